@@ -0,0 +1,510 @@
+///////////////////////////////////////////////////////////////////////////////
+// meshcodec.cpp
+// ============
+// compact coding of vertex and index buffers, decoded at load time
+//
+//  The vertex coding follows the byte plane delta coding of the
+//  meshoptimizer library by Arseny Kapoulkine, without its tail
+//  escapes. A stream starts with the end offset of each block, so
+//  every block can be found before any is decoded.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "MeshCodec.h"
+#include "SIMDMath.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+
+namespace
+{
+	// vertices per block of a vertex stream, a multiple of the group
+	// size, and indices per block of an index stream
+	const size_t g_VertexBlock = 256;
+	const size_t g_IndexBlock = 4096;
+	// deltas sharing a 2 bit header of their width
+	const size_t g_GroupSize = 16;
+	// fewest blocks given to one worker thread by the decoders;
+	// smaller streams stay on one thread
+	const size_t g_ParallelMinBlocks = 32;
+	// longest index code, 7 bits per byte of a 33 bit delta
+	const int g_MaxIndexCodeBytes = 5;
+
+	// widths of the deltas of a group, in its header
+	enum GROUP_MODE
+	{
+		GROUP_ZERO = 0,
+		GROUP_BITS2,
+		GROUP_BITS4,
+		GROUP_BYTES
+	};
+
+	// bytes each group mode stores
+	const size_t g_GroupModeBytes[4] = { 0, 4, 8, 16 };
+
+	/****************************************************
+	 *  ParallelBlocks()
+	 *
+	 *  This function is used for running a decoder over the
+	 *  blocks [0, count) as contiguous ranges, one per
+	 *  worker thread and one on the calling thread, which
+	 *  waits for the rest.
+	 ****************************************************/
+	template <typename PASS>
+	void ParallelBlocks(size_t count, PASS pass)
+	{
+		size_t workers = std::max((size_t)std::thread::hardware_concurrency(), (size_t)1);
+		workers = std::min(workers, count / g_ParallelMinBlocks);
+		if (workers <= 1)
+		{
+			pass((size_t)0, count);
+			return;
+		}
+
+		size_t chunk = (count + workers - 1) / workers;
+		std::vector<std::thread> threads;
+		for (size_t first = chunk; first < count; first += chunk)
+		{
+			threads.push_back(std::thread(pass, first, std::min(first + chunk, count)));
+		}
+		pass((size_t)0, std::min(chunk, count));
+		for (size_t i = 0; i < threads.size(); i++)
+		{
+			threads[i].join();
+		}
+	}
+
+	/****************************************************
+	 *  WriteOffset()
+	 *
+	 *  This function is used for writing where a block
+	 *  ends, the size of the stream so far, into its entry
+	 *  of the table at the start of the stream.
+	 ****************************************************/
+	void WriteOffset(std::vector<unsigned char>& encoded, size_t block)
+	{
+		uint32_t end = (uint32_t)encoded.size();
+		memcpy(&encoded[block * sizeof(uint32_t)], &end, sizeof(end));
+	}
+
+	/****************************************************
+	 *  FindBlocks()
+	 *
+	 *  This function is used for reading the table of block
+	 *  end offsets of a stream into the start of every block
+	 *  and the end of the last, checking that they follow
+	 *  each other inside the stream.
+	 ****************************************************/
+	bool FindBlocks(const unsigned char* pEncoded, size_t encodedSize, size_t blockCount,
+		std::vector<size_t>& starts)
+	{
+		if (blockCount > encodedSize / sizeof(uint32_t))
+		{
+			return(false);
+		}
+		starts.resize(blockCount + 1);
+		starts[0] = blockCount * sizeof(uint32_t);
+		for (size_t i = 0; i < blockCount; i++)
+		{
+			uint32_t end;
+			memcpy(&end, pEncoded + i * sizeof(uint32_t), sizeof(end));
+			if ((end < starts[i]) || (end > encodedSize))
+			{
+				return(false);
+			}
+			starts[i + 1] = end;
+		}
+		return(starts[blockCount] == encodedSize);
+	}
+
+	/****************************************************
+	 *  EncodeVertexBlock()
+	 *
+	 *  This function is used for appending the byte planes
+	 *  of one block of vertices, each the group headers and
+	 *  then the groups at the widths they need. The last
+	 *  group is padded with zero deltas.
+	 ****************************************************/
+	void EncodeVertexBlock(const unsigned char* pVertices, size_t vertexCount, size_t vertexBytes,
+		std::vector<unsigned char>& encoded)
+	{
+		size_t groupCount = (vertexCount + g_GroupSize - 1) / g_GroupSize;
+		unsigned char deltas[g_VertexBlock];
+		for (size_t k = 0; k < vertexBytes; k++)
+		{
+			unsigned char previous = 0;
+			for (size_t i = 0; i < groupCount * g_GroupSize; i++)
+			{
+				deltas[i] = 0;
+				if (i < vertexCount)
+				{
+					unsigned char value = pVertices[i * vertexBytes + k];
+					signed char delta = (signed char)(unsigned char)(value - previous);
+					deltas[i] = (unsigned char)((delta << 1) ^ (delta >> 7));
+					previous = value;
+				}
+			}
+
+			size_t headerStart = encoded.size();
+			encoded.resize(headerStart + (groupCount + 3) / 4, 0);
+			for (size_t g = 0; g < groupCount; g++)
+			{
+				const unsigned char* pGroup = deltas + g * g_GroupSize;
+				unsigned char largest = *std::max_element(pGroup, pGroup + g_GroupSize);
+				int mode = (largest == 0) ? GROUP_ZERO : ((largest < 4) ? GROUP_BITS2 :
+					((largest < 16) ? GROUP_BITS4 : GROUP_BYTES));
+				encoded[headerStart + g / 4] |= (unsigned char)(mode << ((g % 4) * 2));
+				if (mode == GROUP_BITS2)
+				{
+					for (size_t j = 0; j < g_GroupSize; j += 4)
+					{
+						encoded.push_back((unsigned char)(pGroup[j] | (pGroup[j + 1] << 2) |
+							(pGroup[j + 2] << 4) | (pGroup[j + 3] << 6)));
+					}
+				}
+				else if (mode == GROUP_BITS4)
+				{
+					for (size_t j = 0; j < g_GroupSize; j += 2)
+					{
+						encoded.push_back((unsigned char)(pGroup[j] | (pGroup[j + 1] << 4)));
+					}
+				}
+				else if (mode == GROUP_BYTES)
+				{
+					encoded.insert(encoded.end(), pGroup, pGroup + g_GroupSize);
+				}
+			}
+		}
+	}
+
+	/****************************************************
+	 *  DecodeGroup()
+	 *
+	 *  This function is used for unpacking one group of
+	 *  zigzagged deltas and summing them onto the byte
+	 *  before, writing 16 bytes of a plane. With SSE2 the
+	 *  widths unpack with shifts and masks, and the sum is
+	 *  a prefix sum over the lanes in four steps.
+	 ****************************************************/
+	void DecodeGroup(int mode, const unsigned char* pData, unsigned char& previous, unsigned char* pPlane)
+	{
+#if SIMD_FLOAT4_SSE2
+		__m128i zigzag = _mm_setzero_si128();
+		if (mode == GROUP_BITS2)
+		{
+			// each byte four times, then the lanes of each copy shifted
+			// down to their 2 bits
+			int packed;
+			memcpy(&packed, pData, sizeof(packed));
+			__m128i bytes = _mm_cvtsi32_si128(packed);
+			bytes = _mm_unpacklo_epi8(bytes, bytes);
+			bytes = _mm_unpacklo_epi16(bytes, bytes);
+			zigzag = _mm_or_si128(
+				_mm_or_si128(_mm_and_si128(bytes, _mm_set1_epi32(0x00000003)),
+					_mm_and_si128(_mm_srli_epi16(bytes, 2), _mm_set1_epi32(0x00000300))),
+				_mm_or_si128(_mm_and_si128(_mm_srli_epi16(bytes, 4), _mm_set1_epi32(0x00030000)),
+					_mm_and_si128(_mm_srli_epi16(bytes, 6), _mm_set1_epi32(0x03000000))));
+		}
+		else if (mode == GROUP_BITS4)
+		{
+			const __m128i nibble = _mm_set1_epi8(0x0F);
+			__m128i bytes = _mm_loadl_epi64((const __m128i*)pData);
+			zigzag = _mm_unpacklo_epi8(_mm_and_si128(bytes, nibble),
+				_mm_and_si128(_mm_srli_epi16(bytes, 4), nibble));
+		}
+		else if (mode == GROUP_BYTES)
+		{
+			zigzag = _mm_loadu_si128((const __m128i*)pData);
+		}
+
+		__m128i deltas = _mm_xor_si128(
+			_mm_and_si128(_mm_srli_epi16(zigzag, 1), _mm_set1_epi8(0x7F)),
+			_mm_sub_epi8(_mm_setzero_si128(), _mm_and_si128(zigzag, _mm_set1_epi8(1))));
+		deltas = _mm_add_epi8(deltas, _mm_slli_si128(deltas, 1));
+		deltas = _mm_add_epi8(deltas, _mm_slli_si128(deltas, 2));
+		deltas = _mm_add_epi8(deltas, _mm_slli_si128(deltas, 4));
+		deltas = _mm_add_epi8(deltas, _mm_slli_si128(deltas, 8));
+		deltas = _mm_add_epi8(deltas, _mm_set1_epi8((char)previous));
+		_mm_storeu_si128((__m128i*)pPlane, deltas);
+		previous = pPlane[g_GroupSize - 1];
+#else
+		unsigned char zigzag[g_GroupSize] = {};
+		for (size_t j = 0; j < g_GroupSize; j++)
+		{
+			if (mode == GROUP_BITS2)
+			{
+				zigzag[j] = (pData[j / 4] >> ((j % 4) * 2)) & 3;
+			}
+			else if (mode == GROUP_BITS4)
+			{
+				zigzag[j] = (pData[j / 2] >> ((j % 2) * 4)) & 15;
+			}
+			else if (mode == GROUP_BYTES)
+			{
+				zigzag[j] = pData[j];
+			}
+		}
+		for (size_t j = 0; j < g_GroupSize; j++)
+		{
+			previous = (unsigned char)(previous + ((zigzag[j] >> 1) ^ (0 - (zigzag[j] & 1))));
+			pPlane[j] = previous;
+		}
+#endif
+	}
+
+	/****************************************************
+	 *  DecodeVertexBlock()
+	 *
+	 *  This function is used for decoding the byte planes
+	 *  of one block, then turning them back into whole
+	 *  vertices written out in one copy. planes holds the
+	 *  planes and then the vertices, two blocks of room.
+	 ****************************************************/
+	bool DecodeVertexBlock(const unsigned char* pData, size_t dataSize, unsigned char* pVertices,
+		size_t vertexCount, size_t vertexBytes, unsigned char* pPlanes)
+	{
+		size_t groupCount = (vertexCount + g_GroupSize - 1) / g_GroupSize;
+		size_t headerBytes = (groupCount + 3) / 4;
+		size_t in = 0;
+		for (size_t k = 0; k < vertexBytes; k++)
+		{
+			if (headerBytes > dataSize - in)
+			{
+				return(false);
+			}
+			const unsigned char* pHeader = pData + in;
+			in += headerBytes;
+
+			unsigned char previous = 0;
+			unsigned char* pPlane = pPlanes + k * g_VertexBlock;
+			for (size_t g = 0; g < groupCount; g++)
+			{
+				int mode = (pHeader[g / 4] >> ((g % 4) * 2)) & 3;
+				if (g_GroupModeBytes[mode] > dataSize - in)
+				{
+					return(false);
+				}
+				DecodeGroup(mode, pData + in, previous, pPlane + g * g_GroupSize);
+				in += g_GroupModeBytes[mode];
+			}
+		}
+		if (in != dataSize)
+		{
+			return(false);
+		}
+
+		unsigned char* pBlock = pPlanes + vertexBytes * g_VertexBlock;
+		for (size_t i = 0; i < vertexCount; i++)
+		{
+			for (size_t k = 0; k < vertexBytes; k++)
+			{
+				pBlock[i * vertexBytes + k] = pPlanes[k * g_VertexBlock + i];
+			}
+		}
+		memcpy(pVertices, pBlock, vertexCount * vertexBytes);
+		return(true);
+	}
+
+	/****************************************************
+	 *  ReadIndex()
+	 *
+	 *  This function is used for reading an index of 2 or
+	 *  4 bytes at any alignment.
+	 ****************************************************/
+	uint32_t ReadIndex(const unsigned char* pIndex, size_t indexBytes)
+	{
+		if (indexBytes == sizeof(uint16_t))
+		{
+			uint16_t index;
+			memcpy(&index, pIndex, sizeof(index));
+			return(index);
+		}
+		uint32_t index;
+		memcpy(&index, pIndex, sizeof(index));
+		return(index);
+	}
+}
+
+/***********************************************************
+ *  EncodeVertices()
+ *
+ *  This method is used for coding vertices block by block
+ *  after the table of where each block ends.
+ ***********************************************************/
+void MeshCodec::EncodeVertices(
+	const void* pVertices,
+	size_t vertexCount,
+	size_t vertexBytes,
+	std::vector<unsigned char>& encoded)
+{
+	const unsigned char* pBytes = (const unsigned char*)pVertices;
+	size_t blockCount = (vertexCount + g_VertexBlock - 1) / g_VertexBlock;
+	encoded.assign(blockCount * sizeof(uint32_t), 0);
+	encoded.reserve(vertexCount * vertexBytes);
+	for (size_t i = 0; i < blockCount; i++)
+	{
+		size_t first = i * g_VertexBlock;
+		EncodeVertexBlock(pBytes + first * vertexBytes, std::min(g_VertexBlock, vertexCount - first),
+			vertexBytes, encoded);
+		WriteOffset(encoded, i);
+	}
+}
+
+/***********************************************************
+ *  DecodeVertices()
+ *
+ *  This method is used for decoding a vertex stream, the
+ *  blocks split between threads once the table of their
+ *  ends is checked.
+ ***********************************************************/
+bool MeshCodec::DecodeVertices(
+	const unsigned char* pEncoded,
+	size_t encodedSize,
+	void* pVertices,
+	size_t vertexCount,
+	size_t vertexBytes)
+{
+	if ((vertexBytes == 0) || (vertexBytes > MAX_VERTEX_BYTES))
+	{
+		return(false);
+	}
+	size_t blockCount = (vertexCount + g_VertexBlock - 1) / g_VertexBlock;
+	std::vector<size_t> starts;
+	if (FindBlocks(pEncoded, encodedSize, blockCount, starts) == false)
+	{
+		return(false);
+	}
+
+	unsigned char* pBytes = (unsigned char*)pVertices;
+	std::atomic<bool> bValid(true);
+	ParallelBlocks(blockCount, [&](size_t first, size_t end)
+		{
+			std::vector<unsigned char> planes(2 * vertexBytes * g_VertexBlock);
+			for (size_t i = first; (i < end) && (bValid == true); i++)
+			{
+				size_t firstVertex = i * g_VertexBlock;
+				if (DecodeVertexBlock(pEncoded + starts[i], starts[i + 1] - starts[i],
+					pBytes + firstVertex * vertexBytes, std::min(g_VertexBlock, vertexCount - firstVertex),
+					vertexBytes, &planes[0]) == false)
+				{
+					bValid = false;
+				}
+			}
+		});
+	return(bValid);
+}
+
+/***********************************************************
+ *  EncodeIndices()
+ *
+ *  This method is used for coding indices block by block,
+ *  each as the difference from the index before it in its
+ *  block, zigzagged, in 7 bit groups with the top bit set
+ *  on all but the last.
+ ***********************************************************/
+void MeshCodec::EncodeIndices(
+	const void* pIndices,
+	size_t indexCount,
+	size_t indexBytes,
+	std::vector<unsigned char>& encoded)
+{
+	const unsigned char* pBytes = (const unsigned char*)pIndices;
+	size_t blockCount = (indexCount + g_IndexBlock - 1) / g_IndexBlock;
+	encoded.assign(blockCount * sizeof(uint32_t), 0);
+	encoded.reserve(encoded.size() + indexCount * 2);
+	for (size_t i = 0; i < blockCount; i++)
+	{
+		int64_t previous = 0;
+		size_t end = std::min((i + 1) * g_IndexBlock, indexCount);
+		for (size_t j = i * g_IndexBlock; j < end; j++)
+		{
+			int64_t index = ReadIndex(pBytes + j * indexBytes, indexBytes);
+			int64_t delta = index - previous;
+			uint64_t code = ((uint64_t)delta << 1) ^ (uint64_t)(delta >> 63);
+			while (code >= 0x80)
+			{
+				encoded.push_back((unsigned char)(code | 0x80));
+				code >>= 7;
+			}
+			encoded.push_back((unsigned char)code);
+			previous = index;
+		}
+		WriteOffset(encoded, i);
+	}
+}
+
+/***********************************************************
+ *  DecodeIndices()
+ *
+ *  This method is used for decoding an index stream, the
+ *  blocks split between threads once the table of their
+ *  ends is checked.
+ ***********************************************************/
+bool MeshCodec::DecodeIndices(
+	const unsigned char* pEncoded,
+	size_t encodedSize,
+	void* pIndices,
+	size_t indexCount,
+	size_t indexBytes)
+{
+	if ((indexBytes != sizeof(uint16_t)) && (indexBytes != sizeof(uint32_t)))
+	{
+		return(false);
+	}
+	size_t blockCount = (indexCount + g_IndexBlock - 1) / g_IndexBlock;
+	std::vector<size_t> starts;
+	if (FindBlocks(pEncoded, encodedSize, blockCount, starts) == false)
+	{
+		return(false);
+	}
+
+	const int64_t largest = (indexBytes == sizeof(uint16_t)) ? 0xFFFF : 0xFFFFFFFFll;
+	unsigned char* pBytes = (unsigned char*)pIndices;
+	std::atomic<bool> bValid(true);
+	ParallelBlocks(blockCount, [&](size_t first, size_t end)
+		{
+			for (size_t i = first; (i < end) && (bValid == true); i++)
+			{
+				const unsigned char* pData = pEncoded + starts[i];
+				const unsigned char* pDataEnd = pEncoded + starts[i + 1];
+				int64_t previous = 0;
+				size_t lastIndex = std::min((i + 1) * g_IndexBlock, indexCount);
+				for (size_t j = i * g_IndexBlock; j < lastIndex; j++)
+				{
+					uint64_t code = 0;
+					int shift = 0;
+					unsigned char byte = 0x80;
+					for (int n = 0; (n < g_MaxIndexCodeBytes) && ((byte & 0x80) != 0) && (pData < pDataEnd); n++)
+					{
+						byte = *pData++;
+						code |= (uint64_t)(byte & 0x7F) << shift;
+						shift += 7;
+					}
+					int64_t index = previous + (int64_t)((code >> 1) ^ (0 - (code & 1)));
+					if (((byte & 0x80) != 0) || (index < 0) || (index > largest))
+					{
+						bValid = false;
+						break;
+					}
+					if (indexBytes == sizeof(uint16_t))
+					{
+						uint16_t value = (uint16_t)index;
+						memcpy(pBytes + j * indexBytes, &value, sizeof(value));
+					}
+					else
+					{
+						uint32_t value = (uint32_t)index;
+						memcpy(pBytes + j * indexBytes, &value, sizeof(value));
+					}
+					previous = index;
+				}
+				if (pData != pDataEnd)
+				{
+					bValid = false;
+				}
+			}
+		});
+	return(bValid);
+}
@@ -0,0 +1,71 @@
+///////////////////////////////////////////////////////////////////////////////
+// meshcodec.h
+// ============
+// compact coding of vertex and index buffers, decoded at load time
+//
+//  Vertices are coded a byte plane at a time: byte k of each vertex
+//  less byte k of the vertex before, zigzagged so small changes either
+//  way are small values, in groups of 16 sharing a 2 bit header of
+//  how wide they are, none, 2, 4 or 8 bits. Neighbouring vertices of
+//  a baked mesh differ in few bits of most of their bytes, so the
+//  groups shrink, and the repeats left are found by the LZ4 of the
+//  asset pack after. Indices are coded as zigzagged differences from
+//  the index before, 7 bits per byte. Both streams are split into
+//  blocks that decode on their own, so the decoders spread the blocks
+//  over threads, and a block of vertices is written out whole, which
+//  keeps the writes into a mapped GPU buffer sequential. The vertex
+//  groups unpack with SSE2 where the build has it.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+/***********************************************************
+ *  MeshCodec
+ *
+ *  This class contains the encoders the mesh bake runs and
+ *  the decoders of the mesh loads. The coding is lossless:
+ *  the compact vertex layout is the quantized form of the
+ *  vertices, and the float layouts are kept bit for bit.
+ ***********************************************************/
+class MeshCodec
+{
+public:
+	// widest vertex coded, in bytes
+	static const size_t MAX_VERTEX_BYTES = 256;
+
+	// code vertexCount vertices of vertexBytes each, replacing the
+	// contents of encoded
+	static void EncodeVertices(
+		const void* pVertices,
+		size_t vertexCount,
+		size_t vertexBytes,
+		std::vector<unsigned char>& encoded);
+	// decode a stream of EncodeVertices() into vertexCount vertices
+	// of vertexBytes; false, with pVertices partly written, for a
+	// stream that does not hold exactly that many
+	static bool DecodeVertices(
+		const unsigned char* pEncoded,
+		size_t encodedSize,
+		void* pVertices,
+		size_t vertexCount,
+		size_t vertexBytes);
+
+	// code indexCount indices of indexBytes, 2 or 4, each
+	static void EncodeIndices(
+		const void* pIndices,
+		size_t indexCount,
+		size_t indexBytes,
+		std::vector<unsigned char>& encoded);
+	// decode a stream of EncodeIndices() into indexCount indices of
+	// indexBytes; false for a stream that does not hold exactly that
+	// many or holds an index too large for them
+	static bool DecodeIndices(
+		const unsigned char* pEncoded,
+		size_t encodedSize,
+		void* pIndices,
+		size_t indexCount,
+		size_t indexBytes);
+};
@@ -0,0 +1,338 @@
+///////////////////////////////////////////////////////////////////////////////
+// meshfile.cpp
+// ============
+// binary file of baked meshes, mapped and uploaded as it is
+//
+//  The blobs start on BLOB_ALIGNMENT boundaries of the file, and a
+//  mapping starts on a page boundary, so each one can be handed to
+//  glBufferStorage straight from the mapped view, unless it is coded.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "MeshFile.h"
+#include "MeshCodec.h"
+
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static_assert(sizeof(MeshFile::HEADER) == 144, "MeshFile::HEADER must have no padding");
+static_assert(sizeof(MeshFile::SHAPE) == 32, "MeshFile::SHAPE must have no padding");
+static_assert(sizeof(MeshFile::MESH) == 64, "MeshFile::MESH must have no padding");
+static_assert(sizeof(MeshFile::STATS) == 64, "MeshFile::STATS must have no padding");
+
+namespace
+{
+	// most records of each table a file may list
+	const uint32_t MAX_RECORDS = 4096;
+
+	/****************************************************
+	 *  AlignBlob()
+	 *
+	 *  This function is used for rounding a file offset up
+	 *  to the start of the next blob.
+	 ****************************************************/
+	uint64_t AlignBlob(uint64_t offset)
+	{
+		const uint64_t alignment = MeshFile::BLOB_ALIGNMENT;
+		return((offset + alignment - 1) / alignment * alignment);
+	}
+}
+
+MeshFile::MeshFile()
+{
+	m_pView = NULL;
+	m_fileSize = 0;
+	m_packed.pData = NULL;
+	m_packed.size = 0;
+}
+
+MeshFile::~MeshFile()
+{
+	Close();
+}
+
+/***********************************************************
+ *  Open()
+ *
+ *  This method is used for mapping a baked mesh file read
+ *  only, or viewing it in the asset pack. Files of another
+ *  layout, or whose tables or blobs run past their end, are
+ *  closed again and rejected.
+ ***********************************************************/
+bool MeshFile::Open(const char* filename)
+{
+	Close();
+
+	// a file in the asset pack is used from its view, which stays
+	// valid while the pack is mounted
+	if (AssetPack::Find(filename, m_packed) == true)
+	{
+		m_pView = m_packed.pData;
+		m_fileSize = m_packed.size;
+	}
+	else
+	{
+		void* pView = NULL;
+		size_t fileSize = 0;
+#ifdef _WIN32
+		HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL,
+			OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+		if (file != INVALID_HANDLE_VALUE)
+		{
+			LARGE_INTEGER size;
+			if ((GetFileSizeEx(file, &size) != 0) && (size.QuadPart > 0))
+			{
+				fileSize = (size_t)size.QuadPart;
+				// the view keeps the mapping open once both handles are closed
+				HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+				if (NULL != mapping)
+				{
+					pView = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+					CloseHandle(mapping);
+				}
+			}
+			CloseHandle(file);
+		}
+#else
+		int file = open(filename, O_RDONLY);
+		if (file >= 0)
+		{
+			struct stat fileInfo;
+			if ((fstat(file, &fileInfo) == 0) && (fileInfo.st_size > 0))
+			{
+				fileSize = (size_t)fileInfo.st_size;
+				pView = mmap(NULL, fileSize, PROT_READ, MAP_PRIVATE, file, 0);
+				if (pView == MAP_FAILED)
+				{
+					pView = NULL;
+				}
+			}
+			close(file);
+		}
+#endif
+		m_pView = (const unsigned char*)pView;
+		m_fileSize = fileSize;
+	}
+	if (NULL == m_pView)
+	{
+		return(false);
+	}
+
+	bool bValid = (m_fileSize >= sizeof(HEADER));
+	if (bValid == true)
+	{
+		const HEADER& header = GetHeader();
+		bValid = (header.magic == MAGIC) && (header.version == VERSION) &&
+			(header.shapeCount <= MAX_RECORDS) && (header.meshCount <= MAX_RECORDS) &&
+			(header.statsCount <= MAX_RECORDS) && ((header.encodedBlobs >> BLOB_COUNT) == 0) &&
+			(sizeof(HEADER) + header.shapeCount * sizeof(SHAPE) + header.meshCount * sizeof(MESH) +
+				header.statsCount * sizeof(STATS) <= m_fileSize);
+		for (int i = 0; (i < BLOB_COUNT) && (bValid == true); i++)
+		{
+			bValid = ((header.blobOffsets[i] % BLOB_ALIGNMENT) == 0) &&
+				(header.blobOffsets[i] <= m_fileSize) &&
+				(header.storedSizes[i] <= m_fileSize - header.blobOffsets[i]);
+			if (IsEncoded((BLOB)i) == true)
+			{
+				bValid = bValid && (header.blobStrides[i] > 0) && (header.blobStrides[i] <= MeshCodec::MAX_VERTEX_BYTES) &&
+					((header.blobSizes[i] % header.blobStrides[i]) == 0);
+			}
+			else
+			{
+				bValid = bValid && (header.storedSizes[i] == header.blobSizes[i]);
+			}
+		}
+	}
+	if (bValid == false)
+	{
+		std::cout << "Baked mesh file " << filename << " is not valid" << std::endl;
+		Close();
+	}
+	else
+	{
+		AssetPack::NoteArtifact(filename, false);
+	}
+	return(bValid);
+}
+
+/***********************************************************
+ *  Close()
+ *
+ *  This method is used for unmapping the file, which makes
+ *  every pointer into it invalid.
+ ***********************************************************/
+void MeshFile::Close()
+{
+	if ((NULL != m_pView) && (m_pView != m_packed.pData))
+	{
+#ifdef _WIN32
+		UnmapViewOfFile(m_pView);
+#else
+		munmap((void*)m_pView, m_fileSize);
+#endif
+	}
+	m_pView = NULL;
+	m_fileSize = 0;
+	m_packed.pData = NULL;
+	m_packed.size = 0;
+	m_packed.buffer.clear();
+}
+
+/***********************************************************
+ *  GetBlob()
+ *
+ *  This method is used for getting the start of a blob in
+ *  the mapped view.
+ ***********************************************************/
+const void* MeshFile::GetBlob(BLOB blob) const
+{
+	if ((NULL == m_pView) || (0 == GetHeader().storedSizes[blob]))
+	{
+		return(NULL);
+	}
+	return(m_pView + GetHeader().blobOffsets[blob]);
+}
+
+/***********************************************************
+ *  DecodeBlob()
+ *
+ *  This method is used for writing a blob where it is used:
+ *  one stored as it is is copied, the vertex blobs coded
+ *  by MeshCodec are decoded by the stride of their layout,
+ *  and the index blob by the size of its indices.
+ ***********************************************************/
+bool MeshFile::DecodeBlob(BLOB blob, void* pDestination) const
+{
+	const HEADER& header = GetHeader();
+	const unsigned char* pStored = (const unsigned char*)GetBlob(blob);
+	if (IsEncoded(blob) == false)
+	{
+		if (NULL != pStored)
+		{
+			memcpy(pDestination, pStored, (size_t)header.blobSizes[blob]);
+		}
+		return(true);
+	}
+
+	size_t stride = header.blobStrides[blob];
+	size_t count = (size_t)header.blobSizes[blob] / stride;
+	if (blob == BLOB_INDICES)
+	{
+		return(MeshCodec::DecodeIndices(pStored, (size_t)header.storedSizes[blob], pDestination, count, stride));
+	}
+	return(MeshCodec::DecodeVertices(pStored, (size_t)header.storedSizes[blob], pDestination, count, stride));
+}
+
+/***********************************************************
+ *  Write()
+ *
+ *  This method is used for writing the header and tables,
+ *  then each blob, coded first if asked and that pays,
+ *  padded out to the next BLOB_ALIGNMENT boundary.
+ ***********************************************************/
+bool MeshFile::Write(
+	const char* filename,
+	HEADER& header,
+	const std::vector<SHAPE>& shapes,
+	const std::vector<MESH>& meshes,
+	const std::vector<STATS>& stats,
+	const void* const pBlobs[BLOB_COUNT],
+	const size_t blobSizes[BLOB_COUNT],
+	bool bEncode)
+{
+	header.magic = MAGIC;
+	header.version = VERSION;
+	header.shapeCount = (uint32_t)shapes.size();
+	header.meshCount = (uint32_t)meshes.size();
+	header.statsCount = (uint32_t)stats.size();
+	header.encodedBlobs = 0;
+
+	// the blobs as they are written
+	const void* pStored[BLOB_COUNT];
+	std::vector<unsigned char> encoded[BLOB_COUNT];
+	for (int i = 0; i < BLOB_COUNT; i++)
+	{
+		pStored[i] = pBlobs[i];
+		header.blobSizes[i] = blobSizes[i];
+		header.storedSizes[i] = blobSizes[i];
+		size_t stride = header.blobStrides[i];
+		if ((bEncode == false) || (stride == 0) || (blobSizes[i] == 0) || ((blobSizes[i] % stride) != 0))
+		{
+			continue;
+		}
+		if (i == BLOB_INDICES)
+		{
+			MeshCodec::EncodeIndices(pBlobs[i], blobSizes[i] / stride, stride, encoded[i]);
+		}
+		else
+		{
+			MeshCodec::EncodeVertices(pBlobs[i], blobSizes[i] / stride, stride, encoded[i]);
+		}
+		if (encoded[i].size() < blobSizes[i])
+		{
+			pStored[i] = encoded[i].data();
+			header.storedSizes[i] = encoded[i].size();
+			header.encodedBlobs |= 1u << i;
+		}
+	}
+
+	uint64_t offset = AlignBlob(sizeof(HEADER) + shapes.size() * sizeof(SHAPE) +
+		meshes.size() * sizeof(MESH) + stats.size() * sizeof(STATS));
+	for (int i = 0; i < BLOB_COUNT; i++)
+	{
+		header.blobOffsets[i] = offset;
+		offset = AlignBlob(offset + header.storedSizes[i]);
+	}
+
+	FILE* pFile = fopen(filename, "wb");
+	if (NULL == pFile)
+	{
+		std::cout << "Could not create baked mesh file " << filename << std::endl;
+		return(false);
+	}
+
+	bool bWritten = (fwrite(&header, sizeof(header), 1, pFile) == 1);
+	bWritten = bWritten && (shapes.empty() ||
+		(fwrite(&shapes[0], sizeof(SHAPE), shapes.size(), pFile) == shapes.size()));
+	bWritten = bWritten && (meshes.empty() ||
+		(fwrite(&meshes[0], sizeof(MESH), meshes.size(), pFile) == meshes.size()));
+	bWritten = bWritten && (stats.empty() ||
+		(fwrite(&stats[0], sizeof(STATS), stats.size(), pFile) == stats.size()));
+
+	const unsigned char padding[BLOB_ALIGNMENT] = {};
+	for (int i = 0; (i < BLOB_COUNT) && (bWritten == true); i++)
+	{
+		long position = ftell(pFile);
+		size_t paddingBytes = (size_t)(header.blobOffsets[i] - (uint64_t)position);
+		size_t storedSize = (size_t)header.storedSizes[i];
+		bWritten = (position >= 0) && (paddingBytes < BLOB_ALIGNMENT) &&
+			((paddingBytes == 0) || (fwrite(padding, 1, paddingBytes, pFile) == paddingBytes)) &&
+			((storedSize == 0) || (fwrite(pStored[i], 1, storedSize, pFile) == storedSize));
+	}
+	bWritten = (fclose(pFile) == 0) && bWritten;
+
+	if (bWritten == false)
+	{
+		std::cout << "Could not write baked mesh file " << filename << std::endl;
+	}
+	else
+	{
+		AssetPack::NoteArtifact(filename, true);
+	}
+	return(bWritten);
+}
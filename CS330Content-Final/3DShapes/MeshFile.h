@@ -0,0 +1,154 @@
+///////////////////////////////////////////////////////////////////////////////
+// meshfile.h
+// ============
+// binary file of baked meshes, mapped and uploaded as it is
+//
+//  Holds the vertex and index buffers of a set of meshes exactly as
+//  they are sent to GL, each blob aligned for upload straight from
+//  the mapped file, with tables of the shapes they were generated
+//  from, the range and bounds of each mesh and LOD level, and the
+//  vertex cache stats of their bake. Loading it checks the tables
+//  against the file size and copies nothing but the CPU copies the
+//  meshes keep anyway. A file baked for the asset pack may hold its
+//  blobs coded by MeshCodec instead, which are decoded on loading
+//  into those copies and into mapped buffers.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "AssetPack.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/***********************************************************
+ *  MeshFile
+ *
+ *  This class contains the layout of the baked mesh file,
+ *  the read only mapping of one, and the writer baking one.
+ ***********************************************************/
+class MeshFile
+{
+public:
+	// constructor
+	MeshFile();
+	// destructor
+	~MeshFile();
+
+	// "SMB1" and the layout version
+	static const uint32_t MAGIC = 0x31424D53;
+	static const uint32_t VERSION = 2;
+	// start of every blob, past the alignment GL asks of buffer data
+	static const size_t BLOB_ALIGNMENT = 256;
+	// longest mesh name kept, its terminator included
+	static const int NAME_LENGTH = 32;
+
+	// data blobs following the tables
+	enum BLOB
+	{
+		BLOB_VERTICES = 0,		// interleaved full float vertices
+		BLOB_COMPACT_VERTICES,	// compact vertices as packed for GL
+		BLOB_COMPACT_FLOATS,	// the compact vertices in floats, for the CPU
+		BLOB_INDICES,			// indices of indexType
+		BLOB_COUNT
+	};
+
+	// start of the file, followed by shapeCount SHAPE, meshCount
+	// MESH and statsCount STATS records, then the blobs
+	struct HEADER
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint32_t shapeCount;
+		uint32_t meshCount;
+		uint32_t statsCount;
+		uint32_t indexType;		// GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+		uint32_t maxIndex;		// largest index of any mesh
+		uint32_t encodedBlobs;	// bit 1 << BLOB set for a blob coded by MeshCodec
+		uint64_t blobOffsets[BLOB_COUNT];	// from the start of the file
+		uint64_t blobSizes[BLOB_COUNT];		// in bytes, once decoded
+		uint64_t storedSizes[BLOB_COUNT];	// in bytes in the file
+		uint32_t blobStrides[BLOB_COUNT];	// bytes of a vertex or index of each
+	};
+
+	// one generated shape and the tessellation it was requested at
+	struct SHAPE
+	{
+		int32_t shape;			// ShapeMeshes::MESH_SHAPE
+		int32_t bCompact;
+		int32_t resolution[2];
+		float thickness;
+		uint32_t firstMesh;		// its mesh and then its LOD levels
+		uint32_t meshCount;
+		uint32_t unused;
+	};
+
+	// where one mesh or LOD level lies in the blobs
+	struct MESH
+	{
+		uint32_t nVertices;
+		uint32_t nIndices;
+		uint32_t baseVertex;	// in the blob of its layout
+		uint32_t firstIndex;
+		uint32_t slices;
+		int32_t bCompact;
+		float minXYZ[3];
+		float maxXYZ[3];
+		float center[3];
+		float radius;
+	};
+
+	// vertex cache quality of one mesh before and after its bake
+	struct STATS
+	{
+		char name[NAME_LENGTH];
+		int32_t bCompact;
+		uint32_t vertexCount;
+		uint32_t triangleCount;
+		float acmrBefore;
+		float atvrBefore;
+		float acmrAfter;
+		float atvrAfter;
+		uint32_t unused;
+	};
+
+	// map a file read only and check that its tables and blobs lie
+	// inside it, false when it cannot be used
+	bool Open(const char* filename);
+	void Close();
+	bool IsOpen() const { return(NULL != m_pView); }
+
+	const HEADER& GetHeader() const { return(*(const HEADER*)m_pView); }
+	const SHAPE* GetShapes() const { return((const SHAPE*)(m_pView + sizeof(HEADER))); }
+	const MESH* GetMeshes() const { return((const MESH*)(GetShapes() + GetHeader().shapeCount)); }
+	const STATS* GetStats() const { return((const STATS*)(GetMeshes() + GetHeader().meshCount)); }
+	// start of a blob in the mapping, as it is stored, NULL when it
+	// is empty
+	const void* GetBlob(BLOB blob) const;
+	bool IsEncoded(BLOB blob) const { return((GetHeader().encodedBlobs & (1u << blob)) != 0); }
+	// write the blobSizes bytes of a blob into pDestination, decoding
+	// it if it is coded; false for a coded blob that is damaged
+	bool DecodeBlob(BLOB blob, void* pDestination) const;
+
+	// write the tables and blobs, filling in the counts, offsets and
+	// sizes of the header; pBlobs and blobSizes list every BLOB, and
+	// with bEncode each blob the header gives a stride is coded by
+	// MeshCodec when that makes it smaller
+	static bool Write(
+		const char* filename,
+		HEADER& header,
+		const std::vector<SHAPE>& shapes,
+		const std::vector<MESH>& meshes,
+		const std::vector<STATS>& stats,
+		const void* const pBlobs[BLOB_COUNT],
+		const size_t blobSizes[BLOB_COUNT],
+		bool bEncode = false);
+
+private:
+	const unsigned char* m_pView;
+	size_t m_fileSize;
+	// the file in the asset pack, which m_pView points into when the
+	// pack holds it instead of a mapping
+	AssetPack::ASSET_VIEW m_packed;
+};
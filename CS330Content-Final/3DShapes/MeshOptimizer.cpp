@@ -0,0 +1,1219 @@
+///////////////////////////////////////////////////////////////////////////////
+// meshoptimizer.cpp
+// ============
+// reorder indexed meshes for the post-transform vertex cache
+//
+//  The triangle order follows "Fast Triangle Reordering for Vertex
+//  Locality and Reduced Overdraw", Sander, Nehab and Barczak, 2007.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "MeshOptimizer.h"
+#include "SIMDMath.h"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <queue>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace
+{
+	// fewest triangles or vertices given to one worker thread by
+	// the normal generation; smaller meshes stay on one thread
+	const size_t PARALLEL_MIN_ITEMS = 16384;
+
+	/****************************************************
+	 *  ParallelFor()
+	 *
+	 *  This function is used for running a pass over the
+	 *  items [0, count) as contiguous chunks, one per
+	 *  worker thread and one on the calling thread, which
+	 *  waits for the rest. The chunks are multiples of
+	 *  four, so the SIMD paths see whole groups.
+	 ****************************************************/
+	template <typename PASS>
+	void ParallelFor(size_t count, PASS pass)
+	{
+		size_t workers = std::max((size_t)std::thread::hardware_concurrency(), (size_t)1);
+		workers = std::min(workers, count / PARALLEL_MIN_ITEMS);
+		if (workers <= 1)
+		{
+			pass((size_t)0, count);
+			return;
+		}
+
+		size_t chunk = ((count + workers - 1) / workers + 3) & ~(size_t)3;
+		std::vector<std::thread> threads;
+		for (size_t first = chunk; first < count; first += chunk)
+		{
+			threads.push_back(std::thread(pass, first, std::min(first + chunk, count)));
+		}
+		pass((size_t)0, std::min(chunk, count));
+		for (size_t i = 0; i < threads.size(); i++)
+		{
+			threads[i].join();
+		}
+	}
+
+	/****************************************************
+	 *  ComputeFaceNormals()
+	 *
+	 *  This function is used for writing the unnormalized
+	 *  cross product of the triangles [first, end), whose
+	 *  length is twice the area, into three component
+	 *  arrays. With SSE2 or NEON four triangles go at once,
+	 *  one per lane, after their corners are gathered.
+	 ****************************************************/
+	void ComputeFaceNormals(
+		const GLfloat* pVertices,
+		int vertexFloats,
+		const GLuint* pIndices,
+		size_t first,
+		size_t end,
+		float* pNormalX,
+		float* pNormalY,
+		float* pNormalZ)
+	{
+		size_t triangle = first;
+
+#if SIMD_FLOAT4
+		for (; triangle + 4 <= end; triangle += 4)
+		{
+			// corner, then axis, of the four triangles
+			float corners[3][3][4];
+			for (int lane = 0; lane < 4; lane++)
+			{
+				for (int corner = 0; corner < 3; corner++)
+				{
+					const GLfloat* pPosition = pVertices +
+						(size_t)pIndices[(triangle + lane) * 3 + corner] * vertexFloats;
+					corners[corner][0][lane] = pPosition[0];
+					corners[corner][1][lane] = pPosition[1];
+					corners[corner][2][lane] = pPosition[2];
+				}
+			}
+			FLOAT4 ax = Float4Load(corners[0][0]);
+			FLOAT4 ay = Float4Load(corners[0][1]);
+			FLOAT4 az = Float4Load(corners[0][2]);
+			FLOAT4 ux = Float4Sub(Float4Load(corners[1][0]), ax);
+			FLOAT4 uy = Float4Sub(Float4Load(corners[1][1]), ay);
+			FLOAT4 uz = Float4Sub(Float4Load(corners[1][2]), az);
+			FLOAT4 vx = Float4Sub(Float4Load(corners[2][0]), ax);
+			FLOAT4 vy = Float4Sub(Float4Load(corners[2][1]), ay);
+			FLOAT4 vz = Float4Sub(Float4Load(corners[2][2]), az);
+			Float4Store(pNormalX + triangle, Float4Sub(Float4Mul(uy, vz), Float4Mul(uz, vy)));
+			Float4Store(pNormalY + triangle, Float4Sub(Float4Mul(uz, vx), Float4Mul(ux, vz)));
+			Float4Store(pNormalZ + triangle, Float4Sub(Float4Mul(ux, vy), Float4Mul(uy, vx)));
+		}
+#endif
+
+		for (; triangle < end; triangle++)
+		{
+			const GLuint* pTriangle = pIndices + triangle * 3;
+			const GLfloat* pA = pVertices + (size_t)pTriangle[0] * vertexFloats;
+			const GLfloat* pB = pVertices + (size_t)pTriangle[1] * vertexFloats;
+			const GLfloat* pC = pVertices + (size_t)pTriangle[2] * vertexFloats;
+			glm::vec3 a(pA[0], pA[1], pA[2]);
+			glm::vec3 normal = glm::cross(glm::vec3(pB[0], pB[1], pB[2]) - a, glm::vec3(pC[0], pC[1], pC[2]) - a);
+			pNormalX[triangle] = normal.x;
+			pNormalY[triangle] = normal.y;
+			pNormalZ[triangle] = normal.z;
+		}
+	}
+
+	/****************************************************
+	 *  NormalizeVertexNormals()
+	 *
+	 *  This function is used for scaling the summed normals
+	 *  of the vertices [first, end) to unit length, four at
+	 *  a time with SSE2 or NEON, and pointing the ones that summed
+	 *  to nothing up.
+	 ****************************************************/
+	void NormalizeVertexNormals(
+		GLfloat* pVertices,
+		int vertexFloats,
+		size_t first,
+		size_t end)
+	{
+		size_t vertex = first;
+
+#if SIMD_FLOAT4
+		const FLOAT4 zero = Float4Zero();
+		const FLOAT4 one = Float4Set(1.0f);
+		for (; vertex + 4 <= end; vertex += 4)
+		{
+			float normals[3][4];
+			for (int lane = 0; lane < 4; lane++)
+			{
+				const GLfloat* pNormal = pVertices + (vertex + lane) * vertexFloats + 3;
+				normals[0][lane] = pNormal[0];
+				normals[1][lane] = pNormal[1];
+				normals[2][lane] = pNormal[2];
+			}
+			FLOAT4 x = Float4Load(normals[0]);
+			FLOAT4 y = Float4Load(normals[1]);
+			FLOAT4 z = Float4Load(normals[2]);
+			FLOAT4 lengthSquared = Float4Add(Float4Add(Float4Mul(x, x), Float4Mul(y, y)), Float4Mul(z, z));
+			// the empty lanes divide by one and take the up vector
+			FLOAT4 empty = Float4LessEqual(lengthSquared, zero);
+			FLOAT4 length = Float4Select(empty, one, Float4Sqrt(lengthSquared));
+			Float4Store(normals[0], Float4Div(x, length));
+			Float4Store(normals[1], Float4Select(empty, one, Float4Div(y, length)));
+			Float4Store(normals[2], Float4Div(z, length));
+			for (int lane = 0; lane < 4; lane++)
+			{
+				GLfloat* pNormal = pVertices + (vertex + lane) * vertexFloats + 3;
+				pNormal[0] = normals[0][lane];
+				pNormal[1] = normals[1][lane];
+				pNormal[2] = normals[2][lane];
+			}
+		}
+#endif
+
+		for (; vertex < end; vertex++)
+		{
+			GLfloat* pNormal = pVertices + vertex * vertexFloats + 3;
+			glm::vec3 normal(pNormal[0], pNormal[1], pNormal[2]);
+			float length = glm::length(normal);
+			normal = (length > 0.0f) ? normal / length : glm::vec3(0.0f, 1.0f, 0.0f);
+			pNormal[0] = normal.x;
+			pNormal[1] = normal.y;
+			pNormal[2] = normal.z;
+		}
+	}
+
+	// the overdraw order is kept while its ACMR stays within
+	// this factor of the plain cache order
+	const float g_OverdrawCacheSlack = 1.05f;
+
+	/****************************************************
+	 *  SkipDeadEnd()
+	 *
+	 *  This function is used for finding the vertex to fan
+	 *  from next once no vertex of the last fan has live
+	 *  triangles left: the most recent one on the dead end
+	 *  stack that still has some, or else the next such
+	 *  vertex in index order. Returns -1 when every
+	 *  triangle is out.
+	 ****************************************************/
+	GLint SkipDeadEnd(
+		const std::vector<GLuint>& liveTriangles,
+		std::vector<GLuint>& deadEnds,
+		GLuint& nextVertex)
+	{
+		while (false == deadEnds.empty())
+		{
+			GLuint vertex = deadEnds.back();
+			deadEnds.pop_back();
+			if (liveTriangles[vertex] > 0)
+			{
+				return((GLint)vertex);
+			}
+		}
+		while (nextVertex < (GLuint)liveTriangles.size())
+		{
+			if (liveTriangles[nextVertex] > 0)
+			{
+				return((GLint)nextVertex);
+			}
+			nextVertex++;
+		}
+		return(-1);
+	}
+
+	/****************************************************
+	 *  SortClustersForOverdraw()
+	 *
+	 *  This function is used for ordering the clusters of
+	 *  a triangle list, given by the triangles each one
+	 *  starts at, by how far they face out of the mesh:
+	 *  the dot of the area weighted cluster normal and the
+	 *  offset of the cluster centroid from the mesh
+	 *  centroid, largest first, so the clusters drawn
+	 *  first are the ones most likely to hide the rest.
+	 ****************************************************/
+	void SortClustersForOverdraw(
+		const GLuint* pIndices,
+		size_t triangleCount,
+		const GLfloat* pVertices,
+		int vertexFloats,
+		const std::vector<size_t>& clusterStarts,
+		std::vector<GLuint>& sortedIndices)
+	{
+		struct CLUSTER
+		{
+			size_t firstTriangle;
+			size_t triangleCount;
+			glm::vec3 centroid;
+			glm::vec3 normal;
+			float sortKey;
+		};
+
+		std::vector<CLUSTER> clusters(clusterStarts.size());
+		glm::vec3 meshCentroid(0.0f);
+		float meshArea = 0.0f;
+		for (size_t c = 0; c < clusters.size(); c++)
+		{
+			CLUSTER& cluster = clusters[c];
+			cluster.firstTriangle = clusterStarts[c];
+			cluster.triangleCount = ((c + 1 < clusterStarts.size()) ? clusterStarts[c + 1] : triangleCount) -
+				cluster.firstTriangle;
+			cluster.centroid = glm::vec3(0.0f);
+			cluster.normal = glm::vec3(0.0f);
+
+			float clusterArea = 0.0f;
+			for (size_t t = cluster.firstTriangle; t < cluster.firstTriangle + cluster.triangleCount; t++)
+			{
+				glm::vec3 corners[3];
+				for (int k = 0; k < 3; k++)
+				{
+					const GLfloat* pPosition = pVertices + (size_t)pIndices[3 * t + k] * vertexFloats;
+					corners[k] = glm::vec3(pPosition[0], pPosition[1], pPosition[2]);
+				}
+				// twice the area, pointing out of the front face
+				glm::vec3 areaNormal = glm::cross(corners[1] - corners[0], corners[2] - corners[0]);
+				float area = glm::length(areaNormal);
+				cluster.normal += areaNormal;
+				cluster.centroid += (corners[0] + corners[1] + corners[2]) * (area / 3.0f);
+				clusterArea += area;
+			}
+			meshCentroid += cluster.centroid;
+			meshArea += clusterArea;
+			if (clusterArea > 0.0f)
+			{
+				cluster.centroid /= clusterArea;
+			}
+		}
+		if (meshArea > 0.0f)
+		{
+			meshCentroid /= meshArea;
+		}
+
+		for (size_t c = 0; c < clusters.size(); c++)
+		{
+			clusters[c].sortKey = glm::dot(clusters[c].centroid - meshCentroid, clusters[c].normal);
+		}
+		std::stable_sort(clusters.begin(), clusters.end(),
+			[](const CLUSTER& a, const CLUSTER& b) { return(a.sortKey > b.sortKey); });
+
+		sortedIndices.clear();
+		sortedIndices.reserve(triangleCount * 3);
+		for (size_t c = 0; c < clusters.size(); c++)
+		{
+			sortedIndices.insert(sortedIndices.end(),
+				pIndices + clusters[c].firstTriangle * 3,
+				pIndices + (clusters[c].firstTriangle + clusters[c].triangleCount) * 3);
+		}
+	}
+
+	// least cosine between the normals of the two ends of an edge
+	// collapsed, and between a triangle facing before and after the
+	// collapse moves one of its corners
+	const double g_CollapseNormalDot = 0.5;
+	const double g_CollapseFacingDot = 0.2;
+
+	// symmetric 4x4 matrix of a quadric error, its upper triangle
+	// row by row, and the area of the triangle planes summed in
+	struct QUADRIC
+	{
+		double q[10];
+		double area;
+	};
+
+	// a collapse of the vertex from onto the vertex to, scored as
+	// the mean squared distance of the moved vertex to the planes of
+	// both; stale once either end has changed since
+	struct COLLAPSE
+	{
+		double cost;
+		GLuint from;
+		GLuint to;
+		GLuint fromVersion;
+		GLuint toVersion;
+		// the queue pops the cheapest first
+		bool operator<(const COLLAPSE& other) const { return(cost > other.cost); }
+	};
+
+	/****************************************************
+	 *  GetPosition()
+	 *
+	 *  This function is used for reading the position at
+	 *  the start of a vertex in double precision.
+	 ****************************************************/
+	glm::dvec3 GetPosition(const GLfloat* pVertices, int vertexFloats, GLuint vertex)
+	{
+		const GLfloat* pVertex = pVertices + (size_t)vertex * vertexFloats;
+		return(glm::dvec3(pVertex[0], pVertex[1], pVertex[2]));
+	}
+
+	/****************************************************
+	 *  AddPlaneQuadric()
+	 *
+	 *  This function is used for summing the squared
+	 *  distance to the plane of a triangle, weighted by
+	 *  its area, into a quadric.
+	 ****************************************************/
+	void AddPlaneQuadric(QUADRIC& quadric, const glm::dvec3& normal, double distance, double area)
+	{
+		const double plane[4] = { normal.x, normal.y, normal.z, distance };
+		int entry = 0;
+		for (int row = 0; row < 4; row++)
+		{
+			for (int column = row; column < 4; column++)
+			{
+				quadric.q[entry++] += area * plane[row] * plane[column];
+			}
+		}
+		quadric.area += area;
+	}
+
+	/****************************************************
+	 *  EvaluateQuadric()
+	 *
+	 *  This function is used for the summed, area weighted
+	 *  squared distance of a point to the planes of a
+	 *  quadric.
+	 ****************************************************/
+	double EvaluateQuadric(const QUADRIC& quadric, const glm::dvec3& point)
+	{
+		const double p[4] = { point.x, point.y, point.z, 1.0 };
+		double sum = 0.0;
+		int entry = 0;
+		for (int row = 0; row < 4; row++)
+		{
+			for (int column = row; column < 4; column++)
+			{
+				double term = quadric.q[entry++] * p[row] * p[column];
+				sum += (row == column) ? term : 2.0 * term;
+			}
+		}
+		return(glm::max(sum, 0.0));
+	}
+}
+
+/***********************************************************
+ *  AnalyzeCache()
+ *
+ *  This method is used for counting the vertices a FIFO
+ *  cache of cacheSize entries would transform for a
+ *  triangle list, per triangle (ACMR) and per vertex the
+ *  list uses (ATVR).
+ ***********************************************************/
+MeshOptimizer::CACHE_STATS MeshOptimizer::AnalyzeCache(
+	const GLuint* pIndices,
+	size_t indexCount,
+	GLuint vertexCount,
+	int cacheSize)
+{
+	CACHE_STATS stats = { 0.0f, 0.0f };
+	const size_t triangleCount = indexCount / 3;
+	if ((0 == triangleCount) || (0 == vertexCount))
+	{
+		return(stats);
+	}
+
+	// a vertex is still cached while fewer than cacheSize others
+	// went in after it; a stamp of 0 is never cached
+	std::vector<GLuint> cacheStamp(vertexCount, 0);
+	GLuint time = (GLuint)cacheSize + 1;
+	size_t misses = 0;
+	size_t usedVertices = 0;
+	for (size_t i = 0; i < triangleCount * 3; i++)
+	{
+		GLuint vertex = pIndices[i];
+		if (0 == cacheStamp[vertex])
+		{
+			usedVertices++;
+		}
+		if (time - cacheStamp[vertex] > (GLuint)cacheSize)
+		{
+			cacheStamp[vertex] = time++;
+			misses++;
+		}
+	}
+
+	stats.acmr = (float)misses / (float)triangleCount;
+	stats.atvr = (float)misses / (float)usedVertices;
+	return(stats);
+}
+
+/***********************************************************
+ *  OptimizeTriangles()
+ *
+ *  This method is used for reordering a triangle list with
+ *  Tipsify: it fans out every remaining triangle around one
+ *  vertex, then moves on to the vertex of that fan that is
+ *  oldest in the cache while its triangles would still hit
+ *  it, falling back to a recent dead end otherwise. Each
+ *  restart from a vertex no longer cached begins a new
+ *  cluster, and with bOverdraw the clusters are sorted to
+ *  draw the outward facing ones first. A list the order
+ *  does not improve is left as it was.
+ ***********************************************************/
+void MeshOptimizer::OptimizeTriangles(
+	GLuint* pIndices,
+	size_t indexCount,
+	GLuint vertexCount,
+	const GLfloat* pVertices,
+	int vertexFloats,
+	bool bOverdraw,
+	int cacheSize)
+{
+	const size_t triangleCount = indexCount / 3;
+	if ((triangleCount < 2) || (0 == vertexCount))
+	{
+		return;
+	}
+
+	// the triangles using each vertex, as spans of one list
+	std::vector<GLuint> adjacencyStart(vertexCount + 1, 0);
+	for (size_t i = 0; i < triangleCount * 3; i++)
+	{
+		adjacencyStart[pIndices[i] + 1]++;
+	}
+	for (GLuint vertex = 0; vertex < vertexCount; vertex++)
+	{
+		adjacencyStart[vertex + 1] += adjacencyStart[vertex];
+	}
+	std::vector<GLuint> adjacency(triangleCount * 3);
+	std::vector<GLuint> adjacencyFill(adjacencyStart.begin(), adjacencyStart.end() - 1);
+	for (size_t i = 0; i < triangleCount * 3; i++)
+	{
+		adjacency[adjacencyFill[pIndices[i]]++] = (GLuint)(i / 3);
+	}
+
+	std::vector<GLuint> liveTriangles(vertexCount);
+	for (GLuint vertex = 0; vertex < vertexCount; vertex++)
+	{
+		liveTriangles[vertex] = adjacencyStart[vertex + 1] - adjacencyStart[vertex];
+	}
+
+	std::vector<GLuint> cacheStamp(vertexCount, 0);
+	GLuint time = (GLuint)cacheSize + 1;
+	std::vector<bool> emitted(triangleCount, false);
+	std::vector<GLuint> deadEnds;
+	std::vector<GLuint> candidates;
+	std::vector<GLuint> order;
+	std::vector<size_t> clusterStarts;
+	order.reserve(triangleCount);
+	deadEnds.reserve(triangleCount * 3);
+
+	GLuint nextVertex = 0;
+	GLint fanVertex = SkipDeadEnd(liveTriangles, deadEnds, nextVertex);
+	clusterStarts.push_back(0);
+	while (fanVertex >= 0)
+	{
+		candidates.clear();
+		for (GLuint a = adjacencyStart[fanVertex]; a < adjacencyStart[fanVertex + 1]; a++)
+		{
+			GLuint triangle = adjacency[a];
+			if (true == emitted[triangle])
+			{
+				continue;
+			}
+			emitted[triangle] = true;
+			order.push_back(triangle);
+			for (int k = 0; k < 3; k++)
+			{
+				GLuint vertex = pIndices[3 * triangle + k];
+				deadEnds.push_back(vertex);
+				candidates.push_back(vertex);
+				liveTriangles[vertex]--;
+				if (time - cacheStamp[vertex] > (GLuint)cacheSize)
+				{
+					cacheStamp[vertex] = time++;
+				}
+			}
+		}
+
+		// the oldest candidate whose live triangles still find it
+		// cached, counting two new vertices for each of them
+		GLint bestVertex = -1;
+		GLint bestPriority = -1;
+		for (size_t c = 0; c < candidates.size(); c++)
+		{
+			GLuint vertex = candidates[c];
+			if (0 == liveTriangles[vertex])
+			{
+				continue;
+			}
+			GLint priority = 0;
+			if (time - cacheStamp[vertex] + 2 * liveTriangles[vertex] <= (GLuint)cacheSize)
+			{
+				priority = (GLint)(time - cacheStamp[vertex]);
+			}
+			if (priority > bestPriority)
+			{
+				bestPriority = priority;
+				bestVertex = (GLint)vertex;
+			}
+		}
+		if (bestVertex < 0)
+		{
+			bestVertex = SkipDeadEnd(liveTriangles, deadEnds, nextVertex);
+			if ((bestVertex >= 0) && (time - cacheStamp[bestVertex] > (GLuint)cacheSize))
+			{
+				clusterStarts.push_back(order.size());
+			}
+		}
+		fanVertex = bestVertex;
+	}
+
+	// lists already ordered well, like rings of fewer vertices than
+	// the cache, can come out worse; those keep their order
+	std::vector<GLuint> reordered;
+	reordered.reserve(triangleCount * 3);
+	for (size_t t = 0; t < order.size(); t++)
+	{
+		reordered.insert(reordered.end(), pIndices + 3 * order[t], pIndices + 3 * order[t] + 3);
+	}
+	CACHE_STATS originalOrder = AnalyzeCache(pIndices, triangleCount * 3, vertexCount, cacheSize);
+	CACHE_STATS cacheOrder = AnalyzeCache(&reordered[0], reordered.size(), vertexCount, cacheSize);
+	if (cacheOrder.acmr >= originalOrder.acmr)
+	{
+		return;
+	}
+	std::copy(reordered.begin(), reordered.end(), pIndices);
+
+	if ((true == bOverdraw) && (NULL != pVertices) && (clusterStarts.size() > 1))
+	{
+		SortClustersForOverdraw(pIndices, triangleCount, pVertices, vertexFloats, clusterStarts, reordered);
+		CACHE_STATS overdrawOrder = AnalyzeCache(&reordered[0], reordered.size(), vertexCount, cacheSize);
+		if (overdrawOrder.acmr <= cacheOrder.acmr * g_OverdrawCacheSlack)
+		{
+			std::copy(reordered.begin(), reordered.end(), pIndices);
+		}
+	}
+}
+
+/***********************************************************
+ *  OptimizeVertexFetch()
+ *
+ *  This method is used for renumbering the vertices of a
+ *  triangle list by their first use, so the vertex fetches
+ *  of the reordered triangles walk through memory in order.
+ ***********************************************************/
+void MeshOptimizer::OptimizeVertexFetch(
+	GLfloat* pVertices,
+	GLuint vertexCount,
+	int vertexFloats,
+	GLuint* pIndices,
+	size_t indexCount)
+{
+	if ((0 == vertexCount) || (0 == indexCount))
+	{
+		return;
+	}
+
+	const GLuint unused = 0xFFFFFFFF;
+	std::vector<GLuint> remap(vertexCount, unused);
+	GLuint nextVertex = 0;
+	for (size_t i = 0; i < indexCount; i++)
+	{
+		GLuint& newVertex = remap[pIndices[i]];
+		if (unused == newVertex)
+		{
+			newVertex = nextVertex++;
+		}
+		pIndices[i] = newVertex;
+	}
+	for (GLuint vertex = 0; vertex < vertexCount; vertex++)
+	{
+		if (unused == remap[vertex])
+		{
+			remap[vertex] = nextVertex++;
+		}
+	}
+
+	std::vector<GLfloat> source(pVertices, pVertices + (size_t)vertexCount * vertexFloats);
+	for (GLuint vertex = 0; vertex < vertexCount; vertex++)
+	{
+		std::copy(&source[(size_t)vertex * vertexFloats], &source[(size_t)vertex * vertexFloats] + vertexFloats,
+			pVertices + (size_t)remap[vertex] * vertexFloats);
+	}
+}
+
+/***********************************************************
+ *  SimplifyMesh()
+ *
+ *  This method is used for building a coarser version of a
+ *  triangle list by vertex clustering: the bounds are cut
+ *  into cells gridCells wide along their longest side, the
+ *  vertices of a cell facing the same way are merged into
+ *  one at their average position and normal, and the
+ *  triangles left without an area, or repeating another,
+ *  are dropped. Vertices facing apart stay apart, so hard
+ *  edges keep their normals. Returns the triangles left.
+ ***********************************************************/
+size_t MeshOptimizer::SimplifyMesh(
+	const GLfloat* pVertices,
+	GLuint vertexCount,
+	int vertexFloats,
+	const GLuint* pIndices,
+	size_t indexCount,
+	int gridCells,
+	std::vector<GLfloat>& simplifiedVertices,
+	std::vector<GLuint>& simplifiedIndices)
+{
+	simplifiedVertices.clear();
+	simplifiedIndices.clear();
+	if ((0 == vertexCount) || (indexCount < 3) || (gridCells < 1))
+	{
+		return(0);
+	}
+
+	glm::vec3 minXYZ(pVertices[0], pVertices[1], pVertices[2]);
+	glm::vec3 maxXYZ = minXYZ;
+	for (GLuint vertex = 1; vertex < vertexCount; vertex++)
+	{
+		const GLfloat* pVertex = pVertices + (size_t)vertex * vertexFloats;
+		glm::vec3 position(pVertex[0], pVertex[1], pVertex[2]);
+		minXYZ = glm::min(minXYZ, position);
+		maxXYZ = glm::max(maxXYZ, position);
+	}
+	glm::vec3 extent = maxXYZ - minXYZ;
+	float cellSize = glm::max(glm::max(extent.x, extent.y), extent.z) / (float)gridCells;
+	if (cellSize <= 0.0f)
+	{
+		return(0);
+	}
+
+	// the cluster of each vertex, keyed by its cell and by the
+	// axis its normal leans along the most
+	std::unordered_map<uint64_t, GLuint> clusters;
+	std::vector<GLuint> remap(vertexCount);
+	std::vector<GLuint> clusterSizes;
+	for (GLuint vertex = 0; vertex < vertexCount; vertex++)
+	{
+		const GLfloat* pVertex = pVertices + (size_t)vertex * vertexFloats;
+		glm::vec3 cell = glm::min(glm::floor((glm::vec3(pVertex[0], pVertex[1], pVertex[2]) - minXYZ) / cellSize),
+			glm::vec3((float)(gridCells - 1)));
+		glm::vec3 normal(pVertex[3], pVertex[4], pVertex[5]);
+		glm::vec3 lean = glm::abs(normal);
+		int axis = ((lean.x >= lean.y) && (lean.x >= lean.z)) ? 0 : ((lean.y >= lean.z) ? 1 : 2);
+		int facing = 2 * axis + ((normal[axis] < 0.0f) ? 1 : 0);
+		uint64_t key = ((uint64_t)cell.x << 42) | ((uint64_t)cell.y << 22) | ((uint64_t)cell.z << 2);
+		key = key * 8 + (uint64_t)facing;
+
+		std::unordered_map<uint64_t, GLuint>::iterator found = clusters.find(key);
+		if (found == clusters.end())
+		{
+			// the cluster starts as the vertex, keeping its texture
+			// coordinates and any attributes past the normal
+			GLuint cluster = (GLuint)clusterSizes.size();
+			found = clusters.insert(std::make_pair(key, cluster)).first;
+			simplifiedVertices.insert(simplifiedVertices.end(), pVertex, pVertex + vertexFloats);
+			clusterSizes.push_back(1);
+		}
+		else
+		{
+			GLfloat* pCluster = &simplifiedVertices[(size_t)found->second * vertexFloats];
+			for (int i = 0; i < 6; i++)
+			{
+				pCluster[i] += pVertex[i];
+			}
+			clusterSizes[found->second]++;
+		}
+		remap[vertex] = found->second;
+	}
+
+	for (size_t cluster = 0; cluster < clusterSizes.size(); cluster++)
+	{
+		GLfloat* pCluster = &simplifiedVertices[cluster * vertexFloats];
+		glm::vec3 position = glm::vec3(pCluster[0], pCluster[1], pCluster[2]) / (float)clusterSizes[cluster];
+		glm::vec3 normal(pCluster[3], pCluster[4], pCluster[5]);
+		normal = (glm::length(normal) > 0.0f) ? glm::normalize(normal) : glm::vec3(0.0f, 1.0f, 0.0f);
+		pCluster[0] = position.x;
+		pCluster[1] = position.y;
+		pCluster[2] = position.z;
+		pCluster[3] = normal.x;
+		pCluster[4] = normal.y;
+		pCluster[5] = normal.z;
+	}
+
+	// each triangle is keyed starting from its lowest index, which
+	// keeps its winding; the key holds 21 bits of each index
+	const bool bDropRepeats = (clusterSizes.size() < ((size_t)1 << 21));
+	std::unordered_set<uint64_t> triangles;
+	for (size_t i = 0; i + 2 < indexCount; i += 3)
+	{
+		GLuint a = remap[pIndices[i]];
+		GLuint b = remap[pIndices[i + 1]];
+		GLuint c = remap[pIndices[i + 2]];
+		if ((a == b) || (b == c) || (a == c))
+		{
+			continue;
+		}
+		while ((a > b) || (a > c))
+		{
+			GLuint first = a;
+			a = b;
+			b = c;
+			c = first;
+		}
+		uint64_t key = ((uint64_t)a << 42) | ((uint64_t)b << 21) | (uint64_t)c;
+		if ((bDropRepeats == true) && (triangles.insert(key).second == false))
+		{
+			continue;
+		}
+		simplifiedIndices.push_back(a);
+		simplifiedIndices.push_back(b);
+		simplifiedIndices.push_back(c);
+	}
+	return(simplifiedIndices.size() / 3);
+}
+
+/***********************************************************
+ *  SimplifyQuadric()
+ *
+ *  This method is used for building a coarser version of a
+ *  triangle list by edge collapses ordered by the quadric
+ *  error metric of "Surface Simplification Using Quadric
+ *  Error Metrics", Garland and Heckbert 1997. Every vertex
+ *  sums the planes of its triangles, and the collapse that
+ *  moves a vertex the least off the planes of both ends of
+ *  its edge goes first, until the list is down to
+ *  targetIndexCount. A vertex only collapses onto another
+ *  vertex of the mesh, so the ones kept keep their normal
+ *  and texture coordinates. Vertices on an open edge, or
+ *  sharing their position with another vertex, as along a
+ *  seam of the texture coordinates or a crease split into
+ *  two normals, never move, and a collapse that would turn
+ *  a triangle over or join ends facing apart is skipped.
+ *  error is the largest root mean squared distance of a
+ *  collapse, in the units of the positions. Returns the
+ *  triangles left.
+ ***********************************************************/
+size_t MeshOptimizer::SimplifyQuadric(
+	const GLfloat* pVertices,
+	GLuint vertexCount,
+	int vertexFloats,
+	const GLuint* pIndices,
+	size_t indexCount,
+	size_t targetIndexCount,
+	std::vector<GLfloat>& simplifiedVertices,
+	std::vector<GLuint>& simplifiedIndices,
+	float& error)
+{
+	simplifiedVertices.clear();
+	simplifiedIndices.clear();
+	error = 0.0f;
+	size_t triangleCount = indexCount / 3;
+	if ((0 == vertexCount) || (0 == triangleCount))
+	{
+		return(0);
+	}
+
+	// the planes of the triangles around each vertex
+	std::vector<GLuint> corners(pIndices, pIndices + triangleCount * 3);
+	std::vector<bool> bAlive(triangleCount, true);
+	std::vector<std::vector<GLuint> > vertexTriangles(vertexCount);
+	QUADRIC emptyQuadric = { { 0.0 }, 0.0 };
+	std::vector<QUADRIC> quadrics(vertexCount, emptyQuadric);
+	size_t aliveTriangles = 0;
+	for (size_t t = 0; t < triangleCount; t++)
+	{
+		const GLuint* pCorner = &corners[t * 3];
+		if ((pCorner[0] >= vertexCount) || (pCorner[1] >= vertexCount) || (pCorner[2] >= vertexCount) ||
+			(pCorner[0] == pCorner[1]) || (pCorner[1] == pCorner[2]) || (pCorner[0] == pCorner[2]))
+		{
+			bAlive[t] = false;
+			continue;
+		}
+		aliveTriangles++;
+
+		glm::dvec3 a = GetPosition(pVertices, vertexFloats, pCorner[0]);
+		glm::dvec3 normal = glm::cross(GetPosition(pVertices, vertexFloats, pCorner[1]) - a,
+			GetPosition(pVertices, vertexFloats, pCorner[2]) - a);
+		double length = glm::length(normal);
+		for (int c = 0; c < 3; c++)
+		{
+			vertexTriangles[pCorner[c]].push_back((GLuint)t);
+			if (length > 0.0)
+			{
+				AddPlaneQuadric(quadrics[pCorner[c]], normal / length, -glm::dot(normal / length, a), 0.5 * length);
+			}
+		}
+	}
+
+	// an edge used by one triangle, or by more than two, is open
+	// or joins separate sheets; its vertices stay where they are
+	std::vector<bool> bLocked(vertexCount, false);
+	std::unordered_map<uint64_t, GLuint> edgeUses;
+	for (size_t t = 0; t < triangleCount; t++)
+	{
+		for (int c = 0; (c < 3) && (bAlive[t] == true); c++)
+		{
+			GLuint a = corners[t * 3 + c];
+			GLuint b = corners[t * 3 + (c + 1) % 3];
+			edgeUses[((uint64_t)std::min(a, b) << 32) | (uint64_t)std::max(a, b)]++;
+		}
+	}
+	for (std::unordered_map<uint64_t, GLuint>::const_iterator edge = edgeUses.begin(); edge != edgeUses.end(); ++edge)
+	{
+		if (edge->second != 2)
+		{
+			bLocked[(GLuint)(edge->first >> 32)] = true;
+			bLocked[(GLuint)(edge->first & 0xFFFFFFFF)] = true;
+		}
+	}
+	// so do the vertices a seam splits, found next to each other
+	// once sorted by position
+	std::vector<GLuint> byPosition(vertexCount);
+	for (GLuint vertex = 0; vertex < vertexCount; vertex++)
+	{
+		byPosition[vertex] = vertex;
+	}
+	std::sort(byPosition.begin(), byPosition.end(), [pVertices, vertexFloats](GLuint a, GLuint b)
+		{
+			const GLfloat* pA = pVertices + (size_t)a * vertexFloats;
+			const GLfloat* pB = pVertices + (size_t)b * vertexFloats;
+			return(std::lexicographical_compare(pA, pA + 3, pB, pB + 3));
+		});
+	for (GLuint i = 1; i < vertexCount; i++)
+	{
+		const GLfloat* pA = pVertices + (size_t)byPosition[i - 1] * vertexFloats;
+		const GLfloat* pB = pVertices + (size_t)byPosition[i] * vertexFloats;
+		if ((pA[0] == pB[0]) && (pA[1] == pB[1]) && (pA[2] == pB[2]))
+		{
+			bLocked[byPosition[i - 1]] = true;
+			bLocked[byPosition[i]] = true;
+		}
+	}
+
+	// every edge is queued from each end that may move
+	std::vector<GLuint> versions(vertexCount, 0);
+	std::vector<bool> bRemoved(vertexCount, false);
+	std::priority_queue<COLLAPSE> collapses;
+	auto queueCollapse = [&](GLuint from, GLuint to)
+	{
+		if (bLocked[from] == true)
+		{
+			return;
+		}
+		glm::dvec3 target = GetPosition(pVertices, vertexFloats, to);
+		double area = quadrics[from].area + quadrics[to].area;
+		COLLAPSE collapse;
+		collapse.cost = (area > 0.0) ?
+			(EvaluateQuadric(quadrics[from], target) + EvaluateQuadric(quadrics[to], target)) / area : 0.0;
+		collapse.from = from;
+		collapse.to = to;
+		collapse.fromVersion = versions[from];
+		collapse.toVersion = versions[to];
+		collapses.push(collapse);
+	};
+	for (size_t t = 0; t < triangleCount; t++)
+	{
+		for (int c = 0; (c < 3) && (bAlive[t] == true); c++)
+		{
+			GLuint a = corners[t * 3 + c];
+			GLuint b = corners[t * 3 + (c + 1) % 3];
+			queueCollapse(a, b);
+			queueCollapse(b, a);
+		}
+	}
+
+	double largestCost = 0.0;
+	while ((aliveTriangles * 3 > targetIndexCount) && (collapses.empty() == false))
+	{
+		COLLAPSE collapse = collapses.top();
+		collapses.pop();
+		GLuint from = collapse.from;
+		GLuint to = collapse.to;
+		if ((bRemoved[from] == true) || (bRemoved[to] == true) ||
+			(collapse.fromVersion != versions[from]) || (collapse.toVersion != versions[to]))
+		{
+			continue;
+		}
+
+		// the ends have to face alike, and no triangle moved by the
+		// collapse may turn over
+		const GLfloat* pFrom = pVertices + (size_t)from * vertexFloats;
+		const GLfloat* pTo = pVertices + (size_t)to * vertexFloats;
+		bool bValid = (glm::dot(glm::dvec3(pFrom[3], pFrom[4], pFrom[5]), glm::dvec3(pTo[3], pTo[4], pTo[5])) >=
+			g_CollapseNormalDot);
+		glm::dvec3 target = GetPosition(pVertices, vertexFloats, to);
+		for (size_t i = 0; (i < vertexTriangles[from].size()) && (bValid == true); i++)
+		{
+			GLuint t = vertexTriangles[from][i];
+			const GLuint* pCorner = &corners[(size_t)t * 3];
+			if ((bAlive[t] == false) || (pCorner[0] == to) || (pCorner[1] == to) || (pCorner[2] == to))
+			{
+				continue;
+			}
+			glm::dvec3 before[3];
+			glm::dvec3 after[3];
+			for (int c = 0; c < 3; c++)
+			{
+				before[c] = GetPosition(pVertices, vertexFloats, pCorner[c]);
+				after[c] = (pCorner[c] == from) ? target : before[c];
+			}
+			glm::dvec3 beforeNormal = glm::cross(before[1] - before[0], before[2] - before[0]);
+			glm::dvec3 afterNormal = glm::cross(after[1] - after[0], after[2] - after[0]);
+			double lengths = glm::length(beforeNormal) * glm::length(afterNormal);
+			bValid = (lengths > 0.0) && (glm::dot(beforeNormal, afterNormal) >= g_CollapseFacingDot * lengths);
+		}
+		if (bValid == false)
+		{
+			continue;
+		}
+
+		// the triangles on the edge go, the others move to the end
+		// kept, which takes over the planes of both
+		for (size_t i = 0; i < vertexTriangles[from].size(); i++)
+		{
+			GLuint t = vertexTriangles[from][i];
+			GLuint* pCorner = &corners[(size_t)t * 3];
+			if (bAlive[t] == false)
+			{
+				continue;
+			}
+			if ((pCorner[0] == to) || (pCorner[1] == to) || (pCorner[2] == to))
+			{
+				bAlive[t] = false;
+				aliveTriangles--;
+				continue;
+			}
+			for (int c = 0; c < 3; c++)
+			{
+				pCorner[c] = (pCorner[c] == from) ? to : pCorner[c];
+			}
+			vertexTriangles[to].push_back(t);
+		}
+		vertexTriangles[from].clear();
+		bRemoved[from] = true;
+		for (int i = 0; i < 10; i++)
+		{
+			quadrics[to].q[i] += quadrics[from].q[i];
+		}
+		quadrics[to].area += quadrics[from].area;
+		versions[to]++;
+		largestCost = glm::max(largestCost, collapse.cost);
+
+		// the edges of the end kept are scored again
+		for (size_t i = 0; i < vertexTriangles[to].size(); i++)
+		{
+			GLuint t = vertexTriangles[to][i];
+			for (int c = 0; (c < 3) && (bAlive[t] == true); c++)
+			{
+				GLuint other = corners[(size_t)t * 3 + c];
+				if (other != to)
+				{
+					queueCollapse(to, other);
+					queueCollapse(other, to);
+				}
+			}
+		}
+	}
+	error = (float)glm::sqrt(largestCost);
+
+	// the vertices left are copied in the order the triangles use
+	// them
+	const GLuint unused = 0xFFFFFFFF;
+	std::vector<GLuint> remap(vertexCount, unused);
+	GLuint nextVertex = 0;
+	for (size_t t = 0; t < triangleCount; t++)
+	{
+		for (int c = 0; (c < 3) && (bAlive[t] == true); c++)
+		{
+			GLuint vertex = corners[t * 3 + c];
+			if (remap[vertex] == unused)
+			{
+				remap[vertex] = nextVertex++;
+				const GLfloat* pVertex = pVertices + (size_t)vertex * vertexFloats;
+				simplifiedVertices.insert(simplifiedVertices.end(), pVertex, pVertex + vertexFloats);
+			}
+			simplifiedIndices.push_back(remap[vertex]);
+		}
+	}
+	return(simplifiedIndices.size() / 3);
+}
+
+/***********************************************************
+ *  BuildMeshlets()
+ *
+ *  This method is used for cutting a triangle list into
+ *  meshlets, taking the triangles in the order they are in
+ *  so each meshlet stays one index range of the list and
+ *  the cache order keeps its triangles close together. A
+ *  meshlet ends when the next triangle would pass either
+ *  limit. The bounding sphere is centered on the box of
+ *  the vertices, and the normal cone follows "Optimizing
+ *  the Graphics Pipeline with Compute", Wihlidal 2016: the
+ *  axis is the average of the triangle normals and the
+ *  cutoff the sine of the widest angle between the two,
+ *  left at 1, never culled, once that angle nears 90
+ *  degrees.
+ ***********************************************************/
+size_t MeshOptimizer::BuildMeshlets(
+	const GLfloat* pVertices,
+	int vertexFloats,
+	const GLuint* pIndices,
+	size_t indexCount,
+	std::vector<MESHLET>& meshlets,
+	std::vector<GLuint>& meshletVertices,
+	std::vector<GLuint>& meshletTriangles)
+{
+	size_t firstMeshlet = meshlets.size();
+	size_t triangle = 0;
+	size_t triangleCount = indexCount / 3;
+	while (triangle < triangleCount)
+	{
+		MESHLET meshlet;
+		meshlet.firstIndex = (GLuint)(triangle * 3);
+		meshlet.triangleCount = 0;
+		meshlet.firstVertex = (GLuint)meshletVertices.size();
+		meshlet.vertexCount = 0;
+		meshlet.firstTriangle = (GLuint)meshletTriangles.size();
+		meshlet.baseVertex = 0;
+		meshlet.padding[0] = 0;
+		meshlet.padding[1] = 0;
+
+		GLuint localVertices[MESHLET_MAX_VERTICES];
+		while ((triangle < triangleCount) && (meshlet.triangleCount < (GLuint)MESHLET_MAX_TRIANGLES))
+		{
+			// the meshlet numbers of the corners, new ones past the end
+			GLuint corners[3];
+			GLuint vertexCount = meshlet.vertexCount;
+			bool bFits = true;
+			for (int corner = 0; (corner < 3) && (bFits == true); corner++)
+			{
+				GLuint vertex = pIndices[triangle * 3 + corner];
+				GLuint local = 0;
+				while ((local < vertexCount) && (localVertices[local] != vertex))
+				{
+					local++;
+				}
+				if (local == vertexCount)
+				{
+					bFits = (vertexCount < (GLuint)MESHLET_MAX_VERTICES);
+					if (bFits == true)
+					{
+						localVertices[vertexCount++] = vertex;
+					}
+				}
+				corners[corner] = local;
+			}
+			if (bFits == false)
+			{
+				break;
+			}
+
+			meshlet.vertexCount = vertexCount;
+			meshletTriangles.push_back(corners[0] | (corners[1] << 8) | (corners[2] << 16));
+			meshlet.triangleCount++;
+			triangle++;
+		}
+		meshletVertices.insert(meshletVertices.end(), localVertices, localVertices + meshlet.vertexCount);
+
+		glm::vec3 minXYZ(0.0f);
+		glm::vec3 maxXYZ(0.0f);
+		for (GLuint local = 0; local < meshlet.vertexCount; local++)
+		{
+			const GLfloat* pVertex = pVertices + (size_t)localVertices[local] * vertexFloats;
+			glm::vec3 position(pVertex[0], pVertex[1], pVertex[2]);
+			minXYZ = (local == 0) ? position : glm::min(minXYZ, position);
+			maxXYZ = (local == 0) ? position : glm::max(maxXYZ, position);
+		}
+		glm::vec3 center = 0.5f * (minXYZ + maxXYZ);
+		float radius = 0.0f;
+		for (GLuint local = 0; local < meshlet.vertexCount; local++)
+		{
+			const GLfloat* pVertex = pVertices + (size_t)localVertices[local] * vertexFloats;
+			radius = glm::max(radius, glm::length(glm::vec3(pVertex[0], pVertex[1], pVertex[2]) - center));
+		}
+		meshlet.sphere = glm::vec4(center, radius);
+
+		// the normals of the triangles with an area, in winding order
+		std::vector<glm::vec3> normals;
+		glm::vec3 axis(0.0f);
+		for (GLuint i = 0; i < meshlet.triangleCount; i++)
+		{
+			const GLuint* pTriangle = pIndices + meshlet.firstIndex + i * 3;
+			const GLfloat* pA = pVertices + (size_t)pTriangle[0] * vertexFloats;
+			const GLfloat* pB = pVertices + (size_t)pTriangle[1] * vertexFloats;
+			const GLfloat* pC = pVertices + (size_t)pTriangle[2] * vertexFloats;
+			glm::vec3 a(pA[0], pA[1], pA[2]);
+			glm::vec3 normal = glm::cross(glm::vec3(pB[0], pB[1], pB[2]) - a, glm::vec3(pC[0], pC[1], pC[2]) - a);
+			float length = glm::length(normal);
+			if (length > 0.0f)
+			{
+				normals.push_back(normal / length);
+				axis += normals.back();
+			}
+		}
+		meshlet.cone = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
+		if ((normals.empty() == false) && (glm::length(axis) > 0.0f))
+		{
+			axis = glm::normalize(axis);
+			float minDot = 1.0f;
+			for (size_t i = 0; i < normals.size(); i++)
+			{
+				minDot = glm::min(minDot, glm::dot(normals[i], axis));
+			}
+			// past about 84 degrees the cone can hardly be culled
+			float cutoff = (minDot <= 0.1f) ? 1.0f : glm::sqrt(1.0f - minDot * minDot);
+			meshlet.cone = glm::vec4(axis, cutoff);
+		}
+
+		meshlets.push_back(meshlet);
+	}
+	return(meshlets.size() - firstMeshlet);
+}
+
+/***********************************************************
+ *  GenerateNormals()
+ *
+ *  This method is used for computing the smooth normals of
+ *  a mesh without any. The face normals of every triangle
+ *  are computed first, split between threads for large
+ *  meshes, then summed into their corners in triangle
+ *  order, which stays on one thread since triangles share
+ *  vertices, and the sums are normalized, split again. The
+ *  cross products are left unnormalized, so each face
+ *  weighs in by its area.
+ ***********************************************************/
+void MeshOptimizer::GenerateNormals(
+	GLfloat* pVertices,
+	GLuint vertexCount,
+	int vertexFloats,
+	const GLuint* pIndices,
+	size_t indexCount)
+{
+	size_t triangleCount = indexCount / 3;
+	std::vector<float> faceNormals(triangleCount * 3);
+	float* pNormalX = faceNormals.data();
+	float* pNormalY = pNormalX + triangleCount;
+	float* pNormalZ = pNormalY + triangleCount;
+	ParallelFor(triangleCount, [=](size_t first, size_t end)
+	{
+		ComputeFaceNormals(pVertices, vertexFloats, pIndices, first, end, pNormalX, pNormalY, pNormalZ);
+	});
+
+	for (GLuint vertex = 0; vertex < vertexCount; vertex++)
+	{
+		GLfloat* pNormal = pVertices + (size_t)vertex * vertexFloats + 3;
+		pNormal[0] = 0.0f;
+		pNormal[1] = 0.0f;
+		pNormal[2] = 0.0f;
+	}
+	for (size_t triangle = 0; triangle < triangleCount; triangle++)
+	{
+		for (int corner = 0; corner < 3; corner++)
+		{
+			GLfloat* pNormal = pVertices + (size_t)pIndices[triangle * 3 + corner] * vertexFloats + 3;
+			pNormal[0] += pNormalX[triangle];
+			pNormal[1] += pNormalY[triangle];
+			pNormal[2] += pNormalZ[triangle];
+		}
+	}
+
+	ParallelFor((size_t)vertexCount, [=](size_t first, size_t end)
+	{
+		NormalizeVertexNormals(pVertices, vertexFloats, first, end);
+	});
+}
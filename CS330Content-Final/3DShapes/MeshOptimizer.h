@@ -0,0 +1,152 @@
+///////////////////////////////////////////////////////////////////////////////
+// meshoptimizer.h
+// ============
+// reorder indexed meshes for the post-transform vertex cache
+//
+//  Orders the triangles of a mesh with Tipsify (Sander, Nehab and
+//  Barczak, 2007) so the vertices they share are still in the cache
+//  of transformed vertices, optionally sorts the clusters it produces
+//  so the outward facing ones draw first and hide the others, then
+//  renumbers the vertices in the order the triangles first use them
+//  so they are fetched front to back. Works on the interleaved
+//  vertices and 32-bit indices of any mesh, generated or imported,
+//  builds coarser LOD levels of the imported ones, by clustering or
+//  by quadric edge collapses, splits them into the small clusters of
+//  triangles the meshlet culling tests one at a time, and computes the
+//  normals of the ones without.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <vector>
+
+/***********************************************************
+ *  MeshOptimizer
+ *
+ *  This class contains the load time passes reordering the
+ *  triangles and vertices of an indexed triangle list, and
+ *  the FIFO cache model measuring the result.
+ ***********************************************************/
+class MeshOptimizer
+{
+public:
+	// entries of the modeled post-transform cache
+	static const int CACHE_SIZE = 16;
+
+	// quality of an index order against the modeled cache
+	struct CACHE_STATS
+	{
+		float acmr;		// vertices transformed per triangle, 0.5 at best
+		float atvr;		// vertices transformed per vertex used, 1.0 at best
+	};
+
+	// limits of a meshlet, the vertices and triangles one mesh shader
+	// work group outputs; 124 triangles keep the packed triangle list
+	// of a full meshlet a multiple of 16 bytes
+	static const int MESHLET_MAX_VERTICES = 64;
+	static const int MESHLET_MAX_TRIANGLES = 124;
+
+	// a run of consecutive triangles of a list and the volumes its
+	// culling tests, laid out as the std430 array the shaders read
+	struct MESHLET
+	{
+		GLuint firstIndex;		// of its first triangle in the index list
+		GLuint triangleCount;
+		GLuint firstVertex;		// of its vertices in the meshlet vertex list
+		GLuint vertexCount;
+		GLuint firstTriangle;	// of its triangles in the packed triangle list
+		GLint baseVertex;		// added to its indices, set by the owner of the list
+		GLuint padding[2];
+		glm::vec4 sphere;		// xyz center, w radius
+		glm::vec4 cone;			// xyz axis the triangles face, w cutoff; 1 is never culled
+	};
+
+	// run the modeled FIFO cache over a triangle list whose indices
+	// are below vertexCount
+	static CACHE_STATS AnalyzeCache(
+		const GLuint* pIndices,
+		size_t indexCount,
+		GLuint vertexCount,
+		int cacheSize = CACHE_SIZE);
+
+	// reorder the triangles of a list in place for the cache; with
+	// bOverdraw the clusters are also sorted for less overdraw from
+	// the positions at the start of each vertexFloats vertex, as long
+	// as the cache order does not suffer for it; the order of the
+	// corners of each triangle, and so its winding, is kept
+	static void OptimizeTriangles(
+		GLuint* pIndices,
+		size_t indexCount,
+		GLuint vertexCount,
+		const GLfloat* pVertices,
+		int vertexFloats,
+		bool bOverdraw,
+		int cacheSize = CACHE_SIZE);
+
+	// renumber the vertices in the order the triangles first use
+	// them, moving their data to match; unused vertices go last
+	static void OptimizeVertexFetch(
+		GLfloat* pVertices,
+		GLuint vertexCount,
+		int vertexFloats,
+		GLuint* pIndices,
+		size_t indexCount);
+
+	// build a coarser triangle list of the mesh for a distant LOD
+	// level, merging the vertices within each cell of a grid
+	// gridCells wide; returns the triangles it kept
+	static size_t SimplifyMesh(
+		const GLfloat* pVertices,
+		GLuint vertexCount,
+		int vertexFloats,
+		const GLuint* pIndices,
+		size_t indexCount,
+		int gridCells,
+		std::vector<GLfloat>& simplifiedVertices,
+		std::vector<GLuint>& simplifiedIndices);
+
+	// build a coarser triangle list of the mesh for a distant LOD
+	// level by collapsing the edges that move the surface least,
+	// down to targetIndexCount indices where it can, keeping the
+	// open edges and the seams of the attributes where they are;
+	// error is the farthest the surface moved, in the units of the
+	// positions, and the triangles it kept are returned
+	static size_t SimplifyQuadric(
+		const GLfloat* pVertices,
+		GLuint vertexCount,
+		int vertexFloats,
+		const GLuint* pIndices,
+		size_t indexCount,
+		size_t targetIndexCount,
+		std::vector<GLfloat>& simplifiedVertices,
+		std::vector<GLuint>& simplifiedIndices,
+		float& error);
+
+	// split a triangle list, in its order, into meshlets of at most
+	// MESHLET_MAX_VERTICES vertices and MESHLET_MAX_TRIANGLES
+	// triangles, appending them with the list indices of their
+	// vertices and their triangles as three byte sized meshlet
+	// vertex numbers per uint; returns the meshlets added
+	static size_t BuildMeshlets(
+		const GLfloat* pVertices,
+		int vertexFloats,
+		const GLuint* pIndices,
+		size_t indexCount,
+		std::vector<MESHLET>& meshlets,
+		std::vector<GLuint>& meshletVertices,
+		std::vector<GLuint>& meshletTriangles);
+
+	// write area weighted smooth normals into the three floats after
+	// the position of every vertexFloats vertex, from the triangles
+	// using it; vertices no triangle with an area uses point up
+	static void GenerateNormals(
+		GLfloat* pVertices,
+		GLuint vertexCount,
+		int vertexFloats,
+		const GLuint* pIndices,
+		size_t indexCount);
+};
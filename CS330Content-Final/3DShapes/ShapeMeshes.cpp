@@ -9,12 +9,24 @@
 ///////////////////////////////////////////////////////////////////////////////
 
 #include "shapemeshes.h"
+#include "MeshFile.h"
+#include "MeshCodec.h"
+#include "ShapeTables.h"
+#include "GLDebug.h"
+#include "GPUMemory.h"
+#include "GLTrace.h"
 
 // GLM Math Header inclusions
 #include <glm/glm.hpp>
 #include <glm/gtx/transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <utility>
 #include <vector>
 
 namespace
@@ -24,2167 +36,3322 @@ namespace
 	const GLuint g_FloatsPerVertex = 3;	// Number of coordinates per vertex
 	const GLuint g_FloatsPerNormal = 3;	// Number of values per vertex color
 	const GLuint g_FloatsPerUV = 2;		// Number of texture coordinate values
+	// grid cells across the longest side of a model mesh for each of
+	// its coarser LOD levels, and the share of the triangles of the
+	// level above a level has to drop below to be kept
+	const int g_ModelLODCells[ShapeMeshes::MESH_LOD_COUNT - 1] = { 24, 10 };
+	const float g_ModelLODKeepRatio = 0.75f;
+
+	/****************************************************
+	 *  QuadFaceVertices()
+	 *
+	 *  This function is used for getting the vertices and
+	 *  indices WriteQuadFace() writes for a face split
+	 *  divisions times along each edge.
+	 ****************************************************/
+	GLuint QuadFaceVertices(int divisions)
+	{
+		return((GLuint)((divisions + 1) * (divisions + 1)));
+	}
+	GLuint QuadFaceIndices(int divisions)
+	{
+		return((GLuint)(6 * divisions * divisions));
+	}
+
+	/****************************************************
+	 *  TriangleFaceVertices()
+	 *
+	 *  This function is used for getting the vertices and
+	 *  indices WriteTriangleFace() writes for a face split
+	 *  divisions times along each edge.
+	 ****************************************************/
+	GLuint TriangleFaceVertices(int divisions)
+	{
+		return((GLuint)((divisions + 1) * (divisions + 2) / 2));
+	}
+	GLuint TriangleFaceIndices(int divisions)
+	{
+		return((GLuint)(3 * divisions * divisions));
+	}
+
+	/****************************************************
+	 *  RadialCapIndices()
+	 *
+	 *  This function is used for getting the indices
+	 *  GenerateRadialMesh() writes for one cap and for
+	 *  the sides of a mesh of the given slices.
+	 ****************************************************/
+	GLsizei RadialCapIndices(int slices)
+	{
+		return((GLsizei)(3 * (slices - 2)));
+	}
+	GLsizei RadialSideIndices(int slices, bool bCone)
+	{
+		return((GLsizei)(((bCone == true) ? 3 : 6) * slices));
+	}
+
+	// the tessellations the sphere and torus are always generated
+	// at, built by the compiler: the default sphere, the torus, and
+	// the coarser levels of both
+	constexpr ShapeTables::SPHERE_TABLE<16, 16> g_SphereTable = ShapeTables::MakeSphereTable<16, 16>();
+	constexpr ShapeTables::SPHERE_TABLE<10, 12> g_SphereLOD1Table = ShapeTables::MakeSphereTable<10, 12>();
+	constexpr ShapeTables::SPHERE_TABLE<6, 8> g_SphereLOD2Table = ShapeTables::MakeSphereTable<6, 8>();
+	constexpr ShapeTables::TORUS_TABLE<30, 30> g_TorusTable = ShapeTables::MakeTorusTable<30, 30>();
+	constexpr ShapeTables::TORUS_TABLE<18, 12> g_TorusLOD1Table = ShapeTables::MakeTorusTable<18, 12>();
+	constexpr ShapeTables::TORUS_TABLE<12, 8> g_TorusLOD2Table = ShapeTables::MakeTorusTable<12, 8>();
+
+	/****************************************************
+	 *  FindSphereTable()
+	 *
+	 *  This function is used for finding the compile time
+	 *  table of a sphere tessellation, leaving the
+	 *  pointers NULL when there is none.
+	 ****************************************************/
+	void FindSphereTable(int bands, int slices, const GLfloat*& pVertices, const GLuint*& pIndices)
+	{
+		if ((bands == 16) && (slices == 16))
+		{
+			pVertices = g_SphereTable.vertices;
+			pIndices = g_SphereTable.indices;
+		}
+		else if ((bands == 10) && (slices == 12))
+		{
+			pVertices = g_SphereLOD1Table.vertices;
+			pIndices = g_SphereLOD1Table.indices;
+		}
+		else if ((bands == 6) && (slices == 8))
+		{
+			pVertices = g_SphereLOD2Table.vertices;
+			pIndices = g_SphereLOD2Table.indices;
+		}
+	}
+
+	/****************************************************
+	 *  FindTorusTable()
+	 *
+	 *  This function is used for finding the compile time
+	 *  table of a torus tessellation, leaving the
+	 *  pointers NULL when there is none.
+	 ****************************************************/
+	void FindTorusTable(int mainSegments, int tubeSegments, const GLfloat*& pVertices, const GLuint*& pIndices)
+	{
+		if ((mainSegments == 30) && (tubeSegments == 30))
+		{
+			pVertices = g_TorusTable.vertices;
+			pIndices = g_TorusTable.indices;
+		}
+		else if ((mainSegments == 18) && (tubeSegments == 12))
+		{
+			pVertices = g_TorusLOD1Table.vertices;
+			pIndices = g_TorusLOD1Table.indices;
+		}
+		else if ((mainSegments == 12) && (tubeSegments == 8))
+		{
+			pVertices = g_TorusLOD2Table.vertices;
+			pIndices = g_TorusLOD2Table.indices;
+		}
+	}
+
+	// one vertex of the compact layout, ShapeMeshes::COMPACT_VERTEX_BYTES
+	struct COMPACT_VERTEX
+	{
+		GLushort position[4];	// half floats, the last one padding
+		GLuint normal;			// GL_INT_2_10_10_10_REV, normalized
+		GLushort uv[2];			// half floats
+	};
+
+	/****************************************************
+	 *  FloatToHalf()
+	 *
+	 *  This function is used for rounding a float to the
+	 *  nearest half float, keeping infinities and NaNs and
+	 *  flushing values too small for a half denormal to 0.
+	 ****************************************************/
+	GLushort FloatToHalf(float value)
+	{
+		uint32_t bits = 0;
+		memcpy(&bits, &value, sizeof(bits));
+
+		uint32_t sign = (bits >> 16) & 0x8000;
+		int exponent = (int)((bits >> 23) & 0xFF) - 127 + 15;
+		uint32_t mantissa = bits & 0x7FFFFF;
+		if (((bits >> 23) & 0xFF) == 0xFF)
+		{
+			return((GLushort)(sign | 0x7C00 | ((0 != mantissa) ? 0x200 : 0)));
+		}
+		if (exponent >= 31)
+		{
+			return((GLushort)(sign | 0x7C00));
+		}
+		if (exponent <= 0)
+		{
+			if (exponent < -10)
+			{
+				return((GLushort)sign);
+			}
+			// denormal, the implicit leading bit shifted in
+			mantissa |= 0x800000;
+			uint32_t shift = (uint32_t)(14 - exponent);
+			uint32_t half = mantissa >> shift;
+			if (0 != ((mantissa >> (shift - 1)) & 1))
+			{
+				half++;
+			}
+			return((GLushort)(sign | half));
+		}
+
+		// a carry out of the mantissa rounds into the exponent
+		uint32_t half = sign | ((uint32_t)exponent << 10) | (mantissa >> 13);
+		if (0 != (mantissa & 0x1000))
+		{
+			half++;
+		}
+		return((GLushort)half);
+	}
+
+	/****************************************************
+	 *  PackNormal()
+	 *
+	 *  This function is used for packing a unit normal
+	 *  into the signed normalized 10 bit x, y and z of a
+	 *  GL_INT_2_10_10_10_REV value.
+	 ****************************************************/
+	GLuint PackNormal(const GLfloat* pNormal)
+	{
+		GLuint packed = 0;
+		for (int i = 0; i < 3; i++)
+		{
+			int quantized = (int)floor(glm::clamp(pNormal[i], -1.0f, 1.0f) * 511.0f + 0.5f);
+			packed |= ((GLuint)quantized & 0x3FF) << (10 * i);
+		}
+		return(packed);
+	}
+
+	/****************************************************
+	 *  PackCompactVertices()
+	 *
+	 *  This function is used for packing interleaved float
+	 *  vertices into the compact layout sent to GL.
+	 ****************************************************/
+	void PackCompactVertices(const std::vector<GLfloat>& vertices, std::vector<COMPACT_VERTEX>& compactVertices)
+	{
+		const int vertexFloats = ShapeMeshes::VERTEX_FLOATS;
+		compactVertices.resize(vertices.size() / vertexFloats);
+		for (size_t i = 0; i < compactVertices.size(); i++)
+		{
+			const GLfloat* pVertex = &vertices[i * vertexFloats];
+			COMPACT_VERTEX& compact = compactVertices[i];
+			compact.position[0] = FloatToHalf(pVertex[0]);
+			compact.position[1] = FloatToHalf(pVertex[1]);
+			compact.position[2] = FloatToHalf(pVertex[2]);
+			compact.position[3] = FloatToHalf(1.0f);
+			compact.normal = PackNormal(pVertex + 3);
+			compact.uv[0] = FloatToHalf(pVertex[6]);
+			compact.uv[1] = FloatToHalf(pVertex[7]);
+		}
+	}
+}
+
+GLuint ShapeMeshes::s_boundVAO = 0;
+ShapeMeshes::BIND_STATS ShapeMeshes::s_bindStats = {};
+
+ShapeMeshes::ShapeMeshes()
+{
+	m_bArenaDirty = false;
+	m_drawRecorder = NULL;
+	m_pDrawRecorderContext = NULL;
+	m_arenaVAO = 0;
+	m_arenaBuffers[0] = 0;
+	m_arenaBuffers[1] = 0;
+	m_arenaMaxIndex = 0;
+	m_bArenaGarbage = false;
+	m_bCompactVertices = false;
+	m_compactVAO = 0;
+	m_compactVertexBuffer = 0;
+	m_bBuildMeshlets = false;
+	m_pBufferAllocator = NULL;
+	for (int i = 0; i < 3; i++)
+	{
+		m_meshletAllocations[i] = -1;
+		m_meshletBuffers[i].buffer = 0;
+		m_meshletBuffers[i].offset = 0;
+		m_meshletBuffers[i].size = 0;
+	}
+	m_proceduralGenerator = NULL;
+	m_pProceduralContext = NULL;
+	m_bProceduralReadBack = false;
+	m_modelMeshSource = NULL;
+	m_pModelMeshSourceContext = NULL;
+
+	// every shape starts requested at its default tessellation,
+	// generated once a draw uses it
+	for (int shape = 0; shape < SHAPE_COUNT; shape++)
+	{
+		MESH_SLOT& slot = m_meshSlots[shape];
+		slot.bLoaded = false;
+		slot.bCompact = false;
+		slot.resolution[0] = -1;
+		slot.resolution[1] = -1;
+		slot.thickness = -1.0f;
+		slot.references = 0;
+	}
+	LoadBoxMesh();
+	LoadConeMesh();
+	LoadCylinderMesh();
+	LoadPlaneMesh();
+	LoadPrismMesh();
+	LoadPyramid3Mesh();
+	LoadPyramid4Mesh();
+	LoadSphereMesh();
+	LoadTaperedCylinderMesh();
+	LoadTorusMesh();
+}
+
+ShapeMeshes::~ShapeMeshes()
+{
+	// nothing is generated again, so the meshes kept on the GPU
+	// are not copied back
+	m_modelMeshes.clear();
+	ClearArena();
+	GPUMemory::TrackHostCopy("mesh arena CPU copy", 0, GPUMemory::CATEGORY_MESH);
+	GPUMemory::TrackHostCopy("model mesh sources", 0, GPUMemory::CATEGORY_MESH);
+}
+
+///////////////////////////////////////////////////
+//	BindVertexArray()
+//
+//	Bind the passed in VAO, skipping the GL call when
+//  it is already bound. Draw calls leave their VAO
+//  bound so consecutive draws of one mesh bind once.
+///////////////////////////////////////////////////
+void ShapeMeshes::BindVertexArray(GLuint vao)
+{
+	if (s_boundVAO == vao)
+	{
+		s_bindStats.vaoSkips++;
+		return;
+	}
+
+	glBindVertexArray(vao);
+	s_boundVAO = vao;
+	s_bindStats.vaoBinds++;
+}
+
+///////////////////////////////////////////////////
+//	BindTextureForEdit()
+//
+//	Bind the passed in texture on the active unit
+//  for the calls that set it up through its target,
+//  returning the texture the unit held. Binding 0
+//  afterwards would leave the unit apart from the
+//  texture ShaderManager::BindTexture() recorded on
+//  it, whose next bind it would then skip.
+///////////////////////////////////////////////////
+GLuint ShapeMeshes::BindTextureForEdit(GLenum target, GLuint texture)
+{
+	GLenum binding = GL_TEXTURE_BINDING_2D;
+	switch (target)
+	{
+	case GL_TEXTURE_2D_ARRAY:
+		binding = GL_TEXTURE_BINDING_2D_ARRAY;
+		break;
+	case GL_TEXTURE_CUBE_MAP:
+		binding = GL_TEXTURE_BINDING_CUBE_MAP;
+		break;
+	case GL_TEXTURE_BUFFER:
+		binding = GL_TEXTURE_BINDING_BUFFER;
+		break;
+	default:
+		break;
+	}
+
+	GLint previousTexture = 0;
+	glGetIntegerv(binding, &previousTexture);
+	glBindTexture(target, texture);
+	return((GLuint)previousTexture);
+}
+
+///////////////////////////////////////////////////
+//	RestoreTextureBinding()
+//
+//	Bind back the texture BindTextureForEdit() found
+//  on the active unit.
+///////////////////////////////////////////////////
+void ShapeMeshes::RestoreTextureBinding(GLenum target, GLuint previousTexture)
+{
+	glBindTexture(target, previousTexture);
+}
+
+///////////////////////////////////////////////////
+//	ResetBindStats()
+//
+//	Clear the redundant VAO bind and draw counters.
+///////////////////////////////////////////////////
+void ShapeMeshes::ResetBindStats()
+{
+	memset(&s_bindStats, 0, sizeof(s_bindStats));
+}
+
+///////////////////////////////////////////////////
+//	SetDrawRecorder()
+//
+//	Route the draw ranges of the Draw*Mesh() methods
+//  to the passed in function instead of OpenGL, so a
+//  caller can record them and replay them later with
+//  DrawRange(). Pass NULL to draw immediately again.
+///////////////////////////////////////////////////
+void ShapeMeshes::SetDrawRecorder(
+	DrawRecorder drawRecorder,
+	void* pContext)
+{
+	m_drawRecorder = drawRecorder;
+	m_pDrawRecorderContext = pContext;
+}
+
+///////////////////////////////////////////////////
+//	SetProceduralGenerator()
+//
+//	Hand the vertices of the full float spheres and
+//  tori generated from now on to the passed in
+//  function, which writes them on the GPU every time
+//  the arena is uploaded. Pass NULL to generate them
+//  on the CPU again.
+///////////////////////////////////////////////////
+void ShapeMeshes::SetProceduralGenerator(
+	ProceduralGenerator generator,
+	void* pContext)
+{
+	m_proceduralGenerator = generator;
+	m_pProceduralContext = pContext;
+}
+
+///////////////////////////////////////////////////
+//	ReadBackProceduralMeshes()
+//
+//	Copy the vertices the GPU wrote for the
+//  procedural meshes out of the arena vertex buffer
+//  into its CPU copy, so the static bake and the
+//  baked mesh file read the same vertices the draws
+//  do. Later uploads send the copied vertices and
+//  the generator writes the same ones over them.
+///////////////////////////////////////////////////
+void ShapeMeshes::ReadBackProceduralMeshes()
+{
+	if (m_bProceduralReadBack == false)
+	{
+		return;
+	}
+	UploadArena();
+
+	glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+	glBindBuffer(GL_ARRAY_BUFFER, m_arenaBuffers[0]);
+	for (size_t i = 0; i < m_proceduralMeshes.size(); i++)
+	{
+		const PROCEDURAL_MESH& procedural = m_proceduralMeshes[i];
+		GLuint vertexCount = (procedural.shape == SHAPE_SPHERE) ?
+			(2 + (procedural.segments[0] - 1) * (procedural.segments[1] + 1)) :
+			((procedural.segments[0] + 1) * (procedural.segments[1] + 1));
+		size_t firstFloat = (size_t)procedural.baseVertex * VERTEX_FLOATS;
+		glGetBufferSubData(GL_ARRAY_BUFFER, (GLintptr)(firstFloat * sizeof(GLfloat)),
+			(GLsizeiptr)((size_t)vertexCount * VERTEX_FLOATS * sizeof(GLfloat)), &m_arenaVertices[firstFloat]);
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	m_bProceduralReadBack = false;
+}
+
+///////////////////////////////////////////////////
+//	DrawRange()
+//
+//	Draw a range recorded from one of the Draw*Mesh()
+//  methods, instanceCount times with one draw call.
+///////////////////////////////////////////////////
+void ShapeMeshes::DrawRange(
+	const DRAW_RANGE& drawRange,
+	GLsizei instanceCount)
+{
+	const size_t indexSize = (drawRange.indexType == GL_UNSIGNED_SHORT) ? sizeof(GLushort) : sizeof(GLuint);
+	void* indexOffset = (void*)(drawRange.first * indexSize);
+
+	BindVertexArray(drawRange.vao);
+	if (instanceCount > 1)
+	{
+		if (drawRange.bIndexed == true)
+		{
+			glDrawElementsInstancedBaseVertex(drawRange.mode, drawRange.count, drawRange.indexType,
+				indexOffset, instanceCount, drawRange.baseVertex);
+		}
+		else
+		{
+			glDrawArraysInstanced(drawRange.mode, drawRange.first, drawRange.count,
+				instanceCount);
+		}
+	}
+	else if (drawRange.bIndexed == true)
+	{
+		glDrawElementsBaseVertex(drawRange.mode, drawRange.count, drawRange.indexType,
+			indexOffset, drawRange.baseVertex);
+	}
+	else
+	{
+		GLTrace::RecordDrawArrays(drawRange.mode, drawRange.first, drawRange.count);
+		glDrawArrays(drawRange.mode, drawRange.first, drawRange.count);
+	}
+
+	s_bindStats.drawCalls++;
+	s_bindStats.instances += instanceCount;
+	if (drawRange.bIndexed == true)
+	{
+		s_bindStats.elementDraws++;
+		s_bindStats.indices += (unsigned long long)drawRange.count * instanceCount;
+	}
+	else
+	{
+		s_bindStats.arrayDraws++;
+		s_bindStats.vertices += (unsigned long long)drawRange.count * instanceCount;
+	}
+}
+
+///////////////////////////////////////////////////
+//	GetLODRange()
+//
+//	Copy a recorded range with the first, count and
+//  base vertex of one of its LOD levels. Levels past
+//  the last one of the range give the coarsest.
+///////////////////////////////////////////////////
+ShapeMeshes::DRAW_RANGE ShapeMeshes::GetLODRange(
+	const DRAW_RANGE& drawRange,
+	int lod)
+{
+	DRAW_RANGE lodRange = drawRange;
+	lod = glm::clamp(lod, 0, drawRange.lodLevels - 1);
+	lodRange.first = drawRange.lods[lod].first;
+	lodRange.count = drawRange.lods[lod].count;
+	lodRange.baseVertex = drawRange.lods[lod].baseVertex;
+	// the coarser levels are not split into meshlets
+	if (lod > 0)
+	{
+		lodRange.meshletCount = 0;
+	}
+
+	return(lodRange);
+}
+
+///////////////////////////////////////////////////
+//	MakeIndirectCommand()
+//
+//	Fill a multi-draw indirect command that draws a
+//  recorded range instanceCount times, starting at
+//  baseInstance.
+///////////////////////////////////////////////////
+ShapeMeshes::INDIRECT_COMMAND ShapeMeshes::MakeIndirectCommand(
+	const DRAW_RANGE& drawRange,
+	GLuint instanceCount,
+	GLuint baseInstance)
+{
+	INDIRECT_COMMAND command;
+	command.count = drawRange.count;
+	command.instanceCount = instanceCount;
+	command.first = drawRange.first;
+	if (drawRange.bIndexed == true)
+	{
+		command.baseVertexOrInstance = (GLuint)drawRange.baseVertex;
+		command.baseInstance = baseInstance;
+	}
+	else
+	{
+		// array commands have no base vertex
+		command.baseVertexOrInstance = baseInstance;
+		command.baseInstance = 0;
+	}
+
+	return(command);
+}
+
+///////////////////////////////////////////////////
+//	MultiDrawIndirect()
+//
+//	Draw drawCount commands of the bound indirect
+//  buffer, starting at commandIndex, with one call.
+//  The commands must all be indexed, with indices of
+//  indexType, or all not, and start at bufferOffset, so a frame can read its
+//  commands from its region of a shared buffer.
+///////////////////////////////////////////////////
+void ShapeMeshes::MultiDrawIndirect(
+	GLuint vao,
+	GLenum mode,
+	bool bIndexed,
+	GLenum indexType,
+	GLsizei commandIndex,
+	GLsizei drawCount,
+	GLsizei instanceCount,
+	GLintptr bufferOffset)
+{
+	const void* commandOffset = (void*)(bufferOffset + commandIndex * sizeof(INDIRECT_COMMAND));
+
+	BindVertexArray(vao);
+	if (bIndexed == true)
+	{
+		glMultiDrawElementsIndirect(mode, indexType, commandOffset, drawCount,
+			sizeof(INDIRECT_COMMAND));
+	}
+	else
+	{
+		glMultiDrawArraysIndirect(mode, commandOffset, drawCount, sizeof(INDIRECT_COMMAND));
+	}
+
+	// the counts of the commands are written on the GPU, so the
+	// indices and vertices they draw are not known here
+	s_bindStats.drawCalls++;
+	s_bindStats.instances += instanceCount;
+	s_bindStats.indirectDraws++;
+}
+
+///////////////////////////////////////////////////
+//	CalculateBounds()
+//
+//	Compute the axis aligned bounding box of the
+//  positions in interleaved vertex data, and the
+//  smallest sphere around the box center holding
+//  every position.
+///////////////////////////////////////////////////
+ShapeMeshes::BOUNDS ShapeMeshes::CalculateBounds(
+	const GLfloat* pVertexData,
+	size_t floatCount)
+{
+	const GLuint floatsPerVertex = g_FloatsPerVertex + g_FloatsPerNormal + g_FloatsPerUV;
+	BOUNDS bounds;
+
+	bounds.minXYZ = glm::vec3(0.0f, 0.0f, 0.0f);
+	bounds.maxXYZ = glm::vec3(0.0f, 0.0f, 0.0f);
+	for (size_t i = 0; i + floatsPerVertex <= floatCount; i += floatsPerVertex)
+	{
+		glm::vec3 position(pVertexData[i], pVertexData[i + 1], pVertexData[i + 2]);
+		if (i == 0)
+		{
+			bounds.minXYZ = position;
+			bounds.maxXYZ = position;
+		}
+		bounds.minXYZ = glm::min(bounds.minXYZ, position);
+		bounds.maxXYZ = glm::max(bounds.maxXYZ, position);
+	}
+
+	bounds.center = (bounds.minXYZ + bounds.maxXYZ) * 0.5f;
+	bounds.radius = 0.0f;
+	for (size_t i = 0; i + floatsPerVertex <= floatCount; i += floatsPerVertex)
+	{
+		glm::vec3 position(pVertexData[i], pVertexData[i + 1], pVertexData[i + 2]);
+		bounds.radius = glm::max(bounds.radius, glm::length(position - bounds.center));
+	}
+
+	return(bounds);
+}
+
+///////////////////////////////////////////////////
+//	AllocateArenaMesh()
+//
+//	Grow the vertex and index buffers shared by every
+//  mesh by the space of one mesh and remember where
+//  it starts, returning a cursor for its generator
+//  to write the vertices and indices straight into.
+//  All meshes draw from the one arena VAO, so draws
+//  of different meshes need no VAO switch and can
+//  go out together with multi-draw indirect.
+///////////////////////////////////////////////////
+ShapeMeshes::MESH_CURSOR ShapeMeshes::AllocateArenaMesh(
+	GLMesh& mesh,
+	GLuint vertexCount,
+	GLuint indexCount)
+{
+	// each layout needs its own VAO, and so its own vertex buffer
+	// and vertex numbering
+	GLuint& vao = (m_bCompactVertices == true) ? m_compactVAO : m_arenaVAO;
+	if (0 == vao)
+	{
+		vao = CreateVertexArray(m_bCompactVertices);
+	}
+
+	mesh.vao = vao;
+	mesh.bCompact = m_bCompactVertices;
+	std::vector<GLfloat>& vertices = GetMeshVertices(mesh);
+	mesh.nVertices = vertexCount;
+	mesh.nIndices = indexCount;
+	mesh.baseVertex = (GLuint)(vertices.size() / VERTEX_FLOATS);
+	mesh.firstIndex = (GLuint)m_arenaIndices.size();
+	mesh.slices = 0;
+	mesh.firstMeshlet = 0;
+	mesh.meshletCount = 0;
+	mesh.bProcedural = false;
+	mesh.lodError = 0.0f;
+
+	vertices.resize(vertices.size() + (size_t)vertexCount * VERTEX_FLOATS);
+	m_arenaIndices.resize(m_arenaIndices.size() + indexCount);
+
+	MESH_CURSOR cursor;
+	cursor.pVertex = &vertices[(size_t)mesh.baseVertex * VERTEX_FLOATS];
+	cursor.pIndex = (indexCount > 0) ? &m_arenaIndices[mesh.firstIndex] : NULL;
+	cursor.vertexIndex = 0;
+
+	return(cursor);
+}
+
+///////////////////////////////////////////////////
+//	FinishArenaMesh()
+//
+//	Reorder the triangles of a mesh its generator has
+//  written into the arena for the vertex cache, one
+//  segment at a time, then its vertices in the order
+//  the triangles use them, keeping the cache quality
+//  before and after in the mesh stats. Then compute
+//  its bounds and mark the arena for upload. The
+//  vertices of a procedural mesh are not written
+//  yet, so its triangles are only ordered for the
+//  cache, its vertices stay in the order the GPU
+//  writes them, and it keeps its analytic bounds.
+///////////////////////////////////////////////////
+void ShapeMeshes::FinishArenaMesh(
+	GLMesh& mesh,
+	const char* name,
+	const GLsizei* pSegmentEnds,
+	int segmentCount)
+{
+	GLfloat* pVertices = &GetMeshVertices(mesh)[(size_t)mesh.baseVertex * VERTEX_FLOATS];
+	if (mesh.nIndices >= 3)
+	{
+		GLuint* pIndices = &m_arenaIndices[mesh.firstIndex];
+
+		MESH_STATS stats;
+		stats.name = name;
+		stats.bCompact = mesh.bCompact;
+		stats.vertexCount = mesh.nVertices;
+		stats.triangleCount = mesh.nIndices / 3;
+		stats.before = MeshOptimizer::AnalyzeCache(pIndices, mesh.nIndices, mesh.nVertices);
+
+		// the generated order can reuse a ring across two segments,
+		// so it is put back when the whole mesh does no better
+		std::vector<GLuint> generatedIndices(pIndices, pIndices + mesh.nIndices);
+		GLsizei segmentStart = 0;
+		for (int segment = 0; segment <= segmentCount; segment++)
+		{
+			GLsizei segmentEnd = (segment < segmentCount) ? pSegmentEnds[segment] : (GLsizei)mesh.nIndices;
+			MeshOptimizer::OptimizeTriangles(pIndices + segmentStart, (size_t)(segmentEnd - segmentStart),
+				mesh.nVertices, pVertices, VERTEX_FLOATS, (mesh.bProcedural == false));
+			segmentStart = segmentEnd;
+		}
+		if (MeshOptimizer::AnalyzeCache(pIndices, mesh.nIndices, mesh.nVertices).acmr >= stats.before.acmr)
+		{
+			std::copy(generatedIndices.begin(), generatedIndices.end(), pIndices);
+		}
+		if (mesh.bProcedural == false)
+		{
+			MeshOptimizer::OptimizeVertexFetch(pVertices, mesh.nVertices, VERTEX_FLOATS, pIndices, mesh.nIndices);
+		}
+
+		stats.after = MeshOptimizer::AnalyzeCache(pIndices, mesh.nIndices, mesh.nVertices);
+		m_meshStats.push_back(stats);
+
+		m_arenaMaxIndex = glm::max(m_arenaMaxIndex, mesh.nVertices - 1);
+	}
+
+	if (mesh.bProcedural == false)
+	{
+		mesh.bounds = CalculateBounds(pVertices, (size_t)mesh.nVertices * VERTEX_FLOATS);
+	}
+
+	// sent to GL once all the meshes are in, by UploadArena()
+	m_bArenaDirty = true;
+}
+
+///////////////////////////////////////////////////
+//	AddMeshToArena()
+//
+//	Append the interleaved vertices and the indices
+//  of a mesh built elsewhere to the vertex and index
+//  buffers shared by every mesh.
+///////////////////////////////////////////////////
+void ShapeMeshes::AddMeshToArena(
+	GLMesh& mesh,
+	const char* name,
+	const GLfloat* pVertexData,
+	size_t floatCount,
+	const GLuint* pIndices,
+	size_t indexCount)
+{
+	MESH_CURSOR cursor = AllocateArenaMesh(mesh, (GLuint)(floatCount / VERTEX_FLOATS),
+		(NULL != pIndices) ? (GLuint)indexCount : 0);
+	std::copy(pVertexData, pVertexData + (size_t)mesh.nVertices * VERTEX_FLOATS, cursor.pVertex);
+	if (NULL != cursor.pIndex)
+	{
+		std::copy(pIndices, pIndices + indexCount, cursor.pIndex);
+	}
+	FinishArenaMesh(mesh, name);
+}
+
+///////////////////////////////////////////////////
+//	BuildArenaMeshlets()
+//
+//	Split a full float mesh of the arena into
+//  meshlets in its optimized triangle order. The
+//  meshlet ranges and the vertex numbers are made
+//  arena wide, so the culling can build draws and
+//  the mesh shaders fetch vertices without knowing
+//  the mesh they came from.
+///////////////////////////////////////////////////
+void ShapeMeshes::BuildArenaMeshlets(GLMesh& mesh)
+{
+	if ((mesh.bCompact == true) || (mesh.nIndices < 3))
+	{
+		return;
+	}
+
+	size_t firstMeshlet = m_meshlets.size();
+	size_t firstVertex = m_meshletVertices.size();
+	mesh.firstMeshlet = (GLuint)firstMeshlet;
+	mesh.meshletCount = (GLuint)MeshOptimizer::BuildMeshlets(
+		&m_arenaVertices[(size_t)mesh.baseVertex * VERTEX_FLOATS], VERTEX_FLOATS,
+		&m_arenaIndices[mesh.firstIndex], mesh.nIndices,
+		m_meshlets, m_meshletVertices, m_meshletTriangles);
+
+	for (size_t i = firstMeshlet; i < m_meshlets.size(); i++)
+	{
+		m_meshlets[i].firstIndex += mesh.firstIndex;
+		m_meshlets[i].baseVertex = (GLint)mesh.baseVertex;
+	}
+	for (size_t i = firstVertex; i < m_meshletVertices.size(); i++)
+	{
+		m_meshletVertices[i] += mesh.baseVertex;
+	}
+	m_bArenaDirty = true;
+}
+
+///////////////////////////////////////////////////
+//	WriteVertex()
+//
+//	Write one interleaved vertex at the cursor.
+///////////////////////////////////////////////////
+void ShapeMeshes::WriteVertex(
+	MESH_CURSOR& cursor,
+	const glm::vec3& position,
+	const glm::vec3& normal,
+	const glm::vec2& uv)
+{
+	GLfloat* pVertex = cursor.pVertex;
+	pVertex[0] = position.x;
+	pVertex[1] = position.y;
+	pVertex[2] = position.z;
+	pVertex[3] = normal.x;
+	pVertex[4] = normal.y;
+	pVertex[5] = normal.z;
+	pVertex[6] = uv.x;
+	pVertex[7] = uv.y;
+
+	cursor.pVertex += VERTEX_FLOATS;
+	cursor.vertexIndex++;
+}
+
+///////////////////////////////////////////////////
+//	WriteTriangle()
+//
+//	Write the indices of one triangle at the cursor,
+//  relative to the first vertex of the mesh.
+///////////////////////////////////////////////////
+void ShapeMeshes::WriteTriangle(
+	MESH_CURSOR& cursor,
+	GLuint a,
+	GLuint b,
+	GLuint c)
+{
+	cursor.pIndex[0] = a;
+	cursor.pIndex[1] = b;
+	cursor.pIndex[2] = c;
+	cursor.pIndex += 3;
+}
+
+///////////////////////////////////////////////////
+//	WriteQuadFace()
+//
+//	Write a flat face from origin along the uEdge
+//  and vEdge vectors as a grid of divisions by
+//  divisions quads, with texture coordinates from
+//  (0, 0) at origin to (1, 1) at the far corner.
+//  The triangles wind counterclockwise seen from
+//  the side uEdge cross vEdge points to, which is
+//  the face normal.
+///////////////////////////////////////////////////
+void ShapeMeshes::WriteQuadFace(
+	MESH_CURSOR& cursor,
+	const glm::vec3& origin,
+	const glm::vec3& uEdge,
+	const glm::vec3& vEdge,
+	int divisions)
+{
+	const glm::vec3 normal = glm::normalize(glm::cross(uEdge, vEdge));
+	const GLuint firstVertex = cursor.vertexIndex;
+	const GLuint rowVertices = (GLuint)divisions + 1;
+
+	for (int j = 0; j <= divisions; j++)
+	{
+		float v = (float)j / (float)divisions;
+		for (int i = 0; i <= divisions; i++)
+		{
+			float u = (float)i / (float)divisions;
+			WriteVertex(cursor, origin + uEdge * u + vEdge * v, normal, glm::vec2(u, v));
+		}
+	}
+
+	for (GLuint j = 0; j < (GLuint)divisions; j++)
+	{
+		for (GLuint i = 0; i < (GLuint)divisions; i++)
+		{
+			GLuint corner = firstVertex + j * rowVertices + i;
+			WriteTriangle(cursor, corner, corner + 1, corner + rowVertices + 1);
+			WriteTriangle(cursor, corner, corner + rowVertices + 1, corner + rowVertices);
+		}
+	}
+}
+
+///////////////////////////////////////////////////
+//	WriteTriangleFace()
+//
+//	Write a flat triangle face with the passed in
+//  corners and their texture coordinates, each edge
+//  split divisions times, as rows of triangles from
+//  the edge of the first two corners to the third.
+//  The corners wind counterclockwise seen from the
+//  outside.
+///////////////////////////////////////////////////
+void ShapeMeshes::WriteTriangleFace(
+	MESH_CURSOR& cursor,
+	const glm::vec3 corners[3],
+	const glm::vec2 uvs[3],
+	int divisions)
+{
+	const glm::vec3 normal = glm::normalize(glm::cross(corners[1] - corners[0], corners[2] - corners[0]));
+	const GLuint firstVertex = cursor.vertexIndex;
+
+	for (int row = 0; row <= divisions; row++)
+	{
+		float t = (float)row / (float)divisions;
+		for (int i = 0; i <= divisions - row; i++)
+		{
+			float s = (float)i / (float)divisions;
+			WriteVertex(cursor,
+				corners[0] + (corners[1] - corners[0]) * s + (corners[2] - corners[0]) * t,
+				normal,
+				uvs[0] + (uvs[1] - uvs[0]) * s + (uvs[2] - uvs[0]) * t);
+		}
+	}
+
+	// each row holds one vertex less than the one below it
+	GLuint rowStart = firstVertex;
+	for (int row = 0; row < divisions; row++)
+	{
+		GLuint rowVertices = (GLuint)(divisions - row + 1);
+		GLuint nextStart = rowStart + rowVertices;
+		for (GLuint i = 0; i + 1 < rowVertices; i++)
+		{
+			WriteTriangle(cursor, rowStart + i, rowStart + i + 1, nextStart + i);
+			if (i + 2 < rowVertices)
+			{
+				WriteTriangle(cursor, rowStart + i + 1, nextStart + i + 1, nextStart + i);
+			}
+		}
+		rowStart = nextStart;
+	}
+}
+
+///////////////////////////////////////////////////
+//	UploadArena()
+//
+//	Send the arena to GL in immutable buffers behind
+//  the arena VAO, with 16-bit indices when they fit,
+//  and the compact arena packed into its own vertex
+//  buffer behind the compact VAO, sharing the index
+//  buffer. Immutable storage cannot grow, so meshes
+//  loaded after an upload replace the buffers with
+//  ones holding the whole arena again, and ranges
+//  must be recorded again when that widens the
+//  indices.
+///////////////////////////////////////////////////
+void ShapeMeshes::UploadArena()
+{
+	if ((m_bArenaDirty == false) ||
+		((m_arenaVertices.empty() == true) && (m_compactVertices.empty() == true)))
+	{
+		return;
+	}
+
+	GPUMemory::DeleteBuffers(2, m_arenaBuffers);
+	GPUMemory::DeleteBuffers(1, &m_compactVertexBuffer);
+	m_arenaBuffers[0] = 0;
+	m_arenaBuffers[1] = 0;
+	m_compactVertexBuffer = 0;
+
+	if (m_arenaVertices.empty() == false)
+	{
+		m_arenaBuffers[0] = CreateStaticBuffer(
+			m_arenaVertices.size() * sizeof(GLfloat), m_arenaVertices.data(), "mesh arena vertices");
+	}
+	if (m_compactVertices.empty() == false)
+	{
+		std::vector<COMPACT_VERTEX> compactVertices;
+		PackCompactVertices(m_compactVertices, compactVertices);
+		m_compactVertexBuffer = CreateStaticBuffer(
+			compactVertices.size() * sizeof(COMPACT_VERTEX), compactVertices.data(), "mesh arena compact vertices");
+	}
+	if (m_arenaIndices.empty() == false)
+	{
+		if (GetArenaIndexType() == GL_UNSIGNED_SHORT)
+		{
+			std::vector<GLushort> shortIndices(m_arenaIndices.begin(), m_arenaIndices.end());
+			m_arenaBuffers[1] = CreateStaticBuffer(
+				shortIndices.size() * sizeof(GLushort), shortIndices.data(), "mesh arena indices");
+		}
+		else
+		{
+			m_arenaBuffers[1] = CreateStaticBuffer(
+				m_arenaIndices.size() * sizeof(GLuint), m_arenaIndices.data(), "mesh arena indices");
+		}
+	}
+	if (0 != m_arenaVAO)
+	{
+		AttachMeshBuffers(m_arenaVAO, m_arenaBuffers[0], m_arenaBuffers[1]);
+	}
+	// the new vertex buffer holds the CPU copy, which lacks the
+	// procedural vertices until they are read back
+	if ((m_proceduralMeshes.empty() == false) && (NULL != m_proceduralGenerator))
+	{
+		m_proceduralGenerator(m_pProceduralContext, m_arenaBuffers[0], m_proceduralMeshes);
+	}
+	if (0 != m_compactVAO)
+	{
+		AttachMeshBuffers(m_compactVAO, m_compactVertexBuffer, m_arenaBuffers[1], true);
+	}
+
+	UploadMeshletStorage();
+
+	m_bArenaDirty = false;
+	TrackHostCopies();
+}
+
+///////////////////////////////////////////////////
+//	SetBufferAllocator()
+//
+//	Set the allocator the meshlet arrays are placed
+//  in from the next upload on. The arrays already
+//  sent are freed from the storage they were put in
+//  and sent again with the arena.
+///////////////////////////////////////////////////
+void ShapeMeshes::SetBufferAllocator(BufferAllocator* pAllocator)
+{
+	if (pAllocator == m_pBufferAllocator)
+	{
+		return;
+	}
+
+	ReleaseMeshletStorage();
+	m_pBufferAllocator = pAllocator;
+	if (m_meshlets.empty() == false)
+	{
+		m_bArenaDirty = true;
+	}
+}
+
+///////////////////////////////////////////////////
+//	UploadMeshletStorage()
+//
+//	Send the meshlets, their vertices and their
+//  triangles to storage the culling pass binds as
+//  storage buffers, so each range starts at the
+//  offset alignment storage bindings ask for. With
+//  an allocator they are movable ranges of its
+//  pages, since the culling reads the ranges at
+//  every bind.
+///////////////////////////////////////////////////
+void ShapeMeshes::UploadMeshletStorage()
+{
+	ReleaseMeshletStorage();
+	if (m_meshlets.empty() == true)
+	{
+		return;
+	}
+
+	const GLsizeiptr sizes[3] =
+	{
+		(GLsizeiptr)(m_meshlets.size() * sizeof(MeshOptimizer::MESHLET)),
+		(GLsizeiptr)(m_meshletVertices.size() * sizeof(GLuint)),
+		(GLsizeiptr)(m_meshletTriangles.size() * sizeof(GLuint))
+	};
+	const void* data[3] = { m_meshlets.data(), m_meshletVertices.data(), m_meshletTriangles.data() };
+	const char* labels[3] = { "meshlets", "meshlet vertices", "meshlet triangles" };
+
+	if (NULL != m_pBufferAllocator)
+	{
+		GLint alignment = 256;
+		glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &alignment);
+		for (int i = 0; i < 3; i++)
+		{
+			m_meshletAllocations[i] = m_pBufferAllocator->Allocate(sizes[i], glm::max(alignment, 4), data[i], true);
+			s_bindStats.bufferBytes += (unsigned long long)sizes[i];
+		}
+		return;
+	}
+
+	for (int i = 0; i < 3; i++)
+	{
+		m_meshletBuffers[i].buffer = CreateStaticBuffer(sizes[i], data[i], labels[i]);
+		m_meshletBuffers[i].offset = 0;
+		m_meshletBuffers[i].size = sizes[i];
+	}
+}
+
+///////////////////////////////////////////////////
+//	ReleaseMeshletStorage()
+//
+//	Free the storage of the meshlet arrays, the
+//  allocations or the buffers of their own.
+///////////////////////////////////////////////////
+void ShapeMeshes::ReleaseMeshletStorage()
+{
+	for (int i = 0; i < 3; i++)
+	{
+		if ((m_meshletAllocations[i] >= 0) && (NULL != m_pBufferAllocator))
+		{
+			m_pBufferAllocator->Free(m_meshletAllocations[i]);
+		}
+		m_meshletAllocations[i] = -1;
+		if (0 != m_meshletBuffers[i].buffer)
+		{
+			GPUMemory::DeleteBuffers(1, &m_meshletBuffers[i].buffer);
+		}
+		m_meshletBuffers[i].buffer = 0;
+		m_meshletBuffers[i].offset = 0;
+		m_meshletBuffers[i].size = 0;
+	}
+}
+
+///////////////////////////////////////////////////
+//	GetMeshletRange()
+//
+//	Get where one of the meshlet arrays is now, the
+//  range its allocation holds or the whole of its
+//  own buffer.
+///////////////////////////////////////////////////
+BufferAllocator::RANGE ShapeMeshes::GetMeshletRange(int array) const
+{
+	if ((m_meshletAllocations[array] >= 0) && (NULL != m_pBufferAllocator))
+	{
+		return(m_pBufferAllocator->GetRange(m_meshletAllocations[array]));
+	}
+	return(m_meshletBuffers[array]);
+}
+
+///////////////////////////////////////////////////
+//	SaveBakedMeshes()
+//
+//	Write every shape generated into the arena, the
+//  tessellation it was requested at, the range and
+//  bounds of its mesh and LOD levels, and the arena
+//  blobs packed and typed the way UploadArena()
+//  sends them, so loading them does no work. With
+//  bEncode the blobs are coded for the asset pack,
+//  and a load decodes them instead. Model meshes
+//  are not listed, they are added again by their
+//  importer after a load.
+///////////////////////////////////////////////////
+bool ShapeMeshes::SaveBakedMeshes(const char* filename, bool bEncode)
+{
+	ReadBackProceduralMeshes();
+
+	std::vector<MeshFile::SHAPE> shapes;
+	std::vector<MeshFile::MESH> meshes;
+	for (int shape = 0; shape < SHAPE_COUNT; shape++)
+	{
+		const MESH_SLOT& slot = m_meshSlots[shape];
+		if (slot.bLoaded == false)
+		{
+			continue;
+		}
+
+		GLMesh* pMeshes[MESH_LOD_COUNT];
+		int meshCount = GetShapeMeshes((MESH_SHAPE)shape, pMeshes);
+
+		MeshFile::SHAPE shapeRecord;
+		memset(&shapeRecord, 0, sizeof(shapeRecord));
+		shapeRecord.shape = shape;
+		shapeRecord.bCompact = (slot.bCompact == true) ? 1 : 0;
+		shapeRecord.resolution[0] = slot.resolution[0];
+		shapeRecord.resolution[1] = slot.resolution[1];
+		shapeRecord.thickness = slot.thickness;
+		shapeRecord.firstMesh = (uint32_t)meshes.size();
+		shapeRecord.meshCount = (uint32_t)meshCount;
+		shapes.push_back(shapeRecord);
+
+		for (int i = 0; i < meshCount; i++)
+		{
+			const GLMesh& mesh = *pMeshes[i];
+			MeshFile::MESH meshRecord;
+			meshRecord.nVertices = mesh.nVertices;
+			meshRecord.nIndices = mesh.nIndices;
+			meshRecord.baseVertex = mesh.baseVertex;
+			meshRecord.firstIndex = mesh.firstIndex;
+			meshRecord.slices = mesh.slices;
+			meshRecord.bCompact = (mesh.bCompact == true) ? 1 : 0;
+			memcpy(meshRecord.minXYZ, &mesh.bounds.minXYZ[0], sizeof(meshRecord.minXYZ));
+			memcpy(meshRecord.maxXYZ, &mesh.bounds.maxXYZ[0], sizeof(meshRecord.maxXYZ));
+			memcpy(meshRecord.center, &mesh.bounds.center[0], sizeof(meshRecord.center));
+			meshRecord.radius = mesh.bounds.radius;
+			meshes.push_back(meshRecord);
+		}
+	}
+	if (shapes.empty() == true)
+	{
+		std::cout << "No meshes to bake into " << filename << std::endl;
+		return(false);
+	}
+
+	std::vector<MeshFile::STATS> stats(m_meshStats.size());
+	for (size_t i = 0; i < m_meshStats.size(); i++)
+	{
+		memset(&stats[i], 0, sizeof(stats[i]));
+		strncpy(stats[i].name, m_meshStats[i].name, MeshFile::NAME_LENGTH - 1);
+		stats[i].bCompact = (m_meshStats[i].bCompact == true) ? 1 : 0;
+		stats[i].vertexCount = m_meshStats[i].vertexCount;
+		stats[i].triangleCount = m_meshStats[i].triangleCount;
+		stats[i].acmrBefore = m_meshStats[i].before.acmr;
+		stats[i].atvrBefore = m_meshStats[i].before.atvr;
+		stats[i].acmrAfter = m_meshStats[i].after.acmr;
+		stats[i].atvrAfter = m_meshStats[i].after.atvr;
+	}
+
+	// the blobs as the GL buffers hold them
+	std::vector<COMPACT_VERTEX> compactVertices;
+	PackCompactVertices(m_compactVertices, compactVertices);
+	std::vector<GLushort> shortIndices;
+	const void* pIndices = m_arenaIndices.data();
+	size_t indexBytes = m_arenaIndices.size() * sizeof(GLuint);
+	if (GetArenaIndexType() == GL_UNSIGNED_SHORT)
+	{
+		shortIndices.assign(m_arenaIndices.begin(), m_arenaIndices.end());
+		pIndices = shortIndices.data();
+		indexBytes = shortIndices.size() * sizeof(GLushort);
+	}
+
+	const void* pBlobs[MeshFile::BLOB_COUNT] =
+	{
+		m_arenaVertices.data(),
+		compactVertices.data(),
+		m_compactVertices.data(),
+		pIndices
+	};
+	const size_t blobSizes[MeshFile::BLOB_COUNT] =
+	{
+		m_arenaVertices.size() * sizeof(GLfloat),
+		compactVertices.size() * sizeof(COMPACT_VERTEX),
+		m_compactVertices.size() * sizeof(GLfloat),
+		indexBytes
+	};
+
+	MeshFile::HEADER header;
+	memset(&header, 0, sizeof(header));
+	header.indexType = GetArenaIndexType();
+	header.maxIndex = m_arenaMaxIndex;
+	header.blobStrides[MeshFile::BLOB_VERTICES] = VERTEX_FLOATS * sizeof(GLfloat);
+	header.blobStrides[MeshFile::BLOB_COMPACT_VERTICES] = sizeof(COMPACT_VERTEX);
+	header.blobStrides[MeshFile::BLOB_COMPACT_FLOATS] = VERTEX_FLOATS * sizeof(GLfloat);
+	header.blobStrides[MeshFile::BLOB_INDICES] = (GetArenaIndexType() == GL_UNSIGNED_SHORT) ?
+		sizeof(GLushort) : sizeof(GLuint);
+	return(MeshFile::Write(filename, header, shapes, meshes, stats, pBlobs, blobSizes, bEncode));
+}
+
+///////////////////////////////////////////////////
+//	LoadBakedMeshes()
+//
+//	Map a file written by SaveBakedMeshes() and, as
+//  long as every shape in it is still requested at
+//  the tessellation and layout it was baked at,
+//  create the arena buffers with one storage call
+//  per blob from the mapping. Only the CPU copies
+//  of the arena are copied out of it, and the
+//  indices checked against their meshes on the way.
+//  Coded blobs are decoded into the CPU copies, and
+//  the compact vertices, which have none, straight
+//  into the mapping of their buffer. Shapes the
+//  file does not hold are generated when first
+//  drawn, as before.
+///////////////////////////////////////////////////
+bool ShapeMeshes::LoadBakedMeshes(const char* filename)
+{
+	if ((m_arenaVertices.empty() == false) || (m_compactVertices.empty() == false) ||
+		(m_arenaIndices.empty() == false))
+	{
+		return(false);
+	}
+
+	MeshFile file;
+	if (file.Open(filename) == false)
+	{
+		return(false);
+	}
+
+	const MeshFile::HEADER& header = file.GetHeader();
+	const size_t vertexBytes = VERTEX_FLOATS * sizeof(GLfloat);
+	const size_t indexSize = (header.indexType == GL_UNSIGNED_SHORT) ? sizeof(GLushort) :
+		((header.indexType == GL_UNSIGNED_INT) ? sizeof(GLuint) : 0);
+	const size_t fullVertexCount = (size_t)header.blobSizes[MeshFile::BLOB_VERTICES] / vertexBytes;
+	const size_t compactVertexCount = (size_t)header.blobSizes[MeshFile::BLOB_COMPACT_FLOATS] / vertexBytes;
+	bool bValid = (indexSize > 0) &&
+		((header.blobSizes[MeshFile::BLOB_VERTICES] % vertexBytes) == 0) &&
+		((header.blobSizes[MeshFile::BLOB_COMPACT_FLOATS] % vertexBytes) == 0) &&
+		(header.blobSizes[MeshFile::BLOB_COMPACT_VERTICES] == compactVertexCount * COMPACT_VERTEX_BYTES) &&
+		((header.blobSizes[MeshFile::BLOB_INDICES] % indexSize) == 0) &&
+		((file.IsEncoded(MeshFile::BLOB_INDICES) == false) ||
+			(header.blobStrides[MeshFile::BLOB_INDICES] == indexSize));
+	const size_t indexCount = (size_t)header.blobSizes[MeshFile::BLOB_INDICES] / ((indexSize > 0) ? indexSize : 1);
+
+	// the CPU copy of the indices, which the checks read, and the
+	// indices as GL takes them, decoded when they are coded
+	std::vector<GLuint> indices;
+	std::vector<unsigned char> decodedIndices;
+	const void* pIndices = file.GetBlob(MeshFile::BLOB_INDICES);
+	if ((bValid == true) && (file.IsEncoded(MeshFile::BLOB_INDICES) == true))
+	{
+		decodedIndices.resize((size_t)header.blobSizes[MeshFile::BLOB_INDICES]);
+		pIndices = file.DecodeBlob(MeshFile::BLOB_INDICES, decodedIndices.data()) ? decodedIndices.data() : NULL;
+	}
+	if (bValid == true)
+	{
+		if (NULL == pIndices)
+		{
+			bValid = false;
+		}
+		else if (indexSize == sizeof(GLushort))
+		{
+			indices.assign((const GLushort*)pIndices, (const GLushort*)pIndices + indexCount);
+		}
+		else
+		{
+			indices.assign((const GLuint*)pIndices, (const GLuint*)pIndices + indexCount);
+		}
+	}
+
+	// every shape has to be asked for the way it was baked, and each
+	// of its meshes has to stay inside the blobs
+	const MeshFile::SHAPE* pShapes = file.GetShapes();
+	const MeshFile::MESH* pMeshRecords = file.GetMeshes();
+	GLuint maxIndex = 0;
+	for (uint32_t i = 0; (i < header.shapeCount) && (bValid == true); i++)
+	{
+		const MeshFile::SHAPE& shapeRecord = pShapes[i];
+		bValid = (shapeRecord.shape >= 0) && (shapeRecord.shape < SHAPE_COUNT);
+		if (bValid == false)
+		{
+			break;
+		}
+
+		const MESH_SLOT& slot = m_meshSlots[shapeRecord.shape];
+		GLMesh* pMeshes[MESH_LOD_COUNT];
+		bValid = (shapeRecord.meshCount == (uint32_t)GetShapeMeshes((MESH_SHAPE)shapeRecord.shape, pMeshes)) &&
+			(shapeRecord.firstMesh <= header.meshCount) &&
+			(shapeRecord.meshCount <= header.meshCount - shapeRecord.firstMesh) &&
+			((shapeRecord.bCompact != 0) == slot.bCompact) &&
+			(shapeRecord.resolution[0] == slot.resolution[0]) &&
+			(shapeRecord.resolution[1] == slot.resolution[1]) &&
+			(shapeRecord.thickness == slot.thickness);
+		for (uint32_t j = 0; (j < shapeRecord.meshCount) && (bValid == true); j++)
+		{
+			const MeshFile::MESH& meshRecord = pMeshRecords[shapeRecord.firstMesh + j];
+			size_t layoutVertices = (meshRecord.bCompact != 0) ? compactVertexCount : fullVertexCount;
+			bValid = ((meshRecord.bCompact != 0) == slot.bCompact) &&
+				((size_t)meshRecord.baseVertex + meshRecord.nVertices <= layoutVertices) &&
+				((size_t)meshRecord.firstIndex + meshRecord.nIndices <= indexCount);
+			for (GLuint k = 0; (k < meshRecord.nIndices) && (bValid == true); k++)
+			{
+				bValid = (indices[meshRecord.firstIndex + k] < meshRecord.nVertices);
+			}
+			if ((bValid == true) && (meshRecord.nVertices > 0))
+			{
+				maxIndex = glm::max(maxIndex, meshRecord.nVertices - 1);
+			}
+		}
+	}
+	bValid = bValid && ((indexSize == sizeof(GLuint)) || (maxIndex <= 0xFFFF));
+	if (bValid == false)
+	{
+		std::cout << "Baked mesh file " << filename << " does not match the meshes requested" << std::endl;
+		return(false);
+	}
+
+	// the CPU copies of the vertices, and the compact vertices GL
+	// takes, decoded into their buffer before anything is kept
+	std::vector<GLfloat> vertices(fullVertexCount * VERTEX_FLOATS);
+	std::vector<GLfloat> compactFloats(compactVertexCount * VERTEX_FLOATS);
+	bValid = file.DecodeBlob(MeshFile::BLOB_VERTICES, vertices.data()) &&
+		file.DecodeBlob(MeshFile::BLOB_COMPACT_FLOATS, compactFloats.data());
+	GLuint compactVertexBuffer = 0;
+	if ((bValid == true) && (compactFloats.empty() == false))
+	{
+		if (file.IsEncoded(MeshFile::BLOB_COMPACT_VERTICES) == true)
+		{
+			compactVertexBuffer = CreateDecodedBuffer(
+				(GLsizeiptr)header.blobSizes[MeshFile::BLOB_COMPACT_VERTICES],
+				[](const void* pFile, void* pDestination)
+				{
+					return(((const MeshFile*)pFile)->DecodeBlob(MeshFile::BLOB_COMPACT_VERTICES, pDestination));
+				},
+				&file, "mesh arena compact vertices");
+		}
+		else
+		{
+			compactVertexBuffer = CreateStaticBuffer(
+				(GLsizeiptr)header.blobSizes[MeshFile::BLOB_COMPACT_VERTICES],
+				file.GetBlob(MeshFile::BLOB_COMPACT_VERTICES), "mesh arena compact vertices");
+		}
+		bValid = (0 != compactVertexBuffer);
+	}
+	if (bValid == false)
+	{
+		std::cout << "Baked mesh file " << filename << " holds damaged blobs" << std::endl;
+		return(false);
+	}
+
+	m_arenaVertices.swap(vertices);
+	m_compactVertices.swap(compactFloats);
+	m_arenaIndices.swap(indices);
+	m_arenaMaxIndex = maxIndex;
+
+	if ((0 == m_arenaVAO) && (m_arenaVertices.empty() == false))
+	{
+		m_arenaVAO = CreateVertexArray(false, "mesh arena");
+	}
+	if ((0 == m_compactVAO) && (m_compactVertices.empty() == false))
+	{
+		m_compactVAO = CreateVertexArray(true, "compact mesh arena");
+	}
+
+	for (uint32_t i = 0; i < header.shapeCount; i++)
+	{
+		const MeshFile::SHAPE& shapeRecord = pShapes[i];
+		GLMesh* pMeshes[MESH_LOD_COUNT];
+		GetShapeMeshes((MESH_SHAPE)shapeRecord.shape, pMeshes);
+		for (uint32_t j = 0; j < shapeRecord.meshCount; j++)
+		{
+			const MeshFile::MESH& meshRecord = pMeshRecords[shapeRecord.firstMesh + j];
+			GLMesh& mesh = *pMeshes[j];
+			mesh.bCompact = (meshRecord.bCompact != 0);
+			mesh.vao = (mesh.bCompact == true) ? m_compactVAO : m_arenaVAO;
+			mesh.nVertices = meshRecord.nVertices;
+			mesh.nIndices = meshRecord.nIndices;
+			mesh.baseVertex = meshRecord.baseVertex;
+			mesh.firstIndex = meshRecord.firstIndex;
+			mesh.slices = meshRecord.slices;
+			mesh.firstMeshlet = 0;
+			mesh.meshletCount = 0;
+			mesh.bProcedural = false;
+			mesh.lodError = 0.0f;
+			mesh.bounds.minXYZ = glm::vec3(meshRecord.minXYZ[0], meshRecord.minXYZ[1], meshRecord.minXYZ[2]);
+			mesh.bounds.maxXYZ = glm::vec3(meshRecord.maxXYZ[0], meshRecord.maxXYZ[1], meshRecord.maxXYZ[2]);
+			mesh.bounds.center = glm::vec3(meshRecord.center[0], meshRecord.center[1], meshRecord.center[2]);
+			mesh.bounds.radius = meshRecord.radius;
+		}
+		SetShapeParts((MESH_SHAPE)shapeRecord.shape);
+		m_meshSlots[shapeRecord.shape].bLoaded = true;
+	}
+
+	// the names are reserved up front so the stats can point at them
+	const MeshFile::STATS* pStats = file.GetStats();
+	m_bakedNames.reserve(header.statsCount);
+	for (uint32_t i = 0; i < header.statsCount; i++)
+	{
+		m_bakedNames.push_back(std::string(pStats[i].name,
+			std::find(pStats[i].name, pStats[i].name + MeshFile::NAME_LENGTH, '\0')));
+
+		MESH_STATS stats;
+		stats.name = m_bakedNames.back().c_str();
+		stats.bCompact = (pStats[i].bCompact != 0);
+		stats.vertexCount = pStats[i].vertexCount;
+		stats.triangleCount = pStats[i].triangleCount;
+		stats.before.acmr = pStats[i].acmrBefore;
+		stats.before.atvr = pStats[i].atvrBefore;
+		stats.after.acmr = pStats[i].acmrAfter;
+		stats.after.atvr = pStats[i].atvrAfter;
+		m_meshStats.push_back(stats);
+	}
+
+	// GL copies the blobs, so the mapping can go once they are in;
+	// the full vertices are the same bytes as their CPU copy
+	if (m_arenaVertices.empty() == false)
+	{
+		m_arenaBuffers[0] = CreateStaticBuffer(
+			(GLsizeiptr)header.blobSizes[MeshFile::BLOB_VERTICES], m_arenaVertices.data(), "mesh arena vertices");
+	}
+	m_compactVertexBuffer = compactVertexBuffer;
+	if (m_arenaIndices.empty() == false)
+	{
+		m_arenaBuffers[1] = CreateStaticBuffer(
+			(GLsizeiptr)header.blobSizes[MeshFile::BLOB_INDICES], pIndices, "mesh arena indices");
+	}
+	if (0 != m_arenaVAO)
+	{
+		AttachMeshBuffers(m_arenaVAO, m_arenaBuffers[0], m_arenaBuffers[1]);
+	}
+	if (0 != m_compactVAO)
+	{
+		AttachMeshBuffers(m_compactVAO, m_compactVertexBuffer, m_arenaBuffers[1], true);
+	}
+
+	m_bArenaDirty = false;
+	m_bArenaGarbage = false;
+	TrackHostCopies();
+	return(true);
+}
+
+///////////////////////////////////////////////////
+//	HasDirectStateAccess()
+//
+//	True when the context can create and fill GL
+//  objects through their names, so creating them
+//  leaves the bindings the draws use untouched.
+///////////////////////////////////////////////////
+bool ShapeMeshes::HasDirectStateAccess()
+{
+	return((GLEW_VERSION_4_5 == GL_TRUE) || (GLEW_ARB_direct_state_access == GL_TRUE));
+}
+
+///////////////////////////////////////////////////
+//	HasVertexAttribBinding()
+//
+//	True when a VAO keeps the format of its vertex
+//  attributes apart from the buffers they read, so
+//  a VAO set up once per vertex format only has its
+//  buffer bindings changed after that.
+///////////////////////////////////////////////////
+bool ShapeMeshes::HasVertexAttribBinding()
+{
+	return((GLEW_VERSION_4_3 == GL_TRUE) || (GLEW_ARB_vertex_attrib_binding == GL_TRUE));
+}
+
+///////////////////////////////////////////////////
+//	CreateVertexArray()
+//
+//	Create a VAO for one vertex format. With direct
+//  state access it exists from creation and gets
+//  its format through the glVertexArray*() calls;
+//  with vertex attribute binding it is bound once
+//  to set the format. Otherwise it only gets a name
+//  until AttachMeshBuffers() binds it, and the
+//  format is set there with the buffer.
+///////////////////////////////////////////////////
+GLuint ShapeMeshes::CreateVertexArray(bool bCompact, const char* label)
+{
+	GLuint vao = 0;
+	if (HasDirectStateAccess() == true)
+	{
+		glCreateVertexArrays(1, &vao);
+		if (bCompact == true)
+		{
+			glVertexArrayAttribFormat(vao, 0, g_FloatsPerVertex, GL_HALF_FLOAT, GL_FALSE,
+				offsetof(COMPACT_VERTEX, position));
+			glVertexArrayAttribFormat(vao, 1, 4, GL_INT_2_10_10_10_REV, GL_TRUE,
+				offsetof(COMPACT_VERTEX, normal));
+			glVertexArrayAttribFormat(vao, 2, g_FloatsPerUV, GL_HALF_FLOAT, GL_FALSE,
+				offsetof(COMPACT_VERTEX, uv));
+		}
+		else
+		{
+			glVertexArrayAttribFormat(vao, 0, g_FloatsPerVertex, GL_FLOAT, GL_FALSE, 0);
+			glVertexArrayAttribFormat(vao, 1, g_FloatsPerNormal, GL_FLOAT, GL_FALSE,
+				sizeof(GLfloat) * g_FloatsPerVertex);
+			glVertexArrayAttribFormat(vao, 2, g_FloatsPerUV, GL_FLOAT, GL_FALSE,
+				sizeof(GLfloat) * (g_FloatsPerVertex + g_FloatsPerNormal));
+		}
+		for (GLuint attribute = 0; attribute < 3; attribute++)
+		{
+			glVertexArrayAttribBinding(vao, attribute, 0);
+			glEnableVertexArrayAttrib(vao, attribute);
+		}
+	}
+	else
+	{
+		glGenVertexArrays(1, &vao);
+		if (HasVertexAttribBinding() == true)
+		{
+			BindVertexArray(vao);
+			SetShaderMemoryLayout(bCompact);
+		}
+	}
+	// a VAO only generated has no object to label until it is bound
+	if ((NULL != label) && (glIsVertexArray(vao) == GL_TRUE))
+	{
+		GLDebug::Label(GL_VERTEX_ARRAY, vao, label);
+	}
+	return(vao);
+}
+
+///////////////////////////////////////////////////
+//	CreateStaticBuffer()
+//
+//	Create a buffer filled with the passed in data
+//  that never changes. Without direct state access
+//  it is filled through the copy write target, which
+//  no VAO or draw reads. Its memory is counted in
+//  the category, under the label.
+///////////////////////////////////////////////////
+GLuint ShapeMeshes::CreateStaticBuffer(GLsizeiptr size, const void* pData, const char* label,
+	GPUMemory::CATEGORY category)
+{
+	GLuint buffer = 0;
+	if (HasDirectStateAccess() == true)
+	{
+		glCreateBuffers(1, &buffer);
+		glNamedBufferStorage(buffer, size, pData, 0);
+	}
+	else
+	{
+		glGenBuffers(1, &buffer);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+		glBufferData(GL_COPY_WRITE_BUFFER, size, pData, GL_STATIC_DRAW);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	}
+	if (NULL != pData)
+	{
+		s_bindStats.bufferBytes += (unsigned long long)size;
+	}
+	GPUMemory::TrackBuffer(buffer, (long long)size, category, label);
+	if (NULL != label)
+	{
+		GLDebug::Label(GL_BUFFER, buffer, label);
+	}
+	return(buffer);
+}
+
+///////////////////////////////////////////////////
+//	CreateDecodedBuffer()
+//
+//	Create a buffer whose storage is only ever
+//  written through one mapping, which the decoder
+//  fills in place of a copy from memory. The
+//  mapping invalidates the storage, so the driver
+//  has nothing to keep, and the decoder is run on
+//  the calling thread, which may spread it over
+//  threads of its own.
+///////////////////////////////////////////////////
+GLuint ShapeMeshes::CreateDecodedBuffer(GLsizeiptr size, BufferDecoder pDecoder, const void* pContext,
+	const char* label, GPUMemory::CATEGORY category)
+{
+	const GLbitfield access = GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT;
+	GLuint buffer = 0;
+	bool bDecoded = false;
+	if (HasDirectStateAccess() == true)
+	{
+		glCreateBuffers(1, &buffer);
+		glNamedBufferStorage(buffer, size, NULL, GL_MAP_WRITE_BIT);
+		void* pMapping = glMapNamedBufferRange(buffer, 0, size, access);
+		if (NULL != pMapping)
+		{
+			bDecoded = pDecoder(pContext, pMapping);
+			// the storage is lost when the unmap fails
+			bDecoded = (glUnmapNamedBuffer(buffer) == GL_TRUE) && bDecoded;
+		}
+	}
+	else
+	{
+		glGenBuffers(1, &buffer);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+		glBufferData(GL_COPY_WRITE_BUFFER, size, NULL, GL_STATIC_DRAW);
+		void* pMapping = glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, size, access);
+		if (NULL != pMapping)
+		{
+			bDecoded = pDecoder(pContext, pMapping);
+			bDecoded = (glUnmapBuffer(GL_COPY_WRITE_BUFFER) == GL_TRUE) && bDecoded;
+		}
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	}
+	if (bDecoded == false)
+	{
+		glDeleteBuffers(1, &buffer);
+		return(0);
+	}
+
+	s_bindStats.bufferBytes += (unsigned long long)size;
+	GPUMemory::TrackBuffer(buffer, (long long)size, category, label);
+	if (NULL != label)
+	{
+		GLDebug::Label(GL_BUFFER, buffer, label);
+	}
+	return(buffer);
+}
+
+///////////////////////////////////////////////////
+//	AttachMeshBuffers()
+//
+//	Attach the buffers holding the vertices of the
+//  format a VAO was created for, and its indices.
+//  The format is already in the VAO unless neither
+//  direct state access nor vertex attribute binding
+//  is there, in which case the VAO is bound and the
+//  attribute pointers set with the buffer. The
+//  compact layout is turned back into floats by the
+//  vertex fetch: half floats widen and the
+//  normalized normal bits scale to -1 to 1.
+///////////////////////////////////////////////////
+void ShapeMeshes::AttachMeshBuffers(GLuint vao, GLuint vertexBuffer, GLuint indexBuffer, bool bCompact,
+	GLintptr vertexOffset)
+{
+	if (HasDirectStateAccess() == true)
+	{
+		glVertexArrayVertexBuffer(vao, 0, vertexBuffer, vertexOffset, GetVertexStride(bCompact));
+		glVertexArrayElementBuffer(vao, indexBuffer);
+		return;
+	}
+
+	BindVertexArray(vao);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+	if (HasVertexAttribBinding() == true)
+	{
+		glBindVertexBuffer(0, vertexBuffer, vertexOffset, GetVertexStride(bCompact));
+		return;
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+	SetShaderMemoryLayout(bCompact, vertexOffset);
+}
+
+///////////////////////////////////////////////////
+//	SubmitDraw()
+//
+//	Hand one draw range of a mesh to the recorder if
+//  one is set, otherwise draw it right away. first
+//  is relative to the start of the mesh.
+///////////////////////////////////////////////////
+void ShapeMeshes::SubmitDraw(
+	const GLMesh& mesh,
+	GLenum mode,
+	GLint first,
+	GLsizei count,
+	const GLMesh* pLODMeshes,
+	const GLint* pLODFirsts,
+	const GLsizei* pLODCounts,
+	bool bClosed)
+{
+	DRAW_RANGE drawRange;
+	drawRange.vao = mesh.vao;
+	drawRange.mode = mode;
+	drawRange.count = count;
+	drawRange.bIndexed = (mesh.nIndices > 0);
+	drawRange.bounds = mesh.bounds;
+	if (drawRange.bIndexed == true)
+	{
+		drawRange.first = mesh.firstIndex + first;
+		drawRange.baseVertex = mesh.baseVertex;
+	}
+	else
+	{
+		drawRange.first = mesh.baseVertex + first;
+		drawRange.baseVertex = 0;
+	}
+
+	drawRange.lodLevels = 1;
+	drawRange.lods[0].first = drawRange.first;
+	drawRange.lods[0].count = drawRange.count;
+	drawRange.lods[0].baseVertex = drawRange.baseVertex;
+	drawRange.lods[0].error = 0.0f;
+	// only a draw of the whole mesh covers all of its meshlets
+	drawRange.firstMeshlet = mesh.firstMeshlet;
+	drawRange.meshletCount = ((first == 0) && (count == (GLsizei)mesh.nIndices)) ? mesh.meshletCount : 0;
+	drawRange.bClosed = bClosed;
+	if ((NULL != pLODMeshes) && (NULL != pLODFirsts) && (NULL != pLODCounts))
+	{
+		// the coarser levels keep the bounds of the finest, so a
+		// draw does not change its culling volume when it switches
+		for (int i = 0; i < MESH_LOD_COUNT - 1; i++)
+		{
+			const GLMesh& lodMesh = pLODMeshes[i];
+			LOD_RANGE& lodRange = drawRange.lods[i + 1];
+			lodRange.count = pLODCounts[i];
+			lodRange.error = lodMesh.lodError;
+			if (drawRange.bIndexed == true)
+			{
+				lodRange.first = lodMesh.firstIndex + pLODFirsts[i];
+				lodRange.baseVertex = lodMesh.baseVertex;
+			}
+			else
+			{
+				lodRange.first = lodMesh.baseVertex + pLODFirsts[i];
+				lodRange.baseVertex = 0;
+			}
+		}
+		drawRange.lodLevels = MESH_LOD_COUNT;
+	}
+
+	// recorded ranges are drawn later, once the caller uploads the
+	// arena, so a recording generating meshes uploads them once;
+	// the index type is the one the upload picks
+	if (NULL == m_drawRecorder)
+	{
+		UploadArena();
+	}
+	drawRange.indexType = GetArenaIndexType();
+
+	if (NULL != m_drawRecorder)
+	{
+		m_drawRecorder(m_pDrawRecorderContext, drawRange);
+		return;
+	}
+
+	DrawRange(drawRange);
+}
+
+///////////////////////////////////////////////////
+//	Load*Mesh()
+//
+//	Request a shape at the given tessellation, in the
+//  vertex layout SetCompactVertices() last chose.
+//  The mesh is generated the first time it is
+//  drawn, so only the shapes a scene uses take
+//  time and memory; a request matching the current
+//  one is ignored, and one changing it regenerates
+//  the mesh on its next draw.
+///////////////////////////////////////////////////
+void ShapeMeshes::LoadBoxMesh(int divisions)
+{
+	RequestMesh(SHAPE_BOX, divisions, 0, 0.0f);
+}
+void ShapeMeshes::LoadConeMesh(int slices)
+{
+	RequestMesh(SHAPE_CONE, slices, 0, 0.0f);
+}
+void ShapeMeshes::LoadCylinderMesh(int slices)
+{
+	RequestMesh(SHAPE_CYLINDER, slices, 0, 0.0f);
+}
+void ShapeMeshes::LoadPlaneMesh(int divisions)
+{
+	RequestMesh(SHAPE_PLANE, divisions, 0, 0.0f);
+}
+void ShapeMeshes::LoadPrismMesh(int divisions)
+{
+	RequestMesh(SHAPE_PRISM, divisions, 0, 0.0f);
+}
+void ShapeMeshes::LoadPyramid3Mesh(int divisions)
+{
+	RequestMesh(SHAPE_PYRAMID3, divisions, 0, 0.0f);
+}
+void ShapeMeshes::LoadPyramid4Mesh(int divisions)
+{
+	RequestMesh(SHAPE_PYRAMID4, divisions, 0, 0.0f);
+}
+void ShapeMeshes::LoadSphereMesh(int bands, int slices)
+{
+	RequestMesh(SHAPE_SPHERE, bands, slices, 0.0f);
+}
+void ShapeMeshes::LoadTaperedCylinderMesh(int slices)
+{
+	RequestMesh(SHAPE_TAPERED_CYLINDER, slices, 0, 0.0f);
+}
+void ShapeMeshes::LoadTorusMesh(float thickness)
+{
+	RequestMesh(SHAPE_TORUS, 0, 0, thickness);
 }
 
-ShapeMeshes::ShapeMeshes()
+///////////////////////////////////////////////////
+//	RequestMesh()
+//
+//	Remember the tessellation and layout a shape is
+//  to be generated with. A loaded mesh the request
+//  changes stays in the arena for the ranges already
+//  recorded from it, until the arena is released.
+///////////////////////////////////////////////////
+void ShapeMeshes::RequestMesh(
+	MESH_SHAPE shape,
+	int resolution0,
+	int resolution1,
+	float thickness)
+{
+	MESH_SLOT& slot = m_meshSlots[shape];
+	if ((slot.resolution[0] == resolution0) && (slot.resolution[1] == resolution1) &&
+		(slot.thickness == thickness) && (slot.bCompact == m_bCompactVertices))
+	{
+		return;
+	}
+
+	if (slot.bLoaded == true)
+	{
+		slot.bLoaded = false;
+		m_bArenaGarbage = true;
+	}
+	slot.resolution[0] = resolution0;
+	slot.resolution[1] = resolution1;
+	slot.thickness = thickness;
+	slot.bCompact = m_bCompactVertices;
+}
+
+///////////////////////////////////////////////////
+//	UseMesh()
+//
+//	Generate a shape into the arena the first time
+//  one of its draws needs it, with its LOD levels,
+//  and count the draw as a reference to it.
+///////////////////////////////////////////////////
+void ShapeMeshes::UseMesh(
+	MESH_SHAPE shape)
+{
+	MESH_SLOT& slot = m_meshSlots[shape];
+	slot.references++;
+	if (slot.bLoaded == true)
+	{
+		return;
+	}
+
+	// the mesh goes to the arena of the layout it was requested in
+	bool bCompactVertices = m_bCompactVertices;
+	m_bCompactVertices = slot.bCompact;
+	switch (shape)
+	{
+	case SHAPE_BOX:
+		BuildBoxMesh(slot.resolution[0]);
+		break;
+	case SHAPE_CONE:
+		BuildConeMesh(slot.resolution[0]);
+		break;
+	case SHAPE_CYLINDER:
+		BuildCylinderMesh(slot.resolution[0]);
+		break;
+	case SHAPE_PLANE:
+		BuildPlaneMesh(slot.resolution[0]);
+		break;
+	case SHAPE_PRISM:
+		BuildPrismMesh(slot.resolution[0]);
+		break;
+	case SHAPE_PYRAMID3:
+		BuildPyramid3Mesh(slot.resolution[0]);
+		break;
+	case SHAPE_PYRAMID4:
+		BuildPyramid4Mesh(slot.resolution[0]);
+		break;
+	case SHAPE_SPHERE:
+		BuildSphereMesh(slot.resolution[0], slot.resolution[1]);
+		break;
+	case SHAPE_TAPERED_CYLINDER:
+		BuildTaperedCylinderMesh(slot.resolution[0]);
+		break;
+	case SHAPE_TORUS:
+		BuildTorusMesh(slot.thickness);
+		break;
+	default:
+		break;
+	}
+	m_bCompactVertices = bCompactVertices;
+	SetShapeParts(shape);
+	slot.bLoaded = true;
+}
+
+///////////////////////////////////////////////////
+//	UseModelMesh()
+//
+//	Count a draw of a model mesh, generating it into
+//  the full float arena the first time, followed by
+//  its coarser LOD levels, the ones simplified when
+//  it was added or else clustered now. A level that
+//  would not drop enough triangles draws the level
+//  above it. Its CPU copy is restored before and
+//  dropped after by its retention policy.
+///////////////////////////////////////////////////
+void ShapeMeshes::UseModelMesh(int modelMesh)
+{
+	MODEL_MESH& model = m_modelMeshes[modelMesh];
+	model.references++;
+	if ((model.bLoaded == true) || (model.bLost == true))
+	{
+		return;
+	}
+	if (RestoreModelMesh(modelMesh) == false)
+	{
+		std::cout << "Could not restore the vertices of model mesh " << model.name
+			<< ", it is not drawn" << std::endl;
+		model.bLost = true;
+		return;
+	}
+
+	bool bCompactVertices = m_bCompactVertices;
+	m_bCompactVertices = false;
+	AddMeshToArena(model.mesh, model.name.c_str(), model.vertices.data(), model.vertices.size(),
+		model.indices.data(), model.indices.size());
+	if (m_bBuildMeshlets == true)
+	{
+		BuildArenaMeshlets(model.mesh);
+	}
+
+	const GLMesh* pAbove = &model.mesh;
+	const GLfloat* pVertices = model.vertices.data();
+	GLuint vertexCount = (GLuint)(model.vertices.size() / VERTEX_FLOATS);
+	std::vector<GLfloat> lodVertices[MESH_LOD_COUNT - 1];
+	std::vector<GLuint> lodIndices[MESH_LOD_COUNT - 1];
+	for (int i = 0; i < MESH_LOD_COUNT - 1; i++)
+	{
+		const std::vector<GLfloat>* pLODVertices = &model.lodVertices[i];
+		const std::vector<GLuint>* pLODIndices = &model.lodIndices[i];
+		float lodError = model.lodErrors[i];
+		if (pLODIndices->empty() == true)
+		{
+			// each level clusters the full mesh, not the level above;
+			// a vertex moves at most across its cell
+			MeshOptimizer::SimplifyMesh(pVertices, vertexCount, VERTEX_FLOATS,
+				model.indices.data(), model.indices.size(), g_ModelLODCells[i], lodVertices[i], lodIndices[i]);
+			glm::vec3 extent = model.mesh.bounds.maxXYZ - model.mesh.bounds.minXYZ;
+			lodError = glm::sqrt(3.0f) * glm::max(glm::max(extent.x, extent.y), extent.z) / (float)g_ModelLODCells[i];
+			pLODVertices = &lodVertices[i];
+			pLODIndices = &lodIndices[i];
+		}
+		size_t triangles = pLODIndices->size() / 3;
+		if ((triangles == 0) || ((float)triangles > g_ModelLODKeepRatio * (float)(pAbove->nIndices / 3)))
+		{
+			model.lods[i] = *pAbove;
+			continue;
+		}
+		AddMeshToArena(model.lods[i], model.lodNames[i].c_str(), pLODVertices->data(), pLODVertices->size(),
+			pLODIndices->data(), pLODIndices->size());
+		model.lods[i].lodError = lodError;
+		pAbove = &model.lods[i];
+	}
+	m_bCompactVertices = bCompactVertices;
+	model.bLoaded = true;
+
+	DropModelMesh(model);
+	TrackHostCopies();
+}
+
+///////////////////////////////////////////////////
+//	RestoreModelMesh()
+//
+//	Bring back the CPU copy of a model mesh its
+//  policy dropped, from its coding, from the arena
+//  while it is still there, or from the source;
+//  false when none of them has it.
+///////////////////////////////////////////////////
+bool ShapeMeshes::RestoreModelMesh(int modelMesh)
+{
+	MODEL_MESH& model = m_modelMeshes[modelMesh];
+	if (model.vertices.empty() == false)
+	{
+		return(true);
+	}
+
+	if (model.bCoded == true)
+	{
+		bool bDecoded = true;
+		for (int level = 0; level < MESH_LOD_COUNT; level++)
+		{
+			std::vector<GLfloat>& vertices = (level == 0) ? model.vertices : model.lodVertices[level - 1];
+			std::vector<GLuint>& indices = (level == 0) ? model.indices : model.lodIndices[level - 1];
+			const MESH_CODE& code = model.coded[level];
+			vertices.resize(code.vertexCount * VERTEX_FLOATS);
+			indices.resize(code.indexCount);
+			if (code.vertexCount > 0)
+			{
+				bDecoded = bDecoded && MeshCodec::DecodeVertices(code.vertices.data(), code.vertices.size(),
+					vertices.data(), code.vertexCount, VERTEX_FLOATS * sizeof(GLfloat));
+			}
+			if (code.indexCount > 0)
+			{
+				bDecoded = bDecoded && MeshCodec::DecodeIndices(code.indices.data(), code.indices.size(),
+					indices.data(), code.indexCount, sizeof(GLuint));
+			}
+		}
+		return(bDecoded);
+	}
+
+	if (model.bLoaded == true)
+	{
+		CopyBackModelMesh(model);
+		return(true);
+	}
+
+	if (NULL != m_modelMeshSource)
+	{
+		return((m_modelMeshSource(m_pModelMeshSourceContext, modelMesh, model.vertices, model.indices,
+			model.lodVertices, model.lodIndices, model.lodErrors) == true) &&
+			(model.vertices.empty() == false));
+	}
+	return(false);
+}
+
+///////////////////////////////////////////////////
+//	DropModelMesh()
+//
+//	Free the CPU copy of a model mesh in the arena
+//  its policy does not keep, coding it first for
+//  RETAIN_COMPRESSED. Until its first draw it keeps
+//  its copy, which would only be restored for it,
+//  and RETAIN_DERIVED keeps it without a source.
+///////////////////////////////////////////////////
+void ShapeMeshes::DropModelMesh(MODEL_MESH& model)
+{
+	if (model.bLoaded == false)
+	{
+		return;
+	}
+
+	switch (model.retention)
+	{
+	case RETAIN_COMPRESSED:
+		if ((model.bCoded == true) || (model.vertices.empty() == true))
+		{
+			break;
+		}
+		for (int level = 0; level < MESH_LOD_COUNT; level++)
+		{
+			const std::vector<GLfloat>& vertices = (level == 0) ? model.vertices : model.lodVertices[level - 1];
+			const std::vector<GLuint>& indices = (level == 0) ? model.indices : model.lodIndices[level - 1];
+			MESH_CODE& code = model.coded[level];
+			code.vertexCount = vertices.size() / VERTEX_FLOATS;
+			code.indexCount = indices.size();
+			MeshCodec::EncodeVertices(vertices.data(), code.vertexCount, VERTEX_FLOATS * sizeof(GLfloat),
+				code.vertices);
+			MeshCodec::EncodeIndices(indices.data(), code.indexCount, sizeof(GLuint), code.indices);
+		}
+		model.bCoded = true;
+		break;
+	case RETAIN_DERIVED:
+		if (NULL == m_modelMeshSource)
+		{
+			return;
+		}
+		break;
+	case RETAIN_GPU_ONLY:
+		break;
+	default:
+		return;
+	}
+
+	// swapped with empty vectors, as clear() keeps the capacity
+	std::vector<GLfloat>().swap(model.vertices);
+	std::vector<GLuint>().swap(model.indices);
+	for (int i = 0; i < MESH_LOD_COUNT - 1; i++)
+	{
+		std::vector<GLfloat>().swap(model.lodVertices[i]);
+		std::vector<GLuint>().swap(model.lodIndices[i]);
+	}
+}
+
+///////////////////////////////////////////////////
+//	CopyBackModelMesh()
+//
+//	Copy a model mesh and its levels out of the CPU
+//  copy of the arena, as they were generated into
+//  it. A level that drew the level above is left
+//  empty, to be clustered and passed over again.
+///////////////////////////////////////////////////
+void ShapeMeshes::CopyBackModelMesh(MODEL_MESH& model)
+{
+	for (int level = 0; level < MESH_LOD_COUNT; level++)
+	{
+		const GLMesh& mesh = (level == 0) ? model.mesh : model.lods[level - 1];
+		std::vector<GLfloat>& vertices = (level == 0) ? model.vertices : model.lodVertices[level - 1];
+		std::vector<GLuint>& indices = (level == 0) ? model.indices : model.lodIndices[level - 1];
+		if (level > 0)
+		{
+			const GLMesh& above = (level == 1) ? model.mesh : model.lods[level - 2];
+			if ((mesh.firstIndex == above.firstIndex) && (mesh.nIndices == above.nIndices))
+			{
+				vertices.clear();
+				indices.clear();
+				model.lodErrors[level - 1] = 0.0f;
+				continue;
+			}
+			model.lodErrors[level - 1] = mesh.lodError;
+		}
+		const GLfloat* pVertices = &m_arenaVertices[(size_t)mesh.baseVertex * VERTEX_FLOATS];
+		vertices.assign(pVertices, pVertices + (size_t)mesh.nVertices * VERTEX_FLOATS);
+		indices.assign(m_arenaIndices.begin() + mesh.firstIndex,
+			m_arenaIndices.begin() + mesh.firstIndex + mesh.nIndices);
+	}
+}
+
+///////////////////////////////////////////////////
+//	TrackHostCopies()
+//
+//	Register the bytes the CPU copy of the arena and
+//  the copies and codings of the model meshes hold
+//  with the memory accounting.
+///////////////////////////////////////////////////
+void ShapeMeshes::TrackHostCopies()
+{
+	long long arenaBytes = (long long)((m_arenaVertices.size() + m_compactVertices.size()) * sizeof(GLfloat) +
+		(m_arenaIndices.size() + m_meshletVertices.size() + m_meshletTriangles.size()) * sizeof(GLuint) +
+		m_meshlets.size() * sizeof(MeshOptimizer::MESHLET));
+	GPUMemory::TrackHostCopy("mesh arena CPU copy", arenaBytes, GPUMemory::CATEGORY_MESH);
+
+	long long modelBytes = 0;
+	for (size_t i = 0; i < m_modelMeshes.size(); i++)
+	{
+		const MODEL_MESH& model = m_modelMeshes[i];
+		for (int level = 0; level < MESH_LOD_COUNT; level++)
+		{
+			const std::vector<GLfloat>& vertices = (level == 0) ? model.vertices : model.lodVertices[level - 1];
+			const std::vector<GLuint>& indices = (level == 0) ? model.indices : model.lodIndices[level - 1];
+			modelBytes += (long long)(vertices.capacity() * sizeof(GLfloat) + indices.capacity() * sizeof(GLuint) +
+				model.coded[level].vertices.capacity() + model.coded[level].indices.capacity());
+		}
+	}
+	GPUMemory::TrackHostCopy("model mesh sources", modelBytes, GPUMemory::CATEGORY_MESH);
+}
+
+///////////////////////////////////////////////////
+//	ResetMeshReferences()
+//
+//	Start counting the draws of every mesh again,
+//  before recording a new set of draws.
+///////////////////////////////////////////////////
+void ShapeMeshes::ResetMeshReferences()
+{
+	for (int shape = 0; shape < SHAPE_COUNT; shape++)
+	{
+		m_meshSlots[shape].references = 0;
+	}
+	for (size_t i = 0; i < m_modelMeshes.size(); i++)
+	{
+		m_modelMeshes[i].references = 0;
+	}
+}
+
+///////////////////////////////////////////////////
+//	ReleaseUnreferencedMeshes()
+//
+//	Free the arena when it holds meshes no draw used
+//  since ResetMeshReferences(), or meshes replaced
+//  by another tessellation. Freeing moves the meshes
+//  left, so it clears the whole arena and they are
+//  generated again by the draws recorded next; true
+//  when it did, as the draws recorded since the
+//  reset must then be recorded again.
+///////////////////////////////////////////////////
+bool ShapeMeshes::ReleaseUnreferencedMeshes()
+{
+	bool bRelease = m_bArenaGarbage;
+	for (int shape = 0; shape < SHAPE_COUNT; shape++)
+	{
+		if ((m_meshSlots[shape].bLoaded == true) && (0 == m_meshSlots[shape].references))
+		{
+			bRelease = true;
+		}
+	}
+	for (size_t i = 0; i < m_modelMeshes.size(); i++)
+	{
+		if ((m_modelMeshes[i].bLoaded == true) && (0 == m_modelMeshes[i].references))
+		{
+			bRelease = true;
+		}
+	}
+	if (bRelease == false)
+	{
+		return(false);
+	}
+
+	ClearArena();
+	return(true);
+}
+
+///////////////////////////////////////////////////
+//	ClearArena()
+//
+//	Delete the arena VAOs and buffers and empty their
+//  CPU copies, leaving every shape requested but not
+//  loaded.
+///////////////////////////////////////////////////
+void ShapeMeshes::ClearArena()
+{
+	// the meshes kept only on the GPU are about to lose it
+	for (size_t i = 0; i < m_modelMeshes.size(); i++)
+	{
+		MODEL_MESH& model = m_modelMeshes[i];
+		if ((model.bLoaded == true) && (model.vertices.empty() == true) && (model.bCoded == false) &&
+			(model.retention == RETAIN_GPU_ONLY))
+		{
+			CopyBackModelMesh(model);
+		}
+	}
+
+	GLuint vaos[2] = { m_arenaVAO, m_compactVAO };
+	for (int i = 0; i < 2; i++)
+	{
+		if (0 == vaos[i])
+		{
+			continue;
+		}
+		if (s_boundVAO == vaos[i])
+		{
+			s_boundVAO = 0;
+		}
+		glDeleteVertexArrays(1, &vaos[i]);
+	}
+	GPUMemory::DeleteBuffers(2, m_arenaBuffers);
+	GPUMemory::DeleteBuffers(1, &m_compactVertexBuffer);
+	ReleaseMeshletStorage();
+	m_arenaVAO = 0;
+	m_compactVAO = 0;
+	m_arenaBuffers[0] = 0;
+	m_arenaBuffers[1] = 0;
+	m_compactVertexBuffer = 0;
+
+	m_arenaVertices.clear();
+	m_compactVertices.clear();
+	m_arenaIndices.clear();
+	m_meshlets.clear();
+	m_meshletVertices.clear();
+	m_meshletTriangles.clear();
+	m_proceduralMeshes.clear();
+	m_bProceduralReadBack = false;
+	m_meshStats.clear();
+	m_bakedNames.clear();
+	m_arenaMaxIndex = 0;
+	m_bArenaDirty = false;
+	m_bArenaGarbage = false;
+
+	for (int shape = 0; shape < SHAPE_COUNT; shape++)
+	{
+		m_meshSlots[shape].bLoaded = false;
+		m_meshSlots[shape].references = 0;
+	}
+	for (size_t i = 0; i < m_modelMeshes.size(); i++)
+	{
+		m_modelMeshes[i].bLoaded = false;
+		m_modelMeshes[i].references = 0;
+	}
+	TrackHostCopies();
+}
+
+///////////////////////////////////////////////////
+//	GetShapeMeshes()
+//
+//	Get the mesh generated for a shape, followed by
+//  its coarser LOD levels when it has them.
+///////////////////////////////////////////////////
+int ShapeMeshes::GetShapeMeshes(
+	MESH_SHAPE shape,
+	GLMesh* pMeshes[MESH_LOD_COUNT])
+{
+	GLMesh* pLODs = NULL;
+	switch (shape)
+	{
+	case SHAPE_BOX:
+		pMeshes[0] = &m_BoxMesh;
+		break;
+	case SHAPE_CONE:
+		pMeshes[0] = &m_ConeMesh;
+		break;
+	case SHAPE_CYLINDER:
+		pMeshes[0] = &m_CylinderMesh;
+		pLODs = m_CylinderLODs;
+		break;
+	case SHAPE_PLANE:
+		pMeshes[0] = &m_PlaneMesh;
+		break;
+	case SHAPE_PRISM:
+		pMeshes[0] = &m_PrismMesh;
+		break;
+	case SHAPE_PYRAMID3:
+		pMeshes[0] = &m_Pyramid3Mesh;
+		break;
+	case SHAPE_PYRAMID4:
+		pMeshes[0] = &m_Pyramid4Mesh;
+		break;
+	case SHAPE_SPHERE:
+		pMeshes[0] = &m_SphereMesh;
+		pLODs = m_SphereLODs;
+		break;
+	case SHAPE_TAPERED_CYLINDER:
+		pMeshes[0] = &m_TaperedCylinderMesh;
+		break;
+	case SHAPE_TORUS:
+		pMeshes[0] = &m_TorusMesh;
+		pLODs = m_TorusLODs;
+		break;
+	default:
+		return(0);
+	}
+
+	if (NULL == pLODs)
+	{
+		return(1);
+	}
+	for (int i = 0; i < MESH_LOD_COUNT - 1; i++)
+	{
+		pMeshes[i + 1] = &pLODs[i];
+	}
+	return(MESH_LOD_COUNT);
+}
+
+///////////////////////////////////////////////////
+//	SetShapeParts()
+//
+//	Fill in the part ranges of a shape and its LOD
+//  levels from the way their generators order the
+//  indices: the sphere goes from the top pole down
+//  and the torus around its ring, so their first
+//  half is the upper half, and the radial meshes
+//  keep their caps and sides in the segments
+//  GetRadialRange() reads. Each of these is a
+//  segment of its own for the triangle optimizer,
+//  so the parts survive the reordering.
+///////////////////////////////////////////////////
+void ShapeMeshes::SetShapeParts(MESH_SHAPE shape)
+{
+	GLMesh* pMeshes[MESH_LOD_COUNT];
+	int meshCount = GetShapeMeshes(shape, pMeshes);
+	const bool bCone = (shape == SHAPE_CONE);
+	const bool bRadial = (bCone == true) || (shape == SHAPE_CYLINDER) || (shape == SHAPE_TAPERED_CYLINDER);
+
+	for (int i = 0; i < meshCount; i++)
+	{
+		GLMesh& mesh = *pMeshes[i];
+		for (int part = 0; part < PART_COUNT; part++)
+		{
+			mesh.parts[part].first = 0;
+			mesh.parts[part].count = 0;
+		}
+		mesh.parts[PART_WHOLE].count = (GLsizei)mesh.nIndices;
+
+		if ((shape == SHAPE_SPHERE) || (shape == SHAPE_TORUS))
+		{
+			mesh.parts[PART_HALF].count = (GLsizei)mesh.nIndices / 2;
+		}
+		else if (bRadial == true)
+		{
+			// every mix of the bottom, top and sides, the whole
+			// shape being all three without the copy of the bottom
+			for (int mask = 1; mask < 8; mask++)
+			{
+				bool bBottom = ((mask & 1) != 0);
+				bool bTop = ((mask & 2) != 0);
+				bool bSides = ((mask & 4) != 0);
+				PART_RANGE& range = mesh.parts[GetRadialPart(bTop, bBottom, bSides)];
+				if (GetRadialRange(mesh, (bCone == false), bCone, bBottom, bTop, bSides,
+					range.first, range.count) == false)
+				{
+					range.first = 0;
+					range.count = 0;
+				}
+			}
+		}
+	}
+}
+
+///////////////////////////////////////////////////
+//	GetArenaIndexType()
+//
+//	Indices count from the first vertex of their
+//  mesh, so 16 bits hold them while no mesh has
+//  more vertices than that.
+///////////////////////////////////////////////////
+GLenum ShapeMeshes::GetArenaIndexType() const
 {
-	m_bMemoryLayoutDone = false;
+	return((m_arenaMaxIndex <= 0xFFFF) ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT);
 }
 
 ///////////////////////////////////////////////////
-//	LoadBoxMesh()
+//	BuildBoxMesh()
 //
-//	Create a box mesh by specifying the vertices and 
-//  store it in a VAO/VBO.  The normals and texture
-//  coordinates are also set.
+//	Create a unit box mesh centered on the origin,
+//  each face split into divisions by divisions
+//  quads with texture coordinates from 0 to 1, and
+//  append it to the arena.
 //
 //	Correct triangle drawing command:
 //
 //	glDrawElements(GL_TRIANGLES, meshes.gBoxMesh.nIndices, GL_UNSIGNED_INT, (void*)0);
 ///////////////////////////////////////////////////
-void ShapeMeshes::LoadBoxMesh()
-{
-	// Position and Color data
-	GLfloat verts[] = {
-		//Positions				//Normals
-		// ------------------------------------------------------
-
-		//Back Face				//Negative Z Normal  Texture Coords.
-		0.5f, 0.5f, -0.5f,		0.0f,  0.0f, -1.0f,  0.0f, 1.0f,   //0
-		0.5f, -0.5f, -0.5f,		0.0f,  0.0f, -1.0f,  0.0f, 0.0f,   //1
-		-0.5f, -0.5f, -0.5f,	0.0f,  0.0f, -1.0f,  1.0f, 0.0f,   //2
-		-0.5f, 0.5f, -0.5f,		0.0f,  0.0f, -1.0f,  1.0f, 1.0f,   //3
-
-		//Bottom Face			//Negative Y Normal
-		-0.5f, -0.5f, 0.5f,		0.0f, -1.0f,  0.0f,  0.0f, 1.0f,  //4
-		-0.5f, -0.5f, -0.5f,	0.0f, -1.0f,  0.0f,  0.0f, 0.0f,  //5
-		0.5f, -0.5f, -0.5f,		0.0f, -1.0f,  0.0f,  1.0f, 0.0f,  //6
-		0.5f, -0.5f,  0.5f,		0.0f, -1.0f,  0.0f,  1.0f, 1.0f,  //7
-
-		//Left Face				//Negative X Normal
-		-0.5f, 0.5f, -0.5f,		-1.0f,  0.0f,  0.0f,  0.0f, 1.0f,  //8
-		-0.5f, -0.5f,  -0.5f,	-1.0f,  0.0f,  0.0f,  0.0f, 0.0f,  //9
-		-0.5f,  -0.5f,  0.5f,	-1.0f,  0.0f,  0.0f,  1.0f, 0.0f,  //10
-		-0.5f,  0.5f,  0.5f,	-1.0f,  0.0f,  0.0f,  1.0f, 1.0f,  //11
-
-		//Right Face			//Positive X Normal
-		0.5f,  0.5f,  0.5f,		1.0f,  0.0f,  0.0f,  0.0f, 1.0f,  //12
-		0.5f,  -0.5f, 0.5f,		1.0f,  0.0f,  0.0f,  0.0f, 0.0f,  //13
-		0.5f, -0.5f, -0.5f,		1.0f,  0.0f,  0.0f,  1.0f, 0.0f,  //14
-		0.5f, 0.5f, -0.5f,		1.0f,  0.0f,  0.0f,  1.0f, 1.0f,  //15
-
-		//Top Face				//Positive Y Normal
-		-0.5f,  0.5f, -0.5f,	0.0f,  1.0f,  0.0f,  0.0f, 1.0f, //16
-		-0.5f,  0.5f, 0.5f,		0.0f,  1.0f,  0.0f,  0.0f, 0.0f, //17
-		0.5f,  0.5f,  0.5f,		0.0f,  1.0f,  0.0f,  1.0f, 0.0f, //18
-		0.5f,  0.5f,  -0.5f,	0.0f,  1.0f,  0.0f,  1.0f, 1.0f, //19
-
-		//Front Face			//Positive Z Normal
-		-0.5f, 0.5f,  0.5f,	    0.0f,  0.0f,  1.0f,  0.0f, 1.0f, //20
-		-0.5f, -0.5f,  0.5f,	0.0f,  0.0f,  1.0f,  0.0f, 0.0f, //21
-		0.5f,  -0.5f,  0.5f,	0.0f,  0.0f,  1.0f,  1.0f, 0.0f, //22
-		0.5f,  0.5f,  0.5f,		0.0f,  0.0f,  1.0f,  1.0f, 1.0f, //23
+void ShapeMeshes::BuildBoxMesh(int divisions)
+{
+	divisions = glm::max(divisions, 1);
+
+	// corner of each face at texture coordinate (0, 0) and the
+	// edges u and v run along; u cross v faces out of the box
+	const glm::vec3 faces[][3] = {
+		{ glm::vec3(0.5f, -0.5f, -0.5f), glm::vec3(-1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f) },	// back
+		{ glm::vec3(-0.5f, -0.5f, -0.5f), glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f) },	// bottom
+		{ glm::vec3(-0.5f, -0.5f, -0.5f), glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 1.0f, 0.0f) },	// left
+		{ glm::vec3(0.5f, -0.5f, 0.5f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f) },	// right
+		{ glm::vec3(-0.5f, 0.5f, 0.5f), glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, -1.0f) },	// top
+		{ glm::vec3(-0.5f, -0.5f, 0.5f), glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f) }		// front
 	};
+	const int faceCount = sizeof(faces) / sizeof(faces[0]);
 
-	// Index data
-	GLuint indices[] = {
-		0,1,2,
-		0,3,2,
-		4,5,6,
-		4,7,6,
-		8,9,10,
-		8,11,10,
-		12,13,14,
-		12,15,14,
-		16,17,18,
-		16,19,18,
-		20,21,22,
-		20,23,22
-	};
+	MESH_CURSOR cursor = AllocateArenaMesh(m_BoxMesh,
+		faceCount * QuadFaceVertices(divisions), faceCount * QuadFaceIndices(divisions));
+	for (int i = 0; i < faceCount; i++)
+	{
+		WriteQuadFace(cursor, faces[i][0], faces[i][1], faces[i][2], divisions);
+	}
+	FinishArenaMesh(m_BoxMesh, "box");
+}
 
-	m_BoxMesh.nVertices = sizeof(verts) / (sizeof(verts[0]) * (g_FloatsPerVertex + g_FloatsPerNormal + g_FloatsPerUV));
-	m_BoxMesh.nIndices = sizeof(indices) / sizeof(indices[0]);
-
-	glGenVertexArrays(1, &m_BoxMesh.vao); // we can also generate multiple VAOs or buffers at the same time
-	glBindVertexArray(m_BoxMesh.vao);
-
-	// Create 2 buffers: first one for the vertex data; second one for the indices
-	glGenBuffers(2, m_BoxMesh.vbos);
-	glBindBuffer(GL_ARRAY_BUFFER, m_BoxMesh.vbos[0]); // Activates the buffer
-	glBufferData(GL_ARRAY_BUFFER, sizeof(verts), verts, GL_STATIC_DRAW); // Sends vertex or coordinate data to the GPU
-
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_BoxMesh.vbos[1]); // Activates the buffer
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
-
-	if (m_bMemoryLayoutDone == false)
-	{
-		SetShaderMemoryLayout();
-	}
-}
-
-///////////////////////////////////////////////////
-//	LoadConeMesh()
-//
-//	Create a cole mesh by specifying the vertices and 
-//  store it in a VAO/VBO.  The normals and texture
-//  coordinates are also set.
-//
-//  Correct triangle drawing commands:
-//
-//	glDrawArrays(GL_TRIANGLE_FAN, 0, 36);		//bottom
-//	glDrawArrays(GL_TRIANGLE_STRIP, 36, 108);	//sides
-///////////////////////////////////////////////////
-void ShapeMeshes::LoadConeMesh()
-{
-	GLfloat verts[] = {
-		// cone bottom			// normals			// texture coords
-		1.0f, 0.0f, 0.0f,		0.0f, -1.0f, 0.0f,	0.5f,1.0f,
-		.98f, 0.0f, -0.17f,		0.0f, -1.0f, 0.0f,	0.41f, 0.983f,
-		.94f, 0.0f, -0.34f,		0.0f, -1.0f, 0.0f,	0.33f, 0.96f,
-		.87f, 0.0f, -0.5f,		0.0f, -1.0f, 0.0f,	0.25f, 0.92f,
-		.77f, 0.0f, -0.64f,		0.0f, -1.0f, 0.0f,	0.17f, 0.87f,
-		.64f, 0.0f, -0.77f,		0.0f, -1.0f, 0.0f,	0.13f, 0.83f,
-		.5f, 0.0f, -0.87f,		0.0f, -1.0f, 0.0f,	0.08f, 0.77f,
-		.34f, 0.0f, -0.94f,		0.0f, -1.0f, 0.0f,	0.04f, 0.68f,
-		.17f, 0.0f, -0.98f,		0.0f, -1.0f, 0.0f,	0.017f, 0.6f,
-		0.0f, 0.0f, -1.0f,		0.0f, -1.0f, 0.0f,	0.0f,0.5f,
-		-.17f, 0.0f, -0.98f,	0.0f, -1.0f, 0.0f,	0.017f, 0.41f,
-		-.34f, 0.0f, -0.94f,	0.0f, -1.0f, 0.0f,	0.04f, 0.33f,
-		-.5f, 0.0f, -0.87f,		0.0f, -1.0f, 0.0f,	0.08f, 0.25f,
-		-.64f, 0.0f, -0.77f,	0.0f, -1.0f, 0.0f,	0.13f, 0.17f,
-		-.77f, 0.0f, -0.64f,	0.0f, -1.0f, 0.0f,	0.17f, 0.13f,
-		-.87f, 0.0f, -0.5f,		0.0f, -1.0f, 0.0f,	0.25f, 0.08f,
-		-.94f, 0.0f, -0.34f,	0.0f, -1.0f, 0.0f,	0.33f, 0.04f,
-		-.98f, 0.0f, -0.17f,	0.0f, -1.0f, 0.0f,	0.41f, 0.017f,
-		-1.0f, 0.0f, 0.0f,		0.0f, -1.0f, 0.0f,	0.5f, 0.0f,
-		-.98f, 0.0f, 0.17f,		0.0f, -1.0f, 0.0f,	0.6f, 0.017f,
-		-.94f, 0.0f, 0.34f,		0.0f, -1.0f, 0.0f,	0.68f, 0.04f,
-		-.87f, 0.0f, 0.5f,		0.0f, -1.0f, 0.0f,	0.77f, 0.08f,
-		-.77f, 0.0f, 0.64f,		0.0f, -1.0f, 0.0f,	0.83f, 0.13f,
-		-.64f, 0.0f, 0.77f,		0.0f, -1.0f, 0.0f,	0.87f, 0.17f,
-		-.5f, 0.0f, 0.87f,		0.0f, -1.0f, 0.0f,	0.92f, 0.25f,
-		-.34f, 0.0f, 0.94f,		0.0f, -1.0f, 0.0f,	0.96f, 0.33f,
-		-.17f, 0.0f, 0.98f,		0.0f, -1.0f, 0.0f,	0.983f, 0.41f,
-		0.0f, 0.0f, 1.0f,		0.0f, -1.0f, 0.0f,	1.0f, 0.5f,
-		.17f, 0.0f, 0.98f,		0.0f, -1.0f, 0.0f,	0.983f, 0.6f,
-		.34f, 0.0f, 0.94f,		0.0f, -1.0f, 0.0f,	0.96f, 0.68f,
-		.5f, 0.0f, 0.87f,		0.0f, -1.0f, 0.0f,	0.92f, 0.77f,
-		.64f, 0.0f, 0.77f,		0.0f, -1.0f, 0.0f,	0.87f, 0.83f,
-		.77f, 0.0f, 0.64f,		0.0f, -1.0f, 0.0f,	0.83f, 0.87f,
-		.87f, 0.0f, 0.5f,		0.0f, -1.0f, 0.0f,	0.77f, 0.92f,
-		.94f, 0.0f, 0.34f,		0.0f, -1.0f, 0.0f,	0.68f, 0.96f,
-		.98f, 0.0f, 0.17f,		0.0f, -1.0f, 0.0f,	0.6f, 0.983f,
-
-		// cone sides		// normals									// texture coords
-		1.0f, 0.0f, 0.0f,		0.993150651f, 0.0f, -0.116841137f, 		1.0f,0.5f,
-		0.0f, 1.0f, 0.0f,		0.993150651f, 0.0f, -0.116841137f, 		0.5f, 0.5f,
-		.98f, 0.0f, -0.17f,		0.993150651f, 0.0f, -0.116841137f, 		0.983f,0.6f,
-		.98f, 0.0f, -0.17f,		0.973417103f, 0.0f, -0.229039446f, 		0.983f,0.6f,
-		0.0f, 1.0f, 0.0f,		0.973417103f, 0.0f, -0.229039446f, 		0.5f, 0.5f,
-		.94f, 0.0f, -0.34f,		0.973417103f, 0.0f, -0.229039446f, 		0.96f,0.68f,
-		.94f, 0.0f, -0.34f,		0.916157305f, 0.0f, -0.400818795f, 		0.96f,0.68f,
-		0.0f, 1.0f, 0.0f,		0.916157305f, 0.0f, -0.400818795f, 		0.5f, 0.5f,
-		.87f, 0.0f, -0.5f,		0.916157305f, 0.0f, -0.400818795f, 		0.92f,0.77f,
-		.87f, 0.0f, -0.5f,		0.813733339f, 0.0f, -0.581238329f, 		0.92f,0.77f,
-		0.0f, 1.0f, 0.0f,		0.813733339f, 0.0f, -0.581238329f, 		0.5f, 0.5f,
-		.77f, 0.0f, -0.64f,		0.813733339f, 0.0f, -0.581238329f, 		0.87f, 0.83f,
-		.77f, 0.0f, -0.64f,		0.707106769f, 0.0f, -0.707106769f, 		0.87f, 0.83f,
-		0.0f, 1.0f, 0.0f,		0.707106769f, 0.0f, -0.707106769f, 		0.5f, 0.5f,
-		.64f, 0.0f, -0.77f,		0.707106769f, 0.0f, -0.707106769f, 		0.83f, 0.87f,
-		.64f, 0.0f, -0.77f,		0.581238329f, 0.0f, -0.813733339f, 		0.83f, 0.87f,
-		0.0f, 1.0f, 0.0f,		0.581238329f, 0.0f, -0.813733339f, 		0.5f, 0.5f,
-		.5f, 0.0f, -0.87f,		0.581238329f, 0.0f, -0.813733339f, 		0.77f, 0.92f,
-		.5f, 0.0f, -0.87f,		0.400818795f, 0.0f, -0.916157305f, 		0.77f, 0.92f,
-		0.0f, 1.0f, 0.0f,		0.400818795f, 0.0f, -0.916157305f, 		0.5f, 0.5f,
-		.34f, 0.0f, -0.94f,		0.400818795f, 0.0f, -0.916157305f, 		0.68f, 0.96f,
-		.34f, 0.0f, -0.94f,		0.229039446f, 0.0f, -0.973417103f, 		0.68f, 0.96f,
-		0.0f, 1.0f, 0.0f,		0.229039446f, 0.0f, -0.973417103f, 		0.5f, 0.5f,
-		.17f, 0.0f, -0.98f,		0.229039446f, 0.0f, -0.973417103f, 		0.6f, 0.983f,
-		.17f, 0.0f, -0.98f,		0.116841137f, 0.0f, -0.993150651f, 		0.6f, 0.983f,
-		0.0f, 1.0f, 0.0f,		0.116841137f, 0.0f, -0.993150651f, 		0.5f, 0.5f,
-		0.0f, 0.0f, -1.0f,		0.116841137f, 0.0f, -0.993150651f, 		0.5f, 1.0f,
-
-		0.0f, 0.0f, -1.0f,		-0.116841137f, 0.0f, -0.993150651f, 		0.5f, 1.0f,
-		0.0f, 1.0f, 0.0f,		-0.116841137f, 0.0f, -0.993150651f, 		0.5f, 0.5f,
-		-.17f, 0.0f, -0.98f,	-0.116841137f, 0.0f, -0.993150651f, 		0.41f, 0.983f,
-		-.17f, 0.0f, -0.98f,	-0.229039446f, 0.0f, -0.973417103f, 		0.41f, 0.983f,
-		0.0f, 1.0f, 0.0f,		-0.229039446f, 0.0f, -0.973417103f, 		0.5f, 0.5f,
-		-.34f, 0.0f, -0.94f,	-0.229039446f, 0.0f, -0.973417103f, 		0.33f, 0.96f,
-		-.34f, 0.0f, -0.94f,	-0.400818795f, 0.0f, -0.916157305f, 		0.33f, 0.96f,
-		0.0f, 1.0f, 0.0f,		-0.400818795f, 0.0f, -0.916157305f, 		0.5f, 0.5f,
-		-.5f, 0.0f, -0.87f,		-0.400818795f, 0.0f, -0.916157305f, 		0.25f, 0.92f,
-		-.5f, 0.0f, -0.87f,		-0.581238329f, 0.0f, -0.813733339f, 		0.25f, 0.92f,
-		0.0f, 1.0f, 0.0f,		-0.581238329f, 0.0f, -0.813733339f, 		0.5f, 0.5f,
-		-.64f, 0.0f, -0.77f,	-0.581238329f, 0.0f, -0.813733339f, 		0.17f, 0.87f,
-		-.64f, 0.0f, -0.77f,	-0.707106769f, 0.0f, -0.707106769f, 		0.17f, 0.87f,
-		0.0f, 1.0f, 0.0f,		-0.707106769f, 0.0f, -0.707106769f, 		0.5f, 0.5f,
-		-.77f, 0.0f, -0.64f,	-0.707106769f, 0.0f, -0.707106769f, 		0.13f, 0.83f,
-		-.77f, 0.0f, -0.64f,	-0.813733339f, 0.0f, -0.581238329f, 		0.13f, 0.83f,
-		0.0f, 1.0f, 0.0f,		-0.813733339f, 0.0f, -0.581238329f, 		0.5f, 0.5f,
-		-.87f, 0.0f, -0.5f,		-0.813733339f, 0.0f, -0.581238329f, 		0.08f, 0.77f,
-		-.87f, 0.0f, -0.5f,		-0.916157305f, 0.0f, -0.400818795f, 		0.08f, 0.77f,
-		0.0f, 1.0f, 0.0f,		-0.916157305f, 0.0f, -0.400818795f, 		0.5f, 0.5f,
-		-.94f, 0.0f, -0.34f,	-0.916157305f, 0.0f, -0.400818795f, 		0.04f, 0.68f,
-		-.94f, 0.0f, -0.34f,	-0.973417103f, 0.0f, -0.229039446f, 		0.04f, 0.68f,
-		0.0f, 1.0f, 0.0f,		-0.973417103f, 0.0f, -0.229039446f, 		0.5f, 0.5f,
-		-.98f, 0.0f, -0.17f,	-0.973417103f, 0.0f, -0.229039446f, 		0.017f, 0.6f,
-		-.98f, 0.0f, -0.17f,	-0.993150651f, 0.0f, -0.116841137f, 		0.017f, 0.6f,
-		0.0f, 1.0f, 0.0f,		-0.993150651f, 0.0f, -0.116841137f, 		0.5f, 0.5f,
-		-1.0f, 0.0f, 0.0f,		-0.993150651f, 0.0f, -0.116841137f, 		0.0f, 0.5f,
-		-1.0f, 0.0f, 0.0f,		-0.993150651f, 0.0f, -0.116841137f, 		0.0f, 0.5f,
-		0.0f, 1.0f, 0.0f,		-0.993150651f, 0.0f, 0.116841137f, 		0.5f, 0.5f,
-		-.98f, 0.0f, 0.17f,		-0.993150651f, 0.0f, 0.116841137f, 		0.017f, 0.41f,
-		-.98f, 0.0f, 0.17f,		-0.973417103f, 0.0f, 0.229039446f, 		0.017f, 0.41f,
-		0.0f, 1.0f, 0.0f,		-0.973417103f, 0.0f, 0.229039446f, 		0.5f, 0.5f,
-		-.94f, 0.0f, 0.34f,		-0.973417103f, 0.0f, 0.229039446f, 		0.04f, 0.33f,
-		-.94f, 0.0f, 0.34f,		-0.916157305f, 0.0f, 0.400818795f, 		0.04f, 0.33f,
-		0.0f, 1.0f, 0.0f,		-0.916157305f, 0.0f, 0.400818795f, 		0.5f, 0.5f,
-		-.87f, 0.0f, 0.5f,		-0.916157305f, 0.0f, 0.400818795f, 		0.08f, 0.25f,
-		-.87f, 0.0f, 0.5f,		-0.813733339f, 0.0f, 0.581238329f, 		0.08f, 0.25f,
-		0.0f, 1.0f, 0.0f,		-0.813733339f, 0.0f, 0.581238329f, 		0.5f, 0.5f,
-		-.77f, 0.0f, 0.64f,		-0.813733339f, 0.0f, 0.581238329f, 		0.13f, 0.17f,
-		-.77f, 0.0f, 0.64f,		-0.707106769f, 0.0f, 0.707106769f, 		0.13f, 0.17f,
-		0.0f, 1.0f, 0.0f,		-0.707106769f, 0.0f, 0.707106769f, 		0.5f, 0.5f,
-		-.64f, 0.0f, 0.77f,		-0.707106769f, 0.0f, 0.707106769f, 		0.17f, 0.13f,
-		-.64f, 0.0f, 0.77f,		-0.581238329f, 0.0f, 0.813733339f, 		0.17f, 0.13f,
-		0.0f, 1.0f, 0.0f,		-0.581238329f, 0.0f, 0.813733339f, 		0.5f, 0.5f,
-		-.5f, 0.0f, 0.87f,		-0.581238329f, 0.0f, 0.813733339f, 		0.25f, 0.08f,
-		-.5f, 0.0f, 0.87f,		-0.400818795f, 0.0f, 0.916157305f, 		0.25f, 0.08f,
-		0.0f, 1.0f, 0.0f,		-0.400818795f, 0.0f, 0.916157305f, 		0.5f, 0.5f,
-		-.34f, 0.0f, 0.94f,		-0.400818795f, 0.0f, 0.916157305f, 		0.33f, 0.04f,
-		-.34f, 0.0f, 0.94f,		-0.229039446f, 0.0f, 0.973417103f, 		0.33f, 0.04f,
-		0.0f, 1.0f, 0.0f,		-0.229039446f, 0.0f, 0.973417103f, 		0.5f, 0.5f,
-		-.17f, 0.0f, 0.98f,		-0.229039446f, 0.0f, 0.973417103f, 		0.41f, 0.017f,
-		-.17f, 0.0f, 0.98f,		-0.116841137f, 0.0f, 0.993150651f, 		0.41f, 0.017f,
-		0.0f, 1.0f, 0.0f,		-0.116841137f, 0.0f, 0.993150651f, 		0.5f, 0.5f,
-		0.0f, 0.0f, 1.0f,		-0.116841137f, 0.0f, 0.993150651f, 		0.5f, 0.0f,
-		0.0f, 0.0f, 1.0f,		0.116841137f, 0.0f, 0.993150651f, 	0.5f, 0.0f,
-		0.0f, 1.0f, 0.0f,		0.116841137f, 0.0f, 0.993150651f, 	0.5f, 0.5f,
-		.17f, 0.0f, 0.98f,		0.116841137f, 0.0f, 0.993150651f, 	0.6f, 0.017f,
-		.17f, 0.0f, 0.98f,		0.229039446f, 0.0f, 0.973417103f, 	0.6f, 0.017f,
-		0.0f, 1.0f, 0.0f,		0.229039446f, 0.0f, 0.973417103f, 	0.5f, 0.5f,
-		.34f, 0.0f, 0.94f,		0.229039446f, 0.0f, 0.973417103f, 	0.68f, 0.04f,
-		.34f, 0.0f, 0.94f,		0.400818795f, 0.0f, 0.916157305f, 	0.68f, 0.04f,
-		0.0f, 1.0f, 0.0f,		0.400818795f, 0.0f, 0.916157305f, 	0.5f, 0.5f,
-		.5f, 0.0f, 0.87f,		0.400818795f, 0.0f, 0.916157305f, 	0.77f, 0.08f,
-		.5f, 0.0f, 0.87f,		0.581238329f, 0.0f, 0.813733339f, 	0.77f, 0.08f,
-		0.0f, 1.0f, 0.0f,		0.581238329f, 0.0f, 0.813733339f, 	0.5f, 0.5f,
-		.64f, 0.0f, 0.77f,		0.581238329f, 0.0f, 0.813733339f, 	0.83f, 0.13f,
-		.64f, 0.0f, 0.77f,		0.707106769f, 0.0f, 0.707106769f, 	0.83f, 0.13f,
-		0.0f, 1.0f, 0.0f,		0.707106769f, 0.0f, 0.707106769f, 	0.5f, 0.5f,
-		.77f, 0.0f, 0.64f,		0.707106769f, 0.0f, 0.707106769f, 	0.87f, 0.17f,
-		.77f, 0.0f, 0.64f,		0.813733339f, 0.0f, 0.581238329f, 	0.87f, 0.17f,
-		0.0f, 1.0f, 0.0f,		0.813733339f, 0.0f, 0.581238329f, 	0.5f, 0.5f,
-		.87f, 0.0f, 0.5f,		0.813733339f, 0.0f, 0.581238329f, 	0.92f, 0.25f,
-		.87f, 0.0f, 0.5f,		0.916157305f, 0.0f, 0.400818795f, 	0.92f, 0.25f,
-		0.0f, 1.0f, 0.0f,		0.916157305f, 0.0f, 0.400818795f, 	0.5f, 0.5f,
-		.94f, 0.0f, 0.34f,		0.916157305f, 0.0f, 0.400818795f, 	0.96f, 0.33f,
-		.94f, 0.0f, 0.34f,		0.973417103f, 0.0f, 0.229039446f, 	0.96f, 0.33f,
-		0.0f, 1.0f, 0.0f,		0.973417103f, 0.0f, 0.229039446f, 	0.5f, 0.5f,
-		.98f, 0.0f, 0.17f,		0.973417103f, 0.0f, 0.229039446f, 	0.983f, 0.41f,
-		.98f, 0.0f, 0.17f,		0.993150651f, 0.0f, 0.116841137f, 	0.983f, 0.41f,
-		0.0f, 1.0f, 0.0f,		0.993150651f, 0.0f, 0.116841137f, 	0.5f, 0.5f,
-		1.0f, 0.0f, 0.0f,		0.993150651f, 0.0f, 0.116841137f, 	1.0f, 0.5f
-	};
+///////////////////////////////////////////////////
+//	BuildConeMesh()
+//
+//	Create a cone mesh of the given number of slices
+//  around its axis, radius 1 at y = 0 to its tip at
+//  y = 1, and append it to the arena.
+//
+//  Correct triangle drawing commands, in indices:
+//
+//	glDrawElements(GL_TRIANGLES, 3 * (slices - 2), 0);				//bottom
+//	glDrawElements(GL_TRIANGLES, 3 * slices, 3 * (slices - 2));		//sides
+///////////////////////////////////////////////////
+void ShapeMeshes::BuildConeMesh(int slices)
+{
+	GenerateRadialMesh(m_ConeMesh, "cone", glm::max(slices, 3), 0.0f, false);
+}
 
-	// store vertex and index count
-	m_ConeMesh.nVertices = sizeof(verts) / (sizeof(verts[0]) * (g_FloatsPerVertex + g_FloatsPerNormal + g_FloatsPerUV));
-	m_ConeMesh.nIndices = 0;
-
-	// Create VAO
-	glGenVertexArrays(1, &m_ConeMesh.vao); // we can also generate multiple VAOs or buffers at the same time
-	glBindVertexArray(m_ConeMesh.vao);
-
-	// Create VBO
-	glGenBuffers(1, m_ConeMesh.vbos);
-	glBindBuffer(GL_ARRAY_BUFFER, m_ConeMesh.vbos[0]); // Activates the buffer
-	glBufferData(GL_ARRAY_BUFFER, sizeof(verts), verts, GL_STATIC_DRAW); // Sends vertex or coordinate data to the GPU
-
-	if (m_bMemoryLayoutDone == false)
-	{
-		SetShaderMemoryLayout();
-	}
-}
-
-///////////////////////////////////////////////////
-//	LoadCylinderMesh()
-//
-//	Create a cylinder mesh by specifying the vertices and 
-//  store it in a VAO/VBO.  The normals and texture
-//  coordinates are also set.
-//
-//  Correct triangle drawing commands:
-//
-//	glDrawArrays(GL_TRIANGLE_FAN, 0, 36);		//bottom
-//	glDrawArrays(GL_TRIANGLE_FAN, 36, 36);		//top
-//	glDrawArrays(GL_TRIANGLE_STRIP, 72, 146);	//sides
-///////////////////////////////////////////////////
-void ShapeMeshes::LoadCylinderMesh()
-{
-	GLfloat verts[] = {
-		// cylinder bottom		// normals			// texture coords
-		1.0f, 0.0f, 0.0f,		0.0f, -1.0f, 0.0f,	0.5f,1.0f,
-		.98f, 0.0f, -0.17f,		0.0f, -1.0f, 0.0f,	0.41f, 0.983f,
-		.94f, 0.0f, -0.34f,		0.0f, -1.0f, 0.0f,	0.33f, 0.96f,
-		.87f, 0.0f, -0.5f,		0.0f, -1.0f, 0.0f,	0.25f, 0.92f,
-		.77f, 0.0f, -0.64f,		0.0f, -1.0f, 0.0f,	0.17f, 0.87f,
-		.64f, 0.0f, -0.77f,		0.0f, -1.0f, 0.0f,	0.13f, 0.83f,
-		.5f, 0.0f, -0.87f,		0.0f, -1.0f, 0.0f,	0.08f, 0.77f,
-		.34f, 0.0f, -0.94f,		0.0f, -1.0f, 0.0f,	0.04f, 0.68f,
-		.17f, 0.0f, -0.98f,		0.0f, -1.0f, 0.0f,	0.017f, 0.6f,
-		0.0f, 0.0f, -1.0f,		0.0f, -1.0f, 0.0f,	0.0f,0.5f,
-		-.17f, 0.0f, -0.98f,	0.0f, -1.0f, 0.0f,	0.017f, 0.41f,
-		-.34f, 0.0f, -0.94f,	0.0f, -1.0f, 0.0f,	0.04f, 0.33f,
-		-.5f, 0.0f, -0.87f,		0.0f, -1.0f, 0.0f,	0.08f, 0.25f,
-		-.64f, 0.0f, -0.77f,	0.0f, -1.0f, 0.0f,	0.13f, 0.17f,
-		-.77f, 0.0f, -0.64f,	0.0f, -1.0f, 0.0f,	0.17f, 0.13f,
-		-.87f, 0.0f, -0.5f,		0.0f, -1.0f, 0.0f,	0.25f, 0.08f,
-		-.94f, 0.0f, -0.34f,	0.0f, -1.0f, 0.0f,	0.33f, 0.04f,
-		-.98f, 0.0f, -0.17f,	0.0f, -1.0f, 0.0f,	0.41f, 0.017f,
-		-1.0f, 0.0f, 0.0f,		0.0f, -1.0f, 0.0f,	0.5f, 0.0f,
-		-.98f, 0.0f, 0.17f,		0.0f, -1.0f, 0.0f,	0.6f, 0.017f,
-		-.94f, 0.0f, 0.34f,		0.0f, -1.0f, 0.0f,	0.68f, 0.04f,
-		-.87f, 0.0f, 0.5f,		0.0f, -1.0f, 0.0f,	0.77f, 0.08f,
-		-.77f, 0.0f, 0.64f,		0.0f, -1.0f, 0.0f,	0.83f, 0.13f,
-		-.64f, 0.0f, 0.77f,		0.0f, -1.0f, 0.0f,	0.87f, 0.17f,
-		-.5f, 0.0f, 0.87f,		0.0f, -1.0f, 0.0f,	0.92f, 0.25f,
-		-.34f, 0.0f, 0.94f,		0.0f, -1.0f, 0.0f,	0.96f, 0.33f,
-		-.17f, 0.0f, 0.98f,		0.0f, -1.0f, 0.0f,	0.983f, 0.41f,
-		0.0f, 0.0f, 1.0f,		0.0f, -1.0f, 0.0f,	1.0f, 0.5f,
-		.17f, 0.0f, 0.98f,		0.0f, -1.0f, 0.0f,	0.983f, 0.6f,
-		.34f, 0.0f, 0.94f,		0.0f, -1.0f, 0.0f,	0.96f, 0.68f,
-		.5f, 0.0f, 0.87f,		0.0f, -1.0f, 0.0f,	0.92f, 0.77f,
-		.64f, 0.0f, 0.77f,		0.0f, -1.0f, 0.0f,	0.87f, 0.83f,
-		.77f, 0.0f, 0.64f,		0.0f, -1.0f, 0.0f,	0.83f, 0.87f,
-		.87f, 0.0f, 0.5f,		0.0f, -1.0f, 0.0f,	0.77f, 0.92f,
-		.94f, 0.0f, 0.34f,		0.0f, -1.0f, 0.0f,	0.68f, 0.96f,
-		.98f, 0.0f, 0.17f,		0.0f, -1.0f, 0.0f,	0.6f, 0.983f,
-
-		// cylinder top			// normals			// texture coords
-		1.0f, 1.0f, 0.0f,		0.0f, 1.0f, 0.0f,	0.5f,1.0f,
-		.98f, 1.0f, -0.17f,		0.0f, 1.0f, 0.0f,	0.41f, 0.983f,
-		.94f, 1.0f, -0.34f,		0.0f, 1.0f, 0.0f,	0.33f, 0.96f,
-		.87f, 1.0f, -0.5f,		0.0f, 1.0f, 0.0f,	0.25f, 0.92f,
-		.77f, 1.0f, -0.64f,		0.0f, 1.0f, 0.0f,	0.17f, 0.87f,
-		.64f, 1.0f, -0.77f,		0.0f, 1.0f, 0.0f,	0.13f, 0.83f,
-		.5f, 1.0f, -0.87f,		0.0f, 1.0f, 0.0f,	0.08f, 0.77f,
-		.34f, 1.0f, -0.94f,		0.0f, 1.0f, 0.0f,	0.04f, 0.68f,
-		.17f, 1.0f, -0.98f,		0.0f, 1.0f, 0.0f,	0.017f, 0.6f,
-		0.0f, 1.0f, -1.0f,		0.0f, 1.0f, 0.0f,	0.0f,0.5f,
-		-.17f, 1.0f, -0.98f,	0.0f, 1.0f, 0.0f,	0.017f, 0.41f,
-		-.34f, 1.0f, -0.94f,	0.0f, 1.0f, 0.0f,	0.04f, 0.33f,
-		-.5f, 1.0f, -0.87f,		0.0f, 1.0f, 0.0f,	0.08f, 0.25f,
-		-.64f, 1.0f, -0.77f,	0.0f, 1.0f, 0.0f,	0.13f, 0.17f,
-		-.77f, 1.0f, -0.64f,	0.0f, 1.0f, 0.0f,	0.17f, 0.13f,
-		-.87f, 1.0f, -0.5f,		0.0f, 1.0f, 0.0f,	0.25f, 0.08f,
-		-.94f, 1.0f, -0.34f,	0.0f, 1.0f, 0.0f,	0.33f, 0.04f,
-		-.98f, 1.0f, -0.17f,	0.0f, 1.0f, 0.0f,	0.41f, 0.017f,
-		-1.0f, 1.0f, 0.0f,		0.0f, 1.0f, 0.0f,	0.5f, 0.0f,
-		-.98f, 1.0f, 0.17f,		0.0f, 1.0f, 0.0f,	0.6f, 0.017f,
-		-.94f, 1.0f, 0.34f,		0.0f, 1.0f, 0.0f,	0.68f, 0.04f,
-		-.87f, 1.0f, 0.5f,		0.0f, 1.0f, 0.0f,	0.77f, 0.08f,
-		-.77f, 1.0f, 0.64f,		0.0f, 1.0f, 0.0f,	0.83f, 0.13f,
-		-.64f, 1.0f, 0.77f,		0.0f, 1.0f, 0.0f,	0.87f, 0.17f,
-		-.5f, 1.0f, 0.87f,		0.0f, 1.0f, 0.0f,	0.92f, 0.25f,
-		-.34f, 1.0f, 0.94f,		0.0f, 1.0f, 0.0f,	0.96f, 0.33f,
-		-.17f, 1.0f, 0.98f,		0.0f, 1.0f, 0.0f,	0.983f, 0.41f,
-		0.0f, 1.0f, 1.0f,		0.0f, 1.0f, 0.0f,	1.0f, 0.5f,
-		.17f, 1.0f, 0.98f,		0.0f, 1.0f, 0.0f,	0.983f, 0.6f,
-		.34f, 1.0f, 0.94f,		0.0f, 1.0f, 0.0f,	0.96f, 0.68f,
-		.5f, 1.0f, 0.87f,		0.0f, 1.0f, 0.0f,	0.92f, 0.77f,
-		.64f, 1.0f, 0.77f,		0.0f, 1.0f, 0.0f,	0.87f, 0.83f,
-		.77f, 1.0f, 0.64f,		0.0f, 1.0f, 0.0f,	0.83f, 0.87f,
-		.87f, 1.0f, 0.5f,		0.0f, 1.0f, 0.0f,	0.77f, 0.92f,
-		.94f, 1.0f, 0.34f,		0.0f, 1.0f, 0.0f,	0.68f, 0.96f,
-		.98f, 1.0f, 0.17f,		0.0f, 1.0f, 0.0f,	0.6f, 0.983f,
-
-		// cylinder body		// normals							// texture coords
-		1.0f, 1.0f, 0.0f,		0.993150651f, 0.5f, -0.116841137f,	0.0,1.0,
-		1.0f, 0.0f, 0.0f,		0.993150651f, 0.5f, -0.116841137f,	0.0,0.0,
-		.98f, 0.0f, -0.17f,		0.993150651f, 0.5f, -0.116841137f,	0.0277,0.0,
-		1.0f, 1.0f, 0.0f,		0.993150651f, 0.5f, -0.116841137f,	0.0,1.0,
-		.98f, 1.0f, -0.17f,		0.973417103f, 0.5f, -0.229039446f,	0.0277,1.0,
-		.98f, 0.0f, -0.17f,		0.973417103f, 0.5f, -0.229039446f,	0.0277,0.0,
-		.94f, 0.0f, -0.34f,		0.973417103f, 0.0f, -0.229039446f,	0.0554,0.0,
-		.98f, 1.0f, -0.17f,		0.973417103f, 0.0f, -0.229039446f,	0.0277,1.0,
-		.94f, 1.0f, -0.34f,		0.916157305f, 0.0f, -0.400818795f,	0.0554,1.0,
-		.94f, 0.0f, -0.34f,		0.916157305f, 0.0f, -0.400818795f,	0.0554,0.0,
-		.87f, 0.0f, -0.5f,		0.916157305f, 0.0f, -0.400818795f,	0.0831,0.0,
-		.94f, 1.0f, -0.34f,		0.916157305f, 0.0f, -0.400818795f,	0.0554,1.0,
-		.87f, 1.0f, -0.5f,		0.813733339f, 0.0f, -0.581238329f,	0.0831,1.0,
-		.87f, 0.0f, -0.5f,		0.813733339f, 0.0f, -0.581238329f,	0.0831,0.0,
-		.77f, 0.0f, -0.64f,		0.813733339f, 0.0f, -0.581238329f,	0.1108,0.0,
-		.87f, 1.0f, -0.5f,		0.813733339f, 0.0f, -0.581238329f,	0.0831,1.0,
-		.77f, 1.0f, -0.64f,		0.707106769f, 0.0f, -0.707106769f,	0.1108,1.0,
-		.77f, 0.0f, -0.64f,		0.707106769f, 0.0f, -0.707106769f,	0.1108,0.0,
-		.64f, 0.0f, -0.77f,		0.707106769f, 0.0f, -0.707106769f,	0.1385,0.0,
-		.77f, 1.0f, -0.64f,		0.707106769f, 0.0f, -0.707106769f,	0.1108,1.0,
-		.64f, 1.0f, -0.77f,		0.581238329f, 0.0f, -0.813733339f,	0.1385,1.0,
-		.64f, 0.0f, -0.77f,		0.581238329f, 0.0f, -0.813733339f,	0.1385,0.0,
-		.5f, 0.0f, -0.87f,		0.581238329f, 0.0f, -0.813733339f,	0.1662,0.0,
-		.64f, 1.0f, -0.77f,		0.581238329f, 0.0f, -0.813733339f,	0.1385, 1.0,
-		.5f, 1.0f, -0.87f,		0.400818795f, 0.0f, -0.916157305f,	0.1662, 1.0,
-		.5f, 0.0f, -0.87f,		0.400818795f, 0.0f, -0.916157305f,	0.1662, 0.0,
-		.34f, 0.0f, -0.94f,		0.400818795f, 0.0f, -0.916157305f,	0.1939, 0.0,
-		.5f, 1.0f, -0.87f,		0.400818795f, 0.0f, -0.916157305f,	0.1662, 1.0,
-		.34f, 1.0f, -0.94f,		0.229039446f, 0.0f, -0.973417103f,	0.1939, 1.0,
-		.34f, 0.0f, -0.94f,		0.229039446f, 0.0f, -0.973417103f,	0.1939, 0.0,
-		.17f, 0.0f, -0.98f,		0.229039446f, 0.0f, -0.973417103f,	0.2216, 0.0,
-		.34f, 1.0f, -0.94f,		0.229039446f, 0.0f, -0.973417103f,	0.1939, 1.0,
-		.17f, 1.0f, -0.98f,		0.116841137f, 0.0f, -0.993150651f,	0.2216, 1.0,
-		.17f, 0.0f, -0.98f,		0.116841137f, 0.0f, -0.993150651f,	0.2216, 0.0,
-		0.0f, 0.0f, -1.0f,		0.116841137f, 0.0f, -0.993150651f,	0.2493, 0.0,
-		.17f, 1.0f, -0.98f,		0.116841137f, 0.0f, -0.993150651f,	0.2216, 1.0,
-		0.0f, 1.0f, -1.0f,		0.116841137f, 0.0f, -0.993150651f,	0.2493, 1.0,
-		0.0f, 0.0f, -1.0f,		0.116841137f, 0.0f, -0.993150651f,	0.2493, 0.0,
-		-.17f, 0.0f, -0.98f,	-0.116841137f, 0.0f, -0.993150651f,	0.277, 0.0,
-		0.0f, 1.0f, -1.0f,		-0.116841137f, 0.0f, -0.993150651f,	0.2493, 1.0,
-		-.17f, 1.0f, -0.98f,	-0.229039446f, 0.0f, -0.973417103f,	0.277, 1.0,
-		-.17f, 0.0f, -0.98f,	-0.229039446f, 0.0f, -0.973417103f,	0.277, 0.0,
-		-.34f, 0.0f, -0.94f,	-0.229039446f, 0.0f, -0.973417103f,	0.3047, 0.0,
-		-.17f, 1.0f, -0.98f,	-0.229039446f, 0.0f, -0.973417103f,	0.277, 1.0,
-		-.34f, 1.0f, -0.94f,	-0.400818795f, 0.0f, -0.916157305f,	0.3047, 1.0,
-		-.34f, 0.0f, -0.94f,	-0.400818795f, 0.0f, -0.916157305f,	0.3047, 0.0,
-		-.5f, 0.0f, -0.87f,		-0.400818795f, 0.0f, -0.916157305f,	0.3324, 0.0,
-		-.34f, 1.0f, -0.94f,	-0.400818795f, 0.0f, -0.916157305f,	0.3047, 1.0,
-		-.5f, 1.0f, -0.87f,		-0.581238329f, 0.0f, -0.813733339f,	0.3324, 1.0,
-		-.5f, 0.0f, -0.87f,		-0.581238329f, 0.0f, -0.813733339f,	0.3324, 0.0,
-		-.64f, 0.0f, -0.77f,	-0.581238329f, 0.0f, -0.813733339f,	0.3601, 0.0,
-		-.5f, 1.0f, -0.87f,		-0.581238329f, 0.0f, -0.813733339f,	0.3324, 1.0,
-		-.64f, 1.0f, -0.77f,	-0.707106769f, 0.0f, -0.707106769f,	0.3601, 1.0,
-		-.64f, 0.0f, -0.77f,	-0.707106769f, 0.0f, -0.707106769f,	0.3601, 0.0,
-		-.77f, 0.0f, -0.64f,	-0.707106769f, 0.0f, -0.707106769f,	0.3878, 0.0,
-		-.64f, 1.0f, -0.77f,	-0.707106769f, 0.0f, -0.707106769f,	0.3601, 1.0,
-		-.77f, 1.0f, -0.64f,	-0.813733339f, 0.0f, -0.581238329f,	0.3878, 1.0,
-		-.77f, 0.0f, -0.64f,	-0.813733339f, 0.0f, -0.581238329f,	0.3878, 0.0,
-		-.87f, 0.0f, -0.5f,		-0.813733339f, 0.0f, -0.581238329f,	0.4155, 0.0,
-		-.77f, 1.0f, -0.64f,	-0.813733339f, 0.0f, -0.581238329f,	0.3878, 1.0,
-		-.87f, 1.0f, -0.5f,		-0.916157305f, 0.0f, -0.400818795f,	0.4155, 1.0,
-		-.87f, 0.0f, -0.5f,		-0.916157305f, 0.0f, -0.400818795f,	0.4155, 0.0,
-		-.94f, 0.0f, -0.34f,	-0.916157305f, 0.0f, -0.400818795f,	0.4432, 0.0,
-		-.87f, 1.0f, -0.5f,		-0.916157305f, 0.0f, -0.400818795f,	0.4155, 1.0,
-		-.94f, 1.0f, -0.34f,	-0.973417103f, 0.0f, -0.229039446f,	0.4432, 1.0,
-		-.94f, 0.0f, -0.34f,	-0.973417103f, 0.0f, -0.229039446f,	0.4432, 0.0,
-		-.98f, 0.0f, -0.17f,	-0.973417103f, 0.0f, -0.229039446f,	0.4709, 0.0,
-		-.94f, 1.0f, -0.34f,	-0.973417103f, 0.0f, -0.229039446f,	0.4432, 1.0,
-		-.98f, 1.0f, -0.17f,	-0.993150651f, 0.0f, -0.116841137f,	0.4709, 1.0,
-		-.98f, 0.0f, -0.17f,	-0.993150651f, 0.0f, -0.116841137f,	0.4709, 0.0,
-		-1.0f, 0.0f, 0.0f,		-0.993150651f, 0.0f, -0.116841137f,	0.4986, 0.0,
-		-.98f, 1.0f, -0.17f,	-0.993150651f, 0.0f, -0.116841137f,	0.4709, 1.0,
-		-1.0f, 1.0f, 0.0f,		-0.993150651f, 0.0f, -0.116841137f,	0.4986, 1.0,
-		-1.0f, 0.0f, 0.0f,		-0.993150651f, 0.0f, -0.116841137f,	0.4986, 0.0,
-		-.98f, 0.0f, 0.17f,		-0.993150651f, 0.0f, 0.116841137f,	0.5263, 0.0,
-		-1.0f, 1.0f, 0.0f,		-0.993150651f, 0.0f, 0.116841137f,	0.4986, 1.0,
-		-.98f, 1.0f, 0.17f,		-0.973417103f, 0.0f, 0.229039446f,	0.5263, 1.0,
-		-.98f, 0.0f, 0.17f,		-0.973417103f, 0.0f, 0.229039446f,	0.5263, 0.0,
-		-.94f, 0.0f, 0.34f,		-0.973417103f, 0.0f, 0.229039446f,	0.554, 0.0,
-		-.98f, 1.0f, 0.17f,		-0.973417103f, 0.0f, 0.229039446f,	0.5263, 1.0,
-		-.94f, 1.0f, 0.34f,		-0.916157305f, 0.0f, 0.400818795f,	0.554, 1.0,
-		-.94f, 0.0f, 0.34f,		-0.916157305f, 0.0f, 0.400818795f,	0.554, 0.0,
-		-.87f, 0.0f, 0.5f,		-0.916157305f, 0.0f, 0.400818795f,	0.5817, 0.0,
-		-.94f, 1.0f, 0.34f,		-0.916157305f, 0.0f, 0.400818795f,	0.554, 1.0,
-		-.87f, 1.0f, 0.5f,		-0.813733339f, 0.0f, 0.581238329f,	0.5817, 1.0,
-		-.87f, 0.0f, 0.5f,		-0.813733339f, 0.0f, 0.581238329f,	0.5817, 0.0,
-		-.77f, 0.0f, 0.64f,		-0.813733339f, 0.0f, 0.581238329f,	0.6094, 0.0,
-		-.87f, 1.0f, 0.5f,		-0.813733339f, 0.0f, 0.581238329f,	0.5817, 1.0,
-		-.77f, 1.0f, 0.64f,		-0.707106769f, 0.0f, 0.707106769f,	0.6094, 1.0,
-		-.77f, 0.0f, 0.64f,		-0.707106769f, 0.0f, 0.707106769f,	0.6094, 0.0,
-		-.64f, 0.0f, 0.77f,		-0.707106769f, 0.0f, 0.707106769f,	0.6371, 0.0,
-		-.77f, 1.0f, 0.64f,		-0.707106769f, 0.0f, 0.707106769f,	0.6094, 1.0,
-		-.64f, 1.0f, 0.77f,		-0.581238329f, 0.0f, 0.813733339f,	0.6371, 1.0,
-		-.64f, 0.0f, 0.77f,		-0.581238329f, 0.0f, 0.813733339f,	0.6371, 0.0,
-		-.5f, 0.0f, 0.87f,		-0.581238329f, 0.0f, 0.813733339f,	0.6648, 0.0,
-		-.64f, 1.0f, 0.77f,		-0.581238329f, 0.0f, 0.813733339f,	0.6371, 1.0,
-		-.5f, 1.0f, 0.87f,		-0.400818795f, 0.0f, 0.916157305f,	0.6648, 1.0,
-		-.5f, 0.0f, 0.87f,		-0.400818795f, 0.0f, 0.916157305f,	0.6648, 0.0,
-		-.34f, 0.0f, 0.94f,		-0.400818795f, 0.0f, 0.916157305f,	0.6925, 0.0,
-		-.5f, 1.0f, 0.87f,		-0.400818795f, 0.0f, 0.916157305f,	0.6648, 1.0,
-		-.34f, 1.0f, 0.94f,		-0.229039446f, 0.0f, 0.973417103f,	0.6925, 1.0,
-		-.34f, 0.0f, 0.94f,		-0.229039446f, 0.0f, 0.973417103f,	0.6925, 0.0,
-		-.17f, 0.0f, 0.98f,		-0.229039446f, 0.0f, 0.973417103f,	0.7202, 0.0,
-		-.34f, 1.0f, 0.94f,		-0.229039446f, 0.0f, 0.973417103f,	0.6925, 1.0,
-		-.17f, 1.0f, 0.98f,		-0.116841137f, 0.0f, 0.993150651f,	0.7202, 1.0,
-		-.17f, 0.0f, 0.98f,		-0.116841137f, 0.0f, 0.993150651f,	0.7202, 0.0,
-		0.0f, 0.0f, 1.0f,		0.116841137f, 0.0f, 0.993150651f,	0.7479, 0.0,
-		-.17f, 1.0f, 0.98f,		-0.116841137f, 0.0f, 0.993150651f,	0.7202, 1.0,
-		0.0f, 1.0f, 1.0f,		0.116841137f, 0.0f, 0.993150651f,	0.7479, 1.0,
-		0.0f, 0.0f, 1.0f,		0.116841137f, 0.0f, 0.993150651f,	0.7479, 0.0,
-		.17f, 0.0f, 0.98f,		0.116841137f, 0.0f, 0.993150651f,	0.7756, 0.0,
-		0.0f, 1.0f, 1.0f,		0.116841137f, 0.0f, 0.993150651f,	0.7479, 1.0,
-		.17f, 1.0f, 0.98f,		0.229039446f, 0.0f, 0.973417103f,	0.7756, 1.0,
-		.17f, 0.0f, 0.98f,		0.229039446f, 0.0f, 0.973417103f,	0.7756, 0.0,
-		.34f, 0.0f, 0.94f,		0.229039446f, 0.0f, 0.973417103f,	0.8033, 0.0,
-		.17f, 1.0f, 0.98f,		0.229039446f, 0.0f, 0.973417103f,	0.7756, 1.0,
-		.34f, 1.0f, 0.94f,		0.400818795f, 0.0f, 0.916157305f,	0.8033, 1.0,
-		.34f, 0.0f, 0.94f,		0.400818795f, 0.0f, 0.916157305f,	0.8033, 0.0,
-		.5f, 0.0f, 0.87f,		0.400818795f, 0.0f, 0.916157305f,	0.831, 0.0,
-		.34f, 1.0f, 0.94f,		0.400818795f, 0.0f, 0.916157305f,	0.8033, 1.0,
-		.5f, 1.0f, 0.87f,		0.581238329f, 0.0f, 0.813733339f,	0.831, 1.0,
-		.5f, 0.0f, 0.87f,		0.581238329f, 0.0f, 0.813733339f,	0.831, 0.0,
-		.64f, 0.0f, 0.77f,		0.581238329f, 0.0f, 0.813733339f,	0.8587, 0.0,
-		.5f, 1.0f, 0.87f,		0.581238329f, 0.0f, 0.813733339f,	0.831, 1.0,
-		.64f, 1.0f, 0.77f,		0.707106769f, 0.0f, 0.707106769f,	0.8587, 1.0,
-		.64f, 0.0f, 0.77f,		0.707106769f, 0.0f, 0.707106769f,	0.8587, 0.0,
-		.77f, 0.0f, 0.64f,		0.707106769f, 0.0f, 0.707106769f,	0.8864, 0.0,
-		.64f, 1.0f, 0.77f,		0.707106769f, 0.0f, 0.707106769f,	0.8587, 1.0,
-		.77f, 1.0f, 0.64f,		0.813733339f, 0.0f, 0.581238329f,	0.8864, 1.0,
-		.77f, 0.0f, 0.64f,		0.813733339f, 0.0f, 0.581238329f,	0.8864, 0.0,
-		.87f, 0.0f, 0.5f,		0.813733339f, 0.0f, 0.581238329f,	0.9141, 0.0,
-		.77f, 1.0f, 0.64f,		0.813733339f, 0.0f, 0.581238329f,	0.8864, 1.0,
-		.87f, 1.0f, 0.5f,		0.916157305f, 0.0f, 0.400818795f,	0.9141, 1.0,
-		.87f, 0.0f, 0.5f,		0.916157305f, 0.0f, 0.400818795f,	0.9141, 0.0,
-		.94f, 0.0f, 0.34f,		0.916157305f, 0.0f, 0.400818795f,	0.9418, 0.0,
-		.87f, 1.0f, 0.5f,		0.916157305f, 0.0f, 0.400818795f,	0.9141, 1.0,
-		.94f, 1.0f, 0.34f,		0.973417103f, 0.0f, 0.229039446f,	0.9418, 1.0,
-		.94f, 0.0f, 0.34f,		0.973417103f, 0.0f, 0.229039446f,	0.9418, 0.0,
-		.98f, 0.0f, 0.17f,		0.973417103f, 0.0f, 0.229039446f,	0.9695, 0.0,
-		.94f, 1.0f, 0.34f,		0.973417103f, 0.0f, 0.229039446f,	0.9418, 1.0,
-		.98f, 1.0f, 0.17f,		0.993150651f, 0.0f, 0.116841137f,	0.9695, 1.0,
-		.98f, 0.0f, 0.17f,		0.993150651f, 0.0f, 0.116841137f,	0.9695, 0.0,
-		1.0f, 0.0f, 0.0f,		0.993150651f, 0.0f, 0.116841137f,	1.0, 0.0,
-		.98f, 1.0f, 0.17f,		0.993150651f, 0.0f, 0.116841137f,	0.9695, 1.0,
-		1.0f, 1.0f, 0.0f,		0.993150651f, 0.0f, 0.116841137f,	1.0, 1.0,
-		1.0f, 0.0f, 0.0f,		0.993150651f, 0.0f, 0.116841137f,	1.0, 0.0
-	};
+///////////////////////////////////////////////////
+//	BuildCylinderMesh()
+//
+//	Create a cylinder mesh of the given number of
+//  slices around its axis, radius 1 from y = 0 to
+//  y = 1, and append it to the arena with coarser
+//  tessellations for its LOD levels.
+//
+//  Correct triangle drawing commands, in indices:
+//
+//	glDrawElements(GL_TRIANGLES, 3 * (slices - 2), 0);					//bottom
+//	glDrawElements(GL_TRIANGLES, 3 * (slices - 2), 3 * (slices - 2));	//top
+//	glDrawElements(GL_TRIANGLES, 6 * slices, 6 * (slices - 2));		//sides
+//	glDrawElements(GL_TRIANGLES, 3 * (slices - 2), 6 * (slices - 2) + 6 * slices);	//bottom again
+///////////////////////////////////////////////////
+void ShapeMeshes::BuildCylinderMesh(int slices)
+{
+	GenerateRadialMesh(m_CylinderMesh, "cylinder", glm::max(slices, 3), 1.0f, true);
+
+	// coarser rings for the distant LOD levels
+	GenerateRadialMesh(m_CylinderLODs[0], "cylinder LOD 1", 18, 1.0f, true);
+	GenerateRadialMesh(m_CylinderLODs[1], "cylinder LOD 2", 10, 1.0f, true);
+}
+
+///////////////////////////////////////////////////
+//	GenerateRadialMesh()
+//
+//	Build an indexed mesh around the y axis from a
+//  ring of radius 1 at y = 0 to a ring of topRadius
+//  at y = 1 and append it to the arena: the bottom
+//  cap fanned from its first rim vertex, the top cap
+//  when bTopCap is set, then the sides, each side
+//  vertex shared by the quads of two slices. The
+//  sides close on a copy of the first pair for the
+//  texture seam, and a topRadius of 0 makes a cone,
+//  its sides one triangle per slice. With a top cap
+//  the bottom cap is stored once more after the
+//  sides, so GetRadialRange() finds every mix of the
+//  caps and sides as one range.
+///////////////////////////////////////////////////
+void ShapeMeshes::GenerateRadialMesh(
+	GLMesh& mesh,
+	const char* name,
+	int slices,
+	float topRadius,
+	bool bTopCap)
+{
+	const int capCount = (bTopCap == true) ? 2 : 1;
+	const bool bCone = (topRadius <= 0.0f);
+	const glm::vec2* pCircle = GetUnitCircle(slices);
+
+	MESH_CURSOR cursor = AllocateArenaMesh(mesh, capCount * slices + 2 * (slices + 1),
+		(2 * capCount - 1) * RadialCapIndices(slices) + RadialSideIndices(slices, bCone));
+	mesh.slices = (GLuint)slices;
+
+	// the bottom cap goes around the other way to face down
+	for (int cap = 0; cap < capCount; cap++)
+	{
+		float y = (float)cap;
+		float radius = (cap == 0) ? 1.0f : topRadius;
+		glm::vec3 normal(0.0f, (cap == 0) ? -1.0f : 1.0f, 0.0f);
+		for (int i = 0; i < slices; i++)
+		{
+			int slice = (cap == 0) ? ((slices - i) % slices) : i;
+			float x = pCircle[slice].x;
+			float z = -pCircle[slice].y;
+			WriteVertex(cursor, glm::vec3(radius * x, y, radius * z), normal,
+				glm::vec2(0.5f + 0.5f * z, 0.5f + 0.5f * x));
+		}
+	}
 
-	glm::vec3 normal;
+	// the side normals lean up by how much the radius narrows
+	for (int i = 0; i <= slices; i++)
+	{
+		float x = pCircle[i].x;
+		float z = -pCircle[i].y;
+		float u = (float)i / (float)slices;
+		glm::vec3 normal = glm::normalize(glm::vec3(x, 1.0f - topRadius, z));
+		WriteVertex(cursor, glm::vec3(topRadius * x, 1.0f, topRadius * z), normal, glm::vec2(u, 1.0f));
+		WriteVertex(cursor, glm::vec3(x, 0.0f, z), normal, glm::vec2(u, 0.0f));
+	}
+
+	// the caps fan from their first rim vertex
+	for (int cap = 0; cap < capCount; cap++)
+	{
+		GLuint rim = (GLuint)(cap * slices);
+		for (GLuint i = 1; i + 1 < (GLuint)slices; i++)
+		{
+			WriteTriangle(cursor, rim, rim + i, rim + i + 1);
+		}
+	}
 
-	normal = CalculateTriangleNormal(glm::vec3(.98f, 1.0f, 0.17f), glm::vec3(.98f, 0.0f, 0.17f), glm::vec3(1.0f, 0.0f, 0.0f));
+	// each slice of the sides is the quad between two top and
+	// bottom pairs; the cone drops its half at the tip
+	for (GLuint i = 0; i < (GLuint)slices; i++)
+	{
+		GLuint top = (GLuint)(capCount * slices) + 2 * i;
+		if (bCone == false)
+		{
+			WriteTriangle(cursor, top, top + 1, top + 2);
+		}
+		WriteTriangle(cursor, top + 2, top + 1, top + 3);
+	}
 
-	// store vertex and index count
-	m_CylinderMesh.nVertices = sizeof(verts) / (sizeof(verts[0]) * (g_FloatsPerVertex + g_FloatsPerNormal + g_FloatsPerUV));
-	m_CylinderMesh.nIndices = 0;
+	// the sides and bottom cap again, for drawing them without the top
+	if (bTopCap == true)
+	{
+		for (GLuint i = 1; i + 1 < (GLuint)slices; i++)
+		{
+			WriteTriangle(cursor, 0, i, i + 1);
+		}
+	}
 
-	// Create VAO
-	glGenVertexArrays(1, &m_CylinderMesh.vao); // we can also generate multiple VAOs or buffers at the same time
-	glBindVertexArray(m_CylinderMesh.vao);
+	// the caps and sides are drawn apart, so each keeps its triangles
+	const GLsizei capIndices = RadialCapIndices(slices);
+	const GLsizei segmentEnds[] = { capIndices, 2 * capIndices, 2 * capIndices + RadialSideIndices(slices, bCone) };
+	FinishArenaMesh(mesh, name, segmentEnds, (bTopCap == true) ? 3 : 1);
+}
 
-	// Create VBO
-	glGenBuffers(1, m_CylinderMesh.vbos);
-	glBindBuffer(GL_ARRAY_BUFFER, m_CylinderMesh.vbos[0]); // Activates the buffer
-	glBufferData(GL_ARRAY_BUFFER, sizeof(verts), verts, GL_STATIC_DRAW); // Sends vertex or coordinate data to the GPU
+///////////////////////////////////////////////////
+//	GetRadialRange()
+//
+//	Find the one range of indices of a radial mesh,
+//  relative to its first, drawing the bottom cap,
+//  top cap and sides asked for. Its segments are the
+//  bottom, the top when it has one, the sides and
+//  the bottom again, so any mix of them is a run of
+//  neighbouring segments. False when none is asked
+//  for.
+///////////////////////////////////////////////////
+bool ShapeMeshes::GetRadialRange(
+	const GLMesh& mesh,
+	bool bTopCap,
+	bool bCone,
+	bool bBottom,
+	bool bTop,
+	bool bSides,
+	GLint& first,
+	GLsizei& count)
+{
+	const GLsizei capIndices = RadialCapIndices(mesh.slices);
+	const GLsizei sideIndices = RadialSideIndices(mesh.slices, bCone);
+	bTop = (bTop == true) && (bTopCap == true);
 
-	if (m_bMemoryLayoutDone == false)
+	if ((bBottom == true) && (bTop == false) && (bSides == true) && (bTopCap == true))
 	{
-		SetShaderMemoryLayout();
+		// the sides and the copy of the bottom after them
+		first = 2 * capIndices;
+		count = sideIndices + capIndices;
+		return(true);
 	}
+
+	const GLsizei topIndices = (bTopCap == true) ? capIndices : 0;
+	first = (bBottom == true) ? 0 : ((bTop == true) ? capIndices : capIndices + topIndices);
+	count = ((bBottom == true) ? capIndices : 0) + ((bTop == true) ? capIndices : 0) +
+		((bSides == true) ? sideIndices : 0);
+	return(count > 0);
 }
 
 ///////////////////////////////////////////////////
-//	LoadPlaneMesh()
+//	BuildPlaneMesh()
+//
+//	Create a plane mesh from -1 to 1 on x and z,
+//  facing up and split into divisions by divisions
+//  quads, and append it to the arena.
 //
-//	Create a plane mesh by specifying the vertices and 
-//  store it in a VAO/VBO.  The normals and texture
-//  coordinates are also set.
-// 
 //  Correct triangle drawing command:
 //
 //	glDrawElements(GL_TRIANGLES, meshes.gPlaneMesh.nIndices, GL_UNSIGNED_INT, (void*)0);
 ///////////////////////////////////////////////////
-void ShapeMeshes::LoadPlaneMesh()
+void ShapeMeshes::BuildPlaneMesh(int divisions)
 {
-	// Vertex data
-	GLfloat verts[] = {
-		// Vertex Positions		// Normals			// Texture coords	// Index
-		-1.0f, 0.0f, 1.0f,		0.0f, 1.0f, 0.0f,	0.0f, 0.0f,			//0
-		1.0f, 0.0f, 1.0f,		0.0f, 1.0f, 0.0f,	1.0f, 0.0f,			//1
-		1.0f,  0.0f, -1.0f,		0.0f, 1.0f, 0.0f,	1.0f, 1.0f,			//2
-		-1.0f, 0.0f, -1.0f,		0.0f, 1.0f, 0.0f,	0.0f, 1.0f,			//3
-	};
-
-	// Index data
-	GLuint indices[] = {
-		0,1,2,
-		0,3,2
-	};
-
-	// store vertex and index count
-	m_PlaneMesh.nVertices = sizeof(verts) / (sizeof(verts[0]) * (g_FloatsPerVertex + g_FloatsPerNormal + g_FloatsPerUV));
-	m_PlaneMesh.nIndices = sizeof(indices) / sizeof(indices[0]);
-
-	// Generate the VAO for the mesh
-	glGenVertexArrays(1, &m_PlaneMesh.vao);
-	glBindVertexArray(m_PlaneMesh.vao);	// activate the VAO
+	divisions = glm::max(divisions, 1);
 
-	// Create VBOs for the mesh
-	glGenBuffers(2, m_PlaneMesh.vbos);
-	glBindBuffer(GL_ARRAY_BUFFER, m_PlaneMesh.vbos[0]); // Activates the buffer
-	glBufferData(GL_ARRAY_BUFFER, sizeof(verts), verts, GL_STATIC_DRAW); // Sends data to the GPU
-
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_PlaneMesh.vbos[1]); // Activates the buffer
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
-
-	if (m_bMemoryLayoutDone == false)
-	{
-		SetShaderMemoryLayout();
-	}
+	MESH_CURSOR cursor = AllocateArenaMesh(m_PlaneMesh, QuadFaceVertices(divisions), QuadFaceIndices(divisions));
+	WriteQuadFace(cursor, glm::vec3(-1.0f, 0.0f, 1.0f),
+		glm::vec3(2.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, -2.0f), divisions);
+	FinishArenaMesh(m_PlaneMesh, "plane");
 }
 
 ///////////////////////////////////////////////////
-//	LoadPrismMesh()
+//	BuildPrismMesh()
 //
-//	Create a prism mesh by specifying the vertices and 
-//  store it in a VAO/VBO.  The normals and texture
-//  coordinates are also set.
+//	Create a unit triangular prism mesh, its back
+//  face at z = -0.5 and its front edge at z = 0.5,
+//  each face split divisions times along its edges,
+//  and append it to the arena.
 //
 //	Correct triangle drawing command:
 //
-//	glDrawArrays(GL_TRIANGLE_STRIP, 0, meshes.gPrismMesh.nVertices);
-///////////////////////////////////////////////////
-void ShapeMeshes::LoadPrismMesh()
-{
-	// Vertex data
-	GLfloat verts[] = {
-		//Positions				//Normals
-		// ------------------------------------------------------
-
-		//Back Face				//Negative Z Normal  
-		0.5f, 0.5f, -0.5f,		0.0f,  0.0f, -1.0f,		0.0f, 1.0f,
-		0.5f, -0.5f, -0.5f,		0.0f,  0.0f, -1.0f,		0.0f, 0.0f,
-		-0.5f, -0.5f, -0.5f,	0.0f,  0.0f, -1.0f,		1.0f, 0.0f,
-		0.5f, 0.5f, -0.5f,		0.0f,  0.0f, -1.0f,		0.0f, 1.0f,
-		0.5f,  0.5f, -0.5f,		0.0f,  0.0f, -1.0f,		0.0f, 1.0f,
-		-0.5f,  0.5f, -0.5f,	0.0f,  0.0f, -1.0f,		1.0f, 1.0f,
-		-0.5f, -0.5f, -0.5f,	0.0f,  0.0f, -1.0f,		1.0f, 0.0f,
-		0.5f,  0.5f, -0.5f,		0.0f,  0.0f, -1.0f,		0.0f, 1.0f,
-
-		//Bottom Face			//Negative Y Normal
-		0.5f, -0.5f, -0.5f,		0.0f, -1.0f,  0.0f,		0.0f, 0.0f,
-		-0.5f, -0.5f, -0.5f,	0.0f, -1.0f,  0.0f,		1.0f, 0.0f,
-		0.0f, -0.5f,  0.5f,		0.0f, -1.0f,  0.0f,		0.5f, 1.0f,
-		-0.5f, -0.5f,  -0.5f,	0.0f, -1.0f,  0.0f,		0.0f, 0.0f,
-
-		//Left Face/slanted		//Normals
-		-0.5f, -0.5f, -0.5f,	0.894427180f,  0.0f,  -0.447213590f,	0.0f, 0.0f,
-		-0.5f, 0.5f,  -0.5f,	0.894427180f,  0.0f,  -0.447213590f,	0.0f, 1.0f,
-		0.0f, 0.5f,  0.5f,		0.894427180f,  0.0f,  -0.447213590f,	1.0f, 1.0f,
-		-0.5f, -0.5f, -0.5f,	0.894427180f,  0.0f,  -0.447213590f,	0.0f, 0.0f,
-		-0.5f, -0.5f, -0.5f,	0.894427180f,  0.0f,  -0.447213590f,	0.0f, 0.0f,
-		0.0f, -0.5f,  0.5f,		0.894427180f,  0.0f,  -0.447213590f,	1.0f, 0.0f,
-		0.0f, 0.5f,  0.5f,		0.894427180f,  0.0f,  -0.447213590f,	1.0f, 1.0f,
-		-0.5f, -0.5f, -0.5f,	0.894427180f,  0.0f,  -0.447213590f,	0.0f, 0.0f,
-
-		//Right Face/slanted	//Normals
-		0.0f, 0.5f, 0.5f,		-0.894427180f,  0.0f,  -0.447213590f,		0.0f, 1.0f,
-		0.5f, 0.5f, -0.5f,		-0.894427180f,  0.0f,  -0.447213590f,		1.0f, 1.0f,
-		0.5f, -0.5f, -0.5f,		-0.894427180f,  0.0f,  -0.447213590f,		1.0f, 0.0f,
-		0.0f, 0.5f, 0.5f,		-0.894427180f,  0.0f,  -0.447213590f,		0.0f, 1.0f,
-		0.0f, 0.5f, 0.5f,		-0.894427180f,  0.0f,  -0.447213590f,		0.0f, 1.0f,
-		0.0f, -0.5f, 0.5f,		-0.894427180f,  0.0f,  -0.447213590f,		0.0f, 0.0f,
-		0.5f, -0.5f, -0.5f,		-0.894427180f,  0.0f,  -0.447213590f,		1.0f, 0.0f,
-		0.0f, 0.5f, 0.5f,		-0.894427180f,  0.0f,  -0.447213590f,		0.0f, 1.0f,
-
-		//Top Face				//Positive Y Normal		//Texture Coords.
-		0.5f, 0.5f, -0.5f,		0.0f,  1.0f,  0.0f,		0.0f, 0.0f,
-		0.0f,  0.5f,  0.5f,		0.0f,  1.0f,  0.0f,		0.5f, 1.0f,
-		-0.5f,  0.5f, -0.5f,	0.0f,  1.0f,  0.0f,		1.0f, 0.0f,
-		0.5f, 0.5f, -0.5f,		0.0f,  1.0f,  0.0f,		0.0f, 0.0f,
+//	glDrawElements(GL_TRIANGLES, meshes.gPrismMesh.nIndices, GL_UNSIGNED_INT, (void*)0);
+///////////////////////////////////////////////////
+void ShapeMeshes::BuildPrismMesh(int divisions)
+{
+	divisions = glm::max(divisions, 1);
 
+	const glm::vec3 sides[][3] = {
+		{ glm::vec3(0.5f, -0.5f, -0.5f), glm::vec3(-1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f) },	// back
+		{ glm::vec3(-0.5f, -0.5f, -0.5f), glm::vec3(0.5f, 0.0f, 1.0f), glm::vec3(0.0f, 1.0f, 0.0f) },	// left
+		{ glm::vec3(0.0f, -0.5f, 0.5f), glm::vec3(0.5f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f) }	// right
 	};
-
-	m_PrismMesh.nVertices = sizeof(verts) / (sizeof(verts[0]) * (g_FloatsPerVertex + g_FloatsPerNormal + g_FloatsPerUV));
-
-	glGenVertexArrays(1, &m_PrismMesh.vao); // we can also generate multiple VAOs or buffers at the same time
-	glBindVertexArray(m_PrismMesh.vao);
-
-	// Create 2 buffers: first one for the vertex data; second one for the indices
-	glGenBuffers(1, m_PrismMesh.vbos);
-	glBindBuffer(GL_ARRAY_BUFFER, m_PrismMesh.vbos[0]); // Activates the buffer
-	glBufferData(GL_ARRAY_BUFFER, sizeof(verts), verts, GL_STATIC_DRAW); // Sends vertex or coordinate data to the GPU
-
-	if (m_bMemoryLayoutDone == false)
+	const glm::vec3 bottom[] = {
+		glm::vec3(0.5f, -0.5f, -0.5f), glm::vec3(0.0f, -0.5f, 0.5f), glm::vec3(-0.5f, -0.5f, -0.5f) };
+	const glm::vec3 top[] = {
+		glm::vec3(0.5f, 0.5f, -0.5f), glm::vec3(-0.5f, 0.5f, -0.5f), glm::vec3(0.0f, 0.5f, 0.5f) };
+	const glm::vec2 bottomUVs[] = { glm::vec2(0.0f, 0.0f), glm::vec2(0.5f, 1.0f), glm::vec2(1.0f, 0.0f) };
+	const glm::vec2 topUVs[] = { glm::vec2(0.0f, 0.0f), glm::vec2(1.0f, 0.0f), glm::vec2(0.5f, 1.0f) };
+
+	MESH_CURSOR cursor = AllocateArenaMesh(m_PrismMesh,
+		3 * QuadFaceVertices(divisions) + 2 * TriangleFaceVertices(divisions),
+		3 * QuadFaceIndices(divisions) + 2 * TriangleFaceIndices(divisions));
+	WriteTriangleFace(cursor, bottom, bottomUVs, divisions);
+	for (int i = 0; i < 3; i++)
 	{
-		SetShaderMemoryLayout();
+		WriteQuadFace(cursor, sides[i][0], sides[i][1], sides[i][2], divisions);
 	}
+	WriteTriangleFace(cursor, top, topUVs, divisions);
+	FinishArenaMesh(m_PrismMesh, "prism");
 }
 
 ///////////////////////////////////////////////////
-//	LoadPyramid3Mesh()
+//	BuildPyramid3Mesh()
 //
-//	Create a 3-sided pyramid mesh by specifying the 
-//  vertices and store it in a VAO/VBO.  The normals 
-//  and texture coordinates are also set.
+//	Create a 3-sided pyramid mesh, its base at
+//  y = -0.5 and its tip at y = 0.5, each face split
+//  divisions times along its edges, and append it
+//  to the arena.
 //
 //  Correct triangle drawing command:
 //
-//	glDrawArrays(GL_TRIANGLE_STRIP, 0, gPyramid3Mesh.nVertices);
-///////////////////////////////////////////////////
-void ShapeMeshes::LoadPyramid3Mesh()
-{
-	// Vertex data
-	GLfloat verts[] = {
-		// Vertex Positions		// Normals			// Texture coords
-		//left side
-		0.0f, 0.5f, 0.0f,		-0.894427180f, 0.0f, -0.447213590f,	0.5f, 1.0f,		//top point	
-		0.0f, -0.5f, -0.5f,		-0.894427180f, 0.0f, -0.447213590f,	0.0f, 0.0f,		//back center
-		-0.5f, -0.5f, 0.5f,		-0.894427180f, 0.0f, -0.447213590f,	1.0f, 0.0f,     //front bottom left
-		0.0f, 0.5f, 0.0f,		-0.894427180f, 0.0f, -0.447213590f,	0.5f, 1.0f,		//top point	
-		//right side
-		0.0f, 0.5f, 0.0f,		0.894427180f, 0.0f, -0.447213590f,	0.5f, 1.0f,		//top point	
-		0.5f, -0.5f, 0.5f,		0.894427180f, 0.0f, -0.447213590f,	0.0f, 0.0f,     //front bottom right
-		0.0f, -0.5f, -0.5f,		0.894427180f, 0.0f, -0.447213590f,	1.0f, 0.0f,		//back center	
-		0.0f, 0.5f, 0.0f,		0.894427180f, 0.0f, -0.447213590f,	0.5f, 1.0f,		//top point	
-		//front side
-		0.0f, 0.5f, 0.0f,		0.0f, 0.0f, 1.0f,	0.5f, 1.0f,		//top point			
-		-0.5f, -0.5f, 0.5f,		0.0f, 0.0f, 1.0f,	0.0f, 0.0f,     //front bottom left	
-		0.5f, -0.5f, 0.5f,		0.0f, 0.0f, 1.0f,	1.0f, 0.0f,     //front bottom right
-		0.0f, 0.5f, 0.0f,		0.0f, 0.0f, 1.0f,	0.5f, 1.0f,		//top point	
-		//bottom side
-		-0.5f, -0.5f, 0.5f,		0.0f, -1.0f, 0.0f,	0.0f, 1.0f,     //front bottom left
-		0.5f, -0.5f, 0.5f,		0.0f, -1.0f, 0.0f,	1.0f, 1.0f,     //front bottom right
-		0.0f, -0.5f, -0.5f,		0.0f, -1.0f, 0.0f,	0.5f, 0.0f,		//back center	
-		-0.5f, -0.5f, 0.5f,		0.0f, -1.0f, 0.0f,	0.0f, 1.0f,     //front bottom left
+//	glDrawElements(GL_TRIANGLES, meshes.gPyramid3Mesh.nIndices, GL_UNSIGNED_INT, (void*)0);
+///////////////////////////////////////////////////
+void ShapeMeshes::BuildPyramid3Mesh(int divisions)
+{
+	divisions = glm::max(divisions, 1);
+
+	const glm::vec3 top(0.0f, 0.5f, 0.0f);
+	const glm::vec3 back(0.0f, -0.5f, -0.5f);
+	const glm::vec3 frontLeft(-0.5f, -0.5f, 0.5f);
+	const glm::vec3 frontRight(0.5f, -0.5f, 0.5f);
+
+	// corners in counterclockwise order seen from outside
+	const glm::vec3 faces[][3] = {
+		{ back, frontLeft, top },			// left
+		{ frontRight, back, top },			// right
+		{ frontLeft, frontRight, top },		// front
+		{ frontLeft, back, frontRight }		// bottom
 	};
+	const glm::vec2 sideUVs[] = { glm::vec2(0.0f, 0.0f), glm::vec2(1.0f, 0.0f), glm::vec2(0.5f, 1.0f) };
+	const glm::vec2 bottomUVs[] = { glm::vec2(0.0f, 1.0f), glm::vec2(0.5f, 0.0f), glm::vec2(1.0f, 1.0f) };
 
-	// Calculate total defined vertices
-	m_Pyramid3Mesh.nVertices = sizeof(verts) / (sizeof(verts[0]) * (g_FloatsPerVertex + g_FloatsPerNormal + g_FloatsPerUV));
-
-	glGenVertexArrays(1, &m_Pyramid3Mesh.vao);				// Creates 1 VAO
-	glGenBuffers(1, m_Pyramid3Mesh.vbos);					// Creates 1 VBO
-	glBindVertexArray(m_Pyramid3Mesh.vao);					// Activates the VAO
-	glBindBuffer(GL_ARRAY_BUFFER, m_Pyramid3Mesh.vbos[0]);	// Activates the VBO
-	// Sends vertex or coordinate data to the GPU
-	glBufferData(GL_ARRAY_BUFFER, sizeof(verts), verts, GL_STATIC_DRAW);
-
-	if (m_bMemoryLayoutDone == false)
+	MESH_CURSOR cursor = AllocateArenaMesh(m_Pyramid3Mesh, 4 * TriangleFaceVertices(divisions), 4 * TriangleFaceIndices(divisions));
+	for (int i = 0; i < 4; i++)
 	{
-		SetShaderMemoryLayout();
+		WriteTriangleFace(cursor, faces[i], (i < 3) ? sideUVs : bottomUVs, divisions);
 	}
+	FinishArenaMesh(m_Pyramid3Mesh, "pyramid3");
 }
 
 ///////////////////////////////////////////////////
-//	LoadPyramid4Mesh()
+//	BuildPyramid4Mesh()
 //
-//	Create a 4-sided pyramid mesh by specifying the 
-//  vertices and store it in a VAO/VBO.  The normals 
-//  and texture coordinates are also set.
+//	Create a 4-sided pyramid mesh, its unit square
+//  base at y = -0.5 and its tip at y = 0.5, each
+//  face split divisions times along its edges, and
+//  append it to the arena.
 //
 //  Correct triangle drawing command:
 //
-//	glDrawArrays(GL_TRIANGLE_STRIP, 0, meshes.gPyramid4Mesh.nVertices);
-///////////////////////////////////////////////////
-void ShapeMeshes::LoadPyramid4Mesh()
-{
-	// Vertex data
-	GLfloat verts[] = {
-		// Vertex Positions		// Normals			// Texture coords
-		//bottom side
-		-0.5f, -0.5f, 0.5f,		0.0f, -1.0f, 0.0f,	0.0f, 1.0f,     //front bottom left
-		-0.5f, -0.5f, -0.5f,	0.0f, -1.0f, 0.0f,	0.0f, 0.0f,		//back bottom left
-		0.5f, -0.5f, -0.5f,		0.0f, -1.0f, 0.0f,	1.0f, 0.0f,		//back bottom right	
-		-0.5f, -0.5f, 0.5f,		0.0f, -1.0f, 0.0f,	0.0f, 1.0f,     //front bottom left
-		-0.5f, -0.5f, 0.5f,		0.0f, -1.0f, 0.0f,	0.0f, 1.0f,     //front bottom left
-		0.5f, -0.5f, 0.5f,		0.0f, -1.0f, 0.0f,	1.0f, 1.0f,     //front bottom right
-		0.5f, -0.5f, -0.5f,		0.0f, -1.0f, 0.0f,	1.0f, 0.0f,		//back bottom right	
-		-0.5f, -0.5f, 0.5f,		0.0f, -1.0f, 0.0f,	0.0f, 1.0f,     //front bottom left
-		//back side
-		0.0f, 0.5f, 0.0f,		0.0f, 0.0f, -1.0f,	0.5f, 1.0f,		//top point	
-		0.5f, -0.5f, -0.5f,		0.0f, 0.0f, -1.0f,	0.0f, 0.0f,		//back bottom right	
-		-0.5f, -0.5f, -0.5f,	0.0f, 0.0f, -1.0f,	1.0f, 0.0f,		//back bottom left
-		0.0f, 0.5f, 0.0f,		0.0f, 0.0f, -1.0f,	0.5f, 1.0f,		//top point	
-		//left side
-		0.0f, 0.5f, 0.0f,		-1.0f, 0.0f, 0.0f,	0.5f, 1.0f,		//top point	
-		-0.5f, -0.5f, -0.5f,	-1.0f, 0.0f, 0.0f,	0.0f, 0.0f,		//back bottom left	
-		-0.5f, -0.5f, 0.5f,		-1.0f, 0.0f, 0.0f,	1.0f, 0.0f,     //front bottom left
-		0.0f, 0.5f, 0.0f,		-1.0f, 0.0f, 0.0f,	0.5f, 1.0f,		//top point	
-		//right side
-		0.0f, 0.5f, 0.0f,		1.0f, 0.0f, 0.0f,	0.5f, 1.0f,		//top point	
-		0.5f, -0.5f, 0.5f,		1.0f, 0.0f, 0.0f,	0.0f, 0.0f,     //front bottom right
-		0.5f, -0.5f, -0.5f,		1.0f, 0.0f, 0.0f,	1.0f, 0.0f,		//back bottom right	
-		0.0f, 0.5f, 0.0f,		1.0f, 0.0f, 0.0f,	0.5f, 1.0f,		//top point	
-		//front side
-		0.0f, 0.5f, 0.0f,		0.0f, 0.0f, 1.0f,	0.5f, 1.0f,		//top point			
-		-0.5f, -0.5f, 0.5f,		0.0f, 0.0f, 1.0f,	0.0f, 0.0f,     //front bottom left	
-		0.5f, -0.5f, 0.5f,		0.0f, 0.0f, 1.0f,	1.0f, 0.0f,     //front bottom right
-		0.0f, 0.5f, 0.0f,		0.0f, 0.0f, 1.0f,	0.5f, 1.0f,		//top point
+//	glDrawElements(GL_TRIANGLES, meshes.gPyramid4Mesh.nIndices, GL_UNSIGNED_INT, (void*)0);
+///////////////////////////////////////////////////
+void ShapeMeshes::BuildPyramid4Mesh(int divisions)
+{
+	divisions = glm::max(divisions, 1);
+
+	const glm::vec3 top(0.0f, 0.5f, 0.0f);
+	const glm::vec3 backLeft(-0.5f, -0.5f, -0.5f);
+	const glm::vec3 backRight(0.5f, -0.5f, -0.5f);
+	const glm::vec3 frontLeft(-0.5f, -0.5f, 0.5f);
+	const glm::vec3 frontRight(0.5f, -0.5f, 0.5f);
+
+	// corners in counterclockwise order seen from outside
+	const glm::vec3 sides[][3] = {
+		{ backRight, backLeft, top },		// back
+		{ backLeft, frontLeft, top },		// left
+		{ frontRight, backRight, top },		// right
+		{ frontLeft, frontRight, top }		// front
 	};
+	const glm::vec2 sideUVs[] = { glm::vec2(0.0f, 0.0f), glm::vec2(1.0f, 0.0f), glm::vec2(0.5f, 1.0f) };
 
-	// Calculate total defined vertices
-	m_Pyramid4Mesh.nVertices = sizeof(verts) / (sizeof(verts[0]) * (g_FloatsPerVertex + g_FloatsPerNormal + g_FloatsPerUV));
-
-	glGenVertexArrays(1, &m_Pyramid4Mesh.vao);				// Creates 1 VAO
-	glGenBuffers(1, m_Pyramid4Mesh.vbos);					// Creates 1 VBO
-	glBindVertexArray(m_Pyramid4Mesh.vao);					// Activates the VAO
-	glBindBuffer(GL_ARRAY_BUFFER, m_Pyramid4Mesh.vbos[0]);	// Activates the VBO
-	// Sends vertex or coordinate data to the GPU
-	glBufferData(GL_ARRAY_BUFFER, sizeof(verts), verts, GL_STATIC_DRAW);
-
-	if (m_bMemoryLayoutDone == false)
+	MESH_CURSOR cursor = AllocateArenaMesh(m_Pyramid4Mesh,
+		QuadFaceVertices(divisions) + 4 * TriangleFaceVertices(divisions),
+		QuadFaceIndices(divisions) + 4 * TriangleFaceIndices(divisions));
+	WriteQuadFace(cursor, backLeft, glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f), divisions);
+	for (int i = 0; i < 4; i++)
 	{
-		SetShaderMemoryLayout();
+		WriteTriangleFace(cursor, sides[i], sideUVs, divisions);
 	}
+	FinishArenaMesh(m_Pyramid4Mesh, "pyramid4");
 }
 
 ///////////////////////////////////////////////////
-//	LoadSphereMesh()
+//	BuildSphereMesh()
 //
-//	Create a sphere mesh by specifying the vertices and 
-//  store it in a VAO/VBO.  The normals and texture
-//  coordinates are also set.
+//	Create a unit sphere mesh of the given number of
+//  bands from pole to pole and slices around, both
+//  rounded up to even, and append it to the arena
+//  with coarser tessellations for its LOD levels.
 //
 //  Correct triangle drawing command:
 //
 //	glDrawElements(GL_TRIANGLES, meshes.gSphereMesh.nIndices, GL_UNSIGNED_INT, (void*)0);
 ///////////////////////////////////////////////////
-void ShapeMeshes::LoadSphereMesh()
-{
-	GLfloat verts[] = {
-		// vertex data					// texture coords			// index
-		// top center point
-		0.0f, 1.0f, 0.0f,				0.5f, 1.0f,					//0
-		// ring 1
-		0.0f, 0.9808f, 0.1951f,			0.5f, 0.9375f,				//1
-		0.0747f, 0.9808f, 0.1802f,		0.51219375f, 0.9375f,		//2
-		0.1379f, 0.9808f, 0.1379f,		0.5243875f, 0.9375f,		//3
-		0.1802f, 0.9808f, 0.0747f,		0.53658125f, 0.9375f,		//4
-		0.1951f, 0.9808, 0.0f,			0.548775f, 0.9375f,			//5
-		0.1802f, 0.9808f, -0.0747f,		0.56096875f, 0.9375f,		//6
-		0.1379f, 0.9808f, -0.1379f,		0.5731625f, 0.9375f,		//7
-		0.0747f, 0.9808f, -0.1802f,		0.58535625f, 0.9375f,		//8
-		0.0f, 0.9808f, -0.1951f,		0.59755f, 0.9375f,			//9 - seam
-		0.0f, 0.9808f, -0.1951f,		0.40245f, 0.9375f,			//10 - seam
-		-0.0747f, 0.9808f, -0.1802f,	0.41464375f, 0.9375f,		//11
-		-0.1379f, 0.9808f, -0.1379f,	0.4268375f, 0.9375f,		//12
-		-0.1802f, 0.9808f, -0.0747f,	0.43903125f, 0.9375f,		//13
-		-0.1951f, 0.9808, 0.0f,			0.451225f, 0.9375f,			//14
-		-0.1802f, 0.9808f, 0.0747f,		0.46341875f, 0.9375f,		//15
-		-0.1379f, 0.9808f, 0.1379f,		0.4756125f, 0.9375f,		//16
-		-0.0747f, 0.9808f, 0.1802f,		0.48780625f, 0.9375f,		//17
-		// ring 2
-		0.0f, 0.9239f, 0.3827f,			0.5f, 0.875f,				//18
-		0.1464f, 0.9239f, 0.3536f,		0.52391875f, 0.875f,		//19
-		0.2706f, 0.9239f, 0.2706f,		0.5478375f, 0.875f,			//20
-		0.3536f, 0.9239f, 0.1464f,		0.57175625f, 0.875f,		//21
-		0.3827f, 0.9239f, 0.0f,			0.5956755f, 0.875f,			//22
-		0.3536f, 0.9239f, -0.1464f,		0.61959425f, 0.875f,		//23
-		0.2706f, 0.9239f, -0.2706f,		0.643513f, 0.875f,			//24
-		0.1464f, 0.9239f, -0.3536f,		0.66743175f, 0.875f,		//25
-		0.0f, 0.9239f, -0.3827f,		0.6913505f, 0.875f,			//26 - seam
-		0.0f, 0.9239f, -0.3827f,		0.3086495f, 0.875f,			//27 - seam
-		-0.1464f, 0.9239f, -0.3536f,	0.33256825f, 0.875f,		//28
-		-0.2706f, 0.9239f, -0.2706f,	0.356487f, 0.875f,			//29
-		-0.3536f, 0.9239f, -0.1464f,	0.38040575f, 0.875f,		//30
-		-0.3827f, 0.9239f, 0.0f,		0.4043245f, 0.875f,			//31
-		-0.3536f, 0.9239f, 0.1464f,		0.42824325f, 0.875f,		//32
-		-0.2706f, 0.9239f, 0.2706f,		0.452162f, 0.875f,			//33
-		-0.1464f, 0.9239f, 0.3536f,		0.47608075f, 0.875f,		//34
-		// ring 3
-		0.0f, 0.8315f, 0.5556f,			0.5f, 0.8125f,				//35
-		0.2126f, 0.8315f, 0.5133f,		0.534725f, 0.8125f,			//36
-		0.3928f, 0.8315f, 0.3928f,		0.56945f, 0.8125f,			//37
-		0.5133f, 0.8315f, 0.2126f,		0.604175f, 0.8125f,			//38
-		0.5556f, 0.8315f, 0.0f,			0.6389f, 0.8125f,			//39
-		0.5133f, 0.8315f, -0.2126f,		0.673625f, 0.8125f,			//40
-		0.3928f, 0.8315f, -0.3928f,		0.70835f, 0.8125f,			//41
-		0.2126f, 0.8315f, -0.5133f,		0.743075f, 0.8125f,			//42
-		0.0f, 0.8315f, -0.5556f,		0.7778f, 0.8125f,			//43 - seam
-		0.0f, 0.8315f, -0.5556f,		0.2222f, 0.8125f,			//44 - seam
-		-0.2126f, 0.8315f, -0.5133f,	0.256925f, 0.8125f,			//45
-		-0.3928f, 0.8315f, -0.3928f,	0.29165f, 0.8125f,			//46
-		-0.5133f, 0.8315f, -0.2126f,	0.326375f, 0.8125f,			//47
-		-0.5556f, 0.8315f, 0.0f,		0.3611f, 0.8125f,			//48
-		-0.5133f, 0.8315f, 0.2126f,		0.395825f, 0.8125f,			//49
-		-0.3928f, 0.8315f, 0.3928f,		0.43055f, 0.8125f,			//50
-		-0.2126f, 0.8315f, 0.5133f,		0.465275f, 0.8125f,			//51
-		// ring 4
-		0.0f, 0.7071f, 0.7071f,			0.5f, 0.75f,				//52
-		0.2706f, 0.7071f, 0.6533f,		0.54419375f, 0.75f,			//53
-		0.5f, 0.7071f, 0.5f,			0.5883875f, 0.75f,			//54
-		0.6533f, 0.7071f, 0.2706f,		0.63258125f, 0.75f,			//55
-		0.7071f, 0.7071f, 0.0f,			0.676775f, 0.75f,			//56
-		0.6533f, 0.7071f, -0.2706f,		0.72096875f, 0.75f,			//57
-		0.5f, 0.7071f, -0.5f,			0.7651625f, 0.75f,			//58
-		0.2706f, 0.7071f, -0.6533f,		0.80935625f, 0.75f,			//59
-		0.0f, 0.7071f, -0.7071f,		0.85355f, 0.75f,			//60 - seam
-		0.0f, 0.7071f, -0.7071f,		0.14645f, 0.75f,			//61 - seam
-		-0.2706f, 0.7071f, -0.6533f,	0.19064375f, 0.75f,			//62
-		-0.5f, 0.7071f, -0.5f,			0.2348375f, 0.75f,			//63
-		-0.6533f, 0.7071f, -0.2706f,	0.27903135f, 0.75f,			//64
-		-0.7071f, 0.7071f, 0.0f,		0.323225f, 0.75f,			//65
-		-0.6533f, 0.7071f, 0.2706f,		0.36741875f, 0.75f,			//66
-		-0.5f, 0.7071f, 0.5f,			0.4116125f, 0.75f,			//67
-		-0.2706f, 0.7071f, 0.6533f,		0.45580625f, 0.75f,			//68
-		// ring 5
-		0.0f, 0.5556f, 0.8315f,			0.5f, 0.6875f,				//69
-		0.3182f, 0.5556f, 0.7682f,		0.55196875f, 0.6875f,		//70
-		0.5879f, 0.5556f, 0.5879f,		0.6039375f, 0.6875f,		//71
-		0.7682f, 0.5556f, 0.3182f,		0.65590625f, 0.6875f,		//72
-		0.8315f, 0.5556f, 0.0f,			0.707875f, 0.6875f,			//73
-		0.7682f, 0.5556f, -0.3182f,		0.75984375f, 0.6875f,		//74
-		0.5879f, 0.5556f, -0.5879f,		0.8118125f, 0.6875f,		//75
-		0.3182f, 0.5556f, -0.7682f,		0.86378125f, 0.6875f,		//76
-		0.0f, 0.5556f, -0.8315f,		0.91575f, 0.6875f,			//77 - seam
-		0.0f, 0.5556f, -0.8315f,		0.08425f, 0.6875f,			//78 - seam
-		-0.3182f, 0.5556f, -0.7682f,	0.13621875f, 0.6875f,		//79
-		-0.5879f, 0.5556f, -0.5879f,	0.1881875f, 0.6875f,		//80
-		-0.7682f, 0.5556f, -0.3182f,	0.24015625f, 0.6875f,		//81
-		-0.8315f, 0.5556f, 0.0f,		0.292125f, 0.6875f,			//82
-		-0.7682f, 0.5556f, 0.3182f,		0.34409375f, 0.6875f,		//83
-		-0.5879f, 0.5556f, 0.5879f,		0.3960625f, 0.6875f,		//84
-		-0.3182f, 0.5556f, 0.7682f,		0.44803125f, 0.6875f,		//85
-		//ring 6
-		0.0f, 0.3827f, 0.9239f,			0.5f, 0.625f,				//86
-		0.3536f, 0.3827f, 0.8536f,		0.55774375f, 0.625f,		//87
-		0.6533f, 0.3827f, 0.6533f,		0.6154875f, 0.625f,			//88
-		0.8536f, 0.3827f, 0.3536f,		0.67323125f, 0.625f,		//89
-		0.9239f, 0.3827f, 0.0f,			0.730975f, 0.625f,			//90
-		0.8536f, 0.3827f, -0.3536f,		0.78871875f, 0.625f,		//91
-		0.6533f, 0.3827f, -0.6533f,		0.8464625f, 0.625f,			//92
-		0.3536f, 0.3827f, -0.8536f,		0.90420625f, 0.625f,		//93
-		0.0f, 0.3827f, -0.9239f,		0.96195f, 0.625f,			//94 - seam
-		0.0f, 0.3827f, -0.9239f,		0.03805f, 0.625f,			//95 - seam
-		-0.3536f, 0.3827f, -0.8536f,	0.09579375f, 0.625f,		//96
-		-0.6533f, 0.3827f, -0.6533f,	0.1535375f, 0.625f,			//97
-		-0.8536f, 0.3827f, -0.3536f,	0.21128125f, 0.625f,		//98
-		-0.9239f, 0.3827f, 0.0f,		0.269025f, 0.625f,			//99
-		-0.8536f, 0.3827f, 0.3536f,		0.32676875f, 0.625f,		//100
-		-0.6533f, 0.3827f, 0.6533f,		0.3845125f, 0.625f,			//101
-		-0.3536f, 0.3827f, 0.8536f,		0.44225625f, 0.625f,		//102
-		// ring 7
-		0.0f, 0.1951f, 0.9808f,			0.5f, 0.5625f,				//103
-		0.3753f, 0.1915f, 0.9061f,		0.5613f, 0.5625f,			//104
-		0.6935f, 0.1915f, 0.6935f,		0.6226f, 0.5625f,			//105
-		0.9061f, 0.1915f, 0.3753f,		0.6839f, 0.5625f,			//106
-		0.9808f, 0.1915f, 0.0f,			0.7452f, 0.5625f,			//107
-		0.9061f, 0.1915f, -0.3753f,		0.8065f, 0.5625f,			//108
-		0.6935f, 0.1915f, -0.6935f,		0.8678f, 0.5625f,			//109
-		0.3753f, 0.1915f, -0.9061f,		0.9291f, 0.5625f,			//110
-		0.0f, 0.1915f, -0.9808f,		0.9904f, 0.5625f,			//111 - seam
-		0.0f, 0.1915f, -0.9808f,		0.0096f, 0.5625f,			//112 - seam
-		-0.3753f, 0.1915f, -0.9061f,	0.0709f, 0.5625f,			//113
-		-0.6935f, 0.1915f, -0.6935f,	0.1322f, 0.5625f,			//114
-		-0.9061f, 0.1915f, -0.3753f,	0.1935f, 0.5625f,			//115
-		-0.9808f, 0.1915f, 0.0f,		0.2548f, 0.5625f,			//116
-		-0.9061f, 0.1915f, 0.3753f,		0.3161f, 0.5625f,			//117
-		-0.6935f, 0.1915f, 0.6935f,		0.3774f, 0.5625f,			//118
-		-0.3753f, 0.1915f, 0.9061f,		0.4387f, 0.5625f,			//119
-		// ring 8
-		0.0f, 0.0f, 1.0f,				0.5f, 0.5f,					//120
-		0.3827f, 0.0f, 0.9239f,			0.5625f, 0.5f,				//121
-		0.7071f, 0.0f, 0.7071f,			0.625f, 0.5f,				//122
-		0.9239f, 0.0f, 0.3827f,			0.6875f, 0.5f,				//123
-		1.0f, 0.0f, 0.0f,				0.75f, 0.5f,				//124
-		0.9239f, 0.0f, -0.3827f,		0.8125f, 0.5f,				//125
-		0.7071f, 0.0f, -0.7071f,		0.875f, 0.5f,				//126
-		0.3827f, 0.0f, -0.9239f,		0.9375f, 0.5f,				//127
-		0.0f, 0.0f, -1.0f,				1.0f, 0.5f,					//128 - seam
-		0.0f, 0.0f, -1.0f, 				0.0f, 0.5f,					//129 - seam
-		-0.3827f, 0.0f, -0.9239f,		0.0625f, 0.5f,				//130
-		-0.7071f, 0.0f, -0.7071f,		0.125f, 0.5f,				//131
-		-0.9239f, 0.0f, -0.3827f,		0.1875f, 0.5f,				//132
-		-1.0f, 0.0f, 0.0f,				0.25f, 0.5f,				//133
-		-0.9239f, 0.0f, 0.3827f,		0.3125f, 0.5f,				//134
-		-0.7071, 0.0, 0.7071f,			0.375f, 0.5f,				//135
-		-0.3827f, 0.0f, 0.9239f,		0.4375f, 0.5f,				//136
-		// ring 9
-		0.0f, -0.1915f, 0.9808f,		0.5f, 0.4375f,				//137
-		0.3753f, -0.1915f, 0.9061f,		0.5613f, 0.4375f,			//138
-		0.6935f, -0.1915f, 0.6935f,		0.6226f, 0.4375f,			//139
-		0.9061f, -0.1915f, 0.3753f,		0.6839f, 0.4375f,			//140
-		0.9808f, -0.1915f, 0.0f,		0.7452f, 0.4375f,			//141
-		0.9061f, -0.1915f, -0.3753f,	0.8065f, 0.4375f,			//142
-		0.6935f, -0.1915f, -0.6935f,	0.8678f, 0.4375f,			//143
-		0.3753f, -0.1915f, -0.9061f,	0.9261f, 0.4375f,			//144
-		0.0f, -0.1915f, -0.9808f,		0.9904f, 0.4375f,			//145 - seam
-		0.0f, -0.1915f, -0.9808f,		0.0096f, 0.4375f,			//146 - seam
-		-0.3753f, -0.1915f, -0.9061f,	0.0709f, 0.4375f,			//147
-		-0.6935f, -0.1915f, -0.6935f,	0.1322f, 0.4375f,			//148
-		-0.9061f, -0.1915f, -0.3753f,	0.1935f, 0.4375f,			//149
-		-0.9808f, -0.1915f, 0.0f,		0.2548f, 0.4375f,			//150
-		-0.9061f, -0.1915f, 0.3753f,	0.3161f, 0.4375f,			//151
-		-0.6935f, -0.1915f, 0.6935f,	0.3774f, 0.4375f,			//152
-		-0.3753f, -0.1915f, 0.9061f,	0.4387f, 0.4375f,			//153
-		// ring 10
-		0.0f, -0.3827f, 0.9239f,		0.5f, 0.375f,				//154
-		0.3536f, -0.3827f, 0.8536f,		0.55774375f, 0.375f,		//155
-		0.6533f, -0.3827f, 0.6533f,		0.6154875f, 0.375f,			//156
-		0.8536f, -0.3827f, 0.3536f,		0.67323125f, 0.375f,		//157
-		0.9239f, -0.3827f, 0.0f,		0.730975f, 0.375f,			//158
-		0.8536f, -0.3827f, -0.3536f,	0.78871875f, 0.375f,		//159
-		0.6533f, -0.3827f, -0.6533f,	0.8464625f, 0.375f,			//160
-		0.3536f, -0.3827f, -0.8536f,	0.90420625f, 0.375f,		//161
-		0.0f, -0.3827f, -0.9239f,		0.96195f, 0.375f,			//162 - seam
-		0.0f, -0.3827f, -0.9239f,		0.03805f, 0.375f,			//163 - seam
-		-0.3536f, -0.3827f, -0.8536f,	0.09579375f, 0.375f,		//164
-		-0.6533f, -0.3827f, -0.6533f,	0.1535375f, 0.375f,			//165
-		-0.8536f, -0.3827f, -0.3536f,	0.21128125f, 0.375f,		//166
-		-0.9239f, -0.3827f, 0.0f,		0.269025f, 0.375f,			//167
-		-0.8536f, -0.3827f, 0.3536f,	0.32676875f, 0.375f,		//168
-		-0.6533f, -0.3827f, 0.6533f,	0.3845125f, 0.375f,			//169
-		-0.3536f, -0.3827f, 0.8536f,	0.44225625f, 0.375f,		//170
-		// ring 11
-		0.0f, -0.5556f, 0.8315f,		0.5f, 0.3125f,				//171
-		0.3182f, -0.5556f, 0.7682f,		0.55196875f, 0.3125f,		//172
-		0.5879f, -0.5556f, 0.5879f,		0.6039375f, 0.3125f,		//173
-		0.7682f, -0.5556f, 0.3182f,		0.65590625f, 0.3125f,		//174
-		0.8315f, -0.5556f, 0.0f,		0.707875f, 0.3125f,			//175
-		0.7682f, -0.5556f, -0.3182f,	0.75984375f, 0.3125f,		//176
-		0.5879f, -0.5556f, -0.5879f,	0.8118125f, 0.3125f,		//177
-		0.3182f, -0.5556f, -0.7682f,	0.86378125f, 0.3125f,		//178
-		0.0f, -0.5556f, -0.8315f,		0.91575f, 0.3125f,			//179 - seam
-		0.0f, -0.5556f, -0.8315f,		0.08425f, 0.3125f,			//180 - seam
-		-0.3182f, -0.5556f, -0.7682f,	0.13621875f, 0.3125f,		//181
-		-0.5879f, 0.5556f, -0.5879f,	0.1881875f, 0.3125f,		//182
-		-0.7682f, -0.5556f, -0.3182f,	0.24015625f, 0.3125f,		//183
-		-0.8315f, -0.5556f, 0.0f,		0.292125f, 0.3125f,			//184
-		-0.7682f, -0.5556f, 0.3182f,	0.34409375f, 0.3125f,		//185
-		-0.5879f, -0.5556f, 0.5879f,	0.3960625f, 0.3125f,		//186
-		-0.3182f, -0.5556f, 0.7682f,	0.44803125f, 0.3125f,		//187
-		// ring 12
-		0.0f, -0.7071f, 0.7071f,		0.5f, 0.25f,				//188
-		0.2706f, -0.7071f, 0.6533f,		0.54419375f, 0.25f,			//189
-		0.5f, -0.7071f, 0.5f,			0.5883875f, 0.25f,			//190
-		0.6533f, -0.7071f, 0.2706f,		0.63258125f, 0.25f,			//191
-		0.7071f, -0.7071f, 0.0f,		0.676775f, 0.25f,			//192
-		0.6533f, -0.7071f, -0.2706f,	0.72096875f, 0.25f,			//193
-		0.5f, -0.7071f, -0.5f,			0.7651625f, 0.25f,			//194
-		0.2706f, -0.7071f, -0.6533f,	0.80935625f, 0.25f,			//195
-		0.0f, -0.7071f, -0.7071f,		0.85355f, 0.25f,			//196 - seam
-		0.0f, -0.7071f, -0.7071f,		0.14645f, 0.25f,			//197 - seam
-		-0.2706f, -0.7071f, -0.6533f,	0.19064375f, 0.25f,			//198
-		-0.5f, -0.7071f, -0.5f,			0.2348375f, 0.25f,			//199
-		-0.6533f, -0.7071f, -0.2706f,	0.27903135f, 0.25f,			//200
-		-0.7071f, -0.7071f, 0.0f,		0.323225f, 0.25f,			//201
-		-0.6533f, -0.7071f, 0.2706f,	0.36741875f, 0.25f,			//202
-		-0.5f, -0.7071f, 0.5f,			0.4116125f, 0.25f,			//203
-		-0.2706f, -0.7071f, 0.6533f,	0.45580625f, 0.25f,			//204
-		// ring 13
-		0.0f, -0.8315f, 0.5556f,		0.5f, 0.1875f,				//205
-		0.2126f, -0.8315f, 0.5133f,		0.534725f, 0.1875f,			//206
-		0.3928f, -0.8315f, 0.3928f,		0.56945f, 0.1875f,			//207
-		0.5133f, -0.8315f, 0.2126f,		0.604175f, 0.1875f,			//208
-		0.5556f, -0.8315f, 0.0f,		0.6389f, 0.1875f,			//209
-		0.5133f, -0.8315f, -0.2126f,	0.673625f, 0.1875f,			//210
-		0.3928f, -0.8315f, -0.3928f,	0.70835f, 0.1875f,			//211
-		0.2126f, -0.8315f, -0.5133f,	0.743075f, 0.1875f,			//212
-		0.0f, -0.8315f, -0.5556f,		0.7778f, 0.1875f,			//213 - seam
-		0.0f, -0.8315f, -0.5556f,		0.2222f, 0.1875f,			//214 - seam
-		-0.2126f, -0.8315f, -0.5133f,	0.256925f, 0.1875f,			//215
-		-0.3928f, -0.8315f, -0.3928f,	0.29165f, 0.1875f,			//216
-		-0.5133f, -0.8315f, -0.2126f,	0.326375f, 0.1875f,			//217
-		-0.5556f, -0.8315f, 0.0f,		0.3611f, 0.1875f,			//218
-		-0.5133f, -0.8315f, 0.2126f,	0.395825f, 0.1875f,			//219
-		-0.3928f, -0.8315f, 0.3928f,	0.43055f, 0.1875f,			//220
-		-0.2126f, -0.8315f, 0.5133f,	0.465275f, 0.1875f,			//221
-		// ring 14
-		0.0f, -0.9239f, 0.3827f,		0.5f, 0.125f,				//222
-		0.1464f, -0.9239f, 0.3536f,		0.52391875f, 0.125f,		//223
-		0.2706f, -0.9239f, 0.2706f,		0.5478375f, 0.125f,			//224
-		0.3536f, -0.9239f, 0.1464f,		0.57175625f, 0.125f,		//225
-		0.3827f, -0.9239f, 0.0f,		0.5956755f, 0.125f,			//226
-		0.3536f, -0.9239f, -0.1464f,	0.61959425f, 0.125f,		//227
-		0.2706f, -0.9239f, -0.2706f,	0.643513f, 0.125f,			//228
-		0.1464f, -0.9239f, -0.3536f,	0.66743175f, 0.125f,		//229
-		0.0f, -0.9239f, -0.3827f,		0.6913505f, 0.125f,			//230 - seam
-		0.0f, -0.9239f, -0.3827f,		0.3086495f, 0.125f,			//231 - seam
-		-0.1464f, -0.9239f, -0.3536f,	0.33256825f, 0.125f,		//232
-		-0.2706f, -0.9239f, -0.2706f,	0.356487f, 0.125f,			//233
-		-0.3536f, -0.9239f, -0.1464f,	0.38040575f, 0.125f,		//234
-		-0.3827f, -0.9239f, 0.0f,		0.4043245f, 0.125f,			//235
-		-0.3536f, -0.9239f, 0.1464f,	0.42824325f, 0.125f,		//236
-		-0.2706f, -0.9239f, 0.2706f,	0.452162f, 0.125f,			//237
-		-0.1464f, -0.9239f, 0.3536f,	0.47608075f, 0.125f,		//238
-		// ring 15
-		0.0f, -0.9808f, 0.1951f,		0.5f, 0.0625f,				//239
-		0.0747f, -0.9808f, 0.1802f,		0.51219375f, 0.0625f,		//240
-		0.1379f, -0.9808f, 0.1379f,		0.5243875f, 0.0625f,		//241
-		0.1802f, -0.9808f, 0.0747f,		0.53658125f, 0.0625f,		//242
-		0.1951f, -0.9808, 0.0f,			0.548775f, 0.0625f,			//243
-		0.1802f, -0.9808f, -0.0747f,	0.56096875f, 0.0625f,		//244
-		0.1379f, -0.9808f, -0.1379f,	0.5731625f, 0.0625f,		//245
-		0.0747f, -0.9808f, -0.1802f,	0.58535625f, 0.0625f,		//246
-		0.0f, -0.9808f, -0.1951f,		0.59755f, 0.0625f,			//247 - seam
-		0.0f, -0.9808f, -0.1951f,		0.40245f, 0.0625f,			//248 - seam
-		-0.0747f, -0.9808f, -0.1802f,	0.41464375f, 0.0625f,		//249
-		-0.1379f, -0.9808f, -0.1379f,	0.4268375f, 0.0625f,		//250
-		-0.1802f, -0.9808f, -0.0747f,	0.43903125f, 0.0625f,		//251
-		-0.1951f, -0.9808, 0.0f,		0.451225f, 0.0625f,			//252
-		-0.1802f, -0.9808f, 0.0747f,	0.46341875f, 0.0625f,		//253
-		-0.1379f, -0.9808f, 0.1379f,	0.4756125f, 0.0625f,		//254
-		-0.0747f, -0.9808f, 0.1802f,	0.48780625f, 0.0625f,		//255
-		// bottom center point
-		0.0f, -1.0f, 0.0f,				0.5f, 0.0f					//256
-	};
-
-	// index data
-	GLuint indices[] = {
-		//ring 1 - top
-		0,10,11,
-		0,11,12,
-		0,12,13,
-		0,13,14,
-		0,14,15,
-		0,15,16,
-		0,16,17,
-		0,17,1,
-		0,1,2,
-		0,2,3,
-		0,3,4,
-		0,4,5,
-		0,5,6,
-		0,6,7,
-		0,7,8,
-		0,8,9,
-		0,9,10,
-
-		// ring 1 to ring 2
-		10,27,28,
-		10,11,28,
-		11,28,29,
-		11,12,29,
-		12,29,30,
-		12,13,30,
-		13,30,31,
-		13,14,31,
-		14,31,32,
-		14,15,32,
-		15,32,33,
-		15,16,33,
-		16,33,34,
-		16,17,34,
-		17,34,18,
-		17,1,18,
-		1,18,19,
-		1,2,19,
-		2,19,20,
-		2,3,20,
-		3,20,21,
-		3,4,21,
-		4,21,22,
-		4,5,22,
-		5,22,23,
-		5,6,23,
-		6,23,24,
-		6,7,24,
-		7,24,25,
-		7,8,25,
-		8,25,26,
-		8,9,26,
-		9,26,27,
-		9,10,27,
-
-		// ring 2 to ring 3
-		27,44,45,
-		27,28,45,
-		28,45,46,
-		28,29,46,
-		29,46,47,
-		29,30,47,
-		30,47,48,
-		30,31,48,
-		31,48,49,
-		31,32,49,
-		32,49,50,
-		32,33,50,
-		33,50,51,
-		33,34,51,
-		34,51,35,
-		34,18,35,
-		18,35,36,
-		18,19,36,
-		19,36,37,
-		19,20,37,
-		20,37,38,
-		20,21,38,
-		21,38,39,
-		21,22,39,
-		22,39,40,
-		22,23,40,
-		23,40,41,
-		23,24,41,
-		24,41,42,
-		24,25,42,
-		25,42,43,
-		25,26,43,
-		26,43,44,
-		26,27,44,
-
-		// ring 3 to ring 4
-		44,61,62,
-		44,45,62,
-		45,62,63,
-		45,46,63,
-		46,63,64,
-		46,47,64,
-		47,64,65,
-		47,48,65,
-		48,65,66,
-		48,49,66,
-		49,66,67,
-		49,50,67,
-		50,67,68,
-		50,51,68,
-		51,68,52,
-		51,35,52,
-		35,52,53,
-		35,36,53,
-		36,53,54,
-		36,37,54,
-		37,54,55,
-		37,38,55,
-		38,55,56,
-		38,39,56,
-		39,56,57,
-		39,40,57,
-		40,57,58,
-		40,41,58,
-		41,58,59,
-		41,42,59,
-		42,59,60,
-		42,43,60,
-		43,60,61,
-		43,44,61,
-
-		// ring 4 to ring 5
-		61,78,79,
-		61,62,79,
-		62,79,80,
-		62,63,80,
-		63,80,81,
-		63,64,81,
-		64,81,82,
-		64,65,82,
-		65,82,83,
-		65,66,83,
-		66,83,84,
-		66,67,84,
-		67,84,85,
-		67,68,85,
-		68,85,69,
-		68,52,69,
-		52,69,70,
-		52,53,70,
-		53,70,71,
-		53,54,71,
-		54,71,72,
-		54,55,72,
-		55,72,73,
-		55,56,73,
-		56,73,74,
-		56,57,74,
-		57,74,75,
-		57,58,75,
-		58,75,76,
-		58,59,76,
-		59,76,77,
-		59,60,77,
-		60,77,78,
-		60,61,78,
-
-		// ring 5 to ring 6
-		78,95,96,
-		78,79,96,
-		79,96,97,
-		79,80,97,
-		80,97,98,
-		80,81,98,
-		81,98,99,
-		81,82,99,
-		82,99,100,
-		82,83,100,
-		83,100,101,
-		83,84,101,
-		84,101,102,
-		84,85,102,
-		85,102,86,
-		85,69,86,
-		69,86,87,
-		69,70,87,
-		70,87,88,
-		70,71,88,
-		71,88,89,
-		71,72,89,
-		72,89,90,
-		72,73,90,
-		73,90,91,
-		73,74,91,
-		74,91,92,
-		74,75,92,
-		75,92,93,
-		75,76,93,
-		76,93,94,
-		76,77,94,
-		77,94,95,
-		77,78,95,
-
-		// ring 6 to ring 7
-		95,112,113,
-		95,96,113,
-		96,113,114,
-		96,97,114,
-		97,114,115,
-		97,98,115,
-		98,115,116,
-		98,99,116,
-		99,116,117,
-		99,100,117,
-		100,117,118,
-		100,101,118,
-		101,118,119,
-		101,102,119,
-		102,119,103,
-		102,86,103,
-		86,103,104,
-		86,87,104,
-		87,104,105,
-		87,88,105,
-		88,105,106,
-		88,89,106,
-		89,106,107,
-		89,90,107,
-		90,107,108,
-		90,91,108,
-		91,108,109,
-		91,92,109,
-		92,109,110,
-		92,93,110,
-		93,110,111,
-		93,94,111,
-		94,111,112,
-		94,95,112,
-
-		// ring 7 to ring 8
-		112,129,130,
-		112,113,130,
-		113,130,131,
-		113,114,131,
-		114,131,132,
-		114,115,132,
-		115,132,133,
-		115,116,133,
-		116,133,134,
-		116,117,134,
-		117,134,135,
-		117,118,135,
-		118,135,136,
-		118,119,136,
-		119,136,120,
-		119,103,120,
-		103,120,121,
-		103,104,121,
-		104,121,122,
-		104,105,122,
-		105,122,123,
-		105,106,123,
-		106,123,124,
-		106,107,124,
-		107,124,125,
-		107,108,125,
-		108,125,126,
-		108,109,126,
-		109,126,127,
-		109,110,127,
-		110,127,128,
-		110,111,128,
-		111,128,129,
-		111,112,129,
-
-		// ring 8 to ring 9
-		129,146,147,
-		129,130,147,
-		130,147,148,
-		130,131,148,
-		131,148,149,
-		131,132,149,
-		132,149,150,
-		132,133,150,
-		133,150,151,
-		133,134,151,
-		134,151,152,
-		134,135,152,
-		135,152,153,
-		135,136,153,
-		136,153,137,
-		136,120,137,
-		120,137,138,
-		120,121,138,
-		121,138,139,
-		121,122,139,
-		122,139,140,
-		122,123,140,
-		123,140,141,
-		123,124,141,
-		124,141,142,
-		124,125,142,
-		125,142,143,
-		125,126,143,
-		126,143,144,
-		126,127,144,
-		127,144,145,
-		127,128,145,
-		128,145,146,
-		128,129,146,
-
-		// ring 9 to ring 10
-		146,163,164,
-		146,147,164,
-		147,164,165,
-		147,148,165,
-		148,165,166,
-		148,149,166,
-		149,166,167,
-		149,150,167,
-		150,167,168,
-		150,151,168,
-		151,168,169,
-		151,152,169,
-		152,169,170,
-		152,153,170,
-		153,170,154,
-		153,137,154,
-		137,154,155,
-		137,138,155,
-		138,155,156,
-		138,139,156,
-		139,156,157,
-		139,140,157,
-		140,157,158,
-		140,141,158,
-		141,158,159,
-		141,142,159,
-		142,159,160,
-		142,143,160,
-		143,160,161,
-		143,144,161,
-		144,161,162,
-		144,145,162,
-		145,162,163,
-		145,146,163,
-
-		// ring 10 to ring 11
-		163,180,181,
-		163,164,181,
-		164,181,182,
-		164,165,182,
-		165,182,183,
-		165,166,183,
-		166,183,184,
-		166,167,184,
-		167,184,185,
-		167,168,185,
-		168,185,186,
-		168,169,186,
-		169,186,187,
-		169,170,187,
-		170,187,171,
-		170,154,171,
-		154,171,172,
-		154,155,172,
-		155,172,173,
-		155,156,173,
-		156,173,174,
-		156,157,174,
-		157,174,175,
-		157,158,175,
-		158,175,176,
-		158,159,176,
-		159,176,177,
-		159,160,177,
-		160,177,178,
-		160,161,178,
-		161,178,179,
-		161,162,179,
-		162,179,180,
-		162,163,180,
-
-		// ring 11 to ring 12
-		180,197,198,
-		180,181,198,
-		181,198,199,
-		181,182,199,
-		182,199,200,
-		182,183,200,
-		183,200,201,
-		183,184,201,
-		184,201,202,
-		184,185,202,
-		185,202,203,
-		185,186,203,
-		186,203,204,
-		186,187,204,
-		187,204,188,
-		187,171,188,
-		171,188,189,
-		171,172,189,
-		172,189,190,
-		172,173,190,
-		173,190,191,
-		173,174,191,
-		174,191,192,
-		174,175,192,
-		175,192,193,
-		175,176,193,
-		176,193,194,
-		176,177,194,
-		177,194,195,
-		177,178,195,
-		178,195,196,
-		178,179,196,
-		179,196,197,
-		179,180,197,
-
-		// ring 12 to ring 13
-		197,214,215,
-		197,198,215,
-		198,215,216,
-		198,199,216,
-		199,216,217,
-		199,200,217,
-		200,217,218,
-		200,201,218,
-		201,218,219,
-		201,202,219,
-		202,219,220,
-		202,203,220,
-		203,220,221,
-		203,204,221,
-		204,221,205,
-		204,188,205,
-		188,205,206,
-		188,189,206,
-		189,206,207,
-		189,190,207,
-		190,207,208,
-		190,191,208,
-		191,208,209,
-		191,192,209,
-		192,209,210,
-		192,193,210,
-		193,210,211,
-		193,194,211,
-		194,211,212,
-		194,195,212,
-		195,212,213,
-		195,196,213,
-		196,213,214,
-		196,197,214,
-
-		// ring 13 to ring 14
-		214,231,232,
-		214,215,232,
-		215,232,233,
-		215,216,233,
-		216,233,234,
-		216,217,234,
-		217,234,235,
-		217,218,235,
-		218,235,236,
-		218,219,236,
-		219,236,237,
-		219,220,237,
-		220,237,238,
-		220,221,238,
-		221,238,222,
-		221,205,222,
-		205,222,223,
-		205,206,223,
-		206,223,224,
-		206,207,224,
-		207,224,225,
-		207,208,225,
-		208,225,226,
-		208,209,226,
-		209,226,227,
-		209,210,227,
-		210,227,228,
-		210,211,228,
-		211,228,229,
-		211,212,229,
-		212,229,230,
-		212,213,230,
-		213,230,231,
-		213,214,231,
-
-		// ring 14 to ring 15
-		231,248,249,
-		231,232,249,
-		232,249,250,
-		232,233,250,
-		233,250,251,
-		233,234,251,
-		234,251,252,
-		234,235,252,
-		235,252,253,
-		235,236,253,
-		236,253,254,
-		236,237,254,
-		237,254,255,
-		237,238,255,
-		238,255,239,
-		238,222,239,
-		222,239,240,
-		222,223,240,
-		223,240,241,
-		223,224,241,
-		224,241,242,
-		224,225,242,
-		225,242,243,
-		225,226,243,
-		226,243,244,
-		226,227,244,
-		227,244,245,
-		227,228,245,
-		228,245,246,
-		228,229,246,
-		229,246,247,
-		229,230,247,
-		230,247,248,
-		230,231,248,
-
-		// ring 15 - bottom
-		248,256,249,
-		249,256,250,
-		250,256,251,
-		251,256,252,
-		252,256,253,
-		253,256,254,
-		254,256,255,
-		255,256,239,
-		239,256,240,
-		240,256,241,
-		241,256,242,
-		242,256,243,
-		243,256,244,
-		244,256,245,
-		245,256,246,
-		246,256,247,
-		247,256,248
-	};
-
-	// total float values per each type
-	const GLuint floatsPerVertex = 3;
-	const GLuint floatsPerNormal = 3;
-	const GLuint floatsPerUV = 2;
-
-	// store vertex and index count
-	m_SphereMesh.nVertices = sizeof(verts) / (sizeof(verts[0]) * (floatsPerVertex));
-	m_SphereMesh.nIndices = sizeof(indices) / (sizeof(indices[0]));
-
-	glm::vec3 normal;
-	glm::vec3 vert;
-	glm::vec3 center(0.0f, 0.0f, 0.0f);
-	float u, v;
-	std::vector<GLfloat> combined_values;
-
-	// combine interleaved vertices, normals, and texture coords
-	for (int i = 0; i < sizeof(verts) / (sizeof(verts[0])); i += 5)
-	{
-		vert = glm::vec3(verts[i], verts[i + 1], verts[i + 2]);
-		normal = normalize(vert - center);
-		//u = atan2(normal.x, normal.z) / (2 * M_PI) + 0.5;
-		//v = normal.y * 0.5 + 0.5;
-		combined_values.push_back(vert.x);
-		combined_values.push_back(vert.y);
-		combined_values.push_back(vert.z);
-		combined_values.push_back(normal.x);
-		combined_values.push_back(normal.y);
-		combined_values.push_back(normal.z);
-		combined_values.push_back(verts[i + 3]);
-		combined_values.push_back(verts[i + 4]);
-	}
-
-	// Create VAO
-	glGenVertexArrays(1, &m_SphereMesh.vao); // we can also generate multiple VAOs or buffers at the same time
-	glBindVertexArray(m_SphereMesh.vao);
-
-	// Create VBOs
-	glGenBuffers(2, m_SphereMesh.vbos);
-	glBindBuffer(GL_ARRAY_BUFFER, m_SphereMesh.vbos[0]); // Activates the vertex buffer
-	glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * combined_values.size(), combined_values.data(), GL_STATIC_DRAW); // Sends vertex or coordinate data to the GPU
-
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_SphereMesh.vbos[1]); // Activates the index buffer
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
-
-	if (m_bMemoryLayoutDone == false)
-	{
-		SetShaderMemoryLayout();
-	}
-}
-
-///////////////////////////////////////////////////
-//	LoadTaperedCylinderMesh()
-//
-//	Create a tapered cylinder mesh by specifying the 
-//  vertices and store it in a VAO/VBO.  The normals 
-//  and texture coordinates are also set.
-//
-//  Correct triangle drawing commands:
-//
-//	glDrawArrays(GL_TRIANGLE_FAN, 0, 36);		//bottom
-//	glDrawArrays(GL_TRIANGLE_FAN, 36, 72);		//top
-//	glDrawArrays(GL_TRIANGLE_STRIP, 72, 146);	//sides
-///////////////////////////////////////////////////
-void ShapeMeshes::LoadTaperedCylinderMesh()
-{
-	GLfloat verts[] = {
-		// cylinder bottom		// normals			// texture coords
-		1.0f, 0.0f, 0.0f,		0.0f, -1.0f, 0.0f,	0.5f,1.0f,
-		.98f, 0.0f, -0.17f,		0.0f, -1.0f, 0.0f,	0.41f, 0.983f,
-		.94f, 0.0f, -0.34f,		0.0f, -1.0f, 0.0f,	0.33f, 0.96f,
-		.87f, 0.0f, -0.5f,		0.0f, -1.0f, 0.0f,	0.25f, 0.92f,
-		.77f, 0.0f, -0.64f,		0.0f, -1.0f, 0.0f,	0.17f, 0.87f,
-		.64f, 0.0f, -0.77f,		0.0f, -1.0f, 0.0f,	0.13f, 0.83f,
-		.5f, 0.0f, -0.87f,		0.0f, -1.0f, 0.0f,	0.08f, 0.77f,
-		.34f, 0.0f, -0.94f,		0.0f, -1.0f, 0.0f,	0.04f, 0.68f,
-		.17f, 0.0f, -0.98f,		0.0f, -1.0f, 0.0f,	0.017f, 0.6f,
-		0.0f, 0.0f, -1.0f,		0.0f, -1.0f, 0.0f,	0.0f,0.5f,
-		-.17f, 0.0f, -0.98f,	0.0f, -1.0f, 0.0f,	0.017f, 0.41f,
-		-.34f, 0.0f, -0.94f,	0.0f, -1.0f, 0.0f,	0.04f, 0.33f,
-		-.5f, 0.0f, -0.87f,		0.0f, -1.0f, 0.0f,	0.08f, 0.25f,
-		-.64f, 0.0f, -0.77f,	0.0f, -1.0f, 0.0f,	0.13f, 0.17f,
-		-.77f, 0.0f, -0.64f,	0.0f, -1.0f, 0.0f,	0.17f, 0.13f,
-		-.87f, 0.0f, -0.5f,		0.0f, -1.0f, 0.0f,	0.25f, 0.08f,
-		-.94f, 0.0f, -0.34f,	0.0f, -1.0f, 0.0f,	0.33f, 0.04f,
-		-.98f, 0.0f, -0.17f,	0.0f, -1.0f, 0.0f,	0.41f, 0.017f,
-		-1.0f, 0.0f, 0.0f,		0.0f, -1.0f, 0.0f,	0.5f, 0.0f,
-		-.98f, 0.0f, 0.17f,		0.0f, -1.0f, 0.0f,	0.6f, 0.017f,
-		-.94f, 0.0f, 0.34f,		0.0f, -1.0f, 0.0f,	0.68f, 0.04f,
-		-.87f, 0.0f, 0.5f,		0.0f, -1.0f, 0.0f,	0.77f, 0.08f,
-		-.77f, 0.0f, 0.64f,		0.0f, -1.0f, 0.0f,	0.83f, 0.13f,
-		-.64f, 0.0f, 0.77f,		0.0f, -1.0f, 0.0f,	0.87f, 0.17f,
-		-.5f, 0.0f, 0.87f,		0.0f, -1.0f, 0.0f,	0.92f, 0.25f,
-		-.34f, 0.0f, 0.94f,		0.0f, -1.0f, 0.0f,	0.96f, 0.33f,
-		-.17f, 0.0f, 0.98f,		0.0f, -1.0f, 0.0f,	0.983f, 0.41f,
-		0.0f, 0.0f, 1.0f,		0.0f, -1.0f, 0.0f,	1.0f, 0.5f,
-		.17f, 0.0f, 0.98f,		0.0f, -1.0f, 0.0f,	0.983f, 0.6f,
-		.34f, 0.0f, 0.94f,		0.0f, -1.0f, 0.0f,	0.96f, 0.68f,
-		.5f, 0.0f, 0.87f,		0.0f, -1.0f, 0.0f,	0.92f, 0.77f,
-		.64f, 0.0f, 0.77f,		0.0f, -1.0f, 0.0f,	0.87f, 0.83f,
-		.77f, 0.0f, 0.64f,		0.0f, -1.0f, 0.0f,	0.83f, 0.87f,
-		.87f, 0.0f, 0.5f,		0.0f, -1.0f, 0.0f,	0.77f, 0.92f,
-		.94f, 0.0f, 0.34f,		0.0f, -1.0f, 0.0f,	0.68f, 0.96f,
-		.98f, 0.0f, 0.17f,		0.0f, -1.0f, 0.0f,	0.6f, 0.983f,
-
-		// cylinder top			// normals			// texture coords
-		0.5f, 1.0f, 0.0f,		0.0f, 1.0f, 0.0f,	0.5f,1.0f,
-		.49f, 1.0f, -0.085f,	0.0f, 1.0f, 0.0f,	0.41f, 0.983f,
-		.47f, 1.0f, -0.17f,		0.0f, 1.0f, 0.0f,	0.33f, 0.96f,
-		.435f, 1.0f, -0.25f,	0.0f, 1.0f, 0.0f,	0.25f, 0.92f,
-		.385f, 1.0f, -0.32f,	0.0f, 1.0f, 0.0f,	0.17f, 0.87f,
-		.32f, 1.0f, -0.385f,	0.0f, 1.0f, 0.0f,	0.13f, 0.83f,
-		.25f, 1.0f, -0.435f,	0.0f, 1.0f, 0.0f,	0.08f, 0.77f,
-		.17f, 1.0f, -0.47f,		0.0f, 1.0f, 0.0f,	0.04f, 0.68f,
-		.085f, 1.0f, -0.49f,	0.0f, 1.0f, 0.0f,	0.017f, 0.6f,
-		0.0f, 1.0f, -0.5f,		0.0f, 1.0f, 0.0f,	0.0f,0.5f,
-		-.085f, 1.0f, -0.49f,	0.0f, 1.0f, 0.0f,	0.017f, 0.41f,
-		-.17f, 1.0f, -0.47f,	0.0f, 1.0f, 0.0f,	0.04f, 0.33f,
-		-.25f, 1.0f, -0.435f,	0.0f, 1.0f, 0.0f,	0.08f, 0.25f,
-		-.32f, 1.0f, -0.385f,	0.0f, 1.0f, 0.0f,	0.13f, 0.17f,
-		-.385f, 1.0f, -0.32f,	0.0f, 1.0f, 0.0f,	0.17f, 0.13f,
-		-.435f, 1.0f, -0.25f,	0.0f, 1.0f, 0.0f,	0.25f, 0.08f,
-		-.47f, 1.0f, -0.17f,	0.0f, 1.0f, 0.0f,	0.33f, 0.04f,
-		-.49f, 1.0f, -0.085f,	0.0f, 1.0f, 0.0f,	0.41f, 0.017f,
-		-0.5f, 1.0f, 0.0f,		0.0f, 1.0f, 0.0f,	0.5f, 0.0f,
-		-.49f, 1.0f, 0.085f,	0.0f, 1.0f, 0.0f,	0.6f, 0.017f,
-		-.47f, 1.0f, 0.17f,		0.0f, 1.0f, 0.0f,	0.68f, 0.04f,
-		-.435f, 1.0f, 0.25f,	0.0f, 1.0f, 0.0f,	0.77f, 0.08f,
-		-.385f, 1.0f, 0.32f,	0.0f, 1.0f, 0.0f,	0.83f, 0.13f,
-		-.32f, 1.0f, 0.385f,	0.0f, 1.0f, 0.0f,	0.87f, 0.17f,
-		-.25f, 1.0f, 0.435f,	0.0f, 1.0f, 0.0f,	0.92f, 0.25f,
-		-.17f, 1.0f, 0.47f,		0.0f, 1.0f, 0.0f,	0.96f, 0.33f,
-		-.085f, 1.0f, 0.49f,	0.0f, 1.0f, 0.0f,	0.983f, 0.41f,
-		0.0f, 1.0f, 0.5f,		0.0f, 1.0f, 0.0f,	1.0f, 0.5f,
-		.085f, 1.0f, 0.49f,		0.0f, 1.0f, 0.0f,	0.983f, 0.6f,
-		.17f, 1.0f, 0.47f,		0.0f, 1.0f, 0.0f,	0.96f, 0.68f,
-		.25f, 1.0f, 0.435f,		0.0f, 1.0f, 0.0f,	0.92f, 0.77f,
-		.32f, 1.0f, 0.385f,		0.0f, 1.0f, 0.0f,	0.87f, 0.83f,
-		.385f, 1.0f, 0.32f,		0.0f, 1.0f, 0.0f,	0.83f, 0.87f,
-		.435f, 1.0f, 0.25f,		0.0f, 1.0f, 0.0f,	0.77f, 0.92f,
-		.47f, 1.0f, 0.17f,		0.0f, 1.0f, 0.0f,	0.68f, 0.96f,
-		.49f, 1.0f, 0.085f,		0.0f, 1.0f, 0.0f,	0.6f, 0.983f,
-
-		// cylinder body		// normals							// texture coords
-		0.5f, 1.0f, 0.0f,		0.993150651, 0.5f, -0.116841137f,	0.25,1.0,
-		1.0f, 0.0f, 0.0f,		0.993150651, 0.5f, -0.116841137f,	0.0,0.0,
-		.98f, 0.0f, -0.17f,		0.993150651, 0.5f, -0.116841137f,	0.0277,0.0,
-		0.5f, 1.0f, 0.0f,		0.993150651, 0.5f, -0.116841137f, 	0.25,1.0,
-		.49f, 1.0f, -0.085f,	0.993150651, 0.5f, -0.116841137f, 	0.2635,1.0,
-		.98f, 0.0f, -0.17f,		0.993150651, 0.5f, -0.116841137f,	0.0277,0.0,
-		.94f, 0.0f, -0.34f,		0.993417103f, 0.5f, -0.229039446f,	0.0554,0.0,
-		.49f, 1.0f, -0.085f,	0.993417103f, 0.5f, -0.229039446f,	0.2635,1.0,
-		.47f, 1.0f, -0.17f,		0.993417103f, 0.5f, -0.229039446f,	0.277,1.0,
-		.94f, 0.0f, -0.34f,		0.993417103f, 0.5f, -0.229039446f,	0.0554,0.0,
-		.87f, 0.0f, -0.5f,		0.993417103f, 0.5f, -0.229039446f,	0.0831,0.0,
-		.47f, 1.0f, -0.17f,		0.993417103f, 0.5f, -0.229039446f,	0.277,1.0,
-		.435f, 1.0f, -0.25f,	0.813733339f, 0.5f, -0.581238329f,	0.2905,1.0,
-		.87f, 0.0f, -0.5f,		0.813733339f, 0.5f, -0.581238329f,	0.0831,0.0,
-		.77f, 0.0f, -0.64f,		0.813733339f, 0.5f, -0.581238329f,	0.1108,0.0,
-		.435f, 1.0f, -0.25f,	0.813733339f, 0.5f, -0.581238329f,	0.2905,1.0,
-		.385f, 1.0f, -0.32f,	0.813733339f, 0.5f, -0.581238329f,	0.304,1.0,
-		.77f, 0.0f, -0.64f,		0.813733339f, 0.5f, -0.581238329f,	0.1108,0.0,
-		.64f, 0.0f, -0.77f,		0.707106769f, 0.5f, -0.707106769f,	0.1385,0.0,
-		.385f, 1.0f, -0.32f,	0.707106769f, 0.5f, -0.707106769f,	0.304,1.0,
-		.32f, 1.0f, -0.385f,	0.707106769f, 0.5f, -0.707106769f,	0.3175,1.0,
-		.64f, 0.0f, -0.77f,		0.707106769f, 0.5f, -0.707106769f,	0.1385,0.0,
-		.5f, 0.0f, -0.87f,		0.707106769f, 0.5f, -0.707106769f,	0.1662,0.0,
-		.32f, 1.0f, -0.385f,	0.707106769f, 0.5f, -0.707106769f,	0.3175, 1.0,
-		.25f, 1.0f, -0.435f,	0.400818795f, 0.5f, -0.916157305f,	0.331, 1.0,
-		.5f, 0.0f, -0.87f,		0.400818795f, 0.5f, -0.916157305f,	0.1662, 0.0,
-		.34f, 0.0f, -0.94f,		0.400818795f, 0.5f, -0.916157305f,	0.1939, 0.0,
-		.25f, 1.0f, -0.435f,	0.400818795f, 0.5f, -0.916157305f,	0.331, 1.0,
-		.17f, 1.0f, -0.47f,		0.400818795f, 0.5f, -0.916157305f,	0.3445, 1.0,
-		.34f, 0.0f, -0.94f,		0.400818795f, 0.5f, -0.916157305f,	0.1939, 0.0,
-		.17f, 0.0f, -0.98f,		0.229039446f, 0.5f, -0.973417103f,	0.2216, 0.0,
-		.17f, 1.0f, -0.47f,		0.229039446f, 0.5f, -0.973417103f,	0.3445, 1.0,
-		.085f, 1.0f, -0.49f,	0.229039446f, 0.5f, -0.973417103f,	0.358, 1.0,
-		.17f, 0.0f, -0.98f,		0.229039446f, 0.5f, -0.973417103f,	0.2216, 0.0,
-		0.0f, 0.0f, -1.0f,		0.229039446f, 0.5f, -0.973417103f,	0.2493, 0.0,
-		.085f, 1.0f, -0.49f,	0.229039446f, 0.5f, -0.973417103f,	0.358, 1.0,
-		0.0f, 1.0f, -0.5f,		-0.116841137f, 0.5f, -0.993150651f,	0.3715, 1.0,
-		0.0f, 0.0f, -1.0f,		-0.116841137f, 0.5f, -0.993150651f,	0.2493, 0.0,
-		-.17f, 0.0f, -0.98f,	-0.116841137f, 0.5f, -0.993150651f,	0.277, 0.0,
-		0.0f, 1.0f, -0.5f,		-0.116841137f, 0.5f, -0.993150651f,	0.3715, 1.0,
-		-.085f, 1.0f, -0.49f,	-0.116841137f, 0.5f, -0.993150651f,	0.385, 1.0,
-		-.17f, 0.0f, -0.98f,	-0.116841137f, 0.5f, -0.993150651f,	0.277, 0.0,
-		-.34f, 0.0f, -0.94f,	-0.229039446f, 0.5f, -0.973417103f,	0.3047, 0.0,
-		-.085f, 1.0f, -0.49f,	-0.229039446f, 0.5f, -0.973417103f,	0.385, 1.0,
-		-.17f, 1.0f, -0.47f,	-0.229039446f, 0.5f, -0.973417103f,	0.3985, 1.0,
-		-.34f, 0.0f, -0.94f,	-0.229039446f, 0.5f, -0.973417103f,	0.3047, 0.0,
-		-.5f, 0.0f, -0.87f,		-0.229039446f, 0.5f, -0.973417103f,	0.3324, 0.0,
-		-.17f, 1.0f, -0.47f,	-0.229039446f, 0.5f, -0.973417103f,	0.3985, 1.0,
-		-.25f, 1.0f, -0.435f,	-0.581238329f, 0.5f, -0.581238329f,	0.412, 1.0,
-		-.5f, 0.0f, -0.87f,		-0.581238329f, 0.5f, -0.581238329f,	0.3324, 0.0,
-		-.64f, 0.0f, -0.77f,	-0.581238329f, 0.5f, -0.581238329f,	0.3601, 0.0,
-		-.25f, 1.0f, -0.435f,	-0.581238329f, 0.5f, -0.581238329f,	0.412, 1.0,
-		-.32f, 1.0f, -0.385f,	-0.581238329f, 0.5f, -0.581238329f,	0.4255, 1.0,
-		-.64f, 0.0f, -0.77f,	-0.581238329f, 0.5f, -0.581238329f,	0.3601, 0.0,
-		-.77f, 0.0f, -0.64f,	-0.707106769f, 0.5f, -0.707106769f,	0.3878, 0.0,
-		-.32f, 1.0f, -0.385f,	-0.707106769f, 0.5f, -0.707106769f,	0.4255, 1.0,
-		-.385f, 1.0f, -0.32f,	-0.707106769f, 0.5f, -0.707106769f,	0.439, 1.0,
-		-.77f, 0.0f, -0.64f,	-0.707106769f, 0.5f, -0.707106769f,	0.3878, 0.0,
-		-.87f, 0.0f, -0.5f,		-0.707106769f, 0.5f, -0.707106769f,	0.4155, 0.0,
-		-.385f, 1.0f, -0.32f,	-0.707106769f, 0.5f, -0.707106769f,	0.439, 1.0,
-		-.435f, 1.0f, -0.25f,	-0.916157305f, 0.5f, -0.400818795f,	0.4525, 1.0,
-		-.87f, 0.0f, -0.5f,		-0.916157305f, 0.5f, -0.400818795f,	0.4155, 0.0,
-		-.94f, 0.0f, -0.34f,	-0.916157305f, 0.5f, -0.400818795f,	0.4432, 0.0,
-		-.435f, 1.0f, -0.25f,	-0.916157305f, 0.5f, -0.400818795f,	0.4525, 1.0,
-		-.47f, 1.0f, -0.17f,	-0.916157305f, 0.5f, -0.400818795f,	0.466, 1.0,
-		-.94f, 0.0f, -0.34f,	-0.916157305f, 0.5f, -0.400818795f,	0.4432, 0.0,
-		-.98f, 0.0f, -0.17f,	-0.973417103f, 0.5f, -0.229039446f,	0.4709, 0.0,
-		-.47f, 1.0f, -0.17f,	-0.973417103f, 0.5f, -0.229039446f,	0.466, 1.0,
-		-.49f, 1.0f, -0.085f,	-0.973417103f, 0.5f, -0.229039446f,	0.4795, 1.0,
-		-.98f, 0.0f, -0.17f,	-0.973417103f, 0.5f, -0.229039446f,	0.4709, 0.0,
-		-1.0f, 0.0f, 0.0f,		-0.973417103f, 0.5f, -0.229039446f,	0.4986, 0.0,
-		-.49f, 1.0f, -0.085f,	-0.973417103f, 0.5f, -0.229039446f,	0.4795, 1.0,
-		-0.5f, 1.0f, 0.0f,		-0.993150651f, 0.5f, -0.116841137f,	0.493, 1.0,
-		-1.0f, 0.0f, 0.0f,		-0.993150651f, 0.5f, -0.116841137f,	0.4986, 0.0,
-		-.98f, 0.0f, 0.17f,		-0.993150651f, 0.5f, 0.116841137f,	0.5263, 0.0,
-		-0.5f, 1.0f, 0.0f,		-0.993150651f, 0.5f, 0.116841137f,	0.493, 1.0,
-		-.49f, 1.0f, 0.085f,	-0.993150651f, 0.5f, 0.116841137f,	0.5065, 1.0,
-		-.98f, 0.0f, 0.17f,		-0.993150651f, 0.5f, 0.116841137f,	0.5263, 0.0,
-		-.94f, 0.0f, 0.34f,		-0.973417103f, 0.5f, 0.229039446f,	0.554, 0.0,
-		-.49f, 1.0f, 0.085f,	-0.973417103f, 0.5f, 0.229039446f,	0.5065, 1.0,
-		-.47f, 1.0f, 0.17f,		-0.973417103f, 0.5f, 0.229039446f,	0.52, 1.0,
-		-.94f, 0.0f, 0.34f,		-0.973417103f, 0.5f, 0.229039446f,	0.554, 0.0,
-		-.87f, 0.0f, 0.5f,		-0.973417103f, 0.5f, 0.229039446f,	0.5817, 0.0,
-		-.47f, 1.0f, 0.17f,		-0.973417103f, 0.5f, 0.229039446f,	0.52, 1.0,
-		-.435f, 1.0f, 0.25f,	-0.813733339f, 0.5f, 0.581238329f,	0.5335, 1.0,
-		-.87f, 0.0f, 0.5f,		-0.813733339f, 0.5f, 0.581238329f,	0.5817, 0.0,
-		-.77f, 0.0f, 0.64f,		-0.813733339f, 0.5f, 0.581238329f,	0.6094, 0.0,
-		-.435f, 1.0f, 0.25f,	-0.813733339f, 0.5f, 0.581238329f,	0.5335, 1.0,
-		-.385f, 1.0f, 0.32f,	-0.813733339f, 0.5f, 0.581238329f,	0.547, 1.0,
-		-.77f, 0.0f, 0.64f,		-0.813733339f, 0.5f, 0.581238329f,	0.6094, 0.0,
-		-.64f, 0.0f, 0.77f,		-0.707106769f, 0.5f, 0.707106769f,	0.6371, 0.0,
-		-.385f, 1.0f, 0.32f,	-0.707106769f, 0.5f, 0.707106769f,	0.547, 1.0,
-		-.32f, 1.0f, 0.385f,	-0.707106769f, 0.5f, 0.707106769f,	0.5605, 1.0,
-		-.64f, 0.0f, 0.77f,		-0.707106769f, 0.5f, 0.707106769f,	0.6371, 0.0,
-		-.5f, 0.0f, 0.87f,		-0.707106769f, 0.5f, 0.707106769f,	0.6648, 0.0,
-		-.32f, 1.0f, 0.385f,	-0.707106769f, 0.5f, 0.707106769f,	0.5605, 1.0,
-		-.25f, 1.0f, 0.435f,	-0.400818795f, 0.5f, 0.916157305f,	0.574, 1.0,
-		-.5f, 0.0f, 0.87f,		-0.400818795f, 0.5f, 0.916157305f,	0.6648, 0.0,
-		-.34f, 0.0f, 0.94f,		-0.400818795f, 0.5f, 0.916157305f,	0.6925, 0.0,
-		-.25f, 1.0f, 0.435f,	-0.400818795f, 0.5f, 0.916157305f,	0.574, 1.0,
-		-.17f, 1.0f, 0.47f,		-0.400818795f, 0.5f, 0.916157305f,	0.5875, 1.0,
-		-.34f, 0.0f, 0.94f,		-0.400818795f, 0.5f, 0.916157305f,	0.6925, 0.0,
-		-.17f, 0.0f, 0.98f,		-0.229039446f, 0.5f, 0.973417103f,	0.7202, 0.0,
-		-.17f, 1.0f, 0.47f,		-0.229039446f, 0.5f, 0.973417103f,	0.5875, 1.0,
-		-.085f, 1.0f, 0.49f,	-0.229039446f, 0.5f, 0.973417103f,	0.601, 1.0,
-		-.17f, 0.0f, 0.98f,		-0.229039446f, 0.5f, 0.973417103f,	0.7202, 0.0,
-		0.0f, 0.0f, 1.0f,		-0.229039446f, 0.5f, 0.973417103f,	0.7479, 0.0,
-		-.085f, 1.0f, 0.49f,	-0.229039446f, 0.5f, 0.973417103f,	0.601, 1.0,
-		0.0f, 1.0f, 0.5f,		-0.116841137f, 0.5f, 0.993150651f,	0.6145, 1.0,
-		0.0f, 0.0f, 1.0f,		-0.116841137f, 0.5f, 0.993150651f,	0.7479, 0.0,
-		.17f, 0.0f, 0.98f,		0.116841137f, 0.5f, 0.993150651f,	0.7756, 0.0,
-		0.0f, 1.0f, 0.5f,		0.116841137f, 0.5f, 0.993150651f,	0.6145, 1.0,
-		.085f, 1.0f, 0.49f,		0.116841137f, 0.5f, 0.993150651f,	0.628, 1.0,
-		.17f, 0.0f, 0.98f,		0.116841137f, 0.5f, 0.993150651f,	0.7756, 0.0,
-		.34f, 0.0f, 0.94f,		0.229039446f, 0.5f, 0.973417103f,	0.8033, 0.0,
-		.085f, 1.0f, 0.49f,		0.229039446f, 0.5f, 0.973417103f,	0.628, 1.0,
-		.17f, 1.0f, 0.47f,		0.229039446f, 0.5f, 0.973417103f,	0.6415, 1.0,
-		.34f, 0.0f, 0.94f,		0.229039446f, 0.5f, 0.973417103f,	0.8033, 0.0,
-		.5f, 0.0f, 0.87f,		0.229039446f, 0.5f, 0.973417103f,	0.831, 0.0,
-		.17f, 1.0f, 0.47f,		0.229039446f, 0.5f, 0.973417103f,	0.6415, 1.0,
-		.25f, 1.0f, 0.435f,		0.581238329f, 0.5f, 0.813733339f,	0.655, 1.0,
-		.5f, 0.0f, 0.87f,		0.581238329f, 0.5f, 0.813733339f,	0.831, 0.0,
-		.64f, 0.0f, 0.77f,		0.581238329f, 0.5f, 0.813733339f,	0.8587, 0.0,
-		.25f, 1.0f, 0.435f,		0.581238329f, 0.5f, 0.813733339f,	0.655, 1.0,
-		.32f, 1.0f, 0.385f,		0.581238329f, 0.5f, 0.813733339f,	0.6685, 1.0,
-		.64f, 0.0f, 0.77f,		0.581238329f, 0.5f, 0.813733339f,	0.8587, 0.0,
-		.77f, 0.0f, 0.64f,		0.707106769f, 0.5f, 0.707106769f,	0.8864, 0.0,
-		.32f, 1.0f, 0.385f,		0.707106769f, 0.5f, 0.707106769f,	0.6685, 1.0,
-		.385f, 1.0f, 0.32f,		0.707106769f, 0.5f, 0.707106769f,	0.682, 1.0,
-		.77f, 0.0f, 0.64f,		0.707106769f, 0.5f, 0.707106769f,	0.8864, 0.0,
-		.87f, 0.0f, 0.5f,		0.707106769f, 0.5f, 0.707106769f,	0.9141, 0.0,
-		.385f, 1.0f, 0.32f,		0.707106769f, 0.5f, 0.707106769f,	0.682, 1.0,
-		.435f, 1.0f, 0.25f,		0.916157305f, 0.5f, 0.400818795f,	0.6955, 1.0,
-		.87f, 0.0f, 0.5f,		0.916157305f, 0.5f, 0.400818795f,	0.9141, 0.0,
-		.94f, 0.0f, 0.34f,		0.916157305f, 0.5f, 0.400818795f,	0.9418, 0.0,
-		.435f, 1.0f, 0.25f,		0.916157305f, 0.5f, 0.400818795f,	0.6955, 1.0,
-		.47f, 1.0f, 0.17f,		0.916157305f, 0.5f, 0.400818795f,	0.709, 1.0,
-		.94f, 0.0f, 0.34f,		0.916157305f, 0.5f, 0.400818795f,	0.9418, 1.0,
-		.98f, 0.0f, 0.17f,		0.973417103f, 0.5f, 0.229039446f,	0.9695, 0.0,
-		.47f, 1.0f, 0.17f,		0.973417103f, 0.5f, 0.229039446f,	0.709, 0.0,
-		.49f, 1.0f, 0.085f,		0.973417103f, 0.5f, 0.229039446f,	0.7225, 1.0,
-		.98f, 0.0f, 0.17f,		0.973417103f, 0.5f, 0.229039446f,	0.9695, 0.0,
-		1.0f, 0.0f, 0.0f,		0.973417103f, 0.5f, 0.229039446f,	1.0, 0.0,
-		.49f, 1.0f, 0.085f,		0.973417103f, 0.5f, 0.229039446f,	0.7225, 1.0,
-		0.5f, 1.0f, 0.0f,		0.993150651f, 0.5f, 0.116841137f,	0.75, 1.0,
-		1.0f, 0.0f, 0.0f,		0.993150651f, 0.5f, 0.116841137f,	1.0, 0.0
-	};
-
-	// store vertex and index count
-	m_TaperedCylinderMesh.nVertices = sizeof(verts) / (sizeof(verts[0]) * (g_FloatsPerVertex + g_FloatsPerNormal + g_FloatsPerUV));
-	m_TaperedCylinderMesh.nIndices = 0;
-
-	// Create VAO
-	glGenVertexArrays(1, &m_TaperedCylinderMesh.vao); // we can also generate multiple VAOs or buffers at the same time
-	glBindVertexArray(m_TaperedCylinderMesh.vao);
+void ShapeMeshes::BuildSphereMesh(int bands, int slices)
+{
+	bands = glm::max(bands + (bands % 2), 2);
+	slices = glm::max(slices + (slices % 2), 4);
+	GenerateSphereMesh(m_SphereMesh, "sphere", bands, slices);
 
-	// Create VBO
-	glGenBuffers(1, m_TaperedCylinderMesh.vbos);
-	glBindBuffer(GL_ARRAY_BUFFER, m_TaperedCylinderMesh.vbos[0]); // Activates the buffer
-	glBufferData(GL_ARRAY_BUFFER, sizeof(verts), verts, GL_STATIC_DRAW); // Sends vertex or coordinate data to the GPU
+	// fewer bands and slices for the distant LOD levels
+	GenerateSphereMesh(m_SphereLODs[0], "sphere LOD 1", 10, 12);
+	GenerateSphereMesh(m_SphereLODs[1], "sphere LOD 2", 6, 8);
+}
 
-	if (m_bMemoryLayoutDone == false)
+///////////////////////////////////////////////////
+//	GenerateSphereMesh()
+//
+//	Build a unit sphere of the given number of bands
+//  from pole to pole and slices around: its texture
+//  seam runs down the -z side and u narrows toward
+//  the poles. Both counts must be even. The
+//  triangles go from the top pole down, so the
+//  first half of the indices is the upper
+//  hemisphere:
+//
+//	glDrawElements(GL_TRIANGLES, nIndices, GL_UNSIGNED_INT, 0);
+///////////////////////////////////////////////////
+void ShapeMeshes::GenerateSphereMesh(
+	GLMesh& mesh,
+	const char* name,
+	int bands,
+	int slices)
+{
+	bool bProcedural = IsProceduralLayout();
+	MESH_CURSOR cursor = AllocateArenaMesh(mesh, (GLuint)ShapeTables::SphereVertexCount(bands, slices),
+		(GLuint)ShapeTables::SphereIndexCount(bands, slices));
+
+	// the tessellations of a table are copied, the others written
+	// by the same code at run time; proceduralMeshCompute.glsl
+	// writes the same vertices
+	const GLfloat* pTableVertices = NULL;
+	const GLuint* pTableIndices = NULL;
+	FindSphereTable(bands, slices, pTableVertices, pTableIndices);
+	if (bProcedural == true)
 	{
-		SetShaderMemoryLayout();
+		AddProceduralMesh(mesh, SHAPE_SPHERE, bands, slices, 0.0f);
 	}
+	else if (NULL != pTableVertices)
+	{
+		std::copy(pTableVertices, pTableVertices + (size_t)mesh.nVertices * VERTEX_FLOATS, cursor.pVertex);
+	}
+	else
+	{
+		// the bands go halfway around a circle of twice as many steps
+		const glm::vec2* pBandCircle = GetUnitCircle(2 * bands);
+		const glm::vec2* pSliceCircle = GetUnitCircle(slices);
+		ShapeTables::WriteSphereVertices(bands, slices, &pBandCircle[0].x, &pSliceCircle[0].x, cursor.pVertex);
+	}
+	if (NULL != pTableIndices)
+	{
+		std::copy(pTableIndices, pTableIndices + mesh.nIndices, cursor.pIndex);
+	}
+	else
+	{
+		ShapeTables::WriteSphereIndices(bands, slices, cursor.pIndex);
+	}
+
+	// the half sphere draws the first half of the indices
+	const GLsizei segmentEnds[] = { (GLsizei)mesh.nIndices / 2 };
+	FinishArenaMesh(mesh, name, segmentEnds, 1);
+}
+
+///////////////////////////////////////////////////
+//	BuildTaperedCylinderMesh()
+//
+//	Create a tapered cylinder mesh of the given
+//  number of slices around its axis, radius 1 at
+//  y = 0 narrowing to 0.5 at y = 1, and append it
+//  to the arena.
+//
+//  Correct triangle drawing commands, in indices:
+//
+//	glDrawElements(GL_TRIANGLES, 3 * (slices - 2), 0);					//bottom
+//	glDrawElements(GL_TRIANGLES, 3 * (slices - 2), 3 * (slices - 2));	//top
+//	glDrawElements(GL_TRIANGLES, 6 * slices, 6 * (slices - 2));		//sides
+//	glDrawElements(GL_TRIANGLES, 3 * (slices - 2), 6 * (slices - 2) + 6 * slices);	//bottom again
+///////////////////////////////////////////////////
+void ShapeMeshes::BuildTaperedCylinderMesh(int slices)
+{
+	GenerateRadialMesh(m_TaperedCylinderMesh, "tapered cylinder", glm::max(slices, 3), 0.5f, true);
 }
 
 ///////////////////////////////////////////////////
-//	LoadTorusMesh()
+//	BuildTorusMesh()
 //
-//	Create a torus mesh by specifying the vertices and 
-//  store it in a VAO/VBO.  The normals and texture
-//  coordinates are also set.
+//	Create a torus mesh around the z axis, its ring
+//  of radius 1 and its tube of radius thickness, and
+//  append it to the arena with coarser tessellations
+//  for its LOD levels.
 //
 //	Correct triangle drawing command:
 //
-//	glDrawArrays(GL_TRIANGLES, 0, meshes.gTorusMesh.nVertices);
+//	glDrawElements(GL_TRIANGLES, meshes.gTorusMesh.nIndices, GL_UNSIGNED_INT, (void*)0);
 ///////////////////////////////////////////////////
-void ShapeMeshes::LoadTorusMesh(float thickness)
+void ShapeMeshes::BuildTorusMesh(float thickness)
 {
-	int _mainSegments = 30;
-	int _tubeSegments = 30;
-	float _mainRadius = 1.0f;
-	float _tubeRadius = .1f;
+	GenerateTorusMesh(m_TorusMesh, "torus", 30, 30, thickness);
 
-	if (thickness <= 1.0)
+	// coarser tessellations for the distant LOD levels; the main
+	// segment counts stay even so the half torus ends on a segment
+	GenerateTorusMesh(m_TorusLODs[0], "torus LOD 1", 18, 12, thickness);
+	GenerateTorusMesh(m_TorusLODs[1], "torus LOD 2", 12, 8, thickness);
+}
+
+///////////////////////////////////////////////////
+//	GenerateTorusMesh()
+//
+//	Build one tessellation of the torus with the
+//  given main and tube segment counts as a grid of
+//  shared vertices, closing on copies of the first
+//  row and column for the texture seams, and append
+//  it to the arena. The triangles go around the ring
+//  segment by segment, so the first half of the
+//  indices is the half torus above y = 0.
+///////////////////////////////////////////////////
+void ShapeMeshes::GenerateTorusMesh(
+	GLMesh& mesh,
+	const char* name,
+	int mainSegments,
+	int tubeSegments,
+	float thickness)
+{
+	const float tubeRadius = (thickness <= 1.0f) ? thickness : 0.1f;
+
+	bool bProcedural = IsProceduralLayout();
+	MESH_CURSOR cursor = AllocateArenaMesh(mesh, (GLuint)ShapeTables::TorusVertexCount(mainSegments, tubeSegments),
+		(GLuint)ShapeTables::TorusIndexCount(mainSegments, tubeSegments));
+
+	// a table holds the ring of a tube of radius 0, which every
+	// thickness moves out along the normals; the rings share one
+	// unit circle when their counts match
+	const GLfloat* pTableVertices = NULL;
+	const GLuint* pTableIndices = NULL;
+	FindTorusTable(mainSegments, tubeSegments, pTableVertices, pTableIndices);
+	if (bProcedural == true)
 	{
-		_tubeRadius = thickness;
+		AddProceduralMesh(mesh, SHAPE_TORUS, mainSegments, tubeSegments, tubeRadius);
 	}
-
-	auto mainSegmentAngleStep = glm::radians(360.0f / float(_mainSegments));
-	auto tubeSegmentAngleStep = glm::radians(360.0f / float(_tubeSegments));
-
-	std::vector<glm::vec3> vertex_list;
-	std::vector<std::vector<glm::vec3>> segments_list;
-	std::vector<glm::vec2> texture_coords;
-	glm::vec3 center(0.0f, 0.0f, 0.0f);
-	glm::vec3 normal;
-	glm::vec3 vertex;
-	glm::vec2 text_coord;
-
-	// generate the torus vertices
-	auto currentMainSegmentAngle = 0.0f;
-	for (auto i = 0; i < _mainSegments; i++)
+	else if (NULL != pTableVertices)
 	{
-		// Calculate sine and cosine of main segment angle
-		auto sinMainSegment = sin(currentMainSegmentAngle);
-		auto cosMainSegment = cos(currentMainSegmentAngle);
-		auto currentTubeSegmentAngle = 0.0f;
-		std::vector<glm::vec3> segment_points;
-		for (auto j = 0; j < _tubeSegments; j++)
+		std::copy(pTableVertices, pTableVertices + (size_t)mesh.nVertices * VERTEX_FLOATS, cursor.pVertex);
+		for (GLuint i = 0; i < mesh.nVertices; i++)
 		{
-			// Calculate sine and cosine of tube segment angle
-			auto sinTubeSegment = sin(currentTubeSegmentAngle);
-			auto cosTubeSegment = cos(currentTubeSegmentAngle);
+			GLfloat* pVertex = cursor.pVertex + (size_t)i * VERTEX_FLOATS;
+			pVertex[0] += pVertex[3] * tubeRadius;
+			pVertex[1] += pVertex[4] * tubeRadius;
+			pVertex[2] += pVertex[5] * tubeRadius;
+		}
+	}
+	else
+	{
+		const glm::vec2* pMainCircle = GetUnitCircle(mainSegments);
+		const glm::vec2* pTubeCircle = GetUnitCircle(tubeSegments);
+		ShapeTables::WriteTorusVertices(mainSegments, tubeSegments, tubeRadius,
+			&pMainCircle[0].x, &pTubeCircle[0].x, cursor.pVertex);
+	}
+	if (NULL != pTableIndices)
+	{
+		std::copy(pTableIndices, pTableIndices + mesh.nIndices, cursor.pIndex);
+	}
+	else
+	{
+		ShapeTables::WriteTorusIndices(mainSegments, tubeSegments, cursor.pIndex);
+	}
+
+	// the half torus draws the first half of the indices
+	const GLsizei segmentEnds[] = { (GLsizei)mesh.nIndices / 2 };
+	FinishArenaMesh(mesh, name, segmentEnds, 1);
+}
 
-			// Calculate vertex position on the surface of torus
-			auto surfacePosition = glm::vec3(
-				(_mainRadius + _tubeRadius * cosTubeSegment) * cosMainSegment,
-				(_mainRadius + _tubeRadius * cosTubeSegment) * sinMainSegment,
-				_tubeRadius * sinTubeSegment);
+///////////////////////////////////////////////////
+//	IsProceduralLayout()
+//
+//	Check whether the mesh allocated next has its
+//  vertices written by the procedural generator,
+//  which writes full floats, so the meshes of the
+//  compact layout are always written here.
+///////////////////////////////////////////////////
+bool ShapeMeshes::IsProceduralLayout() const
+{
+	return((NULL != m_proceduralGenerator) && (m_bCompactVertices == false));
+}
 
-			//vertex_list.push_back(surfacePosition);
-			segment_points.push_back(surfacePosition);
+///////////////////////////////////////////////////
+//	AddProceduralMesh()
+//
+//	Record the parameters the GPU generates the
+//  vertices of a just allocated mesh from, and give
+//  it the bounds of the exact shape, which hold the
+//  vertices of every tessellation of it.
+///////////////////////////////////////////////////
+void ShapeMeshes::AddProceduralMesh(
+	GLMesh& mesh,
+	MESH_SHAPE shape,
+	int segments0,
+	int segments1,
+	float thickness)
+{
+	PROCEDURAL_MESH procedural;
+	procedural.shape = (GLuint)shape;
+	procedural.baseVertex = mesh.baseVertex;
+	procedural.segments[0] = (GLuint)segments0;
+	procedural.segments[1] = (GLuint)segments1;
+	procedural.thickness = thickness;
+	m_proceduralMeshes.push_back(procedural);
+	m_bProceduralReadBack = true;
+
+	glm::vec3 extent = (shape == SHAPE_TORUS) ?
+		glm::vec3(1.0f + thickness, 1.0f + thickness, thickness) : glm::vec3(1.0f);
+	mesh.bProcedural = true;
+	mesh.bounds.minXYZ = -extent;
+	mesh.bounds.maxXYZ = extent;
+	mesh.bounds.center = glm::vec3(0.0f);
+	mesh.bounds.radius = (shape == SHAPE_TORUS) ? (1.0f + thickness) : 1.0f;
+}
 
-			// Update current tube angle
-			currentTubeSegmentAngle += tubeSegmentAngleStep;
+///////////////////////////////////////////////////
+//	GetUnitCircle()
+//
+//	Get the cosine and sine of each of the given
+//  number of steps around a circle, and one more
+//  copying the first so seams close exactly. Each
+//  count is computed once and kept for the meshes
+//  generated after it.
+///////////////////////////////////////////////////
+const glm::vec2* ShapeMeshes::GetUnitCircle(int segments)
+{
+	for (size_t i = 0; i < m_unitCircles.size(); i++)
+	{
+		if (m_unitCircles[i].segments == segments)
+		{
+			return(m_unitCircles[i].points.data());
 		}
-		segments_list.push_back(segment_points);
-		segment_points.clear();
+	}
 
-		// Update main segment angle
-		currentMainSegmentAngle += mainSegmentAngleStep;
+	UNIT_CIRCLE circle;
+	circle.segments = segments;
+	circle.points.resize((size_t)segments + 1);
+	for (int i = 0; i < segments; i++)
+	{
+		float angle = (float)(2.0 * M_PI) * (float)i / (float)segments;
+		circle.points[i] = glm::vec2(cos(angle), sin(angle));
 	}
+	circle.points[segments] = circle.points[0];
 
-	float horizontalStep = 1.0 / _mainSegments;
-	float verticalStep = 1.0 / _tubeSegments;
-	float u = 0.0;
-	float v = 0.0;
+	// moving the tables keeps their points where they are, so
+	// pointers handed out before stay valid
+	m_unitCircles.push_back(std::move(circle));
+	return(m_unitCircles.back().points.data());
+}
 
-	// connect the various segments together, forming triangles
-	for (int i = 0; i < _mainSegments; i++)
+///////////////////////////////////////////////////
+//	AddModelMesh()
+//
+//	Take the vertices and indices of a mesh built
+//  elsewhere, and its simplified levels if passed,
+//  leaving the passed in vectors empty, to be
+//  generated into the arena when first drawn.
+///////////////////////////////////////////////////
+int ShapeMeshes::AddModelMesh(
+	const std::string& name,
+	std::vector<GLfloat>& vertices,
+	std::vector<GLuint>& indices,
+	std::vector<GLfloat>* pLODVertices,
+	std::vector<GLuint>* pLODIndices,
+	const float* pLODErrors)
+{
+	m_modelMeshes.push_back(MODEL_MESH());
+	MODEL_MESH& model = m_modelMeshes.back();
+	model.name = name;
+	model.vertices.swap(vertices);
+	model.indices.swap(indices);
+	model.bLoaded = false;
+	model.references = 0;
+	model.retention = RETAIN_CPU;
+	model.bCoded = false;
+	model.bLost = false;
+	for (int i = 0; i < MESH_LOD_COUNT - 1; i++)
 	{
-		for (int j = 0; j < _tubeSegments; j++)
+		model.lodNames[i] = name + " LOD " + std::to_string(i + 1);
+		model.lodErrors[i] = 0.0f;
+		if ((NULL != pLODVertices) && (NULL != pLODIndices) && (NULL != pLODErrors))
 		{
-			if (((i + 1) < _mainSegments) && ((j + 1) < _tubeSegments))
-			{
-				vertex_list.push_back(segments_list[i][j]);
-				texture_coords.push_back(glm::vec2(u, v));
-				vertex_list.push_back(segments_list[i][j + 1]);
-				texture_coords.push_back(glm::vec2(u, v + verticalStep));
-				vertex_list.push_back(segments_list[i + 1][j + 1]);
-				texture_coords.push_back(glm::vec2(u + horizontalStep, v + verticalStep));
-				vertex_list.push_back(segments_list[i][j]);
-				texture_coords.push_back(glm::vec2(u, v));
-				vertex_list.push_back(segments_list[i + 1][j]);
-				texture_coords.push_back(glm::vec2(u + horizontalStep, v));
-				vertex_list.push_back(segments_list[i + 1][j + 1]);
-				texture_coords.push_back(glm::vec2(u + horizontalStep, v - verticalStep));
-				vertex_list.push_back(segments_list[i][j]);
-				texture_coords.push_back(glm::vec2(u, v));
-			}
-			else
-			{
-				if (((i + 1) == _mainSegments) && ((j + 1) == _tubeSegments))
-				{
-					vertex_list.push_back(segments_list[i][j]);
-					texture_coords.push_back(glm::vec2(u, v));
-					vertex_list.push_back(segments_list[i][0]);
-					texture_coords.push_back(glm::vec2(u, 0));
-					vertex_list.push_back(segments_list[0][0]);
-					texture_coords.push_back(glm::vec2(0, 0));
-					vertex_list.push_back(segments_list[i][j]);
-					texture_coords.push_back(glm::vec2(u, v));
-					vertex_list.push_back(segments_list[0][j]);
-					texture_coords.push_back(glm::vec2(0, v));
-					vertex_list.push_back(segments_list[0][0]);
-					texture_coords.push_back(glm::vec2(0, 0));
-					vertex_list.push_back(segments_list[i][j]);
-					texture_coords.push_back(glm::vec2(u, v));
-				}
-				else if ((i + 1) == _mainSegments)
-				{
-					vertex_list.push_back(segments_list[i][j]);
-					texture_coords.push_back(glm::vec2(u, v));
-					vertex_list.push_back(segments_list[i][j + 1]);
-					texture_coords.push_back(glm::vec2(u, v + verticalStep));
-					vertex_list.push_back(segments_list[0][j + 1]);
-					texture_coords.push_back(glm::vec2(0, v + verticalStep));
-					vertex_list.push_back(segments_list[i][j]);
-					texture_coords.push_back(glm::vec2(u, v));
-					vertex_list.push_back(segments_list[0][j]);
-					texture_coords.push_back(glm::vec2(0, v));
-					vertex_list.push_back(segments_list[0][j + 1]);
-					texture_coords.push_back(glm::vec2(0, v + verticalStep));
-					vertex_list.push_back(segments_list[i][j]);
-					texture_coords.push_back(glm::vec2(u, v));
-				}
-				else if ((j + 1) == _tubeSegments)
-				{
-					vertex_list.push_back(segments_list[i][j]);
-					texture_coords.push_back(glm::vec2(u, v));
-					vertex_list.push_back(segments_list[i][0]);
-					texture_coords.push_back(glm::vec2(u, 0));
-					vertex_list.push_back(segments_list[i + 1][0]);
-					texture_coords.push_back(glm::vec2(u + horizontalStep, 0));
-					vertex_list.push_back(segments_list[i][j]);
-					texture_coords.push_back(glm::vec2(u, v));
-					vertex_list.push_back(segments_list[i + 1][j]);
-					texture_coords.push_back(glm::vec2(u + horizontalStep, v));
-					vertex_list.push_back(segments_list[i + 1][0]);
-					texture_coords.push_back(glm::vec2(u + horizontalStep, 0));
-					vertex_list.push_back(segments_list[i][j]);
-					texture_coords.push_back(glm::vec2(u, v));
-				}
-
-			}
-			v += verticalStep;
+			model.lodVertices[i].swap(pLODVertices[i]);
+			model.lodIndices[i].swap(pLODIndices[i]);
+			model.lodErrors[i] = pLODErrors[i];
 		}
-		v = 0.0;
-		u += horizontalStep;
 	}
+	TrackHostCopies();
+	return((int)m_modelMeshes.size() - 1);
+}
 
-	std::vector<GLfloat> combined_values;
+///////////////////////////////////////////////////
+//	ReplaceModelMesh()
+//
+//	Take new vertices, indices and simplified levels
+//  for a mesh added by AddModelMesh(), leaving the
+//  passed in vectors holding the old ones. A mesh
+//  already in the arena cannot be resized there, so
+//  it is marked garbage. Its policy applies to the
+//  new copy once it is drawn.
+///////////////////////////////////////////////////
+void ShapeMeshes::ReplaceModelMesh(
+	int modelMesh,
+	std::vector<GLfloat>& vertices,
+	std::vector<GLuint>& indices,
+	std::vector<GLfloat>* pLODVertices,
+	std::vector<GLuint>* pLODIndices,
+	const float* pLODErrors)
+{
+	if ((modelMesh < 0) || (modelMesh >= (int)m_modelMeshes.size()))
+	{
+		return;
+	}
 
-	// combine interleaved vertices, normals, and texture coords
-	for (int i = 0; i < vertex_list.size(); i++)
+	MODEL_MESH& model = m_modelMeshes[modelMesh];
+	model.vertices.swap(vertices);
+	model.indices.swap(indices);
+	for (int i = 0; i < MESH_LOD_COUNT - 1; i++)
 	{
-		vertex = vertex_list[i];
-		normal = normalize(vertex);
-		if (vertex.x < 0)
-		{
-			if (normal.x > 0)
-				normal.x *= -1;
-		}
-		else if (vertex.x > 0)
-		{
-			if (normal.x < 0)
-				normal.x *= -1;
-		}
-		if (vertex.y < 0)
+		if ((NULL != pLODVertices) && (NULL != pLODIndices) && (NULL != pLODErrors))
 		{
-			if (normal.y > 0)
-				normal.y *= -1;
+			model.lodVertices[i].swap(pLODVertices[i]);
+			model.lodIndices[i].swap(pLODIndices[i]);
+			model.lodErrors[i] = pLODErrors[i];
 		}
-		else if (vertex.y > 0)
+		else
 		{
-			if (normal.y < 0)
-				normal.y *= -1;
+			model.lodVertices[i].clear();
+			model.lodIndices[i].clear();
+			model.lodErrors[i] = 0.0f;
 		}
-		if (vertex.z < 0)
+	}
+	if (model.bLoaded == true)
+	{
+		model.bLoaded = false;
+		m_bArenaGarbage = true;
+	}
+	// the coding is of the old copy
+	for (int level = 0; level < MESH_LOD_COUNT; level++)
+	{
+		model.coded[level] = MESH_CODE();
+	}
+	model.bCoded = false;
+	model.bLost = false;
+	TrackHostCopies();
+}
+
+///////////////////////////////////////////////////
+//	SetModelMeshSource()
+//
+//	Set the callback building the meshes kept by
+//  RETAIN_DERIVED again. Without one they keep
+//  their CPU copies.
+///////////////////////////////////////////////////
+void ShapeMeshes::SetModelMeshSource(
+	ModelMeshSource source,
+	void* pContext)
+{
+	m_modelMeshSource = source;
+	m_pModelMeshSourceContext = pContext;
+}
+
+///////////////////////////////////////////////////
+//	SetModelMeshRetention()
+//
+//	Set what a model mesh keeps on the CPU, bringing
+//  its copy back before applying the new policy, so
+//  a policy keeping more than the old one has it,
+//  and one keeping less drops or codes it now when
+//  the mesh is in the arena.
+///////////////////////////////////////////////////
+void ShapeMeshes::SetModelMeshRetention(
+	int modelMesh,
+	MESH_RETENTION retention)
+{
+	if ((modelMesh < 0) || (modelMesh >= (int)m_modelMeshes.size()) ||
+		(retention < 0) || (retention >= RETAIN_COUNT))
+	{
+		return;
+	}
+
+	MODEL_MESH& model = m_modelMeshes[modelMesh];
+	if (model.retention == retention)
+	{
+		return;
+	}
+	model.retention = retention;
+	if ((RestoreModelMesh(modelMesh) == true) && (retention != RETAIN_COMPRESSED))
+	{
+		for (int level = 0; level < MESH_LOD_COUNT; level++)
 		{
-			if (normal.z > 0)
-				normal.z *= -1;
+			model.coded[level] = MESH_CODE();
 		}
-		else if (vertex.z > 0)
+		model.bCoded = false;
+	}
+	DropModelMesh(model);
+	TrackHostCopies();
+}
+
+///////////////////////////////////////////////////
+//	FindMeshRetention()
+//
+//	Get the retention policy of a name, as given on
+//  the command line.
+///////////////////////////////////////////////////
+ShapeMeshes::MESH_RETENTION ShapeMeshes::FindMeshRetention(const char* name)
+{
+	static const char* RETENTION_NAMES[RETAIN_COUNT] = { "cpu", "compressed", "derived", "gpu" };
+	for (int i = 0; (NULL != name) && (i < RETAIN_COUNT); i++)
+	{
+		if (strcmp(name, RETENTION_NAMES[i]) == 0)
 		{
-			if (normal.z < 0)
-				normal.z *= -1;
+			return((MESH_RETENTION)i);
 		}
-		text_coord = texture_coords[i];
-		combined_values.push_back(vertex.x);
-		combined_values.push_back(vertex.y);
-		combined_values.push_back(vertex.z);
-		combined_values.push_back(normal.x);
-		combined_values.push_back(normal.y);
-		combined_values.push_back(normal.z);
-		combined_values.push_back(text_coord.x);
-		combined_values.push_back(text_coord.y);
 	}
+	return(RETAIN_COUNT);
+}
 
-	// store vertex and index count
-	m_TorusMesh.nVertices = vertex_list.size();
-	m_TorusMesh.nIndices = 0;
+///////////////////////////////////////////////////
+//	DrawModelMesh()
+//
+//	Transform and draw a mesh added by AddModelMesh()
+//  to the window.
+///////////////////////////////////////////////////
+void ShapeMeshes::DrawModelMesh(int modelMesh)
+{
+	if ((modelMesh < 0) || (modelMesh >= (int)m_modelMeshes.size()))
+	{
+		return;
+	}
 
-	// Create VAO
-	glGenVertexArrays(1, &m_TorusMesh.vao); // we can also generate multiple VAOs or buffers at the same time
-	glBindVertexArray(m_TorusMesh.vao);
+	UseModelMesh(modelMesh);
+	const MODEL_MESH& model = m_modelMeshes[modelMesh];
+	if (model.bLoaded == false)
+	{
+		return;
+	}
+	GLint lodFirsts[MESH_LOD_COUNT - 1];
+	GLsizei lodCounts[MESH_LOD_COUNT - 1];
+	for (int i = 0; i < MESH_LOD_COUNT - 1; i++)
+	{
+		lodFirsts[i] = 0;
+		lodCounts[i] = (GLsizei)model.lods[i].nIndices;
+	}
+	SubmitDraw(model.mesh, GL_TRIANGLES, 0, model.mesh.nIndices,
+		model.lods, lodFirsts, lodCounts);
+}
 
-	// Create VBOs
-	glGenBuffers(1, m_TorusMesh.vbos);
-	glBindBuffer(GL_ARRAY_BUFFER, m_TorusMesh.vbos[0]); // Activates the buffer
-	glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * combined_values.size(), combined_values.data(), GL_STATIC_DRAW); // Sends vertex or coordinate data to the GPU
+///////////////////////////////////////////////////
+//	GetRadialPart()
+//
+//	Name the part of a cone or cylinder drawing the
+//  caps and sides asked for; PART_COUNT when none
+//  is asked for.
+///////////////////////////////////////////////////
+ShapeMeshes::MESH_PART ShapeMeshes::GetRadialPart(
+	bool bTop,
+	bool bBottom,
+	bool bSides)
+{
+	static const MESH_PART RADIAL_PARTS[8] =
+	{
+		PART_COUNT,			// nothing
+		PART_BOTTOM,
+		PART_TOP,
+		PART_CAPS,
+		PART_SIDES,
+		PART_OPEN_TOP,		// sides and bottom
+		PART_OPEN_BOTTOM,	// sides and top
+		PART_WHOLE
+	};
+	return(RADIAL_PARTS[((bBottom == true) ? 1 : 0) | ((bTop == true) ? 2 : 0) | ((bSides == true) ? 4 : 0)]);
+}
 
-	if (m_bMemoryLayoutDone == false)
+///////////////////////////////////////////////////
+//	DrawShapePart()
+//
+//	Draw one of the part ranges a shape was generated
+//  with, or record it while a recorder is set, with
+//  the same part of each of its LOD levels. A part
+//  is an index range like the whole shape, so the
+//  recorded draws of a part batch and instance with
+//  every other draw of it.
+///////////////////////////////////////////////////
+void ShapeMeshes::DrawShapePart(
+	MESH_SHAPE shape,
+	MESH_PART part)
+{
+	if ((shape < 0) || (shape >= SHAPE_COUNT))
 	{
-		SetShaderMemoryLayout();
+		return;
+	}
+
+	UseMesh(shape);
+	if ((part < 0) || (part >= PART_COUNT))
+	{
+		return;
+	}
+
+	GLMesh* pMeshes[MESH_LOD_COUNT];
+	int meshCount = GetShapeMeshes(shape, pMeshes);
+	const PART_RANGE& range = pMeshes[0]->parts[part];
+	if (range.count <= 0)
+	{
+		return;
 	}
-}
 
+	// every generated shape is wound counterclockwise seen from
+	// outside, so the whole of one but the plane hides its own back
+	// faces; the parts and halves leave them open to the view
+	bool bClosed = ((part == PART_WHOLE) && (shape != SHAPE_PLANE));
 
+	if (meshCount < MESH_LOD_COUNT)
+	{
+		SubmitDraw(*pMeshes[0], GL_TRIANGLES, range.first, range.count,
+			NULL, NULL, NULL, bClosed);
+		return;
+	}
+
+	// the LOD levels of a shape are one array, starting at pMeshes[1]
+	GLint lodFirsts[MESH_LOD_COUNT - 1];
+	GLsizei lodCounts[MESH_LOD_COUNT - 1];
+	for (int i = 0; i < MESH_LOD_COUNT - 1; i++)
+	{
+		lodFirsts[i] = pMeshes[i + 1]->parts[part].first;
+		lodCounts[i] = pMeshes[i + 1]->parts[part].count;
+	}
+	SubmitDraw(*pMeshes[0], GL_TRIANGLES, range.first, range.count,
+		pMeshes[1], lodFirsts, lodCounts, bClosed);
+}
 
 ///////////////////////////////////////////////////
 //	DrawBoxMesh()
@@ -2194,11 +3361,7 @@ void ShapeMeshes::LoadTorusMesh(float thickness)
 ///////////////////////////////////////////////////
 void ShapeMeshes::DrawBoxMesh()
 {
-	glBindVertexArray(m_BoxMesh.vao);
-
-	glDrawElements(GL_TRIANGLES, m_BoxMesh.nIndices, GL_UNSIGNED_INT, (void*)0);
-
-	glBindVertexArray(0);
+	DrawShapePart(SHAPE_BOX, PART_WHOLE);
 }
 
 ///////////////////////////////////////////////////
@@ -2210,15 +3373,7 @@ void ShapeMeshes::DrawBoxMesh()
 void ShapeMeshes::DrawConeMesh(
 	bool bDrawBottom)
 {
-	glBindVertexArray(m_ConeMesh.vao);
-
-	if (bDrawBottom == true)
-	{
-		glDrawArrays(GL_TRIANGLE_FAN, 0, 36);		//bottom
-	}
-	glDrawArrays(GL_TRIANGLE_STRIP, 36, 108);	//sides
-
-	glBindVertexArray(0);
+	DrawShapePart(SHAPE_CONE, GetRadialPart(false, bDrawBottom, true));
 }
 
 ///////////////////////////////////////////////////
@@ -2232,22 +3387,7 @@ void ShapeMeshes::DrawCylinderMesh(
 	bool bDrawBottom,
 	bool bDrawSides)
 {
-	glBindVertexArray(m_CylinderMesh.vao);
-
-	if (bDrawBottom == true)
-	{
-		glDrawArrays(GL_TRIANGLE_FAN, 0, 36);	//bottom
-	}
-	if (bDrawTop == true)
-	{
-		glDrawArrays(GL_TRIANGLE_FAN, 36, 36);	//top
-	}
-	if (bDrawSides == true)
-	{
-		glDrawArrays(GL_TRIANGLE_STRIP, 72, 146);	//sides
-	}
-
-	glBindVertexArray(0);
+	DrawShapePart(SHAPE_CYLINDER, GetRadialPart(bDrawTop, bDrawBottom, bDrawSides));
 }
 
 ///////////////////////////////////////////////////
@@ -2258,11 +3398,7 @@ void ShapeMeshes::DrawCylinderMesh(
 ///////////////////////////////////////////////////
 void ShapeMeshes::DrawPlaneMesh()
 {
-	glBindVertexArray(m_PlaneMesh.vao);
-
-	glDrawElements(GL_TRIANGLES, m_PlaneMesh.nIndices, GL_UNSIGNED_INT, (void*)0);
-	
-	glBindVertexArray(0);
+	DrawShapePart(SHAPE_PLANE, PART_WHOLE);
 }
 
 ///////////////////////////////////////////////////
@@ -2273,11 +3409,7 @@ void ShapeMeshes::DrawPlaneMesh()
 ///////////////////////////////////////////////////
 void ShapeMeshes::DrawPrismMesh()
 {
-	glBindVertexArray(m_PrismMesh.vao);
-
-	glDrawArrays(GL_TRIANGLE_STRIP, 0, m_PrismMesh.nVertices);
-
-	glBindVertexArray(0);
+	DrawShapePart(SHAPE_PRISM, PART_WHOLE);
 }
 
 ///////////////////////////////////////////////////
@@ -2288,11 +3420,7 @@ void ShapeMeshes::DrawPrismMesh()
 ///////////////////////////////////////////////////
 void ShapeMeshes::DrawPyramid3Mesh()
 {
-	glBindVertexArray(m_Pyramid3Mesh.vao);
-
-	glDrawArrays(GL_TRIANGLE_STRIP, 0, m_Pyramid3Mesh.nVertices);
-
-	glBindVertexArray(0);
+	DrawShapePart(SHAPE_PYRAMID3, PART_WHOLE);
 }
 
 ///////////////////////////////////////////////////
@@ -2303,11 +3431,7 @@ void ShapeMeshes::DrawPyramid3Mesh()
 ///////////////////////////////////////////////////
 void ShapeMeshes::DrawPyramid4Mesh()
 {
-	glBindVertexArray(m_Pyramid4Mesh.vao);
-
-	glDrawArrays(GL_TRIANGLE_STRIP, 0, m_Pyramid4Mesh.nVertices);
-
-	glBindVertexArray(0);
+	DrawShapePart(SHAPE_PYRAMID4, PART_WHOLE);
 }
 
 ///////////////////////////////////////////////////
@@ -2318,11 +3442,7 @@ void ShapeMeshes::DrawPyramid4Mesh()
 ///////////////////////////////////////////////////
 void ShapeMeshes::DrawSphereMesh()
 {
-	glBindVertexArray(m_SphereMesh.vao);
-
-	glDrawElements(GL_TRIANGLES, m_SphereMesh.nIndices, GL_UNSIGNED_INT, (void*)0);
-
-	glBindVertexArray(0);
+	DrawShapePart(SHAPE_SPHERE, PART_WHOLE);
 }
 
 ///////////////////////////////////////////////////
@@ -2333,11 +3453,7 @@ void ShapeMeshes::DrawSphereMesh()
 ///////////////////////////////////////////////////
 void ShapeMeshes::DrawHalfSphereMesh()
 {
-	glBindVertexArray(m_SphereMesh.vao);
-
-	glDrawElements(GL_TRIANGLES, m_SphereMesh.nIndices/2, GL_UNSIGNED_INT, (void*)0);
-
-	glBindVertexArray(0);
+	DrawShapePart(SHAPE_SPHERE, PART_HALF);
 }
 
 ///////////////////////////////////////////////////
@@ -2351,22 +3467,7 @@ void ShapeMeshes::DrawTaperedCylinderMesh(
 	bool bDrawBottom,
 	bool bDrawSides)
 {
-	glBindVertexArray(m_TaperedCylinderMesh.vao);
-
-	if (bDrawBottom == true)
-	{
-		glDrawArrays(GL_TRIANGLE_FAN, 0, 36);	//bottom
-	}
-	if (bDrawTop == true)
-	{
-		glDrawArrays(GL_TRIANGLE_FAN, 36, 72);	//top
-	}
-	if (bDrawSides == true)
-	{
-		glDrawArrays(GL_TRIANGLE_STRIP, 72, 146);	//sides
-	}
-
-	glBindVertexArray(0);
+	DrawShapePart(SHAPE_TAPERED_CYLINDER, GetRadialPart(bDrawTop, bDrawBottom, bDrawSides));
 }
 
 ///////////////////////////////////////////////////
@@ -2377,11 +3478,7 @@ void ShapeMeshes::DrawTaperedCylinderMesh(
 ///////////////////////////////////////////////////
 void ShapeMeshes::DrawTorusMesh()
 {
-	glBindVertexArray(m_TorusMesh.vao);
-
-	glDrawArrays(GL_TRIANGLES, 0, m_TorusMesh.nVertices);
-
-	glBindVertexArray(0);
+	DrawShapePart(SHAPE_TORUS, PART_WHOLE);
 }
 
 ///////////////////////////////////////////////////
@@ -2392,56 +3489,81 @@ void ShapeMeshes::DrawTorusMesh()
 ///////////////////////////////////////////////////
 void ShapeMeshes::DrawHalfTorusMesh()
 {
-	glBindVertexArray(m_TorusMesh.vao);
-
-	glDrawArrays(GL_TRIANGLES, 0, m_TorusMesh.nVertices/2);
-
-	glBindVertexArray(0);
+	DrawShapePart(SHAPE_TORUS, PART_HALF);
 }
 
-glm::vec3 ShapeMeshes::CalculateTriangleNormal(glm::vec3 p0, glm::vec3 p1, glm::vec3 p2)
+void ShapeMeshes::SetShaderMemoryLayout(bool bCompact, GLintptr vertexOffset)
 {
-	glm::vec3 Normal(0, 0, 0);
-	float v1x = p1.x - p0.x;
-	float v1y = p1.y - p0.y;
-	float v1z = p1.z - p0.z;
-	float v2x = p2.x - p1.x;
-	float v2y = p2.y - p1.y;
-	float v2z = p2.z - p1.z;
-	Normal.x = v1y * v2z - v1z * v2y;
-	Normal.y = v1z * v2x - v1x * v2z;
-	Normal.y = v1x * v2y - v1y * v2x;
-	float len = (float)sqrt(Normal.x * Normal.x + Normal.y * Normal.y + Normal.z * Normal.z);
-	if (len == 0)
+	// with vertex attribute binding the format is set once per VAO
+	// and read from binding 0, whichever buffer is attached to it
+	if (HasVertexAttribBinding() == true)
 	{
-		//throw Exception();
+		if (bCompact == true)
+		{
+			glVertexAttribFormat(0, g_FloatsPerVertex, GL_HALF_FLOAT, GL_FALSE,
+				offsetof(COMPACT_VERTEX, position));
+			glVertexAttribFormat(1, 4, GL_INT_2_10_10_10_REV, GL_TRUE,
+				offsetof(COMPACT_VERTEX, normal));
+			glVertexAttribFormat(2, g_FloatsPerUV, GL_HALF_FLOAT, GL_FALSE,
+				offsetof(COMPACT_VERTEX, uv));
+		}
+		else
+		{
+			glVertexAttribFormat(0, g_FloatsPerVertex, GL_FLOAT, GL_FALSE, 0);
+			glVertexAttribFormat(1, g_FloatsPerNormal, GL_FLOAT, GL_FALSE,
+				sizeof(GLfloat) * g_FloatsPerVertex);
+			glVertexAttribFormat(2, g_FloatsPerUV, GL_FLOAT, GL_FALSE,
+				sizeof(GLfloat) * (g_FloatsPerVertex + g_FloatsPerNormal));
+		}
+		for (GLuint attribute = 0; attribute < 3; attribute++)
+		{
+			glVertexAttribBinding(attribute, 0);
+			glEnableVertexAttribArray(attribute);
+		}
+		return;
 	}
-	else
+
+	if (bCompact == true)
 	{
-		Normal.x /= len;
-		Normal.y /= len;
-		Normal.z /= len;
+		const GLsizei compactStride = GetVertexStride(true);
+		glVertexAttribPointer(0, g_FloatsPerVertex, GL_HALF_FLOAT, GL_FALSE, compactStride,
+			(void*)(vertexOffset + offsetof(COMPACT_VERTEX, position)));
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, compactStride,
+			(void*)(vertexOffset + offsetof(COMPACT_VERTEX, normal)));
+		glEnableVertexAttribArray(1);
+		glVertexAttribPointer(2, g_FloatsPerUV, GL_HALF_FLOAT, GL_FALSE, compactStride,
+			(void*)(vertexOffset + offsetof(COMPACT_VERTEX, uv)));
+		glEnableVertexAttribArray(2);
+		return;
 	}
-	return Normal;
-}
 
 
-
-void ShapeMeshes::SetShaderMemoryLayout()
-{
 	// The following code defines the layout of the mesh data in memory - each mesh needs
 	// to have the same memory layout so that the data is retrieved properly by the shaders
 
 	// Strides between vertex coordinates is 6 (x, y, z, r, g, b, a). A tightly packed stride is 0.
-	GLint stride = sizeof(float) * (g_FloatsPerVertex + g_FloatsPerNormal + g_FloatsPerUV);// The number of floats before each
+	GLint stride = GetVertexStride(false);// The number of floats before each
 
 	// Create Vertex Attribute Pointers
-	glVertexAttribPointer(0, g_FloatsPerVertex, GL_FLOAT, GL_FALSE, stride, 0);
+	glVertexAttribPointer(0, g_FloatsPerVertex, GL_FLOAT, GL_FALSE, stride, (void*)vertexOffset);
 	glEnableVertexAttribArray(0);
 
-	glVertexAttribPointer(1, g_FloatsPerNormal, GL_FLOAT, GL_FALSE, stride, (void*)(sizeof(float) * g_FloatsPerVertex));
+	glVertexAttribPointer(1, g_FloatsPerNormal, GL_FLOAT, GL_FALSE, stride, (void*)(vertexOffset + sizeof(float) * g_FloatsPerVertex));
 	glEnableVertexAttribArray(1);
 
-	glVertexAttribPointer(2, g_FloatsPerUV, GL_FLOAT, GL_FALSE, stride, (void*)(sizeof(float) * (g_FloatsPerVertex + g_FloatsPerNormal)));
+	glVertexAttribPointer(2, g_FloatsPerUV, GL_FLOAT, GL_FALSE, stride, (void*)(vertexOffset + sizeof(float) * (g_FloatsPerVertex + g_FloatsPerNormal)));
 	glEnableVertexAttribArray(2);
+}
+
+///////////////////////////////////////////////////
+//	GetVertexStride()
+//
+//	Bytes from one vertex to the next in the full
+//  float or the compact layout.
+///////////////////////////////////////////////////
+GLsizei ShapeMeshes::GetVertexStride(bool bCompact)
+{
+	return((bCompact == true) ? (GLsizei)sizeof(COMPACT_VERTEX) :
+		(GLsizei)(sizeof(GLfloat) * (g_FloatsPerVertex + g_FloatsPerNormal + g_FloatsPerUV)));
 }
\ No newline at end of file
@@ -10,10 +10,18 @@
 
 #pragma once
 
+#include "MeshOptimizer.h"
+#include "GPUMemory.h"
+#include "BufferAllocator.h"
+
 #include <GL/glew.h>
 
 #include <glm/glm.hpp>
 
+#include <deque>
+#include <string>
+#include <vector>
+
 /***********************************************************
  *  ShapeMeshes
  *
@@ -25,16 +33,350 @@ class ShapeMeshes
 public:
 	// constructor
 	ShapeMeshes();
+	// destructor
+	~ShapeMeshes();
+
+	// counters for the redundant VAO bind filter and the draws
+	struct BIND_STATS
+	{
+		unsigned long long vaoBinds;	// VAO binds sent to GL
+		unsigned long long vaoSkips;	// VAO binds skipped, already bound
+		unsigned long long drawCalls;	// draw calls sent to GL
+		unsigned long long instances;	// mesh instances drawn by those calls
+		unsigned long long elementDraws;	// indexed draw calls
+		unsigned long long arrayDraws;		// non-indexed draw calls
+		unsigned long long indirectDraws;	// multi-draw indirect calls
+		unsigned long long indices;		// indices submitted, times the instances
+		unsigned long long vertices;	// vertices of the non-indexed draws, likewise
+		unsigned long long bufferBytes;	// bytes uploaded into mesh buffers
+	};
+
+	static const BIND_STATS& GetBindStats() { return(s_bindStats); }
+	static void ResetBindStats();
+
+	// object space bounding volumes of a mesh
+	struct BOUNDS
+	{
+		glm::vec3 minXYZ;	// axis aligned bounding box
+		glm::vec3 maxXYZ;
+		glm::vec3 center;	// bounding sphere around the box center
+		float radius;
+	};
+
+	// tessellation levels of the sphere, cylinder and torus, finest first
+	static const int MESH_LOD_COUNT = 3;
+
+	// the shapes of the mesh registry
+	enum MESH_SHAPE
+	{
+		SHAPE_BOX = 0,
+		SHAPE_CONE,
+		SHAPE_CYLINDER,
+		SHAPE_PLANE,
+		SHAPE_PRISM,
+		SHAPE_PYRAMID3,
+		SHAPE_PYRAMID4,
+		SHAPE_SPHERE,
+		SHAPE_TAPERED_CYLINDER,
+		SHAPE_TORUS,
+		SHAPE_COUNT
+	};
+
+	// named index ranges of a shape mesh, computed when it is
+	// generated; a part a shape does not have draws nothing
+	enum MESH_PART
+	{
+		PART_WHOLE = 0,		// the default draw of the shape
+		PART_HALF,			// upper half of the sphere or torus
+		PART_BOTTOM,		// bottom cap of the radial shapes
+		PART_TOP,			// top cap of the cylinders
+		PART_CAPS,			// bottom and top caps
+		PART_SIDES,			// sides of the radial shapes
+		PART_OPEN_TOP,		// sides and bottom cap
+		PART_OPEN_BOTTOM,	// sides and top cap
+		PART_COUNT
+	};
+
+	// where a draw range starts and how long it is at one LOD level
+	struct LOD_RANGE
+	{
+		GLint first;
+		GLsizei count;
+		GLint baseVertex;
+		float error;	// farthest the level moves the surface off the finest,
+						// in model units; 0 when not known, as for the shapes
+	};
+
+	// one GL draw call issued by a Draw*Mesh() method
+	struct DRAW_RANGE
+	{
+		GLuint vao;		// VAO of the mesh
+		GLenum mode;		// primitive type
+		GLint first;		// first vertex or index in the arena
+		GLsizei count;		// number of vertices or indices
+		GLint baseVertex;	// added to each index, indexed draws only
+		bool bIndexed;		// true for glDrawElements
+		GLenum indexType;	// GL_UNSIGNED_SHORT or GL_UNSIGNED_INT, indexed draws only
+		BOUNDS bounds;		// bounds of the whole mesh the range is part of
+		int lodLevels;		// LOD levels of the range, 1 for meshes without LODs
+		LOD_RANGE lods[MESH_LOD_COUNT];	// the range at each LOD level, lods[0] is the range itself
+		GLuint firstMeshlet;	// meshlets covering the range at LOD level 0, in the arena
+		GLuint meshletCount;	// 0 when the range is not split into meshlets
+		bool bClosed;		// a closed surface wound counterclockwise outward, whose back faces can be culled
+	};
+
+	// command layout shared by glMultiDrawElementsIndirect and
+	// glMultiDrawArraysIndirect; array commands leave the last
+	// field unused and take the base instance in the fourth
+	struct INDIRECT_COMMAND
+	{
+		GLuint count;
+		GLuint instanceCount;
+		GLuint first;			// first index or first vertex
+		GLuint baseVertexOrInstance;
+		GLuint baseInstance;
+	};
+
+	// receives the draw ranges while a recorder is set
+	typedef void (*DrawRecorder)(void* pContext, const DRAW_RANGE& drawRange);
+
+	// record the draw ranges instead of drawing, NULL to draw again
+	void SetDrawRecorder(DrawRecorder drawRecorder, void* pContext);
+
+	// draw a range recorded from one of the Draw*Mesh() methods,
+	// instanced when more than one instance is requested
+	static void DrawRange(const DRAW_RANGE& drawRange, GLsizei instanceCount = 1);
+
+	// copy of a recorded range drawing one of its LOD levels
+	static DRAW_RANGE GetLODRange(const DRAW_RANGE& drawRange, int lod);
+
+	// build the indirect command for a recorded range
+	static INDIRECT_COMMAND MakeIndirectCommand(
+		const DRAW_RANGE& drawRange,
+		GLuint instanceCount,
+		GLuint baseInstance);
+
+	// draw commands of the bound GL_DRAW_INDIRECT_BUFFER with one call,
+	// counting commandIndex from the commands at bufferOffset;
+	// instanceCount is the total of the commands, for the stats only
+	static void MultiDrawIndirect(
+		GLuint vao,
+		GLenum mode,
+		bool bIndexed,
+		GLenum indexType,
+		GLsizei commandIndex,
+		GLsizei drawCount,
+		GLsizei instanceCount,
+		GLintptr bufferOffset);
+
+	// bind a VAO unless it is already the bound one; other code drawing
+	// with its own VAO binds through here to keep the filter in step
+	static void BindVertexArray(GLuint vao);
+	// bind a texture on the active unit for the calls creating or
+	// reading it without direct state access, returning what the unit
+	// held; RestoreTextureBinding() binds that back, so the unit ends
+	// as the filter of ShaderManager::BindTexture() last left it
+	static GLuint BindTextureForEdit(GLenum target, GLuint texture);
+	static void RestoreTextureBinding(GLenum target, GLuint previousTexture);
+
+	// floats of one interleaved arena vertex: position, normal, UV
+	static const int VERTEX_FLOATS = 8;
+	// bytes of one vertex of the compact layout: half float position
+	// padded to four halves, 2_10_10_10 normal, half float UV
+	static const int COMPACT_VERTEX_BYTES = 16;
+
+	// store the meshes loaded after this call in the compact layout,
+	// or in full floats again; the vertex fetch turns both back into
+	// the floats the shaders read, the compact one rounding positions
+	// to half floats, so precision sensitive meshes keep full floats
+	void SetCompactVertices(bool bCompact) { m_bCompactVertices = bCompact; }
+	bool GetCompactVertices() const { return(m_bCompactVertices); }
+	// true for the VAO the meshes of the compact layout draw with
+	bool IsCompactVAO(GLuint vao) const { return((0 != vao) && (vao == m_compactVAO)); }
+
+	// split the finest LOD level of the model meshes loaded after
+	// this call into meshlets the GPU culls one at a time; the
+	// shapes stay whole, their draws are already cheap to cull
+	void SetBuildMeshlets(bool bBuild) { m_bBuildMeshlets = bBuild; }
+	// meshlets of the whole arena, their vertices as arena vertex
+	// numbers, and their packed triangles, with the storage ranges
+	// UploadArena() fills from them; the meshlet vertices read the
+	// full float vertex buffer
+	const std::vector<MeshOptimizer::MESHLET>& GetMeshlets() const { return(m_meshlets); }
+	BufferAllocator::RANGE GetMeshletBuffer() const { return(GetMeshletRange(0)); }
+	BufferAllocator::RANGE GetMeshletVertexBuffer() const { return(GetMeshletRange(1)); }
+	BufferAllocator::RANGE GetMeshletTriangleBuffer() const { return(GetMeshletRange(2)); }
+	// place the meshlet arrays in movable ranges of the pages of an
+	// allocator from the next upload on, NULL for buffers of their
+	// own; the ranges are read at every bind, so they may move
+	void SetBufferAllocator(BufferAllocator* pAllocator);
+	GLuint GetArenaVertexBuffer() const { return(m_arenaBuffers[0]); }
+
+	// parameters of a sphere or torus whose vertices are written by
+	// the GPU into the full float vertex buffer, one record per
+	// tessellation, laid out as the uniforms of the compute shader
+	struct PROCEDURAL_MESH
+	{
+		GLuint shape;			// SHAPE_SPHERE or SHAPE_TORUS
+		GLuint baseVertex;		// first vertex of the mesh in the arena
+		GLuint segments[2];		// bands and slices, or main and tube segments
+		float thickness;		// tube radius of the torus
+	};
+
+	// what a model mesh keeps on the CPU once it is generated into
+	// the arena: all of it, its MeshCodec coding, nothing while the
+	// source of RETAIN_DERIVED can build it again, or nothing while it is in
+	// the arena, copying it back out before the arena is cleared
+	enum MESH_RETENTION
+	{
+		RETAIN_CPU = 0,
+		RETAIN_COMPRESSED,
+		RETAIN_DERIVED,
+		RETAIN_GPU_ONLY,
+		RETAIN_COUNT
+	};
+
+	// builds the vertices, triangle list and simplified levels of a
+	// model mesh again, MESH_LOD_COUNT - 1 of each, the way they were
+	// added; false when it cannot
+	typedef bool (*ModelMeshSource)(void* pContext, int modelMesh, std::vector<GLfloat>& vertices,
+		std::vector<GLuint>& indices, std::vector<GLfloat>* pLODVertices, std::vector<GLuint>* pLODIndices,
+		float* pLODErrors);
+
+	// receives the procedural meshes whenever the arena is uploaded,
+	// with the new vertex buffer to write their vertices into
+	typedef void (*ProceduralGenerator)(void* pContext, GLuint vertexBuffer,
+		const std::vector<PROCEDURAL_MESH>& meshes);
+
+	// generate the vertices of the full float spheres and tori
+	// loaded after this call on the GPU, NULL to write them on the
+	// CPU again; their indices are still built here, and the CPU
+	// copy of their vertices stays zero until read back
+	void SetProceduralGenerator(ProceduralGenerator generator, void* pContext);
+	// copy the vertices the GPU generated into the CPU copy of the
+	// arena, for the passes reading the mesh data back; does
+	// nothing once they are there
+	void ReadBackProceduralMeshes();
+
+	// true when GL objects can be created and filled without binding
+	// them, with GL 4.5 or ARB_direct_state_access
+	static bool HasDirectStateAccess();
+	// true when a VAO can describe its vertex format apart from the
+	// buffers feeding it, with GL 4.3 or ARB_vertex_attrib_binding
+	static bool HasVertexAttribBinding();
+	// create a vertex array object for one vertex format, the
+	// interleaved VERTEX_FLOATS vertices or the compact ones with
+	// bCompact, ready for AttachMeshBuffers(); the format is set
+	// once here when the VAO can keep it apart from the buffers; the
+	// label names it in the GL debug mode
+	static GLuint CreateVertexArray(bool bCompact = false, const char* label = NULL);
+	// create a buffer with immutable storage holding size bytes of pData,
+	// its memory tracked in the category
+	static GLuint CreateStaticBuffer(GLsizeiptr size, const void* pData, const char* label = NULL,
+		GPUMemory::CATEGORY category = GPUMemory::CATEGORY_MESH);
+	// writes size bytes of a buffer through the mapping at pDestination,
+	// false when its source is damaged
+	typedef bool (*BufferDecoder)(const void* pContext, void* pDestination);
+	// create a buffer like CreateStaticBuffer(), its storage written
+	// by pDecoder straight into its mapping; 0, with no buffer left,
+	// when it cannot be mapped or the decoder fails
+	static GLuint CreateDecodedBuffer(GLsizeiptr size, BufferDecoder pDecoder, const void* pContext,
+		const char* label = NULL, GPUMemory::CATEGORY category = GPUMemory::CATEGORY_MESH);
+	// point a VAO of the format of bCompact at a vertex buffer, its
+	// vertices starting at vertexOffset, and, unless it is 0, an
+	// index buffer; with vertex attribute binding only the buffer
+	// bindings change, the format stays as it was
+	static void AttachMeshBuffers(GLuint vao, GLuint vertexBuffer, GLuint indexBuffer,
+		bool bCompact = false, GLintptr vertexOffset = 0);
+
+	// send the meshes loaded since the last upload to GL; drawing a
+	// mesh uploads them too, but recording draws does not, so the
+	// caller uploads once the draws are recorded
+	void UploadArena();
+
+	// write the meshes in the arena, with their LOD levels and stats,
+	// to a baked mesh file the way they are sent to GL, with bEncode
+	// coded by MeshCodec for a smaller file
+	bool SaveBakedMeshes(const char* filename, bool bEncode = false);
+	// fill the empty arena from a baked mesh file, its buffers
+	// created straight from the mapped blobs, or decoded into them
+	// when they are coded; false, leaving the meshes to be
+	// generated, when the file is missing or bad, or a shape in it
+	// is requested at another tessellation or layout
+	bool LoadBakedMeshes(const char* filename);
+
+	// count the draws of each shape from zero again
+	void ResetMeshReferences();
+	// draws of a shape since ResetMeshReferences()
+	unsigned int GetMeshReferences(MESH_SHAPE shape) const { return(m_meshSlots[shape].references); }
+	bool IsMeshLoaded(MESH_SHAPE shape) const { return(m_meshSlots[shape].bLoaded); }
+	// free the meshes no draw used since ResetMeshReferences() and
+	// the ones replaced by another tessellation; true when it did,
+	// which clears the arena, so the draws recorded since the reset
+	// must be recorded again
+	bool ReleaseUnreferencedMeshes();
+
+	// CPU copies of the vertex and index buffers shared by every
+	// mesh, for reading the mesh data back like the static bake does;
+	// the meshes of each layout number their vertices in their own
+	// arena, kept in floats for both
+	const std::vector<GLfloat>& GetArenaVertices(bool bCompact = false) const
+	{
+		return((bCompact == true) ? m_compactVertices : m_arenaVertices);
+	}
+	const std::vector<GLuint>& GetArenaIndices() const { return(m_arenaIndices); }
+
+	// vertex cache quality of a mesh before and after the load
+	// time reordering of its triangles and vertices
+	struct MESH_STATS
+	{
+		const char* name;
+		bool bCompact;		// stored in the compact layout
+		GLuint vertexCount;
+		GLuint triangleCount;
+		MeshOptimizer::CACHE_STATS before;
+		MeshOptimizer::CACHE_STATS after;
+	};
+
+	// one entry per mesh loaded, LOD levels included
+	const std::vector<MESH_STATS>& GetMeshStats() const { return(m_meshStats); }
 
 private:
 
+	// where a part of a mesh starts and how many indices it has,
+	// none when count is 0
+	struct PART_RANGE
+	{
+		GLint first;
+		GLsizei count;
+	};
+
 	// stores the GL data relative to a given mesh
 	struct GLMesh
 	{
-		GLuint vao;         // Handle for the vertex array object
-		GLuint vbos[2];     // Handles for the vertex buffer objects
+		GLuint vao;         // Handle for the vertex array object (the arena VAO)
 		GLuint nVertices;	// Number of vertices for the mesh
 		GLuint nIndices;    // Number of indices for the mesh
+		GLuint baseVertex;	// first vertex of the mesh in the arena
+		GLuint firstIndex;	// first index of the mesh in the arena
+		GLuint slices;		// around the axis of the cone and cylinders, 0 for others
+		bool bCompact;		// in the compact arena, drawn with its VAO
+		BOUNDS bounds;		// computed from the vertices at load time
+		GLuint firstMeshlet;	// first of its meshlets in the arena
+		GLuint meshletCount;	// 0 when it was not split into meshlets
+		bool bProcedural;	// vertices written by the GPU, bounds set by its generator
+		float lodError;		// farthest it moves the surface of the mesh it was
+							// simplified from, 0 for the others
+		PART_RANGE parts[PART_COUNT];	// index ranges of its parts, relative to firstIndex
+	};
+
+	// where a generator writes the next vertex and index of a
+	// mesh in the arena
+	struct MESH_CURSOR
+	{
+		GLfloat* pVertex;
+		GLuint* pIndex;
+		GLuint vertexIndex;	// of the next vertex, from the first of the mesh
 	};
 
 	// the available 3D shapes
@@ -49,20 +391,142 @@ private:
 	GLMesh m_TaperedCylinderMesh;
 	GLMesh m_TorusMesh;
 
-	bool m_bMemoryLayoutDone;
+	// coarser tessellations of the sphere, cylinder and torus,
+	// for LOD levels 1 and up
+	GLMesh m_SphereLODs[MESH_LOD_COUNT - 1];
+	GLMesh m_CylinderLODs[MESH_LOD_COUNT - 1];
+	GLMesh m_TorusLODs[MESH_LOD_COUNT - 1];
+
+	// vertex and index buffers shared by every mesh, their VAO,
+	// and the CPU copy the meshes are appended to; dirty while
+	// the CPU copy holds meshes the buffers do not
+	bool m_bArenaDirty;
+	GLuint m_arenaVAO;
+	GLuint m_arenaBuffers[2];
+	GLuint m_arenaMaxIndex;		// largest index, which picks the index type
+	bool m_bArenaGarbage;		// holds meshes replaced by another tessellation
+	std::vector<GLfloat> m_arenaVertices;
+	std::vector<GLuint> m_arenaIndices;
+	std::vector<MESH_STATS> m_meshStats;
+	// names of the stats read from a baked mesh file
+	std::vector<std::string> m_bakedNames;
+
+	// the arena of the meshes in the compact layout, sharing the
+	// index buffer; its CPU copy stays in floats and is packed on
+	// upload
+	bool m_bCompactVertices;	// layout of the meshes loaded next
+	GLuint m_compactVAO;
+	GLuint m_compactVertexBuffer;
+	std::vector<GLfloat> m_compactVertices;
+
+	// meshlets of the meshes split into them, uploaded with the
+	// arena to the storage buffers of the meshlets, their vertices
+	// and their triangles
+	bool m_bBuildMeshlets;
+	std::vector<MeshOptimizer::MESHLET> m_meshlets;
+	std::vector<GLuint> m_meshletVertices;
+	std::vector<GLuint> m_meshletTriangles;
+	// their storage: allocations of the pages of the allocator when
+	// one is set, otherwise whole buffers of their own
+	BufferAllocator* m_pBufferAllocator;
+	int m_meshletAllocations[3];
+	BufferAllocator::RANGE m_meshletBuffers[3];
+
+	// the GPU generation of the spheres and tori: the callback, the
+	// meshes of the arena it writes on every upload, and whether
+	// the CPU copy still lacks their vertices
+	ProceduralGenerator m_proceduralGenerator;
+	void* m_pProceduralContext;
+	std::vector<PROCEDURAL_MESH> m_proceduralMeshes;
+	bool m_bProceduralReadBack;
+
+	// the tessellation and layout each shape is generated with
+	// the first time it is drawn, and the draws using it
+	struct MESH_SLOT
+	{
+		bool bLoaded;			// generated into the arena
+		bool bCompact;			// layout it is generated in
+		int resolution[2];		// divisions, slices, or bands and slices
+		float thickness;		// of the torus tube
+		unsigned int references;	// draws since ResetMeshReferences()
+	};
+	MESH_SLOT m_meshSlots[SHAPE_COUNT];
+
+	// the MeshCodec coding of the vertices and triangle list of a
+	// model mesh or one of its levels
+	struct MESH_CODE
+	{
+		size_t vertexCount;
+		size_t indexCount;
+		std::vector<unsigned char> vertices;
+		std::vector<unsigned char> indices;
+	};
+
+	// a mesh built elsewhere, like a part of an imported model,
+	// kept to be generated into the arena when first drawn and
+	// again after the arena is cleared; a deque, so the names
+	// the stats point at never move
+	struct MODEL_MESH
+	{
+		std::string name;
+		std::vector<GLfloat> vertices;	// interleaved VERTEX_FLOATS
+		std::vector<GLuint> indices;	// triangle list
+		bool bLoaded;
+		unsigned int references;
+		GLMesh mesh;
+		GLMesh lods[MESH_LOD_COUNT - 1];	// the coarser levels, or copies of the level above
+		std::string lodNames[MESH_LOD_COUNT - 1];
+		// the coarser levels simplified before it was added, and
+		// their errors; empty for the levels clustered when loaded
+		std::vector<GLfloat> lodVertices[MESH_LOD_COUNT - 1];
+		std::vector<GLuint> lodIndices[MESH_LOD_COUNT - 1];
+		float lodErrors[MESH_LOD_COUNT - 1];
+		// what it keeps on the CPU while in the arena, and the coding
+		// of the mesh and its levels above while RETAIN_COMPRESSED
+		MESH_RETENTION retention;
+		bool bCoded;
+		MESH_CODE coded[MESH_LOD_COUNT];
+		bool bLost;				// its copy could not be restored, so it is not drawn
+	};
+	std::deque<MODEL_MESH> m_modelMeshes;
+	// builds the meshes kept by RETAIN_DERIVED again
+	ModelMeshSource m_modelMeshSource;
+	void* m_pModelMeshSourceContext;
+
+	// cosine and sine of every step around a circle split into
+	// segments steps, the last a copy of the first; kept when the
+	// arena is cleared so regenerated meshes skip the trig
+	struct UNIT_CIRCLE
+	{
+		int segments;
+		std::vector<glm::vec2> points;
+	};
+	std::vector<UNIT_CIRCLE> m_unitCircles;
+
+	// set while the draw ranges are being recorded
+	DrawRecorder m_drawRecorder;
+	void* m_pDrawRecorderContext;
+
+	// VAO currently bound in the GL context, shared by all instances
+	static GLuint s_boundVAO;
+	static BIND_STATS s_bindStats;
 
 public:
-	// methods for loading the shape mesh data 
-	// into memory
-	void LoadBoxMesh();
-	void LoadConeMesh();
-	void LoadCylinderMesh();
-	void LoadPlaneMesh();
-	void LoadPrismMesh();
-	void LoadPyramid3Mesh();
-	void LoadPyramid4Mesh();
-	void LoadSphereMesh();
-	void LoadTaperedCylinderMesh();
+	// methods for requesting the shape mesh data,
+	// generated into memory the first time it is
+	// drawn; slices go around the axis of the
+	// round shapes, bands from pole to pole of the
+	// sphere, and the flat faces of the others are
+	// split divisions times along each edge
+	void LoadBoxMesh(int divisions = 1);
+	void LoadConeMesh(int slices = 36);
+	void LoadCylinderMesh(int slices = 36);
+	void LoadPlaneMesh(int divisions = 1);
+	void LoadPrismMesh(int divisions = 1);
+	void LoadPyramid3Mesh(int divisions = 1);
+	void LoadPyramid4Mesh(int divisions = 1);
+	void LoadSphereMesh(int bands = 16, int slices = 16);
+	void LoadTaperedCylinderMesh(int slices = 36);
 	void LoadTorusMesh(float thickness = 0.2);
 
 	// methods for drawing the shape mesh in the
@@ -87,15 +551,166 @@ public:
 	void DrawTorusMesh();
 	void DrawHalfTorusMesh();
 
+	// draw a named part of a shape, through the recorder when one
+	// is set, so partial shapes batch like whole ones
+	void DrawShapePart(MESH_SHAPE shape, MESH_PART part);
+	// the part of a radial shape drawing the caps and sides asked
+	// for, PART_COUNT when none is
+	static MESH_PART GetRadialPart(bool bTop, bool bBottom, bool bSides);
 
-private:
+	// add a mesh built elsewhere, like a part of an imported model,
+	// taking its interleaved vertices and triangle list; it joins the
+	// arena in full floats with coarser LOD levels the first time it
+	// is drawn, and is freed and generated again like the shapes.
+	// The levels simplified already, MESH_LOD_COUNT - 1 of each with
+	// their errors, are taken as well; without them, or for a level
+	// left empty, the level is clustered when first drawn. Returns
+	// the ID its draws use
+	int AddModelMesh(const std::string& name, std::vector<GLfloat>& vertices, std::vector<GLuint>& indices,
+		std::vector<GLfloat>* pLODVertices = NULL, std::vector<GLuint>* pLODIndices = NULL,
+		const float* pLODErrors = NULL);
+	// swap the vertices, triangle list and simplified levels of a
+	// mesh added before for those of its file reloaded; draws keep
+	// its ID, and the arena is cleared so the new ones are generated
+	// into it when next drawn
+	void ReplaceModelMesh(int modelMesh, std::vector<GLfloat>& vertices, std::vector<GLuint>& indices,
+		std::vector<GLfloat>* pLODVertices = NULL, std::vector<GLuint>* pLODIndices = NULL,
+		const float* pLODErrors = NULL);
+	size_t GetModelMeshCount() const { return(m_modelMeshes.size()); }
+	void DrawModelMesh(int modelMesh);
 
-	// called to calculate the normal for 
-	// the passed in coordinates
-	glm::vec3 CalculateTriangleNormal(
-		glm::vec3 px, glm::vec3 py, glm::vec3 pz);
+	// the source of the meshes kept by RETAIN_DERIVED, NULL for none,
+	// which keeps their CPU copies
+	void SetModelMeshSource(ModelMeshSource source, void* pContext);
+	// keep the CPU copy of a model mesh by a policy, RETAIN_CPU when
+	// added; a copy dropped before is restored when the new policy
+	// keeps it
+	void SetModelMeshRetention(int modelMesh, MESH_RETENTION retention);
+	// the policy named cpu, compressed, derived or gpu, RETAIN_COUNT
+	// for any other name
+	static MESH_RETENTION FindMeshRetention(const char* name);
+
+
+private:
 
 	// called to set the memory layout 
-	// template for shader data
-	void SetShaderMemoryLayout();
+	// template for shader data, on the bound VAO; with vertex
+	// attribute binding the buffers are attached separately, else
+	// the vertices start at vertexOffset of the bound buffer
+	static void SetShaderMemoryLayout(bool bCompact = false, GLintptr vertexOffset = 0);
+	// bytes from one vertex of a layout to the next
+	static GLsizei GetVertexStride(bool bCompact);
+
+	// the arena vertices of the layout of a mesh
+	std::vector<GLfloat>& GetMeshVertices(const GLMesh& mesh)
+	{
+		return((mesh.bCompact == true) ? m_compactVertices : m_arenaVertices);
+	}
+
+	// record or draw one range of a mesh; meshes with coarser LOD
+	// levels also pass those meshes and where the range is in them,
+	// and a range covering a closed surface says so
+	void SubmitDraw(
+		const GLMesh& mesh,
+		GLenum mode,
+		GLint first,
+		GLsizei count,
+		const GLMesh* pLODMeshes = NULL,
+		const GLint* pLODFirsts = NULL,
+		const GLsizei* pLODCounts = NULL,
+		bool bClosed = false);
+
+	// registry of the shapes: remember the tessellation a Load*Mesh()
+	// method asks for, generate it on the first draw, and drop the
+	// whole arena for the meshes to be generated again
+	void RequestMesh(MESH_SHAPE shape, int resolution0, int resolution1, float thickness);
+	void UseMesh(MESH_SHAPE shape);
+	void UseModelMesh(int modelMesh);
+	void ClearArena();
+	// the CPU copy of a model mesh under its policy: restore it before
+	// it is generated, drop or code it after, and copy it back out of
+	// the arena before the arena is cleared
+	bool RestoreModelMesh(int modelMesh);
+	void DropModelMesh(MODEL_MESH& model);
+	void CopyBackModelMesh(MODEL_MESH& model);
+	// register the CPU copies of the arena and the model meshes with
+	// the memory accounting
+	void TrackHostCopies();
+	// the mesh of a shape and its LOD levels, returning how many
+	int GetShapeMeshes(MESH_SHAPE shape, GLMesh* pMeshes[MESH_LOD_COUNT]);
+	// compute the part ranges of a shape and its LOD levels once
+	// they are generated or read from a baked file
+	void SetShapeParts(MESH_SHAPE shape);
+	// index type of the arena index buffer as it stands
+	GLenum GetArenaIndexType() const;
+
+	// generate each shape into the arena, with its LOD levels
+	void BuildBoxMesh(int divisions);
+	void BuildConeMesh(int slices);
+	void BuildCylinderMesh(int slices);
+	void BuildPlaneMesh(int divisions);
+	void BuildPrismMesh(int divisions);
+	void BuildPyramid3Mesh(int divisions);
+	void BuildPyramid4Mesh(int divisions);
+	void BuildSphereMesh(int bands, int slices);
+	void BuildTaperedCylinderMesh(int slices);
+	void BuildTorusMesh(float thickness);
+
+	// build the meshes with LOD levels; the radial mesh is the
+	// cone, cylinder and tapered cylinder
+	void GenerateSphereMesh(GLMesh& mesh, const char* name, int bands, int slices);
+	void GenerateRadialMesh(GLMesh& mesh, const char* name, int slices, float topRadius, bool bTopCap);
+	// the one index range of a radial mesh drawing the bottom, the
+	// top and the sides asked for
+	static bool GetRadialRange(const GLMesh& mesh, bool bTopCap, bool bCone,
+		bool bBottom, bool bTop, bool bSides, GLint& first, GLsizei& count);
+	void GenerateTorusMesh(GLMesh& mesh, const char* name, int mainSegments, int tubeSegments, float thickness);
+	// true when the mesh allocated next gets its vertices from the
+	// procedural generator; records it and sets its analytic bounds
+	bool IsProceduralLayout() const;
+	void AddProceduralMesh(GLMesh& mesh, MESH_SHAPE shape, int segments0, int segments1, float thickness);
+	// segments + 1 points around the unit circle, built the first
+	// time a segment count is asked for
+	const glm::vec2* GetUnitCircle(int segments);
+
+	// compute the bounding box and sphere of interleaved vertices
+	static BOUNDS CalculateBounds(
+		const GLfloat* pVertexData,
+		size_t floatCount);
+
+	// grow the shared vertex and index buffers by one mesh for
+	// its generator to write into, then optimize its index order
+	// and compute its bounds; the triangles are only reordered
+	// within the segments ending at pSegmentEnds and at the last
+	// index, so draws of parts of the mesh keep their triangles
+	MESH_CURSOR AllocateArenaMesh(GLMesh& mesh, GLuint vertexCount, GLuint indexCount);
+	void FinishArenaMesh(
+		GLMesh& mesh,
+		const char* name,
+		const GLsizei* pSegmentEnds = NULL,
+		int segmentCount = 0);
+
+	// write vertices and triangles of a mesh at a cursor
+	static void WriteVertex(MESH_CURSOR& cursor, const glm::vec3& position, const glm::vec3& normal, const glm::vec2& uv);
+	static void WriteTriangle(MESH_CURSOR& cursor, GLuint a, GLuint b, GLuint c);
+	static void WriteQuadFace(MESH_CURSOR& cursor, const glm::vec3& origin,
+		const glm::vec3& uEdge, const glm::vec3& vEdge, int divisions);
+	static void WriteTriangleFace(MESH_CURSOR& cursor, const glm::vec3 corners[3],
+		const glm::vec2 uvs[3], int divisions);
+
+	// split a full float mesh of the arena into meshlets
+	void BuildArenaMeshlets(GLMesh& mesh);
+	// send the meshlet arrays to their storage, or free it
+	void UploadMeshletStorage();
+	void ReleaseMeshletStorage();
+	BufferAllocator::RANGE GetMeshletRange(int array) const;
+
+	// append a mesh built elsewhere to the shared vertex and index buffers
+	void AddMeshToArena(
+		GLMesh& mesh,
+		const char* name,
+		const GLfloat* pVertexData,
+		size_t floatCount,
+		const GLuint* pIndices,
+		size_t indexCount);
 };
\ No newline at end of file
@@ -0,0 +1,328 @@
+///////////////////////////////////////////////////////////////////////////////
+// shapetables.h
+// ============
+// vertex and index tables of the sphere and torus built at compile time
+//
+//  The writers lay out a sphere or torus tessellation from tables of
+//  points around the unit circle. They are constexpr, so instantiating
+//  a table template runs them in the compiler and leaves the result in
+//  read only data, while ShapeMeshes calls the same writers at run time
+//  for the tessellations no table is instantiated for.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+namespace ShapeTables
+{
+	// floats of one interleaved vertex: position, normal, UV
+	const int TABLE_VERTEX_FLOATS = 8;
+
+	/***********************************************************
+	 *  TableSin()
+	 *
+	 *  This function is used for the sine of an angle in the
+	 *  compiler, which cannot call sin(): the angle is brought
+	 *  into [-pi, pi] and its Taylor series summed until the
+	 *  terms no longer change a double.
+	 ***********************************************************/
+	constexpr double TableSin(double angle)
+	{
+		const double pi = 3.14159265358979323846;
+		while (angle > pi)
+		{
+			angle -= 2.0 * pi;
+		}
+		while (angle < -pi)
+		{
+			angle += 2.0 * pi;
+		}
+		double term = angle;
+		double sum = angle;
+		for (int n = 1; n < 20; n++)
+		{
+			term *= -angle * angle / (double)((2 * n) * (2 * n + 1));
+			sum += term;
+		}
+		return(sum);
+	}
+	constexpr double TableCos(double angle)
+	{
+		return(TableSin(angle + 1.57079632679489661923));
+	}
+
+	/***********************************************************
+	 *  WriteUnitCircle()
+	 *
+	 *  This function is used for writing the cosine and sine
+	 *  of each of segments steps around a circle, and one more
+	 *  copying the first, as the x, y pairs the writers read.
+	 ***********************************************************/
+	constexpr void WriteUnitCircle(int segments, float* pCircle)
+	{
+		for (int i = 0; i < segments; i++)
+		{
+			double angle = 2.0 * 3.14159265358979323846 * (double)i / (double)segments;
+			pCircle[2 * i] = (float)TableCos(angle);
+			pCircle[2 * i + 1] = (float)TableSin(angle);
+		}
+		pCircle[2 * segments] = pCircle[0];
+		pCircle[2 * segments + 1] = pCircle[1];
+	}
+
+	/***********************************************************
+	 *  WriteTableVertex()
+	 *
+	 *  This function is used for writing one interleaved vertex.
+	 ***********************************************************/
+	constexpr void WriteTableVertex(
+		float* pVertex,
+		float x, float y, float z,
+		float nx, float ny, float nz,
+		float u, float v)
+	{
+		pVertex[0] = x;
+		pVertex[1] = y;
+		pVertex[2] = z;
+		pVertex[3] = nx;
+		pVertex[4] = ny;
+		pVertex[5] = nz;
+		pVertex[6] = u;
+		pVertex[7] = v;
+	}
+
+	// vertices and indices of a sphere of bands from pole to pole
+	// and slices around, and of a torus grid
+	constexpr int SphereVertexCount(int bands, int slices) { return(2 + (bands - 1) * (slices + 1)); }
+	constexpr int SphereIndexCount(int bands, int slices) { return(6 * slices * (bands - 1)); }
+	constexpr int TorusVertexCount(int mainSegments, int tubeSegments) { return((mainSegments + 1) * (tubeSegments + 1)); }
+	constexpr int TorusIndexCount(int mainSegments, int tubeSegments) { return(6 * mainSegments * tubeSegments); }
+
+	/***********************************************************
+	 *  WriteSphereVertices()
+	 *
+	 *  This function is used for writing the vertices of a unit
+	 *  sphere, both counts even, from the unit circles of
+	 *  2 * bands and of slices steps: the top pole, one ring per
+	 *  band boundary, then the bottom pole. Each ring holds
+	 *  slices 0 to slices / 2 and a second copy of the seam
+	 *  slice starting the other half, so u narrows toward the
+	 *  poles without wrapping.
+	 ***********************************************************/
+	constexpr void WriteSphereVertices(
+		int bands,
+		int slices,
+		const float* pBandCircle,
+		const float* pSliceCircle,
+		float* pVertices)
+	{
+		const int halfSlices = slices / 2;
+		const int ringVertices = slices + 1;
+
+		WriteTableVertex(pVertices, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.5f, 1.0f);
+		float* pVertex = pVertices + TABLE_VERTEX_FLOATS;
+		for (int ring = 1; ring < bands; ring++)
+		{
+			float y = pBandCircle[2 * ring];
+			float radius = pBandCircle[2 * ring + 1];
+			float v = 1.0f - (float)ring / (float)bands;
+			for (int k = 0; k < ringVertices; k++)
+			{
+				int slice = (k <= halfSlices) ? k : (k - 1);
+				float halfTurns = (float)slice / (float)halfSlices;
+				if (k > halfSlices)
+				{
+					halfTurns -= 2.0f;
+				}
+				float x = radius * pSliceCircle[2 * slice + 1];
+				float z = radius * pSliceCircle[2 * slice];
+				WriteTableVertex(pVertex, x, y, z, x, y, z, 0.5f + 0.5f * radius * halfTurns, v);
+				pVertex += TABLE_VERTEX_FLOATS;
+			}
+		}
+		WriteTableVertex(pVertex, 0.0f, -1.0f, 0.0f, 0.0f, -1.0f, 0.0f, 0.5f, 0.0f);
+	}
+
+	/***********************************************************
+	 *  WriteSphereIndices()
+	 *
+	 *  This function is used for writing the triangles of the
+	 *  sphere from the top pole down, so the first half of the
+	 *  indices is the upper hemisphere. Every triangle winds
+	 *  counterclockwise seen from outside, and the edges past
+	 *  the seam start on its second copy.
+	 ***********************************************************/
+	constexpr void WriteSphereIndices(int bands, int slices, GLuint* pIndices)
+	{
+		const int halfSlices = slices / 2;
+		const int ringVertices = slices + 1;
+		const GLuint bottomIndex = (GLuint)(1 + (bands - 1) * ringVertices);
+
+		GLuint* pIndex = pIndices;
+		for (int ring = 0; ring < bands; ring++)
+		{
+			for (int slice = 0; slice < slices; slice++)
+			{
+				// vertex starting and ending the edge of the slice
+				// on the ring above and below the band
+				int startK = (slice < halfSlices) ? slice : (slice + 1);
+				int next = slice + 1;
+				int endK = (next <= halfSlices) ? next : ((next == slices) ? 0 : (next + 1));
+				GLuint upperStart = (GLuint)(1 + (ring - 1) * ringVertices + startK);
+				GLuint upperEnd = (GLuint)(1 + (ring - 1) * ringVertices + endK);
+				GLuint lowerStart = (GLuint)(1 + ring * ringVertices + startK);
+				GLuint lowerEnd = (GLuint)(1 + ring * ringVertices + endK);
+
+				if (ring == 0)
+				{
+					pIndex[0] = 0;
+					pIndex[1] = lowerStart;
+					pIndex[2] = lowerEnd;
+					pIndex += 3;
+				}
+				else if (ring == bands - 1)
+				{
+					pIndex[0] = upperStart;
+					pIndex[1] = bottomIndex;
+					pIndex[2] = upperEnd;
+					pIndex += 3;
+				}
+				else
+				{
+					pIndex[0] = upperStart;
+					pIndex[1] = lowerStart;
+					pIndex[2] = upperEnd;
+					pIndex[3] = upperEnd;
+					pIndex[4] = lowerStart;
+					pIndex[5] = lowerEnd;
+					pIndex += 6;
+				}
+			}
+		}
+	}
+
+	/***********************************************************
+	 *  WriteTorusVertices()
+	 *
+	 *  This function is used for writing the vertices of a
+	 *  torus around the z axis, its ring of radius 1 and its
+	 *  tube of radius tubeRadius, as a grid of shared vertices
+	 *  closing on copies of the first row and column for the
+	 *  texture seams.
+	 ***********************************************************/
+	constexpr void WriteTorusVertices(
+		int mainSegments,
+		int tubeSegments,
+		float tubeRadius,
+		const float* pMainCircle,
+		const float* pTubeCircle,
+		float* pVertices)
+	{
+		float* pVertex = pVertices;
+		for (int i = 0; i <= mainSegments; i++)
+		{
+			float ringX = pMainCircle[2 * i];
+			float ringY = pMainCircle[2 * i + 1];
+			for (int j = 0; j <= tubeSegments; j++)
+			{
+				float nx = ringX * pTubeCircle[2 * j];
+				float ny = ringY * pTubeCircle[2 * j];
+				float nz = pTubeCircle[2 * j + 1];
+				WriteTableVertex(pVertex, ringX + nx * tubeRadius, ringY + ny * tubeRadius, nz * tubeRadius,
+					nx, ny, nz, (float)i / (float)mainSegments, (float)j / (float)tubeSegments);
+				pVertex += TABLE_VERTEX_FLOATS;
+			}
+		}
+	}
+
+	/***********************************************************
+	 *  WriteTorusIndices()
+	 *
+	 *  This function is used for writing the triangles of the
+	 *  torus segment by segment around the ring, so the first
+	 *  half of the indices is the half torus above y = 0.
+	 ***********************************************************/
+	constexpr void WriteTorusIndices(int mainSegments, int tubeSegments, GLuint* pIndices)
+	{
+		const GLuint rowVertices = (GLuint)tubeSegments + 1;
+		GLuint* pIndex = pIndices;
+		for (GLuint i = 0; i < (GLuint)mainSegments; i++)
+		{
+			for (GLuint j = 0; j < (GLuint)tubeSegments; j++)
+			{
+				GLuint corner = i * rowVertices + j;
+				pIndex[0] = corner;
+				pIndex[1] = corner + rowVertices;
+				pIndex[2] = corner + rowVertices + 1;
+				pIndex[3] = corner;
+				pIndex[4] = corner + rowVertices + 1;
+				pIndex[5] = corner + 1;
+				pIndex += 6;
+			}
+		}
+	}
+
+	// a sphere tessellation built in the compiler
+	template <int BANDS, int SLICES>
+	struct SPHERE_TABLE
+	{
+		float vertices[SphereVertexCount(BANDS, SLICES) * TABLE_VERTEX_FLOATS];
+		GLuint indices[SphereIndexCount(BANDS, SLICES)];
+	};
+
+	// a torus tessellation built in the compiler with a tube of
+	// radius 0, so its positions are the points of the ring and a
+	// tube of any thickness adds the normal scaled by its radius
+	template <int MAIN_SEGMENTS, int TUBE_SEGMENTS>
+	struct TORUS_TABLE
+	{
+		float vertices[TorusVertexCount(MAIN_SEGMENTS, TUBE_SEGMENTS) * TABLE_VERTEX_FLOATS];
+		GLuint indices[TorusIndexCount(MAIN_SEGMENTS, TUBE_SEGMENTS)];
+	};
+
+	/***********************************************************
+	 *  MakeSphereTable()
+	 *
+	 *  This function is used for building a sphere table, with
+	 *  its unit circles, meant to initialize a constexpr
+	 *  variable so it runs in the compiler.
+	 ***********************************************************/
+	template <int BANDS, int SLICES>
+	constexpr SPHERE_TABLE<BANDS, SLICES> MakeSphereTable()
+	{
+		static_assert((BANDS >= 2) && (BANDS % 2 == 0) && (SLICES >= 4) && (SLICES % 2 == 0),
+			"sphere tables need even counts of at least 2 bands and 4 slices");
+		float bandCircle[2 * (2 * BANDS + 1)] = {};
+		float sliceCircle[2 * (SLICES + 1)] = {};
+		WriteUnitCircle(2 * BANDS, bandCircle);
+		WriteUnitCircle(SLICES, sliceCircle);
+
+		SPHERE_TABLE<BANDS, SLICES> table = {};
+		WriteSphereVertices(BANDS, SLICES, bandCircle, sliceCircle, table.vertices);
+		WriteSphereIndices(BANDS, SLICES, table.indices);
+		return(table);
+	}
+
+	/***********************************************************
+	 *  MakeTorusTable()
+	 *
+	 *  This function is used for building a torus table of tube
+	 *  radius 0, meant to initialize a constexpr variable.
+	 ***********************************************************/
+	template <int MAIN_SEGMENTS, int TUBE_SEGMENTS>
+	constexpr TORUS_TABLE<MAIN_SEGMENTS, TUBE_SEGMENTS> MakeTorusTable()
+	{
+		static_assert((MAIN_SEGMENTS >= 3) && (TUBE_SEGMENTS >= 3),
+			"torus tables need at least 3 segments each way");
+		float mainCircle[2 * (MAIN_SEGMENTS + 1)] = {};
+		float tubeCircle[2 * (TUBE_SEGMENTS + 1)] = {};
+		WriteUnitCircle(MAIN_SEGMENTS, mainCircle);
+		WriteUnitCircle(TUBE_SEGMENTS, tubeCircle);
+
+		TORUS_TABLE<MAIN_SEGMENTS, TUBE_SEGMENTS> table = {};
+		WriteTorusVertices(MAIN_SEGMENTS, TUBE_SEGMENTS, 0.0f, mainCircle, tubeCircle, table.vertices);
+		WriteTorusIndices(MAIN_SEGMENTS, TUBE_SEGMENTS, table.indices);
+		return(table);
+	}
+}
@@ -0,0 +1,158 @@
+#define GLM_FORCE_INLINE
+#include <glm/ext/matrix_float4x4.hpp>
+#include <glm/ext/matrix_transform.hpp>
+#include <glm/ext/matrix_clip_space.hpp>
+#include <glm/ext/matrix_relational.hpp>
+#include <glm/ext/vector_float3.hpp>
+#include <glm/matrix.hpp>
+#if GLM_CONFIG_SIMD == GLM_ENABLE
+#include <glm/gtc/type_aligned.hpp>
+#endif
+#include <vector>
+#include <chrono>
+#include <cstdio>
+
+// Times the functions a renderer builds its transforms with, on packed
+// matrices and, when the configuration enables SIMD, on aligned ones.
+// Build the tests once per GLM_TEST_ENABLE_SIMD_* option to compare the
+// configurations; the packed column is the scalar code of each one.
+
+// the vector of the qualifier of a matrix type, which the transform
+// functions take their vectors in
+template <typename matType>
+struct vec3_of;
+
+template <typename T, glm::qualifier Q>
+struct vec3_of<glm::mat<4, 4, T, Q> >
+{
+	typedef glm::vec<3, T, Q> type;
+};
+
+enum operation
+{
+	OPERATION_TRANSLATE,
+	OPERATION_ROTATE,
+	OPERATION_SCALE,
+	OPERATION_MUL,
+	OPERATION_INVERSE,
+	OPERATION_PERSPECTIVE,
+	OPERATION_COUNT
+};
+
+static char const* const OperationNames[OPERATION_COUNT] =
+{
+	"translate",
+	"rotate",
+	"scale",
+	"mat4 * mat4",
+	"inverse",
+	"perspective"
+};
+
+template <typename matType>
+static void test_mat_transform(int Operation, std::vector<matType> const& I, std::vector<glm::vec3> const& V, std::vector<matType>& O)
+{
+	typedef typename matType::value_type T;
+	typedef typename vec3_of<matType>::type vecType;
+
+	std::size_t const n = I.size();
+	switch(Operation)
+	{
+	case OPERATION_TRANSLATE:
+		for(std::size_t i = 0; i < n; ++i)
+			O[i] = glm::translate(I[i], vecType(V[i]));
+		break;
+	case OPERATION_ROTATE:
+		for(std::size_t i = 0; i < n; ++i)
+			O[i] = glm::rotate(I[i], V[i].x, vecType(0.267f, 0.535f, 0.802f));
+		break;
+	case OPERATION_SCALE:
+		for(std::size_t i = 0; i < n; ++i)
+			O[i] = glm::scale(I[i], vecType(V[i]));
+		break;
+	case OPERATION_MUL:
+		for(std::size_t i = 0; i < n; ++i)
+			O[i] = I[i] * I[n - 1 - i];
+		break;
+	case OPERATION_INVERSE:
+		for(std::size_t i = 0; i < n; ++i)
+			O[i] = glm::inverse(I[i]);
+		break;
+	case OPERATION_PERSPECTIVE:
+		// perspective() only returns the default qualifier, so the
+		// aligned column times it with the conversion to aligned
+		for(std::size_t i = 0; i < n; ++i)
+			O[i] = matType(glm::perspective(static_cast<T>(0.5) + V[i].z * static_cast<T>(0.1), static_cast<T>(16) / static_cast<T>(9), static_cast<T>(0.1), static_cast<T>(100)));
+		break;
+	}
+}
+
+template <typename matType>
+static int launch_mat_transform(int Operation, std::vector<matType>& O, std::size_t Samples)
+{
+	typedef typename matType::value_type T;
+	typedef typename vec3_of<matType>::type vecType;
+
+	std::vector<matType> I(Samples);
+	std::vector<glm::vec3> V(Samples);
+	O.resize(Samples);
+
+	// invertible transforms of translation, rotation and scale
+	for(std::size_t i = 0; i < Samples; ++i)
+	{
+		T const t = static_cast<T>(i % 1024) / static_cast<T>(1024);
+		V[i] = glm::vec3(t * 6.0f, 1.0f + t, 1.0f + t * 2.0f);
+		I[i] = glm::translate(glm::scale(glm::rotate(matType(1), t * static_cast<T>(6), vecType(0, 0, 1)), vecType(1.0f + t)), vecType(t, -t, t * 2.0f));
+	}
+
+	std::chrono::high_resolution_clock::time_point t1 = std::chrono::high_resolution_clock::now();
+	test_mat_transform<matType>(Operation, I, V, O);
+	std::chrono::high_resolution_clock::time_point t2 = std::chrono::high_resolution_clock::now();
+
+	return static_cast<int>(std::chrono::duration_cast<std::chrono::microseconds>(t2 - t1).count());
+}
+
+template <typename packedMatType, typename alignedMatType>
+static int comp_mat4_transform(int Operation, std::size_t Samples)
+{
+	typedef typename packedMatType::value_type T;
+
+	int Error = 0;
+
+	std::vector<packedMatType> SISD;
+	std::printf("%-12s - SISD: %6d us", OperationNames[Operation], launch_mat_transform<packedMatType>(Operation, SISD, Samples));
+
+#	if GLM_CONFIG_SIMD == GLM_ENABLE
+		std::vector<alignedMatType> SIMD;
+		std::printf(" - SIMD: %6d us", launch_mat_transform<alignedMatType>(Operation, SIMD, Samples));
+
+		for(std::size_t i = 0; i < Samples; ++i)
+		{
+			packedMatType const A = SISD[i];
+			packedMatType const B = packedMatType(SIMD[i]);
+			Error += glm::all(glm::equal(A, B, static_cast<T>(0.001))) ? 0 : 1;
+		}
+#	endif
+	std::printf("\n");
+
+	return Error;
+}
+
+int main()
+{
+	std::size_t const Samples = 100000;
+
+	int Error = 0;
+
+	std::printf("mat4 transforms, %s:\n", GLM_CONFIG_SIMD == GLM_ENABLE ? "SIMD" : "scalar");
+	for(int Operation = 0; Operation < OPERATION_COUNT; ++Operation)
+	{
+#		if GLM_CONFIG_SIMD == GLM_ENABLE
+			Error += comp_mat4_transform<glm::mat4, glm::aligned_mat4>(Operation, Samples);
+#		else
+			Error += comp_mat4_transform<glm::mat4, glm::mat4>(Operation, Samples);
+#		endif
+	}
+
+	return Error;
+}
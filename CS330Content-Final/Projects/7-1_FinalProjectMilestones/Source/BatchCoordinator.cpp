@@ -0,0 +1,618 @@
+///////////////////////////////////////////////////////////////////////////////
+// batchcoordinator.cpp
+// ============
+// the coordinator of a batch render shared by worker nodes
+//
+//  A camera path too long for one machine is split into shards of a
+//  few dozen poses, handed out to the workers connecting over TCP,
+//  which render them as a batch render would and send each image
+//  back, written here under its number in the path. A shard whose
+//  worker leaves, reports it failed or sends nothing for too long is
+//  handed out again, a few times at most. A worker is told the scene
+//  and the frame size when it connects, and fetches the asset pack
+//  only when its cache lacks this one, so each node reads the assets
+//  from a local pack it loads once, keeping the scene resident for
+//  all the shards it renders.
+//
+//  Messages are lines, some followed by a payload of the bytes they
+//  give. A worker sends hello <name>, fetch-pack, next, failed
+//  <shard> and image <number> <bytes> with the PNG file; it is sent
+//  welcome <width>x<height> <pack bytes> <pack hash> <scene>, pack
+//  <bytes> with the pack, shard <shard> <first image> <bytes> with
+//  the camera path of the shard, idle while every shard left is
+//  being rendered and finished once all are done.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "BatchCoordinator.h"
+#include "NetSocket.h"
+#include "Logger.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+namespace
+{
+	const uintptr_t NO_SOCKET = NetSocket::INVALID_HANDLE;
+
+	// longest the loop blocks on the sockets before checking the
+	// shards for timeouts
+	const long POLL_MICROSECONDS = 100000;
+	// times a shard is handed out before it is given up
+	const int MAX_SHARD_ATTEMPTS = 3;
+	// time a shard may go without an image before it is handed out
+	// again, which covers a worker still loading its scene
+	const double SHARD_TIMEOUT_SECONDS = 300.0;
+	// time between the progress lines, and the time the workers have
+	// to hear they are finished once every shard is settled
+	const double PROGRESS_SECONDS = 10.0;
+	const double FINISH_SECONDS = 10.0;
+	// longest line and largest image a worker may send
+	const size_t MAX_LINE_BYTES = 1024;
+	const size_t MAX_IMAGE_BYTES = (size_t)256 << 20;
+	// shortest time between the reports of the shards and workers
+	// that failed, which a farm losing its network reports at once
+	const int FAILURE_LOG_INTERVAL_MS = 1000;
+
+	double NowSeconds()
+	{
+		return(std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count());
+	}
+
+	/***********************************************************
+	 *  HashBytes()
+	 *
+	 *  This function is used for naming the pack in the caches
+	 *  of the workers, by the 64 bit FNV-1a hash of its bytes.
+	 ***********************************************************/
+	uint64_t HashBytes(const std::vector<unsigned char>& bytes)
+	{
+		uint64_t hash = 14695981039346656037ull;
+		for (size_t i = 0; i < bytes.size(); i++)
+		{
+			hash ^= bytes[i];
+			hash *= 1099511628211ull;
+		}
+		return(hash);
+	}
+}
+
+/***********************************************************
+ *  BatchCoordinator()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+BatchCoordinator::BatchCoordinator()
+{
+	m_nextWorkerId = 1;
+	m_shardPoses = DEFAULT_SHARD_POSES;
+	m_width = 0;
+	m_height = 0;
+	m_packHash = 0;
+	m_imagesWritten = 0;
+	m_shardsSettled = 0;
+}
+
+/***********************************************************
+ *  ~BatchCoordinator()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+BatchCoordinator::~BatchCoordinator()
+{
+	for (size_t i = 0; i < m_workers.size(); i++)
+	{
+		NetSocket::Close(m_workers[i].socketHandle);
+	}
+}
+
+/***********************************************************
+ *  Run()
+ *
+ *  This method is used for serving the shards until every
+ *  one is written or failed, then telling the workers still
+ *  asking that they are finished. The workers rendering a
+ *  shard again after a timeout may send images already
+ *  written, which are counted once.
+ ***********************************************************/
+bool BatchCoordinator::Run(const char* posesPath, const char* directory, int port, const char* scenePath,
+	const char* packPath, int width, int height, int shardPoses)
+{
+	m_directory = directory;
+	m_scenePath = scenePath;
+	m_width = width;
+	m_height = height;
+	m_shardPoses = std::max(shardPoses, 1);
+	if (LoadShards(posesPath, m_shardPoses) == false)
+	{
+		return(false);
+	}
+	if ((NULL != packPath) && (LoadPack(packPath) == false))
+	{
+		return(false);
+	}
+
+	if (NetSocket::Startup() == false)
+	{
+		LOG_ERROR("Could not start the sockets for the batch");
+		return(false);
+	}
+	uintptr_t listenSocket = NetSocket::Listen(port, false);
+	if (listenSocket == NO_SOCKET)
+	{
+		LOG_ERROR("Could not listen for batch workers on port %d", port);
+		NetSocket::Cleanup();
+		return(false);
+	}
+	size_t imageCount = m_shards.back().firstImage + m_shards.back().imageCount;
+	LOG_INFO("Coordinating %zu poses in %zu shards on port %d", imageCount, m_shards.size(), port);
+
+	double startTime = NowSeconds();
+	double progressTime = startTime;
+	double settledTime = -1.0;
+	std::vector<uintptr_t> sockets;
+	std::vector<bool> readable;
+	std::vector<unsigned char> buffer(64 * 1024);
+	while (true)
+	{
+		double now = NowSeconds();
+		if (m_shardsSettled == m_shards.size())
+		{
+			settledTime = (settledTime < 0.0) ? now : settledTime;
+			if ((m_workers.empty() == true) || (now - settledTime > FINISH_SECONDS))
+			{
+				break;
+			}
+		}
+
+		sockets.assign(1, listenSocket);
+		for (size_t i = 0; i < m_workers.size(); i++)
+		{
+			sockets.push_back(m_workers[i].socketHandle);
+		}
+		if (NetSocket::WaitReadable(sockets, POLL_MICROSECONDS, readable) == true)
+		{
+			// from the last, so a worker dropped does not move the
+			// ones still to be read
+			for (size_t i = m_workers.size(); i > 0; i--)
+			{
+				if (readable[i] == false)
+				{
+					continue;
+				}
+				WORKER& worker = m_workers[i - 1];
+				int bytes = NetSocket::Receive(worker.socketHandle, &buffer[0], buffer.size());
+				if (bytes <= 0)
+				{
+					DropWorker(i - 1, "disconnected");
+					continue;
+				}
+				worker.received.insert(worker.received.end(), buffer.begin(), buffer.begin() + bytes);
+				if (HandleMessages(worker) == false)
+				{
+					DropWorker(i - 1, "sent a malformed message");
+				}
+			}
+			if (readable[0] == true)
+			{
+				uintptr_t workerSocket = NetSocket::Accept(listenSocket);
+				if (workerSocket != NO_SOCKET)
+				{
+					WORKER worker;
+					worker.id = m_nextWorkerId++;
+					worker.socketHandle = workerSocket;
+					worker.name = "?";
+					worker.images = 0;
+					worker.connectTime = NowSeconds();
+					m_workers.push_back(worker);
+				}
+			}
+		}
+
+		// a shard without an image for too long goes to another
+		// worker, while its own may still finish it
+		now = NowSeconds();
+		for (size_t i = 0; i < m_shards.size(); i++)
+		{
+			SHARD& shard = m_shards[i];
+			if ((shard.workerId != 0) && (shard.bFailed == false) && (shard.receivedCount < shard.imageCount) &&
+				(now - shard.progressTime > SHARD_TIMEOUT_SECONDS))
+			{
+				ReleaseShard(i, "timed out");
+			}
+		}
+		if (now - progressTime >= PROGRESS_SECONDS)
+		{
+			PrintProgress(now - startTime);
+			progressTime = now;
+		}
+	}
+
+	while (m_workers.empty() == false)
+	{
+		DropWorker(m_workers.size() - 1, "finished");
+	}
+	NetSocket::Close(listenSocket);
+	NetSocket::Cleanup();
+
+	PrintProgress(NowSeconds() - startTime);
+	size_t failedShards = 0;
+	for (size_t i = 0; i < m_shards.size(); i++)
+	{
+		failedShards += (m_shards[i].bFailed == true) ? 1 : 0;
+	}
+	if (failedShards > 0)
+	{
+		LOG_ERROR("%zu shards failed", failedShards);
+	}
+	return((failedShards == 0) && (m_imagesWritten == imageCount));
+}
+
+/***********************************************************
+ *  LoadShards()
+ *
+ *  This method is used for splitting the steps of a camera
+ *  path into shards, each a path of its own. The keys of
+ *  the steps before a shard are replayed before its first
+ *  step, so it starts from the settings the whole path had
+ *  reached there.
+ ***********************************************************/
+bool BatchCoordinator::LoadShards(const char* posesPath, int shardPoses)
+{
+	std::ifstream file(posesPath);
+	if (!file)
+	{
+		LOG_ERROR("Could not open camera path %s", posesPath);
+		return(false);
+	}
+
+	std::vector<std::string> keyLines;
+	size_t keysWritten = 0;
+	size_t imageCount = 0;
+	std::string text;
+	while (std::getline(file, text))
+	{
+		size_t comment = text.find('#');
+		if (comment != std::string::npos)
+		{
+			text.erase(comment);
+		}
+		std::istringstream line(text);
+		std::string keyword;
+		line >> keyword;
+		if (keyword == "key")
+		{
+			keyLines.push_back(text);
+			continue;
+		}
+		if (keyword != "step")
+		{
+			continue;
+		}
+
+		if ((m_shards.empty() == true) || (m_shards.back().imageCount == (size_t)shardPoses))
+		{
+			SHARD shard;
+			shard.path = "# shard of ";
+			shard.path += posesPath;
+			shard.path += "\n";
+			shard.firstImage = imageCount;
+			shard.imageCount = 0;
+			shard.attempts = 0;
+			shard.workerId = 0;
+			shard.progressTime = 0.0;
+			shard.receivedCount = 0;
+			shard.bFailed = false;
+			m_shards.push_back(shard);
+			keysWritten = 0;
+		}
+		SHARD& shard = m_shards.back();
+		for (; keysWritten < keyLines.size(); keysWritten++)
+		{
+			shard.path += keyLines[keysWritten] + "\n";
+		}
+		shard.path += text + "\n";
+		shard.imageCount++;
+		imageCount++;
+	}
+
+	if (m_shards.empty() == true)
+	{
+		LOG_ERROR("%s: camera path has no steps", posesPath);
+		return(false);
+	}
+	for (size_t i = 0; i < m_shards.size(); i++)
+	{
+		m_shards[i].received.assign(m_shards[i].imageCount, false);
+	}
+	return(true);
+}
+
+/***********************************************************
+ *  LoadPack()
+ *
+ *  This method is used for reading the asset pack the
+ *  workers fetch, and hashing it.
+ ***********************************************************/
+bool BatchCoordinator::LoadPack(const char* packPath)
+{
+	FILE* file = fopen(packPath, "rb");
+	if (NULL == file)
+	{
+		LOG_ERROR("Could not open asset pack %s", packPath);
+		return(false);
+	}
+	fseek(file, 0, SEEK_END);
+	long size = ftell(file);
+	fseek(file, 0, SEEK_SET);
+	m_pack.resize((size > 0) ? (size_t)size : 0);
+	bool bRead = (m_pack.empty() == false) && (fread(&m_pack[0], 1, m_pack.size(), file) == m_pack.size());
+	fclose(file);
+	if (bRead == false)
+	{
+		LOG_ERROR("Could not read asset pack %s", packPath);
+		m_pack.clear();
+		return(false);
+	}
+	m_packHash = HashBytes(m_pack);
+	return(true);
+}
+
+/***********************************************************
+ *  HandleMessages()
+ *
+ *  This method is used for acting on every whole message a
+ *  worker sent; an image whose bytes have not all arrived
+ *  waits for the next read.
+ ***********************************************************/
+bool BatchCoordinator::HandleMessages(WORKER& worker)
+{
+	while (true)
+	{
+		std::vector<unsigned char>::iterator lineEnd = std::find(worker.received.begin(), worker.received.end(), '\n');
+		if (lineEnd == worker.received.end())
+		{
+			return(worker.received.size() <= MAX_LINE_BYTES);
+		}
+		size_t lineBytes = (size_t)(lineEnd - worker.received.begin());
+		if (lineBytes > MAX_LINE_BYTES)
+		{
+			return(false);
+		}
+		std::istringstream words(std::string(worker.received.begin(), lineEnd));
+		std::string command;
+		words >> command;
+
+		if (command == "image")
+		{
+			size_t number = 0;
+			size_t bytes = 0;
+			if (!(words >> number >> bytes) || (bytes > MAX_IMAGE_BYTES))
+			{
+				return(false);
+			}
+			if (worker.received.size() < lineBytes + 1 + bytes)
+			{
+				return(true);
+			}
+			if (ReceiveImage(worker, number, (bytes > 0) ? &worker.received[lineBytes + 1] : NULL, bytes) == false)
+			{
+				return(false);
+			}
+			worker.received.erase(worker.received.begin(), worker.received.begin() + lineBytes + 1 + bytes);
+			continue;
+		}
+		worker.received.erase(worker.received.begin(), worker.received.begin() + lineBytes + 1);
+
+		bool bSent = true;
+		if (command == "hello")
+		{
+			words >> worker.name;
+			char line[1024];
+			snprintf(line, sizeof(line), "welcome %dx%d %zu %016llx %s\n", m_width, m_height,
+				m_pack.size(), (unsigned long long)m_packHash, m_scenePath.c_str());
+			bSent = SendToWorker(worker, line, NULL, 0);
+			LOG_INFO("Batch worker %s connected", worker.name.c_str());
+		}
+		else if (command == "fetch-pack")
+		{
+			char line[64];
+			snprintf(line, sizeof(line), "pack %zu\n", m_pack.size());
+			bSent = SendToWorker(worker, line, m_pack.empty() ? NULL : &m_pack[0], m_pack.size());
+		}
+		else if (command == "next")
+		{
+			bSent = SendNextShard(worker);
+		}
+		else if (command == "failed")
+		{
+			size_t index = 0;
+			if (!(words >> index) || (index >= m_shards.size()))
+			{
+				return(false);
+			}
+			if (m_shards[index].workerId == worker.id)
+			{
+				ReleaseShard(index, "failed on its worker");
+			}
+		}
+		else if (command.empty() == false)
+		{
+			return(false);
+		}
+		if (bSent == false)
+		{
+			return(false);
+		}
+	}
+}
+
+/***********************************************************
+ *  SendNextShard()
+ *
+ *  This method is used for handing the oldest shard waiting
+ *  to a worker asking for one. While every shard left is
+ *  being rendered the worker is told to ask again, since a
+ *  shard may still come back; once all are settled it is
+ *  told it is finished.
+ ***********************************************************/
+bool BatchCoordinator::SendNextShard(WORKER& worker)
+{
+	if (m_shardsSettled == m_shards.size())
+	{
+		return(SendToWorker(worker, "finished\n", NULL, 0));
+	}
+	for (size_t i = 0; i < m_shards.size(); i++)
+	{
+		SHARD& shard = m_shards[i];
+		if ((shard.workerId != 0) || (shard.bFailed == true) || (shard.receivedCount == shard.imageCount))
+		{
+			continue;
+		}
+		shard.workerId = worker.id;
+		shard.attempts++;
+		shard.progressTime = NowSeconds();
+		char line[128];
+		snprintf(line, sizeof(line), "shard %zu %zu %zu\n", i, shard.firstImage, shard.path.size());
+		return(SendToWorker(worker, line, shard.path.data(), shard.path.size()));
+	}
+	return(SendToWorker(worker, "idle\n", NULL, 0));
+}
+
+/***********************************************************
+ *  ReceiveImage()
+ *
+ *  This method is used for writing an image under its
+ *  number, the first time it arrives. A shard is settled
+ *  with its last image; an image that cannot be written
+ *  leaves its shard to time out and be rendered again.
+ ***********************************************************/
+bool BatchCoordinator::ReceiveImage(WORKER& worker, size_t number, const unsigned char* pData, size_t size)
+{
+	size_t index = number / (size_t)m_shardPoses;
+	if (index >= m_shards.size())
+	{
+		return(false);
+	}
+	SHARD& shard = m_shards[index];
+	size_t step = number - shard.firstImage;
+	if (step >= shard.imageCount)
+	{
+		return(false);
+	}
+	worker.images++;
+	if (shard.workerId == worker.id)
+	{
+		shard.progressTime = NowSeconds();
+	}
+	if ((shard.received[step] == true) || (shard.bFailed == true))
+	{
+		return(true);
+	}
+
+	char filename[1024];
+	snprintf(filename, sizeof(filename), "%s/%05zu.png", m_directory.c_str(), number);
+	FILE* file = fopen(filename, "wb");
+	bool bWritten = (NULL != file) && (fwrite(pData, 1, size, file) == size);
+	if (NULL != file)
+	{
+		bWritten = (fclose(file) == 0) && (bWritten == true);
+	}
+	if (bWritten == false)
+	{
+		LOG_WARNING_LIMITED(FAILURE_LOG_INTERVAL_MS, "Could not write batch image %s", filename);
+		return(true);
+	}
+
+	shard.received[step] = true;
+	shard.receivedCount++;
+	m_imagesWritten++;
+	if (shard.receivedCount == shard.imageCount)
+	{
+		m_shardsSettled++;
+	}
+	return(true);
+}
+
+/***********************************************************
+ *  ReleaseShard()
+ *
+ *  This method is used for taking a shard back from its
+ *  worker, to hand it out again, or to give it up once it
+ *  was handed out as often as allowed.
+ ***********************************************************/
+void BatchCoordinator::ReleaseShard(size_t index, const char* reason)
+{
+	SHARD& shard = m_shards[index];
+	if ((shard.bFailed == true) || (shard.receivedCount == shard.imageCount))
+	{
+		return;
+	}
+	shard.workerId = 0;
+	if (shard.attempts >= MAX_SHARD_ATTEMPTS)
+	{
+		shard.bFailed = true;
+		m_shardsSettled++;
+		LOG_WARNING_LIMITED(FAILURE_LOG_INTERVAL_MS, "Shard %zu %s, given up after %d attempts", index, reason,
+			shard.attempts);
+	}
+	else
+	{
+		LOG_WARNING_LIMITED(FAILURE_LOG_INTERVAL_MS, "Shard %zu %s, handed out again", index, reason);
+	}
+}
+
+/***********************************************************
+ *  DropWorker()
+ *
+ *  This method is used for closing a worker, handing the
+ *  shards it had not finished out again.
+ ***********************************************************/
+void BatchCoordinator::DropWorker(size_t index, const char* reason)
+{
+	WORKER& worker = m_workers[index];
+	double seconds = NowSeconds() - worker.connectTime;
+	LOG_WARNING_LIMITED(FAILURE_LOG_INTERVAL_MS, "Batch worker %s %s after %llu images, %.2f images per second",
+		worker.name.c_str(), reason, worker.images, (seconds > 0.0) ? (double)worker.images / seconds : 0.0);
+	NetSocket::Close(worker.socketHandle);
+	int workerId = worker.id;
+	m_workers.erase(m_workers.begin() + index);
+	for (size_t i = 0; i < m_shards.size(); i++)
+	{
+		if (m_shards[i].workerId == workerId)
+		{
+			ReleaseShard(i, "lost its worker");
+		}
+	}
+}
+
+/***********************************************************
+ *  SendToWorker()
+ *
+ *  This method is used for writing a message to a worker;
+ *  false when the connection failed.
+ ***********************************************************/
+bool BatchCoordinator::SendToWorker(const WORKER& worker, const std::string& line, const void* pPayload, size_t size)
+{
+	return((NetSocket::SendAll(worker.socketHandle, line.data(), line.size()) == true) &&
+		((NULL == pPayload) || (NetSocket::SendAll(worker.socketHandle, pPayload, size) == true)));
+}
+
+/***********************************************************
+ *  PrintProgress()
+ *
+ *  This method is used for printing the images written, the
+ *  shards settled and the rate so far.
+ ***********************************************************/
+void BatchCoordinator::PrintProgress(double seconds) const
+{
+	size_t imageCount = m_shards.back().firstImage + m_shards.back().imageCount;
+	std::cout << "batch images " << m_imagesWritten << " of " << imageCount
+		<< "\tshards " << m_shardsSettled << " of " << m_shards.size()
+		<< "\tworkers " << m_workers.size()
+		<< "\tseconds " << seconds
+		<< "\timages per second " << ((seconds > 0.0) ? (double)m_imagesWritten / seconds : 0.0) << std::endl;
+}
@@ -0,0 +1,119 @@
+///////////////////////////////////////////////////////////////////////////////
+// batchcoordinator.h
+// ============
+// the coordinator of a batch render shared by worker nodes
+//
+//  A camera path too long for one machine is split into shards of a
+//  few dozen poses, handed out to the workers connecting over TCP,
+//  which render them as a batch render would and send each image
+//  back, written here under its number in the path. A shard whose
+//  worker leaves, reports it failed or sends nothing for too long is
+//  handed out again, a few times at most. A worker is told the scene
+//  and the frame size when it connects, and fetches the asset pack
+//  only when its cache lacks this one, so each node reads the assets
+//  from a local pack it loads once, keeping the scene resident for
+//  all the shards it renders.
+//
+//  Messages are lines, some followed by a payload of the bytes they
+//  give. A worker sends hello <name>, fetch-pack, next, failed
+//  <shard> and image <number> <bytes> with the PNG file; it is sent
+//  welcome <width>x<height> <pack bytes> <pack hash> <scene>, pack
+//  <bytes> with the pack, shard <shard> <first image> <bytes> with
+//  the camera path of the shard, idle while every shard left is
+//  being rendered and finished once all are done.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/***********************************************************
+ *  BatchCoordinator
+ *
+ *  This class contains the shards of the path, the workers
+ *  connected and what they rendered. Run() serves them on
+ *  the calling thread until every shard is written or has
+ *  failed; it needs no GL context.
+ ***********************************************************/
+class BatchCoordinator
+{
+public:
+	// constructor
+	BatchCoordinator();
+	// destructor
+	~BatchCoordinator();
+
+	// poses in a shard unless given
+	static const int DEFAULT_SHARD_POSES = 64;
+
+	// split a camera path into shards of shardPoses poses and serve
+	// them on a TCP port, writing the images into the directory; the
+	// workers load the scene of the path and the pack, if any, and
+	// render at the size given. False when the path, the pack or the
+	// port cannot be opened, or a shard failed for good
+	bool Run(const char* posesPath, const char* directory, int port, const char* scenePath,
+		const char* packPath, int width, int height, int shardPoses);
+
+private:
+	// poses handed out together, as a camera path of their own
+	struct SHARD
+	{
+		std::string path;			// text of the camera path
+		size_t firstImage;
+		size_t imageCount;
+		int attempts;
+		int workerId;				// 0 while waiting for a worker
+		double progressTime;		// when it was handed out or last sent an image
+		std::vector<bool> received;
+		size_t receivedCount;
+		bool bFailed;
+	};
+	// a connected worker and what it sent so far
+	struct WORKER
+	{
+		int id;
+		uintptr_t socketHandle;
+		std::string name;
+		std::vector<unsigned char> received;
+		unsigned long long images;
+		double connectTime;
+	};
+
+	std::vector<SHARD> m_shards;
+	std::vector<WORKER> m_workers;
+	int m_nextWorkerId;
+	int m_shardPoses;
+	std::string m_directory;
+	std::string m_scenePath;
+	int m_width;
+	int m_height;
+	// the pack handed to the workers, and the hash naming it in their
+	// caches
+	std::vector<unsigned char> m_pack;
+	uint64_t m_packHash;
+	size_t m_imagesWritten;
+	size_t m_shardsSettled;
+
+	// split the path into shards; false when it holds no step
+	bool LoadShards(const char* posesPath, int shardPoses);
+	// read the pack into memory; false when it cannot be read
+	bool LoadPack(const char* packPath);
+	// act on the whole messages a worker sent; false when it sent
+	// something malformed and is dropped
+	bool HandleMessages(WORKER& worker);
+	// answer next with a shard waiting, with idle or with finished
+	bool SendNextShard(WORKER& worker);
+	// count an image, written once whichever worker sent it; false
+	// for a number outside the path
+	bool ReceiveImage(WORKER& worker, size_t number, const unsigned char* pData, size_t size);
+	// hand a shard out again, or give it up after its last attempt
+	void ReleaseShard(size_t index, const char* reason);
+	// close a worker and hand its shards out again
+	void DropWorker(size_t index, const char* reason);
+	// write a line, and a payload after it, to a worker
+	bool SendToWorker(const WORKER& worker, const std::string& line, const void* pPayload, size_t size);
+	void PrintProgress(double seconds) const;
+};
@@ -0,0 +1,412 @@
+///////////////////////////////////////////////////////////////////////////////
+// batchworker.cpp
+// ============
+// a worker node of a batch render shared through a coordinator
+//
+//  The worker connects to the coordinator before anything loads and
+//  is told the scene, the frame size and the asset pack; the pack is
+//  fetched into a cache directory only when no earlier run left it
+//  there, and mounted like any other. Once its scene is complete the
+//  worker asks for a shard, a camera path of a few dozen poses,
+//  plays it back one pose per frame as a batch render does and sends
+//  each image, encoded by the capture pipeline, back under its number
+//  in the whole path, asking for the next shard when the path ends.
+//  The protocol is described in BatchCoordinator.h.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "BatchWorker.h"
+#include "NetSocket.h"
+#include "Logger.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+
+namespace
+{
+	const uintptr_t NO_SOCKET = NetSocket::INVALID_HANDLE;
+
+	// longest wait for an answer of the coordinator, which answers
+	// at once but for the pack it may be sending another worker
+	const double READ_TIMEOUT_SECONDS = 120.0;
+	const long POLL_MICROSECONDS = 100000;
+	// longest line of the coordinator
+	const size_t MAX_LINE_BYTES = 4096;
+	// shortest time between the reports of shards that failed
+	const int FAILURE_LOG_INTERVAL_MS = 1000;
+
+	double NowSeconds()
+	{
+		return(std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count());
+	}
+
+	/***********************************************************
+	 *  GetFileSize()
+	 *
+	 *  This function is used for the size of a file, or -1
+	 *  when it cannot be opened.
+	 ***********************************************************/
+	long GetFileSize(const std::string& filename)
+	{
+		FILE* file = fopen(filename.c_str(), "rb");
+		if (NULL == file)
+		{
+			return(-1);
+		}
+		fseek(file, 0, SEEK_END);
+		long size = ftell(file);
+		fclose(file);
+		return(size);
+	}
+
+	/***********************************************************
+	 *  WriteFile()
+	 *
+	 *  This function is used for writing a whole file; false
+	 *  when any of it could not be written.
+	 ***********************************************************/
+	bool WriteFile(const std::string& filename, const void* pData, size_t size)
+	{
+		FILE* file = fopen(filename.c_str(), "wb");
+		if (NULL == file)
+		{
+			return(false);
+		}
+		bool bWritten = (size == 0) || (fwrite(pData, 1, size, file) == size);
+		return((fclose(file) == 0) && (bWritten == true));
+	}
+}
+
+/***********************************************************
+ *  BatchWorker()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+BatchWorker::BatchWorker()
+{
+	m_socketHandle = NO_SOCKET;
+	m_width = 0;
+	m_height = 0;
+	m_shardIndex = 0;
+	m_shardFirstImage = 0;
+	m_bFailed = false;
+	m_imagesSent = 0;
+}
+
+/***********************************************************
+ *  ~BatchWorker()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+BatchWorker::~BatchWorker()
+{
+	Close();
+}
+
+/***********************************************************
+ *  Connect()
+ *
+ *  This method is used for the handshake with the
+ *  coordinator, before the window and the scene, which
+ *  both depend on what it names.
+ ***********************************************************/
+bool BatchWorker::Connect(const char* address, const char* name, const char* cacheDirectory)
+{
+	std::string host = address;
+	size_t colon = host.find_last_of(':');
+	if (colon == std::string::npos)
+	{
+		LOG_ERROR("A batch coordinator is given as host:port, not %s", address);
+		return(false);
+	}
+	int port = atoi(host.c_str() + colon + 1);
+	host.erase(colon);
+
+	if (NetSocket::Startup() == false)
+	{
+		LOG_ERROR("Could not start the sockets for the batch");
+		return(false);
+	}
+	m_socketHandle = NetSocket::Connect(host.c_str(), port);
+	if (m_socketHandle == NO_SOCKET)
+	{
+		LOG_ERROR("Could not reach the batch coordinator at %s", address);
+		NetSocket::Cleanup();
+		return(false);
+	}
+	m_cacheDirectory = cacheDirectory;
+
+	std::string line;
+	std::string command;
+	std::string size;
+	size_t packBytes = 0;
+	std::string packHash;
+	if ((Send(std::string("hello ") + name + "\n", NULL, 0) == false) || (ReadLine(line) == false))
+	{
+		LOG_ERROR("The batch coordinator did not answer");
+		return(false);
+	}
+	std::istringstream words(line);
+	words >> command >> size >> packBytes >> packHash;
+	// the scene path is the rest of the line, and may hold spaces
+	std::getline(words >> std::ws, m_scenePath);
+	if ((command != "welcome") || (words.fail() == true) ||
+		(sscanf(size.c_str(), "%dx%d", &m_width, &m_height) != 2) || (m_width <= 0) || (m_height <= 0))
+	{
+		LOG_ERROR("Unexpected answer of the batch coordinator: %s", line.c_str());
+		return(false);
+	}
+	if ((packBytes > 0) && (FetchPack(packBytes, packHash) == false))
+	{
+		return(false);
+	}
+	LOG_INFO("Batch worker of %s rendering %s at %dx%d", address, m_scenePath.c_str(), m_width, m_height);
+	return(true);
+}
+
+/***********************************************************
+ *  FetchPack()
+ *
+ *  This method is used for taking the pack from the cache,
+ *  where it is named by its hash, or fetching it into the
+ *  cache. It is written under a temporary name and renamed,
+ *  so a run cut short leaves no partial pack to be taken.
+ ***********************************************************/
+bool BatchWorker::FetchPack(size_t packBytes, const std::string& packHash)
+{
+	m_packPath = m_cacheDirectory + "/" + packHash + ".pack";
+	if (GetFileSize(m_packPath) == (long)packBytes)
+	{
+		LOG_INFO("Asset pack %s taken from the cache", m_packPath.c_str());
+		return(true);
+	}
+
+	std::string line;
+	std::string command;
+	size_t bytes = 0;
+	std::vector<unsigned char> pack;
+	if ((Send("fetch-pack\n", NULL, 0) == false) || (ReadLine(line) == false))
+	{
+		return(false);
+	}
+	std::istringstream words(line);
+	words >> command >> bytes;
+	if ((command != "pack") || (bytes != packBytes) || (ReadBytes(bytes, pack) == false))
+	{
+		LOG_ERROR("Could not fetch the asset pack from the batch coordinator");
+		return(false);
+	}
+	std::string partPath = m_packPath + ".part";
+	remove(m_packPath.c_str());
+	if ((WriteFile(partPath, pack.data(), pack.size()) == false) ||
+		(rename(partPath.c_str(), m_packPath.c_str()) != 0))
+	{
+		LOG_ERROR("Could not write the asset pack %s", m_packPath.c_str());
+		remove(partPath.c_str());
+		return(false);
+	}
+	LOG_INFO("Asset pack fetched into %s", m_packPath.c_str());
+	return(true);
+}
+
+/***********************************************************
+ *  NextShard()
+ *
+ *  This method is used for asking the coordinator for a
+ *  shard and writing its camera path into the cache, where
+ *  it replaces the one of the shard before.
+ ***********************************************************/
+BatchWorker::SHARD_STATE BatchWorker::NextShard()
+{
+	std::string line;
+	if ((m_bFailed.load() == true) || (Send("next\n", NULL, 0) == false) || (ReadLine(line) == false))
+	{
+		return(SHARD_ERROR);
+	}
+	std::istringstream words(line);
+	std::string command;
+	words >> command;
+	if (command == "idle")
+	{
+		return(SHARD_IDLE);
+	}
+	if (command == "finished")
+	{
+		return(SHARD_FINISHED);
+	}
+
+	size_t bytes = 0;
+	std::vector<unsigned char> path;
+	if ((command != "shard") || !(words >> m_shardIndex >> m_shardFirstImage >> bytes) ||
+		(ReadBytes(bytes, path) == false))
+	{
+		LOG_WARNING_LIMITED(FAILURE_LOG_INTERVAL_MS, "Unexpected answer of the batch coordinator: %s", line.c_str());
+		return(SHARD_ERROR);
+	}
+	if (m_shardPath.empty() == false)
+	{
+		remove(m_shardPath.c_str());
+	}
+	char filename[64];
+	snprintf(filename, sizeof(filename), "/shard_%05zu.path", m_shardIndex);
+	m_shardPath = m_cacheDirectory + filename;
+	if (WriteFile(m_shardPath, path.data(), path.size()) == false)
+	{
+		LOG_WARNING_LIMITED(FAILURE_LOG_INTERVAL_MS, "Could not write the shard %s", m_shardPath.c_str());
+		FailShard();
+		return(SHARD_IDLE);
+	}
+	return(SHARD_READY);
+}
+
+/***********************************************************
+ *  FailShard()
+ *
+ *  This method is used for giving the shard back at once,
+ *  rather than letting it time out.
+ ***********************************************************/
+void BatchWorker::FailShard()
+{
+	char line[64];
+	snprintf(line, sizeof(line), "failed %zu\n", m_shardIndex);
+	Send(line, NULL, 0);
+}
+
+/***********************************************************
+ *  ImageSink()
+ *
+ *  This method is used for sending an encoded image to the
+ *  coordinator, on the encoder thread that encoded it.
+ ***********************************************************/
+void BatchWorker::ImageSink(void* pContext, const std::vector<unsigned char>& image,
+	int width, int height, uint32_t tag)
+{
+	BatchWorker* pWorker = (BatchWorker*)pContext;
+	char line[64];
+	snprintf(line, sizeof(line), "image %u %zu\n", tag, image.size());
+	if (pWorker->Send(line, image.empty() ? NULL : image.data(), image.size()) == true)
+	{
+		pWorker->m_imagesSent++;
+	}
+}
+
+/***********************************************************
+ *  Close()
+ *
+ *  This method is used for closing the connection and
+ *  removing the camera path of the last shard.
+ ***********************************************************/
+void BatchWorker::Close()
+{
+	if (m_socketHandle == NO_SOCKET)
+	{
+		return;
+	}
+	NetSocket::Close(m_socketHandle);
+	m_socketHandle = NO_SOCKET;
+	NetSocket::Cleanup();
+	if (m_shardPath.empty() == false)
+	{
+		remove(m_shardPath.c_str());
+		m_shardPath.clear();
+	}
+}
+
+/***********************************************************
+ *  ReadLine()
+ *
+ *  This method is used for reading a line of the
+ *  coordinator, without its end.
+ ***********************************************************/
+bool BatchWorker::ReadLine(std::string& line)
+{
+	double startTime = NowSeconds();
+	unsigned char buffer[4096];
+	while (true)
+	{
+		std::vector<unsigned char>::iterator lineEnd = std::find(m_received.begin(), m_received.end(), '\n');
+		if (lineEnd != m_received.end())
+		{
+			line.assign(m_received.begin(), lineEnd);
+			m_received.erase(m_received.begin(), lineEnd + 1);
+			return(true);
+		}
+		if ((m_received.size() > MAX_LINE_BYTES) || (NowSeconds() - startTime > READ_TIMEOUT_SECONDS))
+		{
+			m_bFailed = true;
+			return(false);
+		}
+		if (NetSocket::WaitReadable(m_socketHandle, POLL_MICROSECONDS) == false)
+		{
+			continue;
+		}
+		int bytes = NetSocket::Receive(m_socketHandle, buffer, sizeof(buffer));
+		if (bytes <= 0)
+		{
+			m_bFailed = true;
+			return(false);
+		}
+		m_received.insert(m_received.end(), buffer, buffer + bytes);
+	}
+}
+
+/***********************************************************
+ *  ReadBytes()
+ *
+ *  This method is used for reading the payload after a
+ *  line, the wait starting over while bytes keep coming.
+ ***********************************************************/
+bool BatchWorker::ReadBytes(size_t size, std::vector<unsigned char>& bytes)
+{
+	double progressTime = NowSeconds();
+	std::vector<unsigned char> buffer(64 * 1024);
+	while (m_received.size() < size)
+	{
+		if (NowSeconds() - progressTime > READ_TIMEOUT_SECONDS)
+		{
+			m_bFailed = true;
+			return(false);
+		}
+		if (NetSocket::WaitReadable(m_socketHandle, POLL_MICROSECONDS) == false)
+		{
+			continue;
+		}
+		int received = NetSocket::Receive(m_socketHandle, &buffer[0], buffer.size());
+		if (received <= 0)
+		{
+			m_bFailed = true;
+			return(false);
+		}
+		m_received.insert(m_received.end(), buffer.begin(), buffer.begin() + received);
+		progressTime = NowSeconds();
+	}
+	bytes.assign(m_received.begin(), m_received.begin() + size);
+	m_received.erase(m_received.begin(), m_received.begin() + size);
+	return(true);
+}
+
+/***********************************************************
+ *  Send()
+ *
+ *  This method is used for sending a line and its payload
+ *  as one message, from any thread; a failed send marks the
+ *  coordinator gone.
+ ***********************************************************/
+bool BatchWorker::Send(const std::string& line, const void* pPayload, size_t size)
+{
+	std::lock_guard<std::mutex> lock(m_sendMutex);
+	if ((m_socketHandle == NO_SOCKET) || (m_bFailed.load() == true))
+	{
+		return(false);
+	}
+	bool bSent = (NetSocket::SendAll(m_socketHandle, line.data(), line.size()) == true) &&
+		((NULL == pPayload) || (NetSocket::SendAll(m_socketHandle, pPayload, size) == true));
+	if (bSent == false)
+	{
+		m_bFailed = true;
+	}
+	return(bSent);
+}
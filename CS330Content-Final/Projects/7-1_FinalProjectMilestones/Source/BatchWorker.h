@@ -0,0 +1,102 @@
+///////////////////////////////////////////////////////////////////////////////
+// batchworker.h
+// ============
+// a worker node of a batch render shared through a coordinator
+//
+//  The worker connects to the coordinator before anything loads and
+//  is told the scene, the frame size and the asset pack; the pack is
+//  fetched into a cache directory only when no earlier run left it
+//  there, and mounted like any other. Once its scene is complete the
+//  worker asks for a shard, a camera path of a few dozen poses,
+//  plays it back one pose per frame as a batch render does and sends
+//  each image, encoded by the capture pipeline, back under its number
+//  in the whole path, asking for the next shard when the path ends.
+//  The protocol is described in BatchCoordinator.h.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/***********************************************************
+ *  BatchWorker
+ *
+ *  This class contains the connection to the coordinator,
+ *  what it named at the handshake and the shard being
+ *  rendered. The main thread asks for the shards; the
+ *  encoder threads send the images through ImageSink().
+ ***********************************************************/
+class BatchWorker
+{
+public:
+	// constructor
+	BatchWorker();
+	// destructor
+	~BatchWorker();
+
+	// the answer to asking for a shard
+	enum SHARD_STATE
+	{
+		SHARD_READY = 0,		// a shard to render, in GetShardPath()
+		SHARD_IDLE,				// none now, ask again later
+		SHARD_FINISHED,			// the batch is done
+		SHARD_ERROR				// the coordinator is gone
+	};
+
+	// connect to the coordinator at host:port, take the scene and
+	// the frame size and fetch the pack into the cache directory if
+	// it is not there; false when any of it fails
+	bool Connect(const char* address, const char* name, const char* cacheDirectory);
+	const std::string& GetScenePath() const { return(m_scenePath); }
+	int GetWidth() const { return(m_width); }
+	int GetHeight() const { return(m_height); }
+	// the pack in the cache, empty when the coordinator has none
+	const std::string& GetPackPath() const { return(m_packPath); }
+
+	// ask for the next shard, written as a camera path file
+	SHARD_STATE NextShard();
+	const std::string& GetShardPath() const { return(m_shardPath); }
+	// number of the image of the first pose of the shard
+	size_t GetShardFirstImage() const { return(m_shardFirstImage); }
+	// report the shard could not be played, to be handed out again
+	void FailShard();
+
+	// FrameCapture::FrameSink sending the image numbered by the tag
+	// for the worker of pContext
+	static void ImageSink(void* pContext, const std::vector<unsigned char>& image,
+		int width, int height, uint32_t tag);
+	unsigned long long GetImagesSent() const { return(m_imagesSent.load()); }
+
+	// close the connection, after the last image was handed on
+	void Close();
+
+private:
+	uintptr_t m_socketHandle;
+	// bytes received past the last message read
+	std::vector<unsigned char> m_received;
+	std::string m_cacheDirectory;
+	std::string m_scenePath;
+	std::string m_packPath;
+	int m_width;
+	int m_height;
+	size_t m_shardIndex;
+	size_t m_shardFirstImage;
+	std::string m_shardPath;
+	// keeps the messages of the threads whole
+	std::mutex m_sendMutex;
+	std::atomic<bool> m_bFailed;
+	std::atomic<unsigned long long> m_imagesSent;
+
+	// read the next line, or the bytes of a payload, waiting for
+	// them a while; false when the connection failed
+	bool ReadLine(std::string& line);
+	bool ReadBytes(size_t size, std::vector<unsigned char>& bytes);
+	bool Send(const std::string& line, const void* pPayload, size_t size);
+	// take the pack from the cache, or fetch it into it
+	bool FetchPack(size_t packBytes, const std::string& packHash);
+};
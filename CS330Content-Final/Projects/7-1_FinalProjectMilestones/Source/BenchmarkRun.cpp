@@ -0,0 +1,365 @@
+///////////////////////////////////////////////////////////////////////////////
+// benchmarkrun.cpp
+// ============
+// frame time percentiles of a played back camera path, for release runs
+//
+//  A benchmark run waits for the whole scene, renders a number of
+//  warm-up frames at the starting view, then plays a recorded camera
+//  path and keeps the frame interval, the CPU time and the GPU time of
+//  every frame along it, with the render counters. The report gives
+//  their mean, median, 95th and 99th percentile and maximum, since an
+//  average alone hides the hitches, along with the machine and driver
+//  the run was made on, as JSON or CSV for comparing runs.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "BenchmarkRun.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+namespace
+{
+	// names of the times in the report
+	const char* const TIME_NAMES[BenchmarkRun::TIME_COUNT] =
+	{
+		"frame-ms",
+		"cpu-ms",
+		"gpu-ms"
+	};
+
+	// write a string as a JSON string literal
+	void WriteJSONString(FILE* file, const char* text)
+	{
+		fputc('"', file);
+		for (const char* c = text; *c != '\0'; c++)
+		{
+			if ((*c == '"') || (*c == '\\'))
+			{
+				fputc('\\', file);
+				fputc(*c, file);
+			}
+			else if ((unsigned char)*c >= 0x20)
+			{
+				fputc(*c, file);
+			}
+		}
+		fputc('"', file);
+	}
+
+	// write a summary as the members of a JSON object
+	void WriteJSONSummary(FILE* file, const BenchmarkRun::SAMPLE_SUMMARY& summary)
+	{
+		fprintf(file, "{\"samples\":%llu,\"mean\":%.4f,\"p50\":%.4f,\"p95\":%.4f,\"p99\":%.4f,\"max\":%.4f}",
+			(unsigned long long)summary.samples, summary.mean, summary.p50, summary.p95, summary.p99, summary.maximum);
+	}
+
+	// write a summary as a row of the CSV report
+	void WriteCSVSummary(FILE* file, const char* name, const BenchmarkRun::SAMPLE_SUMMARY& summary)
+	{
+		fprintf(file, "%s,%llu,%.4f,%.4f,%.4f,%.4f,%.4f\n", name, (unsigned long long)summary.samples,
+			summary.mean, summary.p50, summary.p95, summary.p99, summary.maximum);
+	}
+}
+
+/***********************************************************
+ *  BenchmarkRun()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+BenchmarkRun::BenchmarkRun(RenderCounters* pRenderCounters, RenderTarget* pRenderTarget)
+{
+	m_pRenderCounters = pRenderCounters;
+	m_pRenderTarget = pRenderTarget;
+	m_warmupFrames = DEFAULT_WARMUP_FRAMES;
+	m_measuredFrames = 0;
+	m_warmedUpFrames = 0;
+	m_bMeasuring = false;
+	m_framesMeasured = 0;
+	m_lastPresentSeconds = 0.0;
+}
+
+/***********************************************************
+ *  ~BenchmarkRun()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+BenchmarkRun::~BenchmarkRun()
+{
+	m_pRenderTarget->SetGPUSampling(false);
+}
+
+/***********************************************************
+ *  GetTimeName()
+ *
+ *  This method is used for getting the name of a time.
+ ***********************************************************/
+const char* BenchmarkRun::GetTimeName(int time)
+{
+	if ((time < 0) || (time >= TIME_COUNT))
+	{
+		return("unknown");
+	}
+	return(TIME_NAMES[time]);
+}
+
+/***********************************************************
+ *  WarmUp()
+ *
+ *  This method is used for counting a warm-up frame. After
+ *  the last one the GPU times start being kept, so the
+ *  frames of the path are measured from the next one on.
+ ***********************************************************/
+bool BenchmarkRun::WarmUp(double presentSeconds)
+{
+	if (m_bMeasuring == true)
+	{
+		return(false);
+	}
+
+	m_warmedUpFrames++;
+	if (m_warmedUpFrames < m_warmupFrames)
+	{
+		return(false);
+	}
+
+	m_bMeasuring = true;
+	m_lastPresentSeconds = presentSeconds;
+	m_pRenderTarget->SetGPUSampling(true);
+	return(true);
+}
+
+/***********************************************************
+ *  AddFrame()
+ *
+ *  This method is used for sampling a measured frame: its
+ *  interval from the last present, its CPU time and what it
+ *  added to every render counter. The GPU times read back
+ *  during it are those of earlier frames, so the first few
+ *  may still be of the warm-up, which renders the same
+ *  scene.
+ ***********************************************************/
+void BenchmarkRun::AddFrame(double cpuSeconds, double presentSeconds)
+{
+	if ((m_bMeasuring == false) || (IsComplete() == true))
+	{
+		return;
+	}
+
+	m_timeSamples[TIME_FRAME].push_back((presentSeconds - m_lastPresentSeconds) * 1000.0);
+	m_timeSamples[TIME_CPU].push_back(cpuSeconds * 1000.0);
+	m_lastPresentSeconds = presentSeconds;
+	for (int i = 0; i < RenderCounters::COUNTER_COUNT; i++)
+	{
+		m_counterSamples[i].push_back((double)m_pRenderCounters->GetLast(i));
+	}
+	TakeGPUSamples();
+	m_framesMeasured++;
+}
+
+/***********************************************************
+ *  IsComplete()
+ *
+ *  This method is used for checking whether the frames asked
+ *  for were measured; a run measuring the whole path is
+ *  ended by the path instead.
+ ***********************************************************/
+bool BenchmarkRun::IsComplete() const
+{
+	return((m_measuredFrames > 0) && (m_framesMeasured >= (unsigned long long)m_measuredFrames));
+}
+
+/***********************************************************
+ *  Finish()
+ *
+ *  This method is used for taking the GPU times read back
+ *  since the last measured frame and ending the sampling.
+ ***********************************************************/
+void BenchmarkRun::Finish()
+{
+	if (m_bMeasuring == true)
+	{
+		TakeGPUSamples();
+	}
+	m_pRenderTarget->SetGPUSampling(false);
+}
+
+/***********************************************************
+ *  TakeGPUSamples()
+ *
+ *  This method is used for moving the GPU times the target
+ *  read back into the samples.
+ ***********************************************************/
+void BenchmarkRun::TakeGPUSamples()
+{
+	m_gpuSamples.clear();
+	m_pRenderTarget->TakeGPUSamples(m_gpuSamples);
+	for (size_t i = 0; i < m_gpuSamples.size(); i++)
+	{
+		m_timeSamples[TIME_GPU].push_back((double)m_gpuSamples[i]);
+	}
+}
+
+/***********************************************************
+ *  Summarize()
+ *
+ *  This method is used for getting the mean, the maximum
+ *  and the nearest rank percentiles of samples.
+ ***********************************************************/
+BenchmarkRun::SAMPLE_SUMMARY BenchmarkRun::Summarize(const std::vector<double>& samples)
+{
+	SAMPLE_SUMMARY summary = {};
+	summary.samples = samples.size();
+	if (samples.empty() == true)
+	{
+		return(summary);
+	}
+
+	std::vector<double> sorted(samples);
+	std::sort(sorted.begin(), sorted.end());
+	double total = 0.0;
+	for (size_t i = 0; i < sorted.size(); i++)
+	{
+		total += sorted[i];
+	}
+
+	// the smallest sample with the share of the samples at or
+	// below it
+	const double percentiles[3] = { 0.50, 0.95, 0.99 };
+	double values[3];
+	for (int i = 0; i < 3; i++)
+	{
+		size_t rank = (size_t)std::ceil(percentiles[i] * (double)sorted.size());
+		values[i] = sorted[(rank > 0) ? rank - 1 : 0];
+	}
+
+	summary.mean = total / (double)sorted.size();
+	summary.p50 = values[0];
+	summary.p95 = values[1];
+	summary.p99 = values[2];
+	summary.maximum = sorted.back();
+	return(summary);
+}
+
+/***********************************************************
+ *  GetTimeSummary()
+ *
+ *  This method is used for summarizing a time, in
+ *  milliseconds, over the measured frames.
+ ***********************************************************/
+BenchmarkRun::SAMPLE_SUMMARY BenchmarkRun::GetTimeSummary(int time) const
+{
+	return(Summarize(m_timeSamples[time]));
+}
+
+/***********************************************************
+ *  GetCounterSummary()
+ *
+ *  This method is used for summarizing a render counter
+ *  over the measured frames.
+ ***********************************************************/
+BenchmarkRun::SAMPLE_SUMMARY BenchmarkRun::GetCounterSummary(int counter) const
+{
+	return(Summarize(m_counterSamples[counter]));
+}
+
+/***********************************************************
+ *  AddInfo()
+ *
+ *  This method is used for adding a line describing the
+ *  run to the report.
+ ***********************************************************/
+void BenchmarkRun::AddInfo(const char* key, const std::string& value)
+{
+	m_info.push_back(std::make_pair(std::string(key), value));
+}
+
+/***********************************************************
+ *  WriteReport()
+ *
+ *  This method is used for writing the description of the
+ *  run and the summaries of the times and the counters. The
+ *  CSV report has a row per time and counter, after the
+ *  description in comment lines.
+ ***********************************************************/
+bool BenchmarkRun::WriteReport(const char* filename) const
+{
+	FILE* file = fopen(filename, "wb");
+	if (file == NULL)
+	{
+		return(false);
+	}
+
+	size_t length = strlen(filename);
+	bool bCSV = (length >= 4) && (strcmp(filename + length - 4, ".csv") == 0);
+	if (bCSV == true)
+	{
+		for (size_t i = 0; i < m_info.size(); i++)
+		{
+			fprintf(file, "# %s: %s\n", m_info[i].first.c_str(), m_info[i].second.c_str());
+		}
+		fprintf(file, "# warmup frames: %d\n# measured frames: %llu\n", m_warmedUpFrames, m_framesMeasured);
+		fprintf(file, "metric,samples,mean,p50,p95,p99,max\n");
+		for (int i = 0; i < TIME_COUNT; i++)
+		{
+			WriteCSVSummary(file, TIME_NAMES[i], GetTimeSummary(i));
+		}
+		for (int i = 0; i < RenderCounters::COUNTER_COUNT; i++)
+		{
+			WriteCSVSummary(file, RenderCounters::GetCounterName(i), GetCounterSummary(i));
+		}
+	}
+	else
+	{
+		fprintf(file, "{\n\"info\":{");
+		for (size_t i = 0; i < m_info.size(); i++)
+		{
+			fprintf(file, "%s\n\t", (i > 0) ? "," : "");
+			WriteJSONString(file, m_info[i].first.c_str());
+			fputc(':', file);
+			WriteJSONString(file, m_info[i].second.c_str());
+		}
+		fprintf(file, "},\n\"warmupFrames\":%d,\n\"measuredFrames\":%llu,\n\"times\":{", m_warmedUpFrames, m_framesMeasured);
+		for (int i = 0; i < TIME_COUNT; i++)
+		{
+			fprintf(file, "%s\n\t\"%s\":", (i > 0) ? "," : "", TIME_NAMES[i]);
+			WriteJSONSummary(file, GetTimeSummary(i));
+		}
+		fprintf(file, "},\n\"counters\":{");
+		for (int i = 0; i < RenderCounters::COUNTER_COUNT; i++)
+		{
+			fprintf(file, "%s\n\t\"%s\":", (i > 0) ? "," : "", RenderCounters::GetCounterName(i));
+			WriteJSONSummary(file, GetCounterSummary(i));
+		}
+		fprintf(file, "}\n}\n");
+	}
+
+	bool bWritten = (ferror(file) == 0);
+	fclose(file);
+	return(bWritten);
+}
+
+/***********************************************************
+ *  Print()
+ *
+ *  This method is used for printing the measured frames and
+ *  the summaries of the times.
+ ***********************************************************/
+void BenchmarkRun::Print() const
+{
+	std::cout << "\n*** BENCHMARK: ***\n";
+	std::cout << "warmup frames " << m_warmedUpFrames
+		<< "\tmeasured frames " << m_framesMeasured << "\n";
+	for (int i = 0; i < TIME_COUNT; i++)
+	{
+		SAMPLE_SUMMARY summary = GetTimeSummary(i);
+		std::cout << TIME_NAMES[i]
+			<< "\tmean " << summary.mean
+			<< "\tp50 " << summary.p50
+			<< "\tp95 " << summary.p95
+			<< "\tp99 " << summary.p99
+			<< "\tmax " << summary.maximum << "\n";
+	}
+}
@@ -0,0 +1,113 @@
+///////////////////////////////////////////////////////////////////////////////
+// benchmarkrun.h
+// ============
+// frame time percentiles of a played back camera path, for release runs
+//
+//  A benchmark run waits for the whole scene, renders a number of
+//  warm-up frames at the starting view, then plays a recorded camera
+//  path and keeps the frame interval, the CPU time and the GPU time of
+//  every frame along it, with the render counters. The report gives
+//  their mean, median, 95th and 99th percentile and maximum, since an
+//  average alone hides the hitches, along with the machine and driver
+//  the run was made on, as JSON or CSV for comparing runs.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "RenderCounters.h"
+#include "RenderTarget.h"
+
+#include <string>
+#include <utility>
+#include <vector>
+
+/***********************************************************
+ *  BenchmarkRun
+ *
+ *  This class contains the state of a benchmark run and the
+ *  samples of its measured frames. WarmUp() counts the
+ *  frames before the measuring, and AddFrame() samples the
+ *  frames of the path.
+ ***********************************************************/
+class BenchmarkRun
+{
+public:
+	// constructor
+	BenchmarkRun(RenderCounters* pRenderCounters, RenderTarget* pRenderTarget);
+	// destructor
+	~BenchmarkRun();
+
+	// frames rendered at the starting view once the scene is complete
+	static const int DEFAULT_WARMUP_FRAMES = 120;
+
+	// times sampled for every measured frame
+	enum FRAME_TIME
+	{
+		TIME_FRAME = 0,		// present to present
+		TIME_CPU,			// frame start to the present call
+		TIME_GPU,			// the frame on the GPU, read back a few frames late
+		TIME_COUNT
+	};
+
+	// a time or a counter over the measured frames
+	struct SAMPLE_SUMMARY
+	{
+		size_t samples;
+		double mean;
+		double p50;
+		double p95;
+		double p99;
+		double maximum;
+	};
+
+	// frames of the warm-up, and frames measured along the path; 0
+	// measures the whole path
+	void SetWarmupFrames(int frames) { m_warmupFrames = frames; }
+	void SetMeasuredFrames(int frames) { m_measuredFrames = frames; }
+
+	// count a warm-up frame presented at the given time; true when
+	// it was the last, so the measuring starts with the next frame
+	bool WarmUp(double presentSeconds);
+	bool IsMeasuring() const { return(m_bMeasuring); }
+	// sample a measured frame
+	void AddFrame(double cpuSeconds, double presentSeconds);
+	// true once the frames asked for were measured
+	bool IsComplete() const;
+	// take the GPU times read back since the last frame and stop
+	// sampling them
+	void Finish();
+
+	unsigned long long GetFramesMeasured() const { return(m_framesMeasured); }
+	SAMPLE_SUMMARY GetTimeSummary(int time) const;
+	SAMPLE_SUMMARY GetCounterSummary(int counter) const;
+	static const char* GetTimeName(int time);
+
+	// describe the run, as the machine, driver and settings, in the
+	// order added
+	void AddInfo(const char* key, const std::string& value);
+	// write the report as CSV when the file name ends in .csv and
+	// as JSON otherwise; false when it cannot be written
+	bool WriteReport(const char* filename) const;
+	// print the times for the exit report
+	void Print() const;
+
+private:
+	// pointers to the counters and the target the GPU times come from
+	RenderCounters* m_pRenderCounters;
+	RenderTarget* m_pRenderTarget;
+	int m_warmupFrames;
+	int m_measuredFrames;
+	int m_warmedUpFrames;
+	bool m_bMeasuring;
+	unsigned long long m_framesMeasured;
+	double m_lastPresentSeconds;
+	// milliseconds of each time, and counts of each counter, per frame
+	std::vector<double> m_timeSamples[TIME_COUNT];
+	std::vector<double> m_counterSamples[RenderCounters::COUNTER_COUNT];
+	std::vector<float> m_gpuSamples;
+	std::vector<std::pair<std::string, std::string> > m_info;
+
+	// move the GPU times read back into the samples
+	void TakeGPUSamples();
+	static SAMPLE_SUMMARY Summarize(const std::vector<double>& samples);
+};
@@ -0,0 +1,257 @@
+///////////////////////////////////////////////////////////////////////////////
+// camerapath.cpp
+// ============
+// recorded camera path, played back for repeatable benchmark runs
+//
+//  Keeps the camera pose after every fixed simulation step along with
+//  the keys pressed before it. Played back one step per frame, the
+//  path renders the same frames on every run, however fast the
+//  machine is, so the frame timings of builds and machines compare.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "CameraPath.h"
+
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+namespace
+{
+	// digits that write a float and read back the same value
+	const int FLOAT_DIGITS = 9;
+}
+
+/***********************************************************
+ *  CameraPath()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+CameraPath::CameraPath()
+{
+	m_nextStep = 0;
+	m_bRecording = false;
+	m_bPlaying = false;
+	m_bFinished = false;
+}
+
+/***********************************************************
+ *  StartRecording()
+ *
+ *  This method is used for starting a new recording, which
+ *  also stops any playback.
+ ***********************************************************/
+void CameraPath::StartRecording()
+{
+	m_steps.clear();
+	m_keys.clear();
+	m_nextStep = 0;
+	m_bRecording = true;
+	m_bPlaying = false;
+	m_bFinished = false;
+}
+
+/***********************************************************
+ *  RecordKey()
+ *
+ *  This method is used for adding a key press to the
+ *  recording. It belongs to the step recorded next.
+ ***********************************************************/
+void CameraPath::RecordKey(int key)
+{
+	if (m_bRecording == true)
+	{
+		m_keys.push_back(key);
+	}
+}
+
+/***********************************************************
+ *  RecordStep()
+ *
+ *  This method is used for adding the camera pose after a
+ *  simulation step, together with the keys pressed since
+ *  the step before.
+ ***********************************************************/
+void CameraPath::RecordStep(const CAMERA_POSE& pose)
+{
+	if (m_bRecording == false)
+	{
+		return;
+	}
+
+	PATH_STEP step;
+	step.pose = pose;
+	step.firstKey = 0;
+	if (m_steps.empty() == false)
+	{
+		step.firstKey = m_steps.back().firstKey + m_steps.back().keyCount;
+	}
+	step.keyCount = m_keys.size() - step.firstKey;
+	m_steps.push_back(step);
+}
+
+/***********************************************************
+ *  Save()
+ *
+ *  This method is used for writing the recorded path as
+ *  text, one line per key press and per step, in the order
+ *  they are played back. The floats are written with every
+ *  digit they need, so the path reads back exactly.
+ ***********************************************************/
+bool CameraPath::Save(const char* filename) const
+{
+	std::ofstream file(filename);
+	if (!file)
+	{
+		std::cout << "Could not create camera path " << filename << std::endl;
+		return(false);
+	}
+
+	file << "# camera path, one step per simulation step\n";
+	file << "# key <glfw key code>\n";
+	file << "# step <position xyz> <front xyz> <up xyz> <yaw> <pitch> <zoom> <orthographic>\n";
+	file << std::setprecision(FLOAT_DIGITS);
+	for (size_t i = 0; i < m_steps.size(); i++)
+	{
+		const PATH_STEP& step = m_steps[i];
+		for (size_t k = 0; k < step.keyCount; k++)
+		{
+			file << "key " << m_keys[step.firstKey + k] << "\n";
+		}
+
+		const CAMERA_POSE& pose = step.pose;
+		file << "step "
+			<< pose.position.x << " " << pose.position.y << " " << pose.position.z << " "
+			<< pose.front.x << " " << pose.front.y << " " << pose.front.z << " "
+			<< pose.up.x << " " << pose.up.y << " " << pose.up.z << " "
+			<< pose.yaw << " " << pose.pitch << " " << pose.zoom << " "
+			<< ((pose.bOrthographic == true) ? 1 : 0) << "\n";
+	}
+
+	file.flush();
+	if (!file)
+	{
+		std::cout << "Could not write camera path " << filename << std::endl;
+		return(false);
+	}
+	return(true);
+}
+
+/***********************************************************
+ *  Load()
+ *
+ *  This method is used for reading a path written by Save()
+ *  and starting its playback. Anything after # is a
+ *  comment; a malformed line fails the whole path, since a
+ *  benchmark of a partly read path would not compare.
+ ***********************************************************/
+bool CameraPath::Load(const char* filename)
+{
+	m_steps.clear();
+	m_keys.clear();
+	m_nextStep = 0;
+	m_bRecording = false;
+	m_bPlaying = false;
+	m_bFinished = false;
+
+	std::ifstream file(filename);
+	if (!file)
+	{
+		std::cout << "Could not open camera path " << filename << std::endl;
+		return(false);
+	}
+
+	std::string text;
+	int lineNumber = 0;
+	size_t firstKey = 0;
+	while (std::getline(file, text))
+	{
+		lineNumber++;
+		size_t comment = text.find('#');
+		if (comment != std::string::npos)
+		{
+			text.erase(comment);
+		}
+
+		std::istringstream line(text);
+		std::string keyword;
+		if (!(line >> keyword))
+		{
+			continue;
+		}
+
+		bool bValid = false;
+		if (keyword == "key")
+		{
+			int key = 0;
+			bValid = (line >> key) ? true : false;
+			if (bValid == true)
+			{
+				m_keys.push_back(key);
+			}
+		}
+		else if (keyword == "step")
+		{
+			PATH_STEP step;
+			CAMERA_POSE& pose = step.pose;
+			int orthographic = 0;
+			bValid = (line >> pose.position.x >> pose.position.y >> pose.position.z
+				>> pose.front.x >> pose.front.y >> pose.front.z
+				>> pose.up.x >> pose.up.y >> pose.up.z
+				>> pose.yaw >> pose.pitch >> pose.zoom >> orthographic) ? true : false;
+			if (bValid == true)
+			{
+				pose.bOrthographic = (orthographic != 0);
+				step.firstKey = firstKey;
+				step.keyCount = m_keys.size() - firstKey;
+				firstKey = m_keys.size();
+				m_steps.push_back(step);
+			}
+		}
+
+		if (bValid == false)
+		{
+			std::cout << filename << "(" << lineNumber << "): malformed camera path line" << std::endl;
+			m_steps.clear();
+			m_keys.clear();
+			return(false);
+		}
+	}
+
+	if (m_steps.empty() == true)
+	{
+		std::cout << filename << ": camera path has no steps" << std::endl;
+		return(false);
+	}
+
+	m_bPlaying = true;
+	return(true);
+}
+
+/***********************************************************
+ *  NextStep()
+ *
+ *  This method is used for handing out the next step of the
+ *  played back path: the keys pressed before it, in their
+ *  recorded order, and the pose after it.
+ ***********************************************************/
+bool CameraPath::NextStep(std::vector<int>& keys, CAMERA_POSE& pose)
+{
+	keys.clear();
+	if (m_bPlaying == false)
+	{
+		return(false);
+	}
+	if (m_nextStep >= m_steps.size())
+	{
+		m_bFinished = true;
+		return(false);
+	}
+
+	const PATH_STEP& step = m_steps[m_nextStep];
+	keys.assign(m_keys.begin() + step.firstKey, m_keys.begin() + step.firstKey + step.keyCount);
+	pose = step.pose;
+	m_nextStep++;
+	return(true);
+}
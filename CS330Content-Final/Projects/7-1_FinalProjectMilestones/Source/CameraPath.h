@@ -0,0 +1,85 @@
+///////////////////////////////////////////////////////////////////////////////
+// camerapath.h
+// ============
+// recorded camera path, played back for repeatable benchmark runs
+//
+//  Keeps the camera pose after every fixed simulation step along with
+//  the keys pressed before it. Played back one step per frame, the
+//  path renders the same frames on every run, however fast the
+//  machine is, so the frame timings of builds and machines compare.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+/***********************************************************
+ *  CameraPath
+ *
+ *  This class contains the steps of a camera path. While
+ *  recording, the view manager adds the key presses and the
+ *  pose of every simulation step, and Save() writes them as
+ *  text. Load() reads a path and starts playing it back,
+ *  and NextStep() hands out one step after the other.
+ ***********************************************************/
+class CameraPath
+{
+public:
+	// constructor
+	CameraPath();
+
+	// camera state after a simulation step
+	struct CAMERA_POSE
+	{
+		glm::vec3 position;
+		glm::vec3 front;
+		glm::vec3 up;
+		float yaw;
+		float pitch;
+		float zoom;
+		bool bOrthographic;
+	};
+
+	// drop any path and record a new one
+	void StartRecording();
+	bool IsRecording() const { return(m_bRecording); }
+	// add a key press, replayed before the next recorded step
+	void RecordKey(int key);
+	// add the pose after a simulation step
+	void RecordStep(const CAMERA_POSE& pose);
+	// write the recorded path; false when the file cannot be written
+	bool Save(const char* filename) const;
+
+	// read a path and start playing it back from its first step;
+	// false when the file cannot be read or holds no step
+	bool Load(const char* filename);
+	bool IsPlaying() const { return(m_bPlaying); }
+	// true once a step past the last one of the played back path
+	// was asked for
+	bool IsFinished() const { return(m_bFinished); }
+	// the keys pressed before the next step and its pose; false
+	// after the last step
+	bool NextStep(std::vector<int>& keys, CAMERA_POSE& pose);
+
+	// steps recorded or loaded, and steps played back so far
+	size_t GetStepCount() const { return(m_steps.size()); }
+	size_t GetStepsPlayed() const { return(m_nextStep); }
+
+private:
+	// one step of the path and its range of m_keys
+	struct PATH_STEP
+	{
+		CAMERA_POSE pose;
+		size_t firstKey;
+		size_t keyCount;
+	};
+
+	std::vector<PATH_STEP> m_steps;
+	std::vector<int> m_keys;
+	size_t m_nextStep;
+	bool m_bRecording;
+	bool m_bPlaying;
+	bool m_bFinished;
+};
@@ -0,0 +1,595 @@
+///////////////////////////////////////////////////////////////////////////////
+// cascadedshadows.cpp
+// ============
+// cascaded shadow maps of the directional key light
+//
+//  The view is cut into slices along its depth, nearer ones thinner,
+//  and each slice gets an orthographic shadow map of its own along the
+//  light, layers of one depth array. Every map is fitted around the
+//  bounding sphere of its slice, whose size does not change as the
+//  camera turns, and moved in whole texels of the light view, so the
+//  shadow edges stay put while the camera moves. All the cascades are
+//  drawn in one pass, an instance per cascade writing its own layer.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "CascadedShadows.h"
+#include "ShadowAtlas.h"
+#include "GPUMemory.h"
+#include "GLTrace.h"
+#include "Logger.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+	// view depth the first cascade starts at, the near plane of the
+	// perspective views
+	const float CASCADE_NEAR_DEPTH = 0.1f;
+	// view depth the last cascade reaches unless told otherwise
+	const float DEFAULT_SHADOW_DISTANCE = 60.0f;
+	// share of the logarithmic split in the split distances, the rest
+	// uniform; the logarithmic split alone gives the far cascades
+	// too much and the near ones too little
+	const float CASCADE_SPLIT_BLEND = 0.75f;
+	// steps the radius of a slice sphere is rounded up to, so float
+	// noise never changes the size of its cascade
+	const float CASCADE_RADIUS_STEP = 1.0f / 16.0f;
+	// window depth subtracted before the comparison, with the slope
+	// scaled polygon offset of the caster pass against acne
+	const float CASCADE_DEPTH_BIAS = 0.0005f;
+	const float CASCADE_OFFSET_FACTOR = 2.0f;
+	const float CASCADE_OFFSET_UNITS = 4.0f;
+
+	/***********************************************************
+	 *  GetSplitDepth()
+	 *
+	 *  This function is used for the view depth the cascade
+	 *  before a split ends at, blending the logarithmic split,
+	 *  which keeps the texels per pixel even over the depth,
+	 *  with the uniform one.
+	 ***********************************************************/
+	float GetSplitDepth(int split, int cascadeCount, float nearDepth, float farDepth)
+	{
+		float fraction = (float)split / (float)cascadeCount;
+		float logarithmic = nearDepth * std::pow(farDepth / nearDepth, fraction);
+		float uniform = nearDepth + ((farDepth - nearDepth) * fraction);
+		return((CASCADE_SPLIT_BLEND * logarithmic) + ((1.0f - CASCADE_SPLIT_BLEND) * uniform));
+	}
+
+	/***********************************************************
+	 *  GetSliceCorners()
+	 *
+	 *  This function is used for the world corners of the part
+	 *  of the view between two view depths. Each corner ray of
+	 *  the view is unprojected at two window depths and walked
+	 *  to the depths wanted, which works for the perspective
+	 *  and orthographic projections in either depth convention.
+	 ***********************************************************/
+	void GetSliceCorners(
+		const glm::mat4& inverseProjection,
+		const glm::mat4& cameraWorld,
+		float nearDepth,
+		float farDepth,
+		glm::vec3 corners[8])
+	{
+		for (int i = 0; i < 4; i++)
+		{
+			float x = ((i & 1) != 0) ? 1.0f : -1.0f;
+			float y = ((i & 2) != 0) ? 1.0f : -1.0f;
+			glm::vec4 first = inverseProjection * glm::vec4(x, y, 1.0f, 1.0f);
+			glm::vec4 second = inverseProjection * glm::vec4(x, y, 0.5f, 1.0f);
+			glm::vec3 a = glm::vec3(first) / first.w;
+			glm::vec3 b = glm::vec3(second) / second.w;
+			glm::vec3 along = b - a;
+			if (std::fabs(along.z) < 1e-6f)
+			{
+				along.z = -1e-6f;
+			}
+
+			glm::vec3 nearCorner = a + (along * ((-nearDepth - a.z) / along.z));
+			glm::vec3 farCorner = a + (along * ((-farDepth - a.z) / along.z));
+			corners[i] = glm::vec3(cameraWorld * glm::vec4(nearCorner, 1.0f));
+			corners[i + 4] = glm::vec3(cameraWorld * glm::vec4(farCorner, 1.0f));
+		}
+	}
+
+	/***********************************************************
+	 *  GetBoxCorners()
+	 *
+	 *  This function is used for the eight corners of a box.
+	 ***********************************************************/
+	void GetBoxCorners(const glm::vec3& minXYZ, const glm::vec3& maxXYZ, glm::vec3 corners[8])
+	{
+		for (int i = 0; i < 8; i++)
+		{
+			corners[i] = glm::vec3(
+				((i & 1) != 0) ? maxXYZ.x : minXYZ.x,
+				((i & 2) != 0) ? maxXYZ.y : minXYZ.y,
+				((i & 4) != 0) ? maxXYZ.z : minXYZ.z);
+		}
+	}
+
+	/***********************************************************
+	 *  BoxesOverlap()
+	 *
+	 *  This function is used for testing two boxes against
+	 *  each other.
+	 ***********************************************************/
+	bool BoxesOverlap(const SceneBVH::AABB& first, const SceneBVH::AABB& second)
+	{
+		return((first.minXYZ.x <= second.maxXYZ.x) && (first.maxXYZ.x >= second.minXYZ.x) &&
+			(first.minXYZ.y <= second.maxXYZ.y) && (first.maxXYZ.y >= second.minXYZ.y) &&
+			(first.minXYZ.z <= second.maxXYZ.z) && (first.maxXYZ.z >= second.minXYZ.z));
+	}
+}
+
+/***********************************************************
+ *  CascadedShadows()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+CascadedShadows::CascadedShadows(ShaderManager* pShaderManager)
+{
+	m_pShaderManager = pShaderManager;
+	m_casterProgram = 0;
+	m_modelLocation = -1;
+	m_viewProjectionLocation = -1;
+	m_firstCascadeLocation = -1;
+	m_bLayered = false;
+	m_arrayTexture = 0;
+	m_framebuffer = 0;
+	m_arrayCount = 0;
+	m_arraySize = 0;
+	m_arrayFormat = GL_NONE;
+	m_cascadeCount = DEFAULT_CASCADE_COUNT;
+	m_cascadeSize = DEFAULT_CASCADE_SIZE;
+	m_depthFormat = GL_DEPTH_COMPONENT24;
+	m_shadowDistance = DEFAULT_SHADOW_DISTANCE;
+	m_quality = ShadowAtlas::SHADOW_QUALITY_MEDIUM;
+	m_bDirty = true;
+	m_casterVolume.minXYZ = glm::vec3(0.0f);
+	m_casterVolume.maxXYZ = glm::vec3(0.0f);
+	memset(&m_cascadeData, 0, sizeof(m_cascadeData));
+	m_bCascadeDataDirty = true;
+	m_savedFramebuffer = 0;
+	memset(m_savedViewport, 0, sizeof(m_savedViewport));
+	m_savedDepthFunc = GL_LESS;
+	m_savedClearDepth = 1.0f;
+	m_savedClipDepthMode = GL_NEGATIVE_ONE_TO_ONE;
+}
+
+/***********************************************************
+ *  ~CascadedShadows()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+CascadedShadows::~CascadedShadows()
+{
+	if ((NULL != m_pShaderManager) && (0 != m_arrayTexture))
+	{
+		m_pShaderManager->BindTexture(CASCADE_TEXTURE_UNIT, 0, GL_TEXTURE_2D_ARRAY);
+	}
+	if (0 != m_framebuffer)
+	{
+		glDeleteFramebuffers(1, &m_framebuffer);
+		m_framebuffer = 0;
+	}
+	if (0 != m_arrayTexture)
+	{
+		GPUMemory::DeleteTextures(1, &m_arrayTexture);
+		m_arrayTexture = 0;
+	}
+	m_cascadeDataBuffer.Destroy();
+	if (0 != m_casterProgram)
+	{
+		glDeleteProgram(m_casterProgram);
+		m_casterProgram = 0;
+	}
+	m_pShaderManager = NULL;
+}
+
+/***********************************************************
+ *  Create()
+ *
+ *  This method is used for creating the CascadeData block
+ *  and building the caster program. The block comes first,
+ *  so the lit shaders read no cascades even when the
+ *  program fails. The cascades are drawn in one pass where
+ *  the vertex shader can pick the layer it writes.
+ ***********************************************************/
+bool CascadedShadows::Create(const char* casterVertexPath, const char* casterFragmentPath)
+{
+	if (NULL == m_pShaderManager)
+	{
+		return(false);
+	}
+
+	// the block is attached to its binding point once, like the
+	// shadow data
+	m_cascadeDataBuffer.Create(GPUBuffer::USAGE_DYNAMIC, sizeof(CASCADE_DATA), &m_cascadeData,
+		GPUMemory::CATEGORY_BUFFER, "cascade data");
+	glBindBufferBase(GL_UNIFORM_BUFFER, ShaderManager::CASCADE_DATA_BINDING, m_cascadeDataBuffer.GetName());
+	m_bCascadeDataDirty = false;
+
+	m_casterProgram = m_pShaderManager->LoadExternalProgram(casterVertexPath, casterFragmentPath);
+	if (0 == m_casterProgram)
+	{
+		LOG_WARNING("Cascaded shadows disabled, the cascade caster shader did not build");
+		return(false);
+	}
+	m_modelLocation = glGetUniformLocation(m_casterProgram, "model");
+	m_viewProjectionLocation = glGetUniformLocation(m_casterProgram, "cascadeViewProjection");
+	m_firstCascadeLocation = glGetUniformLocation(m_casterProgram, "firstCascade");
+	m_bLayered = (GLEW_ARB_shader_viewport_layer_array == GL_TRUE);
+
+	glGenFramebuffers(1, &m_framebuffer);
+
+	return(true);
+}
+
+/***********************************************************
+ *  CreateArray()
+ *
+ *  This method is used for making the depth array of the
+ *  cascades asked for, in place of the one before. Hardware
+ *  comparison filters the 2x2 texels of every lookup.
+ ***********************************************************/
+void CascadedShadows::CreateArray()
+{
+	if (0 != m_arrayTexture)
+	{
+		m_pShaderManager->BindTexture(CASCADE_TEXTURE_UNIT, 0, GL_TEXTURE_2D_ARRAY);
+		GPUMemory::DeleteTextures(1, &m_arrayTexture);
+		m_arrayTexture = 0;
+	}
+
+	GLint maxTextureSize = 0;
+	glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTextureSize);
+	m_arrayCount = m_cascadeCount;
+	m_arraySize = glm::min(m_cascadeSize, (int)maxTextureSize);
+	m_arrayFormat = m_depthFormat;
+
+	// create on the cascade unit, so the bindings of the scene
+	// textures stay what the shader manager expects
+	glGenTextures(1, &m_arrayTexture);
+	m_pShaderManager->BindTexture(CASCADE_TEXTURE_UNIT, m_arrayTexture, GL_TEXTURE_2D_ARRAY);
+	m_pShaderManager->SetActiveTextureUnit(CASCADE_TEXTURE_UNIT);
+	glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, m_arrayFormat, m_arraySize, m_arraySize, m_arrayCount, 0,
+		GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, NULL);
+	GPUMemory::TrackTexture(m_arrayTexture, m_arrayFormat, m_arraySize, m_arraySize, m_arrayCount, 1,
+		GPUMemory::CATEGORY_RENDER_TARGET, "shadow cascades");
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+
+	// layered, every layer is attached at once and the clear takes
+	// all of them; otherwise a layer is attached a pass
+	glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+	if (m_bLayered == true)
+	{
+		glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, m_arrayTexture, 0);
+	}
+	else
+	{
+		glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, m_arrayTexture, 0, 0);
+	}
+	glDrawBuffer(GL_NONE);
+	glReadBuffer(GL_NONE);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+	{
+		LOG_ERROR("Shadow cascade framebuffer is incomplete");
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	m_bDirty = true;
+}
+
+/***********************************************************
+ *  SetCascades()
+ *
+ *  This method is used for choosing how many cascades the
+ *  view is cut into and the side of each in texels.
+ ***********************************************************/
+void CascadedShadows::SetCascades(int cascadeCount, int cascadeSize)
+{
+	m_cascadeCount = glm::clamp(cascadeCount, 1, (int)MAX_CASCADES);
+	m_cascadeSize = glm::max(cascadeSize, (int)MIN_CASCADE_SIZE);
+}
+
+/***********************************************************
+ *  SetShadowDistance()
+ *
+ *  This method is used for choosing the view depth the last
+ *  cascade reaches, past which nothing has a shadow of the
+ *  key light.
+ ***********************************************************/
+void CascadedShadows::SetShadowDistance(float distance)
+{
+	m_shadowDistance = glm::max(distance, CASCADE_NEAR_DEPTH * 2.0f);
+}
+
+/***********************************************************
+ *  SetQuality()
+ *
+ *  This method is used for choosing the filtering of the
+ *  cascade lookups, the same levels the shadow atlas has.
+ ***********************************************************/
+void CascadedShadows::SetQuality(int quality)
+{
+	if (quality != m_quality)
+	{
+		m_quality = quality;
+		m_cascadeData.quality = quality;
+		m_bCascadeDataDirty = true;
+	}
+}
+
+/***********************************************************
+ *  Update()
+ *
+ *  This method is used for fitting the cascades to the view.
+ *  The splits run from the near plane to the shadow distance,
+ *  or to the farthest corner of the scene when that is
+ *  nearer. The light looks down its direction from the
+ *  origin, so its view only turns with the light, and the
+ *  center of every cascade is snapped to the texels of that
+ *  view. Each cascade spans the depth of the whole scene
+ *  along the light, so casters outside the view still cast
+ *  into it.
+ ***********************************************************/
+void CascadedShadows::Update(
+	const glm::mat4& view,
+	const glm::mat4& projection,
+	const glm::vec3& lightDirection,
+	const SceneBVH::AABB& sceneBounds)
+{
+	if (IsAvailable() == false)
+	{
+		return;
+	}
+	if ((0 == m_arrayTexture) || (m_arrayCount != m_cascadeCount) || (m_arraySize != m_cascadeSize) ||
+		(m_arrayFormat != m_depthFormat))
+	{
+		CreateArray();
+	}
+
+	glm::mat4 cameraWorld = glm::inverse(view);
+	glm::mat4 inverseProjection = glm::inverse(projection);
+	glm::vec3 cameraPosition = glm::vec3(cameraWorld[3]);
+
+	glm::vec3 sceneCorners[8];
+	GetBoxCorners(sceneBounds.minXYZ, sceneBounds.maxXYZ, sceneCorners);
+	float sceneReach = 0.0f;
+	for (int i = 0; i < 8; i++)
+	{
+		sceneReach = glm::max(sceneReach, glm::length(sceneCorners[i] - cameraPosition));
+	}
+	float farDepth = glm::clamp(sceneReach, CASCADE_NEAR_DEPTH * 2.0f, m_shadowDistance);
+
+	glm::vec3 forward = -glm::normalize(lightDirection);
+	glm::vec3 up = (std::fabs(forward.y) > 0.99f) ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+	glm::mat4 lightView = glm::lookAt(glm::vec3(0.0f), forward, up);
+	glm::mat4 lightWorld = glm::inverse(lightView);
+
+	// the light view looks down -Z, so the scene spans these depths
+	float sceneMinZ = FLT_MAX;
+	float sceneMaxZ = -FLT_MAX;
+	for (int i = 0; i < 8; i++)
+	{
+		float z = (lightView * glm::vec4(sceneCorners[i], 1.0f)).z;
+		sceneMinZ = glm::min(sceneMinZ, z);
+		sceneMaxZ = glm::max(sceneMaxZ, z);
+	}
+
+	CASCADE_DATA cascadeData;
+	memset(&cascadeData, 0, sizeof(cascadeData));
+	m_casterVolume.minXYZ = glm::vec3(FLT_MAX);
+	m_casterVolume.maxXYZ = glm::vec3(-FLT_MAX);
+	float sliceNear = CASCADE_NEAR_DEPTH;
+	for (int cascade = 0; cascade < m_arrayCount; cascade++)
+	{
+		float sliceFar = GetSplitDepth(cascade + 1, m_arrayCount, CASCADE_NEAR_DEPTH, farDepth);
+		glm::vec3 corners[8];
+		GetSliceCorners(inverseProjection, cameraWorld, sliceNear, sliceFar, corners);
+
+		glm::vec3 center = glm::vec3(0.0f);
+		for (int i = 0; i < 8; i++)
+		{
+			center += corners[i] * 0.125f;
+		}
+		float radius = 0.0f;
+		for (int i = 0; i < 8; i++)
+		{
+			radius = glm::max(radius, glm::length(corners[i] - center));
+		}
+		radius = std::ceil(radius / CASCADE_RADIUS_STEP) * CASCADE_RADIUS_STEP;
+
+		glm::vec3 lightCenter = glm::vec3(lightView * glm::vec4(center, 1.0f));
+		float texel = (2.0f * radius) / (float)m_arraySize;
+		lightCenter.x = std::floor(lightCenter.x / texel) * texel;
+		lightCenter.y = std::floor(lightCenter.y / texel) * texel;
+		float nearPlane = -glm::max(sceneMaxZ, lightCenter.z + radius);
+		float farPlane = -glm::min(sceneMinZ, lightCenter.z - radius);
+
+		glm::mat4 lightProjection = glm::ortho(lightCenter.x - radius, lightCenter.x + radius,
+			lightCenter.y - radius, lightCenter.y + radius, nearPlane, farPlane);
+		cascadeData.viewProjection[cascade] = lightProjection * lightView;
+		cascadeData.splits[cascade] = sliceFar;
+
+		glm::vec3 boxCorners[8];
+		GetBoxCorners(glm::vec3(lightCenter.x - radius, lightCenter.y - radius, -farPlane),
+			glm::vec3(lightCenter.x + radius, lightCenter.y + radius, -nearPlane), boxCorners);
+		for (int i = 0; i < 8; i++)
+		{
+			glm::vec3 corner = glm::vec3(lightWorld * glm::vec4(boxCorners[i], 1.0f));
+			m_casterVolume.minXYZ = glm::min(m_casterVolume.minXYZ, corner);
+			m_casterVolume.maxXYZ = glm::max(m_casterVolume.maxXYZ, corner);
+		}
+		sliceNear = sliceFar;
+	}
+	cascadeData.count = m_arrayCount;
+	cascadeData.quality = m_quality;
+	cascadeData.depthBias = CASCADE_DEPTH_BIAS;
+	cascadeData.texelSize = 1.0f / (float)m_arraySize;
+
+	if (memcmp(&cascadeData, &m_cascadeData, sizeof(cascadeData)) != 0)
+	{
+		if ((cascadeData.count != m_cascadeData.count) ||
+			(memcmp(cascadeData.viewProjection, m_cascadeData.viewProjection, sizeof(cascadeData.viewProjection)) != 0))
+		{
+			m_bDirty = true;
+		}
+		m_cascadeData = cascadeData;
+		m_bCascadeDataDirty = true;
+	}
+}
+
+/***********************************************************
+ *  ClearLight()
+ *
+ *  This method is used for telling the lit shaders there is
+ *  no key light, so they read no cascades.
+ ***********************************************************/
+void CascadedShadows::ClearLight()
+{
+	if (m_cascadeData.count != 0)
+	{
+		m_cascadeData.count = 0;
+		m_bCascadeDataDirty = true;
+	}
+}
+
+/***********************************************************
+ *  InvalidateBox()
+ *
+ *  This method is used for marking the cascades for a
+ *  re-render when the box overlaps any of them.
+ ***********************************************************/
+void CascadedShadows::InvalidateBox(const SceneBVH::AABB& box)
+{
+	if ((m_bDirty == false) && (m_cascadeData.count > 0) && (BoxesOverlap(box, m_casterVolume) == true))
+	{
+		m_bDirty = true;
+	}
+}
+
+/***********************************************************
+ *  GetPassCount()
+ *
+ *  This method is used for getting how many passes draw the
+ *  casters into every cascade.
+ ***********************************************************/
+int CascadedShadows::GetPassCount() const
+{
+	return((m_bLayered == true) ? 1 : m_arrayCount);
+}
+
+/***********************************************************
+ *  BeginShadowPass()
+ *
+ *  This method is used for switching to the cascade array
+ *  and the caster program, with the matrices of every
+ *  cascade set. The cascades keep the standard depth
+ *  convention the lookups compare against, even while the
+ *  scene is drawn with reverse-Z depth.
+ ***********************************************************/
+void CascadedShadows::BeginShadowPass()
+{
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &m_savedFramebuffer);
+	glGetIntegerv(GL_VIEWPORT, m_savedViewport);
+	glGetIntegerv(GL_DEPTH_FUNC, &m_savedDepthFunc);
+	glGetFloatv(GL_DEPTH_CLEAR_VALUE, &m_savedClearDepth);
+	if ((GLEW_VERSION_4_5 == GL_TRUE) || (GLEW_ARB_clip_control == GL_TRUE))
+	{
+		glGetIntegerv(GL_CLIP_DEPTH_MODE, &m_savedClipDepthMode);
+		glClipControl(GL_LOWER_LEFT, GL_NEGATIVE_ONE_TO_ONE);
+	}
+	glClearDepth(1.0);
+	glDepthFunc(GL_LESS);
+	glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+	glViewport(0, 0, m_arraySize, m_arraySize);
+	glEnable(GL_POLYGON_OFFSET_FILL);
+	glPolygonOffset(CASCADE_OFFSET_FACTOR, CASCADE_OFFSET_UNITS);
+	m_pShaderManager->UseExternalProgram(m_casterProgram);
+	glUniformMatrix4fv(m_viewProjectionLocation, MAX_CASCADES, GL_FALSE, &m_cascadeData.viewProjection[0][0][0]);
+}
+
+/***********************************************************
+ *  BeginCascadePass()
+ *
+ *  This method is used for clearing the layers one pass
+ *  draws and pointing the casters at them: all of them when
+ *  layered, otherwise the one layer of the pass.
+ ***********************************************************/
+void CascadedShadows::BeginCascadePass(int pass)
+{
+	if (m_bLayered == false)
+	{
+		glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, m_arrayTexture, 0, pass);
+	}
+	GLTrace::RecordClear(GL_DEPTH_BUFFER_BIT);
+	glClear(GL_DEPTH_BUFFER_BIT);
+	glUniform1i(m_firstCascadeLocation, (m_bLayered == true) ? 0 : pass);
+}
+
+/***********************************************************
+ *  DrawCaster()
+ *
+ *  This method is used for drawing the depth of one caster
+ *  into the cascades of the pass, an instance per cascade.
+ ***********************************************************/
+void CascadedShadows::DrawCaster(const glm::mat4& model, const ShapeMeshes::DRAW_RANGE& range)
+{
+	glUniformMatrix4fv(m_modelLocation, 1, GL_FALSE, &model[0][0]);
+	ShapeMeshes::DrawRange(range, (m_bLayered == true) ? m_arrayCount : 1);
+}
+
+/***********************************************************
+ *  EndShadowPass()
+ *
+ *  This method is used for going back to the scene
+ *  framebuffer and viewport, with every cascade up to date.
+ ***********************************************************/
+void CascadedShadows::EndShadowPass()
+{
+	glDisable(GL_POLYGON_OFFSET_FILL);
+	glBindFramebuffer(GL_FRAMEBUFFER, (GLuint)m_savedFramebuffer);
+	glViewport(m_savedViewport[0], m_savedViewport[1], m_savedViewport[2], m_savedViewport[3]);
+	if ((GLEW_VERSION_4_5 == GL_TRUE) || (GLEW_ARB_clip_control == GL_TRUE))
+	{
+		glClipControl(GL_LOWER_LEFT, (GLenum)m_savedClipDepthMode);
+	}
+	glClearDepth(m_savedClearDepth);
+	glDepthFunc((GLenum)m_savedDepthFunc);
+
+	m_bDirty = false;
+}
+
+/***********************************************************
+ *  Upload()
+ *
+ *  This method is used for writing the CascadeData block
+ *  with a single upload, only when it has changed, and
+ *  binding the cascade array for the lit shaders.
+ ***********************************************************/
+void CascadedShadows::Upload()
+{
+	if (0 != m_arrayTexture)
+	{
+		m_pShaderManager->BindTexture(CASCADE_TEXTURE_UNIT, m_arrayTexture, GL_TEXTURE_2D_ARRAY);
+	}
+	if ((m_cascadeDataBuffer.IsCreated() == false) || (m_bCascadeDataDirty == false))
+	{
+		return;
+	}
+
+	m_cascadeDataBuffer.Update(0, sizeof(CASCADE_DATA), &m_cascadeData);
+	m_bCascadeDataDirty = false;
+}
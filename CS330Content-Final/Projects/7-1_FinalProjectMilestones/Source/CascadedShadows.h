@@ -0,0 +1,152 @@
+///////////////////////////////////////////////////////////////////////////////
+// cascadedshadows.h
+// ============
+// cascaded shadow maps of the directional key light
+//
+//  The view is cut into slices along its depth, nearer ones thinner,
+//  and each slice gets an orthographic shadow map of its own along the
+//  light, layers of one depth array. Every map is fitted around the
+//  bounding sphere of its slice, whose size does not change as the
+//  camera turns, and moved in whole texels of the light view, so the
+//  shadow edges stay put while the camera moves. All the cascades are
+//  drawn in one pass, an instance per cascade writing its own layer.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "ShaderManager.h"
+#include "ShapeMeshes.h"
+#include "SceneBVH.h"
+#include "GPUBuffer.h"
+
+/***********************************************************
+ *  CascadedShadows
+ *
+ *  This class contains the cascade array, the caster program
+ *  and the CascadeData uniform block of the key light. The
+ *  cascades are fitted again every frame, and their casters
+ *  drawn only when a cascade moved or a caster in it did.
+ ***********************************************************/
+class CascadedShadows
+{
+public:
+	// constructor
+	CascadedShadows(ShaderManager* pShaderManager);
+	// destructor
+	~CascadedShadows();
+
+	// texture unit the lit shaders read the cascades from, the one
+	// below the instance buffer, since every unit above is taken
+	static const int CASCADE_TEXTURE_UNIT = 15;
+	// capacity of the CascadeData block, must match the shaders
+	static const int MAX_CASCADES = 4;
+	// cascades and their side in texels unless told otherwise
+	static const int DEFAULT_CASCADE_COUNT = 4;
+	static const int DEFAULT_CASCADE_SIZE = 2048;
+	// smallest side a cascade is given
+	static const int MIN_CASCADE_SIZE = 512;
+
+	// build the caster program and the CascadeData block; false when
+	// the program fails, with the block left saying there are no
+	// cascades
+	bool Create(const char* casterVertexPath, const char* casterFragmentPath);
+	bool IsAvailable() const { return(0 != m_casterProgram); }
+	// true when one pass draws every cascade
+	bool IsLayered() const { return(m_bLayered); }
+
+	// cascades and the side of each in texels, the array made again
+	// on the next Update() when either changed
+	void SetCascades(int cascadeCount, int cascadeSize);
+	int GetCascadeCount() const { return(m_cascadeCount); }
+	int GetCascadeSize() const { return(m_cascadeSize); }
+	// depth format of the array, made again on the next Update() when
+	// it changed; the cascades are orthographic, so their depth is
+	// linear and 16 bits resolve it
+	void SetDepthFormat(GLenum depthFormat) { m_depthFormat = depthFormat; }
+	// view depth the last cascade reaches when the scene goes further
+	void SetShadowDistance(float distance);
+	float GetShadowDistance() const { return(m_shadowDistance); }
+	// filtering of the lookups, a ShadowAtlas::SHADOW_QUALITY
+	void SetQuality(int quality);
+
+	// fit the cascades to the camera, for a key light shining from
+	// lightDirection, and mark them for a re-render when any moved
+	void Update(
+		const glm::mat4& view,
+		const glm::mat4& projection,
+		const glm::vec3& lightDirection,
+		const SceneBVH::AABB& sceneBounds);
+	// leave the scene without a key light
+	void ClearLight();
+
+	// mark the cascades for a re-render when the box overlaps them,
+	// e.g. the old and new bounds of a moved caster
+	void InvalidateBox(const SceneBVH::AABB& box);
+	void InvalidateAll() { m_bDirty = true; }
+	// true when the casters need to be drawn again
+	bool IsDirty() const { return(m_bDirty && (m_cascadeData.count > 0)); }
+	// box around every cascade, to find the casters
+	const SceneBVH::AABB& GetCasterVolume() const { return(m_casterVolume); }
+
+	// draw the casters between these, every pass taking all of them
+	// with DrawCaster(); one pass of an instance per cascade when
+	// layered, otherwise a pass per cascade
+	int GetPassCount() const;
+	void BeginShadowPass();
+	void BeginCascadePass(int pass);
+	void DrawCaster(const glm::mat4& model, const ShapeMeshes::DRAW_RANGE& range);
+	void EndShadowPass();
+
+	// upload the CascadeData block if it changed and bind the array
+	void Upload();
+
+private:
+	// std140 layout of the CascadeData block
+	struct CASCADE_DATA
+	{
+		glm::mat4 viewProjection[MAX_CASCADES];
+		GLfloat splits[MAX_CASCADES];	// view depth each cascade reaches
+		GLint count;					// 0 without a key light
+		GLint quality;
+		GLfloat depthBias;
+		GLfloat texelSize;
+	};
+
+	// pointer to shader manager object
+	ShaderManager* m_pShaderManager;
+	// depth only program drawing one caster into the cascades
+	GLuint m_casterProgram;
+	GLint m_modelLocation;
+	GLint m_viewProjectionLocation;
+	GLint m_firstCascadeLocation;
+	bool m_bLayered;
+	// depth array of the cascades and the framebuffer drawing it,
+	// with the count and side it was made for
+	GLuint m_arrayTexture;
+	GLuint m_framebuffer;
+	int m_arrayCount;
+	int m_arraySize;
+	GLenum m_arrayFormat;
+	// asked for with SetCascades() and SetDepthFormat()
+	int m_cascadeCount;
+	int m_cascadeSize;
+	GLenum m_depthFormat;
+	float m_shadowDistance;
+	int m_quality;
+	bool m_bDirty;
+	SceneBVH::AABB m_casterVolume;
+	CASCADE_DATA m_cascadeData;
+	// dynamic, written when a cascade moves
+	GPUBuffer m_cascadeDataBuffer;
+	bool m_bCascadeDataDirty;
+	// framebuffer, viewport and depth convention to restore after
+	// the shadow pass
+	GLint m_savedFramebuffer;
+	GLint m_savedViewport[4];
+	GLint m_savedDepthFunc;
+	GLfloat m_savedClearDepth;
+	GLint m_savedClipDepthMode;
+
+	// make the depth array for the cascades asked for
+	void CreateArray();
+};
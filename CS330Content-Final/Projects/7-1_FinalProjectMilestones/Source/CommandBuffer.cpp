@@ -0,0 +1,69 @@
+///////////////////////////////////////////////////////////////////////////////
+// commandbuffer.cpp
+// ============
+// compact list of draw commands recorded off the GL thread
+//
+//  The commands name the batch of the sorted render list they draw
+//  and the shader permutation they draw it with, never a GL object,
+//  so any thread can record them. Worker threads record the batches
+//  of a frame into a buffer each, and the GL thread replays the
+//  buffers in order, merging the indirect draws that continue
+//  across them.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "CommandBuffer.h"
+
+namespace
+{
+	const char* const COMMAND_NAMES[] =
+	{
+		"use permutation",
+		"begin transparent",
+		"draw batch",
+		"multi draw",
+		"draw meshlets",
+		"draw query boxes",
+		"begin conditional",
+		"end conditional"
+	};
+}
+
+/***********************************************************
+ *  CommandBuffer()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+CommandBuffer::CommandBuffer()
+{
+}
+
+/***********************************************************
+ *  Add()
+ *
+ *  This method is used for appending a command with its
+ *  arguments to the buffer.
+ ***********************************************************/
+void CommandBuffer::Add(COMMAND_TYPE type, uint32_t arg0, uint32_t arg1, uint32_t arg2)
+{
+	COMMAND command;
+	command.type = (uint32_t)type;
+	command.args[0] = arg0;
+	command.args[1] = arg1;
+	command.args[2] = arg2;
+	m_commands.push_back(command);
+}
+
+/***********************************************************
+ *  GetTypeName()
+ *
+ *  This method is used for getting the name of a command
+ *  type, for the reports.
+ ***********************************************************/
+const char* CommandBuffer::GetTypeName(int type)
+{
+	if ((type < 0) || (type > COMMAND_END_CONDITIONAL))
+	{
+		return("unknown");
+	}
+	return(COMMAND_NAMES[type]);
+}
@@ -0,0 +1,74 @@
+///////////////////////////////////////////////////////////////////////////////
+// commandbuffer.h
+// ============
+// compact list of draw commands recorded off the GL thread
+//
+//  The commands name the batch of the sorted render list they draw
+//  and the shader permutation they draw it with, never a GL object,
+//  so any thread can record them. Worker threads record the batches
+//  of a frame into a buffer each, and the GL thread replays the
+//  buffers in order, merging the indirect draws that continue
+//  across them.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/***********************************************************
+ *  CommandBuffer
+ *
+ *  This class contains the recorded commands of one range
+ *  of batches. The command array is kept between frames,
+ *  so recording a frame the size of the last one does not
+ *  allocate.
+ ***********************************************************/
+class CommandBuffer
+{
+public:
+	// constructor
+	CommandBuffer();
+
+	// what a recorded command does
+	enum COMMAND_TYPE
+	{
+		// switch to the shader permutation args[0]
+		COMMAND_USE_PERMUTATION = 0,
+		// start the blended draws, after lighting the G-buffer
+		COMMAND_BEGIN_TRANSPARENT,
+		// draw batch args[0] with one instanced call
+		COMMAND_DRAW_BATCH,
+		// draw args[1] batches from args[0], args[2] instances in
+		// all, with one multi-draw indirect call
+		COMMAND_MULTI_DRAW,
+		// draw the visible meshlets of batch args[0]
+		COMMAND_DRAW_MESHLETS,
+		// draw the boxes of the queried objects, whose batches
+		// follow to the end of the opaque draws
+		COMMAND_DRAW_QUERY_BOXES,
+		// draw the commands up to the end only when a sample of the
+		// box of query group args[0] passed
+		COMMAND_BEGIN_CONDITIONAL,
+		COMMAND_END_CONDITIONAL
+	};
+
+	// one recorded command, 16 bytes
+	struct COMMAND
+	{
+		uint32_t type;
+		uint32_t args[3];
+	};
+
+	// drop the commands, keeping their memory
+	void Clear() { m_commands.clear(); }
+	void Add(COMMAND_TYPE type, uint32_t arg0 = 0, uint32_t arg1 = 0, uint32_t arg2 = 0);
+
+	const std::vector<COMMAND>& GetCommands() const { return(m_commands); }
+	size_t GetCommandCount() const { return(m_commands.size()); }
+	static const char* GetTypeName(int type);
+
+private:
+	std::vector<COMMAND> m_commands;
+};
@@ -0,0 +1,1122 @@
+///////////////////////////////////////////////////////////////////////////////
+// compressedtexture.cpp
+// ============
+// block compressed textures with precomputed mip chains
+//
+//  Loads KTX2 and DDS files holding BC1, BC3, BC5, BC7 or ASTC blocks
+//  and uploads their mip levels as they are, so a texture takes a
+//  quarter to an eighth of the memory of the RGB8 or RGBA8 texture
+//  decoded from its JPEG or PNG source. The offline converter encodes
+//  those sources into BC1 or BC3 KTX2 files.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "CompressedTexture.h"
+#include "ImageDecoder.h"
+#include "MipChain.h"
+#include "ShapeMeshes.h"
+#include "GPUMemory.h"
+#include "AssetPack.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+namespace
+{
+	// block layout of each format and its codes in the two file formats
+	struct FORMAT_INFO
+	{
+		const char* name;
+		GLenum internalFormat;
+		int blockWidth;
+		int blockHeight;
+		int blockBytes;
+		uint32_t vkFormat;
+		uint32_t dxgiFormat;
+	};
+
+	// in the order of CompressedTexture::FORMAT
+	const FORMAT_INFO g_Formats[CompressedTexture::FORMAT_COUNT] =
+	{
+		{ "none", GL_NONE, 1, 1, 0, 0, 0 },
+		{ "bc1", GL_COMPRESSED_RGB_S3TC_DXT1_EXT, 4, 4, 8, 131, 71 },
+		{ "bc3", GL_COMPRESSED_RGBA_S3TC_DXT5_EXT, 4, 4, 16, 137, 77 },
+		{ "bc5", GL_COMPRESSED_RG_RGTC2, 4, 4, 16, 141, 83 },
+		{ "bc7", GL_COMPRESSED_RGBA_BPTC_UNORM, 4, 4, 16, 145, 98 },
+		{ "astc4x4", GL_COMPRESSED_RGBA_ASTC_4x4_KHR, 4, 4, 16, 157, 0 },
+		{ "astc6x6", GL_COMPRESSED_RGBA_ASTC_6x6_KHR, 6, 6, 16, 165, 0 },
+		{ "astc8x8", GL_COMPRESSED_RGBA_ASTC_8x8_KHR, 8, 8, 16, 171, 0 }
+	};
+	// VK_FORMAT_BC1_RGBA_UNORM_BLOCK, read as BC1 without its alpha
+	const uint32_t VK_FORMAT_BC1_RGBA = 133;
+
+	// KTX2 file layout, https://registry.khronos.org/KTX/specs/2.0/
+	const unsigned char KTX2_IDENTIFIER[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+	struct KTX2_HEADER
+	{
+		unsigned char identifier[12];
+		uint32_t vkFormat;
+		uint32_t typeSize;
+		uint32_t pixelWidth;
+		uint32_t pixelHeight;
+		uint32_t pixelDepth;
+		uint32_t layerCount;
+		uint32_t faceCount;
+		uint32_t levelCount;
+		uint32_t supercompressionScheme;
+		uint32_t dfdByteOffset;
+		uint32_t dfdByteLength;
+		uint32_t kvdByteOffset;
+		uint32_t kvdByteLength;
+		uint64_t sgdByteOffset;
+		uint64_t sgdByteLength;
+	};
+
+	struct KTX2_LEVEL
+	{
+		uint64_t byteOffset;
+		uint64_t byteLength;
+		uint64_t uncompressedByteLength;
+	};
+
+	// data format descriptor values written for BC1 and BC3
+	const uint32_t KHR_DF_MODEL_BC1A = 128;
+	const uint32_t KHR_DF_MODEL_BC3 = 130;
+	const uint32_t KHR_DF_PRIMARIES_BT709 = 1;
+	const uint32_t KHR_DF_TRANSFER_LINEAR = 1;
+	const uint32_t KHR_DF_CHANNEL_COLOR = 0;
+	const uint32_t KHR_DF_CHANNEL_BC3_ALPHA = 15;
+
+	// DDS file layout
+	inline uint32_t MakeFourCC(char a, char b, char c, char d)
+	{
+		return((uint32_t)(unsigned char)a | ((uint32_t)(unsigned char)b << 8) |
+			((uint32_t)(unsigned char)c << 16) | ((uint32_t)(unsigned char)d << 24));
+	}
+
+	const uint32_t DDS_MAGIC = 0x20534444;		// "DDS "
+	const uint32_t DDSD_MIPMAPCOUNT = 0x20000;
+	const uint32_t DDPF_FOURCC = 0x4;
+	const uint32_t DDS_DIMENSION_TEXTURE2D = 3;
+
+	struct DDS_PIXELFORMAT
+	{
+		uint32_t size;
+		uint32_t flags;
+		uint32_t fourCC;
+		uint32_t RGBBitCount;
+		uint32_t bitMasks[4];
+	};
+
+	struct DDS_HEADER
+	{
+		uint32_t size;
+		uint32_t flags;
+		uint32_t height;
+		uint32_t width;
+		uint32_t pitchOrLinearSize;
+		uint32_t depth;
+		uint32_t mipMapCount;
+		uint32_t reserved1[11];
+		DDS_PIXELFORMAT pixelFormat;
+		uint32_t caps[4];
+		uint32_t reserved2;
+	};
+
+	struct DDS_HEADER_DXT10
+	{
+		uint32_t dxgiFormat;
+		uint32_t resourceDimension;
+		uint32_t miscFlag;
+		uint32_t arraySize;
+		uint32_t miscFlags2;
+	};
+
+	/***********************************************************
+	 *  ReadFile()
+	 *
+	 *  This function is used for reading a whole file, from
+	 *  the asset pack when it holds the file.
+	 ***********************************************************/
+	bool ReadFile(const char* filename, std::vector<unsigned char>& file)
+	{
+		AssetPack::ASSET_VIEW view;
+		if (AssetPack::Find(filename, view) == true)
+		{
+			file.assign(view.pData, view.pData + view.size);
+			return(view.size > 0);
+		}
+
+		FILE* pFile = fopen(filename, "rb");
+		if (NULL == pFile)
+		{
+			return(false);
+		}
+
+		fseek(pFile, 0, SEEK_END);
+		long size = ftell(pFile);
+		fseek(pFile, 0, SEEK_SET);
+
+		file.resize((size > 0) ? (size_t)size : 0);
+		bool bRead = (size > 0) && (fread(&file[0], 1, file.size(), pFile) == file.size());
+		fclose(pFile);
+
+		return(bRead);
+	}
+
+	bool FileExists(const std::string& filename)
+	{
+		if (AssetPack::Contains(filename.c_str()) == true)
+		{
+			return(true);
+		}
+		FILE* pFile = fopen(filename.c_str(), "rb");
+		if (NULL == pFile)
+		{
+			return(false);
+		}
+		fclose(pFile);
+		return(true);
+	}
+
+	/***********************************************************
+	 *  To565()
+	 *
+	 *  This function is used for rounding an RGB color to the
+	 *  5:6:5 bits of a BC1 endpoint.
+	 ***********************************************************/
+	uint16_t To565(const int color[3])
+	{
+		return((uint16_t)((((color[0] * 31 + 127) / 255) << 11) |
+			(((color[1] * 63 + 127) / 255) << 5) |
+			((color[2] * 31 + 127) / 255)));
+	}
+
+	void From565(uint16_t packed, int color[3])
+	{
+		int r = (packed >> 11) & 31;
+		int g = (packed >> 5) & 63;
+		int b = packed & 31;
+		color[0] = (r << 3) | (r >> 2);
+		color[1] = (g << 2) | (g >> 4);
+		color[2] = (b << 3) | (b >> 2);
+	}
+
+	/***********************************************************
+	 *  EncodeColorBlock()
+	 *
+	 *  This function is used for encoding the colors of 4x4
+	 *  RGBA texels into a BC1 block. The endpoints are the
+	 *  corners of the bounding box of the colors, inset by a
+	 *  sixteenth of its size, which is fast and close to the
+	 *  error of a search for the best endpoints.
+	 ***********************************************************/
+	void EncodeColorBlock(const unsigned char texels[16][4], unsigned char* pBlock)
+	{
+		int minColor[3] = { 255, 255, 255 };
+		int maxColor[3] = { 0, 0, 0 };
+		for (int i = 0; i < 16; i++)
+		{
+			for (int c = 0; c < 3; c++)
+			{
+				minColor[c] = std::min(minColor[c], (int)texels[i][c]);
+				maxColor[c] = std::max(maxColor[c], (int)texels[i][c]);
+			}
+		}
+		for (int c = 0; c < 3; c++)
+		{
+			int inset = (maxColor[c] - minColor[c]) >> 4;
+			minColor[c] += inset;
+			maxColor[c] -= inset;
+		}
+
+		// the larger endpoint first selects the four color mode
+		uint16_t color0 = To565(maxColor);
+		uint16_t color1 = To565(minColor);
+		uint32_t indices = 0;
+		if (color0 != color1)
+		{
+			int palette[4][3];
+			From565(color0, palette[0]);
+			From565(color1, palette[1]);
+			for (int c = 0; c < 3; c++)
+			{
+				palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+				palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+			}
+
+			for (int i = 0; i < 16; i++)
+			{
+				int bestIndex = 0;
+				int bestError = INT32_MAX;
+				for (int p = 0; p < 4; p++)
+				{
+					int error = 0;
+					for (int c = 0; c < 3; c++)
+					{
+						int difference = (int)texels[i][c] - palette[p][c];
+						error += difference * difference;
+					}
+					if (error < bestError)
+					{
+						bestError = error;
+						bestIndex = p;
+					}
+				}
+				indices |= (uint32_t)bestIndex << (2 * i);
+			}
+		}
+
+		pBlock[0] = (unsigned char)(color0 & 0xFF);
+		pBlock[1] = (unsigned char)(color0 >> 8);
+		pBlock[2] = (unsigned char)(color1 & 0xFF);
+		pBlock[3] = (unsigned char)(color1 >> 8);
+		for (int i = 0; i < 4; i++)
+		{
+			pBlock[4 + i] = (unsigned char)(indices >> (8 * i));
+		}
+	}
+
+	/***********************************************************
+	 *  EncodeAlphaBlock()
+	 *
+	 *  This function is used for encoding the alpha of 4x4
+	 *  texels into the alpha block of BC3, between the lowest
+	 *  and highest alpha of the texels.
+	 ***********************************************************/
+	void EncodeAlphaBlock(const unsigned char texels[16][4], unsigned char* pBlock)
+	{
+		int alpha0 = 0;
+		int alpha1 = 255;
+		for (int i = 0; i < 16; i++)
+		{
+			alpha0 = std::max(alpha0, (int)texels[i][3]);
+			alpha1 = std::min(alpha1, (int)texels[i][3]);
+		}
+
+		// the larger alpha first selects the eight alpha mode
+		uint64_t indices = 0;
+		if (alpha0 != alpha1)
+		{
+			int palette[8];
+			palette[0] = alpha0;
+			palette[1] = alpha1;
+			for (int p = 1; p < 7; p++)
+			{
+				palette[p + 1] = ((7 - p) * alpha0 + p * alpha1) / 7;
+			}
+
+			for (int i = 0; i < 16; i++)
+			{
+				int bestIndex = 0;
+				int bestError = INT32_MAX;
+				for (int p = 0; p < 8; p++)
+				{
+					int error = std::abs((int)texels[i][3] - palette[p]);
+					if (error < bestError)
+					{
+						bestError = error;
+						bestIndex = p;
+					}
+				}
+				indices |= (uint64_t)bestIndex << (3 * i);
+			}
+		}
+
+		pBlock[0] = (unsigned char)alpha0;
+		pBlock[1] = (unsigned char)alpha1;
+		for (int i = 0; i < 6; i++)
+		{
+			pBlock[2 + i] = (unsigned char)(indices >> (8 * i));
+		}
+	}
+
+	/***********************************************************
+	 *  FlipColorRows() / FlipAlphaRows()
+	 *
+	 *  These functions are used for reversing the first
+	 *  rowCount rows of texels inside a BC1 color block, with
+	 *  a byte of indices per row, or a BC3 and BC5 alpha block,
+	 *  with twelve bits of indices per row.
+	 ***********************************************************/
+	void FlipColorRows(unsigned char* pBlock, int rowCount)
+	{
+		std::reverse(pBlock + 4, pBlock + 4 + rowCount);
+	}
+
+	void FlipAlphaRows(unsigned char* pBlock, int rowCount)
+	{
+		uint64_t indices = 0;
+		for (int i = 0; i < 6; i++)
+		{
+			indices |= (uint64_t)pBlock[2 + i] << (8 * i);
+		}
+
+		uint64_t flipped = indices;
+		for (int row = 0; row < rowCount; row++)
+		{
+			uint64_t rowIndices = (indices >> (12 * row)) & 0xFFF;
+			int flippedRow = rowCount - 1 - row;
+			flipped &= ~((uint64_t)0xFFF << (12 * flippedRow));
+			flipped |= rowIndices << (12 * flippedRow);
+		}
+
+		for (int i = 0; i < 6; i++)
+		{
+			pBlock[2 + i] = (unsigned char)(flipped >> (8 * i));
+		}
+	}
+
+	/***********************************************************
+	 *  SpreadToRGBA()
+	 *
+	 *  This function is used for copying texels of 1 to 4
+	 *  channels as RGBA, gray spread over the color channels
+	 *  and alpha opaque when there is none.
+	 ***********************************************************/
+	void SpreadToRGBA(const unsigned char* pixels, size_t texelCount, int colorChannels, unsigned char* pRGBA)
+	{
+		for (size_t i = 0; i < texelCount; i++)
+		{
+			const unsigned char* pTexel = pixels + i * colorChannels;
+			for (int c = 0; c < 4; c++)
+			{
+				if (colorChannels < 3)
+				{
+					pRGBA[i * 4 + c] = (c < 3) ? pTexel[0] : ((colorChannels == 2) ? pTexel[1] : 255);
+				}
+				else
+				{
+					pRGBA[i * 4 + c] = (c < colorChannels) ? pTexel[c] : 255;
+				}
+			}
+		}
+	}
+}
+
+/***********************************************************
+ *  CompressedTexture()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+CompressedTexture::CompressedTexture()
+{
+	Clear();
+}
+
+/***********************************************************
+ *  Clear()
+ *
+ *  This method is used for dropping the loaded levels.
+ ***********************************************************/
+void CompressedTexture::Clear()
+{
+	m_format = FORMAT_NONE;
+	m_width = 0;
+	m_height = 0;
+	m_levels.clear();
+	m_data.clear();
+}
+
+/***********************************************************
+ *  GetFormatName()
+ *
+ *  This method is used for getting the name of a format, as
+ *  taken by the converter.
+ ***********************************************************/
+const char* CompressedTexture::GetFormatName(FORMAT format)
+{
+	if ((format < FORMAT_NONE) || (format >= FORMAT_COUNT))
+	{
+		format = FORMAT_NONE;
+	}
+	return(g_Formats[format].name);
+}
+
+/***********************************************************
+ *  FindFormat()
+ *
+ *  This method is used for looking up a format by its name.
+ ***********************************************************/
+CompressedTexture::FORMAT CompressedTexture::FindFormat(const char* name)
+{
+	for (int i = 0; i < FORMAT_COUNT; i++)
+	{
+		if (strcmp(g_Formats[i].name, name) == 0)
+		{
+			return((FORMAT)i);
+		}
+	}
+	return(FORMAT_NONE);
+}
+
+/***********************************************************
+ *  IsFormatSupported()
+ *
+ *  This method is used for checking that the GL context can
+ *  sample textures of a format. S3TC and ASTC are extensions
+ *  on every GL version, RGTC and BPTC are core in 3.0 and
+ *  4.2.
+ ***********************************************************/
+bool CompressedTexture::IsFormatSupported(FORMAT format)
+{
+	switch (format)
+	{
+	case FORMAT_BC1:
+	case FORMAT_BC3:
+		return(GLEW_EXT_texture_compression_s3tc == GL_TRUE);
+	case FORMAT_BC5:
+		return((GLEW_VERSION_3_0 == GL_TRUE) || (GLEW_ARB_texture_compression_rgtc == GL_TRUE));
+	case FORMAT_BC7:
+		return((GLEW_VERSION_4_2 == GL_TRUE) || (GLEW_ARB_texture_compression_bptc == GL_TRUE));
+	case FORMAT_ASTC_4x4:
+	case FORMAT_ASTC_6x6:
+	case FORMAT_ASTC_8x8:
+		return(GLEW_KHR_texture_compression_astc_ldr == GL_TRUE);
+	default:
+		return(false);
+	}
+}
+
+/***********************************************************
+ *  IsCompressedFile()
+ *
+ *  This method is used for checking if a file name has the
+ *  extension of a KTX2 or DDS file.
+ ***********************************************************/
+bool CompressedTexture::IsCompressedFile(const std::string& filename)
+{
+	size_t dot = filename.find_last_of('.');
+	if (dot == std::string::npos)
+	{
+		return(false);
+	}
+
+	std::string extension = filename.substr(dot + 1);
+	std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+	return((extension == "ktx2") || (extension == "dds"));
+}
+
+/***********************************************************
+ *  FindCompressedFile()
+ *
+ *  This method is used for finding the compressed file of
+ *  an image, so a scene lists its JPEG and PNG sources and
+ *  picks up their converted files once they exist.
+ ***********************************************************/
+std::string CompressedTexture::FindCompressedFile(const std::string& imageFilename)
+{
+	if (IsCompressedFile(imageFilename) == true)
+	{
+		return(FileExists(imageFilename) ? imageFilename : std::string());
+	}
+
+	size_t dot = imageFilename.find_last_of('.');
+	size_t slash = imageFilename.find_last_of("/\\");
+	std::string stem = imageFilename;
+	if ((dot != std::string::npos) && ((slash == std::string::npos) || (dot > slash)))
+	{
+		stem = imageFilename.substr(0, dot);
+	}
+
+	const char* const extensions[] = { ".ktx2", ".dds" };
+	for (int i = 0; i < 2; i++)
+	{
+		std::string filename = stem + extensions[i];
+		if (FileExists(filename) == true)
+		{
+			return(filename);
+		}
+	}
+	return(std::string());
+}
+
+/***********************************************************
+ *  SetLevels()
+ *
+ *  This method is used for laying out the mip levels of a
+ *  texture of the base size in the format, each level half
+ *  the size of the one above it.
+ ***********************************************************/
+bool CompressedTexture::SetLevels(int width, int height, int levelCount)
+{
+	if ((m_format <= FORMAT_NONE) || (m_format >= FORMAT_COUNT) ||
+		(width <= 0) || (height <= 0) || (levelCount <= 0))
+	{
+		return(false);
+	}
+
+	// a level never gets smaller than 1x1
+	int fullLevelCount = 1;
+	while (((width | height) >> fullLevelCount) != 0)
+	{
+		fullLevelCount++;
+	}
+
+	const FORMAT_INFO& info = g_Formats[m_format];
+	m_width = width;
+	m_height = height;
+	m_levels.resize(std::min(levelCount, fullLevelCount));
+	size_t offset = 0;
+	for (size_t i = 0; i < m_levels.size(); i++)
+	{
+		LEVEL& level = m_levels[i];
+		level.width = std::max(width >> i, 1);
+		level.height = std::max(height >> i, 1);
+		level.offset = offset;
+		level.size = (size_t)((level.width + info.blockWidth - 1) / info.blockWidth) *
+			(size_t)((level.height + info.blockHeight - 1) / info.blockHeight) * info.blockBytes;
+		offset += level.size;
+	}
+	m_data.resize(offset);
+
+	return(true);
+}
+
+/***********************************************************
+ *  Load()
+ *
+ *  This method is used for loading a KTX2 or DDS file and
+ *  flipping its blocks into the row order of GL.
+ ***********************************************************/
+bool CompressedTexture::Load(const char* filename)
+{
+	Clear();
+
+	std::vector<unsigned char> file;
+	if (ReadFile(filename, file) == false)
+	{
+		std::cout << "Could not read compressed texture " << filename << std::endl;
+		return(false);
+	}
+
+	bool bLoaded = false;
+	bool bTopDown = true;
+	if ((file.size() >= sizeof(KTX2_HEADER)) && (memcmp(&file[0], KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) == 0))
+	{
+		bLoaded = LoadKTX2(file);
+
+		// the orientation defaults to rows top down, "rd"
+		const KTX2_HEADER* pHeader = (const KTX2_HEADER*)&file[0];
+		size_t position = pHeader->kvdByteOffset;
+		size_t end = std::min((size_t)pHeader->kvdByteOffset + pHeader->kvdByteLength, file.size());
+		while ((true == bLoaded) && (position + 4 <= end))
+		{
+			uint32_t length = 0;
+			memcpy(&length, &file[position], sizeof(length));
+			const char* pKey = (const char*)&file[position + 4];
+			if ((position + 4 + length <= end) && (length > 15) && (strncmp(pKey, "KTXorientation", 15) == 0))
+			{
+				bTopDown = (length < 17) || (pKey[16] != 'u');
+			}
+			position += (4 + length + 3) & ~(size_t)3;
+		}
+	}
+	else if ((file.size() >= 4 + sizeof(DDS_HEADER)) && (*(const uint32_t*)&file[0] == DDS_MAGIC))
+	{
+		bLoaded = LoadDDS(file);
+	}
+	else
+	{
+		std::cout << "Compressed texture " << filename << " is neither a KTX2 nor a DDS file" << std::endl;
+		return(false);
+	}
+
+	if (false == bLoaded)
+	{
+		std::cout << "Could not load compressed texture " << filename << std::endl;
+		Clear();
+		return(false);
+	}
+	if ((true == bTopDown) && (FlipVertically() == false))
+	{
+		std::cout << "Compressed texture " << filename << " stores " << GetFormatName(m_format)
+			<< " blocks top down, which cannot be flipped, so it shows upside down" << std::endl;
+	}
+
+	return(true);
+}
+
+/***********************************************************
+ *  LoadKTX2()
+ *
+ *  This method is used for reading the levels of a KTX2 file
+ *  holding one 2D texture without supercompression.
+ ***********************************************************/
+bool CompressedTexture::LoadKTX2(const std::vector<unsigned char>& file)
+{
+	KTX2_HEADER header;
+	memcpy(&header, &file[0], sizeof(header));
+
+	if (header.supercompressionScheme != 0)
+	{
+		std::cout << "Supercompressed KTX2 files are not supported" << std::endl;
+		return(false);
+	}
+	if ((header.pixelDepth > 1) || (header.layerCount > 1) || (header.faceCount != 1))
+	{
+		std::cout << "Only 2D KTX2 textures are supported" << std::endl;
+		return(false);
+	}
+
+	m_format = FORMAT_NONE;
+	for (int i = FORMAT_NONE + 1; i < FORMAT_COUNT; i++)
+	{
+		if (g_Formats[i].vkFormat == header.vkFormat)
+		{
+			m_format = (FORMAT)i;
+		}
+	}
+	if (header.vkFormat == VK_FORMAT_BC1_RGBA)
+	{
+		m_format = FORMAT_BC1;
+	}
+	if (m_format == FORMAT_NONE)
+	{
+		std::cout << "Unsupported KTX2 format " << header.vkFormat << std::endl;
+		return(false);
+	}
+
+	int levelCount = std::max((int)header.levelCount, 1);
+	if ((SetLevels((int)header.pixelWidth, (int)header.pixelHeight, levelCount) == false) ||
+		(sizeof(KTX2_HEADER) + levelCount * sizeof(KTX2_LEVEL) > file.size()))
+	{
+		return(false);
+	}
+
+	for (size_t i = 0; i < m_levels.size(); i++)
+	{
+		KTX2_LEVEL level;
+		memcpy(&level, &file[sizeof(KTX2_HEADER) + i * sizeof(KTX2_LEVEL)], sizeof(level));
+		if ((level.byteLength != m_levels[i].size) || (level.byteOffset + level.byteLength > file.size()))
+		{
+			return(false);
+		}
+		memcpy(&m_data[m_levels[i].offset], &file[(size_t)level.byteOffset], m_levels[i].size);
+	}
+
+	return(true);
+}
+
+/***********************************************************
+ *  LoadDDS()
+ *
+ *  This method is used for reading the levels of a DDS file,
+ *  with a legacy FourCC or a DX10 header naming its format.
+ ***********************************************************/
+bool CompressedTexture::LoadDDS(const std::vector<unsigned char>& file)
+{
+	DDS_HEADER header;
+	memcpy(&header, &file[4], sizeof(header));
+	size_t dataOffset = 4 + sizeof(DDS_HEADER);
+
+	if ((header.size != sizeof(DDS_HEADER)) || ((header.pixelFormat.flags & DDPF_FOURCC) == 0))
+	{
+		std::cout << "Only block compressed DDS files are supported" << std::endl;
+		return(false);
+	}
+
+	m_format = FORMAT_NONE;
+	const uint32_t fourCC = header.pixelFormat.fourCC;
+	if (fourCC == MakeFourCC('D', 'X', '1', '0'))
+	{
+		if (file.size() < dataOffset + sizeof(DDS_HEADER_DXT10))
+		{
+			return(false);
+		}
+		DDS_HEADER_DXT10 header10;
+		memcpy(&header10, &file[dataOffset], sizeof(header10));
+		dataOffset += sizeof(DDS_HEADER_DXT10);
+
+		if ((header10.resourceDimension != DDS_DIMENSION_TEXTURE2D) || (header10.arraySize > 1))
+		{
+			std::cout << "Only 2D DDS textures are supported" << std::endl;
+			return(false);
+		}
+		for (int i = FORMAT_NONE + 1; i < FORMAT_COUNT; i++)
+		{
+			if ((g_Formats[i].dxgiFormat != 0) && (g_Formats[i].dxgiFormat == header10.dxgiFormat))
+			{
+				m_format = (FORMAT)i;
+			}
+		}
+	}
+	else if (fourCC == MakeFourCC('D', 'X', 'T', '1'))
+	{
+		m_format = FORMAT_BC1;
+	}
+	else if (fourCC == MakeFourCC('D', 'X', 'T', '5'))
+	{
+		m_format = FORMAT_BC3;
+	}
+	else if ((fourCC == MakeFourCC('A', 'T', 'I', '2')) || (fourCC == MakeFourCC('B', 'C', '5', 'U')))
+	{
+		m_format = FORMAT_BC5;
+	}
+	if (m_format == FORMAT_NONE)
+	{
+		std::cout << "Unsupported DDS format" << std::endl;
+		return(false);
+	}
+
+	int levelCount = ((header.flags & DDSD_MIPMAPCOUNT) != 0) ? std::max((int)header.mipMapCount, 1) : 1;
+	if ((SetLevels((int)header.width, (int)header.height, levelCount) == false) ||
+		(dataOffset + m_data.size() > file.size()))
+	{
+		return(false);
+	}
+
+	// the levels follow the headers, largest first
+	memcpy(&m_data[0], &file[dataOffset], m_data.size());
+	return(true);
+}
+
+/***********************************************************
+ *  FlipVertically()
+ *
+ *  This method is used for reversing the rows of every level
+ *  by reversing the rows of blocks and the texel rows inside
+ *  each block. The formats whose blocks keep their rows in
+ *  separate bits can be flipped this way, BC7 and ASTC can
+ *  not. Levels of a height that is not a multiple of four
+ *  keep the padding rows of their top blocks at the top.
+ ***********************************************************/
+bool CompressedTexture::FlipVertically()
+{
+	if ((m_format != FORMAT_BC1) && (m_format != FORMAT_BC3) && (m_format != FORMAT_BC5))
+	{
+		return(false);
+	}
+
+	const int blockBytes = g_Formats[m_format].blockBytes;
+	std::vector<unsigned char> blockRow;
+	for (size_t i = 0; i < m_levels.size(); i++)
+	{
+		const LEVEL& level = m_levels[i];
+		const int blocksX = (level.width + 3) / 4;
+		const int blocksY = (level.height + 3) / 4;
+		const size_t rowBytes = (size_t)blocksX * blockBytes;
+		unsigned char* pLevel = &m_data[level.offset];
+
+		blockRow.resize(rowBytes);
+		for (int y = 0; y < blocksY / 2; y++)
+		{
+			unsigned char* pTop = pLevel + y * rowBytes;
+			unsigned char* pBottom = pLevel + (blocksY - 1 - y) * rowBytes;
+			memcpy(&blockRow[0], pTop, rowBytes);
+			memcpy(pTop, pBottom, rowBytes);
+			memcpy(pBottom, &blockRow[0], rowBytes);
+		}
+
+		const int rowCount = std::min(level.height, 4);
+		for (int block = 0; block < blocksX * blocksY; block++)
+		{
+			unsigned char* pBlock = pLevel + block * blockBytes;
+			if (m_format == FORMAT_BC1)
+			{
+				FlipColorRows(pBlock, rowCount);
+			}
+			else if (m_format == FORMAT_BC3)
+			{
+				FlipAlphaRows(pBlock, rowCount);
+				FlipColorRows(pBlock + 8, rowCount);
+			}
+			else
+			{
+				FlipAlphaRows(pBlock, rowCount);
+				FlipAlphaRows(pBlock + 8, rowCount);
+			}
+		}
+	}
+
+	return(true);
+}
+
+/***********************************************************
+ *  Encode()
+ *
+ *  This method is used for encoding an image and its mip
+ *  levels into BC1 or BC3 blocks. The levels the pixels do
+ *  not hold are box filtered from the one above, the texels
+ *  past the right and bottom edges of a level repeating its
+ *  last column and row.
+ ***********************************************************/
+bool CompressedTexture::Encode(const unsigned char* pixels, int width, int height, int colorChannels, FORMAT format,
+	int levelCount)
+{
+	Clear();
+	if (((format != FORMAT_BC1) && (format != FORMAT_BC3)) || (colorChannels < 1) || (colorChannels > 4))
+	{
+		return(false);
+	}
+
+	m_format = format;
+	if (SetLevels(width, height, INT32_MAX) == false)
+	{
+		Clear();
+		return(false);
+	}
+
+	// RGBA copy of the level being encoded
+	std::vector<unsigned char> level;
+	const int blockBytes = g_Formats[m_format].blockBytes;
+	for (size_t i = 0; i < m_levels.size(); i++)
+	{
+		const int levelWidth = m_levels[i].width;
+		const int levelHeight = m_levels[i].height;
+		if ((i == 0) || ((int)i < levelCount))
+		{
+			level.resize((size_t)levelWidth * levelHeight * 4);
+			SpreadToRGBA(pixels + MipChain::GetLevelOffset(width, height, colorChannels, (int)i),
+				(size_t)levelWidth * levelHeight, colorChannels, &level[0]);
+		}
+		else
+		{
+			// average the 2x2 texels of the level above each texel
+			const int aboveWidth = m_levels[i - 1].width;
+			const int aboveHeight = m_levels[i - 1].height;
+			std::vector<unsigned char> above;
+			above.swap(level);
+			level.resize((size_t)levelWidth * levelHeight * 4);
+			for (int y = 0; y < levelHeight; y++)
+			{
+				int y0 = std::min(y * 2, aboveHeight - 1);
+				int y1 = std::min(y * 2 + 1, aboveHeight - 1);
+				for (int x = 0; x < levelWidth; x++)
+				{
+					int x0 = std::min(x * 2, aboveWidth - 1);
+					int x1 = std::min(x * 2 + 1, aboveWidth - 1);
+					for (int c = 0; c < 4; c++)
+					{
+						int sum = above[((size_t)y0 * aboveWidth + x0) * 4 + c] + above[((size_t)y0 * aboveWidth + x1) * 4 + c] +
+							above[((size_t)y1 * aboveWidth + x0) * 4 + c] + above[((size_t)y1 * aboveWidth + x1) * 4 + c];
+						level[((size_t)y * levelWidth + x) * 4 + c] = (unsigned char)((sum + 2) / 4);
+					}
+				}
+			}
+		}
+
+		unsigned char* pBlock = &m_data[m_levels[i].offset];
+		for (int blockY = 0; blockY < levelHeight; blockY += 4)
+		{
+			for (int blockX = 0; blockX < levelWidth; blockX += 4)
+			{
+				unsigned char texels[16][4];
+				for (int t = 0; t < 16; t++)
+				{
+					int x = std::min(blockX + (t & 3), levelWidth - 1);
+					int y = std::min(blockY + (t >> 2), levelHeight - 1);
+					memcpy(texels[t], &level[((size_t)y * levelWidth + x) * 4], 4);
+				}
+
+				if (m_format == FORMAT_BC3)
+				{
+					EncodeAlphaBlock(texels, pBlock);
+					EncodeColorBlock(texels, pBlock + 8);
+				}
+				else
+				{
+					EncodeColorBlock(texels, pBlock);
+				}
+				pBlock += blockBytes;
+			}
+		}
+	}
+
+	return(true);
+}
+
+/***********************************************************
+ *  SaveKTX2()
+ *
+ *  This method is used for writing the levels into a KTX2
+ *  file with rows top down, its default orientation. The
+ *  data format descriptor is only written for BC1 and BC3,
+ *  the formats the converter encodes.
+ ***********************************************************/
+bool CompressedTexture::SaveKTX2(const char* filename) const
+{
+	if (((m_format != FORMAT_BC1) && (m_format != FORMAT_BC3)) || (m_levels.empty() == true))
+	{
+		return(false);
+	}
+	const FORMAT_INFO& info = g_Formats[m_format];
+
+	// basic data format descriptor block, one sample per 64 bits
+	const uint32_t sampleCount = (m_format == FORMAT_BC3) ? 2 : 1;
+	const uint32_t blockSize = 24 + 16 * sampleCount;
+	std::vector<uint32_t> dfd;
+	dfd.push_back(4 + blockSize);
+	dfd.push_back(0);
+	dfd.push_back(2 | (blockSize << 16));
+	dfd.push_back(((m_format == FORMAT_BC3) ? KHR_DF_MODEL_BC3 : KHR_DF_MODEL_BC1A) |
+		(KHR_DF_PRIMARIES_BT709 << 8) | (KHR_DF_TRANSFER_LINEAR << 16));
+	dfd.push_back((uint32_t)(info.blockWidth - 1) | ((uint32_t)(info.blockHeight - 1) << 8));
+	dfd.push_back((uint32_t)info.blockBytes);
+	dfd.push_back(0);
+	for (uint32_t i = 0; i < sampleCount; i++)
+	{
+		uint32_t channel = ((m_format == FORMAT_BC3) && (i == 0)) ? KHR_DF_CHANNEL_BC3_ALPHA : KHR_DF_CHANNEL_COLOR;
+		dfd.push_back((64 * i) | (63 << 16) | (channel << 24));
+		dfd.push_back(0);
+		dfd.push_back(0);
+		dfd.push_back(0xFFFFFFFF);
+	}
+
+	KTX2_HEADER header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.identifier, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER));
+	header.vkFormat = info.vkFormat;
+	header.typeSize = 1;
+	header.pixelWidth = (uint32_t)m_width;
+	header.pixelHeight = (uint32_t)m_height;
+	header.faceCount = 1;
+	header.levelCount = (uint32_t)m_levels.size();
+	header.dfdByteOffset = (uint32_t)(sizeof(KTX2_HEADER) + m_levels.size() * sizeof(KTX2_LEVEL));
+	header.dfdByteLength = (uint32_t)(dfd.size() * sizeof(uint32_t));
+
+	// the levels are stored smallest first, each aligned to a block
+	std::vector<KTX2_LEVEL> levels(m_levels.size());
+	uint64_t offset = header.dfdByteOffset + header.dfdByteLength;
+	for (size_t i = m_levels.size(); i > 0; i--)
+	{
+		offset = (offset + info.blockBytes - 1) / info.blockBytes * info.blockBytes;
+		levels[i - 1].byteOffset = offset;
+		levels[i - 1].byteLength = m_levels[i - 1].size;
+		levels[i - 1].uncompressedByteLength = m_levels[i - 1].size;
+		offset += m_levels[i - 1].size;
+	}
+
+	FILE* pFile = fopen(filename, "wb");
+	if (NULL == pFile)
+	{
+		std::cout << "Could not create compressed texture " << filename << std::endl;
+		return(false);
+	}
+
+	bool bWritten = (fwrite(&header, sizeof(header), 1, pFile) == 1) &&
+		(fwrite(&levels[0], sizeof(KTX2_LEVEL), levels.size(), pFile) == levels.size()) &&
+		(fwrite(&dfd[0], sizeof(uint32_t), dfd.size(), pFile) == dfd.size());
+	uint64_t position = header.dfdByteOffset + header.dfdByteLength;
+	const unsigned char padding[16] = { 0 };
+	for (size_t i = m_levels.size(); (i > 0) && (true == bWritten); i--)
+	{
+		size_t paddingBytes = (size_t)(levels[i - 1].byteOffset - position);
+		bWritten = ((paddingBytes == 0) || (fwrite(padding, 1, paddingBytes, pFile) == paddingBytes)) &&
+			(fwrite(&m_data[m_levels[i - 1].offset], 1, m_levels[i - 1].size, pFile) == m_levels[i - 1].size);
+		position = levels[i - 1].byteOffset + levels[i - 1].byteLength;
+	}
+	fclose(pFile);
+
+	if (false == bWritten)
+	{
+		std::cout << "Could not write compressed texture " << filename << std::endl;
+	}
+	return(bWritten);
+}
+
+/***********************************************************
+ *  CompressImageFile()
+ *
+ *  This method is used for converting a JPEG or PNG file to
+ *  a KTX2 file offline. The rows are decoded top down, the
+ *  order the file keeps them in.
+ ***********************************************************/
+bool CompressedTexture::CompressImageFile(const char* imageFilename, const char* filename, FORMAT format)
+{
+	ImageDecoder::IMAGE image;
+	if (ImageDecoder::Decode(imageFilename, image, false) == false)
+	{
+		std::cout << "Could not load image:" << imageFilename << std::endl;
+		return(false);
+	}
+
+	if (format == FORMAT_NONE)
+	{
+		format = (ImageDecoder::HasAlpha(image.fileChannels) == true) ? FORMAT_BC3 : FORMAT_BC1;
+	}
+
+	CompressedTexture texture;
+	bool bCompressed = texture.Encode(image.pixels, image.width, image.height, image.colorChannels, format, image.levelCount) &&
+		texture.SaveKTX2(filename);
+	if (true == bCompressed)
+	{
+		std::cout << "Compressed " << imageFilename << " into " << filename << ", " << GetFormatName(format)
+			<< ", " << texture.GetLevelCount() << " levels" << std::endl;
+	}
+	else
+	{
+		std::cout << "Could not compress " << imageFilename << " into " << GetFormatName(format) << std::endl;
+	}
+
+	ImageDecoder::Free(image);
+	return(bCompressed);
+}
+
+/***********************************************************
+ *  CreateGLTexture()
+ *
+ *  This method is used for creating a texture of the loaded
+ *  levels, with the same wrapping and filtering as the
+ *  textures decoded from images. Skipping the first levels
+ *  gives a smaller texture for when memory is short.
+ ***********************************************************/
+GLuint CompressedTexture::CreateGLTexture(int firstLevel) const
+{
+	if ((firstLevel < 0) || (firstLevel >= (int)m_levels.size()) || (IsFormatSupported(m_format) == false))
+	{
+		return(0);
+	}
+
+	const GLenum internalFormat = g_Formats[m_format].internalFormat;
+	const size_t levelCount = m_levels.size() - firstLevel;
+	GLuint textureID = 0;
+	if (ShapeMeshes::HasDirectStateAccess() == true)
+	{
+		glCreateTextures(GL_TEXTURE_2D, 1, &textureID);
+		glTextureStorage2D(textureID, (GLsizei)levelCount, internalFormat,
+			m_levels[firstLevel].width, m_levels[firstLevel].height);
+		for (size_t i = 0; i < levelCount; i++)
+		{
+			const LEVEL& level = m_levels[firstLevel + i];
+			glCompressedTextureSubImage2D(textureID, (GLint)i, 0, 0, level.width, level.height,
+				internalFormat, (GLsizei)level.size, &m_data[level.offset]);
+		}
+
+		// set the texture wrapping parameters
+		glTextureParameteri(textureID, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		glTextureParameteri(textureID, GL_TEXTURE_WRAP_T, GL_REPEAT);
+		// set texture filtering parameters
+		glTextureParameteri(textureID, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTextureParameteri(textureID, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	}
+	else
+	{
+		glGenTextures(1, &textureID);
+		GLuint previousTexture = ShapeMeshes::BindTextureForEdit(GL_TEXTURE_2D, textureID);
+		for (size_t i = 0; i < levelCount; i++)
+		{
+			const LEVEL& level = m_levels[firstLevel + i];
+			glCompressedTexImage2D(GL_TEXTURE_2D, (GLint)i, internalFormat, level.width, level.height, 0,
+				(GLsizei)level.size, &m_data[level.offset]);
+		}
+		// a file may hold fewer levels than the full chain
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)levelCount - 1);
+
+		// set the texture wrapping parameters
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+		// set texture filtering parameters
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		ShapeMeshes::RestoreTextureBinding(GL_TEXTURE_2D, previousTexture);
+	}
+	GPUMemory::TrackTexture(textureID, internalFormat, m_levels[firstLevel].width, m_levels[firstLevel].height, 1,
+		(int)levelCount, GPUMemory::CATEGORY_TEXTURE, "compressed texture");
+
+	return(textureID);
+}
@@ -0,0 +1,108 @@
+///////////////////////////////////////////////////////////////////////////////
+// compressedtexture.h
+// ============
+// block compressed textures with precomputed mip chains
+//
+//  Loads KTX2 and DDS files holding BC1, BC3, BC5, BC7 or ASTC blocks
+//  and uploads their mip levels as they are, so a texture takes a
+//  quarter to an eighth of the memory of the RGB8 or RGBA8 texture
+//  decoded from its JPEG or PNG source. The offline converter encodes
+//  those sources into BC1 or BC3 KTX2 files.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+#include <string>
+#include <vector>
+
+/***********************************************************
+ *  CompressedTexture
+ *
+ *  This class contains the blocks of every mip level of one
+ *  compressed texture, largest level first.
+ ***********************************************************/
+class CompressedTexture
+{
+public:
+	// constructor
+	CompressedTexture();
+
+	enum FORMAT
+	{
+		FORMAT_NONE = 0,
+		FORMAT_BC1,
+		FORMAT_BC3,
+		FORMAT_BC5,
+		FORMAT_BC7,
+		FORMAT_ASTC_4x4,
+		FORMAT_ASTC_6x6,
+		FORMAT_ASTC_8x8,
+		FORMAT_COUNT
+	};
+
+	// place of one mip level in the block data
+	struct LEVEL
+	{
+		int width;
+		int height;
+		size_t offset;
+		size_t size;
+	};
+
+	// load a KTX2 or DDS file, told apart by their magic
+	bool Load(const char* filename);
+	// write the levels into a KTX2 file
+	bool SaveKTX2(const char* filename) const;
+	// encode RGB or RGBA pixels, top row first, into every mip
+	// level; pixels holding the first levelCount levels of a chain,
+	// as ImageDecoder hands them over, are encoded as they are and
+	// the others are filtered. Only FORMAT_BC1 and FORMAT_BC3 can
+	// be encoded
+	bool Encode(const unsigned char* pixels, int width, int height, int colorChannels, FORMAT format,
+		int levelCount = 1);
+
+	// offline converter from a JPEG or PNG file to a KTX2 file;
+	// FORMAT_NONE picks BC3 for images with alpha and BC1 for others
+	static bool CompressImageFile(const char* imageFilename, const char* filename, FORMAT format);
+	// the KTX2 or DDS file standing in for an image file: the file
+	// itself when it is one, else one with the same name next to it;
+	// empty when there is none
+	static std::string FindCompressedFile(const std::string& imageFilename);
+	static bool IsCompressedFile(const std::string& filename);
+
+	// true when the context can sample textures of the format
+	static bool IsFormatSupported(FORMAT format);
+	static const char* GetFormatName(FORMAT format);
+	// format of a name from GetFormatName(), FORMAT_NONE if unknown
+	static FORMAT FindFormat(const char* name);
+
+	// texture holding the levels from firstLevel down, 0 when the
+	// format is not supported
+	GLuint CreateGLTexture(int firstLevel = 0) const;
+
+	FORMAT GetFormat() const { return(m_format); }
+	int GetWidth() const { return(m_width); }
+	int GetHeight() const { return(m_height); }
+	int GetLevelCount() const { return((int)m_levels.size()); }
+	// only BC3 keeps a full alpha channel for the transparent draws
+	bool HasAlpha() const { return(m_format == FORMAT_BC3); }
+
+private:
+	FORMAT m_format;
+	int m_width;
+	int m_height;
+	std::vector<LEVEL> m_levels;
+	std::vector<unsigned char> m_data;
+
+	void Clear();
+	bool LoadDDS(const std::vector<unsigned char>& file);
+	bool LoadKTX2(const std::vector<unsigned char>& file);
+	// lay out the levels of a base size in the block data, false
+	// for sizes the format cannot hold
+	bool SetLevels(int width, int height, int levelCount);
+	// GL reads the first row as the bottom of a texture, while the
+	// files store the top row first
+	bool FlipVertically();
+};
@@ -0,0 +1,191 @@
+///////////////////////////////////////////////////////////////////////////////
+// deferredpass.cpp
+// ============
+// deferred shading of the opaque draws
+//
+//  The opaque draws only write their albedo, normal and material into
+//  a G-buffer, which one full screen pass then lights, so the lighting
+//  cost follows the pixel count instead of the drawn geometry.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "DeferredPass.h"
+#include "ShapeMeshes.h"
+#include "ShadowAtlas.h"
+#include "CascadedShadows.h"
+#include "ReflectionProbes.h"
+#include "ShadingRate.h"
+#include "GLTrace.h"
+
+/***********************************************************
+ *  DeferredPass()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+DeferredPass::DeferredPass(ShaderManager* pShaderManager)
+{
+	m_pShaderManager = pShaderManager;
+	m_lightingProgram = 0;
+	m_inverseViewProjectionLocation = -1;
+	m_shadingRatePassLocation = -1;
+	m_lightingVAO = 0;
+}
+
+/***********************************************************
+ *  ~DeferredPass()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+DeferredPass::~DeferredPass()
+{
+	if (0 != m_lightingVAO)
+	{
+		glDeleteVertexArrays(1, &m_lightingVAO);
+		m_lightingVAO = 0;
+	}
+	if (0 != m_lightingProgram)
+	{
+		glDeleteProgram(m_lightingProgram);
+		m_lightingProgram = 0;
+	}
+	m_pShaderManager = NULL;
+}
+
+/***********************************************************
+ *  Create()
+ *
+ *  This method is used for building the lighting program
+ *  and pointing its samplers at the G-buffer units.
+ ***********************************************************/
+bool DeferredPass::Create(
+	const char* lightingVertexPath,
+	const char* lightingFragmentPath)
+{
+	if (NULL == m_pShaderManager)
+	{
+		return(false);
+	}
+
+	m_lightingProgram = m_pShaderManager->LoadExternalProgram(lightingVertexPath, lightingFragmentPath);
+	if (0 == m_lightingProgram)
+	{
+		std::cout << "Deferred shading disabled, its lighting shader did not build" << std::endl;
+		return(false);
+	}
+
+	m_pShaderManager->UseExternalProgram(m_lightingProgram);
+	glUniform1i(glGetUniformLocation(m_lightingProgram, "albedoTexture"), ALBEDO_TEXTURE_UNIT);
+	glUniform1i(glGetUniformLocation(m_lightingProgram, "normalTexture"), NORMAL_TEXTURE_UNIT);
+	glUniform1i(glGetUniformLocation(m_lightingProgram, "materialTexture"), MATERIAL_TEXTURE_UNIT);
+	glUniform1i(glGetUniformLocation(m_lightingProgram, "depthTexture"), DEPTH_TEXTURE_UNIT);
+	glUniform1i(glGetUniformLocation(m_lightingProgram, "shadowAtlas"), ShadowAtlas::SHADOW_ATLAS_TEXTURE_UNIT);
+	glUniform1i(glGetUniformLocation(m_lightingProgram, "cascadeShadowMap"), CascadedShadows::CASCADE_TEXTURE_UNIT);
+	glUniform1i(glGetUniformLocation(m_lightingProgram, "reflectionProbes"), ReflectionProbes::PROBE_TEXTURE_UNIT);
+	glUniform1i(glGetUniformLocation(m_lightingProgram, "shadingRateImage"), ShadingRate::RATE_TEXTURE_UNIT);
+	glUniform1i(glGetUniformLocation(m_lightingProgram, "coarseLighting"), ShadingRate::COARSE_LIGHTING_TEXTURE_UNIT);
+	m_inverseViewProjectionLocation = glGetUniformLocation(m_lightingProgram, "inverseViewProjection");
+	m_shadingRatePassLocation = glGetUniformLocation(m_lightingProgram, "shadingRatePass");
+
+	glGenVertexArrays(1, &m_lightingVAO);
+
+	return(true);
+}
+
+/***********************************************************
+ *  BeginGeometry()
+ *
+ *  This method is used for clearing the G-buffer the opaque
+ *  draws go to. Blending is turned off, since the targets
+ *  hold surface values rather than colors, and material 0
+ *  marks the pixels nothing was drawn to.
+ ***********************************************************/
+void DeferredPass::BeginGeometry()
+{
+	if (IsAvailable() == false)
+	{
+		return;
+	}
+
+	glDisable(GL_BLEND);
+
+	const GLfloat clearColor[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	const GLuint clearMaterial[4] = { 0, 0, 0, 0 };
+	// the farthest depth of the frame, 0 with reverse-Z
+	GLfloat clearDepth = 1.0f;
+	glGetFloatv(GL_DEPTH_CLEAR_VALUE, &clearDepth);
+	glClearBufferfv(GL_COLOR, 0, clearColor);
+	glClearBufferfv(GL_COLOR, 1, clearColor);
+	glClearBufferuiv(GL_COLOR, 2, clearMaterial);
+	glClearBufferfv(GL_DEPTH, 0, &clearDepth);
+}
+
+/***********************************************************
+ *  Light()
+ *
+ *  This method is used for lighting the G-buffer with one
+ *  full screen triangle into the bound framebuffer. The
+ *  pass writes the G-buffer depth along with the color, so
+ *  the occlusion pyramid and the forward transparent draws
+ *  see the same depth as without the deferred path. With
+ *  a rate image, the rasterizer shades its coarse tiles at
+ *  their rate, or a first draw lights them at half the
+ *  resolution, unblended, and the full draw reads the
+ *  light back in them.
+ ***********************************************************/
+void DeferredPass::Light(const glm::mat4& viewProjection,
+	GLuint albedoTexture,
+	GLuint normalTexture,
+	GLuint materialTexture,
+	GLuint depthTexture,
+	ShadingRate* pShadingRate)
+{
+	if (IsAvailable() == false)
+	{
+		return;
+	}
+
+	GLint depthFunc = GL_LESS;
+	glGetIntegerv(GL_DEPTH_FUNC, &depthFunc);
+
+	glEnable(GL_BLEND);
+	glDepthFunc(GL_ALWAYS);
+
+	glm::mat4 inverseViewProjection = glm::inverse(viewProjection);
+	m_pShaderManager->UseExternalProgram(m_lightingProgram);
+	glUniformMatrix4fv(m_inverseViewProjectionLocation, 1, GL_FALSE, &inverseViewProjection[0][0]);
+	m_pShaderManager->BindTexture(ALBEDO_TEXTURE_UNIT, albedoTexture);
+	m_pShaderManager->BindTexture(NORMAL_TEXTURE_UNIT, normalTexture);
+	m_pShaderManager->BindTexture(MATERIAL_TEXTURE_UNIT, materialTexture);
+	m_pShaderManager->BindTexture(DEPTH_TEXTURE_UNIT, depthTexture);
+	ShapeMeshes::BindVertexArray(m_lightingVAO);
+
+	if ((NULL != pShadingRate) && (pShadingRate->IsHardwareRate() == true))
+	{
+		glUniform1i(m_shadingRatePassLocation, ShadingRate::LIGHTING_PASS_FULL);
+		pShadingRate->BeginHardwareRate();
+		GLTrace::RecordDrawArrays(GL_TRIANGLES, 0, 3);
+		glDrawArrays(GL_TRIANGLES, 0, 3);
+		pShadingRate->EndHardwareRate();
+	}
+	else if (NULL != pShadingRate)
+	{
+		glDisable(GL_BLEND);
+		glUniform1i(m_shadingRatePassLocation, ShadingRate::LIGHTING_PASS_COARSE);
+		pShadingRate->BeginCoarseLighting();
+		GLTrace::RecordDrawArrays(GL_TRIANGLES, 0, 3);
+		glDrawArrays(GL_TRIANGLES, 0, 3);
+		pShadingRate->EndCoarseLighting();
+		glEnable(GL_BLEND);
+
+		glUniform1i(m_shadingRatePassLocation, ShadingRate::LIGHTING_PASS_RESOLVE);
+		GLTrace::RecordDrawArrays(GL_TRIANGLES, 0, 3);
+		glDrawArrays(GL_TRIANGLES, 0, 3);
+	}
+	else
+	{
+		glUniform1i(m_shadingRatePassLocation, ShadingRate::LIGHTING_PASS_FULL);
+		GLTrace::RecordDrawArrays(GL_TRIANGLES, 0, 3);
+		glDrawArrays(GL_TRIANGLES, 0, 3);
+	}
+
+	glDepthFunc((GLenum)depthFunc);
+}
@@ -0,0 +1,77 @@
+///////////////////////////////////////////////////////////////////////////////
+// deferredpass.h
+// ============
+// deferred shading of the opaque draws
+//
+//  The opaque draws only write their albedo, normal and material into
+//  a G-buffer, which one full screen pass then lights, so the lighting
+//  cost follows the pixel count instead of the drawn geometry.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "ShaderManager.h"
+
+class ShadingRate;
+
+/***********************************************************
+ *  DeferredPass
+ *
+ *  This class contains the lighting program of the deferred
+ *  path. The G-buffer is a set of transient targets of the
+ *  render graph: BeginGeometry() prepares the opaque draws
+ *  into it and Light() shades it into the scene target,
+ *  writing the depth back so the transparent draws can
+ *  still be drawn forward after it.
+ ***********************************************************/
+class DeferredPass
+{
+public:
+	// constructor
+	DeferredPass(ShaderManager* pShaderManager);
+	// destructor
+	~DeferredPass();
+
+	// texture units the lighting pass reads the G-buffer from, above
+	// the transparency targets
+	static const int ALBEDO_TEXTURE_UNIT = 20;
+	static const int NORMAL_TEXTURE_UNIT = 21;
+	static const int MATERIAL_TEXTURE_UNIT = 22;
+	static const int DEPTH_TEXTURE_UNIT = 23;
+
+	// formats of the G-buffer targets. The material is an integer
+	// so it is never filtered or blended into a different index; the
+	// normals are packed octahedrally into the first two channels of
+	// the format of the TargetFormats tier
+	static const GLenum ALBEDO_FORMAT = GL_RGBA8;
+	static const GLenum MATERIAL_FORMAT = GL_R8UI;
+	static const GLenum DEPTH_FORMAT = GL_DEPTH_COMPONENT32F;
+
+	// build the lighting program; false when it fails to build
+	bool Create(
+		const char* lightingVertexPath,
+		const char* lightingFragmentPath);
+	bool IsAvailable() const { return(0 != m_lightingProgram); }
+
+	// start drawing the opaque draws into the bound G-buffer, with
+	// the albedo, normal and material attached in that order
+	void BeginGeometry();
+	// light the G-buffer into the bound framebuffer, at the rates of
+	// the rate image pShadingRate built for it, if one is given
+	void Light(const glm::mat4& viewProjection,
+		GLuint albedoTexture,
+		GLuint normalTexture,
+		GLuint materialTexture,
+		GLuint depthTexture,
+		ShadingRate* pShadingRate);
+
+private:
+	// pointer to shader manager object
+	ShaderManager* m_pShaderManager;
+	// full screen program lighting the G-buffer
+	GLuint m_lightingProgram;
+	GLint m_inverseViewProjectionLocation;
+	GLint m_shadingRatePassLocation;
+	// vertex array for the full screen triangle, which has no buffers
+	GLuint m_lightingVAO;
+};
@@ -0,0 +1,212 @@
+///////////////////////////////////////////////////////////////////////////////
+// dirtyrangebuffer.cpp
+// ============
+// a GPU buffer kept in step with an array by copying its changed ranges
+//
+//  The instance data of a large scene that mostly stands still barely
+//  changes between frames, yet writing it whole into the upload ring
+//  every frame sends all of it again each time one draw moves. This
+//  buffer stays resident instead and keeps a copy of what it holds;
+//  each update compares the array with the copy an element at a time,
+//  joins the changed elements into ranges, copied as one across short
+//  runs of unchanged ones, and only writes those ranges into the
+//  upload ring, copying each into place with glCopyNamedBufferSubData.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "DirtyRangeBuffer.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+	// alignment of the ranges in the upload ring, which a copy does
+	// not need, but keeps their floats aligned for the writes
+	const GLsizeiptr RANGE_ALIGNMENT = 16;
+}
+
+DirtyRangeBuffer::UPLOAD_STATS DirtyRangeBuffer::s_stats = {};
+
+/***********************************************************
+ *  DirtyRangeBuffer()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+DirtyRangeBuffer::DirtyRangeBuffer(size_t elementSize, const char* owner)
+{
+	m_elementSize = elementSize;
+	m_owner = (NULL != owner) ? owner : "";
+	m_capacity = 0;
+	m_count = 0;
+	m_lastRegions = 0;
+	m_lastBytes = 0;
+}
+
+/***********************************************************
+ *  ~DirtyRangeBuffer()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+DirtyRangeBuffer::~DirtyRangeBuffer()
+{
+}
+
+/***********************************************************
+ *  Grow()
+ *
+ *  This method is used for replacing the buffer with one
+ *  half again as large as the count, so a list growing a
+ *  draw at a time does not replace it every frame. The new
+ *  buffer holds nothing the copy says it does.
+ ***********************************************************/
+bool DirtyRangeBuffer::Grow(size_t count)
+{
+	size_t capacity = std::max(count + (count / 2), (size_t)1);
+	if (m_buffer.Create(GPUBuffer::USAGE_STATIC, (GLsizeiptr)(capacity * m_elementSize), NULL,
+		GPUMemory::CATEGORY_BUFFER, m_owner.c_str()) == false)
+	{
+		m_capacity = 0;
+		m_count = 0;
+		return(false);
+	}
+
+	m_capacity = capacity;
+	m_count = 0;
+	m_contents.resize(capacity * m_elementSize);
+	return(true);
+}
+
+/***********************************************************
+ *  FindChangedRanges()
+ *
+ *  This method is used for listing the ranges of elements
+ *  that differ from the copy, and every element past the
+ *  ones in step. A range starts at the first changed
+ *  element and ends past the last one before a run of
+ *  unchanged elements longer than MERGE_GAP_BYTES.
+ ***********************************************************/
+void DirtyRangeBuffer::FindChangedRanges(const unsigned char* pData, size_t count)
+{
+	m_ranges.clear();
+	const size_t mergeGap = MERGE_GAP_BYTES / m_elementSize;
+	size_t compared = std::min(m_count, count);
+
+	size_t rangeFirst = 0;
+	size_t rangeEnd = 0;
+	bool bOpen = false;
+	for (size_t i = 0; i < compared; i++)
+	{
+		size_t offset = i * m_elementSize;
+		if (memcmp(pData + offset, &m_contents[offset], m_elementSize) == 0)
+		{
+			continue;
+		}
+		if ((bOpen == true) && (i - rangeEnd <= mergeGap))
+		{
+			rangeEnd = i + 1;
+			continue;
+		}
+		if (bOpen == true)
+		{
+			m_ranges.push_back(rangeFirst);
+			m_ranges.push_back(rangeEnd);
+		}
+		rangeFirst = i;
+		rangeEnd = i + 1;
+		bOpen = true;
+	}
+
+	// the elements past the copy are all written, joined to the
+	// last range when it ends close enough
+	if (count > compared)
+	{
+		if ((bOpen == true) && (compared - rangeEnd <= mergeGap))
+		{
+			rangeEnd = count;
+		}
+		else
+		{
+			if (bOpen == true)
+			{
+				m_ranges.push_back(rangeFirst);
+				m_ranges.push_back(rangeEnd);
+			}
+			rangeFirst = compared;
+			rangeEnd = count;
+			bOpen = true;
+		}
+	}
+	if (bOpen == true)
+	{
+		m_ranges.push_back(rangeFirst);
+		m_ranges.push_back(rangeEnd);
+	}
+}
+
+/***********************************************************
+ *  Update()
+ *
+ *  This method is used for copying the changed ranges of
+ *  the array into the buffer. Each range is written into
+ *  the frame's region of the upload ring and copied into
+ *  place on the GPU, which orders the copy after the draws
+ *  already submitted that read the buffer. A range is only
+ *  taken into the copy once its write found room, so one
+ *  that did not is found changed again by the next update.
+ ***********************************************************/
+bool DirtyRangeBuffer::Update(UploadRing* pUploadRing, const void* pData, size_t count)
+{
+	m_lastRegions = 0;
+	m_lastBytes = 0;
+	if ((NULL == pUploadRing) || (pUploadRing->IsAvailable() == false) || (count == 0))
+	{
+		return(false);
+	}
+
+	bool bFull = false;
+	if (count > m_capacity)
+	{
+		if (Grow(count) == false)
+		{
+			return(false);
+		}
+		bFull = true;
+	}
+
+	const unsigned char* pBytes = (const unsigned char*)pData;
+	FindChangedRanges(pBytes, count);
+
+	bool bWritten = true;
+	for (size_t r = 0; r < m_ranges.size(); r += 2)
+	{
+		size_t offset = m_ranges[r] * m_elementSize;
+		size_t bytes = (m_ranges[r + 1] - m_ranges[r]) * m_elementSize;
+		GLintptr ringOffset = pUploadRing->Write(pBytes + offset, (GLsizeiptr)bytes, RANGE_ALIGNMENT);
+		if (ringOffset < 0)
+		{
+			bWritten = false;
+			break;
+		}
+		glCopyNamedBufferSubData(pUploadRing->GetBuffer(), m_buffer.GetName(),
+			ringOffset, (GLintptr)offset, (GLsizeiptr)bytes);
+		memcpy(&m_contents[offset], pBytes + offset, bytes);
+
+		m_lastRegions++;
+		m_lastBytes += bytes;
+		s_stats.elements += m_ranges[r + 1] - m_ranges[r];
+	}
+
+	// the ranges not written still differ from the copy, and the
+	// elements past it are written whole again
+	m_count = (bWritten == true) ? count : std::min(m_count, count);
+
+	if (m_lastRegions > 0)
+	{
+		s_stats.updates++;
+		s_stats.fullUploads += (bFull == true) ? 1 : 0;
+		s_stats.regions += m_lastRegions;
+		s_stats.bytes += m_lastBytes;
+		s_stats.peakBytes = std::max(s_stats.peakBytes, (unsigned long long)m_lastBytes);
+	}
+	return(bWritten);
+}
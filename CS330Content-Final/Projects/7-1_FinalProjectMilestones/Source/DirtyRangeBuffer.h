@@ -0,0 +1,94 @@
+///////////////////////////////////////////////////////////////////////////////
+// dirtyrangebuffer.h
+// ============
+// a GPU buffer kept in step with an array by copying its changed ranges
+//
+//  The instance data of a large scene that mostly stands still barely
+//  changes between frames, yet writing it whole into the upload ring
+//  every frame sends all of it again each time one draw moves. This
+//  buffer stays resident instead and keeps a copy of what it holds;
+//  each update compares the array with the copy an element at a time,
+//  joins the changed elements into ranges, copied as one across short
+//  runs of unchanged ones, and only writes those ranges into the
+//  upload ring, copying each into place with glCopyNamedBufferSubData.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "GPUBuffer.h"
+#include "UploadRing.h"
+
+#include <string>
+#include <vector>
+
+/***********************************************************
+ *  DirtyRangeBuffer
+ *
+ *  This class contains the resident buffer, the copy of its
+ *  contents and the ranges of the last update. The buffer
+ *  grows to the largest element count it held, and a grown
+ *  buffer is written whole once.
+ ***********************************************************/
+class DirtyRangeBuffer
+{
+public:
+	// constructor
+	DirtyRangeBuffer(size_t elementSize, const char* owner);
+	// destructor
+	~DirtyRangeBuffer();
+
+	// unchanged bytes between two changed ranges up to which they are
+	// copied as one, since each copy costs more than a few bytes
+	static const size_t MERGE_GAP_BYTES = 256;
+
+	// updates since the start, over every buffer
+	struct UPLOAD_STATS
+	{
+		unsigned long long updates;			// updates that copied anything
+		unsigned long long fullUploads;		// of those, the ones of a new buffer
+		unsigned long long regions;			// ranges copied
+		unsigned long long elements;		// elements the ranges held
+		unsigned long long bytes;			// bytes the ranges held
+		unsigned long long peakBytes;		// most bytes of one update
+	};
+
+	// bring the buffer in step with the count elements of pData,
+	// through the upload ring of the frame; false, with the ranges
+	// not written left to the next update, when the ring is full
+	bool Update(UploadRing* pUploadRing, const void* pData, size_t count);
+	// have the next update write every element
+	void Invalidate() { m_count = 0; }
+
+	GLuint GetBuffer() const { return(m_buffer.GetName()); }
+	// elements the buffer has room for, which changes as it is
+	// replaced by a larger one
+	size_t GetCapacity() const { return(m_capacity); }
+	// elements in step with the array after the last update
+	size_t GetCount() const { return(m_count); }
+	// ranges and bytes of the last update
+	size_t GetLastRegions() const { return(m_lastRegions); }
+	size_t GetLastBytes() const { return(m_lastBytes); }
+
+	static const UPLOAD_STATS& GetStats() { return(s_stats); }
+
+private:
+	size_t m_elementSize;
+	std::string m_owner;
+	GPUBuffer m_buffer;
+	// elements the buffer has room for, and in step with the copy
+	size_t m_capacity;
+	size_t m_count;
+	// what the buffer holds, element for element
+	std::vector<unsigned char> m_contents;
+	// first and end element of each range to copy, in pairs
+	std::vector<size_t> m_ranges;
+	size_t m_lastRegions;
+	size_t m_lastBytes;
+
+	static UPLOAD_STATS s_stats;
+
+	// replace the buffer with one of room for count elements
+	bool Grow(size_t count);
+	// find the ranges of the elements that differ from the copy
+	void FindChangedRanges(const unsigned char* pData, size_t count);
+};
@@ -0,0 +1,303 @@
+///////////////////////////////////////////////////////////////////////////////
+// framearena.cpp
+// ============
+// per-thread linear allocator for the data living only within a frame
+//
+//  Every thread that allocates during a frame gets its own arena, so
+//  no allocation takes a lock. An allocation bumps an offset in the
+//  arena's block; nothing is freed on its own, and the arenas of all
+//  threads are reset together at the end of the frame. A frame
+//  outgrowing its block chains another, and the reset folds the
+//  chain into one block the size of them all, so after the first
+//  frames the arenas stop touching the heap. Every operator new of
+//  the program is counted, so a run can check that a frame in the
+//  steady state allocates nothing from the heap at all.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "FrameArena.h"
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <mutex>
+
+namespace
+{
+	// operator new calls of every thread, from before main() on
+	std::atomic<unsigned long long> gHeapAllocations(0);
+
+	// the arena of the calling thread, NULL before its first use
+	thread_local FrameArena* gpThreadArena = NULL;
+
+	/***********************************************************
+	 *  ARENA_REGISTRY
+	 *
+	 *  This structure holds the arena of every thread that
+	 *  allocated, so the frame can reset them all. The arenas
+	 *  outlive their threads and are deleted at exit.
+	 ***********************************************************/
+	struct ARENA_REGISTRY
+	{
+		std::mutex mutex;
+		std::vector<FrameArena*> arenas;
+
+		~ARENA_REGISTRY()
+		{
+			for (size_t i = 0; i < arenas.size(); i++)
+			{
+				delete arenas[i];
+			}
+		}
+	};
+
+	/***********************************************************
+	 *  GetRegistry()
+	 *
+	 *  This function is used for getting the registry, built
+	 *  on first use so it exists before any thread asks.
+	 ***********************************************************/
+	ARENA_REGISTRY& GetRegistry()
+	{
+		static ARENA_REGISTRY registry;
+		return(registry);
+	}
+
+	/***********************************************************
+	 *  CountedAllocate()
+	 *
+	 *  This function is used for every operator new below,
+	 *  counting the call and taking the memory from malloc.
+	 ***********************************************************/
+	void* CountedAllocate(size_t bytes)
+	{
+		gHeapAllocations.fetch_add(1, std::memory_order_relaxed);
+		void* pMemory = malloc((bytes > 0) ? bytes : 1);
+		return(pMemory);
+	}
+}
+
+// the global operators new and delete, replaced only to count the
+// allocations of the program; the memory still comes from malloc
+void* operator new(size_t bytes)
+{
+	void* pMemory = CountedAllocate(bytes);
+	if (NULL == pMemory)
+	{
+		throw std::bad_alloc();
+	}
+	return(pMemory);
+}
+void* operator new[](size_t bytes)
+{
+	void* pMemory = CountedAllocate(bytes);
+	if (NULL == pMemory)
+	{
+		throw std::bad_alloc();
+	}
+	return(pMemory);
+}
+void* operator new(size_t bytes, const std::nothrow_t&) noexcept
+{
+	return(CountedAllocate(bytes));
+}
+void* operator new[](size_t bytes, const std::nothrow_t&) noexcept
+{
+	return(CountedAllocate(bytes));
+}
+void operator delete(void* pMemory) noexcept
+{
+	free(pMemory);
+}
+void operator delete[](void* pMemory) noexcept
+{
+	free(pMemory);
+}
+void operator delete(void* pMemory, size_t) noexcept
+{
+	free(pMemory);
+}
+void operator delete[](void* pMemory, size_t) noexcept
+{
+	free(pMemory);
+}
+void operator delete(void* pMemory, const std::nothrow_t&) noexcept
+{
+	free(pMemory);
+}
+void operator delete[](void* pMemory, const std::nothrow_t&) noexcept
+{
+	free(pMemory);
+}
+
+/***********************************************************
+ *  FrameArena()
+ *
+ *  The constructor for the class. The first block is taken
+ *  by the first allocation.
+ ***********************************************************/
+FrameArena::FrameArena()
+{
+	m_offset = 0;
+	m_usedBytes = 0;
+	m_peakBytes = 0;
+	m_blockAllocations = 0;
+}
+
+/***********************************************************
+ *  ~FrameArena()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+FrameArena::~FrameArena()
+{
+	for (size_t i = 0; i < m_blocks.size(); i++)
+	{
+		delete[] m_blocks[i].pData;
+	}
+	m_blocks.clear();
+}
+
+/***********************************************************
+ *  Allocate()
+ *
+ *  This method is used for taking bytes from the block in
+ *  use at the given alignment, a power of two, chaining a
+ *  block twice the size of the last one, or the size of the
+ *  allocation if larger, when they do not fit.
+ ***********************************************************/
+void* FrameArena::Allocate(size_t bytes, size_t alignment)
+{
+	if (m_blocks.empty() == true)
+	{
+		AddBlock(bytes + alignment);
+	}
+
+	BLOCK* pBlock = &m_blocks.back();
+	uintptr_t base = (uintptr_t)pBlock->pData;
+	size_t start = (size_t)(((base + m_offset + alignment - 1) & ~(uintptr_t)(alignment - 1)) - base);
+	if (start + bytes > pBlock->bytes)
+	{
+		AddBlock((pBlock->bytes * 2 > bytes + alignment) ? pBlock->bytes * 2 : bytes + alignment);
+		pBlock = &m_blocks.back();
+		base = (uintptr_t)pBlock->pData;
+		start = (size_t)(((base + alignment - 1) & ~(uintptr_t)(alignment - 1)) - base);
+	}
+
+	m_usedBytes += (start - m_offset) + bytes;
+	m_offset = start + bytes;
+	return(pBlock->pData + start);
+}
+
+/***********************************************************
+ *  Reset()
+ *
+ *  This method is used for forgetting every allocation of
+ *  the frame. A frame that chained blocks leaves one block
+ *  as large as all of them, so the next one like it fits.
+ ***********************************************************/
+void FrameArena::Reset()
+{
+	m_peakBytes = (m_usedBytes > m_peakBytes) ? m_usedBytes : m_peakBytes;
+	if (m_blocks.size() > 1)
+	{
+		size_t totalBytes = 0;
+		for (size_t i = 0; i < m_blocks.size(); i++)
+		{
+			totalBytes += m_blocks[i].bytes;
+			delete[] m_blocks[i].pData;
+		}
+		m_blocks.clear();
+		AddBlock(totalBytes);
+	}
+	m_offset = 0;
+	m_usedBytes = 0;
+}
+
+/***********************************************************
+ *  AddBlock()
+ *
+ *  This method is used for chaining a block of at least the
+ *  bytes, and never less than the first block, from the
+ *  heap.
+ ***********************************************************/
+void FrameArena::AddBlock(size_t bytes)
+{
+	BLOCK block;
+	block.bytes = (bytes > INITIAL_BLOCK_BYTES) ? bytes : INITIAL_BLOCK_BYTES;
+	block.pData = new char[block.bytes];
+	m_blocks.push_back(block);
+	m_offset = 0;
+	m_blockAllocations++;
+}
+
+/***********************************************************
+ *  ForThread()
+ *
+ *  This method is used for getting the arena of the calling
+ *  thread, creating and registering it on the first call;
+ *  only that first call takes the lock.
+ ***********************************************************/
+FrameArena& FrameArena::ForThread()
+{
+	if (NULL == gpThreadArena)
+	{
+		FrameArena* pArena = new FrameArena();
+		ARENA_REGISTRY& registry = GetRegistry();
+		std::lock_guard<std::mutex> lock(registry.mutex);
+		registry.arenas.push_back(pArena);
+		gpThreadArena = pArena;
+	}
+	return(*gpThreadArena);
+}
+
+/***********************************************************
+ *  ResetAll()
+ *
+ *  This method is used for resetting the arena of every
+ *  thread at the end of a frame.
+ ***********************************************************/
+void FrameArena::ResetAll()
+{
+	ARENA_REGISTRY& registry = GetRegistry();
+	std::lock_guard<std::mutex> lock(registry.mutex);
+	for (size_t i = 0; i < registry.arenas.size(); i++)
+	{
+		registry.arenas[i]->Reset();
+	}
+}
+
+/***********************************************************
+ *  GetStats()
+ *
+ *  This method is used for adding up the blocks and the
+ *  peak use of the arenas of all threads.
+ ***********************************************************/
+FrameArena::ARENA_STATS FrameArena::GetStats()
+{
+	ARENA_STATS stats = {};
+	ARENA_REGISTRY& registry = GetRegistry();
+	std::lock_guard<std::mutex> lock(registry.mutex);
+	stats.arenas = (int)registry.arenas.size();
+	for (size_t i = 0; i < registry.arenas.size(); i++)
+	{
+		const FrameArena* pArena = registry.arenas[i];
+		for (size_t b = 0; b < pArena->m_blocks.size(); b++)
+		{
+			stats.capacityBytes += pArena->m_blocks[b].bytes;
+		}
+		stats.peakBytes += pArena->m_peakBytes;
+		stats.blockAllocations += pArena->m_blockAllocations;
+	}
+	return(stats);
+}
+
+/***********************************************************
+ *  GetHeapAllocations()
+ *
+ *  This method is used for getting the operator new calls
+ *  of every thread since the start.
+ ***********************************************************/
+unsigned long long FrameArena::GetHeapAllocations()
+{
+	return(gHeapAllocations.load(std::memory_order_relaxed));
+}
@@ -0,0 +1,164 @@
+///////////////////////////////////////////////////////////////////////////////
+// framearena.h
+// ============
+// per-thread linear allocator for the data living only within a frame
+//
+//  Every thread that allocates during a frame gets its own arena, so
+//  no allocation takes a lock. An allocation bumps an offset in the
+//  arena's block; nothing is freed on its own, and the arenas of all
+//  threads are reset together at the end of the frame. A frame
+//  outgrowing its block chains another, and the reset folds the
+//  chain into one block the size of them all, so after the first
+//  frames the arenas stop touching the heap. Every operator new of
+//  the program is counted, so a run can check that a frame in the
+//  steady state allocates nothing from the heap at all.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+/***********************************************************
+ *  FrameArena
+ *
+ *  This class contains the blocks of one thread's arena.
+ *  ForThread() finds the arena of the calling thread, and
+ *  ResetAll() empties every arena once the frame is done
+ *  with what it allocated.
+ ***********************************************************/
+class FrameArena
+{
+public:
+	// constructor
+	FrameArena();
+	// destructor
+	~FrameArena();
+
+	// bytes of the first block of an arena
+	static const size_t INITIAL_BLOCK_BYTES = 64 * 1024;
+
+	// what the arenas of all threads held
+	struct ARENA_STATS
+	{
+		int arenas;						// threads that allocated
+		size_t capacityBytes;			// blocks of all arenas
+		size_t peakBytes;				// most any frame used, all arenas
+		unsigned long long blockAllocations;	// blocks taken from the heap
+	};
+
+	// bytes aligned to a power of two, valid until the next reset
+	void* Allocate(size_t bytes, size_t alignment);
+	template<typename T>
+	T* AllocateArray(size_t count)
+	{
+		return(static_cast<T*>(Allocate(sizeof(T) * count, std::alignment_of<T>::value)));
+	}
+	// forget every allocation, merging the blocks into one
+	void Reset();
+	size_t GetUsedBytes() const { return(m_usedBytes); }
+
+	// the arena of the calling thread, created on its first call
+	static FrameArena& ForThread();
+	// reset the arena of every thread; called at the end of the frame
+	// on the thread rendering it, once its jobs are done, so no thread
+	// holds an allocation of it any more
+	static void ResetAll();
+	static ARENA_STATS GetStats();
+
+	// calls to operator new by every thread since the start
+	static unsigned long long GetHeapAllocations();
+
+private:
+	struct BLOCK
+	{
+		char* pData;
+		size_t bytes;
+	};
+
+	// blocks in the order they were chained, the last one in use
+	std::vector<BLOCK> m_blocks;
+	size_t m_offset;
+	size_t m_usedBytes;
+	size_t m_peakBytes;
+	unsigned long long m_blockAllocations;
+
+	// chain a block holding at least the bytes
+	void AddBlock(size_t bytes);
+
+	// not copyable, the blocks are owned
+	FrameArena(const FrameArena&);
+	FrameArena& operator=(const FrameArena&);
+};
+
+/***********************************************************
+ *  FrameAllocator
+ *
+ *  This template is an allocator for the standard containers
+ *  that takes its memory from an arena, by default the one
+ *  of the thread constructing it, and never gives it back.
+ *  A container using it must be gone, or never touched
+ *  again, by the end of the frame.
+ ***********************************************************/
+template<typename T>
+class FrameAllocator
+{
+public:
+	typedef T value_type;
+
+	FrameAllocator() : m_pArena(&FrameArena::ForThread()) {}
+	explicit FrameAllocator(FrameArena& arena) : m_pArena(&arena) {}
+	template<typename U>
+	FrameAllocator(const FrameAllocator<U>& other) : m_pArena(other.GetArena()) {}
+
+	T* allocate(size_t count) { return(m_pArena->AllocateArray<T>(count)); }
+	void deallocate(T*, size_t) {}
+	FrameArena* GetArena() const { return(m_pArena); }
+
+private:
+	FrameArena* m_pArena;
+};
+
+template<typename T, typename U>
+bool operator==(const FrameAllocator<T>& a, const FrameAllocator<U>& b) { return(a.GetArena() == b.GetArena()); }
+template<typename T, typename U>
+bool operator!=(const FrameAllocator<T>& a, const FrameAllocator<U>& b) { return(a.GetArena() != b.GetArena()); }
+
+// a vector of the frame, for lists rebuilt every frame
+template<typename T>
+using FrameVector = std::vector<T, FrameAllocator<T> >;
+
+/***********************************************************
+ *  FrameFunction
+ *
+ *  This class holds a callable copied into an arena and
+ *  calls it through a plain function pointer, where a
+ *  std::function would take a capture larger than its own
+ *  storage from the heap. The arena runs no destructors, so
+ *  only callables with nothing to destroy are taken.
+ ***********************************************************/
+class FrameFunction
+{
+public:
+	FrameFunction() : m_pInvoke(NULL), m_pObject(NULL) {}
+	template<typename F>
+	FrameFunction(FrameArena& arena, const F& function)
+	{
+		static_assert(std::is_trivially_destructible<F>::value,
+			"a frame function must capture nothing with a destructor");
+		m_pObject = new (arena.Allocate(sizeof(F), std::alignment_of<F>::value)) F(function);
+		m_pInvoke = &Invoke<F>;
+	}
+
+	void operator()() const { m_pInvoke(m_pObject); }
+	bool IsEmpty() const { return(NULL == m_pInvoke); }
+
+private:
+	void (*m_pInvoke)(void*);
+	void* m_pObject;
+
+	template<typename F>
+	static void Invoke(void* pObject) { (*static_cast<F*>(pObject))(); }
+};
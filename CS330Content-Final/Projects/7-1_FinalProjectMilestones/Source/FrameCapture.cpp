@@ -0,0 +1,898 @@
+///////////////////////////////////////////////////////////////////////////////
+// framecapture.cpp
+// ============
+// pipelined readback and encoding of rendered frames into image files
+//
+//  A batch render writes every frame to a file. Reading a frame back
+//  with glReadPixels into client memory waits for the GPU to finish it,
+//  and encoding the image on the GL thread holds up the next frame, so
+//  frames are read into a ring of pixel buffers instead, mapped a few
+//  frames later once their fence passed, and encoded by worker threads
+//  while the GPU renders the following frames. Screenshots and the
+//  video capture of the viewer go the same way, so capturing never
+//  holds up the frames on screen; a video frame that would is dropped.
+//  Frames for a sink, such as the stream to a remote viewer or the
+//  requests of the render service, are encoded the same way and
+//  handed to it instead of written. A video sink takes the frame as
+//  NV12 instead, converted by a compute pass before the readback, so
+//  only 12 bits a pixel cross the bus and no encoder thread touches
+//  it before the video encoder does.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "FrameCapture.h"
+#include "ScopeProfiler.h"
+#include "GPUMemory.h"
+#include "ShaderManager.h"
+#include "Logger.h"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+namespace
+{
+	// frames queued for the encoders per encoder thread
+	const size_t QUEUED_JOBS_PER_ENCODER = 2;
+	// image unit the NV12 conversion reads the frame on, and the
+	// storage buffer binding it writes the planes to
+	const GLuint VIDEO_IMAGE_UNIT = 0;
+	const GLuint VIDEO_PLANES_BINDING = 0;
+	// pixels of the frame each invocation of the conversion covers
+	// across and down, and its work group size
+	const int VIDEO_BLOCK_WIDTH = 4;
+	const int VIDEO_BLOCK_HEIGHT = 2;
+	const int VIDEO_GROUP_SIZE = 8;
+	// bytes a PNG match may reach back, the deflate window
+	const int DEFLATE_WINDOW = 32768;
+	// shortest and longest match deflate encodes
+	const int MIN_MATCH = 3;
+	const int MAX_MATCH = 258;
+	// bits of the hash of the next three bytes the matches are found by
+	const int HASH_BITS = 15;
+	// most bytes the Adler-32 sums take before they may overflow
+	const int ADLER_RUN = 5552;
+
+	// base lengths and extra bits of the length codes 257 to 285
+	const int LENGTH_BASE[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+		35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+	const int LENGTH_EXTRA[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+		3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+	// base distances and extra bits of the distance codes 0 to 29
+	const int DISTANCE_BASE[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+		257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+	const int DISTANCE_EXTRA[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+		7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+	// deflate writes its bits from the lowest up, and the Huffman
+	// codes from their highest bit
+	struct BIT_WRITER
+	{
+		std::vector<unsigned char>* pBytes;
+		unsigned int bits;
+		int bitCount;
+
+		void Write(unsigned int value, int count)
+		{
+			bits |= value << bitCount;
+			bitCount += count;
+			while (bitCount >= 8)
+			{
+				pBytes->push_back((unsigned char)(bits & 0xFF));
+				bits >>= 8;
+				bitCount -= 8;
+			}
+		}
+		void WriteCode(unsigned int code, int length)
+		{
+			unsigned int reversed = 0;
+			for (int i = 0; i < length; i++)
+			{
+				reversed = (reversed << 1) | ((code >> i) & 1);
+			}
+			Write(reversed, length);
+		}
+		void Flush()
+		{
+			if (bitCount > 0)
+			{
+				pBytes->push_back((unsigned char)(bits & 0xFF));
+			}
+			bits = 0;
+			bitCount = 0;
+		}
+	};
+
+	// write a literal or length symbol with the fixed Huffman codes
+	void WriteLiteralLength(BIT_WRITER& writer, int symbol)
+	{
+		if (symbol < 144)
+		{
+			writer.WriteCode(0x30 + symbol, 8);
+		}
+		else if (symbol < 256)
+		{
+			writer.WriteCode(0x190 + symbol - 144, 9);
+		}
+		else if (symbol < 280)
+		{
+			writer.WriteCode(symbol - 256, 7);
+		}
+		else
+		{
+			writer.WriteCode(0xC0 + symbol - 280, 8);
+		}
+	}
+
+	// write a match of a length at a distance
+	void WriteMatch(BIT_WRITER& writer, int length, int distance)
+	{
+		int code = 28;
+		while (LENGTH_BASE[code] > length)
+		{
+			code--;
+		}
+		WriteLiteralLength(writer, 257 + code);
+		writer.Write(length - LENGTH_BASE[code], LENGTH_EXTRA[code]);
+
+		code = 29;
+		while (DISTANCE_BASE[code] > distance)
+		{
+			code--;
+		}
+		writer.WriteCode(code, 5);
+		writer.Write(distance - DISTANCE_BASE[code], DISTANCE_EXTRA[code]);
+	}
+
+	// compress data into a zlib stream of one block with the fixed
+	// Huffman codes, matching each position against the last one
+	// with the same next three bytes; rendered frames are mostly
+	// runs and repeated rows, which that finds
+	void Deflate(const std::vector<unsigned char>& data, std::vector<unsigned char>& stream)
+	{
+		// deflate with a 32K window and no preset dictionary
+		stream.push_back(0x78);
+		stream.push_back(0x01);
+
+		BIT_WRITER writer = { &stream, 0, 0 };
+		// the last block, with the fixed codes
+		writer.Write(1, 1);
+		writer.Write(1, 2);
+
+		std::vector<int> lastPosition((size_t)1 << HASH_BITS, -1);
+		int size = (int)data.size();
+		int position = 0;
+		while (position < size)
+		{
+			int length = 0;
+			int distance = 0;
+			if (position + MIN_MATCH <= size)
+			{
+				unsigned int hash = ((unsigned int)data[position] << 16) |
+					((unsigned int)data[position + 1] << 8) | data[position + 2];
+				hash = (hash * 2654435761u) >> (32 - HASH_BITS);
+				int candidate = lastPosition[hash];
+				lastPosition[hash] = position;
+				if ((candidate >= 0) && (position - candidate <= DEFLATE_WINDOW))
+				{
+					int maxLength = std::min(MAX_MATCH, size - position);
+					while ((length < maxLength) && (data[candidate + length] == data[position + length]))
+					{
+						length++;
+					}
+					distance = position - candidate;
+				}
+			}
+
+			if (length >= MIN_MATCH)
+			{
+				WriteMatch(writer, length, distance);
+				position += length;
+			}
+			else
+			{
+				WriteLiteralLength(writer, data[position]);
+				position++;
+			}
+		}
+		WriteLiteralLength(writer, 256);
+		writer.Flush();
+
+		// Adler-32 of the uncompressed data, highest byte first; the
+		// sums are reduced once per run of bytes that cannot overflow
+		unsigned int a = 1;
+		unsigned int b = 0;
+		for (int first = 0; first < size; first += ADLER_RUN)
+		{
+			int end = std::min(first + ADLER_RUN, size);
+			for (int i = first; i < end; i++)
+			{
+				a += data[i];
+				b += a;
+			}
+			a %= 65521;
+			b %= 65521;
+		}
+		unsigned int adler = (b << 16) | a;
+		for (int shift = 24; shift >= 0; shift -= 8)
+		{
+			stream.push_back((unsigned char)((adler >> shift) & 0xFF));
+		}
+	}
+
+	// CRC-32 of every byte value, built once by the first encoder
+	struct CRC_TABLE
+	{
+		unsigned int values[256];
+
+		CRC_TABLE()
+		{
+			for (unsigned int n = 0; n < 256; n++)
+			{
+				unsigned int c = n;
+				for (int k = 0; k < 8; k++)
+				{
+					c = (c & 1) ? (0xEDB88320u ^ (c >> 1)) : (c >> 1);
+				}
+				values[n] = c;
+			}
+		}
+	};
+
+	// CRC-32 a PNG chunk ends with
+	unsigned int CRC32(const unsigned char* data, size_t size, unsigned int crc)
+	{
+		static const CRC_TABLE table;
+		for (size_t i = 0; i < size; i++)
+		{
+			crc = table.values[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+		}
+		return(crc);
+	}
+
+	void WriteBigEndian(std::vector<unsigned char>& file, unsigned int value)
+	{
+		for (int shift = 24; shift >= 0; shift -= 8)
+		{
+			file.push_back((unsigned char)((value >> shift) & 0xFF));
+		}
+	}
+
+	// append a PNG chunk of a type and its data
+	void WriteChunk(std::vector<unsigned char>& file, const char* type, const std::vector<unsigned char>& data)
+	{
+		WriteBigEndian(file, (unsigned int)data.size());
+		size_t start = file.size();
+		file.insert(file.end(), type, type + 4);
+		file.insert(file.end(), data.begin(), data.end());
+		unsigned int crc = CRC32(&file[start], file.size() - start, 0xFFFFFFFFu) ^ 0xFFFFFFFFu;
+		WriteBigEndian(file, crc);
+	}
+
+	// true when a filename ends with an extension, in any case
+	bool HasExtension(const std::string& filename, const char* extension)
+	{
+		size_t length = strlen(extension);
+		if (filename.size() < length)
+		{
+			return(false);
+		}
+		for (size_t i = 0; i < length; i++)
+		{
+			if (tolower((unsigned char)filename[filename.size() - length + i]) != extension[i])
+			{
+				return(false);
+			}
+		}
+		return(true);
+	}
+}
+
+/***********************************************************
+ *  FrameCapture()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+FrameCapture::FrameCapture()
+{
+	for (int i = 0; i < READBACK_SLOTS; i++)
+	{
+		m_slots[i].buffer = 0;
+		m_slots[i].size = 0;
+		m_slots[i].fence = 0;
+		m_slots[i].width = 0;
+		m_slots[i].height = 0;
+		m_slots[i].pSink = NULL;
+		m_slots[i].pSinkContext = NULL;
+		m_slots[i].tag = 0;
+		m_slots[i].format = SINK_PNG;
+	}
+	m_nextSlot = 0;
+	m_maxQueuedJobs = QUEUED_JOBS_PER_ENCODER;
+	m_activeJobs = 0;
+	m_bStopping = false;
+	memset(&m_stats, 0, sizeof(m_stats));
+	m_pShaderManager = NULL;
+	m_videoProgram = 0;
+	m_frameSizeLocation = -1;
+	m_pictureSizeLocation = -1;
+	m_videoTexture = 0;
+	m_videoFramebuffer = 0;
+	m_videoWidth = 0;
+	m_videoHeight = 0;
+}
+
+/***********************************************************
+ *  ~FrameCapture()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+FrameCapture::~FrameCapture()
+{
+	Finish();
+	for (int i = 0; i < READBACK_SLOTS; i++)
+	{
+		if (0 != m_slots[i].buffer)
+		{
+			GPUMemory::DeleteBuffers(1, &m_slots[i].buffer);
+			m_slots[i].buffer = 0;
+		}
+	}
+	ReleaseVideoTexture();
+	if (0 != m_videoProgram)
+	{
+		glDeleteProgram(m_videoProgram);
+		m_videoProgram = 0;
+	}
+}
+
+/***********************************************************
+ *  Start()
+ *
+ *  This method is used for starting the encoder threads.
+ *  Without any, the files are encoded on the GL thread.
+ ***********************************************************/
+void FrameCapture::Start(int encoderCount)
+{
+	Finish();
+
+	if (encoderCount < 0)
+	{
+		encoderCount = std::max((int)std::thread::hardware_concurrency() - 1, 0);
+	}
+	m_bStopping = false;
+	m_maxQueuedJobs = QUEUED_JOBS_PER_ENCODER * std::max(encoderCount, 1);
+	for (int i = 0; i < encoderCount; i++)
+	{
+		m_encoders.push_back(std::thread(&FrameCapture::EncodeLoop, this));
+	}
+}
+
+/***********************************************************
+ *  EnableVideoFrames()
+ *
+ *  This method is used for building the compute program
+ *  converting a frame to the NV12 planes a video encoder
+ *  takes. The frame is copied into a texture first, which
+ *  resolves a multisampled framebuffer, so the conversion
+ *  needs the named framebuffer blit of OpenGL 4.5.
+ ***********************************************************/
+bool FrameCapture::EnableVideoFrames(ShaderManager* pShaderManager, const char* shaderPath)
+{
+	if ((NULL == pShaderManager) || (GLEW_VERSION_4_5 != GL_TRUE))
+	{
+		return(false);
+	}
+	if (0 != m_videoProgram)
+	{
+		return(true);
+	}
+
+	m_videoProgram = pShaderManager->LoadComputeShader(shaderPath);
+	if (0 == m_videoProgram)
+	{
+		LOG_ERROR("Video frames disabled, the compute shader %s did not build", shaderPath);
+		return(false);
+	}
+	m_pShaderManager = pShaderManager;
+	m_frameSizeLocation = glGetUniformLocation(m_videoProgram, "frameSize");
+	m_pictureSizeLocation = glGetUniformLocation(m_videoProgram, "pictureSize");
+	return(true);
+}
+
+/***********************************************************
+ *  Capture()
+ *
+ *  This method is used for starting the readback of a frame
+ *  into the next pixel buffer, after taking the frame read
+ *  into it earlier, and queueing the earlier frames whose
+ *  readback already finished. The read is asynchronous; the
+ *  fence placed after it tells when the pixels arrived. A
+ *  frame that may be dropped is, rather than waiting for
+ *  the frame still in its buffer or for a full encode queue.
+ ***********************************************************/
+bool FrameCapture::Capture(GLuint framebuffer, int width, int height, const std::string& filename, bool bMayDrop)
+{
+	return(StartReadback(framebuffer, width, height, filename, bMayDrop, NULL, NULL, 0, SINK_PNG));
+}
+
+/***********************************************************
+ *  CaptureToSink()
+ *
+ *  This method is used for starting the readback of a frame
+ *  for a sink, which a stream drops rather than waiting
+ *  for, as a video frame is, and a requested image waits
+ *  for. Without a sink nothing is read, nor is an NV12
+ *  frame before EnableVideoFrames() or one smaller than a
+ *  single block of the conversion.
+ ***********************************************************/
+bool FrameCapture::CaptureToSink(GLuint framebuffer, int width, int height, FrameSink pSink, void* pContext,
+	uint32_t tag, bool bMayDrop, int format)
+{
+	if (NULL == pSink)
+	{
+		return(false);
+	}
+	if ((format == SINK_NV12) &&
+		((0 == m_videoProgram) || (width < VIDEO_BLOCK_WIDTH) || (height < VIDEO_BLOCK_HEIGHT)))
+	{
+		return(false);
+	}
+	return(StartReadback(framebuffer, width, height, std::string(), bMayDrop, pSink, pContext, tag, format));
+}
+
+/***********************************************************
+ *  StartReadback()
+ *
+ *  This method is used for reading a frame back for a file
+ *  or for the sink, as Capture() describes.
+ ***********************************************************/
+bool FrameCapture::StartReadback(GLuint framebuffer, int width, int height, const std::string& filename,
+	bool bMayDrop, FrameSink pSink, void* pSinkContext, uint32_t tag, int format)
+{
+	if ((width <= 0) || (height <= 0))
+	{
+		return(false);
+	}
+
+	Poll();
+	if (bMayDrop == true)
+	{
+		bool bQueueFull = false;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			bQueueFull = (m_encoders.empty() == false) && (m_jobs.size() >= m_maxQueuedJobs);
+		}
+		if ((bQueueFull == true) || (CompleteSlot(m_nextSlot, false) == false))
+		{
+			m_stats.dropped++;
+			return(false);
+		}
+	}
+	CompleteSlot(m_nextSlot, true);
+
+	READBACK_SLOT& slot = m_slots[m_nextSlot];
+	GLsizeiptr size = (GLsizeiptr)width * height * 4;
+	if (format == SINK_NV12)
+	{
+		// a byte of luma a pixel and one of chroma per two pixels
+		size = (GLsizeiptr)(width & ~(VIDEO_BLOCK_WIDTH - 1)) * (height & ~(VIDEO_BLOCK_HEIGHT - 1)) * 3 / 2;
+	}
+	if (0 == slot.buffer)
+	{
+		glGenBuffers(1, &slot.buffer);
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+	if (slot.size != size)
+	{
+		glBufferData(GL_PIXEL_PACK_BUFFER, size, NULL, GL_STREAM_READ);
+		GPUMemory::TrackBuffer(slot.buffer, size, GPUMemory::CATEGORY_BUFFER, "frame capture readback");
+		slot.size = size;
+	}
+
+	if (format == SINK_NV12)
+	{
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		ConvertVideoFrame(framebuffer, width, height, slot.buffer);
+		m_stats.converted++;
+	}
+	else
+	{
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+		glPixelStorei(GL_PACK_ALIGNMENT, 1);
+		glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	}
+
+	slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	slot.width = width;
+	slot.height = height;
+	slot.filename = filename;
+	slot.pSink = pSink;
+	slot.pSinkContext = pSinkContext;
+	slot.tag = tag;
+	slot.format = format;
+	m_nextSlot = (m_nextSlot + 1) % READBACK_SLOTS;
+	return(true);
+}
+
+/***********************************************************
+ *  ConvertVideoFrame()
+ *
+ *  This method is used for converting a frame to NV12 in
+ *  the pixel buffer of its slot. The frame is copied into
+ *  a texture the size of the frame, resolving it when the
+ *  framebuffer is multisampled, and the compute pass reads
+ *  it as an image, turning the rows top down, and writes
+ *  the luma plane and the interleaved chroma plane after
+ *  it into the buffer as a storage buffer. The barrier
+ *  makes the writes visible to the map after the fence.
+ ***********************************************************/
+void FrameCapture::ConvertVideoFrame(GLuint framebuffer, int width, int height, GLuint buffer)
+{
+	if ((width != m_videoWidth) || (height != m_videoHeight))
+	{
+		ReleaseVideoTexture();
+		glCreateTextures(GL_TEXTURE_2D, 1, &m_videoTexture);
+		glTextureStorage2D(m_videoTexture, 1, GL_RGBA8, width, height);
+		GPUMemory::TrackTexture(m_videoTexture, GL_RGBA8, width, height, 1, 1,
+			GPUMemory::CATEGORY_RENDER_TARGET, "video frame copy");
+		glCreateFramebuffers(1, &m_videoFramebuffer);
+		glNamedFramebufferTexture(m_videoFramebuffer, GL_COLOR_ATTACHMENT0, m_videoTexture, 0);
+		m_videoWidth = width;
+		m_videoHeight = height;
+	}
+	glBlitNamedFramebuffer(framebuffer, m_videoFramebuffer, 0, 0, width, height, 0, 0, width, height,
+		GL_COLOR_BUFFER_BIT, GL_NEAREST);
+
+	int pictureWidth = width & ~(VIDEO_BLOCK_WIDTH - 1);
+	int pictureHeight = height & ~(VIDEO_BLOCK_HEIGHT - 1);
+	m_pShaderManager->UseExternalProgram(m_videoProgram);
+	glUniform2i(m_frameSizeLocation, width, height);
+	glUniform2i(m_pictureSizeLocation, pictureWidth, pictureHeight);
+	glBindImageTexture(VIDEO_IMAGE_UNIT, m_videoTexture, 0, GL_FALSE, 0, GL_READ_ONLY, GL_RGBA8);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, VIDEO_PLANES_BINDING, buffer);
+	glDispatchCompute(
+		(pictureWidth / VIDEO_BLOCK_WIDTH + VIDEO_GROUP_SIZE - 1) / VIDEO_GROUP_SIZE,
+		(pictureHeight / VIDEO_BLOCK_HEIGHT + VIDEO_GROUP_SIZE - 1) / VIDEO_GROUP_SIZE, 1);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, VIDEO_PLANES_BINDING, 0);
+	glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+}
+
+/***********************************************************
+ *  ReleaseVideoTexture()
+ *
+ *  This method is used for deleting the copy of the frame
+ *  the conversion reads, when the frame size changes.
+ ***********************************************************/
+void FrameCapture::ReleaseVideoTexture()
+{
+	if (0 != m_videoFramebuffer)
+	{
+		glDeleteFramebuffers(1, &m_videoFramebuffer);
+		m_videoFramebuffer = 0;
+	}
+	if (0 != m_videoTexture)
+	{
+		GPUMemory::DeleteTextures(1, &m_videoTexture);
+		m_videoTexture = 0;
+	}
+	m_videoWidth = 0;
+	m_videoHeight = 0;
+}
+
+/***********************************************************
+ *  Poll()
+ *
+ *  This method is used for taking the pending readbacks
+ *  that finished, oldest first, without waiting for any.
+ *  The oldest pending frames follow the next slot.
+ ***********************************************************/
+void FrameCapture::Poll()
+{
+	for (int i = 0; i < READBACK_SLOTS; i++)
+	{
+		int slot = (m_nextSlot + i) % READBACK_SLOTS;
+		if ((0 != m_slots[slot].fence) && (CompleteSlot(slot, false) == false))
+		{
+			break;
+		}
+	}
+}
+
+/***********************************************************
+ *  CompleteSlot()
+ *
+ *  This method is used for copying the frame of a slot out
+ *  of its pixel buffer once the readback finished, and
+ *  handing it to the encoders. The copy frees the buffer
+ *  for the next readback right away. When the encoders are
+ *  too far behind, the GL thread waits for them, unless it
+ *  would not wait for the readback either; without encoder
+ *  threads it encodes the frame itself.
+ ***********************************************************/
+bool FrameCapture::CompleteSlot(int slot, bool bWait)
+{
+	READBACK_SLOT& readback = m_slots[slot];
+	if (0 == readback.fence)
+	{
+		return(true);
+	}
+	if (bWait == false)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if ((m_encoders.empty() == false) && (m_jobs.size() >= m_maxQueuedJobs))
+		{
+			return(false);
+		}
+	}
+
+	GLenum result = glClientWaitSync(readback.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+	if ((result == GL_TIMEOUT_EXPIRED) && (bWait == true))
+	{
+		std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+		while (result == GL_TIMEOUT_EXPIRED)
+		{
+			result = glClientWaitSync(readback.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+		}
+		std::chrono::duration<double> waited = std::chrono::high_resolution_clock::now() - start;
+		m_stats.readbackWaits++;
+		m_stats.readbackWaitSeconds += waited.count();
+	}
+	if (result == GL_TIMEOUT_EXPIRED)
+	{
+		return(false);
+	}
+	glDeleteSync(readback.fence);
+	readback.fence = 0;
+
+	ENCODE_JOB job;
+	job.pixels.resize((size_t)readback.size);
+	job.width = readback.width;
+	job.height = readback.height;
+	job.filename = readback.filename;
+	job.pSink = readback.pSink;
+	job.pSinkContext = readback.pSinkContext;
+	job.tag = readback.tag;
+	job.format = readback.format;
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.buffer);
+	const void* pMapped = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, readback.size, GL_MAP_READ_BIT);
+	if (NULL != pMapped)
+	{
+		memcpy(&job.pixels[0], pMapped, job.pixels.size());
+		glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	if (NULL == pMapped)
+	{
+		std::cout << "Could not map the readback of " << job.filename << std::endl;
+		m_stats.failures++;
+		return(true);
+	}
+
+	// no encoder threads, so the frame is written here
+	if (m_encoders.empty() == true)
+	{
+		EncodeJob(job);
+		return(true);
+	}
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+	if (m_jobs.size() >= m_maxQueuedJobs)
+	{
+		std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+		m_jobDone.wait(lock, [this]() { return(m_jobs.size() < m_maxQueuedJobs); });
+		std::chrono::duration<double> waited = std::chrono::high_resolution_clock::now() - start;
+		m_stats.encodeWaits++;
+		m_stats.encodeWaitSeconds += waited.count();
+	}
+	m_jobs.push_back(std::move(job));
+	m_activeJobs++;
+	lock.unlock();
+	m_jobQueued.notify_one();
+	return(true);
+}
+
+/***********************************************************
+ *  EncodeLoop()
+ *
+ *  This method is used for encoding the queued frames and
+ *  writing their files, until the queue is empty and the
+ *  capture is stopping.
+ ***********************************************************/
+void FrameCapture::EncodeLoop()
+{
+	ScopeProfiler::SetThreadName("frame encoder");
+	std::unique_lock<std::mutex> lock(m_mutex);
+	while (true)
+	{
+		m_jobQueued.wait(lock, [this]() { return((m_jobs.empty() == false) || (m_bStopping == true)); });
+		if (m_jobs.empty() == true)
+		{
+			return;
+		}
+
+		ENCODE_JOB job = std::move(m_jobs.front());
+		m_jobs.pop_front();
+		lock.unlock();
+		m_jobDone.notify_all();
+
+		EncodeJob(job);
+
+		lock.lock();
+		m_activeJobs--;
+		m_jobDone.notify_all();
+	}
+}
+
+/***********************************************************
+ *  EncodeJob()
+ *
+ *  This method is used for encoding a read back frame in
+ *  the format its extension names and writing its file,
+ *  or a frame of the sink as PNG and handing it over. An
+ *  NV12 frame is already in the format of the sink, which
+ *  gets the size of the picture cropped from the frame.
+ ***********************************************************/
+void FrameCapture::EncodeJob(const ENCODE_JOB& job)
+{
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	std::vector<unsigned char> file;
+	if ((NULL != job.pSink) && (job.format == SINK_NV12))
+	{
+		job.pSink(job.pSinkContext, job.pixels, job.width & ~(VIDEO_BLOCK_WIDTH - 1),
+			job.height & ~(VIDEO_BLOCK_HEIGHT - 1), job.tag);
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stats.sunk++;
+		return;
+	}
+	if (NULL != job.pSink)
+	{
+		EncodePNG(&job.pixels[0], job.width, job.height, file);
+		job.pSink(job.pSinkContext, file, job.width, job.height, job.tag);
+		std::chrono::duration<double> encoded = std::chrono::high_resolution_clock::now() - start;
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stats.encodeSeconds += encoded.count();
+		m_stats.sunk++;
+		return;
+	}
+	if (HasExtension(job.filename, ".tga") == true)
+	{
+		EncodeTGA(&job.pixels[0], job.width, job.height, file);
+	}
+	else
+	{
+		EncodePNG(&job.pixels[0], job.width, job.height, file);
+	}
+	std::ofstream stream(job.filename.c_str(), std::ios::binary);
+	stream.write((const char*)&file[0], file.size());
+	bool bWritten = (stream.good() == true);
+	stream.close();
+	std::chrono::duration<double> encoded = std::chrono::high_resolution_clock::now() - start;
+	if (bWritten == false)
+	{
+		std::cout << "Could not write frame " << job.filename << std::endl;
+	}
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_stats.encodeSeconds += encoded.count();
+	if (bWritten == true)
+	{
+		m_stats.images++;
+		m_stats.bytesWritten += file.size();
+	}
+	else
+	{
+		m_stats.failures++;
+	}
+}
+
+/***********************************************************
+ *  Finish()
+ *
+ *  This method is used for taking every pending readback,
+ *  oldest first, waiting for the encoders to write them and
+ *  ending the encoder threads.
+ ***********************************************************/
+void FrameCapture::Finish()
+{
+	for (int i = 0; i < READBACK_SLOTS; i++)
+	{
+		CompleteSlot((m_nextSlot + i) % READBACK_SLOTS, true);
+	}
+
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_jobDone.wait(lock, [this]() { return(m_activeJobs == 0); });
+		m_bStopping = true;
+	}
+	m_jobQueued.notify_all();
+	for (size_t i = 0; i < m_encoders.size(); i++)
+	{
+		m_encoders[i].join();
+	}
+	m_encoders.clear();
+	m_bStopping = false;
+}
+
+/***********************************************************
+ *  EncodePNG()
+ *
+ *  This method is used for encoding RGBA pixels as a PNG
+ *  file. The rows are written top down, each with the Sub
+ *  filter, which turns the smooth gradients of a rendered
+ *  frame into the small repeated values deflate compresses
+ *  well.
+ ***********************************************************/
+void FrameCapture::EncodePNG(const unsigned char* pixels, int width, int height, std::vector<unsigned char>& file)
+{
+	static const unsigned char SIGNATURE[8] = { 0x89, 'P', 'N', 'G', 0x0D, 0x0A, 0x1A, 0x0A };
+
+	file.clear();
+	file.insert(file.end(), SIGNATURE, SIGNATURE + 8);
+
+	// 8 bits per channel RGBA, no interlacing
+	std::vector<unsigned char> header;
+	WriteBigEndian(header, (unsigned int)width);
+	WriteBigEndian(header, (unsigned int)height);
+	header.push_back(8);
+	header.push_back(6);
+	header.push_back(0);
+	header.push_back(0);
+	header.push_back(0);
+	WriteChunk(file, "IHDR", header);
+
+	size_t rowBytes = (size_t)width * 4;
+	std::vector<unsigned char> filtered;
+	filtered.reserve((rowBytes + 1) * height);
+	for (int y = height - 1; y >= 0; y--)
+	{
+		const unsigned char* row = pixels + rowBytes * y;
+		filtered.push_back(1);
+		for (size_t x = 0; x < rowBytes; x++)
+		{
+			unsigned char left = (x >= 4) ? row[x - 4] : 0;
+			filtered.push_back((unsigned char)(row[x] - left));
+		}
+	}
+
+	std::vector<unsigned char> stream;
+	Deflate(filtered, stream);
+	WriteChunk(file, "IDAT", stream);
+	WriteChunk(file, "IEND", std::vector<unsigned char>());
+}
+
+/***********************************************************
+ *  EncodeTGA()
+ *
+ *  This method is used for writing RGBA pixels as an
+ *  uncompressed TGA file, which keeps the rows bottom up
+ *  and stores the channels as BGRA.
+ ***********************************************************/
+void FrameCapture::EncodeTGA(const unsigned char* pixels, int width, int height, std::vector<unsigned char>& file)
+{
+	// uncompressed true color, 32 bits per pixel, 8 of them alpha
+	unsigned char header[18] = { 0 };
+	header[2] = 2;
+	header[12] = (unsigned char)(width & 0xFF);
+	header[13] = (unsigned char)((width >> 8) & 0xFF);
+	header[14] = (unsigned char)(height & 0xFF);
+	header[15] = (unsigned char)((height >> 8) & 0xFF);
+	header[16] = 32;
+	header[17] = 8;
+
+	size_t pixelCount = (size_t)width * height;
+	file.assign(header, header + sizeof(header));
+	file.resize(sizeof(header) + pixelCount * 4);
+	unsigned char* pOut = &file[sizeof(header)];
+	for (size_t i = 0; i < pixelCount; i++)
+	{
+		pOut[i * 4 + 0] = pixels[i * 4 + 2];
+		pOut[i * 4 + 1] = pixels[i * 4 + 1];
+		pOut[i * 4 + 2] = pixels[i * 4 + 0];
+		pOut[i * 4 + 3] = pixels[i * 4 + 3];
+	}
+}
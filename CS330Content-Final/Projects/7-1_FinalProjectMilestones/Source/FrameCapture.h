@@ -0,0 +1,185 @@
+///////////////////////////////////////////////////////////////////////////////
+// framecapture.h
+// ============
+// pipelined readback and encoding of rendered frames into image files
+//
+//  A batch render writes every frame to a file. Reading a frame back
+//  with glReadPixels into client memory waits for the GPU to finish it,
+//  and encoding the image on the GL thread holds up the next frame, so
+//  frames are read into a ring of pixel buffers instead, mapped a few
+//  frames later once their fence passed, and encoded by worker threads
+//  while the GPU renders the following frames. Screenshots and the
+//  video capture of the viewer go the same way, so capturing never
+//  holds up the frames on screen; a video frame that would is dropped.
+//  Frames for a sink, such as the stream to a remote viewer or the
+//  requests of the render service, are encoded the same way and
+//  handed to it instead of written. A video sink takes the frame as
+//  NV12 instead, converted by a compute pass before the readback, so
+//  only 12 bits a pixel cross the bus and no encoder thread touches
+//  it before the video encoder does.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class ShaderManager;
+
+/***********************************************************
+ *  FrameCapture
+ *
+ *  This class contains the pixel buffers the frames are read
+ *  back into, the queue of read back frames waiting to be
+ *  encoded and the encoder threads. Capture() starts the
+ *  readback of a frame and Finish() waits for every file.
+ ***********************************************************/
+class FrameCapture
+{
+public:
+	// constructor
+	FrameCapture();
+	// destructor
+	~FrameCapture();
+
+	// frames read back while the GPU may still be rendering them
+	static const int READBACK_SLOTS = 3;
+
+	// frames written and where the GL thread waited
+	struct CAPTURE_STATS
+	{
+		unsigned long long images;			// files written
+		unsigned long long failures;		// files that could not be written
+		unsigned long long bytesWritten;
+		unsigned long long readbackWaits;	// captures that waited for a fence
+		double readbackWaitSeconds;
+		unsigned long long encodeWaits;		// captures that waited for the encoders
+		double encodeWaitSeconds;
+		double encodeSeconds;				// time encoding over all threads
+		unsigned long long dropped;			// captures left out rather than waited for
+		unsigned long long sunk;			// frames handed to the sink
+		unsigned long long converted;		// frames converted to NV12 on the GPU
+	};
+
+	// what a sink takes: a PNG file, or the NV12 planes of the picture,
+	// the frame cropped to a multiple of 4 by 2 pixels
+	enum SINK_FORMAT
+	{
+		SINK_PNG = 0,
+		SINK_NV12
+	};
+
+	// takes a frame in the format of its capture with the tag of the
+	// capture, on an encoder thread; the size is that of the picture
+	typedef void (*FrameSink)(void* pContext, const std::vector<unsigned char>& image,
+		int width, int height, uint32_t tag);
+
+	// start the encoder threads; a negative count starts one per
+	// hardware thread besides the calling one
+	void Start(int encoderCount = -1);
+	// build the compute program converting frames to NV12, which
+	// SINK_NV12 captures need; false without OpenGL 4.5
+	bool EnableVideoFrames(ShaderManager* pShaderManager, const char* shaderPath);
+	// read the color of a framebuffer back into the next pixel
+	// buffer, to be written to the file later; the extension picks
+	// the format, .tga or else .png. With bMayDrop the frame is left
+	// out, and false returned, when capturing it would have to wait
+	// for the GPU or the encoders
+	bool Capture(GLuint framebuffer, int width, int height, const std::string& filename, bool bMayDrop = false);
+	// read a frame back for a sink, which takes it with the tag in
+	// a SINK_FORMAT; with bMayDrop it is dropped rather than waited for
+	bool CaptureToSink(GLuint framebuffer, int width, int height, FrameSink pSink, void* pContext,
+		uint32_t tag, bool bMayDrop = true, int format = SINK_PNG);
+	// hand the readbacks that finished to the encoders, once a frame
+	// while any may be pending, so none waits for the next capture
+	void Poll();
+	// wait for every readback and file, and end the encoder threads
+	void Finish();
+
+	const CAPTURE_STATS& GetStats() const { return(m_stats); }
+
+	// encode RGBA pixels, rows bottom up as GL reads them, into a
+	// PNG or TGA file in memory
+	static void EncodePNG(const unsigned char* pixels, int width, int height, std::vector<unsigned char>& file);
+	static void EncodeTGA(const unsigned char* pixels, int width, int height, std::vector<unsigned char>& file);
+
+private:
+	// a pixel buffer and the frame read into it
+	struct READBACK_SLOT
+	{
+		GLuint buffer;
+		GLsizeiptr size;
+		GLsync fence;		// 0 when no frame is pending
+		int width;
+		int height;
+		std::string filename;
+		// the sink of the frame, NULL for a file, and its tag
+		FrameSink pSink;
+		void* pSinkContext;
+		uint32_t tag;
+		int format;
+	};
+	// a read back frame waiting for an encoder
+	struct ENCODE_JOB
+	{
+		std::vector<unsigned char> pixels;
+		int width;
+		int height;
+		std::string filename;
+		FrameSink pSink;
+		void* pSinkContext;
+		uint32_t tag;
+		int format;
+	};
+
+	READBACK_SLOT m_slots[READBACK_SLOTS];
+	// slot the next capture reads into; the pending ones follow it
+	// from the oldest
+	int m_nextSlot;
+	// encode queue, guarded by m_mutex, and its limit, which keeps
+	// the read back frames from piling up when the encoders fall
+	// behind
+	std::deque<ENCODE_JOB> m_jobs;
+	size_t m_maxQueuedJobs;
+	int m_activeJobs;
+	bool m_bStopping;
+	std::mutex m_mutex;
+	std::condition_variable m_jobQueued;
+	std::condition_variable m_jobDone;
+	std::vector<std::thread> m_encoders;
+	CAPTURE_STATS m_stats;
+
+	// the NV12 conversion, 0 until EnableVideoFrames(), and the copy
+	// of the frame it reads, made for the size of the frame
+	ShaderManager* m_pShaderManager;
+	GLuint m_videoProgram;
+	GLint m_frameSizeLocation;
+	GLint m_pictureSizeLocation;
+	GLuint m_videoTexture;
+	GLuint m_videoFramebuffer;
+	int m_videoWidth;
+	int m_videoHeight;
+
+	// start the readback of a frame into the next pixel buffer
+	bool StartReadback(GLuint framebuffer, int width, int height, const std::string& filename,
+		bool bMayDrop, FrameSink pSink, void* pSinkContext, uint32_t tag, int format);
+	// convert a frame to NV12 into a pixel buffer of its slot
+	void ConvertVideoFrame(GLuint framebuffer, int width, int height, GLuint buffer);
+	// release the copy of the frame the conversion reads
+	void ReleaseVideoTexture();
+	// map the frame of a slot once its fence passed and queue it
+	// for the encoders; without bWait only a finished frame is taken,
+	// and only while the encoders have room for it
+	bool CompleteSlot(int slot, bool bWait);
+	// body of an encoder thread
+	void EncodeLoop();
+	// encode a frame and write its file, on any thread
+	void EncodeJob(const ENCODE_JOB& job);
+};
@@ -0,0 +1,279 @@
+///////////////////////////////////////////////////////////////////////////////
+// framepacer.cpp
+// ============
+// presentation mode, frame rate limiter and frame interval statistics
+//
+//  The swap interval is set explicitly instead of left to the driver
+//  default, and a capped mode presents on a fixed schedule of
+//  deadlines, so the frames are spaced evenly rather than as soon as
+//  they are done.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "FramePacer.h"
+
+#include <glm/glm.hpp>
+
+#include <cstring>
+#include <thread>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <mmsystem.h>
+#endif
+
+namespace
+{
+	// names of the PRESENT_MODE values, for the command line and stats
+	const char* const PRESENT_MODE_NAMES[FramePacer::PRESENT_MODE_COUNT] =
+	{
+		"vsync",
+		"adaptive",
+		"uncapped",
+		"capped"
+	};
+
+	// frame rate of the capped mode unless one is set
+	const double DEFAULT_FRAME_CAP = 60.0;
+	// range of the frame cap
+	const double MIN_FRAME_CAP = 10.0;
+	const double MAX_FRAME_CAP = 1000.0;
+
+	// time before a deadline the limiter stops sleeping and spins,
+	// covering how late the OS may wake a sleeping thread
+	const std::chrono::microseconds SPIN_MARGIN(1500);
+}
+
+/***********************************************************
+ *  FramePacer()
+ *
+ *  The constructor for the class. On Windows the timer
+ *  resolution is raised to 1 ms while the pacer exists, so
+ *  the limiter sleeps are not rounded up to the 15.6 ms
+ *  default tick.
+ ***********************************************************/
+FramePacer::FramePacer()
+{
+	m_presentMode = PRESENT_VSYNC;
+	m_appliedMode = -1;
+	m_frameCap = DEFAULT_FRAME_CAP;
+	m_bAdaptiveFallback = false;
+	m_bHasLastPresent = false;
+	memset(&m_stats, 0, sizeof(m_stats));
+
+#ifdef _WIN32
+	timeBeginPeriod(1);
+#endif
+}
+
+/***********************************************************
+ *  ~FramePacer()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+FramePacer::~FramePacer()
+{
+#ifdef _WIN32
+	timeEndPeriod(1);
+#endif
+}
+
+/***********************************************************
+ *  GetPresentModeName()
+ *
+ *  This method is used for getting the name of a mode.
+ ***********************************************************/
+const char* FramePacer::GetPresentModeName(int mode)
+{
+	if ((mode < 0) || (mode >= PRESENT_MODE_COUNT))
+	{
+		return("unknown");
+	}
+	return(PRESENT_MODE_NAMES[mode]);
+}
+
+/***********************************************************
+ *  FindPresentMode()
+ *
+ *  This method is used for looking up a mode by its name.
+ ***********************************************************/
+int FramePacer::FindPresentMode(const char* name)
+{
+	for (int i = 0; i < PRESENT_MODE_COUNT; i++)
+	{
+		if (strcmp(PRESENT_MODE_NAMES[i], name) == 0)
+		{
+			return(i);
+		}
+	}
+	return(-1);
+}
+
+/***********************************************************
+ *  SetPresentMode()
+ *
+ *  This method is used for choosing how the frames are
+ *  presented. The swap interval changes on the next
+ *  Present(), on the thread owning the GL context.
+ ***********************************************************/
+void FramePacer::SetPresentMode(int mode)
+{
+	m_presentMode = glm::clamp(mode, 0, (int)PRESENT_MODE_COUNT - 1);
+}
+
+/***********************************************************
+ *  SetFrameCap()
+ *
+ *  This method is used for setting the frame rate of the
+ *  capped mode.
+ ***********************************************************/
+void FramePacer::SetFrameCap(double framesPerSecond)
+{
+	m_frameCap = glm::clamp(framesPerSecond, MIN_FRAME_CAP, MAX_FRAME_CAP);
+	m_bHasLastPresent = false;
+}
+
+/***********************************************************
+ *  Present()
+ *
+ *  This method is used for presenting a finished frame. In
+ *  the capped mode it first waits for the deadline of the
+ *  frame, then swaps, and measures the interval from the
+ *  present before.
+ ***********************************************************/
+void FramePacer::Present(GLFWwindow* window)
+{
+	if (m_presentMode != m_appliedMode)
+	{
+		ApplySwapInterval();
+	}
+
+	if (m_presentMode == PRESENT_CAPPED)
+	{
+		WaitForDeadline();
+	}
+
+	glfwSwapBuffers(window);
+
+	CLOCK::time_point now = CLOCK::now();
+	if (m_bHasLastPresent == true)
+	{
+		double seconds = std::chrono::duration<double>(now - m_lastPresent).count();
+		if (m_stats.intervals == 0)
+		{
+			m_stats.minSeconds = seconds;
+			m_stats.maxSeconds = seconds;
+		}
+		m_stats.intervals++;
+		m_stats.totalSeconds += seconds;
+		m_stats.totalSquaredSeconds += seconds * seconds;
+		m_stats.minSeconds = glm::min(m_stats.minSeconds, seconds);
+		m_stats.maxSeconds = glm::max(m_stats.maxSeconds, seconds);
+	}
+	m_lastPresent = now;
+	m_bHasLastPresent = true;
+}
+
+/***********************************************************
+ *  ResetPacing()
+ *
+ *  This method is used for starting the intervals over,
+ *  after a pause in which no frames were presented.
+ ***********************************************************/
+void FramePacer::ResetPacing()
+{
+	m_bHasLastPresent = false;
+}
+
+/***********************************************************
+ *  ApplySwapInterval()
+ *
+ *  This method is used for setting the swap interval of the
+ *  mode. Adaptive vsync is a negative interval, which only
+ *  drivers with the swap control tear extension accept;
+ *  without it the mode falls back to plain vsync.
+ ***********************************************************/
+void FramePacer::ApplySwapInterval()
+{
+	m_bAdaptiveFallback = false;
+	switch (m_presentMode)
+	{
+	case PRESENT_ADAPTIVE_VSYNC:
+		if ((glfwExtensionSupported("WGL_EXT_swap_control_tear") == GLFW_TRUE) ||
+			(glfwExtensionSupported("GLX_EXT_swap_control_tear") == GLFW_TRUE))
+		{
+			glfwSwapInterval(-1);
+		}
+		else
+		{
+			m_bAdaptiveFallback = true;
+			glfwSwapInterval(1);
+		}
+		break;
+
+	case PRESENT_UNCAPPED:
+	case PRESENT_CAPPED:
+		glfwSwapInterval(0);
+		break;
+
+	case PRESENT_VSYNC:
+	default:
+		glfwSwapInterval(1);
+		break;
+	}
+
+	m_appliedMode = m_presentMode;
+	m_bHasLastPresent = false;
+}
+
+/***********************************************************
+ *  WaitForDeadline()
+ *
+ *  This method is used for holding the frame until its
+ *  deadline. The deadlines follow each other at the frame
+ *  cap from the first one rather than from whenever the
+ *  last frame was done, so a frame that was slow to render
+ *  does not push every later one back. A frame later than a
+ *  whole interval starts the schedule over instead of
+ *  rushing the frames after it. The thread sleeps until
+ *  shortly before the deadline and spins the rest, since a
+ *  sleep may wake up late.
+ ***********************************************************/
+void FramePacer::WaitForDeadline()
+{
+	CLOCK::duration interval = std::chrono::duration_cast<CLOCK::duration>(
+		std::chrono::duration<double>(1.0 / m_frameCap));
+
+	CLOCK::time_point start = CLOCK::now();
+	if (m_bHasLastPresent == false)
+	{
+		m_nextDeadline = start;
+		return;
+	}
+
+	m_nextDeadline += interval;
+	if (start > m_nextDeadline + interval)
+	{
+		m_nextDeadline = start;
+		return;
+	}
+
+	CLOCK::time_point now = start;
+	while (m_nextDeadline - now > SPIN_MARGIN)
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		now = CLOCK::now();
+	}
+	while (now < m_nextDeadline)
+	{
+		std::this_thread::yield();
+		now = CLOCK::now();
+	}
+
+	m_stats.waitSeconds += std::chrono::duration<double>(now - start).count();
+}
@@ -0,0 +1,100 @@
+///////////////////////////////////////////////////////////////////////////////
+// framepacer.h
+// ============
+// presentation mode, frame rate limiter and frame interval statistics
+//
+//  The swap interval is set explicitly instead of left to the driver
+//  default, and a capped mode presents on a fixed schedule of
+//  deadlines, so the frames are spaced evenly rather than as soon as
+//  they are done.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+#include "GLFW/glfw3.h"
+
+#include <chrono>
+
+/***********************************************************
+ *  FramePacer
+ *
+ *  This class contains the presentation of the frames. The
+ *  mode is applied with glfwSwapInterval() when it changes,
+ *  and every Present() swaps the buffers of the window,
+ *  after waiting for the next deadline in the capped mode,
+ *  and measures the interval since the one before.
+ ***********************************************************/
+class FramePacer
+{
+public:
+	// constructor
+	FramePacer();
+	// destructor
+	~FramePacer();
+
+	// how the frames are presented
+	enum PRESENT_MODE
+	{
+		PRESENT_VSYNC,				// wait for every vertical blank
+		PRESENT_ADAPTIVE_VSYNC,		// tear instead of waiting when late
+		PRESENT_UNCAPPED,			// swap as soon as a frame is done
+		PRESENT_CAPPED,				// no vsync, limited to the frame cap
+		PRESENT_MODE_COUNT
+	};
+
+	// name of a presentation mode, as taken by FindPresentMode()
+	static const char* GetPresentModeName(int mode);
+	// presentation mode of a name, -1 for an unknown name
+	static int FindPresentMode(const char* name);
+
+	// presentation mode, applied by the next Present()
+	void SetPresentMode(int mode);
+	int GetPresentMode() const { return(m_presentMode); }
+	// frame rate of the capped mode
+	void SetFrameCap(double framesPerSecond);
+	double GetFrameCap() const { return(m_frameCap); }
+	// true when adaptive vsync was asked for and the driver lacks
+	// it, so plain vsync is used instead
+	bool IsAdaptiveVsyncFallback() const { return(m_bAdaptiveFallback); }
+
+	// wait for the frame deadline of the mode and swap the buffers
+	// of the window
+	void Present(GLFWwindow* window);
+	// forget the last present, after the loop waited for events,
+	// so the wait neither counts as a frame interval nor makes
+	// the limiter hurry to catch up
+	void ResetPacing();
+
+	// intervals between consecutive presents
+	struct PACING_STATS
+	{
+		unsigned long long intervals;	// intervals measured
+		double totalSeconds;			// sum of the intervals
+		double totalSquaredSeconds;		// sum of their squares
+		double minSeconds;
+		double maxSeconds;
+		double waitSeconds;				// spent in the limiter
+	};
+	const PACING_STATS& GetStats() const { return(m_stats); }
+
+private:
+	typedef std::chrono::steady_clock CLOCK;
+
+	int m_presentMode;
+	// mode last passed to glfwSwapInterval(), -1 before the first
+	int m_appliedMode;
+	double m_frameCap;
+	bool m_bAdaptiveFallback;
+	// time of the last present, and whether there is one
+	CLOCK::time_point m_lastPresent;
+	bool m_bHasLastPresent;
+	// time the next capped frame is presented at
+	CLOCK::time_point m_nextDeadline;
+	PACING_STATS m_stats;
+
+	// set the swap interval of the current mode
+	void ApplySwapInterval();
+	// sleep, then spin, until the next deadline of the frame cap
+	void WaitForDeadline();
+};
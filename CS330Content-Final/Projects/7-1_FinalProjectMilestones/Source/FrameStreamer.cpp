@@ -0,0 +1,771 @@
+///////////////////////////////////////////////////////////////////////////////
+// framestreamer.cpp
+// ============
+// streaming of the rendered frames to a remote viewer, and its input back
+//
+//  The frames are converted to NV12 on the GPU and read back by the
+//  frame capture pipeline, so streaming never waits for the GPU, and
+//  piped into an FFmpeg process encoding H.264 with the hardware
+//  encoder of the GPU, NVENC, VA-API, AMF or Quick Sync, which sends
+//  it over RTP to the client, or over WebRTC to a WHIP endpoint. A
+//  frame finished while the one before is still being encoded
+//  replaces the one waiting. When the hardware encoder fails, x264
+//  takes over.
+//
+//  One client at a time connects over TCP. It is sent the SDP of the
+//  RTP stream and, for every frame, a header carrying the id of the
+//  newest input the frame took; it sends its keys and mouse movement
+//  the other way, which are handed to the view manager on the main
+//  thread as if they came from the window, so the client can time its
+//  input to the frame that shows it and report that back.
+//
+//  Messages are little endian. The SDP is a STREAM_FRAME_HEADER with
+//  SDP_MAGIC and the text after it; a frame is a STREAM_FRAME_HEADER
+//  alone, the picture being in the RTP stream. The client sends
+//  STREAM_INPUT messages.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "FrameStreamer.h"
+#include "NetSocket.h"
+#include "ViewManager.h"
+#include "ScopeProfiler.h"
+#include "Logger.h"
+
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <iostream>
+
+namespace
+{
+	const uintptr_t NO_SOCKET = NetSocket::INVALID_HANDLE;
+
+	// the FFmpeg name of each VIDEO_ENCODER, the codec it picks, and
+	// the options before and after the input making it encode for low
+	// latency; VA-API uploads the NV12 frames to the GPU itself
+	struct ENCODER_INFO
+	{
+		const char* name;
+		const char* codec;
+		const char* inputOptions;
+		const char* outputOptions;
+	};
+	const ENCODER_INFO ENCODERS[FrameStreamer::ENCODER_COUNT] =
+	{
+		{ "nvenc", "h264_nvenc", "", "-preset p1 -tune ull -zerolatency 1 -rc cbr" },
+		{ "vaapi", "h264_vaapi", "-vaapi_device /dev/dri/renderD128", "-vf format=nv12,hwupload" },
+		{ "amf", "h264_amf", "", "-usage ultralowlatency -quality speed -rc cbr" },
+		{ "qsv", "h264_qsv", "", "-preset veryfast -async_depth 1" },
+		{ "x264", "libx264", "", "-preset ultrafast -tune zerolatency" }
+	};
+
+	// frames between key frames, which a client joining late or
+	// losing packets waits for at most
+	const int KEY_FRAME_INTERVAL = 120;
+	// largest RTP packet, below the usual MTU with room for a tunnel
+	const int RTP_PACKET_SIZE = 1200;
+	// RTP payload type of the H.264 stream, the first dynamic one
+	const int RTP_PAYLOAD_TYPE = 96;
+	// the RTP stream goes to this far past the TCP port unless the
+	// client asks for another
+	const int VIDEO_PORT_OFFSET = 2;
+
+	// longest the threads block on a socket before checking whether
+	// the streamer stops
+	const long POLL_MICROSECONDS = 100000;
+	// inputs kept waiting for a frame, the oldest dropped beyond
+	const size_t MAX_TIMED_INPUTS = 256;
+
+	double NowSeconds()
+	{
+		return(std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count());
+	}
+
+	// the hardware encoder of the GPU's vendor; AMD and Intel are
+	// reached through their own SDKs on Windows and VA-API elsewhere
+	int PickEncoder(const char* gpuVendor)
+	{
+		std::string vendor = (NULL != gpuVendor) ? gpuVendor : "";
+		bool bAMD = (vendor.find("AMD") != std::string::npos) || (vendor.find("ATI") != std::string::npos);
+		bool bIntel = (vendor.find("Intel") != std::string::npos);
+		if (vendor.find("NVIDIA") != std::string::npos)
+		{
+			return(FrameStreamer::ENCODER_NVENC);
+		}
+#ifdef _WIN32
+		if (bAMD == true)
+		{
+			return(FrameStreamer::ENCODER_AMF);
+		}
+		if (bIntel == true)
+		{
+			return(FrameStreamer::ENCODER_QSV);
+		}
+#else
+		if ((bAMD == true) || (bIntel == true))
+		{
+			return(FrameStreamer::ENCODER_VAAPI);
+		}
+#endif
+		return(FrameStreamer::ENCODER_X264);
+	}
+
+	// run a command with a pipe to its standard input
+	FILE* OpenPipe(const std::string& command)
+	{
+#ifdef _WIN32
+		// cmd.exe drops the outer quotes of the line, so it gets a
+		// pair more to keep those of the path and URL
+		return(_popen(("\"" + command + "\"").c_str(), "wb"));
+#else
+		return(popen(command.c_str(), "w"));
+#endif
+	}
+
+	// close the pipe, waiting for the command to end
+	void ClosePipe(FILE* pPipe)
+	{
+#ifdef _WIN32
+		_pclose(pPipe);
+#else
+		pclose(pPipe);
+#endif
+	}
+}
+
+/***********************************************************
+ *  FrameStreamer()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+FrameStreamer::FrameStreamer()
+{
+	m_encoder = ENCODER_X264;
+	m_bitrateKbps = 0;
+	m_port = 0;
+	m_listenSocket = NO_SOCKET;
+	m_clientSocket = NO_SOCKET;
+	m_bConnected = false;
+	m_bStopping = false;
+	m_pumpedInputId = 0;
+	m_timedInputId = 0;
+	m_pendingFrame.width = 0;
+	m_pendingFrame.height = 0;
+	m_pendingFrame.inputId = 0;
+	m_bFramePending = false;
+	m_sequence = 0;
+	m_videoPort = 0;
+	m_bRestartEncoder = false;
+	m_pEncoderPipe = NULL;
+	m_activeEncoder = ENCODER_X264;
+	m_encoderWidth = 0;
+	m_encoderHeight = 0;
+	m_bEncoderFailed = false;
+	memset(&m_stats, 0, sizeof(m_stats));
+}
+
+/***********************************************************
+ *  ~FrameStreamer()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+FrameStreamer::~FrameStreamer()
+{
+	Stop();
+}
+
+/***********************************************************
+ *  Start()
+ *
+ *  This method is used for opening the port on every
+ *  interface and starting the threads, which then take one
+ *  client at a time. FFmpeg is started by the first frame
+ *  for a client, once its size is known.
+ ***********************************************************/
+bool FrameStreamer::Start(int port, const char* ffmpegPath, int encoder, int bitrateKbps, const char* whipUrl,
+	const char* gpuVendor)
+{
+	Stop();
+
+	if (NetSocket::Startup() == false)
+	{
+		LOG_ERROR("Could not start the sockets for streaming");
+		return(false);
+	}
+	uintptr_t listenSocket = NetSocket::Listen(port, false);
+	if (listenSocket == NO_SOCKET)
+	{
+		LOG_ERROR("Could not listen for a stream client on port %d", port);
+		NetSocket::Cleanup();
+		return(false);
+	}
+#ifndef _WIN32
+	// a write to FFmpeg after it exited fails instead of ending the
+	// process, so the stream can fall back to another encoder
+	signal(SIGPIPE, SIG_IGN);
+#endif
+
+	m_ffmpegPath = (NULL != ffmpegPath) ? ffmpegPath : "ffmpeg";
+	m_encoder = ((encoder >= 0) && (encoder < ENCODER_COUNT)) ? encoder : PickEncoder(gpuVendor);
+	m_activeEncoder = m_encoder;
+	m_bitrateKbps = bitrateKbps;
+	m_whipUrl = (NULL != whipUrl) ? whipUrl : "";
+	m_port = port;
+	m_stats.encoder = ENCODERS[m_encoder].codec;
+	m_listenSocket = listenSocket;
+	m_bStopping = false;
+	m_receiveThread = std::thread(&FrameStreamer::ReceiveLoop, this);
+	m_sendThread = std::thread(&FrameStreamer::SendLoop, this);
+	LOG_INFO("Streaming frames on port %d, encoded with %s", port, ENCODERS[m_encoder].codec);
+	return(true);
+}
+
+/***********************************************************
+ *  FindEncoder()
+ *
+ *  This method is used for looking up an encoder by the
+ *  name --stream-encoder takes.
+ ***********************************************************/
+int FrameStreamer::FindEncoder(const char* name)
+{
+	if (strcmp(name, "auto") == 0)
+	{
+		return(ENCODER_AUTO);
+	}
+	for (int i = 0; i < ENCODER_COUNT; i++)
+	{
+		if (strcmp(name, ENCODERS[i].name) == 0)
+		{
+			return(i);
+		}
+	}
+	return(ENCODER_COUNT);
+}
+
+/***********************************************************
+ *  Stop()
+ *
+ *  This method is used for ending the threads and closing
+ *  the client and the port.
+ ***********************************************************/
+void FrameStreamer::Stop()
+{
+	if (m_listenSocket == NO_SOCKET)
+	{
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_sendMutex);
+		m_bStopping = true;
+	}
+	m_frameQueued.notify_all();
+	m_receiveThread.join();
+	m_sendThread.join();
+
+	StopEncoder();
+	CloseClient();
+	NetSocket::Close(m_listenSocket);
+	m_listenSocket = NO_SOCKET;
+	NetSocket::Cleanup();
+}
+
+/***********************************************************
+ *  PumpInput()
+ *
+ *  This method is used for handing the keys and mouse
+ *  movement of the client to the view manager, through the
+ *  same callbacks the window calls, so they reach the
+ *  queues and the camera from the thread that owns them.
+ *  The time each is handed on is kept, to time it to the
+ *  first frame sent with it.
+ ***********************************************************/
+void FrameStreamer::PumpInput()
+{
+	std::vector<STREAM_INPUT> inputs;
+	{
+		std::lock_guard<std::mutex> lock(m_inputMutex);
+		inputs.swap(m_receivedInput);
+	}
+	if (inputs.empty() == true)
+	{
+		return;
+	}
+
+	double now = NowSeconds();
+	for (size_t i = 0; i < inputs.size(); i++)
+	{
+		const STREAM_INPUT& input = inputs[i];
+		if (input.type == INPUT_KEY)
+		{
+			ViewManager::Key_Callback(NULL, (int)input.values[0], 0, (int)input.values[1], 0);
+		}
+		else if (input.type == INPUT_MOUSE_MOVE)
+		{
+			ViewManager::InjectMouseMovement((double)input.values[0], (double)input.values[1]);
+		}
+	}
+
+	std::lock_guard<std::mutex> lock(m_inputMutex);
+	for (size_t i = 0; i < inputs.size(); i++)
+	{
+		INPUT_TIME inputTime;
+		inputTime.inputId = inputs[i].inputId;
+		inputTime.time = now;
+		m_inputTimes.push_back(inputTime);
+	}
+	while (m_inputTimes.size() > MAX_TIMED_INPUTS)
+	{
+		m_inputTimes.pop_front();
+	}
+	m_pumpedInputId = inputs.back().inputId;
+}
+
+/***********************************************************
+ *  SendFrame()
+ *
+ *  This method is used for queueing an NV12 frame for the
+ *  encoding thread. Only the newest frame waits; one still
+ *  waiting is replaced, so a slow encoder or connection
+ *  gets fewer frames rather than older ones.
+ ***********************************************************/
+void FrameStreamer::SendFrame(const std::vector<unsigned char>& image, int width, int height, uint32_t inputId)
+{
+	if (HasClient() == false)
+	{
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_sendMutex);
+		if (m_bFramePending == true)
+		{
+			m_stats.framesReplaced++;
+		}
+		m_pendingFrame.image = image;
+		m_pendingFrame.width = width;
+		m_pendingFrame.height = height;
+		m_pendingFrame.inputId = inputId;
+		m_bFramePending = true;
+	}
+	m_frameQueued.notify_one();
+}
+
+/***********************************************************
+ *  FrameSink()
+ *
+ *  This method is used for passing the NV12 frames the
+ *  capture encoders take to the streamer given as the
+ *  context.
+ ***********************************************************/
+void FrameStreamer::FrameSink(void* pContext, const std::vector<unsigned char>& image,
+	int width, int height, uint32_t tag)
+{
+	((FrameStreamer*)pContext)->SendFrame(image, width, height, tag);
+}
+
+/***********************************************************
+ *  ReceiveLoop()
+ *
+ *  This method is used for taking a client on the port and
+ *  reading its messages, which may arrive split anywhere,
+ *  until it leaves and the next one may connect. The keys
+ *  and movement wait for PumpInput(), and an empty event
+ *  wakes the main loop for them while it waits for the
+ *  window; the display reports are counted here. A new
+ *  client, or a new RTP port of one, starts the encoder
+ *  over with the destination.
+ ***********************************************************/
+void FrameStreamer::ReceiveLoop()
+{
+	ScopeProfiler::SetThreadName("stream receive");
+	std::vector<unsigned char> received;
+	char buffer[4096];
+	while (m_bStopping.load() == false)
+	{
+		if (HasClient() == false)
+		{
+			if (NetSocket::WaitReadable(m_listenSocket, POLL_MICROSECONDS) == false)
+			{
+				continue;
+			}
+			uintptr_t clientSocket = NetSocket::Accept(m_listenSocket);
+			if (clientSocket == NO_SOCKET)
+			{
+				continue;
+			}
+			received.clear();
+			std::string clientAddress = NetSocket::GetPeerAddress(clientSocket);
+			{
+				std::lock_guard<std::mutex> lock(m_sendMutex);
+				m_clientSocket = clientSocket;
+				m_clientAddress = clientAddress;
+				m_videoPort = m_port + VIDEO_PORT_OFFSET;
+				m_bFramePending = false;
+				m_bRestartEncoder = true;
+			}
+			m_frameQueued.notify_one();
+			{
+				std::lock_guard<std::mutex> lock(m_inputMutex);
+				m_stats.clients++;
+			}
+			m_bConnected = true;
+			LOG_INFO("Stream client connected from %s", clientAddress.c_str());
+			continue;
+		}
+
+		if (NetSocket::WaitReadable(m_clientSocket, POLL_MICROSECONDS) == false)
+		{
+			continue;
+		}
+		int bytes = NetSocket::Receive(m_clientSocket, buffer, sizeof(buffer));
+		if (bytes <= 0)
+		{
+			CloseClient();
+			LOG_INFO("Stream client disconnected");
+			continue;
+		}
+		received.insert(received.end(), buffer, buffer + bytes);
+
+		size_t messageCount = received.size() / sizeof(STREAM_INPUT);
+		if (messageCount == 0)
+		{
+			continue;
+		}
+		bool bInput = false;
+		int videoPort = 0;
+		{
+			std::lock_guard<std::mutex> lock(m_inputMutex);
+			for (size_t i = 0; i < messageCount; i++)
+			{
+				STREAM_INPUT input;
+				memcpy(&input, &received[i * sizeof(STREAM_INPUT)], sizeof(STREAM_INPUT));
+				if (input.type == INPUT_DISPLAYED)
+				{
+					double seconds = (double)input.values[0] / 1000000.0;
+					m_stats.glassToGlassInputs++;
+					m_stats.glassToGlassSeconds += seconds;
+					m_stats.glassToGlassMaxSeconds = std::max(m_stats.glassToGlassMaxSeconds, seconds);
+				}
+				else if (input.type == INPUT_VIDEO_PORT)
+				{
+					videoPort = (int)input.values[0];
+				}
+				else if ((input.type == INPUT_KEY) || (input.type == INPUT_MOUSE_MOVE))
+				{
+					m_receivedInput.push_back(input);
+					m_stats.inputs++;
+					bInput = true;
+				}
+			}
+		}
+		received.erase(received.begin(), received.begin() + messageCount * sizeof(STREAM_INPUT));
+		if ((videoPort > 0) && (videoPort < 65536))
+		{
+			{
+				std::lock_guard<std::mutex> lock(m_sendMutex);
+				m_videoPort = videoPort;
+				m_bRestartEncoder = true;
+			}
+			m_frameQueued.notify_one();
+		}
+		if (bInput == true)
+		{
+			glfwPostEmptyEvent();
+		}
+	}
+}
+
+/***********************************************************
+ *  SendLoop()
+ *
+ *  This method is used for handing each queued frame to
+ *  the encoder and sending its header. A failed send shuts
+ *  the connection down, which ends the reading of the
+ *  receiving thread, which then closes it. The inputs the
+ *  frame took are timed from their handing on to the send
+ *  of its header, which follows the picture into FFmpeg.
+ *  A new client or port stops the encoder, and the next
+ *  frame starts it with the encoder asked for again.
+ ***********************************************************/
+void FrameStreamer::SendLoop()
+{
+	ScopeProfiler::SetThreadName("stream send");
+	PENDING_FRAME frame;
+	std::unique_lock<std::mutex> lock(m_sendMutex);
+	while (true)
+	{
+		m_frameQueued.wait(lock, [this]() {
+			return((m_bFramePending == true) || (m_bRestartEncoder == true) || (m_bStopping.load() == true)); });
+		if (m_bStopping.load() == true)
+		{
+			lock.unlock();
+			StopEncoder();
+			return;
+		}
+		if (m_bRestartEncoder == true)
+		{
+			m_bRestartEncoder = false;
+			lock.unlock();
+			StopEncoder();
+			m_activeEncoder = m_encoder;
+			m_bEncoderFailed = false;
+			lock.lock();
+			continue;
+		}
+		std::swap(frame, m_pendingFrame);
+		m_bFramePending = false;
+		uintptr_t clientSocket = m_clientSocket;
+		std::string clientAddress = m_clientAddress;
+		int videoPort = m_videoPort;
+
+		STREAM_FRAME_HEADER header;
+		header.magic = FRAME_MAGIC;
+		header.sequence = m_sequence++;
+		header.width = (uint32_t)frame.width;
+		header.height = (uint32_t)frame.height;
+		header.inputId = frame.inputId;
+		header.bytes = 0;
+		lock.unlock();
+
+		bool bEncoded = false;
+		if (m_bEncoderFailed == false)
+		{
+			bEncoded = EncodePicture(frame, clientSocket, clientAddress, videoPort);
+			m_bEncoderFailed = (bEncoded == false);
+		}
+		bool bSent = NetSocket::SendAll(clientSocket, &header, sizeof(header));
+		double now = NowSeconds();
+
+		lock.lock();
+		if (bSent == false)
+		{
+			NetSocket::Shutdown(clientSocket);
+			continue;
+		}
+		m_stats.framesSent++;
+		m_stats.bytesSent += sizeof(header);
+		if (bEncoded == true)
+		{
+			m_stats.bytesEncoded += frame.image.size();
+		}
+
+		std::lock_guard<std::mutex> inputLock(m_inputMutex);
+		while ((m_inputTimes.empty() == false) && (frame.inputId != 0) &&
+			((int32_t)(frame.inputId - m_inputTimes.front().inputId) >= 0))
+		{
+			double seconds = now - m_inputTimes.front().time;
+			m_stats.serverLatencyInputs++;
+			m_stats.serverLatencySeconds += seconds;
+			m_stats.serverLatencyMaxSeconds = std::max(m_stats.serverLatencyMaxSeconds, seconds);
+			m_inputTimes.pop_front();
+		}
+	}
+}
+
+/***********************************************************
+ *  StartEncoder()
+ *
+ *  This method is used for running FFmpeg on the raw NV12
+ *  pictures of a size, timed as they arrive, encoding them
+ *  without B-frames and with the parameter sets repeated
+ *  before every key frame, so a client may join the stream
+ *  anywhere. The packets go out as soon as they are made,
+ *  over RTP to the client, whom the SDP of the stream is
+ *  sent to, or to the WHIP endpoint, which negotiates its
+ *  own.
+ ***********************************************************/
+bool FrameStreamer::StartEncoder(int width, int height, uintptr_t clientSocket, const std::string& clientAddress,
+	int videoPort)
+{
+	const ENCODER_INFO& encoder = ENCODERS[m_activeEncoder];
+	bool bIPv6 = (clientAddress.find(':') != std::string::npos);
+	char option[64];
+	std::string destination;
+	if (m_whipUrl.empty() == false)
+	{
+		destination = "-f whip \"" + m_whipUrl + "\"";
+	}
+	else
+	{
+		snprintf(option, sizeof(option), ":%d?pkt_size=%d", videoPort, RTP_PACKET_SIZE);
+		destination = "-f rtp \"rtp://" + ((bIPv6 == true) ? "[" + clientAddress + "]" : clientAddress) +
+			option + "\"";
+	}
+
+	std::string command = "\"" + m_ffmpegPath + "\" -hide_banner -loglevel error " + encoder.inputOptions;
+	snprintf(option, sizeof(option), " -f rawvideo -pix_fmt nv12 -video_size %dx%d", width, height);
+	command += std::string(option) + " -use_wallclock_as_timestamps 1 -i - " + encoder.outputOptions +
+		" -c:v " + encoder.codec;
+	snprintf(option, sizeof(option), " -b:v %dk -bf 0 -g %d", m_bitrateKbps, KEY_FRAME_INTERVAL);
+	command += std::string(option) + " -bsf:v dump_extra -fps_mode passthrough -flush_packets 1 -an " + destination;
+
+	m_pEncoderPipe = OpenPipe(command);
+	if (NULL == m_pEncoderPipe)
+	{
+		return(false);
+	}
+	m_encoderWidth = width;
+	m_encoderHeight = height;
+	{
+		std::lock_guard<std::mutex> lock(m_sendMutex);
+		m_stats.encoder = encoder.codec;
+		m_stats.encoderStarts++;
+	}
+	LOG_INFO("Encoding the stream at %dx%d with %s", width, height, encoder.codec);
+	if (m_whipUrl.empty() == false)
+	{
+		return(true);
+	}
+
+	const char* addressType = (bIPv6 == true) ? "IP6" : "IP4";
+	char sdp[512];
+	snprintf(sdp, sizeof(sdp),
+		"v=0\r\n"
+		"o=- 0 0 IN %s %s\r\n"
+		"s=stream\r\n"
+		"c=IN %s %s\r\n"
+		"t=0 0\r\n"
+		"m=video %d RTP/AVP %d\r\n"
+		"a=rtpmap:%d H264/90000\r\n"
+		"a=fmtp:%d packetization-mode=1\r\n",
+		addressType, clientAddress.c_str(), addressType, clientAddress.c_str(),
+		videoPort, RTP_PAYLOAD_TYPE, RTP_PAYLOAD_TYPE, RTP_PAYLOAD_TYPE);
+	STREAM_FRAME_HEADER header;
+	header.magic = SDP_MAGIC;
+	header.sequence = 0;
+	header.width = (uint32_t)width;
+	header.height = (uint32_t)height;
+	header.inputId = 0;
+	header.bytes = (uint32_t)strlen(sdp);
+	if ((NetSocket::SendAll(clientSocket, &header, sizeof(header)) == false) ||
+		(NetSocket::SendAll(clientSocket, sdp, header.bytes) == false))
+	{
+		NetSocket::Shutdown(clientSocket);
+	}
+	return(true);
+}
+
+/***********************************************************
+ *  EncodePicture()
+ *
+ *  This method is used for writing a picture to FFmpeg,
+ *  starting it first for a new size. A hardware encoder
+ *  that FFmpeg lacks, or that fails on this GPU, makes it
+ *  exit, which fails the write; x264 then takes over.
+ ***********************************************************/
+bool FrameStreamer::EncodePicture(const PENDING_FRAME& frame, uintptr_t clientSocket,
+	const std::string& clientAddress, int videoPort)
+{
+	while (true)
+	{
+		if ((NULL == m_pEncoderPipe) || (frame.width != m_encoderWidth) || (frame.height != m_encoderHeight))
+		{
+			StopEncoder();
+			StartEncoder(frame.width, frame.height, clientSocket, clientAddress, videoPort);
+		}
+		if ((NULL != m_pEncoderPipe) &&
+			(fwrite(frame.image.data(), 1, frame.image.size(), m_pEncoderPipe) == frame.image.size()) &&
+			(fflush(m_pEncoderPipe) == 0))
+		{
+			return(true);
+		}
+
+		StopEncoder();
+		if (m_activeEncoder == ENCODER_X264)
+		{
+			LOG_ERROR("FFmpeg did not take the stream, check that %s runs and has libx264", m_ffmpegPath.c_str());
+			return(false);
+		}
+		LOG_WARNING("The %s encoder failed, streaming with libx264 instead", ENCODERS[m_activeEncoder].codec);
+		m_activeEncoder = ENCODER_X264;
+		std::lock_guard<std::mutex> lock(m_sendMutex);
+		m_stats.encoderFallbacks++;
+	}
+}
+
+/***********************************************************
+ *  StopEncoder()
+ *
+ *  This method is used for ending the input of FFmpeg,
+ *  which then sends what it has left and exits.
+ ***********************************************************/
+void FrameStreamer::StopEncoder()
+{
+	if (NULL != m_pEncoderPipe)
+	{
+		ClosePipe(m_pEncoderPipe);
+		m_pEncoderPipe = NULL;
+	}
+	m_encoderWidth = 0;
+	m_encoderHeight = 0;
+}
+
+/***********************************************************
+ *  CloseClient()
+ *
+ *  This method is used for closing the connection of the
+ *  client and dropping the frame waiting for it. The
+ *  encoding thread stops the encoder streaming to it.
+ ***********************************************************/
+void FrameStreamer::CloseClient()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_sendMutex);
+		m_bConnected = false;
+		if (m_clientSocket != NO_SOCKET)
+		{
+			NetSocket::Close(m_clientSocket);
+			m_clientSocket = NO_SOCKET;
+		}
+		m_bFramePending = false;
+		m_bRestartEncoder = true;
+	}
+	m_frameQueued.notify_one();
+}
+
+/***********************************************************
+ *  GetStats()
+ *
+ *  This method is used for getting a copy of the counters,
+ *  which the threads keep updating.
+ ***********************************************************/
+FrameStreamer::STREAM_STATS FrameStreamer::GetStats() const
+{
+	std::lock_guard<std::mutex> sendLock(m_sendMutex);
+	std::lock_guard<std::mutex> inputLock(m_inputMutex);
+	return(m_stats);
+}
+
+/***********************************************************
+ *  PrintStats()
+ *
+ *  This method is used for printing the frames sent and
+ *  the input latency of the stream.
+ ***********************************************************/
+void FrameStreamer::PrintStats() const
+{
+	STREAM_STATS stats = GetStats();
+	std::cout << "\n*** STREAM: ***\n";
+	std::cout << "clients " << stats.clients
+		<< "\tframes sent " << stats.framesSent
+		<< "\treplaced " << stats.framesReplaced
+		<< "\tsent " << (stats.bytesSent / 1024) << " KB"
+		<< "\tinputs " << stats.inputs << "\n";
+	std::cout << "encoder " << ((NULL != stats.encoder) ? stats.encoder : "none")
+		<< "\tstarts " << stats.encoderStarts
+		<< "\tfallbacks " << stats.encoderFallbacks
+		<< "\tencoded " << (stats.bytesEncoded / (1024 * 1024)) << " MB\n";
+	if (stats.serverLatencyInputs > 0)
+	{
+		std::cout << "input to frame sent\tmean " << (stats.serverLatencySeconds * 1000.0 / stats.serverLatencyInputs)
+			<< " ms\tmax " << (stats.serverLatencyMaxSeconds * 1000.0) << " ms\n";
+	}
+	if (stats.glassToGlassInputs > 0)
+	{
+		std::cout << "glass to glass\tmean " << (stats.glassToGlassSeconds * 1000.0 / stats.glassToGlassInputs)
+			<< " ms\tmax " << (stats.glassToGlassMaxSeconds * 1000.0) << " ms"
+			<< "\tinputs " << stats.glassToGlassInputs << "\n";
+	}
+}
@@ -0,0 +1,243 @@
+///////////////////////////////////////////////////////////////////////////////
+// framestreamer.h
+// ============
+// streaming of the rendered frames to a remote viewer, and its input back
+//
+//  The frames are converted to NV12 on the GPU and read back by the
+//  frame capture pipeline, so streaming never waits for the GPU, and
+//  piped into an FFmpeg process encoding H.264 with the hardware
+//  encoder of the GPU, NVENC, VA-API, AMF or Quick Sync, which sends
+//  it over RTP to the client, or over WebRTC to a WHIP endpoint. A
+//  frame finished while the one before is still being encoded
+//  replaces the one waiting. When the hardware encoder fails, x264
+//  takes over.
+//
+//  One client at a time connects over TCP. It is sent the SDP of the
+//  RTP stream and, for every frame, a header carrying the id of the
+//  newest input the frame took; it sends its keys and mouse movement
+//  the other way, which are handed to the view manager on the main
+//  thread as if they came from the window, so the client can time its
+//  input to the frame that shows it and report that back.
+//
+//  Messages are little endian. The SDP is a STREAM_FRAME_HEADER with
+//  SDP_MAGIC and the text after it; a frame is a STREAM_FRAME_HEADER
+//  alone, the picture being in the RTP stream. The client sends
+//  STREAM_INPUT messages.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/***********************************************************
+ *  FrameStreamer
+ *
+ *  This class contains the listening socket, the connected
+ *  client, the thread receiving its input and the one
+ *  feeding the video encoder. Start() opens the port and
+ *  Stop() closes it; SendFrame() takes the NV12 frames from
+ *  the capture encoders and PumpInput() hands the client's
+ *  input on, once per frame on the main thread.
+ ***********************************************************/
+class FrameStreamer
+{
+public:
+	// constructor
+	FrameStreamer();
+	// destructor
+	~FrameStreamer();
+
+	// what a message from the client is
+	enum INPUT_TYPE
+	{
+		// a key pressed or released, values GLFW key and action
+		INPUT_KEY = 0,
+		// the mouse moved, values the offset in pixels
+		INPUT_MOUSE_MOVE,
+		// the frame showing the input of the id was displayed, value 0
+		// the microseconds from the input to the display
+		INPUT_DISPLAYED,
+		// send the RTP stream to this UDP port of the client, value 0,
+		// rather than to the port after the TCP port's next
+		INPUT_VIDEO_PORT
+	};
+
+	// the encoders FFmpeg may be asked for; ENCODER_AUTO picks the
+	// hardware one of the GPU's vendor
+	enum VIDEO_ENCODER
+	{
+		ENCODER_AUTO = -1,
+		ENCODER_NVENC = 0,
+		ENCODER_VAAPI,
+		ENCODER_AMF,
+		ENCODER_QSV,
+		ENCODER_X264,
+		ENCODER_COUNT
+	};
+
+	// a message from the client, 16 bytes
+	struct STREAM_INPUT
+	{
+		uint32_t type;
+		uint32_t inputId;
+		int32_t values[2];
+	};
+
+	// the header of a frame or of the SDP sent to the client, 24 bytes
+	struct STREAM_FRAME_HEADER
+	{
+		uint32_t magic;			// FRAME_MAGIC or SDP_MAGIC
+		uint32_t sequence;
+		uint32_t width;
+		uint32_t height;
+		uint32_t inputId;		// newest input the frame took, 0 for none
+		uint32_t bytes;			// of the SDP text that follows, 0 for a frame
+	};
+	static const uint32_t FRAME_MAGIC = 0x4D524653;	// "SFRM"
+	static const uint32_t SDP_MAGIC = 0x50445353;	// "SSDP"
+
+	// frames sent and the latency of the input they showed
+	struct STREAM_STATS
+	{
+		unsigned long long clients;
+		unsigned long long framesSent;
+		unsigned long long framesReplaced;	// finished while another waited
+		unsigned long long bytesSent;		// over the TCP connection
+		unsigned long long bytesEncoded;	// of the pictures handed to the encoder
+		const char* encoder;				// FFmpeg name of the last encoder used
+		unsigned long long encoderStarts;
+		unsigned long long encoderFallbacks;	// hardware encoders replaced by x264
+		unsigned long long inputs;
+		// from taking an input to sending the first frame showing it
+		unsigned long long serverLatencyInputs;
+		double serverLatencySeconds;
+		double serverLatencyMaxSeconds;
+		// from the client's input to its display, as the client
+		// measured it
+		unsigned long long glassToGlassInputs;
+		double glassToGlassSeconds;
+		double glassToGlassMaxSeconds;
+	};
+
+	// listen for a client on a TCP port, whose frames FFmpeg, run
+	// from ffmpegPath, encodes at bitrateKbps with a VIDEO_ENCODER,
+	// the automatic pick going by the GL_VENDOR string; with a WHIP
+	// URL the stream goes there over WebRTC instead of to the client
+	// over RTP. False when the port could not be opened
+	bool Start(int port, const char* ffmpegPath, int encoder, int bitrateKbps, const char* whipUrl,
+		const char* gpuVendor);
+	// VIDEO_ENCODER of a name, auto or an FFmpeg encoder family;
+	// ENCODER_COUNT for none
+	static int FindEncoder(const char* name);
+	// close the connection and the port, and end the threads
+	void Stop();
+	// true while a client is connected, so frames are worth reading
+	// back for it
+	bool HasClient() const { return(m_bConnected.load() == true); }
+
+	// hand the input the client sent since the last call to the view
+	// manager, on the thread that owns the window
+	void PumpInput();
+	// id of the newest input PumpInput() handed on
+	uint32_t GetInputId() const { return(m_pumpedInputId.load()); }
+
+	// queue an NV12 frame for the encoder, from any thread; the tag
+	// is the input id of the frame
+	void SendFrame(const std::vector<unsigned char>& image, int width, int height, uint32_t inputId);
+	// FrameCapture::FrameSink sending to the streamer of pContext
+	static void FrameSink(void* pContext, const std::vector<unsigned char>& image,
+		int width, int height, uint32_t tag);
+
+	STREAM_STATS GetStats() const;
+	void PrintStats() const;
+
+private:
+	// a frame waiting for the encoding thread
+	struct PENDING_FRAME
+	{
+		std::vector<unsigned char> image;
+		int width;
+		int height;
+		uint32_t inputId;
+	};
+	// when an input was handed on, for the latency of its frame
+	struct INPUT_TIME
+	{
+		uint32_t inputId;
+		double time;
+	};
+
+	// the encoder asked for and where it sends
+	std::string m_ffmpegPath;
+	int m_encoder;
+	int m_bitrateKbps;
+	std::string m_whipUrl;
+	int m_port;
+
+	// sockets, as the platform's handle type
+	uintptr_t m_listenSocket;
+	uintptr_t m_clientSocket;
+	std::atomic<bool> m_bConnected;
+	std::atomic<bool> m_bStopping;
+	std::thread m_receiveThread;
+	std::thread m_sendThread;
+
+	// input received and not yet handed on, guarded by m_inputMutex
+	mutable std::mutex m_inputMutex;
+	std::vector<STREAM_INPUT> m_receivedInput;
+	std::atomic<uint32_t> m_pumpedInputId;
+	// inputs handed on whose frame was not sent yet, and the id of
+	// the newest one timed
+	std::deque<INPUT_TIME> m_inputTimes;
+	uint32_t m_timedInputId;
+
+	// the frame waiting, guarded by m_sendMutex
+	mutable std::mutex m_sendMutex;
+	std::condition_variable m_frameQueued;
+	PENDING_FRAME m_pendingFrame;
+	bool m_bFramePending;
+	uint32_t m_sequence;
+	// the client's address and RTP port, and whether the encoder has
+	// to start over for a new client or port
+	std::string m_clientAddress;
+	int m_videoPort;
+	bool m_bRestartEncoder;
+
+	// the running FFmpeg process, its encoder and picture size, used
+	// by the encoding thread only; the encoder in use falls back to
+	// x264 once the hardware one failed, and when x264 failed too no
+	// frame is encoded until the next client
+	FILE* m_pEncoderPipe;
+	int m_activeEncoder;
+	int m_encoderWidth;
+	int m_encoderHeight;
+	bool m_bEncoderFailed;
+
+	STREAM_STATS m_stats;
+
+	// accept a client and read its messages until it leaves
+	void ReceiveLoop();
+	// encode the frames queued while a client is connected and send
+	// their headers
+	void SendLoop();
+	// start FFmpeg for a picture size and send the client the SDP of
+	// its stream; false when it could not be run
+	bool StartEncoder(int width, int height, uintptr_t clientSocket, const std::string& clientAddress,
+		int videoPort);
+	// hand a picture to FFmpeg, falling back to x264 once when the
+	// hardware encoder took no more; false when none did
+	bool EncodePicture(const PENDING_FRAME& frame, uintptr_t clientSocket, const std::string& clientAddress,
+		int videoPort);
+	// close the input of FFmpeg and wait for it to end
+	void StopEncoder();
+	// drop the client, so another may connect
+	void CloseClient();
+};
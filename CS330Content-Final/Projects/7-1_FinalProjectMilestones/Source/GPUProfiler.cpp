@@ -0,0 +1,373 @@
+///////////////////////////////////////////////////////////////////////////////
+// gpuprofiler.cpp
+// ============
+// GPU and CPU time of each render pass of a frame
+//
+//  A timestamp query is written where a pass begins and ends on the
+//  GPU, and the CPU time of the calls issuing it is taken alongside.
+//  The queries of a frame are read a few frames later, once the GPU
+//  finished them, so the timing never waits for the GPU. Timestamps
+//  leave the elapsed time query of the whole frame in RenderTarget
+//  undisturbed, which a nested GL_TIME_ELAPSED query would not.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "GPUProfiler.h"
+#include "ScopeProfiler.h"
+
+#include "GLFW/glfw3.h"
+
+namespace
+{
+	// weight of the newest frame in the smoothed times
+	const float TIME_SMOOTHING = 0.1f;
+
+	const char* const PASS_NAMES[GPUProfiler::PASS_COUNT] =
+	{
+		"shadow",
+		"culling",
+		"prepass",
+		"opaque",
+		"query boxes",
+		"transparent",
+		"post"
+	};
+}
+
+/***********************************************************
+ *  GPUProfiler()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+GPUProfiler::GPUProfiler()
+{
+	m_bEnabled = false;
+	for (int i = 0; i < QUERY_SETS; i++)
+	{
+		m_sets[i].usedQueries = 0;
+		m_sets[i].primitivesQuery = 0;
+		m_sets[i].frameBeginQuery = -1;
+		m_sets[i].frameEndQuery = -1;
+		m_sets[i].bPending = false;
+		m_sets[i].beginNanoseconds = 0;
+	}
+	m_currentSet = -1;
+	m_nextSet = 0;
+	for (int pass = 0; pass < PASS_COUNT; pass++)
+	{
+		m_openRuns[pass] = -1;
+		m_times.gpuMilliseconds[pass] = 0.0f;
+		m_times.cpuMilliseconds[pass] = 0.0f;
+		m_gpuSeconds[pass] = 0.0;
+	}
+	m_times.gpuFrameMilliseconds = 0.0f;
+	m_nextHistory = 0;
+	m_times.primitives = 0;
+	m_framesTimed = 0;
+}
+
+/***********************************************************
+ *  ~GPUProfiler()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+GPUProfiler::~GPUProfiler()
+{
+	DestroyQueries();
+}
+
+/***********************************************************
+ *  GetPassName()
+ *
+ *  This method is used for getting the name of a pass.
+ ***********************************************************/
+const char* GPUProfiler::GetPassName(int pass)
+{
+	if ((pass < 0) || (pass >= PASS_COUNT))
+	{
+		return("unknown");
+	}
+	return(PASS_NAMES[pass]);
+}
+
+/***********************************************************
+ *  GetAverageGPUMilliseconds()
+ *
+ *  This method is used for getting the mean GPU time of a
+ *  pass over every frame read back.
+ ***********************************************************/
+float GPUProfiler::GetAverageGPUMilliseconds(int pass) const
+{
+	if ((pass < 0) || (pass >= PASS_COUNT) || (0 == m_framesTimed))
+	{
+		return(0.0f);
+	}
+	return((float)(m_gpuSeconds[pass] * 1000.0 / (double)m_framesTimed));
+}
+
+/***********************************************************
+ *  SetEnabled()
+ *
+ *  This method is used for starting or stopping the timing.
+ *  Stopping frees the query pools, so a profiler that is
+ *  switched off costs nothing.
+ ***********************************************************/
+void GPUProfiler::SetEnabled(bool bEnable)
+{
+	if ((bEnable == false) && (m_bEnabled == true))
+	{
+		DestroyQueries();
+	}
+	m_bEnabled = bEnable;
+}
+
+/***********************************************************
+ *  DestroyQueries()
+ *
+ *  This method is used for deleting the queries of every
+ *  set, dropping the results still pending.
+ ***********************************************************/
+void GPUProfiler::DestroyQueries()
+{
+	for (int i = 0; i < QUERY_SETS; i++)
+	{
+		QUERY_SET& set = m_sets[i];
+		if (set.queries.empty() == false)
+		{
+			glDeleteQueries((GLsizei)set.queries.size(), &set.queries[0]);
+			set.queries.clear();
+		}
+		if (0 != set.primitivesQuery)
+		{
+			glDeleteQueries(1, &set.primitivesQuery);
+			set.primitivesQuery = 0;
+		}
+		set.usedQueries = 0;
+		set.runs.clear();
+		set.bPending = false;
+	}
+	m_currentSet = -1;
+	for (int pass = 0; pass < PASS_COUNT; pass++)
+	{
+		m_openRuns[pass] = -1;
+	}
+}
+
+/***********************************************************
+ *  WriteTimestamp()
+ *
+ *  This method is used for writing the GPU time into the
+ *  next query of the current set, growing its pool when
+ *  the frame has more passes than any frame before.
+ ***********************************************************/
+int GPUProfiler::WriteTimestamp()
+{
+	QUERY_SET& set = m_sets[m_currentSet];
+	if (set.usedQueries == (int)set.queries.size())
+	{
+		GLuint query = 0;
+		glGenQueries(1, &query);
+		set.queries.push_back(query);
+	}
+
+	glQueryCounter(set.queries[set.usedQueries], GL_TIMESTAMP);
+	return(set.usedQueries++);
+}
+
+/***********************************************************
+ *  ReadSet()
+ *
+ *  This method is used for adding the times of a finished
+ *  set up per pass and blending them into the smoothed
+ *  times, with the CPU times taken in the same frame.
+ ***********************************************************/
+void GPUProfiler::ReadSet(QUERY_SET& set)
+{
+	std::vector<GLuint64> timestamps(set.usedQueries);
+	for (int i = 0; i < set.usedQueries; i++)
+	{
+		glGetQueryObjectui64v(set.queries[i], GL_QUERY_RESULT, &timestamps[i]);
+	}
+
+	double gpuSeconds[PASS_COUNT] = { 0.0 };
+	for (size_t i = 0; i < set.runs.size(); i++)
+	{
+		const PASS_RUN& run = set.runs[i];
+		if ((run.endQuery >= 0) && (timestamps[run.endQuery] > timestamps[run.beginQuery]))
+		{
+			gpuSeconds[run.pass] += (double)(timestamps[run.endQuery] - timestamps[run.beginQuery]) / 1.0e9;
+		}
+	}
+
+	GLuint64 primitives = 0;
+	glGetQueryObjectui64v(set.primitivesQuery, GL_QUERY_RESULT, &primitives);
+
+	float weight = (m_framesTimed == 0) ? 1.0f : TIME_SMOOTHING;
+	for (int pass = 0; pass < PASS_COUNT; pass++)
+	{
+		m_times.gpuMilliseconds[pass] += ((float)(gpuSeconds[pass] * 1000.0) - m_times.gpuMilliseconds[pass]) * weight;
+		m_times.cpuMilliseconds[pass] += (set.cpuMilliseconds[pass] - m_times.cpuMilliseconds[pass]) * weight;
+		m_gpuSeconds[pass] += gpuSeconds[pass];
+	}
+	float frameMilliseconds = (float)((double)(timestamps[set.frameEndQuery] - timestamps[set.frameBeginQuery]) / 1.0e6);
+	m_times.gpuFrameMilliseconds += (frameMilliseconds - m_times.gpuFrameMilliseconds) * weight;
+	m_times.primitives = primitives;
+	m_framesTimed++;
+
+	FRAME_TIMES frame;
+	frame.beginNanoseconds = set.beginNanoseconds;
+	for (int pass = 0; pass < PASS_COUNT; pass++)
+	{
+		frame.gpuMilliseconds[pass] = (float)(gpuSeconds[pass] * 1000.0);
+		frame.cpuMilliseconds[pass] = set.cpuMilliseconds[pass];
+	}
+	frame.gpuFrameMilliseconds = frameMilliseconds;
+	frame.primitives = primitives;
+	if (m_history.size() < HISTORY_FRAMES)
+	{
+		m_history.push_back(frame);
+	}
+	else
+	{
+		m_history[m_nextHistory] = frame;
+		m_nextHistory = (m_nextHistory + 1) % HISTORY_FRAMES;
+	}
+}
+
+/***********************************************************
+ *  GetHistory()
+ *
+ *  This method is used for copying the times of the last
+ *  frames read back, oldest first.
+ ***********************************************************/
+void GPUProfiler::GetHistory(std::vector<FRAME_TIMES>& history) const
+{
+	history.assign(m_history.begin() + m_nextHistory, m_history.end());
+	history.insert(history.end(), m_history.begin(), m_history.begin() + m_nextHistory);
+}
+
+/***********************************************************
+ *  BeginFrame()
+ *
+ *  This method is used for reading the sets of the earlier
+ *  frames that are finished, oldest first, and starting the
+ *  set of this frame. Results are never waited for; the
+ *  end of a frame is its last query, so once it is there
+ *  the frame is finished.
+ ***********************************************************/
+void GPUProfiler::BeginFrame()
+{
+	m_currentSet = -1;
+	if (m_bEnabled == false)
+	{
+		return;
+	}
+
+	for (int i = 0; i < QUERY_SETS; i++)
+	{
+		QUERY_SET& set = m_sets[(m_nextSet + i) % QUERY_SETS];
+		if (set.bPending == false)
+		{
+			continue;
+		}
+
+		GLint available = GL_FALSE;
+		glGetQueryObjectiv(set.queries[set.frameEndQuery], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (available == GL_FALSE)
+		{
+			// the later frames are not finished either
+			break;
+		}
+		ReadSet(set);
+		set.bPending = false;
+	}
+
+	QUERY_SET& set = m_sets[m_nextSet];
+	if (set.bPending == true)
+	{
+		return;
+	}
+
+	m_currentSet = m_nextSet;
+	m_nextSet = (m_nextSet + 1) % QUERY_SETS;
+	set.usedQueries = 0;
+	set.runs.clear();
+	for (int pass = 0; pass < PASS_COUNT; pass++)
+	{
+		set.cpuMilliseconds[pass] = 0.0f;
+		m_openRuns[pass] = -1;
+	}
+	if (0 == set.primitivesQuery)
+	{
+		glGenQueries(1, &set.primitivesQuery);
+	}
+	set.beginNanoseconds = ScopeProfiler::Now();
+	set.frameBeginQuery = WriteTimestamp();
+	glBeginQuery(GL_PRIMITIVES_GENERATED, set.primitivesQuery);
+}
+
+/***********************************************************
+ *  EndFrame()
+ *
+ *  This method is used for closing the set of the frame; a
+ *  pass left open ends with the frame.
+ ***********************************************************/
+void GPUProfiler::EndFrame()
+{
+	if (m_currentSet < 0)
+	{
+		return;
+	}
+
+	for (int pass = 0; pass < PASS_COUNT; pass++)
+	{
+		EndPass(pass);
+	}
+
+	QUERY_SET& set = m_sets[m_currentSet];
+	glEndQuery(GL_PRIMITIVES_GENERATED);
+	set.frameEndQuery = WriteTimestamp();
+	set.bPending = true;
+	m_currentSet = -1;
+}
+
+/***********************************************************
+ *  BeginPass()
+ *
+ *  This method is used for starting a run of a pass.
+ ***********************************************************/
+void GPUProfiler::BeginPass(int pass)
+{
+	if ((m_currentSet < 0) || (pass < 0) || (pass >= PASS_COUNT) || (m_openRuns[pass] >= 0))
+	{
+		return;
+	}
+
+	QUERY_SET& set = m_sets[m_currentSet];
+	PASS_RUN run;
+	run.pass = pass;
+	run.beginQuery = WriteTimestamp();
+	run.endQuery = -1;
+	run.cpuStartSeconds = glfwGetTime();
+	m_openRuns[pass] = (int)set.runs.size();
+	set.runs.push_back(run);
+}
+
+/***********************************************************
+ *  EndPass()
+ *
+ *  This method is used for ending the open run of a pass,
+ *  if it has one.
+ ***********************************************************/
+void GPUProfiler::EndPass(int pass)
+{
+	if ((m_currentSet < 0) || (pass < 0) || (pass >= PASS_COUNT) || (m_openRuns[pass] < 0))
+	{
+		return;
+	}
+
+	QUERY_SET& set = m_sets[m_currentSet];
+	PASS_RUN& run = set.runs[m_openRuns[pass]];
+	run.endQuery = WriteTimestamp();
+	set.cpuMilliseconds[pass] += (float)((glfwGetTime() - run.cpuStartSeconds) * 1000.0);
+	m_openRuns[pass] = -1;
+}
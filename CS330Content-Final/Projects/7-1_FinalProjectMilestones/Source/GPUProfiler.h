@@ -0,0 +1,143 @@
+///////////////////////////////////////////////////////////////////////////////
+// gpuprofiler.h
+// ============
+// GPU and CPU time of each render pass of a frame
+//
+//  A timestamp query is written where a pass begins and ends on the
+//  GPU, and the CPU time of the calls issuing it is taken alongside.
+//  The queries of a frame are read a few frames later, once the GPU
+//  finished them, so the timing never waits for the GPU. Timestamps
+//  leave the elapsed time query of the whole frame in RenderTarget
+//  undisturbed, which a nested GL_TIME_ELAPSED query would not.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+#include <vector>
+
+/***********************************************************
+ *  GPUProfiler
+ *
+ *  This class contains a pool of timestamp queries for each
+ *  frame in flight and the smoothed times of the passes.
+ *  BeginPass() and EndPass() bracket a pass; a pass run
+ *  several times in a frame, as for the extra views, adds
+ *  up its runs.
+ ***********************************************************/
+class GPUProfiler
+{
+public:
+	// constructor
+	GPUProfiler();
+	// destructor
+	~GPUProfiler();
+
+	// render passes timed in a frame
+	enum PROFILED_PASS
+	{
+		PASS_SHADOW = 0,	// shadow maps redrawn
+		PASS_CULLING,		// light clusters, GPU culling and depth pyramid
+		PASS_PREPASS,		// depth pre-pass
+		PASS_OPAQUE,		// opaque draws, with the deferred lighting
+		PASS_QUERY_BOXES,	// occlusion query boxes, inside the opaque pass
+		PASS_TRANSPARENT,	// blended draws and their resolve
+		PASS_POST,			// post effects, stretch to the window and overlay
+		PASS_COUNT
+	};
+
+	// frames whose queries may still be pending; a frame finding
+	// its query set still pending goes untimed
+	static const int QUERY_SETS = 4;
+
+	// times of the passes, in milliseconds, smoothed over frames
+	struct PASS_TIMES
+	{
+		float gpuMilliseconds[PASS_COUNT];
+		float cpuMilliseconds[PASS_COUNT];
+		// GPU time from the start to the end of the frame
+		float gpuFrameMilliseconds;
+		// primitives the frame generated, after the GPU culling
+		unsigned long long primitives;
+	};
+
+	// time the frames from the next one on, or stop and free the
+	// queries
+	void SetEnabled(bool bEnable);
+	bool IsEnabled() const { return(m_bEnabled); }
+
+	// read the query sets of the frames the GPU finished and start
+	// the set of this frame
+	void BeginFrame();
+	void EndFrame();
+	// bracket a pass of the frame
+	void BeginPass(int pass);
+	void EndPass(int pass);
+
+	// frames whose unsmoothed times are kept, for the trace of a
+	// hitch
+	static const int HISTORY_FRAMES = 1024;
+	// times of one frame read back, in milliseconds
+	struct FRAME_TIMES
+	{
+		// when the frame began issuing, in ScopeProfiler::Now() time
+		long long beginNanoseconds;
+		float gpuMilliseconds[PASS_COUNT];
+		float cpuMilliseconds[PASS_COUNT];
+		float gpuFrameMilliseconds;
+		unsigned long long primitives;
+	};
+
+	const PASS_TIMES& GetTimes() const { return(m_times); }
+	// the last frames read back, oldest first
+	void GetHistory(std::vector<FRAME_TIMES>& history) const;
+	// frames read back since the start, and the average GPU time of
+	// each pass over them
+	unsigned long long GetFramesTimed() const { return(m_framesTimed); }
+	float GetAverageGPUMilliseconds(int pass) const;
+	static const char* GetPassName(int pass);
+
+private:
+	// a run of a pass; the queries are indexes into the set pool
+	struct PASS_RUN
+	{
+		int pass;
+		int beginQuery;
+		int endQuery;
+		double cpuStartSeconds;
+	};
+	// queries of one frame
+	struct QUERY_SET
+	{
+		std::vector<GLuint> queries;
+		int usedQueries;
+		std::vector<PASS_RUN> runs;
+		GLuint primitivesQuery;
+		int frameBeginQuery;
+		int frameEndQuery;
+		bool bPending;
+		float cpuMilliseconds[PASS_COUNT];
+		long long beginNanoseconds;
+	};
+
+	bool m_bEnabled;
+	QUERY_SET m_sets[QUERY_SETS];
+	// set of the frame being issued, -1 when it goes untimed
+	int m_currentSet;
+	int m_nextSet;
+	// run of each pass begun and not ended, -1 for none
+	int m_openRuns[PASS_COUNT];
+	PASS_TIMES m_times;
+	unsigned long long m_framesTimed;
+	double m_gpuSeconds[PASS_COUNT];
+	// ring of HISTORY_FRAMES, filled before it wraps
+	std::vector<FRAME_TIMES> m_history;
+	size_t m_nextHistory;
+
+	// write a timestamp into the next query of the current set
+	int WriteTimestamp();
+	// read a finished set into the smoothed times
+	void ReadSet(QUERY_SET& set);
+	void DestroyQueries();
+};
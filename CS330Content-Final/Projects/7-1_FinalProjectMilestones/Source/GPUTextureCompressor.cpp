@@ -0,0 +1,250 @@
+///////////////////////////////////////////////////////////////////////////////
+// gputexturecompressor.cpp
+// ============
+// block compress the textures decoded from image files on the GPU
+//
+//  Every level is encoded by one dispatch into its own range of the
+//  block buffer, and the whole buffer is then read into the levels of
+//  the compressed texture as a pixel unpack buffer, so the blocks are
+//  never read back.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "GPUTextureCompressor.h"
+#include "ShapeMeshes.h"
+#include "MipChain.h"
+#include "GPUMemory.h"
+#include "ScopeProfiler.h"
+#include "Logger.h"
+
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+namespace
+{
+	// work group size declared by the compute shader, in blocks
+	const GLuint COMPRESS_GROUP_SIZE = 8;
+	// storage binding of the blocks
+	const GLuint BLOCKS_BINDING = 0;
+	// texture unit the source is read from, above the units the
+	// scene and its passes sample from
+	const int SOURCE_TEXTURE_UNIT = 31;
+}
+
+/***********************************************************
+ *  GPUTextureCompressor()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+GPUTextureCompressor::GPUTextureCompressor(ShaderManager* pShaderManager)
+{
+	m_pShaderManager = pShaderManager;
+	m_compressProgram = 0;
+	m_sourceLevelLocation = -1;
+	m_levelSizeLocation = -1;
+	m_firstWordLocation = -1;
+	m_alphaBlocksLocation = -1;
+	m_qualityLocation = -1;
+	m_quality = QUALITY_FAST;
+	m_blockBuffer = 0;
+	m_blockCapacity = 0;
+	m_stats.textures = 0;
+	m_stats.levels = 0;
+	m_stats.sourceBytes = 0;
+	m_stats.compressedBytes = 0;
+	m_stats.milliseconds = 0.0;
+}
+
+/***********************************************************
+ *  ~GPUTextureCompressor()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+GPUTextureCompressor::~GPUTextureCompressor()
+{
+	if (0 != m_blockBuffer)
+	{
+		GPUMemory::DeleteBuffers(1, &m_blockBuffer);
+		m_blockBuffer = 0;
+	}
+	if (0 != m_compressProgram)
+	{
+		glDeleteProgram(m_compressProgram);
+		m_compressProgram = 0;
+	}
+	m_pShaderManager = NULL;
+}
+
+/***********************************************************
+ *  Create()
+ *
+ *  This method is used for building the compute program
+ *  encoding the blocks, which needs OpenGL 4.3 for compute
+ *  shaders, direct state access to copy the blocks into a
+ *  texture without binding it, and S3TC for the texture.
+ ***********************************************************/
+bool GPUTextureCompressor::Create(const char* compressShaderPath)
+{
+	if ((NULL == m_pShaderManager) || (GLEW_VERSION_4_3 != GL_TRUE) ||
+		(ShapeMeshes::HasDirectStateAccess() == false) || (GLEW_EXT_texture_compression_s3tc != GL_TRUE))
+	{
+		LOG_WARNING("Texture compression disabled, the context lacks compute shaders, direct state access or S3TC");
+		return(false);
+	}
+
+	m_compressProgram = m_pShaderManager->LoadComputeShader(compressShaderPath);
+	if (0 == m_compressProgram)
+	{
+		LOG_WARNING("Texture compression disabled, its compute shader did not build");
+		return(false);
+	}
+
+	m_sourceLevelLocation = glGetUniformLocation(m_compressProgram, "sourceLevel");
+	m_levelSizeLocation = glGetUniformLocation(m_compressProgram, "levelSize");
+	m_firstWordLocation = glGetUniformLocation(m_compressProgram, "firstWord");
+	m_alphaBlocksLocation = glGetUniformLocation(m_compressProgram, "alphaBlocks");
+	m_qualityLocation = glGetUniformLocation(m_compressProgram, "quality");
+	glProgramUniform1i(m_compressProgram, glGetUniformLocation(m_compressProgram, "sourceTexture"), SOURCE_TEXTURE_UNIT);
+
+	return(true);
+}
+
+/***********************************************************
+ *  IsCompressedFormat()
+ *
+ *  This method is used for checking if a texture format is
+ *  one of the block formats the compressor writes.
+ ***********************************************************/
+bool GPUTextureCompressor::IsCompressedFormat(GLenum internalFormat)
+{
+	return((internalFormat == GL_COMPRESSED_RGB_S3TC_DXT1_EXT) || (internalFormat == GL_COMPRESSED_RGBA_S3TC_DXT5_EXT));
+}
+
+/***********************************************************
+ *  Compress()
+ *
+ *  This method is used for encoding the levels of a texture
+ *  into the block buffer, a dispatch per level, and copying
+ *  them into the levels of a new compressed texture once
+ *  the barrier makes the writes visible to the copy. The
+ *  copy reads the buffer on the GPU, so the source texture
+ *  may be deleted as soon as the commands are issued.
+ ***********************************************************/
+GLuint GPUTextureCompressor::Compress(GLuint texture, bool bAlpha)
+{
+	if ((IsAvailable() == false) || (0 == texture))
+	{
+		return(0);
+	}
+
+	PROFILE_SCOPE("texture compress");
+	long long start = ScopeProfiler::Now();
+
+	GLint width = 0;
+	GLint height = 0;
+	GLint internalFormat = 0;
+	GLint levelCount = 0;
+	glGetTextureLevelParameteriv(texture, 0, GL_TEXTURE_WIDTH, &width);
+	glGetTextureLevelParameteriv(texture, 0, GL_TEXTURE_HEIGHT, &height);
+	glGetTextureLevelParameteriv(texture, 0, GL_TEXTURE_INTERNAL_FORMAT, &internalFormat);
+	glGetTextureParameteriv(texture, GL_TEXTURE_IMMUTABLE_LEVELS, &levelCount);
+	if ((width <= 0) || (height <= 0) || (levelCount <= 0) || (IsCompressedFormat((GLenum)internalFormat) == true))
+	{
+		return(0);
+	}
+
+	// the blocks of each level follow those of the level above
+	const GLuint blockWords = (bAlpha == true) ? 4 : 2;
+	std::vector<GLuint> firstWords(levelCount);
+	GLuint wordCount = 0;
+	for (GLint i = 0; i < levelCount; i++)
+	{
+		int levelWidth = 0;
+		int levelHeight = 0;
+		MipChain::GetLevelSize(width, height, i, levelWidth, levelHeight);
+		firstWords[i] = wordCount;
+		wordCount += (GLuint)((levelWidth + 3) / 4) * (GLuint)((levelHeight + 3) / 4) * blockWords;
+	}
+
+	const GLsizeiptr bytes = (GLsizeiptr)wordCount * sizeof(GLuint);
+	if (bytes > m_blockCapacity)
+	{
+		if (0 != m_blockBuffer)
+		{
+			GPUMemory::DeleteBuffers(1, &m_blockBuffer);
+		}
+		m_blockCapacity = bytes;
+		glCreateBuffers(1, &m_blockBuffer);
+		glNamedBufferData(m_blockBuffer, m_blockCapacity, NULL, GL_DYNAMIC_COPY);
+		GPUMemory::TrackBuffer(m_blockBuffer, m_blockCapacity, GPUMemory::CATEGORY_BUFFER, "texture compression blocks");
+	}
+
+	const GLenum compressedFormat = (bAlpha == true) ? GL_COMPRESSED_RGBA_S3TC_DXT5_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+	GLuint compressed = 0;
+	glCreateTextures(GL_TEXTURE_2D, 1, &compressed);
+	glTextureStorage2D(compressed, levelCount, compressedFormat, width, height);
+	// set the texture wrapping parameters
+	glTextureParameteri(compressed, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTextureParameteri(compressed, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	// set texture filtering parameters
+	glTextureParameteri(compressed, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTextureParameteri(compressed, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+	m_pShaderManager->UseExternalProgram(m_compressProgram);
+	glBindTextureUnit(SOURCE_TEXTURE_UNIT, texture);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, BLOCKS_BINDING, m_blockBuffer);
+	glUniform1i(m_alphaBlocksLocation, (bAlpha == true) ? 1 : 0);
+	glUniform1i(m_qualityLocation, (int)m_quality);
+	for (GLint i = 0; i < levelCount; i++)
+	{
+		int levelWidth = 0;
+		int levelHeight = 0;
+		MipChain::GetLevelSize(width, height, i, levelWidth, levelHeight);
+		const GLuint blocksX = (GLuint)(levelWidth + 3) / 4;
+		const GLuint blocksY = (GLuint)(levelHeight + 3) / 4;
+		glUniform1i(m_sourceLevelLocation, i);
+		glUniform2i(m_levelSizeLocation, levelWidth, levelHeight);
+		glUniform1ui(m_firstWordLocation, firstWords[i]);
+		glDispatchCompute((blocksX + COMPRESS_GROUP_SIZE - 1) / COMPRESS_GROUP_SIZE,
+			(blocksY + COMPRESS_GROUP_SIZE - 1) / COMPRESS_GROUP_SIZE, 1);
+	}
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, BLOCKS_BINDING, 0);
+	glBindTextureUnit(SOURCE_TEXTURE_UNIT, 0);
+	glMemoryBarrier(GL_PIXEL_BUFFER_BARRIER_BIT);
+
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_blockBuffer);
+	for (GLint i = 0; i < levelCount; i++)
+	{
+		int levelWidth = 0;
+		int levelHeight = 0;
+		MipChain::GetLevelSize(width, height, i, levelWidth, levelHeight);
+		const GLuint levelWords = ((i + 1 < levelCount) ? firstWords[i + 1] : wordCount) - firstWords[i];
+		glCompressedTextureSubImage2D(compressed, i, 0, 0, levelWidth, levelHeight, compressedFormat,
+			(GLsizei)(levelWords * sizeof(GLuint)), (const void*)((size_t)firstWords[i] * sizeof(GLuint)));
+	}
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+	GPUMemory::TrackTexture(compressed, compressedFormat, width, height, 1, levelCount, GPUMemory::CATEGORY_TEXTURE, "texture");
+
+	m_stats.textures++;
+	m_stats.levels += (unsigned long long)levelCount;
+	m_stats.sourceBytes += GPUMemory::GetTextureBytes((GLenum)internalFormat, width, height, 1, levelCount);
+	m_stats.compressedBytes += GPUMemory::GetTextureBytes(compressedFormat, width, height, 1, levelCount);
+	m_stats.milliseconds += (double)(ScopeProfiler::Now() - start) / 1000000.0;
+	return(compressed);
+}
+
+/***********************************************************
+ *  Print()
+ *
+ *  This method is used for writing the textures compressed
+ *  and the memory they saved to the console.
+ ***********************************************************/
+void GPUTextureCompressor::Print() const
+{
+	std::cout << "textures compressed on the GPU " << m_stats.textures
+		<< "\tlevels " << m_stats.levels
+		<< "\t" << (double)m_stats.sourceBytes / (1024.0 * 1024.0) << " MB into "
+		<< (double)m_stats.compressedBytes / (1024.0 * 1024.0) << " MB"
+		<< "\tin " << m_stats.milliseconds << " ms\n";
+}
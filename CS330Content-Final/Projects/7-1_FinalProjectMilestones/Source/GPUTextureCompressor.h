@@ -0,0 +1,89 @@
+///////////////////////////////////////////////////////////////////////////////
+// gputexturecompressor.h
+// ============
+// block compress the textures decoded from image files on the GPU
+//
+//  A texture with no KTX2 or DDS file beside its image is decoded and
+//  held as RGBA8, four bytes a texel. Once its levels are uploaded, a
+//  compute pass encodes every level into BC1 blocks, or BC3 with its
+//  alpha, half a byte or a byte a texel, into a buffer that is copied
+//  into a compressed texture without leaving the GPU. The scene then
+//  takes the compressed texture in its place and deletes the other.
+//  The box of the colors is quick; their principal axis, with the
+//  endpoints fitted to the indices, is closer to the offline encoders.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "ShaderManager.h"
+
+#include <GL/glew.h>
+
+/***********************************************************
+ *  GPUTextureCompressor
+ *
+ *  This class contains the compute program encoding the
+ *  blocks and the buffer they are written to, grown to the
+ *  largest texture compressed so far.
+ ***********************************************************/
+class GPUTextureCompressor
+{
+public:
+	// constructor
+	GPUTextureCompressor(ShaderManager* pShaderManager);
+	// destructor
+	~GPUTextureCompressor();
+
+	// how the endpoints of the color blocks are picked
+	enum QUALITY
+	{
+		QUALITY_FAST,		// the box of the colors, inset
+		QUALITY_HIGH		// the principal axis, fitted once
+	};
+
+	// textures compressed since the start
+	struct COMPRESS_STATS
+	{
+		unsigned long long textures;
+		unsigned long long levels;
+		unsigned long long sourceBytes;			// of the textures replaced
+		unsigned long long compressedBytes;
+		double milliseconds;					// issuing the passes
+	};
+
+	// build the compute program; false when the context has no
+	// compute shaders, direct state access or S3TC textures, or the
+	// program fails to build
+	bool Create(const char* compressShaderPath);
+	bool IsAvailable() const { return(0 != m_compressProgram); }
+
+	void SetQuality(QUALITY quality) { m_quality = quality; }
+	QUALITY GetQuality() const { return(m_quality); }
+
+	// true for the formats Compress() writes
+	static bool IsCompressedFormat(GLenum internalFormat);
+
+	// compress every level of a texture with immutable storage into
+	// a new BC1 texture, BC3 when bAlpha is true; 0 when it cannot,
+	// with the texture left as it is. The caller may delete the
+	// texture as soon as this returns
+	GLuint Compress(GLuint texture, bool bAlpha);
+
+	const COMPRESS_STATS& GetStats() const { return(m_stats); }
+	void Print() const;
+
+private:
+	// pointer to shader manager object
+	ShaderManager* m_pShaderManager;
+	GLuint m_compressProgram;
+	GLint m_sourceLevelLocation;
+	GLint m_levelSizeLocation;
+	GLint m_firstWordLocation;
+	GLint m_alphaBlocksLocation;
+	GLint m_qualityLocation;
+	QUALITY m_quality;
+	// blocks of every level of the texture being compressed
+	GLuint m_blockBuffer;
+	GLsizeiptr m_blockCapacity;
+	COMPRESS_STATS m_stats;
+};
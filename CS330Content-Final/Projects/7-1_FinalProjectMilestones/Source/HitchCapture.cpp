@@ -0,0 +1,388 @@
+///////////////////////////////////////////////////////////////////////////////
+// hitchcapture.cpp
+// ============
+// the trace of the last seconds written out when a frame runs over budget
+//
+//  Hitches in the field rarely show up again on a developer's
+//  machine, so the profilers run all the time: the scope profiler
+//  keeps the newest scopes of every thread in its rings and the GPU
+//  profiler the pass times of the last frames read back. When the
+//  interval between two presents goes over the budget, the render
+//  counters and the recorded draw commands of that frame are copied
+//  at once, and a few frames later, once the GPU times of the frame
+//  are read back, the scopes of the seconds before it are copied too
+//  and the capture is written out on a thread of its own: a Chrome
+//  trace with the GPU times as counter tracks, the frame stats and
+//  the command stream. Captures are at least a minimum time apart and
+//  limited in number, so a run of hitches costs one capture.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "HitchCapture.h"
+#include "SceneManager.h"
+#include "Logger.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+namespace
+{
+	// the GPU times of a frame are read back this many frames after
+	// it, so the capture waits as long for them
+	const int GPU_READBACK_FRAMES = GPUProfiler::QUERY_SETS + 1;
+
+	bool MakeDirectory(const std::string& directory)
+	{
+#ifdef _WIN32
+		int result = _mkdir(directory.c_str());
+#else
+		int result = mkdir(directory.c_str(), 0755);
+#endif
+		return((result == 0) || (errno == EEXIST));
+	}
+}
+
+/***********************************************************
+ *  HitchCapture()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+HitchCapture::HitchCapture(GPUProfiler* pGPUProfiler, RenderCounters* pRenderCounters, SceneManager* pSceneManager)
+{
+	m_pGPUProfiler = pGPUProfiler;
+	m_pRenderCounters = pRenderCounters;
+	m_pSceneManager = pSceneManager;
+	m_budgetMilliseconds = 0.0;
+	m_windowNanoseconds = 0;
+	m_minNanoseconds = 0;
+	m_maxCaptures = 0;
+	m_captures = 0;
+	m_nextFrame = 0;
+	m_lastPresentNanoseconds = -1;
+	m_lastTriggerNanoseconds = -1;
+	m_pPending = NULL;
+	m_pendingFrames = 0;
+	for (int pass = 0; pass < GPUProfiler::PASS_COUNT; pass++)
+	{
+		m_passTrackNames.push_back(std::string("GPU ") + GPUProfiler::GetPassName(pass) + " ms");
+	}
+}
+
+/***********************************************************
+ *  ~HitchCapture()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+HitchCapture::~HitchCapture()
+{
+	Finish();
+	if (NULL != m_pPending)
+	{
+		delete m_pPending;
+		m_pPending = NULL;
+	}
+}
+
+/***********************************************************
+ *  Start()
+ *
+ *  This method is used for taking the settings, making the
+ *  directory and switching on the scope profiler, whose
+ *  rings are the window of the CPU scopes.
+ ***********************************************************/
+bool HitchCapture::Start(const char* directory, double budgetMilliseconds, double windowSeconds,
+	double minSeconds, int maxCaptures)
+{
+	if (MakeDirectory(directory) == false)
+	{
+		LOG_ERROR("Could not make the hitch capture directory %s", directory);
+		return(false);
+	}
+	m_directory = directory;
+	m_budgetMilliseconds = budgetMilliseconds;
+	m_windowNanoseconds = (long long)(windowSeconds * 1.0e9);
+	m_minNanoseconds = (long long)(minSeconds * 1.0e9);
+	m_maxCaptures = maxCaptures;
+	m_frames.reserve(FRAME_WINDOW);
+	ScopeProfiler::SetEnabled(true);
+	LOG_INFO("Capturing frames over %.2f ms into %s", budgetMilliseconds, directory);
+	return(true);
+}
+
+/***********************************************************
+ *  EndFrame()
+ *
+ *  This method is used for adding the frame to the window,
+ *  completing the capture waiting once the GPU times of its
+ *  frame are in, and starting a capture for a frame over
+ *  the budget when none is pending, the last one is long
+ *  enough ago and the limit is not reached.
+ ***********************************************************/
+void HitchCapture::EndFrame(double cpuSeconds)
+{
+	if (IsStarted() == false)
+	{
+		return;
+	}
+
+	long long now = ScopeProfiler::Now();
+	FRAME_RECORD frame;
+	frame.presentNanoseconds = now;
+	frame.intervalMilliseconds = (m_lastPresentNanoseconds >= 0) ?
+		(float)((double)(now - m_lastPresentNanoseconds) / 1.0e6) : 0.0f;
+	frame.cpuMilliseconds = (float)(cpuSeconds * 1000.0);
+	bool bHasInterval = (m_lastPresentNanoseconds >= 0);
+	m_lastPresentNanoseconds = now;
+	if (m_frames.size() < FRAME_WINDOW)
+	{
+		m_frames.push_back(frame);
+	}
+	else
+	{
+		m_frames[m_nextFrame] = frame;
+		m_nextFrame = (m_nextFrame + 1) % FRAME_WINDOW;
+	}
+
+	if (NULL != m_pPending)
+	{
+		m_pendingFrames--;
+		if (m_pendingFrames <= 0)
+		{
+			Complete();
+		}
+		return;
+	}
+
+	if ((bHasInterval == true) && (frame.intervalMilliseconds > m_budgetMilliseconds) &&
+		(m_captures < m_maxCaptures) &&
+		((m_lastTriggerNanoseconds < 0) || ((now - m_lastTriggerNanoseconds) >= m_minNanoseconds)))
+	{
+		Trigger(now, frame);
+	}
+}
+
+/***********************************************************
+ *  ResetInterval()
+ *
+ *  This method is used for starting the intervals over
+ *  after a pause in which no frames were presented.
+ ***********************************************************/
+void HitchCapture::ResetInterval()
+{
+	m_lastPresentNanoseconds = -1;
+}
+
+/***********************************************************
+ *  Trigger()
+ *
+ *  This method is used for copying what only lasts until
+ *  the next frame: the counters and the recorded commands
+ *  of the frame over budget.
+ ***********************************************************/
+void HitchCapture::Trigger(long long presentNanoseconds, const FRAME_RECORD& frame)
+{
+	CAPTURE* pCapture = new CAPTURE();
+	pCapture->index = m_captures;
+	pCapture->triggerNanoseconds = presentNanoseconds;
+	pCapture->intervalMilliseconds = frame.intervalMilliseconds;
+	pCapture->cpuMilliseconds = frame.cpuMilliseconds;
+	for (int counter = 0; counter < RenderCounters::COUNTER_COUNT; counter++)
+	{
+		pCapture->counters[counter] = m_pRenderCounters->GetLast(counter);
+	}
+	const CommandBuffer* pBuffers = m_pSceneManager->GetCommandBuffers();
+	for (size_t i = 0; i < m_pSceneManager->GetCommandBufferCount(); i++)
+	{
+		pCapture->commands.push_back(pBuffers[i].GetCommands());
+	}
+
+	m_pPending = pCapture;
+	m_pendingFrames = GPU_READBACK_FRAMES;
+	m_lastTriggerNanoseconds = presentNanoseconds;
+	m_captures++;
+}
+
+/***********************************************************
+ *  Complete()
+ *
+ *  This method is used for copying the windows of the frame
+ *  intervals, the GPU times and the CPU scopes, now holding
+ *  the frame over budget and the few after it, and writing
+ *  the capture on the write thread.
+ ***********************************************************/
+void HitchCapture::Complete()
+{
+	CAPTURE* pCapture = m_pPending;
+	m_pPending = NULL;
+
+	long long since = pCapture->triggerNanoseconds - m_windowNanoseconds;
+	for (size_t i = 0; i < m_frames.size(); i++)
+	{
+		const FRAME_RECORD& frame = m_frames[(m_nextFrame + i) % m_frames.size()];
+		if (frame.presentNanoseconds >= since)
+		{
+			pCapture->frames.push_back(frame);
+		}
+	}
+	std::vector<GPUProfiler::FRAME_TIMES> gpuFrames;
+	m_pGPUProfiler->GetHistory(gpuFrames);
+	for (size_t i = 0; i < gpuFrames.size(); i++)
+	{
+		if (gpuFrames[i].beginNanoseconds >= since)
+		{
+			pCapture->gpuFrames.push_back(gpuFrames[i]);
+		}
+	}
+	ScopeProfiler::CopyEvents(since, pCapture->threads);
+
+	// the last capture is long written, as they are far apart
+	Finish();
+	m_writeThread = std::thread(&HitchCapture::WriteCapture, this, pCapture);
+}
+
+/***********************************************************
+ *  Finish()
+ *
+ *  This method is used for waiting until the capture being
+ *  written is on disk.
+ ***********************************************************/
+void HitchCapture::Finish()
+{
+	if (m_writeThread.joinable() == true)
+	{
+		m_writeThread.join();
+	}
+}
+
+/***********************************************************
+ *  WriteCapture()
+ *
+ *  This method is used for writing a capture as three files
+ *  of the directory: hitch_<n>_trace.json, the scopes with
+ *  the frame and GPU times as counter tracks; hitch_<n>.txt,
+ *  the counters of the frame and the times of every frame
+ *  in the window; and hitch_<n>_commands.txt, the commands
+ *  the frame recorded. The frame over budget is the one
+ *  presented at 0 ms.
+ ***********************************************************/
+void HitchCapture::WriteCapture(CAPTURE* pCapture)
+{
+	ScopeProfiler::SetThreadName("hitch capture");
+	char path[1024];
+
+	std::vector<ScopeProfiler::COUNTER_EVENT> counters;
+	for (size_t i = 0; i < pCapture->frames.size(); i++)
+	{
+		const FRAME_RECORD& frame = pCapture->frames[i];
+		ScopeProfiler::COUNTER_EVENT event;
+		event.nanoseconds = frame.presentNanoseconds;
+		event.name = "frame interval ms";
+		event.value = frame.intervalMilliseconds;
+		counters.push_back(event);
+		event.name = "CPU frame ms";
+		event.value = frame.cpuMilliseconds;
+		counters.push_back(event);
+	}
+	for (size_t i = 0; i < pCapture->gpuFrames.size(); i++)
+	{
+		const GPUProfiler::FRAME_TIMES& gpuFrame = pCapture->gpuFrames[i];
+		ScopeProfiler::COUNTER_EVENT event;
+		event.nanoseconds = gpuFrame.beginNanoseconds;
+		event.name = "GPU frame ms";
+		event.value = gpuFrame.gpuFrameMilliseconds;
+		counters.push_back(event);
+		for (int pass = 0; pass < GPUProfiler::PASS_COUNT; pass++)
+		{
+			event.name = m_passTrackNames[pass].c_str();
+			event.value = gpuFrame.gpuMilliseconds[pass];
+			counters.push_back(event);
+		}
+	}
+	snprintf(path, sizeof(path), "%s/hitch_%03d_trace.json", m_directory.c_str(), pCapture->index);
+	bool bWritten = ScopeProfiler::WriteChromeTrace(path, pCapture->threads, counters);
+
+	snprintf(path, sizeof(path), "%s/hitch_%03d.txt", m_directory.c_str(), pCapture->index);
+	FILE* file = fopen(path, "w");
+	if (file != NULL)
+	{
+		fprintf(file, "frame interval %.3f ms\tbudget %.3f ms\tCPU %.3f ms\tat %.6f s\n",
+			pCapture->intervalMilliseconds, m_budgetMilliseconds, pCapture->cpuMilliseconds,
+			(double)pCapture->triggerNanoseconds / 1.0e9);
+		fprintf(file, "\ncounters of the frame\n");
+		for (int counter = 0; counter < RenderCounters::COUNTER_COUNT; counter++)
+		{
+			fprintf(file, "%-20s %llu\n", RenderCounters::GetCounterName(counter), pCapture->counters[counter]);
+		}
+		fprintf(file, "\nframes, from the frame over budget\npresent ms\tinterval ms\tCPU ms\n");
+		for (size_t i = 0; i < pCapture->frames.size(); i++)
+		{
+			const FRAME_RECORD& frame = pCapture->frames[i];
+			fprintf(file, "%.3f\t%.3f\t%.3f\n",
+				(double)(frame.presentNanoseconds - pCapture->triggerNanoseconds) / 1.0e6,
+				frame.intervalMilliseconds, frame.cpuMilliseconds);
+		}
+		fprintf(file, "\nGPU times, from the frame over budget\nbegin ms\tframe ms");
+		for (int pass = 0; pass < GPUProfiler::PASS_COUNT; pass++)
+		{
+			fprintf(file, "\t%s ms", GPUProfiler::GetPassName(pass));
+		}
+		fprintf(file, "\tprimitives\n");
+		for (size_t i = 0; i < pCapture->gpuFrames.size(); i++)
+		{
+			const GPUProfiler::FRAME_TIMES& gpuFrame = pCapture->gpuFrames[i];
+			fprintf(file, "%.3f\t%.3f", (double)(gpuFrame.beginNanoseconds - pCapture->triggerNanoseconds) / 1.0e6,
+				gpuFrame.gpuFrameMilliseconds);
+			for (int pass = 0; pass < GPUProfiler::PASS_COUNT; pass++)
+			{
+				fprintf(file, "\t%.3f", gpuFrame.gpuMilliseconds[pass]);
+			}
+			fprintf(file, "\t%llu\n", gpuFrame.primitives);
+		}
+		bWritten = (ferror(file) == 0) && (bWritten == true);
+		fclose(file);
+	}
+	else
+	{
+		bWritten = false;
+	}
+
+	snprintf(path, sizeof(path), "%s/hitch_%03d_commands.txt", m_directory.c_str(), pCapture->index);
+	file = fopen(path, "w");
+	if (file != NULL)
+	{
+		fprintf(file, "buffer\tcommand\ttype\targs\n");
+		for (size_t buffer = 0; buffer < pCapture->commands.size(); buffer++)
+		{
+			const std::vector<CommandBuffer::COMMAND>& commands = pCapture->commands[buffer];
+			for (size_t i = 0; i < commands.size(); i++)
+			{
+				fprintf(file, "%zu\t%zu\t%s\t%u %u %u\n", buffer, i, CommandBuffer::GetTypeName((int)commands[i].type),
+					commands[i].args[0], commands[i].args[1], commands[i].args[2]);
+			}
+		}
+		bWritten = (ferror(file) == 0) && (bWritten == true);
+		fclose(file);
+	}
+	else
+	{
+		bWritten = false;
+	}
+
+	snprintf(path, sizeof(path), "%s/hitch_%03d", m_directory.c_str(), pCapture->index);
+	if (bWritten == true)
+	{
+		LOG_WARNING("Hitch of %.2f ms captured as %s", pCapture->intervalMilliseconds, path);
+	}
+	else
+	{
+		LOG_ERROR("Hitch of %.2f ms could not be written fully as %s", pCapture->intervalMilliseconds, path);
+	}
+	delete pCapture;
+}
@@ -0,0 +1,119 @@
+///////////////////////////////////////////////////////////////////////////////
+// hitchcapture.h
+// ============
+// the trace of the last seconds written out when a frame runs over budget
+//
+//  Hitches in the field rarely show up again on a developer's
+//  machine, so the profilers run all the time: the scope profiler
+//  keeps the newest scopes of every thread in its rings and the GPU
+//  profiler the pass times of the last frames read back. When the
+//  interval between two presents goes over the budget, the render
+//  counters and the recorded draw commands of that frame are copied
+//  at once, and a few frames later, once the GPU times of the frame
+//  are read back, the scopes of the seconds before it are copied too
+//  and the capture is written out on a thread of its own: a Chrome
+//  trace with the GPU times as counter tracks, the frame stats and
+//  the command stream. Captures are at least a minimum time apart and
+//  limited in number, so a run of hitches costs one capture.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "CommandBuffer.h"
+#include "GPUProfiler.h"
+#include "RenderCounters.h"
+#include "ScopeProfiler.h"
+
+#include <string>
+#include <thread>
+#include <vector>
+
+class SceneManager;
+
+/***********************************************************
+ *  HitchCapture
+ *
+ *  This class contains the window of the last frame
+ *  intervals, the capture being gathered and the thread
+ *  writing the last one. EndFrame() is called after every
+ *  present, on the thread of the GL context.
+ ***********************************************************/
+class HitchCapture
+{
+public:
+	// constructor
+	HitchCapture(GPUProfiler* pGPUProfiler, RenderCounters* pRenderCounters, SceneManager* pSceneManager);
+	// destructor
+	~HitchCapture();
+
+	// frame intervals kept
+	static const size_t FRAME_WINDOW = 1024;
+
+	// capture the frames over budgetMilliseconds into the directory,
+	// with the seconds of the window before them; one capture per
+	// minSeconds at most and maxCaptures in all. The profilers are
+	// switched on from here; false when the directory cannot be made
+	bool Start(const char* directory, double budgetMilliseconds, double windowSeconds,
+		double minSeconds, int maxCaptures);
+	bool IsStarted() const { return(m_directory.empty() == false); }
+
+	// take the frame just presented, with the CPU time it took
+	void EndFrame(double cpuSeconds);
+	// forget the last present, after a wait for events, so the wait
+	// is no hitch
+	void ResetInterval();
+	// wait for the capture being written
+	void Finish();
+	int GetCaptureCount() const { return(m_captures); }
+
+private:
+	// a frame presented
+	struct FRAME_RECORD
+	{
+		long long presentNanoseconds;
+		float intervalMilliseconds;
+		float cpuMilliseconds;
+	};
+	// what a capture writes, gathered on the GL thread
+	struct CAPTURE
+	{
+		int index;
+		long long triggerNanoseconds;
+		float intervalMilliseconds;
+		float cpuMilliseconds;
+		unsigned long long counters[RenderCounters::COUNTER_COUNT];
+		std::vector<std::vector<CommandBuffer::COMMAND> > commands;
+		std::vector<FRAME_RECORD> frames;
+		std::vector<GPUProfiler::FRAME_TIMES> gpuFrames;
+		std::vector<ScopeProfiler::THREAD_EVENTS> threads;
+	};
+
+	GPUProfiler* m_pGPUProfiler;
+	RenderCounters* m_pRenderCounters;
+	SceneManager* m_pSceneManager;
+	std::string m_directory;
+	double m_budgetMilliseconds;
+	long long m_windowNanoseconds;
+	long long m_minNanoseconds;
+	int m_maxCaptures;
+	int m_captures;
+	// ring of FRAME_WINDOW, filled before it wraps
+	std::vector<FRAME_RECORD> m_frames;
+	size_t m_nextFrame;
+	long long m_lastPresentNanoseconds;
+	long long m_lastTriggerNanoseconds;
+	// the capture waiting for the GPU times of its frame, and the
+	// frames left until they are read back
+	CAPTURE* m_pPending;
+	int m_pendingFrames;
+	std::thread m_writeThread;
+	// names of the counter tracks of the GPU passes
+	std::vector<std::string> m_passTrackNames;
+
+	// copy the counters and the commands of the frame over budget
+	void Trigger(long long presentNanoseconds, const FRAME_RECORD& frame);
+	// copy the windows and hand the capture to the write thread
+	void Complete();
+	// write the trace, the stats and the commands of a capture
+	void WriteCapture(CAPTURE* pCapture);
+};
@@ -0,0 +1,512 @@
+///////////////////////////////////////////////////////////////////////////////
+// imagedecoder.cpp
+// ============
+// decode texture image files on worker threads
+//
+//  Reading and decompressing the JPEG and PNG files of the scene is
+//  the slow part of loading its textures and needs no GL context, so
+//  the files are decoded by a pool of worker threads while the GL
+//  thread uploads each image as soon as it is ready. RGB images are
+//  expanded to RGBA on the worker as well, four or sixteen pixels at a
+//  time, since a driver given GL_RGB rows converts them itself on the
+//  thread of the upload. An image whose color channels all agree keeps
+//  a single gray channel instead, with its alpha if it has one.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "ImageDecoder.h"
+#include "MipChain.h"
+#include "TextureCache.h"
+#include "ScopeProfiler.h"
+#include "AssetPack.h"
+#include "SIMDMath.h"
+
+// the implementation is compiled in scenemanager.cpp
+#include "stb_image.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#if SIMD_FLOAT4_SSE2
+#include <tmmintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>	// __cpuid
+#endif
+#endif
+
+std::atomic<unsigned long long> ImageDecoder::s_expandedImages(0);
+std::atomic<unsigned long long> ImageDecoder::s_expandedPixels(0);
+std::atomic<unsigned long long> ImageDecoder::s_expandNanoseconds(0);
+std::atomic<unsigned long long> ImageDecoder::s_grayImages(0);
+int ImageDecoder::s_grayTolerance = ImageDecoder::DEFAULT_GRAY_TOLERANCE;
+
+namespace
+{
+	/***********************************************************
+	 *  ExpandPixels()
+	 *
+	 *  This function is used for writing RGB pixels as RGBA
+	 *  with opaque alpha, a 32 bit word at a time: every three
+	 *  words read hold four pixels, little endian as are the
+	 *  targets of the build.
+	 ***********************************************************/
+	void ExpandPixels(const unsigned char* pRGB, unsigned char* pRGBA, size_t first, size_t pixelCount)
+	{
+		const uint32_t ALPHA = 0xFF000000u;
+		size_t i = first;
+		for (; i + 4 <= pixelCount; i += 4)
+		{
+			uint32_t words[3];
+			memcpy(words, pRGB + i * 3, sizeof(words));
+			const uint32_t pixels[4] =
+			{
+				(words[0] & 0xFFFFFFu) | ALPHA,
+				(words[0] >> 24) | ((words[1] & 0xFFFFu) << 8) | ALPHA,
+				(words[1] >> 16) | ((words[2] & 0xFFu) << 16) | ALPHA,
+				(words[2] >> 8) | ALPHA
+			};
+			memcpy(pRGBA + i * 4, pixels, sizeof(pixels));
+		}
+		for (; i < pixelCount; i++)
+		{
+			pRGBA[i * 4 + 0] = pRGB[i * 3 + 0];
+			pRGBA[i * 4 + 1] = pRGB[i * 3 + 1];
+			pRGBA[i * 4 + 2] = pRGB[i * 3 + 2];
+			pRGBA[i * 4 + 3] = 255;
+		}
+	}
+
+#if SIMD_FLOAT4_SSE2
+	/***********************************************************
+	 *  DetectSSSE3()
+	 *
+	 *  This function is used for checking the processor has
+	 *  SSSE3 for its byte shuffle, which SSE2 builds may not
+	 *  assume.
+	 ***********************************************************/
+	bool DetectSSSE3()
+	{
+#if defined(_MSC_VER)
+		int info[4];
+		__cpuid(info, 1);
+		const int SSSE3_BIT = 1 << 9;
+		return((info[2] & SSSE3_BIT) != 0);
+#elif defined(__GNUC__)
+		return(__builtin_cpu_supports("ssse3") != 0);
+#else
+		return(false);
+#endif
+	}
+
+	/***********************************************************
+	 *  ExpandPixelsSSSE3()
+	 *
+	 *  This function is used for expanding four pixels per
+	 *  shuffle. Each load reads 16 bytes for the 12 of its
+	 *  pixels, so the last pixels are left to the word loop.
+	 ***********************************************************/
+#if defined(__GNUC__) && !defined(__SSSE3__)
+	__attribute__((target("ssse3")))
+#endif
+	size_t ExpandPixelsSSSE3(const unsigned char* pRGB, unsigned char* pRGBA, size_t pixelCount)
+	{
+		const __m128i shuffle = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+		const __m128i alpha = _mm_set1_epi32((int)0xFF000000u);
+		size_t i = 0;
+		for (; i + 6 <= pixelCount; i += 4)
+		{
+			__m128i rgb = _mm_loadu_si128((const __m128i*)(pRGB + i * 3));
+			_mm_storeu_si128((__m128i*)(pRGBA + i * 4), _mm_or_si128(_mm_shuffle_epi8(rgb, shuffle), alpha));
+		}
+		return(i);
+	}
+#endif
+
+	/***********************************************************
+	 *  ExpandRGB()
+	 *
+	 *  This function is used for expanding RGB pixels to RGBA
+	 *  with the widest instructions the processor has.
+	 ***********************************************************/
+	void ExpandRGB(const unsigned char* pRGB, unsigned char* pRGBA, size_t pixelCount)
+	{
+		size_t first = 0;
+#if SIMD_FLOAT4_SSE2
+		static const bool bSSSE3 = DetectSSSE3();
+		if (true == bSSSE3)
+		{
+			first = ExpandPixelsSSSE3(pRGB, pRGBA, pixelCount);
+		}
+#elif SIMD_FLOAT4_NEON
+		// the three planes are split and the four interleaved again
+		for (; first + 16 <= pixelCount; first += 16)
+		{
+			uint8x16x3_t rgb = vld3q_u8(pRGB + first * 3);
+			uint8x16x4_t rgba;
+			rgba.val[0] = rgb.val[0];
+			rgba.val[1] = rgb.val[1];
+			rgba.val[2] = rgb.val[2];
+			rgba.val[3] = vdupq_n_u8(255);
+			vst4q_u8(pRGBA + first * 4, rgba);
+		}
+#endif
+		ExpandPixels(pRGB, pRGBA, first, pixelCount);
+	}
+}
+
+/***********************************************************
+ *  ImageDecoder()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+ImageDecoder::ImageDecoder()
+	: m_nextFile(0)
+{
+	m_pCache = NULL;
+	m_takenCount = 0;
+}
+
+/***********************************************************
+ *  ~ImageDecoder()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+ImageDecoder::~ImageDecoder()
+{
+	Finish();
+}
+
+/***********************************************************
+ *  Decode()
+ *
+ *  This method is used for decoding an image file on the
+ *  calling thread, from its view in the asset pack when the
+ *  pack holds it. The vertical flip is set for the calling
+ *  thread only, so decodes on other threads are not
+ *  affected by it.
+ ***********************************************************/
+bool ImageDecoder::Decode(const char* filename, IMAGE& image, bool bFlipVertically)
+{
+	PROFILE_SCOPE("texture decode");
+	stbi_set_flip_vertically_on_load_thread(bFlipVertically ? 1 : 0);
+
+	image.width = 0;
+	image.height = 0;
+	image.colorChannels = 0;
+	image.levelCount = 1;
+	AssetPack::ASSET_VIEW view;
+	if (AssetPack::Find(filename, view) == true)
+	{
+		image.pixels = stbi_load_from_memory(
+			view.pData,
+			(int)view.size,
+			&image.width,
+			&image.height,
+			&image.colorChannels,
+			0);
+	}
+	else
+	{
+		image.pixels = stbi_load(
+			filename,
+			&image.width,
+			&image.height,
+			&image.colorChannels,
+			0);
+	}
+	image.fileChannels = image.colorChannels;
+	if (NULL == image.pixels)
+	{
+		return(false);
+	}
+
+	bool bGray = (image.colorChannels >= 3) && (ReduceToGray(image) == true);
+	if ((bGray == false) && (image.colorChannels == 3))
+	{
+		ExpandToRGBA(image);
+	}
+	MipChain::Generate(image);
+	return(true);
+}
+
+/***********************************************************
+ *  ReduceToGray()
+ *
+ *  This method is used for rewriting the pixels of an RGB
+ *  or RGBA image as gray, or gray and alpha, in place, when
+ *  no pixel differs between its color channels by more than
+ *  the tolerance. The scan stops at the first pixel in
+ *  color, which for a color image is almost at once.
+ ***********************************************************/
+bool ImageDecoder::ReduceToGray(IMAGE& image)
+{
+	if (s_grayTolerance < 0)
+	{
+		return(false);
+	}
+	PROFILE_SCOPE("texture reduce gray");
+	long long start = ScopeProfiler::Now();
+
+	const size_t pixelCount = (size_t)image.width * image.height;
+	const int channels = image.colorChannels;
+	const unsigned char* pPixel = image.pixels;
+	for (size_t i = 0; i < pixelCount; i++, pPixel += channels)
+	{
+		const int low = std::min(std::min(pPixel[0], pPixel[1]), pPixel[2]);
+		const int high = std::max(std::max(pPixel[0], pPixel[1]), pPixel[2]);
+		if (high - low > s_grayTolerance)
+		{
+			s_expandNanoseconds.fetch_add((unsigned long long)(ScopeProfiler::Now() - start), std::memory_order_relaxed);
+			return(false);
+		}
+	}
+
+	// each pixel is written no further on than it was read from
+	const int grayChannels = (channels == 4) ? 2 : 1;
+	unsigned char* pGray = image.pixels;
+	pPixel = image.pixels;
+	for (size_t i = 0; i < pixelCount; i++, pPixel += channels, pGray += grayChannels)
+	{
+		const int gray = (pPixel[0] + 2 * pPixel[1] + pPixel[2] + 2) / 4;
+		const unsigned char alpha = (channels == 4) ? pPixel[3] : 255;
+		pGray[0] = (unsigned char)gray;
+		if (grayChannels == 2)
+		{
+			pGray[1] = alpha;
+		}
+	}
+	image.colorChannels = grayChannels;
+
+	s_grayImages.fetch_add(1, std::memory_order_relaxed);
+	s_expandNanoseconds.fetch_add((unsigned long long)(ScopeProfiler::Now() - start), std::memory_order_relaxed);
+	return(true);
+}
+
+/***********************************************************
+ *  ExpandToRGBA()
+ *
+ *  This method is used for replacing the pixels of an RGB
+ *  image by RGBA ones with opaque alpha, so the rows are
+ *  uploaded as they are, 4 byte aligned at any width. The
+ *  buffer is allocated as stb_image does, so Free() frees
+ *  either.
+ ***********************************************************/
+void ImageDecoder::ExpandToRGBA(IMAGE& image)
+{
+	PROFILE_SCOPE("texture expand rgb");
+	long long start = ScopeProfiler::Now();
+
+	const size_t pixelCount = (size_t)image.width * image.height;
+	unsigned char* pRGBA = (unsigned char*)malloc(pixelCount * 4);
+	if (NULL == pRGBA)
+	{
+		return;
+	}
+	ExpandRGB(image.pixels, pRGBA, pixelCount);
+	stbi_image_free(image.pixels);
+	image.pixels = pRGBA;
+	image.colorChannels = 4;
+
+	s_expandedImages.fetch_add(1, std::memory_order_relaxed);
+	s_expandedPixels.fetch_add(pixelCount, std::memory_order_relaxed);
+	s_expandNanoseconds.fetch_add((unsigned long long)(ScopeProfiler::Now() - start), std::memory_order_relaxed);
+}
+
+/***********************************************************
+ *  GetExpandStats()
+ *
+ *  This method is used for getting the RGB images expanded
+ *  to RGBA and the images reduced to gray since the launch,
+ *  and the time it took.
+ ***********************************************************/
+ImageDecoder::EXPAND_STATS ImageDecoder::GetExpandStats()
+{
+	EXPAND_STATS stats;
+	stats.images = s_expandedImages.load(std::memory_order_relaxed);
+	stats.pixels = s_expandedPixels.load(std::memory_order_relaxed);
+	stats.grayImages = s_grayImages.load(std::memory_order_relaxed);
+	stats.milliseconds = (double)s_expandNanoseconds.load(std::memory_order_relaxed) / 1000000.0;
+	return(stats);
+}
+
+/***********************************************************
+ *  ReadInfo()
+ *
+ *  This method is used for reading the size and channels of
+ *  an image from the header of its file, without decoding
+ *  the pixels.
+ ***********************************************************/
+bool ImageDecoder::ReadInfo(const char* filename, int& width, int& height, int& colorChannels)
+{
+	width = 0;
+	height = 0;
+	colorChannels = 0;
+	AssetPack::ASSET_VIEW view;
+	if (AssetPack::Find(filename, view) == true)
+	{
+		return(stbi_info_from_memory(view.pData, (int)view.size, &width, &height, &colorChannels) != 0);
+	}
+	return(stbi_info(filename, &width, &height, &colorChannels) != 0);
+}
+
+/***********************************************************
+ *  Free()
+ *
+ *  This method is used for freeing the pixels of a decoded
+ *  image.
+ ***********************************************************/
+void ImageDecoder::Free(IMAGE& image)
+{
+	if (NULL != image.pixels)
+	{
+		stbi_image_free(image.pixels);
+		image.pixels = NULL;
+	}
+}
+
+/***********************************************************
+ *  Start()
+ *
+ *  This method is used for starting a worker thread per
+ *  hardware thread, at most one per file. The workers take
+ *  the files in order, so the first listed are ready first.
+ ***********************************************************/
+void ImageDecoder::Start(const std::vector<std::string>& filenames, TextureCache* pCache)
+{
+	Finish();
+
+	m_filenames = filenames;
+	m_pCache = pCache;
+	m_images.resize(m_filenames.size());
+	for (size_t i = 0; i < m_images.size(); i++)
+	{
+		m_images[i].pixels = NULL;
+	}
+	m_readyFiles.clear();
+	m_takenCount = 0;
+	m_nextFile = 0;
+
+	size_t workers = std::max((size_t)std::thread::hardware_concurrency(), (size_t)1);
+	workers = std::min(workers, m_filenames.size());
+	for (size_t i = 0; i < workers; i++)
+	{
+		m_workers.push_back(std::thread(&ImageDecoder::DecodeFiles, this));
+	}
+}
+
+/***********************************************************
+ *  DecodeFiles()
+ *
+ *  This method is used for decoding files until none is left
+ *  and handing each image to the GL thread when done.
+ ***********************************************************/
+void ImageDecoder::DecodeFiles()
+{
+	ScopeProfiler::SetThreadName("image decoder");
+	int fileIndex = m_nextFile++;
+	while (fileIndex < (int)m_filenames.size())
+	{
+		IMAGE image;
+		Decode(m_filenames[fileIndex].c_str(), image);
+		if ((NULL != m_pCache) && (NULL != image.pixels))
+		{
+			m_pCache->Store(m_filenames[fileIndex], image);
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_images[fileIndex] = image;
+			m_readyFiles.push_back(fileIndex);
+		}
+		m_imageReady.notify_one();
+
+		fileIndex = m_nextFile++;
+	}
+}
+
+/***********************************************************
+ *  WaitForNext()
+ *
+ *  This method is used for taking the next image a worker
+ *  thread finished, waiting for one when none is ready.
+ ***********************************************************/
+bool ImageDecoder::WaitForNext(int& fileIndex, IMAGE& image)
+{
+	if (IsDone() == true)
+	{
+		return(false);
+	}
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_imageReady.wait(lock, [this]() { return(m_readyFiles.empty() == false); });
+
+	TakeFront(fileIndex, image);
+	return(true);
+}
+
+/***********************************************************
+ *  TakeReady()
+ *
+ *  This method is used for taking the next image a worker
+ *  thread finished, if there is one, so a frame never waits
+ *  for a decode.
+ ***********************************************************/
+bool ImageDecoder::TakeReady(int& fileIndex, IMAGE& image)
+{
+	if (IsDone() == true)
+	{
+		return(false);
+	}
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (m_readyFiles.empty() == true)
+	{
+		return(false);
+	}
+
+	TakeFront(fileIndex, image);
+	return(true);
+}
+
+/***********************************************************
+ *  TakeFront()
+ *
+ *  This method is used for handing the oldest ready image to
+ *  the caller, with m_mutex locked.
+ ***********************************************************/
+void ImageDecoder::TakeFront(int& fileIndex, IMAGE& image)
+{
+	fileIndex = m_readyFiles.front();
+	m_readyFiles.erase(m_readyFiles.begin());
+	image = m_images[fileIndex];
+	m_images[fileIndex].pixels = NULL;
+	m_takenCount++;
+}
+
+/***********************************************************
+ *  Finish()
+ *
+ *  This method is used for joining the worker threads and
+ *  freeing the images the GL thread did not take.
+ ***********************************************************/
+void ImageDecoder::Finish()
+{
+	// no more files are handed out, the workers stop after the
+	// file they are decoding
+	m_nextFile = (int)m_filenames.size();
+	for (size_t i = 0; i < m_workers.size(); i++)
+	{
+		m_workers[i].join();
+	}
+	m_workers.clear();
+
+	for (size_t i = 0; i < m_images.size(); i++)
+	{
+		Free(m_images[i]);
+	}
+	m_images.clear();
+	m_readyFiles.clear();
+	m_filenames.clear();
+	m_pCache = NULL;
+	m_takenCount = 0;
+}
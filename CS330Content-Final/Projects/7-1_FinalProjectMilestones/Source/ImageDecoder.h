@@ -0,0 +1,134 @@
+///////////////////////////////////////////////////////////////////////////////
+// imagedecoder.h
+// ============
+// decode texture image files on worker threads
+//
+//  Reading and decompressing the JPEG and PNG files of the scene is
+//  the slow part of loading its textures and needs no GL context, so
+//  the files are decoded by a pool of worker threads while the GL
+//  thread uploads each image as soon as it is ready. RGB images are
+//  expanded to RGBA on the worker as well, four or sixteen pixels at a
+//  time, since a driver given GL_RGB rows converts them itself on the
+//  thread of the upload. An image whose color channels all agree, such
+//  as a roughness map or a gray photo saved as RGB, keeps a single gray
+//  channel instead, with its alpha if it has one.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class TextureCache;
+
+/***********************************************************
+ *  ImageDecoder
+ *
+ *  This class contains the worker threads decoding a list of
+ *  image files and the images they finished that have not
+ *  been taken by the GL thread yet.
+ ***********************************************************/
+class ImageDecoder
+{
+public:
+	// constructor
+	ImageDecoder();
+	// destructor
+	~ImageDecoder();
+
+	// pixels of a decoded image, flipped vertically for GL; pixels
+	// is NULL when the file could not be decoded
+	struct IMAGE
+	{
+		unsigned char* pixels;
+		int width;
+		int height;
+		int colorChannels;		// of the pixels, 4 for an expanded RGB file
+		int fileChannels;		// of the file; 2 and 4 have alpha
+		int levelCount;			// mip levels the pixels hold, largest first
+	};
+
+	// RGB images expanded to RGBA, and color images reduced to gray,
+	// since the launch
+	struct EXPAND_STATS
+	{
+		unsigned long long images;
+		unsigned long long pixels;
+		unsigned long long grayImages;
+		double milliseconds;	// summed over the threads, both kinds
+	};
+
+	// largest difference between the color channels of any pixel of
+	// an image that is reduced to gray
+	static const int DEFAULT_GRAY_TOLERANCE = 2;
+
+	// decode one file on the calling thread; the rows are bottom up
+	// for GL unless bFlipVertically is false, gray images come out
+	// with one channel, or two with alpha, and RGB files as RGBA
+	// with opaque alpha; the pixels hold the whole mip chain unless
+	// there was no memory for it
+	static bool Decode(const char* filename, IMAGE& image, bool bFlipVertically = true);
+	// read only the size and channels from the header of a file
+	static bool ReadInfo(const char* filename, int& width, int& height, int& colorChannels);
+	// free the pixels of a decoded image
+	static void Free(IMAGE& image);
+
+	// true for the channel counts with an alpha channel
+	static bool HasAlpha(int colorChannels) { return((colorChannels == 2) || (colorChannels == 4)); }
+
+	// set before decoding; negative keeps every image in color
+	static void SetGrayTolerance(int tolerance) { s_grayTolerance = tolerance; }
+	static int GetGrayTolerance() { return(s_grayTolerance); }
+
+	static EXPAND_STATS GetExpandStats();
+
+	// start decoding the files on the worker threads, which write
+	// each image into the cache, if any, before handing it over
+	void Start(const std::vector<std::string>& filenames, TextureCache* pCache = NULL);
+	// wait for the next decoded image, in the order they finish;
+	// false once the image of every file was taken. The caller
+	// owns the image and frees it with Free()
+	bool WaitForNext(int& fileIndex, IMAGE& image);
+	// same as above without waiting; false when no image is ready
+	bool TakeReady(int& fileIndex, IMAGE& image);
+	// true once the image of every file was taken
+	bool IsDone() const { return(m_takenCount >= (int)m_filenames.size()); }
+	// wait for the worker threads and free the images not taken
+	void Finish();
+
+private:
+	static std::atomic<unsigned long long> s_expandedImages;
+	static std::atomic<unsigned long long> s_expandedPixels;
+	static std::atomic<unsigned long long> s_expandNanoseconds;
+	static std::atomic<unsigned long long> s_grayImages;
+	static int s_grayTolerance;
+
+	std::vector<std::string> m_filenames;
+	std::vector<IMAGE> m_images;
+	TextureCache* m_pCache;
+	// next file a worker thread takes
+	std::atomic<int> m_nextFile;
+	// files decoded and not yet taken, guarded by m_mutex
+	std::vector<int> m_readyFiles;
+	int m_takenCount;
+	std::mutex m_mutex;
+	std::condition_variable m_imageReady;
+	std::vector<std::thread> m_workers;
+
+	// replace the RGB pixels of a decoded image by RGBA ones; the
+	// image stays RGB when the memory cannot be had
+	static void ExpandToRGBA(IMAGE& image);
+	// keep only the gray channel, and alpha, of an RGB or RGBA image
+	// whose color channels agree within the tolerance; false when
+	// they do not
+	static bool ReduceToGray(IMAGE& image);
+	// body of a worker thread
+	void DecodeFiles();
+	// hand out the oldest ready image, with m_mutex locked
+	void TakeFront(int& fileIndex, IMAGE& image);
+};
@@ -0,0 +1,179 @@
+///////////////////////////////////////////////////////////////////////////////
+// imagediff.cpp
+// ============
+// compare rendered frames against reference frames within error bounds
+//
+//  A change meant to keep the picture, such as shading in half floats,
+//  is checked by rendering the same camera path with and without it
+//  through --batch-render and comparing the frames pixel by pixel.
+//  The largest and the mean difference of the color channels, in 8 bit
+//  levels, must stay within their bounds for every frame; a handful of
+//  pixels a level or two off is rounding, a mean drifting up is a bug.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "ImageDiff.h"
+#include "ImageDecoder.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+// half float lighting rounds to about a thousandth, which an 8 bit
+// frame shows as a level here and there, and a few where a highlight
+// raises the rounding to a power
+const float ImageDiff::DEFAULT_MAX_ERROR = 8.0f;
+const float ImageDiff::DEFAULT_MEAN_ERROR = 0.5f;
+
+namespace
+{
+	// name of a batch render frame, as --batch-render writes it
+	std::string GetFrameName(const char* directory, int frame, const char* frameFormat)
+	{
+		char filename[1024];
+		snprintf(filename, sizeof(filename), "%s/%05d.%s", directory, frame, frameFormat);
+		return(std::string(filename));
+	}
+
+	// channel of a pixel of a decoded image, gray images giving the
+	// same value for every color channel
+	int GetChannel(const ImageDecoder::IMAGE& image, int pixel, int channel)
+	{
+		int colorChannels = (image.colorChannels >= 3) ? 3 : 1;
+		return(image.pixels[(pixel * image.colorChannels) + ((colorChannels == 3) ? channel : 0)]);
+	}
+
+	// print the differences of a pair and whether they are in bounds
+	bool Report(const char* testPath, const ImageDiff::RESULT& result, float maxError, float meanError)
+	{
+		bool bWithin = (result.maxError <= maxError) && (result.meanError <= meanError);
+		std::cout << testPath << ": max " << result.maxError << ", mean " << result.meanError
+			<< ", PSNR " << result.psnr << " dB" << ((bWithin == true) ? "" : " - OUT OF BOUNDS") << std::endl;
+		return(bWithin);
+	}
+}
+
+/***********************************************************
+ *  Compare()
+ *
+ *  This method is used for measuring the differences of the
+ *  color channels of two images, their alpha left out, as
+ *  the frames are opaque.
+ ***********************************************************/
+bool ImageDiff::Compare(const char* referencePath, const char* testPath, RESULT& result)
+{
+	result.width = 0;
+	result.height = 0;
+	result.maxError = 0.0f;
+	result.meanError = 0.0f;
+	result.psnr = 0.0f;
+
+	// a gray frame is compared by its single channel, which is the
+	// same as the color channels it was reduced from
+	ImageDecoder::IMAGE reference;
+	ImageDecoder::IMAGE test;
+	if (ImageDecoder::Decode(referencePath, reference, false) == false)
+	{
+		std::cout << "Could not read " << referencePath << std::endl;
+		return(false);
+	}
+	if (ImageDecoder::Decode(testPath, test, false) == false)
+	{
+		std::cout << "Could not read " << testPath << std::endl;
+		ImageDecoder::Free(reference);
+		return(false);
+	}
+	if ((reference.width != test.width) || (reference.height != test.height))
+	{
+		std::cout << testPath << " is " << test.width << "x" << test.height << ", its reference " <<
+			reference.width << "x" << reference.height << std::endl;
+		ImageDecoder::Free(reference);
+		ImageDecoder::Free(test);
+		return(false);
+	}
+
+	const int pixelCount = reference.width * reference.height;
+	int maxError = 0;
+	double errorSum = 0.0;
+	double squaredSum = 0.0;
+	for (int pixel = 0; pixel < pixelCount; pixel++)
+	{
+		for (int channel = 0; channel < 3; channel++)
+		{
+			int error = abs(GetChannel(reference, pixel, channel) - GetChannel(test, pixel, channel));
+			maxError = (error > maxError) ? error : maxError;
+			errorSum += (double)error;
+			squaredSum += (double)(error * error);
+		}
+	}
+
+	const double samples = (double)pixelCount * 3.0;
+	result.width = reference.width;
+	result.height = reference.height;
+	result.maxError = (float)maxError;
+	result.meanError = (samples > 0.0) ? (float)(errorSum / samples) : 0.0f;
+	if ((samples > 0.0) && (squaredSum > 0.0))
+	{
+		result.psnr = (float)(10.0 * log10((255.0 * 255.0) / (squaredSum / samples)));
+	}
+
+	ImageDecoder::Free(reference);
+	ImageDecoder::Free(test);
+	return(true);
+}
+
+/***********************************************************
+ *  CompareWithin()
+ *
+ *  This method is used for checking a pair of images, or
+ *  two directories of batch render frames from 00000 on
+ *  until the reference runs out, against the bounds.
+ ***********************************************************/
+bool ImageDiff::CompareWithin(const char* referencePath, const char* testPath, const char* frameFormat,
+	float maxError, float meanError)
+{
+	// the gray reduction is checked per image, so both images of a
+	// pair may not come out the same way; keep every image in color
+	const int grayTolerance = ImageDecoder::GetGrayTolerance();
+	ImageDecoder::SetGrayTolerance(-1);
+
+	RESULT result;
+	bool bWithin = true;
+	int width = 0;
+	int height = 0;
+	int channels = 0;
+	if (ImageDecoder::ReadInfo(referencePath, width, height, channels) == true)
+	{
+		bWithin = (Compare(referencePath, testPath, result) == true) &&
+			(Report(testPath, result, maxError, meanError) == true);
+	}
+	else
+	{
+		int frame = 0;
+		for (; ; frame++)
+		{
+			std::string referenceFrame = GetFrameName(referencePath, frame, frameFormat);
+			if (ImageDecoder::ReadInfo(referenceFrame.c_str(), width, height, channels) == false)
+			{
+				break;
+			}
+			std::string testFrame = GetFrameName(testPath, frame, frameFormat);
+			bWithin = (Compare(referenceFrame.c_str(), testFrame.c_str(), result) == true) &&
+				(Report(testFrame.c_str(), result, maxError, meanError) == true) && (bWithin == true);
+		}
+		if (0 == frame)
+		{
+			std::cout << "No images at " << referencePath << std::endl;
+			bWithin = false;
+		}
+		else
+		{
+			std::cout << frame << " frames " << ((bWithin == true) ? "within" : "NOT within") <<
+				" max " << maxError << " and mean " << meanError << std::endl;
+		}
+	}
+
+	ImageDecoder::SetGrayTolerance(grayTolerance);
+	return(bWithin);
+}
@@ -0,0 +1,49 @@
+///////////////////////////////////////////////////////////////////////////////
+// imagediff.h
+// ============
+// compare rendered frames against reference frames within error bounds
+//
+//  A change meant to keep the picture, such as shading in half floats,
+//  is checked by rendering the same camera path with and without it
+//  through --batch-render and comparing the frames pixel by pixel.
+//  The largest and the mean difference of the color channels, in 8 bit
+//  levels, must stay within their bounds for every frame; a handful of
+//  pixels a level or two off is rounding, a mean drifting up is a bug.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+/***********************************************************
+ *  ImageDiff
+ *
+ *  This class contains the comparison of two images, or of
+ *  the numbered frames of two batch render directories. It
+ *  is used through static methods, since it needs no GL
+ *  context and runs before the window is made.
+ ***********************************************************/
+class ImageDiff
+{
+public:
+	// bounds unless told otherwise, in 8 bit levels of a channel
+	static const float DEFAULT_MAX_ERROR;
+	static const float DEFAULT_MEAN_ERROR;
+
+	// differences of the color channels of two images
+	struct RESULT
+	{
+		int width;
+		int height;
+		float maxError;		// largest over every channel, in levels
+		float meanError;	// mean over every channel, in levels
+		float psnr;			// in decibels, 0 for identical images
+	};
+
+	// compare two image files of the same size; false when either
+	// cannot be read or their sizes differ
+	static bool Compare(const char* referencePath, const char* testPath, RESULT& result);
+	// compare two images, or every numbered frame of the reference
+	// directory with the same frame of the test one, printing the
+	// differences; true when all are within the bounds
+	static bool CompareWithin(const char* referencePath, const char* testPath, const char* frameFormat,
+		float maxError, float meanError);
+};
@@ -0,0 +1,422 @@
+///////////////////////////////////////////////////////////////////////////////
+// impostoratlas.cpp
+// ============
+// octahedral impostors of the composite objects
+//
+//  Every composite object is captured from a grid of directions laid
+//  out over an octahedron, each view keeping the albedo, normal, depth
+//  and material of the parts. Far away the object is drawn as one
+//  camera facing quad that blends the views nearest the direction it
+//  is seen from and lights them with the lights of the frame.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "ImpostorAtlas.h"
+#include "TextureTable.h"
+#include "GPUMemory.h"
+#include "GLTrace.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+	// texels along each side of one atlas layer
+	const int LAYER_SIZE = ImpostorAtlas::GRID_SIZE * ImpostorAtlas::VIEW_SIZE;
+
+	/***********************************************************
+	 *  GetViewDirection()
+	 *
+	 *  This function is used for getting the direction a view
+	 *  of the grid looks at the object from, unfolding its cell
+	 *  over the octahedron the way impostorVertex.glsl folds
+	 *  the camera direction onto it.
+	 ***********************************************************/
+	glm::vec3 GetViewDirection(int view)
+	{
+		const float lastCell = (float)(ImpostorAtlas::GRID_SIZE - 1);
+		float x = ((float)(view % ImpostorAtlas::GRID_SIZE) / lastCell) * 2.0f - 1.0f;
+		float z = ((float)(view / ImpostorAtlas::GRID_SIZE) / lastCell) * 2.0f - 1.0f;
+		glm::vec3 direction(x, 1.0f - fabsf(x) - fabsf(z), z);
+		if (direction.y < 0.0f)
+		{
+			direction.x = (1.0f - fabsf(z)) * ((x >= 0.0f) ? 1.0f : -1.0f);
+			direction.z = (1.0f - fabsf(x)) * ((z >= 0.0f) ? 1.0f : -1.0f);
+		}
+
+		return(glm::normalize(direction));
+	}
+
+	/***********************************************************
+	 *  GetViewUp()
+	 *
+	 *  This function is used for getting the up vector of a
+	 *  view, the same one impostorFragment.glsl projects onto.
+	 ***********************************************************/
+	glm::vec3 GetViewUp(const glm::vec3& direction)
+	{
+		glm::vec3 reference = (fabsf(direction.y) < 0.999f) ?
+			glm::vec3(0.0f, 1.0f, 0.0f) : glm::vec3(0.0f, 0.0f, 1.0f);
+		glm::vec3 right = glm::normalize(glm::cross(reference, direction));
+		return(glm::cross(direction, right));
+	}
+}
+
+/***********************************************************
+ *  ImpostorAtlas()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+ImpostorAtlas::ImpostorAtlas(ShaderManager* pShaderManager)
+{
+	m_pShaderManager = pShaderManager;
+	m_captureProgram = 0;
+	m_captureViewProjectionLocation = -1;
+	m_modelLocation = -1;
+	m_normalMatrixLocation = -1;
+	m_colorLocation = -1;
+	m_UVscaleLocation = -1;
+	m_materialIndexLocation = -1;
+	m_textureIndexLocation = -1;
+	m_transparentLocation = -1;
+	m_impostorProgram = 0;
+	m_lightingLocation = -1;
+	m_albedoTexture = 0;
+	m_normalDepthTexture = 0;
+	m_captureFramebuffer = 0;
+	m_captureDepth = 0;
+	m_vao = 0;
+	m_captureCenter = glm::vec3(0.0f);
+	m_captureRadius = 1.0f;
+	m_savedFramebuffer = 0;
+	memset(m_savedViewport, 0, sizeof(m_savedViewport));
+	m_savedDepthFunc = GL_LESS;
+	m_savedClearDepth = 1.0f;
+	m_savedClipDepthMode = GL_NEGATIVE_ONE_TO_ONE;
+}
+
+/***********************************************************
+ *  ~ImpostorAtlas()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+ImpostorAtlas::~ImpostorAtlas()
+{
+	if (NULL != m_pShaderManager)
+	{
+		if (0 != m_albedoTexture)
+		{
+			m_pShaderManager->BindTexture(ALBEDO_TEXTURE_UNIT, 0, GL_TEXTURE_2D_ARRAY);
+		}
+		if (0 != m_normalDepthTexture)
+		{
+			m_pShaderManager->BindTexture(NORMAL_DEPTH_TEXTURE_UNIT, 0, GL_TEXTURE_2D_ARRAY);
+		}
+	}
+	if (0 != m_vao)
+	{
+		glDeleteVertexArrays(1, &m_vao);
+		m_vao = 0;
+	}
+	m_instanceBuffer.Destroy();
+	if (0 != m_captureFramebuffer)
+	{
+		glDeleteFramebuffers(1, &m_captureFramebuffer);
+		m_captureFramebuffer = 0;
+	}
+	if (0 != m_captureDepth)
+	{
+		glDeleteRenderbuffers(1, &m_captureDepth);
+		m_captureDepth = 0;
+	}
+	if (0 != m_albedoTexture)
+	{
+		GPUMemory::DeleteTextures(1, &m_albedoTexture);
+		m_albedoTexture = 0;
+	}
+	if (0 != m_normalDepthTexture)
+	{
+		GPUMemory::DeleteTextures(1, &m_normalDepthTexture);
+		m_normalDepthTexture = 0;
+	}
+	if (0 != m_captureProgram)
+	{
+		glDeleteProgram(m_captureProgram);
+		m_captureProgram = 0;
+	}
+	if (0 != m_impostorProgram)
+	{
+		glDeleteProgram(m_impostorProgram);
+		m_impostorProgram = 0;
+	}
+	m_pShaderManager = NULL;
+}
+
+/***********************************************************
+ *  Create()
+ *
+ *  This method is used for building the capture and the
+ *  impostor programs and the atlas. The albedo keeps the
+ *  coverage in its alpha; the normal and depth layers are
+ *  half float so the depth and the material index survive
+ *  the blend of the views.
+ ***********************************************************/
+bool ImpostorAtlas::Create(
+	const char* captureVertexPath,
+	const char* captureFragmentPath,
+	const char* impostorVertexPath,
+	const char* impostorFragmentPath)
+{
+	if (NULL == m_pShaderManager)
+	{
+		return(false);
+	}
+
+	m_captureProgram = m_pShaderManager->LoadExternalProgram(captureVertexPath, captureFragmentPath);
+	m_impostorProgram = m_pShaderManager->LoadExternalProgram(impostorVertexPath, impostorFragmentPath);
+	if ((0 == m_captureProgram) || (0 == m_impostorProgram))
+	{
+		std::cout << "Impostors disabled, the impostor shaders did not build" << std::endl;
+		if (0 != m_captureProgram)
+		{
+			glDeleteProgram(m_captureProgram);
+			m_captureProgram = 0;
+		}
+		if (0 != m_impostorProgram)
+		{
+			glDeleteProgram(m_impostorProgram);
+			m_impostorProgram = 0;
+		}
+		return(false);
+	}
+
+	m_captureViewProjectionLocation = glGetUniformLocation(m_captureProgram, "captureViewProjection");
+	m_modelLocation = glGetUniformLocation(m_captureProgram, "model");
+	m_normalMatrixLocation = glGetUniformLocation(m_captureProgram, "normalMatrix");
+	m_colorLocation = glGetUniformLocation(m_captureProgram, "objectColor");
+	m_UVscaleLocation = glGetUniformLocation(m_captureProgram, "UVscale");
+	m_materialIndexLocation = glGetUniformLocation(m_captureProgram, "materialIndex");
+	m_textureIndexLocation = glGetUniformLocation(m_captureProgram, "textureIndex");
+	m_transparentLocation = glGetUniformLocation(m_captureProgram, "transparent");
+	m_pShaderManager->UseExternalProgram(m_captureProgram);
+	glUniform1i(glGetUniformLocation(m_captureProgram, "textureArray"), TextureTable::TEXTURE_ARRAY_UNIT);
+
+	m_lightingLocation = glGetUniformLocation(m_impostorProgram, "lighting");
+	m_pShaderManager->UseExternalProgram(m_impostorProgram);
+	glUniform1i(glGetUniformLocation(m_impostorProgram, "albedoAtlas"), ALBEDO_TEXTURE_UNIT);
+	glUniform1i(glGetUniformLocation(m_impostorProgram, "normalDepthAtlas"), NORMAL_DEPTH_TEXTURE_UNIT);
+
+	// create on the atlas units, so the bindings of the scene
+	// textures stay what the shader manager expects
+	GLuint* textures[2] = { &m_albedoTexture, &m_normalDepthTexture };
+	const int units[2] = { ALBEDO_TEXTURE_UNIT, NORMAL_DEPTH_TEXTURE_UNIT };
+	const GLenum formats[2] = { GL_RGBA8, GL_RGBA16F };
+	const char* names[2] = { "impostor albedo", "impostor normal depth" };
+	for (int i = 0; i < 2; i++)
+	{
+		glGenTextures(1, textures[i]);
+		m_pShaderManager->BindTexture(units[i], *textures[i], GL_TEXTURE_2D_ARRAY);
+		m_pShaderManager->SetActiveTextureUnit(units[i]);
+		glTexStorage3D(GL_TEXTURE_2D_ARRAY, 1, formats[i], LAYER_SIZE, LAYER_SIZE, MAX_IMPOSTORS);
+		GPUMemory::TrackTexture(*textures[i], formats[i], LAYER_SIZE, LAYER_SIZE, MAX_IMPOSTORS, 1,
+			GPUMemory::CATEGORY_RENDER_TARGET, names[i]);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	}
+
+	glGenRenderbuffers(1, &m_captureDepth);
+	glBindRenderbuffer(GL_RENDERBUFFER, m_captureDepth);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, LAYER_SIZE, LAYER_SIZE);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	glGenFramebuffers(1, &m_captureFramebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, m_captureFramebuffer);
+	glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, m_albedoTexture, 0, 0);
+	glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, m_normalDepthTexture, 0, 0);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, m_captureDepth);
+	const GLenum drawBuffers[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+	glDrawBuffers(2, drawBuffers);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+	{
+		std::cout << "Impostor capture framebuffer is incomplete" << std::endl;
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	// one quad per instance, its corners made by the vertex shader
+	glGenVertexArrays(1, &m_vao);
+	m_instanceBuffer.Create(GPUBuffer::USAGE_STREAM, MAX_INSTANCES * sizeof(IMPOSTOR_INSTANCE), NULL,
+		GPUMemory::CATEGORY_BUFFER, "impostor instances");
+	ShapeMeshes::BindVertexArray(m_vao);
+	glBindBuffer(GL_ARRAY_BUFFER, m_instanceBuffer.GetName());
+	for (GLuint attribute = 0; attribute < 4; attribute++)
+	{
+		glVertexAttribPointer(attribute, 4, GL_FLOAT, GL_FALSE, sizeof(IMPOSTOR_INSTANCE),
+			(void*)(attribute * sizeof(glm::vec4)));
+		glVertexAttribDivisor(attribute, 1);
+		glEnableVertexAttribArray(attribute);
+	}
+	ShapeMeshes::BindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	return(true);
+}
+
+/***********************************************************
+ *  BeginCapture()
+ *
+ *  This method is used for switching to the layer of the
+ *  atlas an object is captured into, with the capture
+ *  program and the standard depth convention, even while
+ *  the scene is drawn with reverse-Z depth.
+ ***********************************************************/
+void ImpostorAtlas::BeginCapture(int layer, const glm::vec3& center, float radius)
+{
+	m_captureCenter = center;
+	m_captureRadius = glm::max(radius, 1e-4f);
+
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &m_savedFramebuffer);
+	glGetIntegerv(GL_VIEWPORT, m_savedViewport);
+	glGetIntegerv(GL_DEPTH_FUNC, &m_savedDepthFunc);
+	glGetFloatv(GL_DEPTH_CLEAR_VALUE, &m_savedClearDepth);
+	if ((GLEW_VERSION_4_5 == GL_TRUE) || (GLEW_ARB_clip_control == GL_TRUE))
+	{
+		glGetIntegerv(GL_CLIP_DEPTH_MODE, &m_savedClipDepthMode);
+		glClipControl(GL_LOWER_LEFT, GL_NEGATIVE_ONE_TO_ONE);
+	}
+	glClearDepth(1.0);
+	glDepthFunc(GL_LESS);
+	glDepthMask(GL_TRUE);
+	glBindFramebuffer(GL_FRAMEBUFFER, m_captureFramebuffer);
+	glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, m_albedoTexture, 0, layer);
+	glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, m_normalDepthTexture, 0, layer);
+	glEnable(GL_SCISSOR_TEST);
+	m_pShaderManager->UseExternalProgram(m_captureProgram);
+}
+
+/***********************************************************
+ *  BeginView()
+ *
+ *  This method is used for clearing the tile of one view and
+ *  pointing the parts at it, through an orthographic camera
+ *  outside the sphere of the object that looks at its
+ *  center.
+ ***********************************************************/
+void ImpostorAtlas::BeginView(int view)
+{
+	int x = (view % GRID_SIZE) * VIEW_SIZE;
+	int y = (view / GRID_SIZE) * VIEW_SIZE;
+	glViewport(x, y, VIEW_SIZE, VIEW_SIZE);
+	glScissor(x, y, VIEW_SIZE, VIEW_SIZE);
+
+	const GLfloat clearColor[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	const GLfloat clearDepth = 1.0f;
+	GLTrace::RecordClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	glClearBufferfv(GL_COLOR, 0, clearColor);
+	glClearBufferfv(GL_COLOR, 1, clearColor);
+	glClearBufferfv(GL_DEPTH, 0, &clearDepth);
+
+	glm::vec3 direction = GetViewDirection(view);
+	glm::mat4 captureView = glm::lookAt(m_captureCenter + (direction * (2.0f * m_captureRadius)),
+		m_captureCenter, GetViewUp(direction));
+	glm::mat4 captureProjection = glm::ortho(-m_captureRadius, m_captureRadius,
+		-m_captureRadius, m_captureRadius, m_captureRadius, 3.0f * m_captureRadius);
+	glm::mat4 captureViewProjection = captureProjection * captureView;
+	glUniformMatrix4fv(m_captureViewProjectionLocation, 1, GL_FALSE, &captureViewProjection[0][0]);
+}
+
+/***********************************************************
+ *  DrawPart()
+ *
+ *  This method is used for drawing one part into the current
+ *  view. Blended parts only add their color and coverage to
+ *  the albedo, over the opaque parts drawn before them.
+ ***********************************************************/
+void ImpostorAtlas::DrawPart(
+	const glm::mat4& model,
+	const ShapeMeshes::DRAW_RANGE& range,
+	const glm::vec4& color,
+	const glm::vec2& UVscale,
+	int materialID,
+	int textureSlot,
+	bool bTransparent)
+{
+	glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(model)));
+	glUniformMatrix4fv(m_modelLocation, 1, GL_FALSE, &model[0][0]);
+	glUniformMatrix3fv(m_normalMatrixLocation, 1, GL_FALSE, &normalMatrix[0][0]);
+	glUniform4fv(m_colorLocation, 1, &color[0]);
+	glUniform2fv(m_UVscaleLocation, 1, &UVscale[0]);
+	glUniform1i(m_materialIndexLocation, materialID);
+	glUniform1i(m_textureIndexLocation, textureSlot);
+	glUniform1i(m_transparentLocation, (bTransparent == true) ? 1 : 0);
+
+	if (bTransparent == true)
+	{
+		glEnable(GL_BLEND);
+		glBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+		glColorMaski(1, GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+		glDepthMask(GL_FALSE);
+	}
+	else
+	{
+		glDisable(GL_BLEND);
+	}
+
+	ShapeMeshes::DrawRange(range);
+
+	if (bTransparent == true)
+	{
+		glColorMaski(1, GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+		glDepthMask(GL_TRUE);
+	}
+}
+
+/***********************************************************
+ *  EndCapture()
+ *
+ *  This method is used for going back to the scene
+ *  framebuffer, viewport, blending and depth convention.
+ ***********************************************************/
+void ImpostorAtlas::EndCapture()
+{
+	glDisable(GL_SCISSOR_TEST);
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	glBindFramebuffer(GL_FRAMEBUFFER, (GLuint)m_savedFramebuffer);
+	glViewport(m_savedViewport[0], m_savedViewport[1], m_savedViewport[2], m_savedViewport[3]);
+	if ((GLEW_VERSION_4_5 == GL_TRUE) || (GLEW_ARB_clip_control == GL_TRUE))
+	{
+		glClipControl(GL_LOWER_LEFT, (GLenum)m_savedClipDepthMode);
+	}
+	glClearDepth(m_savedClearDepth);
+	glDepthFunc((GLenum)m_savedDepthFunc);
+}
+
+/***********************************************************
+ *  Draw()
+ *
+ *  This method is used for writing the quads of a frame into
+ *  the instance buffer, orphaning its last copy, and drawing
+ *  them in one instanced call. The quads test and write the
+ *  depth of the surface they stand for, with the depth
+ *  function of the pass they are drawn in.
+ ***********************************************************/
+void ImpostorAtlas::Draw(const std::vector<IMPOSTOR_INSTANCE>& instances, bool bLighting)
+{
+	if ((IsAvailable() == false) || (instances.empty() == true))
+	{
+		return;
+	}
+
+	GLsizei count = (GLsizei)glm::min((int)instances.size(), (int)MAX_INSTANCES);
+	m_instanceBuffer.Update(0, count * sizeof(IMPOSTOR_INSTANCE), &instances[0]);
+
+	m_pShaderManager->UseExternalProgram(m_impostorProgram);
+	glUniform1i(m_lightingLocation, (bLighting == true) ? 1 : 0);
+	m_pShaderManager->BindTexture(ALBEDO_TEXTURE_UNIT, m_albedoTexture, GL_TEXTURE_2D_ARRAY);
+	m_pShaderManager->BindTexture(NORMAL_DEPTH_TEXTURE_UNIT, m_normalDepthTexture, GL_TEXTURE_2D_ARRAY);
+	ShapeMeshes::BindVertexArray(m_vao);
+	glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, count);
+}
@@ -0,0 +1,126 @@
+///////////////////////////////////////////////////////////////////////////////
+// impostoratlas.h
+// ============
+// octahedral impostors of the composite objects
+//
+//  Every composite object is captured from a grid of directions laid
+//  out over an octahedron, each view keeping the albedo, normal, depth
+//  and material of the parts. Far away the object is drawn as one
+//  camera facing quad that blends the views nearest the direction it
+//  is seen from and lights them with the lights of the frame.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "ShaderManager.h"
+#include "ShapeMeshes.h"
+#include "GPUBuffer.h"
+
+#include <vector>
+
+/***********************************************************
+ *  ImpostorAtlas
+ *
+ *  This class contains the capture and the impostor programs
+ *  and the two texture arrays holding the views, one layer
+ *  per impostor. BeginCapture() starts the views of a layer,
+ *  each taking the parts of the object with DrawPart(), and
+ *  Draw() draws the quads of a frame in one instanced call.
+ ***********************************************************/
+class ImpostorAtlas
+{
+public:
+	// constructor
+	ImpostorAtlas(ShaderManager* pShaderManager);
+	// destructor
+	~ImpostorAtlas();
+
+	// texture units the impostors read the views from, above the
+	// pooled targets of the render graph
+	static const int ALBEDO_TEXTURE_UNIT = 29;
+	static const int NORMAL_DEPTH_TEXTURE_UNIT = 30;
+	// views along each side of the octahedral grid, and texels along
+	// each side of one view
+	static const int GRID_SIZE = 8;
+	static const int VIEW_SIZE = 64;
+	static const int VIEW_COUNT = GRID_SIZE * GRID_SIZE;
+	// impostors the atlas holds, and quads drawn in one frame
+	static const int MAX_IMPOSTORS = 8;
+	static const int MAX_INSTANCES = 4096;
+
+	// one quad of a frame, read as instance attributes
+	struct IMPOSTOR_INSTANCE
+	{
+		glm::vec4 centerRadius;	// world center, radius of the capture in object space
+		glm::vec4 axisX;		// object to world columns, w = atlas layer
+		glm::vec4 axisY;		// w = share of the pixels the impostor takes, 1 for all
+		glm::vec4 axisZ;		// w unused
+	};
+
+	// build the programs and the atlas; false when either fails
+	bool Create(
+		const char* captureVertexPath,
+		const char* captureFragmentPath,
+		const char* impostorVertexPath,
+		const char* impostorFragmentPath);
+	bool IsAvailable() const { return(0 != m_impostorProgram); }
+
+	// capture the views of a layer around a sphere in object space;
+	// every view clears its tile and takes the parts with DrawPart(),
+	// the opaque ones before the blended ones. The texture table has
+	// to be bound for the textured parts
+	void BeginCapture(int layer, const glm::vec3& center, float radius);
+	void BeginView(int view);
+	void DrawPart(
+		const glm::mat4& model,
+		const ShapeMeshes::DRAW_RANGE& range,
+		const glm::vec4& color,
+		const glm::vec2& UVscale,
+		int materialID,
+		int textureSlot,
+		bool bTransparent);
+	void EndCapture();
+
+	// draw the quads over the bound framebuffer, depth tested against
+	// the scene; lit by the LightData block unless bLighting is false
+	void Draw(const std::vector<IMPOSTOR_INSTANCE>& instances, bool bLighting);
+
+private:
+	// pointer to shader manager object
+	ShaderManager* m_pShaderManager;
+	// program writing the views, and its uniforms
+	GLuint m_captureProgram;
+	GLint m_captureViewProjectionLocation;
+	GLint m_modelLocation;
+	GLint m_normalMatrixLocation;
+	GLint m_colorLocation;
+	GLint m_UVscaleLocation;
+	GLint m_materialIndexLocation;
+	GLint m_textureIndexLocation;
+	GLint m_transparentLocation;
+	// program drawing the quads
+	GLuint m_impostorProgram;
+	GLint m_lightingLocation;
+	// albedo and coverage, and normal, depth and material, of every
+	// view of every layer
+	GLuint m_albedoTexture;
+	GLuint m_normalDepthTexture;
+	// framebuffer of the captures, drawing into the layer captured,
+	// and its depth
+	GLuint m_captureFramebuffer;
+	GLuint m_captureDepth;
+	// instance attributes of the quads, a stream rewritten by every
+	// draw, and the vertex array reading them
+	GPUBuffer m_instanceBuffer;
+	GLuint m_vao;
+	// sphere of the capture and the layer it goes into
+	glm::vec3 m_captureCenter;
+	float m_captureRadius;
+	// framebuffer, viewport and depth convention to restore after
+	// a capture
+	GLint m_savedFramebuffer;
+	GLint m_savedViewport[4];
+	GLint m_savedDepthFunc;
+	GLfloat m_savedClearDepth;
+	GLint m_savedClipDepthMode;
+};
@@ -0,0 +1,196 @@
+///////////////////////////////////////////////////////////////////////////////
+// instanceexpander.cpp
+// ============
+// expand compact instance records into the instance data on the GPU
+//
+//  The records are read straight from the upload ring they were
+//  written to, one invocation per record.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "InstanceExpander.h"
+#include "GPUMemory.h"
+
+#include <glm/packing.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+namespace
+{
+	// work group size declared by the compute shader
+	const GLuint EXPAND_GROUP_SIZE = 64;
+	// storage bindings of the records and the instance data
+	const GLuint RECORDS_BINDING = 0;
+	const GLuint INSTANCES_BINDING = 1;
+	// largest cosine between two axes of a model still taken as
+	// perpendicular, and the smallest scale along an axis
+	const float MAX_AXIS_COSINE = 1e-3f;
+	const float MIN_AXIS_SCALE = 1e-6f;
+}
+
+/***********************************************************
+ *  InstanceExpander()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+InstanceExpander::InstanceExpander(ShaderManager* pShaderManager)
+{
+	m_pShaderManager = pShaderManager;
+	m_expandProgram = 0;
+	m_firstRecordLocation = -1;
+	m_instanceCountLocation = -1;
+	m_instanceBuffer = 0;
+	m_instanceCapacity = 0;
+	m_stats.expansions = 0;
+	m_stats.instances = 0;
+	m_stats.fallbacks = 0;
+}
+
+/***********************************************************
+ *  ~InstanceExpander()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+InstanceExpander::~InstanceExpander()
+{
+	if (0 != m_instanceBuffer)
+	{
+		GPUMemory::DeleteBuffers(1, &m_instanceBuffer);
+		m_instanceBuffer = 0;
+	}
+	if (0 != m_expandProgram)
+	{
+		glDeleteProgram(m_expandProgram);
+		m_expandProgram = 0;
+	}
+	m_pShaderManager = NULL;
+}
+
+/***********************************************************
+ *  Create()
+ *
+ *  This method is used for building the compute program
+ *  expanding the records, which needs OpenGL 4.3 for
+ *  compute shaders and storage buffers.
+ ***********************************************************/
+bool InstanceExpander::Create(const char* expandShaderPath)
+{
+	if ((NULL == m_pShaderManager) || (GLEW_VERSION_4_3 != GL_TRUE))
+	{
+		return(false);
+	}
+
+	m_expandProgram = m_pShaderManager->LoadComputeShader(expandShaderPath);
+	if (0 == m_expandProgram)
+	{
+		std::cout << "Compact instances disabled, their compute shader did not build" << std::endl;
+		return(false);
+	}
+
+	m_firstRecordLocation = glGetUniformLocation(m_expandProgram, "firstRecord");
+	m_instanceCountLocation = glGetUniformLocation(m_expandProgram, "instanceCount");
+
+	return(true);
+}
+
+/***********************************************************
+ *  Pack()
+ *
+ *  This method is used for splitting a model matrix into the
+ *  translation, rotation and scale of a record. A mirrored
+ *  model keeps a negative scale along x, so the rotation
+ *  left over is a proper one.
+ ***********************************************************/
+bool InstanceExpander::Pack(
+	const glm::mat4& model,
+	const glm::vec4& color,
+	const glm::vec2& UVscale,
+	int materialID,
+	int textureIndex,
+	COMPACT_INSTANCE& instance)
+{
+	glm::mat3 axes = glm::mat3(model);
+	glm::vec3 scale = glm::vec3(glm::length(axes[0]), glm::length(axes[1]), glm::length(axes[2]));
+	if ((scale.x < MIN_AXIS_SCALE) || (scale.y < MIN_AXIS_SCALE) || (scale.z < MIN_AXIS_SCALE))
+	{
+		return(false);
+	}
+	if (glm::determinant(axes) < 0.0f)
+	{
+		scale.x = -scale.x;
+	}
+
+	glm::mat3 rotation = glm::mat3(axes[0] / scale.x, axes[1] / scale.y, axes[2] / scale.z);
+	if ((glm::abs(glm::dot(rotation[0], rotation[1])) > MAX_AXIS_COSINE) ||
+		(glm::abs(glm::dot(rotation[0], rotation[2])) > MAX_AXIS_COSINE) ||
+		(glm::abs(glm::dot(rotation[1], rotation[2])) > MAX_AXIS_COSINE))
+	{
+		return(false);
+	}
+
+	glm::quat orientation = glm::normalize(glm::quat_cast(rotation));
+
+	instance.position[0] = model[3].x;
+	instance.position[1] = model[3].y;
+	instance.position[2] = model[3].z;
+	instance.scaleXY = glm::packHalf2x16(glm::vec2(scale.x, scale.y));
+	instance.rotation[0] = glm::packSnorm2x16(glm::vec2(orientation.x, orientation.y));
+	instance.rotation[1] = glm::packSnorm2x16(glm::vec2(orientation.z, orientation.w));
+	instance.scaleZ = glm::packHalf2x16(glm::vec2(scale.z, 0.0f));
+	instance.UVscale = glm::packHalf2x16(UVscale);
+	instance.color[0] = glm::packHalf2x16(glm::vec2(color.r, color.g));
+	instance.color[1] = glm::packHalf2x16(glm::vec2(color.b, color.a));
+	instance.materialID = materialID;
+	instance.textureIndex = textureIndex;
+	return(true);
+}
+
+/***********************************************************
+ *  Expand()
+ *
+ *  This method is used for dispatching the compute program
+ *  over the records of the frame, after growing the instance
+ *  buffer when they do not fit. The barrier makes the writes
+ *  visible to the texel fetches of the draws and of the
+ *  culling passes.
+ ***********************************************************/
+bool InstanceExpander::Expand(GLuint recordBuffer, GLuint firstRecord, GLuint count)
+{
+	if ((IsAvailable() == false) || (0 == recordBuffer))
+	{
+		return(false);
+	}
+	if (0 == count)
+	{
+		return(true);
+	}
+
+	if (count > m_instanceCapacity)
+	{
+		if (0 != m_instanceBuffer)
+		{
+			GPUMemory::DeleteBuffers(1, &m_instanceBuffer);
+		}
+		// room to grow by half, so a few added draws do not
+		// replace the buffer every frame
+		m_instanceCapacity = count + count / 2;
+		GLsizeiptr bytes = (GLsizeiptr)m_instanceCapacity * INSTANCE_TEXELS * sizeof(glm::vec4);
+		glGenBuffers(1, &m_instanceBuffer);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_instanceBuffer);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, bytes, NULL, GL_DYNAMIC_COPY);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+		GPUMemory::TrackBuffer(m_instanceBuffer, bytes, GPUMemory::CATEGORY_BUFFER, "expanded instances");
+	}
+
+	m_pShaderManager->UseExternalProgram(m_expandProgram);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, RECORDS_BINDING, recordBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, INSTANCES_BINDING, m_instanceBuffer);
+	glUniform1ui(m_firstRecordLocation, firstRecord);
+	glUniform1ui(m_instanceCountLocation, count);
+	glDispatchCompute((count + EXPAND_GROUP_SIZE - 1) / EXPAND_GROUP_SIZE, 1, 1);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, RECORDS_BINDING, 0);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, INSTANCES_BINDING, 0);
+	glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+
+	m_stats.expansions++;
+	m_stats.instances += count;
+	return(true);
+}
@@ -0,0 +1,101 @@
+///////////////////////////////////////////////////////////////////////////////
+// instanceexpander.h
+// ============
+// expand compact instance records into the instance data on the GPU
+//
+//  The instance data every shader reads is 144 bytes per draw, most of
+//  it the model and normal matrices, and all of it is written into the
+//  upload ring again each time anything moves. A draw placed by a
+//  translation, rotation and scale is described by far less, so with
+//  this pass the frame uploads 48 byte records instead, and a compute
+//  pass rebuilds both matrices from them into a buffer of its own,
+//  laid out as the instance data the shaders already read.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "ShaderManager.h"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+
+/***********************************************************
+ *  InstanceExpander
+ *
+ *  This class contains the compute program expanding the
+ *  records and the instance buffer it writes, grown to the
+ *  largest instance count expanded so far.
+ ***********************************************************/
+class InstanceExpander
+{
+public:
+	// constructor
+	InstanceExpander(ShaderManager* pShaderManager);
+	// destructor
+	~InstanceExpander();
+
+	// one instance as it is uploaded, three uvec4 in the shader;
+	// the rotation is a unit quaternion, the halves are half floats
+	struct COMPACT_INSTANCE
+	{
+		float position[3];
+		uint32_t scaleXY;		// halves
+		uint32_t rotation[2];	// xy and zw as snorm16
+		uint32_t scaleZ;		// half, high half unused
+		uint32_t UVscale;		// halves
+		uint32_t color[2];		// rg and ba as halves
+		int32_t materialID;
+		int32_t textureIndex;
+	};
+
+	// RGBA32F texels of the instance data each record expands to,
+	// SceneManager::INSTANCE_DATA
+	static const int INSTANCE_TEXELS = 9;
+
+	// expansions since the start
+	struct EXPAND_STATS
+	{
+		unsigned long long expansions;		// dispatches of the pass
+		unsigned long long instances;		// records expanded
+		unsigned long long fallbacks;		// rebuilds left with full values
+	};
+
+	// build the compute program; false when the context has no
+	// compute shaders or the program fails to build
+	bool Create(const char* expandShaderPath);
+	bool IsAvailable() const { return(0 != m_expandProgram); }
+
+	// pack the values of one draw into a record; false when the
+	// model has a shear or a zero scale, which a translation,
+	// rotation and scale cannot describe
+	static bool Pack(
+		const glm::mat4& model,
+		const glm::vec4& color,
+		const glm::vec2& UVscale,
+		int materialID,
+		int textureIndex,
+		COMPACT_INSTANCE& instance);
+
+	// expand count records starting at a record index of a buffer
+	// into the instance buffer, from its first instance on; false
+	// when the pass is not available
+	bool Expand(GLuint recordBuffer, GLuint firstRecord, GLuint count);
+	// buffer of the expanded instance data, replaced when it grows
+	GLuint GetInstanceBuffer() const { return(m_instanceBuffer); }
+
+	// a rebuild of the instance data went back to the full values
+	void CountFallback() { m_stats.fallbacks++; }
+	const EXPAND_STATS& GetStats() const { return(m_stats); }
+
+private:
+	// pointer to shader manager object
+	ShaderManager* m_pShaderManager;
+	GLuint m_expandProgram;
+	GLint m_firstRecordLocation;
+	GLint m_instanceCountLocation;
+	// expanded instance data and the instances it holds
+	GLuint m_instanceBuffer;
+	GLuint m_instanceCapacity;
+	EXPAND_STATS m_stats;
+};
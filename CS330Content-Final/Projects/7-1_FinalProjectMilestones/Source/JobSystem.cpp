@@ -0,0 +1,396 @@
+///////////////////////////////////////////////////////////////////////////////
+// jobsystem.cpp
+// ============
+// work-stealing job scheduler shared by the per-frame scene passes
+//
+//  A pool of worker threads, started once, runs the jobs of the scene
+//  update, culling and sorting. Every thread keeps its own queue and
+//  takes its newest job first, while an idle thread steals the oldest
+//  job of another, which is the largest part of a split range. A
+//  parallel loop splits its range only while no split of it is left
+//  waiting, so it adapts to the load instead of fixing the chunks.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "JobSystem.h"
+#include "ScopeProfiler.h"
+
+#include <algorithm>
+
+namespace
+{
+	// job system and queue of the worker thread running, for
+	// finding the queue of a thread queueing jobs from a job
+	thread_local const JobSystem* gpWorkerSystem = NULL;
+	thread_local int gWorkerQueue = -1;
+}
+
+/***********************************************************
+ *  JobSystem()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+JobSystem::JobSystem()
+	: m_bRunning(false), m_queuedJobs(0), m_waitingCount(0), m_jobsRun(0), m_steals(0)
+{
+	// the shared queue, the only one while no worker runs
+	m_queues.push_back(new JOB_QUEUE());
+}
+
+/***********************************************************
+ *  ~JobSystem()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+JobSystem::~JobSystem()
+{
+	Stop();
+	for (size_t i = 0; i < m_queues.size(); i++)
+	{
+		delete m_queues[i];
+	}
+	m_queues.clear();
+}
+
+/***********************************************************
+ *  Start()
+ *
+ *  This method is used for starting the worker threads, each
+ *  with a queue of its own ahead of the shared one.
+ ***********************************************************/
+void JobSystem::Start(int workerCount)
+{
+	Stop();
+
+	if (workerCount < 0)
+	{
+		workerCount = std::max((int)std::thread::hardware_concurrency() - 1, 0);
+	}
+
+	for (size_t i = 0; i < m_queues.size(); i++)
+	{
+		delete m_queues[i];
+	}
+	m_queues.clear();
+	for (int i = 0; i <= workerCount; i++)
+	{
+		m_queues.push_back(new JOB_QUEUE());
+	}
+
+	m_bRunning = true;
+	for (int i = 0; i < workerCount; i++)
+	{
+		m_workers.push_back(std::thread(&JobSystem::WorkerLoop, this, i));
+	}
+}
+
+/***********************************************************
+ *  Stop()
+ *
+ *  This method is used for ending the worker threads. The
+ *  jobs still queued are run on the calling thread, so no
+ *  counter is left waiting.
+ ***********************************************************/
+void JobSystem::Stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_sleepMutex);
+		m_bRunning = false;
+	}
+	m_jobQueued.notify_all();
+	for (size_t i = 0; i < m_workers.size(); i++)
+	{
+		m_workers[i].join();
+	}
+	m_workers.clear();
+
+	while (RunOneJob((int)m_queues.size() - 1) == true)
+	{
+	}
+}
+
+/***********************************************************
+ *  Run()
+ *
+ *  This method is used for queueing a job on the queue of
+ *  the calling thread. A job depending on a counter that
+ *  still has jobs pending waits aside until the last of
+ *  them finishes, which queues it.
+ ***********************************************************/
+void JobSystem::Run(const std::function<void()>& job, JOB_COUNTER* pCounter, JOB_COUNTER* pDependency)
+{
+	JOB queuedJob;
+	queuedJob.job = job;
+	queuedJob.pCounter = pCounter;
+	queuedJob.pDependency = pDependency;
+	if (NULL != pCounter)
+	{
+		pCounter->pending++;
+	}
+
+	if (NULL != pDependency)
+	{
+		std::lock_guard<std::mutex> lock(m_waitingMutex);
+		// counted before the dependency is read, so the job that
+		// finishes it either sees this one waiting or was seen done
+		m_waitingCount++;
+		if (pDependency->pending > 0)
+		{
+			m_waitingJobs.push_back(queuedJob);
+			return;
+		}
+		m_waitingCount--;
+	}
+
+	PushJob(queuedJob);
+}
+
+/***********************************************************
+ *  Wait()
+ *
+ *  This method is used for running jobs on the calling
+ *  thread until the jobs of a counter finished. The thread
+ *  works on its own jobs first, which are the ones it split
+ *  off, and steals when it has none.
+ ***********************************************************/
+void JobSystem::Wait(JOB_COUNTER& counter)
+{
+	int queueIndex = GetQueueIndex();
+	while (counter.pending > 0)
+	{
+		if (RunOneJob(queueIndex) == false)
+		{
+			std::this_thread::yield();
+		}
+	}
+}
+
+/***********************************************************
+ *  ParallelFor()
+ *
+ *  This method is used for running a loop body over [0,
+ *  count) in ranges of at least minItems. The calling thread
+ *  starts on the whole range and splits off halves for the
+ *  other threads to steal, then waits for the halves taken.
+ *  Short loops and a system without workers run the body
+ *  once on the calling thread.
+ ***********************************************************/
+void JobSystem::ParallelFor(size_t count, size_t minItems, const std::function<void(size_t, size_t)>& body)
+{
+	size_t grain = (std::max(minItems, (size_t)1) + 3) & ~(size_t)3;
+	if ((m_workers.empty() == true) || (count <= grain))
+	{
+		body((size_t)0, count);
+		return;
+	}
+
+	JOB_COUNTER counter;
+	RunRange((size_t)0, count, grain, body, &counter);
+	Wait(counter);
+}
+
+/***********************************************************
+ *  GetStats()
+ *
+ *  This method is used for getting the jobs run so far and
+ *  how many of them were stolen.
+ ***********************************************************/
+JobSystem::JOB_STATS JobSystem::GetStats() const
+{
+	JOB_STATS stats;
+	stats.jobsRun = m_jobsRun;
+	stats.steals = m_steals;
+	return(stats);
+}
+
+/***********************************************************
+ *  WorkerLoop()
+ *
+ *  This method is used as the body of a worker thread. It
+ *  runs jobs while there are any and sleeps until one is
+ *  queued otherwise.
+ ***********************************************************/
+void JobSystem::WorkerLoop(int queueIndex)
+{
+	gpWorkerSystem = this;
+	gWorkerQueue = queueIndex;
+	ScopeProfiler::SetThreadName("job worker");
+
+	while (m_bRunning == true)
+	{
+		if (RunOneJob(queueIndex) == true)
+		{
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(m_sleepMutex);
+		m_jobQueued.wait(lock, [this]() { return((m_queuedJobs > 0) || (m_bRunning == false)); });
+	}
+
+	gpWorkerSystem = NULL;
+	gWorkerQueue = -1;
+}
+
+/***********************************************************
+ *  GetQueueIndex()
+ *
+ *  This method is used for getting the queue of the calling
+ *  thread, its own for a worker and the shared one for any
+ *  other thread.
+ ***********************************************************/
+int JobSystem::GetQueueIndex() const
+{
+	if (gpWorkerSystem == this)
+	{
+		return(gWorkerQueue);
+	}
+	return((int)m_queues.size() - 1);
+}
+
+/***********************************************************
+ *  PushJob()
+ *
+ *  This method is used for adding a job to the back of the
+ *  queue of the calling thread and waking a worker for it.
+ ***********************************************************/
+void JobSystem::PushJob(const JOB& job)
+{
+	JOB_QUEUE* pQueue = m_queues[GetQueueIndex()];
+	{
+		std::lock_guard<std::mutex> lock(pQueue->mutex);
+		pQueue->jobs.push_back(job);
+	}
+	m_queuedJobs++;
+
+	// a worker between checking for jobs and sleeping holds the
+	// lock, so taking it here cannot slip the wake past it
+	{
+		std::lock_guard<std::mutex> lock(m_sleepMutex);
+	}
+	m_jobQueued.notify_one();
+}
+
+/***********************************************************
+ *  RunOneJob()
+ *
+ *  This method is used for running one job: the newest of
+ *  the given queue, or else the oldest of the next queue
+ *  that has one. Finishing the last job of a counter queues
+ *  the jobs that were waiting for it.
+ ***********************************************************/
+bool JobSystem::RunOneJob(int queueIndex)
+{
+	JOB job;
+	bool bFound = false;
+	const int queueCount = (int)m_queues.size();
+	for (int i = 0; (i < queueCount) && (bFound == false); i++)
+	{
+		JOB_QUEUE* pQueue = m_queues[(queueIndex + i) % queueCount];
+		std::lock_guard<std::mutex> lock(pQueue->mutex);
+		if (pQueue->jobs.empty() == true)
+		{
+			continue;
+		}
+
+		if (i == 0)
+		{
+			job = pQueue->jobs.back();
+			pQueue->jobs.pop_back();
+		}
+		else
+		{
+			job = pQueue->jobs.front();
+			pQueue->jobs.pop_front();
+			m_steals++;
+		}
+		bFound = true;
+	}
+	if (bFound == false)
+	{
+		return(false);
+	}
+	m_queuedJobs--;
+
+	{
+		PROFILE_SCOPE("job");
+		job.job();
+	}
+	m_jobsRun++;
+
+	if ((NULL != job.pCounter) && (--job.pCounter->pending == 0) && (m_waitingCount > 0))
+	{
+		ReleaseWaitingJobs();
+	}
+	return(true);
+}
+
+/***********************************************************
+ *  ReleaseWaitingJobs()
+ *
+ *  This method is used for queueing the jobs whose
+ *  dependency has no job pending anymore.
+ ***********************************************************/
+void JobSystem::ReleaseWaitingJobs()
+{
+	std::vector<JOB> readyJobs;
+	{
+		std::lock_guard<std::mutex> lock(m_waitingMutex);
+		size_t kept = 0;
+		for (size_t i = 0; i < m_waitingJobs.size(); i++)
+		{
+			if (m_waitingJobs[i].pDependency->pending > 0)
+			{
+				m_waitingJobs[kept++] = m_waitingJobs[i];
+			}
+			else
+			{
+				readyJobs.push_back(m_waitingJobs[i]);
+			}
+		}
+		m_waitingJobs.resize(kept);
+		m_waitingCount -= (int)readyJobs.size();
+	}
+
+	for (size_t i = 0; i < readyJobs.size(); i++)
+	{
+		PushJob(readyJobs[i]);
+	}
+}
+
+/***********************************************************
+ *  RunRange()
+ *
+ *  This method is used for running the loop body over a
+ *  range a grain at a time. Whenever the queue of the
+ *  thread is empty, meaning its last split was stolen or
+ *  there was none, the upper half of what is left becomes a
+ *  job of its own. Busy threads so keep their ranges whole,
+ *  while idle ones always find a large piece to steal.
+ ***********************************************************/
+void JobSystem::RunRange(size_t first, size_t end, size_t grain,
+	const std::function<void(size_t, size_t)>& body, JOB_COUNTER* pCounter)
+{
+	JOB_QUEUE* pQueue = m_queues[GetQueueIndex()];
+	while (first < end)
+	{
+		bool bQueueEmpty = false;
+		if (end - first > grain)
+		{
+			std::lock_guard<std::mutex> lock(pQueue->mutex);
+			bQueueEmpty = pQueue->jobs.empty();
+		}
+
+		if (bQueueEmpty == true)
+		{
+			size_t middle = first + (((end - first) / 2 + 3) & ~(size_t)3);
+			size_t splitEnd = end;
+			Run([this, middle, splitEnd, grain, &body, pCounter]()
+				{ RunRange(middle, splitEnd, grain, body, pCounter); }, pCounter);
+			end = middle;
+			continue;
+		}
+
+		size_t chunkEnd = std::min(first + grain, end);
+		body(first, chunkEnd);
+		first = chunkEnd;
+	}
+}
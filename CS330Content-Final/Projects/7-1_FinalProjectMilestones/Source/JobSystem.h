@@ -0,0 +1,126 @@
+///////////////////////////////////////////////////////////////////////////////
+// jobsystem.h
+// ============
+// work-stealing job scheduler shared by the per-frame scene passes
+//
+//  A pool of worker threads, started once, runs the jobs of the scene
+//  update, culling and sorting. Every thread keeps its own queue and
+//  takes its newest job first, while an idle thread steals the oldest
+//  job of another, which is the largest part of a split range. A
+//  parallel loop splits its range only while no split of it is left
+//  waiting, so it adapts to the load instead of fixing the chunks.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/***********************************************************
+ *  JobSystem
+ *
+ *  This class contains the worker threads and the job queue
+ *  of every thread. Run() queues a job that may wait for the
+ *  jobs of a counter to finish first, Wait() runs jobs on
+ *  the calling thread until the jobs of a counter are done,
+ *  and ParallelFor() splits a loop into jobs. Without
+ *  workers every job runs on the thread queueing it.
+ ***********************************************************/
+class JobSystem
+{
+public:
+	// constructor
+	JobSystem();
+	// destructor
+	~JobSystem();
+
+	// jobs of a group not finished yet; a job can wait for a group
+	// before it starts, and a thread can wait for it to finish
+	struct JOB_COUNTER
+	{
+		std::atomic<int> pending;
+
+		JOB_COUNTER() : pending(0) {}
+	};
+
+	// work handed out so far
+	struct JOB_STATS
+	{
+		unsigned long long jobsRun;
+		// jobs taken from the queue of another thread
+		unsigned long long steals;
+	};
+
+	// start the worker threads; a negative count starts one per
+	// hardware thread besides the calling one
+	void Start(int workerCount = -1);
+	// finish the queued jobs and end the worker threads
+	void Stop();
+	// threads running jobs, the workers and the one waiting
+	int GetThreadCount() const { return((int)m_workers.size() + 1); }
+
+	// queue a job counted in pCounter, started only once the jobs
+	// of pDependency, if any, finished
+	void Run(const std::function<void()>& job, JOB_COUNTER* pCounter, JOB_COUNTER* pDependency = NULL);
+	// run queued jobs on the calling thread until the jobs of the
+	// counter finished
+	void Wait(JOB_COUNTER& counter);
+	// run body(first, end) over ranges covering [0, count), never
+	// splitting below minItems; the ranges start at multiples of
+	// four, so SIMD loops see whole groups
+	void ParallelFor(size_t count, size_t minItems, const std::function<void(size_t, size_t)>& body);
+
+	JOB_STATS GetStats() const;
+
+private:
+	// a queued job and the group it belongs to
+	struct JOB
+	{
+		std::function<void()> job;
+		JOB_COUNTER* pCounter;
+		JOB_COUNTER* pDependency;
+	};
+	// jobs of one thread, pushed and popped at the back by it and
+	// stolen from the front by the others
+	struct JOB_QUEUE
+	{
+		std::mutex mutex;
+		std::deque<JOB> jobs;
+	};
+
+	std::vector<std::thread> m_workers;
+	// a queue per worker, then one shared by the other threads
+	std::vector<JOB_QUEUE*> m_queues;
+	std::atomic<bool> m_bRunning;
+	// jobs in the queues, which the idle workers sleep on
+	std::atomic<int> m_queuedJobs;
+	std::mutex m_sleepMutex;
+	std::condition_variable m_jobQueued;
+	// jobs waiting for their dependency to finish
+	std::vector<JOB> m_waitingJobs;
+	std::atomic<int> m_waitingCount;
+	std::mutex m_waitingMutex;
+	std::atomic<unsigned long long> m_jobsRun;
+	std::atomic<unsigned long long> m_steals;
+
+	// body of a worker thread
+	void WorkerLoop(int queueIndex);
+	// queue of the calling thread
+	int GetQueueIndex() const;
+	void PushJob(const JOB& job);
+	// run the newest job of the thread's queue or steal the oldest
+	// of another; false when every queue is empty
+	bool RunOneJob(int queueIndex);
+	// queue the waiting jobs whose dependency finished
+	void ReleaseWaitingJobs();
+	// work through a range, splitting off its upper half whenever
+	// the queue of the thread ran dry
+	void RunRange(size_t first, size_t end, size_t grain,
+		const std::function<void(size_t, size_t)>& body, JOB_COUNTER* pCounter);
+};
@@ -0,0 +1,209 @@
+///////////////////////////////////////////////////////////////////////////////
+// lightclusters.cpp
+// ============
+// clustered forward lighting: the light lists of a froxel grid
+//
+//  A compute pass bins the lights of the LightData block into the
+//  clusters of a grid spanning the view frustum, and the fragment
+//  shader only evaluates the lights listed for its own cluster.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "LightClusters.h"
+#include "GPUMemory.h"
+
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+	// invocations per work group of the cluster compute shader
+	const GLuint CLUSTER_GROUP_SIZE = 64;
+	// closest distance the slices start at, so log() stays finite
+	const float MIN_CLUSTER_DEPTH = 0.01f;
+	// entries per cluster: the light count and its indexes
+	const int CLUSTER_STRIDE = LightClusters::MAX_CLUSTER_LIGHTS + 1;
+
+	/***********************************************************
+	 *  GetDepthRange()
+	 *
+	 *  This function is used for reading the near and far plane
+	 *  distances back out of a projection matrix, for both the
+	 *  perspective and the orthographic projection.
+	 ***********************************************************/
+	void GetDepthRange(const glm::mat4& projection, float& nearDepth, float& farDepth)
+	{
+		if (projection[3][3] == 0.0f)
+		{
+			nearDepth = projection[3][2] / (projection[2][2] - 1.0f);
+			farDepth = projection[3][2] / (projection[2][2] + 1.0f);
+		}
+		else
+		{
+			nearDepth = (projection[3][2] + 1.0f) / projection[2][2];
+			farDepth = (projection[3][2] - 1.0f) / projection[2][2];
+		}
+
+		nearDepth = glm::max(nearDepth, MIN_CLUSTER_DEPTH);
+		farDepth = glm::max(farDepth, nearDepth * 2.0f);
+	}
+}
+
+/***********************************************************
+ *  LightClusters()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+LightClusters::LightClusters(ShaderManager* pShaderManager)
+{
+	m_pShaderManager = pShaderManager;
+	m_cullProgram = 0;
+	m_viewLocation = -1;
+	m_inverseProjectionLocation = -1;
+	m_depthRangeLocation = -1;
+	m_clusterBuffer = 0;
+	memset(&m_header, 0, sizeof(m_header));
+	m_fallbackLightCount = -1;
+}
+
+/***********************************************************
+ *  ~LightClusters()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+LightClusters::~LightClusters()
+{
+	if (0 != m_clusterBuffer)
+	{
+		GPUMemory::DeleteBuffers(1, &m_clusterBuffer);
+		m_clusterBuffer = 0;
+	}
+	if (0 != m_cullProgram)
+	{
+		glDeleteProgram(m_cullProgram);
+		m_cullProgram = 0;
+	}
+	m_pShaderManager = NULL;
+}
+
+/***********************************************************
+ *  Create()
+ *
+ *  This method is used for creating the storage buffer of
+ *  the cluster light lists and building the compute program
+ *  filling them. Compute shaders came with OpenGL 4.3, so
+ *  without them the grid has a single cluster listing every
+ *  light, which shades the same as the unclustered loop.
+ ***********************************************************/
+void LightClusters::Create(const char* cullShaderPath)
+{
+	if (NULL == m_pShaderManager)
+	{
+		return;
+	}
+
+	if (GLEW_VERSION_4_3 == GL_TRUE)
+	{
+		m_cullProgram = m_pShaderManager->LoadComputeShader(cullShaderPath);
+		if (0 == m_cullProgram)
+		{
+			std::cout << "Clustered lighting disabled, its compute shader did not build" << std::endl;
+		}
+		else
+		{
+			m_viewLocation = glGetUniformLocation(m_cullProgram, "view");
+			m_inverseProjectionLocation = glGetUniformLocation(m_cullProgram, "inverseProjection");
+			m_depthRangeLocation = glGetUniformLocation(m_cullProgram, "depthRange");
+		}
+	}
+
+	// sized for the full grid either way, the fallback uses its start
+	glGenBuffers(1, &m_clusterBuffer);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_clusterBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER,
+		sizeof(CLUSTER_HEADER) + (CLUSTER_COUNT * CLUSTER_STRIDE * sizeof(GLuint)),
+		NULL, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	GPUMemory::TrackBuffer(m_clusterBuffer, sizeof(CLUSTER_HEADER) + (CLUSTER_COUNT * CLUSTER_STRIDE * sizeof(GLuint)),
+		GPUMemory::CATEGORY_BUFFER, "light clusters");
+}
+
+/***********************************************************
+ *  Update()
+ *
+ *  This method is used for filling the cluster light lists
+ *  for the camera of the frame, after the light block was
+ *  uploaded. The header is only uploaded when the viewport
+ *  or the depth range changed, and the fallback list only
+ *  when the number of lights changed.
+ ***********************************************************/
+void LightClusters::Update(
+	const glm::mat4& view,
+	const glm::mat4& projection,
+	int lightCount)
+{
+	if (0 == m_clusterBuffer)
+	{
+		return;
+	}
+
+	GLint viewport[4] = { 0, 0, 0, 0 };
+	glGetIntegerv(GL_VIEWPORT, viewport);
+
+	float nearDepth = 0.0f;
+	float farDepth = 0.0f;
+	GetDepthRange(projection, nearDepth, farDepth);
+
+	// slice = log(depth / near) / log(far / near) * slices
+	CLUSTER_HEADER header;
+	memset(&header, 0, sizeof(header));
+	if (IsClustered() == true)
+	{
+		header.gridSize[0] = CLUSTER_GRID_X;
+		header.gridSize[1] = CLUSTER_GRID_Y;
+		header.gridSize[2] = CLUSTER_GRID_Z;
+		header.sliceScale = CLUSTER_GRID_Z / logf(farDepth / nearDepth);
+		header.sliceBias = -logf(nearDepth) * header.sliceScale;
+	}
+	else
+	{
+		header.gridSize[0] = 1;
+		header.gridSize[1] = 1;
+		header.gridSize[2] = 1;
+	}
+	header.screenSize[0] = (GLfloat)glm::max(viewport[2], 1);
+	header.screenSize[1] = (GLfloat)glm::max(viewport[3], 1);
+
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, LIGHT_CLUSTERS_BINDING, m_clusterBuffer);
+	bool bHeaderChanged = (memcmp(&header, &m_header, sizeof(header)) != 0);
+	if (bHeaderChanged == true)
+	{
+		m_header = header;
+		glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(m_header), &m_header);
+	}
+
+	if (IsClustered() == false)
+	{
+		if ((bHeaderChanged == true) || (lightCount != m_fallbackLightCount))
+		{
+			GLuint clusterLights[CLUSTER_STRIDE];
+			int listed = glm::clamp(lightCount, 0, (int)MAX_CLUSTER_LIGHTS);
+			clusterLights[0] = (GLuint)listed;
+			for (int i = 0; i < listed; i++)
+			{
+				clusterLights[i + 1] = (GLuint)i;
+			}
+			glBufferSubData(GL_SHADER_STORAGE_BUFFER, sizeof(m_header),
+				(listed + 1) * sizeof(GLuint), clusterLights);
+			m_fallbackLightCount = lightCount;
+		}
+		return;
+	}
+
+	glm::mat4 inverseProjection = glm::inverse(projection);
+	m_pShaderManager->UseExternalProgram(m_cullProgram);
+	glUniformMatrix4fv(m_viewLocation, 1, GL_FALSE, &view[0][0]);
+	glUniformMatrix4fv(m_inverseProjectionLocation, 1, GL_FALSE, &inverseProjection[0][0]);
+	glUniform2f(m_depthRangeLocation, nearDepth, farDepth);
+	glDispatchCompute((CLUSTER_COUNT + CLUSTER_GROUP_SIZE - 1) / CLUSTER_GROUP_SIZE, 1, 1);
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+}
@@ -0,0 +1,80 @@
+///////////////////////////////////////////////////////////////////////////////
+// lightclusters.h
+// ============
+// clustered forward lighting: the light lists of a froxel grid
+//
+//  A compute pass bins the lights of the LightData block into the
+//  clusters of a grid spanning the view frustum, and the fragment
+//  shader only evaluates the lights listed for its own cluster.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "ShaderManager.h"
+
+#include <vector>
+
+/***********************************************************
+ *  LightClusters
+ *
+ *  This class contains the compute program and the storage
+ *  buffer of the light clusters. The grid has screen tiles
+ *  in x and y and exponentially spaced depth slices in z,
+ *  so the clusters stay roughly cube shaped with distance.
+ ***********************************************************/
+class LightClusters
+{
+public:
+	// constructor
+	LightClusters(ShaderManager* pShaderManager);
+	// destructor
+	~LightClusters();
+
+	// grid resolution, must match the cluster shaders
+	static const int CLUSTER_GRID_X = 16;
+	static const int CLUSTER_GRID_Y = 9;
+	static const int CLUSTER_GRID_Z = 24;
+	static const int CLUSTER_COUNT = CLUSTER_GRID_X * CLUSTER_GRID_Y * CLUSTER_GRID_Z;
+	// lights listed per cluster, must match MAX_CLUSTER_LIGHTS in the shaders
+	static const int MAX_CLUSTER_LIGHTS = 64;
+
+	// binding point of the LightClusters storage buffer
+	static const GLuint LIGHT_CLUSTERS_BINDING = 2;
+
+	// create the buffer and try to build the compute program; without
+	// compute shaders every light is listed in a single cluster
+	void Create(const char* cullShaderPath);
+	bool IsClustered() const { return(0 != m_cullProgram); }
+
+	// rebuild the cluster light lists for the camera of the frame;
+	// lightCount is only used by the single cluster fallback
+	void Update(
+		const glm::mat4& view,
+		const glm::mat4& projection,
+		int lightCount);
+
+private:
+	// std430 header of the LightClusters buffer, followed by one
+	// count and MAX_CLUSTER_LIGHTS light indexes per cluster
+	struct CLUSTER_HEADER
+	{
+		GLuint gridSize[4];		// x, y, z clusters and unused
+		GLfloat sliceScale;		// slice = log(depth) * scale + bias
+		GLfloat sliceBias;
+		GLfloat screenSize[2];	// viewport size in pixels
+	};
+
+	// pointer to shader manager object
+	ShaderManager* m_pShaderManager;
+	// compute program binning the lights, 0 without compute shaders
+	GLuint m_cullProgram;
+	GLint m_viewLocation;
+	GLint m_inverseProjectionLocation;
+	GLint m_depthRangeLocation;
+	// storage buffer read by the fragment shader
+	GLuint m_clusterBuffer;
+	// header of the last upload, to skip unchanged ones
+	CLUSTER_HEADER m_header;
+	// light count of the last fallback upload, -1 before the first
+	int m_fallbackLightCount;
+};
@@ -0,0 +1,1077 @@
+///////////////////////////////////////////////////////////////////////////////
+// lightmapbaker.cpp
+// ============
+// diffuse lighting of the static geometry baked into a lightmap atlas
+//
+//  Charts the triangles of the baked static geometry into a second UV
+//  set packed into one atlas, then fills the atlas on a worker thread
+//  with the ambient and diffuse terms the lit shader computes for
+//  every light, shadowed by rays cast against the static triangles
+//  and optionally darkened by ambient occlusion. The lit shader reads
+//  the atlas on the static surfaces instead of looping over their
+//  lights, while moving objects keep the real-time lighting.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "LightmapBaker.h"
+#include "AssetPack.h"
+#include "ShapeMeshes.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+namespace
+{
+	// "LMAP" and the layout version of the cache files
+	const uint32_t CACHE_MAGIC = 0x50414D4C;
+	const uint32_t CACHE_VERSION = 1;
+
+	const int VERTEX_FLOATS = ShapeMeshes::VERTEX_FLOATS;
+	const int UV_FLOATS = LightmapBaker::LIGHTMAP_UV_FLOATS;
+
+	// a face joins a chart while it turns less than about 37
+	// degrees away from the face the chart grew from
+	const float CHART_NORMAL_COS = 0.8f;
+	// empty texels around every chart, which the bilinear lookups
+	// of its edge texels read and the dilation fills
+	const int CHART_PADDING = 2;
+	// share of the atlas the charts are sized to cover at first
+	const float PACK_FILL = 0.6f;
+	// the density is capped, so a small scene gets a small atlas
+	const float MAX_TEXELS_PER_UNIT = 32.0f;
+	// attempts at a lower density before the charts are given up
+	const int MAX_PACK_ATTEMPTS = 40;
+	// triangles per leaf of the ray casting hierarchy
+	const int LEAF_TRIANGLES = 4;
+	// distance the rays start off the surface, so they miss it
+	const float RAY_BIAS = 0.01f;
+	// hemisphere rays per texel and their reach, in world units
+	const int AO_RAYS = 16;
+	const float AO_DISTANCE = 1.5f;
+
+	struct CACHE_HEADER
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint64_t key;
+		int32_t width;
+		int32_t height;
+	};
+
+	// one edge of a triangle, its corner indexes packed low first
+	struct CHART_EDGE
+	{
+		uint64_t key;
+		GLuint triangle;
+	};
+
+	// faces grown from one seed, flattened onto its plane
+	struct CHART
+	{
+		size_t firstTriangle;		// into the chart ordered triangles
+		size_t triangleCount;
+		glm::vec3 tangent;
+		glm::vec3 bitangent;
+		glm::vec2 minUV;			// world units on the plane
+		glm::vec2 maxUV;
+		glm::ivec2 size;			// texels, with the padding
+		glm::ivec2 offset;			// texels into the atlas
+	};
+
+	// a node of the hierarchy the shadow and occlusion rays are
+	// cast against
+	struct BVH_NODE
+	{
+		glm::vec3 minXYZ;
+		glm::vec3 maxXYZ;
+		int first;		// first triangle of a leaf, left child otherwise
+		int count;		// triangles of a leaf, 0 for an inner node
+	};
+
+	struct TRIANGLE_BVH
+	{
+		std::vector<BVH_NODE> nodes;
+		std::vector<glm::vec3> corners;		// 3 per triangle, in leaf order
+	};
+
+	/***********************************************************
+	 *  HashBytes()
+	 *
+	 *  This function is used for adding bytes to a 64 bit
+	 *  FNV-1a hash.
+	 ***********************************************************/
+	uint64_t HashBytes(uint64_t hash, const void* pData, size_t size)
+	{
+		const unsigned char* pBytes = (const unsigned char*)pData;
+		for (size_t i = 0; i < size; i++)
+		{
+			hash ^= pBytes[i];
+			hash *= 1099511628211ull;
+		}
+		return(hash);
+	}
+
+	/***********************************************************
+	 *  GetPosition()
+	 *
+	 *  This function is used for reading the position of a
+	 *  vertex of the interleaved arena layout.
+	 ***********************************************************/
+	glm::vec3 GetPosition(const std::vector<GLfloat>& vertices, GLuint vertex)
+	{
+		const GLfloat* pVertex = &vertices[(size_t)vertex * VERTEX_FLOATS];
+		return(glm::vec3(pVertex[0], pVertex[1], pVertex[2]));
+	}
+
+	/***********************************************************
+	 *  NextPowerOfTwo()
+	 *
+	 *  This function is used for rounding an atlas side up to
+	 *  a power of two.
+	 ***********************************************************/
+	int NextPowerOfTwo(int value)
+	{
+		int power = 1;
+		while (power < value)
+		{
+			power *= 2;
+		}
+		return(power);
+	}
+
+	/***********************************************************
+	 *  PackCharts()
+	 *
+	 *  This function is used for sizing the charts at a texel
+	 *  density and placing them on shelves, tallest first, in
+	 *  rows of maxAtlasSize texels. Returns false when they
+	 *  do not fit into a square of that size.
+	 ***********************************************************/
+	bool PackCharts(
+		std::vector<CHART>& charts,
+		float texelsPerUnit,
+		int maxAtlasSize,
+		glm::ivec2& usedSize)
+	{
+		std::vector<size_t> order(charts.size());
+		for (size_t i = 0; i < charts.size(); i++)
+		{
+			CHART& chart = charts[i];
+			glm::vec2 extent = (chart.maxUV - chart.minUV) * texelsPerUnit;
+			chart.size.x = (int)std::ceil(extent.x) + 1 + (2 * CHART_PADDING);
+			chart.size.y = (int)std::ceil(extent.y) + 1 + (2 * CHART_PADDING);
+			order[i] = i;
+		}
+		std::stable_sort(order.begin(), order.end(),
+			[&charts](size_t a, size_t b) { return(charts[a].size.y > charts[b].size.y); });
+
+		glm::ivec2 cursor(0, 0);
+		int shelfHeight = 0;
+		usedSize = glm::ivec2(0, 0);
+		for (size_t i = 0; i < order.size(); i++)
+		{
+			CHART& chart = charts[order[i]];
+			if (chart.size.x > maxAtlasSize)
+			{
+				return(false);
+			}
+			if (cursor.x + chart.size.x > maxAtlasSize)
+			{
+				cursor.x = 0;
+				cursor.y += shelfHeight;
+				shelfHeight = 0;
+			}
+			chart.offset = cursor;
+			cursor.x += chart.size.x;
+			shelfHeight = std::max(shelfHeight, chart.size.y);
+			usedSize.x = std::max(usedSize.x, cursor.x);
+		}
+		usedSize.y = cursor.y + shelfHeight;
+
+		return(usedSize.y <= maxAtlasSize);
+	}
+
+	/***********************************************************
+	 *  BuildNode()
+	 *
+	 *  This function is used for bounding a range of triangles
+	 *  and splitting it at the median of their centroids along
+	 *  the longest axis, until a leaf holds a few triangles.
+	 ***********************************************************/
+	void BuildNode(
+		TRIANGLE_BVH& bvh,
+		std::vector<GLuint>& order,
+		const std::vector<glm::vec3>& triangleCorners,
+		const std::vector<glm::vec3>& centroids,
+		int nodeIndex,
+		int first,
+		int count)
+	{
+		glm::vec3 minXYZ = triangleCorners[(size_t)order[first] * 3];
+		glm::vec3 maxXYZ = minXYZ;
+		glm::vec3 minCentroid = centroids[order[first]];
+		glm::vec3 maxCentroid = minCentroid;
+		for (int i = first; i < first + count; i++)
+		{
+			for (int corner = 0; corner < 3; corner++)
+			{
+				minXYZ = glm::min(minXYZ, triangleCorners[(size_t)order[i] * 3 + corner]);
+				maxXYZ = glm::max(maxXYZ, triangleCorners[(size_t)order[i] * 3 + corner]);
+			}
+			minCentroid = glm::min(minCentroid, centroids[order[i]]);
+			maxCentroid = glm::max(maxCentroid, centroids[order[i]]);
+		}
+		bvh.nodes[nodeIndex].minXYZ = minXYZ;
+		bvh.nodes[nodeIndex].maxXYZ = maxXYZ;
+
+		if (count <= LEAF_TRIANGLES)
+		{
+			bvh.nodes[nodeIndex].first = first;
+			bvh.nodes[nodeIndex].count = count;
+			return;
+		}
+
+		glm::vec3 extent = maxCentroid - minCentroid;
+		int axis = ((extent.x >= extent.y) && (extent.x >= extent.z)) ? 0 : ((extent.y >= extent.z) ? 1 : 2);
+		int middle = first + (count / 2);
+		std::nth_element(order.begin() + first, order.begin() + middle, order.begin() + first + count,
+			[&centroids, axis](GLuint a, GLuint b) { return(centroids[a][axis] < centroids[b][axis]); });
+
+		// the children are added before either is filled, so the
+		// nodes can be reallocated without losing the index
+		int leftChild = (int)bvh.nodes.size();
+		bvh.nodes.resize(bvh.nodes.size() + 2);
+		bvh.nodes[nodeIndex].first = leftChild;
+		bvh.nodes[nodeIndex].count = 0;
+		BuildNode(bvh, order, triangleCorners, centroids, leftChild, first, middle - first);
+		BuildNode(bvh, order, triangleCorners, centroids, leftChild + 1, middle, first + count - middle);
+	}
+
+	/***********************************************************
+	 *  BuildTriangleBVH()
+	 *
+	 *  This function is used for building the hierarchy of the
+	 *  triangles of a bake and copying their corners into the
+	 *  order of its leaves.
+	 ***********************************************************/
+	void BuildTriangleBVH(
+		const std::vector<GLfloat>& vertices,
+		const std::vector<GLuint>& indices,
+		TRIANGLE_BVH& bvh)
+	{
+		size_t triangleCount = indices.size() / 3;
+		bvh.nodes.clear();
+		bvh.corners.clear();
+		if (triangleCount == 0)
+		{
+			return;
+		}
+
+		std::vector<glm::vec3> triangleCorners(triangleCount * 3);
+		std::vector<glm::vec3> centroids(triangleCount);
+		std::vector<GLuint> order(triangleCount);
+		for (size_t t = 0; t < triangleCount; t++)
+		{
+			for (int corner = 0; corner < 3; corner++)
+			{
+				triangleCorners[t * 3 + corner] = GetPosition(vertices, indices[t * 3 + corner]);
+			}
+			centroids[t] = (triangleCorners[t * 3] + triangleCorners[t * 3 + 1] + triangleCorners[t * 3 + 2]) / 3.0f;
+			order[t] = (GLuint)t;
+		}
+
+		bvh.nodes.reserve(triangleCount * 2);
+		bvh.nodes.resize(1);
+		BuildNode(bvh, order, triangleCorners, centroids, 0, 0, (int)triangleCount);
+
+		bvh.corners.resize(triangleCount * 3);
+		for (size_t i = 0; i < triangleCount; i++)
+		{
+			for (int corner = 0; corner < 3; corner++)
+			{
+				bvh.corners[i * 3 + corner] = triangleCorners[(size_t)order[i] * 3 + corner];
+			}
+		}
+	}
+
+	/***********************************************************
+	 *  HitsBox()
+	 *
+	 *  This function is used for testing a ray against the box
+	 *  of a node with the slab method, up to a distance.
+	 ***********************************************************/
+	bool HitsBox(
+		const BVH_NODE& node,
+		const glm::vec3& origin,
+		const glm::vec3& inverseDirection,
+		float maxDistance)
+	{
+		glm::vec3 toMin = (node.minXYZ - origin) * inverseDirection;
+		glm::vec3 toMax = (node.maxXYZ - origin) * inverseDirection;
+		glm::vec3 entry = glm::min(toMin, toMax);
+		glm::vec3 exit = glm::max(toMin, toMax);
+		float tEntry = std::max(std::max(entry.x, entry.y), std::max(entry.z, 0.0f));
+		float tExit = std::min(std::min(exit.x, exit.y), std::min(exit.z, maxDistance));
+		return(tEntry <= tExit);
+	}
+
+	/***********************************************************
+	 *  HitsTriangle()
+	 *
+	 *  This function is used for testing a ray against both
+	 *  sides of a triangle with the Moller-Trumbore test, up
+	 *  to a distance.
+	 ***********************************************************/
+	bool HitsTriangle(
+		const glm::vec3* pCorners,
+		const glm::vec3& origin,
+		const glm::vec3& direction,
+		float maxDistance)
+	{
+		glm::vec3 edge1 = pCorners[1] - pCorners[0];
+		glm::vec3 edge2 = pCorners[2] - pCorners[0];
+		glm::vec3 p = glm::cross(direction, edge2);
+		float determinant = glm::dot(edge1, p);
+		if (std::fabs(determinant) < 1e-12f)
+		{
+			return(false);
+		}
+
+		float inverseDeterminant = 1.0f / determinant;
+		glm::vec3 toOrigin = origin - pCorners[0];
+		float u = glm::dot(toOrigin, p) * inverseDeterminant;
+		if ((u < 0.0f) || (u > 1.0f))
+		{
+			return(false);
+		}
+		glm::vec3 q = glm::cross(toOrigin, edge1);
+		float v = glm::dot(direction, q) * inverseDeterminant;
+		if ((v < 0.0f) || (u + v > 1.0f))
+		{
+			return(false);
+		}
+
+		float distance = glm::dot(edge2, q) * inverseDeterminant;
+		return((distance > 0.0f) && (distance < maxDistance));
+	}
+
+	/***********************************************************
+	 *  IsOccluded()
+	 *
+	 *  This function is used for finding out whether any
+	 *  triangle lies on a ray before a distance, which is all
+	 *  the shadow and occlusion rays ask.
+	 ***********************************************************/
+	bool IsOccluded(
+		const TRIANGLE_BVH& bvh,
+		const glm::vec3& origin,
+		const glm::vec3& direction,
+		float maxDistance)
+	{
+		if ((bvh.nodes.empty() == true) || (maxDistance <= 0.0f))
+		{
+			return(false);
+		}
+
+		glm::vec3 inverseDirection = 1.0f / direction;
+		// median splits keep the depth near log2 of the triangles
+		int stack[64];
+		int stackSize = 0;
+		stack[stackSize++] = 0;
+		while (stackSize > 0)
+		{
+			const BVH_NODE& node = bvh.nodes[stack[--stackSize]];
+			if (HitsBox(node, origin, inverseDirection, maxDistance) == false)
+			{
+				continue;
+			}
+			if (node.count > 0)
+			{
+				for (int t = node.first; t < node.first + node.count; t++)
+				{
+					if (HitsTriangle(&bvh.corners[(size_t)t * 3], origin, direction, maxDistance) == true)
+					{
+						return(true);
+					}
+				}
+			}
+			else if (stackSize + 2 <= 64)
+			{
+				stack[stackSize++] = node.first;
+				stack[stackSize++] = node.first + 1;
+			}
+		}
+		return(false);
+	}
+
+	/***********************************************************
+	 *  CalcAttenuation()
+	 *
+	 *  This function is used for fading a light to nothing at
+	 *  its radius, the same as CalcAttenuation() of the lit
+	 *  shader.
+	 ***********************************************************/
+	float CalcAttenuation(const LightmapBaker::BAKE_LIGHT& light, const glm::vec3& position)
+	{
+		if (light.radius <= 0.0f)
+		{
+			return(1.0f);
+		}
+
+		float distanceRatio = glm::length(light.position - position) / light.radius;
+		float window = glm::clamp(1.0f - std::pow(distanceRatio, 4.0f), 0.0f, 1.0f);
+		return(window * window);
+	}
+
+	/***********************************************************
+	 *  CalcOcclusion()
+	 *
+	 *  This function is used for the share of the hemisphere
+	 *  above a surface that no static triangle covers within
+	 *  AO_DISTANCE, from stratified cosine weighted rays. The
+	 *  pattern is turned by a hash of the texel, so its strata
+	 *  do not line up into bands, yet every bake is the same.
+	 ***********************************************************/
+	float CalcOcclusion(
+		const TRIANGLE_BVH& bvh,
+		const glm::vec3& origin,
+		const glm::vec3& normal,
+		uint32_t texelIndex)
+	{
+		glm::vec3 tangent = glm::normalize(glm::cross(
+			(std::fabs(normal.y) < 0.99f) ? glm::vec3(0.0f, 1.0f, 0.0f) : glm::vec3(1.0f, 0.0f, 0.0f), normal));
+		glm::vec3 bitangent = glm::cross(normal, tangent);
+
+		uint32_t hash = texelIndex * 2654435761u;
+		float rotation = (float)(hash >> 8) / 16777216.0f;
+
+		const int strata = 4;
+		int openRays = 0;
+		for (int i = 0; i < AO_RAYS; i++)
+		{
+			float radiusSquared = ((float)(i % strata) + 0.5f) / (float)strata;
+			float angle = 6.2831853f * ((((float)(i / strata) + 0.5f) / (float)(AO_RAYS / strata)) + rotation);
+			float radius = std::sqrt(radiusSquared);
+			glm::vec3 direction = (tangent * (radius * std::cos(angle))) +
+				(bitangent * (radius * std::sin(angle))) +
+				(normal * std::sqrt(1.0f - radiusSquared));
+			if (IsOccluded(bvh, origin, direction, AO_DISTANCE) == false)
+			{
+				openRays++;
+			}
+		}
+		return((float)openRays / (float)AO_RAYS);
+	}
+}
+
+/***********************************************************
+ *  LightmapBaker()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+LightmapBaker::LightmapBaker()
+	: m_bBusy(false), m_bReady(false), m_bCancel(false)
+{
+	m_result.width = 0;
+	m_result.height = 0;
+	m_result.key = 0;
+}
+
+/***********************************************************
+ *  ~LightmapBaker()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+LightmapBaker::~LightmapBaker()
+{
+	Finish();
+}
+
+/***********************************************************
+ *  GenerateUVs()
+ *
+ *  This method is used for the second UV set of the static
+ *  geometry. Faces sharing an edge are grown into a chart
+ *  while they face about the way of its first face, and
+ *  every chart is projected onto the plane of that face, so
+ *  a texel covers about the same area everywhere. The charts
+ *  are then shelf packed at the highest density that fits,
+ *  and every vertex gets one copy per chart using it. The
+ *  triangles keep their order, so index ranges into the list
+ *  still draw the same faces.
+ ***********************************************************/
+void LightmapBaker::GenerateUVs(
+	std::vector<GLfloat>& vertices,
+	std::vector<GLuint>& indices,
+	std::vector<GLfloat>& lightmapUVs,
+	int maxAtlasSize,
+	int& atlasWidth,
+	int& atlasHeight)
+{
+	lightmapUVs.clear();
+	atlasWidth = 0;
+	atlasHeight = 0;
+
+	size_t triangleCount = indices.size() / 3;
+	if (triangleCount == 0)
+	{
+		return;
+	}
+
+	// normal and area of every face
+	std::vector<glm::vec3> faceNormals(triangleCount);
+	float totalArea = 0.0f;
+	for (size_t t = 0; t < triangleCount; t++)
+	{
+		glm::vec3 p0 = GetPosition(vertices, indices[t * 3]);
+		glm::vec3 cross = glm::cross(GetPosition(vertices, indices[t * 3 + 1]) - p0,
+			GetPosition(vertices, indices[t * 3 + 2]) - p0);
+		float length = glm::length(cross);
+		faceNormals[t] = (length > 0.0f) ? (cross / length) : glm::vec3(0.0f);
+		totalArea += length * 0.5f;
+	}
+	if (totalArea <= 0.0f)
+	{
+		return;
+	}
+
+	// faces sharing an edge, found next to each other once the
+	// edges are sorted
+	std::vector<CHART_EDGE> edges(triangleCount * 3);
+	for (size_t t = 0; t < triangleCount; t++)
+	{
+		for (int corner = 0; corner < 3; corner++)
+		{
+			GLuint a = indices[t * 3 + corner];
+			GLuint b = indices[t * 3 + ((corner + 1) % 3)];
+			edges[t * 3 + corner].key = ((uint64_t)std::min(a, b) << 32) | std::max(a, b);
+			edges[t * 3 + corner].triangle = (GLuint)t;
+		}
+	}
+	std::sort(edges.begin(), edges.end(),
+		[](const CHART_EDGE& a, const CHART_EDGE& b) { return(a.key < b.key); });
+	std::vector<std::vector<GLuint>> neighbours(triangleCount);
+	for (size_t first = 0; first < edges.size();)
+	{
+		size_t end = first + 1;
+		while ((end < edges.size()) && (edges[end].key == edges[first].key))
+		{
+			end++;
+		}
+		for (size_t a = first; a < end; a++)
+		{
+			for (size_t b = a + 1; b < end; b++)
+			{
+				neighbours[edges[a].triangle].push_back(edges[b].triangle);
+				neighbours[edges[b].triangle].push_back(edges[a].triangle);
+			}
+		}
+		first = end;
+	}
+
+	// grow the charts, listing their faces one chart after another
+	std::vector<CHART> charts;
+	std::vector<GLuint> chartTriangles;
+	chartTriangles.reserve(triangleCount);
+	std::vector<unsigned char> charted(triangleCount, 0);
+	for (size_t seed = 0; seed < triangleCount; seed++)
+	{
+		if (charted[seed] != 0)
+		{
+			continue;
+		}
+
+		glm::vec3 normal = (glm::dot(faceNormals[seed], faceNormals[seed]) > 0.0f) ?
+			faceNormals[seed] : glm::vec3(0.0f, 0.0f, 1.0f);
+		CHART chart;
+		chart.firstTriangle = chartTriangles.size();
+		chart.tangent = glm::normalize(glm::cross(
+			(std::fabs(normal.y) < 0.99f) ? glm::vec3(0.0f, 1.0f, 0.0f) : glm::vec3(1.0f, 0.0f, 0.0f), normal));
+		chart.bitangent = glm::cross(normal, chart.tangent);
+
+		// the chart list doubles as the queue of the flood fill
+		charted[seed] = 1;
+		chartTriangles.push_back((GLuint)seed);
+		for (size_t next = chart.firstTriangle; next < chartTriangles.size(); next++)
+		{
+			const std::vector<GLuint>& adjacent = neighbours[chartTriangles[next]];
+			for (size_t i = 0; i < adjacent.size(); i++)
+			{
+				if ((charted[adjacent[i]] == 0) &&
+					(glm::dot(faceNormals[adjacent[i]], normal) >= CHART_NORMAL_COS))
+				{
+					charted[adjacent[i]] = 1;
+					chartTriangles.push_back(adjacent[i]);
+				}
+			}
+		}
+		chart.triangleCount = chartTriangles.size() - chart.firstTriangle;
+
+		// extent of the faces on the plane of the chart
+		chart.minUV = glm::vec2(FLT_MAX);
+		chart.maxUV = glm::vec2(-FLT_MAX);
+		for (size_t i = chart.firstTriangle; i < chartTriangles.size(); i++)
+		{
+			for (int corner = 0; corner < 3; corner++)
+			{
+				glm::vec3 position = GetPosition(vertices, indices[(size_t)chartTriangles[i] * 3 + corner]);
+				glm::vec2 planeUV(glm::dot(position, chart.tangent), glm::dot(position, chart.bitangent));
+				chart.minUV = glm::min(chart.minUV, planeUV);
+				chart.maxUV = glm::max(chart.maxUV, planeUV);
+			}
+		}
+		charts.push_back(chart);
+	}
+
+	// the density that would fill part of the atlas, lowered until
+	// the padded charts fit
+	float texelsPerUnit = std::min(
+		std::sqrt((float)maxAtlasSize * (float)maxAtlasSize * PACK_FILL / totalArea), MAX_TEXELS_PER_UNIT);
+	glm::ivec2 usedSize(0, 0);
+	int attempts = 0;
+	while (PackCharts(charts, texelsPerUnit, maxAtlasSize, usedSize) == false)
+	{
+		attempts++;
+		if (attempts >= MAX_PACK_ATTEMPTS)
+		{
+			std::cout << "Could not pack " << charts.size() << " lightmap charts into "
+				<< maxAtlasSize << "x" << maxAtlasSize << " texels" << std::endl;
+			return;
+		}
+		texelsPerUnit *= 0.85f;
+	}
+	atlasWidth = NextPowerOfTwo(usedSize.x);
+	atlasHeight = NextPowerOfTwo(usedSize.y);
+	glm::vec2 atlasScale(1.0f / (float)atlasWidth, 1.0f / (float)atlasHeight);
+
+	// copy every vertex once per chart using it, with the chart
+	// position in the atlas as its lightmap coordinate
+	size_t vertexCount = vertices.size() / VERTEX_FLOATS;
+	std::vector<int> vertexCharts(vertexCount, -1);
+	std::vector<GLuint> vertexCopies(vertexCount, 0);
+	std::vector<GLfloat> chartVertices;
+	chartVertices.reserve(vertices.size());
+	lightmapUVs.reserve((vertices.size() / VERTEX_FLOATS) * UV_FLOATS);
+	std::vector<GLuint> chartIndices(indices.size());
+	for (size_t chartIndex = 0; chartIndex < charts.size(); chartIndex++)
+	{
+		const CHART& chart = charts[chartIndex];
+		glm::vec2 origin = glm::vec2(chart.offset) + glm::vec2((float)CHART_PADDING + 0.5f);
+		for (size_t i = chart.firstTriangle; i < chart.firstTriangle + chart.triangleCount; i++)
+		{
+			size_t triangle = chartTriangles[i];
+			for (int corner = 0; corner < 3; corner++)
+			{
+				GLuint vertex = indices[triangle * 3 + corner];
+				if (vertexCharts[vertex] != (int)chartIndex)
+				{
+					vertexCharts[vertex] = (int)chartIndex;
+					vertexCopies[vertex] = (GLuint)(chartVertices.size() / VERTEX_FLOATS);
+
+					const GLfloat* pVertex = &vertices[(size_t)vertex * VERTEX_FLOATS];
+					chartVertices.insert(chartVertices.end(), pVertex, pVertex + VERTEX_FLOATS);
+
+					glm::vec3 position(pVertex[0], pVertex[1], pVertex[2]);
+					glm::vec2 planeUV(glm::dot(position, chart.tangent), glm::dot(position, chart.bitangent));
+					glm::vec2 atlasUV = (origin + ((planeUV - chart.minUV) * texelsPerUnit)) * atlasScale;
+					lightmapUVs.push_back(atlasUV.x);
+					lightmapUVs.push_back(atlasUV.y);
+					lightmapUVs.push_back(1.0f);
+				}
+				chartIndices[triangle * 3 + corner] = vertexCopies[vertex];
+			}
+		}
+	}
+
+	vertices.swap(chartVertices);
+	indices.swap(chartIndices);
+}
+
+/***********************************************************
+ *  MakeKey()
+ *
+ *  This method is used for hashing everything the lighting
+ *  of a bake reads on top of its geometry: the lights, the
+ *  materials and whether occlusion is baked.
+ ***********************************************************/
+uint64_t LightmapBaker::MakeKey(
+	uint64_t geometryKey,
+	const std::vector<BAKE_LIGHT>& lights,
+	const std::vector<BAKE_MATERIAL>& materials,
+	bool bAmbientOcclusion)
+{
+	uint64_t hash = 14695981039346656037ull;
+	hash = HashBytes(hash, &geometryKey, sizeof(geometryKey));
+
+	// field by field, so padding bytes stay out of the hash
+	for (size_t i = 0; i < lights.size(); i++)
+	{
+		const BAKE_LIGHT& light = lights[i];
+		float values[8] = { light.position.x, light.position.y, light.position.z,
+			light.ambientColor.r, light.ambientColor.g, light.ambientColor.b,
+			light.radius, (light.bDirect == true) ? 1.0f : 0.0f };
+		hash = HashBytes(hash, values, sizeof(values));
+	}
+	for (size_t i = 0; i < materials.size(); i++)
+	{
+		hash = HashBytes(hash, &materials[i].ambientColor[0], sizeof(float) * 3);
+		hash = HashBytes(hash, &materials[i].diffuseColor[0], sizeof(float) * 3);
+	}
+	int settings[2] = { (bAmbientOcclusion == true) ? 1 : 0, (int)CACHE_VERSION };
+	hash = HashBytes(hash, settings, sizeof(settings));
+
+	return(hash);
+}
+
+/***********************************************************
+ *  Bake()
+ *
+ *  This method is used for filling the atlas. Each triangle
+ *  is rasterized in lightmap space, and every texel whose
+ *  center it covers is lit with the interpolated position
+ *  and normal: the ambient of every light and of the
+ *  material, weighted by the attenuation as the lit shader
+ *  does, and the diffuse term of each direct light that a
+ *  shadow ray reaches. The highlights depend on the view,
+ *  so they are left out. The texels around the charts are
+ *  then grown from their neighbours, so bilinear lookups
+ *  along a chart edge never read the black background.
+ ***********************************************************/
+bool LightmapBaker::Bake(const BAKE_INPUT& input, LIGHTMAP& lightmap, const std::atomic<bool>* pCancel)
+{
+	lightmap.width = input.width;
+	lightmap.height = input.height;
+	lightmap.key = input.key;
+	lightmap.texels.assign((size_t)input.width * input.height * 3, 0.0f);
+	if ((input.width <= 0) || (input.height <= 0) || (input.indices.empty() == true))
+	{
+		return(true);
+	}
+
+	TRIANGLE_BVH bvh;
+	BuildTriangleBVH(input.vertices, input.indices, bvh);
+
+	std::vector<unsigned char> covered((size_t)input.width * input.height, 0);
+	size_t triangleCount = input.indices.size() / 3;
+	for (size_t t = 0; t < triangleCount; t++)
+	{
+		if ((NULL != pCancel) && (*pCancel == true))
+		{
+			return(false);
+		}
+
+		const BAKE_MATERIAL& material = input.materials[input.triangleMaterials[t]];
+		glm::vec3 positions[3];
+		glm::vec3 normals[3];
+		glm::vec2 texelUVs[3];
+		for (int corner = 0; corner < 3; corner++)
+		{
+			GLuint vertex = input.indices[t * 3 + corner];
+			const GLfloat* pVertex = &input.vertices[(size_t)vertex * VERTEX_FLOATS];
+			const GLfloat* pUV = &input.lightmapUVs[(size_t)vertex * UV_FLOATS];
+			positions[corner] = glm::vec3(pVertex[0], pVertex[1], pVertex[2]);
+			normals[corner] = glm::vec3(pVertex[3], pVertex[4], pVertex[5]);
+			texelUVs[corner] = glm::vec2(pUV[0] * (float)input.width, pUV[1] * (float)input.height);
+		}
+
+		glm::vec3 faceNormal = glm::cross(positions[1] - positions[0], positions[2] - positions[0]);
+		float area = ((texelUVs[1].x - texelUVs[0].x) * (texelUVs[2].y - texelUVs[0].y)) -
+			((texelUVs[2].x - texelUVs[0].x) * (texelUVs[1].y - texelUVs[0].y));
+		if ((glm::dot(faceNormal, faceNormal) <= 0.0f) || (std::fabs(area) < 1e-8f))
+		{
+			continue;
+		}
+		faceNormal = glm::normalize(faceNormal);
+
+		glm::vec2 minTexel = glm::min(glm::min(texelUVs[0], texelUVs[1]), texelUVs[2]);
+		glm::vec2 maxTexel = glm::max(glm::max(texelUVs[0], texelUVs[1]), texelUVs[2]);
+		int minX = std::max((int)std::floor(minTexel.x), 0);
+		int minY = std::max((int)std::floor(minTexel.y), 0);
+		int maxX = std::min((int)std::ceil(maxTexel.x), input.width - 1);
+		int maxY = std::min((int)std::ceil(maxTexel.y), input.height - 1);
+		for (int y = minY; y <= maxY; y++)
+		{
+			for (int x = minX; x <= maxX; x++)
+			{
+				// barycentric weights of the texel center
+				glm::vec2 center((float)x + 0.5f, (float)y + 0.5f);
+				float weight0 = (((texelUVs[1].x - center.x) * (texelUVs[2].y - center.y)) -
+					((texelUVs[2].x - center.x) * (texelUVs[1].y - center.y))) / area;
+				float weight1 = (((texelUVs[2].x - center.x) * (texelUVs[0].y - center.y)) -
+					((texelUVs[0].x - center.x) * (texelUVs[2].y - center.y))) / area;
+				float weight2 = 1.0f - weight0 - weight1;
+				if ((weight0 < -1e-4f) || (weight1 < -1e-4f) || (weight2 < -1e-4f))
+				{
+					continue;
+				}
+
+				glm::vec3 position = (positions[0] * weight0) + (positions[1] * weight1) + (positions[2] * weight2);
+				glm::vec3 normal = (normals[0] * weight0) + (normals[1] * weight1) + (normals[2] * weight2);
+				normal = (glm::dot(normal, normal) > 0.0f) ? glm::normalize(normal) : faceNormal;
+				// the rays leave from the side the shading normal faces
+				glm::vec3 origin = position +
+					(((glm::dot(faceNormal, normal) < 0.0f) ? -faceNormal : faceNormal) * RAY_BIAS);
+
+				glm::vec3 lightAmbient(0.0f);
+				glm::vec3 direct(0.0f);
+				float ambientWeight = 0.0f;
+				for (size_t i = 0; i < input.lights.size(); i++)
+				{
+					const BAKE_LIGHT& light = input.lights[i];
+					float attenuation = CalcAttenuation(light, position);
+					lightAmbient += light.ambientColor * attenuation;
+					ambientWeight += attenuation;
+					if ((light.bDirect == false) || (attenuation <= 0.0f))
+					{
+						continue;
+					}
+
+					// a directional light is past every triangle of the scene
+					glm::vec3 toLight = (light.radius < 0.0f) ? light.position : (light.position - origin);
+					float distance = glm::length(toLight);
+					if (distance <= RAY_BIAS)
+					{
+						continue;
+					}
+					glm::vec3 lightDirection = toLight / distance;
+					if (light.radius < 0.0f)
+					{
+						distance = FLT_MAX;
+					}
+					float impact = std::max(glm::dot(normal, lightDirection), 0.0f);
+					if ((impact > 0.0f) && (IsOccluded(bvh, origin, lightDirection, distance - RAY_BIAS) == false))
+					{
+						direct += material.diffuseColor * (impact * attenuation);
+					}
+				}
+
+				glm::vec3 ambient = lightAmbient + (material.ambientColor * ambientWeight);
+				if (input.bAmbientOcclusion == true)
+				{
+					ambient *= CalcOcclusion(bvh, origin, normal, (uint32_t)((y * input.width) + x));
+				}
+
+				size_t texel = ((size_t)y * input.width) + x;
+				glm::vec3 color = ambient + direct;
+				lightmap.texels[texel * 3] = color.r;
+				lightmap.texels[texel * 3 + 1] = color.g;
+				lightmap.texels[texel * 3 + 2] = color.b;
+				covered[texel] = 1;
+			}
+		}
+	}
+
+	// grow the charts into their padding, one texel per pass
+	std::vector<unsigned char> grown;
+	for (int pass = 0; pass < CHART_PADDING; pass++)
+	{
+		grown = covered;
+		for (int y = 0; y < input.height; y++)
+		{
+			for (int x = 0; x < input.width; x++)
+			{
+				size_t texel = ((size_t)y * input.width) + x;
+				if (covered[texel] != 0)
+				{
+					continue;
+				}
+
+				glm::vec3 sum(0.0f);
+				int count = 0;
+				for (int dy = -1; dy <= 1; dy++)
+				{
+					for (int dx = -1; dx <= 1; dx++)
+					{
+						int nx = x + dx;
+						int ny = y + dy;
+						if ((nx < 0) || (ny < 0) || (nx >= input.width) || (ny >= input.height))
+						{
+							continue;
+						}
+						size_t neighbour = ((size_t)ny * input.width) + nx;
+						if (covered[neighbour] != 0)
+						{
+							sum += glm::vec3(lightmap.texels[neighbour * 3], lightmap.texels[neighbour * 3 + 1],
+								lightmap.texels[neighbour * 3 + 2]);
+							count++;
+						}
+					}
+				}
+				if (count > 0)
+				{
+					sum /= (float)count;
+					lightmap.texels[texel * 3] = sum.r;
+					lightmap.texels[texel * 3 + 1] = sum.g;
+					lightmap.texels[texel * 3 + 2] = sum.b;
+					grown[texel] = 1;
+				}
+			}
+		}
+		covered.swap(grown);
+	}
+
+	return(true);
+}
+
+/***********************************************************
+ *  SaveCache()
+ *
+ *  This method is used for writing a lightmap with the key
+ *  it was baked for.
+ ***********************************************************/
+bool LightmapBaker::SaveCache(const char* filename, const LIGHTMAP& lightmap)
+{
+	FILE* pFile = fopen(filename, "wb");
+	if (NULL == pFile)
+	{
+		std::cout << "Could not create lightmap cache " << filename << std::endl;
+		return(false);
+	}
+
+	CACHE_HEADER header;
+	memset(&header, 0, sizeof(header));
+	header.magic = CACHE_MAGIC;
+	header.version = CACHE_VERSION;
+	header.key = lightmap.key;
+	header.width = lightmap.width;
+	header.height = lightmap.height;
+
+	bool bWritten = (fwrite(&header, sizeof(header), 1, pFile) == 1);
+	bWritten = bWritten && (lightmap.texels.empty() ||
+		(fwrite(&lightmap.texels[0], sizeof(float), lightmap.texels.size(), pFile) == lightmap.texels.size()));
+	bWritten = (fclose(pFile) == 0) && bWritten;
+
+	if (bWritten == false)
+	{
+		std::cout << "Could not write lightmap cache " << filename << std::endl;
+	}
+	else
+	{
+		AssetPack::NoteArtifact(filename, true);
+	}
+	return(bWritten);
+}
+
+/***********************************************************
+ *  LoadCache()
+ *
+ *  This method is used for restoring a lightmap saved by
+ *  SaveCache(). Files of another key, from geometry or
+ *  lighting that changed since, are rejected so the
+ *  lightmap gets baked again.
+ ***********************************************************/
+bool LightmapBaker::LoadCache(const char* filename, uint64_t key, LIGHTMAP& lightmap)
+{
+	// from the warm-start snapshot, or else the file
+	AssetPack::ASSET_VIEW view;
+	if (AssetPack::ReadArtifact(filename, view) == false)
+	{
+		return(false);
+	}
+
+	size_t offset = 0;
+	CACHE_HEADER header;
+	bool bRead = AssetPack::ReadView(view, offset, &header, sizeof(header)) &&
+		(header.magic == CACHE_MAGIC) && (header.version == CACHE_VERSION) && (header.key == key) &&
+		(header.width > 0) && (header.width <= MAX_ATLAS_SIZE) &&
+		(header.height > 0) && (header.height <= MAX_ATLAS_SIZE);
+	if (bRead == true)
+	{
+		lightmap.width = header.width;
+		lightmap.height = header.height;
+		lightmap.key = header.key;
+		lightmap.texels.resize((size_t)header.width * header.height * 3);
+		bRead = AssetPack::ReadView(view, offset, &lightmap.texels[0], lightmap.texels.size() * sizeof(float));
+	}
+
+	if (bRead == false)
+	{
+		lightmap.texels.clear();
+	}
+	else
+	{
+		AssetPack::NoteArtifact(filename, false);
+	}
+	return(bRead);
+}
+
+/***********************************************************
+ *  Start()
+ *
+ *  This method is used for starting the worker thread on a
+ *  bake. A bake still running is for lighting that changed
+ *  since, so it is dropped first.
+ ***********************************************************/
+void LightmapBaker::Start(BAKE_INPUT& input)
+{
+	Finish();
+
+	std::swap(m_input, input);
+	m_bBusy = true;
+	m_worker = std::thread(&LightmapBaker::BakeInput, this);
+}
+
+/***********************************************************
+ *  BakeInput()
+ *
+ *  This method is used for baking the input on the worker
+ *  thread and handing the lightmap to the GL thread.
+ ***********************************************************/
+void LightmapBaker::BakeInput()
+{
+	LIGHTMAP lightmap;
+	if (Bake(m_input, lightmap, &m_bCancel) == true)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		std::swap(m_result, lightmap);
+		m_bReady = true;
+	}
+	m_bBusy = false;
+}
+
+/***********************************************************
+ *  TakeResult()
+ *
+ *  This method is used for taking the lightmap the worker
+ *  thread finished, if it did, so a frame never waits for
+ *  a bake.
+ ***********************************************************/
+bool LightmapBaker::TakeResult(LIGHTMAP& lightmap)
+{
+	if (m_bReady == false)
+	{
+		return(false);
+	}
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	std::swap(lightmap, m_result);
+	m_result = LIGHTMAP();
+	m_bReady = false;
+	return(true);
+}
+
+/***********************************************************
+ *  Finish()
+ *
+ *  This method is used for joining the worker thread and
+ *  dropping its input and a lightmap the GL thread did not
+ *  take.
+ ***********************************************************/
+void LightmapBaker::Finish()
+{
+	// the worker stops before the next triangle
+	m_bCancel = true;
+	if (m_worker.joinable() == true)
+	{
+		m_worker.join();
+	}
+	m_bCancel = false;
+
+	m_input = BAKE_INPUT();
+	m_result = LIGHTMAP();
+	m_bReady = false;
+	m_bBusy = false;
+}
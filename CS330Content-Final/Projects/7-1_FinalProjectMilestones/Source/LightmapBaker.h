@@ -0,0 +1,145 @@
+///////////////////////////////////////////////////////////////////////////////
+// lightmapbaker.h
+// ============
+// diffuse lighting of the static geometry baked into a lightmap atlas
+//
+//  Charts the triangles of the baked static geometry into a second UV
+//  set packed into one atlas, then fills the atlas on a worker thread
+//  with the ambient and diffuse terms the lit shader computes for
+//  every light, shadowed by rays cast against the static triangles
+//  and optionally darkened by ambient occlusion. The lit shader reads
+//  the atlas on the static surfaces instead of looping over their
+//  lights, while moving objects keep the real-time lighting.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/***********************************************************
+ *  LightmapBaker
+ *
+ *  This class contains the worker thread baking a lightmap
+ *  and the lightmap it finished that has not been taken by
+ *  the GL thread yet. The charting and the bake itself are
+ *  static, so they can run on any thread.
+ ***********************************************************/
+class LightmapBaker
+{
+public:
+	// constructor
+	LightmapBaker();
+	// destructor
+	~LightmapBaker();
+
+	// floats of a lightmap coordinate: the atlas UV and a weight
+	// of 1, which reads as 0 on meshes without the attribute
+	static const int LIGHTMAP_UV_FLOATS = 3;
+	// largest width and height of the atlas
+	static const int MAX_ATLAS_SIZE = 1024;
+
+	// one light as the lit shader evaluates it
+	struct BAKE_LIGHT
+	{
+		glm::vec3 position;
+		glm::vec3 ambientColor;
+		float radius;		// reach of the light, 0 for the whole scene,
+							// negative for a directional light, whose
+							// position is the direction towards it
+		bool bDirect;		// false for lights with only an ambient term
+	};
+
+	// the terms of a material the diffuse lighting reads
+	struct BAKE_MATERIAL
+	{
+		glm::vec3 ambientColor;		// ambient color times its strength
+		glm::vec3 diffuseColor;
+	};
+
+	// everything a bake reads, in world space
+	struct BAKE_INPUT
+	{
+		std::vector<GLfloat> vertices;		// ShapeMeshes::VERTEX_FLOATS per vertex
+		std::vector<GLfloat> lightmapUVs;	// LIGHTMAP_UV_FLOATS per vertex
+		std::vector<GLuint> indices;		// triangle list
+		std::vector<int> triangleMaterials;	// materials index of each triangle
+		std::vector<BAKE_MATERIAL> materials;
+		std::vector<BAKE_LIGHT> lights;
+		int width;
+		int height;
+		bool bAmbientOcclusion;
+		uint64_t key;		// from MakeKey(), handed on to the lightmap
+	};
+
+	// linear RGB texels of the atlas, rows from the bottom up
+	struct LIGHTMAP
+	{
+		int width;
+		int height;
+		std::vector<float> texels;	// 3 floats per texel
+		uint64_t key;
+	};
+
+	// split a triangle list into charts of faces facing about the same
+	// way, each flattened onto its plane, and pack them into an atlas
+	// no larger than maxAtlasSize; vertices shared by two charts are
+	// copied, so the vertices and indices are rewritten. Fills one
+	// lightmap coordinate per vertex and the size of the atlas, which
+	// is 0 by 0 for an empty list
+	static void GenerateUVs(
+		std::vector<GLfloat>& vertices,
+		std::vector<GLuint>& indices,
+		std::vector<GLfloat>& lightmapUVs,
+		int maxAtlasSize,
+		int& atlasWidth,
+		int& atlasHeight);
+	// key of the lighting of a bake over the geometry of geometryKey,
+	// which changes whenever a cached lightmap of it would be stale
+	static uint64_t MakeKey(
+		uint64_t geometryKey,
+		const std::vector<BAKE_LIGHT>& lights,
+		const std::vector<BAKE_MATERIAL>& materials,
+		bool bAmbientOcclusion);
+	// bake the lightmap of an input on the calling thread; pCancel,
+	// when set, stops it between triangles and returns false
+	static bool Bake(const BAKE_INPUT& input, LIGHTMAP& lightmap, const std::atomic<bool>* pCancel = NULL);
+
+	// restore a lightmap saved with the same key
+	static bool LoadCache(const char* filename, uint64_t key, LIGHTMAP& lightmap);
+	static bool SaveCache(const char* filename, const LIGHTMAP& lightmap);
+
+	// start baking the input, which is taken over, on the worker
+	// thread, dropping a bake still running
+	void Start(BAKE_INPUT& input);
+	// take the finished lightmap without waiting; false when the
+	// bake is still running or there is none
+	bool TakeResult(LIGHTMAP& lightmap);
+	// true while the worker thread bakes
+	bool IsBusy() const { return(m_bBusy); }
+	// true when a finished lightmap waits to be taken
+	bool IsReady() const { return(m_bReady); }
+	// stop the worker after the triangle it is baking and drop its
+	// result
+	void Finish();
+
+private:
+	BAKE_INPUT m_input;
+	// the finished lightmap, guarded by m_mutex
+	LIGHTMAP m_result;
+	std::atomic<bool> m_bBusy;
+	std::atomic<bool> m_bReady;
+	// set to stop the worker between triangles
+	std::atomic<bool> m_bCancel;
+	std::mutex m_mutex;
+	std::thread m_worker;
+
+	// body of the worker thread
+	void BakeInput();
+};
@@ -0,0 +1,568 @@
+///////////////////////////////////////////////////////////////////////////////
+// liveedit.cpp
+// ============
+// scene edits taken over a local socket and applied between frames
+//
+//  An editor connected to a TCP port of the loopback interface sends
+//  small edits of the running scene a line each, which a thread reads
+//  and queues; the main loop applies the queued ones before it builds
+//  the next frame, through the incremental paths of the scene manager,
+//  so an edit never reloads the scene. Every edit is answered once it
+//  was applied, with ok or error and the line number of the client,
+//  and the time from receiving it to applying it is kept.
+//
+//  The edit lines are
+//    transform <node> <sx> <sy> <sz> <rx> <ry> <rz> <px> <py> <pz>
+//    color <node> <r> <g> <b> <a>
+//    material <material> <parameter> <value> [<value> <value>]
+//    add <prefab> <node> <sx> <sy> <sz> <rx> <ry> <rz> <px> <py> <pz>
+//    remove <node>
+//  with the nodes and materials named by their tags and the rotation
+//  in degrees. A parameter is a field of the material, such as
+//  diffuseColor or shininess. add puts back a removed instance of the
+//  tag where given, or else places a new movable instance of a prefab
+//  the scene placed. The line stats is answered with the counters.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "LiveEdit.h"
+#include "NetSocket.h"
+#include "SceneManager.h"
+#include "ScopeProfiler.h"
+#include "Logger.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+
+namespace
+{
+	const uintptr_t NO_SOCKET = NetSocket::INVALID_HANDLE;
+
+	// longest the thread blocks on the sockets before checking
+	// whether the service stops
+	const long POLL_MICROSECONDS = 100000;
+	// edits waiting beyond which more are refused
+	const size_t MAX_PENDING_EDITS = 65536;
+	// edits applied per frame, so a burst from the editor is spread
+	// over frames instead of stalling one
+	const int MAX_EDITS_PER_FRAME = 256;
+	// longest line a client may send
+	const size_t MAX_LINE_BYTES = 1024;
+
+	double NowSeconds()
+	{
+		return(std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count());
+	}
+}
+
+/***********************************************************
+ *  LiveEdit()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+LiveEdit::LiveEdit()
+{
+	m_listenSocket = NO_SOCKET;
+	m_bStopping = false;
+	m_nextClientId = 1;
+	memset(&m_stats, 0, sizeof(m_stats));
+}
+
+/***********************************************************
+ *  ~LiveEdit()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+LiveEdit::~LiveEdit()
+{
+	Stop();
+}
+
+/***********************************************************
+ *  Start()
+ *
+ *  This method is used for opening the port, on the
+ *  loopback interface only since the edits are not
+ *  authenticated, and starting the thread taking the
+ *  clients and their edits.
+ ***********************************************************/
+bool LiveEdit::Start(int port)
+{
+	Stop();
+
+	if (NetSocket::Startup() == false)
+	{
+		LOG_ERROR("Could not start the sockets for the live edits");
+		return(false);
+	}
+	uintptr_t listenSocket = NetSocket::Listen(port, true);
+	if (listenSocket == NO_SOCKET)
+	{
+		LOG_ERROR("Could not listen for live edits on port %d", port);
+		NetSocket::Cleanup();
+		return(false);
+	}
+
+	m_listenSocket = listenSocket;
+	m_bStopping = false;
+	m_receiveThread = std::thread(&LiveEdit::ReceiveLoop, this);
+	LOG_INFO("Taking live edits on port %d", port);
+	return(true);
+}
+
+/***********************************************************
+ *  Stop()
+ *
+ *  This method is used for ending the thread and closing
+ *  the clients and the port. The edits still waiting are
+ *  dropped.
+ ***********************************************************/
+void LiveEdit::Stop()
+{
+	if (m_listenSocket == NO_SOCKET)
+	{
+		return;
+	}
+
+	m_bStopping = true;
+	m_receiveThread.join();
+
+	while (m_clients.empty() == false)
+	{
+		CloseClient(m_clients.size() - 1);
+	}
+	NetSocket::Close(m_listenSocket);
+	m_listenSocket = NO_SOCKET;
+	NetSocket::Cleanup();
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_pending.clear();
+}
+
+/***********************************************************
+ *  ApplyEdits()
+ *
+ *  This method is used for applying the edits waiting, in
+ *  the order they arrived, and answering each. At most
+ *  MAX_EDITS_PER_FRAME are taken, the rest wait for the
+ *  next frame. The edits only mark what changed; the
+ *  transforms, the hierarchy and the instance data are
+ *  brought up to date once for all of them by the scene
+ *  update of the frame.
+ ***********************************************************/
+int LiveEdit::ApplyEdits(SceneManager* pSceneManager)
+{
+	std::vector<SCENE_EDIT> edits;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		size_t count = std::min(m_pending.size(), (size_t)MAX_EDITS_PER_FRAME);
+		edits.assign(m_pending.begin(), m_pending.begin() + count);
+		m_pending.erase(m_pending.begin(), m_pending.begin() + count);
+	}
+	if (edits.empty() == true)
+	{
+		return(0);
+	}
+
+	double startTime = NowSeconds();
+	int applied = 0;
+	int rejected = 0;
+	double latencySeconds = 0.0;
+	double latencyMaxSeconds = 0.0;
+	for (size_t i = 0; i < edits.size(); i++)
+	{
+		const SCENE_EDIT& edit = edits[i];
+		std::string reason;
+		char line[256];
+		if (ApplyEdit(pSceneManager, edit, reason) == true)
+		{
+			snprintf(line, sizeof(line), "ok %u\n", edit.line);
+			applied++;
+			double latency = startTime - edit.receivedTime;
+			latencySeconds += latency;
+			latencyMaxSeconds = std::max(latencyMaxSeconds, latency);
+		}
+		else
+		{
+			snprintf(line, sizeof(line), "error %u %s\n", edit.line, reason.c_str());
+			rejected++;
+		}
+		SendToClient(edit.clientId, line);
+	}
+	double applySeconds = NowSeconds() - startTime;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_stats.applied += applied;
+	m_stats.rejected += rejected;
+	m_stats.frames++;
+	m_stats.latencySeconds += latencySeconds;
+	m_stats.latencyMaxSeconds = std::max(m_stats.latencyMaxSeconds, latencyMaxSeconds);
+	m_stats.applySeconds += applySeconds;
+	m_stats.applyMaxSeconds = std::max(m_stats.applyMaxSeconds, applySeconds);
+	return(applied);
+}
+
+/***********************************************************
+ *  ApplyEdit()
+ *
+ *  This method is used for applying one edit to the scene.
+ *  A node is found by the first of its tag, so an instance
+ *  added takes a tag no node has, and one removed is put
+ *  back by adding its tag again.
+ ***********************************************************/
+bool LiveEdit::ApplyEdit(SceneManager* pSceneManager, const SCENE_EDIT& edit, std::string& reason)
+{
+	if (edit.type == EDIT_MATERIAL)
+	{
+		if (pSceneManager->SetMaterialParameter(edit.target, edit.name, edit.values, edit.valueCount) == false)
+		{
+			reason = "unknown material or parameter";
+			return(false);
+		}
+		return(true);
+	}
+
+	int nodeID = pSceneManager->FindSceneNode(edit.target);
+	if (edit.type == EDIT_ADD)
+	{
+		if (nodeID >= 0)
+		{
+			if (pSceneManager->IsSceneNodeRemoved(nodeID) == false)
+			{
+				reason = "node exists";
+				return(false);
+			}
+			pSceneManager->SetSceneNodeRemoved(nodeID, false);
+			pSceneManager->SetSceneNodeTransform(nodeID, edit.scaleXYZ, edit.rotationDegreesXYZ, edit.positionXYZ);
+			return(true);
+		}
+		if (pSceneManager->AddPrefabInstance(edit.name, edit.target,
+			edit.scaleXYZ, edit.rotationDegreesXYZ, edit.positionXYZ) < 0)
+		{
+			reason = "prefab not in the scene";
+			return(false);
+		}
+		return(true);
+	}
+
+	if (nodeID < 0)
+	{
+		reason = "unknown node";
+		return(false);
+	}
+	bool bApplied = false;
+	switch (edit.type)
+	{
+	case EDIT_TRANSFORM:
+		bApplied = pSceneManager->SetSceneNodeTransform(nodeID, edit.scaleXYZ, edit.rotationDegreesXYZ,
+			edit.positionXYZ);
+		break;
+	case EDIT_COLOR:
+		bApplied = pSceneManager->SetSceneNodeColor(nodeID,
+			glm::vec4(edit.values[0], edit.values[1], edit.values[2], edit.values[3]));
+		break;
+	case EDIT_REMOVE:
+		bApplied = pSceneManager->SetSceneNodeRemoved(nodeID, true);
+		break;
+	default:
+		break;
+	}
+	if (bApplied == false)
+	{
+		// the static draws are merged into the bake of the scene
+		reason = "node has no movable draws";
+	}
+	return(bApplied);
+}
+
+/***********************************************************
+ *  ReceiveLoop()
+ *
+ *  This method is used for taking the clients on the port
+ *  and reading their lines, which may arrive split
+ *  anywhere, until the service stops. A client sending a
+ *  line longer than any edit is dropped.
+ ***********************************************************/
+void LiveEdit::ReceiveLoop()
+{
+	ScopeProfiler::SetThreadName("live edit");
+	std::vector<uintptr_t> sockets;
+	std::vector<bool> readable;
+	char buffer[4096];
+	while (m_bStopping.load() == false)
+	{
+		sockets.assign(1, m_listenSocket);
+		for (size_t i = 0; i < m_clients.size(); i++)
+		{
+			sockets.push_back(m_clients[i].socketHandle);
+		}
+		if (NetSocket::WaitReadable(sockets, POLL_MICROSECONDS, readable) == false)
+		{
+			continue;
+		}
+
+		// from the last, so a client closed does not move the ones
+		// still to be read
+		for (size_t i = m_clients.size(); i > 0; i--)
+		{
+			size_t index = i - 1;
+			if (readable[i] == false)
+			{
+				continue;
+			}
+			int bytes = NetSocket::Receive(m_clients[index].socketHandle, buffer, sizeof(buffer));
+			if (bytes <= 0)
+			{
+				CloseClient(index);
+				continue;
+			}
+			std::string& received = m_clients[index].received;
+			received.append(buffer, bytes);
+			size_t lineEnd = received.find('\n');
+			while (lineEnd != std::string::npos)
+			{
+				std::string line = received.substr(0, lineEnd);
+				received.erase(0, lineEnd + 1);
+				HandleLine(m_clients[index], line);
+				lineEnd = received.find('\n');
+			}
+			if (received.size() > MAX_LINE_BYTES)
+			{
+				CloseClient(index);
+			}
+		}
+
+		if (readable[0] == true)
+		{
+			uintptr_t clientSocket = NetSocket::Accept(m_listenSocket);
+			if (clientSocket != NO_SOCKET)
+			{
+				CLIENT client;
+				client.id = m_nextClientId++;
+				client.socketHandle = clientSocket;
+				client.lineCount = 0;
+				m_clients.push_back(client);
+				{
+					std::lock_guard<std::mutex> lock(m_sendMutex);
+					m_clientSockets[client.id] = clientSocket;
+				}
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_stats.clients++;
+			}
+		}
+	}
+}
+
+/***********************************************************
+ *  HandleLine()
+ *
+ *  This method is used for queuing an edit, answering with
+ *  the counters, and refusing at once what cannot be
+ *  applied. Every line but an empty one counts, so the
+ *  answers name the lines the editor sent.
+ ***********************************************************/
+void LiveEdit::HandleLine(CLIENT& client, const std::string& line)
+{
+	std::string command;
+	std::istringstream words(line);
+	words >> command;
+	if (command.empty() == true)
+	{
+		return;
+	}
+	client.lineCount++;
+
+	char reply[512];
+	if (command == "stats")
+	{
+		EDIT_STATS stats = GetStats();
+		snprintf(reply, sizeof(reply), "stats %llu %llu %llu %llu %.3f %.3f\n",
+			stats.received, stats.applied, stats.rejected, stats.frames,
+			(stats.applied > 0) ? stats.latencySeconds * 1000.0 / stats.applied : 0.0,
+			stats.latencyMaxSeconds * 1000.0);
+		SendToClient(client.id, reply);
+		return;
+	}
+
+	SCENE_EDIT edit;
+	std::string reason;
+	bool bQueued = false;
+	if (ParseEdit(line, edit, reason) == true)
+	{
+		edit.clientId = client.id;
+		edit.line = client.lineCount;
+		edit.receivedTime = NowSeconds();
+		std::lock_guard<std::mutex> lock(m_mutex);
+		bQueued = (m_pending.size() < MAX_PENDING_EDITS);
+		if (bQueued == true)
+		{
+			m_pending.push_back(edit);
+			m_stats.received++;
+		}
+		else
+		{
+			reason = "too many edits waiting";
+			m_stats.rejected++;
+		}
+	}
+	else
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stats.rejected++;
+	}
+
+	if (bQueued == false)
+	{
+		snprintf(reply, sizeof(reply), "error %u %s\n", client.lineCount, reason.c_str());
+		SendToClient(client.id, reply);
+	}
+}
+
+/***********************************************************
+ *  ParseEdit()
+ *
+ *  This method is used for reading the fields of an edit
+ *  line.
+ ***********************************************************/
+bool LiveEdit::ParseEdit(const std::string& line, SCENE_EDIT& edit, std::string& reason) const
+{
+	std::istringstream words(line);
+	std::string command;
+	words >> command;
+	edit.valueCount = 0;
+	memset(edit.values, 0, sizeof(edit.values));
+	edit.scaleXYZ = glm::vec3(1.0f, 1.0f, 1.0f);
+	edit.rotationDegreesXYZ = glm::vec3(0.0f, 0.0f, 0.0f);
+	edit.positionXYZ = glm::vec3(0.0f, 0.0f, 0.0f);
+
+	if ((command == "transform") || (command == "add"))
+	{
+		edit.type = (command == "add") ? EDIT_ADD : EDIT_TRANSFORM;
+		if (edit.type == EDIT_ADD)
+		{
+			words >> edit.name;
+		}
+		words >> edit.target
+			>> edit.scaleXYZ.x >> edit.scaleXYZ.y >> edit.scaleXYZ.z
+			>> edit.rotationDegreesXYZ.x >> edit.rotationDegreesXYZ.y >> edit.rotationDegreesXYZ.z
+			>> edit.positionXYZ.x >> edit.positionXYZ.y >> edit.positionXYZ.z;
+	}
+	else if (command == "color")
+	{
+		edit.type = EDIT_COLOR;
+		words >> edit.target >> edit.values[0] >> edit.values[1] >> edit.values[2] >> edit.values[3];
+		edit.valueCount = 4;
+	}
+	else if (command == "material")
+	{
+		edit.type = EDIT_MATERIAL;
+		words >> edit.target >> edit.name;
+		while ((edit.valueCount < 4) && (words >> edit.values[edit.valueCount]))
+		{
+			edit.valueCount++;
+		}
+		if (edit.valueCount == 0)
+		{
+			reason = "malformed edit";
+			return(false);
+		}
+		return(true);
+	}
+	else if (command == "remove")
+	{
+		edit.type = EDIT_REMOVE;
+		words >> edit.target;
+	}
+	else
+	{
+		reason = "unknown command " + command;
+		return(false);
+	}
+
+	if (words.fail() == true)
+	{
+		reason = "malformed edit";
+		return(false);
+	}
+	return(true);
+}
+
+/***********************************************************
+ *  SendToClient()
+ *
+ *  This method is used for sending a line to a client
+ *  still connected. A failed send shuts the connection
+ *  down, which ends the reading of the thread, which then
+ *  closes it.
+ ***********************************************************/
+bool LiveEdit::SendToClient(uint32_t clientId, const std::string& line)
+{
+	std::lock_guard<std::mutex> lock(m_sendMutex);
+	std::map<uint32_t, uintptr_t>::iterator found = m_clientSockets.find(clientId);
+	if (found == m_clientSockets.end())
+	{
+		return(false);
+	}
+	bool bSent = NetSocket::SendAll(found->second, line.data(), line.size());
+	if (bSent == false)
+	{
+		NetSocket::Shutdown(found->second);
+	}
+	return(bSent);
+}
+
+/***********************************************************
+ *  CloseClient()
+ *
+ *  This method is used for closing the connection of a
+ *  client. Its edits still waiting are applied all the
+ *  same, since the editor sent them, with nobody to answer.
+ ***********************************************************/
+void LiveEdit::CloseClient(size_t index)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_sendMutex);
+		m_clientSockets.erase(m_clients[index].id);
+		NetSocket::Close(m_clients[index].socketHandle);
+	}
+	m_clients.erase(m_clients.begin() + index);
+}
+
+/***********************************************************
+ *  GetStats()
+ *
+ *  This method is used for getting a copy of the counters,
+ *  which the threads keep updating.
+ ***********************************************************/
+LiveEdit::EDIT_STATS LiveEdit::GetStats() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return(m_stats);
+}
+
+/***********************************************************
+ *  PrintStats()
+ *
+ *  This method is used for printing the edits applied and
+ *  their mean and longest times.
+ ***********************************************************/
+void LiveEdit::PrintStats() const
+{
+	EDIT_STATS stats = GetStats();
+	std::cout << "\n*** LIVE EDIT: ***\n";
+	std::cout << "clients " << stats.clients
+		<< "\treceived " << stats.received
+		<< "\tapplied " << stats.applied
+		<< "\trejected " << stats.rejected
+		<< "\tframes " << stats.frames << "\n";
+	if ((stats.applied > 0) && (stats.frames > 0))
+	{
+		std::cout << "latency mean " << (stats.latencySeconds * 1000.0 / stats.applied) << " ms"
+			<< "\tmax " << (stats.latencyMaxSeconds * 1000.0) << " ms"
+			<< "\tapply per frame mean " << (stats.applySeconds * 1000.0 / stats.frames) << " ms"
+			<< "\tmax " << (stats.applyMaxSeconds * 1000.0) << " ms\n";
+	}
+}
@@ -0,0 +1,153 @@
+///////////////////////////////////////////////////////////////////////////////
+// liveedit.h
+// ============
+// scene edits taken over a local socket and applied between frames
+//
+//  An editor connected to a TCP port of the loopback interface sends
+//  small edits of the running scene a line each, which a thread reads
+//  and queues; the main loop applies the queued ones before it builds
+//  the next frame, through the incremental paths of the scene manager,
+//  so an edit never reloads the scene. Every edit is answered once it
+//  was applied, with ok or error and the line number of the client,
+//  and the time from receiving it to applying it is kept.
+//
+//  The edit lines are
+//    transform <node> <sx> <sy> <sz> <rx> <ry> <rz> <px> <py> <pz>
+//    color <node> <r> <g> <b> <a>
+//    material <material> <parameter> <value> [<value> <value>]
+//    add <prefab> <node> <sx> <sy> <sz> <rx> <ry> <rz> <px> <py> <pz>
+//    remove <node>
+//  with the nodes and materials named by their tags and the rotation
+//  in degrees. A parameter is a field of the material, such as
+//  diffuseColor or shininess. add puts back a removed instance of the
+//  tag where given, or else places a new movable instance of a prefab
+//  the scene placed. The line stats is answered with the counters.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class SceneManager;
+
+/***********************************************************
+ *  LiveEdit
+ *
+ *  This class contains the listening socket, the connected
+ *  editors and the thread reading their edits, and the
+ *  queue of the edits not applied yet. The main loop calls
+ *  ApplyEdits() once per frame, on the GL thread, before
+ *  the scene is updated.
+ ***********************************************************/
+class LiveEdit
+{
+public:
+	// constructor
+	LiveEdit();
+	// destructor
+	~LiveEdit();
+
+	// what an edit changes
+	enum EDIT_TYPE
+	{
+		EDIT_TRANSFORM = 0,
+		EDIT_COLOR,
+		EDIT_MATERIAL,
+		EDIT_ADD,
+		EDIT_REMOVE
+	};
+
+	// an edit taken from a client
+	struct SCENE_EDIT
+	{
+		uint32_t clientId;
+		uint32_t line;			// line number of the client, echoed back
+		int type;				// an EDIT_TYPE
+		std::string target;		// node or material tag
+		std::string name;		// material parameter or prefab name
+		glm::vec3 scaleXYZ;
+		glm::vec3 rotationDegreesXYZ;
+		glm::vec3 positionXYZ;
+		float values[4];		// color or parameter values
+		int valueCount;
+		double receivedTime;
+	};
+
+	// edits applied and their times
+	struct EDIT_STATS
+	{
+		unsigned long long clients;
+		unsigned long long received;
+		unsigned long long applied;
+		unsigned long long rejected;
+		unsigned long long frames;		// frames that applied an edit
+		// from receiving an edit to applying it, of the applied ones
+		double latencySeconds;
+		double latencyMaxSeconds;
+		// spent applying the edits of a frame
+		double applySeconds;
+		double applyMaxSeconds;
+	};
+
+	// listen on a TCP port of the loopback interface for edits; false
+	// when the port could not be opened
+	bool Start(int port);
+	// close the clients and the port, and end the thread
+	void Stop();
+
+	// apply the edits waiting, at most a frame's worth, to the scene
+	// and answer them; returns the number applied
+	int ApplyEdits(SceneManager* pSceneManager);
+
+	EDIT_STATS GetStats() const;
+	void PrintStats() const;
+
+private:
+	// a connected client, the part of a line it sent so far and the
+	// lines it sent
+	struct CLIENT
+	{
+		uint32_t id;
+		uintptr_t socketHandle;
+		std::string received;
+		uint32_t lineCount;
+	};
+
+	uintptr_t m_listenSocket;
+	std::atomic<bool> m_bStopping;
+	std::thread m_receiveThread;
+	// clients, read by the thread only
+	std::vector<CLIENT> m_clients;
+	uint32_t m_nextClientId;
+
+	// edits waiting and the counters, guarded by m_mutex
+	mutable std::mutex m_mutex;
+	std::deque<SCENE_EDIT> m_pending;
+	EDIT_STATS m_stats;
+
+	// sockets of the connected clients by id, for the answers from
+	// the main loop, guarded by m_sendMutex
+	std::mutex m_sendMutex;
+	std::map<uint32_t, uintptr_t> m_clientSockets;
+
+	// accept the clients and read their lines until stopped
+	void ReceiveLoop();
+	// act on one line of a client
+	void HandleLine(CLIENT& client, const std::string& line);
+	// parse an edit line; false, with the reason, for a malformed one
+	bool ParseEdit(const std::string& line, SCENE_EDIT& edit, std::string& reason) const;
+	// apply one edit; false, with the reason, when it could not be
+	bool ApplyEdit(SceneManager* pSceneManager, const SCENE_EDIT& edit, std::string& reason);
+	// send a line to a client still connected
+	bool SendToClient(uint32_t clientId, const std::string& line);
+	void CloseClient(size_t index);
+};
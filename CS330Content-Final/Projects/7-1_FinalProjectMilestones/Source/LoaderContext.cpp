@@ -0,0 +1,235 @@
+///////////////////////////////////////////////////////////////////////////////
+// loadercontext.cpp
+// ============
+// second GL context creating the scene resources on a loader thread
+//
+//  Creating a texture, copying its pixels and building its mipmaps on
+//  the rendering context takes the time of the frame it happens in. A
+//  hidden window sharing the objects of the main context carries a
+//  second context, current on a loader thread of its own, which runs
+//  those uploads instead. Each task ends with a fence; once the fence
+//  passed, the objects the task created are complete and the main
+//  context may draw with them.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "LoaderContext.h"
+#include "ScopeProfiler.h"
+
+#include <iostream>
+
+/***********************************************************
+ *  LoaderContext()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+LoaderContext::LoaderContext()
+{
+	m_pWindow = NULL;
+	m_bRunningTask = false;
+	m_bStopping = false;
+	m_nextID = 1;
+	m_stats.tasks = 0;
+	m_stats.busySeconds = 0.0;
+}
+
+/***********************************************************
+ *  ~LoaderContext()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+LoaderContext::~LoaderContext()
+{
+	Destroy();
+}
+
+/***********************************************************
+ *  Create()
+ *
+ *  This method is used for creating the hidden window whose
+ *  context shares the textures, buffers and fences of the
+ *  window given, and starting the loader thread, which makes
+ *  the new context current on itself. The context is made
+ *  with the hints of the main window, so both are of the
+ *  same version and profile.
+ ***********************************************************/
+bool LoaderContext::Create(GLFWwindow* pShareWindow)
+{
+	if (NULL != m_pWindow)
+	{
+		return(true);
+	}
+
+	glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+	m_pWindow = glfwCreateWindow(1, 1, "loader", NULL, pShareWindow);
+	glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
+	if (NULL == m_pWindow)
+	{
+		std::cout << "Could not create the shared loader context, resources are uploaded on the rendering context" << std::endl;
+		return(false);
+	}
+
+	m_bStopping = false;
+	m_thread = std::thread(&LoaderContext::LoaderLoop, this);
+	return(true);
+}
+
+/***********************************************************
+ *  Destroy()
+ *
+ *  This method is used for ending the loader thread once the
+ *  task it runs returns, dropping the queued ones, and
+ *  deleting the fences not polled and the hidden window.
+ *  Like Create(), it is called on the main thread.
+ ***********************************************************/
+void LoaderContext::Destroy()
+{
+	if (NULL == m_pWindow)
+	{
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_bStopping = true;
+		m_tasks.clear();
+	}
+	m_taskQueued.notify_all();
+	m_taskRan.notify_all();
+	if (m_thread.joinable() == true)
+	{
+		m_thread.join();
+	}
+
+	for (size_t i = 0; i < m_ranTasks.size(); i++)
+	{
+		glDeleteSync(m_ranTasks[i].fence);
+	}
+	m_ranTasks.clear();
+	for (size_t i = 0; i < m_pendingFences.size(); i++)
+	{
+		glDeleteSync(m_pendingFences[i].fence);
+	}
+	m_pendingFences.clear();
+
+	glfwDestroyWindow(m_pWindow);
+	m_pWindow = NULL;
+}
+
+/***********************************************************
+ *  Submit()
+ *
+ *  This method is used for queueing a task for the loader
+ *  thread and giving out the id it is reported by.
+ ***********************************************************/
+unsigned long long LoaderContext::Submit(const std::function<void()>& task)
+{
+	LOADER_TASK queued;
+	queued.task = task;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		queued.id = m_nextID++;
+		m_tasks.push_back(queued);
+	}
+	m_taskQueued.notify_one();
+
+	return(queued.id);
+}
+
+/***********************************************************
+ *  Poll()
+ *
+ *  This method is used for checking the fences of the tasks
+ *  that ran, without waiting on any. The fence objects are
+ *  shared with the main context, so they are tested and
+ *  deleted on it; a task is reported once its fence passed,
+ *  in the order the tasks were submitted.
+ ***********************************************************/
+void LoaderContext::Poll(std::vector<unsigned long long>& finished)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_pendingFences.insert(m_pendingFences.end(), m_ranTasks.begin(), m_ranTasks.end());
+		m_ranTasks.clear();
+	}
+
+	size_t kept = 0;
+	for (size_t i = 0; i < m_pendingFences.size(); i++)
+	{
+		RAN_TASK& ran = m_pendingFences[i];
+		if ((0 != ran.fence) && (glClientWaitSync(ran.fence, 0, 0) == GL_TIMEOUT_EXPIRED))
+		{
+			m_pendingFences[kept++] = ran;
+			continue;
+		}
+		if (0 != ran.fence)
+		{
+			glDeleteSync(ran.fence);
+		}
+		finished.push_back(ran.id);
+	}
+	m_pendingFences.resize(kept);
+}
+
+/***********************************************************
+ *  WaitForTasks()
+ *
+ *  This method is used for waiting until the queue is empty
+ *  and no task runs, so none still writes into an object
+ *  the caller is about to delete.
+ ***********************************************************/
+void LoaderContext::WaitForTasks()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_taskRan.wait(lock, [this]() {
+		return((m_bStopping == true) || ((m_tasks.empty() == true) && (m_bRunningTask == false)));
+	});
+}
+
+/***********************************************************
+ *  LoaderLoop()
+ *
+ *  This method is used for running the queued tasks with
+ *  the loader context current. A fence follows the commands
+ *  of every task, flushed so the main context can see it
+ *  pass, since a fence never sent to the GPU never signals.
+ ***********************************************************/
+void LoaderContext::LoaderLoop()
+{
+	glfwMakeContextCurrent(m_pWindow);
+	ScopeProfiler::SetThreadName("loader context");
+
+	for (;;)
+	{
+		LOADER_TASK queued;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_taskQueued.wait(lock, [this]() { return((m_bStopping == true) || (m_tasks.empty() == false)); });
+			if (m_bStopping == true)
+			{
+				break;
+			}
+			queued = m_tasks.front();
+			m_tasks.pop_front();
+			m_bRunningTask = true;
+		}
+
+		double startTime = glfwGetTime();
+		queued.task();
+		RAN_TASK ran;
+		ran.id = queued.id;
+		ran.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		glFlush();
+		double taskSeconds = glfwGetTime() - startTime;
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_ranTasks.push_back(ran);
+			m_bRunningTask = false;
+			m_stats.tasks++;
+			m_stats.busySeconds += taskSeconds;
+		}
+		m_taskRan.notify_all();
+	}
+
+	glfwMakeContextCurrent(NULL);
+}
@@ -0,0 +1,103 @@
+///////////////////////////////////////////////////////////////////////////////
+// loadercontext.h
+// ============
+// second GL context creating the scene resources on a loader thread
+//
+//  Creating a texture, copying its pixels and building its mipmaps on
+//  the rendering context takes the time of the frame it happens in. A
+//  hidden window sharing the objects of the main context carries a
+//  second context, current on a loader thread of its own, which runs
+//  those uploads instead. Each task ends with a fence; once the fence
+//  passed, the objects the task created are complete and the main
+//  context may draw with them.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+#include "GLFW/glfw3.h"
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/***********************************************************
+ *  LoaderContext
+ *
+ *  This class contains the shared context, the thread it is
+ *  current on and the queue of upload tasks. Submit() hands
+ *  a task to the thread and Poll(), on the thread of the
+ *  main context, reports the tasks whose GPU work finished.
+ ***********************************************************/
+class LoaderContext
+{
+public:
+	// constructor
+	LoaderContext();
+	// destructor
+	~LoaderContext();
+
+	// tasks run and the time the loader thread spent on them
+	struct LOADER_STATS
+	{
+		unsigned long long tasks;
+		double busySeconds;
+	};
+
+	// create the context sharing the objects of the window and start
+	// the loader thread; GLFW creates windows on the main thread only,
+	// so this is called there, with the context of the window current
+	bool Create(GLFWwindow* pShareWindow);
+	// drop the tasks not started, end the thread and free the context
+	void Destroy();
+	// true once Create() succeeded
+	bool IsAvailable() const { return(NULL != m_pWindow); }
+
+	// queue a task to run with the loader context current; returns
+	// the id Poll() reports it by once its GPU work finished
+	unsigned long long Submit(const std::function<void()>& task);
+	// add the ids of the tasks whose fence passed to finished,
+	// without waiting for the others
+	void Poll(std::vector<unsigned long long>& finished);
+	// wait until every submitted task ran, so the objects they
+	// created may be deleted
+	void WaitForTasks();
+
+	const LOADER_STATS& GetStats() const { return(m_stats); }
+
+private:
+	// a queued task and its id
+	struct LOADER_TASK
+	{
+		unsigned long long id;
+		std::function<void()> task;
+	};
+	// a task that ran, and the fence after its commands
+	struct RAN_TASK
+	{
+		unsigned long long id;
+		GLsync fence;
+	};
+
+	GLFWwindow* m_pWindow;
+	std::thread m_thread;
+	// tasks not started and tasks ran but not polled, guarded by
+	// m_mutex
+	std::deque<LOADER_TASK> m_tasks;
+	std::vector<RAN_TASK> m_ranTasks;
+	bool m_bRunningTask;
+	bool m_bStopping;
+	unsigned long long m_nextID;
+	std::mutex m_mutex;
+	std::condition_variable m_taskQueued;
+	std::condition_variable m_taskRan;
+	// fences Poll() found still pending, read on the main context only
+	std::vector<RAN_TASK> m_pendingFences;
+	LOADER_STATS m_stats;
+
+	// body of the loader thread
+	void LoaderLoop();
+};
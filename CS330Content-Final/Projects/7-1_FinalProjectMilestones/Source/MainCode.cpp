@@ -1,5 +1,11 @@
 #include <iostream>         // error handling and output
-#include <cstdlib>          // EXIT_FAILURE
+#include <cstdlib>          // EXIT_FAILURE, EXIT_SUCCESS, atoi, atof, strtoull
+#include <cstring>          // strcmp, memcpy
+#include <cstdio>           // sscanf, snprintf
+#include <future>           // std::async
+#include <thread>           // std::thread::hardware_concurrency, sleep_for
+#include <chrono>           // std::chrono::milliseconds
+#include <ctime>            // time, strftime
 
 #include <GL/glew.h>        // GLEW library
 #include "GLFW/glfw3.h"     // GLFW library
@@ -13,12 +19,98 @@
 #include "ViewManager.h"
 #include "ShapeMeshes.h"
 #include "ShaderManager.h"
+#include "ModelTransforms.h"
+#include "SceneFile.h"
+#include "UploadRing.h"
+#include "RenderTarget.h"
+#include "FramePacer.h"
+#include "StereoTarget.h"
+#include "RenderThread.h"
+#include "JobSystem.h"
+#include "FrameCapture.h"
+#include "FrameStreamer.h"
+#include "RenderService.h"
+#include "MetricsExporter.h"
+#include "LiveEdit.h"
+#include "HitchCapture.h"
+#include "BatchCoordinator.h"
+#include "BatchWorker.h"
+#include "WallSync.h"
+#include "LoaderContext.h"
+#include "StartupTimer.h"
+#include "GPUProfiler.h"
+#include "QualityGovernor.h"
+#include "PowerPolicy.h"
+#include "FrameArena.h"
+#include "ResourceManager.h"
+#include "StatsOverlay.h"
+#include "ScopeProfiler.h"
+#include "RenderCounters.h"
+#include "GLDebug.h"
+#include "GLLoader.h"
+#include "GPUMemory.h"
+#include "GPUBuffer.h"
+#include "AssetPack.h"
+#include "FileWatcher.h"
+#include "GLTrace.h"
+#include "GLTraceReplay.h"
+#include "BenchmarkRun.h"
+#include "StressScene.h"
+#include "CompressedTexture.h"
+#include "Microbenchmarks.h"
+#include "ImageDiff.h"
+#include "LightClusters.h"
+#include "Logger.h"
 
 // Namespace for declaring global variables
 namespace
 {
 	// Macro for window title
 	const char* const WINDOW_TITLE = "7-1 FinalProject and Milestones"; 
+	// scene description loaded when --scene names no other
+	const char* const DEFAULT_SCENE_PATH = "../../Utilities/scenes/kitchen.scene";
+	// sources of the scene shader permutations
+	const char* const SCENE_VERTEX_SHADER_PATH = "../../Utilities/shaders/vertexShader.glsl";
+	const char* const SCENE_FRAGMENT_SHADER_PATH = "../../Utilities/shaders/fragmentShader.glsl";
+
+	// longest wait for events while rendering on demand, which bounds
+	// how late a reloaded shader shows up, and the wait while shader
+	// programs are still compiling
+	const double IDLE_WAIT_SECONDS = 0.25;
+	const double PENDING_PROGRAMS_WAIT_SECONDS = 1.0 / 60.0;
+	// wait of the render service between polls of the readbacks
+	// its answers wait for
+	const double SERVICE_POLL_SECONDS = 0.001;
+	// frames rendered after the last change; the occlusion culling tests
+	// against the depth of the previous frame, so the one after the
+	// change shows what the change uncovered
+	const int SETTLE_FRAMES = 2;
+	// frames after a change of the anti-aliasing mode before the
+	// smoothed GPU frame time is counted against the new mode
+	const int ANTI_ALIASING_SETTLE_FRAMES = 30;
+	// starting size of each frame region of the upload ring, grown
+	// when a scene needs more
+	const GLsizeiptr UPLOAD_RING_FRAME_BYTES = 256 * 1024;
+	// share of the frame time waited on upload fences above which the
+	// frames are reported as GPU bound
+	const double GPU_BOUND_STALL_FRACTION = 0.1;
+	// frames a headless run renders when --headless-frames and a
+	// played back camera path do not end it sooner
+	const unsigned long long DEFAULT_HEADLESS_FRAMES = 300;
+	// frame size of a batch render when --headless gives none
+	const int DEFAULT_BATCH_WIDTH = 1024;
+	const int DEFAULT_BATCH_HEIGHT = 1024;
+	// shaders of the stats overlay text
+	const char* const OVERLAY_VERTEX_SHADER_PATH = "../../Utilities/shaders/overlayTextVertex.glsl";
+	const char* const OVERLAY_FRAGMENT_SHADER_PATH = "../../Utilities/shaders/overlayTextFragment.glsl";
+	// conversion of the streamed frames to NV12 for the video encoder
+	const char* const VIDEO_FRAME_SHADER_PATH = "../../Utilities/shaders/videoFrameCompute.glsl";
+	// weight of the newest frame in the smoothed overlay frame times
+	const double OVERLAY_SMOOTHING = 0.1;
+	// LOD levels the quality governor may push the meshes coarser by,
+	// and the render scale each of its steps takes off
+	const int GOVERNOR_LOD_LEVELS = 2;
+	const float GOVERNOR_RENDER_SCALE_STEP = 0.125f;
 
 	// Main GLFW window
 	GLFWwindow* g_Window = nullptr;
@@ -29,12 +121,126 @@ namespace
 	ShaderManager* g_ShaderManager = nullptr;
 	// view manager object for managing the 3D view setup and projection to 2D
 	ViewManager* g_ViewManager = nullptr;
+	// ring buffer every per-frame upload is written through
+	UploadRing* g_UploadRing = nullptr;
+	// offscreen target the frame is drawn into at the render scale
+	RenderTarget* g_RenderTarget = nullptr;
+	// presentation mode and frame rate limiter of the window
+	FramePacer* g_FramePacer = nullptr;
+	// two layer target of the stereo frames, both eyes drawn at once
+	StereoTarget* g_StereoTarget = nullptr;
+	// worker threads the scene update, culling and sorting share
+	JobSystem* g_JobSystem = nullptr;
+	// readback and encoding of the saved frames
+	FrameCapture* g_FrameCapture = nullptr;
+	// frames sent to a remote viewer and its input taken back,
+	// with --stream
+	FrameStreamer* g_FrameStreamer = nullptr;
+	// render requests of local clients, with --render-service
+	RenderService* g_RenderService = nullptr;
+	// frame statistics served to a metrics scraper, with --metrics
+	MetricsExporter* g_MetricsExporter = nullptr;
+	// scene edits of a local editor, with --live-edit
+	LiveEdit* g_LiveEdit = nullptr;
+	// trace of the seconds before a frame over budget, with
+	// --hitch-capture
+	HitchCapture* g_HitchCapture = nullptr;
+	// connection to the coordinator of a shared batch, with
+	// --batch-worker
+	BatchWorker* g_BatchWorker = nullptr;
+	// frame lock of the nodes of a video wall, with --wall-master
+	// or --wall-node
+	WallSync* g_WallSync = nullptr;
+	// shared context the scene textures are uploaded on
+	LoaderContext* g_LoaderContext = nullptr;
+	// owner of the meshes, textures and programs of the scene, which
+	// reports those never released on exit
+	ResourceManager* g_ResourceManager = nullptr;
+	// GPU and CPU time of the render passes, while the overlay shows
+	// or the quality governor weighs them
+	GPUProfiler* g_GPUProfiler = nullptr;
+	// the settings traded for a frame time target, with
+	// --governor-frame-ms, the render scale and shadow cascades they
+	// are traded from, and where the decisions are written on exit
+	QualityGovernor* g_QualityGovernor = nullptr;
+	float g_governorRenderScale = 1.0f;
+	int g_governorShadowCascades = CascadedShadows::DEFAULT_CASCADE_COUNT;
+	int g_governorCascadeSize = CascadedShadows::DEFAULT_CASCADE_SIZE;
+	const char* g_governorLogFile = NULL;
+	// limits on the frames following the power source and the heat,
+	// with --power-policy, and the frame cap and render scale asked
+	// for that its tiers lower
+	PowerPolicy* g_PowerPolicy = nullptr;
+	double g_powerFrameCap = 0.0;
+	float g_powerRenderScale = 1.0f;
+	// polls the shader files with --watch-shaders, and the image and
+	// model files with --watch-assets, so they reload once saved
+	FileWatcher* g_FileWatcher = nullptr;
+	// pass timings and counters drawn over the frame, toggled with F3
+	StatsOverlay* g_StatsOverlay = nullptr;
+	// draws, state changes and uploads of each frame, and budgets
+	RenderCounters* g_RenderCounters = nullptr;
+	// frame time percentiles along a camera path, with --benchmark
+	BenchmarkRun* g_Benchmark = nullptr;
+	// smoothed frame interval and CPU time of the overlay
+	double g_overlayFrameTime = -1.0;
+	// snapshot of the cache artifacts beside the scene, with
+	// --warm-start, rewritten after a load that changed them
+	std::string g_warmStartPath;
+	double g_overlayIntervalSeconds = 0.0;
+	double g_overlayCPUSeconds = 0.0;
+	// stages of the startup, timed from the launch, and those that
+	// end once the first frames are drawn
+	StartupTimer g_StartupTimer;
+	int g_firstFrameStage = -1;
+	int g_shaderCompileStage = -1;
+	int g_sceneStreamingStage = -1;
+	// draw the pipelines of the scene once before they show, off
+	// with --no-pipeline-warm-up, again after every load or compile:
+	// 2 while they run, 1 for the frame that lists their draws, and
+	// 0 once warmed up
+	bool g_bPipelineWarmUp = true;
+	int g_warmUpDue = 2;
+	// where the saved frames go, their format, png or tga, and the
+	// screenshots and video frames saved so far
+	const char* g_captureDirectory = ".";
+	const char* g_captureFormat = "png";
+	unsigned long long g_screenshots = 0;
+	unsigned long long g_videoFrames = 0;
+
+	// frames rendered and frames skipped as unchanged, written by the
+	// thread rendering them
+	unsigned long long g_framesRendered = 0;
+	unsigned long long g_framesSkipped = 0;
+	int g_settleFrames = SETTLE_FRAMES;
+	// shader programs compiling at the last frame
+	int g_lastPendingPrograms = -1;
+	// time of the first frame drawn, which the clips play from,
+	// negative before it
+	double g_animationStartTime = -1.0;
+	// GPU frame time summed over the frames drawn with each
+	// anti-aliasing mode, and the mode of the last frame
+	double g_antiAliasingMilliseconds[PostStack::AA_COUNT] = {};
+	unsigned long long g_antiAliasingFrames[PostStack::AA_COUNT] = {};
+	int g_lastAntiAliasing = -1;
+	int g_antiAliasingSettle = 0;
 }
 
 // Function declarations - all functions that are called manually
 // need to be pre-declared at the beginning of the source code.
 bool InitializeGLFW();
 bool InitializeGLEW();
+bool RenderFramePacket(ViewManager::FRAME_PACKET& packet, bool bLateLatch);
+void CaptureFrame(const ViewManager::FRAME_PACKET& packet);
+void TimeStartupFrame();
+void JitterMainView(ViewManager::FRAME_PACKET& packet);
+void CountAntiAliasingCost(int antiAliasing);
+void ApplyQualityGovernor(int& antiAliasing, int& shadowQuality);
+void UpdateQualityGovernor(double cpuSeconds);
+void UpdatePowerPolicy();
+void ApplyPowerPolicy(int& antiAliasing, int& shadowQuality);
+void DrawStatsOverlay(const ViewManager::FRAME_PACKET& packet, double frameStartTime);
+void RenderLoop(RenderThread* pThread);
 
 
 /***********************************************************
@@ -45,11 +251,344 @@ bool InitializeGLEW();
  ***********************************************************/
 int main(int argc, char* argv[])
 {
+	// time the model matrix composition against the matrix products
+	// it replaced and the aligned world products against the packed
+	// ones, checking they agree, without opening a window
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--benchmark-transforms") == 0)
+		{
+			int count = (i + 1 < argc) ? atoi(argv[i + 1]) : 0;
+			BenchmarkModelTransforms((count > 0) ? count : 10000, 100);
+			return(EXIT_SUCCESS);
+		}
+		// compile a text scene description into the binary form that
+		// is memory-mapped at load time
+		if ((strcmp(argv[i], "--compile-scene") == 0) && (i + 2 < argc))
+		{
+			SceneFile sceneFile;
+			bool bCompiled = sceneFile.LoadText(argv[i + 1]) && sceneFile.SaveBinary(argv[i + 2]);
+			return(bCompiled ? EXIT_SUCCESS : EXIT_FAILURE);
+		}
+		// write a scene of OBJECTS copies of the composite prefabs of
+		// the --scene description, in varied textures and materials,
+		// under LIGHTS point lights, for plotting the frame time
+		// against the object and light counts
+		if ((strcmp(argv[i], "--generate-stress-scene") == 0) && (i + 3 < argc))
+		{
+			StressScene stressScene;
+			stressScene.SetBaseScene(DEFAULT_SCENE_PATH);
+			stressScene.SetObjectCount(atoi(argv[i + 1]));
+			stressScene.SetLightCount(atoi(argv[i + 2]));
+			for (int j = 1; j + 1 < argc; j++)
+			{
+				if (strcmp(argv[j], "--scene") == 0)
+				{
+					stressScene.SetBaseScene(argv[j + 1]);
+				}
+				// grid or random placement of the objects
+				if (strcmp(argv[j], "--stress-layout") == 0)
+				{
+					stressScene.SetLayout((strcmp(argv[j + 1], "random") == 0) ?
+						StressScene::LAYOUT_RANDOM : StressScene::LAYOUT_GRID);
+				}
+				if (strcmp(argv[j], "--stress-seed") == 0)
+				{
+					stressScene.SetSeed((unsigned int)atoi(argv[j + 1]));
+				}
+				if (strcmp(argv[j], "--stress-variants") == 0)
+				{
+					stressScene.SetVariants(atoi(argv[j + 1]));
+				}
+			}
+			return(stressScene.Write(argv[i + 3]) ? EXIT_SUCCESS : EXIT_FAILURE);
+		}
+		// encode JPEG and PNG textures into KTX2 files next to them,
+		// which are loaded instead of the images from then on;
+		// "auto" picks BC3 for images with alpha and BC1 for others
+		if ((strcmp(argv[i], "--compress-textures") == 0) && (i + 2 < argc))
+		{
+			CompressedTexture::FORMAT format = CompressedTexture::FindFormat(argv[i + 1]);
+			if ((format != CompressedTexture::FORMAT_NONE) && (format != CompressedTexture::FORMAT_BC1) &&
+				(format != CompressedTexture::FORMAT_BC3))
+			{
+				std::cout << "Only bc1, bc3 or auto textures can be encoded" << std::endl;
+				return(EXIT_FAILURE);
+			}
+
+			bool bCompressed = true;
+			for (int j = i + 2; j < argc; j++)
+			{
+				std::string imageFilename = argv[j];
+				size_t dot = imageFilename.find_last_of('.');
+				std::string filename = imageFilename.substr(0, dot) + ".ktx2";
+				bCompressed = CompressedTexture::CompressImageFile(imageFilename.c_str(), filename.c_str(), format) && bCompressed;
+			}
+			return(bCompressed ? EXIT_SUCCESS : EXIT_FAILURE);
+		}
+		// tile very large images into .vtex files next to them, which
+		// are opened as virtual textures paged in as they are seen
+		if ((strcmp(argv[i], "--write-virtual-textures") == 0) && (i + 1 < argc))
+		{
+			bool bWritten = true;
+			for (int j = i + 1; j < argc; j++)
+			{
+				bWritten = VirtualTextures::WriteTiledFile(argv[j], VirtualTextures::GetTiledFilename(argv[j]).c_str()) && bWritten;
+			}
+			return(bWritten ? EXIT_SUCCESS : EXIT_FAILURE);
+		}
+		// write the textures, meshes, shaders and scenes under ROOT
+		// into one pack, mounted by --asset-pack, or at the default
+		// path without it
+		if ((strcmp(argv[i], "--build-asset-pack") == 0) && (i + 2 < argc))
+		{
+			return(AssetPack::Build(argv[i + 1], argv[i + 2]) ? EXIT_SUCCESS : EXIT_FAILURE);
+		}
+		// share the poses of a camera path out to the --batch-worker
+		// nodes connecting on a TCP port, in shards of --shard-poses,
+		// and write the images they send back into a directory; the
+		// workers load the scene of --scene, from the pack of
+		// --asset-pack or the default one, at the --headless size
+		if ((strcmp(argv[i], "--batch-coordinator") == 0) && (i + 3 < argc))
+		{
+			const char* coordinatorScene = DEFAULT_SCENE_PATH;
+			const char* coordinatorPack = NULL;
+			int coordinatorWidth = DEFAULT_BATCH_WIDTH;
+			int coordinatorHeight = DEFAULT_BATCH_HEIGHT;
+			int shardPoses = BatchCoordinator::DEFAULT_SHARD_POSES;
+			for (int j = 1; j + 1 < argc; j++)
+			{
+				if (strcmp(argv[j], "--scene") == 0)
+				{
+					coordinatorScene = argv[j + 1];
+				}
+				if (strcmp(argv[j], "--asset-pack") == 0)
+				{
+					coordinatorPack = argv[j + 1];
+				}
+				if (strcmp(argv[j], "--headless") == 0)
+				{
+					sscanf(argv[j + 1], "%dx%d", &coordinatorWidth, &coordinatorHeight);
+				}
+				if (strcmp(argv[j], "--shard-poses") == 0)
+				{
+					shardPoses = atoi(argv[j + 1]);
+				}
+			}
+			if (NULL == coordinatorPack)
+			{
+				FILE* pPackFile = fopen(AssetPack::DEFAULT_PACK_FILE, "rb");
+				if (NULL != pPackFile)
+				{
+					fclose(pPackFile);
+					coordinatorPack = AssetPack::DEFAULT_PACK_FILE;
+				}
+			}
+			BatchCoordinator coordinator;
+			return(coordinator.Run(argv[i + 1], argv[i + 2], atoi(argv[i + 3]), coordinatorScene, coordinatorPack,
+				glm::max(coordinatorWidth, 1), glm::max(coordinatorHeight, 1), shardPoses) ? EXIT_SUCCESS : EXIT_FAILURE);
+		}
+		// compile the scene shaders into the SPIR-V modules that
+		// --spirv-shaders loads, with glslangValidator of the Vulkan
+		// SDK; run again after editing the shaders
+		if (strcmp(argv[i], "--compile-spirv") == 0)
+		{
+			ShaderManager spirvCompiler;
+			return(spirvCompiler.CompileSpirvModules(SCENE_VERTEX_SHADER_PATH, SCENE_FRAGMENT_SHADER_PATH) ?
+				EXIT_SUCCESS : EXIT_FAILURE);
+		}
+		// compare two images, or the frames of two --batch-render
+		// directories, failing when any differs by more than the
+		// bounds in 8 bit levels; e.g. the frames of a path rendered
+		// with --half-precision against the same path without it
+		if ((strcmp(argv[i], "--image-diff") == 0) && (i + 2 < argc))
+		{
+			float maxError = ImageDiff::DEFAULT_MAX_ERROR;
+			float meanError = ImageDiff::DEFAULT_MEAN_ERROR;
+			const char* frameFormat = "png";
+			for (int j = 1; j + 1 < argc; j++)
+			{
+				if (strcmp(argv[j], "--max-error") == 0)
+				{
+					maxError = (float)atof(argv[j + 1]);
+				}
+				if (strcmp(argv[j], "--mean-error") == 0)
+				{
+					meanError = (float)atof(argv[j + 1]);
+				}
+				if (strcmp(argv[j], "--capture-format") == 0)
+				{
+					frameFormat = argv[j + 1];
+				}
+			}
+			return(ImageDiff::CompareWithin(argv[i + 1], argv[i + 2], frameFormat, maxError, meanError) ?
+				EXIT_SUCCESS : EXIT_FAILURE);
+		}
+	}
+
+	// record the marked scopes of every thread into a Chrome trace
+	// written at exit, for profiling without a debugger
+	const char* tracePath = NULL;
+	for (int i = 1; i + 1 < argc; i++)
+	{
+		if (strcmp(argv[i], "--trace") == 0)
+		{
+			tracePath = argv[i + 1];
+		}
+	}
+	ScopeProfiler::SetThreadName("main");
+	ScopeProfiler::SetEnabled(tracePath != NULL);
+
+	// write the messages from a thread of their own, so a warning of
+	// the render loop costs no console write; --verbose adds the
+	// debug messages of a build that has them
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--verbose") == 0)
+		{
+			Logger::SetMinSeverity(Logger::SEVERITY_DEBUG);
+		}
+	}
+	Logger::Start();
+
+	// render the shards of a --batch-coordinator at host:port, which
+	// names the scene, the frame size and the asset pack; the pack is
+	// fetched into --worker-cache unless an earlier run left it there
+	const char* batchWorkerAddress = NULL;
+	const char* workerName = "worker";
+	const char* workerCache = ".";
+	for (int i = 1; i + 1 < argc; i++)
+	{
+		if (strcmp(argv[i], "--batch-worker") == 0)
+		{
+			batchWorkerAddress = argv[i + 1];
+		}
+		if (strcmp(argv[i], "--worker-name") == 0)
+		{
+			workerName = argv[i + 1];
+		}
+		if (strcmp(argv[i], "--worker-cache") == 0)
+		{
+			workerCache = argv[i + 1];
+		}
+	}
+	if (NULL != batchWorkerAddress)
+	{
+		g_BatchWorker = new BatchWorker();
+		if (g_BatchWorker->Connect(batchWorkerAddress, workerName, workerCache) == false)
+		{
+			delete g_BatchWorker;
+			g_BatchWorker = NULL;
+			return(EXIT_FAILURE);
+		}
+	}
+
+	// read the assets from the pack named, or the default one once it
+	// is built, before anything is loaded; what the pack lacks is
+	// still read from the loose files
+	const char* assetPackPath = NULL;
+	for (int i = 1; i + 1 < argc; i++)
+	{
+		if (strcmp(argv[i], "--asset-pack") == 0)
+		{
+			assetPackPath = argv[i + 1];
+		}
+	}
+	if ((NULL != g_BatchWorker) && (g_BatchWorker->GetPackPath().empty() == false))
+	{
+		assetPackPath = g_BatchWorker->GetPackPath().c_str();
+	}
+	// one watcher polls every hot reloaded file; the files are edited
+	// loose, so the default pack, which would shadow them, is skipped
+	bool bWatchShaders = false;
+	bool bWatchAssets = false;
+	for (int i = 1; i < argc; i++)
+	{
+		bWatchShaders = (bWatchShaders == true) || (strcmp(argv[i], "--watch-shaders") == 0);
+		bWatchAssets = (bWatchAssets == true) || (strcmp(argv[i], "--watch-assets") == 0);
+	}
+	if ((bWatchShaders == true) || (bWatchAssets == true))
+	{
+		g_FileWatcher = new FileWatcher();
+		g_FileWatcher->Start();
+	}
+	if (NULL != assetPackPath)
+	{
+		AssetPack::Mount(assetPackPath);
+	}
+	else if (NULL == g_FileWatcher)
+	{
+		FILE* pPackFile = fopen(AssetPack::DEFAULT_PACK_FILE, "rb");
+		if (NULL != pPackFile)
+		{
+			fclose(pPackFile);
+			AssetPack::Mount(AssetPack::DEFAULT_PACK_FILE);
+		}
+	}
+
+	// the scene description needs no GL context, so it is read
+	// while the window and the context are created; the future
+	// waits for the read when an early exit drops it
+	const char* scenePath = DEFAULT_SCENE_PATH;
+	for (int i = 1; i + 1 < argc; i++)
+	{
+		// text or compiled scene description to show
+		if (strcmp(argv[i], "--scene") == 0)
+		{
+			scenePath = argv[i + 1];
+		}
+	}
+	if (NULL != g_BatchWorker)
+	{
+		scenePath = g_BatchWorker->GetScenePath().c_str();
+	}
+	for (int i = 1; i < argc; i++)
+	{
+		// read the caches from one snapshot of the scene mapped
+		// before anything loads
+		if (strcmp(argv[i], "--warm-start") == 0)
+		{
+			g_warmStartPath = std::string(scenePath) + ".warmstart";
+			AssetPack::MountSnapshot(g_warmStartPath.c_str());
+		}
+	}
+	SceneFile startupSceneFile;
+	std::future<void> sceneFileRead = std::async(std::launch::async, [&startupSceneFile, scenePath]() {
+		int stage = g_StartupTimer.BeginStage("scene file read");
+		startupSceneFile.Load(scenePath);
+		g_StartupTimer.EndStage(stage);
+	});
+
 	// if GLFW fails initialization, then terminate the application
+	int startupStage = g_StartupTimer.BeginStage("GLFW init");
 	if (InitializeGLFW() == false)
 	{
 		return(EXIT_FAILURE);
 	}
+	g_StartupTimer.EndStage(startupStage);
+
+	// create a debug context and print the driver's errors and
+	// performance warnings, with the GL objects and the passes
+	// named for GL debuggers
+	bool bGLDebug = false;
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--gl-debug") == 0)
+		{
+			bGLDebug = true;
+			glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, GLFW_TRUE);
+		}
+	}
+	// every GPU resource still held at exit, largest first, as CSV;
+	// F9 writes the same at any time
+	const char* gpuMemoryDumpFile = NULL;
+	for (int i = 1; i + 1 < argc; i++)
+	{
+		if (strcmp(argv[i], "--gpu-memory-dump") == 0)
+		{
+			gpuMemoryDumpFile = argv[i + 1];
+		}
+	}
 
 	// try to create a new shader manager object
 	g_ShaderManager = new ShaderManager();
@@ -57,24 +596,965 @@ int main(int argc, char* argv[])
 	g_ViewManager = new ViewManager(
 		g_ShaderManager);
 
+	// render offscreen at WIDTHxHEIGHT with a hidden window holding
+	// the context, for servers without a display
+	bool bHeadless = false;
+	int headlessWidth = 0;
+	int headlessHeight = 0;
+	for (int i = 1; i + 1 < argc; i++)
+	{
+		if (strcmp(argv[i], "--headless") == 0)
+		{
+			bHeadless = (sscanf(argv[i + 1], "%dx%d", &headlessWidth, &headlessHeight) == 2) &&
+				(headlessWidth > 0) && (headlessHeight > 0);
+			if (bHeadless == false)
+			{
+				std::cout << "Headless size must be WIDTHxHEIGHT, not " << argv[i + 1] << std::endl;
+				return(EXIT_FAILURE);
+			}
+		}
+	}
+
+	// render every pose of a camera path file into an image of a
+	// directory, headless, reading back and encoding the images
+	// while the next poses render
+	const char* batchPosesPath = NULL;
+	const char* batchDirectory = NULL;
+	int captureEncoders = -1;
+	int servicePort = 0;
+	const char* serviceReportPath = NULL;
+	for (int i = 1; i + 1 < argc; i++)
+	{
+		if ((strcmp(argv[i], "--batch-render") == 0) && (i + 2 < argc))
+		{
+			batchPosesPath = argv[i + 1];
+			batchDirectory = argv[i + 2];
+		}
+		// render the requests of clients on a local TCP port,
+		// headless, until one of them sends quit
+		if (strcmp(argv[i], "--render-service") == 0)
+		{
+			servicePort = atoi(argv[i + 1]);
+		}
+		// CSV of the requests answered, written when the service ends
+		if (strcmp(argv[i], "--service-report") == 0)
+		{
+			serviceReportPath = argv[i + 1];
+		}
+		// image format of the saved frames, png or tga
+		if (strcmp(argv[i], "--capture-format") == 0)
+		{
+			g_captureFormat = argv[i + 1];
+		}
+		// directory the screenshots and video frames are saved in
+		if (strcmp(argv[i], "--capture-directory") == 0)
+		{
+			g_captureDirectory = argv[i + 1];
+		}
+		// encoder threads, one per hardware thread besides this one
+		// unless given; 0 encodes on the rendering thread
+		if (strcmp(argv[i], "--capture-encoders") == 0)
+		{
+			captureEncoders = atoi(argv[i + 1]);
+		}
+	}
+
+	// time the CPU hot paths at several sizes each, printing the
+	// results and writing them as CSV with --microbenchmark-report;
+	// the context is only made for the uniform cases
+	bool bMicrobenchmarks = false;
+	const char* microbenchmarkFilter = NULL;
+	const char* microbenchmarkReport = NULL;
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--microbenchmarks") == 0)
+		{
+			bMicrobenchmarks = true;
+			// the cases whose names contain the filter, or all of them
+			if ((i + 1 < argc) && (strncmp(argv[i + 1], "--", 2) != 0))
+			{
+				microbenchmarkFilter = argv[i + 1];
+			}
+		}
+		if ((strcmp(argv[i], "--microbenchmark-report") == 0) && (i + 1 < argc))
+		{
+			microbenchmarkReport = argv[i + 1];
+		}
+	}
+	if (((batchPosesPath != NULL) || (bMicrobenchmarks == true) || (servicePort > 0)) && (bHeadless == false))
+	{
+		bHeadless = true;
+		headlessWidth = DEFAULT_BATCH_WIDTH;
+		headlessHeight = DEFAULT_BATCH_HEIGHT;
+	}
+	// every worker renders at the size of the coordinator
+	if (NULL != g_BatchWorker)
+	{
+		bHeadless = true;
+		headlessWidth = g_BatchWorker->GetWidth();
+		headlessHeight = g_BatchWorker->GetHeight();
+	}
+
+	// replay the frames of a GL trace headless, at the size they
+	// were captured at, without the scene, then exit; the later
+	// loops are timed, and with --replay-timing every call
+	GLTraceReplay* pTraceReplay = NULL;
+	int replayLoops = 2;
+	bool bReplayTiming = false;
+	for (int i = 1; i < argc; i++)
+	{
+		if ((strcmp(argv[i], "--replay-trace") == 0) && (i + 1 < argc))
+		{
+			pTraceReplay = new GLTraceReplay();
+			if (pTraceReplay->Load(argv[i + 1]) == false)
+			{
+				delete pTraceReplay;
+				return(EXIT_FAILURE);
+			}
+		}
+		if ((strcmp(argv[i], "--replay-loops") == 0) && (i + 1 < argc))
+		{
+			replayLoops = (atoi(argv[i + 1]) > 1) ? atoi(argv[i + 1]) : 1;
+		}
+		if (strcmp(argv[i], "--replay-timing") == 0)
+		{
+			bReplayTiming = true;
+		}
+	}
+	if (pTraceReplay != NULL)
+	{
+		bHeadless = true;
+		headlessWidth = pTraceReplay->GetWidth();
+		headlessHeight = pTraceReplay->GetHeight();
+	}
+
 	// try to create the main display window
-	g_Window = g_ViewManager->CreateDisplayWindow(WINDOW_TITLE);
+	startupStage = g_StartupTimer.BeginStage("window and context");
+	if (bHeadless == true)
+	{
+		g_Window = g_ViewManager->CreateHeadlessWindow(headlessWidth, headlessHeight);
+	}
+	else
+	{
+		g_Window = g_ViewManager->CreateDisplayWindow(WINDOW_TITLE);
+	}
+	if (g_Window == NULL)
+	{
+		return(EXIT_FAILURE);
+	}
+	g_StartupTimer.EndStage(startupStage);
 
 	// if GLEW fails initialization, then terminate the application
+	startupStage = g_StartupTimer.BeginStage("GL loader");
 	if (InitializeGLEW() == false)
 	{
 		return(EXIT_FAILURE);
 	}
+	if (bGLDebug == true)
+	{
+		GLDebug::Enable();
+	}
+	// the memory the driver loses from here on is set beside the
+	// tracked resources in the report
+	GPUMemory::CaptureBaseline();
+	g_StartupTimer.EndStage(startupStage);
+	if (pTraceReplay != NULL)
+	{
+		pTraceReplay->SetTiming(bReplayTiming);
+		bool bReplayed = pTraceReplay->Run(replayLoops);
+		pTraceReplay->Print();
+		delete pTraceReplay;
+		pTraceReplay = NULL;
+		return(bReplayed ? EXIT_SUCCESS : EXIT_FAILURE);
+	}
+
+	// capture COUNT frames from the frame numbered FIRST into a GL
+	// trace for --replay-trace; the hooks go in before the shaders
+	// are built, which are then built from their sources rather than
+	// the binary cache, so the trace holds the sources
+	for (int i = 1; i + 3 < argc; i++)
+	{
+		if (strcmp(argv[i], "--trace-frames") == 0)
+		{
+			GLTrace::Install();
+			if (GLTrace::IsInstalled() == true)
+			{
+				g_ShaderManager->SetProgramBinaryCache(false);
+				GLTrace::SetFrames(argv[i + 3], strtoull(argv[i + 1], NULL, 10), strtoull(argv[i + 2], NULL, 10));
+			}
+		}
+	}
+
+	// render both eyes side by side in one multiview pass, which
+	// the shaders are built for, so it is decided before they load
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--stereo") == 0)
+		{
+			if (bHeadless == true)
+			{
+				std::cout << "Stereo shows the eyes in the window, rendering one view headless" << std::endl;
+			}
+			else if (StereoTarget::IsAvailable() == true)
+			{
+				g_ShaderManager->SetMultiview(true);
+				g_ViewManager->SetStereo(true);
+			}
+			else
+			{
+				std::cout << "Stereo needs GL_OVR_multiview, rendering one view" << std::endl;
+			}
+		}
+	}
+
+	// build the permutations as separable stages in program
+	// pipelines; the GL trace records programs, not pipelines, so a
+	// traced run keeps whole programs
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--separable-programs") == 0)
+		{
+			if (GLTrace::IsInstalled() == true)
+			{
+				std::cout << "Separable programs are not traced, linking whole programs" << std::endl;
+			}
+			else
+			{
+				g_ShaderManager->SetSeparablePrograms(true);
+			}
+		}
+	}
 
-	// load the shader code from the external GLSL files
-	g_ShaderManager->LoadShaders(
-		"../../Utilities/shaders/vertexShader.glsl",
-		"../../Utilities/shaders/fragmentShader.glsl");
+	// build the permutations from the SPIR-V modules of
+	// --compile-spirv, specialized instead of compiled from GLSL; the
+	// GL trace records shader sources, so a traced run keeps the GLSL
+	g_ShaderManager->SetSpecializationConstant(ShaderManager::SPEC_CLUSTER_LIGHTS, LightClusters::MAX_CLUSTER_LIGHTS);
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--spirv-shaders") == 0)
+		{
+			if (GLTrace::IsInstalled() == true)
+			{
+				std::cout << "SPIR-V shaders are not traced, compiling GLSL" << std::endl;
+			}
+			else
+			{
+				g_ShaderManager->SetSpirvShaders(true);
+			}
+		}
+	}
+
+	// do the color and lighting math of the scene shaders in half
+	// floats, which --image-diff checks against the full ones
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--half-precision") == 0)
+		{
+			if ((GLEW_AMD_gpu_shader_half_float == GL_FALSE) && (GLEW_NV_gpu_shader5 == GL_FALSE))
+			{
+				std::cout << "Half precision needs GL_AMD_gpu_shader_half_float or GL_NV_gpu_shader5, shading in full precision" << std::endl;
+			}
+			else if (g_ShaderManager->IsSpirvShaders() == true)
+			{
+				std::cout << "The SPIR-V modules are built in full precision, shading in full precision" << std::endl;
+			}
+			else
+			{
+				g_ShaderManager->SetHalfPrecision(true);
+			}
+		}
+	}
+
+	// load the shader code from the external GLSL files; the
+	// programs compile while the scene is prepared, and after
+	startupStage = g_StartupTimer.BeginStage("shader load");
+	g_ShaderManager->LoadShaders(SCENE_VERTEX_SHADER_PATH, SCENE_FRAGMENT_SHADER_PATH);
 	g_ShaderManager->use();
+	g_StartupTimer.EndStage(startupStage);
+	if (bMicrobenchmarks == true)
+	{
+		// let the permutations finish compiling so the driver is
+		// idle while the uniform cases run
+		while (g_ShaderManager->PollPendingPrograms() > 0)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+		g_ShaderManager->use();
+		Microbenchmarks* pMicrobenchmarks = new Microbenchmarks(g_ShaderManager);
+		bool bRun = pMicrobenchmarks->Run(microbenchmarkFilter, microbenchmarkReport);
+		delete pMicrobenchmarks;
+		pMicrobenchmarks = NULL;
+		return(bRun ? EXIT_SUCCESS : EXIT_FAILURE);
+	}
+	g_shaderCompileStage = g_StartupTimer.BeginStage("shader compiles");
+
+	// rebuild the shaders whenever their files are saved, for tuning
+	// the shader code without restarting the application
+	if (bWatchShaders == true)
+	{
+		g_ShaderManager->StartFileWatcher(g_FileWatcher);
+	}
+	for (int i = 1; i < argc; i++)
+	{
+		// save every frame from the start, as F10 does
+		if (strcmp(argv[i], "--capture-video") == 0)
+		{
+			g_ViewManager->SetVideoCapture(true);
+		}
+		// start with the depth pre-pass on, for comparing GPUs
+		if (strcmp(argv[i], "--depth-prepass") == 0)
+		{
+			g_ViewManager->SetDepthPrepass(true);
+		}
+		// start on the deferred path instead of clustered forward
+		if (strcmp(argv[i], "--deferred") == 0)
+		{
+			g_ViewManager->SetDeferredShading(true);
+		}
+		// start with the low-detail tiles of the deferred path lit
+		// coarsely
+		if (strcmp(argv[i], "--variable-rate-shading") == 0)
+		{
+			g_ViewManager->SetVariableRateShading(true);
+		}
+		// start rendering only the frames in which something changed
+		if (strcmp(argv[i], "--render-on-demand") == 0)
+		{
+			g_ViewManager->SetRenderOnDemand(true);
+		}
+		// start with the reverse-Z infinite far projection
+		if (strcmp(argv[i], "--reverse-z") == 0)
+		{
+			g_ViewManager->SetReverseZ(true);
+		}
+		// start with the pass timings drawn over the frame, as F3 does
+		if (strcmp(argv[i], "--stats-overlay") == 0)
+		{
+			g_ViewManager->SetStatsOverlay(true);
+		}
+	}
+
+	// the camera block, instance data and indirect commands of the
+	// frames in flight share one persistently mapped buffer, three
+	// frames unless --frames-in-flight asks for 1 to 3
+	g_UploadRing = new UploadRing();
+	for (int i = 1; i + 1 < argc; i++)
+	{
+		if (strcmp(argv[i], "--frames-in-flight") == 0)
+		{
+			g_UploadRing->SetFramesInFlight(atoi(argv[i + 1]));
+		}
+	}
+	g_UploadRing->Create(UPLOAD_RING_FRAME_BYTES);
+
+	// the draws, state changes and uploads of every frame, with
+	// budgets from --budget NAME=VALUE that fail the run when any
+	// frame goes over them, for automated runs; heap-allocations=0
+	// checks that the frames after the warm-up take nothing from
+	// the heap
+	g_RenderCounters = new RenderCounters(g_ShaderManager, g_UploadRing);
+	for (int i = 1; i + 1 < argc; i++)
+	{
+		if (strcmp(argv[i], "--budget") == 0)
+		{
+			if (g_RenderCounters->ParseBudget(argv[i + 1]) == false)
+			{
+				std::cout << "Unknown budget " << argv[i + 1] << std::endl;
+				return(EXIT_FAILURE);
+			}
+		}
+	}
+
+	// the frame is drawn at the render scale and stretched to the
+	// window, or kept offscreen when there is none to show it in
+	g_RenderTarget = new RenderTarget();
+	g_RenderTarget->SetHeadless(bHeadless);
+	// the frames are presented in the chosen mode, never the driver default
+	g_FramePacer = new FramePacer();
+	// stereo frames are drawn into both eyes of their own target
+	g_StereoTarget = new StereoTarget();
+
+	// once the scene is complete, render warm-up frames and then
+	// play a camera path, writing the percentiles of its frame
+	// times and counters to a report, JSON or .csv, for comparing
+	// release candidates; every frame is rendered while it runs
+	const char* benchmarkPathFile = NULL;
+	const char* benchmarkReportFile = NULL;
+	for (int i = 1; i + 1 < argc; i++)
+	{
+		if ((strcmp(argv[i], "--benchmark") == 0) && (i + 2 < argc))
+		{
+			benchmarkPathFile = argv[i + 1];
+			benchmarkReportFile = argv[i + 2];
+			g_Benchmark = new BenchmarkRun(g_RenderCounters, g_RenderTarget);
+			g_ViewManager->SetRenderOnDemand(false);
+		}
+	}
+	for (int i = 1; (g_Benchmark != NULL) && (i + 1 < argc); i++)
+	{
+		// frames rendered at the starting view before the path
+		if (strcmp(argv[i], "--benchmark-warmup") == 0)
+		{
+			g_Benchmark->SetWarmupFrames(glm::max(atoi(argv[i + 1]), 0));
+		}
+		// frames measured along the path, all of it unless given
+		if (strcmp(argv[i], "--benchmark-frames") == 0)
+		{
+			g_Benchmark->SetMeasuredFrames(glm::max(atoi(argv[i + 1]), 0));
+		}
+	}
 
 	// try to create a new scene manager object and prepare the 3D scene
-	g_SceneManager = new SceneManager(g_ShaderManager);
+	// the scene passes are spread over the cores, one worker per
+	// hardware thread besides the one rendering unless --job-workers
+	// asks for a count, 0 keeping them on the rendering thread
+	int jobWorkers = -1;
+	for (int i = 1; i + 1 < argc; i++)
+	{
+		if (strcmp(argv[i], "--job-workers") == 0)
+		{
+			jobWorkers = atoi(argv[i + 1]);
+		}
+	}
+	g_JobSystem = new JobSystem();
+	g_JobSystem->Start(jobWorkers);
+
+	// saved frames are read back and encoded while the next render
+	g_FrameCapture = new FrameCapture();
+	g_FrameCapture->Start(captureEncoders);
+	// the stream is H.264 from FFmpeg, by the hardware encoder of the
+	// GPU unless --stream-encoder names one, at --stream-bitrate
+	// kilobits a second, sent over RTP to the viewer, or over WebRTC
+	// to the WHIP endpoint of --stream-whip
+	const char* streamFFmpegPath = "ffmpeg";
+	int streamEncoder = FrameStreamer::ENCODER_AUTO;
+	int streamBitrateKbps = 8000;
+	const char* streamWhipUrl = NULL;
+	for (int i = 1; i + 1 < argc; i++)
+	{
+		// the FFmpeg executable, when it is not on the path
+		if (strcmp(argv[i], "--stream-ffmpeg") == 0)
+		{
+			streamFFmpegPath = argv[i + 1];
+		}
+		// auto, nvenc, vaapi, amf, qsv or x264
+		if (strcmp(argv[i], "--stream-encoder") == 0)
+		{
+			streamEncoder = FrameStreamer::FindEncoder(argv[i + 1]);
+			if (streamEncoder == FrameStreamer::ENCODER_COUNT)
+			{
+				std::cout << "Unknown stream encoder " << argv[i + 1] << std::endl;
+				return(EXIT_FAILURE);
+			}
+		}
+		if (strcmp(argv[i], "--stream-bitrate") == 0)
+		{
+			streamBitrateKbps = glm::max(atoi(argv[i + 1]), 100);
+		}
+		if (strcmp(argv[i], "--stream-whip") == 0)
+		{
+			streamWhipUrl = argv[i + 1];
+		}
+	}
+	for (int i = 1; i + 1 < argc; i++)
+	{
+		// stream the frames to a viewer connecting on a TCP port,
+		// converted to NV12 on the GPU for the video encoder
+		if (strcmp(argv[i], "--stream") == 0)
+		{
+			g_FrameStreamer = new FrameStreamer();
+			if ((g_FrameCapture->EnableVideoFrames(g_ShaderManager, VIDEO_FRAME_SHADER_PATH) == false) ||
+				(g_FrameStreamer->Start(atoi(argv[i + 1]), streamFFmpegPath, streamEncoder, streamBitrateKbps,
+					streamWhipUrl, (const char*)glGetString(GL_VENDOR)) == false))
+			{
+				delete g_FrameStreamer;
+				g_FrameStreamer = NULL;
+				return(EXIT_FAILURE);
+			}
+		}
+	}
+	// the requests are answered with images from the capture
+	// encoders too
+	if (servicePort > 0)
+	{
+		g_RenderService = new RenderService();
+		if (g_RenderService->Start(servicePort, scenePath) == false)
+		{
+			delete g_RenderService;
+			g_RenderService = NULL;
+			return(EXIT_FAILURE);
+		}
+	}
+	for (int i = 1; i + 1 < argc; i++)
+	{
+		// serve the frame statistics on a TCP port, for a Prometheus
+		// scraper of the fleet
+		if (strcmp(argv[i], "--metrics") == 0)
+		{
+			g_MetricsExporter = new MetricsExporter();
+			if (g_MetricsExporter->Start(atoi(argv[i + 1])) == false)
+			{
+				delete g_MetricsExporter;
+				g_MetricsExporter = NULL;
+				return(EXIT_FAILURE);
+			}
+		}
+		// take edits of the running scene from an editor on a TCP
+		// port of the loopback interface
+		if (strcmp(argv[i], "--live-edit") == 0)
+		{
+			g_LiveEdit = new LiveEdit();
+			if (g_LiveEdit->Start(atoi(argv[i + 1])) == false)
+			{
+				delete g_LiveEdit;
+				g_LiveEdit = NULL;
+				return(EXIT_FAILURE);
+			}
+		}
+	}
+
+	// the scene textures are uploaded on a second context sharing
+	// this one, from a thread of its own, unless --loader-context 0
+	// keeps them on the rendering context, streamed in bands
+	bool bLoaderContext = true;
+	for (int i = 1; i + 1 < argc; i++)
+	{
+		if (strcmp(argv[i], "--loader-context") == 0)
+		{
+			bLoaderContext = (atoi(argv[i + 1]) != 0);
+		}
+	}
+	g_LoaderContext = new LoaderContext();
+	if (bLoaderContext == true)
+	{
+		g_LoaderContext->Create(g_Window);
+	}
+
+	g_ResourceManager = new ResourceManager();
+	g_SceneManager = new SceneManager(g_ShaderManager, g_UploadRing, g_JobSystem, g_ResourceManager);
+	g_SceneManager->SetStereo(g_ViewManager->IsStereo());
+	g_SceneManager->SetLoaderContext(g_LoaderContext);
+	// reload the textures and models whenever their files are saved,
+	// behind the slots and mesh IDs the draws already use
+	if (bWatchAssets == true)
+	{
+		g_SceneManager->SetAssetWatcher(g_FileWatcher);
+	}
+	// the passes are only timed while the overlay shows them, the
+	// governor weighs them or a hitch capture may need them
+	g_GPUProfiler = new GPUProfiler();
+	g_SceneManager->SetGPUProfiler(g_GPUProfiler);
+	g_QualityGovernor = new QualityGovernor();
+	g_PowerPolicy = new PowerPolicy();
+	g_StatsOverlay = new StatsOverlay(g_ShaderManager);
+	g_StatsOverlay->Create(OVERLAY_VERTEX_SHADER_PATH, OVERLAY_FRAGMENT_SHADER_PATH);
+	// capture the trace of the seconds before a frame longer than a
+	// budget in milliseconds, at most one per interval and so many
+	// in all, for the hitches that never show up again
+	const char* hitchDirectory = NULL;
+	double hitchBudgetMilliseconds = 0.0;
+	double hitchWindowSeconds = 5.0;
+	double hitchIntervalSeconds = 30.0;
+	int hitchLimit = 10;
+	for (int i = 1; i + 1 < argc; i++)
+	{
+		// the directory of the captures and the budget
+		if ((strcmp(argv[i], "--hitch-capture") == 0) && (i + 2 < argc))
+		{
+			hitchDirectory = argv[i + 1];
+			hitchBudgetMilliseconds = atof(argv[i + 2]);
+		}
+		// seconds of the trace before the hitch
+		if (strcmp(argv[i], "--hitch-window") == 0)
+		{
+			hitchWindowSeconds = atof(argv[i + 1]);
+		}
+		// seconds at least between two captures
+		if (strcmp(argv[i], "--hitch-interval") == 0)
+		{
+			hitchIntervalSeconds = atof(argv[i + 1]);
+		}
+		// captures of the run at most
+		if (strcmp(argv[i], "--hitch-limit") == 0)
+		{
+			hitchLimit = atoi(argv[i + 1]);
+		}
+	}
+	if ((hitchDirectory != NULL) && (hitchBudgetMilliseconds > 0.0))
+	{
+		g_HitchCapture = new HitchCapture(g_GPUProfiler, g_RenderCounters, g_SceneManager);
+		if (g_HitchCapture->Start(hitchDirectory, hitchBudgetMilliseconds, hitchWindowSeconds,
+			hitchIntervalSeconds, hitchLimit) == false)
+		{
+			delete g_HitchCapture;
+			g_HitchCapture = NULL;
+		}
+	}
+	// no frame time target keeps the render scale fixed
+	float targetFrameMilliseconds = 0.0f;
+	float minRenderScale = RenderTarget::MIN_RENDER_SCALE;
+	float maxRenderScale = 1.0f;
+	for (int i = 1; i + 1 < argc; i++)
+	{
+		// shadow atlas memory in megabytes, which bounds the number
+		// of shadowed lights
+		if (strcmp(argv[i], "--shadow-budget-mb") == 0)
+		{
+			g_SceneManager->SetShadowAtlasBudget((size_t)atoi(argv[i + 1]) * 1024 * 1024);
+		}
+		// cascades of the directional key light, 1 to 4, the side of
+		// each in texels, and the view depth they reach
+		if (strcmp(argv[i], "--shadow-cascades") == 0)
+		{
+			g_SceneManager->SetShadowCascades(atoi(argv[i + 1]), g_SceneManager->GetShadowCascadeSize());
+		}
+		if (strcmp(argv[i], "--shadow-cascade-size") == 0)
+		{
+			g_SceneManager->SetShadowCascades(g_SceneManager->GetShadowCascadeCount(), atoi(argv[i + 1]));
+		}
+		if (strcmp(argv[i], "--shadow-distance") == 0)
+		{
+			g_SceneManager->SetShadowDistance((float)atof(argv[i + 1]));
+		}
+		// texture memory in megabytes, past which the top mip levels
+		// of the textures drawn least recently are dropped
+		if (strcmp(argv[i], "--texture-budget-mb") == 0)
+		{
+			g_SceneManager->SetTextureBudget((size_t)atoi(argv[i + 1]) * 1024 * 1024);
+		}
+		// largest difference between the color channels of an image
+		// kept as one gray channel; negative keeps every image in color
+		if (strcmp(argv[i], "--gray-tolerance") == 0)
+		{
+			ImageDecoder::SetGrayTolerance(atoi(argv[i + 1]));
+		}
+		// compress the textures of image files with no KTX2 or DDS
+		// file into BC1 or BC3 on the GPU, "fast" or "high" quality
+		if (strcmp(argv[i], "--compress-textures") == 0)
+		{
+			g_SceneManager->SetTextureCompression(true, (strcmp(argv[i + 1], "high") == 0) ?
+				GPUTextureCompressor::QUALITY_HIGH : GPUTextureCompressor::QUALITY_FAST);
+		}
+		// memory in megabytes the committed pages of the virtual
+		// textures may take, past which the pages read least
+		// recently are decommitted
+		if (strcmp(argv[i], "--virtual-texture-budget-mb") == 0)
+		{
+			g_SceneManager->SetVirtualTextureBudget((size_t)atoi(argv[i + 1]) * 1024 * 1024);
+		}
+		// cut a large scene file into square chunks of this many
+		// units, streamed in and out around the camera
+		if (strcmp(argv[i], "--chunk-size") == 0)
+		{
+			g_SceneManager->SetWorldChunkSize((float)atof(argv[i + 1]));
+		}
+		// distance from the camera the chunks are loaded within
+		if (strcmp(argv[i], "--chunk-radius") == 0)
+		{
+			g_SceneManager->SetWorldChunkRadius((float)atof(argv[i + 1]));
+		}
+		// memory in megabytes the files and bakes of the resident
+		// chunks may take, past which the farthest are dropped
+		if (strcmp(argv[i], "--chunk-budget-mb") == 0)
+		{
+			g_SceneManager->SetWorldChunkBudget((size_t)atoi(argv[i + 1]) * 1024 * 1024);
+		}
+		// 0 to keep every mesh in full float vertices, for checking
+		// the compact layout against them
+		if (strcmp(argv[i], "--compact-vertices") == 0)
+		{
+			g_SceneManager->SetCompactVertices(atoi(argv[i + 1]) != 0);
+		}
+		// write the sphere and torus vertices with a compute shader
+		// instead of on the CPU
+		if (strcmp(argv[i], "--gpu-primitives") == 0)
+		{
+			g_SceneManager->SetGPUPrimitives(true);
+		}
+		// upload a position, rotation and scale per draw instead of
+		// its matrices, rebuilt into the instance data by a compute pass
+		if (strcmp(argv[i], "--compact-instances") == 0)
+		{
+			g_SceneManager->SetCompactInstances(true);
+		}
+		// play the clips of an animation file on the scene nodes
+		if (strcmp(argv[i], "--animations") == 0)
+		{
+			g_SceneManager->LoadAnimations(argv[i + 1]);
+		}
+		// emit, move and draw ambient particles on the GPU, such as
+		// steam over the cup, from a file of emitters
+		if (strcmp(argv[i], "--particles") == 0)
+		{
+			g_SceneManager->LoadParticles(argv[i + 1]);
+		}
+		// leave the pipelines of the scene to be built by the driver
+		// on their first draw in view, as a hitch
+		if (strcmp(argv[i], "--no-pipeline-warm-up") == 0)
+		{
+			g_bPipelineWarmUp = false;
+		}
+		// sample every animated node on the CPU, however many there
+		// are, instead of posing them with a compute pass
+		if (strcmp(argv[i], "--cpu-animation") == 0)
+		{
+			g_SceneManager->SetGPUAnimation(false);
+		}
+		// write the whole instance data into the upload ring every
+		// frame instead of copying the changed instances into a
+		// buffer kept between frames
+		if (strcmp(argv[i], "--ring-instances") == 0)
+		{
+			g_SceneManager->SetResidentInstances(false);
+		}
+		// shade each forward draw by the few lights that reach it
+		// most, picked on the CPU, instead of the light clusters
+		if (strcmp(argv[i], "--object-lights") == 0)
+		{
+			g_SceneManager->SetObjectLights(true);
+		}
+		// fold the lights that take little of the view into their
+		// ambient term, and fade out the negligible ones
+		if (strcmp(argv[i], "--light-lod") == 0)
+		{
+			g_SceneManager->SetLightLOD(true);
+		}
+		// what the imported model meshes keep on the CPU once drawn:
+		// cpu, compressed, derived from their files again, or gpu
+		if (strcmp(argv[i], "--mesh-retention") == 0)
+		{
+			if (g_SceneManager->SetMeshRetention(argv[i + 1]) == false)
+			{
+				std::cout << "Unknown mesh retention " << argv[i + 1] << std::endl;
+			}
+		}
+		// draw the expensive composite objects under the occlusion
+		// query of their box, for GPUs without the Hi-Z culling
+		if (strcmp(argv[i], "--occlusion-queries") == 0)
+		{
+			g_SceneManager->SetOcclusionQueries(true);
+		}
+		// light the static geometry from a baked lightmap, 1 for the
+		// diffuse lighting, 2 with ambient occlusion as well
+		if (strcmp(argv[i], "--lightmaps") == 0)
+		{
+			int lightmaps = atoi(argv[i + 1]);
+			g_SceneManager->SetLightmaps(lightmaps > 0, lightmaps > 1);
+		}
+		// diameter on screen, in pixels, below which a composite object
+		// is drawn as one impostor quad, 0 to always draw its parts
+		if (strcmp(argv[i], "--impostor-pixels") == 0)
+		{
+			g_SceneManager->SetImpostorPixels((float)atof(argv[i + 1]));
+		}
+		// a post effect (taa, ssao, bloom, tonemap or fxaa) at a tier
+		// from 0 (off) to 3, with an optional GPU budget in milliseconds
+		// it drops tiers to hold, as bloom=2:0.5; taa and fxaa only run
+		// while their anti-aliasing mode is picked
+		if (strcmp(argv[i], "--post-effect") == 0)
+		{
+			if (g_SceneManager->ParsePostEffect(argv[i + 1]) == false)
+			{
+				std::cout << "Unknown post effect " << argv[i + 1] << std::endl;
+			}
+		}
+		// 0 to compute the ambient occlusion of every pixel every frame
+		// instead of reusing it while the camera moves slowly
+		if (strcmp(argv[i], "--temporal-cache") == 0)
+		{
+			g_SceneManager->SetTemporalCaching(atoi(argv[i + 1]) != 0);
+		}
+		// starting shadow filtering, 0 (off) to 3 (5x5 PCF)
+		if (strcmp(argv[i], "--shadow-quality") == 0)
+		{
+			g_ViewManager->SetShadowQuality(atoi(argv[i + 1]));
+		}
+		// starting texture filtering, 0 (bilinear) to 3 (16x anisotropic)
+		if (strcmp(argv[i], "--texture-filter") == 0)
+		{
+			g_ViewManager->SetTextureFilterQuality(atoi(argv[i + 1]));
+		}
+		// starting anti-aliasing, by name (none, msaa2x, msaa4x,
+		// msaa8x, fxaa or taa) or number, cycled with the M key
+		if (strcmp(argv[i], "--anti-aliasing") == 0)
+		{
+			int antiAliasing = atoi(argv[i + 1]);
+			for (int mode = 0; mode < PostStack::AA_COUNT; mode++)
+			{
+				if (strcmp(argv[i + 1], PostStack::GetAntiAliasingName(mode)) == 0)
+				{
+					antiAliasing = mode;
+				}
+			}
+			g_ViewManager->SetAntiAliasing(antiAliasing);
+		}
+		// formats of the render targets, by name (low, medium or high)
+		// or number, from the smallest to the lossless ones
+		if (strcmp(argv[i], "--target-formats") == 0)
+		{
+			int tier = TargetFormats::ParseTier(argv[i + 1]);
+			if (tier < 0)
+			{
+				std::cout << "Unknown target format tier " << argv[i + 1] << std::endl;
+			}
+			else
+			{
+				g_SceneManager->SetTargetFormatTier(tier);
+			}
+		}
+		// resolution of the rendered frame to the window, 0.5 to 2
+		if (strcmp(argv[i], "--render-scale") == 0)
+		{
+			g_RenderTarget->SetRenderScale((float)atof(argv[i + 1]));
+		}
+		// GPU frame time in milliseconds the render scale is adjusted to hold
+		if (strcmp(argv[i], "--target-frame-ms") == 0)
+		{
+			targetFrameMilliseconds = (float)atof(argv[i + 1]);
+		}
+		// frame time in milliseconds the quality governor holds by
+		// dropping, in order, the post effect tiers, the mesh LODs, the
+		// shadow filtering, the shadow cascades, the anti-aliasing and
+		// the render scale
+		if (strcmp(argv[i], "--governor-frame-ms") == 0)
+		{
+			g_QualityGovernor->SetTarget((float)atof(argv[i + 1]));
+		}
+		// file the governor's decisions are written to on exit
+		if (strcmp(argv[i], "--governor-log") == 0)
+		{
+			g_governorLogFile = argv[i + 1];
+		}
+		// cap the frame rate, the render scale and the quality by the
+		// power source and the heat, auto, or hold the limits of a
+		// tier, full, save or low; a benchmark or a headless run
+		// measures the frames as asked for
+		if (strcmp(argv[i], "--power-policy") == 0)
+		{
+			int forcedTier = PowerPolicy::FindTier(argv[i + 1]);
+			if ((forcedTier < 0) && (strcmp(argv[i + 1], "auto") != 0))
+			{
+				std::cout << "Unknown power policy " << argv[i + 1] << std::endl;
+			}
+			else if ((bHeadless == true) || (g_Benchmark != NULL))
+			{
+				std::cout << "The power policy is left off for headless and benchmark runs" << std::endl;
+			}
+			else
+			{
+				g_PowerPolicy->SetEnabled(true);
+				g_PowerPolicy->SetForcedTier(forcedTier);
+			}
+		}
+		// bounds of the adjusted render scale
+		if (strcmp(argv[i], "--min-render-scale") == 0)
+		{
+			minRenderScale = (float)atof(argv[i + 1]);
+		}
+		if (strcmp(argv[i], "--max-render-scale") == 0)
+		{
+			maxRenderScale = (float)atof(argv[i + 1]);
+		}
+		// starting presentation mode: vsync, adaptive, uncapped or capped
+		if (strcmp(argv[i], "--present-mode") == 0)
+		{
+			int presentMode = FramePacer::FindPresentMode(argv[i + 1]);
+			if (presentMode >= 0)
+			{
+				g_ViewManager->SetPresentMode(presentMode);
+			}
+			else
+			{
+				std::cout << "Unknown present mode " << argv[i + 1] << std::endl;
+			}
+		}
+		// frame rate of the capped presentation mode
+		if (strcmp(argv[i], "--frame-cap") == 0)
+		{
+			g_FramePacer->SetFrameCap(atof(argv[i + 1]));
+		}
+		// 0 to use the camera of the frame start for the whole frame,
+		// for comparing the latency with and without the late latch
+		if (strcmp(argv[i], "--late-latch") == 0)
+		{
+			g_ViewManager->SetLateLatch(atoi(argv[i + 1]) != 0);
+		}
+		// record the camera path and key presses into a file on exit
+		if (strcmp(argv[i], "--record-path") == 0)
+		{
+			g_ViewManager->StartPathRecording(argv[i + 1]);
+		}
+		// play a recorded camera path back one step per frame, for
+		// benchmark runs rendering the same frames, and exit after it
+		if (strcmp(argv[i], "--play-path") == 0)
+		{
+			if (g_ViewManager->StartPathPlayback(argv[i + 1]) == false)
+			{
+				return(EXIT_FAILURE);
+			}
+		}
+		// distance between the eyes of a stereo frame, in scene units
+		if (strcmp(argv[i], "--eye-separation") == 0)
+		{
+			g_ViewManager->SetEyeSeparation((float)atof(argv[i + 1]));
+		}
+		// draw the scene from a preset camera, front, top or detail,
+		// into a corner of the frame; repeat for more views
+		if (strcmp(argv[i], "--view") == 0)
+		{
+			g_ViewManager->AddView(argv[i + 1]);
+		}
+		// the same, shown in a window of its own, as for another
+		// monitor; a headless run has no windows to show
+		if ((strcmp(argv[i], "--window") == 0) && (bHeadless == false))
+		{
+			g_ViewManager->AddWindowView(argv[i + 1]);
+		}
+	}
+	for (int i = 1; i < argc; i++)
+	{
+		// turn the camera by the mouse motion the device reports,
+		// without the pointer acceleration of the system
+		if (strcmp(argv[i], "--raw-mouse") == 0)
+		{
+			g_ViewManager->SetRawMouseMotion(true);
+		}
+	}
+	g_RenderTarget->SetDynamicScale(targetFrameMilliseconds, minRenderScale, maxRenderScale);
+	g_governorRenderScale = g_RenderTarget->GetRenderScale();
+	g_powerRenderScale = g_governorRenderScale;
+	g_powerFrameCap = g_FramePacer->GetFrameCap();
+	g_governorShadowCascades = g_SceneManager->GetShadowCascadeCount();
+	g_governorCascadeSize = g_SceneManager->GetShadowCascadeSize();
+	// the meshes are generated when the render list first draws
+	// them, and the images, models and programs keep loading on
+	// their threads after the first frame
+	sceneFileRead.wait();
+	startupStage = g_StartupTimer.BeginStage("prepare scene");
+	g_SceneManager->LoadSceneFile(startupSceneFile, scenePath);
 	g_SceneManager->PrepareScene();
+	g_StartupTimer.EndStage(startupStage);
+	g_sceneStreamingStage = g_StartupTimer.BeginStage("scene streaming");
+
+	// bake the meshes the scene uses into the file loaded in their
+	// place at startup; generating them needs the GL context, so
+	// this runs once the scene is prepared. --encode-meshes codes
+	// the file for the asset pack, smaller but decoded on loading
+	bool bEncodeMeshes = false;
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--encode-meshes") == 0)
+		{
+			bEncodeMeshes = true;
+		}
+	}
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--bake-meshes") == 0)
+		{
+			return(g_SceneManager->SaveBakedMeshes(bEncodeMeshes) ? EXIT_SUCCESS : EXIT_FAILURE);
+		}
+	}
 
 	// controls displayed in terminal
 	std::cout << "\n*** CONTROLS: ***\n";
@@ -84,104 +1564,1826 @@ int main(int argc, char* argv[])
 	std::cout << "Q - pan up\t" << "E - pan down\n";
 	std::cout << "O - orthographic view\n";
 	std::cout << "P - perspective view\n";
+	std::cout << "Z - toggle depth pre-pass\n";
+	std::cout << "G - toggle deferred shading\n";
+	std::cout << "C - toggle variable rate shading\n";
+	std::cout << "X - cycle shadow quality\n";
+	std::cout << "F - cycle texture filtering\n";
+	std::cout << "I - toggle render on demand\n";
+	std::cout << "R - toggle reverse-Z depth\n";
+	std::cout << "F12 - save a screenshot\t" << "F10 - toggle video capture\n";
+	std::cout << "F3 - toggle stats overlay\n";
 	std::cout << "SCROLL UP - increase move speed\t" << "SCROLL DOWN - decrease move speed\n";
 	std::cout << "ARROW UP - zoom in\t" << "ARROW DOWN - zoom out\n";
+
+	// a node of a video wall shows its tile of the wall, a column
+	// and row of a grid of displays, locked to the frames of the
+	// master, which takes the input
+	int wallMasterPort = 0;
+	int wallNodeCount = 0;
+	const char* wallMasterAddress = NULL;
+	for (int i = 1; i + 1 < argc; i++)
+	{
+		// the grid and the tile of this node, --wall 3x2 0,1
+		if ((strcmp(argv[i], "--wall") == 0) && (i + 2 < argc))
+		{
+			int columns = 0;
+			int rows = 0;
+			int column = 0;
+			int row = 0;
+			if ((sscanf(argv[i + 1], "%dx%d", &columns, &rows) == 2) &&
+				(sscanf(argv[i + 2], "%d,%d", &column, &row) == 2) &&
+				(column >= 0) && (column < columns) && (row >= 0) && (row < rows))
+			{
+				g_ViewManager->SetWallTile(columns, rows, column, row);
+			}
+			else
+			{
+				std::cout << "A wall tile is given as <columns>x<rows> <column>,<row>" << std::endl;
+			}
+		}
+		// the port the master waits on and how many nodes it waits for
+		if ((strcmp(argv[i], "--wall-master") == 0) && (i + 2 < argc))
+		{
+			wallMasterPort = atoi(argv[i + 1]);
+			wallNodeCount = glm::max(atoi(argv[i + 2]), 0);
+		}
+		// host:port of the master
+		if (strcmp(argv[i], "--wall-node") == 0)
+		{
+			wallMasterAddress = argv[i + 1];
+		}
+	}
+	if ((bHeadless == false) && ((wallMasterPort > 0) || (NULL != wallMasterAddress)))
+	{
+		g_WallSync = new WallSync();
+		bool bConnected = (wallMasterPort > 0) ?
+			g_WallSync->StartMaster(wallMasterPort, wallNodeCount) : g_WallSync->ConnectNode(wallMasterAddress);
+		if (bConnected == false)
+		{
+			delete g_WallSync;
+			g_WallSync = NULL;
+			return(EXIT_FAILURE);
+		}
+		// every node renders every frame with the camera it was sent,
+		// so none sleeps or reads the camera again before drawing
+		g_ViewManager->SetRenderOnDemand(false);
+		g_ViewManager->SetLateLatch(false);
+		if (g_WallSync->IsMaster() == false)
+		{
+			g_ViewManager->SetRemoteCamera(true);
+		}
+		if (g_WallSync->JoinSwapGroup() == true)
+		{
+			std::cout << "Wall swaps locked by the NV swap group" << std::endl;
+		}
+		else
+		{
+			std::cout << "Wall swaps locked by the software barrier alone" << std::endl;
+		}
+	}
+
+	// submit the frames from a thread of their own, which the
+	// window events never hold up, while this one handles them
+	bool bRenderThread = false;
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--render-thread") == 0)
+		{
+			// a benchmark starts its path between the frames, and a
+			// wall takes the frames of the master, so they render on
+			// this thread
+			bRenderThread = (bHeadless == false) && (g_Benchmark == NULL) && (NULL == g_WallSync);
+		}
+	}
+
+	// a headless run renders a fixed number of frames, and may keep
+	// the last one as an image
+	unsigned long long headlessFrames = DEFAULT_HEADLESS_FRAMES;
+	const char* saveFramePath = NULL;
+	for (int i = 1; i + 1 < argc; i++)
+	{
+		if (strcmp(argv[i], "--headless-frames") == 0)
+		{
+			headlessFrames = (unsigned long long)glm::max(atoi(argv[i + 1]), 1);
+		}
+		if (strcmp(argv[i], "--save-frame") == 0)
+		{
+			saveFramePath = argv[i + 1];
+		}
+	}
+	// throughput is timed from the end of the first frame, which
+	// also waits for the shader programs and the scene uploads
+	double headlessStartTime = -1.0;
+
+	// a batch waits for the whole scene before its first pose, then
+	// renders one pose per frame until the path ends
+	bool bBatchStarted = false;
+	unsigned long long batchImages = 0;
+	double batchStartTime = -1.0;
+
+	// the render service takes a request per frame once the scene
+	// is complete, and sleeps while none waits
+	RenderService::RENDER_REQUEST serviceRequest;
+	bool bServiceRequest = false;
+
+	// a batch worker plays the shards it is handed like a batch,
+	// numbering the images from the first of the shard
+	bool bShardPlaying = false;
+	size_t shardImage = 0;
+
+	// the camera and key presses of the master's frame, on a node
+	std::vector<int> wallKeys;
+	CameraPath::CAMERA_POSE wallPose;
+
+	ViewManager::FRAME_PACKET packet;
+	RenderThread renderThread;
+	g_firstFrameStage = g_StartupTimer.BeginStage("first frame");
+	if (bRenderThread == true)
+	{
+		// the late latch polls the events, which only this thread
+		// may do, and the render thread makes the context current
+		// on its own
+		g_ViewManager->SetLateLatch(false);
+		glfwMakeContextCurrent(NULL);
+		renderThread.Start(&RenderLoop);
+	}
+
 	// loop will keep running until the application is closed 
 	// or until an error has occurred
 	while (!glfwWindowShouldClose(g_Window))
 	{
-		// Enable z-depth
-		glEnable(GL_DEPTH_TEST);
-
-		// Clear the frame and z buffers
-		glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
+		PROFILE_SCOPE("main loop");
+		// the input of a remote viewer goes in with the window's
+		if (NULL != g_FrameStreamer)
+		{
+			g_FrameStreamer->PumpInput();
+		}
+		// the next request of the render service sets the camera, the
+		// frame size and the quality of the frame
+		if ((NULL != g_RenderService) && (bServiceRequest == false) &&
+			(g_lastPendingPrograms == 0) && (g_SceneManager->IsLoading() == false))
+		{
+			if (g_RenderService->IsQuitRequested() == true)
+			{
+				break;
+			}
+			if (g_RenderService->NextRequest(serviceRequest) == false)
+			{
+				// the readbacks of the requests rendered are taken
+				// while waiting, so their answers go out
+				g_FrameCapture->Poll();
+				g_RenderService->WaitForRequest((g_RenderService->HasRequestsInFlight() == true) ?
+					SERVICE_POLL_SECONDS : IDLE_WAIT_SECONDS);
+				continue;
+			}
+			g_ViewManager->SetHeadlessSize(serviceRequest.width, serviceRequest.height);
+			RenderService::ApplyQuality(g_ViewManager, serviceRequest.quality);
+			g_ViewManager->SetCameraPose(serviceRequest.pose);
+			bServiceRequest = true;
+		}
+		// a batch worker asks for its next shard once the scene is
+		// complete and the last shard was played through
+		if ((NULL != g_BatchWorker) && (bShardPlaying == false) &&
+			(g_lastPendingPrograms == 0) && (g_SceneManager->IsLoading() == false))
+		{
+			BatchWorker::SHARD_STATE shardState = g_BatchWorker->NextShard();
+			if ((shardState == BatchWorker::SHARD_FINISHED) || (shardState == BatchWorker::SHARD_ERROR))
+			{
+				break;
+			}
+			if (shardState == BatchWorker::SHARD_IDLE)
+			{
+				g_FrameCapture->Poll();
+				glfwWaitEventsTimeout(IDLE_WAIT_SECONDS);
+				continue;
+			}
+			if (g_ViewManager->StartPathPlayback(g_BatchWorker->GetShardPath().c_str()) == false)
+			{
+				g_BatchWorker->FailShard();
+				continue;
+			}
+			bShardPlaying = true;
+			shardImage = g_BatchWorker->GetShardFirstImage();
+		}
+		// a node of a wall renders the master's next frame, and closes
+		// with the master
+		if ((NULL != g_WallSync) && (g_WallSync->IsMaster() == false))
+		{
+			if (g_WallSync->ReceiveFrame(wallKeys, wallPose) == false)
+			{
+				break;
+			}
+			g_ViewManager->ApplyRemoteFrame(wallKeys, wallPose);
+		}
 		// convert from 3D object space to 2D view
 		g_ViewManager->PrepareSceneView();
+		// a played back camera path ends the run after its last step,
+		// and the shard of a worker the wait for the next
+		if (g_ViewManager->IsPathPlaybackFinished() == true)
+		{
+			if (bShardPlaying == true)
+			{
+				bShardPlaying = false;
+				continue;
+			}
+			break;
+		}
+		g_ViewManager->GetFramePacket(packet);
+		// a saving tier of the power policy draws only the frames
+		// that change, as render on demand does
+		if (g_PowerPolicy->GetActiveLimits().bIdleOnDemand == true)
+		{
+			packet.bRenderOnDemand = true;
+		}
+		if (NULL != g_MetricsExporter)
+		{
+			MetricsExporter::SCENE_METRICS sceneMetrics;
+			sceneMetrics.streamingQueue = g_SceneManager->GetStreamingQueueDepth();
+			sceneMetrics.textureResidentBytes = g_SceneManager->GetTextureResidencyStats().residentBytes;
+			sceneMetrics.textureBudgetBytes = g_SceneManager->GetTextureBudget();
+			g_MetricsExporter->RecordScene(sceneMetrics);
+		}
+		if ((NULL != g_WallSync) && (g_WallSync->IsMaster() == true))
+		{
+			g_WallSync->BroadcastFrame(g_ViewManager->GetFrameKeys(), g_ViewManager->GetRenderCameraPose());
+		}
+		if (NULL != g_FrameStreamer)
+		{
+			packet.streamInputId = g_FrameStreamer->GetInputId();
+		}
+		// the poses of a batch or of the requests need not follow each
+		// other, so the depth of the last one cannot cull the draws
+		// of the next
+		if ((bBatchStarted == true) || (bServiceRequest == true) || (bShardPlaying == true))
+		{
+			g_SceneManager->CameraCut();
+		}
 
-		// refresh the 3D scene
-		g_SceneManager->RenderScene();
+		if (bRenderThread == true)
+		{
+			// hand the frame over and handle the events of the next one
+			// while it renders, staying at most a frame ahead of it
+			renderThread.Publish(packet);
+			if (packet.bRenderOnDemand == true)
+			{
+				glfwWaitEventsTimeout(IDLE_WAIT_SECONDS);
+			}
+			else
+			{
+				renderThread.WaitForTaken(IDLE_WAIT_SECONDS);
+				glfwPollEvents();
+			}
+		}
+		else if (RenderFramePacket(packet, true) == true)
+		{
+			if (bHeadless == true)
+			{
+				if (g_framesRendered == 1)
+				{
+					headlessStartTime = glfwGetTime();
+				}
+				if ((batchPosesPath == NULL) && (g_Benchmark == NULL) && (NULL == g_FrameStreamer) &&
+					(NULL == g_RenderService) && (NULL == g_BatchWorker) && (g_framesRendered >= headlessFrames))
+				{
+					break;
+				}
+			}
+			if (g_Benchmark != NULL)
+			{
+				if (g_Benchmark->IsComplete() == true)
+				{
+					break;
+				}
+				// the warm-up counts once the scene is complete, and
+				// the path starts with the frame after it
+				if ((g_Benchmark->IsMeasuring() == false) && (g_lastPendingPrograms == 0) &&
+					(g_SceneManager->IsLoading() == false) && (g_Benchmark->WarmUp(glfwGetTime()) == true))
+				{
+					if (g_ViewManager->StartPathPlayback(benchmarkPathFile) == false)
+					{
+						break;
+					}
+				}
+			}
+			if (bServiceRequest == true)
+			{
+				// the image is read back while the next request
+				// renders, and answered once encoded
+				g_FrameCapture->CaptureToSink(g_RenderTarget->GetFramebuffer(),
+					g_RenderTarget->GetWidth(), g_RenderTarget->GetHeight(),
+					&RenderService::ImageSink, g_RenderService, serviceRequest.id, false);
+				bServiceRequest = false;
+			}
+			if (bShardPlaying == true)
+			{
+				g_FrameCapture->CaptureToSink(g_RenderTarget->GetFramebuffer(),
+					g_RenderTarget->GetWidth(), g_RenderTarget->GetHeight(),
+					&BatchWorker::ImageSink, g_BatchWorker, (uint32_t)shardImage, false);
+				shardImage++;
+			}
+			if (bBatchStarted == true)
+			{
+				char filename[1024];
+				snprintf(filename, sizeof(filename), "%s/%05llu.%s", batchDirectory, batchImages, g_captureFormat);
+				g_FrameCapture->Capture(g_RenderTarget->GetFramebuffer(),
+					g_RenderTarget->GetWidth(), g_RenderTarget->GetHeight(), filename);
+				batchImages++;
+			}
+			else if ((batchPosesPath != NULL) && (g_lastPendingPrograms == 0) &&
+				(g_SceneManager->IsLoading() == false))
+			{
+				// the scene is complete, so the next frame shows the
+				// first pose
+				if (g_ViewManager->StartPathPlayback(batchPosesPath) == false)
+				{
+					break;
+				}
+				bBatchStarted = true;
+				batchStartTime = glfwGetTime();
+			}
+			// query the latest GLFW events
+			glfwPollEvents();
+		}
+		else
+		{
+			// nothing changed or the window is minimized, so sleep
+			// until an event arrives or it is time to check the
+			// shader programs again
+			glfwWaitEventsTimeout((g_lastPendingPrograms > 0) ? PENDING_PROGRAMS_WAIT_SECONDS : IDLE_WAIT_SECONDS);
+			g_FramePacer->ResetPacing();
+			if (NULL != g_MetricsExporter)
+			{
+				g_MetricsExporter->ResetInterval();
+			}
+			if (NULL != g_HitchCapture)
+			{
+				g_HitchCapture->ResetInterval();
+			}
+		}
+	}
 
+	if (bRenderThread == true)
+	{
+		// the statistics below are read once the thread is done
+		renderThread.Stop();
+		glfwMakeContextCurrent(g_Window);
+	}
 
-		// Flips the the back buffer with the front buffer every frame.
-		glfwSwapBuffers(g_Window);
+	// the report goes straight to the console, after every message
+	// still queued; what is logged from here on is written at once
+	Logger::Stop();
 
-		// query the latest GLFW events
-		glfwPollEvents();
+	if (bHeadless == true)
+	{
+		// the frames count once the GPU has finished them
+		glFinish();
+		double headlessSeconds = (headlessStartTime >= 0.0) ? glfwGetTime() - headlessStartTime : 0.0;
+		unsigned long long timedFrames = (g_framesRendered > 0) ? g_framesRendered - 1 : 0;
+		std::cout << "\n*** HEADLESS: ***\n";
+		std::cout << "frame size " << headlessWidth << "x" << headlessHeight
+			<< "\tframes " << g_framesRendered << "\n";
+		std::cout << "timed frames " << timedFrames
+			<< "\tseconds " << headlessSeconds
+			<< "\tframes per second " << ((headlessSeconds > 0.0) ? (double)timedFrames / headlessSeconds : 0.0) << "\n";
+		if (saveFramePath != NULL)
+		{
+			if (g_RenderTarget->SaveFrame(saveFramePath) == true)
+			{
+				std::cout << "frame saved to " << saveFramePath << "\n";
+			}
+		}
 	}
 
-	// clear the allocated manager objects from memory
-	if (NULL != g_SceneManager)
+	// the saved frames are done once the last image is written,
+	// and the streamed ones and the requests once the last was
+	// handed on
+	g_FrameCapture->Finish();
+	if (NULL != g_FrameStreamer)
 	{
-		delete g_SceneManager;
-		g_SceneManager = NULL;
+		g_FrameStreamer->Stop();
+		g_FrameStreamer->PrintStats();
 	}
-	if (NULL != g_ViewManager)
+	if (NULL != g_HitchCapture)
 	{
-		delete g_ViewManager;
-		g_ViewManager = NULL;
+		g_HitchCapture->Finish();
+		std::cout << "\n*** HITCH CAPTURE: ***\nhitches captured " << g_HitchCapture->GetCaptureCount() << "\n";
 	}
-	if (NULL != g_ShaderManager)
+	if (NULL != g_WallSync)
 	{
-		delete g_ShaderManager;
-		g_ShaderManager = NULL;
+		if (g_WallSync->IsMaster() == true)
+		{
+			g_WallSync->BroadcastQuit();
+		}
+		g_WallSync->PrintStats();
+	}
+	if (NULL != g_BatchWorker)
+	{
+		std::cout << "\n*** BATCH WORKER: ***\nimages sent " << g_BatchWorker->GetImagesSent() << "\n";
+		g_BatchWorker->Close();
+	}
+	if (NULL != g_LiveEdit)
+	{
+		g_LiveEdit->Stop();
+		g_LiveEdit->PrintStats();
+	}
+	if (NULL != g_RenderService)
+	{
+		g_RenderService->Stop();
+		g_RenderService->PrintStats();
+		if ((serviceReportPath != NULL) && (g_RenderService->WriteReport(serviceReportPath) == false))
+		{
+			std::cout << "Could not write the service report " << serviceReportPath << std::endl;
+		}
+	}
+	const FrameCapture::CAPTURE_STATS& captureStats = g_FrameCapture->GetStats();
+	if (batchPosesPath != NULL)
+	{
+		double batchSeconds = (batchStartTime >= 0.0) ? glfwGetTime() - batchStartTime : 0.0;
+		std::cout << "\n*** BATCH: ***\n";
+		std::cout << "images " << captureStats.images << " of " << batchImages
+			<< "\tfailed " << captureStats.failures
+			<< "\twritten " << (captureStats.bytesWritten / (1024 * 1024)) << " MB\n";
+		std::cout << "seconds " << batchSeconds
+			<< "\timages per second " << ((batchSeconds > 0.0) ? (double)captureStats.images / batchSeconds : 0.0) << "\n";
+		std::cout << "readback waits " << captureStats.readbackWaits
+			<< "\t" << (captureStats.readbackWaitSeconds * 1000.0) << " ms"
+			<< "\tencoder waits " << captureStats.encodeWaits
+			<< "\t" << (captureStats.encodeWaitSeconds * 1000.0) << " ms"
+			<< "\tencode per image " << ((captureStats.images > 0) ? captureStats.encodeSeconds * 1000.0 / (double)captureStats.images : 0.0) << " ms\n";
+	}
+	else if ((g_screenshots > 0) || (g_videoFrames > 0) || (captureStats.dropped > 0))
+	{
+		// the frames saved from the viewer, and the video frames left
+		// out so the rendering kept its rate
+		std::cout << "\n*** CAPTURE: ***\n";
+		std::cout << "screenshots " << g_screenshots
+			<< "\tvideo frames " << g_videoFrames
+			<< "\tdropped " << captureStats.dropped
+			<< "\twritten " << captureStats.images
+			<< "\tfailed " << captureStats.failures << "\n";
+		std::cout << "readback waits " << captureStats.readbackWaits
+			<< "\tencoder waits " << captureStats.encodeWaits
+			<< "\tencode per image " << ((captureStats.images > 0) ? captureStats.encodeSeconds * 1000.0 / (double)captureStats.images : 0.0) << " ms\n";
 	}
 
-	// Terminates the program successfully
-	exit(EXIT_SUCCESS); 
-}
+	// a run ending before the whole scene was drawn reports
+	// how far the startup got
+	if (g_StartupTimer.IsSceneComplete() == false)
+	{
+		g_StartupTimer.Print();
+		TextureStreamer::PrintUploadStats();
+	}
 
-/***********************************************************
- *	InitializeGLFW()
- * 
- *  This function is used to initialize the GLFW library.   
- ***********************************************************/
-bool InitializeGLFW()
-{
-	// GLFW: initialize and configure library
-	// --------------------------------------
-	glfwInit();
+	std::cout << "\n*** FRAMES: ***\n";
+	std::cout << "frames rendered " << g_framesRendered
+		<< "\tidle waits " << g_framesSkipped << "\n";
+	if (bRenderThread == true)
+	{
+		const RenderThread::THREAD_STATS& threadStats = renderThread.GetStats();
+		std::cout << "render thread packets " << threadStats.published
+			<< "\ttaken " << threadStats.taken
+			<< "\tmerged " << threadStats.merged << "\n";
+	}
+	std::cout << "GPU frame " << g_RenderTarget->GetGPUMilliseconds() << " ms"
+		<< "\trender scale " << g_RenderTarget->GetRenderScale();
+	if (g_RenderTarget->IsDynamicScale() == true)
+	{
+		std::cout << "\tdynamic, " << g_RenderTarget->GetScaleChanges() << " changes";
+	}
+	std::cout << "\n";
+	// what the governor traded away by the end, and how often it
+	// changed its mind
+	if (g_QualityGovernor->IsEnabled() == true)
+	{
+		std::cout << "quality governor target " << g_QualityGovernor->GetTarget() << " ms"
+			<< "\tchanges " << g_QualityGovernor->GetDecisions().size()
+			<< "\tcpu bound frames " << g_QualityGovernor->GetCPUBoundFrames() << "\n";
+		for (int lever = 0; lever < QualityGovernor::LEVER_COUNT; lever++)
+		{
+			std::cout << QualityGovernor::GetLeverName(lever) << " " << g_QualityGovernor->GetLevel(lever)
+				<< " of " << g_QualityGovernor->GetLeverSteps(lever)
+				<< ((lever + 1 < QualityGovernor::LEVER_COUNT) ? "\t" : "\n");
+		}
+		if (NULL != g_governorLogFile)
+		{
+			bool bWritten = g_QualityGovernor->WriteLog(g_governorLogFile);
+			std::cout << "governor log " << ((bWritten == true) ? "written to " : "could not be written to ")
+				<< g_governorLogFile << "\n";
+		}
+	}
+	// time and frames in each tier of the power policy, and the
+	// charge used on battery
+	if ((g_PowerPolicy->IsEnabled() == true) || (g_PowerPolicy->GetStats().batterySeconds > 0.0))
+	{
+		g_PowerPolicy->PrintStats();
+	}
+	// what the render graph of the last frame kept and pooled
+	const RenderGraph::GRAPH_STATS& graphStats = g_SceneManager->GetRenderGraphStats();
+	std::cout << "render graph passes " << graphStats.passes
+		<< "\tculled " << graphStats.culledPasses
+		<< "\ttransient targets " << graphStats.transientTargets
+		<< " in " << graphStats.pooledTextures << " textures"
+		<< "\tframebuffer binds " << graphStats.framebufferBinds
+		<< "\tskipped " << graphStats.framebufferSkips << "\n";
+	// the GPU frame time of each anti-aliasing mode drawn, and what
+	// it costs over none when that was drawn too
+	for (int mode = 0; mode < PostStack::AA_COUNT; mode++)
+	{
+		if (g_antiAliasingFrames[mode] > 0)
+		{
+			double milliseconds = g_antiAliasingMilliseconds[mode] / (double)g_antiAliasingFrames[mode];
+			std::cout << "anti-aliasing " << PostStack::GetAntiAliasingName(mode)
+				<< "\t" << milliseconds << " ms over " << g_antiAliasingFrames[mode] << " frames";
+			if ((mode != PostStack::AA_NONE) && (g_antiAliasingFrames[PostStack::AA_NONE] > 0))
+			{
+				std::cout << "\tcost " << (milliseconds - g_antiAliasingMilliseconds[PostStack::AA_NONE] /
+					(double)g_antiAliasingFrames[PostStack::AA_NONE]) << " ms";
+			}
+			std::cout << "\n";
+		}
+	}
+	const PostStack& postStack = g_SceneManager->GetPostStack();
+	for (int effect = 0; effect < PostStack::EFFECT_COUNT; effect++)
+	{
+		if (postStack.GetRequestedTier(effect) != PostStack::TIER_OFF)
+		{
+			std::cout << "post " << PostStack::GetEffectName(effect)
+				<< "\ttier " << postStack.GetTier(effect) << " of " << postStack.GetRequestedTier(effect)
+				<< "\t" << postStack.GetMilliseconds(effect) << " ms"
+				<< "\tbudget " << postStack.GetBudget(effect) << " ms\n";
+		}
+	}
+	// the average time of each pass over the frames the overlay timed
+	if (g_GPUProfiler->GetFramesTimed() > 0)
+	{
+		std::cout << "passes timed over " << g_GPUProfiler->GetFramesTimed() << " frames\n";
+		for (int pass = 0; pass < GPUProfiler::PASS_COUNT; pass++)
+		{
+			std::cout << GPUProfiler::GetPassName(pass) << " " << g_GPUProfiler->GetAverageGPUMilliseconds(pass) << " ms"
+				<< ((pass + 1 < GPUProfiler::PASS_COUNT) ? "\t" : "\n");
+		}
+	}
 
-#ifdef __APPLE__
-	// set the version of OpenGL and profile to use
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-	glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
-#else
-	// set the version of OpenGL and profile to use
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 6);
-	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-#endif
-	// GLFW: end -------------------------------
+	// how evenly the frames were presented
+	const FramePacer::PACING_STATS& pacingStats = g_FramePacer->GetStats();
+	std::cout << "present mode " << FramePacer::GetPresentModeName(g_FramePacer->GetPresentMode());
+	if (g_FramePacer->GetPresentMode() == FramePacer::PRESENT_CAPPED)
+	{
+		std::cout << " at " << g_FramePacer->GetFrameCap() << " Hz";
+	}
+	if (g_FramePacer->IsAdaptiveVsyncFallback() == true)
+	{
+		std::cout << " (unsupported, vsync)";
+	}
+	std::cout << "\n";
+	if (pacingStats.intervals > 0)
+	{
+		double meanInterval = pacingStats.totalSeconds / (double)pacingStats.intervals;
+		double variance = pacingStats.totalSquaredSeconds / (double)pacingStats.intervals - meanInterval * meanInterval;
+		std::cout << "frame interval " << (meanInterval * 1000.0) << " ms"
+			<< "\tjitter " << (glm::sqrt(glm::max(variance, 0.0)) * 1000.0) << " ms"
+			<< "\tmin " << (pacingStats.minSeconds * 1000.0) << " ms"
+			<< "\tmax " << (pacingStats.maxSeconds * 1000.0) << " ms"
+			<< "\tlimiter wait " << pacingStats.waitSeconds << " s\n";
+	}
 
-	return(true);
-}
+	// the camera path recorded or played back
+	if (g_ViewManager->SavePathRecording() == true)
+	{
+		std::cout << "camera path recorded " << g_ViewManager->GetCameraPath().GetStepCount() << " steps\n";
+	}
+	if (g_ViewManager->GetCameraPath().IsPlaying() == true)
+	{
+		std::cout << "camera path played " << g_ViewManager->GetCameraPath().GetStepsPlayed()
+			<< " of " << g_ViewManager->GetCameraPath().GetStepCount() << " steps\n";
+	}
 
-/***********************************************************
- *	InitializeGLEW()
- *
- *  This function is used to initialize the GLEW library.
- ***********************************************************/
-bool InitializeGLEW()
-{
-	// GLEW: initialize
-	// -----------------------------------------
-	GLenum GLEWInitResult = GLEW_OK;
+	// how long input took to reach a presented frame
+	const ViewManager::LATENCY_STATS& latencyStats = g_ViewManager->GetLatencyStats();
+	if (latencyStats.frames > 0)
+	{
+		std::cout << "input to present " << (latencyStats.totalSeconds / (double)latencyStats.frames * 1000.0) << " ms"
+			<< "\tmax " << (latencyStats.maxSeconds * 1000.0) << " ms"
+			<< "\tlate latch " << ((g_ViewManager->GetLateLatch() == true) ? "on" : "off") << "\n";
+	}
+	const ViewManager::MOUSE_STATS& mouseStats = ViewManager::GetMouseStats();
+	if (mouseStats.updates > 0)
+	{
+		std::cout << "mouse " << mouseStats.events << " events in " << mouseStats.updates << " camera updates"
+			<< "\tmax " << mouseStats.maxEvents << " per update"
+			<< "\traw motion " << ((g_ViewManager->GetRawMouseMotion() == true) ? "on" : "off") << "\n";
+	}
 
-	// try to initialize the GLEW library
-	GLEWInitResult = glewInit();
-	if (GLEW_OK != GLEWInitResult)
+	// the frame time percentiles along the path, and the machine
+	// and settings they were measured with
+	bool bBenchmarkWritten = true;
+	if (g_Benchmark != NULL)
 	{
-		std::cerr << glewGetErrorString(GLEWInitResult) << std::endl;
-		return false;
+		g_Benchmark->Finish();
+		char dateText[64];
+		time_t now = time(NULL);
+		strftime(dateText, sizeof(dateText), "%Y-%m-%d %H:%M:%S", localtime(&now));
+		g_Benchmark->AddInfo("date", dateText);
+		g_Benchmark->AddInfo("vendor", (const char*)glGetString(GL_VENDOR));
+		g_Benchmark->AddInfo("renderer", (const char*)glGetString(GL_RENDERER));
+		g_Benchmark->AddInfo("gl version", (const char*)glGetString(GL_VERSION));
+		g_Benchmark->AddInfo("glsl version", (const char*)glGetString(GL_SHADING_LANGUAGE_VERSION));
+		g_Benchmark->AddInfo("hardware threads", std::to_string(std::thread::hardware_concurrency()));
+		g_Benchmark->AddInfo("job threads", std::to_string(g_JobSystem->GetThreadCount()));
+#ifdef _DEBUG
+		g_Benchmark->AddInfo("build", "debug");
+#else
+		g_Benchmark->AddInfo("build", "release");
+#endif
+		g_Benchmark->AddInfo("scene", scenePath);
+		g_Benchmark->AddInfo("camera path", benchmarkPathFile);
+		g_Benchmark->AddInfo("frame size", std::to_string(g_RenderTarget->GetWidth()) + "x" + std::to_string(g_RenderTarget->GetHeight()));
+		g_Benchmark->AddInfo("render scale", std::to_string(g_RenderTarget->GetRenderScale()));
+		g_Benchmark->AddInfo("anti-aliasing", PostStack::GetAntiAliasingName(g_SceneManager->GetAntiAliasing()));
+		g_Benchmark->AddInfo("quality governor", (g_QualityGovernor->IsEnabled() == true) ?
+			std::to_string(g_QualityGovernor->GetTarget()) + " ms, " +
+			std::to_string(g_QualityGovernor->GetDecisions().size()) + " changes" : "off");
+		// a run on battery or throttled is not comparable with one
+		// on AC power
+		const PowerPolicy::POWER_STATE& powerState = g_PowerPolicy->GetState();
+		g_Benchmark->AddInfo("power", std::string((powerState.source == PowerPolicy::SOURCE_BATTERY) ? "battery" :
+			(powerState.source == PowerPolicy::SOURCE_AC) ? "AC" : "no battery") +
+			((powerState.bThrottled == true) ? ", throttled" : ""));
+		g_Benchmark->AddInfo("temporal cache", (g_SceneManager->IsTemporalCachingEnabled() == true) ? "on" : "off");
+		g_Benchmark->AddInfo("present mode", (bHeadless == true) ? "headless" :
+			FramePacer::GetPresentModeName(g_FramePacer->GetPresentMode()));
+		g_Benchmark->AddInfo("frames in flight", std::to_string(g_UploadRing->GetFramesInFlight()));
+		g_Benchmark->Print();
+		bBenchmarkWritten = g_Benchmark->WriteReport(benchmarkReportFile);
+		std::cout << "report " << ((bBenchmarkWritten == true) ? "written to " : "could not be written to ")
+			<< benchmarkReportFile << "\n";
 	}
-	// GLEW: end -------------------------------
 
-	// Displays a successful OpenGL initialization message
-	std::cout << "INFO: OpenGL Successfully Initialized\n";
-	std::cout << "INFO: OpenGL Version: " << glGetString(GL_VERSION) << "\n" << std::endl;
+	// how much went through the upload ring and how long the CPU
+	// waited for the GPU to release a region
+	const UploadRing::UPLOAD_STATS& uploadStats = g_UploadRing->GetStats();
+	std::cout << "\n*** UPLOADS: ***\n";
+	std::cout << (g_UploadRing->IsPersistent() ? "persistent mapped" : "buffer sub-data")
+		<< " ring of " << g_UploadRing->GetBufferSize() << " bytes\n";
+	std::cout << "bytes per frame " << ((uploadStats.frames > 0) ? uploadStats.bytesWritten / uploadStats.frames : 0)
+		<< "\tpeak " << uploadStats.peakFrameBytes << "\n";
+	std::cout << "stalls " << uploadStats.stalls
+		<< "\twaited " << (uploadStats.stallSeconds * 1000.0) << " ms"
+		<< "\toverflows " << uploadStats.overflows << "\n";
+	// a frame spending a noticeable share of its time on the fences
+	// waits for the GPU; otherwise the CPU sets the frame rate
+	double stallFraction = g_UploadRing->GetStallFraction();
+	std::cout << "frames in flight " << g_UploadRing->GetFramesInFlight()
+		<< "\tfence wait per frame " << ((uploadStats.frames > 0) ? uploadStats.stallSeconds * 1000.0 / uploadStats.frames : 0.0) << " ms"
+		<< "\tlongest " << (uploadStats.maxStallSeconds * 1000.0) << " ms"
+		<< "\t" << (stallFraction * 100.0) << "% of frame time"
+		<< "\t" << ((stallFraction > GPU_BOUND_STALL_FRACTION) ? "GPU bound" : "CPU bound") << "\n";
+	if (g_LoaderContext->IsAvailable() == true)
+	{
+		const LoaderContext::LOADER_STATS& loaderStats = g_LoaderContext->GetStats();
+		std::cout << "loader context tasks " << loaderStats.tasks
+			<< "\tbusy " << (loaderStats.busySeconds * 1000.0) << " ms\n";
+	}
+	else
+	{
+		std::cout << "textures streamed on the rendering context\n";
+	}
+	const ResourceManager::RESOURCE_STATS& resourceStats = g_ResourceManager->GetStats();
+	std::cout << "resources loaded " << resourceStats.loads
+		<< "\tadopted " << resourceStats.adopted
+		<< "\tshared " << resourceStats.shared
+		<< "\tfailed " << resourceStats.failed
+		<< "\tevicted " << resourceStats.evicted
+		<< "\treloaded " << resourceStats.reloads << "\n";
 
-	return(true);
-}
\ No newline at end of file
+	// report how much redundant state the filters kept away from GL
+	const ShaderManager::STATE_FILTER_STATS& stateStats =
+		g_ShaderManager->GetStateFilterStats();
+	const ShapeMeshes::BIND_STATS& bindStats = ShapeMeshes::GetBindStats();
+	std::cout << "\n*** STATE FILTER: ***\n";
+	std::cout << "uniforms sent " << stateStats.uniformUploads
+		<< "\tskipped " << stateStats.uniformSkips << "\n";
+	std::cout << "textures sent " << stateStats.textureBinds
+		<< "\tskipped " << stateStats.textureSkips << "\n";
+	std::cout << "programs switched " << stateStats.programSwitches
+		<< "\tskipped " << stateStats.programSkips << "\n";
+	const ShaderManager::SOURCE_STATS& sourceStats = g_ShaderManager->GetSourceStats();
+	std::cout << "shader files read " << sourceStats.fileReads
+		<< "\tcached " << sourceStats.fileHits
+		<< "\texpanded " << sourceStats.expansions
+		<< "\treused " << sourceStats.expansionHits << "\n";
+	std::cout << "VAOs sent " << bindStats.vaoBinds
+		<< "\tskipped " << bindStats.vaoSkips << "\n";
+	std::cout << "draw calls " << bindStats.drawCalls
+		<< "\tinstances " << bindStats.instances << "\n";
+	const SceneManager::CULL_STATS& cullStats = g_SceneManager->GetCullStats();
+	std::cout << "draws tested " << cullStats.drawsTested
+		<< "\tculled " << cullStats.drawsCulled << "\n";
+	const SceneManager::IMPOSTOR_STATS& impostorStats = g_SceneManager->GetImpostorStats();
+	std::cout << "impostors drawn " << impostorStats.impostorsDrawn
+		<< "\tdraws replaced " << impostorStats.drawsReplaced
+		<< "\tshapes captured " << impostorStats.shapesCaptured << "\n";
+	const SceneManager::PREFAB_STATS& prefabStats = g_SceneManager->GetPrefabStats();
+	std::cout << "prefabs compiled " << prefabStats.prefabs
+		<< "\tparts " << prefabStats.parts
+		<< "\tinstances " << prefabStats.instances
+		<< "\tdraws copied " << prefabStats.draws
+		<< "\tparts merged " << prefabStats.mergedParts
+		<< "\tinto groups " << prefabStats.mergedGroups << "\n";
+	const ObjectPicker::PICK_STATS& pickStats = g_SceneManager->GetPickStats();
+	if (pickStats.picks > 0)
+	{
+		std::cout << "object picks " << pickStats.picks
+			<< "\thits " << pickStats.hits
+			<< "\treadback polls pending " << pickStats.pendingPolls << "\n";
+	}
+	if (g_SceneManager->GetOcclusionQueries().GetStats().frames > 0)
+	{
+		g_SceneManager->GetOcclusionQueries().Print();
+	}
+	g_SceneManager->GetRenderStates().Print();
+	const InstanceExpander::EXPAND_STATS& expandStats = g_SceneManager->GetInstanceExpandStats();
+	if (expandStats.expansions > 0)
+	{
+		std::cout << "compact instances expanded " << expandStats.instances
+			<< "\tdispatches " << expandStats.expansions
+			<< "\tfull uploads " << expandStats.fallbacks << "\n";
+	}
+	if (g_SceneManager->GetAnimation().GetStats().bindings > 0)
+	{
+		g_SceneManager->GetAnimation().PrintStats();
+	}
+	if (g_SceneManager->GetParticles().IsAvailable() == true)
+	{
+		g_SceneManager->GetParticles().PrintStats();
+	}
+	const SceneManager::WARMUP_STATS& warmUpStats = g_SceneManager->GetWarmUpStats();
+	if (warmUpStats.warmUps > 0)
+	{
+		std::cout << "pipeline warm-ups " << warmUpStats.warmUps
+			<< "\tcombinations " << warmUpStats.combinations
+			<< "\tpermutations " << warmUpStats.permutations
+			<< "\tvertex formats " << warmUpStats.vertexFormats
+			<< "\tms " << warmUpStats.seconds * 1000.0 << "\n";
+	}
+	const DirtyRangeBuffer::UPLOAD_STATS& residentStats = DirtyRangeBuffer::GetStats();
+	if (residentStats.updates > 0)
+	{
+		std::cout << "resident instance updates " << residentStats.updates
+			<< "\tnew buffers " << residentStats.fullUploads
+			<< "\tregions " << residentStats.regions
+			<< "\tinstances " << residentStats.elements
+			<< "\tKB " << residentStats.bytes / 1024
+			<< "\tpeak KB " << residentStats.peakBytes / 1024 << "\n";
+	}
+	if (g_SceneManager->GetTextureCompressor().GetStats().textures > 0)
+	{
+		g_SceneManager->GetTextureCompressor().Print();
+	}
+	if (g_SceneManager->GetVirtualTextures().GetStats().pagesCommitted > 0)
+	{
+		g_SceneManager->GetVirtualTextures().Print();
+	}
+
+	// what the driver reported in the debug mode
+	if (GLDebug::IsEnabled() == true)
+	{
+		GLDebug::Print();
+	}
+	// the messages logged, and those the limits left out
+	Logger::Print();
+
+	// what the frames submitted, and whether they kept the budgets
+	g_RenderCounters->Print();
+	bool bWithinBudgets = g_RenderCounters->IsWithinBudgets();
+
+	// how the scene passes were spread over the threads
+	JobSystem::JOB_STATS jobStats = g_JobSystem->GetStats();
+	std::cout << "\n*** JOBS: ***\n";
+	std::cout << "threads " << g_JobSystem->GetThreadCount()
+		<< "\tjobs run " << jobStats.jobsRun
+		<< "\tstolen " << jobStats.steals << "\n";
+	// what the per-thread frame arenas grew to
+	FrameArena::ARENA_STATS arenaStats = FrameArena::GetStats();
+	std::cout << "frame arenas " << arenaStats.arenas
+		<< "\tcapacity " << (arenaStats.capacityBytes / 1024) << " KB"
+		<< "\tpeak " << (arenaStats.peakBytes / 1024) << " KB"
+		<< "\tblocks allocated " << arenaStats.blockAllocations << "\n";
+
+	// how much of the full mip chains the scene textures held
+	const TextureResidency::RESIDENCY_STATS& residencyStats =
+		g_SceneManager->GetTextureResidencyStats();
+	std::cout << "\n*** TEXTURES: ***\n";
+	std::cout << "resident " << (residencyStats.residentBytes / (1024 * 1024)) << " MB"
+		<< "\tof " << (residencyStats.fullBytes / (1024 * 1024)) << " MB"
+		<< "\tpeak " << (residencyStats.peakResidentBytes / (1024 * 1024)) << " MB"
+		<< "\tbudget " << (g_SceneManager->GetTextureBudget() / (1024 * 1024)) << " MB\n";
+	std::cout << "reduced textures " << residencyStats.reducedTextures
+		<< "\tlevels dropped " << residencyStats.levelsDropped
+		<< "\trestored " << residencyStats.levelsRestored
+		<< "\tprefetched " << residencyStats.levelsPrefetched << "\n";
+
+	// vertices transformed per triangle and per vertex used, with
+	// the modeled cache, before and after the load time reordering,
+	// and the vertex memory the layouts of the meshes take
+	const std::vector<ShapeMeshes::MESH_STATS>& meshStats = g_SceneManager->GetMeshStats();
+	size_t vertexBytes = 0;
+	size_t fullVertexBytes = 0;
+	std::cout << "\n*** MESHES: ***\n";
+	for (size_t i = 0; i < meshStats.size(); i++)
+	{
+		std::cout << meshStats[i].name << "\t" << meshStats[i].vertexCount << " vertices\t"
+			<< meshStats[i].triangleCount << " triangles"
+			<< "\tACMR " << meshStats[i].before.acmr << " -> " << meshStats[i].after.acmr
+			<< "\tATVR " << meshStats[i].before.atvr << " -> " << meshStats[i].after.atvr
+			<< ((meshStats[i].bCompact == true) ? "\tcompact" : "") << "\n";
+		vertexBytes += (size_t)meshStats[i].vertexCount * ((meshStats[i].bCompact == true) ?
+			ShapeMeshes::COMPACT_VERTEX_BYTES : ShapeMeshes::VERTEX_FLOATS * sizeof(GLfloat));
+		fullVertexBytes += (size_t)meshStats[i].vertexCount * ShapeMeshes::VERTEX_FLOATS * sizeof(GLfloat);
+	}
+	std::cout << "vertex memory " << (vertexBytes / 1024) << " KB"
+		<< "\tin full floats " << (fullVertexBytes / 1024) << " KB\n";
+
+	// the video memory of the meshes, textures, targets and buffers
+	GPUMemory::Print();
+	GPUBuffer::Print();
+	g_SceneManager->GetMeshPages().Print("mesh");
+	if (g_SceneManager->GetWorldChunks().IsEnabled() == true)
+	{
+		g_SceneManager->GetWorldChunks().Print();
+	}
+	if (NULL != gpuMemoryDumpFile)
+	{
+		GPUMemory::Dump(gpuMemoryDumpFile);
+	}
+
+	// the assets read from the pack and the loose files
+	AssetPack::PrintStats();
+
+	// the frames captured, closing a trace the run cut short
+	GLTrace::Finish();
+	GLTrace::Print();
+
+	// clear the allocated manager objects from memory; the watcher
+	// first, so nothing polls the files of the managers going away
+	if (NULL != g_FileWatcher)
+	{
+		delete g_FileWatcher;
+		g_FileWatcher = NULL;
+	}
+	if (NULL != g_SceneManager)
+	{
+		delete g_SceneManager;
+		g_SceneManager = NULL;
+	}
+	// what the scene released is gone; anything left was never
+	// released, and is freed here while the context is current
+	if (NULL != g_ResourceManager)
+	{
+		g_ResourceManager->PrintLeakReport();
+		delete g_ResourceManager;
+		g_ResourceManager = NULL;
+	}
+	// after the scene, whose textures may wait for its tasks
+	if (NULL != g_LoaderContext)
+	{
+		delete g_LoaderContext;
+		g_LoaderContext = NULL;
+	}
+	if (NULL != g_ViewManager)
+	{
+		delete g_ViewManager;
+		g_ViewManager = NULL;
+	}
+	if (NULL != g_FramePacer)
+	{
+		delete g_FramePacer;
+		g_FramePacer = NULL;
+	}
+	// before the target whose GPU times it samples
+	if (NULL != g_Benchmark)
+	{
+		delete g_Benchmark;
+		g_Benchmark = NULL;
+	}
+	if (NULL != g_RenderTarget)
+	{
+		delete g_RenderTarget;
+		g_RenderTarget = NULL;
+	}
+	if (NULL != g_StereoTarget)
+	{
+		delete g_StereoTarget;
+		g_StereoTarget = NULL;
+	}
+	if (NULL != g_UploadRing)
+	{
+		delete g_UploadRing;
+		g_UploadRing = NULL;
+	}
+	if (NULL != g_FrameCapture)
+	{
+		delete g_FrameCapture;
+		g_FrameCapture = NULL;
+	}
+	if (NULL != g_FrameStreamer)
+	{
+		delete g_FrameStreamer;
+		g_FrameStreamer = NULL;
+	}
+	if (NULL != g_RenderService)
+	{
+		delete g_RenderService;
+		g_RenderService = NULL;
+	}
+	if (NULL != g_BatchWorker)
+	{
+		delete g_BatchWorker;
+		g_BatchWorker = NULL;
+	}
+	if (NULL != g_WallSync)
+	{
+		delete g_WallSync;
+		g_WallSync = NULL;
+	}
+	if (NULL != g_MetricsExporter)
+	{
+		delete g_MetricsExporter;
+		g_MetricsExporter = NULL;
+	}
+	if (NULL != g_LiveEdit)
+	{
+		delete g_LiveEdit;
+		g_LiveEdit = NULL;
+	}
+	if (NULL != g_HitchCapture)
+	{
+		delete g_HitchCapture;
+		g_HitchCapture = NULL;
+	}
+	if (NULL != g_JobSystem)
+	{
+		delete g_JobSystem;
+		g_JobSystem = NULL;
+	}
+	if (NULL != g_RenderCounters)
+	{
+		delete g_RenderCounters;
+		g_RenderCounters = NULL;
+	}
+	// before the shader manager, which the overlay program is built by
+	if (NULL != g_StatsOverlay)
+	{
+		delete g_StatsOverlay;
+		g_StatsOverlay = NULL;
+	}
+	if (NULL != g_GPUProfiler)
+	{
+		delete g_GPUProfiler;
+		g_GPUProfiler = NULL;
+	}
+	if (NULL != g_QualityGovernor)
+	{
+		delete g_QualityGovernor;
+		g_QualityGovernor = NULL;
+	}
+	if (NULL != g_PowerPolicy)
+	{
+		delete g_PowerPolicy;
+		g_PowerPolicy = NULL;
+	}
+	if (NULL != g_ShaderManager)
+	{
+		delete g_ShaderManager;
+		g_ShaderManager = NULL;
+	}
+	// once every loader has ended
+	AssetPack::UnmountSnapshot();
+	AssetPack::Unmount();
+
+	// every thread has ended, so the rings are read whole
+	if (tracePath != NULL)
+	{
+		ScopeProfiler::SetEnabled(false);
+		std::cout << "\n*** TRACE: ***\n";
+		if (ScopeProfiler::WriteChromeTrace(tracePath) == true)
+		{
+			std::cout << "scopes " << ScopeProfiler::GetEventCount()
+				<< "\toverwritten " << ScopeProfiler::GetOverwrittenCount()
+				<< "\twritten to " << tracePath << "\n";
+		}
+		else
+		{
+			std::cout << "trace could not be written to " << tracePath << "\n";
+		}
+	}
+
+	// Terminates the program, unsuccessfully when a frame went over
+	// a budget or the benchmark report could not be written
+	exit(((bWithinBudgets == true) && (bBenchmarkWritten == true)) ? EXIT_SUCCESS : EXIT_FAILURE);
+}
+
+/***********************************************************
+ *	InitializeGLFW()
+ * 
+ *  This function is used to initialize the GLFW library.   
+ ***********************************************************/
+bool InitializeGLFW()
+{
+	// GLFW: initialize and configure library
+	// --------------------------------------
+	glfwInit();
+
+#ifdef __APPLE__
+	// set the version of OpenGL and profile to use
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+	glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+#else
+	// set the version of OpenGL and profile to use
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 6);
+	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+#endif
+	// GLFW: end -------------------------------
+
+	return(true);
+}
+
+/***********************************************************
+ *	InitializeGLEW()
+ *
+ *  This function is used to resolve the OpenGL entry points
+ *  the application calls into the GLEW pointers, in place
+ *  of glewInit() resolving every one GLEW knows.
+ ***********************************************************/
+bool InitializeGLEW()
+{
+	// GL loader: initialize
+	// -----------------------------------------
+	if (GLLoader::Load(glfwGetProcAddress) == false)
+	{
+		return false;
+	}
+	// GL loader: end --------------------------
+
+	// Displays a successful OpenGL initialization message
+	LOG_INFO("OpenGL Successfully Initialized");
+	LOG_INFO("OpenGL Version: %s", (const char*)glGetString(GL_VERSION));
+
+	return(true);
+}
+/***********************************************************
+ *  RenderFramePacket()
+ *
+ *  This function is used for rendering and presenting the
+ *  frame a packet describes, on the thread owning the GL
+ *  context. On demand it only renders when the view, the
+ *  scene or the programs drawing it changed, and shortly
+ *  after; it returns false for a frame it skipped. The late
+ *  latch samples the mouse look again once the draws are
+ *  built, which polls the window events, so only the main
+ *  thread may ask for it.
+ ***********************************************************/
+bool RenderFramePacket(ViewManager::FRAME_PACKET& packet, bool bLateLatch)
+{
+	PROFILE_SCOPE("RenderFramePacket");
+	// pick up shader permutations that finished compiling
+	int pendingPrograms = g_ShaderManager->PollPendingPrograms();
+	// the clips play from the first frame drawn on
+	if (g_animationStartTime < 0.0)
+	{
+		g_animationStartTime = glfwGetTime();
+	}
+	g_SceneManager->SetAnimationTime(glfwGetTime() - g_animationStartTime);
+	// apply the edits of the editor on the thread that renders the
+	// scene, before its update of the frame
+	int liveEdits = (NULL != g_LiveEdit) ? g_LiveEdit->ApplyEdits(g_SceneManager) : 0;
+
+	bool bChanged = (packet.bViewChanged == true) ||
+		(g_SceneManager->HasPendingChanges() == true) ||
+		(pendingPrograms != g_lastPendingPrograms) || (liveEdits > 0);
+	g_lastPendingPrograms = pendingPrograms;
+	if (bChanged == true)
+	{
+		g_settleFrames = SETTLE_FRAMES;
+	}
+
+	// the power state is read on the frames skipped too, so a
+	// skipping tier still notices the charger plugged in
+	UpdatePowerPolicy();
+
+	// a minimized window has no framebuffer to draw into
+	bool bVisible = (packet.framebufferWidth > 0) && (packet.framebufferHeight > 0);
+	if ((bVisible == false) ||
+		((packet.bRenderOnDemand == true) && (g_settleFrames <= 0)))
+	{
+		g_framesSkipped++;
+		g_PowerPolicy->AddFrame(false);
+		return(false);
+	}
+
+	// a load or compile still running brings draws the driver has
+	// not met; once none is and a frame has listed them, they are
+	// drawn off screen before the next, whose GL trace leaves them out
+	if ((pendingPrograms > 0) || (g_SceneManager->IsLoading() == true))
+	{
+		g_warmUpDue = 2;
+	}
+	else if (g_warmUpDue == 2)
+	{
+		g_warmUpDue = 1;
+	}
+	else if ((g_bPipelineWarmUp == true) && (g_warmUpDue == 1))
+	{
+		int warmUpStage = (g_StartupTimer.IsSceneComplete() == false) ?
+			g_StartupTimer.BeginStage("pipeline warm-up") : -1;
+		int combinations = g_SceneManager->WarmUpPipelines();
+		g_StartupTimer.EndStage(warmUpStage);
+		g_warmUpDue = 0;
+
+		const SceneManager::WARMUP_STATS& warmUpStats = g_SceneManager->GetWarmUpStats();
+		if (combinations > 0)
+		{
+			std::cout << "Pipeline warm-up drew " << combinations << " combinations of "
+				<< warmUpStats.permutations << " permutations and "
+				<< warmUpStats.vertexFormats << " vertex formats in "
+				<< warmUpStats.lastSeconds * 1000.0 << " ms" << std::endl;
+		}
+	}
+	// the frames of a GL trace start before their first call
+	GLTrace::BeginFrame(packet.framebufferWidth, packet.framebufferHeight);
+
+	// time the passes while the overlay shows them; a headless
+	// frame has no window to show it in
+	double frameStartTime = glfwGetTime();
+	bool bStatsOverlay = (packet.bStatsOverlay == true) && (g_RenderTarget->IsHeadless() == false) &&
+		(g_StatsOverlay->IsAvailable() == true);
+	g_GPUProfiler->SetEnabled((bStatsOverlay == true) || (g_QualityGovernor->IsEnabled() == true) ||
+		(NULL != g_HitchCapture));
+	g_GPUProfiler->BeginFrame();
+	g_RenderCounters->BeginFrame();
+	GPUBuffer::BeginFrame();
+	if (bStatsOverlay == false)
+	{
+		g_overlayFrameTime = -1.0;
+	}
+
+	// wait for the region of the ring this frame writes to
+	g_UploadRing->BeginFrame();
+	// the settings asked for, less the steps the governor dropped;
+	// the packet keeps the asked ones, as it may be drawn again
+	int antiAliasing = packet.antiAliasing;
+	int shadowQuality = packet.shadowQuality;
+	ApplyQualityGovernor(antiAliasing, shadowQuality);
+	ApplyPowerPolicy(antiAliasing, shadowQuality);
+
+	// the anti-aliasing picks the targets and effects of the frame,
+	// and the temporal one draws the main view a subpixel apart
+	// each frame
+	CountAntiAliasingCost(antiAliasing);
+	g_SceneManager->SetAntiAliasing(antiAliasing);
+	JitterMainView(packet);
+	g_ViewManager->UploadFramePacket(packet);
+
+	// reverse-Z needs a floating point depth buffer, and sets
+	// the clip depth range and the depth clear value and test;
+	// the multisampled depth is resolved into the frame by a
+	// copy, which needs the formats to match
+	g_RenderTarget->SetFloatDepth((packet.bReverseZ == true) ||
+		(PostStack::GetAntiAliasingSamples(antiAliasing) > 1));
+	// the post effects read the lit frame before it is tone mapped
+	g_RenderTarget->SetFloatColor(g_SceneManager->IsPostProcessingActive());
+	g_RenderTarget->SetFloatColorFormat(g_SceneManager->GetTargetFormats().hdrColor);
+	g_SceneManager->SetReverseZ(packet.bReverseZ);
+
+	// point the frame at the scaled target and its viewport, or
+	// at both eyes of the stereo target and the viewport of one
+	if (packet.bStereo == true)
+	{
+		g_StereoTarget->Begin(packet.framebufferWidth, packet.framebufferHeight);
+	}
+	else
+	{
+		g_RenderTarget->Begin(packet.framebufferWidth, packet.framebufferHeight);
+	}
+
+	// the frame and z buffers are cleared by the first pass of the
+	// scene's render graph, and every pass sets its depth state
+
+	const ViewManager::FRAME_DATA& mainView = packet.views[0];
+	g_SceneManager->SetViewPosition(glm::vec3(mainView.viewPosition));
+	g_SceneManager->SetViewMatrices(mainView.view, mainView.projection);
+	g_SceneManager->SetDepthPrepass(packet.bDepthPrepass);
+	g_SceneManager->SetDeferredShading(packet.bDeferredShading);
+	g_SceneManager->SetVariableRateShading(packet.bVariableRateShading);
+	g_SceneManager->SetShadowQuality(shadowQuality);
+	g_SceneManager->SetTextureFilterQuality(packet.textureFilterQuality);
+	// the ID pass of a click is drawn with the main view
+	if ((packet.bPick == true) && (packet.bStereo == false))
+	{
+		g_SceneManager->RequestPick(0.5f, 0.5f);
+	}
+
+	// refresh the 3D scene: build the draws, then sample the mouse
+	// look once more and submit them with the newest view
+	g_SceneManager->BuildScene();
+	if ((bLateLatch == true) && (g_ViewManager->LatchCamera(packet) == true))
+	{
+		JitterMainView(packet);
+		g_ViewManager->UploadFramePacket(packet);
+		g_SceneManager->SetViewMatrices(mainView.view, mainView.projection);
+	}
+	g_SceneManager->SubmitScene();
+
+	// report the object of an earlier click once its IDs were read
+	// back, which never waits for the GPU
+	int pickedDraw = -1;
+	if (g_SceneManager->TakePickedDraw(pickedDraw) == true)
+	{
+		if (pickedDraw >= 0)
+		{
+			std::cout << "Picked draw " << pickedDraw << " of scene node "
+				<< g_SceneManager->GetDrawSceneNode(pickedDraw) << std::endl;
+		}
+		else
+		{
+			std::cout << "Picked nothing" << std::endl;
+		}
+	}
+
+	// draw the extra views over their corners of the frame, or
+	// into the targets of their windows, sharing the scene update
+	// of the main view; a stereo frame has only its two eyes
+	int viewCount = (packet.bStereo == true) ? 1 : packet.viewCount;
+	for (int view = 1; view < viewCount; view++)
+	{
+		GLint viewRect[4];
+		ViewWindow* pViewWindow = g_ViewManager->GetViewWindow(view);
+		if (NULL != pViewWindow)
+		{
+			if (pViewWindow->Begin(packet.viewWindowWidth[view], packet.viewWindowHeight[view]) == false)
+			{
+				continue;
+			}
+			viewRect[0] = 0;
+			viewRect[1] = 0;
+			viewRect[2] = packet.viewWindowWidth[view];
+			viewRect[3] = packet.viewWindowHeight[view];
+		}
+		else
+		{
+			g_ViewManager->GetViewRect(view, g_RenderTarget->GetWidth(), g_RenderTarget->GetHeight(), viewRect);
+		}
+		g_ViewManager->BindView(view);
+		g_SceneManager->SetViewPosition(glm::vec3(packet.views[view].viewPosition));
+		g_SceneManager->SetViewMatrices(packet.views[view].view, packet.views[view].projection);
+		GLDebugGroup viewGroup("secondary view");
+		g_SceneManager->RenderSecondaryView(viewRect);
+		if (NULL != pViewWindow)
+		{
+			pViewWindow->End();
+		}
+	}
+	if (viewCount > 1)
+	{
+		g_ViewManager->BindView(0);
+		g_SceneManager->SetViewPosition(glm::vec3(mainView.viewPosition));
+		g_SceneManager->SetViewMatrices(mainView.view, mainView.projection);
+	}
+	g_UploadRing->EndFrame();
+
+	// stretch the frame over the window, or show the eyes side
+	// by side
+	g_GPUProfiler->BeginPass(GPUProfiler::PASS_POST);
+	GLDebug::PushGroup(GPUProfiler::GetPassName(GPUProfiler::PASS_POST));
+	if (packet.bStereo == true)
+	{
+		g_StereoTarget->End();
+	}
+	else
+	{
+		g_RenderTarget->End();
+	}
+
+	// save the finished frame without waiting for it, and hand on
+	// the earlier ones whose readback arrived
+	g_FrameCapture->Poll();
+	if ((packet.bScreenshot == true) || (packet.bVideoCapture == true) ||
+		((NULL != g_FrameStreamer) && (g_FrameStreamer->HasClient() == true)))
+	{
+		CaptureFrame(packet);
+	}
+
+	// the overlay goes over the window after the readback, so the
+	// saved frames leave it out, and after the counters, so they
+	// leave out its draw
+	g_RenderCounters->EndFrame();
+	if (bStatsOverlay == true)
+	{
+		DrawStatsOverlay(packet, frameStartTime);
+	}
+	GLDebug::PopGroup();
+	g_GPUProfiler->EndPass(GPUProfiler::PASS_POST);
+	g_GPUProfiler->EndFrame();
+	// the passes and lists of the frame ran and its jobs are done,
+	// so what the threads took from their arenas goes at once
+	FrameArena::ResetAll();
+
+	// Flips the the back buffer with the front buffer every frame,
+	// paced by the presentation mode; a headless frame is only
+	// flushed, so the run measures the rendering alone
+	double cpuEndTime = glfwGetTime();
+	if (g_RenderTarget->IsHeadless() == true)
+	{
+		glFlush();
+	}
+	else
+	{
+		// the windows of the extra views are swapped first, without
+		// waiting, so the pacing of the main window shows them all
+		// with the same frame
+		for (int view = 1; view < viewCount; view++)
+		{
+			ViewWindow* pViewWindow = g_ViewManager->GetViewWindow(view);
+			if (NULL != pViewWindow)
+			{
+				pViewWindow->Present();
+			}
+		}
+		// the tiles of a wall wait for each other, so they change
+		// together
+		if (NULL != g_WallSync)
+		{
+			g_WallSync->SwapBarrier();
+		}
+		// the frame cap of a saving tier holds whatever the mode
+		g_FramePacer->SetPresentMode((g_PowerPolicy->GetActiveLimits().frameCap > 0.0) ?
+			(int)FramePacer::PRESENT_CAPPED : packet.presentMode);
+		g_FramePacer->Present(g_Window);
+	}
+	g_ViewManager->FramePresented(packet.inputTime);
+	// the exporter only copies the numbers of the frame; the
+	// scrapes are answered from its own thread
+	if (NULL != g_MetricsExporter)
+	{
+		const GPUProfiler::PASS_TIMES& passTimes = g_GPUProfiler->GetTimes();
+		MetricsExporter::FRAME_METRICS frameMetrics;
+		frameMetrics.cpuSeconds = cpuEndTime - frameStartTime;
+		memcpy(frameMetrics.gpuMilliseconds, passTimes.gpuMilliseconds, sizeof(frameMetrics.gpuMilliseconds));
+		frameMetrics.drawCalls = g_RenderCounters->GetLast(RenderCounters::COUNTER_DRAW_CALLS);
+		frameMetrics.instances = g_RenderCounters->GetLast(RenderCounters::COUNTER_INSTANCES);
+		frameMetrics.primitives = passTimes.primitives;
+		frameMetrics.captureDropped = g_FrameCapture->GetStats().dropped;
+		g_MetricsExporter->RecordFrame(glfwGetTime(), frameMetrics);
+		const PowerPolicy::POWER_STATE& powerState = g_PowerPolicy->GetState();
+		MetricsExporter::POWER_METRICS powerMetrics;
+		powerMetrics.tier = g_PowerPolicy->GetTier();
+		powerMetrics.bOnBattery = (powerState.source == PowerPolicy::SOURCE_BATTERY);
+		powerMetrics.batteryPercent = powerState.batteryPercent;
+		powerMetrics.temperature = powerState.temperature;
+		powerMetrics.bThrottled = powerState.bThrottled;
+		g_MetricsExporter->RecordPower(powerMetrics);
+	}
+	if (NULL != g_HitchCapture)
+	{
+		g_HitchCapture->EndFrame(cpuEndTime - frameStartTime);
+	}
+	UpdateQualityGovernor(cpuEndTime - frameStartTime);
+	if ((g_Benchmark != NULL) && (g_Benchmark->IsMeasuring() == true))
+	{
+		g_Benchmark->AddFrame(cpuEndTime - frameStartTime, glfwGetTime());
+	}
+	if (g_StartupTimer.IsSceneComplete() == false)
+	{
+		TimeStartupFrame();
+	}
+
+	GLTrace::EndFrame();
+	g_framesRendered++;
+	g_PowerPolicy->AddFrame(true);
+	g_settleFrames = (g_settleFrames > 0) ? g_settleFrames - 1 : 0;
+	return(true);
+}
+
+/***********************************************************
+ *  CaptureFrame()
+ *
+ *  This function is used for starting the readback of the
+ *  frame just drawn, before it is presented: the window's
+ *  back buffer, or the offscreen frame when headless. The
+ *  screenshots and the video frames are numbered apart. A
+ *  video frame that would wait for the GPU or the encoders
+ *  is dropped and keeps its number for the next one, so the
+ *  sequence stays gapless; a screenshot is always taken.
+ *  While a remote viewer is connected every frame is read
+ *  back for it too, dropped the same way.
+ ***********************************************************/
+void CaptureFrame(const ViewManager::FRAME_PACKET& packet)
+{
+	GLuint framebuffer = 0;
+	int width = packet.framebufferWidth;
+	int height = packet.framebufferHeight;
+	if (g_RenderTarget->IsHeadless() == true)
+	{
+		framebuffer = g_RenderTarget->GetFramebuffer();
+		width = g_RenderTarget->GetWidth();
+		height = g_RenderTarget->GetHeight();
+	}
+
+	char filename[1024];
+	if (packet.bScreenshot == true)
+	{
+		snprintf(filename, sizeof(filename), "%s/screenshot_%05llu.%s", g_captureDirectory, g_screenshots, g_captureFormat);
+		if (g_FrameCapture->Capture(framebuffer, width, height, filename) == true)
+		{
+			std::cout << "Screenshot " << filename << std::endl;
+			g_screenshots++;
+		}
+	}
+	if (packet.bVideoCapture == true)
+	{
+		snprintf(filename, sizeof(filename), "%s/video_%06llu.%s", g_captureDirectory, g_videoFrames, g_captureFormat);
+		if (g_FrameCapture->Capture(framebuffer, width, height, filename, true) == true)
+		{
+			g_videoFrames++;
+		}
+	}
+	// the frame of a remote viewer carries the newest input it took
+	if ((NULL != g_FrameStreamer) && (g_FrameStreamer->HasClient() == true))
+	{
+		g_FrameCapture->CaptureToSink(framebuffer, width, height, &FrameStreamer::FrameSink, g_FrameStreamer,
+			packet.streamInputId, true, FrameCapture::SINK_NV12);
+	}
+}
+
+/***********************************************************
+ *  DrawStatsOverlay()
+ *
+ *  This function is used for drawing the frame rate, the
+ *  time of every pass on the GPU and the CPU, and what the
+ *  frame submitted over the window. The pass times are
+ *  those of a frame a few frames back, read without waiting
+ *  for the GPU, and the counters are those of this frame.
+ ***********************************************************/
+void DrawStatsOverlay(const ViewManager::FRAME_PACKET& packet, double frameStartTime)
+{
+	double now = glfwGetTime();
+	if (g_overlayFrameTime >= 0.0)
+	{
+		g_overlayIntervalSeconds += (now - g_overlayFrameTime - g_overlayIntervalSeconds) * OVERLAY_SMOOTHING;
+	}
+	g_overlayFrameTime = now;
+	g_overlayCPUSeconds += (now - frameStartTime - g_overlayCPUSeconds) * OVERLAY_SMOOTHING;
+
+	const GPUProfiler::PASS_TIMES& times = g_GPUProfiler->GetTimes();
+
+	std::vector<std::string> lines;
+	char line[256];
+	snprintf(line, sizeof(line), "FPS %.1f   CPU %.2f MS   GPU %.2f MS",
+		(g_overlayIntervalSeconds > 0.0) ? 1.0 / g_overlayIntervalSeconds : 0.0,
+		g_overlayCPUSeconds * 1000.0, times.gpuFrameMilliseconds);
+	lines.push_back(line);
+	lines.push_back("PASS         GPU MS  CPU MS");
+	for (int pass = 0; pass < GPUProfiler::PASS_COUNT; pass++)
+	{
+		snprintf(line, sizeof(line), "%-12s %6.2f  %6.2f", GPUProfiler::GetPassName(pass),
+			times.gpuMilliseconds[pass], times.cpuMilliseconds[pass]);
+		lines.push_back(line);
+	}
+	snprintf(line, sizeof(line), "DRAWS %llu (%llu EL %llu AR %llu MDI)   INSTANCES %llu   TRIANGLES %llu",
+		g_RenderCounters->GetSummary(RenderCounters::COUNTER_DRAW_CALLS).last,
+		g_RenderCounters->GetSummary(RenderCounters::COUNTER_ELEMENT_DRAWS).last,
+		g_RenderCounters->GetSummary(RenderCounters::COUNTER_ARRAY_DRAWS).last,
+		g_RenderCounters->GetSummary(RenderCounters::COUNTER_INDIRECT_DRAWS).last,
+		g_RenderCounters->GetSummary(RenderCounters::COUNTER_INSTANCES).last, times.primitives);
+	lines.push_back(line);
+	snprintf(line, sizeof(line), "VAO %llu   PROGRAMS %llu   TEXTURES %llu   UNIFORMS %llu   UPLOAD %llu KB (INSTANCES %llu KB)",
+		g_RenderCounters->GetSummary(RenderCounters::COUNTER_VAO_BINDS).last,
+		g_RenderCounters->GetSummary(RenderCounters::COUNTER_PROGRAM_SWITCHES).last,
+		g_RenderCounters->GetSummary(RenderCounters::COUNTER_TEXTURE_BINDS).last,
+		g_RenderCounters->GetSummary(RenderCounters::COUNTER_UNIFORM_UPLOADS).last,
+		g_RenderCounters->GetSummary(RenderCounters::COUNTER_BUFFER_BYTES).last / 1024,
+		g_RenderCounters->GetSummary(RenderCounters::COUNTER_INSTANCE_BYTES).last / 1024);
+	lines.push_back(line);
+	snprintf(line, sizeof(line), "SCALE %.2f   %s", g_RenderTarget->GetRenderScale(),
+		FramePacer::GetPresentModeName(packet.presentMode));
+	lines.push_back(line);
+
+	g_StatsOverlay->Draw(lines, packet.framebufferWidth, packet.framebufferHeight);
+}
+
+/***********************************************************
+ *  TimeStartupFrame()
+ *
+ *  This function is used for ending the startup stages a
+ *  presented frame finished: the first frame, the shader
+ *  compiles once no program is pending and the streaming
+ *  once every texture and model of the scene arrived. The
+ *  first frame with all of them, and with the pipelines
+ *  warmed up after them, ends the startup, whose breakdown
+ *  is printed then.
+ ***********************************************************/
+void TimeStartupFrame()
+{
+	g_StartupTimer.FirstFrame();
+	g_StartupTimer.EndStage(g_firstFrameStage);
+	if (g_lastPendingPrograms == 0)
+	{
+		g_StartupTimer.EndStage(g_shaderCompileStage);
+	}
+	if (g_SceneManager->IsLoading() == false)
+	{
+		g_StartupTimer.EndStage(g_sceneStreamingStage);
+	}
+
+	// the pipelines are warmed up before the frame after these end,
+	// which then completes the startup
+	if ((g_StartupTimer.IsStageRunning(g_shaderCompileStage) == false) &&
+		(g_StartupTimer.IsStageRunning(g_sceneStreamingStage) == false) &&
+		((g_bPipelineWarmUp == false) || (g_warmUpDue == 0)))
+	{
+		g_StartupTimer.SceneComplete();
+		g_StartupTimer.Print();
+		TextureStreamer::PrintUploadStats();
+
+		// every artifact of the scene has now been read or written,
+		// so a snapshot missing or behind them is written whole
+		if ((g_warmStartPath.empty() == false) && (AssetPack::IsSnapshotStale() == true))
+		{
+			AssetPack::WriteSnapshot(g_warmStartPath.c_str());
+		}
+	}
+}
+
+/***********************************************************
+ *  JitterMainView()
+ *
+ *  This function is used for shifting the projection of the
+ *  main view by the subpixel offset of the temporal anti-
+ *  aliasing, for the size of the frame it is drawn into. A
+ *  stereo frame is not anti-aliased over time.
+ ***********************************************************/
+void JitterMainView(ViewManager::FRAME_PACKET& packet)
+{
+	if ((packet.bStereo == true) || (g_SceneManager->IsTemporalAntiAliasingActive() == false))
+	{
+		return;
+	}
+	packet.views[0].projection = g_SceneManager->JitterProjection(packet.views[0].projection,
+		g_RenderTarget->GetWidth(), g_RenderTarget->GetHeight());
+}
+
+/***********************************************************
+ *  CountAntiAliasingCost()
+ *
+ *  This function is used for adding the smoothed GPU frame
+ *  time of the render target's timer queries to the mode of
+ *  anti-aliasing it was drawn with. The time lags the frames
+ *  by the queries in flight and the smoothing, so the frames
+ *  right after a change of the mode are not counted.
+ ***********************************************************/
+void CountAntiAliasingCost(int antiAliasing)
+{
+	if (antiAliasing != g_lastAntiAliasing)
+	{
+		g_lastAntiAliasing = antiAliasing;
+		g_antiAliasingSettle = ANTI_ALIASING_SETTLE_FRAMES;
+		return;
+	}
+	if (g_antiAliasingSettle > 0)
+	{
+		g_antiAliasingSettle--;
+		return;
+	}
+	float milliseconds = g_RenderTarget->GetGPUMilliseconds();
+	if ((milliseconds > 0.0f) && (antiAliasing >= 0) && (antiAliasing < PostStack::AA_COUNT))
+	{
+		g_antiAliasingMilliseconds[antiAliasing] += milliseconds;
+		g_antiAliasingFrames[antiAliasing]++;
+	}
+}
+
+/***********************************************************
+ *  ApplyQualityGovernor()
+ *
+ *  This function is used for giving the governor the steps
+ *  each lever has below the settings asked for, which the
+ *  keys may have changed, and taking its levels off them:
+ *  the tier cap of the post effects, the LOD bias, the
+ *  shadow filtering, the shadow cascades, the anti-aliasing
+ *  mode and the render scale. The cascades are halved down
+ *  to the smallest side first, then dropped one by one down
+ *  to a single one. The render scale is left to the render
+ *  target while it follows a frame time target of its own.
+ ***********************************************************/
+void ApplyQualityGovernor(int& antiAliasing, int& shadowQuality)
+{
+	if (g_QualityGovernor->IsEnabled() == false)
+	{
+		return;
+	}
+
+	const PostStack& postStack = g_SceneManager->GetPostStack();
+	int postTier = PostStack::TIER_OFF;
+	for (int effect = 0; effect < PostStack::EFFECT_COUNT; effect++)
+	{
+		postTier = glm::max(postTier, postStack.GetRequestedTier(effect));
+	}
+	int antiAliasingSteps = 0;
+	for (int mode = antiAliasing; mode != PostStack::AA_NONE; mode = PostStack::GetCheaperAntiAliasing(mode))
+	{
+		antiAliasingSteps++;
+	}
+	int cascadeSizeSteps = 0;
+	for (int size = g_governorCascadeSize; (size / 2) >= CascadedShadows::MIN_CASCADE_SIZE; size /= 2)
+	{
+		cascadeSizeSteps++;
+	}
+	int renderScaleSteps = 0;
+	if (g_RenderTarget->IsDynamicScale() == false)
+	{
+		renderScaleSteps = (int)((g_governorRenderScale - RenderTarget::MIN_RENDER_SCALE) / GOVERNOR_RENDER_SCALE_STEP + 0.001f);
+	}
+	g_QualityGovernor->SetLeverSteps(QualityGovernor::LEVER_POST_EFFECTS, postTier - PostStack::TIER_LOW);
+	g_QualityGovernor->SetLeverSteps(QualityGovernor::LEVER_LOD_BIAS, GOVERNOR_LOD_LEVELS);
+	g_QualityGovernor->SetLeverSteps(QualityGovernor::LEVER_SHADOWS, shadowQuality - ShadowAtlas::SHADOW_QUALITY_LOW);
+	g_QualityGovernor->SetLeverSteps(QualityGovernor::LEVER_SHADOW_CASCADES, cascadeSizeSteps + g_governorShadowCascades - 1);
+	g_QualityGovernor->SetLeverSteps(QualityGovernor::LEVER_ANTI_ALIASING, antiAliasingSteps);
+	g_QualityGovernor->SetLeverSteps(QualityGovernor::LEVER_RENDER_SCALE, renderScaleSteps);
+
+	int postLevel = g_QualityGovernor->GetLevel(QualityGovernor::LEVER_POST_EFFECTS);
+	g_SceneManager->SetPostTierCap((postLevel > 0) ? (postTier - postLevel) : (int)PostStack::TIER_HIGH);
+	g_SceneManager->SetLODBias((float)g_QualityGovernor->GetLevel(QualityGovernor::LEVER_LOD_BIAS));
+	shadowQuality -= g_QualityGovernor->GetLevel(QualityGovernor::LEVER_SHADOWS);
+	int cascadeLevel = g_QualityGovernor->GetLevel(QualityGovernor::LEVER_SHADOW_CASCADES);
+	int cascadeSizeLevel = glm::min(cascadeLevel, cascadeSizeSteps);
+	g_SceneManager->SetShadowCascades(g_governorShadowCascades - (cascadeLevel - cascadeSizeLevel),
+		g_governorCascadeSize >> cascadeSizeLevel);
+	for (int step = 0; step < g_QualityGovernor->GetLevel(QualityGovernor::LEVER_ANTI_ALIASING); step++)
+	{
+		antiAliasing = PostStack::GetCheaperAntiAliasing(antiAliasing);
+	}
+	if (g_RenderTarget->IsDynamicScale() == false)
+	{
+		g_RenderTarget->SetRenderScale(g_governorRenderScale -
+			GOVERNOR_RENDER_SCALE_STEP * (float)g_QualityGovernor->GetLevel(QualityGovernor::LEVER_RENDER_SCALE));
+	}
+}
+
+/***********************************************************
+ *  UpdateQualityGovernor()
+ *
+ *  This function is used for handing the governor the CPU
+ *  time of the frame, the smoothed GPU time of the render
+ *  target and the pass times of the profiler, and printing
+ *  the change it made, if any, so the log of a run shows
+ *  what the machine traded away.
+ ***********************************************************/
+void UpdateQualityGovernor(double cpuSeconds)
+{
+	if (g_QualityGovernor->IsEnabled() == false)
+	{
+		return;
+	}
+
+	const float* passMilliseconds = (g_GPUProfiler->GetFramesTimed() > 0) ?
+		g_GPUProfiler->GetTimes().gpuMilliseconds : NULL;
+	if (g_QualityGovernor->AddFrame((float)(cpuSeconds * 1000.0), g_RenderTarget->GetGPUMilliseconds(), passMilliseconds) == true)
+	{
+		const QualityGovernor::DECISION& decision = g_QualityGovernor->GetDecisions().back();
+		std::cout << "Quality governor " << ((decision.toLevel > decision.fromLevel) ? "dropped " : "restored ")
+			<< QualityGovernor::GetLeverName(decision.lever) << " to step " << decision.toLevel
+			<< " of " << g_QualityGovernor->GetLeverSteps(decision.lever)
+			<< " (cpu " << decision.cpuMilliseconds << " ms, gpu " << decision.gpuMilliseconds
+			<< " ms, target " << g_QualityGovernor->GetTarget() << " ms)" << std::endl;
+	}
+}
+
+/***********************************************************
+ *  UpdatePowerPolicy()
+ *
+ *  This function is used for reading the power state when
+ *  it is due and, when the tier changed, setting the frame
+ *  cap and render scale asked for, lowered to those of the
+ *  tier. The governor trades the render scale down from the
+ *  lowered one; a dynamic render scale follows its own
+ *  target and is left alone.
+ ***********************************************************/
+void UpdatePowerPolicy()
+{
+	if (g_PowerPolicy->Update(glfwGetTime()) == false)
+	{
+		return;
+	}
+
+	const PowerPolicy::TIER_LIMITS& limits = g_PowerPolicy->GetActiveLimits();
+	const PowerPolicy::POWER_STATE& state = g_PowerPolicy->GetState();
+	char battery[16] = "";
+	char temperature[16] = "";
+	if (state.batteryPercent >= 0)
+	{
+		snprintf(battery, sizeof(battery), " %d%%", state.batteryPercent);
+	}
+	if (state.temperature >= 0.0f)
+	{
+		snprintf(temperature, sizeof(temperature), ", %.0f C", state.temperature);
+	}
+	LOG_INFO("Power policy %s (%s%s%s%s)", PowerPolicy::GetTierName(g_PowerPolicy->GetTier()),
+		(state.source == PowerPolicy::SOURCE_BATTERY) ? "battery" :
+			(state.source == PowerPolicy::SOURCE_AC) ? "AC" : "no battery",
+		battery, temperature, (state.bThrottled == true) ? ", throttled" : "");
+
+	g_FramePacer->SetFrameCap((limits.frameCap > 0.0) ? glm::min(g_powerFrameCap, limits.frameCap) : g_powerFrameCap);
+	g_governorRenderScale = glm::min(g_powerRenderScale, limits.renderScale);
+	if ((g_RenderTarget->IsDynamicScale() == false) && (g_QualityGovernor->IsEnabled() == false))
+	{
+		g_RenderTarget->SetRenderScale(g_governorRenderScale);
+	}
+}
+
+/***********************************************************
+ *  ApplyPowerPolicy()
+ *
+ *  This function is used for holding the settings of the
+ *  frame to the limits of the power tier, after the
+ *  governor took its levels off them: the lower of the two
+ *  caps of the post effects, the shadow filtering, and the
+ *  cheaper anti-aliasing modes.
+ ***********************************************************/
+void ApplyPowerPolicy(int& antiAliasing, int& shadowQuality)
+{
+	if (g_PowerPolicy->IsEnabled() == false)
+	{
+		return;
+	}
+
+	const PowerPolicy::TIER_LIMITS& limits = g_PowerPolicy->GetActiveLimits();
+	int postTierCap = (g_QualityGovernor->IsEnabled() == true) ?
+		g_SceneManager->GetPostStack().GetTierCap() : (int)PostStack::TIER_HIGH;
+	g_SceneManager->SetPostTierCap(glm::min(postTierCap, limits.postTier));
+	if (shadowQuality > ShadowAtlas::SHADOW_QUALITY_OFF)
+	{
+		shadowQuality = glm::min(shadowQuality, limits.shadowQuality);
+	}
+	for (int step = 0; step < limits.antiAliasingSteps; step++)
+	{
+		antiAliasing = PostStack::GetCheaperAntiAliasing(antiAliasing);
+	}
+}
+
+/***********************************************************
+ *  RenderLoop()
+ *
+ *  This function is used as the body of the render thread.
+ *  It renders the newest packet the main thread published,
+ *  or the last one again when none came, so frames keep
+ *  coming while the main thread is held up in the event
+ *  loop, and waits whenever a frame is skipped as unchanged.
+ ***********************************************************/
+void RenderLoop(RenderThread* pThread)
+{
+	glfwMakeContextCurrent(g_Window);
+	ScopeProfiler::SetThreadName("render");
+
+	ViewManager::FRAME_PACKET packet;
+	bool bHasPacket = false;
+	double waitSeconds = IDLE_WAIT_SECONDS;
+	while (pThread->IsRunning() == true)
+	{
+		if (pThread->Take(packet, waitSeconds) == true)
+		{
+			bHasPacket = true;
+		}
+		if (bHasPacket == false)
+		{
+			continue;
+		}
+
+		if (RenderFramePacket(packet, false) == true)
+		{
+			// rendered again, the packet is no change and no input
+			packet.bViewChanged = false;
+			packet.inputTime = -1.0;
+			packet.bScreenshot = false;
+			packet.bPick = false;
+			waitSeconds = 0.0;
+		}
+		else
+		{
+			waitSeconds = (g_lastPendingPrograms > 0) ? PENDING_PROGRAMS_WAIT_SECONDS : IDLE_WAIT_SECONDS;
+			g_FramePacer->ResetPacing();
+			if (NULL != g_MetricsExporter)
+			{
+				g_MetricsExporter->ResetInterval();
+			}
+			if (NULL != g_HitchCapture)
+			{
+				g_HitchCapture->ResetInterval();
+			}
+		}
+	}
+
+	glfwMakeContextCurrent(NULL);
+}
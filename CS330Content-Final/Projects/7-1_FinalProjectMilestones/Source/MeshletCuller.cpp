@@ -0,0 +1,484 @@
+///////////////////////////////////////////////////////////////////////////////
+// meshletculler.cpp
+// ============
+// GPU culling of the meshlets of the batches drawn with multi-draw indirect
+//
+//  The culling tests follow "Optimizing the Graphics Pipeline with
+//  Compute", Wihlidal 2016, with the Hi-Z test of the occlusion culling.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "MeshletCuller.h"
+#include "GPUMemory.h"
+
+#include <GLFW/glfw3.h>
+
+namespace
+{
+	// work group sizes declared by the compute and task shaders
+	const int CULL_GROUP_SIZE = 64;
+	const int TASK_GROUP_SIZE = 32;
+
+	// storage bindings declared by the compute, task and mesh shaders
+	const GLuint MESHLETS_BINDING = 0;
+	const GLuint MESHLET_VERTICES_BINDING = 1;
+	const GLuint MESHLET_TRIANGLES_BINDING = 2;
+	const GLuint ARENA_VERTICES_BINDING = 3;
+	const GLuint BATCHES_BINDING = 4;
+	const GLuint COMMANDS_BINDING = 5;
+	const GLuint COMMAND_COUNTS_BINDING = 6;
+}
+
+/***********************************************************
+ *  MeshletCuller()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+MeshletCuller::MeshletCuller(ShaderManager* pShaderManager)
+{
+	m_pShaderManager = pShaderManager;
+	m_cullProgram = 0;
+	m_instanceDataLocation = -1;
+	m_instanceBaseLocation = -1;
+	m_pyramidViewProjectionLocation = -1;
+	m_pyramidValidLocation = -1;
+	m_batchCountLocation = -1;
+	m_workCountLocation = -1;
+	m_compactLocation = -1;
+	m_instanceDataUnit = 0;
+	m_shadowAtlasUnit = 0;
+	m_cascadeUnit = 0;
+	m_probeUnit = 0;
+	m_textureArrayUnit = 0;
+	m_bIndirectCount = false;
+	m_commandCount = 0;
+	m_batchBuffer = 0;
+	m_commandBuffer = 0;
+	m_countBuffer = 0;
+	m_pDrawMeshTasks = NULL;
+}
+
+/***********************************************************
+ *  ~MeshletCuller()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+MeshletCuller::~MeshletCuller()
+{
+	GLuint buffers[3] = { m_batchBuffer, m_commandBuffer, m_countBuffer };
+	for (int i = 0; i < 3; i++)
+	{
+		if (0 != buffers[i])
+		{
+			GPUMemory::DeleteBuffers(1, &buffers[i]);
+		}
+	}
+	m_batchBuffer = 0;
+	m_commandBuffer = 0;
+	m_countBuffer = 0;
+	if (0 != m_cullProgram)
+	{
+		glDeleteProgram(m_cullProgram);
+		m_cullProgram = 0;
+	}
+	for (size_t i = 0; i < m_meshPrograms.size(); i++)
+	{
+		if (0 != m_meshPrograms[i].program)
+		{
+			glDeleteProgram(m_meshPrograms[i].program);
+		}
+	}
+	m_meshPrograms.clear();
+	m_pShaderManager = NULL;
+}
+
+/***********************************************************
+ *  Create()
+ *
+ *  This method is used for building the compute program of
+ *  the meshlet culling. Like the occlusion culling it needs
+ *  OpenGL 4.3. The visible meshlets are compacted to the
+ *  front of the region of their batch when the draws can
+ *  read their count from a buffer, which came with 4.6 and
+ *  ARB_indirect_parameters.
+ ***********************************************************/
+bool MeshletCuller::Create(const char* cullShaderPath)
+{
+	if ((NULL == m_pShaderManager) || (GLEW_VERSION_4_3 != GL_TRUE))
+	{
+		return(false);
+	}
+
+	m_cullProgram = m_pShaderManager->LoadComputeShader(cullShaderPath);
+	if (0 == m_cullProgram)
+	{
+		std::cout << "Meshlet culling disabled, its compute shader did not build" << std::endl;
+		return(false);
+	}
+
+	m_instanceDataLocation = glGetUniformLocation(m_cullProgram, "instanceData");
+	m_instanceBaseLocation = glGetUniformLocation(m_cullProgram, "instanceBase");
+	m_pyramidViewProjectionLocation = glGetUniformLocation(m_cullProgram, "pyramidViewProjection");
+	m_pyramidValidLocation = glGetUniformLocation(m_cullProgram, "bPyramidValid");
+	m_batchCountLocation = glGetUniformLocation(m_cullProgram, "batchCount");
+	m_workCountLocation = glGetUniformLocation(m_cullProgram, "workCount");
+	m_compactLocation = glGetUniformLocation(m_cullProgram, "bCompact");
+
+	m_bIndirectCount = (GLEW_VERSION_4_6 == GL_TRUE) || (GLEW_ARB_indirect_parameters == GL_TRUE);
+
+	glGenBuffers(1, &m_batchBuffer);
+	glGenBuffers(1, &m_commandBuffer);
+	glGenBuffers(1, &m_countBuffer);
+
+	return(true);
+}
+
+/***********************************************************
+ *  CreateMeshShading()
+ *
+ *  This method is used for keeping the task, mesh and
+ *  fragment shader files of the mesh shading path when the
+ *  context has GL_NV_mesh_shader. The programs need the
+ *  defines of each permutation, so they are built when a
+ *  permutation is first drawn with them.
+ ***********************************************************/
+bool MeshletCuller::CreateMeshShading(
+	const char* taskShaderPath,
+	const char* meshShaderPath,
+	const char* fragmentShaderPath)
+{
+	if (IsAvailable() == false)
+	{
+		return(false);
+	}
+
+	bool bSupported = false;
+	GLint extensionCount = 0;
+	glGetIntegerv(GL_NUM_EXTENSIONS, &extensionCount);
+	for (GLint i = 0; (i < extensionCount) && (bSupported == false); i++)
+	{
+		const char* pExtension = (const char*)glGetStringi(GL_EXTENSIONS, (GLuint)i);
+		bSupported = (NULL != pExtension) && (strcmp(pExtension, "GL_NV_mesh_shader") == 0);
+	}
+	if (bSupported == false)
+	{
+		return(false);
+	}
+
+	m_pDrawMeshTasks = (DrawMeshTasksProc)glfwGetProcAddress("glDrawMeshTasksNV");
+	if (NULL == m_pDrawMeshTasks)
+	{
+		return(false);
+	}
+
+	m_taskShaderPath = taskShaderPath;
+	m_meshShaderPath = meshShaderPath;
+	m_fragmentShaderPath = fragmentShaderPath;
+
+	MESH_PROGRAM program;
+	program.program = 0;
+	program.bFailed = false;
+	m_meshPrograms.assign(ShaderManager::PERMUTATION_COUNT, program);
+
+	return(true);
+}
+
+/***********************************************************
+ *  SetTextureUnits()
+ *
+ *  This method is used for setting the texture units the
+ *  scene binds the instance buffer, the shadow atlas, the
+ *  shadow cascades, the reflection probes and the texture
+ *  array to, which the programs sample.
+ ***********************************************************/
+void MeshletCuller::SetTextureUnits(int instanceDataUnit, int shadowAtlasUnit, int cascadeUnit, int probeUnit,
+	int textureArrayUnit)
+{
+	m_instanceDataUnit = instanceDataUnit;
+	m_shadowAtlasUnit = shadowAtlasUnit;
+	m_cascadeUnit = cascadeUnit;
+	m_probeUnit = probeUnit;
+	m_textureArrayUnit = textureArrayUnit;
+}
+
+/***********************************************************
+ *  SetBatches()
+ *
+ *  This method is used for uploading the batches drawing
+ *  meshlets and sizing the commands for them: each batch
+ *  gets a region with room for every meshlet of every
+ *  instance, and a count the culling appends to. It is
+ *  called whenever the render list batches are rebuilt.
+ ***********************************************************/
+void MeshletCuller::SetBatches(const std::vector<MESHLET_BATCH>& batches)
+{
+	if (IsAvailable() == false)
+	{
+		return;
+	}
+
+	m_batches = batches;
+	m_firstCommands.resize(batches.size());
+	m_commandCount = 0;
+
+	std::vector<GLuint> batchData(8 * batches.size(), 0);
+	for (size_t i = 0; i < batches.size(); i++)
+	{
+		m_firstCommands[i] = m_commandCount;
+		batchData[8 * i] = batches[i].firstInstance;
+		batchData[8 * i + 1] = batches[i].instanceCount;
+		batchData[8 * i + 2] = batches[i].firstMeshlet;
+		batchData[8 * i + 3] = batches[i].meshletCount;
+		batchData[8 * i + 4] = m_commandCount;
+		m_commandCount += batches[i].instanceCount * batches[i].meshletCount;
+	}
+	if (batches.empty() == true)
+	{
+		return;
+	}
+
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_batchBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, batchData.size() * sizeof(GLuint),
+		batchData.data(), GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_commandBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, (GLsizeiptr)m_commandCount * sizeof(ShapeMeshes::INDIRECT_COMMAND),
+		NULL, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_countBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, batches.size() * sizeof(GLuint), NULL, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	GPUMemory::TrackBuffer(m_batchBuffer, batchData.size() * sizeof(GLuint), GPUMemory::CATEGORY_BUFFER, "meshlet batches");
+	GPUMemory::TrackBuffer(m_commandBuffer, (GLsizeiptr)m_commandCount * sizeof(ShapeMeshes::INDIRECT_COMMAND),
+		GPUMemory::CATEGORY_BUFFER, "meshlet commands");
+	GPUMemory::TrackBuffer(m_countBuffer, batches.size() * sizeof(GLuint), GPUMemory::CATEGORY_BUFFER, "meshlet counts");
+}
+
+/***********************************************************
+ *  BindMeshletBuffers()
+ *
+ *  This method is used for binding the meshlets of the
+ *  arena, their vertices and triangles, and the arena
+ *  vertices the mesh shaders fetch. The meshlet arrays may
+ *  be ranges of shared buffer pages, which move when the
+ *  pages are defragmented, so they are looked up here.
+ ***********************************************************/
+void MeshletCuller::BindMeshletBuffers(const ShapeMeshes& meshes)
+{
+	const BufferAllocator::RANGE ranges[3] =
+	{
+		meshes.GetMeshletBuffer(),
+		meshes.GetMeshletVertexBuffer(),
+		meshes.GetMeshletTriangleBuffer()
+	};
+	const GLuint bindings[3] = { MESHLETS_BINDING, MESHLET_VERTICES_BINDING, MESHLET_TRIANGLES_BINDING };
+	for (int i = 0; i < 3; i++)
+	{
+		glBindBufferRange(GL_SHADER_STORAGE_BUFFER, bindings[i], ranges[i].buffer, ranges[i].offset, ranges[i].size);
+	}
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, ARENA_VERTICES_BINDING, meshes.GetArenaVertexBuffer());
+}
+
+/***********************************************************
+ *  SetPyramid()
+ *
+ *  This method is used for binding the depth pyramid of the
+ *  occlusion culling and telling the active program whether
+ *  there is one to test against yet.
+ ***********************************************************/
+void MeshletCuller::SetPyramid(
+	GLint viewProjectionLocation,
+	GLint validLocation,
+	const OcclusionCuller& occlusionCuller)
+{
+	bool bPyramidValid = occlusionCuller.IsPyramidValid();
+	glUniform1i(validLocation, (bPyramidValid == true) ? 1 : 0);
+	if (bPyramidValid == true)
+	{
+		m_pShaderManager->BindTexture(OcclusionCuller::DEPTH_PYRAMID_TEXTURE_UNIT,
+			occlusionCuller.GetPyramidTexture());
+		glUniformMatrix4fv(viewProjectionLocation, 1, GL_FALSE,
+			&occlusionCuller.GetPyramidViewProjection()[0][0]);
+	}
+}
+
+/***********************************************************
+ *  CullBatches()
+ *
+ *  This method is used for testing every meshlet of every
+ *  instance of the batches on the GPU, one invocation each.
+ *  With the counts read by the draws the visible meshlets
+ *  are appended to the region of their batch, so the
+ *  counts start from zero every frame; without them each
+ *  meshlet writes its own command every frame, with no
+ *  instance when it is hidden. The barrier makes the
+ *  following draws read the written commands and counts.
+ ***********************************************************/
+void MeshletCuller::CullBatches(
+	const ShapeMeshes& meshes,
+	int instanceBase,
+	const OcclusionCuller& occlusionCuller)
+{
+	if ((IsAvailable() == false) || (0 == m_commandCount) || (0 == meshes.GetMeshletBuffer().buffer))
+	{
+		return;
+	}
+
+	if (m_bIndirectCount == true)
+	{
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_countBuffer);
+		glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, NULL);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	}
+
+	m_pShaderManager->UseExternalProgram(m_cullProgram);
+	glUniform1i(m_instanceDataLocation, m_instanceDataUnit);
+	glUniform1i(m_instanceBaseLocation, instanceBase);
+	glUniform1ui(m_batchCountLocation, (GLuint)m_batches.size());
+	glUniform1ui(m_workCountLocation, m_commandCount);
+	glUniform1i(m_compactLocation, (m_bIndirectCount == true) ? 1 : 0);
+	SetPyramid(m_pyramidViewProjectionLocation, m_pyramidValidLocation, occlusionCuller);
+
+	BindMeshletBuffers(meshes);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, BATCHES_BINDING, m_batchBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, COMMANDS_BINDING, m_commandBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, COMMAND_COUNTS_BINDING, m_countBuffer);
+	glDispatchCompute((m_commandCount + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE, 1, 1);
+	glMemoryBarrier(GL_COMMAND_BARRIER_BIT);
+}
+
+/***********************************************************
+ *  DrawBatch()
+ *
+ *  This method is used for drawing the commands the culling
+ *  wrote for one batch with one call, reading how many
+ *  there are from the count of the batch when the context
+ *  can. The commands carry the instance as base instance,
+ *  so the bound program finds it the way it finds the
+ *  instances of the other indirect commands.
+ ***********************************************************/
+void MeshletCuller::DrawBatch(int batch, GLuint vao, GLenum indexType)
+{
+	if ((batch < 0) || (batch >= (int)m_batches.size()))
+	{
+		return;
+	}
+
+	const MESHLET_BATCH& meshletBatch = m_batches[batch];
+	const void* commandOffset = (void*)((GLintptr)m_firstCommands[batch] * sizeof(ShapeMeshes::INDIRECT_COMMAND));
+	GLsizei maxCount = (GLsizei)(meshletBatch.instanceCount * meshletBatch.meshletCount);
+
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_commandBuffer);
+	ShapeMeshes::BindVertexArray(vao);
+	if (m_bIndirectCount == false)
+	{
+		glMultiDrawElementsIndirect(GL_TRIANGLES, indexType, commandOffset, maxCount,
+			sizeof(ShapeMeshes::INDIRECT_COMMAND));
+		return;
+	}
+
+	glBindBuffer(GL_PARAMETER_BUFFER, m_countBuffer);
+	GLintptr countOffset = (GLintptr)batch * sizeof(GLuint);
+	if (GLEW_VERSION_4_6 == GL_TRUE)
+	{
+		glMultiDrawElementsIndirectCount(GL_TRIANGLES, indexType, commandOffset, countOffset, maxCount,
+			sizeof(ShapeMeshes::INDIRECT_COMMAND));
+	}
+	else
+	{
+		glMultiDrawElementsIndirectCountARB(GL_TRIANGLES, indexType, commandOffset, countOffset, maxCount,
+			sizeof(ShapeMeshes::INDIRECT_COMMAND));
+	}
+	glBindBuffer(GL_PARAMETER_BUFFER, 0);
+}
+
+/***********************************************************
+ *  GetMeshProgram()
+ *
+ *  This method is used for building the task and mesh
+ *  shader program of a permutation the first time it is
+ *  drawn, and finding the uniforms the draws set. A program
+ *  that fails is reported once and not tried again.
+ ***********************************************************/
+const MeshletCuller::MESH_PROGRAM* MeshletCuller::GetMeshProgram(int permutation)
+{
+	if ((permutation < 0) || (permutation >= (int)m_meshPrograms.size()))
+	{
+		return(NULL);
+	}
+
+	MESH_PROGRAM& program = m_meshPrograms[permutation];
+	if ((0 == program.program) && (program.bFailed == false))
+	{
+		program.program = m_pShaderManager->LoadMeshShaderProgram(m_taskShaderPath.c_str(),
+			m_meshShaderPath.c_str(), m_fragmentShaderPath.c_str(), permutation);
+		if (0 == program.program)
+		{
+			std::cout << "Mesh shading disabled for permutation " << permutation
+				<< ", its program did not build" << std::endl;
+			program.bFailed = true;
+			return(NULL);
+		}
+
+		GLuint id = program.program;
+		program.instanceDataLocation = glGetUniformLocation(id, "instanceData");
+		program.shadowAtlasLocation = glGetUniformLocation(id, "shadowAtlas");
+		program.cascadeLocation = glGetUniformLocation(id, "cascadeShadowMap");
+		program.probeLocation = glGetUniformLocation(id, "reflectionProbes");
+		program.textureArrayLocation = glGetUniformLocation(id, "textureArray");
+		program.instanceBaseLocation = glGetUniformLocation(id, "instanceBase");
+		program.firstMeshletLocation = glGetUniformLocation(id, "firstMeshlet");
+		program.meshletCountLocation = glGetUniformLocation(id, "meshletCount");
+		program.taskGroupsLocation = glGetUniformLocation(id, "taskGroups");
+		program.pyramidViewProjectionLocation = glGetUniformLocation(id, "pyramidViewProjection");
+		program.pyramidValidLocation = glGetUniformLocation(id, "bPyramidValid");
+	}
+
+	return((0 != program.program) ? &program : NULL);
+}
+
+/***********************************************************
+ *  DrawMeshTasks()
+ *
+ *  This method is used for drawing a batch with the mesh
+ *  shading path, one task work group per TASK_GROUP_SIZE
+ *  meshlets of each instance. The task shaders run the
+ *  tests of the compute culling and launch a mesh work
+ *  group for each meshlet that passes, so nothing goes
+ *  through the command buffers.
+ ***********************************************************/
+bool MeshletCuller::DrawMeshTasks(
+	int batch,
+	int permutation,
+	const ShapeMeshes& meshes,
+	int instanceBase,
+	const OcclusionCuller& occlusionCuller)
+{
+	if ((HasMeshShading() == false) || (batch < 0) || (batch >= (int)m_batches.size()) ||
+		(0 == meshes.GetMeshletBuffer().buffer))
+	{
+		return(false);
+	}
+	const MESH_PROGRAM* pProgram = GetMeshProgram(permutation);
+	if (NULL == pProgram)
+	{
+		return(false);
+	}
+
+	const MESHLET_BATCH& meshletBatch = m_batches[batch];
+	GLuint taskGroups = (meshletBatch.meshletCount + TASK_GROUP_SIZE - 1) / TASK_GROUP_SIZE;
+
+	m_pShaderManager->UseExternalProgram(pProgram->program);
+	glUniform1i(pProgram->instanceDataLocation, m_instanceDataUnit);
+	glUniform1i(pProgram->shadowAtlasLocation, m_shadowAtlasUnit);
+	glUniform1i(pProgram->cascadeLocation, m_cascadeUnit);
+	glUniform1i(pProgram->probeLocation, m_probeUnit);
+	glUniform1i(pProgram->textureArrayLocation, m_textureArrayUnit);
+	glUniform1i(pProgram->instanceBaseLocation, instanceBase + (int)meshletBatch.firstInstance);
+	glUniform1ui(pProgram->firstMeshletLocation, meshletBatch.firstMeshlet);
+	glUniform1ui(pProgram->meshletCountLocation, meshletBatch.meshletCount);
+	glUniform1ui(pProgram->taskGroupsLocation, taskGroups);
+	SetPyramid(pProgram->pyramidViewProjectionLocation, pProgram->pyramidValidLocation, occlusionCuller);
+
+	BindMeshletBuffers(meshes);
+	m_pDrawMeshTasks(0, taskGroups * meshletBatch.instanceCount);
+
+	return(true);
+}
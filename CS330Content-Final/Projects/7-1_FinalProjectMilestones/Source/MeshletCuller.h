@@ -0,0 +1,162 @@
+///////////////////////////////////////////////////////////////////////////////
+// meshletculler.h
+// ============
+// GPU culling of the meshlets of the batches drawn with multi-draw indirect
+//
+//  The batches of meshes split into meshlets are culled a meshlet at a
+//  time instead of a whole mesh at a time: a compute pass tests every
+//  meshlet of every instance against the view frustum, the cone of its
+//  triangle normals and the depth pyramid of the occlusion culling, and
+//  appends one indirect command per visible meshlet to the region of
+//  its batch. With GL_NV_mesh_shader the batches can instead be drawn
+//  by task shaders running the same tests and mesh shaders emitting
+//  only the meshlets that pass.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "ShaderManager.h"
+#include "OcclusionCuller.h"
+#include "ShapeMeshes.h"
+
+#include <string>
+#include <vector>
+
+/***********************************************************
+ *  MeshletCuller
+ *
+ *  This class contains the compute program, the command
+ *  buffers and the mesh shader programs of the meshlet
+ *  culling. The batches are set whenever the render list
+ *  batches are rebuilt, culled once per frame, and then
+ *  drawn one batch at a time.
+ ***********************************************************/
+class MeshletCuller
+{
+public:
+	// constructor
+	MeshletCuller(ShaderManager* pShaderManager);
+	// destructor
+	~MeshletCuller();
+
+	// one render list batch drawing a mesh range split into meshlets
+	struct MESHLET_BATCH
+	{
+		uint32_t firstInstance;	// first entry of the frame's instances
+		uint32_t instanceCount;
+		uint32_t firstMeshlet;	// into the meshlets of ShapeMeshes
+		uint32_t meshletCount;
+	};
+
+	// build the compute program; false when the context has no
+	// compute shaders or the program fails to build
+	bool Create(const char* cullShaderPath);
+	bool IsAvailable() const { return(0 != m_cullProgram); }
+	// keep the shaders the mesh shader programs are built from,
+	// one permutation at a time when first drawn; false without
+	// GL_NV_mesh_shader
+	bool CreateMeshShading(
+		const char* taskShaderPath,
+		const char* meshShaderPath,
+		const char* fragmentShaderPath);
+	bool HasMeshShading() const { return(NULL != m_pDrawMeshTasks); }
+
+	// texture units the programs read the instances, the shadow
+	// atlas, the shadow cascades, the reflection probes and the
+	// texture array from
+	void SetTextureUnits(int instanceDataUnit, int shadowAtlasUnit, int cascadeUnit, int probeUnit,
+		int textureArrayUnit);
+
+	// set the batches culled and drawn from now on
+	void SetBatches(const std::vector<MESHLET_BATCH>& batches);
+	size_t GetBatchCount() const { return(m_batches.size()); }
+
+	// cull the meshlets of every batch for the frame whose instances
+	// start at instanceBase, testing against the pyramid when the
+	// occlusion culling has one
+	void CullBatches(
+		const ShapeMeshes& meshes,
+		int instanceBase,
+		const OcclusionCuller& occlusionCuller);
+	// draw the visible meshlets of a batch with the bound program;
+	// leaves the command buffer bound to GL_DRAW_INDIRECT_BUFFER
+	void DrawBatch(int batch, GLuint vao, GLenum indexType);
+	// cull and draw a batch with the task and mesh shaders of a
+	// permutation; false, drawing nothing, when its program failed
+	bool DrawMeshTasks(
+		int batch,
+		int permutation,
+		const ShapeMeshes& meshes,
+		int instanceBase,
+		const OcclusionCuller& occlusionCuller);
+
+private:
+	// glDrawMeshTasksNV(), looked up by name since GLEW predates it
+	typedef void (GLAPIENTRY* DrawMeshTasksProc)(GLuint first, GLuint count);
+
+	// pointer to shader manager object
+	ShaderManager* m_pShaderManager;
+	// compute program testing the meshlets
+	GLuint m_cullProgram;
+	GLint m_instanceDataLocation;
+	GLint m_instanceBaseLocation;
+	GLint m_pyramidViewProjectionLocation;
+	GLint m_pyramidValidLocation;
+	GLint m_batchCountLocation;
+	GLint m_workCountLocation;
+	GLint m_compactLocation;
+	// texture units set by SetTextureUnits()
+	int m_instanceDataUnit;
+	int m_shadowAtlasUnit;
+	int m_cascadeUnit;
+	int m_probeUnit;
+	int m_textureArrayUnit;
+	// true when the count of each batch is read by the GPU, with
+	// GL 4.6 or ARB_indirect_parameters; otherwise every meshlet
+	// keeps its command and the hidden ones draw no instance
+	bool m_bIndirectCount;
+	// the batches, the command region each starts at, and the
+	// regions' total; the batch buffer holds two uvec4 per batch
+	std::vector<MESHLET_BATCH> m_batches;
+	std::vector<uint32_t> m_firstCommands;
+	uint32_t m_commandCount;
+	GLuint m_batchBuffer;
+	GLuint m_commandBuffer;
+	GLuint m_countBuffer;
+
+	// a task and mesh shader program and its uniforms
+	struct MESH_PROGRAM
+	{
+		GLuint program;
+		bool bFailed;	// did not build, never tried again
+		GLint instanceDataLocation;
+		GLint shadowAtlasLocation;
+		GLint cascadeLocation;
+		GLint probeLocation;
+		GLint textureArrayLocation;
+		GLint instanceBaseLocation;
+		GLint firstMeshletLocation;
+		GLint meshletCountLocation;
+		GLint taskGroupsLocation;
+		GLint pyramidViewProjectionLocation;
+		GLint pyramidValidLocation;
+	};
+
+	// mesh shading: the shader files, the program of each
+	// permutation, built on first use, and the entry point
+	std::string m_taskShaderPath;
+	std::string m_meshShaderPath;
+	std::string m_fragmentShaderPath;
+	std::vector<MESH_PROGRAM> m_meshPrograms;
+	DrawMeshTasksProc m_pDrawMeshTasks;
+
+	// bind the meshlet buffers of the arena to the storage bindings
+	// the compute, task and mesh shaders share
+	void BindMeshletBuffers(const ShapeMeshes& meshes);
+	// bind the depth pyramid and set the uniforms reading it
+	void SetPyramid(GLint viewProjectionLocation, GLint validLocation,
+		const OcclusionCuller& occlusionCuller);
+	// the mesh shader program of a permutation, built the first
+	// time; NULL when it did not build
+	const MESH_PROGRAM* GetMeshProgram(int permutation);
+};
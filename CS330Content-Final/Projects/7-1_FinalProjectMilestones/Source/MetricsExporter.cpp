@@ -0,0 +1,536 @@
+///////////////////////////////////////////////////////////////////////////////
+// metricsexporter.cpp
+// ============
+// the frame statistics served over HTTP in the Prometheus text format
+//
+//  The renderer hands its numbers over once per frame: the interval
+//  since the frame before, the CPU time of the frame, the GPU time of
+//  each pass, the draw counters, the video memory, the depth of the
+//  streaming queues and the frames dropped. That only copies them
+//  under a lock; a thread of its own answers the scrapes, sorting the
+//  window of frame intervals into percentiles and formatting the page
+//  there, so a scrape never holds up a frame. The page is served at
+//  /metrics in the Prometheus text format, which OpenMetrics scrapers
+//  read as well.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "MetricsExporter.h"
+#include "NetSocket.h"
+#include "ScopeProfiler.h"
+#include "Logger.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+namespace
+{
+	const uintptr_t NO_SOCKET = NetSocket::INVALID_HANDLE;
+
+	// longest the serving thread waits before checking the stop
+	const long POLL_MICROSECONDS = 100000;
+	// a request longer than this is no scrape, and is dropped
+	const size_t MAX_REQUEST_BYTES = 8192;
+	// the video memory is read this often, not every frame
+	const double MEMORY_SAMPLE_SECONDS = 1.0;
+	// an interval this much over the running mean counts as a
+	// dropped frame, a missed refresh when the swaps are synced
+	const double DROPPED_FRAME_FACTOR = 1.5;
+	// weight of a new interval in the running mean
+	const double MEAN_INTERVAL_WEIGHT = 0.05;
+	// the percentiles served of the frame intervals and CPU times
+	const double QUANTILES[] = { 0.5, 0.9, 0.99 };
+
+	// GL_NVX_gpu_memory_info and GL_ATI_meminfo, which the GLEW of
+	// the project may predate
+	const GLenum GPU_MEMORY_TOTAL_NVX = 0x9048;
+	const GLenum GPU_MEMORY_AVAILABLE_NVX = 0x9049;
+	const GLenum TEXTURE_FREE_MEMORY_ATI = 0x87FC;
+
+	double NowSeconds()
+	{
+		return(std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count());
+	}
+
+	/***********************************************************
+	 *  AppendSummary()
+	 *
+	 *  This function is used for writing the percentiles of a
+	 *  window of samples, in milliseconds, and the sum and
+	 *  count of every sample, as a Prometheus summary.
+	 ***********************************************************/
+	void AppendSummary(std::string& page, const char* name, const char* help,
+		std::vector<float>& samples, double sumSeconds, unsigned long long count)
+	{
+		char line[256];
+		page += std::string("# HELP ") + name + " " + help + "\n";
+		page += std::string("# TYPE ") + name + " summary\n";
+		std::sort(samples.begin(), samples.end());
+		for (size_t i = 0; (i < sizeof(QUANTILES) / sizeof(QUANTILES[0])) && (samples.empty() == false); i++)
+		{
+			size_t index = std::min((size_t)(QUANTILES[i] * samples.size()), samples.size() - 1);
+			snprintf(line, sizeof(line), "%s{quantile=\"%g\"} %.6f\n", name, QUANTILES[i], samples[index]);
+			page += line;
+		}
+		snprintf(line, sizeof(line), "%s_sum %.6f\n%s_count %llu\n", name, sumSeconds, name, count);
+		page += line;
+	}
+
+	/***********************************************************
+	 *  AppendValue()
+	 *
+	 *  This function is used for writing a metric of a single
+	 *  value, a counter or a gauge.
+	 ***********************************************************/
+	void AppendValue(std::string& page, const char* name, const char* type, const char* help, double value)
+	{
+		char line[256];
+		page += std::string("# HELP ") + name + " " + help + "\n";
+		page += std::string("# TYPE ") + name + " " + type + "\n";
+		snprintf(line, sizeof(line), "%s %.17g\n", name, value);
+		page += line;
+	}
+}
+
+/***********************************************************
+ *  MetricsExporter()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+MetricsExporter::MetricsExporter()
+{
+	m_listenSocket = NO_SOCKET;
+	m_bStopping = false;
+	m_startTime = NowSeconds();
+	m_intervals.reserve(FRAME_WINDOW);
+	m_cpuTimes.reserve(FRAME_WINDOW);
+	m_nextInterval = 0;
+	m_nextCpuTime = 0;
+	m_frames = 0;
+	m_intervalSeconds = 0.0;
+	m_cpuSeconds = 0.0;
+	m_lastPresentTime = -1.0;
+	m_meanInterval = 0.0;
+	m_droppedFrames = 0;
+	memset(m_gpuSeconds, 0, sizeof(m_gpuSeconds));
+	memset(&m_lastFrame, 0, sizeof(m_lastFrame));
+	m_drawCallsTotal = 0;
+	m_primitivesTotal = 0;
+	memset(&m_scene, 0, sizeof(m_scene));
+	memset(&m_power, 0, sizeof(m_power));
+	m_power.batteryPercent = -1;
+	m_power.temperature = -1.0f;
+	m_videoMemoryTotal = -1;
+	m_videoMemoryAvailable = -1;
+	m_lastMemorySampleTime = -MEMORY_SAMPLE_SECONDS;
+}
+
+/***********************************************************
+ *  ~MetricsExporter()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+MetricsExporter::~MetricsExporter()
+{
+	Stop();
+}
+
+/***********************************************************
+ *  Start()
+ *
+ *  This method is used for opening the port and starting
+ *  the thread serving it.
+ ***********************************************************/
+bool MetricsExporter::Start(int port)
+{
+	Stop();
+
+	if (NetSocket::Startup() == false)
+	{
+		LOG_ERROR("Could not start the sockets for the metrics");
+		return(false);
+	}
+	uintptr_t listenSocket = NetSocket::Listen(port, false);
+	if (listenSocket == NO_SOCKET)
+	{
+		LOG_ERROR("Could not listen for metrics scrapes on port %d", port);
+		NetSocket::Cleanup();
+		return(false);
+	}
+
+	m_listenSocket = listenSocket;
+	m_bStopping = false;
+	m_serveThread = std::thread(&MetricsExporter::ServeLoop, this);
+	LOG_INFO("Serving metrics at http://localhost:%d/metrics", port);
+	return(true);
+}
+
+/***********************************************************
+ *  Stop()
+ *
+ *  This method is used for ending the thread and closing
+ *  the scrapers and the port.
+ ***********************************************************/
+void MetricsExporter::Stop()
+{
+	if (m_listenSocket == NO_SOCKET)
+	{
+		return;
+	}
+
+	m_bStopping = true;
+	m_serveThread.join();
+
+	while (m_scrapers.empty() == false)
+	{
+		CloseScraper(m_scrapers.size() - 1);
+	}
+	NetSocket::Close(m_listenSocket);
+	m_listenSocket = NO_SOCKET;
+	NetSocket::Cleanup();
+}
+
+/***********************************************************
+ *  RecordFrame()
+ *
+ *  This method is used for taking the numbers of a frame
+ *  presented. The interval since the present before goes
+ *  into the window and the running mean, and counts as a
+ *  dropped frame when well over that mean.
+ ***********************************************************/
+void MetricsExporter::RecordFrame(double presentTime, const FRAME_METRICS& frame)
+{
+	if ((presentTime - m_lastMemorySampleTime) >= MEMORY_SAMPLE_SECONDS)
+	{
+		SampleVideoMemory();
+		m_lastMemorySampleTime = presentTime;
+	}
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	float interval = -1.0f;
+	if (m_lastPresentTime >= 0.0)
+	{
+		interval = (float)(presentTime - m_lastPresentTime);
+		if ((m_meanInterval > 0.0) && (interval > (DROPPED_FRAME_FACTOR * m_meanInterval)))
+		{
+			m_droppedFrames++;
+		}
+		m_meanInterval = (m_meanInterval > 0.0) ?
+			m_meanInterval + (MEAN_INTERVAL_WEIGHT * (interval - m_meanInterval)) : interval;
+		m_intervalSeconds += interval;
+	}
+	m_lastPresentTime = presentTime;
+
+	// the first frame after a pause has no interval, only its CPU
+	// time, so the rings move on their own
+	if (interval >= 0.0f)
+	{
+		AddSample(m_intervals, m_nextInterval, interval * 1000.0f);
+	}
+	AddSample(m_cpuTimes, m_nextCpuTime, (float)(frame.cpuSeconds * 1000.0));
+
+	m_frames++;
+	m_cpuSeconds += frame.cpuSeconds;
+	for (int pass = 0; pass < GPUProfiler::PASS_COUNT; pass++)
+	{
+		m_gpuSeconds[pass] += frame.gpuMilliseconds[pass] / 1000.0;
+	}
+	m_drawCallsTotal += frame.drawCalls;
+	m_primitivesTotal += frame.primitives;
+	m_lastFrame = frame;
+}
+
+/***********************************************************
+ *  AddSample()
+ *
+ *  This method is used for putting a sample into a ring of
+ *  FRAME_WINDOW, over the oldest once it is full.
+ ***********************************************************/
+void MetricsExporter::AddSample(std::vector<float>& ring, size_t& next, float value)
+{
+	if (ring.size() < FRAME_WINDOW)
+	{
+		ring.push_back(value);
+		return;
+	}
+	ring[next] = value;
+	next = (next + 1) % FRAME_WINDOW;
+}
+
+/***********************************************************
+ *  ResetInterval()
+ *
+ *  This method is used for starting the intervals over
+ *  after a pause in which no frames were presented.
+ ***********************************************************/
+void MetricsExporter::ResetInterval()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_lastPresentTime = -1.0;
+}
+
+/***********************************************************
+ *  RecordScene()
+ *
+ *  This method is used for taking the state of the scene.
+ ***********************************************************/
+void MetricsExporter::RecordScene(const SCENE_METRICS& scene)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_scene = scene;
+}
+
+/***********************************************************
+ *  RecordPower()
+ *
+ *  This method is used for taking the power state.
+ ***********************************************************/
+void MetricsExporter::RecordPower(const POWER_METRICS& power)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_power = power;
+}
+
+/***********************************************************
+ *  SampleVideoMemory()
+ *
+ *  This method is used for reading the video memory the
+ *  driver reports, in KB. NVIDIA tells the total and what
+ *  is available, AMD only the memory free for textures.
+ ***********************************************************/
+void MetricsExporter::SampleVideoMemory()
+{
+	GLint values[4] = { -1, -1, -1, -1 };
+	long long total = -1;
+	long long available = -1;
+	if (glewIsSupported("GL_NVX_gpu_memory_info") == GL_TRUE)
+	{
+		glGetIntegerv(GPU_MEMORY_TOTAL_NVX, &values[0]);
+		glGetIntegerv(GPU_MEMORY_AVAILABLE_NVX, &values[1]);
+		total = values[0];
+		available = values[1];
+	}
+	else if (glewIsSupported("GL_ATI_meminfo") == GL_TRUE)
+	{
+		glGetIntegerv(TEXTURE_FREE_MEMORY_ATI, values);
+		available = values[0];
+	}
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_videoMemoryTotal = total;
+	m_videoMemoryAvailable = available;
+}
+
+/***********************************************************
+ *  FormatMetrics()
+ *
+ *  This method is used for writing the page of a scrape.
+ *  The numbers are copied under the lock, and sorted and
+ *  formatted after it.
+ ***********************************************************/
+std::string MetricsExporter::FormatMetrics()
+{
+	std::vector<float> intervals;
+	std::vector<float> cpuTimes;
+	unsigned long long frames = 0;
+	double intervalSeconds = 0.0;
+	double cpuSeconds = 0.0;
+	unsigned long long droppedFrames = 0;
+	double gpuSeconds[GPUProfiler::PASS_COUNT];
+	FRAME_METRICS lastFrame;
+	unsigned long long drawCallsTotal = 0;
+	unsigned long long primitivesTotal = 0;
+	SCENE_METRICS scene;
+	POWER_METRICS power;
+	long long videoMemoryTotal = -1;
+	long long videoMemoryAvailable = -1;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		intervals = m_intervals;
+		cpuTimes = m_cpuTimes;
+		frames = m_frames;
+		intervalSeconds = m_intervalSeconds;
+		cpuSeconds = m_cpuSeconds;
+		droppedFrames = m_droppedFrames;
+		memcpy(gpuSeconds, m_gpuSeconds, sizeof(gpuSeconds));
+		lastFrame = m_lastFrame;
+		drawCallsTotal = m_drawCallsTotal;
+		primitivesTotal = m_primitivesTotal;
+		scene = m_scene;
+		power = m_power;
+		videoMemoryTotal = m_videoMemoryTotal;
+		videoMemoryAvailable = m_videoMemoryAvailable;
+	}
+
+	// the windows are in milliseconds, and the summaries too, with
+	// their sums in seconds like the counters
+	std::string page;
+	page.reserve(4096);
+	AppendValue(page, "viewer_uptime_seconds", "gauge", "Seconds since the exporter started.",
+		NowSeconds() - m_startTime);
+	AppendValue(page, "viewer_frames_total", "counter", "Frames presented.", (double)frames);
+	AppendSummary(page, "viewer_frame_interval_milliseconds",
+		"Interval between presents over the last frames; the sum is in seconds.",
+		intervals, intervalSeconds, (frames > 0) ? frames - 1 : 0);
+	AppendSummary(page, "viewer_frame_cpu_milliseconds",
+		"CPU time from the frame start to its present over the last frames; the sum is in seconds.",
+		cpuTimes, cpuSeconds, frames);
+	AppendValue(page, "viewer_dropped_frames_total", "counter",
+		"Frames presented well after the running mean interval, a missed refresh when synced.",
+		(double)droppedFrames);
+	AppendValue(page, "viewer_capture_dropped_total", "counter",
+		"Saved video frames left out rather than waited for.", (double)lastFrame.captureDropped);
+
+	char line[256];
+	page += "# HELP viewer_gpu_pass_seconds_total GPU time of each pass.\n";
+	page += "# TYPE viewer_gpu_pass_seconds_total counter\n";
+	for (int pass = 0; pass < GPUProfiler::PASS_COUNT; pass++)
+	{
+		snprintf(line, sizeof(line), "viewer_gpu_pass_seconds_total{pass=\"%s\"} %.6f\n",
+			GPUProfiler::GetPassName(pass), gpuSeconds[pass]);
+		page += line;
+	}
+	page += "# HELP viewer_gpu_pass_milliseconds GPU time of each pass in the last frame read back.\n";
+	page += "# TYPE viewer_gpu_pass_milliseconds gauge\n";
+	for (int pass = 0; pass < GPUProfiler::PASS_COUNT; pass++)
+	{
+		snprintf(line, sizeof(line), "viewer_gpu_pass_milliseconds{pass=\"%s\"} %.4f\n",
+			GPUProfiler::GetPassName(pass), lastFrame.gpuMilliseconds[pass]);
+		page += line;
+	}
+
+	AppendValue(page, "viewer_draw_calls_total", "counter", "Draw calls issued.", (double)drawCallsTotal);
+	AppendValue(page, "viewer_draw_calls", "gauge", "Draw calls of the last frame.", (double)lastFrame.drawCalls);
+	AppendValue(page, "viewer_instances", "gauge", "Instances drawn in the last frame.", (double)lastFrame.instances);
+	AppendValue(page, "viewer_primitives_total", "counter", "Primitives generated.", (double)primitivesTotal);
+
+	if (videoMemoryTotal >= 0)
+	{
+		AppendValue(page, "viewer_vram_total_bytes", "gauge", "Video memory of the GPU.",
+			(double)videoMemoryTotal * 1024.0);
+	}
+	if (videoMemoryAvailable >= 0)
+	{
+		AppendValue(page, "viewer_vram_available_bytes", "gauge", "Video memory the driver reports free.",
+			(double)videoMemoryAvailable * 1024.0);
+	}
+	AppendValue(page, "viewer_texture_resident_bytes", "gauge", "Texture levels held resident.",
+		(double)scene.textureResidentBytes);
+	AppendValue(page, "viewer_texture_budget_bytes", "gauge", "Budget of the resident texture levels, 0 for none.",
+		(double)scene.textureBudgetBytes);
+	AppendValue(page, "viewer_streaming_queue_depth", "gauge", "Resource loads and texture uploads waiting.",
+		(double)scene.streamingQueue);
+
+	AppendValue(page, "viewer_power_tier", "gauge", "Limits of the power policy, 0 for none to 2 for the most saving.",
+		(double)power.tier);
+	AppendValue(page, "viewer_on_battery", "gauge", "1 while running on battery power.",
+		(power.bOnBattery == true) ? 1.0 : 0.0);
+	if (power.batteryPercent >= 0)
+	{
+		AppendValue(page, "viewer_battery_percent", "gauge", "Charge left in the battery.",
+			(double)power.batteryPercent);
+	}
+	if (power.temperature >= 0.0f)
+	{
+		AppendValue(page, "viewer_temperature_celsius", "gauge", "Hottest thermal zone the platform reports.",
+			(double)power.temperature);
+	}
+	AppendValue(page, "viewer_cpu_throttled", "gauge", "1 while a processor clock is held below its maximum.",
+		(power.bThrottled == true) ? 1.0 : 0.0);
+	return(page);
+}
+
+/***********************************************************
+ *  ServeLoop()
+ *
+ *  This method is used for taking the scrapers on the port
+ *  and answering each with the page once its request is
+ *  read whole, then closing it. Any path but / and
+ *  /metrics is not found.
+ ***********************************************************/
+void MetricsExporter::ServeLoop()
+{
+	ScopeProfiler::SetThreadName("metrics exporter");
+	std::vector<uintptr_t> sockets;
+	std::vector<bool> readable;
+	char buffer[2048];
+	while (m_bStopping.load() == false)
+	{
+		sockets.assign(1, m_listenSocket);
+		for (size_t i = 0; i < m_scrapers.size(); i++)
+		{
+			sockets.push_back(m_scrapers[i].socketHandle);
+		}
+		if (NetSocket::WaitReadable(sockets, POLL_MICROSECONDS, readable) == false)
+		{
+			continue;
+		}
+
+		// from the last, so a scraper closed does not move the ones
+		// still to be read
+		for (size_t i = m_scrapers.size(); i > 0; i--)
+		{
+			size_t index = i - 1;
+			if (readable[i] == false)
+			{
+				continue;
+			}
+			int bytes = NetSocket::Receive(m_scrapers[index].socketHandle, buffer, sizeof(buffer));
+			if (bytes <= 0)
+			{
+				CloseScraper(index);
+				continue;
+			}
+			std::string& received = m_scrapers[index].received;
+			received.append(buffer, bytes);
+			if (received.find("\r\n\r\n") == std::string::npos)
+			{
+				if (received.size() > MAX_REQUEST_BYTES)
+				{
+					CloseScraper(index);
+				}
+				continue;
+			}
+
+			std::string response;
+			if ((received.compare(0, 13, "GET /metrics ") == 0) || (received.compare(0, 6, "GET / ") == 0))
+			{
+				std::string page = FormatMetrics();
+				snprintf(buffer, sizeof(buffer), "HTTP/1.1 200 OK\r\n"
+					"Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+					"Content-Length: %zu\r\nConnection: close\r\n\r\n", page.size());
+				response = buffer + page;
+			}
+			else
+			{
+				response = "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+			}
+			NetSocket::SendAll(m_scrapers[index].socketHandle, response.data(), response.size());
+			CloseScraper(index);
+		}
+
+		if (readable[0] == true)
+		{
+			uintptr_t scraperSocket = NetSocket::Accept(m_listenSocket);
+			if (scraperSocket != NO_SOCKET)
+			{
+				SCRAPER scraper;
+				scraper.socketHandle = scraperSocket;
+				m_scrapers.push_back(scraper);
+			}
+		}
+	}
+}
+
+/***********************************************************
+ *  CloseScraper()
+ *
+ *  This method is used for closing the connection of a
+ *  scraper.
+ ***********************************************************/
+void MetricsExporter::CloseScraper(size_t index)
+{
+	NetSocket::Close(m_scrapers[index].socketHandle);
+	m_scrapers.erase(m_scrapers.begin() + index);
+}
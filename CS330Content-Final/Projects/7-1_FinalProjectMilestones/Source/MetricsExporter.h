@@ -0,0 +1,142 @@
+///////////////////////////////////////////////////////////////////////////////
+// metricsexporter.h
+// ============
+// the frame statistics served over HTTP in the Prometheus text format
+//
+//  The renderer hands its numbers over once per frame: the interval
+//  since the frame before, the CPU time of the frame, the GPU time of
+//  each pass, the draw counters, the video memory, the depth of the
+//  streaming queues and the frames dropped. That only copies them
+//  under a lock; a thread of its own answers the scrapes, sorting the
+//  window of frame intervals into percentiles and formatting the page
+//  there, so a scrape never holds up a frame. The page is served at
+//  /metrics in the Prometheus text format, which OpenMetrics scrapers
+//  read as well.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "GPUProfiler.h"
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/***********************************************************
+ *  MetricsExporter
+ *
+ *  This class contains the numbers of the last frames, the
+ *  listening socket and the thread serving them. The frame
+ *  side calls RecordFrame() after each present and
+ *  RecordScene() once per loop; the scrapes see whatever
+ *  was recorded last.
+ ***********************************************************/
+class MetricsExporter
+{
+public:
+	// constructor
+	MetricsExporter();
+	// destructor
+	~MetricsExporter();
+
+	// frame intervals the percentiles are taken over
+	static const size_t FRAME_WINDOW = 1024;
+
+	// what the renderer measured of one frame
+	struct FRAME_METRICS
+	{
+		double cpuSeconds;			// from the frame start to its present
+		float gpuMilliseconds[GPUProfiler::PASS_COUNT];
+		unsigned long long drawCalls;
+		unsigned long long instances;
+		unsigned long long primitives;
+		unsigned long long captureDropped;	// saved frames left out, in all
+	};
+	// what the scene side holds
+	struct SCENE_METRICS
+	{
+		size_t streamingQueue;		// loads and texture uploads waiting
+		unsigned long long textureResidentBytes;
+		unsigned long long textureBudgetBytes;
+	};
+	// what the power policy read last
+	struct POWER_METRICS
+	{
+		int tier;					// PowerPolicy::TIER
+		bool bOnBattery;
+		int batteryPercent;			// -1 when unknown
+		float temperature;			// degrees C, -1 when unknown
+		bool bThrottled;
+	};
+
+	// serve the metrics on a TCP port of every interface; false when
+	// the port cannot be opened
+	bool Start(int port);
+	// close the scrapers and the port, and end the thread
+	void Stop();
+
+	// take the numbers of the frame presented at the time given, on
+	// the thread of the GL context, which also samples the video
+	// memory now and then
+	void RecordFrame(double presentTime, const FRAME_METRICS& frame);
+	// forget the last present, after a wait for events, so the wait
+	// counts as neither an interval nor a dropped frame
+	void ResetInterval();
+	void RecordScene(const SCENE_METRICS& scene);
+	void RecordPower(const POWER_METRICS& power);
+
+private:
+	// a scraper connected, with the request read so far
+	struct SCRAPER
+	{
+		uintptr_t socketHandle;
+		std::string received;
+	};
+
+	uintptr_t m_listenSocket;
+	std::atomic<bool> m_bStopping;
+	std::thread m_serveThread;
+	// of the serving thread alone
+	std::vector<SCRAPER> m_scrapers;
+
+	// guards everything below, written by the frame side and read by
+	// the serving thread
+	std::mutex m_mutex;
+	double m_startTime;
+	// the last intervals and CPU times, a ring of FRAME_WINDOW
+	std::vector<float> m_intervals;
+	std::vector<float> m_cpuTimes;
+	size_t m_nextInterval;
+	size_t m_nextCpuTime;
+	unsigned long long m_frames;
+	double m_intervalSeconds;
+	double m_cpuSeconds;
+	double m_lastPresentTime;
+	// running mean of the interval, which a dropped frame exceeds
+	double m_meanInterval;
+	unsigned long long m_droppedFrames;
+	double m_gpuSeconds[GPUProfiler::PASS_COUNT];
+	FRAME_METRICS m_lastFrame;
+	unsigned long long m_drawCallsTotal;
+	unsigned long long m_primitivesTotal;
+	SCENE_METRICS m_scene;
+	POWER_METRICS m_power;
+	// video memory in KB, -1 where the driver does not tell
+	long long m_videoMemoryTotal;
+	long long m_videoMemoryAvailable;
+	double m_lastMemorySampleTime;
+
+	// take the scrapers on the port and answer their requests until
+	// the exporter stops
+	void ServeLoop();
+	// the page of the metrics recorded so far
+	std::string FormatMetrics();
+	void CloseScraper(size_t index);
+	static void AddSample(std::vector<float>& ring, size_t& next, float value);
+	// read the video memory, from GL_NVX_gpu_memory_info or
+	// GL_ATI_meminfo
+	void SampleVideoMemory();
+};
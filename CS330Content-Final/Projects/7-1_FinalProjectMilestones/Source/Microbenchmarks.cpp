@@ -0,0 +1,750 @@
+///////////////////////////////////////////////////////////////////////////////
+// microbenchmarks.cpp
+// ============
+// timed cases of the CPU hot paths, each over a range of problem sizes
+//
+//  Each case times one hot path of the renderer against the code it
+//  replaced or the slower way of doing the same: the model matrix
+//  composition against the matrix product, the batch matrix products
+//  of each kernel the processor runs, the tag handles against
+//  string lookups, the uniform handles against the name and location
+//  setters, the sphere and torus generation, and the draw key radix
+//  sort against std::stable_sort. The iterations of a case are raised
+//  until a run takes long enough to time, and the median of several
+//  runs is reported, so a regression shows as a number that moved.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "Microbenchmarks.h"
+#include "ModelTransforms.h"
+#include "SceneManager.h"
+#include "ShapeTables.h"
+#include "TagRegistry.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <random>
+
+namespace
+{
+	// shortest run the iterations are raised to, and the runs the
+	// median is taken over
+	const double MIN_RUN_SECONDS = 0.05;
+	const int RUN_REPETITIONS = 5;
+	const unsigned long long MAX_ITERATIONS = 1ull << 30;
+
+	// sort methods of TimeSort()
+	const int SORT_STABLE = 0;
+	const int SORT_RADIX = 1;
+	const int SORT_PARALLEL_RADIX = 2;
+
+	double GetSeconds()
+	{
+		return(std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count());
+	}
+
+	// the same random transforms for every case of a size
+	void MakeTransforms(int count, TRS_ARRAYS& transforms)
+	{
+		std::mt19937 random(1);
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+		transforms.Clear();
+		transforms.Reserve((size_t)count);
+		for (int i = 0; i < count; i++)
+		{
+			glm::vec3 scale(0.1f + unit(random) * 4.0f, 0.1f + unit(random) * 4.0f, 0.1f + unit(random) * 4.0f);
+			glm::vec3 rotation(unit(random) * 360.0f, unit(random) * 360.0f, unit(random) * 360.0f);
+			glm::vec3 position(unit(random) * 20.0f - 10.0f, unit(random) * 20.0f - 10.0f, unit(random) * 20.0f - 10.0f);
+			transforms.Add(scale, rotation, position);
+		}
+	}
+
+	// tags shaped like those of a scene, "texture_0042"
+	void MakeTags(int count, std::vector<std::string>& tags)
+	{
+		tags.resize((size_t)count);
+		for (int i = 0; i < count; i++)
+		{
+			char tag[32];
+			snprintf(tag, sizeof(tag), "texture_%04d", i);
+			tags[i] = tag;
+		}
+	}
+}
+
+/***********************************************************
+ *  Microbenchmarks()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+Microbenchmarks::Microbenchmarks(ShaderManager* pShaderManager)
+{
+	m_pShaderManager = pShaderManager;
+	m_pJobSystem = new JobSystem();
+	m_pJobSystem->Start();
+	m_checksum = 0.0;
+
+	AddCase("transforms/matrix-product", &Microbenchmarks::TimeMatrixProduct, 64, 1024, 16384);
+	AddCase("transforms/compose", &Microbenchmarks::TimeComposeModelMatrix, 64, 1024, 16384);
+	AddCase("transforms/compose-simd", &Microbenchmarks::TimeComposeModelMatrices, 64, 1024, 16384);
+	AddCase("transforms/batch-glm", &Microbenchmarks::TimeMatrixBatchGLM, 64, 1024, 16384);
+	if (IsMatrixKernelSupported(MATRIX_KERNEL_SSE2) == true)
+	{
+		AddCase("transforms/batch-sse2", &Microbenchmarks::TimeMatrixBatchSSE2, 64, 1024, 16384);
+	}
+	if (IsMatrixKernelSupported(MATRIX_KERNEL_AVX2) == true)
+	{
+		AddCase("transforms/batch-avx2", &Microbenchmarks::TimeMatrixBatchAVX2, 64, 1024, 16384);
+	}
+	if (IsMatrixKernelSupported(MATRIX_KERNEL_NEON) == true)
+	{
+		AddCase("transforms/batch-neon", &Microbenchmarks::TimeMatrixBatchNEON, 64, 1024, 16384);
+	}
+	AddCase("tags/linear-search", &Microbenchmarks::TimeTagLinearSearch, 16, 256, 4096);
+	AddCase("tags/find", &Microbenchmarks::TimeTagFind, 16, 256, 4096);
+	AddCase("tags/resolve", &Microbenchmarks::TimeTagResolve, 16, 256, 4096);
+	AddCase("uniforms/queried-location", &Microbenchmarks::TimeUniformQueriedLocation, 1, 64, 1024, true);
+	AddCase("uniforms/cached-location", &Microbenchmarks::TimeUniformCachedLocation, 1, 64, 1024, true);
+	AddCase("uniforms/handle", &Microbenchmarks::TimeUniformHandle, 1, 64, 1024, true);
+	AddCase("uniforms/handle-unchanged", &Microbenchmarks::TimeUniformHandleUnchanged, 1, 64, 1024, true);
+	AddCase("meshes/sphere", &Microbenchmarks::TimeSphereGeneration, 8, 32, 128);
+	AddCase("meshes/torus", &Microbenchmarks::TimeTorusGeneration, 8, 32, 128);
+	AddCase("sort/stable-sort", &Microbenchmarks::TimeStableSort, 256, 4096, 65536);
+	AddCase("sort/radix", &Microbenchmarks::TimeRadixSort, 256, 4096, 65536);
+	AddCase("sort/radix-parallel", &Microbenchmarks::TimeParallelRadixSort, 256, 4096, 65536);
+}
+
+/***********************************************************
+ *  ~Microbenchmarks()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+Microbenchmarks::~Microbenchmarks()
+{
+	if (NULL != m_pJobSystem)
+	{
+		delete m_pJobSystem;
+		m_pJobSystem = NULL;
+	}
+}
+
+/***********************************************************
+ *  AddCase()
+ *
+ *  This method is used for adding a case run at three
+ *  problem sizes.
+ ***********************************************************/
+void Microbenchmarks::AddCase(const char* name, CASE_FUNCTION function, int size0, int size1, int size2, bool bNeedsGL)
+{
+	BENCHMARK_CASE benchmarkCase;
+	benchmarkCase.name = name;
+	benchmarkCase.function = function;
+	benchmarkCase.sizes.push_back(size0);
+	benchmarkCase.sizes.push_back(size1);
+	benchmarkCase.sizes.push_back(size2);
+	benchmarkCase.bNeedsGL = bNeedsGL;
+	m_cases.push_back(benchmarkCase);
+}
+
+/***********************************************************
+ *  Run()
+ *
+ *  This method is used for running the matching cases at
+ *  each of their sizes, printing the results and writing
+ *  them to the report.
+ ***********************************************************/
+bool Microbenchmarks::Run(const char* filter, const char* reportFile)
+{
+	std::vector<CASE_RESULT> results;
+	std::cout << "\n*** MICROBENCHMARKS: ***\n";
+	std::cout << "matrix kernel " << GetMatrixKernelName(GetMatrixKernel()) << "\n";
+	for (size_t i = 0; i < m_cases.size(); i++)
+	{
+		const BENCHMARK_CASE& benchmarkCase = m_cases[i];
+		if ((NULL != filter) && (strstr(benchmarkCase.name, filter) == NULL))
+		{
+			continue;
+		}
+		if ((benchmarkCase.bNeedsGL == true) && (NULL == m_pShaderManager))
+		{
+			std::cout << benchmarkCase.name << "\tskipped, no shader program\n";
+			continue;
+		}
+
+		for (size_t size = 0; size < benchmarkCase.sizes.size(); size++)
+		{
+			CASE_RESULT result = RunCase(benchmarkCase, benchmarkCase.sizes[size]);
+			std::cout << result.name << "/" << result.size
+				<< "\titerations " << result.iterations
+				<< "\tmedian " << result.medianNanoseconds << " ns"
+				<< "\tmin " << result.minNanoseconds << " ns"
+				<< "\tper item " << result.itemNanoseconds << " ns\n";
+			results.push_back(result);
+		}
+	}
+	std::cout << "checksum " << m_checksum << std::endl;
+
+	if (results.empty() == true)
+	{
+		std::cout << "No benchmark case matches " << ((NULL != filter) ? filter : "") << std::endl;
+		return(false);
+	}
+	if (NULL == reportFile)
+	{
+		return(true);
+	}
+
+	FILE* file = fopen(reportFile, "wb");
+	if (file == NULL)
+	{
+		std::cout << "Could not create benchmark report " << reportFile << std::endl;
+		return(false);
+	}
+	fprintf(file, "case,size,iterations,median_ns,min_ns,item_ns\n");
+	for (size_t i = 0; i < results.size(); i++)
+	{
+		fprintf(file, "%s,%d,%llu,%.3f,%.3f,%.4f\n", results[i].name.c_str(), results[i].size,
+			results[i].iterations, results[i].medianNanoseconds, results[i].minNanoseconds, results[i].itemNanoseconds);
+	}
+	bool bWritten = (ferror(file) == 0);
+	fclose(file);
+	return(bWritten);
+}
+
+/***********************************************************
+ *  RunCase()
+ *
+ *  This method is used for timing a case at a size. The
+ *  iterations start at one and grow toward a run of
+ *  MIN_RUN_SECONDS, then RUN_REPETITIONS runs are timed and
+ *  their median and fastest are kept.
+ ***********************************************************/
+Microbenchmarks::CASE_RESULT Microbenchmarks::RunCase(const BENCHMARK_CASE& benchmarkCase, int size)
+{
+	unsigned long long items = 0;
+	unsigned long long iterations = 1;
+	while (iterations < MAX_ITERATIONS)
+	{
+		double seconds = (this->*benchmarkCase.function)(size, iterations, items);
+		if (seconds >= MIN_RUN_SECONDS)
+		{
+			break;
+		}
+		// aim past the shortest run, growing at least twofold and
+		// at most a hundredfold per try
+		double scale = (seconds > 0.0) ? MIN_RUN_SECONDS * 1.2 / seconds : 100.0;
+		scale = std::min(std::max(scale, 2.0), 100.0);
+		iterations = std::min((unsigned long long)((double)iterations * scale), MAX_ITERATIONS);
+	}
+
+	std::vector<double> runNanoseconds;
+	for (int run = 0; run < RUN_REPETITIONS; run++)
+	{
+		double seconds = (this->*benchmarkCase.function)(size, iterations, items);
+		runNanoseconds.push_back(seconds * 1.0e9 / (double)iterations);
+	}
+	std::sort(runNanoseconds.begin(), runNanoseconds.end());
+
+	CASE_RESULT result;
+	result.name = benchmarkCase.name;
+	result.size = size;
+	result.iterations = iterations;
+	result.medianNanoseconds = runNanoseconds[RUN_REPETITIONS / 2];
+	result.minNanoseconds = runNanoseconds[0];
+	result.itemNanoseconds = (items > 0) ? result.medianNanoseconds / (double)items : result.medianNanoseconds;
+	return(result);
+}
+
+/***********************************************************
+ *  TimeMatrixProduct()
+ *
+ *  This method is used for timing the five matrix product
+ *  the model matrices were once built with.
+ ***********************************************************/
+double Microbenchmarks::TimeMatrixProduct(int size, unsigned long long iterations, unsigned long long& items)
+{
+	TRS_ARRAYS transforms;
+	MakeTransforms(size, transforms);
+	std::vector<glm::mat4> matrices((size_t)size);
+	items = (unsigned long long)size;
+
+	double start = GetSeconds();
+	for (unsigned long long iteration = 0; iteration < iterations; iteration++)
+	{
+		for (int i = 0; i < size; i++)
+		{
+			matrices[i] = MultiplyModelMatrix(
+				glm::vec3(transforms.scaleXYZ[0][i], transforms.scaleXYZ[1][i], transforms.scaleXYZ[2][i]),
+				glm::vec3(transforms.rotationDegreesXYZ[0][i], transforms.rotationDegreesXYZ[1][i], transforms.rotationDegreesXYZ[2][i]),
+				glm::vec3(transforms.positionXYZ[0][i], transforms.positionXYZ[1][i], transforms.positionXYZ[2][i]));
+		}
+		m_checksum += matrices[iteration % size][0][0];
+	}
+	return(GetSeconds() - start);
+}
+
+/***********************************************************
+ *  TimeComposeModelMatrix()
+ *
+ *  This method is used for timing ComposeModelMatrix(), one
+ *  matrix a call, as SetTransformations() builds them.
+ ***********************************************************/
+double Microbenchmarks::TimeComposeModelMatrix(int size, unsigned long long iterations, unsigned long long& items)
+{
+	TRS_ARRAYS transforms;
+	MakeTransforms(size, transforms);
+	std::vector<glm::mat4> matrices((size_t)size);
+	items = (unsigned long long)size;
+
+	double start = GetSeconds();
+	for (unsigned long long iteration = 0; iteration < iterations; iteration++)
+	{
+		for (int i = 0; i < size; i++)
+		{
+			matrices[i] = ComposeModelMatrix(
+				glm::vec3(transforms.scaleXYZ[0][i], transforms.scaleXYZ[1][i], transforms.scaleXYZ[2][i]),
+				glm::vec3(transforms.rotationDegreesXYZ[0][i], transforms.rotationDegreesXYZ[1][i], transforms.rotationDegreesXYZ[2][i]),
+				glm::vec3(transforms.positionXYZ[0][i], transforms.positionXYZ[1][i], transforms.positionXYZ[2][i]));
+		}
+		m_checksum += matrices[iteration % size][0][0];
+	}
+	return(GetSeconds() - start);
+}
+
+/***********************************************************
+ *  TimeComposeModelMatrices()
+ *
+ *  This method is used for timing the SIMD composition of
+ *  four transforms at a time from the component arrays.
+ ***********************************************************/
+double Microbenchmarks::TimeComposeModelMatrices(int size, unsigned long long iterations, unsigned long long& items)
+{
+	TRS_ARRAYS transforms;
+	MakeTransforms(size, transforms);
+	std::vector<glm::mat4> matrices((size_t)size);
+	items = (unsigned long long)size;
+
+	double start = GetSeconds();
+	for (unsigned long long iteration = 0; iteration < iterations; iteration++)
+	{
+		ComposeModelMatrices(transforms, matrices.data());
+		m_checksum += matrices[iteration % size][0][0];
+	}
+	return(GetSeconds() - start);
+}
+
+/***********************************************************
+ *  TimeMatrixBatch()
+ *
+ *  This method is used for timing the batch products of
+ *  size parent and local matrices on a kernel, on this one
+ *  thread, so the items per second are those of a core.
+ ***********************************************************/
+double Microbenchmarks::TimeMatrixBatch(int size, unsigned long long iterations, MATRIX_KERNEL kernel)
+{
+	TRS_ARRAYS transforms;
+	MakeTransforms(size, transforms);
+	MODEL_MATRIX_ARRAY locals((size_t)size);
+	ComposeModelMatrices(transforms, 0, (size_t)size, locals.data());
+	MODEL_MATRIX_ARRAY parents(locals.rbegin(), locals.rend());
+	MODEL_MATRIX_ARRAY results((size_t)size);
+
+	const MATRIX_KERNEL kernelInUse = GetMatrixKernel();
+	SetMatrixKernel(kernel);
+	double start = GetSeconds();
+	for (unsigned long long iteration = 0; iteration < iterations; iteration++)
+	{
+		MultiplyModelMatrixBatch(parents.data(), locals.data(), results.data(), (size_t)size);
+		m_checksum += results[iteration % size][0][0];
+	}
+	double seconds = GetSeconds() - start;
+	SetMatrixKernel(kernelInUse);
+	return(seconds);
+}
+
+/***********************************************************
+ *  TimeMatrixBatchGLM()
+ *
+ *  This method is used for timing the batch products with
+ *  glm's own matrix product.
+ ***********************************************************/
+double Microbenchmarks::TimeMatrixBatchGLM(int size, unsigned long long iterations, unsigned long long& items)
+{
+	items = (unsigned long long)size;
+	return(TimeMatrixBatch(size, iterations, MATRIX_KERNEL_GLM));
+}
+
+/***********************************************************
+ *  TimeMatrixBatchSSE2()
+ *
+ *  This method is used for timing the batch products one
+ *  SSE2 column at a time.
+ ***********************************************************/
+double Microbenchmarks::TimeMatrixBatchSSE2(int size, unsigned long long iterations, unsigned long long& items)
+{
+	items = (unsigned long long)size;
+	return(TimeMatrixBatch(size, iterations, MATRIX_KERNEL_SSE2));
+}
+
+/***********************************************************
+ *  TimeMatrixBatchAVX2()
+ *
+ *  This method is used for timing the batch products two
+ *  columns at a time with AVX2 and FMA.
+ ***********************************************************/
+double Microbenchmarks::TimeMatrixBatchAVX2(int size, unsigned long long iterations, unsigned long long& items)
+{
+	items = (unsigned long long)size;
+	return(TimeMatrixBatch(size, iterations, MATRIX_KERNEL_AVX2));
+}
+
+/***********************************************************
+ *  TimeMatrixBatchNEON()
+ *
+ *  This method is used for timing the batch products one
+ *  column at a time with ARM64 NEON.
+ ***********************************************************/
+double Microbenchmarks::TimeMatrixBatchNEON(int size, unsigned long long iterations, unsigned long long& items)
+{
+	items = (unsigned long long)size;
+	return(TimeMatrixBatch(size, iterations, MATRIX_KERNEL_NEON));
+}
+
+/***********************************************************
+ *  TimeTagLinearSearch()
+ *
+ *  This method is used for timing the lookup of every tag
+ *  by comparing it with each of the tags in turn, as the
+ *  textures and materials were found before the registry.
+ ***********************************************************/
+double Microbenchmarks::TimeTagLinearSearch(int size, unsigned long long iterations, unsigned long long& items)
+{
+	std::vector<std::string> tags;
+	MakeTags(size, tags);
+	items = (unsigned long long)size;
+
+	double start = GetSeconds();
+	for (unsigned long long iteration = 0; iteration < iterations; iteration++)
+	{
+		for (int i = 0; i < size; i++)
+		{
+			int found = -1;
+			for (size_t j = 0; (j < tags.size()) && (found < 0); j++)
+			{
+				if (tags[j].compare(tags[i]) == 0)
+				{
+					found = (int)j;
+				}
+			}
+			m_checksum += found;
+		}
+	}
+	return(GetSeconds() - start);
+}
+
+/***********************************************************
+ *  TimeTagFind()
+ *
+ *  This method is used for timing the lookup of every tag
+ *  in the registry by string, as FindTextureSlot() and
+ *  FindMaterialID() do.
+ ***********************************************************/
+double Microbenchmarks::TimeTagFind(int size, unsigned long long iterations, unsigned long long& items)
+{
+	std::vector<std::string> tags;
+	MakeTags(size, tags);
+	TagRegistry registry("benchmark tag");
+	for (int i = 0; i < size; i++)
+	{
+		registry.Register(tags[i], i);
+	}
+	items = (unsigned long long)size;
+
+	double start = GetSeconds();
+	for (unsigned long long iteration = 0; iteration < iterations; iteration++)
+	{
+		for (int i = 0; i < size; i++)
+		{
+			m_checksum += registry.Resolve(registry.Find(tags[i]));
+		}
+	}
+	return(GetSeconds() - start);
+}
+
+/***********************************************************
+ *  TimeTagResolve()
+ *
+ *  This method is used for timing the resolution of handles
+ *  found once, as the draws pass them.
+ ***********************************************************/
+double Microbenchmarks::TimeTagResolve(int size, unsigned long long iterations, unsigned long long& items)
+{
+	std::vector<std::string> tags;
+	MakeTags(size, tags);
+	TagRegistry registry("benchmark tag");
+	std::vector<TagRegistry::HANDLE> handles((size_t)size);
+	for (int i = 0; i < size; i++)
+	{
+		handles[i] = registry.Register(tags[i], i);
+	}
+	items = (unsigned long long)size;
+
+	double start = GetSeconds();
+	for (unsigned long long iteration = 0; iteration < iterations; iteration++)
+	{
+		for (int i = 0; i < size; i++)
+		{
+			m_checksum += registry.Resolve(handles[i]);
+		}
+	}
+	return(GetSeconds() - start);
+}
+
+/***********************************************************
+ *  TimeUniformQueriedLocation()
+ *
+ *  This method is used for timing matrix uploads that ask
+ *  GL for the uniform location every time, with no cache.
+ *  The uniform cases time the calls on the CPU; the driver
+ *  may carry out the uploads later.
+ ***********************************************************/
+double Microbenchmarks::TimeUniformQueriedLocation(int size, unsigned long long iterations, unsigned long long& items)
+{
+	TRS_ARRAYS transforms;
+	MakeTransforms(size, transforms);
+	std::vector<glm::mat4> matrices((size_t)size);
+	ComposeModelMatrices(transforms, matrices.data());
+	m_pShaderManager->use();
+	GLuint program = m_pShaderManager->m_programID;
+	items = (unsigned long long)size;
+
+	double start = GetSeconds();
+	for (unsigned long long iteration = 0; iteration < iterations; iteration++)
+	{
+		for (int i = 0; i < size; i++)
+		{
+			glUniformMatrix4fv(glGetUniformLocation(program, "model"), 1, GL_FALSE, &matrices[i][0][0]);
+		}
+	}
+	double seconds = GetSeconds() - start;
+	glFinish();
+	return(seconds);
+}
+
+/***********************************************************
+ *  TimeUniformCachedLocation()
+ *
+ *  This method is used for timing matrix uploads by name,
+ *  through the shader manager's cache of the locations.
+ ***********************************************************/
+double Microbenchmarks::TimeUniformCachedLocation(int size, unsigned long long iterations, unsigned long long& items)
+{
+	TRS_ARRAYS transforms;
+	MakeTransforms(size, transforms);
+	std::vector<glm::mat4> matrices((size_t)size);
+	ComposeModelMatrices(transforms, matrices.data());
+	m_pShaderManager->use();
+	items = (unsigned long long)size;
+
+	double start = GetSeconds();
+	for (unsigned long long iteration = 0; iteration < iterations; iteration++)
+	{
+		for (int i = 0; i < size; i++)
+		{
+			m_pShaderManager->setMat4Value("model", matrices[i]);
+		}
+	}
+	double seconds = GetSeconds() - start;
+	glFinish();
+	return(seconds);
+}
+
+/***********************************************************
+ *  TimeUniformHandle()
+ *
+ *  This method is used for timing matrix uploads through a
+ *  uniform handle, each a new value that is sent.
+ ***********************************************************/
+double Microbenchmarks::TimeUniformHandle(int size, unsigned long long iterations, unsigned long long& items)
+{
+	TRS_ARRAYS transforms;
+	MakeTransforms(size, transforms);
+	std::vector<glm::mat4> matrices((size_t)size);
+	ComposeModelMatrices(transforms, matrices.data());
+	UniformHandle<glm::mat4> model = m_pShaderManager->GetUniformHandle<glm::mat4>("model");
+	m_pShaderManager->use();
+	m_pShaderManager->InvalidateUniformShadow();
+	items = (unsigned long long)size;
+
+	double start = GetSeconds();
+	for (unsigned long long iteration = 0; iteration < iterations; iteration++)
+	{
+		for (int i = 0; i < size; i++)
+		{
+			// a single size would send the same value every time
+			matrices[i][3][3] = (float)(iteration & 1) + 1.0f;
+			m_pShaderManager->setUniform(model, matrices[i]);
+		}
+	}
+	double seconds = GetSeconds() - start;
+	glFinish();
+	return(seconds);
+}
+
+/***********************************************************
+ *  TimeUniformHandleUnchanged()
+ *
+ *  This method is used for timing uniform handle sets of
+ *  the value already sent, which the filter skips.
+ ***********************************************************/
+double Microbenchmarks::TimeUniformHandleUnchanged(int size, unsigned long long iterations, unsigned long long& items)
+{
+	glm::mat4 matrix = glm::mat4(1.0f);
+	UniformHandle<glm::mat4> model = m_pShaderManager->GetUniformHandle<glm::mat4>("model");
+	m_pShaderManager->use();
+	m_pShaderManager->setUniform(model, matrix);
+	items = (unsigned long long)size;
+
+	double start = GetSeconds();
+	for (unsigned long long iteration = 0; iteration < iterations; iteration++)
+	{
+		for (int i = 0; i < size; i++)
+		{
+			m_pShaderManager->setUniform(model, matrix);
+		}
+	}
+	double seconds = GetSeconds() - start;
+	glFinish();
+	return(seconds);
+}
+
+/***********************************************************
+ *  TimeSphereGeneration()
+ *
+ *  This method is used for timing the writing of a sphere
+ *  of size bands and slices, with its unit circles, as
+ *  ShapeMeshes does for a tessellation without a table.
+ ***********************************************************/
+double Microbenchmarks::TimeSphereGeneration(int size, unsigned long long iterations, unsigned long long& items)
+{
+	std::vector<float> bandCircle((size_t)(2 * size + 1) * 2);
+	std::vector<float> sliceCircle((size_t)(size + 1) * 2);
+	std::vector<float> vertices((size_t)ShapeTables::SphereVertexCount(size, size) * ShapeTables::TABLE_VERTEX_FLOATS);
+	std::vector<GLuint> indices((size_t)ShapeTables::SphereIndexCount(size, size));
+	items = (unsigned long long)ShapeTables::SphereVertexCount(size, size);
+
+	double start = GetSeconds();
+	for (unsigned long long iteration = 0; iteration < iterations; iteration++)
+	{
+		ShapeTables::WriteUnitCircle(2 * size, bandCircle.data());
+		ShapeTables::WriteUnitCircle(size, sliceCircle.data());
+		ShapeTables::WriteSphereVertices(size, size, bandCircle.data(), sliceCircle.data(), vertices.data());
+		ShapeTables::WriteSphereIndices(size, size, indices.data());
+		m_checksum += vertices[iteration % vertices.size()] + (double)indices[iteration % indices.size()];
+	}
+	return(GetSeconds() - start);
+}
+
+/***********************************************************
+ *  TimeTorusGeneration()
+ *
+ *  This method is used for timing the writing of a torus of
+ *  size main and tube segments, with its unit circles.
+ ***********************************************************/
+double Microbenchmarks::TimeTorusGeneration(int size, unsigned long long iterations, unsigned long long& items)
+{
+	std::vector<float> mainCircle((size_t)(size + 1) * 2);
+	std::vector<float> tubeCircle((size_t)(size + 1) * 2);
+	std::vector<float> vertices((size_t)ShapeTables::TorusVertexCount(size, size) * ShapeTables::TABLE_VERTEX_FLOATS);
+	std::vector<GLuint> indices((size_t)ShapeTables::TorusIndexCount(size, size));
+	items = (unsigned long long)ShapeTables::TorusVertexCount(size, size);
+
+	double start = GetSeconds();
+	for (unsigned long long iteration = 0; iteration < iterations; iteration++)
+	{
+		ShapeTables::WriteUnitCircle(size, mainCircle.data());
+		ShapeTables::WriteUnitCircle(size, tubeCircle.data());
+		ShapeTables::WriteTorusVertices(size, size, 0.2f, mainCircle.data(), tubeCircle.data(), vertices.data());
+		ShapeTables::WriteTorusIndices(size, size, indices.data());
+		m_checksum += vertices[iteration % vertices.size()] + (double)indices[iteration % indices.size()];
+	}
+	return(GetSeconds() - start);
+}
+
+/***********************************************************
+ *  TimeSort()
+ *
+ *  This method is used for timing the sort of size random
+ *  draw keys. Each iteration sorts a fresh copy of the
+ *  unsorted keys, and only the sort is timed.
+ ***********************************************************/
+double Microbenchmarks::TimeSort(int size, unsigned long long iterations, int method)
+{
+	std::mt19937_64 random(1);
+	std::vector<SceneManager::DRAW_KEY> unsorted((size_t)size);
+	for (int i = 0; i < size; i++)
+	{
+		unsorted[i].key = random();
+		unsorted[i].drawIndex = (uint32_t)i;
+	}
+	std::vector<SceneManager::DRAW_KEY> keys;
+	std::vector<SceneManager::DRAW_KEY> scratch;
+
+	double seconds = 0.0;
+	for (unsigned long long iteration = 0; iteration < iterations; iteration++)
+	{
+		keys = unsorted;
+		double start = GetSeconds();
+		if (method == SORT_STABLE)
+		{
+			std::stable_sort(keys.begin(), keys.end(),
+				[](const SceneManager::DRAW_KEY& a, const SceneManager::DRAW_KEY& b) { return(a.key < b.key); });
+		}
+		else
+		{
+			SceneManager::SortDrawKeys(keys, scratch, (method == SORT_PARALLEL_RADIX) ? m_pJobSystem : NULL);
+		}
+		seconds += GetSeconds() - start;
+		m_checksum += keys[iteration % keys.size()].drawIndex;
+	}
+	return(seconds);
+}
+
+/***********************************************************
+ *  TimeStableSort()
+ *
+ *  This method is used for timing std::stable_sort of the
+ *  draw keys, the comparison sort the radix sort replaced.
+ ***********************************************************/
+double Microbenchmarks::TimeStableSort(int size, unsigned long long iterations, unsigned long long& items)
+{
+	items = (unsigned long long)size;
+	return(TimeSort(size, iterations, SORT_STABLE));
+}
+
+/***********************************************************
+ *  TimeRadixSort()
+ *
+ *  This method is used for timing the radix sort of the
+ *  draw keys on this thread.
+ ***********************************************************/
+double Microbenchmarks::TimeRadixSort(int size, unsigned long long iterations, unsigned long long& items)
+{
+	items = (unsigned long long)size;
+	return(TimeSort(size, iterations, SORT_RADIX));
+}
+
+/***********************************************************
+ *  TimeParallelRadixSort()
+ *
+ *  This method is used for timing the radix sort of the
+ *  draw keys given the job system, which only splits lists
+ *  long enough to gain from it.
+ ***********************************************************/
+double Microbenchmarks::TimeParallelRadixSort(int size, unsigned long long iterations, unsigned long long& items)
+{
+	items = (unsigned long long)size;
+	return(TimeSort(size, iterations, SORT_PARALLEL_RADIX));
+}
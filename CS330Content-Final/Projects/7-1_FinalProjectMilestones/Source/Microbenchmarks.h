@@ -0,0 +1,107 @@
+///////////////////////////////////////////////////////////////////////////////
+// microbenchmarks.h
+// ============
+// timed cases of the CPU hot paths, each over a range of problem sizes
+//
+//  Each case times one hot path of the renderer against the code it
+//  replaced or the slower way of doing the same: the model matrix
+//  composition against the matrix product, the batch matrix products
+//  of each kernel the processor runs, the tag handles against
+//  string lookups, the uniform handles against the name and location
+//  setters, the sphere and torus generation, and the draw key radix
+//  sort against std::stable_sort. The iterations of a case are raised
+//  until a run takes long enough to time, and the median of several
+//  runs is reported, so a regression shows as a number that moved.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "ShaderManager.h"
+#include "JobSystem.h"
+#include "ModelTransforms.h"
+
+#include <string>
+#include <vector>
+
+/***********************************************************
+ *  Microbenchmarks
+ *
+ *  This class contains the benchmark cases and runs them.
+ *  The uniform cases set the model matrix of the scene
+ *  program, so they need a current context with the shader
+ *  manager's program built; the others need no GL.
+ ***********************************************************/
+class Microbenchmarks
+{
+public:
+	// constructor; NULL leaves out the uniform cases
+	Microbenchmarks(ShaderManager* pShaderManager);
+	// destructor
+	~Microbenchmarks();
+
+	// run the cases whose name contains filter, or all of them for
+	// NULL, print a line for each case and size, and write them as
+	// CSV when reportFile is given; false when none matched or the
+	// report could not be written
+	bool Run(const char* filter, const char* reportFile);
+
+private:
+	// time iterations runs of a case at a size, setting the items
+	// one run handles; returns the seconds the runs took
+	typedef double (Microbenchmarks::*CASE_FUNCTION)(int size, unsigned long long iterations, unsigned long long& items);
+
+	struct BENCHMARK_CASE
+	{
+		const char* name;
+		CASE_FUNCTION function;
+		std::vector<int> sizes;
+		bool bNeedsGL;
+	};
+
+	struct CASE_RESULT
+	{
+		std::string name;
+		int size;
+		unsigned long long iterations;
+		double medianNanoseconds;	// per iteration
+		double minNanoseconds;
+		double itemNanoseconds;		// median per item
+	};
+
+	ShaderManager* m_pShaderManager;
+	// threads the parallel sort runs on
+	JobSystem* m_pJobSystem;
+	std::vector<BENCHMARK_CASE> m_cases;
+	// sum of results, printed so the timed work cannot be dropped
+	double m_checksum;
+
+	void AddCase(const char* name, CASE_FUNCTION function, int size0, int size1, int size2, bool bNeedsGL = false);
+	// raise the iterations until a run is long enough, then time
+	// the runs the result is the median of
+	CASE_RESULT RunCase(const BENCHMARK_CASE& benchmarkCase, int size);
+
+	double TimeMatrixProduct(int size, unsigned long long iterations, unsigned long long& items);
+	double TimeComposeModelMatrix(int size, unsigned long long iterations, unsigned long long& items);
+	double TimeComposeModelMatrices(int size, unsigned long long iterations, unsigned long long& items);
+	double TimeMatrixBatchGLM(int size, unsigned long long iterations, unsigned long long& items);
+	double TimeMatrixBatchSSE2(int size, unsigned long long iterations, unsigned long long& items);
+	double TimeMatrixBatchAVX2(int size, unsigned long long iterations, unsigned long long& items);
+	double TimeMatrixBatchNEON(int size, unsigned long long iterations, unsigned long long& items);
+	double TimeTagLinearSearch(int size, unsigned long long iterations, unsigned long long& items);
+	double TimeTagFind(int size, unsigned long long iterations, unsigned long long& items);
+	double TimeTagResolve(int size, unsigned long long iterations, unsigned long long& items);
+	double TimeUniformQueriedLocation(int size, unsigned long long iterations, unsigned long long& items);
+	double TimeUniformCachedLocation(int size, unsigned long long iterations, unsigned long long& items);
+	double TimeUniformHandle(int size, unsigned long long iterations, unsigned long long& items);
+	double TimeUniformHandleUnchanged(int size, unsigned long long iterations, unsigned long long& items);
+	double TimeSphereGeneration(int size, unsigned long long iterations, unsigned long long& items);
+	double TimeTorusGeneration(int size, unsigned long long iterations, unsigned long long& items);
+	double TimeStableSort(int size, unsigned long long iterations, unsigned long long& items);
+	double TimeRadixSort(int size, unsigned long long iterations, unsigned long long& items);
+	double TimeParallelRadixSort(int size, unsigned long long iterations, unsigned long long& items);
+	// multiply size matrices by as many parents on a kernel
+	double TimeMatrixBatch(int size, unsigned long long iterations, MATRIX_KERNEL kernel);
+	// sort random keys of the size with the radix sort, on the job
+	// system or not, or with std::stable_sort
+	double TimeSort(int size, unsigned long long iterations, int method);
+};
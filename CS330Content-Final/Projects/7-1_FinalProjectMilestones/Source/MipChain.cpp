@@ -0,0 +1,297 @@
+///////////////////////////////////////////////////////////////////////////////
+// mipchain.cpp
+// ============
+// mip levels of decoded images, filtered in linear light off the GL thread
+//
+//  A level is made a row at a time: the two rows above it are decoded
+//  to floats through a table per channel, summed, paired and scaled,
+//  and encoded back through a table of the linear values. The tables
+//  are built on first use, by whichever thread gets there first.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "MipChain.h"
+#include "ScopeProfiler.h"
+#include "SIMDMath.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
+std::atomic<unsigned long long> MipChain::s_chains(0);
+std::atomic<unsigned long long> MipChain::s_levels(0);
+std::atomic<unsigned long long> MipChain::s_nanoseconds(0);
+
+namespace
+{
+	// entries of the encode tables; at the steepest part of the sRGB
+	// curve one step is under a quarter of a code
+	const int ENCODE_STEPS = 16384;
+
+	// 8 bit values to floats and back, for colors in sRGB and for
+	// alpha as it is
+	struct FILTER_TABLES
+	{
+		float colorToLinear[256];
+		float alphaToLinear[256];
+		unsigned char colorFromLinear[ENCODE_STEPS];
+		unsigned char alphaFromLinear[ENCODE_STEPS];
+	};
+
+	/***********************************************************
+	 *  BuildTables()
+	 *
+	 *  This function is used for filling the tables of the sRGB
+	 *  transfer function of IEC 61966-2-1.
+	 ***********************************************************/
+	FILTER_TABLES* BuildTables()
+	{
+		FILTER_TABLES* pTables = new FILTER_TABLES();
+		for (int i = 0; i < 256; i++)
+		{
+			float value = (float)i / 255.0f;
+			pTables->colorToLinear[i] = (value <= 0.04045f) ? value / 12.92f : powf((value + 0.055f) / 1.055f, 2.4f);
+			pTables->alphaToLinear[i] = value;
+		}
+		for (int i = 0; i < ENCODE_STEPS; i++)
+		{
+			float value = (float)i / (float)(ENCODE_STEPS - 1);
+			float encoded = (value <= 0.0031308f) ? value * 12.92f : 1.055f * powf(value, 1.0f / 2.4f) - 0.055f;
+			pTables->colorFromLinear[i] = (unsigned char)std::min(std::max((int)(encoded * 255.0f + 0.5f), 0), 255);
+			pTables->alphaFromLinear[i] = (unsigned char)std::min(std::max((int)(value * 255.0f + 0.5f), 0), 255);
+		}
+		return(pTables);
+	}
+
+	const FILTER_TABLES& GetTables()
+	{
+		static const FILTER_TABLES* pTables = BuildTables();
+		return(*pTables);
+	}
+
+	// the alpha channel of a channel count, -1 for none
+	int GetAlphaChannel(int colorChannels)
+	{
+		return(((colorChannels == 2) || (colorChannels == 4)) ? colorChannels - 1 : -1);
+	}
+
+	/***********************************************************
+	 *  DecodeRow()
+	 *
+	 *  This function is used for reading a row of texels as
+	 *  floats, each channel through its own table.
+	 ***********************************************************/
+	void DecodeRow(const unsigned char* pRow, int count, const float* const* ppTables, int colorChannels, float* pOut)
+	{
+		for (int i = 0, c = 0; i < count; i++)
+		{
+			pOut[i] = ppTables[c][pRow[i]];
+			c = (c + 1 < colorChannels) ? c + 1 : 0;
+		}
+	}
+
+	/***********************************************************
+	 *  AddRows()
+	 *
+	 *  This function is used for summing two decoded rows into
+	 *  the first, four floats at a time.
+	 ***********************************************************/
+	void AddRows(float* pSum, const float* pRow, int count)
+	{
+		int i = 0;
+#if SIMD_FLOAT4
+		for (; i + 4 <= count; i += 4)
+		{
+			Float4Store(pSum + i, Float4Add(Float4Load(pSum + i), Float4Load(pRow + i)));
+		}
+#endif
+		for (; i < count; i++)
+		{
+			pSum[i] += pRow[i];
+		}
+	}
+}
+
+/***********************************************************
+ *  GetLevelCount()
+ *
+ *  This method is used for the count of levels of a full
+ *  chain, the same GL gives a texture of the size.
+ ***********************************************************/
+int MipChain::GetLevelCount(int width, int height)
+{
+	int levels = 1;
+	while (((width | height) >> levels) != 0)
+	{
+		levels++;
+	}
+	return(levels);
+}
+
+/***********************************************************
+ *  GetLevelSize()
+ *
+ *  This method is used for the size of a level.
+ ***********************************************************/
+void MipChain::GetLevelSize(int width, int height, int level, int& levelWidth, int& levelHeight)
+{
+	levelWidth = std::max(width >> level, 1);
+	levelHeight = std::max(height >> level, 1);
+}
+
+/***********************************************************
+ *  GetLevelOffset()
+ *
+ *  This method is used for the offset of a level in the
+ *  pixels of a chain: the bytes of the levels above it.
+ ***********************************************************/
+size_t MipChain::GetLevelOffset(int width, int height, int colorChannels, int level)
+{
+	return(GetChainBytes(width, height, colorChannels, level));
+}
+
+/***********************************************************
+ *  GetChainBytes()
+ *
+ *  This method is used for the bytes of the first levels of
+ *  a chain.
+ ***********************************************************/
+size_t MipChain::GetChainBytes(int width, int height, int colorChannels, int levelCount)
+{
+	size_t bytes = 0;
+	for (int i = 0; i < levelCount; i++)
+	{
+		int levelWidth = 0;
+		int levelHeight = 0;
+		GetLevelSize(width, height, i, levelWidth, levelHeight);
+		bytes += (size_t)levelWidth * levelHeight * colorChannels;
+	}
+	return(bytes);
+}
+
+/***********************************************************
+ *  Generate()
+ *
+ *  This method is used for growing the pixels of a decoded
+ *  image to the whole chain and filtering each level from
+ *  the one above. The buffer is grown as stb_image would,
+ *  so ImageDecoder::Free() still frees it.
+ ***********************************************************/
+bool MipChain::Generate(ImageDecoder::IMAGE& image)
+{
+	if ((NULL == image.pixels) || (image.levelCount != 1))
+	{
+		return(false);
+	}
+	const int levelCount = GetLevelCount(image.width, image.height);
+	if (levelCount == 1)
+	{
+		return(true);
+	}
+
+	PROFILE_SCOPE("texture mip chain");
+	long long start = ScopeProfiler::Now();
+
+	unsigned char* pChain = (unsigned char*)realloc(image.pixels,
+		GetChainBytes(image.width, image.height, image.colorChannels, levelCount));
+	if (NULL == pChain)
+	{
+		return(false);
+	}
+	image.pixels = pChain;
+
+	size_t aboveOffset = 0;
+	for (int i = 1; i < levelCount; i++)
+	{
+		int aboveWidth = 0;
+		int aboveHeight = 0;
+		int width = 0;
+		int height = 0;
+		GetLevelSize(image.width, image.height, i - 1, aboveWidth, aboveHeight);
+		GetLevelSize(image.width, image.height, i, width, height);
+		const size_t offset = aboveOffset + (size_t)aboveWidth * aboveHeight * image.colorChannels;
+		HalveLevel(pChain + aboveOffset, aboveWidth, aboveHeight, pChain + offset, width, height, image.colorChannels);
+		aboveOffset = offset;
+	}
+	image.levelCount = levelCount;
+
+	s_chains.fetch_add(1, std::memory_order_relaxed);
+	s_levels.fetch_add((unsigned long long)levelCount - 1, std::memory_order_relaxed);
+	s_nanoseconds.fetch_add((unsigned long long)(ScopeProfiler::Now() - start), std::memory_order_relaxed);
+	return(true);
+}
+
+/***********************************************************
+ *  HalveLevel()
+ *
+ *  This method is used for box filtering a level into the
+ *  next smaller one in linear light. The two rows above a
+ *  row are summed as floats, then each pair of columns,
+ *  and the average is encoded back.
+ ***********************************************************/
+void MipChain::HalveLevel(const unsigned char* pAbove, int aboveWidth, int aboveHeight,
+	unsigned char* pLevel, int width, int height, int colorChannels)
+{
+	const FILTER_TABLES& tables = GetTables();
+	const int alphaChannel = GetAlphaChannel(colorChannels);
+	const float* decodeTables[4];
+	const unsigned char* encodeTables[4];
+	for (int c = 0; c < 4; c++)
+	{
+		decodeTables[c] = (c == alphaChannel) ? tables.alphaToLinear : tables.colorToLinear;
+		encodeTables[c] = (c == alphaChannel) ? tables.alphaFromLinear : tables.colorFromLinear;
+	}
+
+	const int aboveCount = aboveWidth * colorChannels;
+	std::vector<float> sum((size_t)aboveCount);
+	std::vector<float> row((size_t)aboveCount);
+	const float scale = 0.25f * (float)(ENCODE_STEPS - 1);
+	for (int y = 0; y < height; y++)
+	{
+		const int y0 = std::min(y * 2, aboveHeight - 1);
+		const int y1 = std::min(y * 2 + 1, aboveHeight - 1);
+		DecodeRow(pAbove + (size_t)y0 * aboveCount, aboveCount, decodeTables, colorChannels, &sum[0]);
+		DecodeRow(pAbove + (size_t)y1 * aboveCount, aboveCount, decodeTables, colorChannels, &row[0]);
+		AddRows(&sum[0], &row[0], aboveCount);
+
+		unsigned char* pOut = pLevel + (size_t)y * width * colorChannels;
+		for (int x = 0; x < width; x++)
+		{
+			const int x0 = std::min(x * 2, aboveWidth - 1) * colorChannels;
+			const int x1 = std::min(x * 2 + 1, aboveWidth - 1) * colorChannels;
+			float texel[4];
+#if SIMD_FLOAT4
+			if (colorChannels == 4)
+			{
+				Float4Store(texel, Float4Mul(Float4Add(Float4Load(&sum[x0]), Float4Load(&sum[x1])), Float4Set(scale)));
+			}
+			else
+#endif
+			{
+				for (int c = 0; c < colorChannels; c++)
+				{
+					texel[c] = (sum[x0 + c] + sum[x1 + c]) * scale;
+				}
+			}
+			for (int c = 0; c < colorChannels; c++)
+			{
+				pOut[x * colorChannels + c] = encodeTables[c][std::min((int)(texel[c] + 0.5f), ENCODE_STEPS - 1)];
+			}
+		}
+	}
+}
+
+/***********************************************************
+ *  GetStats()
+ *
+ *  This method is used for getting the chains generated
+ *  since the launch and the time they took.
+ ***********************************************************/
+MipChain::CHAIN_STATS MipChain::GetStats()
+{
+	CHAIN_STATS stats;
+	stats.chains = s_chains.load(std::memory_order_relaxed);
+	stats.levels = s_levels.load(std::memory_order_relaxed);
+	stats.milliseconds = (double)s_nanoseconds.load(std::memory_order_relaxed) / 1000000.0;
+	return(stats);
+}
@@ -0,0 +1,67 @@
+///////////////////////////////////////////////////////////////////////////////
+// mipchain.h
+// ============
+// mip levels of decoded images, filtered in linear light off the GL thread
+//
+//  glGenerateMipmap() runs on the thread of the context, and how it
+//  filters is up to the driver; most average the sRGB encoded bytes,
+//  which darkens every level below the first. The decoder instead
+//  fills in the whole chain on its worker: each level is box filtered
+//  from the one above it, the colors decoded to linear light through a
+//  table and four floats at a time, and encoded back. Alpha is averaged
+//  as it is. The levels lie back to back after the base one, so the
+//  streamer uploads them as they are and the texture cache and the
+//  block compressor take them as their input.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "ImageDecoder.h"
+
+#include <atomic>
+#include <cstddef>
+
+/***********************************************************
+ *  MipChain
+ *
+ *  This class contains the level layout of a chain and its
+ *  filter. It is used through static methods, like the
+ *  decoding of ImageDecoder, from any thread.
+ ***********************************************************/
+class MipChain
+{
+public:
+	// chains generated since the launch
+	struct CHAIN_STATS
+	{
+		unsigned long long chains;
+		unsigned long long levels;
+		double milliseconds;	// summed over the threads
+	};
+
+	// levels of a full chain, down to 1x1
+	static int GetLevelCount(int width, int height);
+	// size of a level, no side under 1
+	static void GetLevelSize(int width, int height, int level, int& levelWidth, int& levelHeight);
+	// where a level starts in the pixels of a chain, and how many
+	// bytes the first levelCount levels take; rows are tightly packed
+	static size_t GetLevelOffset(int width, int height, int colorChannels, int level);
+	static size_t GetChainBytes(int width, int height, int colorChannels, int levelCount);
+
+	// grow the pixels of a decoded image of one level to hold every
+	// level and filter them in; false when the memory cannot be had,
+	// and the image keeps its one level
+	static bool Generate(ImageDecoder::IMAGE& image);
+	// filter a level into the one below, a texel from the 2x2 above
+	// it; the texels past the right and bottom edges of an odd sized
+	// level repeat its last column and row
+	static void HalveLevel(const unsigned char* pAbove, int aboveWidth, int aboveHeight,
+		unsigned char* pLevel, int width, int height, int colorChannels);
+
+	static CHAIN_STATS GetStats();
+
+private:
+	static std::atomic<unsigned long long> s_chains;
+	static std::atomic<unsigned long long> s_levels;
+	static std::atomic<unsigned long long> s_nanoseconds;
+};
@@ -0,0 +1,1051 @@
+///////////////////////////////////////////////////////////////////////////////
+// modelimporter.cpp
+// ============
+// import binary glTF 2.0 models off the GL thread
+//
+//  Reads the appliances and utensils of a scene that the basic shapes
+//  cannot build from .glb files. The file is mapped read only and the
+//  accessors of every triangle primitive are read straight out of its
+//  binary chunk into the interleaved position, normal and UV layout
+//  of the mesh arena, with the transforms of the nodes it hangs from
+//  applied, and simplified into coarser LOD levels by quadric edge
+//  collapses, so the GL thread only has to hand the result to
+//  ShapeMeshes. Only the base color, metallic and roughness factors
+//  and the alpha mode of the materials are read.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "ModelImporter.h"
+#include "MeshOptimizer.h"
+#include "AssetPack.h"
+
+#include <glm/gtc/quaternion.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <utility>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+	// "glTF", the container version, and the types of its chunks
+	const uint32_t GLB_MAGIC = 0x46546C67;
+	const uint32_t GLB_VERSION = 2;
+	const uint32_t GLB_CHUNK_JSON = 0x4E4F534A;
+	const uint32_t GLB_CHUNK_BIN = 0x004E4942;
+
+	// accessor component types and the triangle list mode
+	const int GLTF_BYTE = 5120;
+	const int GLTF_UNSIGNED_BYTE = 5121;
+	const int GLTF_SHORT = 5122;
+	const int GLTF_UNSIGNED_SHORT = 5123;
+	const int GLTF_UNSIGNED_INT = 5125;
+	const int GLTF_FLOAT = 5126;
+	const int GLTF_TRIANGLES = 4;
+
+	// deepest nesting of JSON arrays and objects parsed
+	const int MAX_JSON_DEPTH = 64;
+
+	// share of the triangles of a primitive each coarser LOD level
+	// is simplified down to
+	const float LOD_TRIANGLE_RATIOS[ModelImporter::LOD_LEVELS] = { 0.5f, 0.2f };
+
+	enum JSON_TYPE
+	{
+		JSON_NULL = 0,
+		JSON_BOOL,
+		JSON_NUMBER,
+		JSON_STRING,
+		JSON_ARRAY,
+		JSON_OBJECT
+	};
+
+	// one value of the parsed JSON chunk; the children of arrays and
+	// objects are indexes into the same node vector, and objects keep
+	// the key of each child at the same index
+	struct JSON_NODE
+	{
+		JSON_TYPE type;
+		double number;		// also 1 or 0 for a bool
+		std::string text;
+		std::vector<int> children;
+		std::vector<std::string> keys;
+	};
+
+	struct JSON_DOCUMENT
+	{
+		const char* pText;
+		const char* pEnd;
+		std::vector<JSON_NODE> nodes;
+	};
+
+	// one accessor resolved against the binary chunk
+	struct ACCESSOR_VIEW
+	{
+		const unsigned char* pData;
+		size_t stride;
+		size_t count;
+		int componentType;
+		int components;
+		bool bNormalized;
+	};
+
+	/****************************************************
+	 *  MapFile()
+	 *
+	 *  This function is used for mapping a file read only,
+	 *  NULL when it cannot be opened or is empty.
+	 ****************************************************/
+	const unsigned char* MapFile(const char* filename, size_t& fileSize)
+	{
+		void* pView = NULL;
+		fileSize = 0;
+#ifdef _WIN32
+		HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL,
+			OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+		if (file != INVALID_HANDLE_VALUE)
+		{
+			LARGE_INTEGER size;
+			if ((GetFileSizeEx(file, &size) != 0) && (size.QuadPart > 0))
+			{
+				fileSize = (size_t)size.QuadPart;
+				// the view keeps the mapping open once both handles are closed
+				HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+				if (NULL != mapping)
+				{
+					pView = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+					CloseHandle(mapping);
+				}
+			}
+			CloseHandle(file);
+		}
+#else
+		int file = open(filename, O_RDONLY);
+		if (file >= 0)
+		{
+			struct stat fileInfo;
+			if ((fstat(file, &fileInfo) == 0) && (fileInfo.st_size > 0))
+			{
+				fileSize = (size_t)fileInfo.st_size;
+				pView = mmap(NULL, fileSize, PROT_READ, MAP_PRIVATE, file, 0);
+				if (pView == MAP_FAILED)
+				{
+					pView = NULL;
+				}
+			}
+			close(file);
+		}
+#endif
+		return((const unsigned char*)pView);
+	}
+
+	/****************************************************
+	 *  UnmapFile()
+	 *
+	 *  This function is used for unmapping a file mapped by
+	 *  MapFile().
+	 ****************************************************/
+	void UnmapFile(const unsigned char* pView, size_t fileSize)
+	{
+#ifdef _WIN32
+		UnmapViewOfFile(pView);
+#else
+		munmap((void*)pView, fileSize);
+#endif
+	}
+
+	/****************************************************
+	 *  SkipSpace()
+	 *
+	 *  This function is used for moving the parser past
+	 *  JSON white space.
+	 ****************************************************/
+	void SkipSpace(JSON_DOCUMENT& document)
+	{
+		while ((document.pText < document.pEnd) &&
+			((*document.pText == ' ') || (*document.pText == '\t') ||
+			(*document.pText == '\n') || (*document.pText == '\r')))
+		{
+			document.pText++;
+		}
+	}
+
+	/****************************************************
+	 *  ParseString()
+	 *
+	 *  This function is used for reading a quoted string,
+	 *  the parser on its opening quote, into UTF-8 text.
+	 ****************************************************/
+	bool ParseString(JSON_DOCUMENT& document, std::string& text)
+	{
+		text.clear();
+		document.pText++;
+		while (document.pText < document.pEnd)
+		{
+			char c = *document.pText++;
+			if (c == '"')
+			{
+				return(true);
+			}
+			if (c != '\\')
+			{
+				text.push_back(c);
+				continue;
+			}
+			if (document.pText >= document.pEnd)
+			{
+				return(false);
+			}
+
+			c = *document.pText++;
+			switch (c)
+			{
+			case 'b': text.push_back('\b'); break;
+			case 'f': text.push_back('\f'); break;
+			case 'n': text.push_back('\n'); break;
+			case 'r': text.push_back('\r'); break;
+			case 't': text.push_back('\t'); break;
+			case 'u':
+			{
+				// names are all this importer reads from strings, so
+				// each escape is encoded on its own, pairs or not
+				if (document.pEnd - document.pText < 4)
+				{
+					return(false);
+				}
+				char digits[5] = { document.pText[0], document.pText[1], document.pText[2], document.pText[3], '\0' };
+				char* pDigitsEnd = NULL;
+				unsigned long codePoint = strtoul(digits, &pDigitsEnd, 16);
+				if (pDigitsEnd != digits + 4)
+				{
+					return(false);
+				}
+				document.pText += 4;
+				if (codePoint < 0x80)
+				{
+					text.push_back((char)codePoint);
+				}
+				else if (codePoint < 0x800)
+				{
+					text.push_back((char)(0xC0 | (codePoint >> 6)));
+					text.push_back((char)(0x80 | (codePoint & 0x3F)));
+				}
+				else
+				{
+					text.push_back((char)(0xE0 | (codePoint >> 12)));
+					text.push_back((char)(0x80 | ((codePoint >> 6) & 0x3F)));
+					text.push_back((char)(0x80 | (codePoint & 0x3F)));
+				}
+				break;
+			}
+			default:
+				// \" \\ and \/ stand for themselves
+				text.push_back(c);
+				break;
+			}
+		}
+		return(false);
+	}
+
+	/****************************************************
+	 *  ParseValue()
+	 *
+	 *  This function is used for parsing the JSON value at
+	 *  the parser into a new node and its children,
+	 *  returning its index or -1 when it is malformed.
+	 ****************************************************/
+	int ParseValue(JSON_DOCUMENT& document, int depth)
+	{
+		SkipSpace(document);
+		if ((document.pText >= document.pEnd) || (depth > MAX_JSON_DEPTH))
+		{
+			return(-1);
+		}
+
+		int nodeIndex = (int)document.nodes.size();
+		document.nodes.push_back(JSON_NODE());
+		document.nodes[nodeIndex].type = JSON_NULL;
+		document.nodes[nodeIndex].number = 0.0;
+
+		char c = *document.pText;
+		if ((c == '{') || (c == '['))
+		{
+			bool bObject = (c == '{');
+			char close = bObject ? '}' : ']';
+			document.nodes[nodeIndex].type = bObject ? JSON_OBJECT : JSON_ARRAY;
+			document.pText++;
+			SkipSpace(document);
+			if ((document.pText < document.pEnd) && (*document.pText == close))
+			{
+				document.pText++;
+				return(nodeIndex);
+			}
+
+			while (document.pText < document.pEnd)
+			{
+				std::string key;
+				if (bObject == true)
+				{
+					SkipSpace(document);
+					if ((document.pText >= document.pEnd) || (*document.pText != '"') ||
+						(ParseString(document, key) == false))
+					{
+						return(-1);
+					}
+					SkipSpace(document);
+					if ((document.pText >= document.pEnd) || (*document.pText != ':'))
+					{
+						return(-1);
+					}
+					document.pText++;
+				}
+
+				// the node vector grows while the child is parsed
+				int child = ParseValue(document, depth + 1);
+				if (child < 0)
+				{
+					return(-1);
+				}
+				document.nodes[nodeIndex].children.push_back(child);
+				if (bObject == true)
+				{
+					document.nodes[nodeIndex].keys.push_back(key);
+				}
+
+				SkipSpace(document);
+				if (document.pText >= document.pEnd)
+				{
+					return(-1);
+				}
+				c = *document.pText++;
+				if (c == close)
+				{
+					return(nodeIndex);
+				}
+				if (c != ',')
+				{
+					return(-1);
+				}
+			}
+			return(-1);
+		}
+		if (c == '"')
+		{
+			std::string text;
+			if (ParseString(document, text) == false)
+			{
+				return(-1);
+			}
+			document.nodes[nodeIndex].type = JSON_STRING;
+			document.nodes[nodeIndex].text.swap(text);
+			return(nodeIndex);
+		}
+
+		// a literal or a number runs to the next delimiter
+		const char* pStart = document.pText;
+		while ((document.pText < document.pEnd) && (strchr(",]} \t\n\r", *document.pText) == NULL))
+		{
+			document.pText++;
+		}
+		std::string token(pStart, document.pText);
+		if ((token == "true") || (token == "false"))
+		{
+			document.nodes[nodeIndex].type = JSON_BOOL;
+			document.nodes[nodeIndex].number = (token == "true") ? 1.0 : 0.0;
+			return(nodeIndex);
+		}
+		if (token == "null")
+		{
+			return(nodeIndex);
+		}
+
+		char* pNumberEnd = NULL;
+		double number = strtod(token.c_str(), &pNumberEnd);
+		if (token.empty() || (pNumberEnd != token.c_str() + token.size()))
+		{
+			return(-1);
+		}
+		document.nodes[nodeIndex].type = JSON_NUMBER;
+		document.nodes[nodeIndex].number = number;
+		return(nodeIndex);
+	}
+
+	/****************************************************
+	 *  FindMember()
+	 *
+	 *  This function is used for finding the child of an
+	 *  object node by its key, -1 when it has none.
+	 ****************************************************/
+	int FindMember(const JSON_DOCUMENT& document, int node, const char* key)
+	{
+		if ((node < 0) || (document.nodes[node].type != JSON_OBJECT))
+		{
+			return(-1);
+		}
+		const JSON_NODE& object = document.nodes[node];
+		for (size_t i = 0; i < object.keys.size(); i++)
+		{
+			if (object.keys[i] == key)
+			{
+				return(object.children[i]);
+			}
+		}
+		return(-1);
+	}
+
+	/****************************************************
+	 *  GetElement()
+	 *
+	 *  This function is used for getting an element of an
+	 *  array node, -1 when it has no such element.
+	 ****************************************************/
+	int GetElement(const JSON_DOCUMENT& document, int node, int element)
+	{
+		if ((node < 0) || (document.nodes[node].type != JSON_ARRAY) ||
+			(element < 0) || (element >= (int)document.nodes[node].children.size()))
+		{
+			return(-1);
+		}
+		return(document.nodes[node].children[element]);
+	}
+
+	/****************************************************
+	 *  GetElementCount()
+	 *
+	 *  This function is used for getting the length of an
+	 *  array node, 0 for anything else.
+	 ****************************************************/
+	int GetElementCount(const JSON_DOCUMENT& document, int node)
+	{
+		if ((node < 0) || (document.nodes[node].type != JSON_ARRAY))
+		{
+			return(0);
+		}
+		return((int)document.nodes[node].children.size());
+	}
+
+	/****************************************************
+	 *  GetNumber()
+	 *
+	 *  This function is used for reading a number or bool
+	 *  member of an object node, or the default without one.
+	 ****************************************************/
+	double GetNumber(const JSON_DOCUMENT& document, int node, const char* key, double defaultValue)
+	{
+		int member = FindMember(document, node, key);
+		if ((member < 0) ||
+			((document.nodes[member].type != JSON_NUMBER) && (document.nodes[member].type != JSON_BOOL)))
+		{
+			return(defaultValue);
+		}
+		return(document.nodes[member].number);
+	}
+
+	/****************************************************
+	 *  GetIndex()
+	 *
+	 *  This function is used for reading an index member of
+	 *  an object node, -1 when it is missing or negative.
+	 ****************************************************/
+	int GetIndex(const JSON_DOCUMENT& document, int node, const char* key)
+	{
+		double index = GetNumber(document, node, key, -1.0);
+		if ((index < 0.0) || (index > 2147483647.0))
+		{
+			return(-1);
+		}
+		return((int)index);
+	}
+
+	/****************************************************
+	 *  GetText()
+	 *
+	 *  This function is used for reading a string member of
+	 *  an object node, empty without one.
+	 ****************************************************/
+	std::string GetText(const JSON_DOCUMENT& document, int node, const char* key)
+	{
+		int member = FindMember(document, node, key);
+		if ((member < 0) || (document.nodes[member].type != JSON_STRING))
+		{
+			return(std::string());
+		}
+		return(document.nodes[member].text);
+	}
+
+	/****************************************************
+	 *  GetNumbers()
+	 *
+	 *  This function is used for reading an array member of
+	 *  count numbers, false when it is missing or another
+	 *  length.
+	 ****************************************************/
+	bool GetNumbers(const JSON_DOCUMENT& document, int node, const char* key, float* pValues, int count)
+	{
+		int member = FindMember(document, node, key);
+		if (GetElementCount(document, member) != count)
+		{
+			return(false);
+		}
+		for (int i = 0; i < count; i++)
+		{
+			const JSON_NODE& element = document.nodes[GetElement(document, member, i)];
+			if (element.type != JSON_NUMBER)
+			{
+				return(false);
+			}
+			pValues[i] = (float)element.number;
+		}
+		return(true);
+	}
+
+	/****************************************************
+	 *  GetComponentSize()
+	 *
+	 *  This function is used for getting the bytes of an
+	 *  accessor component type, 0 when it is not one.
+	 ****************************************************/
+	size_t GetComponentSize(int componentType)
+	{
+		switch (componentType)
+		{
+		case GLTF_BYTE:
+		case GLTF_UNSIGNED_BYTE:
+			return(1);
+		case GLTF_SHORT:
+		case GLTF_UNSIGNED_SHORT:
+			return(2);
+		case GLTF_UNSIGNED_INT:
+		case GLTF_FLOAT:
+			return(4);
+		default:
+			return(0);
+		}
+	}
+
+	/****************************************************
+	 *  GetAccessor()
+	 *
+	 *  This function is used for resolving an accessor to
+	 *  where its elements lie in the binary chunk, checking
+	 *  that every one of them is inside its buffer view and
+	 *  the view inside the chunk. Only buffer 0, the chunk
+	 *  of the .glb, is read, and sparse accessors are not.
+	 ****************************************************/
+	bool GetAccessor(
+		const JSON_DOCUMENT& document,
+		int root,
+		int accessorIndex,
+		const unsigned char* pBinary,
+		size_t binarySize,
+		ACCESSOR_VIEW& view)
+	{
+		int accessor = GetElement(document, FindMember(document, root, "accessors"), accessorIndex);
+		int bufferView = GetElement(document, FindMember(document, root, "bufferViews"),
+			GetIndex(document, accessor, "bufferView"));
+		if ((accessor < 0) || (bufferView < 0) || (NULL == pBinary) ||
+			(FindMember(document, accessor, "sparse") >= 0) ||
+			(GetIndex(document, bufferView, "buffer") != 0))
+		{
+			return(false);
+		}
+
+		std::string type = GetText(document, accessor, "type");
+		view.components = (type == "SCALAR") ? 1 : ((type == "VEC2") ? 2 : ((type == "VEC3") ? 3 : ((type == "VEC4") ? 4 : 0)));
+		view.componentType = (int)GetNumber(document, accessor, "componentType", 0.0);
+		view.bNormalized = (GetNumber(document, accessor, "normalized", 0.0) != 0.0);
+		double count = GetNumber(document, accessor, "count", 0.0);
+		size_t componentSize = GetComponentSize(view.componentType);
+		if ((view.components == 0) || (componentSize == 0) || (count < 1.0) || (count > 4294967295.0))
+		{
+			return(false);
+		}
+		view.count = (size_t)count;
+
+		double viewOffset = GetNumber(document, bufferView, "byteOffset", 0.0);
+		double viewLength = GetNumber(document, bufferView, "byteLength", 0.0);
+		double accessorOffset = GetNumber(document, accessor, "byteOffset", 0.0);
+		size_t elementSize = componentSize * view.components;
+		double stride = GetNumber(document, bufferView, "byteStride", (double)elementSize);
+		if ((viewOffset < 0.0) || (viewLength < 0.0) || (accessorOffset < 0.0) ||
+			(stride < (double)elementSize) || (viewOffset + viewLength > (double)binarySize) ||
+			(accessorOffset + stride * (count - 1.0) + (double)elementSize > viewLength))
+		{
+			return(false);
+		}
+
+		view.stride = (size_t)stride;
+		view.pData = pBinary + (size_t)viewOffset + (size_t)accessorOffset;
+		return(true);
+	}
+
+	/****************************************************
+	 *  ReadComponent()
+	 *
+	 *  This function is used for reading one component of
+	 *  an accessor element as a float, scaling normalized
+	 *  integers to [0, 1] or [-1, 1].
+	 ****************************************************/
+	float ReadComponent(const ACCESSOR_VIEW& view, size_t element, int component)
+	{
+		const unsigned char* pValue = view.pData + element * view.stride +
+			component * GetComponentSize(view.componentType);
+		switch (view.componentType)
+		{
+		case GLTF_FLOAT:
+		{
+			float value;
+			memcpy(&value, pValue, sizeof(value));
+			return(value);
+		}
+		case GLTF_UNSIGNED_BYTE:
+			return(view.bNormalized ? (float)pValue[0] / 255.0f : (float)pValue[0]);
+		case GLTF_BYTE:
+			return(view.bNormalized ? glm::max((float)(int8_t)pValue[0] / 127.0f, -1.0f) : (float)(int8_t)pValue[0]);
+		case GLTF_UNSIGNED_SHORT:
+		{
+			uint16_t value;
+			memcpy(&value, pValue, sizeof(value));
+			return(view.bNormalized ? (float)value / 65535.0f : (float)value);
+		}
+		case GLTF_SHORT:
+		{
+			int16_t value;
+			memcpy(&value, pValue, sizeof(value));
+			return(view.bNormalized ? glm::max((float)value / 32767.0f, -1.0f) : (float)value);
+		}
+		default:
+		{
+			uint32_t value;
+			memcpy(&value, pValue, sizeof(value));
+			return((float)value);
+		}
+		}
+	}
+
+	/****************************************************
+	 *  ReadIndex()
+	 *
+	 *  This function is used for reading one element of an
+	 *  index accessor.
+	 ****************************************************/
+	GLuint ReadIndex(const ACCESSOR_VIEW& view, size_t element)
+	{
+		const unsigned char* pValue = view.pData + element * view.stride;
+		if (view.componentType == GLTF_UNSIGNED_BYTE)
+		{
+			return(pValue[0]);
+		}
+		if (view.componentType == GLTF_UNSIGNED_SHORT)
+		{
+			uint16_t value;
+			memcpy(&value, pValue, sizeof(value));
+			return(value);
+		}
+		uint32_t value;
+		memcpy(&value, pValue, sizeof(value));
+		return(value);
+	}
+
+	/****************************************************
+	 *  GetNodeMatrix()
+	 *
+	 *  This function is used for getting the local matrix
+	 *  of a node, from its matrix or from its translation,
+	 *  rotation and scale.
+	 ****************************************************/
+	glm::mat4 GetNodeMatrix(const JSON_DOCUMENT& document, int node)
+	{
+		float values[16];
+		if (GetNumbers(document, node, "matrix", values, 16) == true)
+		{
+			// column major, like glm
+			return(glm::make_mat4(values));
+		}
+
+		glm::mat4 matrix(1.0f);
+		if (GetNumbers(document, node, "translation", values, 3) == true)
+		{
+			matrix[3] = glm::vec4(values[0], values[1], values[2], 1.0f);
+		}
+		if (GetNumbers(document, node, "rotation", values, 4) == true)
+		{
+			matrix = matrix * glm::mat4_cast(glm::normalize(glm::quat(values[3], values[0], values[1], values[2])));
+		}
+		if (GetNumbers(document, node, "scale", values, 3) == true)
+		{
+			matrix = matrix * glm::mat4(
+				glm::vec4(values[0], 0.0f, 0.0f, 0.0f),
+				glm::vec4(0.0f, values[1], 0.0f, 0.0f),
+				glm::vec4(0.0f, 0.0f, values[2], 0.0f),
+				glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
+		}
+		return(matrix);
+	}
+
+	/****************************************************
+	 *  ReadPrimitive()
+	 *
+	 *  This function is used for reading a triangle list
+	 *  primitive into the interleaved layout, moved into the
+	 *  space of the model by the world matrix of its node.
+	 *  Normals are computed from the triangles when it has
+	 *  none, and the UVs are flipped to the bottom up rows
+	 *  of the decoded images.
+	 ****************************************************/
+	bool ReadPrimitive(
+		const JSON_DOCUMENT& document,
+		int root,
+		int primitive,
+		const unsigned char* pBinary,
+		size_t binarySize,
+		const glm::mat4& world,
+		ModelImporter::MODEL_PRIMITIVE& result)
+	{
+		const int VERTEX_FLOATS = ModelImporter::VERTEX_FLOATS;
+		int attributes = FindMember(document, primitive, "attributes");
+		ACCESSOR_VIEW positions;
+		if ((GetAccessor(document, root, GetIndex(document, attributes, "POSITION"), pBinary, binarySize, positions) == false) ||
+			(positions.components != 3) || (positions.componentType != GLTF_FLOAT))
+		{
+			return(false);
+		}
+
+		ACCESSOR_VIEW normals;
+		bool bNormals = (GetAccessor(document, root, GetIndex(document, attributes, "NORMAL"), pBinary, binarySize, normals) == true) &&
+			(normals.components == 3) && (normals.componentType == GLTF_FLOAT) && (normals.count == positions.count);
+		ACCESSOR_VIEW uvs;
+		bool bUVs = (GetAccessor(document, root, GetIndex(document, attributes, "TEXCOORD_0"), pBinary, binarySize, uvs) == true) &&
+			(uvs.components == 2) && (uvs.count == positions.count) &&
+			((uvs.componentType == GLTF_FLOAT) || (uvs.bNormalized == true));
+
+		result.indices.clear();
+		int indicesAccessor = GetIndex(document, primitive, "indices");
+		if (indicesAccessor >= 0)
+		{
+			ACCESSOR_VIEW indices;
+			if ((GetAccessor(document, root, indicesAccessor, pBinary, binarySize, indices) == false) ||
+				(indices.components != 1) ||
+				((indices.componentType != GLTF_UNSIGNED_BYTE) && (indices.componentType != GLTF_UNSIGNED_SHORT) &&
+				(indices.componentType != GLTF_UNSIGNED_INT)))
+			{
+				return(false);
+			}
+			result.indices.resize(indices.count);
+			for (size_t i = 0; i < indices.count; i++)
+			{
+				result.indices[i] = ReadIndex(indices, i);
+				if (result.indices[i] >= positions.count)
+				{
+					return(false);
+				}
+			}
+		}
+		else
+		{
+			result.indices.resize(positions.count);
+			for (size_t i = 0; i < positions.count; i++)
+			{
+				result.indices[i] = (GLuint)i;
+			}
+		}
+		result.indices.resize(result.indices.size() / 3 * 3);
+
+		// a mirroring node turns the triangles inside out
+		glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(world)));
+		if (glm::determinant(glm::mat3(world)) < 0.0f)
+		{
+			for (size_t i = 0; i < result.indices.size(); i += 3)
+			{
+				std::swap(result.indices[i + 1], result.indices[i + 2]);
+			}
+		}
+
+		result.vertices.assign(positions.count * VERTEX_FLOATS, 0.0f);
+		for (size_t i = 0; i < positions.count; i++)
+		{
+			GLfloat* pVertex = &result.vertices[i * VERTEX_FLOATS];
+			glm::vec3 position = glm::vec3(world * glm::vec4(ReadComponent(positions, i, 0),
+				ReadComponent(positions, i, 1), ReadComponent(positions, i, 2), 1.0f));
+			pVertex[0] = position.x;
+			pVertex[1] = position.y;
+			pVertex[2] = position.z;
+			if (bNormals == true)
+			{
+				glm::vec3 normal = normalMatrix * glm::vec3(ReadComponent(normals, i, 0),
+					ReadComponent(normals, i, 1), ReadComponent(normals, i, 2));
+				float length = glm::length(normal);
+				normal = (length > 0.0f) ? normal / length : glm::vec3(0.0f, 1.0f, 0.0f);
+				pVertex[3] = normal.x;
+				pVertex[4] = normal.y;
+				pVertex[5] = normal.z;
+			}
+			if (bUVs == true)
+			{
+				pVertex[6] = ReadComponent(uvs, i, 0);
+				pVertex[7] = 1.0f - ReadComponent(uvs, i, 1);
+			}
+		}
+
+		if (bNormals == false)
+		{
+			MeshOptimizer::GenerateNormals(result.vertices.data(), (GLuint)positions.count, VERTEX_FLOATS,
+				result.indices.data(), result.indices.size());
+		}
+
+		result.materialIndex = GetIndex(document, primitive, "material");
+		return(result.indices.empty() == false);
+	}
+
+	/****************************************************
+	 *  BuildPrimitiveLODs()
+	 *
+	 *  This function is used for simplifying a primitive
+	 *  into its coarser LOD levels, each from the full
+	 *  triangle list so the errors do not add up.
+	 ****************************************************/
+	void BuildPrimitiveLODs(ModelImporter::MODEL_PRIMITIVE& primitive)
+	{
+		GLuint vertexCount = (GLuint)(primitive.vertices.size() / ModelImporter::VERTEX_FLOATS);
+		size_t triangleCount = primitive.indices.size() / 3;
+		for (int i = 0; i < ModelImporter::LOD_LEVELS; i++)
+		{
+			size_t targetIndexCount = (size_t)(LOD_TRIANGLE_RATIOS[i] * (float)triangleCount) * 3;
+			MeshOptimizer::SimplifyQuadric(primitive.vertices.data(), vertexCount, ModelImporter::VERTEX_FLOATS,
+				primitive.indices.data(), primitive.indices.size(), targetIndexCount,
+				primitive.lodVertices[i], primitive.lodIndices[i], primitive.lodErrors[i]);
+		}
+	}
+}
+
+/***********************************************************
+ *  Import()
+ *
+ *  This method is used for importing a .glb file on the
+ *  calling thread: the materials, then every triangle
+ *  primitive of the meshes the nodes of its scene place,
+ *  walking the node tree from its roots. Primitives drawn
+ *  as points or lines, or reading data this importer does
+ *  not, are skipped and counted.
+ ***********************************************************/
+bool ModelImporter::Import(const char* filename, MODEL& model)
+{
+	model.primitives.clear();
+	model.materials.clear();
+
+	// a model in the asset pack is read from its view, others
+	// are mapped
+	AssetPack::ASSET_VIEW view;
+	bool bPacked = AssetPack::Find(filename, view);
+	size_t fileSize = view.size;
+	const unsigned char* pFile = bPacked ? view.pData : MapFile(filename, fileSize);
+	if (NULL == pFile)
+	{
+		std::cout << "Could not open model file " << filename << std::endl;
+		return(false);
+	}
+
+	// header, then the JSON chunk and the optional binary chunk
+	uint32_t header[3] = { 0, 0, 0 };
+	uint32_t chunk[2] = { 0, 0 };
+	if (fileSize >= sizeof(header) + sizeof(chunk))
+	{
+		memcpy(header, pFile, sizeof(header));
+		memcpy(chunk, pFile + sizeof(header), sizeof(chunk));
+	}
+	size_t jsonStart = sizeof(header) + sizeof(chunk);
+	if ((header[0] != GLB_MAGIC) || (header[1] != GLB_VERSION) || (header[2] > fileSize) || (header[2] < jsonStart) ||
+		(chunk[1] != GLB_CHUNK_JSON) || (chunk[0] > header[2] - jsonStart))
+	{
+		std::cout << "Model file " << filename << " is not a version 2 binary glTF file" << std::endl;
+		if (bPacked == false)
+		{
+			UnmapFile(pFile, fileSize);
+		}
+		return(false);
+	}
+
+	const unsigned char* pBinary = NULL;
+	size_t binarySize = 0;
+	size_t binaryChunk = jsonStart + ((chunk[0] + 3) & ~(size_t)3);
+	if (binaryChunk + sizeof(chunk) <= header[2])
+	{
+		uint32_t binaryHeader[2];
+		memcpy(binaryHeader, pFile + binaryChunk, sizeof(binaryHeader));
+		if ((binaryHeader[1] == GLB_CHUNK_BIN) && (binaryHeader[0] <= header[2] - binaryChunk - sizeof(chunk)))
+		{
+			pBinary = pFile + binaryChunk + sizeof(chunk);
+			binarySize = binaryHeader[0];
+		}
+	}
+
+	JSON_DOCUMENT document;
+	document.pText = (const char*)pFile + jsonStart;
+	document.pEnd = document.pText + chunk[0];
+	int root = ParseValue(document, 0);
+	if ((root < 0) || (document.nodes[root].type != JSON_OBJECT) ||
+		(GetText(document, FindMember(document, root, "asset"), "version").compare(0, 1, "2") != 0))
+	{
+		std::cout << "Model file " << filename << " has no valid glTF 2.0 JSON chunk" << std::endl;
+		if (bPacked == false)
+		{
+			UnmapFile(pFile, fileSize);
+		}
+		return(false);
+	}
+
+	int materials = FindMember(document, root, "materials");
+	for (int i = 0; i < GetElementCount(document, materials); i++)
+	{
+		int material = GetElement(document, materials, i);
+		int pbr = FindMember(document, material, "pbrMetallicRoughness");
+		MODEL_MATERIAL modelMaterial;
+		modelMaterial.name = GetText(document, material, "name");
+		if (modelMaterial.name.empty() == true)
+		{
+			modelMaterial.name = "material" + std::to_string(i);
+		}
+		float baseColor[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+		GetNumbers(document, pbr, "baseColorFactor", baseColor, 4);
+		modelMaterial.baseColor = glm::make_vec4(baseColor);
+		modelMaterial.metallic = glm::clamp((float)GetNumber(document, pbr, "metallicFactor", 1.0), 0.0f, 1.0f);
+		modelMaterial.roughness = glm::clamp((float)GetNumber(document, pbr, "roughnessFactor", 1.0), 0.0f, 1.0f);
+		modelMaterial.bBlend = (GetText(document, material, "alphaMode") == "BLEND");
+		model.materials.push_back(modelMaterial);
+	}
+
+	// the roots of the scene to show, or of every node tree when
+	// the file names no scene
+	int nodes = FindMember(document, root, "nodes");
+	int nodeCount = GetElementCount(document, nodes);
+	std::vector<int> roots;
+	int scenes = FindMember(document, root, "scenes");
+	int scene = GetElement(document, scenes, glm::max(GetIndex(document, root, "scene"), 0));
+	if (scene >= 0)
+	{
+		int sceneNodes = FindMember(document, scene, "nodes");
+		for (int i = 0; i < GetElementCount(document, sceneNodes); i++)
+		{
+			roots.push_back((int)document.nodes[GetElement(document, sceneNodes, i)].number);
+		}
+	}
+	else
+	{
+		std::vector<bool> bChild(nodeCount, false);
+		for (int i = 0; i < nodeCount; i++)
+		{
+			int children = FindMember(document, GetElement(document, nodes, i), "children");
+			for (int j = 0; j < GetElementCount(document, children); j++)
+			{
+				int child = (int)document.nodes[GetElement(document, children, j)].number;
+				if ((child >= 0) && (child < nodeCount))
+				{
+					bChild[child] = true;
+				}
+			}
+		}
+		for (int i = 0; i < nodeCount; i++)
+		{
+			if (bChild[i] == false)
+			{
+				roots.push_back(i);
+			}
+		}
+	}
+
+	// walk the trees depth first; a node is placed once, so a file
+	// whose children loop back cannot hang the walk
+	std::vector<bool> bVisited(nodeCount, false);
+	std::vector<std::pair<int, glm::mat4> > stack;
+	for (size_t i = roots.size(); i > 0; i--)
+	{
+		stack.push_back(std::make_pair(roots[i - 1], glm::mat4(1.0f)));
+	}
+	int meshes = FindMember(document, root, "meshes");
+	int skipped = 0;
+	while (stack.empty() == false)
+	{
+		int nodeIndex = stack.back().first;
+		glm::mat4 parentWorld = stack.back().second;
+		stack.pop_back();
+		if ((nodeIndex < 0) || (nodeIndex >= nodeCount) || (bVisited[nodeIndex] == true))
+		{
+			continue;
+		}
+		bVisited[nodeIndex] = true;
+
+		int node = GetElement(document, nodes, nodeIndex);
+		glm::mat4 world = parentWorld * GetNodeMatrix(document, node);
+		int children = FindMember(document, node, "children");
+		for (int j = GetElementCount(document, children); j > 0; j--)
+		{
+			stack.push_back(std::make_pair((int)document.nodes[GetElement(document, children, j - 1)].number, world));
+		}
+
+		int meshIndex = GetIndex(document, node, "mesh");
+		int mesh = GetElement(document, meshes, meshIndex);
+		if (mesh < 0)
+		{
+			continue;
+		}
+		std::string meshName = GetText(document, mesh, "name");
+		if (meshName.empty() == true)
+		{
+			meshName = "mesh" + std::to_string(meshIndex);
+		}
+
+		int primitives = FindMember(document, mesh, "primitives");
+		for (int p = 0; p < GetElementCount(document, primitives); p++)
+		{
+			int primitive = GetElement(document, primitives, p);
+			MODEL_PRIMITIVE result;
+			if (((int)GetNumber(document, primitive, "mode", (double)GLTF_TRIANGLES) != GLTF_TRIANGLES) ||
+				(ReadPrimitive(document, root, primitive, pBinary, binarySize, world, result) == false))
+			{
+				skipped++;
+				continue;
+			}
+			if (result.materialIndex >= (int)model.materials.size())
+			{
+				result.materialIndex = -1;
+			}
+			// a mesh placed by several nodes is imported once for each
+			result.name = meshName + " " + std::to_string(nodeIndex) + "." + std::to_string(p);
+			BuildPrimitiveLODs(result);
+			model.primitives.push_back(result);
+		}
+	}
+	if (bPacked == false)
+	{
+		UnmapFile(pFile, fileSize);
+	}
+
+	if (skipped > 0)
+	{
+		std::cout << "Skipped " << skipped << " primitives of model file " << filename
+			<< " that are not triangle lists of the binary chunk" << std::endl;
+	}
+	if (model.primitives.empty() == true)
+	{
+		std::cout << "Model file " << filename << " has no triangles to import" << std::endl;
+		return(false);
+	}
+	return(true);
+}
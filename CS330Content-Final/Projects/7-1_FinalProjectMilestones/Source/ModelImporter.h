@@ -0,0 +1,78 @@
+///////////////////////////////////////////////////////////////////////////////
+// modelimporter.h
+// ============
+// import binary glTF 2.0 models off the GL thread
+//
+//  Reads the appliances and utensils of a scene that the basic shapes
+//  cannot build from .glb files. The file is mapped read only and the
+//  accessors of every triangle primitive are read straight out of its
+//  binary chunk into the interleaved position, normal and UV layout
+//  of the mesh arena, with the transforms of the nodes it hangs from
+//  applied, and simplified into coarser LOD levels by quadric edge
+//  collapses, so the GL thread only has to hand the result to
+//  ShapeMeshes. Only the base color, metallic and roughness factors
+//  and the alpha mode of the materials are read.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <string>
+#include <vector>
+
+/***********************************************************
+ *  ModelImporter
+ *
+ *  This class contains the reader of .glb files. It is used
+ *  through its static Import(), which the loader thread of
+ *  the resource manager runs for every model of a scene.
+ ***********************************************************/
+class ModelImporter
+{
+public:
+	// interleaved position, normal and UV floats of a vertex, the
+	// layout of ShapeMeshes
+	static const int VERTEX_FLOATS = 8;
+	// coarser levels of detail simplified for every primitive, the
+	// levels of ShapeMeshes past its finest
+	static const int LOD_LEVELS = 2;
+
+	// metallic roughness factors of a glTF material
+	struct MODEL_MATERIAL
+	{
+		std::string name;
+		glm::vec4 baseColor;
+		float metallic;
+		float roughness;
+		bool bBlend;		// alphaMode BLEND
+	};
+
+	// one triangle primitive of one node, in the space of the model
+	struct MODEL_PRIMITIVE
+	{
+		std::string name;
+		std::vector<GLfloat> vertices;	// VERTEX_FLOATS per vertex
+		std::vector<GLuint> indices;	// triangle list
+		int materialIndex;				// into the materials, -1 for none
+		// the coarser levels, finest first, each simplified from the
+		// full primitive, and the farthest each moved its surface, in
+		// the units of the model; a level is empty when nothing could
+		// be simplified
+		std::vector<GLfloat> lodVertices[LOD_LEVELS];
+		std::vector<GLuint> lodIndices[LOD_LEVELS];
+		float lodErrors[LOD_LEVELS];
+	};
+
+	// primitives are empty when the file could not be imported
+	struct MODEL
+	{
+		std::vector<MODEL_PRIMITIVE> primitives;
+		std::vector<MODEL_MATERIAL> materials;
+	};
+
+	// import one file on the calling thread, false and reported
+	// when it is not a .glb file this importer can read
+	static bool Import(const char* filename, MODEL& model);
+};
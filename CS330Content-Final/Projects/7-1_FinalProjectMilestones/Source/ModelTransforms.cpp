@@ -0,0 +1,760 @@
+///////////////////////////////////////////////////////////////////////////////
+// modeltransforms.cpp
+// ============
+// compose model matrices from scale, rotation and position
+//
+//  Builds T * Rx * Ry * Rz * S straight from the sine and cosine of
+//  the three angles instead of multiplying five matrices, one at a
+//  time or four at a time from component arrays. The project builds
+//  glm with GLM_FORCE_INTRINSICS, or GLM_FORCE_NEON on ARM64, so the
+//  matrices the scene keeps for itself can be 16 byte aligned and
+//  multiplied with the SSE2 or NEON products of SIMDMath.h; the
+//  matrices handed to GL stay packed. Arrays of products, as a depth
+//  level of the hierarchy needs, go through batch kernels: glm's
+//  product, SSE2 or NEON one column at a time, chosen at compile
+//  time, or AVX2 and FMA two columns at a time where the processor
+//  has them.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "ModelTransforms.h"
+#include "ModelTransformsAVX2.h"
+
+#include <glm/gtx/transform.hpp>
+
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+
+#if SIMD_FLOAT4_SSE2 && defined(_MSC_VER)
+#include <intrin.h>	// __cpuid, _xgetbv
+#endif
+
+namespace
+{
+	const char* const MATRIX_KERNEL_NAMES[MATRIX_KERNEL_COUNT] = { "glm", "sse2", "avx2", "neon" };
+
+	/***********************************************************
+	 *  DetectAVX2()
+	 *
+	 *  This function is used for checking the processor has
+	 *  AVX2 and FMA and the OS saves the AVX registers, which
+	 *  the instructions need besides the CPUID bits.
+	 ***********************************************************/
+	bool DetectAVX2()
+	{
+#if ALIGNED_MODEL_MATRICES && SIMD_FLOAT4_SSE2 && defined(_MSC_VER)
+		int info[4];
+		__cpuid(info, 0);
+		if (info[0] < 7)
+		{
+			return(false);
+		}
+		__cpuid(info, 1);
+		const int OSXSAVE_BIT = 1 << 27;
+		const int AVX_BIT = 1 << 28;
+		const int FMA_BIT = 1 << 12;
+		if ((info[2] & (OSXSAVE_BIT | AVX_BIT | FMA_BIT)) != (OSXSAVE_BIT | AVX_BIT | FMA_BIT))
+		{
+			return(false);
+		}
+		// the SSE and AVX state enabled in XCR0
+		if ((_xgetbv(0) & 6) != 6)
+		{
+			return(false);
+		}
+		__cpuidex(info, 7, 0);
+		const int AVX2_BIT = 1 << 5;
+		return((info[1] & AVX2_BIT) != 0);
+#elif ALIGNED_MODEL_MATRICES && SIMD_FLOAT4_SSE2 && defined(__GNUC__)
+		return((__builtin_cpu_supports("avx2") != 0) && (__builtin_cpu_supports("fma") != 0));
+#else
+		return(false);
+#endif
+	}
+
+	/***********************************************************
+	 *  GetSupportedKernels()
+	 *
+	 *  This function is used for the kernels this build runs on
+	 *  this processor, found on the first call. SSE2 and NEON
+	 *  are fixed by the target of the build, AVX2 is checked.
+	 ***********************************************************/
+	const bool* GetSupportedKernels()
+	{
+#if ALIGNED_MODEL_MATRICES && SIMD_FLOAT4_SSE2
+		static const bool supported[MATRIX_KERNEL_COUNT] =
+		{
+			true,
+			true,
+			(AreAVX2MatrixKernelsBuilt() == true) && (DetectAVX2() == true),
+			false
+		};
+#elif ALIGNED_MODEL_MATRICES && SIMD_FLOAT4_NEON
+		static const bool supported[MATRIX_KERNEL_COUNT] = { true, false, false, true };
+#else
+		static const bool supported[MATRIX_KERNEL_COUNT] = { true, false, false, false };
+#endif
+		return(supported);
+	}
+
+	/***********************************************************
+	 *  CurrentKernel()
+	 *
+	 *  This function is used for the kernel in use, starting
+	 *  as the widest supported one.
+	 ***********************************************************/
+	MATRIX_KERNEL& CurrentKernel()
+	{
+		static MATRIX_KERNEL kernel = (GetSupportedKernels()[MATRIX_KERNEL_AVX2] == true) ? MATRIX_KERNEL_AVX2 :
+			((GetSupportedKernels()[MATRIX_KERNEL_SSE2] == true) ? MATRIX_KERNEL_SSE2 :
+			((GetSupportedKernels()[MATRIX_KERNEL_NEON] == true) ? MATRIX_KERNEL_NEON : MATRIX_KERNEL_GLM));
+		return(kernel);
+	}
+
+	/***********************************************************
+	 *  MultiplyBatch()
+	 *
+	 *  This function is used for the batch products on the
+	 *  kernel in use, parentStep 0 keeping the same parent.
+	 ***********************************************************/
+	void MultiplyBatch(
+		const MODEL_MATRIX* pParents,
+		size_t parentStep,
+		const MODEL_MATRIX* pLocals,
+		MODEL_MATRIX* pResults,
+		size_t count)
+	{
+		if (count == 0)
+		{
+			return;
+		}
+
+		switch (CurrentKernel())
+		{
+#if ALIGNED_MODEL_MATRICES
+#if SIMD_FLOAT4_SSE2
+		case MATRIX_KERNEL_AVX2:
+			MultiplyMatricesAVX2(&pParents[0][0][0], parentStep, &pLocals[0][0][0], &pResults[0][0][0], count);
+			break;
+#endif
+		case MATRIX_KERNEL_SSE2:
+		case MATRIX_KERNEL_NEON:
+			for (size_t i = 0; i < count; i++)
+			{
+				Float4MultiplyMatrix(&pParents[i * parentStep][0][0], &pLocals[i][0][0], &pResults[i][0][0]);
+			}
+			break;
+#endif
+		default:
+			for (size_t i = 0; i < count; i++)
+			{
+				pResults[i] = pParents[i * parentStep] * pLocals[i];
+			}
+			break;
+		}
+	}
+
+	/***********************************************************
+	 *  GetTransform()
+	 *
+	 *  This function is used for reading one transform out of
+	 *  the component arrays.
+	 ***********************************************************/
+	void GetTransform(
+		const TRS_ARRAYS& transforms,
+		size_t index,
+		glm::vec3& scaleXYZ,
+		glm::vec3& rotationDegreesXYZ,
+		glm::vec3& positionXYZ)
+	{
+		for (int axis = 0; axis < 3; axis++)
+		{
+			scaleXYZ[axis] = transforms.scaleXYZ[axis][index];
+			rotationDegreesXYZ[axis] = transforms.rotationDegreesXYZ[axis][index];
+			positionXYZ[axis] = transforms.positionXYZ[axis][index];
+		}
+	}
+
+	/***********************************************************
+	 *  MaxDifference()
+	 *
+	 *  This function is used for getting the largest element
+	 *  difference between two matrices.
+	 ***********************************************************/
+	float MaxDifference(const glm::mat4& a, const glm::mat4& b)
+	{
+		float difference = 0.0f;
+		for (int column = 0; column < 4; column++)
+		{
+			glm::vec4 delta = glm::abs(a[column] - b[column]);
+			difference = glm::max(difference, glm::max(glm::max(delta.x, delta.y), glm::max(delta.z, delta.w)));
+		}
+
+		return(difference);
+	}
+
+	/***********************************************************
+	 *  ComposeMatrixRange()
+	 *
+	 *  This function is used for composing the model matrices
+	 *  of a run of the transforms into packed or aligned
+	 *  matrices. With SSE2 or NEON four transforms are done at
+	 *  once, one per lane: the rotation terms of a column are
+	 *  computed for the four of them, then transposed into the
+	 *  column of each matrix. The transforms left over, or all
+	 *  of them without SIMD, go through ComposeModelMatrix().
+	 ***********************************************************/
+	template<typename MATRIX>
+	void ComposeMatrixRange(
+		const TRS_ARRAYS& transforms,
+		size_t first,
+		size_t count,
+		MATRIX* pMatrices)
+	{
+		const size_t end = first + count;
+		size_t i = first;
+
+#if SIMD_FLOAT4
+		const FLOAT4 zero = Float4Zero();
+		const FLOAT4 one = Float4Set(1.0f);
+
+		for (; i + 4 <= end; i += 4)
+		{
+			// the trigonometry stays scalar, the products go four wide
+			float sines[3][4];
+			float cosines[3][4];
+			for (int axis = 0; axis < 3; axis++)
+			{
+				for (int lane = 0; lane < 4; lane++)
+				{
+					float angle = glm::radians(transforms.rotationDegreesXYZ[axis][i + lane]);
+					sines[axis][lane] = sin(angle);
+					cosines[axis][lane] = cos(angle);
+				}
+			}
+			FLOAT4 sx = Float4Load(sines[0]);
+			FLOAT4 cx = Float4Load(cosines[0]);
+			FLOAT4 sy = Float4Load(sines[1]);
+			FLOAT4 cy = Float4Load(cosines[1]);
+			FLOAT4 sz = Float4Load(sines[2]);
+			FLOAT4 cz = Float4Load(cosines[2]);
+			FLOAT4 sxsy = Float4Mul(sx, sy);
+			FLOAT4 cxsy = Float4Mul(cx, sy);
+
+			// rows 0 to 2 of the three rotation columns
+			FLOAT4 rows[3][4];
+			rows[0][0] = Float4Mul(cy, cz);
+			rows[0][1] = Float4Add(Float4Mul(cx, sz), Float4Mul(sxsy, cz));
+			rows[0][2] = Float4Sub(Float4Mul(sx, sz), Float4Mul(cxsy, cz));
+			rows[1][0] = Float4Sub(zero, Float4Mul(cy, sz));
+			rows[1][1] = Float4Sub(Float4Mul(cx, cz), Float4Mul(sxsy, sz));
+			rows[1][2] = Float4Add(Float4Mul(sx, cz), Float4Mul(cxsy, sz));
+			rows[2][0] = sy;
+			rows[2][1] = Float4Sub(zero, Float4Mul(sx, cy));
+			rows[2][2] = Float4Mul(cx, cy);
+
+			for (int column = 0; column < 3; column++)
+			{
+				FLOAT4 scale = Float4Load(&transforms.scaleXYZ[column][i]);
+				FLOAT4 row0 = Float4Mul(rows[column][0], scale);
+				FLOAT4 row1 = Float4Mul(rows[column][1], scale);
+				FLOAT4 row2 = Float4Mul(rows[column][2], scale);
+				FLOAT4 row3 = zero;
+				Float4Transpose(row0, row1, row2, row3);
+				Float4Store(&pMatrices[i - first][column][0], row0);
+				Float4Store(&pMatrices[i - first + 1][column][0], row1);
+				Float4Store(&pMatrices[i - first + 2][column][0], row2);
+				Float4Store(&pMatrices[i - first + 3][column][0], row3);
+			}
+
+			FLOAT4 positionX = Float4Load(&transforms.positionXYZ[0][i]);
+			FLOAT4 positionY = Float4Load(&transforms.positionXYZ[1][i]);
+			FLOAT4 positionZ = Float4Load(&transforms.positionXYZ[2][i]);
+			FLOAT4 positionW = one;
+			Float4Transpose(positionX, positionY, positionZ, positionW);
+			Float4Store(&pMatrices[i - first][3][0], positionX);
+			Float4Store(&pMatrices[i - first + 1][3][0], positionY);
+			Float4Store(&pMatrices[i - first + 2][3][0], positionZ);
+			Float4Store(&pMatrices[i - first + 3][3][0], positionW);
+		}
+#endif
+
+		for (; i < end; i++)
+		{
+			glm::vec3 scaleXYZ;
+			glm::vec3 rotationDegreesXYZ;
+			glm::vec3 positionXYZ;
+			GetTransform(transforms, i, scaleXYZ, rotationDegreesXYZ, positionXYZ);
+			pMatrices[i - first] = ComposeModelMatrix(scaleXYZ, rotationDegreesXYZ, positionXYZ);
+		}
+	}
+}
+
+/***********************************************************
+ *  MultiplyModelMatrix()
+ *
+ *  This function is used for building a model matrix as the
+ *  product of the scale, three rotation and translation
+ *  matrices, which is what the composition replaces and is
+ *  kept as the reference of the benchmark.
+ ***********************************************************/
+glm::mat4 MultiplyModelMatrix(
+	const glm::vec3& scaleXYZ,
+	const glm::vec3& rotationDegreesXYZ,
+	const glm::vec3& positionXYZ)
+{
+	glm::mat4 scale = glm::scale(scaleXYZ);
+	glm::mat4 rotationX = glm::rotate(glm::radians(rotationDegreesXYZ.x), glm::vec3(1.0f, 0.0f, 0.0f));
+	glm::mat4 rotationY = glm::rotate(glm::radians(rotationDegreesXYZ.y), glm::vec3(0.0f, 1.0f, 0.0f));
+	glm::mat4 rotationZ = glm::rotate(glm::radians(rotationDegreesXYZ.z), glm::vec3(0.0f, 0.0f, 1.0f));
+	glm::mat4 translation = glm::translate(positionXYZ);
+
+	return(translation * rotationX * rotationY * rotationZ * scale);
+}
+
+/***********************************************************
+ *  ComposeModelMatrix()
+ *
+ *  This function is used for building a model matrix from
+ *  scale, rotation in degrees and position, applied in
+ *  scale, Z, Y, X rotation and translation order. The
+ *  columns of Rx * Ry * Rz are written out from the sines
+ *  and cosines and scaled per axis, and the position is the
+ *  last column, so no matrix product is needed.
+ ***********************************************************/
+glm::mat4 ComposeModelMatrix(
+	const glm::vec3& scaleXYZ,
+	const glm::vec3& rotationDegreesXYZ,
+	const glm::vec3& positionXYZ)
+{
+	glm::vec3 radians = glm::radians(rotationDegreesXYZ);
+	float sx = sin(radians.x);
+	float cx = cos(radians.x);
+	float sy = sin(radians.y);
+	float cy = cos(radians.y);
+	float sz = sin(radians.z);
+	float cz = cos(radians.z);
+
+	glm::mat4 model;
+	model[0] = glm::vec4(cy * cz, cx * sz + sx * sy * cz, sx * sz - cx * sy * cz, 0.0f) * scaleXYZ.x;
+	model[1] = glm::vec4(-cy * sz, cx * cz - sx * sy * sz, sx * cz + cx * sy * sz, 0.0f) * scaleXYZ.y;
+	model[2] = glm::vec4(sy, -sx * cy, cx * cy, 0.0f) * scaleXYZ.z;
+	model[3] = glm::vec4(positionXYZ, 1.0f);
+
+	return(model);
+}
+
+/***********************************************************
+ *  ComputeNormalMatrix()
+ *
+ *  This function is used for the normal matrix of a model
+ *  matrix. The columns of the inverse transpose of the
+ *  upper 3x3 are the cross products of its axes over its
+ *  determinant, so no general inverse is needed. A matrix
+ *  that flattens an axis has no inverse and keeps the cross
+ *  products, which the shaders normalize anyway.
+ ***********************************************************/
+glm::mat3 ComputeNormalMatrix(const glm::mat4& model)
+{
+	glm::vec3 axisX(model[0]);
+	glm::vec3 axisY(model[1]);
+	glm::vec3 axisZ(model[2]);
+	glm::mat3 cofactors(glm::cross(axisY, axisZ), glm::cross(axisZ, axisX), glm::cross(axisX, axisY));
+
+	float determinant = glm::dot(axisX, cofactors[0]);
+	if (determinant == 0.0f)
+	{
+		return(cofactors);
+	}
+	return(cofactors * (1.0f / determinant));
+}
+
+/***********************************************************
+ *  ComposeModelMatrices()
+ *
+ *  This function is used for composing the model matrices
+ *  of every transform of the arrays.
+ ***********************************************************/
+void ComposeModelMatrices(
+	const TRS_ARRAYS& transforms,
+	glm::mat4* pMatrices)
+{
+	ComposeModelMatrices(transforms, 0, transforms.Size(), pMatrices);
+}
+
+/***********************************************************
+ *  ComposeModelMatrices()
+ *
+ *  This function is used for composing the model matrices
+ *  of a run of the transforms, so callers can split the
+ *  arrays between threads or skip the unchanged ones.
+ ***********************************************************/
+void ComposeModelMatrices(
+	const TRS_ARRAYS& transforms,
+	size_t first,
+	size_t count,
+	glm::mat4* pMatrices)
+{
+	ComposeMatrixRange(transforms, first, count, pMatrices);
+}
+
+#if ALIGNED_MODEL_MATRICES
+void ComposeModelMatrices(
+	const TRS_ARRAYS& transforms,
+	size_t first,
+	size_t count,
+	MODEL_MATRIX* pMatrices)
+{
+	ComposeMatrixRange(transforms, first, count, pMatrices);
+}
+#endif
+
+/***********************************************************
+ *  MultiplyModelMatrices()
+ *
+ *  This function is used for the world matrix of a node
+ *  from its parent's and its local matrix, with the SSE2
+ *  or NEON product of SIMDMath.h when the matrices are
+ *  aligned.
+ ***********************************************************/
+void MultiplyModelMatrices(
+	const MODEL_MATRIX& parent,
+	const MODEL_MATRIX& local,
+	MODEL_MATRIX& world)
+{
+#if ALIGNED_MODEL_MATRICES
+	Float4MultiplyMatrix(&parent[0][0], &local[0][0], &world[0][0]);
+#else
+	world = parent * local;
+#endif
+}
+
+/***********************************************************
+ *  IsMatrixKernelSupported()
+ *
+ *  This function is used for checking a kernel is built and
+ *  the processor has its instructions.
+ ***********************************************************/
+bool IsMatrixKernelSupported(MATRIX_KERNEL kernel)
+{
+	if ((kernel < 0) || (kernel >= MATRIX_KERNEL_COUNT))
+	{
+		return(false);
+	}
+
+	return(GetSupportedKernels()[kernel]);
+}
+
+/***********************************************************
+ *  GetMatrixKernel()
+ *
+ *  This function is used for getting the kernel of the
+ *  batch products.
+ ***********************************************************/
+MATRIX_KERNEL GetMatrixKernel()
+{
+	return(CurrentKernel());
+}
+
+/***********************************************************
+ *  SetMatrixKernel()
+ *
+ *  This function is used for choosing the kernel of the
+ *  batch products, for the benchmarks and to compare the
+ *  kernels; not safe while other threads multiply.
+ ***********************************************************/
+bool SetMatrixKernel(MATRIX_KERNEL kernel)
+{
+	if (IsMatrixKernelSupported(kernel) == false)
+	{
+		return(false);
+	}
+
+	CurrentKernel() = kernel;
+	return(true);
+}
+
+/***********************************************************
+ *  GetMatrixKernelName()
+ *
+ *  This function is used for getting the name a kernel is
+ *  printed with.
+ ***********************************************************/
+const char* GetMatrixKernelName(MATRIX_KERNEL kernel)
+{
+	if ((kernel < 0) || (kernel >= MATRIX_KERNEL_COUNT))
+	{
+		return("unknown");
+	}
+
+	return(MATRIX_KERNEL_NAMES[kernel]);
+}
+
+/***********************************************************
+ *  MultiplyModelMatrixBatch()
+ *
+ *  This function is used for multiplying each local matrix
+ *  by the parent at its index. pResults may be pLocals.
+ ***********************************************************/
+void MultiplyModelMatrixBatch(
+	const MODEL_MATRIX* pParents,
+	const MODEL_MATRIX* pLocals,
+	MODEL_MATRIX* pResults,
+	size_t count)
+{
+	MultiplyBatch(pParents, 1, pLocals, pResults, count);
+}
+
+/***********************************************************
+ *  MultiplyModelMatrixBatch()
+ *
+ *  This function is used for multiplying every local matrix
+ *  by the same parent. pResults may be pLocals.
+ ***********************************************************/
+void MultiplyModelMatrixBatch(
+	const MODEL_MATRIX& parent,
+	const MODEL_MATRIX* pLocals,
+	MODEL_MATRIX* pResults,
+	size_t count)
+{
+	MultiplyBatch(&parent, 0, pLocals, pResults, count);
+}
+
+/***********************************************************
+ *  UpdateWorldMatrixBatch()
+ *
+ *  This function is used for rebuilding the world matrices
+ *  of the changed nodes of a depth level from those of
+ *  their parents, which are not in the batch.
+ ***********************************************************/
+void UpdateWorldMatrixBatch(
+	const uint32_t* pNodeIDs,
+	size_t count,
+	const int* pParentIDs,
+	const unsigned char* pChanged,
+	const MODEL_MATRIX* pLocals,
+	MODEL_MATRIX* pWorlds)
+{
+	if (count == 0)
+	{
+		return;
+	}
+
+#if ALIGNED_MODEL_MATRICES && SIMD_FLOAT4_SSE2
+	if (CurrentKernel() == MATRIX_KERNEL_AVX2)
+	{
+		UpdateWorldMatricesAVX2(pNodeIDs, count, pParentIDs, pChanged, &pLocals[0][0][0], &pWorlds[0][0][0]);
+		return;
+	}
+#endif
+
+	for (size_t i = 0; i < count; i++)
+	{
+		uint32_t nodeID = pNodeIDs[i];
+		if ((NULL != pChanged) && (pChanged[nodeID] == 0))
+		{
+			continue;
+		}
+
+		int parentID = pParentIDs[nodeID];
+		if (parentID < 0)
+		{
+			pWorlds[nodeID] = pLocals[nodeID];
+		}
+		else if ((CurrentKernel() == MATRIX_KERNEL_SSE2) || (CurrentKernel() == MATRIX_KERNEL_NEON))
+		{
+			MultiplyModelMatrices(pWorlds[parentID], pLocals[nodeID], pWorlds[nodeID]);
+		}
+		else
+		{
+			pWorlds[nodeID] = pWorlds[parentID] * pLocals[nodeID];
+		}
+	}
+}
+
+/***********************************************************
+ *  BenchmarkModelTransforms()
+ *
+ *  This function is used for timing the three ways of
+ *  building model matrices over the same random transforms.
+ *  Each is run repeats times and the sum of a matrix element
+ *  is printed, so the compiler cannot drop the loops.
+ ***********************************************************/
+void BenchmarkModelTransforms(int count, int repeats)
+{
+	if ((count <= 0) || (repeats <= 0))
+	{
+		return;
+	}
+
+	TRS_ARRAYS transforms;
+	srand(1);
+	for (int i = 0; i < count; i++)
+	{
+		glm::vec3 scale(0.1f + (float)rand() / RAND_MAX * 4.0f, 0.1f + (float)rand() / RAND_MAX * 4.0f, 0.1f + (float)rand() / RAND_MAX * 4.0f);
+		glm::vec3 rotation((float)rand() / RAND_MAX * 360.0f, (float)rand() / RAND_MAX * 360.0f, (float)rand() / RAND_MAX * 360.0f);
+		glm::vec3 position((float)rand() / RAND_MAX * 20.0f - 10.0f, (float)rand() / RAND_MAX * 20.0f - 10.0f, (float)rand() / RAND_MAX * 20.0f - 10.0f);
+		transforms.Add(scale, rotation, position);
+	}
+
+	std::vector<glm::mat4> multiplied(count);
+	std::vector<glm::mat4> composed(count);
+	std::vector<glm::mat4> batched(count);
+	float checksum = 0.0f;
+	double seconds[3] = { 0.0, 0.0, 0.0 };
+
+	for (int method = 0; method < 3; method++)
+	{
+		std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+		for (int repeat = 0; repeat < repeats; repeat++)
+		{
+			if (method == 2)
+			{
+				ComposeModelMatrices(transforms, batched.data());
+			}
+			else
+			{
+				for (int i = 0; i < count; i++)
+				{
+					glm::vec3 scaleXYZ;
+					glm::vec3 rotationDegreesXYZ;
+					glm::vec3 positionXYZ;
+					GetTransform(transforms, i, scaleXYZ, rotationDegreesXYZ, positionXYZ);
+					if (method == 0)
+					{
+						multiplied[i] = MultiplyModelMatrix(scaleXYZ, rotationDegreesXYZ, positionXYZ);
+					}
+					else
+					{
+						composed[i] = ComposeModelMatrix(scaleXYZ, rotationDegreesXYZ, positionXYZ);
+					}
+				}
+			}
+			checksum += (method == 0) ? multiplied[repeat % count][0][0] :
+				((method == 1) ? composed[repeat % count][0][0] : batched[repeat % count][0][0]);
+		}
+		std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+		seconds[method] = elapsed.count();
+	}
+
+	float composedDifference = 0.0f;
+	float batchedDifference = 0.0f;
+	for (int i = 0; i < count; i++)
+	{
+		composedDifference = glm::max(composedDifference, MaxDifference(multiplied[i], composed[i]));
+		batchedDifference = glm::max(batchedDifference, MaxDifference(multiplied[i], batched[i]));
+	}
+
+	const char* const names[3] = { "five matrix product", "ComposeModelMatrix", "ComposeModelMatrices" };
+	const double matrices = (double)count * (double)repeats;
+	std::cout << "Model matrix benchmark, " << count << " transforms x " << repeats << " repeats" << std::endl;
+	for (int method = 0; method < 3; method++)
+	{
+		std::cout << "  " << names[method] << ": " << seconds[method] * 1.0e9 / matrices << " ns per matrix";
+		if (method > 0)
+		{
+			std::cout << ", " << seconds[0] / seconds[method] << "x";
+		}
+		std::cout << std::endl;
+	}
+	std::cout << "  largest difference: " << composedDifference << " composed, " << batchedDifference
+		<< " batched (checksum " << checksum << ")" << std::endl;
+
+	// the world matrices of a tree of nodes with four children each,
+	// parents before children as in the scene, as packed glm products
+	// and as the aligned products the scene transforms keep, which
+	// must agree
+	MODEL_MATRIX_ARRAY alignedLocals(count);
+	ComposeModelMatrices(transforms, 0, (size_t)count, alignedLocals.data());
+	std::vector<glm::mat4> packedWorlds(count);
+	MODEL_MATRIX_ARRAY alignedWorlds(count);
+	double worldSeconds[2] = { 0.0, 0.0 };
+
+	for (int method = 0; method < 2; method++)
+	{
+		std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+		for (int repeat = 0; repeat < repeats; repeat++)
+		{
+			if (method == 0)
+			{
+				packedWorlds[0] = batched[0];
+				for (int i = 1; i < count; i++)
+				{
+					packedWorlds[i] = packedWorlds[(i - 1) / 4] * batched[i];
+				}
+			}
+			else
+			{
+				alignedWorlds[0] = alignedLocals[0];
+				for (int i = 1; i < count; i++)
+				{
+					MultiplyModelMatrices(alignedWorlds[(i - 1) / 4], alignedLocals[i], alignedWorlds[i]);
+				}
+			}
+			checksum += (method == 0) ? packedWorlds[repeat % count][0][0] : alignedWorlds[repeat % count][0][0];
+		}
+		std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+		worldSeconds[method] = elapsed.count();
+	}
+
+	// the scales multiply down the tree, so the difference is taken
+	// relative to the largest element of the packed matrix
+	float localDifference = 0.0f;
+	float worldDifference = 0.0f;
+	for (int i = 0; i < count; i++)
+	{
+		localDifference = glm::max(localDifference, MaxDifference(batched[i], glm::mat4(alignedLocals[i])));
+		float largest = MaxDifference(packedWorlds[i], glm::mat4(0.0f));
+		float difference = MaxDifference(packedWorlds[i], glm::mat4(alignedWorlds[i]));
+		worldDifference = glm::max(worldDifference, (largest > 0.0f) ? difference / largest : difference);
+	}
+
+	std::cout << "World matrix products, " << (ALIGNED_MODEL_MATRICES ? "aligned SIMD" : "unaligned") << " storage" << std::endl;
+	std::cout << "  packed: " << worldSeconds[0] * 1.0e9 / matrices << " ns per matrix" << std::endl;
+	std::cout << "  aligned: " << worldSeconds[1] * 1.0e9 / matrices << " ns per matrix, "
+		<< worldSeconds[0] / worldSeconds[1] << "x" << std::endl;
+	std::cout << "  largest difference: " << localDifference << " local, " << worldDifference
+		<< " world relative (checksum " << checksum << ")" << std::endl;
+
+	// the batch products of each kernel this processor runs, with the
+	// world matrices as parents, against the packed glm products
+	std::vector<glm::mat4> packedProducts(count);
+	for (int i = 0; i < count; i++)
+	{
+		packedProducts[i] = packedWorlds[i] * batched[i];
+	}
+	MODEL_MATRIX_ARRAY batchProducts(count);
+	const MATRIX_KERNEL kernelInUse = GetMatrixKernel();
+	std::cout << "Batch matrix products, one thread" << std::endl;
+	for (int kernel = 0; kernel < MATRIX_KERNEL_COUNT; kernel++)
+	{
+		if (SetMatrixKernel((MATRIX_KERNEL)kernel) == false)
+		{
+			std::cout << "  " << GetMatrixKernelName((MATRIX_KERNEL)kernel) << ": not supported" << std::endl;
+			continue;
+		}
+
+		std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+		for (int repeat = 0; repeat < repeats; repeat++)
+		{
+			MultiplyModelMatrixBatch(alignedWorlds.data(), alignedLocals.data(), batchProducts.data(), (size_t)count);
+			checksum += batchProducts[repeat % count][0][0];
+		}
+		std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+
+		float batchDifference = 0.0f;
+		for (int i = 0; i < count; i++)
+		{
+			float largest = MaxDifference(packedProducts[i], glm::mat4(0.0f));
+			float difference = MaxDifference(packedProducts[i], glm::mat4(batchProducts[i]));
+			batchDifference = glm::max(batchDifference, (largest > 0.0f) ? difference / largest : difference);
+		}
+		std::cout << "  " << GetMatrixKernelName((MATRIX_KERNEL)kernel) << ": "
+			<< elapsed.count() * 1.0e9 / matrices << " ns per matrix, "
+			<< matrices / elapsed.count() * 1.0e-6 << " M matrices per second, largest difference "
+			<< batchDifference << (((MATRIX_KERNEL)kernel == kernelInUse) ? " (in use)" : "") << std::endl;
+	}
+	SetMatrixKernel(kernelInUse);
+	std::cout << "  checksum " << checksum << std::endl;
+}
@@ -0,0 +1,239 @@
+///////////////////////////////////////////////////////////////////////////////
+// modeltransforms.h
+// ============
+// compose model matrices from scale, rotation and position
+//
+//  Builds T * Rx * Ry * Rz * S straight from the sine and cosine of
+//  the three angles instead of multiplying five matrices, one at a
+//  time or four at a time from component arrays. The project builds
+//  glm with GLM_FORCE_INTRINSICS, or GLM_FORCE_NEON on ARM64, so the
+//  matrices the scene keeps for itself can be 16 byte aligned and
+//  multiplied with the SSE2 or NEON products of SIMDMath.h; the
+//  matrices handed to GL stay packed. Arrays of products, as a depth
+//  level of the hierarchy needs, go through batch kernels: glm's
+//  product, SSE2 or NEON one column at a time, chosen at compile
+//  time, or AVX2 and FMA two columns at a time where the processor
+//  has them.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include "SIMDMath.h"
+
+// aligned matrices need glm's SIMD types, which GLM_FORCE_INTRINSICS
+// turns on, and SSE2 or NEON for the products
+#if (GLM_CONFIG_ALIGNED_GENTYPES == GLM_ENABLE) && SIMD_FLOAT4
+#define ALIGNED_MODEL_MATRICES 1
+#include <glm/gtc/type_aligned.hpp>
+#else
+#define ALIGNED_MODEL_MATRICES 0
+#endif
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+/***********************************************************
+ *  TRS_ARRAYS
+ *
+ *  This struct holds the scale, rotation in degrees and
+ *  position of many transforms with one array per component,
+ *  so ComposeModelMatrices() can load four transforms of a
+ *  component with one SIMD load.
+ ***********************************************************/
+struct TRS_ARRAYS
+{
+	std::vector<float> scaleXYZ[3];
+	std::vector<float> rotationDegreesXYZ[3];
+	std::vector<float> positionXYZ[3];
+
+	size_t Size() const { return(scaleXYZ[0].size()); }
+
+	void Reserve(size_t count)
+	{
+		for (int axis = 0; axis < 3; axis++)
+		{
+			scaleXYZ[axis].reserve(count);
+			rotationDegreesXYZ[axis].reserve(count);
+			positionXYZ[axis].reserve(count);
+		}
+	}
+
+	void Clear()
+	{
+		for (int axis = 0; axis < 3; axis++)
+		{
+			scaleXYZ[axis].clear();
+			rotationDegreesXYZ[axis].clear();
+			positionXYZ[axis].clear();
+		}
+	}
+
+	void Add(
+		const glm::vec3& scale,
+		const glm::vec3& rotationDegrees,
+		const glm::vec3& position)
+	{
+		for (int axis = 0; axis < 3; axis++)
+		{
+			scaleXYZ[axis].push_back(scale[axis]);
+			rotationDegreesXYZ[axis].push_back(rotationDegrees[axis]);
+			positionXYZ[axis].push_back(position[axis]);
+		}
+	}
+};
+
+#if ALIGNED_MODEL_MATRICES
+/***********************************************************
+ *  ALIGNED_ALLOCATOR
+ *
+ *  This struct allocates the elements of a vector on the
+ *  alignment of their type, which operator new does not
+ *  promise past 8 bytes on 32 bit Windows before C++17.
+ *  The block is moved up to the alignment, with the pointer
+ *  malloc() returned kept just before it, so the same code
+ *  serves every platform.
+ ***********************************************************/
+template<typename T>
+struct ALIGNED_ALLOCATOR
+{
+	typedef T value_type;
+
+	ALIGNED_ALLOCATOR() {}
+	template<typename U>
+	ALIGNED_ALLOCATOR(const ALIGNED_ALLOCATOR<U>&) {}
+
+	T* allocate(size_t count)
+	{
+		const size_t alignment = alignof(T);
+		void* pMemory = malloc(count * sizeof(T) + alignment + sizeof(void*));
+		if (pMemory == NULL)
+		{
+			throw std::bad_alloc();
+		}
+		uintptr_t start = ((uintptr_t)pMemory + sizeof(void*) + alignment - 1) & ~(uintptr_t)(alignment - 1);
+		reinterpret_cast<void**>(start)[-1] = pMemory;
+		return(reinterpret_cast<T*>(start));
+	}
+
+	void deallocate(T* pElements, size_t)
+	{
+		free(reinterpret_cast<void**>(pElements)[-1]);
+	}
+};
+
+template<typename T, typename U>
+bool operator==(const ALIGNED_ALLOCATOR<T>&, const ALIGNED_ALLOCATOR<U>&) { return(true); }
+template<typename T, typename U>
+bool operator!=(const ALIGNED_ALLOCATOR<T>&, const ALIGNED_ALLOCATOR<U>&) { return(false); }
+
+// a matrix the scene keeps for itself, never handed to GL as it is
+typedef glm::aligned_mat4 MODEL_MATRIX;
+typedef std::vector<MODEL_MATRIX, ALIGNED_ALLOCATOR<MODEL_MATRIX>> MODEL_MATRIX_ARRAY;
+#else
+typedef glm::mat4 MODEL_MATRIX;
+typedef std::vector<MODEL_MATRIX> MODEL_MATRIX_ARRAY;
+#endif
+
+// the same model matrix as the product of the five glm matrices,
+// which ComposeModelMatrix() replaced, kept as the reference the
+// benchmarks compare against
+glm::mat4 MultiplyModelMatrix(
+	const glm::vec3& scaleXYZ,
+	const glm::vec3& rotationDegreesXYZ,
+	const glm::vec3& positionXYZ);
+
+// model matrix applying scale, Z, Y, X rotation and translation in
+// that order, the same as the product of the five glm matrices
+glm::mat4 ComposeModelMatrix(
+	const glm::vec3& scaleXYZ,
+	const glm::vec3& rotationDegreesXYZ,
+	const glm::vec3& positionXYZ);
+
+// inverse transpose of the upper 3x3 of a model matrix, which turns
+// object space normals into world space ones that stay perpendicular
+// to the surface under non-uniform scale
+glm::mat3 ComputeNormalMatrix(const glm::mat4& model);
+
+// compose the model matrices of every transform of the arrays into
+// pMatrices, which holds at least transforms.Size() matrices
+void ComposeModelMatrices(
+	const TRS_ARRAYS& transforms,
+	glm::mat4* pMatrices);
+// compose the count transforms from first on, the one at first
+// going to pMatrices[0]
+void ComposeModelMatrices(
+	const TRS_ARRAYS& transforms,
+	size_t first,
+	size_t count,
+	glm::mat4* pMatrices);
+#if ALIGNED_MODEL_MATRICES
+void ComposeModelMatrices(
+	const TRS_ARRAYS& transforms,
+	size_t first,
+	size_t count,
+	MODEL_MATRIX* pMatrices);
+#endif
+
+// world = parent * local, four columns at a time with SSE2 or NEON
+// when the matrices are aligned, the same as glm's product otherwise
+void MultiplyModelMatrices(
+	const MODEL_MATRIX& parent,
+	const MODEL_MATRIX& local,
+	MODEL_MATRIX& world);
+
+// instruction sets the batch products can run on
+enum MATRIX_KERNEL
+{
+	MATRIX_KERNEL_GLM = 0,
+	MATRIX_KERNEL_SSE2,
+	MATRIX_KERNEL_AVX2,
+	MATRIX_KERNEL_NEON,
+	MATRIX_KERNEL_COUNT
+};
+
+// true when both the build and the processor can run the kernel
+bool IsMatrixKernelSupported(MATRIX_KERNEL kernel);
+// the kernel of the batch products, the widest supported one unless
+// SetMatrixKernel() chose another
+MATRIX_KERNEL GetMatrixKernel();
+// run the batch products on a supported kernel; false, keeping the
+// one in use, for a kernel that is not
+bool SetMatrixKernel(MATRIX_KERNEL kernel);
+const char* GetMatrixKernelName(MATRIX_KERNEL kernel);
+
+// pResults[i] = pParents[i] * pLocals[i] for count matrices
+void MultiplyModelMatrixBatch(
+	const MODEL_MATRIX* pParents,
+	const MODEL_MATRIX* pLocals,
+	MODEL_MATRIX* pResults,
+	size_t count);
+// pResults[i] = parent * pLocals[i], as a view projection is
+// premultiplied into model matrices
+void MultiplyModelMatrixBatch(
+	const MODEL_MATRIX& parent,
+	const MODEL_MATRIX* pLocals,
+	MODEL_MATRIX* pResults,
+	size_t count);
+// for each of the count nodes of pNodeIDs whose pChanged flag is set,
+// or all of them for NULL, pWorlds[node] = pWorlds[parent] *
+// pLocals[node], or pLocals[node] for a root; no node of the batch
+// may be the parent of another, as within a depth level
+void UpdateWorldMatrixBatch(
+	const uint32_t* pNodeIDs,
+	size_t count,
+	const int* pParentIDs,
+	const unsigned char* pChanged,
+	const MODEL_MATRIX* pLocals,
+	MODEL_MATRIX* pWorlds);
+
+// time the five matrix product, ComposeModelMatrix() and
+// ComposeModelMatrices() over count random transforms, then the
+// packed and aligned world matrix products and the batch products of
+// each supported kernel, and print the results and the largest
+// difference between them
+void BenchmarkModelTransforms(int count, int repeats);
@@ -0,0 +1,136 @@
+///////////////////////////////////////////////////////////////////////////////
+// modeltransformsavx2.cpp
+// ============
+// AVX2 and FMA kernels of the batch matrix products
+//
+//  Each product handles two columns of the result per 256 bit
+//  register: the four columns of the parent are repeated in both
+//  halves of a register, and every element of two columns of the
+//  local is spread over the half of its column, so four fused
+//  multiply-adds give two result columns. This file is built with
+//  /arch:AVX2 and must stay free of glm and the standard library.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "ModelTransformsAVX2.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+
+namespace
+{
+	// floats of a 4x4 matrix
+	const size_t MATRIX_FLOATS = 16;
+
+	/***********************************************************
+	 *  MultiplyMatrix()
+	 *
+	 *  This function is used for one product, result = parent
+	 *  * local, reading both before writing so the result may
+	 *  be either of them.
+	 ***********************************************************/
+	inline void MultiplyMatrix(const float* pParent, const float* pLocal, float* pResult)
+	{
+		__m256 parent0 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(pParent));
+		__m256 parent1 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(pParent + 4));
+		__m256 parent2 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(pParent + 8));
+		__m256 parent3 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(pParent + 12));
+		__m256 local01 = _mm256_loadu_ps(pLocal);
+		__m256 local23 = _mm256_loadu_ps(pLocal + 8);
+
+		__m256 result01 = _mm256_mul_ps(parent0, _mm256_shuffle_ps(local01, local01, _MM_SHUFFLE(0, 0, 0, 0)));
+		result01 = _mm256_fmadd_ps(parent1, _mm256_shuffle_ps(local01, local01, _MM_SHUFFLE(1, 1, 1, 1)), result01);
+		result01 = _mm256_fmadd_ps(parent2, _mm256_shuffle_ps(local01, local01, _MM_SHUFFLE(2, 2, 2, 2)), result01);
+		result01 = _mm256_fmadd_ps(parent3, _mm256_shuffle_ps(local01, local01, _MM_SHUFFLE(3, 3, 3, 3)), result01);
+
+		__m256 result23 = _mm256_mul_ps(parent0, _mm256_shuffle_ps(local23, local23, _MM_SHUFFLE(0, 0, 0, 0)));
+		result23 = _mm256_fmadd_ps(parent1, _mm256_shuffle_ps(local23, local23, _MM_SHUFFLE(1, 1, 1, 1)), result23);
+		result23 = _mm256_fmadd_ps(parent2, _mm256_shuffle_ps(local23, local23, _MM_SHUFFLE(2, 2, 2, 2)), result23);
+		result23 = _mm256_fmadd_ps(parent3, _mm256_shuffle_ps(local23, local23, _MM_SHUFFLE(3, 3, 3, 3)), result23);
+
+		_mm256_storeu_ps(pResult, result01);
+		_mm256_storeu_ps(pResult + 8, result23);
+	}
+}
+
+/***********************************************************
+ *  AreAVX2MatrixKernelsBuilt()
+ *
+ *  This function is used for telling the dispatch the AVX2
+ *  kernels are real.
+ ***********************************************************/
+bool AreAVX2MatrixKernelsBuilt()
+{
+	return(true);
+}
+
+/***********************************************************
+ *  MultiplyMatricesAVX2()
+ *
+ *  This function is used for a batch of products.
+ ***********************************************************/
+void MultiplyMatricesAVX2(
+	const float* pParents,
+	size_t parentStep,
+	const float* pLocals,
+	float* pResults,
+	size_t count)
+{
+	const size_t parentFloats = parentStep * MATRIX_FLOATS;
+	for (size_t i = 0; i < count; i++)
+	{
+		MultiplyMatrix(pParents + i * parentFloats, pLocals + i * MATRIX_FLOATS, pResults + i * MATRIX_FLOATS);
+	}
+}
+
+/***********************************************************
+ *  UpdateWorldMatricesAVX2()
+ *
+ *  This function is used for the world matrices of the
+ *  changed nodes of a depth level.
+ ***********************************************************/
+void UpdateWorldMatricesAVX2(
+	const uint32_t* pNodeIDs,
+	size_t count,
+	const int* pParentIDs,
+	const unsigned char* pChanged,
+	const float* pLocals,
+	float* pWorlds)
+{
+	for (size_t i = 0; i < count; i++)
+	{
+		uint32_t nodeID = pNodeIDs[i];
+		if ((pChanged != NULL) && (pChanged[nodeID] == 0))
+		{
+			continue;
+		}
+
+		const float* pLocal = pLocals + nodeID * MATRIX_FLOATS;
+		float* pWorld = pWorlds + nodeID * MATRIX_FLOATS;
+		int parentID = pParentIDs[nodeID];
+		if (parentID < 0)
+		{
+			_mm256_storeu_ps(pWorld, _mm256_loadu_ps(pLocal));
+			_mm256_storeu_ps(pWorld + 8, _mm256_loadu_ps(pLocal + 8));
+		}
+		else
+		{
+			MultiplyMatrix(pWorlds + (size_t)parentID * MATRIX_FLOATS, pLocal, pWorld);
+		}
+	}
+}
+#else
+// built without AVX2, the dispatch never picks these
+
+bool AreAVX2MatrixKernelsBuilt()
+{
+	return(false);
+}
+
+void MultiplyMatricesAVX2(const float*, size_t, const float*, float*, size_t)
+{
+}
+
+void UpdateWorldMatricesAVX2(const uint32_t*, size_t, const int*, const unsigned char*, const float*, float*)
+{
+}
+#endif
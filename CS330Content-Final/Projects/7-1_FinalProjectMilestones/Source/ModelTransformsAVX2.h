@@ -0,0 +1,40 @@
+///////////////////////////////////////////////////////////////////////////////
+// modeltransformsavx2.h
+// ============
+// AVX2 and FMA kernels of the batch matrix products
+//
+//  The kernels work on column major 4x4 float matrices, 16 floats
+//  each, so their translation unit, the only one built with
+//  /arch:AVX2, includes no glm or standard library code that could
+//  be shared with the rest of the program and run on a processor
+//  without AVX2. ModelTransforms.cpp only calls them once the
+//  processor is known to have AVX2, FMA and the OS support for them.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// true when the kernels were built with AVX2, false when the
+// compiler was not asked for it and they do nothing
+bool AreAVX2MatrixKernelsBuilt();
+
+// pResults[i] = pParents[i * parentStep] * pLocals[i], parentStep 0
+// multiplying every local by the same parent
+void MultiplyMatricesAVX2(
+	const float* pParents,
+	size_t parentStep,
+	const float* pLocals,
+	float* pResults,
+	size_t count);
+
+// the world matrices of the nodes of a depth level, as
+// UpdateWorldMatrixBatch() describes them
+void UpdateWorldMatricesAVX2(
+	const uint32_t* pNodeIDs,
+	size_t count,
+	const int* pParentIDs,
+	const unsigned char* pChanged,
+	const float* pLocals,
+	float* pWorlds);
@@ -0,0 +1,321 @@
+///////////////////////////////////////////////////////////////////////////////
+// netsocket.cpp
+// ============
+// the few TCP socket calls of the streaming, the render service and the
+// distributed batch
+//
+//  Winsock and the BSD sockets differ in their handle type, how a
+//  socket is closed and the startup Winsock needs, so the callers use
+//  these instead and never include the platform headers, which on
+//  Windows have to come before anything else pulling in windows.h.
+///////////////////////////////////////////////////////////////////////////////
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#pragma comment(lib, "Ws2_32.lib")
+#else
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <netdb.h>
+#include <unistd.h>
+#endif
+
+#include "NetSocket.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+namespace
+{
+#ifdef _WIN32
+	typedef SOCKET SOCKET_HANDLE;
+#else
+	typedef int SOCKET_HANDLE;
+	const SOCKET_HANDLE INVALID_SOCKET = -1;
+#endif
+
+	// most bytes handed to one send call
+	const size_t MAX_SEND_CHUNK = (size_t)1 << 20;
+
+	// a send to a client that went away fails rather than raising
+	// SIGPIPE, which would end the process; Linux takes that per
+	// call, Apple per socket, and Winsock never raises it
+#ifdef MSG_NOSIGNAL
+	const int SEND_FLAGS = MSG_NOSIGNAL;
+#else
+	const int SEND_FLAGS = 0;
+#endif
+
+	// set the options of a connected socket: Nagle's delay off, so
+	// what is written goes out at once, and no SIGPIPE on Apple
+	void SetConnectedOptions(SOCKET_HANDLE connectedSocket)
+	{
+		int noDelay = 1;
+		setsockopt(connectedSocket, IPPROTO_TCP, TCP_NODELAY, (const char*)&noDelay, sizeof(noDelay));
+#ifdef SO_NOSIGPIPE
+		int noSignal = 1;
+		setsockopt(connectedSocket, SOL_SOCKET, SO_NOSIGPIPE, (const char*)&noSignal, sizeof(noSignal));
+#endif
+	}
+}
+
+/***********************************************************
+ *  Startup()
+ *
+ *  This method is used for starting Winsock, which every
+ *  user does before its first socket; elsewhere there is
+ *  nothing to start.
+ ***********************************************************/
+bool NetSocket::Startup()
+{
+#ifdef _WIN32
+	WSADATA wsaData;
+	return(WSAStartup(MAKEWORD(2, 2), &wsaData) == 0);
+#else
+	return(true);
+#endif
+}
+
+/***********************************************************
+ *  Cleanup()
+ *
+ *  This method is used for releasing Winsock once for every
+ *  Startup().
+ ***********************************************************/
+void NetSocket::Cleanup()
+{
+#ifdef _WIN32
+	WSACleanup();
+#endif
+}
+
+/***********************************************************
+ *  Listen()
+ *
+ *  This method is used for opening a TCP port for incoming
+ *  connections. The port may be taken again at once after
+ *  the last run closed it.
+ ***********************************************************/
+uintptr_t NetSocket::Listen(int port, bool bLoopbackOnly)
+{
+	SOCKET_HANDLE listenSocket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	if (listenSocket == INVALID_SOCKET)
+	{
+		return(INVALID_HANDLE);
+	}
+	int reuse = 1;
+	setsockopt(listenSocket, SOL_SOCKET, SO_REUSEADDR, (const char*)&reuse, sizeof(reuse));
+
+	sockaddr_in address;
+	memset(&address, 0, sizeof(address));
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = htonl((bLoopbackOnly == true) ? INADDR_LOOPBACK : INADDR_ANY);
+	address.sin_port = htons((unsigned short)port);
+	if ((bind(listenSocket, (const sockaddr*)&address, sizeof(address)) != 0) ||
+		(listen(listenSocket, SOMAXCONN) != 0))
+	{
+		Close((uintptr_t)listenSocket);
+		return(INVALID_HANDLE);
+	}
+	return((uintptr_t)listenSocket);
+}
+
+/***********************************************************
+ *  Accept()
+ *
+ *  This method is used for taking a waiting connection,
+ *  with Nagle's delay off, so a frame or image goes out as
+ *  soon as it is written.
+ ***********************************************************/
+uintptr_t NetSocket::Accept(uintptr_t listenSocket)
+{
+	SOCKET_HANDLE clientSocket = accept((SOCKET_HANDLE)listenSocket, NULL, NULL);
+	if (clientSocket == INVALID_SOCKET)
+	{
+		return(INVALID_HANDLE);
+	}
+	SetConnectedOptions(clientSocket);
+	return((uintptr_t)clientSocket);
+}
+
+/***********************************************************
+ *  Connect()
+ *
+ *  This method is used for connecting to a host, trying
+ *  each address its name resolves to in turn, with Nagle's
+ *  delay off as for an accepted connection.
+ ***********************************************************/
+uintptr_t NetSocket::Connect(const char* host, int port)
+{
+	addrinfo hints;
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	hints.ai_protocol = IPPROTO_TCP;
+	char service[16];
+	snprintf(service, sizeof(service), "%d", port);
+	addrinfo* pAddresses = NULL;
+	if (getaddrinfo(host, service, &hints, &pAddresses) != 0)
+	{
+		return(INVALID_HANDLE);
+	}
+
+	SOCKET_HANDLE connected = INVALID_SOCKET;
+	for (addrinfo* pAddress = pAddresses; (NULL != pAddress) && (connected == INVALID_SOCKET); pAddress = pAddress->ai_next)
+	{
+		SOCKET_HANDLE candidate = socket(pAddress->ai_family, pAddress->ai_socktype, pAddress->ai_protocol);
+		if (candidate == INVALID_SOCKET)
+		{
+			continue;
+		}
+		if (connect(candidate, pAddress->ai_addr, (int)pAddress->ai_addrlen) != 0)
+		{
+			Close((uintptr_t)candidate);
+			continue;
+		}
+		connected = candidate;
+	}
+	freeaddrinfo(pAddresses);
+	if (connected == INVALID_SOCKET)
+	{
+		return(INVALID_HANDLE);
+	}
+	SetConnectedOptions(connected);
+	return((uintptr_t)connected);
+}
+
+/***********************************************************
+ *  GetPeerAddress()
+ *
+ *  This method is used for getting the address a connection
+ *  came from, in numbers, so a stream to the client can be
+ *  sent there without resolving a name.
+ ***********************************************************/
+std::string NetSocket::GetPeerAddress(uintptr_t socketHandle)
+{
+	sockaddr_storage address;
+	socklen_t addressSize = sizeof(address);
+	if (getpeername((SOCKET_HANDLE)socketHandle, (sockaddr*)&address, &addressSize) != 0)
+	{
+		return(std::string());
+	}
+	char host[NI_MAXHOST];
+	if (getnameinfo((const sockaddr*)&address, addressSize, host, sizeof(host), NULL, 0, NI_NUMERICHOST) != 0)
+	{
+		return(std::string());
+	}
+	return(std::string(host));
+}
+
+/***********************************************************
+ *  WaitReadable()
+ *
+ *  This method is used for waiting on several sockets at
+ *  once, with select(), whose set holds at most
+ *  FD_SETSIZE of them.
+ ***********************************************************/
+bool NetSocket::WaitReadable(const std::vector<uintptr_t>& sockets, long microseconds,
+	std::vector<bool>& readable)
+{
+	readable.assign(sockets.size(), false);
+	fd_set readSet;
+	FD_ZERO(&readSet);
+	uintptr_t highest = 0;
+	for (size_t i = 0; i < sockets.size(); i++)
+	{
+		FD_SET((SOCKET_HANDLE)sockets[i], &readSet);
+		highest = std::max(highest, sockets[i]);
+	}
+	timeval timeout;
+	timeout.tv_sec = microseconds / 1000000;
+	timeout.tv_usec = microseconds % 1000000;
+	if (select((int)highest + 1, &readSet, NULL, NULL, &timeout) <= 0)
+	{
+		return(false);
+	}
+	for (size_t i = 0; i < sockets.size(); i++)
+	{
+		readable[i] = (FD_ISSET((SOCKET_HANDLE)sockets[i], &readSet) != 0);
+	}
+	return(true);
+}
+
+/***********************************************************
+ *  WaitReadable()
+ *
+ *  This method is used for waiting on one socket.
+ ***********************************************************/
+bool NetSocket::WaitReadable(uintptr_t socketHandle, long microseconds)
+{
+	std::vector<uintptr_t> sockets(1, socketHandle);
+	std::vector<bool> readable;
+	return(WaitReadable(sockets, microseconds, readable));
+}
+
+/***********************************************************
+ *  Receive()
+ *
+ *  This method is used for reading what arrived, at most
+ *  the size of the buffer.
+ ***********************************************************/
+int NetSocket::Receive(uintptr_t socketHandle, void* pBuffer, size_t size)
+{
+	return((int)recv((SOCKET_HANDLE)socketHandle, (char*)pBuffer, (int)size, 0));
+}
+
+/***********************************************************
+ *  SendAll()
+ *
+ *  This method is used for sending a whole buffer, a chunk
+ *  per call. A closed connection fails the send, never
+ *  the process.
+ ***********************************************************/
+bool NetSocket::SendAll(uintptr_t socketHandle, const void* pData, size_t size)
+{
+	const char* pBytes = (const char*)pData;
+	while (size > 0)
+	{
+		int chunk = (int)std::min(size, MAX_SEND_CHUNK);
+		int sent = (int)send((SOCKET_HANDLE)socketHandle, pBytes, chunk, SEND_FLAGS);
+		if (sent <= 0)
+		{
+			return(false);
+		}
+		pBytes += sent;
+		size -= (size_t)sent;
+	}
+	return(true);
+}
+
+/***********************************************************
+ *  Shutdown()
+ *
+ *  This method is used for ending the connection without
+ *  closing the handle, which another thread may still use.
+ ***********************************************************/
+void NetSocket::Shutdown(uintptr_t socketHandle)
+{
+#ifdef _WIN32
+	shutdown((SOCKET_HANDLE)socketHandle, SD_BOTH);
+#else
+	shutdown((SOCKET_HANDLE)socketHandle, SHUT_RDWR);
+#endif
+}
+
+/***********************************************************
+ *  Close()
+ *
+ *  This method is used for closing a socket.
+ ***********************************************************/
+void NetSocket::Close(uintptr_t socketHandle)
+{
+#ifdef _WIN32
+	closesocket((SOCKET_HANDLE)socketHandle);
+#else
+	close((SOCKET_HANDLE)socketHandle);
+#endif
+}
@@ -0,0 +1,65 @@
+///////////////////////////////////////////////////////////////////////////////
+// netsocket.h
+// ============
+// the few TCP socket calls of the streaming, the render service and the
+// distributed batch
+//
+//  Winsock and the BSD sockets differ in their handle type, how a
+//  socket is closed and the startup Winsock needs, so the callers use
+//  these instead and never include the platform headers, which on
+//  Windows have to come before anything else pulling in windows.h.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/***********************************************************
+ *  NetSocket
+ *
+ *  This class contains the socket calls, on handles kept as
+ *  integers of pointer size, which hold either platform's.
+ *  The calls block, at most the time given where they wait.
+ ***********************************************************/
+class NetSocket
+{
+public:
+	// a handle that is no socket
+	static const uintptr_t INVALID_HANDLE = ~(uintptr_t)0;
+
+	// take and release the socket library, once per user
+	static bool Startup();
+	static void Cleanup();
+
+	// listen on a TCP port, of the loopback interface only or of
+	// every interface; INVALID_HANDLE when the port cannot be opened
+	static uintptr_t Listen(int port, bool bLoopbackOnly);
+	// take a connection waiting on a listening socket, sending
+	// what is written at once
+	static uintptr_t Accept(uintptr_t listenSocket);
+	// connect to a TCP port of a host, by name or address;
+	// INVALID_HANDLE when it cannot be reached
+	static uintptr_t Connect(const char* host, int port);
+	// numeric address of the other end of a connection, empty when
+	// it has none
+	static std::string GetPeerAddress(uintptr_t socketHandle);
+	// wait until any of the sockets has data or a connection, at
+	// most the time given, and flag the ones that have; false when
+	// none has
+	static bool WaitReadable(const std::vector<uintptr_t>& sockets, long microseconds,
+		std::vector<bool>& readable);
+	static bool WaitReadable(uintptr_t socketHandle, long microseconds);
+
+	// bytes received, 0 once the other end closed, negative on error
+	static int Receive(uintptr_t socketHandle, void* pBuffer, size_t size);
+	// send every byte, as many calls as it takes; false when the
+	// connection failed
+	static bool SendAll(uintptr_t socketHandle, const void* pData, size_t size);
+
+	// end both directions, waking a thread blocked on the socket
+	static void Shutdown(uintptr_t socketHandle);
+	static void Close(uintptr_t socketHandle);
+};
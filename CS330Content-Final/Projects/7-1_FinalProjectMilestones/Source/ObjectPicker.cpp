@@ -0,0 +1,304 @@
+///////////////////////////////////////////////////////////////////////////////
+// objectpicker.cpp
+// ============
+// picking the object under a point of the view from an ID pass
+//
+//  Casting a ray against the bounds of every draw finds the box in
+//  front, not the surface, and testing the triangles on the CPU does
+//  not scale. When a pick is asked for, the draws of the frame are
+//  drawn once more into a small integer target covering only the few
+//  pixels around the point, each fragment writing the ID of its
+//  instance, and the target is read into a pixel buffer behind a
+//  fence. The result is taken a frame or two later, once the fence
+//  passed, so the frames never wait for the GPU.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "ObjectPicker.h"
+#include "GPUMemory.h"
+#include "GLTrace.h"
+
+#include <glm/gtc/type_ptr.hpp>
+
+#include <cfloat>
+#include <cstring>
+#include <iostream>
+
+/***********************************************************
+ *  ObjectPicker()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+ObjectPicker::ObjectPicker(ShaderManager* pShaderManager)
+{
+	m_pShaderManager = pShaderManager;
+	m_program = 0;
+	m_instanceBaseLocation = -1;
+	m_firstIDLocation = -1;
+	m_pickRegionLocation = -1;
+	m_framebuffer = 0;
+	m_renderbuffers[0] = 0;
+	m_renderbuffers[1] = 0;
+	m_pixelBuffer = 0;
+	m_fence = 0;
+	m_bRequested = false;
+	m_requestX = 0.5f;
+	m_requestY = 0.5f;
+	memset(&m_stats, 0, sizeof(m_stats));
+	m_savedFramebuffer = 0;
+	memset(m_savedViewport, 0, sizeof(m_savedViewport));
+	m_savedDepthFunc = GL_LESS;
+	m_savedDepthMask = GL_TRUE;
+	m_bSavedBlend = GL_FALSE;
+	m_bSavedScissor = GL_FALSE;
+}
+
+/***********************************************************
+ *  ~ObjectPicker()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+ObjectPicker::~ObjectPicker()
+{
+	if (0 != m_fence)
+	{
+		glDeleteSync(m_fence);
+		m_fence = 0;
+	}
+	if (0 != m_framebuffer)
+	{
+		glDeleteFramebuffers(1, &m_framebuffer);
+		m_framebuffer = 0;
+	}
+	GPUMemory::DeleteRenderbuffers(2, m_renderbuffers);
+	m_renderbuffers[0] = 0;
+	m_renderbuffers[1] = 0;
+	GPUMemory::DeleteBuffers(1, &m_pixelBuffer);
+	m_pixelBuffer = 0;
+	if (0 != m_program)
+	{
+		glDeleteProgram(m_program);
+		m_program = 0;
+	}
+}
+
+/***********************************************************
+ *  Create()
+ *
+ *  This method is used for building the ID program and the
+ *  target of the picked region. The IDs are unsigned
+ *  integers, so no blending or filtering ever mixes two of
+ *  them.
+ ***********************************************************/
+bool ObjectPicker::Create(const char* vertexPath, const char* fragmentPath, int instanceDataTextureUnit)
+{
+	if (NULL == m_pShaderManager)
+	{
+		return(false);
+	}
+
+	m_program = m_pShaderManager->LoadExternalProgram(vertexPath, fragmentPath);
+	if (0 == m_program)
+	{
+		std::cout << "Object picking disabled, the ID shader did not build" << std::endl;
+		return(false);
+	}
+	m_pShaderManager->UseExternalProgram(m_program);
+	glUniform1i(glGetUniformLocation(m_program, "instanceData"), instanceDataTextureUnit);
+	m_instanceBaseLocation = glGetUniformLocation(m_program, "instanceBase");
+	m_firstIDLocation = glGetUniformLocation(m_program, "firstID");
+	m_pickRegionLocation = glGetUniformLocation(m_program, "pickRegion");
+
+	glGenRenderbuffers(2, m_renderbuffers);
+	glBindRenderbuffer(GL_RENDERBUFFER, m_renderbuffers[0]);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_R32UI, PICK_REGION_SIZE, PICK_REGION_SIZE);
+	glBindRenderbuffer(GL_RENDERBUFFER, m_renderbuffers[1]);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT32F, PICK_REGION_SIZE, PICK_REGION_SIZE);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+	GPUMemory::TrackRenderbuffer(m_renderbuffers[0], GL_R32UI, PICK_REGION_SIZE, PICK_REGION_SIZE, 1, "pick IDs");
+	GPUMemory::TrackRenderbuffer(m_renderbuffers[1], GL_DEPTH_COMPONENT32F, PICK_REGION_SIZE, PICK_REGION_SIZE, 1,
+		"pick depth");
+
+	glGenFramebuffers(1, &m_framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, m_renderbuffers[0]);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, m_renderbuffers[1]);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+	{
+		std::cout << "Object pick framebuffer is incomplete" << std::endl;
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	const GLsizeiptr bytes = PICK_REGION_SIZE * PICK_REGION_SIZE * sizeof(GLuint);
+	glGenBuffers(1, &m_pixelBuffer);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, m_pixelBuffer);
+	glBufferData(GL_PIXEL_PACK_BUFFER, bytes, NULL, GL_STREAM_READ);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	GPUMemory::TrackBuffer(m_pixelBuffer, bytes, GPUMemory::CATEGORY_BUFFER, "pick readback");
+	return(true);
+}
+
+/***********************************************************
+ *  Request()
+ *
+ *  This method is used for asking for the object at a point
+ *  of the view. A later request before the ID pass is drawn
+ *  replaces the earlier one.
+ ***********************************************************/
+void ObjectPicker::Request(float x, float y)
+{
+	m_requestX = glm::clamp(x, 0.0f, 1.0f);
+	m_requestY = glm::clamp(y, 0.0f, 1.0f);
+	m_bRequested = true;
+}
+
+/***********************************************************
+ *  BeginPick()
+ *
+ *  This method is used for pointing the draws at the ID
+ *  target. The picked region of the bound viewport is
+ *  stretched over the whole target by the matrix the clip
+ *  positions are multiplied with, so the region is drawn at
+ *  the pixel size of the view and nothing outside it is
+ *  rasterized at all.
+ ***********************************************************/
+void ObjectPicker::BeginPick(bool bReverseZ)
+{
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &m_savedFramebuffer);
+	glGetIntegerv(GL_VIEWPORT, m_savedViewport);
+	glGetIntegerv(GL_DEPTH_FUNC, &m_savedDepthFunc);
+	glGetBooleanv(GL_DEPTH_WRITEMASK, &m_savedDepthMask);
+	m_bSavedBlend = glIsEnabled(GL_BLEND);
+	m_bSavedScissor = glIsEnabled(GL_SCISSOR_TEST);
+
+	// half the size of the region in normalized device coordinates
+	const float halfWidth = (float)PICK_REGION_SIZE / (float)glm::max(m_savedViewport[2], 1);
+	const float halfHeight = (float)PICK_REGION_SIZE / (float)glm::max(m_savedViewport[3], 1);
+	glm::mat4 pickRegion = glm::mat4(1.0f);
+	pickRegion[0][0] = 1.0f / halfWidth;
+	pickRegion[1][1] = 1.0f / halfHeight;
+	pickRegion[3][0] = -((m_requestX * 2.0f) - 1.0f) / halfWidth;
+	pickRegion[3][1] = -((m_requestY * 2.0f) - 1.0f) / halfHeight;
+
+	glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+	glViewport(0, 0, PICK_REGION_SIZE, PICK_REGION_SIZE);
+	glDisable(GL_BLEND);
+	glDisable(GL_SCISSOR_TEST);
+	glEnable(GL_DEPTH_TEST);
+	glDepthMask(GL_TRUE);
+	glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+	glDepthFunc((bReverseZ == true) ? GL_GREATER : GL_LESS);
+	const GLuint noObject[4] = { 0, 0, 0, 0 };
+	const GLfloat farDepth = (bReverseZ == true) ? 0.0f : 1.0f;
+	GLTrace::RecordClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	glClearBufferuiv(GL_COLOR, 0, noObject);
+	glClearBufferfv(GL_DEPTH, 0, &farDepth);
+
+	m_pShaderManager->UseExternalProgram(m_program);
+	glUniformMatrix4fv(m_pickRegionLocation, 1, GL_FALSE, glm::value_ptr(pickRegion));
+}
+
+/***********************************************************
+ *  DrawBatch()
+ *
+ *  This method is used for drawing the instances of one
+ *  batch with consecutive IDs.
+ ***********************************************************/
+void ObjectPicker::DrawBatch(
+	GLint instanceBase,
+	GLint firstID,
+	const ShapeMeshes::DRAW_RANGE& range,
+	GLsizei instanceCount)
+{
+	glUniform1i(m_instanceBaseLocation, instanceBase);
+	glUniform1i(m_firstIDLocation, firstID);
+	ShapeMeshes::DrawRange(range, instanceCount);
+}
+
+/***********************************************************
+ *  EndPick()
+ *
+ *  This method is used for reading the IDs into the pixel
+ *  buffer behind a fence and giving the frame back its
+ *  framebuffer and state.
+ ***********************************************************/
+void ObjectPicker::EndPick()
+{
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, m_framebuffer);
+	glReadBuffer(GL_COLOR_ATTACHMENT0);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, m_pixelBuffer);
+	glPixelStorei(GL_PACK_ALIGNMENT, 4);
+	glReadPixels(0, 0, PICK_REGION_SIZE, PICK_REGION_SIZE, GL_RED_INTEGER, GL_UNSIGNED_INT, NULL);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	m_fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	m_bRequested = false;
+	m_stats.picks++;
+
+	glBindFramebuffer(GL_FRAMEBUFFER, (GLuint)m_savedFramebuffer);
+	glViewport(m_savedViewport[0], m_savedViewport[1], m_savedViewport[2], m_savedViewport[3]);
+	glDepthFunc((GLenum)m_savedDepthFunc);
+	glDepthMask(m_savedDepthMask);
+	if (m_bSavedBlend == GL_TRUE)
+	{
+		glEnable(GL_BLEND);
+	}
+	if (m_bSavedScissor == GL_TRUE)
+	{
+		glEnable(GL_SCISSOR_TEST);
+	}
+}
+
+/***********************************************************
+ *  TakeResult()
+ *
+ *  This method is used for taking the IDs of the last pick
+ *  once its fence passed, never waiting for it. The ID
+ *  drawn nearest the center of the region wins, so the
+ *  object under the point itself comes first.
+ ***********************************************************/
+bool ObjectPicker::TakeResult(uint32_t& objectID)
+{
+	if (0 == m_fence)
+	{
+		return(false);
+	}
+	GLenum result = glClientWaitSync(m_fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+	if (result == GL_TIMEOUT_EXPIRED)
+	{
+		m_stats.pendingPolls++;
+		return(false);
+	}
+	glDeleteSync(m_fence);
+	m_fence = 0;
+
+	objectID = 0;
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, m_pixelBuffer);
+	const GLuint* pIDs = (const GLuint*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0,
+		PICK_REGION_SIZE * PICK_REGION_SIZE * sizeof(GLuint), GL_MAP_READ_BIT);
+	if (NULL != pIDs)
+	{
+		const float center = (float)PICK_REGION_SIZE * 0.5f;
+		float nearest = FLT_MAX;
+		for (int y = 0; y < PICK_REGION_SIZE; y++)
+		{
+			for (int x = 0; x < PICK_REGION_SIZE; x++)
+			{
+				GLuint id = pIDs[(y * PICK_REGION_SIZE) + x];
+				float dx = ((float)x + 0.5f) - center;
+				float dy = ((float)y + 0.5f) - center;
+				if ((0 != id) && ((dx * dx) + (dy * dy) < nearest))
+				{
+					nearest = (dx * dx) + (dy * dy);
+					objectID = id;
+				}
+			}
+		}
+		glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	if (0 != objectID)
+	{
+		m_stats.hits++;
+	}
+	return(true);
+}
@@ -0,0 +1,100 @@
+///////////////////////////////////////////////////////////////////////////////
+// objectpicker.h
+// ============
+// picking the object under a point of the view from an ID pass
+//
+//  Casting a ray against the bounds of every draw finds the box in
+//  front, not the surface, and testing the triangles on the CPU does
+//  not scale. When a pick is asked for, the draws of the frame are
+//  drawn once more into a small integer target covering only the few
+//  pixels around the point, each fragment writing the ID of its
+//  instance, and the target is read into a pixel buffer behind a
+//  fence. The result is taken a frame or two later, once the fence
+//  passed, so the frames never wait for the GPU.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "ShaderManager.h"
+#include "ShapeMeshes.h"
+
+/***********************************************************
+ *  ObjectPicker
+ *
+ *  This class contains the ID program, the ID target and the
+ *  pixel buffer of the one pick in flight. A request made
+ *  while a readback is in flight waits for it to be taken.
+ ***********************************************************/
+class ObjectPicker
+{
+public:
+	// constructor
+	ObjectPicker(ShaderManager* pShaderManager);
+	// destructor
+	~ObjectPicker();
+
+	// pixels on a side of the region around the picked point that
+	// is drawn, so a click just beside a thin object still finds it
+	static const int PICK_REGION_SIZE = 8;
+
+	// picks since the start
+	struct PICK_STATS
+	{
+		unsigned long long picks;			// ID passes drawn
+		unsigned long long hits;			// that found an object
+		unsigned long long pendingPolls;	// polls before a readback arrived
+	};
+
+	// build the ID program reading the instance data from a texture
+	// unit, and the target; false when either fails
+	bool Create(const char* vertexPath, const char* fragmentPath, int instanceDataTextureUnit);
+	bool IsAvailable() const { return(0 != m_program); }
+
+	// ask for the object at a point of the view, 0..1 from its lower
+	// left corner
+	void Request(float x, float y);
+	// true when the next ID pass should be drawn: a request waits and
+	// no readback is in flight
+	bool IsRequested() const { return((m_bRequested == true) && (0 == m_fence)); }
+
+	// draw the ID pass of the view bound now between these, with
+	// the depth convention of the frame; every batch takes the IDs
+	// from firstID on, one per instance
+	void BeginPick(bool bReverseZ);
+	void DrawBatch(GLint instanceBase, GLint firstID, const ShapeMeshes::DRAW_RANGE& range, GLsizei instanceCount);
+	void EndPick();
+
+	// take the result of the last pick once its readback arrived,
+	// without waiting: the ID nearest the point, 0 for none; false
+	// while no result is in
+	bool TakeResult(uint32_t& objectID);
+
+	const PICK_STATS& GetStats() const { return(m_stats); }
+
+private:
+	// pointer to shader manager object
+	ShaderManager* m_pShaderManager;
+	GLuint m_program;
+	GLint m_instanceBaseLocation;
+	GLint m_firstIDLocation;
+	GLint m_pickRegionLocation;
+	// R32UI ID and depth renderbuffers of the region, and the pixel
+	// buffer the IDs are read into
+	GLuint m_framebuffer;
+	GLuint m_renderbuffers[2];
+	GLuint m_pixelBuffer;
+	// fence of the readback in flight, 0 for none
+	GLsync m_fence;
+	bool m_bRequested;
+	float m_requestX;
+	float m_requestY;
+	PICK_STATS m_stats;
+
+	// state of the frame to restore after the ID pass
+	GLint m_savedFramebuffer;
+	GLint m_savedViewport[4];
+	GLint m_savedDepthFunc;
+	GLboolean m_savedDepthMask;
+	GLboolean m_bSavedBlend;
+	GLboolean m_bSavedScissor;
+};
@@ -0,0 +1,343 @@
+///////////////////////////////////////////////////////////////////////////////
+// occlusionculler.cpp
+// ============
+// GPU occlusion culling of multi-draw indirect commands
+//
+//  Keeps a hierarchical depth pyramid of the previous frame and
+//  zeroes the instance count of the indirect commands whose bounds
+//  are hidden behind it, without the CPU reading anything back.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "OcclusionCuller.h"
+#include "GPUMemory.h"
+#include "GLTrace.h"
+
+namespace
+{
+	// work group sizes declared by the compute shaders
+	const int PYRAMID_GROUP_SIZE = 8;
+	const int CULL_GROUP_SIZE = 64;
+
+	// binding points declared by the compute shaders
+	const GLuint PYRAMID_IMAGE_UNIT = 0;
+	const GLuint COMMAND_BOUNDS_BINDING = 0;
+	const GLuint INDIRECT_COMMANDS_BINDING = 1;
+}
+
+/***********************************************************
+ *  OcclusionCuller()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+OcclusionCuller::OcclusionCuller(ShaderManager* pShaderManager)
+{
+	m_pShaderManager = pShaderManager;
+	m_pyramidProgram = 0;
+	m_cullProgram = 0;
+	m_sourceLevelLocation = -1;
+	m_pyramidViewProjectionLocation = -1;
+	m_commandCountLocation = -1;
+	m_pyramidReverseDepthLocation = -1;
+	m_cullReverseDepthLocation = -1;
+	m_depthTexture = 0;
+	m_pyramidTexture = 0;
+	m_pyramidWidth = 0;
+	m_pyramidHeight = 0;
+	m_pyramidLevels = 0;
+	m_pyramidViewProjection = glm::mat4(1.0f);
+	m_bPyramidValid = false;
+	m_bReverseDepth = false;
+	m_commandBoundsBuffer = 0;
+	m_commandCount = 0;
+}
+
+/***********************************************************
+ *  ~OcclusionCuller()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+OcclusionCuller::~OcclusionCuller()
+{
+	DestroyPyramidTextures();
+	if (0 != m_commandBoundsBuffer)
+	{
+		GPUMemory::DeleteBuffers(1, &m_commandBoundsBuffer);
+		m_commandBoundsBuffer = 0;
+	}
+	if (0 != m_pyramidProgram)
+	{
+		glDeleteProgram(m_pyramidProgram);
+		m_pyramidProgram = 0;
+	}
+	if (0 != m_cullProgram)
+	{
+		glDeleteProgram(m_cullProgram);
+		m_cullProgram = 0;
+	}
+	m_pShaderManager = NULL;
+}
+
+/***********************************************************
+ *  Create()
+ *
+ *  This method is used for building the compute programs of
+ *  the occlusion culling. Compute shaders, storage buffers
+ *  and image stores all came with OpenGL 4.3, so without it
+ *  the culling stays unavailable and every command is drawn.
+ ***********************************************************/
+bool OcclusionCuller::Create(
+	const char* pyramidShaderPath,
+	const char* cullShaderPath)
+{
+	if ((NULL == m_pShaderManager) || (GLEW_VERSION_4_3 != GL_TRUE))
+	{
+		return(false);
+	}
+
+	m_pyramidProgram = m_pShaderManager->LoadComputeShader(pyramidShaderPath);
+	m_cullProgram = m_pShaderManager->LoadComputeShader(cullShaderPath);
+	if ((0 == m_pyramidProgram) || (0 == m_cullProgram))
+	{
+		std::cout << "Occlusion culling disabled, its compute shaders did not build" << std::endl;
+		if (0 != m_pyramidProgram)
+		{
+			glDeleteProgram(m_pyramidProgram);
+			m_pyramidProgram = 0;
+		}
+		if (0 != m_cullProgram)
+		{
+			glDeleteProgram(m_cullProgram);
+			m_cullProgram = 0;
+		}
+		return(false);
+	}
+
+	m_sourceLevelLocation = glGetUniformLocation(m_pyramidProgram, "sourceLevel");
+	m_pyramidViewProjectionLocation = glGetUniformLocation(m_cullProgram, "pyramidViewProjection");
+	m_commandCountLocation = glGetUniformLocation(m_cullProgram, "commandCount");
+	m_pyramidReverseDepthLocation = glGetUniformLocation(m_pyramidProgram, "bReverseDepth");
+	m_cullReverseDepthLocation = glGetUniformLocation(m_cullProgram, "bReverseDepth");
+
+	glGenBuffers(1, &m_commandBoundsBuffer);
+
+	return(true);
+}
+
+/***********************************************************
+ *  CreatePyramidTextures()
+ *
+ *  This method is used for creating the depth buffer copy
+ *  and the pyramid for a viewport size. Level 0 of the
+ *  pyramid has the size of the viewport and every level
+ *  above halves it, rounding down, like a mip chain.
+ ***********************************************************/
+void OcclusionCuller::CreatePyramidTextures(int width, int height)
+{
+	DestroyPyramidTextures();
+
+	m_pyramidWidth = width;
+	m_pyramidHeight = height;
+	m_pyramidLevels = 1;
+	for (int size = glm::max(width, height); size > 1; size /= 2)
+	{
+		m_pyramidLevels++;
+	}
+
+	// create both on the pyramid unit, so the bindings of the scene
+	// textures stay what the shader manager expects
+	m_pShaderManager->SetActiveTextureUnit(DEPTH_PYRAMID_TEXTURE_UNIT);
+
+	glGenTextures(1, &m_depthTexture);
+	m_pShaderManager->BindTexture(DEPTH_PYRAMID_TEXTURE_UNIT, m_depthTexture);
+	glTexStorage2D(GL_TEXTURE_2D, 1, GL_DEPTH_COMPONENT32F, width, height);
+	GPUMemory::TrackTexture(m_depthTexture, GL_DEPTH_COMPONENT32F, width, height, 1, 1,
+		GPUMemory::CATEGORY_RENDER_TARGET, "occlusion depth");
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+	glGenTextures(1, &m_pyramidTexture);
+	m_pShaderManager->BindTexture(DEPTH_PYRAMID_TEXTURE_UNIT, m_pyramidTexture);
+	glTexStorage2D(GL_TEXTURE_2D, m_pyramidLevels, GL_R32F, width, height);
+	GPUMemory::TrackTexture(m_pyramidTexture, GL_R32F, width, height, 1, m_pyramidLevels,
+		GPUMemory::CATEGORY_RENDER_TARGET, "depth pyramid");
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+	m_bPyramidValid = false;
+}
+
+/***********************************************************
+ *  DestroyPyramidTextures()
+ *
+ *  This method is used for freeing the depth buffer copy
+ *  and the pyramid.
+ ***********************************************************/
+void OcclusionCuller::DestroyPyramidTextures()
+{
+	// unbind first, so a new texture reusing an ID is never
+	// taken for the one already bound
+	if ((NULL != m_pShaderManager) && ((0 != m_depthTexture) || (0 != m_pyramidTexture)))
+	{
+		m_pShaderManager->BindTexture(DEPTH_PYRAMID_TEXTURE_UNIT, 0);
+	}
+	if (0 != m_depthTexture)
+	{
+		GPUMemory::DeleteTextures(1, &m_depthTexture);
+		m_depthTexture = 0;
+	}
+	if (0 != m_pyramidTexture)
+	{
+		GPUMemory::DeleteTextures(1, &m_pyramidTexture);
+		m_pyramidTexture = 0;
+	}
+	m_bPyramidValid = false;
+}
+
+/***********************************************************
+ *  SetCommandBounds()
+ *
+ *  This method is used for uploading the world bounds of
+ *  every indirect command together with the instance count
+ *  the culling writes back for visible commands. It is
+ *  called whenever the indirect commands are rebuilt.
+ ***********************************************************/
+void OcclusionCuller::SetCommandBounds(
+	const std::vector<SceneBVH::AABB>& commandBounds,
+	const std::vector<uint32_t>& instanceCounts)
+{
+	if (IsAvailable() == false)
+	{
+		return;
+	}
+
+	m_commandCount = (GLuint)commandBounds.size();
+	m_commandBounds.resize(2 * commandBounds.size());
+	for (size_t i = 0; i < commandBounds.size(); i++)
+	{
+		m_commandBounds[2 * i] = glm::vec4(commandBounds[i].minXYZ, (float)instanceCounts[i]);
+		m_commandBounds[2 * i + 1] = glm::vec4(commandBounds[i].maxXYZ, 0.0f);
+	}
+
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_commandBoundsBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, m_commandBounds.size() * sizeof(glm::vec4),
+		m_commandBounds.data(), GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	GPUMemory::TrackBuffer(m_commandBoundsBuffer, m_commandBounds.size() * sizeof(glm::vec4),
+		GPUMemory::CATEGORY_BUFFER, "occlusion bounds");
+}
+
+/***********************************************************
+ *  CullCommands()
+ *
+ *  This method is used for testing the bounds of every
+ *  indirect command against the pyramid of the previous
+ *  frame on the GPU. The compute shader writes the instance
+ *  count of each command straight into the indirect buffer,
+ *  and the barrier makes the following indirect draws read
+ *  the written counts. Only the range holding the commands
+ *  of the frame is bound.
+ ***********************************************************/
+void OcclusionCuller::CullCommands(GLuint indirectBuffer, GLintptr offset, GLsizeiptr size)
+{
+	if ((IsAvailable() == false) || (m_bPyramidValid == false) ||
+		(0 == indirectBuffer) || (0 == m_commandCount))
+	{
+		return;
+	}
+
+	m_pShaderManager->UseExternalProgram(m_cullProgram);
+	m_pShaderManager->BindTexture(DEPTH_PYRAMID_TEXTURE_UNIT, m_pyramidTexture);
+	glUniformMatrix4fv(m_pyramidViewProjectionLocation, 1, GL_FALSE, &m_pyramidViewProjection[0][0]);
+	glUniform1ui(m_commandCountLocation, m_commandCount);
+	glUniform1i(m_cullReverseDepthLocation, (m_bReverseDepth == true) ? 1 : 0);
+
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, COMMAND_BOUNDS_BINDING, m_commandBoundsBuffer);
+	glBindBufferRange(GL_SHADER_STORAGE_BUFFER, INDIRECT_COMMANDS_BINDING, indirectBuffer, offset, size);
+	glDispatchCompute((m_commandCount + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE, 1, 1);
+	glMemoryBarrier(GL_COMMAND_BARRIER_BIT);
+}
+
+/***********************************************************
+ *  BuildDepthPyramid()
+ *
+ *  This method is used for copying the depth buffer of the
+ *  frame just drawn and reducing it into the pyramid, each
+ *  level keeping the farthest depth of the texels below it,
+ *  the smallest one with reverse-Z depth. Commands tested against a level are then hidden only if
+ *  they are behind everything the level covers.
+ ***********************************************************/
+void OcclusionCuller::BuildDepthPyramid(const glm::mat4& viewProjection)
+{
+	if (IsAvailable() == false)
+	{
+		return;
+	}
+
+	GLint viewport[4] = { 0, 0, 0, 0 };
+	glGetIntegerv(GL_VIEWPORT, viewport);
+	if ((viewport[2] <= 0) || (viewport[3] <= 0))
+	{
+		return;
+	}
+	if ((viewport[2] != m_pyramidWidth) || (viewport[3] != m_pyramidHeight))
+	{
+		CreatePyramidTextures(viewport[2], viewport[3]);
+	}
+
+	m_pShaderManager->BindTexture(DEPTH_PYRAMID_TEXTURE_UNIT, m_depthTexture);
+	m_pShaderManager->SetActiveTextureUnit(DEPTH_PYRAMID_TEXTURE_UNIT);
+	GLTrace::RecordCopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, viewport[0], viewport[1], viewport[2], viewport[3]);
+	glCopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, viewport[0], viewport[1], viewport[2], viewport[3]);
+
+	m_pShaderManager->UseExternalProgram(m_pyramidProgram);
+	glUniform1i(m_pyramidReverseDepthLocation, (m_bReverseDepth == true) ? 1 : 0);
+
+	int levelWidth = m_pyramidWidth;
+	int levelHeight = m_pyramidHeight;
+	for (int level = 0; level < m_pyramidLevels; level++)
+	{
+		if (level == 0)
+		{
+			glUniform1i(m_sourceLevelLocation, -1);
+		}
+		else
+		{
+			// read the level below through the sampler
+			m_pShaderManager->BindTexture(DEPTH_PYRAMID_TEXTURE_UNIT, m_pyramidTexture);
+			glUniform1i(m_sourceLevelLocation, level - 1);
+		}
+
+		glBindImageTexture(PYRAMID_IMAGE_UNIT, m_pyramidTexture, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+		glDispatchCompute(
+			(levelWidth + PYRAMID_GROUP_SIZE - 1) / PYRAMID_GROUP_SIZE,
+			(levelHeight + PYRAMID_GROUP_SIZE - 1) / PYRAMID_GROUP_SIZE, 1);
+		glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+
+		levelWidth = glm::max(levelWidth / 2, 1);
+		levelHeight = glm::max(levelHeight / 2, 1);
+	}
+
+	m_pyramidViewProjection = viewProjection;
+	m_bPyramidValid = true;
+}
+
+/***********************************************************
+ *  SetReverseDepth()
+ *
+ *  This method is used for setting whether the depth buffer
+ *  holds reverse-Z depth, which turns the farthest depth of
+ *  the pyramid from the largest into the smallest. The
+ *  pyramid of the other convention would hide the wrong
+ *  commands, so it is dropped until the next frame builds
+ *  one.
+ ***********************************************************/
+void OcclusionCuller::SetReverseDepth(bool bReverse)
+{
+	if (bReverse != m_bReverseDepth)
+	{
+		m_bReverseDepth = bReverse;
+		m_bPyramidValid = false;
+	}
+}
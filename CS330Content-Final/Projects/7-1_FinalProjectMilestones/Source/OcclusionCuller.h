@@ -0,0 +1,98 @@
+///////////////////////////////////////////////////////////////////////////////
+// occlusionculler.h
+// ============
+// GPU occlusion culling of multi-draw indirect commands
+//
+//  Keeps a hierarchical depth pyramid of the previous frame and
+//  zeroes the instance count of the indirect commands whose bounds
+//  are hidden behind it, without the CPU reading anything back.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "ShaderManager.h"
+#include "SceneBVH.h"
+
+#include <vector>
+
+/***********************************************************
+ *  OcclusionCuller
+ *
+ *  This class contains the compute programs and textures of
+ *  the occlusion culling. The pyramid is built at the end of
+ *  a frame from the depth buffer, and the commands of the
+ *  next frame are tested against it before they are drawn.
+ ***********************************************************/
+class OcclusionCuller
+{
+public:
+	// constructor
+	OcclusionCuller(ShaderManager* pShaderManager);
+	// destructor
+	~OcclusionCuller();
+
+	// texture unit the depth pyramid is read from, above the
+	// instance buffer
+	static const int DEPTH_PYRAMID_TEXTURE_UNIT = 17;
+
+	// build the compute programs; false when the context has no
+	// compute shaders or either program fails to build
+	bool Create(
+		const char* pyramidShaderPath,
+		const char* cullShaderPath);
+	bool IsAvailable() const { return((0 != m_pyramidProgram) && (0 != m_cullProgram)); }
+
+	// set the world bounds and instance count of every indirect command
+	void SetCommandBounds(
+		const std::vector<SceneBVH::AABB>& commandBounds,
+		const std::vector<uint32_t>& instanceCounts);
+	// write the instance counts of the commands in the size bytes at
+	// offset of the indirect buffer, zero for the hidden ones; does
+	// nothing before the first pyramid
+	void CullCommands(GLuint indirectBuffer, GLintptr offset, GLsizeiptr size);
+	// build the pyramid from the depth buffer of the frame just drawn
+	void BuildDepthPyramid(const glm::mat4& viewProjection);
+	// depth convention of the following frames, 1 at the near plane
+	// with reverse-Z; a pyramid of the other convention is dropped
+	void SetReverseDepth(bool bReverse);
+	bool IsReverseDepth() const { return(m_bReverseDepth); }
+	// drop the pyramid, when the next frame's camera is unrelated to
+	// the one it was built from; the frame after it builds a new one
+	void InvalidatePyramid() { m_bPyramidValid = false; }
+
+	// the pyramid of the previous frame and the view-projection it
+	// was rendered with, for the other passes testing against it
+	bool IsPyramidValid() const { return(m_bPyramidValid); }
+	GLuint GetPyramidTexture() const { return(m_pyramidTexture); }
+	const glm::mat4& GetPyramidViewProjection() const { return(m_pyramidViewProjection); }
+
+private:
+	// pointer to shader manager object
+	ShaderManager* m_pShaderManager;
+	// compute programs building the pyramid and testing the commands
+	GLuint m_pyramidProgram;
+	GLuint m_cullProgram;
+	GLint m_sourceLevelLocation;
+	GLint m_pyramidViewProjectionLocation;
+	GLint m_commandCountLocation;
+	GLint m_pyramidReverseDepthLocation;
+	GLint m_cullReverseDepthLocation;
+	// copy of the depth buffer and the pyramid built from it
+	GLuint m_depthTexture;
+	GLuint m_pyramidTexture;
+	int m_pyramidWidth;
+	int m_pyramidHeight;
+	int m_pyramidLevels;
+	// view-projection the pyramid was rendered with
+	glm::mat4 m_pyramidViewProjection;
+	bool m_bPyramidValid;
+	bool m_bReverseDepth;
+	// (box min, instance count) and (box max, 0) per command
+	std::vector<glm::vec4> m_commandBounds;
+	GLuint m_commandBoundsBuffer;
+	GLuint m_commandCount;
+
+	// size the depth copy and pyramid textures for the viewport
+	void CreatePyramidTextures(int width, int height);
+	void DestroyPyramidTextures();
+};
@@ -0,0 +1,231 @@
+///////////////////////////////////////////////////////////////////////////////
+// occlusionqueries.cpp
+// ============
+// conditional rendering of expensive objects behind their query boxes
+//
+//  The Hi-Z culling needs multi-draw indirect and compute shaders, which
+//  older GPUs run slowly or not at all. On those the composite objects
+//  that cost the most to draw, such as the jar or an imported model,
+//  can instead be hidden with the occlusion queries of their bounding
+//  boxes. Once the other opaque draws are in the depth buffer, the box
+//  of every such object is drawn with color and depth writes off, each
+//  under an any-samples-passed query of its own, back to back from one
+//  buffer of boxes. The real draws of the object then go out between
+//  glBeginConditionalRender() and glEndConditionalRender() on its
+//  query, so the GPU skips them when no sample of the box passed, and
+//  the CPU never reads a result back.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "OcclusionQueries.h"
+#include "ShapeMeshes.h"
+
+#include <cstring>
+#include <iostream>
+
+namespace
+{
+	// corners of the box as one triangle strip, made by the vertex
+	// shader from gl_VertexID
+	const GLsizei BOX_STRIP_VERTICES = 14;
+}
+
+/***********************************************************
+ *  OcclusionQueries()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+OcclusionQueries::OcclusionQueries(ShaderManager* pShaderManager)
+{
+	m_pShaderManager = pShaderManager;
+	m_program = 0;
+	m_vao = 0;
+	memset(m_queries, 0, sizeof(m_queries));
+	m_drawnBoxes = 0;
+	m_bConditional = false;
+	memset(&m_stats, 0, sizeof(m_stats));
+}
+
+/***********************************************************
+ *  ~OcclusionQueries()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+OcclusionQueries::~OcclusionQueries()
+{
+	if (0 != m_queries[0])
+	{
+		glDeleteQueries(MAX_BOXES, m_queries);
+		memset(m_queries, 0, sizeof(m_queries));
+	}
+	m_boxBuffer.Destroy();
+	if (0 != m_vao)
+	{
+		glDeleteVertexArrays(1, &m_vao);
+		m_vao = 0;
+	}
+	if (0 != m_program)
+	{
+		glDeleteProgram(m_program);
+		m_program = 0;
+	}
+}
+
+/***********************************************************
+ *  Create()
+ *
+ *  This method is used for building the box program, the
+ *  vertex array reading one box per instance from the box
+ *  buffer, and the queries. The queries only tell whether
+ *  any sample passed, conservatively, which is all the
+ *  conditional rendering needs and the cheapest to answer.
+ ***********************************************************/
+bool OcclusionQueries::Create(const char* vertexPath, const char* fragmentPath)
+{
+	if (NULL == m_pShaderManager)
+	{
+		return(false);
+	}
+
+	m_program = m_pShaderManager->LoadExternalProgram(vertexPath, fragmentPath);
+	if (0 == m_program)
+	{
+		std::cout << "Occlusion queries disabled, the box shader did not build" << std::endl;
+		return(false);
+	}
+
+	glGenVertexArrays(1, &m_vao);
+	m_boxBuffer.Create(GPUBuffer::USAGE_STREAM, MAX_BOXES * sizeof(QUERY_BOX), NULL,
+		GPUMemory::CATEGORY_BUFFER, "occlusion query boxes");
+	ShapeMeshes::BindVertexArray(m_vao);
+	glBindBuffer(GL_ARRAY_BUFFER, m_boxBuffer.GetName());
+	for (GLuint attribute = 0; attribute < 2; attribute++)
+	{
+		glVertexAttribPointer(attribute, 4, GL_FLOAT, GL_FALSE, sizeof(QUERY_BOX),
+			(void*)(attribute * sizeof(glm::vec4)));
+		glVertexAttribDivisor(attribute, 1);
+		glEnableVertexAttribArray(attribute);
+	}
+	ShapeMeshes::BindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	glGenQueries(MAX_BOXES, m_queries);
+	return(true);
+}
+
+/***********************************************************
+ *  SetBoxes()
+ *
+ *  This method is used for keeping the boxes of the view
+ *  being built until DrawBoxes() uploads them.
+ ***********************************************************/
+void OcclusionQueries::SetBoxes(const std::vector<QUERY_BOX>& boxes)
+{
+	m_boxes.assign(boxes.begin(), boxes.begin() + glm::min((int)boxes.size(), (int)MAX_BOXES));
+	m_drawnBoxes = 0;
+}
+
+/***********************************************************
+ *  DrawBoxes()
+ *
+ *  This method is used for writing the boxes of the view
+ *  into the box buffer, orphaning its last copy, and drawing
+ *  each one under its query. Every box is one draw of a
+ *  single instance picked by the base instance, so the
+ *  program, vertex array and state are set once for all of
+ *  them. The boxes are only tested: nothing they draw may
+ *  hide the objects they stand for.
+ ***********************************************************/
+void OcclusionQueries::DrawBoxes(bool bReverseZ)
+{
+	m_drawnBoxes = 0;
+	if ((IsAvailable() == false) || (m_boxes.empty() == true))
+	{
+		return;
+	}
+
+	m_boxBuffer.Update(0, m_boxes.size() * sizeof(QUERY_BOX), &m_boxes[0]);
+
+	GLint savedDepthFunc = GL_LESS;
+	GLboolean savedDepthMask = GL_TRUE;
+	GLboolean savedColorMask[4] = { GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE };
+	glGetIntegerv(GL_DEPTH_FUNC, &savedDepthFunc);
+	glGetBooleanv(GL_DEPTH_WRITEMASK, &savedDepthMask);
+	glGetBooleanv(GL_COLOR_WRITEMASK, savedColorMask);
+	GLboolean bSavedCullFace = glIsEnabled(GL_CULL_FACE);
+
+	m_pShaderManager->UseExternalProgram(m_program);
+	ShapeMeshes::BindVertexArray(m_vao);
+	glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+	glDepthMask(GL_FALSE);
+	glDepthFunc((bReverseZ == true) ? GL_GEQUAL : GL_LEQUAL);
+	// the strip winds both ways, and either side of a face passing
+	// counts
+	glDisable(GL_CULL_FACE);
+
+	for (size_t box = 0; box < m_boxes.size(); box++)
+	{
+		glBeginQuery(GL_ANY_SAMPLES_PASSED_CONSERVATIVE, m_queries[box]);
+		glDrawArraysInstancedBaseInstance(GL_TRIANGLE_STRIP, 0, BOX_STRIP_VERTICES, 1, (GLuint)box);
+		glEndQuery(GL_ANY_SAMPLES_PASSED_CONSERVATIVE);
+	}
+	m_drawnBoxes = (int)m_boxes.size();
+
+	glColorMask(savedColorMask[0], savedColorMask[1], savedColorMask[2], savedColorMask[3]);
+	glDepthMask(savedDepthMask);
+	glDepthFunc((GLenum)savedDepthFunc);
+	if (bSavedCullFace == GL_TRUE)
+	{
+		glEnable(GL_CULL_FACE);
+	}
+
+	m_stats.frames++;
+	m_stats.boxes += m_boxes.size();
+}
+
+/***********************************************************
+ *  BeginConditional()
+ *
+ *  This method is used for starting the draws of the object
+ *  of a box. A box that was not drawn this view has no
+ *  result to wait on, so its object is drawn as usual.
+ ***********************************************************/
+void OcclusionQueries::BeginConditional(int box)
+{
+	if ((box < 0) || (box >= m_drawnBoxes) || (m_bConditional == true))
+	{
+		return;
+	}
+
+	glBeginConditionalRender(m_queries[box], GL_QUERY_WAIT);
+	m_bConditional = true;
+	m_stats.conditionalDraws++;
+}
+
+/***********************************************************
+ *  EndConditional()
+ *
+ *  This method is used for ending the draws of the object
+ *  started by BeginConditional(), if any.
+ ***********************************************************/
+void OcclusionQueries::EndConditional()
+{
+	if (m_bConditional == true)
+	{
+		glEndConditionalRender();
+		m_bConditional = false;
+	}
+}
+
+/***********************************************************
+ *  Print()
+ *
+ *  This method is used for writing the boxes drawn and the
+ *  draws they decided to the console for the exit report.
+ ***********************************************************/
+void OcclusionQueries::Print() const
+{
+	std::cout << "occlusion queries views " << m_stats.frames
+		<< "\tboxes " << m_stats.boxes
+		<< "\tconditional draws " << m_stats.conditionalDraws
+		<< "\tcamera inside " << m_stats.insideBoxes << "\n";
+}
@@ -0,0 +1,107 @@
+///////////////////////////////////////////////////////////////////////////////
+// occlusionqueries.h
+// ============
+// conditional rendering of expensive objects behind their query boxes
+//
+//  The Hi-Z culling needs multi-draw indirect and compute shaders, which
+//  older GPUs run slowly or not at all. On those the composite objects
+//  that cost the most to draw, such as the jar or an imported model,
+//  can instead be hidden with the occlusion queries of their bounding
+//  boxes. Once the other opaque draws are in the depth buffer, the box
+//  of every such object is drawn with color and depth writes off, each
+//  under an any-samples-passed query of its own, back to back from one
+//  buffer of boxes. The real draws of the object then go out between
+//  glBeginConditionalRender() and glEndConditionalRender() on its
+//  query, so the GPU skips them when no sample of the box passed, and
+//  the CPU never reads a result back.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "GPUBuffer.h"
+#include "ShaderManager.h"
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+/***********************************************************
+ *  OcclusionQueries
+ *
+ *  This class contains the box program, the buffer of the
+ *  boxes of a view and one query object per box. The boxes
+ *  are set and drawn on the thread rendering.
+ ***********************************************************/
+class OcclusionQueries
+{
+public:
+	// constructor
+	OcclusionQueries(ShaderManager* pShaderManager);
+	// destructor
+	~OcclusionQueries();
+
+	// world bounds of one queried object, 32 bytes as the box
+	// program reads them
+	struct QUERY_BOX
+	{
+		glm::vec4 minXYZ;	// w unused
+		glm::vec4 maxXYZ;
+	};
+
+	// the boxes and the draws they decided since the start
+	struct QUERY_STATS
+	{
+		unsigned long long frames;				// views the boxes were drawn in
+		unsigned long long boxes;				// boxes drawn under a query
+		unsigned long long conditionalDraws;	// draws issued under a query
+		unsigned long long insideBoxes;			// objects drawn unconditionally, the camera in their box
+	};
+
+	// boxes, and queries, a view can draw
+	static const int MAX_BOXES = 1024;
+
+	// build the box program and the queries; false when the program
+	// does not build
+	bool Create(const char* vertexPath, const char* fragmentPath);
+	bool IsAvailable() const { return(0 != m_program); }
+
+	// set the boxes of the view being built; a box is named by its
+	// index from then on, past MAX_BOXES they are dropped
+	void SetBoxes(const std::vector<QUERY_BOX>& boxes);
+	int GetBoxCount() const { return((int)m_boxes.size()); }
+	// count an object left out of the boxes as the camera is in it
+	void CountInsideBox() { m_stats.insideBoxes++; }
+
+	// draw every box under its query against the depth bound now,
+	// with the depth convention of the frame, leaving the depth and
+	// color writes, the depth function and the face culling as they
+	// were; the program and the vertex array are left changed
+	void DrawBoxes(bool bReverseZ);
+	// wrap the draws of an object in the result of its box; the GPU
+	// waits for the query in the pipeline, not the CPU
+	void BeginConditional(int box);
+	void EndConditional();
+
+	const QUERY_STATS& GetStats() const { return(m_stats); }
+	// print the stats for the exit report
+	void Print() const;
+
+private:
+	// pointer to shader manager object
+	ShaderManager* m_pShaderManager;
+	GLuint m_program;
+	GLuint m_vao;
+	GPUBuffer m_boxBuffer;
+	GLuint m_queries[MAX_BOXES];
+	std::vector<QUERY_BOX> m_boxes;
+	// boxes of the view drawn by the last DrawBoxes(), whose queries
+	// hold a result of it
+	int m_drawnBoxes;
+	// true between BeginConditional() and EndConditional()
+	bool m_bConditional;
+	QUERY_STATS m_stats;
+
+	// not copyable, the queries are owned
+	OcclusionQueries(const OcclusionQueries&);
+	OcclusionQueries& operator=(const OcclusionQueries&);
+};
@@ -0,0 +1,771 @@
+///////////////////////////////////////////////////////////////////////////////
+// particlesystem.cpp
+// ============
+// ambient particles emitted, simulated, sorted and drawn on the GPU
+//
+//  Steam over a cup or dust in a beam of light is many thousands of
+//  small quads, far too many to draw one at a time. The particles
+//  live in storage buffers instead and never come back to the CPU:
+//  each frame a compute pass takes free particles from a dead list
+//  for the ones the emitters spawn, another advances every alive
+//  particle and compacts the survivors into the other of two alive
+//  lists, returning the dead ones, and one instanced draw takes its
+//  instance count from that list's counter through an indirect
+//  command. Additive particles look the same in any order and are
+//  drawn as they are; alpha blended ones are sorted back to front
+//  with a bitonic sort first, so only they pay for it. The CPU only
+//  writes the few emitters and issues the passes.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "ParticleSystem.h"
+#include "ShapeMeshes.h"
+#include "Logger.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+namespace
+{
+	// work group size declared by both compute shaders
+	const GLuint PARTICLE_GROUP_SIZE = 64;
+	// storage bindings of the emitters, the particles, the dead list,
+	// the alive lists, the counters and the sort keys
+	const GLuint EMITTERS_BINDING = 0;
+	const GLuint PARTICLES_BINDING = 1;
+	const GLuint DEAD_LIST_BINDING = 2;
+	const GLuint ALIVE_LISTS_BINDING = 3;
+	const GLuint COUNTERS_BINDING = 4;
+	const GLuint SORT_KEYS_BINDING = 5;
+	// stages of particleSimulateCompute.glsl
+	const GLint STAGE_EMIT = 0;
+	const GLint STAGE_PREPARE = 1;
+	const GLint STAGE_SIMULATE = 2;
+	// stages of particleSortCompute.glsl
+	const GLint STAGE_SORT_KEYS = 0;
+	const GLint STAGE_SORT_MERGE = 1;
+	// the counters of a pool: the draw command of each alive list,
+	// whose instance count is the list's count, the dispatch of the
+	// simulation and the dead list's count
+	const GLuint COUNTER_DRAW_0 = 0;
+	const GLuint COUNTER_DRAW_1 = 4;
+	const GLuint COUNTER_DISPATCH = 8;
+	const GLuint COUNTER_DEAD = 11;
+	const GLuint COUNTER_COUNT = 16;
+	// bytes of one particle: position and age, velocity and life,
+	// emitter and random state
+	const GLsizeiptr PARTICLE_BYTES = 3 * sizeof(glm::vec4);
+	// fewest keys sorted, one merge dispatch of them
+	const uint32_t MIN_SORT_SIZE = 2 * PARTICLE_GROUP_SIZE;
+
+	const char* const BLEND_NAMES[ParticleSystem::BLEND_COUNT] =
+	{
+		"alpha",
+		"additive"
+	};
+
+	/***********************************************************
+	 *  GetSeconds()
+	 *
+	 *  This function is used for reading a monotonic clock in
+	 *  seconds.
+	 ***********************************************************/
+	double GetSeconds()
+	{
+		return(std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count());
+	}
+
+	/***********************************************************
+	 *  FindBlendMode()
+	 *
+	 *  This function is used for finding a blend mode by its
+	 *  name, -1 when there is none.
+	 ***********************************************************/
+	int FindBlendMode(const std::string& name)
+	{
+		for (int i = 0; i < ParticleSystem::BLEND_COUNT; i++)
+		{
+			if (name == BLEND_NAMES[i])
+			{
+				return(i);
+			}
+		}
+		return(-1);
+	}
+}
+
+const double ParticleSystem::MAX_STEP_SECONDS = 0.1;
+
+/***********************************************************
+ *  ParticleSystem()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+ParticleSystem::ParticleSystem(ShaderManager* pShaderManager)
+{
+	m_pShaderManager = pShaderManager;
+	m_simulateProgram = 0;
+	m_simulateStageLocation = -1;
+	m_simulatePoolLocation = -1;
+	m_simulateCapacityLocation = -1;
+	m_simulateCurrentLocation = -1;
+	m_simulateSpawnTotalLocation = -1;
+	m_simulateEmitterCountLocation = -1;
+	m_simulateSeedLocation = -1;
+	m_simulateStepLocation = -1;
+	m_simulateTimeLocation = -1;
+	m_sortProgram = 0;
+	m_sortStageLocation = -1;
+	m_sortCapacityLocation = -1;
+	m_sortCurrentLocation = -1;
+	m_sortSizeLocation = -1;
+	m_sortBlockLocation = -1;
+	m_sortStrideLocation = -1;
+	m_drawProgram = 0;
+	m_drawCapacityLocation = -1;
+	m_drawCurrentLocation = -1;
+	m_drawSortedLocation = -1;
+	m_vao = 0;
+	m_capacities[BLEND_ALPHA] = DEFAULT_ALPHA_CAPACITY;
+	m_capacities[BLEND_ADDITIVE] = DEFAULT_ADDITIVE_CAPACITY;
+	for (int i = 0; i < BLEND_COUNT; i++)
+	{
+		m_pools[i].capacity = 0;
+		m_pools[i].bUsed = false;
+		m_pools[i].current = 0;
+		m_pools[i].sortSize = 0;
+		m_pools[i].spawnTotal = 0;
+	}
+	m_lastTime = -1.0;
+	m_frame = 0;
+	memset(&m_stats, 0, sizeof(m_stats));
+}
+
+/***********************************************************
+ *  ~ParticleSystem()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+ParticleSystem::~ParticleSystem()
+{
+	if (0 != m_simulateProgram)
+	{
+		glDeleteProgram(m_simulateProgram);
+		m_simulateProgram = 0;
+	}
+	if (0 != m_sortProgram)
+	{
+		glDeleteProgram(m_sortProgram);
+		m_sortProgram = 0;
+	}
+	if (0 != m_drawProgram)
+	{
+		glDeleteProgram(m_drawProgram);
+		m_drawProgram = 0;
+	}
+	if (0 != m_vao)
+	{
+		glDeleteVertexArrays(1, &m_vao);
+		m_vao = 0;
+	}
+	m_pShaderManager = NULL;
+}
+
+/***********************************************************
+ *  Load()
+ *
+ *  This method is used for reading the emitters of a
+ *  particle file. A property line sets the emitter line
+ *  above it; the capacity lines can be anywhere.
+ ***********************************************************/
+bool ParticleSystem::Load(const char* filename)
+{
+	std::ifstream file(filename);
+	if (!file)
+	{
+		LOG_ERROR("Could not open particle file %s", filename);
+		return(false);
+	}
+
+	m_emitters.clear();
+
+	std::string text;
+	int lineNumber = 0;
+	while (std::getline(file, text))
+	{
+		lineNumber++;
+		size_t comment = text.find('#');
+		if (comment != std::string::npos)
+		{
+			text.erase(comment);
+		}
+
+		std::istringstream line(text);
+		std::string keyword;
+		if (!(line >> keyword))
+		{
+			continue;
+		}
+
+		bool bValid = true;
+		std::string error;
+		EMITTER* pEmitter = (m_emitters.empty() == false) ? &m_emitters.back() : NULL;
+		if (keyword == "emitter")
+		{
+			EMITTER emitter;
+			std::string node;
+			std::string blend;
+			bValid = (bool)(line >> emitter.name >> node >> blend);
+			emitter.tag = (node == "world") ? "" : node;
+			emitter.nodeID = -1;
+			emitter.blendMode = FindBlendMode(blend);
+			emitter.offset = glm::vec3(0.0f);
+			emitter.box = glm::vec3(0.0f);
+			emitter.rate = 0.0f;
+			emitter.life = 2.0f;
+			emitter.lifeJitter = 0.0f;
+			emitter.velocity = glm::vec3(0.0f);
+			emitter.spread = glm::vec3(0.0f);
+			emitter.acceleration = glm::vec3(0.0f);
+			emitter.drag = 0.0f;
+			emitter.turbulence = 0.0f;
+			emitter.startSize = 0.05f;
+			emitter.endSize = 0.05f;
+			emitter.startColor = glm::vec4(1.0f);
+			emitter.endColor = glm::vec4(1.0f, 1.0f, 1.0f, 0.0f);
+			emitter.spawnCarry = 0.0;
+			if ((bValid == true) && (emitter.blendMode < 0))
+			{
+				error = "unknown blend " + blend;
+				bValid = false;
+			}
+			if ((bValid == true) && (m_emitters.size() >= (size_t)MAX_EMITTERS))
+			{
+				error = "more than " + std::to_string(MAX_EMITTERS) + " emitters";
+				bValid = false;
+			}
+			if (bValid == true)
+			{
+				m_emitters.push_back(emitter);
+			}
+		}
+		else if (keyword == "capacity")
+		{
+			std::string blend;
+			int capacity = 0;
+			bValid = (line >> blend >> capacity) && (capacity > 0);
+			int blendMode = FindBlendMode(blend);
+			if ((bValid == true) && (blendMode < 0))
+			{
+				error = "unknown blend " + blend;
+				bValid = false;
+			}
+			if ((bValid == true) && (blendMode == BLEND_ALPHA) && ((uint32_t)capacity > MAX_SORTED_CAPACITY))
+			{
+				error = "sorted capacity above " + std::to_string(MAX_SORTED_CAPACITY);
+				bValid = false;
+			}
+			if (bValid == true)
+			{
+				m_capacities[blendMode] = (uint32_t)capacity;
+			}
+		}
+		else if (NULL == pEmitter)
+		{
+			error = keyword + " line before any emitter line";
+			bValid = false;
+		}
+		else if (keyword == "offset")
+		{
+			bValid = (bool)(line >> pEmitter->offset.x >> pEmitter->offset.y >> pEmitter->offset.z);
+		}
+		else if (keyword == "box")
+		{
+			bValid = (bool)(line >> pEmitter->box.x >> pEmitter->box.y >> pEmitter->box.z);
+		}
+		else if (keyword == "rate")
+		{
+			bValid = (line >> pEmitter->rate) && (pEmitter->rate >= 0.0f);
+		}
+		else if (keyword == "life")
+		{
+			bValid = (line >> pEmitter->life) && (pEmitter->life > 0.0f);
+			line >> pEmitter->lifeJitter;
+		}
+		else if (keyword == "velocity")
+		{
+			bValid = (bool)(line >> pEmitter->velocity.x >> pEmitter->velocity.y >> pEmitter->velocity.z);
+			line >> pEmitter->spread.x >> pEmitter->spread.y >> pEmitter->spread.z;
+		}
+		else if (keyword == "acceleration")
+		{
+			bValid = (bool)(line >> pEmitter->acceleration.x >> pEmitter->acceleration.y >> pEmitter->acceleration.z);
+			line >> pEmitter->drag;
+		}
+		else if (keyword == "turbulence")
+		{
+			bValid = (bool)(line >> pEmitter->turbulence);
+		}
+		else if (keyword == "size")
+		{
+			bValid = (line >> pEmitter->startSize) && (pEmitter->startSize > 0.0f);
+			pEmitter->endSize = pEmitter->startSize;
+			line >> pEmitter->endSize;
+		}
+		else if (keyword == "color")
+		{
+			glm::vec4& start = pEmitter->startColor;
+			glm::vec4& end = pEmitter->endColor;
+			bValid = (bool)(line >> start.r >> start.g >> start.b >> start.a);
+			end = glm::vec4(glm::vec3(start), 0.0f);
+			line >> end.r >> end.g >> end.b >> end.a;
+		}
+		else
+		{
+			error = "unknown line " + keyword;
+			bValid = false;
+		}
+
+		if (bValid == false)
+		{
+			LOG_ERROR("%s(%d): %s", filename, lineNumber,
+				(error.empty() ? ("malformed " + keyword + " line") : error).c_str());
+			m_emitters.clear();
+			return(false);
+		}
+	}
+
+	m_stats.emitters = m_emitters.size();
+	return(true);
+}
+
+/***********************************************************
+ *  Create()
+ *
+ *  This method is used for building the programs and the
+ *  pools of the blend modes the emitters use. The compute
+ *  stages need OpenGL 4.3, and the quads read the particles
+ *  from storage buffers in the vertex shader, which a
+ *  driver need not allow.
+ ***********************************************************/
+bool ParticleSystem::Create(
+	const char* simulateShaderPath,
+	const char* sortShaderPath,
+	const char* vertexShaderPath,
+	const char* fragmentShaderPath)
+{
+	if ((NULL == m_pShaderManager) || (IsLoaded() == false) || (GLEW_VERSION_4_3 != GL_TRUE))
+	{
+		return(false);
+	}
+	GLint vertexStorageBlocks = 0;
+	glGetIntegerv(GL_MAX_VERTEX_SHADER_STORAGE_BLOCKS, &vertexStorageBlocks);
+	if (vertexStorageBlocks < (GLint)SORT_KEYS_BINDING + 1)
+	{
+		LOG_WARNING("Particles disabled, the vertex shader cannot read storage buffers");
+		return(false);
+	}
+
+	m_simulateProgram = m_pShaderManager->LoadComputeShader(simulateShaderPath);
+	m_sortProgram = m_pShaderManager->LoadComputeShader(sortShaderPath);
+	m_drawProgram = m_pShaderManager->LoadExternalProgram(vertexShaderPath, fragmentShaderPath);
+	if ((0 == m_simulateProgram) || (0 == m_sortProgram) || (0 == m_drawProgram))
+	{
+		LOG_ERROR("Particles disabled, their shaders did not build");
+		GLuint* pPrograms[] = { &m_simulateProgram, &m_sortProgram, &m_drawProgram };
+		for (size_t i = 0; i < sizeof(pPrograms) / sizeof(pPrograms[0]); i++)
+		{
+			if (0 != *pPrograms[i])
+			{
+				glDeleteProgram(*pPrograms[i]);
+				*pPrograms[i] = 0;
+			}
+		}
+		return(false);
+	}
+
+	m_simulateStageLocation = glGetUniformLocation(m_simulateProgram, "stage");
+	m_simulatePoolLocation = glGetUniformLocation(m_simulateProgram, "pool");
+	m_simulateCapacityLocation = glGetUniformLocation(m_simulateProgram, "capacity");
+	m_simulateCurrentLocation = glGetUniformLocation(m_simulateProgram, "current");
+	m_simulateSpawnTotalLocation = glGetUniformLocation(m_simulateProgram, "spawnTotal");
+	m_simulateEmitterCountLocation = glGetUniformLocation(m_simulateProgram, "emitterCount");
+	m_simulateSeedLocation = glGetUniformLocation(m_simulateProgram, "seed");
+	m_simulateStepLocation = glGetUniformLocation(m_simulateProgram, "step");
+	m_simulateTimeLocation = glGetUniformLocation(m_simulateProgram, "time");
+	m_sortStageLocation = glGetUniformLocation(m_sortProgram, "stage");
+	m_sortCapacityLocation = glGetUniformLocation(m_sortProgram, "capacity");
+	m_sortCurrentLocation = glGetUniformLocation(m_sortProgram, "current");
+	m_sortSizeLocation = glGetUniformLocation(m_sortProgram, "sortSize");
+	m_sortBlockLocation = glGetUniformLocation(m_sortProgram, "block");
+	m_sortStrideLocation = glGetUniformLocation(m_sortProgram, "stride");
+	m_drawCapacityLocation = glGetUniformLocation(m_drawProgram, "capacity");
+	m_drawCurrentLocation = glGetUniformLocation(m_drawProgram, "current");
+	m_drawSortedLocation = glGetUniformLocation(m_drawProgram, "sorted");
+
+	// the pools of the blend modes in use, and every emitter, which
+	// the particles name by their index
+	bool bCreated = true;
+	for (size_t i = 0; i < m_emitters.size(); i++)
+	{
+		m_pools[m_emitters[i].blendMode].bUsed = true;
+	}
+	for (int i = 0; (i < BLEND_COUNT) && (bCreated == true); i++)
+	{
+		if (m_pools[i].bUsed == true)
+		{
+			bCreated = CreatePool(m_pools[i], m_capacities[i], (i == BLEND_ALPHA),
+				(i == BLEND_ALPHA) ? "alpha particles" : "additive particles");
+			m_stats.capacity += m_pools[i].capacity;
+		}
+	}
+	m_gpuEmitters.resize(m_emitters.size());
+	memset(&m_gpuEmitters[0], 0, m_gpuEmitters.size() * sizeof(GPU_EMITTER));
+	if ((bCreated == false) || (m_emitterBuffer.Create(GPUBuffer::USAGE_STREAM,
+		(GLsizeiptr)(m_gpuEmitters.size() * sizeof(GPU_EMITTER)), NULL,
+		GPUMemory::CATEGORY_BUFFER, "particle emitters") == false))
+	{
+		LOG_ERROR("Particles disabled, their buffers could not be created");
+		glDeleteProgram(m_drawProgram);
+		m_drawProgram = 0;
+		return(false);
+	}
+
+	glGenVertexArrays(1, &m_vao);
+	return(true);
+}
+
+/***********************************************************
+ *  CreatePool()
+ *
+ *  This method is used for allocating the buffers of a
+ *  pool. Every particle starts on the dead list, and both
+ *  alive lists start empty. A sorted pool sorts a power of
+ *  two of keys, the capacity rounded up.
+ ***********************************************************/
+bool ParticleSystem::CreatePool(PARTICLE_POOL& pool, uint32_t capacity, bool bSorted, const char* owner)
+{
+	pool.capacity = capacity;
+	pool.current = 0;
+	pool.sortSize = 0;
+
+	std::vector<GLuint> deadList(capacity);
+	for (uint32_t i = 0; i < capacity; i++)
+	{
+		deadList[i] = i;
+	}
+	GLuint counters[COUNTER_COUNT] = {};
+	counters[COUNTER_DRAW_0] = 4;
+	counters[COUNTER_DRAW_1] = 4;
+	counters[COUNTER_DISPATCH + 1] = 1;
+	counters[COUNTER_DISPATCH + 2] = 1;
+	counters[COUNTER_DEAD] = capacity;
+
+	std::string name = owner;
+	bool bCreated = (pool.particles.Create(GPUBuffer::USAGE_STATIC, (GLsizeiptr)capacity * PARTICLE_BYTES, NULL,
+		GPUMemory::CATEGORY_BUFFER, name.c_str()) == true) &&
+		(pool.deadList.Create(GPUBuffer::USAGE_STATIC, (GLsizeiptr)(capacity * sizeof(GLuint)), &deadList[0],
+		GPUMemory::CATEGORY_BUFFER, (name + " dead list").c_str()) == true) &&
+		(pool.aliveLists.Create(GPUBuffer::USAGE_STATIC, (GLsizeiptr)(2 * capacity * sizeof(GLuint)), NULL,
+		GPUMemory::CATEGORY_BUFFER, (name + " alive lists").c_str()) == true) &&
+		(pool.counters.Create(GPUBuffer::USAGE_STATIC, (GLsizeiptr)sizeof(counters), counters,
+		GPUMemory::CATEGORY_BUFFER, (name + " counters").c_str()) == true);
+	if ((bCreated == true) && (bSorted == true))
+	{
+		pool.sortSize = MIN_SORT_SIZE;
+		while (pool.sortSize < capacity)
+		{
+			pool.sortSize *= 2;
+		}
+		bCreated = pool.sortKeys.Create(GPUBuffer::USAGE_STATIC, (GLsizeiptr)(pool.sortSize * sizeof(glm::uvec2)),
+			NULL, GPUMemory::CATEGORY_BUFFER, (name + " sort keys").c_str());
+	}
+	return(bCreated);
+}
+
+/***********************************************************
+ *  Bind()
+ *
+ *  This method is used for finding the node each emitter
+ *  follows in a recorded scene. An emitter whose node is
+ *  not in the scene stays at its offset in the world.
+ ***********************************************************/
+void ParticleSystem::Bind(const SceneTransforms& transforms)
+{
+	for (size_t i = 0; i < m_emitters.size(); i++)
+	{
+		EMITTER& emitter = m_emitters[i];
+		emitter.nodeID = (emitter.tag.empty() == false) ? transforms.FindNode(emitter.tag) : -1;
+		if ((emitter.tag.empty() == false) && (emitter.nodeID < 0))
+		{
+			LOG_WARNING("Particle emitter %s found no node %s", emitter.name.c_str(), emitter.tag.c_str());
+		}
+	}
+}
+
+/***********************************************************
+ *  BindPool()
+ *
+ *  This method is used for binding the buffers of a pool,
+ *  and the emitters, to the storage bindings of the shaders.
+ ***********************************************************/
+void ParticleSystem::BindPool(const PARTICLE_POOL& pool) const
+{
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, EMITTERS_BINDING, m_emitterBuffer.GetName());
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, PARTICLES_BINDING, pool.particles.GetName());
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, DEAD_LIST_BINDING, pool.deadList.GetName());
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, ALIVE_LISTS_BINDING, pool.aliveLists.GetName());
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, COUNTERS_BINDING, pool.counters.GetName());
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SORT_KEYS_BINDING, pool.sortKeys.GetName());
+}
+
+/***********************************************************
+ *  Update()
+ *
+ *  This method is used for advancing the particles to a
+ *  time. The emitters owe the particles of their rate over
+ *  the step, the fractions carried to the next frame, and
+ *  each pool runs its passes: the spawns take particles off
+ *  the dead list, the prepare stage sizes the simulation
+ *  by the alive count and empties the other list, and the
+ *  simulation moves every alive particle into it or back to
+ *  the dead list. Nothing is read back; the counts stay on
+ *  the GPU for the dispatch and the draw.
+ ***********************************************************/
+void ParticleSystem::Update(double time, const SceneTransforms& transforms)
+{
+	if (IsAvailable() == false)
+	{
+		return;
+	}
+	if ((m_lastTime < 0.0) || (time < m_lastTime))
+	{
+		m_lastTime = time;
+		return;
+	}
+	if (time == m_lastTime)
+	{
+		return;
+	}
+	double start = GetSeconds();
+	float step = (float)std::min(time - m_lastTime, MAX_STEP_SECONDS);
+	m_lastTime = time;
+
+	// the spawns of each emitter follow those of the emitters of
+	// its pool before it, as many as the pool has room for
+	for (int i = 0; i < BLEND_COUNT; i++)
+	{
+		m_pools[i].spawnTotal = 0;
+	}
+	for (size_t i = 0; i < m_emitters.size(); i++)
+	{
+		EMITTER& emitter = m_emitters[i];
+		PARTICLE_POOL& pool = m_pools[emitter.blendMode];
+		emitter.spawnCarry += (double)emitter.rate * (double)step;
+		uint32_t spawnCount = (uint32_t)emitter.spawnCarry;
+		emitter.spawnCarry -= (double)spawnCount;
+		spawnCount = std::min(spawnCount, pool.capacity - pool.spawnTotal);
+
+		glm::vec4 center = glm::vec4(emitter.offset, 1.0f);
+		if ((emitter.nodeID >= 0) && (emitter.nodeID < transforms.GetNodeCount()))
+		{
+			center = transforms.GetNodeWorld(emitter.nodeID) * center;
+		}
+
+		GPU_EMITTER& gpuEmitter = m_gpuEmitters[i];
+		gpuEmitter.center = glm::vec4(glm::vec3(center), emitter.turbulence);
+		gpuEmitter.box = glm::vec4(emitter.box, emitter.life);
+		gpuEmitter.velocity = glm::vec4(emitter.velocity, emitter.lifeJitter);
+		gpuEmitter.spread = glm::vec4(emitter.spread, emitter.drag);
+		gpuEmitter.acceleration = glm::vec4(emitter.acceleration, emitter.startSize);
+		gpuEmitter.startColor = emitter.startColor;
+		gpuEmitter.endColor = emitter.endColor;
+		gpuEmitter.firstSpawn = pool.spawnTotal;
+		gpuEmitter.spawnCount = spawnCount;
+		gpuEmitter.endSize = emitter.endSize;
+		gpuEmitter.blendMode = (uint32_t)emitter.blendMode;
+		pool.spawnTotal += spawnCount;
+		m_stats.spawned += spawnCount;
+	}
+	m_emitterBuffer.Update(0, (GLsizeiptr)(m_gpuEmitters.size() * sizeof(GPU_EMITTER)), &m_gpuEmitters[0]);
+
+	m_pShaderManager->UseExternalProgram(m_simulateProgram);
+	glUniform1ui(m_simulateEmitterCountLocation, (GLuint)m_gpuEmitters.size());
+	glUniform1ui(m_simulateSeedLocation, m_frame * 0x9E3779B9u);
+	glUniform1f(m_simulateStepLocation, step);
+	glUniform1f(m_simulateTimeLocation, (float)time);
+	for (int i = 0; i < BLEND_COUNT; i++)
+	{
+		PARTICLE_POOL& pool = m_pools[i];
+		if (pool.bUsed == false)
+		{
+			continue;
+		}
+		BindPool(pool);
+		glUniform1ui(m_simulatePoolLocation, (GLuint)i);
+		glUniform1ui(m_simulateCapacityLocation, pool.capacity);
+		glUniform1ui(m_simulateCurrentLocation, (GLuint)pool.current);
+		glUniform1ui(m_simulateSpawnTotalLocation, pool.spawnTotal);
+
+		if (pool.spawnTotal > 0)
+		{
+			glUniform1i(m_simulateStageLocation, STAGE_EMIT);
+			glDispatchCompute((pool.spawnTotal + PARTICLE_GROUP_SIZE - 1) / PARTICLE_GROUP_SIZE, 1, 1);
+			glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+			m_stats.dispatches++;
+		}
+
+		glUniform1i(m_simulateStageLocation, STAGE_PREPARE);
+		glDispatchCompute(1, 1, 1);
+		glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
+
+		glUniform1i(m_simulateStageLocation, STAGE_SIMULATE);
+		glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, pool.counters.GetName());
+		glDispatchComputeIndirect((GLintptr)(COUNTER_DISPATCH * sizeof(GLuint)));
+		glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, 0);
+		glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+		m_stats.dispatches += 2;
+
+		// the survivors were compacted into the other list
+		pool.current = 1 - pool.current;
+	}
+
+	if (m_pools[BLEND_ALPHA].bUsed == true)
+	{
+		SortPool(m_pools[BLEND_ALPHA]);
+	}
+	for (GLuint binding = EMITTERS_BINDING; binding <= SORT_KEYS_BINDING; binding++)
+	{
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, binding, 0);
+	}
+	// the draws read the lists and take their counts as commands
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
+
+	m_frame++;
+	m_stats.frames++;
+	double seconds = GetSeconds() - start;
+	m_stats.updateSeconds += seconds;
+	m_stats.updateMaxSeconds = std::max(m_stats.updateMaxSeconds, seconds);
+}
+
+/***********************************************************
+ *  SortPool()
+ *
+ *  This method is used for sorting the alive list of a pool
+ *  back to front with a bitonic sort: the key stage writes
+ *  the distance and index of every alive particle, and the
+ *  slots past the count keys that sort last, then each
+ *  merge step compares the pairs a stride apart within
+ *  blocks that double until they span all of the keys. The
+ *  steps are fixed by the capacity, since the count is only
+ *  known on the GPU.
+ ***********************************************************/
+void ParticleSystem::SortPool(PARTICLE_POOL& pool)
+{
+	m_pShaderManager->UseExternalProgram(m_sortProgram);
+	BindPool(pool);
+	glUniform1ui(m_sortCapacityLocation, pool.capacity);
+	glUniform1ui(m_sortCurrentLocation, (GLuint)pool.current);
+	glUniform1ui(m_sortSizeLocation, pool.sortSize);
+
+	glUniform1i(m_sortStageLocation, STAGE_SORT_KEYS);
+	glDispatchCompute(pool.sortSize / PARTICLE_GROUP_SIZE, 1, 1);
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+	m_stats.dispatches++;
+
+	glUniform1i(m_sortStageLocation, STAGE_SORT_MERGE);
+	for (uint32_t block = 2; block <= pool.sortSize; block *= 2)
+	{
+		glUniform1ui(m_sortBlockLocation, block);
+		for (uint32_t stride = block / 2; stride > 0; stride /= 2)
+		{
+			glUniform1ui(m_sortStrideLocation, stride);
+			glDispatchCompute(pool.sortSize / 2 / PARTICLE_GROUP_SIZE, 1, 1);
+			glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+			m_stats.dispatches++;
+			m_stats.sortPasses++;
+		}
+	}
+}
+
+/***********************************************************
+ *  Draw()
+ *
+ *  This method is used for drawing the alive particles of
+ *  each pool as camera facing quads, in one instanced draw
+ *  whose instance count is the count the simulation left
+ *  in the counters. The additive pool goes first, since it
+ *  looks the same under the blended particles or over them.
+ ***********************************************************/
+void ParticleSystem::Draw()
+{
+	if ((IsAvailable() == false) || (m_stats.frames == 0))
+	{
+		return;
+	}
+
+	m_pShaderManager->UseExternalProgram(m_drawProgram);
+	ShapeMeshes::BindVertexArray(m_vao);
+	glEnable(GL_BLEND);
+	glDepthMask(GL_FALSE);
+
+	const int drawOrder[BLEND_COUNT] = { BLEND_ADDITIVE, BLEND_ALPHA };
+	for (int i = 0; i < BLEND_COUNT; i++)
+	{
+		const PARTICLE_POOL& pool = m_pools[drawOrder[i]];
+		if (pool.bUsed == false)
+		{
+			continue;
+		}
+		if (drawOrder[i] == BLEND_ADDITIVE)
+		{
+			glBlendFunc(GL_SRC_ALPHA, GL_ONE);
+		}
+		else
+		{
+			glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+		}
+
+		BindPool(pool);
+		glUniform1ui(m_drawCapacityLocation, pool.capacity);
+		glUniform1ui(m_drawCurrentLocation, (GLuint)pool.current);
+		glUniform1i(m_drawSortedLocation, (pool.sortSize > 0) ? 1 : 0);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, pool.counters.GetName());
+		glDrawArraysIndirect(GL_TRIANGLE_STRIP,
+			(const void*)(size_t)(((pool.current == 0) ? COUNTER_DRAW_0 : COUNTER_DRAW_1) * sizeof(GLuint)));
+		m_stats.draws++;
+	}
+
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+	for (GLuint binding = EMITTERS_BINDING; binding <= SORT_KEYS_BINDING; binding++)
+	{
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, binding, 0);
+	}
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	glDepthMask(GL_TRUE);
+}
+
+/***********************************************************
+ *  PrintStats()
+ *
+ *  This method is used for printing the emitters, the pools
+ *  and the cost of the updates for the exit report.
+ ***********************************************************/
+void ParticleSystem::PrintStats() const
+{
+	std::cout << "particle emitters " << m_stats.emitters
+		<< "\tcapacity " << m_stats.capacity
+		<< "\tspawned " << m_stats.spawned << "\n";
+	if (m_stats.frames > 0)
+	{
+		std::cout << "particle frames " << m_stats.frames
+			<< "\tdispatches " << m_stats.dispatches
+			<< "\tsort steps " << m_stats.sortPasses
+			<< "\tdraws " << m_stats.draws
+			<< "\tavg CPU ms " << m_stats.updateSeconds * 1000.0 / (double)m_stats.frames
+			<< "\tmax CPU ms " << m_stats.updateMaxSeconds * 1000.0 << "\n";
+	}
+}
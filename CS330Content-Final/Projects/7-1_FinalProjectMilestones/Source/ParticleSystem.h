@@ -0,0 +1,235 @@
+///////////////////////////////////////////////////////////////////////////////
+// particlesystem.h
+// ============
+// ambient particles emitted, simulated, sorted and drawn on the GPU
+//
+//  Steam over a cup or dust in a beam of light is many thousands of
+//  small quads, far too many to draw one at a time. The particles
+//  live in storage buffers instead and never come back to the CPU:
+//  each frame a compute pass takes free particles from a dead list
+//  for the ones the emitters spawn, another advances every alive
+//  particle and compacts the survivors into the other of two alive
+//  lists, returning the dead ones, and one instanced draw takes its
+//  instance count from that list's counter through an indirect
+//  command. Additive particles look the same in any order and are
+//  drawn as they are; alpha blended ones are sorted back to front
+//  with a bitonic sort first, so only they pay for it. The CPU only
+//  writes the few emitters and issues the passes.
+//
+//  The emitter lines are
+//    emitter <name> <node|world> <alpha|additive>
+//    offset <x> <y> <z>
+//    box <x> <y> <z>
+//    rate <particles per second>
+//    life <seconds> [<jitter>]
+//    velocity <x> <y> <z> [<random x> <y> <z>]
+//    acceleration <x> <y> <z> [<drag>]
+//    turbulence <strength>
+//    size <start> [<end>]
+//    color <r> <g> <b> <a> [<r> <g> <b> <a>]
+//    capacity <alpha|additive> <particles>
+//  with the property lines setting the emitter above them. The offset
+//  is in the space of the node, the box half sizes and the motion in
+//  world units, and the colors and sizes go from the start to the end
+//  over the life of a particle.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "GPUBuffer.h"
+#include "SceneTransforms.h"
+#include "ShaderManager.h"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/***********************************************************
+ *  ParticleSystem
+ *
+ *  This class contains the emitters of a particle file, the
+ *  compute and draw programs, and the buffers of the pool of
+ *  each blend mode. Bind() places the emitters on the nodes
+ *  of a recorded scene; every frame Update() emits, moves
+ *  and sorts the particles, and Draw() draws them.
+ ***********************************************************/
+class ParticleSystem
+{
+public:
+	// constructor
+	ParticleSystem(ShaderManager* pShaderManager);
+	// destructor
+	~ParticleSystem();
+
+	// how the particles of an emitter blend, each with a pool of
+	// its own
+	enum BLEND_MODE
+	{
+		BLEND_ALPHA = 0,	// sorted back to front
+		BLEND_ADDITIVE,		// drawn in any order
+		BLEND_COUNT
+	};
+
+	// emitters a file can have
+	static const int MAX_EMITTERS = 64;
+	// particles of a pool unless the file sets them, and the most of
+	// a sorted pool, whose sort grows with the square of the log
+	static const uint32_t DEFAULT_ALPHA_CAPACITY = 16384;
+	static const uint32_t DEFAULT_ADDITIVE_CAPACITY = 262144;
+	static const uint32_t MAX_SORTED_CAPACITY = 65536;
+	// longest step the particles are moved by, so a hitch does not
+	// throw them across the scene
+	static const double MAX_STEP_SECONDS;
+
+	// frames simulated since the start
+	struct PARTICLE_STATS
+	{
+		unsigned long long emitters;		// of the file
+		unsigned long long capacity;		// particles of the pools
+		unsigned long long frames;			// frames simulated
+		unsigned long long spawned;			// particles asked of the dead lists
+		unsigned long long dispatches;		// compute passes
+		unsigned long long sortPasses;		// of those, sort steps
+		unsigned long long draws;			// indirect draws
+		// spent issuing the passes of a frame
+		double updateSeconds;
+		double updateMaxSeconds;
+	};
+
+	// read a particle file; false when it cannot be read or has a
+	// malformed line
+	bool Load(const char* filename);
+	bool IsLoaded() const { return(m_emitters.empty() == false); }
+	// build the programs and the pools; false when the context has
+	// no compute shaders or a program fails to build
+	bool Create(
+		const char* simulateShaderPath,
+		const char* sortShaderPath,
+		const char* vertexShaderPath,
+		const char* fragmentShaderPath);
+	bool IsAvailable() const { return(0 != m_drawProgram); }
+
+	// find the nodes of the emitters in a recorded scene
+	void Bind(const SceneTransforms& transforms);
+	// emit, move and sort the particles for time, the sort along the
+	// view of the bound FrameData block; nothing for a time not
+	// past the last one
+	void Update(double time, const SceneTransforms& transforms);
+	// draw the particles over the bound framebuffer, depth tested
+	// against the scene without writing it
+	void Draw();
+
+	const PARTICLE_STATS& GetStats() const { return(m_stats); }
+	void PrintStats() const;
+
+private:
+	struct EMITTER
+	{
+		std::string name;
+		std::string tag;		// empty for the world
+		int nodeID;
+		int blendMode;			// BLEND_MODE
+		glm::vec3 offset;
+		glm::vec3 box;
+		float rate;
+		float life;
+		float lifeJitter;
+		glm::vec3 velocity;
+		glm::vec3 spread;
+		glm::vec3 acceleration;
+		float drag;
+		float turbulence;
+		float startSize;
+		float endSize;
+		glm::vec4 startColor;
+		glm::vec4 endColor;
+		// spawns owed from the frames before, below one particle
+		double spawnCarry;
+	};
+
+	// an emitter as the shaders read it, rewritten every frame
+	struct GPU_EMITTER
+	{
+		glm::vec4 center;		// world spawn center, w = turbulence
+		glm::vec4 box;			// spawn box half size, w = life
+		glm::vec4 velocity;		// w = life jitter
+		glm::vec4 spread;		// w = drag
+		glm::vec4 acceleration;	// w = start size
+		glm::vec4 startColor;
+		glm::vec4 endColor;
+		uint32_t firstSpawn;	// of the spawns of its pool this frame
+		uint32_t spawnCount;
+		float endSize;
+		uint32_t blendMode;
+	};
+
+	// the particles of one blend mode: the particles, the dead list
+	// and its count, the two alive lists and the draw command of
+	// each, whose instance count is the list's count
+	struct PARTICLE_POOL
+	{
+		uint32_t capacity;
+		bool bUsed;
+		// alive list the next draw reads, 0 or 1
+		int current;
+		GPUBuffer particles;
+		GPUBuffer deadList;
+		GPUBuffer aliveLists;
+		GPUBuffer counters;
+		// keys and indexes of a sorted pool, a power of two of them
+		uint32_t sortSize;
+		GPUBuffer sortKeys;
+		// spawns of the frame being updated
+		uint32_t spawnTotal;
+	};
+
+	// pointer to shader manager object
+	ShaderManager* m_pShaderManager;
+	// emit, prepare and simulate stages, and their uniforms
+	GLuint m_simulateProgram;
+	GLint m_simulateStageLocation;
+	GLint m_simulatePoolLocation;
+	GLint m_simulateCapacityLocation;
+	GLint m_simulateCurrentLocation;
+	GLint m_simulateSpawnTotalLocation;
+	GLint m_simulateEmitterCountLocation;
+	GLint m_simulateSeedLocation;
+	GLint m_simulateStepLocation;
+	GLint m_simulateTimeLocation;
+	// key and merge stages of the sort, and their uniforms
+	GLuint m_sortProgram;
+	GLint m_sortStageLocation;
+	GLint m_sortCapacityLocation;
+	GLint m_sortCurrentLocation;
+	GLint m_sortSizeLocation;
+	GLint m_sortBlockLocation;
+	GLint m_sortStrideLocation;
+	// camera facing quads, and the vertex array they need without
+	// any buffers
+	GLuint m_drawProgram;
+	GLint m_drawCapacityLocation;
+	GLint m_drawCurrentLocation;
+	GLint m_drawSortedLocation;
+	GLuint m_vao;
+
+	std::vector<EMITTER> m_emitters;
+	std::vector<GPU_EMITTER> m_gpuEmitters;
+	GPUBuffer m_emitterBuffer;
+	uint32_t m_capacities[BLEND_COUNT];
+	PARTICLE_POOL m_pools[BLEND_COUNT];
+	// time of the last update, negative before the first
+	double m_lastTime;
+	uint32_t m_frame;
+
+	PARTICLE_STATS m_stats;
+
+	// allocate the buffers of a pool, every particle dead
+	bool CreatePool(PARTICLE_POOL& pool, uint32_t capacity, bool bSorted, const char* owner);
+	// bind the buffers of a pool to the storage bindings the
+	// shaders read them from
+	void BindPool(const PARTICLE_POOL& pool) const;
+	// sort the alive list of a pool back to front
+	void SortPool(PARTICLE_POOL& pool);
+};
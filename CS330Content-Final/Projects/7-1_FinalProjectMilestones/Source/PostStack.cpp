@@ -0,0 +1,1156 @@
+///////////////////////////////////////////////////////////////////////////////
+// poststack.cpp
+// ============
+// post effects of the frame as passes of the render graph
+//
+//  The lit frame is copied into half float targets and filtered by
+//  temporal anti-aliasing, screen space ambient occlusion, bloom, tone
+//  mapping and FXAA, each at a quality tier of its own. Ambient occlusion and the bloom blur
+//  run at a half or quarter of the frame size, the occlusion brought
+//  back up with a depth aware filter. The occlusion of a pixel is
+//  kept over the frames it stays on the same surface, a share of the
+//  pixels recomputed each frame along with the ones newly uncovered.
+//  Every effect is timed on the
+//  GPU, and one over its time budget drops a tier, climbing back once
+//  it has room again, so a slow machine keeps every effect at a lower
+//  quality instead of losing them.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "PostStack.h"
+#include "ShapeMeshes.h"
+#include "GLDebug.h"
+#include "GLTrace.h"
+#include "GPUMemory.h"
+
+#include <cstdlib>
+#include <iostream>
+#include <cstring>
+#include <string>
+
+const float PostStack::TIME_SMOOTHING = 0.1f;
+const float PostStack::RAISE_FRACTION = 0.6f;
+
+namespace
+{
+	const char* const EFFECT_NAMES[PostStack::EFFECT_COUNT] =
+	{
+		"taa",
+		"ssao",
+		"bloom",
+		"tonemap",
+		"fxaa"
+	};
+
+	const char* const ANTI_ALIASING_NAMES[PostStack::AA_COUNT] =
+	{
+		"none",
+		"msaa2x",
+		"msaa4x",
+		"msaa8x",
+		"fxaa",
+		"taa"
+	};
+
+	// settings of each tier, TIER_OFF first
+	// neighborhood the history is clamped to, 1 the cross of the
+	// pixel, 2 its 3x3 box and 3 the box narrowed by the variance
+	const int TAA_CLAMP_MODES[4] = { 0, 1, 2, 3 };
+	// weight of the new frame against the history
+	const float TAA_BLEND_FACTORS[4] = { 0.0f, 0.15f, 0.1f, 0.1f };
+	// fraction of the frame size the occlusion is computed at
+	const int SSAO_DIVISORS[4] = { 1, 4, 2, 2 };
+	// hemisphere samples per pixel
+	const int SSAO_SAMPLES[4] = { 0, 6, 10, 16 };
+	// texels the depth aware blur reaches to each side
+	const int SSAO_BLUR_RADII[4] = { 0, 1, 2, 2 };
+	// fraction of the frame size the bloom is blurred at
+	const int BLOOM_DIVISORS[4] = { 1, 4, 2, 2 };
+	// horizontal and vertical blur rounds
+	const int BLOOM_ITERATIONS[4] = { 0, 1, 1, 2 };
+	// bilinear taps of a blur, each covering two texels
+	const int BLOOM_TAPS[4] = { 0, 3, 5, 5 };
+	// curve of the tone mapping, 1 Reinhard and 2 filmic
+	const int TONE_MAPPERS[4] = { 0, 1, 2, 2 };
+	// steps FXAA searches along an edge for its end
+	const int FXAA_SEARCH_STEPS[4] = { 0, 2, 4, 8 };
+
+	// world distance the occlusion looks for occluders within
+	const float SSAO_RADIUS = 0.5f;
+	// frames a pixel keeps its cached occlusion for, each frame
+	// recomputing one block in this many, and the occlusion texels it
+	// may move between frames and still reuse it
+	const int SSAO_CACHE_FRAMES = 4;
+	const float SSAO_CACHE_MAX_MOTION = 2.0f;
+	// color above which a pixel glows, and how much of the glow is
+	// added back
+	const float BLOOM_THRESHOLD = 1.0f;
+	const float BLOOM_STRENGTH = 0.1f;
+
+	/***********************************************************
+	 *  Halton()
+	 *
+	 *  This function is used for getting an element of the
+	 *  Halton sequence of a base, evenly spread over 0 to 1.
+	 ***********************************************************/
+	float Halton(unsigned int index, unsigned int base)
+	{
+		float result = 0.0f;
+		float fraction = 1.0f / (float)base;
+		while (index > 0)
+		{
+			result += fraction * (float)(index % base);
+			index /= base;
+			fraction /= (float)base;
+		}
+		return(result);
+	}
+}
+
+/***********************************************************
+ *  PostStack()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+PostStack::PostStack(ShaderManager* pShaderManager)
+{
+	m_pShaderManager = pShaderManager;
+	m_pGPUProfiler = NULL;
+	m_ssaoProgram = 0;
+	m_ssaoBlurProgram = 0;
+	m_bloomProgram = 0;
+	m_compositeProgram = 0;
+	m_fxaaProgram = 0;
+	m_taaProgram = 0;
+	m_vertexArray = 0;
+	m_linearSampler = 0;
+	m_querySet = 0;
+	m_tierCap = TIER_HIGH;
+	m_exposure = 1.0f;
+	m_colorFormat = GL_RGBA16F;
+	m_inverseProjection = glm::mat4(1.0f);
+	m_antiAliasing = AA_NONE;
+	m_historyTexture = 0;
+	m_historyWidth = 0;
+	m_historyHeight = 0;
+	m_historyFormat = GL_NONE;
+	m_bHistoryValid = false;
+	m_previousViewProjection = glm::mat4(1.0f);
+	m_frameIndex = 0;
+	m_bTemporalCaching = true;
+	m_occlusionHistoryTexture = 0;
+	m_occlusionHistoryWidth = 0;
+	m_occlusionHistoryHeight = 0;
+	m_bOcclusionHistoryValid = false;
+	m_previousOcclusionView = glm::mat4(1.0f);
+	m_previousOcclusionViewProjection = glm::mat4(1.0f);
+	for (int effect = 0; effect < EFFECT_COUNT; effect++)
+	{
+		EFFECT_STATE& state = m_effects[effect];
+		state.requestedTier = TIER_OFF;
+		state.tier = TIER_OFF;
+		state.budgetMilliseconds = 0.0f;
+		state.gpuMilliseconds = 0.0f;
+		state.framesSinceChange = 0;
+		for (int set = 0; set < QUERY_SETS; set++)
+		{
+			state.queries[set][0] = 0;
+			state.queries[set][1] = 0;
+			state.bPending[set] = false;
+		}
+		state.bTiming = false;
+	}
+	// the anti-aliasing effects run at their best while their mode
+	// is picked, unless asked otherwise
+	m_effects[EFFECT_TAA].requestedTier = TIER_HIGH;
+	m_effects[EFFECT_TAA].tier = TIER_HIGH;
+	m_effects[EFFECT_FXAA].requestedTier = TIER_HIGH;
+	m_effects[EFFECT_FXAA].tier = TIER_HIGH;
+}
+
+/***********************************************************
+ *  ~PostStack()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+PostStack::~PostStack()
+{
+	GLuint* programs[6] = { &m_ssaoProgram, &m_ssaoBlurProgram, &m_bloomProgram, &m_compositeProgram, &m_fxaaProgram, &m_taaProgram };
+	for (int i = 0; i < 6; i++)
+	{
+		if (0 != *programs[i])
+		{
+			glDeleteProgram(*programs[i]);
+			*programs[i] = 0;
+		}
+	}
+	if (0 != m_vertexArray)
+	{
+		glDeleteVertexArrays(1, &m_vertexArray);
+		m_vertexArray = 0;
+	}
+	if (0 != m_linearSampler)
+	{
+		glDeleteSamplers(1, &m_linearSampler);
+		m_linearSampler = 0;
+	}
+	DestroyHistory();
+	DestroyOcclusionHistory();
+	for (int effect = 0; effect < EFFECT_COUNT; effect++)
+	{
+		if (0 != m_effects[effect].queries[0][0])
+		{
+			glDeleteQueries(QUERY_SETS * 2, &m_effects[effect].queries[0][0]);
+		}
+	}
+	m_pShaderManager = NULL;
+	m_pGPUProfiler = NULL;
+}
+
+/***********************************************************
+ *  Create()
+ *
+ *  This method is used for building the programs of the
+ *  effects, pointing their samplers at the post units, and
+ *  creating the timer queries. The composite program tone
+ *  maps and combines the others, so without it no effect
+ *  runs.
+ ***********************************************************/
+bool PostStack::Create(
+	const char* vertexPath,
+	const char* ssaoFragmentPath,
+	const char* ssaoBlurFragmentPath,
+	const char* bloomFragmentPath,
+	const char* compositeFragmentPath,
+	const char* fxaaFragmentPath,
+	const char* taaFragmentPath)
+{
+	if (NULL == m_pShaderManager)
+	{
+		return(false);
+	}
+
+	m_compositeProgram = m_pShaderManager->LoadExternalProgram(vertexPath, compositeFragmentPath);
+	if (0 == m_compositeProgram)
+	{
+		std::cout << "Post effects disabled, the composite shader did not build" << std::endl;
+		return(false);
+	}
+	m_ssaoProgram = m_pShaderManager->LoadExternalProgram(vertexPath, ssaoFragmentPath);
+	m_ssaoBlurProgram = m_pShaderManager->LoadExternalProgram(vertexPath, ssaoBlurFragmentPath);
+	m_bloomProgram = m_pShaderManager->LoadExternalProgram(vertexPath, bloomFragmentPath);
+	m_fxaaProgram = m_pShaderManager->LoadExternalProgram(vertexPath, fxaaFragmentPath);
+	m_taaProgram = m_pShaderManager->LoadExternalProgram(vertexPath, taaFragmentPath);
+
+	const GLuint programs[6] = { m_ssaoProgram, m_ssaoBlurProgram, m_bloomProgram, m_compositeProgram, m_fxaaProgram, m_taaProgram };
+	for (int i = 0; i < 6; i++)
+	{
+		if (0 == programs[i])
+		{
+			continue;
+		}
+		m_pShaderManager->UseExternalProgram(programs[i]);
+		glUniform1i(glGetUniformLocation(programs[i], "colorTexture"), COLOR_TEXTURE_UNIT);
+		glUniform1i(glGetUniformLocation(programs[i], "depthTexture"), DEPTH_TEXTURE_UNIT);
+		glUniform1i(glGetUniformLocation(programs[i], "occlusionTexture"), OCCLUSION_TEXTURE_UNIT);
+		glUniform1i(glGetUniformLocation(programs[i], "bloomTexture"), BLOOM_TEXTURE_UNIT);
+		glUniform1i(glGetUniformLocation(programs[i], "historyTexture"), HISTORY_TEXTURE_UNIT);
+		glUniform1i(glGetUniformLocation(programs[i], "occlusionHistory"), OCCLUSION_HISTORY_TEXTURE_UNIT);
+	}
+
+	glGenVertexArrays(1, &m_vertexArray);
+
+	glGenSamplers(1, &m_linearSampler);
+	glSamplerParameteri(m_linearSampler, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glSamplerParameteri(m_linearSampler, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glSamplerParameteri(m_linearSampler, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glSamplerParameteri(m_linearSampler, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+	for (int effect = 0; effect < EFFECT_COUNT; effect++)
+	{
+		glGenQueries(QUERY_SETS * 2, &m_effects[effect].queries[0][0]);
+	}
+
+	return(true);
+}
+
+/***********************************************************
+ *  SetTier()
+ *
+ *  This method is used for asking for a quality tier of an
+ *  effect, which it starts at; the budget may lower it.
+ ***********************************************************/
+void PostStack::SetTier(int effect, int tier)
+{
+	if ((effect < 0) || (effect >= EFFECT_COUNT))
+	{
+		return;
+	}
+	EFFECT_STATE& state = m_effects[effect];
+	state.requestedTier = glm::clamp(tier, (int)TIER_OFF, (int)TIER_HIGH);
+	state.tier = GetCappedTier(effect);
+	state.gpuMilliseconds = 0.0f;
+	state.framesSinceChange = 0;
+}
+
+/***********************************************************
+ *  GetRequestedTier()
+ *
+ *  This method is used for getting the tier asked for an
+ *  effect.
+ ***********************************************************/
+int PostStack::GetRequestedTier(int effect) const
+{
+	if ((effect < 0) || (effect >= EFFECT_COUNT))
+	{
+		return(TIER_OFF);
+	}
+	return(m_effects[effect].requestedTier);
+}
+
+/***********************************************************
+ *  GetTier()
+ *
+ *  This method is used for getting the tier an effect runs
+ *  at, after its budget.
+ ***********************************************************/
+int PostStack::GetTier(int effect) const
+{
+	if ((effect < 0) || (effect >= EFFECT_COUNT))
+	{
+		return(TIER_OFF);
+	}
+	return(m_effects[effect].tier);
+}
+
+/***********************************************************
+ *  SetTierCap()
+ *
+ *  This method is used for capping the tier of every effect.
+ *  Effects without a budget move to the capped tier at once;
+ *  those with one drop to it at once and climb back up to
+ *  it by their budget.
+ ***********************************************************/
+void PostStack::SetTierCap(int tier)
+{
+	tier = glm::clamp(tier, (int)TIER_LOW, (int)TIER_HIGH);
+	if (tier == m_tierCap)
+	{
+		return;
+	}
+	m_tierCap = tier;
+	for (int effect = 0; effect < EFFECT_COUNT; effect++)
+	{
+		EFFECT_STATE& state = m_effects[effect];
+		int cappedTier = GetCappedTier(effect);
+		if ((state.budgetMilliseconds <= 0.0f) || (state.tier > cappedTier))
+		{
+			state.tier = cappedTier;
+			state.gpuMilliseconds = 0.0f;
+			state.framesSinceChange = 0;
+		}
+	}
+}
+
+/***********************************************************
+ *  GetCappedTier()
+ *
+ *  This method is used for getting the tier asked for an
+ *  effect, held under the tier cap unless it is off.
+ ***********************************************************/
+int PostStack::GetCappedTier(int effect) const
+{
+	const int requestedTier = m_effects[effect].requestedTier;
+	if (requestedTier == TIER_OFF)
+	{
+		return(TIER_OFF);
+	}
+	return(glm::min(requestedTier, m_tierCap));
+}
+
+/***********************************************************
+ *  SetBudget()
+ *
+ *  This method is used for setting the GPU time an effect
+ *  may take a frame before it drops a tier.
+ ***********************************************************/
+void PostStack::SetBudget(int effect, float milliseconds)
+{
+	if ((effect < 0) || (effect >= EFFECT_COUNT))
+	{
+		return;
+	}
+	m_effects[effect].budgetMilliseconds = glm::max(milliseconds, 0.0f);
+	m_effects[effect].framesSinceChange = 0;
+}
+
+/***********************************************************
+ *  GetBudget()
+ *
+ *  This method is used for getting the GPU time budget of an
+ *  effect, 0 for none.
+ ***********************************************************/
+float PostStack::GetBudget(int effect) const
+{
+	if ((effect < 0) || (effect >= EFFECT_COUNT))
+	{
+		return(0.0f);
+	}
+	return(m_effects[effect].budgetMilliseconds);
+}
+
+/***********************************************************
+ *  GetMilliseconds()
+ *
+ *  This method is used for getting the smoothed GPU time of
+ *  an effect at its current tier.
+ ***********************************************************/
+float PostStack::GetMilliseconds(int effect) const
+{
+	if ((effect < 0) || (effect >= EFFECT_COUNT))
+	{
+		return(0.0f);
+	}
+	return(m_effects[effect].gpuMilliseconds);
+}
+
+/***********************************************************
+ *  ParseEffect()
+ *
+ *  This method is used for setting the tier and optionally
+ *  the budget in milliseconds of an effect from text of the
+ *  form name=tier[:budget].
+ ***********************************************************/
+bool PostStack::ParseEffect(const char* text)
+{
+	const char* equals = strchr(text, '=');
+	if (equals == NULL)
+	{
+		return(false);
+	}
+
+	std::string name(text, equals - text);
+	for (int effect = 0; effect < EFFECT_COUNT; effect++)
+	{
+		if (name == EFFECT_NAMES[effect])
+		{
+			SetTier(effect, atoi(equals + 1));
+			const char* colon = strchr(equals + 1, ':');
+			if (colon != NULL)
+			{
+				SetBudget(effect, (float)atof(colon + 1));
+			}
+			return(true);
+		}
+	}
+	return(false);
+}
+
+/***********************************************************
+ *  GetEffectName()
+ *
+ *  This method is used for getting the name of an effect as
+ *  ParseEffect() reads it.
+ ***********************************************************/
+const char* PostStack::GetEffectName(int effect)
+{
+	if ((effect < 0) || (effect >= EFFECT_COUNT))
+	{
+		return("");
+	}
+	return(EFFECT_NAMES[effect]);
+}
+
+/***********************************************************
+ *  GetAntiAliasingName()
+ *
+ *  This method is used for getting the name of an
+ *  anti-aliasing mode.
+ ***********************************************************/
+const char* PostStack::GetAntiAliasingName(int mode)
+{
+	if ((mode < 0) || (mode >= AA_COUNT))
+	{
+		return("");
+	}
+	return(ANTI_ALIASING_NAMES[mode]);
+}
+
+/***********************************************************
+ *  GetAntiAliasingSamples()
+ *
+ *  This method is used for getting the samples per pixel of
+ *  an anti-aliasing mode.
+ ***********************************************************/
+int PostStack::GetAntiAliasingSamples(int mode)
+{
+	switch (mode)
+	{
+	case AA_MSAA_2X:
+		return(2);
+	case AA_MSAA_4X:
+		return(4);
+	case AA_MSAA_8X:
+		return(8);
+	}
+	return(1);
+}
+
+/***********************************************************
+ *  GetCheaperAntiAliasing()
+ *
+ *  This method is used for getting the mode a step cheaper
+ *  than a mode: fewer samples for the multisampled modes,
+ *  FXAA under two samples and under the temporal mode, and
+ *  none under FXAA.
+ ***********************************************************/
+int PostStack::GetCheaperAntiAliasing(int mode)
+{
+	switch (mode)
+	{
+	case AA_MSAA_8X:
+		return(AA_MSAA_4X);
+	case AA_MSAA_4X:
+		return(AA_MSAA_2X);
+	case AA_MSAA_2X:
+	case AA_TEMPORAL:
+		return(AA_FXAA);
+	}
+	return(AA_NONE);
+}
+
+/***********************************************************
+ *  JitterProjection()
+ *
+ *  This method is used for shifting a projection by the
+ *  subpixel offset of the current frame, in clip space so
+ *  perspective and orthographic projections move alike.
+ *  Without the temporal anti-aliasing it is unchanged.
+ ***********************************************************/
+glm::mat4 PostStack::JitterProjection(const glm::mat4& projection, int width, int height) const
+{
+	if ((IsEffectActive(EFFECT_TAA) == false) || (width <= 0) || (height <= 0))
+	{
+		return(projection);
+	}
+	glm::vec2 jitter = GetJitterOffset(m_frameIndex, width, height);
+	return(glm::translate(glm::mat4(1.0f), glm::vec3(jitter, 0.0f)) * projection);
+}
+
+/***********************************************************
+ *  GetJitterOffset()
+ *
+ *  This method is used for getting the offset of a frame in
+ *  normalized device coordinates: a point of the Halton
+ *  sequence of bases 2 and 3 within the pixel, so the
+ *  frames of a cycle cover it evenly.
+ ***********************************************************/
+glm::vec2 PostStack::GetJitterOffset(unsigned int frameIndex, int width, int height) const
+{
+	unsigned int phase = (frameIndex % JITTER_PHASES) + 1;
+	glm::vec2 pixelOffset(Halton(phase, 2) - 0.5f, Halton(phase, 3) - 0.5f);
+	return(glm::vec2(pixelOffset.x * 2.0f / (float)width, pixelOffset.y * 2.0f / (float)height));
+}
+
+/***********************************************************
+ *  CreateHistory()
+ *
+ *  This method is used for creating the history texture of
+ *  the temporal anti-aliasing at the frame size. It holds
+ *  nothing until the next frame is blended into it.
+ ***********************************************************/
+void PostStack::CreateHistory(int width, int height)
+{
+	DestroyHistory();
+	glGenTextures(1, &m_historyTexture);
+	m_pShaderManager->BindTexture(HISTORY_TEXTURE_UNIT, m_historyTexture);
+	m_pShaderManager->SetActiveTextureUnit(HISTORY_TEXTURE_UNIT);
+	glTexStorage2D(GL_TEXTURE_2D, 1, m_colorFormat, width, height);
+	GPUMemory::TrackTexture(m_historyTexture, m_colorFormat, width, height, 1, 1,
+		GPUMemory::CATEGORY_RENDER_TARGET, "taa history");
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	m_historyWidth = width;
+	m_historyHeight = height;
+	m_historyFormat = m_colorFormat;
+	m_bHistoryValid = false;
+}
+
+/***********************************************************
+ *  DestroyHistory()
+ *
+ *  This method is used for deleting the history texture.
+ ***********************************************************/
+void PostStack::DestroyHistory()
+{
+	if (0 != m_historyTexture)
+	{
+		GPUMemory::DeleteTextures(1, &m_historyTexture);
+		if (NULL != m_pShaderManager)
+		{
+			m_pShaderManager->ForgetTexture(m_historyTexture);
+		}
+		m_historyTexture = 0;
+	}
+	m_historyWidth = 0;
+	m_historyHeight = 0;
+	m_historyFormat = GL_NONE;
+	m_bHistoryValid = false;
+}
+
+/***********************************************************
+ *  CreateOcclusionHistory()
+ *
+ *  This method is used for creating the texture the raw
+ *  occlusion is kept in for the next frame, at the size the
+ *  occlusion is computed at.
+ ***********************************************************/
+void PostStack::CreateOcclusionHistory(int width, int height)
+{
+	DestroyOcclusionHistory();
+	glGenTextures(1, &m_occlusionHistoryTexture);
+	m_pShaderManager->BindTexture(OCCLUSION_HISTORY_TEXTURE_UNIT, m_occlusionHistoryTexture);
+	m_pShaderManager->SetActiveTextureUnit(OCCLUSION_HISTORY_TEXTURE_UNIT);
+	glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA16F, width, height);
+	GPUMemory::TrackTexture(m_occlusionHistoryTexture, GL_RGBA16F, width, height, 1, 1,
+		GPUMemory::CATEGORY_RENDER_TARGET, "ssao history");
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	m_occlusionHistoryWidth = width;
+	m_occlusionHistoryHeight = height;
+	m_bOcclusionHistoryValid = false;
+}
+
+/***********************************************************
+ *  DestroyOcclusionHistory()
+ *
+ *  This method is used for deleting the occlusion history.
+ ***********************************************************/
+void PostStack::DestroyOcclusionHistory()
+{
+	if (0 != m_occlusionHistoryTexture)
+	{
+		GPUMemory::DeleteTextures(1, &m_occlusionHistoryTexture);
+		if (NULL != m_pShaderManager)
+		{
+			m_pShaderManager->ForgetTexture(m_occlusionHistoryTexture);
+		}
+		m_occlusionHistoryTexture = 0;
+	}
+	m_occlusionHistoryWidth = 0;
+	m_occlusionHistoryHeight = 0;
+	m_bOcclusionHistoryValid = false;
+}
+
+/***********************************************************
+ *  IsActive()
+ *
+ *  This method is used for checking that any effect runs.
+ ***********************************************************/
+bool PostStack::IsActive() const
+{
+	for (int effect = 0; effect < EFFECT_COUNT; effect++)
+	{
+		if (IsEffectActive(effect) == true)
+		{
+			return(true);
+		}
+	}
+	return(false);
+}
+
+/***********************************************************
+ *  IsEffectActive()
+ *
+ *  This method is used for checking that an effect has a
+ *  tier and the programs it draws with, and for FXAA and
+ *  the temporal anti-aliasing that their mode is picked.
+ ***********************************************************/
+bool PostStack::IsEffectActive(int effect) const
+{
+	if ((effect < 0) || (effect >= EFFECT_COUNT) ||
+		(m_effects[effect].tier == TIER_OFF) || (0 == m_compositeProgram))
+	{
+		return(false);
+	}
+	switch (effect)
+	{
+	case EFFECT_TAA:
+		return((m_antiAliasing == AA_TEMPORAL) && (0 != m_taaProgram));
+	case EFFECT_SSAO:
+		return((0 != m_ssaoProgram) && (0 != m_ssaoBlurProgram));
+	case EFFECT_BLOOM:
+		return(0 != m_bloomProgram);
+	case EFFECT_FXAA:
+		return((m_antiAliasing == AA_FXAA) && (0 != m_fxaaProgram));
+	}
+	return(true);
+}
+
+/***********************************************************
+ *  AddPasses()
+ *
+ *  This method is used for adding the passes of the effects
+ *  to the graph. The lit frame is copied into a half float
+ *  target first, and its depth too for the occlusion and
+ *  the reprojection of the temporal anti-aliasing, which
+ *  replaces the copy with its blend with the history. The
+ *  occlusion and the bloom are drawn into small targets,
+ *  then the composite adds them to the color and tone maps
+ *  it, into the frame or, with FXAA, into a target FXAA
+ *  reads while it writes the frame.
+ ***********************************************************/
+void PostStack::AddPasses(RenderGraph& graph, int frame, const glm::mat4& view, const glm::mat4& projection)
+{
+	// the history only follows the frames it was blended from
+	if (IsEffectActive(EFFECT_TAA) == false)
+	{
+		m_bHistoryValid = false;
+	}
+	if ((IsEffectActive(EFFECT_SSAO) == false) || (m_bTemporalCaching == false))
+	{
+		m_bOcclusionHistoryValid = false;
+	}
+	if (IsActive() == false)
+	{
+		return;
+	}
+
+	// settle the tiers before the passes pick their settings
+	ReadTimings();
+	m_querySet = (m_querySet + 1) % QUERY_SETS;
+	m_inverseProjection = glm::inverse(projection);
+
+	RenderGraph* pGraph = &graph;
+	const bool bTemporal = IsEffectActive(EFFECT_TAA);
+	const bool bOcclusion = IsEffectActive(EFFECT_SSAO);
+	const bool bBloom = IsEffectActive(EFFECT_BLOOM);
+	const bool bFXAA = IsEffectActive(EFFECT_FXAA);
+
+	int color = graph.CreateTexture("post color", m_colorFormat);
+	int depth = -1;
+	if ((bTemporal == true) || (bOcclusion == true))
+	{
+		depth = graph.CreateTexture("post depth", GL_DEPTH_COMPONENT32F);
+	}
+
+	int sourcePass = graph.AddPass("post source", [this, pGraph, frame, color, depth]()
+		{
+			if (NULL != m_pGPUProfiler)
+			{
+				m_pGPUProfiler->BeginPass(GPUProfiler::PASS_POST);
+			}
+			GLDebug::PushGroup("post effects");
+			glDisable(GL_DEPTH_TEST);
+			glDisable(GL_BLEND);
+			glBindSampler(COLOR_TEXTURE_UNIT, m_linearSampler);
+			glBindSampler(BLOOM_TEXTURE_UNIT, m_linearSampler);
+			glBindSampler(HISTORY_TEXTURE_UNIT, m_linearSampler);
+
+			// copy the lit frame into the targets the effects sample
+			GLint viewport[4] = { 0, 0, 0, 0 };
+			glGetIntegerv(GL_VIEWPORT, viewport);
+			GLint passFramebuffer = 0;
+			glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &passFramebuffer);
+			glBindFramebuffer(GL_READ_FRAMEBUFFER, pGraph->GetFramebuffer(frame));
+			m_pShaderManager->BindTexture(COLOR_TEXTURE_UNIT, pGraph->GetTexture(color));
+			m_pShaderManager->SetActiveTextureUnit(COLOR_TEXTURE_UNIT);
+			GLTrace::RecordCopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 0, 0, viewport[2], viewport[3]);
+			glCopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 0, 0, viewport[2], viewport[3]);
+			if (depth >= 0)
+			{
+				m_pShaderManager->BindTexture(DEPTH_TEXTURE_UNIT, pGraph->GetTexture(depth));
+				m_pShaderManager->SetActiveTextureUnit(DEPTH_TEXTURE_UNIT);
+				GLTrace::RecordCopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 0, 0, viewport[2], viewport[3]);
+				glCopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 0, 0, viewport[2], viewport[3]);
+			}
+			glBindFramebuffer(GL_READ_FRAMEBUFFER, (GLuint)passFramebuffer);
+		});
+	graph.Read(sourcePass, frame);
+	graph.Write(sourcePass, color);
+	if (depth >= 0)
+	{
+		graph.Write(sourcePass, depth);
+	}
+
+	// the frame blended with the history reprojected onto it, which
+	// then becomes the history of the next frame
+	if (bTemporal == true)
+	{
+		const int tier = m_effects[EFFECT_TAA].tier;
+		const unsigned int frameIndex = m_frameIndex;
+		int resolved = graph.CreateTexture("taa color", m_colorFormat);
+		int temporalPass = graph.AddPass("taa", [this, pGraph, color, depth, tier, frameIndex, view, projection]()
+			{
+				BeginTiming(EFFECT_TAA);
+				GLint viewport[4] = { 0, 0, 0, 0 };
+				glGetIntegerv(GL_VIEWPORT, viewport);
+				if ((viewport[2] != m_historyWidth) || (viewport[3] != m_historyHeight) ||
+					(m_historyFormat != m_colorFormat))
+				{
+					CreateHistory(viewport[2], viewport[3]);
+				}
+
+				// the history is reprojected by the view of the last
+				// frame without its jitter, which the depth of this
+				// frame carries
+				glm::vec2 jitter = GetJitterOffset(frameIndex, viewport[2], viewport[3]);
+				glm::mat4 unjitteredProjection = glm::translate(glm::mat4(1.0f), glm::vec3(-jitter, 0.0f)) * projection;
+				glm::mat4 inverseViewProjection = glm::inverse(projection * view);
+
+				m_pShaderManager->BindTexture(COLOR_TEXTURE_UNIT, pGraph->GetTexture(color));
+				m_pShaderManager->BindTexture(DEPTH_TEXTURE_UNIT, pGraph->GetTexture(depth));
+				m_pShaderManager->BindTexture(HISTORY_TEXTURE_UNIT, m_historyTexture);
+				m_pShaderManager->UseExternalProgram(m_taaProgram);
+				glUniformMatrix4fv(glGetUniformLocation(m_taaProgram, "inverseViewProjection"), 1, GL_FALSE, &inverseViewProjection[0][0]);
+				glUniformMatrix4fv(glGetUniformLocation(m_taaProgram, "previousViewProjection"), 1, GL_FALSE, &m_previousViewProjection[0][0]);
+				glUniform1i(glGetUniformLocation(m_taaProgram, "historyValid"), (m_bHistoryValid == true) ? 1 : 0);
+				glUniform1i(glGetUniformLocation(m_taaProgram, "clampMode"), TAA_CLAMP_MODES[tier]);
+				glUniform1f(glGetUniformLocation(m_taaProgram, "blendFactor"), TAA_BLEND_FACTORS[tier]);
+				DrawFullScreen();
+
+				m_pShaderManager->SetActiveTextureUnit(HISTORY_TEXTURE_UNIT);
+				GLTrace::RecordCopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 0, 0, viewport[2], viewport[3]);
+				glCopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 0, 0, viewport[2], viewport[3]);
+				m_previousViewProjection = unjitteredProjection * view;
+				m_bHistoryValid = true;
+				EndTiming(EFFECT_TAA);
+			});
+		graph.Read(temporalPass, color);
+		graph.Read(temporalPass, depth);
+		graph.Write(temporalPass, resolved);
+		color = resolved;
+	}
+
+	// occlusion, its view depth and its age at a fraction of the
+	// frame size, most pixels reusing the occlusion of the last frame
+	// while the camera moves slowly, then blurred without bleeding
+	// across depth edges
+	int occlusion = -1;
+	int occlusionDivisor = 1;
+	if (bOcclusion == true)
+	{
+		const int tier = m_effects[EFFECT_SSAO].tier;
+		const unsigned int frameIndex = m_frameIndex;
+		occlusionDivisor = SSAO_DIVISORS[tier];
+		int rawOcclusion = graph.CreateTexture("ssao", GL_RGBA16F, occlusionDivisor);
+		occlusion = graph.CreateTexture("ssao blurred", GL_RG16F, occlusionDivisor);
+
+		int ssaoPass = graph.AddPass("ssao", [this, pGraph, depth, tier, occlusionDivisor, frameIndex, view, projection]()
+			{
+				BeginTiming(EFFECT_SSAO);
+				GLint viewport[4] = { 0, 0, 0, 0 };
+				glGetIntegerv(GL_VIEWPORT, viewport);
+				if ((m_bTemporalCaching == true) &&
+					((viewport[2] != m_occlusionHistoryWidth) || (viewport[3] != m_occlusionHistoryHeight)))
+				{
+					CreateOcclusionHistory(viewport[2], viewport[3]);
+				}
+				glm::mat4 inverseView = glm::inverse(view);
+
+				m_pShaderManager->BindTexture(DEPTH_TEXTURE_UNIT, pGraph->GetTexture(depth));
+				m_pShaderManager->BindTexture(OCCLUSION_HISTORY_TEXTURE_UNIT, m_occlusionHistoryTexture);
+				m_pShaderManager->UseExternalProgram(m_ssaoProgram);
+				glUniformMatrix4fv(glGetUniformLocation(m_ssaoProgram, "inverseProjection"), 1, GL_FALSE, &m_inverseProjection[0][0]);
+				glUniformMatrix4fv(glGetUniformLocation(m_ssaoProgram, "inverseView"), 1, GL_FALSE, &inverseView[0][0]);
+				glUniformMatrix4fv(glGetUniformLocation(m_ssaoProgram, "previousView"), 1, GL_FALSE, &m_previousOcclusionView[0][0]);
+				glUniformMatrix4fv(glGetUniformLocation(m_ssaoProgram, "previousViewProjection"), 1, GL_FALSE, &m_previousOcclusionViewProjection[0][0]);
+				glUniform1i(glGetUniformLocation(m_ssaoProgram, "historyValid"), (m_bOcclusionHistoryValid == true) ? 1 : 0);
+				glUniform1i(glGetUniformLocation(m_ssaoProgram, "cacheFrames"), (m_bTemporalCaching == true) ? SSAO_CACHE_FRAMES : 0);
+				glUniform1i(glGetUniformLocation(m_ssaoProgram, "frameIndex"), (GLint)(frameIndex % SSAO_CACHE_FRAMES));
+				glUniform1f(glGetUniformLocation(m_ssaoProgram, "maxMotion"), SSAO_CACHE_MAX_MOTION);
+				glUniform1i(glGetUniformLocation(m_ssaoProgram, "resolutionDivisor"), occlusionDivisor);
+				glUniform1i(glGetUniformLocation(m_ssaoProgram, "sampleCount"), SSAO_SAMPLES[tier]);
+				glUniform1f(glGetUniformLocation(m_ssaoProgram, "radius"), SSAO_RADIUS);
+				DrawFullScreen();
+
+				// the raw occlusion, before the blur, is what the next
+				// frame reuses
+				if (m_bTemporalCaching == true)
+				{
+					m_pShaderManager->SetActiveTextureUnit(OCCLUSION_HISTORY_TEXTURE_UNIT);
+					GLTrace::RecordCopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 0, 0, viewport[2], viewport[3]);
+					glCopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 0, 0, viewport[2], viewport[3]);
+					m_previousOcclusionView = view;
+					m_previousOcclusionViewProjection = projection * view;
+					m_bOcclusionHistoryValid = true;
+				}
+			});
+		graph.Read(ssaoPass, depth);
+		graph.Write(ssaoPass, rawOcclusion);
+
+		int blurPass = graph.AddPass("ssao blur", [this, pGraph, rawOcclusion, tier]()
+			{
+				m_pShaderManager->BindTexture(OCCLUSION_TEXTURE_UNIT, pGraph->GetTexture(rawOcclusion));
+				m_pShaderManager->UseExternalProgram(m_ssaoBlurProgram);
+				glUniform1i(glGetUniformLocation(m_ssaoBlurProgram, "blurRadius"), SSAO_BLUR_RADII[tier]);
+				DrawFullScreen();
+				EndTiming(EFFECT_SSAO);
+			});
+		graph.Read(blurPass, rawOcclusion);
+		graph.Write(blurPass, occlusion);
+	}
+
+	// the pixels above the threshold, downsampled and blurred back
+	// and forth between two small targets
+	int bloom = -1;
+	if (bBloom == true)
+	{
+		const int tier = m_effects[EFFECT_BLOOM].tier;
+		bloom = graph.CreateTexture("bloom", m_colorFormat, BLOOM_DIVISORS[tier]);
+		int bloomBlur = graph.CreateTexture("bloom blur", m_colorFormat, BLOOM_DIVISORS[tier]);
+
+		int brightPass = graph.AddPass("bloom bright", [this, pGraph, color, tier]()
+			{
+				BeginTiming(EFFECT_BLOOM);
+				m_pShaderManager->BindTexture(COLOR_TEXTURE_UNIT, pGraph->GetTexture(color));
+				m_pShaderManager->UseExternalProgram(m_bloomProgram);
+				glUniform1i(glGetUniformLocation(m_bloomProgram, "bloomStage"), 0);
+				glUniform1f(glGetUniformLocation(m_bloomProgram, "threshold"), BLOOM_THRESHOLD);
+				glUniform1f(glGetUniformLocation(m_bloomProgram, "sourceScale"), (float)BLOOM_DIVISORS[tier]);
+				DrawFullScreen();
+			});
+		graph.Read(brightPass, color);
+		graph.Write(brightPass, bloom);
+
+		const int iterations = BLOOM_ITERATIONS[tier];
+		for (int i = 0; i < iterations * 2; i++)
+		{
+			const bool bHorizontal = ((i % 2) == 0);
+			const bool bLast = (i == iterations * 2 - 1);
+			int source = (bHorizontal == true) ? bloom : bloomBlur;
+			int target = (bHorizontal == true) ? bloomBlur : bloom;
+			int blurPass = graph.AddPass("bloom blur", [this, pGraph, source, tier, bHorizontal, bLast]()
+				{
+					m_pShaderManager->BindTexture(BLOOM_TEXTURE_UNIT, pGraph->GetTexture(source));
+					m_pShaderManager->UseExternalProgram(m_bloomProgram);
+					glUniform1i(glGetUniformLocation(m_bloomProgram, "bloomStage"), 1);
+					glUniform2f(glGetUniformLocation(m_bloomProgram, "blurDirection"),
+						(bHorizontal == true) ? 1.0f : 0.0f, (bHorizontal == true) ? 0.0f : 1.0f);
+					glUniform1i(glGetUniformLocation(m_bloomProgram, "tapCount"), BLOOM_TAPS[tier]);
+					DrawFullScreen();
+					if (bLast == true)
+					{
+						EndTiming(EFFECT_BLOOM);
+					}
+				});
+			graph.Read(blurPass, source);
+			graph.Write(blurPass, target);
+		}
+	}
+
+	// the composite writes the frame, or the target FXAA reads
+	int composited = frame;
+	if (bFXAA == true)
+	{
+		composited = graph.CreateTexture("post composite", GL_RGBA8);
+	}
+	const int toneMapper = TONE_MAPPERS[m_effects[EFFECT_TONEMAP].tier];
+	int compositePass = graph.AddPass("post composite",
+		[this, pGraph, color, depth, occlusion, occlusionDivisor, bloom, toneMapper, bFXAA]()
+		{
+			BeginTiming(EFFECT_TONEMAP);
+			m_pShaderManager->BindTexture(COLOR_TEXTURE_UNIT, pGraph->GetTexture(color));
+			if (occlusion >= 0)
+			{
+				m_pShaderManager->BindTexture(DEPTH_TEXTURE_UNIT, pGraph->GetTexture(depth));
+				m_pShaderManager->BindTexture(OCCLUSION_TEXTURE_UNIT, pGraph->GetTexture(occlusion));
+			}
+			if (bloom >= 0)
+			{
+				m_pShaderManager->BindTexture(BLOOM_TEXTURE_UNIT, pGraph->GetTexture(bloom));
+			}
+			m_pShaderManager->UseExternalProgram(m_compositeProgram);
+			glUniformMatrix4fv(glGetUniformLocation(m_compositeProgram, "inverseProjection"), 1, GL_FALSE, &m_inverseProjection[0][0]);
+			glUniform1i(glGetUniformLocation(m_compositeProgram, "occlusionEnabled"), (occlusion >= 0) ? 1 : 0);
+			glUniform1i(glGetUniformLocation(m_compositeProgram, "occlusionDivisor"), occlusionDivisor);
+			glUniform1f(glGetUniformLocation(m_compositeProgram, "bloomStrength"), (bloom >= 0) ? BLOOM_STRENGTH : 0.0f);
+			glUniform1i(glGetUniformLocation(m_compositeProgram, "toneMapper"), toneMapper);
+			glUniform1f(glGetUniformLocation(m_compositeProgram, "exposure"), m_exposure);
+			glUniform1i(glGetUniformLocation(m_compositeProgram, "lumaInAlpha"), (bFXAA == true) ? 1 : 0);
+			DrawFullScreen();
+			EndTiming(EFFECT_TONEMAP);
+		});
+	graph.Read(compositePass, color);
+	if (occlusion >= 0)
+	{
+		graph.Read(compositePass, depth);
+		graph.Read(compositePass, occlusion);
+	}
+	if (bloom >= 0)
+	{
+		graph.Read(compositePass, bloom);
+	}
+	graph.Write(compositePass, composited);
+
+	if (bFXAA == true)
+	{
+		const int tier = m_effects[EFFECT_FXAA].tier;
+		int fxaaPass = graph.AddPass("fxaa", [this, pGraph, composited, tier]()
+			{
+				BeginTiming(EFFECT_FXAA);
+				m_pShaderManager->BindTexture(COLOR_TEXTURE_UNIT, pGraph->GetTexture(composited));
+				m_pShaderManager->UseExternalProgram(m_fxaaProgram);
+				glUniform1i(glGetUniformLocation(m_fxaaProgram, "searchSteps"), FXAA_SEARCH_STEPS[tier]);
+				DrawFullScreen();
+				EndTiming(EFFECT_FXAA);
+			});
+		graph.Read(fxaaPass, composited);
+		graph.Write(fxaaPass, frame);
+	}
+
+	// the state the scene draws expect, after the last pass
+	int endPass = graph.AddPass("post end", [this]()
+		{
+			glBindSampler(COLOR_TEXTURE_UNIT, 0);
+			glBindSampler(BLOOM_TEXTURE_UNIT, 0);
+			glBindSampler(HISTORY_TEXTURE_UNIT, 0);
+			glEnable(GL_BLEND);
+			glEnable(GL_DEPTH_TEST);
+			GLDebug::PopGroup();
+			if (NULL != m_pGPUProfiler)
+			{
+				m_pGPUProfiler->EndPass(GPUProfiler::PASS_POST);
+			}
+		});
+	graph.Write(endPass, frame);
+	m_frameIndex++;
+}
+
+/***********************************************************
+ *  ReadTimings()
+ *
+ *  This method is used for reading the timestamps of the
+ *  frames the GPU finished, without waiting for the others,
+ *  and moving the tier of each effect toward its budget.
+ ***********************************************************/
+void PostStack::ReadTimings()
+{
+	for (int effect = 0; effect < EFFECT_COUNT; effect++)
+	{
+		EFFECT_STATE& state = m_effects[effect];
+		for (int set = 0; set < QUERY_SETS; set++)
+		{
+			if (state.bPending[set] == false)
+			{
+				continue;
+			}
+			GLint available = 0;
+			glGetQueryObjectiv(state.queries[set][1], GL_QUERY_RESULT_AVAILABLE, &available);
+			if (available == 0)
+			{
+				continue;
+			}
+
+			GLuint64 startTime = 0;
+			GLuint64 endTime = 0;
+			glGetQueryObjectui64v(state.queries[set][0], GL_QUERY_RESULT, &startTime);
+			glGetQueryObjectui64v(state.queries[set][1], GL_QUERY_RESULT, &endTime);
+			state.bPending[set] = false;
+
+			float milliseconds = (float)((double)(endTime - startTime) / 1000000.0);
+			if (state.gpuMilliseconds <= 0.0f)
+			{
+				state.gpuMilliseconds = milliseconds;
+			}
+			else
+			{
+				state.gpuMilliseconds += (milliseconds - state.gpuMilliseconds) * TIME_SMOOTHING;
+			}
+			UpdateTier(effect);
+		}
+	}
+}
+
+/***********************************************************
+ *  UpdateTier()
+ *
+ *  This method is used for moving an effect a tier down when
+ *  its smoothed time is over its budget, or back up toward
+ *  the tier asked for, under the cap, when it is well under
+ *  it. A tier is held for a while after a change, so the
+ *  time measured at it settles first; the budget never turns
+ *  an effect off.
+ ***********************************************************/
+void PostStack::UpdateTier(int effect)
+{
+	EFFECT_STATE& state = m_effects[effect];
+	const int cappedTier = GetCappedTier(effect);
+	if ((state.budgetMilliseconds <= 0.0f) || (cappedTier == TIER_OFF))
+	{
+		state.tier = cappedTier;
+		return;
+	}
+
+	state.framesSinceChange++;
+	if (state.framesSinceChange < SETTLE_FRAMES)
+	{
+		return;
+	}
+
+	int tier = state.tier;
+	if ((state.gpuMilliseconds > state.budgetMilliseconds) && (tier > TIER_LOW))
+	{
+		tier--;
+	}
+	else if ((state.gpuMilliseconds < state.budgetMilliseconds * RAISE_FRACTION) && (tier < cappedTier))
+	{
+		tier++;
+	}
+	if (tier != state.tier)
+	{
+		state.tier = tier;
+		state.framesSinceChange = 0;
+		state.gpuMilliseconds = 0.0f;
+	}
+}
+
+/***********************************************************
+ *  BeginTiming()
+ *
+ *  This method is used for writing the start timestamp of an
+ *  effect into the query set of the frame, unless the GPU
+ *  has not finished with that set yet.
+ ***********************************************************/
+void PostStack::BeginTiming(int effect)
+{
+	EFFECT_STATE& state = m_effects[effect];
+	state.bTiming = (state.tier != TIER_OFF) && (state.bPending[m_querySet] == false);
+	if (state.bTiming == true)
+	{
+		glQueryCounter(state.queries[m_querySet][0], GL_TIMESTAMP);
+	}
+}
+
+/***********************************************************
+ *  EndTiming()
+ *
+ *  This method is used for writing the end timestamp of an
+ *  effect timed this frame.
+ ***********************************************************/
+void PostStack::EndTiming(int effect)
+{
+	EFFECT_STATE& state = m_effects[effect];
+	if (state.bTiming == true)
+	{
+		glQueryCounter(state.queries[m_querySet][1], GL_TIMESTAMP);
+		state.bPending[m_querySet] = true;
+		state.bTiming = false;
+	}
+}
+
+/***********************************************************
+ *  DrawFullScreen()
+ *
+ *  This method is used for drawing the full screen triangle
+ *  with the program in use.
+ ***********************************************************/
+void PostStack::DrawFullScreen()
+{
+	ShapeMeshes::BindVertexArray(m_vertexArray);
+	GLTrace::RecordDrawArrays(GL_TRIANGLES, 0, 3);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+}
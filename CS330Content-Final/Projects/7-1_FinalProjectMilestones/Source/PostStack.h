@@ -0,0 +1,245 @@
+///////////////////////////////////////////////////////////////////////////////
+// poststack.h
+// ============
+// post effects of the frame as passes of the render graph
+//
+//  The lit frame is copied into half float targets and filtered by
+//  temporal anti-aliasing, screen space ambient occlusion, bloom, tone
+//  mapping and FXAA, each at a quality tier of its own. Ambient occlusion and the bloom blur
+//  run at a half or quarter of the frame size, the occlusion brought
+//  back up with a depth aware filter and reused over the frames
+//  where the camera barely moves. Every effect is timed on the
+//  GPU, and one over its time budget drops a tier, climbing back once
+//  it has room again, so a slow machine keeps every effect at a lower
+//  quality instead of losing them.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "ShaderManager.h"
+#include "RenderGraph.h"
+#include "GPUProfiler.h"
+
+/***********************************************************
+ *  PostStack
+ *
+ *  This class contains the programs, quality tiers, budgets
+ *  and timer queries of the post effects. AddPasses() adds
+ *  the passes of the effects that are on to the render
+ *  graph of a frame, reading the lit frame and writing the
+ *  filtered one back into it.
+ ***********************************************************/
+class PostStack
+{
+public:
+	// constructor
+	PostStack(ShaderManager* pShaderManager);
+	// destructor
+	~PostStack();
+
+	// the effects, in the order they are applied
+	enum EFFECT
+	{
+		EFFECT_TAA = 0,		// frames drawn a subpixel apart blended over time
+		EFFECT_SSAO,		// screen space ambient occlusion
+		EFFECT_BLOOM,		// glow around the brightest pixels
+		EFFECT_TONEMAP,		// high range color to the display range
+		EFFECT_FXAA,		// edge smoothing of the tone mapped frame
+		EFFECT_COUNT
+	};
+
+	// anti-aliasing of the main view; the multisampled modes are
+	// drawn by the scene, FXAA and TAA are effects of the stack and
+	// only run while their mode is picked
+	enum ANTI_ALIASING
+	{
+		AA_NONE = 0,
+		AA_MSAA_2X,
+		AA_MSAA_4X,
+		AA_MSAA_8X,
+		AA_FXAA,
+		AA_TEMPORAL,
+		AA_COUNT
+	};
+
+	// quality of an effect; the budget moves it between TIER_LOW
+	// and the tier asked for
+	enum TIER
+	{
+		TIER_OFF = 0,
+		TIER_LOW,
+		TIER_MEDIUM,
+		TIER_HIGH
+	};
+
+	// texture units the effects read from, those of the G-buffer,
+	// which is done with by the time the effects run
+	static const int COLOR_TEXTURE_UNIT = 20;
+	static const int DEPTH_TEXTURE_UNIT = 21;
+	static const int OCCLUSION_TEXTURE_UNIT = 22;
+	static const int BLOOM_TEXTURE_UNIT = 23;
+	// the earlier frames the temporal anti-aliasing blends with, on
+	// the unit of the transparency revealage, also done with
+	static const int HISTORY_TEXTURE_UNIT = 19;
+	// the occlusion of the earlier frames, read while the occlusion
+	// is computed, before the blurred occlusion takes the unit
+	static const int OCCLUSION_HISTORY_TEXTURE_UNIT = 22;
+
+	// frames whose timer queries may still be pending
+	static const int QUERY_SETS = 4;
+
+	// build the programs of the effects from the full screen vertex
+	// shader; an effect whose program fails stays off. False when
+	// none built
+	bool Create(
+		const char* vertexPath,
+		const char* ssaoFragmentPath,
+		const char* ssaoBlurFragmentPath,
+		const char* bloomFragmentPath,
+		const char* compositeFragmentPath,
+		const char* fxaaFragmentPath,
+		const char* taaFragmentPath);
+
+	// the tier asked for an effect, and the one it runs at
+	void SetTier(int effect, int tier);
+	int GetRequestedTier(int effect) const;
+	int GetTier(int effect) const;
+	// highest tier any effect runs at, over what it asks for and its
+	// budget; never below TIER_LOW, so no effect is turned off
+	void SetTierCap(int tier);
+	int GetTierCap() const { return(m_tierCap); }
+	// GPU time an effect may take a frame, 0 for no limit
+	void SetBudget(int effect, float milliseconds);
+	float GetBudget(int effect) const;
+	// smoothed GPU time of an effect, 0 before it was measured
+	float GetMilliseconds(int effect) const;
+	// set an effect from text of the form name=tier[:budget]
+	bool ParseEffect(const char* text);
+	static const char* GetEffectName(int effect);
+
+	// brightness the frame is scaled by before the tone mapping
+	void SetExposure(float exposure) { m_exposure = exposure; }
+	// format of the targets holding the frame before the tone mapping,
+	// the HDR color of the TargetFormats tier; the history is made
+	// again in it on the next frame
+	void SetColorFormat(GLenum colorFormat) { m_colorFormat = colorFormat; }
+
+	// reuse the occlusion of the earlier frames where the camera
+	// barely moved, recomputing the pixels newly uncovered and a
+	// share of the others each frame
+	void SetTemporalCaching(bool bEnable) { m_bTemporalCaching = bEnable; }
+	bool IsTemporalCachingEnabled() const { return(m_bTemporalCaching); }
+
+	// pick the anti-aliasing mode, which turns FXAA and TAA on or off
+	void SetAntiAliasing(int mode) { m_antiAliasing = mode; }
+	int GetAntiAliasing() const { return(m_antiAliasing); }
+	static const char* GetAntiAliasingName(int mode);
+	// samples per pixel of a mode, 1 for those not multisampled
+	static int GetAntiAliasingSamples(int mode);
+	// the next cheaper mode down from a mode, none from none
+	static int GetCheaperAntiAliasing(int mode);
+	// the projection of the main view shifted by the subpixel offset
+	// of the current frame, for a frame of the given size
+	glm::mat4 JitterProjection(const glm::mat4& projection, int width, int height) const;
+
+	// true when an effect is on and its programs built
+	bool IsEffectActive(int effect) const;
+	// true when an effect is on, so the frame wants a high range
+	// color buffer for them to read
+	bool IsActive() const;
+	// time the effects as a pass of the profiler; NULL for none
+	void SetGPUProfiler(GPUProfiler* pProfiler) { m_pGPUProfiler = pProfiler; }
+
+	// add the passes of the effects that are on to the graph, reading
+	// and writing the imported frame drawn with the view and the
+	// projection, jittered when the temporal anti-aliasing is on
+	void AddPasses(RenderGraph& graph, int frame, const glm::mat4& view, const glm::mat4& projection);
+
+private:
+	// smoothing of the measured times
+	static const float TIME_SMOOTHING;
+	// frames a tier is kept before the budget moves it again
+	static const int SETTLE_FRAMES = 30;
+	// share of the budget an effect must stay under to climb a tier
+	static const float RAISE_FRACTION;
+	// subpixel offsets the temporal anti-aliasing cycles through
+	static const int JITTER_PHASES = 8;
+
+	struct EFFECT_STATE
+	{
+		int requestedTier;
+		int tier;
+		float budgetMilliseconds;
+		float gpuMilliseconds;
+		int framesSinceChange;
+		// start and end timestamps of each query set
+		GLuint queries[QUERY_SETS][2];
+		bool bPending[QUERY_SETS];
+		// true while the effect is timed into the current set
+		bool bTiming;
+	};
+
+	// pointer to shader manager object
+	ShaderManager* m_pShaderManager;
+	GPUProfiler* m_pGPUProfiler;
+	// programs of the effects, 0 where one did not build
+	GLuint m_ssaoProgram;
+	GLuint m_ssaoBlurProgram;
+	GLuint m_bloomProgram;
+	GLuint m_compositeProgram;
+	GLuint m_fxaaProgram;
+	GLuint m_taaProgram;
+	// vertex array for the full screen triangle, which has no buffers
+	GLuint m_vertexArray;
+	// bilinear sampler of the color and bloom reads
+	GLuint m_linearSampler;
+	EFFECT_STATE m_effects[EFFECT_COUNT];
+	// query set of the current frame
+	int m_querySet;
+	int m_tierCap;
+	float m_exposure;
+	GLenum m_colorFormat;
+	// projection of the frame inverted, for the depth reads
+	glm::mat4 m_inverseProjection;
+	int m_antiAliasing;
+	// the blended earlier frames of the temporal anti-aliasing, and
+	// the unjittered view and projection of the last one
+	GLuint m_historyTexture;
+	int m_historyWidth;
+	int m_historyHeight;
+	GLenum m_historyFormat;
+	bool m_bHistoryValid;
+	glm::mat4 m_previousViewProjection;
+	// frames drawn, which pick the subpixel offset and the pixels
+	// whose cached occlusion is recomputed
+	unsigned int m_frameIndex;
+	// the occlusion, view depth and age of the last frame it was
+	// computed for, and the view and projection of that frame
+	bool m_bTemporalCaching;
+	GLuint m_occlusionHistoryTexture;
+	int m_occlusionHistoryWidth;
+	int m_occlusionHistoryHeight;
+	bool m_bOcclusionHistoryValid;
+	glm::mat4 m_previousOcclusionView;
+	glm::mat4 m_previousOcclusionViewProjection;
+
+	// subpixel offset of a frame in clip space for a frame of the size
+	glm::vec2 GetJitterOffset(unsigned int frameIndex, int width, int height) const;
+	// size the history for a frame, forgetting what it held
+	void CreateHistory(int width, int height);
+	void DestroyHistory();
+	// the same for the occlusion history, at the size of the occlusion
+	void CreateOcclusionHistory(int width, int height);
+	void DestroyOcclusionHistory();
+	// read the finished timer queries and move the tiers to their
+	// budgets
+	void ReadTimings();
+	void UpdateTier(int effect);
+	// the tier asked for an effect under the cap
+	int GetCappedTier(int effect) const;
+	// bracket the passes of an effect with timestamps
+	void BeginTiming(int effect);
+	void EndTiming(int effect);
+	// draw the full screen triangle with the program in use
+	void DrawFullScreen();
+};
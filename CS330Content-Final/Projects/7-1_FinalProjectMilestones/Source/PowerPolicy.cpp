@@ -0,0 +1,495 @@
+///////////////////////////////////////////////////////////////////////////////
+// powerpolicy.cpp
+// ============
+// frame rate and quality limits following the power source and the heat
+//
+//  A laptop on battery, low on charge or running hot has no use for a
+//  frame rate above what is needed to look smooth. Every few seconds
+//  the power source, the charge and the temperature or throttling the
+//  platform reports are read, and they pick one of three tiers, each
+//  with a frame cap, a render scale, a cap on the post effect tiers
+//  and the shadow filtering, and whether an unchanged scene stops
+//  being drawn. The time spent in each tier, the frames drawn and
+//  skipped in it and the charge used are kept for the stats.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "PowerPolicy.h"
+#include "PostStack.h"
+#include "ShadowAtlas.h"
+
+#include <glm/glm.hpp>
+
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <powrprof.h>
+#pragma comment(lib, "PowrProf.lib")
+#else
+#include <dirent.h>
+#endif
+
+const double PowerPolicy::POLL_SECONDS = 2.0;
+const float PowerPolicy::WARM_TEMPERATURE = 80.0f;
+const float PowerPolicy::HOT_TEMPERATURE = 90.0f;
+const float PowerPolicy::COOLING_MARGIN = 5.0f;
+
+namespace
+{
+	// names of the TIER values, for the command line and stats
+	const char* const TIER_NAMES[PowerPolicy::TIER_COUNT] =
+	{
+		"full",
+		"save",
+		"low"
+	};
+
+	// limits of each tier; the saving ones still draw at a rate that
+	// looks smooth, and only the lowest gives up anti-aliasing
+	const PowerPolicy::TIER_LIMITS LIMITS_OF_TIERS[PowerPolicy::TIER_COUNT] =
+	{
+		{ 0.0, 1.0f, PostStack::TIER_HIGH, ShadowAtlas::SHADOW_QUALITY_HIGH, 0, false },
+		{ 30.0, 0.85f, PostStack::TIER_MEDIUM, ShadowAtlas::SHADOW_QUALITY_MEDIUM, 0, true },
+		{ 20.0, 0.7f, PostStack::TIER_LOW, ShadowAtlas::SHADOW_QUALITY_LOW, 1, true }
+	};
+
+#ifdef _WIN32
+	// one processor of CallNtPowerInformation(ProcessorInformation),
+	// which the SDK headers leave undeclared
+	struct PROCESSOR_POWER_INFORMATION
+	{
+		ULONG Number;
+		ULONG MaxMhz;
+		ULONG CurrentMhz;
+		ULONG MhzLimit;
+		ULONG MaxIdleState;
+		ULONG CurrentIdleState;
+	};
+#else
+	/***********************************************************
+	 *  ReadFirstLine()
+	 *
+	 *  This function is used for reading the first line of a
+	 *  file, as sysfs holds a value; false when it cannot be
+	 *  read.
+	 ***********************************************************/
+	bool ReadFirstLine(const std::string& path, std::string& line)
+	{
+		std::ifstream file(path.c_str());
+		if (!file)
+		{
+			return(false);
+		}
+		return((bool)std::getline(file, line));
+	}
+
+	/***********************************************************
+	 *  ListEntries()
+	 *
+	 *  This function is used for listing the entries of a
+	 *  directory whose names start with the prefix given.
+	 ***********************************************************/
+	std::vector<std::string> ListEntries(const char* directory, const char* prefix)
+	{
+		std::vector<std::string> entries;
+		DIR* pDirectory = opendir(directory);
+		if (NULL == pDirectory)
+		{
+			return(entries);
+		}
+		size_t prefixLength = strlen(prefix);
+		struct dirent* pEntry = NULL;
+		while ((pEntry = readdir(pDirectory)) != NULL)
+		{
+			if ((pEntry->d_name[0] != '.') && (strncmp(pEntry->d_name, prefix, prefixLength) == 0))
+			{
+				entries.push_back(std::string(directory) + "/" + pEntry->d_name);
+			}
+		}
+		closedir(pDirectory);
+		return(entries);
+	}
+#endif
+}
+
+/***********************************************************
+ *  PowerPolicy()
+ *
+ *  The constructor for the class.
+ ***********************************************************/
+PowerPolicy::PowerPolicy()
+{
+	m_bEnabled = false;
+	m_forcedTier = -1;
+	m_tier.store(TIER_FULL);
+	m_powerTier = TIER_FULL;
+	m_thermalTier = TIER_FULL;
+	m_state.source = SOURCE_UNKNOWN;
+	m_state.batteryPercent = -1;
+	m_state.bBatterySaver = false;
+	m_state.temperature = -1.0f;
+	m_state.bThrottled = false;
+	m_lastPollTime = -1.0;
+	m_lastTime = -1.0;
+	memset(&m_stats, 0, sizeof(m_stats));
+	m_stats.firstBatteryPercent = -1;
+	m_stats.lastBatteryPercent = -1;
+	m_stats.maxTemperature = -1.0f;
+}
+
+/***********************************************************
+ *  ~PowerPolicy()
+ *
+ *  The destructor for the class.
+ ***********************************************************/
+PowerPolicy::~PowerPolicy()
+{
+}
+
+/***********************************************************
+ *  GetTierName()
+ *
+ *  This method is used for getting the name of a tier.
+ ***********************************************************/
+const char* PowerPolicy::GetTierName(int tier)
+{
+	if ((tier < 0) || (tier >= TIER_COUNT))
+	{
+		return("unknown");
+	}
+	return(TIER_NAMES[tier]);
+}
+
+/***********************************************************
+ *  FindTier()
+ *
+ *  This method is used for finding the tier of a name.
+ ***********************************************************/
+int PowerPolicy::FindTier(const char* name)
+{
+	for (int tier = 0; tier < TIER_COUNT; tier++)
+	{
+		if (strcmp(name, TIER_NAMES[tier]) == 0)
+		{
+			return(tier);
+		}
+	}
+	return(-1);
+}
+
+/***********************************************************
+ *  GetLimits()
+ *
+ *  This method is used for getting the limits of a tier.
+ ***********************************************************/
+const PowerPolicy::TIER_LIMITS& PowerPolicy::GetLimits(int tier)
+{
+	return(LIMITS_OF_TIERS[glm::clamp(tier, 0, TIER_COUNT - 1)]);
+}
+
+/***********************************************************
+ *  Update()
+ *
+ *  This method is used for counting the time since the last
+ *  update toward the tier it was spent in and, once the
+ *  poll interval has passed, reading the state again and
+ *  picking the tier from it: the higher of the tiers the
+ *  power and the heat pick, or the forced one.
+ ***********************************************************/
+bool PowerPolicy::Update(double time)
+{
+	if (m_lastTime >= 0.0)
+	{
+		double elapsed = time - m_lastTime;
+		m_stats.tierSeconds[GetTier()] += elapsed;
+		if (m_state.source == SOURCE_BATTERY)
+		{
+			m_stats.batterySeconds += elapsed;
+		}
+	}
+	m_lastTime = time;
+	if ((m_lastPollTime >= 0.0) && ((time - m_lastPollTime) < POLL_SECONDS))
+	{
+		return(false);
+	}
+	m_lastPollTime = time;
+
+	ReadState();
+	m_stats.polls++;
+	if ((m_state.source == SOURCE_BATTERY) && (m_state.batteryPercent >= 0))
+	{
+		if (m_stats.firstBatteryPercent < 0)
+		{
+			m_stats.firstBatteryPercent = m_state.batteryPercent;
+		}
+		m_stats.lastBatteryPercent = m_state.batteryPercent;
+	}
+	m_stats.maxTemperature = glm::max(m_stats.maxTemperature, m_state.temperature);
+	if (m_state.bThrottled == true)
+	{
+		m_stats.throttledPolls++;
+	}
+	m_powerTier = PickPowerTier();
+	m_thermalTier = PickThermalTier();
+
+	int tier = TIER_FULL;
+	if (m_bEnabled == true)
+	{
+		tier = (m_forcedTier >= 0) ? m_forcedTier : glm::max(m_powerTier, m_thermalTier);
+	}
+	if (tier == GetTier())
+	{
+		return(false);
+	}
+	m_tier.store(tier);
+	m_stats.changes++;
+	return(true);
+}
+
+/***********************************************************
+ *  AddFrame()
+ *
+ *  This method is used for counting a frame drawn, or one
+ *  skipped as unchanged, in the current tier.
+ ***********************************************************/
+void PowerPolicy::AddFrame(bool bRendered)
+{
+	if (bRendered == true)
+	{
+		m_stats.framesRendered[GetTier()]++;
+	}
+	else
+	{
+		m_stats.framesSkipped[GetTier()]++;
+	}
+}
+
+/***********************************************************
+ *  PickPowerTier()
+ *
+ *  This method is used for picking the tier of the power
+ *  source: full on AC power, saving on battery, and lowest
+ *  on a low charge or with the battery saver on. A low
+ *  charge holds the lowest tier until it has recovered a
+ *  few percent, as it does while charging.
+ ***********************************************************/
+int PowerPolicy::PickPowerTier() const
+{
+	if (m_state.source != SOURCE_BATTERY)
+	{
+		return((m_state.bBatterySaver == true) ? TIER_SAVE : TIER_FULL);
+	}
+	int lowPercent = (m_powerTier == TIER_LOW) ? RECOVERED_BATTERY_PERCENT : LOW_BATTERY_PERCENT;
+	if ((m_state.bBatterySaver == true) ||
+		((m_state.batteryPercent >= 0) && (m_state.batteryPercent <= lowPercent)))
+	{
+		return(TIER_LOW);
+	}
+	return(TIER_SAVE);
+}
+
+/***********************************************************
+ *  PickThermalTier()
+ *
+ *  This method is used for picking the tier of the heat: a
+ *  throttled processor or a warm zone saves, and a hot one
+ *  takes the lowest tier. Each holds until the temperature
+ *  is the cooling margin below the threshold that raised
+ *  it, so a zone at the threshold does not flip the tier
+ *  every poll.
+ ***********************************************************/
+int PowerPolicy::PickThermalTier() const
+{
+	int tier = (m_state.bThrottled == true) ? TIER_SAVE : TIER_FULL;
+	if (m_state.temperature < 0.0f)
+	{
+		return(tier);
+	}
+	float hotMargin = (m_thermalTier == TIER_LOW) ? COOLING_MARGIN : 0.0f;
+	if (m_state.temperature >= (HOT_TEMPERATURE - hotMargin))
+	{
+		return(TIER_LOW);
+	}
+	float warmMargin = (m_thermalTier >= TIER_SAVE) ? COOLING_MARGIN : 0.0f;
+	if (m_state.temperature >= (WARM_TEMPERATURE - warmMargin))
+	{
+		return(TIER_SAVE);
+	}
+	return(tier);
+}
+
+/***********************************************************
+ *  ReadState()
+ *
+ *  This method is used for reading the power source, the
+ *  charge and the heat. Windows reports the power source,
+ *  the charge and the battery saver, and the processors
+ *  whose clock limit is held below their maximum, but no
+ *  temperature without elevated rights. Linux reports the
+ *  supplies and the thermal zones in sysfs, the hottest
+ *  zone standing for the machine. Whatever is not reported
+ *  is left unknown and picks no tier of its own.
+ ***********************************************************/
+void PowerPolicy::ReadState()
+{
+	m_state.source = SOURCE_UNKNOWN;
+	m_state.batteryPercent = -1;
+	m_state.bBatterySaver = false;
+	m_state.temperature = -1.0f;
+	m_state.bThrottled = false;
+
+#ifdef _WIN32
+	SYSTEM_POWER_STATUS status;
+	if (GetSystemPowerStatus(&status) != FALSE)
+	{
+		// 128 is no battery, and 255 an unknown one
+		bool bBattery = (status.BatteryFlag != 255) && ((status.BatteryFlag & 128) == 0);
+		if (bBattery == true)
+		{
+			if (status.ACLineStatus == 0)
+			{
+				m_state.source = SOURCE_BATTERY;
+			}
+			else if (status.ACLineStatus == 1)
+			{
+				m_state.source = SOURCE_AC;
+			}
+			if (status.BatteryLifePercent != 255)
+			{
+				m_state.batteryPercent = status.BatteryLifePercent;
+			}
+		}
+		m_state.bBatterySaver = (status.SystemStatusFlag == 1);
+	}
+
+	SYSTEM_INFO systemInfo;
+	GetSystemInfo(&systemInfo);
+	std::vector<PROCESSOR_POWER_INFORMATION> processors(systemInfo.dwNumberOfProcessors);
+	if ((processors.empty() == false) &&
+		(CallNtPowerInformation(ProcessorInformation, NULL, 0, processors.data(),
+			(ULONG)(processors.size() * sizeof(PROCESSOR_POWER_INFORMATION))) == 0))
+	{
+		for (size_t i = 0; i < processors.size(); i++)
+		{
+			if ((processors[i].MhzLimit > 0) && (processors[i].MhzLimit < processors[i].MaxMhz))
+			{
+				m_state.bThrottled = true;
+			}
+		}
+	}
+#else
+	bool bBattery = false;
+	bool bDischarging = false;
+	bool bMains = false;
+	bool bMainsOnline = false;
+	std::vector<std::string> supplies = ListEntries("/sys/class/power_supply", "");
+	for (size_t i = 0; i < supplies.size(); i++)
+	{
+		std::string type;
+		std::string value;
+		if (ReadFirstLine(supplies[i] + "/type", type) == false)
+		{
+			continue;
+		}
+		if (type == "Battery")
+		{
+			bBattery = true;
+			if ((ReadFirstLine(supplies[i] + "/status", value) == true) && (value == "Discharging"))
+			{
+				bDischarging = true;
+			}
+			if (ReadFirstLine(supplies[i] + "/capacity", value) == true)
+			{
+				int percent = atoi(value.c_str());
+				m_state.batteryPercent = (m_state.batteryPercent < 0) ? percent : glm::min(m_state.batteryPercent, percent);
+			}
+		}
+		else if (type == "Mains")
+		{
+			bMains = true;
+			if ((ReadFirstLine(supplies[i] + "/online", value) == true) && (atoi(value.c_str()) != 0))
+			{
+				bMainsOnline = true;
+			}
+		}
+	}
+	if (bBattery == true)
+	{
+		m_state.source = ((bDischarging == true) || ((bMains == true) && (bMainsOnline == false))) ?
+			SOURCE_BATTERY : SOURCE_AC;
+	}
+
+	// in thousandths of a degree; zones reading nothing sensible
+	// are left out
+	std::vector<std::string> zones = ListEntries("/sys/class/thermal", "thermal_zone");
+	for (size_t i = 0; i < zones.size(); i++)
+	{
+		std::string value;
+		if (ReadFirstLine(zones[i] + "/temp", value) == true)
+		{
+			float temperature = (float)atof(value.c_str()) / 1000.0f;
+			if ((temperature > 0.0f) && (temperature < 150.0f))
+			{
+				m_state.temperature = glm::max(m_state.temperature, temperature);
+			}
+		}
+	}
+#endif
+}
+
+/***********************************************************
+ *  PrintStats()
+ *
+ *  This method is used for printing the time spent in each
+ *  tier with the frames drawn and skipped in it, and the
+ *  charge used on battery.
+ ***********************************************************/
+void PowerPolicy::PrintStats() const
+{
+	std::cout << "power policy " << ((m_bEnabled == false) ? "off" :
+		(m_forcedTier >= 0) ? GetTierName(m_forcedTier) : "auto")
+		<< "\tpolls " << m_stats.polls
+		<< "\tchanges " << m_stats.changes
+		<< "\tthrottled polls " << m_stats.throttledPolls;
+	if (m_stats.maxTemperature >= 0.0f)
+	{
+		std::cout << "\tmax temperature " << m_stats.maxTemperature << " C";
+	}
+	std::cout << "\n";
+	for (int tier = 0; tier < TIER_COUNT; tier++)
+	{
+		if ((m_stats.framesRendered[tier] + m_stats.framesSkipped[tier]) == 0)
+		{
+			continue;
+		}
+		std::cout << "power tier " << GetTierName(tier)
+			<< "\tseconds " << m_stats.tierSeconds[tier]
+			<< "\tframes drawn " << m_stats.framesRendered[tier]
+			<< "\tskipped " << m_stats.framesSkipped[tier] << "\n";
+	}
+	if (m_stats.batterySeconds > 0.0)
+	{
+		std::cout << "on battery " << m_stats.batterySeconds << " s";
+		if (m_stats.firstBatteryPercent >= 0)
+		{
+			int used = m_stats.firstBatteryPercent - m_stats.lastBatteryPercent;
+			std::cout << "\tcharge " << m_stats.firstBatteryPercent << "% to " << m_stats.lastBatteryPercent << "%";
+			if ((used > 0) && (m_stats.batterySeconds >= 60.0))
+			{
+				std::cout << "\t" << (double)used * 3600.0 / m_stats.batterySeconds << " %/h";
+			}
+		}
+		std::cout << "\n";
+	}
+}
@@ -0,0 +1,144 @@
+///////////////////////////////////////////////////////////////////////////////
+// powerpolicy.h
+// ============
+// frame rate and quality limits following the power source and the heat
+//
+//  A laptop on battery, low on charge or running hot has no use for a
+//  frame rate above what is needed to look smooth. Every few seconds
+//  the power source, the charge and the temperature or throttling the
+//  platform reports are read, and they pick one of three tiers, each
+//  with a frame cap, a render scale, a cap on the post effect tiers
+//  and the shadow filtering, and whether an unchanged scene stops
+//  being drawn. The time spent in each tier, the frames drawn and
+//  skipped in it and the charge used are kept for the stats.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <atomic>
+
+/***********************************************************
+ *  PowerPolicy
+ *
+ *  This class contains the power and thermal state read
+ *  last, the tier it picked and the stats of the run. The
+ *  state is read by Update() on the thread rendering the
+ *  frames, which maps the tier's limits onto the settings;
+ *  the tier alone may be read from any thread.
+ ***********************************************************/
+class PowerPolicy
+{
+public:
+	// constructor
+	PowerPolicy();
+	// destructor
+	~PowerPolicy();
+
+	// limits on the frames, from none to the most saving
+	enum TIER
+	{
+		TIER_FULL = 0,		// on AC power and cool
+		TIER_SAVE,			// on battery, or warm
+		TIER_LOW,			// low on charge, battery saver, or hot
+		TIER_COUNT
+	};
+	static const char* GetTierName(int tier);
+	// tier of a name, -1 for an unknown name
+	static int FindTier(const char* name);
+
+	// what a tier holds the frames to
+	struct TIER_LIMITS
+	{
+		double frameCap;		// frames per second, 0 for no cap
+		float renderScale;		// most of the render scale asked for
+		int postTier;			// PostStack::TIER cap
+		int shadowQuality;		// ShadowAtlas::SHADOW_QUALITY cap
+		int antiAliasingSteps;	// cheaper anti-aliasing modes taken
+		bool bIdleOnDemand;		// no frames while nothing changes
+	};
+	static const TIER_LIMITS& GetLimits(int tier);
+
+	// where the power comes from
+	enum POWER_SOURCE
+	{
+		SOURCE_UNKNOWN = 0,		// no battery reported, as a desktop
+		SOURCE_AC,
+		SOURCE_BATTERY
+	};
+
+	// what the platform reported at the last poll
+	struct POWER_STATE
+	{
+		int source;
+		int batteryPercent;		// -1 when unknown
+		bool bBatterySaver;
+		float temperature;		// hottest zone in degrees C, -1 when unknown
+		bool bThrottled;		// the processor clock held below its maximum
+	};
+
+	// limit the frames by the tier the state picks, or by the tier
+	// given whatever the state is, or not at all; the state is
+	// read either way
+	void SetEnabled(bool bEnabled) { m_bEnabled = bEnabled; }
+	bool IsEnabled() const { return(m_bEnabled); }
+	void SetForcedTier(int tier) { m_forcedTier = tier; }
+
+	// read the state when the poll interval has passed since the
+	// last read and pick the tier; true when the tier changed
+	bool Update(double time);
+	// tier whose limits apply, TIER_FULL while disabled
+	int GetTier() const { return(m_tier.load()); }
+	const TIER_LIMITS& GetActiveLimits() const { return(GetLimits(GetTier())); }
+	const POWER_STATE& GetState() const { return(m_state); }
+
+	// count a frame drawn, or skipped as unchanged, in the tier
+	void AddFrame(bool bRendered);
+
+	// time, frames and charge of the run in each tier
+	struct POLICY_STATS
+	{
+		unsigned long long polls;
+		unsigned long long changes;
+		double tierSeconds[TIER_COUNT];
+		unsigned long long framesRendered[TIER_COUNT];
+		unsigned long long framesSkipped[TIER_COUNT];
+		double batterySeconds;		// time on battery power
+		int firstBatteryPercent;	// charge when first on battery, -1 for never
+		int lastBatteryPercent;
+		float maxTemperature;		// -1 when never known
+		unsigned long long throttledPolls;
+	};
+	const POLICY_STATS& GetStats() const { return(m_stats); }
+	void PrintStats() const;
+
+private:
+	// seconds between reads of the state
+	static const double POLL_SECONDS;
+	// charge at or below which a battery counts as low, and above
+	// which it stops being low again
+	static const int LOW_BATTERY_PERCENT = 20;
+	static const int RECOVERED_BATTERY_PERCENT = 25;
+	// temperatures that raise the tier, and how far below them the
+	// heat must fall to lower it again
+	static const float WARM_TEMPERATURE;
+	static const float HOT_TEMPERATURE;
+	static const float COOLING_MARGIN;
+
+	bool m_bEnabled;
+	int m_forcedTier;
+	std::atomic<int> m_tier;
+	// tiers picked by the power and by the heat alone, each kept
+	// until its state is clear of the threshold that raised it
+	int m_powerTier;
+	int m_thermalTier;
+	POWER_STATE m_state;
+	double m_lastPollTime;
+	double m_lastTime;
+	POLICY_STATS m_stats;
+
+	// read the state from the platform
+	void ReadState();
+	// tier the state picks, from the ones picked before
+	int PickPowerTier() const;
+	int PickThermalTier() const;
+};
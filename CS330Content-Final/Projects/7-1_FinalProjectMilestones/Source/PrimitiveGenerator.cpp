@@ -0,0 +1,130 @@
+///////////////////////////////////////////////////////////////////////////////
+// primitivegenerator.cpp
+// ============
+// generate the vertices of the spheres and tori on the GPU
+//
+//  One dispatch per record, one invocation per vertex; the records
+//  are few, a handful of tessellations per scene.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "PrimitiveGenerator.h"
+
+namespace
+{
+	// work group size declared by the compute shader
+	const GLuint GENERATE_GROUP_SIZE = 64;
+	// storage binding of the arena vertices in the compute shader
+	const GLuint ARENA_VERTICES_BINDING = 0;
+}
+
+/***********************************************************
+ *  PrimitiveGenerator()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+PrimitiveGenerator::PrimitiveGenerator(ShaderManager* pShaderManager)
+{
+	m_pShaderManager = pShaderManager;
+	m_generateProgram = 0;
+	m_shapeLocation = -1;
+	m_baseVertexLocation = -1;
+	m_segmentsLocation = -1;
+	m_thicknessLocation = -1;
+	m_vertexCountLocation = -1;
+}
+
+/***********************************************************
+ *  ~PrimitiveGenerator()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+PrimitiveGenerator::~PrimitiveGenerator()
+{
+	if (0 != m_generateProgram)
+	{
+		glDeleteProgram(m_generateProgram);
+		m_generateProgram = 0;
+	}
+	m_pShaderManager = NULL;
+}
+
+/***********************************************************
+ *  Create()
+ *
+ *  This method is used for building the compute program
+ *  expanding the records, which needs OpenGL 4.3 for
+ *  compute shaders and storage buffers.
+ ***********************************************************/
+bool PrimitiveGenerator::Create(const char* generateShaderPath)
+{
+	if ((NULL == m_pShaderManager) || (GLEW_VERSION_4_3 != GL_TRUE))
+	{
+		return(false);
+	}
+
+	m_generateProgram = m_pShaderManager->LoadComputeShader(generateShaderPath);
+	if (0 == m_generateProgram)
+	{
+		std::cout << "GPU primitive generation disabled, its compute shader did not build" << std::endl;
+		return(false);
+	}
+
+	m_shapeLocation = glGetUniformLocation(m_generateProgram, "shape");
+	m_baseVertexLocation = glGetUniformLocation(m_generateProgram, "baseVertex");
+	m_segmentsLocation = glGetUniformLocation(m_generateProgram, "segments");
+	m_thicknessLocation = glGetUniformLocation(m_generateProgram, "thickness");
+	m_vertexCountLocation = glGetUniformLocation(m_generateProgram, "vertexCount");
+
+	return(true);
+}
+
+/***********************************************************
+ *  GenerateMeshes()
+ *
+ *  This method is used for passing the records ShapeMeshes
+ *  hands its callback on to the generator it was set with.
+ ***********************************************************/
+void PrimitiveGenerator::GenerateMeshes(
+	void* pContext,
+	GLuint vertexBuffer,
+	const std::vector<ShapeMeshes::PROCEDURAL_MESH>& meshes)
+{
+	static_cast<PrimitiveGenerator*>(pContext)->Generate(vertexBuffer, meshes);
+}
+
+/***********************************************************
+ *  Generate()
+ *
+ *  This method is used for dispatching the compute program
+ *  once per record over its vertices. The barrier makes the
+ *  writes visible to the vertex fetch of the draws and to a
+ *  later read back of the buffer.
+ ***********************************************************/
+void PrimitiveGenerator::Generate(
+	GLuint vertexBuffer,
+	const std::vector<ShapeMeshes::PROCEDURAL_MESH>& meshes)
+{
+	if ((IsAvailable() == false) || (0 == vertexBuffer) || (meshes.empty() == true))
+	{
+		return;
+	}
+
+	m_pShaderManager->UseExternalProgram(m_generateProgram);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, ARENA_VERTICES_BINDING, vertexBuffer);
+	for (size_t i = 0; i < meshes.size(); i++)
+	{
+		const ShapeMeshes::PROCEDURAL_MESH& procedural = meshes[i];
+		GLuint vertexCount = (procedural.shape == ShapeMeshes::SHAPE_SPHERE) ?
+			(2 + (procedural.segments[0] - 1) * (procedural.segments[1] + 1)) :
+			((procedural.segments[0] + 1) * (procedural.segments[1] + 1));
+
+		glUniform1ui(m_shapeLocation, procedural.shape);
+		glUniform1ui(m_baseVertexLocation, procedural.baseVertex);
+		glUniform2ui(m_segmentsLocation, procedural.segments[0], procedural.segments[1]);
+		glUniform1f(m_thicknessLocation, procedural.thickness);
+		glUniform1ui(m_vertexCountLocation, vertexCount);
+		glDispatchCompute((vertexCount + GENERATE_GROUP_SIZE - 1) / GENERATE_GROUP_SIZE, 1, 1);
+	}
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, ARENA_VERTICES_BINDING, 0);
+	glMemoryBarrier(GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+}
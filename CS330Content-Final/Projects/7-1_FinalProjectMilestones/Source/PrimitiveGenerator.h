@@ -0,0 +1,56 @@
+///////////////////////////////////////////////////////////////////////////////
+// primitivegenerator.h
+// ============
+// generate the vertices of the spheres and tori on the GPU
+//
+//  ShapeMeshes keeps a small parameter record for each sphere and torus
+//  tessellation instead of writing its vertices, and a compute pass
+//  expands every record into the arena vertex buffer each time the
+//  arena is uploaded, so the CPU only builds their index lists.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "ShaderManager.h"
+#include "ShapeMeshes.h"
+
+#include <vector>
+
+/***********************************************************
+ *  PrimitiveGenerator
+ *
+ *  This class contains the compute program expanding the
+ *  procedural mesh records of ShapeMeshes, and the callback
+ *  ShapeMeshes runs it through.
+ ***********************************************************/
+class PrimitiveGenerator
+{
+public:
+	// constructor
+	PrimitiveGenerator(ShaderManager* pShaderManager);
+	// destructor
+	~PrimitiveGenerator();
+
+	// build the compute program; false when the context has no
+	// compute shaders or the program fails to build
+	bool Create(const char* generateShaderPath);
+	bool IsAvailable() const { return(0 != m_generateProgram); }
+
+	// ShapeMeshes::ProceduralGenerator, with the generator as context
+	static void GenerateMeshes(void* pContext, GLuint vertexBuffer,
+		const std::vector<ShapeMeshes::PROCEDURAL_MESH>& meshes);
+
+private:
+	// pointer to shader manager object
+	ShaderManager* m_pShaderManager;
+	// compute program writing the vertices of one record
+	GLuint m_generateProgram;
+	GLint m_shapeLocation;
+	GLint m_baseVertexLocation;
+	GLint m_segmentsLocation;
+	GLint m_thicknessLocation;
+	GLint m_vertexCountLocation;
+
+	// write the vertices of every record into the vertex buffer
+	void Generate(GLuint vertexBuffer, const std::vector<ShapeMeshes::PROCEDURAL_MESH>& meshes);
+};
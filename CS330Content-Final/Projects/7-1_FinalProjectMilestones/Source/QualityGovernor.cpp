@@ -0,0 +1,339 @@
+///////////////////////////////////////////////////////////////////////////////
+// qualitygovernor.cpp
+// ============
+// one controller trading rendering quality for a frame time target
+//
+//  The CPU and GPU time of every frame and the GPU time of its passes
+//  are weighed against a target. Over it, the governor drops one step
+//  of the first setting in a fixed order that relieves the passes
+//  taking the time; well under it for long enough, it gives back the
+//  last step it took. Every change is kept with the times that led to
+//  it, so a run shows what a machine traded away and when.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "QualityGovernor.h"
+#include "GPUProfiler.h"
+
+#include <glm/glm.hpp>
+
+#include <cstdio>
+
+const float QualityGovernor::TIME_SMOOTHING = 0.1f;
+const float QualityGovernor::DROP_MARGIN = 0.05f;
+const float QualityGovernor::RAISE_FRACTION = 0.8f;
+const float QualityGovernor::MIN_PASS_SHARE = 0.1f;
+
+namespace
+{
+	// names of the LEVER values, for the log and the stats
+	const char* const LEVER_NAMES[QualityGovernor::LEVER_COUNT] =
+	{
+		"post effects",
+		"lod bias",
+		"shadows",
+		"shadow cascades",
+		"anti-aliasing",
+		"render scale"
+	};
+
+	// GPUProfiler passes whose time each lever cuts down; the
+	// anti-aliasing and the render scale weigh on every pass; the
+	// query boxes are timed inside the opaque pass, so never counted
+	const bool LEVER_PASSES[QualityGovernor::LEVER_COUNT][GPUProfiler::PASS_COUNT] =
+	{
+		// shadow, culling, prepass, opaque, query boxes, transparent, post
+		{ false, false, false, false, false, false, true },
+		{ true, false, true, true, false, false, false },
+		{ false, false, false, true, false, true, false },
+		{ true, false, false, true, false, false, false },
+		{ true, true, true, true, false, true, true },
+		{ true, true, true, true, false, true, true }
+	};
+}
+
+/***********************************************************
+ *  QualityGovernor()
+ *
+ *  The constructor for the class. It starts off, every lever
+ *  without steps.
+ ***********************************************************/
+QualityGovernor::QualityGovernor()
+{
+	m_targetMilliseconds = 0.0f;
+	for (int lever = 0; lever < LEVER_COUNT; lever++)
+	{
+		m_steps[lever] = 0;
+		m_levels[lever] = 0;
+	}
+	m_bHasTimes = false;
+	m_cpuMilliseconds = 0.0f;
+	m_gpuMilliseconds = 0.0f;
+	m_frames = 0;
+	m_framesSinceChange = 0;
+	m_framesUnderTarget = 0;
+	m_raiseFrames = RAISE_FRAMES;
+	m_lastRaisedLever = -1;
+	m_lastRaiseFrame = 0;
+	m_cpuBoundFrames = 0;
+}
+
+/***********************************************************
+ *  ~QualityGovernor()
+ *
+ *  The destructor for the class.
+ ***********************************************************/
+QualityGovernor::~QualityGovernor()
+{
+}
+
+/***********************************************************
+ *  GetLeverName()
+ *
+ *  This method is used for getting the name of a lever.
+ ***********************************************************/
+const char* QualityGovernor::GetLeverName(int lever)
+{
+	if ((lever < 0) || (lever >= LEVER_COUNT))
+	{
+		return("unknown");
+	}
+	return(LEVER_NAMES[lever]);
+}
+
+/***********************************************************
+ *  SetTarget()
+ *
+ *  This method is used for setting the frame time to hold.
+ *  Turning the governor off gives back every step at once,
+ *  and a new target starts from fresh measurements.
+ ***********************************************************/
+void QualityGovernor::SetTarget(float targetMilliseconds)
+{
+	m_targetMilliseconds = glm::max(targetMilliseconds, 0.0f);
+	if (IsEnabled() == false)
+	{
+		for (int lever = 0; lever < LEVER_COUNT; lever++)
+		{
+			if (m_levels[lever] > 0)
+			{
+				ChangeLevel(lever, 0);
+			}
+		}
+	}
+	m_bHasTimes = false;
+	m_framesSinceChange = 0;
+	m_framesUnderTarget = 0;
+	m_raiseFrames = RAISE_FRAMES;
+}
+
+/***********************************************************
+ *  SetLeverSteps()
+ *
+ *  This method is used for setting how many steps a lever
+ *  can drop from the setting asked for, which changes when
+ *  that setting does. A level past the new steps is pulled
+ *  back without counting as a decision; the setting it was
+ *  dropped from is gone.
+ ***********************************************************/
+void QualityGovernor::SetLeverSteps(int lever, int steps)
+{
+	if ((lever < 0) || (lever >= LEVER_COUNT))
+	{
+		return;
+	}
+	m_steps[lever] = glm::max(steps, 0);
+	m_levels[lever] = glm::min(m_levels[lever], m_steps[lever]);
+}
+
+/***********************************************************
+ *  GetLeverSteps()
+ *
+ *  This method is used for getting the steps a lever can
+ *  drop.
+ ***********************************************************/
+int QualityGovernor::GetLeverSteps(int lever) const
+{
+	if ((lever < 0) || (lever >= LEVER_COUNT))
+	{
+		return(0);
+	}
+	return(m_steps[lever]);
+}
+
+/***********************************************************
+ *  GetLevel()
+ *
+ *  This method is used for getting the steps a lever is
+ *  dropped by.
+ ***********************************************************/
+int QualityGovernor::GetLevel(int lever) const
+{
+	if ((lever < 0) || (lever >= LEVER_COUNT))
+	{
+		return(0);
+	}
+	return(m_levels[lever]);
+}
+
+/***********************************************************
+ *  AddFrame()
+ *
+ *  This method is used for taking the times of a frame and
+ *  moving a lever when the smoothed times call for it. Over
+ *  the target, a frame whose CPU is the slower side is left
+ *  alone, since every lever cuts GPU work; otherwise the
+ *  first lever in order with a step left and enough of the
+ *  frame in its passes drops a step. Under the target for
+ *  long enough, the last lever in order with a step taken
+ *  gets it back. A step given back that has to be dropped
+ *  again soon after doubles the wait before the next one.
+ ***********************************************************/
+bool QualityGovernor::AddFrame(float cpuMilliseconds, float gpuMilliseconds, const float* passMilliseconds)
+{
+	m_frames++;
+	if (IsEnabled() == false)
+	{
+		return(false);
+	}
+
+	if (m_bHasTimes == false)
+	{
+		m_cpuMilliseconds = cpuMilliseconds;
+		m_gpuMilliseconds = gpuMilliseconds;
+		m_bHasTimes = true;
+	}
+	else
+	{
+		m_cpuMilliseconds += (cpuMilliseconds - m_cpuMilliseconds) * TIME_SMOOTHING;
+		m_gpuMilliseconds += (gpuMilliseconds - m_gpuMilliseconds) * TIME_SMOOTHING;
+	}
+	m_framesSinceChange++;
+	if (m_framesSinceChange < SETTLE_FRAMES)
+	{
+		return(false);
+	}
+
+	float frameMilliseconds = glm::max(m_cpuMilliseconds, m_gpuMilliseconds);
+	if (frameMilliseconds > m_targetMilliseconds * (1.0f + DROP_MARGIN))
+	{
+		m_framesUnderTarget = 0;
+		if (m_cpuMilliseconds > m_gpuMilliseconds)
+		{
+			m_cpuBoundFrames++;
+			return(false);
+		}
+		for (int lever = 0; lever < LEVER_COUNT; lever++)
+		{
+			if ((m_levels[lever] < m_steps[lever]) && (IsLeverUseful(lever, passMilliseconds) == true))
+			{
+				if ((lever == m_lastRaisedLever) && (m_frames - m_lastRaiseFrame < (unsigned long long)m_raiseFrames))
+				{
+					m_raiseFrames = glm::min(m_raiseFrames * 2, (int)MAX_RAISE_FRAMES);
+				}
+				ChangeLevel(lever, m_levels[lever] + 1);
+				return(true);
+			}
+		}
+		return(false);
+	}
+
+	if (frameMilliseconds < m_targetMilliseconds * RAISE_FRACTION)
+	{
+		m_framesUnderTarget++;
+		if (m_framesUnderTarget < m_raiseFrames)
+		{
+			return(false);
+		}
+		for (int lever = LEVER_COUNT - 1; lever >= 0; lever--)
+		{
+			if (m_levels[lever] > 0)
+			{
+				m_lastRaisedLever = lever;
+				m_lastRaiseFrame = m_frames;
+				ChangeLevel(lever, m_levels[lever] - 1);
+				return(true);
+			}
+		}
+		return(false);
+	}
+	m_framesUnderTarget = 0;
+	return(false);
+}
+
+/***********************************************************
+ *  WriteLog()
+ *
+ *  This method is used for writing the decisions, one line
+ *  each after a header, with the level counted in steps
+ *  below the setting asked for.
+ ***********************************************************/
+bool QualityGovernor::WriteLog(const char* filename) const
+{
+	FILE* file = fopen(filename, "wb");
+	if (file == NULL)
+	{
+		return(false);
+	}
+
+	fprintf(file, "# target frame: %g ms\n", m_targetMilliseconds);
+	fprintf(file, "# cpu bound frames: %llu\n", m_cpuBoundFrames);
+	fprintf(file, "frame,lever,from,to,cpu ms,gpu ms\n");
+	for (size_t i = 0; i < m_decisions.size(); i++)
+	{
+		const DECISION& decision = m_decisions[i];
+		fprintf(file, "%llu,%s,%d,%d,%.3f,%.3f\n", decision.frame, GetLeverName(decision.lever),
+			decision.fromLevel, decision.toLevel, decision.cpuMilliseconds, decision.gpuMilliseconds);
+	}
+	bool bWritten = (ferror(file) == 0);
+	fclose(file);
+	return(bWritten);
+}
+
+/***********************************************************
+ *  IsLeverUseful()
+ *
+ *  This method is used for checking that the passes a lever
+ *  cuts down take a fair share of the GPU frame, so a scene
+ *  without post effects does not lose them for nothing. The
+ *  lever is worth trying when the passes went untimed.
+ ***********************************************************/
+bool QualityGovernor::IsLeverUseful(int lever, const float* passMilliseconds) const
+{
+	if ((NULL == passMilliseconds) || (m_gpuMilliseconds <= 0.0f))
+	{
+		return(true);
+	}
+	float milliseconds = 0.0f;
+	for (int pass = 0; pass < GPUProfiler::PASS_COUNT; pass++)
+	{
+		if (LEVER_PASSES[lever][pass] == true)
+		{
+			milliseconds += passMilliseconds[pass];
+		}
+	}
+	return(milliseconds >= m_gpuMilliseconds * MIN_PASS_SHARE);
+}
+
+/***********************************************************
+ *  ChangeLevel()
+ *
+ *  This method is used for moving a lever to a level and
+ *  keeping the decision. The times are measured afresh at
+ *  the new level.
+ ***********************************************************/
+void QualityGovernor::ChangeLevel(int lever, int level)
+{
+	DECISION decision;
+	decision.frame = m_frames;
+	decision.lever = lever;
+	decision.fromLevel = m_levels[lever];
+	decision.toLevel = level;
+	decision.cpuMilliseconds = m_cpuMilliseconds;
+	decision.gpuMilliseconds = m_gpuMilliseconds;
+	m_decisions.push_back(decision);
+
+	m_levels[lever] = level;
+	m_bHasTimes = false;
+	m_framesSinceChange = 0;
+	m_framesUnderTarget = 0;
+}
@@ -0,0 +1,128 @@
+///////////////////////////////////////////////////////////////////////////////
+// qualitygovernor.h
+// ============
+// one controller trading rendering quality for a frame time target
+//
+//  The CPU and GPU time of every frame and the GPU time of its passes
+//  are weighed against a target. Over it, the governor drops one step
+//  of the first setting in a fixed order that relieves the passes
+//  taking the time; well under it for long enough, it gives back the
+//  last step it took. Every change is kept with the times that led to
+//  it, so a run shows what a machine traded away and when.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <vector>
+
+/***********************************************************
+ *  QualityGovernor
+ *
+ *  This class contains the level of every lever, the steps
+ *  it is dropped by from the setting asked for, and the
+ *  smoothed frame times. It only decides; the caller maps
+ *  the levels onto the settings, sets the steps each lever
+ *  has from those asked for, and hands every frame's times
+ *  to AddFrame().
+ ***********************************************************/
+class QualityGovernor
+{
+public:
+	// constructor
+	QualityGovernor();
+	// destructor
+	~QualityGovernor();
+
+	// settings the governor trades away, in the order it drops them;
+	// it gives them back in the opposite order
+	enum LEVER
+	{
+		LEVER_POST_EFFECTS = 0,	// tier cap of the post effects
+		LEVER_LOD_BIAS,			// coarser mesh LOD levels
+		LEVER_SHADOWS,			// fewer shadow filter taps
+		LEVER_SHADOW_CASCADES,	// smaller, then fewer, shadow cascades
+		LEVER_ANTI_ALIASING,	// a cheaper anti-aliasing mode
+		LEVER_RENDER_SCALE,		// fewer pixels
+		LEVER_COUNT
+	};
+	static const char* GetLeverName(int lever);
+
+	// a change of a lever, with the smoothed times that led to it
+	struct DECISION
+	{
+		unsigned long long frame;
+		int lever;
+		int fromLevel;
+		int toLevel;
+		float cpuMilliseconds;
+		float gpuMilliseconds;
+	};
+
+	// frame time to hold in milliseconds; 0 turns the governor off
+	// and gives back every step
+	void SetTarget(float targetMilliseconds);
+	float GetTarget() const { return(m_targetMilliseconds); }
+	bool IsEnabled() const { return(m_targetMilliseconds > 0.0f); }
+
+	// steps a lever can drop from the setting asked for, which the
+	// level is clamped to; 0 leaves the lever alone
+	void SetLeverSteps(int lever, int steps);
+	int GetLeverSteps(int lever) const;
+	// steps a lever is dropped by
+	int GetLevel(int lever) const;
+
+	// take the CPU and GPU time of a frame, and the GPU time of each
+	// GPUProfiler pass or NULL when the passes went untimed, and move
+	// at most one lever; true when a level changed
+	bool AddFrame(float cpuMilliseconds, float gpuMilliseconds, const float* passMilliseconds);
+
+	const std::vector<DECISION>& GetDecisions() const { return(m_decisions); }
+	// frames over the target with the CPU the slower side, which no
+	// lever helps
+	unsigned long long GetCPUBoundFrames() const { return(m_cpuBoundFrames); }
+	// write the decisions as comma separated lines; false when the
+	// file cannot be written
+	bool WriteLog(const char* filename) const;
+
+private:
+	// smoothing of the frame times
+	static const float TIME_SMOOTHING;
+	// frames a level is held before the times measured at it count
+	static const int SETTLE_FRAMES = 30;
+	// frames well under the target before a step is given back, and
+	// the most that grows to after steps that did not hold
+	static const int RAISE_FRAMES = 120;
+	static const int MAX_RAISE_FRAMES = 1920;
+	// share over the target that drops a step, and share of it the
+	// frame must stay under to give one back
+	static const float DROP_MARGIN;
+	static const float RAISE_FRACTION;
+	// share of the GPU frame the passes a lever relieves must take
+	// for the lever to be worth dropping
+	static const float MIN_PASS_SHARE;
+
+	float m_targetMilliseconds;
+	int m_steps[LEVER_COUNT];
+	int m_levels[LEVER_COUNT];
+	// smoothed times since the last change, none after one
+	bool m_bHasTimes;
+	float m_cpuMilliseconds;
+	float m_gpuMilliseconds;
+	unsigned long long m_frames;
+	int m_framesSinceChange;
+	int m_framesUnderTarget;
+	// frames to wait under the target before giving a step back, and
+	// the lever given back last and when, so a step that does not
+	// hold doubles the wait instead of flipping every few frames
+	int m_raiseFrames;
+	int m_lastRaisedLever;
+	unsigned long long m_lastRaiseFrame;
+	unsigned long long m_cpuBoundFrames;
+	std::vector<DECISION> m_decisions;
+
+	// true when the passes a lever relieves take enough of the frame,
+	// or when the passes went untimed
+	bool IsLeverUseful(int lever, const float* passMilliseconds) const;
+	// move a lever by a step and keep the decision
+	void ChangeLevel(int lever, int level);
+};
@@ -0,0 +1,452 @@
+///////////////////////////////////////////////////////////////////////////////
+// reflectionprobes.cpp
+// ============
+// prefiltered cube map reflections of the shiny materials
+//
+//  A probe is a cube map of the scene seen from a point near the glass
+//  and metal surfaces, captured once after the scene is loaded and
+//  again only when its point moves. Every capture is prefiltered into
+//  a mip chain, the sharp reflection at the top and rougher ones
+//  further down, and kept as one cube of a cube map array, so a shiny
+//  surface reflects its surroundings for the cost of a texture fetch
+//  at the level of its roughness. A probe holds the positions within
+//  its reach, and overlapping probes are blended.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "ReflectionProbes.h"
+#include "GPUMemory.h"
+#include "GLTrace.h"
+#include "ShapeMeshes.h"
+#include "Logger.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <cstring>
+
+namespace
+{
+	// near plane of the capture camera, and its far plane without
+	// reverse-Z depth
+	const float CAPTURE_NEAR_PLANE = 0.05f;
+	const float CAPTURE_FAR_PLANE = 100.0f;
+	// mip levels of the capture cube, down to one texel
+	const int CAPTURE_LEVELS = 8;
+	// threads along each side of a prefilter work group, must match
+	// probePrefilterCompute.glsl
+	const int PREFILTER_GROUP_SIZE = 8;
+	// image unit the prefilter writes the probe levels through
+	const int PREFILTER_IMAGE_UNIT = 0;
+
+	// view direction and up vector of the cube faces, in the
+	// +X, -X, +Y, -Y, +Z, -Z layer order of a cube map
+	const glm::vec3 g_FaceDirections[ReflectionProbes::PROBE_FACES] =
+	{
+		glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(-1.0f, 0.0f, 0.0f),
+		glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f),
+		glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 0.0f, -1.0f)
+	};
+	const glm::vec3 g_FaceUps[ReflectionProbes::PROBE_FACES] =
+	{
+		glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f),
+		glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 0.0f, -1.0f),
+		glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f)
+	};
+}
+
+/***********************************************************
+ *  ReflectionProbes()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+ReflectionProbes::ReflectionProbes(ShaderManager* pShaderManager)
+{
+	m_pShaderManager = pShaderManager;
+	m_prefilterProgram = 0;
+	m_probeIndexLocation = -1;
+	m_levelSizeLocation = -1;
+	m_roughnessLocation = -1;
+	m_probeTexture = 0;
+	m_captureTexture = 0;
+	m_captureDepth = 0;
+	m_framebuffer = 0;
+	m_captureProbe = -1;
+	m_captureFace = 0;
+	memset(&m_probeData, 0, sizeof(m_probeData));
+	m_probeData.levels = (GLfloat)(PROBE_LEVELS - 1);
+	m_bProbeDataDirty = true;
+	m_savedFramebuffer = 0;
+	memset(m_savedViewport, 0, sizeof(m_savedViewport));
+	m_savedFrameDataBuffer = 0;
+	m_savedFrameOffset = 0;
+	m_savedFrameSize = 0;
+}
+
+/***********************************************************
+ *  ~ReflectionProbes()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+ReflectionProbes::~ReflectionProbes()
+{
+	if ((NULL != m_pShaderManager) && (0 != m_probeTexture))
+	{
+		m_pShaderManager->BindTexture(PROBE_TEXTURE_UNIT, 0, GL_TEXTURE_CUBE_MAP_ARRAY);
+	}
+	if (0 != m_framebuffer)
+	{
+		glDeleteFramebuffers(1, &m_framebuffer);
+		m_framebuffer = 0;
+	}
+	if (0 != m_captureDepth)
+	{
+		GPUMemory::DeleteRenderbuffers(1, &m_captureDepth);
+		m_captureDepth = 0;
+	}
+	if (0 != m_captureTexture)
+	{
+		GPUMemory::DeleteTextures(1, &m_captureTexture);
+		m_captureTexture = 0;
+	}
+	if (0 != m_probeTexture)
+	{
+		GPUMemory::DeleteTextures(1, &m_probeTexture);
+		m_probeTexture = 0;
+	}
+	m_probeDataBuffer.Destroy();
+	m_frameDataBuffer.Destroy();
+	if (0 != m_prefilterProgram)
+	{
+		glDeleteProgram(m_prefilterProgram);
+		m_prefilterProgram = 0;
+	}
+	m_pShaderManager = NULL;
+}
+
+/***********************************************************
+ *  Create()
+ *
+ *  This method is used for creating the ProbeData block, the
+ *  probe array, the capture target and the prefilter
+ *  program. The block comes first, so the lit shaders read
+ *  no probes even when the rest fails. The prefilter writes
+ *  the levels of the array from a compute shader, which
+ *  came with OpenGL 4.3, so without it there are no probes.
+ ***********************************************************/
+bool ReflectionProbes::Create(const char* prefilterShaderPath)
+{
+	if (NULL == m_pShaderManager)
+	{
+		return(false);
+	}
+
+	// the block is attached to its binding point once, like the
+	// shadow data
+	m_probeDataBuffer.Create(GPUBuffer::USAGE_DYNAMIC, sizeof(PROBE_DATA), &m_probeData,
+		GPUMemory::CATEGORY_BUFFER, "probe data");
+	glBindBufferBase(GL_UNIFORM_BUFFER, ShaderManager::PROBE_DATA_BINDING, m_probeDataBuffer.GetName());
+	m_bProbeDataDirty = false;
+
+	// the lit shaders sample the unit whether or not there are
+	// probes, so it always holds a cube array
+	glGenTextures(1, &m_probeTexture);
+	m_pShaderManager->BindTexture(PROBE_TEXTURE_UNIT, m_probeTexture, GL_TEXTURE_CUBE_MAP_ARRAY);
+	m_pShaderManager->SetActiveTextureUnit(PROBE_TEXTURE_UNIT);
+	glTexStorage3D(GL_TEXTURE_CUBE_MAP_ARRAY, PROBE_LEVELS, GL_RGBA16F, PROBE_SIZE, PROBE_SIZE,
+		MAX_PROBES * PROBE_FACES);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	GPUMemory::TrackTexture(m_probeTexture, GL_RGBA16F, PROBE_SIZE, PROBE_SIZE, MAX_PROBES * PROBE_FACES,
+		PROBE_LEVELS, GPUMemory::CATEGORY_RENDER_TARGET, "reflection probes");
+
+	if (GLEW_VERSION_4_3 != GL_TRUE)
+	{
+		LOG_WARNING("Reflection probes disabled, they need OpenGL 4.3 compute shaders");
+		return(false);
+	}
+	m_prefilterProgram = m_pShaderManager->LoadComputeShader(prefilterShaderPath);
+	if (0 == m_prefilterProgram)
+	{
+		LOG_WARNING("Reflection probes disabled, the prefilter shader did not build");
+		return(false);
+	}
+	m_probeIndexLocation = glGetUniformLocation(m_prefilterProgram, "probeIndex");
+	m_levelSizeLocation = glGetUniformLocation(m_prefilterProgram, "levelSize");
+	m_roughnessLocation = glGetUniformLocation(m_prefilterProgram, "roughness");
+
+	// the faces are drawn into a cube of their own, whose mips the
+	// prefilter reads to keep its sample count low
+	glGenTextures(1, &m_captureTexture);
+	GLuint previousTexture = ShapeMeshes::BindTextureForEdit(GL_TEXTURE_CUBE_MAP, m_captureTexture);
+	glTexStorage2D(GL_TEXTURE_CUBE_MAP, CAPTURE_LEVELS, GL_RGBA16F, PROBE_SIZE, PROBE_SIZE);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	ShapeMeshes::RestoreTextureBinding(GL_TEXTURE_CUBE_MAP, previousTexture);
+	GPUMemory::TrackTexture(m_captureTexture, GL_RGBA16F, PROBE_SIZE, PROBE_SIZE, PROBE_FACES,
+		CAPTURE_LEVELS, GPUMemory::CATEGORY_RENDER_TARGET, "probe capture");
+
+	glGenRenderbuffers(1, &m_captureDepth);
+	glBindRenderbuffer(GL_RENDERBUFFER, m_captureDepth);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT32F, PROBE_SIZE, PROBE_SIZE);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+	GPUMemory::TrackRenderbuffer(m_captureDepth, GL_DEPTH_COMPONENT32F, PROBE_SIZE, PROBE_SIZE, 1,
+		"probe capture depth");
+
+	GLint framebuffer = 0;
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &framebuffer);
+	glGenFramebuffers(1, &m_framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X, m_captureTexture, 0);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, m_captureDepth);
+	bool bComplete = (glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE);
+	glBindFramebuffer(GL_FRAMEBUFFER, (GLuint)framebuffer);
+	if (bComplete == false)
+	{
+		LOG_ERROR("Reflection probes disabled, the capture framebuffer is incomplete");
+		glDeleteProgram(m_prefilterProgram);
+		m_prefilterProgram = 0;
+		return(false);
+	}
+
+	CAPTURE_FRAME_DATA frameData;
+	memset(&frameData, 0, sizeof(frameData));
+	m_frameDataBuffer.Create(GPUBuffer::USAGE_DYNAMIC, sizeof(CAPTURE_FRAME_DATA), &frameData,
+		GPUMemory::CATEGORY_BUFFER, "probe frame data");
+
+	return(true);
+}
+
+/***********************************************************
+ *  SetProbes()
+ *
+ *  This method is used for placing the probes. A probe
+ *  keeps its capture while its sphere stays the same, and
+ *  reads as out of reach until a new capture is done.
+ ***********************************************************/
+void ReflectionProbes::SetProbes(const std::vector<glm::vec4>& probeSpheres)
+{
+	int probeCount = glm::min((int)probeSpheres.size(), (int)MAX_PROBES);
+	if ((int)m_probes.size() != probeCount)
+	{
+		m_probes.resize(probeCount);
+		for (int i = 0; i < probeCount; i++)
+		{
+			m_probes[i].sphere = glm::vec4(0.0f);
+			m_probes[i].bCaptured = false;
+		}
+		m_probeData.count = probeCount;
+		m_bProbeDataDirty = true;
+	}
+
+	for (int i = 0; i < probeCount; i++)
+	{
+		if ((m_probes[i].bCaptured == true) && (m_probes[i].sphere == probeSpheres[i]))
+		{
+			continue;
+		}
+		m_probes[i].sphere = probeSpheres[i];
+		m_probes[i].bCaptured = false;
+		m_probeData.spheres[i] = glm::vec4(glm::vec3(probeSpheres[i]), 0.0f);
+		m_bProbeDataDirty = true;
+		// a capture underway starts over from its first face
+		if (m_captureProbe == i)
+		{
+			m_captureProbe = -1;
+		}
+	}
+	for (int i = probeCount; i < MAX_PROBES; i++)
+	{
+		m_probeData.spheres[i] = glm::vec4(0.0f);
+	}
+}
+
+/***********************************************************
+ *  InvalidateAll()
+ *
+ *  This method is used for capturing every probe again,
+ *  keeping the old captures in use until the new ones are
+ *  done.
+ ***********************************************************/
+void ReflectionProbes::InvalidateAll()
+{
+	for (size_t i = 0; i < m_probes.size(); i++)
+	{
+		m_probes[i].bCaptured = false;
+	}
+	m_captureProbe = -1;
+}
+
+/***********************************************************
+ *  HasPendingCapture()
+ *
+ *  This method is used for finding whether a probe waits
+ *  for its capture.
+ ***********************************************************/
+bool ReflectionProbes::HasPendingCapture() const
+{
+	if (IsAvailable() == false)
+	{
+		return(false);
+	}
+	for (size_t i = 0; i < m_probes.size(); i++)
+	{
+		if (m_probes[i].bCaptured == false)
+		{
+			return(true);
+		}
+	}
+	return(false);
+}
+
+/***********************************************************
+ *  BeginCapture()
+ *
+ *  This method is used for switching to the capture target
+ *  and the FrameData block of the next face of the waiting
+ *  probe, and giving the camera of that face, a 90 degree
+ *  view in the depth convention of the frame. The face is
+ *  cleared with the clear color and depth of the frame.
+ ***********************************************************/
+void ReflectionProbes::BeginCapture(bool bReverseZ, glm::mat4& view, glm::mat4& projection, glm::vec3& position)
+{
+	if ((m_captureProbe < 0) || (m_probes[m_captureProbe].bCaptured == true))
+	{
+		m_captureProbe = -1;
+		for (size_t i = 0; (i < m_probes.size()) && (m_captureProbe < 0); i++)
+		{
+			if (m_probes[i].bCaptured == false)
+			{
+				m_captureProbe = (int)i;
+			}
+		}
+		m_captureFace = 0;
+	}
+
+	position = glm::vec3(m_probes[m_captureProbe].sphere);
+	view = glm::lookAt(position, position + g_FaceDirections[m_captureFace], g_FaceUps[m_captureFace]);
+	if (bReverseZ == true)
+	{
+		// the infinite reverse-Z projection of ViewManager
+		projection = glm::mat4(0.0f);
+		projection[0][0] = 1.0f;
+		projection[1][1] = 1.0f;
+		projection[2][3] = -1.0f;
+		projection[3][2] = CAPTURE_NEAR_PLANE;
+	}
+	else
+	{
+		projection = glm::perspective(glm::radians(90.0f), 1.0f, CAPTURE_NEAR_PLANE, CAPTURE_FAR_PLANE);
+	}
+
+	CAPTURE_FRAME_DATA frameData;
+	frameData.view = view;
+	frameData.projection = projection;
+	frameData.viewPosition = glm::vec4(position, (bReverseZ == true) ? 1.0f : 0.0f);
+	m_frameDataBuffer.Update(0, sizeof(CAPTURE_FRAME_DATA), &frameData);
+
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &m_savedFramebuffer);
+	glGetIntegerv(GL_VIEWPORT, m_savedViewport);
+	glGetIntegeri_v(GL_UNIFORM_BUFFER_BINDING, ShaderManager::FRAME_DATA_BINDING, &m_savedFrameDataBuffer);
+	glGetInteger64i_v(GL_UNIFORM_BUFFER_START, ShaderManager::FRAME_DATA_BINDING, &m_savedFrameOffset);
+	glGetInteger64i_v(GL_UNIFORM_BUFFER_SIZE, ShaderManager::FRAME_DATA_BINDING, &m_savedFrameSize);
+	glBindBufferBase(GL_UNIFORM_BUFFER, ShaderManager::FRAME_DATA_BINDING, m_frameDataBuffer.GetName());
+
+	glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + m_captureFace,
+		m_captureTexture, 0);
+	glViewport(0, 0, PROBE_SIZE, PROBE_SIZE);
+	GLTrace::RecordClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+}
+
+/***********************************************************
+ *  EndCapture()
+ *
+ *  This method is used for going back to the framebuffer,
+ *  viewport and FrameData block of the frame, and
+ *  prefiltering the probe once its last face is drawn.
+ ***********************************************************/
+void ReflectionProbes::EndCapture()
+{
+	glBindFramebuffer(GL_FRAMEBUFFER, (GLuint)m_savedFramebuffer);
+	glViewport(m_savedViewport[0], m_savedViewport[1], m_savedViewport[2], m_savedViewport[3]);
+	if (m_savedFrameSize > 0)
+	{
+		glBindBufferRange(GL_UNIFORM_BUFFER, ShaderManager::FRAME_DATA_BINDING, (GLuint)m_savedFrameDataBuffer,
+			(GLintptr)m_savedFrameOffset, (GLsizeiptr)m_savedFrameSize);
+	}
+	else
+	{
+		glBindBufferBase(GL_UNIFORM_BUFFER, ShaderManager::FRAME_DATA_BINDING, (GLuint)m_savedFrameDataBuffer);
+	}
+
+	m_captureFace++;
+	if (m_captureFace < PROBE_FACES)
+	{
+		return;
+	}
+
+	PrefilterProbe(m_captureProbe);
+	m_probes[m_captureProbe].bCaptured = true;
+	m_probeData.spheres[m_captureProbe] = m_probes[m_captureProbe].sphere;
+	m_bProbeDataDirty = true;
+	m_captureProbe = -1;
+	m_captureFace = 0;
+}
+
+/***********************************************************
+ *  PrefilterProbe()
+ *
+ *  This method is used for filling the levels of a probe
+ *  from the captured cube, one dispatch per level over all
+ *  six faces. The roughness of a level grows evenly from
+ *  none at the top to fully rough at the bottom, which is
+ *  how the lit shaders pick the level of a material.
+ ***********************************************************/
+void ReflectionProbes::PrefilterProbe(int probeIndex)
+{
+	m_pShaderManager->BindTexture(PROBE_TEXTURE_UNIT, m_captureTexture, GL_TEXTURE_CUBE_MAP);
+	m_pShaderManager->SetActiveTextureUnit(PROBE_TEXTURE_UNIT);
+	glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
+
+	m_pShaderManager->UseExternalProgram(m_prefilterProgram);
+	glUniform1i(m_probeIndexLocation, probeIndex);
+	for (int level = 0; level < PROBE_LEVELS; level++)
+	{
+		int levelSize = glm::max(PROBE_SIZE >> level, 1);
+		glUniform1i(m_levelSizeLocation, levelSize);
+		glUniform1f(m_roughnessLocation, (float)level / (float)(PROBE_LEVELS - 1));
+		glBindImageTexture(PREFILTER_IMAGE_UNIT, m_probeTexture, level, GL_TRUE, 0, GL_WRITE_ONLY, GL_RGBA16F);
+		glDispatchCompute(
+			(levelSize + PREFILTER_GROUP_SIZE - 1) / PREFILTER_GROUP_SIZE,
+			(levelSize + PREFILTER_GROUP_SIZE - 1) / PREFILTER_GROUP_SIZE, PROBE_FACES);
+	}
+	glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+
+	m_pShaderManager->BindTexture(PROBE_TEXTURE_UNIT, m_probeTexture, GL_TEXTURE_CUBE_MAP_ARRAY);
+}
+
+/***********************************************************
+ *  Upload()
+ *
+ *  This method is used for writing the ProbeData block with
+ *  a single upload, only when it has changed, and binding
+ *  the probe array for the lit shaders.
+ ***********************************************************/
+void ReflectionProbes::Upload()
+{
+	if (0 != m_probeTexture)
+	{
+		m_pShaderManager->BindTexture(PROBE_TEXTURE_UNIT, m_probeTexture, GL_TEXTURE_CUBE_MAP_ARRAY);
+	}
+	if ((m_probeDataBuffer.IsCreated() == false) || (m_bProbeDataDirty == false))
+	{
+		return;
+	}
+
+	m_probeDataBuffer.Update(0, sizeof(PROBE_DATA), &m_probeData);
+	m_bProbeDataDirty = false;
+}
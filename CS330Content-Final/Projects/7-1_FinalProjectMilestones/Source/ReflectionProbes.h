@@ -0,0 +1,138 @@
+///////////////////////////////////////////////////////////////////////////////
+// reflectionprobes.h
+// ============
+// prefiltered cube map reflections of the shiny materials
+//
+//  A probe is a cube map of the scene seen from a point near the glass
+//  and metal surfaces, captured once after the scene is loaded and
+//  again only when its point moves. Every capture is prefiltered into
+//  a mip chain, the sharp reflection at the top and rougher ones
+//  further down, and kept as one cube of a cube map array, so a shiny
+//  surface reflects its surroundings for the cost of a texture fetch
+//  at the level of its roughness. A probe holds the positions within
+//  its reach, and overlapping probes are blended.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "ShaderManager.h"
+#include "GPUBuffer.h"
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+/***********************************************************
+ *  ReflectionProbes
+ *
+ *  This class contains the probe array, the capture target
+ *  and the prefilter program, and the ProbeData uniform
+ *  block the lit shaders find the probes by. The scene is
+ *  drawn into the capture target one face per call, so a
+ *  capture spreads over six frames.
+ ***********************************************************/
+class ReflectionProbes
+{
+public:
+	// constructor
+	ReflectionProbes(ShaderManager* pShaderManager);
+	// destructor
+	~ReflectionProbes();
+
+	// texture unit the lit shaders read the probes from, the last one
+	// below the cascades
+	static const int PROBE_TEXTURE_UNIT = 14;
+	// side of a probe face at its sharpest level, in texels
+	static const int PROBE_SIZE = 128;
+	// prefiltered levels of a probe, from sharp to fully rough
+	static const int PROBE_LEVELS = 6;
+	// capacity of the ProbeData block, must match the shaders
+	static const int MAX_PROBES = 8;
+	// cube faces per probe
+	static const int PROBE_FACES = 6;
+
+	// make the probe array and the capture target and build the
+	// prefilter program; false without compute shaders or when the
+	// program fails, with the block left saying there are no probes
+	bool Create(const char* prefilterShaderPath);
+	bool IsAvailable() const { return(0 != m_prefilterProgram); }
+
+	// place the probes, one (position, reach) each; a probe that is
+	// new or moved is captured again
+	void SetProbes(const std::vector<glm::vec4>& probeSpheres);
+	int GetProbeCount() const { return((int)m_probes.size()); }
+	// capture every probe again, e.g. after the lights changed
+	void InvalidateAll();
+	// true while some probe waits for its capture
+	bool HasPendingCapture() const;
+
+	// draw the next face of the waiting probe between these, with the
+	// camera matrices BeginCapture() gives the scene; the FrameData
+	// block, framebuffer and viewport are restored after. The probe
+	// is prefiltered once its last face is drawn.
+	void BeginCapture(bool bReverseZ, glm::mat4& view, glm::mat4& projection, glm::vec3& position);
+	void EndCapture();
+
+	// upload the ProbeData block if it changed and bind the array
+	void Upload();
+
+private:
+	// std140 layout of the FrameData block, as ViewManager writes it
+	struct CAPTURE_FRAME_DATA
+	{
+		glm::mat4 view;
+		glm::mat4 projection;
+		glm::vec4 viewPosition;		// w = 1 with reverse-Z depth
+	};
+
+	// std140 layout of the ProbeData block
+	struct PROBE_DATA
+	{
+		glm::vec4 spheres[MAX_PROBES];	// position and reach, 0 until captured
+		GLint count;
+		GLfloat levels;					// prefiltered levels past the sharpest
+		GLfloat padding[2];
+	};
+
+	// a placed probe
+	struct PROBE_ENTRY
+	{
+		glm::vec4 sphere;
+		bool bCaptured;
+	};
+
+	// pointer to shader manager object
+	ShaderManager* m_pShaderManager;
+	// compute program writing one prefiltered level of a probe
+	GLuint m_prefilterProgram;
+	GLint m_probeIndexLocation;
+	GLint m_levelSizeLocation;
+	GLint m_roughnessLocation;
+	// cube map array of the prefiltered probes
+	GLuint m_probeTexture;
+	// cube the scene is drawn into, with the full mip chain the
+	// prefilter reads, and its depth and framebuffer
+	GLuint m_captureTexture;
+	GLuint m_captureDepth;
+	GLuint m_framebuffer;
+	// probe and face the next capture draws
+	int m_captureProbe;
+	int m_captureFace;
+	std::vector<PROBE_ENTRY> m_probes;
+	PROBE_DATA m_probeData;
+	// dynamic, written when a probe is placed or captured
+	GPUBuffer m_probeDataBuffer;
+	bool m_bProbeDataDirty;
+	// FrameData block of the capture camera
+	GPUBuffer m_frameDataBuffer;
+	// framebuffer, viewport and FrameData block to restore after a
+	// capture
+	GLint m_savedFramebuffer;
+	GLint m_savedViewport[4];
+	GLint m_savedFrameDataBuffer;
+	GLint64 m_savedFrameOffset;
+	GLint64 m_savedFrameSize;
+
+	// filter the captured cube into the levels of its probe
+	void PrefilterProbe(int probeIndex);
+};
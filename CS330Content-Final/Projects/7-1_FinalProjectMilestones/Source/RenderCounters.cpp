@@ -0,0 +1,309 @@
+///////////////////////////////////////////////////////////////////////////////
+// rendercounters.cpp
+// ============
+// per-frame render statistics with rolling minimum, average and maximum
+//
+//  ShapeMeshes, ShaderManager and the upload ring count the draws, the
+//  state changes and the bytes uploaded since the start. The counts are
+//  taken at the start and the end of every frame, so each frame gets
+//  its own, and the last frames are kept for their minimum, average and
+//  maximum. Budgets on the counters let an automated run fail when a
+//  frame submitted, or took from the heap, more than it should.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "RenderCounters.h"
+#include "FrameArena.h"
+#include "GPUBuffer.h"
+#include "DirtyRangeBuffer.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+namespace
+{
+	// names of the counters, as --budget takes them
+	const char* const COUNTER_NAMES[RenderCounters::COUNTER_COUNT] =
+	{
+		"draws",
+		"element-draws",
+		"array-draws",
+		"indirect-draws",
+		"instances",
+		"indices",
+		"vertices",
+		"uniforms",
+		"textures",
+		"vaos",
+		"programs",
+		"buffer-bytes",
+		"instance-bytes",
+		"heap-allocations",
+		"buffer-misuses"
+	};
+
+	// counters whose first frames are not held against the peak and
+	// budget, only steady frames are expected to keep at zero
+	const bool COUNTER_SETTLES[RenderCounters::COUNTER_COUNT] =
+	{
+		false, false, false, false, false, false,
+		false, false, false, false, false, false,
+		false, true, false
+	};
+
+	// uniforms listed by upload count in the report
+	const size_t REPORTED_UNIFORMS = 8;
+}
+
+/***********************************************************
+ *  RenderCounters()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+RenderCounters::RenderCounters(ShaderManager* pShaderManager, UploadRing* pUploadRing)
+{
+	m_pShaderManager = pShaderManager;
+	m_pUploadRing = pUploadRing;
+	memset(m_frameStart, 0, sizeof(m_frameStart));
+	memset(m_window, 0, sizeof(m_window));
+	m_windowFrames = 0;
+	m_nextFrame = 0;
+	m_framesCounted = 0;
+	memset(m_peaks, 0, sizeof(m_peaks));
+	for (int i = 0; i < COUNTER_COUNT; i++)
+	{
+		m_budgets[i] = -1;
+	}
+}
+
+/***********************************************************
+ *  ~RenderCounters()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+RenderCounters::~RenderCounters()
+{
+}
+
+/***********************************************************
+ *  GetCounterName()
+ *
+ *  This method is used for getting the name of a counter.
+ ***********************************************************/
+const char* RenderCounters::GetCounterName(int counter)
+{
+	if ((counter < 0) || (counter >= COUNTER_COUNT))
+	{
+		return("unknown");
+	}
+	return(COUNTER_NAMES[counter]);
+}
+
+/***********************************************************
+ *  FindCounter()
+ *
+ *  This method is used for looking up a counter by its name.
+ ***********************************************************/
+int RenderCounters::FindCounter(const char* name)
+{
+	for (int i = 0; i < COUNTER_COUNT; i++)
+	{
+		if (strcmp(COUNTER_NAMES[i], name) == 0)
+		{
+			return(i);
+		}
+	}
+	return(-1);
+}
+
+/***********************************************************
+ *  ReadTotals()
+ *
+ *  This method is used for reading every counter since the
+ *  start from the modules that keep them.
+ ***********************************************************/
+void RenderCounters::ReadTotals(unsigned long long totals[COUNTER_COUNT]) const
+{
+	const ShapeMeshes::BIND_STATS& bindStats = ShapeMeshes::GetBindStats();
+	const ShaderManager::STATE_FILTER_STATS& stateStats = m_pShaderManager->GetStateFilterStats();
+	const UploadRing::UPLOAD_STATS& uploadStats = m_pUploadRing->GetStats();
+
+	totals[COUNTER_DRAW_CALLS] = bindStats.drawCalls;
+	totals[COUNTER_ELEMENT_DRAWS] = bindStats.elementDraws;
+	totals[COUNTER_ARRAY_DRAWS] = bindStats.arrayDraws;
+	totals[COUNTER_INDIRECT_DRAWS] = bindStats.indirectDraws;
+	totals[COUNTER_INSTANCES] = bindStats.instances;
+	totals[COUNTER_INDICES] = bindStats.indices;
+	totals[COUNTER_VERTICES] = bindStats.vertices;
+	totals[COUNTER_UNIFORM_UPLOADS] = stateStats.uniformUploads;
+	totals[COUNTER_TEXTURE_BINDS] = stateStats.textureBinds;
+	totals[COUNTER_VAO_BINDS] = bindStats.vaoBinds;
+	totals[COUNTER_PROGRAM_SWITCHES] = stateStats.programSwitches;
+	totals[COUNTER_BUFFER_BYTES] = uploadStats.bytesWritten + bindStats.bufferBytes +
+		GPUBuffer::GetUpdateBytes();
+	totals[COUNTER_INSTANCE_BYTES] = DirtyRangeBuffer::GetStats().bytes;
+	totals[COUNTER_HEAP_ALLOCATIONS] = FrameArena::GetHeapAllocations();
+	totals[COUNTER_BUFFER_MISUSES] = GPUBuffer::GetMisuses();
+}
+
+/***********************************************************
+ *  BeginFrame()
+ *
+ *  This method is used for taking the counts the frame
+ *  starts from.
+ ***********************************************************/
+void RenderCounters::BeginFrame()
+{
+	ReadTotals(m_frameStart);
+}
+
+/***********************************************************
+ *  EndFrame()
+ *
+ *  This method is used for storing what the frame added to
+ *  every counter in the window, over its oldest frame. The
+ *  counters that settle only raise their peak after the
+ *  warm-up frames.
+ ***********************************************************/
+void RenderCounters::EndFrame()
+{
+	unsigned long long totals[COUNTER_COUNT];
+	ReadTotals(totals);
+
+	unsigned long long* frame = m_window[m_nextFrame];
+	for (int i = 0; i < COUNTER_COUNT; i++)
+	{
+		frame[i] = totals[i] - m_frameStart[i];
+		if ((COUNTER_SETTLES[i] == false) || (m_framesCounted >= (unsigned long long)WARMUP_FRAMES))
+		{
+			m_peaks[i] = (frame[i] > m_peaks[i]) ? frame[i] : m_peaks[i];
+		}
+	}
+	m_nextFrame = (m_nextFrame + 1) % WINDOW_FRAMES;
+	m_windowFrames = (m_windowFrames < WINDOW_FRAMES) ? m_windowFrames + 1 : WINDOW_FRAMES;
+	m_framesCounted++;
+}
+
+/***********************************************************
+ *  GetSummary()
+ *
+ *  This method is used for getting the last count of a
+ *  counter and its minimum, average and maximum over the
+ *  frames of the window.
+ ***********************************************************/
+RenderCounters::COUNTER_SUMMARY RenderCounters::GetSummary(int counter) const
+{
+	COUNTER_SUMMARY summary = {};
+	if (m_windowFrames == 0)
+	{
+		return(summary);
+	}
+
+	int last = (m_nextFrame + WINDOW_FRAMES - 1) % WINDOW_FRAMES;
+	summary.last = m_window[last][counter];
+	summary.minimum = summary.last;
+	summary.maximum = summary.last;
+	unsigned long long total = 0;
+	for (int i = 0; i < m_windowFrames; i++)
+	{
+		unsigned long long count = m_window[i][counter];
+		summary.minimum = (count < summary.minimum) ? count : summary.minimum;
+		summary.maximum = (count > summary.maximum) ? count : summary.maximum;
+		total += count;
+	}
+	summary.average = (double)total / (double)m_windowFrames;
+
+	return(summary);
+}
+
+/***********************************************************
+ *  GetLast()
+ *
+ *  This method is used for getting the count of a counter
+ *  in the last frame, 0 before the first.
+ ***********************************************************/
+unsigned long long RenderCounters::GetLast(int counter) const
+{
+	if (m_windowFrames == 0)
+	{
+		return(0);
+	}
+	return(m_window[(m_nextFrame + WINDOW_FRAMES - 1) % WINDOW_FRAMES][counter]);
+}
+
+/***********************************************************
+ *  ParseBudget()
+ *
+ *  This method is used for setting the budget of a counter
+ *  from text of the form name=value.
+ ***********************************************************/
+bool RenderCounters::ParseBudget(const char* text)
+{
+	const char* equals = strchr(text, '=');
+	if (equals == NULL)
+	{
+		return(false);
+	}
+
+	std::string name(text, equals - text);
+	int counter = FindCounter(name.c_str());
+	if (counter < 0)
+	{
+		return(false);
+	}
+	SetBudget(counter, atoll(equals + 1));
+	return(true);
+}
+
+/***********************************************************
+ *  IsWithinBudgets()
+ *
+ *  This method is used for checking the busiest frame of
+ *  every counter with a budget against it.
+ ***********************************************************/
+bool RenderCounters::IsWithinBudgets() const
+{
+	for (int i = 0; i < COUNTER_COUNT; i++)
+	{
+		if ((m_budgets[i] >= 0) && (m_peaks[i] > (unsigned long long)m_budgets[i]))
+		{
+			return(false);
+		}
+	}
+	return(true);
+}
+
+/***********************************************************
+ *  Print()
+ *
+ *  This method is used for printing every counter over the
+ *  window with its peak and budget, and the uniforms sent
+ *  most often.
+ ***********************************************************/
+void RenderCounters::Print() const
+{
+	std::cout << "\n*** RENDER COUNTERS: ***\n";
+	std::cout << "frames counted " << m_framesCounted << "\tlast " << m_windowFrames << " shown\n";
+	for (int i = 0; i < COUNTER_COUNT; i++)
+	{
+		COUNTER_SUMMARY summary = GetSummary(i);
+		std::cout << COUNTER_NAMES[i]
+			<< "\tmin " << summary.minimum
+			<< "\tavg " << summary.average
+			<< "\tmax " << summary.maximum
+			<< "\tpeak " << m_peaks[i];
+		if (m_budgets[i] >= 0)
+		{
+			std::cout << "\tbudget " << m_budgets[i]
+				<< ((m_peaks[i] > (unsigned long long)m_budgets[i]) ? " EXCEEDED" : " ok");
+		}
+		std::cout << "\n";
+	}
+
+	std::vector<std::pair<std::string, unsigned long long> > uniformCounts;
+	m_pShaderManager->GetUniformUploadCounts(uniformCounts);
+	for (size_t i = 0; (i < uniformCounts.size()) && (i < REPORTED_UNIFORMS); i++)
+	{
+		std::cout << "uniform " << uniformCounts[i].first << "\tuploads " << uniformCounts[i].second << "\n";
+	}
+}
@@ -0,0 +1,117 @@
+///////////////////////////////////////////////////////////////////////////////
+// rendercounters.h
+// ============
+// per-frame render statistics with rolling minimum, average and maximum
+//
+//  ShapeMeshes, ShaderManager and the upload ring count the draws, the
+//  state changes and the bytes uploaded since the start. The counts are
+//  taken at the start and the end of every frame, so each frame gets
+//  its own, and the last frames are kept for their minimum, average and
+//  maximum. Budgets on the counters let an automated run fail when a
+//  frame submitted, or took from the heap, more than it should.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "ShaderManager.h"
+#include "ShapeMeshes.h"
+#include "UploadRing.h"
+
+/***********************************************************
+ *  RenderCounters
+ *
+ *  This class contains the counts of the last frames and a
+ *  budget for each counter. BeginFrame() and EndFrame()
+ *  bracket the part of the frame that is counted.
+ ***********************************************************/
+class RenderCounters
+{
+public:
+	// constructor
+	RenderCounters(ShaderManager* pShaderManager, UploadRing* pUploadRing);
+	// destructor
+	~RenderCounters();
+
+	// what is counted per frame
+	enum COUNTER
+	{
+		COUNTER_DRAW_CALLS = 0,
+		COUNTER_ELEMENT_DRAWS,		// glDrawElements* calls
+		COUNTER_ARRAY_DRAWS,		// glDrawArrays* calls
+		COUNTER_INDIRECT_DRAWS,		// glMultiDraw*Indirect calls
+		COUNTER_INSTANCES,
+		COUNTER_INDICES,			// indices of the direct indexed draws
+		COUNTER_VERTICES,			// vertices of the direct array draws
+		COUNTER_UNIFORM_UPLOADS,
+		COUNTER_TEXTURE_BINDS,
+		COUNTER_VAO_BINDS,
+		COUNTER_PROGRAM_SWITCHES,
+		COUNTER_BUFFER_BYTES,		// upload ring, mesh and buffer update bytes
+		COUNTER_INSTANCE_BYTES,		// of those, the changed instances copied
+		COUNTER_HEAP_ALLOCATIONS,	// operator new calls of every thread
+		COUNTER_BUFFER_MISUSES,		// updates more often than the buffer usage
+		COUNTER_COUNT
+	};
+
+	// frames the minimum, average and maximum are taken over
+	static const int WINDOW_FRAMES = 120;
+	// first frames left out of the peak of the counters that settle,
+	// while the pools, caches and arenas grow to the scene
+	static const int WARMUP_FRAMES = 60;
+
+	// a counter over the frames of the window
+	struct COUNTER_SUMMARY
+	{
+		unsigned long long last;
+		unsigned long long minimum;
+		unsigned long long maximum;
+		double average;
+	};
+
+	// take the counts at the start and the end of a frame
+	void BeginFrame();
+	void EndFrame();
+
+	// the counter over the window, zero before the first frame
+	COUNTER_SUMMARY GetSummary(int counter) const;
+	// the counter in the last frame
+	unsigned long long GetLast(int counter) const;
+	// most of a counter in any frame since the start
+	unsigned long long GetPeak(int counter) const { return(m_peaks[counter]); }
+	unsigned long long GetFramesCounted() const { return(m_framesCounted); }
+
+	// fail the budget check when a frame's count goes over the
+	// budget; a negative budget is none
+	void SetBudget(int counter, long long budget) { m_budgets[counter] = budget; }
+	long long GetBudget(int counter) const { return(m_budgets[counter]); }
+	// set a budget from "name=value", as --budget gives it; false
+	// for an unknown counter
+	bool ParseBudget(const char* text);
+	// true when no frame went over a budget
+	bool IsWithinBudgets() const;
+
+	// name of a counter, as in the budgets, and the counter of a
+	// name, -1 for none
+	static const char* GetCounterName(int counter);
+	static int FindCounter(const char* name);
+
+	// print the counters and the budgets for the exit report
+	void Print() const;
+
+private:
+	// pointer to shader manager object
+	ShaderManager* m_pShaderManager;
+	UploadRing* m_pUploadRing;
+	// counts at BeginFrame(), since the start
+	unsigned long long m_frameStart[COUNTER_COUNT];
+	// counts of the frames of the window, a ring of WINDOW_FRAMES
+	unsigned long long m_window[WINDOW_FRAMES][COUNTER_COUNT];
+	int m_windowFrames;
+	int m_nextFrame;
+	unsigned long long m_framesCounted;
+	unsigned long long m_peaks[COUNTER_COUNT];
+	long long m_budgets[COUNTER_COUNT];
+
+	// every counter since the start
+	void ReadTotals(unsigned long long totals[COUNTER_COUNT]) const;
+};
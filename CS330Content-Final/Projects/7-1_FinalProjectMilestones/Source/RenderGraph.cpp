@@ -0,0 +1,840 @@
+///////////////////////////////////////////////////////////////////////////////
+// rendergraph.cpp
+// ============
+// passes of a frame ordered by the resources they read and write
+//
+//  Every pass of the frame declares the resources it reads and writes
+//  before any of them runs. The graph then drops the passes whose
+//  results nothing uses, orders the rest so passes drawing into the
+//  same framebuffer follow each other, and takes the transient render
+//  targets from a pool, handing one texture to several targets whose
+//  lifetimes in the frame do not overlap. The framebuffers of the
+//  passes are cached by their attachments and only bound on a change.
+//  The passes, their code and the lists of the frame live in the frame
+//  arena, so declaring a frame takes nothing from the heap.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "RenderGraph.h"
+#include "GPUMemory.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+namespace
+{
+	/***********************************************************
+	 *  IsDepthFormat()
+	 *
+	 *  This function is used for telling the depth formats,
+	 *  which attach as the depth of a framebuffer, from the
+	 *  color ones.
+	 ***********************************************************/
+	bool IsDepthFormat(GLenum internalFormat)
+	{
+		return((internalFormat == GL_DEPTH_COMPONENT16) ||
+			(internalFormat == GL_DEPTH_COMPONENT24) ||
+			(internalFormat == GL_DEPTH_COMPONENT32) ||
+			(internalFormat == GL_DEPTH_COMPONENT32F) ||
+			(internalFormat == GL_DEPTH24_STENCIL8) ||
+			(internalFormat == GL_DEPTH32F_STENCIL8));
+	}
+
+	/***********************************************************
+	 *  HasStencil()
+	 *
+	 *  This function is used for telling the depth formats
+	 *  that carry a stencil as well.
+	 ***********************************************************/
+	bool HasStencil(GLenum internalFormat)
+	{
+		return((internalFormat == GL_DEPTH24_STENCIL8) ||
+			(internalFormat == GL_DEPTH32F_STENCIL8));
+	}
+}
+
+/***********************************************************
+ *  RenderGraph()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+RenderGraph::RenderGraph(ShaderManager* pShaderManager)
+{
+	m_pShaderManager = pShaderManager;
+	m_width = 0;
+	m_height = 0;
+	m_stats.passes = 0;
+	m_stats.culledPasses = 0;
+	m_stats.transientTargets = 0;
+	m_stats.pooledTextures = 0;
+	m_stats.framebufferBinds = 0;
+	m_stats.framebufferSkips = 0;
+	m_stats.texturesCreated = 0;
+}
+
+/***********************************************************
+ *  ~RenderGraph()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+RenderGraph::~RenderGraph()
+{
+	ReleasePool();
+	m_pShaderManager = NULL;
+}
+
+/***********************************************************
+ *  Reset()
+ *
+ *  This method is used for starting the graph of a frame.
+ *  The pooled textures and framebuffers are kept for the
+ *  targets of the new frame.
+ ***********************************************************/
+void RenderGraph::Reset(int width, int height)
+{
+	m_width = width;
+	m_height = height;
+	m_resources.clear();
+	m_passes.clear();
+	m_schedule.clear();
+}
+
+/***********************************************************
+ *  ImportFramebuffer()
+ *
+ *  This method is used for declaring a framebuffer owned
+ *  outside the graph, which the passes writing it draw
+ *  into. Its contents outlive the frame, so those passes
+ *  are kept.
+ ***********************************************************/
+int RenderGraph::ImportFramebuffer(const char* name, GLuint framebuffer)
+{
+	RESOURCE resource;
+	resource.name = name;
+	resource.internalFormat = GL_NONE;
+	resource.framebuffer = framebuffer;
+	resource.width = 0;
+	resource.height = 0;
+	resource.samples = 1;
+	resource.poolIndex = -1;
+	resource.firstUse = -1;
+	resource.lastUse = -1;
+	m_resources.push_back(resource);
+	return((int)m_resources.size() - 1);
+}
+
+/***********************************************************
+ *  CreateTexture()
+ *
+ *  This method is used for declaring a transient target of
+ *  the frame size over a divisor. It gets a texture only
+ *  when a pass that is kept uses it, and only from its
+ *  first to its last use, so the texture is undefined
+ *  before the first pass writing it. A multisampled target
+ *  is only drawn into and resolved, never sampled.
+ ***********************************************************/
+int RenderGraph::CreateTexture(const char* name, GLenum internalFormat, int divisor, int samples)
+{
+	divisor = std::max(divisor, 1);
+	RESOURCE resource;
+	resource.name = name;
+	resource.internalFormat = internalFormat;
+	resource.framebuffer = 0;
+	resource.width = std::max(m_width / divisor, 1);
+	resource.height = std::max(m_height / divisor, 1);
+	resource.samples = std::max(samples, 1);
+	resource.poolIndex = -1;
+	resource.firstUse = -1;
+	resource.lastUse = -1;
+	m_resources.push_back(resource);
+	return((int)m_resources.size() - 1);
+}
+
+/***********************************************************
+ *  AddPass()
+ *
+ *  This method is used for declaring a pass of the frame.
+ *  A pass writes either imported framebuffers or transient
+ *  targets, which become the attachments of its
+ *  framebuffer in the order they are written, the depth
+ *  target aside.
+ ***********************************************************/
+int RenderGraph::AddPass(const char* name, PASS_FUNCTION execute)
+{
+	PASS pass;
+	pass.name = name;
+	pass.execute = execute;
+	pass.bLive = false;
+	pass.framebuffer = 0;
+	pass.viewportWidth = 0;
+	pass.viewportHeight = 0;
+	m_passes.push_back(pass);
+	return((int)m_passes.size() - 1);
+}
+
+/***********************************************************
+ *  Read()
+ *
+ *  This method is used for declaring a resource a pass
+ *  reads, so it runs after the passes writing it before.
+ ***********************************************************/
+void RenderGraph::Read(int pass, int resource)
+{
+	if ((pass < 0) || (pass >= (int)m_passes.size()) ||
+		(resource < 0) || (resource >= (int)m_resources.size()))
+	{
+		return;
+	}
+	m_passes[pass].reads.push_back(resource);
+}
+
+/***********************************************************
+ *  Write()
+ *
+ *  This method is used for declaring a resource a pass
+ *  writes, so it runs after the passes using it before.
+ ***********************************************************/
+void RenderGraph::Write(int pass, int resource)
+{
+	if ((pass < 0) || (pass >= (int)m_passes.size()) ||
+		(resource < 0) || (resource >= (int)m_resources.size()))
+	{
+		return;
+	}
+	m_passes[pass].writes.push_back(resource);
+}
+
+/***********************************************************
+ *  AddResolvePass()
+ *
+ *  This method is used for adding a pass that blits the
+ *  multisampled color and depth targets into the target
+ *  written, averaging the color samples; the depth takes
+ *  one sample of each pixel. The depth formats must match,
+ *  and the target covers the viewport of its pass.
+ ***********************************************************/
+int RenderGraph::AddResolvePass(const char* name, int color, int depth, int target)
+{
+	int pass = AddPass(name, [this, color, depth]()
+		{
+			GLint viewport[4] = { 0, 0, 0, 0 };
+			glGetIntegerv(GL_VIEWPORT, viewport);
+			GLint passFramebuffer = 0;
+			glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &passFramebuffer);
+
+			const RESOURCE& source = m_resources[color];
+			glBindFramebuffer(GL_READ_FRAMEBUFFER, GetFramebuffer(color));
+			glBlitFramebuffer(0, 0, source.width, source.height,
+				viewport[0], viewport[1], viewport[0] + viewport[2], viewport[1] + viewport[3],
+				GL_COLOR_BUFFER_BIT, GL_NEAREST);
+			if (depth >= 0)
+			{
+				glBlitFramebuffer(0, 0, source.width, source.height,
+					viewport[0], viewport[1], viewport[0] + viewport[2], viewport[1] + viewport[3],
+					GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+			}
+			glBindFramebuffer(GL_READ_FRAMEBUFFER, (GLuint)passFramebuffer);
+		});
+	Read(pass, color);
+	if (depth >= 0)
+	{
+		Read(pass, depth);
+	}
+	Write(pass, target);
+	return(pass);
+}
+
+/***********************************************************
+ *  Execute()
+ *
+ *  This method is used for running the passes of the frame:
+ *  the unused ones are dropped, the rest ordered and given
+ *  their targets, and each runs with its framebuffer bound.
+ *  A pass drawing into the framebuffer already bound skips
+ *  the bind. The viewport covers the targets of a pass, or
+ *  is the one of the caller for an imported framebuffer,
+ *  and the framebuffer and viewport of the caller are set
+ *  again at the end.
+ ***********************************************************/
+void RenderGraph::Execute()
+{
+	CullPasses();
+	SchedulePasses();
+	AllocateTextures();
+	ResolveFramebuffers();
+
+	GLint callerFramebuffer = 0;
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &callerFramebuffer);
+	GLint boundFramebuffer = callerFramebuffer;
+	GLint callerViewport[4] = { 0, 0, 0, 0 };
+	glGetIntegerv(GL_VIEWPORT, callerViewport);
+	GLint viewport[4] = { callerViewport[0], callerViewport[1], callerViewport[2], callerViewport[3] };
+	for (size_t i = 0; i < m_schedule.size(); i++)
+	{
+		PASS& pass = m_passes[m_schedule[i]];
+		GLint passViewport[4] = { callerViewport[0], callerViewport[1], callerViewport[2], callerViewport[3] };
+		if (pass.viewportWidth > 0)
+		{
+			passViewport[0] = 0;
+			passViewport[1] = 0;
+			passViewport[2] = pass.viewportWidth;
+			passViewport[3] = pass.viewportHeight;
+		}
+		if (memcmp(viewport, passViewport, sizeof(viewport)) != 0)
+		{
+			glViewport(passViewport[0], passViewport[1], passViewport[2], passViewport[3]);
+			memcpy(viewport, passViewport, sizeof(viewport));
+		}
+		if (pass.framebuffer != (GLuint)boundFramebuffer)
+		{
+			glBindFramebuffer(GL_FRAMEBUFFER, pass.framebuffer);
+			boundFramebuffer = (GLint)pass.framebuffer;
+			m_stats.framebufferBinds++;
+		}
+		else
+		{
+			m_stats.framebufferSkips++;
+		}
+		// the targets of the pass are read back through its
+		// framebuffer from now on
+		for (size_t w = 0; w < pass.writes.size(); w++)
+		{
+			RESOURCE& resource = m_resources[pass.writes[w]];
+			if (resource.internalFormat != GL_NONE)
+			{
+				resource.framebuffer = pass.framebuffer;
+			}
+		}
+		pass.execute();
+	}
+	if (boundFramebuffer != callerFramebuffer)
+	{
+		glBindFramebuffer(GL_FRAMEBUFFER, (GLuint)callerFramebuffer);
+		m_stats.framebufferBinds++;
+	}
+	if (memcmp(viewport, callerViewport, sizeof(viewport)) != 0)
+	{
+		glViewport(callerViewport[0], callerViewport[1], callerViewport[2], callerViewport[3]);
+	}
+
+	TrimPool();
+}
+
+/***********************************************************
+ *  GetTexture()
+ *
+ *  This method is used for finding the texture holding a
+ *  transient target while the passes run; 0 for an
+ *  imported framebuffer or a target of a dropped pass.
+ ***********************************************************/
+GLuint RenderGraph::GetTexture(int resource) const
+{
+	if ((resource < 0) || (resource >= (int)m_resources.size()) ||
+		(m_resources[resource].poolIndex < 0))
+	{
+		return(0);
+	}
+	return(m_pool[m_resources[resource].poolIndex].texture);
+}
+
+/***********************************************************
+ *  GetFramebuffer()
+ *
+ *  This method is used for finding the framebuffer of an
+ *  imported target, or the framebuffer a transient target
+ *  was last drawn into by the passes run so far, for
+ *  reading it back; 0 before any pass drew it.
+ ***********************************************************/
+GLuint RenderGraph::GetFramebuffer(int resource) const
+{
+	if ((resource < 0) || (resource >= (int)m_resources.size()))
+	{
+		return(0);
+	}
+	return(m_resources[resource].framebuffer);
+}
+
+/***********************************************************
+ *  CullPasses()
+ *
+ *  This method is used for keeping the passes whose writes
+ *  reach an imported framebuffer, walking back from the
+ *  last pass. A kept pass needs what it reads from the
+ *  passes before it, and what it writes as well, since it
+ *  may draw over their results instead of replacing them.
+ ***********************************************************/
+void RenderGraph::CullPasses()
+{
+	FrameVector<unsigned char> needed(m_resources.size(), 0);
+	for (size_t i = 0; i < m_resources.size(); i++)
+	{
+		needed[i] = (m_resources[i].internalFormat == GL_NONE) ? 1 : 0;
+	}
+
+	m_stats.passes = (int)m_passes.size();
+	m_stats.culledPasses = 0;
+	for (int p = (int)m_passes.size() - 1; p >= 0; p--)
+	{
+		PASS& pass = m_passes[p];
+		pass.bLive = false;
+		for (size_t i = 0; i < pass.writes.size(); i++)
+		{
+			if (needed[pass.writes[i]] != 0)
+			{
+				pass.bLive = true;
+				break;
+			}
+		}
+		if (pass.bLive == false)
+		{
+			m_stats.culledPasses++;
+			continue;
+		}
+		for (size_t i = 0; i < pass.reads.size(); i++)
+		{
+			needed[pass.reads[i]] = 1;
+		}
+		for (size_t i = 0; i < pass.writes.size(); i++)
+		{
+			needed[pass.writes[i]] = 1;
+		}
+	}
+}
+
+/***********************************************************
+ *  SchedulePasses()
+ *
+ *  This method is used for ordering the kept passes. A pass
+ *  depends on the last pass writing what it reads or
+ *  writes, and a writing pass also on the passes reading
+ *  the earlier contents. Of the passes whose dependencies
+ *  ran, the one drawing into the same targets as the pass
+ *  before goes first, then the one declared first, so the
+ *  declared order is kept wherever nothing is gained.
+ ***********************************************************/
+void RenderGraph::SchedulePasses()
+{
+	const size_t passCount = m_passes.size();
+	FrameVector<FrameVector<int> > successors(passCount);
+	FrameVector<int> dependencies(passCount, 0);
+	FrameVector<int> lastWriter(m_resources.size(), -1);
+	FrameVector<FrameVector<int> > readers(m_resources.size());
+
+	for (size_t p = 0; p < passCount; p++)
+	{
+		const PASS& pass = m_passes[p];
+		if (pass.bLive == false)
+		{
+			continue;
+		}
+		for (size_t i = 0; i < pass.reads.size(); i++)
+		{
+			int resource = pass.reads[i];
+			if ((lastWriter[resource] >= 0) && (lastWriter[resource] != (int)p))
+			{
+				successors[lastWriter[resource]].push_back((int)p);
+				dependencies[p]++;
+			}
+			readers[resource].push_back((int)p);
+		}
+		for (size_t i = 0; i < pass.writes.size(); i++)
+		{
+			int resource = pass.writes[i];
+			if ((lastWriter[resource] >= 0) && (lastWriter[resource] != (int)p))
+			{
+				successors[lastWriter[resource]].push_back((int)p);
+				dependencies[p]++;
+			}
+			for (size_t r = 0; r < readers[resource].size(); r++)
+			{
+				if (readers[resource][r] != (int)p)
+				{
+					successors[readers[resource][r]].push_back((int)p);
+					dependencies[p]++;
+				}
+			}
+			readers[resource].clear();
+			lastWriter[resource] = (int)p;
+		}
+	}
+
+	FrameVector<int> ready;
+	ready.reserve(passCount);
+	for (size_t p = 0; p < passCount; p++)
+	{
+		if ((m_passes[p].bLive == true) && (dependencies[p] == 0))
+		{
+			ready.push_back((int)p);
+		}
+	}
+
+	m_schedule.clear();
+	while (ready.empty() == false)
+	{
+		// ready stays sorted by declaration, so the first one is the
+		// fallback
+		size_t pick = 0;
+		if (m_schedule.empty() == false)
+		{
+			const PASS& previous = m_passes[m_schedule.back()];
+			for (size_t i = 0; i < ready.size(); i++)
+			{
+				if (SharesTarget(m_passes[ready[i]], previous) == true)
+				{
+					pick = i;
+					break;
+				}
+			}
+		}
+
+		int p = ready[pick];
+		ready.erase(ready.begin() + pick);
+		m_schedule.push_back(p);
+		for (size_t i = 0; i < successors[p].size(); i++)
+		{
+			int next = successors[p][i];
+			dependencies[next]--;
+			if (dependencies[next] == 0)
+			{
+				ready.insert(std::upper_bound(ready.begin(), ready.end(), next), next);
+			}
+		}
+	}
+}
+
+/***********************************************************
+ *  AllocateTextures()
+ *
+ *  This method is used for giving every transient target of
+ *  the kept passes a texture of the pool, from the pass
+ *  using it first to the pass using it last. A texture of
+ *  the same format and size whose last target was done with
+ *  it by then is taken again, so targets that do not live
+ *  at the same time share their memory; otherwise a new one
+ *  joins the pool.
+ ***********************************************************/
+void RenderGraph::AllocateTextures()
+{
+	for (size_t i = 0; i < m_resources.size(); i++)
+	{
+		m_resources[i].poolIndex = -1;
+		m_resources[i].firstUse = -1;
+		m_resources[i].lastUse = -1;
+	}
+	for (int position = 0; position < (int)m_schedule.size(); position++)
+	{
+		const PASS& pass = m_passes[m_schedule[position]];
+		for (int list = 0; list < 2; list++)
+		{
+			const FrameVector<int>& resources = (list == 0) ? pass.reads : pass.writes;
+			for (size_t i = 0; i < resources.size(); i++)
+			{
+				RESOURCE& resource = m_resources[resources[i]];
+				if (resource.firstUse < 0)
+				{
+					resource.firstUse = position;
+				}
+				resource.lastUse = position;
+			}
+		}
+	}
+
+	for (size_t i = 0; i < m_pool.size(); i++)
+	{
+		m_pool[i].busyUntil = -1;
+	}
+
+	m_stats.transientTargets = 0;
+	m_stats.pooledTextures = 0;
+	for (int position = 0; position < (int)m_schedule.size(); position++)
+	{
+		for (size_t r = 0; r < m_resources.size(); r++)
+		{
+			RESOURCE& resource = m_resources[r];
+			if ((resource.internalFormat == GL_NONE) || (resource.firstUse != position))
+			{
+				continue;
+			}
+			m_stats.transientTargets++;
+
+			for (size_t i = 0; i < m_pool.size(); i++)
+			{
+				const POOL_TEXTURE& pooled = m_pool[i];
+				if ((pooled.internalFormat == resource.internalFormat) &&
+					(pooled.width == resource.width) && (pooled.height == resource.height) &&
+					(pooled.samples == resource.samples) && (pooled.busyUntil < position))
+				{
+					resource.poolIndex = (int)i;
+					break;
+				}
+			}
+
+			if (resource.poolIndex < 0)
+			{
+				// create on a unit of its own, so the bindings of the
+				// scene textures stay what the shader manager expects
+				POOL_TEXTURE pooled;
+				glGenTextures(1, &pooled.texture);
+				if (resource.samples > 1)
+				{
+					// the samples are counted as layers of the memory
+					m_pShaderManager->BindTexture(CREATE_TEXTURE_UNIT, pooled.texture, GL_TEXTURE_2D_MULTISAMPLE);
+					m_pShaderManager->SetActiveTextureUnit(CREATE_TEXTURE_UNIT);
+					glTexStorage2DMultisample(GL_TEXTURE_2D_MULTISAMPLE, resource.samples, resource.internalFormat,
+						resource.width, resource.height, GL_TRUE);
+					GPUMemory::TrackTexture(pooled.texture, resource.internalFormat, resource.width, resource.height,
+						resource.samples, 1, GPUMemory::CATEGORY_RENDER_TARGET, "render graph");
+				}
+				else
+				{
+					m_pShaderManager->BindTexture(CREATE_TEXTURE_UNIT, pooled.texture);
+					m_pShaderManager->SetActiveTextureUnit(CREATE_TEXTURE_UNIT);
+					glTexStorage2D(GL_TEXTURE_2D, 1, resource.internalFormat, resource.width, resource.height);
+					GPUMemory::TrackTexture(pooled.texture, resource.internalFormat, resource.width, resource.height, 1, 1,
+						GPUMemory::CATEGORY_RENDER_TARGET, "render graph");
+					glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+					glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+					glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+					glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+				}
+				pooled.internalFormat = resource.internalFormat;
+				pooled.width = resource.width;
+				pooled.height = resource.height;
+				pooled.samples = resource.samples;
+				pooled.busyUntil = -1;
+				pooled.idleFrames = 0;
+				m_pool.push_back(pooled);
+				resource.poolIndex = (int)m_pool.size() - 1;
+				m_stats.texturesCreated++;
+			}
+
+			POOL_TEXTURE& pooled = m_pool[resource.poolIndex];
+			if (pooled.busyUntil < 0)
+			{
+				m_stats.pooledTextures++;
+			}
+			pooled.busyUntil = resource.lastUse;
+			pooled.idleFrames = 0;
+		}
+	}
+}
+
+/***********************************************************
+ *  ResolveFramebuffers()
+ *
+ *  This method is used for finding the framebuffer of each
+ *  kept pass: the imported one it writes, or the cached
+ *  framebuffer attaching its transient targets.
+ ***********************************************************/
+void RenderGraph::ResolveFramebuffers()
+{
+	for (size_t i = 0; i < m_schedule.size(); i++)
+	{
+		PASS& pass = m_passes[m_schedule[i]];
+		pass.framebuffer = 0;
+		pass.viewportWidth = 0;
+		pass.viewportHeight = 0;
+
+		FrameVector<GLuint> attachments;
+		GLuint depthTexture = 0;
+		for (size_t w = 0; w < pass.writes.size(); w++)
+		{
+			const RESOURCE& resource = m_resources[pass.writes[w]];
+			if (resource.internalFormat == GL_NONE)
+			{
+				pass.framebuffer = resource.framebuffer;
+			}
+			else
+			{
+				pass.viewportWidth = resource.width;
+				pass.viewportHeight = resource.height;
+				if (IsDepthFormat(resource.internalFormat) == true)
+				{
+					depthTexture = GetTexture(pass.writes[w]);
+				}
+				else
+				{
+					attachments.push_back(GetTexture(pass.writes[w]));
+				}
+			}
+		}
+		if ((attachments.empty() == false) || (0 != depthTexture))
+		{
+			attachments.push_back(depthTexture);
+			pass.framebuffer = FindFramebuffer(attachments);
+		}
+	}
+}
+
+/***********************************************************
+ *  FindFramebuffer()
+ *
+ *  This method is used for finding the cached framebuffer
+ *  with the given attachments, the color targets in order
+ *  and the depth last, creating it the first time. The
+ *  binding of the caller is restored.
+ ***********************************************************/
+GLuint RenderGraph::FindFramebuffer(const FrameVector<GLuint>& attachments)
+{
+	for (size_t i = 0; i < m_framebuffers.size(); i++)
+	{
+		const std::vector<GLuint>& cached = m_framebuffers[i].attachments;
+		if ((cached.size() == attachments.size()) &&
+			(std::equal(cached.begin(), cached.end(), attachments.begin()) == true))
+		{
+			return(m_framebuffers[i].framebuffer);
+		}
+	}
+
+	GLint previousFramebuffer = 0;
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previousFramebuffer);
+
+	FRAMEBUFFER_ENTRY entry;
+	entry.attachments.assign(attachments.begin(), attachments.end());
+	glGenFramebuffers(1, &entry.framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, entry.framebuffer);
+
+	std::vector<GLenum> drawBuffers;
+	const size_t colorCount = attachments.size() - 1;
+	for (size_t i = 0; i < colorCount; i++)
+	{
+		glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + (GLenum)i, attachments[i], 0);
+		drawBuffers.push_back(GL_COLOR_ATTACHMENT0 + (GLenum)i);
+	}
+	GLuint depthTexture = attachments[colorCount];
+	if (0 != depthTexture)
+	{
+		GLenum depthFormat = GL_NONE;
+		for (size_t i = 0; i < m_pool.size(); i++)
+		{
+			if (m_pool[i].texture == depthTexture)
+			{
+				depthFormat = m_pool[i].internalFormat;
+				break;
+			}
+		}
+		glFramebufferTexture(GL_FRAMEBUFFER,
+			(HasStencil(depthFormat) == true) ? GL_DEPTH_STENCIL_ATTACHMENT : GL_DEPTH_ATTACHMENT,
+			depthTexture, 0);
+	}
+
+	if (drawBuffers.empty() == true)
+	{
+		glDrawBuffer(GL_NONE);
+	}
+	else
+	{
+		glDrawBuffers((GLsizei)drawBuffers.size(), &drawBuffers[0]);
+	}
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+	{
+		std::cout << "Render graph framebuffer is incomplete" << std::endl;
+	}
+
+	glBindFramebuffer(GL_FRAMEBUFFER, (GLuint)previousFramebuffer);
+	m_framebuffers.push_back(entry);
+	return(entry.framebuffer);
+}
+
+/***********************************************************
+ *  TrimPool()
+ *
+ *  This method is used for deleting the pooled textures no
+ *  target took for a while, as after the window was resized
+ *  or a pass was turned off, along with the framebuffers
+ *  attaching them.
+ ***********************************************************/
+void RenderGraph::TrimPool()
+{
+	size_t kept = 0;
+	for (size_t i = 0; i < m_pool.size(); i++)
+	{
+		POOL_TEXTURE& pooled = m_pool[i];
+		if (pooled.busyUntil < 0)
+		{
+			pooled.idleFrames++;
+		}
+		if (pooled.idleFrames <= POOL_IDLE_FRAMES)
+		{
+			m_pool[kept++] = pooled;
+			continue;
+		}
+
+		for (size_t f = 0; f < m_framebuffers.size(); )
+		{
+			const std::vector<GLuint>& attachments = m_framebuffers[f].attachments;
+			if (std::find(attachments.begin(), attachments.end(), pooled.texture) != attachments.end())
+			{
+				glDeleteFramebuffers(1, &m_framebuffers[f].framebuffer);
+				m_framebuffers.erase(m_framebuffers.begin() + f);
+				continue;
+			}
+			f++;
+		}
+		// deleting a texture unbinds it from every unit
+		GLuint texture = pooled.texture;
+		GPUMemory::DeleteTextures(1, &texture);
+		m_pShaderManager->ForgetTexture(texture);
+	}
+	m_pool.resize(kept);
+
+	// the pool indices of this frame's targets moved
+	for (size_t i = 0; i < m_resources.size(); i++)
+	{
+		m_resources[i].poolIndex = -1;
+	}
+}
+
+/***********************************************************
+ *  ReleasePool()
+ *
+ *  This method is used for deleting every pooled texture and
+ *  cached framebuffer, as when the context goes away.
+ ***********************************************************/
+void RenderGraph::ReleasePool()
+{
+	for (size_t f = 0; f < m_framebuffers.size(); f++)
+	{
+		glDeleteFramebuffers(1, &m_framebuffers[f].framebuffer);
+	}
+	m_framebuffers.clear();
+
+	for (size_t i = 0; i < m_pool.size(); i++)
+	{
+		GLuint texture = m_pool[i].texture;
+		GPUMemory::DeleteTextures(1, &texture);
+		if (NULL != m_pShaderManager)
+		{
+			m_pShaderManager->ForgetTexture(texture);
+		}
+	}
+	m_pool.clear();
+
+	for (size_t i = 0; i < m_resources.size(); i++)
+	{
+		m_resources[i].poolIndex = -1;
+	}
+}
+
+/***********************************************************
+ *  SharesTarget()
+ *
+ *  This method is used for checking that two passes write
+ *  the same resources, so the second can run without a
+ *  framebuffer bind.
+ ***********************************************************/
+bool RenderGraph::SharesTarget(const PASS& pass, const PASS& otherPass) const
+{
+	if ((pass.writes.empty() == true) || (pass.writes.size() != otherPass.writes.size()))
+	{
+		return(false);
+	}
+	for (size_t i = 0; i < pass.writes.size(); i++)
+	{
+		if (std::find(otherPass.writes.begin(), otherPass.writes.end(), pass.writes[i]) == otherPass.writes.end())
+		{
+			return(false);
+		}
+	}
+	return(true);
+}
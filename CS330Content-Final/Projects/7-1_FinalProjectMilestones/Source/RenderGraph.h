@@ -0,0 +1,184 @@
+///////////////////////////////////////////////////////////////////////////////
+// rendergraph.h
+// ============
+// passes of a frame ordered by the resources they read and write
+//
+//  Every pass of the frame declares the resources it reads and writes
+//  before any of them runs. The graph then drops the passes whose
+//  results nothing uses, orders the rest so passes drawing into the
+//  same framebuffer follow each other, and takes the transient render
+//  targets from a pool, handing one texture to several targets whose
+//  lifetimes in the frame do not overlap. The framebuffers of the
+//  passes are cached by their attachments and only bound on a change.
+//  The passes, their code and the lists of the frame live in the frame
+//  arena, so declaring a frame takes nothing from the heap.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "ShaderManager.h"
+#include "FrameArena.h"
+
+#include <vector>
+
+/***********************************************************
+ *  RenderGraph
+ *
+ *  This class contains the passes and resources declared
+ *  for the current frame, and the pooled textures and
+ *  cached framebuffers that outlive it. Reset() starts a
+ *  frame, the passes are added with the resources they
+ *  read and write, and Execute() culls, orders, allocates
+ *  and runs them. A pass draws into the framebuffer of the
+ *  targets it writes, which the graph binds before calling
+ *  it; GetTexture() finds the texture of a transient target
+ *  while the passes run.
+ ***********************************************************/
+class RenderGraph
+{
+public:
+	// constructor
+	RenderGraph(ShaderManager* pShaderManager);
+	// destructor
+	~RenderGraph();
+
+	// texture unit the pooled textures are created on, above the
+	// units the scene and its passes sample from
+	static const int CREATE_TEXTURE_UNIT = 28;
+
+	// code of a pass, run on the GL thread, held in the frame arena
+	typedef FrameFunction PASS_FUNCTION;
+
+	// what the graph did in the last frame, and in all frames
+	struct GRAPH_STATS
+	{
+		int passes;					// passes declared in the last frame
+		int culledPasses;			// of those, dropped as unused
+		int transientTargets;		// transient targets of the last frame
+		int pooledTextures;			// textures holding them
+		unsigned long long framebufferBinds;	// all frames
+		unsigned long long framebufferSkips;	// binds left out all frames
+		unsigned long long texturesCreated;		// all frames
+	};
+
+	// forget the passes and resources of the last frame and start
+	// one of the given size, the size of the transient targets
+	void Reset(int width, int height);
+	// a framebuffer the frame draws into that the graph does not own,
+	// as the scene target; passes writing it are never culled
+	int ImportFramebuffer(const char* name, GLuint framebuffer);
+	// a target of the frame size, divided by the divisor for the
+	// effects run at a lower resolution, living only while the
+	// frame uses it; with several samples it is multisampled
+	int CreateTexture(const char* name, GLenum internalFormat, int divisor = 1, int samples = 1);
+	// add a pass, which runs after the earlier passes whose resources
+	// it reads or writes; the code is copied into the frame arena of
+	// the calling thread, and so must capture nothing with a destructor
+	int AddPass(const char* name, PASS_FUNCTION execute);
+	template<typename F>
+	int AddPass(const char* name, const F& execute)
+	{
+		return(AddPass(name, PASS_FUNCTION(FrameArena::ForThread(), execute)));
+	}
+	void Read(int pass, int resource);
+	void Write(int pass, int resource);
+	// add a pass averaging the samples of multisampled color and
+	// depth targets into another target; depth -1 for none
+	int AddResolvePass(const char* name, int color, int depth, int target);
+	// cull, order, allocate and run the passes of the frame
+	void Execute();
+
+	// texture of a transient target while the passes run
+	GLuint GetTexture(int resource) const;
+	// framebuffer of an imported target, or the one a transient
+	// target was last drawn into while the passes run
+	GLuint GetFramebuffer(int resource) const;
+	// free the pooled textures and framebuffers
+	void ReleasePool();
+
+	const GRAPH_STATS& GetStats() const { return(m_stats); }
+
+private:
+	// executions of the graph a pooled texture is kept while no
+	// target takes it
+	static const int POOL_IDLE_FRAMES = 8;
+
+	// names are kept as given, string literals
+	struct RESOURCE
+	{
+		const char* name;
+		GLenum internalFormat;	// GL_NONE for an imported framebuffer
+		// imported framebuffer, or the last one drawing the target
+		GLuint framebuffer;
+		int width;				// size of a transient target
+		int height;
+		int samples;			// 1 unless multisampled
+		int poolIndex;			// texture of a transient target, -1 before allocation
+		// schedule position of the first and last live pass using it
+		int firstUse;
+		int lastUse;
+	};
+
+	struct PASS
+	{
+		const char* name;
+		PASS_FUNCTION execute;
+		FrameVector<int> reads;
+		FrameVector<int> writes;
+		bool bLive;
+		GLuint framebuffer;		// bound before the pass runs
+		// viewport of its transient targets, 0 by 0 to keep the one
+		// of the caller
+		int viewportWidth;
+		int viewportHeight;
+	};
+
+	struct POOL_TEXTURE
+	{
+		GLuint texture;
+		GLenum internalFormat;
+		int width;
+		int height;
+		int samples;
+		// schedule position after which it is free this frame, -1
+		// while no target holds it
+		int busyUntil;
+		int idleFrames;
+	};
+
+	struct FRAMEBUFFER_ENTRY
+	{
+		GLuint framebuffer;
+		// color attachments in order, then the depth, 0 for none
+		std::vector<GLuint> attachments;
+	};
+
+	// pointer to shader manager object
+	ShaderManager* m_pShaderManager;
+	int m_width;
+	int m_height;
+	std::vector<RESOURCE> m_resources;
+	std::vector<PASS> m_passes;
+	// live passes in the order they run
+	std::vector<int> m_schedule;
+	std::vector<POOL_TEXTURE> m_pool;
+	std::vector<FRAMEBUFFER_ENTRY> m_framebuffers;
+	GRAPH_STATS m_stats;
+
+	// mark the passes contributing to an imported target
+	void CullPasses();
+	// order the live passes by their dependencies
+	void SchedulePasses();
+	// give every transient target a pooled texture
+	void AllocateTextures();
+	// find the framebuffer of each live pass
+	void ResolveFramebuffers();
+	// the cached framebuffer with the attachments, created if missing
+	GLuint FindFramebuffer(const FrameVector<GLuint>& attachments);
+	// delete the pooled textures unused for a while, and the
+	// framebuffers attaching them
+	void TrimPool();
+	// true when two passes write the same targets, so they draw
+	// into the same framebuffer
+	bool SharesTarget(const PASS& pass, const PASS& otherPass) const;
+};
@@ -0,0 +1,705 @@
+///////////////////////////////////////////////////////////////////////////////
+// renderservice.cpp
+// ============
+// render requests taken over a local socket, answered with encoded images
+//
+//  The application runs headless as a long-lived service, its scene
+//  loaded once and kept resident across the requests. Clients connect
+//  to a TCP port of the loopback interface and send requests a line
+//  each, naming the camera, the image size and a quality preset; the
+//  requests waiting are taken so that those of the same size and
+//  quality follow each other, which keeps the targets and the passes
+//  of one batch from being rebuilt between its frames. Each request
+//  takes one frame, read back and encoded by the frame capture
+//  pipeline while the next ones render, and is answered with its PNG.
+//  The wait, render and total time of every request are kept, for the
+//  stats line a client may ask for and the report written at the end.
+//
+//  A request line is
+//    render <name> <scene> <x> <y> <z> <tx> <ty> <tz> <zoom> <width>x<height> <quality>
+//  with the camera at x y z looking at tx ty tz, the zoom the field
+//  of view in degrees, the scene - or the name of the one resident,
+//  and the quality draft, preview or final. It is answered with
+//    image <name> <width> <height> <bytes> <wait ms> <render ms>
+//  and the bytes of the PNG file, or with error <name> <reason>. The
+//  line stats is answered with the counters, and quit ends the
+//  service.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "RenderService.h"
+#include "NetSocket.h"
+#include "ViewManager.h"
+#include "ScopeProfiler.h"
+#include "Logger.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+
+namespace
+{
+	const uintptr_t NO_SOCKET = NetSocket::INVALID_HANDLE;
+
+	// longest the thread blocks on the sockets before checking
+	// whether the service stops
+	const long POLL_MICROSECONDS = 100000;
+	// requests waiting beyond which more are refused
+	const size_t MAX_PENDING_REQUESTS = 1024;
+	// requests of one size and quality taken in a row while older
+	// ones of another wait
+	const int MAX_BATCH_REQUESTS = 16;
+	// largest side of an image, and longest line a client may send
+	const int MAX_IMAGE_SIDE = 8192;
+	const size_t MAX_LINE_BYTES = 4096;
+	// field of view a request may ask for, in degrees
+	const float MIN_ZOOM = 1.0f;
+	const float MAX_ZOOM = 120.0f;
+
+	// names of the qualities in the requests and the settings of
+	// each, by RenderService::QUALITY
+	const char* const QUALITY_NAMES[RenderService::QUALITY_COUNT] = { "draft", "preview", "final" };
+	const int QUALITY_SHADOWS[RenderService::QUALITY_COUNT] = {
+		ShadowAtlas::SHADOW_QUALITY_LOW, ShadowAtlas::SHADOW_QUALITY_MEDIUM, ShadowAtlas::SHADOW_QUALITY_HIGH };
+	const int QUALITY_FILTERS[RenderService::QUALITY_COUNT] = {
+		TextureTable::FILTER_QUALITY_BILINEAR, TextureTable::FILTER_QUALITY_TRILINEAR, TextureTable::FILTER_QUALITY_ANISOTROPIC_16X };
+	// the temporal mode needs frames before it, which a request does
+	// not have
+	const int QUALITY_ANTI_ALIASING[RenderService::QUALITY_COUNT] = {
+		PostStack::AA_NONE, PostStack::AA_FXAA, PostStack::AA_MSAA_8X };
+
+	double NowSeconds()
+	{
+		return(std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count());
+	}
+}
+
+/***********************************************************
+ *  RenderService()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+RenderService::RenderService()
+{
+	m_listenSocket = NO_SOCKET;
+	m_bStopping = false;
+	m_bQuitRequested = false;
+	m_nextClientId = 1;
+	m_nextRequestId = 1;
+	m_batchWidth = 0;
+	m_batchHeight = 0;
+	m_batchQuality = -1;
+	m_batchLength = 0;
+	memset(&m_stats, 0, sizeof(m_stats));
+}
+
+/***********************************************************
+ *  ~RenderService()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+RenderService::~RenderService()
+{
+	Stop();
+}
+
+/***********************************************************
+ *  Start()
+ *
+ *  This method is used for opening the port, on the
+ *  loopback interface only since the requests are not
+ *  authenticated, and starting the thread taking the
+ *  clients and their requests.
+ ***********************************************************/
+bool RenderService::Start(int port, const char* scenePath)
+{
+	Stop();
+
+	if (NetSocket::Startup() == false)
+	{
+		LOG_ERROR("Could not start the sockets for the render service");
+		return(false);
+	}
+	uintptr_t listenSocket = NetSocket::Listen(port, true);
+	if (listenSocket == NO_SOCKET)
+	{
+		LOG_ERROR("Could not listen for render requests on port %d", port);
+		NetSocket::Cleanup();
+		return(false);
+	}
+
+	// a request names the scene by its file name or its path
+	m_scenePath = scenePath;
+	size_t slash = m_scenePath.find_last_of("/\\");
+	m_sceneName = (slash == std::string::npos) ? m_scenePath : m_scenePath.substr(slash + 1);
+
+	m_listenSocket = listenSocket;
+	m_bStopping = false;
+	m_bQuitRequested = false;
+	m_receiveThread = std::thread(&RenderService::ReceiveLoop, this);
+	LOG_INFO("Taking render requests for %s on port %d", m_sceneName.c_str(), port);
+	return(true);
+}
+
+/***********************************************************
+ *  Stop()
+ *
+ *  This method is used for ending the thread and closing
+ *  the clients and the port. The requests still waiting
+ *  are dropped with their clients.
+ ***********************************************************/
+void RenderService::Stop()
+{
+	if (m_listenSocket == NO_SOCKET)
+	{
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_bStopping = true;
+	}
+	m_requestQueued.notify_all();
+	m_receiveThread.join();
+
+	while (m_clients.empty() == false)
+	{
+		CloseClient(m_clients.size() - 1);
+	}
+	NetSocket::Close(m_listenSocket);
+	m_listenSocket = NO_SOCKET;
+	NetSocket::Cleanup();
+}
+
+/***********************************************************
+ *  WaitForRequest()
+ *
+ *  This method is used for sleeping while nothing waits,
+ *  woken by a request, a quit or the stop.
+ ***********************************************************/
+bool RenderService::WaitForRequest(double seconds)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	return(m_requestQueued.wait_for(lock, std::chrono::duration<double>(seconds), [this]() {
+		return((m_pending.empty() == false) || (m_bQuitRequested.load() == true) || (m_bStopping.load() == true));
+	}));
+}
+
+/***********************************************************
+ *  NextRequest()
+ *
+ *  This method is used for taking the request to render
+ *  next. A request of the size and quality of the batch
+ *  running goes first, however late it arrived, since it
+ *  renders without resizing the targets or switching the
+ *  passes; the batch is cut after MAX_BATCH_REQUESTS, so
+ *  the older requests of another wait at most that long.
+ ***********************************************************/
+bool RenderService::NextRequest(RENDER_REQUEST& request)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (m_pending.empty() == true)
+	{
+		return(false);
+	}
+
+	size_t pick = 0;
+	if (m_batchLength < MAX_BATCH_REQUESTS)
+	{
+		for (size_t i = 0; i < m_pending.size(); i++)
+		{
+			if ((m_pending[i].width == m_batchWidth) && (m_pending[i].height == m_batchHeight) &&
+				(m_pending[i].quality == m_batchQuality))
+			{
+				pick = i;
+				break;
+			}
+		}
+	}
+	request = m_pending[pick];
+	m_pending.erase(m_pending.begin() + pick);
+
+	if ((request.width != m_batchWidth) || (request.height != m_batchHeight) ||
+		(request.quality != m_batchQuality))
+	{
+		m_batchWidth = request.width;
+		m_batchHeight = request.height;
+		m_batchQuality = request.quality;
+		m_batchLength = 0;
+		m_stats.batches++;
+	}
+	m_batchLength++;
+
+	request.renderTime = NowSeconds();
+	m_inFlight[request.id] = request;
+	return(true);
+}
+
+/***********************************************************
+ *  HasRequestsInFlight()
+ *
+ *  This method is used for telling whether images are still
+ *  being read back or encoded, which the main loop polls
+ *  the capture for while no request waits.
+ ***********************************************************/
+bool RenderService::HasRequestsInFlight() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return(m_inFlight.empty() == false);
+}
+
+/***********************************************************
+ *  FailRequest()
+ *
+ *  This method is used for answering a request taken that
+ *  could not be rendered with an error.
+ ***********************************************************/
+void RenderService::FailRequest(const RENDER_REQUEST& request, const char* reason)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_inFlight.erase(request.id);
+		m_stats.rejected++;
+	}
+	SendToClient(request.clientId, "error " + request.name + " " + reason + "\n", NULL);
+}
+
+/***********************************************************
+ *  ApplyQuality()
+ *
+ *  This method is used for setting the shadows, texture
+ *  filtering and anti-aliasing of a quality preset.
+ ***********************************************************/
+void RenderService::ApplyQuality(ViewManager* pViewManager, int quality)
+{
+	quality = std::min(std::max(quality, 0), (int)QUALITY_COUNT - 1);
+	pViewManager->SetShadowQuality(QUALITY_SHADOWS[quality]);
+	pViewManager->SetTextureFilterQuality(QUALITY_FILTERS[quality]);
+	pViewManager->SetAntiAliasing(QUALITY_ANTI_ALIASING[quality]);
+}
+
+/***********************************************************
+ *  ImageSink()
+ *
+ *  This method is used for answering a request with its
+ *  encoded image, on the encoder thread that encoded it,
+ *  and timing it. The answer of a client that left is
+ *  dropped, and so is a tag no request is waiting for.
+ ***********************************************************/
+void RenderService::ImageSink(void* pContext, const std::vector<unsigned char>& image,
+	int width, int height, uint32_t tag)
+{
+	RenderService* pService = (RenderService*)pContext;
+	RENDER_REQUEST request;
+	double now = NowSeconds();
+	{
+		std::lock_guard<std::mutex> lock(pService->m_mutex);
+		std::map<uint32_t, RENDER_REQUEST>::iterator found = pService->m_inFlight.find(tag);
+		if (found == pService->m_inFlight.end())
+		{
+			return;
+		}
+		request = found->second;
+		pService->m_inFlight.erase(found);
+	}
+
+	char line[512];
+	snprintf(line, sizeof(line), "image %s %d %d %zu %.3f %.3f\n", request.name.c_str(), width, height,
+		image.size(), (request.renderTime - request.receivedTime) * 1000.0, (now - request.renderTime) * 1000.0);
+	bool bSent = pService->SendToClient(request.clientId, line, &image);
+	now = NowSeconds();
+
+	REQUEST_RECORD record;
+	record.name = request.name;
+	record.width = width;
+	record.height = height;
+	record.quality = request.quality;
+	record.bytes = image.size();
+	record.waitSeconds = request.renderTime - request.receivedTime;
+	record.renderSeconds = now - request.renderTime;
+	record.totalSeconds = now - request.receivedTime;
+
+	std::lock_guard<std::mutex> lock(pService->m_mutex);
+	SERVICE_STATS& stats = pService->m_stats;
+	stats.completed++;
+	stats.waitSeconds += record.waitSeconds;
+	stats.renderSeconds += record.renderSeconds;
+	stats.totalSeconds += record.totalSeconds;
+	stats.totalMaxSeconds = std::max(stats.totalMaxSeconds, record.totalSeconds);
+	stats.lastCompletedTime = now;
+	if (bSent == true)
+	{
+		stats.bytesSent += strlen(line) + image.size();
+	}
+	pService->m_records.push_back(record);
+}
+
+/***********************************************************
+ *  ReceiveLoop()
+ *
+ *  This method is used for taking the clients on the port
+ *  and reading their lines, which may arrive split
+ *  anywhere, until the service stops. A client sending a
+ *  line longer than any request is dropped.
+ ***********************************************************/
+void RenderService::ReceiveLoop()
+{
+	ScopeProfiler::SetThreadName("render service");
+	std::vector<uintptr_t> sockets;
+	std::vector<bool> readable;
+	char buffer[4096];
+	while (m_bStopping.load() == false)
+	{
+		sockets.assign(1, m_listenSocket);
+		for (size_t i = 0; i < m_clients.size(); i++)
+		{
+			sockets.push_back(m_clients[i].socketHandle);
+		}
+		if (NetSocket::WaitReadable(sockets, POLL_MICROSECONDS, readable) == false)
+		{
+			continue;
+		}
+
+		// from the last, so a client closed does not move the ones
+		// still to be read
+		for (size_t i = m_clients.size(); i > 0; i--)
+		{
+			size_t index = i - 1;
+			if (readable[i] == false)
+			{
+				continue;
+			}
+			int bytes = NetSocket::Receive(m_clients[index].socketHandle, buffer, sizeof(buffer));
+			if (bytes <= 0)
+			{
+				CloseClient(index);
+				continue;
+			}
+			std::string& received = m_clients[index].received;
+			received.append(buffer, bytes);
+			size_t lineEnd = received.find('\n');
+			while (lineEnd != std::string::npos)
+			{
+				std::string line = received.substr(0, lineEnd);
+				received.erase(0, lineEnd + 1);
+				HandleLine(m_clients[index].id, line);
+				lineEnd = received.find('\n');
+			}
+			if (received.size() > MAX_LINE_BYTES)
+			{
+				CloseClient(index);
+			}
+		}
+
+		if (readable[0] == true)
+		{
+			uintptr_t clientSocket = NetSocket::Accept(m_listenSocket);
+			if (clientSocket != NO_SOCKET)
+			{
+				CLIENT client;
+				client.id = m_nextClientId++;
+				client.socketHandle = clientSocket;
+				m_clients.push_back(client);
+				{
+					std::lock_guard<std::mutex> lock(m_sendMutex);
+					m_clientSockets[client.id] = clientSocket;
+				}
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_stats.clients++;
+			}
+		}
+	}
+}
+
+/***********************************************************
+ *  HandleLine()
+ *
+ *  This method is used for queuing a request, answering
+ *  with the counters or taking the quit, and refusing what
+ *  cannot be rendered at once.
+ ***********************************************************/
+void RenderService::HandleLine(uint32_t clientId, const std::string& line)
+{
+	std::string command;
+	std::istringstream words(line);
+	words >> command;
+	if (command.empty() == true)
+	{
+		return;
+	}
+
+	if (command == "render")
+	{
+		RENDER_REQUEST request;
+		std::string reason;
+		if (ParseRequest(line, request, reason) == false)
+		{
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_stats.rejected++;
+			}
+			SendToClient(clientId, "error " + request.name + " " + reason + "\n", NULL);
+			return;
+		}
+		request.clientId = clientId;
+		request.receivedTime = NowSeconds();
+		request.renderTime = request.receivedTime;
+		bool bQueued = false;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			bQueued = (m_pending.size() < MAX_PENDING_REQUESTS);
+			if (bQueued == true)
+			{
+				request.id = m_nextRequestId++;
+				m_pending.push_back(request);
+				m_stats.requests++;
+				if (m_stats.firstRequestTime == 0.0)
+				{
+					m_stats.firstRequestTime = request.receivedTime;
+				}
+			}
+			else
+			{
+				m_stats.rejected++;
+			}
+		}
+		if (bQueued == true)
+		{
+			m_requestQueued.notify_all();
+		}
+		else
+		{
+			SendToClient(clientId, "error " + request.name + " too many requests waiting\n", NULL);
+		}
+	}
+	else if (command == "stats")
+	{
+		SERVICE_STATS stats = GetStats();
+		double seconds = stats.lastCompletedTime - stats.firstRequestTime;
+		char reply[512];
+		snprintf(reply, sizeof(reply), "stats %llu %llu %llu %llu %.3f %.3f %.3f\n",
+			stats.requests, stats.completed, stats.rejected, stats.batches,
+			((stats.completed > 0) && (seconds > 0.0)) ? (double)stats.completed / seconds : 0.0,
+			(stats.completed > 0) ? stats.totalSeconds * 1000.0 / stats.completed : 0.0,
+			stats.totalMaxSeconds * 1000.0);
+		SendToClient(clientId, reply, NULL);
+	}
+	else if (command == "quit")
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_bQuitRequested = true;
+		}
+		m_requestQueued.notify_all();
+	}
+	else
+	{
+		SendToClient(clientId, "error - unknown command " + command + "\n", NULL);
+	}
+}
+
+/***********************************************************
+ *  ParseRequest()
+ *
+ *  This method is used for reading the fields of a render
+ *  line and turning the camera position and target into
+ *  the pose the view manager takes, with the yaw and pitch
+ *  its mouse look would have.
+ ***********************************************************/
+bool RenderService::ParseRequest(const std::string& line, RENDER_REQUEST& request, std::string& reason) const
+{
+	std::istringstream words(line);
+	std::string command;
+	std::string scene;
+	std::string size;
+	std::string quality;
+	glm::vec3 target;
+	request.name = "-";
+	words >> command >> request.name >> scene
+		>> request.pose.position.x >> request.pose.position.y >> request.pose.position.z
+		>> target.x >> target.y >> target.z >> request.pose.zoom >> size >> quality;
+	if (words.fail() == true)
+	{
+		reason = "malformed request";
+		return(false);
+	}
+
+	// the scene loaded at the start stays resident; another cannot
+	// be swapped in while the service runs
+	if ((scene != "-") && (scene != m_sceneName) && (scene != m_scenePath))
+	{
+		reason = "scene not resident, the service renders " + m_sceneName;
+		return(false);
+	}
+	if ((sscanf(size.c_str(), "%dx%d", &request.width, &request.height) != 2) ||
+		(request.width <= 0) || (request.height <= 0) ||
+		(request.width > MAX_IMAGE_SIDE) || (request.height > MAX_IMAGE_SIDE))
+	{
+		reason = "bad image size";
+		return(false);
+	}
+	request.quality = -1;
+	for (int i = 0; i < QUALITY_COUNT; i++)
+	{
+		if (quality == QUALITY_NAMES[i])
+		{
+			request.quality = i;
+		}
+	}
+	if (request.quality < 0)
+	{
+		reason = "unknown quality";
+		return(false);
+	}
+	if ((request.pose.zoom < MIN_ZOOM) || (request.pose.zoom > MAX_ZOOM))
+	{
+		reason = "bad zoom";
+		return(false);
+	}
+
+	// the camera cannot look straight up or down, as with the mouse
+	glm::vec3 front = target - request.pose.position;
+	float length = glm::length(front);
+	if ((length < 1.0e-5f) || (glm::abs(front.y / length) > 0.999f))
+	{
+		reason = "bad camera direction";
+		return(false);
+	}
+	front /= length;
+	glm::vec3 right = glm::normalize(glm::cross(front, glm::vec3(0.0f, 1.0f, 0.0f)));
+	request.pose.front = front;
+	request.pose.up = glm::normalize(glm::cross(right, front));
+	request.pose.yaw = glm::degrees(atan2f(front.z, front.x));
+	request.pose.pitch = glm::degrees(asinf(front.y));
+	request.pose.bOrthographic = false;
+	return(true);
+}
+
+/***********************************************************
+ *  SendToClient()
+ *
+ *  This method is used for sending a line, and the file
+ *  after it, to a client still connected. A failed send
+ *  shuts the connection down, which ends the reading of the
+ *  thread, which then closes it.
+ ***********************************************************/
+bool RenderService::SendToClient(uint32_t clientId, const std::string& line, const std::vector<unsigned char>* pFile)
+{
+	std::lock_guard<std::mutex> lock(m_sendMutex);
+	std::map<uint32_t, uintptr_t>::iterator found = m_clientSockets.find(clientId);
+	if (found == m_clientSockets.end())
+	{
+		return(false);
+	}
+	bool bSent = (NetSocket::SendAll(found->second, line.data(), line.size()) == true) &&
+		((NULL == pFile) || (pFile->empty() == true) ||
+		(NetSocket::SendAll(found->second, pFile->data(), pFile->size()) == true));
+	if (bSent == false)
+	{
+		NetSocket::Shutdown(found->second);
+	}
+	return(bSent);
+}
+
+/***********************************************************
+ *  CloseClient()
+ *
+ *  This method is used for closing the connection of a
+ *  client and dropping its requests still waiting; the ones
+ *  rendering finish with nobody to answer.
+ ***********************************************************/
+void RenderService::CloseClient(size_t index)
+{
+	uint32_t clientId = m_clients[index].id;
+	{
+		std::lock_guard<std::mutex> lock(m_sendMutex);
+		m_clientSockets.erase(clientId);
+		NetSocket::Close(m_clients[index].socketHandle);
+	}
+	m_clients.erase(m_clients.begin() + index);
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	for (size_t i = m_pending.size(); i > 0; i--)
+	{
+		if (m_pending[i - 1].clientId == clientId)
+		{
+			m_pending.erase(m_pending.begin() + (i - 1));
+		}
+	}
+}
+
+/***********************************************************
+ *  GetStats()
+ *
+ *  This method is used for getting a copy of the counters,
+ *  which the threads keep updating.
+ ***********************************************************/
+RenderService::SERVICE_STATS RenderService::GetStats() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return(m_stats);
+}
+
+/***********************************************************
+ *  PrintStats()
+ *
+ *  This method is used for printing the requests answered,
+ *  their throughput and their mean and longest times.
+ ***********************************************************/
+void RenderService::PrintStats() const
+{
+	SERVICE_STATS stats = GetStats();
+	std::cout << "\n*** RENDER SERVICE: ***\n";
+	std::cout << "clients " << stats.clients
+		<< "\trequests " << stats.requests
+		<< "\tcompleted " << stats.completed
+		<< "\trejected " << stats.rejected
+		<< "\tbatches " << stats.batches
+		<< "\tsent " << (stats.bytesSent / (1024 * 1024)) << " MB\n";
+	if (stats.completed > 0)
+	{
+		double seconds = stats.lastCompletedTime - stats.firstRequestTime;
+		std::cout << "requests per second " << ((seconds > 0.0) ? (double)stats.completed / seconds : 0.0)
+			<< "\twait mean " << (stats.waitSeconds * 1000.0 / stats.completed) << " ms"
+			<< "\trender mean " << (stats.renderSeconds * 1000.0 / stats.completed) << " ms"
+			<< "\ttotal mean " << (stats.totalSeconds * 1000.0 / stats.completed) << " ms"
+			<< "\tmax " << (stats.totalMaxSeconds * 1000.0) << " ms\n";
+	}
+}
+
+/***********************************************************
+ *  WriteReport()
+ *
+ *  This method is used for writing a row per answered
+ *  request, in the order they were answered, after the
+ *  totals in comment lines.
+ ***********************************************************/
+bool RenderService::WriteReport(const char* filename) const
+{
+	FILE* file = fopen(filename, "wb");
+	if (file == NULL)
+	{
+		return(false);
+	}
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	double seconds = m_stats.lastCompletedTime - m_stats.firstRequestTime;
+	fprintf(file, "# scene: %s\n", m_scenePath.c_str());
+	fprintf(file, "# requests: %llu\n# completed: %llu\n# rejected: %llu\n# batches: %llu\n",
+		m_stats.requests, m_stats.completed, m_stats.rejected, m_stats.batches);
+	fprintf(file, "# requests per second: %.3f\n",
+		((m_stats.completed > 0) && (seconds > 0.0)) ? (double)m_stats.completed / seconds : 0.0);
+	fprintf(file, "name,width,height,quality,bytes,wait ms,render ms,total ms\n");
+	for (size_t i = 0; i < m_records.size(); i++)
+	{
+		const REQUEST_RECORD& record = m_records[i];
+		fprintf(file, "%s,%d,%d,%s,%zu,%.3f,%.3f,%.3f\n", record.name.c_str(), record.width, record.height,
+			QUALITY_NAMES[record.quality], record.bytes, record.waitSeconds * 1000.0,
+			record.renderSeconds * 1000.0, record.totalSeconds * 1000.0);
+	}
+	fclose(file);
+	return(true);
+}
@@ -0,0 +1,201 @@
+///////////////////////////////////////////////////////////////////////////////
+// renderservice.h
+// ============
+// render requests taken over a local socket, answered with encoded images
+//
+//  The application runs headless as a long-lived service, its scene
+//  loaded once and kept resident across the requests. Clients connect
+//  to a TCP port of the loopback interface and send requests a line
+//  each, naming the camera, the image size and a quality preset; the
+//  requests waiting are taken so that those of the same size and
+//  quality follow each other, which keeps the targets and the passes
+//  of one batch from being rebuilt between its frames. Each request
+//  takes one frame, read back and encoded by the frame capture
+//  pipeline while the next ones render, and is answered with its PNG.
+//  The wait, render and total time of every request are kept, for the
+//  stats line a client may ask for and the report written at the end.
+//
+//  A request line is
+//    render <name> <scene> <x> <y> <z> <tx> <ty> <tz> <zoom> <width>x<height> <quality>
+//  with the camera at x y z looking at tx ty tz, the zoom the field
+//  of view in degrees, the scene - or the name of the one resident,
+//  and the quality draft, preview or final. It is answered with
+//    image <name> <width> <height> <bytes> <wait ms> <render ms>
+//  and the bytes of the PNG file, or with error <name> <reason>. The
+//  line stats is answered with the counters, and quit ends the
+//  service.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "CameraPath.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class ViewManager;
+
+/***********************************************************
+ *  RenderService
+ *
+ *  This class contains the listening socket, the connected
+ *  clients and the thread reading their requests, the queue
+ *  of the requests waiting and the ones rendered whose
+ *  images are still being encoded. The main loop takes the
+ *  next request with NextRequest(), renders it and hands
+ *  its frame to the capture pipeline with the request id as
+ *  the tag; ImageSink() answers the request from there.
+ ***********************************************************/
+class RenderService
+{
+public:
+	// constructor
+	RenderService();
+	// destructor
+	~RenderService();
+
+	// the settings a request picks by name
+	enum QUALITY
+	{
+		QUALITY_DRAFT = 0,		// no anti-aliasing, low shadows, bilinear
+		QUALITY_PREVIEW,		// FXAA, medium shadows, trilinear
+		QUALITY_FINAL,			// 8x MSAA, high shadows, 16x anisotropic
+		QUALITY_COUNT
+	};
+
+	// a request taken from a client
+	struct RENDER_REQUEST
+	{
+		uint32_t id;			// given by the service, the capture tag
+		uint32_t clientId;
+		std::string name;		// given by the client, echoed back
+		CameraPath::CAMERA_POSE pose;
+		int width;
+		int height;
+		int quality;			// a QUALITY
+		double receivedTime;
+		double renderTime;		// when the main loop took it
+	};
+
+	// requests answered and their times
+	struct SERVICE_STATS
+	{
+		unsigned long long clients;
+		unsigned long long requests;
+		unsigned long long completed;
+		unsigned long long rejected;
+		unsigned long long batches;		// runs of requests of one size and quality
+		unsigned long long bytesSent;
+		// from receiving a request to rendering it
+		double waitSeconds;
+		// from rendering a request to its image going out
+		double renderSeconds;
+		// from receiving a request to its image going out
+		double totalSeconds;
+		double totalMaxSeconds;
+		// from the first request received to the last answered
+		double firstRequestTime;
+		double lastCompletedTime;
+	};
+
+	// listen on a TCP port of the loopback interface for requests on
+	// the scene of the path; false when the port could not be opened
+	bool Start(int port, const char* scenePath);
+	// close the clients and the port, and end the thread
+	void Stop();
+	// true once a client sent quit
+	bool IsQuitRequested() const { return(m_bQuitRequested.load() == true); }
+
+	// wait until a request is waiting, at most the time given
+	bool WaitForRequest(double seconds);
+	// take the next request to render: the oldest of the size and
+	// quality of the last one taken, until a batch is as long as
+	// allowed, or else the oldest of all
+	bool NextRequest(RENDER_REQUEST& request);
+	// true while rendered requests wait for their images
+	bool HasRequestsInFlight() const;
+	// a request taken could not be rendered
+	void FailRequest(const RENDER_REQUEST& request, const char* reason);
+
+	// apply the preset of a quality to the view manager
+	static void ApplyQuality(ViewManager* pViewManager, int quality);
+	// FrameCapture::FrameSink answering the request of the tag for
+	// the service of pContext
+	static void ImageSink(void* pContext, const std::vector<unsigned char>& image,
+		int width, int height, uint32_t tag);
+
+	SERVICE_STATS GetStats() const;
+	void PrintStats() const;
+	// write every answered request and its times as CSV; false when
+	// the file could not be written
+	bool WriteReport(const char* filename) const;
+
+private:
+	// a connected client and the part of a line it sent so far
+	struct CLIENT
+	{
+		uint32_t id;
+		uintptr_t socketHandle;
+		std::string received;
+	};
+	// the times of an answered request, for the report
+	struct REQUEST_RECORD
+	{
+		std::string name;
+		int width;
+		int height;
+		int quality;
+		size_t bytes;
+		double waitSeconds;
+		double renderSeconds;
+		double totalSeconds;
+	};
+
+	uintptr_t m_listenSocket;
+	std::string m_scenePath;
+	std::string m_sceneName;
+	std::atomic<bool> m_bStopping;
+	std::atomic<bool> m_bQuitRequested;
+	std::thread m_receiveThread;
+	// clients, read by the thread only
+	std::vector<CLIENT> m_clients;
+	uint32_t m_nextClientId;
+
+	// requests waiting and in flight, guarded by m_mutex
+	mutable std::mutex m_mutex;
+	std::condition_variable m_requestQueued;
+	std::deque<RENDER_REQUEST> m_pending;
+	std::map<uint32_t, RENDER_REQUEST> m_inFlight;
+	uint32_t m_nextRequestId;
+	// size and quality of the batch taken last, and its length
+	int m_batchWidth;
+	int m_batchHeight;
+	int m_batchQuality;
+	int m_batchLength;
+	SERVICE_STATS m_stats;
+	std::vector<REQUEST_RECORD> m_records;
+
+	// sockets of the connected clients by id, for the answers from
+	// the encoder threads, guarded by m_sendMutex, which keeps the
+	// answers of a client whole
+	std::mutex m_sendMutex;
+	std::map<uint32_t, uintptr_t> m_clientSockets;
+
+	// accept the clients and read their lines until stopped
+	void ReceiveLoop();
+	// act on one line of a client
+	void HandleLine(uint32_t clientId, const std::string& line);
+	// parse a render line into a request; false, with the reason,
+	// for one that cannot be rendered
+	bool ParseRequest(const std::string& line, RENDER_REQUEST& request, std::string& reason) const;
+	// send a line, or a line and a file, to a client
+	bool SendToClient(uint32_t clientId, const std::string& line, const std::vector<unsigned char>* pFile);
+	void CloseClient(size_t index);
+};
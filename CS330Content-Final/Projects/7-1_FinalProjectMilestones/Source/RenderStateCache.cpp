@@ -0,0 +1,382 @@
+///////////////////////////////////////////////////////////////////////////////
+// renderstatecache.cpp
+// ============
+// immutable render state objects and the cache applying them
+//
+//  The fixed function state of a draw comes in four subsets: the depth
+//  test, blending, face culling and the stencil test. Each subset is
+//  described once, when the scene is prepared, as an immutable state
+//  object, and the passes and batches only name the objects they draw
+//  with. The cache keeps what it last set on the context, so applying
+//  an object issues only the calls for what differs from it, and a
+//  pass that keeps the state of the one before costs nothing. Depth
+//  functions are written for the forward depth convention and turned
+//  around when the frame uses reverse-Z.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "RenderStateCache.h"
+
+#include <cstring>
+#include <iostream>
+
+namespace
+{
+	/***********************************************************
+	 *  GetReversedDepthFunc()
+	 *
+	 *  This function is used for turning a depth function of
+	 *  the forward convention into the one testing the same
+	 *  with reverse-Z, where nearer is greater.
+	 ***********************************************************/
+	GLenum GetReversedDepthFunc(GLenum func)
+	{
+		switch (func)
+		{
+		case GL_LESS:
+			return(GL_GREATER);
+		case GL_LEQUAL:
+			return(GL_GEQUAL);
+		case GL_GREATER:
+			return(GL_LESS);
+		case GL_GEQUAL:
+			return(GL_LEQUAL);
+		}
+		return(func);
+	}
+
+	bool IsSameState(const RenderStateCache::DEPTH_STATE& a, const RenderStateCache::DEPTH_STATE& b)
+	{
+		return((a.bTest == b.bTest) && (a.bWrite == b.bWrite) && (a.func == b.func));
+	}
+
+	bool IsSameState(const RenderStateCache::BLEND_STATE& a, const RenderStateCache::BLEND_STATE& b)
+	{
+		return((a.bEnable == b.bEnable) &&
+			(a.sourceColor == b.sourceColor) && (a.destinationColor == b.destinationColor) &&
+			(a.sourceAlpha == b.sourceAlpha) && (a.destinationAlpha == b.destinationAlpha));
+	}
+
+	bool IsSameState(const RenderStateCache::CULL_STATE& a, const RenderStateCache::CULL_STATE& b)
+	{
+		return((a.bEnable == b.bEnable) && (a.face == b.face) && (a.frontFace == b.frontFace));
+	}
+
+	bool IsSameState(const RenderStateCache::STENCIL_STATE& a, const RenderStateCache::STENCIL_STATE& b)
+	{
+		return((a.bTest == b.bTest) && (a.func == b.func) && (a.reference == b.reference) &&
+			(a.readMask == b.readMask) && (a.writeMask == b.writeMask) &&
+			(a.stencilFail == b.stencilFail) && (a.depthFail == b.depthFail) && (a.depthPass == b.depthPass));
+	}
+
+	/***********************************************************
+	 *  FindOrAddState()
+	 *
+	 *  This function is used for finding the object of a
+	 *  subset holding a state, adding it when there is none.
+	 *  A scene only ever creates a handful of them.
+	 ***********************************************************/
+	template <typename STATE>
+	int FindOrAddState(std::vector<STATE>& states, const STATE& state, int& objects)
+	{
+		for (size_t i = 0; i < states.size(); i++)
+		{
+			if (IsSameState(states[i], state) == true)
+			{
+				return((int)i);
+			}
+		}
+		states.push_back(state);
+		objects++;
+		return((int)states.size() - 1);
+	}
+}
+
+/***********************************************************
+ *  RenderStateCache()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+RenderStateCache::RenderStateCache()
+{
+	memset(&m_depth, 0, sizeof(m_depth));
+	memset(&m_blend, 0, sizeof(m_blend));
+	memset(&m_cull, 0, sizeof(m_cull));
+	memset(&m_stencil, 0, sizeof(m_stencil));
+	m_bDepthKnown = false;
+	m_bBlendKnown = false;
+	m_bCullKnown = false;
+	m_bStencilKnown = false;
+	m_bReverseZ = false;
+	memset(&m_stats, 0, sizeof(m_stats));
+}
+
+/***********************************************************
+ *  ~RenderStateCache()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+RenderStateCache::~RenderStateCache()
+{
+}
+
+/***********************************************************
+ *  Create*State()
+ *
+ *  These methods are used for creating the state object of
+ *  a subset. Objects are never changed once created, so
+ *  asking twice for the same state gives the same object.
+ ***********************************************************/
+int RenderStateCache::CreateDepthState(const DEPTH_STATE& state)
+{
+	return(FindOrAddState(m_depthStates, state, m_stats.objects));
+}
+
+int RenderStateCache::CreateBlendState(const BLEND_STATE& state)
+{
+	return(FindOrAddState(m_blendStates, state, m_stats.objects));
+}
+
+int RenderStateCache::CreateCullState(const CULL_STATE& state)
+{
+	return(FindOrAddState(m_cullStates, state, m_stats.objects));
+}
+
+int RenderStateCache::CreateStencilState(const STENCIL_STATE& state)
+{
+	return(FindOrAddState(m_stencilStates, state, m_stats.objects));
+}
+
+/***********************************************************
+ *  ApplyDepthState()
+ *
+ *  This method is used for setting the depth test, writes
+ *  and function of an object. The function only matters
+ *  while the test is on, so it is left as it is otherwise.
+ ***********************************************************/
+void RenderStateCache::ApplyDepthState(int state)
+{
+	if ((state < 0) || (state >= (int)m_depthStates.size()))
+	{
+		return;
+	}
+	m_stats.applies++;
+
+	const DEPTH_STATE& depth = m_depthStates[state];
+	GLenum func = (m_bReverseZ == true) ? GetReversedDepthFunc(depth.func) : depth.func;
+	if (CountCall((m_bDepthKnown == false) || (depth.bTest != m_depth.bTest)) == true)
+	{
+		SetCapability(GL_DEPTH_TEST, depth.bTest);
+	}
+	if (CountCall((m_bDepthKnown == false) || (depth.bWrite != m_depth.bWrite)) == true)
+	{
+		glDepthMask((depth.bWrite == true) ? GL_TRUE : GL_FALSE);
+	}
+	if ((depth.bTest == true) &&
+		(CountCall((m_bDepthKnown == false) || (func != m_depth.func)) == true))
+	{
+		glDepthFunc(func);
+		m_depth.func = func;
+	}
+	if (m_bDepthKnown == false)
+	{
+		// a function left as it was is not known yet
+		m_depth.func = (depth.bTest == true) ? func : GL_NONE;
+	}
+	m_depth.bTest = depth.bTest;
+	m_depth.bWrite = depth.bWrite;
+	m_bDepthKnown = true;
+}
+
+/***********************************************************
+ *  ApplyBlendState()
+ *
+ *  This method is used for turning blending on or off, and
+ *  setting the factors of an object that blends.
+ ***********************************************************/
+void RenderStateCache::ApplyBlendState(int state)
+{
+	if ((state < 0) || (state >= (int)m_blendStates.size()))
+	{
+		return;
+	}
+	m_stats.applies++;
+
+	const BLEND_STATE& blend = m_blendStates[state];
+	if (CountCall((m_bBlendKnown == false) || (blend.bEnable != m_blend.bEnable)) == true)
+	{
+		SetCapability(GL_BLEND, blend.bEnable);
+	}
+	bool bFactorsKnown = (m_bBlendKnown == true) && (m_blend.sourceColor != GL_NONE);
+	if ((blend.bEnable == true) &&
+		(CountCall((bFactorsKnown == false) ||
+		(blend.sourceColor != m_blend.sourceColor) || (blend.destinationColor != m_blend.destinationColor) ||
+		(blend.sourceAlpha != m_blend.sourceAlpha) || (blend.destinationAlpha != m_blend.destinationAlpha)) == true))
+	{
+		glBlendFuncSeparate(blend.sourceColor, blend.destinationColor, blend.sourceAlpha, blend.destinationAlpha);
+		m_blend = blend;
+	}
+	if ((blend.bEnable == false) && (bFactorsKnown == false))
+	{
+		m_blend.sourceColor = GL_NONE;
+	}
+	m_blend.bEnable = blend.bEnable;
+	m_bBlendKnown = true;
+}
+
+/***********************************************************
+ *  ApplyCullState()
+ *
+ *  This method is used for turning face culling on or off,
+ *  and setting the faces an object culls and the winding
+ *  of the front ones.
+ ***********************************************************/
+void RenderStateCache::ApplyCullState(int state)
+{
+	if ((state < 0) || (state >= (int)m_cullStates.size()))
+	{
+		return;
+	}
+	m_stats.applies++;
+
+	const CULL_STATE& cull = m_cullStates[state];
+	if (CountCall((m_bCullKnown == false) || (cull.bEnable != m_cull.bEnable)) == true)
+	{
+		SetCapability(GL_CULL_FACE, cull.bEnable);
+	}
+	bool bFacesKnown = (m_bCullKnown == true) && (m_cull.face != GL_NONE);
+	if (cull.bEnable == true)
+	{
+		if (CountCall((bFacesKnown == false) || (cull.face != m_cull.face)) == true)
+		{
+			glCullFace(cull.face);
+		}
+		if (CountCall((bFacesKnown == false) || (cull.frontFace != m_cull.frontFace)) == true)
+		{
+			glFrontFace(cull.frontFace);
+		}
+		m_cull = cull;
+	}
+	else if (bFacesKnown == false)
+	{
+		m_cull.face = GL_NONE;
+	}
+	m_cull.bEnable = cull.bEnable;
+	m_bCullKnown = true;
+}
+
+/***********************************************************
+ *  ApplyStencilState()
+ *
+ *  This method is used for turning the stencil test on or
+ *  off, and setting the function, masks and operations of
+ *  an object that tests.
+ ***********************************************************/
+void RenderStateCache::ApplyStencilState(int state)
+{
+	if ((state < 0) || (state >= (int)m_stencilStates.size()))
+	{
+		return;
+	}
+	m_stats.applies++;
+
+	const STENCIL_STATE& stencil = m_stencilStates[state];
+	if (CountCall((m_bStencilKnown == false) || (stencil.bTest != m_stencil.bTest)) == true)
+	{
+		SetCapability(GL_STENCIL_TEST, stencil.bTest);
+	}
+	bool bTestKnown = (m_bStencilKnown == true) && (m_stencil.func != GL_NONE);
+	if (stencil.bTest == true)
+	{
+		if (CountCall((bTestKnown == false) || (stencil.func != m_stencil.func) ||
+			(stencil.reference != m_stencil.reference) || (stencil.readMask != m_stencil.readMask)) == true)
+		{
+			glStencilFunc(stencil.func, stencil.reference, stencil.readMask);
+		}
+		if (CountCall((bTestKnown == false) || (stencil.writeMask != m_stencil.writeMask)) == true)
+		{
+			glStencilMask(stencil.writeMask);
+		}
+		if (CountCall((bTestKnown == false) || (stencil.stencilFail != m_stencil.stencilFail) ||
+			(stencil.depthFail != m_stencil.depthFail) || (stencil.depthPass != m_stencil.depthPass)) == true)
+		{
+			glStencilOp(stencil.stencilFail, stencil.depthFail, stencil.depthPass);
+		}
+		m_stencil = stencil;
+	}
+	else if (bTestKnown == false)
+	{
+		m_stencil.func = GL_NONE;
+	}
+	m_stencil.bTest = stencil.bTest;
+	m_bStencilKnown = true;
+}
+
+/***********************************************************
+ *  Invalidate()
+ *
+ *  This method is used for forgetting the state of the
+ *  context after code outside the cache set some of it, so
+ *  the next object of every subset is applied whole.
+ ***********************************************************/
+void RenderStateCache::Invalidate()
+{
+	m_bDepthKnown = false;
+	m_bBlendKnown = false;
+	m_bCullKnown = false;
+	m_bStencilKnown = false;
+	m_stats.invalidations++;
+}
+
+/***********************************************************
+ *  Print()
+ *
+ *  This method is used for writing the state objects and
+ *  the calls the cache issued and saved to the console for
+ *  the exit report.
+ ***********************************************************/
+void RenderStateCache::Print() const
+{
+	std::cout << "render states objects " << m_stats.objects
+		<< "\tapplied " << m_stats.applies
+		<< "\tgl calls " << m_stats.calls
+		<< "\tskipped " << m_stats.skippedCalls
+		<< "\tinvalidations " << m_stats.invalidations << "\n";
+}
+
+/***********************************************************
+ *  CountCall()
+ *
+ *  This method is used for counting one call of an apply
+ *  as issued when its state changed, or skipped otherwise,
+ *  and telling the caller whether to issue it.
+ ***********************************************************/
+bool RenderStateCache::CountCall(bool bChanged)
+{
+	if (bChanged == true)
+	{
+		m_stats.calls++;
+	}
+	else
+	{
+		m_stats.skippedCalls++;
+	}
+	return(bChanged);
+}
+
+/***********************************************************
+ *  SetCapability()
+ *
+ *  This method is used for turning a capability of the
+ *  context on or off.
+ ***********************************************************/
+void RenderStateCache::SetCapability(GLenum capability, bool bEnable)
+{
+	if (bEnable == true)
+	{
+		glEnable(capability);
+	}
+	else
+	{
+		glDisable(capability);
+	}
+}
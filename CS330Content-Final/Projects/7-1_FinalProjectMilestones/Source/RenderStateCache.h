@@ -0,0 +1,143 @@
+///////////////////////////////////////////////////////////////////////////////
+// renderstatecache.h
+// ============
+// immutable render state objects and the cache applying them
+//
+//  The fixed function state of a draw comes in four subsets: the depth
+//  test, blending, face culling and the stencil test. Each subset is
+//  described once, when the scene is prepared, as an immutable state
+//  object, and the passes and batches only name the objects they draw
+//  with. The cache keeps what it last set on the context, so applying
+//  an object issues only the calls for what differs from it, and a
+//  pass that keeps the state of the one before costs nothing. Depth
+//  functions are written for the forward depth convention and turned
+//  around when the frame uses reverse-Z.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+#include <vector>
+
+/***********************************************************
+ *  RenderStateCache
+ *
+ *  This class contains the state objects of each subset and
+ *  the state last applied to the context. Code outside the
+ *  cache that changes one of the subsets makes the cache
+ *  forget it with Invalidate(), and the next object applied
+ *  sets all of its subset again.
+ ***********************************************************/
+class RenderStateCache
+{
+public:
+	// constructor
+	RenderStateCache();
+	// destructor
+	~RenderStateCache();
+
+	// depth test and writes; func is for the forward convention
+	struct DEPTH_STATE
+	{
+		bool bTest;
+		bool bWrite;
+		GLenum func;
+	};
+
+	// blending, with separate color and alpha factors
+	struct BLEND_STATE
+	{
+		bool bEnable;
+		GLenum sourceColor;
+		GLenum destinationColor;
+		GLenum sourceAlpha;
+		GLenum destinationAlpha;
+	};
+
+	// face culling, and the winding of the faces kept
+	struct CULL_STATE
+	{
+		bool bEnable;
+		GLenum face;
+		GLenum frontFace;
+	};
+
+	// stencil test, the same for front and back faces
+	struct STENCIL_STATE
+	{
+		bool bTest;
+		GLenum func;
+		GLint reference;
+		GLuint readMask;
+		GLuint writeMask;
+		GLenum stencilFail;
+		GLenum depthFail;
+		GLenum depthPass;
+	};
+
+	// state objects and the calls they issued since the start
+	struct STATE_STATS
+	{
+		int objects;					// state objects of all subsets
+		unsigned long long applies;		// objects applied
+		unsigned long long calls;		// GL calls issued by the applies
+		unsigned long long skippedCalls;	// GL calls the applies found already set
+		unsigned long long invalidations;
+	};
+
+	// create a state object, or find the one with the same state;
+	// the object is named by the index returned
+	int CreateDepthState(const DEPTH_STATE& state);
+	int CreateBlendState(const BLEND_STATE& state);
+	int CreateCullState(const CULL_STATE& state);
+	int CreateStencilState(const STENCIL_STATE& state);
+
+	// set the state of an object on the context, skipping what the
+	// context already has
+	void ApplyDepthState(int state);
+	void ApplyBlendState(int state);
+	void ApplyCullState(int state);
+	void ApplyStencilState(int state);
+
+	// turn the depth functions around for reverse-Z from the next
+	// depth state applied
+	void SetReverseZ(bool bEnable) { m_bReverseZ = bEnable; }
+	bool IsReverseZ() const { return(m_bReverseZ); }
+
+	// forget the state of the context, changed by other code
+	void Invalidate();
+
+	const STATE_STATS& GetStats() const { return(m_stats); }
+	// print the stats for the exit report
+	void Print() const;
+
+private:
+	std::vector<DEPTH_STATE> m_depthStates;
+	std::vector<BLEND_STATE> m_blendStates;
+	std::vector<CULL_STATE> m_cullStates;
+	std::vector<STENCIL_STATE> m_stencilStates;
+
+	// the state last set on the context, with the depth function as
+	// it was issued; a subset is unknown after Invalidate()
+	DEPTH_STATE m_depth;
+	BLEND_STATE m_blend;
+	CULL_STATE m_cull;
+	STENCIL_STATE m_stencil;
+	bool m_bDepthKnown;
+	bool m_bBlendKnown;
+	bool m_bCullKnown;
+	bool m_bStencilKnown;
+
+	bool m_bReverseZ;
+	STATE_STATS m_stats;
+
+	// count one call of an apply, issued or found set
+	bool CountCall(bool bChanged);
+	// turn a capability on or off
+	static void SetCapability(GLenum capability, bool bEnable);
+
+	// not copyable, the cache mirrors the one context
+	RenderStateCache(const RenderStateCache&);
+	RenderStateCache& operator=(const RenderStateCache&);
+};
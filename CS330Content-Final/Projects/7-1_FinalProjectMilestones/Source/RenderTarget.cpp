@@ -0,0 +1,457 @@
+///////////////////////////////////////////////////////////////////////////////
+// rendertarget.cpp
+// ============
+// offscreen target the scene renders into at a scale of the window size
+//
+//  The scene is drawn at the window size times the render scale and
+//  stretched to the window at the end of the frame, so a deployment
+//  can trade resolution for frame rate, or render above the window
+//  size for smoother edges. With a frame time target the scale is
+//  picked automatically from the measured GPU time of the frames.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "RenderTarget.h"
+#include "GPUMemory.h"
+
+#include <glm/glm.hpp>
+
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+const float RenderTarget::MIN_RENDER_SCALE = 0.5f;
+const float RenderTarget::MAX_RENDER_SCALE = 2.0f;
+
+namespace
+{
+	// weight of a new GPU time in the smoothed one, low enough that
+	// single slow frames do not move the scale
+	const float GPU_TIME_SMOOTHING = 0.1f;
+	// measured frames between two changes of the dynamic scale, so
+	// the smoothed time reflects the new scale before the next one
+	const int SCALE_SETTLE_FRAMES = 30;
+	// the scale only grows again below this part of the target, so
+	// it does not swing around a frame time right at the target
+	const float SCALE_UP_HEADROOM = 0.85f;
+	// largest change of the scale at once, as a part of the scale
+	const float MAX_SCALE_STEP = 0.1f;
+	// steps the dynamic scale snaps to; every change sizes the
+	// targets of the passes again, so tiny ones are not worth it
+	const float SCALE_QUANTUM = 0.05f;
+}
+
+/***********************************************************
+ *  RenderTarget()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+RenderTarget::RenderTarget()
+{
+	m_renderScale = 1.0f;
+	m_framebuffer = 0;
+	m_renderbuffers[0] = 0;
+	m_renderbuffers[1] = 0;
+	m_width = 0;
+	m_height = 0;
+	m_storageWidth = 0;
+	m_storageHeight = 0;
+	m_bFloatDepth = false;
+	m_bStorageFloatDepth = false;
+	m_bFloatColor = false;
+	m_floatColorFormat = GL_RGBA16F;
+	m_storageColorFormat = GL_NONE;
+	m_bHeadless = false;
+	m_windowWidth = 0;
+	m_windowHeight = 0;
+	m_bOffscreen = false;
+	for (int i = 0; i < TIMER_QUERY_COUNT; i++)
+	{
+		m_timerQueries[i] = 0;
+		m_bQueryPending[i] = false;
+	}
+	m_nextQuery = 0;
+	m_bTiming = false;
+	m_targetMilliseconds = 0.0f;
+	m_minDynamicScale = MIN_RENDER_SCALE;
+	m_maxDynamicScale = 1.0f;
+	m_gpuMilliseconds = 0.0f;
+	m_bGPUSampling = false;
+	m_framesSinceScaleChange = 0;
+	m_scaleChanges = 0;
+}
+
+/***********************************************************
+ *  ~RenderTarget()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+RenderTarget::~RenderTarget()
+{
+	DestroyTargets();
+	if (0 != m_timerQueries[0])
+	{
+		glDeleteQueries(TIMER_QUERY_COUNT, m_timerQueries);
+	}
+}
+
+/***********************************************************
+ *  SetRenderScale()
+ *
+ *  This method is used for setting the scale of the drawn
+ *  frame to the window. The targets follow on the next
+ *  Begin(). While the scale is dynamic, it is where the
+ *  adjustment starts from.
+ ***********************************************************/
+void RenderTarget::SetRenderScale(float renderScale)
+{
+	m_renderScale = glm::clamp(renderScale, MIN_RENDER_SCALE, MAX_RENDER_SCALE);
+	if (IsDynamicScale() == true)
+	{
+		m_renderScale = glm::clamp(m_renderScale, m_minDynamicScale, m_maxDynamicScale);
+	}
+}
+
+/***********************************************************
+ *  SetDynamicScale()
+ *
+ *  This method is used for turning the automatic render
+ *  scale on, for a GPU frame time target and within the
+ *  given bounds, or off with a target of 0.
+ ***********************************************************/
+void RenderTarget::SetDynamicScale(float targetMilliseconds, float minScale, float maxScale)
+{
+	m_targetMilliseconds = glm::max(targetMilliseconds, 0.0f);
+	m_minDynamicScale = glm::clamp(minScale, MIN_RENDER_SCALE, MAX_RENDER_SCALE);
+	m_maxDynamicScale = glm::clamp(maxScale, m_minDynamicScale, MAX_RENDER_SCALE);
+	m_framesSinceScaleChange = 0;
+	SetRenderScale(m_renderScale);
+}
+
+/***********************************************************
+ *  SetGPUSampling()
+ *
+ *  This method is used for keeping the GPU time of every
+ *  frame as it is read back, for a benchmark taking their
+ *  percentiles, which the smoothed time hides.
+ ***********************************************************/
+void RenderTarget::SetGPUSampling(bool bEnable)
+{
+	m_bGPUSampling = bEnable;
+	m_gpuSamples.clear();
+}
+
+/***********************************************************
+ *  TakeGPUSamples()
+ *
+ *  This method is used for handing over the GPU times kept
+ *  since the last call. They belong to frames a few frames
+ *  back, as the queries are read without waiting.
+ ***********************************************************/
+void RenderTarget::TakeGPUSamples(std::vector<float>& samples)
+{
+	samples.insert(samples.end(), m_gpuSamples.begin(), m_gpuSamples.end());
+	m_gpuSamples.clear();
+}
+
+/***********************************************************
+ *  Begin()
+ *
+ *  This method is used for pointing the frame at the window
+ *  or, away from a fixed scale of 1, at the scaled targets,
+ *  which are created again whenever the window or the scale
+ *  changes their size. While the scale is dynamic they are
+ *  created for the largest scale and the frame only covers
+ *  part of them, so a change of the scale alone does not
+ *  create them again. The passes with targets of their own
+ *  size them from the viewport set here. A floating point
+ *  depth buffer also needs the targets, at any scale, and
+ *  so does a headless frame, which has no window to draw to.
+ ***********************************************************/
+bool RenderTarget::Begin(int windowWidth, int windowHeight)
+{
+	m_windowWidth = windowWidth;
+	m_windowHeight = windowHeight;
+	m_bOffscreen = false;
+	if ((windowWidth <= 0) || (windowHeight <= 0))
+	{
+		return(false);
+	}
+
+	BeginTiming();
+
+	if ((m_renderScale == 1.0f) && (IsDynamicScale() == false) && (m_bFloatDepth == false) &&
+		(m_bFloatColor == false) && (m_bHeadless == false))
+	{
+		if (0 != m_framebuffer)
+		{
+			DestroyTargets();
+		}
+		m_width = windowWidth;
+		m_height = windowHeight;
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		glViewport(0, 0, m_width, m_height);
+		return(true);
+	}
+
+	m_width = glm::max((int)(windowWidth * m_renderScale + 0.5f), 1);
+	m_height = glm::max((int)(windowHeight * m_renderScale + 0.5f), 1);
+
+	int storageWidth = m_width;
+	int storageHeight = m_height;
+	if (IsDynamicScale() == true)
+	{
+		storageWidth = glm::max((int)(windowWidth * m_maxDynamicScale + 0.5f), m_width);
+		storageHeight = glm::max((int)(windowHeight * m_maxDynamicScale + 0.5f), m_height);
+	}
+	if ((0 == m_framebuffer) || (storageWidth != m_storageWidth) || (storageHeight != m_storageHeight) ||
+		(m_bStorageFloatDepth != m_bFloatDepth) || (m_storageColorFormat != GetColorFormat()))
+	{
+		CreateTargets(storageWidth, storageHeight);
+	}
+
+	glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+	glViewport(0, 0, m_width, m_height);
+	m_bOffscreen = true;
+	return(true);
+}
+
+/***********************************************************
+ *  End()
+ *
+ *  This method is used for stretching the offscreen frame
+ *  over the window with linear filtering, and leaving the
+ *  window framebuffer and viewport bound for the swap. The
+ *  GPU time of the frame ends after the stretch. A headless
+ *  frame stays in the target, where SaveFrame() reads it.
+ ***********************************************************/
+void RenderTarget::End()
+{
+	if ((m_bOffscreen == true) && (m_bHeadless == true))
+	{
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		m_bOffscreen = false;
+	}
+	else if (m_bOffscreen == true)
+	{
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, m_framebuffer);
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+		glBlitFramebuffer(0, 0, m_width, m_height, 0, 0, m_windowWidth, m_windowHeight,
+			GL_COLOR_BUFFER_BIT, GL_LINEAR);
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		glViewport(0, 0, m_windowWidth, m_windowHeight);
+		m_bOffscreen = false;
+	}
+
+	if (m_bTiming == true)
+	{
+		glEndQuery(GL_TIME_ELAPSED);
+		m_bTiming = false;
+	}
+}
+
+/***********************************************************
+ *  SaveFrame()
+ *
+ *  This method is used for reading the color of the last
+ *  frame back and writing it as a TGA image. TGA rows run
+ *  bottom up like the framebuffer and its pixels are BGRA,
+ *  which the read converts to, so the pixels are written
+ *  as read. The read waits for the GPU to finish the frame.
+ ***********************************************************/
+bool RenderTarget::SaveFrame(const char* filename) const
+{
+	if ((0 == m_framebuffer) || (m_width <= 0) || (m_height <= 0))
+	{
+		std::cout << "No offscreen frame to save" << std::endl;
+		return(false);
+	}
+
+	std::vector<unsigned char> pixels((size_t)m_width * m_height * 4);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, m_framebuffer);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glReadPixels(0, 0, m_width, m_height, GL_BGRA, GL_UNSIGNED_BYTE, pixels.data());
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+
+	// uncompressed true color, 32 bits per pixel, 8 of them alpha
+	unsigned char header[18] = { 0 };
+	header[2] = 2;
+	header[12] = (unsigned char)(m_width & 0xFF);
+	header[13] = (unsigned char)((m_width >> 8) & 0xFF);
+	header[14] = (unsigned char)(m_height & 0xFF);
+	header[15] = (unsigned char)((m_height >> 8) & 0xFF);
+	header[16] = 32;
+	header[17] = 8;
+
+	std::ofstream file(filename, std::ios::binary);
+	file.write((const char*)header, sizeof(header));
+	file.write((const char*)pixels.data(), pixels.size());
+	if (!file)
+	{
+		std::cout << "Could not write frame " << filename << std::endl;
+		return(false);
+	}
+	return(true);
+}
+
+/***********************************************************
+ *  BeginTiming()
+ *
+ *  This method is used for reading the GPU times of the
+ *  earlier frames that are finished, oldest first, and
+ *  starting the query of this frame. Results are never
+ *  waited for; when the GPU is so far behind that every
+ *  query is still pending, this frame goes untimed.
+ ***********************************************************/
+void RenderTarget::BeginTiming()
+{
+	if (0 == m_timerQueries[0])
+	{
+		glGenQueries(TIMER_QUERY_COUNT, m_timerQueries);
+	}
+
+	for (int i = 0; i < TIMER_QUERY_COUNT; i++)
+	{
+		int query = (m_nextQuery + i) % TIMER_QUERY_COUNT;
+		if (m_bQueryPending[query] == false)
+		{
+			continue;
+		}
+
+		GLint available = GL_FALSE;
+		glGetQueryObjectiv(m_timerQueries[query], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (available == GL_FALSE)
+		{
+			// the later frames are not finished either
+			break;
+		}
+
+		GLuint64 nanoseconds = 0;
+		glGetQueryObjectui64v(m_timerQueries[query], GL_QUERY_RESULT, &nanoseconds);
+		m_bQueryPending[query] = false;
+		if (m_bGPUSampling == true)
+		{
+			m_gpuSamples.push_back((float)((double)nanoseconds / 1000000.0));
+		}
+		UpdateDynamicScale((float)((double)nanoseconds / 1000000.0));
+	}
+
+	if (m_bQueryPending[m_nextQuery] == false)
+	{
+		glBeginQuery(GL_TIME_ELAPSED, m_timerQueries[m_nextQuery]);
+		m_bQueryPending[m_nextQuery] = true;
+		m_nextQuery = (m_nextQuery + 1) % TIMER_QUERY_COUNT;
+		m_bTiming = true;
+	}
+}
+
+/***********************************************************
+ *  UpdateDynamicScale()
+ *
+ *  This method is used for smoothing the GPU time of one
+ *  more frame and, when the scale is dynamic and settled,
+ *  moving it toward the frame time target. The time grows
+ *  with the pixels drawn, the square of the scale, so the
+ *  scale moves by the square root of the time ratio, in
+ *  limited and snapped steps.
+ ***********************************************************/
+void RenderTarget::UpdateDynamicScale(float gpuMilliseconds)
+{
+	if (m_gpuMilliseconds <= 0.0f)
+	{
+		m_gpuMilliseconds = gpuMilliseconds;
+	}
+	else
+	{
+		m_gpuMilliseconds = glm::mix(m_gpuMilliseconds, gpuMilliseconds, GPU_TIME_SMOOTHING);
+	}
+
+	if ((IsDynamicScale() == false) || (m_gpuMilliseconds <= 0.0f))
+	{
+		return;
+	}
+
+	m_framesSinceScaleChange++;
+	if (m_framesSinceScaleChange < SCALE_SETTLE_FRAMES)
+	{
+		return;
+	}
+
+	bool bOverTarget = (m_gpuMilliseconds > m_targetMilliseconds);
+	bool bUnderHeadroom = (m_gpuMilliseconds < m_targetMilliseconds * SCALE_UP_HEADROOM);
+	if ((bOverTarget == false) && (bUnderHeadroom == false))
+	{
+		return;
+	}
+
+	float scale = m_renderScale * std::sqrt(m_targetMilliseconds / m_gpuMilliseconds);
+	scale = glm::clamp(scale, m_renderScale * (1.0f - MAX_SCALE_STEP), m_renderScale * (1.0f + MAX_SCALE_STEP));
+	scale = std::floor(scale / SCALE_QUANTUM + 0.5f) * SCALE_QUANTUM;
+	scale = glm::clamp(scale, m_minDynamicScale, m_maxDynamicScale);
+	if (scale != m_renderScale)
+	{
+		m_renderScale = scale;
+		m_framesSinceScaleChange = 0;
+		m_scaleChanges++;
+	}
+}
+
+/***********************************************************
+ *  CreateTargets()
+ *
+ *  This method is used for creating the color and depth
+ *  renderbuffers of a frame size. They are only drawn into,
+ *  blitted and copied from, never sampled, so they need no
+ *  textures.
+ ***********************************************************/
+void RenderTarget::CreateTargets(int width, int height)
+{
+	DestroyTargets();
+
+	m_storageWidth = width;
+	m_storageHeight = height;
+	m_bStorageFloatDepth = m_bFloatDepth;
+	m_storageColorFormat = GetColorFormat();
+	const GLenum colorFormat = m_storageColorFormat;
+
+	glGenRenderbuffers(2, m_renderbuffers);
+	glBindRenderbuffer(GL_RENDERBUFFER, m_renderbuffers[0]);
+	glRenderbufferStorage(GL_RENDERBUFFER, colorFormat, width, height);
+	glBindRenderbuffer(GL_RENDERBUFFER, m_renderbuffers[1]);
+	glRenderbufferStorage(GL_RENDERBUFFER, (m_bFloatDepth == true) ? GL_DEPTH_COMPONENT32F : GL_DEPTH_COMPONENT24, width, height);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+	GPUMemory::TrackRenderbuffer(m_renderbuffers[0], colorFormat, width, height, 1, "scaled color");
+	GPUMemory::TrackRenderbuffer(m_renderbuffers[1], (m_bFloatDepth == true) ? GL_DEPTH_COMPONENT32F : GL_DEPTH_COMPONENT24,
+		width, height, 1, "scaled depth");
+
+	glGenFramebuffers(1, &m_framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, m_renderbuffers[0]);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, m_renderbuffers[1]);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+	{
+		std::cout << "Render target framebuffer is incomplete" << std::endl;
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+/***********************************************************
+ *  DestroyTargets()
+ *
+ *  This method is used for freeing the framebuffer and its
+ *  renderbuffers.
+ ***********************************************************/
+void RenderTarget::DestroyTargets()
+{
+	if (0 != m_framebuffer)
+	{
+		glDeleteFramebuffers(1, &m_framebuffer);
+		m_framebuffer = 0;
+	}
+	if (0 != m_renderbuffers[0])
+	{
+		GPUMemory::DeleteRenderbuffers(2, m_renderbuffers);
+		m_renderbuffers[0] = 0;
+		m_renderbuffers[1] = 0;
+	}
+}
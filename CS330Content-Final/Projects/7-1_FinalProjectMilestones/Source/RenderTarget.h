@@ -0,0 +1,151 @@
+///////////////////////////////////////////////////////////////////////////////
+// rendertarget.h
+// ============
+// offscreen target the scene renders into at a scale of the window size
+//
+//  The scene is drawn at the window size times the render scale and
+//  stretched to the window at the end of the frame, so a deployment
+//  can trade resolution for frame rate, or render above the window
+//  size for smoother edges. With a frame time target the scale is
+//  picked automatically from the measured GPU time of the frames.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+#include <vector>
+
+/***********************************************************
+ *  RenderTarget
+ *
+ *  This class contains the color and depth renderbuffers of
+ *  the scaled frame. Begin() points the scene draws at them,
+ *  sized for the window and the render scale, and End()
+ *  blits them to the window. At a fixed scale of 1 the
+ *  frame is drawn straight into the window and no target
+ *  exists. Every frame is timed on the GPU, and with a
+ *  frame time target the scale follows the smoothed time.
+ ***********************************************************/
+class RenderTarget
+{
+public:
+	// constructor
+	RenderTarget();
+	// destructor
+	~RenderTarget();
+
+	// range of the render scale
+	static const float MIN_RENDER_SCALE;
+	static const float MAX_RENDER_SCALE;
+
+	// scale of the rendered frame to the window size, clamped to
+	// the range above; 1 renders straight into the window
+	void SetRenderScale(float renderScale);
+	float GetRenderScale() const { return(m_renderScale); }
+
+	// bind the framebuffer and viewport the frame is drawn into
+	// for a window framebuffer of the given size; false when the
+	// window has no area, as while it is minimized
+	bool Begin(int windowWidth, int windowHeight);
+	// stretch the drawn frame to the window, when it was offscreen
+	void End();
+
+	// draw into a 32 bit floating point depth buffer, as reverse-Z
+	// depth needs; the window has none, so the frame is always
+	// drawn offscreen while it is on
+	void SetFloatDepth(bool bFloatDepth) { m_bFloatDepth = bFloatDepth; }
+	bool IsFloatDepth() const { return(m_bFloatDepth); }
+	// draw into a floating point color buffer, so the lighting keeps the
+	// range above 1 the post effects tone map; also always offscreen
+	void SetFloatColor(bool bFloatColor) { m_bFloatColor = bFloatColor; }
+	bool IsFloatColor() const { return(m_bFloatColor); }
+	// format of that color buffer, the HDR color of the TargetFormats
+	// tier, so a multisampled frame resolves into the same format
+	void SetFloatColorFormat(GLenum colorFormat) { m_floatColorFormat = colorFormat; }
+
+	// keep every frame offscreen and never stretch it to the window,
+	// for rendering without a display
+	void SetHeadless(bool bHeadless) { m_bHeadless = bHeadless; }
+	bool IsHeadless() const { return(m_bHeadless); }
+	// write the color of the last drawn offscreen frame as an
+	// uncompressed TGA image; false when there is none or the file
+	// cannot be written
+	bool SaveFrame(const char* filename) const;
+	// framebuffer of the offscreen frame, 0 while it is drawn
+	// straight into the window
+	GLuint GetFramebuffer() const { return(m_framebuffer); }
+
+	// size of the frame the last Begin() set up
+	int GetWidth() const { return(m_width); }
+	int GetHeight() const { return(m_height); }
+
+	// adjust the render scale between the given bounds to hold the
+	// GPU time of a frame at the target; a target of 0 turns the
+	// adjustment off and leaves the scale where it is
+	void SetDynamicScale(float targetMilliseconds, float minScale, float maxScale);
+	bool IsDynamicScale() const { return(m_targetMilliseconds > 0.0f); }
+	// smoothed GPU time of the frames, 0 before the first measurement
+	float GetGPUMilliseconds() const { return(m_gpuMilliseconds); }
+	// times the dynamic scale changed
+	unsigned long long GetScaleChanges() const { return(m_scaleChanges); }
+	// keep the unsmoothed GPU time of every frame read back, and
+	// move those kept so far to the end of samples
+	void SetGPUSampling(bool bEnable);
+	void TakeGPUSamples(std::vector<float>& samples);
+
+private:
+	// frames of timer queries the GPU may still be working on
+	static const int TIMER_QUERY_COUNT = 4;
+
+	float m_renderScale;
+	// framebuffer with the color and depth of the scaled frame
+	GLuint m_framebuffer;
+	GLuint m_renderbuffers[2];
+	int m_width;
+	int m_height;
+	// size the renderbuffers were created with, which the frame
+	// may only partly cover while the scale is dynamic
+	int m_storageWidth;
+	int m_storageHeight;
+	// depth format asked for, and the one the renderbuffers have
+	bool m_bFloatDepth;
+	bool m_bStorageFloatDepth;
+	// color format asked for, and the one the renderbuffers have
+	bool m_bFloatColor;
+	GLenum m_floatColorFormat;
+	GLenum m_storageColorFormat;
+	// true when the frame never goes to the window
+	bool m_bHeadless;
+	// window framebuffer size of the last Begin()
+	int m_windowWidth;
+	int m_windowHeight;
+	// true while the frame is drawn into m_framebuffer
+	bool m_bOffscreen;
+
+	// GPU time of each frame, read back a few frames later
+	GLuint m_timerQueries[TIMER_QUERY_COUNT];
+	bool m_bQueryPending[TIMER_QUERY_COUNT];
+	int m_nextQuery;
+	bool m_bTiming;
+	// dynamic scale target, bounds and state
+	float m_targetMilliseconds;
+	float m_minDynamicScale;
+	float m_maxDynamicScale;
+	float m_gpuMilliseconds;
+	int m_framesSinceScaleChange;
+	unsigned long long m_scaleChanges;
+	// GPU times read back since the last TakeGPUSamples()
+	bool m_bGPUSampling;
+	std::vector<float> m_gpuSamples;
+
+	// size the renderbuffers for a frame
+	void CreateTargets(int width, int height);
+	void DestroyTargets();
+	// color format the renderbuffers are wanted in
+	GLenum GetColorFormat() const { return((m_bFloatColor == true) ? m_floatColorFormat : GL_RGBA8); }
+	// read the finished timer queries and start timing this frame
+	void BeginTiming();
+	// move the dynamic scale toward the frame time target
+	void UpdateDynamicScale(float gpuMilliseconds);
+};
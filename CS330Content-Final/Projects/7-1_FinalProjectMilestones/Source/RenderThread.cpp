@@ -0,0 +1,157 @@
+///////////////////////////////////////////////////////////////////////////////
+// renderthread.cpp
+// ============
+// thread submitting the frames while the main thread handles the input
+//
+//  The main thread polls the window events and prepares the view of the
+//  next frame, then publishes it as a packet. The render thread owns
+//  the GL context and renders the newest packet, so the simulation of
+//  one frame overlaps the submission of the one before, and frames
+//  keep coming while the main thread is held up in the event loop, as
+//  during a window drag.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "RenderThread.h"
+
+#include <chrono>
+
+/***********************************************************
+ *  RenderThread()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+RenderThread::RenderThread()
+{
+	m_bRunning = false;
+	m_bPacketPending = false;
+	m_stats.published = 0;
+	m_stats.taken = 0;
+	m_stats.merged = 0;
+}
+
+/***********************************************************
+ *  ~RenderThread()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+RenderThread::~RenderThread()
+{
+	Stop();
+}
+
+/***********************************************************
+ *  Start()
+ *
+ *  This method is used for starting the thread running the
+ *  render loop. The loop makes the GL context current on
+ *  its thread itself, after the main thread released it.
+ ***********************************************************/
+void RenderThread::Start(void (*pRenderLoop)(RenderThread* pThread))
+{
+	Stop();
+
+	m_bPacketPending = false;
+	m_bRunning = true;
+	m_thread = std::thread(pRenderLoop, this);
+}
+
+/***********************************************************
+ *  Stop()
+ *
+ *  This method is used for ending the render loop and
+ *  waiting until its thread is done with the GL context,
+ *  which the main thread can then make current again.
+ ***********************************************************/
+void RenderThread::Stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_bRunning = false;
+	}
+	m_packetPublished.notify_all();
+	m_packetTaken.notify_all();
+
+	if (m_thread.joinable() == true)
+	{
+		m_thread.join();
+	}
+}
+
+/***********************************************************
+ *  Publish()
+ *
+ *  This method is used for writing the packet of the next
+ *  frame into the back packet and waking the render thread.
+ *  A pending packet the render thread did not take yet is
+ *  replaced by the newer one, but its view change, its
+ *  screenshot request and its input time carry over, so
+ *  render on demand still draws the change, no screenshot
+ *  is lost and the latency counts from the first input.
+ ***********************************************************/
+void RenderThread::Publish(const ViewManager::FRAME_PACKET& packet)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (m_bPacketPending == true)
+		{
+			bool bViewChanged = (m_backPacket.bViewChanged == true) || (packet.bViewChanged == true);
+			bool bScreenshot = (m_backPacket.bScreenshot == true) || (packet.bScreenshot == true);
+			double inputTime = m_backPacket.inputTime;
+			m_backPacket = packet;
+			m_backPacket.bViewChanged = bViewChanged;
+			m_backPacket.bScreenshot = bScreenshot;
+			if ((inputTime >= 0.0) && ((packet.inputTime < 0.0) || (inputTime < packet.inputTime)))
+			{
+				m_backPacket.inputTime = inputTime;
+			}
+			m_stats.merged++;
+		}
+		else
+		{
+			m_backPacket = packet;
+		}
+		m_bPacketPending = true;
+		m_stats.published++;
+	}
+	m_packetPublished.notify_one();
+}
+
+/***********************************************************
+ *  Take()
+ *
+ *  This method is used for copying the pending packet out
+ *  of the mailbox for the render thread, waiting up to the
+ *  timeout for the main thread to publish one.
+ ***********************************************************/
+bool RenderThread::Take(ViewManager::FRAME_PACKET& packet, double timeoutSeconds)
+{
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_packetPublished.wait_for(lock, std::chrono::duration<double>(timeoutSeconds),
+			[this]() { return((m_bPacketPending == true) || (m_bRunning == false)); });
+		if (m_bPacketPending == false)
+		{
+			return(false);
+		}
+
+		packet = m_backPacket;
+		m_bPacketPending = false;
+		m_stats.taken++;
+	}
+	m_packetTaken.notify_one();
+	return(true);
+}
+
+/***********************************************************
+ *  WaitForTaken()
+ *
+ *  This method is used for holding the main thread until the
+ *  render thread took the last published packet, so input
+ *  is not sampled for frames that would only be merged.
+ ***********************************************************/
+bool RenderThread::WaitForTaken(double timeoutSeconds)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	return(m_packetTaken.wait_for(lock, std::chrono::duration<double>(timeoutSeconds),
+		[this]() { return((m_bPacketPending == false) || (m_bRunning == false)); }));
+}
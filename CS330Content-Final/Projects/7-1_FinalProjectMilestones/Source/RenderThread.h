@@ -0,0 +1,79 @@
+///////////////////////////////////////////////////////////////////////////////
+// renderthread.h
+// ============
+// thread submitting the frames while the main thread handles the input
+//
+//  The main thread polls the window events and prepares the view of the
+//  next frame, then publishes it as a packet. The render thread owns
+//  the GL context and renders the newest packet, so the simulation of
+//  one frame overlaps the submission of the one before, and frames
+//  keep coming while the main thread is held up in the event loop, as
+//  during a window drag.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "ViewManager.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+/***********************************************************
+ *  RenderThread
+ *
+ *  This class contains the render thread and the mailbox of
+ *  frame packets between it and the main thread. Publish()
+ *  writes the back packet and Take() swaps it to the front,
+ *  so each side works on its own copy. A packet published
+ *  before the last one was taken replaces it, keeping the
+ *  view changes and the earliest input time of both.
+ ***********************************************************/
+class RenderThread
+{
+public:
+	// constructor
+	RenderThread();
+	// destructor
+	~RenderThread();
+
+	// frames handed between the threads
+	struct THREAD_STATS
+	{
+		unsigned long long published;
+		unsigned long long taken;
+		// packets replaced before the render thread took them
+		unsigned long long merged;
+	};
+
+	// run the render loop on a thread of its own; it returns once
+	// IsRunning() turns false
+	void Start(void (*pRenderLoop)(RenderThread* pThread));
+	// ask the render loop to return and wait for it
+	void Stop();
+	bool IsRunning() const { return(m_bRunning); }
+
+	// hand the packet of the next frame to the render thread
+	void Publish(const ViewManager::FRAME_PACKET& packet);
+	// take the newest packet, waiting up to the timeout for one;
+	// false when none was published since the last take
+	bool Take(ViewManager::FRAME_PACKET& packet, double timeoutSeconds);
+	// wait up to the timeout for the render thread to take the
+	// published packet, so the main thread stays at most a frame
+	// ahead; false on the timeout
+	bool WaitForTaken(double timeoutSeconds);
+
+	const THREAD_STATS& GetStats() const { return(m_stats); }
+
+private:
+	std::thread m_thread;
+	std::atomic<bool> m_bRunning;
+	// back packet written by Publish(), guarded by m_mutex
+	ViewManager::FRAME_PACKET m_backPacket;
+	bool m_bPacketPending;
+	THREAD_STATS m_stats;
+	std::mutex m_mutex;
+	std::condition_variable m_packetPublished;
+	std::condition_variable m_packetTaken;
+};
@@ -0,0 +1,676 @@
+///////////////////////////////////////////////////////////////////////////////
+// resourcemanager.cpp
+// ============
+// one owner for the meshes, textures and programs of the scene
+//
+//  Every resource is held by a typed handle, which names a slot and the
+//  generation the slot had when the handle was made, so a handle kept
+//  past its resource is found stale instead of reaching another one.
+//  A load reads its files on a loader thread of its own and creates
+//  its GL objects on the thread updating the manager, once the
+//  resources it depends on are ready; it holds a reference to those
+//  for as long as it lives. A resource nothing references any more is
+//  evicted after a while, and what is still referenced at shutdown is
+//  reported as a leak.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "ResourceManager.h"
+#include "ScopeProfiler.h"
+
+#include <iostream>
+#include <utility>
+
+namespace
+{
+	// names of the RESOURCE_TYPE values, for the reports
+	const char* const TYPE_NAMES[ResourceManager::RESOURCE_TYPE_COUNT] =
+	{
+		"mesh",
+		"texture",
+		"program"
+	};
+
+	// names of the RESOURCE_STATE values, for the leak report
+	const char* const STATE_NAMES[] =
+	{
+		"waiting",
+		"loading",
+		"ready",
+		"failed"
+	};
+}
+
+/***********************************************************
+ *  ResourceManager()
+ *
+ *  The constructor for the class. The loader thread starts
+ *  at once and sleeps until a load is queued.
+ ***********************************************************/
+ResourceManager::ResourceManager()
+{
+	m_frame = 0;
+	m_loadingCount = 0;
+	m_stats.loads = 0;
+	m_stats.adopted = 0;
+	m_stats.shared = 0;
+	m_stats.failed = 0;
+	m_stats.evicted = 0;
+	m_stats.reloads = 0;
+	for (int type = 0; type < RESOURCE_TYPE_COUNT; type++)
+	{
+		m_stats.live[type] = 0;
+	}
+	m_bStopping = false;
+	m_loaderThread = std::thread(&ResourceManager::LoaderLoop, this);
+}
+
+/***********************************************************
+ *  ~ResourceManager()
+ *
+ *  The destructor for the class. The loader thread ends
+ *  after the file it reads, and every resource left is
+ *  freed, newest first, so the context has to be current.
+ ***********************************************************/
+ResourceManager::~ResourceManager()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_bStopping = true;
+		m_tasks.clear();
+	}
+	m_taskQueued.notify_all();
+	if (m_loaderThread.joinable() == true)
+	{
+		m_loaderThread.join();
+	}
+
+	for (size_t i = m_entries.size(); i > 0; i--)
+	{
+		if (m_entries[i - 1].bActive == true)
+		{
+			Evict((uint32_t)(i - 1));
+		}
+	}
+	m_entries.clear();
+	m_freeEntries.clear();
+}
+
+/***********************************************************
+ *  GetTypeName()
+ *
+ *  This method is used for getting the name of a resource
+ *  type.
+ ***********************************************************/
+const char* ResourceManager::GetTypeName(int type)
+{
+	if ((type < 0) || (type >= RESOURCE_TYPE_COUNT))
+	{
+		return("unknown");
+	}
+	return(TYPE_NAMES[type]);
+}
+
+/***********************************************************
+ *  LoadResource()
+ *
+ *  This method is used for queueing the load of a resource,
+ *  taking a reference to each of its dependencies. A
+ *  resource of the type and name already held, loaded or
+ *  not, is shared instead of loaded twice.
+ ***********************************************************/
+uint32_t ResourceManager::LoadResource(int type, const std::string& name, const LOAD_DESC& desc)
+{
+	int existing = FindByName(type, name);
+	if (existing >= 0)
+	{
+		m_entries[existing].refs++;
+		m_stats.shared++;
+		return(MakeHandle((uint32_t)existing));
+	}
+
+	uint32_t handle = AddEntry(type, name);
+	if (0 == handle)
+	{
+		return(0);
+	}
+	uint32_t index = (handle & MAX_RESOURCES) - 1;
+	m_entries[index].desc = desc;
+	m_entries[index].state = STATE_WAITING;
+	for (size_t i = 0; i < desc.dependencies.size(); i++)
+	{
+		AddResourceRef(RESOURCE_TYPE_COUNT, desc.dependencies[i]);
+	}
+	m_loadingCount++;
+	m_stats.loads++;
+
+	// the files are read right away when nothing is waited for
+	StartLoad(index);
+	return(handle);
+}
+
+/***********************************************************
+ *  AdoptResource()
+ *
+ *  This method is used for taking over an object created
+ *  elsewhere, which is ready from the start.
+ ***********************************************************/
+uint32_t ResourceManager::AdoptResource(int type, const std::string& name, const RESOURCE_OBJECT& object,
+	const std::function<void(const RESOURCE_OBJECT&)>& destroy)
+{
+	uint32_t handle = AddEntry(type, name);
+	if (0 == handle)
+	{
+		return(0);
+	}
+	uint32_t index = (handle & MAX_RESOURCES) - 1;
+	m_entries[index].object = object;
+	m_entries[index].desc.destroy = destroy;
+	m_entries[index].state = STATE_READY;
+	m_stats.adopted++;
+	return(handle);
+}
+
+/***********************************************************
+ *  SetResourceObject()
+ *
+ *  This method is used for replacing the object of a ready
+ *  resource.
+ ***********************************************************/
+void ResourceManager::SetResourceObject(int type, uint32_t handle, const RESOURCE_OBJECT& object)
+{
+	int index = FindEntry(type, handle);
+	if ((index >= 0) && (m_entries[index].state == STATE_READY))
+	{
+		m_entries[index].object = object;
+	}
+}
+
+/***********************************************************
+ *  ReloadResource()
+ *
+ *  This method is used for reading the files of a ready
+ *  resource again, as when one of them was saved while the
+ *  program runs. The resource stays ready with its object
+ *  until Update() finds the files read.
+ ***********************************************************/
+bool ResourceManager::ReloadResource(int type, uint32_t handle, const LOAD_DESC& desc)
+{
+	int index = FindEntry(type, handle);
+	if ((index < 0) || (m_entries[index].state != STATE_READY) || (m_entries[index].bReloading == true))
+	{
+		return(false);
+	}
+
+	ENTRY& entry = m_entries[index];
+	entry.reload = desc;
+	entry.reload.dependencies.clear();
+	entry.bReloading = true;
+	if (desc.prepare)
+	{
+		entry.pTask = QueueTask(desc.prepare);
+	}
+	return(true);
+}
+
+/***********************************************************
+ *  AddResourceRef()
+ *
+ *  This method is used for taking a reference to a resource,
+ *  which keeps it from being evicted.
+ ***********************************************************/
+void ResourceManager::AddResourceRef(int type, uint32_t handle)
+{
+	int index = FindEntry(type, handle);
+	if (index >= 0)
+	{
+		m_entries[index].refs++;
+	}
+}
+
+/***********************************************************
+ *  ReleaseResource()
+ *
+ *  This method is used for dropping a reference. The last
+ *  one starts the wait before the resource is evicted.
+ ***********************************************************/
+void ResourceManager::ReleaseResource(int type, uint32_t handle)
+{
+	int index = FindEntry(type, handle);
+	if ((index < 0) || (m_entries[index].refs <= 0))
+	{
+		return;
+	}
+	m_entries[index].refs--;
+	if (0 == m_entries[index].refs)
+	{
+		m_entries[index].unusedSince = m_frame;
+	}
+}
+
+/***********************************************************
+ *  Update()
+ *
+ *  This method is used for moving the loads along: waiting
+ *  resources whose dependencies got ready start reading
+ *  their files, and those whose files were read create
+ *  their objects. The objects are created one slot after
+ *  another, and create() may load or adopt resources
+ *  itself, so no slot is held by reference across it.
+ ***********************************************************/
+void ResourceManager::Update()
+{
+	m_frame++;
+
+	for (uint32_t i = 0; i < (uint32_t)m_entries.size(); i++)
+	{
+		if (m_entries[i].bActive == false)
+		{
+			continue;
+		}
+		if (m_entries[i].state == STATE_WAITING)
+		{
+			StartLoad(i);
+			continue;
+		}
+		if (m_entries[i].bReloading == true)
+		{
+			FinishReload(i);
+			continue;
+		}
+		if (m_entries[i].state != STATE_LOADING)
+		{
+			continue;
+		}
+
+		LOAD_TASK* pTask = m_entries[i].pTask;
+		if ((NULL != pTask) && (pTask->bDone.load(std::memory_order_acquire) == false))
+		{
+			continue;
+		}
+		bool bLoaded = (NULL == pTask) || (pTask->bPrepared == true);
+		delete pTask;
+		m_entries[i].pTask = NULL;
+
+		if ((bLoaded == true) && m_entries[i].desc.create)
+		{
+			std::function<bool(RESOURCE_OBJECT&)> create = m_entries[i].desc.create;
+			RESOURCE_OBJECT object = m_entries[i].object;
+			bLoaded = create(object);
+			m_entries[i].object = object;
+		}
+		m_entries[i].state = (bLoaded == true) ? STATE_READY : STATE_FAILED;
+		m_loadingCount--;
+		if (bLoaded == false)
+		{
+			m_stats.failed++;
+		}
+	}
+
+	for (uint32_t i = 0; i < (uint32_t)m_entries.size(); i++)
+	{
+		if ((m_entries[i].bActive == true) && (m_entries[i].refs == 0) &&
+			(m_frame - m_entries[i].unusedSince >= (unsigned long long)EVICT_FRAMES) &&
+			(PrepareEviction(i) == true))
+		{
+			Evict(i);
+		}
+	}
+}
+
+/***********************************************************
+ *  EvictUnused()
+ *
+ *  This method is used for freeing the resources nothing
+ *  references without waiting, as when a scene is unloaded.
+ *  Freeing one drops its references to its dependencies,
+ *  so the slots are gone over until none more is freed. A
+ *  resource whose files are being read is left for a later
+ *  Update().
+ ***********************************************************/
+void ResourceManager::EvictUnused()
+{
+	bool bEvicted = true;
+	while (bEvicted == true)
+	{
+		bEvicted = false;
+		for (uint32_t i = 0; i < (uint32_t)m_entries.size(); i++)
+		{
+			if ((m_entries[i].bActive == true) && (m_entries[i].refs == 0) && (PrepareEviction(i) == true))
+			{
+				Evict(i);
+				bEvicted = true;
+			}
+		}
+	}
+}
+
+/***********************************************************
+ *  PrintLeakReport()
+ *
+ *  This method is used for listing the resources someone
+ *  still holds a reference to, called at shutdown once
+ *  every owner should have released what it held.
+ ***********************************************************/
+int ResourceManager::PrintLeakReport() const
+{
+	int leaks = 0;
+	for (size_t i = 0; i < m_entries.size(); i++)
+	{
+		const ENTRY& entry = m_entries[i];
+		if ((entry.bActive == false) || (entry.refs == 0))
+		{
+			continue;
+		}
+		if (0 == leaks)
+		{
+			std::cout << "\n*** RESOURCE LEAKS: ***\n";
+		}
+		std::cout << GetTypeName(entry.type) << " \"" << entry.name << "\""
+			<< "\treferences " << entry.refs
+			<< "\t" << STATE_NAMES[entry.state] << "\n";
+		leaks++;
+	}
+	return(leaks);
+}
+
+/***********************************************************
+ *  FindEntry()
+ *
+ *  This method is used for finding the slot of a handle,
+ *  checking its generation and type.
+ ***********************************************************/
+int ResourceManager::FindEntry(int type, uint32_t handle) const
+{
+	uint32_t index = handle & MAX_RESOURCES;
+	if ((0 == index) || (index > (uint32_t)m_entries.size()))
+	{
+		return(-1);
+	}
+	const ENTRY& entry = m_entries[index - 1];
+	if ((entry.bActive == false) || (entry.generation != (uint16_t)(handle >> HANDLE_INDEX_BITS)) ||
+		((type != RESOURCE_TYPE_COUNT) && (type != entry.type)))
+	{
+		return(-1);
+	}
+	return((int)(index - 1));
+}
+
+/***********************************************************
+ *  FindByName()
+ *
+ *  This method is used for finding the active resource of
+ *  a type with a name. Loads are few and happen while a
+ *  scene is set up, so the slots are searched in order.
+ ***********************************************************/
+int ResourceManager::FindByName(int type, const std::string& name) const
+{
+	for (size_t i = 0; i < m_entries.size(); i++)
+	{
+		if ((m_entries[i].bActive == true) && (m_entries[i].type == type) && (m_entries[i].name == name))
+		{
+			return((int)i);
+		}
+	}
+	return(-1);
+}
+
+/***********************************************************
+ *  AddEntry()
+ *
+ *  This method is used for taking a slot for a resource,
+ *  reusing an evicted one first. The resource holds one
+ *  reference.
+ ***********************************************************/
+uint32_t ResourceManager::AddEntry(int type, const std::string& name)
+{
+	uint32_t index = 0;
+	if (m_freeEntries.empty() == false)
+	{
+		index = m_freeEntries.back();
+		m_freeEntries.pop_back();
+	}
+	else
+	{
+		if (m_entries.size() >= MAX_RESOURCES)
+		{
+			std::cout << "Could not add " << GetTypeName(type) << " \"" << name << "\", all "
+				<< MAX_RESOURCES << " resource slots are used" << std::endl;
+			return(0);
+		}
+		m_entries.push_back(ENTRY());
+		index = (uint32_t)m_entries.size() - 1;
+	}
+
+	ENTRY& entry = m_entries[index];
+	entry.type = type;
+	entry.name = name;
+	entry.state = STATE_WAITING;
+	entry.refs = 1;
+	entry.bActive = true;
+	entry.object.name = 0;
+	entry.object.pData = NULL;
+	entry.object.index = -1;
+	entry.desc = LOAD_DESC();
+	entry.pTask = NULL;
+	entry.bReloading = false;
+	entry.reload = LOAD_DESC();
+	entry.unusedSince = m_frame;
+	m_stats.live[type]++;
+	return(MakeHandle(index));
+}
+
+/***********************************************************
+ *  MakeHandle()
+ *
+ *  This method is used for making the handle of a slot with
+ *  its current generation.
+ ***********************************************************/
+uint32_t ResourceManager::MakeHandle(uint32_t index) const
+{
+	return(((uint32_t)m_entries[index].generation << HANDLE_INDEX_BITS) | (index + 1));
+}
+
+/***********************************************************
+ *  StartLoad()
+ *
+ *  This method is used for handing the prepare step of a
+ *  waiting resource to the loader thread once every one of
+ *  its dependencies is ready. A dependency that failed or
+ *  is gone fails the resource too.
+ ***********************************************************/
+void ResourceManager::StartLoad(uint32_t index)
+{
+	const std::vector<uint32_t>& dependencies = m_entries[index].desc.dependencies;
+	for (size_t i = 0; i < dependencies.size(); i++)
+	{
+		int dependency = FindEntry(RESOURCE_TYPE_COUNT, dependencies[i]);
+		if ((dependency < 0) || (m_entries[dependency].state == STATE_FAILED))
+		{
+			std::cout << "Could not load " << GetTypeName(m_entries[index].type) << " \"" << m_entries[index].name
+				<< "\", a resource it depends on failed" << std::endl;
+			m_entries[index].state = STATE_FAILED;
+			m_loadingCount--;
+			m_stats.failed++;
+			return;
+		}
+		if (m_entries[dependency].state != STATE_READY)
+		{
+			return;
+		}
+	}
+
+	m_entries[index].state = STATE_LOADING;
+	if (!m_entries[index].desc.prepare)
+	{
+		return;
+	}
+
+	m_entries[index].pTask = QueueTask(m_entries[index].desc.prepare);
+}
+
+/***********************************************************
+ *  QueueTask()
+ *
+ *  This method is used for queueing a prepare step for the
+ *  loader thread. The task is owned by the slot it is set
+ *  in, which deletes it once it is done.
+ ***********************************************************/
+ResourceManager::LOAD_TASK* ResourceManager::QueueTask(const std::function<bool()>& prepare)
+{
+	LOAD_TASK* pTask = new LOAD_TASK();
+	pTask->prepare = prepare;
+	pTask->bPrepared = false;
+	pTask->bDone = false;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_tasks.push_back(pTask);
+	}
+	m_taskQueued.notify_one();
+	return(pTask);
+}
+
+/***********************************************************
+ *  FinishReload()
+ *
+ *  This method is used for handing the files of a reload to
+ *  its create step once the loader thread read them. A
+ *  reload that fails leaves the object as it was, so the
+ *  scene keeps drawing what it had.
+ ***********************************************************/
+void ResourceManager::FinishReload(uint32_t index)
+{
+	LOAD_TASK* pTask = m_entries[index].pTask;
+	if ((NULL != pTask) && (pTask->bDone.load(std::memory_order_acquire) == false))
+	{
+		return;
+	}
+	bool bLoaded = (NULL == pTask) || (pTask->bPrepared == true);
+	delete pTask;
+	m_entries[index].pTask = NULL;
+	m_entries[index].bReloading = false;
+
+	// taken out of the slot, since create() may add resources
+	LOAD_DESC reload;
+	std::swap(reload, m_entries[index].reload);
+	if ((bLoaded == true) && reload.create)
+	{
+		RESOURCE_OBJECT object = m_entries[index].object;
+		bLoaded = reload.create(object);
+		if (bLoaded == true)
+		{
+			m_entries[index].object = object;
+		}
+	}
+	if (bLoaded == true)
+	{
+		m_stats.reloads++;
+	}
+	else
+	{
+		std::cout << "Could not reload " << GetTypeName(m_entries[index].type) << " \""
+			<< m_entries[index].name << "\", keeping what it had" << std::endl;
+		m_stats.failed++;
+	}
+}
+
+/***********************************************************
+ *  PrepareEviction()
+ *
+ *  This method is used for checking that the load of an
+ *  unused resource is out of the way of its eviction. A
+ *  prepare step still queued is taken back; one the loader
+ *  thread runs has to finish first.
+ ***********************************************************/
+bool ResourceManager::PrepareEviction(uint32_t index)
+{
+	LOAD_TASK* pTask = m_entries[index].pTask;
+	if ((NULL == pTask) || (pTask->bDone.load(std::memory_order_acquire) == true))
+	{
+		return(true);
+	}
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	for (size_t i = 0; i < m_tasks.size(); i++)
+	{
+		if (m_tasks[i] == pTask)
+		{
+			m_tasks.erase(m_tasks.begin() + i);
+			return(true);
+		}
+	}
+	return(false);
+}
+
+/***********************************************************
+ *  Evict()
+ *
+ *  This method is used for freeing the object of a resource
+ *  and dropping its references to its dependencies, which
+ *  may leave them unused in turn. The generation of the
+ *  slot moves on, so the handles of the resource go stale.
+ ***********************************************************/
+void ResourceManager::Evict(uint32_t index)
+{
+	ENTRY& entry = m_entries[index];
+	if (entry.state == STATE_READY)
+	{
+		if (entry.desc.destroy)
+		{
+			entry.desc.destroy(entry.object);
+		}
+	}
+	else if ((entry.state == STATE_WAITING) || (entry.state == STATE_LOADING))
+	{
+		m_loadingCount--;
+	}
+	// only reached with the task done, taken back or never to run
+	delete entry.pTask;
+	entry.pTask = NULL;
+	entry.bReloading = false;
+	entry.reload = LOAD_DESC();
+
+	std::vector<uint32_t> dependencies;
+	dependencies.swap(entry.desc.dependencies);
+	m_stats.live[entry.type]--;
+	m_stats.evicted++;
+	entry.bActive = false;
+	entry.generation++;
+	entry.name.clear();
+	entry.desc = LOAD_DESC();
+	m_freeEntries.push_back(index);
+
+	for (size_t i = 0; i < dependencies.size(); i++)
+	{
+		ReleaseResource(RESOURCE_TYPE_COUNT, dependencies[i]);
+	}
+}
+
+/***********************************************************
+ *  LoaderLoop()
+ *
+ *  This method is used for running the queued prepare steps
+ *  in order, one at a time, so reading the files of a load
+ *  never takes a worker the frames need.
+ ***********************************************************/
+void ResourceManager::LoaderLoop()
+{
+	ScopeProfiler::SetThreadName("resource loader");
+
+	for (;;)
+	{
+		LOAD_TASK* pTask = NULL;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_taskQueued.wait(lock, [this]() { return((m_bStopping == true) || (m_tasks.empty() == false)); });
+			if (m_bStopping == true)
+			{
+				break;
+			}
+			pTask = m_tasks.front();
+			m_tasks.pop_front();
+		}
+
+		pTask->bPrepared = pTask->prepare();
+		pTask->bDone.store(true, std::memory_order_release);
+	}
+}
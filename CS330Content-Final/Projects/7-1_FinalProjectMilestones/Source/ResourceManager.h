@@ -0,0 +1,273 @@
+///////////////////////////////////////////////////////////////////////////////
+// resourcemanager.h
+// ============
+// one owner for the meshes, textures and programs of the scene
+//
+//  Every resource is held by a typed handle, which names a slot and the
+//  generation the slot had when the handle was made, so a handle kept
+//  past its resource is found stale instead of reaching another one.
+//  A load reads its files on a loader thread of its own and creates
+//  its GL objects on the thread updating the manager, once the
+//  resources it depends on are ready; it holds a reference to those
+//  for as long as it lives. A resource nothing references any more is
+//  evicted after a while, and what is still referenced at shutdown is
+//  reported as a leak.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/***********************************************************
+ *  ResourceManager
+ *
+ *  This class contains the slots of every resource, their
+ *  reference counts and the loader thread. Load() queues a
+ *  resource and Update(), called once a frame with the GL
+ *  context current, starts the loads whose dependencies are
+ *  ready, creates the objects of those whose files were
+ *  read and evicts the resources unused for long enough.
+ ***********************************************************/
+class ResourceManager
+{
+public:
+	// constructor
+	ResourceManager();
+	// destructor
+	~ResourceManager();
+
+	// kinds of resources, which a handle is typed by
+	enum RESOURCE_TYPE
+	{
+		RESOURCE_MESH = 0,
+		RESOURCE_TEXTURE,
+		RESOURCE_PROGRAM,
+		RESOURCE_TYPE_COUNT
+	};
+
+	// how far the load of a resource got
+	enum RESOURCE_STATE
+	{
+		STATE_WAITING = 0,	// for its dependencies
+		STATE_LOADING,		// its files are read on the loader thread
+		STATE_READY,
+		STATE_FAILED
+	};
+
+	// generation in the high 16 bits, slot index + 1 in the low 16,
+	// like TagRegistry; typed so a mesh handle is never taken for a
+	// texture
+	template<int TYPE>
+	struct HANDLE
+	{
+		uint32_t value;
+
+		HANDLE() : value(0) {}
+		explicit HANDLE(uint32_t handleValue) : value(handleValue) {}
+		bool IsNull() const { return(0 == value); }
+	};
+	typedef HANDLE<RESOURCE_MESH> MESH_HANDLE;
+	typedef HANDLE<RESOURCE_TEXTURE> TEXTURE_HANDLE;
+	typedef HANDLE<RESOURCE_PROGRAM> PROGRAM_HANDLE;
+	static const int HANDLE_INDEX_BITS = 16;
+	static const uint32_t MAX_RESOURCES = (1u << HANDLE_INDEX_BITS) - 1;
+
+	// what a resource was created as: a GL name, an object of the
+	// module that made it or an index into one of its lists
+	struct RESOURCE_OBJECT
+	{
+		GLuint name;
+		void* pData;
+		int index;
+	};
+
+	// how a resource is loaded and freed
+	struct LOAD_DESC
+	{
+		// reads the files on the loader thread, false when they
+		// cannot be; empty when there is nothing to read
+		std::function<bool()> prepare;
+		// creates the object on the thread calling Update(), false
+		// when it cannot be
+		std::function<bool(RESOURCE_OBJECT&)> create;
+		// frees the object once the resource is evicted; empty when
+		// it owns nothing
+		std::function<void(const RESOURCE_OBJECT&)> destroy;
+		// handle values of the resources created first and kept
+		// alive as long as this one, of any type
+		std::vector<uint32_t> dependencies;
+	};
+
+	// resources handed out and freed since the start
+	struct RESOURCE_STATS
+	{
+		unsigned long long loads;		// loads queued
+		unsigned long long adopted;		// objects created elsewhere
+		unsigned long long shared;		// loads of a name already held
+		unsigned long long failed;
+		unsigned long long evicted;
+		unsigned long long reloads;		// of ready resources, hot reloaded
+		int live[RESOURCE_TYPE_COUNT];	// in a slot now
+	};
+
+	// frames a resource nothing references is kept, so a load of it
+	// soon after finds it, before it is evicted
+	static const int EVICT_FRAMES = 300;
+
+	// queue the load of a resource holding one reference; a name
+	// of the type already held gets another reference to it instead
+	template<int TYPE>
+	HANDLE<TYPE> Load(const std::string& name, const LOAD_DESC& desc)
+	{
+		return(HANDLE<TYPE>(LoadResource(TYPE, name, desc)));
+	}
+	// take over an object created elsewhere, ready and holding one
+	// reference
+	template<int TYPE>
+	HANDLE<TYPE> Adopt(const std::string& name, const RESOURCE_OBJECT& object,
+		const std::function<void(const RESOURCE_OBJECT&)>& destroy)
+	{
+		return(HANDLE<TYPE>(AdoptResource(TYPE, name, object, destroy)));
+	}
+	// the object of a ready resource, NULL for a stale handle or one
+	// not loaded yet
+	template<int TYPE>
+	const RESOURCE_OBJECT* Get(HANDLE<TYPE> handle) const
+	{
+		int index = FindEntry(TYPE, handle.value);
+		return(((index >= 0) && (m_entries[index].state == STATE_READY)) ? &m_entries[index].object : NULL);
+	}
+	// swap the object of a resource for another the caller made, as a
+	// streamed texture replaces its placeholder; the old one is not
+	// freed
+	template<int TYPE>
+	void SetObject(HANDLE<TYPE> handle, const RESOURCE_OBJECT& object)
+	{
+		SetResourceObject(TYPE, handle.value, object);
+	}
+	// read the files of a ready resource again on the loader thread
+	// and hand them to desc.create, which updates the object in place,
+	// so its handles stay valid; the old object is kept until then,
+	// and after a reload that failed. False when the resource is not
+	// ready or still reloading; the dependencies of desc are ignored
+	template<int TYPE>
+	bool Reload(HANDLE<TYPE> handle, const LOAD_DESC& desc)
+	{
+		return(ReloadResource(TYPE, handle.value, desc));
+	}
+	template<int TYPE>
+	RESOURCE_STATE GetState(HANDLE<TYPE> handle) const
+	{
+		int index = FindEntry(TYPE, handle.value);
+		return((index >= 0) ? m_entries[index].state : STATE_FAILED);
+	}
+
+	// take and drop a reference; a resource nothing references is
+	// evicted EVICT_FRAMES frames later
+	template<int TYPE>
+	void AddRef(HANDLE<TYPE> handle) { AddResourceRef(TYPE, handle.value); }
+	template<int TYPE>
+	void Release(HANDLE<TYPE> handle) { ReleaseResource(TYPE, handle.value); }
+
+	// start the loads whose dependencies are ready, create the objects
+	// of those read since the last call and evict the resources unused
+	// for EVICT_FRAMES calls; called once a frame with the context
+	// current
+	void Update();
+	// free every resource nothing references now, and those only they
+	// kept alive, except the ones whose files are being read
+	void EvictUnused();
+	// true while a load waits or its files are read
+	bool IsLoading() const { return(m_loadingCount > 0); }
+	int GetLoadingCount() const { return(m_loadingCount); }
+
+	// print the resources still referenced, which nothing released;
+	// returns how many there are
+	int PrintLeakReport() const;
+	const RESOURCE_STATS& GetStats() const { return(m_stats); }
+	static const char* GetTypeName(int type);
+
+private:
+	// a prepare step handed to the loader thread; bDone is set once
+	// bPrepared holds its result
+	struct LOAD_TASK
+	{
+		std::function<bool()> prepare;
+		bool bPrepared;
+		std::atomic<bool> bDone;
+	};
+
+	struct ENTRY
+	{
+		int type;
+		std::string name;
+		RESOURCE_STATE state;
+		int refs;
+		uint16_t generation;
+		bool bActive;
+		RESOURCE_OBJECT object;
+		LOAD_DESC desc;
+		// the prepare step on the loader thread, NULL when none runs
+		LOAD_TASK* pTask;
+		// set while pTask reads the files of a reload of the ready
+		// resource, which reload.create finishes
+		bool bReloading;
+		LOAD_DESC reload;
+		// Update() call the last reference was dropped in
+		unsigned long long unusedSince;
+	};
+
+	std::vector<ENTRY> m_entries;
+	// slots of evicted resources, reused before new ones are added
+	std::vector<uint32_t> m_freeEntries;
+	unsigned long long m_frame;
+	int m_loadingCount;
+	RESOURCE_STATS m_stats;
+
+	// the prepare steps not started, guarded by m_mutex
+	std::thread m_loaderThread;
+	std::deque<LOAD_TASK*> m_tasks;
+	bool m_bStopping;
+	std::mutex m_mutex;
+	std::condition_variable m_taskQueued;
+
+	uint32_t LoadResource(int type, const std::string& name, const LOAD_DESC& desc);
+	uint32_t AdoptResource(int type, const std::string& name, const RESOURCE_OBJECT& object,
+		const std::function<void(const RESOURCE_OBJECT&)>& destroy);
+	void SetResourceObject(int type, uint32_t handle, const RESOURCE_OBJECT& object);
+	bool ReloadResource(int type, uint32_t handle, const LOAD_DESC& desc);
+	void AddResourceRef(int type, uint32_t handle);
+	void ReleaseResource(int type, uint32_t handle);
+	// slot of a handle of the type that is not stale, -1 otherwise;
+	// RESOURCE_TYPE_COUNT matches any type
+	int FindEntry(int type, uint32_t handle) const;
+	// slot of the active resource of a type and name, -1 for none
+	int FindByName(int type, const std::string& name) const;
+	uint32_t AddEntry(int type, const std::string& name);
+	uint32_t MakeHandle(uint32_t index) const;
+	// start the prepare step of a waiting resource, or fail it with a
+	// dependency that failed
+	void StartLoad(uint32_t index);
+	// hand a prepare step to the loader thread
+	LOAD_TASK* QueueTask(const std::function<bool()>& prepare);
+	// create the object of a reload whose files were read
+	void FinishReload(uint32_t index);
+	// true when the prepare step of a resource is done, not started or
+	// taken back from the queue, so it can be evicted
+	bool PrepareEviction(uint32_t index);
+	// free the object of a resource, drop its references to its
+	// dependencies and put its slot up for reuse
+	void Evict(uint32_t index);
+	// body of the loader thread
+	void LoaderLoop();
+};
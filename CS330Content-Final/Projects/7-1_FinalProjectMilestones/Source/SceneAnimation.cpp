@@ -0,0 +1,886 @@
+///////////////////////////////////////////////////////////////////////////////
+// sceneanimation.cpp
+// ============
+// keyframed clips played on the scene nodes, on the CPU or the GPU
+//
+//  A clip is a set of channels, each one keying the scale, rotation
+//  or position of a node over time, stepped, linear or eased between
+//  the keys. Bound to the nodes of the scene by their tags, a clip is
+//  played on top of the transform each node was placed with, so the
+//  same door or drawer clip serves every copy of it. The bindings are
+//  sampled in parallel on the job system and set as the local
+//  transforms of their nodes, which the hierarchy takes from there.
+//  When many bindings can be, a compute pass samples them instead and
+//  writes the model and normal matrices of their draws straight into
+//  the instance data of the frame, so the CPU spends nothing per
+//  animated object on a frame.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "SceneAnimation.h"
+#include "Logger.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+namespace
+{
+	// work group size declared by the compute shader
+	const GLuint SAMPLE_GROUP_SIZE = 64;
+	// storage bindings of the clips, channels, keys, records and
+	// the instance data
+	const GLuint CLIPS_BINDING = 0;
+	const GLuint CHANNELS_BINDING = 1;
+	const GLuint KEYS_BINDING = 2;
+	const GLuint RECORDS_BINDING = 3;
+	const GLuint INSTANCES_BINDING = 4;
+	// fewest CPU bindings sampled by one job
+	const size_t PARALLEL_MIN_BINDINGS = 256;
+	// poses of a clip, besides its keys, the box of a GPU posed
+	// draw is widened to
+	const int SWEEP_SAMPLES = 32;
+
+	const char* const PROPERTY_NAMES[SceneAnimation::PROPERTY_COUNT] =
+	{
+		"scale",
+		"rotation",
+		"position"
+	};
+
+	/***********************************************************
+	 *  GetSeconds()
+	 *
+	 *  This function is used for reading a monotonic clock in
+	 *  seconds.
+	 ***********************************************************/
+	double GetSeconds()
+	{
+		return(std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count());
+	}
+
+	/***********************************************************
+	 *  FindName()
+	 *
+	 *  This function is used for finding a name in a list of
+	 *  names, -1 when it is not there.
+	 ***********************************************************/
+	int FindName(const char* const* pNames, int count, const std::string& name)
+	{
+		for (int i = 0; i < count; i++)
+		{
+			if (name == pNames[i])
+			{
+				return(i);
+			}
+		}
+		return(-1);
+	}
+
+	/***********************************************************
+	 *  TransformBox()
+	 *
+	 *  This function is used for the box around a box moved by
+	 *  a matrix, each column adding its smaller and larger
+	 *  product with the extent along its axis.
+	 ***********************************************************/
+	SceneBVH::AABB TransformBox(const glm::mat4& matrix, const SceneBVH::AABB& bounds)
+	{
+		SceneBVH::AABB moved;
+		moved.minXYZ = glm::vec3(matrix[3]);
+		moved.maxXYZ = moved.minXYZ;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			glm::vec3 column = glm::vec3(matrix[axis]);
+			glm::vec3 a = column * bounds.minXYZ[axis];
+			glm::vec3 b = column * bounds.maxXYZ[axis];
+			moved.minXYZ += glm::min(a, b);
+			moved.maxXYZ += glm::max(a, b);
+		}
+		return(moved);
+	}
+}
+
+/***********************************************************
+ *  SceneAnimation()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+SceneAnimation::SceneAnimation(ShaderManager* pShaderManager)
+	: m_recordBuffer(sizeof(GPU_RECORD), "animation records")
+{
+	m_pShaderManager = pShaderManager;
+	m_sampleProgram = 0;
+	m_timeLocation = -1;
+	m_instanceBaseLocation = -1;
+	m_recordCountLocation = -1;
+	m_bGPUAllowed = true;
+	m_endTime = 0.0;
+	m_bEndless = false;
+	m_lastEvaluated = -1.0;
+	m_gpuBindingCount = 0;
+	m_bRecordsCurrent = false;
+	memset(&m_stats, 0, sizeof(m_stats));
+}
+
+/***********************************************************
+ *  ~SceneAnimation()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+SceneAnimation::~SceneAnimation()
+{
+	if (0 != m_sampleProgram)
+	{
+		glDeleteProgram(m_sampleProgram);
+		m_sampleProgram = 0;
+	}
+	m_pShaderManager = NULL;
+}
+
+/***********************************************************
+ *  Load()
+ *
+ *  This method is used for reading the clips and bind lines
+ *  of an animation file. A channel belongs to the clip line
+ *  above it and a key to the channel line above it; the
+ *  bind lines name the clips before them.
+ ***********************************************************/
+bool SceneAnimation::Load(const char* filename)
+{
+	std::ifstream file(filename);
+	if (!file)
+	{
+		LOG_ERROR("Could not open animation file %s", filename);
+		return(false);
+	}
+
+	m_clips.clear();
+	m_channels.clear();
+	m_keys.clear();
+	m_bindLines.clear();
+
+	const char* const interpolationNames[] = { "step", "linear", "smooth" };
+	const char* const playbackNames[] = { "once", "loop", "pingpong" };
+
+	std::string text;
+	int lineNumber = 0;
+	while (std::getline(file, text))
+	{
+		lineNumber++;
+		size_t comment = text.find('#');
+		if (comment != std::string::npos)
+		{
+			text.erase(comment);
+		}
+
+		std::istringstream line(text);
+		std::string keyword;
+		if (!(line >> keyword))
+		{
+			continue;
+		}
+
+		bool bValid = true;
+		std::string error;
+		if (keyword == "clip")
+		{
+			ANIMATION_CLIP clip;
+			std::string playback;
+			bValid = (line >> clip.name >> clip.duration >> playback) && (clip.duration > 0.0f);
+			clip.playback = FindName(playbackNames, 3, playback);
+			clip.firstChannel = (uint32_t)m_channels.size();
+			clip.channelCount = 0;
+			if ((bValid == true) && (clip.playback < 0))
+			{
+				error = "unknown playback " + playback;
+				bValid = false;
+			}
+			for (size_t i = 0; (i < m_clips.size()) && (bValid == true); i++)
+			{
+				if (m_clips[i].name == clip.name)
+				{
+					error = "clip " + clip.name + " is already defined";
+					bValid = false;
+				}
+			}
+			if (bValid == true)
+			{
+				m_clips.push_back(clip);
+			}
+		}
+		else if (keyword == "channel")
+		{
+			ANIMATION_CHANNEL channel;
+			std::string property;
+			std::string interpolation;
+			bValid = (line >> property >> interpolation) && (m_clips.empty() == false);
+			channel.property = FindName(PROPERTY_NAMES, PROPERTY_COUNT, property);
+			channel.interpolation = FindName(interpolationNames, 3, interpolation);
+			channel.firstKey = (uint32_t)m_keys.size();
+			channel.keyCount = 0;
+			if ((bValid == true) && ((channel.property < 0) || (channel.interpolation < 0)))
+			{
+				error = "unknown channel " + property + " " + interpolation;
+				bValid = false;
+			}
+			if (bValid == true)
+			{
+				m_channels.push_back(channel);
+				m_clips.back().channelCount++;
+			}
+		}
+		else if (keyword == "key")
+		{
+			ANIMATION_KEY key;
+			bValid = (line >> key.time >> key.value.x >> key.value.y >> key.value.z) &&
+				(m_clips.empty() == false) && (m_clips.back().channelCount > 0);
+			if ((bValid == true) && (m_channels.back().keyCount > 0) && (key.time < m_keys.back().time))
+			{
+				error = "key before the one above it";
+				bValid = false;
+			}
+			if (bValid == true)
+			{
+				m_keys.push_back(key);
+				m_channels.back().keyCount++;
+			}
+		}
+		else if (keyword == "bind")
+		{
+			BIND_LINE bindLine;
+			std::string clipName;
+			bValid = (line >> clipName >> bindLine.tag) && (bindLine.tag.empty() == false);
+			bindLine.start = 0.0f;
+			bindLine.speed = 1.0f;
+			bindLine.stagger = 0.0f;
+			if ((bValid == true) && (line >> bindLine.start) && (line >> bindLine.speed))
+			{
+				line >> bindLine.stagger;
+			}
+			bindLine.bPrefix = (bValid == true) && (bindLine.tag.back() == '*');
+			if (bindLine.bPrefix == true)
+			{
+				bindLine.tag.pop_back();
+			}
+			bindLine.clipIndex = -1;
+			for (size_t i = 0; i < m_clips.size(); i++)
+			{
+				if (m_clips[i].name == clipName)
+				{
+					bindLine.clipIndex = (int)i;
+				}
+			}
+			if ((bValid == true) && (bindLine.clipIndex < 0))
+			{
+				error = "unknown clip " + clipName;
+				bValid = false;
+			}
+			if ((bValid == true) && (bindLine.speed <= 0.0f))
+			{
+				error = "speed must be above 0";
+				bValid = false;
+			}
+			if (bValid == true)
+			{
+				m_bindLines.push_back(bindLine);
+			}
+		}
+		else
+		{
+			error = "unknown line " + keyword;
+			bValid = false;
+		}
+
+		if (bValid == false)
+		{
+			LOG_ERROR("%s(%d): %s", filename, lineNumber,
+				(error.empty() ? ("malformed " + keyword + " line") : error).c_str());
+			return(false);
+		}
+	}
+
+	for (size_t i = 0; i < m_channels.size(); i++)
+	{
+		if (m_channels[i].keyCount == 0)
+		{
+			LOG_ERROR("%s: a %s channel has no key", filename, PROPERTY_NAMES[m_channels[i].property]);
+			return(false);
+		}
+	}
+
+	return(true);
+}
+
+/***********************************************************
+ *  Create()
+ *
+ *  This method is used for building the compute program of
+ *  the GPU path, which needs OpenGL 4.3 for compute shaders
+ *  and storage buffers.
+ ***********************************************************/
+bool SceneAnimation::Create(const char* sampleShaderPath)
+{
+	if ((NULL == m_pShaderManager) || (GLEW_VERSION_4_3 != GL_TRUE))
+	{
+		return(false);
+	}
+
+	m_sampleProgram = m_pShaderManager->LoadComputeShader(sampleShaderPath);
+	if (0 == m_sampleProgram)
+	{
+		LOG_WARNING("GPU animation disabled, its compute shader did not build");
+		return(false);
+	}
+
+	m_timeLocation = glGetUniformLocation(m_sampleProgram, "time");
+	m_instanceBaseLocation = glGetUniformLocation(m_sampleProgram, "instanceBase");
+	m_recordCountLocation = glGetUniformLocation(m_sampleProgram, "recordCount");
+
+	return(true);
+}
+
+/***********************************************************
+ *  Bind()
+ *
+ *  This method is used for binding the clips to the nodes
+ *  of a recorded scene, the first bind line naming a node
+ *  winning. The rest transform of a node is the local one
+ *  it has now. A binding goes to the GPU path when there
+ *  are enough of them and no other binding is above or
+ *  below it, since the pass poses the draws under a node
+ *  from the world of its parent, which must not move with
+ *  the clip of another node.
+ ***********************************************************/
+void SceneAnimation::Bind(SceneTransforms& transforms, const std::vector<unsigned char>& drawStatic)
+{
+	m_bindings.clear();
+	m_cpuBindings.clear();
+	m_drawGPUBindings.clear();
+	m_records.clear();
+	m_bRecordsCurrent = false;
+	m_gpuBindingCount = 0;
+	m_endTime = 0.0;
+	m_bEndless = false;
+	m_lastEvaluated = -1.0;
+	m_stats.bindings = 0;
+	m_stats.gpuBindings = 0;
+	m_stats.skipped = 0;
+	if (IsLoaded() == false)
+	{
+		return;
+	}
+
+	// nodes with a baked draw under them, which moving would
+	// leave behind in the static geometry
+	int nodeCount = transforms.GetNodeCount();
+	std::vector<unsigned char> staticNodes(nodeCount, 0);
+	for (size_t i = 0; (i < drawStatic.size()) && (i < transforms.GetDrawCount()); i++)
+	{
+		int nodeID = transforms.GetDrawNode((uint32_t)i);
+		if ((drawStatic[i] != 0) && (nodeID >= 0))
+		{
+			staticNodes[nodeID] = 1;
+		}
+	}
+	for (int i = nodeCount - 1; i >= 0; i--)
+	{
+		int parentID = transforms.GetNodeParent(i);
+		if ((staticNodes[i] != 0) && (parentID >= 0))
+		{
+			staticNodes[parentID] = 1;
+		}
+	}
+
+	std::vector<int> nodeBindings(nodeCount, -1);
+	for (size_t line = 0; line < m_bindLines.size(); line++)
+	{
+		const BIND_LINE& bindLine = m_bindLines[line];
+		int matches = 0;
+		for (int i = 0; i < nodeCount; i++)
+		{
+			const std::string& tag = transforms.GetNodeTag(i);
+			bool bMatch = (bindLine.bPrefix == true) ?
+				(tag.compare(0, bindLine.tag.size(), bindLine.tag) == 0) : (tag == bindLine.tag);
+			if ((bMatch == false) || (nodeBindings[i] >= 0))
+			{
+				continue;
+			}
+			if (staticNodes[i] != 0)
+			{
+				m_stats.skipped++;
+				continue;
+			}
+
+			NODE_BINDING binding;
+			binding.clipIndex = bindLine.clipIndex;
+			binding.nodeID = i;
+			binding.start = bindLine.start + bindLine.stagger * (float)matches;
+			binding.speed = bindLine.speed;
+			transforms.GetNodeTransform(i, binding.restScale, binding.restRotation, binding.restPosition);
+			binding.bGPU = true;
+			nodeBindings[i] = (int)m_bindings.size();
+			m_bindings.push_back(binding);
+			matches++;
+
+			const ANIMATION_CLIP& clip = m_clips[binding.clipIndex];
+			if (clip.playback == PLAYBACK_ONCE)
+			{
+				m_endTime = std::max(m_endTime, (double)(binding.start + clip.duration / binding.speed));
+			}
+			else
+			{
+				m_bEndless = true;
+			}
+		}
+		if (matches == 0)
+		{
+			LOG_WARNING("Animation of clip %s bound to no node %s%s", m_clips[bindLine.clipIndex].name.c_str(),
+				bindLine.tag.c_str(), (bindLine.bPrefix == true) ? "*" : "");
+		}
+	}
+
+	// the binding above each node, then the nested bindings, which
+	// stay on the CPU
+	std::vector<int> bindingsAbove(nodeCount, -1);
+	size_t nestedCount = 0;
+	for (int i = 0; i < nodeCount; i++)
+	{
+		int parentID = transforms.GetNodeParent(i);
+		if (parentID >= 0)
+		{
+			bindingsAbove[i] = (nodeBindings[parentID] >= 0) ? nodeBindings[parentID] : bindingsAbove[parentID];
+		}
+		if ((nodeBindings[i] >= 0) && (bindingsAbove[i] >= 0))
+		{
+			nestedCount += (m_bindings[nodeBindings[i]].bGPU == true) ? 1 : 0;
+			nestedCount += (m_bindings[bindingsAbove[i]].bGPU == true) ? 1 : 0;
+			m_bindings[nodeBindings[i]].bGPU = false;
+			m_bindings[bindingsAbove[i]].bGPU = false;
+		}
+	}
+	bool bGPU = (m_bGPUAllowed == true) && (0 != m_sampleProgram) &&
+		(m_bindings.size() - nestedCount >= GPU_MIN_BINDINGS) && (UploadClips() == true);
+	for (size_t i = 0; i < m_bindings.size(); i++)
+	{
+		m_bindings[i].bGPU = (m_bindings[i].bGPU == true) && (bGPU == true);
+		if (m_bindings[i].bGPU == false)
+		{
+			m_cpuBindings.push_back((uint32_t)i);
+		}
+	}
+	m_gpuBindingCount = m_bindings.size() - m_cpuBindings.size();
+	m_sampledScale.resize(m_cpuBindings.size());
+	m_sampledRotation.resize(m_cpuBindings.size());
+	m_sampledPosition.resize(m_cpuBindings.size());
+
+	// the draws the pass poses, each one's box widened around the
+	// poses it goes through
+	if (m_gpuBindingCount > 0)
+	{
+		m_drawGPUBindings.assign(transforms.GetDrawCount(), -1);
+		for (uint32_t i = 0; i < (uint32_t)transforms.GetDrawCount(); i++)
+		{
+			int nodeID = transforms.GetDrawNode(i);
+			if (nodeID < 0)
+			{
+				continue;
+			}
+			int bindingIndex = (nodeBindings[nodeID] >= 0) ? nodeBindings[nodeID] : bindingsAbove[nodeID];
+			if ((bindingIndex < 0) || (m_bindings[bindingIndex].bGPU == false))
+			{
+				continue;
+			}
+
+			const NODE_BINDING& binding = m_bindings[bindingIndex];
+			glm::mat4 offset = glm::inverse(transforms.GetNodeWorld(binding.nodeID)) * transforms.GetDrawModel(i);
+			transforms.SetDrawMeshBounds(i, GetSweepBounds(binding, offset, transforms.GetDrawMeshBounds(i)));
+			m_drawGPUBindings[i] = bindingIndex;
+		}
+	}
+
+	m_stats.bindings = m_bindings.size();
+	m_stats.gpuBindings = m_gpuBindingCount;
+	if (m_bindings.empty() == false)
+	{
+		LOG_INFO("Animated %zu nodes, %zu of them on the GPU", m_bindings.size(), m_gpuBindingCount);
+	}
+}
+
+/***********************************************************
+ *  IsPlaying()
+ *
+ *  This method is used for telling whether the bound clips
+ *  still change the scene, which a looping one always does
+ *  and a once one until it ended and its last pose was set.
+ ***********************************************************/
+bool SceneAnimation::IsPlaying(double time) const
+{
+	if (m_bindings.empty() == true)
+	{
+		return(false);
+	}
+	return((m_bEndless == true) || (time < m_endTime) || (m_lastEvaluated < m_endTime));
+}
+
+/***********************************************************
+ *  GetClipTime()
+ *
+ *  This method is used for mapping the time of the scene to
+ *  the time into the clip of a binding, which holds the
+ *  first pose until the binding starts.
+ ***********************************************************/
+float SceneAnimation::GetClipTime(const NODE_BINDING& binding, double time) const
+{
+	const ANIMATION_CLIP& clip = m_clips[binding.clipIndex];
+	float clipTime = (float)((time - binding.start) * binding.speed);
+	if (clipTime <= 0.0f)
+	{
+		return(0.0f);
+	}
+
+	if (clip.playback == PLAYBACK_LOOP)
+	{
+		return(fmodf(clipTime, clip.duration));
+	}
+	if (clip.playback == PLAYBACK_PINGPONG)
+	{
+		clipTime = fmodf(clipTime, 2.0f * clip.duration);
+		return((clipTime > clip.duration) ? 2.0f * clip.duration - clipTime : clipTime);
+	}
+	return(std::min(clipTime, clip.duration));
+}
+
+/***********************************************************
+ *  SampleClip()
+ *
+ *  This method is used for sampling the channels of a clip
+ *  at a time into it. A channel holds its first key before
+ *  it and its last key after it; a property no channel
+ *  keys is left as it is.
+ ***********************************************************/
+void SceneAnimation::SampleClip(int clipIndex, float clipTime,
+	glm::vec3& scale, glm::vec3& rotation, glm::vec3& position) const
+{
+	scale = glm::vec3(1.0f);
+	rotation = glm::vec3(0.0f);
+	position = glm::vec3(0.0f);
+
+	const ANIMATION_CLIP& clip = m_clips[clipIndex];
+	for (uint32_t c = clip.firstChannel; c < clip.firstChannel + clip.channelCount; c++)
+	{
+		const ANIMATION_CHANNEL& channel = m_channels[c];
+		const ANIMATION_KEY* pFirst = &m_keys[channel.firstKey];
+		const ANIMATION_KEY* pLast = pFirst + channel.keyCount - 1;
+
+		glm::vec3 value;
+		if (clipTime <= pFirst->time)
+		{
+			value = pFirst->value;
+		}
+		else if (clipTime >= pLast->time)
+		{
+			value = pLast->value;
+		}
+		else
+		{
+			// the last key at or before the time, and the one after
+			const ANIMATION_KEY* pNext = std::upper_bound(pFirst, pLast + 1, clipTime,
+				[](float t, const ANIMATION_KEY& key) { return(t < key.time); });
+			const ANIMATION_KEY* pKey = pNext - 1;
+			float weight = (clipTime - pKey->time) / (pNext->time - pKey->time);
+			if (channel.interpolation == INTERPOLATION_STEP)
+			{
+				weight = 0.0f;
+			}
+			else if (channel.interpolation == INTERPOLATION_SMOOTH)
+			{
+				weight = weight * weight * (3.0f - 2.0f * weight);
+			}
+			value = glm::mix(pKey->value, pNext->value, weight);
+		}
+
+		if (channel.property == PROPERTY_SCALE)
+		{
+			scale = value;
+		}
+		else if (channel.property == PROPERTY_ROTATION)
+		{
+			rotation = value;
+		}
+		else
+		{
+			position = value;
+		}
+	}
+}
+
+/***********************************************************
+ *  GetSweepBounds()
+ *
+ *  This method is used for the mesh space box around the
+ *  poses of a draw of a GPU binding, taken at every key of
+ *  the clip and at even steps between. A pose relative to
+ *  the rest one is offset^-1 rest^-1 pose offset in the
+ *  space of the mesh.
+ ***********************************************************/
+SceneBVH::AABB SceneAnimation::GetSweepBounds(const NODE_BINDING& binding, const glm::mat4& offset,
+	const SceneBVH::AABB& meshBounds) const
+{
+	const ANIMATION_CLIP& clip = m_clips[binding.clipIndex];
+	std::vector<float> times;
+	for (int i = 0; i <= SWEEP_SAMPLES; i++)
+	{
+		times.push_back(clip.duration * (float)i / (float)SWEEP_SAMPLES);
+	}
+	for (uint32_t c = clip.firstChannel; c < clip.firstChannel + clip.channelCount; c++)
+	{
+		for (uint32_t k = 0; k < m_channels[c].keyCount; k++)
+		{
+			times.push_back(m_keys[m_channels[c].firstKey + k].time);
+		}
+	}
+
+	glm::mat4 toRest = glm::inverse(offset) *
+		glm::inverse(ComposeModelMatrix(binding.restScale, binding.restRotation, binding.restPosition));
+	SceneBVH::AABB sweep = SceneBVH::EmptyBounds();
+	for (size_t i = 0; i < times.size(); i++)
+	{
+		glm::vec3 scale;
+		glm::vec3 rotation;
+		glm::vec3 position;
+		SampleClip(binding.clipIndex, glm::clamp(times[i], 0.0f, clip.duration), scale, rotation, position);
+		glm::mat4 pose = toRest * ComposeModelMatrix(binding.restScale * scale,
+			binding.restRotation + rotation, binding.restPosition + position) * offset;
+		SceneBVH::AABB moved = TransformBox(pose, meshBounds);
+		sweep.minXYZ = glm::min(sweep.minXYZ, moved.minXYZ);
+		sweep.maxXYZ = glm::max(sweep.maxXYZ, moved.maxXYZ);
+	}
+	return(sweep);
+}
+
+/***********************************************************
+ *  Evaluate()
+ *
+ *  This method is used for posing the nodes of the CPU
+ *  bindings: the clips are sampled in parallel, each range
+ *  writing its own poses, then set on the nodes on the
+ *  calling thread, since setting one marks the hierarchy.
+ *  Once every clip ended and its last pose was set nothing
+ *  is sampled any more.
+ ***********************************************************/
+void SceneAnimation::Evaluate(double time, SceneTransforms& transforms, JobSystem* pJobSystem)
+{
+	if ((m_cpuBindings.empty() == true) || (IsPlaying(time) == false))
+	{
+		m_lastEvaluated = time;
+		return;
+	}
+
+	double startTime = GetSeconds();
+	auto sample = [this, time](size_t first, size_t end)
+	{
+		for (size_t i = first; i < end; i++)
+		{
+			const NODE_BINDING& binding = m_bindings[m_cpuBindings[i]];
+			glm::vec3 scale;
+			glm::vec3 rotation;
+			glm::vec3 position;
+			SampleClip(binding.clipIndex, GetClipTime(binding, time), scale, rotation, position);
+			m_sampledScale[i] = binding.restScale * scale;
+			m_sampledRotation[i] = binding.restRotation + rotation;
+			m_sampledPosition[i] = binding.restPosition + position;
+		}
+	};
+	if (NULL == pJobSystem)
+	{
+		sample((size_t)0, m_cpuBindings.size());
+	}
+	else
+	{
+		pJobSystem->ParallelFor(m_cpuBindings.size(), PARALLEL_MIN_BINDINGS, sample);
+	}
+
+	for (size_t i = 0; i < m_cpuBindings.size(); i++)
+	{
+		transforms.SetNodeTransform(m_bindings[m_cpuBindings[i]].nodeID,
+			m_sampledScale[i], m_sampledRotation[i], m_sampledPosition[i]);
+	}
+	m_lastEvaluated = time;
+
+	double seconds = GetSeconds() - startTime;
+	m_stats.frames++;
+	m_stats.cpuSamples += m_cpuBindings.size();
+	m_stats.sampleSeconds += seconds;
+	m_stats.sampleMaxSeconds = std::max(m_stats.sampleMaxSeconds, seconds);
+}
+
+/***********************************************************
+ *  BuildRecords()
+ *
+ *  This method is used for listing the draws of an instance
+ *  order the GPU poses, with the world their binding's node
+ *  hangs from and where each draw sits under the node, read
+ *  from the transforms as they are now, so a parent moved
+ *  on the CPU carries the posed draws along.
+ ***********************************************************/
+void SceneAnimation::BuildRecords(const std::vector<uint32_t>& instanceOrder, const SceneTransforms& transforms)
+{
+	m_records.clear();
+	m_bRecordsCurrent = false;
+	if (m_gpuBindingCount == 0)
+	{
+		return;
+	}
+
+	for (size_t i = 0; i < instanceOrder.size(); i++)
+	{
+		uint32_t drawIndex = instanceOrder[i];
+		// draws added after the binding are never posed
+		if ((drawIndex >= m_drawGPUBindings.size()) || (m_drawGPUBindings[drawIndex] < 0))
+		{
+			continue;
+		}
+
+		const NODE_BINDING& binding = m_bindings[m_drawGPUBindings[drawIndex]];
+		int parentID = transforms.GetNodeParent(binding.nodeID);
+
+		GPU_RECORD record;
+		record.parentWorld = (parentID >= 0) ? transforms.GetNodeWorld(parentID) : glm::mat4(1.0f);
+		record.offset = glm::inverse(transforms.GetNodeWorld(binding.nodeID)) * transforms.GetDrawModel(drawIndex);
+		record.restScale = glm::vec4(binding.restScale, binding.start);
+		record.restRotation = glm::vec4(binding.restRotation, binding.speed);
+		record.restPosition = glm::vec4(binding.restPosition, 0.0f);
+		record.clipIndex = (uint32_t)binding.clipIndex;
+		record.instance = (uint32_t)i;
+		record.unused[0] = 0;
+		record.unused[1] = 0;
+		m_records.push_back(record);
+	}
+}
+
+/***********************************************************
+ *  Dispatch()
+ *
+ *  This method is used for posing the listed draws in the
+ *  instance data of the frame, one invocation per draw.
+ *  The records stay in a buffer of their own, into which
+ *  only the ones a new order changed are copied. The
+ *  barrier makes the matrices visible to the texel fetches
+ *  of the draws and of the culling passes.
+ ***********************************************************/
+bool SceneAnimation::Dispatch(UploadRing* pUploadRing, GLuint instanceBuffer, int instanceBase, double time)
+{
+	if ((0 == m_sampleProgram) || (m_records.empty() == true) || (0 == instanceBuffer))
+	{
+		return(false);
+	}
+	if (m_bRecordsCurrent == false)
+	{
+		if (m_recordBuffer.Update(pUploadRing, &m_records[0], m_records.size()) == false)
+		{
+			return(false);
+		}
+		m_bRecordsCurrent = true;
+	}
+
+	m_pShaderManager->UseExternalProgram(m_sampleProgram);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, CLIPS_BINDING, m_clipBuffer.GetName());
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, CHANNELS_BINDING, m_channelBuffer.GetName());
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, KEYS_BINDING, m_keyBuffer.GetName());
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, RECORDS_BINDING, m_recordBuffer.GetBuffer());
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, INSTANCES_BINDING, instanceBuffer);
+	glUniform1f(m_timeLocation, (float)time);
+	glUniform1ui(m_instanceBaseLocation, (GLuint)instanceBase);
+	glUniform1ui(m_recordCountLocation, (GLuint)m_records.size());
+	glDispatchCompute((GLuint)((m_records.size() + SAMPLE_GROUP_SIZE - 1) / SAMPLE_GROUP_SIZE), 1, 1);
+	for (GLuint binding = CLIPS_BINDING; binding <= INSTANCES_BINDING; binding++)
+	{
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, binding, 0);
+	}
+	glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+
+	m_stats.dispatches++;
+	m_stats.gpuSamples += m_records.size();
+	return(true);
+}
+
+/***********************************************************
+ *  UploadClips()
+ *
+ *  This method is used for uploading the clips, channels
+ *  and keys once, as the uvec4 and vec4 arrays the compute
+ *  shader reads.
+ ***********************************************************/
+bool SceneAnimation::UploadClips()
+{
+	if (m_keyBuffer.IsCreated() == true)
+	{
+		return(true);
+	}
+
+	std::vector<glm::uvec4> clips(m_clips.size());
+	for (size_t i = 0; i < m_clips.size(); i++)
+	{
+		uint32_t durationBits;
+		memcpy(&durationBits, &m_clips[i].duration, sizeof(durationBits));
+		clips[i] = glm::uvec4(m_clips[i].firstChannel, m_clips[i].channelCount,
+			(uint32_t)m_clips[i].playback, durationBits);
+	}
+	std::vector<glm::uvec4> channels(m_channels.size());
+	for (size_t i = 0; i < m_channels.size(); i++)
+	{
+		channels[i] = glm::uvec4(m_channels[i].firstKey, m_channels[i].keyCount,
+			(uint32_t)m_channels[i].property, (uint32_t)m_channels[i].interpolation);
+	}
+	std::vector<glm::vec4> keys(m_keys.size());
+	for (size_t i = 0; i < m_keys.size(); i++)
+	{
+		keys[i] = glm::vec4(m_keys[i].value, m_keys[i].time);
+	}
+
+	// a clip without channels still has a clip, but maybe no keys
+	if (keys.empty() == true)
+	{
+		keys.push_back(glm::vec4(0.0f));
+	}
+	if (channels.empty() == true)
+	{
+		channels.push_back(glm::uvec4(0));
+	}
+
+	return((m_clipBuffer.Create(GPUBuffer::USAGE_STATIC, (GLsizeiptr)(clips.size() * sizeof(glm::uvec4)),
+		clips.data(), GPUMemory::CATEGORY_BUFFER, "animation clips") == true) &&
+		(m_channelBuffer.Create(GPUBuffer::USAGE_STATIC, (GLsizeiptr)(channels.size() * sizeof(glm::uvec4)),
+		channels.data(), GPUMemory::CATEGORY_BUFFER, "animation channels") == true) &&
+		(m_keyBuffer.Create(GPUBuffer::USAGE_STATIC, (GLsizeiptr)(keys.size() * sizeof(glm::vec4)),
+		keys.data(), GPUMemory::CATEGORY_BUFFER, "animation keys") == true));
+}
+
+/***********************************************************
+ *  PrintStats()
+ *
+ *  This method is used for printing the bindings and the
+ *  sampling of both paths for the exit report.
+ ***********************************************************/
+void SceneAnimation::PrintStats() const
+{
+	std::cout << "animated nodes " << m_stats.bindings
+		<< "\ton the GPU " << m_stats.gpuBindings
+		<< "\tskipped as baked " << m_stats.skipped << "\n";
+	if (m_stats.frames > 0)
+	{
+		std::cout << "animation CPU samples " << m_stats.cpuSamples
+			<< "\tframes " << m_stats.frames
+			<< "\tavg ms " << m_stats.sampleSeconds * 1000.0 / (double)m_stats.frames
+			<< "\tmax ms " << m_stats.sampleMaxSeconds * 1000.0 << "\n";
+	}
+	if (m_stats.dispatches > 0)
+	{
+		std::cout << "animation GPU samples " << m_stats.gpuSamples
+			<< "\tdispatches " << m_stats.dispatches << "\n";
+	}
+}
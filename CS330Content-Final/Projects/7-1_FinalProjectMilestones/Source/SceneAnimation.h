@@ -0,0 +1,251 @@
+///////////////////////////////////////////////////////////////////////////////
+// sceneanimation.h
+// ============
+// keyframed clips played on the scene nodes, on the CPU or the GPU
+//
+//  A clip is a set of channels, each one keying the scale, rotation
+//  or position of a node over time, stepped, linear or eased between
+//  the keys. Bound to the nodes of the scene by their tags, a clip is
+//  played on top of the transform each node was placed with, so the
+//  same door or drawer clip serves every copy of it. The bindings are
+//  sampled in parallel on the job system and set as the local
+//  transforms of their nodes, which the hierarchy takes from there.
+//  When many bindings can be, a compute pass samples them instead and
+//  writes the model and normal matrices of their draws straight into
+//  the instance data of the frame, so the CPU spends nothing per
+//  animated object on a frame.
+//
+//  The clip lines are
+//    clip <name> <seconds> <once|loop|pingpong>
+//    channel <scale|rotation|position> <step|linear|smooth>
+//    key <seconds> <x> <y> <z>
+//    bind <clip> <node> [<start> [<speed> [<stagger>]]]
+//  with the keys of a channel in time order, the scale keys factors
+//  and the others offsets in degrees and units. A node tag ending in
+//  * binds every node starting with the rest of it, each one started
+//  stagger seconds after the one before.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "DirtyRangeBuffer.h"
+#include "GPUBuffer.h"
+#include "JobSystem.h"
+#include "SceneTransforms.h"
+#include "ShaderManager.h"
+#include "UploadRing.h"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/***********************************************************
+ *  SceneAnimation
+ *
+ *  This class contains the clips of an animation file, the
+ *  nodes they are bound to, and the compute program and
+ *  buffers of the GPU path. Bind() resolves the bindings
+ *  against a recorded scene and picks the path of each;
+ *  every frame Evaluate() poses the nodes of the CPU path,
+ *  and Dispatch() the draws of the GPU path.
+ ***********************************************************/
+class SceneAnimation
+{
+public:
+	// constructor
+	SceneAnimation(ShaderManager* pShaderManager);
+	// destructor
+	~SceneAnimation();
+
+	// what a channel keys
+	enum CHANNEL_PROPERTY
+	{
+		PROPERTY_SCALE = 0,
+		PROPERTY_ROTATION,
+		PROPERTY_POSITION,
+		PROPERTY_COUNT
+	};
+
+	// how a channel goes from one key to the next
+	enum INTERPOLATION
+	{
+		INTERPOLATION_STEP = 0,
+		INTERPOLATION_LINEAR,
+		INTERPOLATION_SMOOTH	// eased in and out of every key
+	};
+
+	// what a clip does past its end
+	enum PLAYBACK
+	{
+		PLAYBACK_ONCE = 0,		// holds the last key
+		PLAYBACK_LOOP,
+		PLAYBACK_PINGPONG		// plays backwards, then forwards again
+	};
+
+	// bindings the GPU path takes over from, below which the compute
+	// pass costs more than the sampling it saves
+	static const size_t GPU_MIN_BINDINGS = 256;
+
+	// clips played since the start
+	struct ANIMATION_STATS
+	{
+		unsigned long long bindings;		// of the last Bind()
+		unsigned long long gpuBindings;		// of those, sampled on the GPU
+		unsigned long long skipped;			// bound nodes with baked draws
+		unsigned long long frames;			// frames that sampled the CPU bindings
+		unsigned long long cpuSamples;		// bindings sampled on the CPU
+		unsigned long long dispatches;		// passes of the GPU path
+		unsigned long long gpuSamples;		// draws they posed
+		// spent sampling and setting the CPU bindings of a frame
+		double sampleSeconds;
+		double sampleMaxSeconds;
+	};
+
+	// read an animation file; false when it cannot be read or has a
+	// malformed line
+	bool Load(const char* filename);
+	bool IsLoaded() const { return(m_clips.empty() == false); }
+	// build the compute program of the GPU path; false when the
+	// context has no compute shaders or the program fails to build
+	bool Create(const char* sampleShaderPath);
+	// let the GPU path take the bindings it can once there are
+	// GPU_MIN_BINDINGS of them
+	void SetGPUAllowed(bool bAllowed) { m_bGPUAllowed = bAllowed; }
+
+	// bind the clips to the nodes of a recorded scene, skipping the
+	// nodes with a draw under them baked as static, and widen the
+	// boxes of the draws the GPU poses to every pose of their clip
+	void Bind(SceneTransforms& transforms, const std::vector<unsigned char>& drawStatic);
+	// true while a bound clip still changes the scene at time
+	bool IsPlaying(double time) const;
+
+	// pose the nodes of the CPU path at time, in parallel on the job
+	// system when there is one
+	void Evaluate(double time, SceneTransforms& transforms, JobSystem* pJobSystem);
+	// list the draws the GPU poses among the instances of an order,
+	// for the next dispatches
+	void BuildRecords(const std::vector<uint32_t>& instanceOrder, const SceneTransforms& transforms);
+	// pose the listed draws at time in the instance data of a buffer
+	// starting at instanceBase; false when nothing was posed
+	bool Dispatch(UploadRing* pUploadRing, GLuint instanceBuffer, int instanceBase, double time);
+	bool HasGPUBindings() const { return(m_gpuBindingCount > 0); }
+
+	const ANIMATION_STATS& GetStats() const { return(m_stats); }
+	void PrintStats() const;
+
+private:
+	struct ANIMATION_KEY
+	{
+		float time;
+		glm::vec3 value;
+	};
+
+	struct ANIMATION_CHANNEL
+	{
+		int property;		// CHANNEL_PROPERTY
+		int interpolation;	// INTERPOLATION
+		uint32_t firstKey;
+		uint32_t keyCount;
+	};
+
+	struct ANIMATION_CLIP
+	{
+		std::string name;
+		float duration;
+		int playback;		// PLAYBACK
+		uint32_t firstChannel;
+		uint32_t channelCount;
+	};
+
+	// a bind line of the file
+	struct BIND_LINE
+	{
+		int clipIndex;
+		std::string tag;		// without the trailing *
+		bool bPrefix;
+		float start;
+		float speed;
+		float stagger;
+	};
+
+	// a clip bound to a node, and the transform it plays on
+	struct NODE_BINDING
+	{
+		int clipIndex;
+		int nodeID;
+		float start;
+		float speed;
+		glm::vec3 restScale;
+		glm::vec3 restRotation;
+		glm::vec3 restPosition;
+		bool bGPU;
+	};
+
+	// one posed draw as the compute shader reads it: the world of
+	// the node's parent, the draw relative to the node, and the
+	// rest transform, start and speed of the binding
+	struct GPU_RECORD
+	{
+		glm::mat4 parentWorld;
+		glm::mat4 offset;
+		glm::vec4 restScale;		// w is the start
+		glm::vec4 restRotation;		// w is the speed
+		glm::vec4 restPosition;
+		uint32_t clipIndex;
+		uint32_t instance;			// from instanceBase
+		uint32_t unused[2];
+	};
+
+	// pointer to shader manager object
+	ShaderManager* m_pShaderManager;
+	GLuint m_sampleProgram;
+	GLint m_timeLocation;
+	GLint m_instanceBaseLocation;
+	GLint m_recordCountLocation;
+	bool m_bGPUAllowed;
+
+	std::vector<ANIMATION_CLIP> m_clips;
+	std::vector<ANIMATION_CHANNEL> m_channels;
+	std::vector<ANIMATION_KEY> m_keys;
+	std::vector<BIND_LINE> m_bindLines;
+
+	std::vector<NODE_BINDING> m_bindings;
+	// CPU bindings, and the transforms they were last sampled to
+	std::vector<uint32_t> m_cpuBindings;
+	std::vector<glm::vec3> m_sampledScale;
+	std::vector<glm::vec3> m_sampledRotation;
+	std::vector<glm::vec3> m_sampledPosition;
+	// time past which no once clip changes, and whether a clip
+	// loops; the time of the last evaluation, negative for none
+	double m_endTime;
+	bool m_bEndless;
+	double m_lastEvaluated;
+
+	// GPU binding each draw is posed by, -1 for none, and the
+	// records of the last order
+	size_t m_gpuBindingCount;
+	std::vector<int> m_drawGPUBindings;
+	std::vector<GPU_RECORD> m_records;
+	DirtyRangeBuffer m_recordBuffer;
+	bool m_bRecordsCurrent;
+	// the clips, channels and keys, as the shader reads them
+	GPUBuffer m_clipBuffer;
+	GPUBuffer m_channelBuffer;
+	GPUBuffer m_keyBuffer;
+
+	ANIMATION_STATS m_stats;
+
+	// time into the clip of a binding at the time of the scene
+	float GetClipTime(const NODE_BINDING& binding, double time) const;
+	// the offsets of a clip at a time into it
+	void SampleClip(int clipIndex, float clipTime,
+		glm::vec3& scale, glm::vec3& rotation, glm::vec3& position) const;
+	// the box in mesh space around every pose of a draw of a GPU
+	// binding, offset being the draw relative to the bound node
+	SceneBVH::AABB GetSweepBounds(const NODE_BINDING& binding, const glm::mat4& offset,
+		const SceneBVH::AABB& meshBounds) const;
+	// upload the clips, channels and keys for the shader
+	bool UploadClips();
+};
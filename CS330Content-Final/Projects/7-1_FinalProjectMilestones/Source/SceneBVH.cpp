@@ -0,0 +1,751 @@
+///////////////////////////////////////////////////////////////////////////////
+// scenebvh.cpp
+// ============
+// bounding volume hierarchy over the world bounds of the scene draws
+//
+//  Built once over the recorded render list and refit in place
+//  when scene nodes move, for frustum culling, picking and light
+//  volume queries.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "SceneBVH.h"
+#include "SIMDMath.h"
+
+#include <algorithm>
+#include <cfloat>
+
+namespace
+{
+	// bit mask with one bit for each of the six frustum planes
+	const int ALL_FRUSTUM_PLANES = 0x3F;
+	// fewest objects a frustum query is split between threads for
+	const size_t PARALLEL_MIN_OBJECTS = 4096;
+	// subtrees a split frustum query aims to give every thread
+	const size_t SUBTREES_PER_THREAD = 4;
+
+	/***********************************************************
+	 *  MergeBounds()
+	 *
+	 *  This function is used for growing a box so it also
+	 *  contains a second box.
+	 ***********************************************************/
+	void MergeBounds(SceneBVH::AABB& bounds, const SceneBVH::AABB& other)
+	{
+		bounds.minXYZ = glm::min(bounds.minXYZ, other.minXYZ);
+		bounds.maxXYZ = glm::max(bounds.maxXYZ, other.maxXYZ);
+	}
+
+	/***********************************************************
+	 *  BoxesOverlap()
+	 *
+	 *  This function is used for testing two boxes for overlap,
+	 *  counting touching faces as overlap.
+	 ***********************************************************/
+	bool BoxesOverlap(const SceneBVH::AABB& a, const SceneBVH::AABB& b)
+	{
+		return((a.minXYZ.x <= b.maxXYZ.x) && (a.maxXYZ.x >= b.minXYZ.x) &&
+			(a.minXYZ.y <= b.maxXYZ.y) && (a.maxXYZ.y >= b.minXYZ.y) &&
+			(a.minXYZ.z <= b.maxXYZ.z) && (a.maxXYZ.z >= b.minXYZ.z));
+	}
+
+	/***********************************************************
+	 *  ClassifyBox()
+	 *
+	 *  This function is used for testing a box against the
+	 *  frustum planes still set in the plane mask. It returns
+	 *  -1 when the box is outside of a plane, or else the mask
+	 *  with the planes the box is fully inside of cleared, so
+	 *  children of the box skip those planes. With SSE2 or
+	 *  NEON four planes are tested at once, one per lane, with
+	 *  the same operations in the same order as the scalar
+	 *  test, so both give the same answers.
+	 ***********************************************************/
+	int ClassifyBox(const SceneBVH::AABB& box, const SceneBVH::FRUSTUM_PLANES& planes, int planeMask)
+	{
+#if SIMD_FLOAT4
+		const FLOAT4 zero = Float4Zero();
+		const FLOAT4 minX = Float4Set(box.minXYZ.x);
+		const FLOAT4 minY = Float4Set(box.minXYZ.y);
+		const FLOAT4 minZ = Float4Set(box.minXYZ.z);
+		const FLOAT4 maxX = Float4Set(box.maxXYZ.x);
+		const FLOAT4 maxY = Float4Set(box.maxXYZ.y);
+		const FLOAT4 maxZ = Float4Set(box.maxXYZ.z);
+		int outside = 0;
+		int inside = 0;
+		for (int p = 0; p < 8; p += 4)
+		{
+			FLOAT4 normalX = Float4Load(planes.normalX + p);
+			FLOAT4 normalY = Float4Load(planes.normalY + p);
+			FLOAT4 normalZ = Float4Load(planes.normalZ + p);
+			FLOAT4 distance = Float4Load(planes.distance + p);
+			FLOAT4 alongX = Float4GreaterEqual(normalX, zero);
+			FLOAT4 alongY = Float4GreaterEqual(normalY, zero);
+			FLOAT4 alongZ = Float4GreaterEqual(normalZ, zero);
+
+			// box corners farthest along and against the plane normals
+			FLOAT4 positive = Float4Add(Float4Add(Float4Add(
+				Float4Mul(normalX, Float4Select(alongX, maxX, minX)),
+				Float4Mul(normalY, Float4Select(alongY, maxY, minY))),
+				Float4Mul(normalZ, Float4Select(alongZ, maxZ, minZ))), distance);
+			FLOAT4 negative = Float4Add(Float4Add(Float4Add(
+				Float4Mul(normalX, Float4Select(alongX, minX, maxX)),
+				Float4Mul(normalY, Float4Select(alongY, minY, maxY))),
+				Float4Mul(normalZ, Float4Select(alongZ, minZ, maxZ))), distance);
+
+			outside |= Float4MaskBits(Float4LessThan(positive, zero)) << p;
+			inside |= Float4MaskBits(Float4GreaterEqual(negative, zero)) << p;
+		}
+
+		if ((outside & planeMask) != 0)
+		{
+			return(-1);
+		}
+		return(planeMask & ~inside);
+#else
+		for (int p = 0; p < 6; p++)
+		{
+			if ((planeMask & (1 << p)) == 0)
+			{
+				continue;
+			}
+
+			glm::vec3 normal(planes.normalX[p], planes.normalY[p], planes.normalZ[p]);
+			// box corners farthest along and against the plane normal
+			glm::vec3 positive(
+				(normal.x >= 0.0f) ? box.maxXYZ.x : box.minXYZ.x,
+				(normal.y >= 0.0f) ? box.maxXYZ.y : box.minXYZ.y,
+				(normal.z >= 0.0f) ? box.maxXYZ.z : box.minXYZ.z);
+			glm::vec3 negative(
+				(normal.x >= 0.0f) ? box.minXYZ.x : box.maxXYZ.x,
+				(normal.y >= 0.0f) ? box.minXYZ.y : box.maxXYZ.y,
+				(normal.z >= 0.0f) ? box.minXYZ.z : box.maxXYZ.z);
+
+			if (glm::dot(normal, positive) + planes.distance[p] < 0.0f)
+			{
+				return(-1);
+			}
+			if (glm::dot(normal, negative) + planes.distance[p] >= 0.0f)
+			{
+				planeMask &= ~(1 << p);
+			}
+		}
+
+		return(planeMask);
+#endif
+	}
+
+	/***********************************************************
+	 *  SplitPlanes()
+	 *
+	 *  This function is used for storing the six planes by
+	 *  component, the two padding lanes holding planes with no
+	 *  normal that every box is inside of.
+	 ***********************************************************/
+	void SplitPlanes(const glm::vec4 planes[6], SceneBVH::FRUSTUM_PLANES& split)
+	{
+		for (int p = 0; p < 8; p++)
+		{
+			glm::vec4 plane = (p < 6) ? planes[p] : glm::vec4(0.0f);
+			split.normalX[p] = plane.x;
+			split.normalY[p] = plane.y;
+			split.normalZ[p] = plane.z;
+			split.distance[p] = plane.w;
+		}
+	}
+
+	/***********************************************************
+	 *  IntersectRayBox()
+	 *
+	 *  This function is used for finding the distance along a
+	 *  ray where it enters a box with the slab method. A ray
+	 *  starting inside the box enters it at 0. An empty box,
+	 *  whose slabs would swap into one around everything, is
+	 *  never entered.
+	 ***********************************************************/
+	bool IntersectRayBox(
+		const glm::vec3& origin,
+		const glm::vec3& inverseDirection,
+		const SceneBVH::AABB& box,
+		float maxDistance,
+		float& entryDistance)
+	{
+		if (box.minXYZ.x > box.maxXYZ.x)
+		{
+			return(false);
+		}
+
+		glm::vec3 t0 = (box.minXYZ - origin) * inverseDirection;
+		glm::vec3 t1 = (box.maxXYZ - origin) * inverseDirection;
+		glm::vec3 tNear = glm::min(t0, t1);
+		glm::vec3 tFar = glm::max(t0, t1);
+
+		float entry = glm::max(glm::max(tNear.x, tNear.y), glm::max(tNear.z, 0.0f));
+		float exit = glm::min(glm::min(tFar.x, tFar.y), glm::min(tFar.z, maxDistance));
+		if (entry > exit)
+		{
+			return(false);
+		}
+
+		entryDistance = entry;
+		return(true);
+	}
+}
+
+/***********************************************************
+ *  SceneBVH()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+SceneBVH::SceneBVH()
+{
+	m_bDirty = false;
+}
+
+/***********************************************************
+ *  Build()
+ *
+ *  This method is used for building the tree over the boxes
+ *  of a new set of objects. Nodes are split at the median
+ *  center along their longest axis, which builds in
+ *  O(n log n) and keeps the tree balanced for the queries.
+ ***********************************************************/
+void SceneBVH::Build(const std::vector<AABB>& objectBounds)
+{
+	const uint32_t objectCount = (uint32_t)objectBounds.size();
+
+	m_objectBounds = objectBounds;
+	m_objectOrder.resize(objectCount);
+	m_objectLeaf.assign(objectCount, -1);
+	m_nodes.clear();
+	m_nodeDirty.clear();
+	m_bDirty = false;
+
+	if (objectCount == 0)
+	{
+		return;
+	}
+
+	std::vector<glm::vec3> centers(objectCount);
+	for (uint32_t i = 0; i < objectCount; i++)
+	{
+		m_objectOrder[i] = i;
+		centers[i] = (objectBounds[i].minXYZ + objectBounds[i].maxXYZ) * 0.5f;
+	}
+
+	// a binary tree with leaves of one or more objects has
+	// fewer than two nodes per object
+	m_nodes.reserve(2 * objectCount);
+
+	BVH_NODE root;
+	root.leftChild = -1;
+	root.parent = -1;
+	root.firstObject = 0;
+	root.objectCount = objectCount;
+	m_nodes.push_back(root);
+	BuildNode(0, centers);
+
+	m_nodeDirty.assign(m_nodes.size(), 0);
+}
+
+/***********************************************************
+ *  BuildNode()
+ *
+ *  This method is used for computing the box of a node and
+ *  splitting its objects between two children, until they
+ *  fit into a leaf.
+ ***********************************************************/
+void SceneBVH::BuildNode(int nodeIndex, const std::vector<glm::vec3>& centers)
+{
+	const uint32_t firstObject = m_nodes[nodeIndex].firstObject;
+	const uint32_t objectCount = m_nodes[nodeIndex].objectCount;
+
+	AABB bounds = m_objectBounds[m_objectOrder[firstObject]];
+	glm::vec3 centerMin = centers[m_objectOrder[firstObject]];
+	glm::vec3 centerMax = centerMin;
+	for (uint32_t i = firstObject + 1; i < firstObject + objectCount; i++)
+	{
+		MergeBounds(bounds, m_objectBounds[m_objectOrder[i]]);
+		centerMin = glm::min(centerMin, centers[m_objectOrder[i]]);
+		centerMax = glm::max(centerMax, centers[m_objectOrder[i]]);
+	}
+	m_nodes[nodeIndex].bounds = bounds;
+
+	glm::vec3 extent = centerMax - centerMin;
+	if ((objectCount <= MAX_LEAF_OBJECTS) ||
+		((extent.x <= 0.0f) && (extent.y <= 0.0f) && (extent.z <= 0.0f)))
+	{
+		for (uint32_t i = firstObject; i < firstObject + objectCount; i++)
+		{
+			m_objectLeaf[m_objectOrder[i]] = nodeIndex;
+		}
+		return;
+	}
+
+	int axis = 0;
+	if (extent.y > extent[axis])
+	{
+		axis = 1;
+	}
+	if (extent.z > extent[axis])
+	{
+		axis = 2;
+	}
+
+	// partition the range around its median center
+	const uint32_t leftCount = objectCount / 2;
+	std::vector<uint32_t>::iterator first = m_objectOrder.begin() + firstObject;
+	std::nth_element(first, first + leftCount, first + objectCount,
+		[&centers, axis](uint32_t a, uint32_t b) { return(centers[a][axis] < centers[b][axis]); });
+
+	BVH_NODE child;
+	child.bounds = bounds;
+	child.leftChild = -1;
+	child.parent = nodeIndex;
+
+	const int leftChild = (int)m_nodes.size();
+	child.firstObject = firstObject;
+	child.objectCount = leftCount;
+	m_nodes.push_back(child);
+	child.firstObject = firstObject + leftCount;
+	child.objectCount = objectCount - leftCount;
+	m_nodes.push_back(child);
+	m_nodes[nodeIndex].leftChild = leftChild;
+
+	BuildNode(leftChild, centers);
+	BuildNode(leftChild + 1, centers);
+}
+
+/***********************************************************
+ *  SetObjectBounds()
+ *
+ *  This method is used for changing the box of an object
+ *  that moved. The node boxes are only refit by the next
+ *  Refit(), so any number of objects can move first.
+ ***********************************************************/
+void SceneBVH::SetObjectBounds(uint32_t objectIndex, const AABB& bounds)
+{
+	if (objectIndex >= m_objectBounds.size())
+	{
+		return;
+	}
+
+	m_objectBounds[objectIndex] = bounds;
+	m_nodeDirty[m_objectLeaf[objectIndex]] = 1;
+	m_bDirty = true;
+}
+
+/***********************************************************
+ *  EmptyBounds()
+ *
+ *  This method is used for getting the box of an object
+ *  taken out of the tree without a rebuild. Its minimum is
+ *  above its maximum, so merging it into a node box leaves
+ *  that box as it was, it overlaps no box, and every
+ *  frustum plane finds it outside.
+ ***********************************************************/
+SceneBVH::AABB SceneBVH::EmptyBounds()
+{
+	AABB bounds;
+	bounds.minXYZ = glm::vec3(FLT_MAX, FLT_MAX, FLT_MAX);
+	bounds.maxXYZ = glm::vec3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+	return(bounds);
+}
+
+/***********************************************************
+ *  UpdateNodeBounds()
+ *
+ *  This method is used for recomputing the box of a leaf
+ *  from its objects, or of an inner node from its children.
+ ***********************************************************/
+void SceneBVH::UpdateNodeBounds(int nodeIndex)
+{
+	BVH_NODE& node = m_nodes[nodeIndex];
+
+	if (node.leftChild < 0)
+	{
+		node.bounds = m_objectBounds[m_objectOrder[node.firstObject]];
+		for (uint32_t i = node.firstObject + 1; i < node.firstObject + node.objectCount; i++)
+		{
+			MergeBounds(node.bounds, m_objectBounds[m_objectOrder[i]]);
+		}
+	}
+	else
+	{
+		node.bounds = m_nodes[node.leftChild].bounds;
+		MergeBounds(node.bounds, m_nodes[node.leftChild + 1].bounds);
+	}
+}
+
+/***********************************************************
+ *  Refit()
+ *
+ *  This method is used for refitting the node boxes above
+ *  the objects changed by SetObjectBounds(). Children are
+ *  stored after their parents, so walking the nodes from
+ *  the back updates every child before its parent, and only
+ *  the paths from the changed leaves to the root are
+ *  recomputed. The tree keeps its structure, so it loosens
+ *  if objects move far and can be rebuilt with Build().
+ ***********************************************************/
+void SceneBVH::Refit()
+{
+	if (m_bDirty == false)
+	{
+		return;
+	}
+
+	for (int i = (int)m_nodes.size() - 1; i >= 0; i--)
+	{
+		if (m_nodeDirty[i] == 0)
+		{
+			continue;
+		}
+
+		UpdateNodeBounds(i);
+		if (m_nodes[i].parent >= 0)
+		{
+			m_nodeDirty[m_nodes[i].parent] = 1;
+		}
+		m_nodeDirty[i] = 0;
+	}
+
+	m_bDirty = false;
+}
+
+/***********************************************************
+ *  QueryFrustum()
+ *
+ *  This method is used for collecting the objects that are
+ *  not fully outside of the frustum. With a job system and
+ *  a large tree, the top of the tree is classified here
+ *  until there are a few subtrees per thread, which are
+ *  then queried as jobs and appended in their tree order,
+ *  so the result does not depend on the thread count.
+ ***********************************************************/
+void SceneBVH::QueryFrustum(const glm::vec4 frustumPlanes[6], std::vector<uint32_t>& objects, JobSystem* pJobSystem) const
+{
+	if (m_nodes.empty() == true)
+	{
+		return;
+	}
+	FRUSTUM_PLANES planes;
+	SplitPlanes(frustumPlanes, planes);
+	if ((NULL == pJobSystem) || (pJobSystem->GetThreadCount() <= 1) ||
+		(m_objectBounds.size() < PARALLEL_MIN_OBJECTS))
+	{
+		QuerySubtree(0, ALL_FRUSTUM_PLANES, planes, m_stack, objects);
+		return;
+	}
+
+	// node index and plane mask pairs of the subtrees to query,
+	// split until every thread has a few of them to steal from
+	const size_t subtreeTarget = (size_t)pJobSystem->GetThreadCount() * SUBTREES_PER_THREAD;
+	std::vector<int>& subtrees = m_subtrees;
+	std::vector<int>& nextSubtrees = m_stack;
+	subtrees.clear();
+	subtrees.push_back(0);
+	subtrees.push_back(ALL_FRUSTUM_PLANES);
+	bool bSplit = true;
+	while ((bSplit == true) && (subtrees.size() / 2 < subtreeTarget))
+	{
+		bSplit = false;
+		nextSubtrees.clear();
+		for (size_t i = 0; i < subtrees.size(); i += 2)
+		{
+			const BVH_NODE& node = m_nodes[subtrees[i]];
+			int planeMask = ClassifyBox(node.bounds, planes, subtrees[i + 1]);
+			if (planeMask < 0)
+			{
+				continue;
+			}
+			if ((planeMask == 0) || (node.leftChild < 0))
+			{
+				nextSubtrees.push_back(subtrees[i]);
+				nextSubtrees.push_back(subtrees[i + 1]);
+				continue;
+			}
+			nextSubtrees.push_back(node.leftChild);
+			nextSubtrees.push_back(planeMask);
+			nextSubtrees.push_back(node.leftChild + 1);
+			nextSubtrees.push_back(planeMask);
+			bSplit = true;
+		}
+		subtrees.swap(nextSubtrees);
+	}
+
+	const size_t subtreeCount = subtrees.size() / 2;
+	if (m_subtreeObjects.size() < subtreeCount)
+	{
+		m_subtreeObjects.resize(subtreeCount);
+	}
+	pJobSystem->ParallelFor(subtreeCount, 1, [this, &planes](size_t first, size_t end)
+		{
+			std::vector<int> stack;
+			for (size_t i = first; i < end; i++)
+			{
+				m_subtreeObjects[i].clear();
+				QuerySubtree(m_subtrees[i * 2], m_subtrees[i * 2 + 1], planes, stack, m_subtreeObjects[i]);
+			}
+		});
+	for (size_t i = 0; i < subtreeCount; i++)
+	{
+		objects.insert(objects.end(), m_subtreeObjects[i].begin(), m_subtreeObjects[i].end());
+	}
+}
+
+/***********************************************************
+ *  QuerySubtree()
+ *
+ *  This method is used for collecting the objects of one
+ *  subtree that are not fully outside of the frustum. A
+ *  node outside of any plane skips its whole subtree, and
+ *  planes a node is fully inside of are not tested again
+ *  below it, so a subtree inside the frustum is appended
+ *  without further tests.
+ ***********************************************************/
+void SceneBVH::QuerySubtree(int nodeIndex, int rootPlaneMask, const FRUSTUM_PLANES& planes,
+	std::vector<int>& stack, std::vector<uint32_t>& objects) const
+{
+	// node index and plane mask pairs
+	stack.clear();
+	stack.push_back(nodeIndex);
+	stack.push_back(rootPlaneMask);
+	while (stack.empty() == false)
+	{
+		int planeMask = stack.back();
+		stack.pop_back();
+		const BVH_NODE& node = m_nodes[stack.back()];
+		stack.pop_back();
+
+		planeMask = ClassifyBox(node.bounds, planes, planeMask);
+		if (planeMask < 0)
+		{
+			continue;
+		}
+
+		if (planeMask == 0)
+		{
+			objects.insert(objects.end(),
+				m_objectOrder.begin() + node.firstObject,
+				m_objectOrder.begin() + node.firstObject + node.objectCount);
+		}
+		else if (node.leftChild < 0)
+		{
+			for (uint32_t i = node.firstObject; i < node.firstObject + node.objectCount; i++)
+			{
+				if (ClassifyBox(m_objectBounds[m_objectOrder[i]], planes, planeMask) >= 0)
+				{
+					objects.push_back(m_objectOrder[i]);
+				}
+			}
+		}
+		else
+		{
+			stack.push_back(node.leftChild);
+			stack.push_back(planeMask);
+			stack.push_back(node.leftChild + 1);
+			stack.push_back(planeMask);
+		}
+	}
+}
+
+/***********************************************************
+ *  QueryBox()
+ *
+ *  This method is used for collecting the objects whose box
+ *  overlaps a box, such as the volume lit by a light.
+ ***********************************************************/
+void SceneBVH::QueryBox(const AABB& box, std::vector<uint32_t>& objects) const
+{
+	if (m_nodes.empty() == true)
+	{
+		return;
+	}
+
+	m_stack.clear();
+	m_stack.push_back(0);
+	while (m_stack.empty() == false)
+	{
+		const BVH_NODE& node = m_nodes[m_stack.back()];
+		m_stack.pop_back();
+
+		if (BoxesOverlap(node.bounds, box) == false)
+		{
+			continue;
+		}
+
+		if (node.leftChild < 0)
+		{
+			for (uint32_t i = node.firstObject; i < node.firstObject + node.objectCount; i++)
+			{
+				if (BoxesOverlap(m_objectBounds[m_objectOrder[i]], box) == true)
+				{
+					objects.push_back(m_objectOrder[i]);
+				}
+			}
+		}
+		else
+		{
+			m_stack.push_back(node.leftChild);
+			m_stack.push_back(node.leftChild + 1);
+		}
+	}
+}
+
+/***********************************************************
+ *  Raycast()
+ *
+ *  This method is used for finding the object whose box is
+ *  entered first along a ray, for picking. Subtrees that
+ *  start behind the closest hit so far are skipped. The hit
+ *  is against the object's box, not its triangles.
+ ***********************************************************/
+int SceneBVH::Raycast(
+	const glm::vec3& origin,
+	const glm::vec3& direction,
+	float maxDistance,
+	float& hitDistance) const
+{
+	int hitObject = -1;
+	float closest = maxDistance;
+
+	if (m_nodes.empty() == true)
+	{
+		return(hitObject);
+	}
+
+	// infinite components for axis aligned rays are fine for the slabs
+	glm::vec3 inverseDirection = 1.0f / direction;
+
+	m_stack.clear();
+	m_stack.push_back(0);
+	while (m_stack.empty() == false)
+	{
+		const BVH_NODE& node = m_nodes[m_stack.back()];
+		m_stack.pop_back();
+
+		float entry = 0.0f;
+		if (IntersectRayBox(origin, inverseDirection, node.bounds, closest, entry) == false)
+		{
+			continue;
+		}
+
+		if (node.leftChild < 0)
+		{
+			for (uint32_t i = node.firstObject; i < node.firstObject + node.objectCount; i++)
+			{
+				if ((IntersectRayBox(origin, inverseDirection,
+					m_objectBounds[m_objectOrder[i]], closest, entry) == true) &&
+					((hitObject < 0) || (entry < closest)))
+				{
+					closest = entry;
+					hitObject = (int)m_objectOrder[i];
+				}
+			}
+		}
+		else
+		{
+			m_stack.push_back(node.leftChild);
+			m_stack.push_back(node.leftChild + 1);
+		}
+	}
+
+	if (hitObject >= 0)
+	{
+		hitDistance = closest;
+	}
+	return(hitObject);
+}
+
+/***********************************************************
+ *  Raycast()
+ *
+ *  This method is used for finding the object whose surface
+ *  a ray hits first. Every object whose box is entered before
+ *  the closest hit so far is handed to the exact test, and
+ *  of the two children of a node the one entered first is
+ *  visited first, so the hits found early cut off the boxes
+ *  further along.
+ ***********************************************************/
+int SceneBVH::Raycast(
+	const glm::vec3& origin,
+	const glm::vec3& direction,
+	float maxDistance,
+	const RAY_OBJECT_TEST& objectTest,
+	std::vector<int>& stack,
+	float& hitDistance) const
+{
+	int hitObject = -1;
+	float closest = maxDistance;
+
+	if (m_nodes.empty() == true)
+	{
+		return(hitObject);
+	}
+
+	glm::vec3 inverseDirection = 1.0f / direction;
+
+	stack.clear();
+	stack.push_back(0);
+	while (stack.empty() == false)
+	{
+		const BVH_NODE& node = m_nodes[stack.back()];
+		stack.pop_back();
+
+		// tested again on the way out, a hit since the push may have
+		// moved the closest distance in front of the box
+		float entry = 0.0f;
+		if (IntersectRayBox(origin, inverseDirection, node.bounds, closest, entry) == false)
+		{
+			continue;
+		}
+
+		if (node.leftChild < 0)
+		{
+			for (uint32_t i = node.firstObject; i < node.firstObject + node.objectCount; i++)
+			{
+				uint32_t objectIndex = m_objectOrder[i];
+				float distance = 0.0f;
+				if ((IntersectRayBox(origin, inverseDirection,
+					m_objectBounds[objectIndex], closest, entry) == true) &&
+					(objectTest(objectIndex, closest, distance) == true) &&
+					(distance <= closest))
+				{
+					closest = distance;
+					hitObject = (int)objectIndex;
+				}
+			}
+		}
+		else
+		{
+			float leftEntry = 0.0f;
+			float rightEntry = 0.0f;
+			bool bLeft = IntersectRayBox(origin, inverseDirection,
+				m_nodes[node.leftChild].bounds, closest, leftEntry);
+			bool bRight = IntersectRayBox(origin, inverseDirection,
+				m_nodes[node.leftChild + 1].bounds, closest, rightEntry);
+
+			// the child entered first goes on top
+			if ((bLeft == true) && (bRight == true))
+			{
+				bool bLeftFirst = (leftEntry <= rightEntry);
+				stack.push_back((bLeftFirst == true) ? node.leftChild + 1 : node.leftChild);
+				stack.push_back((bLeftFirst == true) ? node.leftChild : node.leftChild + 1);
+			}
+			else if (bLeft == true)
+			{
+				stack.push_back(node.leftChild);
+			}
+			else if (bRight == true)
+			{
+				stack.push_back(node.leftChild + 1);
+			}
+		}
+	}
+
+	if (hitObject >= 0)
+	{
+		hitDistance = closest;
+	}
+	return(hitObject);
+}
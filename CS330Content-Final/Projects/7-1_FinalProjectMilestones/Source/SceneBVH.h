@@ -0,0 +1,135 @@
+///////////////////////////////////////////////////////////////////////////////
+// scenebvh.h
+// ============
+// bounding volume hierarchy over the world bounds of the scene draws
+//
+//  Built once over the recorded render list and refit in place
+//  when scene nodes move, for frustum culling, picking and light
+//  volume queries.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "JobSystem.h"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+/***********************************************************
+ *  SceneBVH
+ *
+ *  This class contains a binary tree of axis aligned boxes
+ *  over a set of objects, each known only by its index and
+ *  its box. The objects of a leaf are stored contiguously
+ *  in the object order, so a whole subtree is one range.
+ ***********************************************************/
+class SceneBVH
+{
+public:
+	// constructor
+	SceneBVH();
+
+	// world space axis aligned box
+	struct AABB
+	{
+		glm::vec3 minXYZ;
+		glm::vec3 maxXYZ;
+	};
+
+	// one node of the tree; leaves have no children and own
+	// objectCount entries of the object order
+	struct BVH_NODE
+	{
+		AABB bounds;
+		int leftChild;		// -1 for a leaf, right child is leftChild + 1
+		int parent;			// -1 for the root
+		uint32_t firstObject;	// first entry of the subtree in the object order
+		uint32_t objectCount;	// entries of the subtree in the object order
+	};
+
+	// the six frustum planes by component, padded to eight lanes
+	// with planes every box is inside of, so a box is tested
+	// against four planes at a time
+	struct FRUSTUM_PLANES
+	{
+		float normalX[8];
+		float normalY[8];
+		float normalZ[8];
+		float distance[8];
+	};
+
+	// exact test of an object whose box a ray enters, giving the
+	// distance of its surface when that is nearer than maxDistance
+	typedef std::function<bool(uint32_t objectIndex, float maxDistance, float& hitDistance)> RAY_OBJECT_TEST;
+
+	// objects a leaf holds before it is split
+	static const uint32_t MAX_LEAF_OBJECTS = 4;
+
+	// build the tree over the boxes, indexed by object
+	void Build(const std::vector<AABB>& objectBounds);
+	// change the box of one object, applied by the next Refit()
+	void SetObjectBounds(uint32_t objectIndex, const AABB& bounds);
+	// a box no query finds, which takes an object out of the tree
+	// until it is given a box again
+	static AABB EmptyBounds();
+	// grow or shrink the node boxes above the changed objects
+	void Refit();
+
+	// append the objects whose box is inside or crosses all six
+	// planes, each a normalized (normal, distance) inward plane;
+	// a large tree is split between the threads of the job system
+	void QueryFrustum(const glm::vec4 planes[6], std::vector<uint32_t>& objects, JobSystem* pJobSystem = NULL) const;
+	// append the objects whose box overlaps the box
+	void QueryBox(const AABB& box, std::vector<uint32_t>& objects) const;
+	// find the nearest object box hit by the ray, -1 for none
+	int Raycast(
+		const glm::vec3& origin,
+		const glm::vec3& direction,
+		float maxDistance,
+		float& hitDistance) const;
+	// find the nearest object the exact test hits along the ray, -1
+	// for none; the nearer child is visited first so the boxes behind
+	// a hit are skipped, and the traversal stack is the caller's, so
+	// rays may be cast from several threads at once
+	int Raycast(
+		const glm::vec3& origin,
+		const glm::vec3& direction,
+		float maxDistance,
+		const RAY_OBJECT_TEST& objectTest,
+		std::vector<int>& stack,
+		float& hitDistance) const;
+
+	uint32_t GetObjectCount() const { return((uint32_t)m_objectBounds.size()); }
+	const std::vector<BVH_NODE>& GetNodes() const { return(m_nodes); }
+
+private:
+	// nodes with every child after its parent, root first
+	std::vector<BVH_NODE> m_nodes;
+	// box of every object, indexed by object
+	std::vector<AABB> m_objectBounds;
+	// object indexes grouped by leaf
+	std::vector<uint32_t> m_objectOrder;
+	// leaf node holding every object
+	std::vector<int> m_objectLeaf;
+	// 1 for every node whose box needs to be recomputed
+	std::vector<unsigned char> m_nodeDirty;
+	bool m_bDirty;
+	// traversal stack reused by the queries
+	mutable std::vector<int> m_stack;
+	// subtrees of a frustum query split between threads, as node
+	// index and plane mask pairs, and the objects each one found
+	mutable std::vector<int> m_subtrees;
+	mutable std::vector<std::vector<uint32_t>> m_subtreeObjects;
+
+	// split the object order range into the subtree of a node
+	void BuildNode(int nodeIndex, const std::vector<glm::vec3>& centers);
+	// recompute the box of a node from its objects or children
+	void UpdateNodeBounds(int nodeIndex);
+	// append the objects of a subtree inside the frustum, with the
+	// planes of rootPlaneMask left to test
+	void QuerySubtree(int nodeIndex, int rootPlaneMask, const FRUSTUM_PLANES& planes,
+		std::vector<int>& stack, std::vector<uint32_t>& objects) const;
+};
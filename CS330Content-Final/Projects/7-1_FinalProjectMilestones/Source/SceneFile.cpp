@@ -0,0 +1,920 @@
+///////////////////////////////////////////////////////////////////////////////
+// scenefile.cpp
+// ============
+// text and compiled binary descriptions of a scene
+//
+//  Lists the textures, materials, lights, models, prefabs and
+//  placed instances of a scene. The text form is written by hand; the
+//  compiled form holds the same records as fixed size arrays and
+//  is memory-mapped and read in place.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "SceneFile.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <utility>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+	// names of the SCENE_MESH values in the text form
+	const char* const MESH_NAMES[SceneFile::MESH_COUNT] =
+	{
+		"box",
+		"cone",
+		"cylinder",
+		"cylinder_open",
+		"cylinder_caps",
+		"cylinder_bottom",
+		"plane",
+		"prism",
+		"pyramid3",
+		"pyramid4",
+		"sphere",
+		"half_sphere",
+		"tapered_cylinder",
+		"torus",
+		"half_torus",
+		"model"
+	};
+
+	// prefix of a part mesh naming a model by its tag
+	const char* const MODEL_MESH_PREFIX = "model:";
+
+	// render list draws recorded for each SCENE_MESH value; every
+	// combination of cylinder pieces is one range of its mesh
+	const int MESH_DRAW_COUNTS[SceneFile::MESH_COUNT] =
+	{
+		1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1
+	};
+
+	// alignment of the section arrays in the image, so SIMD loads of
+	// mapped records never straddle it
+	const size_t SECTION_ALIGNMENT = 16;
+
+	// size of one record of each SCENE_SECTION
+	const size_t RECORD_SIZES[SceneFile::SECTION_COUNT] =
+	{
+		sizeof(SceneFile::TEXTURE_RECORD),
+		sizeof(SceneFile::MATERIAL_RECORD),
+		sizeof(SceneFile::LIGHT_RECORD),
+		sizeof(SceneFile::PART_RECORD),
+		sizeof(SceneFile::PREFAB_RECORD),
+		sizeof(SceneFile::INSTANCE_RECORD),
+		sizeof(SceneFile::MODEL_RECORD)
+	};
+
+	// copy value into a fixed length field, false when it does not fit
+	bool CopyField(char* pField, size_t fieldLength, const std::string& value)
+	{
+		if (value.size() >= fieldLength)
+		{
+			return(false);
+		}
+
+		memset(pField, 0, fieldLength);
+		memcpy(pField, value.c_str(), value.size());
+		return(true);
+	}
+
+	// read count floats from the rest of a line
+	bool ReadFloats(std::istringstream& line, float* pValues, int count)
+	{
+		for (int i = 0; i < count; i++)
+		{
+			if (!(line >> pValues[i]))
+			{
+				return(false);
+			}
+		}
+		return(true);
+	}
+
+	// index of the record whose name field matches, -1 if none does
+	template <typename RECORD>
+	int FindRecord(const std::vector<RECORD>& records, char (RECORD::*pName)[SceneFile::TAG_LENGTH], const std::string& name)
+	{
+		for (size_t i = 0; i < records.size(); i++)
+		{
+			if (name.compare(records[i].*pName) == 0)
+			{
+				return((int)i);
+			}
+		}
+		return(-1);
+	}
+
+	// SCENE_MESH value of a mesh name, -1 if it is not one
+	int FindMesh(const std::string& name)
+	{
+		for (int mesh = 0; mesh < SceneFile::MESH_COUNT; mesh++)
+		{
+			if (name.compare(MESH_NAMES[mesh]) == 0)
+			{
+				return(mesh);
+			}
+		}
+		return(-1);
+	}
+
+	// true when a fixed length field holds its terminator
+	bool IsTerminated(const char* pField, size_t fieldLength)
+	{
+		return(NULL != memchr(pField, '\0', fieldLength));
+	}
+}
+
+/***********************************************************
+ *  SceneFile()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+SceneFile::SceneFile()
+{
+	m_pImage = NULL;
+	m_imageSize = 0;
+	m_pMapping = NULL;
+}
+
+/***********************************************************
+ *  ~SceneFile()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+SceneFile::~SceneFile()
+{
+	Close();
+}
+
+/***********************************************************
+ *  Swap()
+ *
+ *  This method is used for exchanging the loaded images of
+ *  two descriptions. Swapping the vectors keeps their
+ *  storage, so an image compiled from text stays where its
+ *  pointer points.
+ ***********************************************************/
+void SceneFile::Swap(SceneFile& other)
+{
+	std::swap(m_pImage, other.m_pImage);
+	std::swap(m_imageSize, other.m_imageSize);
+	m_textImage.swap(other.m_textImage);
+	std::swap(m_pMapping, other.m_pMapping);
+}
+
+/***********************************************************
+ *  Close()
+ *
+ *  This method is used for dropping the loaded image and
+ *  unmapping the binary file it was read from.
+ ***********************************************************/
+void SceneFile::Close()
+{
+	if (NULL != m_pMapping)
+	{
+#ifdef _WIN32
+		UnmapViewOfFile(m_pMapping);
+#else
+		munmap(m_pMapping, m_imageSize);
+#endif
+		m_pMapping = NULL;
+	}
+
+	m_textImage.clear();
+	m_pImage = NULL;
+	m_imageSize = 0;
+}
+
+/***********************************************************
+ *  Load()
+ *
+ *  This method is used for loading a scene description in
+ *  either form. Files starting with the magic of the
+ *  compiled form are mapped, all others are read as text;
+ *  a description in the asset pack is loaded from its view.
+ ***********************************************************/
+bool SceneFile::Load(const char* filename)
+{
+	AssetPack::ASSET_VIEW view;
+	if (AssetPack::Find(filename, view) == true)
+	{
+		return(LoadPacked(filename, view));
+	}
+
+	uint32_t magic = 0;
+	FILE* pFile = fopen(filename, "rb");
+	if (NULL == pFile)
+	{
+		std::cout << "Could not open scene file " << filename << std::endl;
+		return(false);
+	}
+	size_t bytesRead = fread(&magic, 1, sizeof(magic), pFile);
+	fclose(pFile);
+
+	if ((bytesRead == sizeof(magic)) && (magic == SCENE_FILE_MAGIC))
+	{
+		return(LoadBinary(filename));
+	}
+	return(LoadText(filename));
+}
+
+/***********************************************************
+ *  LoadText()
+ *
+ *  This method is used for compiling a text description
+ *  into the image. Each line is one record, and names must
+ *  be defined before they are used:
+ *
+ *  texture <tag> <path>
+ *  model <tag> <path of a .glb file>
+ *  material <tag> <ambient rgb> <ambient strength>
+ *      <diffuse rgb> <specular rgb> <shininess> <transparent 0|1>
+ *      [reflectivity [coarse shading 0|1]]
+ *  light <position xyz> <ambient rgb> <diffuse rgb>
+ *      <specular rgb> <focal strength> <specular intensity> [radius]
+ *  sun <direction towards it xyz> <ambient rgb> <diffuse rgb>
+ *      <specular rgb> <focal strength> <specular intensity>
+ *  prefab <name>
+ *  part <mesh> <texture|none> <material|none> <color rgba>
+ *      <UV scale uv> <scale xyz> <rotation xyz> <position xyz>
+ *  end
+ *  instance <prefab> <tag|-> <position xyz> [rotation xyz] [scale xyz]
+ *  static <prefab> <position xyz> [rotation xyz] [scale xyz]
+ *
+ *  Parts belong to the prefab opened above them, and text
+ *  after # is a comment. A part draws a model with the mesh
+ *  model:<tag>, in the materials of the model unless it
+ *  names one of its own. Static instances never move and
+ *  have no tag, so their draws can be baked together.
+ ***********************************************************/
+bool SceneFile::LoadText(const char* filename)
+{
+	Close();
+
+	std::ifstream file(filename);
+	if (!file)
+	{
+		std::cout << "Could not open scene file " << filename << std::endl;
+		return(false);
+	}
+	return(ParseText(file, filename));
+}
+
+/***********************************************************
+ *  ParseText()
+ *
+ *  This method is used for compiling the lines of a text
+ *  description, from a file or the asset pack, into the
+ *  image, in the form LoadText() describes.
+ ***********************************************************/
+bool SceneFile::ParseText(std::istream& file, const char* filename)
+{
+	std::vector<TEXTURE_RECORD> textures;
+	std::vector<MODEL_RECORD> models;
+	std::vector<MATERIAL_RECORD> materials;
+	std::vector<LIGHT_RECORD> lights;
+	std::vector<PART_RECORD> parts;
+	std::vector<PREFAB_RECORD> prefabs;
+	std::vector<INSTANCE_RECORD> instances;
+	bool bInPrefab = false;
+
+	std::string text;
+	int lineNumber = 0;
+	while (std::getline(file, text))
+	{
+		lineNumber++;
+		size_t comment = text.find('#');
+		if (comment != std::string::npos)
+		{
+			text.erase(comment);
+		}
+
+		std::istringstream line(text);
+		std::string keyword;
+		if (!(line >> keyword))
+		{
+			continue;
+		}
+
+		bool bValid = true;
+		std::string error;
+		if (keyword == "texture")
+		{
+			TEXTURE_RECORD texture;
+			std::string tag;
+			std::string path;
+			bValid = (line >> tag >> path) &&
+				CopyField(texture.tag, TAG_LENGTH, tag) &&
+				CopyField(texture.path, PATH_LENGTH, path);
+			if (bValid == true)
+			{
+				textures.push_back(texture);
+			}
+		}
+		else if (keyword == "model")
+		{
+			MODEL_RECORD model;
+			std::string tag;
+			std::string path;
+			bValid = (line >> tag >> path) &&
+				CopyField(model.tag, TAG_LENGTH, tag) &&
+				CopyField(model.path, PATH_LENGTH, path);
+			if ((bValid == true) && (FindRecord(models, &MODEL_RECORD::tag, tag) >= 0))
+			{
+				error = "model " + tag + " is already defined";
+				bValid = false;
+			}
+			if (bValid == true)
+			{
+				models.push_back(model);
+			}
+		}
+		else if (keyword == "material")
+		{
+			MATERIAL_RECORD material;
+			std::string tag;
+			int bTransparent = 0;
+			bValid = (line >> tag) &&
+				CopyField(material.tag, TAG_LENGTH, tag) &&
+				ReadFloats(line, material.ambientColor, 3) &&
+				ReadFloats(line, &material.ambientStrength, 1) &&
+				ReadFloats(line, material.diffuseColor, 3) &&
+				ReadFloats(line, material.specularColor, 3) &&
+				ReadFloats(line, &material.shininess, 1) &&
+				(line >> bTransparent);
+			if (bValid == true)
+			{
+				material.bTransparent = (bTransparent != 0) ? 1 : 0;
+				if (ReadFloats(line, &material.reflectivity, 1) == false)
+				{
+					material.reflectivity = 0.0f;
+				}
+				int bCoarseShading = 0;
+				if (!(line >> bCoarseShading))
+				{
+					bCoarseShading = 0;
+				}
+				material.bCoarseShading = (bCoarseShading != 0) ? 1 : 0;
+				materials.push_back(material);
+			}
+		}
+		else if (keyword == "light")
+		{
+			LIGHT_RECORD light;
+			bValid = ReadFloats(line, light.position, 3) &&
+				ReadFloats(line, light.ambientColor, 3) &&
+				ReadFloats(line, light.diffuseColor, 3) &&
+				ReadFloats(line, light.specularColor, 3) &&
+				ReadFloats(line, &light.focalStrength, 1) &&
+				ReadFloats(line, &light.specularIntensity, 1);
+			if (ReadFloats(line, &light.radius, 1) == false)
+			{
+				light.radius = 0.0f;
+			}
+			if (bValid == true)
+			{
+				lights.push_back(light);
+			}
+		}
+		else if (keyword == "sun")
+		{
+			// a directional light, stored with a negative radius
+			LIGHT_RECORD light;
+			bValid = ReadFloats(line, light.position, 3) &&
+				ReadFloats(line, light.ambientColor, 3) &&
+				ReadFloats(line, light.diffuseColor, 3) &&
+				ReadFloats(line, light.specularColor, 3) &&
+				ReadFloats(line, &light.focalStrength, 1) &&
+				ReadFloats(line, &light.specularIntensity, 1) &&
+				((light.position[0] != 0.0f) || (light.position[1] != 0.0f) || (light.position[2] != 0.0f));
+			light.radius = -1.0f;
+			if (bValid == true)
+			{
+				lights.push_back(light);
+			}
+		}
+		else if (keyword == "prefab")
+		{
+			PREFAB_RECORD prefab;
+			std::string name;
+			bValid = (bInPrefab == false) && (line >> name) &&
+				CopyField(prefab.name, TAG_LENGTH, name);
+			if ((bValid == true) && (FindRecord(prefabs, &PREFAB_RECORD::name, name) >= 0))
+			{
+				error = "prefab " + name + " is already defined";
+				bValid = false;
+			}
+			if (bValid == true)
+			{
+				prefab.firstPart = (uint32_t)parts.size();
+				prefab.partCount = 0;
+				prefabs.push_back(prefab);
+				bInPrefab = true;
+			}
+		}
+		else if (keyword == "part")
+		{
+			PART_RECORD part;
+			std::string mesh;
+			std::string texture;
+			std::string material;
+			bValid = (bInPrefab == true) && (line >> mesh >> texture >> material) &&
+				ReadFloats(line, part.color, 4) &&
+				ReadFloats(line, part.UVscale, 2) &&
+				ReadFloats(line, part.scaleXYZ, 3) &&
+				ReadFloats(line, part.rotationDegreesXYZ, 3) &&
+				ReadFloats(line, part.positionXYZ, 3);
+			if (bValid == true)
+			{
+				int meshIndex = FindMesh(mesh);
+				part.modelIndex = -1;
+				if (mesh.compare(0, strlen(MODEL_MESH_PREFIX), MODEL_MESH_PREFIX) == 0)
+				{
+					std::string model = mesh.substr(strlen(MODEL_MESH_PREFIX));
+					part.modelIndex = FindRecord(models, &MODEL_RECORD::tag, model);
+					meshIndex = (part.modelIndex >= 0) ? (int)MESH_MODEL : -1;
+				}
+				part.textureIndex = (texture == "none") ? -1 : FindRecord(textures, &TEXTURE_RECORD::tag, texture);
+				part.materialIndex = (material == "none") ? -1 : FindRecord(materials, &MATERIAL_RECORD::tag, material);
+				if ((meshIndex < 0) || ((meshIndex == MESH_MODEL) && (part.modelIndex < 0)))
+				{
+					error = "unknown mesh " + mesh;
+				}
+				else if ((part.textureIndex < 0) && (texture != "none"))
+				{
+					error = "unknown texture " + texture;
+				}
+				else if ((part.materialIndex < 0) && (material != "none"))
+				{
+					error = "unknown material " + material;
+				}
+				bValid = error.empty();
+				part.mesh = (uint32_t)meshIndex;
+			}
+			if (bValid == true)
+			{
+				parts.push_back(part);
+				prefabs.back().partCount++;
+			}
+		}
+		else if (keyword == "end")
+		{
+			bValid = (bInPrefab == true);
+			bInPrefab = false;
+		}
+		else if ((keyword == "instance") || (keyword == "static"))
+		{
+			INSTANCE_RECORD instance;
+			std::string prefab;
+			std::string tag = "-";
+			instance.flags = (keyword == "static") ? INSTANCE_STATIC : 0;
+			bValid = (line >> prefab) &&
+				((instance.flags == INSTANCE_STATIC) || (line >> tag)) &&
+				CopyField(instance.tag, TAG_LENGTH, (tag == "-") ? std::string() : tag) &&
+				ReadFloats(line, instance.positionXYZ, 3);
+			if (bValid == true)
+			{
+				// rotation and scale are optional, in that order
+				if (ReadFloats(line, instance.rotationDegreesXYZ, 3) == false)
+				{
+					instance.rotationDegreesXYZ[0] = instance.rotationDegreesXYZ[1] = instance.rotationDegreesXYZ[2] = 0.0f;
+				}
+				if (ReadFloats(line, instance.scaleXYZ, 3) == false)
+				{
+					instance.scaleXYZ[0] = instance.scaleXYZ[1] = instance.scaleXYZ[2] = 1.0f;
+				}
+
+				int prefabIndex = FindRecord(prefabs, &PREFAB_RECORD::name, prefab);
+				if (prefabIndex < 0)
+				{
+					error = "unknown prefab " + prefab;
+					bValid = false;
+				}
+				instance.prefabIndex = (uint32_t)prefabIndex;
+			}
+			if (bValid == true)
+			{
+				instances.push_back(instance);
+			}
+		}
+		else
+		{
+			error = "unknown record " + keyword;
+			bValid = false;
+		}
+
+		if (bValid == false)
+		{
+			std::cout << filename << "(" << lineNumber << "): " <<
+				(error.empty() ? ("malformed " + keyword + " record") : error) << std::endl;
+			return(false);
+		}
+	}
+
+	if (bInPrefab == true)
+	{
+		std::cout << filename << ": prefab " << prefabs.back().name << " has no end" << std::endl;
+		return(false);
+	}
+
+	// lay the arrays out after the header, each one aligned
+	const void* pRecords[SECTION_COUNT] =
+	{
+		textures.empty() ? NULL : &textures[0],
+		materials.empty() ? NULL : &materials[0],
+		lights.empty() ? NULL : &lights[0],
+		parts.empty() ? NULL : &parts[0],
+		prefabs.empty() ? NULL : &prefabs[0],
+		instances.empty() ? NULL : &instances[0],
+		models.empty() ? NULL : &models[0]
+	};
+	const size_t recordCounts[SECTION_COUNT] =
+	{
+		textures.size(), materials.size(), lights.size(),
+		parts.size(), prefabs.size(), instances.size(),
+		models.size()
+	};
+
+	FILE_HEADER header;
+	memset(&header, 0, sizeof(header));
+	header.magic = SCENE_FILE_MAGIC;
+	header.version = SCENE_FILE_VERSION;
+
+	size_t imageSize = sizeof(FILE_HEADER);
+	for (int section = 0; section < SECTION_COUNT; section++)
+	{
+		imageSize = (imageSize + SECTION_ALIGNMENT - 1) & ~(SECTION_ALIGNMENT - 1);
+		header.sections[section].offset = (uint32_t)imageSize;
+		header.sections[section].count = (uint32_t)recordCounts[section];
+		imageSize += recordCounts[section] * RECORD_SIZES[section];
+	}
+	header.imageSize = (uint32_t)imageSize;
+
+	m_textImage.assign(imageSize, 0);
+	memcpy(&m_textImage[0], &header, sizeof(header));
+	for (int section = 0; section < SECTION_COUNT; section++)
+	{
+		if (recordCounts[section] > 0)
+		{
+			memcpy(&m_textImage[header.sections[section].offset], pRecords[section],
+				recordCounts[section] * RECORD_SIZES[section]);
+		}
+	}
+	m_pImage = &m_textImage[0];
+	m_imageSize = imageSize;
+
+	return(true);
+}
+
+/***********************************************************
+ *  LoadPacked()
+ *
+ *  This method is used for loading a description from its
+ *  view in the asset pack. A compiled one is copied into the
+ *  image and checked as a mapped one is, and a text one is
+ *  parsed from the view.
+ ***********************************************************/
+bool SceneFile::LoadPacked(const char* filename, const AssetPack::ASSET_VIEW& view)
+{
+	Close();
+
+	uint32_t magic = 0;
+	if (view.size >= sizeof(magic))
+	{
+		memcpy(&magic, view.pData, sizeof(magic));
+	}
+	if (magic != SCENE_FILE_MAGIC)
+	{
+		std::istringstream file(std::string((const char*)view.pData, view.size));
+		return(ParseText(file, filename));
+	}
+
+	m_textImage.assign(view.pData, view.pData + view.size);
+	m_pImage = &m_textImage[0];
+	m_imageSize = m_textImage.size();
+	if (ValidateImage(filename) == false)
+	{
+		Close();
+		return(false);
+	}
+	return(true);
+}
+
+/***********************************************************
+ *  LoadBinary()
+ *
+ *  This method is used for mapping a compiled description
+ *  into memory. The records are used where they lie in the
+ *  mapping, after one pass checking that every offset and
+ *  index stays inside the file.
+ ***********************************************************/
+bool SceneFile::LoadBinary(const char* filename)
+{
+	Close();
+
+	void* pView = NULL;
+	size_t fileSize = 0;
+#ifdef _WIN32
+	HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (file != INVALID_HANDLE_VALUE)
+	{
+		LARGE_INTEGER size;
+		if ((GetFileSizeEx(file, &size) != 0) && (size.QuadPart > 0))
+		{
+			fileSize = (size_t)size.QuadPart;
+			// the view keeps the mapping open once both handles are closed
+			HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+			if (NULL != mapping)
+			{
+				pView = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+				CloseHandle(mapping);
+			}
+		}
+		CloseHandle(file);
+	}
+#else
+	int file = open(filename, O_RDONLY);
+	if (file >= 0)
+	{
+		struct stat fileInfo;
+		if ((fstat(file, &fileInfo) == 0) && (fileInfo.st_size > 0))
+		{
+			fileSize = (size_t)fileInfo.st_size;
+			pView = mmap(NULL, fileSize, PROT_READ, MAP_PRIVATE, file, 0);
+			if (pView == MAP_FAILED)
+			{
+				pView = NULL;
+			}
+		}
+		close(file);
+	}
+#endif
+
+	if (NULL == pView)
+	{
+		std::cout << "Could not map scene file " << filename << std::endl;
+		return(false);
+	}
+
+	m_pMapping = pView;
+	m_pImage = (const unsigned char*)pView;
+	m_imageSize = fileSize;
+
+	if (ValidateImage(filename) == false)
+	{
+		Close();
+		return(false);
+	}
+
+	return(true);
+}
+
+/***********************************************************
+ *  SaveBinary()
+ *
+ *  This method is used for writing the loaded image as a
+ *  compiled description, which LoadBinary() maps as it is.
+ ***********************************************************/
+bool SceneFile::SaveBinary(const char* filename) const
+{
+	if (NULL == m_pImage)
+	{
+		return(false);
+	}
+
+	FILE* pFile = fopen(filename, "wb");
+	if (NULL == pFile)
+	{
+		std::cout << "Could not create scene file " << filename << std::endl;
+		return(false);
+	}
+	bool bWritten = (fwrite(m_pImage, 1, m_imageSize, pFile) == m_imageSize);
+	bWritten = (fclose(pFile) == 0) && bWritten;
+
+	if (bWritten == false)
+	{
+		std::cout << "Could not write scene file " << filename << std::endl;
+	}
+	return(bWritten);
+}
+
+/***********************************************************
+ *  ValidateImage()
+ *
+ *  This method is used for checking a mapped image before
+ *  its records are used: the header, that every section
+ *  lies inside the image, and that every name is terminated
+ *  and every index points at an existing record.
+ ***********************************************************/
+bool SceneFile::ValidateImage(const char* filename) const
+{
+	const FILE_HEADER* pHeader = (const FILE_HEADER*)m_pImage;
+	if ((m_imageSize < sizeof(FILE_HEADER)) ||
+		(pHeader->magic != SCENE_FILE_MAGIC) ||
+		(pHeader->version != SCENE_FILE_VERSION) ||
+		(pHeader->imageSize != m_imageSize))
+	{
+		std::cout << filename << ": not a version " << SCENE_FILE_VERSION << " compiled scene" << std::endl;
+		return(false);
+	}
+
+	for (int section = 0; section < SECTION_COUNT; section++)
+	{
+		const SECTION_RANGE& range = pHeader->sections[section];
+		unsigned long long end = (unsigned long long)range.offset +
+			(unsigned long long)range.count * RECORD_SIZES[section];
+		if ((range.offset < sizeof(FILE_HEADER)) ||
+			((range.offset % SECTION_ALIGNMENT) != 0) ||
+			(end > m_imageSize))
+		{
+			std::cout << filename << ": section " << section << " lies outside of the file" << std::endl;
+			return(false);
+		}
+	}
+
+	const TEXTURE_RECORD* pTextures = GetTextures();
+	for (uint32_t i = 0; i < GetTextureCount(); i++)
+	{
+		if ((IsTerminated(pTextures[i].tag, TAG_LENGTH) == false) ||
+			(IsTerminated(pTextures[i].path, PATH_LENGTH) == false))
+		{
+			std::cout << filename << ": texture " << i << " is malformed" << std::endl;
+			return(false);
+		}
+	}
+
+	const MODEL_RECORD* pModels = GetModels();
+	for (uint32_t i = 0; i < GetModelCount(); i++)
+	{
+		if ((IsTerminated(pModels[i].tag, TAG_LENGTH) == false) ||
+			(IsTerminated(pModels[i].path, PATH_LENGTH) == false))
+		{
+			std::cout << filename << ": model " << i << " is malformed" << std::endl;
+			return(false);
+		}
+	}
+
+	const MATERIAL_RECORD* pMaterials = GetMaterials();
+	for (uint32_t i = 0; i < GetMaterialCount(); i++)
+	{
+		if (IsTerminated(pMaterials[i].tag, TAG_LENGTH) == false)
+		{
+			std::cout << filename << ": material " << i << " is malformed" << std::endl;
+			return(false);
+		}
+	}
+
+	const PART_RECORD* pParts = GetParts();
+	for (uint32_t i = 0; i < GetPartCount(); i++)
+	{
+		const PART_RECORD& part = pParts[i];
+		if ((part.mesh >= (uint32_t)MESH_COUNT) ||
+			(part.textureIndex < -1) || (part.textureIndex >= (int32_t)GetTextureCount()) ||
+			(part.materialIndex < -1) || (part.materialIndex >= (int32_t)GetMaterialCount()) ||
+			((part.mesh == (uint32_t)MESH_MODEL) ? ((part.modelIndex < 0) || (part.modelIndex >= (int32_t)GetModelCount())) :
+			(part.modelIndex != -1)))
+		{
+			std::cout << filename << ": part " << i << " is malformed" << std::endl;
+			return(false);
+		}
+	}
+
+	const PREFAB_RECORD* pPrefabs = GetPrefabs();
+	for (uint32_t i = 0; i < GetPrefabCount(); i++)
+	{
+		const PREFAB_RECORD& prefab = pPrefabs[i];
+		if ((IsTerminated(prefab.name, TAG_LENGTH) == false) ||
+			((unsigned long long)prefab.firstPart + prefab.partCount > GetPartCount()))
+		{
+			std::cout << filename << ": prefab " << i << " is malformed" << std::endl;
+			return(false);
+		}
+	}
+
+	const INSTANCE_RECORD* pInstances = GetInstances();
+	for (uint32_t i = 0; i < GetInstanceCount(); i++)
+	{
+		if ((IsTerminated(pInstances[i].tag, TAG_LENGTH) == false) ||
+			(pInstances[i].prefabIndex >= GetPrefabCount()) ||
+			((pInstances[i].flags & ~INSTANCE_STATIC) != 0))
+		{
+			std::cout << filename << ": instance " << i << " is malformed" << std::endl;
+			return(false);
+		}
+	}
+
+	return(true);
+}
+
+/***********************************************************
+ *  GetSectionCount()
+ *
+ *  This method is used for getting the number of records
+ *  in a section of the loaded image, 0 without one.
+ ***********************************************************/
+uint32_t SceneFile::GetSectionCount(int section) const
+{
+	if (NULL == m_pImage)
+	{
+		return(0);
+	}
+	return(((const FILE_HEADER*)m_pImage)->sections[section].count);
+}
+
+/***********************************************************
+ *  GetSection()
+ *
+ *  This method is used for getting the first record of a
+ *  section of the loaded image, NULL without one.
+ ***********************************************************/
+const void* SceneFile::GetSection(int section) const
+{
+	if (NULL == m_pImage)
+	{
+		return(NULL);
+	}
+	return(m_pImage + ((const FILE_HEADER*)m_pImage)->sections[section].offset);
+}
+
+/***********************************************************
+ *  GetMeshName()
+ *
+ *  This method is used for getting the name a part mesh has
+ *  in the text form.
+ ***********************************************************/
+const char* SceneFile::GetMeshName(int mesh)
+{
+	if ((mesh < 0) || (mesh >= MESH_COUNT))
+	{
+		return("unknown");
+	}
+	return(MESH_NAMES[mesh]);
+}
+
+/***********************************************************
+ *  GetNodeCount()
+ *
+ *  This method is used for counting the scene nodes the
+ *  instances add: one for each instance and one for each
+ *  of its parts.
+ ***********************************************************/
+size_t SceneFile::GetNodeCount() const
+{
+	const PREFAB_RECORD* pPrefabs = GetPrefabs();
+	const INSTANCE_RECORD* pInstances = GetInstances();
+
+	size_t nodeCount = 0;
+	for (uint32_t i = 0; i < GetInstanceCount(); i++)
+	{
+		nodeCount += 1 + pPrefabs[pInstances[i].prefabIndex].partCount;
+	}
+	return(nodeCount);
+}
+
+/***********************************************************
+ *  GetDrawCount()
+ *
+ *  This method is used for counting the render list draws
+ *  the instances record, from the draws of each prefab.
+ ***********************************************************/
+size_t SceneFile::GetDrawCount() const
+{
+	const PART_RECORD* pParts = GetParts();
+	const PREFAB_RECORD* pPrefabs = GetPrefabs();
+	const INSTANCE_RECORD* pInstances = GetInstances();
+
+	std::vector<size_t> prefabDraws(GetPrefabCount(), 0);
+	for (uint32_t i = 0; i < GetPrefabCount(); i++)
+	{
+		for (uint32_t part = 0; part < pPrefabs[i].partCount; part++)
+		{
+			prefabDraws[i] += MESH_DRAW_COUNTS[pParts[pPrefabs[i].firstPart + part].mesh];
+		}
+	}
+
+	size_t drawCount = 0;
+	for (uint32_t i = 0; i < GetInstanceCount(); i++)
+	{
+		drawCount += prefabDraws[pInstances[i].prefabIndex];
+	}
+	return(drawCount);
+}
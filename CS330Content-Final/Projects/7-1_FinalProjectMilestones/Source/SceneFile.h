@@ -0,0 +1,228 @@
+///////////////////////////////////////////////////////////////////////////////
+// scenefile.h
+// ============
+// text and compiled binary descriptions of a scene
+//
+//  Lists the textures, materials, lights, models, prefabs and
+//  placed instances of a scene. The text form is written by hand; the
+//  compiled form holds the same records as fixed size arrays and
+//  is memory-mapped and read in place.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "AssetPack.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <string>
+#include <vector>
+
+/***********************************************************
+ *  SceneFile
+ *
+ *  This class contains one scene description. Both forms
+ *  end up as the same image: the header followed by one
+ *  array per record type. A text file is compiled into an
+ *  image in memory, a binary file is that image on disk and
+ *  is mapped and only checked, never parsed.
+ ***********************************************************/
+class SceneFile
+{
+public:
+	// constructor
+	SceneFile();
+	// destructor
+	~SceneFile();
+
+	// "SCNB" and the layout version of the compiled form
+	static const uint32_t SCENE_FILE_MAGIC = 0x424E4353;
+	static const uint32_t SCENE_FILE_VERSION = 5;
+	// length of the tag and path fields, including the terminator
+	static const int TAG_LENGTH = 32;
+	static const int PATH_LENGTH = 224;
+
+	// meshes a prefab part can draw, with the parts of the cylinder
+	// the ShapeMeshWrappers descriptors name, and the imported models
+	enum SCENE_MESH
+	{
+		MESH_BOX = 0,
+		MESH_CONE,
+		MESH_CYLINDER,
+		MESH_CYLINDER_OPEN,		// sides only
+		MESH_CYLINDER_CAPS,		// top and bottom only
+		MESH_CYLINDER_BOTTOM,	// bottom only
+		MESH_PLANE,
+		MESH_PRISM,
+		MESH_PYRAMID3,
+		MESH_PYRAMID4,
+		MESH_SPHERE,
+		MESH_HALF_SPHERE,
+		MESH_TAPERED_CYLINDER,
+		MESH_TORUS,
+		MESH_HALF_TORUS,
+		MESH_MODEL,				// the model of modelIndex
+		MESH_COUNT
+	};
+
+	// record arrays of the image, in file order
+	enum SCENE_SECTION
+	{
+		SECTION_TEXTURES = 0,
+		SECTION_MATERIALS,
+		SECTION_LIGHTS,
+		SECTION_PARTS,
+		SECTION_PREFABS,
+		SECTION_INSTANCES,
+		SECTION_MODELS,
+		SECTION_COUNT
+	};
+
+	struct SECTION_RANGE
+	{
+		uint32_t offset;	// from the start of the image, 16 byte aligned
+		uint32_t count;
+	};
+
+	struct FILE_HEADER
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint32_t imageSize;
+		uint32_t unused;
+		SECTION_RANGE sections[SECTION_COUNT];
+	};
+
+	struct TEXTURE_RECORD
+	{
+		char tag[TAG_LENGTH];
+		char path[PATH_LENGTH];
+	};
+
+	// binary glTF file of a model the parts can draw
+	struct MODEL_RECORD
+	{
+		char tag[TAG_LENGTH];
+		char path[PATH_LENGTH];
+	};
+
+	struct MATERIAL_RECORD
+	{
+		char tag[TAG_LENGTH];
+		float ambientColor[3];
+		float ambientStrength;
+		float diffuseColor[3];
+		float specularColor[3];
+		float shininess;
+		uint32_t bTransparent;
+		float reflectivity;		// share of the reflection probes head on
+		uint32_t bCoarseShading;	// lit coarsely where it shows little detail
+	};
+
+	struct LIGHT_RECORD
+	{
+		float position[3];
+		float ambientColor[3];
+		float diffuseColor[3];
+		float specularColor[3];
+		float focalStrength;
+		float specularIntensity;
+		float radius;		// 0 for the whole scene, negative for a
+							// directional light, whose position is
+							// the direction towards it
+	};
+
+	// one mesh of a prefab, placed relative to its instance
+	struct PART_RECORD
+	{
+		uint32_t mesh;			// SCENE_MESH
+		int32_t textureIndex;	// into the textures, -1 for none
+		int32_t materialIndex;	// into the materials, -1 for none
+		int32_t modelIndex;		// into the models for MESH_MODEL, else -1
+		float color[4];
+		float UVscale[2];
+		float scaleXYZ[3];
+		float rotationDegreesXYZ[3];
+		float positionXYZ[3];
+	};
+
+	struct PREFAB_RECORD
+	{
+		char name[TAG_LENGTH];
+		uint32_t firstPart;
+		uint32_t partCount;
+	};
+
+	// INSTANCE_RECORD flags
+	static const uint32_t INSTANCE_STATIC = 1;	// never moves, can be baked
+
+	// one placed prefab; the tag names its scene node
+	struct INSTANCE_RECORD
+	{
+		char tag[TAG_LENGTH];
+		uint32_t prefabIndex;
+		uint32_t flags;
+		float scaleXYZ[3];
+		float rotationDegreesXYZ[3];
+		float positionXYZ[3];
+	};
+
+	// load either form, told apart by the magic of the compiled one
+	bool Load(const char* filename);
+	// compile a text description into the in memory image
+	bool LoadText(const char* filename);
+	// map a compiled description and check its records
+	bool LoadBinary(const char* filename);
+	// write the loaded image as a compiled description
+	bool SaveBinary(const char* filename) const;
+	// drop the image and unmap the file
+	void Close();
+	// exchange the loaded images, for handing over a description
+	// read on another thread
+	void Swap(SceneFile& other);
+	bool IsLoaded() const { return(NULL != m_pImage); }
+
+	uint32_t GetTextureCount() const { return(GetSectionCount(SECTION_TEXTURES)); }
+	const TEXTURE_RECORD* GetTextures() const { return((const TEXTURE_RECORD*)GetSection(SECTION_TEXTURES)); }
+	uint32_t GetModelCount() const { return(GetSectionCount(SECTION_MODELS)); }
+	const MODEL_RECORD* GetModels() const { return((const MODEL_RECORD*)GetSection(SECTION_MODELS)); }
+	uint32_t GetMaterialCount() const { return(GetSectionCount(SECTION_MATERIALS)); }
+	const MATERIAL_RECORD* GetMaterials() const { return((const MATERIAL_RECORD*)GetSection(SECTION_MATERIALS)); }
+	uint32_t GetLightCount() const { return(GetSectionCount(SECTION_LIGHTS)); }
+	const LIGHT_RECORD* GetLights() const { return((const LIGHT_RECORD*)GetSection(SECTION_LIGHTS)); }
+	uint32_t GetPartCount() const { return(GetSectionCount(SECTION_PARTS)); }
+	const PART_RECORD* GetParts() const { return((const PART_RECORD*)GetSection(SECTION_PARTS)); }
+	uint32_t GetPrefabCount() const { return(GetSectionCount(SECTION_PREFABS)); }
+	const PREFAB_RECORD* GetPrefabs() const { return((const PREFAB_RECORD*)GetSection(SECTION_PREFABS)); }
+	uint32_t GetInstanceCount() const { return(GetSectionCount(SECTION_INSTANCES)); }
+	const INSTANCE_RECORD* GetInstances() const { return((const INSTANCE_RECORD*)GetSection(SECTION_INSTANCES)); }
+
+	// name of a SCENE_MESH value in the text form
+	static const char* GetMeshName(int mesh);
+
+	// scene nodes and draws the instances add together, for sizing
+	// the render list before it is recorded; a model counts as one
+	// draw, whatever number of primitives it is imported with
+	size_t GetNodeCount() const;
+	size_t GetDrawCount() const;
+
+private:
+	// image of the loaded description, either m_textImage or the
+	// mapped file
+	const unsigned char* m_pImage;
+	size_t m_imageSize;
+	// image compiled from a text description
+	std::vector<unsigned char> m_textImage;
+	// view of the mapped binary file, NULL for a text description
+	void* m_pMapping;
+
+	uint32_t GetSectionCount(int section) const;
+	const void* GetSection(int section) const;
+	// check the header, section bounds and record indexes
+	bool ValidateImage(const char* filename) const;
+	// compile the lines of a text description into the image
+	bool ParseText(std::istream& file, const char* filename);
+	// load either form from its view in the asset pack
+	bool LoadPacked(const char* filename, const AssetPack::ASSET_VIEW& view);
+};
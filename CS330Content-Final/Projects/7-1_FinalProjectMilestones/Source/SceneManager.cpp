@@ -16,6 +16,11 @@
 ///////////////////////////////////////////////////////////////////////////////
 
 #include "SceneManager.h"
+#include "ScopeProfiler.h"
+#include "GLDebug.h"
+#include "GPUMemory.h"
+#include "GLTrace.h"
+#include "Logger.h"
 
 #ifndef STB_IMAGE_IMPLEMENTATION
 #define STB_IMAGE_IMPLEMENTATION
@@ -23,15 +28,693 @@
 #endif
 
 #include <glm/gtx/transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cfloat>
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <memory>
 
-// declaration of global variables
 namespace
 {
-	const char* g_ModelName = "model";
-	const char* g_ColorValueName = "objectColor";
-	const char* g_TextureValueName = "objectTexture";
-	const char* g_UseTextureName = "bUseTexture";
-	const char* g_UseLightingName = "bUseLighting";
+	// compute shaders of the occlusion culling
+	const char* const DEPTH_PYRAMID_SHADER_PATH = "../../Utilities/shaders/depthPyramidCompute.glsl";
+	const char* const OCCLUSION_CULL_SHADER_PATH = "../../Utilities/shaders/occlusionCullCompute.glsl";
+	const char* const MESHLET_CULL_SHADER_PATH = "../../Utilities/shaders/meshletCullCompute.glsl";
+	const char* const MESHLET_TASK_SHADER_PATH = "../../Utilities/shaders/meshletTask.glsl";
+	const char* const MESHLET_MESH_SHADER_PATH = "../../Utilities/shaders/meshletMesh.glsl";
+	const char* const MESHLET_FRAGMENT_SHADER_PATH = "../../Utilities/shaders/fragmentShader.glsl";
+	// compute shader writing the sphere and torus vertices
+	const char* const PROCEDURAL_MESH_SHADER_PATH = "../../Utilities/shaders/proceduralMeshCompute.glsl";
+	const char* const INSTANCE_EXPAND_SHADER_PATH = "../../Utilities/shaders/instanceExpandCompute.glsl";
+	const char* const ANIMATION_SAMPLE_SHADER_PATH = "../../Utilities/shaders/animationSampleCompute.glsl";
+	// particle stages and their camera facing quads
+	const char* const PARTICLE_SIMULATE_SHADER_PATH = "../../Utilities/shaders/particleSimulateCompute.glsl";
+	const char* const PARTICLE_SORT_SHADER_PATH = "../../Utilities/shaders/particleSortCompute.glsl";
+	const char* const PARTICLE_VERTEX_SHADER_PATH = "../../Utilities/shaders/particleVertex.glsl";
+	const char* const PARTICLE_FRAGMENT_SHADER_PATH = "../../Utilities/shaders/particleFragment.glsl";
+	const char* const TEXTURE_COMPRESS_SHADER_PATH = "../../Utilities/shaders/textureCompressCompute.glsl";
+	// full screen resolve of the transparent pass
+	const char* const OIT_RESOLVE_VERTEX_SHADER_PATH = "../../Utilities/shaders/oitResolveVertex.glsl";
+	const char* const OIT_RESOLVE_FRAGMENT_SHADER_PATH = "../../Utilities/shaders/oitResolveFragment.glsl";
+	// position-only program of the depth pre-pass
+	const char* const DEPTH_PREPASS_VERTEX_SHADER_PATH = "../../Utilities/shaders/depthPrepassVertex.glsl";
+	const char* const DEPTH_PREPASS_FRAGMENT_SHADER_PATH = "../../Utilities/shaders/depthPrepassFragment.glsl";
+	// compute shader binning the lights into the view clusters
+	const char* const LIGHT_CLUSTER_SHADER_PATH = "../../Utilities/shaders/lightClusterCompute.glsl";
+	// full screen lighting of the deferred path, sharing the resolve triangle
+	const char* const DEFERRED_LIGHTING_VERTEX_SHADER_PATH = "../../Utilities/shaders/oitResolveVertex.glsl";
+	const char* const DEFERRED_LIGHTING_FRAGMENT_SHADER_PATH = "../../Utilities/shaders/deferredLightingFragment.glsl";
+	const char* const SHADING_RATE_SHADER_PATH = "../../Utilities/shaders/shadingRateCompute.glsl";
+	// depth only caster program of the shadow atlas
+	const char* const SHADOW_CASTER_VERTEX_SHADER_PATH = "../../Utilities/shaders/shadowCasterVertex.glsl";
+	const char* const SHADOW_CASTER_FRAGMENT_SHADER_PATH = "../../Utilities/shaders/depthPrepassFragment.glsl";
+	const char* const CASCADE_CASTER_VERTEX_SHADER_PATH = "../../Utilities/shaders/cascadeCasterVertex.glsl";
+	const char* const PROBE_PREFILTER_SHADER_PATH = "../../Utilities/shaders/probePrefilterCompute.glsl";
+	// full screen post effects, sharing the resolve triangle
+	const char* const POST_VERTEX_SHADER_PATH = "../../Utilities/shaders/oitResolveVertex.glsl";
+	const char* const POST_SSAO_FRAGMENT_SHADER_PATH = "../../Utilities/shaders/postSsaoFragment.glsl";
+	const char* const POST_SSAO_BLUR_FRAGMENT_SHADER_PATH = "../../Utilities/shaders/postSsaoBlurFragment.glsl";
+	const char* const POST_BLOOM_FRAGMENT_SHADER_PATH = "../../Utilities/shaders/postBloomFragment.glsl";
+	const char* const POST_COMPOSITE_FRAGMENT_SHADER_PATH = "../../Utilities/shaders/postCompositeFragment.glsl";
+	const char* const POST_FXAA_FRAGMENT_SHADER_PATH = "../../Utilities/shaders/postFxaaFragment.glsl";
+	const char* const POST_TAA_FRAGMENT_SHADER_PATH = "../../Utilities/shaders/postTaaFragment.glsl";
+
+	const char* const IMPOSTOR_CAPTURE_VERTEX_SHADER_PATH = "../../Utilities/shaders/impostorCaptureVertex.glsl";
+	const char* const IMPOSTOR_CAPTURE_FRAGMENT_SHADER_PATH = "../../Utilities/shaders/impostorCaptureFragment.glsl";
+	const char* const IMPOSTOR_VERTEX_SHADER_PATH = "../../Utilities/shaders/impostorVertex.glsl";
+	const char* const IMPOSTOR_FRAGMENT_SHADER_PATH = "../../Utilities/shaders/impostorFragment.glsl";
+	const char* const PICK_VERTEX_SHADER_PATH = "../../Utilities/shaders/pickVertex.glsl";
+	const char* const PICK_FRAGMENT_SHADER_PATH = "../../Utilities/shaders/pickFragment.glsl";
+	// depth only boxes of the occlusion queries
+	const char* const OCCLUSION_BOX_VERTEX_SHADER_PATH = "../../Utilities/shaders/occlusionBoxVertex.glsl";
+	const char* const OCCLUSION_BOX_FRAGMENT_SHADER_PATH = "../../Utilities/shaders/depthPrepassFragment.glsl";
+	// default memory of the shadow atlas, 2560x2560 depth texels, which
+	// holds the cube maps of four lights
+	const size_t DEFAULT_SHADOW_ATLAS_BUDGET = 32 * 1024 * 1024;
+
+	// directory of the texture cache, next to the working directory
+	// the project runs from
+	const char* const TEXTURE_CACHE_DIRECTORY = "texturecache";
+	// upload ring bytes per frame on top of the instance data and
+	// indirect commands, for the camera block and the alignment
+	const GLsizeiptr UPLOAD_RING_SLACK_BYTES = 16 * 1024;
+
+	// projected bounding sphere diameters, in pixels, below which a
+	// draw moves to the next coarser LOD level; a draw has to cross
+	// LOD_HYSTERESIS of the threshold past it before it switches, so
+	// draws sitting near a threshold do not pop back and forth
+	const float LOD_SWITCH_PIXELS[ShapeMeshes::MESH_LOD_COUNT - 1] = { 160.0f, 48.0f };
+	const float LOD_HYSTERESIS = 0.15f;
+	// largest distance on screen, in pixels, a level whose error is
+	// known may move the surface of a draw off its finest level; the
+	// same hysteresis applies
+	const float LOD_ERROR_PIXELS = 1.0f;
+
+	// default diameter on screen, in pixels, below which a composite
+	// object is drawn as its impostor; it dithers in over the parts
+	// from IMPOSTOR_FADE_BAND past it, and the parts are dropped once
+	// it takes every pixel
+	const float DEFAULT_IMPOSTOR_PIXELS = 40.0f;
+	const float IMPOSTOR_FADE_BAND = 0.5f;
+	// fewest parts of an object drawn as an impostor; a single mesh
+	// is already cheaper at its coarsest LOD level
+	const size_t IMPOSTOR_MIN_PARTS = 2;
+	// gap up to which reflective draws share a probe, and the reach of
+	// a probe past the box of its draws, so neighbouring probes overlap
+	// and blend
+	const float PROBE_MERGE_DISTANCE = 3.0f;
+	const float PROBE_REACH_MARGIN = 1.0f;
+	// objects drawn under the occlusion query of their box: those of
+	// several parts or of many vertices or indices at their finest
+	// level, as a box costs a draw and a wait in the pipeline. A box
+	// the camera is within the margin of may be cut by the near
+	// plane, so its object is drawn without the query
+	const size_t OCCLUSION_QUERY_MIN_PARTS = 3;
+	const GLsizei OCCLUSION_QUERY_MIN_VERTICES = 6000;
+	const float OCCLUSION_QUERY_MARGIN = 0.5f;
+
+	// fewest draws a per-draw pass hands to one job, and fewest
+	// keys the draw sort is split between threads for
+	const size_t PARALLEL_MIN_DRAWS = 2048;
+	const size_t PARALLEL_MIN_SORT_KEYS = 16384;
+	// fewest batches whose commands are recorded on several threads
+	const size_t PARALLEL_MIN_BATCHES = 512;
+	// fewest rays of a scene raycast batch handed to one job
+	const size_t PARALLEL_MIN_RAYS = 64;
+
+	// pages the meshlet arrays and the static geometry bake are
+	// placed in, and the bytes an idle frame may move to close the
+	// holes left in them
+	const GLsizeiptr MESH_PAGE_SIZE = 8 * 1024 * 1024;
+	const GLsizeiptr DEFRAGMENT_BYTES_PER_FRAME = 1024 * 1024;
+
+	// pixels on screen the textures of a loading chunk are marked as
+	// drawn over, so their levels up to about that size are resident
+	// by the time it shows
+	const float CHUNK_TEXTURE_PIXELS = 256.0f;
+
+	// frames ahead the camera motion is followed to the frustums
+	// whose textures are prefetched, about the time a level takes
+	// to be read back and swapped in; the frustum halfway there is
+	// tested too, for the draws swept past on the way
+	const float PREDICT_FRAMES = 8.0f;
+	// a larger turn or move in one frame is a cut, not a motion
+	// to follow
+	const float MAX_PREDICT_TURN = 0.5f;
+	const float MAX_PREDICT_MOVE = 10.0f;
+	// less motion than this in a frame leaves the view as it is
+	const float MIN_PREDICT_TURN = 0.001f;
+	const float MIN_PREDICT_MOVE = 0.001f;
+
+	// share of the view of a light, the largest channel of its color
+	// times the fraction of the screen its sphere covers, below which
+	// its direct light is folded into its ambient term, and below
+	// which it fades out; a light has to cross LIGHT_LOD_HYSTERESIS
+	// of a threshold past it before it changes level
+	const float LIGHT_FOLD_IMPORTANCE = 0.01f;
+	const float LIGHT_DROP_IMPORTANCE = 0.001f;
+	const float LIGHT_LOD_HYSTERESIS = 0.25f;
+	// frames a light takes to fold or fade out fully
+	const int LIGHT_FADE_FRAMES = 30;
+	// part of the folded diffuse light kept as ambient, about the
+	// mean of the diffuse term over the directions it arrives from
+	const float LIGHT_FOLD_AMBIENT = 0.5f;
+
+	// side of the target the pipeline warm-up draws into, and the
+	// most vertices or indices of a range it draws, one triangle
+	const GLsizei WARMUP_TARGET_SIZE = 8;
+	const GLsizei WARMUP_MAX_COUNT = 3;
+	// passes a combination of the warm-up is drawn in, each with the
+	// targets and state of the pass of the frame it stands for
+	enum WARMUP_PASS
+	{
+		WARMUP_FORWARD = 0,		// opaque, lit into the scene target
+		WARMUP_PREPASS,			// opaque depth of the pre-pass
+		WARMUP_GBUFFER,			// opaque, into the G-buffer
+		WARMUP_TRANSPARENT,		// blended, or into the transparency targets
+		WARMUP_PASS_COUNT
+	};
+	// one combination a warm-up draws
+	struct WARMUP_DRAW
+	{
+		int pass;
+		int permutation;
+		uint32_t drawIndex;		// render list entry of the range drawn
+	};
+
+	/***********************************************************
+	 *  ExtractFrustumPlanes()
+	 *
+	 *  This function is used for taking the normalized planes
+	 *  of the frustum of a view-projection matrix, left, right,
+	 *  bottom, top, near and far, with the plane distance in
+	 *  world units.
+	 ***********************************************************/
+	void ExtractFrustumPlanes(const glm::mat4& m, glm::vec4 planes[6])
+	{
+		glm::vec4 rowX(m[0][0], m[1][0], m[2][0], m[3][0]);
+		glm::vec4 rowY(m[0][1], m[1][1], m[2][1], m[3][1]);
+		glm::vec4 rowZ(m[0][2], m[1][2], m[2][2], m[3][2]);
+		glm::vec4 rowW(m[0][3], m[1][3], m[2][3], m[3][3]);
+		planes[0] = rowW + rowX;	// left
+		planes[1] = rowW - rowX;	// right
+		planes[2] = rowW + rowY;	// bottom
+		planes[3] = rowW - rowY;	// top
+		planes[4] = rowW + rowZ;	// near
+		planes[5] = rowW - rowZ;	// far
+		for (int p = 0; p < 6; p++)
+		{
+			planes[p] /= glm::length(glm::vec3(planes[p]));
+		}
+	}
+
+	// std140 layout of the LightData block in the fragment shader
+	struct LIGHT_DATA
+	{
+		int lightCount;
+		int padding[3];
+		SceneManager::LIGHT_SOURCE lightSources[SceneManager::MAX_LIGHTS];
+	};
+
+	// std140 layout of one Material in the MaterialData block
+	struct MATERIAL_DATA
+	{
+		glm::vec3 ambientColor;
+		float ambientStrength;
+		glm::vec3 diffuseColor;
+		float shininess;
+		glm::vec3 specularColor;
+		float reflectivity;
+	};
+
+	static_assert(sizeof(MATERIAL_DATA) == 48, "MATERIAL_DATA must match the std140 Material layout");
+	static_assert(sizeof(SceneManager::LIGHT_SOURCE) == 80, "LIGHT_SOURCE must match the std140 LightSource layout");
+
+	// one instance of the instance buffer is read as nine RGBA32F
+	// texels by the vertex shader
+	static_assert(sizeof(SceneManager::INSTANCE_DATA) == 9 * 4 * sizeof(float), "INSTANCE_DATA must be 9 RGBA32F texels");
+	static_assert(ModelImporter::LOD_LEVELS == ShapeMeshes::MESH_LOD_COUNT - 1,
+		"the importer must simplify every coarser LOD level");
+	static_assert(SceneManager::MAX_OBJECT_LIGHTS + 1 <= 9, "light list does not fit the normal matrix columns");
+	static_assert(SceneManager::MAX_LIGHTS <= 256, "light index does not fit a byte of the light list");
+
+	// ShapeMeshWrappers descriptor of each basic scene file mesh,
+	// in SceneFile::SCENE_MESH order
+	const ShapeMeshWrappers::MESH_DRAW SCENE_FILE_MESH_DRAWS[SceneFile::MESH_MODEL] =
+	{
+		ShapeMeshWrappers::Box,
+		ShapeMeshWrappers::Cone,
+		ShapeMeshWrappers::Cylinder,
+		ShapeMeshWrappers::HollowCylinder,
+		ShapeMeshWrappers::NoSideCylinder,
+		ShapeMeshWrappers::BottomCylinder,
+		ShapeMeshWrappers::Plane,
+		ShapeMeshWrappers::Prism,
+		ShapeMeshWrappers::Pyramid3,
+		ShapeMeshWrappers::Pyramid4,
+		ShapeMeshWrappers::Sphere,
+		ShapeMeshWrappers::HalfSphere,
+		ShapeMeshWrappers::TaperedCylinder,
+		ShapeMeshWrappers::Torus,
+		ShapeMeshWrappers::HalfTorus
+	};
+	static_assert(SceneFile::MESH_HALF_TORUS + 1 == SceneFile::MESH_MODEL, "SCENE_FILE_MESH_DRAWS must cover every basic mesh");
+
+	// one part of a composite object of the built-in scene, with the
+	// texture and material named by their tags, NULL for none
+	struct BUILTIN_PART
+	{
+		SceneFile::SCENE_MESH mesh;
+		const char* textureTag;
+		const char* materialTag;
+		float color[4];
+		float UVscale[2];
+		float scaleXYZ[3];
+		float rotationDegreesXYZ[3];
+		float positionXYZ[3];
+	};
+
+	// glass jar, base to lid
+	const BUILTIN_PART JAR_PARTS[] =
+	{
+		{ SceneFile::MESH_SPHERE, "glass13", "glass", { 0.7f, 0.7f, 0.9f, 0.8f }, { 1.0f, 0.35f }, { 2.0f, 0.3f, 2.0f }, { 0.0f, 0.0f, 0.0f }, { 0.0f, 0.15f, 0.0f } },
+		{ SceneFile::MESH_CYLINDER, "glass13", "glass", { 0.7f, 0.7f, 0.9f, 0.8f }, { 1.0f, 0.35f }, { 2.0f, 4.05f, 2.0f }, { 0.0f, 0.0f, 0.0f }, { 0.0f, 0.15f, 0.0f } },
+		{ SceneFile::MESH_SPHERE, "glass13", "glass", { 0.7f, 0.7f, 0.9f, 0.8f }, { 1.0f, 0.25f }, { 2.02f, 0.7f, 2.02f }, { 0.0f, -10.0f, 0.0f }, { 0.0f, 4.2f, 0.0f } },
+		{ SceneFile::MESH_CYLINDER, "glass13", "glass", { 0.7f, 0.7f, 0.9f, 0.8f }, { 0.8f, 0.1f }, { 1.6f, 0.8f, 1.6f }, { 0.0f, 8.0f, 0.0f }, { 0.0f, 4.4f, 0.0f } },
+		{ SceneFile::MESH_TORUS, "glass13", "glass", { 0.7f, 0.7f, 0.9f, 0.8f }, { 1.5f, 0.3f }, { 1.48f, 1.48f, 0.65f }, { 90.0f, 0.0f, 0.0f }, { 0.0f, 5.1f, 0.0f } },
+		{ SceneFile::MESH_TORUS, "glass10", "glass", { 0.7f, 0.7f, 0.9f, 0.8f }, { 2.0f, 1.0f }, { 1.5f, 1.5f, 0.5f }, { 90.0f, 0.0f, 0.0f }, { 0.0f, 5.25f, 0.0f } },
+		{ SceneFile::MESH_SPHERE, "glass10", "glass", { 0.7f, 0.7f, 0.9f, 0.8f }, { 2.0f, 1.0f }, { 1.6f, 0.16f, 1.6f }, { 0.0f, 0.0f, 0.0f }, { 0.0f, 5.25f, 0.0f } },
+		{ SceneFile::MESH_CYLINDER, "glass10", "glass", { 0.7f, 0.7f, 0.9f, 0.8f }, { 2.0f, 1.0f }, { 0.9f, 0.5f, 0.9f }, { 0.0f, 0.0f, 0.0f }, { 0.0f, 5.2f, 0.0f } },
+		{ SceneFile::MESH_TORUS, "glass10", "glass", { 0.7f, 0.7f, 0.9f, 0.8f }, { 1.5f, 1.0f }, { 1.1f, 1.1f, 0.5f }, { 90.0f, 0.0f, 0.0f }, { 0.0f, 5.7f, 0.0f } },
+		{ SceneFile::MESH_SPHERE, "glass10", "glass", { 0.7f, 0.7f, 0.9f, 0.8f }, { 1.5f, 1.0f }, { 1.1f, 0.2f, 1.1f }, { 0.0f, 0.0f, 0.0f }, { 0.0f, 5.65f, 0.0f } }
+	};
+
+	// plastic cup with a metal lip and straw
+	const BUILTIN_PART CUP_PARTS[] =
+	{
+		{ SceneFile::MESH_TAPERED_CYLINDER, NULL, "plastic", { 0.6f, 0.1f, 0.1f, 1.0f }, { 3.0f, 0.8f }, { 1.5f, 6.49f, 1.5f }, { 0.0f, 0.0f, 180.0f }, { 0.0f, 4.5f, 0.0f } },
+		{ SceneFile::MESH_CYLINDER_OPEN, "metal", "metal", { 0.6f, 0.1f, 0.1f, 1.0f }, { 3.0f, 0.8f }, { 1.5f, 1.0f, 1.5f }, { 0.0f, 0.0f, 0.0f }, { 0.0f, 4.5f, 0.0f } },
+		{ SceneFile::MESH_CYLINDER_OPEN, "metal", "metal", { 0.6f, 0.1f, 0.1f, 1.0f }, { 1.0f, 5.0f }, { 0.2f, 7.5f, 0.2f }, { 14.6f, 0.0f, 10.5f }, { 0.35f, 0.0f, -0.35f } }
+	};
+
+	// long piece with a rounded end and five slices, the cut faces
+	// showing the inside
+	const BUILTIN_PART CUCUMBER_PARTS[] =
+	{
+		{ SceneFile::MESH_CYLINDER_OPEN, "cucumber_outer", "organic", { 0.2f, 0.5f, 0.2f, 1.0f }, { 1.0f, 1.0f }, { 0.7f, 2.8f, 0.7f }, { 0.0f, -25.0f, 90.0f }, { 0.0f, 0.7f, 0.0f } },
+		{ SceneFile::MESH_CYLINDER_BOTTOM, "cucumber_inner", "organic", { 0.2f, 0.5f, 0.2f, 1.0f }, { 1.0f, 1.0f }, { 0.7f, 2.8f, 0.7f }, { 0.0f, -25.0f, 90.0f }, { 0.0f, 0.7f, 0.0f } },
+		{ SceneFile::MESH_SPHERE, "cucumber_outer", "organic", { 0.2f, 0.5f, 0.2f, 1.0f }, { 1.0f, 1.0f }, { 1.0f, 0.7f, 0.7f }, { 0.0f, -25.0f, 0.0f }, { -2.538f, 0.7f, -1.183f } },
+		{ SceneFile::MESH_CYLINDER_OPEN, "cucumber_outer", "organic", { 0.2f, 0.5f, 0.2f, 1.0f }, { 1.0f, 1.0f }, { 0.7f, 0.15f, 0.7f }, { 0.0f, 0.0f, 0.0f }, { 0.9f, 0.0f, 0.2f } },
+		{ SceneFile::MESH_CYLINDER_CAPS, "cucumber_inner", "organic", { 0.2f, 0.5f, 0.2f, 1.0f }, { 1.0f, 1.0f }, { 0.7f, 0.15f, 0.7f }, { 0.0f, 0.0f, 0.0f }, { 0.9f, 0.0f, 0.2f } },
+		{ SceneFile::MESH_CYLINDER_OPEN, "cucumber_outer", "organic", { 0.2f, 0.5f, 0.2f, 1.0f }, { 1.0f, 1.0f }, { 0.7f, 0.15f, 0.7f }, { -3.5f, 0.0f, 0.0f }, { 1.35f, 0.02f, 2.0f } },
+		{ SceneFile::MESH_CYLINDER_CAPS, "cucumber_inner", "organic", { 0.2f, 0.5f, 0.2f, 1.0f }, { 1.0f, 1.0f }, { 0.7f, 0.15f, 0.7f }, { -3.5f, 0.0f, 0.0f }, { 1.35f, 0.02f, 2.0f } },
+		{ SceneFile::MESH_CYLINDER_OPEN, "cucumber_outer", "organic", { 0.2f, 0.5f, 0.2f, 1.0f }, { 1.0f, 1.0f }, { 0.75f, 0.17f, 0.7f }, { 0.0f, -5.0f, 0.0f }, { 1.3f, 0.15f, 0.9f } },
+		{ SceneFile::MESH_CYLINDER_CAPS, "cucumber_inner", "organic", { 0.2f, 0.5f, 0.2f, 1.0f }, { 1.0f, 1.0f }, { 0.75f, 0.17f, 0.7f }, { 0.0f, -5.0f, 0.0f }, { 1.3f, 0.15f, 0.9f } },
+		{ SceneFile::MESH_CYLINDER_OPEN, "cucumber_outer", "organic", { 0.2f, 0.5f, 0.2f, 1.0f }, { 1.0f, 1.0f }, { 0.7f, 0.13f, 0.65f }, { 0.0f, -1.0f, -1.5f }, { 1.2f, 0.3f, 0.7f } },
+		{ SceneFile::MESH_CYLINDER_CAPS, "cucumber_inner", "organic", { 0.2f, 0.5f, 0.2f, 1.0f }, { 1.0f, 1.0f }, { 0.7f, 0.13f, 0.65f }, { 0.0f, -1.0f, -1.5f }, { 1.2f, 0.3f, 0.7f } },
+		{ SceneFile::MESH_CYLINDER_OPEN, "cucumber_outer", "organic", { 0.2f, 0.5f, 0.2f, 1.0f }, { 1.0f, 1.0f }, { 0.7f, 0.2f, 0.65f }, { 0.0f, -1.0f, -3.0f }, { 0.7f, 0.45f, 0.4f } },
+		{ SceneFile::MESH_CYLINDER_CAPS, "cucumber_inner", "organic", { 0.2f, 0.5f, 0.2f, 1.0f }, { 1.0f, 1.0f }, { 0.7f, 0.2f, 0.65f }, { 0.0f, -1.0f, -3.0f }, { 0.7f, 0.45f, 0.4f } }
+	};
+
+	// knife with a wooden handle
+	const BUILTIN_PART KNIFE_PARTS[] =
+	{
+		{ SceneFile::MESH_TAPERED_CYLINDER, "wood", "wood", { 0.3f, 0.3f, 0.2f, 1.0f }, { 1.0f, 1.0f }, { 0.45f, 2.9f, 0.35f }, { 90.0f, 178.0f, 80.0f }, { -3.0f, 0.35f, 0.0f } },
+		{ SceneFile::MESH_CYLINDER, "metal", "metal", { 0.3f, 0.3f, 0.2f, 1.0f }, { 1.0f, 1.0f }, { 0.451f, 0.1f, 0.351f }, { 90.0f, 178.0f, 80.0f }, { -3.01f, 0.35f, 0.0f } },
+		{ SceneFile::MESH_CYLINDER, "metal", "metal", { 0.3f, 0.3f, 0.2f, 1.0f }, { 1.0f, 1.0f }, { 0.27f, 0.35f, 0.2f }, { 90.0f, 178.0f, 80.0f }, { -0.4f, 0.27f, 0.45f } },
+		{ SceneFile::MESH_CYLINDER, "metal", "metal", { 0.3f, 0.3f, 0.2f, 1.0f }, { 1.0f, 1.0f }, { 0.65f, 4.5f, 0.02f }, { 88.0f, 178.0f, 80.0f }, { -0.05f, 0.27f, 0.1f } },
+		{ SceneFile::MESH_PYRAMID4, "metal", "metal", { 0.3f, 0.3f, 0.2f, 1.0f }, { 0.3f, 0.3f }, { 1.43f, 1.25f, 0.02f }, { 88.0f, 178.0f, 105.0f }, { 4.65f, 0.125f, 0.675f } }
+	};
+
+	// the composite objects of the built-in scene, the same prefabs
+	// as the kitchen scene file
+	struct BUILTIN_PREFAB
+	{
+		const char* name;
+		const BUILTIN_PART* pParts;
+		int partCount;
+	};
+	const BUILTIN_PREFAB BUILTIN_PREFABS[] =
+	{
+		{ "jar", JAR_PARTS, sizeof(JAR_PARTS) / sizeof(JAR_PARTS[0]) },
+		{ "cup", CUP_PARTS, sizeof(CUP_PARTS) / sizeof(CUP_PARTS[0]) },
+		{ "cucumber", CUCUMBER_PARTS, sizeof(CUCUMBER_PARTS) / sizeof(CUCUMBER_PARTS[0]) },
+		{ "knife", KNIFE_PARTS, sizeof(KNIFE_PARTS) / sizeof(KNIFE_PARTS[0]) }
+	};
+
+	// bit layout of the draw sort keys, from the most significant
+	// bit down. Opaque draws sort by state and then front to back,
+	// transparent draws back to front and then by state, or only by
+	// state with order-independent transparency. The mesh
+	// range sorts above the material, which is per-instance data
+	// and does not split instanced batches; without bindless
+	// textures the texture is per-instance data too and sorts
+	// below the mesh range
+	const int DRAW_KEY_PASS_SHIFT = 63;			// 1 bit, 1 = transparent
+	const int DRAW_KEY_QUERY_SHIFT = 62;		// 1 bit, 1 = opaque under an occlusion query
+	const int DRAW_KEY_PROGRAM_BITS = 5;
+	const int DRAW_KEY_TEXTURE_BITS = 9;		// texture slot + 1, 0 = none
+	const int DRAW_KEY_RANGE_BITS = 16;			// index into m_meshRanges
+	const int DRAW_KEY_MATERIAL_BITS = 6;
+	const int DRAW_KEY_DEPTH_BITS = 24;
+	const int DRAW_KEY_STATE_BITS = DRAW_KEY_PROGRAM_BITS + DRAW_KEY_TEXTURE_BITS +
+		DRAW_KEY_RANGE_BITS + DRAW_KEY_MATERIAL_BITS;
+
+	static_assert(ShaderManager::PERMUTATION_COUNT <= (1 << DRAW_KEY_PROGRAM_BITS), "program does not fit the draw key");
+	static_assert(SceneManager::MAX_MATERIALS <= (1 << DRAW_KEY_MATERIAL_BITS), "material does not fit the draw key");
+	static_assert(TextureTable::MAX_TEXTURES < (1 << DRAW_KEY_TEXTURE_BITS), "texture does not fit the draw key");
+	static_assert(2 + DRAW_KEY_STATE_BITS + DRAW_KEY_DEPTH_BITS <= 64, "draw key fields overflow 64 bits");
+
+	/***********************************************************
+	 *  QuantizeDepth()
+	 *
+	 *  This function is used for turning a non-negative distance
+	 *  into an unsigned integer of DRAW_KEY_DEPTH_BITS bits that
+	 *  sorts in the same order. The bits of a positive float
+	 *  already compare like the float, so its low mantissa bits
+	 *  are dropped.
+	 ***********************************************************/
+	uint64_t QuantizeDepth(float distance)
+	{
+		uint32_t bits = 0;
+		memcpy(&bits, &distance, sizeof(bits));
+		return((uint64_t)(bits >> (32 - DRAW_KEY_DEPTH_BITS)));
+	}
+
+	/***********************************************************
+	 *  ParallelRadixSortDrawKeys()
+	 *
+	 *  This function is used for sorting the draw keys with the
+	 *  radix sort below, split into a chunk of keys per thread
+	 *  of the job system. Every byte pass counts the buckets of
+	 *  each chunk, then a job waiting for the counts turns them
+	 *  into the first slot of each bucket of each chunk, and
+	 *  the chunks scatter their keys once it is done. Bucket
+	 *  by bucket the lower chunks go first, so the sort stays
+	 *  stable.
+	 ***********************************************************/
+	void ParallelRadixSortDrawKeys(
+		std::vector<SceneManager::DRAW_KEY>& keys,
+		std::vector<SceneManager::DRAW_KEY>& scratch,
+		JobSystem& jobSystem)
+	{
+		const size_t keyCount = keys.size();
+		const size_t chunkCount = (size_t)jobSystem.GetThreadCount();
+		const size_t chunkSize = (keyCount + chunkCount - 1) / chunkCount;
+		scratch.resize(keyCount);
+		FrameVector<size_t> chunkCounts(chunkCount * 256);
+
+		for (int shift = 0; shift < 64; shift += 8)
+		{
+			JobSystem::JOB_COUNTER counting;
+			JobSystem::JOB_COUNTER offsets;
+			JobSystem::JOB_COUNTER scattering;
+			bool bSkipPass = false;
+
+			for (size_t chunk = 0; chunk < chunkCount; chunk++)
+			{
+				jobSystem.Run([&, chunk]()
+					{
+						size_t* counts = &chunkCounts[chunk * 256];
+						std::fill(counts, counts + 256, (size_t)0);
+						size_t end = std::min((chunk + 1) * chunkSize, keyCount);
+						for (size_t i = chunk * chunkSize; i < end; i++)
+						{
+							counts[(keys[i].key >> shift) & 0xFF]++;
+						}
+					}, &counting);
+			}
+
+			jobSystem.Run([&]()
+				{
+					size_t firstBucketKeys = 0;
+					for (size_t chunk = 0; chunk < chunkCount; chunk++)
+					{
+						firstBucketKeys += chunkCounts[chunk * 256 + ((keys[0].key >> shift) & 0xFF)];
+					}
+					// every key lands in the same bucket, nothing to reorder
+					bSkipPass = (firstBucketKeys == keyCount);
+
+					size_t offset = 0;
+					for (int bucket = 0; bucket < 256; bucket++)
+					{
+						for (size_t chunk = 0; chunk < chunkCount; chunk++)
+						{
+							size_t count = chunkCounts[chunk * 256 + bucket];
+							chunkCounts[chunk * 256 + bucket] = offset;
+							offset += count;
+						}
+					}
+				}, &offsets, &counting);
+
+			for (size_t chunk = 0; chunk < chunkCount; chunk++)
+			{
+				jobSystem.Run([&, chunk]()
+					{
+						if (bSkipPass == true)
+						{
+							return;
+						}
+						size_t* slots = &chunkCounts[chunk * 256];
+						size_t end = std::min((chunk + 1) * chunkSize, keyCount);
+						for (size_t i = chunk * chunkSize; i < end; i++)
+						{
+							scratch[slots[(keys[i].key >> shift) & 0xFF]++] = keys[i];
+						}
+					}, &scattering, &offsets);
+			}
+
+			jobSystem.Wait(scattering);
+			if (bSkipPass == false)
+			{
+				keys.swap(scratch);
+			}
+		}
+	}
+
+	/***********************************************************
+	 *  RadixSortDrawKeys()
+	 *
+	 *  This function is used for sorting the draw keys with a
+	 *  least significant byte first radix sort. Byte passes in
+	 *  which every key has the same value are skipped, which is
+	 *  most of them for a small scene. Long lists are sorted on
+	 *  the threads of the job system.
+	 ***********************************************************/
+	void RadixSortDrawKeys(
+		std::vector<SceneManager::DRAW_KEY>& keys,
+		std::vector<SceneManager::DRAW_KEY>& scratch,
+		JobSystem* pJobSystem)
+	{
+		const size_t keyCount = keys.size();
+		if ((NULL != pJobSystem) && (pJobSystem->GetThreadCount() > 1) &&
+			(keyCount >= PARALLEL_MIN_SORT_KEYS))
+		{
+			ParallelRadixSortDrawKeys(keys, scratch, *pJobSystem);
+			return;
+		}
+		scratch.resize(keyCount);
+
+		for (int shift = 0; shift < 64; shift += 8)
+		{
+			size_t counts[256] = { 0 };
+			for (size_t i = 0; i < keyCount; i++)
+			{
+				counts[(keys[i].key >> shift) & 0xFF]++;
+			}
+
+			// every key lands in the same bucket, nothing to reorder
+			if (counts[(keys[0].key >> shift) & 0xFF] == keyCount)
+			{
+				continue;
+			}
+
+			size_t offset = 0;
+			for (int bucket = 0; bucket < 256; bucket++)
+			{
+				size_t count = counts[bucket];
+				counts[bucket] = offset;
+				offset += count;
+			}
+
+			for (size_t i = 0; i < keyCount; i++)
+			{
+				scratch[counts[(keys[i].key >> shift) & 0xFF]++] = keys[i];
+			}
+			keys.swap(scratch);
+		}
+	}
+
+	/***********************************************************
+	 *  GetLightType()
+	 *
+	 *  This function is used for the terms a light needs in the
+	 *  fragment shaders. A light without diffuse or specular
+	 *  color only adds its ambient term, as it casts no shadow,
+	 *  and one without specular intensity skips the highlight.
+	 ***********************************************************/
+	int GetLightType(const SceneManager::LIGHT_SOURCE& light)
+	{
+		glm::vec3 directLight = light.diffuseColor + light.specularColor;
+		if (glm::max(directLight.x, glm::max(directLight.y, directLight.z)) <= 0.0f)
+		{
+			return(SceneManager::LIGHT_TYPE_AMBIENT);
+		}
+		if (light.specularIntensity <= 0.0f)
+		{
+			return(SceneManager::LIGHT_TYPE_DIFFUSE);
+		}
+		return(SceneManager::LIGHT_TYPE_POINT);
+	}
+
+	/***********************************************************
+	 *  GetMaxAxisScale()
+	 *
+	 *  This function is used for the largest scale of a model
+	 *  matrix along its axes, which a bounding sphere grows by.
+	 ***********************************************************/
+	float GetMaxAxisScale(const glm::mat4& model)
+	{
+		return(glm::max(glm::length(glm::vec3(model[0])),
+			glm::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2])))));
+	}
+
+	/***********************************************************
+	 *  IntersectRayTriangle()
+	 *
+	 *  This function is used for finding the distance along a
+	 *  ray where it crosses a triangle, from either side, with
+	 *  the Moller-Trumbore test.
+	 ***********************************************************/
+	bool IntersectRayTriangle(
+		const glm::vec3& origin,
+		const glm::vec3& direction,
+		const glm::vec3& vertex0,
+		const glm::vec3& vertex1,
+		const glm::vec3& vertex2,
+		float& distance)
+	{
+		glm::vec3 edge1 = vertex1 - vertex0;
+		glm::vec3 edge2 = vertex2 - vertex0;
+		glm::vec3 p = glm::cross(direction, edge2);
+		float determinant = glm::dot(edge1, p);
+		// the ray runs along the plane of the triangle
+		if (glm::abs(determinant) < 1e-12f)
+		{
+			return(false);
+		}
+
+		float inverseDeterminant = 1.0f / determinant;
+		glm::vec3 s = origin - vertex0;
+		float u = glm::dot(s, p) * inverseDeterminant;
+		if ((u < 0.0f) || (u > 1.0f))
+		{
+			return(false);
+		}
+		glm::vec3 q = glm::cross(s, edge1);
+		float v = glm::dot(direction, q) * inverseDeterminant;
+		if ((v < 0.0f) || (u + v > 1.0f))
+		{
+			return(false);
+		}
+
+		distance = glm::dot(edge2, q) * inverseDeterminant;
+		return(distance >= 0.0f);
+	}
+
+	/***********************************************************
+	 *  MakeResourceObject()
+	 *
+	 *  This function is used for the object the resource
+	 *  manager keeps for a GL name or an object of the scene.
+	 ***********************************************************/
+	ResourceManager::RESOURCE_OBJECT MakeResourceObject(GLuint name, void* pData)
+	{
+		ResourceManager::RESOURCE_OBJECT object;
+		object.name = name;
+		object.pData = pData;
+		object.index = -1;
+		return(object);
+	}
+
+	// what the resource manager frees the scene's objects with
+	void DestroyTextureObject(const ResourceManager::RESOURCE_OBJECT& object)
+	{
+		GPUMemory::DeleteTextures(1, &object.name);
+	}
+	void DestroyProgramObject(const ResourceManager::RESOURCE_OBJECT& object)
+	{
+		glDeleteProgram(object.name);
+	}
+	void DestroyShapeMeshesObject(const ResourceManager::RESOURCE_OBJECT& object)
+	{
+		delete static_cast<ShapeMeshes*>(object.pData);
+	}
+
+	/***********************************************************
+	 *  GetWarmUpKey()
+	 *
+	 *  This function is used for the key of a combination the
+	 *  driver may build a variant of a program for: the pass,
+	 *  the permutation, the VAO with the primitive and index
+	 *  types drawn from it, and the face culling.
+	 ***********************************************************/
+	uint64_t GetWarmUpKey(int pass, int permutation, const ShapeMeshes::DRAW_RANGE& range, bool bCulled)
+	{
+		uint64_t indexType = 0;
+		if (range.bIndexed == true)
+		{
+			indexType = (range.indexType == GL_UNSIGNED_SHORT) ? 1 : ((range.indexType == GL_UNSIGNED_INT) ? 2 : 3);
+		}
+		return(((uint64_t)range.vao << 32) | ((uint64_t)(range.mode & 0xF) << 16) | (indexType << 14) |
+			((uint64_t)((bCulled == true) ? 1 : 0) << 13) | ((uint64_t)pass << 8) | (uint64_t)(permutation & 0xFF));
+	}
+
+	/***********************************************************
+	 *  CreateWarmUpTarget()
+	 *
+	 *  This function is used for creating a framebuffer of the
+	 *  warm-up size with color targets of the formats given and
+	 *  a 32 bit float depth target, all of the samples given,
+	 *  and binding it. The textures are created without being
+	 *  bound, so the units the shader manager tracks keep what
+	 *  it knows of them, and are added to the list to delete.
+	 ***********************************************************/
+	GLuint CreateWarmUpTarget(const GLenum* pColorFormats, int colorCount, int samples, std::vector<GLuint>& textures)
+	{
+		GLuint framebuffer = 0;
+		glCreateFramebuffers(1, &framebuffer);
+		GLenum drawBuffers[4] = { GL_NONE, GL_NONE, GL_NONE, GL_NONE };
+		for (int target = 0; target <= colorCount; target++)
+		{
+			GLenum format = (target < colorCount) ? pColorFormats[target] : (GLenum)GL_DEPTH_COMPONENT32F;
+			GLuint texture = 0;
+			if (samples > 1)
+			{
+				glCreateTextures(GL_TEXTURE_2D_MULTISAMPLE, 1, &texture);
+				glTextureStorage2DMultisample(texture, samples, format, WARMUP_TARGET_SIZE, WARMUP_TARGET_SIZE, GL_TRUE);
+			}
+			else
+			{
+				glCreateTextures(GL_TEXTURE_2D, 1, &texture);
+				glTextureStorage2D(texture, 1, format, WARMUP_TARGET_SIZE, WARMUP_TARGET_SIZE);
+			}
+			GLenum attachment = (target < colorCount) ? (GLenum)(GL_COLOR_ATTACHMENT0 + target) : (GLenum)GL_DEPTH_ATTACHMENT;
+			glNamedFramebufferTexture(framebuffer, attachment, texture, 0);
+			if (target < colorCount)
+			{
+				drawBuffers[target] = attachment;
+			}
+			textures.push_back(texture);
+		}
+		glNamedFramebufferDrawBuffers(framebuffer, glm::max(colorCount, 1), drawBuffers);
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffer);
+		return(framebuffer);
+	}
 }
 
 /***********************************************************
@@ -39,10 +722,133 @@ namespace
  *
  *  The constructor for the class
  ***********************************************************/
-SceneManager::SceneManager(ShaderManager *pShaderManager)
+SceneManager::SceneManager(ShaderManager *pShaderManager, UploadRing* pUploadRing, JobSystem* pJobSystem,
+	ResourceManager* pResources)
+	: m_textureTags("texture"), m_materialTags("material")
 {
 	m_pShaderManager = pShaderManager;
+	m_pResources = pResources;
+	m_pUploadRing = pUploadRing;
+	m_pJobSystem = pJobSystem;
+	m_pGPUProfiler = NULL;
+	for (int i = 0; i < GPUProfiler::PASS_COUNT; i++)
+	{
+		m_bPassGroupOpen[i] = false;
+	}
+	m_sceneTransforms.SetJobSystem(pJobSystem);
+	m_meshPages.Create(MESH_PAGE_SIZE, GPUMemory::CATEGORY_MESH, "mesh pages");
 	m_basicMeshes = new ShapeMeshes();
+	m_basicMeshes->SetBufferAllocator(&m_meshPages);
+	m_basicMeshes->SetModelMeshSource(ImportModelMesh, this);
+	m_staticGeometry.SetBufferAllocator(&m_meshPages);
+	m_basicMeshesResource = m_pResources->Adopt<ResourceManager::RESOURCE_MESH>("shape meshes",
+		MakeResourceObject(0, m_basicMeshes), DestroyShapeMeshesObject);
+	m_pTextureTable = new TextureTable(pShaderManager);
+	m_pTextureStreamer = new TextureStreamer();
+	m_pTextureCache = new TextureCache();
+	m_pTextureCache->Open(TEXTURE_CACHE_DIRECTORY, TextureCache::DEFAULT_SIZE_LIMIT);
+	m_pTextureResidency = new TextureResidency(m_pTextureCache);
+	m_pTextureCompressor = new GPUTextureCompressor(pShaderManager);
+	m_bCompressTextures = false;
+	m_pVirtualTextures = new VirtualTextures(pShaderManager);
+	m_pTextureTable->SetVirtualTextures(m_pVirtualTextures);
+	m_bModelsAdded = false;
+	m_pAssetWatcher = NULL;
+	m_modelReloads = 0;
+	m_meshRetention = ShapeMeshes::RETAIN_CPU;
+	m_staticGeometryKey = 0;
+	m_worldChunks.SetReadyCallback(IsChunkReady, this);
+	m_recordChunk = -1;
+	m_prefabPart = -1;
+	memset(&m_prefabStats, 0, sizeof(m_prefabStats));
+	memset(&m_warmUpStats, 0, sizeof(m_warmUpStats));
+	m_pLightmapBaker = new LightmapBaker();
+	m_bLightmaps = false;
+	m_bLightmapOcclusion = false;
+	m_lightmapKey = 0;
+	m_lightmapTexture = 0;
+	m_bLightmapReady = false;
+	m_bLightsDirty = true;
+	m_bLightLOD = false;
+	m_bLightLODDirty = false;
+	m_bUseLighting = false;
+	m_bRecording = false;
+	m_viewPosition = glm::vec3(0.0f, 0.0f, 0.0f);
+	m_instanceTexture = 0;
+	m_instanceTextureBuffer = 0;
+	m_instanceBase = 0;
+	m_indirectOffset = -1;
+	m_bMultiDrawIndirect = false;
+	m_pOcclusionCuller = new OcclusionCuller(pShaderManager);
+	m_pMeshletCuller = new MeshletCuller(pShaderManager);
+	m_bMeshShading = true;
+	m_pPrimitiveGenerator = new PrimitiveGenerator(pShaderManager);
+	m_bGPUPrimitives = false;
+	m_pInstanceExpander = new InstanceExpander(pShaderManager);
+	m_bCompactInstances = false;
+	m_bCompactInstancesPacked = false;
+	m_pResidentInstances = new DirtyRangeBuffer(sizeof(INSTANCE_DATA), "resident instances");
+	m_bResidentInstances = true;
+	m_bResidentInstancesCurrent = false;
+	m_pSceneAnimation = new SceneAnimation(pShaderManager);
+	m_animationTime = 0.0;
+	m_bAnimationSampled = false;
+	m_pParticleSystem = new ParticleSystem(pShaderManager);
+	m_bObjectLights = false;
+	m_pTransparencyPass = new TransparencyPass(pShaderManager);
+	m_pLightClusters = new LightClusters(pShaderManager);
+	m_pDeferredPass = new DeferredPass(pShaderManager);
+	m_bDeferredShading = false;
+	m_pShadingRate = new ShadingRate(pShaderManager);
+	m_bVariableRateShading = false;
+	m_pRenderGraph = new RenderGraph(pShaderManager);
+	m_pPostStack = new PostStack(pShaderManager);
+	m_antiAliasing = PostStack::AA_NONE;
+	m_maxSamples = 1;
+	m_bReverseZ = false;
+	m_bStereo = false;
+	m_commandBufferCount = 0;
+	m_transparentBuffer = 0;
+	m_transparentCommand = 0;
+	m_pShadowAtlas = new ShadowAtlas(pShaderManager);
+	m_shadowAtlasBudget = DEFAULT_SHADOW_ATLAS_BUDGET;
+	m_pCascadedShadows = new CascadedShadows(pShaderManager);
+	SetTargetFormatTier(TargetFormats::DEFAULT_TIER);
+	m_pReflectionProbes = new ReflectionProbes(pShaderManager);
+	m_bCapturingProbe = false;
+	m_pImpostorAtlas = new ImpostorAtlas(pShaderManager);
+	m_impostorPixels = DEFAULT_IMPOSTOR_PIXELS;
+	m_pObjectPicker = new ObjectPicker(pShaderManager);
+	m_pOcclusionQueries = new OcclusionQueries(pShaderManager);
+	m_bOcclusionQueries = false;
+	m_pRenderStates = new RenderStateCache();
+	CreateRenderStates();
+	m_lodBias = 0.0f;
+	m_impostorStats.impostorsDrawn = 0;
+	m_impostorStats.drawsReplaced = 0;
+	m_impostorStats.shapesCaptured = 0;
+	m_bCompactVertices = true;
+	m_bOrderIndependentTransparency = false;
+	m_depthPrepassProgram = 0;
+	m_depthPrepassInstanceBaseLocation = -1;
+	m_bDepthPrepass = false;
+	m_bInstanceDataDirty = false;
+	m_bDrawsAdded = false;
+	m_currentParentNode = -1;
+	m_recordModel = glm::mat4(1.0f);
+	m_viewMatrix = glm::mat4(1.0f);
+	m_projectionMatrix = glm::mat4(1.0f);
+	m_viewProjection = glm::mat4(1.0f);
+	m_bHasViewProjection = false;
+	m_lastCameraPosition = glm::vec3(0.0f);
+	m_lastCameraOrientation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+	m_bHasLastCamera = false;
+	m_bPrimaryView = true;
+	m_bInstanceCopyWritten = false;
+	m_cullStats.drawsTested = 0;
+	m_cullStats.drawsCulled = 0;
+
+	ResolveShaderUniforms();
 }
 
 /***********************************************************
@@ -52,9 +858,120 @@ SceneManager::SceneManager(ShaderManager *pShaderManager)
  ***********************************************************/
 SceneManager::~SceneManager()
 {
+	delete m_pOcclusionCuller;
+	m_pOcclusionCuller = NULL;
+	delete m_pMeshletCuller;
+	m_pMeshletCuller = NULL;
+	delete m_pPrimitiveGenerator;
+	m_pPrimitiveGenerator = NULL;
+	delete m_pInstanceExpander;
+	m_pInstanceExpander = NULL;
+	delete m_pResidentInstances;
+	m_pResidentInstances = NULL;
+	delete m_pSceneAnimation;
+	m_pSceneAnimation = NULL;
+	delete m_pParticleSystem;
+	m_pParticleSystem = NULL;
+	delete m_pTransparencyPass;
+	m_pTransparencyPass = NULL;
+	delete m_pLightClusters;
+	m_pLightClusters = NULL;
+	delete m_pDeferredPass;
+	m_pDeferredPass = NULL;
+	delete m_pShadingRate;
+	m_pShadingRate = NULL;
+	delete m_pPostStack;
+	m_pPostStack = NULL;
+	delete m_pRenderGraph;
+	m_pRenderGraph = NULL;
+	delete m_pShadowAtlas;
+	m_pShadowAtlas = NULL;
+	delete m_pCascadedShadows;
+	m_pCascadedShadows = NULL;
+	delete m_pReflectionProbes;
+	m_pReflectionProbes = NULL;
+	delete m_pImpostorAtlas;
+	m_pImpostorAtlas = NULL;
+	delete m_pObjectPicker;
+	m_pObjectPicker = NULL;
+	delete m_pOcclusionQueries;
+	m_pOcclusionQueries = NULL;
+	delete m_pRenderStates;
+	m_pRenderStates = NULL;
+	ClearPrefabs();
+	DestroyGLTextures();
+	delete m_pTextureResidency;
+	m_pTextureResidency = NULL;
+	delete m_pTextureCompressor;
+	m_pTextureCompressor = NULL;
+	delete m_pTextureTable;
+	m_pTextureTable = NULL;
+	delete m_pVirtualTextures;
+	m_pVirtualTextures = NULL;
+	delete m_pTextureStreamer;
+	m_pTextureStreamer = NULL;
+	// after the streamer, whose workers write into the cache
+	delete m_pTextureCache;
+	m_pTextureCache = NULL;
+	delete m_pLightmapBaker;
+	m_pLightmapBaker = NULL;
+	if (0 != m_lightmapTexture)
+	{
+		GPUMemory::DeleteTextures(1, &m_lightmapTexture);
+		m_lightmapTexture = 0;
+	}
+	m_pResources->Release(m_depthPrepassResource);
+	m_depthPrepassProgram = 0;
 	m_pShaderManager = NULL;
-	delete m_basicMeshes;
+	// the models hold the shape meshes their meshes were added to, so
+	// the meshes go with the last of them
+	for (size_t i = 0; i < m_sceneFileModels.size(); i++)
+	{
+		m_pResources->Release(m_sceneFileModels[i].resource);
+	}
+	m_sceneFileModels.clear();
+	m_pResources->Release(m_basicMeshesResource);
+	m_pResources->EvictUnused();
 	m_basicMeshes = NULL;
+	m_pResources = NULL;
+	m_lightData.Destroy();
+	m_materialData.Destroy();
+	if (0 != m_instanceTexture)
+	{
+		GPUMemory::DeleteTextures(1, &m_instanceTexture);
+		m_instanceTexture = 0;
+	}
+	m_pUploadRing = NULL;
+}
+
+/***********************************************************
+ *  ResolveShaderUniforms()
+ *
+ *  This method is used for resolving every shader uniform
+ *  used by the scene into typed handles, so the per-draw
+ *  path never builds or compares uniform name strings.
+ ***********************************************************/
+void SceneManager::ResolveShaderUniforms()
+{
+	if (NULL == m_pShaderManager)
+	{
+		return;
+	}
+
+	m_uniforms.model = m_pShaderManager->GetUniformHandle<glm::mat4>("model");
+	m_uniforms.normalMatrix = m_pShaderManager->GetUniformHandle<glm::mat3>("normalMatrix");
+	m_uniforms.objectColor = m_pShaderManager->GetUniformHandle<glm::vec4>("objectColor");
+	m_uniforms.textureIndex = m_pShaderManager->GetUniformHandle<int>("textureIndex");
+	m_uniforms.UVscale = m_pShaderManager->GetUniformHandle<glm::vec2>("UVscale");
+	m_uniforms.materialIndex = m_pShaderManager->GetUniformHandle<int>("materialIndex");
+	m_uniforms.instanceData = m_pShaderManager->GetUniformHandle<int>("instanceData");
+	m_uniforms.instanceBase = m_pShaderManager->GetUniformHandle<int>("instanceBase");
+	m_uniforms.shadowAtlas = m_pShaderManager->GetUniformHandle<int>("shadowAtlas");
+	m_uniforms.cascadeShadowMap = m_pShaderManager->GetUniformHandle<int>("cascadeShadowMap");
+	m_uniforms.reflectionProbes = m_pShaderManager->GetUniformHandle<int>("reflectionProbes");
+	m_uniforms.textureArray = m_pShaderManager->GetUniformHandle<int>("textureArray");
+	m_uniforms.lightmap = m_pShaderManager->GetUniformHandle<int>("lightmap");
+	m_uniforms.lightmapEnabled = m_pShaderManager->GetUniformHandle<int>("lightmapEnabled");
 }
 
 /***********************************************************
@@ -67,565 +984,6760 @@ SceneManager::~SceneManager()
  ***********************************************************/
 bool SceneManager::CreateGLTexture(const char* filename, std::string tag)
 {
-	int width = 0;
-	int height = 0;
-	int colorChannels = 0;
-	GLuint textureID = 0;
-
-	// indicate to always flip images vertically when loaded
-	stbi_set_flip_vertically_on_load(true);
+	if (m_textureIDs.size() >= (size_t)TextureTable::MAX_TEXTURES)
+	{
+		LOG_WARNING("Could not load image:%s, all %d texture slots are used", filename, (int)TextureTable::MAX_TEXTURES);
+		return false;
+	}
+	if ((CreateVirtualGLTexture(filename, tag) == true) || (CreateCompressedGLTexture(filename, tag) == true) ||
+		(CreateCachedGLTexture(filename, tag) == true))
+	{
+		return true;
+	}
 
 	// try to parse the image data from the specified image file
-	unsigned char* image = stbi_load(
-		filename,
-		&width,
-		&height,
-		&colorChannels,
-		0);
+	ImageDecoder::IMAGE image;
+	if (ImageDecoder::Decode(filename, image) == false)
+	{
+		LOG_WARNING("Could not load image:%s", filename);
+
+		// Error loading the image
+		return false;
+	}
+
+	TEXTURE_INFO textureInfo;
+	textureInfo.ID = UploadGLTexture(filename, image);
+	textureInfo.tag = tag;
+	textureInfo.bHasAlpha = ImageDecoder::HasAlpha(image.fileChannels);
+	textureInfo.filename = filename;
+	textureInfo.bCompressed = false;
+	textureInfo.bVirtual = false;
 
-	// if the image was successfully read from the image file
-	if (image)
+	if (0 != textureInfo.ID)
 	{
-		std::cout << "Successfully loaded image:" << filename << ", width:" << width << ", height:" << height << ", channels:" << colorChannels << std::endl;
+		m_pTextureCache->Store(filename, image);
+	}
 
-		glGenTextures(1, &textureID);
-		glBindTexture(GL_TEXTURE_2D, textureID);
+	// free the image data from local memory
+	ImageDecoder::Free(image);
 
-		// set the texture wrapping parameters
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-		// set texture filtering parameters
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	if (0 == textureInfo.ID)
+	{
+		return false;
+	}
+	return(AddGLTexture(textureInfo));
+}
 
-		// if the loaded image is in RGB format
-		if (colorChannels == 3)
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, image);
-		// if the loaded image is in RGBA format - it supports transparency
-		else if (colorChannels == 4)
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, image);
-		else
+/***********************************************************
+ *  CreateGLTextures()
+ *
+ *  This method is used for loading several textures without
+ *  waiting for their images. Each texture slot starts with a
+ *  1x1 placeholder, while the image files are decoded on
+ *  worker threads and streamed into their textures over the
+ *  next frames by UpdateStreamedTextures(). The slots follow
+ *  the order of the files, so they are the same on every run.
+ ***********************************************************/
+int SceneManager::CreateGLTextures(const std::vector<TEXTURE_FILE>& files)
+{
+	std::vector<std::string> filenames;
+	std::vector<int> slots;
+	for (size_t i = 0; i < files.size(); i++)
+	{
+		// tiled files, compressed files and cache entries are read
+		// whole, or paged in, with no decode to wait for
+		if ((CreateVirtualGLTexture(files[i].filename, files[i].tag) == true) ||
+			(CreateCompressedGLTexture(files[i].filename, files[i].tag) == true) ||
+			(CreateCachedGLTexture(files[i].filename, files[i].tag) == true))
 		{
-			std::cout << "Not implemented to handle image with " << colorChannels << " channels" << std::endl;
-			return false;
+			continue;
 		}
 
-		// generate the texture mipmaps for mapping textures to lower resolutions
-		glGenerateMipmap(GL_TEXTURE_2D);
-
-		// free the image data from local memory
-		stbi_image_free(image);
-		glBindTexture(GL_TEXTURE_2D, 0); // Unbind the texture
+		// only the header is read here, for the transparency of the
+		// draws recorded before the pixels arrive
+		int width = 0;
+		int height = 0;
+		int colorChannels = 0;
+		if (ImageDecoder::ReadInfo(files[i].filename, width, height, colorChannels) == false)
+		{
+			LOG_WARNING("Could not load image:%s", files[i].filename);
+			continue;
+		}
+		GLenum internalFormat = GL_NONE;
+		GLenum format = GL_NONE;
+		if (TextureStreamer::GetPixelFormat(colorChannels, internalFormat, format) == false)
+		{
+			LOG_WARNING("Not implemented to handle image with %d channels", colorChannels);
+			continue;
+		}
 
-		// register the loaded texture and associate it with the special tag string
-		m_textureIDs[m_loadedTextures].ID = textureID;
-		m_textureIDs[m_loadedTextures].tag = tag;
-		m_loadedTextures++;
+		TEXTURE_INFO textureInfo;
+		textureInfo.ID = TextureStreamer::CreatePlaceholder();
+		textureInfo.tag = files[i].tag;
+		textureInfo.bHasAlpha = ImageDecoder::HasAlpha(colorChannels);
+		textureInfo.filename = files[i].filename;
+		textureInfo.bCompressed = false;
+		textureInfo.bVirtual = false;
+		if (AddGLTexture(textureInfo) == false)
+		{
+			GPUMemory::DeleteTextures(1, &textureInfo.ID);
+			continue;
+		}
 
-		return true;
+		filenames.push_back(files[i].filename);
+		slots.push_back((int)m_textureIDs.size() - 1);
 	}
 
-	std::cout << "Could not load image:" << filename << std::endl;
+	m_pTextureStreamer->Start(filenames, slots, m_pTextureCache);
 
-	// Error loading the image
-	return false;
+	return((int)slots.size());
 }
 
 /***********************************************************
- *  BindGLTextures()
+ *  CreateCompressedGLTexture()
  *
- *  This method is used for binding the loaded textures to
- *  OpenGL texture memory slots.  There are up to 16 slots.
+ *  This method is used for loading the KTX2 or DDS file that
+ *  stands in for an image file, with its precomputed mip
+ *  levels. The texture array fallback blits every texture
+ *  into RGBA8 layers, which a block compressed texture
+ *  cannot be read into, so without bindless textures the
+ *  image is always decoded instead.
  ***********************************************************/
-void SceneManager::BindGLTextures()
+bool SceneManager::CreateCompressedGLTexture(const std::string& imageFilename, const std::string& tag)
 {
-	for (int i = 0; i < m_loadedTextures; i++)
+	const bool bCompressedFile = CompressedTexture::IsCompressedFile(imageFilename);
+	if (GLEW_ARB_bindless_texture != GL_TRUE)
 	{
-		// bind textures on corresponding texture units
-		glActiveTexture(GL_TEXTURE0 + i);
-		glBindTexture(GL_TEXTURE_2D, m_textureIDs[i].ID);
+		if (true == bCompressedFile)
+		{
+			LOG_WARNING("Could not load compressed texture %s, the texture array cannot hold compressed textures without bindless textures",
+				imageFilename.c_str());
+			return(true);
+		}
+		return(false);
+	}
+
+	std::string filename = CompressedTexture::FindCompressedFile(imageFilename);
+	if (filename.empty() == true)
+	{
+		return(false);
+	}
+
+	CompressedTexture texture;
+	if (texture.Load(filename.c_str()) == false)
+	{
+		return(bCompressedFile);
+	}
+	if (CompressedTexture::IsFormatSupported(texture.GetFormat()) == false)
+	{
+		LOG_WARNING("Compressed texture %s is %s, which this GPU cannot sample", filename.c_str(),
+			CompressedTexture::GetFormatName(texture.GetFormat()));
+		return(bCompressedFile);
+	}
+
+	TEXTURE_INFO textureInfo;
+	textureInfo.ID = texture.CreateGLTexture();
+	textureInfo.tag = tag;
+	textureInfo.bHasAlpha = texture.HasAlpha();
+	textureInfo.filename = filename;
+	textureInfo.bCompressed = true;
+	textureInfo.bVirtual = false;
+	if (0 == textureInfo.ID)
+	{
+		return(bCompressedFile);
+	}
+
+	LOG_INFO("Successfully loaded compressed image:%s, width:%d, height:%d, format:%s, levels:%d", filename.c_str(),
+		(int)texture.GetWidth(), (int)texture.GetHeight(), CompressedTexture::GetFormatName(texture.GetFormat()), (int)texture.GetLevelCount());
+
+	// a full table is reported once, the image would not fit either
+	if (AddGLTexture(textureInfo) == false)
+	{
+		GPUMemory::DeleteTextures(1, &textureInfo.ID);
 	}
+	return(true);
 }
 
 /***********************************************************
- *  DestroyGLTextures()
+ *  CreateCachedGLTexture()
  *
- *  This method is used for freeing the memory in all the
- *  used texture memory slots.
+ *  This method is used for loading the texture cache entry
+ *  of an image file, with the mip levels generated when it
+ *  was first decoded. A changed image file has no entry, so
+ *  it is decoded and cached again.
  ***********************************************************/
-void SceneManager::DestroyGLTextures()
+bool SceneManager::CreateCachedGLTexture(const std::string& imageFilename, const std::string& tag)
 {
-	for (int i = 0; i < m_loadedTextures; i++)
+	int width = 0;
+	int height = 0;
+	int colorChannels = 0;
+	TEXTURE_INFO textureInfo;
+	textureInfo.ID = CompressGLTexture(m_pTextureCache->CreateGLTexture(imageFilename, width, height, colorChannels),
+		ImageDecoder::HasAlpha(colorChannels));
+	textureInfo.tag = tag;
+	textureInfo.bHasAlpha = ImageDecoder::HasAlpha(colorChannels);
+	textureInfo.filename = imageFilename;
+	textureInfo.bCompressed = false;
+	textureInfo.bVirtual = false;
+	if (0 == textureInfo.ID)
+	{
+		return(false);
+	}
+
+	LOG_INFO("Successfully loaded cached image:%s, width:%d, height:%d, channels:%d", imageFilename.c_str(),
+		width, height, colorChannels);
+
+	// a full table is reported once, the image would not fit either
+	if (AddGLTexture(textureInfo) == false)
 	{
-		glGenTextures(1, &m_textureIDs[i].ID);
+		GPUMemory::DeleteTextures(1, &textureInfo.ID);
 	}
+	return(true);
 }
 
 /***********************************************************
- *  FindTextureID()
+ *  CreateVirtualGLTexture()
  *
- *  This method is used for getting an ID for the previously
- *  loaded texture bitmap associated with the passed in tag.
+ *  This method is used for opening the tiled file written
+ *  beside an image file as a sparse texture, whose pages
+ *  are committed as the views read them. The tiled file is
+ *  neither watched nor cached, and the residency of the
+ *  mip levels leaves it to VirtualTextures.
  ***********************************************************/
-int SceneManager::FindTextureID(std::string tag)
+bool SceneManager::CreateVirtualGLTexture(const std::string& imageFilename, const std::string& tag)
 {
-	int textureID = -1;
-	int index = 0;
-	bool bFound = false;
+	if (VirtualTextures::IsSupported() == false)
+	{
+		return(false);
+	}
 
-	while ((index < m_loadedTextures) && (bFound == false))
+	const std::string filename = VirtualTextures::GetTiledFilename(imageFilename);
+	FILE* pFile = fopen(filename.c_str(), "rb");
+	if (NULL == pFile)
 	{
-		if (m_textureIDs[index].tag.compare(tag) == 0)
-		{
-			textureID = m_textureIDs[index].ID;
-			bFound = true;
-		}
-		else
-			index++;
+		return(false);
+	}
+	fclose(pFile);
+
+	TEXTURE_INFO textureInfo;
+	textureInfo.bHasAlpha = false;
+	textureInfo.ID = m_pVirtualTextures->Open(filename, textureInfo.bHasAlpha);
+	textureInfo.tag = tag;
+	textureInfo.filename = filename;
+	textureInfo.bCompressed = false;
+	textureInfo.bVirtual = true;
+	if (0 == textureInfo.ID)
+	{
+		return(false);
 	}
 
-	return(textureID);
+	// a full table is reported once, the image would not fit either
+	if (AddGLTexture(textureInfo) == false)
+	{
+		GPUMemory::DeleteTextures(1, &textureInfo.ID);
+	}
+	return(true);
 }
 
 /***********************************************************
- *  FindTextureSlot()
+ *  UpdateStreamedTextures()
  *
- *  This method is used for getting a slot index for the previously
- *  loaded texture bitmap associated with the passed in tag.
+ *  This method is used for uploading the next part of the
+ *  streamed images and swapping the textures they finished
+ *  in for the placeholders of their slots. The handles of
+ *  the bindless table are remade as each texture arrives,
+ *  while the texture array fallback, which repacks every
+ *  texture when it is built, waits for the last one.
  ***********************************************************/
-int SceneManager::FindTextureSlot(std::string tag)
+void SceneManager::UpdateStreamedTextures()
 {
-	int textureSlot = -1;
-	int index = 0;
-	bool bFound = false;
+	if (m_pTextureStreamer->IsBusy() == false)
+	{
+		return;
+	}
 
-	while ((index < m_loadedTextures) && (bFound == false))
+	std::vector<TextureStreamer::STREAMED_TEXTURE> completed;
+	m_pTextureStreamer->Update(completed);
+	for (size_t i = 0; i < completed.size(); i++)
 	{
-		if (m_textureIDs[index].tag.compare(tag) == 0)
+		if (0 != completed[i].texture)
 		{
-			textureSlot = index;
-			bFound = true;
+			ReplaceGLTexture(completed[i].slot, CompressGLTexture(completed[i].texture,
+				m_textureIDs[completed[i].slot].bHasAlpha));
 		}
-		else
-			index++;
 	}
 
-	return(textureSlot);
+	if ((m_streamedPlaceholders.empty() == false) &&
+		((m_pTextureTable->IsBindless() == true) || (m_pTextureStreamer->IsBusy() == false)))
+	{
+		BindGLTextures();
+
+		// the rebuilt table released the handles of the placeholders
+		GPUMemory::DeleteTextures((GLsizei)m_streamedPlaceholders.size(), &m_streamedPlaceholders[0]);
+		m_streamedPlaceholders.clear();
+	}
+}
+
+/***********************************************************
+ *  ReplaceGLTexture()
+ *
+ *  This method is used for putting a new texture in a slot,
+ *  behind the resource handle the slot already has, as a
+ *  streamed image replaces its placeholder or a reloaded
+ *  file the texture it had. The old texture is deleted once
+ *  the texture table stops reading it.
+ ***********************************************************/
+void SceneManager::ReplaceGLTexture(int slot, GLuint texture)
+{
+	TEXTURE_INFO& textureInfo = m_textureIDs[slot];
+	m_streamedPlaceholders.push_back(textureInfo.ID);
+	textureInfo.ID = texture;
+	m_pResources->SetObject(textureInfo.resource, MakeResourceObject(texture, NULL));
+	GLDebug::Label(GL_TEXTURE, texture, textureInfo.tag.c_str());
+	GPUMemory::SetOwner(GPUMemory::KIND_TEXTURE, texture, textureInfo.tag.c_str());
+	m_pTextureResidency->ReplaceTexture(slot, texture);
 }
 
 /***********************************************************
- *  FindMaterial()
+ *  UpdateAssetWatcher()
  *
- *  This method is used for getting a material from the previously
- *  defined materials list that is associated with the passed in tag.
+ *  This method is used for reloading the image and model
+ *  files saved since the last frame. Images are decoded by
+ *  the texture streamer again and swapped into their slots
+ *  like the first time, compressed files are read at once,
+ *  and models are imported again on the loader thread of
+ *  the resource manager. Textures and models loaded after
+ *  the watcher was set are watched once they show up.
  ***********************************************************/
-bool SceneManager::FindMaterial(std::string tag, OBJECT_MATERIAL& material)
+void SceneManager::UpdateAssetWatcher()
 {
-	if (m_objectMaterials.size() == 0)
+	if (NULL == m_pAssetWatcher)
 	{
-		return(false);
+		return;
 	}
 
-	int index = 0;
-	bool bFound = false;
-	while ((index < m_objectMaterials.size()) && (bFound == false))
+	while (m_textureWatches.size() < m_textureIDs.size())
+	{
+		const TEXTURE_INFO& textureInfo = m_textureIDs[m_textureWatches.size()];
+		m_textureWatches.push_back(((textureInfo.filename.empty() == false) && (textureInfo.bVirtual == false)) ?
+			m_pAssetWatcher->Watch(textureInfo.filename) : -1);
+	}
+	const SceneFile::MODEL_RECORD* pModels = m_sceneFile.GetModels();
+	while (m_modelWatches.size() < m_sceneFileModels.size())
+	{
+		m_modelWatches.push_back(m_pAssetWatcher->Watch(pModels[m_modelWatches.size()].path));
+	}
+
+	bool bReplaced = false;
+	for (size_t i = 0; i < m_textureWatches.size(); i++)
 	{
-		if (m_objectMaterials[index].tag.compare(tag) == 0)
+		if ((m_textureWatches[i] < 0) || (m_pAssetWatcher->TakeChange(m_textureWatches[i]) == false))
 		{
-			bFound = true;
-			material.ambientColor = m_objectMaterials[index].ambientColor;
-			material.ambientStrength = m_objectMaterials[index].ambientStrength;
-			material.diffuseColor = m_objectMaterials[index].diffuseColor;
-			material.specularColor = m_objectMaterials[index].specularColor;
-			material.shininess = m_objectMaterials[index].shininess;
+			continue;
 		}
-		else
+		LOG_INFO("Reloading texture %s", m_textureIDs[i].filename.c_str());
+		if (m_textureIDs[i].bCompressed == true)
+		{
+			bReplaced = (ReloadCompressedGLTexture((int)i) == true) || (bReplaced == true);
+		}
+		else if (std::find(m_pendingTextureReloads.begin(), m_pendingTextureReloads.end(), (int)i) ==
+			m_pendingTextureReloads.end())
 		{
-			index++;
+			m_pendingTextureReloads.push_back((int)i);
 		}
 	}
+	if (bReplaced == true)
+	{
+		BindGLTextures();
+		GPUMemory::DeleteTextures((GLsizei)m_streamedPlaceholders.size(), &m_streamedPlaceholders[0]);
+		m_streamedPlaceholders.clear();
+	}
 
-	return(true);
+	if ((m_pendingTextureReloads.empty() == false) && (m_pTextureStreamer->IsBusy() == false))
+	{
+		std::vector<std::string> filenames;
+		for (size_t i = 0; i < m_pendingTextureReloads.size(); i++)
+		{
+			filenames.push_back(m_textureIDs[m_pendingTextureReloads[i]].filename);
+		}
+		m_pTextureStreamer->Start(filenames, m_pendingTextureReloads, m_pTextureCache);
+		m_pendingTextureReloads.clear();
+	}
+
+	for (size_t i = 0; i < m_modelWatches.size(); i++)
+	{
+		// a model no chunk imported yet reads the new file when one does
+		if ((m_pAssetWatcher->TakeChange(m_modelWatches[i]) == false) ||
+			(m_sceneFileModels[i].resource.IsNull() == true))
+		{
+			continue;
+		}
+		std::shared_ptr<ModelImporter::MODEL> pModel = std::make_shared<ModelImporter::MODEL>();
+		std::string path = pModels[i].path;
+		int fileIndex = (int)i;
+		ResourceManager::LOAD_DESC reload;
+		reload.prepare = [pModel, path]() { return(ModelImporter::Import(path.c_str(), *pModel)); };
+		reload.create = [this, pModel, fileIndex](ResourceManager::RESOURCE_OBJECT& object) {
+			bool bReloaded = ReloadImportedModel(fileIndex, *pModel);
+			*pModel = ModelImporter::MODEL();
+			return(bReloaded);
+		};
+		if (m_pResources->Reload(m_sceneFileModels[i].resource, reload) == true)
+		{
+			std::cout << "Reloading model " << path << std::endl;
+		}
+		else
+		{
+			std::cout << "Could not reload model " << path << " while it is still loading" << std::endl;
+		}
+	}
 }
 
 /***********************************************************
- *  SetTransformations()
+ *  ReloadCompressedGLTexture()
  *
- *  This method is used for setting the transform buffer
- *  using the passed in transformation values.
+ *  This method is used for reading the KTX2 or DDS file of
+ *  a texture slot again. It is read whole with no decode,
+ *  so it is not worth a trip through the streamer.
  ***********************************************************/
-void SceneManager::SetTransformations(
-	glm::vec3 scaleXYZ,
-	float XrotationDegrees,
-	float YrotationDegrees,
-	float ZrotationDegrees,
-	glm::vec3 positionXYZ)
+bool SceneManager::ReloadCompressedGLTexture(int slot)
 {
-	// variables for this method
-	glm::mat4 modelView;
-	glm::mat4 scale;
-	glm::mat4 rotationX;
-	glm::mat4 rotationY;
-	glm::mat4 rotationZ;
-	glm::mat4 translation;
-
-	// set the scale value in the transform buffer
-	scale = glm::scale(scaleXYZ);
-	// set the rotation values in the transform buffer
-	rotationX = glm::rotate(glm::radians(XrotationDegrees), glm::vec3(1.0f, 0.0f, 0.0f));
-	rotationY = glm::rotate(glm::radians(YrotationDegrees), glm::vec3(0.0f, 1.0f, 0.0f));
-	rotationZ = glm::rotate(glm::radians(ZrotationDegrees), glm::vec3(0.0f, 0.0f, 1.0f));
-	// set the translation value in the transform buffer
-	translation = glm::translate(positionXYZ);
-
-	modelView = translation * rotationX * rotationY * rotationZ * scale;
+	const std::string& filename = m_textureIDs[slot].filename;
+	CompressedTexture texture;
+	if ((texture.Load(filename.c_str()) == false) ||
+		(CompressedTexture::IsFormatSupported(texture.GetFormat()) == false))
+	{
+		LOG_WARNING("Could not reload compressed texture %s, keeping the one loaded", filename.c_str());
+		return(false);
+	}
+	GLuint textureID = texture.CreateGLTexture();
+	if (0 == textureID)
+	{
+		return(false);
+	}
+	m_textureIDs[slot].bHasAlpha = texture.HasAlpha();
+	ReplaceGLTexture(slot, textureID);
+	return(true);
+}
 
-	if (NULL != m_pShaderManager)
+/***********************************************************
+ *  UpdateResources()
+ *
+ *  This method is used for moving the loads of the resource
+ *  manager along, which adds the models imported since the
+ *  last frame, streaming the chunks of a large scene file
+ *  in and out around the camera, and recording the render
+ *  list again with the draws of the new models and chunks.
+ ***********************************************************/
+void SceneManager::UpdateResources()
+{
+	UpdateAssetWatcher();
+	m_pResources->Update();
+	// chunks that came in or were dropped change the draws as well
+	bool bChunksChanged = m_worldChunks.Update(m_viewPosition);
+	if ((m_bModelsAdded == true) || (bChunksChanged == true))
 	{
-		m_pShaderManager->setMat4Value(g_ModelName, modelView);
+		m_bModelsAdded = false;
+		UploadMaterials();
+		BuildRenderList();
 	}
 }
 
 /***********************************************************
- *  SetShaderColor()
+ *  AddImportedModel()
  *
- *  This method is used for setting the passed in color
- *  into the shader for the next draw command
+ *  This method is used for adding a model the resource
+ *  manager imported to the scene: its primitives become
+ *  model meshes, and its materials object materials tagged
+ *  <model>.<material>.
  ***********************************************************/
-void SceneManager::SetShaderColor(
-	float redColorValue,
-	float greenColorValue,
-	float blueColorValue,
-	float alphaValue)
+void SceneManager::AddImportedModel(int fileIndex, ModelImporter::MODEL& model)
 {
-	// variables for this method
-	glm::vec4 currentColor;
+	const SceneFile::MODEL_RECORD* pModels = m_sceneFile.GetModels();
+	SCENE_MODEL& sceneModel = m_sceneFileModels[fileIndex];
+	std::string modelTag = pModels[fileIndex].tag;
 
-	currentColor.r = redColorValue;
-	currentColor.g = greenColorValue;
-	currentColor.b = blueColorValue;
-	currentColor.a = alphaValue;
+	int firstMaterialID = (int)m_objectMaterials.size();
+	for (size_t i = 0; i < model.materials.size(); i++)
+	{
+		m_objectMaterials.push_back(MakeModelMaterial(modelTag, model.materials[i]));
+	}
+	sceneModel.firstMaterialID = firstMaterialID;
+	sceneModel.materialCount = (int)model.materials.size();
 
-	if (NULL != m_pShaderManager)
+	for (size_t i = 0; i < model.primitives.size(); i++)
 	{
-		m_pShaderManager->setIntValue(g_UseTextureName, false);
-		m_pShaderManager->setVec4Value(g_ColorValueName, currentColor);
+		ModelImporter::MODEL_PRIMITIVE& primitive = model.primitives[i];
+		sceneModel.meshIDs.push_back(m_basicMeshes->AddModelMesh(modelTag + " " + primitive.name,
+			primitive.vertices, primitive.indices, primitive.lodVertices, primitive.lodIndices, primitive.lodErrors));
+		m_basicMeshes->SetModelMeshRetention(sceneModel.meshIDs.back(), m_meshRetention);
+		// primitives without a material, or whose material is past
+		// the material buffer, draw in the default one
+		int materialID = (primitive.materialIndex >= 0) ? firstMaterialID + primitive.materialIndex : 0;
+		sceneModel.materialIDs.push_back((materialID < MAX_MATERIALS) ? materialID : 0);
 	}
+
+	std::cout << "Imported model " << pModels[fileIndex].path << " with " << model.primitives.size()
+		<< " primitives and " << model.materials.size() << " materials" << std::endl;
+	m_bModelsAdded = (m_bModelsAdded == true) || (model.primitives.empty() == false);
 }
 
 /***********************************************************
- *  SetShaderTexture()
+ *  SetMeshRetention()
  *
- *  This method is used for setting the texture data
- *  associated with the passed in ID into the shader.
+ *  This method is used for setting what the model meshes
+ *  imported from here on keep on the CPU once drawn, so a
+ *  kiosk that never reads the vertices back does not hold
+ *  a second copy of every model.
  ***********************************************************/
-void SceneManager::SetShaderTexture(
-	std::string textureTag)
+bool SceneManager::SetMeshRetention(const char* name)
 {
-	if (NULL != m_pShaderManager)
+	ShapeMeshes::MESH_RETENTION retention = ShapeMeshes::FindMeshRetention(name);
+	if (retention == ShapeMeshes::RETAIN_COUNT)
+	{
+		return(false);
+	}
+	m_meshRetention = retention;
+	return(true);
+}
+
+/***********************************************************
+ *  ImportModelMesh()
+ *
+ *  This method is used by ShapeMeshes to build a model mesh
+ *  that dropped its CPU copy again: the model file it came
+ *  from is imported once more, on the calling thread, and
+ *  the primitive of the mesh taken from it.
+ ***********************************************************/
+bool SceneManager::ImportModelMesh(
+	void* pContext,
+	int modelMesh,
+	std::vector<GLfloat>& vertices,
+	std::vector<GLuint>& indices,
+	std::vector<GLfloat>* pLODVertices,
+	std::vector<GLuint>* pLODIndices,
+	float* pLODErrors)
+{
+	SceneManager* pScene = (SceneManager*)pContext;
+	for (size_t fileIndex = 0; fileIndex < pScene->m_sceneFileModels.size(); fileIndex++)
 	{
-		m_pShaderManager->setIntValue(g_UseTextureName, true);
+		const std::vector<int>& meshIDs = pScene->m_sceneFileModels[fileIndex].meshIDs;
+		std::vector<int>::const_iterator it = std::find(meshIDs.begin(), meshIDs.end(), modelMesh);
+		if (it == meshIDs.end())
+		{
+			continue;
+		}
 
-		int textureID = -1;
-		textureID = FindTextureSlot(textureTag);
-		m_pShaderManager->setSampler2DValue(g_TextureValueName, textureID);
+		const char* path = pScene->m_sceneFile.GetModels()[fileIndex].path;
+		ModelImporter::MODEL model;
+		size_t primitiveIndex = (size_t)(it - meshIDs.begin());
+		if ((ModelImporter::Import(path, model) == false) || (primitiveIndex >= model.primitives.size()))
+		{
+			return(false);
+		}
+		ModelImporter::MODEL_PRIMITIVE& primitive = model.primitives[primitiveIndex];
+		vertices.swap(primitive.vertices);
+		indices.swap(primitive.indices);
+		for (int i = 0; i < ModelImporter::LOD_LEVELS; i++)
+		{
+			pLODVertices[i].swap(primitive.lodVertices[i]);
+			pLODIndices[i].swap(primitive.lodIndices[i]);
+			pLODErrors[i] = primitive.lodErrors[i];
+		}
+		return(true);
 	}
+	return(false);
 }
 
 /***********************************************************
- *  SetTextureUVScale()
+ *  ReloadImportedModel()
  *
- *  This method is used for setting the texture UV scale
- *  values into the shader.
+ *  This method is used for updating a model from its file
+ *  imported again. Its model meshes get the new vertices
+ *  under the IDs the draws use and its materials are
+ *  updated where they are, so nothing else in the scene
+ *  has to know; a file whose primitive or material count
+ *  changed would need new IDs, so it waits for a restart.
  ***********************************************************/
-void SceneManager::SetTextureUVScale(float u, float v)
+bool SceneManager::ReloadImportedModel(int fileIndex, ModelImporter::MODEL& model)
 {
-	if (NULL != m_pShaderManager)
+	const SceneFile::MODEL_RECORD* pModels = m_sceneFile.GetModels();
+	SCENE_MODEL& sceneModel = m_sceneFileModels[fileIndex];
+	if ((model.primitives.size() != sceneModel.meshIDs.size()) ||
+		((int)model.materials.size() != sceneModel.materialCount))
+	{
+		std::cout << "Model " << pModels[fileIndex].path << " has " << model.primitives.size() << " primitives and "
+			<< model.materials.size() << " materials now, restart to load it" << std::endl;
+		return(false);
+	}
+
+	std::string modelTag = pModels[fileIndex].tag;
+	for (size_t i = 0; i < model.materials.size(); i++)
+	{
+		m_objectMaterials[sceneModel.firstMaterialID + i] = MakeModelMaterial(modelTag, model.materials[i]);
+	}
+	for (size_t i = 0; i < model.primitives.size(); i++)
 	{
-		m_pShaderManager->setVec2Value("UVscale", glm::vec2(u, v));
+		ModelImporter::MODEL_PRIMITIVE& primitive = model.primitives[i];
+		m_basicMeshes->ReplaceModelMesh(sceneModel.meshIDs[i], primitive.vertices, primitive.indices,
+			primitive.lodVertices, primitive.lodIndices, primitive.lodErrors);
+		int materialID = (primitive.materialIndex >= 0) ? sceneModel.firstMaterialID + primitive.materialIndex : 0;
+		sceneModel.materialIDs[i] = (materialID < MAX_MATERIALS) ? materialID : 0;
 	}
+
+	std::cout << "Reloaded model " << pModels[fileIndex].path << std::endl;
+	m_modelReloads++;
+	m_bModelsAdded = true;
+	return(true);
 }
 
 /***********************************************************
- *  SetShaderMaterial()
+ *  MakeModelMaterial()
  *
- *  This method is used for passing the material values
- *  into the shader.
+ *  This method is used for mapping the metallic roughness
+ *  factors of a material of an imported model onto the
+ *  Phong terms of the shader, metals tinting their
+ *  highlights with the base color and rough surfaces
+ *  spreading them.
  ***********************************************************/
-void SceneManager::SetShaderMaterial(
-	std::string materialTag)
+SceneManager::OBJECT_MATERIAL SceneManager::MakeModelMaterial(
+	const std::string& modelTag,
+	const ModelImporter::MODEL_MATERIAL& modelMaterial)
 {
-	if (m_objectMaterials.size() > 0)
+	glm::vec3 baseColor = glm::vec3(modelMaterial.baseColor);
+	OBJECT_MATERIAL material;
+	material.ambientColor = baseColor;
+	material.ambientStrength = 0.2f;
+	material.diffuseColor = baseColor * (1.0f - modelMaterial.metallic);
+	material.specularColor = glm::mix(glm::vec3(0.04f), baseColor, modelMaterial.metallic);
+	material.shininess = glm::mix(128.0f, 2.0f, modelMaterial.roughness);
+	material.reflectivity = modelMaterial.metallic * (1.0f - modelMaterial.roughness);
+	material.tag = modelTag + "." + modelMaterial.name;
+	material.bTransparent = (modelMaterial.bBlend == true) || (modelMaterial.baseColor.a < 1.0f);
+	material.bCoarseShading = false;
+	return(material);
+}
+
+/***********************************************************
+ *  UploadGLTexture()
+ *
+ *  This method is used for creating an OpenGL texture from a
+ *  decoded image, configuring the texture mapping parameters
+ *  and uploading its mip levels.
+ ***********************************************************/
+GLuint SceneManager::UploadGLTexture(const char* filename, const ImageDecoder::IMAGE& image)
+{
+	GLuint textureID = TextureStreamer::CreateTexture(image.width, image.height, image.colorChannels);
+	if (0 == textureID)
 	{
-		OBJECT_MATERIAL material;
-		bool bReturn = false;
+		return(0);
+	}
+
+	LOG_INFO("Successfully loaded image:%s, width:%d, height:%d, channels:%d", filename, image.width, image.height, image.fileChannels);
+
+	// the decoder made the mipmaps for mapping textures to lower resolutions
+	TextureStreamer::UploadImage(textureID, image);
+
+	return(CompressGLTexture(textureID, ImageDecoder::HasAlpha(image.fileChannels)));
+}
+
+/***********************************************************
+ *  CompressGLTexture()
+ *
+ *  This method is used for block compressing a texture made
+ *  from an image file on the GPU, once all its levels are
+ *  uploaded, and deleting the uncompressed one. The copy
+ *  into the compressed texture is queued before the delete,
+ *  so the pixels are still read from it.
+ ***********************************************************/
+GLuint SceneManager::CompressGLTexture(GLuint texture, bool bHasAlpha)
+{
+	if ((0 == texture) || (m_pTextureCompressor->IsAvailable() == false))
+	{
+		return(texture);
+	}
+
+	GLuint compressed = m_pTextureCompressor->Compress(texture, bHasAlpha);
+	if (0 == compressed)
+	{
+		return(texture);
+	}
+	GPUMemory::DeleteTextures(1, &texture);
+	return(compressed);
+}
+
+/***********************************************************
+ *  AddGLTexture()
+ *
+ *  This method is used for registering an uploaded texture
+ *  and associating it with its special tag string. From
+ *  here on the resource manager owns the texture.
+ ***********************************************************/
+bool SceneManager::AddGLTexture(const TEXTURE_INFO& textureInfo)
+{
+	if (m_textureIDs.size() >= (size_t)TextureTable::MAX_TEXTURES)
+	{
+		LOG_WARNING("Could not add texture \"%s\", all %d texture slots are used", textureInfo.tag.c_str(), (int)TextureTable::MAX_TEXTURES);
+		return false;
+	}
+
+	m_textureTags.Register(textureInfo.tag, (int)m_textureIDs.size());
+	GLDebug::Label(GL_TEXTURE, textureInfo.ID, textureInfo.tag.c_str());
+	GPUMemory::SetOwner(GPUMemory::KIND_TEXTURE, textureInfo.ID, textureInfo.tag.c_str());
+	// the pages of a virtual texture are kept within their own budget
+	m_pTextureResidency->SetTexture((int)m_textureIDs.size(), (textureInfo.bVirtual == true) ? 0 : textureInfo.ID,
+		textureInfo.filename, textureInfo.bCompressed);
+	m_textureIDs.push_back(textureInfo);
+	m_textureIDs.back().resource = m_pResources->Adopt<ResourceManager::RESOURCE_TEXTURE>(textureInfo.tag,
+		MakeResourceObject(textureInfo.ID, NULL), DestroyTextureObject);
+
+	return true;
+}
+
+/***********************************************************
+ *  BindGLTextures()
+ *
+ *  This method is used for making the loaded textures
+ *  readable by their texture slot through the texture
+ *  table, so draws select them with an index instead of a
+ *  texture unit and there is no limit of 16 slots.
+ ***********************************************************/
+void SceneManager::BindGLTextures()
+{
+	std::vector<GLuint> textures(m_textureIDs.size());
+	for (size_t i = 0; i < m_textureIDs.size(); i++)
+	{
+		textures[i] = m_textureIDs[i].ID;
+	}
 
-		bReturn = FindMaterial(materialTag, material);
-		if (bReturn == true)
+	if (m_pTextureTable->Build(textures) == false)
+	{
+		std::cout << "Could not build the texture table, textured draws will sample nothing" << std::endl;
+	}
+	else if ((textures.empty() == false) && (m_pTextureStreamer->IsBusy() == false))
+	{
+		if (m_pTextureTable->IsBindless() == true)
+		{
+			std::cout << "Texture table of " << textures.size() << " textures uses bindless handles" << std::endl;
+		}
+		else
 		{
-			m_pShaderManager->setVec3Value("material.ambientColor", material.ambientColor);
-			m_pShaderManager->setFloatValue("material.ambientStrength", material.ambientStrength);
-			m_pShaderManager->setVec3Value("material.diffuseColor", material.diffuseColor);
-			m_pShaderManager->setVec3Value("material.specularColor", material.specularColor);
-			m_pShaderManager->setFloatValue("material.shininess", material.shininess);
+			std::cout << "Texture table of " << textures.size() << " textures packed into "
+				<< m_pTextureTable->GetLayerCount() << " texture array layers of "
+				<< m_pTextureTable->GetLayerSize() << "x" << m_pTextureTable->GetLayerSize() << std::endl;
 		}
 	}
 }
 
+/***********************************************************
+ *  DestroyGLTextures()
+ *
+ *  This method is used for freeing the memory in all the
+ *  used texture memory slots. The textures are released to
+ *  the resource manager, which deletes them at once.
+ ***********************************************************/
+void SceneManager::DestroyGLTextures()
+{
+	m_pTextureStreamer->Cancel();
+	// resident handles have to be released before their textures
+	m_pTextureTable->Clear();
+	for (size_t i = 0; i < m_textureIDs.size(); i++)
+	{
+		m_pResources->Release(m_textureIDs[i].resource);
+	}
+	m_pResources->EvictUnused();
+	m_textureIDs.clear();
+	m_pTextureResidency->Clear();
+	m_pVirtualTextures->Clear();
+	if (m_streamedPlaceholders.empty() == false)
+	{
+		GPUMemory::DeleteTextures((GLsizei)m_streamedPlaceholders.size(), &m_streamedPlaceholders[0]);
+		m_streamedPlaceholders.clear();
+	}
+	// handles kept from the dropped textures no longer resolve
+	m_textureTags.Clear();
+}
+
+/***********************************************************
+ *  FindTextureID()
+ *
+ *  This method is used for getting an ID for the previously
+ *  loaded texture bitmap associated with the passed in tag.
+ ***********************************************************/
+int SceneManager::FindTextureID(const std::string& tag) const
+{
+	int textureSlot = FindTextureSlot(tag);
+	if (textureSlot < 0)
+	{
+		return(-1);
+	}
 
-/*******************************************************************/
-/*** STUDENTS CAN MODIFY the code in the methods BELOW for       ***/
-/*** preparing and rendering their own 3D replicated scenes.     ***/
-/*** Please refer to the code in the OpenGL sample project       ***/
-/*** for assistance.                                             ***/
-/********************************************************************/
+	return((int)m_textureIDs[textureSlot].ID);
+}
 
 /***********************************************************
-*  LoadSceneTextures() 
-* 
-*  This method is used for preparing the 3D scene by loading 
-*  the shapes, textures in memory to support the 3D scene 
-*  rendering 
-***********************************************************/ 
-void SceneManager::LoadSceneTextures() 
+ *  FindTextureSlot()
+ *
+ *  This method is used for getting a slot index for the previously
+ *  loaded texture bitmap associated with the passed in tag.
+ ***********************************************************/
+int SceneManager::FindTextureSlot(const std::string& tag) const
 {
-	bool bReturn = false;
-	// load each texture into memory with CreateGLTexture()
-	bReturn = CreateGLTexture("../../Utilities/textures/tile.jpg", "backdrop"); // Used for backdrop wall
-	bReturn = CreateGLTexture("../../Utilities/textures/counter.jpg", "counter"); // Used for counter surface
-	bReturn = CreateGLTexture("../../Utilities/textures/knife_handle.jpg", "wood"); // Used for knife handle and backdrop ledge
-	bReturn = CreateGLTexture("../../Utilities/textures/metal.jpg", "metal"); // Used for knife and cup metal
-	bReturn = CreateGLTexture("../../Utilities/textures/marble.jpg", "marble"); // Used for coaster
-	bReturn = CreateGLTexture("../../Utilities/textures/drywall.jpg", "plastic"); // Used for cutting board
-	bReturn = CreateGLTexture("../../Utilities/textures/cucumber_outer.jpeg", "cucumber_outer"); // Used for cucumber sides
-	bReturn = CreateGLTexture("../../Utilities/textures/cucumber_inner.jpg", "cucumber_inner"); // Used for cucumber interior
-	bReturn = CreateGLTexture("../../Utilities/textures/glass10.png", "glass10"); // Used for glass jar
-	bReturn = CreateGLTexture("../../Utilities/textures/glass13.png", "glass13");
+	return(m_textureTags.Resolve(m_textureTags.Find(tag)));
+}
 
-	// bind loaded textures to texture slots
-	BindGLTextures();
+/***********************************************************
+ *  FindMaterialID()
+ *
+ *  This method is used for getting the ID of a material from
+ *  the previously defined materials list that is associated
+ *  with the passed in tag. Returns -1 if no material matches.
+ *  The tags are registered by UploadMaterials().
+ ***********************************************************/
+int SceneManager::FindMaterialID(const std::string& tag) const
+{
+	return(m_materialTags.Resolve(m_materialTags.Find(tag)));
 }
 
 /***********************************************************
-*  DefineObjectMaterials()
-*
-*  This method configures various types of materials which
-*  can be set for each object with SetShaderMaterial(tag).
-***********************************************************/
-void SceneManager::DefineObjectMaterials()
+ *  UploadMaterials()
+ *
+ *  This method is used for writing every defined material
+ *  into the MaterialData uniform buffer, so selecting a
+ *  material for a draw only sets its integer index.
+ ***********************************************************/
+void SceneManager::UploadMaterials()
 {
-	/*Create glass material(used for complex glass jar)*/
-	OBJECT_MATERIAL glassMaterial;
-	// set attributes
-	glassMaterial.ambientColor = glm::vec3(0.4f, 0.4f, 0.4f);
-	glassMaterial.ambientStrength = 0.15f;
-	glassMaterial.diffuseColor = glm::vec3(0.32f, 0.32f, 0.3f);
-	glassMaterial.specularColor = glm::vec3(0.6f, 0.6f, 0.6f);
-	glassMaterial.shininess = 75.0f;
-	glassMaterial.tag = "glass"; // used to identify material
-	// load "glass" as a material
-	m_objectMaterials.push_back(glassMaterial);
+	int materialCount = (int)m_objectMaterials.size();
+	if (materialCount > MAX_MATERIALS)
+	{
+		std::cout << "Only the first " << MAX_MATERIALS << " of " << materialCount
+			<< " materials fit in the material buffer" << std::endl;
+		materialCount = MAX_MATERIALS;
+	}
 
-	/* Create wood material (used for wood countertop/knife handle) */
-	OBJECT_MATERIAL woodMaterial;
-	// set attributes
-	woodMaterial.ambientColor = glm::vec3(0.25f, 0.22f, 0.2f);
-	woodMaterial.ambientStrength = 0.2f;
-	woodMaterial.diffuseColor = glm::vec3(0.25f, 0.2f, 0.15f);
-	woodMaterial.specularColor = glm::vec3(0.2f, 0.2f, 0.2f);
-	woodMaterial.shininess = 5.0f;
-	woodMaterial.tag = "wood"; // used to identify material
-	// load "wood" as a material
-	m_objectMaterials.push_back(woodMaterial);
+	// only the uploaded materials can be selected by tag
+	m_materialTags.Clear();
+	for (int i = 0; i < materialCount; i++)
+	{
+		m_materialTags.Register(m_objectMaterials[i].tag, i);
+	}
 
-	/*Create plastic material(used for cup and cutting board)*/
-	OBJECT_MATERIAL plasticMaterial;
-	// set attributes
-	plasticMaterial.ambientColor = glm::vec3(0.2f, 0.2f, 0.23f);
-	plasticMaterial.ambientStrength = 0.15f;
-	plasticMaterial.diffuseColor = glm::vec3(0.25f, 0.255f, 0.28f);
-	plasticMaterial.specularColor = glm::vec3(0.32f, 0.32f, 0.3f);
-	plasticMaterial.shininess = 7.0f;
-	plasticMaterial.tag = "plastic"; // used to identify material
-	// load "plastic" as a material
-	m_objectMaterials.push_back(plasticMaterial);
+	std::vector<MATERIAL_DATA> materialData(MAX_MATERIALS);
+	for (int i = 0; i < materialCount; i++)
+	{
+		materialData[i].ambientColor = m_objectMaterials[i].ambientColor;
+		materialData[i].ambientStrength = m_objectMaterials[i].ambientStrength;
+		materialData[i].diffuseColor = m_objectMaterials[i].diffuseColor;
+		materialData[i].shininess = m_objectMaterials[i].shininess;
+		materialData[i].specularColor = m_objectMaterials[i].specularColor;
+		materialData[i].reflectivity = m_objectMaterials[i].reflectivity;
+	}
 
-	/*Create polished stone material(used for countertop, background wall and coaster)*/
-	OBJECT_MATERIAL stoneMaterial;
-	// set attributes
-	stoneMaterial.ambientColor = glm::vec3(0.39f, 0.37f, 0.35f);
-	stoneMaterial.ambientStrength = 0.25f;
-	stoneMaterial.diffuseColor = glm::vec3(0.4f, 0.37f, 0.35f);
-	stoneMaterial.specularColor = glm::vec3(0.27f, 0.3f, 0.33f);
-	stoneMaterial.shininess = 2.0f;
-	stoneMaterial.tag = "stone"; // used to identify material
-	// load "stone" as a material
-	m_objectMaterials.push_back(stoneMaterial);
+	// the G-buffer holds ID + 1, and every ID fits one bit of the mask
+	static_assert(MAX_MATERIALS <= 32, "material does not fit the coarse shading mask");
+	uint32_t coarseMaterials = 0;
+	for (int i = 0; i < materialCount; i++)
+	{
+		if (m_objectMaterials[i].bCoarseShading == true)
+		{
+			coarseMaterials |= (uint32_t)1 << i;
+		}
+	}
+	m_pShadingRate->SetCoarseMaterials(coarseMaterials);
+
+	if (m_materialData.IsCreated() == false)
+	{
+		m_materialData.Create(GPUBuffer::USAGE_STATIC, MAX_MATERIALS * sizeof(MATERIAL_DATA), &materialData[0],
+			GPUMemory::CATEGORY_BUFFER, "material data");
+	}
+	else
+	{
+		m_materialData.Update(0, MAX_MATERIALS * sizeof(MATERIAL_DATA), &materialData[0]);
+	}
+
+	glBindBufferBase(GL_UNIFORM_BUFFER, ShaderManager::MATERIAL_DATA_BINDING, m_materialData.GetName());
+}
+
+/***********************************************************
+ *  SetMaterialParameter()
+ *
+ *  This method is used for changing one parameter of an
+ *  uploaded material while the scene runs, writing the 48
+ *  bytes of its slot instead of the whole buffer. Whether
+ *  the material is transparent picks the pass of its draws
+ *  when they are recorded, so it is not among the
+ *  parameters.
+ ***********************************************************/
+bool SceneManager::SetMaterialParameter(
+	const std::string& tag,
+	const std::string& parameter,
+	const float* pValues,
+	int valueCount)
+{
+	int materialID = FindMaterialID(tag);
+	if ((materialID < 0) || (m_materialData.IsCreated() == false))
+	{
+		return(false);
+	}
+
+	OBJECT_MATERIAL& material = m_objectMaterials[materialID];
+	glm::vec3* pColor = NULL;
+	float* pValue = NULL;
+	if (parameter == "ambientColor")
+	{
+		pColor = &material.ambientColor;
+	}
+	else if (parameter == "diffuseColor")
+	{
+		pColor = &material.diffuseColor;
+	}
+	else if (parameter == "specularColor")
+	{
+		pColor = &material.specularColor;
+	}
+	else if (parameter == "ambientStrength")
+	{
+		pValue = &material.ambientStrength;
+	}
+	else if (parameter == "shininess")
+	{
+		pValue = &material.shininess;
+	}
+	else if (parameter == "reflectivity")
+	{
+		pValue = &material.reflectivity;
+	}
+
+	if ((NULL != pColor) && (valueCount >= 3))
+	{
+		*pColor = glm::vec3(pValues[0], pValues[1], pValues[2]);
+	}
+	else if ((NULL != pValue) && (valueCount >= 1))
+	{
+		*pValue = pValues[0];
+	}
+	else
+	{
+		return(false);
+	}
+
+	MATERIAL_DATA materialData;
+	materialData.ambientColor = material.ambientColor;
+	materialData.ambientStrength = material.ambientStrength;
+	materialData.diffuseColor = material.diffuseColor;
+	materialData.shininess = material.shininess;
+	materialData.specularColor = material.specularColor;
+	materialData.reflectivity = material.reflectivity;
+	m_materialData.Update(materialID * sizeof(MATERIAL_DATA), sizeof(MATERIAL_DATA), &materialData);
+	return(true);
+}
+
+/***********************************************************
+ *  SetTransformations()
+ *
+ *  This method is used for setting the transform buffer
+ *  using the passed in transformation values, relative to
+ *  the scene node opened by BeginSceneNode(). While the
+ *  render list is recorded each call adds a child node, so
+ *  the draw follows when its parent is moved. The normal
+ *  matrix is computed here once per draw, not per vertex.
+ ***********************************************************/
+void SceneManager::SetTransformations(
+	glm::vec3 scaleXYZ,
+	float XrotationDegrees,
+	float YrotationDegrees,
+	float ZrotationDegrees,
+	glm::vec3 positionXYZ)
+{
+	glm::vec3 rotationDegreesXYZ(XrotationDegrees, YrotationDegrees, ZrotationDegrees);
+
+	if (m_bRecording == true)
+	{
+		int nodeID = AddSceneNode("", scaleXYZ, rotationDegreesXYZ, positionXYZ);
+		m_recordState.nodeID = nodeID;
+		m_recordModel = m_sceneTransforms.GetNodeWorld(nodeID);
+		return;
+	}
+
+	glm::mat4 modelView = ComposeModelMatrix(scaleXYZ, rotationDegreesXYZ, positionXYZ);
+	if (m_currentParentNode >= 0)
+	{
+		modelView = m_sceneTransforms.GetNodeWorld(m_currentParentNode) * modelView;
+	}
+
+	if (NULL != m_pShaderManager)
+	{
+		m_pShaderManager->setUniform(m_uniforms.model, modelView);
+		m_pShaderManager->setUniform(m_uniforms.normalMatrix, ComputeNormalMatrix(modelView));
+	}
+}
+
+/***********************************************************
+ *  AddSceneNode()
+ *
+ *  This method is used for adding a node with the passed in
+ *  local transformation as a child of the open scene node,
+ *  and caching its world matrix.
+ ***********************************************************/
+int SceneManager::AddSceneNode(
+	std::string tag,
+	glm::vec3 scaleXYZ,
+	glm::vec3 rotationDegreesXYZ,
+	glm::vec3 positionXYZ)
+{
+	return(m_sceneTransforms.AddNode(tag, m_currentParentNode, scaleXYZ, rotationDegreesXYZ, positionXYZ));
+}
+
+/***********************************************************
+ *  BeginSceneNode()
+ *
+ *  This method is used for opening a parent node for the
+ *  parts of a composite object; transformations set until
+ *  EndSceneNode() are relative to it. Returns the node ID
+ *  for SetSceneNodeTransform().
+ ***********************************************************/
+int SceneManager::BeginSceneNode(
+	std::string tag,
+	glm::vec3 positionXYZ)
+{
+	int nodeID = AddSceneNode(tag, glm::vec3(1.0f, 1.0f, 1.0f), glm::vec3(0.0f, 0.0f, 0.0f), positionXYZ);
+	m_currentParentNode = nodeID;
+
+	return(nodeID);
+}
+
+/***********************************************************
+ *  EndSceneNode()
+ *
+ *  This method is used for closing the node opened by the
+ *  last BeginSceneNode(). Outside of recording the node only
+ *  lives while it is open.
+ ***********************************************************/
+void SceneManager::EndSceneNode()
+{
+	if (m_currentParentNode < 0)
+	{
+		return;
+	}
+
+	int nodeID = m_currentParentNode;
+	m_currentParentNode = m_sceneTransforms.GetNodeParent(nodeID);
+	if (m_bRecording == false)
+	{
+		m_sceneTransforms.TruncateNodes(nodeID);
+	}
+}
+
+/***********************************************************
+ *  FindSceneNode()
+ *
+ *  This method is used for getting the ID of the first
+ *  scene node with the passed in tag, -1 if there is none.
+ ***********************************************************/
+int SceneManager::FindSceneNode(std::string tag)
+{
+	return(m_sceneTransforms.FindNode(tag));
+}
+
+/***********************************************************
+ *  SetSceneNodeTransform()
+ *
+ *  This method is used for changing the local transform of
+ *  a scene node. The world matrices of the node and of its
+ *  descendants are rebuilt by the next RenderScene().
+ ***********************************************************/
+bool SceneManager::SetSceneNodeTransform(
+	int nodeID,
+	glm::vec3 scaleXYZ,
+	glm::vec3 rotationDegreesXYZ,
+	glm::vec3 positionXYZ)
+{
+	return(m_sceneTransforms.SetNodeTransform(nodeID, scaleXYZ, rotationDegreesXYZ, positionXYZ));
+}
+
+/***********************************************************
+ *  IsUnderSceneNode()
+ *
+ *  This method is used for telling whether a node is the
+ *  passed in root or one of its descendants.
+ ***********************************************************/
+bool SceneManager::IsUnderSceneNode(int nodeID, int rootID) const
+{
+	while (nodeID >= 0)
+	{
+		if (nodeID == rootID)
+		{
+			return(true);
+		}
+		nodeID = m_sceneTransforms.GetNodeParent(nodeID);
+	}
+	return(false);
+}
+
+/***********************************************************
+ *  SetSceneNodeColor()
+ *
+ *  This method is used for changing the color of the draws
+ *  following a scene node or its descendants. Only the
+ *  instance data is written again; the static draws are
+ *  baked with their colors and keep them.
+ ***********************************************************/
+bool SceneManager::SetSceneNodeColor(int nodeID, const glm::vec4& color)
+{
+	if ((nodeID < 0) || (nodeID >= m_sceneTransforms.GetNodeCount()))
+	{
+		return(false);
+	}
+
+	bool bFound = false;
+	for (size_t i = 0; i < m_renderList.size(); i++)
+	{
+		DRAW_RECORD& drawRecord = m_renderList[i];
+		if ((drawRecord.bStatic == true) || (IsUnderSceneNode(drawRecord.nodeID, nodeID) == false))
+		{
+			continue;
+		}
+		drawRecord.color = color;
+		bFound = true;
+	}
+
+	if (bFound == true)
+	{
+		m_bInstanceDataDirty = true;
+	}
+	return(bFound);
+}
+
+/***********************************************************
+ *  SetSceneNodeRemoved()
+ *
+ *  This method is used for taking the draws following a
+ *  scene node or its descendants out of every view, or
+ *  putting them back, without rebuilding the render list:
+ *  a removed draw holds an empty box in the hierarchy, so
+ *  no culling, shadow or ray query finds it, and it keeps
+ *  its index. The shadows it cast are drawn again.
+ ***********************************************************/
+bool SceneManager::SetSceneNodeRemoved(int nodeID, bool bRemoved)
+{
+	if ((nodeID < 0) || (nodeID >= m_sceneTransforms.GetNodeCount()))
+	{
+		return(false);
+	}
+
+	bool bFound = false;
+	for (size_t i = 0; i < m_renderList.size(); i++)
+	{
+		const DRAW_RECORD& drawRecord = m_renderList[i];
+		if ((drawRecord.bStatic == true) || (IsUnderSceneNode(drawRecord.nodeID, nodeID) == false))
+		{
+			continue;
+		}
+		bFound = true;
+		if ((m_drawRemoved[i] != 0) == bRemoved)
+		{
+			continue;
+		}
+
+		m_drawRemoved[i] = (bRemoved == true) ? 1 : 0;
+		const SceneBVH::AABB& bounds = m_sceneTransforms.GetDrawBounds((uint32_t)i);
+		m_sceneBVH.SetObjectBounds((uint32_t)i, (bRemoved == true) ? SceneBVH::EmptyBounds() : bounds);
+		if (drawRecord.bTransparent == false)
+		{
+			m_pShadowAtlas->InvalidateBox(bounds);
+			m_pCascadedShadows->InvalidateBox(bounds);
+		}
+	}
+	m_sceneBVH.Refit();
+
+	return(bFound);
+}
+
+/***********************************************************
+ *  IsSceneNodeRemoved()
+ *
+ *  This method is used for telling whether the draws under
+ *  a scene node were taken out by SetSceneNodeRemoved().
+ ***********************************************************/
+bool SceneManager::IsSceneNodeRemoved(int nodeID) const
+{
+	if ((nodeID < 0) || (nodeID >= m_sceneTransforms.GetNodeCount()))
+	{
+		return(false);
+	}
+
+	bool bFound = false;
+	for (size_t i = 0; i < m_renderList.size(); i++)
+	{
+		const DRAW_RECORD& drawRecord = m_renderList[i];
+		if ((drawRecord.bStatic == true) || (IsUnderSceneNode(drawRecord.nodeID, nodeID) == false))
+		{
+			continue;
+		}
+		if (m_drawRemoved[i] == 0)
+		{
+			return(false);
+		}
+		bFound = true;
+	}
+	return(bFound);
+}
+
+/***********************************************************
+ *  AddPrefabInstance()
+ *
+ *  This method is used for placing one more instance of a
+ *  compiled prefab while the scene runs. The draw records
+ *  are copied as the recording would, movable and at the
+ *  root, and indexed by the next UpdateScene(), so adding
+ *  many instances between two frames builds the hierarchy
+ *  over them once. The prefabs compiled by the recording
+ *  last until the next one, which also drops the instances
+ *  added since.
+ ***********************************************************/
+int SceneManager::AddPrefabInstance(
+	const std::string& prefabName,
+	const std::string& tag,
+	glm::vec3 scaleXYZ,
+	glm::vec3 rotationDegreesXYZ,
+	glm::vec3 positionXYZ)
+{
+	int prefabID = -1;
+	for (size_t i = 0; (i < m_prefabs.size()) && (prefabID < 0); i++)
+	{
+		if (m_prefabs[i].name == prefabName)
+		{
+			prefabID = (int)i;
+		}
+	}
+	if (prefabID < 0)
+	{
+		return(-1);
+	}
+
+	int parentNode = m_currentParentNode;
+	bool bStatic = m_recordState.bStatic;
+	m_currentParentNode = -1;
+	m_recordState.bStatic = false;
+	int nodeID = PlacePrefab(prefabID, tag, scaleXYZ, rotationDegreesXYZ, positionXYZ);
+	m_currentParentNode = parentNode;
+	m_recordState.bStatic = bStatic;
+
+	m_drawRemoved.resize(m_renderList.size(), 0);
+	m_bDrawsAdded = true;
+	return(nodeID);
+}
+
+/***********************************************************
+ *  UpdateSceneTransforms()
+ *
+ *  This method is used for rebuilding the world matrices of
+ *  the moved scene nodes and the draws that follow them, then
+ *  refitting the hierarchy and invalidating the shadows the
+ *  moved draws left or entered. Nothing runs while no node
+ *  moved.
+ ***********************************************************/
+void SceneManager::UpdateSceneTransforms()
+{
+	if (m_sceneTransforms.Update() == false)
+	{
+		return;
+	}
+
+	const std::vector<uint32_t>& movedDraws = m_sceneTransforms.GetMovedDraws();
+	for (size_t i = 0; i < movedDraws.size(); i++)
+	{
+		uint32_t drawIndex = movedDraws[i];
+		// a removed draw keeps its empty box wherever it moves
+		if (m_drawRemoved[drawIndex] != 0)
+		{
+			continue;
+		}
+		m_sceneBVH.SetObjectBounds(drawIndex, m_sceneTransforms.GetDrawBounds(drawIndex));
+		// a caster leaving or entering a light volume changes its shadow
+		if (m_renderList[drawIndex].bTransparent == false)
+		{
+			m_pShadowAtlas->InvalidateBox(m_sceneTransforms.GetPreviousDrawBounds(drawIndex));
+			m_pShadowAtlas->InvalidateBox(m_sceneTransforms.GetDrawBounds(drawIndex));
+			m_pCascadedShadows->InvalidateBox(m_sceneTransforms.GetPreviousDrawBounds(drawIndex));
+			m_pCascadedShadows->InvalidateBox(m_sceneTransforms.GetDrawBounds(drawIndex));
+		}
+	}
+	m_sceneBVH.Refit();
+
+	m_bInstanceDataDirty = true;
+}
+
+/***********************************************************
+ *  IndexAddedDraws()
+ *
+ *  This method is used for making the draws added since
+ *  BuildRenderList() part of the frame: the hierarchy is
+ *  built again over every box, the removed draws emptied
+ *  out of it, the shadows they fall in drawn again, and the
+ *  arrays kept per draw grown. The instance data, sized for
+ *  the draws indexed before, tells which ones are new.
+ ***********************************************************/
+void SceneManager::IndexAddedDraws()
+{
+	m_bDrawsAdded = false;
+
+	m_sceneBVH.Build(m_sceneTransforms.GetAllDrawBounds());
+	for (size_t i = 0; i < m_drawRemoved.size(); i++)
+	{
+		if (m_drawRemoved[i] != 0)
+		{
+			m_sceneBVH.SetObjectBounds((uint32_t)i, SceneBVH::EmptyBounds());
+		}
+	}
+	m_sceneBVH.Refit();
+
+	for (size_t i = m_instanceData.size(); i < m_renderList.size(); i++)
+	{
+		if (m_renderList[i].bTransparent == false)
+		{
+			m_pShadowAtlas->InvalidateBox(m_sceneTransforms.GetDrawBounds((uint32_t)i));
+			m_pCascadedShadows->InvalidateBox(m_sceneTransforms.GetDrawBounds((uint32_t)i));
+		}
+	}
+
+	// the new draws are in no query group
+	if (m_drawQueryGroups.empty() == false)
+	{
+		m_drawQueryGroups.resize(m_renderList.size(), -1);
+	}
+	m_instanceData.resize(m_renderList.size());
+	m_instanceOrder.clear();
+	if (NULL != m_pUploadRing)
+	{
+		m_pUploadRing->Reserve((GLsizeiptr)(m_renderList.size() *
+			(sizeof(INSTANCE_DATA) + sizeof(ShapeMeshes::INDIRECT_COMMAND))) + UPLOAD_RING_SLACK_BYTES);
+	}
+}
+
+/***********************************************************
+ *  GetLightingPermutation()
+ *
+ *  This method is used for getting the shader permutation
+ *  flags for the lighting state of the scene.
+ ***********************************************************/
+int SceneManager::GetLightingPermutation() const
+{
+	return((m_bUseLighting == true) ? ShaderManager::PERMUTATION_LIGHTING : 0);
+}
+
+/***********************************************************
+ *  IsDeferredShadingActive()
+ *
+ *  This method is used for checking whether the opaque
+ *  draws are written to the G-buffer this frame. Unlit
+ *  scenes have nothing to defer and stay forward.
+ ***********************************************************/
+bool SceneManager::IsDeferredShadingActive() const
+{
+	return((m_bDeferredShading == true) && (m_bUseLighting == true) &&
+		(m_pDeferredPass->IsAvailable() == true) && (m_bStereo == false));
+}
+
+/***********************************************************
+ *  IsVariableRateShadingActive()
+ *
+ *  This method is used for checking whether the deferred
+ *  lighting of this frame reads a rate image. The rates are
+ *  per pixel and measured on the main view, so multisampled
+ *  frames and the extra views shade every pixel.
+ ***********************************************************/
+bool SceneManager::IsVariableRateShadingActive() const
+{
+	return((m_bVariableRateShading == true) && (IsDeferredShadingActive() == true) &&
+		(m_pShadingRate->IsAvailable() == true) && (m_bPrimaryView == true) &&
+		(GetMultisampleCount() <= 1));
+}
+
+/***********************************************************
+ *  IsMeshShadingActive()
+ *
+ *  This method is used for checking whether the meshlet
+ *  batches are drawn by mesh shaders this frame. The depth
+ *  pre-pass draws them from the culled commands with its
+ *  own vertex shader, and only the same vertex stage in the
+ *  lit pass is certain to give the depths its GL_EQUAL test
+ *  needs, so the pre-pass turns mesh shading off.
+ ***********************************************************/
+bool SceneManager::IsMeshShadingActive() const
+{
+	return((m_bMeshShading == true) && (m_pMeshletCuller->HasMeshShading() == true) &&
+		(IsDepthPrepassActive() == false) && (m_bStereo == false));
+}
+
+/***********************************************************
+ *  IsDepthPrepassActive()
+ *
+ *  This method is used for checking whether the opaque
+ *  depth is laid down by the pre-pass this frame, which the
+ *  deferred path and the stereo views do without.
+ ***********************************************************/
+bool SceneManager::IsDepthPrepassActive() const
+{
+	return((IsDeferredShadingActive() == false) && (m_bStereo == false) &&
+		(m_bDepthPrepass == true) && (0 != m_depthPrepassProgram));
+}
+
+/***********************************************************
+ *  UpdateShadowMaps()
+ *
+ *  This method is used for giving the lights their shadows
+ *  and drawing the casters of the stale ones. Lights with
+ *  no direct light cast nothing visible and get no shadow.
+ *  A light without radius reaches as far as the farthest
+ *  corner of the scene bounds. Casters are the opaque draws
+ *  inside the light volume, drawn one by one, which is fine
+ *  since a static shadow is drawn only once. Directional
+ *  lights have no cube; the first of them with direct light
+ *  is the key light, which gets the cascades instead.
+ ***********************************************************/
+void SceneManager::UpdateShadowMaps()
+{
+	if (m_bUseLighting == false)
+	{
+		return;
+	}
+
+	SceneBVH::AABB sceneBounds;
+	sceneBounds.minXYZ = glm::vec3(0.0f);
+	sceneBounds.maxXYZ = glm::vec3(0.0f);
+	if (m_sceneBVH.GetNodes().empty() == false)
+	{
+		sceneBounds = m_sceneBVH.GetNodes()[0].bounds;
+	}
+
+	m_lightShadowSpheres.resize(m_lights.size());
+	for (size_t i = 0; i < m_lights.size(); i++)
+	{
+		const LIGHT_SOURCE& light = m_lights[i];
+		float reach = light.radius;
+		if (reach <= 0.0f)
+		{
+			glm::vec3 farthest = glm::max(glm::abs(sceneBounds.minXYZ - light.position),
+				glm::abs(sceneBounds.maxXYZ - light.position));
+			reach = glm::length(farthest) * 1.01f;
+		}
+		if ((GetLightType(light) == LIGHT_TYPE_AMBIENT) || (light.radius < 0.0f))
+		{
+			reach = 0.0f;
+		}
+		m_lightShadowSpheres[i] = glm::vec4(light.position, reach);
+	}
+
+	m_pShadowAtlas->SetLights(m_lightShadowSpheres, m_lightShadowIndexes);
+	int keyLight = -1;
+	if (m_pCascadedShadows->IsAvailable() == true)
+	{
+		for (size_t i = 0; (i < m_lights.size()) && (keyLight < 0); i++)
+		{
+			if ((m_lights[i].radius < 0.0f) && (GetLightType(m_lights[i]) != LIGHT_TYPE_AMBIENT) &&
+				(glm::dot(m_lights[i].position, m_lights[i].position) > 0.0f))
+			{
+				keyLight = (int)i;
+				m_lightShadowIndexes[i] = 0;
+			}
+		}
+	}
+	for (size_t i = 0; i < m_lights.size(); i++)
+	{
+		if (m_lights[i].shadowIndex != m_lightShadowIndexes[i])
+		{
+			m_lights[i].shadowIndex = m_lightShadowIndexes[i];
+			m_bLightsDirty = true;
+		}
+	}
+
+	UpdateCascadedShadows(keyLight, sceneBounds);
+
+	// stale shadows keep their cubes until the quality is back on
+	if ((m_pShadowAtlas->IsAvailable() == true) &&
+		(m_pShadowAtlas->GetQuality() != ShadowAtlas::SHADOW_QUALITY_OFF) &&
+		(m_pShadowAtlas->HasDirtyShadows() == true))
+	{
+		m_pShadowAtlas->BeginShadowPass();
+		for (int shadowIndex = 0; shadowIndex < m_pShadowAtlas->GetShadowCapacity(); shadowIndex++)
+		{
+			if (m_pShadowAtlas->IsShadowDirty(shadowIndex) == false)
+			{
+				continue;
+			}
+
+			m_shadowCasters.clear();
+			m_sceneBVH.QueryBox(m_pShadowAtlas->GetShadowVolume(shadowIndex), m_shadowCasters);
+			for (int pass = 0; pass < m_pShadowAtlas->GetPassCount(); pass++)
+			{
+				m_pShadowAtlas->BeginShadow(shadowIndex, pass);
+				for (size_t i = 0; i < m_shadowCasters.size(); i++)
+				{
+					const DRAW_RECORD& drawRecord = m_renderList[m_shadowCasters[i]];
+					// cached shadows outlive the camera, so they are
+					// drawn at the finest level whatever the view is
+					if (drawRecord.bTransparent == false)
+					{
+						m_pShadowAtlas->DrawCaster(m_sceneTransforms.GetDrawModel(m_shadowCasters[i]),
+							m_meshRanges[drawRecord.lodRangeIDs[0]], m_sceneTransforms.GetDrawBounds(m_shadowCasters[i]));
+					}
+				}
+			}
+		}
+		m_pShadowAtlas->EndShadowPass();
+	}
+
+	m_pShadowAtlas->Upload();
+}
+
+/***********************************************************
+ *  UpdateCascadedShadows()
+ *
+ *  This method is used for fitting the cascades of the key
+ *  light to the main view and drawing their casters when a
+ *  cascade moved or a caster in one did. Casters are the
+ *  opaque draws inside the box around every cascade, each
+ *  drawn once for all the cascades where they are layered.
+ ***********************************************************/
+void SceneManager::UpdateCascadedShadows(int keyLight, const SceneBVH::AABB& sceneBounds)
+{
+	if (m_pCascadedShadows->IsAvailable() == false)
+	{
+		return;
+	}
+	if (keyLight < 0)
+	{
+		m_pCascadedShadows->ClearLight();
+		m_pCascadedShadows->Upload();
+		return;
+	}
+
+	m_pCascadedShadows->Update(m_viewMatrix, m_projectionMatrix, m_lights[keyLight].position, sceneBounds);
+	// stale cascades stay as they are until the quality is back on
+	if ((m_pShadowAtlas->GetQuality() != ShadowAtlas::SHADOW_QUALITY_OFF) &&
+		(m_pCascadedShadows->IsDirty() == true))
+	{
+		m_shadowCasters.clear();
+		m_sceneBVH.QueryBox(m_pCascadedShadows->GetCasterVolume(), m_shadowCasters);
+		m_pCascadedShadows->BeginShadowPass();
+		for (int pass = 0; pass < m_pCascadedShadows->GetPassCount(); pass++)
+		{
+			m_pCascadedShadows->BeginCascadePass(pass);
+			for (size_t i = 0; i < m_shadowCasters.size(); i++)
+			{
+				const DRAW_RECORD& drawRecord = m_renderList[m_shadowCasters[i]];
+				if (drawRecord.bTransparent == false)
+				{
+					m_pCascadedShadows->DrawCaster(m_sceneTransforms.GetDrawModel(m_shadowCasters[i]),
+						m_meshRanges[drawRecord.lodRangeIDs[0]]);
+				}
+			}
+		}
+		m_pCascadedShadows->EndShadowPass();
+	}
+
+	m_pCascadedShadows->Upload();
+}
+
+/***********************************************************
+ *  CollectImpostorGroups()
+ *
+ *  This method is used for grouping the movable draws of the
+ *  render list by the root scene node they hang from. Each
+ *  group of several parts is a composite object, and the
+ *  objects of the same shape, the same prefab or node tag
+ *  with the same part count, share a layer of the impostor
+ *  atlas, captured from the first of them. The static draws
+ *  are baked into merged geometry, so they have no impostor.
+ ***********************************************************/
+void SceneManager::CollectImpostorGroups()
+{
+	m_impostorShapes.clear();
+	m_impostorGroups.clear();
+	m_impostorInstances.clear();
+	m_impostorStats.shapesCaptured = 0;
+	if (m_pImpostorAtlas->IsAvailable() == false)
+	{
+		return;
+	}
+
+	std::vector<int> nodeGroups(m_sceneTransforms.GetNodeCount(), -1);
+	for (size_t i = 0; i < m_renderList.size(); i++)
+	{
+		const DRAW_RECORD& drawRecord = m_renderList[i];
+		if ((drawRecord.nodeID < 0) || (drawRecord.bStatic == true))
+		{
+			continue;
+		}
+
+		int rootNode = drawRecord.nodeID;
+		while (m_sceneTransforms.GetNodeParent(rootNode) >= 0)
+		{
+			rootNode = m_sceneTransforms.GetNodeParent(rootNode);
+		}
+		if (nodeGroups[rootNode] < 0)
+		{
+			IMPOSTOR_GROUP group;
+			group.rootNode = rootNode;
+			group.shape = -1;
+			nodeGroups[rootNode] = (int)m_impostorGroups.size();
+			m_impostorGroups.push_back(group);
+		}
+		m_impostorGroups[nodeGroups[rootNode]].draws.push_back((uint32_t)i);
+	}
+
+	// keep the composite objects whose shape found a layer
+	size_t keptGroups = 0;
+	std::vector<glm::vec4> partSpheres;
+	for (size_t g = 0; g < m_impostorGroups.size(); g++)
+	{
+		IMPOSTOR_GROUP& group = m_impostorGroups[g];
+		std::string tag = m_sceneTransforms.GetNodeTag(group.rootNode);
+		if (((size_t)group.rootNode < m_nodeShapeTags.size()) && (m_nodeShapeTags[group.rootNode].empty() == false))
+		{
+			tag = m_nodeShapeTags[group.rootNode];
+		}
+		if ((group.draws.size() < IMPOSTOR_MIN_PARTS) || (tag.empty() == true))
+		{
+			continue;
+		}
+
+		std::string key = tag + "/" + std::to_string(group.draws.size());
+		for (size_t s = 0; (s < m_impostorShapes.size()) && (group.shape < 0); s++)
+		{
+			if (m_impostorShapes[s].key == key)
+			{
+				group.shape = (int)s;
+			}
+		}
+		if ((group.shape < 0) && ((int)m_impostorShapes.size() < ImpostorAtlas::MAX_IMPOSTORS))
+		{
+			// the sphere around the parts, in the space of the root node
+			glm::mat4 toRoot = glm::inverse(m_sceneTransforms.GetNodeWorld(group.rootNode));
+			glm::vec3 minXYZ(FLT_MAX);
+			glm::vec3 maxXYZ(-FLT_MAX);
+			partSpheres.clear();
+			for (size_t i = 0; i < group.draws.size(); i++)
+			{
+				const ShapeMeshes::BOUNDS& bounds = m_meshRanges[m_renderList[group.draws[i]].lodRangeIDs[0]].bounds;
+				glm::mat4 partModel = toRoot * m_sceneTransforms.GetDrawModel(group.draws[i]);
+				glm::vec3 center = glm::vec3(partModel * glm::vec4(bounds.center, 1.0f));
+				float radius = bounds.radius * GetMaxAxisScale(partModel);
+				minXYZ = glm::min(minXYZ, center - glm::vec3(radius));
+				maxXYZ = glm::max(maxXYZ, center + glm::vec3(radius));
+				partSpheres.push_back(glm::vec4(center, radius));
+			}
+
+			IMPOSTOR_SHAPE shape;
+			shape.key = key;
+			shape.group = (int)keptGroups;
+			shape.center = (minXYZ + maxXYZ) * 0.5f;
+			shape.radius = 0.0f;
+			for (size_t i = 0; i < partSpheres.size(); i++)
+			{
+				shape.radius = glm::max(shape.radius,
+					glm::length(glm::vec3(partSpheres[i]) - shape.center) + partSpheres[i].w);
+			}
+			shape.bCaptured = false;
+			group.shape = (int)m_impostorShapes.size();
+			m_impostorShapes.push_back(shape);
+		}
+		if (group.shape < 0)
+		{
+			continue;
+		}
+
+		if (keptGroups != g)
+		{
+			m_impostorGroups[keptGroups] = group;
+		}
+		keptGroups++;
+	}
+	m_impostorGroups.resize(keptGroups);
+}
+
+/***********************************************************
+ *  CollectQueryGroups()
+ *
+ *  This method is used for grouping the movable opaque draws
+ *  of the new render list by the root scene node they hang
+ *  from, like the impostors, and keeping the objects worth
+ *  an occlusion query: several parts, such as the jar, or
+ *  many vertices, such as an imported model. The static
+ *  draws are baked into merged geometry, and the blended
+ *  parts are drawn in a pass of their own, so neither is
+ *  queried.
+ ***********************************************************/
+void SceneManager::CollectQueryGroups()
+{
+	m_queryGroups.clear();
+	m_drawQueryGroups.clear();
+	if ((m_bOcclusionQueries == false) || (m_pOcclusionQueries->IsAvailable() == false))
+	{
+		return;
+	}
+
+	std::vector<int> nodeGroups(m_sceneTransforms.GetNodeCount(), -1);
+	std::vector<GLsizei> groupVertices;
+	for (size_t i = 0; i < m_renderList.size(); i++)
+	{
+		const DRAW_RECORD& drawRecord = m_renderList[i];
+		if ((drawRecord.nodeID < 0) || (drawRecord.bStatic == true) || (drawRecord.bTransparent == true))
+		{
+			continue;
+		}
+
+		int rootNode = drawRecord.nodeID;
+		while (m_sceneTransforms.GetNodeParent(rootNode) >= 0)
+		{
+			rootNode = m_sceneTransforms.GetNodeParent(rootNode);
+		}
+		if (nodeGroups[rootNode] < 0)
+		{
+			nodeGroups[rootNode] = (int)m_queryGroups.size();
+			m_queryGroups.push_back(std::vector<uint32_t>());
+			groupVertices.push_back(0);
+		}
+		m_queryGroups[nodeGroups[rootNode]].push_back((uint32_t)i);
+		groupVertices[nodeGroups[rootNode]] += m_meshRanges[drawRecord.lodRangeIDs[0]].count;
+	}
+
+	// keep the expensive objects, as many as there are queries
+	size_t keptGroups = 0;
+	for (size_t g = 0; (g < m_queryGroups.size()) && ((int)keptGroups < OcclusionQueries::MAX_BOXES); g++)
+	{
+		if ((m_queryGroups[g].size() >= OCCLUSION_QUERY_MIN_PARTS) ||
+			(groupVertices[g] >= OCCLUSION_QUERY_MIN_VERTICES))
+		{
+			m_queryGroups[keptGroups].swap(m_queryGroups[g]);
+			keptGroups++;
+		}
+	}
+	m_queryGroups.resize(keptGroups);
+
+	m_drawQueryGroups.assign(m_renderList.size(), -1);
+	for (size_t g = 0; g < m_queryGroups.size(); g++)
+	{
+		for (size_t i = 0; i < m_queryGroups[g].size(); i++)
+		{
+			m_drawQueryGroups[m_queryGroups[g][i]] = (int)g;
+		}
+	}
+	m_groupQueryBoxes.assign(m_queryGroups.size(), -1);
+}
+
+/***********************************************************
+ *  UpdateQueryBoxes()
+ *
+ *  This method is used for giving every query group with a
+ *  part in the view the box around its visible parts. The
+ *  groups keep their place in the batches either way, so a
+ *  group without a box only draws without the condition.
+ ***********************************************************/
+void SceneManager::UpdateQueryBoxes()
+{
+	m_queryBoxes.clear();
+	m_groupQueryBoxes.assign(m_queryGroups.size(), -1);
+	if (IsOcclusionQueryActive() == false)
+	{
+		m_pOcclusionQueries->SetBoxes(m_queryBoxes);
+		return;
+	}
+
+	for (size_t g = 0; g < m_queryGroups.size(); g++)
+	{
+		const std::vector<uint32_t>& draws = m_queryGroups[g];
+		glm::vec3 minXYZ(FLT_MAX);
+		glm::vec3 maxXYZ(-FLT_MAX);
+		bool bVisible = false;
+		for (size_t i = 0; i < draws.size(); i++)
+		{
+			if (m_drawVisible[draws[i]] != 0)
+			{
+				const SceneBVH::AABB& bounds = m_sceneTransforms.GetDrawBounds(draws[i]);
+				minXYZ = glm::min(minXYZ, bounds.minXYZ);
+				maxXYZ = glm::max(maxXYZ, bounds.maxXYZ);
+				bVisible = true;
+			}
+		}
+		if (bVisible == false)
+		{
+			continue;
+		}
+
+		// the near plane may cut into a box around the camera, which
+		// would hide an object in plain view
+		if ((glm::all(glm::greaterThan(m_viewPosition, minXYZ - glm::vec3(OCCLUSION_QUERY_MARGIN))) == true) &&
+			(glm::all(glm::lessThan(m_viewPosition, maxXYZ + glm::vec3(OCCLUSION_QUERY_MARGIN))) == true))
+		{
+			m_pOcclusionQueries->CountInsideBox();
+			continue;
+		}
+
+		OcclusionQueries::QUERY_BOX box;
+		box.minXYZ = glm::vec4(minXYZ, 0.0f);
+		box.maxXYZ = glm::vec4(maxXYZ, 0.0f);
+		m_groupQueryBoxes[g] = (int)m_queryBoxes.size();
+		m_queryBoxes.push_back(box);
+	}
+	m_pOcclusionQueries->SetBoxes(m_queryBoxes);
+}
+
+/***********************************************************
+ *  UpdateImpostors()
+ *
+ *  This method is used for capturing the views of the first
+ *  shape not in the atlas yet, from the finest LOD level of
+ *  its parts. Only one shape is captured a frame, and only
+ *  once the scene has loaded, so the views hold the final
+ *  textures.
+ ***********************************************************/
+void SceneManager::UpdateImpostors()
+{
+	if ((m_pImpostorAtlas->IsAvailable() == false) || (m_impostorPixels <= 0.0f) || (IsLoading() == true))
+	{
+		return;
+	}
+
+	for (size_t s = 0; s < m_impostorShapes.size(); s++)
+	{
+		IMPOSTOR_SHAPE& shape = m_impostorShapes[s];
+		if (shape.bCaptured == true)
+		{
+			continue;
+		}
+
+		const IMPOSTOR_GROUP& group = m_impostorGroups[shape.group];
+		glm::mat4 toRoot = glm::inverse(m_sceneTransforms.GetNodeWorld(group.rootNode));
+		m_pTextureTable->Bind();
+		m_pImpostorAtlas->BeginCapture((int)s, shape.center, shape.radius);
+		for (int view = 0; view < ImpostorAtlas::VIEW_COUNT; view++)
+		{
+			m_pImpostorAtlas->BeginView(view);
+			// the blended parts go over the opaque ones
+			for (int pass = 0; pass < 2; pass++)
+			{
+				for (size_t i = 0; i < group.draws.size(); i++)
+				{
+					const DRAW_RECORD& drawRecord = m_renderList[group.draws[i]];
+					if (drawRecord.bTransparent != (pass == 1))
+					{
+						continue;
+					}
+					m_pImpostorAtlas->DrawPart(toRoot * m_sceneTransforms.GetDrawModel(group.draws[i]),
+						m_meshRanges[drawRecord.lodRangeIDs[0]], drawRecord.color, drawRecord.UVscale,
+						drawRecord.materialID, drawRecord.textureSlot, drawRecord.bTransparent);
+				}
+			}
+		}
+		m_pImpostorAtlas->EndCapture();
+
+		shape.bCaptured = true;
+		m_impostorStats.shapesCaptured++;
+		break;
+	}
+}
+
+/***********************************************************
+ *  IsReflectiveDraw()
+ *
+ *  This method is used for finding whether the material of
+ *  a draw reflects the probes.
+ ***********************************************************/
+bool SceneManager::IsReflectiveDraw(const DRAW_RECORD& drawRecord) const
+{
+	if ((drawRecord.materialID < 0) || (drawRecord.materialID >= (int)m_objectMaterials.size()))
+	{
+		return(false);
+	}
+	return(m_objectMaterials[drawRecord.materialID].reflectivity > 0.0f);
+}
+
+/***********************************************************
+ *  PlaceReflectionProbes()
+ *
+ *  This method is used for placing the reflection probes
+ *  of a new render list. The boxes of the reflective draws
+ *  are gathered into clusters, a draw joining the nearest
+ *  cluster within PROBE_MERGE_DISTANCE, or the nearest one
+ *  at all once every probe is taken, and each cluster gets
+ *  a probe at its center reaching a little past its
+ *  corners. Probes that did not move keep their capture.
+ ***********************************************************/
+void SceneManager::PlaceReflectionProbes()
+{
+	if (m_pReflectionProbes->IsAvailable() == false)
+	{
+		return;
+	}
+
+	std::vector<SceneBVH::AABB> clusters;
+	for (size_t i = 0; i < m_renderList.size(); i++)
+	{
+		if (IsReflectiveDraw(m_renderList[i]) == false)
+		{
+			continue;
+		}
+
+		const SceneBVH::AABB& bounds = m_sceneTransforms.GetDrawBounds(i);
+		int nearest = -1;
+		float nearestGap = FLT_MAX;
+		for (size_t c = 0; c < clusters.size(); c++)
+		{
+			glm::vec3 gap = glm::max(glm::max(clusters[c].minXYZ - bounds.maxXYZ, bounds.minXYZ - clusters[c].maxXYZ),
+				glm::vec3(0.0f));
+			if (glm::length(gap) < nearestGap)
+			{
+				nearestGap = glm::length(gap);
+				nearest = (int)c;
+			}
+		}
+
+		if ((nearest >= 0) &&
+			((nearestGap <= PROBE_MERGE_DISTANCE) || ((int)clusters.size() >= ReflectionProbes::MAX_PROBES)))
+		{
+			clusters[nearest].minXYZ = glm::min(clusters[nearest].minXYZ, bounds.minXYZ);
+			clusters[nearest].maxXYZ = glm::max(clusters[nearest].maxXYZ, bounds.maxXYZ);
+		}
+		else
+		{
+			clusters.push_back(bounds);
+		}
+	}
+
+	std::vector<glm::vec4> probeSpheres(clusters.size());
+	for (size_t c = 0; c < clusters.size(); c++)
+	{
+		glm::vec3 center = (clusters[c].minXYZ + clusters[c].maxXYZ) * 0.5f;
+		float reach = (glm::length(clusters[c].maxXYZ - clusters[c].minXYZ) * 0.5f) + PROBE_REACH_MARGIN;
+		probeSpheres[c] = glm::vec4(center, reach);
+	}
+	m_pReflectionProbes->SetProbes(probeSpheres);
+}
+
+/***********************************************************
+ *  UpdateReflectionProbes()
+ *
+ *  This method is used for drawing the next face of a probe
+ *  waiting for its capture, and uploading the probes. The
+ *  face is drawn like an extra view, shaded forward with
+ *  the reflective draws hidden, from the camera of the
+ *  face; the camera of the frame is set back after. Only
+ *  one face is drawn a frame, and only once the scene has
+ *  loaded, so the probes hold the final textures.
+ ***********************************************************/
+void SceneManager::UpdateReflectionProbes()
+{
+	// a stereo frame draws into both layers of its target, which
+	// the capture cube does not have
+	if ((m_pReflectionProbes->HasPendingCapture() == false) || (IsLoading() == true) ||
+		(m_bHasViewProjection == false) || (m_bStereo == true))
+	{
+		m_pReflectionProbes->Upload();
+		return;
+	}
+
+	PROFILE_SCOPE("UpdateReflectionProbes");
+	GLDebugGroup captureGroup("reflection probe");
+	glm::mat4 frameView = m_viewMatrix;
+	glm::mat4 frameProjection = m_projectionMatrix;
+	glm::vec3 framePosition = m_viewPosition;
+	glm::mat4 faceView;
+	glm::mat4 faceProjection;
+	glm::vec3 facePosition;
+	m_pReflectionProbes->BeginCapture(m_bReverseZ, faceView, faceProjection, facePosition);
+	SetViewPosition(facePosition);
+	SetViewMatrices(faceView, faceProjection);
+
+	bool bDeferredShading = m_bDeferredShading;
+	bool bOrderIndependentTransparency = m_bOrderIndependentTransparency;
+	m_bDeferredShading = false;
+	m_bOrderIndependentTransparency = false;
+	m_bCapturingProbe = true;
+
+	BuildView(false);
+	SubmitRenderList();
+
+	m_bCapturingProbe = false;
+	m_bDeferredShading = bDeferredShading;
+	m_bOrderIndependentTransparency = bOrderIndependentTransparency;
+	m_bPrimaryView = true;
+	m_pReflectionProbes->EndCapture();
+	SetViewPosition(framePosition);
+	SetViewMatrices(frameView, frameProjection);
+	m_pReflectionProbes->Upload();
+}
+
+/***********************************************************
+ *  SelectImpostors()
+ *
+ *  This method is used for listing the impostors of the view
+ *  being built. A composite object with a part in the view
+ *  gets its impostor once the sphere of its parts is below
+ *  the fade band on screen; the impostor dithers in over
+ *  the parts through the band, and the parts are hidden once
+ *  it takes every pixel. Stereo frames keep the parts, as
+ *  the impostor shaders draw one eye.
+ ***********************************************************/
+void SceneManager::SelectImpostors()
+{
+	m_impostorInstances.clear();
+	if ((m_impostorPixels <= 0.0f) || (m_bStereo == true) || (m_bHasViewProjection == false))
+	{
+		return;
+	}
+
+	const float pixelScale = GetPixelScale();
+	const float fadePixels = m_impostorPixels * (1.0f + IMPOSTOR_FADE_BAND);
+	for (size_t g = 0; g < m_impostorGroups.size(); g++)
+	{
+		const IMPOSTOR_GROUP& group = m_impostorGroups[g];
+		const IMPOSTOR_SHAPE& shape = m_impostorShapes[group.shape];
+		if ((shape.bCaptured == false) || (m_impostorInstances.size() >= (size_t)ImpostorAtlas::MAX_INSTANCES))
+		{
+			continue;
+		}
+
+		bool bVisible = false;
+		for (size_t i = 0; (i < group.draws.size()) && (bVisible == false); i++)
+		{
+			bVisible = (m_drawVisible[group.draws[i]] != 0);
+		}
+		if (bVisible == false)
+		{
+			continue;
+		}
+
+		// same projected diameter as ProjectDrawPixels()
+		glm::mat4 rootWorld = m_sceneTransforms.GetNodeWorld(group.rootNode);
+		glm::vec3 center = glm::vec3(rootWorld * glm::vec4(shape.center, 1.0f));
+		float radius = shape.radius * GetMaxAxisScale(rootWorld);
+		float pixels = 2.0f * radius * pixelScale;
+		if (m_projectionMatrix[3][3] == 0.0f)
+		{
+			float distance = glm::length(center - m_viewPosition);
+			pixels = (distance > radius) ? (pixels / distance) : FLT_MAX;
+		}
+		if (pixels >= fadePixels)
+		{
+			continue;
+		}
+
+		ImpostorAtlas::IMPOSTOR_INSTANCE instance;
+		instance.centerRadius = glm::vec4(center, shape.radius);
+		instance.axisX = glm::vec4(glm::vec3(rootWorld[0]), (float)group.shape);
+		instance.axisY = glm::vec4(glm::vec3(rootWorld[1]),
+			glm::clamp((fadePixels - pixels) / (fadePixels - m_impostorPixels), 0.0f, 1.0f));
+		instance.axisZ = glm::vec4(glm::vec3(rootWorld[2]), 0.0f);
+		m_impostorInstances.push_back(instance);
+		if (m_bPrimaryView == true)
+		{
+			m_impostorStats.impostorsDrawn++;
+		}
+
+		if (pixels > m_impostorPixels)
+		{
+			continue;
+		}
+		for (size_t i = 0; i < group.draws.size(); i++)
+		{
+			if (m_drawVisible[group.draws[i]] != 0)
+			{
+				m_drawVisible[group.draws[i]] = 0;
+				if (m_bPrimaryView == true)
+				{
+					m_impostorStats.drawsReplaced++;
+				}
+			}
+		}
+	}
+}
+
+/***********************************************************
+ *  AddImpostorPass()
+ *
+ *  This method is used for adding the pass drawing the
+ *  impostors of the view over the opaque draws, with depth
+ *  writes on and the depth test of the frame, whatever the
+ *  pre-pass left set.
+ ***********************************************************/
+void SceneManager::AddImpostorPass(const SCENE_TARGET& target)
+{
+	if (m_impostorInstances.empty() == true)
+	{
+		return;
+	}
+
+	int impostorPass = m_pRenderGraph->AddPass("impostors", [this]()
+		{
+			ApplyPassState(m_states.depthWrite, m_states.blendAlpha);
+			m_pImpostorAtlas->Draw(m_impostorInstances, m_bUseLighting);
+			// the fading impostors blend and leave the depth as is
+			m_pRenderStates->Invalidate();
+		});
+	WriteSceneTarget(impostorPass, target);
+}
+
+/***********************************************************
+ *  AddParticlePass()
+ *
+ *  This method is used for adding the pass drawing the
+ *  particles over everything else the view draws, depth
+ *  tested against it without writing it. The main view
+ *  moves them to the time of the clips first and sorts
+ *  them along its own view; the extra views of the frame
+ *  draw them as they are.
+ ***********************************************************/
+void SceneManager::AddParticlePass(const SCENE_TARGET& target)
+{
+	if (m_pParticleSystem->IsAvailable() == false)
+	{
+		return;
+	}
+
+	const bool bUpdate = m_bPrimaryView;
+	int particlePass = m_pRenderGraph->AddPass("particles", [this, bUpdate]()
+		{
+			if (bUpdate == true)
+			{
+				m_pParticleSystem->Update(m_animationTime, m_sceneTransforms);
+			}
+			ApplyPassState(m_states.depthRead, m_states.blendAlpha);
+			m_pParticleSystem->Draw();
+			// the particles blend with factors of their own
+			m_pRenderStates->Invalidate();
+		});
+	WriteSceneTarget(particlePass, target);
+}
+
+/***********************************************************
+ *  SetShaderColor()
+ *
+ *  This method is used for setting the passed in color
+ *  into the shader for the next draw command
+ ***********************************************************/
+void SceneManager::SetShaderColor(
+	float redColorValue,
+	float greenColorValue,
+	float blueColorValue,
+	float alphaValue)
+{
+	// variables for this method
+	glm::vec4 currentColor;
+
+	currentColor.r = redColorValue;
+	currentColor.g = greenColorValue;
+	currentColor.b = blueColorValue;
+	currentColor.a = alphaValue;
+
+	if (m_bRecording == true)
+	{
+		m_recordState.color = currentColor;
+		m_recordState.textureSlot = -1;
+	}
+	else if (NULL != m_pShaderManager)
+	{
+		// draw with the untextured program
+		m_pShaderManager->UsePermutation(GetLightingPermutation());
+		m_pShaderManager->setUniform(m_uniforms.objectColor, currentColor);
+	}
+}
+
+/***********************************************************
+ *  SetShaderTexture()
+ *
+ *  This method is used for setting the texture data
+ *  associated with the passed in handle into the shader.
+ ***********************************************************/
+void SceneManager::SetShaderTexture(
+	TextureHandle texture)
+{
+	int textureSlot = m_textureTags.Resolve(texture);
+
+	if (m_bRecording == true)
+	{
+		m_recordState.textureSlot = textureSlot;
+	}
+	else if (NULL != m_pShaderManager)
+	{
+		// draw with the textured program
+		m_pShaderManager->UsePermutation(
+			GetLightingPermutation() | ShaderManager::PERMUTATION_TEXTURE);
+
+		m_pTextureTable->Bind();
+		m_pShaderManager->setUniform(m_uniforms.textureArray, (int)TextureTable::TEXTURE_ARRAY_UNIT);
+		m_pShaderManager->setUniform(m_uniforms.textureIndex, textureSlot);
+	}
+}
+
+/***********************************************************
+ *  SetShaderTexture()
+ *
+ *  This method is used for setting the texture data
+ *  associated with the passed in tag into the shader.
+ ***********************************************************/
+void SceneManager::SetShaderTexture(
+	const std::string& textureTag)
+{
+	SetShaderTexture(m_textureTags.Find(textureTag));
+}
+
+/***********************************************************
+ *  SetTextureUVScale()
+ *
+ *  This method is used for setting the texture UV scale
+ *  values into the shader.
+ ***********************************************************/
+void SceneManager::SetTextureUVScale(float u, float v)
+{
+	if (m_bRecording == true)
+	{
+		m_recordState.UVscale = glm::vec2(u, v);
+	}
+	else if (NULL != m_pShaderManager)
+	{
+		m_pShaderManager->setUniform(m_uniforms.UVscale, glm::vec2(u, v));
+	}
+}
+
+/***********************************************************
+ *  SetShaderMaterial()
+ *
+ *  This method is used for selecting the material that is
+ *  associated with the passed in handle in the shader.
+ ***********************************************************/
+void SceneManager::SetShaderMaterial(
+	MaterialHandle material)
+{
+	SelectMaterialID(m_materialTags.Resolve(material));
+}
+
+/***********************************************************
+ *  SetShaderMaterial()
+ *
+ *  This method is used for selecting the material that is
+ *  associated with the passed in tag in the shader. An
+ *  unknown tag is reported once by the tag registry.
+ ***********************************************************/
+void SceneManager::SetShaderMaterial(
+	const std::string& materialTag)
+{
+	SetShaderMaterial(m_materialTags.Find(materialTag));
+}
+
+/***********************************************************
+ *  SelectMaterialID()
+ *
+ *  This method is used for selecting a material uploaded by
+ *  UploadMaterials() by its ID from FindMaterialID().
+ ***********************************************************/
+void SceneManager::SelectMaterialID(
+	int materialID)
+{
+	if ((materialID < 0) || (materialID >= (int)m_objectMaterials.size()) ||
+		(materialID >= MAX_MATERIALS))
+	{
+		return;
+	}
+
+	if (m_bRecording == true)
+	{
+		m_recordState.materialID = materialID;
+	}
+	else if (NULL != m_pShaderManager)
+	{
+		m_pShaderManager->setUniform(m_uniforms.materialIndex, materialID);
+	}
+}
+
+/*******************************************************************/
+/*** STUDENTS CAN MODIFY the code in the methods BELOW for       ***/
+/*** preparing and rendering their own 3D replicated scenes.     ***/
+/*** Please refer to the code in the OpenGL sample project       ***/
+/*** for assistance.                                             ***/
+/********************************************************************/
+
+/***********************************************************
+*  LoadSceneTextures() 
+* 
+*  This method is used for preparing the 3D scene by loading 
+*  the shapes, textures in memory to support the 3D scene 
+*  rendering 
+***********************************************************/ 
+void SceneManager::LoadSceneTextures() 
+{
+	// load each texture into memory with CreateGLTextures(), which
+	// decodes the image files in parallel
+	const TEXTURE_FILE textureFiles[] =
+	{
+		{ "../../Utilities/textures/tile.jpg", "backdrop" }, // Used for backdrop wall
+		{ "../../Utilities/textures/counter.jpg", "counter" }, // Used for counter surface
+		{ "../../Utilities/textures/knife_handle.jpg", "wood" }, // Used for knife handle and backdrop ledge
+		{ "../../Utilities/textures/metal.jpg", "metal" }, // Used for knife and cup metal
+		{ "../../Utilities/textures/marble.jpg", "marble" }, // Used for coaster
+		{ "../../Utilities/textures/drywall.jpg", "plastic" }, // Used for cutting board
+		{ "../../Utilities/textures/cucumber_outer.jpeg", "cucumber_outer" }, // Used for cucumber sides
+		{ "../../Utilities/textures/cucumber_inner.jpg", "cucumber_inner" }, // Used for cucumber interior
+		{ "../../Utilities/textures/glass10.png", "glass10" }, // Used for glass jar
+		{ "../../Utilities/textures/glass13.png", "glass13" }
+	};
+	CreateGLTextures(std::vector<TEXTURE_FILE>(textureFiles, textureFiles + sizeof(textureFiles) / sizeof(textureFiles[0])));
+
+	// bind loaded textures to texture slots
+	BindGLTextures();
+}
+
+/***********************************************************
+*  DefineObjectMaterials()
+*
+*  This method configures various types of materials which
+*  can be set for each object with SetShaderMaterial(tag).
+***********************************************************/
+void SceneManager::DefineObjectMaterials()
+{
+	/*Create glass material(used for complex glass jar)*/
+	OBJECT_MATERIAL glassMaterial;
+	// set attributes
+	glassMaterial.ambientColor = glm::vec3(0.4f, 0.4f, 0.4f);
+	glassMaterial.ambientStrength = 0.15f;
+	glassMaterial.diffuseColor = glm::vec3(0.32f, 0.32f, 0.3f);
+	glassMaterial.specularColor = glm::vec3(0.6f, 0.6f, 0.6f);
+	glassMaterial.shininess = 75.0f;
+	glassMaterial.reflectivity = 0.15f;
+	glassMaterial.tag = "glass"; // used to identify material
+	glassMaterial.bTransparent = true;
+	glassMaterial.bCoarseShading = false;
+	// load "glass" as a material
+	m_objectMaterials.push_back(glassMaterial);
+
+	/* Create wood material (used for wood countertop/knife handle) */
+	OBJECT_MATERIAL woodMaterial;
+	// set attributes
+	woodMaterial.ambientColor = glm::vec3(0.25f, 0.22f, 0.2f);
+	woodMaterial.ambientStrength = 0.2f;
+	woodMaterial.diffuseColor = glm::vec3(0.25f, 0.2f, 0.15f);
+	woodMaterial.specularColor = glm::vec3(0.2f, 0.2f, 0.2f);
+	woodMaterial.shininess = 5.0f;
+	woodMaterial.reflectivity = 0.0f;
+	woodMaterial.tag = "wood"; // used to identify material
+	woodMaterial.bTransparent = false;
+	woodMaterial.bCoarseShading = false;
+	// load "wood" as a material
+	m_objectMaterials.push_back(woodMaterial);
+
+	/*Create plastic material(used for cup and cutting board)*/
+	OBJECT_MATERIAL plasticMaterial;
+	// set attributes
+	plasticMaterial.ambientColor = glm::vec3(0.2f, 0.2f, 0.23f);
+	plasticMaterial.ambientStrength = 0.15f;
+	plasticMaterial.diffuseColor = glm::vec3(0.25f, 0.255f, 0.28f);
+	plasticMaterial.specularColor = glm::vec3(0.32f, 0.32f, 0.3f);
+	plasticMaterial.shininess = 7.0f;
+	plasticMaterial.reflectivity = 0.0f;
+	plasticMaterial.tag = "plastic"; // used to identify material
+	plasticMaterial.bTransparent = false;
+	plasticMaterial.bCoarseShading = true;
+	// load "plastic" as a material
+	m_objectMaterials.push_back(plasticMaterial);
+
+	/*Create polished stone material(used for countertop, background wall and coaster)*/
+	OBJECT_MATERIAL stoneMaterial;
+	// set attributes
+	stoneMaterial.ambientColor = glm::vec3(0.39f, 0.37f, 0.35f);
+	stoneMaterial.ambientStrength = 0.25f;
+	stoneMaterial.diffuseColor = glm::vec3(0.4f, 0.37f, 0.35f);
+	stoneMaterial.specularColor = glm::vec3(0.27f, 0.3f, 0.33f);
+	stoneMaterial.shininess = 2.0f;
+	stoneMaterial.reflectivity = 0.0f;
+	stoneMaterial.tag = "stone"; // used to identify material
+	stoneMaterial.bTransparent = false;
+	stoneMaterial.bCoarseShading = true;
+	// load "stone" as a material
+	m_objectMaterials.push_back(stoneMaterial);
+
+	/*Create metal material(used for cup lip/straw and knife )*/
+	OBJECT_MATERIAL metalMaterial;
+	// set attributes
+	metalMaterial.ambientColor = glm::vec3(0.23f, 0.23f, 0.21f);
+	metalMaterial.ambientStrength = 0.4f;
+	metalMaterial.diffuseColor = glm::vec3(0.3f, 0.3f, 0.25f);
+	metalMaterial.specularColor = glm::vec3(0.45f, 0.45f, 0.45f);
+	metalMaterial.shininess = 25.0f;
+	metalMaterial.reflectivity = 0.6f;
+	metalMaterial.tag = "metal"; // used to identify material
+	metalMaterial.bTransparent = false;
+	metalMaterial.bCoarseShading = false;
+	// load "metal" as a material
+	m_objectMaterials.push_back(metalMaterial);
+
+	/*Create organic material(used for cucumber)*/
+	OBJECT_MATERIAL organicMaterial;
+	// set attributes
+	organicMaterial.ambientColor = glm::vec3(0.25f, 0.28f, 0.25f);
+	organicMaterial.ambientStrength = 0.15f;
+	organicMaterial.diffuseColor = glm::vec3(0.3f, 0.34f, 0.3f);
+	organicMaterial.specularColor = glm::vec3(0.35f, 0.35f, 0.3f);
+	organicMaterial.shininess = 12.0f;
+	organicMaterial.reflectivity = 0.0f;
+	organicMaterial.tag = "organic"; // used to identify material
+	organicMaterial.bTransparent = false;
+	organicMaterial.bCoarseShading = false;
+	// load "organic" as a material
+	m_objectMaterials.push_back(organicMaterial);
+}
+
+/***********************************************************
+*  SetupSceneLights()
+*
+*  This method is used for setting the attributes of each
+*  custom light source in the scene (position, ambient color,
+*  diffuse color, specular color, focal strength, specular
+*  intensity).
+*  - ensure number of scene lights equals number of lights
+*    in fragment shader code.
+***********************************************************/
+void SceneManager::SetupSceneLights()
+{
+	// enable custom lighting in the scene
+	m_bUseLighting = true;
+
+	m_lights.clear();
+	m_lightLODs.clear();
+	m_bLightsDirty = true;
+
+	LIGHT_SOURCE light;
+	// the room is small enough for every light to reach all of it
+	light.radius = 0.0f;
+	light.shadowIndex = -1;	// assigned by UpdateShadowMaps()
+
+	// Set up ceiling light [0] source // light left/front of objects
+	light.position = glm::vec3(-6.7f, 5.5f, 1.0f); // position
+	light.ambientColor = glm::vec3(0.03f, 0.01f, 0.01f); // ambient light color
+	light.diffuseColor = glm::vec3(0.32f, 0.32f, 0.3f); // diffuse light color
+	light.specularColor = glm::vec3(0.4f, 0.4f, 0.39f); // specular light color
+	light.focalStrength = 45.0f; // strength of emitted focal beam
+	light.specularIntensity = 0.05f; // strength of emitted specular light
+	AddLight(light);
+
+	// Set up ceiling light [1] source // light right/front of objects
+	light.position = glm::vec3(8.0f, 6.5f, 0.5f); //  above and in front of scene
+	light.ambientColor = glm::vec3(0.03f, 0.02f, 0.01f);
+	light.diffuseColor = glm::vec3(0.3f, 0.3f, 0.3f);
+	light.specularColor = glm::vec3(0.4f, 0.4f, 0.4f);
+	light.focalStrength = 70.0f;
+	light.specularIntensity = 0.20f;
+	AddLight(light);
+
+	// Set up light source [2] // focus on ambient lighting
+	light.position = glm::vec3(0.0f, 15.0f, 0.0f);
+	light.ambientColor = glm::vec3(0.3f, 0.25f, 0.25f);
+	light.diffuseColor = glm::vec3(0.0f, 0.0f, 0.0f);
+	light.specularColor = glm::vec3(0.0f, 0.0f, 0.0f);
+	light.focalStrength = 0.01f;
+	light.specularIntensity = 0.01f;
+	AddLight(light);
+}
+
+/***********************************************************
+ *  AddLight()
+ *
+ *  This method is used for adding a light source to the
+ *  scene. Returns the index of the new light, or -1 when
+ *  all MAX_LIGHTS slots are in use.
+ ***********************************************************/
+int SceneManager::AddLight(const LIGHT_SOURCE& light)
+{
+	if ((int)m_lights.size() >= MAX_LIGHTS)
+	{
+		std::cout << "Cannot add light, all " << MAX_LIGHTS << " light slots are in use" << std::endl;
+		return(-1);
+	}
+
+	m_lights.push_back(light);
+	m_bLightsDirty = true;
+
+	return((int)m_lights.size() - 1);
+}
+
+/***********************************************************
+ *  RemoveLight()
+ *
+ *  This method is used for removing the light source at the
+ *  passed in index. Lights after it move down one index.
+ ***********************************************************/
+bool SceneManager::RemoveLight(int lightIndex)
+{
+	if ((lightIndex < 0) || (lightIndex >= (int)m_lights.size()))
+	{
+		return(false);
+	}
+
+	m_lights.erase(m_lights.begin() + lightIndex);
+	if (lightIndex < (int)m_lightLODs.size())
+	{
+		m_lightLODs.erase(m_lightLODs.begin() + lightIndex);
+	}
+	m_bLightsDirty = true;
+
+	return(true);
+}
+
+/***********************************************************
+ *  UpdateLight()
+ *
+ *  This method is used for replacing the values of the light
+ *  source at the passed in index, e.g. to animate it.
+ ***********************************************************/
+bool SceneManager::UpdateLight(int lightIndex, const LIGHT_SOURCE& light)
+{
+	if ((lightIndex < 0) || (lightIndex >= (int)m_lights.size()))
+	{
+		return(false);
+	}
+
+	m_lights[lightIndex] = light;
+	m_bLightsDirty = true;
+
+	return(true);
+}
+
+/***********************************************************
+ *  UploadLights()
+ *
+ *  This method is used for writing the light count and the
+ *  active light sources into the LightData uniform buffer
+ *  with a single upload, only when they have changed. The
+ *  type of every light is decided here, so the shaders only
+ *  run the terms it has.
+ ***********************************************************/
+void SceneManager::UploadLights()
+{
+	if ((m_bLightsDirty == false) && (m_bLightLODDirty == false))
+	{
+		return;
+	}
+
+	// the buffer is created on first use and stays attached
+	// to the LightData binding point shared by all programs
+	if (m_lightData.IsCreated() == false)
+	{
+		m_lightData.Create(GPUBuffer::USAGE_DYNAMIC, sizeof(LIGHT_DATA), NULL,
+			GPUMemory::CATEGORY_BUFFER, "light data");
+		glBindBufferBase(GL_UNIFORM_BUFFER, ShaderManager::LIGHT_DATA_BINDING, m_lightData.GetName());
+	}
+
+	LIGHT_DATA lightData;
+	lightData.lightCount = (int)m_lights.size();
+	lightData.padding[0] = lightData.padding[1] = lightData.padding[2] = 0;
+	for (size_t i = 0; i < m_lights.size(); i++)
+	{
+		lightData.lightSources[i] = GetLODLight((int)i);
+	}
+
+	// unused slots past lightCount are never read, so skip them
+	GLsizeiptr uploadSize = offsetof(LIGHT_DATA, lightSources) + m_lights.size() * sizeof(LIGHT_SOURCE);
+	m_lightData.Update(0, uploadSize, &lightData);
+
+	// the lights picked per draw are picked again
+	if (m_bObjectLights == true)
+	{
+		m_bInstanceDataDirty = true;
+	}
+	m_bLightsDirty = false;
+	m_bLightLODDirty = false;
+}
+
+/***********************************************************
+ *  UpdateLightLOD()
+ *
+ *  This method is used for estimating the share of the view
+ *  of every light that has a reach, from its brightness and
+ *  the part of the screen its sphere covers at its distance,
+ *  and moving its level a step towards the one of that
+ *  share. Lights without a reach light the whole view, and
+ *  always stay at full.
+ ***********************************************************/
+void SceneManager::UpdateLightLOD()
+{
+	if ((m_bLightLOD == false) || (m_bHasViewProjection == false))
+	{
+		// back to the lights as they are
+		if (m_lightLODs.empty() == false)
+		{
+			m_lightLODs.clear();
+			m_bLightLODDirty = true;
+		}
+		return;
+	}
+
+	const float fadeStep = 1.0f / (float)LIGHT_FADE_FRAMES;
+	// a perspective projection shrinks the sphere with its distance
+	const bool bPerspective = (m_projectionMatrix[2][3] != 0.0f);
+	LIGHT_LOD newLOD = { 0.0f, -1.0f, false, false };
+	m_lightLODs.resize(m_lights.size(), newLOD);
+	for (size_t i = 0; i < m_lights.size(); i++)
+	{
+		const LIGHT_SOURCE& light = m_lights[i];
+		LIGHT_LOD& lightLOD = m_lightLODs[i];
+		if (light.radius > 0.0f)
+		{
+			float coverage = 1.0f;
+			float distance = glm::length(light.position - m_viewPosition);
+			if ((bPerspective == false) || (distance > light.radius))
+			{
+				float projected = light.radius * m_projectionMatrix[1][1];
+				if (bPerspective == true)
+				{
+					projected /= distance;
+				}
+				coverage = glm::min(projected * projected, 1.0f);
+			}
+			glm::vec3 direct = light.diffuseColor + (light.specularColor * light.specularIntensity);
+			glm::vec3 total = direct + light.ambientColor;
+			float directShare = glm::max(direct.x, glm::max(direct.y, direct.z)) * coverage;
+			float totalShare = glm::max(total.x, glm::max(total.y, total.z)) * coverage;
+
+			if (directShare < LIGHT_FOLD_IMPORTANCE * (1.0f - LIGHT_LOD_HYSTERESIS))
+			{
+				lightLOD.bFolded = true;
+			}
+			else if (directShare > LIGHT_FOLD_IMPORTANCE * (1.0f + LIGHT_LOD_HYSTERESIS))
+			{
+				lightLOD.bFolded = false;
+			}
+			if (totalShare < LIGHT_DROP_IMPORTANCE * (1.0f - LIGHT_LOD_HYSTERESIS))
+			{
+				lightLOD.bDropped = true;
+			}
+			else if (totalShare > LIGHT_DROP_IMPORTANCE * (1.0f + LIGHT_LOD_HYSTERESIS))
+			{
+				lightLOD.bDropped = false;
+			}
+		}
+		else
+		{
+			lightLOD.bFolded = false;
+			lightLOD.bDropped = false;
+		}
+
+		float foldTarget = (lightLOD.bFolded == true) ? 1.0f : 0.0f;
+		float fadeTarget = (lightLOD.bDropped == true) ? 0.0f : 1.0f;
+		if (lightLOD.fade < 0.0f)
+		{
+			// a new light starts at its level
+			lightLOD.fold = foldTarget;
+			lightLOD.fade = fadeTarget;
+			m_bLightLODDirty = true;
+		}
+		else if ((lightLOD.fold != foldTarget) || (lightLOD.fade != fadeTarget))
+		{
+			lightLOD.fold = glm::clamp(foldTarget, lightLOD.fold - fadeStep, lightLOD.fold + fadeStep);
+			lightLOD.fade = glm::clamp(fadeTarget, lightLOD.fade - fadeStep, lightLOD.fade + fadeStep);
+			m_bLightLODDirty = true;
+		}
+	}
+}
+
+/***********************************************************
+ *  GetLODLight()
+ *
+ *  This method is used for the light source at the passed
+ *  in index as the shaders see it: the folded part of its
+ *  direct light moved into its ambient term, its fade set,
+ *  and its type decided.
+ ***********************************************************/
+SceneManager::LIGHT_SOURCE SceneManager::GetLODLight(int lightIndex) const
+{
+	LIGHT_SOURCE light = m_lights[lightIndex];
+	light.fade = 1.0f;
+	light.padding[0] = light.padding[1] = 0;
+	if (lightIndex < (int)m_lightLODs.size())
+	{
+		const LIGHT_LOD& lightLOD = m_lightLODs[lightIndex];
+		light.ambientColor += light.diffuseColor * (lightLOD.fold * LIGHT_FOLD_AMBIENT);
+		light.diffuseColor *= 1.0f - lightLOD.fold;
+		light.specularColor *= 1.0f - lightLOD.fold;
+		light.fade = glm::max(lightLOD.fade, 0.0f);
+	}
+	light.lightType = (light.fade > 0.0f) ? GetLightType(light) : LIGHT_TYPE_OFF;
+
+	return(light);
+}
+
+/***********************************************************
+ *  PrepareScene()
+ *
+ *  This method is used for preparing the 3D scene by loading
+ *  the shapes, textures in memory to support the 3D scene 
+ *  rendering
+ ***********************************************************/
+void SceneManager::PrepareScene()
+{
+	// the texture array fallback blits every texture into RGBA8
+	// layers, so only a bindless table can read compressed ones
+	if ((m_bCompressTextures == true) && (GLEW_ARB_bindless_texture == GL_TRUE) &&
+		(m_pTextureCompressor->Create(TEXTURE_COMPRESS_SHADER_PATH) == true))
+	{
+		m_pTextureResidency->SetCompressor(m_pTextureCompressor);
+	}
+
+	if (m_sceneFile.IsLoaded() == true)
+	{
+		LoadSceneFileResources();	// textures, materials and lights listed by the scene file
+	}
+	else
+	{
+		LoadSceneTextures();		  // Use custom textures for scene
+		DefineObjectMaterials(); // define the materials to create proper object lighting
+		SetupSceneLights();	   // create the lights for the scene (up to 4 lights)
+	}
+	UploadMaterials();		  // copy the materials into the material buffer once
+	
+	// only one instance of a particular mesh needs to be
+	// loaded in memory no matter how many times it is drawn
+	// in the rendered 3D scene; these pick the tessellation
+	// and layout, and the meshes are generated and uploaded
+	// only once BuildRenderList() records a draw of them
+	m_basicMeshes->LoadPlaneMesh();
+	m_basicMeshes->LoadBoxMesh();
+	m_basicMeshes->LoadPyramid3Mesh();
+	m_basicMeshes->LoadPyramid4Mesh();
+	m_basicMeshes->LoadPrismMesh();
+	// the round meshes hold most of the vertices and are drawn
+	// near their unit size, where half float positions hold; the
+	// flat ones are scaled up the most, as floors and walls, so
+	// they keep full floats, and so do the spheres and tori the
+	// GPU generates, which it writes in floats
+	bool bGPUPrimitives = (m_bGPUPrimitives == true) &&
+		(m_pPrimitiveGenerator->Create(PROCEDURAL_MESH_SHADER_PATH) == true);
+	if (bGPUPrimitives == true)
+	{
+		m_basicMeshes->SetProceduralGenerator(PrimitiveGenerator::GenerateMeshes, m_pPrimitiveGenerator);
+	}
+	m_basicMeshes->SetCompactVertices((m_bCompactVertices == true) && (bGPUPrimitives == false));
+	m_basicMeshes->LoadSphereMesh();
+	m_basicMeshes->LoadTorusMesh();
+	m_basicMeshes->SetCompactVertices(m_bCompactVertices);
+	m_basicMeshes->LoadCylinderMesh();
+	m_basicMeshes->LoadTaperedCylinderMesh();
+	m_basicMeshes->LoadConeMesh();
+	m_basicMeshes->SetCompactVertices(false);
+
+	// one multi-draw indirect call per texture and primitive type
+	// needs indirect commands and gl_BaseInstance in the shader
+	m_bMultiDrawIndirect = (GLEW_ARB_shader_draw_parameters == GL_TRUE) &&
+		((GLEW_VERSION_4_3 == GL_TRUE) || (GLEW_ARB_multi_draw_indirect == GL_TRUE));
+
+	// hidden indirect commands are zeroed on the GPU, so the culling
+	// only applies to the multi-draw indirect path
+	if (m_bMultiDrawIndirect == true)
+	{
+		m_pOcclusionCuller->Create(DEPTH_PYRAMID_SHADER_PATH, OCCLUSION_CULL_SHADER_PATH);
+	}
+
+	// the imported models are split into meshlets only when their
+	// culled commands can be drawn; the shapes stay whole
+	if ((m_bMultiDrawIndirect == true) && (m_pMeshletCuller->Create(MESHLET_CULL_SHADER_PATH) == true))
+	{
+		m_pMeshletCuller->SetTextureUnits(INSTANCE_DATA_TEXTURE_UNIT,
+			ShadowAtlas::SHADOW_ATLAS_TEXTURE_UNIT, CascadedShadows::CASCADE_TEXTURE_UNIT,
+			ReflectionProbes::PROBE_TEXTURE_UNIT, TextureTable::TEXTURE_ARRAY_UNIT);
+		m_pMeshletCuller->CreateMeshShading(MESHLET_TASK_SHADER_PATH, MESHLET_MESH_SHADER_PATH,
+			MESHLET_FRAGMENT_SHADER_PATH);
+		m_basicMeshes->SetBuildMeshlets(true);
+	}
+
+	// transparent draws need no sorting once they are blended
+	// independently of their order
+	m_bOrderIndependentTransparency = m_pTransparencyPass->Create(
+		OIT_RESOLVE_VERTEX_SHADER_PATH, OIT_RESOLVE_FRAGMENT_SHADER_PATH);
+	// its accumulation targets have a single layer, so a stereo
+	// frame sorts the glass instead
+	if (m_bStereo == true)
+	{
+		m_bOrderIndependentTransparency = false;
+	}
+
+	// the lit shader reads its lights from the cluster lists
+	m_pLightClusters->Create(LIGHT_CLUSTER_SHADER_PATH);
+	// built even while it is off, so it can be switched on at runtime
+	m_pDeferredPass->Create(DEFERRED_LIGHTING_VERTEX_SHADER_PATH, DEFERRED_LIGHTING_FRAGMENT_SHADER_PATH);
+	m_pShadingRate->Create(SHADING_RATE_SHADER_PATH);
+	// the effects run only at the tiers asked for before this
+	m_pPostStack->Create(POST_VERTEX_SHADER_PATH, POST_SSAO_FRAGMENT_SHADER_PATH,
+		POST_SSAO_BLUR_FRAGMENT_SHADER_PATH, POST_BLOOM_FRAGMENT_SHADER_PATH,
+		POST_COMPOSITE_FRAGMENT_SHADER_PATH, POST_FXAA_FRAGMENT_SHADER_PATH, POST_TAA_FRAGMENT_SHADER_PATH);
+	// the multisampled targets are textures of both kinds
+	GLint maxColorSamples = 1;
+	GLint maxDepthSamples = 1;
+	glGetIntegerv(GL_MAX_COLOR_TEXTURE_SAMPLES, &maxColorSamples);
+	glGetIntegerv(GL_MAX_DEPTH_TEXTURE_SAMPLES, &maxDepthSamples);
+	m_maxSamples = glm::max((int)glm::min(maxColorSamples, maxDepthSamples), 1);
+	// rendered on the first frame, then only when something changes
+	m_pShadowAtlas->Create(SHADOW_CASTER_VERTEX_SHADER_PATH, SHADOW_CASTER_FRAGMENT_SHADER_PATH,
+		m_shadowAtlasBudget);
+	// fitted every frame, drawn when a cascade or a caster in it moves
+	m_pCascadedShadows->Create(CASCADE_CASTER_VERTEX_SHADER_PATH, SHADOW_CASTER_FRAGMENT_SHADER_PATH);
+	// captured once the scene has loaded, one face a frame
+	m_pReflectionProbes->Create(PROBE_PREFILTER_SHADER_PATH);
+	// captured once the scene has loaded, one shape a frame
+	m_pImpostorAtlas->Create(IMPOSTOR_CAPTURE_VERTEX_SHADER_PATH, IMPOSTOR_CAPTURE_FRAGMENT_SHADER_PATH,
+		IMPOSTOR_VERTEX_SHADER_PATH, IMPOSTOR_FRAGMENT_SHADER_PATH);
+	// drawn only on the frames a pick is asked for
+	m_pObjectPicker->Create(PICK_VERTEX_SHADER_PATH, PICK_FRAGMENT_SHADER_PATH, INSTANCE_DATA_TEXTURE_UNIT);
+	if (m_bOcclusionQueries == true)
+	{
+		m_pOcclusionQueries->Create(OCCLUSION_BOX_VERTEX_SHADER_PATH, OCCLUSION_BOX_FRAGMENT_SHADER_PATH);
+	}
+	// the state every other draw of the app starts from
+	ApplyDefaultState();
+	// the instance data is uploaded in full when the pass is missing
+	if (m_bCompactInstances == true)
+	{
+		m_pInstanceExpander->Create(INSTANCE_EXPAND_SHADER_PATH);
+	}
+	// the animated nodes are all posed on the CPU without the pass
+	if (m_pSceneAnimation->IsLoaded() == true)
+	{
+		m_pSceneAnimation->Create(ANIMATION_SAMPLE_SHADER_PATH);
+	}
+	// without compute shaders the particles are not drawn at all
+	if (m_pParticleSystem->IsLoaded() == true)
+	{
+		m_pParticleSystem->Create(PARTICLE_SIMULATE_SHADER_PATH, PARTICLE_SORT_SHADER_PATH,
+			PARTICLE_VERTEX_SHADER_PATH, PARTICLE_FRAGMENT_SHADER_PATH);
+	}
+
+	// the pre-pass is built even while it is off, so it can be
+	// switched on at runtime
+	m_depthPrepassProgram = m_pShaderManager->LoadExternalProgram(
+		DEPTH_PREPASS_VERTEX_SHADER_PATH, DEPTH_PREPASS_FRAGMENT_SHADER_PATH);
+	if (0 != m_depthPrepassProgram)
+	{
+		m_depthPrepassResource = m_pResources->Adopt<ResourceManager::RESOURCE_PROGRAM>("depth prepass",
+			MakeResourceObject(m_depthPrepassProgram, NULL), DestroyProgramObject);
+		m_pShaderManager->UseExternalProgram(m_depthPrepassProgram);
+		glUniform1i(glGetUniformLocation(m_depthPrepassProgram, "instanceData"), INSTANCE_DATA_TEXTURE_UNIT);
+		m_depthPrepassInstanceBaseLocation = glGetUniformLocation(m_depthPrepassProgram, "instanceBase");
+	}
+
+	// the scene is static, so describe it once and replay the
+	// recorded draws every frame
+	BuildRenderList();
+}
+
+/***********************************************************
+*  SetShaderAttributes()
+*
+*  This method is used for setting the shader's color,
+	texturing, and material attributes for the mesh.
+	- Use "none" for no texture or material.
+	- UVscale sets number of texture tiles in X&Y directions.
+	- Parameters default to white color, "none" texture,
+	  (1.0f, 1.0f) UVscale, and "none" material. Omit trailing
+	  parameters for default values.
+***********************************************************/
+void SceneManager::SetShaderAttributes(
+	glm::vec4 colorRGBA,		 // RGBA color
+	const std::string& texture,	   // texture name (default = "none) (from LoadSceneTextures())
+	glm::vec2 UVscale,	  // number of times texture drawn in X&Y direction (default = (1.0f, 1.0f))
+	const std::string& material) // name of material (default = "none") (from DefineObjectMaterials())
+{
+	SetShaderAttributes(
+		colorRGBA,
+		(texture != "none") ? m_textureTags.Find(texture) : TagRegistry::INVALID_HANDLE,
+		UVscale,
+		(material != "none") ? m_materialTags.Find(material) : TagRegistry::INVALID_HANDLE);
+}
+
+/***********************************************************
+*  SetShaderAttributes()
+*
+*  This method is used for setting the shader's color,
+	texturing, and material attributes for the mesh, with
+	the handles from FindTexture() and FindMaterial().
+	- Use TagRegistry::INVALID_HANDLE for no texture or
+	  material.
+***********************************************************/
+void SceneManager::SetShaderAttributes(
+	glm::vec4 colorRGBA,
+	TextureHandle texture,
+	glm::vec2 UVscale,
+	MaterialHandle material)
+{
+	PROFILE_SCOPE("SetShaderAttributes");
+	// Set texture if provided, otherwise set RGBA color. Each
+	// path selects its own shader permutation, so only one is
+	// taken to avoid switching programs twice per draw
+	if (m_textureTags.IsValid(texture) == true)
+	{
+		if (m_bRecording == true)
+		{
+			m_recordState.color = colorRGBA;
+		}
+		else if (NULL != m_pShaderManager)
+		{
+			m_pShaderManager->setUniform(m_uniforms.objectColor, colorRGBA);
+		}
+		SetShaderTexture(texture);
+	}
+	else
+	{
+		SetShaderColor(colorRGBA.x, colorRGBA.y, colorRGBA.z, colorRGBA.w);
+	}
+	// Set UV scale
+	SetTextureUVScale(UVscale.x, UVscale.y);
+	// Set material if provided
+	if (m_materialTags.IsValid(material) == true)
+	{
+		SetShaderMaterial(material);
+	}
+}
+
+/***********************************************************
+ *  DrawMeshTransformation()
+ *
+ *  This method is used for drawing a basic 3D shape given parameter
+ *  vectors for color, scale, rotation, position. Must pass the ShapeMeshes object,
+ *  and a descriptor from ShapeMeshWrappers.h naming the shape and the range of
+ *  it to draw, e.g. ShapeMeshWrappers::HollowCylinder, which stands for the
+ *  default parameter arguments of the ShapeMeshes draw method it maps to.
+ ***********************************************************/
+void SceneManager::DrawMeshTransformation(
+	glm::vec3 scaleXYZ,					// shape XYZ scale
+	glm::vec3 rotationDegreesXYZ,	  // shape XYZ rotation
+	glm::vec3 positionXYZ,			 // XYZ position of shape
+	ShapeMeshes* meshObject,		// pointer to ShapeMesh object
+	ShapeMeshWrappers::MESH_DRAW meshDraw) // descriptor of the shape and range to draw
+{
+	// Set transform buffer using passed in arguments
+	SetTransformations(
+		scaleXYZ, // Scale
+		rotationDegreesXYZ.x, // X axis rotation
+		rotationDegreesXYZ.y, // Y axis rotation
+		rotationDegreesXYZ.z, // Z axis rotation
+		positionXYZ); // XYZ position
+	
+	// Draws the shape the descriptor names
+	ShapeMeshWrappers::DrawMesh(meshObject, meshDraw);
+}
+
+/***********************************************************
+ *  BuildRenderList()
+ *
+ *  This method is used for recording the draws made by
+ *  DefineSceneObjects() into the render list, together with
+ *  the transform, color, texture, UV scale and material that
+ *  were set for each of them. The meshes are generated as
+ *  the draws first use them, unless a scene file has baked
+ *  meshes next to it; when meshes the last list drew are
+ *  freed, the arena is rebuilt, so the draws are recorded
+ *  over it again. The arena is sent to GL once, at the end.
+ ***********************************************************/
+void SceneManager::BuildRenderList()
+{
+	if (m_sceneFile.IsLoaded() == true)
+	{
+		m_basicMeshes->LoadBakedMeshes((m_sceneFilePath + ".meshes").c_str());
+	}
+	m_basicMeshes->ResetMeshReferences();
+	RecordRenderList();
+	if (m_basicMeshes->ReleaseUnreferencedMeshes() == true)
+	{
+		RecordRenderList();
+	}
+	m_basicMeshes->UploadArena();
+
+	BakeStaticGeometry();
+
+	// bind the clips to the recorded nodes, which widens the boxes
+	// of the draws the GPU poses before they are indexed
+	if (m_pSceneAnimation->IsLoaded() == true)
+	{
+		std::vector<unsigned char> drawStatic(m_renderList.size());
+		for (size_t i = 0; i < m_renderList.size(); i++)
+		{
+			drawStatic[i] = (m_renderList[i].bStatic == true) ? 1 : 0;
+		}
+		m_pSceneAnimation->Bind(m_sceneTransforms, drawStatic);
+	}
+	// the emitters follow the nodes of the new list
+	if (m_pParticleSystem->IsLoaded() == true)
+	{
+		m_pParticleSystem->Bind(m_sceneTransforms);
+	}
+
+	// index the world bounds of the new list for the spatial queries
+	m_sceneBVH.Build(m_sceneTransforms.GetAllDrawBounds());
+	m_pShadowAtlas->InvalidateAll();
+	m_pCascadedShadows->InvalidateAll();
+	PlaceReflectionProbes();
+	CollectImpostorGroups();
+	CollectQueryGroups();
+
+	// size the instance data for the new list and force a rebuild
+	m_instanceData.resize(m_renderList.size());
+	m_instanceOrder.clear();
+	m_drawRemoved.assign(m_renderList.size(), 0);
+	m_bDrawsAdded = false;
+
+	// every frame writes the instance data and at most one indirect
+	// command per draw, plus the camera block and the alignment
+	if (NULL != m_pUploadRing)
+	{
+		m_pUploadRing->Reserve((GLsizeiptr)(m_renderList.size() *
+			(sizeof(INSTANCE_DATA) + sizeof(ShapeMeshes::INDIRECT_COMMAND))) + UPLOAD_RING_SLACK_BYTES);
+	}
+}
+
+/***********************************************************
+ *  RecordRenderList()
+ *
+ *  This method is used for clearing the render list and
+ *  recording the draws of the scene file, or of
+ *  DefineSceneObjects() without one, into it.
+ ***********************************************************/
+void SceneManager::RecordRenderList()
+{
+	m_renderList.clear();
+	m_meshRanges.clear();
+	m_sceneTransforms.Clear();
+	m_staticDraws.clear();
+	m_staticDrawChunks.clear();
+	m_nodeShapeTags.clear();
+	m_currentParentNode = -1;
+	// the prefabs are compiled again, the range IDs they held are gone
+	ClearPrefabs();
+	m_sceneFilePrefabs.assign((m_sceneFile.IsLoaded() == true) ? m_sceneFile.GetPrefabCount() : 0, -1);
+	memset(&m_prefabStats, 0, sizeof(m_prefabStats));
+
+	m_recordModel = glm::mat4(1.0f);
+	m_recordState.color = glm::vec4(1.0f, 1.0f, 1.0f, 1.0f);
+	m_recordState.UVscale = glm::vec2(1.0f, 1.0f);
+	m_recordState.textureSlot = -1;
+	m_recordState.materialID = 0;
+	m_recordState.bTransparent = false;
+	m_recordState.nodeID = -1;
+	m_recordState.bStatic = false;
+
+	m_bRecording = true;
+	m_basicMeshes->SetDrawRecorder(RecordDrawRange, this);
+
+	// a loaded scene file replaces the scene described in code
+	if (m_sceneFile.IsLoaded() == true)
+	{
+		DefineSceneFileObjects();
+	}
+	else
+	{
+		DefineSceneObjects();
+	}
+
+	m_basicMeshes->SetDrawRecorder(NULL, NULL);
+	m_bRecording = false;
+	m_recordState.bStatic = false;
+}
+
+/***********************************************************
+ *  SaveBakedMeshes()
+ *
+ *  This method is used for baking the meshes the draws of
+ *  the scene file use into the file next to it that
+ *  BuildRenderList() loads, coded when it goes into the
+ *  asset pack. The built-in scene has no file to keep them
+ *  next to.
+ ***********************************************************/
+bool SceneManager::SaveBakedMeshes(bool bEncode)
+{
+	if (m_sceneFile.IsLoaded() == false)
+	{
+		std::cout << "Only the meshes of a scene file can be baked" << std::endl;
+		return(false);
+	}
+	return(m_basicMeshes->SaveBakedMeshes((m_sceneFilePath + ".meshes").c_str(), bEncode));
+}
+
+/***********************************************************
+ *  LoadSceneFile()
+ *
+ *  This method is used for reading the scene description
+ *  that PrepareScene() builds the scene from, in its text
+ *  or compiled form. Without one, or when it cannot be
+ *  read, the scene of DefineSceneObjects() is used.
+ ***********************************************************/
+bool SceneManager::LoadSceneFile(const char* filename)
+{
+	if (m_sceneFile.Load(filename) == false)
+	{
+		std::cout << "Could not load scene file " << filename << ", using the built-in scene" << std::endl;
+		return(false);
+	}
+
+	m_sceneFilePath = filename;
+	return(true);
+}
+
+/***********************************************************
+ *  LoadSceneFile()
+ *
+ *  This method is used for taking over a scene description
+ *  read elsewhere, so it can be read while the window and
+ *  the GL context are created.
+ ***********************************************************/
+bool SceneManager::LoadSceneFile(SceneFile& sceneFile, const char* filename)
+{
+	if (sceneFile.IsLoaded() == false)
+	{
+		std::cout << "Could not load scene file " << filename << ", using the built-in scene" << std::endl;
+		return(false);
+	}
+
+	m_sceneFile.Swap(sceneFile);
+	m_sceneFilePath = filename;
+	return(true);
+}
+
+/***********************************************************
+ *  LoadSceneFileResources()
+ *
+ *  This method is used for loading the textures, defining
+ *  the materials and adding the lights listed by the scene
+ *  file, and remembering the texture slot and material ID
+ *  each of them got for the parts referring to them. The
+ *  models are imported on a worker thread meanwhile.
+ ***********************************************************/
+void SceneManager::LoadSceneFileResources()
+{
+	const SceneFile::TEXTURE_RECORD* pTextures = m_sceneFile.GetTextures();
+	std::vector<TEXTURE_FILE> textureFiles(m_sceneFile.GetTextureCount());
+	for (uint32_t i = 0; i < m_sceneFile.GetTextureCount(); i++)
+	{
+		textureFiles[i].filename = pTextures[i].path;
+		textureFiles[i].tag = pTextures[i].tag;
+	}
+	CreateGLTextures(textureFiles);
+	BindGLTextures();
+
+	// a texture that failed to load draws untextured
+	m_sceneFileTextureSlots.resize(m_sceneFile.GetTextureCount());
+	for (uint32_t i = 0; i < m_sceneFile.GetTextureCount(); i++)
+	{
+		m_sceneFileTextureSlots[i] = FindTextureSlot(pTextures[i].tag);
+	}
+
+	const SceneFile::MATERIAL_RECORD* pMaterials = m_sceneFile.GetMaterials();
+	m_sceneFileMaterialIDs.resize(m_sceneFile.GetMaterialCount());
+	for (uint32_t i = 0; i < m_sceneFile.GetMaterialCount(); i++)
+	{
+		OBJECT_MATERIAL material;
+		material.ambientColor = glm::make_vec3(pMaterials[i].ambientColor);
+		material.ambientStrength = pMaterials[i].ambientStrength;
+		material.diffuseColor = glm::make_vec3(pMaterials[i].diffuseColor);
+		material.specularColor = glm::make_vec3(pMaterials[i].specularColor);
+		material.shininess = pMaterials[i].shininess;
+		material.reflectivity = pMaterials[i].reflectivity;
+		material.tag = pMaterials[i].tag;
+		material.bTransparent = (pMaterials[i].bTransparent != 0);
+		material.bCoarseShading = (pMaterials[i].bCoarseShading != 0);
+		m_objectMaterials.push_back(material);
+		m_sceneFileMaterialIDs[i] = (int)m_objectMaterials.size() - 1;
+	}
+
+	// the parts of the models draw nothing until they are imported;
+	// a scene cut into chunks imports each model once the first chunk
+	// using it is loaded
+	m_sceneFileModels.assign(m_sceneFile.GetModelCount(), SCENE_MODEL());
+	if (m_worldChunks.Build(m_sceneFile) == false)
+	{
+		for (uint32_t i = 0; i < m_sceneFile.GetModelCount(); i++)
+		{
+			LoadSceneFileModel((int)i);
+		}
+	}
+
+	m_lights.clear();
+	m_bLightsDirty = true;
+	// an unlit scene file lists no lights
+	m_bUseLighting = (m_sceneFile.GetLightCount() > 0);
+
+	const SceneFile::LIGHT_RECORD* pLights = m_sceneFile.GetLights();
+	for (uint32_t i = 0; i < m_sceneFile.GetLightCount(); i++)
+	{
+		LIGHT_SOURCE light;
+		light.position = glm::make_vec3(pLights[i].position);
+		light.ambientColor = glm::make_vec3(pLights[i].ambientColor);
+		light.diffuseColor = glm::make_vec3(pLights[i].diffuseColor);
+		light.specularColor = glm::make_vec3(pLights[i].specularColor);
+		light.focalStrength = pLights[i].focalStrength;
+		light.specularIntensity = pLights[i].specularIntensity;
+		light.radius = pLights[i].radius;
+		light.shadowIndex = -1;	// assigned by UpdateShadowMaps()
+		AddLight(light);
+	}
+}
+
+/***********************************************************
+ *  LoadSceneFileModel()
+ *
+ *  This method is used for importing a model of the scene
+ *  file: it is read on the loader thread of the resource
+ *  manager and added to the shape meshes, which its load
+ *  holds on to. The model meshes are kept once added, and
+ *  only join the arena while a draw uses them.
+ ***********************************************************/
+void SceneManager::LoadSceneFileModel(int fileIndex)
+{
+	const SceneFile::MODEL_RECORD& modelRecord = m_sceneFile.GetModels()[fileIndex];
+	std::shared_ptr<ModelImporter::MODEL> pModel = std::make_shared<ModelImporter::MODEL>();
+	std::string path = modelRecord.path;
+	ResourceManager::LOAD_DESC load;
+	load.prepare = [pModel, path]() { return(ModelImporter::Import(path.c_str(), *pModel)); };
+	load.create = [this, pModel, fileIndex](ResourceManager::RESOURCE_OBJECT& object) {
+		object.index = fileIndex;
+		AddImportedModel(fileIndex, *pModel);
+		// the meshes and materials were copied out of it
+		*pModel = ModelImporter::MODEL();
+		return(true);
+	};
+	load.dependencies.push_back(m_basicMeshesResource.value);
+	m_sceneFileModels[fileIndex].resource = m_pResources->Load<ResourceManager::RESOURCE_MESH>(
+		std::string(modelRecord.tag) + " " + path, load);
+}
+
+/***********************************************************
+ *  IsChunkReady()
+ *
+ *  This method is used by WorldChunks for each loading
+ *  chunk every frame. The first call starts the imports of
+ *  its models not asked for yet; a model that failed to
+ *  import counts as finished, its parts drawing nothing as
+ *  without chunks. Until then the textures of the chunk are
+ *  marked as drawn small, so the residency keeps or reads
+ *  back their lower levels before the chunk shows.
+ ***********************************************************/
+bool SceneManager::IsChunkReady(void* pContext, const WorldChunks::CHUNK& chunk)
+{
+	SceneManager* pSceneManager = (SceneManager*)pContext;
+
+	bool bReady = true;
+	for (size_t i = 0; i < chunk.models.size(); i++)
+	{
+		SCENE_MODEL& model = pSceneManager->m_sceneFileModels[chunk.models[i]];
+		if (model.resource.IsNull() == true)
+		{
+			pSceneManager->LoadSceneFileModel(chunk.models[i]);
+		}
+		ResourceManager::RESOURCE_STATE state = pSceneManager->m_pResources->GetState(model.resource);
+		bReady = (bReady == true) && (state != ResourceManager::STATE_WAITING) && (state != ResourceManager::STATE_LOADING);
+	}
+
+	for (size_t i = 0; i < chunk.textures.size(); i++)
+	{
+		int slot = pSceneManager->m_sceneFileTextureSlots[chunk.textures[i]];
+		if (slot >= 0)
+		{
+			pSceneManager->m_pTextureResidency->MarkDrawn(slot, CHUNK_TEXTURE_PIXELS, 1.0f);
+		}
+	}
+	return(bReady);
+}
+
+/***********************************************************
+ *  DefineSceneFileObjects()
+ *
+ *  This method is used for recording the scene file into
+ *  the render list: a scene node for every instance, and
+ *  under it a node and the draws of every part of its
+ *  prefab. Each prefab is compiled into draw records by its
+ *  first instance, and every instance copies them. The
+ *  records are read where the file was mapped and the
+ *  arrays are sized up front, so recording a large scene
+ *  allocates nothing per object. A scene cut into chunks
+ *  records the instances of the resident ones.
+ ***********************************************************/
+void SceneManager::DefineSceneFileObjects()
+{
+	const SceneFile::INSTANCE_RECORD* pInstances = m_sceneFile.GetInstances();
+
+	size_t drawCount = m_sceneFile.GetDrawCount();
+	m_sceneTransforms.Reserve(m_sceneFile.GetNodeCount(), drawCount);
+	m_renderList.reserve(drawCount);
+
+	for (uint32_t i = 0; i < m_sceneFile.GetInstanceCount(); i++)
+	{
+		// a scene cut into chunks records only the resident ones
+		if (m_worldChunks.IsInstanceResident(i) == false)
+		{
+			continue;
+		}
+		m_recordChunk = m_worldChunks.GetInstanceChunk(i);
+
+		const SceneFile::INSTANCE_RECORD& instance = pInstances[i];
+
+		// the instance node has no parent, its parts go under it
+		m_currentParentNode = -1;
+		SetStaticGeometry((instance.flags & SceneFile::INSTANCE_STATIC) != 0);
+		PlacePrefab(GetSceneFilePrefab(instance.prefabIndex), instance.tag,
+			glm::make_vec3(instance.scaleXYZ),
+			glm::make_vec3(instance.rotationDegreesXYZ),
+			glm::make_vec3(instance.positionXYZ));
+	}
+
+	SetStaticGeometry(false);
+	m_currentParentNode = -1;
+	m_recordChunk = -1;
+}
+
+/***********************************************************
+ *  GetSceneFilePrefab()
+ *
+ *  This method is used for getting the compiled prefab of a
+ *  scene file prefab, compiling it from its part records the
+ *  first time. Prefabs no resident instance uses are never
+ *  compiled, so their meshes are not drawn.
+ ***********************************************************/
+int SceneManager::GetSceneFilePrefab(uint32_t prefabIndex)
+{
+	if (m_sceneFilePrefabs[prefabIndex] >= 0)
+	{
+		return(m_sceneFilePrefabs[prefabIndex]);
+	}
+
+	const SceneFile::PREFAB_RECORD& prefab = m_sceneFile.GetPrefabs()[prefabIndex];
+	const SceneFile::PART_RECORD* pParts = m_sceneFile.GetParts() + prefab.firstPart;
+
+	std::vector<PREFAB_PART> parts(prefab.partCount);
+	for (uint32_t p = 0; p < prefab.partCount; p++)
+	{
+		const SceneFile::PART_RECORD& record = pParts[p];
+		PREFAB_PART& part = parts[p];
+
+		part.mesh = record.mesh;
+		part.modelIndex = record.modelIndex;
+		// a model part in a material of its own keeps it on every mesh
+		part.bModelMaterials = (record.materialIndex < 0);
+		part.color = glm::make_vec4(record.color);
+		part.UVscale = glm::make_vec2(record.UVscale);
+		part.textureSlot = (record.textureIndex >= 0) ?
+			m_sceneFileTextureSlots[record.textureIndex] : -1;
+		part.materialID = (record.materialIndex >= 0) ?
+			m_sceneFileMaterialIDs[record.materialIndex] : 0;
+		part.scaleXYZ = glm::make_vec3(record.scaleXYZ);
+		part.rotationDegreesXYZ = glm::make_vec3(record.rotationDegreesXYZ);
+		part.positionXYZ = glm::make_vec3(record.positionXYZ);
+	}
+
+	m_sceneFilePrefabs[prefabIndex] = CompilePrefab(prefab.name, parts);
+	return(m_sceneFilePrefabs[prefabIndex]);
+}
+
+/***********************************************************
+ *  GetBuiltInPrefab()
+ *
+ *  This method is used for getting the compiled prefab of a
+ *  composite object of the built-in scene, compiling it from
+ *  its table the first time. The texture and material tags
+ *  are resolved once here, not for every instance.
+ ***********************************************************/
+int SceneManager::GetBuiltInPrefab(const std::string& name)
+{
+	for (size_t i = 0; i < m_prefabs.size(); i++)
+	{
+		if (m_prefabs[i].name == name)
+		{
+			return((int)i);
+		}
+	}
+
+	const BUILTIN_PREFAB* pPrefab = NULL;
+	for (size_t i = 0; i < sizeof(BUILTIN_PREFABS) / sizeof(BUILTIN_PREFABS[0]); i++)
+	{
+		if (name == BUILTIN_PREFABS[i].name)
+		{
+			pPrefab = &BUILTIN_PREFABS[i];
+			break;
+		}
+	}
+	if (NULL == pPrefab)
+	{
+		std::cout << "Unknown built-in prefab " << name << std::endl;
+		return(-1);
+	}
+
+	std::vector<PREFAB_PART> parts(pPrefab->partCount);
+	for (int p = 0; p < pPrefab->partCount; p++)
+	{
+		const BUILTIN_PART& builtIn = pPrefab->pParts[p];
+		PREFAB_PART& part = parts[p];
+
+		part.mesh = builtIn.mesh;
+		part.modelIndex = -1;
+		part.bModelMaterials = false;
+		part.color = glm::make_vec4(builtIn.color);
+		part.UVscale = glm::make_vec2(builtIn.UVscale);
+		part.textureSlot = (NULL != builtIn.textureTag) ?
+			m_textureTags.Resolve(FindTexture(builtIn.textureTag)) : -1;
+		part.materialID = glm::max(m_materialTags.Resolve(FindMaterial(builtIn.materialTag)), 0);
+		part.scaleXYZ = glm::make_vec3(builtIn.scaleXYZ);
+		part.rotationDegreesXYZ = glm::make_vec3(builtIn.rotationDegreesXYZ);
+		part.positionXYZ = glm::make_vec3(builtIn.positionXYZ);
+	}
+
+	return(CompilePrefab(pPrefab->name, parts));
+}
+
+/***********************************************************
+ *  CompilePrefab()
+ *
+ *  This method is used for flattening a prefab into the draw
+ *  records of its parts: each part is drawn once, with its
+ *  shader state, into the prefab instead of the render list,
+ *  and the transparency of every record is decided here. The
+ *  records keep the mesh ranges, so an instance placed later
+ *  draws nothing through ShapeMeshes.
+ ***********************************************************/
+int SceneManager::CompilePrefab(
+	const std::string& name,
+	const std::vector<PREFAB_PART>& parts)
+{
+	m_prefabs.push_back(COMPILED_PREFAB());
+	m_prefabs.back().name = name;
+	m_prefabs.back().parts = parts;
+	m_prefabs.back().pGeometry = NULL;
+
+	DRAW_RECORD savedState = m_recordState;
+	m_basicMeshes->SetDrawRecorder(RecordPrefabRange, this);
+	for (size_t p = 0; p < parts.size(); p++)
+	{
+		const PREFAB_PART& part = parts[p];
+
+		m_prefabPart = (int)p;
+		m_recordState.color = part.color;
+		m_recordState.UVscale = part.UVscale;
+		m_recordState.textureSlot = part.textureSlot;
+		m_recordState.materialID = part.materialID;
+		if (part.mesh == SceneFile::MESH_MODEL)
+		{
+			DrawSceneFileModel(part.modelIndex, (part.bModelMaterials == false));
+		}
+		else
+		{
+			DrawSceneFileMesh(part.mesh);
+		}
+	}
+	m_basicMeshes->SetDrawRecorder(RecordDrawRange, this);
+	m_recordState = savedState;
+	m_prefabPart = -1;
+
+	MergePrefabParts(m_prefabs.back());
+
+	m_prefabStats.prefabs++;
+	m_prefabStats.parts += (int)parts.size();
+	return((int)m_prefabs.size() - 1);
+}
+
+/***********************************************************
+ *  MergePrefabParts()
+ *
+ *  This method is used for baking the part draws of a prefab
+ *  that share a texture, material and color with another of
+ *  its parts into one triangle list per state, in the space
+ *  of the prefab with the part transforms and UV scales
+ *  applied. A movable instance then draws each group once
+ *  on its own node. Parts alone in their state, and those
+ *  split into meshlets, keep their draws and LOD levels.
+ ***********************************************************/
+void SceneManager::MergePrefabParts(COMPILED_PREFAB& prefab)
+{
+	std::vector<PREFAB_DRAW>& draws = prefab.draws;
+
+	// a draw merges when another one of the prefab has its state
+	std::vector<bool> mergeable(draws.size(), false);
+	for (size_t d = 0; d < draws.size(); d++)
+	{
+		const DRAW_RECORD& record = draws[d].record;
+		mergeable[d] = (record.range.meshletCount == 0) && (StaticGeometry::CanBake(record.range) == true);
+	}
+	std::vector<StaticGeometry::STATIC_DRAW> mergeDraws;
+	prefab.mergedDraws.clear();
+	for (size_t d = 0; d < draws.size(); d++)
+	{
+		const DRAW_RECORD& record = draws[d].record;
+		bool bMerged = false;
+		for (size_t other = 0; (other < draws.size()) && (mergeable[d] == true); other++)
+		{
+			const DRAW_RECORD& otherRecord = draws[other].record;
+			if ((other != d) && (mergeable[other] == true) &&
+				(otherRecord.textureSlot == record.textureSlot) &&
+				(otherRecord.materialID == record.materialID) &&
+				(otherRecord.color == record.color))
+			{
+				bMerged = true;
+				break;
+			}
+		}
+		if (bMerged == false)
+		{
+			prefab.mergedDraws.push_back(draws[d]);
+			continue;
+		}
+
+		const PREFAB_PART& part = prefab.parts[draws[d].part];
+		StaticGeometry::STATIC_DRAW staticDraw;
+		staticDraw.range = record.range;
+		staticDraw.model = ComposeModelMatrix(part.scaleXYZ, part.rotationDegreesXYZ, part.positionXYZ);
+		staticDraw.color = record.color;
+		staticDraw.UVscale = record.UVscale;
+		staticDraw.textureSlot = record.textureSlot;
+		staticDraw.materialID = record.materialID;
+		mergeDraws.push_back(staticDraw);
+	}
+	if (mergeDraws.empty() == true)
+	{
+		prefab.mergedDraws.clear();
+		return;
+	}
+
+	prefab.pGeometry = new StaticGeometry();
+	prefab.pGeometry->SetBufferAllocator(&m_meshPages);
+	prefab.pGeometry->Bake(mergeDraws, *m_basicMeshes, false);
+
+	for (size_t i = 0; i < prefab.pGeometry->GetGroupCount(); i++)
+	{
+		const StaticGeometry::BAKED_GROUP& group = prefab.pGeometry->GetGroup(i);
+
+		PREFAB_DRAW prefabDraw;
+		prefabDraw.part = -1;
+		DRAW_RECORD& drawRecord = prefabDraw.record;
+		drawRecord.range = prefab.pGeometry->GetGroupRange(i);
+		drawRecord.rangeID = -1;
+		drawRecord.lod = 0;
+		drawRecord.color = group.color;
+		drawRecord.UVscale = glm::vec2(1.0f, 1.0f);
+		drawRecord.textureSlot = group.textureSlot;
+		drawRecord.materialID = group.materialID;
+		drawRecord.bTransparent = IsTransparentRecord(drawRecord);
+		drawRecord.nodeID = -1;
+		drawRecord.bStatic = false;
+		prefab.mergedDraws.push_back(prefabDraw);
+	}
+
+	m_prefabStats.mergedParts += (int)mergeDraws.size();
+	m_prefabStats.mergedGroups += (int)prefab.pGeometry->GetGroupCount();
+}
+
+/***********************************************************
+ *  ClearPrefabs()
+ *
+ *  This method is used for dropping the compiled prefabs
+ *  and freeing the buffers of their merged groups.
+ ***********************************************************/
+void SceneManager::ClearPrefabs()
+{
+	for (size_t i = 0; i < m_prefabs.size(); i++)
+	{
+		delete m_prefabs[i].pGeometry;
+		m_prefabs[i].pGeometry = NULL;
+	}
+	m_prefabs.clear();
+}
+
+/***********************************************************
+ *  PlacePrefab()
+ *
+ *  This method is used for adding an instance of a compiled
+ *  prefab under the open scene node: the instance node, a
+ *  node for every part it draws on under it, and a copy of
+ *  every draw record of the prefab on the node of its part.
+ *  A movable instance draws the merged groups of the prefab
+ *  on the instance node; a static one draws the parts, which
+ *  the bake of the scene merges with the rest. The copies
+ *  only differ by their node, so the draws of every instance
+ *  sort next to the same draws of the others and share
+ *  their instanced draws. The instance is static or movable
+ *  as set by SetStaticGeometry().
+ ***********************************************************/
+int SceneManager::PlacePrefab(
+	int prefabID,
+	const std::string& tag,
+	glm::vec3 scaleXYZ,
+	glm::vec3 rotationDegreesXYZ,
+	glm::vec3 positionXYZ)
+{
+	if ((prefabID < 0) || (prefabID >= (int)m_prefabs.size()))
+	{
+		return(-1);
+	}
+	COMPILED_PREFAB& prefab = m_prefabs[prefabID];
+
+	int parentNode = m_currentParentNode;
+	int nodeID = AddSceneNode(tag, scaleXYZ, rotationDegreesXYZ, positionXYZ);
+	// every instance of a prefab shares its impostor
+	m_nodeShapeTags.resize(nodeID + 1);
+	m_nodeShapeTags[nodeID] = prefab.name;
+
+	std::vector<PREFAB_DRAW>& draws = ((NULL != prefab.pGeometry) && (m_recordState.bStatic == false)) ?
+		prefab.mergedDraws : prefab.draws;
+
+	// the parts get their nodes as their first draw needs them
+	m_currentParentNode = nodeID;
+	m_prefabPartNodes.assign(prefab.parts.size(), -1);
+	for (size_t d = 0; d < draws.size(); d++)
+	{
+		int part = draws[d].part;
+		if ((part >= 0) && (m_prefabPartNodes[part] < 0))
+		{
+			m_prefabPartNodes[part] = AddSceneNode("",
+				prefab.parts[part].scaleXYZ,
+				prefab.parts[part].rotationDegreesXYZ,
+				prefab.parts[part].positionXYZ);
+		}
+	}
+	m_currentParentNode = parentNode;
+
+	for (size_t d = 0; d < draws.size(); d++)
+	{
+		DRAW_RECORD& drawRecord = draws[d].record;
+		drawRecord.nodeID = (draws[d].part >= 0) ? m_prefabPartNodes[draws[d].part] : nodeID;
+		drawRecord.bStatic = m_recordState.bStatic;
+		m_recordModel = m_sceneTransforms.GetNodeWorld(drawRecord.nodeID);
+		// the first movable instance finds the range IDs for the others
+		AddRecordedDraw(drawRecord);
+	}
+
+	m_prefabStats.instances++;
+	m_prefabStats.draws += (int)draws.size();
+	return(nodeID);
+}
+
+/***********************************************************
+ *  DrawSceneFileMesh()
+ *
+ *  This method is used for drawing the basic mesh a scene
+ *  file part names, through the ShapeMeshWrappers
+ *  descriptor of the same shape and range.
+ ***********************************************************/
+void SceneManager::DrawSceneFileMesh(uint32_t mesh)
+{
+	if (mesh < (uint32_t)SceneFile::MESH_MODEL)
+	{
+		ShapeMeshWrappers::DrawMesh(m_basicMeshes, SCENE_FILE_MESH_DRAWS[mesh]);
+	}
+}
+
+/***********************************************************
+ *  DrawSceneFileModel()
+ *
+ *  This method is used for drawing the primitives of an
+ *  imported scene file model under the node of the part,
+ *  each in the material it was imported with unless the
+ *  part names one. Every instance of the prefab draws the
+ *  same model meshes, so they are batched like the shapes.
+ ***********************************************************/
+void SceneManager::DrawSceneFileModel(int modelIndex, bool bKeepMaterial)
+{
+	const SCENE_MODEL& model = m_sceneFileModels[modelIndex];
+	int partMaterialID = m_recordState.materialID;
+	for (size_t i = 0; i < model.meshIDs.size(); i++)
+	{
+		m_recordState.materialID = (bKeepMaterial == true) ? partMaterialID : model.materialIDs[i];
+		m_basicMeshes->DrawModelMesh(model.meshIDs[i]);
+	}
+	m_recordState.materialID = partMaterialID;
+}
+
+/***********************************************************
+ *  RecordDrawRange()
+ *
+ *  This method is used by ShapeMeshes while the render list
+ *  is recorded, to add one draw with the current shader
+ *  state to the list.
+ ***********************************************************/
+void SceneManager::RecordDrawRange(
+	void* pContext,
+	const ShapeMeshes::DRAW_RANGE& drawRange)
+{
+	SceneManager* pSceneManager = (SceneManager*)pContext;
+	DRAW_RECORD& recordState = pSceneManager->m_recordState;
+
+	recordState.range = drawRange;
+	recordState.rangeID = -1;
+	recordState.bTransparent = pSceneManager->IsTransparentRecord(recordState);
+	pSceneManager->AddRecordedDraw(recordState);
+}
+
+/***********************************************************
+ *  RecordPrefabRange()
+ *
+ *  This method is used by ShapeMeshes while a prefab is
+ *  compiled, to keep one draw record of the part being
+ *  compiled with the current shader state.
+ ***********************************************************/
+void SceneManager::RecordPrefabRange(
+	void* pContext,
+	const ShapeMeshes::DRAW_RANGE& drawRange)
+{
+	SceneManager* pSceneManager = (SceneManager*)pContext;
+
+	PREFAB_DRAW prefabDraw;
+	prefabDraw.part = pSceneManager->m_prefabPart;
+	prefabDraw.record = pSceneManager->m_recordState;
+	prefabDraw.record.range = drawRange;
+	prefabDraw.record.rangeID = -1;
+	prefabDraw.record.bTransparent = pSceneManager->IsTransparentRecord(prefabDraw.record);
+	pSceneManager->m_prefabs.back().draws.push_back(prefabDraw);
+}
+
+/***********************************************************
+ *  IsTransparentRecord()
+ *
+ *  This method is used for deciding whether a draw record
+ *  is blended, from the alpha of its texture or color and
+ *  from its material.
+ ***********************************************************/
+bool SceneManager::IsTransparentRecord(const DRAW_RECORD& drawRecord) const
+{
+	// blended draws need to go over the opaque ones
+	bool bTransparent = false;
+	if (drawRecord.textureSlot >= 0)
+	{
+		bTransparent = m_textureIDs[drawRecord.textureSlot].bHasAlpha;
+	}
+	else
+	{
+		bTransparent = (drawRecord.color.a < 1.0f);
+	}
+	if ((drawRecord.materialID >= 0) &&
+		(drawRecord.materialID < (int)m_objectMaterials.size()) &&
+		(m_objectMaterials[drawRecord.materialID].bTransparent == true))
+	{
+		bTransparent = true;
+	}
+
+	return(bTransparent);
+}
+
+/***********************************************************
+ *  AddRecordedDraw()
+ *
+ *  This method is used for adding a recorded draw, with the
+ *  model matrix in m_recordModel, to the static draws of the
+ *  bake or to the render list. A record without range IDs
+ *  gets them here and keeps them for its next copy.
+ ***********************************************************/
+void SceneManager::AddRecordedDraw(DRAW_RECORD& drawRecord)
+{
+	const ShapeMeshes::DRAW_RANGE& drawRange = drawRecord.range;
+
+	// opaque static draws are kept for the bake instead, which
+	// merges them in world space after the recording; the ones split
+	// into meshlets are culled finer than a merged group would be
+	if ((drawRecord.bStatic == true) && (drawRecord.bTransparent == false) &&
+		(drawRange.meshletCount == 0) && (StaticGeometry::CanBake(drawRange) == true))
+	{
+		StaticGeometry::STATIC_DRAW staticDraw;
+		staticDraw.range = drawRange;
+		staticDraw.model = m_recordModel;
+		staticDraw.color = drawRecord.color;
+		staticDraw.UVscale = drawRecord.UVscale;
+		staticDraw.textureSlot = drawRecord.textureSlot;
+		staticDraw.materialID = drawRecord.materialID;
+		m_staticDraws.push_back(staticDraw);
+		m_staticDrawChunks.push_back(m_recordChunk);
+		return;
+	}
+
+	// draws of the same mesh range can share an instanced draw call,
+	// so every LOD level of the range gets its own ID; draws start
+	// at the finest level until the first frame picks theirs
+	if (drawRecord.rangeID < 0)
+	{
+		for (int lod = 0; lod < ShapeMeshes::MESH_LOD_COUNT; lod++)
+		{
+			drawRecord.lodRangeIDs[lod] = FindMeshRange(ShapeMeshes::GetLODRange(drawRange, lod));
+		}
+		drawRecord.rangeID = drawRecord.lodRangeIDs[0];
+	}
+	drawRecord.lod = 0;
+
+	// the transform goes to the store at the same index
+	m_sceneTransforms.AddDraw(drawRecord.nodeID, m_recordModel, drawRange.bounds);
+	m_renderList.push_back(drawRecord);
+}
+
+/***********************************************************
+ *  BakeStaticGeometry()
+ *
+ *  This method is used for merging the static draws of the
+ *  recording into world space buffers, one triangle list per
+ *  texture, material and color, and adding a draw for each
+ *  of those lists to the render list. A scene file keeps the
+ *  bake in a cache next to it, which is used again as long
+ *  as the draws and meshes it was made from did not change.
+ *  With lightmaps the lightmap of the new geometry is baked
+ *  last. A scene cut into chunks bakes each chunk instead.
+ ***********************************************************/
+void SceneManager::BakeStaticGeometry()
+{
+	m_staticGeometry.Clear();
+	m_staticGeometryKey = 0;
+	if (m_worldChunks.IsEnabled() == true)
+	{
+		BakeChunkGeometry();
+		BakeLightmap();
+		return;
+	}
+	if (m_staticDraws.empty() == true)
+	{
+		BakeLightmap();
+		return;
+	}
+
+	uint64_t key = StaticGeometry::MakeKey(m_staticDraws, *m_basicMeshes, m_bLightmaps);
+	m_staticGeometryKey = key;
+
+	std::string cachePath;
+	if (m_sceneFile.IsLoaded() == true)
+	{
+		cachePath = m_sceneFilePath + ".bake";
+	}
+
+	bool bCached = (cachePath.empty() == false) && (0 == m_modelReloads) &&
+		(m_staticGeometry.LoadCache(cachePath.c_str(), key) == true);
+	if (bCached == false)
+	{
+		// the bake reads the vertices the GPU generated
+		m_basicMeshes->ReadBackProceduralMeshes();
+		m_staticGeometry.Bake(m_staticDraws, *m_basicMeshes, m_bLightmaps);
+		if (cachePath.empty() == false)
+		{
+			m_staticGeometry.SaveCache(cachePath.c_str(), key);
+		}
+	}
+
+	AddStaticGroups(m_staticGeometry);
+
+	std::cout << "Baked " << m_staticDraws.size() << " static draws into "
+		<< m_staticGeometry.GetGroupCount() << " groups"
+		<< ((bCached == true) ? " (cached)" : "") << std::endl;
+
+	BakeLightmap();
+}
+
+/***********************************************************
+ *  BakeChunkGeometry()
+ *
+ *  This method is used for baking the static draws of each
+ *  resident chunk into a bake of its own, cached next to
+ *  the scene file under the chunk's cell. A chunk keeps its
+ *  bake across recordings as long as its draws and meshes
+ *  did not change, so a chunk coming in only bakes itself
+ *  and one going out frees its pages. The chunks are not
+ *  lightmapped, as the lightmap atlas covers one bake.
+ ***********************************************************/
+void SceneManager::BakeChunkGeometry()
+{
+	std::vector<std::vector<StaticGeometry::STATIC_DRAW> > chunkDraws(m_worldChunks.GetChunkCount());
+	for (size_t i = 0; i < m_staticDraws.size(); i++)
+	{
+		if (m_staticDrawChunks[i] >= 0)
+		{
+			chunkDraws[m_staticDrawChunks[i]].push_back(m_staticDraws[i]);
+		}
+	}
+
+	int bakedChunks = 0;
+	int cachedChunks = 0;
+	for (size_t c = 0; c < chunkDraws.size(); c++)
+	{
+		WorldChunks::CHUNK& chunk = m_worldChunks.GetChunk(c);
+		if (chunkDraws[c].empty() == true)
+		{
+			delete chunk.pGeometry;
+			chunk.pGeometry = NULL;
+			chunk.geometryKey = 0;
+			continue;
+		}
+
+		uint64_t key = StaticGeometry::MakeKey(chunkDraws[c], *m_basicMeshes, false);
+		if ((NULL == chunk.pGeometry) || (chunk.geometryKey != key))
+		{
+			if (NULL == chunk.pGeometry)
+			{
+				chunk.pGeometry = new StaticGeometry();
+				chunk.pGeometry->SetBufferAllocator(&m_meshPages);
+			}
+			chunk.pGeometry->Clear();
+			chunk.geometryKey = key;
+
+			std::string cachePath = m_sceneFilePath + ".chunk" + std::to_string(chunk.cellX) +
+				"_" + std::to_string(chunk.cellZ) + ".bake";
+			if ((0 == m_modelReloads) && (chunk.pGeometry->LoadCache(cachePath.c_str(), key) == true))
+			{
+				cachedChunks++;
+			}
+			else
+			{
+				m_basicMeshes->ReadBackProceduralMeshes();
+				chunk.pGeometry->Bake(chunkDraws[c], *m_basicMeshes, false);
+				chunk.pGeometry->SaveCache(cachePath.c_str(), key);
+				bakedChunks++;
+			}
+		}
+		AddStaticGroups(*chunk.pGeometry);
+	}
+
+	if ((bakedChunks > 0) || (cachedChunks > 0))
+	{
+		std::cout << "Baked the static draws of " << bakedChunks << " chunks, " << cachedChunks
+			<< " cached" << std::endl;
+	}
+}
+
+/***********************************************************
+ *  AddStaticGroups()
+ *
+ *  This method is used for adding a draw for every group of
+ *  a bake to the render list. The groups are already in
+ *  world space and carry the UV scale.
+ ***********************************************************/
+void SceneManager::AddStaticGroups(const StaticGeometry& geometry)
+{
+	for (size_t i = 0; i < geometry.GetGroupCount(); i++)
+	{
+		const StaticGeometry::BAKED_GROUP& group = geometry.GetGroup(i);
+
+		DRAW_RECORD drawRecord;
+		drawRecord.range = geometry.GetGroupRange(i);
+		drawRecord.rangeID = FindMeshRange(drawRecord.range);
+		for (int lod = 0; lod < ShapeMeshes::MESH_LOD_COUNT; lod++)
+		{
+			drawRecord.lodRangeIDs[lod] = drawRecord.rangeID;
+		}
+		drawRecord.lod = 0;
+		drawRecord.color = group.color;
+		drawRecord.UVscale = glm::vec2(1.0f, 1.0f);
+		drawRecord.textureSlot = group.textureSlot;
+		drawRecord.materialID = group.materialID;
+		drawRecord.bTransparent = false;
+		drawRecord.nodeID = -1;
+		drawRecord.bStatic = true;
+
+		m_sceneTransforms.AddDraw(-1, glm::mat4(1.0f), drawRecord.range.bounds);
+		m_renderList.push_back(drawRecord);
+	}
+}
+
+/***********************************************************
+ *  FindStaticGeometry()
+ *
+ *  This method is used for finding the bake whose vertex
+ *  array a draw range reads, among the whole scene's, those
+ *  of the resident chunks and the merged prefab parts.
+ ***********************************************************/
+const StaticGeometry* SceneManager::FindStaticGeometry(GLuint vao) const
+{
+	if (0 == vao)
+	{
+		return(NULL);
+	}
+	if (vao == m_staticGeometry.GetVertexArray())
+	{
+		return(&m_staticGeometry);
+	}
+	for (size_t i = 0; i < m_prefabs.size(); i++)
+	{
+		if ((NULL != m_prefabs[i].pGeometry) && (vao == m_prefabs[i].pGeometry->GetVertexArray()))
+		{
+			return(m_prefabs[i].pGeometry);
+		}
+	}
+	for (size_t i = 0; i < m_worldChunks.GetChunkCount(); i++)
+	{
+		const StaticGeometry* pGeometry = m_worldChunks.GetChunk(i).pGeometry;
+		if ((NULL != pGeometry) && (vao == pGeometry->GetVertexArray()))
+		{
+			return(pGeometry);
+		}
+	}
+	return(NULL);
+}
+
+/***********************************************************
+ *  BakeLightmap()
+ *
+ *  This method is used for starting the bake of the diffuse
+ *  lighting of the static geometry on the worker thread. The
+ *  lights are handed over with the type the shaders give
+ *  them, and the materials as the material buffer holds them.
+ *  A bake of the same geometry and lighting is kept, and a
+ *  scene file keeps the lightmap in a cache next to it, so
+ *  only new lighting is baked again. Until the new lightmap
+ *  is taken, the static geometry is lit in real time.
+ ***********************************************************/
+void SceneManager::BakeLightmap()
+{
+	if ((m_bLightmaps == false) || (m_bUseLighting == false) ||
+		(m_staticGeometry.HasLightmapUVs() == false))
+	{
+		m_pLightmapBaker->Finish();
+		m_lightmapKey = 0;
+		m_bLightmapReady = false;
+		return;
+	}
+
+	std::vector<LightmapBaker::BAKE_LIGHT> lights(m_lights.size());
+	for (size_t i = 0; i < m_lights.size(); i++)
+	{
+		lights[i].position = m_lights[i].position;
+		lights[i].ambientColor = m_lights[i].ambientColor;
+		lights[i].radius = m_lights[i].radius;
+		lights[i].bDirect = (GetLightType(m_lights[i]) != LIGHT_TYPE_AMBIENT);
+	}
+	// materials past the material buffer read as zero, as they do
+	// in the shaders
+	std::vector<LightmapBaker::BAKE_MATERIAL> materials(MAX_MATERIALS);
+	for (size_t i = 0; i < materials.size(); i++)
+	{
+		materials[i].ambientColor = glm::vec3(0.0f);
+		materials[i].diffuseColor = glm::vec3(0.0f);
+		if (i < m_objectMaterials.size())
+		{
+			materials[i].ambientColor = m_objectMaterials[i].ambientColor * m_objectMaterials[i].ambientStrength;
+			materials[i].diffuseColor = m_objectMaterials[i].diffuseColor;
+		}
+	}
+
+	uint64_t key = LightmapBaker::MakeKey(m_staticGeometryKey, lights, materials, m_bLightmapOcclusion);
+	if (key == m_lightmapKey)
+	{
+		return;
+	}
+	m_pLightmapBaker->Finish();
+	m_lightmapKey = key;
+	m_bLightmapReady = false;
+
+	std::string cachePath;
+	if (m_sceneFile.IsLoaded() == true)
+	{
+		cachePath = m_sceneFilePath + ".lightmap";
+	}
+	LightmapBaker::LIGHTMAP lightmap;
+	if ((cachePath.empty() == false) &&
+		(LightmapBaker::LoadCache(cachePath.c_str(), key, lightmap) == true) &&
+		(lightmap.width == m_staticGeometry.GetLightmapWidth()) &&
+		(lightmap.height == m_staticGeometry.GetLightmapHeight()))
+	{
+		UploadLightmap(lightmap);
+		std::cout << "Loaded the " << lightmap.width << "x" << lightmap.height
+			<< " lightmap (cached)" << std::endl;
+		return;
+	}
+
+	LightmapBaker::BAKE_INPUT input;
+	input.vertices = m_staticGeometry.GetVertices();
+	input.lightmapUVs = m_staticGeometry.GetLightmapUVs();
+	input.indices = m_staticGeometry.GetIndices();
+	input.triangleMaterials.assign(input.indices.size() / 3, 0);
+	for (size_t i = 0; i < m_staticGeometry.GetGroupCount(); i++)
+	{
+		const StaticGeometry::BAKED_GROUP& group = m_staticGeometry.GetGroup(i);
+		int materialID = ((group.materialID >= 0) && (group.materialID < MAX_MATERIALS)) ? group.materialID : 0;
+		for (GLsizei index = 0; index < group.indexCount; index += 3)
+		{
+			input.triangleMaterials[(group.firstIndex + index) / 3] = materialID;
+		}
+	}
+	input.materials.swap(materials);
+	input.lights.swap(lights);
+	input.width = m_staticGeometry.GetLightmapWidth();
+	input.height = m_staticGeometry.GetLightmapHeight();
+	input.bAmbientOcclusion = m_bLightmapOcclusion;
+	input.key = key;
+	m_pLightmapBaker->Start(input);
+}
+
+/***********************************************************
+ *  UpdateLightmap()
+ *
+ *  This method is used for baking the lightmap again when
+ *  the lights changed and for taking the lightmap of a
+ *  finished bake, which is saved to the cache of a scene
+ *  file. A bake for lighting that changed again since is
+ *  dropped.
+ ***********************************************************/
+void SceneManager::UpdateLightmap()
+{
+	if (m_bLightmaps == false)
+	{
+		return;
+	}
+
+	if (m_bLightsDirty == true)
+	{
+		BakeLightmap();
+	}
+
+	LightmapBaker::LIGHTMAP lightmap;
+	if ((m_pLightmapBaker->TakeResult(lightmap) == false) || (lightmap.key != m_lightmapKey))
+	{
+		return;
+	}
+
+	UploadLightmap(lightmap);
+	std::cout << "Baked the " << lightmap.width << "x" << lightmap.height << " lightmap" << std::endl;
+	if (m_sceneFile.IsLoaded() == true)
+	{
+		LightmapBaker::SaveCache((m_sceneFilePath + ".lightmap").c_str(), lightmap);
+	}
+}
+
+/***********************************************************
+ *  UploadLightmap()
+ *
+ *  This method is used for copying a lightmap into the
+ *  half float lightmap texture, which keeps lighting above
+ *  one, and creating the texture when the atlas size
+ *  changed. It is filtered bilinearly without mipmaps, as
+ *  the charts are padded for the one texel lookups only.
+ ***********************************************************/
+void SceneManager::UploadLightmap(const LightmapBaker::LIGHTMAP& lightmap)
+{
+	if ((lightmap.width <= 0) || (lightmap.height <= 0) || (lightmap.texels.empty() == true))
+	{
+		return;
+	}
+
+	GLint width = 0;
+	GLint height = 0;
+	m_pShaderManager->SetActiveTextureUnit(LIGHTMAP_TEXTURE_UNIT);
+	if (0 != m_lightmapTexture)
+	{
+		m_pShaderManager->BindTexture(LIGHTMAP_TEXTURE_UNIT, m_lightmapTexture);
+		glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &width);
+		glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &height);
+	}
+	if ((width != lightmap.width) || (height != lightmap.height))
+	{
+		if (0 != m_lightmapTexture)
+		{
+			m_pShaderManager->BindTexture(LIGHTMAP_TEXTURE_UNIT, 0);
+			GPUMemory::DeleteTextures(1, &m_lightmapTexture);
+		}
+		glGenTextures(1, &m_lightmapTexture);
+		m_pShaderManager->BindTexture(LIGHTMAP_TEXTURE_UNIT, m_lightmapTexture);
+		glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA16F, lightmap.width, lightmap.height);
+		GPUMemory::TrackTexture(m_lightmapTexture, GL_RGBA16F, lightmap.width, lightmap.height, 1, 1,
+			GPUMemory::CATEGORY_TEXTURE, "lightmap");
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	}
+	glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, lightmap.width, lightmap.height, GL_RGB, GL_FLOAT,
+		&lightmap.texels[0]);
+
+	m_bLightmapReady = true;
+}
+
+/***********************************************************
+ *  FindMeshRange()
+ *
+ *  This method is used for getting the index of a mesh
+ *  range in m_meshRanges, adding it when no recorded draw
+ *  used it yet.
+ ***********************************************************/
+int SceneManager::FindMeshRange(const ShapeMeshes::DRAW_RANGE& drawRange)
+{
+	for (size_t i = 0; i < m_meshRanges.size(); i++)
+	{
+		if ((m_meshRanges[i].vao == drawRange.vao) && (m_meshRanges[i].mode == drawRange.mode) &&
+			(m_meshRanges[i].first == drawRange.first) && (m_meshRanges[i].count == drawRange.count) &&
+			(m_meshRanges[i].bIndexed == drawRange.bIndexed))
+		{
+			return((int)i);
+		}
+	}
+
+	m_meshRanges.push_back(drawRange);
+	return((int)m_meshRanges.size() - 1);
+}
+
+/***********************************************************
+ *  MakeDrawKey()
+ *
+ *  This method is used for packing the pass, shader program,
+ *  texture, mesh range, material and camera distance of a
+ *  recorded draw into a 64 bit key, so sorting the keys
+ *  groups draws that share state.
+ ***********************************************************/
+uint64_t SceneManager::MakeDrawKey(uint32_t drawIndex) const
+{
+	const DRAW_RECORD& drawRecord = m_renderList[drawIndex];
+
+	const uint64_t textureKey = (uint64_t)(drawRecord.textureSlot + 1);
+	const uint64_t rangeKey = (uint64_t)drawRecord.rangeID & ((1 << DRAW_KEY_RANGE_BITS) - 1);
+
+	uint64_t stateKey = (uint64_t)GetDrawPermutation(drawRecord);
+	if (m_pTextureTable->IsBindless() == true)
+	{
+		stateKey = (stateKey << DRAW_KEY_TEXTURE_BITS) | textureKey;
+		stateKey = (stateKey << DRAW_KEY_RANGE_BITS) | rangeKey;
+	}
+	else
+	{
+		// one batch draws a mesh with every texture it is used with
+		stateKey = (stateKey << DRAW_KEY_RANGE_BITS) | rangeKey;
+		stateKey = (stateKey << DRAW_KEY_TEXTURE_BITS) | textureKey;
+	}
+	stateKey = (stateKey << DRAW_KEY_MATERIAL_BITS) | (uint64_t)drawRecord.materialID;
+
+	// distance from the camera to the origin of the draw
+	glm::vec3 position = glm::vec3(m_sceneTransforms.GetDrawModel(drawIndex)[3]);
+	uint64_t depth = QuantizeDepth(glm::length(position - m_viewPosition));
+
+	if ((drawRecord.bTransparent == true) && (m_bOrderIndependentTransparency == true))
+	{
+		// blended independently of order, so only state matters
+		return(((uint64_t)1 << DRAW_KEY_PASS_SHIFT) | (stateKey << DRAW_KEY_DEPTH_BITS));
+	}
+	if (drawRecord.bTransparent == true)
+	{
+		// farthest first, inverting the depth bits
+		uint64_t backToFront = ((uint64_t)1 << DRAW_KEY_DEPTH_BITS) - 1 - depth;
+		return(((uint64_t)1 << DRAW_KEY_PASS_SHIFT) |
+			(backToFront << DRAW_KEY_STATE_BITS) | stateKey);
+	}
+
+	// the objects under an occlusion query follow the other opaque
+	// draws, whose depth their boxes are tested against
+	uint64_t queryKey = 0;
+	if ((drawIndex < m_drawQueryGroups.size()) && (m_drawQueryGroups[drawIndex] >= 0))
+	{
+		queryKey = (uint64_t)1 << DRAW_KEY_QUERY_SHIFT;
+	}
+	return(queryKey | (stateKey << DRAW_KEY_DEPTH_BITS) | depth);
+}
+
+/***********************************************************
+ *  SetReverseZ()
+ *
+ *  This method is used for switching the depth convention
+ *  of the frames. Reverse-Z clips the depth to 0..1 with
+ *  glClipControl(), so the projection maps the near plane
+ *  to 1 without the precision near 1 being folded away,
+ *  clears the depth to 0, the farthest, and keeps the
+ *  fragments of the larger depth. The occlusion culling
+ *  then looks for the smallest depth as the farthest one.
+ ***********************************************************/
+void SceneManager::SetReverseZ(bool bEnable)
+{
+	if (bEnable == m_bReverseZ)
+	{
+		return;
+	}
+	m_bReverseZ = bEnable;
+
+	if (bEnable == true)
+	{
+		glClipControl(GL_LOWER_LEFT, GL_ZERO_TO_ONE);
+		glClearDepth(0.0);
+	}
+	else
+	{
+		glClipControl(GL_LOWER_LEFT, GL_NEGATIVE_ONE_TO_ONE);
+		glClearDepth(1.0);
+	}
+	// the depth functions of the state objects turn around with it
+	m_pRenderStates->SetReverseZ(bEnable);
+	m_pRenderStates->ApplyDepthState(m_states.depthWrite);
+	m_pOcclusionCuller->SetReverseDepth(bEnable);
+}
+
+/***********************************************************
+ *  SetViewMatrices()
+ *
+ *  This method is used for setting the camera matrices of
+ *  the frame. While the camera rests they are the same as
+ *  the last ones, and the product and the six frustum
+ *  planes taken from its rows are kept.
+ ***********************************************************/
+void SceneManager::SetViewMatrices(const glm::mat4& view, const glm::mat4& projection)
+{
+	if ((m_bHasViewProjection == true) && (view == m_viewMatrix) && (projection == m_projectionMatrix))
+	{
+		return;
+	}
+
+	m_viewMatrix = view;
+	m_projectionMatrix = projection;
+	m_viewProjection = projection * view;
+	m_bHasViewProjection = true;
+	ExtractFrustumPlanes(m_viewProjection, m_frustumPlanes);
+}
+
+/***********************************************************
+ *  CullRenderList()
+ *
+ *  This method is used for marking the draws whose bounding
+ *  box lies outside of the view frustum. The scene hierarchy
+ *  is walked with the six planes SetViewMatrices() took
+ *  from the view-projection matrix, so whole groups of
+ *  draws outside of the view are rejected with one test.
+ ***********************************************************/
+void SceneManager::CullRenderList()
+{
+	const size_t drawCount = m_renderList.size();
+
+	if ((m_bHasViewProjection == false) || (drawCount == 0))
+	{
+		m_drawVisible.assign(drawCount, 1);
+		return;
+	}
+
+	m_visibleDraws.clear();
+	m_sceneBVH.QueryFrustum(m_frustumPlanes, m_visibleDraws, m_pJobSystem);
+
+	m_drawVisible.assign(drawCount, 0);
+	for (size_t i = 0; i < m_visibleDraws.size(); i++)
+	{
+		m_drawVisible[m_visibleDraws[i]] = 1;
+	}
+	m_cullStats.drawsTested += drawCount;
+	m_cullStats.drawsCulled += drawCount - m_visibleDraws.size();
+
+	// a probe holds what the shiny surfaces reflect, not the
+	// surfaces themselves
+	if (m_bCapturingProbe == true)
+	{
+		for (size_t i = 0; i < m_visibleDraws.size(); i++)
+		{
+			if (IsReflectiveDraw(m_renderList[m_visibleDraws[i]]) == true)
+			{
+				m_drawVisible[m_visibleDraws[i]] = 0;
+			}
+		}
+	}
+}
+
+/***********************************************************
+ *  SelectDrawLODs()
+ *
+ *  This method is used for picking the LOD level of every
+ *  visible draw from the diameter of its bounding sphere on
+ *  screen, shrunk by the LOD bias. A draw only moves a level
+ *  when its size is past the threshold by the hysteresis
+ *  band, and the batches are rebuilt when any draw changed
+ *  its level.
+ ***********************************************************/
+void SceneManager::SelectDrawLODs()
+{
+	if (m_bHasViewProjection == false)
+	{
+		return;
+	}
+
+	// every visible draw is its own record, so the ranges of
+	// draws are picked on the threads of the job system
+	const float pixelScale = GetPixelScale() * glm::exp2(-m_lodBias);
+	std::atomic<bool> bLODChanged(false);
+	ParallelFor(m_visibleDraws.size(), PARALLEL_MIN_DRAWS, [this, pixelScale, &bLODChanged](size_t first, size_t end)
+		{
+			for (size_t i = first; i < end; i++)
+			{
+				DRAW_RECORD& drawRecord = m_renderList[m_visibleDraws[i]];
+				if (drawRecord.range.lodLevels <= 1)
+				{
+					continue;
+				}
+
+				int draw = (int)m_visibleDraws[i];
+				int lod = drawRecord.lod;
+				const ShapeMeshes::DRAW_RANGE& finestRange = m_meshRanges[drawRecord.lodRangeIDs[0]];
+				if (finestRange.lods[finestRange.lodLevels - 1].error > 0.0f)
+				{
+					// simplified levels by how far their surface is off
+					// the finest on screen
+					while ((lod > 0) &&
+						(ProjectLODErrorPixels(draw, lod, pixelScale) > LOD_ERROR_PIXELS * (1.0f + LOD_HYSTERESIS)))
+					{
+						lod--;
+					}
+					while ((lod + 1 < drawRecord.range.lodLevels) &&
+						(ProjectLODErrorPixels(draw, lod + 1, pixelScale) < LOD_ERROR_PIXELS * (1.0f - LOD_HYSTERESIS)))
+					{
+						lod++;
+					}
+				}
+				else
+				{
+					// the shapes by their size on screen
+					float pixels = ProjectDrawPixels(draw, pixelScale);
+					while ((lod > 0) && (pixels > LOD_SWITCH_PIXELS[lod - 1] * (1.0f + LOD_HYSTERESIS)))
+					{
+						lod--;
+					}
+					while ((lod + 1 < drawRecord.range.lodLevels) &&
+						(pixels < LOD_SWITCH_PIXELS[lod] * (1.0f - LOD_HYSTERESIS)))
+					{
+						lod++;
+					}
+				}
+
+				if (lod != drawRecord.lod)
+				{
+					drawRecord.lod = lod;
+					drawRecord.rangeID = drawRecord.lodRangeIDs[lod];
+					drawRecord.range = m_meshRanges[drawRecord.rangeID];
+					bLODChanged = true;
+				}
+			}
+		});
+	if (bLODChanged == true)
+	{
+		m_bInstanceDataDirty = true;
+	}
+}
+
+/***********************************************************
+ *  GetPixelScale()
+ *
+ *  This method is used for getting the pixels one world unit
+ *  covers on screen, at distance 1 for a perspective
+ *  projection and at any distance for an orthographic one.
+ ***********************************************************/
+float SceneManager::GetPixelScale() const
+{
+	GLint viewport[4] = { 0, 0, 0, 0 };
+	glGetIntegerv(GL_VIEWPORT, viewport);
+
+	return(m_projectionMatrix[1][1] * 0.5f * (float)viewport[3]);
+}
+
+/***********************************************************
+ *  ProjectDrawPixels()
+ *
+ *  This method is used for getting the diameter on screen,
+ *  in pixels, of the bounding sphere of a draw.
+ ***********************************************************/
+float SceneManager::ProjectDrawPixels(int draw, float pixelScale) const
+{
+	return(ProjectDrawPixels(draw, pixelScale, m_viewPosition));
+}
+
+/***********************************************************
+ *  ProjectDrawPixels()
+ *
+ *  This method is used for getting the diameter on screen,
+ *  in pixels, of the bounding sphere of a draw seen from
+ *  another camera position, like one it is heading to.
+ ***********************************************************/
+float SceneManager::ProjectDrawPixels(int draw, float pixelScale, const glm::vec3& viewPosition) const
+{
+	const SceneBVH::AABB& worldBounds = m_sceneTransforms.GetDrawBounds(draw);
+	glm::vec3 center = (worldBounds.minXYZ + worldBounds.maxXYZ) * 0.5f;
+	float radius = glm::length(worldBounds.maxXYZ - center);
+	float pixels = 2.0f * radius * pixelScale;
+	if (m_projectionMatrix[3][3] == 0.0f)
+	{
+		float distance = glm::length(center - viewPosition);
+		pixels = (distance > radius) ? (pixels / distance) : FLT_MAX;
+	}
+	return(pixels);
+}
+
+/***********************************************************
+ *  ProjectLODErrorPixels()
+ *
+ *  This method is used for getting the error of an LOD
+ *  level of a draw on screen, in pixels: the distance the
+ *  level moves the surface off the finest, grown by the
+ *  largest scale of the draw, at the distance of the
+ *  center of its bounds. A camera inside the bounding
+ *  sphere sees every error as too large.
+ ***********************************************************/
+float SceneManager::ProjectLODErrorPixels(int draw, int lod, float pixelScale) const
+{
+	const ShapeMeshes::DRAW_RANGE& finestRange = m_meshRanges[m_renderList[draw].lodRangeIDs[0]];
+	lod = glm::clamp(lod, 0, finestRange.lodLevels - 1);
+	float pixels = finestRange.lods[lod].error * GetMaxAxisScale(m_sceneTransforms.GetDrawModel(draw)) * pixelScale;
+	if (m_projectionMatrix[3][3] == 0.0f)
+	{
+		const SceneBVH::AABB& worldBounds = m_sceneTransforms.GetDrawBounds(draw);
+		glm::vec3 center = (worldBounds.minXYZ + worldBounds.maxXYZ) * 0.5f;
+		float radius = glm::length(worldBounds.maxXYZ - center);
+		float distance = glm::length(center - m_viewPosition);
+		pixels = (distance > radius) ? (pixels / distance) : FLT_MAX;
+	}
+	return(pixels);
+}
+
+/***********************************************************
+ *  UpdateTextureResidency()
+ *
+ *  This method is used for telling the texture residency
+ *  how large each visible textured draw is on screen, and
+ *  those about to be, then swapping in the textures it made
+ *  smaller or larger. The streamer gets the same sizes, for
+ *  the placeholders still waiting for their image. Only
+ *  bindless handles can be remade for a single texture; the
+ *  texture array fallback holds copies of every texture, so
+ *  without them the levels are only counted.
+ ***********************************************************/
+void SceneManager::UpdateTextureResidency()
+{
+	if (m_bHasViewProjection == true)
+	{
+		const float pixelScale = GetPixelScale();
+		for (size_t i = 0; i < m_visibleDraws.size(); i++)
+		{
+			const DRAW_RECORD& drawRecord = m_renderList[m_visibleDraws[i]];
+			if (drawRecord.textureSlot >= 0)
+			{
+				float pixels = ProjectDrawPixels(m_visibleDraws[i], pixelScale);
+				m_pTextureResidency->MarkDrawn(drawRecord.textureSlot, pixels,
+					glm::max(drawRecord.UVscale.x, drawRecord.UVscale.y));
+				m_pTextureStreamer->SetCoverage(drawRecord.textureSlot, pixels);
+			}
+		}
+		PrefetchPredictedTextures(pixelScale);
+	}
+
+	std::vector<TextureResidency::REPLACED_TEXTURE> replaced;
+	m_pTextureResidency->Update(m_pTextureTable->IsBindless(), replaced);
+	if (replaced.empty() == true)
+	{
+		return;
+	}
+
+	std::vector<GLuint> releasedTextures;
+	for (size_t i = 0; i < replaced.size(); i++)
+	{
+		releasedTextures.push_back(m_textureIDs[replaced[i].slot].ID);
+		m_textureIDs[replaced[i].slot].ID = replaced[i].texture;
+		m_pResources->SetObject(m_textureIDs[replaced[i].slot].resource, MakeResourceObject(replaced[i].texture, NULL));
+		GPUMemory::SetOwner(GPUMemory::KIND_TEXTURE, replaced[i].texture, m_textureIDs[replaced[i].slot].tag.c_str());
+	}
+
+	std::vector<GLuint> textures(m_textureIDs.size());
+	for (size_t i = 0; i < m_textureIDs.size(); i++)
+	{
+		textures[i] = m_textureIDs[i].ID;
+	}
+	if (m_pTextureTable->Build(textures) == false)
+	{
+		std::cout << "Could not build the texture table, textured draws will sample nothing" << std::endl;
+	}
+
+	// the rebuilt table released the handles of the replaced textures
+	GPUMemory::DeleteTextures((GLsizei)releasedTextures.size(), &releasedTextures[0]);
+}
+
+/***********************************************************
+ *  PrefetchPredictedTextures()
+ *
+ *  This method is used for marking the textures of the
+ *  draws the camera is about to see. The turn and move of
+ *  the camera over the last frame are followed ahead to the
+ *  frustum it will have PREDICT_FRAMES frames later, and to
+ *  the one halfway there, and the draws the scene hierarchy
+ *  finds in them outside the current view are marked with
+ *  the size they will have from there. A camera standing
+ *  still sees nothing new, and a cut is not followed.
+ ***********************************************************/
+void SceneManager::PrefetchPredictedTextures(float pixelScale)
+{
+	glm::mat4 cameraWorld = glm::inverse(m_viewMatrix);
+	glm::vec3 position = glm::vec3(cameraWorld[3]);
+	glm::quat orientation = glm::normalize(glm::quat_cast(glm::mat3(cameraWorld)));
+
+	bool bHadLastCamera = m_bHasLastCamera;
+	glm::vec3 move = position - m_lastCameraPosition;
+	glm::quat turn = orientation * glm::inverse(m_lastCameraOrientation);
+	m_lastCameraPosition = position;
+	m_lastCameraOrientation = orientation;
+	m_bHasLastCamera = true;
+	if (bHadLastCamera == false)
+	{
+		return;
+	}
+
+	// the shorter way around
+	if (turn.w < 0.0f)
+	{
+		turn = -turn;
+	}
+	float turnAngle = glm::angle(turn);
+	float moveDistance = glm::length(move);
+	if ((turnAngle > MAX_PREDICT_TURN) || (moveDistance > MAX_PREDICT_MOVE) ||
+		((turnAngle < MIN_PREDICT_TURN) && (moveDistance < MIN_PREDICT_MOVE)))
+	{
+		return;
+	}
+	glm::vec3 turnAxis = (turnAngle >= MIN_PREDICT_TURN) ? glm::axis(turn) : glm::vec3(0.0f, 1.0f, 0.0f);
+
+	const float predictSteps[2] = { PREDICT_FRAMES * 0.5f, PREDICT_FRAMES };
+	for (int step = 0; step < 2; step++)
+	{
+		float frames = predictSteps[step];
+		glm::vec3 predictedPosition = position + move * frames;
+		glm::quat predictedOrientation = glm::angleAxis(turnAngle * frames, turnAxis) * orientation;
+		glm::mat4 predictedView = glm::inverse(glm::translate(predictedPosition) * glm::mat4_cast(predictedOrientation));
+
+		glm::vec4 planes[6];
+		ExtractFrustumPlanes(m_projectionMatrix * predictedView, planes);
+		m_predictedDraws.clear();
+		m_sceneBVH.QueryFrustum(planes, m_predictedDraws, m_pJobSystem);
+		for (size_t i = 0; i < m_predictedDraws.size(); i++)
+		{
+			uint32_t draw = m_predictedDraws[i];
+			const DRAW_RECORD& drawRecord = m_renderList[draw];
+			if ((drawRecord.textureSlot < 0) || ((draw < m_drawVisible.size()) && (m_drawVisible[draw] != 0)))
+			{
+				continue;
+			}
+			float pixels = ProjectDrawPixels((int)draw, pixelScale, predictedPosition);
+			m_pTextureResidency->MarkPredicted(drawRecord.textureSlot, pixels,
+				glm::max(drawRecord.UVscale.x, drawRecord.UVscale.y));
+			m_pTextureStreamer->SetCoverage(drawRecord.textureSlot, pixels);
+		}
+	}
+}
+
+/***********************************************************
+ *  RaycastScene()
+ *
+ *  This method is used for picking the render list draw
+ *  whose world bounds a ray enters first. The direction
+ *  does not need to be normalized, the hit distance is in
+ *  multiples of it.
+ ***********************************************************/
+int SceneManager::RaycastScene(
+	const glm::vec3& origin,
+	const glm::vec3& direction,
+	float& hitDistance) const
+{
+	return(m_sceneBVH.Raycast(origin, direction, FLT_MAX, hitDistance));
+}
+
+/***********************************************************
+ *  QueryDrawsInBox()
+ *
+ *  This method is used for collecting the render list draws
+ *  whose world bounds overlap a box, so passes like shadow
+ *  rendering only visit the draws inside their volume.
+ ***********************************************************/
+void SceneManager::QueryDrawsInBox(
+	const SceneBVH::AABB& box,
+	std::vector<uint32_t>& drawIndexes) const
+{
+	m_sceneBVH.QueryBox(box, drawIndexes);
+}
+
+/***********************************************************
+ *  QueryDrawsInSphere()
+ *
+ *  This method is used for collecting the render list draws
+ *  whose world bounds overlap a sphere. The box around the
+ *  sphere finds the candidates and the distance from the
+ *  center to each draw box drops the ones in its corners.
+ ***********************************************************/
+void SceneManager::QueryDrawsInSphere(
+	const glm::vec3& center,
+	float radius,
+	std::vector<uint32_t>& drawIndexes) const
+{
+	SceneBVH::AABB box;
+	box.minXYZ = center - glm::vec3(radius);
+	box.maxXYZ = center + glm::vec3(radius);
+
+	size_t first = drawIndexes.size();
+	m_sceneBVH.QueryBox(box, drawIndexes);
+
+	size_t kept = first;
+	for (size_t i = first; i < drawIndexes.size(); i++)
+	{
+		const SceneBVH::AABB& bounds = m_sceneTransforms.GetDrawBounds(drawIndexes[i]);
+		glm::vec3 nearest = glm::clamp(center, bounds.minXYZ, bounds.maxXYZ);
+		glm::vec3 offset = nearest - center;
+		if (glm::dot(offset, offset) <= radius * radius)
+		{
+			drawIndexes[kept++] = drawIndexes[i];
+		}
+	}
+	drawIndexes.resize(kept);
+}
+
+/***********************************************************
+ *  RaycastSceneTriangles()
+ *
+ *  This method is used for finding the surface a ray hits,
+ *  for tools that place objects on others. Unlike the box
+ *  of RaycastScene(), a ray passing through the empty
+ *  corner of a draw's bounds goes on to what is behind it.
+ ***********************************************************/
+bool SceneManager::RaycastSceneTriangles(const RAY_QUERY& ray, RAY_HIT& hit)
+{
+	// the CPU copies of the meshes the GPU generated are read once
+	m_basicMeshes->ReadBackProceduralMeshes();
+
+	std::vector<int> stack;
+	CastSceneRay(ray, stack, hit);
+	return(hit.drawIndex >= 0);
+}
+
+/***********************************************************
+ *  RaycastSceneBatch()
+ *
+ *  This method is used for casting many rays at once, as
+ *  the layout tools do every frame. The rays are split
+ *  between the threads of the job system, each job with
+ *  its own traversal stack, and only read the scene.
+ ***********************************************************/
+void SceneManager::RaycastSceneBatch(const std::vector<RAY_QUERY>& rays, std::vector<RAY_HIT>& hits)
+{
+	m_basicMeshes->ReadBackProceduralMeshes();
+
+	hits.resize(rays.size());
+	ParallelFor(rays.size(), PARALLEL_MIN_RAYS, [this, &rays, &hits](size_t first, size_t end)
+	{
+		std::vector<int> stack;
+		for (size_t i = first; i < end; i++)
+		{
+			CastSceneRay(rays[i], stack, hits[i]);
+		}
+	});
+}
+
+/***********************************************************
+ *  CastSceneRay()
+ *
+ *  This method is used for casting one ray through the
+ *  scene BVH, testing the triangles of every draw whose
+ *  box it enters before the nearest hit so far.
+ ***********************************************************/
+void SceneManager::CastSceneRay(const RAY_QUERY& ray, std::vector<int>& stack, RAY_HIT& hit) const
+{
+	glm::vec3 hitNormal(0.0f);
+	float hitDistance = 0.0f;
+	int drawIndex = m_sceneBVH.Raycast(ray.origin, ray.direction, ray.maxDistance,
+		[this, &ray, &hitNormal](uint32_t objectIndex, float maxDistance, float& distance)
+		{
+			glm::vec3 normal;
+			if (IntersectDrawTriangles(objectIndex, ray.origin, ray.direction, maxDistance, distance, normal) == false)
+			{
+				return(false);
+			}
+			hitNormal = normal;
+			return(true);
+		},
+		stack, hitDistance);
+
+	hit.drawIndex = drawIndex;
+	hit.distance = 0.0f;
+	hit.position = ray.origin;
+	hit.normal = glm::vec3(0.0f);
+	if (drawIndex >= 0)
+	{
+		hit.distance = hitDistance;
+		hit.position = ray.origin + ray.direction * hitDistance;
+		hit.normal = hitNormal;
+	}
+}
+
+/***********************************************************
+ *  IntersectDrawTriangles()
+ *
+ *  This method is used for testing a ray against every
+ *  triangle of a draw's finest LOD level. The ray is moved
+ *  into the space of the mesh instead of the triangles into
+ *  the world, and a distance along the moved direction is
+ *  the same distance along the world one.
+ ***********************************************************/
+bool SceneManager::IntersectDrawTriangles(
+	uint32_t drawIndex,
+	const glm::vec3& origin,
+	const glm::vec3& direction,
+	float maxDistance,
+	float& hitDistance,
+	glm::vec3& hitNormal) const
+{
+	const ShapeMeshes::DRAW_RANGE& range = m_meshRanges[m_renderList[drawIndex].lodRangeIDs[0]];
+	if ((StaticGeometry::CanBake(range) == false) || (range.count < 3))
+	{
+		return(false);
+	}
+
+	glm::mat4 inverseModel = glm::inverse(m_sceneTransforms.GetDrawModel(drawIndex));
+	glm::vec3 localOrigin = glm::vec3(inverseModel * glm::vec4(origin, 1.0f));
+	glm::vec3 localDirection = glm::mat3(inverseModel) * direction;
+
+	// the baked static groups index the merged buffers, whose
+	// indices may start past the beginning of a shared page
+	const StaticGeometry* pStaticGeometry = FindStaticGeometry(range.vao);
+	const std::vector<GLuint>& arenaIndices = (NULL != pStaticGeometry) ?
+		pStaticGeometry->GetIndices() : m_basicMeshes->GetArenaIndices();
+	const std::vector<GLfloat>& arenaVertices = (NULL != pStaticGeometry) ?
+		pStaticGeometry->GetVertices() : m_basicMeshes->GetArenaVertices(m_basicMeshes->IsCompactVAO(range.vao));
+	GLint firstIndex = range.first - ((NULL != pStaticGeometry) ? pStaticGeometry->GetIndexBase() : 0);
+	const int VERTEX_FLOATS = ShapeMeshes::VERTEX_FLOATS;
+
+	// position of the arena vertex behind an element of the range
+	auto elementPosition = [&](GLsizei element)
+	{
+		GLuint vertex = (range.bIndexed == true) ?
+			arenaIndices[firstIndex + element] + range.baseVertex :
+			(GLuint)(range.first + element);
+		const GLfloat* pVertex = &arenaVertices[(size_t)vertex * VERTEX_FLOATS];
+		return(glm::vec3(pVertex[0], pVertex[1], pVertex[2]));
+	};
+
+	bool bHit = false;
+	float closest = maxDistance;
+	glm::vec3 localNormal(0.0f);
+	GLsizei step = (range.mode == GL_TRIANGLES) ? 3 : 1;
+	for (GLsizei element = 2; element < range.count; element += step)
+	{
+		glm::vec3 vertex0 = elementPosition((range.mode == GL_TRIANGLE_FAN) ? 0 : element - 2);
+		glm::vec3 vertex1 = elementPosition(element - 1);
+		glm::vec3 vertex2 = elementPosition(element);
+
+		float distance = 0.0f;
+		if ((IntersectRayTriangle(localOrigin, localDirection, vertex0, vertex1, vertex2, distance) == true) &&
+			(distance <= closest))
+		{
+			bHit = true;
+			closest = distance;
+			localNormal = glm::cross(vertex1 - vertex0, vertex2 - vertex0);
+		}
+	}
+
+	if (bHit == false)
+	{
+		return(false);
+	}
+
+	// the winding does not matter, the normal faces the ray
+	hitNormal = glm::normalize(m_sceneTransforms.GetDrawNormalMatrix(drawIndex) * localNormal);
+	if (glm::dot(hitNormal, direction) > 0.0f)
+	{
+		hitNormal = -hitNormal;
+	}
+	hitDistance = closest;
+	return(true);
+}
+
+/***********************************************************
+ *  GetDrawSceneNode()
+ *
+ *  This method is used for getting the scene node a render
+ *  list draw is placed by, so a picked draw can be moved
+ *  with its whole object.
+ ***********************************************************/
+int SceneManager::GetDrawSceneNode(int drawIndex) const
+{
+	if ((drawIndex < 0) || (drawIndex >= (int)m_renderList.size()))
+	{
+		return(-1);
+	}
+
+	return(m_renderList[drawIndex].nodeID);
+}
+
+/***********************************************************
+ *  TakePickedDraw()
+ *
+ *  This method is used for mapping the ID the last pick
+ *  read back to the render list draw it was drawn for. The
+ *  ID is the submission index of the instance, so the order
+ *  of the frame the pick was drawn in is what it is looked
+ *  up in.
+ ***********************************************************/
+bool SceneManager::TakePickedDraw(int& drawIndex)
+{
+	uint32_t objectID = 0;
+	if (m_pObjectPicker->TakeResult(objectID) == false)
+	{
+		return(false);
+	}
+
+	drawIndex = -1;
+	if ((0 != objectID) && (objectID <= m_pickInstanceOrder.size()))
+	{
+		drawIndex = (int)m_pickInstanceOrder[objectID - 1];
+	}
+	return(true);
+}
+
+/***********************************************************
+ *  SortRenderList()
+ *
+ *  This method is used for building the sort key of every
+ *  draw left by CullRenderList() for the current camera
+ *  position and radix sorting them into the submission
+ *  order. The keys are built and sorted on the threads of
+ *  the job system.
+ ***********************************************************/
+void SceneManager::SortRenderList()
+{
+	m_drawKeys.clear();
+	for (size_t i = 0; i < m_renderList.size(); i++)
+	{
+		if (m_drawVisible[i] == 0)
+		{
+			continue;
+		}
+
+		DRAW_KEY drawKey;
+		drawKey.key = 0;
+		drawKey.drawIndex = (uint32_t)i;
+		m_drawKeys.push_back(drawKey);
+	}
+
+	ParallelFor(m_drawKeys.size(), PARALLEL_MIN_DRAWS, [this](size_t first, size_t end)
+		{
+			for (size_t i = first; i < end; i++)
+			{
+				m_drawKeys[i].key = MakeDrawKey(m_drawKeys[i].drawIndex);
+			}
+		});
+
+	SortDrawKeys(m_drawKeys, m_sortScratch, m_pJobSystem);
+}
+
+/***********************************************************
+ *  SortDrawKeys()
+ *
+ *  This method is used for radix sorting draw keys into the
+ *  submission order, on the threads of the job system for
+ *  long lists. It is static, so the benchmarks sort keys
+ *  the same way without a scene.
+ ***********************************************************/
+void SceneManager::SortDrawKeys(std::vector<DRAW_KEY>& keys, std::vector<DRAW_KEY>& scratch, JobSystem* pJobSystem)
+{
+	if (keys.empty() == false)
+	{
+		RadixSortDrawKeys(keys, scratch, pJobSystem);
+	}
+}
+
+/***********************************************************
+ *  ParallelFor()
+ *
+ *  This method is used for running a pass over [0, count)
+ *  on the threads of the job system, or on the calling
+ *  thread without one.
+ ***********************************************************/
+void SceneManager::ParallelFor(size_t count, size_t minItems, const std::function<void(size_t, size_t)>& pass)
+{
+	if (NULL == m_pJobSystem)
+	{
+		pass((size_t)0, count);
+		return;
+	}
+	m_pJobSystem->ParallelFor(count, minItems, pass);
+}
+
+/***********************************************************
+ *  GetDrawPermutation()
+ *
+ *  This method is used for getting the instanced shader
+ *  permutation a recorded draw is submitted with.
+ ***********************************************************/
+int SceneManager::GetDrawPermutation(const DRAW_RECORD& drawRecord) const
+{
+	int permutation = GetLightingPermutation() | ShaderManager::PERMUTATION_INSTANCING;
+	if (drawRecord.textureSlot >= 0)
+	{
+		permutation |= ShaderManager::PERMUTATION_TEXTURE;
+	}
+	if ((drawRecord.bTransparent == true) && (m_bOrderIndependentTransparency == true))
+	{
+		permutation |= ShaderManager::PERMUTATION_TRANSPARENCY;
+	}
+	// glass is blended over the lit result, so it stays forward
+	if ((drawRecord.bTransparent == false) && (IsDeferredShadingActive() == true))
+	{
+		permutation |= ShaderManager::PERMUTATION_GBUFFER;
+	}
+
+	return(permutation);
+}
+
+/***********************************************************
+ *  AttachInstanceTexture()
+ *
+ *  This method is used for creating the texture buffer the
+ *  shaders read the INSTANCE_DATA from, and attaching it to
+ *  the whole upload ring, to the resident instance buffer,
+ *  or to the buffer the compact records are expanded into.
+ *  The frame's instances are
+ *  found through instanceBase, so the texture stays attached
+ *  until the buffer is replaced by a larger one.
+ ***********************************************************/
+void SceneManager::AttachInstanceTexture(GLuint buffer)
+{
+	if (0 == m_instanceTexture)
+	{
+		glGenTextures(1, &m_instanceTexture);
+	}
+
+	GLuint previousTexture = ShapeMeshes::BindTextureForEdit(GL_TEXTURE_BUFFER, m_instanceTexture);
+	glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, buffer);
+	ShapeMeshes::RestoreTextureBinding(GL_TEXTURE_BUFFER, previousTexture);
+	m_instanceTextureBuffer = buffer;
+}
+
+/***********************************************************
+ *  UploadInstanceData()
+ *
+ *  This method is used for writing the per-instance values
+ *  of the render list in the sorted submission order, so
+ *  every batch is a contiguous run of instances, followed
+ *  by the indirect commands. The values and batches are only
+ *  rebuilt when the order or the draws changed. The full
+ *  values are kept in the resident buffer, which only takes
+ *  the instances that differ from what it holds; otherwise
+ *  every frame writes its own copy into the upload ring,
+ *  since the GPU may still read the copy of the frame
+ *  before. A view of the same frame with the same order
+ *  draws the copy already written. The draws the GPU
+ *  animates are posed in the copy once it is written.
+ ***********************************************************/
+void SceneManager::UploadInstanceData()
+{
+	m_indirectOffset = -1;
+	if ((NULL == m_pUploadRing) || (m_pUploadRing->IsAvailable() == false) ||
+		(m_drawKeys.empty() == true))
+	{
+		return;
+	}
+
+	bool bOrderChanged = (m_instanceOrder.size() != m_drawKeys.size());
+	for (size_t i = 0; (i < m_drawKeys.size()) && (bOrderChanged == false); i++)
+	{
+		bOrderChanged = (m_instanceOrder[i] != m_drawKeys[i].drawIndex);
+	}
+	bool bRebuild = (bOrderChanged == true) || (m_bInstanceDataDirty == true);
+	if (bRebuild == true)
+	{
+		RebuildInstanceData();
+	}
+
+	// the copy is drawn from the ring, or from the buffer the
+	// compact records of the frame are expanded into
+	bool bCompact = (m_bCompactInstancesPacked == true) && (m_pInstanceExpander->IsAvailable() == true);
+	GLuint instanceBuffer = (bCompact == true) ?
+		m_pInstanceExpander->GetInstanceBuffer() : m_pUploadRing->GetBuffer();
+
+	// the resident buffer is kept in step with the order of the
+	// primary view; an extra view with an order of its own writes
+	// its copy into the ring instead
+	bool bResident = (bCompact == false) && (m_bResidentInstances == true) &&
+		((m_bPrimaryView == true) || (bRebuild == false));
+	if (bResident == true)
+	{
+		size_t capacity = m_pResidentInstances->GetCapacity();
+		if ((m_bResidentInstancesCurrent == false) &&
+			(m_pResidentInstances->Update(m_pUploadRing, &m_instanceData[0], m_drawKeys.size()) == true))
+		{
+			m_bResidentInstancesCurrent = true;
+		}
+		bResident = m_bResidentInstancesCurrent;
+		if (bResident == true)
+		{
+			instanceBuffer = m_pResidentInstances->GetBuffer();
+			m_instanceBase = 0;
+			m_bInstanceCopyWritten = true;
+			// a larger buffer may have been given the old one's name
+			if (m_pResidentInstances->GetCapacity() != capacity)
+			{
+				m_instanceTextureBuffer = 0;
+			}
+		}
+	}
+	bool bReuseCopy = (bResident == true) || ((bRebuild == false) && (m_bInstanceCopyWritten == true) &&
+		(m_instanceTextureBuffer == instanceBuffer));
+
+	// aligned to whole instances, or whole records, so the shaders
+	// can index them from the start of the ring
+	if ((bReuseCopy == false) && (bCompact == true))
+	{
+		GLintptr recordOffset = m_pUploadRing->Write(&m_compactInstances[0],
+			m_drawKeys.size() * sizeof(InstanceExpander::COMPACT_INSTANCE), sizeof(InstanceExpander::COMPACT_INSTANCE));
+		if ((recordOffset >= 0) && (m_pInstanceExpander->Expand(m_pUploadRing->GetBuffer(),
+			(GLuint)(recordOffset / sizeof(InstanceExpander::COMPACT_INSTANCE)), (GLuint)m_drawKeys.size()) == true))
+		{
+			m_instanceBase = 0;
+			m_bInstanceCopyWritten = true;
+		}
+		// the expanded buffer is replaced when it grows
+		instanceBuffer = m_pInstanceExpander->GetInstanceBuffer();
+	}
+	else if (bReuseCopy == false)
+	{
+		GLintptr instanceOffset = m_pUploadRing->Write(&m_instanceData[0],
+			m_drawKeys.size() * sizeof(INSTANCE_DATA), sizeof(INSTANCE_DATA));
+		if (instanceOffset >= 0)
+		{
+			m_instanceBase = (int)(instanceOffset / sizeof(INSTANCE_DATA));
+			m_bInstanceCopyWritten = true;
+		}
+	}
+	if (m_instanceTextureBuffer != instanceBuffer)
+	{
+		AttachInstanceTexture(instanceBuffer);
+	}
+
+	// pose the draws the GPU animates in every new copy, and once a
+	// frame in the resident one
+	if (bReuseCopy == false)
+	{
+		m_bAnimationSampled = false;
+	}
+	if ((m_bInstanceCopyWritten == true) && (m_bAnimationSampled == false) &&
+		(m_pSceneAnimation->HasGPUBindings() == true))
+	{
+		m_pSceneAnimation->Dispatch(m_pUploadRing, m_instanceTextureBuffer, m_instanceBase, m_animationTime);
+		m_bAnimationSampled = true;
+	}
+
+	// the occlusion culling overwrites the instance counts of this
+	// copy, so the commands are written again every frame as well
+	if ((m_bMultiDrawIndirect == true) && (m_indirectCommands.empty() == false))
+	{
+		m_indirectOffset = m_pUploadRing->Write(m_indirectCommands.data(),
+			m_indirectCommands.size() * sizeof(ShapeMeshes::INDIRECT_COMMAND));
+	}
+}
+
+/***********************************************************
+ *  RebuildInstanceData()
+ *
+ *  This method is used for gathering the per-instance values
+ *  of the render list in the sorted submission order and
+ *  splitting the order into batches again.
+ ***********************************************************/
+void SceneManager::RebuildInstanceData()
+{
+	m_bInstanceDataDirty = false;
+	m_bResidentInstancesCurrent = false;
+
+	m_instanceOrder.resize(m_drawKeys.size());
+	for (size_t i = 0; i < m_drawKeys.size(); i++)
+	{
+		m_instanceOrder[i] = m_drawKeys[i].drawIndex;
+	}
+
+	// the compact records when every model of the order is a
+	// translation, rotation and scale, the full values otherwise;
+	// the records have no room for the lights of a draw
+	m_bCompactInstancesPacked = false;
+	if ((m_bCompactInstances == true) && (m_bObjectLights == false) &&
+		(m_pInstanceExpander->IsAvailable() == true))
+	{
+		m_compactInstances.resize(m_drawKeys.size());
+		bool bPacked = true;
+		for (size_t i = 0; (i < m_drawKeys.size()) && (bPacked == true); i++)
+		{
+			const DRAW_RECORD& drawRecord = m_renderList[m_drawKeys[i].drawIndex];
+			bPacked = InstanceExpander::Pack(m_sceneTransforms.GetDrawModel(m_drawKeys[i].drawIndex),
+				drawRecord.color, drawRecord.UVscale, drawRecord.materialID, drawRecord.textureSlot,
+				m_compactInstances[i]);
+		}
+		m_bCompactInstancesPacked = bPacked;
+		if (bPacked == false)
+		{
+			m_pInstanceExpander->CountFallback();
+		}
+	}
+
+	for (size_t i = 0; (i < m_drawKeys.size()) && (m_bCompactInstancesPacked == false); i++)
+	{
+		const DRAW_RECORD& drawRecord = m_renderList[m_drawKeys[i].drawIndex];
+
+		m_instanceData[i].model = m_sceneTransforms.GetDrawModel(m_drawKeys[i].drawIndex);
+		const glm::mat3& normalMatrix = m_sceneTransforms.GetDrawNormalMatrix(m_drawKeys[i].drawIndex);
+		for (int column = 0; column < 3; column++)
+		{
+			m_instanceData[i].normalMatrix[column] = glm::vec4(normalMatrix[column], 0.0f);
+		}
+		if (m_bObjectLights == true)
+		{
+			PackObjectLights(m_drawKeys[i].drawIndex, m_instanceData[i]);
+		}
+		m_instanceData[i].color = drawRecord.color;
+		m_instanceData[i].UVscaleMaterial = glm::vec4(
+			drawRecord.UVscale.x, drawRecord.UVscale.y, (float)drawRecord.materialID, (float)drawRecord.textureSlot);
+	}
+
+	// the draws the GPU animates move with the order
+	m_pSceneAnimation->BuildRecords(m_instanceOrder, m_sceneTransforms);
+
+	// the batches follow the submission order
+	BuildDrawBatches();
+}
+
+/***********************************************************
+ *  PackObjectLights()
+ *
+ *  This method is used for picking the lights a forward draw
+ *  is shaded by: every light is scored by its brightness
+ *  times its attenuation at the nearest point of the world
+ *  bounds of the draw, and the MAX_OBJECT_LIGHTS best are
+ *  kept. The count + 1 and the indexes are packed a byte
+ *  each, three to the w of a normal matrix column, which a
+ *  float holds exactly.
+ ***********************************************************/
+void SceneManager::PackObjectLights(uint32_t drawIndex, INSTANCE_DATA& instance) const
+{
+	const SceneBVH::AABB& bounds = m_sceneTransforms.GetDrawBounds(drawIndex);
+
+	// the best lights so far, strongest first
+	int lightIndexes[MAX_OBJECT_LIGHTS];
+	float lightScores[MAX_OBJECT_LIGHTS];
+	int lightCount = 0;
+	for (int i = 0; i < (int)m_lights.size(); i++)
+	{
+		// as the shaders see it, past the light LOD
+		const LIGHT_SOURCE light = GetLODLight(i);
+		if (light.lightType == LIGHT_TYPE_OFF)
+		{
+			continue;
+		}
+		glm::vec3 color = light.ambientColor + light.diffuseColor + (light.specularColor * light.specularIntensity);
+		float score = glm::max(color.x, glm::max(color.y, color.z)) * light.fade;
+		// lights without a reach light the whole draw, the others as
+		// the shaders attenuate them at its nearest point
+		if (light.radius > 0.0f)
+		{
+			glm::vec3 nearest = glm::clamp(light.position, bounds.minXYZ, bounds.maxXYZ);
+			float distanceRatio = glm::length(light.position - nearest) / light.radius;
+			float window = glm::clamp(1.0f - (distanceRatio * distanceRatio * distanceRatio * distanceRatio), 0.0f, 1.0f);
+			score *= window * window;
+		}
+		if (score <= 0.0f)
+		{
+			continue;
+		}
+
+		// insert in order, dropping the weakest when full
+		int slot = lightCount;
+		while ((slot > 0) && (lightScores[slot - 1] < score))
+		{
+			slot--;
+		}
+		if (slot >= MAX_OBJECT_LIGHTS)
+		{
+			continue;
+		}
+		int last = glm::min(lightCount, MAX_OBJECT_LIGHTS - 1);
+		for (int j = last; j > slot; j--)
+		{
+			lightIndexes[j] = lightIndexes[j - 1];
+			lightScores[j] = lightScores[j - 1];
+		}
+		lightIndexes[slot] = i;
+		lightScores[slot] = score;
+		lightCount = glm::min(lightCount + 1, MAX_OBJECT_LIGHTS);
+	}
+
+	uint32_t bytes[MAX_OBJECT_LIGHTS + 1] = { 0 };
+	bytes[0] = (uint32_t)lightCount + 1;
+	for (int i = 0; i < lightCount; i++)
+	{
+		bytes[i + 1] = (uint32_t)lightIndexes[i];
+	}
+	for (int column = 0; column < 3; column++)
+	{
+		uint32_t word = bytes[column * 3] | (bytes[column * 3 + 1] << 8) | (bytes[column * 3 + 2] << 16);
+		instance.normalMatrix[column].w = (float)word;
+	}
+}
+
+/***********************************************************
+ *  BuildDrawBatches()
+ *
+ *  This method is used for splitting the sorted render list
+ *  into batches of consecutive draws that share a mesh range,
+ *  and with bindless textures a texture, each drawn with one
+ *  instanced call, and for writing one indirect command per
+ *  batch when multi-draw indirect is used.
+ ***********************************************************/
+void SceneManager::BuildDrawBatches()
+{
+	m_drawBatches.clear();
+	m_indirectCommands.clear();
+	m_batchBounds.clear();
+	m_batchInstanceCounts.clear();
+	m_batchMeshletBatches.clear();
+	std::vector<MeshletCuller::MESHLET_BATCH> meshletBatches;
+
+	size_t batchStart = 0;
+	while (batchStart < m_drawKeys.size())
+	{
+		const DRAW_RECORD& drawRecord = m_renderList[m_drawKeys[batchStart].drawIndex];
+		SceneBVH::AABB batchBounds = m_sceneTransforms.GetDrawBounds(m_drawKeys[batchStart].drawIndex);
+
+		size_t batchEnd = batchStart + 1;
+		while (batchEnd < m_drawKeys.size())
+		{
+			const DRAW_RECORD& nextRecord = m_renderList[m_drawKeys[batchEnd].drawIndex];
+			// one texture per batch keeps the bindless handle the same
+			// for every instance of an indirect command; the texture
+			// array is read per instance, so only texturing matters
+			if ((nextRecord.rangeID != drawRecord.rangeID) ||
+				((nextRecord.textureSlot != drawRecord.textureSlot) && (m_pTextureTable->IsBindless() == true)) ||
+				((nextRecord.textureSlot >= 0) != (drawRecord.textureSlot >= 0)) ||
+				(nextRecord.bTransparent != drawRecord.bTransparent) ||
+				((m_drawQueryGroups.empty() == false) &&
+				(m_drawQueryGroups[m_drawKeys[batchEnd].drawIndex] != m_drawQueryGroups[m_drawKeys[batchStart].drawIndex])))
+			{
+				break;
+			}
+			const SceneBVH::AABB& nextBounds = m_sceneTransforms.GetDrawBounds(m_drawKeys[batchEnd].drawIndex);
+			batchBounds.minXYZ = glm::min(batchBounds.minXYZ, nextBounds.minXYZ);
+			batchBounds.maxXYZ = glm::max(batchBounds.maxXYZ, nextBounds.maxXYZ);
+			batchEnd++;
+		}
+
+		DRAW_BATCH drawBatch;
+		drawBatch.firstInstance = (uint32_t)batchStart;
+		drawBatch.instanceCount = (uint32_t)(batchEnd - batchStart);
+		drawBatch.drawIndex = m_drawKeys[batchStart].drawIndex;
+		m_drawBatches.push_back(drawBatch);
+
+		if (m_bMultiDrawIndirect == true)
+		{
+			m_indirectCommands.push_back(ShapeMeshes::MakeIndirectCommand(
+				drawRecord.range, drawBatch.instanceCount, drawBatch.firstInstance));
+			m_batchBounds.push_back(batchBounds);
+			m_batchInstanceCounts.push_back(drawBatch.instanceCount);
+
+			// the command stays for frames the meshlets are not culled
+			int meshletBatch = -1;
+			if ((drawRecord.range.meshletCount > 0) && (m_pMeshletCuller->IsAvailable() == true))
+			{
+				MeshletCuller::MESHLET_BATCH batch;
+				batch.firstInstance = drawBatch.firstInstance;
+				batch.instanceCount = drawBatch.instanceCount;
+				batch.firstMeshlet = drawRecord.range.firstMeshlet;
+				batch.meshletCount = drawRecord.range.meshletCount;
+				meshletBatch = (int)meshletBatches.size();
+				meshletBatches.push_back(batch);
+			}
+			m_batchMeshletBatches.push_back(meshletBatch);
+		}
+
+		batchStart = batchEnd;
+	}
+
+	// the GPU culling runs for the main view only
+	if ((m_bMultiDrawIndirect == true) && (IsGPUCullingActive() == true))
+	{
+		// the culling writes the instance counts back per command
+		m_pOcclusionCuller->SetCommandBounds(m_batchBounds, m_batchInstanceCounts);
+		m_pMeshletCuller->SetBatches(meshletBatches);
+	}
+}
+
+/***********************************************************
+ *  SubmitRenderList()
+ *
+ *  This method is used for drawing the batches of the sorted
+ *  render list, each instance reading its model, color, UV
+ *  scale, material and texture index from the instance
+ *  buffer. The draws are first recorded as commands, split
+ *  between the threads of the job system, and the commands
+ *  are then replayed by the passes of the render graph on
+ *  the GL thread, into the framebuffer bound by the caller.
+ ***********************************************************/
+void SceneManager::SubmitRenderList()
+{
+	if (NULL == m_pShaderManager)
+	{
+		return;
+	}
+
+	// the transient targets are sized for the viewport
+	GLint viewport[4] = { 0, 0, 0, 0 };
+	glGetIntegerv(GL_VIEWPORT, viewport);
+	GLint sceneFramebuffer = 0;
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &sceneFramebuffer);
+	m_pRenderGraph->Reset(viewport[2], viewport[3]);
+	int frame = m_pRenderGraph->ImportFramebuffer("frame", (GLuint)sceneFramebuffer);
+
+	// a multisampled main view draws into targets of the graph of
+	// the frame's formats, resolved into it before the post effects
+	SCENE_TARGET target;
+	target.color = frame;
+	target.depth = -1;
+	target.bMultisampled = false;
+	const int samples = GetMultisampleCount();
+	if (samples > 1)
+	{
+		target.color = m_pRenderGraph->CreateTexture("msaa color",
+			(IsPostProcessingActive() == true) ? GetTargetFormats().hdrColor : GL_RGBA8, 1, samples);
+		target.depth = m_pRenderGraph->CreateTexture("msaa depth", GL_DEPTH_COMPONENT32F, 1, samples);
+		target.bMultisampled = true;
+	}
+
+	// the main view starts from a cleared frame; the extra views
+	// clear the part of it they cover themselves
+	if (m_bPrimaryView == true)
+	{
+		int clearPass = m_pRenderGraph->AddPass("clear", [this]()
+			{
+				// glClear() only clears the depth buffer while writes are on
+				ApplyPassState(m_states.depthWrite, m_states.blendAlpha);
+				glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+				GLTrace::RecordClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+				glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			});
+		WriteSceneTarget(clearPass, target);
+
+		// a main view lit at full rate leaves no copy of its frame
+		// for the rate image of the next one
+		if (IsVariableRateShadingActive() == false)
+		{
+			m_pShadingRate->Invalidate();
+		}
+	}
+
+	const bool bDraws = (m_drawBatches.empty() == false);
+	if (bDraws == true)
+	{
+		RecordCommandBuffers();
+
+		m_pShaderManager->BindTexture(INSTANCE_DATA_TEXTURE_UNIT, m_instanceTexture, GL_TEXTURE_BUFFER);
+		m_pTextureTable->Bind();
+		if (m_bLightmapReady == true)
+		{
+			m_pShaderManager->BindTexture(LIGHTMAP_TEXTURE_UNIT, m_lightmapTexture);
+		}
+		if (IsIndirectFrame() == true)
+		{
+			glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_pUploadRing->GetBuffer());
+		}
+		AddDrawPasses(target);
+	}
+	else
+	{
+		AddImpostorPass(target);
+	}
+	AddParticlePass(target);
+	if (target.bMultisampled == true)
+	{
+		m_pRenderGraph->AddResolvePass("msaa resolve", target.color, target.depth, frame);
+	}
+
+	// the effects filter the main view once it is lit; the extra
+	// views drawn over it after are left as they are
+	if ((m_bPrimaryView == true) && (IsPostProcessingActive() == true))
+	{
+		m_pPostStack->AddPasses(*m_pRenderGraph, frame, m_viewMatrix, m_projectionMatrix);
+	}
+
+	m_pRenderGraph->Execute();
+
+	// the effects set the state of their own passes
+	if ((m_bPrimaryView == true) && (IsPostProcessingActive() == true))
+	{
+		m_pRenderStates->Invalidate();
+	}
+	// the next view, and the draws of other code, start from the
+	// default state
+	ApplyDefaultState();
+	if ((bDraws == true) && (IsIndirectFrame() == true))
+	{
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+	}
+}
+
+/***********************************************************
+ *  AddDrawPasses()
+ *
+ *  This method is used for adding the passes drawing the
+ *  recorded commands to the render graph. The deferred
+ *  path draws the opaque batches into a G-buffer lit into
+ *  the frame; otherwise they are shaded straight into it,
+ *  after a depth pre-pass when one is asked for. Weighted
+ *  blended transparency accumulates the blended batches in
+ *  targets of their own, composited over the frame after.
+ *  The G-buffer and the transparency targets are transient,
+ *  so the graph lets them share textures. The frame is the
+ *  scene target, which may be multisampled targets of the
+ *  graph instead.
+ ***********************************************************/
+void SceneManager::AddDrawPasses(const SCENE_TARGET& target)
+{
+	RenderGraph& graph = *m_pRenderGraph;
+
+	// the deferred path already shades every pixel once, so it
+	// skips the pre-pass and only writes the G-buffer
+	if (IsDeferredShadingActive() == true)
+	{
+		int albedo = graph.CreateTexture("g-buffer albedo", DeferredPass::ALBEDO_FORMAT);
+		int normal = graph.CreateTexture("g-buffer normal", GetTargetFormats().gbufferNormal);
+		int material = graph.CreateTexture("g-buffer material", DeferredPass::MATERIAL_FORMAT);
+		int depth = graph.CreateTexture("g-buffer depth", DeferredPass::DEPTH_FORMAT);
+
+		int geometryPass = graph.AddPass("g-buffer", [this]()
+			{
+				BeginProfiledPass(GPUProfiler::PASS_OPAQUE);
+				// the targets hold surface values rather than colors
+				ApplyPassState(m_states.depthWrite, m_states.blendOff);
+				m_pDeferredPass->BeginGeometry();
+				ReplayCommandBuffers(false);
+			});
+		graph.Write(geometryPass, albedo);
+		graph.Write(geometryPass, normal);
+		graph.Write(geometryPass, material);
+		graph.Write(geometryPass, depth);
+
+		// the rate image of the frame is classified from its materials
+		// and the lit frame before, which is copied for the next one
+		const bool bVariableRate = IsVariableRateShadingActive();
+		int lightingPass = graph.AddPass("deferred lighting", [this, albedo, normal, material, depth, bVariableRate]()
+			{
+				ApplyPassState(m_states.depthWrite, m_states.blendAlpha);
+				bool bRateImage = (bVariableRate == true) &&
+					(m_pShadingRate->BuildRateImage(m_pRenderGraph->GetTexture(material)) == true);
+				m_pDeferredPass->Light(m_viewProjection,
+					m_pRenderGraph->GetTexture(albedo), m_pRenderGraph->GetTexture(normal),
+					m_pRenderGraph->GetTexture(material), m_pRenderGraph->GetTexture(depth),
+					(bRateImage == true) ? m_pShadingRate : NULL);
+				if (bVariableRate == true)
+				{
+					m_pShadingRate->CaptureFrame();
+				}
+				// the lighting writes every depth with a function of its own
+				m_pRenderStates->Invalidate();
+				EndProfiledPass(GPUProfiler::PASS_OPAQUE);
+			});
+		graph.Read(lightingPass, albedo);
+		graph.Read(lightingPass, normal);
+		graph.Read(lightingPass, material);
+		graph.Read(lightingPass, depth);
+		WriteSceneTarget(lightingPass, target);
+	}
+	else
+	{
+		// with the opaque depth already in place, only the nearest
+		// fragment of every pixel passes and is shaded
+		const bool bPrepass = IsDepthPrepassActive();
+		if (bPrepass == true)
+		{
+			int prepass = graph.AddPass("depth prepass", [this]()
+				{
+					BeginProfiledPass(GPUProfiler::PASS_PREPASS);
+					ApplyPassState(m_states.depthWrite, m_states.blendAlpha);
+					SubmitDepthPrepass();
+					EndProfiledPass(GPUProfiler::PASS_PREPASS);
+				});
+			WriteSceneTarget(prepass, target);
+		}
+
+		// textured opaque draws keep blending by the alpha of their
+		// texture, as the deferred lighting does
+		int opaquePass = graph.AddPass("opaque", [this, bPrepass]()
+			{
+				BeginProfiledPass(GPUProfiler::PASS_OPAQUE);
+				ApplyPassState((bPrepass == true) ? m_states.depthEqual : m_states.depthWrite, m_states.blendAlpha);
+				ReplayCommandBuffers(false);
+				EndProfiledPass(GPUProfiler::PASS_OPAQUE);
+			});
+		WriteSceneTarget(opaquePass, target);
+	}
+	// the impostors are opaque, and drawn over the opaque depth
+	AddImpostorPass(target);
+
+	// blended batches sort after the opaque ones
+	if (m_renderList[m_drawBatches.back().drawIndex].bTransparent == false)
+	{
+		return;
+	}
+
+	// blended draws are depth tested but leave the depth of the
+	// opaque draws behind them, which the occlusion culling reads
+	if (m_bOrderIndependentTransparency == true)
+	{
+		int accumulation = graph.CreateTexture("transparency accumulation", TransparencyPass::ACCUMULATION_FORMAT);
+		int revealage = graph.CreateTexture("transparency revealage", TransparencyPass::REVEALAGE_FORMAT);
+		int depth = graph.CreateTexture("transparency depth", TransparencyPass::DEPTH_FORMAT);
+
+		int transparentPass = graph.AddPass("transparent", [this, target, depth]()
+			{
+				BeginProfiledPass(GPUProfiler::PASS_TRANSPARENT);
+				ApplyPassState(m_states.depthRead, m_states.blendAlpha);
+				m_pTransparencyPass->Begin(m_pRenderGraph->GetFramebuffer(target.color), m_pRenderGraph->GetTexture(depth),
+					target.bMultisampled);
+				// the targets blend with factors of their own
+				m_pRenderStates->Invalidate();
+				ReplayCommandBuffers(true);
+			});
+		ReadSceneTarget(transparentPass, target);
+		graph.Write(transparentPass, accumulation);
+		graph.Write(transparentPass, revealage);
+		graph.Write(transparentPass, depth);
+
+		int resolvePass = graph.AddPass("transparency resolve", [this, accumulation, revealage]()
+			{
+				m_pTransparencyPass->Resolve(m_pRenderGraph->GetTexture(accumulation), m_pRenderGraph->GetTexture(revealage));
+				m_pRenderStates->Invalidate();
+				EndProfiledPass(GPUProfiler::PASS_TRANSPARENT);
+			});
+		graph.Read(resolvePass, accumulation);
+		graph.Read(resolvePass, revealage);
+		WriteSceneTarget(resolvePass, target);
+	}
+	else
+	{
+		int transparentPass = graph.AddPass("transparent", [this]()
+			{
+				BeginProfiledPass(GPUProfiler::PASS_TRANSPARENT);
+				ApplyPassState(m_states.depthRead, m_states.blendAlpha);
+				ReplayCommandBuffers(true);
+				EndProfiledPass(GPUProfiler::PASS_TRANSPARENT);
+			});
+		WriteSceneTarget(transparentPass, target);
+	}
+}
+
+/***********************************************************
+ *  WriteSceneTarget()
+ *
+ *  This method is used for declaring that a pass draws into
+ *  the scene target, its depth included.
+ ***********************************************************/
+void SceneManager::WriteSceneTarget(int pass, const SCENE_TARGET& target)
+{
+	m_pRenderGraph->Write(pass, target.color);
+	if (target.depth >= 0)
+	{
+		m_pRenderGraph->Write(pass, target.depth);
+	}
+}
+
+/***********************************************************
+ *  ReadSceneTarget()
+ *
+ *  This method is used for declaring that a pass reads the
+ *  scene target, its depth included.
+ ***********************************************************/
+void SceneManager::ReadSceneTarget(int pass, const SCENE_TARGET& target)
+{
+	m_pRenderGraph->Read(pass, target.color);
+	if (target.depth >= 0)
+	{
+		m_pRenderGraph->Read(pass, target.depth);
+	}
+}
+
+/***********************************************************
+ *  GetMultisampleCount()
+ *
+ *  This method is used for getting the samples per pixel
+ *  the view is drawn with: those of the anti-aliasing mode,
+ *  within what the GPU supports, for the main view of a
+ *  frame that is not stereo, and 1 otherwise.
+ ***********************************************************/
+int SceneManager::GetMultisampleCount() const
+{
+	if ((m_bPrimaryView == false) || (m_bStereo == true))
+	{
+		return(1);
+	}
+	return(glm::min(PostStack::GetAntiAliasingSamples(m_antiAliasing), m_maxSamples));
+}
+
+/***********************************************************
+ *  RecordCommandBuffers()
+ *
+ *  This method is used for recording the draws of the
+ *  batches into a command buffer per thread of the job
+ *  system, each for an equal range of the batches. Short
+ *  lists are recorded into one buffer on this thread. The
+ *  recording reads the render list and the batches only,
+ *  and makes no GL call.
+ ***********************************************************/
+void SceneManager::RecordCommandBuffers()
+{
+	const size_t batchCount = m_drawBatches.size();
+	size_t bufferCount = 1;
+	if ((NULL != m_pJobSystem) && (batchCount >= PARALLEL_MIN_BATCHES))
+	{
+		bufferCount = (size_t)m_pJobSystem->GetThreadCount();
+	}
+	if (m_commandBuffers.size() < bufferCount)
+	{
+		m_commandBuffers.resize(bufferCount);
+	}
+	m_commandBufferCount = bufferCount;
+	m_transparentBuffer = bufferCount;
+	m_transparentCommand = 0;
+
+	const size_t batchesPerBuffer = (batchCount + bufferCount - 1) / bufferCount;
+	if (bufferCount == 1)
+	{
+		RecordBatches(m_commandBuffers[0], 0, batchCount);
+		return;
+	}
+
+	JobSystem::JOB_COUNTER recording;
+	for (size_t buffer = 0; buffer < bufferCount; buffer++)
+	{
+		size_t first = std::min(buffer * batchesPerBuffer, batchCount);
+		size_t end = std::min(first + batchesPerBuffer, batchCount);
+		m_pJobSystem->Run([this, buffer, first, end]()
+			{ RecordBatches(m_commandBuffers[buffer], first, end); }, &recording);
+	}
+	m_pJobSystem->Wait(recording);
+}
+
+/***********************************************************
+ *  RecordBatches()
+ *
+ *  This method is used for recording the draws of the
+ *  batches [first, end). A permutation is recorded where it
+ *  differs from the batch before, and the start of the
+ *  blended draws at the first transparent batch, which the
+ *  buffer can tell from the batch before its range. With
+ *  multi-draw indirect, consecutive batches that share a
+ *  program and primitive type become one command, whatever
+ *  their textures; the batches split into meshlets draw
+ *  alone. Otherwise every batch is one instanced draw. The
+ *  batches of the objects under an occlusion query start
+ *  with the drawing of their boxes, and each one draws
+ *  alone between the start and end of the conditional
+ *  rendering on the box of its object.
+ ***********************************************************/
+void SceneManager::RecordBatches(CommandBuffer& commandBuffer, size_t first, size_t end)
+{
+	commandBuffer.Clear();
+
+	const bool bIndirectFrame = IsIndirectFrame();
+	int permutation = -1;
+	size_t batchIndex = first;
+	while (batchIndex < end)
+	{
+		const DRAW_BATCH& drawBatch = m_drawBatches[batchIndex];
+		const DRAW_RECORD& drawRecord = m_renderList[drawBatch.drawIndex];
+
+		// blended draws sort after the opaque ones
+		if ((drawRecord.bTransparent == true) &&
+			((batchIndex == 0) || (m_renderList[m_drawBatches[batchIndex - 1].drawIndex].bTransparent == false)))
+		{
+			commandBuffer.Add(CommandBuffer::COMMAND_BEGIN_TRANSPARENT);
+			// the blended draws replay in a pass of their own, which
+			// may follow the program lighting the G-buffer
+			permutation = -1;
+		}
+
+		// the queried objects follow the other opaque draws, and their
+		// boxes are tested against the depth those leave
+		int queryGroup = GetBatchQueryGroup(batchIndex);
+		if ((queryGroup >= 0) && ((batchIndex == 0) || (GetBatchQueryGroup(batchIndex - 1) < 0)))
+		{
+			commandBuffer.Add(CommandBuffer::COMMAND_DRAW_QUERY_BOXES);
+		}
+
+		int drawPermutation = GetDrawPermutation(drawRecord);
+		if (drawPermutation != permutation)
+		{
+			permutation = drawPermutation;
+			commandBuffer.Add(CommandBuffer::COMMAND_USE_PERMUTATION, (uint32_t)permutation);
+		}
+
+		// a queried batch draws alone, under the query of its object
+		if (queryGroup >= 0)
+		{
+			commandBuffer.Add(CommandBuffer::COMMAND_BEGIN_CONDITIONAL, (uint32_t)queryGroup);
+			if (bIndirectFrame == false)
+			{
+				commandBuffer.Add(CommandBuffer::COMMAND_DRAW_BATCH, (uint32_t)batchIndex);
+			}
+			else
+			{
+				commandBuffer.Add(CommandBuffer::COMMAND_MULTI_DRAW, (uint32_t)batchIndex, 1, drawBatch.instanceCount);
+			}
+			commandBuffer.Add(CommandBuffer::COMMAND_END_CONDITIONAL);
+			batchIndex++;
+			continue;
+		}
+
+		if (bIndirectFrame == false)
+		{
+			commandBuffer.Add(CommandBuffer::COMMAND_DRAW_BATCH, (uint32_t)batchIndex);
+			batchIndex++;
+			continue;
+		}
+
+		if (GetMeshletBatch(batchIndex) >= 0)
+		{
+			commandBuffer.Add(CommandBuffer::COMMAND_DRAW_MESHLETS, (uint32_t)batchIndex);
+			batchIndex++;
+			continue;
+		}
+
+		size_t batchEnd = batchIndex + 1;
+		uint32_t instanceCount = drawBatch.instanceCount;
+		while ((batchEnd < end) && (CanMergeBatches(batchIndex, batchEnd) == true) &&
+			(GetBatchQueryGroup(batchEnd) < 0) &&
+			(GetDrawPermutation(m_renderList[m_drawBatches[batchEnd].drawIndex]) == permutation))
+		{
+			instanceCount += m_drawBatches[batchEnd].instanceCount;
+			batchEnd++;
+		}
+		commandBuffer.Add(CommandBuffer::COMMAND_MULTI_DRAW,
+			(uint32_t)batchIndex, (uint32_t)(batchEnd - batchIndex), instanceCount);
+		batchIndex = batchEnd;
+	}
+}
+
+/***********************************************************
+ *  CanMergeBatches()
+ *
+ *  This method is used for checking that a batch can join
+ *  the multi-draw indirect call of an earlier batch: it is
+ *  not split into meshlets, and it draws with the same
+ *  blending and face culling from the same vertex array and
+ *  primitive type. The caller checks the permutation.
+ ***********************************************************/
+bool SceneManager::CanMergeBatches(size_t batchIndex, size_t nextBatch) const
+{
+	const DRAW_RECORD& drawRecord = m_renderList[m_drawBatches[batchIndex].drawIndex];
+	const DRAW_RECORD& nextRecord = m_renderList[m_drawBatches[nextBatch].drawIndex];
+	return((GetMeshletBatch(nextBatch) < 0) &&
+		(nextRecord.bTransparent == drawRecord.bTransparent) &&
+		(nextRecord.range.bClosed == drawRecord.range.bClosed) &&
+		(nextRecord.range.mode == drawRecord.range.mode) &&
+		(nextRecord.range.bIndexed == drawRecord.range.bIndexed) &&
+		(nextRecord.range.vao == drawRecord.range.vao));
+}
+
+/***********************************************************
+ *  ReplayCommandBuffers()
+ *
+ *  This method is used for issuing the GL calls of the
+ *  recorded commands, buffer after buffer. A multi-draw is
+ *  held back until the next command, so one that continues
+ *  it across the end of a buffer is merged into a single
+ *  call, and a permutation the replay already uses is
+ *  skipped. The opaque draws stop at the start of the
+ *  blended ones, which the replay of the blended draws
+ *  later picks up, in a pass of their own.
+ ***********************************************************/
+void SceneManager::ReplayCommandBuffers(bool bTransparent)
+{
+	const bool bMeshShading = IsMeshShadingActive();
+	int permutation = -1;
+	// multi-draw held back for merging, as first batch, batches
+	// and instances
+	uint32_t pendingDraw[3] = { 0, 0, 0 };
+
+	size_t firstBuffer = 0;
+	size_t firstCommand = 0;
+	if (bTransparent == true)
+	{
+		firstBuffer = m_transparentBuffer;
+		firstCommand = m_transparentCommand + 1;
+	}
+	bool bStopped = false;
+
+	for (size_t buffer = firstBuffer; (buffer < m_commandBufferCount) && (bStopped == false); buffer++)
+	{
+		const std::vector<CommandBuffer::COMMAND>& commands = m_commandBuffers[buffer].GetCommands();
+		for (size_t i = (buffer == firstBuffer) ? firstCommand : 0; (i < commands.size()) && (bStopped == false); i++)
+		{
+			const CommandBuffer::COMMAND& command = commands[i];
+			if ((command.type == CommandBuffer::COMMAND_USE_PERMUTATION) && ((int)command.args[0] == permutation))
+			{
+				continue;
+			}
+			if ((command.type == CommandBuffer::COMMAND_MULTI_DRAW) && (pendingDraw[1] > 0) &&
+				(command.args[0] == pendingDraw[0] + pendingDraw[1]) &&
+				(CanMergeBatches(pendingDraw[0], command.args[0]) == true))
+			{
+				pendingDraw[1] += command.args[1];
+				pendingDraw[2] += command.args[2];
+				continue;
+			}
+			if (pendingDraw[1] > 0)
+			{
+				MultiDrawBatches(pendingDraw[0], pendingDraw[1], pendingDraw[2]);
+				pendingDraw[1] = 0;
+			}
+
+			switch (command.type)
+			{
+			case CommandBuffer::COMMAND_USE_PERMUTATION:
+				permutation = (int)command.args[0];
+				UseDrawPermutation(permutation);
+				break;
+			case CommandBuffer::COMMAND_BEGIN_TRANSPARENT:
+				// the blended draws start here, in the next pass
+				m_transparentBuffer = buffer;
+				m_transparentCommand = i;
+				bStopped = true;
+				break;
+			case CommandBuffer::COMMAND_DRAW_BATCH:
+			{
+				const DRAW_BATCH& drawBatch = m_drawBatches[command.args[0]];
+				ApplyBatchCulling(command.args[0]);
+				m_pShaderManager->setUniform(m_uniforms.instanceBase, m_instanceBase + (int)drawBatch.firstInstance);
+				ShapeMeshes::DrawRange(m_renderList[drawBatch.drawIndex].range, (GLsizei)drawBatch.instanceCount);
+				break;
+			}
+			case CommandBuffer::COMMAND_MULTI_DRAW:
+				pendingDraw[0] = command.args[0];
+				pendingDraw[1] = command.args[1];
+				pendingDraw[2] = command.args[2];
+				break;
+			case CommandBuffer::COMMAND_DRAW_MESHLETS:
+			{
+				const DRAW_BATCH& drawBatch = m_drawBatches[command.args[0]];
+				const DRAW_RECORD& drawRecord = m_renderList[drawBatch.drawIndex];
+				ApplyBatchCulling(command.args[0]);
+				m_pShaderManager->setUniform(m_uniforms.instanceBase, m_instanceBase);
+				int meshletBatch = GetMeshletBatch(command.args[0]);
+				bool bDrawn = false;
+				if (bMeshShading == true)
+				{
+					bDrawn = m_pMeshletCuller->DrawMeshTasks(meshletBatch, permutation,
+						*m_basicMeshes, m_instanceBase, *m_pOcclusionCuller);
+				}
+				else
+				{
+					m_pMeshletCuller->DrawBatch(meshletBatch, drawRecord.range.vao, drawRecord.range.indexType);
+					glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_pUploadRing->GetBuffer());
+					bDrawn = true;
+				}
+				// the batch falls back on its own command
+				if (bDrawn == false)
+				{
+					MultiDrawBatches(command.args[0], 1, drawBatch.instanceCount);
+				}
+				break;
+			}
+			case CommandBuffer::COMMAND_DRAW_QUERY_BOXES:
+				DrawQueryBoxes(permutation);
+				break;
+			case CommandBuffer::COMMAND_BEGIN_CONDITIONAL:
+				m_pOcclusionQueries->BeginConditional(m_groupQueryBoxes[command.args[0]]);
+				break;
+			case CommandBuffer::COMMAND_END_CONDITIONAL:
+				// a multi-draw held back went out above, still under
+				// the query
+				m_pOcclusionQueries->EndConditional();
+				break;
+			}
+		}
+	}
+
+	if (pendingDraw[1] > 0)
+	{
+		MultiDrawBatches(pendingDraw[0], pendingDraw[1], pendingDraw[2]);
+	}
+}
+
+/***********************************************************
+ *  MultiDrawBatches()
+ *
+ *  This method is used for drawing consecutive batches with
+ *  one multi-draw indirect call from their commands in the
+ *  upload ring. Each instance is found through the base
+ *  instance of its command, counted from m_instanceBase,
+ *  where the frame's copy starts in the upload ring.
+ ***********************************************************/
+void SceneManager::MultiDrawBatches(uint32_t firstBatch, uint32_t batchCount, uint32_t instanceCount)
+{
+	const DRAW_RECORD& drawRecord = m_renderList[m_drawBatches[firstBatch].drawIndex];
+	ApplyBatchCulling(firstBatch);
+	m_pShaderManager->setUniform(m_uniforms.instanceBase, m_instanceBase);
+	ShapeMeshes::MultiDrawIndirect(drawRecord.range.vao, drawRecord.range.mode,
+		drawRecord.range.bIndexed, drawRecord.range.indexType,
+		(GLsizei)firstBatch, (GLsizei)batchCount, (GLsizei)instanceCount, m_indirectOffset);
+}
+
+/***********************************************************
+ *  UseDrawPermutation()
+ *
+ *  This method is used for making a shader permutation of
+ *  the draws current and pointing its samplers at the
+ *  texture units the frame bound.
+ ***********************************************************/
+void SceneManager::UseDrawPermutation(int permutation)
+{
+	m_pShaderManager->UsePermutation(permutation);
+	m_pShaderManager->setUniform(m_uniforms.instanceData, (int)INSTANCE_DATA_TEXTURE_UNIT);
+	m_pShaderManager->setUniform(m_uniforms.shadowAtlas, (int)ShadowAtlas::SHADOW_ATLAS_TEXTURE_UNIT);
+	m_pShaderManager->setUniform(m_uniforms.cascadeShadowMap, (int)CascadedShadows::CASCADE_TEXTURE_UNIT);
+	m_pShaderManager->setUniform(m_uniforms.reflectionProbes, (int)ReflectionProbes::PROBE_TEXTURE_UNIT);
+	m_pShaderManager->setUniform(m_uniforms.textureArray, (int)TextureTable::TEXTURE_ARRAY_UNIT);
+	m_pShaderManager->setUniform(m_uniforms.lightmap, (int)LIGHTMAP_TEXTURE_UNIT);
+	m_pShaderManager->setUniform(m_uniforms.lightmapEnabled, (m_bLightmapReady == true) ? 1 : 0);
+}
+
+/***********************************************************
+ *  CreateRenderStates()
+ *
+ *  This method is used for creating the state objects the
+ *  passes and batches draw with. Creating them issues no GL
+ *  call, so they exist before the context is current.
+ ***********************************************************/
+void SceneManager::CreateRenderStates()
+{
+	RenderStateCache::DEPTH_STATE depth;
+	depth.bTest = true;
+	depth.bWrite = true;
+	depth.func = GL_LESS;
+	m_states.depthWrite = m_pRenderStates->CreateDepthState(depth);
+	depth.bWrite = false;
+	m_states.depthRead = m_pRenderStates->CreateDepthState(depth);
+	depth.func = GL_EQUAL;
+	m_states.depthEqual = m_pRenderStates->CreateDepthState(depth);
+
+	RenderStateCache::BLEND_STATE blend;
+	blend.bEnable = false;
+	blend.sourceColor = GL_ONE;
+	blend.destinationColor = GL_ZERO;
+	blend.sourceAlpha = GL_ONE;
+	blend.destinationAlpha = GL_ZERO;
+	m_states.blendOff = m_pRenderStates->CreateBlendState(blend);
+	blend.bEnable = true;
+	blend.sourceColor = GL_SRC_ALPHA;
+	blend.destinationColor = GL_ONE_MINUS_SRC_ALPHA;
+	blend.sourceAlpha = GL_SRC_ALPHA;
+	blend.destinationAlpha = GL_ONE_MINUS_SRC_ALPHA;
+	m_states.blendAlpha = m_pRenderStates->CreateBlendState(blend);
+
+	RenderStateCache::CULL_STATE cull;
+	cull.bEnable = false;
+	cull.face = GL_BACK;
+	cull.frontFace = GL_CCW;
+	m_states.cullOff = m_pRenderStates->CreateCullState(cull);
+	cull.bEnable = true;
+	m_states.cullBack = m_pRenderStates->CreateCullState(cull);
+
+	RenderStateCache::STENCIL_STATE stencil;
+	stencil.bTest = false;
+	stencil.func = GL_ALWAYS;
+	stencil.reference = 0;
+	stencil.readMask = 0xFF;
+	stencil.writeMask = 0xFF;
+	stencil.stencilFail = GL_KEEP;
+	stencil.depthFail = GL_KEEP;
+	stencil.depthPass = GL_KEEP;
+	m_states.stencilOff = m_pRenderStates->CreateStencilState(stencil);
+}
+
+/***********************************************************
+ *  ApplyPassState()
+ *
+ *  This method is used for setting the depth and blend
+ *  state a pass draws with. The passes start with both
+ *  faces drawn and no stencil test; the batches of a pass
+ *  then cull the faces they can.
+ ***********************************************************/
+void SceneManager::ApplyPassState(int depthState, int blendState)
+{
+	m_pRenderStates->ApplyDepthState(depthState);
+	m_pRenderStates->ApplyBlendState(blendState);
+	m_pRenderStates->ApplyCullState(m_states.cullOff);
+	m_pRenderStates->ApplyStencilState(m_states.stencilOff);
+}
+
+/***********************************************************
+ *  ApplyDefaultState()
+ *
+ *  This method is used for setting the state other code
+ *  expects between the views, which leaves it as it found
+ *  it or tells the cache it did not.
+ ***********************************************************/
+void SceneManager::ApplyDefaultState()
+{
+	ApplyPassState(m_states.depthWrite, m_states.blendAlpha);
+}
+
+/***********************************************************
+ *  ApplyBatchCulling()
+ *
+ *  This method is used for culling the back faces of a
+ *  batch when it draws a closed surface and is opaque. The
+ *  inside of a closed shape is never seen, while a blended
+ *  one shows its far side through the near one, and an
+ *  open part or an imported model may show either side.
+ ***********************************************************/
+void SceneManager::ApplyBatchCulling(size_t batchIndex)
+{
+	const DRAW_RECORD& drawRecord = m_renderList[m_drawBatches[batchIndex].drawIndex];
+	m_pRenderStates->ApplyCullState(((drawRecord.range.bClosed == true) && (drawRecord.bTransparent == false)) ?
+		m_states.cullBack : m_states.cullOff);
+}
+
+/***********************************************************
+ *  IsOcclusionQueryActive()
+ *
+ *  This method is used for checking whether the boxes of the
+ *  query groups are drawn this frame. The boxes are drawn
+ *  with the camera of one view, so a stereo frame draws the
+ *  groups without them.
+ ***********************************************************/
+bool SceneManager::IsOcclusionQueryActive() const
+{
+	return((m_queryGroups.empty() == false) && (m_pOcclusionQueries->IsAvailable() == true) &&
+		(m_bHasViewProjection == true) && (m_bStereo == false));
+}
+
+/***********************************************************
+ *  GetBatchQueryGroup()
+ *
+ *  This method is used for finding the query group of the
+ *  object a batch draws a part of. A batch never spans two
+ *  groups, so its first draw tells.
+ ***********************************************************/
+int SceneManager::GetBatchQueryGroup(size_t batchIndex) const
+{
+	uint32_t drawIndex = m_drawBatches[batchIndex].drawIndex;
+	if (drawIndex >= m_drawQueryGroups.size())
+	{
+		return(-1);
+	}
+	return(m_drawQueryGroups[drawIndex]);
+}
+
+/***********************************************************
+ *  DrawQueryBoxes()
+ *
+ *  This method is used for drawing the boxes of the query
+ *  groups in the view against the opaque depth drawn so
+ *  far, timed as a pass of their own, and switching back to
+ *  the permutation of the replay. The pre-pass left the
+ *  queried objects out, so from here on they test and
+ *  write their depth as they would without one.
+ ***********************************************************/
+void SceneManager::DrawQueryBoxes(int permutation)
+{
+	if (IsOcclusionQueryActive() == true)
+	{
+		BeginProfiledPass(GPUProfiler::PASS_QUERY_BOXES);
+		m_pOcclusionQueries->DrawBoxes(m_bReverseZ);
+		EndProfiledPass(GPUProfiler::PASS_QUERY_BOXES);
+		if (permutation >= 0)
+		{
+			UseDrawPermutation(permutation);
+		}
+	}
+
+	if (IsDepthPrepassActive() == true)
+	{
+		m_pRenderStates->ApplyDepthState(m_states.depthWrite);
+	}
+}
+
+/***********************************************************
+ *  SubmitPickPass()
+ *
+ *  This method is used for drawing every batch of the main
+ *  view once more into the ID target of the pick, each
+ *  instance with its submission index + 1 as its ID. The
+ *  batches go out one call each, without the GPU culling,
+ *  since only the few pixels around the point are drawn.
+ *  A stereo frame has no single view to pick in, and the
+ *  objects shown as impostors are not in the batches.
+ ***********************************************************/
+void SceneManager::SubmitPickPass()
+{
+	if ((m_bStereo == true) || (m_pObjectPicker->IsAvailable() == false))
+	{
+		return;
+	}
+
+	GLDebug::PushGroup("object pick");
+	m_pShaderManager->BindTexture(INSTANCE_DATA_TEXTURE_UNIT, m_instanceTexture, GL_TEXTURE_BUFFER);
+	m_pObjectPicker->BeginPick(m_bReverseZ);
+	for (size_t i = 0; i < m_drawBatches.size(); i++)
+	{
+		const DRAW_BATCH& drawBatch = m_drawBatches[i];
+		m_pObjectPicker->DrawBatch(m_instanceBase + (GLint)drawBatch.firstInstance, (GLint)drawBatch.firstInstance + 1,
+			m_renderList[drawBatch.drawIndex].range, (GLsizei)drawBatch.instanceCount);
+	}
+	m_pObjectPicker->EndPick();
+	GLDebug::PopGroup();
+
+	m_pickInstanceOrder = m_instanceOrder;
+}
+
+/***********************************************************
+ *  SubmitDepthPrepass()
+ *
+ *  This method is used for drawing the depth of the opaque
+ *  batches with the position-only program and color writes
+ *  off. Texture and material do not matter for depth, so
+ *  with multi-draw indirect every run of opaque batches
+ *  that shares a primitive type and face culling goes out
+ *  as one call, and the ones split into meshlets draw
+ *  their visible ones.
+ ***********************************************************/
+void SceneManager::SubmitDepthPrepass()
+{
+	m_pShaderManager->UseExternalProgram(m_depthPrepassProgram);
+	glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+
+	size_t batchIndex = 0;
+	while (batchIndex < m_drawBatches.size())
+	{
+		const DRAW_BATCH& drawBatch = m_drawBatches[batchIndex];
+		const DRAW_RECORD& drawRecord = m_renderList[drawBatch.drawIndex];
+
+		// opaque batches sort before the transparent ones, and the
+		// queried objects after the other opaque ones; those draw
+		// their own depth once their boxes were tested
+		if ((drawRecord.bTransparent == true) || (GetBatchQueryGroup(batchIndex) >= 0))
+		{
+			break;
+		}
+
+		ApplyBatchCulling(batchIndex);
+		if (IsIndirectFrame() == false)
+		{
+			glUniform1i(m_depthPrepassInstanceBaseLocation, m_instanceBase + (int)drawBatch.firstInstance);
+			ShapeMeshes::DrawRange(drawRecord.range, (GLsizei)drawBatch.instanceCount);
+			batchIndex++;
+			continue;
+		}
+
+		// the pre-pass turns mesh shading off, so the meshlets were
+		// culled into commands
+		glUniform1i(m_depthPrepassInstanceBaseLocation, m_instanceBase);
+		int meshletBatch = GetMeshletBatch(batchIndex);
+		if (meshletBatch >= 0)
+		{
+			m_pMeshletCuller->DrawBatch(meshletBatch, drawRecord.range.vao, drawRecord.range.indexType);
+			glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_pUploadRing->GetBuffer());
+			batchIndex++;
+			continue;
+		}
+
+		size_t batchEnd = batchIndex + 1;
+		GLsizei instanceCount = (GLsizei)drawBatch.instanceCount;
+		while (batchEnd < m_drawBatches.size())
+		{
+			const DRAW_RECORD& nextRecord = m_renderList[m_drawBatches[batchEnd].drawIndex];
+			if ((GetMeshletBatch(batchEnd) >= 0) ||
+				(GetBatchQueryGroup(batchEnd) >= 0) ||
+				(nextRecord.bTransparent == true) ||
+				(nextRecord.range.bClosed != drawRecord.range.bClosed) ||
+				(nextRecord.range.mode != drawRecord.range.mode) ||
+				(nextRecord.range.bIndexed != drawRecord.range.bIndexed) ||
+				(nextRecord.range.vao != drawRecord.range.vao))
+			{
+				break;
+			}
+			instanceCount += (GLsizei)m_drawBatches[batchEnd].instanceCount;
+			batchEnd++;
+		}
+
+		ShapeMeshes::MultiDrawIndirect(drawRecord.range.vao, drawRecord.range.mode,
+			drawRecord.range.bIndexed, drawRecord.range.indexType,
+			(GLsizei)batchIndex, (GLsizei)(batchEnd - batchIndex),
+			instanceCount, m_indirectOffset);
+
+		batchIndex = batchEnd;
+	}
+
+	glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+}
+
+/***********************************************************
+ *  WarmUpPipelines()
+ *
+ *  This method is used for drawing once, into a few pixels,
+ *  every combination of program, vertex format, primitive
+ *  and pass state the draws of the render list meet in the
+ *  passes of a frame: the forward and, with lighting, the
+ *  G-buffer permutation of every opaque draw, as the keys
+ *  switch between them, its depth pre-pass, and the blended
+ *  permutation of every transparent one into the targets of
+ *  its pass. Drivers finish building a program, or build
+ *  another variant of it, on the first draw with a state it
+ *  was not built for, which is a hitch the first time an
+ *  object comes into view. Only a triangle of each range is
+ *  drawn, and the GPU is waited for, so the time taken is
+ *  the driver's. A state the frame sets with the pass, such
+ *  as the depth function, changes no variant and is left
+ *  out of the combinations.
+ ***********************************************************/
+int SceneManager::WarmUpPipelines()
+{
+	if ((m_renderList.empty() == true) || (m_bStereo == true))
+	{
+		return(0);
+	}
+	double startSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+
+	// the keys switch the deferred shading and the pre-pass at any
+	// time, so both paths are drawn where they are available
+	const bool bDeferred = (m_bUseLighting == true) && (m_pDeferredPass->IsAvailable() == true);
+	const bool bPrepass = (0 != m_depthPrepassProgram);
+	std::vector<WARMUP_DRAW> draws;
+	std::vector<uint64_t> newKeys;
+	for (size_t drawIndex = 0; drawIndex < m_renderList.size(); drawIndex++)
+	{
+		const DRAW_RECORD& drawRecord = m_renderList[drawIndex];
+		if (drawRecord.range.count <= 0)
+		{
+			continue;
+		}
+		int permutation = GetLightingPermutation() | ShaderManager::PERMUTATION_INSTANCING;
+		if (drawRecord.textureSlot >= 0)
+		{
+			permutation |= ShaderManager::PERMUTATION_TEXTURE;
+		}
+		WARMUP_DRAW combinations[3];
+		int combinationCount = 0;
+		if (drawRecord.bTransparent == true)
+		{
+			combinations[combinationCount++] = { WARMUP_TRANSPARENT, (m_bOrderIndependentTransparency == true) ?
+				(permutation | ShaderManager::PERMUTATION_TRANSPARENCY) : permutation, (uint32_t)drawIndex };
+		}
+		else
+		{
+			combinations[combinationCount++] = { WARMUP_FORWARD, permutation, (uint32_t)drawIndex };
+			if (bDeferred == true)
+			{
+				combinations[combinationCount++] = { WARMUP_GBUFFER, permutation | ShaderManager::PERMUTATION_GBUFFER,
+					(uint32_t)drawIndex };
+			}
+			if (bPrepass == true)
+			{
+				combinations[combinationCount++] = { WARMUP_PREPASS, 0, (uint32_t)drawIndex };
+			}
+		}
+
+		bool bCulled = (drawRecord.range.bClosed == true) && (drawRecord.bTransparent == false);
+		for (int combination = 0; combination < combinationCount; combination++)
+		{
+			uint64_t key = GetWarmUpKey(combinations[combination].pass, combinations[combination].permutation,
+				drawRecord.range, bCulled);
+			if ((std::binary_search(m_warmedPipelines.begin(), m_warmedPipelines.end(), key) == false) &&
+				(std::find(newKeys.begin(), newKeys.end(), key) == newKeys.end()))
+			{
+				newKeys.push_back(key);
+				draws.push_back(combinations[combination]);
+			}
+		}
+	}
+	if (draws.empty() == true)
+	{
+		return(0);
+	}
+	m_warmedPipelines.insert(m_warmedPipelines.end(), newKeys.begin(), newKeys.end());
+	std::sort(m_warmedPipelines.begin(), m_warmedPipelines.end());
+	// a pass at a time, with the draws of a permutation together
+	std::stable_sort(draws.begin(), draws.end(), [](const WARMUP_DRAW& a, const WARMUP_DRAW& b)
+		{
+			return((a.pass < b.pass) || ((a.pass == b.pass) && (a.permutation < b.permutation)));
+		});
+
+	GLint previousFramebuffer = 0;
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previousFramebuffer);
+	GLint previousViewport[4] = { 0, 0, 0, 0 };
+	glGetIntegerv(GL_VIEWPORT, previousViewport);
+	glViewport(0, 0, WARMUP_TARGET_SIZE, WARMUP_TARGET_SIZE);
+
+	std::vector<GLuint> textures;
+	std::vector<GLuint> framebuffers;
+	std::vector<int> permutations;
+	std::vector<GLuint> vertexFormats;
+	int pass = -1;
+	int permutation = -1;
+	for (size_t i = 0; i < draws.size(); i++)
+	{
+		const WARMUP_DRAW& draw = draws[i];
+		const DRAW_RECORD& drawRecord = m_renderList[draw.drawIndex];
+		if (draw.pass != pass)
+		{
+			if (pass == WARMUP_PREPASS)
+			{
+				glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+			}
+			pass = draw.pass;
+			permutation = -1;
+
+			// the targets of the pass drawn for, of the formats of the frame
+			const GLenum sceneColor = (IsPostProcessingActive() == true) ? GetTargetFormats().hdrColor : (GLenum)GL_RGBA8;
+			if (pass == WARMUP_GBUFFER)
+			{
+				const GLenum formats[3] = { DeferredPass::ALBEDO_FORMAT, GetTargetFormats().gbufferNormal, DeferredPass::MATERIAL_FORMAT };
+				framebuffers.push_back(CreateWarmUpTarget(formats, 3, 1, textures));
+				ApplyPassState(m_states.depthWrite, m_states.blendOff);
+			}
+			else if ((pass == WARMUP_TRANSPARENT) && (m_bOrderIndependentTransparency == true))
+			{
+				const GLenum formats[2] = { TransparencyPass::ACCUMULATION_FORMAT, TransparencyPass::REVEALAGE_FORMAT };
+				framebuffers.push_back(CreateWarmUpTarget(formats, 2, 1, textures));
+				ApplyPassState(m_states.depthRead, m_states.blendAlpha);
+				// the factors TransparencyPass::Begin() blends its targets with
+				glBlendFunci(0, GL_ONE, GL_ONE);
+				glBlendFunci(1, GL_ZERO, GL_ONE_MINUS_SRC_COLOR);
+				m_pRenderStates->Invalidate();
+			}
+			else
+			{
+				framebuffers.push_back(CreateWarmUpTarget(&sceneColor, 1, GetMultisampleCount(), textures));
+				ApplyPassState((pass == WARMUP_TRANSPARENT) ? m_states.depthRead : m_states.depthWrite, m_states.blendAlpha);
+			}
+			if (pass == WARMUP_PREPASS)
+			{
+				m_pShaderManager->UseExternalProgram(m_depthPrepassProgram);
+				glUniform1i(m_depthPrepassInstanceBaseLocation, m_instanceBase);
+				glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+			}
+		}
+		if ((pass != WARMUP_PREPASS) && (draw.permutation != permutation))
+		{
+			permutation = draw.permutation;
+			UseDrawPermutation(permutation);
+			m_pShaderManager->setUniform(m_uniforms.instanceBase, m_instanceBase);
+			if (std::find(permutations.begin(), permutations.end(), permutation) == permutations.end())
+			{
+				permutations.push_back(permutation);
+			}
+		}
+		if (std::find(vertexFormats.begin(), vertexFormats.end(), drawRecord.range.vao) == vertexFormats.end())
+		{
+			vertexFormats.push_back(drawRecord.range.vao);
+		}
+
+		m_pRenderStates->ApplyCullState(((drawRecord.range.bClosed == true) && (drawRecord.bTransparent == false)) ?
+			m_states.cullBack : m_states.cullOff);
+		ShapeMeshes::DRAW_RANGE range = drawRecord.range;
+		range.count = glm::min(range.count, WARMUP_MAX_COUNT);
+		ShapeMeshes::DrawRange(range, 1);
+	}
+	glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+	// the time taken is the driver's once the GPU is done with them
+	glFinish();
+
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, (GLuint)previousFramebuffer);
+	glViewport(previousViewport[0], previousViewport[1], previousViewport[2], previousViewport[3]);
+	glDeleteFramebuffers((GLsizei)framebuffers.size(), framebuffers.data());
+	glDeleteTextures((GLsizei)textures.size(), textures.data());
+	m_pRenderStates->Invalidate();
+	ApplyDefaultState();
+
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count() - startSeconds;
+	m_warmUpStats.warmUps++;
+	m_warmUpStats.combinations += (int)draws.size();
+	m_warmUpStats.permutations = (int)permutations.size();
+	m_warmUpStats.vertexFormats = (int)vertexFormats.size();
+	m_warmUpStats.seconds += seconds;
+	m_warmUpStats.lastSeconds = seconds;
+	return((int)draws.size());
+}
+
+/***********************************************************
+ *  RenderScene()
+ *
+ *  This method is used for rendering the 3D scene by
+ *  drawing the render list recorded in PrepareScene(),
+ *  sorted by shader state and camera distance and batched
+ *  into instanced draw calls
+ ***********************************************************/
+void SceneManager::RenderScene()
+{
+	PROFILE_SCOPE("RenderScene");
+	BuildScene();
+	SubmitScene();
+}
 
-	/*Create metal material(used for cup lip/straw and knife )*/
-	OBJECT_MATERIAL metalMaterial;
-	// set attributes
-	metalMaterial.ambientColor = glm::vec3(0.23f, 0.23f, 0.21f);
-	metalMaterial.ambientStrength = 0.4f;
-	metalMaterial.diffuseColor = glm::vec3(0.3f, 0.3f, 0.25f);
-	metalMaterial.specularColor = glm::vec3(0.45f, 0.45f, 0.45f);
-	metalMaterial.shininess = 25.0f;
-	metalMaterial.tag = "metal"; // used to identify material
-	// load "metal" as a material
-	m_objectMaterials.push_back(metalMaterial);
+/***********************************************************
+ *  BuildScene()
+ *
+ *  This method is used for the part of a frame before the
+ *  draws: updating the scene, shadows and lights, and
+ *  culling, sorting and uploading the draws against the
+ *  view matrices of the frame.
+ ***********************************************************/
+void SceneManager::BuildScene()
+{
+	PROFILE_SCOPE("BuildScene");
+	m_bInstanceCopyWritten = false;
+	m_bAnimationSampled = false;
+	UpdateScene();
+	BuildView(true);
+}
 
-	/*Create organic material(used for cucumber)*/
-	OBJECT_MATERIAL organicMaterial;
-	// set attributes
-	organicMaterial.ambientColor = glm::vec3(0.25f, 0.28f, 0.25f);
-	organicMaterial.ambientStrength = 0.15f;
-	organicMaterial.diffuseColor = glm::vec3(0.3f, 0.34f, 0.3f);
-	organicMaterial.specularColor = glm::vec3(0.35f, 0.35f, 0.3f);
-	organicMaterial.shininess = 12.0f;
-	organicMaterial.tag = "organic"; // used to identify material
-	// load "organic" as a material
-	m_objectMaterials.push_back(organicMaterial);
+/***********************************************************
+ *  UpdateScene()
+ *
+ *  This method is used for the part of a frame all of its
+ *  views share: the streamed textures and imported models,
+ *  the scene transforms, the shadows and the lights.
+ ***********************************************************/
+void SceneManager::UpdateScene()
+{
+	// swap in the textures streamed in since the last frame
+	UpdateStreamedTextures();
+	// commit the pages of the virtual textures the last frames read
+	m_pVirtualTextures->Update();
+	// finish the loads of the resources, and record the draws of the
+	// models they imported since the last frame
+	UpdateResources();
+	// index the draws added between the frames, pose the animated
+	// nodes, then rebuild the world matrices of moved scene nodes
+	if (m_bDrawsAdded == true)
+	{
+		IndexAddedDraws();
+	}
+	m_pSceneAnimation->Evaluate(m_animationTime, m_sceneTransforms, m_pJobSystem);
+	UpdateSceneTransforms();
+	// redraw the shadows whose light or casters changed, which can
+	// also change the shadow index of the lights
+	BeginProfiledPass(GPUProfiler::PASS_SHADOW);
+	UpdateShadowMaps();
+	EndProfiledPass(GPUProfiler::PASS_SHADOW);
+	// capture the views of a composite shape not in the atlas yet
+	UpdateImpostors();
+	// rebake the lightmap for changed lights, or take a finished
+	// bake, before the change is uploaded
+	UpdateLightmap();
+	// fold and fade out the lights that take little of the view,
+	// then upload the light sources if any were added, removed or
+	// changed, or changed level
+	UpdateLightLOD();
+	UploadLights();
+	// capture a face of a reflection probe in the lights just uploaded
+	UpdateReflectionProbes();
 }
 
 /***********************************************************
-*  SetupSceneLights()
-*
-*  This method is used for setting the attributes of each
-*  custom light source in the scene (position, ambient color,
-*  diffuse color, specular color, focal strength, specular
-*  intensity).
-*  - ensure number of scene lights equals number of lights
-*    in fragment shader code.
-***********************************************************/
-void SceneManager::SetupSceneLights()
+ *  BuildView()
+ *
+ *  This method is used for culling, sorting and uploading
+ *  the draws against the view matrices set last. The LOD
+ *  levels, texture residency and the GPU culling against
+ *  the depth of the frame before follow the main view
+ *  only; the extra views draw the levels it picked, and
+ *  every draw inside their frustum.
+ ***********************************************************/
+void SceneManager::BuildView(bool bPrimaryView)
 {
-	// enable custom lighting in the scene
-	m_pShaderManager->setBoolValue("bUseLighting", true);
+	m_bPrimaryView = bPrimaryView;
 
-	// Set up ceiling light [0] source // light left/front of objects
-	m_pShaderManager->setVec3Value("lightSources[0].position", -6.7f, 5.5f, 1.0f); // position
-	m_pShaderManager->setVec3Value("lightSources[0].ambientColor", 0.03f, 0.01f, 0.01f); // ambient light color
-	m_pShaderManager->setVec3Value("lightSources[0].diffuseColor", 0.32f, 0.32f, 0.3f); // diffuse light color
-	m_pShaderManager->setVec3Value("lightSources[0].specularColor", 0.4f, 0.4f, 0.39f); // specular light color
-	m_pShaderManager->setFloatValue("lightSources[0].focalStrength", 45.0f); // strength of emitted focal beam
-	m_pShaderManager->setFloatValue("lightSources[0].specularIntensity", 0.05f); // strength of emitted specular light
+	// list the lights reaching each cluster of the view
+	if (m_bHasViewProjection == true)
+	{
+		BeginProfiledPass(GPUProfiler::PASS_CULLING);
+		m_pLightClusters->Update(m_viewMatrix, m_projectionMatrix, (int)m_lights.size());
+		EndProfiledPass(GPUProfiler::PASS_CULLING);
+	}
 
-	// Set up ceiling light [1] source // light right/front of objects
-	m_pShaderManager->setVec3Value("lightSources[1].position", 8.0f, 6.5f, 0.5f); //  above and in front of scene
-	m_pShaderManager->setVec3Value("lightSources[1].ambientColor", 0.03f, 0.02f, 0.01f); 
-	m_pShaderManager->setVec3Value("lightSources[1].diffuseColor", 0.3f, 0.3f, 0.3f); 
-	m_pShaderManager->setVec3Value("lightSources[1].specularColor", 0.4f, 0.4f, 0.4f); 
-	m_pShaderManager->setFloatValue("lightSources[1].focalStrength", 70.0f); 
-	m_pShaderManager->setFloatValue("lightSources[1].specularIntensity", 0.20f); 
+	// skip the draws outside the view, then submit the rest in
+	// state order instead of the order of the scene description
+	CullRenderList();
+	SelectImpostors();
+	if (m_bPrimaryView == true)
+	{
+		SelectDrawLODs();
+		UpdateTextureResidency();
+	}
+	UpdateQueryBoxes();
+	SortRenderList();
+	UploadInstanceData();
+	if (IsGPUCullingActive() == false)
+	{
+		return;
+	}
 
-	// Set up light source [2] // focus on ambient lighting
-	m_pShaderManager->setVec3Value("lightSources[2].position", 0.0f, 15.0f, 0.0f);  
-	m_pShaderManager->setVec3Value("lightSources[2].ambientColor", 0.3f, 0.25f, 0.25f);
-	m_pShaderManager->setVec3Value("lightSources[2].diffuseColor", 0.0f, 0.0f, 0.0f); 
-	m_pShaderManager->setVec3Value("lightSources[2].specularColor", 0.0f, 0.0f, 0.0f); 
-	m_pShaderManager->setFloatValue("lightSources[2].focalStrength", 0.01f); 
-	m_pShaderManager->setFloatValue("lightSources[2].specularIntensity", 0.01f); 
+	// hide the batches behind the depth of the previous frame,
+	// entirely on the GPU, then keep this frame's depth for the next
+	BeginProfiledPass(GPUProfiler::PASS_CULLING);
+	if (IsIndirectFrame() == true)
+	{
+		m_pOcclusionCuller->CullCommands(m_pUploadRing->GetBuffer(), m_indirectOffset,
+			m_indirectCommands.size() * sizeof(ShapeMeshes::INDIRECT_COMMAND));
+	}
+	// the task shaders cull the meshlets themselves when they draw
+	if ((IsIndirectFrame() == true) && (m_pMeshletCuller->GetBatchCount() > 0) &&
+		(IsMeshShadingActive() == false))
+	{
+		m_pShaderManager->BindTexture(INSTANCE_DATA_TEXTURE_UNIT, m_instanceTexture, GL_TEXTURE_BUFFER);
+		m_pMeshletCuller->CullBatches(*m_basicMeshes, m_instanceBase, *m_pOcclusionCuller);
+	}
+	EndProfiledPass(GPUProfiler::PASS_CULLING);
 }
 
 /***********************************************************
- *  PrepareScene()
+ *  SubmitScene()
  *
- *  This method is used for preparing the 3D scene by loading
- *  the shapes, textures in memory to support the 3D scene 
- *  rendering
+ *  This method is used for submitting the draws built by
+ *  BuildScene(). The deferred lighting and the depth
+ *  pyramid use the view matrices set at this point, which
+ *  are the ones the FrameData block of the draws holds.
  ***********************************************************/
-void SceneManager::PrepareScene()
+void SceneManager::SubmitScene()
 {
+	PROFILE_SCOPE("SubmitScene");
+	SubmitRenderList();
+	if (m_pObjectPicker->IsRequested() == true)
+	{
+		SubmitPickPass();
+	}
+	if ((m_bMultiDrawIndirect == true) && (m_bHasViewProjection == true) && (IsGPUCullingActive() == true))
+	{
+		BeginProfiledPass(GPUProfiler::PASS_CULLING);
+		m_pOcclusionCuller->BuildDepthPyramid(m_viewProjection);
+		EndProfiledPass(GPUProfiler::PASS_CULLING);
+	}
+	// once the draws of the frame are submitted, which read the
+	// ranges where they were
+	m_meshPages.Defragment(DEFRAGMENT_BYTES_PER_FRAME);
+}
 
-	LoadSceneTextures();		  // Use custom textures for scene
-	DefineObjectMaterials(); // define the materials to create proper object lighting
-	SetupSceneLights();	   // create the lights for the scene (up to 4 lights)
-	
-	// only one instance of a particular mesh needs to be
-	// loaded in memory no matter how many times it is drawn
-	// in the rendered 3D scene
-	m_basicMeshes->LoadPlaneMesh();
-	m_basicMeshes->LoadCylinderMesh();
-	m_basicMeshes->LoadSphereMesh();
-	m_basicMeshes->LoadTorusMesh();
-	m_basicMeshes->LoadTaperedCylinderMesh();
-	m_basicMeshes->LoadBoxMesh();
-	m_basicMeshes->LoadPyramid3Mesh();
-	m_basicMeshes->LoadPyramid4Mesh();
-	m_basicMeshes->LoadConeMesh();
-	m_basicMeshes->LoadPlaneMesh();
-	m_basicMeshes->LoadPrismMesh();
-
+/***********************************************************
+ *  BeginProfiledPass()
+ *
+ *  This method is used for starting the timing of a pass and
+ *  opening its debug group, so a GL capture shows the pass
+ *  by name.
+ ***********************************************************/
+void SceneManager::BeginProfiledPass(int pass)
+{
+	if (m_bPassGroupOpen[pass] == false)
+	{
+		GLDebug::PushGroup(GPUProfiler::GetPassName(pass));
+		m_bPassGroupOpen[pass] = true;
+	}
+	if (m_pGPUProfiler != NULL)
+	{
+		m_pGPUProfiler->BeginPass(pass);
+	}
 }
 
 /***********************************************************
-*  SetShaderAttributes()
-*
-*  This method is used for setting the shader's color,
-	texturing, and material attributes for the mesh.
-	- Use "none" for no texture or material.
-	- UVscale sets number of texture tiles in X&Y directions.
-	- Parameters default to white color, "none" texture,
-	  (1.0f, 1.0f) UVscale, and "none" material. Omit trailing
-	  parameters for default values.
-***********************************************************/
-void SceneManager::SetShaderAttributes(
-	glm::vec4 colorRGBA,		 // RGBA color
-	std::string texture,	   // texture name (default = "none) (from LoadSceneTextures())
-	glm::vec2 UVscale,	  // number of times texture drawn in X&Y direction (default = (1.0f, 1.0f))
-	std::string material) // name of material (default = "none") (from DefineObjectMaterials())
+ *  EndProfiledPass()
+ *
+ *  This method is used for ending the timing of a pass and
+ *  closing its debug group, when it is open.
+ ***********************************************************/
+void SceneManager::EndProfiledPass(int pass)
 {
-	// set RGBA color
-	SetShaderColor(colorRGBA.x, colorRGBA.y, colorRGBA.z, colorRGBA.w);
-	// Set texture if provided
-	if (texture != "none")
+	if (m_bPassGroupOpen[pass] == true)
 	{
-		SetShaderTexture(texture);
+		GLDebug::PopGroup();
+		m_bPassGroupOpen[pass] = false;
 	}
-	// Set UV scale
-	SetTextureUVScale(UVscale.x, UVscale.y);
-	// Set material if provided
-	if (material != "none")
+	if (m_pGPUProfiler != NULL)
 	{
-		SetShaderMaterial(material);
+		m_pGPUProfiler->EndPass(pass);
 	}
 }
 
 /***********************************************************
- *  DrawMeshTransformation()
+ *  RenderSecondaryView()
  *
- *  This method is used for drawing a basic 3D shape given parameter
- *  vectors for color, scale, rotation, position. Must pass the ShapeMeshes object,
- *  and must use the drawing functions in the ShapeMeshWrappers.h wrapper class. This
- *  allows the use of all default parameter arguments from ShapeMeshes class.
- *  don't use ShapeMeshes::DrawCylinderMesh use instead-> ShapeMeshWrapper::DrawCylinderMeshWrapper
+ *  This method is used for drawing the scene once more into
+ *  a part of the frame, after SubmitScene(), from the view
+ *  matrices and position set since. The scene update of
+ *  the frame is not repeated; only the culling, sorting
+ *  and upload of the draws, and when the new view sees the
+ *  same draws in the same order, the instance copy of the
+ *  main view is drawn again instead of written anew. The
+ *  G-buffer and transparency targets are sized for the
+ *  whole frame, so the view is shaded forward with its
+ *  glass blended in depth order.
  ***********************************************************/
-void SceneManager::DrawMeshTransformation(
-	glm::vec3 scaleXYZ,					// shape XYZ scale
-	glm::vec3 rotationDegreesXYZ,	  // shape XYZ rotation
-	glm::vec3 positionXYZ,			 // XYZ position of shape
-	ShapeMeshes* meshObject,		// pointer to ShapeMesh object
-	MeshDrawFunction drawMeshFunction) // pointer to function used to draw specific shape (see notes)
+void SceneManager::RenderSecondaryView(const GLint viewport[4])
 {
-	// Set transform buffer using passed in arguments
-	SetTransformations(
-		scaleXYZ, // Scale
-		rotationDegreesXYZ.x, // X axis rotation
-		rotationDegreesXYZ.y, // Y axis rotation
-		rotationDegreesXYZ.z, // Z axis rotation
-		positionXYZ); // XYZ position
-	
-	// Draws the object with the function pointer passed, must be from ShapeMeshWrapper class.
-	drawMeshFunction(meshObject);
+	PROFILE_SCOPE("RenderSecondaryView");
+	GLint frameViewport[4];
+	glGetIntegerv(GL_VIEWPORT, frameViewport);
+	glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+
+	// clear only the part of the frame the view covers
+	glEnable(GL_SCISSOR_TEST);
+	glScissor(viewport[0], viewport[1], viewport[2], viewport[3]);
+	GLTrace::RecordClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	glDisable(GL_SCISSOR_TEST);
+
+	bool bDeferredShading = m_bDeferredShading;
+	bool bOrderIndependentTransparency = m_bOrderIndependentTransparency;
+	m_bDeferredShading = false;
+	m_bOrderIndependentTransparency = false;
+
+	BuildView(false);
+	SubmitRenderList();
+
+	m_bDeferredShading = bDeferredShading;
+	m_bOrderIndependentTransparency = bOrderIndependentTransparency;
+	m_bPrimaryView = true;
+	glViewport(frameViewport[0], frameViewport[1], frameViewport[2], frameViewport[3]);
 }
 
 /***********************************************************
- *  RenderScene()
+ *  SetStereo()
  *
- *  This method is used for rendering the 3D scene by
- *  transforming and drawing the basic 3D shapes
+ *  This method is used for drawing every frame into both
+ *  layers of a multiview target at once. The G-buffer, the
+ *  transparency targets and the depth pyramid have a single
+ *  layer, so a stereo frame is forward shaded, sorts its
+ *  glass and skips the depth pre-pass and the GPU culling
+ *  against the depth of the frame before; the draws are
+ *  culled against the view set with SetViewMatrices(),
+ *  which encloses both eyes.
  ***********************************************************/
-void SceneManager::RenderScene()
+void SceneManager::SetStereo(bool bEnable)
+{
+	m_bStereo = bEnable;
+}
+
+/***********************************************************
+ *  SetAntiAliasing()
+ *
+ *  This method is used for picking how the main view is
+ *  anti-aliased: multisampled targets of the render graph
+ *  resolved into the frame, or FXAA or the temporal
+ *  anti-aliasing of the post effects. It may change every
+ *  frame; the targets come from the graph pool either way.
+ ***********************************************************/
+void SceneManager::SetAntiAliasing(int mode)
+{
+	m_antiAliasing = glm::clamp(mode, 0, (int)PostStack::AA_COUNT - 1);
+	m_pPostStack->SetAntiAliasing(m_antiAliasing);
+}
+
+/***********************************************************
+ *  GetMeshletBatch()
+ *
+ *  This method is used for getting the meshlet batch of a
+ *  draw batch, -1 when it has none. The meshlets are culled
+ *  for the main view only, so the extra views draw every
+ *  batch with its own command.
+ ***********************************************************/
+int SceneManager::GetMeshletBatch(size_t batchIndex) const
+{
+	if (IsGPUCullingActive() == false)
+	{
+		return(-1);
+	}
+	return(m_batchMeshletBatches[batchIndex]);
+}
+
+/***********************************************************
+ *  DefineSceneObjects()
+ *
+ *  This method is used for describing the 3D scene by
+ *  transforming and drawing the basic 3D shapes. It runs
+ *  once from PrepareScene() and its draws are recorded into
+ *  the render list, so changes here need a new PrepareScene()
+ ***********************************************************/
+void SceneManager::DefineSceneObjects()
 {
 	//***********************DRAW OBJECTS*****************************//
 	/*** Set needed transformations before drawing the basic mesh.  ***/
@@ -633,6 +7745,9 @@ void SceneManager::RenderScene()
 	/*** and drawing all the basic 3D shapes.						       ***/
 	/******************************************************************/
 
+	// the backdrop, ledge and countertop never move
+	SetStaticGeometry(true);
+
 	// BACKGROUND PLANE:
 	SetShaderAttributes(
 		glm::vec4(.3, .3, .3, 1),  // shader RGBA color
@@ -644,7 +7759,7 @@ void SceneManager::RenderScene()
 		glm::vec3(90.0f, 0.0f, 0.0f),		// shape XYZ rotation
 		glm::vec3(0.0f, 3.5f, -10.0f),		// XYZ position of shape
 		m_basicMeshes,							// pointer to ShapeMesh object
-		ShapeMeshWrappers::DrawPlaneMeshWrapper);	// pointer to function used to draw specific shape
+		ShapeMeshWrappers::Plane);	// descriptor of the mesh to draw
 
 	// BACKGROUND LEDGE
 	SetShaderAttributes(
@@ -657,7 +7772,7 @@ void SceneManager::RenderScene()
 		glm::vec3(0.0f, 0.0f, 0.0f),	   // shape XYZ rotation
 		glm::vec3(0.0f, 7.0f, -9.5f),	  // XYZ position of shape
 		m_basicMeshes,						 // pointer to ShapeMesh object
-		ShapeMeshWrappers::DrawBoxMeshWrapper);	// pointer to function used to draw specific shape
+		ShapeMeshWrappers::Box);	// descriptor of the mesh to draw
 
 	// COUNTERTOP
 	SetShaderAttributes(
@@ -670,13 +7785,20 @@ void SceneManager::RenderScene()
 		glm::vec3(0.0f, 0.0f, 0.0f),	   // shape XYZ rotation
 		glm::vec3(0.0f, -1.0f, -3.5f),	  // XYZ position of shape
 		m_basicMeshes,						 // pointer to ShapeMesh object
-		ShapeMeshWrappers::DrawBoxMeshWrapper);	// pointer to function used to draw specific shape
+		ShapeMeshWrappers::Box);	// descriptor of the mesh to draw
 
-	 // GLASS JAR (complex object):
-	DrawJar(6.0f, 0.0f, -6.2f);
+	SetStaticGeometry(false);
+
+	// GLASS JAR (complex object):
+	PlacePrefab(GetBuiltInPrefab("jar"), "jar",
+		glm::vec3(1.0f, 1.0f, 1.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(6.0f, 0.0f, -6.2f));
 
 	// CUP WITH STRAW (complex object):
-	DrawCup(-3.0f, 0.0f, -4.2f);
+	PlacePrefab(GetBuiltInPrefab("cup"), "cup",
+		glm::vec3(1.0f, 1.0f, 1.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(-3.0f, 0.0f, -4.2f));
+
+	// the coaster and cutting board never move either
+	SetStaticGeometry(true);
 
 	// MARBLE COASTER UNDER CUP
 	SetShaderAttributes(
@@ -689,7 +7811,7 @@ void SceneManager::RenderScene()
 		glm::vec3(0.0f, 0.0f, 0.0f),	   // shape XYZ rotation
 		glm::vec3(-3.0f, 0.0f, -4.0f),	  // XYZ position of shape
 		m_basicMeshes,						 // pointer to ShapeMesh object
-		ShapeMeshWrappers::DrawCylinderMeshWrapper);	// pointer to function used to draw specific shape
+		ShapeMeshWrappers::Cylinder);	// descriptor of the mesh to draw
 
 	// CUTTING BOARD
 	SetShaderAttributes(
@@ -702,366 +7824,17 @@ void SceneManager::RenderScene()
 		glm::vec3(0.0f, -20.0f, 0.0f),   // XYZ rotation
  		glm::vec3(3.0f, 0.15f, -1.5f),  // XYZ position
 		m_basicMeshes,
-		ShapeMeshWrappers::DrawBoxMeshWrapper); // mesh shape function
+		ShapeMeshWrappers::Box); // descriptor of the mesh to draw
+
+	SetStaticGeometry(false);
 
 	// CUCUMBER
-	DrawCucumber(3.8f, 0.3f, -3.0f);
+	PlacePrefab(GetBuiltInPrefab("cucumber"), "cucumber",
+		glm::vec3(1.0f, 1.0f, 1.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(3.8f, 0.3f, -3.0f));
 
 	// KNIFE
-	DrawKnife(0.6f, 0.25f, -0.7f);
-}
-
-/***********************************************************
- *  DrawJar()
- *
- *  This method is used by RenderScene() to draw and transform
- *  a complex 3D object of multiple basic 3D shapes. Created to
- *  reduce complexity of the RenderScene() method.
- ***********************************************************/
-void SceneManager::DrawJar(float x_pos, float y_pos, float z_pos)
-{
-	// Position of the entire object.
-	float jarX_pos = x_pos;
-	float jarY_pos = y_pos;
-	float jarZ_pos = z_pos;
-
-	glm::vec4 baseShaderColorRGBA = glm::vec4(0.7, 0.7, 0.9, 0.8);
-	std::string baseTexture = "glass13";
-	std::string lidTexture = "glass10";
-	glm::vec2 baseUVscale = glm::vec2(1.0f, 0.35f);
-	std::string baseMaterial = "glass";
-
-	/********************[DRAW GLASS JAR (complex)]************************/
-	  // set initial color, texture, UVscale
-	SetShaderAttributes(
-		baseShaderColorRGBA, // shader RGBA color
-		baseTexture,		  // memory-loaded texture name
-		baseUVscale,		 // X and Y UVscale
-		baseMaterial);		// Material Tag
-
-	   /********Transform each individual shape from bottom to top******/
-	// ROUNDED BASE BOTTOM SPHERE:
-	DrawMeshTransformation(
-		glm::vec3(2.0f, 0.3f, 2.0f),		// shape XYZ scale
-		glm::vec3(0.0f, 0.0f, 0.0f),		// shape XYZ rotation
-		glm::vec3(jarX_pos + 0.0f, jarY_pos + 0.15f, jarZ_pos + 0.0f), // XYZ position of shape
-		m_basicMeshes,							// pointer to ShapeMesh object
-		ShapeMeshWrappers::DrawSphereMeshWrapper);	// pointer to function used to draw specific shape
-	// CYLINDER BASE:
-	DrawMeshTransformation(
-		glm::vec3(2.0f, 4.05f, 2.0f),		// shape XYZ scale
-		glm::vec3(0.0f, 0.0f, 0.0f),		// shape XYZ rotation
-		glm::vec3(jarX_pos + 0.0f, jarY_pos + 0.15f, jarZ_pos + 0.0f), // XYZ position of shape
-		m_basicMeshes,							// pointer to ShapeMesh object
-		ShapeMeshWrappers::DrawCylinderMeshWrapper);	// pointer to function used to draw specific shape
-	//ROUNDED BASE TOP SPHERE :
-	SetTextureUVScale(1.0, 0.25); // adjust scale to align shape textures
-	DrawMeshTransformation(
-		glm::vec3(2.02f, 0.7f, 2.02f),		// shape XYZ scale
-		glm::vec3(0.0f, -10.0f, 0.0f),		// shape XYZ rotation
-		glm::vec3(jarX_pos + 0.0f, jarY_pos + 4.2f, jarZ_pos + 0.0f), // XYZ position of shape
-		m_basicMeshes,							// pointer to ShapeMesh object
-		ShapeMeshWrappers::DrawSphereMeshWrapper);	// pointer to function used to draw specific shape
-	//ROUNDED NECK CYLINDER:
-	SetTextureUVScale(0.8f, 0.1f); // adjust scale to align shape textures
-	DrawMeshTransformation(
-		glm::vec3(1.6f, 0.80f, 1.6f),		// shape XYZ scale
-		glm::vec3(0.0f, 8.0f, 0.0f),		// shape XYZ rotation
-		glm::vec3(jarX_pos + 0.0f, jarY_pos + 4.4f, jarZ_pos + 0.0f), // XYZ position of shape
-		m_basicMeshes,							// pointer to ShapeMesh object
-		ShapeMeshWrappers::DrawCylinderMeshWrapper);	// pointer to function used to draw specific shape
-	// NECK TORUS LARGE:
-	SetTextureUVScale(1.5f, 0.3f);
-	DrawMeshTransformation(
-		glm::vec3(1.48f, 1.48f, 0.65f),		// shape XYZ scale
-		glm::vec3(90.0f, 0.0f, 0.0f),		// shape XYZ rotation
-		glm::vec3(jarX_pos + 0.0f, jarY_pos + 5.10f, jarZ_pos + 0.0f), // XYZ position of shape
-		m_basicMeshes,							// pointer to ShapeMesh object
-		ShapeMeshWrappers::DrawTorusMeshWrapper);	// pointer to function used to draw specific shape
-
-	SetShaderTexture(lidTexture);
-	SetTextureUVScale(2.0f, 1.0f); // adjust scale to align shape textures
-	// LID TORUS LARGE:
-	DrawMeshTransformation(
-		glm::vec3(1.5f, 1.5f, 0.5f),		// shape XYZ scale
-		glm::vec3(90.0f, 0.0f, 0.0f),		// shape XYZ rotation
-		glm::vec3(jarX_pos + 0.0f, jarY_pos + 5.25f, jarZ_pos + 0.0f), // XYZ position of shape
-		m_basicMeshes,							// pointer to ShapeMesh object
-		ShapeMeshWrappers::DrawTorusMeshWrapper);	// pointer to function used to draw specific shape
-	//LID SPHERE LARGE:
-	DrawMeshTransformation(
-		glm::vec3(1.6f, 0.16f, 1.6f),		// shape XYZ scale
-		glm::vec3(0.0f, 0.0f, 0.0f),		// shape XYZ rotation
-		glm::vec3(jarX_pos + 0.0f, jarY_pos + 5.25f, jarZ_pos + 0.0f), // XYZ position of shape
-		m_basicMeshes,							// pointer to ShapeMesh object
-		ShapeMeshWrappers::DrawSphereMeshWrapper);	// pointer to function used to draw specific shape
-	// LID CYLINDER:
-	SetTextureUVScale(2.0f, 1.0f);
-	DrawMeshTransformation(
-		glm::vec3(0.9f, 0.5f, 0.9f),		// shape XYZ scale
-		glm::vec3(0.0f, 0.0f, 0.0f),		// shape XYZ rotation
-		glm::vec3(jarX_pos + 0.0f, jarY_pos + 5.2f, jarZ_pos + 0.0f), // XYZ position of shape
-		m_basicMeshes,							// pointer to ShapeMesh object
-		ShapeMeshWrappers::DrawCylinderMeshWrapper);	// pointer to function used to draw specific shape
-	SetTextureUVScale(1.5f, 1.0f);
-	// LID TORUS SMALL:
-	DrawMeshTransformation(
-		glm::vec3(1.1f, 1.1f, 0.5f),		// shape XYZ scale
-		glm::vec3(90.0f, 0.0f, 0.0f),		// shape XYZ rotation
-		glm::vec3(jarX_pos + 0.0f, jarY_pos + 5.7f, jarZ_pos + 0.0f), // XYZ position of shape
-		m_basicMeshes,							// pointer to ShapeMesh object
-		ShapeMeshWrappers::DrawTorusMeshWrapper);	// pointer to function used to draw specific shape
-	// LID SPHERE TOP:
-	DrawMeshTransformation(
-		glm::vec3(1.1f, 0.2f, 1.1f),		// shape XYZ scale
-		glm::vec3(0.0f, 0.0f, 0.0f),		// shape XYZ rotation
-		glm::vec3(jarX_pos + 0.0f, jarY_pos + 5.65f, jarZ_pos + 0.0f), // XYZ position of shape
-		m_basicMeshes,							// pointer to ShapeMesh object
-		ShapeMeshWrappers::DrawSphereMeshWrapper);	// pointer to function used to draw specific shape
-}
-
-/*********Complex Object Functions***************************
-* The following functions are used by RenderScene() to draw	*
-* and transform a complex 3D object of multiple 3D shapes	*
-* and/or textures/materials.											*
-* Created to reduce complexity of the RenderScene() method.	*
-************************************************************/
-
-/***********************************************************
- *  DrawCup()
- *
- *  Draws a plastic/metal cup object
- ***********************************************************/
-void SceneManager::DrawCup(float x_pos, float y_pos, float z_pos)
-{
-	// Position of the entire object.
-	float cupX_pos = x_pos;
-	float cupY_pos = y_pos;
-	float cupZ_pos = z_pos;
-
-	glm::vec4 baseShaderColorRGBA = glm::vec4(0.6, 0.1, 0.1, 1.0);
-	std::string baseTexture = "none";
-	std::string metalTexture = "metal";
-	glm::vec2 baseUVscale = glm::vec2(3.0f, 0.8f);
-	std::string baseMaterial = "plastic";
-	std::string metalMaterial = "metal";
-
-	/********************[DRAW CUP (complex)]************************/
-	  // set initial color, texture, UVscale
-	SetShaderAttributes(
-		baseShaderColorRGBA, // shader RGBA color
-		baseTexture,		  // memory-loaded texture name
-		baseUVscale,		 // X and Y UVscale
-		baseMaterial);		// Material Tag
-	/********Transform each individual shape from bottom to top******/
-	// BASE TAPERED CYLINDER:
-	DrawMeshTransformation(
-		glm::vec3(1.5f, 6.49f, 1.5f),		// shape XYZ scale
-		glm::vec3(0.0f, 0.0f, 180.0f),		// shape XYZ rotation
-		glm::vec3(cupX_pos + 0.0f, cupY_pos + 4.5f, cupZ_pos + 0.0f), // XYZ position of shape
-		m_basicMeshes,							// pointer to ShapeMesh object
-		ShapeMeshWrappers::DrawTaperedCylinderMeshWrapper);	// pointer to function used to draw specific shape
-
-	// TOP METALLIC LIP
-	SetShaderAttributes( // metal texture and material
-		baseShaderColorRGBA, // shader RGBA color
-		metalTexture,		  // memory-loaded texture name
-		baseUVscale,		 // X and Y UVscale
-		metalMaterial);   // Material Tag
-	DrawMeshTransformation(
-		glm::vec3(1.5f, 1.0f, 1.5f),		// shape XYZ scale
-		glm::vec3(0.0f, 0.0f, 0.0f),		// shape XYZ rotation
-		glm::vec3(cupX_pos + 0.0f, cupY_pos + 4.5f, cupZ_pos + 0.0f), // XYZ position of shape
-		m_basicMeshes,							// pointer to ShapeMesh object
-		ShapeMeshWrappers::DrawHollowCylinderMeshWrapper);	// pointer to function used to draw specific shape
-
-	// METALLIC STRAW
-	SetTextureUVScale(1.0f, 5.0f);
-	DrawMeshTransformation(
-		glm::vec3(0.2f, 7.5f, 0.2f),		// shape XYZ scale
-		glm::vec3(14.6f, 0.0f, 10.5f),		// shape XYZ rotation
-		glm::vec3(cupX_pos + 0.35f, cupY_pos + 0.0f, cupZ_pos + -0.35f), // XYZ position of shape
-		m_basicMeshes,							// pointer to ShapeMesh object
-		ShapeMeshWrappers::DrawHollowCylinderMeshWrapper);	// pointer to function used to draw specific shape
-}
-
-/***********************************************************
- *  DrawCucumber()
- *
- *  Draws a sliced cucumber object
- ***********************************************************/
-void SceneManager::DrawCucumber(float x_pos, float y_pos, float z_pos)
-{
-	// Position of the entire object.
-	float xPos = x_pos;
-	float yPos = y_pos;
-	float zPos = z_pos;
-
-	glm::vec4 baseShaderColorRGBA = glm::vec4(0.2, 0.5, 0.2, 1.0);
-	std::string outerTexture = "cucumber_outer";
-	std::string innerTexture = "cucumber_inner";
-	glm::vec2 baseUVscale = glm::vec2(1.0f, 1.0f);
-	std::string baseMaterial = "organic";
-
-	/********************[DRAW CUCUMBER (complex)]************************/
-	 // set initial color, texture, UVscale
-	SetShaderAttributes(
-		baseShaderColorRGBA, // shader RGBA color
-		outerTexture,		  // memory-loaded texture name
-		baseUVscale,		 // X and Y UVscale
-		baseMaterial);		// Material Tag
-
-   /********Transform each individual shape******/
-	// Long Cucumber slice
-	DrawMeshTransformation( // cylinder
-		glm::vec3(0.7f, 2.8f, 0.7f),		// shape XYZ scale
-		glm::vec3(0.0f, -25.0f, 90.0f),		// shape XYZ rotation
-		glm::vec3(xPos + 0.0f, yPos + 0.7f, zPos + 0.0f), // XYZ position of shape
-		m_basicMeshes,							// pointer to ShapeMesh object
-		ShapeMeshWrappers::DrawHollowCylinderMeshWrapper);	// pointer to function used to draw specific shape
-	SetShaderTexture(innerTexture);
-	m_basicMeshes->DrawCylinderMesh(false, true, false); // draw bottom only
-	SetShaderTexture(outerTexture);
-
-	DrawMeshTransformation( // sphere end
-		glm::vec3(1.0f, 0.7f, 0.7f),		// shape XYZ scale
-		glm::vec3(0.0f, -25.0f, 0.0f),		// shape XYZ rotation
-		glm::vec3(xPos + -2.538f, yPos + 0.7f, zPos + -1.183f), // XYZ position of shape
-		m_basicMeshes,							// pointer to ShapeMesh object
-		ShapeMeshWrappers::DrawSphereMeshWrapper);	// pointer to function used to draw specific shape
-
-
-	
-	// 5 small cucumber slices
-	DrawMeshTransformation( // cylinder
-		glm::vec3(0.7f, 0.15f, 0.7f),		// shape XYZ scale
-		glm::vec3(0.0f, 0.0f, 0.0f),		// shape XYZ rotation
-		glm::vec3(xPos + 0.9f, yPos + 0.0f, zPos + 0.2f), // XYZ position of shape
-		m_basicMeshes,							// pointer to ShapeMesh object
-		ShapeMeshWrappers::DrawHollowCylinderMeshWrapper);	// pointer to function used to draw specific shape
-	SetShaderTexture(innerTexture);
-	m_basicMeshes->DrawCylinderMesh(true, true, false);
-
-	SetShaderTexture(outerTexture);
-	DrawMeshTransformation( // cylinder
-		glm::vec3(0.7f, 0.15f, 0.7f),		// shape XYZ scale
-		glm::vec3(-3.5f, 0.0f, 0.0f),		// shape XYZ rotation
-		glm::vec3(xPos + 1.35f, yPos + 0.02f, zPos + 2.0f), // XYZ position of shape
-		m_basicMeshes,							// pointer to ShapeMesh object
-		ShapeMeshWrappers::DrawHollowCylinderMeshWrapper);	// pointer to function used to draw specific shape
-	SetShaderTexture(innerTexture);
-	m_basicMeshes->DrawCylinderMesh(true, true, false);
-
-	SetShaderTexture(outerTexture);
-	DrawMeshTransformation( // cylinder
-		glm::vec3(0.75f, 0.17f, 0.7f),		// shape XYZ scale
-		glm::vec3(0.0f, -5.0f, 0.0f),		// shape XYZ rotation
-		glm::vec3(xPos + 1.3f, yPos + 0.15f, zPos + 0.9f), // XYZ position of shape
-		m_basicMeshes,							// pointer to ShapeMesh object
-		ShapeMeshWrappers::DrawHollowCylinderMeshWrapper);	// pointer to function used to draw specific shape
-	SetShaderTexture(innerTexture);
-	m_basicMeshes->DrawCylinderMesh(true, true, false);
-
-	SetShaderTexture(outerTexture);
-	DrawMeshTransformation( // cylinderq
-		glm::vec3(0.7f, 0.13f, 0.65f),		// shape XYZ scale
-		glm::vec3(0.0f, -1.0f, -1.5f),		// shape XYZ rotation
-		glm::vec3(xPos + 1.2f, yPos + 0.3f, zPos + 0.7f), // XYZ position of shape
-		m_basicMeshes,							// pointer to ShapeMesh object
-		ShapeMeshWrappers::DrawHollowCylinderMeshWrapper);	// pointer to function used to draw specific shape
-	SetShaderTexture(innerTexture);
-	m_basicMeshes->DrawCylinderMesh(true, true, false);
-
-	SetShaderTexture(outerTexture);
-	DrawMeshTransformation( // cylinder
-		glm::vec3(0.7f, 0.2f, 0.65f),		// shape XYZ scale
-		glm::vec3(0.0f, -1.0f, -3.0f),		// shape XYZ rotation
-		glm::vec3(xPos + 0.7f, yPos + 0.45f, zPos + 0.4f), // XYZ position of shape
-		m_basicMeshes,							// pointer to ShapeMesh object
-		ShapeMeshWrappers::DrawHollowCylinderMeshWrapper);	// pointer to function used to draw specific shape
-	SetShaderTexture(innerTexture);
-	m_basicMeshes->DrawCylinderMesh(true, true, false);
-}
-
-/***********************************************************
- *  DrawKnife()
- *
- *  Draws a knife with wooden handle.
- ***********************************************************/
-void SceneManager::DrawKnife(float x_pos, float y_pos, float z_pos)
-{
-	// Position of the entire object.
-	float xPos = x_pos;
-	float yPos = y_pos;
-	float zPos = z_pos;
-
-	glm::vec4 baseShaderColorRGBA = glm::vec4(0.3, 0.3, 0.2, 1.0);
-	std::string handleTexture = "wood";
-	std::string bladeTexture = "metal";
-	glm::vec2 baseUVscale = glm::vec2(1.0f, 1.0f);
-	std::string handleMaterial = "wood";
-	std::string bladeMaterial = "metal";
-
-	/********************[DRAW KNIFE (complex)]************************/
-	 // set initial color, texture, UVscale
-	SetShaderAttributes(
-		baseShaderColorRGBA, // shader RGBA color
-		bladeTexture,		  // memory-loaded texture name
-		baseUVscale,		 // X and Y UVscale
-		bladeMaterial);		// Material Tag
-
-	/********Transform each individual shape******/
-	// Handle Base Wood Tapered Cylinder
-	SetShaderAttributes(
-		baseShaderColorRGBA, // shader RGBA color
-		handleTexture,		  // memory-loaded texture name
-		baseUVscale,		 // X and Y UVscale
-		handleMaterial);	// Material Tag
-	DrawMeshTransformation(
-		glm::vec3(0.45f, 2.9f, 0.35f),		// shape XYZ scale
-		glm::vec3(90.0f, 178.0f, 80.0f),		// shape XYZ rotation
-		glm::vec3(xPos + -3.0f, yPos + 0.35f, zPos + 0.0f), // XYZ position of shape
-		m_basicMeshes,							// pointer to ShapeMesh object
-		ShapeMeshWrappers::DrawTaperedCylinderMeshWrapper);	// pointer to function used to draw specific shape
-
-	// Handle End Metal Cylinder
-	SetShaderAttributes(
-		baseShaderColorRGBA, // shader RGBA color
-		bladeTexture,		  // memory-loaded texture name
-		baseUVscale,		 // X and Y UVscale
-		bladeMaterial);	// Material Tag
-	DrawMeshTransformation(
-		glm::vec3(0.451f, 0.1f, 0.351f),		// shape XYZ scale
-		glm::vec3(90.0f, 178.0f, 80.0f),		// shape XYZ rotation
-		glm::vec3(xPos + -3.01f, yPos + 0.35f, zPos + 0.0f), // XYZ position of shape
-		m_basicMeshes,							// pointer to ShapeMesh object
-		ShapeMeshWrappers::DrawCylinderMeshWrapper);	// pointer to function used to draw specific shape
-	
-	// Blade Beginning Metal cylinder
-	DrawMeshTransformation(
-		glm::vec3(0.27f, 0.35f, 0.2f),		// shape XYZ scale
-		glm::vec3(90.0f, 178.0f, 80.0f),		// shape XYZ rotation
-		glm::vec3(xPos + -0.4f, yPos + 0.27f, zPos + 0.45f), // XYZ position of shape
-		m_basicMeshes,							// pointer to ShapeMesh object
-		ShapeMeshWrappers::DrawCylinderMeshWrapper);	// pointer to function used to draw specific shape
-
-	// Blade Base Metal Rectangle
-	DrawMeshTransformation(
-		glm::vec3(0.65f, 4.5f, 0.02f),		// shape XYZ scale
-		glm::vec3(88.0f, 178.0f, 80.0f),		// shape XYZ rotation
-		glm::vec3(xPos + -0.05f, yPos + 0.27f, zPos + 0.1f), // XYZ position of shape
-		m_basicMeshes,							// pointer to ShapeMesh object
-		ShapeMeshWrappers::DrawCylinderMeshWrapper);	// pointer to function used to draw specific shape
-
-	// Blade Tip Metal Pyramid
-	SetTextureUVScale(0.3f, 0.3f);
-	DrawMeshTransformation(
-		glm::vec3(1.43f, 1.25f, 0.02f),		// shape XYZ scale
-		glm::vec3(88.0f, 178.0f, 105.0f),		// shape XYZ rotation
-		glm::vec3(xPos + 4.65f, yPos + 0.125f, zPos + 0.675f), // XYZ position of shape
-		m_basicMeshes,							// pointer to ShapeMesh object
-		ShapeMeshWrappers::DrawPyramid4MeshWrapper);	// pointer to function used to draw specific shape
-
+	PlacePrefab(GetBuiltInPrefab("knife"), "knife",
+		glm::vec3(1.0f, 1.0f, 1.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.6f, 0.25f, -0.7f));
 }
 
 /***************CHALLENGES*************************
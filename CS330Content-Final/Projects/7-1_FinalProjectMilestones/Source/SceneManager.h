@@ -14,9 +14,55 @@
 #pragma once
 
 #include "ShaderManager.h"
+#include "JobSystem.h"
+#include "GPUProfiler.h"
+#include "GPUBuffer.h"
+#include "CommandBuffer.h"
 #include "ShapeMeshes.h"
 #include "ShapeMeshWrappers.h"
+#include "SceneBVH.h"
+#include "OcclusionCuller.h"
+#include "MeshletCuller.h"
+#include "PrimitiveGenerator.h"
+#include "TransparencyPass.h"
+#include "LightClusters.h"
+#include "DeferredPass.h"
+#include "ShadingRate.h"
+#include "TargetFormats.h"
+#include "RenderGraph.h"
+#include "PostStack.h"
+#include "ShadowAtlas.h"
+#include "CascadedShadows.h"
+#include "ReflectionProbes.h"
+#include "ImpostorAtlas.h"
+#include "ObjectPicker.h"
+#include "OcclusionQueries.h"
+#include "RenderStateCache.h"
+#include "InstanceExpander.h"
+#include "DirtyRangeBuffer.h"
+#include "SceneAnimation.h"
+#include "ParticleSystem.h"
+#include "GPUTextureCompressor.h"
+#include "SceneTransforms.h"
+#include "SceneFile.h"
+#include "StaticGeometry.h"
+#include "WorldChunks.h"
+#include "LightmapBaker.h"
+#include "UploadRing.h"
+#include "TextureTable.h"
+#include "TagRegistry.h"
+#include "TextureStreamer.h"
+#include "CompressedTexture.h"
+#include "TextureCache.h"
+#include "TextureResidency.h"
+#include "VirtualTextures.h"
+#include "ModelImporter.h"
+#include "ResourceManager.h"
+#include "FileWatcher.h"
 
+#include <glm/gtc/quaternion.hpp>
+
+#include <functional>
 #include <string>
 #include <vector>
 
@@ -30,8 +76,11 @@ class SceneManager
 {
 public:
 
-	// constructor
-	SceneManager(ShaderManager *pShaderManager);
+	// constructor; the instance data and indirect commands of every
+	// frame are written through the upload ring, and the meshes,
+	// textures and programs are owned by the resource manager
+	SceneManager(ShaderManager *pShaderManager, UploadRing* pUploadRing, JobSystem* pJobSystem,
+		ResourceManager* pResources);
 	// destructor
 	~SceneManager();
 
@@ -39,8 +88,18 @@ public:
 	{
 		std::string tag;
 		uint32_t ID;
+		bool bHasAlpha;		// loaded from an RGBA image
+		std::string filename;	// file the mip levels are read back from
+		bool bCompressed;	// filename is a KTX2 or DDS file
+		bool bVirtual;		// sparse, paged in from a tiled file by VirtualTextures
+		ResourceManager::TEXTURE_HANDLE resource;	// ID as the resource manager owns it
 	};
 
+	// interned tags of the loaded textures and defined materials;
+	// TagRegistry::INVALID_HANDLE stands for "none"
+	typedef TagRegistry::HANDLE TextureHandle;
+	typedef TagRegistry::HANDLE MaterialHandle;
+
 	struct OBJECT_MATERIAL
 	{
 		float ambientStrength;
@@ -48,32 +107,694 @@ public:
 		glm::vec3 diffuseColor;
 		glm::vec3 specularColor;
 		float shininess;
+		float reflectivity;	// share of the reflection probes head on, 0 for none
 		std::string tag;
+		bool bTransparent;	// drawn in the transparent pass, like glass
+		bool bCoarseShading;	// may be lit coarsely where it shows little detail
+	};
+
+	// capacity of the MaterialData block declared in the fragment shader
+	static const int MAX_MATERIALS = 32;
+
+	// capacity of the LightData block declared in the fragment shader
+	// and the light cluster compute shader
+	static const int MAX_LIGHTS = 64;
+	// lights a forward draw is shaded by when they are picked per
+	// draw, packed into the spare normal matrix components of its
+	// instance with the count, one byte each
+	static const int MAX_OBJECT_LIGHTS = 8;
+
+	// shading a light runs in the fragment shaders, decided for every
+	// light when the lights are uploaded
+	enum LIGHT_TYPE
+	{
+		LIGHT_TYPE_AMBIENT = 0,		// no direct light, only the ambient term
+		LIGHT_TYPE_DIFFUSE,			// direct light without a highlight
+		LIGHT_TYPE_POINT,			// direct light with a highlight
+		LIGHT_TYPE_OFF				// faded out by the light LOD, in no cluster
 	};
 
+	// std140 layout of one LightSource in the LightData block
+	struct LIGHT_SOURCE
+	{
+		glm::vec3 position;
+		float focalStrength;		// strength of emitted focal beam
+		glm::vec3 ambientColor;
+		float specularIntensity;	// strength of emitted specular light
+		glm::vec3 diffuseColor;
+		float radius;				// reach of the light, 0 for the whole scene,
+									// negative for a directional light, whose
+									// position is the direction towards it
+		glm::vec3 specularColor;
+		GLint shadowIndex;			// ShadowData entry, or 0 for the cascades of
+									// the key light, set by UpdateShadowMaps()
+		GLint lightType;			// LIGHT_TYPE, set by UploadLights()
+		GLfloat fade;				// 0 to 1 fade of the light LOD, set by
+									// UploadLights()
+		GLint padding[2];
+	};
+
+	struct SHADER_UNIFORMS
+	{
+		UniformHandle<glm::mat4> model;
+		UniformHandle<glm::mat3> normalMatrix;
+		UniformHandle<glm::vec4> objectColor;
+		UniformHandle<int> textureIndex;
+		UniformHandle<glm::vec2> UVscale;
+		UniformHandle<int> materialIndex;
+		UniformHandle<int> instanceData;
+		UniformHandle<int> instanceBase;
+		UniformHandle<int> shadowAtlas;
+		UniformHandle<int> cascadeShadowMap;
+		UniformHandle<int> reflectionProbes;
+		UniformHandle<int> textureArray;
+		UniformHandle<int> lightmap;
+		UniformHandle<int> lightmapEnabled;
+	};
+
+	// texture unit of the instance buffer, above the scene textures
+	static const int INSTANCE_DATA_TEXTURE_UNIT = 16;
+	// texture unit of the lightmap atlas of the static geometry
+	static const int LIGHTMAP_TEXTURE_UNIT = 27;
+
+	// per-instance values of a render list draw in the instance buffer
+	struct INSTANCE_DATA
+	{
+		glm::mat4 model;
+		glm::vec4 color;
+		glm::vec4 UVscaleMaterial;	// xy = UV scale, z = material ID, w = texture index
+		glm::vec4 normalMatrix[3];	// columns of the normal matrix, w the light
+									// list of PackObjectLights(), 0 for none
+	};
+
+	// one recorded draw of the retained render list, with the
+	// shader state it was described with
+	struct DRAW_RECORD
+	{
+		ShapeMeshes::DRAW_RANGE range;	// the range at the LOD level drawn
+		int rangeID;		// index into m_meshRanges
+		int lodRangeIDs[ShapeMeshes::MESH_LOD_COUNT];	// m_meshRanges index of each LOD level
+		int lod;		// LOD level picked for the last frame the draw was visible
+		glm::vec4 color;
+		glm::vec2 UVscale;
+		int textureSlot;	// -1 draws with the untextured program
+		int materialID;
+		bool bTransparent;	// drawn back to front after the opaque draws
+		int nodeID;		// scene node the model matrix comes from, -1 for none
+		bool bStatic;		// never moves, baked into m_staticGeometry when opaque
+	};
+
+	// one ray of a scene query, the distance in multiples of the
+	// direction, which does not need to be normalized
+	struct RAY_QUERY
+	{
+		glm::vec3 origin;
+		glm::vec3 direction;
+		float maxDistance;
+	};
+	// the triangle a ray hit first, drawIndex -1 for none
+	struct RAY_HIT
+	{
+		int drawIndex;
+		float distance;
+		glm::vec3 position;
+		glm::vec3 normal;	// world space, facing the ray
+	};
+
+	// counters for the view frustum culling of the render list
+	struct CULL_STATS
+	{
+		unsigned long long drawsTested;	// draws tested against the frustum
+		unsigned long long drawsCulled;	// draws found outside of it
+	};
+
+	// counters for the impostors of the composite objects
+	struct IMPOSTOR_STATS
+	{
+		unsigned long long impostorsDrawn;	// quads drawn by the main view
+		unsigned long long drawsReplaced;	// part draws they were drawn instead of
+		int shapesCaptured;		// shapes whose views are in the atlas
+	};
+
+	// counters for the prefabs of the last recording
+	struct PREFAB_STATS
+	{
+		int prefabs;		// prefabs compiled
+		int parts;			// parts of the compiled prefabs
+		int instances;		// instances placed
+		int draws;			// draw records copied for the instances
+		int mergedParts;	// part draws baked into merged groups
+		int mergedGroups;	// merged groups drawn in their place
+	};
+
+	// what the pipeline warm-ups drew and the time they took
+	struct WARMUP_STATS
+	{
+		int warmUps;			// warm-ups that drew anything
+		int combinations;		// state combinations drawn
+		int permutations;		// shader permutations among those of the last one
+		int vertexFormats;		// VAOs among those of the last one
+		double seconds;			// CPU time of the warm-ups, up to the GPU finishing
+		double lastSeconds;
+	};
+
+	// run of consecutive draws in submission order that share a
+	// mesh range, and a texture when textures are bindless
+	struct DRAW_BATCH
+	{
+		uint32_t firstInstance;	// first entry in the instance buffer
+		uint32_t instanceCount;
+		uint32_t drawIndex;		// render list entry holding the batch state
+	};
+
+	// sort key of a render list entry for the current frame
+	struct DRAW_KEY
+	{
+		uint64_t key;
+		uint32_t drawIndex;	// index into the render list
+	};
+	// sort draw keys by key, keeping the order of equal keys, as the
+	// render list is sorted every frame; long lists are split over
+	// the threads of the job system when one is given
+	static void SortDrawKeys(std::vector<DRAW_KEY>& keys, std::vector<DRAW_KEY>& scratch, JobSystem* pJobSystem);
+
 private:
 	// pointer to shader manager object
 	ShaderManager* m_pShaderManager;
+	// owner of the meshes, textures and programs below, and the
+	// handles the shape meshes and the depth pre-pass are held by
+	ResourceManager* m_pResources;
+	ResourceManager::MESH_HANDLE m_basicMeshesResource;
+	ResourceManager::PROGRAM_HANDLE m_depthPrepassResource;
 	// pointer to basic shapes object
 	ShapeMeshes* m_basicMeshes;
-	// total number of loaded textures
-	int m_loadedTextures;
-	// loaded textures info
-	TEXTURE_INFO m_textureIDs[16];
-	// defined object materials
+	// loaded textures info, indexed by texture slot
+	std::vector<TEXTURE_INFO> m_textureIDs;
+	// the loaded textures as the shaders read them, by texture slot
+	TextureTable* m_pTextureTable;
+	// decodes and uploads the images of the textures over several
+	// frames, and the placeholders it replaced that the texture
+	// table may still read
+	TextureStreamer* m_pTextureStreamer;
+	std::vector<GLuint> m_streamedPlaceholders;
+	// decoded images and their mip levels kept on disk, so the next
+	// run maps them instead of decoding the image files again
+	TextureCache* m_pTextureCache;
+	// bytes of the mip levels of every texture slot, kept inside a
+	// budget by dropping the top levels of textures drawn least
+	TextureResidency* m_pTextureResidency;
+	// BC1 and BC3 encoder of the textures decoded from image files,
+	// when asked for and the texture table is bindless
+	GPUTextureCompressor* m_pTextureCompressor;
+	bool m_bCompressTextures;
+	// sparse textures of the images with a tiled file beside them,
+	// paged in from the feedback of the fragment shader
+	VirtualTextures* m_pVirtualTextures;
+	// texture slot and material ID of every tag
+	TagRegistry m_textureTags;
+	TagRegistry m_materialTags;
+	// defined object materials, indexed by material ID
 	std::vector<OBJECT_MATERIAL> m_objectMaterials;
+	// uniform buffer backing the MaterialData block, static since
+	// the materials are only uploaded again with a new scene, or a
+	// slot at a time by a live edit
+	GPUBuffer m_materialData;
+	// true when the scene is drawn with the lit shader permutations
+	bool m_bUseLighting;
+	// resolved shader uniforms
+	SHADER_UNIFORMS m_uniforms;
+	// active light sources, uploaded to the LightData block
+	std::vector<LIGHT_SOURCE> m_lights;
+	// uniform buffer backing the LightData block, dynamic since it
+	// is only written when a light changes
+	GPUBuffer m_lightData;
+	// true when m_lights changed since the last upload
+	bool m_bLightsDirty;
+	// level of detail of a light, from its share of the view: a
+	// weak light has its direct light folded into its ambient term,
+	// and a negligible one fades out, each over LIGHT_FADE_FRAMES
+	struct LIGHT_LOD
+	{
+		float fold;		// 0 to 1 share of the direct light made ambient
+		float fade;		// 1 to 0 as it fades out, negative until placed
+		bool bFolded;	// where fold is heading
+		bool bDropped;	// where fade is heading
+	};
+	// the level of every light, by index into m_lights, while the
+	// light LOD is on
+	std::vector<LIGHT_LOD> m_lightLODs;
+	bool m_bLightLOD;
+	// true when a level moved since the last upload, which does not
+	// rebake the lightmap the way a change of m_lights does
+	bool m_bLightLODDirty;
+	// draws of the scene, recorded once by BuildRenderList()
+	std::vector<DRAW_RECORD> m_renderList;
+	// distinct mesh ranges of the render list
+	std::vector<ShapeMeshes::DRAW_RANGE> m_meshRanges;
+	// instance values in submission order, and the render list
+	// index each one was written from
+	std::vector<INSTANCE_DATA> m_instanceData;
+	std::vector<uint32_t> m_instanceOrder;
+	// the same values as compact records, uploaded instead when
+	// asked for and every model of the order is a TRS, and expanded
+	// on the GPU
+	std::vector<InstanceExpander::COMPACT_INSTANCE> m_compactInstances;
+	InstanceExpander* m_pInstanceExpander;
+	bool m_bCompactInstances;
+	bool m_bCompactInstancesPacked;
+	// buffer holding the full values between frames, updated by the
+	// instances that changed, and true while it is in step with
+	// m_instanceData
+	DirtyRangeBuffer* m_pResidentInstances;
+	bool m_bResidentInstances;
+	bool m_bResidentInstancesCurrent;
+	// true when each draw carries the lights picked for it instead
+	// of reading the light clusters
+	bool m_bObjectLights;
+	// ring buffer of the per-frame uploads, owned by the caller
+	UploadRing* m_pUploadRing;
+	// worker threads of the scene update, culling and sorting,
+	// owned by the caller
+	JobSystem* m_pJobSystem;
+	// times the passes of the frame when set
+	GPUProfiler* m_pGPUProfiler;
+	// passes whose debug group is open
+	bool m_bPassGroupOpen[GPUProfiler::PASS_COUNT];
+	// texture buffer over the whole upload ring, the ring buffer it
+	// was attached to, and the instance the frame's copy of
+	// m_instanceData starts at in it
+	GLuint m_instanceTexture;
+	GLuint m_instanceTextureBuffer;
+	int m_instanceBase;
+	// instanced batches of the submission order
+	std::vector<DRAW_BATCH> m_drawBatches;
+	// commands drawing the batches, a buffer per recording thread
+	// kept between frames, and the buffers the frame recorded
+	std::vector<CommandBuffer> m_commandBuffers;
+	size_t m_commandBufferCount;
+	// buffer and command the blended draws start at, where the
+	// replay of the opaque draws stopped; m_commandBufferCount when
+	// it has not reached them
+	size_t m_transparentBuffer;
+	size_t m_transparentCommand;
+	// one indirect command per batch, and where the frame's copy of
+	// them starts in the upload ring, -1 when it was not written
+	std::vector<ShapeMeshes::INDIRECT_COMMAND> m_indirectCommands;
+	GLintptr m_indirectOffset;
+	// true when batches are drawn with multi-draw indirect
+	bool m_bMultiDrawIndirect;
+	// GPU occlusion culling of the indirect commands; only created
+	// when batches are drawn with multi-draw indirect
+	OcclusionCuller* m_pOcclusionCuller;
+	// world bounds and instance count of every batch, for the
+	// occlusion culling of their indirect commands
+	std::vector<SceneBVH::AABB> m_batchBounds;
+	std::vector<uint32_t> m_batchInstanceCounts;
+	// GPU culling of the meshlets of the batches drawing meshes split
+	// into them, the meshlet batch of every batch, -1 for none, and
+	// true to draw them with mesh shaders where the context can
+	MeshletCuller* m_pMeshletCuller;
+	std::vector<int> m_batchMeshletBatches;
+	bool m_bMeshShading;
+	// compute pass writing the sphere and torus vertices, used when
+	// GPU generation is asked for before PrepareScene()
+	PrimitiveGenerator* m_pPrimitiveGenerator;
+	bool m_bGPUPrimitives;
+	// weighted blended transparency of the transparent draws; when it
+	// is available they are drawn unsorted instead of back to front
+	TransparencyPass* m_pTransparencyPass;
+	bool m_bOrderIndependentTransparency;
+	// position-only program of the depth pre-pass, 0 if it did not build
+	GLuint m_depthPrepassProgram;
+	GLint m_depthPrepassInstanceBaseLocation;
+	// true to lay down the opaque depth before shading it
+	bool m_bDepthPrepass;
+	// per cluster light lists, so fragments skip the lights that
+	// cannot reach them
+	LightClusters* m_pLightClusters;
+	// G-buffer and lighting pass of the deferred path
+	DeferredPass* m_pDeferredPass;
+	// true to shade the opaque draws deferred instead of forward
+	bool m_bDeferredShading;
+	// rate image of the deferred lighting, and whether the low-detail
+	// tiles of the coarse materials are lit at a reduced rate
+	ShadingRate* m_pShadingRate;
+	bool m_bVariableRateShading;
+	// TargetFormats tier the frame, G-buffer, post and cascade
+	// targets are created in
+	int m_targetFormatTier;
+	// passes of a view, with the pooled G-buffer and transparency
+	// targets they draw into
+	RenderGraph* m_pRenderGraph;
+	// tone mapping and the other effects of the main view, added to
+	// its graph after the lighting
+	PostStack* m_pPostStack;
+	// anti-aliasing mode of the main view, and the most samples a
+	// multisampled color and depth target may have
+	int m_antiAliasing;
+	int m_maxSamples;
+	// resources of the graph the draws of a view go into: the
+	// imported frame, or multisampled color and depth targets
+	// resolved into it
+	struct SCENE_TARGET
+	{
+		int color;
+		int depth;		// -1 with the frame, which has its own
+		bool bMultisampled;
+	};
+	// reverse-Z depth convention of the frames
+	bool m_bReverseZ;
+	// true while both eyes of a stereo frame are drawn at once
+	bool m_bStereo;
+	// cached cube shadow maps of the lights and the memory they may use
+	ShadowAtlas* m_pShadowAtlas;
+	size_t m_shadowAtlasBudget;
+	// cascaded shadow maps of the directional key light
+	CascadedShadows* m_pCascadedShadows;
+	// prefiltered cube maps the glass and metal surfaces reflect, and
+	// whether one is being captured, which hides those surfaces
+	ReflectionProbes* m_pReflectionProbes;
+	bool m_bCapturingProbe;
+	// the round meshes are loaded in the compact vertex layout
+	bool m_bCompactVertices;
+	// shadow index of every light from the last UpdateShadowMaps()
+	std::vector<int> m_lightShadowIndexes;
+	std::vector<glm::vec4> m_lightShadowSpheres;
+	// draws inside the volume of the shadow being drawn
+	std::vector<uint32_t> m_shadowCasters;
+	// views of the composite objects, drawn as one quad each once
+	// they are smaller on screen than m_impostorPixels; 0 for never
+	ImpostorAtlas* m_pImpostorAtlas;
+	float m_impostorPixels;
+	// ID pass of the picks asked for, and the render list draw of
+	// every instance of the frame the last pick was drawn in
+	ObjectPicker* m_pObjectPicker;
+	std::vector<uint32_t> m_pickInstanceOrder;
+	// boxes hiding the expensive composite objects behind the other
+	// opaque draws, for GPUs without the Hi-Z culling. The movable
+	// opaque draws of each such object by root node, the group of
+	// every render list draw, -1 for none, and the box of every
+	// group in the view being built, -1 while it has none
+	OcclusionQueries* m_pOcclusionQueries;
+	bool m_bOcclusionQueries;
+	std::vector<std::vector<uint32_t> > m_queryGroups;
+	std::vector<int> m_drawQueryGroups;
+	std::vector<int> m_groupQueryBoxes;
+	std::vector<OcclusionQueries::QUERY_BOX> m_queryBoxes;
+	// the fixed function state of the passes and batches, set
+	// through the cache, and the state objects they name. The
+	// default state is the one other code expects between views:
+	// depth writes and test of the frame, alpha blending, no face
+	// culling and no stencil test
+	struct SCENE_STATES
+	{
+		int depthWrite;		// test and write
+		int depthEqual;		// shade only what the pre-pass left nearest
+		int depthRead;		// test without writing, for blended draws
+		int blendOff;
+		int blendAlpha;
+		int cullOff;
+		int cullBack;		// closed opaque surfaces, wound counterclockwise
+		int stencilOff;
+	};
+	RenderStateCache* m_pRenderStates;
+	SCENE_STATES m_states;
+	// LOD levels the draws are pushed coarser by, as if they were
+	// that many halvings smaller on screen
+	float m_lodBias;
+	// parts of a composite object as the atlas captures them; every
+	// object of the same shape shares one layer
+	struct IMPOSTOR_SHAPE
+	{
+		std::string key;		// shape tag and part count
+		int group;		// m_impostorGroups entry the views are captured from
+		glm::vec3 center;		// sphere of the parts around the root node
+		float radius;
+		bool bCaptured;
+	};
+	// the movable draws under one root scene node
+	struct IMPOSTOR_GROUP
+	{
+		int rootNode;
+		int shape;		// m_impostorShapes index, -1 past the atlas capacity
+		std::vector<uint32_t> draws;
+	};
+	std::vector<IMPOSTOR_SHAPE> m_impostorShapes;
+	std::vector<IMPOSTOR_GROUP> m_impostorGroups;
+	// shape tag of each root node recorded from a scene file prefab;
+	// the others are known by their own tag
+	std::vector<std::string> m_nodeShapeTags;
+	// quads of the view being built
+	std::vector<ImpostorAtlas::IMPOSTOR_INSTANCE> m_impostorInstances;
+	IMPOSTOR_STATS m_impostorStats;
+	// true when draws changed without the submission order changing
+	bool m_bInstanceDataDirty;
+	// 1 for each render list draw taken out by SetSceneNodeRemoved(),
+	// which holds an empty box in the hierarchy
+	std::vector<unsigned char> m_drawRemoved;
+	// true when draws were added after the render list was built
+	bool m_bDrawsAdded;
+	// true once the instance copy of the frame was written, which a
+	// view with the same submission order draws again
+	bool m_bInstanceCopyWritten;
+	// clips played on the scene nodes, the time they are played at,
+	// and true once the GPU posed its draws in the copy drawn
+	SceneAnimation* m_pSceneAnimation;
+	double m_animationTime;
+	bool m_bAnimationSampled;
+	// ambient particles, moved to the time of the clips
+	ParticleSystem* m_pParticleSystem;
+	// keys of the state combinations the pipeline warm-ups drew,
+	// sorted, so a later one draws only what the scene added
+	std::vector<uint64_t> m_warmedPipelines;
+	WARMUP_STATS m_warmUpStats;
+	// false while an extra view of the frame is built and drawn
+	bool m_bPrimaryView;
+	// transform hierarchy of the recorded scene, and the model
+	// matrix and world bounds of every render list draw
+	SceneTransforms m_sceneTransforms;
+	// node opened by BeginSceneNode(), -1 for none
+	int m_currentParentNode;
+	// scene description read by LoadSceneFile(), and the texture slot
+	// and material ID each of its textures and materials got
+	SceneFile m_sceneFile;
+	std::vector<int> m_sceneFileTextureSlots;
+	std::vector<int> m_sceneFileMaterialIDs;
+	// the models of the scene file, loaded through the resource
+	// manager, and the model mesh and material ID of each primitive
+	// of every model, empty until its load created them
+	struct SCENE_MODEL
+	{
+		ResourceManager::MESH_HANDLE resource;
+		std::vector<int> meshIDs;
+		std::vector<int> materialIDs;
+		// object materials the import added, which a reload updates
+		int firstMaterialID;
+		int materialCount;
+	};
+	std::vector<SCENE_MODEL> m_sceneFileModels;
+	// true when a model load created its meshes since the render list
+	// was recorded
+	bool m_bModelsAdded;
+	// watcher of the image and model files, NULL when they are not
+	// hot reloaded, and the watch of every texture slot and scene file
+	// model, -1 for one with no file
+	FileWatcher* m_pAssetWatcher;
+	std::vector<int> m_textureWatches;
+	std::vector<int> m_modelWatches;
+	// texture slots whose images changed, streamed again once the
+	// streamer is idle, since starting it cancels what it streams
+	std::vector<int> m_pendingTextureReloads;
+	// models reloaded since the start; the static geometry cache key
+	// does not cover the vertices, so it is not trusted after one
+	int m_modelReloads;
+	// what the model meshes imported keep on the CPU once drawn
+	ShapeMeshes::MESH_RETENTION m_meshRetention;
+	// path of the loaded scene file, which the static geometry
+	// bake is cached next to
+	std::string m_sceneFilePath;
+	// opaque static draws collected while recording, and the merged
+	// world space buffers they were baked into
+	std::vector<StaticGeometry::STATIC_DRAW> m_staticDraws;
+	// chunk of the instance each static draw was recorded for
+	std::vector<int> m_staticDrawChunks;
+	// pages of the meshlet arrays and the merged static buffers,
+	// declared first so they outlive the bake placed in them
+	BufferAllocator m_meshPages;
+	StaticGeometry m_staticGeometry;
+	uint64_t m_staticGeometryKey;
+	// chunks of a large scene file, each with the bake of its static
+	// draws in place of m_staticGeometry
+	WorldChunks m_worldChunks;
+	// diffuse lighting of the static geometry, baked on a worker
+	// thread into the lightmap texture
+	LightmapBaker* m_pLightmapBaker;
+	bool m_bLightmaps;
+	bool m_bLightmapOcclusion;
+	// lighting of the texture, or of the bake making it
+	uint64_t m_lightmapKey;
+	GLuint m_lightmapTexture;
+	// true while the texture holds the lighting of m_lightmapKey
+	bool m_bLightmapReady;
+	// view and projection of the frame, for the light clusters, and
+	// their product for the frustum culling
+	glm::mat4 m_viewMatrix;
+	glm::mat4 m_projectionMatrix;
+	glm::mat4 m_viewProjection;
+	bool m_bHasViewProjection;
+	// normalized planes of the view frustum, left, right, bottom,
+	// top, near and far, rebuilt when the matrices change
+	glm::vec4 m_frustumPlanes[6];
+	// hierarchy over the world bounds of the render list, indexed
+	// by render list draw
+	SceneBVH m_sceneBVH;
+	// draws returned by the last frustum query
+	std::vector<uint32_t> m_visibleDraws;
+	// 1 for each render list draw inside the frustum this frame
+	std::vector<unsigned char> m_drawVisible;
+	// camera position and orientation of the last primary view, which
+	// its motion is predicted from, and the draws of the predicted
+	// frustums
+	glm::vec3 m_lastCameraPosition;
+	glm::quat m_lastCameraOrientation;
+	bool m_bHasLastCamera;
+	std::vector<uint32_t> m_predictedDraws;
+	CULL_STATS m_cullStats;
+	// true while BuildRenderList() records the scene
+	bool m_bRecording;
+	// shader state the next recorded draw will use
+	DRAW_RECORD m_recordState;
+	glm::mat4 m_recordModel;
+	// chunk of the scene file instance being recorded, -1 for none
+	int m_recordChunk;
+	// one part of a prefab: the mesh it draws, its shader state and
+	// its transform relative to the instance
+	struct PREFAB_PART
+	{
+		uint32_t mesh;		// SceneFile::SCENE_MESH
+		int modelIndex;		// m_sceneFileModels index of a SceneFile::MESH_MODEL part
+		bool bModelMaterials;	// a model part drawn in its own materials
+		glm::vec4 color;
+		glm::vec2 UVscale;
+		int textureSlot;	// -1 draws with the untextured program
+		int materialID;
+		glm::vec3 scaleXYZ;
+		glm::vec3 rotationDegreesXYZ;
+		glm::vec3 positionXYZ;
+	};
+	// draw record of a part, copied for every instance placed
+	struct PREFAB_DRAW
+	{
+		int part;			// index into the parts of the prefab, -1 for the instance node
+		DRAW_RECORD record;	// rangeID -1 until the first movable instance finds the ranges
+	};
+	// a prefab flattened into the draw records of its parts, and of
+	// the same with the parts sharing a state merged in prefab space
+	struct COMPILED_PREFAB
+	{
+		std::string name;
+		std::vector<PREFAB_PART> parts;
+		std::vector<PREFAB_DRAW> draws;
+		// drawn by movable instances; static ones keep the parts for
+		// the bake of the scene
+		std::vector<PREFAB_DRAW> mergedDraws;
+		StaticGeometry* pGeometry;	// merged groups, NULL when nothing merged
+	};
+	// prefabs compiled by the recording, as their first instance is
+	// placed; the range IDs they hold only last for the recording
+	std::vector<COMPILED_PREFAB> m_prefabs;
+	// m_prefabs index of each scene file prefab, -1 until compiled
+	std::vector<int> m_sceneFilePrefabs;
+	// part of the prefab being compiled
+	int m_prefabPart;
+	// node of each part of the instance being placed
+	std::vector<int> m_prefabPartNodes;
+	PREFAB_STATS m_prefabStats;
+	// render list submission order, sorted every frame
+	std::vector<DRAW_KEY> m_drawKeys;
+	// scratch buffer for sorting m_drawKeys
+	std::vector<DRAW_KEY> m_sortScratch;
+	// camera position used for the depth part of the sort keys
+	glm::vec3 m_viewPosition;
+
+	// resolve the shader uniform handles used by the scene
+	void ResolveShaderUniforms();
+
+	// image file of a texture and the tag it is found by
+	struct TEXTURE_FILE
+	{
+		const char* filename;
+		const char* tag;
+	};
 
 	// load texture images and convert to OpenGL texture data
 	bool CreateGLTexture(const char* filename, std::string tag);
-	// bind loaded OpenGL textures to slots in memory
+	// same as above for several images, streamed in over the next
+	// frames; returns the count of textures started
+	int CreateGLTextures(const std::vector<TEXTURE_FILE>& files);
+	// upload the next part of the streamed images
+	void UpdateStreamedTextures();
+	// move the loads of the resource manager along, and record the
+	// draws of the models they created since the last frame
+	void UpdateResources();
+	// add the meshes and materials of an imported model to the scene
+	void AddImportedModel(int fileIndex, ModelImporter::MODEL& model);
+	// update the meshes and materials of a model in place from its
+	// file imported again; false when its layout changed
+	bool ReloadImportedModel(int fileIndex, ModelImporter::MODEL& model);
+	// the object material of a material of an imported model
+	static OBJECT_MATERIAL MakeModelMaterial(const std::string& modelTag,
+		const ModelImporter::MODEL_MATERIAL& modelMaterial);
+	// take the changes of the watched files and start their reloads
+	void UpdateAssetWatcher();
+	// load the compressed file of a texture slot again
+	bool ReloadCompressedGLTexture(int slot);
+	// put a new texture in a slot, keeping the one it replaced until
+	// the texture table is rebuilt
+	void ReplaceGLTexture(int slot, GLuint texture);
+	// load the KTX2 or DDS file of an image instead, if there is one
+	// the texture table can read; false when the image has to be used
+	bool CreateCompressedGLTexture(const std::string& imageFilename, const std::string& tag);
+	// load the texture cache entry of an image file, if it holds one
+	bool CreateCachedGLTexture(const std::string& imageFilename, const std::string& tag);
+	// open the tiled file of an image as a virtual texture, if there
+	// is one and the context can page it
+	bool CreateVirtualGLTexture(const std::string& imageFilename, const std::string& tag);
+	// drop and restore mip levels for the draws of the frame
+	void UpdateTextureResidency();
+	// mark the textures of the draws the camera is about to see, in
+	// the frustums its motion over the last frame leads to
+	void PrefetchPredictedTextures(float pixelScale);
+	// pixels a world unit covers on screen, at distance 1 when the
+	// projection is perspective
+	float GetPixelScale() const;
+	// diameter of the bounding sphere of a draw on screen, seen from
+	// the camera or from viewPosition
+	float ProjectDrawPixels(int draw, float pixelScale) const;
+	float ProjectDrawPixels(int draw, float pixelScale, const glm::vec3& viewPosition) const;
+	// how far on screen, in pixels, an LOD level of a draw moves its
+	// surface off the finest level
+	float ProjectLODErrorPixels(int draw, int lod, float pixelScale) const;
+	// make an OpenGL texture of a decoded image, 0 if it cannot be
+	GLuint UploadGLTexture(const char* filename, const ImageDecoder::IMAGE& image);
+	// the compressed texture taking the place of an uploaded one,
+	// which is deleted, or the texture itself when not compressed
+	GLuint CompressGLTexture(GLuint texture, bool bHasAlpha);
+	// give an uploaded texture the next texture slot
+	bool AddGLTexture(const TEXTURE_INFO& textureInfo);
+	// build the texture table the shaders read the loaded textures from
 	void BindGLTextures();
 	// free the loaded OpenGL textures
 	void DestroyGLTextures();
-	// find a loaded texture by tag
-	int FindTextureID(std::string tag);
-	int FindTextureSlot(std::string tag);
-	// find a defined material by tag
-	bool FindMaterial(std::string tag, OBJECT_MATERIAL& material);
+	// find a loaded texture by tag, -1 and reported if not loaded
+	int FindTextureID(const std::string& tag) const;
+	int FindTextureSlot(const std::string& tag) const;
+	// find the ID of a defined material by tag, -1 and reported if
+	// not defined
+	int FindMaterialID(const std::string& tag) const;
+	// upload the defined materials to the MaterialData block and
+	// register their tags
+	void UploadMaterials();
 
 	// set the transformation values 
 	// into the transform buffer
@@ -84,6 +805,89 @@ private:
 		float ZrotationDegrees,
 		glm::vec3 positionXYZ);
 
+	// add a scene node under the open node and cache its world matrix
+	int AddSceneNode(
+		std::string tag,
+		glm::vec3 scaleXYZ,
+		glm::vec3 rotationDegreesXYZ,
+		glm::vec3 positionXYZ);
+	// rebuild the world matrices of moved nodes and their draws
+	void UpdateSceneTransforms();
+	// index the draws added since the render list was built
+	void IndexAddedDraws();
+	// true when nodeID is rootID or under it
+	bool IsUnderSceneNode(int nodeID, int rootID) const;
+
+	// shader permutation flags for the scene's lighting state
+	int GetLightingPermutation() const;
+	// true when the opaque draws of this frame go through the G-buffer
+	bool IsDeferredShadingActive() const;
+	// true when the deferred lighting of this frame shades the
+	// low-detail tiles at a reduced rate
+	bool IsVariableRateShadingActive() const;
+	// true when the meshlet batches of this frame are drawn with the
+	// task and mesh shaders instead of the culled indirect commands
+	bool IsMeshShadingActive() const;
+	// true when the batches of this frame are drawn from the indirect
+	// commands, which needs them written into the upload ring
+	bool IsIndirectFrame() const { return((m_bMultiDrawIndirect == true) && (m_indirectOffset >= 0)); }
+	// true when the draws are culled on the GPU against the depth of
+	// the frame before, which only the main view of a mono frame has
+	bool IsGPUCullingActive() const { return((m_bPrimaryView == true) && (m_bStereo == false)); }
+	// assign the light shadows and redraw the casters of stale ones
+	void UpdateShadowMaps();
+	// fit the cascades of the key light, or clear them without one,
+	// and redraw their casters when they are stale
+	void UpdateCascadedShadows(int keyLight, const SceneBVH::AABB& sceneBounds);
+	// group the movable draws of the new render list by their root
+	// node and give each composite shape a layer of the atlas
+	void CollectImpostorGroups();
+	// capture the views of one shape not in the atlas yet
+	void UpdateImpostors();
+	// place a reflection probe at every cluster of reflective draws
+	void PlaceReflectionProbes();
+	// draw the next face of a probe waiting for its capture
+	void UpdateReflectionProbes();
+	// true when the material of a draw reflects the probes
+	bool IsReflectiveDraw(const DRAW_RECORD& drawRecord) const;
+	// group the movable opaque draws of the new render list by their
+	// root node and keep the objects worth an occlusion query
+	void CollectQueryGroups();
+	// give the query groups seen by the view their boxes
+	void UpdateQueryBoxes();
+	// true when the boxes are drawn and the queried batches wait on
+	// them this frame
+	bool IsOcclusionQueryActive() const;
+	// query group of a batch, -1 for none
+	int GetBatchQueryGroup(size_t batchIndex) const;
+	// draw the query boxes from the replay and switch back to the
+	// permutation it uses
+	void DrawQueryBoxes(int permutation);
+	// make a permutation current with the texture units of the draws
+	void UseDrawPermutation(int permutation);
+	// create the state objects of the passes and batches
+	void CreateRenderStates();
+	// set the depth and blend state of a pass, without culling or
+	// stencil test, and the default state between views
+	void ApplyPassState(int depthState, int blendState);
+	void ApplyDefaultState();
+	// cull the back faces of a batch drawing closed opaque surfaces
+	void ApplyBatchCulling(size_t batchIndex);
+	// true when the opaque depth is drawn by a pre-pass this frame
+	bool IsDepthPrepassActive() const;
+	// swap the composite objects small on screen for their impostors,
+	// hiding their parts once the fade is complete
+	void SelectImpostors();
+	// add the pass drawing the impostors of the view to the graph
+	void AddImpostorPass(const SCENE_TARGET& target);
+	// add the pass moving and drawing the particles to the graph
+	void AddParticlePass(const SCENE_TARGET& target);
+	// bracket a pass with the profiler, when there is one, and with
+	// a debug group named after it; ending a pass that is not open
+	// does nothing
+	void BeginProfiledPass(int pass);
+	void EndProfiledPass(int pass);
+
 	// set the color values into the shader
 	void SetShaderColor(
 		float redColorValue,
@@ -93,7 +897,9 @@ private:
 
 	// set the texture data into the shader
 	void SetShaderTexture(
-		std::string textureTag);
+		TextureHandle texture);
+	void SetShaderTexture(
+		const std::string& textureTag);
 
 	// set the UV scale for the texture mapping
 	void SetTextureUVScale(
@@ -101,42 +907,554 @@ private:
 
 	// set the object material into the shader
 	void SetShaderMaterial(
-		std::string materialTag);
+		MaterialHandle material);
+	void SetShaderMaterial(
+		const std::string& materialTag);
+	// select a material by its index in the MaterialData block
+	void SelectMaterialID(
+		int materialID);
+
+	// upload the active lights to the LightData block if they changed
+	void UploadLights();
+	// move the level of each light towards the one of its share of
+	// the view, and the light with its level applied
+	void UpdateLightLOD();
+	LIGHT_SOURCE GetLODLight(int lightIndex) const;
+
+	// record the draws of DefineSceneObjects() into the render list
+	void BuildRenderList();
+	// one pass of BuildRenderList() over the scene
+	void RecordRenderList();
+	// load the textures, materials and lights of the scene file
+	void LoadSceneFileResources();
+	// start importing a model of the scene file on the loader thread
+	void LoadSceneFileModel(int fileIndex);
+	// called by WorldChunks for a loading chunk: start the imports of
+	// its models, true once they all finished
+	static bool IsChunkReady(void* pContext, const WorldChunks::CHUNK& chunk);
+	// record the parts of every instance of the scene file
+	void DefineSceneFileObjects();
+	// draw a SceneFile::SCENE_MESH with the current shader state
+	void DrawSceneFileMesh(uint32_t mesh);
+	// the compiled prefab of a scene file prefab, compiled on first use
+	int GetSceneFilePrefab(uint32_t prefabIndex);
+	// the compiled prefab of an object of the built-in scene, by name
+	int GetBuiltInPrefab(const std::string& name);
+	// draw every part of a prefab once, keeping the draw records
+	int CompilePrefab(const std::string& name, const std::vector<PREFAB_PART>& parts);
+	// bake the part draws of a prefab that share a texture, material
+	// and color into one group each
+	void MergePrefabParts(COMPILED_PREFAB& prefab);
+	// free the merged groups of the compiled prefabs and drop them
+	void ClearPrefabs();
+	// add an instance node, a node per part under it, and a copy of
+	// every draw record of the prefab; returns the instance node
+	int PlacePrefab(
+		int prefabID,
+		const std::string& tag,
+		glm::vec3 scaleXYZ,
+		glm::vec3 rotationDegreesXYZ,
+		glm::vec3 positionXYZ);
+	// draw every primitive of a scene file model, in its own
+	// materials unless bKeepMaterial
+	void DrawSceneFileModel(int modelIndex, bool bKeepMaterial);
+	// merge the static draws of the recording and add the baked
+	// groups to the render list
+	void BakeStaticGeometry();
+	// bake the static draws of each resident chunk on its own,
+	// keeping the bakes the recording did not change
+	void BakeChunkGeometry();
+	// add a draw for every group of a bake to the render list
+	void AddStaticGroups(const StaticGeometry& geometry);
+	// the bake a draw range of a static group or merged prefab
+	// parts is in, NULL for the ranges of the arena
+	const StaticGeometry* FindStaticGeometry(GLuint vao) const;
+	// bake the lightmap of the static geometry for the current
+	// lights and materials, unless it already has them
+	void BakeLightmap();
+	// start a new bake when the lights changed, and take the
+	// lightmap of a finished one
+	void UpdateLightmap();
+	// create or refill the lightmap texture
+	void UploadLightmap(const LightmapBaker::LIGHTMAP& lightmap);
+	// called by ShapeMeshes for each draw range while recording
+	static void RecordDrawRange(
+		void* pContext,
+		const ShapeMeshes::DRAW_RANGE& drawRange);
+	// called by ShapeMeshes to build a model mesh kept by
+	// RETAIN_DERIVED again, from its model file
+	static bool ImportModelMesh(
+		void* pContext,
+		int modelMesh,
+		std::vector<GLfloat>& vertices,
+		std::vector<GLuint>& indices,
+		std::vector<GLfloat>* pLODVertices,
+		std::vector<GLuint>* pLODIndices,
+		float* pLODErrors);
+	// called by ShapeMeshes for each draw range of a prefab compiled
+	static void RecordPrefabRange(
+		void* pContext,
+		const ShapeMeshes::DRAW_RANGE& drawRange);
+	// true when the shader state of a record needs blending
+	bool IsTransparentRecord(const DRAW_RECORD& drawRecord) const;
+	// add a recorded draw to the static draws or the render list,
+	// finding its range IDs unless it has them
+	void AddRecordedDraw(DRAW_RECORD& drawRecord);
+	// instanced shader permutation of a recorded draw
+	int GetDrawPermutation(const DRAW_RECORD& drawRecord) const;
+	// point the instance texture buffer at the upload ring or at the
+	// expanded instances
+	void AttachInstanceTexture(GLuint buffer);
+	// write the instance values in submission order and the indirect
+	// commands of the frame into the upload ring
+	void UploadInstanceData();
+	// gather the instance values in submission order and rebatch
+	void RebuildInstanceData();
+	// pick the lights that reach a draw most and pack their indexes
+	// into the w of its normal matrix columns
+	void PackObjectLights(uint32_t drawIndex, INSTANCE_DATA& instance) const;
+	// split the submission order into instanced batches
+	void BuildDrawBatches();
+	// draw the sorted render list as instanced batches
+	void SubmitRenderList();
+	// add the passes drawing the batches to the render graph, over
+	// the scene target of the view
+	void AddDrawPasses(const SCENE_TARGET& target);
+	// declare a pass drawing or reading the scene target
+	void WriteSceneTarget(int pass, const SCENE_TARGET& target);
+	void ReadSceneTarget(int pass, const SCENE_TARGET& target);
+	// samples per pixel of the view being drawn
+	int GetMultisampleCount() const;
+	// record the draws of the batches into the command buffers,
+	// split between the threads of the job system
+	void RecordCommandBuffers();
+	void RecordBatches(CommandBuffer& commandBuffer, size_t first, size_t end);
+	// true when a batch can join the multi-draw of an earlier one
+	bool CanMergeBatches(size_t batchIndex, size_t nextBatch) const;
+	// issue the recorded commands of the opaque or of the blended
+	// draws
+	void ReplayCommandBuffers(bool bTransparent);
+	// draw consecutive batches with one multi-draw indirect call
+	void MultiDrawBatches(uint32_t firstBatch, uint32_t batchCount, uint32_t instanceCount);
+	// draw the depth of the opaque batches without shading them
+	void SubmitDepthPrepass();
+	// draw the batches of the main view into the ID target of the
+	// pick asked for
+	void SubmitPickPass();
+	// meshlet batch a draw batch is drawn with, -1 for none
+	int GetMeshletBatch(size_t batchIndex) const;
+	// the part of BuildScene() shared by all views of the frame
+	void UpdateScene();
+	// cull, sort and upload the draws for the view matrices set
+	void BuildView(bool bPrimaryView);
+	// test the draws of the render list against the view frustum
+	void CullRenderList();
+	// pick the LOD level of the visible draws from their size on screen
+	void SelectDrawLODs();
+	// index of a range in m_meshRanges, added if it is not there yet
+	int FindMeshRange(const ShapeMeshes::DRAW_RANGE& drawRange);
+	// build and sort the submission keys of the render list
+	void SortRenderList();
+	// run a pass over [0, count) on the threads of the job system
+	void ParallelFor(size_t count, size_t minItems, const std::function<void(size_t, size_t)>& pass);
+	// pack the state and depth of a recorded draw into a sort key
+	uint64_t MakeDrawKey(uint32_t drawIndex) const;
+	// cast one ray against the triangles of the draws, with the
+	// traversal stack of the calling thread
+	void CastSceneRay(const RAY_QUERY& ray, std::vector<int>& stack, RAY_HIT& hit) const;
+	// nearest triangle of a draw a ray hits before maxDistance
+	bool IntersectDrawTriangles(
+		uint32_t drawIndex,
+		const glm::vec3& origin,
+		const glm::vec3& direction,
+		float maxDistance,
+		float& hitDistance,
+		glm::vec3& hitNormal) const;
 
 public:
 	// The following methods are for the students to 
 	// customize for their own 3D scene
 
 	void LoadSceneTextures();
+	// describe the scene with a text or compiled scene file instead
+	// of DefineSceneObjects(); only read by PrepareScene()
+	bool LoadSceneFile(const char* filename);
+	// take a description already read, as on a startup thread; the
+	// failed read of filename leaves the built-in scene
+	bool LoadSceneFile(SceneFile& sceneFile, const char* filename);
 	void PrepareScene();
 	void RenderScene();
+	// the two halves of RenderScene(): update the scene and build
+	// the culled, sorted draws of the frame, then submit them with
+	// the view matrices set in between, so the camera can be
+	// sampled once more right before the draws go to the GPU
+	void BuildScene();
+	void SubmitScene();
+	// draw the scene again into a viewport of the frame, after
+	// SubmitScene(), from the view matrices and position set since;
+	// it shares the scene update of the frame and is forward shaded
+	void RenderSecondaryView(const GLint viewport[4]);
+	// write the meshes PrepareScene() generated for a scene file to
+	// the baked mesh file loaded in their place from then on, with
+	// bEncode coded for the asset pack
+	bool SaveBakedMeshes(bool bEncode = false);
+	void DefineSceneObjects();
+
+	// mark the draws recorded next as never moving, so they are
+	// baked into the merged static geometry
+	void SetStaticGeometry(bool bStatic) { m_recordState.bStatic = bStatic; }
+
+	// group the parts of a composite object under one scene node
+	int BeginSceneNode(std::string tag, glm::vec3 positionXYZ);
+	void EndSceneNode();
+	// find a scene node by tag, -1 if not found
+	int FindSceneNode(std::string tag);
+	// move a scene node and everything under it
+	bool SetSceneNodeTransform(
+		int nodeID,
+		glm::vec3 scaleXYZ,
+		glm::vec3 rotationDegreesXYZ,
+		glm::vec3 positionXYZ);
+	// recolor the movable draws under a scene node; false when it
+	// has none
+	bool SetSceneNodeColor(int nodeID, const glm::vec4& color);
+	// take the movable draws under a scene node out of the frame,
+	// or put them back; false when it has none
+	bool SetSceneNodeRemoved(int nodeID, bool bRemoved);
+	// true when the movable draws under a scene node were removed
+	bool IsSceneNodeRemoved(int nodeID) const;
+	// add a movable instance of a prefab the scene placed, outside
+	// of any node, between frames; returns its node, -1 for a prefab
+	// the recording did not compile
+	int AddPrefabInstance(
+		const std::string& prefabName,
+		const std::string& tag,
+		glm::vec3 scaleXYZ,
+		glm::vec3 rotationDegreesXYZ,
+		glm::vec3 positionXYZ);
+	// change one parameter of a material, named as its field, such
+	// as diffuseColor, writing only its slot of the material buffer;
+	// false for an unknown material or parameter, or too few values
+	bool SetMaterialParameter(
+		const std::string& tag,
+		const std::string& parameter,
+		const float* pValues,
+		int valueCount);
+
+	// camera position the draws are depth sorted against
+	void SetViewPosition(const glm::vec3& viewPosition) { m_viewPosition = viewPosition; }
+	// camera matrices the draws are frustum culled and the lights
+	// clustered against; the product and the frustum planes are
+	// only rebuilt when they differ from the last ones
+	void SetViewMatrices(const glm::mat4& view, const glm::mat4& projection);
+
+	const CULL_STATS& GetCullStats() const { return(m_cullStats); }
+
+	// diameter on screen, in pixels, below which a composite object is
+	// drawn as its impostor; it fades in over a band above it. 0
+	// always draws the parts
+	void SetImpostorPixels(float pixels) { m_impostorPixels = pixels; }
+	float GetImpostorPixels() const { return(m_impostorPixels); }
+	const IMPOSTOR_STATS& GetImpostorStats() const { return(m_impostorStats); }
+	const PREFAB_STATS& GetPrefabStats() const { return(m_prefabStats); }
+	// levels the mesh LODs are picked coarser by, 0 for none; each
+	// level halves the size on screen the switches compare
+	void SetLODBias(float levels) { m_lodBias = glm::max(levels, 0.0f); }
+	float GetLODBias() const { return(m_lodBias); }
+
+	// true when a scene node or light changed since the last
+	// RenderScene(), so the next frame differs from the last one
+	bool HasPendingChanges() const
+	{
+		return((m_bLightsDirty == true) || m_sceneTransforms.HasPendingUpdate() ||
+			(m_pLightmapBaker->IsReady() == true) || (m_pSceneAnimation->IsPlaying(m_animationTime) == true) ||
+			(m_pParticleSystem->IsAvailable() == true));
+	}
+	// true while textures stream in, models are still imported or
+	// the lightmap is baked, so the frames do not show the whole
+	// scene yet
+	bool IsLoading() const
+	{
+		return((m_pTextureStreamer->IsBusy() == true) || (m_pResources->IsLoading() == true) ||
+			(m_pLightmapBaker->IsBusy() == true));
+	}
+	// resource loads and texture uploads still waiting
+	size_t GetStreamingQueueDepth() const
+	{
+		return((size_t)m_pResources->GetLoadingCount() + m_pTextureStreamer->GetQueueDepth());
+	}
+	// draw once every combination of shader permutation, vertex
+	// format, primitive type and pass state the render list may be
+	// drawn with, that no earlier warm-up drew, into a small target
+	// of the frame's formats, so the driver has built its variants
+	// of the programs before a view first meets them; returns the
+	// combinations drawn
+	int WarmUpPipelines();
+	const WARMUP_STATS& GetWarmUpStats() const { return(m_warmUpStats); }
+	// the commands the last view drawn recorded, in the buffers the
+	// frame used
+	const CommandBuffer* GetCommandBuffers() const { return(m_commandBuffers.data()); }
+	size_t GetCommandBufferCount() const { return(m_commandBufferCount); }
+	// the next frame's camera jumps away from the last one, so the
+	// depth of the last frame tells nothing about what it hides
+	void CameraCut() { m_pOcclusionCuller->InvalidatePyramid(); }
+
+	// draw the opaque depth first, so the lit pass shades every pixel
+	// once; can be switched at any time to compare both paths
+	void SetDepthPrepass(bool bEnable) { m_bDepthPrepass = bEnable; }
+	bool IsDepthPrepassEnabled() const { return(m_bDepthPrepass); }
+
+	// light the opaque draws from a G-buffer in one full screen pass,
+	// drawing only the transparent ones forward; can be switched at
+	// any time to compare it with clustered forward
+	void SetDeferredShading(bool bEnable) { m_bDeferredShading = bEnable; }
+	bool IsDeferredShadingEnabled() const { return(m_bDeferredShading); }
+	// light the tiles of the materials flagged for coarse shading
+	// once per 2x2 pixels where the frame before shows little detail
+	// there; only the deferred lighting of a single sampled main
+	// view does
+	void SetVariableRateShading(bool bEnable) { m_bVariableRateShading = bEnable; }
+	bool IsVariableRateShadingEnabled() const { return(m_bVariableRateShading); }
+	// formats of the render targets, a TargetFormats::TIER trading
+	// precision for bandwidth; the persistent targets are made again
+	// in the new formats on their next use
+	void SetTargetFormatTier(int tier)
+	{
+		m_targetFormatTier = glm::clamp(tier, (int)TargetFormats::TIER_LOW, TargetFormats::TIER_COUNT - 1);
+		m_pPostStack->SetColorFormat(GetTargetFormats().hdrColor);
+		m_pCascadedShadows->SetDepthFormat(GetTargetFormats().cascadeDepth);
+	}
+	int GetTargetFormatTier() const { return(m_targetFormatTier); }
+	const TargetFormats::FORMATS& GetTargetFormats() const { return(TargetFormats::GetFormats(m_targetFormatTier)); }
+
+	// depth of 1 at the near plane falling to 0 far away, for the
+	// reverse-Z projection; sets the clip depth range, the depth
+	// clear value and the depth test, before the frame is cleared
+	void SetReverseZ(bool bEnable);
+	bool IsReverseZEnabled() const { return(m_bReverseZ); }
+
+	// draw both eyes of a stereo frame in one pass with the shaders
+	// built for GL_OVR_multiview; set before PrepareScene()
+	void SetStereo(bool bEnable);
+	bool IsStereoEnabled() const { return(m_bStereo); }
+
+	// draw the meshes split into meshlets with task and mesh shaders
+	// where GL_NV_mesh_shader is available; the depth pre-pass needs
+	// the same vertex stage in both passes, so it keeps them on the
+	// culled indirect commands
+	void SetMeshShading(bool bEnable) { m_bMeshShading = bEnable; }
+	bool IsMeshShadingEnabled() const { return(m_bMeshShading); }
+
+	// memory the shadow atlas may take, which bounds how many lights
+	// cast shadows; only read by PrepareScene()
+	void SetShadowAtlasBudget(size_t budgetBytes) { m_shadowAtlasBudget = budgetBytes; }
+	// store the dense round meshes in half the vertex memory,
+	// before PrepareScene() loads them
+	void SetCompactVertices(bool bCompact) { m_bCompactVertices = bCompact; }
+	// generate the sphere and torus vertices with a compute shader,
+	// in full floats, before PrepareScene() loads them
+	void SetGPUPrimitives(bool bEnable) { m_bGPUPrimitives = bEnable; }
+	// upload a translation, rotation and scale per draw instead of
+	// its matrices, expanded by a compute pass, before PrepareScene()
+	void SetCompactInstances(bool bEnable) { m_bCompactInstances = bEnable; }
+	const InstanceExpander::EXPAND_STATS& GetInstanceExpandStats() const { return(m_pInstanceExpander->GetStats()); }
+	// keep the full instance values in a buffer of their own and copy
+	// only the changed instances into it, instead of writing all of
+	// them into the upload ring every frame
+	void SetResidentInstances(bool bEnable) { m_bResidentInstances = bEnable; }
+	// read the clips played on the scene nodes, before PrepareScene()
+	bool LoadAnimations(const char* filename) { return(m_pSceneAnimation->Load(filename)); }
+	// let a compute pass pose the animated draws once there are many
+	void SetGPUAnimation(bool bAllow) { m_pSceneAnimation->SetGPUAllowed(bAllow); }
+	// seconds of the frame the clips are played at
+	void SetAnimationTime(double seconds) { m_animationTime = seconds; }
+	const SceneAnimation& GetAnimation() const { return(*m_pSceneAnimation); }
+	// read the particle emitters placed on the scene nodes, before
+	// PrepareScene()
+	bool LoadParticles(const char* filename) { return(m_pParticleSystem->Load(filename)); }
+	const ParticleSystem& GetParticles() const { return(*m_pParticleSystem); }
+	// shade each instanced forward draw by the MAX_OBJECT_LIGHTS
+	// lights that reach it most, picked on the CPU, instead of the
+	// light clusters; the instances are then uploaded in full
+	void SetObjectLights(bool bEnable)
+	{
+		m_bObjectLights = bEnable;
+		m_bInstanceDataDirty = true;
+	}
+	bool IsObjectLights() const { return(m_bObjectLights); }
+	// fold the direct light of the lights that take little of the
+	// view into their ambient term, and fade out the negligible ones
+	void SetLightLOD(bool bEnable) { m_bLightLOD = bEnable; }
+	bool IsLightLOD() const { return(m_bLightLOD); }
+	// keep the CPU copies of the model meshes imported from here on
+	// by the policy named cpu, compressed, derived or gpu; false for
+	// any other name
+	bool SetMeshRetention(const char* name);
+	// light the static geometry from a baked lightmap, optionally
+	// with ambient occlusion, before PrepareScene() bakes it
+	void SetLightmaps(bool bEnable, bool bAmbientOcclusion)
+	{
+		m_bLightmaps = bEnable;
+		m_bLightmapOcclusion = bAmbientOcclusion;
+	}
+	bool IsLightmapReady() const { return(m_bLightmapReady); }
+	// filtering of the shadow lookups, a ShadowAtlas::SHADOW_QUALITY
+	void SetShadowQuality(int quality)
+	{
+		m_pShadowAtlas->SetQuality(quality);
+		m_pCascadedShadows->SetQuality(m_pShadowAtlas->GetQuality());
+	}
+	int GetShadowQuality() const { return(m_pShadowAtlas->GetQuality()); }
+	// cascades of the directional key light and the side of each in
+	// texels, and the view depth they reach
+	void SetShadowCascades(int cascadeCount, int cascadeSize) { m_pCascadedShadows->SetCascades(cascadeCount, cascadeSize); }
+	int GetShadowCascadeCount() const { return(m_pCascadedShadows->GetCascadeCount()); }
+	int GetShadowCascadeSize() const { return(m_pCascadedShadows->GetCascadeSize()); }
+	void SetShadowDistance(float distance) { m_pCascadedShadows->SetShadowDistance(distance); }
+	// filtering of the scene textures, a TextureTable::FILTER_QUALITY
+	void SetTextureFilterQuality(int quality) { m_pTextureTable->SetFilterQuality(quality); }
+	int GetTextureFilterQuality() const { return(m_pTextureTable->GetFilterQuality()); }
+	// memory the scene textures may take before their top mip
+	// levels are dropped
+	void SetTextureBudget(size_t budgetBytes) { m_pTextureResidency->SetBudget(budgetBytes); }
+	size_t GetTextureBudget() const { return(m_pTextureResidency->GetBudget()); }
+	// compress the textures decoded from image files into BC1 or BC3
+	// on the GPU, before PrepareScene() loads them
+	void SetTextureCompression(bool bEnable, GPUTextureCompressor::QUALITY quality)
+	{
+		m_bCompressTextures = bEnable;
+		m_pTextureCompressor->SetQuality(quality);
+	}
+	const GPUTextureCompressor& GetTextureCompressor() const { return(*m_pTextureCompressor); }
+	// memory the committed pages of the virtual textures may take,
+	// before PrepareScene() opens them
+	void SetVirtualTextureBudget(size_t budgetBytes) { m_pVirtualTextures->SetBudget(budgetBytes); }
+	const VirtualTextures& GetVirtualTextures() const { return(*m_pVirtualTextures); }
+	// time the shadow, culling, pre-pass, opaque, transparent and
+	// post passes with the profiler; NULL for none
+	void SetGPUProfiler(GPUProfiler* pProfiler) { m_pGPUProfiler = pProfiler; m_pPostStack->SetGPUProfiler(pProfiler); }
+	// set a post effect from text of the form name=tier[:budget]
+	bool ParsePostEffect(const char* text) { return(m_pPostStack->ParseEffect(text)); }
+	// highest tier of every post effect, TIER_HIGH for no cap
+	void SetPostTierCap(int tier) { m_pPostStack->SetTierCap(tier); }
+	// reuse the ambient occlusion of the earlier frames where the
+	// camera barely moved
+	void SetTemporalCaching(bool bEnable) { m_pPostStack->SetTemporalCaching(bEnable); }
+	bool IsTemporalCachingEnabled() const { return(m_pPostStack->IsTemporalCachingEnabled()); }
+	// true when the main view is post processed, so its frame wants a
+	// high range color buffer; never for a stereo frame
+	bool IsPostProcessingActive() const { return((m_pPostStack->IsActive() == true) && (m_bStereo == false)); }
+	const PostStack& GetPostStack() const { return(*m_pPostStack); }
+	// anti-aliasing of the main view, one of PostStack::ANTI_ALIASING;
+	// stereo frames are never anti-aliased
+	void SetAntiAliasing(int mode);
+	int GetAntiAliasing() const { return(m_antiAliasing); }
+	// true when the main view is drawn a subpixel off each frame for
+	// the temporal anti-aliasing, by the projection JitterProjection()
+	// gives for a frame of the size
+	bool IsTemporalAntiAliasingActive() const { return((IsPostProcessingActive() == true) && (m_pPostStack->IsEffectActive(PostStack::EFFECT_TAA) == true)); }
+	glm::mat4 JitterProjection(const glm::mat4& projection, int width, int height) const { return(m_pPostStack->JitterProjection(projection, width, height)); }
+	// shared context the streamed textures are uploaded on, before
+	// PrepareScene() starts them; NULL uploads them on this one
+	void SetLoaderContext(LoaderContext* pLoader) { m_pTextureStreamer->SetLoaderContext(pLoader); }
+	// reload the image and model files saved while the program runs,
+	// behind the texture slots and mesh IDs they already have, as the
+	// watcher notices them; NULL stops it
+	void SetAssetWatcher(FileWatcher* pWatcher) { m_pAssetWatcher = pWatcher; }
+	const TextureResidency::RESIDENCY_STATS& GetTextureResidencyStats() const { return(m_pTextureResidency->GetStats()); }
+	// passes culled, targets pooled and framebuffer binds skipped
+	const RenderGraph::GRAPH_STATS& GetRenderGraphStats() const { return(m_pRenderGraph->GetStats()); }
+	// vertex cache quality of the loaded meshes
+	const std::vector<ShapeMeshes::MESH_STATS>& GetMeshStats() const { return(m_basicMeshes->GetMeshStats()); }
+
+	// find the render list draw whose bounds a ray hits first, for
+	// picking; returns -1 when the ray hits nothing
+	int RaycastScene(
+		const glm::vec3& origin,
+		const glm::vec3& direction,
+		float& hitDistance) const;
+	// collect the render list draws whose bounds overlap a box,
+	// such as the shadow casters inside the volume of a light
+	void QueryDrawsInBox(
+		const SceneBVH::AABB& box,
+		std::vector<uint32_t>& drawIndexes) const;
+	// collect the render list draws whose bounds overlap a sphere
+	void QueryDrawsInSphere(
+		const glm::vec3& center,
+		float radius,
+		std::vector<uint32_t>& drawIndexes) const;
+	// find the triangle of the finest LOD level of the render list
+	// draws a ray hits first, from the CPU copies of the meshes;
+	// false when it hits nothing
+	bool RaycastSceneTriangles(const RAY_QUERY& ray, RAY_HIT& hit);
+	// cast many rays at once, split between the threads of the job
+	// system, with a hit for every ray in the same order
+	void RaycastSceneBatch(const std::vector<RAY_QUERY>& rays, std::vector<RAY_HIT>& hits);
+	// node a render list draw is placed by, -1 for none
+	int GetDrawSceneNode(int drawIndex) const;
+	// ask for the render list draw at a point of the main view, 0..1
+	// from its lower left corner; the surface under the point is drawn
+	// by the GPU and read back a frame or two later, without a stall
+	void RequestPick(float x, float y) { m_pObjectPicker->Request(x, y); }
+	// take the result of the last pick once it arrived: the draw hit,
+	// -1 for none; false while it has not arrived
+	bool TakePickedDraw(int& drawIndex);
+	const ObjectPicker::PICK_STATS& GetPickStats() const { return(m_pObjectPicker->GetStats()); }
+	// draw the expensive composite objects under the occlusion query
+	// of their bounding box, after the other opaque draws; taken by
+	// the next render list built
+	void SetOcclusionQueries(bool bEnable) { m_bOcclusionQueries = bEnable; }
+	bool IsOcclusionQueriesEnabled() const { return(m_bOcclusionQueries); }
+	const OcclusionQueries& GetOcclusionQueries() const { return(*m_pOcclusionQueries); }
+	// the state objects and the calls their cache saved
+	const RenderStateCache& GetRenderStates() const { return(*m_pRenderStates); }
+	// the pages the meshlets and static geometry are allocated from
+	const BufferAllocator& GetMeshPages() const { return(m_meshPages); }
+	// cut the scene file into chunks of chunkSize units before
+	// PrepareScene(), 0 to record the whole scene, and stream them in
+	// within loadRadius of the camera
+	void SetWorldChunkSize(float chunkSize) { m_worldChunks.SetChunkSize(chunkSize); }
+	void SetWorldChunkRadius(float loadRadius) { m_worldChunks.SetLoadRadius(loadRadius); }
+	// memory the files and bakes of the resident chunks may take
+	void SetWorldChunkBudget(size_t budgetBytes) { m_worldChunks.SetBudget(budgetBytes); }
+	const WorldChunks& GetWorldChunks() const { return(m_worldChunks); }
 	void DefineObjectMaterials();
 	void SetupSceneLights();
+
+	// manage the light sources of the scene at runtime; indexes past a
+	// removed light shift down by one, like the underlying vector
+	int AddLight(const LIGHT_SOURCE& light);
+	bool RemoveLight(int lightIndex);
+	bool UpdateLight(int lightIndex, const LIGHT_SOURCE& light);
+	int GetLightCount() const { return((int)m_lights.size()); }
 	
 	// sets the shader manager attributes to the given color, texture, UVscale, and material
 	// defaults to white color, no texture, 1.0 UVscale, and no material.
 	// Use UVscale to set the number of times the texture is drawn in the X and Y direction
 	void SetShaderAttributes(
 		glm::vec4 colorRGBA = glm::vec4(1.0f, 1.0f, 1.0f, 1.0f),
-		std::string texture = "none",
+		const std::string& texture = "none",
 		glm::vec2 UVscale = glm::vec2(1.0f, 1.0f),
-		std::string material = "none");
+		const std::string& material = "none");
+	// same as above with the texture and material handles of
+	// FindTexture() and FindMaterial(), which compare no strings
+	void SetShaderAttributes(
+		glm::vec4 colorRGBA,
+		TextureHandle texture,
+		glm::vec2 UVscale,
+		MaterialHandle material);
 
-	// Defines the alias for a pointer to ShapeMeshWrappers drawing functions passed to DrawMeshTransformation()
-	typedef void (*MeshDrawFunction)(ShapeMeshes*);
+	// intern a tag once at load time for the handle overloads;
+	// unknown tags are reported and give TagRegistry::INVALID_HANDLE
+	TextureHandle FindTexture(const std::string& tag) const { return(m_textureTags.Find(tag)); }
+	MaterialHandle FindMaterial(const std::string& tag) const { return(m_materialTags.Find(tag)); }
 
 	// draws an object with given transformation parameters, ShapeMeshes object reference, 
-	// and a drawing function from the ShapeMeshWrappers wrapper class
+	// and a mesh descriptor from ShapeMeshWrappers naming the shape and range to draw
 	void DrawMeshTransformation(
 		glm::vec3 scaleXYZ, 
 		glm::vec3 rotationDegreesXYZ, 
 		glm::vec3 positionXYZ, 
 		ShapeMeshes* meshObject, 
-		MeshDrawFunction drawMeshFunction);
-
-	// uses DrawMeshTransformation calls to draw a complicated multi-mesh objects with one XYZ position.
-	void DrawJar(float x_pos, float y_pos, float z_pos);
-	void DrawCup(float x_pos, float y_pos, float z_pos);
-	void DrawCucumber(float x_pos, float y_pos, float z_pos);
-	void DrawKnife(float x_pos, float y_pos, float z_pos);
+		ShapeMeshWrappers::MESH_DRAW meshDraw);
 };
\ No newline at end of file
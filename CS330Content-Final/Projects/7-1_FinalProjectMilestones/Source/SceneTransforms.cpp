@@ -0,0 +1,466 @@
+///////////////////////////////////////////////////////////////////////////////
+// scenetransforms.cpp
+// ============
+// structure of arrays storage of the scene transforms
+//
+//  Keeps the transform hierarchy of the scene nodes and the world
+//  matrices and bounds of the render list draws in one array per
+//  component, updated in linear passes that are split between
+//  worker threads for large scenes.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "SceneTransforms.h"
+
+#include <algorithm>
+
+namespace
+{
+	// fewest nodes or draws a pass hands to one job; shorter
+	// passes run on the calling thread, where queueing a job
+	// would cost more than it saves
+	const size_t PARALLEL_MIN_ITEMS = 1024;
+
+	/***********************************************************
+	 *  TransformBoundingBox()
+	 *
+	 *  This function is used for moving the bounding box of a
+	 *  mesh into world space with a model matrix. Each column
+	 *  of the matrix adds its smaller and larger product with
+	 *  the box extent along that axis, which gives the tight
+	 *  world box around the transformed corners.
+	 ***********************************************************/
+	SceneBVH::AABB TransformBoundingBox(
+		const glm::mat4& model,
+		const SceneBVH::AABB& bounds)
+	{
+		SceneBVH::AABB worldBounds;
+		worldBounds.minXYZ = glm::vec3(model[3]);
+		worldBounds.maxXYZ = worldBounds.minXYZ;
+
+		for (int axis = 0; axis < 3; axis++)
+		{
+			glm::vec3 column = glm::vec3(model[axis]);
+			glm::vec3 a = column * bounds.minXYZ[axis];
+			glm::vec3 b = column * bounds.maxXYZ[axis];
+			worldBounds.minXYZ += glm::min(a, b);
+			worldBounds.maxXYZ += glm::max(a, b);
+		}
+
+		return(worldBounds);
+	}
+}
+
+/***********************************************************
+ *  SceneTransforms()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+SceneTransforms::SceneTransforms()
+{
+	m_pJobSystem = NULL;
+	m_bNodesDirty = false;
+	m_bDepthLevelsValid = true;
+}
+
+/***********************************************************
+ *  Clear()
+ *
+ *  This method is used for dropping every node and draw,
+ *  before a new render list is recorded.
+ ***********************************************************/
+void SceneTransforms::Clear()
+{
+	m_tags.clear();
+	m_parentIDs.clear();
+	m_depths.clear();
+	m_localTransforms.Clear();
+	m_localMatrices.clear();
+	m_nodeWorlds.clear();
+	m_nodeDirty.clear();
+	m_nodeChanged.clear();
+	m_bNodesDirty = false;
+	m_depthLevels.clear();
+	m_bDepthLevelsValid = true;
+
+	m_drawNodes.clear();
+	m_drawMeshBounds.clear();
+	m_drawModels.clear();
+	m_drawNormals.clear();
+	m_drawBounds.clear();
+	m_previousDrawBounds.clear();
+	m_drawMoved.clear();
+	m_movedDraws.clear();
+}
+
+/***********************************************************
+ *  Reserve()
+ *
+ *  This method is used for sizing every node and draw array
+ *  for a scene whose size is known before it is added, such
+ *  as one read from a scene file.
+ ***********************************************************/
+void SceneTransforms::Reserve(size_t nodeCount, size_t drawCount)
+{
+	m_tags.reserve(nodeCount);
+	m_parentIDs.reserve(nodeCount);
+	m_depths.reserve(nodeCount);
+	m_localTransforms.Reserve(nodeCount);
+	m_localMatrices.reserve(nodeCount);
+	m_nodeWorlds.reserve(nodeCount);
+	m_nodeDirty.reserve(nodeCount);
+	m_nodeChanged.reserve(nodeCount);
+
+	m_drawNodes.reserve(drawCount);
+	m_drawMeshBounds.reserve(drawCount);
+	m_drawModels.reserve(drawCount);
+	m_drawNormals.reserve(drawCount);
+	m_drawBounds.reserve(drawCount);
+	m_previousDrawBounds.reserve(drawCount);
+	m_drawMoved.reserve(drawCount);
+}
+
+/***********************************************************
+ *  AddNode()
+ *
+ *  This method is used for adding a node with the passed in
+ *  local transformation as a child of parentID, and caching
+ *  its world matrix.
+ ***********************************************************/
+int SceneTransforms::AddNode(
+	const std::string& tag,
+	int parentID,
+	const glm::vec3& scaleXYZ,
+	const glm::vec3& rotationDegreesXYZ,
+	const glm::vec3& positionXYZ)
+{
+	MODEL_MATRIX local = MODEL_MATRIX(ComposeModelMatrix(scaleXYZ, rotationDegreesXYZ, positionXYZ));
+	MODEL_MATRIX world = local;
+	if (parentID >= 0)
+	{
+		MultiplyModelMatrices(m_nodeWorlds[parentID], local, world);
+	}
+
+	m_tags.push_back(tag);
+	m_parentIDs.push_back(parentID);
+	m_depths.push_back((parentID >= 0) ? m_depths[parentID] + 1 : 0);
+	m_localTransforms.Add(scaleXYZ, rotationDegreesXYZ, positionXYZ);
+	m_localMatrices.push_back(local);
+	m_nodeWorlds.push_back(world);
+	m_nodeDirty.push_back(0);
+	m_nodeChanged.push_back(0);
+	m_bDepthLevelsValid = false;
+
+	return((int)m_parentIDs.size() - 1);
+}
+
+/***********************************************************
+ *  SetNodeTransform()
+ *
+ *  This method is used for changing the local transform of
+ *  a node. The world matrices of the node, its descendants
+ *  and their draws are rebuilt by the next Update().
+ ***********************************************************/
+bool SceneTransforms::SetNodeTransform(
+	int nodeID,
+	const glm::vec3& scaleXYZ,
+	const glm::vec3& rotationDegreesXYZ,
+	const glm::vec3& positionXYZ)
+{
+	if ((nodeID < 0) || (nodeID >= GetNodeCount()))
+	{
+		return(false);
+	}
+
+	for (int axis = 0; axis < 3; axis++)
+	{
+		m_localTransforms.scaleXYZ[axis][nodeID] = scaleXYZ[axis];
+		m_localTransforms.rotationDegreesXYZ[axis][nodeID] = rotationDegreesXYZ[axis];
+		m_localTransforms.positionXYZ[axis][nodeID] = positionXYZ[axis];
+	}
+	m_nodeDirty[nodeID] = 1;
+	m_bNodesDirty = true;
+
+	return(true);
+}
+
+/***********************************************************
+ *  GetNodeTransform()
+ *
+ *  This method is used for reading back the local transform
+ *  a node was added or last set with.
+ ***********************************************************/
+bool SceneTransforms::GetNodeTransform(
+	int nodeID,
+	glm::vec3& scaleXYZ,
+	glm::vec3& rotationDegreesXYZ,
+	glm::vec3& positionXYZ) const
+{
+	if ((nodeID < 0) || (nodeID >= GetNodeCount()))
+	{
+		return(false);
+	}
+
+	for (int axis = 0; axis < 3; axis++)
+	{
+		scaleXYZ[axis] = m_localTransforms.scaleXYZ[axis][nodeID];
+		rotationDegreesXYZ[axis] = m_localTransforms.rotationDegreesXYZ[axis][nodeID];
+		positionXYZ[axis] = m_localTransforms.positionXYZ[axis][nodeID];
+	}
+
+	return(true);
+}
+
+/***********************************************************
+ *  TruncateNodes()
+ *
+ *  This method is used for dropping the nodes from nodeCount
+ *  on, like the temporary ones opened outside of recording.
+ *  No draw may follow them.
+ ***********************************************************/
+void SceneTransforms::TruncateNodes(int nodeCount)
+{
+	if ((nodeCount < 0) || (nodeCount >= GetNodeCount()))
+	{
+		return;
+	}
+
+	m_tags.resize(nodeCount);
+	m_parentIDs.resize(nodeCount);
+	m_depths.resize(nodeCount);
+	for (int axis = 0; axis < 3; axis++)
+	{
+		m_localTransforms.scaleXYZ[axis].resize(nodeCount);
+		m_localTransforms.rotationDegreesXYZ[axis].resize(nodeCount);
+		m_localTransforms.positionXYZ[axis].resize(nodeCount);
+	}
+	m_localMatrices.resize(nodeCount);
+	m_nodeWorlds.resize(nodeCount);
+	m_nodeDirty.resize(nodeCount);
+	m_nodeChanged.resize(nodeCount);
+	m_bDepthLevelsValid = false;
+}
+
+/***********************************************************
+ *  FindNode()
+ *
+ *  This method is used for getting the ID of the first node
+ *  with the passed in tag, -1 if there is none.
+ ***********************************************************/
+int SceneTransforms::FindNode(const std::string& tag) const
+{
+	for (size_t i = 0; i < m_tags.size(); i++)
+	{
+		if (m_tags[i].compare(tag) == 0)
+		{
+			return((int)i);
+		}
+	}
+
+	return(-1);
+}
+
+/***********************************************************
+ *  AddDraw()
+ *
+ *  This method is used for adding a draw of a mesh, with its
+ *  world box and normal matrix computed from the model
+ *  matrix.
+ ***********************************************************/
+uint32_t SceneTransforms::AddDraw(
+	int nodeID,
+	const glm::mat4& model,
+	const ShapeMeshes::BOUNDS& meshBounds)
+{
+	SceneBVH::AABB bounds;
+	bounds.minXYZ = meshBounds.minXYZ;
+	bounds.maxXYZ = meshBounds.maxXYZ;
+
+	m_drawNodes.push_back(nodeID);
+	m_drawMeshBounds.push_back(bounds);
+	m_drawModels.push_back(model);
+	m_drawNormals.push_back(ComputeNormalMatrix(model));
+	m_drawBounds.push_back(TransformBoundingBox(model, bounds));
+	m_previousDrawBounds.push_back(m_drawBounds.back());
+	m_drawMoved.push_back(0);
+
+	return((uint32_t)m_drawNodes.size() - 1);
+}
+
+/***********************************************************
+ *  SetDrawMeshBounds()
+ *
+ *  This method is used for replacing the mesh box of a draw
+ *  and moving the new box into world space with the model
+ *  the draw has now. The box before stays the previous one.
+ ***********************************************************/
+void SceneTransforms::SetDrawMeshBounds(uint32_t drawIndex, const SceneBVH::AABB& meshBounds)
+{
+	m_drawMeshBounds[drawIndex] = meshBounds;
+	m_drawBounds[drawIndex] = TransformBoundingBox(m_drawModels[drawIndex], meshBounds);
+}
+
+/***********************************************************
+ *  Update()
+ *
+ *  This method is used for rebuilding everything that moved
+ *  since the last update, in linear passes over the arrays:
+ *  flag the changed nodes in node order, so a flag reaches
+ *  every descendant, compose their local matrices, build the
+ *  world matrices one depth level at a time, since a level
+ *  only reads the one above, and move the draws of changed
+ *  nodes. All but the first pass split their range between
+ *  threads when it is large enough.
+ ***********************************************************/
+bool SceneTransforms::Update()
+{
+	m_movedDraws.clear();
+	if (m_bNodesDirty == false)
+	{
+		return(false);
+	}
+	m_bNodesDirty = false;
+
+	const size_t nodeCount = m_parentIDs.size();
+	for (size_t i = 0; i < nodeCount; i++)
+	{
+		int parentID = m_parentIDs[i];
+		m_nodeChanged[i] = ((m_nodeDirty[i] != 0) || ((parentID >= 0) && (m_nodeChanged[parentID] != 0))) ? 1 : 0;
+		m_nodeDirty[i] = 0;
+	}
+
+	ParallelFor(nodeCount, [this](size_t first, size_t end) { ComposeChangedNodes(first, end); });
+
+	if (m_bDepthLevelsValid == false)
+	{
+		BuildDepthLevels();
+	}
+	for (size_t depth = 0; depth < m_depthLevels.size(); depth++)
+	{
+		const std::vector<uint32_t>& level = m_depthLevels[depth];
+		ParallelFor(level.size(), [this, &level](size_t first, size_t end) { UpdateLevelWorlds(level, first, end); });
+	}
+
+	const size_t drawCount = m_drawNodes.size();
+	ParallelFor(drawCount, [this](size_t first, size_t end) { UpdateDraws(first, end); });
+	for (size_t i = 0; i < drawCount; i++)
+	{
+		if (m_drawMoved[i] != 0)
+		{
+			m_movedDraws.push_back((uint32_t)i);
+		}
+	}
+
+	return(true);
+}
+
+/***********************************************************
+ *  ParallelFor()
+ *
+ *  This method is used for running a pass over the items
+ *  [0, count) as ranges spread over the threads of the job
+ *  system, or all of them on the calling thread without
+ *  one. The ranges are multiples of four, so the SIMD paths
+ *  see whole groups.
+ ***********************************************************/
+void SceneTransforms::ParallelFor(size_t count, const std::function<void(size_t, size_t)>& pass)
+{
+	if (NULL == m_pJobSystem)
+	{
+		pass((size_t)0, count);
+		return;
+	}
+	m_pJobSystem->ParallelFor(count, PARALLEL_MIN_ITEMS, pass);
+}
+
+/***********************************************************
+ *  ComposeChangedNodes()
+ *
+ *  This method is used for composing the local matrices of
+ *  the changed nodes in [first, end). Runs of consecutive
+ *  changed nodes, which is what moving an object gives, are
+ *  composed together four at a time.
+ ***********************************************************/
+void SceneTransforms::ComposeChangedNodes(size_t first, size_t end)
+{
+	size_t i = first;
+	while (i < end)
+	{
+		if (m_nodeChanged[i] == 0)
+		{
+			i++;
+			continue;
+		}
+
+		size_t runEnd = i + 1;
+		while ((runEnd < end) && (m_nodeChanged[runEnd] != 0))
+		{
+			runEnd++;
+		}
+		ComposeModelMatrices(m_localTransforms, i, runEnd - i, &m_localMatrices[i]);
+		i = runEnd;
+	}
+}
+
+/***********************************************************
+ *  UpdateLevelWorlds()
+ *
+ *  This method is used for rebuilding the world matrices of
+ *  the changed nodes in [first, end) of one depth level from
+ *  the world matrices of their parents, with the batch
+ *  kernel the processor runs best.
+ ***********************************************************/
+void SceneTransforms::UpdateLevelWorlds(
+	const std::vector<uint32_t>& level,
+	size_t first,
+	size_t end)
+{
+	if (first < end)
+	{
+		UpdateWorldMatrixBatch(&level[first], end - first, m_parentIDs.data(), m_nodeChanged.data(),
+			m_localMatrices.data(), m_nodeWorlds.data());
+	}
+}
+
+/***********************************************************
+ *  UpdateDraws()
+ *
+ *  This method is used for copying the world matrix of the
+ *  changed nodes into the draws of [first, end) following
+ *  them, with their normal matrices, and moving their boxes,
+ *  keeping the previous boxes for the caller.
+ ***********************************************************/
+void SceneTransforms::UpdateDraws(size_t first, size_t end)
+{
+	for (size_t i = first; i < end; i++)
+	{
+		int nodeID = m_drawNodes[i];
+		m_drawMoved[i] = ((nodeID >= 0) && (m_nodeChanged[nodeID] != 0)) ? 1 : 0;
+		if (m_drawMoved[i] != 0)
+		{
+			m_previousDrawBounds[i] = m_drawBounds[i];
+			m_drawModels[i] = glm::mat4(m_nodeWorlds[nodeID]);
+			m_drawNormals[i] = ComputeNormalMatrix(m_drawModels[i]);
+			m_drawBounds[i] = TransformBoundingBox(m_drawModels[i], m_drawMeshBounds[i]);
+		}
+	}
+}
+
+/***********************************************************
+ *  BuildDepthLevels()
+ *
+ *  This method is used for grouping the node IDs by their
+ *  depth in the hierarchy, in node order within a group.
+ ***********************************************************/
+void SceneTransforms::BuildDepthLevels()
+{
+	m_depthLevels.clear();
+	for (size_t i = 0; i < m_depths.size(); i++)
+	{
+		if (m_depths[i] >= (int)m_depthLevels.size())
+		{
+			m_depthLevels.resize(m_depths[i] + 1);
+		}
+		m_depthLevels[m_depths[i]].push_back((uint32_t)i);
+	}
+	m_bDepthLevelsValid = true;
+}
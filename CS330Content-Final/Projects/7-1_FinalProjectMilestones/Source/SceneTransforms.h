@@ -0,0 +1,140 @@
+///////////////////////////////////////////////////////////////////////////////
+// scenetransforms.h
+// ============
+// structure of arrays storage of the scene transforms
+//
+//  Keeps the transform hierarchy of the scene nodes and the world
+//  matrices and bounds of the render list draws in one array per
+//  component, updated in linear passes that are split between
+//  worker threads for large scenes.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "JobSystem.h"
+#include "ModelTransforms.h"
+#include "SceneBVH.h"
+#include "ShapeMeshes.h"
+
+#include <functional>
+#include <string>
+#include <vector>
+
+/***********************************************************
+ *  SceneTransforms
+ *
+ *  This class contains the local transforms and cached world
+ *  matrices of the scene nodes and the world matrix and box
+ *  of every draw following a node. Nodes are always added
+ *  after their parent. Update() rebuilds what moved since
+ *  the last one and lists the draws that moved with it.
+ ***********************************************************/
+class SceneTransforms
+{
+public:
+	// constructor
+	SceneTransforms();
+
+	// split the passes of Update() between the threads of a job
+	// system; without one they run on the calling thread
+	void SetJobSystem(JobSystem* pJobSystem) { m_pJobSystem = pJobSystem; }
+
+	// drop every node and draw
+	void Clear();
+	// make room for nodeCount nodes and drawCount draws, so adding
+	// a scene of known size allocates once per array
+	void Reserve(size_t nodeCount, size_t drawCount);
+
+	// add a node under parentID, -1 for none, and cache its world
+	// matrix; returns the node ID
+	int AddNode(
+		const std::string& tag,
+		int parentID,
+		const glm::vec3& scaleXYZ,
+		const glm::vec3& rotationDegreesXYZ,
+		const glm::vec3& positionXYZ);
+	// change the local transform of a node, false for unknown IDs
+	bool SetNodeTransform(
+		int nodeID,
+		const glm::vec3& scaleXYZ,
+		const glm::vec3& rotationDegreesXYZ,
+		const glm::vec3& positionXYZ);
+	// the local transform of a node, false for unknown IDs
+	bool GetNodeTransform(
+		int nodeID,
+		glm::vec3& scaleXYZ,
+		glm::vec3& rotationDegreesXYZ,
+		glm::vec3& positionXYZ) const;
+	// drop the nodes from nodeCount on
+	void TruncateNodes(int nodeCount);
+	// ID of the first node with the tag, -1 if there is none
+	int FindNode(const std::string& tag) const;
+	int GetNodeCount() const { return((int)m_parentIDs.size()); }
+	int GetNodeParent(int nodeID) const { return(m_parentIDs[nodeID]); }
+	const std::string& GetNodeTag(int nodeID) const { return(m_tags[nodeID]); }
+	// a packed copy of the aligned world matrix
+	glm::mat4 GetNodeWorld(int nodeID) const { return(glm::mat4(m_nodeWorlds[nodeID])); }
+
+	// add a draw of a mesh with the passed model matrix, following
+	// nodeID when it is not -1; returns the draw index
+	uint32_t AddDraw(
+		int nodeID,
+		const glm::mat4& model,
+		const ShapeMeshes::BOUNDS& meshBounds);
+	size_t GetDrawCount() const { return(m_drawNodes.size()); }
+	const glm::mat4& GetDrawModel(uint32_t drawIndex) const { return(m_drawModels[drawIndex]); }
+	const glm::mat3& GetDrawNormalMatrix(uint32_t drawIndex) const { return(m_drawNormals[drawIndex]); }
+	const SceneBVH::AABB& GetDrawBounds(uint32_t drawIndex) const { return(m_drawBounds[drawIndex]); }
+	int GetDrawNode(uint32_t drawIndex) const { return(m_drawNodes[drawIndex]); }
+	const SceneBVH::AABB& GetDrawMeshBounds(uint32_t drawIndex) const { return(m_drawMeshBounds[drawIndex]); }
+	// replace the mesh box of a draw, such as with one around every
+	// pose the GPU animates it through, and move it again
+	void SetDrawMeshBounds(uint32_t drawIndex, const SceneBVH::AABB& meshBounds);
+	const std::vector<SceneBVH::AABB>& GetAllDrawBounds() const { return(m_drawBounds); }
+
+	// rebuild the world matrices of moved nodes and the draws that
+	// follow them; false when nothing moved
+	bool Update();
+	// true when a node moved since the last Update()
+	bool HasPendingUpdate() const { return(m_bNodesDirty); }
+	// draws moved by the last Update(), in draw order, and the
+	// bounds they had before it
+	const std::vector<uint32_t>& GetMovedDraws() const { return(m_movedDraws); }
+	const SceneBVH::AABB& GetPreviousDrawBounds(uint32_t drawIndex) const { return(m_previousDrawBounds[drawIndex]); }
+
+private:
+	JobSystem* m_pJobSystem;
+	// nodes, parents always before their children
+	std::vector<std::string> m_tags;
+	std::vector<int> m_parentIDs;
+	std::vector<int> m_depths;		// 0 for nodes without parent
+	TRS_ARRAYS m_localTransforms;
+	// aligned for the SSE2 or NEON products of the hierarchy
+	MODEL_MATRIX_ARRAY m_localMatrices;
+	MODEL_MATRIX_ARRAY m_nodeWorlds;
+	std::vector<unsigned char> m_nodeDirty;		// local transform changed
+	std::vector<unsigned char> m_nodeChanged;	// world rebuilt by the last update
+	bool m_bNodesDirty;
+	// node IDs grouped by depth, so each group can be split
+	// between threads; rebuilt after nodes are added or dropped
+	std::vector<std::vector<uint32_t>> m_depthLevels;
+	bool m_bDepthLevelsValid;
+
+	// draws, indexed like the render list
+	std::vector<int> m_drawNodes;		// -1 for draws that never move
+	std::vector<SceneBVH::AABB> m_drawMeshBounds;
+	std::vector<glm::mat4> m_drawModels;		// packed, copied to the instance data
+	std::vector<glm::mat3> m_drawNormals;		// normal matrix of each model
+	std::vector<SceneBVH::AABB> m_drawBounds;
+	std::vector<SceneBVH::AABB> m_previousDrawBounds;
+	std::vector<unsigned char> m_drawMoved;
+	std::vector<uint32_t> m_movedDraws;
+
+	// run a pass over [0, count) on the threads of the job system
+	void ParallelFor(size_t count, const std::function<void(size_t, size_t)>& pass);
+	// passes of Update() over a range of nodes or draws
+	void ComposeChangedNodes(size_t first, size_t end);
+	void UpdateLevelWorlds(const std::vector<uint32_t>& level, size_t first, size_t end);
+	void UpdateDraws(size_t first, size_t end);
+	void BuildDepthLevels();
+};
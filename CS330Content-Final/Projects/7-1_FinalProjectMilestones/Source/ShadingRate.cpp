@@ -0,0 +1,410 @@
+///////////////////////////////////////////////////////////////////////////////
+// shadingrate.cpp
+// ============
+// variable rate shading of the low-detail regions of the deferred lighting
+//
+//  The frame is split into tiles, and a tile whose pixels all show a
+//  material flagged for coarse shading, and whose luminance barely
+//  varied in the previous frame, has its light shaded once per 2x2
+//  pixels. With GL_NV_shading_rate_image the rasterizer does it from
+//  a rate image; otherwise the lighting pass shades those tiles into
+//  a half resolution target first and reads the light back from it,
+//  keeping the albedo, reflections and depth of every pixel.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "ShadingRate.h"
+#include "GPUMemory.h"
+#include "GLTrace.h"
+
+#include <GLFW/glfw3.h>
+
+#include <cstring>
+
+namespace
+{
+	// image unit the compute shader writes the rate image through
+	const GLuint RATE_IMAGE_UNIT = 0;
+	// format of the frame copy and the coarse light, which only hold
+	// colors, at half the size of RGBA16F
+	const GLenum LIGHT_FORMAT = GL_R11F_G11F_B10F;
+
+	// tokens of GL_NV_shading_rate_image, which GLEW predates
+	const GLenum SHADING_RATE_IMAGE_NV = 0x9563;
+	const GLenum SHADING_RATE_1_INVOCATION_PER_PIXEL_NV = 0x9565;
+	const GLenum SHADING_RATE_1_INVOCATION_PER_2X2_PIXELS_NV = 0x9568;
+	const GLenum SHADING_RATE_IMAGE_TEXEL_WIDTH_NV = 0x955C;
+	const GLenum SHADING_RATE_IMAGE_TEXEL_HEIGHT_NV = 0x955D;
+	const GLenum SHADING_RATE_IMAGE_PALETTE_SIZE_NV = 0x955E;
+
+	// the rate of each value of the rate image, full and coarse
+	const GLenum RATE_PALETTE[] =
+	{
+		SHADING_RATE_1_INVOCATION_PER_PIXEL_NV,
+		SHADING_RATE_1_INVOCATION_PER_2X2_PIXELS_NV
+	};
+	const GLsizei RATE_PALETTE_SIZE = sizeof(RATE_PALETTE) / sizeof(RATE_PALETTE[0]);
+}
+
+/***********************************************************
+ *  ShadingRate()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+ShadingRate::ShadingRate(ShaderManager* pShaderManager)
+{
+	m_pShaderManager = pShaderManager;
+	m_rateProgram = 0;
+	m_coarseMaterialsLocation = -1;
+	m_rateTexture = 0;
+	m_frameTexture = 0;
+	m_coarseTexture = 0;
+	m_coarseFramebuffer = 0;
+	m_width = 0;
+	m_height = 0;
+	m_bFrameValid = false;
+	m_coarseMaterials = 0;
+	m_savedFramebuffer = 0;
+	for (int i = 0; i < 4; i++)
+	{
+		m_savedViewport[i] = 0;
+	}
+	m_pBindShadingRateImage = NULL;
+	m_pShadingRateImagePalette = NULL;
+}
+
+/***********************************************************
+ *  ~ShadingRate()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+ShadingRate::~ShadingRate()
+{
+	DestroyTextures();
+	if (0 != m_rateProgram)
+	{
+		glDeleteProgram(m_rateProgram);
+		m_rateProgram = 0;
+	}
+	m_pShaderManager = NULL;
+}
+
+/***********************************************************
+ *  Create()
+ *
+ *  This method is used for building the compute program
+ *  classifying the tiles, which needs OpenGL 4.3, and for
+ *  looking up the hardware rate image. The textures follow
+ *  the viewport, so they are made by the first frame.
+ ***********************************************************/
+bool ShadingRate::Create(const char* rateShaderPath)
+{
+	if ((NULL == m_pShaderManager) || (GLEW_VERSION_4_3 != GL_TRUE))
+	{
+		return(false);
+	}
+
+	m_rateProgram = m_pShaderManager->LoadComputeShader(rateShaderPath);
+	if (0 == m_rateProgram)
+	{
+		std::cout << "Variable rate shading disabled, its compute shader did not build" << std::endl;
+		return(false);
+	}
+	m_coarseMaterialsLocation = glGetUniformLocation(m_rateProgram, "coarseMaterials");
+
+	CreateHardwareRate();
+
+	return(true);
+}
+
+/***********************************************************
+ *  CreateHardwareRate()
+ *
+ *  This method is used for looking up the functions of
+ *  GL_NV_shading_rate_image when the context has it. The
+ *  tiles are classified at TILE_SIZE, so a rate image of
+ *  another texel size leaves the fallback in use.
+ ***********************************************************/
+void ShadingRate::CreateHardwareRate()
+{
+	bool bSupported = false;
+	GLint extensionCount = 0;
+	glGetIntegerv(GL_NUM_EXTENSIONS, &extensionCount);
+	for (GLint i = 0; (i < extensionCount) && (bSupported == false); i++)
+	{
+		const char* pExtension = (const char*)glGetStringi(GL_EXTENSIONS, (GLuint)i);
+		bSupported = (NULL != pExtension) && (strcmp(pExtension, "GL_NV_shading_rate_image") == 0);
+	}
+	if (bSupported == false)
+	{
+		return;
+	}
+
+	GLint texelWidth = 0;
+	GLint texelHeight = 0;
+	GLint paletteSize = 0;
+	glGetIntegerv(SHADING_RATE_IMAGE_TEXEL_WIDTH_NV, &texelWidth);
+	glGetIntegerv(SHADING_RATE_IMAGE_TEXEL_HEIGHT_NV, &texelHeight);
+	glGetIntegerv(SHADING_RATE_IMAGE_PALETTE_SIZE_NV, &paletteSize);
+	if ((texelWidth != TILE_SIZE) || (texelHeight != TILE_SIZE) || (paletteSize < RATE_PALETTE_SIZE))
+	{
+		return;
+	}
+
+	BindShadingRateImageProc pBind = (BindShadingRateImageProc)glfwGetProcAddress("glBindShadingRateImageNV");
+	ShadingRateImagePaletteProc pPalette =
+		(ShadingRateImagePaletteProc)glfwGetProcAddress("glShadingRateImagePaletteNV");
+	if ((NULL != pBind) && (NULL != pPalette))
+	{
+		m_pBindShadingRateImage = pBind;
+		m_pShadingRateImagePalette = pPalette;
+	}
+}
+
+/***********************************************************
+ *  CreateTextures()
+ *
+ *  This method is used for creating the rate image, a texel
+ *  per tile, the frame copy and the half resolution target
+ *  of the coarse light for a viewport size. The frame copy
+ *  starts out empty, so the first frame shades every pixel.
+ ***********************************************************/
+void ShadingRate::CreateTextures(int width, int height)
+{
+	DestroyTextures();
+
+	m_width = width;
+	m_height = height;
+	const int tilesX = (width + TILE_SIZE - 1) / TILE_SIZE;
+	const int tilesY = (height + TILE_SIZE - 1) / TILE_SIZE;
+	const int coarseWidth = (width + 1) / 2;
+	const int coarseHeight = (height + 1) / 2;
+
+	// create them on the rate unit, so the bindings of the scene
+	// textures stay what the shader manager expects
+	m_pShaderManager->SetActiveTextureUnit(RATE_TEXTURE_UNIT);
+
+	glGenTextures(1, &m_rateTexture);
+	m_pShaderManager->BindTexture(RATE_TEXTURE_UNIT, m_rateTexture);
+	glTexStorage2D(GL_TEXTURE_2D, 1, GL_R8UI, tilesX, tilesY);
+	GPUMemory::TrackTexture(m_rateTexture, GL_R8UI, tilesX, tilesY, 1, 1,
+		GPUMemory::CATEGORY_RENDER_TARGET, "shading rate image");
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+	glGenTextures(1, &m_frameTexture);
+	m_pShaderManager->BindTexture(RATE_TEXTURE_UNIT, m_frameTexture);
+	glTexStorage2D(GL_TEXTURE_2D, 1, LIGHT_FORMAT, width, height);
+	GPUMemory::TrackTexture(m_frameTexture, LIGHT_FORMAT, width, height, 1, 1,
+		GPUMemory::CATEGORY_RENDER_TARGET, "shading rate frame");
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+	glGenTextures(1, &m_coarseTexture);
+	m_pShaderManager->BindTexture(RATE_TEXTURE_UNIT, m_coarseTexture);
+	glTexStorage2D(GL_TEXTURE_2D, 1, LIGHT_FORMAT, coarseWidth, coarseHeight);
+	GPUMemory::TrackTexture(m_coarseTexture, LIGHT_FORMAT, coarseWidth, coarseHeight, 1, 1,
+		GPUMemory::CATEGORY_RENDER_TARGET, "coarse lighting");
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+	GLint boundFramebuffer = 0;
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &boundFramebuffer);
+	glGenFramebuffers(1, &m_coarseFramebuffer);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_coarseFramebuffer);
+	glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_coarseTexture, 0);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, (GLuint)boundFramebuffer);
+
+	m_bFrameValid = false;
+}
+
+/***********************************************************
+ *  DestroyTextures()
+ *
+ *  This method is used for freeing the rate image, the
+ *  frame copy and the coarse light.
+ ***********************************************************/
+void ShadingRate::DestroyTextures()
+{
+	// unbind first, so a new texture reusing an ID is never
+	// taken for the one already bound
+	if ((NULL != m_pShaderManager) && (0 != m_rateTexture))
+	{
+		m_pShaderManager->BindTexture(RATE_TEXTURE_UNIT, 0);
+		m_pShaderManager->BindTexture(COARSE_LIGHTING_TEXTURE_UNIT, 0);
+	}
+	if (0 != m_coarseFramebuffer)
+	{
+		glDeleteFramebuffers(1, &m_coarseFramebuffer);
+		m_coarseFramebuffer = 0;
+	}
+	if (0 != m_rateTexture)
+	{
+		GPUMemory::DeleteTextures(1, &m_rateTexture);
+		m_rateTexture = 0;
+	}
+	if (0 != m_frameTexture)
+	{
+		GPUMemory::DeleteTextures(1, &m_frameTexture);
+		m_frameTexture = 0;
+	}
+	if (0 != m_coarseTexture)
+	{
+		GPUMemory::DeleteTextures(1, &m_coarseTexture);
+		m_coarseTexture = 0;
+	}
+	m_width = 0;
+	m_height = 0;
+	m_bFrameValid = false;
+}
+
+/***********************************************************
+ *  BuildRateImage()
+ *
+ *  This method is used for writing the rate of every tile
+ *  of the viewport, one work group per tile. A tile is
+ *  coarse when each of its pixels shows a flagged material
+ *  and the luminance of the frame copy varies little over
+ *  it; the copy is not reprojected, so a tile moving into
+ *  detail is shaded coarsely for at most one frame. The
+ *  compute shader reads the copy and the materials on the
+ *  units of the lighting pass, which binds its own after.
+ ***********************************************************/
+bool ShadingRate::BuildRateImage(GLuint materialTexture)
+{
+	if (IsAvailable() == false)
+	{
+		return(false);
+	}
+
+	GLint viewport[4] = { 0, 0, 0, 0 };
+	glGetIntegerv(GL_VIEWPORT, viewport);
+	if ((viewport[2] <= 0) || (viewport[3] <= 0))
+	{
+		return(false);
+	}
+	if ((viewport[2] != m_width) || (viewport[3] != m_height))
+	{
+		CreateTextures(viewport[2], viewport[3]);
+	}
+	if (m_bFrameValid == false)
+	{
+		return(false);
+	}
+
+	m_pShaderManager->BindTexture(RATE_TEXTURE_UNIT, m_frameTexture);
+	m_pShaderManager->BindTexture(COARSE_LIGHTING_TEXTURE_UNIT, materialTexture);
+	m_pShaderManager->UseExternalProgram(m_rateProgram);
+	glUniform1ui(m_coarseMaterialsLocation, m_coarseMaterials);
+	glBindImageTexture(RATE_IMAGE_UNIT, m_rateTexture, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R8UI);
+	glDispatchCompute(
+		(m_width + TILE_SIZE - 1) / TILE_SIZE,
+		(m_height + TILE_SIZE - 1) / TILE_SIZE, 1);
+	glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+
+	return(true);
+}
+
+/***********************************************************
+ *  CaptureFrame()
+ *
+ *  This method is used for copying the lit frame from the
+ *  bound framebuffer, which the rate image of the next
+ *  frame measures. A viewport of another size than the
+ *  rate image leaves the copy invalid.
+ ***********************************************************/
+void ShadingRate::CaptureFrame()
+{
+	if ((IsAvailable() == false) || (0 == m_frameTexture))
+	{
+		return;
+	}
+
+	GLint viewport[4] = { 0, 0, 0, 0 };
+	glGetIntegerv(GL_VIEWPORT, viewport);
+	if ((viewport[2] != m_width) || (viewport[3] != m_height))
+	{
+		m_bFrameValid = false;
+		return;
+	}
+
+	GLint drawFramebuffer = 0;
+	GLint readFramebuffer = 0;
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &drawFramebuffer);
+	glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &readFramebuffer);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, (GLuint)drawFramebuffer);
+
+	m_pShaderManager->BindTexture(RATE_TEXTURE_UNIT, m_frameTexture);
+	m_pShaderManager->SetActiveTextureUnit(RATE_TEXTURE_UNIT);
+	GLTrace::RecordCopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, viewport[0], viewport[1], viewport[2], viewport[3]);
+	glCopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, viewport[0], viewport[1], viewport[2], viewport[3]);
+
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, (GLuint)readFramebuffer);
+	m_bFrameValid = true;
+}
+
+/***********************************************************
+ *  BeginHardwareRate()
+ *
+ *  This method is used for letting the rasterizer shade
+ *  the following draws at the rate of their tile, the
+ *  values of the rate image picking from the palette.
+ ***********************************************************/
+void ShadingRate::BeginHardwareRate()
+{
+	if (IsHardwareRate() == false)
+	{
+		return;
+	}
+
+	m_pBindShadingRateImage(m_rateTexture);
+	m_pShadingRateImagePalette(0, 0, RATE_PALETTE_SIZE, RATE_PALETTE);
+	glEnable(SHADING_RATE_IMAGE_NV);
+}
+
+/***********************************************************
+ *  EndHardwareRate()
+ *
+ *  This method is used for shading every pixel again.
+ ***********************************************************/
+void ShadingRate::EndHardwareRate()
+{
+	if (IsHardwareRate() == false)
+	{
+		return;
+	}
+
+	glDisable(SHADING_RATE_IMAGE_NV);
+	m_pBindShadingRateImage(0);
+}
+
+/***********************************************************
+ *  BeginCoarseLighting()
+ *
+ *  This method is used for switching to the half resolution
+ *  target of the coarse light, with the rate image on its
+ *  unit. Only the coarse tiles are written and later read,
+ *  so the target is never cleared.
+ ***********************************************************/
+void ShadingRate::BeginCoarseLighting()
+{
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &m_savedFramebuffer);
+	glGetIntegerv(GL_VIEWPORT, m_savedViewport);
+
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_coarseFramebuffer);
+	glViewport(0, 0, (m_width + 1) / 2, (m_height + 1) / 2);
+	m_pShaderManager->BindTexture(RATE_TEXTURE_UNIT, m_rateTexture);
+}
+
+/***********************************************************
+ *  EndCoarseLighting()
+ *
+ *  This method is used for returning to the framebuffer and
+ *  viewport of the lighting pass, and binding the coarse
+ *  light for the full resolution draw that reads it.
+ ***********************************************************/
+void ShadingRate::EndCoarseLighting()
+{
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, (GLuint)m_savedFramebuffer);
+	glViewport(m_savedViewport[0], m_savedViewport[1], m_savedViewport[2], m_savedViewport[3]);
+	m_pShaderManager->BindTexture(COARSE_LIGHTING_TEXTURE_UNIT, m_coarseTexture);
+}
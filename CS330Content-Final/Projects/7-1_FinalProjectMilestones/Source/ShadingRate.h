@@ -0,0 +1,122 @@
+///////////////////////////////////////////////////////////////////////////////
+// shadingrate.h
+// ============
+// variable rate shading of the low-detail regions of the deferred lighting
+//
+//  The frame is split into tiles, and a tile whose pixels all show a
+//  material flagged for coarse shading, and whose luminance barely
+//  varied in the previous frame, has its light shaded once per 2x2
+//  pixels. With GL_NV_shading_rate_image the rasterizer does it from
+//  a rate image; otherwise the lighting pass shades those tiles into
+//  a half resolution target first and reads the light back from it,
+//  keeping the albedo, reflections and depth of every pixel.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "ShaderManager.h"
+
+#include <cstdint>
+
+/***********************************************************
+ *  ShadingRate
+ *
+ *  This class contains the compute program classifying the
+ *  tiles into the rate image, the copy of the lit frame the
+ *  next classification measures, and the half resolution
+ *  target of the fallback. The rate image of a frame is
+ *  built between its G-buffer and lighting passes.
+ ***********************************************************/
+class ShadingRate
+{
+public:
+	// constructor
+	ShadingRate(ShaderManager* pShaderManager);
+	// destructor
+	~ShadingRate();
+
+	// texture units the lighting pass reads the rate image and the
+	// coarse light from, shared with the transparency targets, which
+	// are only bound after the lighting
+	static const int RATE_TEXTURE_UNIT = 18;
+	static const int COARSE_LIGHTING_TEXTURE_UNIT = 19;
+	// side of a tile of the rate image, in pixels, which is also the
+	// texel size of the hardware rate image
+	static const int TILE_SIZE = 16;
+
+	// what a draw of the lighting program shades, must match
+	// shadingRatePass in deferredLightingFragment.glsl
+	enum LIGHTING_PASS
+	{
+		// every pixel, or the rasterizer picks the rate
+		LIGHTING_PASS_FULL = 0,
+		// the light of the coarse tiles at half resolution
+		LIGHTING_PASS_COARSE,
+		// every pixel, with the light of the coarse tiles read back
+		LIGHTING_PASS_RESOLVE
+	};
+
+	// build the classifying program and look for the hardware rate
+	// image; false without compute shaders or when the program fails
+	bool Create(const char* rateShaderPath);
+	bool IsAvailable() const { return(0 != m_rateProgram); }
+	// true when the rasterizer shades the coarse tiles itself
+	bool IsHardwareRate() const { return(NULL != m_pShadingRateImagePalette); }
+
+	// bit i set for the materials with ID i shaded coarsely
+	void SetCoarseMaterials(uint32_t materialMask) { m_coarseMaterials = materialMask; }
+	// drop the frame copy, when the next frame does not follow it
+	void Invalidate() { m_bFrameValid = false; }
+
+	// classify the tiles of the G-buffer about to be lit, from its
+	// materials and the frame copy, sized for the viewport; false,
+	// shading every pixel, without a copy of the same size
+	bool BuildRateImage(GLuint materialTexture);
+	// copy the lit frame in the bound framebuffer for the next frame
+	void CaptureFrame();
+
+	// shade the draws between these at the rates of the rate image,
+	// with GL_NV_shading_rate_image
+	void BeginHardwareRate();
+	void EndHardwareRate();
+	// draw into the half resolution target between these, and bind
+	// the rate image and the coarse light for the lighting after
+	void BeginCoarseLighting();
+	void EndCoarseLighting();
+
+private:
+	// glBindShadingRateImageNV() and glShadingRateImagePaletteNV(),
+	// looked up by name since GLEW predates them
+	typedef void (GLAPIENTRY* BindShadingRateImageProc)(GLuint texture);
+	typedef void (GLAPIENTRY* ShadingRateImagePaletteProc)(GLuint viewport, GLuint first, GLsizei count,
+		const GLenum* pRates);
+
+	// pointer to shader manager object
+	ShaderManager* m_pShaderManager;
+	// compute program writing one texel of the rate image per tile
+	GLuint m_rateProgram;
+	GLint m_coarseMaterialsLocation;
+	// the rates per tile, 0 for full and 1 for coarse
+	GLuint m_rateTexture;
+	// copy of the lit frame before
+	GLuint m_frameTexture;
+	// light of the coarse tiles, a texel per 2x2 pixels
+	GLuint m_coarseTexture;
+	GLuint m_coarseFramebuffer;
+	int m_width;
+	int m_height;
+	bool m_bFrameValid;
+	uint32_t m_coarseMaterials;
+	// framebuffer and viewport to restore after the coarse lighting
+	GLint m_savedFramebuffer;
+	GLint m_savedViewport[4];
+	BindShadingRateImageProc m_pBindShadingRateImage;
+	ShadingRateImagePaletteProc m_pShadingRateImagePalette;
+
+	// create the textures for a viewport size
+	void CreateTextures(int width, int height);
+	void DestroyTextures();
+	// look for GL_NV_shading_rate_image with the tile size of the
+	// rate image
+	void CreateHardwareRate();
+};
@@ -0,0 +1,587 @@
+///////////////////////////////////////////////////////////////////////////////
+// shadowatlas.cpp
+// ============
+// cached cube shadow maps of the point lights, packed into one atlas
+//
+//  Every shadowed light owns a cube of a depth cube map array, the
+//  atlas. Cubes are only re-rendered when their light moves or a caster
+//  inside its volume changes, so static lights over static geometry
+//  are rendered once. A caster is drawn once for all six faces of a
+//  cube, an instance for each face its bounds reach, every instance
+//  writing the layer of its face.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "ShadowAtlas.h"
+#include "GPUMemory.h"
+#include "GLTrace.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <cstddef>
+#include <cstring>
+
+namespace
+{
+	// bytes of one DEPTH_COMPONENT24 texel as drivers store it
+	const size_t SHADOW_TEXEL_BYTES = 4;
+	// near plane of the cube faces
+	const float SHADOW_NEAR_PLANE = 0.05f;
+	// window depth subtracted before the comparison, with the slope
+	// scaled polygon offset of the caster pass against acne
+	const float SHADOW_DEPTH_BIAS = 0.0002f;
+	const float SHADOW_OFFSET_FACTOR = 2.0f;
+	const float SHADOW_OFFSET_UNITS = 4.0f;
+
+	// view direction and up vector of the cube faces, in the
+	// +X, -X, +Y, -Y, +Z, -Z layer order of a cube map
+	const glm::vec3 g_FaceDirections[ShadowAtlas::SHADOW_FACES] =
+	{
+		glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(-1.0f, 0.0f, 0.0f),
+		glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f),
+		glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 0.0f, -1.0f)
+	};
+	const glm::vec3 g_FaceUps[ShadowAtlas::SHADOW_FACES] =
+	{
+		glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f),
+		glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 0.0f, -1.0f),
+		glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f)
+	};
+
+	/***********************************************************
+	 *  SphereOverlapsBox()
+	 *
+	 *  This function is used for testing a light volume against
+	 *  a box, through the box point closest to the center.
+	 ***********************************************************/
+	bool SphereOverlapsBox(const glm::vec4& sphere, const SceneBVH::AABB& box)
+	{
+		glm::vec3 center = glm::vec3(sphere);
+		glm::vec3 offset = glm::clamp(center, box.minXYZ, box.maxXYZ) - center;
+		return(glm::dot(offset, offset) <= (sphere.w * sphere.w));
+	}
+
+	/***********************************************************
+	 *  GetFaceMask()
+	 *
+	 *  This function is used for finding the cube faces of a
+	 *  light that can see a box, a bit per face. A face sees
+	 *  the points whose offset from the light is largest along
+	 *  its axis, so it is missed when the box does not reach as
+	 *  far along that axis as it stays away along the others.
+	 ***********************************************************/
+	int GetFaceMask(const glm::vec4& sphere, const SceneBVH::AABB& box)
+	{
+		glm::vec3 minOffset = box.minXYZ - glm::vec3(sphere);
+		glm::vec3 maxOffset = box.maxXYZ - glm::vec3(sphere);
+		// smallest distance of the box from the light along each axis
+		glm::vec3 nearest = glm::max(glm::max(minOffset, -maxOffset), glm::vec3(0.0f));
+
+		int faceMask = 0;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			float across = glm::max(nearest[(axis + 1) % 3], nearest[(axis + 2) % 3]);
+			if (maxOffset[axis] >= across)
+			{
+				faceMask |= 1 << (axis * 2);
+			}
+			if (-minOffset[axis] >= across)
+			{
+				faceMask |= 1 << ((axis * 2) + 1);
+			}
+		}
+		return(faceMask);
+	}
+
+	/***********************************************************
+	 *  CountBits()
+	 *
+	 *  This function is used for counting the faces of a mask.
+	 ***********************************************************/
+	int CountBits(int mask)
+	{
+		int count = 0;
+		for (; mask != 0; mask &= mask - 1)
+		{
+			count++;
+		}
+		return(count);
+	}
+}
+
+/***********************************************************
+ *  ShadowAtlas()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+ShadowAtlas::ShadowAtlas(ShaderManager* pShaderManager)
+{
+	m_pShaderManager = pShaderManager;
+	m_casterProgram = 0;
+	m_modelLocation = -1;
+	m_faceViewProjectionLocation = -1;
+	m_faceMaskLocation = -1;
+	m_firstLayerLocation = -1;
+	m_bLayered = false;
+	m_atlasTexture = 0;
+	m_framebuffer = 0;
+	m_shadowCapacity = 0;
+	m_currentShadow = 0;
+	m_passFace = -1;
+	m_quality = SHADOW_QUALITY_MEDIUM;
+	memset(&m_shadowData, 0, sizeof(m_shadowData));
+	m_bShadowDataDirty = true;
+	m_savedFramebuffer = 0;
+	memset(m_savedViewport, 0, sizeof(m_savedViewport));
+	m_savedDepthFunc = GL_LESS;
+	m_savedClearDepth = 1.0f;
+	m_savedClipDepthMode = GL_NEGATIVE_ONE_TO_ONE;
+}
+
+/***********************************************************
+ *  ~ShadowAtlas()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+ShadowAtlas::~ShadowAtlas()
+{
+	if ((NULL != m_pShaderManager) && (0 != m_atlasTexture))
+	{
+		m_pShaderManager->BindTexture(SHADOW_ATLAS_TEXTURE_UNIT, 0, GL_TEXTURE_CUBE_MAP_ARRAY);
+	}
+	if (0 != m_framebuffer)
+	{
+		glDeleteFramebuffers(1, &m_framebuffer);
+		m_framebuffer = 0;
+	}
+	if (0 != m_atlasTexture)
+	{
+		GPUMemory::DeleteTextures(1, &m_atlasTexture);
+		m_atlasTexture = 0;
+	}
+	m_shadowDataBuffer.Destroy();
+	if (0 != m_casterProgram)
+	{
+		glDeleteProgram(m_casterProgram);
+		m_casterProgram = 0;
+	}
+	m_pShaderManager = NULL;
+}
+
+/***********************************************************
+ *  Create()
+ *
+ *  This method is used for creating the atlas and building
+ *  the caster program. The atlas holds as many cubes as fit
+ *  the memory budget, one per light, so the budget decides
+ *  how many lights can cast shadows.
+ ***********************************************************/
+bool ShadowAtlas::Create(
+	const char* casterVertexPath,
+	const char* casterFragmentPath,
+	size_t memoryBudgetBytes)
+{
+	if (NULL == m_pShaderManager)
+	{
+		return(false);
+	}
+
+	GLint maxLayers = 0;
+	glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &maxLayers);
+	size_t cubeBytes = (size_t)SHADOW_TILE_SIZE * SHADOW_TILE_SIZE * SHADOW_TEXEL_BYTES * SHADOW_FACES;
+	m_shadowCapacity = (int)glm::min(memoryBudgetBytes / cubeBytes, (size_t)MAX_SHADOWED_LIGHTS);
+	m_shadowCapacity = glm::min(m_shadowCapacity, (int)maxLayers / SHADOW_FACES);
+	if (m_shadowCapacity <= 0)
+	{
+		std::cout << "Shadows disabled, the atlas budget of " << memoryBudgetBytes <<
+			" bytes holds no cube shadow map" << std::endl;
+		return(false);
+	}
+
+	m_casterProgram = m_pShaderManager->LoadExternalProgram(casterVertexPath, casterFragmentPath);
+	if (0 == m_casterProgram)
+	{
+		std::cout << "Shadows disabled, the shadow caster shader did not build" << std::endl;
+		return(false);
+	}
+	m_modelLocation = glGetUniformLocation(m_casterProgram, "model");
+	m_faceViewProjectionLocation = glGetUniformLocation(m_casterProgram, "faceViewProjection");
+	m_faceMaskLocation = glGetUniformLocation(m_casterProgram, "faceMask");
+	m_firstLayerLocation = glGetUniformLocation(m_casterProgram, "firstLayer");
+	// the vertex shader picks the layer of every instance, so one
+	// draw reaches all the faces of a cube
+	m_bLayered = (GLEW_ARB_shader_viewport_layer_array == GL_TRUE);
+
+	// create on the atlas unit, so the bindings of the scene
+	// textures stay what the shader manager expects; hardware
+	// comparison filters the 2x2 texels of every lookup, and
+	// seamless cube filtering blends them across the face edges
+	int layerCount = m_shadowCapacity * SHADOW_FACES;
+	glGenTextures(1, &m_atlasTexture);
+	m_pShaderManager->BindTexture(SHADOW_ATLAS_TEXTURE_UNIT, m_atlasTexture, GL_TEXTURE_CUBE_MAP_ARRAY);
+	m_pShaderManager->SetActiveTextureUnit(SHADOW_ATLAS_TEXTURE_UNIT);
+	glTexImage3D(GL_TEXTURE_CUBE_MAP_ARRAY, 0, GL_DEPTH_COMPONENT24, SHADOW_TILE_SIZE, SHADOW_TILE_SIZE,
+		layerCount, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, NULL);
+	GPUMemory::TrackTexture(m_atlasTexture, GL_DEPTH_COMPONENT24, SHADOW_TILE_SIZE, SHADOW_TILE_SIZE,
+		layerCount, 1, GPUMemory::CATEGORY_RENDER_TARGET, "shadow atlas");
+	glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+	glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
+
+	// layered, every layer is attached at once; otherwise a face
+	// is attached a pass
+	glGenFramebuffers(1, &m_framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+	if (m_bLayered == true)
+	{
+		glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, m_atlasTexture, 0);
+	}
+	else
+	{
+		glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, m_atlasTexture, 0, 0);
+	}
+	glDrawBuffer(GL_NONE);
+	glReadBuffer(GL_NONE);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+	{
+		std::cout << "Shadow atlas framebuffer is incomplete" << std::endl;
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	// the block is attached to its binding point once, like the light data
+	m_shadowDataBuffer.Create(GPUBuffer::USAGE_DYNAMIC, sizeof(SHADOW_DATA), NULL,
+		GPUMemory::CATEGORY_BUFFER, "shadow data");
+	glBindBufferBase(GL_UNIFORM_BUFFER, ShaderManager::SHADOW_DATA_BINDING, m_shadowDataBuffer.GetName());
+
+	m_shadowData.depthBias = SHADOW_DEPTH_BIAS;
+	m_shadowData.texelSize = 1.0f / (float)SHADOW_TILE_SIZE;
+	m_bShadowDataDirty = true;
+
+	return(true);
+}
+
+/***********************************************************
+ *  SetQuality()
+ *
+ *  This method is used for choosing the filtering of the
+ *  shadow lookups, one of the SHADOW_QUALITY levels.
+ ***********************************************************/
+void ShadowAtlas::SetQuality(int quality)
+{
+	quality = glm::clamp(quality, (int)SHADOW_QUALITY_OFF, (int)SHADOW_QUALITY_COUNT - 1);
+	if (quality != m_quality)
+	{
+		m_quality = quality;
+		m_bShadowDataDirty = true;
+	}
+}
+
+/***********************************************************
+ *  SetLights()
+ *
+ *  This method is used for handing out the shadows to the
+ *  lights in order, until the atlas is full. A shadow keeps
+ *  its cube while its light stays put, and is only marked
+ *  for a re-render once the light moved or its reach
+ *  changed.
+ ***********************************************************/
+void ShadowAtlas::SetLights(const std::vector<glm::vec4>& lightSpheres, std::vector<int>& shadowIndexes)
+{
+	shadowIndexes.assign(lightSpheres.size(), -1);
+	if (IsAvailable() == false)
+	{
+		return;
+	}
+
+	int shadowCount = 0;
+	for (size_t i = 0; i < lightSpheres.size(); i++)
+	{
+		if ((lightSpheres[i].w <= 0.0f) || (shadowCount >= m_shadowCapacity))
+		{
+			continue;
+		}
+
+		if (shadowCount >= (int)m_shadows.size())
+		{
+			SHADOW_ENTRY entry;
+			entry.sphere = glm::vec4(0.0f);
+			entry.bDirty = true;
+			m_shadows.push_back(entry);
+		}
+
+		SHADOW_ENTRY& entry = m_shadows[shadowCount];
+		if ((entry.bDirty == true) || (entry.sphere != lightSpheres[i]))
+		{
+			entry.sphere = lightSpheres[i];
+			entry.bDirty = true;
+			UpdateShadowData(shadowCount);
+		}
+		shadowIndexes[i] = shadowCount;
+		shadowCount++;
+	}
+	m_shadows.resize(shadowCount);
+}
+
+/***********************************************************
+ *  UpdateShadowData()
+ *
+ *  This method is used for working out the cube face
+ *  matrices of one shadow, kept for the caster pass, and
+ *  writing its depth range into the ShadowData block. The
+ *  faces share the light position and span 90 degrees each,
+ *  so together they see every direction, and the lit shaders
+ *  only need the range to turn a distance into a depth.
+ ***********************************************************/
+void ShadowAtlas::UpdateShadowData(int shadowIndex)
+{
+	SHADOW_ENTRY& entry = m_shadows[shadowIndex];
+	glm::vec3 position = glm::vec3(entry.sphere);
+	glm::mat4 projection = glm::perspective(glm::radians(90.0f), 1.0f, SHADOW_NEAR_PLANE, entry.sphere.w);
+
+	for (int face = 0; face < SHADOW_FACES; face++)
+	{
+		entry.faceViewProjection[face] = projection *
+			glm::lookAt(position, position + g_FaceDirections[face], g_FaceUps[face]);
+	}
+
+	SHADOW_LIGHT& shadowLight = m_shadowData.shadows[shadowIndex];
+	shadowLight.depthRange[0] = SHADOW_NEAR_PLANE;
+	shadowLight.depthRange[1] = entry.sphere.w;
+	m_bShadowDataDirty = true;
+}
+
+/***********************************************************
+ *  InvalidateBox()
+ *
+ *  This method is used for marking every shadow whose light
+ *  volume overlaps the box for a re-render.
+ ***********************************************************/
+void ShadowAtlas::InvalidateBox(const SceneBVH::AABB& box)
+{
+	for (size_t i = 0; i < m_shadows.size(); i++)
+	{
+		if ((m_shadows[i].bDirty == false) && (SphereOverlapsBox(m_shadows[i].sphere, box) == true))
+		{
+			m_shadows[i].bDirty = true;
+		}
+	}
+}
+
+/***********************************************************
+ *  InvalidateAll()
+ *
+ *  This method is used for marking every shadow for a
+ *  re-render, e.g. after the render list was rebuilt.
+ ***********************************************************/
+void ShadowAtlas::InvalidateAll()
+{
+	for (size_t i = 0; i < m_shadows.size(); i++)
+	{
+		m_shadows[i].bDirty = true;
+	}
+}
+
+/***********************************************************
+ *  HasDirtyShadows()
+ *
+ *  This method is used for checking whether any shadow needs
+ *  its casters drawn again.
+ ***********************************************************/
+bool ShadowAtlas::HasDirtyShadows() const
+{
+	for (size_t i = 0; i < m_shadows.size(); i++)
+	{
+		if (m_shadows[i].bDirty == true)
+		{
+			return(true);
+		}
+	}
+
+	return(false);
+}
+
+/***********************************************************
+ *  IsShadowDirty()
+ *
+ *  This method is used for checking whether one shadow needs
+ *  its casters drawn again.
+ ***********************************************************/
+bool ShadowAtlas::IsShadowDirty(int shadowIndex) const
+{
+	if ((shadowIndex < 0) || (shadowIndex >= (int)m_shadows.size()))
+	{
+		return(false);
+	}
+
+	return(m_shadows[shadowIndex].bDirty);
+}
+
+/***********************************************************
+ *  GetShadowVolume()
+ *
+ *  This method is used for getting the box around the light
+ *  volume of a shadow, which holds all of its casters.
+ ***********************************************************/
+SceneBVH::AABB ShadowAtlas::GetShadowVolume(int shadowIndex) const
+{
+	const glm::vec4& sphere = m_shadows[shadowIndex].sphere;
+
+	SceneBVH::AABB volume;
+	volume.minXYZ = glm::vec3(sphere) - glm::vec3(sphere.w);
+	volume.maxXYZ = glm::vec3(sphere) + glm::vec3(sphere.w);
+	return(volume);
+}
+
+/***********************************************************
+ *  BeginShadowPass()
+ *
+ *  This method is used for switching to the atlas and the
+ *  caster program. The shadow maps keep the standard
+ *  depth convention the shadow lookups compare against, even
+ *  while the scene is drawn with reverse-Z depth.
+ ***********************************************************/
+void ShadowAtlas::BeginShadowPass()
+{
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &m_savedFramebuffer);
+	glGetIntegerv(GL_VIEWPORT, m_savedViewport);
+	glGetIntegerv(GL_DEPTH_FUNC, &m_savedDepthFunc);
+	glGetFloatv(GL_DEPTH_CLEAR_VALUE, &m_savedClearDepth);
+	if ((GLEW_VERSION_4_5 == GL_TRUE) || (GLEW_ARB_clip_control == GL_TRUE))
+	{
+		glGetIntegerv(GL_CLIP_DEPTH_MODE, &m_savedClipDepthMode);
+		glClipControl(GL_LOWER_LEFT, GL_NEGATIVE_ONE_TO_ONE);
+	}
+	glClearDepth(1.0);
+	glDepthFunc(GL_LESS);
+	glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+	glViewport(0, 0, SHADOW_TILE_SIZE, SHADOW_TILE_SIZE);
+	glEnable(GL_POLYGON_OFFSET_FILL);
+	glPolygonOffset(SHADOW_OFFSET_FACTOR, SHADOW_OFFSET_UNITS);
+	m_pShaderManager->UseExternalProgram(m_casterProgram);
+}
+
+/***********************************************************
+ *  BeginShadow()
+ *
+ *  This method is used for clearing the layers one pass of
+ *  a shadow draws and pointing the casters at them: the six
+ *  faces of its cube when layered, otherwise the one face
+ *  of the pass. A clear of the layered attachment would take
+ *  every cube, so the layered faces are cleared as a range
+ *  of the texture, or one layer at a time where that is not
+ *  supported.
+ ***********************************************************/
+void ShadowAtlas::BeginShadow(int shadowIndex, int pass)
+{
+	int firstLayer = shadowIndex * SHADOW_FACES;
+	if (m_bLayered == true)
+	{
+		m_passFace = -1;
+		if ((GLEW_VERSION_4_4 == GL_TRUE) || (GLEW_ARB_clear_texture == GL_TRUE))
+		{
+			GLfloat clearDepth = 1.0f;
+			glClearTexSubImage(m_atlasTexture, 0, 0, 0, firstLayer, SHADOW_TILE_SIZE, SHADOW_TILE_SIZE,
+				SHADOW_FACES, GL_DEPTH_COMPONENT, GL_FLOAT, &clearDepth);
+		}
+		else
+		{
+			for (int face = 0; face < SHADOW_FACES; face++)
+			{
+				glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, m_atlasTexture, 0, firstLayer + face);
+				GLTrace::RecordClear(GL_DEPTH_BUFFER_BIT);
+				glClear(GL_DEPTH_BUFFER_BIT);
+			}
+			glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, m_atlasTexture, 0);
+		}
+	}
+	else
+	{
+		m_passFace = pass;
+		glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, m_atlasTexture, 0, firstLayer + pass);
+		GLTrace::RecordClear(GL_DEPTH_BUFFER_BIT);
+		glClear(GL_DEPTH_BUFFER_BIT);
+	}
+
+	glUniformMatrix4fv(m_faceViewProjectionLocation, SHADOW_FACES, GL_FALSE,
+		&m_shadows[shadowIndex].faceViewProjection[0][0][0]);
+	glUniform1i(m_firstLayerLocation, firstLayer);
+	m_currentShadow = shadowIndex;
+}
+
+/***********************************************************
+ *  DrawCaster()
+ *
+ *  This method is used for drawing the depth of one caster
+ *  into the faces of the pass its bounds reach, with an
+ *  instance per face.
+ ***********************************************************/
+void ShadowAtlas::DrawCaster(const glm::mat4& model, const ShapeMeshes::DRAW_RANGE& range, const SceneBVH::AABB& bounds)
+{
+	int faceMask = GetFaceMask(m_shadows[m_currentShadow].sphere, bounds);
+	if (m_passFace >= 0)
+	{
+		faceMask &= 1 << m_passFace;
+	}
+	if (0 == faceMask)
+	{
+		return;
+	}
+
+	glUniformMatrix4fv(m_modelLocation, 1, GL_FALSE, &model[0][0]);
+	glUniform1i(m_faceMaskLocation, faceMask);
+	ShapeMeshes::DrawRange(range, CountBits(faceMask));
+}
+
+/***********************************************************
+ *  EndShadowPass()
+ *
+ *  This method is used for going back to the scene
+ *  framebuffer and viewport, with every shadow up to date.
+ ***********************************************************/
+void ShadowAtlas::EndShadowPass()
+{
+	glDisable(GL_POLYGON_OFFSET_FILL);
+	glBindFramebuffer(GL_FRAMEBUFFER, (GLuint)m_savedFramebuffer);
+	glViewport(m_savedViewport[0], m_savedViewport[1], m_savedViewport[2], m_savedViewport[3]);
+	if ((GLEW_VERSION_4_5 == GL_TRUE) || (GLEW_ARB_clip_control == GL_TRUE))
+	{
+		glClipControl(GL_LOWER_LEFT, (GLenum)m_savedClipDepthMode);
+	}
+	glClearDepth(m_savedClearDepth);
+	glDepthFunc((GLenum)m_savedDepthFunc);
+
+	for (size_t i = 0; i < m_shadows.size(); i++)
+	{
+		m_shadows[i].bDirty = false;
+	}
+}
+
+/***********************************************************
+ *  Upload()
+ *
+ *  This method is used for writing the ShadowData block with
+ *  a single upload, only when it has changed, and binding
+ *  the atlas for the lit shaders.
+ ***********************************************************/
+void ShadowAtlas::Upload()
+{
+	if (IsAvailable() == false)
+	{
+		return;
+	}
+
+	m_pShaderManager->BindTexture(SHADOW_ATLAS_TEXTURE_UNIT, m_atlasTexture, GL_TEXTURE_CUBE_MAP_ARRAY);
+	if (m_bShadowDataDirty == false)
+	{
+		return;
+	}
+
+	m_shadowData.quality = m_quality;
+	GLsizeiptr uploadSize = offsetof(SHADOW_DATA, shadows) + (m_shadows.size() * sizeof(SHADOW_LIGHT));
+	m_shadowDataBuffer.Update(0, uploadSize, &m_shadowData);
+
+	m_bShadowDataDirty = false;
+}
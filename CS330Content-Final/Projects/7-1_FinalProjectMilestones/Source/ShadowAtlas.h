@@ -0,0 +1,160 @@
+///////////////////////////////////////////////////////////////////////////////
+// shadowatlas.h
+// ============
+// cached cube shadow maps of the point lights, packed into one atlas
+//
+//  Every shadowed light owns a cube of a depth cube map array, the
+//  atlas. Cubes are only re-rendered when their light moves or a caster
+//  inside its volume changes, so static lights over static geometry
+//  are rendered once. A caster is drawn once for all six faces of a
+//  cube, an instance for each face its bounds reach, every instance
+//  writing the layer of its face.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "ShaderManager.h"
+#include "ShapeMeshes.h"
+#include "SceneBVH.h"
+#include "GPUBuffer.h"
+
+#include <vector>
+
+/***********************************************************
+ *  ShadowAtlas
+ *
+ *  This class contains the cube array, the caster program
+ *  and the ShadowData uniform block of the shadow maps. The
+ *  array is sized from a memory budget, which also bounds
+ *  how many lights can cast shadows.
+ ***********************************************************/
+class ShadowAtlas
+{
+public:
+	// constructor
+	ShadowAtlas(ShaderManager* pShaderManager);
+	// destructor
+	~ShadowAtlas();
+
+	// texture unit the lit shaders read the atlas from, above the
+	// G-buffer targets
+	static const int SHADOW_ATLAS_TEXTURE_UNIT = 24;
+	// side of one cube face, in texels
+	static const int SHADOW_TILE_SIZE = 512;
+	// cube faces per light
+	static const int SHADOW_FACES = 6;
+	// capacity of the ShadowData block, must match the shaders
+	static const int MAX_SHADOWED_LIGHTS = 8;
+
+	// filtering of the shadow lookups, cycled from the keyboard
+	enum SHADOW_QUALITY
+	{
+		SHADOW_QUALITY_OFF = 0,		// no shadows
+		SHADOW_QUALITY_LOW,			// one bilinear comparison
+		SHADOW_QUALITY_MEDIUM,		// 3x3 PCF
+		SHADOW_QUALITY_HIGH,		// 5x5 PCF
+		SHADOW_QUALITY_COUNT
+	};
+
+	// create the array of as many cubes as the budget holds and
+	// build the caster program; false when either fails
+	bool Create(
+		const char* casterVertexPath,
+		const char* casterFragmentPath,
+		size_t memoryBudgetBytes);
+	bool IsAvailable() const { return(0 != m_casterProgram); }
+	int GetShadowCapacity() const { return(m_shadowCapacity); }
+
+	void SetQuality(int quality);
+	int GetQuality() const { return(m_quality); }
+
+	// assign shadows to the lights, one (position, far distance) per
+	// light with 0 distance for the ones without shadow; returns the
+	// shadow index of every light, -1 when it has none
+	void SetLights(const std::vector<glm::vec4>& lightSpheres, std::vector<int>& shadowIndexes);
+	// mark the shadows whose light volume overlaps the box for a
+	// re-render, e.g. the old and new bounds of a moved caster
+	void InvalidateBox(const SceneBVH::AABB& box);
+	void InvalidateAll();
+
+	// true when some shadow needs its casters drawn again
+	bool HasDirtyShadows() const;
+	bool IsShadowDirty(int shadowIndex) const;
+	// box around the volume of a shadowed light, to find its casters
+	SceneBVH::AABB GetShadowVolume(int shadowIndex) const;
+
+	// draw the casters of the dirty shadows between these; every
+	// pass of a shadow clears its layers and takes all the casters
+	// with DrawCaster(), which skips the faces their bounds miss.
+	// A shadow takes one pass where the vertex shader can pick the
+	// layer it writes, otherwise one per face.
+	int GetPassCount() const { return((m_bLayered == true) ? 1 : SHADOW_FACES); }
+	void BeginShadowPass();
+	void BeginShadow(int shadowIndex, int pass);
+	void DrawCaster(const glm::mat4& model, const ShapeMeshes::DRAW_RANGE& range, const SceneBVH::AABB& bounds);
+	void EndShadowPass();
+
+	// upload the ShadowData block if it changed
+	void Upload();
+
+private:
+	// std140 layout of one ShadowLight of the ShadowData block
+	struct SHADOW_LIGHT
+	{
+		GLfloat depthRange[2];	// near and far plane of the faces
+		GLfloat padding[2];
+	};
+
+	// std140 layout of the ShadowData block
+	struct SHADOW_DATA
+	{
+		GLint quality;
+		GLfloat depthBias;
+		GLfloat texelSize;		// of a cube face, in uv
+		GLfloat padding;
+		SHADOW_LIGHT shadows[MAX_SHADOWED_LIGHTS];
+	};
+
+	// cached state of one shadow
+	struct SHADOW_ENTRY
+	{
+		glm::vec4 sphere;	// light position and far distance
+		glm::mat4 faceViewProjection[SHADOW_FACES];
+		bool bDirty;
+	};
+
+	// pointer to shader manager object
+	ShaderManager* m_pShaderManager;
+	// depth only program drawing one caster at a time
+	GLuint m_casterProgram;
+	GLint m_modelLocation;
+	GLint m_faceViewProjectionLocation;
+	GLint m_faceMaskLocation;
+	GLint m_firstLayerLocation;
+	bool m_bLayered;
+	// depth cube array and the framebuffer rendering into it
+	GLuint m_atlasTexture;
+	GLuint m_framebuffer;
+	int m_shadowCapacity;
+	// shadow of the pass, and its one face without layered
+	// rendering, -1 when it draws them all
+	int m_currentShadow;
+	int m_passFace;
+	int m_quality;
+	// shadows in use, indexed by shadow index
+	std::vector<SHADOW_ENTRY> m_shadows;
+	SHADOW_DATA m_shadowData;
+	// dynamic, written when a shadow is placed or rendered
+	GPUBuffer m_shadowDataBuffer;
+	bool m_bShadowDataDirty;
+	// framebuffer, viewport and depth convention to restore after
+	// the shadow pass
+	GLint m_savedFramebuffer;
+	GLint m_savedViewport[4];
+	GLint m_savedDepthFunc;
+	GLfloat m_savedClearDepth;
+	GLint m_savedClipDepthMode;
+
+	// write the face matrices and depth range of one shadow
+	void UpdateShadowData(int shadowIndex);
+};
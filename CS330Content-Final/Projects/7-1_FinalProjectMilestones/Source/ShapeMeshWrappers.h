@@ -5,60 +5,60 @@
 ///////////////////////////////////////////////////////////////////////////////
 // shapemeshwrappers.h
 // ============
-// call the default functions of equivelent shapemeshes.h functions
-// All in .h file due to simplicity. Seperate logic into .cpp if additional
-// complexity is required. 
+// name the default draws of equivelent shapemeshes.h functions as plain
+// descriptors, a shape and the part of it to draw, so a draw keeps its
+// mesh identity for sorting and batching instead of hiding it behind a
+// function pointer. All in .h file due to simplicity.
 //
 //  AUTHOR: Michael Lorenz - SNHU Student / Computer Science
 //	Created for CS-330-Computational Graphics and Visualization, Jul. 23rd, 2024
 ///////////////////////////////////////////////////////////////////////////////
-class ShapeMeshWrappers
+namespace ShapeMeshWrappers
 {
-public:
+   // descriptor of one basic mesh draw, passed by value: the shape
+   // and the part range it was generated with
+   struct MESH_DRAW
+   {
+      ShapeMeshes::MESH_SHAPE shape;
+      ShapeMeshes::MESH_PART part;
 
-   static void DrawBoxMeshWrapper(ShapeMeshes* meshObject) {
-      meshObject->DrawBoxMesh();
-   }
-   static void DrawConeMeshWrapper(ShapeMeshes* meshObject) {
-      meshObject->DrawConeMesh();
-   }
-   static void DrawCylinderMeshWrapper(ShapeMeshes* meshObject) {
-      meshObject->DrawCylinderMesh();
-   }
-   static void DrawHollowCylinderMeshWrapper(ShapeMeshes* meshObject) {
-      meshObject->DrawCylinderMesh(false, false);
-   }
-   static void DrawNoSideCylinderMeshWrapper(ShapeMeshes* meshObject) {
-      meshObject->DrawCylinderMesh(true, true, false);
-   }
-   static void DrawPlaneMeshWrapper(ShapeMeshes* meshObject) {
-      meshObject->DrawPlaneMesh();
-   }
-   static void DrawPrismMeshWrapper(ShapeMeshes* meshObject) {
-      meshObject->DrawPrismMesh();
-   }
-   static void DrawPyramid3MeshWrapper(ShapeMeshes* meshObject) {
-      meshObject->DrawPyramid3Mesh();
-   }
-   static void DrawPyramid4MeshWrapper(ShapeMeshes* meshObject) {
-      meshObject->DrawPyramid4Mesh();
-   }
-   static void DrawSphereMeshWrapper(ShapeMeshes* meshObject) {
-      meshObject->DrawSphereMesh();
-   }
-   static void DrawHalfSphereMeshWrapper(ShapeMeshes* meshObject) {
-      meshObject->DrawHalfSphereMesh();
-   }
-   static void DrawTaperedCylinderMeshWrapper(ShapeMeshes* meshObject) {
-      meshObject->DrawTaperedCylinderMesh();
-   }
-   static void DrawTorusMeshWrapper(ShapeMeshes* meshObject) {
-      meshObject->DrawTorusMesh();
-   }
-   static void DrawHalfTorusMeshWrapper(ShapeMeshes* meshObject) {
-      meshObject->DrawHalfTorusMesh();
+      // dense identity of the draw, for sort keys and batch lookups
+      constexpr unsigned int Key() const { return((unsigned int)shape * ShapeMeshes::PART_COUNT + part); }
+      constexpr bool operator==(const MESH_DRAW& other) const
+      {
+         return((shape == other.shape) && (part == other.part));
+      }
+      constexpr bool operator!=(const MESH_DRAW& other) const { return(!(*this == other)); }
+   };
+
+   // one past the largest key, None included
+   const unsigned int MESH_DRAW_KEY_COUNT = (ShapeMeshes::SHAPE_COUNT + 1) * ShapeMeshes::PART_COUNT;
+
+   // the variants the scene draws, with the default arguments of
+   // the matching ShapeMeshes draw methods
+   constexpr MESH_DRAW Box = { ShapeMeshes::SHAPE_BOX, ShapeMeshes::PART_WHOLE };
+   constexpr MESH_DRAW Cone = { ShapeMeshes::SHAPE_CONE, ShapeMeshes::PART_WHOLE };
+   constexpr MESH_DRAW Cylinder = { ShapeMeshes::SHAPE_CYLINDER, ShapeMeshes::PART_WHOLE };
+   constexpr MESH_DRAW HollowCylinder = { ShapeMeshes::SHAPE_CYLINDER, ShapeMeshes::PART_SIDES };
+   constexpr MESH_DRAW NoSideCylinder = { ShapeMeshes::SHAPE_CYLINDER, ShapeMeshes::PART_CAPS };
+   constexpr MESH_DRAW BottomCylinder = { ShapeMeshes::SHAPE_CYLINDER, ShapeMeshes::PART_BOTTOM };
+   constexpr MESH_DRAW Plane = { ShapeMeshes::SHAPE_PLANE, ShapeMeshes::PART_WHOLE };
+   constexpr MESH_DRAW Prism = { ShapeMeshes::SHAPE_PRISM, ShapeMeshes::PART_WHOLE };
+   constexpr MESH_DRAW Pyramid3 = { ShapeMeshes::SHAPE_PYRAMID3, ShapeMeshes::PART_WHOLE };
+   constexpr MESH_DRAW Pyramid4 = { ShapeMeshes::SHAPE_PYRAMID4, ShapeMeshes::PART_WHOLE };
+   constexpr MESH_DRAW Sphere = { ShapeMeshes::SHAPE_SPHERE, ShapeMeshes::PART_WHOLE };
+   constexpr MESH_DRAW HalfSphere = { ShapeMeshes::SHAPE_SPHERE, ShapeMeshes::PART_HALF };
+   constexpr MESH_DRAW TaperedCylinder = { ShapeMeshes::SHAPE_TAPERED_CYLINDER, ShapeMeshes::PART_WHOLE };
+   constexpr MESH_DRAW Torus = { ShapeMeshes::SHAPE_TORUS, ShapeMeshes::PART_WHOLE };
+   constexpr MESH_DRAW HalfTorus = { ShapeMeshes::SHAPE_TORUS, ShapeMeshes::PART_HALF };
+   constexpr MESH_DRAW None = { ShapeMeshes::SHAPE_COUNT, ShapeMeshes::PART_WHOLE };
+
+   // issue the draw a descriptor names, from the part ranges the
+   // shape was generated with
+   inline void DrawMesh(ShapeMeshes* meshObject, MESH_DRAW draw)
+   {
+      meshObject->DrawShapePart(draw.shape, draw.part);
    }
-   static void DrawNone(ShapeMeshes* meshObject) {}
-};
+}
 
 #endif // SHAPEMESHWRAPPERS_H
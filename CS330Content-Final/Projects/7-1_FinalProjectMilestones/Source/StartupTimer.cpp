@@ -0,0 +1,191 @@
+///////////////////////////////////////////////////////////////////////////////
+// startuptimer.cpp
+// ============
+// stages of the startup and the time to the first frame
+//
+//  The startup runs on several threads: the scene description is read
+//  while the window and context are created, and the shader compiles,
+//  image decodes, texture uploads and model imports go on after the
+//  first frame is drawn. Each stage is timed from the launch wherever
+//  it runs, and the breakdown is printed once the scene is complete,
+//  so the time to the first frame can be tracked from run to run.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "StartupTimer.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+
+namespace
+{
+	// width of the stage names in the report
+	const int STAGE_NAME_WIDTH = 24;
+}
+
+/***********************************************************
+ *  StartupTimer()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+StartupTimer::StartupTimer()
+{
+	m_launchTime = std::chrono::steady_clock::now();
+	m_firstFrameSeconds = -1.0;
+	m_sceneCompleteSeconds = -1.0;
+}
+
+/***********************************************************
+ *  GetSeconds()
+ *
+ *  This method is used for getting the time since launch.
+ *  The steady clock runs before GLFW is initialized, unlike
+ *  glfwGetTime(), which the first stages come before.
+ ***********************************************************/
+double StartupTimer::GetSeconds() const
+{
+	return(std::chrono::duration<double>(std::chrono::steady_clock::now() - m_launchTime).count());
+}
+
+/***********************************************************
+ *  BeginStage()
+ *
+ *  This method is used for starting the timing of a stage.
+ ***********************************************************/
+int StartupTimer::BeginStage(const char* name)
+{
+	STARTUP_STAGE stage;
+	stage.name = name;
+	stage.startSeconds = GetSeconds();
+	stage.endSeconds = -1.0;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_stages.push_back(stage);
+	return((int)m_stages.size() - 1);
+}
+
+/***********************************************************
+ *  EndStage()
+ *
+ *  This method is used for ending the timing of a stage; a
+ *  stage ended before keeps its first end.
+ ***********************************************************/
+void StartupTimer::EndStage(int stage)
+{
+	double endSeconds = GetSeconds();
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if ((stage >= 0) && (stage < (int)m_stages.size()) && (m_stages[stage].endSeconds < 0.0))
+	{
+		m_stages[stage].endSeconds = endSeconds;
+	}
+}
+
+/***********************************************************
+ *  IsStageRunning()
+ *
+ *  This method is used for checking whether a stage began
+ *  and has not ended yet.
+ ***********************************************************/
+bool StartupTimer::IsStageRunning(int stage) const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return((stage >= 0) && (stage < (int)m_stages.size()) && (m_stages[stage].endSeconds < 0.0));
+}
+
+/***********************************************************
+ *  FirstFrame()
+ *
+ *  This method is used for noting the first presented frame.
+ ***********************************************************/
+void StartupTimer::FirstFrame()
+{
+	double seconds = GetSeconds();
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (m_firstFrameSeconds < 0.0)
+	{
+		m_firstFrameSeconds = seconds;
+	}
+}
+
+/***********************************************************
+ *  SceneComplete()
+ *
+ *  This method is used for noting the first frame with the
+ *  whole scene in it.
+ ***********************************************************/
+void StartupTimer::SceneComplete()
+{
+	double seconds = GetSeconds();
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (m_sceneCompleteSeconds < 0.0)
+	{
+		m_sceneCompleteSeconds = seconds;
+	}
+}
+
+/***********************************************************
+ *  IsSceneComplete()
+ *
+ *  This method is used for checking whether the complete
+ *  scene was drawn yet.
+ ***********************************************************/
+bool StartupTimer::IsSceneComplete() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return(m_sceneCompleteSeconds >= 0.0);
+}
+
+/***********************************************************
+ *  Print()
+ *
+ *  This method is used for printing the stages in the order
+ *  they began. A stage still running is shown up to now.
+ *  The sum of the stage times past the span they cover is
+ *  the time saved by running them side by side.
+ ***********************************************************/
+void StartupTimer::Print() const
+{
+	double nowSeconds = GetSeconds();
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	std::cout << "\n*** STARTUP: ***\n";
+	std::cout << std::left << std::setw(STAGE_NAME_WIDTH) << "stage" << std::right
+		<< "start ms\ttime ms\n";
+
+	double stageSeconds = 0.0;
+	double firstSeconds = 0.0;
+	double lastSeconds = 0.0;
+	std::streamsize precision = std::cout.precision();
+	std::cout << std::fixed << std::setprecision(1);
+	for (size_t i = 0; i < m_stages.size(); i++)
+	{
+		const STARTUP_STAGE& stage = m_stages[i];
+		double endSeconds = (stage.endSeconds >= 0.0) ? stage.endSeconds : nowSeconds;
+		std::cout << std::left << std::setw(STAGE_NAME_WIDTH) << stage.name << std::right
+			<< std::setw(8) << (stage.startSeconds * 1000.0) << "\t"
+			<< std::setw(7) << ((endSeconds - stage.startSeconds) * 1000.0)
+			<< ((stage.endSeconds < 0.0) ? "\trunning" : "") << "\n";
+
+		stageSeconds += endSeconds - stage.startSeconds;
+		firstSeconds = (i == 0) ? stage.startSeconds : std::min(firstSeconds, stage.startSeconds);
+		lastSeconds = std::max(lastSeconds, endSeconds);
+	}
+
+	std::cout << "time to first frame " << ((m_firstFrameSeconds >= 0.0) ? m_firstFrameSeconds * 1000.0 : 0.0) << " ms"
+		<< "\tto complete scene ";
+	if (m_sceneCompleteSeconds >= 0.0)
+	{
+		std::cout << (m_sceneCompleteSeconds * 1000.0) << " ms\n";
+	}
+	else
+	{
+		std::cout << "not reached\n";
+	}
+	std::cout << "stages " << (stageSeconds * 1000.0) << " ms"
+		<< "\tspan " << ((lastSeconds - firstSeconds) * 1000.0) << " ms"
+		<< "\toverlapped " << (std::max(stageSeconds - (lastSeconds - firstSeconds), 0.0) * 1000.0) << " ms\n";
+	std::cout << std::defaultfloat << std::setprecision(precision);
+}
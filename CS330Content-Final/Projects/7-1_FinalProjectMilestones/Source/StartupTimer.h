@@ -0,0 +1,65 @@
+///////////////////////////////////////////////////////////////////////////////
+// startuptimer.h
+// ============
+// stages of the startup and the time to the first frame
+//
+//  The startup runs on several threads: the scene description is read
+//  while the window and context are created, and the shader compiles,
+//  image decodes, texture uploads and model imports go on after the
+//  first frame is drawn. Each stage is timed from the launch wherever
+//  it runs, and the breakdown is printed once the scene is complete,
+//  so the time to the first frame can be tracked from run to run.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/***********************************************************
+ *  StartupTimer
+ *
+ *  This class contains the stages timed since the launch.
+ *  BeginStage() and EndStage() may be called on any thread,
+ *  and stages may overlap.
+ ***********************************************************/
+class StartupTimer
+{
+public:
+	// constructor; the launch is timed from here
+	StartupTimer();
+
+	// start timing a stage, returning the id EndStage() takes
+	int BeginStage(const char* name);
+	void EndStage(int stage);
+	// true while the stage has not ended
+	bool IsStageRunning(int stage) const;
+
+	// the first frame was presented, and the first with every
+	// texture, model and shader program of the scene in it
+	void FirstFrame();
+	void SceneComplete();
+	bool IsSceneComplete() const;
+
+	// print every stage with its start and length, the times of the
+	// first frames, and how much of the work overlapped
+	void Print() const;
+
+private:
+	struct STARTUP_STAGE
+	{
+		std::string name;
+		double startSeconds;
+		double endSeconds;		// negative while running
+	};
+
+	std::chrono::steady_clock::time_point m_launchTime;
+	std::vector<STARTUP_STAGE> m_stages;
+	double m_firstFrameSeconds;		// negative until presented
+	double m_sceneCompleteSeconds;
+	mutable std::mutex m_mutex;
+
+	double GetSeconds() const;
+};
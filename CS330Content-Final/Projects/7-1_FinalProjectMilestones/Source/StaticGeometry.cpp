@@ -0,0 +1,776 @@
+///////////////////////////////////////////////////////////////////////////////
+// staticgeometry.cpp
+// ============
+// static draws baked into merged world space buffers
+//
+//  Pre-transforms the draws of objects that never move into one
+//  vertex and index buffer, with one triangle list per shader
+//  state, so the static environment renders in a handful of
+//  draws. With lightmaps the merged triangles also get a second UV
+//  set into the lightmap atlas of LightmapBaker. The baked buffers
+//  can be cached next to the scene file.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "StaticGeometry.h"
+#include "AssetPack.h"
+#include "GPUMemory.h"
+#include "LightmapBaker.h"
+#include "ModelTransforms.h"
+
+#include <cfloat>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+namespace
+{
+	// "SGBK" and the layout version of the cache files
+	const uint32_t CACHE_MAGIC = 0x4B424753;
+	const uint32_t CACHE_VERSION = 2;
+
+	const int VERTEX_FLOATS = ShapeMeshes::VERTEX_FLOATS;
+	const int LIGHTMAP_UV_FLOATS = LightmapBaker::LIGHTMAP_UV_FLOATS;
+	// vertex attribute and buffer binding of the lightmap coordinates
+	const GLuint LIGHTMAP_UV_ATTRIBUTE = 3;
+	const GLuint LIGHTMAP_UV_BINDING = 1;
+
+	struct CACHE_HEADER
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint64_t key;
+		uint32_t vertexFloatCount;
+		uint32_t indexCount;
+		uint32_t groupCount;
+		uint32_t lightmapUVFloatCount;
+		int32_t lightmapWidth;
+		int32_t lightmapHeight;
+	};
+
+	struct CACHE_GROUP
+	{
+		int32_t firstIndex;
+		int32_t indexCount;
+		int32_t textureSlot;
+		int32_t materialID;
+		float color[4];
+		float minXYZ[3];
+		float maxXYZ[3];
+		float center[3];
+		float radius;
+	};
+
+	/***********************************************************
+	 *  HashBytes()
+	 *
+	 *  This function is used for adding bytes to a 64 bit
+	 *  FNV-1a hash.
+	 ***********************************************************/
+	uint64_t HashBytes(uint64_t hash, const void* pData, size_t size)
+	{
+		const unsigned char* pBytes = (const unsigned char*)pData;
+		for (size_t i = 0; i < size; i++)
+		{
+			hash ^= pBytes[i];
+			hash *= 1099511628211ull;
+		}
+		return(hash);
+	}
+
+	/***********************************************************
+	 *  AppendTriangle()
+	 *
+	 *  This function is used for adding one triangle of mesh
+	 *  vertex indexes to a list, skipping the degenerate ones
+	 *  strips use to join their rows, and reversing it when
+	 *  the model matrix mirrors the mesh.
+	 ***********************************************************/
+	void AppendTriangle(
+		std::vector<GLuint>& triangles,
+		GLuint a, GLuint b, GLuint c,
+		bool bMirrored)
+	{
+		if ((a == b) || (b == c) || (a == c))
+		{
+			return;
+		}
+
+		triangles.push_back(a);
+		triangles.push_back(bMirrored ? c : b);
+		triangles.push_back(bMirrored ? b : c);
+	}
+}
+
+/***********************************************************
+ *  StaticGeometry()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+StaticGeometry::StaticGeometry()
+{
+	m_vao = 0;
+	m_pBufferAllocator = NULL;
+	for (int i = 0; i < 3; i++)
+	{
+		m_allocations[i] = -1;
+		m_buffers[i] = 0;
+	}
+	m_lightmapWidth = 0;
+	m_lightmapHeight = 0;
+}
+
+/***********************************************************
+ *  ~StaticGeometry()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+StaticGeometry::~StaticGeometry()
+{
+	Clear();
+}
+
+/***********************************************************
+ *  Clear()
+ *
+ *  This method is used for dropping the baked groups and
+ *  freeing the merged buffers.
+ ***********************************************************/
+void StaticGeometry::Clear()
+{
+	if (0 != m_vao)
+	{
+		ShapeMeshes::BindVertexArray(0);
+		glDeleteVertexArrays(1, &m_vao);
+		m_vao = 0;
+	}
+	ReleaseBuffers();
+
+	m_vertices.clear();
+	m_indices.clear();
+	m_lightmapUVs.clear();
+	m_lightmapWidth = 0;
+	m_lightmapHeight = 0;
+	m_groups.clear();
+}
+
+/***********************************************************
+ *  CanBake()
+ *
+ *  This method is used for checking that a range draws
+ *  triangles, as lists, strips or fans, which is all the
+ *  bake knows how to merge.
+ ***********************************************************/
+bool StaticGeometry::CanBake(const ShapeMeshes::DRAW_RANGE& drawRange)
+{
+	return((drawRange.mode == GL_TRIANGLES) ||
+		(drawRange.mode == GL_TRIANGLE_STRIP) ||
+		(drawRange.mode == GL_TRIANGLE_FAN));
+}
+
+/***********************************************************
+ *  MakeKey()
+ *
+ *  This method is used for hashing everything a bake reads:
+ *  the range, transform and state of every draw, the sizes of
+ *  the mesh arenas, which change with the tessellation and
+ *  vertex layout of the meshes, and whether the bake charts
+ *  the lightmap coordinates.
+ ***********************************************************/
+uint64_t StaticGeometry::MakeKey(
+	const std::vector<STATIC_DRAW>& draws,
+	const ShapeMeshes& meshes,
+	bool bLightmapUVs)
+{
+	uint64_t hash = 14695981039346656037ull;
+	uint64_t arenaSizes[4] = { meshes.GetArenaVertices(false).size(),
+		meshes.GetArenaVertices(true).size(), meshes.GetArenaIndices().size(),
+		(bLightmapUVs == true) ? 1u : 0u };
+	hash = HashBytes(hash, arenaSizes, sizeof(arenaSizes));
+
+	// field by field, so padding bytes stay out of the hash
+	for (size_t i = 0; i < draws.size(); i++)
+	{
+		const STATIC_DRAW& draw = draws[i];
+		GLint range[6] = { (GLint)draw.range.mode, draw.range.first, draw.range.count,
+			draw.range.baseVertex, (draw.range.bIndexed == true) ? 1 : 0,
+			(meshes.IsCompactVAO(draw.range.vao) == true) ? 1 : 0 };
+		int state[2] = { draw.textureSlot, draw.materialID };
+		hash = HashBytes(hash, range, sizeof(range));
+		hash = HashBytes(hash, &draw.model[0][0], sizeof(float) * 16);
+		hash = HashBytes(hash, &draw.color[0], sizeof(float) * 4);
+		hash = HashBytes(hash, &draw.UVscale[0], sizeof(float) * 2);
+		hash = HashBytes(hash, state, sizeof(state));
+	}
+
+	return(hash);
+}
+
+/***********************************************************
+ *  Bake()
+ *
+ *  This method is used for merging the draws into one
+ *  triangle list per texture, material and color. Every
+ *  draw copies the span of mesh vertices it uses with the
+ *  positions moved to world space and the UVs scaled, and
+ *  its strips and fans are unrolled into triangles. The
+ *  normals are turned by the normal matrix of the draw, as the
+ *  vertex shader does for a draw that is not baked. With
+ *  bLightmapUVs the merged triangles are then charted into
+ *  the lightmap atlas, which copies the vertices on the seams
+ *  of the charts.
+ ***********************************************************/
+void StaticGeometry::Bake(
+	const std::vector<STATIC_DRAW>& draws,
+	const ShapeMeshes& meshes,
+	bool bLightmapUVs)
+{
+	Clear();
+
+	const std::vector<GLuint>& arenaIndices = meshes.GetArenaIndices();
+
+	std::vector<std::vector<GLuint>> groupIndices;
+	std::vector<GLuint> meshVertices;
+	std::vector<GLuint> triangles;
+
+	for (size_t i = 0; i < draws.size(); i++)
+	{
+		const STATIC_DRAW& draw = draws[i];
+		const ShapeMeshes::DRAW_RANGE& range = draw.range;
+		if ((CanBake(range) == false) || (range.count < 3))
+		{
+			continue;
+		}
+
+		// the arena vertex behind each element of the range, in
+		// the arena of the layout the range draws with
+		const std::vector<GLfloat>& arenaVertices = meshes.GetArenaVertices(meshes.IsCompactVAO(range.vao));
+		meshVertices.resize(range.count);
+		GLuint firstVertex = UINT32_MAX;
+		GLuint lastVertex = 0;
+		for (GLsizei element = 0; element < range.count; element++)
+		{
+			GLuint vertex = (range.bIndexed == true) ?
+				arenaIndices[range.first + element] + range.baseVertex :
+				(GLuint)(range.first + element);
+			meshVertices[element] = vertex;
+			firstVertex = glm::min(firstVertex, vertex);
+			lastVertex = glm::max(lastVertex, vertex);
+		}
+
+		bool bMirrored = (glm::determinant(glm::mat3(draw.model)) < 0.0f);
+		glm::mat3 normalMatrix = ComputeNormalMatrix(draw.model);
+		triangles.clear();
+		for (GLsizei element = 2; element < range.count; element++)
+		{
+			if (range.mode == GL_TRIANGLES)
+			{
+				if ((element % 3) == 2)
+				{
+					AppendTriangle(triangles, meshVertices[element - 2], meshVertices[element - 1],
+						meshVertices[element], bMirrored);
+				}
+			}
+			else if (range.mode == GL_TRIANGLE_STRIP)
+			{
+				// every other strip triangle has the opposite winding
+				bool bOdd = ((element % 2) == 1);
+				AppendTriangle(triangles, meshVertices[element - 2], meshVertices[element - 1],
+					meshVertices[element], bMirrored != bOdd);
+			}
+			else
+			{
+				AppendTriangle(triangles, meshVertices[0], meshVertices[element - 1],
+					meshVertices[element], bMirrored);
+			}
+		}
+
+		// find or open the group of the draw state
+		size_t groupIndex = 0;
+		while ((groupIndex < m_groups.size()) &&
+			((m_groups[groupIndex].textureSlot != draw.textureSlot) ||
+			(m_groups[groupIndex].materialID != draw.materialID) ||
+			(m_groups[groupIndex].color != draw.color)))
+		{
+			groupIndex++;
+		}
+		if (groupIndex == m_groups.size())
+		{
+			BAKED_GROUP group;
+			group.firstIndex = 0;
+			group.indexCount = 0;
+			group.textureSlot = draw.textureSlot;
+			group.materialID = draw.materialID;
+			group.color = draw.color;
+			group.bounds.minXYZ = glm::vec3(FLT_MAX);
+			group.bounds.maxXYZ = glm::vec3(-FLT_MAX);
+			m_groups.push_back(group);
+			groupIndices.push_back(std::vector<GLuint>());
+		}
+		BAKED_GROUP& group = m_groups[groupIndex];
+
+		// copy the span of vertices the draw uses into world space
+		GLuint baseVertex = (GLuint)(m_vertices.size() / VERTEX_FLOATS);
+		for (GLuint vertex = firstVertex; vertex <= lastVertex; vertex++)
+		{
+			const GLfloat* pVertex = &arenaVertices[(size_t)vertex * VERTEX_FLOATS];
+			glm::vec3 position = glm::vec3(draw.model * glm::vec4(pVertex[0], pVertex[1], pVertex[2], 1.0f));
+			group.bounds.minXYZ = glm::min(group.bounds.minXYZ, position);
+			group.bounds.maxXYZ = glm::max(group.bounds.maxXYZ, position);
+			glm::vec3 normal = normalMatrix * glm::vec3(pVertex[3], pVertex[4], pVertex[5]);
+			if (glm::dot(normal, normal) > 0.0f)
+			{
+				normal = glm::normalize(normal);
+			}
+
+			m_vertices.push_back(position.x);
+			m_vertices.push_back(position.y);
+			m_vertices.push_back(position.z);
+			m_vertices.push_back(normal.x);
+			m_vertices.push_back(normal.y);
+			m_vertices.push_back(normal.z);
+			m_vertices.push_back(pVertex[6] * draw.UVscale.x);
+			m_vertices.push_back(pVertex[7] * draw.UVscale.y);
+		}
+
+		std::vector<GLuint>& indices = groupIndices[groupIndex];
+		for (size_t t = 0; t < triangles.size(); t++)
+		{
+			indices.push_back(baseVertex + triangles[t] - firstVertex);
+		}
+	}
+
+	// lay the groups out one after the other in the index buffer
+	for (size_t groupIndex = 0; groupIndex < m_groups.size(); groupIndex++)
+	{
+		BAKED_GROUP& group = m_groups[groupIndex];
+		group.firstIndex = (GLint)m_indices.size();
+		group.indexCount = (GLsizei)groupIndices[groupIndex].size();
+		m_indices.insert(m_indices.end(), groupIndices[groupIndex].begin(), groupIndices[groupIndex].end());
+	}
+
+	// the charts keep the triangle order, so the group ranges hold
+	if (bLightmapUVs == true)
+	{
+		LightmapBaker::GenerateUVs(m_vertices, m_indices, m_lightmapUVs,
+			LightmapBaker::MAX_ATLAS_SIZE, m_lightmapWidth, m_lightmapHeight);
+	}
+
+	for (size_t groupIndex = 0; groupIndex < m_groups.size(); groupIndex++)
+	{
+		BAKED_GROUP& group = m_groups[groupIndex];
+
+		// sphere around the box center holding every vertex
+		group.bounds.center = (group.bounds.minXYZ + group.bounds.maxXYZ) * 0.5f;
+		group.bounds.radius = 0.0f;
+		for (GLsizei index = 0; index < group.indexCount; index++)
+		{
+			const GLfloat* pVertex = &m_vertices[(size_t)m_indices[group.firstIndex + index] * VERTEX_FLOATS];
+			group.bounds.radius = glm::max(group.bounds.radius,
+				glm::length(glm::vec3(pVertex[0], pVertex[1], pVertex[2]) - group.bounds.center));
+		}
+	}
+
+	Upload();
+}
+
+/***********************************************************
+ *  SaveCache()
+ *
+ *  This method is used for writing the merged buffers and
+ *  groups with the key of the draws they were baked from.
+ ***********************************************************/
+bool StaticGeometry::SaveCache(const char* filename, uint64_t key) const
+{
+	FILE* pFile = fopen(filename, "wb");
+	if (NULL == pFile)
+	{
+		std::cout << "Could not create static geometry cache " << filename << std::endl;
+		return(false);
+	}
+
+	CACHE_HEADER header;
+	memset(&header, 0, sizeof(header));
+	header.magic = CACHE_MAGIC;
+	header.version = CACHE_VERSION;
+	header.key = key;
+	header.vertexFloatCount = (uint32_t)m_vertices.size();
+	header.indexCount = (uint32_t)m_indices.size();
+	header.groupCount = (uint32_t)m_groups.size();
+	header.lightmapUVFloatCount = (uint32_t)m_lightmapUVs.size();
+	header.lightmapWidth = m_lightmapWidth;
+	header.lightmapHeight = m_lightmapHeight;
+
+	std::vector<CACHE_GROUP> groups(m_groups.size());
+	for (size_t i = 0; i < m_groups.size(); i++)
+	{
+		const BAKED_GROUP& group = m_groups[i];
+		groups[i].firstIndex = group.firstIndex;
+		groups[i].indexCount = group.indexCount;
+		groups[i].textureSlot = group.textureSlot;
+		groups[i].materialID = group.materialID;
+		memcpy(groups[i].color, &group.color[0], sizeof(groups[i].color));
+		memcpy(groups[i].minXYZ, &group.bounds.minXYZ[0], sizeof(groups[i].minXYZ));
+		memcpy(groups[i].maxXYZ, &group.bounds.maxXYZ[0], sizeof(groups[i].maxXYZ));
+		memcpy(groups[i].center, &group.bounds.center[0], sizeof(groups[i].center));
+		groups[i].radius = group.bounds.radius;
+	}
+
+	bool bWritten = (fwrite(&header, sizeof(header), 1, pFile) == 1);
+	bWritten = bWritten && (groups.empty() ||
+		(fwrite(&groups[0], sizeof(CACHE_GROUP), groups.size(), pFile) == groups.size()));
+	bWritten = bWritten && (m_vertices.empty() ||
+		(fwrite(&m_vertices[0], sizeof(GLfloat), m_vertices.size(), pFile) == m_vertices.size()));
+	bWritten = bWritten && (m_indices.empty() ||
+		(fwrite(&m_indices[0], sizeof(GLuint), m_indices.size(), pFile) == m_indices.size()));
+	bWritten = bWritten && (m_lightmapUVs.empty() ||
+		(fwrite(&m_lightmapUVs[0], sizeof(GLfloat), m_lightmapUVs.size(), pFile) == m_lightmapUVs.size()));
+	bWritten = (fclose(pFile) == 0) && bWritten;
+
+	if (bWritten == false)
+	{
+		std::cout << "Could not write static geometry cache " << filename << std::endl;
+	}
+	else
+	{
+		AssetPack::NoteArtifact(filename, true);
+	}
+	return(bWritten);
+}
+
+/***********************************************************
+ *  LoadCache()
+ *
+ *  This method is used for restoring a bake saved by
+ *  SaveCache(). Files of another key, from draws or meshes
+ *  that changed since, are rejected so they get baked again.
+ ***********************************************************/
+bool StaticGeometry::LoadCache(const char* filename, uint64_t key)
+{
+	// from the warm-start snapshot, or else the file
+	AssetPack::ASSET_VIEW view;
+	if (AssetPack::ReadArtifact(filename, view) == false)
+	{
+		return(false);
+	}
+
+	size_t offset = 0;
+	CACHE_HEADER header;
+	bool bRead = AssetPack::ReadView(view, offset, &header, sizeof(header)) &&
+		(header.magic == CACHE_MAGIC) && (header.version == CACHE_VERSION) &&
+		(header.key == key) && ((header.vertexFloatCount % VERTEX_FLOATS) == 0) &&
+		((header.lightmapUVFloatCount == 0) ||
+		(((header.lightmapUVFloatCount / LIGHTMAP_UV_FLOATS) == (header.vertexFloatCount / VERTEX_FLOATS)) &&
+		(header.lightmapWidth > 0) && (header.lightmapWidth <= LightmapBaker::MAX_ATLAS_SIZE) &&
+		(header.lightmapHeight > 0) && (header.lightmapHeight <= LightmapBaker::MAX_ATLAS_SIZE)));
+
+	std::vector<CACHE_GROUP> groups;
+	if (bRead == true)
+	{
+		Clear();
+		groups.resize(header.groupCount);
+		m_vertices.resize(header.vertexFloatCount);
+		m_indices.resize(header.indexCount);
+		m_lightmapUVs.resize(header.lightmapUVFloatCount);
+		m_lightmapWidth = header.lightmapWidth;
+		m_lightmapHeight = header.lightmapHeight;
+		bRead = (groups.empty() ||
+			AssetPack::ReadView(view, offset, &groups[0], groups.size() * sizeof(CACHE_GROUP))) &&
+			(m_vertices.empty() ||
+			AssetPack::ReadView(view, offset, &m_vertices[0], m_vertices.size() * sizeof(GLfloat))) &&
+			(m_indices.empty() ||
+			AssetPack::ReadView(view, offset, &m_indices[0], m_indices.size() * sizeof(GLuint))) &&
+			(m_lightmapUVs.empty() ||
+			AssetPack::ReadView(view, offset, &m_lightmapUVs[0], m_lightmapUVs.size() * sizeof(GLfloat)));
+	}
+
+	// every group and index has to stay inside the buffers
+	GLuint vertexCount = header.vertexFloatCount / VERTEX_FLOATS;
+	for (size_t i = 0; (i < m_indices.size()) && (bRead == true); i++)
+	{
+		bRead = (m_indices[i] < vertexCount);
+	}
+	for (size_t i = 0; (i < groups.size()) && (bRead == true); i++)
+	{
+		bRead = (groups[i].firstIndex >= 0) && (groups[i].indexCount >= 0) &&
+			((size_t)groups[i].firstIndex + (size_t)groups[i].indexCount <= m_indices.size());
+	}
+
+	if (bRead == false)
+	{
+		Clear();
+		return(false);
+	}
+
+	m_groups.resize(groups.size());
+	for (size_t i = 0; i < groups.size(); i++)
+	{
+		BAKED_GROUP& group = m_groups[i];
+		group.firstIndex = groups[i].firstIndex;
+		group.indexCount = groups[i].indexCount;
+		group.textureSlot = groups[i].textureSlot;
+		group.materialID = groups[i].materialID;
+		memcpy(&group.color[0], groups[i].color, sizeof(groups[i].color));
+		memcpy(&group.bounds.minXYZ[0], groups[i].minXYZ, sizeof(groups[i].minXYZ));
+		memcpy(&group.bounds.maxXYZ[0], groups[i].maxXYZ, sizeof(groups[i].maxXYZ));
+		memcpy(&group.bounds.center[0], groups[i].center, sizeof(groups[i].center));
+		group.bounds.radius = groups[i].radius;
+	}
+
+	Upload();
+	AssetPack::NoteArtifact(filename, false);
+	return(true);
+}
+
+/***********************************************************
+ *  GetGroupRange()
+ *
+ *  This method is used for getting the draw range of a
+ *  group, an indexed triangle list of the merged buffers
+ *  with a single LOD level.
+ ***********************************************************/
+ShapeMeshes::DRAW_RANGE StaticGeometry::GetGroupRange(size_t groupIndex) const
+{
+	const BAKED_GROUP& group = m_groups[groupIndex];
+
+	GLint indexBase = GetIndexBase();
+
+	ShapeMeshes::DRAW_RANGE drawRange;
+	drawRange.vao = m_vao;
+	drawRange.mode = GL_TRIANGLES;
+	drawRange.first = indexBase + group.firstIndex;
+	drawRange.count = group.indexCount;
+	drawRange.baseVertex = 0;
+	drawRange.bIndexed = true;
+	drawRange.indexType = GL_UNSIGNED_INT;
+	drawRange.bounds = group.bounds;
+	drawRange.lodLevels = 1;
+	for (int lod = 0; lod < ShapeMeshes::MESH_LOD_COUNT; lod++)
+	{
+		drawRange.lods[lod].first = indexBase + group.firstIndex;
+		drawRange.lods[lod].count = group.indexCount;
+		drawRange.lods[lod].baseVertex = 0;
+		drawRange.lods[lod].error = 0.0f;
+	}
+	// the merged buffers are not split into meshlets
+	drawRange.firstMeshlet = 0;
+	drawRange.meshletCount = 0;
+	// a group merges open and closed draws alike, so it keeps its
+	// back faces
+	drawRange.bClosed = false;
+
+	return(drawRange);
+}
+
+/***********************************************************
+ *  GetIndexBase()
+ *
+ *  This method is used for getting the index the merged
+ *  indices start at in their buffer, past the start of a
+ *  shared page when they are an allocation of one.
+ ***********************************************************/
+GLint StaticGeometry::GetIndexBase() const
+{
+	return((GLint)(GetBufferRange(1).offset / (GLintptr)sizeof(GLuint)));
+}
+
+/***********************************************************
+ *  Upload()
+ *
+ *  This method is used for sending the merged buffers to
+ *  GL in immutable storage behind a VAO with the attribute
+ *  layout of the mesh arena, so the scene shaders draw them
+ *  unchanged. The lightmap coordinates, when there are any,
+ *  come from a third buffer.
+ ***********************************************************/
+void StaticGeometry::Upload()
+{
+	if (m_indices.empty() == true)
+	{
+		return;
+	}
+
+	if (0 == m_vao)
+	{
+		m_vao = ShapeMeshes::CreateVertexArray(false, "static geometry");
+	}
+	ReleaseBuffers();
+
+	const GLsizeiptr sizes[3] =
+	{
+		(GLsizeiptr)(m_vertices.size() * sizeof(GLfloat)),
+		(GLsizeiptr)(m_indices.size() * sizeof(GLuint)),
+		(GLsizeiptr)(m_lightmapUVs.size() * sizeof(GLfloat))
+	};
+	const void* data[3] = { m_vertices.data(), m_indices.data(), m_lightmapUVs.data() };
+	const char* labels[3] =
+	{
+		"static geometry vertices",
+		"static geometry indices",
+		"static geometry lightmap coordinates"
+	};
+
+	if (NULL != m_pBufferAllocator)
+	{
+		// vertices start on a whole vertex, the indices on a whole
+		// index, which the draw ranges count in
+		const GLsizeiptr alignments[3] =
+		{
+			VERTEX_FLOATS * sizeof(GLfloat),
+			sizeof(GLuint),
+			LIGHTMAP_UV_FLOATS * sizeof(GLfloat)
+		};
+		for (int i = 0; i < 3; i++)
+		{
+			m_allocations[i] = m_pBufferAllocator->Allocate(sizes[i], alignments[i], data[i], (i != 1),
+				RelocateBuffers, this);
+		}
+	}
+	else
+	{
+		for (int i = 0; i < 3; i++)
+		{
+			if (sizes[i] > 0)
+			{
+				m_buffers[i] = ShapeMeshes::CreateStaticBuffer(sizes[i], data[i], labels[i]);
+			}
+		}
+	}
+
+	AttachBuffers();
+}
+
+/***********************************************************
+ *  SetBufferAllocator()
+ *
+ *  This method is used for setting the allocator the merged
+ *  buffers are placed in. A bake already sent is sent again
+ *  to the new storage.
+ ***********************************************************/
+void StaticGeometry::SetBufferAllocator(BufferAllocator* pAllocator)
+{
+	if (pAllocator == m_pBufferAllocator)
+	{
+		return;
+	}
+
+	ReleaseBuffers();
+	m_pBufferAllocator = pAllocator;
+	if ((0 != m_vao) && (m_indices.empty() == false))
+	{
+		Upload();
+	}
+}
+
+/***********************************************************
+ *  ReleaseBuffers()
+ *
+ *  This method is used for freeing the merged buffers, the
+ *  allocations or the buffers of their own.
+ ***********************************************************/
+void StaticGeometry::ReleaseBuffers()
+{
+	for (int i = 0; i < 3; i++)
+	{
+		if ((m_allocations[i] >= 0) && (NULL != m_pBufferAllocator))
+		{
+			m_pBufferAllocator->Free(m_allocations[i]);
+		}
+		m_allocations[i] = -1;
+		if (0 != m_buffers[i])
+		{
+			GPUMemory::DeleteBuffers(1, &m_buffers[i]);
+			m_buffers[i] = 0;
+		}
+	}
+}
+
+/***********************************************************
+ *  GetBufferRange()
+ *
+ *  This method is used for getting where one of the merged
+ *  buffers is now, the range of its allocation or the
+ *  start of its own buffer.
+ ***********************************************************/
+BufferAllocator::RANGE StaticGeometry::GetBufferRange(int buffer) const
+{
+	if ((m_allocations[buffer] >= 0) && (NULL != m_pBufferAllocator))
+	{
+		return(m_pBufferAllocator->GetRange(m_allocations[buffer]));
+	}
+
+	BufferAllocator::RANGE range;
+	range.buffer = m_buffers[buffer];
+	range.offset = 0;
+	range.size = 0;
+	return(range);
+}
+
+/***********************************************************
+ *  AttachBuffers()
+ *
+ *  This method is used for pointing the VAO at the merged
+ *  vertices and indices, and the lightmap coordinates when
+ *  there are any.
+ ***********************************************************/
+void StaticGeometry::AttachBuffers()
+{
+	BufferAllocator::RANGE vertices = GetBufferRange(0);
+	ShapeMeshes::AttachMeshBuffers(m_vao, vertices.buffer, GetBufferRange(1).buffer, false, vertices.offset);
+	if (m_lightmapUVs.empty() == false)
+	{
+		AttachLightmapUVs();
+	}
+}
+
+/***********************************************************
+ *  RelocateBuffers()
+ *
+ *  This method is used for pointing the VAO at the vertices
+ *  or lightmap coordinates the allocator moved.
+ ***********************************************************/
+void StaticGeometry::RelocateBuffers(void* pContext, int allocation)
+{
+	StaticGeometry* pGeometry = static_cast<StaticGeometry*>(pContext);
+	if (0 != pGeometry->m_vao)
+	{
+		pGeometry->AttachBuffers();
+	}
+}
+
+/***********************************************************
+ *  AttachLightmapUVs()
+ *
+ *  This method is used for feeding attribute 3 of the VAO
+ *  from the lightmap coordinate buffer, through a binding
+ *  of its own next to the one of the arena layout. The
+ *  VAOs of the other meshes leave the attribute disabled,
+ *  so the shaders read its default of 0 as the weight.
+ ***********************************************************/
+void StaticGeometry::AttachLightmapUVs()
+{
+	const GLsizei stride = LIGHTMAP_UV_FLOATS * sizeof(GLfloat);
+	BufferAllocator::RANGE lightmapUVs = GetBufferRange(2);
+	if (ShapeMeshes::HasDirectStateAccess() == true)
+	{
+		glVertexArrayAttribFormat(m_vao, LIGHTMAP_UV_ATTRIBUTE, LIGHTMAP_UV_FLOATS, GL_FLOAT, GL_FALSE, 0);
+		glVertexArrayAttribBinding(m_vao, LIGHTMAP_UV_ATTRIBUTE, LIGHTMAP_UV_BINDING);
+		glEnableVertexArrayAttrib(m_vao, LIGHTMAP_UV_ATTRIBUTE);
+		glVertexArrayVertexBuffer(m_vao, LIGHTMAP_UV_BINDING, lightmapUVs.buffer, lightmapUVs.offset, stride);
+		return;
+	}
+
+	ShapeMeshes::BindVertexArray(m_vao);
+	if (ShapeMeshes::HasVertexAttribBinding() == true)
+	{
+		glVertexAttribFormat(LIGHTMAP_UV_ATTRIBUTE, LIGHTMAP_UV_FLOATS, GL_FLOAT, GL_FALSE, 0);
+		glVertexAttribBinding(LIGHTMAP_UV_ATTRIBUTE, LIGHTMAP_UV_BINDING);
+		glBindVertexBuffer(LIGHTMAP_UV_BINDING, lightmapUVs.buffer, lightmapUVs.offset, stride);
+	}
+	else
+	{
+		glBindBuffer(GL_ARRAY_BUFFER, lightmapUVs.buffer);
+		glVertexAttribPointer(LIGHTMAP_UV_ATTRIBUTE, LIGHTMAP_UV_FLOATS, GL_FLOAT, GL_FALSE, stride,
+			(void*)lightmapUVs.offset);
+	}
+	glEnableVertexAttribArray(LIGHTMAP_UV_ATTRIBUTE);
+}
@@ -0,0 +1,136 @@
+///////////////////////////////////////////////////////////////////////////////
+// staticgeometry.h
+// ============
+// static draws baked into merged world space buffers
+//
+//  Pre-transforms the draws of objects that never move into one
+//  vertex and index buffer, with one triangle list per shader
+//  state, so the static environment renders in a handful of
+//  draws. With lightmaps the merged triangles also get a second UV
+//  set into the lightmap atlas of LightmapBaker. The baked buffers
+//  can be cached next to the scene file.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "ShapeMeshes.h"
+
+#include <cstdint>
+#include <vector>
+
+/***********************************************************
+ *  StaticGeometry
+ *
+ *  This class contains the merged vertex and index buffers
+ *  of the baked static draws and the groups drawing them.
+ *  A group is one indexed triangle list sharing a texture,
+ *  material and color, drawn with an identity model matrix
+ *  and a UV scale of one, which the bake applied already.
+ ***********************************************************/
+class StaticGeometry
+{
+public:
+	// constructor
+	StaticGeometry();
+	// destructor
+	~StaticGeometry();
+
+	// one recorded draw to bake, with the state it is grouped by
+	struct STATIC_DRAW
+	{
+		ShapeMeshes::DRAW_RANGE range;
+		glm::mat4 model;
+		glm::vec4 color;
+		glm::vec2 UVscale;
+		int textureSlot;
+		int materialID;
+	};
+
+	// one merged triangle list of the baked buffers
+	struct BAKED_GROUP
+	{
+		GLint firstIndex;
+		GLsizei indexCount;
+		int textureSlot;
+		int materialID;
+		glm::vec4 color;
+		ShapeMeshes::BOUNDS bounds;		// world space
+	};
+
+	// true for the primitive types the bake turns into triangles
+	static bool CanBake(const ShapeMeshes::DRAW_RANGE& drawRange);
+	// key of a set of draws over the mesh arenas, which changes
+	// whenever a cached bake of them would be stale
+	static uint64_t MakeKey(
+		const std::vector<STATIC_DRAW>& draws,
+		const ShapeMeshes& meshes,
+		bool bLightmapUVs);
+
+	// pre-transform the draws, whose ranges index the mesh arenas,
+	// into the merged buffers, with lightmap coordinates when
+	// bLightmapUVs is set
+	void Bake(
+		const std::vector<STATIC_DRAW>& draws,
+		const ShapeMeshes& meshes,
+		bool bLightmapUVs);
+	// restore the buffers of an earlier bake saved with the same key
+	bool LoadCache(const char* filename, uint64_t key);
+	bool SaveCache(const char* filename, uint64_t key) const;
+	// drop the groups and free the buffers
+	void Clear();
+	// place the merged buffers in ranges of the pages of an allocator
+	// from the next bake on, NULL for buffers of their own; set before
+	// the draws of the groups are recorded, which hold the offset of
+	// the indices
+	void SetBufferAllocator(BufferAllocator* pAllocator);
+
+	size_t GetGroupCount() const { return(m_groups.size()); }
+	const BAKED_GROUP& GetGroup(size_t groupIndex) const { return(m_groups[groupIndex]); }
+	// range drawing a group from the merged buffers
+	ShapeMeshes::DRAW_RANGE GetGroupRange(size_t groupIndex) const;
+	// the VAO of the groups, and the index their ranges count from
+	// on top of the first index of the group
+	GLuint GetVertexArray() const { return(m_vao); }
+	GLint GetIndexBase() const;
+
+	// the merged buffers in world space, which the lightmap bake
+	// reads; the lightmap coordinates are empty without lightmaps
+	const std::vector<GLfloat>& GetVertices() const { return(m_vertices); }
+	const std::vector<GLuint>& GetIndices() const { return(m_indices); }
+	const std::vector<GLfloat>& GetLightmapUVs() const { return(m_lightmapUVs); }
+	bool HasLightmapUVs() const { return(m_lightmapUVs.empty() == false); }
+	int GetLightmapWidth() const { return(m_lightmapWidth); }
+	int GetLightmapHeight() const { return(m_lightmapHeight); }
+
+private:
+	// CPU copies of the merged buffers, kept for SaveCache()
+	std::vector<GLfloat> m_vertices;
+	std::vector<GLuint> m_indices;
+	// LightmapBaker::LIGHTMAP_UV_FLOATS per vertex, and the size of
+	// the atlas they were packed into
+	std::vector<GLfloat> m_lightmapUVs;
+	int m_lightmapWidth;
+	int m_lightmapHeight;
+	std::vector<BAKED_GROUP> m_groups;
+	GLuint m_vao;
+	// the vertices, indices and lightmap coordinates: allocations of
+	// the pages of the allocator when one is set, the indices pinned
+	// and the others movable, otherwise whole buffers of their own
+	BufferAllocator* m_pBufferAllocator;
+	int m_allocations[3];
+	GLuint m_buffers[3];
+
+	// send the merged buffers to GL with the arena vertex layout
+	void Upload();
+	void ReleaseBuffers();
+	// where one of the merged buffers is now
+	BufferAllocator::RANGE GetBufferRange(int buffer) const;
+	// point the VAO at the vertices, indices and lightmap
+	// coordinates where they are now
+	void AttachBuffers();
+	// feed the lightmap coordinates to attribute 3 of the VAO from
+	// a binding of their own
+	void AttachLightmapUVs();
+	// re-attach the buffers once the allocator moved one of them
+	static void RelocateBuffers(void* pContext, int allocation);
+};
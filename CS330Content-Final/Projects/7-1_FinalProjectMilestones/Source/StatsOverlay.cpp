@@ -0,0 +1,255 @@
+///////////////////////////////////////////////////////////////////////////////
+// statsoverlay.cpp
+// ============
+// lines of text drawn over the frame, for the frame statistics
+//
+//  A small built-in 5x7 pixel font is kept in a texture, and each
+//  character of the text is one instance of a quad, so the whole
+//  overlay is a single draw with no font file to load.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "StatsOverlay.h"
+#include "ShapeMeshes.h"
+#include "GPUMemory.h"
+
+#include <cctype>
+#include <iostream>
+
+namespace
+{
+	// a glyph of the font, one byte per row from the top, the
+	// leftmost pixel in bit 4
+	struct FONT_GLYPH
+	{
+		char character;
+		unsigned char rows[7];
+	};
+
+	const FONT_GLYPH FONT_GLYPHS[] =
+	{
+		{ ' ', { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 } },
+		{ '0', { 0x0E, 0x11, 0x13, 0x15, 0x19, 0x11, 0x0E } },
+		{ '1', { 0x04, 0x0C, 0x04, 0x04, 0x04, 0x04, 0x0E } },
+		{ '2', { 0x0E, 0x11, 0x01, 0x02, 0x04, 0x08, 0x1F } },
+		{ '3', { 0x1F, 0x02, 0x04, 0x02, 0x01, 0x11, 0x0E } },
+		{ '4', { 0x02, 0x06, 0x0A, 0x12, 0x1F, 0x02, 0x02 } },
+		{ '5', { 0x1F, 0x10, 0x1E, 0x01, 0x01, 0x11, 0x0E } },
+		{ '6', { 0x06, 0x08, 0x10, 0x1E, 0x11, 0x11, 0x0E } },
+		{ '7', { 0x1F, 0x01, 0x02, 0x04, 0x08, 0x08, 0x08 } },
+		{ '8', { 0x0E, 0x11, 0x11, 0x0E, 0x11, 0x11, 0x0E } },
+		{ '9', { 0x0E, 0x11, 0x11, 0x0F, 0x01, 0x02, 0x0C } },
+		{ 'A', { 0x0E, 0x11, 0x11, 0x1F, 0x11, 0x11, 0x11 } },
+		{ 'B', { 0x1E, 0x11, 0x11, 0x1E, 0x11, 0x11, 0x1E } },
+		{ 'C', { 0x0E, 0x11, 0x10, 0x10, 0x10, 0x11, 0x0E } },
+		{ 'D', { 0x1C, 0x12, 0x11, 0x11, 0x11, 0x12, 0x1C } },
+		{ 'E', { 0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x1F } },
+		{ 'F', { 0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x10 } },
+		{ 'G', { 0x0E, 0x11, 0x10, 0x17, 0x11, 0x11, 0x0F } },
+		{ 'H', { 0x11, 0x11, 0x11, 0x1F, 0x11, 0x11, 0x11 } },
+		{ 'I', { 0x0E, 0x04, 0x04, 0x04, 0x04, 0x04, 0x0E } },
+		{ 'J', { 0x07, 0x02, 0x02, 0x02, 0x02, 0x12, 0x0C } },
+		{ 'K', { 0x11, 0x12, 0x14, 0x18, 0x14, 0x12, 0x11 } },
+		{ 'L', { 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x1F } },
+		{ 'M', { 0x11, 0x1B, 0x15, 0x15, 0x11, 0x11, 0x11 } },
+		{ 'N', { 0x11, 0x11, 0x19, 0x15, 0x13, 0x11, 0x11 } },
+		{ 'O', { 0x0E, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E } },
+		{ 'P', { 0x1E, 0x11, 0x11, 0x1E, 0x10, 0x10, 0x10 } },
+		{ 'Q', { 0x0E, 0x11, 0x11, 0x11, 0x15, 0x12, 0x0D } },
+		{ 'R', { 0x1E, 0x11, 0x11, 0x1E, 0x14, 0x12, 0x11 } },
+		{ 'S', { 0x0F, 0x10, 0x10, 0x0E, 0x01, 0x01, 0x1E } },
+		{ 'T', { 0x1F, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04 } },
+		{ 'U', { 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E } },
+		{ 'V', { 0x11, 0x11, 0x11, 0x11, 0x11, 0x0A, 0x04 } },
+		{ 'W', { 0x11, 0x11, 0x11, 0x15, 0x15, 0x15, 0x0A } },
+		{ 'X', { 0x11, 0x11, 0x0A, 0x04, 0x0A, 0x11, 0x11 } },
+		{ 'Y', { 0x11, 0x11, 0x0A, 0x04, 0x04, 0x04, 0x04 } },
+		{ 'Z', { 0x1F, 0x01, 0x02, 0x04, 0x08, 0x10, 0x1F } },
+		{ '.', { 0x00, 0x00, 0x00, 0x00, 0x00, 0x0C, 0x0C } },
+		{ ',', { 0x00, 0x00, 0x00, 0x00, 0x0C, 0x04, 0x08 } },
+		{ ':', { 0x00, 0x0C, 0x0C, 0x00, 0x0C, 0x0C, 0x00 } },
+		{ '%', { 0x18, 0x19, 0x02, 0x04, 0x08, 0x13, 0x03 } },
+		{ '/', { 0x00, 0x01, 0x02, 0x04, 0x08, 0x10, 0x00 } },
+		{ '-', { 0x00, 0x00, 0x00, 0x1F, 0x00, 0x00, 0x00 } },
+		{ '+', { 0x00, 0x04, 0x04, 0x1F, 0x04, 0x04, 0x00 } },
+		{ '=', { 0x00, 0x00, 0x1F, 0x00, 0x1F, 0x00, 0x00 } },
+		{ '(', { 0x02, 0x04, 0x08, 0x08, 0x08, 0x04, 0x02 } },
+		{ ')', { 0x08, 0x04, 0x02, 0x02, 0x02, 0x04, 0x08 } },
+		{ '_', { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x1F } },
+		{ '>', { 0x08, 0x04, 0x02, 0x01, 0x02, 0x04, 0x08 } },
+		{ '<', { 0x02, 0x04, 0x08, 0x10, 0x08, 0x04, 0x02 } },
+		{ '?', { 0x0E, 0x11, 0x01, 0x02, 0x04, 0x00, 0x04 } },
+	};
+	const int FONT_GLYPH_COUNT = (int)(sizeof(FONT_GLYPHS) / sizeof(FONT_GLYPHS[0]));
+
+	// window height drawn at one pixel per font pixel; taller
+	// windows scale the text up in whole steps
+	const int UNSCALED_WINDOW_HEIGHT = 540;
+	// gap between the overlay and the window edges, in font pixels
+	const int OVERLAY_MARGIN = 4;
+}
+
+/***********************************************************
+ *  StatsOverlay()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+StatsOverlay::StatsOverlay(ShaderManager* pShaderManager)
+{
+	m_pShaderManager = pShaderManager;
+	m_program = 0;
+	m_viewportSizeLocation = -1;
+	m_glyphScaleLocation = -1;
+	m_vao = 0;
+	m_fontTexture = 0;
+	for (int i = 0; i < 128; i++)
+	{
+		m_glyphIndex[i] = -1;
+	}
+}
+
+/***********************************************************
+ *  ~StatsOverlay()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+StatsOverlay::~StatsOverlay()
+{
+	if (0 != m_vao)
+	{
+		glDeleteVertexArrays(1, &m_vao);
+		m_vao = 0;
+	}
+	m_glyphBuffer.Destroy();
+	if (0 != m_fontTexture)
+	{
+		GPUMemory::DeleteTextures(1, &m_fontTexture);
+		m_fontTexture = 0;
+	}
+	if (0 != m_program)
+	{
+		glDeleteProgram(m_program);
+		m_program = 0;
+	}
+	m_pShaderManager = NULL;
+}
+
+/***********************************************************
+ *  Create()
+ *
+ *  This method is used for building the program, unpacking
+ *  the font into a one channel texture with the glyphs side
+ *  by side, and setting up the vertex array reading the
+ *  characters as unsigned integer instance attributes.
+ ***********************************************************/
+bool StatsOverlay::Create(const char* vertexPath, const char* fragmentPath)
+{
+	if (NULL == m_pShaderManager)
+	{
+		return(false);
+	}
+
+	m_program = m_pShaderManager->LoadExternalProgram(vertexPath, fragmentPath);
+	if (0 == m_program)
+	{
+		std::cout << "Stats overlay disabled, its shader did not build" << std::endl;
+		return(false);
+	}
+	m_pShaderManager->UseExternalProgram(m_program);
+	glUniform1i(glGetUniformLocation(m_program, "fontTexture"), FONT_TEXTURE_UNIT);
+	m_viewportSizeLocation = glGetUniformLocation(m_program, "viewportSize");
+	m_glyphScaleLocation = glGetUniformLocation(m_program, "glyphScale");
+
+	const int fontWidth = FONT_GLYPH_COUNT * GLYPH_WIDTH;
+	std::vector<unsigned char> pixels((size_t)fontWidth * GLYPH_HEIGHT, 0);
+	for (int glyph = 0; glyph < FONT_GLYPH_COUNT; glyph++)
+	{
+		m_glyphIndex[(unsigned char)FONT_GLYPHS[glyph].character] = glyph;
+		for (int row = 0; row < 7; row++)
+		{
+			for (int column = 0; column < 5; column++)
+			{
+				if ((FONT_GLYPHS[glyph].rows[row] & (0x10 >> column)) != 0)
+				{
+					pixels[(size_t)row * fontWidth + glyph * GLYPH_WIDTH + column] = 255;
+				}
+			}
+		}
+	}
+
+	// the rows go top down, as the vertex shader reads them
+	glGenTextures(1, &m_fontTexture);
+	GLuint previousTexture = ShapeMeshes::BindTextureForEdit(GL_TEXTURE_2D, m_fontTexture);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, fontWidth, GLYPH_HEIGHT, 0, GL_RED, GL_UNSIGNED_BYTE, &pixels[0]);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	GPUMemory::TrackTexture(m_fontTexture, GL_R8, fontWidth, GLYPH_HEIGHT, 1, 1, GPUMemory::CATEGORY_TEXTURE, "overlay font");
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+	ShapeMeshes::RestoreTextureBinding(GL_TEXTURE_2D, previousTexture);
+
+	glGenVertexArrays(1, &m_vao);
+	m_glyphBuffer.Create(GPUBuffer::USAGE_STREAM, MAX_GLYPHS * 4 * sizeof(GLushort), NULL,
+		GPUMemory::CATEGORY_BUFFER, "overlay glyphs");
+	ShapeMeshes::BindVertexArray(m_vao);
+	glBindBuffer(GL_ARRAY_BUFFER, m_glyphBuffer.GetName());
+	glVertexAttribIPointer(0, 4, GL_UNSIGNED_SHORT, 4 * sizeof(GLushort), (void*)0);
+	glVertexAttribDivisor(0, 1);
+	glEnableVertexAttribArray(0);
+	ShapeMeshes::BindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	return(true);
+}
+
+/***********************************************************
+ *  Draw()
+ *
+ *  This method is used for writing the characters of the
+ *  lines into the glyph buffer, orphaning its last copy,
+ *  and drawing them in one instanced call with the depth
+ *  test off, blended over the frame.
+ ***********************************************************/
+void StatsOverlay::Draw(const std::vector<std::string>& lines, int width, int height)
+{
+	if ((IsAvailable() == false) || (width <= 0) || (height <= 0))
+	{
+		return;
+	}
+
+	const int scale = (height > UNSCALED_WINDOW_HEIGHT) ? height / UNSCALED_WINDOW_HEIGHT : 1;
+	m_glyphs.clear();
+	for (size_t line = 0; line < lines.size(); line++)
+	{
+		const std::string& text = lines[line];
+		for (size_t i = 0; (i < text.size()) && (m_glyphs.size() < (size_t)MAX_GLYPHS * 4); i++)
+		{
+			int character = toupper((unsigned char)text[i]);
+			int glyph = ((character >= 0) && (character < 128)) ? m_glyphIndex[character] : -1;
+			if (glyph < 0)
+			{
+				glyph = m_glyphIndex['?'];
+			}
+			m_glyphs.push_back((GLushort)((OVERLAY_MARGIN + (int)i * GLYPH_WIDTH) * scale));
+			m_glyphs.push_back((GLushort)((OVERLAY_MARGIN + (int)line * GLYPH_HEIGHT) * scale));
+			m_glyphs.push_back((GLushort)glyph);
+			m_glyphs.push_back(0);
+		}
+	}
+	if (m_glyphs.empty() == true)
+	{
+		return;
+	}
+
+	m_glyphBuffer.Update(0, m_glyphs.size() * sizeof(GLushort), &m_glyphs[0]);
+
+	glDisable(GL_DEPTH_TEST);
+	glEnable(GL_BLEND);
+	m_pShaderManager->UseExternalProgram(m_program);
+	glUniform2f(m_viewportSizeLocation, (float)width, (float)height);
+	glUniform1f(m_glyphScaleLocation, (float)scale);
+	m_pShaderManager->BindTexture(FONT_TEXTURE_UNIT, m_fontTexture);
+	ShapeMeshes::BindVertexArray(m_vao);
+	glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, (GLsizei)(m_glyphs.size() / 4));
+	glEnable(GL_DEPTH_TEST);
+}
@@ -0,0 +1,68 @@
+///////////////////////////////////////////////////////////////////////////////
+// statsoverlay.h
+// ============
+// lines of text drawn over the frame, for the frame statistics
+//
+//  A small built-in 5x7 pixel font is kept in a texture, and each
+//  character of the text is one instance of a quad, so the whole
+//  overlay is a single draw with no font file to load.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "ShaderManager.h"
+#include "GPUBuffer.h"
+
+#include <string>
+#include <vector>
+
+/***********************************************************
+ *  StatsOverlay
+ *
+ *  This class contains the font texture, the buffer of the
+ *  characters drawn and the program drawing them. Draw()
+ *  writes the lines from the top left of the window, on a
+ *  dark background so they read over any scene.
+ ***********************************************************/
+class StatsOverlay
+{
+public:
+	// constructor
+	StatsOverlay(ShaderManager* pShaderManager);
+	// destructor
+	~StatsOverlay();
+
+	// texture unit the font is read from, above the texture table
+	static const int FONT_TEXTURE_UNIT = 26;
+	// cell of a character, the 5x7 glyph and its spacing, in pixels
+	static const int GLYPH_WIDTH = 6;
+	static const int GLYPH_HEIGHT = 8;
+	// most characters drawn in one overlay
+	static const int MAX_GLYPHS = 4096;
+
+	// build the program and the font texture; false when the
+	// program fails to build
+	bool Create(const char* vertexPath, const char* fragmentPath);
+	bool IsAvailable() const { return(0 != m_program); }
+
+	// draw the lines over the bound framebuffer of the given size;
+	// characters missing from the font show as '?', lower case as
+	// upper case
+	void Draw(const std::vector<std::string>& lines, int width, int height);
+
+private:
+	// pointer to shader manager object
+	ShaderManager* m_pShaderManager;
+	GLuint m_program;
+	GLint m_viewportSizeLocation;
+	GLint m_glyphScaleLocation;
+	// vertex array reading one character per instance
+	GLuint m_vao;
+	// stream, rewritten every frame the overlay is drawn
+	GPUBuffer m_glyphBuffer;
+	GLuint m_fontTexture;
+	// font column of each character code, -1 when it has none
+	int m_glyphIndex[128];
+	// x, y, font column and padding of each character drawn
+	std::vector<GLushort> m_glyphs;
+};
@@ -0,0 +1,188 @@
+///////////////////////////////////////////////////////////////////////////////
+// stereotarget.cpp
+// ============
+// two layer target both eyes of a stereo frame render into in one pass
+//
+//  With GL_OVR_multiview the framebuffer covers both layers of a texture
+//  array, and every draw is broadcast to them with the camera of each
+//  eye, so the scene is culled and submitted once for the two views.
+//  The layers are shown side by side in the window at the end of the
+//  frame.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "StereoTarget.h"
+#include "GPUMemory.h"
+#include "ShapeMeshes.h"
+
+#include <glm/glm.hpp>
+
+#include <iostream>
+
+/***********************************************************
+ *  StereoTarget()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+StereoTarget::StereoTarget()
+{
+	m_framebuffer = 0;
+	m_readFramebuffer = 0;
+	m_colorTexture = 0;
+	m_depthTexture = 0;
+	m_eyeWidth = 0;
+	m_eyeHeight = 0;
+	m_windowWidth = 0;
+	m_windowHeight = 0;
+	m_bActive = false;
+}
+
+/***********************************************************
+ *  ~StereoTarget()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+StereoTarget::~StereoTarget()
+{
+	DestroyTargets();
+}
+
+/***********************************************************
+ *  IsAvailable()
+ *
+ *  This method is used for checking that the driver can
+ *  broadcast the draws to the layers of the target.
+ ***********************************************************/
+bool StereoTarget::IsAvailable()
+{
+	return(GLEW_OVR_multiview ? true : false);
+}
+
+/***********************************************************
+ *  Begin()
+ *
+ *  This method is used for pointing the frame at both
+ *  layers of the target, which are created again whenever
+ *  the window changes their size. Each eye gets one half
+ *  of the window, so the viewport is the size of a half.
+ *  The depth is floating point, which reverse-Z needs and
+ *  the standard depth convention does not mind.
+ ***********************************************************/
+bool StereoTarget::Begin(int windowWidth, int windowHeight)
+{
+	m_windowWidth = windowWidth;
+	m_windowHeight = windowHeight;
+	m_bActive = false;
+	if ((windowWidth < EYE_COUNT) || (windowHeight <= 0) || (IsAvailable() == false))
+	{
+		return(false);
+	}
+
+	int eyeWidth = windowWidth / EYE_COUNT;
+	if ((0 == m_framebuffer) || (eyeWidth != m_eyeWidth) || (windowHeight != m_eyeHeight))
+	{
+		CreateTargets(eyeWidth, windowHeight);
+	}
+
+	glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+	glViewport(0, 0, m_eyeWidth, m_eyeHeight);
+	m_bActive = true;
+	return(true);
+}
+
+/***********************************************************
+ *  End()
+ *
+ *  This method is used for copying the layer of every eye
+ *  into its half of the window, and leaving the window
+ *  framebuffer and viewport bound for the swap.
+ ***********************************************************/
+void StereoTarget::End()
+{
+	if (m_bActive == false)
+	{
+		return;
+	}
+
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, m_readFramebuffer);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+	for (int eye = 0; eye < EYE_COUNT; eye++)
+	{
+		glFramebufferTextureLayer(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, m_colorTexture, 0, eye);
+		glBlitFramebuffer(0, 0, m_eyeWidth, m_eyeHeight,
+			eye * m_eyeWidth, 0, (eye + 1) * m_eyeWidth, m_eyeHeight,
+			GL_COLOR_BUFFER_BIT, GL_NEAREST);
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glViewport(0, 0, m_windowWidth, m_windowHeight);
+	m_bActive = false;
+}
+
+/***********************************************************
+ *  CreateTargets()
+ *
+ *  This method is used for creating the color and depth
+ *  texture arrays with a layer per eye, the framebuffer
+ *  drawing into all of their layers at once, and the one
+ *  reading them back a layer at a time.
+ ***********************************************************/
+void StereoTarget::CreateTargets(int eyeWidth, int eyeHeight)
+{
+	DestroyTargets();
+
+	m_eyeWidth = eyeWidth;
+	m_eyeHeight = eyeHeight;
+
+	glGenTextures(1, &m_colorTexture);
+	GLuint previousTexture = ShapeMeshes::BindTextureForEdit(GL_TEXTURE_2D_ARRAY, m_colorTexture);
+	glTexStorage3D(GL_TEXTURE_2D_ARRAY, 1, GL_RGBA8, eyeWidth, eyeHeight, EYE_COUNT);
+	glGenTextures(1, &m_depthTexture);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, m_depthTexture);
+	glTexStorage3D(GL_TEXTURE_2D_ARRAY, 1, GL_DEPTH_COMPONENT32F, eyeWidth, eyeHeight, EYE_COUNT);
+	ShapeMeshes::RestoreTextureBinding(GL_TEXTURE_2D_ARRAY, previousTexture);
+	GPUMemory::TrackTexture(m_colorTexture, GL_RGBA8, eyeWidth, eyeHeight, EYE_COUNT, 1,
+		GPUMemory::CATEGORY_RENDER_TARGET, "stereo color");
+	GPUMemory::TrackTexture(m_depthTexture, GL_DEPTH_COMPONENT32F, eyeWidth, eyeHeight, EYE_COUNT, 1,
+		GPUMemory::CATEGORY_RENDER_TARGET, "stereo depth");
+
+	glGenFramebuffers(1, &m_framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+	glFramebufferTextureMultiviewOVR(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, m_colorTexture, 0, 0, EYE_COUNT);
+	glFramebufferTextureMultiviewOVR(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, m_depthTexture, 0, 0, EYE_COUNT);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+	{
+		std::cout << "Stereo target framebuffer is incomplete" << std::endl;
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	glGenFramebuffers(1, &m_readFramebuffer);
+}
+
+/***********************************************************
+ *  DestroyTargets()
+ *
+ *  This method is used for freeing the framebuffers and
+ *  their texture arrays.
+ ***********************************************************/
+void StereoTarget::DestroyTargets()
+{
+	if (0 != m_framebuffer)
+	{
+		glDeleteFramebuffers(1, &m_framebuffer);
+		m_framebuffer = 0;
+	}
+	if (0 != m_readFramebuffer)
+	{
+		glDeleteFramebuffers(1, &m_readFramebuffer);
+		m_readFramebuffer = 0;
+	}
+	if (0 != m_colorTexture)
+	{
+		GPUMemory::DeleteTextures(1, &m_colorTexture);
+		m_colorTexture = 0;
+	}
+	if (0 != m_depthTexture)
+	{
+		GPUMemory::DeleteTextures(1, &m_depthTexture);
+		m_depthTexture = 0;
+	}
+}
@@ -0,0 +1,70 @@
+///////////////////////////////////////////////////////////////////////////////
+// stereotarget.h
+// ============
+// two layer target both eyes of a stereo frame render into in one pass
+//
+//  With GL_OVR_multiview the framebuffer covers both layers of a texture
+//  array, and every draw is broadcast to them with the camera of each
+//  eye, so the scene is culled and submitted once for the two views.
+//  The layers are shown side by side in the window at the end of the
+//  frame.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+/***********************************************************
+ *  StereoTarget
+ *
+ *  This class contains the color and depth texture arrays
+ *  of the stereo frame, one layer per eye. Begin() points
+ *  the scene draws at both layers, sized for one half of
+ *  the window, and End() blits the left eye into the left
+ *  half of the window and the right eye into the right.
+ ***********************************************************/
+class StereoTarget
+{
+public:
+	// constructor
+	StereoTarget();
+	// destructor
+	~StereoTarget();
+
+	// views of the stereo frame, the layers of the texture arrays
+	static const int EYE_COUNT = 2;
+
+	// true when the driver supports GL_OVR_multiview
+	static bool IsAvailable();
+
+	// bind the multiview framebuffer and the viewport of one eye for
+	// a window framebuffer of the given size; false when the window
+	// has no area, as while it is minimized
+	bool Begin(int windowWidth, int windowHeight);
+	// show both eyes side by side in the window
+	void End();
+
+	// size of one eye of the frame the last Begin() set up
+	int GetEyeWidth() const { return(m_eyeWidth); }
+	int GetEyeHeight() const { return(m_eyeHeight); }
+
+private:
+	// framebuffer drawing into both layers, and the one reading a
+	// single layer for the blit to the window
+	GLuint m_framebuffer;
+	GLuint m_readFramebuffer;
+	// color and depth texture arrays with one layer per eye
+	GLuint m_colorTexture;
+	GLuint m_depthTexture;
+	int m_eyeWidth;
+	int m_eyeHeight;
+	// window framebuffer size of the last Begin()
+	int m_windowWidth;
+	int m_windowHeight;
+	// true while the frame is drawn into m_framebuffer
+	bool m_bActive;
+
+	// size the texture arrays for the eyes of a frame
+	void CreateTargets(int eyeWidth, int eyeHeight);
+	void DestroyTargets();
+};
@@ -0,0 +1,288 @@
+///////////////////////////////////////////////////////////////////////////////
+// stressscene.cpp
+// ============
+// generated scenes of many objects and lights, for scaling tests
+//
+//  The kitchen has a handful of objects and three lights, too few to
+//  show how the frame time grows with the scene. The generator takes
+//  the composite prefabs of a scene description, the jar, the cup, the
+//  cucumber and the knife, makes variants of them in other textures,
+//  materials and tints, and writes a text scene placing any number of
+//  them on a grid or at random over a floor, under any number of point
+//  lights. Run with --benchmark over a range of counts, it gives the
+//  frame time against the objects and the lights for each render path.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "StressScene.h"
+#include "SceneFile.h"
+#include "SceneManager.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <random>
+
+namespace
+{
+	// composite prefabs of the kitchen placed when none are set
+	const char* const DEFAULT_PREFABS[] = { "jar", "cup", "cucumber", "knife" };
+	// side of the square each object gets, which the longest of
+	// them, the knife, fits in
+	const float OBJECT_SPACING = 9.0f;
+	// height of the point lights over the floor, and their reach
+	// in light spacings, so each point is lit by a few of them
+	const float LIGHT_HEIGHT = 6.0f;
+	const float LIGHT_REACH = 1.5f;
+	// range the variants tint the part colors by
+	const float MIN_TINT = 0.7f;
+	const float MAX_TINT = 1.3f;
+
+	// write count floats separated by spaces
+	void WriteFloats(std::ofstream& file, const float* pValues, int count)
+	{
+		for (int i = 0; i < count; i++)
+		{
+			file << " " << pValues[i];
+		}
+	}
+}
+
+/***********************************************************
+ *  StressScene()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+StressScene::StressScene()
+{
+	m_objectCount = 0;
+	m_lightCount = 0;
+	m_layout = LAYOUT_GRID;
+	m_seed = 1;
+	m_variants = DEFAULT_VARIANTS;
+	for (size_t i = 0; i < sizeof(DEFAULT_PREFABS) / sizeof(DEFAULT_PREFABS[0]); i++)
+	{
+		m_prefabs.push_back(DEFAULT_PREFABS[i]);
+	}
+}
+
+/***********************************************************
+ *  Write()
+ *
+ *  This method is used for writing the generated scene. The
+ *  textures, models and materials of the base scene are
+ *  copied, and every placed prefab is written in variants:
+ *  the first as it is, the others with each textured part
+ *  moved to another texture, each part to another material
+ *  of the same transparency, and the colors tinted, so the
+ *  objects bind a mix of textures and materials as a real
+ *  scene would. The objects fill a square, on a grid or at
+ *  random, in front of the starting camera, on a floor
+ *  covering it, and the lights are spread over it on a
+ *  grid of their own.
+ ***********************************************************/
+bool StressScene::Write(const char* filename) const
+{
+	SceneFile baseScene;
+	if (baseScene.LoadText(m_baseScene.c_str()) == false)
+	{
+		return(false);
+	}
+
+	const SceneFile::TEXTURE_RECORD* pTextures = baseScene.GetTextures();
+	const SceneFile::MODEL_RECORD* pModels = baseScene.GetModels();
+	const SceneFile::MATERIAL_RECORD* pMaterials = baseScene.GetMaterials();
+	const SceneFile::PART_RECORD* pParts = baseScene.GetParts();
+	const SceneFile::PREFAB_RECORD* pPrefabs = baseScene.GetPrefabs();
+
+	std::vector<uint32_t> prefabs;
+	for (size_t i = 0; i < m_prefabs.size(); i++)
+	{
+		for (uint32_t prefab = 0; prefab < baseScene.GetPrefabCount(); prefab++)
+		{
+			if (m_prefabs[i] == pPrefabs[prefab].name)
+			{
+				prefabs.push_back(prefab);
+			}
+		}
+	}
+	if (prefabs.empty() == true)
+	{
+		std::cout << m_baseScene << " has none of the prefabs to place" << std::endl;
+		return(false);
+	}
+
+	int maxLights = SceneManager::MAX_LIGHTS;
+	int lightCount = std::min(std::max(m_lightCount, 0), maxLights);
+	if (lightCount < m_lightCount)
+	{
+		std::cout << "Placing " << lightCount << " of the " << m_lightCount << " lights, the most the scene holds" << std::endl;
+	}
+	int objectCount = std::max(m_objectCount, 0);
+	int variants = std::max(m_variants, 1);
+
+	std::ofstream file(filename);
+	if (!file)
+	{
+		std::cout << "Could not create scene file " << filename << std::endl;
+		return(false);
+	}
+
+	std::mt19937 random(m_seed);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+	file << "# " << filename << "\n";
+	file << "# generated from " << m_baseScene << ": " << objectCount << " objects, "
+		<< lightCount << " lights, " << variants << " variants, "
+		<< ((m_layout == LAYOUT_RANDOM) ? "random" : "grid") << " layout, seed " << m_seed << "\n\n";
+
+	for (uint32_t i = 0; i < baseScene.GetTextureCount(); i++)
+	{
+		file << "texture " << pTextures[i].tag << " " << pTextures[i].path << "\n";
+	}
+	for (uint32_t i = 0; i < baseScene.GetModelCount(); i++)
+	{
+		file << "model " << pModels[i].tag << " " << pModels[i].path << "\n";
+	}
+	int floorMaterial = -1;
+	for (uint32_t i = 0; i < baseScene.GetMaterialCount(); i++)
+	{
+		const SceneFile::MATERIAL_RECORD& material = pMaterials[i];
+		file << "material " << material.tag;
+		WriteFloats(file, material.ambientColor, 3);
+		WriteFloats(file, &material.ambientStrength, 1);
+		WriteFloats(file, material.diffuseColor, 3);
+		WriteFloats(file, material.specularColor, 3);
+		WriteFloats(file, &material.shininess, 1);
+		file << " " << material.bTransparent;
+		WriteFloats(file, &material.reflectivity, 1);
+		file << " " << material.bCoarseShading << "\n";
+		if ((floorMaterial < 0) && (material.bTransparent == 0))
+		{
+			floorMaterial = (int)i;
+		}
+	}
+
+	// the objects fill a square of cells from the front edge of
+	// the floor away from the camera
+	int cellsPerSide = std::max((int)std::ceil(std::sqrt((double)objectCount)), 1);
+	float side = (float)cellsPerSide * OBJECT_SPACING;
+	float minX = -0.5f * side;
+	float maxZ = 0.0f;
+
+	// point lights on a grid of their own over the square, each
+	// reaching past its neighbors
+	int lightsPerSide = std::max((int)std::ceil(std::sqrt((double)lightCount)), 1);
+	float lightSpacing = side / (float)lightsPerSide;
+	file << "\n";
+	for (int i = 0; i < lightCount; i++)
+	{
+		float diffuse[3] = { 0.3f + 0.5f * unit(random), 0.3f + 0.5f * unit(random), 0.3f + 0.5f * unit(random) };
+		file << "light " << (minX + ((float)(i % lightsPerSide) + 0.5f) * lightSpacing)
+			<< " " << LIGHT_HEIGHT
+			<< " " << (maxZ - ((float)(i / lightsPerSide) + 0.5f) * lightSpacing)
+			<< "  0.01 0.01 0.01 ";
+		WriteFloats(file, diffuse, 3);
+		file << " ";
+		WriteFloats(file, diffuse, 3);
+		file << "  32.0 0.2 " << (lightSpacing * LIGHT_REACH) << "\n";
+	}
+
+	// a floor under the square, as the countertop is in the kitchen
+	file << "\nprefab stress_floor\n";
+	file << "part box " << ((baseScene.GetTextureCount() > 0) ? pTextures[0].tag : "none")
+		<< " " << ((floorMaterial >= 0) ? pMaterials[floorMaterial].tag : "none")
+		<< "  0.3 0.3 0.3 1.0  " << (side / OBJECT_SPACING) << " " << (side / OBJECT_SPACING)
+		<< "  " << side << " 2.0 " << side << "  0.0 0.0 0.0  0.0 0.0 0.0\nend\n";
+
+	for (size_t i = 0; i < prefabs.size(); i++)
+	{
+		const SceneFile::PREFAB_RECORD& prefab = pPrefabs[prefabs[i]];
+		for (int variant = 0; variant < variants; variant++)
+		{
+			file << "\nprefab " << prefab.name << "_" << variant << "\n";
+			for (uint32_t p = 0; p < prefab.partCount; p++)
+			{
+				SceneFile::PART_RECORD part = pParts[prefab.firstPart + p];
+				if ((variant > 0) && (part.textureIndex >= 0))
+				{
+					part.textureIndex = (int32_t)((part.textureIndex + variant) % baseScene.GetTextureCount());
+				}
+				if ((variant > 0) && (part.materialIndex >= 0))
+				{
+					// step through the materials of the same
+					// transparency, which decides the pass it draws in
+					uint32_t bTransparent = pMaterials[part.materialIndex].bTransparent;
+					int steps = variant;
+					int material = part.materialIndex;
+					for (uint32_t tries = 0; (steps > 0) && (tries < baseScene.GetMaterialCount() * (uint32_t)variants); tries++)
+					{
+						material = (material + 1) % (int)baseScene.GetMaterialCount();
+						steps -= (pMaterials[material].bTransparent == bTransparent) ? 1 : 0;
+					}
+					part.materialIndex = material;
+				}
+				if (variant > 0)
+				{
+					for (int c = 0; c < 3; c++)
+					{
+						part.color[c] = std::min(part.color[c] * (MIN_TINT + (MAX_TINT - MIN_TINT) * unit(random)), 1.0f);
+					}
+				}
+
+				file << "part ";
+				if (part.mesh == SceneFile::MESH_MODEL)
+				{
+					file << "model:" << pModels[part.modelIndex].tag;
+				}
+				else
+				{
+					file << SceneFile::GetMeshName((int)part.mesh);
+				}
+				file << " " << ((part.textureIndex >= 0) ? pTextures[part.textureIndex].tag : "none")
+					<< " " << ((part.materialIndex >= 0) ? pMaterials[part.materialIndex].tag : "none") << " ";
+				WriteFloats(file, part.color, 4);
+				file << " ";
+				WriteFloats(file, part.UVscale, 2);
+				file << " ";
+				WriteFloats(file, part.scaleXYZ, 3);
+				file << " ";
+				WriteFloats(file, part.rotationDegreesXYZ, 3);
+				file << " ";
+				WriteFloats(file, part.positionXYZ, 3);
+				file << "\n";
+			}
+			file << "end\n";
+		}
+	}
+
+	// the objects move like the tagged ones of the kitchen, so
+	// they are never baked together and each draws on its own
+	file << "\nstatic stress_floor  0.0 -1.0 " << (maxZ - 0.5f * side) << "\n";
+	for (int i = 0; i < objectCount; i++)
+	{
+		float x = 0.0f;
+		float z = 0.0f;
+		if (m_layout == LAYOUT_RANDOM)
+		{
+			x = minX + side * unit(random);
+			z = maxZ - side * unit(random);
+		}
+		else
+		{
+			x = minX + ((float)(i % cellsPerSide) + 0.5f) * OBJECT_SPACING;
+			z = maxZ - ((float)(i / cellsPerSide) + 0.5f) * OBJECT_SPACING;
+		}
+		const SceneFile::PREFAB_RECORD& prefab = pPrefabs[prefabs[i % prefabs.size()]];
+		int variant = (int)(random() % (unsigned int)variants);
+		file << "instance " << prefab.name << "_" << variant << " -  "
+			<< x << " 0.0 " << z << "  0.0 " << (360.0f * unit(random)) << " 0.0\n";
+	}
+
+	if (!file)
+	{
+		std::cout << "Could not write scene file " << filename << std::endl;
+		return(false);
+	}
+	return(true);
+}
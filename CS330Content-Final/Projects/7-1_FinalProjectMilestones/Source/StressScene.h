@@ -0,0 +1,67 @@
+///////////////////////////////////////////////////////////////////////////////
+// stressscene.h
+// ============
+// generated scenes of many objects and lights, for scaling tests
+//
+//  The kitchen has a handful of objects and three lights, too few to
+//  show how the frame time grows with the scene. The generator takes
+//  the composite prefabs of a scene description, the jar, the cup, the
+//  cucumber and the knife, makes variants of them in other textures,
+//  materials and tints, and writes a text scene placing any number of
+//  them on a grid or at random over a floor, under any number of point
+//  lights. Run with --benchmark over a range of counts, it gives the
+//  frame time against the objects and the lights for each render path.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+/***********************************************************
+ *  StressScene
+ *
+ *  This class contains the settings of a generated scene
+ *  and writes it. The same settings and seed always write
+ *  the same scene.
+ ***********************************************************/
+class StressScene
+{
+public:
+	// constructor
+	StressScene();
+
+	// prefabs of a variant count placed, and how they are placed
+	static const int DEFAULT_VARIANTS = 4;
+	enum LAYOUT
+	{
+		LAYOUT_GRID = 0,	// rows of the prefabs, one cell each
+		LAYOUT_RANDOM		// anywhere over the area of the grid
+	};
+
+	// scene description the textures, materials and prefabs come from
+	void SetBaseScene(const char* filename) { m_baseScene = filename; }
+	// objects and point lights placed; the lights are limited to
+	// what the scene manager can hold
+	void SetObjectCount(int objectCount) { m_objectCount = objectCount; }
+	void SetLightCount(int lightCount) { m_lightCount = lightCount; }
+	void SetLayout(LAYOUT layout) { m_layout = layout; }
+	void SetSeed(unsigned int seed) { m_seed = seed; }
+	// copies of every prefab in other textures and materials
+	void SetVariants(int variants) { m_variants = variants; }
+	// prefabs placed, in turn; the jar, cup, cucumber and knife unless set
+	void SetPrefabs(const std::vector<std::string>& prefabs) { m_prefabs = prefabs; }
+
+	// write the scene as text; false when the base scene cannot be
+	// read, has none of the prefabs or the file cannot be written
+	bool Write(const char* filename) const;
+
+private:
+	std::string m_baseScene;
+	int m_objectCount;
+	int m_lightCount;
+	LAYOUT m_layout;
+	unsigned int m_seed;
+	int m_variants;
+	std::vector<std::string> m_prefabs;
+};
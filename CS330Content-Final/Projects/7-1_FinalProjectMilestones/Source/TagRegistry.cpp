@@ -0,0 +1,195 @@
+///////////////////////////////////////////////////////////////////////////////
+// tagregistry.cpp
+// ============
+// interned tags of the scene textures and materials
+//
+//  Tags like "backdrop" or "stone" are only strings while the scene is
+//  loaded and described. They are interned into compact handles once,
+//  and everything after that passes the handles, which resolve to a
+//  texture slot or material ID without comparing a string.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "TagRegistry.h"
+
+#include <iostream>
+
+namespace
+{
+	// returned by GetTag() for handles naming no entry
+	const std::string g_EmptyTag;
+}
+
+/***********************************************************
+ *  TagRegistry()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+TagRegistry::TagRegistry(const char* kind)
+{
+	m_kind = kind;
+}
+
+/***********************************************************
+ *  MakeHandle()
+ *
+ *  This method is used for packing an entry index with the
+ *  current generation of the entry. The index is stored
+ *  plus one so INVALID_HANDLE never names an entry.
+ ***********************************************************/
+TagRegistry::HANDLE TagRegistry::MakeHandle(uint32_t index) const
+{
+	return(((HANDLE)m_entries[index].generation << HANDLE_INDEX_BITS) | (index + 1));
+}
+
+/***********************************************************
+ *  FindEntry()
+ *
+ *  This method is used for checking a handle against the
+ *  entry it names, returning the entry index only when the
+ *  entry is in use with the generation of the handle.
+ ***********************************************************/
+int TagRegistry::FindEntry(HANDLE handle) const
+{
+	uint32_t index = handle & MAX_ENTRIES;
+	if ((index == 0) || (index > m_entries.size()))
+	{
+		return(-1);
+	}
+	index--;
+
+	const ENTRY& entry = m_entries[index];
+	if ((entry.bActive == false) || (entry.generation != (uint16_t)(handle >> HANDLE_INDEX_BITS)))
+	{
+		return(-1);
+	}
+	return((int)index);
+}
+
+/***********************************************************
+ *  Register()
+ *
+ *  This method is used for interning a tag with the value
+ *  it maps to. Registering a tag again keeps its handle and
+ *  only replaces the value.
+ ***********************************************************/
+TagRegistry::HANDLE TagRegistry::Register(const std::string& tag, int value)
+{
+	std::unordered_map<std::string, uint32_t>::const_iterator found = m_tagIndexes.find(tag);
+	if (found != m_tagIndexes.end())
+	{
+		m_entries[found->second].value = value;
+		return(MakeHandle(found->second));
+	}
+
+	uint32_t index = 0;
+	if (m_freeEntries.empty() == false)
+	{
+		index = m_freeEntries.back();
+		m_freeEntries.pop_back();
+	}
+	else if (m_entries.size() < MAX_ENTRIES)
+	{
+		index = (uint32_t)m_entries.size();
+		ENTRY entry;
+		entry.value = -1;
+		entry.generation = 1;
+		entry.bActive = false;
+		m_entries.push_back(entry);
+	}
+	else
+	{
+		std::cout << "Could not register " << m_kind << " \"" << tag << "\", all "
+			<< MAX_ENTRIES << " handles are used" << std::endl;
+		return(INVALID_HANDLE);
+	}
+
+	ENTRY& entry = m_entries[index];
+	entry.tag = tag;
+	entry.value = value;
+	entry.bActive = true;
+	m_tagIndexes[tag] = index;
+	m_reportedTags.erase(tag);
+
+	return(MakeHandle(index));
+}
+
+/***********************************************************
+ *  Find()
+ *
+ *  This method is used for looking up the handle of a tag.
+ *  Unknown tags are reported the first time they are asked
+ *  for, so a typo in a scene shows up once in the console
+ *  instead of silently drawing without the resource.
+ ***********************************************************/
+TagRegistry::HANDLE TagRegistry::Find(const std::string& tag) const
+{
+	std::unordered_map<std::string, uint32_t>::const_iterator found = m_tagIndexes.find(tag);
+	if (found == m_tagIndexes.end())
+	{
+		if (m_reportedTags.insert(tag).second == true)
+		{
+			std::cout << "Unknown " << m_kind << " tag \"" << tag << "\"" << std::endl;
+		}
+		return(INVALID_HANDLE);
+	}
+
+	return(MakeHandle(found->second));
+}
+
+/***********************************************************
+ *  Resolve()
+ *
+ *  This method is used for getting the value a handle maps
+ *  to, or -1 when it names no entry in use.
+ ***********************************************************/
+int TagRegistry::Resolve(HANDLE handle) const
+{
+	int index = FindEntry(handle);
+	if (index < 0)
+	{
+		return(-1);
+	}
+	return(m_entries[index].value);
+}
+
+/***********************************************************
+ *  GetTag()
+ *
+ *  This method is used for getting the tag of a handle back,
+ *  for messages and tools.
+ ***********************************************************/
+const std::string& TagRegistry::GetTag(HANDLE handle) const
+{
+	int index = FindEntry(handle);
+	if (index < 0)
+	{
+		return(g_EmptyTag);
+	}
+	return(m_entries[index].tag);
+}
+
+/***********************************************************
+ *  Clear()
+ *
+ *  This method is used for dropping every tag. The entries
+ *  move to their next generation, so the handles made from
+ *  them no longer resolve once the entries are reused.
+ ***********************************************************/
+void TagRegistry::Clear()
+{
+	m_freeEntries.clear();
+	for (size_t i = m_entries.size(); i > 0; i--)
+	{
+		ENTRY& entry = m_entries[i - 1];
+		if (entry.bActive == true)
+		{
+			entry.generation++;
+		}
+		entry.bActive = false;
+		entry.tag.clear();
+		entry.value = -1;
+		m_freeEntries.push_back((uint32_t)(i - 1));
+	}
+	m_tagIndexes.clear();
+	m_reportedTags.clear();
+}
@@ -0,0 +1,78 @@
+///////////////////////////////////////////////////////////////////////////////
+// tagregistry.h
+// ============
+// interned tags of the scene textures and materials
+//
+//  Tags like "backdrop" or "stone" are only strings while the scene is
+//  loaded and described. They are interned into compact handles once,
+//  and everything after that passes the handles, which resolve to a
+//  texture slot or material ID without comparing a string.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+/***********************************************************
+ *  TagRegistry
+ *
+ *  This class contains the tags of one kind of resource and
+ *  the value each maps to. A handle holds the index of its
+ *  entry and the generation the entry had when the handle
+ *  was made, so handles from before a Clear() are detected
+ *  as stale instead of resolving to another resource.
+ ***********************************************************/
+class TagRegistry
+{
+public:
+	// constructor; kind names the resources in the error messages
+	TagRegistry(const char* kind);
+
+	// generation in the high 16 bits, entry index + 1 in the low 16
+	typedef uint32_t HANDLE;
+	// never names an entry, like the "none" tag
+	static const HANDLE INVALID_HANDLE = 0;
+	static const int HANDLE_INDEX_BITS = 16;
+	static const uint32_t MAX_ENTRIES = (1u << HANDLE_INDEX_BITS) - 1;
+
+	// map a tag to a value, replacing the value of a registered tag;
+	// returns INVALID_HANDLE when the registry is full
+	HANDLE Register(const std::string& tag, int value);
+	// handle of a registered tag; an unknown tag is reported once and
+	// gets INVALID_HANDLE
+	HANDLE Find(const std::string& tag) const;
+	// value of a handle, -1 for INVALID_HANDLE or a stale handle
+	int Resolve(HANDLE handle) const;
+	bool IsValid(HANDLE handle) const { return(Resolve(handle) >= 0); }
+	// tag of a handle, empty for INVALID_HANDLE or a stale handle
+	const std::string& GetTag(HANDLE handle) const;
+
+	// drop every tag; the handles handed out so far turn stale
+	void Clear();
+	size_t GetCount() const { return(m_tagIndexes.size()); }
+
+private:
+	struct ENTRY
+	{
+		std::string tag;
+		int value;
+		uint16_t generation;
+		bool bActive;
+	};
+
+	std::string m_kind;
+	std::vector<ENTRY> m_entries;
+	// entries dropped by Clear(), reused before new ones are added
+	std::vector<uint32_t> m_freeEntries;
+	std::unordered_map<std::string, uint32_t> m_tagIndexes;
+	// unknown tags already reported, so a tag is reported only once
+	mutable std::unordered_set<std::string> m_reportedTags;
+
+	HANDLE MakeHandle(uint32_t index) const;
+	// entry index of a handle that is not stale, -1 otherwise
+	int FindEntry(HANDLE handle) const;
+};
@@ -0,0 +1,101 @@
+///////////////////////////////////////////////////////////////////////////////
+// targetformats.cpp
+// ============
+// formats of the render targets, picked per quality tier for bandwidth
+//
+//  The targets of a frame are written and read several times each, so
+//  the bytes per pixel of their formats are a large share of the
+//  bandwidth of the frame. HDR color does not need the alpha or the
+//  mantissa of RGBA16F and fits R11F_G11F_B10F at half the size; the
+//  normals of the G-buffer are unit vectors, packed octahedrally into
+//  two signed channels; and the cascades are orthographic, so their
+//  depth is linear and 16 bits resolve it. The highest tier keeps
+//  the formats without loss for comparing against.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "TargetFormats.h"
+
+#include <cstdlib>
+#include <cstring>
+
+namespace
+{
+	// bytes per pixel: 4, 2 and 2 for the low tier; 4, 4 and 2 for
+	// the medium one; 8, 8 and 4 for the high one. Eight bits per
+	// axis still place a normal within about a degree, which the low
+	// tier accepts for the specular highlights
+	const TargetFormats::FORMATS TIER_FORMATS[TargetFormats::TIER_COUNT] =
+	{
+		{ GL_R11F_G11F_B10F, GL_RG8_SNORM, GL_DEPTH_COMPONENT16 },
+		{ GL_R11F_G11F_B10F, GL_RG16_SNORM, GL_DEPTH_COMPONENT16 },
+		{ GL_RGBA16F, GL_RGBA16F, GL_DEPTH_COMPONENT24 }
+	};
+
+	const char* TIER_NAMES[TargetFormats::TIER_COUNT] =
+	{
+		"low",
+		"medium",
+		"high"
+	};
+}
+
+/***********************************************************
+ *  GetFormats()
+ *
+ *  This method is used for getting the formats of a tier,
+ *  the nearest one for a tier out of range.
+ ***********************************************************/
+const TargetFormats::FORMATS& TargetFormats::GetFormats(int tier)
+{
+	if (tier < TIER_LOW)
+	{
+		tier = TIER_LOW;
+	}
+	if (tier >= TIER_COUNT)
+	{
+		tier = TIER_COUNT - 1;
+	}
+	return(TIER_FORMATS[tier]);
+}
+
+/***********************************************************
+ *  GetTierName()
+ *
+ *  This method is used for getting the name of a tier.
+ ***********************************************************/
+const char* TargetFormats::GetTierName(int tier)
+{
+	if ((tier < TIER_LOW) || (tier >= TIER_COUNT))
+	{
+		return("unknown");
+	}
+	return(TIER_NAMES[tier]);
+}
+
+/***********************************************************
+ *  ParseTier()
+ *
+ *  This method is used for reading a tier given by its name
+ *  or its number.
+ ***********************************************************/
+int TargetFormats::ParseTier(const char* pText)
+{
+	if (NULL == pText)
+	{
+		return(-1);
+	}
+	for (int tier = TIER_LOW; tier < TIER_COUNT; tier++)
+	{
+		if (strcmp(pText, TIER_NAMES[tier]) == 0)
+		{
+			return(tier);
+		}
+	}
+	char* pEnd = NULL;
+	long tier = strtol(pText, &pEnd, 10);
+	if ((pEnd == pText) || (*pEnd != '\0') || (tier < TIER_LOW) || (tier >= TIER_COUNT))
+	{
+		return(-1);
+	}
+	return((int)tier);
+}
@@ -0,0 +1,61 @@
+///////////////////////////////////////////////////////////////////////////////
+// targetformats.h
+// ============
+// formats of the render targets, picked per quality tier for bandwidth
+//
+//  The targets of a frame are written and read several times each, so
+//  the bytes per pixel of their formats are a large share of the
+//  bandwidth of the frame. HDR color does not need the alpha or the
+//  mantissa of RGBA16F and fits R11F_G11F_B10F at half the size; the
+//  normals of the G-buffer are unit vectors, packed octahedrally into
+//  two signed channels; and the cascades are orthographic, so their
+//  depth is linear and 16 bits resolve it. The highest tier keeps
+//  the formats without loss for comparing against.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+/***********************************************************
+ *  TargetFormats
+ *
+ *  This class contains the table of target formats per
+ *  tier. It is used through static methods, since the scene,
+ *  the post effects and the shadows each create targets of
+ *  the tier the scene manager picked.
+ ***********************************************************/
+class TargetFormats
+{
+public:
+	// the tiers, from least to most bandwidth
+	enum TIER
+	{
+		TIER_LOW = 0,
+		TIER_MEDIUM,
+		TIER_HIGH,
+		TIER_COUNT
+	};
+
+	// tier used unless told otherwise
+	static const int DEFAULT_TIER = TIER_MEDIUM;
+
+	// formats of the targets one tier creates
+	struct FORMATS
+	{
+		// lit frame before tone mapping, and the post targets holding
+		// colors of the same range
+		GLenum hdrColor;
+		// octahedral normal of the G-buffer, in the first two channels
+		GLenum gbufferNormal;
+		// depth array of the shadow cascades
+		GLenum cascadeDepth;
+	};
+
+	// formats of a tier, clamped to the table
+	static const FORMATS& GetFormats(int tier);
+	// name of a tier, for the help and the command line
+	static const char* GetTierName(int tier);
+	// tier of a name or a number, -1 for neither
+	static int ParseTier(const char* pText);
+};
@@ -0,0 +1,834 @@
+///////////////////////////////////////////////////////////////////////////////
+// texturecache.cpp
+// ============
+// disk cache of decoded texture images and their mip levels
+//
+//  Without compressed files every launch decodes the JPEG and PNG
+//  images again and generates their mip levels. The cache keeps the
+//  pixels of every level of a decoded image in one file, named by a
+//  hash of the contents of the image file, which the next launch
+//  maps and uploads as it is with no decode at all. An image file
+//  that changed hashes to another entry and its old one is deleted,
+//  and the least recently used entries are deleted once the cache
+//  grows past its size limit.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "TextureCache.h"
+#include "TextureStreamer.h"
+#include "MipChain.h"
+#include "ShapeMeshes.h"
+#include "GPUMemory.h"
+#include "AssetPack.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <direct.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+	// "TXC1" and the layout version of an entry file
+	const uint32_t CACHE_ENTRY_MAGIC = 0x31435854;
+	const uint32_t CACHE_ENTRY_VERSION = 3;
+	// first line of the index file
+	const char* const CACHE_INDEX_HEADER = "texturecache 1";
+
+	// start of an entry file, followed by levelCount CACHE_LEVEL
+	// records and the pixels of each level, rows bottom up and
+	// tightly packed
+	struct CACHE_HEADER
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint64_t hash;			// of the image file the entry was decoded from
+		uint64_t imageFileSize;
+		uint32_t width;
+		uint32_t height;
+		uint32_t colorChannels;	// of the pixels
+		uint32_t levelCount;
+		uint32_t fileChannels;	// of the image file; 2 and 4 have alpha
+		int32_t grayTolerance;	// the decode reduced images to gray with
+	};
+
+	struct CACHE_LEVEL
+	{
+		uint32_t width;
+		uint32_t height;
+		uint64_t offset;		// from the start of the file, 16 byte aligned
+		uint64_t size;
+	};
+
+	static_assert(sizeof(CACHE_HEADER) == 48, "CACHE_HEADER must have no padding");
+	static_assert(sizeof(CACHE_LEVEL) == 24, "CACHE_LEVEL must have no padding");
+
+	/***********************************************************
+	 *  MapFile()
+	 *
+	 *  This function is used for mapping a whole file read
+	 *  only, returning NULL when it cannot be mapped.
+	 ***********************************************************/
+	const unsigned char* MapFile(const std::string& filename, size_t& fileSize)
+	{
+		void* pView = NULL;
+		fileSize = 0;
+#ifdef _WIN32
+		HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+			OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+		if (file != INVALID_HANDLE_VALUE)
+		{
+			LARGE_INTEGER size;
+			if ((GetFileSizeEx(file, &size) != 0) && (size.QuadPart > 0))
+			{
+				fileSize = (size_t)size.QuadPart;
+				// the view keeps the mapping open once both handles are closed
+				HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+				if (NULL != mapping)
+				{
+					pView = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+					CloseHandle(mapping);
+				}
+			}
+			CloseHandle(file);
+		}
+#else
+		int file = open(filename.c_str(), O_RDONLY);
+		if (file >= 0)
+		{
+			struct stat fileInfo;
+			if ((fstat(file, &fileInfo) == 0) && (fileInfo.st_size > 0))
+			{
+				fileSize = (size_t)fileInfo.st_size;
+				pView = mmap(NULL, fileSize, PROT_READ, MAP_PRIVATE, file, 0);
+				if (pView == MAP_FAILED)
+				{
+					pView = NULL;
+				}
+			}
+			close(file);
+		}
+#endif
+		if (NULL == pView)
+		{
+			fileSize = 0;
+		}
+		return((const unsigned char*)pView);
+	}
+
+	void UnmapFile(const unsigned char* pView, size_t fileSize)
+	{
+#ifdef _WIN32
+		UnmapViewOfFile(pView);
+#else
+		munmap((void*)pView, fileSize);
+#endif
+	}
+
+	bool MakeDirectory(const std::string& directory)
+	{
+#ifdef _WIN32
+		int result = _mkdir(directory.c_str());
+#else
+		int result = mkdir(directory.c_str(), 0755);
+#endif
+		return((result == 0) || (errno == EEXIST));
+	}
+
+	/***********************************************************
+	 *  CheckEntry()
+	 *
+	 *  This function is used for checking that a mapped entry
+	 *  file was written for the image file of the hash and that
+	 *  every level it lists lies inside the file.
+	 ***********************************************************/
+	bool CheckEntry(const unsigned char* pFile, size_t fileSize, uint64_t hash, uint64_t imageFileSize)
+	{
+		if (fileSize < sizeof(CACHE_HEADER))
+		{
+			return(false);
+		}
+		const CACHE_HEADER* pHeader = (const CACHE_HEADER*)pFile;
+		if ((pHeader->magic != CACHE_ENTRY_MAGIC) || (pHeader->version != CACHE_ENTRY_VERSION) ||
+			(pHeader->hash != hash) || (pHeader->imageFileSize != imageFileSize) ||
+			(pHeader->colorChannels < 1) || (pHeader->colorChannels > 4) ||
+			(pHeader->fileChannels < 1) || (pHeader->fileChannels > 4) ||
+			((pHeader->fileChannels >= 3) && (pHeader->grayTolerance != ImageDecoder::GetGrayTolerance())) ||
+			(pHeader->levelCount == 0) || (pHeader->levelCount > 32) ||
+			(sizeof(CACHE_HEADER) + pHeader->levelCount * sizeof(CACHE_LEVEL) > fileSize))
+		{
+			return(false);
+		}
+
+		const CACHE_LEVEL* pLevels = (const CACHE_LEVEL*)(pFile + sizeof(CACHE_HEADER));
+		uint32_t width = pHeader->width;
+		uint32_t height = pHeader->height;
+		for (uint32_t i = 0; i < pHeader->levelCount; i++)
+		{
+			if ((pLevels[i].width != width) || (pLevels[i].height != height) ||
+				(pLevels[i].size != (uint64_t)width * height * pHeader->colorChannels) ||
+				(pLevels[i].offset > fileSize) || (pLevels[i].size > fileSize - pLevels[i].offset))
+			{
+				return(false);
+			}
+			width = std::max(width / 2, 1u);
+			height = std::max(height / 2, 1u);
+		}
+		return(true);
+	}
+}
+
+/***********************************************************
+ *  TextureCache()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+TextureCache::TextureCache()
+{
+	m_sizeLimit = DEFAULT_SIZE_LIMIT;
+	m_bOpen = false;
+	m_useCount = 0;
+	m_bIndexDirty = false;
+}
+
+/***********************************************************
+ *  ~TextureCache()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+TextureCache::~TextureCache()
+{
+	Close();
+}
+
+/***********************************************************
+ *  Open()
+ *
+ *  This method is used for using a cache directory, creating
+ *  it when missing, and reading the index of its entries.
+ ***********************************************************/
+bool TextureCache::Open(const std::string& directory, size_t sizeLimit)
+{
+	Close();
+
+	if (MakeDirectory(directory) == false)
+	{
+		std::cout << "Could not create texture cache directory " << directory << ", textures are not cached" << std::endl;
+		return(false);
+	}
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_directory = directory;
+	m_sizeLimit = sizeLimit;
+	m_bOpen = true;
+	ReadIndex();
+	// a smaller limit than the last run applies right away
+	Trim();
+
+	return(true);
+}
+
+/***********************************************************
+ *  Close()
+ *
+ *  This method is used for writing the index with the last
+ *  use of every entry and no longer caching textures.
+ ***********************************************************/
+void TextureCache::Close()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if ((true == m_bOpen) && (true == m_bIndexDirty))
+	{
+		WriteIndex();
+	}
+	m_bOpen = false;
+	m_index.clear();
+	m_useCount = 0;
+	m_bIndexDirty = false;
+}
+
+/***********************************************************
+ *  HashFile()
+ *
+ *  This method is used for hashing the contents of a file
+ *  with 64 bit FNV-1a, which is far cheaper than decoding
+ *  the image in it; the view of an image in the asset pack
+ *  is hashed where it lies.
+ ***********************************************************/
+bool TextureCache::HashFile(const std::string& filename, uint64_t& hash, uint64_t& fileSize)
+{
+	hash = 14695981039346656037ull;
+	fileSize = 0;
+
+	AssetPack::ASSET_VIEW view;
+	if (AssetPack::Find(filename.c_str(), view) == true)
+	{
+		for (size_t i = 0; i < view.size; i++)
+		{
+			hash = (hash ^ view.pData[i]) * 1099511628211ull;
+		}
+		fileSize = view.size;
+		return(true);
+	}
+
+	FILE* pFile = fopen(filename.c_str(), "rb");
+	if (NULL == pFile)
+	{
+		return(false);
+	}
+
+	std::vector<unsigned char> buffer(256 * 1024);
+	size_t bytesRead = fread(&buffer[0], 1, buffer.size(), pFile);
+	while (bytesRead > 0)
+	{
+		for (size_t i = 0; i < bytesRead; i++)
+		{
+			hash = (hash ^ buffer[i]) * 1099511628211ull;
+		}
+		fileSize += bytesRead;
+		bytesRead = fread(&buffer[0], 1, buffer.size(), pFile);
+	}
+	bool bRead = (ferror(pFile) == 0);
+	fclose(pFile);
+
+	return(bRead);
+}
+
+std::string TextureCache::GetEntryFilename(uint64_t hash) const
+{
+	char name[32];
+	snprintf(name, sizeof(name), "%016llx.tex", (unsigned long long)hash);
+	return(m_directory + "/" + name);
+}
+
+std::string TextureCache::GetIndexFilename() const
+{
+	return(m_directory + "/index.txt");
+}
+
+int TextureCache::FindEntry(const std::string& imageFilename) const
+{
+	for (size_t i = 0; i < m_index.size(); i++)
+	{
+		if (m_index[i].imageFilename == imageFilename)
+		{
+			return((int)i);
+		}
+	}
+	return(-1);
+}
+
+int TextureCache::FindHash(uint64_t hash) const
+{
+	for (size_t i = 0; i < m_index.size(); i++)
+	{
+		if ((m_index[i].hash == hash) && (m_index[i].bytes > 0))
+		{
+			return((int)i);
+		}
+	}
+	return(-1);
+}
+
+/***********************************************************
+ *  RemoveEntry()
+ *
+ *  This method is used for dropping a line of the index and
+ *  deleting its entry file, unless another image file with
+ *  the same contents still uses it.
+ ***********************************************************/
+void TextureCache::RemoveEntry(int entry)
+{
+	const uint64_t hash = m_index[entry].hash;
+	m_index.erase(m_index.begin() + entry);
+	m_bIndexDirty = true;
+
+	for (size_t i = 0; i < m_index.size(); i++)
+	{
+		if (m_index[i].hash == hash)
+		{
+			return;
+		}
+	}
+	remove(GetEntryFilename(hash).c_str());
+}
+
+/***********************************************************
+ *  Trim()
+ *
+ *  This method is used for deleting the least recently used
+ *  entries until the rest fit in the size limit. Entries
+ *  still being written are never deleted.
+ ***********************************************************/
+void TextureCache::Trim()
+{
+	uint64_t cachedBytes = 0;
+	for (size_t i = 0; i < m_index.size(); i++)
+	{
+		cachedBytes += m_index[i].bytes;
+	}
+
+	while (cachedBytes > m_sizeLimit)
+	{
+		int oldest = -1;
+		for (size_t i = 0; i < m_index.size(); i++)
+		{
+			if ((m_index[i].bytes > 0) && ((oldest < 0) || (m_index[i].lastUse < m_index[oldest].lastUse)))
+			{
+				oldest = (int)i;
+			}
+		}
+		if (oldest < 0)
+		{
+			break;
+		}
+
+		std::cout << "Texture cache is past " << (m_sizeLimit >> 20) << " MB, dropping the entry of "
+			<< m_index[oldest].imageFilename << std::endl;
+		cachedBytes -= m_index[oldest].bytes;
+		RemoveEntry(oldest);
+	}
+}
+
+/***********************************************************
+ *  ReadIndex()
+ *
+ *  This method is used for reading the index file, one line
+ *  per entry of its hash, size, last use and image file.
+ *  Lines whose entry file is gone are dropped.
+ ***********************************************************/
+bool TextureCache::ReadIndex()
+{
+	m_index.clear();
+	m_useCount = 0;
+
+	std::ifstream indexFile(GetIndexFilename().c_str());
+	if (!indexFile)
+	{
+		return(false);
+	}
+
+	std::string line;
+	if (!std::getline(indexFile, line) || (line != CACHE_INDEX_HEADER))
+	{
+		std::cout << "Texture cache index " << GetIndexFilename() << " has an unknown layout, starting an empty cache" << std::endl;
+		m_bIndexDirty = true;
+		return(false);
+	}
+
+	while (std::getline(indexFile, line))
+	{
+		std::istringstream fields(line);
+		INDEX_ENTRY entry;
+		if (!(fields >> std::hex >> entry.hash >> std::dec >> entry.bytes >> entry.lastUse))
+		{
+			m_bIndexDirty = true;
+			continue;
+		}
+		fields >> std::ws;
+		std::getline(fields, entry.imageFilename);
+		if ((entry.imageFilename.empty() == true) || (entry.bytes == 0))
+		{
+			m_bIndexDirty = true;
+			continue;
+		}
+
+		FILE* pEntryFile = fopen(GetEntryFilename(entry.hash).c_str(), "rb");
+		if (NULL == pEntryFile)
+		{
+			m_bIndexDirty = true;
+			continue;
+		}
+		fclose(pEntryFile);
+
+		m_useCount = std::max(m_useCount, entry.lastUse);
+		m_index.push_back(entry);
+	}
+
+	return(true);
+}
+
+/***********************************************************
+ *  WriteIndex()
+ *
+ *  This method is used for writing the index file next to
+ *  the entries and replacing the last one with it.
+ ***********************************************************/
+bool TextureCache::WriteIndex()
+{
+	std::string filename = GetIndexFilename();
+	std::string writtenFilename = filename + ".tmp";
+	FILE* pFile = fopen(writtenFilename.c_str(), "w");
+	if (NULL == pFile)
+	{
+		std::cout << "Could not write texture cache index " << filename << std::endl;
+		return(false);
+	}
+
+	bool bWritten = (fprintf(pFile, "%s\n", CACHE_INDEX_HEADER) > 0);
+	for (size_t i = 0; i < m_index.size(); i++)
+	{
+		if (m_index[i].bytes > 0)
+		{
+			bWritten = (fprintf(pFile, "%016llx %llu %llu %s\n", (unsigned long long)m_index[i].hash,
+				(unsigned long long)m_index[i].bytes, (unsigned long long)m_index[i].lastUse,
+				m_index[i].imageFilename.c_str()) > 0) && bWritten;
+		}
+	}
+	bWritten = (fclose(pFile) == 0) && bWritten;
+
+	// rename() does not replace an existing file on Windows
+	remove(filename.c_str());
+	if ((false == bWritten) || (rename(writtenFilename.c_str(), filename.c_str()) != 0))
+	{
+		std::cout << "Could not write texture cache index " << filename << std::endl;
+		remove(writtenFilename.c_str());
+		return(false);
+	}
+
+	m_bIndexDirty = false;
+	return(true);
+}
+
+/***********************************************************
+ *  CreateGLTexture()
+ *
+ *  This method is used for creating a texture from the entry
+ *  of an image file when the cache holds one for its current
+ *  contents. The entry file is mapped and each level is
+ *  uploaded from the mapping, with no copy on the way.
+ *  Skipping the first levels gives a smaller texture for
+ *  when memory is short.
+ ***********************************************************/
+GLuint TextureCache::CreateGLTexture(const std::string& imageFilename, int& width, int& height, int& colorChannels,
+	int firstLevel)
+{
+	width = 0;
+	height = 0;
+	colorChannels = 0;
+	if (false == m_bOpen)
+	{
+		return(0);
+	}
+
+	uint64_t hash = 0;
+	uint64_t imageFileSize = 0;
+	if (HashFile(imageFilename, hash, imageFileSize) == false)
+	{
+		return(0);
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		int entry = FindEntry(imageFilename);
+		if ((entry >= 0) && (m_index[entry].hash != hash))
+		{
+			std::cout << "Image " << imageFilename << " changed since it was cached, dropping its texture cache entry" << std::endl;
+			RemoveEntry(entry);
+			entry = -1;
+		}
+		if ((entry < 0) && (FindHash(hash) < 0))
+		{
+			return(0);
+		}
+	}
+
+	// the levels are uploaded where they lie in the warm-start
+	// snapshot, or in the mapped entry file
+	std::string entryFilename = GetEntryFilename(hash);
+	AssetPack::ASSET_VIEW snapshotView;
+	bool bSnapshot = AssetPack::Find(entryFilename.c_str(), snapshotView);
+	size_t fileSize = snapshotView.size;
+	const unsigned char* pFile = (bSnapshot == true) ? snapshotView.pData : MapFile(entryFilename, fileSize);
+	if ((NULL == pFile) || (CheckEntry(pFile, fileSize, hash, imageFileSize) == false))
+	{
+		std::cout << "Texture cache entry of " << imageFilename << " is damaged, decoding the image again" << std::endl;
+		if ((NULL != pFile) && (bSnapshot == false))
+		{
+			UnmapFile(pFile, fileSize);
+		}
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		int entry = FindHash(hash);
+		while (entry >= 0)
+		{
+			RemoveEntry(entry);
+			entry = FindHash(hash);
+		}
+		remove(GetEntryFilename(hash).c_str());
+		return(0);
+	}
+
+	const CACHE_HEADER* pHeader = (const CACHE_HEADER*)pFile;
+	if ((firstLevel < 0) || (firstLevel >= (int)pHeader->levelCount))
+	{
+		if (bSnapshot == false)
+		{
+			UnmapFile(pFile, fileSize);
+		}
+		return(0);
+	}
+	const CACHE_LEVEL* pLevels = (const CACHE_LEVEL*)(pFile + sizeof(CACHE_HEADER)) + firstLevel;
+	const uint32_t levelCount = pHeader->levelCount - (uint32_t)firstLevel;
+	GLenum internalFormat = GL_NONE;
+	GLenum format = GL_NONE;
+	TextureStreamer::GetPixelFormat((int)pHeader->colorChannels, internalFormat, format);
+
+	GLuint textureID = 0;
+	if (ShapeMeshes::HasDirectStateAccess() == true)
+	{
+		glCreateTextures(GL_TEXTURE_2D, 1, &textureID);
+		glTextureStorage2D(textureID, (GLsizei)levelCount, internalFormat, pLevels[0].width, pLevels[0].height);
+
+		// set the texture wrapping parameters
+		glTextureParameteri(textureID, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		glTextureParameteri(textureID, GL_TEXTURE_WRAP_T, GL_REPEAT);
+		// set texture filtering parameters
+		glTextureParameteri(textureID, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTextureParameteri(textureID, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	}
+	else
+	{
+		glGenTextures(1, &textureID);
+		GLuint previousTexture = ShapeMeshes::BindTextureForEdit(GL_TEXTURE_2D, textureID);
+		if ((GLEW_VERSION_4_2 == GL_TRUE) || (GLEW_ARB_texture_storage == GL_TRUE))
+		{
+			glTexStorage2D(GL_TEXTURE_2D, (GLsizei)levelCount, internalFormat, pLevels[0].width, pLevels[0].height);
+		}
+		else
+		{
+			for (uint32_t i = 0; i < levelCount; i++)
+			{
+				glTexImage2D(GL_TEXTURE_2D, (GLint)i, internalFormat, pLevels[i].width, pLevels[i].height, 0,
+					format, GL_UNSIGNED_BYTE, NULL);
+			}
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)levelCount - 1);
+		}
+
+		// set the texture wrapping parameters
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+		// set texture filtering parameters
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		ShapeMeshes::RestoreTextureBinding(GL_TEXTURE_2D, previousTexture);
+	}
+	for (uint32_t i = 0; i < levelCount; i++)
+	{
+		TextureStreamer::UploadRows(textureID, 0, (int)pLevels[i].width, (int)pLevels[i].height,
+			(int)pHeader->colorChannels, pFile + pLevels[i].offset, (int)i);
+	}
+	TextureStreamer::SetSwizzle(textureID, internalFormat);
+
+	GPUMemory::TrackTexture(textureID, internalFormat, pLevels[0].width, pLevels[0].height, 1, (int)levelCount,
+		GPUMemory::CATEGORY_TEXTURE, imageFilename.c_str());
+
+	width = (int)pHeader->width;
+	height = (int)pHeader->height;
+	colorChannels = (int)pHeader->fileChannels;
+	if (bSnapshot == false)
+	{
+		UnmapFile(pFile, fileSize);
+	}
+	AssetPack::NoteArtifact(entryFilename.c_str(), false);
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	int entry = FindEntry(imageFilename);
+	if (entry < 0)
+	{
+		// another image file with the same contents wrote the entry
+		INDEX_ENTRY newEntry;
+		newEntry.imageFilename = imageFilename;
+		newEntry.hash = hash;
+		newEntry.bytes = fileSize;
+		m_index.push_back(newEntry);
+		entry = (int)m_index.size() - 1;
+	}
+	m_index[entry].lastUse = ++m_useCount;
+	m_bIndexDirty = true;
+
+	return(textureID);
+}
+
+/***********************************************************
+ *  Store()
+ *
+ *  This method is used for writing the entry of a decoded
+ *  image: every mip level down to 1x1, those of its chain
+ *  as they are and any it lacks filtered from the one
+ *  above. The entry file is written under a temporary name
+ *  and renamed once complete, so a run that stops halfway
+ *  never leaves an entry that maps.
+ ***********************************************************/
+bool TextureCache::Store(const std::string& imageFilename, const ImageDecoder::IMAGE& image)
+{
+	if ((false == m_bOpen) || (NULL == image.pixels) || (image.width <= 0) || (image.height <= 0) ||
+		(image.colorChannels < 1) || (image.colorChannels > 4))
+	{
+		return(false);
+	}
+
+	uint64_t hash = 0;
+	uint64_t imageFileSize = 0;
+	if (HashFile(imageFilename, hash, imageFileSize) == false)
+	{
+		return(false);
+	}
+
+	// lay out the levels after the header and the level records
+	std::vector<CACHE_LEVEL> levels;
+	int levelWidth = image.width;
+	int levelHeight = image.height;
+	while (true)
+	{
+		CACHE_LEVEL level;
+		level.width = (uint32_t)levelWidth;
+		level.height = (uint32_t)levelHeight;
+		level.size = (uint64_t)levelWidth * levelHeight * image.colorChannels;
+		levels.push_back(level);
+		if ((levelWidth == 1) && (levelHeight == 1))
+		{
+			break;
+		}
+		levelWidth = std::max(levelWidth / 2, 1);
+		levelHeight = std::max(levelHeight / 2, 1);
+	}
+	uint64_t fileSize = sizeof(CACHE_HEADER) + levels.size() * sizeof(CACHE_LEVEL);
+	for (size_t i = 0; i < levels.size(); i++)
+	{
+		fileSize = (fileSize + 15) & ~(uint64_t)15;
+		levels[i].offset = fileSize;
+		fileSize += levels[i].size;
+	}
+	if (fileSize > m_sizeLimit)
+	{
+		return(false);
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		int entry = FindEntry(imageFilename);
+		if ((entry >= 0) && (m_index[entry].hash != hash))
+		{
+			RemoveEntry(entry);
+			entry = -1;
+		}
+		if (entry >= 0)
+		{
+			// already cached, or being written by another thread
+			return(true);
+		}
+
+		// an image file with the same contents shares its entry file
+		int sharedEntry = -1;
+		for (size_t i = 0; i < m_index.size(); i++)
+		{
+			if (m_index[i].hash == hash)
+			{
+				sharedEntry = (int)i;
+			}
+		}
+		if ((sharedEntry >= 0) && (m_index[sharedEntry].bytes == 0))
+		{
+			// still being written, the next run adds the line
+			return(true);
+		}
+
+		INDEX_ENTRY newEntry;
+		newEntry.imageFilename = imageFilename;
+		newEntry.hash = hash;
+		newEntry.bytes = (sharedEntry >= 0) ? m_index[sharedEntry].bytes : 0;
+		newEntry.lastUse = ++m_useCount;
+		m_index.push_back(newEntry);
+		if (sharedEntry >= 0)
+		{
+			m_bIndexDirty = true;
+			return(true);
+		}
+	}
+
+	std::vector<unsigned char> file((size_t)fileSize, 0);
+	CACHE_HEADER* pHeader = (CACHE_HEADER*)&file[0];
+	pHeader->magic = CACHE_ENTRY_MAGIC;
+	pHeader->version = CACHE_ENTRY_VERSION;
+	pHeader->hash = hash;
+	pHeader->imageFileSize = imageFileSize;
+	pHeader->width = (uint32_t)image.width;
+	pHeader->height = (uint32_t)image.height;
+	pHeader->colorChannels = (uint32_t)image.colorChannels;
+	pHeader->levelCount = (uint32_t)levels.size();
+	pHeader->fileChannels = (uint32_t)image.fileChannels;
+	pHeader->grayTolerance = (int32_t)ImageDecoder::GetGrayTolerance();
+	memcpy(&file[sizeof(CACHE_HEADER)], &levels[0], levels.size() * sizeof(CACHE_LEVEL));
+	for (size_t i = 0; i < levels.size(); i++)
+	{
+		if ((int)i < image.levelCount)
+		{
+			memcpy(&file[(size_t)levels[i].offset], image.pixels +
+				MipChain::GetLevelOffset(image.width, image.height, image.colorChannels, (int)i), (size_t)levels[i].size);
+			continue;
+		}
+		MipChain::HalveLevel(&file[(size_t)levels[i - 1].offset], (int)levels[i - 1].width, (int)levels[i - 1].height,
+			&file[(size_t)levels[i].offset], (int)levels[i].width, (int)levels[i].height, image.colorChannels);
+	}
+
+	std::string filename = GetEntryFilename(hash);
+	std::string writtenFilename = filename + ".tmp";
+	bool bWritten = false;
+	FILE* pFile = fopen(writtenFilename.c_str(), "wb");
+	if (NULL != pFile)
+	{
+		bWritten = (fwrite(&file[0], 1, file.size(), pFile) == file.size());
+		bWritten = (fclose(pFile) == 0) && bWritten;
+		remove(filename.c_str());
+		bWritten = bWritten && (rename(writtenFilename.c_str(), filename.c_str()) == 0);
+	}
+	if (false == bWritten)
+	{
+		std::cout << "Could not write texture cache entry " << filename << std::endl;
+		remove(writtenFilename.c_str());
+	}
+	else
+	{
+		AssetPack::NoteArtifact(filename.c_str(), true);
+	}
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	int entry = FindEntry(imageFilename);
+	if ((entry >= 0) && (m_index[entry].hash == hash))
+	{
+		if (true == bWritten)
+		{
+			m_index[entry].bytes = fileSize;
+		}
+		else
+		{
+			// the line holds no entry file yet, nothing to delete
+			m_index.erase(m_index.begin() + entry);
+		}
+	}
+	if (true == bWritten)
+	{
+		Trim();
+		WriteIndex();
+	}
+
+	return(bWritten);
+}
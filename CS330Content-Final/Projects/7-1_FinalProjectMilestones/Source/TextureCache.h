@@ -0,0 +1,98 @@
+///////////////////////////////////////////////////////////////////////////////
+// texturecache.h
+// ============
+// disk cache of decoded texture images and their mip levels
+//
+//  Without compressed files every launch decodes the JPEG and PNG
+//  images again and generates their mip levels. The cache keeps the
+//  pixels of every level of a decoded image in one file, named by a
+//  hash of the contents of the image file, which the next launch
+//  maps and uploads as it is with no decode at all. An image file
+//  that changed hashes to another entry and its old one is deleted,
+//  and the least recently used entries are deleted once the cache
+//  grows past its size limit.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "ImageDecoder.h"
+
+#include <GL/glew.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/***********************************************************
+ *  TextureCache
+ *
+ *  This class contains the index of the cache directory: the
+ *  image file each entry was decoded from, the hash of its
+ *  contents and when the entry was last used.
+ ***********************************************************/
+class TextureCache
+{
+public:
+	// constructor
+	TextureCache();
+	// destructor
+	~TextureCache();
+
+	// most bytes of entries kept in the directory
+	static const size_t DEFAULT_SIZE_LIMIT = 512 * 1024 * 1024;
+
+	// use the directory, created when missing, and read its index
+	bool Open(const std::string& directory, size_t sizeLimit);
+	// write the index and stop caching
+	void Close();
+	bool IsOpen() const { return(m_bOpen); }
+
+	// texture of the cached levels of an image file from firstLevel
+	// down, 0 when the cache holds none for the current contents of
+	// the file; the size and channels are those of the image file,
+	// whatever the cached pixels were expanded to
+	GLuint CreateGLTexture(const std::string& imageFilename, int& width, int& height, int& colorChannels,
+		int firstLevel = 0);
+	// write an image decoded with its rows bottom up, with the mip
+	// levels box filtered from it; worker threads may store images
+	// while others are stored or read
+	bool Store(const std::string& imageFilename, const ImageDecoder::IMAGE& image);
+
+	// FNV-1a hash of the contents of a file
+	static bool HashFile(const std::string& filename, uint64_t& hash, uint64_t& fileSize);
+
+private:
+	// one entry of the index; two image files with the same
+	// contents share the entry file of their hash
+	struct INDEX_ENTRY
+	{
+		std::string imageFilename;
+		uint64_t hash;
+		uint64_t bytes;		// 0 while the entry file is written
+		uint64_t lastUse;
+	};
+
+	std::string m_directory;
+	size_t m_sizeLimit;
+	bool m_bOpen;
+	// the index lines, guarded by m_mutex
+	std::vector<INDEX_ENTRY> m_index;
+	uint64_t m_useCount;
+	bool m_bIndexDirty;
+	std::mutex m_mutex;
+
+	std::string GetEntryFilename(uint64_t hash) const;
+	std::string GetIndexFilename() const;
+	// the methods below are called with m_mutex locked
+	int FindEntry(const std::string& imageFilename) const;
+	int FindHash(uint64_t hash) const;
+	// drop an index line and delete its entry file, unless another
+	// line still uses it
+	void RemoveEntry(int entry);
+	// delete the least recently used entries past the size limit
+	void Trim();
+	bool ReadIndex();
+	bool WriteIndex();
+};
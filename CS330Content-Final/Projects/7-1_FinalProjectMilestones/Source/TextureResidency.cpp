@@ -0,0 +1,611 @@
+///////////////////////////////////////////////////////////////////////////////
+// textureresidency.cpp
+// ============
+// keep the scene textures inside a memory budget
+//
+//  Tracks the bytes of every mip level of the scene textures. Once
+//  they pass the budget, the top levels of the textures drawn least
+//  recently are dropped by copying the rest into a smaller texture,
+//  and the levels are read back from their files when a texture is
+//  drawn large enough on screen to need them and the budget allows.
+//  The draws the camera is about to see are marked as predicted, so
+//  their levels are read back before they come into view.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "TextureResidency.h"
+#include "CompressedTexture.h"
+#include "TextureStreamer.h"
+#include "ShapeMeshes.h"
+#include "GPUMemory.h"
+#include "Logger.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+/***********************************************************
+ *  TextureResidency()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+TextureResidency::TextureResidency(TextureCache* pTextureCache)
+{
+	m_pTextureCache = pTextureCache;
+	m_pCompressor = NULL;
+	m_budget = DEFAULT_BUDGET;
+	m_frame = 1;
+	memset(&m_stats, 0, sizeof(m_stats));
+}
+
+/***********************************************************
+ *  IsSupported()
+ *
+ *  This method is used for checking that the textures are
+ *  made with immutable storage, whose levels can be counted
+ *  and copied into a texture of fewer levels.
+ ***********************************************************/
+bool TextureResidency::IsSupported()
+{
+	return((ShapeMeshes::HasDirectStateAccess() == true) &&
+		((GLEW_VERSION_4_3 == GL_TRUE) || (GLEW_ARB_copy_image == GL_TRUE)));
+}
+
+/***********************************************************
+ *  ReadLevels()
+ *
+ *  This method is used for reading the size and format of a
+ *  texture holding its full mip chain, and the bytes of each
+ *  level. RGB8 levels are counted as 4 bytes a texel, as the
+ *  drivers store them.
+ ***********************************************************/
+void TextureResidency::ReadLevels(RESIDENT_TEXTURE& resident)
+{
+	resident.levelBytes.clear();
+	resident.width = 0;
+	resident.height = 0;
+	resident.internalFormat = GL_NONE;
+	resident.topLevel = 0;
+	if (0 == resident.texture)
+	{
+		return;
+	}
+
+	GLint levelCount = 0;
+	GLint width = 0;
+	GLint height = 0;
+	GLint internalFormat = 0;
+	if (ShapeMeshes::HasDirectStateAccess() == true)
+	{
+		glGetTextureParameteriv(resident.texture, GL_TEXTURE_IMMUTABLE_LEVELS, &levelCount);
+		glGetTextureLevelParameteriv(resident.texture, 0, GL_TEXTURE_WIDTH, &width);
+		glGetTextureLevelParameteriv(resident.texture, 0, GL_TEXTURE_HEIGHT, &height);
+		glGetTextureLevelParameteriv(resident.texture, 0, GL_TEXTURE_INTERNAL_FORMAT, &internalFormat);
+	}
+	else
+	{
+		GLint maxLevel = 0;
+		GLuint previousTexture = ShapeMeshes::BindTextureForEdit(GL_TEXTURE_2D, resident.texture);
+		glGetTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, &maxLevel);
+		glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &width);
+		glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &height);
+		glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_INTERNAL_FORMAT, &internalFormat);
+		ShapeMeshes::RestoreTextureBinding(GL_TEXTURE_2D, previousTexture);
+		levelCount = maxLevel + 1;
+	}
+	if ((width <= 0) || (height <= 0))
+	{
+		return;
+	}
+
+	// a mutable texture only has the levels of its chain
+	GLint chainLevels = 1;
+	while (((width | height) >> chainLevels) != 0)
+	{
+		chainLevels++;
+	}
+	levelCount = std::min(std::max(levelCount, 1), chainLevels);
+
+	resident.width = width;
+	resident.height = height;
+	resident.internalFormat = (GLenum)internalFormat;
+	for (GLint i = 0; i < levelCount; i++)
+	{
+		GLint compressed = GL_FALSE;
+		GLint compressedSize = 0;
+		if (ShapeMeshes::HasDirectStateAccess() == true)
+		{
+			glGetTextureLevelParameteriv(resident.texture, i, GL_TEXTURE_COMPRESSED, &compressed);
+			if (GL_FALSE != compressed)
+			{
+				glGetTextureLevelParameteriv(resident.texture, i, GL_TEXTURE_COMPRESSED_IMAGE_SIZE, &compressedSize);
+			}
+		}
+		else
+		{
+			GLuint previousTexture = ShapeMeshes::BindTextureForEdit(GL_TEXTURE_2D, resident.texture);
+			glGetTexLevelParameteriv(GL_TEXTURE_2D, i, GL_TEXTURE_COMPRESSED, &compressed);
+			if (GL_FALSE != compressed)
+			{
+				glGetTexLevelParameteriv(GL_TEXTURE_2D, i, GL_TEXTURE_COMPRESSED_IMAGE_SIZE, &compressedSize);
+			}
+			ShapeMeshes::RestoreTextureBinding(GL_TEXTURE_2D, previousTexture);
+		}
+
+		size_t levelWidth = (size_t)std::max(width >> i, 1);
+		size_t levelHeight = (size_t)std::max(height >> i, 1);
+		resident.levelBytes.push_back((GL_FALSE != compressed) ? (size_t)compressedSize :
+			(size_t)GPUMemory::GetTextureBytes(resident.internalFormat, (int)levelWidth, (int)levelHeight, 1, 1));
+	}
+}
+
+size_t TextureResidency::GetResidentBytes(const RESIDENT_TEXTURE& resident, int topLevel)
+{
+	size_t bytes = 0;
+	for (size_t i = (size_t)topLevel; i < resident.levelBytes.size(); i++)
+	{
+		bytes += resident.levelBytes[i];
+	}
+	return(bytes);
+}
+
+bool TextureResidency::CanDropLevel(const RESIDENT_TEXTURE& resident, int topLevel)
+{
+	int nextLevel = topLevel + 1;
+	return((0 != resident.texture) && (nextLevel < (int)resident.levelBytes.size()) &&
+		(std::max(resident.width >> nextLevel, resident.height >> nextLevel) >= MIN_RESIDENT_SIZE));
+}
+
+/***********************************************************
+ *  SetTexture()
+ *
+ *  This method is used for tracking the texture of a slot
+ *  and the file its levels are read back from.
+ ***********************************************************/
+void TextureResidency::SetTexture(int slot, GLuint texture, const std::string& sourceFilename, bool bCompressedSource)
+{
+	if (slot < 0)
+	{
+		return;
+	}
+	if (slot >= (int)m_textures.size())
+	{
+		RESIDENT_TEXTURE untracked;
+		untracked.texture = 0;
+		untracked.bCompressedSource = false;
+		untracked.internalFormat = GL_NONE;
+		untracked.width = 0;
+		untracked.height = 0;
+		untracked.topLevel = 0;
+		untracked.neededLevel = 0;
+		untracked.lastDrawnFrame = 0;
+		untracked.predictedLevel = 0;
+		untracked.predictedPixels = 0.0f;
+		untracked.lastPredictedFrame = 0;
+		untracked.bLoadFailed = false;
+		m_textures.resize(slot + 1, untracked);
+	}
+
+	RESIDENT_TEXTURE& resident = m_textures[slot];
+	resident.sourceFilename = sourceFilename;
+	resident.bCompressedSource = bCompressedSource;
+	resident.lastDrawnFrame = 0;
+	resident.neededLevel = 0;
+	resident.lastPredictedFrame = 0;
+	resident.predictedLevel = 0;
+	resident.predictedPixels = 0.0f;
+	resident.bLoadFailed = false;
+	ReplaceTexture(slot, texture);
+}
+
+/***********************************************************
+ *  ReplaceTexture()
+ *
+ *  This method is used for tracking the texture that took
+ *  the place of the one of a slot, holding every level.
+ ***********************************************************/
+void TextureResidency::ReplaceTexture(int slot, GLuint texture)
+{
+	if ((slot < 0) || (slot >= (int)m_textures.size()))
+	{
+		return;
+	}
+
+	m_textures[slot].texture = texture;
+	ReadLevels(m_textures[slot]);
+}
+
+/***********************************************************
+ *  Clear()
+ *
+ *  This method is used for no longer tracking any texture,
+ *  when the scene deletes them.
+ ***********************************************************/
+void TextureResidency::Clear()
+{
+	m_textures.clear();
+}
+
+/***********************************************************
+ *  MarkDrawn()
+ *
+ *  This method is used for noting the level a draw of this
+ *  frame needs: the one with about as many texels across
+ *  as the pixels each repeat of the texture covers.
+ ***********************************************************/
+void TextureResidency::MarkDrawn(int slot, float pixels, float uvScale)
+{
+	if ((slot < 0) || (slot >= (int)m_textures.size()))
+	{
+		return;
+	}
+
+	RESIDENT_TEXTURE& resident = m_textures[slot];
+	int level = GetLevelForPixels(resident, pixels, uvScale);
+
+	if (resident.lastDrawnFrame != m_frame)
+	{
+		resident.lastDrawnFrame = m_frame;
+		resident.neededLevel = level;
+	}
+	else
+	{
+		resident.neededLevel = std::min(resident.neededLevel, level);
+	}
+}
+
+/***********************************************************
+ *  MarkPredicted()
+ *
+ *  This method is used for noting the level a draw about
+ *  to come into view will need, and the pixels it will
+ *  cover, which orders the restores of the predicted
+ *  textures.
+ ***********************************************************/
+void TextureResidency::MarkPredicted(int slot, float pixels, float uvScale)
+{
+	if ((slot < 0) || (slot >= (int)m_textures.size()))
+	{
+		return;
+	}
+
+	RESIDENT_TEXTURE& resident = m_textures[slot];
+	int level = GetLevelForPixels(resident, pixels, uvScale);
+
+	if (resident.lastPredictedFrame != m_frame)
+	{
+		resident.lastPredictedFrame = m_frame;
+		resident.predictedLevel = level;
+		resident.predictedPixels = pixels;
+	}
+	else
+	{
+		resident.predictedLevel = std::min(resident.predictedLevel, level);
+		resident.predictedPixels = std::max(resident.predictedPixels, pixels);
+	}
+}
+
+/***********************************************************
+ *  GetLevelForPixels()
+ *
+ *  This method is used for the level with about as many
+ *  texels across as the pixels each repeat of the texture
+ *  covers.
+ ***********************************************************/
+int TextureResidency::GetLevelForPixels(const RESIDENT_TEXTURE& resident, float pixels, float uvScale)
+{
+	float texels = (float)std::max(resident.width, resident.height) * std::max(uvScale, 1.0f);
+	float ratio = texels / std::max(pixels, 1.0f);
+	int level = (ratio > 1.0f) ? (int)floorf(log2f(ratio)) : 0;
+	return(std::min(level, std::max((int)resident.levelBytes.size() - 1, 0)));
+}
+
+/***********************************************************
+ *  GetWantedLevel()
+ *
+ *  This method is used for the finest level the draws of
+ *  this frame read or are predicted to read; the top level
+ *  when there are none.
+ ***********************************************************/
+int TextureResidency::GetWantedLevel(const RESIDENT_TEXTURE& resident, bool& bDrawn) const
+{
+	bDrawn = (resident.lastDrawnFrame == m_frame);
+	int level = resident.topLevel;
+	if (bDrawn == true)
+	{
+		level = std::min(level, resident.neededLevel);
+	}
+	if (resident.lastPredictedFrame == m_frame)
+	{
+		level = std::min(level, resident.predictedLevel);
+	}
+	return(level);
+}
+
+/***********************************************************
+ *  CopyLevels()
+ *
+ *  This method is used for creating a texture of fewer
+ *  levels and copying the matching levels of a texture into
+ *  it, entirely on the GPU.
+ ***********************************************************/
+GLuint TextureResidency::CopyLevels(GLuint source, int sourceLevel, GLenum internalFormat,
+	int width, int height, int levelCount)
+{
+	GLuint textureID = 0;
+	glCreateTextures(GL_TEXTURE_2D, 1, &textureID);
+	glTextureStorage2D(textureID, levelCount, internalFormat, width, height);
+	for (int i = 0; i < levelCount; i++)
+	{
+		glCopyImageSubData(
+			source, GL_TEXTURE_2D, sourceLevel + i, 0, 0, 0,
+			textureID, GL_TEXTURE_2D, i, 0, 0, 0,
+			std::max(width >> i, 1), std::max(height >> i, 1), 1);
+	}
+
+	// set the texture wrapping parameters
+	glTextureParameteri(textureID, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTextureParameteri(textureID, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	// set texture filtering parameters
+	glTextureParameteri(textureID, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTextureParameteri(textureID, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	TextureStreamer::SetSwizzle(textureID, internalFormat);
+	GPUMemory::TrackTexture(textureID, internalFormat, width, height, 1, levelCount, GPUMemory::CATEGORY_TEXTURE, "texture");
+
+	return(textureID);
+}
+
+/***********************************************************
+ *  LoadLevels()
+ *
+ *  This method is used for reading the levels of a texture
+ *  from topLevel down back from its file. Compressed files
+ *  hold every level; an image file is read from its texture
+ *  cache entry, which is written first when missing, and
+ *  only without the cache is it decoded and cut down on the
+ *  GPU. The levels of a texture the scene compressed on the
+ *  GPU are compressed again once read.
+ ***********************************************************/
+GLuint TextureResidency::LoadLevels(const RESIDENT_TEXTURE& resident, int topLevel)
+{
+	const int levelCount = (int)resident.levelBytes.size() - topLevel;
+	if (true == resident.bCompressedSource)
+	{
+		CompressedTexture texture;
+		if ((texture.Load(resident.sourceFilename.c_str()) == false) ||
+			(texture.GetLevelCount() != (int)resident.levelBytes.size()))
+		{
+			return(0);
+		}
+		return(texture.CreateGLTexture(topLevel));
+	}
+
+	int width = 0;
+	int height = 0;
+	int colorChannels = 0;
+	GLuint textureID = m_pTextureCache->CreateGLTexture(resident.sourceFilename, width, height, colorChannels, topLevel);
+	if (0 == textureID)
+	{
+		ImageDecoder::IMAGE image;
+		if (ImageDecoder::Decode(resident.sourceFilename.c_str(), image) == false)
+		{
+			return(0);
+		}
+		if (m_pTextureCache->Store(resident.sourceFilename, image) == true)
+		{
+			textureID = m_pTextureCache->CreateGLTexture(resident.sourceFilename, width, height, colorChannels, topLevel);
+		}
+		GLenum internalFormat = GL_NONE;
+		GLenum format = GL_NONE;
+		if ((0 == textureID) && (TextureStreamer::GetPixelFormat(image.colorChannels, internalFormat, format) == true))
+		{
+			GLuint fullTexture = TextureStreamer::CreateTexture(image.width, image.height, image.colorChannels);
+			if (0 != fullTexture)
+			{
+				TextureStreamer::UploadImage(fullTexture, image);
+				textureID = CopyLevels(fullTexture, topLevel, internalFormat,
+					std::max(image.width >> topLevel, 1), std::max(image.height >> topLevel, 1), levelCount);
+				GPUMemory::DeleteTextures(1, &fullTexture);
+			}
+		}
+		ImageDecoder::Free(image);
+	}
+
+	if ((0 != textureID) && (NULL != m_pCompressor) &&
+		(GPUTextureCompressor::IsCompressedFormat(resident.internalFormat) == true))
+	{
+		GLuint compressed = m_pCompressor->Compress(textureID,
+			resident.internalFormat == GL_COMPRESSED_RGBA_S3TC_DXT5_EXT);
+		GPUMemory::DeleteTextures(1, &textureID);
+		textureID = compressed;
+	}
+	return(textureID);
+}
+
+/***********************************************************
+ *  Update()
+ *
+ *  This method is used for keeping the textures inside the
+ *  budget. Past it, the top level of the texture drawn
+ *  least recently is dropped until they fit, preferring
+ *  among those drawn this frame the ones their draws do not
+ *  read; a texture predicted this frame counts as drawn in
+ *  it. Inside it, the textures drawn too small for their
+ *  draws get back the levels that fit, those missing the
+ *  most levels first and a few per frame, then the ones
+ *  only predicted, those covering the most pixels first.
+ ***********************************************************/
+void TextureResidency::Update(bool bCanReplace, std::vector<REPLACED_TEXTURE>& replaced)
+{
+	size_t residentBytes = 0;
+	size_t fullBytes = 0;
+	for (size_t i = 0; i < m_textures.size(); i++)
+	{
+		residentBytes += GetResidentBytes(m_textures[i], m_textures[i].topLevel);
+		fullBytes += GetResidentBytes(m_textures[i], 0);
+	}
+
+	if ((true == bCanReplace) && (IsSupported() == true))
+	{
+		// plan the dropped levels first, so each texture is copied once
+		std::vector<int> topLevels(m_textures.size());
+		for (size_t i = 0; i < m_textures.size(); i++)
+		{
+			topLevels[i] = m_textures[i].topLevel;
+		}
+		bool bDropped = false;
+		while (residentBytes > m_budget)
+		{
+			int victim = -1;
+			for (size_t i = 0; i < m_textures.size(); i++)
+			{
+				const RESIDENT_TEXTURE& resident = m_textures[i];
+				if (CanDropLevel(resident, topLevels[i]) == false)
+				{
+					continue;
+				}
+				if (victim < 0)
+				{
+					victim = (int)i;
+					continue;
+				}
+
+				const RESIDENT_TEXTURE& other = m_textures[victim];
+				bool bUnread = (topLevels[i] < resident.neededLevel);
+				bool bOtherUnread = (topLevels[victim] < other.neededLevel);
+				unsigned long long usedFrame = std::max(resident.lastDrawnFrame, resident.lastPredictedFrame);
+				unsigned long long otherUsedFrame = std::max(other.lastDrawnFrame, other.lastPredictedFrame);
+				if ((usedFrame < otherUsedFrame) ||
+					((usedFrame == otherUsedFrame) && (bUnread == true) && (bOtherUnread == false)) ||
+					((usedFrame == otherUsedFrame) && (bUnread == bOtherUnread) &&
+						(resident.levelBytes[topLevels[i]] > other.levelBytes[topLevels[victim]])))
+				{
+					victim = (int)i;
+				}
+			}
+			if (victim < 0)
+			{
+				break;
+			}
+
+			residentBytes -= m_textures[victim].levelBytes[topLevels[victim]];
+			topLevels[victim]++;
+			bDropped = true;
+		}
+
+		for (size_t i = 0; (true == bDropped) && (i < m_textures.size()); i++)
+		{
+			RESIDENT_TEXTURE& resident = m_textures[i];
+			if (topLevels[i] == resident.topLevel)
+			{
+				continue;
+			}
+
+			const int sourceLevel = topLevels[i] - resident.topLevel;
+			REPLACED_TEXTURE texture;
+			texture.slot = (int)i;
+			texture.texture = CopyLevels(resident.texture, sourceLevel, resident.internalFormat,
+				std::max(resident.width >> topLevels[i], 1), std::max(resident.height >> topLevels[i], 1),
+				(int)resident.levelBytes.size() - topLevels[i]);
+			replaced.push_back(texture);
+			m_stats.levelsDropped += sourceLevel;
+			resident.texture = texture.texture;
+			resident.topLevel = topLevels[i];
+		}
+
+		// levels only come back when nothing had to be dropped, so a
+		// texture never loses and regains a level in one frame
+		std::vector<int> restores;
+		std::vector<int> wantedLevels(m_textures.size());
+		std::vector<bool> drawn(m_textures.size());
+		for (size_t i = 0; (false == bDropped) && (i < m_textures.size()); i++)
+		{
+			bool bDrawn = false;
+			wantedLevels[i] = GetWantedLevel(m_textures[i], bDrawn);
+			drawn[i] = bDrawn;
+			if ((wantedLevels[i] < m_textures[i].topLevel) && (m_textures[i].bLoadFailed == false))
+			{
+				restores.push_back((int)i);
+			}
+		}
+		// the drawn textures first, most missing levels first, then
+		// the predicted ones, most pixels first
+		auto restoresBefore = [this, &wantedLevels, &drawn](int slot, int other)
+		{
+			if (drawn[slot] != drawn[other])
+			{
+				return(drawn[slot] == true);
+			}
+			if (drawn[slot] == true)
+			{
+				return(m_textures[slot].topLevel - wantedLevels[slot] > m_textures[other].topLevel - wantedLevels[other]);
+			}
+			return(m_textures[slot].predictedPixels > m_textures[other].predictedPixels);
+		};
+		for (size_t i = 1; i < restores.size(); i++)
+		{
+			// insertion sort, keeping the order of equal ones
+			int slot = restores[i];
+			size_t j = i;
+			while ((j > 0) && (restoresBefore(slot, restores[j - 1]) == true))
+			{
+				restores[j] = restores[j - 1];
+				j--;
+			}
+			restores[j] = slot;
+		}
+
+		size_t restoredBytes = 0;
+		for (size_t i = 0; i < restores.size(); i++)
+		{
+			RESIDENT_TEXTURE& resident = m_textures[restores[i]];
+			const size_t currentBytes = GetResidentBytes(resident, resident.topLevel);
+			int topLevel = wantedLevels[restores[i]];
+			while ((topLevel < resident.topLevel) &&
+				(residentBytes + GetResidentBytes(resident, topLevel) - currentBytes > m_budget))
+			{
+				topLevel++;
+			}
+			if (topLevel >= resident.topLevel)
+			{
+				continue;
+			}
+			const size_t addedBytes = GetResidentBytes(resident, topLevel) - currentBytes;
+			if ((restoredBytes > 0) && (restoredBytes + addedBytes > RESTORE_BYTES_PER_FRAME))
+			{
+				break;
+			}
+
+			REPLACED_TEXTURE texture;
+			texture.slot = restores[i];
+			texture.texture = LoadLevels(resident, topLevel);
+			if (0 == texture.texture)
+			{
+				LOG_WARNING("Could not read the levels of %s back, it stays at level %d",
+					resident.sourceFilename.c_str(), resident.topLevel);
+				resident.bLoadFailed = true;
+				continue;
+			}
+			replaced.push_back(texture);
+			m_stats.levelsRestored += resident.topLevel - topLevel;
+			if (drawn[restores[i]] == false)
+			{
+				m_stats.levelsPrefetched += resident.topLevel - topLevel;
+			}
+			resident.texture = texture.texture;
+			resident.topLevel = topLevel;
+			residentBytes += addedBytes;
+			restoredBytes += addedBytes;
+		}
+	}
+
+	m_stats.residentBytes = residentBytes;
+	m_stats.fullBytes = fullBytes;
+	m_stats.peakResidentBytes = std::max(m_stats.peakResidentBytes, (unsigned long long)residentBytes);
+	m_stats.reducedTextures = 0;
+	for (size_t i = 0; i < m_textures.size(); i++)
+	{
+		m_stats.reducedTextures += (m_textures[i].topLevel > 0) ? 1 : 0;
+	}
+
+	m_frame++;
+}
@@ -0,0 +1,152 @@
+///////////////////////////////////////////////////////////////////////////////
+// textureresidency.h
+// ============
+// keep the scene textures inside a memory budget
+//
+//  Tracks the bytes of every mip level of the scene textures. Once
+//  they pass the budget, the top levels of the textures drawn least
+//  recently are dropped by copying the rest into a smaller texture,
+//  and the levels are read back from their files when a texture is
+//  drawn large enough on screen to need them and the budget allows.
+//  The draws the camera is about to see are marked as predicted, so
+//  their levels are read back before they come into view.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "TextureCache.h"
+#include "GPUTextureCompressor.h"
+
+#include <GL/glew.h>
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/***********************************************************
+ *  TextureResidency
+ *
+ *  This class contains the levels each texture slot holds,
+ *  the levels its draws need and when it was last drawn.
+ *  The textures themselves stay owned by the scene, which
+ *  swaps in the smaller or larger ones made here.
+ ***********************************************************/
+class TextureResidency
+{
+public:
+	// constructor
+	TextureResidency(TextureCache* pTextureCache);
+
+	// bytes the scene textures may take by default
+	static const size_t DEFAULT_BUDGET = 512 * 1024 * 1024;
+	// levels of this size and below are never dropped
+	static const int MIN_RESIDENT_SIZE = 64;
+	// most bytes of levels read back from the files in one frame
+	static const size_t RESTORE_BYTES_PER_FRAME = 16 * 1024 * 1024;
+
+	struct RESIDENCY_STATS
+	{
+		unsigned long long residentBytes;	// held at the last Update()
+		unsigned long long fullBytes;		// with every level of every texture
+		unsigned long long peakResidentBytes;
+		int reducedTextures;				// textures missing top levels now
+		unsigned long long levelsDropped;
+		unsigned long long levelsRestored;
+		unsigned long long levelsPrefetched;	// of them, for textures only predicted
+	};
+
+	// texture made by Update() for a slot; the scene swaps it in and
+	// deletes the one it replaces once the table no longer reads it
+	struct REPLACED_TEXTURE
+	{
+		int slot;
+		GLuint texture;
+	};
+
+	void SetBudget(size_t budgetBytes) { m_budget = budgetBytes; }
+	// compressor of the textures the scene compressed on the GPU,
+	// whose levels read back from their image files are compressed
+	// the same way
+	void SetCompressor(GPUTextureCompressor* pCompressor) { m_pCompressor = pCompressor; }
+	size_t GetBudget() const { return(m_budget); }
+
+	// true when levels can be dropped and restored: the textures
+	// have immutable storage and can be copied between
+	static bool IsSupported();
+
+	// track the texture of a slot, holding every level; the levels
+	// are read back from sourceFilename, a KTX2 or DDS file when
+	// bCompressedSource is true and an image file otherwise
+	void SetTexture(int slot, GLuint texture, const std::string& sourceFilename, bool bCompressedSource);
+	// a texture holding every level took the place of the one of a
+	// slot, like a streamed texture its placeholder
+	void ReplaceTexture(int slot, GLuint texture);
+	// stop tracking every texture
+	void Clear();
+
+	// a draw of this frame reads the texture of the slot over pixels
+	// of the screen, repeated uvScale times
+	void MarkDrawn(int slot, float pixels, float uvScale);
+	// a draw about to come into view will read the texture of the
+	// slot over pixels of the screen; it is not dropped this frame,
+	// and its levels come back after those of the drawn textures,
+	// the one covering the most pixels first
+	void MarkPredicted(int slot, float pixels, float uvScale);
+	// drop levels past the budget and read back the ones the draws
+	// need, adding the textures made for it to replaced; without
+	// bCanReplace only the bytes are counted
+	void Update(bool bCanReplace, std::vector<REPLACED_TEXTURE>& replaced);
+
+	const RESIDENCY_STATS& GetStats() const { return(m_stats); }
+
+private:
+	struct RESIDENT_TEXTURE
+	{
+		GLuint texture;
+		std::string sourceFilename;
+		bool bCompressedSource;
+		GLenum internalFormat;
+		// bytes of every level of the full mip chain
+		std::vector<size_t> levelBytes;
+		int width;				// of level 0 of the full chain
+		int height;
+		int topLevel;			// level of the full chain the texture starts at
+		int neededLevel;		// finest level the draws of the last drawn frame read
+		unsigned long long lastDrawnFrame;
+		// finest level and most pixels of the predicted draws of the
+		// last frame any was
+		int predictedLevel;
+		float predictedPixels;
+		unsigned long long lastPredictedFrame;
+		// set when the file could not be read back, so it is not
+		// read again every frame
+		bool bLoadFailed;
+	};
+
+	TextureCache* m_pTextureCache;
+	GPUTextureCompressor* m_pCompressor;
+	// tracked textures, by texture slot
+	std::vector<RESIDENT_TEXTURE> m_textures;
+	size_t m_budget;
+	// frame the draws are marked for, counted up by Update()
+	unsigned long long m_frame;
+	RESIDENCY_STATS m_stats;
+
+	// read the size, format and level bytes of a full texture
+	static void ReadLevels(RESIDENT_TEXTURE& resident);
+	// level with about as many texels across as the pixels each of
+	// uvScale repeats covers
+	static int GetLevelForPixels(const RESIDENT_TEXTURE& resident, float pixels, float uvScale);
+	// the finest level the draws of this frame read or are predicted
+	// to, and whether any of them was drawn
+	int GetWantedLevel(const RESIDENT_TEXTURE& resident, bool& bDrawn) const;
+	// bytes of the levels of a texture starting at topLevel
+	static size_t GetResidentBytes(const RESIDENT_TEXTURE& resident, int topLevel);
+	// true when the texture can lose its current top level
+	static bool CanDropLevel(const RESIDENT_TEXTURE& resident, int topLevel);
+	// new texture of the levels of the current one from topLevel
+	static GLuint CopyLevels(GLuint source, int sourceLevel, GLenum internalFormat,
+		int width, int height, int levelCount);
+	// new texture of the levels from topLevel, read from the file
+	GLuint LoadLevels(const RESIDENT_TEXTURE& resident, int topLevel);
+};
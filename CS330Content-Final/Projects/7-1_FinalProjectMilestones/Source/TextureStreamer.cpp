@@ -0,0 +1,749 @@
+///////////////////////////////////////////////////////////////////////////////
+// texturestreamer.cpp
+// ============
+// stream decoded texture images to GL over several frames
+//
+//  The scene textures start as 1x1 placeholders so the first frame
+//  does not wait for any image. The images are decoded on worker
+//  threads and copied to their textures through a small pool of
+//  pixel buffer objects, a band of rows at a time within a budget of
+//  bytes per frame, so even the largest image never stalls a frame.
+//  With a loader context, each image is uploaded whole on its thread
+//  instead, and the rendering context takes no part in it. The decoder
+//  hands over RGB images expanded to RGBA with their mip chain filled
+//  in, whose rows the driver takes as they are into immutable storage
+//  of the whole chain, a level after the other.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "TextureStreamer.h"
+#include "MipChain.h"
+#include "ShapeMeshes.h"
+#include "ScopeProfiler.h"
+#include "GPUMemory.h"
+#include "Logger.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+std::atomic<unsigned long long> TextureStreamer::s_uploads(0);
+std::atomic<unsigned long long> TextureStreamer::s_uploadBytes(0);
+std::atomic<unsigned long long> TextureStreamer::s_uploadNanoseconds(0);
+
+/***********************************************************
+ *  TextureStreamer()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+TextureStreamer::TextureStreamer()
+{
+	for (int i = 0; i < STAGING_BUFFER_COUNT; i++)
+	{
+		m_stagingBuffers[i].buffer = 0;
+		m_stagingBuffers[i].fence = 0;
+	}
+	m_nextStagingBuffer = 0;
+	m_pLoader = NULL;
+}
+
+/***********************************************************
+ *  ~TextureStreamer()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+TextureStreamer::~TextureStreamer()
+{
+	Cancel();
+	Destroy();
+}
+
+/***********************************************************
+ *  GetPixelFormat()
+ *
+ *  This method is used for getting the GL formats of the
+ *  pixels of an image with the given count of channels.
+ ***********************************************************/
+bool TextureStreamer::GetPixelFormat(int colorChannels, GLenum& internalFormat, GLenum& format)
+{
+	// if the loaded image is gray, such as a roughness map
+	if (colorChannels == 1)
+	{
+		internalFormat = GL_R8;
+		format = GL_RED;
+		return(true);
+	}
+	// if the loaded image is gray with transparency
+	if (colorChannels == 2)
+	{
+		internalFormat = GL_RG8;
+		format = GL_RG;
+		return(true);
+	}
+	// if the loaded image is in RGB format
+	if (colorChannels == 3)
+	{
+		internalFormat = GL_RGB8;
+		format = GL_RGB;
+		return(true);
+	}
+	// if the loaded image is in RGBA format - it supports transparency
+	if (colorChannels == 4)
+	{
+		internalFormat = GL_RGBA8;
+		format = GL_RGBA;
+		return(true);
+	}
+
+	internalFormat = GL_NONE;
+	format = GL_NONE;
+	return(false);
+}
+
+/***********************************************************
+ *  SetSwizzle()
+ *
+ *  This method is used for having a texture of one or two
+ *  channels read by the shaders as the RGBA it stands for:
+ *  the gray in red, green and blue, and the second channel,
+ *  if any, as alpha.
+ ***********************************************************/
+void TextureStreamer::SetSwizzle(GLuint texture, GLenum internalFormat)
+{
+	GLint swizzle[4] = { GL_RED, GL_RED, GL_RED, GL_ONE };
+	if (internalFormat == GL_RG8)
+	{
+		swizzle[3] = GL_GREEN;
+	}
+	else if (internalFormat != GL_R8)
+	{
+		return;
+	}
+
+	if (ShapeMeshes::HasDirectStateAccess() == true)
+	{
+		glTextureParameteriv(texture, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+	}
+	else
+	{
+		GLuint previousTexture = ShapeMeshes::BindTextureForEdit(GL_TEXTURE_2D, texture);
+		glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+		ShapeMeshes::RestoreTextureBinding(GL_TEXTURE_2D, previousTexture);
+	}
+}
+
+/***********************************************************
+ *  CreateTexture()
+ *
+ *  This method is used for creating a texture with storage
+ *  for an image of the given size and channels, and setting
+ *  its wrapping and filtering parameters. The pixels are
+ *  uploaded afterwards with UploadRows().
+ ***********************************************************/
+GLuint TextureStreamer::CreateTexture(int width, int height, int colorChannels)
+{
+	GLenum internalFormat = GL_NONE;
+	GLenum format = GL_NONE;
+	if (GetPixelFormat(colorChannels, internalFormat, format) == false)
+	{
+		LOG_WARNING("Not implemented to handle image with %d channels", colorChannels);
+		return(0);
+	}
+
+	const GLsizei levels = MipChain::GetLevelCount(width, height);
+
+	GLuint textureID = 0;
+	if (ShapeMeshes::HasDirectStateAccess() == true)
+	{
+		// immutable storage for the whole mip chain, filled without
+		// touching the texture bindings of the draws
+		glCreateTextures(GL_TEXTURE_2D, 1, &textureID);
+		glTextureStorage2D(textureID, levels, internalFormat, width, height);
+
+		// set the texture wrapping parameters
+		glTextureParameteri(textureID, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		glTextureParameteri(textureID, GL_TEXTURE_WRAP_T, GL_REPEAT);
+		// set texture filtering parameters
+		glTextureParameteri(textureID, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTextureParameteri(textureID, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	}
+	else
+	{
+		glGenTextures(1, &textureID);
+		GLuint previousTexture = ShapeMeshes::BindTextureForEdit(GL_TEXTURE_2D, textureID);
+
+		// set the texture wrapping parameters
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+		// set texture filtering parameters
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+		if ((GLEW_VERSION_4_2 == GL_TRUE) || (GLEW_ARB_texture_storage == GL_TRUE))
+		{
+			glTexStorage2D(GL_TEXTURE_2D, levels, internalFormat, width, height);
+		}
+		else
+		{
+			// every level is allocated, for the chains the decoder
+			// fills in as for those FinishTexture() makes
+			for (GLsizei i = 0; i < levels; i++)
+			{
+				int levelWidth = 0;
+				int levelHeight = 0;
+				MipChain::GetLevelSize(width, height, i, levelWidth, levelHeight);
+				glTexImage2D(GL_TEXTURE_2D, i, internalFormat, levelWidth, levelHeight, 0, format, GL_UNSIGNED_BYTE, NULL);
+			}
+		}
+		ShapeMeshes::RestoreTextureBinding(GL_TEXTURE_2D, previousTexture);
+	}
+	SetSwizzle(textureID, internalFormat);
+	// the owner is named once the texture is given a slot
+	GPUMemory::TrackTexture(textureID, internalFormat, width, height, 1, levels, GPUMemory::CATEGORY_TEXTURE, "texture");
+
+	return(textureID);
+}
+
+/***********************************************************
+ *  CreatePlaceholder()
+ *
+ *  This method is used for creating the 1x1 white texture a
+ *  texture slot reads until its image is streamed in, so the
+ *  draws show their color meanwhile.
+ ***********************************************************/
+GLuint TextureStreamer::CreatePlaceholder()
+{
+	const unsigned char white[4] = { 255, 255, 255, 255 };
+
+	GLuint textureID = CreateTexture(1, 1, 4);
+	if (0 != textureID)
+	{
+		UploadRows(textureID, 0, 1, 1, 4, white);
+	}
+	return(textureID);
+}
+
+/***********************************************************
+ *  UploadRows()
+ *
+ *  This method is used for copying rows of pixels into a
+ *  level of a texture, from client memory or, when a pixel
+ *  unpack buffer is bound, from an offset in it. The rows
+ *  are tightly packed, so their alignment is the largest
+ *  that divides their length, which is 4 for RGBA.
+ ***********************************************************/
+void TextureStreamer::UploadRows(GLuint texture, int firstRow, int width, int rowCount,
+	int colorChannels, const void* pixels, int level)
+{
+	GLenum internalFormat = GL_NONE;
+	GLenum format = GL_NONE;
+	GetPixelFormat(colorChannels, internalFormat, format);
+
+	const int rowBytes = width * colorChannels;
+	const bool bUnaligned = ((rowBytes % 4) != 0);
+	if (true == bUnaligned)
+	{
+		glPixelStorei(GL_UNPACK_ALIGNMENT, ((rowBytes % 2) == 0) ? 2 : 1);
+	}
+
+	long long start = ScopeProfiler::Now();
+	if (ShapeMeshes::HasDirectStateAccess() == true)
+	{
+		glTextureSubImage2D(texture, level, 0, firstRow, width, rowCount, format, GL_UNSIGNED_BYTE, pixels);
+	}
+	else
+	{
+		GLuint previousTexture = ShapeMeshes::BindTextureForEdit(GL_TEXTURE_2D, texture);
+		glTexSubImage2D(GL_TEXTURE_2D, level, 0, firstRow, width, rowCount, format, GL_UNSIGNED_BYTE, pixels);
+		ShapeMeshes::RestoreTextureBinding(GL_TEXTURE_2D, previousTexture);
+	}
+	s_uploadNanoseconds.fetch_add((unsigned long long)(ScopeProfiler::Now() - start), std::memory_order_relaxed);
+	s_uploadBytes.fetch_add((unsigned long long)rowBytes * rowCount, std::memory_order_relaxed);
+	s_uploads.fetch_add(1, std::memory_order_relaxed);
+
+	if (true == bUnaligned)
+	{
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	}
+}
+
+/***********************************************************
+ *  UploadImage()
+ *
+ *  This method is used for copying a decoded image whole
+ *  from client memory, a level at a time from the largest.
+ *  An image the decoder could not make a chain for has its
+ *  levels generated by GL instead.
+ ***********************************************************/
+void TextureStreamer::UploadImage(GLuint texture, const ImageDecoder::IMAGE& image)
+{
+	for (int i = 0; i < image.levelCount; i++)
+	{
+		int levelWidth = 0;
+		int levelHeight = 0;
+		MipChain::GetLevelSize(image.width, image.height, i, levelWidth, levelHeight);
+		UploadRows(texture, 0, levelWidth, levelHeight, image.colorChannels,
+			image.pixels + MipChain::GetLevelOffset(image.width, image.height, image.colorChannels, i), i);
+	}
+	if (image.levelCount == 1)
+	{
+		FinishTexture(texture);
+	}
+}
+
+/***********************************************************
+ *  FinishTexture()
+ *
+ *  This method is used for generating the texture mipmaps
+ *  for mapping textures to lower resolutions, once every
+ *  row of the base level is uploaded.
+ ***********************************************************/
+void TextureStreamer::FinishTexture(GLuint texture)
+{
+	if (ShapeMeshes::HasDirectStateAccess() == true)
+	{
+		glGenerateTextureMipmap(texture);
+	}
+	else
+	{
+		GLuint previousTexture = ShapeMeshes::BindTextureForEdit(GL_TEXTURE_2D, texture);
+		glGenerateMipmap(GL_TEXTURE_2D);
+		ShapeMeshes::RestoreTextureBinding(GL_TEXTURE_2D, previousTexture);
+	}
+}
+
+/***********************************************************
+ *  GetUploadStats()
+ *
+ *  This method is used for getting the pixels handed to the
+ *  driver since the launch and the time its calls took.
+ ***********************************************************/
+TextureStreamer::UPLOAD_STATS TextureStreamer::GetUploadStats()
+{
+	UPLOAD_STATS stats;
+	stats.uploads = s_uploads.load(std::memory_order_relaxed);
+	stats.bytes = s_uploadBytes.load(std::memory_order_relaxed);
+	stats.milliseconds = (double)s_uploadNanoseconds.load(std::memory_order_relaxed) / 1000000.0;
+	return(stats);
+}
+
+/***********************************************************
+ *  PrintUploadStats()
+ *
+ *  This method is used for writing the texture uploads and
+ *  the images the decoder expanded, reduced and made mip
+ *  chains of for them to the console, for the startup
+ *  report.
+ ***********************************************************/
+void TextureStreamer::PrintUploadStats()
+{
+	UPLOAD_STATS uploads = GetUploadStats();
+	ImageDecoder::EXPAND_STATS expanded = ImageDecoder::GetExpandStats();
+	printf("texture uploads %llu\t%.1f MB\tin driver %.2f ms\n",
+		uploads.uploads, (double)uploads.bytes / (1024.0 * 1024.0), uploads.milliseconds);
+	printf("rgb images expanded %llu\t%.1f Mpixels\tgray images reduced %llu\tin %.2f ms\n",
+		expanded.images, (double)expanded.pixels / 1000000.0, expanded.grayImages, expanded.milliseconds);
+	MipChain::CHAIN_STATS chains = MipChain::GetStats();
+	printf("mip chains %llu\t%llu levels\tin %.2f ms\n",
+		chains.chains, chains.levels, chains.milliseconds);
+}
+
+/***********************************************************
+ *  Start()
+ *
+ *  This method is used for starting the decode of the image
+ *  files on the worker threads.
+ ***********************************************************/
+void TextureStreamer::Start(const std::vector<std::string>& filenames, const std::vector<int>& slots, TextureCache* pCache)
+{
+	Cancel();
+
+	m_filenames = filenames;
+	m_slots = slots;
+	m_decoder.Start(m_filenames, pCache);
+}
+
+/***********************************************************
+ *  Cancel()
+ *
+ *  This method is used for stopping the decode and dropping
+ *  the images not uploaded yet, with the textures of those
+ *  that were partly uploaded. The tasks on the loader
+ *  context are waited for first, since they still write
+ *  into their textures and free their pixels.
+ ***********************************************************/
+void TextureStreamer::Cancel()
+{
+	m_decoder.Finish();
+	if (m_loading.empty() == false)
+	{
+		m_pLoader->WaitForTasks();
+		for (size_t i = 0; i < m_loading.size(); i++)
+		{
+			ImageDecoder::Free(m_loading[i]->image);
+			if (0 != m_loading[i]->texture)
+			{
+				GPUMemory::DeleteTextures(1, &m_loading[i]->texture);
+			}
+			delete m_loading[i];
+		}
+		m_loading.clear();
+	}
+	for (size_t i = 0; i < m_pending.size(); i++)
+	{
+		ImageDecoder::Free(m_pending[i].image);
+		if (0 != m_pending[i].texture)
+		{
+			GPUMemory::DeleteTextures(1, &m_pending[i].texture);
+		}
+	}
+	m_pending.clear();
+	m_filenames.clear();
+	m_slots.clear();
+}
+
+/***********************************************************
+ *  CreateStagingBuffers()
+ *
+ *  This method is used for creating the pixel unpack
+ *  buffers the rows are staged in, when first used.
+ ***********************************************************/
+bool TextureStreamer::CreateStagingBuffers()
+{
+	if (0 != m_stagingBuffers[0].buffer)
+	{
+		return(true);
+	}
+
+	for (int i = 0; i < STAGING_BUFFER_COUNT; i++)
+	{
+		glGenBuffers(1, &m_stagingBuffers[i].buffer);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_stagingBuffers[i].buffer);
+		glBufferData(GL_PIXEL_UNPACK_BUFFER, STAGING_BUFFER_SIZE, NULL, GL_STREAM_DRAW);
+		GPUMemory::TrackBuffer(m_stagingBuffers[i].buffer, STAGING_BUFFER_SIZE, GPUMemory::CATEGORY_BUFFER, "texture staging");
+	}
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	m_nextStagingBuffer = 0;
+
+	return(0 != m_stagingBuffers[0].buffer);
+}
+
+/***********************************************************
+ *  Destroy()
+ *
+ *  This method is used for deleting the staging buffers and
+ *  the fences on them.
+ ***********************************************************/
+void TextureStreamer::Destroy()
+{
+	for (int i = 0; i < STAGING_BUFFER_COUNT; i++)
+	{
+		if (0 != m_stagingBuffers[i].fence)
+		{
+			glDeleteSync(m_stagingBuffers[i].fence);
+			m_stagingBuffers[i].fence = 0;
+		}
+		if (0 != m_stagingBuffers[i].buffer)
+		{
+			GPUMemory::DeleteBuffers(1, &m_stagingBuffers[i].buffer);
+			m_stagingBuffers[i].buffer = 0;
+		}
+	}
+}
+
+/***********************************************************
+ *  UploadBand()
+ *
+ *  This method is used for copying the next rows of an image
+ *  into the next staging buffer and from there into its
+ *  texture. A staging buffer the GPU is still reading from
+ *  ends the uploads of the frame instead of waiting on it.
+ ***********************************************************/
+bool TextureStreamer::UploadBand(PENDING_IMAGE& pending, GLsizeiptr& budget)
+{
+	PROFILE_SCOPE("texture upload band");
+	int levelWidth = 0;
+	int levelHeight = 0;
+	MipChain::GetLevelSize(pending.image.width, pending.image.height, pending.uploadedLevel, levelWidth, levelHeight);
+	const GLsizeiptr rowBytes = (GLsizeiptr)levelWidth * pending.image.colorChannels;
+	if ((budget < rowBytes) && (budget < UPLOAD_BYTES_PER_FRAME))
+	{
+		return(false);
+	}
+
+	STAGING_BUFFER& staging = m_stagingBuffers[m_nextStagingBuffer];
+	if (0 != staging.fence)
+	{
+		if (glClientWaitSync(staging.fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+		{
+			return(false);
+		}
+		glDeleteSync(staging.fence);
+		staging.fence = 0;
+	}
+
+	if (0 == pending.texture)
+	{
+		pending.texture = CreateTexture(pending.image.width, pending.image.height, pending.image.colorChannels);
+		if (0 == pending.texture)
+		{
+			// the slot keeps its placeholder
+			pending.uploadedLevel = pending.image.levelCount;
+			return(true);
+		}
+	}
+
+	int rowCount = (int)(std::min(STAGING_BUFFER_SIZE, budget) / rowBytes);
+	rowCount = std::max(std::min(rowCount, levelHeight - pending.uploadedRows), 1);
+	const GLsizeiptr bandBytes = rowCount * rowBytes;
+	const unsigned char* pRows = pending.image.pixels + MipChain::GetLevelOffset(pending.image.width,
+		pending.image.height, pending.image.colorChannels, pending.uploadedLevel) + pending.uploadedRows * rowBytes;
+
+	void* pStaging = NULL;
+	if (bandBytes <= STAGING_BUFFER_SIZE)
+	{
+		// the fence above makes the buffer free, so mapping needs
+		// no synchronization of its own
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, staging.buffer);
+		pStaging = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, bandBytes,
+			GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+	}
+	if (NULL != pStaging)
+	{
+		memcpy(pStaging, pRows, bandBytes);
+		glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+		UploadRows(pending.texture, pending.uploadedRows, levelWidth, rowCount,
+			pending.image.colorChannels, (const void*)0, pending.uploadedLevel);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+		staging.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		m_nextStagingBuffer = (m_nextStagingBuffer + 1) % STAGING_BUFFER_COUNT;
+	}
+	else
+	{
+		// a row wider than a staging buffer, or one that could not
+		// be mapped, is copied from client memory
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		UploadRows(pending.texture, pending.uploadedRows, levelWidth, rowCount,
+			pending.image.colorChannels, pRows, pending.uploadedLevel);
+	}
+
+	pending.uploadedRows += rowCount;
+	if (pending.uploadedRows >= levelHeight)
+	{
+		pending.uploadedLevel++;
+		pending.uploadedRows = 0;
+	}
+	budget -= bandBytes;
+
+	return(true);
+}
+
+/***********************************************************
+ *  Update()
+ *
+ *  This method is used for taking the images the workers
+ *  decoded and uploading them in bands until the budget of
+ *  the frame is spent, the levels of an image one after the
+ *  other. An image without its chain has its mipmaps made in
+ *  the frame its last band is uploaded.
+ ***********************************************************/
+void TextureStreamer::Update(std::vector<STREAMED_TEXTURE>& completed)
+{
+	if (IsBusy() == false)
+	{
+		return;
+	}
+
+	int fileIndex = -1;
+	ImageDecoder::IMAGE image;
+	while (m_decoder.TakeReady(fileIndex, image) == true)
+	{
+		if (NULL == image.pixels)
+		{
+			LOG_WARNING("Could not load image:%s", m_filenames[fileIndex].c_str());
+
+			STREAMED_TEXTURE streamed;
+			streamed.slot = m_slots[fileIndex];
+			streamed.texture = 0;
+			completed.push_back(streamed);
+			continue;
+		}
+
+		if ((NULL != m_pLoader) && (m_pLoader->IsAvailable() == true))
+		{
+			SubmitUpload(fileIndex, image);
+			continue;
+		}
+
+		PENDING_IMAGE pending;
+		pending.fileIndex = fileIndex;
+		pending.image = image;
+		pending.texture = 0;
+		pending.uploadedLevel = 0;
+		pending.uploadedRows = 0;
+		m_pending.push_back(pending);
+	}
+
+	CompleteUploads(completed);
+	if ((m_pending.empty() == true) || (CreateStagingBuffers() == false))
+	{
+		std::fill(m_slotCoverage.begin(), m_slotCoverage.end(), 0.0f);
+		return;
+	}
+	PickNextImage();
+	std::fill(m_slotCoverage.begin(), m_slotCoverage.end(), 0.0f);
+
+	GLsizeiptr budget = UPLOAD_BYTES_PER_FRAME;
+	while ((m_pending.empty() == false) && (UploadBand(m_pending.front(), budget) == true))
+	{
+		PENDING_IMAGE& pending = m_pending.front();
+		if (pending.uploadedLevel < pending.image.levelCount)
+		{
+			continue;
+		}
+
+		if (0 != pending.texture)
+		{
+			if (pending.image.levelCount == 1)
+			{
+				FinishTexture(pending.texture);
+			}
+			LOG_INFO("Successfully loaded image:%s, width:%d, height:%d, channels:%d", m_filenames[pending.fileIndex].c_str(),
+				pending.image.width, pending.image.height, pending.image.colorChannels);
+		}
+
+		STREAMED_TEXTURE streamed;
+		streamed.slot = m_slots[pending.fileIndex];
+		streamed.texture = pending.texture;
+		completed.push_back(streamed);
+
+		// free the image data from local memory
+		ImageDecoder::Free(pending.image);
+		m_pending.erase(m_pending.begin());
+	}
+}
+
+/***********************************************************
+ *  SetCoverage()
+ *
+ *  This method is used for noting how many pixels the draws
+ *  of a texture slot cover this frame, or are predicted to
+ *  cover soon, keeping the largest.
+ ***********************************************************/
+void TextureStreamer::SetCoverage(int slot, float pixels)
+{
+	if (slot < 0)
+	{
+		return;
+	}
+	if (slot >= (int)m_slotCoverage.size())
+	{
+		m_slotCoverage.resize(slot + 1, 0.0f);
+	}
+	m_slotCoverage[slot] = std::max(m_slotCoverage[slot], pixels);
+}
+
+/***********************************************************
+ *  PickNextImage()
+ *
+ *  This method is used for uploading the decoded image of
+ *  the largest coverage next, so a texture coming into view
+ *  replaces its placeholder before those off screen. An
+ *  image partly uploaded is finished first, and the others
+ *  keep the order they were decoded in.
+ ***********************************************************/
+void TextureStreamer::PickNextImage()
+{
+	if ((m_pending.size() < 2) || (m_pending.front().uploadedLevel > 0) || (m_pending.front().uploadedRows > 0))
+	{
+		return;
+	}
+
+	size_t best = 0;
+	float bestCoverage = 0.0f;
+	for (size_t i = 0; i < m_pending.size(); i++)
+	{
+		int slot = m_slots[m_pending[i].fileIndex];
+		float coverage = ((slot >= 0) && (slot < (int)m_slotCoverage.size())) ? m_slotCoverage[slot] : 0.0f;
+		if (coverage > bestCoverage)
+		{
+			best = i;
+			bestCoverage = coverage;
+		}
+	}
+	std::rotate(m_pending.begin(), m_pending.begin() + best, m_pending.begin() + best + 1);
+}
+
+/***********************************************************
+ *  SubmitUpload()
+ *
+ *  This method is used for handing a decoded image to the
+ *  loader context, which creates its texture, copies every
+ *  level from client memory at once and frees the pixels,
+ *  all on the loader thread.
+ ***********************************************************/
+void TextureStreamer::SubmitUpload(int fileIndex, const ImageDecoder::IMAGE& image)
+{
+	LOADER_UPLOAD* pUpload = new LOADER_UPLOAD();
+	pUpload->fileIndex = fileIndex;
+	pUpload->image = image;
+	pUpload->width = image.width;
+	pUpload->height = image.height;
+	pUpload->colorChannels = image.colorChannels;
+	pUpload->texture = 0;
+	pUpload->taskID = m_pLoader->Submit([pUpload]() {
+		PROFILE_SCOPE("texture upload");
+		pUpload->texture = CreateTexture(pUpload->width, pUpload->height, pUpload->colorChannels);
+		if (0 != pUpload->texture)
+		{
+			UploadImage(pUpload->texture, pUpload->image);
+		}
+		// the copy is made by the time the upload returns
+		ImageDecoder::Free(pUpload->image);
+	});
+	m_loading.push_back(pUpload);
+}
+
+/***********************************************************
+ *  CompleteUploads()
+ *
+ *  This method is used for taking the textures whose loader
+ *  tasks finished on the GPU, which the rendering context
+ *  may sample from now on.
+ ***********************************************************/
+void TextureStreamer::CompleteUploads(std::vector<STREAMED_TEXTURE>& completed)
+{
+	if (m_loading.empty() == true)
+	{
+		return;
+	}
+
+	std::vector<unsigned long long> finished;
+	m_pLoader->Poll(finished);
+	for (size_t f = 0; f < finished.size(); f++)
+	{
+		for (size_t i = 0; i < m_loading.size(); i++)
+		{
+			LOADER_UPLOAD* pUpload = m_loading[i];
+			if (pUpload->taskID != finished[f])
+			{
+				continue;
+			}
+
+			if (0 != pUpload->texture)
+			{
+				LOG_INFO("Successfully loaded image:%s, width:%d, height:%d, channels:%d", m_filenames[pUpload->fileIndex].c_str(),
+					pUpload->width, pUpload->height, pUpload->colorChannels);
+			}
+
+			STREAMED_TEXTURE streamed;
+			streamed.slot = m_slots[pUpload->fileIndex];
+			streamed.texture = pUpload->texture;
+			completed.push_back(streamed);
+
+			delete pUpload;
+			m_loading.erase(m_loading.begin() + i);
+			break;
+		}
+	}
+}
@@ -0,0 +1,172 @@
+///////////////////////////////////////////////////////////////////////////////
+// texturestreamer.h
+// ============
+// stream decoded texture images to GL over several frames
+//
+//  The scene textures start as 1x1 placeholders so the first frame
+//  does not wait for any image. The images are decoded on worker
+//  threads and copied to their textures through a small pool of
+//  pixel buffer objects, a band of rows at a time within a budget of
+//  bytes per frame, so even the largest image never stalls a frame.
+//  With a loader context, each image is uploaded whole on its thread
+//  instead, and the rendering context takes no part in it.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "ImageDecoder.h"
+#include "LoaderContext.h"
+
+#include <GL/glew.h>
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+/***********************************************************
+ *  TextureStreamer
+ *
+ *  This class contains the decoder of the streamed images,
+ *  the images waiting for their upload and the staging
+ *  buffers their rows are copied through.
+ ***********************************************************/
+class TextureStreamer
+{
+public:
+	// constructor
+	TextureStreamer();
+	// destructor
+	~TextureStreamer();
+
+	// staging buffers a band of rows is copied through; a buffer is
+	// only written again once the GPU has read the last band in it
+	static const int STAGING_BUFFER_COUNT = 3;
+	static const GLsizeiptr STAGING_BUFFER_SIZE = 4 * 1024 * 1024;
+	// most bytes of pixels copied for the textures in one frame
+	static const GLsizeiptr UPLOAD_BYTES_PER_FRAME = 8 * 1024 * 1024;
+
+	// pixels handed to the driver since the launch, on any thread;
+	// the time is that spent in the upload calls, where a driver
+	// converts pixels it does not take as they are
+	struct UPLOAD_STATS
+	{
+		unsigned long long uploads;
+		unsigned long long bytes;
+		double milliseconds;
+	};
+
+	// texture whose pixels were all uploaded, for the texture slot
+	// it was started for; texture is 0 when the image could not be
+	// decoded and the slot keeps its placeholder
+	struct STREAMED_TEXTURE
+	{
+		int slot;
+		GLuint texture;
+	};
+
+	// start decoding the files, each for the texture slot at the
+	// same index, writing the decoded images into the cache, if any
+	void Start(const std::vector<std::string>& filenames, const std::vector<int>& slots, TextureCache* pCache = NULL);
+	// upload the decoded images within the budget of the frame,
+	// adding the textures finished in it to completed
+	void Update(std::vector<STREAMED_TEXTURE>& completed);
+	// pixels on screen the draws of a texture slot cover now or are
+	// about to; of the decoded images waiting for their upload, the
+	// one covering the most goes next. Cleared by every Update()
+	void SetCoverage(int slot, float pixels);
+	// drop the images not streamed yet and their textures
+	void Cancel();
+	// delete the staging buffers
+	void Destroy();
+	// true while images are decoded or uploaded
+	bool IsBusy() const { return((m_decoder.IsDone() == false) || (m_pending.empty() == false) || (m_loading.empty() == false)); }
+	// images decoded and waiting for their upload, or uploading
+	size_t GetQueueDepth() const { return(m_pending.size() + m_loading.size()); }
+	// upload the images on the loader context, when it is available,
+	// rather than in bands on the rendering one; NULL to stop
+	void SetLoaderContext(LoaderContext* pLoader) { m_pLoader = pLoader; }
+
+	// GL formats of an image with the channel count, false when the
+	// count is not supported
+	static bool GetPixelFormat(int colorChannels, GLenum& internalFormat, GLenum& format);
+	// make a gray texture, and one of gray and alpha, read as RGBA
+	// through its swizzle; other formats are left as they are
+	static void SetSwizzle(GLuint texture, GLenum internalFormat);
+	// texture with storage for an image and every mip level
+	static GLuint CreateTexture(int width, int height, int colorChannels);
+	// 1x1 white texture standing in for one that is streamed
+	static GLuint CreatePlaceholder();
+	// copy rows of pixels into a level of a texture, the base one
+	// unless told; pixels is an offset into the bound pixel unpack
+	// buffer, if any
+	static void UploadRows(GLuint texture, int firstRow, int width, int rowCount,
+		int colorChannels, const void* pixels, int level = 0);
+	// copy every level a decoded image holds into its texture, and
+	// generate the levels below when it holds only the base one
+	static void UploadImage(GLuint texture, const ImageDecoder::IMAGE& image);
+	// generate the mip levels once the base level is complete
+	static void FinishTexture(GLuint texture);
+
+	static UPLOAD_STATS GetUploadStats();
+	// print the uploads and the RGB images expanded and the mip
+	// chains made for them, for the startup report
+	static void PrintUploadStats();
+
+private:
+	static std::atomic<unsigned long long> s_uploads;
+	static std::atomic<unsigned long long> s_uploadBytes;
+	static std::atomic<unsigned long long> s_uploadNanoseconds;
+
+	struct STAGING_BUFFER
+	{
+		GLuint buffer;
+		GLsync fence;
+	};
+
+	// decoded image and how far its upload got
+	struct PENDING_IMAGE
+	{
+		int fileIndex;
+		ImageDecoder::IMAGE image;
+		GLuint texture;
+		int uploadedLevel;
+		int uploadedRows;		// of uploadedLevel
+	};
+	// image handed whole to the loader context; the task writes the
+	// texture and frees the pixels
+	struct LOADER_UPLOAD
+	{
+		unsigned long long taskID;
+		int fileIndex;
+		ImageDecoder::IMAGE image;
+		int width;
+		int height;
+		int colorChannels;
+		GLuint texture;
+	};
+
+	ImageDecoder m_decoder;
+	std::vector<std::string> m_filenames;
+	std::vector<int> m_slots;
+	// decoded images in the order they are uploaded
+	std::vector<PENDING_IMAGE> m_pending;
+	STAGING_BUFFER m_stagingBuffers[STAGING_BUFFER_COUNT];
+	int m_nextStagingBuffer;
+	LoaderContext* m_pLoader;
+	// images on the loader context, in the order they were submitted
+	std::vector<LOADER_UPLOAD*> m_loading;
+	// SetCoverage() of each slot since the last Update()
+	std::vector<float> m_slotCoverage;
+
+	bool CreateStagingBuffers();
+	// move the waiting image covering the most pixels to the front,
+	// unless the front one is partly uploaded
+	void PickNextImage();
+	// hand a decoded image to the loader context
+	void SubmitUpload(int fileIndex, const ImageDecoder::IMAGE& image);
+	// add the textures whose loader tasks finished to completed
+	void CompleteUploads(std::vector<STREAMED_TEXTURE>& completed);
+	// upload the next band of rows of an image; false when there is
+	// no budget left or no staging buffer is free this frame
+	bool UploadBand(PENDING_IMAGE& pending, GLsizeiptr& budget);
+};
@@ -0,0 +1,510 @@
+///////////////////////////////////////////////////////////////////////////////
+// texturetable.cpp
+// ============
+// table of every scene texture, read by index in the shaders
+//
+//  With bindless textures each texture gets a resident handle in the
+//  TextureData uniform block; without them the textures are packed
+//  into the layers of one texture array, and the block holds the
+//  layer and rectangle of each. Either way a draw selects its texture
+//  with an index in its instance data, so no sampler uniform or
+//  texture binding changes between draws. The filtering of every
+//  texture comes from one sampler object per filter quality, shared
+//  by all of them, so the quality can change while the scene runs.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "TextureTable.h"
+#include "ShapeMeshes.h"
+#include "VirtualTextures.h"
+#include "GPUMemory.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+namespace
+{
+	/***********************************************************
+	 *  CeilPowerOfTwo()
+	 *
+	 *  This function is used for rounding a size up to the next
+	 *  power of two, so packed tiles keep their mip levels apart.
+	 ***********************************************************/
+	int CeilPowerOfTwo(int size)
+	{
+		int power = 1;
+		while (power < size)
+		{
+			power <<= 1;
+		}
+		return(power);
+	}
+
+	/***********************************************************
+	 *  IsLargerTile()
+	 *
+	 *  This function is used for ordering the tiles tallest
+	 *  first, and widest first among tiles of one height.
+	 ***********************************************************/
+	template <typename TILE>
+	bool IsLargerTile(const TILE& first, const TILE& second)
+	{
+		if (first.height != second.height)
+		{
+			return(first.height > second.height);
+		}
+		if (first.width != second.width)
+		{
+			return(first.width > second.width);
+		}
+		return(first.textureIndex < second.textureIndex);
+	}
+}
+
+/***********************************************************
+ *  TextureTable()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+TextureTable::TextureTable(ShaderManager* pShaderManager)
+{
+	m_pShaderManager = pShaderManager;
+	m_pVirtualTextures = NULL;
+	m_bBindless = false;
+	m_textureCount = 0;
+	m_filterQuality = FILTER_QUALITY_ANISOTROPIC_4X;
+	memset(m_samplers, 0, sizeof(m_samplers));
+	m_textureDataUBO = 0;
+	m_textureArray = 0;
+	m_layerCount = 0;
+	m_layerSize = 0;
+}
+
+/***********************************************************
+ *  ~TextureTable()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+TextureTable::~TextureTable()
+{
+	Clear();
+	for (int i = 0; i < FILTER_QUALITY_COUNT; i++)
+	{
+		glDeleteSamplers(2, m_samplers[i]);
+	}
+	m_pShaderManager = NULL;
+}
+
+/***********************************************************
+ *  Clear()
+ *
+ *  This method is used for making the handles non-resident
+ *  and deleting the handle buffer and the texture array.
+ ***********************************************************/
+void TextureTable::Clear()
+{
+	for (size_t i = 0; i < m_handles.size(); i++)
+	{
+		glMakeTextureHandleNonResidentARB(m_handles[i]);
+	}
+	m_handles.clear();
+
+	if (0 != m_textureDataUBO)
+	{
+		GPUMemory::DeleteBuffers(1, &m_textureDataUBO);
+		m_textureDataUBO = 0;
+	}
+	if (0 != m_textureArray)
+	{
+		if (NULL != m_pShaderManager)
+		{
+			m_pShaderManager->BindTexture(TEXTURE_ARRAY_UNIT, 0, GL_TEXTURE_2D_ARRAY);
+		}
+		glBindSampler(TEXTURE_ARRAY_UNIT, 0);
+		GPUMemory::DeleteTextures(1, &m_textureArray);
+		m_textureArray = 0;
+	}
+	m_layerCount = 0;
+	m_layerSize = 0;
+	m_bBindless = false;
+	m_textureCount = 0;
+	m_textures.clear();
+}
+
+/***********************************************************
+ *  Build()
+ *
+ *  This method is used for making the passed in textures
+ *  readable by their index in the list, through resident
+ *  handles when bindless textures are supported and through
+ *  the texture array otherwise.
+ ***********************************************************/
+bool TextureTable::Build(const std::vector<GLuint>& textures)
+{
+	Clear();
+
+	if (textures.empty())
+	{
+		return(true);
+	}
+	if (textures.size() > (size_t)MAX_TEXTURES)
+	{
+		std::cout << "Scene has " << textures.size() << " textures, the texture table holds " << MAX_TEXTURES << std::endl;
+		return(false);
+	}
+
+	bool bSuccess = false;
+	if (GLEW_ARB_bindless_texture == GL_TRUE)
+	{
+		bSuccess = BuildHandles(textures);
+		if (false == bSuccess)
+		{
+			std::cout << "Could not make the texture handles resident, using a texture array" << std::endl;
+			Clear();
+		}
+	}
+	if (false == bSuccess)
+	{
+		bSuccess = BuildTextureArray(textures);
+	}
+	if (true == bSuccess)
+	{
+		m_textureCount = (int)textures.size();
+		m_textures = textures;
+	}
+
+	return(bSuccess);
+}
+
+/***********************************************************
+ *  SetFilterQuality()
+ *
+ *  This method is used for switching the filtering of every
+ *  texture. The texture array reads the sampler bound with
+ *  it, while a bindless handle has the sampler built in, so
+ *  the handles are made again for the new one.
+ ***********************************************************/
+void TextureTable::SetFilterQuality(int quality)
+{
+	quality = glm::clamp(quality, 0, (int)FILTER_QUALITY_COUNT - 1);
+	if (quality == m_filterQuality)
+	{
+		return;
+	}
+	m_filterQuality = quality;
+
+	if (true == m_bBindless)
+	{
+		std::vector<GLuint> textures(m_textures);
+		if (Build(textures) == false)
+		{
+			std::cout << "Could not build the texture table for the new filter quality" << std::endl;
+		}
+	}
+}
+
+/***********************************************************
+ *  GetSampler()
+ *
+ *  This method is used for getting the sampler object of the
+ *  current filter quality, creating it on first use. The
+ *  anisotropic qualities are clamped to what the GPU offers,
+ *  and are trilinear where it offers no anisotropy.
+ ***********************************************************/
+GLuint TextureTable::GetSampler(bool bRepeat)
+{
+	GLuint& sampler = m_samplers[m_filterQuality][(true == bRepeat) ? 1 : 0];
+	if (0 != sampler)
+	{
+		return(sampler);
+	}
+
+	glGenSamplers(1, &sampler);
+	const GLint wrap = (true == bRepeat) ? GL_REPEAT : GL_CLAMP_TO_EDGE;
+	glSamplerParameteri(sampler, GL_TEXTURE_WRAP_S, wrap);
+	glSamplerParameteri(sampler, GL_TEXTURE_WRAP_T, wrap);
+	glSamplerParameteri(sampler, GL_TEXTURE_MIN_FILTER,
+		(m_filterQuality == FILTER_QUALITY_BILINEAR) ? GL_LINEAR : GL_LINEAR_MIPMAP_LINEAR);
+	glSamplerParameteri(sampler, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+	float anisotropy = 1.0f;
+	if (m_filterQuality == FILTER_QUALITY_ANISOTROPIC_4X)
+	{
+		anisotropy = 4.0f;
+	}
+	else if (m_filterQuality == FILTER_QUALITY_ANISOTROPIC_16X)
+	{
+		anisotropy = 16.0f;
+	}
+	if ((anisotropy > 1.0f) && ((GLEW_VERSION_4_6 == GL_TRUE) ||
+		(GLEW_ARB_texture_filter_anisotropic == GL_TRUE) || (GLEW_EXT_texture_filter_anisotropic == GL_TRUE)))
+	{
+		GLfloat maxAnisotropy = 1.0f;
+		glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY, &maxAnisotropy);
+		glSamplerParameterf(sampler, GL_TEXTURE_MAX_ANISOTROPY, glm::min(anisotropy, (float)maxAnisotropy));
+	}
+
+	return(sampler);
+}
+
+/***********************************************************
+ *  BuildHandles()
+ *
+ *  This method is used for making a handle of every texture
+ *  resident and uploading the handles to the TextureData
+ *  block. Each handle pairs a texture with the sampler of
+ *  the filter quality, and a texture with a handle can no
+ *  longer change its parameters, which the scene textures
+ *  never do.
+ ***********************************************************/
+bool TextureTable::BuildHandles(const std::vector<GLuint>& textures)
+{
+	std::vector<TEXTURE_HANDLE> textureData(MAX_TEXTURES);
+	for (size_t i = 0; i < textureData.size(); i++)
+	{
+		textureData[i].handle = 0;
+		textureData[i].virtualIndex = 0;
+		textureData[i].padding = 0;
+	}
+
+	// the sampler replaces the filtering set on the textures
+	const GLuint sampler = GetSampler(true);
+
+	for (size_t i = 0; i < textures.size(); i++)
+	{
+		GLuint64 handle = glGetTextureSamplerHandleARB(textures[i], sampler);
+		if (0 == handle)
+		{
+			return(false);
+		}
+		glMakeTextureHandleResidentARB(handle);
+		m_handles.push_back(handle);
+		textureData[i].handle = handle;
+		if (NULL != m_pVirtualTextures)
+		{
+			textureData[i].virtualIndex = (GLuint)(m_pVirtualTextures->FindTexture(textures[i]) + 1);
+		}
+	}
+
+	m_textureDataUBO = ShapeMeshes::CreateStaticBuffer(
+		sizeof(TEXTURE_HANDLE) * textureData.size(), &textureData[0], "texture table handles",
+		GPUMemory::CATEGORY_BUFFER);
+
+	m_bBindless = true;
+	return(true);
+}
+
+/***********************************************************
+ *  PackTiles()
+ *
+ *  This method is used for placing power of two tiles into
+ *  shelves of square layers. Taken tallest first, a shelf
+ *  only holds tiles of its height, widest first, so every
+ *  tile starts on a multiple of its own size and its mip
+ *  levels never mix texels of a neighbour above 1x1.
+ ***********************************************************/
+int TextureTable::PackTiles(std::vector<TEXTURE_TILE>& tiles, int layerSize)
+{
+	std::sort(tiles.begin(), tiles.end(), IsLargerTile<TEXTURE_TILE>);
+
+	int layer = 0;
+	int shelfY = 0;
+	int shelfHeight = 0;
+	int shelfX = 0;
+	for (size_t i = 0; i < tiles.size(); i++)
+	{
+		TEXTURE_TILE& tile = tiles[i];
+		if ((tile.height != shelfHeight) || (shelfX + tile.width > layerSize))
+		{
+			// open a new shelf, in a new layer when this one is full
+			shelfY += shelfHeight;
+			if (shelfY + tile.height > layerSize)
+			{
+				layer++;
+				shelfY = 0;
+			}
+			shelfHeight = tile.height;
+			shelfX = 0;
+		}
+
+		tile.layer = layer;
+		tile.x = shelfX;
+		tile.y = shelfY;
+		shelfX += tile.width;
+	}
+
+	return(tiles.empty() ? 0 : (layer + 1));
+}
+
+/***********************************************************
+ *  BuildTextureArray()
+ *
+ *  This method is used for packing the textures into the
+ *  layers of the texture array. Every texture is resampled
+ *  to a power of two tile no larger than a layer, converted
+ *  to RGBA8 by a filtered blit, and small ones share layers
+ *  like an atlas. The TextureData block gets the layer and
+ *  rectangle of each, for the shader to wrap its UVs in.
+ ***********************************************************/
+bool TextureTable::BuildTextureArray(const std::vector<GLuint>& textures)
+{
+	GLint maxTextureSize = 0;
+	glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTextureSize);
+	const int maxLayerSize = glm::min((int)MAX_TEXTURE_ARRAY_LAYER_SIZE, (int)maxTextureSize);
+
+	// size every tile from its texture, and the layers from the largest
+	std::vector<TEXTURE_TILE> tiles(textures.size());
+	std::vector<glm::ivec2> textureSizes(textures.size());
+	std::vector<GLint> textureChannels(textures.size());
+	const bool bDirectStateAccess = ShapeMeshes::HasDirectStateAccess();
+	m_layerSize = 1;
+	m_pShaderManager->SetActiveTextureUnit(TEXTURE_ARRAY_UNIT);
+	for (size_t i = 0; i < textures.size(); i++)
+	{
+		GLint width = 0;
+		GLint height = 0;
+		GLint internalFormat = 0;
+		if (true == bDirectStateAccess)
+		{
+			glGetTextureLevelParameteriv(textures[i], 0, GL_TEXTURE_WIDTH, &width);
+			glGetTextureLevelParameteriv(textures[i], 0, GL_TEXTURE_HEIGHT, &height);
+			glGetTextureLevelParameteriv(textures[i], 0, GL_TEXTURE_INTERNAL_FORMAT, &internalFormat);
+		}
+		else
+		{
+			GLuint previousTexture = ShapeMeshes::BindTextureForEdit(GL_TEXTURE_2D, textures[i]);
+			glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &width);
+			glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &height);
+			glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_INTERNAL_FORMAT, &internalFormat);
+			ShapeMeshes::RestoreTextureBinding(GL_TEXTURE_2D, previousTexture);
+		}
+		textureSizes[i] = glm::ivec2(width, height);
+		textureChannels[i] = (internalFormat == GL_R8) ? 1 : ((internalFormat == GL_RG8) ? 2 : 4);
+
+		tiles[i].textureIndex = (int)i;
+		tiles[i].width = glm::min(CeilPowerOfTwo(width), maxLayerSize);
+		tiles[i].height = glm::min(CeilPowerOfTwo(height), maxLayerSize);
+		m_layerSize = glm::max(m_layerSize, glm::max(tiles[i].width, tiles[i].height));
+	}
+
+	m_layerCount = PackTiles(tiles, m_layerSize);
+
+	// the shader wraps the UVs inside each tile itself
+	GLsizei levels = 1;
+	while ((m_layerSize >> levels) != 0)
+	{
+		levels++;
+	}
+	if (true == bDirectStateAccess)
+	{
+		glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, &m_textureArray);
+		glTextureStorage3D(m_textureArray, levels, GL_RGBA8, m_layerSize, m_layerSize, m_layerCount);
+		glTextureParameteri(m_textureArray, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTextureParameteri(m_textureArray, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTextureParameteri(m_textureArray, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glTextureParameteri(m_textureArray, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	}
+	else
+	{
+		glGenTextures(1, &m_textureArray);
+		m_pShaderManager->BindTexture(TEXTURE_ARRAY_UNIT, m_textureArray, GL_TEXTURE_2D_ARRAY);
+		glTexImage3D(
+			GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8,
+			m_layerSize, m_layerSize, m_layerCount,
+			0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	}
+	// the levels below the first are generated once the tiles are in
+	GPUMemory::TrackTexture(m_textureArray, GL_RGBA8, m_layerSize, m_layerSize, m_layerCount, levels,
+		GPUMemory::CATEGORY_TEXTURE, "texture array");
+
+	GLuint framebuffers[2] = { 0, 0 };
+	glGenFramebuffers(2, framebuffers);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffers[0]);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffers[1]);
+
+	std::vector<TEXTURE_LAYER> textureData(MAX_TEXTURES);
+	memset(&textureData[0], 0, sizeof(TEXTURE_LAYER) * textureData.size());
+
+	bool bSuccess = true;
+	for (size_t i = 0; (i < tiles.size()) && (true == bSuccess); i++)
+	{
+		const TEXTURE_TILE& tile = tiles[i];
+		const glm::ivec2& textureSize = textureSizes[tile.textureIndex];
+
+		glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, textures[tile.textureIndex], 0);
+		glFramebufferTextureLayer(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, m_textureArray, 0, tile.layer);
+		if ((glCheckFramebufferStatus(GL_READ_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) ||
+			(glCheckFramebufferStatus(GL_DRAW_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE))
+		{
+			std::cout << "Could not copy texture " << tile.textureIndex << " into the texture array" << std::endl;
+			bSuccess = false;
+		}
+		else
+		{
+			glBlitFramebuffer(
+				0, 0, textureSize.x, textureSize.y,
+				tile.x, tile.y, tile.x + tile.width, tile.y + tile.height,
+				GL_COLOR_BUFFER_BIT, GL_LINEAR);
+		}
+
+		TEXTURE_LAYER& entry = textureData[tile.textureIndex];
+		entry.rect = glm::vec4(
+			(float)tile.x / (float)m_layerSize, (float)tile.y / (float)m_layerSize,
+			(float)tile.width / (float)m_layerSize, (float)tile.height / (float)m_layerSize);
+		entry.layer = tile.layer;
+		entry.channels = textureChannels[tile.textureIndex];
+	}
+
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+	glDeleteFramebuffers(2, framebuffers);
+
+	if (true == bSuccess)
+	{
+		if (true == bDirectStateAccess)
+		{
+			glGenerateTextureMipmap(m_textureArray);
+		}
+		else
+		{
+			m_pShaderManager->BindTexture(TEXTURE_ARRAY_UNIT, m_textureArray, GL_TEXTURE_2D_ARRAY);
+			m_pShaderManager->SetActiveTextureUnit(TEXTURE_ARRAY_UNIT);
+			glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+		}
+
+		m_textureDataUBO = ShapeMeshes::CreateStaticBuffer(
+			sizeof(TEXTURE_LAYER) * textureData.size(), &textureData[0], "texture table layers",
+			GPUMemory::CATEGORY_BUFFER);
+	}
+
+	return(bSuccess);
+}
+
+/***********************************************************
+ *  Bind()
+ *
+ *  This method is used for binding the TextureData block,
+ *  with the page tables of the virtual textures among the
+ *  handles, or the texture array it points into without
+ *  bindless textures.
+ ***********************************************************/
+void TextureTable::Bind()
+{
+	if (0 != m_textureDataUBO)
+	{
+		glBindBufferBase(GL_UNIFORM_BUFFER, ShaderManager::TEXTURE_DATA_BINDING, m_textureDataUBO);
+	}
+	if ((true == m_bBindless) && (NULL != m_pVirtualTextures))
+	{
+		m_pVirtualTextures->Bind();
+	}
+	if (0 != m_textureArray)
+	{
+		m_pShaderManager->BindTexture(TEXTURE_ARRAY_UNIT, m_textureArray, GL_TEXTURE_2D_ARRAY);
+		glBindSampler(TEXTURE_ARRAY_UNIT, GetSampler(false));
+	}
+}
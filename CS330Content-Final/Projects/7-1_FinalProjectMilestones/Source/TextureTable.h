@@ -0,0 +1,143 @@
+///////////////////////////////////////////////////////////////////////////////
+// texturetable.h
+// ============
+// table of every scene texture, read by index in the shaders
+//
+//  With bindless textures each texture gets a resident handle in the
+//  TextureData uniform block; without them the textures are packed
+//  into the layers of one texture array, and the block holds the
+//  layer and rectangle of each. Either way a draw selects its texture
+//  with an index in its instance data, so no sampler uniform or
+//  texture binding changes between draws. The filtering of every
+//  texture comes from one sampler object per filter quality, shared
+//  by all of them, so the quality can change while the scene runs.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "ShaderManager.h"
+
+#include <vector>
+
+class VirtualTextures;
+
+/***********************************************************
+ *  TextureTable
+ *
+ *  This class contains the resident handles, or the texture
+ *  array standing in for them, of the textures loaded by the
+ *  scene. The textures themselves stay owned by the scene.
+ ***********************************************************/
+class TextureTable
+{
+public:
+	// constructor
+	TextureTable(ShaderManager* pShaderManager);
+	// destructor
+	~TextureTable();
+
+	// capacity of the TextureData block, must match the fragment shader
+	static const int MAX_TEXTURES = 256;
+	// texture unit of the texture array fallback, above the shadow atlas
+	static const int TEXTURE_ARRAY_UNIT = 25;
+	// largest texture array layer, in texels; bigger textures are
+	// resampled down to it
+	static const int MAX_TEXTURE_ARRAY_LAYER_SIZE = 2048;
+
+	// filtering of the scene textures, from least texture bandwidth
+	// to sharpest at grazing angles
+	enum FILTER_QUALITY
+	{
+		FILTER_QUALITY_BILINEAR = 0,		// base level only
+		FILTER_QUALITY_TRILINEAR,			// blend of the two nearest mip levels
+		FILTER_QUALITY_ANISOTROPIC_4X,		// trilinear, up to 4 samples along the slope
+		FILTER_QUALITY_ANISOTROPIC_16X,		// trilinear, up to 16 samples along the slope
+		FILTER_QUALITY_COUNT
+	};
+
+	// std140 layout of one entry in the TextureData block; the handle
+	// is read as the xy of a uvec4, and z is one past the page tables
+	// of a virtual texture, 0 for any other
+	struct TEXTURE_HANDLE
+	{
+		GLuint64 handle;
+		GLuint virtualIndex;
+		GLuint padding;
+	};
+
+	// std140 layout of one entry in the TextureData block of the
+	// texture array fallback
+	struct TEXTURE_LAYER
+	{
+		glm::vec4 rect;		// xy = offset, zw = scale in the layer
+		GLint layer;
+		GLint channels;		// 1 or 2 for a gray texture, whose swizzle the blit drops
+		GLint padding[2];
+	};
+
+	// make the textures readable by index, in the order passed in;
+	// false when there are more than MAX_TEXTURES or none could be
+	// made resident
+	bool Build(const std::vector<GLuint>& textures);
+	// drop the handles and the texture array; call before the
+	// textures they were made from are deleted
+	void Clear();
+	// bind the table for the draws of a frame
+	void Bind();
+	// virtual textures whose page tables the handles point at, and
+	// which are bound with the handles
+	void SetVirtualTextures(VirtualTextures* pVirtualTextures) { m_pVirtualTextures = pVirtualTextures; }
+
+	// switch the sampler the textures are read with; the bindless
+	// handles are remade for it from the textures of the last Build()
+	void SetFilterQuality(int quality);
+	int GetFilterQuality() const { return(m_filterQuality); }
+
+	// true when the shaders read the textures through handles, so a
+	// draw has to keep to one texture; without them the instances of
+	// one draw may read different textures
+	bool IsBindless() const { return(m_bBindless); }
+	int GetTextureCount() const { return(m_textureCount); }
+	// layers of the texture array fallback and the size of each
+	int GetLayerCount() const { return(m_layerCount); }
+	int GetLayerSize() const { return(m_layerSize); }
+
+private:
+	// pointer to shader manager object
+	ShaderManager* m_pShaderManager;
+	VirtualTextures* m_pVirtualTextures;
+	bool m_bBindless;
+	int m_textureCount;
+	// textures of the last Build(), for remaking their handles
+	std::vector<GLuint> m_textures;
+	int m_filterQuality;
+	// sampler objects of each filter quality, created when first
+	// used; the texture array clamps where the textures repeat
+	GLuint m_samplers[FILTER_QUALITY_COUNT][2];
+	// resident handles and the uniform buffer backing TextureData
+	std::vector<GLuint64> m_handles;
+	GLuint m_textureDataUBO;
+	// fallback array the textures are packed into
+	GLuint m_textureArray;
+	int m_layerCount;
+	int m_layerSize;
+
+	// place of one texture in the texture array, in texels
+	struct TEXTURE_TILE
+	{
+		int textureIndex;
+		int width;
+		int height;
+		int layer;
+		int x;
+		int y;
+	};
+
+	// sampler of the current filter quality
+	GLuint GetSampler(bool bRepeat);
+	bool BuildHandles(const std::vector<GLuint>& textures);
+	bool BuildTextureArray(const std::vector<GLuint>& textures);
+	// place the tiles in shelves of the layers, returning the count
+	// of layers used
+	static int PackTiles(std::vector<TEXTURE_TILE>& tiles, int layerSize);
+};
@@ -0,0 +1,177 @@
+///////////////////////////////////////////////////////////////////////////////
+// transparencypass.cpp
+// ============
+// weighted blended order-independent transparency
+//
+//  Transparent draws are accumulated into two targets in any order
+//  and composited over the opaque scene with one full screen pass.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "TransparencyPass.h"
+#include "ShapeMeshes.h"
+#include "GLTrace.h"
+
+namespace
+{
+	/***********************************************************
+	 *  SetDrawBufferBlendFunc()
+	 *
+	 *  This function is used for setting the blend function of
+	 *  one draw buffer, through OpenGL 4.0 or the extension it
+	 *  came from.
+	 ***********************************************************/
+	void SetDrawBufferBlendFunc(GLuint drawBuffer, GLenum source, GLenum destination)
+	{
+		if (GLEW_VERSION_4_0 == GL_TRUE)
+		{
+			glBlendFunci(drawBuffer, source, destination);
+		}
+		else
+		{
+			glBlendFunciARB(drawBuffer, source, destination);
+		}
+	}
+}
+
+/***********************************************************
+ *  TransparencyPass()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+TransparencyPass::TransparencyPass(ShaderManager* pShaderManager)
+{
+	m_pShaderManager = pShaderManager;
+	m_resolveProgram = 0;
+	m_resolveVAO = 0;
+}
+
+/***********************************************************
+ *  ~TransparencyPass()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+TransparencyPass::~TransparencyPass()
+{
+	if (0 != m_resolveVAO)
+	{
+		glDeleteVertexArrays(1, &m_resolveVAO);
+		m_resolveVAO = 0;
+	}
+	if (0 != m_resolveProgram)
+	{
+		glDeleteProgram(m_resolveProgram);
+		m_resolveProgram = 0;
+	}
+	m_pShaderManager = NULL;
+}
+
+/***********************************************************
+ *  Create()
+ *
+ *  This method is used for building the resolve program.
+ *  The two targets accumulate with different blend
+ *  functions, which needs per draw buffer blending from
+ *  OpenGL 4.0 or ARB_draw_buffers_blend.
+ ***********************************************************/
+bool TransparencyPass::Create(
+	const char* resolveVertexPath,
+	const char* resolveFragmentPath)
+{
+	if ((NULL == m_pShaderManager) ||
+		((GLEW_VERSION_4_0 != GL_TRUE) && (GLEW_ARB_draw_buffers_blend != GL_TRUE)))
+	{
+		return(false);
+	}
+
+	m_resolveProgram = m_pShaderManager->LoadExternalProgram(resolveVertexPath, resolveFragmentPath);
+	if (0 == m_resolveProgram)
+	{
+		std::cout << "Order-independent transparency disabled, its resolve shader did not build" << std::endl;
+		return(false);
+	}
+
+	m_pShaderManager->UseExternalProgram(m_resolveProgram);
+	glUniform1i(glGetUniformLocation(m_resolveProgram, "accumulationTexture"), ACCUMULATION_TEXTURE_UNIT);
+	glUniform1i(glGetUniformLocation(m_resolveProgram, "revealageTexture"), REVEALAGE_TEXTURE_UNIT);
+
+	glGenVertexArrays(1, &m_resolveVAO);
+
+	return(true);
+}
+
+/***********************************************************
+ *  Begin()
+ *
+ *  This method is used for switching the transparent draws
+ *  to the accumulation targets. The opaque depth is copied
+ *  in first, so transparent surfaces behind opaque ones are
+ *  still rejected, then the targets are cleared to nothing
+ *  accumulated and fully revealed. A multisampled scene
+ *  cannot be copied from, so its depth is blitted into the
+ *  depth texture the bound framebuffer attaches.
+ ***********************************************************/
+void TransparencyPass::Begin(GLuint sceneFramebuffer, GLuint depthTexture, bool bMultisampled)
+{
+	if (IsAvailable() == false)
+	{
+		return;
+	}
+
+	GLint viewport[4] = { 0, 0, 0, 0 };
+	glGetIntegerv(GL_VIEWPORT, viewport);
+	GLint passFramebuffer = 0;
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &passFramebuffer);
+
+	// read the opaque depth from the scene; the copy replaces the
+	// revealage target on its unit until the resolve binds it again
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, sceneFramebuffer);
+	if (bMultisampled == true)
+	{
+		glBlitFramebuffer(viewport[0], viewport[1], viewport[0] + viewport[2], viewport[1] + viewport[3],
+			0, 0, viewport[2], viewport[3], GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+	}
+	else
+	{
+		m_pShaderManager->BindTexture(REVEALAGE_TEXTURE_UNIT, depthTexture);
+		m_pShaderManager->SetActiveTextureUnit(REVEALAGE_TEXTURE_UNIT);
+		GLTrace::RecordCopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, viewport[0], viewport[1], viewport[2], viewport[3]);
+		glCopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, viewport[0], viewport[1], viewport[2], viewport[3]);
+	}
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, (GLuint)passFramebuffer);
+
+	const GLfloat clearAccumulation[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	const GLfloat clearRevealage[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+	glClearBufferfv(GL_COLOR, 0, clearAccumulation);
+	glClearBufferfv(GL_COLOR, 1, clearRevealage);
+
+	SetDrawBufferBlendFunc(0, GL_ONE, GL_ONE);
+	SetDrawBufferBlendFunc(1, GL_ZERO, GL_ONE_MINUS_SRC_COLOR);
+}
+
+/***********************************************************
+ *  Resolve()
+ *
+ *  This method is used for compositing the accumulated
+ *  transparent layers over the opaque scene with one full
+ *  screen triangle, using the blend function the window
+ *  was created with, which it also restores.
+ ***********************************************************/
+void TransparencyPass::Resolve(GLuint accumulationTexture, GLuint revealageTexture)
+{
+	if (IsAvailable() == false)
+	{
+		return;
+	}
+
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	glDisable(GL_DEPTH_TEST);
+
+	m_pShaderManager->UseExternalProgram(m_resolveProgram);
+	m_pShaderManager->BindTexture(ACCUMULATION_TEXTURE_UNIT, accumulationTexture);
+	m_pShaderManager->BindTexture(REVEALAGE_TEXTURE_UNIT, revealageTexture);
+	ShapeMeshes::BindVertexArray(m_resolveVAO);
+	GLTrace::RecordDrawArrays(GL_TRIANGLES, 0, 3);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+
+	glEnable(GL_DEPTH_TEST);
+}
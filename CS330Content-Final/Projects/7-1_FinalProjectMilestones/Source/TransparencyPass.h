@@ -0,0 +1,64 @@
+///////////////////////////////////////////////////////////////////////////////
+// transparencypass.h
+// ============
+// weighted blended order-independent transparency
+//
+//  Transparent draws are accumulated into two targets in any order
+//  and composited over the opaque scene with one full screen pass.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "ShaderManager.h"
+
+/***********************************************************
+ *  TransparencyPass
+ *
+ *  This class contains the resolve program of the weighted
+ *  blended transparency. The accumulation and revealage
+ *  targets and the depth copy are transient targets of the
+ *  render graph: Begin() prepares the transparent draws
+ *  into them, tested against a copy of the opaque depth,
+ *  and Resolve() blends the result into the scene target.
+ ***********************************************************/
+class TransparencyPass
+{
+public:
+	// constructor
+	TransparencyPass(ShaderManager* pShaderManager);
+	// destructor
+	~TransparencyPass();
+
+	// texture units the resolve reads the targets from
+	static const int ACCUMULATION_TEXTURE_UNIT = 18;
+	static const int REVEALAGE_TEXTURE_UNIT = 19;
+
+	// formats of the accumulation and revealage targets, and of the
+	// copy of the opaque depth they are tested against
+	static const GLenum ACCUMULATION_FORMAT = GL_RGBA16F;
+	static const GLenum REVEALAGE_FORMAT = GL_R16F;
+	static const GLenum DEPTH_FORMAT = GL_DEPTH_COMPONENT32F;
+
+	// build the resolve program; false when the context cannot set
+	// a blend function per draw buffer or the program fails to build
+	bool Create(
+		const char* resolveVertexPath,
+		const char* resolveFragmentPath);
+	bool IsAvailable() const { return(0 != m_resolveProgram); }
+
+	// start drawing transparent draws into the bound accumulation
+	// and revealage targets, copying the depth of the scene
+	// framebuffer into their depth texture first; a multisampled
+	// scene is resolved into it, and needs the same depth format
+	void Begin(GLuint sceneFramebuffer, GLuint depthTexture, bool bMultisampled = false);
+	// composite the accumulated draws over the bound framebuffer
+	void Resolve(GLuint accumulationTexture, GLuint revealageTexture);
+
+private:
+	// pointer to shader manager object
+	ShaderManager* m_pShaderManager;
+	// full screen program compositing the targets
+	GLuint m_resolveProgram;
+	// vertex array for the full screen triangle, which has no buffers
+	GLuint m_resolveVAO;
+};
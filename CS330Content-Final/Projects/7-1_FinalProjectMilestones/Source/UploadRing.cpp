@@ -0,0 +1,353 @@
+///////////////////////////////////////////////////////////////////////////////
+// uploadring.cpp
+// ============
+// persistently mapped ring buffer for the per-frame dynamic data
+//
+//  One buffer split into a region per frame in flight. Each frame
+//  writes its camera block, instance data and indirect commands
+//  into its own region, and a fence keeps a region from being
+//  written again before the GPU has finished the frame reading it.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "UploadRing.h"
+#include "GLDebug.h"
+#include "GPUMemory.h"
+#include "GLTrace.h"
+
+#include <glm/glm.hpp>
+
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+namespace
+{
+	// longest single wait on a fence before checking it again
+	const GLuint64 FENCE_WAIT_NANOSECONDS = 1000000;
+}
+
+/***********************************************************
+ *  UploadRing()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+UploadRing::UploadRing()
+{
+	m_buffer = 0;
+	m_pMapping = NULL;
+	m_frameSize = 0;
+	m_bindAlignment = 16;
+	m_framesInFlight = MAX_FRAMES_IN_FLIGHT;
+	m_frameIndex = m_framesInFlight - 1;
+	m_frameOffset = 0;
+	for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+	{
+		m_fences[i] = 0;
+	}
+	memset(&m_stats, 0, sizeof(m_stats));
+	m_frameStartSeconds = -1.0;
+}
+
+/***********************************************************
+ *  ~UploadRing()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+UploadRing::~UploadRing()
+{
+	Destroy();
+}
+
+/***********************************************************
+ *  Destroy()
+ *
+ *  This method is used for dropping the fences, unmapping
+ *  the buffer and deleting it.
+ ***********************************************************/
+void UploadRing::Destroy()
+{
+	for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+	{
+		if (0 != m_fences[i])
+		{
+			glDeleteSync(m_fences[i]);
+			m_fences[i] = 0;
+		}
+	}
+
+	if (0 != m_buffer)
+	{
+		if (NULL != m_pMapping)
+		{
+			glBindBuffer(GL_COPY_WRITE_BUFFER, m_buffer);
+			glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+			glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+			m_pMapping = NULL;
+		}
+		GPUMemory::DeleteBuffers(1, &m_buffer);
+		m_buffer = 0;
+	}
+	m_frameSize = 0;
+}
+
+/***********************************************************
+ *  Create()
+ *
+ *  This method is used for creating the buffer with one
+ *  region of frameSize bytes per frame in flight. Every
+ *  region starts on the largest offset alignment of the
+ *  uniform, storage and texture buffer bindings, so any of
+ *  them can be bound to the start of a write.
+ ***********************************************************/
+bool UploadRing::Create(GLsizeiptr frameSize)
+{
+	Destroy();
+
+	GLint alignment = 0;
+	m_bindAlignment = 16;
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+	m_bindAlignment = glm::max(m_bindAlignment, (GLsizeiptr)alignment);
+	if (GLEW_VERSION_4_3 == GL_TRUE)
+	{
+		glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &alignment);
+		m_bindAlignment = glm::max(m_bindAlignment, (GLsizeiptr)alignment);
+		glGetIntegerv(GL_TEXTURE_BUFFER_OFFSET_ALIGNMENT, &alignment);
+		m_bindAlignment = glm::max(m_bindAlignment, (GLsizeiptr)alignment);
+	}
+	m_frameSize = ((glm::max(frameSize, (GLsizeiptr)1) + m_bindAlignment - 1) / m_bindAlignment) * m_bindAlignment;
+
+	glGenBuffers(1, &m_buffer);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, m_buffer);
+	if (GLEW_ARB_buffer_storage == GL_TRUE)
+	{
+		// mapped once for the life of the buffer; coherent, so the
+		// writes need no flush before the draws that read them
+		const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glBufferStorage(GL_COPY_WRITE_BUFFER, GetBufferSize(), NULL, flags);
+		m_pMapping = (unsigned char*)glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, GetBufferSize(), flags);
+		if (NULL == m_pMapping)
+		{
+			std::cout << "Could not map the upload ring, using buffer sub-data" << std::endl;
+			glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+			GPUMemory::DeleteBuffers(1, &m_buffer);
+			glGenBuffers(1, &m_buffer);
+			glBindBuffer(GL_COPY_WRITE_BUFFER, m_buffer);
+		}
+	}
+	if (NULL == m_pMapping)
+	{
+		glBufferData(GL_COPY_WRITE_BUFFER, GetBufferSize(), NULL, GL_DYNAMIC_DRAW);
+	}
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	GLDebug::Label(GL_BUFFER, m_buffer, "upload ring");
+	GPUMemory::TrackBuffer(m_buffer, GetBufferSize(), GPUMemory::CATEGORY_BUFFER, "upload ring");
+
+	m_frameIndex = m_framesInFlight - 1;
+	m_frameOffset = 0;
+
+	return(0 != m_buffer);
+}
+
+/***********************************************************
+ *  Reserve()
+ *
+ *  This method is used for growing the frame regions when a
+ *  new render list needs more than they hold. The frames in
+ *  flight still read the old buffer, so they are waited for
+ *  before it is replaced.
+ ***********************************************************/
+bool UploadRing::Reserve(GLsizeiptr frameSize)
+{
+	if ((0 != m_buffer) && (frameSize <= m_frameSize))
+	{
+		return(true);
+	}
+
+	for (int i = 0; i < m_framesInFlight; i++)
+	{
+		WaitForRegion(i);
+	}
+
+	// double at least, so a growing scene does not recreate it often
+	return(Create(glm::max(frameSize, m_frameSize * 2)));
+}
+
+/***********************************************************
+ *  WaitForRegion()
+ *
+ *  This method is used for waiting until the GPU finished
+ *  the commands fenced after the last frame that used the
+ *  region. Frames that had to wait are counted as stalls.
+ ***********************************************************/
+void UploadRing::WaitForRegion(int frameIndex)
+{
+	GLsync fence = m_fences[frameIndex];
+	if (0 == fence)
+	{
+		return;
+	}
+
+	GLenum result = glClientWaitSync(fence, 0, 0);
+	if (result == GL_TIMEOUT_EXPIRED)
+	{
+		std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+		while (result == GL_TIMEOUT_EXPIRED)
+		{
+			result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, FENCE_WAIT_NANOSECONDS);
+		}
+		std::chrono::duration<double> waited = std::chrono::high_resolution_clock::now() - start;
+
+		m_stats.stalls++;
+		m_stats.stallSeconds += waited.count();
+		m_stats.maxStallSeconds = glm::max(m_stats.maxStallSeconds, waited.count());
+	}
+
+	glDeleteSync(fence);
+	m_fences[frameIndex] = 0;
+}
+
+/***********************************************************
+ *  SetFramesInFlight()
+ *
+ *  This method is used for changing how many regions the
+ *  ring cycles through. An existing buffer still read by
+ *  the frames in flight is waited for and created again
+ *  with the new number of regions.
+ ***********************************************************/
+void UploadRing::SetFramesInFlight(int framesInFlight)
+{
+	framesInFlight = glm::clamp(framesInFlight, 1, (int)MAX_FRAMES_IN_FLIGHT);
+	if (framesInFlight == m_framesInFlight)
+	{
+		return;
+	}
+
+	if (0 == m_buffer)
+	{
+		m_framesInFlight = framesInFlight;
+		m_frameIndex = m_framesInFlight - 1;
+		return;
+	}
+
+	for (int i = 0; i < m_framesInFlight; i++)
+	{
+		WaitForRegion(i);
+	}
+	GLsizeiptr frameSize = m_frameSize;
+	m_framesInFlight = framesInFlight;
+	Create(frameSize);
+}
+
+/***********************************************************
+ *  GetStallFraction()
+ *
+ *  This method is used for getting the share of the frame
+ *  time the CPU spent waiting for the GPU to release a
+ *  region, over all frames so far.
+ ***********************************************************/
+double UploadRing::GetStallFraction() const
+{
+	if (m_stats.frameSeconds <= 0.0)
+	{
+		return(0.0);
+	}
+	return(glm::min(m_stats.stallSeconds / m_stats.frameSeconds, 1.0));
+}
+
+/***********************************************************
+ *  BeginFrame()
+ *
+ *  This method is used for starting the writes of a frame
+ *  in the next region of the ring.
+ ***********************************************************/
+void UploadRing::BeginFrame()
+{
+	double now = std::chrono::duration<double>(
+		std::chrono::high_resolution_clock::now().time_since_epoch()).count();
+	if (m_frameStartSeconds >= 0.0)
+	{
+		m_stats.frameSeconds += now - m_frameStartSeconds;
+	}
+	m_frameStartSeconds = now;
+
+	m_frameIndex = (m_frameIndex + 1) % m_framesInFlight;
+	WaitForRegion(m_frameIndex);
+	m_frameOffset = 0;
+	m_stats.frames++;
+}
+
+/***********************************************************
+ *  EndFrame()
+ *
+ *  This method is used for fencing the commands of the frame
+ *  after its last draw, so its region is only written again
+ *  once they have run.
+ ***********************************************************/
+void UploadRing::EndFrame()
+{
+	if (0 == m_buffer)
+	{
+		return;
+	}
+
+	if (0 != m_fences[m_frameIndex])
+	{
+		glDeleteSync(m_fences[m_frameIndex]);
+	}
+	m_fences[m_frameIndex] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+	m_stats.peakFrameBytes = glm::max(m_stats.peakFrameBytes, (unsigned long long)m_frameOffset);
+}
+
+/***********************************************************
+ *  Write()
+ *
+ *  This method is used for copying a block of data into the
+ *  region of the frame, after the blocks written before it.
+ *  The offset is aligned in the whole buffer, so a block
+ *  aligned to its record size can be addressed by record
+ *  index from the start of the buffer.
+ ***********************************************************/
+GLintptr UploadRing::Write(const void* pData, GLsizeiptr size, GLsizeiptr alignment)
+{
+	if ((0 == m_buffer) || (size <= 0))
+	{
+		return(-1);
+	}
+	if (alignment <= 0)
+	{
+		alignment = m_bindAlignment;
+	}
+
+	GLintptr regionStart = (GLintptr)m_frameIndex * m_frameSize;
+	GLintptr offset = regionStart + m_frameOffset;
+	offset = ((offset + alignment - 1) / alignment) * alignment;
+	if (offset + size > regionStart + m_frameSize)
+	{
+		// reported once, the caller keeps its earlier binding
+		if (m_stats.overflows == 0)
+		{
+			std::cout << "Upload ring region of " << m_frameSize << " bytes is full" << std::endl;
+		}
+		m_stats.overflows++;
+		return(-1);
+	}
+
+	if (NULL != m_pMapping)
+	{
+		memcpy(m_pMapping + offset, pData, size);
+		// the write reaches the GPU through the mapping, without a call
+		GLTrace::RecordBufferWrite(m_buffer, offset, size, pData);
+	}
+	else
+	{
+		glBindBuffer(GL_COPY_WRITE_BUFFER, m_buffer);
+		glBufferSubData(GL_COPY_WRITE_BUFFER, offset, size, pData);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	}
+
+	m_frameOffset = (offset + size) - regionStart;
+	m_stats.bytesWritten += size;
+
+	return(offset);
+}
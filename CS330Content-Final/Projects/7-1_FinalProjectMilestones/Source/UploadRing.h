@@ -0,0 +1,108 @@
+///////////////////////////////////////////////////////////////////////////////
+// uploadring.h
+// ============
+// persistently mapped ring buffer for the per-frame dynamic data
+//
+//  One buffer split into a region per frame in flight. Each frame
+//  writes its camera block, instance data and indirect commands
+//  into its own region, and a fence keeps a region from being
+//  written again before the GPU has finished the frame reading it.
+//  The regions so bound how many frames the CPU runs ahead of the
+//  GPU, and the time spent waiting on their fences tells whether
+//  the frames are CPU or GPU bound.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+/***********************************************************
+ *  UploadRing
+ *
+ *  This class contains the ring buffer every dynamic upload
+ *  of the renderer goes through. With buffer storage the
+ *  buffer is mapped once, persistent and coherent, and a
+ *  write is a copy into the mapping; without it the same
+ *  regions are written with glBufferSubData().
+ ***********************************************************/
+class UploadRing
+{
+public:
+	// constructor
+	UploadRing();
+	// destructor
+	~UploadRing();
+
+	// most frames the CPU may run ahead of the GPU
+	static const int MAX_FRAMES_IN_FLIGHT = 3;
+
+	// bytes written and time spent waiting for the GPU
+	struct UPLOAD_STATS
+	{
+		unsigned long long frames;			// frames begun
+		unsigned long long bytesWritten;	// over all frames
+		unsigned long long peakFrameBytes;	// most written in one frame
+		unsigned long long stalls;			// frames that waited for a fence
+		double stallSeconds;				// time waited over all frames
+		double maxStallSeconds;				// longest wait of one frame
+		double frameSeconds;				// time from frame start to frame start
+		unsigned long long overflows;		// writes that did not fit
+	};
+
+	// frames the CPU may run ahead of the GPU, 1 to
+	// MAX_FRAMES_IN_FLIGHT; 1 waits for every frame to finish on
+	// the GPU before the next one is written, more let the CPU
+	// prepare frames while the GPU still draws earlier ones
+	void SetFramesInFlight(int framesInFlight);
+	int GetFramesInFlight() const { return(m_framesInFlight); }
+
+	// create the buffer with frameSize bytes per frame region
+	bool Create(GLsizeiptr frameSize);
+	// grow the frame regions to at least frameSize bytes, waiting for
+	// every frame in flight first; only call between frames
+	bool Reserve(GLsizeiptr frameSize);
+	bool IsAvailable() const { return(0 != m_buffer); }
+	bool IsPersistent() const { return(NULL != m_pMapping); }
+
+	// move to the region of the next frame, waiting until the GPU
+	// has finished the frame that last used it
+	void BeginFrame();
+	// fence the commands of the frame that read its region
+	void EndFrame();
+
+	// copy size bytes into the region of the frame; returns the offset
+	// in the buffer, a multiple of the alignment (the binding alignment
+	// when 0), or -1 when the region is full
+	GLintptr Write(const void* pData, GLsizeiptr size, GLsizeiptr alignment = 0);
+
+	GLuint GetBuffer() const { return(m_buffer); }
+	GLsizeiptr GetBufferSize() const { return(m_frameSize * m_framesInFlight); }
+	// offset alignment shared by uniform, storage and texture buffers
+	GLsizeiptr GetBindAlignment() const { return(m_bindAlignment); }
+	// bytes written so far by the frame
+	GLsizeiptr GetFrameBytes() const { return(m_frameOffset); }
+	const UPLOAD_STATS& GetStats() const { return(m_stats); }
+	// share of the frame time spent waiting on fences; near 0 the
+	// frames are CPU bound, higher the CPU waits for the GPU
+	double GetStallFraction() const;
+
+private:
+	GLuint m_buffer;
+	// persistent mapping of the whole buffer, NULL without buffer storage
+	unsigned char* m_pMapping;
+	GLsizeiptr m_frameSize;
+	GLsizeiptr m_bindAlignment;
+	// region of the current frame and the bytes written into it
+	int m_frameIndex;
+	GLsizeiptr m_frameOffset;
+	int m_framesInFlight;
+	// fence of the last frame that used each region, 0 for none
+	GLsync m_fences[MAX_FRAMES_IN_FLIGHT];
+	UPLOAD_STATS m_stats;
+	// start of the last frame, for the frame time
+	double m_frameStartSeconds;
+
+	// wait for the fence of a region and drop it
+	void WaitForRegion(int frameIndex);
+	void Destroy();
+};
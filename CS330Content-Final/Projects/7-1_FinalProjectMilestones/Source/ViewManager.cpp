@@ -11,20 +11,64 @@
 ///////////////////////////////////////////////////////////////////////////////
 
 #include "ViewManager.h"
+#include "ScopeProfiler.h"
+#include "GPUMemory.h"
 
 // GLM Math Header inclusions
 #include <glm/glm.hpp>
 #include <glm/gtx/transform.hpp>
 #include <glm/gtc/type_ptr.hpp>    
 
+#include <atomic>
+#include <cstring>
+
 // declaration of the global variables and defines
 namespace
 {
 	// Variables for window width and height
 	const int WINDOW_WIDTH = 1000;
 	const int WINDOW_HEIGHT = 800;
-	const char* g_ViewName = "view";
-	const char* g_ProjectionName = "projection";
+	// current size of the window framebuffer in pixels, which differs
+	// from the window size on high-DPI displays; zero while minimized
+	int gFramebufferWidth = WINDOW_WIDTH;
+	int gFramebufferHeight = WINDOW_HEIGHT;
+	// half the height of the orthographic view volume; its width
+	// follows the framebuffer aspect
+	const float ORTHO_HALF_HEIGHT = 7.0f;
+	// depth range of the orthographic view volume
+	const float ORTHO_NEAR_PLANE = -1.0f;
+	const float ORTHO_FAR_PLANE = 30.0f;
+	// clip planes of the perspective view; reverse-Z has no far plane
+	const float PERSPECTIVE_NEAR_PLANE = 0.1f;
+	const float PERSPECTIVE_FAR_PLANE = 100.0f;
+
+	// size and spacing of the extra views drawn over the frame
+	// after the main view, as fractions of the frame
+	const float EXTRA_VIEW_SIZE = 0.3f;
+	const float EXTRA_VIEW_MARGIN = 0.02f;
+	// fixed cameras an extra view can show the scene from
+	struct VIEW_PRESET
+	{
+		const char* name;
+		glm::vec3 position;
+		glm::vec3 front;
+		glm::vec3 up;
+		float zoom;
+		bool bOrthographic;
+	};
+	const VIEW_PRESET VIEW_PRESETS[] =
+	{
+		// the front view of the O key
+		{ "front", glm::vec3(0.0f, 2.0f, 10.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f), 45.0f, true },
+		// straight down onto the counter
+		{ "top", glm::vec3(0.0f, 20.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, 0.0f, -1.0f), 45.0f, true },
+		// close up of the objects on the counter
+		{ "detail", glm::vec3(3.0f, 4.0f, 4.0f), glm::vec3(-3.0f, -2.5f, -4.0f), glm::vec3(0.0f, 1.0f, 0.0f), 35.0f, false }
+	};
+	const int VIEW_PRESET_COUNT = sizeof(VIEW_PRESETS) / sizeof(VIEW_PRESETS[0]);
+
+	// distance between the eyes of a stereo frame unless one is set
+	const float DEFAULT_EYE_SEPARATION = 0.065f;
 
 	// camera object used for viewing and interacting with
 	// the 3D scene
@@ -35,13 +79,119 @@ namespace
 	float gLastY = WINDOW_HEIGHT / 2.0f;
 	bool gFirstMouse = true;
 
-	// time between current frame and last frame
-	float gDeltaTime = 0.0f; 
-	float gLastFrame = 0.0f;
+	// the camera moves in fixed steps of simulated time, independent
+	// of the frame rate; the clock is kept in doubles, which still
+	// resolve microseconds after weeks of uptime
+	const double FIXED_TIMESTEP = 1.0 / 120.0;
+	// time of the last frame, negative before the first one
+	double gLastFrameTime = -1.0;
+	// frame time not yet simulated, less than one step after an update
+	double gStepAccumulator = 0.0;
+	// longest frame time fed to the simulation, so the first key
+	// press after an idle wait does not jump the camera
+	const double MAX_FRAME_DELTA = 0.1;
+	// camera position and zoom before the last step, blended with
+	// the current ones by the fraction of a step left over
+	glm::vec3 gPreviousCameraPosition(0.0f);
+	float gPreviousCameraZoom = 0.0f;
+
+	// true while a camera path is played back, which the mouse
+	// callbacks leave alone
+	bool gPathPlayback = false;
+	// set by a left click until the next packet takes it
+	bool gPickRequested = false;
+
+	// set by the input callbacks and mode keys until the next
+	// PrepareSceneView() picks it up
+	bool gInputReceived = true;
+	// time of the first input since a frame last took it, negative
+	// when there was none; the start of the input-to-present latency
+	double gFirstInputTime = -1.0;
+
+	// cursor movement since the camera last turned, in pixels, summed
+	// by Mouse_Position_Callback() and applied by ApplyMouseMovement()
+	// once a tick, so a mouse reporting many times a frame rebuilds
+	// the camera basis once instead of on every event
+	double gPendingMouseX = 0.0;
+	double gPendingMouseY = 0.0;
+	unsigned int gPendingMouseEvents = 0;
+	ViewManager::MOUSE_STATS gMouseStats = {};
+
+	// note an input event for redrawing and the latency measurement
+	void MarkInputReceived()
+	{
+		gInputReceived = true;
+		if (gFirstInputTime < 0.0)
+		{
+			gFirstInputTime = glfwGetTime();
+		}
+	}
 
 	// the following variable is false when orthographic projection
 	// is off and true when it is on
 	bool bOrthographicProjection = false;
+
+	// key presses and releases in the order GLFW reported them,
+	// written by Key_Callback() and read by ProcessKeyboardEvents()
+	// without a lock: the one writer only moves the head and the
+	// one reader only the tail. Events past a full queue are
+	// dropped, their key state is still tracked
+	struct KEY_EVENT
+	{
+		int key;
+		int action;		// GLFW_PRESS or GLFW_RELEASE
+	};
+	const unsigned int KEY_QUEUE_SIZE = 64;	// a power of two
+	KEY_EVENT gKeyQueue[KEY_QUEUE_SIZE];
+	std::atomic<unsigned int> gKeyQueueHead(0);
+	std::atomic<unsigned int> gKeyQueueTail(0);
+
+	// keys held down, one bit per GLFW key code, for the movement
+	// of the simulation steps
+	const int KEY_STATE_WORDS = (GLFW_KEY_LAST + 64) / 64;
+	std::atomic<unsigned long long> gKeyState[KEY_STATE_WORDS];
+
+	void PushKeyEvent(int key, int action)
+	{
+		unsigned int head = gKeyQueueHead.load(std::memory_order_relaxed);
+		if (head - gKeyQueueTail.load(std::memory_order_acquire) >= KEY_QUEUE_SIZE)
+		{
+			return;
+		}
+		gKeyQueue[head & (KEY_QUEUE_SIZE - 1)].key = key;
+		gKeyQueue[head & (KEY_QUEUE_SIZE - 1)].action = action;
+		gKeyQueueHead.store(head + 1, std::memory_order_release);
+	}
+
+	bool PopKeyEvent(KEY_EVENT& keyEvent)
+	{
+		unsigned int tail = gKeyQueueTail.load(std::memory_order_relaxed);
+		if (tail == gKeyQueueHead.load(std::memory_order_acquire))
+		{
+			return(false);
+		}
+		keyEvent = gKeyQueue[tail & (KEY_QUEUE_SIZE - 1)];
+		gKeyQueueTail.store(tail + 1, std::memory_order_release);
+		return(true);
+	}
+
+	void SetKeyDown(int key, bool bDown)
+	{
+		unsigned long long bit = 1ULL << (key % 64);
+		if (bDown == true)
+		{
+			gKeyState[key / 64].fetch_or(bit, std::memory_order_relaxed);
+		}
+		else
+		{
+			gKeyState[key / 64].fetch_and(~bit, std::memory_order_relaxed);
+		}
+	}
+
+	bool IsKeyDown(int key)
+	{
+		return((gKeyState[key / 64].load(std::memory_order_relaxed) & (1ULL << (key % 64))) != 0);
+	}
 }
 
 /***********************************************************
@@ -55,12 +205,51 @@ ViewManager::ViewManager(
 	// initialize the member variables
 	m_pShaderManager = pShaderManager;
 	m_pWindow = NULL;
+	m_frameData.view = glm::mat4(1.0f);
+	m_frameData.projection = glm::mat4(1.0f);
+	m_frameData.viewPosition = glm::vec4(0.0f, 0.0f, 0.0f, 0.0f);
+	m_bDepthPrepass = false;
+	m_bDeferredShading = false;
+	m_bVariableRateShading = false;
+	m_shadowQuality = ShadowAtlas::SHADOW_QUALITY_MEDIUM;
+	m_textureFilterQuality = TextureTable::FILTER_QUALITY_ANISOTROPIC_4X;
+	m_antiAliasing = PostStack::AA_NONE;
+	m_bRenderOnDemand = false;
+	m_presentMode = FramePacer::PRESENT_VSYNC;
+	m_bLateLatch = true;
+	m_bRawMouseMotion = false;
+	m_bReverseZ = false;
+	m_bScreenshotRequested = false;
+	m_bVideoCapture = false;
+	m_bStatsOverlay = false;
+	m_frameDataUBO = 0;
+	m_frameDataStride = 0;
+	m_bHasUploadedViews = false;
+	m_bStereo = false;
+	m_eyeSeparation = DEFAULT_EYE_SEPARATION;
+	memset(&m_stereoData, 0, sizeof(m_stereoData));
+	memset(&m_stereoFrameData, 0, sizeof(m_stereoFrameData));
+	m_stereoDataUBO = 0;
+	m_bProjectionCached = false;
+	m_bCachedOrthographic = false;
+	m_bCachedReverseZ = false;
+	m_cachedZoom = 0.0f;
+	m_cachedAspectRatio = 0.0f;
+	m_frameInputTime = -1.0;
+	memset(&m_latencyStats, 0, sizeof(m_latencyStats));
+	m_bViewChanged = true;
+	m_aspectRatio = (float)WINDOW_WIDTH / (float)WINDOW_HEIGHT;
+	m_bRemoteCamera = false;
+	m_wallTile = glm::mat4(1.0f);
+	m_wallAspectScale = 1.0f;
 	g_pCamera = new Camera();
 	// default camera view parameters
 	g_pCamera->Position = glm::vec3(2.0f, 5.5f, 9.0f);
 	g_pCamera->Front = glm::vec3(0.0f, -0.9f, -4.0f);
 	g_pCamera->Up = glm::vec3(0.0f, 1.0f, 0.0f);
 	g_pCamera->Zoom = 60;
+	gPreviousCameraPosition = g_pCamera->Position;
+	gPreviousCameraZoom = g_pCamera->Zoom;
 }
 
 /***********************************************************
@@ -73,6 +262,24 @@ ViewManager::~ViewManager()
 	// free up allocated memory
 	m_pShaderManager = NULL;
 	m_pWindow = NULL;
+	for (size_t i = 0; i < m_extraViews.size(); i++)
+	{
+		if (NULL != m_extraViews[i].pWindow)
+		{
+			delete m_extraViews[i].pWindow;
+			m_extraViews[i].pWindow = NULL;
+		}
+	}
+	if (0 != m_frameDataUBO)
+	{
+		GPUMemory::DeleteBuffers(1, &m_frameDataUBO);
+		m_frameDataUBO = 0;
+	}
+	if (0 != m_stereoDataUBO)
+	{
+		GPUMemory::DeleteBuffers(1, &m_stereoDataUBO);
+		m_stereoDataUBO = 0;
+	}
 	if (NULL != g_pCamera)
 	{
 		delete g_pCamera;
@@ -105,39 +312,108 @@ GLFWwindow* ViewManager::CreateDisplayWindow(const char* windowTitle)
 	// set created window as main GLFW window for openGL
 	glfwMakeContextCurrent(window);
 
-	// this callback is used to receive window sizing events
-	//glfwSetFramebufferSizeCallback(window, &ViewManager::Window_Resize_Callback);
+	// this callback is used to receive window sizing events, starting
+	// from the framebuffer size the window was created with
+	glfwGetFramebufferSize(window, &gFramebufferWidth, &gFramebufferHeight);
+	glfwSetFramebufferSizeCallback(window, &ViewManager::Window_Resize_Callback);
 
 	// tell GLFW to capture all mouse events
 	glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+	if ((m_bRawMouseMotion == true) && (glfwRawMouseMotionSupported() == GLFW_TRUE))
+	{
+		glfwSetInputMode(window, GLFW_RAW_MOUSE_MOTION, GLFW_TRUE);
+	}
 
 	// this callback is used to receive mouse moving events calling Mouse_Position_Callback()
 	glfwSetCursorPosCallback(window, &ViewManager::Mouse_Position_Callback);
 
+	// this callback is used to receive key presses and releases in Key_Callback()
+	glfwSetKeyCallback(window, &ViewManager::Key_Callback);
+
 	// this callback is used to receive mouse wheel scrolling events within the window in Mouse_Scroll_Wheel_Callback()
 	glfwSetScrollCallback(window, &ViewManager::Mouse_Scroll_Wheel_Callback);
 
-	// enable blending for supporting tranparent rendering
-	glEnable(GL_BLEND);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	// this callback is used to receive mouse button clicks in Mouse_Button_Callback()
+	glfwSetMouseButtonCallback(window, &ViewManager::Mouse_Button_Callback);
+
+	// this callback is used to redraw the window when it was uncovered
+	// or resized while no frames were rendered
+	glfwSetWindowRefreshCallback(window, &ViewManager::Window_Refresh_Callback);
+
+	// the blending and depth state of the draws is set by the scene
+	// once it is prepared, and by each of its passes
 
 	m_pWindow = window;
 
 	return(window);
 }
 
+/***********************************************************
+ *  CreateHeadlessWindow()
+ *
+ *  This method is used to create a hidden window that only
+ *  carries the OpenGL context, for rendering the frames
+ *  offscreen at the given size. The window takes no input
+ *  and is never resized, so the frame size stays fixed.
+ ***********************************************************/
+GLFWwindow* ViewManager::CreateHeadlessWindow(int width, int height)
+{
+	GLFWwindow* window = nullptr;
+
+	// the window itself is never shown or drawn into
+	glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+	window = glfwCreateWindow(1, 1, "headless", NULL, NULL);
+	glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
+	if (window == NULL)
+	{
+		std::cout << "Failed to create headless GLFW context" << std::endl;
+		glfwTerminate();
+		return NULL;
+	}
+
+	glfwMakeContextCurrent(window);
+
+	// the frames are sized for the offscreen target, not the window
+	gFramebufferWidth = glm::max(width, 1);
+	gFramebufferHeight = glm::max(height, 1);
+
+	// the blending and depth state of the draws is set by the scene
+	// once it is prepared, and by each of its passes
+
+	m_pWindow = window;
+
+	return(window);
+}
+
+/***********************************************************
+ *  SetHeadlessSize()
+ *
+ *  This method is used for changing the size of the frames
+ *  rendered offscreen, which the render target follows at
+ *  the start of the next frame, as it would a resize.
+ ***********************************************************/
+void ViewManager::SetHeadlessSize(int width, int height)
+{
+	width = glm::max(width, 1);
+	height = glm::max(height, 1);
+	if ((width != gFramebufferWidth) || (height != gFramebufferHeight))
+	{
+		gFramebufferWidth = width;
+		gFramebufferHeight = height;
+		gInputReceived = true;
+	}
+}
+
 /***********************************************************
  *  Mouse_Position_Callback()
  *
  *  This method is automatically called from GLFW whenever
  *  the mouse is moved within the active GLFW display window.
- *  Processes mouse movement on camera.
+ *  Sums the mouse movement for the camera to turn by on the
+ *  next tick.
  ***********************************************************/
 void ViewManager::Mouse_Position_Callback(GLFWwindow* window, double xMousePos, double yMousePos)
 {
-	// adjust to allow for more sensitive camera movement
-	float mouseSensitivity = 2.50f;
-
 	// Record first move event to calculate subsequent mouse movement offsets
 	if (gFirstMouse)
 	{
@@ -147,15 +423,108 @@ void ViewManager::Mouse_Position_Callback(GLFWwindow* window, double xMousePos,
 	}
 
 	// calculate X & Y offset values used to move 3D camera
-	float xOffset = xMousePos - gLastX;
-	float yOffset = gLastY - yMousePos; //reversed because y increases from bottom to top
+	double xOffset = xMousePos - gLastX;
+	double yOffset = gLastY - yMousePos; //reversed because y increases from bottom to top
 
 	// set current positions into last position variables
 	gLastX = xMousePos;
 	gLastY = yMousePos;
+	if (gPathPlayback == true)
+	{
+		return;
+	}
+	MarkInputReceived();
 
-	// move 3D camera using calculated offsets
-	g_pCamera->ProcessMouseMovement(xOffset*mouseSensitivity, yOffset*mouseSensitivity);
+	// the camera turns by the sum once per tick
+	gPendingMouseX += xOffset;
+	gPendingMouseY += yOffset;
+	gPendingMouseEvents++;
+}
+
+/***********************************************************
+ *  ApplyMouseMovement()
+ *
+ *  This method is used for turning the camera by the cursor
+ *  movement summed since the last tick, rebuilding its
+ *  basis once however many events the mouse reported. The
+ *  pitch is clamped on the sum, which only differs from
+ *  clamping each event when a tick swings past the limit
+ *  and back.
+ ***********************************************************/
+void ViewManager::ApplyMouseMovement()
+{
+	if (gPendingMouseEvents == 0)
+	{
+		return;
+	}
+
+	// adjust to allow for more sensitive camera movement
+	const float mouseSensitivity = 2.50f;
+
+	// a played back path owns the camera, and drops the movement
+	if (gPathPlayback == false)
+	{
+		g_pCamera->ProcessMouseMovement((float)gPendingMouseX * mouseSensitivity,
+			(float)gPendingMouseY * mouseSensitivity);
+	}
+
+	gMouseStats.events += gPendingMouseEvents;
+	gMouseStats.updates++;
+	if (gPendingMouseEvents > gMouseStats.maxEvents)
+	{
+		gMouseStats.maxEvents = gPendingMouseEvents;
+	}
+	gPendingMouseX = 0.0;
+	gPendingMouseY = 0.0;
+	gPendingMouseEvents = 0;
+}
+
+/***********************************************************
+ *  GetMouseStats()
+ *
+ *  This method is used for getting the cursor events and
+ *  the camera updates they were summed into.
+ ***********************************************************/
+const ViewManager::MOUSE_STATS& ViewManager::GetMouseStats()
+{
+	return(gMouseStats);
+}
+
+/***********************************************************
+ *  SetRawMouseMotion()
+ *
+ *  This method is used for reading the mouse motion as the
+ *  device reports it, without the scaling and acceleration
+ *  of the system cursor, which GLFW only offers while the
+ *  cursor is disabled, as the display window keeps it.
+ *  Where the platform has no raw motion the cursor motion
+ *  is kept.
+ ***********************************************************/
+void ViewManager::SetRawMouseMotion(bool bEnable)
+{
+	if ((bEnable == true) && (glfwRawMouseMotionSupported() == GLFW_FALSE))
+	{
+		std::cout << "Raw mouse motion is not supported, using the cursor motion" << std::endl;
+		bEnable = false;
+	}
+	m_bRawMouseMotion = bEnable;
+	if (NULL != m_pWindow)
+	{
+		glfwSetInputMode(m_pWindow, GLFW_RAW_MOUSE_MOTION, (bEnable == true) ? GLFW_TRUE : GLFW_FALSE);
+	}
+}
+
+/***********************************************************
+ *  InjectMouseMovement()
+ *
+ *  This method is used for moving the mouse look by an
+ *  offset from the last position the mouse was seen at,
+ *  such as the movement a remote viewer sends.
+ ***********************************************************/
+void ViewManager::InjectMouseMovement(double xOffset, double yOffset)
+{
+	gFirstMouse = false;
+	Mouse_Position_Callback(NULL, gLastX + xOffset, gLastY + yOffset);
 }
 
 /***********************************************************
@@ -167,101 +536,286 @@ void ViewManager::Mouse_Position_Callback(GLFWwindow* window, double xMousePos,
  ***********************************************************/
 void ViewManager::Mouse_Scroll_Wheel_Callback(GLFWwindow* window, double xOffset, double yOffset)
 {
+	if (gPathPlayback == true)
+	{
+		return;
+	}
+
 	// Change movement speed of camera accordingly to yOffset (vertical scroll)
 	// Scroll down = decrease speed, Scroll up = increase speed
 	g_pCamera->ProcessMouseScroll(-yOffset);
+	MarkInputReceived();
+}
+
+/***********************************************************
+ *  Mouse_Button_Callback()
+ *
+ *  This method is automatically called from GLFW whenever
+ *  a mouse button is pressed or released. A left click asks
+ *  the next frame to pick the object the camera aims at.
+ ***********************************************************/
+void ViewManager::Mouse_Button_Callback(GLFWwindow* window, int button, int action, int mods)
+{
+	if ((gPathPlayback == true) || (button != GLFW_MOUSE_BUTTON_LEFT) || (action != GLFW_PRESS))
+	{
+		return;
+	}
+
+	gPickRequested = true;
+	MarkInputReceived();
+}
+
+/***********************************************************
+ *  Key_Callback()
+ *
+ *  This method is automatically called from GLFW whenever
+ *  a key is pressed, repeated or released. It keeps the
+ *  held keys in the key state bits for the movement and
+ *  queues the presses and releases for the next
+ *  ProcessKeyboardEvents(), so no key is polled per frame.
+ ***********************************************************/
+void ViewManager::Key_Callback(GLFWwindow* window, int key, int scancode, int action, int mods)
+{
+	if ((key < 0) || (key > GLFW_KEY_LAST) || (action == GLFW_REPEAT))
+	{
+		return;
+	}
+
+	SetKeyDown(key, (action == GLFW_PRESS));
+	PushKeyEvent(key, action);
+	MarkInputReceived();
 }
 
 /***********************************************************
  *  ProcessKeyboardEvents()
  *
- *  This method is called to process any keyboard events
- *  that may be waiting in the event queue. Includes camera
- *  view and movement controls.
+ *  This method is called to process the key events queued
+ *  by Key_Callback() since the last frame: the mode toggles
+ *  and the view changes act once per key press. Camera
+ *  movement reads the held keys in UpdateSimulation().
  ***********************************************************/
 void ViewManager::ProcessKeyboardEvents()
 {
-	// close the window if the escape key has been pressed
-	if (glfwGetKey(m_pWindow, GLFW_KEY_ESCAPE) == GLFW_PRESS)
+	m_frameKeys.clear();
+	KEY_EVENT keyEvent;
+	while (PopKeyEvent(keyEvent) == true)
+	{
+		if (keyEvent.action != GLFW_PRESS)
+		{
+			continue;
+		}
+
+		// a played back path replays its recorded key presses, and
+		// a node of a wall the master's, so only the escape key is
+		// taken from the keyboard
+		if (((m_cameraPath.IsPlaying() == true) || (m_bRemoteCamera == true)) && (keyEvent.key != GLFW_KEY_ESCAPE))
+		{
+			continue;
+		}
+		if (keyEvent.key != GLFW_KEY_ESCAPE)
+		{
+			m_cameraPath.RecordKey(keyEvent.key);
+			m_frameKeys.push_back(keyEvent.key);
+		}
+		ProcessKeyPress(keyEvent.key);
+	}
+}
+
+/***********************************************************
+ *  ProcessKeyPress()
+ *
+ *  This method is used for acting on one key press, whether
+ *  it came from the keyboard or from a played back path.
+ ***********************************************************/
+void ViewManager::ProcessKeyPress(int key)
+{
+	switch (key)
 	{
+	// close the window if the escape key has been pressed
+	case GLFW_KEY_ESCAPE:
 		glfwSetWindowShouldClose(m_pWindow, true);
+		break;
+
+	// toggle the depth pre-pass once per key press
+	case GLFW_KEY_Z:
+		m_bDepthPrepass = !m_bDepthPrepass;
+		std::cout << "Depth pre-pass " << ((m_bDepthPrepass == true) ? "on" : "off") << std::endl;
+		break;
+
+	// switch between clustered forward and deferred shading
+	case GLFW_KEY_G:
+		m_bDeferredShading = !m_bDeferredShading;
+		std::cout << "Deferred shading " << ((m_bDeferredShading == true) ? "on" : "off") << std::endl;
+		break;
+
+	// light the low-detail tiles of the deferred path coarsely
+	case GLFW_KEY_C:
+		m_bVariableRateShading = !m_bVariableRateShading;
+		std::cout << "Variable rate shading " << ((m_bVariableRateShading == true) ? "on" : "off") << std::endl;
+		break;
+
+	// step through off, hardware, 3x3 and 5x5 filtered shadows
+	case GLFW_KEY_X:
+	{
+		const char* const qualityNames[ShadowAtlas::SHADOW_QUALITY_COUNT] = { "off", "low", "medium", "high" };
+		m_shadowQuality = (m_shadowQuality + 1) % ShadowAtlas::SHADOW_QUALITY_COUNT;
+		std::cout << "Shadow quality " << qualityNames[m_shadowQuality] << std::endl;
+		break;
+	}
+
+	// step through bilinear, trilinear, 4x and 16x anisotropic textures
+	case GLFW_KEY_F:
+	{
+		const char* const qualityNames[TextureTable::FILTER_QUALITY_COUNT] = { "bilinear", "trilinear", "4x anisotropic", "16x anisotropic" };
+		m_textureFilterQuality = (m_textureFilterQuality + 1) % TextureTable::FILTER_QUALITY_COUNT;
+		std::cout << "Texture filtering " << qualityNames[m_textureFilterQuality] << std::endl;
+		break;
 	}
 
-	// if the camera object is null, then exit this method
+	// step through no, 2x, 4x and 8x multisampled, FXAA and temporal
+	// anti-aliasing
+	case GLFW_KEY_M:
+		m_antiAliasing = (m_antiAliasing + 1) % PostStack::AA_COUNT;
+		std::cout << "Anti-aliasing " << PostStack::GetAntiAliasingName(m_antiAliasing) << std::endl;
+		break;
+
+	// switch between rendering every frame and only changed ones
+	case GLFW_KEY_I:
+		m_bRenderOnDemand = !m_bRenderOnDemand;
+		std::cout << "Render on demand " << ((m_bRenderOnDemand == true) ? "on" : "off") << std::endl;
+		break;
+
+	// step through vsync, adaptive vsync, uncapped and capped presents
+	case GLFW_KEY_V:
+		m_presentMode = (m_presentMode + 1) % FramePacer::PRESENT_MODE_COUNT;
+		std::cout << "Present mode " << FramePacer::GetPresentModeName(m_presentMode) << std::endl;
+		break;
+
+	// save the next rendered frame as an image
+	case GLFW_KEY_F12:
+		m_bScreenshotRequested = true;
+		break;
+
+	// start or stop saving every rendered frame, for a video
+	case GLFW_KEY_F10:
+		m_bVideoCapture = !m_bVideoCapture;
+		std::cout << "Video capture " << ((m_bVideoCapture == true) ? "on" : "off") << std::endl;
+		break;
+
+	// write every GPU resource, for finding what holds the video
+	// memory; it makes no GL calls, so any thread may ask
+	case GLFW_KEY_F9:
+		GPUMemory::Dump(GPUMemory::DUMP_FILE);
+		break;
+
+	// show or hide the pass timings and counters
+	case GLFW_KEY_F3:
+		m_bStatsOverlay = !m_bStatsOverlay;
+		std::cout << "Stats overlay " << ((m_bStatsOverlay == true) ? "on" : "off") << std::endl;
+		break;
+
+	// switch between standard and reverse-Z infinite depth
+	case GLFW_KEY_R:
+		SetReverseZ(!m_bReverseZ);
+		std::cout << "Reverse-Z depth " << ((m_bReverseZ == true) ? "on" : "off") << std::endl;
+		break;
+
+	/*Change view of the scene*/
+	// Orthographic (2D) view
+	case GLFW_KEY_O:
+		if (NULL != g_pCamera)
+		{
+			// changes projection matrix in PrepareSceneView()
+			bOrthographicProjection = true;
+			// Set camera settings for a front view, perpendicular to the horizontal plane
+			g_pCamera->Position = glm::vec3(0.0f, 2.0f, 10.0f); // Reset camera position along z axis in front of object
+			g_pCamera->Front = glm::vec3(0.0f, 0.0f, -1.0f); // Look at origin
+			g_pCamera->Up = glm::vec3(0.0f, 5.0f, 0.0f); // correct camera orientation
+			// jump to the front view rather than blending toward it
+			gPreviousCameraPosition = g_pCamera->Position;
+		}
+		break;
+
+	// Perspective (3D) view
+	case GLFW_KEY_P:
+		// changes projection matrix in PrepareSceneView()
+		bOrthographicProjection = false;
+		break;
+
+	default:
+		break;
+	}
+}
+
+/***********************************************************
+ *  UpdateSimulation()
+ *
+ *  This method is used for advancing the camera by one fixed
+ *  step of simulated time, moving it by the keys held down.
+ *  Each step takes the same time whatever the frame rate, so
+ *  the camera covers the same path at any frame rate.
+ ***********************************************************/
+void ViewManager::UpdateSimulation(float stepSeconds)
+{
 	if (NULL == g_pCamera)
 	{
 		return;
 	}
 
+	gPreviousCameraPosition = g_pCamera->Position;
+	gPreviousCameraZoom = g_pCamera->Zoom;
+
 	/*process camera moving forward and backward*/
 	// Move Forward:
-	if (glfwGetKey(m_pWindow, GLFW_KEY_W) == GLFW_PRESS)
+	if (IsKeyDown(GLFW_KEY_W) == true)
 	{
-		g_pCamera->ProcessKeyboard(FORWARD, gDeltaTime);
+		g_pCamera->ProcessKeyboard(FORWARD, stepSeconds);
 	}
 	// Move Backward:
-	if (glfwGetKey(m_pWindow, GLFW_KEY_S) == GLFW_PRESS)
+	if (IsKeyDown(GLFW_KEY_S) == true)
 	{
-		g_pCamera->ProcessKeyboard(BACKWARD, gDeltaTime);
+		g_pCamera->ProcessKeyboard(BACKWARD, stepSeconds);
 	}
 
 	/* process camera panning left and right*/
 	// Pan Left:
-	if (glfwGetKey(m_pWindow, GLFW_KEY_A) == GLFW_PRESS)
+	if (IsKeyDown(GLFW_KEY_A) == true)
 	{
-		g_pCamera->ProcessKeyboard(LEFT, gDeltaTime);
+		g_pCamera->ProcessKeyboard(LEFT, stepSeconds);
 	}
 	// Pan Right:
-	if (glfwGetKey(m_pWindow, GLFW_KEY_D) == GLFW_PRESS)
+	if (IsKeyDown(GLFW_KEY_D) == true)
 	{
-		g_pCamera->ProcessKeyboard(RIGHT, gDeltaTime);
+		g_pCamera->ProcessKeyboard(RIGHT, stepSeconds);
 	}
 
 	/*process camera panning upward and downward*/
 	// Pan Up:
-	if (glfwGetKey(m_pWindow, GLFW_KEY_Q) == GLFW_PRESS)
+	if (IsKeyDown(GLFW_KEY_Q) == true)
 	{
-		g_pCamera->ProcessKeyboard(UP, gDeltaTime);
+		g_pCamera->ProcessKeyboard(UP, stepSeconds);
 	}
 	// Pan Down:
-	if (glfwGetKey(m_pWindow, GLFW_KEY_E) == GLFW_PRESS)
+	if (IsKeyDown(GLFW_KEY_E) == true)
 	{
-		g_pCamera->ProcessKeyboard(DOWN, gDeltaTime);
+		g_pCamera->ProcessKeyboard(DOWN, stepSeconds);
 	}
 
 	/* process camera zooming in and out*/
 	// Zoom in:
-	if (glfwGetKey(m_pWindow, GLFW_KEY_UP) == GLFW_PRESS)
+	if (IsKeyDown(GLFW_KEY_UP) == true)
 	{
 		if (g_pCamera->Zoom >= 10) { // Maximum zoom = minimum of 10
 			g_pCamera->Zoom -= 0.01;
 		}
 	}
 	// Zoom out:
-	if (glfwGetKey(m_pWindow, GLFW_KEY_DOWN) == GLFW_PRESS)
+	if (IsKeyDown(GLFW_KEY_DOWN) == true)
 	{
 		if (g_pCamera->Zoom <= 160) { // Maximum field of view of 160
 			g_pCamera->Zoom += 0.01;
 		}
 	}
-
-	/*Change view of the scene*/
-	// Orthographic (2D) view
-	if (glfwGetKey(m_pWindow, GLFW_KEY_O) == GLFW_PRESS)
-	{
-		// changes projection matrix in PrepareSceneView()
-		bOrthographicProjection = true;
-		// Set camera settings for a front view, perpendicular to the horizontal plane
-		g_pCamera->Position = glm::vec3(0.0f, 2.0f, 10.0f); // Reset camera position along z axis in front of object
-		g_pCamera->Front = glm::vec3(0.0f, 0.0f, -1.0f); // Look at origin
-		g_pCamera->Up = glm::vec3(0.0f, 5.0f, 0.0f); // correct camera orientation
-	}
-	// Perspective (3D) view
-	if (glfwGetKey(m_pWindow, GLFW_KEY_P) == GLFW_PRESS)
-	{
-		// changes projection matrix in PrepareSceneView()
-		bOrthographicProjection = false;
-	}
 }
 
 /***********************************************************
@@ -270,9 +824,26 @@ void ViewManager::ProcessKeyboardEvents()
  *  This method is automatically called from GLFW whenever
  *  the framebuffer for the active GLFW window is resized
  ***********************************************************/
-void ViewManager::Window_Resize_Callback(GLFWwindow* window, double width, double height)
+void ViewManager::Window_Resize_Callback(GLFWwindow* window, int width, int height)
 {
-	//glViewport(0, 0, width, height);
+	// the viewport is set from the new size by the render target
+	// at the start of the next frame
+	gFramebufferWidth = width;
+	gFramebufferHeight = height;
+	gInputReceived = true;
+}
+
+/***********************************************************
+ *  Window_Refresh_Callback()
+ *
+ *  This method is automatically called from GLFW whenever
+ *  the contents of the window need to be redrawn, such as
+ *  after it was uncovered, which render on demand would
+ *  otherwise leave for the next change.
+ ***********************************************************/
+void ViewManager::Window_Refresh_Callback(GLFWwindow* window)
+{
+	gInputReceived = true;
 }
 
 /***********************************************************
@@ -284,40 +855,826 @@ void ViewManager::Window_Resize_Callback(GLFWwindow* window, double width, doubl
  ***********************************************************/
 void ViewManager::PrepareSceneView()
 {
+	PROFILE_SCOPE("PrepareSceneView");
 	glm::mat4 view;
 	glm::mat4 projection;
 
-	// per-frame timing
-	float currentFrame = glfwGetTime();
-	gDeltaTime = currentFrame - gLastFrame;
-	gLastFrame = currentFrame;
-
 	// process any keyboard events that may be waiting in the 
 	// event queue
 	ProcessKeyboardEvents();
+	// and turn the camera by the mouse movement since the last frame
+	ApplyMouseMovement();
+
+	if (m_cameraPath.IsPlaying() == true)
+	{
+		// a played back path advances one step per frame, however
+		// long the frame took
+		PlayPathStep();
+	}
+	else if (m_bRemoteCamera == true)
+	{
+		// the master's camera was taken before the frame
+	}
+	else
+	{
+		// per-frame timing, in doubles
+		double currentFrameTime = glfwGetTime();
+		if (gLastFrameTime < 0.0)
+		{
+			gLastFrameTime = currentFrameTime;
+		}
+		gStepAccumulator += glm::min(currentFrameTime - gLastFrameTime, MAX_FRAME_DELTA);
+		gLastFrameTime = currentFrameTime;
+
+		// run the fixed steps the frame time covers
+		while (gStepAccumulator >= FIXED_TIMESTEP)
+		{
+			UpdateSimulation((float)FIXED_TIMESTEP);
+			gStepAccumulator -= FIXED_TIMESTEP;
+			if (m_cameraPath.IsRecording() == true)
+			{
+				m_cameraPath.RecordStep(GetCameraPose());
+			}
+		}
+	}
+
+	// render the camera between its last two steps, by the part of
+	// a step already elapsed; the orientation follows the mouse
+	// directly, so looking around never lags
+	float blend = (float)(gStepAccumulator / FIXED_TIMESTEP);
+	SetRenderCamera(glm::mix(gPreviousCameraPosition, g_pCamera->Position, blend));
+	m_renderCamera.Zoom = glm::mix(gPreviousCameraZoom, g_pCamera->Zoom, blend);
+
+	// get the current view matrix from the camera, which keeps the
+	// last one while the camera rests
+	view = m_renderCamera.GetViewMatrix();
+
+	// aspect of the framebuffer, kept from the last frame while
+	// the window is minimized and has no area; in stereo each eye
+	// gets half of the width
+	if ((gFramebufferWidth > 0) && (gFramebufferHeight > 0))
+	{
+		m_aspectRatio = (GLfloat)gFramebufferWidth / (GLfloat)gFramebufferHeight;
+		if (m_bStereo == true)
+		{
+			m_aspectRatio *= 0.5f;
+		}
+	}
+
+	// the projection only changes with the mode, the zoom and the
+	// aspect, so it is kept from the last frame while they stay
+	bool bProjectionChanged = (m_bProjectionCached == false) ||
+		(m_bCachedOrthographic != bOrthographicProjection) || (m_bCachedReverseZ != m_bReverseZ) ||
+		(m_cachedZoom != m_renderCamera.Zoom) || (m_cachedAspectRatio != m_aspectRatio);
+	if (bProjectionChanged == false)
+	{
+		projection = m_frameData.projection;
+	}
+	else
+	{
+		// a tile of a wall narrows the frustum over the whole wall
+		projection = m_wallTile *
+			MakeProjection(bOrthographicProjection, m_renderCamera.Zoom, m_aspectRatio * m_wallAspectScale);
+	}
+	m_bProjectionCached = true;
+	m_bCachedOrthographic = bOrthographicProjection;
+	m_bCachedReverseZ = m_bReverseZ;
+	m_cachedZoom = m_renderCamera.Zoom;
+	m_cachedAspectRatio = m_aspectRatio;
+
+	// the extra views hold their cameras, so only the aspect of the
+	// frame or of their window and the depth convention change
+	// their projection; closing the window of a view closes the
+	// application, as the main window does
+	for (size_t i = 0; i < m_extraViews.size(); i++)
+	{
+		EXTRA_VIEW& extraView = m_extraViews[i];
+		float viewAspectRatio = m_aspectRatio * extraView.rect.z / extraView.rect.w;
+		if (NULL != extraView.pWindow)
+		{
+			if (extraView.pWindow->UpdateSize() == true)
+			{
+				gInputReceived = true;
+			}
+			if ((extraView.pWindow->GetWidth() > 0) && (extraView.pWindow->GetHeight() > 0))
+			{
+				extraView.windowAspectRatio = (float)extraView.pWindow->GetWidth() / (float)extraView.pWindow->GetHeight();
+			}
+			if (glfwWindowShouldClose(extraView.pWindow->GetWindow()) == GLFW_TRUE)
+			{
+				glfwSetWindowShouldClose(m_pWindow, GLFW_TRUE);
+			}
+			viewAspectRatio = extraView.windowAspectRatio;
+		}
+		FRAME_DATA viewFrameData;
+		viewFrameData.view = glm::lookAt(extraView.position, extraView.position + extraView.front, extraView.up);
+		viewFrameData.projection = MakeProjection(extraView.bOrthographic, extraView.zoom, viewAspectRatio);
+		viewFrameData.viewPosition = glm::vec4(extraView.position, (m_bReverseZ == true) ? 1.0f : 0.0f);
+		extraView.frameData = viewFrameData;
+	}
+
+	FRAME_DATA frameData;
+	frameData.view = view;
+	frameData.projection = projection;
+	frameData.viewPosition = glm::vec4(m_renderCamera.Position, (m_bReverseZ == true) ? 1.0f : 0.0f);
+
+	// the frame differs from the last one after input or when the
+	// camera moved, such as while a movement key is held
+	bool bFrameDataChanged = (memcmp(&frameData, &m_frameData, sizeof(FRAME_DATA)) != 0);
+	m_bViewChanged = (gInputReceived == true) || (bFrameDataChanged == true);
+	gInputReceived = false;
+
+	if (bFrameDataChanged == true)
+	{
+		m_frameData = frameData;
+		UpdateStereoViews();
+	}
+	TakeInputTime();
+}
 
-	// get the current view matrix from the camera
-	view = g_pCamera->GetViewMatrix();
+/***********************************************************
+ *  LatchCamera()
+ *
+ *  This method is used for sampling the mouse look once more
+ *  after the draws of a frame were built, right before they
+ *  are submitted. It polls the events that arrived since
+ *  PrepareSceneView() and rebuilds the view matrix from the
+ *  newest camera orientation, keeping the position and the
+ *  projection of the frame, so looking around reaches the
+ *  screen a frame build earlier. The blocks of the packet
+ *  follow, for the caller to write with UploadFramePacket(),
+ *  and an input the packet did not have yet becomes its
+ *  input time. Returns false when late latching is off or
+ *  the view did not change.
+ ***********************************************************/
+bool ViewManager::LatchCamera(FRAME_PACKET& packet)
+{
+	if ((m_bLateLatch == false) || (m_cameraPath.IsPlaying() == true) || (m_bRemoteCamera == true))
+	{
+		return(false);
+	}
+
+	// the mouse callbacks sum the movement as the events are polled,
+	// and the camera turns by it once
+	glfwPollEvents();
+	ApplyMouseMovement();
+	TakeInputTime();
+
+	SetRenderCamera(glm::vec3(m_frameData.viewPosition));
+	glm::mat4 view = m_renderCamera.GetViewMatrix();
+	if (view == m_frameData.view)
+	{
+		return(false);
+	}
+
+	m_frameData.view = view;
+	UpdateStereoViews();
+
+	// the earlier input the packet already had stays its input time
+	double inputTime = packet.inputTime;
+	GetFramePacket(packet);
+	if (inputTime >= 0.0)
+	{
+		packet.inputTime = inputTime;
+	}
+	return(true);
+}
+
+/***********************************************************
+ *  FramePresented()
+ *
+ *  This method is used for ending the latency measurement of
+ *  a frame just presented, from the first input it took to
+ *  the return of the buffer swap. The swap returns when the
+ *  frame is queued for display, so the latency is the part
+ *  the renderer controls, without the display scanout. It
+ *  runs on the thread rendering the frames, which alone
+ *  writes the statistics.
+ ***********************************************************/
+void ViewManager::FramePresented(double inputTime)
+{
+	if (inputTime < 0.0)
+	{
+		return;
+	}
+
+	double latency = glfwGetTime() - inputTime;
+	m_latencyStats.frames++;
+	m_latencyStats.totalSeconds += latency;
+	m_latencyStats.maxSeconds = glm::max(m_latencyStats.maxSeconds, latency);
+}
+
+/***********************************************************
+ *  TakeInputTime()
+ *
+ *  This method is used for handing the time of the first
+ *  input since the last frame to the frame being prepared,
+ *  unless it already has an earlier one.
+ ***********************************************************/
+void ViewManager::TakeInputTime()
+{
+	if ((gFirstInputTime >= 0.0) && (m_frameInputTime < 0.0))
+	{
+		m_frameInputTime = gFirstInputTime;
+	}
+	gFirstInputTime = -1.0;
+}
+
+/***********************************************************
+ *  SetRenderCamera()
+ *
+ *  This method is used for pointing the camera the frame is
+ *  rendered from at a position, with the orientation of the
+ *  camera the input moves. The render camera lives as long
+ *  as the view manager, so its cached view matrix carries
+ *  over the frames in which the camera rests.
+ ***********************************************************/
+void ViewManager::SetRenderCamera(const glm::vec3& position)
+{
+	m_renderCamera.Position = position;
+	m_renderCamera.Front = g_pCamera->Front;
+	m_renderCamera.Up = g_pCamera->Up;
+	m_renderCamera.Right = g_pCamera->Right;
+}
+
+/***********************************************************
+ *  GetFramePacket()
+ *
+ *  This method is used for copying everything the rendering
+ *  of the prepared frame reads from the view manager into a
+ *  packet: the FrameData block of every view, the eye
+ *  cameras, the render modes and the window size. The frame
+ *  can then be rendered from the packet while the input and
+ *  simulation of the next one already change the manager.
+ *  The input time moves to the packet, so it is measured
+ *  once, by the frame that presents it.
+ ***********************************************************/
+void ViewManager::GetFramePacket(FRAME_PACKET& packet)
+{
+	packet.viewCount = GetViewCount();
+	for (int view = 0; view < packet.viewCount; view++)
+	{
+		packet.views[view] = GetViewFrameData(view);
+		ViewWindow* pViewWindow = GetViewWindow(view);
+		packet.viewWindowWidth[view] = (NULL != pViewWindow) ? pViewWindow->GetWidth() : 0;
+		packet.viewWindowHeight[view] = (NULL != pViewWindow) ? pViewWindow->GetHeight() : 0;
+	}
+	packet.stereoData = m_stereoData;
+	packet.bStereo = m_bStereo;
+	packet.bDepthPrepass = m_bDepthPrepass;
+	packet.bDeferredShading = m_bDeferredShading;
+	packet.bVariableRateShading = m_bVariableRateShading;
+	packet.bReverseZ = m_bReverseZ;
+	packet.bRenderOnDemand = m_bRenderOnDemand;
+	packet.shadowQuality = m_shadowQuality;
+	packet.textureFilterQuality = m_textureFilterQuality;
+	packet.antiAliasing = m_antiAliasing;
+	packet.presentMode = m_presentMode;
+	packet.framebufferWidth = gFramebufferWidth;
+	packet.framebufferHeight = gFramebufferHeight;
+	packet.bViewChanged = m_bViewChanged;
+	packet.inputTime = m_frameInputTime;
+	m_frameInputTime = -1.0;
+	packet.streamInputId = 0;
+	packet.bScreenshot = m_bScreenshotRequested;
+	packet.bVideoCapture = m_bVideoCapture;
+	packet.bStatsOverlay = m_bStatsOverlay;
+	packet.bPick = gPickRequested;
+	m_bScreenshotRequested = false;
+	gPickRequested = false;
+}
+
+/***********************************************************
+ *  UploadFramePacket()
+ *
+ *  This method is used for writing the view, projection and
+ *  camera position of every view of a packet into the
+ *  FrameData buffer shared by all shader programs, only the
+ *  blocks that changed since the last write. A block is a
+ *  few hundred bytes, and the GL orders the write after the
+ *  draws issued before it, which still read the old
+ *  contents, so a resting camera writes nothing at all.
+ *  Every view has a slot of its own in the buffer, which
+ *  BindView() selects, and the main view is bound unless
+ *  one is. Only the thread rendering the frames calls it.
+ ***********************************************************/
+void ViewManager::UploadFramePacket(const FRAME_PACKET& packet)
+{
+	if (0 == m_frameDataUBO)
+	{
+		// the slots start at offsets a range binding accepts
+		GLint alignment = (GLint)sizeof(FRAME_DATA);
+		glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+		alignment = glm::max(alignment, 1);
+		m_frameDataStride = ((GLintptr)sizeof(FRAME_DATA) + alignment - 1) / alignment * alignment;
+
+		glGenBuffers(1, &m_frameDataUBO);
+		glBindBuffer(GL_UNIFORM_BUFFER, m_frameDataUBO);
+		glBufferData(GL_UNIFORM_BUFFER, m_frameDataStride * (1 + MAX_EXTRA_VIEWS), NULL, GL_DYNAMIC_DRAW);
+		GPUMemory::TrackBuffer(m_frameDataUBO, m_frameDataStride * (1 + MAX_EXTRA_VIEWS), GPUMemory::CATEGORY_BUFFER, "frame data");
+		BindView(0);
+		m_bHasUploadedViews = false;
+	}
+
+	glBindBuffer(GL_UNIFORM_BUFFER, m_frameDataUBO);
+	for (int view = 0; view < packet.viewCount; view++)
+	{
+		if ((m_bHasUploadedViews == false) ||
+			(memcmp(&packet.views[view], &m_uploadedViews[view], sizeof(FRAME_DATA)) != 0))
+		{
+			glBufferSubData(GL_UNIFORM_BUFFER, view * m_frameDataStride, sizeof(FRAME_DATA), &packet.views[view]);
+			m_uploadedViews[view] = packet.views[view];
+		}
+	}
+
+	// the eye cameras change together with the frame camera
+	if (packet.bStereo == true)
+	{
+		bool bWrite = (m_bHasUploadedViews == false);
+		if (0 == m_stereoDataUBO)
+		{
+			glGenBuffers(1, &m_stereoDataUBO);
+			glBindBuffer(GL_UNIFORM_BUFFER, m_stereoDataUBO);
+			glBufferData(GL_UNIFORM_BUFFER, sizeof(STEREO_DATA), NULL, GL_DYNAMIC_DRAW);
+			GPUMemory::TrackBuffer(m_stereoDataUBO, sizeof(STEREO_DATA), GPUMemory::CATEGORY_BUFFER, "stereo data");
+			glBindBufferBase(GL_UNIFORM_BUFFER, ShaderManager::STEREO_DATA_BINDING, m_stereoDataUBO);
+			bWrite = true;
+		}
+		if ((bWrite == true) ||
+			(memcmp(&packet.stereoData, &m_uploadedStereoData, sizeof(STEREO_DATA)) != 0))
+		{
+			glBindBuffer(GL_UNIFORM_BUFFER, m_stereoDataUBO);
+			glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(STEREO_DATA), &packet.stereoData);
+			m_uploadedStereoData = packet.stereoData;
+		}
+	}
+	m_bHasUploadedViews = true;
+}
+
+/***********************************************************
+ *  GetFramebufferWidth()
+ *
+ *  This method is used for getting the width in pixels of
+ *  the window framebuffer, as of the last resize event.
+ ***********************************************************/
+int ViewManager::GetFramebufferWidth() const
+{
+	return(gFramebufferWidth);
+}
+
+/***********************************************************
+ *  GetFramebufferHeight()
+ *
+ *  This method is used for getting the height in pixels of
+ *  the window framebuffer, as of the last resize event.
+ ***********************************************************/
+int ViewManager::GetFramebufferHeight() const
+{
+	return(gFramebufferHeight);
+}
+
+/***********************************************************
+ *  SetReverseZ()
+ *
+ *  This method is used for switching to a reverse-Z
+ *  projection, which needs glClipControl() to keep the
+ *  clip depth at 0..1 instead of folding it into -1..1,
+ *  where the precision near 1 would be lost. Without it the
+ *  standard projection is kept.
+ ***********************************************************/
+void ViewManager::SetReverseZ(bool bEnable)
+{
+	if ((bEnable == true) && (GLEW_VERSION_4_5 != GL_TRUE) && (GLEW_ARB_clip_control != GL_TRUE))
+	{
+		bEnable = false;
+	}
+	m_bReverseZ = bEnable;
+}
+
+/***********************************************************
+ *  StartPathRecording()
+ *
+ *  This method is used for recording the camera path from
+ *  the next frame on, for SavePathRecording() to write into
+ *  the given file.
+ ***********************************************************/
+void ViewManager::StartPathRecording(const char* filename)
+{
+	m_pathFilename = filename;
+	m_cameraPath.StartRecording();
+	gPathPlayback = false;
+}
+
+/***********************************************************
+ *  SavePathRecording()
+ *
+ *  This method is used for writing the recorded camera
+ *  path. Returns false when nothing was recorded or the
+ *  file could not be written.
+ ***********************************************************/
+bool ViewManager::SavePathRecording()
+{
+	if (m_cameraPath.IsRecording() == false)
+	{
+		return(false);
+	}
+	return(m_cameraPath.Save(m_pathFilename.c_str()));
+}
+
+/***********************************************************
+ *  StartPathPlayback()
+ *
+ *  This method is used for playing a recorded camera path
+ *  back in place of the keyboard and mouse, one step per
+ *  frame. Returns false when the path could not be read.
+ ***********************************************************/
+bool ViewManager::StartPathPlayback(const char* filename)
+{
+	m_pathFilename = filename;
+	gPathPlayback = m_cameraPath.Load(filename);
+	return(gPathPlayback);
+}
+
+/***********************************************************
+ *  PlayPathStep()
+ *
+ *  This method is used for moving the camera to the next
+ *  step of the played back path, after the key presses
+ *  recorded before it.
+ ***********************************************************/
+void ViewManager::PlayPathStep()
+{
+	std::vector<int> keys;
+	CameraPath::CAMERA_POSE pose;
+	if (m_cameraPath.NextStep(keys, pose) == false)
+	{
+		return;
+	}
+
+	for (size_t i = 0; i < keys.size(); i++)
+	{
+		ProcessKeyPress(keys[i]);
+	}
+
+	SetCameraPose(pose);
+}
+
+/***********************************************************
+ *  SetCameraPose()
+ *
+ *  This method is used for placing the camera at a pose,
+ *  from a path step or a render request. The pose is taken
+ *  as it is, so the frame shows it without blending toward
+ *  it, and the frame counts as changed for render on demand.
+ ***********************************************************/
+void ViewManager::SetCameraPose(const CameraPath::CAMERA_POSE& pose)
+{
+	g_pCamera->Position = pose.position;
+	g_pCamera->Front = pose.front;
+	g_pCamera->Up = pose.up;
+	g_pCamera->Right = glm::normalize(glm::cross(pose.front, g_pCamera->WorldUp));
+	g_pCamera->Yaw = pose.yaw;
+	g_pCamera->Pitch = pose.pitch;
+	g_pCamera->Zoom = pose.zoom;
+	bOrthographicProjection = pose.bOrthographic;
+	gPreviousCameraPosition = pose.position;
+	gPreviousCameraZoom = pose.zoom;
+	gStepAccumulator = 0.0;
+	gInputReceived = true;
+}
+
+/***********************************************************
+ *  ApplyRemoteFrame()
+ *
+ *  This method is used for taking a frame of the master of
+ *  a wall: its key presses act as a played back path's do,
+ *  and its render camera is taken as it is.
+ ***********************************************************/
+void ViewManager::ApplyRemoteFrame(const std::vector<int>& keys, const CameraPath::CAMERA_POSE& pose)
+{
+	for (size_t i = 0; i < keys.size(); i++)
+	{
+		ProcessKeyPress(keys[i]);
+	}
+	SetCameraPose(pose);
+}
+
+/***********************************************************
+ *  GetRenderCameraPose()
+ *
+ *  This method is used for getting the camera the last
+ *  frame was rendered from, between its simulation steps,
+ *  which the nodes of a wall render from too.
+ ***********************************************************/
+CameraPath::CAMERA_POSE ViewManager::GetRenderCameraPose() const
+{
+	CameraPath::CAMERA_POSE pose;
+	pose.position = m_renderCamera.Position;
+	pose.front = m_renderCamera.Front;
+	pose.up = m_renderCamera.Up;
+	pose.yaw = m_renderCamera.Yaw;
+	pose.pitch = m_renderCamera.Pitch;
+	pose.zoom = m_renderCamera.Zoom;
+	pose.bOrthographic = bOrthographicProjection;
+	return(pose);
+}
+
+/***********************************************************
+ *  SetWallTile()
+ *
+ *  This method is used for narrowing the main view to one
+ *  tile of a wall. The projection is made for the aspect of
+ *  the whole wall, and the tile's part of its clip space is
+ *  scaled up to fill the view; off axis for every tile but
+ *  a center one, so the tiles join into one picture.
+ ***********************************************************/
+void ViewManager::SetWallTile(int columns, int rows, int column, int row)
+{
+	columns = glm::max(columns, 1);
+	rows = glm::max(rows, 1);
+	column = glm::clamp(column, 0, columns - 1);
+	row = glm::clamp(row, 0, rows - 1);
+
+	// x' = columns * x + (columns - 1 - 2 * column) * w, and so for
+	// y with the rows counted from the top
+	m_wallTile = glm::mat4(1.0f);
+	m_wallTile[0][0] = (float)columns;
+	m_wallTile[1][1] = (float)rows;
+	m_wallTile[3][0] = (float)(columns - 1 - 2 * column);
+	m_wallTile[3][1] = (float)(2 * row - (rows - 1));
+	m_wallAspectScale = (float)columns / (float)rows;
+	m_bProjectionCached = false;
+}
+
+/***********************************************************
+ *  GetCameraPose()
+ *
+ *  This method is used for getting the camera state the
+ *  path records after a simulation step.
+ ***********************************************************/
+CameraPath::CAMERA_POSE ViewManager::GetCameraPose() const
+{
+	CameraPath::CAMERA_POSE pose;
+	pose.position = g_pCamera->Position;
+	pose.front = g_pCamera->Front;
+	pose.up = g_pCamera->Up;
+	pose.yaw = g_pCamera->Yaw;
+	pose.pitch = g_pCamera->Pitch;
+	pose.zoom = g_pCamera->Zoom;
+	pose.bOrthographic = bOrthographicProjection;
+	return(pose);
+}
 
-	// define the current projection matrix if bOrthographicProjection is enabled (modified in ProcessKeyboardEvents()
-	if (bOrthographicProjection) // Orthographic(2D) View
+/***********************************************************
+ *  MakeProjection()
+ *
+ *  This method is used for building the projection of a
+ *  view, orthographic or perspective with the field of view
+ *  of the zoom, for the aspect of its viewport and the
+ *  depth convention.
+ ***********************************************************/
+glm::mat4 ViewManager::MakeProjection(bool bOrthographic, float zoom, float aspectRatio) const
+{
+	glm::mat4 projection;
+	if (bOrthographic == true) // Orthographic(2D) View
 	{
-		// apply an orthographic matrix transformation to the projection matrix
-		projection = glm::ortho(-9.0f, 9.0f, -7.0f, 7.0f, -1.0f, 30.0f);
+		// apply an orthographic matrix transformation to the projection matrix,
+		// widened or narrowed to the viewport aspect
+		float orthoHalfWidth = ORTHO_HALF_HEIGHT * aspectRatio;
+		projection = glm::ortho(-orthoHalfWidth, orthoHalfWidth, -ORTHO_HALF_HEIGHT, ORTHO_HALF_HEIGHT, ORTHO_NEAR_PLANE, ORTHO_FAR_PLANE);
+		if (m_bReverseZ == true)
+		{
+			// map the near plane to depth 1 and the far plane to 0
+			projection[2][2] = 1.0f / (ORTHO_FAR_PLANE - ORTHO_NEAR_PLANE);
+			projection[3][2] = ORTHO_FAR_PLANE / (ORTHO_FAR_PLANE - ORTHO_NEAR_PLANE);
+		}
+	}
+	else if (m_bReverseZ == true) // Perspective(3D) view, reverse-Z
+	{
+		// the depth is near / distance, 1 at the near plane and
+		// falling toward 0 at infinity, which spreads the precision
+		// of a floating point depth buffer evenly over the distance
+		float focal = 1.0f / glm::tan(glm::radians(zoom) * 0.5f);
+		projection = glm::mat4(0.0f);
+		projection[0][0] = focal / aspectRatio;
+		projection[1][1] = focal;
+		projection[2][3] = -1.0f;
+		projection[3][2] = PERSPECTIVE_NEAR_PLANE;
 	}
 	else // Perspective(3D) view
 	{
-		projection = glm::perspective(glm::radians(g_pCamera->Zoom), (GLfloat)WINDOW_WIDTH / (GLfloat)WINDOW_HEIGHT, 0.1f, 100.0f);
+		projection = glm::perspective(glm::radians(zoom), aspectRatio, PERSPECTIVE_NEAR_PLANE, PERSPECTIVE_FAR_PLANE);
 	}
 
-	// if the shader manager object is valid
-	if (NULL != m_pShaderManager)
+	return(projection);
+}
+
+/***********************************************************
+ *  AddView()
+ *
+ *  This method is used for adding an extra view of the
+ *  scene from one of the preset cameras, drawn over a
+ *  corner of the frame after the main view. The extra views
+ *  stack down the right edge in the order they were added.
+ *  Returns false for an unknown preset or when every
+ *  corner is taken.
+ ***********************************************************/
+bool ViewManager::AddView(const char* presetName)
+{
+	return(AddExtraView(presetName, false));
+}
+
+/***********************************************************
+ *  AddWindowView()
+ *
+ *  This method is used for adding an extra view of the
+ *  scene from one of the preset cameras, shown in a window
+ *  of its own. The view is drawn by the rendering context
+ *  with the rest of the frame and presented into its
+ *  window along with the main one, so every window shows
+ *  the same frame of the scene. Returns false for an
+ *  unknown preset, when every view is taken or when the
+ *  window could not be created.
+ ***********************************************************/
+bool ViewManager::AddWindowView(const char* presetName)
+{
+	return(AddExtraView(presetName, true));
+}
+
+/***********************************************************
+ *  AddExtraView()
+ *
+ *  This method is used for adding an extra view of either
+ *  kind; the views drawn over the frame take the corners
+ *  in order, skipping the ones in windows.
+ ***********************************************************/
+bool ViewManager::AddExtraView(const char* presetName, bool bWindow)
+{
+	if ((int)m_extraViews.size() >= MAX_EXTRA_VIEWS)
 	{
-		// set the view matrix into the shader for proper rendering
-		m_pShaderManager->setMat4Value(g_ViewName, view);
-		// set the view matrix into the shader for proper rendering
-		m_pShaderManager->setMat4Value(g_ProjectionName, projection);
-		// set the view position of the camera into the shader for proper rendering
-		m_pShaderManager->setVec3Value("viewPosition", g_pCamera->Position);
+		std::cout << "No room for the " << presetName << " view, at most " << MAX_EXTRA_VIEWS << " extra views" << std::endl;
+		return(false);
 	}
-}
\ No newline at end of file
+
+	for (int i = 0; i < VIEW_PRESET_COUNT; i++)
+	{
+		if (strcmp(VIEW_PRESETS[i].name, presetName) != 0)
+		{
+			continue;
+		}
+
+		EXTRA_VIEW extraView;
+		extraView.position = VIEW_PRESETS[i].position;
+		extraView.front = glm::normalize(VIEW_PRESETS[i].front);
+		extraView.up = VIEW_PRESETS[i].up;
+		extraView.zoom = VIEW_PRESETS[i].zoom;
+		extraView.bOrthographic = VIEW_PRESETS[i].bOrthographic;
+		int slot = 0;
+		for (size_t j = 0; j < m_extraViews.size(); j++)
+		{
+			slot += (NULL == m_extraViews[j].pWindow) ? 1 : 0;
+		}
+		extraView.rect = glm::vec4(1.0f - EXTRA_VIEW_MARGIN - EXTRA_VIEW_SIZE,
+			1.0f - (slot + 1) * (EXTRA_VIEW_SIZE + EXTRA_VIEW_MARGIN), EXTRA_VIEW_SIZE, EXTRA_VIEW_SIZE);
+		extraView.pWindow = NULL;
+		extraView.windowAspectRatio = 1.0f;
+		if (bWindow == true)
+		{
+			extraView.pWindow = new ViewWindow();
+			if (extraView.pWindow->Create(m_pWindow, presetName) == false)
+			{
+				delete extraView.pWindow;
+				return(false);
+			}
+			// keys pressed over the window act as over the main one
+			glfwSetKeyCallback(extraView.pWindow->GetWindow(), &ViewManager::Key_Callback);
+			glfwSetWindowRefreshCallback(extraView.pWindow->GetWindow(), &ViewManager::Window_Refresh_Callback);
+			if ((extraView.pWindow->GetWidth() > 0) && (extraView.pWindow->GetHeight() > 0))
+			{
+				extraView.windowAspectRatio = (float)extraView.pWindow->GetWidth() / (float)extraView.pWindow->GetHeight();
+			}
+		}
+		memset(&extraView.frameData, 0, sizeof(FRAME_DATA));
+		m_extraViews.push_back(extraView);
+		return(true);
+	}
+
+	std::cout << "Unknown view " << presetName << std::endl;
+	return(false);
+}
+
+/***********************************************************
+ *  GetViewWindow()
+ *
+ *  This method is used for getting the window a view is
+ *  shown in, NULL when it is drawn over the frame.
+ ***********************************************************/
+ViewWindow* ViewManager::GetViewWindow(int view) const
+{
+	if ((view > 0) && (view <= (int)m_extraViews.size()))
+	{
+		return(m_extraViews[view - 1].pWindow);
+	}
+	return(NULL);
+}
+
+/***********************************************************
+ *  GetViewRect()
+ *
+ *  This method is used for getting the viewport of a view
+ *  in a frame of the given size, the whole frame for the
+ *  main view.
+ ***********************************************************/
+void ViewManager::GetViewRect(int view, int frameWidth, int frameHeight, GLint rect[4]) const
+{
+	glm::vec4 fraction(0.0f, 0.0f, 1.0f, 1.0f);
+	if ((view > 0) && (view <= (int)m_extraViews.size()))
+	{
+		fraction = m_extraViews[view - 1].rect;
+	}
+	rect[0] = (GLint)(fraction.x * frameWidth);
+	rect[1] = (GLint)(fraction.y * frameHeight);
+	rect[2] = glm::max((GLint)(fraction.z * frameWidth), 1);
+	rect[3] = glm::max((GLint)(fraction.w * frameHeight), 1);
+}
+
+/***********************************************************
+ *  GetViewFrameData()
+ *
+ *  This method is used for getting the FrameData block of a
+ *  view, the one of the main view for view 0.
+ ***********************************************************/
+const ViewManager::FRAME_DATA& ViewManager::GetViewFrameData(int view) const
+{
+	if ((view > 0) && (view <= (int)m_extraViews.size()))
+	{
+		return(m_extraViews[view - 1].frameData);
+	}
+	if (m_bStereo == true)
+	{
+		return(m_stereoFrameData);
+	}
+	return(m_frameData);
+}
+
+/***********************************************************
+ *  BindView()
+ *
+ *  This method is used for pointing the FrameData block of
+ *  the shaders at the slot of a view, for the draws of that
+ *  view that follow.
+ ***********************************************************/
+void ViewManager::BindView(int view)
+{
+	if ((0 == m_frameDataUBO) || (view < 0) || (view > (int)m_extraViews.size()))
+	{
+		return;
+	}
+	glBindBufferRange(GL_UNIFORM_BUFFER, ShaderManager::FRAME_DATA_BINDING, m_frameDataUBO,
+		view * m_frameDataStride, sizeof(FRAME_DATA));
+}
+
+/***********************************************************
+ *  UpdateStereoViews()
+ *
+ *  This method is used for deriving the camera of each eye
+ *  from the camera of the frame, moved half of the eye
+ *  separation to its side, and the view enclosing both
+ *  eyes, which the draws are culled and the lights
+ *  clustered against. The enclosing perspective view moves
+ *  back until its frustum takes in both of the eyes; an
+ *  orthographic one widens by half the separation. The
+ *  camera position of the block stays between the eyes for
+ *  the lighting.
+ ***********************************************************/
+void ViewManager::UpdateStereoViews()
+{
+	if (m_bStereo == false)
+	{
+		return;
+	}
+
+	const glm::mat4& projection = m_frameData.projection;
+	float halfSeparation = m_eyeSeparation * 0.5f;
+	for (int eye = 0; eye < 2; eye++)
+	{
+		// the left eye sits to the left, so the scene moves right
+		float eyeOffset = (eye == 0) ? -halfSeparation : halfSeparation;
+		m_stereoData.eyeView[eye] = glm::translate(glm::vec3(-eyeOffset, 0.0f, 0.0f)) * m_frameData.view;
+		m_stereoData.eyeProjection[eye] = projection;
+	}
+
+	m_stereoFrameData = m_frameData;
+	if (projection[2][3] == 0.0f)
+	{
+		// orthographic, half the width is 1 / projection[0][0]
+		m_stereoFrameData.projection[0][0] = 1.0f / (1.0f / projection[0][0] + halfSeparation);
+	}
+	else
+	{
+		// the eye frusta are each half the separation off the center,
+		// which a frustum of the same angle covers from this far back
+		float backOffset = halfSeparation * projection[0][0];
+		m_stereoFrameData.view = glm::translate(glm::vec3(0.0f, 0.0f, -backOffset)) * m_frameData.view;
+	}
+}
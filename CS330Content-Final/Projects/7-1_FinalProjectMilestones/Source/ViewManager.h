@@ -12,12 +12,22 @@
 
 #pragma once
 
+#include "CameraPath.h"
+#include "FramePacer.h"
 #include "ShaderManager.h"
+#include "ShadowAtlas.h"
+#include "TextureTable.h"
+#include "PostStack.h"
+#include "ViewWindow.h"
 #include "camera.h"
 
 // GLFW library
 #include "GLFW/glfw3.h" 
 
+#include <cstdint>
+#include <string>
+#include <vector>
+
 class ViewManager
 {
 public:
@@ -27,29 +37,396 @@ public:
 	// destructor
 	~ViewManager();
 
+	// time from the first input a frame took to its present
+	struct LATENCY_STATS
+	{
+		unsigned long long frames;		// frames that took input
+		double totalSeconds;
+		double maxSeconds;
+	};
+
+	// cursor movement events against the camera updates they were
+	// applied in, since the start
+	struct MOUSE_STATS
+	{
+		unsigned long long events;			// cursor positions reported
+		unsigned long long updates;			// camera turns they were summed into
+		unsigned long long maxEvents;		// most events of one update
+	};
+
 	// mouse position callback for mouse interaction with the 3D scene
 	static void Mouse_Position_Callback(GLFWwindow* window, double xMousePos, double yMousePos);
 
+	// move the mouse look by an offset in pixels, as the mouse
+	// position callback would, for input from elsewhere than the
+	// window; called on the thread that owns the window, and
+	// applied with the window's own movement of the next tick
+	static void InjectMouseMovement(double xOffset, double yOffset);
+
 	// mouse scroll wheel call back for scroll wheel interaction with scene controls
 	static void Mouse_Scroll_Wheel_Callback(GLFWwindow* window, double xOffset, double yOffset);
 
+	// mouse button callback asking for a pick with the left button
+	static void Mouse_Button_Callback(GLFWwindow* window, int button, int action, int mods);
+
 	// frame buffer window callback for resizing frame buffer
-	static void Window_Resize_Callback(GLFWwindow* window, double x, double y);
+	static void Window_Resize_Callback(GLFWwindow* window, int width, int height);
+
+	// key callback queueing key presses and tracking the held keys
+	static void Key_Callback(GLFWwindow* window, int key, int scancode, int action, int mods);
+
+	// window refresh callback for redrawing damaged window contents
+	static void Window_Refresh_Callback(GLFWwindow* window);
+
+	// most views drawn after the main view, over the frame or in
+	// windows of their own
+	static const int MAX_EXTRA_VIEWS = 3;
+
+	// std140 layout of the FrameData uniform block read by the shaders
+	struct FRAME_DATA
+	{
+		glm::mat4 view;
+		glm::mat4 projection;
+		glm::vec4 viewPosition;		// xyz = camera position, w = 1 with reverse-Z depth
+	};
+	// std140 layout of the StereoData uniform block, the camera of
+	// each eye of a multiview frame
+	struct STEREO_DATA
+	{
+		glm::mat4 eyeView[2];
+		glm::mat4 eyeProjection[2];
+	};
+
+	// everything the rendering of a frame takes from the input and
+	// simulation of PrepareSceneView(), copied so the frame can be
+	// rendered while the next one is prepared
+	struct FRAME_PACKET
+	{
+		// FrameData block of every view, the main one first, which
+		// in stereo encloses both eyes
+		FRAME_DATA views[1 + MAX_EXTRA_VIEWS];
+		int viewCount;
+		// framebuffer size of the window of each view, zero for the
+		// views drawn over the frame and while a window is minimized
+		int viewWindowWidth[1 + MAX_EXTRA_VIEWS];
+		int viewWindowHeight[1 + MAX_EXTRA_VIEWS];
+		STEREO_DATA stereoData;
+		bool bStereo;
+		// render modes
+		bool bDepthPrepass;
+		bool bDeferredShading;
+		bool bVariableRateShading;
+		bool bReverseZ;
+		bool bRenderOnDemand;
+		int shadowQuality;
+		int textureFilterQuality;
+		int antiAliasing;
+		int presentMode;
+		// window framebuffer size, zero while minimized
+		int framebufferWidth;
+		int framebufferHeight;
+		// true after input, a mode change or a camera move
+		bool bViewChanged;
+		// time of the first input the frame took, negative for none
+		double inputTime;
+		// id of the newest input of a remote viewer the frame took,
+		// 0 for none, set by the main loop
+		uint32_t streamInputId;
+		// save the frame as an image, once or as part of the video
+		bool bScreenshot;
+		bool bVideoCapture;
+		// draw the pass timings and counters over the frame
+		bool bStatsOverlay;
+		// pick the object at the center of the main view, where the
+		// captured cursor aims, asked for with a left click
+		bool bPick;
+	};
 
 private:
 	// pointer to shader manager object
 	ShaderManager* m_pShaderManager;
 	// active OpenGL display window
 	GLFWwindow* m_pWindow;
+	// FRAME_DATA of the last PrepareSceneView(), and the uniform
+	// buffer of the rendered frames
+	FRAME_DATA m_frameData;
+	GLuint m_frameDataUBO;
+	// bytes from one view's slot of the buffer to the next
+	GLintptr m_frameDataStride;
+	// blocks last written into the buffers, so a frame only writes
+	// the ones that changed
+	FRAME_DATA m_uploadedViews[1 + MAX_EXTRA_VIEWS];
+	STEREO_DATA m_uploadedStereoData;
+	bool m_bHasUploadedViews;
+	// true while the frame renders both eyes in one multiview pass,
+	// and the distance between the eyes in scene units
+	bool m_bStereo;
+	float m_eyeSeparation;
+	// eye cameras of the frame, and the FrameData block enclosing
+	// both of them, which the draws are culled against
+	STEREO_DATA m_stereoData;
+	FRAME_DATA m_stereoFrameData;
+	GLuint m_stereoDataUBO;
+	// a view from a fixed camera, drawn over a part of the frame
+	struct EXTRA_VIEW
+	{
+		glm::vec3 position;
+		glm::vec3 front;
+		glm::vec3 up;
+		float zoom;
+		bool bOrthographic;
+		// x, y, width and height as fractions of the frame
+		glm::vec4 rect;
+		// window the view is shown in instead, and the aspect of its
+		// framebuffer, kept while it is minimized
+		ViewWindow* pWindow;
+		float windowAspectRatio;
+		FRAME_DATA frameData;
+	};
+	std::vector<EXTRA_VIEW> m_extraViews;
+	// camera the frame is rendered from, which caches its view matrix
+	Camera m_renderCamera;
+	// projection inputs of m_frameData.projection
+	bool m_bProjectionCached;
+	bool m_bCachedOrthographic;
+	bool m_bCachedReverseZ;
+	float m_cachedZoom;
+	float m_cachedAspectRatio;
+	// render mode toggled from the keyboard, read by the main loop
+	bool m_bDepthPrepass;
+	// deferred shading mode, toggled with the G key
+	bool m_bDeferredShading;
+	// coarse lighting of the low-detail tiles, toggled with the C key
+	bool m_bVariableRateShading;
+	// shadow filtering level, cycled with the X key
+	int m_shadowQuality;
+	// texture filtering level, cycled with the F key
+	int m_textureFilterQuality;
+	// anti-aliasing mode, cycled with the M key
+	int m_antiAliasing;
+	// render only frames that differ, toggled with the I key
+	bool m_bRenderOnDemand;
+	// presentation mode, cycled with the V key
+	int m_presentMode;
+	// sample the mouse look again right before the draws
+	bool m_bLateLatch;
+	// raw mouse motion asked for, and supported
+	bool m_bRawMouseMotion;
+	// reverse-Z infinite far projection, toggled with the R key
+	bool m_bReverseZ;
+	// screenshot asked for with the F12 key, handed to the next
+	// packet, and video capture, toggled with the F10 key
+	bool m_bScreenshotRequested;
+	bool m_bVideoCapture;
+	// stats overlay, toggled with the F3 key
+	bool m_bStatsOverlay;
+	// time of the first input the frame being rendered took,
+	// negative when it took none
+	double m_frameInputTime;
+	// true when the last PrepareSceneView() saw input or a new view
+	bool m_bViewChanged;
+	LATENCY_STATS m_latencyStats;
+	// width over height of the framebuffer the projection is for
+	float m_aspectRatio;
+	// camera path recorded or played back, and its file
+	CameraPath m_cameraPath;
+	std::string m_pathFilename;
+	// the camera and the key presses come from the master of a
+	// video wall instead of the input
+	bool m_bRemoteCamera;
+	// key presses acted on in the last PrepareSceneView()
+	std::vector<int> m_frameKeys;
+	// part of the wall frustum the main view shows, applied after
+	// its projection
+	glm::mat4 m_wallTile;
+	float m_wallAspectScale;
 
-	// process keyboard events for interaction with the 3D scene
+	// process the queued key events for interaction with the 3D scene
 	void ProcessKeyboardEvents();
+	// turn the camera once by the cursor movement summed since the
+	// last tick
+	void ApplyMouseMovement();
+	// advance the camera movement by one fixed step
+	void UpdateSimulation(float stepSeconds);
+	// move the time of the pending input to the frame
+	void TakeInputTime();
+	// place the render camera with the input camera's orientation
+	void SetRenderCamera(const glm::vec3& position);
+	// act on one key press, from the keyboard or a played back path
+	void ProcessKeyPress(int key);
+	// move the camera to the next step of the played back path
+	void PlayPathStep();
+	// camera state recorded after a simulation step
+	CameraPath::CAMERA_POSE GetCameraPose() const;
+	// projection of a view for the aspect of its viewport
+	glm::mat4 MakeProjection(bool bOrthographic, float zoom, float aspectRatio) const;
+	// FrameData block of a view, the main one for view 0
+	const FRAME_DATA& GetViewFrameData(int view) const;
+	// derive the eye cameras and their enclosing view from the
+	// camera of the frame
+	void UpdateStereoViews();
+	// add an extra view from a preset camera, over the frame or in
+	// a window of its own
+	bool AddExtraView(const char* presetName, bool bWindow);
 
 
 public:
 	// create the initial OpenGL display window
 	GLFWwindow* CreateDisplayWindow(const char* windowTitle);
+	// create a hidden window holding only the OpenGL context, for
+	// frames of the given size rendered offscreen
+	GLFWwindow* CreateHeadlessWindow(int width, int height);
 	
 	// prepare the conversion from 3D object display to 2D scene display
 	void PrepareSceneView();
+	// copy what rendering the prepared frame needs, handing it the
+	// input time of the frame
+	void GetFramePacket(FRAME_PACKET& packet);
+	// write the FrameData blocks of a frame that is rendered, when
+	// they changed since the last write
+	void UploadFramePacket(const FRAME_PACKET& packet);
+	// rebuild the view matrix from the newest mouse look, after the
+	// draws are built, and update the blocks of the packet; true
+	// when the frame data changed
+	bool LatchCamera(FRAME_PACKET& packet);
+	// end the input-to-present latency of a presented frame
+	void FramePresented(double inputTime);
+	// input-to-present latency of the frames presented so far
+	const LATENCY_STATS& GetLatencyStats() const { return(m_latencyStats); }
+
+	// cursor events summed into each camera update so far
+	static const MOUSE_STATS& GetMouseStats();
+
+	// read the mouse motion unscaled and unaccelerated by the system,
+	// where the platform supports it, while the cursor is captured
+	void SetRawMouseMotion(bool bEnable);
+	bool GetRawMouseMotion() const { return(m_bRawMouseMotion); }
+
+	// sample the mouse look again right before the draws are submitted
+	void SetLateLatch(bool bEnable) { m_bLateLatch = bEnable; }
+	bool GetLateLatch() const { return(m_bLateLatch); }
+
+	// reverse-Z depth with an infinite far plane, toggled with the R
+	// key; stays off when the driver cannot clip depth to 0..1
+	void SetReverseZ(bool bEnable);
+	bool GetReverseZ() const { return(m_bReverseZ); }
+
+	// record the camera path into a file, written by
+	// SavePathRecording() when the application closes
+	void StartPathRecording(const char* filename);
+	bool SavePathRecording();
+	// play a recorded camera path back in place of the input, one
+	// fixed step per frame; false when it could not be read
+	bool StartPathPlayback(const char* filename);
+	// true once the frame after the last step of the played back
+	// path was prepared
+	bool IsPathPlaybackFinished() const { return(m_cameraPath.IsFinished()); }
+	const CameraPath& GetCameraPath() const { return(m_cameraPath); }
+	// place the camera at a pose as it is, as a path step does
+	void SetCameraPose(const CameraPath::CAMERA_POSE& pose);
+	// size of the frames of a headless window, from the next frame
+	void SetHeadlessSize(int width, int height);
+
+	// show the tile of a wall of columns x rows displays, counted
+	// from the top left, of the frustum the camera has over the
+	// whole wall; the displays are taken to be alike
+	void SetWallTile(int columns, int rows, int column, int row);
+	// take the camera and the key presses of each frame from
+	// ApplyRemoteFrame() instead of the input
+	void SetRemoteCamera(bool bEnable) { m_bRemoteCamera = bEnable; }
+	// act on the key presses of the master's frame and take its
+	// camera, before PrepareSceneView()
+	void ApplyRemoteFrame(const std::vector<int>& keys, const CameraPath::CAMERA_POSE& pose);
+	// the key presses and the camera of the last PrepareSceneView(),
+	// for the nodes of a wall
+	const std::vector<int>& GetFrameKeys() const { return(m_frameKeys); }
+	CameraPath::CAMERA_POSE GetRenderCameraPose() const;
+
+	// camera position of the last PrepareSceneView()
+	glm::vec3 GetViewPosition() const { return(glm::vec3(m_frameData.viewPosition)); }
+	// view and projection matrices of the last PrepareSceneView(),
+	// in stereo the ones enclosing both eyes
+	glm::mat4 GetViewMatrix() const { return(GetViewFrameData(0).view); }
+	glm::mat4 GetProjectionMatrix() const { return(GetViewFrameData(0).projection); }
+
+	// render both eyes of a stereo frame in one multiview pass; the
+	// shaders must be built for it, so it is set before the first frame
+	void SetStereo(bool bEnable) { m_bStereo = bEnable; }
+	bool IsStereo() const { return(m_bStereo); }
+	// distance between the eyes in scene units
+	void SetEyeSeparation(float separation) { m_eyeSeparation = glm::max(separation, 0.0f); }
+	float GetEyeSeparation() const { return(m_eyeSeparation); }
+
+	// add an extra view from a preset camera, front, top or detail,
+	// drawn over the frame after the main view
+	bool AddView(const char* presetName);
+	// add an extra view from a preset camera shown in a window of
+	// its own, sharing the meshes, textures and programs of the
+	// main one; made while the rendering context is current on the
+	// main thread, before any frame
+	bool AddWindowView(const char* presetName);
+	// window of a view, NULL for the main view and the views drawn
+	// over the frame
+	ViewWindow* GetViewWindow(int view) const;
+	// views of the frame, the main view being view 0
+	int GetViewCount() const { return(1 + (int)m_extraViews.size()); }
+	// viewport of a view in a frame of the given size
+	void GetViewRect(int view, int frameWidth, int frameHeight, GLint rect[4]) const;
+	// camera position and matrices of a view
+	glm::vec3 GetViewPosition(int view) const { return(glm::vec3(GetViewFrameData(view).viewPosition)); }
+	glm::mat4 GetViewMatrix(int view) const { return(GetViewFrameData(view).view); }
+	glm::mat4 GetProjectionMatrix(int view) const { return(GetViewFrameData(view).projection); }
+	// point the FrameData block of the shaders at a view
+	void BindView(int view);
+
+	// depth pre-pass mode, toggled with the Z key
+	void SetDepthPrepass(bool bEnable) { m_bDepthPrepass = bEnable; }
+	bool GetDepthPrepass() const { return(m_bDepthPrepass); }
+
+	// deferred shading mode, toggled with the G key
+	void SetDeferredShading(bool bEnable) { m_bDeferredShading = bEnable; }
+	bool GetDeferredShading() const { return(m_bDeferredShading); }
+
+	// coarse lighting of the low-detail tiles of the deferred path,
+	// toggled with the C key
+	void SetVariableRateShading(bool bEnable) { m_bVariableRateShading = bEnable; }
+	bool GetVariableRateShading() const { return(m_bVariableRateShading); }
+
+	// shadow filtering level, a ShadowAtlas::SHADOW_QUALITY
+	void SetShadowQuality(int quality) { m_shadowQuality = glm::clamp(quality, 0, (int)ShadowAtlas::SHADOW_QUALITY_COUNT - 1); }
+	int GetShadowQuality() const { return(m_shadowQuality); }
+
+	// texture filtering level, a TextureTable::FILTER_QUALITY
+	void SetTextureFilterQuality(int quality) { m_textureFilterQuality = glm::clamp(quality, 0, (int)TextureTable::FILTER_QUALITY_COUNT - 1); }
+	int GetTextureFilterQuality() const { return(m_textureFilterQuality); }
+
+	// anti-aliasing of the main view, a PostStack::ANTI_ALIASING,
+	// stepped through with the M key
+	void SetAntiAliasing(int mode) { m_antiAliasing = glm::clamp(mode, 0, (int)PostStack::AA_COUNT - 1); }
+	int GetAntiAliasing() const { return(m_antiAliasing); }
+
+	// skip the frames in which nothing changed and wait for events
+	// instead of rendering continuously, toggled with the I key
+	void SetRenderOnDemand(bool bEnable) { m_bRenderOnDemand = bEnable; }
+	bool GetRenderOnDemand() const { return(m_bRenderOnDemand); }
+
+	// save every rendered frame as an image, toggled with the F10 key
+	void SetVideoCapture(bool bEnable) { m_bVideoCapture = bEnable; }
+	bool GetVideoCapture() const { return(m_bVideoCapture); }
+
+	// draw the pass timings and counters, toggled with the F3 key
+	void SetStatsOverlay(bool bEnable) { m_bStatsOverlay = bEnable; }
+	bool GetStatsOverlay() const { return(m_bStatsOverlay); }
+
+	// presentation mode, a FramePacer::PRESENT_MODE
+	void SetPresentMode(int mode) { m_presentMode = glm::clamp(mode, 0, (int)FramePacer::PRESENT_MODE_COUNT - 1); }
+	int GetPresentMode() const { return(m_presentMode); }
+	// true when the last PrepareSceneView() received input, changed
+	// a render mode or moved the camera
+	bool HasViewChanged() const { return(m_bViewChanged); }
+
+	// current size of the window framebuffer in pixels, zero while
+	// the window is minimized
+	int GetFramebufferWidth() const;
+	int GetFramebufferHeight() const;
 };
\ No newline at end of file
@@ -0,0 +1,268 @@
+///////////////////////////////////////////////////////////////////////////////
+// viewwindow.cpp
+// ============
+// a window of its own showing one of the extra views of the frame
+//
+//  The view is drawn by the rendering context like the views over the
+//  corners of the frame, with the same meshes, textures and programs,
+//  but into a target of its own sized for the window. The window has
+//  a context sharing its objects with the rendering one, which only
+//  copies the finished target to its back buffer and swaps, so the
+//  scene is loaded once however many windows show it.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "ViewWindow.h"
+#include "GPUMemory.h"
+#include "ShapeMeshes.h"
+
+#include <iostream>
+
+namespace
+{
+	// size the window opens at
+	const int VIEW_WINDOW_WIDTH = 800;
+	const int VIEW_WINDOW_HEIGHT = 600;
+}
+
+/***********************************************************
+ *  ViewWindow()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+ViewWindow::ViewWindow()
+{
+	m_pWindow = NULL;
+	m_width = 0;
+	m_height = 0;
+	m_framebuffer = 0;
+	m_colorTexture = 0;
+	m_depthTexture = 0;
+	m_targetWidth = 0;
+	m_targetHeight = 0;
+	m_readFramebuffer = 0;
+	m_readTexture = 0;
+	m_bDrawn = false;
+	m_savedFramebuffer = 0;
+}
+
+/***********************************************************
+ *  ~ViewWindow()
+ *
+ *  The destructor for the class. The target belongs to the
+ *  rendering context, which is current, and the read
+ *  framebuffer to the window's own context.
+ ***********************************************************/
+ViewWindow::~ViewWindow()
+{
+	DestroyTargets();
+	if (NULL != m_pWindow)
+	{
+		if (0 != m_readFramebuffer)
+		{
+			GLFWwindow* pCurrentContext = glfwGetCurrentContext();
+			glfwMakeContextCurrent(m_pWindow);
+			glDeleteFramebuffers(1, &m_readFramebuffer);
+			glfwMakeContextCurrent(pCurrentContext);
+			m_readFramebuffer = 0;
+		}
+		glfwDestroyWindow(m_pWindow);
+		m_pWindow = NULL;
+	}
+}
+
+/***********************************************************
+ *  Create()
+ *
+ *  This method is used for opening the window, with a
+ *  context sharing the textures, buffers and programs of
+ *  the rendering one. The window never waits for the
+ *  vertical blank itself; the frame pacer paces the main
+ *  window, and every window is presented with it.
+ ***********************************************************/
+bool ViewWindow::Create(GLFWwindow* pShareWindow, const char* windowTitle)
+{
+	m_pWindow = glfwCreateWindow(VIEW_WINDOW_WIDTH, VIEW_WINDOW_HEIGHT, windowTitle, NULL, pShareWindow);
+	if (NULL == m_pWindow)
+	{
+		std::cout << "Failed to create the window of the " << windowTitle << " view" << std::endl;
+		return(false);
+	}
+
+	GLFWwindow* pCurrentContext = glfwGetCurrentContext();
+	glfwMakeContextCurrent(m_pWindow);
+	glfwSwapInterval(0);
+	glfwMakeContextCurrent(pCurrentContext);
+
+	UpdateSize();
+	return(true);
+}
+
+/***********************************************************
+ *  UpdateSize()
+ *
+ *  This method is used for reading the framebuffer size of
+ *  the window, once per prepared frame, so the view is
+ *  projected for its aspect.
+ ***********************************************************/
+bool ViewWindow::UpdateSize()
+{
+	int width = 0;
+	int height = 0;
+	if (NULL != m_pWindow)
+	{
+		glfwGetFramebufferSize(m_pWindow, &width, &height);
+	}
+	bool bChanged = (width != m_width) || (height != m_height);
+	m_width = width;
+	m_height = height;
+	return(bChanged);
+}
+
+/***********************************************************
+ *  Begin()
+ *
+ *  This method is used for pointing the draws of the view
+ *  at its target, which is created again whenever the
+ *  window changes its size. The depth is floating point,
+ *  which reverse-Z needs and the standard depth convention
+ *  does not mind.
+ ***********************************************************/
+bool ViewWindow::Begin(int width, int height)
+{
+	if ((width <= 0) || (height <= 0))
+	{
+		return(false);
+	}
+	if ((0 == m_framebuffer) || (width != m_targetWidth) || (height != m_targetHeight))
+	{
+		CreateTargets(width, height);
+	}
+
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &m_savedFramebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+	glViewport(0, 0, m_targetWidth, m_targetHeight);
+	m_bDrawn = true;
+	return(true);
+}
+
+/***********************************************************
+ *  End()
+ *
+ *  This method is used for returning the draws to the
+ *  framebuffer of the frame once the view is drawn.
+ ***********************************************************/
+void ViewWindow::End()
+{
+	glBindFramebuffer(GL_FRAMEBUFFER, (GLuint)m_savedFramebuffer);
+}
+
+/***********************************************************
+ *  Present()
+ *
+ *  This method is used for showing the target in the
+ *  window. A fence put after the draws of the view is
+ *  waited for on the window's context, which then blits
+ *  the shared texture into its back buffer and swaps. The
+ *  framebuffer reading the texture is a container object,
+ *  which contexts do not share, so the window's context
+ *  keeps one of its own.
+ ***********************************************************/
+void ViewWindow::Present()
+{
+	if ((NULL == m_pWindow) || (m_bDrawn == false))
+	{
+		return;
+	}
+	m_bDrawn = false;
+
+	GLsync fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	glFlush();
+
+	GLFWwindow* pRenderContext = glfwGetCurrentContext();
+	glfwMakeContextCurrent(m_pWindow);
+	glWaitSync(fence, 0, GL_TIMEOUT_IGNORED);
+	if (0 == m_readFramebuffer)
+	{
+		glGenFramebuffers(1, &m_readFramebuffer);
+	}
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, m_readFramebuffer);
+	if (m_readTexture != m_colorTexture)
+	{
+		glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_colorTexture, 0);
+		m_readTexture = m_colorTexture;
+	}
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+	glBlitFramebuffer(0, 0, m_targetWidth, m_targetHeight,
+		0, 0, m_targetWidth, m_targetHeight, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glfwSwapBuffers(m_pWindow);
+	glDeleteSync(fence);
+	glfwMakeContextCurrent(pRenderContext);
+}
+
+/***********************************************************
+ *  CreateTargets()
+ *
+ *  This method is used for creating the color and depth
+ *  textures of the view and the framebuffer drawing into
+ *  them, on the rendering context.
+ ***********************************************************/
+void ViewWindow::CreateTargets(int width, int height)
+{
+	DestroyTargets();
+
+	m_targetWidth = width;
+	m_targetHeight = height;
+
+	glGenTextures(1, &m_colorTexture);
+	GLuint previousTexture = ShapeMeshes::BindTextureForEdit(GL_TEXTURE_2D, m_colorTexture);
+	glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, width, height);
+	glGenTextures(1, &m_depthTexture);
+	glBindTexture(GL_TEXTURE_2D, m_depthTexture);
+	glTexStorage2D(GL_TEXTURE_2D, 1, GL_DEPTH_COMPONENT32F, width, height);
+	ShapeMeshes::RestoreTextureBinding(GL_TEXTURE_2D, previousTexture);
+	GPUMemory::TrackTexture(m_colorTexture, GL_RGBA8, width, height, 1, 1,
+		GPUMemory::CATEGORY_RENDER_TARGET, "view window color");
+	GPUMemory::TrackTexture(m_depthTexture, GL_DEPTH_COMPONENT32F, width, height, 1, 1,
+		GPUMemory::CATEGORY_RENDER_TARGET, "view window depth");
+
+	GLint previousFramebuffer = 0;
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previousFramebuffer);
+	glGenFramebuffers(1, &m_framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_colorTexture, 0);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, m_depthTexture, 0);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+	{
+		std::cout << "View window framebuffer is incomplete" << std::endl;
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, (GLuint)previousFramebuffer);
+}
+
+/***********************************************************
+ *  DestroyTargets()
+ *
+ *  This method is used for freeing the framebuffer of the
+ *  view and its textures. A texture still attached to the
+ *  read framebuffer lives on until it is attached again.
+ ***********************************************************/
+void ViewWindow::DestroyTargets()
+{
+	if (0 != m_framebuffer)
+	{
+		glDeleteFramebuffers(1, &m_framebuffer);
+		m_framebuffer = 0;
+	}
+	if (0 != m_colorTexture)
+	{
+		GPUMemory::DeleteTextures(1, &m_colorTexture);
+		m_colorTexture = 0;
+	}
+	// a new texture may reuse the name, so it is attached anew
+	m_readTexture = 0;
+	if (0 != m_depthTexture)
+	{
+		GPUMemory::DeleteTextures(1, &m_depthTexture);
+		m_depthTexture = 0;
+	}
+}
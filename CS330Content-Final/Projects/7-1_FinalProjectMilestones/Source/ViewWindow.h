@@ -0,0 +1,79 @@
+///////////////////////////////////////////////////////////////////////////////
+// viewwindow.h
+// ============
+// a window of its own showing one of the extra views of the frame
+//
+//  The view is drawn by the rendering context like the views over the
+//  corners of the frame, with the same meshes, textures and programs,
+//  but into a target of its own sized for the window. The window has
+//  a context sharing its objects with the rendering one, which only
+//  copies the finished target to its back buffer and swaps, so the
+//  scene is loaded once however many windows show it.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+#include "GLFW/glfw3.h"
+
+/***********************************************************
+ *  ViewWindow
+ *
+ *  This class contains the window of an extra view, its
+ *  color and depth target on the rendering context, and the
+ *  framebuffer its own context reads the target through.
+ *  The window is created and polled on the main thread;
+ *  Begin(), End() and Present() run on the thread that
+ *  renders the frames.
+ ***********************************************************/
+class ViewWindow
+{
+public:
+	// constructor
+	ViewWindow();
+	// destructor, with the rendering context current
+	~ViewWindow();
+
+	// open the window with a context sharing the objects of the
+	// window given, with the rendering context current on this
+	// thread; false when the window could not be created
+	bool Create(GLFWwindow* pShareWindow, const char* windowTitle);
+	GLFWwindow* GetWindow() const { return(m_pWindow); }
+	// read the framebuffer size of the window, zero while it is
+	// minimized; true when it changed since the last call
+	bool UpdateSize();
+	int GetWidth() const { return(m_width); }
+	int GetHeight() const { return(m_height); }
+
+	// bind the target for a window of the given size, with the
+	// viewport over all of it; false while the window has no area
+	bool Begin(int width, int height);
+	// bind the framebuffer bound before Begin() again
+	void End();
+	// copy the target drawn since Begin() into the window and swap,
+	// leaving the rendering context current again
+	void Present();
+
+private:
+	GLFWwindow* m_pWindow;
+	// framebuffer size of the window, read on the main thread
+	int m_width;
+	int m_height;
+	// target of the view on the rendering context
+	GLuint m_framebuffer;
+	GLuint m_colorTexture;
+	GLuint m_depthTexture;
+	int m_targetWidth;
+	int m_targetHeight;
+	// framebuffer of the window's context reading m_colorTexture,
+	// and the texture it was last attached to
+	GLuint m_readFramebuffer;
+	GLuint m_readTexture;
+	// set when the target was drawn since the last Present()
+	bool m_bDrawn;
+	GLint m_savedFramebuffer;
+
+	// size the target for a window
+	void CreateTargets(int width, int height);
+	void DestroyTargets();
+};
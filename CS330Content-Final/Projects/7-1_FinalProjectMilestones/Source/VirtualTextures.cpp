@@ -0,0 +1,1059 @@
+///////////////////////////////////////////////////////////////////////////////
+// virtualtextures.cpp
+// ============
+// page very large surface textures in from tiled files as they are seen
+//
+//  The page tables are one storage buffer: the pixel of each 4x4 block
+//  that writes feedback this frame, the layout of every texture, then
+//  the feedback bits of all the textures followed by their residency
+//  words. The feedback bits are copied out and cleared each frame, and
+//  the copy is read once its fence passed, three frames at most later.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "VirtualTextures.h"
+#include "ImageDecoder.h"
+#include "MipChain.h"
+#include "ShapeMeshes.h"
+#include "GPUMemory.h"
+#include "ScopeProfiler.h"
+#include "Logger.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+namespace
+{
+	// header of a tiled file, followed by the pages of the paged
+	// levels, level after level and row after row from the bottom,
+	// then the levels below them back to back
+	struct VTEX_HEADER
+	{
+		char magic[4];			// "VTEX"
+		uint32_t version;
+		uint32_t width;
+		uint32_t height;
+		uint32_t tileSize;
+		uint32_t levelCount;
+		uint32_t pagedLevels;
+		uint32_t hasAlpha;		// 1 when the image had alpha
+	};
+	const uint32_t VTEX_VERSION = 1;
+
+	// texels of the pages, in the files and on the GPU
+	const GLenum VIRTUAL_FORMAT = GL_RGBA8;
+	const int VIRTUAL_CHANNELS = 4;
+	// texture unit a sparse texture is bound to while its pages are
+	// committed, above the units the scene samples from; it is bound
+	// to 0 again after
+	const int COMMIT_TEXTURE_UNIT = 31;
+	// pixels of a 4x4 block of the screen, one of which writes the
+	// feedback of a frame
+	const unsigned int FEEDBACK_PHASES = 16;
+	// the phase, then two uvec4 of layout per texture
+	const size_t PAGE_TABLE_HEADER_WORDS = 4 + VirtualTextures::MAX_VIRTUAL_TEXTURES * 8;
+
+	/***********************************************************
+	 *  SeekFile()
+	 *
+	 *  This function is used for moving to an offset past 2 GB,
+	 *  which a tiled 16K texture takes.
+	 ***********************************************************/
+	bool SeekFile(FILE* pFile, long long offset)
+	{
+#ifdef _WIN32
+		return(_fseeki64(pFile, offset, SEEK_SET) == 0);
+#else
+		return(fseeko(pFile, (off_t)offset, SEEK_SET) == 0);
+#endif
+	}
+
+	// levels from the top whose sides are both whole pages
+	int GetPagedLevelCount(int width, int height, int tileSize)
+	{
+		int levels = 0;
+		while (((width >> levels) >= tileSize) && ((height >> levels) >= tileSize) &&
+			(((width >> levels) % tileSize) == 0) && (((height >> levels) % tileSize) == 0))
+		{
+			levels++;
+		}
+		return(levels);
+	}
+}
+
+/***********************************************************
+ *  VirtualTextures()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+VirtualTextures::VirtualTextures(ShaderManager* pShaderManager)
+{
+	m_pShaderManager = pShaderManager;
+	m_budget = DEFAULT_BUDGET;
+	m_pagesBuffer = 0;
+	m_feedbackWords = 0;
+	m_residencyWords = 0;
+	for (int i = 0; i < READBACK_COUNT; i++)
+	{
+		m_readbacks[i].buffer = 0;
+		m_readbacks[i].fence = 0;
+	}
+	m_nextReadback = 0;
+	m_frame = 0;
+	m_feedbackReads = 0;
+	m_residentPages = 0;
+	m_residentBytes = 0;
+	m_pendingLoads = 0;
+	memset(&m_stats, 0, sizeof(m_stats));
+	m_generation = 0;
+	m_loadNanoseconds = 0;
+	m_bStopping = false;
+}
+
+/***********************************************************
+ *  ~VirtualTextures()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+VirtualTextures::~VirtualTextures()
+{
+	if (m_loader.joinable() == true)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_bStopping = true;
+		}
+		m_wake.notify_all();
+		m_loader.join();
+	}
+	Clear();
+	m_pShaderManager = NULL;
+}
+
+/***********************************************************
+ *  IsSupported()
+ *
+ *  This method is used for checking the context can page a
+ *  texture: sparse storage, bindless handles to read it by
+ *  the texture table, and shader storage with direct state
+ *  access for the page tables.
+ ***********************************************************/
+bool VirtualTextures::IsSupported()
+{
+	return((GLEW_ARB_sparse_texture == GL_TRUE) && (GLEW_ARB_bindless_texture == GL_TRUE) &&
+		(GLEW_VERSION_4_3 == GL_TRUE) && (ShapeMeshes::HasDirectStateAccess() == true));
+}
+
+/***********************************************************
+ *  GetTiledFilename()
+ *
+ *  This method is used for the name of the tiled file that
+ *  stands in for an image file.
+ ***********************************************************/
+std::string VirtualTextures::GetTiledFilename(const std::string& imageFilename)
+{
+	return(imageFilename.substr(0, imageFilename.find_last_of('.')) + ".vtex");
+}
+
+/***********************************************************
+ *  WriteTiledFile()
+ *
+ *  This method is used for converting an image file into a
+ *  tiled file offline. The chain is decoded and filtered as
+ *  for any texture, in RGBA since the pages are, and the
+ *  paged levels are cut into pages of TILE_SIZE texels.
+ ***********************************************************/
+bool VirtualTextures::WriteTiledFile(const char* imageFilename, const char* tiledFilename)
+{
+	// a gray image is kept in color, as the pages are RGBA
+	const int grayTolerance = ImageDecoder::GetGrayTolerance();
+	ImageDecoder::SetGrayTolerance(-1);
+	ImageDecoder::IMAGE image;
+	const bool bDecoded = ImageDecoder::Decode(imageFilename, image);
+	ImageDecoder::SetGrayTolerance(grayTolerance);
+	if (false == bDecoded)
+	{
+		LOG_ERROR("Could not load image:%s", imageFilename);
+		return(false);
+	}
+
+	const int pagedLevels = GetPagedLevelCount(image.width, image.height, TILE_SIZE);
+	if ((image.colorChannels != VIRTUAL_CHANNELS) || (pagedLevels == 0) ||
+		((image.width % TILE_SIZE) != 0) || ((image.height % TILE_SIZE) != 0))
+	{
+		LOG_ERROR("Could not tile %s, its sides have to be multiples of %d and its pixels RGB or RGBA",
+			imageFilename, TILE_SIZE);
+		ImageDecoder::Free(image);
+		return(false);
+	}
+	if (image.levelCount != MipChain::GetLevelCount(image.width, image.height))
+	{
+		LOG_ERROR("Could not tile %s, there was no memory for its mip chain", imageFilename);
+		ImageDecoder::Free(image);
+		return(false);
+	}
+
+	FILE* pFile = fopen(tiledFilename, "wb");
+	if (NULL == pFile)
+	{
+		LOG_ERROR("Could not create tiled texture %s", tiledFilename);
+		ImageDecoder::Free(image);
+		return(false);
+	}
+
+	VTEX_HEADER header;
+	memcpy(header.magic, "VTEX", 4);
+	header.version = VTEX_VERSION;
+	header.width = (uint32_t)image.width;
+	header.height = (uint32_t)image.height;
+	header.tileSize = (uint32_t)TILE_SIZE;
+	header.levelCount = (uint32_t)image.levelCount;
+	header.pagedLevels = (uint32_t)pagedLevels;
+	header.hasAlpha = (ImageDecoder::HasAlpha(image.fileChannels) == true) ? 1 : 0;
+	bool bWritten = (fwrite(&header, sizeof(header), 1, pFile) == 1);
+
+	int pageCount = 0;
+	const size_t tileRowBytes = (size_t)TILE_SIZE * VIRTUAL_CHANNELS;
+	for (int level = 0; (level < pagedLevels) && (true == bWritten); level++)
+	{
+		int levelWidth = 0;
+		int levelHeight = 0;
+		MipChain::GetLevelSize(image.width, image.height, level, levelWidth, levelHeight);
+		const unsigned char* pLevel = image.pixels + MipChain::GetLevelOffset(image.width, image.height, VIRTUAL_CHANNELS, level);
+		for (int y = 0; (y < levelHeight / TILE_SIZE) && (true == bWritten); y++)
+		{
+			for (int x = 0; (x < levelWidth / TILE_SIZE) && (true == bWritten); x++)
+			{
+				for (int row = 0; (row < TILE_SIZE) && (true == bWritten); row++)
+				{
+					const size_t offset = ((size_t)(y * TILE_SIZE + row) * levelWidth + (size_t)x * TILE_SIZE) * VIRTUAL_CHANNELS;
+					bWritten = (fwrite(pLevel + offset, 1, tileRowBytes, pFile) == tileRowBytes);
+				}
+				pageCount++;
+			}
+		}
+	}
+
+	const size_t tailOffset = MipChain::GetLevelOffset(image.width, image.height, VIRTUAL_CHANNELS, pagedLevels);
+	const size_t tailBytes = MipChain::GetChainBytes(image.width, image.height, VIRTUAL_CHANNELS, image.levelCount) - tailOffset;
+	bWritten = (true == bWritten) && ((tailBytes == 0) || (fwrite(image.pixels + tailOffset, 1, tailBytes, pFile) == tailBytes));
+	fclose(pFile);
+	ImageDecoder::Free(image);
+
+	if (true == bWritten)
+	{
+		LOG_INFO("Tiled %s into %s, %d pages of %dx%d in %d levels, %d levels whole", imageFilename, tiledFilename,
+			pageCount, TILE_SIZE, TILE_SIZE, pagedLevels, (int)header.levelCount - pagedLevels);
+	}
+	else
+	{
+		LOG_ERROR("Could not write tiled texture %s", tiledFilename);
+	}
+	return(bWritten);
+}
+
+/***********************************************************
+ *  Open()
+ *
+ *  This method is used for creating the sparse texture of a
+ *  tiled file. The levels the GPU cannot commit a page at a
+ *  time, and those with no pages in the file, are committed
+ *  whole and read in here; the others start with no page
+ *  committed, and the shader reads the level below them
+ *  until the feedback asks for their pages.
+ ***********************************************************/
+GLuint VirtualTextures::Open(const std::string& filename, bool& bHasAlpha)
+{
+	if ((IsSupported() == false) || (m_textures.size() >= (size_t)MAX_VIRTUAL_TEXTURES))
+	{
+		return(0);
+	}
+
+	FILE* pFile = fopen(filename.c_str(), "rb");
+	if (NULL == pFile)
+	{
+		return(0);
+	}
+
+	VTEX_HEADER header;
+	bool bValid = (fread(&header, sizeof(header), 1, pFile) == 1) && (memcmp(header.magic, "VTEX", 4) == 0) &&
+		(header.version == VTEX_VERSION) && (header.width > 0) && (header.height > 0) && (header.tileSize > 0) &&
+		((int)header.levelCount == MipChain::GetLevelCount((int)header.width, (int)header.height)) &&
+		((int)header.pagedLevels == GetPagedLevelCount((int)header.width, (int)header.height, (int)header.tileSize));
+	if (false == bValid)
+	{
+		LOG_WARNING("Could not read tiled texture %s", filename.c_str());
+		fclose(pFile);
+		return(0);
+	}
+
+	// a page of the file has to be whole pages of the GPU
+	GLint pageWidth = 0;
+	GLint pageHeight = 0;
+	glGetInternalformativ(GL_TEXTURE_2D, VIRTUAL_FORMAT, GL_VIRTUAL_PAGE_SIZE_X_ARB, 1, &pageWidth);
+	glGetInternalformativ(GL_TEXTURE_2D, VIRTUAL_FORMAT, GL_VIRTUAL_PAGE_SIZE_Y_ARB, 1, &pageHeight);
+	if ((pageWidth <= 0) || (pageHeight <= 0) ||
+		((header.tileSize % (uint32_t)pageWidth) != 0) || ((header.tileSize % (uint32_t)pageHeight) != 0))
+	{
+		LOG_WARNING("Could not page tiled texture %s, its pages of %d texels are not whole GPU pages of %dx%d",
+			filename.c_str(), (int)header.tileSize, (int)pageWidth, (int)pageHeight);
+		fclose(pFile);
+		return(0);
+	}
+
+	VIRTUAL_TEXTURE virtualTexture;
+	virtualTexture.filename = filename;
+	virtualTexture.width = (int)header.width;
+	virtualTexture.height = (int)header.height;
+	virtualTexture.tileSize = (int)header.tileSize;
+	virtualTexture.levelCount = (int)header.levelCount;
+	virtualTexture.pagedLevels = (int)header.pagedLevels;
+	virtualTexture.tilesX = virtualTexture.width / virtualTexture.tileSize;
+	virtualTexture.tilesY = virtualTexture.height / virtualTexture.tileSize;
+	virtualTexture.firstPageOffset = (long long)sizeof(header);
+	virtualTexture.firstPages.push_back(0);
+	for (int level = 0; level < virtualTexture.pagedLevels; level++)
+	{
+		virtualTexture.firstPages.push_back(virtualTexture.firstPages.back() +
+			(virtualTexture.tilesX >> level) * (virtualTexture.tilesY >> level));
+	}
+	virtualTexture.firstFeedbackBit = 0;
+	virtualTexture.firstResidencyWord = 0;
+	virtualTexture.bResidencyChanged = true;
+
+	glCreateTextures(GL_TEXTURE_2D, 1, &virtualTexture.texture);
+	glTextureParameteri(virtualTexture.texture, GL_TEXTURE_SPARSE_ARB, GL_TRUE);
+	glTextureParameteri(virtualTexture.texture, GL_VIRTUAL_PAGE_SIZE_INDEX_ARB, 0);
+	glTextureStorage2D(virtualTexture.texture, virtualTexture.levelCount, VIRTUAL_FORMAT,
+		virtualTexture.width, virtualTexture.height);
+	// set the texture wrapping parameters
+	glTextureParameteri(virtualTexture.texture, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTextureParameteri(virtualTexture.texture, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	// set texture filtering parameters
+	glTextureParameteri(virtualTexture.texture, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTextureParameteri(virtualTexture.texture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+	GLint sparseLevels = 0;
+	glGetTextureParameteriv(virtualTexture.texture, GL_NUM_SPARSE_LEVELS_ARB, &sparseLevels);
+	virtualTexture.streamedLevels = std::min(virtualTexture.pagedLevels, (int)sparseLevels);
+	virtualTexture.pageStates.assign(virtualTexture.firstPages[virtualTexture.streamedLevels], (unsigned char)PAGE_ABSENT);
+	virtualTexture.pageWantedReads.assign(virtualTexture.pageStates.size(), 0);
+
+	// the levels below the streamed ones are read in whole, the paged
+	// ones a page at a time and the rest from the end of the file
+	const int tileSize = virtualTexture.tileSize;
+	const size_t pageBytes = (size_t)tileSize * tileSize * VIRTUAL_CHANNELS;
+	std::vector<unsigned char> pixels(pageBytes);
+	bool bRead = SeekFile(pFile, virtualTexture.firstPageOffset + (long long)virtualTexture.firstPages[virtualTexture.streamedLevels] * (long long)pageBytes);
+	for (int level = virtualTexture.streamedLevels; (level < virtualTexture.levelCount) && (true == bRead); level++)
+	{
+		int levelWidth = 0;
+		int levelHeight = 0;
+		MipChain::GetLevelSize(virtualTexture.width, virtualTexture.height, level, levelWidth, levelHeight);
+		CommitRegion(virtualTexture.texture, level, 0, 0, levelWidth, levelHeight, true);
+		if (level < virtualTexture.pagedLevels)
+		{
+			for (int y = 0; (y < levelHeight / tileSize) && (true == bRead); y++)
+			{
+				for (int x = 0; (x < levelWidth / tileSize) && (true == bRead); x++)
+				{
+					bRead = (fread(&pixels[0], 1, pageBytes, pFile) == pageBytes);
+					if (true == bRead)
+					{
+						glTextureSubImage2D(virtualTexture.texture, level, x * tileSize, y * tileSize, tileSize, tileSize,
+							GL_RGBA, GL_UNSIGNED_BYTE, &pixels[0]);
+					}
+				}
+			}
+		}
+		else
+		{
+			const size_t levelBytes = (size_t)levelWidth * levelHeight * VIRTUAL_CHANNELS;
+			pixels.resize(std::max(levelBytes, pageBytes));
+			bRead = (fread(&pixels[0], 1, levelBytes, pFile) == levelBytes);
+			if (true == bRead)
+			{
+				glTextureSubImage2D(virtualTexture.texture, level, 0, 0, levelWidth, levelHeight,
+					GL_RGBA, GL_UNSIGNED_BYTE, &pixels[0]);
+			}
+		}
+	}
+	fclose(pFile);
+	if (false == bRead)
+	{
+		LOG_WARNING("Could not read the levels of tiled texture %s", filename.c_str());
+		glDeleteTextures(1, &virtualTexture.texture);
+		return(0);
+	}
+
+	if (m_loader.joinable() == false)
+	{
+		m_loader = std::thread(&VirtualTextures::LoaderLoop, this);
+	}
+
+	LOG_INFO("Opened tiled texture %s, %dx%d, %d levels paged in pages of %d, %d resident whole",
+		filename.c_str(), virtualTexture.width, virtualTexture.height, virtualTexture.streamedLevels,
+		tileSize, virtualTexture.levelCount - virtualTexture.streamedLevels);
+
+	m_textures.push_back(virtualTexture);
+	BuildPageTables();
+	bHasAlpha = (header.hasAlpha != 0);
+	return(virtualTexture.texture);
+}
+
+/***********************************************************
+ *  FindTexture()
+ *
+ *  This method is used for finding the page tables of a
+ *  texture, for the texture table to mark its entry.
+ ***********************************************************/
+int VirtualTextures::FindTexture(GLuint texture) const
+{
+	for (size_t i = 0; i < m_textures.size(); i++)
+	{
+		if ((0 != texture) && (m_textures[i].texture == texture))
+		{
+			return((int)i);
+		}
+	}
+	return(-1);
+}
+
+/***********************************************************
+ *  Clear()
+ *
+ *  This method is used for forgetting the textures, when the
+ *  scene deletes them. A page the loader thread is reading
+ *  belongs to the generation before, so it is dropped when
+ *  it is done.
+ ***********************************************************/
+void VirtualTextures::Clear()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_generation++;
+		m_loadQueue.clear();
+		m_loadDone.clear();
+	}
+	m_loadedPages.clear();
+	m_textures.clear();
+	m_pendingLoads = 0;
+	m_residentPages = 0;
+	m_residentBytes = 0;
+	m_stats.residentPages = 0;
+	m_stats.wantedPages = 0;
+
+	DeleteReadbacks();
+	if (0 != m_pagesBuffer)
+	{
+		GPUMemory::DeleteBuffers(1, &m_pagesBuffer);
+		m_pagesBuffer = 0;
+	}
+	m_feedbackWords = 0;
+	m_residencyWords = 0;
+}
+
+/***********************************************************
+ *  Bind()
+ *
+ *  This method is used for binding the page tables for the
+ *  fragment shader to read and write its feedback into.
+ ***********************************************************/
+void VirtualTextures::Bind()
+{
+	if (0 != m_pagesBuffer)
+	{
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, VIRTUAL_PAGES_BINDING, m_pagesBuffer);
+	}
+}
+
+/***********************************************************
+ *  Update()
+ *
+ *  This method is used for the part of a frame spent on the
+ *  pages: the feedback of an earlier frame picks the pages
+ *  to load, those the loader thread read are committed, and
+ *  the residency of the textures whose pages changed is
+ *  uploaded before the frame draws with it.
+ ***********************************************************/
+void VirtualTextures::Update()
+{
+	if (m_textures.empty() == true)
+	{
+		return;
+	}
+
+	PROFILE_SCOPE("virtual textures");
+	m_frame++;
+
+	ReadFeedback();
+	CopyFeedback();
+	RequestPages();
+	CommitPages();
+	for (size_t i = 0; i < m_textures.size(); i++)
+	{
+		if (m_textures[i].bResidencyChanged == true)
+		{
+			UploadResidency(m_textures[i]);
+		}
+	}
+
+	// the next pixel of each 4x4 block writes the feedback of the frame
+	const GLuint phase = (GLuint)(m_frame % FEEDBACK_PHASES);
+	glNamedBufferSubData(m_pagesBuffer, 0, sizeof(GLuint), &phase);
+
+	m_stats.residentPages = m_residentPages;
+	m_stats.peakResidentPages = std::max(m_stats.peakResidentPages, m_residentPages);
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_stats.loadMilliseconds = (double)m_loadNanoseconds / 1000000.0;
+}
+
+/***********************************************************
+ *  LoaderLoop()
+ *
+ *  This method is used for reading the queued pages on the
+ *  loader thread, keeping the last file open since the
+ *  pages of one texture tend to be asked for together.
+ ***********************************************************/
+void VirtualTextures::LoaderLoop()
+{
+	FILE* pFile = NULL;
+	std::string openFilename;
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+	while (true)
+	{
+		m_wake.wait(lock, [this]() { return((m_bStopping == true) || (m_loadQueue.empty() == false)); });
+		if (m_bStopping == true)
+		{
+			break;
+		}
+		PAGE_LOAD load = m_loadQueue.front();
+		m_loadQueue.pop_front();
+		lock.unlock();
+
+		long long start = ScopeProfiler::Now();
+		if (load.filename != openFilename)
+		{
+			if (NULL != pFile)
+			{
+				fclose(pFile);
+			}
+			pFile = fopen(load.filename.c_str(), "rb");
+			openFilename = load.filename;
+		}
+		load.pixels.resize(load.bytes);
+		if ((NULL == pFile) || (SeekFile(pFile, load.offset) == false) ||
+			(fread(&load.pixels[0], 1, load.bytes, pFile) != load.bytes))
+		{
+			load.pixels.clear();
+		}
+		long long elapsed = ScopeProfiler::Now() - start;
+
+		lock.lock();
+		m_loadNanoseconds += (unsigned long long)elapsed;
+		if (load.generation == m_generation)
+		{
+			m_loadDone.push_back(load);
+		}
+	}
+
+	if (NULL != pFile)
+	{
+		fclose(pFile);
+	}
+}
+
+/***********************************************************
+ *  BuildPageTables()
+ *
+ *  This method is used for laying out the feedback bits and
+ *  residency words of every texture opened, each texture's
+ *  bits starting on a word, and uploading the layout. The
+ *  readbacks are made again for the new size, and the
+ *  feedback in flight in the old ones is dropped.
+ ***********************************************************/
+void VirtualTextures::BuildPageTables()
+{
+	DeleteReadbacks();
+
+	m_feedbackWords = 0;
+	for (size_t i = 0; i < m_textures.size(); i++)
+	{
+		m_textures[i].firstFeedbackBit = m_feedbackWords * 32;
+		m_feedbackWords += ((unsigned int)m_textures[i].pageStates.size() + 31) / 32;
+	}
+	m_residencyWords = 0;
+	for (size_t i = 0; i < m_textures.size(); i++)
+	{
+		m_textures[i].firstResidencyWord = m_feedbackWords + m_residencyWords;
+		m_residencyWords += (unsigned int)(m_textures[i].tilesX * m_textures[i].tilesY);
+		m_textures[i].bResidencyChanged = true;
+	}
+
+	std::vector<GLuint> words(PAGE_TABLE_HEADER_WORDS + m_feedbackWords + m_residencyWords, 0);
+	words[0] = (GLuint)(m_frame % FEEDBACK_PHASES);
+	for (size_t i = 0; i < m_textures.size(); i++)
+	{
+		GLuint* pLayout = &words[4 + i * 8];
+		pLayout[0] = (GLuint)m_textures[i].tilesX;
+		pLayout[1] = (GLuint)m_textures[i].tilesY;
+		pLayout[2] = (GLuint)m_textures[i].streamedLevels;
+		pLayout[4] = m_textures[i].firstFeedbackBit;
+		pLayout[5] = m_textures[i].firstResidencyWord;
+	}
+
+	if (0 != m_pagesBuffer)
+	{
+		GPUMemory::DeleteBuffers(1, &m_pagesBuffer);
+	}
+	const GLsizeiptr bytes = (GLsizeiptr)(words.size() * sizeof(GLuint));
+	glCreateBuffers(1, &m_pagesBuffer);
+	glNamedBufferData(m_pagesBuffer, bytes, &words[0], GL_DYNAMIC_DRAW);
+	GPUMemory::TrackBuffer(m_pagesBuffer, bytes, GPUMemory::CATEGORY_BUFFER, "virtual texture page tables");
+	for (size_t i = 0; i < m_textures.size(); i++)
+	{
+		UploadResidency(m_textures[i]);
+	}
+
+	if (m_feedbackWords > 0)
+	{
+		const GLsizeiptr feedbackBytes = (GLsizeiptr)m_feedbackWords * sizeof(GLuint);
+		for (int i = 0; i < READBACK_COUNT; i++)
+		{
+			glCreateBuffers(1, &m_readbacks[i].buffer);
+			glNamedBufferData(m_readbacks[i].buffer, feedbackBytes, NULL, GL_STREAM_READ);
+			GPUMemory::TrackBuffer(m_readbacks[i].buffer, feedbackBytes, GPUMemory::CATEGORY_BUFFER, "virtual texture feedback");
+		}
+	}
+}
+
+/***********************************************************
+ *  DeleteReadbacks()
+ *
+ *  This method is used for deleting the feedback copies and
+ *  their fences.
+ ***********************************************************/
+void VirtualTextures::DeleteReadbacks()
+{
+	for (int i = 0; i < READBACK_COUNT; i++)
+	{
+		if (0 != m_readbacks[i].fence)
+		{
+			glDeleteSync(m_readbacks[i].fence);
+			m_readbacks[i].fence = 0;
+		}
+		if (0 != m_readbacks[i].buffer)
+		{
+			GPUMemory::DeleteBuffers(1, &m_readbacks[i].buffer);
+			m_readbacks[i].buffer = 0;
+		}
+	}
+	m_nextReadback = 0;
+}
+
+/***********************************************************
+ *  ReadFeedback()
+ *
+ *  This method is used for taking the feedback copies whose
+ *  fence passed, oldest first, never waiting for one. Every
+ *  page a copy marks is wanted by this read, and so are the
+ *  pages above it, which the sampler falls back to.
+ ***********************************************************/
+void VirtualTextures::ReadFeedback()
+{
+	std::vector<GLuint> bits(m_feedbackWords);
+	for (int i = 0; i < READBACK_COUNT; i++)
+	{
+		FEEDBACK_READBACK& readback = m_readbacks[(m_nextReadback + i) % READBACK_COUNT];
+		if (0 == readback.fence)
+		{
+			continue;
+		}
+		if (glClientWaitSync(readback.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0) == GL_TIMEOUT_EXPIRED)
+		{
+			return;
+		}
+		glDeleteSync(readback.fence);
+		readback.fence = 0;
+
+		glGetNamedBufferSubData(readback.buffer, 0, (GLsizeiptr)m_feedbackWords * sizeof(GLuint), &bits[0]);
+		m_feedbackReads++;
+		m_stats.feedbackReads++;
+		for (size_t t = 0; t < m_textures.size(); t++)
+		{
+			VIRTUAL_TEXTURE& virtualTexture = m_textures[t];
+			const unsigned int firstWord = virtualTexture.firstFeedbackBit / 32;
+			const unsigned int pageCount = (unsigned int)virtualTexture.pageStates.size();
+			for (unsigned int word = 0; word * 32 < pageCount; word++)
+			{
+				for (GLuint mask = bits[firstWord + word]; mask != 0; mask &= mask - 1)
+				{
+					unsigned int bit = 0;
+					while (((mask >> bit) & 1) == 0)
+					{
+						bit++;
+					}
+					int level = 0;
+					int x = 0;
+					int y = 0;
+					GetPageTile(virtualTexture, (int)(word * 32 + bit), level, x, y);
+					MarkWanted(virtualTexture, level, x, y);
+				}
+			}
+		}
+	}
+}
+
+/***********************************************************
+ *  CopyFeedback()
+ *
+ *  This method is used for copying the bits the last frame
+ *  wrote into the next free readback behind a fence, and
+ *  clearing them for the frame about to be drawn. With no
+ *  readback free the bits are left to add up with those of
+ *  the next frame.
+ ***********************************************************/
+void VirtualTextures::CopyFeedback()
+{
+	FEEDBACK_READBACK& readback = m_readbacks[m_nextReadback];
+	if ((0 == m_feedbackWords) || (0 != readback.fence))
+	{
+		return;
+	}
+
+	const GLintptr offset = (GLintptr)(PAGE_TABLE_HEADER_WORDS * sizeof(GLuint));
+	const GLsizeiptr bytes = (GLsizeiptr)m_feedbackWords * sizeof(GLuint);
+	const GLuint zero = 0;
+	// the shader wrote the bits through storage, not a GL command
+	glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+	glCopyNamedBufferSubData(m_pagesBuffer, readback.buffer, offset, 0, bytes);
+	glClearNamedBufferSubData(m_pagesBuffer, GL_R32UI, offset, bytes, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+	readback.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	m_nextReadback = (m_nextReadback + 1) % READBACK_COUNT;
+}
+
+/***********************************************************
+ *  MarkWanted()
+ *
+ *  This method is used for marking a page wanted by the read
+ *  being taken, with the pages covering it in the levels
+ *  above; a page already marked had those marked with it.
+ ***********************************************************/
+void VirtualTextures::MarkWanted(VIRTUAL_TEXTURE& virtualTexture, int level, int x, int y)
+{
+	for (; level < virtualTexture.streamedLevels; level++)
+	{
+		const int page = virtualTexture.firstPages[level] + y * (virtualTexture.tilesX >> level) + x;
+		if (virtualTexture.pageWantedReads[page] == m_feedbackReads)
+		{
+			break;
+		}
+		virtualTexture.pageWantedReads[page] = m_feedbackReads;
+		x /= 2;
+		y /= 2;
+	}
+}
+
+/***********************************************************
+ *  RequestPages()
+ *
+ *  This method is used for queuing the wanted pages that are
+ *  absent for the loader thread, the coarsest levels first
+ *  so a texture sharpens from its blurred levels down, and
+ *  no more than the budget can hold beside the wanted pages
+ *  already resident.
+ ***********************************************************/
+void VirtualTextures::RequestPages()
+{
+	struct PAGE_REQUEST
+	{
+		int level;
+		int textureIndex;
+		int page;
+	};
+	std::vector<PAGE_REQUEST> requests;
+	size_t wantedBytes = 0;
+	int wantedPages = 0;
+	for (size_t t = 0; t < m_textures.size(); t++)
+	{
+		const VIRTUAL_TEXTURE& virtualTexture = m_textures[t];
+		const size_t pageBytes = (size_t)virtualTexture.tileSize * virtualTexture.tileSize * VIRTUAL_CHANNELS;
+		for (int level = 0; level < virtualTexture.streamedLevels; level++)
+		{
+			for (int page = virtualTexture.firstPages[level]; page < virtualTexture.firstPages[level + 1]; page++)
+			{
+				const unsigned long long wantedRead = virtualTexture.pageWantedReads[page];
+				if ((0 == wantedRead) || (wantedRead + WANTED_READS <= m_feedbackReads))
+				{
+					continue;
+				}
+				wantedPages++;
+				if (virtualTexture.pageStates[page] != PAGE_ABSENT)
+				{
+					wantedBytes += (virtualTexture.pageStates[page] == PAGE_FAILED) ? 0 : pageBytes;
+					continue;
+				}
+				PAGE_REQUEST request;
+				request.level = level;
+				request.textureIndex = (int)t;
+				request.page = page;
+				requests.push_back(request);
+			}
+		}
+	}
+	m_stats.wantedPages = wantedPages;
+	std::stable_sort(requests.begin(), requests.end(),
+		[](const PAGE_REQUEST& first, const PAGE_REQUEST& second) { return(first.level > second.level); });
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	for (size_t i = 0; (i < requests.size()) && (m_pendingLoads < MAX_PENDING_LOADS); i++)
+	{
+		VIRTUAL_TEXTURE& virtualTexture = m_textures[requests[i].textureIndex];
+		const size_t pageBytes = (size_t)virtualTexture.tileSize * virtualTexture.tileSize * VIRTUAL_CHANNELS;
+		if (wantedBytes + pageBytes > m_budget)
+		{
+			break;
+		}
+		wantedBytes += pageBytes;
+
+		PAGE_LOAD load;
+		load.generation = m_generation;
+		load.textureIndex = requests[i].textureIndex;
+		load.page = requests[i].page;
+		load.filename = virtualTexture.filename;
+		load.offset = virtualTexture.firstPageOffset + (long long)requests[i].page * (long long)pageBytes;
+		load.bytes = pageBytes;
+		m_loadQueue.push_back(load);
+		virtualTexture.pageStates[requests[i].page] = PAGE_LOADING;
+		m_pendingLoads++;
+	}
+	m_wake.notify_one();
+}
+
+/***********************************************************
+ *  CommitPages()
+ *
+ *  This method is used for committing the pages the loader
+ *  thread read and copying their texels in, a few a frame.
+ *  A page no read wants any more by now is dropped, and the
+ *  budget makes room by evicting the page wanted least
+ *  recently, or drops the page when every resident one is
+ *  still wanted.
+ ***********************************************************/
+void VirtualTextures::CommitPages()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_loadedPages.insert(m_loadedPages.end(), m_loadDone.begin(), m_loadDone.end());
+		m_loadDone.clear();
+	}
+
+	int committed = 0;
+	size_t taken = 0;
+	for (; (taken < m_loadedPages.size()) && (committed < PAGES_PER_FRAME); taken++)
+	{
+		const PAGE_LOAD& load = m_loadedPages[taken];
+		VIRTUAL_TEXTURE& virtualTexture = m_textures[load.textureIndex];
+		m_pendingLoads--;
+		if (load.pixels.empty() == true)
+		{
+			LOG_WARNING("Could not read page %d of tiled texture %s", load.page, virtualTexture.filename.c_str());
+			virtualTexture.pageStates[load.page] = PAGE_FAILED;
+			continue;
+		}
+		const unsigned long long wantedRead = virtualTexture.pageWantedReads[load.page];
+		if (((wantedRead + WANTED_READS <= m_feedbackReads)) ||
+			((m_residentBytes + load.bytes > m_budget) && (EvictPage() == false)))
+		{
+			virtualTexture.pageStates[load.page] = PAGE_ABSENT;
+			continue;
+		}
+
+		int level = 0;
+		int x = 0;
+		int y = 0;
+		GetPageTile(virtualTexture, load.page, level, x, y);
+		const int tileSize = virtualTexture.tileSize;
+		CommitRegion(virtualTexture.texture, level, x * tileSize, y * tileSize, tileSize, tileSize, true);
+		glTextureSubImage2D(virtualTexture.texture, level, x * tileSize, y * tileSize, tileSize, tileSize,
+			GL_RGBA, GL_UNSIGNED_BYTE, &load.pixels[0]);
+		virtualTexture.pageStates[load.page] = PAGE_RESIDENT;
+		virtualTexture.bResidencyChanged = true;
+		m_residentPages++;
+		m_residentBytes += load.bytes;
+		m_stats.pagesCommitted++;
+		committed++;
+	}
+	m_loadedPages.erase(m_loadedPages.begin(), m_loadedPages.begin() + taken);
+}
+
+/***********************************************************
+ *  EvictPage()
+ *
+ *  This method is used for decommitting the resident page
+ *  wanted least recently, of the finest level among pages
+ *  wanted equally long ago. A page the last WANTED_READS
+ *  reads marked is never evicted.
+ ***********************************************************/
+bool VirtualTextures::EvictPage()
+{
+	int victimTexture = -1;
+	int victimPage = -1;
+	int victimLevel = 0;
+	unsigned long long victimRead = 0;
+	for (size_t t = 0; t < m_textures.size(); t++)
+	{
+		const VIRTUAL_TEXTURE& virtualTexture = m_textures[t];
+		for (int level = 0; level < virtualTexture.streamedLevels; level++)
+		{
+			for (int page = virtualTexture.firstPages[level]; page < virtualTexture.firstPages[level + 1]; page++)
+			{
+				const unsigned long long wantedRead = virtualTexture.pageWantedReads[page];
+				if ((virtualTexture.pageStates[page] != PAGE_RESIDENT) || (wantedRead + WANTED_READS > m_feedbackReads))
+				{
+					continue;
+				}
+				if ((victimPage < 0) || (wantedRead < victimRead) || ((wantedRead == victimRead) && (level < victimLevel)))
+				{
+					victimTexture = (int)t;
+					victimPage = page;
+					victimLevel = level;
+					victimRead = wantedRead;
+				}
+			}
+		}
+	}
+	if (victimPage < 0)
+	{
+		return(false);
+	}
+
+	VIRTUAL_TEXTURE& virtualTexture = m_textures[victimTexture];
+	int level = 0;
+	int x = 0;
+	int y = 0;
+	GetPageTile(virtualTexture, victimPage, level, x, y);
+	const int tileSize = virtualTexture.tileSize;
+	CommitRegion(virtualTexture.texture, level, x * tileSize, y * tileSize, tileSize, tileSize, false);
+	virtualTexture.pageStates[victimPage] = PAGE_ABSENT;
+	virtualTexture.bResidencyChanged = true;
+	m_residentPages--;
+	m_residentBytes -= (size_t)tileSize * tileSize * VIRTUAL_CHANNELS;
+	m_stats.pagesEvicted++;
+	return(true);
+}
+
+/***********************************************************
+ *  CommitRegion()
+ *
+ *  This method is used for committing or decommitting the
+ *  memory of a region of a level. The commitment call works
+ *  on the texture bound to the active unit, so the texture
+ *  is bound for it and unbound after.
+ ***********************************************************/
+void VirtualTextures::CommitRegion(GLuint texture, int level, int x, int y, int width, int height, bool bCommit)
+{
+	m_pShaderManager->BindTexture(COMMIT_TEXTURE_UNIT, texture);
+	m_pShaderManager->SetActiveTextureUnit(COMMIT_TEXTURE_UNIT);
+	glTexPageCommitmentARB(GL_TEXTURE_2D, level, x, y, 0, width, height, 1, (true == bCommit) ? GL_TRUE : GL_FALSE);
+	m_pShaderManager->BindTexture(COMMIT_TEXTURE_UNIT, 0);
+}
+
+/***********************************************************
+ *  UploadResidency()
+ *
+ *  This method is used for finding the finest level whose
+ *  page under each tile of level 0 is resident along with
+ *  every page above it, and uploading it for the shader to
+ *  clamp its level to. A pixel near the edge of a tile also
+ *  filters texels of the tiles around it, so each tile takes
+ *  the coarsest level of its neighbours; the texture
+ *  repeats, so the neighbours wrap around.
+ ***********************************************************/
+void VirtualTextures::UploadResidency(VIRTUAL_TEXTURE& virtualTexture)
+{
+	const int tilesX = virtualTexture.tilesX;
+	const int tilesY = virtualTexture.tilesY;
+	std::vector<GLuint> finest((size_t)tilesX * tilesY);
+	for (int y = 0; y < tilesY; y++)
+	{
+		for (int x = 0; x < tilesX; x++)
+		{
+			int level = virtualTexture.streamedLevels;
+			while (level > 0)
+			{
+				const int below = level - 1;
+				const int page = virtualTexture.firstPages[below] + (y >> below) * (tilesX >> below) + (x >> below);
+				if (virtualTexture.pageStates[page] != PAGE_RESIDENT)
+				{
+					break;
+				}
+				level = below;
+			}
+			finest[(size_t)y * tilesX + x] = (GLuint)level;
+		}
+	}
+
+	std::vector<GLuint> residency(finest.size());
+	for (int y = 0; y < tilesY; y++)
+	{
+		for (int x = 0; x < tilesX; x++)
+		{
+			GLuint level = 0;
+			for (int dy = -1; dy <= 1; dy++)
+			{
+				for (int dx = -1; dx <= 1; dx++)
+				{
+					const int neighbourX = (x + dx + tilesX) % tilesX;
+					const int neighbourY = (y + dy + tilesY) % tilesY;
+					level = std::max(level, finest[(size_t)neighbourY * tilesX + neighbourX]);
+				}
+			}
+			residency[(size_t)y * tilesX + x] = level;
+		}
+	}
+
+	glNamedBufferSubData(m_pagesBuffer,
+		(GLintptr)((PAGE_TABLE_HEADER_WORDS + virtualTexture.firstResidencyWord) * sizeof(GLuint)),
+		(GLsizeiptr)(residency.size() * sizeof(GLuint)), &residency[0]);
+	virtualTexture.bResidencyChanged = false;
+}
+
+/***********************************************************
+ *  GetPageTile()
+ *
+ *  This method is used for the level of a page and its tile
+ *  in the level.
+ ***********************************************************/
+void VirtualTextures::GetPageTile(const VIRTUAL_TEXTURE& virtualTexture, int page, int& level, int& x, int& y)
+{
+	level = 0;
+	while ((level + 2 < (int)virtualTexture.firstPages.size()) && (page >= virtualTexture.firstPages[level + 1]))
+	{
+		level++;
+	}
+	const int tilesAcross = virtualTexture.tilesX >> level;
+	const int index = page - virtualTexture.firstPages[level];
+	x = index % tilesAcross;
+	y = index / tilesAcross;
+}
+
+/***********************************************************
+ *  Print()
+ *
+ *  This method is used for writing the pages committed and
+ *  evicted, and the feedback read for them, to the console.
+ ***********************************************************/
+void VirtualTextures::Print() const
+{
+	const size_t pageBytes = (size_t)TILE_SIZE * TILE_SIZE * VIRTUAL_CHANNELS;
+	std::cout << "virtual texture pages committed " << m_stats.pagesCommitted
+		<< "\tevicted " << m_stats.pagesEvicted
+		<< "\tresident " << m_stats.residentPages << " (peak " << m_stats.peakResidentPages
+		<< " of a budget of " << m_budget / pageBytes << ")"
+		<< "\tfeedback reads " << m_stats.feedbackReads
+		<< "\tread in " << m_stats.loadMilliseconds << " ms\n";
+}
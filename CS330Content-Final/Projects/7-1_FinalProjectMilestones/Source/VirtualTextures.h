@@ -0,0 +1,228 @@
+///////////////////////////////////////////////////////////////////////////////
+// virtualtextures.h
+// ============
+// page very large surface textures in from tiled files as they are seen
+//
+//  A texture of 16K texels and more across would take a gigabyte with
+//  its mip chain, so it is given sparse storage instead, of which only
+//  the pages the view reads are committed. The fragment shader marks
+//  the page each pixel reads in a feedback bitmask, a sixteenth of the
+//  pixels each frame, which is read back a few frames later without
+//  waiting for it. The pages marked are read from a tiled file on a
+//  loader thread, committed and uploaded a few a frame, and the pages
+//  wanted least recently are decommitted once the page budget is used.
+//  A table of the finest resident level under every tile of level 0
+//  keeps the shader from reading a page that is not committed: it
+//  raises the level the sampler picks to that one, so a texture shows
+//  blurred until its pages arrive. The levels smaller than a page, and
+//  those the GPU keeps in its mip tail, stay resident whole.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "ShaderManager.h"
+
+#include <GL/glew.h>
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/***********************************************************
+ *  VirtualTextures
+ *
+ *  This class contains the sparse textures opened from the
+ *  tiled files, the state of each of their pages, the page
+ *  tables the fragment shader reads and the thread loading
+ *  the pages. The textures themselves are owned by the
+ *  scene, which calls Clear() before it deletes them.
+ ***********************************************************/
+class VirtualTextures
+{
+public:
+	// constructor
+	VirtualTextures(ShaderManager* pShaderManager);
+	// destructor
+	~VirtualTextures();
+
+	// capacity of the page tables, must match the fragment shader
+	static const int MAX_VIRTUAL_TEXTURES = 8;
+	// storage binding of the page tables, must match the fragment shader
+	static const GLuint VIRTUAL_PAGES_BINDING = 7;
+	// side of a page of the tiled files written, in texels; a page
+	// is 64 KB of RGBA8
+	static const int TILE_SIZE = 128;
+	// bytes the committed pages may take by default
+	static const size_t DEFAULT_BUDGET = 64 * 1024 * 1024;
+	// most pages committed in one frame
+	static const int PAGES_PER_FRAME = 16;
+	// most pages waiting for the loader thread
+	static const int MAX_PENDING_LOADS = 64;
+	// feedback reads a page stays wanted for after the last one that
+	// marked it; each read holds a sixteenth of the pixels
+	static const int WANTED_READS = 32;
+
+	struct VIRTUAL_STATS
+	{
+		unsigned long long pagesCommitted;
+		unsigned long long pagesEvicted;
+		unsigned long long feedbackReads;
+		int residentPages;			// committed now
+		int peakResidentPages;
+		int wantedPages;			// marked by the feedback kept now
+		double loadMilliseconds;	// reading the pages, on the loader thread
+	};
+
+	// true when the context has sparse and bindless textures and
+	// shader storage to write the feedback into
+	static bool IsSupported();
+	// tiled file written beside an image file
+	static std::string GetTiledFilename(const std::string& imageFilename);
+	// decode an image file and write it out a page at a time, with
+	// its mip chain; the sides have to be multiples of TILE_SIZE
+	static bool WriteTiledFile(const char* imageFilename, const char* tiledFilename);
+
+	void SetBudget(size_t budgetBytes) { m_budget = budgetBytes; }
+	size_t GetBudget() const { return(m_budget); }
+
+	// create the sparse texture of a tiled file, with the levels
+	// that are not paged committed and read in, and tell if its image
+	// had alpha; 0 when the file cannot be read or its pages are not
+	// a multiple of those of the GPU
+	GLuint Open(const std::string& filename, bool& bHasAlpha);
+	// index of a texture opened here in the page tables, -1 for any
+	// other texture
+	int FindTexture(GLuint texture) const;
+	// forget every texture and drop the pages being loaded
+	void Clear();
+
+	// bind the page tables for the draws of a frame
+	void Bind();
+	// read the feedback of an earlier frame, start loading the pages
+	// it marked and commit those loaded, within the page budget
+	void Update();
+
+	const VIRTUAL_STATS& GetStats() const { return(m_stats); }
+	void Print() const;
+
+private:
+	// what a page of a streamed level holds
+	enum PAGE_STATE
+	{
+		PAGE_ABSENT = 0,
+		PAGE_LOADING,
+		PAGE_RESIDENT,
+		PAGE_FAILED			// could not be read, never asked for again
+	};
+
+	struct VIRTUAL_TEXTURE
+	{
+		GLuint texture;
+		std::string filename;
+		int width;
+		int height;
+		int tileSize;
+		int levelCount;
+		// levels the file holds a page at a time, and of them, those
+		// committed a page at a time; the rest are resident whole
+		int pagedLevels;
+		int streamedLevels;
+		// pages across and down level 0
+		int tilesX;
+		int tilesY;
+		// where the pages start in the file
+		long long firstPageOffset;
+		// first page of each paged level, and one past the last
+		std::vector<int> firstPages;
+		// state of every page of the streamed levels, and the last
+		// feedback read that marked it
+		std::vector<unsigned char> pageStates;
+		std::vector<unsigned long long> pageWantedReads;
+		// of its bits in the feedback and its words in the residency
+		// table of the page tables
+		unsigned int firstFeedbackBit;
+		unsigned int firstResidencyWord;
+		bool bResidencyChanged;
+	};
+
+	// page read by the loader thread, for the Clear() it was asked
+	// for after
+	struct PAGE_LOAD
+	{
+		unsigned long long generation;
+		int textureIndex;
+		int page;
+		std::string filename;
+		long long offset;
+		size_t bytes;
+		// empty when the page could not be read
+		std::vector<unsigned char> pixels;
+	};
+
+	// copy of the feedback bits behind the fence of its frame
+	struct FEEDBACK_READBACK
+	{
+		GLuint buffer;
+		GLsync fence;
+	};
+	static const int READBACK_COUNT = 3;
+
+	// pointer to shader manager object
+	ShaderManager* m_pShaderManager;
+	std::vector<VIRTUAL_TEXTURE> m_textures;
+	size_t m_budget;
+	// header, feedback bits and residency words of every texture
+	GLuint m_pagesBuffer;
+	unsigned int m_feedbackWords;
+	unsigned int m_residencyWords;
+	FEEDBACK_READBACK m_readbacks[READBACK_COUNT];
+	int m_nextReadback;
+	unsigned long long m_frame;
+	unsigned long long m_feedbackReads;
+	int m_residentPages;
+	size_t m_residentBytes;
+	int m_pendingLoads;
+	// pages loaded and not committed yet, oldest first
+	std::vector<PAGE_LOAD> m_loadedPages;
+	VIRTUAL_STATS m_stats;
+
+	// loader thread and the pages queued for it, guarded by m_mutex
+	std::thread m_loader;
+	std::mutex m_mutex;
+	std::condition_variable m_wake;
+	std::deque<PAGE_LOAD> m_loadQueue;
+	std::vector<PAGE_LOAD> m_loadDone;
+	unsigned long long m_generation;
+	unsigned long long m_loadNanoseconds;
+	bool m_bStopping;
+
+	// body of the loader thread
+	void LoaderLoop();
+	// lay the page tables out for the textures opened and upload
+	// them, dropping the feedback copied for the layout before
+	void BuildPageTables();
+	void DeleteReadbacks();
+	// take the feedback of the oldest copy whose fence passed, and
+	// copy the bits of the last frame into a free one
+	void ReadFeedback();
+	void CopyFeedback();
+	// mark a page and the pages above it wanted by this read
+	void MarkWanted(VIRTUAL_TEXTURE& virtualTexture, int level, int x, int y);
+	// queue the wanted pages that are absent, coarsest first
+	void RequestPages();
+	// commit the loaded pages, evicting where the budget is used
+	void CommitPages();
+	// decommit the page wanted least recently that no read kept
+	// wanted; false when every page is
+	bool EvictPage();
+	// commit or decommit a region of a level of a sparse texture
+	void CommitRegion(GLuint texture, int level, int x, int y, int width, int height, bool bCommit);
+	// upload the finest resident level under each tile of level 0
+	void UploadResidency(VIRTUAL_TEXTURE& virtualTexture);
+
+	static void GetPageTile(const VIRTUAL_TEXTURE& virtualTexture, int page, int& level, int& x, int& y);
+};
@@ -0,0 +1,528 @@
+///////////////////////////////////////////////////////////////////////////////
+// wallsync.cpp
+// ============
+// frame lock of the nodes of a video wall, each showing a tile of it
+//
+//  A wall of displays driven by several machines shows one picture:
+//  every node renders its tile of the frustum the camera has over the
+//  whole wall (ViewManager::SetWallTile()), from the camera of the
+//  master node. The master sends each frame's camera and key presses
+//  to the nodes before rendering it, so the settings the keys toggle
+//  change on every node with the same frame, and the nodes render it
+//  from there. Before the swap each node reports the frame ready and
+//  waits for the master, which swaps once all are, so the displays
+//  change together. Where the driver has NV_swap_group the nodes also
+//  join a swap group bound to the barrier of a frame lock board,
+//  which aligns their swaps to one refresh; without it the software
+//  barrier alone keeps the frames in lock.
+//
+//  Messages are little endian and start with a magic and the frame
+//  number; a WALL_FRAME is followed by its key presses, as int32s.
+///////////////////////////////////////////////////////////////////////////////
+
+#include <GL/glew.h>
+#ifdef _WIN32
+#include <GL/wglew.h>
+#else
+#include <GL/glxew.h>
+#endif
+
+#include "WallSync.h"
+#include "NetSocket.h"
+#include "Logger.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+namespace
+{
+	const uintptr_t NO_SOCKET = NetSocket::INVALID_HANDLE;
+
+	// longest wait at the barrier, and for the master's next frame;
+	// generous, since the first frames of a node wait for its shader
+	// compiles and uploads
+	const double BARRIER_TIMEOUT_SECONDS = 30.0;
+	const double FRAME_TIMEOUT_SECONDS = 60.0;
+	// most key presses one frame carries
+	const uint32_t MAX_FRAME_KEYS = 256;
+	// shortest time between the reports of lost peers from the frame
+	// path, where a whole wall losing its master reports at once
+	const int LOST_LOG_INTERVAL_MS = 1000;
+
+	double NowSeconds()
+	{
+		return(std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count());
+	}
+}
+
+/***********************************************************
+ *  WallSync()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+WallSync::WallSync()
+{
+	m_bMaster = false;
+	m_listenSocket = NO_SOCKET;
+	m_frame = 0;
+	m_bSwapGroup = false;
+	m_bFramePending = false;
+	memset(&m_pendingFrame, 0, sizeof(m_pendingFrame));
+	memset(&m_stats, 0, sizeof(m_stats));
+}
+
+/***********************************************************
+ *  ~WallSync()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+WallSync::~WallSync()
+{
+	while (m_sockets.empty() == false)
+	{
+		DropSocket(m_sockets.size() - 1);
+	}
+	if (m_listenSocket != NO_SOCKET)
+	{
+		NetSocket::Close(m_listenSocket);
+		m_listenSocket = NO_SOCKET;
+		NetSocket::Cleanup();
+	}
+}
+
+/***********************************************************
+ *  StartMaster()
+ *
+ *  This method is used for opening the port and taking the
+ *  nodes, before the first frame, so none misses a frame.
+ ***********************************************************/
+bool WallSync::StartMaster(int port, int nodeCount)
+{
+	m_bMaster = true;
+	if (NetSocket::Startup() == false)
+	{
+		LOG_ERROR("Could not start the sockets for the wall");
+		return(false);
+	}
+	m_listenSocket = NetSocket::Listen(port, false);
+	if (m_listenSocket == NO_SOCKET)
+	{
+		LOG_ERROR("Could not listen for wall nodes on port %d", port);
+		NetSocket::Cleanup();
+		return(false);
+	}
+
+	LOG_INFO("Waiting for %d wall nodes on port %d", nodeCount, port);
+	while ((int)m_sockets.size() < nodeCount)
+	{
+		if (NetSocket::WaitReadable(m_listenSocket, 1000000) == false)
+		{
+			continue;
+		}
+		uintptr_t nodeSocket = NetSocket::Accept(m_listenSocket);
+		if (nodeSocket != NO_SOCKET)
+		{
+			m_sockets.push_back(nodeSocket);
+			LOG_INFO("Wall node %d of %d connected", (int)m_sockets.size(), nodeCount);
+		}
+	}
+	return(true);
+}
+
+/***********************************************************
+ *  ConnectNode()
+ *
+ *  This method is used for connecting a node to its master.
+ ***********************************************************/
+bool WallSync::ConnectNode(const char* address)
+{
+	m_bMaster = false;
+	std::string host = address;
+	size_t colon = host.find_last_of(':');
+	if (colon == std::string::npos)
+	{
+		LOG_ERROR("A wall master is given as host:port, not %s", address);
+		return(false);
+	}
+	int port = atoi(host.c_str() + colon + 1);
+	host.erase(colon);
+
+	if (NetSocket::Startup() == false)
+	{
+		LOG_ERROR("Could not start the sockets for the wall");
+		return(false);
+	}
+	uintptr_t masterSocket = NetSocket::Connect(host.c_str(), port);
+	if (masterSocket == NO_SOCKET)
+	{
+		LOG_ERROR("Could not reach the wall master at %s", address);
+		NetSocket::Cleanup();
+		return(false);
+	}
+	m_sockets.push_back(masterSocket);
+	LOG_INFO("Wall node of %s", address);
+	return(true);
+}
+
+/***********************************************************
+ *  JoinSwapGroup()
+ *
+ *  This method is used for joining the window's drawable to
+ *  swap group 1 and binding the group to barrier 1, which
+ *  every node does alike. The barrier spans the machines
+ *  only with a frame lock board; a driver with groups and
+ *  no barriers still swaps the group together.
+ ***********************************************************/
+bool WallSync::JoinSwapGroup()
+{
+	GLuint maxGroups = 0;
+	GLuint maxBarriers = 0;
+#ifdef _WIN32
+	if (WGLEW_NV_swap_group == GL_FALSE)
+	{
+		return(false);
+	}
+	HDC deviceContext = wglGetCurrentDC();
+	if ((wglQueryMaxSwapGroupsNV(deviceContext, &maxGroups, &maxBarriers) == FALSE) || (maxGroups == 0) ||
+		(wglJoinSwapGroupNV(deviceContext, 1) == FALSE))
+	{
+		return(false);
+	}
+	if (maxBarriers > 0)
+	{
+		wglBindSwapBarrierNV(1, 1);
+	}
+#else
+	if (GLXEW_NV_swap_group == GL_FALSE)
+	{
+		return(false);
+	}
+	Display* pDisplay = glXGetCurrentDisplay();
+	GLXDrawable drawable = glXGetCurrentDrawable();
+	if ((NULL == pDisplay) ||
+		(glXQueryMaxSwapGroupsNV(pDisplay, DefaultScreen(pDisplay), &maxGroups, &maxBarriers) == False) ||
+		(maxGroups == 0) || (glXJoinSwapGroupNV(pDisplay, drawable, 1) == False))
+	{
+		return(false);
+	}
+	if (maxBarriers > 0)
+	{
+		glXBindSwapBarrierNV(pDisplay, 1, 1);
+	}
+#endif
+	m_bSwapGroup = true;
+	return(true);
+}
+
+/***********************************************************
+ *  BroadcastFrame()
+ *
+ *  This method is used for sending the next frame to every
+ *  node. A node the send fails for is dropped, and the wall
+ *  goes on without its tile.
+ ***********************************************************/
+void WallSync::BroadcastFrame(const std::vector<int>& keys, const CameraPath::CAMERA_POSE& pose)
+{
+	m_frame++;
+	WALL_FRAME frame;
+	frame.magic = FRAME_MAGIC;
+	frame.frame = m_frame;
+	frame.flags = (pose.bOrthographic == true) ? FRAME_ORTHOGRAPHIC : 0;
+	frame.keyCount = (uint32_t)std::min(keys.size(), (size_t)MAX_FRAME_KEYS);
+	for (int i = 0; i < 3; i++)
+	{
+		frame.position[i] = pose.position[i];
+		frame.front[i] = pose.front[i];
+		frame.up[i] = pose.up[i];
+	}
+	frame.yaw = pose.yaw;
+	frame.pitch = pose.pitch;
+	frame.zoom = pose.zoom;
+
+	std::vector<int32_t> frameKeys(keys.begin(), keys.begin() + frame.keyCount);
+	for (size_t i = m_sockets.size(); i > 0; i--)
+	{
+		if ((NetSocket::SendAll(m_sockets[i - 1], &frame, sizeof(frame)) == false) ||
+			((frameKeys.empty() == false) &&
+			(NetSocket::SendAll(m_sockets[i - 1], frameKeys.data(), frameKeys.size() * sizeof(int32_t)) == false)))
+		{
+			LOG_WARNING_LIMITED(LOST_LOG_INTERVAL_MS, "Wall node lost");
+			DropSocket(i - 1);
+			m_stats.nodesLost++;
+		}
+	}
+}
+
+/***********************************************************
+ *  BroadcastQuit()
+ *
+ *  This method is used for telling the nodes the master
+ *  closes, so they close too.
+ ***********************************************************/
+void WallSync::BroadcastQuit()
+{
+	WALL_FRAME frame;
+	memset(&frame, 0, sizeof(frame));
+	frame.magic = FRAME_MAGIC;
+	frame.frame = ++m_frame;
+	frame.flags = FRAME_QUIT;
+	for (size_t i = 0; i < m_sockets.size(); i++)
+	{
+		NetSocket::SendAll(m_sockets[i], &frame, sizeof(frame));
+	}
+}
+
+/***********************************************************
+ *  ReceiveFrame()
+ *
+ *  This method is used for taking the master's next frame,
+ *  skipping the swap of a barrier the node already left.
+ ***********************************************************/
+bool WallSync::ReceiveFrame(std::vector<int>& keys, CameraPath::CAMERA_POSE& pose)
+{
+	if (m_sockets.empty() == true)
+	{
+		return(false);
+	}
+
+	WALL_FRAME frame;
+	if (m_bFramePending == true)
+	{
+		frame = m_pendingFrame;
+		keys = m_pendingKeys;
+		m_bFramePending = false;
+	}
+	else
+	{
+		while (true)
+		{
+			WALL_SIGNAL signal;
+			bool bLost = false;
+			if (ReadExact(m_sockets[0], &signal, sizeof(signal), FRAME_TIMEOUT_SECONDS, bLost) == false)
+			{
+				LOG_WARNING_LIMITED(LOST_LOG_INTERVAL_MS, "Wall master lost");
+				DropSocket(0);
+				return(false);
+			}
+			if (signal.magic == SWAP_MAGIC)
+			{
+				continue;
+			}
+			if ((signal.magic != FRAME_MAGIC) || (ReadFrame(m_sockets[0], signal, frame, keys) == false))
+			{
+				LOG_WARNING_LIMITED(LOST_LOG_INTERVAL_MS, "Wall master lost");
+				DropSocket(0);
+				return(false);
+			}
+			break;
+		}
+	}
+
+	if ((frame.flags & FRAME_QUIT) != 0)
+	{
+		return(false);
+	}
+	m_frame = frame.frame;
+	pose.position = glm::vec3(frame.position[0], frame.position[1], frame.position[2]);
+	pose.front = glm::vec3(frame.front[0], frame.front[1], frame.front[2]);
+	pose.up = glm::vec3(frame.up[0], frame.up[1], frame.up[2]);
+	pose.yaw = frame.yaw;
+	pose.pitch = frame.pitch;
+	pose.zoom = frame.zoom;
+	pose.bOrthographic = ((frame.flags & FRAME_ORTHOGRAPHIC) != 0);
+	return(true);
+}
+
+/***********************************************************
+ *  SwapBarrier()
+ *
+ *  This method is used for holding the swap of the frame
+ *  until every node rendered it. A node reports the frame
+ *  and waits for the master's swap; the master waits for
+ *  every report, then sends the swap. Reports and swaps of
+ *  earlier frames, left behind by a timeout, are skipped.
+ ***********************************************************/
+void WallSync::SwapBarrier()
+{
+	double startTime = NowSeconds();
+	WALL_SIGNAL signal;
+	if (m_bMaster == true)
+	{
+		for (size_t i = m_sockets.size(); i > 0; i--)
+		{
+			while (true)
+			{
+				bool bLost = false;
+				if (ReadExact(m_sockets[i - 1], &signal, sizeof(signal), BARRIER_TIMEOUT_SECONDS, bLost) == false)
+				{
+					if (bLost == true)
+					{
+						LOG_WARNING_LIMITED(LOST_LOG_INTERVAL_MS, "Wall node lost");
+						DropSocket(i - 1);
+						m_stats.nodesLost++;
+					}
+					else
+					{
+						m_stats.barrierTimeouts++;
+					}
+					break;
+				}
+				if ((signal.magic == READY_MAGIC) && ((int32_t)(signal.frame - m_frame) >= 0))
+				{
+					break;
+				}
+			}
+		}
+		signal.magic = SWAP_MAGIC;
+		signal.frame = m_frame;
+		for (size_t i = 0; i < m_sockets.size(); i++)
+		{
+			NetSocket::SendAll(m_sockets[i], &signal, sizeof(signal));
+		}
+	}
+	else if (m_sockets.empty() == false)
+	{
+		signal.magic = READY_MAGIC;
+		signal.frame = m_frame;
+		NetSocket::SendAll(m_sockets[0], &signal, sizeof(signal));
+		while (true)
+		{
+			bool bLost = false;
+			if (ReadExact(m_sockets[0], &signal, sizeof(signal), BARRIER_TIMEOUT_SECONDS, bLost) == false)
+			{
+				if (bLost == true)
+				{
+					LOG_WARNING_LIMITED(LOST_LOG_INTERVAL_MS, "Wall master lost");
+					DropSocket(0);
+				}
+				else
+				{
+					m_stats.barrierTimeouts++;
+				}
+				break;
+			}
+			if ((signal.magic == SWAP_MAGIC) && ((int32_t)(signal.frame - m_frame) >= 0))
+			{
+				break;
+			}
+			// the master went on without swapping this frame, so the
+			// next one is kept for ReceiveFrame()
+			if (signal.magic == FRAME_MAGIC)
+			{
+				if (ReadFrame(m_sockets[0], signal, m_pendingFrame, m_pendingKeys) == false)
+				{
+					LOG_WARNING_LIMITED(LOST_LOG_INTERVAL_MS, "Wall master lost");
+					DropSocket(0);
+					break;
+				}
+				m_bFramePending = true;
+				break;
+			}
+		}
+	}
+
+	double seconds = NowSeconds() - startTime;
+	m_stats.frames++;
+	m_stats.barrierSeconds += seconds;
+	m_stats.barrierMaxSeconds = std::max(m_stats.barrierMaxSeconds, seconds);
+}
+
+/***********************************************************
+ *  ReadFrame()
+ *
+ *  This method is used for reading the rest of a frame and
+ *  its key presses after its signal.
+ ***********************************************************/
+bool WallSync::ReadFrame(uintptr_t socketHandle, const WALL_SIGNAL& signal, WALL_FRAME& frame, std::vector<int>& keys)
+{
+	bool bLost = false;
+	memcpy(&frame, &signal, sizeof(signal));
+	if ((ReadExact(socketHandle, (unsigned char*)&frame + sizeof(signal), sizeof(frame) - sizeof(signal),
+		FRAME_TIMEOUT_SECONDS, bLost) == false) || (frame.keyCount > MAX_FRAME_KEYS))
+	{
+		return(false);
+	}
+	std::vector<int32_t> frameKeys(frame.keyCount);
+	if ((frameKeys.empty() == false) &&
+		(ReadExact(socketHandle, frameKeys.data(), frameKeys.size() * sizeof(int32_t), FRAME_TIMEOUT_SECONDS, bLost) == false))
+	{
+		return(false);
+	}
+	keys.assign(frameKeys.begin(), frameKeys.end());
+	return(true);
+}
+
+/***********************************************************
+ *  ReadExact()
+ *
+ *  This method is used for reading a whole message, which
+ *  may arrive split anywhere. The size asked for never
+ *  reaches into the next message.
+ ***********************************************************/
+bool WallSync::ReadExact(uintptr_t socketHandle, void* pData, size_t size, double seconds, bool& bLost)
+{
+	bLost = false;
+	unsigned char* pBytes = (unsigned char*)pData;
+	double startTime = NowSeconds();
+	while (size > 0)
+	{
+		double remaining = seconds - (NowSeconds() - startTime);
+		if (remaining <= 0.0)
+		{
+			return(false);
+		}
+		if (NetSocket::WaitReadable(socketHandle, (long)(std::min(remaining, 1.0) * 1000000.0)) == false)
+		{
+			continue;
+		}
+		int received = NetSocket::Receive(socketHandle, pBytes, size);
+		if (received <= 0)
+		{
+			bLost = true;
+			return(false);
+		}
+		pBytes += received;
+		size -= (size_t)received;
+	}
+	return(true);
+}
+
+/***********************************************************
+ *  DropSocket()
+ *
+ *  This method is used for closing a connection.
+ ***********************************************************/
+void WallSync::DropSocket(size_t index)
+{
+	NetSocket::Close(m_sockets[index]);
+	m_sockets.erase(m_sockets.begin() + index);
+	if ((m_sockets.empty() == true) && (m_listenSocket == NO_SOCKET))
+	{
+		NetSocket::Cleanup();
+	}
+}
+
+/***********************************************************
+ *  PrintStats()
+ *
+ *  This method is used for printing the frames locked and
+ *  the time the swaps waited for the other nodes.
+ ***********************************************************/
+void WallSync::PrintStats() const
+{
+	std::cout << "\n*** WALL: ***\n";
+	std::cout << ((m_bMaster == true) ? "master" : "node")
+		<< "\tswap group " << ((m_bSwapGroup == true) ? "yes" : "no")
+		<< "\tframes " << m_stats.frames
+		<< "\tbarrier timeouts " << m_stats.barrierTimeouts
+		<< "\tnodes lost " << m_stats.nodesLost << "\n";
+	if (m_stats.frames > 0)
+	{
+		std::cout << "barrier wait\tmean " << (m_stats.barrierSeconds * 1000.0 / m_stats.frames)
+			<< " ms\tmax " << (m_stats.barrierMaxSeconds * 1000.0) << " ms\n";
+	}
+}
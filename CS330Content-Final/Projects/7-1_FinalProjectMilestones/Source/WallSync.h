@@ -0,0 +1,138 @@
+///////////////////////////////////////////////////////////////////////////////
+// wallsync.h
+// ============
+// frame lock of the nodes of a video wall, each showing a tile of it
+//
+//  A wall of displays driven by several machines shows one picture:
+//  every node renders its tile of the frustum the camera has over the
+//  whole wall (ViewManager::SetWallTile()), from the camera of the
+//  master node. The master sends each frame's camera and key presses
+//  to the nodes before rendering it, so the settings the keys toggle
+//  change on every node with the same frame, and the nodes render it
+//  from there. Before the swap each node reports the frame ready and
+//  waits for the master, which swaps once all are, so the displays
+//  change together. Where the driver has NV_swap_group the nodes also
+//  join a swap group bound to the barrier of a frame lock board,
+//  which aligns their swaps to one refresh; without it the software
+//  barrier alone keeps the frames in lock.
+//
+//  Messages are little endian and start with a magic and the frame
+//  number; a WALL_FRAME is followed by its key presses, as int32s.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "CameraPath.h"
+
+#include <cstdint>
+#include <vector>
+
+/***********************************************************
+ *  WallSync
+ *
+ *  This class contains the connections of the master to the
+ *  nodes, or of a node to the master, and the swap group.
+ *  The master calls BroadcastFrame() after preparing each
+ *  frame, a node ReceiveFrame() before preparing it, and
+ *  both SwapBarrier() right before the swap.
+ ***********************************************************/
+class WallSync
+{
+public:
+	// constructor
+	WallSync();
+	// destructor
+	~WallSync();
+
+	static const uint32_t FRAME_MAGIC = 0x464C4157;		// "WALF"
+	static const uint32_t READY_MAGIC = 0x524C4157;		// "WALR"
+	static const uint32_t SWAP_MAGIC = 0x534C4157;		// "WALS"
+
+	// what else a frame of the master carries
+	enum FRAME_FLAG
+	{
+		FRAME_ORTHOGRAPHIC = 1,
+		// the master closed, and the nodes close with it
+		FRAME_QUIT = 2
+	};
+
+	// the start of every message, and the whole of READY and SWAP
+	struct WALL_SIGNAL
+	{
+		uint32_t magic;
+		uint32_t frame;
+	};
+	// the camera and the key presses of a frame, 60 bytes
+	struct WALL_FRAME
+	{
+		uint32_t magic;
+		uint32_t frame;
+		uint32_t flags;
+		uint32_t keyCount;
+		float position[3];
+		float front[3];
+		float up[3];
+		float yaw;
+		float pitch;
+		float zoom;
+	};
+
+	// the frames locked and the time waited for the others
+	struct WALL_STATS
+	{
+		unsigned long long frames;
+		unsigned long long barrierTimeouts;
+		unsigned long long nodesLost;
+		double barrierSeconds;
+		double barrierMaxSeconds;
+	};
+
+	// listen on a TCP port and wait until the nodes all connected;
+	// false when the port cannot be opened
+	bool StartMaster(int port, int nodeCount);
+	// connect to the master at host:port; false when it cannot be
+	// reached
+	bool ConnectNode(const char* address);
+	bool IsMaster() const { return(m_bMaster); }
+
+	// join swap group 1 and bind it to barrier 1, with the context
+	// of the window current; false without NV_swap_group
+	bool JoinSwapGroup();
+	bool HasSwapGroup() const { return(m_bSwapGroup); }
+
+	// send the nodes the camera and the key presses of the frame
+	// about to render, or that the master closes
+	void BroadcastFrame(const std::vector<int>& keys, const CameraPath::CAMERA_POSE& pose);
+	void BroadcastQuit();
+	// wait for the master's next frame; false once the master
+	// closed or was lost
+	bool ReceiveFrame(std::vector<int>& keys, CameraPath::CAMERA_POSE& pose);
+	// wait until every node rendered the frame, right before the
+	// swap; a node waiting too long swaps without the others
+	void SwapBarrier();
+
+	const WALL_STATS& GetStats() const { return(m_stats); }
+	void PrintStats() const;
+
+private:
+	bool m_bMaster;
+	uintptr_t m_listenSocket;
+	// the nodes of the master, or the master of a node
+	std::vector<uintptr_t> m_sockets;
+	uint32_t m_frame;
+	bool m_bSwapGroup;
+	// a frame a node read while waiting at the barrier, for the
+	// next ReceiveFrame()
+	bool m_bFramePending;
+	WALL_FRAME m_pendingFrame;
+	std::vector<int> m_pendingKeys;
+	WALL_STATS m_stats;
+
+	// read exactly the size given, waiting at most the time given;
+	// false on a timeout or a failed connection, which bLost tells
+	bool ReadExact(uintptr_t socketHandle, void* pData, size_t size, double seconds, bool& bLost);
+	// read the rest of a frame whose signal was read
+	bool ReadFrame(uintptr_t socketHandle, const WALL_SIGNAL& signal, WALL_FRAME& frame, std::vector<int>& keys);
+	// close the connection of a node or of the master
+	void DropSocket(size_t index);
+};
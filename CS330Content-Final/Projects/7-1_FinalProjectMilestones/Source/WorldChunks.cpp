@@ -0,0 +1,566 @@
+///////////////////////////////////////////////////////////////////////////////
+// worldchunks.cpp
+// ============
+// stream the chunks of a large scene file in and out around the camera
+//
+//  A scene file too large to hold at once is cut into square chunks of
+//  the ground plane, each with the instances standing in it, the model
+//  and texture files they need and, once recorded, the bake of its
+//  static draws. Only the resident chunks are recorded into the render
+//  list. Every frame the chunks near the camera and near where its
+//  velocity takes it next are loaded, the nearest first, as long as
+//  the files and bakes of the resident ones fit the budget; the models
+//  are imported on the loader thread of the resource manager, and a
+//  chunk joins the scene once they are all in. Chunks farther than the
+//  load radius by a margin are dropped, the farthest first, so a
+//  camera moving along a chunk edge does not load and drop the same
+//  chunk every frame.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "WorldChunks.h"
+
+#include <glm/gtc/type_ptr.hpp>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <utility>
+
+namespace
+{
+	// side of a chunk and the load radius unless they are set
+	const float DEFAULT_CHUNK_SIZE = 0.0f;
+	const float DEFAULT_LOAD_RADIUS = 64.0f;
+	// a chunk is dropped this far past the load radius, so one on
+	// the edge is not loaded and dropped every other frame
+	const float UNLOAD_RADIUS_SCALE = 1.25f;
+	// seconds ahead the camera velocity is followed to the chunks
+	// loaded before the camera gets there
+	const float PREDICT_SECONDS = 1.0f;
+	// weight of the newest velocity in the smoothed one
+	const float VELOCITY_SMOOTHING = 0.25f;
+	// a longer gap between updates, like a hitch or a jump of the
+	// camera, starts the velocity over
+	const float MAX_VELOCITY_SECONDS = 0.5f;
+
+	/***********************************************************
+	 *  GetFileBytes()
+	 *
+	 *  This function is used for the size of a file, 0 when
+	 *  it cannot be opened.
+	 ***********************************************************/
+	size_t GetFileBytes(const char* path)
+	{
+		std::ifstream file(path, std::ios::binary | std::ios::ate);
+		if (file.is_open() == false)
+		{
+			return(0);
+		}
+		std::streamoff bytes = file.tellg();
+		return((bytes > 0) ? (size_t)bytes : 0);
+	}
+
+	/***********************************************************
+	 *  DistanceToBounds()
+	 *
+	 *  This function is used for the distance from a point to
+	 *  a box, 0 inside it.
+	 ***********************************************************/
+	float DistanceToBounds(const glm::vec3& point, const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+	{
+		glm::vec3 closest = glm::clamp(point, boundsMin, boundsMax);
+		return(glm::length(point - closest));
+	}
+
+	/***********************************************************
+	 *  SortUnique()
+	 *
+	 *  This function is used for keeping each index of a list
+	 *  once.
+	 ***********************************************************/
+	void SortUnique(std::vector<int>& indexes)
+	{
+		std::sort(indexes.begin(), indexes.end());
+		indexes.erase(std::unique(indexes.begin(), indexes.end()), indexes.end());
+	}
+}
+
+/***********************************************************
+ *  WorldChunks()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+WorldChunks::WorldChunks()
+{
+	m_fileBytes = 0;
+	m_chunkSize = DEFAULT_CHUNK_SIZE;
+	m_loadRadius = DEFAULT_LOAD_RADIUS;
+	m_budget = DEFAULT_BUDGET;
+	m_ready = NULL;
+	m_pReadyContext = NULL;
+	m_lastPosition = glm::vec3(0.0f);
+	m_bHasLastPosition = false;
+	m_velocity = glm::vec3(0.0f);
+	m_loads = 0;
+	m_unloads = 0;
+	m_deferred = 0;
+	m_peakResidentBytes = 0;
+}
+
+/***********************************************************
+ *  ~WorldChunks()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+WorldChunks::~WorldChunks()
+{
+	Clear();
+}
+
+/***********************************************************
+ *  SetReadyCallback()
+ *
+ *  This method is used for setting the function the
+ *  loading chunks are polled through.
+ ***********************************************************/
+void WorldChunks::SetReadyCallback(ReadyCallback ready, void* pContext)
+{
+	m_ready = ready;
+	m_pReadyContext = pContext;
+}
+
+/***********************************************************
+ *  Build()
+ *
+ *  This method is used for cutting the instances of the
+ *  scene file into the chunks their positions fall in. An
+ *  instance reaches as far from its position as the parts
+ *  of its prefab, each taken as a mesh of its scale around
+ *  its offset, so the bounds hold whatever way it is
+ *  turned. The files are measured once here, for the
+ *  budget.
+ ***********************************************************/
+bool WorldChunks::Build(const SceneFile& sceneFile)
+{
+	Clear();
+	if ((m_chunkSize <= 0.0f) || (sceneFile.IsLoaded() == false) || (sceneFile.GetInstanceCount() == 0))
+	{
+		return(false);
+	}
+
+	const SceneFile::PART_RECORD* pParts = sceneFile.GetParts();
+	const SceneFile::PREFAB_RECORD* pPrefabs = sceneFile.GetPrefabs();
+	const SceneFile::INSTANCE_RECORD* pInstances = sceneFile.GetInstances();
+
+	// reach of every prefab at the scale of 1
+	std::vector<float> prefabRadii(sceneFile.GetPrefabCount(), 0.0f);
+	for (uint32_t i = 0; i < sceneFile.GetPrefabCount(); i++)
+	{
+		for (uint32_t p = 0; p < pPrefabs[i].partCount; p++)
+		{
+			const SceneFile::PART_RECORD& part = pParts[pPrefabs[i].firstPart + p];
+			float reach = glm::length(glm::make_vec3(part.positionXYZ)) + glm::length(glm::make_vec3(part.scaleXYZ));
+			prefabRadii[i] = glm::max(prefabRadii[i], reach);
+		}
+	}
+
+	std::map<std::pair<int, int>, int> cells;
+	m_instanceChunks.assign(sceneFile.GetInstanceCount(), -1);
+	for (uint32_t i = 0; i < sceneFile.GetInstanceCount(); i++)
+	{
+		const SceneFile::INSTANCE_RECORD& instance = pInstances[i];
+		glm::vec3 position = glm::make_vec3(instance.positionXYZ);
+		std::pair<int, int> cell((int)std::floor(position.x / m_chunkSize), (int)std::floor(position.z / m_chunkSize));
+
+		std::map<std::pair<int, int>, int>::iterator found = cells.find(cell);
+		if (found == cells.end())
+		{
+			CHUNK chunk;
+			chunk.cellX = cell.first;
+			chunk.cellZ = cell.second;
+			chunk.boundsMin = glm::vec3(FLT_MAX);
+			chunk.boundsMax = glm::vec3(-FLT_MAX);
+			chunk.state = CHUNK_UNLOADED;
+			chunk.distance = FLT_MAX;
+			chunk.pGeometry = NULL;
+			chunk.geometryKey = 0;
+			m_chunks.push_back(chunk);
+			found = cells.insert(std::make_pair(cell, (int)m_chunks.size() - 1)).first;
+		}
+
+		CHUNK& chunk = m_chunks[found->second];
+		chunk.instances.push_back(i);
+		m_instanceChunks[i] = found->second;
+
+		glm::vec3 scale = glm::abs(glm::make_vec3(instance.scaleXYZ));
+		float radius = prefabRadii[instance.prefabIndex] * glm::max(scale.x, glm::max(scale.y, scale.z));
+		chunk.boundsMin = glm::min(chunk.boundsMin, position - glm::vec3(radius));
+		chunk.boundsMax = glm::max(chunk.boundsMax, position + glm::vec3(radius));
+
+		const SceneFile::PREFAB_RECORD& prefab = pPrefabs[instance.prefabIndex];
+		for (uint32_t p = 0; p < prefab.partCount; p++)
+		{
+			const SceneFile::PART_RECORD& part = pParts[prefab.firstPart + p];
+			if ((part.mesh == SceneFile::MESH_MODEL) && (part.modelIndex >= 0))
+			{
+				chunk.models.push_back(part.modelIndex);
+			}
+			if (part.textureIndex >= 0)
+			{
+				chunk.textures.push_back(part.textureIndex);
+			}
+		}
+	}
+	for (size_t i = 0; i < m_chunks.size(); i++)
+	{
+		SortUnique(m_chunks[i].models);
+		SortUnique(m_chunks[i].textures);
+	}
+
+	const SceneFile::MODEL_RECORD* pModels = sceneFile.GetModels();
+	m_modelBytes.resize(sceneFile.GetModelCount());
+	for (uint32_t i = 0; i < sceneFile.GetModelCount(); i++)
+	{
+		m_modelBytes[i] = GetFileBytes(pModels[i].path);
+	}
+	const SceneFile::TEXTURE_RECORD* pTextures = sceneFile.GetTextures();
+	m_textureBytes.resize(sceneFile.GetTextureCount());
+	for (uint32_t i = 0; i < sceneFile.GetTextureCount(); i++)
+	{
+		m_textureBytes[i] = GetFileBytes(pTextures[i].path);
+	}
+	m_modelUsers.assign(m_modelBytes.size(), 0);
+	m_textureUsers.assign(m_textureBytes.size(), 0);
+	m_fileBytes = 0;
+	m_bHasLastPosition = false;
+	m_velocity = glm::vec3(0.0f);
+
+	std::cout << "Cut " << sceneFile.GetInstanceCount() << " instances into " << m_chunks.size()
+		<< " chunks of " << m_chunkSize << " units" << std::endl;
+	return(true);
+}
+
+/***********************************************************
+ *  Clear()
+ *
+ *  This method is used for dropping every chunk and the
+ *  bakes of the resident ones.
+ ***********************************************************/
+void WorldChunks::Clear()
+{
+	for (size_t i = 0; i < m_chunks.size(); i++)
+	{
+		delete m_chunks[i].pGeometry;
+	}
+	m_chunks.clear();
+	m_instanceChunks.clear();
+	m_modelBytes.clear();
+	m_textureBytes.clear();
+	m_modelUsers.clear();
+	m_textureUsers.clear();
+	m_fileBytes = 0;
+}
+
+/***********************************************************
+ *  Update()
+ *
+ *  This method is used for moving the chunks along for the
+ *  camera. The velocity between the updates is smoothed
+ *  and followed PREDICT_SECONDS ahead, and a chunk is as
+ *  far as the nearer of the camera and that point. The
+ *  loading chunks are polled, those out of reach dropped,
+ *  and the nearest wanted ones start loading while fewer
+ *  than MAX_LOADING_CHUNKS do. A wanted chunk that does not
+ *  fit the budget takes the place of resident chunks
+ *  farther than it, the farthest first, or waits; the first
+ *  chunk is loaded whatever it takes, else the camera would
+ *  stand in nothing.
+ ***********************************************************/
+bool WorldChunks::Update(const glm::vec3& position)
+{
+	if (m_chunks.empty() == true)
+	{
+		return(false);
+	}
+
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	if (m_bHasLastPosition == true)
+	{
+		float seconds = std::chrono::duration<float>(now - m_lastTime).count();
+		if ((seconds > 0.0f) && (seconds < MAX_VELOCITY_SECONDS))
+		{
+			m_velocity = glm::mix(m_velocity, (position - m_lastPosition) / seconds, VELOCITY_SMOOTHING);
+		}
+		else if (seconds >= MAX_VELOCITY_SECONDS)
+		{
+			m_velocity = glm::vec3(0.0f);
+		}
+	}
+	m_lastPosition = position;
+	m_lastTime = now;
+	m_bHasLastPosition = true;
+	glm::vec3 predicted = position + m_velocity * PREDICT_SECONDS;
+
+	bool bChanged = false;
+	int loading = 0;
+	std::vector<int> wanted;
+	for (size_t i = 0; i < m_chunks.size(); i++)
+	{
+		CHUNK& chunk = m_chunks[i];
+		chunk.distance = glm::min(DistanceToBounds(position, chunk.boundsMin, chunk.boundsMax),
+			DistanceToBounds(predicted, chunk.boundsMin, chunk.boundsMax));
+
+		if ((chunk.state != CHUNK_UNLOADED) && (chunk.distance > m_loadRadius * UNLOAD_RADIUS_SCALE))
+		{
+			bChanged = (bChanged == true) || (chunk.state == CHUNK_RESIDENT);
+			UnloadChunk(chunk);
+		}
+		else if (chunk.state == CHUNK_LOADING)
+		{
+			if ((NULL == m_ready) || (m_ready(m_pReadyContext, chunk) == true))
+			{
+				chunk.state = CHUNK_RESIDENT;
+				m_loads++;
+				bChanged = true;
+			}
+			else
+			{
+				loading++;
+			}
+		}
+		else if ((chunk.state == CHUNK_UNLOADED) && (chunk.distance <= m_loadRadius))
+		{
+			wanted.push_back((int)i);
+		}
+	}
+
+	std::sort(wanted.begin(), wanted.end(), [this](int a, int b) {
+		return(m_chunks[a].distance < m_chunks[b].distance);
+	});
+	for (size_t w = 0; (w < wanted.size()) && (loading < MAX_LOADING_CHUNKS); w++)
+	{
+		CHUNK& chunk = m_chunks[wanted[w]];
+		while (GetResidentBytes() + GetAddedBytes(chunk) > m_budget)
+		{
+			int farthest = -1;
+			for (size_t i = 0; i < m_chunks.size(); i++)
+			{
+				if ((m_chunks[i].state != CHUNK_UNLOADED) && (m_chunks[i].distance > chunk.distance) &&
+					((farthest < 0) || (m_chunks[i].distance > m_chunks[farthest].distance)))
+				{
+					farthest = (int)i;
+				}
+			}
+			if (farthest < 0)
+			{
+				break;
+			}
+			bChanged = (bChanged == true) || (m_chunks[farthest].state == CHUNK_RESIDENT);
+			UnloadChunk(m_chunks[farthest]);
+		}
+		if ((GetResidentBytes() + GetAddedBytes(chunk) > m_budget) && (GetResidentBytes() > 0))
+		{
+			m_deferred++;
+			break;
+		}
+
+		AddChunkFiles(chunk);
+		chunk.state = CHUNK_LOADING;
+		// a chunk whose models are all in already joins at once
+		if ((NULL == m_ready) || (m_ready(m_pReadyContext, chunk) == true))
+		{
+			chunk.state = CHUNK_RESIDENT;
+			m_loads++;
+			bChanged = true;
+		}
+		else
+		{
+			loading++;
+		}
+	}
+
+	m_peakResidentBytes = glm::max(m_peakResidentBytes, (unsigned long long)GetResidentBytes());
+	return(bChanged);
+}
+
+/***********************************************************
+ *  UnloadChunk()
+ *
+ *  This method is used for dropping a resident or loading
+ *  chunk: its files stop counting, and its bake is freed.
+ *  A load it started runs on, and whatever it brings in is
+ *  kept for the next chunk needing it.
+ ***********************************************************/
+void WorldChunks::UnloadChunk(CHUNK& chunk)
+{
+	if (chunk.state == CHUNK_UNLOADED)
+	{
+		return;
+	}
+
+	RemoveChunkFiles(chunk);
+	delete chunk.pGeometry;
+	chunk.pGeometry = NULL;
+	chunk.geometryKey = 0;
+	if (chunk.state == CHUNK_RESIDENT)
+	{
+		m_unloads++;
+	}
+	chunk.state = CHUNK_UNLOADED;
+}
+
+/***********************************************************
+ *  GetAddedBytes()
+ *
+ *  This method is used for the bytes of the files of a
+ *  chunk no resident or loading chunk uses yet.
+ ***********************************************************/
+size_t WorldChunks::GetAddedBytes(const CHUNK& chunk) const
+{
+	size_t bytes = 0;
+	for (size_t i = 0; i < chunk.models.size(); i++)
+	{
+		bytes += (0 == m_modelUsers[chunk.models[i]]) ? m_modelBytes[chunk.models[i]] : 0;
+	}
+	for (size_t i = 0; i < chunk.textures.size(); i++)
+	{
+		bytes += (0 == m_textureUsers[chunk.textures[i]]) ? m_textureBytes[chunk.textures[i]] : 0;
+	}
+	return(bytes);
+}
+
+/***********************************************************
+ *  AddChunkFiles()
+ *
+ *  This method is used for counting the files of a chunk
+ *  in, each once however many chunks use it.
+ ***********************************************************/
+void WorldChunks::AddChunkFiles(const CHUNK& chunk)
+{
+	m_fileBytes += GetAddedBytes(chunk);
+	for (size_t i = 0; i < chunk.models.size(); i++)
+	{
+		m_modelUsers[chunk.models[i]]++;
+	}
+	for (size_t i = 0; i < chunk.textures.size(); i++)
+	{
+		m_textureUsers[chunk.textures[i]]++;
+	}
+}
+
+/***********************************************************
+ *  RemoveChunkFiles()
+ *
+ *  This method is used for counting the files of a chunk
+ *  out, once no other chunk uses them.
+ ***********************************************************/
+void WorldChunks::RemoveChunkFiles(const CHUNK& chunk)
+{
+	for (size_t i = 0; i < chunk.models.size(); i++)
+	{
+		if (0 == --m_modelUsers[chunk.models[i]])
+		{
+			m_fileBytes -= m_modelBytes[chunk.models[i]];
+		}
+	}
+	for (size_t i = 0; i < chunk.textures.size(); i++)
+	{
+		if (0 == --m_textureUsers[chunk.textures[i]])
+		{
+			m_fileBytes -= m_textureBytes[chunk.textures[i]];
+		}
+	}
+}
+
+/***********************************************************
+ *  GetResidentBytes()
+ *
+ *  This method is used for the bytes of the files the
+ *  resident and loading chunks use and of the bakes of the
+ *  resident ones, as the CPU copies and the merged buffers
+ *  hold them alike.
+ ***********************************************************/
+size_t WorldChunks::GetResidentBytes() const
+{
+	size_t bytes = m_fileBytes;
+	for (size_t i = 0; i < m_chunks.size(); i++)
+	{
+		if (NULL != m_chunks[i].pGeometry)
+		{
+			bytes += 2 * (m_chunks[i].pGeometry->GetVertices().size() * sizeof(GLfloat) +
+				m_chunks[i].pGeometry->GetIndices().size() * sizeof(GLuint));
+		}
+	}
+	return(bytes);
+}
+
+/***********************************************************
+ *  GetInstanceChunk()
+ *
+ *  This method is used for the chunk a scene file instance
+ *  stands in, -1 when the scene is not cut into chunks.
+ ***********************************************************/
+int WorldChunks::GetInstanceChunk(uint32_t instance) const
+{
+	return((instance < m_instanceChunks.size()) ? m_instanceChunks[instance] : -1);
+}
+
+/***********************************************************
+ *  IsInstanceResident()
+ *
+ *  This method is used for checking whether the chunk of a
+ *  scene file instance is recorded; every instance is when
+ *  the scene is not cut into chunks.
+ ***********************************************************/
+bool WorldChunks::IsInstanceResident(uint32_t instance) const
+{
+	int chunk = GetInstanceChunk(instance);
+	return((chunk < 0) || (m_chunks[chunk].state == CHUNK_RESIDENT));
+}
+
+/***********************************************************
+ *  GetStats()
+ *
+ *  This method is used for counting the chunks in each
+ *  state and the bytes they hold now, with the loads since
+ *  the start.
+ ***********************************************************/
+WorldChunks::CHUNK_STATS WorldChunks::GetStats() const
+{
+	CHUNK_STATS stats;
+	stats.chunks = (int)m_chunks.size();
+	stats.resident = 0;
+	stats.loading = 0;
+	for (size_t i = 0; i < m_chunks.size(); i++)
+	{
+		stats.resident += (m_chunks[i].state == CHUNK_RESIDENT) ? 1 : 0;
+		stats.loading += (m_chunks[i].state == CHUNK_LOADING) ? 1 : 0;
+	}
+	stats.loads = m_loads;
+	stats.unloads = m_unloads;
+	stats.deferred = m_deferred;
+	stats.residentBytes = (unsigned long long)GetResidentBytes();
+	stats.peakResidentBytes = m_peakResidentBytes;
+	return(stats);
+}
+
+/***********************************************************
+ *  Print()
+ *
+ *  This method is used for printing the stats for the exit
+ *  report.
+ ***********************************************************/
+void WorldChunks::Print() const
+{
+	CHUNK_STATS stats = GetStats();
+	std::cout << "world chunks " << stats.chunks
+		<< "\tresident " << stats.resident
+		<< "\tloads " << stats.loads
+		<< "\tunloads " << stats.unloads
+		<< "\tdeferred " << stats.deferred
+		<< "\tKB " << stats.residentBytes / 1024
+		<< "\tpeak KB " << stats.peakResidentBytes / 1024 << "\n";
+}
@@ -0,0 +1,181 @@
+///////////////////////////////////////////////////////////////////////////////
+// worldchunks.h
+// ============
+// stream the chunks of a large scene file in and out around the camera
+//
+//  A scene file too large to hold at once is cut into square chunks of
+//  the ground plane, each with the instances standing in it, the model
+//  and texture files they need and, once recorded, the bake of its
+//  static draws. Only the resident chunks are recorded into the render
+//  list. Every frame the chunks near the camera and near where its
+//  velocity takes it next are loaded, the nearest first, as long as
+//  the files and bakes of the resident ones fit the budget; the models
+//  are imported on the loader thread of the resource manager, and a
+//  chunk joins the scene once they are all in. Chunks farther than the
+//  load radius by a margin are dropped, the farthest first, so a
+//  camera moving along a chunk edge does not load and drop the same
+//  chunk every frame.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "SceneFile.h"
+#include "StaticGeometry.h"
+
+#include <glm/glm.hpp>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/***********************************************************
+ *  WorldChunks
+ *
+ *  This class contains the chunks of the scene file, the
+ *  state each one is in and the camera motion they are
+ *  loaded against. The loads themselves are the scene's,
+ *  asked for through the ready callback.
+ ***********************************************************/
+class WorldChunks
+{
+public:
+	// constructor
+	WorldChunks();
+	// destructor
+	~WorldChunks();
+
+	// how far a chunk is loaded
+	enum CHUNK_STATE
+	{
+		CHUNK_UNLOADED = 0,
+		CHUNK_LOADING,		// its models are imported
+		CHUNK_RESIDENT		// recorded into the render list
+	};
+
+	// one square of the ground plane and what stands in it
+	struct CHUNK
+	{
+		int cellX;
+		int cellZ;
+		// world bounds of its instances
+		glm::vec3 boundsMin;
+		glm::vec3 boundsMax;
+		// scene file indexes of its instances, and of the models
+		// and textures their parts use, each listed once
+		std::vector<uint32_t> instances;
+		std::vector<int> models;
+		std::vector<int> textures;
+		CHUNK_STATE state;
+		// distance to the nearer of the camera and where it is
+		// heading, at the last Update()
+		float distance;
+		// bake of its opaque static draws, NULL until it is resident
+		// and has some; its key tells whether a new recording can
+		// keep it
+		StaticGeometry* pGeometry;
+		uint64_t geometryKey;
+	};
+
+	// the chunks and their loads since the start
+	struct CHUNK_STATS
+	{
+		int chunks;
+		int resident;
+		int loading;
+		unsigned long long loads;			// chunks that became resident
+		unsigned long long unloads;
+		unsigned long long deferred;		// updates a wanted chunk did not fit the budget
+		unsigned long long residentBytes;	// of the resident and loading chunks now
+		unsigned long long peakResidentBytes;
+	};
+
+	// polled every Update() for a loading chunk: starts the loads it
+	// needs the first time, and returns true once they all finished
+	typedef bool (*ReadyCallback)(void* pContext, const CHUNK& chunk);
+
+	// files and bakes the resident chunks may take by default
+	static const size_t DEFAULT_BUDGET = 256 * 1024 * 1024;
+	// chunks loading at the same time
+	static const int MAX_LOADING_CHUNKS = 2;
+
+	// side of a chunk in world units, 0 to hold the whole scene;
+	// taken by the next Build()
+	void SetChunkSize(float chunkSize) { m_chunkSize = chunkSize; }
+	float GetChunkSize() const { return(m_chunkSize); }
+	// distance from the camera a chunk is loaded within
+	void SetLoadRadius(float loadRadius) { m_loadRadius = loadRadius; }
+	void SetBudget(size_t budgetBytes) { m_budget = budgetBytes; }
+	void SetReadyCallback(ReadyCallback ready, void* pContext);
+
+	// cut the instances of the scene file into chunks, all of them
+	// unloaded; false when the chunk size is 0, which leaves none
+	bool Build(const SceneFile& sceneFile);
+	// drop every chunk and its bake
+	void Clear();
+	bool IsEnabled() const { return(m_chunks.empty() == false); }
+
+	// move the chunks along for the camera at position: poll the
+	// loading ones, drop the ones out of reach and start loading the
+	// nearest wanted ones that fit. Returns true when a chunk became
+	// resident or was dropped, so the render list is recorded again
+	bool Update(const glm::vec3& position);
+
+	size_t GetChunkCount() const { return(m_chunks.size()); }
+	CHUNK& GetChunk(size_t index) { return(m_chunks[index]); }
+	const CHUNK& GetChunk(size_t index) const { return(m_chunks[index]); }
+	// chunk of a scene file instance, -1 when there are no chunks
+	int GetInstanceChunk(uint32_t instance) const;
+	bool IsInstanceResident(uint32_t instance) const;
+
+	// the camera velocity Update() predicts with, in units a second
+	const glm::vec3& GetVelocity() const { return(m_velocity); }
+	CHUNK_STATS GetStats() const;
+	// print the stats for the exit report
+	void Print() const;
+
+private:
+	std::vector<CHUNK> m_chunks;
+	std::vector<int> m_instanceChunks;
+	// bytes of the file of every model and texture, and how many
+	// resident or loading chunks use it
+	std::vector<size_t> m_modelBytes;
+	std::vector<size_t> m_textureBytes;
+	std::vector<int> m_modelUsers;
+	std::vector<int> m_textureUsers;
+	// bytes of the files the resident and loading chunks use
+	size_t m_fileBytes;
+
+	float m_chunkSize;
+	float m_loadRadius;
+	size_t m_budget;
+	ReadyCallback m_ready;
+	void* m_pReadyContext;
+
+	// camera position and time of the last Update(), and the
+	// smoothed velocity between the updates
+	glm::vec3 m_lastPosition;
+	std::chrono::steady_clock::time_point m_lastTime;
+	bool m_bHasLastPosition;
+	glm::vec3 m_velocity;
+
+	unsigned long long m_loads;
+	unsigned long long m_unloads;
+	unsigned long long m_deferred;
+	unsigned long long m_peakResidentBytes;
+
+	// bytes of the files a chunk needs that no resident or loading
+	// chunk uses yet
+	size_t GetAddedBytes(const CHUNK& chunk) const;
+	// count the files of a chunk in or out of m_fileBytes
+	void AddChunkFiles(const CHUNK& chunk);
+	void RemoveChunkFiles(const CHUNK& chunk);
+	// m_fileBytes and the bakes of the resident chunks
+	size_t GetResidentBytes() const;
+	// drop a resident or loading chunk and its bake
+	void UnloadChunk(CHUNK& chunk);
+
+	// not copyable, the bakes are owned
+	WorldChunks(const WorldChunks&);
+	WorldChunks& operator=(const WorldChunks&);
+};
@@ -0,0 +1,1113 @@
+///////////////////////////////////////////////////////////////////////////////
+// assetpack.cpp
+// ============
+// one memory-mapped archive holding the textures, meshes, shaders and
+// scenes of the program
+//
+//  Loading every asset from a loose file costs an open, a stat and a
+//  read of its own, which adds up over the files of a scene and is
+//  slow on a cold disk. A pack holds them all in one file: a header,
+//  the blobs, each starting on a page so it can be used where it lies
+//  in the mapping, and a table of contents sorted by path. The pack is
+//  mapped once, and a lookup is a binary search of the table handing
+//  out a view of the blob without copying it. Shaders, scenes and
+//  meshes may be stored as LZ4 blocks, when that pays, and are
+//  decompressed into the view instead; the images, already
+//  compressed, are stored as they are. Every loader asks the pack
+//  first and reads the loose file when it holds no such asset, so a
+//  pack may hold any subset. A second pack, the warm-start snapshot,
+//  holds what the caches wrote on the first complete load, such as
+//  the program binaries, the static geometry bakes and the texture
+//  cache entries the scene used, stored as they are so a later
+//  launch uploads them straight from its mapping; it is looked up
+//  before the other.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "AssetPack.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+const char* const AssetPack::DEFAULT_PACK_FILE = "../../Utilities/assets.pak";
+AssetPack::PACK_MAPPING AssetPack::s_pack = {};
+AssetPack::PACK_MAPPING AssetPack::s_snapshot = {};
+std::atomic<unsigned long long> AssetPack::s_hits(0);
+std::atomic<unsigned long long> AssetPack::s_misses(0);
+std::atomic<unsigned long long> AssetPack::s_decompressedBytes(0);
+std::atomic<unsigned long long> AssetPack::s_snapshotHits(0);
+std::mutex AssetPack::s_artifactMutex;
+std::set<std::string> AssetPack::s_artifacts;
+std::atomic<bool> AssetPack::s_bSnapshotStale(false);
+
+// the table is read where it lies in the mapping, so its layout is
+// the same for every compiler
+static_assert(sizeof(AssetPack::PACK_HEADER) == 32, "the pack header must be 32 bytes");
+static_assert(sizeof(AssetPack::PACK_ENTRY) == 144, "a pack entry must be 144 bytes");
+
+namespace
+{
+	const char* const TYPE_NAMES[AssetPack::ASSET_TYPE_COUNT] =
+	{
+		"other",
+		"texture",
+		"mesh",
+		"shader",
+		"scene"
+	};
+
+	// the LZ4 block format: a match is at least 4 bytes, and the last
+	// 5 bytes of a block, and the 12 before its last match ends, are
+	// always literals
+	const size_t LZ4_MIN_MATCH = 4;
+	const size_t LZ4_LAST_LITERALS = 5;
+	const size_t LZ4_MATCH_FIND_LIMIT = 12;
+	const size_t LZ4_MAX_OFFSET = 65535;
+	const int LZ4_HASH_BITS = 16;
+
+	const double BYTES_PER_MB = 1024.0 * 1024.0;
+
+	/***********************************************************
+	 *  Read32()
+	 *
+	 *  This function is used for reading 4 bytes at any
+	 *  alignment.
+	 ***********************************************************/
+	uint32_t Read32(const unsigned char* pBytes)
+	{
+		uint32_t value;
+		memcpy(&value, pBytes, sizeof(value));
+		return(value);
+	}
+
+	/***********************************************************
+	 *  WriteLength()
+	 *
+	 *  This function is used for writing the part of a literal
+	 *  or match length past the 15 its token holds, as a run
+	 *  of 255 bytes ended by a smaller one.
+	 ***********************************************************/
+	bool WriteLength(size_t length, unsigned char* pDestination, size_t capacity, size_t& out)
+	{
+		while (length >= 255)
+		{
+			if (out >= capacity)
+			{
+				return(false);
+			}
+			pDestination[out++] = 255;
+			length -= 255;
+		}
+		if (out >= capacity)
+		{
+			return(false);
+		}
+		pDestination[out++] = (unsigned char)length;
+		return(true);
+	}
+
+	/***********************************************************
+	 *  WriteSequence()
+	 *
+	 *  This function is used for writing one LZ4 sequence: the
+	 *  literals and then the match, which the last sequence of
+	 *  a block, given a match length of 0, has none of.
+	 ***********************************************************/
+	bool WriteSequence(const unsigned char* pLiterals, size_t literalLength, size_t offset, size_t matchLength,
+		unsigned char* pDestination, size_t capacity, size_t& out)
+	{
+		if (out >= capacity)
+		{
+			return(false);
+		}
+		size_t matchCode = (matchLength > 0) ? matchLength - LZ4_MIN_MATCH : 0;
+		size_t token = out++;
+		pDestination[token] = (unsigned char)((std::min<size_t>(literalLength, 15) << 4) |
+			std::min<size_t>(matchCode, 15));
+		if ((literalLength >= 15) && (WriteLength(literalLength - 15, pDestination, capacity, out) == false))
+		{
+			return(false);
+		}
+		if (out + literalLength > capacity)
+		{
+			return(false);
+		}
+		memcpy(pDestination + out, pLiterals, literalLength);
+		out += literalLength;
+
+		if (matchLength > 0)
+		{
+			if (out + 2 > capacity)
+			{
+				return(false);
+			}
+			pDestination[out++] = (unsigned char)(offset & 0xff);
+			pDestination[out++] = (unsigned char)(offset >> 8);
+			if ((matchCode >= 15) && (WriteLength(matchCode - 15, pDestination, capacity, out) == false))
+			{
+				return(false);
+			}
+		}
+		return(true);
+	}
+
+	/***********************************************************
+	 *  MapFile()
+	 *
+	 *  This function is used for mapping a whole file read
+	 *  only, returning NULL when it cannot be.
+	 ***********************************************************/
+	const unsigned char* MapFile(const char* filename, size_t& fileSize)
+	{
+		void* pView = NULL;
+		fileSize = 0;
+#ifdef _WIN32
+		HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL,
+			OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS, NULL);
+		if (file != INVALID_HANDLE_VALUE)
+		{
+			LARGE_INTEGER size;
+			if ((GetFileSizeEx(file, &size) != 0) && (size.QuadPart > 0))
+			{
+				fileSize = (size_t)size.QuadPart;
+				// the view keeps the mapping open once both handles are closed
+				HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+				if (NULL != mapping)
+				{
+					pView = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+					CloseHandle(mapping);
+				}
+			}
+			CloseHandle(file);
+		}
+#else
+		int file = open(filename, O_RDONLY);
+		if (file >= 0)
+		{
+			struct stat fileInfo;
+			if ((fstat(file, &fileInfo) == 0) && (fileInfo.st_size > 0))
+			{
+				fileSize = (size_t)fileInfo.st_size;
+				pView = mmap(NULL, fileSize, PROT_READ, MAP_PRIVATE, file, 0);
+				if (pView == MAP_FAILED)
+				{
+					pView = NULL;
+				}
+			}
+			close(file);
+		}
+#endif
+		return((const unsigned char*)pView);
+	}
+
+	/***********************************************************
+	 *  ListFiles()
+	 *
+	 *  This function is used for adding the path below the
+	 *  root of every file in a directory and those under it.
+	 ***********************************************************/
+	void ListFiles(const std::string& rootDirectory, const std::string& relativeDirectory,
+		std::vector<std::string>& files)
+	{
+		std::string directory = relativeDirectory.empty() ? rootDirectory : rootDirectory + "/" + relativeDirectory;
+		std::string prefix = relativeDirectory.empty() ? std::string() : relativeDirectory + "/";
+#ifdef _WIN32
+		WIN32_FIND_DATAA findData;
+		HANDLE find = FindFirstFileA((directory + "/*").c_str(), &findData);
+		if (find == INVALID_HANDLE_VALUE)
+		{
+			return;
+		}
+		do
+		{
+			std::string name = findData.cFileName;
+			if ((name == ".") || (name == ".."))
+			{
+				continue;
+			}
+			if ((findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0)
+			{
+				ListFiles(rootDirectory, prefix + name, files);
+			}
+			else
+			{
+				files.push_back(prefix + name);
+			}
+		} while (FindNextFileA(find, &findData) != 0);
+		FindClose(find);
+#else
+		DIR* pDirectory = opendir(directory.c_str());
+		if (NULL == pDirectory)
+		{
+			return;
+		}
+		struct dirent* pEntry = readdir(pDirectory);
+		while (NULL != pEntry)
+		{
+			std::string name = pEntry->d_name;
+			struct stat fileInfo;
+			if ((name != ".") && (name != "..") && (stat((directory + "/" + name).c_str(), &fileInfo) == 0))
+			{
+				if (S_ISDIR(fileInfo.st_mode))
+				{
+					ListFiles(rootDirectory, prefix + name, files);
+				}
+				else if (S_ISREG(fileInfo.st_mode))
+				{
+					files.push_back(prefix + name);
+				}
+			}
+			pEntry = readdir(pDirectory);
+		}
+		closedir(pDirectory);
+#endif
+	}
+
+	/***********************************************************
+	 *  ReadFile()
+	 *
+	 *  This function is used for reading a whole file.
+	 ***********************************************************/
+	bool ReadFile(const std::string& filename, std::vector<unsigned char>& file)
+	{
+		FILE* pFile = fopen(filename.c_str(), "rb");
+		if (NULL == pFile)
+		{
+			return(false);
+		}
+
+		fseek(pFile, 0, SEEK_END);
+		long size = ftell(pFile);
+		fseek(pFile, 0, SEEK_SET);
+
+		file.resize((size > 0) ? (size_t)size : 0);
+		bool bRead = (size >= 0) && ((size == 0) || (fread(&file[0], 1, file.size(), pFile) == file.size()));
+		fclose(pFile);
+
+		return(bRead);
+	}
+
+	/***********************************************************
+	 *  ReadArtifactBlob()
+	 *
+	 *  This function is used for reading an artifact going
+	 *  into a snapshot: its file, or the copy the snapshot or
+	 *  pack mounted holds when the file is gone, like a texture
+	 *  cache entry trimmed since.
+	 ***********************************************************/
+	bool ReadArtifactBlob(const std::string& path, std::vector<unsigned char>& blob)
+	{
+		if (ReadFile(path, blob) == true)
+		{
+			return(true);
+		}
+		AssetPack::ASSET_VIEW view;
+		if (AssetPack::Find(path.c_str(), view) == false)
+		{
+			return(false);
+		}
+		blob.assign(view.pData, view.pData + view.size);
+		return(true);
+	}
+
+	/***********************************************************
+	 *  PadTo()
+	 *
+	 *  This function is used for writing zeros up to the next
+	 *  multiple of the alignment.
+	 ***********************************************************/
+	bool PadTo(FILE* pFile, uint64_t& offset, uint64_t alignment)
+	{
+		static const unsigned char zeros[AssetPack::PAGE_BYTES] = {};
+		uint64_t padding = (alignment - (offset % alignment)) % alignment;
+		offset += padding;
+		return((padding == 0) || (fwrite(zeros, 1, (size_t)padding, pFile) == (size_t)padding));
+	}
+}
+
+/***********************************************************
+ *  Mount()
+ *
+ *  This method is used for mapping the pack the assets are
+ *  looked up in.
+ ***********************************************************/
+bool AssetPack::Mount(const char* filename)
+{
+	Unmount();
+	if (MapPack(filename, s_pack) == false)
+	{
+		return(false);
+	}
+
+	s_hits = 0;
+	s_misses = 0;
+	s_decompressedBytes = 0;
+	std::cout << "Mounted asset pack " << filename << " of " << s_pack.entryCount << " assets" << std::endl;
+	return(true);
+}
+
+/***********************************************************
+ *  Unmount()
+ *
+ *  This method is used for unmapping the mounted pack.
+ ***********************************************************/
+void AssetPack::Unmount()
+{
+	UnmapPack(s_pack);
+}
+
+/***********************************************************
+ *  MountSnapshot()
+ *
+ *  This method is used for mapping the warm-start snapshot.
+ *  The file of a snapshot cannot be replaced while it is
+ *  mapped, so one written then waits beside it as .new and
+ *  takes its place here.
+ ***********************************************************/
+bool AssetPack::MountSnapshot(const char* filename)
+{
+	UnmountSnapshot();
+
+	std::string pendingFilename = std::string(filename) + ".new";
+	FILE* pPending = fopen(pendingFilename.c_str(), "rb");
+	if (NULL != pPending)
+	{
+		fclose(pPending);
+		remove(filename);
+		if (rename(pendingFilename.c_str(), filename) != 0)
+		{
+			std::cout << "Could not replace warm-start snapshot " << filename << std::endl;
+		}
+	}
+
+	FILE* pFile = fopen(filename, "rb");
+	if (NULL == pFile)
+	{
+		// the first launch writes it
+		s_bSnapshotStale = true;
+		return(false);
+	}
+	fclose(pFile);
+	if (MapPack(filename, s_snapshot) == false)
+	{
+		s_bSnapshotStale = true;
+		return(false);
+	}
+
+	s_snapshotHits = 0;
+	s_bSnapshotStale = false;
+	std::cout << "Mounted warm-start snapshot " << filename << " of " << s_snapshot.entryCount << " artifacts"
+		<< std::endl;
+	return(true);
+}
+
+/***********************************************************
+ *  UnmountSnapshot()
+ *
+ *  This method is used for unmapping the snapshot.
+ ***********************************************************/
+void AssetPack::UnmountSnapshot()
+{
+	UnmapPack(s_snapshot);
+}
+
+/***********************************************************
+ *  MapPack()
+ *
+ *  This method is used for mapping a pack and checking its
+ *  header and every entry of its table, so a lookup needs
+ *  no checks of its own.
+ ***********************************************************/
+bool AssetPack::MapPack(const char* filename, PACK_MAPPING& mapping)
+{
+	size_t fileSize = 0;
+	const unsigned char* pView = MapFile(filename, fileSize);
+	if (NULL == pView)
+	{
+		std::cout << "Could not map asset pack " << filename << std::endl;
+		return(false);
+	}
+
+	PACK_HEADER header = {};
+	bool bValid = (fileSize >= sizeof(PACK_HEADER));
+	if (bValid == true)
+	{
+		memcpy(&header, pView, sizeof(header));
+		bValid = (header.magic == PACK_MAGIC) && (header.version == PACK_VERSION) &&
+			(header.pageBytes == PAGE_BYTES) && (header.fileSize == fileSize) &&
+			(header.tocOffset % sizeof(uint64_t) == 0) && (header.tocOffset <= fileSize) &&
+			(header.entryCount <= (fileSize - header.tocOffset) / sizeof(PACK_ENTRY));
+	}
+
+	const PACK_ENTRY* pEntries = bValid ? (const PACK_ENTRY*)(pView + header.tocOffset) : NULL;
+	for (uint32_t i = 0; (bValid == true) && (i < header.entryCount); i++)
+	{
+		const PACK_ENTRY& entry = pEntries[i];
+		bValid = (memchr(entry.path, '\0', sizeof(entry.path)) != NULL) &&
+			(entry.offset % PAGE_BYTES == 0) && (entry.offset <= header.tocOffset) &&
+			(entry.storedSize <= header.tocOffset - entry.offset) &&
+			(entry.compression < COMPRESSION_COUNT) && (entry.type < ASSET_TYPE_COUNT) &&
+			((entry.compression != COMPRESSION_NONE) || (entry.storedSize == entry.size)) &&
+			((i == 0) || (strcmp(pEntries[i - 1].path, entry.path) < 0));
+	}
+
+	if (bValid == false)
+	{
+		std::cout << "Asset pack " << filename << " is damaged or of another version" << std::endl;
+#ifdef _WIN32
+		UnmapViewOfFile(pView);
+#else
+		munmap((void*)pView, fileSize);
+#endif
+		return(false);
+	}
+
+	mapping.pView = pView;
+	mapping.size = fileSize;
+	mapping.pEntries = pEntries;
+	mapping.entryCount = header.entryCount;
+	return(true);
+}
+
+/***********************************************************
+ *  UnmapPack()
+ *
+ *  This method is used for unmapping a pack.
+ ***********************************************************/
+void AssetPack::UnmapPack(PACK_MAPPING& mapping)
+{
+	if (NULL != mapping.pView)
+	{
+#ifdef _WIN32
+		UnmapViewOfFile(mapping.pView);
+#else
+		munmap((void*)mapping.pView, mapping.size);
+#endif
+	}
+	mapping.pView = NULL;
+	mapping.size = 0;
+	mapping.pEntries = NULL;
+	mapping.entryCount = 0;
+}
+
+/***********************************************************
+ *  FindEntry()
+ *
+ *  This method is used for the binary search of the sorted
+ *  table of a pack for a key.
+ ***********************************************************/
+const AssetPack::PACK_ENTRY* AssetPack::FindEntry(const PACK_MAPPING& mapping, const std::string& key)
+{
+	if (NULL == mapping.pView)
+	{
+		return(NULL);
+	}
+	const PACK_ENTRY* pEnd = mapping.pEntries + mapping.entryCount;
+	const PACK_ENTRY* pEntry = std::lower_bound(mapping.pEntries, pEnd, key,
+		[](const PACK_ENTRY& entry, const std::string& path) { return(strcmp(entry.path, path.c_str()) < 0); });
+	if ((pEntry == pEnd) || (key != pEntry->path))
+	{
+		return(NULL);
+	}
+	return(pEntry);
+}
+
+/***********************************************************
+ *  Find()
+ *
+ *  This method is used for handing out the asset of a path,
+ *  from the snapshot when it has one, else from the pack.
+ *  A blob stored as it is is viewed where it lies, and an
+ *  LZ4 blob is decompressed into the buffer of the view.
+ ***********************************************************/
+bool AssetPack::Find(const char* path, ASSET_VIEW& view)
+{
+	view.pData = NULL;
+	view.size = 0;
+	view.buffer.clear();
+	if ((NULL == s_pack.pView) && (NULL == s_snapshot.pView))
+	{
+		return(false);
+	}
+
+	std::string key = MakeKey(path);
+	const PACK_MAPPING* pMapping = &s_snapshot;
+	const PACK_ENTRY* pEntry = FindEntry(s_snapshot, key);
+	if (NULL == pEntry)
+	{
+		pMapping = &s_pack;
+		pEntry = FindEntry(s_pack, key);
+	}
+	if (NULL == pEntry)
+	{
+		s_misses++;
+		return(false);
+	}
+
+	const unsigned char* pBlob = pMapping->pView + pEntry->offset;
+	if (pEntry->compression == COMPRESSION_LZ4)
+	{
+		view.buffer.resize((size_t)pEntry->size);
+		if ((pEntry->size > 0) &&
+			(DecompressLZ4(pBlob, (size_t)pEntry->storedSize, &view.buffer[0], view.buffer.size()) == false))
+		{
+			std::cout << "Asset " << pEntry->path << " of the pack is damaged" << std::endl;
+			view.buffer.clear();
+			s_misses++;
+			return(false);
+		}
+		view.pData = view.buffer.empty() ? NULL : &view.buffer[0];
+		s_decompressedBytes += pEntry->size;
+	}
+	else
+	{
+		view.pData = pBlob;
+	}
+	view.size = (size_t)pEntry->size;
+	s_hits++;
+	if (pMapping == &s_snapshot)
+	{
+		s_snapshotHits++;
+	}
+	return(true);
+}
+
+/***********************************************************
+ *  FindText()
+ *
+ *  This method is used for copying the asset of a path into
+ *  a string, which the shader and scene parsers take.
+ ***********************************************************/
+bool AssetPack::FindText(const char* path, std::string& text)
+{
+	ASSET_VIEW view;
+	if (Find(path, view) == false)
+	{
+		return(false);
+	}
+	text.assign((const char*)view.pData, view.size);
+	return(true);
+}
+
+/***********************************************************
+ *  Contains()
+ *
+ *  This method is used for asking whether the pack holds
+ *  the asset of a path, as the loaders choosing between
+ *  files do before loading one.
+ ***********************************************************/
+bool AssetPack::Contains(const char* path)
+{
+	std::string key = MakeKey(path);
+	return((NULL != FindEntry(s_snapshot, key)) || (NULL != FindEntry(s_pack, key)));
+}
+
+/***********************************************************
+ *  Build()
+ *
+ *  This method is used for writing a pack of every asset
+ *  under the root directory.
+ ***********************************************************/
+bool AssetPack::Build(const char* packFilename, const char* rootDirectory)
+{
+	std::vector<std::string> files;
+	ListFiles(rootDirectory, std::string(), files);
+
+	std::vector<std::string> keys;
+	std::vector<std::string> sources;
+	for (size_t i = 0; i < files.size(); i++)
+	{
+		// the sources and earlier packs under the root are left out
+		if (GetType(files[i]) == ASSET_OTHER)
+		{
+			continue;
+		}
+		keys.push_back(files[i]);
+		sources.push_back(std::string(rootDirectory) + "/" + files[i]);
+	}
+	return(WritePack(packFilename, "asset pack", keys, sources, ReadFile, true));
+}
+
+/***********************************************************
+ *  ReadArtifact()
+ *
+ *  This method is used for reading a file a cache wrote,
+ *  which the cache checks for itself: from the snapshot,
+ *  where it is viewed in the mapping, or read whole from
+ *  the file into the buffer of the view.
+ ***********************************************************/
+bool AssetPack::ReadArtifact(const char* path, ASSET_VIEW& view)
+{
+	if (Find(path, view) == true)
+	{
+		return(true);
+	}
+	if (ReadFile(path, view.buffer) == false)
+	{
+		return(false);
+	}
+	view.pData = view.buffer.empty() ? NULL : &view.buffer[0];
+	view.size = view.buffer.size();
+	return(true);
+}
+
+/***********************************************************
+ *  ReadView()
+ *
+ *  This method is used for reading the parts of a view in
+ *  order, the way a file is read.
+ ***********************************************************/
+bool AssetPack::ReadView(const ASSET_VIEW& view, size_t& offset, void* pDestination, size_t bytes)
+{
+	if ((offset > view.size) || (bytes > view.size - offset))
+	{
+		return(false);
+	}
+	if (bytes > 0)
+	{
+		memcpy(pDestination, view.pData + offset, bytes);
+	}
+	offset += bytes;
+	return(true);
+}
+
+/***********************************************************
+ *  NoteArtifact()
+ *
+ *  This method is used for recording an artifact for the
+ *  next snapshot. One the snapshot does not hold, or that a
+ *  cache wrote because the copy there no longer matched
+ *  what it caches, means the snapshot should be made again.
+ ***********************************************************/
+void AssetPack::NoteArtifact(const char* path, bool bWritten)
+{
+	std::lock_guard<std::mutex> lock(s_artifactMutex);
+	s_artifacts.insert(path);
+	if ((bWritten == true) || (NULL == FindEntry(s_snapshot, MakeKey(path))))
+	{
+		s_bSnapshotStale = true;
+	}
+}
+
+/***********************************************************
+ *  WriteSnapshot()
+ *
+ *  This method is used for writing every artifact noted
+ *  since the launch into a snapshot. The artifacts are
+ *  stored as they are, for the loaders to use them in the
+ *  mapping with no copy.
+ ***********************************************************/
+bool AssetPack::WriteSnapshot(const char* filename)
+{
+	std::vector<std::string> keys;
+	std::vector<std::string> sources;
+	{
+		std::lock_guard<std::mutex> lock(s_artifactMutex);
+		for (std::set<std::string>::const_iterator it = s_artifacts.begin(); it != s_artifacts.end(); ++it)
+		{
+			keys.push_back(MakeKey(it->c_str()));
+			sources.push_back(*it);
+		}
+	}
+	if (keys.empty() == true)
+	{
+		return(false);
+	}
+
+	std::string snapshotFilename = (IsSnapshotMounted() == true) ? std::string(filename) + ".new" : filename;
+	if (WritePack(snapshotFilename.c_str(), "warm-start snapshot", keys, sources, ReadArtifactBlob, false) == false)
+	{
+		return(false);
+	}
+	s_bSnapshotStale = false;
+	return(true);
+}
+
+/***********************************************************
+ *  WritePack()
+ *
+ *  This method is used for writing a pack of the blobs read
+ *  from their sources. The blobs are written first, each on
+ *  a page of its own, then the table sorted by key, and the
+ *  header last once the table's offset is known.
+ ***********************************************************/
+bool AssetPack::WritePack(
+	const char* packFilename,
+	const char* description,
+	const std::vector<std::string>& keys,
+	const std::vector<std::string>& sources,
+	BlobReader reader,
+	bool bCompress)
+{
+	// the table is sorted by key, and two paths of one key, like
+	// ./a and a, are written once
+	std::vector<size_t> order(keys.size());
+	for (size_t i = 0; i < order.size(); i++)
+	{
+		order[i] = i;
+	}
+	std::sort(order.begin(), order.end(), [&keys](size_t a, size_t b) { return(keys[a] < keys[b]); });
+	order.erase(std::unique(order.begin(), order.end(),
+		[&keys](size_t a, size_t b) { return(keys[a] == keys[b]); }), order.end());
+
+	FILE* pFile = fopen(packFilename, "wb");
+	if (NULL == pFile)
+	{
+		std::cout << "Could not create " << description << " " << packFilename << std::endl;
+		return(false);
+	}
+
+	PACK_HEADER header = {};
+	bool bWritten = (fwrite(&header, sizeof(header), 1, pFile) == 1);
+	uint64_t offset = sizeof(header);
+
+	std::vector<PACK_ENTRY> entries;
+	std::vector<unsigned char> file;
+	std::vector<unsigned char> compressed;
+	unsigned long long sourceBytes = 0;
+	for (size_t i = 0; (i < order.size()) && (bWritten == true); i++)
+	{
+		const std::string& key = keys[order[i]];
+		if (key.size() >= (size_t)MAX_PATH_LENGTH)
+		{
+			std::cout << "Path " << key << " is too long for the " << description << ", skipped" << std::endl;
+			continue;
+		}
+		if (reader(sources[order[i]], file) == false)
+		{
+			std::cout << "Could not read " << key << ", skipped" << std::endl;
+			continue;
+		}
+
+		PACK_ENTRY entry = {};
+		memcpy(entry.path, key.c_str(), key.size() + 1);
+		entry.size = file.size();
+		entry.type = GetType(key);
+		entry.compression = COMPRESSION_NONE;
+		const unsigned char* pBlob = file.empty() ? NULL : &file[0];
+		entry.storedSize = file.size();
+
+		// the images are compressed already and gain nothing
+		if ((bCompress == true) && (entry.type != ASSET_TEXTURE) && (file.size() > LZ4_MATCH_FIND_LIMIT))
+		{
+			compressed.resize(file.size() - file.size() / 10);
+			size_t compressedSize = CompressLZ4(&file[0], file.size(), &compressed[0], compressed.size());
+			if (compressedSize > 0)
+			{
+				entry.compression = COMPRESSION_LZ4;
+				entry.storedSize = compressedSize;
+				pBlob = &compressed[0];
+			}
+		}
+
+		bWritten = PadTo(pFile, offset, PAGE_BYTES);
+		entry.offset = offset;
+		if ((bWritten == true) && (entry.storedSize > 0))
+		{
+			bWritten = (fwrite(pBlob, 1, (size_t)entry.storedSize, pFile) == (size_t)entry.storedSize);
+		}
+		offset += entry.storedSize;
+		sourceBytes += entry.size;
+		entries.push_back(entry);
+	}
+
+	if (bWritten == true)
+	{
+		bWritten = PadTo(pFile, offset, sizeof(uint64_t));
+	}
+	header.magic = PACK_MAGIC;
+	header.version = PACK_VERSION;
+	header.entryCount = (uint32_t)entries.size();
+	header.pageBytes = PAGE_BYTES;
+	header.tocOffset = offset;
+	header.fileSize = offset + entries.size() * sizeof(PACK_ENTRY);
+	if ((bWritten == true) && (entries.empty() == false))
+	{
+		bWritten = (fwrite(&entries[0], sizeof(PACK_ENTRY), entries.size(), pFile) == entries.size());
+	}
+	if (bWritten == true)
+	{
+		bWritten = (fseek(pFile, 0, SEEK_SET) == 0) && (fwrite(&header, sizeof(header), 1, pFile) == 1);
+	}
+	bWritten = (fclose(pFile) == 0) && bWritten;
+
+	if (bWritten == false)
+	{
+		std::cout << "Could not write " << description << " " << packFilename << std::endl;
+		remove(packFilename);
+		return(false);
+	}
+
+	char line[192];
+	snprintf(line, sizeof(line), "Wrote %s %s: %d files, %.2f MB of files in %.2f MB",
+		description, packFilename, (int)entries.size(), sourceBytes / BYTES_PER_MB, header.fileSize / BYTES_PER_MB);
+	std::cout << line << std::endl;
+	return(true);
+}
+
+/***********************************************************
+ *  MakeKey()
+ *
+ *  This method is used for turning the path a loader was
+ *  given into the key the pack holds it by, the same for
+ *  the paths relative to any project directory.
+ ***********************************************************/
+std::string AssetPack::MakeKey(const char* path)
+{
+	std::string key = path;
+	std::replace(key.begin(), key.end(), '\\', '/');
+
+	size_t root = key.rfind("Utilities/");
+	if (root != std::string::npos)
+	{
+		return(key.substr(root + strlen("Utilities/")));
+	}
+	while ((key.compare(0, 2, "./") == 0) || (key.compare(0, 3, "../") == 0))
+	{
+		key.erase(0, (key[1] == '/') ? 2 : 3);
+	}
+	return(key);
+}
+
+/***********************************************************
+ *  GetType()
+ *
+ *  This method is used for finding what an asset is from
+ *  the extension of its path.
+ ***********************************************************/
+AssetPack::ASSET_TYPE AssetPack::GetType(const std::string& path)
+{
+	size_t dot = path.find_last_of('.');
+	if (dot == std::string::npos)
+	{
+		return(ASSET_OTHER);
+	}
+	std::string extension = path.substr(dot + 1);
+	std::transform(extension.begin(), extension.end(), extension.begin(),
+		[](char c) { return((char)tolower((unsigned char)c)); });
+
+	if ((extension == "jpg") || (extension == "jpeg") || (extension == "png") || (extension == "ktx2") ||
+		(extension == "dds"))
+	{
+		return(ASSET_TEXTURE);
+	}
+	if ((extension == "glb") || (extension == "meshes"))
+	{
+		return(ASSET_MESH);
+	}
+	if ((extension == "glsl") || (extension == "spv"))
+	{
+		return(ASSET_SHADER);
+	}
+	if (extension == "scene")
+	{
+		return(ASSET_SCENE);
+	}
+	return(ASSET_OTHER);
+}
+
+const char* AssetPack::GetTypeName(int type)
+{
+	return(((type >= 0) && (type < ASSET_TYPE_COUNT)) ? TYPE_NAMES[type] : "unknown");
+}
+
+/***********************************************************
+ *  GetStats()
+ *
+ *  This method is used for getting the size of the mounted
+ *  pack and the lookups since it was mounted.
+ ***********************************************************/
+AssetPack::PACK_STATS AssetPack::GetStats()
+{
+	PACK_STATS stats = {};
+	stats.entries = (int)s_pack.entryCount;
+	stats.packBytes = s_pack.size;
+	stats.hits = s_hits;
+	stats.misses = s_misses;
+	stats.decompressedBytes = s_decompressedBytes;
+	stats.snapshotEntries = (int)s_snapshot.entryCount;
+	stats.snapshotBytes = s_snapshot.size;
+	stats.snapshotHits = s_snapshotHits;
+	return(stats);
+}
+
+/***********************************************************
+ *  PrintStats()
+ *
+ *  This method is used for printing the lookups of the
+ *  mounted pack and snapshot, and nothing when neither is
+ *  mounted.
+ ***********************************************************/
+void AssetPack::PrintStats()
+{
+	if ((NULL == s_pack.pView) && (NULL == s_snapshot.pView))
+	{
+		return;
+	}
+	PACK_STATS stats = GetStats();
+	std::cout << "\n*** ASSET PACK: ***\n";
+	std::cout << "assets " << stats.entries
+		<< "\t" << (double)stats.packBytes / BYTES_PER_MB << " MB\n";
+	if (NULL != s_snapshot.pView)
+	{
+		std::cout << "snapshot artifacts " << stats.snapshotEntries
+			<< "\t" << (double)stats.snapshotBytes / BYTES_PER_MB << " MB"
+			<< "\tfound " << stats.snapshotHits << "\n";
+	}
+	std::cout << "found " << stats.hits
+		<< "\tloose files " << stats.misses
+		<< "\tdecompressed " << (double)stats.decompressedBytes / BYTES_PER_MB << " MB\n";
+}
+
+/***********************************************************
+ *  CompressLZ4()
+ *
+ *  This method is used for encoding one LZ4 block. The
+ *  search is greedy: the 4 bytes at each position are
+ *  hashed to the last position they were seen at, and a
+ *  match found there is taken and extended as far as it
+ *  goes.
+ ***********************************************************/
+size_t AssetPack::CompressLZ4(const unsigned char* pSource, size_t sourceSize,
+	unsigned char* pDestination, size_t destinationCapacity)
+{
+	size_t out = 0;
+	size_t anchor = 0;
+	if (sourceSize > LZ4_MATCH_FIND_LIMIT)
+	{
+		// last position seen of each hash, plus one so 0 is none
+		std::vector<uint32_t> table((size_t)1 << LZ4_HASH_BITS, 0);
+		size_t matchLimit = sourceSize - LZ4_LAST_LITERALS;
+		size_t findLimit = sourceSize - LZ4_MATCH_FIND_LIMIT;
+		size_t position = 0;
+		while (position < findLimit)
+		{
+			uint32_t sequence = Read32(pSource + position);
+			uint32_t hash = (sequence * 2654435761u) >> (32 - LZ4_HASH_BITS);
+			size_t candidate = table[hash];
+			table[hash] = (uint32_t)(position + 1);
+			if ((candidate == 0) || (position - (candidate - 1) > LZ4_MAX_OFFSET) ||
+				(Read32(pSource + candidate - 1) != sequence))
+			{
+				position++;
+				continue;
+			}
+
+			size_t match = candidate - 1;
+			size_t matchLength = LZ4_MIN_MATCH;
+			while ((position + matchLength < matchLimit) && (pSource[match + matchLength] == pSource[position + matchLength]))
+			{
+				matchLength++;
+			}
+			if (WriteSequence(pSource + anchor, position - anchor, position - match, matchLength,
+				pDestination, destinationCapacity, out) == false)
+			{
+				return(0);
+			}
+			position += matchLength;
+			anchor = position;
+		}
+	}
+
+	if (WriteSequence(pSource + anchor, sourceSize - anchor, 0, 0, pDestination, destinationCapacity, out) == false)
+	{
+		return(0);
+	}
+	return(out);
+}
+
+/***********************************************************
+ *  DecompressLZ4()
+ *
+ *  This method is used for decoding one LZ4 block, checking
+ *  every length and offset against both buffers, since the
+ *  blob comes from a file.
+ ***********************************************************/
+bool AssetPack::DecompressLZ4(const unsigned char* pSource, size_t sourceSize,
+	unsigned char* pDestination, size_t destinationSize)
+{
+	size_t in = 0;
+	size_t out = 0;
+	while (in < sourceSize)
+	{
+		unsigned char token = pSource[in++];
+		size_t literalLength = token >> 4;
+		if (literalLength == 15)
+		{
+			unsigned char extra = 255;
+			while (extra == 255)
+			{
+				if (in >= sourceSize)
+				{
+					return(false);
+				}
+				extra = pSource[in++];
+				literalLength += extra;
+			}
+		}
+		if ((literalLength > sourceSize - in) || (literalLength > destinationSize - out))
+		{
+			return(false);
+		}
+		memcpy(pDestination + out, pSource + in, literalLength);
+		in += literalLength;
+		out += literalLength;
+
+		// the last sequence ends with its literals
+		if (in == sourceSize)
+		{
+			break;
+		}
+
+		if (in + 2 > sourceSize)
+		{
+			return(false);
+		}
+		size_t offset = (size_t)pSource[in] | ((size_t)pSource[in + 1] << 8);
+		in += 2;
+		size_t matchLength = (token & 15);
+		if (matchLength == 15)
+		{
+			unsigned char extra = 255;
+			while (extra == 255)
+			{
+				if (in >= sourceSize)
+				{
+					return(false);
+				}
+				extra = pSource[in++];
+				matchLength += extra;
+			}
+		}
+		matchLength += LZ4_MIN_MATCH;
+		if ((offset == 0) || (offset > out) || (matchLength > destinationSize - out))
+		{
+			return(false);
+		}
+		// byte by byte, since a match may overlap the bytes it makes
+		const unsigned char* pMatch = pDestination + out - offset;
+		for (size_t i = 0; i < matchLength; i++)
+		{
+			pDestination[out + i] = pMatch[i];
+		}
+		out += matchLength;
+	}
+	return(out == destinationSize);
+}
@@ -0,0 +1,217 @@
+///////////////////////////////////////////////////////////////////////////////
+// assetpack.h
+// ============
+// one memory-mapped archive holding the textures, meshes, shaders and
+// scenes of the program
+//
+//  Loading every asset from a loose file costs an open, a stat and a
+//  read of its own, which adds up over the files of a scene and is
+//  slow on a cold disk. A pack holds them all in one file: a header,
+//  the blobs, each starting on a page so it can be used where it lies
+//  in the mapping, and a table of contents sorted by path. The pack is
+//  mapped once, and a lookup is a binary search of the table handing
+//  out a view of the blob without copying it. Shaders, scenes and
+//  meshes may be stored as LZ4 blocks, when that pays, and are
+//  decompressed into the view instead; the images, already
+//  compressed, are stored as they are. Every loader asks the pack
+//  first and reads the loose file when it holds no such asset, so a
+//  pack may hold any subset. A second pack, the warm-start snapshot,
+//  holds what the caches wrote on the first complete load, such as
+//  the program binaries, the static geometry bakes and the texture
+//  cache entries the scene used, stored as they are so a later
+//  launch uploads them straight from its mapping; it is looked up
+//  before the other.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+/***********************************************************
+ *  AssetPack
+ *
+ *  This class contains the mapping of the mounted pack and
+ *  its table of contents. It is used through static methods,
+ *  like GPUMemory, since the loaders asking it are spread
+ *  over many modules and run on the worker threads as well.
+ ***********************************************************/
+class AssetPack
+{
+public:
+	// how a blob is stored
+	enum COMPRESSION
+	{
+		COMPRESSION_NONE = 0,
+		COMPRESSION_LZ4,		// one LZ4 block of the whole asset
+		COMPRESSION_COUNT
+	};
+
+	// what an asset is, from the extension of its path
+	enum ASSET_TYPE
+	{
+		ASSET_OTHER = 0,
+		ASSET_TEXTURE,			// .jpg, .png and .ktx2 images
+		ASSET_MESH,				// .glb models and baked .meshes files
+		ASSET_SHADER,			// .glsl sources and .spv modules
+		ASSET_SCENE,			// .scene descriptions
+		ASSET_TYPE_COUNT
+	};
+
+	static const uint32_t PACK_MAGIC = 0x4b504141;	// "AAPK"
+	static const uint32_t PACK_VERSION = 1;
+	// alignment of every blob in the file, so a view of one never
+	// shares a page with another
+	static const uint32_t PAGE_BYTES = 4096;
+	// longest path of an asset in the pack, with its terminator
+	static const int MAX_PATH_LENGTH = 112;
+
+	// first bytes of the pack
+	struct PACK_HEADER
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint32_t entryCount;
+		uint32_t pageBytes;
+		uint64_t tocOffset;		// where the entries start
+		uint64_t fileSize;		// so a truncated pack is found
+	};
+
+	// one asset of the table of contents, sorted by path
+	struct PACK_ENTRY
+	{
+		char path[MAX_PATH_LENGTH];	// key of the asset, see MakeKey()
+		uint64_t offset;			// of the blob from the start of the pack
+		uint64_t storedSize;		// bytes of the blob
+		uint64_t size;				// bytes of the asset once decompressed
+		uint32_t compression;
+		uint32_t type;
+	};
+
+	// the bytes of one asset, valid while the pack is mounted; they
+	// point into the mapping when the blob is stored as it is, and
+	// into the buffer when it was decompressed
+	struct ASSET_VIEW
+	{
+		const unsigned char* pData;
+		size_t size;
+		std::vector<unsigned char> buffer;
+	};
+
+	// lookups since the pack was mounted
+	struct PACK_STATS
+	{
+		int entries;
+		unsigned long long packBytes;
+		unsigned long long hits;				// assets found in the pack
+		unsigned long long misses;				// read from loose files
+		unsigned long long decompressedBytes;	// of the LZ4 blobs found
+		int snapshotEntries;
+		unsigned long long snapshotBytes;
+		unsigned long long snapshotHits;		// assets found in the snapshot
+	};
+
+	// pack mounted when no other is named, built from the files under
+	// the Utilities directory
+	static const char* const DEFAULT_PACK_FILE;
+
+	// map a pack and check its table, replacing the one mounted; false
+	// leaves no pack mounted. Only called while no loader runs, since
+	// the views of the last pack are gone with it
+	static bool Mount(const char* filename);
+	static void Unmount();
+	static bool IsMounted() { return(NULL != s_pack.pView); }
+
+	// map the warm-start snapshot beside the pack, first putting in
+	// place one written while the last was mapped; false leaves none
+	static bool MountSnapshot(const char* filename);
+	static void UnmountSnapshot();
+	static bool IsSnapshotMounted() { return(NULL != s_snapshot.pView); }
+
+	// the asset of a path, from the snapshot or the pack; false when
+	// neither holds it, and the caller reads the loose file then
+	static bool Find(const char* path, ASSET_VIEW& view);
+	// the asset of a path copied into a string, for the text loaders
+	static bool FindText(const char* path, std::string& text);
+	// true when the pack holds the asset of a path, without counting
+	// a lookup
+	static bool Contains(const char* path);
+
+	// write every texture, mesh, shader and scene under the root
+	// directory into a pack, keyed by its path below the root; all but the images are compressed when
+	// that saves a tenth of their size
+	static bool Build(const char* packFilename, const char* rootDirectory);
+
+	// a file a cache wrote, an artifact, read whole from the snapshot
+	// or else from the file itself; false when neither has it
+	static bool ReadArtifact(const char* path, ASSET_VIEW& view);
+	// copy the next bytes of a view, false once they run past its end
+	static bool ReadView(const ASSET_VIEW& view, size_t& offset, void* pDestination, size_t bytes);
+	// note an artifact a cache accepted or wrote, to go into the next
+	// snapshot; one the snapshot lacked, or that was written since
+	// the snapshot was made, makes the snapshot stale
+	static void NoteArtifact(const char* path, bool bWritten);
+	static bool IsSnapshotStale() { return(s_bSnapshotStale); }
+	// write the artifacts noted since the launch into a snapshot, as
+	// filename.new while another is mapped
+	static bool WriteSnapshot(const char* filename);
+
+	// key of the asset a path names: the part after the last
+	// "Utilities/" of it, with the separators made forward slashes,
+	// or the whole path without leading "./" and "../" otherwise
+	static std::string MakeKey(const char* path);
+	static ASSET_TYPE GetType(const std::string& path);
+	static const char* GetTypeName(int type);
+
+	static PACK_STATS GetStats();
+	static void PrintStats();
+
+	// the LZ4 block format, used for the compressed blobs; Compress()
+	// returns 0 when the output would not fit and Decompress() false
+	// for a block that does not decode to exactly the bytes given
+	static size_t CompressLZ4(const unsigned char* pSource, size_t sourceSize,
+		unsigned char* pDestination, size_t destinationCapacity);
+	static bool DecompressLZ4(const unsigned char* pSource, size_t sourceSize,
+		unsigned char* pDestination, size_t destinationSize);
+
+private:
+	// the mapping of a whole pack and its table, the view NULL when
+	// none is mounted
+	struct PACK_MAPPING
+	{
+		const unsigned char* pView;
+		size_t size;
+		const PACK_ENTRY* pEntries;
+		uint32_t entryCount;
+	};
+
+	// reads the bytes of one blob of a pack being written
+	typedef bool (*BlobReader)(const std::string& source, std::vector<unsigned char>& blob);
+
+	static PACK_MAPPING s_pack;
+	static PACK_MAPPING s_snapshot;
+	static std::atomic<unsigned long long> s_hits;
+	static std::atomic<unsigned long long> s_misses;
+	static std::atomic<unsigned long long> s_decompressedBytes;
+	static std::atomic<unsigned long long> s_snapshotHits;
+	// the artifacts noted since the launch, and whether the snapshot
+	// mounted misses any of them
+	static std::mutex s_artifactMutex;
+	static std::set<std::string> s_artifacts;
+	static std::atomic<bool> s_bSnapshotStale;
+
+	// map a pack and check its header and table
+	static bool MapPack(const char* filename, PACK_MAPPING& mapping);
+	static void UnmapPack(PACK_MAPPING& mapping);
+	// entry of a key in the sorted table of a pack, NULL for none
+	static const PACK_ENTRY* FindEntry(const PACK_MAPPING& mapping, const std::string& key);
+	// write the blobs read from the sources under their keys, sorted
+	// by key, LZ4 compressing all but the images when asked to
+	static bool WritePack(const char* packFilename, const char* description, const std::vector<std::string>& keys,
+		const std::vector<std::string>& sources, BlobReader reader, bool bCompress);
+};
@@ -0,0 +1,562 @@
+///////////////////////////////////////////////////////////////////////////////
+// bufferallocator.cpp
+// ============
+// aligned ranges handed out of a few large buffer pages
+//
+//  The pages are written and copied through the copy targets, which no
+//  VAO or draw reads, so the bindings of the frame are left alone.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "BufferAllocator.h"
+#include "GLDebug.h"
+
+#include <algorithm>
+#include <iostream>
+
+namespace
+{
+	// the offset rounded up to a multiple of the alignment
+	GLintptr AlignUp(GLintptr offset, GLsizeiptr alignment)
+	{
+		return((offset + alignment - 1) / alignment * alignment);
+	}
+}
+
+/***********************************************************
+ *  BufferAllocator()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+BufferAllocator::BufferAllocator()
+{
+	m_pageSize = DEFAULT_PAGE_SIZE;
+	m_category = GPUMemory::CATEGORY_MESH;
+	m_owner = "buffer pages";
+	m_quietFrames = 0;
+	m_bSettled = true;
+	m_movedAllocations = 0;
+	m_movedBytes = 0;
+	m_releasedPages = 0;
+}
+
+/***********************************************************
+ *  ~BufferAllocator()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+BufferAllocator::~BufferAllocator()
+{
+	Destroy();
+}
+
+/***********************************************************
+ *  Create()
+ *
+ *  This method is used for setting the size, category and
+ *  owner of the pages created from then on.
+ ***********************************************************/
+void BufferAllocator::Create(GLsizeiptr pageSize, GPUMemory::CATEGORY category, const char* owner)
+{
+	m_pageSize = DEFAULT_PAGE_SIZE;
+	if (pageSize > 0)
+	{
+		m_pageSize = pageSize;
+	}
+	m_category = category;
+	m_owner = (NULL != owner) ? owner : "buffer pages";
+}
+
+/***********************************************************
+ *  Destroy()
+ *
+ *  This method is used for deleting every page, which drops
+ *  the allocations still in them.
+ ***********************************************************/
+void BufferAllocator::Destroy()
+{
+	for (size_t i = 0; i < m_pages.size(); i++)
+	{
+		if (0 != m_pages[i].buffer)
+		{
+			GPUMemory::DeleteBuffers(1, &m_pages[i].buffer);
+		}
+	}
+	m_pages.clear();
+	m_allocations.clear();
+	m_freeHandles.clear();
+	m_blocksBySize.clear();
+	m_quietFrames = 0;
+	m_bSettled = true;
+}
+
+/***********************************************************
+ *  CreatePage()
+ *
+ *  This method is used for creating a page, in the slot of
+ *  a released one when there is one, and making all of it
+ *  one free block. The storage is immutable where
+ *  ARB_buffer_storage is there, and writable for the data
+ *  of the allocations.
+ ***********************************************************/
+int BufferAllocator::CreatePage(GLsizeiptr size)
+{
+	int page = -1;
+	for (size_t i = 0; (i < m_pages.size()) && (page < 0); i++)
+	{
+		if (0 == m_pages[i].buffer)
+		{
+			page = (int)i;
+		}
+	}
+	if (page < 0)
+	{
+		page = (int)m_pages.size();
+		m_pages.push_back(PAGE());
+	}
+
+	PAGE& newPage = m_pages[page];
+	newPage.buffer = 0;
+	newPage.size = size;
+	newPage.allocations = 0;
+	newPage.freeBlocks.clear();
+
+	glGenBuffers(1, &newPage.buffer);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, newPage.buffer);
+	if (GLEW_ARB_buffer_storage == GL_TRUE)
+	{
+		glBufferStorage(GL_COPY_WRITE_BUFFER, size, NULL, GL_DYNAMIC_STORAGE_BIT);
+	}
+	else
+	{
+		glBufferData(GL_COPY_WRITE_BUFFER, size, NULL, GL_STATIC_DRAW);
+	}
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	GPUMemory::TrackBuffer(newPage.buffer, (long long)size, m_category, m_owner.c_str());
+	GLDebug::Label(GL_BUFFER, newPage.buffer, m_owner.c_str());
+
+	InsertFreeBlock(page, 0, size);
+	return(page);
+}
+
+/***********************************************************
+ *  InsertFreeBlock()
+ *
+ *  This method is used for adding a free block to its page
+ *  and the size index, after merging it with the free
+ *  blocks right before and after it, so no two free blocks
+ *  of a page ever touch.
+ ***********************************************************/
+void BufferAllocator::InsertFreeBlock(int page, GLintptr offset, GLsizeiptr size)
+{
+	std::map<GLintptr, GLsizeiptr>& blocks = m_pages[page].freeBlocks;
+
+	std::map<GLintptr, GLsizeiptr>::iterator next = blocks.lower_bound(offset);
+	if ((next != blocks.end()) && (offset + size == next->first))
+	{
+		size += next->second;
+		RemoveFreeBlock(page, next->first);
+	}
+	std::map<GLintptr, GLsizeiptr>::iterator after = blocks.lower_bound(offset);
+	if (after != blocks.begin())
+	{
+		std::map<GLintptr, GLsizeiptr>::iterator previous = after;
+		--previous;
+		if (previous->first + previous->second == offset)
+		{
+			offset = previous->first;
+			size += previous->second;
+			RemoveFreeBlock(page, offset);
+		}
+	}
+
+	blocks[offset] = size;
+	m_blocksBySize.insert(std::make_pair(size, BLOCK_KEY(page, offset)));
+}
+
+/***********************************************************
+ *  RemoveFreeBlock()
+ *
+ *  This method is used for taking a free block out of its
+ *  page and the size index.
+ ***********************************************************/
+void BufferAllocator::RemoveFreeBlock(int page, GLintptr offset)
+{
+	std::map<GLintptr, GLsizeiptr>& blocks = m_pages[page].freeBlocks;
+	std::map<GLintptr, GLsizeiptr>::iterator block = blocks.find(offset);
+	if (block == blocks.end())
+	{
+		return;
+	}
+
+	typedef std::multimap<GLsizeiptr, BLOCK_KEY>::iterator SIZE_ITERATOR;
+	std::pair<SIZE_ITERATOR, SIZE_ITERATOR> sized = m_blocksBySize.equal_range(block->second);
+	for (SIZE_ITERATOR it = sized.first; it != sized.second; ++it)
+	{
+		if (it->second == BLOCK_KEY(page, offset))
+		{
+			m_blocksBySize.erase(it);
+			break;
+		}
+	}
+	blocks.erase(block);
+}
+
+/***********************************************************
+ *  CarveFreeBlock()
+ *
+ *  This method is used for taking an aligned range out of a
+ *  free block, the padding before it and the rest after it
+ *  going back to the page as free blocks.
+ ***********************************************************/
+GLintptr BufferAllocator::CarveFreeBlock(int page, GLintptr blockOffset, GLsizeiptr size, GLsizeiptr alignment)
+{
+	GLsizeiptr blockSize = m_pages[page].freeBlocks[blockOffset];
+	RemoveFreeBlock(page, blockOffset);
+
+	GLintptr offset = AlignUp(blockOffset, alignment);
+	if (offset > blockOffset)
+	{
+		InsertFreeBlock(page, blockOffset, offset - blockOffset);
+	}
+	GLintptr end = offset + size;
+	if (end < blockOffset + blockSize)
+	{
+		InsertFreeBlock(page, end, blockOffset + blockSize - end);
+	}
+	return(offset);
+}
+
+/***********************************************************
+ *  FindBestFit()
+ *
+ *  This method is used for finding the smallest free block
+ *  that holds the size at the alignment. The blocks are
+ *  walked up from the first as large as the size, and only
+ *  the padding of the alignment can make one of them too
+ *  small, so the walk is short.
+ ***********************************************************/
+bool BufferAllocator::FindBestFit(GLsizeiptr size, GLsizeiptr alignment, BLOCK_KEY& block) const
+{
+	std::multimap<GLsizeiptr, BLOCK_KEY>::const_iterator it = m_blocksBySize.lower_bound(size);
+	for (; it != m_blocksBySize.end(); ++it)
+	{
+		GLintptr offset = it->second.second;
+		if (AlignUp(offset, alignment) - offset + size <= it->first)
+		{
+			block = it->second;
+			return(true);
+		}
+	}
+	return(false);
+}
+
+/***********************************************************
+ *  FindEarlierFit()
+ *
+ *  This method is used for finding the first free block, in
+ *  the order of the pages and then the offsets, that holds
+ *  the allocation at its alignment and lies before it. A
+ *  free block never overlaps an allocation, so the copy
+ *  into it never reads the bytes it writes.
+ ***********************************************************/
+bool BufferAllocator::FindEarlierFit(const ALLOCATION& allocation, BLOCK_KEY& block) const
+{
+	for (int page = 0; page <= allocation.page; page++)
+	{
+		const std::map<GLintptr, GLsizeiptr>& blocks = m_pages[page].freeBlocks;
+		std::map<GLintptr, GLsizeiptr>::const_iterator it = blocks.begin();
+		for (; it != blocks.end(); ++it)
+		{
+			if ((page == allocation.page) && (it->first >= allocation.offset))
+			{
+				break;
+			}
+			if (AlignUp(it->first, allocation.alignment) + allocation.size <= it->first + it->second)
+			{
+				block = BLOCK_KEY(page, it->first);
+				return(true);
+			}
+		}
+	}
+	return(false);
+}
+
+/***********************************************************
+ *  Allocate()
+ *
+ *  This method is used for placing a range in the best
+ *  fitting free block, or at the start of a new page when
+ *  none fits, and writing its data.
+ ***********************************************************/
+int BufferAllocator::Allocate(GLsizeiptr size, GLsizeiptr alignment, const void* pData, bool bMovable,
+	RelocateCallback relocate, void* pContext)
+{
+	if (size <= 0)
+	{
+		return(-1);
+	}
+	if (alignment < 1)
+	{
+		alignment = 1;
+	}
+
+	BLOCK_KEY block;
+	if (FindBestFit(size, alignment, block) == false)
+	{
+		block = BLOCK_KEY(CreatePage((size > m_pageSize) ? size : m_pageSize), 0);
+	}
+	GLintptr offset = CarveFreeBlock(block.first, block.second, size, alignment);
+
+	int handle = -1;
+	if (m_freeHandles.empty() == false)
+	{
+		handle = m_freeHandles.back();
+		m_freeHandles.pop_back();
+	}
+	else
+	{
+		handle = (int)m_allocations.size();
+		m_allocations.push_back(ALLOCATION());
+	}
+
+	ALLOCATION& allocation = m_allocations[handle];
+	allocation.page = block.first;
+	allocation.offset = offset;
+	allocation.size = size;
+	allocation.alignment = alignment;
+	allocation.bMovable = bMovable;
+	allocation.relocate = relocate;
+	allocation.pContext = pContext;
+	m_pages[block.first].allocations++;
+
+	if (NULL != pData)
+	{
+		glBindBuffer(GL_COPY_WRITE_BUFFER, m_pages[block.first].buffer);
+		glBufferSubData(GL_COPY_WRITE_BUFFER, offset, size, pData);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	}
+
+	m_quietFrames = 0;
+	m_bSettled = false;
+	return(handle);
+}
+
+/***********************************************************
+ *  Free()
+ *
+ *  This method is used for giving the range of an
+ *  allocation back to its page. An empty page stays until
+ *  the idle frames release it, so freeing and allocating
+ *  again does not recreate it.
+ ***********************************************************/
+void BufferAllocator::Free(int allocation)
+{
+	if ((allocation < 0) || (allocation >= (int)m_allocations.size()) ||
+		(m_allocations[allocation].page < 0))
+	{
+		return;
+	}
+
+	ALLOCATION& freed = m_allocations[allocation];
+	InsertFreeBlock(freed.page, freed.offset, freed.size);
+	m_pages[freed.page].allocations--;
+	freed.page = -1;
+	freed.relocate = NULL;
+	freed.pContext = NULL;
+	m_freeHandles.push_back(allocation);
+
+	m_quietFrames = 0;
+	m_bSettled = false;
+}
+
+/***********************************************************
+ *  GetRange()
+ *
+ *  This method is used for getting the buffer, offset and
+ *  size an allocation holds now.
+ ***********************************************************/
+BufferAllocator::RANGE BufferAllocator::GetRange(int allocation) const
+{
+	RANGE range;
+	range.buffer = 0;
+	range.offset = 0;
+	range.size = 0;
+	if ((allocation >= 0) && (allocation < (int)m_allocations.size()) &&
+		(m_allocations[allocation].page >= 0))
+	{
+		const ALLOCATION& held = m_allocations[allocation];
+		range.buffer = m_pages[held.page].buffer;
+		range.offset = held.offset;
+		range.size = held.size;
+	}
+	return(range);
+}
+
+/***********************************************************
+ *  Defragment()
+ *
+ *  This method is used for closing the holes the frees
+ *  left, once no allocation or free happened for the idle
+ *  frames. The movable ranges are taken from the last in
+ *  the pages on, each copied on the GPU into the first free
+ *  block before it that holds it, so the allocations pack
+ *  toward the first pages and the free bytes gather at the
+ *  end. The pages left empty are released. A pass that
+ *  finds nothing to move settles the pages until the next
+ *  allocation or free.
+ ***********************************************************/
+GLsizeiptr BufferAllocator::Defragment(GLsizeiptr maxBytes)
+{
+	if (m_quietFrames < IDLE_FRAMES)
+	{
+		m_quietFrames++;
+		return(0);
+	}
+	if (m_bSettled == true)
+	{
+		return(0);
+	}
+
+	// the movable allocations, the last in the pages first
+	std::vector<std::pair<BLOCK_KEY, int> > order;
+	for (size_t i = 0; i < m_allocations.size(); i++)
+	{
+		if ((m_allocations[i].page >= 0) && (m_allocations[i].bMovable == true))
+		{
+			order.push_back(std::make_pair(BLOCK_KEY(m_allocations[i].page, m_allocations[i].offset), (int)i));
+		}
+	}
+	std::sort(order.rbegin(), order.rend());
+
+	GLsizeiptr moved = 0;
+	for (size_t i = 0; (i < order.size()) && (moved < maxBytes); i++)
+	{
+		int handle = order[i].second;
+		BLOCK_KEY block;
+		if (FindEarlierFit(m_allocations[handle], block) == false)
+		{
+			continue;
+		}
+
+		ALLOCATION& allocation = m_allocations[handle];
+		int sourcePage = allocation.page;
+		GLintptr sourceOffset = allocation.offset;
+		GLintptr offset = CarveFreeBlock(block.first, block.second, allocation.size, allocation.alignment);
+
+		glBindBuffer(GL_COPY_READ_BUFFER, m_pages[sourcePage].buffer);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, m_pages[block.first].buffer);
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, sourceOffset, offset, allocation.size);
+
+		InsertFreeBlock(sourcePage, sourceOffset, allocation.size);
+		m_pages[sourcePage].allocations--;
+		m_pages[block.first].allocations++;
+		allocation.page = block.first;
+		allocation.offset = offset;
+		moved += allocation.size;
+		m_movedAllocations++;
+		m_movedBytes += (unsigned long long)allocation.size;
+
+		// the owner may allocate in the callback, which can move
+		// the allocations in memory
+		RelocateCallback relocate = allocation.relocate;
+		void* pContext = allocation.pContext;
+		if (NULL != relocate)
+		{
+			relocate(pContext, handle);
+		}
+	}
+	glBindBuffer(GL_COPY_READ_BUFFER, 0);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+	for (size_t i = 0; i < m_pages.size(); i++)
+	{
+		if ((0 != m_pages[i].buffer) && (0 == m_pages[i].allocations))
+		{
+			RemoveFreeBlock((int)i, 0);
+			GPUMemory::DeleteBuffers(1, &m_pages[i].buffer);
+			m_pages[i].buffer = 0;
+			m_pages[i].size = 0;
+			m_pages[i].freeBlocks.clear();
+			m_releasedPages++;
+		}
+	}
+
+	m_bSettled = (0 == moved);
+	return(moved);
+}
+
+/***********************************************************
+ *  GetFragmentation()
+ *
+ *  This method is used for the share of the free bytes that
+ *  a single allocation of them could not use, outside the
+ *  largest free block.
+ ***********************************************************/
+float BufferAllocator::GetFragmentation() const
+{
+	ALLOCATOR_STATS stats = GetStats();
+	if (0 == stats.freeBytes)
+	{
+		return(0.0f);
+	}
+	return(1.0f - (float)((double)stats.largestFreeBlock / (double)stats.freeBytes));
+}
+
+/***********************************************************
+ *  GetStats()
+ *
+ *  This method is used for counting the pages, allocations
+ *  and free blocks as they stand.
+ ***********************************************************/
+BufferAllocator::ALLOCATOR_STATS BufferAllocator::GetStats() const
+{
+	ALLOCATOR_STATS stats = {};
+	for (size_t i = 0; i < m_pages.size(); i++)
+	{
+		if (0 == m_pages[i].buffer)
+		{
+			continue;
+		}
+		stats.pages++;
+		stats.pageBytes += (unsigned long long)m_pages[i].size;
+		std::map<GLintptr, GLsizeiptr>::const_iterator it = m_pages[i].freeBlocks.begin();
+		for (; it != m_pages[i].freeBlocks.end(); ++it)
+		{
+			stats.freeBlocks++;
+			stats.freeBytes += (unsigned long long)it->second;
+			stats.largestFreeBlock = std::max(stats.largestFreeBlock, (unsigned long long)it->second);
+		}
+	}
+	for (size_t i = 0; i < m_allocations.size(); i++)
+	{
+		if (m_allocations[i].page >= 0)
+		{
+			stats.allocations++;
+			stats.allocatedBytes += (unsigned long long)m_allocations[i].size;
+		}
+	}
+	stats.movedAllocations = m_movedAllocations;
+	stats.movedBytes = m_movedBytes;
+	stats.releasedPages = m_releasedPages;
+	return(stats);
+}
+
+/***********************************************************
+ *  Print()
+ *
+ *  This method is used for printing the pages, allocations,
+ *  fragmentation and moves for the exit report.
+ ***********************************************************/
+void BufferAllocator::Print(const char* name) const
+{
+	ALLOCATOR_STATS stats = GetStats();
+	std::cout << name << " pages " << stats.pages
+		<< "\tKB " << stats.pageBytes / 1024
+		<< "\tallocations " << stats.allocations
+		<< "\tKB used " << stats.allocatedBytes / 1024
+		<< "\tfree blocks " << stats.freeBlocks
+		<< "\tfragmentation " << (int)(GetFragmentation() * 100.0f + 0.5f) << "%\n";
+	std::cout << name << " moved " << stats.movedAllocations
+		<< "\tKB moved " << stats.movedBytes / 1024
+		<< "\tpages released " << stats.releasedPages << "\n";
+}
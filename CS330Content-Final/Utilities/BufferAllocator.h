@@ -0,0 +1,168 @@
+///////////////////////////////////////////////////////////////////////////////
+// bufferallocator.h
+// ============
+// aligned ranges handed out of a few large buffer pages
+//
+//  A buffer object per array multiplies the objects the driver tracks
+//  and leaves video memory cut into as many separate blocks. The
+//  arrays created for good, such as the meshlets of the meshes and the
+//  merged static geometry, are placed instead in ranges of large
+//  pages: each page keeps its free blocks by offset, so a freed range
+//  merges with its neighbours at once, and all the free blocks are
+//  indexed by size, so an allocation takes the smallest block it fits
+//  in. Freeing leaves holes, which the idle frames close by copying
+//  movable ranges into free blocks earlier in the pages on the GPU,
+//  a few at a time, until the last pages are empty and released.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "GPUMemory.h"
+
+#include <GL/glew.h>
+
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+/***********************************************************
+ *  BufferAllocator
+ *
+ *  This class contains the pages, their free blocks and the
+ *  allocations made from them. Allocations are named by a
+ *  handle, since defragmenting moves the range behind it.
+ ***********************************************************/
+class BufferAllocator
+{
+public:
+	// constructor
+	BufferAllocator();
+	// destructor
+	~BufferAllocator();
+
+	// the bytes an allocation holds in its page
+	struct RANGE
+	{
+		GLuint buffer;
+		GLintptr offset;
+		GLsizeiptr size;
+	};
+
+	// receives an allocation Defragment() moved, once its bytes are
+	// in the new range, for its owner to point its bindings at it
+	typedef void (*RelocateCallback)(void* pContext, int allocation);
+
+	// the pages and allocations as they stand, and the moves since
+	// the start
+	struct ALLOCATOR_STATS
+	{
+		unsigned long long pages;
+		unsigned long long pageBytes;
+		unsigned long long allocations;
+		unsigned long long allocatedBytes;	// the sizes asked for
+		unsigned long long freeBytes;
+		unsigned long long freeBlocks;
+		unsigned long long largestFreeBlock;
+		unsigned long long movedAllocations;
+		unsigned long long movedBytes;
+		unsigned long long releasedPages;
+	};
+
+	// size of a page unless Create() sets another
+	static const GLsizeiptr DEFAULT_PAGE_SIZE = 16 * 1024 * 1024;
+	// Defragment() calls without an allocation or a free before
+	// the pages are taken as settled enough to move ranges
+	static const int IDLE_FRAMES = 30;
+
+	// set the size of the pages created from then on, and the memory
+	// category and owner they are counted under; no page is created
+	// before the first allocation
+	void Create(GLsizeiptr pageSize, GPUMemory::CATEGORY category, const char* owner);
+	// free every allocation and page
+	void Destroy();
+
+	// allocate size bytes at an offset that is a multiple of
+	// alignment, filled with pData unless it is NULL; a range larger
+	// than a page gets a page of its own. Defragment() only moves a
+	// movable allocation, whose owner reads its range at each use or
+	// is told through the relocate callback. Returns the handle, or
+	// -1 for an empty size
+	int Allocate(GLsizeiptr size, GLsizeiptr alignment, const void* pData, bool bMovable,
+		RelocateCallback relocate = NULL, void* pContext = NULL);
+	// give the range back, merging it with the free blocks around it
+	void Free(int allocation);
+	// the range of an allocation, an empty one for -1
+	RANGE GetRange(int allocation) const;
+
+	// called once per frame: after IDLE_FRAMES calls without an
+	// allocation or a free, copy up to maxBytes of movable ranges
+	// into free blocks earlier in the pages and release the pages
+	// left empty; returns the bytes moved
+	GLsizeiptr Defragment(GLsizeiptr maxBytes);
+
+	// share of the free bytes outside the largest free block, 0
+	// when the free bytes are one block
+	float GetFragmentation() const;
+	ALLOCATOR_STATS GetStats() const;
+	// print the stats for the exit report
+	void Print(const char* name) const;
+
+private:
+	struct PAGE
+	{
+		GLuint buffer;			// 0 once released
+		GLsizeiptr size;
+		int allocations;
+		// free blocks by offset, with their sizes
+		std::map<GLintptr, GLsizeiptr> freeBlocks;
+	};
+
+	struct ALLOCATION
+	{
+		int page;				// -1 for a free handle
+		GLintptr offset;
+		GLsizeiptr size;
+		GLsizeiptr alignment;
+		bool bMovable;
+		RelocateCallback relocate;
+		void* pContext;
+	};
+
+	// a free block as the size index names it
+	typedef std::pair<int, GLintptr> BLOCK_KEY;
+
+	GLsizeiptr m_pageSize;
+	GPUMemory::CATEGORY m_category;
+	std::string m_owner;
+	std::vector<PAGE> m_pages;
+	std::vector<ALLOCATION> m_allocations;
+	std::vector<int> m_freeHandles;
+	// every free block of every page by size, for the best fit
+	std::multimap<GLsizeiptr, BLOCK_KEY> m_blocksBySize;
+	// Defragment() calls since the last allocation or free, and
+	// whether the last pass found nothing to move
+	int m_quietFrames;
+	bool m_bSettled;
+	unsigned long long m_movedAllocations;
+	unsigned long long m_movedBytes;
+	unsigned long long m_releasedPages;
+
+	// create a page of at least size bytes, returning its index
+	int CreatePage(GLsizeiptr size);
+	// add a free block, merged with the free blocks it touches
+	void InsertFreeBlock(int page, GLintptr offset, GLsizeiptr size);
+	void RemoveFreeBlock(int page, GLintptr offset);
+	// take size bytes at an aligned offset out of a free block,
+	// returning the free parts before and after it to the page
+	GLintptr CarveFreeBlock(int page, GLintptr blockOffset, GLsizeiptr size, GLsizeiptr alignment);
+	// the free block of the best fit, false when none fits
+	bool FindBestFit(GLsizeiptr size, GLsizeiptr alignment, BLOCK_KEY& block) const;
+	// the first free block in page order that fits before the
+	// allocation, false when none does
+	bool FindEarlierFit(const ALLOCATION& allocation, BLOCK_KEY& block) const;
+
+	// not copyable, the pages are owned
+	BufferAllocator(const BufferAllocator&);
+	BufferAllocator& operator=(const BufferAllocator&);
+};
@@ -0,0 +1,186 @@
+///////////////////////////////////////////////////////////////////////////////
+// filewatcher.cpp
+// ============
+// one background thread noticing when watched files are saved
+//
+//  Hot reloading the shaders, textures and models all comes down to
+//  noticing that a file changed. One thread polls the modification
+//  time of every watched file and raises a flag for each one that
+//  moved, and whoever watches the file takes the flag between frames,
+//  on the thread that may touch GL. Nothing is read on the watcher
+//  thread, so a file saved twice within an interval is reloaded once.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "FileWatcher.h"
+#include "ScopeProfiler.h"
+
+#include <chrono>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+/***********************************************************
+ *  FileWatcher()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+FileWatcher::FileWatcher()
+{
+	m_bRunning = false;
+	m_bStopping = false;
+	m_intervalMilliseconds = DEFAULT_INTERVAL_MILLISECONDS;
+}
+
+/***********************************************************
+ *  ~FileWatcher()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+FileWatcher::~FileWatcher()
+{
+	Stop();
+}
+
+/***********************************************************
+ *  Watch()
+ *
+ *  This method is used for adding a file to the ones
+ *  polled, noting its modification time now so only later
+ *  saves count as changes.
+ ***********************************************************/
+int FileWatcher::Watch(const std::string& path)
+{
+	WATCH watch;
+	watch.path = path;
+	watch.modifiedTime = GetModifiedTime(path);
+	watch.bChanged = false;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_watches.push_back(watch);
+	return((int)m_watches.size() - 1);
+}
+
+/***********************************************************
+ *  TakeChange()
+ *
+ *  This method is used for taking the change flag of a
+ *  watch, which the polling thread raised.
+ ***********************************************************/
+bool FileWatcher::TakeChange(int watch)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if ((watch < 0) || (watch >= (int)m_watches.size()) || (m_watches[watch].bChanged == false))
+	{
+		return(false);
+	}
+	m_watches[watch].bChanged = false;
+	return(true);
+}
+
+/***********************************************************
+ *  Start()
+ *
+ *  This method is used for starting the polling thread.
+ ***********************************************************/
+void FileWatcher::Start(int intervalMilliseconds)
+{
+	if (m_bRunning == true)
+	{
+		return;
+	}
+
+	m_intervalMilliseconds = intervalMilliseconds;
+	m_bStopping = false;
+	m_bRunning = true;
+	m_thread = std::thread(&FileWatcher::WatchLoop, this);
+}
+
+/***********************************************************
+ *  Stop()
+ *
+ *  This method is used for stopping the polling thread,
+ *  waking it from its wait so it ends at once.
+ ***********************************************************/
+void FileWatcher::Stop()
+{
+	if (m_bRunning == false)
+	{
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_bStopping = true;
+	}
+	m_stop.notify_one();
+	m_thread.join();
+	m_bRunning = false;
+}
+
+/***********************************************************
+ *  GetModifiedTime()
+ *
+ *  This method is used for reading the last modification
+ *  time of a file.
+ ***********************************************************/
+long long FileWatcher::GetModifiedTime(const std::string& path)
+{
+#ifdef _WIN32
+	struct _stat64 fileInfo;
+	if (_stat64(path.c_str(), &fileInfo) != 0)
+	{
+		return(0);
+	}
+#else
+	struct stat fileInfo;
+	if (stat(path.c_str(), &fileInfo) != 0)
+	{
+		return(0);
+	}
+#endif
+	return((long long)fileInfo.st_mtime);
+}
+
+/***********************************************************
+ *  WatchLoop()
+ *
+ *  This method runs on the polling thread. The files are
+ *  checked outside the lock, so a slow disk never holds up
+ *  the frame taking the changes, and a file that cannot be
+ *  read is skipped, since editors may briefly remove it
+ *  while saving it.
+ ***********************************************************/
+void FileWatcher::WatchLoop()
+{
+	ScopeProfiler::SetThreadName("file watcher");
+
+	std::vector<std::string> paths;
+	std::vector<long long> modifiedTimes;
+	std::unique_lock<std::mutex> lock(m_mutex);
+	while (m_stop.wait_for(lock, std::chrono::milliseconds(m_intervalMilliseconds),
+		[this]() { return(m_bStopping); }) == false)
+	{
+		paths.resize(m_watches.size());
+		for (size_t i = 0; i < m_watches.size(); i++)
+		{
+			paths[i] = m_watches[i].path;
+		}
+		lock.unlock();
+
+		modifiedTimes.resize(paths.size());
+		for (size_t i = 0; i < paths.size(); i++)
+		{
+			modifiedTimes[i] = GetModifiedTime(paths[i]);
+		}
+
+		lock.lock();
+		for (size_t i = 0; i < modifiedTimes.size(); i++)
+		{
+			if ((modifiedTimes[i] != 0) && (modifiedTimes[i] != m_watches[i].modifiedTime))
+			{
+				m_watches[i].modifiedTime = modifiedTimes[i];
+				m_watches[i].bChanged = true;
+			}
+		}
+	}
+}
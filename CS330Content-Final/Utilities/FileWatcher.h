@@ -0,0 +1,79 @@
+///////////////////////////////////////////////////////////////////////////////
+// filewatcher.h
+// ============
+// one background thread noticing when watched files are saved
+//
+//  Hot reloading the shaders, textures and models all comes down to
+//  noticing that a file changed. One thread polls the modification
+//  time of every watched file and raises a flag for each one that
+//  moved, and whoever watches the file takes the flag between frames,
+//  on the thread that may touch GL. Nothing is read on the watcher
+//  thread, so a file saved twice within an interval is reloaded once.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/***********************************************************
+ *  FileWatcher
+ *
+ *  This class contains the watched files and the thread
+ *  polling them. Watch() may be called while the thread
+ *  runs, and several owners may watch the same file, each
+ *  taking its own changes.
+ ***********************************************************/
+class FileWatcher
+{
+public:
+	// constructor
+	FileWatcher();
+	// destructor
+	~FileWatcher();
+
+	// how often the files are polled unless told otherwise
+	static const int DEFAULT_INTERVAL_MILLISECONDS = 250;
+
+	// watch a file, returning the ID its changes are taken by
+	int Watch(const std::string& path);
+	// true once for every change of a watched file since the last
+	// call; false for an unknown ID
+	bool TakeChange(int watch);
+	const std::string& GetPath(int watch) const { return(m_watches[watch].path); }
+
+	// start and stop the polling thread
+	void Start(int intervalMilliseconds = DEFAULT_INTERVAL_MILLISECONDS);
+	void Stop();
+	bool IsRunning() const { return(m_bRunning); }
+
+	// last modification time of a file, 0 when it cannot be read
+	static long long GetModifiedTime(const std::string& path);
+
+private:
+	struct WATCH
+	{
+		std::string path;
+		long long modifiedTime;
+		bool bChanged;
+	};
+
+	// guards the watches, which both threads touch
+	mutable std::mutex m_mutex;
+	std::vector<WATCH> m_watches;
+	std::thread m_thread;
+	bool m_bRunning;
+	bool m_bStopping;
+	std::condition_variable m_stop;
+	int m_intervalMilliseconds;
+
+	// body of the polling thread
+	void WatchLoop();
+
+	// not copyable, the thread is owned
+	FileWatcher(const FileWatcher&);
+	FileWatcher& operator=(const FileWatcher&);
+};
@@ -0,0 +1,224 @@
+///////////////////////////////////////////////////////////////////////////////
+// gldebug.cpp
+// ============
+// KHR_debug messages, object labels and debug groups
+//
+//  In a debug context the driver reports errors and performance
+//  warnings, such as shader recompiles and buffer sync stalls, through
+//  a callback, which is otherwise never installed, so they go unseen.
+//  The messages are printed with a limit per message, so one warning
+//  raised every frame does not flood the output. The buffers, textures
+//  and programs get labels, and the passes of the frame debug groups,
+//  so a capture in RenderDoc or Nsight names what it shows. Outside the
+//  debug mode every call here returns at once.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "GLDebug.h"
+#include "Logger.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#include <vector>
+
+bool GLDebug::s_bEnabled = false;
+std::mutex GLDebug::s_mutex;
+GLDebug::DEBUG_STATS GLDebug::s_stats = {};
+std::map<GLuint, unsigned long long> GLDebug::s_messageCounts;
+
+namespace
+{
+	// message ids listed by count in the report
+	const size_t REPORTED_MESSAGES = 8;
+
+	// name of a message type for the output
+	const char* GetTypeName(GLenum type)
+	{
+		switch (type)
+		{
+		case GL_DEBUG_TYPE_ERROR:
+			return("error");
+		case GL_DEBUG_TYPE_DEPRECATED_BEHAVIOR:
+			return("deprecated");
+		case GL_DEBUG_TYPE_UNDEFINED_BEHAVIOR:
+			return("undefined behavior");
+		case GL_DEBUG_TYPE_PORTABILITY:
+			return("portability");
+		case GL_DEBUG_TYPE_PERFORMANCE:
+			return("performance");
+		default:
+			return("other");
+		}
+	}
+}
+
+/***********************************************************
+ *  Enable()
+ *
+ *  This method is used for installing the message callback
+ *  on the current context. The messages are synchronous, so
+ *  each arrives during the call that raised it and a
+ *  debugger stopped in the callback shows that call. The
+ *  notifications, which include the debug groups, are left
+ *  out.
+ ***********************************************************/
+bool GLDebug::Enable()
+{
+	if ((GLEW_KHR_debug == false) && (GLEW_VERSION_4_3 == false))
+	{
+		LOG_WARNING("GL debug output needs KHR_debug");
+		return(false);
+	}
+
+	GLint contextFlags = 0;
+	glGetIntegerv(GL_CONTEXT_FLAGS, &contextFlags);
+	if ((contextFlags & GL_CONTEXT_FLAG_DEBUG_BIT) == 0)
+	{
+		LOG_WARNING("GL context is not a debug context, the driver may report little");
+	}
+
+	glEnable(GL_DEBUG_OUTPUT);
+	glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+	glDebugMessageCallback(&GLDebug::MessageCallback, NULL);
+	glDebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, GL_DONT_CARE, 0, NULL, GL_TRUE);
+	glDebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, GL_DEBUG_SEVERITY_NOTIFICATION, 0, NULL, GL_FALSE);
+	s_bEnabled = true;
+	return(true);
+}
+
+/***********************************************************
+ *  MessageCallback()
+ *
+ *  This method is called by the driver for every message.
+ *  It counts the message by kind and id, and prints the
+ *  first few of each id and then one of every
+ *  REPEAT_INTERVAL, so a warning raised every frame still
+ *  shows now and then without flooding the output.
+ ***********************************************************/
+void GLAPIENTRY GLDebug::MessageCallback(GLenum source, GLenum type, GLuint id, GLenum severity,
+	GLsizei length, const GLchar* message, const void* pUserParam)
+{
+	std::lock_guard<std::mutex> lock(s_mutex);
+	if (type == GL_DEBUG_TYPE_ERROR)
+	{
+		s_stats.errors++;
+	}
+	else if (type == GL_DEBUG_TYPE_PERFORMANCE)
+	{
+		s_stats.performance++;
+	}
+	else if ((type == GL_DEBUG_TYPE_PUSH_GROUP) || (type == GL_DEBUG_TYPE_POP_GROUP) ||
+		(type == GL_DEBUG_TYPE_MARKER))
+	{
+		return;
+	}
+	else
+	{
+		s_stats.other++;
+	}
+
+	unsigned long long count = ++s_messageCounts[id];
+	if ((count > MESSAGE_REPEATS) && ((count % REPEAT_INTERVAL) != 0))
+	{
+		s_stats.suppressed++;
+		return;
+	}
+
+	// queued for the logger's thread, as the driver may call from
+	// the render loop; only errors are written at once
+	char repeats[32] = "";
+	if (count > MESSAGE_REPEATS)
+	{
+		snprintf(repeats, sizeof(repeats), " (%llu times)", count);
+	}
+	if (type == GL_DEBUG_TYPE_ERROR)
+	{
+		LOG_ERROR("GL %s [%u]%s: %s", GetTypeName(type), id, repeats, message);
+	}
+	else
+	{
+		LOG_WARNING("GL %s [%u]%s: %s", GetTypeName(type), id, repeats, message);
+	}
+}
+
+/***********************************************************
+ *  Label()
+ *
+ *  This method is used for naming a GL object in the debug
+ *  mode.
+ ***********************************************************/
+void GLDebug::Label(GLenum identifier, GLuint name, const char* label)
+{
+	if ((s_bEnabled == false) || (0 == name))
+	{
+		return;
+	}
+	glObjectLabel(identifier, name, -1, label);
+}
+
+/***********************************************************
+ *  PushGroup()
+ *
+ *  This method is used for opening a debug group in the
+ *  debug mode.
+ ***********************************************************/
+void GLDebug::PushGroup(const char* name)
+{
+	if (s_bEnabled == false)
+	{
+		return;
+	}
+	glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 0, -1, name);
+}
+
+/***********************************************************
+ *  PopGroup()
+ *
+ *  This method is used for closing the last debug group.
+ ***********************************************************/
+void GLDebug::PopGroup()
+{
+	if (s_bEnabled == false)
+	{
+		return;
+	}
+	glPopDebugGroup();
+}
+
+/***********************************************************
+ *  GetStats()
+ *
+ *  This method is used for getting the message counts.
+ ***********************************************************/
+GLDebug::DEBUG_STATS GLDebug::GetStats()
+{
+	std::lock_guard<std::mutex> lock(s_mutex);
+	return(s_stats);
+}
+
+/***********************************************************
+ *  Print()
+ *
+ *  This method is used for printing the message counts and
+ *  the ids that were reported most often.
+ ***********************************************************/
+void GLDebug::Print()
+{
+	std::lock_guard<std::mutex> lock(s_mutex);
+	std::cout << "\n*** GL DEBUG: ***\n";
+	std::cout << "errors " << s_stats.errors
+		<< "\tperformance " << s_stats.performance
+		<< "\tother " << s_stats.other
+		<< "\tsuppressed " << s_stats.suppressed << "\n";
+
+	std::vector<std::pair<unsigned long long, GLuint> > counts;
+	for (std::map<GLuint, unsigned long long>::const_iterator it = s_messageCounts.begin(); it != s_messageCounts.end(); ++it)
+	{
+		counts.push_back(std::make_pair(it->second, it->first));
+	}
+	std::sort(counts.rbegin(), counts.rend());
+	for (size_t i = 0; (i < counts.size()) && (i < REPORTED_MESSAGES); i++)
+	{
+		std::cout << "message " << counts[i].second << "\treported " << counts[i].first << "\n";
+	}
+}
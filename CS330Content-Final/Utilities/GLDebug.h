@@ -0,0 +1,88 @@
+///////////////////////////////////////////////////////////////////////////////
+// gldebug.h
+// ============
+// KHR_debug messages, object labels and debug groups
+//
+//  In a debug context the driver reports errors and performance
+//  warnings, such as shader recompiles and buffer sync stalls, through
+//  a callback, which is otherwise never installed, so they go unseen.
+//  The messages are printed with a limit per message, so one warning
+//  raised every frame does not flood the output. The buffers, textures
+//  and programs get labels, and the passes of the frame debug groups,
+//  so a capture in RenderDoc or Nsight names what it shows. Outside the
+//  debug mode every call here returns at once.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+#include <map>
+#include <mutex>
+
+/***********************************************************
+ *  GLDebug
+ *
+ *  This class contains the message callback and its counts.
+ *  It is used through static methods, like ScopeProfiler,
+ *  so any module can label its objects.
+ ***********************************************************/
+class GLDebug
+{
+public:
+	// messages of one id printed before the rest are only counted,
+	// and the count after which one is printed again
+	static const int MESSAGE_REPEATS = 3;
+	static const int REPEAT_INTERVAL = 1000;
+
+	// messages the driver reported, by kind
+	struct DEBUG_STATS
+	{
+		unsigned long long errors;
+		unsigned long long performance;
+		unsigned long long other;		// deprecated, undefined, portability and the rest
+		unsigned long long suppressed;	// counted but not printed
+	};
+
+	// install the callback on the current context, which should
+	// have been created with GLFW_OPENGL_DEBUG_CONTEXT; false when
+	// the driver lacks KHR_debug
+	static bool Enable();
+	static bool IsEnabled() { return(s_bEnabled); }
+
+	// name a buffer, texture, program, framebuffer or vertex array
+	// for the debuggers
+	static void Label(GLenum identifier, GLuint name, const char* label);
+	// open and close a named group of GL calls
+	static void PushGroup(const char* name);
+	static void PopGroup();
+
+	static DEBUG_STATS GetStats();
+	// print the counts and the messages that repeated most
+	static void Print();
+
+private:
+	static bool s_bEnabled;
+	// guards the counts, since a driver may call back on its own
+	// threads
+	static std::mutex s_mutex;
+	static DEBUG_STATS s_stats;
+	// times each message id was reported
+	static std::map<GLuint, unsigned long long> s_messageCounts;
+
+	static void GLAPIENTRY MessageCallback(GLenum source, GLenum type, GLuint id, GLenum severity,
+		GLsizei length, const GLchar* message, const void* pUserParam);
+};
+
+/***********************************************************
+ *  GLDebugGroup
+ *
+ *  This class keeps a debug group open for the scope it
+ *  lives in.
+ ***********************************************************/
+class GLDebugGroup
+{
+public:
+	explicit GLDebugGroup(const char* name) { GLDebug::PushGroup(name); }
+	~GLDebugGroup() { GLDebug::PopGroup(); }
+};
@@ -0,0 +1,203 @@
+///////////////////////////////////////////////////////////////////////////////
+// glloader.cpp
+// ============
+// resolves the OpenGL entry points the application calls, and no others
+//
+//  The table of GLLoaderTable.h is expanded into one list of groups
+//  followed by their functions. The extensions the context advertises
+//  are only looked up among the listed ones, and a group whose
+//  functions are not all found has its flag cleared, as GLEW does.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "GLLoader.h"
+#include "Logger.h"
+#include "ScopeProfiler.h"
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
+
+GLLoader::LOADER_STATS GLLoader::s_stats = {};
+
+namespace
+{
+	// kinds of the entries of the table
+	enum ENTRY_KIND
+	{
+		ENTRY_VERSION,
+		ENTRY_EXTENSION,
+		ENTRY_FUNCTION
+	};
+
+	// a group, with its flag and the version it needs or is core
+	// in, or a function of the group before it
+	struct LOADER_ENTRY
+	{
+		ENTRY_KIND kind;
+		const char* name;
+		void* pTarget;			// GLboolean flag or entry point pointer
+		int majorVersion;
+		int minorVersion;
+	};
+
+#define GL_LOADER_VERSION(major, minor) \
+	{ ENTRY_VERSION, "GL_VERSION_" #major "_" #minor, &__GLEW_VERSION_##major##_##minor, major, minor },
+#define GL_LOADER_EXTENSION(extension, major, minor) \
+	{ ENTRY_EXTENSION, "GL_" #extension, &__GLEW_##extension, major, minor },
+#define GL_LOADER_FUNCTION(function) \
+	{ ENTRY_FUNCTION, "gl" #function, (void*)&__glew##function, 0, 0 },
+
+	const LOADER_ENTRY g_entries[] =
+	{
+#include "GLLoaderTable.h"
+	};
+
+#undef GL_LOADER_VERSION
+#undef GL_LOADER_EXTENSION
+#undef GL_LOADER_FUNCTION
+
+	const int ENTRY_COUNT = sizeof(g_entries) / sizeof(g_entries[0]);
+
+	// listed extensions sorted by name, for looking up advertised ones
+	struct ENTRY_NAME_ORDER
+	{
+		bool operator()(const LOADER_ENTRY* a, const LOADER_ENTRY* b) const { return(strcmp(a->name, b->name) < 0); }
+		bool operator()(const LOADER_ENTRY* a, const char* b) const { return(strcmp(a->name, b) < 0); }
+	};
+
+	bool VersionAtLeast(int major, int minor, int contextMajor, int contextMinor)
+	{
+		return((contextMajor > major) || ((contextMajor == major) && (contextMinor >= minor)));
+	}
+}
+
+/***********************************************************
+ *  Load()
+ *
+ *  This method is used for resolving the listed entry
+ *  points of the current context and setting the flags of
+ *  its versions and advertised extensions.
+ ***********************************************************/
+bool GLLoader::Load(GET_PROC_ADDRESS getProcAddress)
+{
+	long long start = ScopeProfiler::Now();
+	s_stats = LOADER_STATS();
+
+	GLint majorVersion = 0;
+	GLint minorVersion = 0;
+	glGetIntegerv(GL_MAJOR_VERSION, &majorVersion);
+	glGetIntegerv(GL_MINOR_VERSION, &minorVersion);
+	s_stats.majorVersion = majorVersion;
+	s_stats.minorVersion = minorVersion;
+	if (VersionAtLeast(MIN_MAJOR_VERSION, MIN_MINOR_VERSION, majorVersion, minorVersion) == false)
+	{
+		LOG_ERROR("OpenGL %d.%d is older than the %d.%d the application needs",
+			majorVersion, minorVersion, MIN_MAJOR_VERSION, MIN_MINOR_VERSION);
+		return(false);
+	}
+
+	// the flags are set from the context alone before any function
+	std::vector<const LOADER_ENTRY*> extensions;
+	for (int i = 0; i < ENTRY_COUNT; i++)
+	{
+		if (g_entries[i].kind == ENTRY_VERSION)
+		{
+			*(GLboolean*)g_entries[i].pTarget = VersionAtLeast(g_entries[i].majorVersion,
+				g_entries[i].minorVersion, majorVersion, minorVersion) ? GL_TRUE : GL_FALSE;
+		}
+		else if (g_entries[i].kind == ENTRY_EXTENSION)
+		{
+			*(GLboolean*)g_entries[i].pTarget = GL_FALSE;
+			extensions.push_back(&g_entries[i]);
+		}
+	}
+	std::sort(extensions.begin(), extensions.end(), ENTRY_NAME_ORDER());
+
+	__glewGetStringi = (PFNGLGETSTRINGIPROC)getProcAddress("glGetStringi");
+	if (__glewGetStringi == NULL)
+	{
+		LOG_ERROR("OpenGL %d.%d lacks glGetStringi", majorVersion, minorVersion);
+		return(false);
+	}
+	GLint extensionCount = 0;
+	glGetIntegerv(GL_NUM_EXTENSIONS, &extensionCount);
+	for (GLint i = 0; i < extensionCount; i++)
+	{
+		const char* name = (const char*)glGetStringi(GL_EXTENSIONS, i);
+		if (name == NULL)
+		{
+			continue;
+		}
+		std::vector<const LOADER_ENTRY*>::iterator found =
+			std::lower_bound(extensions.begin(), extensions.end(), name, ENTRY_NAME_ORDER());
+		if ((found != extensions.end()) && (strcmp((*found)->name, name) == 0))
+		{
+			*(GLboolean*)(*found)->pTarget = GL_TRUE;
+		}
+	}
+
+	// the functions of a group are resolved when its version is met,
+	// or its extension is advertised or part of the context version
+	const LOADER_ENTRY* pGroup = NULL;
+	bool bLoadGroup = false;
+	bool bComplete = true;
+	std::string missing;
+	for (int i = 0; i < ENTRY_COUNT; i++)
+	{
+		const LOADER_ENTRY& entry = g_entries[i];
+		if (entry.kind != ENTRY_FUNCTION)
+		{
+			pGroup = &entry;
+			bLoadGroup = (*(GLboolean*)entry.pTarget == GL_TRUE) || ((entry.kind == ENTRY_EXTENSION) &&
+				(entry.majorVersion > 0) && (VersionAtLeast(entry.majorVersion, entry.minorVersion, majorVersion, minorVersion) == true));
+			continue;
+		}
+
+		s_stats.functions++;
+		*(PROC*)entry.pTarget = (bLoadGroup == true) ? getProcAddress(entry.name) : NULL;
+		if (*(PROC*)entry.pTarget != NULL)
+		{
+			s_stats.resolved++;
+		}
+		else if (bLoadGroup == true)
+		{
+			*(GLboolean*)pGroup->pTarget = GL_FALSE;
+			if ((pGroup->kind == ENTRY_VERSION) && (VersionAtLeast(pGroup->majorVersion,
+				pGroup->minorVersion, MIN_MAJOR_VERSION, MIN_MINOR_VERSION) == true))
+			{
+				LOG_ERROR("OpenGL %d.%d lacks %s", majorVersion, minorVersion, entry.name);
+				bComplete = false;
+			}
+		}
+	}
+
+	for (int i = 0; i < ENTRY_COUNT; i++)
+	{
+		if (g_entries[i].kind != ENTRY_EXTENSION)
+		{
+			continue;
+		}
+		s_stats.extensions++;
+		if (*(GLboolean*)g_entries[i].pTarget == GL_TRUE)
+		{
+			s_stats.advertised++;
+		}
+		else
+		{
+			missing += " ";
+			missing += g_entries[i].name;
+		}
+	}
+	s_stats.milliseconds = (double)(ScopeProfiler::Now() - start) / 1000000.0;
+
+	LOG_INFO("OpenGL %d.%d: %d of %d entry points, %d of %d extensions in %.2f ms",
+		majorVersion, minorVersion, s_stats.resolved, s_stats.functions,
+		s_stats.advertised, s_stats.extensions, s_stats.milliseconds);
+	if (missing.empty() == false)
+	{
+		LOG_INFO("OpenGL extensions not available:%s", missing.c_str());
+	}
+
+	return(bComplete);
+}
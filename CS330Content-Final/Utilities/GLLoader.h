@@ -0,0 +1,61 @@
+///////////////////////////////////////////////////////////////////////////////
+// glloader.h
+// ============
+// resolves the OpenGL entry points the application calls, and no others
+//
+//  glewInit() asks the driver for every entry point of every version
+//  and extension GLEW knows, some thousands of lookups, and parses the
+//  extension string for hundreds of flags the application never reads.
+//  The loader instead fills the GLEW pointers and flags listed in
+//  GLLoaderTable.h: the functions of each core version the context
+//  provides, and those of an extension only when the context advertises
+//  it or provides the version that took it in. The GLEW headers and
+//  pointers stay, so the calls, the GLEW_*() checks and the GLTrace
+//  hooks are unchanged. What was resolved and what is missing is logged
+//  once, so the capabilities the run depends on are plain.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+/***********************************************************
+ *  GLLoader
+ *
+ *  This class contains the loading of the entry points and
+ *  what it found. It is used through static methods, like
+ *  GLDebug, as the entry points are global.
+ ***********************************************************/
+class GLLoader
+{
+public:
+	// the oldest context the application runs on
+	static const int MIN_MAJOR_VERSION = 3;
+	static const int MIN_MINOR_VERSION = 3;
+
+	// the lookup of the window library, such as glfwGetProcAddress
+	typedef void (*PROC)();
+	typedef PROC (*GET_PROC_ADDRESS)(const char* name);
+
+	// what the last Load() found
+	struct LOADER_STATS
+	{
+		int majorVersion;			// of the context
+		int minorVersion;
+		int functions;				// entry points listed
+		int resolved;				// of them found
+		int extensions;				// extensions listed
+		int advertised;				// of them advertised and complete
+		double milliseconds;
+	};
+
+	// resolve the listed entry points for the current context; false
+	// when it is older than the minimum version or lacks one of the
+	// functions up to it
+	static bool Load(GET_PROC_ADDRESS getProcAddress);
+
+	static const LOADER_STATS& GetStats() { return(s_stats); }
+
+private:
+	static LOADER_STATS s_stats;
+};
@@ -0,0 +1,314 @@
+///////////////////////////////////////////////////////////////////////////////
+// glloadertable.h
+// ============
+// the OpenGL entry points and capability flags the application uses
+//
+//  Listed from the gl*() calls and GLEW_*() checks in the sources, so
+//  GLLoader resolves these and nothing else. Each group is a core
+//  version or an extension, the extensions with the core version that
+//  took them in, 0, 0 for none. A call or check added to the sources
+//  needs its line here, or its pointer stays NULL and its flag false.
+//  Included by GLLoader.cpp with the three macros defined; no guard.
+///////////////////////////////////////////////////////////////////////////////
+
+GL_LOADER_VERSION(1, 2)
+	GL_LOADER_FUNCTION(TexImage3D)
+GL_LOADER_VERSION(1, 3)
+	GL_LOADER_FUNCTION(ActiveTexture)
+	GL_LOADER_FUNCTION(CompressedTexImage2D)
+GL_LOADER_VERSION(1, 4)
+	GL_LOADER_FUNCTION(BlendColor)
+	GL_LOADER_FUNCTION(BlendFuncSeparate)
+GL_LOADER_VERSION(1, 5)
+	GL_LOADER_FUNCTION(BeginQuery)
+	GL_LOADER_FUNCTION(BindBuffer)
+	GL_LOADER_FUNCTION(BufferData)
+	GL_LOADER_FUNCTION(BufferSubData)
+	GL_LOADER_FUNCTION(DeleteBuffers)
+	GL_LOADER_FUNCTION(DeleteQueries)
+	GL_LOADER_FUNCTION(EndQuery)
+	GL_LOADER_FUNCTION(GenBuffers)
+	GL_LOADER_FUNCTION(GenQueries)
+	GL_LOADER_FUNCTION(GetBufferSubData)
+	GL_LOADER_FUNCTION(GetQueryObjectiv)
+	GL_LOADER_FUNCTION(IsBuffer)
+	GL_LOADER_FUNCTION(UnmapBuffer)
+GL_LOADER_VERSION(2, 0)
+	GL_LOADER_FUNCTION(AttachShader)
+	GL_LOADER_FUNCTION(BlendEquationSeparate)
+	GL_LOADER_FUNCTION(CompileShader)
+	GL_LOADER_FUNCTION(CreateProgram)
+	GL_LOADER_FUNCTION(CreateShader)
+	GL_LOADER_FUNCTION(DeleteProgram)
+	GL_LOADER_FUNCTION(DeleteShader)
+	GL_LOADER_FUNCTION(DetachShader)
+	GL_LOADER_FUNCTION(DrawBuffers)
+	GL_LOADER_FUNCTION(EnableVertexAttribArray)
+	GL_LOADER_FUNCTION(GetActiveUniform)
+	GL_LOADER_FUNCTION(GetProgramInfoLog)
+	GL_LOADER_FUNCTION(GetProgramiv)
+	GL_LOADER_FUNCTION(GetShaderInfoLog)
+	GL_LOADER_FUNCTION(GetShaderiv)
+	GL_LOADER_FUNCTION(GetUniformLocation)
+	GL_LOADER_FUNCTION(GetUniformfv)
+	GL_LOADER_FUNCTION(GetUniformiv)
+	GL_LOADER_FUNCTION(GetVertexAttribiv)
+	GL_LOADER_FUNCTION(IsProgram)
+	GL_LOADER_FUNCTION(LinkProgram)
+	GL_LOADER_FUNCTION(ShaderSource)
+	GL_LOADER_FUNCTION(Uniform1f)
+	GL_LOADER_FUNCTION(Uniform1i)
+	GL_LOADER_FUNCTION(Uniform2f)
+	GL_LOADER_FUNCTION(Uniform2fv)
+	GL_LOADER_FUNCTION(Uniform2i)
+	GL_LOADER_FUNCTION(Uniform3f)
+	GL_LOADER_FUNCTION(Uniform3fv)
+	GL_LOADER_FUNCTION(Uniform4f)
+	GL_LOADER_FUNCTION(Uniform4fv)
+	GL_LOADER_FUNCTION(UniformMatrix2fv)
+	GL_LOADER_FUNCTION(UniformMatrix3fv)
+	GL_LOADER_FUNCTION(UniformMatrix4fv)
+	GL_LOADER_FUNCTION(UseProgram)
+	GL_LOADER_FUNCTION(VertexAttribPointer)
+GL_LOADER_VERSION(2, 1)
+GL_LOADER_VERSION(3, 0)
+	GL_LOADER_FUNCTION(BeginConditionalRender)
+	GL_LOADER_FUNCTION(ClearBufferfv)
+	GL_LOADER_FUNCTION(ClearBufferuiv)
+	GL_LOADER_FUNCTION(ColorMaski)
+	GL_LOADER_FUNCTION(EndConditionalRender)
+	GL_LOADER_FUNCTION(GetStringi)
+	GL_LOADER_FUNCTION(GetUniformuiv)
+	GL_LOADER_FUNCTION(Uniform1ui)
+	GL_LOADER_FUNCTION(Uniform2ui)
+	GL_LOADER_FUNCTION(VertexAttribIPointer)
+GL_LOADER_VERSION(3, 1)
+	GL_LOADER_FUNCTION(DrawArraysInstanced)
+	GL_LOADER_FUNCTION(TexBuffer)
+GL_LOADER_VERSION(3, 2)
+	GL_LOADER_FUNCTION(FramebufferTexture)
+	GL_LOADER_FUNCTION(GetInteger64i_v)
+GL_LOADER_VERSION(3, 3)
+	GL_LOADER_FUNCTION(VertexAttribDivisor)
+GL_LOADER_VERSION(4, 0)
+	GL_LOADER_FUNCTION(BlendFuncSeparatei)
+	GL_LOADER_FUNCTION(BlendFunci)
+GL_LOADER_VERSION(4, 1)
+GL_LOADER_VERSION(4, 2)
+GL_LOADER_VERSION(4, 3)
+GL_LOADER_VERSION(4, 4)
+GL_LOADER_VERSION(4, 5)
+GL_LOADER_VERSION(4, 6)
+	GL_LOADER_FUNCTION(MultiDrawElementsIndirectCount)
+	GL_LOADER_FUNCTION(SpecializeShader)
+GL_LOADER_EXTENSION(ARB_ES2_compatibility, 4, 1)
+	GL_LOADER_FUNCTION(ShaderBinary)
+GL_LOADER_EXTENSION(ARB_base_instance, 4, 2)
+	GL_LOADER_FUNCTION(DrawArraysInstancedBaseInstance)
+GL_LOADER_EXTENSION(ARB_bindless_texture, 0, 0)
+	GL_LOADER_FUNCTION(GetTextureSamplerHandleARB)
+	GL_LOADER_FUNCTION(MakeTextureHandleNonResidentARB)
+	GL_LOADER_FUNCTION(MakeTextureHandleResidentARB)
+GL_LOADER_EXTENSION(ARB_buffer_storage, 4, 4)
+	GL_LOADER_FUNCTION(BufferStorage)
+GL_LOADER_EXTENSION(ARB_clear_buffer_object, 4, 3)
+	GL_LOADER_FUNCTION(ClearBufferData)
+GL_LOADER_EXTENSION(ARB_clear_texture, 4, 4)
+	GL_LOADER_FUNCTION(ClearTexImage)
+	GL_LOADER_FUNCTION(ClearTexSubImage)
+GL_LOADER_EXTENSION(ARB_clip_control, 4, 5)
+	GL_LOADER_FUNCTION(ClipControl)
+GL_LOADER_EXTENSION(ARB_compute_shader, 4, 3)
+	GL_LOADER_FUNCTION(DispatchCompute)
+GL_LOADER_EXTENSION(ARB_copy_buffer, 3, 1)
+	GL_LOADER_FUNCTION(CopyBufferSubData)
+GL_LOADER_EXTENSION(ARB_copy_image, 4, 3)
+	GL_LOADER_FUNCTION(CopyImageSubData)
+GL_LOADER_EXTENSION(ARB_direct_state_access, 4, 5)
+	GL_LOADER_FUNCTION(BindTextureUnit)
+	GL_LOADER_FUNCTION(ClearNamedBufferSubData)
+	GL_LOADER_FUNCTION(CompressedTextureSubImage2D)
+	GL_LOADER_FUNCTION(CompressedTextureSubImage3D)
+	GL_LOADER_FUNCTION(CopyNamedBufferSubData)
+	GL_LOADER_FUNCTION(CreateBuffers)
+	GL_LOADER_FUNCTION(CreateFramebuffers)
+	GL_LOADER_FUNCTION(CreateRenderbuffers)
+	GL_LOADER_FUNCTION(CreateSamplers)
+	GL_LOADER_FUNCTION(CreateTextures)
+	GL_LOADER_FUNCTION(CreateVertexArrays)
+	GL_LOADER_FUNCTION(EnableVertexArrayAttrib)
+	GL_LOADER_FUNCTION(GenerateTextureMipmap)
+	GL_LOADER_FUNCTION(GetCompressedTextureImage)
+	GL_LOADER_FUNCTION(GetNamedBufferParameteri64v)
+	GL_LOADER_FUNCTION(GetNamedBufferParameteriv)
+	GL_LOADER_FUNCTION(GetNamedBufferSubData)
+	GL_LOADER_FUNCTION(GetNamedFramebufferAttachmentParameteriv)
+	GL_LOADER_FUNCTION(GetNamedFramebufferParameteriv)
+	GL_LOADER_FUNCTION(GetNamedRenderbufferParameteriv)
+	GL_LOADER_FUNCTION(GetTextureImage)
+	GL_LOADER_FUNCTION(GetTextureLevelParameteriv)
+	GL_LOADER_FUNCTION(GetTextureParameterfv)
+	GL_LOADER_FUNCTION(GetTextureParameteriv)
+	GL_LOADER_FUNCTION(NamedBufferData)
+	GL_LOADER_FUNCTION(NamedBufferStorage)
+	GL_LOADER_FUNCTION(NamedBufferSubData)
+	GL_LOADER_FUNCTION(NamedFramebufferDrawBuffers)
+	GL_LOADER_FUNCTION(NamedFramebufferReadBuffer)
+	GL_LOADER_FUNCTION(NamedFramebufferRenderbuffer)
+	GL_LOADER_FUNCTION(NamedFramebufferTexture)
+	GL_LOADER_FUNCTION(NamedFramebufferTextureLayer)
+	GL_LOADER_FUNCTION(NamedRenderbufferStorageMultisample)
+	GL_LOADER_FUNCTION(TextureBuffer)
+	GL_LOADER_FUNCTION(TextureBufferRange)
+	GL_LOADER_FUNCTION(TextureParameterf)
+	GL_LOADER_FUNCTION(TextureParameteri)
+	GL_LOADER_FUNCTION(TextureParameteriv)
+	GL_LOADER_FUNCTION(TextureStorage2D)
+	GL_LOADER_FUNCTION(TextureStorage2DMultisample)
+	GL_LOADER_FUNCTION(TextureStorage3D)
+	GL_LOADER_FUNCTION(TextureStorage3DMultisample)
+	GL_LOADER_FUNCTION(TextureSubImage2D)
+	GL_LOADER_FUNCTION(TextureSubImage3D)
+	GL_LOADER_FUNCTION(VertexArrayAttribBinding)
+	GL_LOADER_FUNCTION(VertexArrayAttribFormat)
+	GL_LOADER_FUNCTION(VertexArrayAttribIFormat)
+	GL_LOADER_FUNCTION(VertexArrayAttribLFormat)
+	GL_LOADER_FUNCTION(VertexArrayBindingDivisor)
+	GL_LOADER_FUNCTION(VertexArrayElementBuffer)
+	GL_LOADER_FUNCTION(VertexArrayVertexBuffer)
+GL_LOADER_EXTENSION(ARB_draw_buffers_blend, 4, 0)
+	GL_LOADER_FUNCTION(BlendFunciARB)
+GL_LOADER_EXTENSION(ARB_draw_elements_base_vertex, 3, 2)
+	GL_LOADER_FUNCTION(DrawElementsBaseVertex)
+	GL_LOADER_FUNCTION(DrawElementsInstancedBaseVertex)
+GL_LOADER_EXTENSION(ARB_framebuffer_object, 3, 0)
+	GL_LOADER_FUNCTION(BindFramebuffer)
+	GL_LOADER_FUNCTION(BindRenderbuffer)
+	GL_LOADER_FUNCTION(BlitFramebuffer)
+	GL_LOADER_FUNCTION(CheckFramebufferStatus)
+	GL_LOADER_FUNCTION(DeleteFramebuffers)
+	GL_LOADER_FUNCTION(DeleteRenderbuffers)
+	GL_LOADER_FUNCTION(FramebufferRenderbuffer)
+	GL_LOADER_FUNCTION(FramebufferTexture2D)
+	GL_LOADER_FUNCTION(FramebufferTextureLayer)
+	GL_LOADER_FUNCTION(GenFramebuffers)
+	GL_LOADER_FUNCTION(GenRenderbuffers)
+	GL_LOADER_FUNCTION(GenerateMipmap)
+	GL_LOADER_FUNCTION(IsFramebuffer)
+	GL_LOADER_FUNCTION(IsRenderbuffer)
+	GL_LOADER_FUNCTION(RenderbufferStorage)
+GL_LOADER_EXTENSION(ARB_get_program_binary, 4, 1)
+	GL_LOADER_FUNCTION(GetProgramBinary)
+	GL_LOADER_FUNCTION(ProgramBinary)
+	GL_LOADER_FUNCTION(ProgramParameteri)
+GL_LOADER_EXTENSION(ARB_gl_spirv, 4, 6)
+GL_LOADER_EXTENSION(ARB_indirect_parameters, 4, 6)
+	GL_LOADER_FUNCTION(MultiDrawElementsIndirectCountARB)
+GL_LOADER_EXTENSION(ARB_internalformat_query, 4, 2)
+	GL_LOADER_FUNCTION(GetInternalformativ)
+GL_LOADER_EXTENSION(ARB_map_buffer_range, 3, 0)
+	GL_LOADER_FUNCTION(MapBufferRange)
+GL_LOADER_EXTENSION(ARB_multi_draw_indirect, 4, 3)
+	GL_LOADER_FUNCTION(MultiDrawArraysIndirect)
+	GL_LOADER_FUNCTION(MultiDrawElementsIndirect)
+GL_LOADER_EXTENSION(ARB_parallel_shader_compile, 0, 0)
+	GL_LOADER_FUNCTION(MaxShaderCompilerThreadsARB)
+GL_LOADER_EXTENSION(ARB_program_interface_query, 4, 3)
+	GL_LOADER_FUNCTION(GetProgramInterfaceiv)
+	GL_LOADER_FUNCTION(GetProgramResourceIndex)
+	GL_LOADER_FUNCTION(GetProgramResourceName)
+	GL_LOADER_FUNCTION(GetProgramResourceiv)
+GL_LOADER_EXTENSION(ARB_sampler_objects, 3, 3)
+	GL_LOADER_FUNCTION(BindSampler)
+	GL_LOADER_FUNCTION(DeleteSamplers)
+	GL_LOADER_FUNCTION(GenSamplers)
+	GL_LOADER_FUNCTION(GetSamplerParameterfv)
+	GL_LOADER_FUNCTION(GetSamplerParameteriv)
+	GL_LOADER_FUNCTION(IsSampler)
+	GL_LOADER_FUNCTION(SamplerParameterf)
+	GL_LOADER_FUNCTION(SamplerParameteri)
+GL_LOADER_EXTENSION(ARB_separate_shader_objects, 4, 1)
+	GL_LOADER_FUNCTION(ActiveShaderProgram)
+	GL_LOADER_FUNCTION(BindProgramPipeline)
+	GL_LOADER_FUNCTION(DeleteProgramPipelines)
+	GL_LOADER_FUNCTION(GenProgramPipelines)
+	GL_LOADER_FUNCTION(ProgramUniform1f)
+	GL_LOADER_FUNCTION(ProgramUniform1fv)
+	GL_LOADER_FUNCTION(ProgramUniform1i)
+	GL_LOADER_FUNCTION(ProgramUniform1iv)
+	GL_LOADER_FUNCTION(ProgramUniform1uiv)
+	GL_LOADER_FUNCTION(ProgramUniform2fv)
+	GL_LOADER_FUNCTION(ProgramUniform2iv)
+	GL_LOADER_FUNCTION(ProgramUniform2uiv)
+	GL_LOADER_FUNCTION(ProgramUniform3fv)
+	GL_LOADER_FUNCTION(ProgramUniform3iv)
+	GL_LOADER_FUNCTION(ProgramUniform3uiv)
+	GL_LOADER_FUNCTION(ProgramUniform4fv)
+	GL_LOADER_FUNCTION(ProgramUniform4iv)
+	GL_LOADER_FUNCTION(ProgramUniform4uiv)
+	GL_LOADER_FUNCTION(ProgramUniformMatrix2fv)
+	GL_LOADER_FUNCTION(ProgramUniformMatrix2x3fv)
+	GL_LOADER_FUNCTION(ProgramUniformMatrix2x4fv)
+	GL_LOADER_FUNCTION(ProgramUniformMatrix3fv)
+	GL_LOADER_FUNCTION(ProgramUniformMatrix3x2fv)
+	GL_LOADER_FUNCTION(ProgramUniformMatrix3x4fv)
+	GL_LOADER_FUNCTION(ProgramUniformMatrix4fv)
+	GL_LOADER_FUNCTION(ProgramUniformMatrix4x2fv)
+	GL_LOADER_FUNCTION(ProgramUniformMatrix4x3fv)
+	GL_LOADER_FUNCTION(UseProgramStages)
+GL_LOADER_EXTENSION(ARB_shader_draw_parameters, 4, 6)
+GL_LOADER_EXTENSION(ARB_shader_image_load_store, 4, 2)
+	GL_LOADER_FUNCTION(BindImageTexture)
+	GL_LOADER_FUNCTION(MemoryBarrier)
+GL_LOADER_EXTENSION(ARB_shader_storage_buffer_object, 4, 3)
+	GL_LOADER_FUNCTION(ShaderStorageBlockBinding)
+GL_LOADER_EXTENSION(ARB_shader_viewport_layer_array, 0, 0)
+GL_LOADER_EXTENSION(ARB_sparse_texture, 0, 0)
+	GL_LOADER_FUNCTION(TexPageCommitmentARB)
+GL_LOADER_EXTENSION(ARB_sync, 3, 2)
+	GL_LOADER_FUNCTION(ClientWaitSync)
+	GL_LOADER_FUNCTION(DeleteSync)
+	GL_LOADER_FUNCTION(FenceSync)
+GL_LOADER_EXTENSION(ARB_texture_compression_bptc, 4, 2)
+GL_LOADER_EXTENSION(ARB_texture_compression_rgtc, 3, 0)
+GL_LOADER_EXTENSION(ARB_texture_filter_anisotropic, 4, 6)
+GL_LOADER_EXTENSION(ARB_texture_storage, 4, 2)
+	GL_LOADER_FUNCTION(TexStorage2D)
+	GL_LOADER_FUNCTION(TexStorage3D)
+GL_LOADER_EXTENSION(ARB_texture_storage_multisample, 4, 3)
+	GL_LOADER_FUNCTION(TexStorage2DMultisample)
+GL_LOADER_EXTENSION(ARB_timer_query, 3, 3)
+	GL_LOADER_FUNCTION(GetQueryObjectui64v)
+	GL_LOADER_FUNCTION(QueryCounter)
+GL_LOADER_EXTENSION(ARB_uniform_buffer_object, 3, 1)
+	GL_LOADER_FUNCTION(BindBufferBase)
+	GL_LOADER_FUNCTION(BindBufferRange)
+	GL_LOADER_FUNCTION(GetActiveUniformBlockName)
+	GL_LOADER_FUNCTION(GetActiveUniformBlockiv)
+	GL_LOADER_FUNCTION(GetIntegeri_v)
+	GL_LOADER_FUNCTION(GetUniformBlockIndex)
+	GL_LOADER_FUNCTION(UniformBlockBinding)
+GL_LOADER_EXTENSION(ARB_vertex_array_object, 3, 0)
+	GL_LOADER_FUNCTION(BindVertexArray)
+	GL_LOADER_FUNCTION(DeleteVertexArrays)
+	GL_LOADER_FUNCTION(GenVertexArrays)
+	GL_LOADER_FUNCTION(IsVertexArray)
+GL_LOADER_EXTENSION(ARB_vertex_attrib_binding, 4, 3)
+	GL_LOADER_FUNCTION(BindVertexBuffer)
+	GL_LOADER_FUNCTION(VertexAttribBinding)
+	GL_LOADER_FUNCTION(VertexAttribFormat)
+GL_LOADER_EXTENSION(ATI_meminfo, 0, 0)
+GL_LOADER_EXTENSION(EXT_texture_compression_s3tc, 0, 0)
+GL_LOADER_EXTENSION(EXT_texture_filter_anisotropic, 0, 0)
+GL_LOADER_EXTENSION(KHR_debug, 4, 3)
+	GL_LOADER_FUNCTION(DebugMessageCallback)
+	GL_LOADER_FUNCTION(DebugMessageControl)
+	GL_LOADER_FUNCTION(ObjectLabel)
+	GL_LOADER_FUNCTION(PopDebugGroup)
+	GL_LOADER_FUNCTION(PushDebugGroup)
+GL_LOADER_EXTENSION(KHR_parallel_shader_compile, 0, 0)
+	GL_LOADER_FUNCTION(MaxShaderCompilerThreadsKHR)
+GL_LOADER_EXTENSION(KHR_texture_compression_astc_ldr, 0, 0)
+GL_LOADER_EXTENSION(NVX_gpu_memory_info, 0, 0)
+GL_LOADER_EXTENSION(OVR_multiview, 0, 0)
+	GL_LOADER_FUNCTION(FramebufferTextureMultiviewOVR)
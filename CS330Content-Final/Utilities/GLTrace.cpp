@@ -0,0 +1,2158 @@
+///////////////////////////////////////////////////////////////////////////////
+// gltrace.cpp
+// ============
+// capture of the GL calls of a range of frames into a binary trace
+//
+//  A slow frame a customer reports can only be studied on a machine
+//  with the application, its assets and the same scene. The trace
+//  holds the GL calls of a range of frames instead, with the contents
+//  of every buffer, texture and program they use as it was the first
+//  time a call used it, so GLTraceReplay can run the frames again on
+//  any machine, alone, and time each call on another driver. GLEW
+//  calls the entry points past GL 1.1 through pointers, which are
+//  swapped here for recording ones; the GL 1.1 calls are linked
+//  directly, so their callers record the few that draw, and the
+//  fixed function state they set, the enables, blending, viewport
+//  and the bound textures, is recorded before each draw whenever it
+//  changed. The hooks are only installed for a capture, so a run
+//  without one calls the driver directly.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "GLTrace.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+bool GLTrace::s_bInstalled = false;
+GLTrace::GL_FUNCTIONS GLTrace::s_real = {};
+std::atomic<bool> GLTrace::s_bCapturing(false);
+std::thread::id GLTrace::s_captureThread;
+std::string GLTrace::s_filename;
+unsigned long long GLTrace::s_firstFrame = 0;
+unsigned long long GLTrace::s_frameCount = 0;
+unsigned long long GLTrace::s_frame = 0;
+FILE* GLTrace::s_pFile = NULL;
+std::vector<unsigned char> GLTrace::s_records;
+GLTrace::TRACE_STATS GLTrace::s_stats = {};
+std::set<unsigned long long> GLTrace::s_defined;
+GLTrace::TRACE_STATE GLTrace::s_state = {};
+bool GLTrace::s_bStateRecorded = false;
+std::mutex GLTrace::s_sourceMutex;
+std::map<GLuint, std::string> GLTrace::s_shaderSources;
+std::map<GLuint, std::vector<GLuint> > GLTrace::s_attachedShaders;
+std::map<GLuint, GLTrace::PROGRAM_SOURCE> GLTrace::s_programSources;
+
+namespace
+{
+	// records kept in memory before they are written, so a frame
+	// defining large textures does not hold them all
+	const size_t FLUSH_BYTES = 64 * 1024 * 1024;
+	// longest name of a uniform or block read back
+	const GLsizei MAX_NAME_LENGTH = 256;
+	// vertex attributes and bindings, and image units, recorded
+	const int TRACE_VERTEX_ATTRIBS = 16;
+	const int TRACE_IMAGE_UNITS = 8;
+	// indexed uniform and storage buffer bindings recorded
+	const int TRACE_BUFFER_BINDINGS = 32;
+
+	const GLenum ENABLE_CAP_LIST[GLTrace::STATE_ENABLES] =
+	{
+		GL_DEPTH_TEST, GL_BLEND, GL_CULL_FACE, GL_SCISSOR_TEST, GL_STENCIL_TEST,
+		GL_POLYGON_OFFSET_FILL, GL_MULTISAMPLE, GL_SAMPLE_ALPHA_TO_COVERAGE,
+		GL_TEXTURE_CUBE_MAP_SEAMLESS, GL_FRAMEBUFFER_SRGB, GL_PROGRAM_POINT_SIZE,
+		GL_DEPTH_CLAMP, GL_RASTERIZER_DISCARD
+	};
+	const GLenum TEXTURE_TARGET_LIST[GLTrace::STATE_TEXTURE_TARGETS] =
+	{
+		GL_TEXTURE_2D, GL_TEXTURE_2D_ARRAY, GL_TEXTURE_CUBE_MAP,
+		GL_TEXTURE_BUFFER, GL_TEXTURE_3D, GL_TEXTURE_2D_MULTISAMPLE
+	};
+	const GLenum TEXTURE_BINDING_LIST[GLTrace::STATE_TEXTURE_TARGETS] =
+	{
+		GL_TEXTURE_BINDING_2D, GL_TEXTURE_BINDING_2D_ARRAY, GL_TEXTURE_BINDING_CUBE_MAP,
+		GL_TEXTURE_BINDING_BUFFER, GL_TEXTURE_BINDING_3D, GL_TEXTURE_BINDING_2D_MULTISAMPLE
+	};
+
+	// the buffer targets bound outside the vertex arrays, and the
+	// queries of their bindings
+	const GLenum BUFFER_TARGETS[][2] =
+	{
+		{ GL_ARRAY_BUFFER, GL_ARRAY_BUFFER_BINDING },
+		{ GL_DRAW_INDIRECT_BUFFER, GL_DRAW_INDIRECT_BUFFER_BINDING },
+		{ GL_PARAMETER_BUFFER, GL_PARAMETER_BUFFER_BINDING },
+		{ GL_DISPATCH_INDIRECT_BUFFER, GL_DISPATCH_INDIRECT_BUFFER_BINDING },
+		{ GL_PIXEL_UNPACK_BUFFER, GL_PIXEL_UNPACK_BUFFER_BINDING },
+		{ GL_PIXEL_PACK_BUFFER, GL_PIXEL_PACK_BUFFER_BINDING },
+		{ GL_COPY_READ_BUFFER, GL_COPY_READ_BUFFER_BINDING },
+		{ GL_COPY_WRITE_BUFFER, GL_COPY_WRITE_BUFFER_BINDING },
+		{ GL_UNIFORM_BUFFER, GL_UNIFORM_BUFFER_BINDING },
+		{ GL_SHADER_STORAGE_BUFFER, GL_SHADER_STORAGE_BUFFER_BINDING }
+	};
+
+	// texture and sampler parameters recorded, and whether each
+	// is a float
+	const GLenum SAMPLER_PARAMETERS[][2] =
+	{
+		{ GL_TEXTURE_MIN_FILTER, GL_FALSE },
+		{ GL_TEXTURE_MAG_FILTER, GL_FALSE },
+		{ GL_TEXTURE_WRAP_S, GL_FALSE },
+		{ GL_TEXTURE_WRAP_T, GL_FALSE },
+		{ GL_TEXTURE_WRAP_R, GL_FALSE },
+		{ GL_TEXTURE_COMPARE_MODE, GL_FALSE },
+		{ GL_TEXTURE_COMPARE_FUNC, GL_FALSE },
+		{ GL_TEXTURE_MIN_LOD, GL_TRUE },
+		{ GL_TEXTURE_MAX_LOD, GL_TRUE },
+		{ GL_TEXTURE_LOD_BIAS, GL_TRUE },
+		{ GL_TEXTURE_MAX_ANISOTROPY, GL_TRUE }
+	};
+	const GLenum TEXTURE_ONLY_PARAMETERS[][2] =
+	{
+		{ GL_TEXTURE_BASE_LEVEL, GL_FALSE },
+		{ GL_TEXTURE_MAX_LEVEL, GL_FALSE },
+		{ GL_TEXTURE_SWIZZLE_R, GL_FALSE },
+		{ GL_TEXTURE_SWIZZLE_G, GL_FALSE },
+		{ GL_TEXTURE_SWIZZLE_B, GL_FALSE },
+		{ GL_TEXTURE_SWIZZLE_A, GL_FALSE }
+	};
+
+	const char* const OPCODE_NAMES[GLTrace::OP_COUNT] =
+	{
+		"glBindBuffer", "glBindBufferBase", "glBindBufferRange", "glBufferData",
+		"glBufferSubData", "glClearBufferData", "glUseProgram", "glUniform1i",
+		"glUniform1ui", "glUniform2ui", "glUniform1f", "glUniform2f",
+		"glUniform3f", "glUniform4f", "glUniform*fv", "glUniformMatrix*fv",
+		"glUniformBlockBinding", "glBindVertexArray", "glBindVertexBuffer", "glBindFramebuffer",
+		"glDrawBuffers", "glBlitFramebuffer", "glClearBufferfv", "glClearBufferuiv",
+		"glActiveTexture", "glBindSampler", "glBindImageTexture", "glGenerateTextureMipmap",
+		"glGenerateMipmap", "glTextureSubImage2D", "glTexBuffer", "glClipControl",
+		"glBlendFunci", "glMemoryBarrier", "glDispatchCompute", "glDrawArraysInstanced",
+		"glDrawElementsBaseVertex", "glDrawElementsInstancedBaseVertex", "glMultiDrawElementsIndirect", "glMultiDrawElementsIndirectCount",
+		"glMultiDrawArraysIndirect", "glClear", "glDrawArrays", "glCopyTexSubImage2D",
+		"state", "buffer write", "define buffer", "define texture",
+		"define renderbuffer", "define framebuffer", "define vertex array", "define sampler",
+		"define program", "frame end"
+	};
+
+	// the arguments of a record are 64 bit, so the signed ones are
+	// sign extended and the floats kept as their bits
+	unsigned long long SignedArg(long long value)
+	{
+		return((unsigned long long)value);
+	}
+
+	unsigned long long FloatArg(GLfloat value)
+	{
+		unsigned int bits = 0;
+		memcpy(&bits, &value, sizeof(bits));
+		return(bits);
+	}
+
+	unsigned long long PointerArg(const void* pValue)
+	{
+		return((unsigned long long)(uintptr_t)pValue);
+	}
+
+	void PutU32(std::vector<unsigned char>& blob, unsigned int value)
+	{
+		blob.insert(blob.end(), (const unsigned char*)&value, (const unsigned char*)&value + sizeof(value));
+	}
+
+	void PutU64(std::vector<unsigned char>& blob, unsigned long long value)
+	{
+		blob.insert(blob.end(), (const unsigned char*)&value, (const unsigned char*)&value + sizeof(value));
+	}
+
+	void PutBytes(std::vector<unsigned char>& blob, const void* pData, size_t bytes)
+	{
+		PutU64(blob, bytes);
+		blob.insert(blob.end(), (const unsigned char*)pData, (const unsigned char*)pData + bytes);
+	}
+
+	void PutString(std::vector<unsigned char>& blob, const std::string& text)
+	{
+		PutU32(blob, (unsigned int)text.size());
+		blob.insert(blob.end(), text.begin(), text.end());
+	}
+
+	// the format and type a texture of an internal format is read
+	// back and uploaded again in; false for the formats left out
+	bool GetTransferFormat(GLenum internalFormat, GLenum& format, GLenum& type)
+	{
+		switch (internalFormat)
+		{
+		case GL_R8: case GL_RED:
+			format = GL_RED; type = GL_UNSIGNED_BYTE; return(true);
+		case GL_RG8: case GL_RG:
+			format = GL_RG; type = GL_UNSIGNED_BYTE; return(true);
+		case GL_RGB8: case GL_SRGB8: case GL_RGB:
+			format = GL_RGB; type = GL_UNSIGNED_BYTE; return(true);
+		case GL_RGBA8: case GL_SRGB8_ALPHA8: case GL_RGBA:
+			format = GL_RGBA; type = GL_UNSIGNED_BYTE; return(true);
+		case GL_R16F:
+			format = GL_RED; type = GL_HALF_FLOAT; return(true);
+		case GL_RG16F:
+			format = GL_RG; type = GL_HALF_FLOAT; return(true);
+		case GL_RGB16F:
+			format = GL_RGB; type = GL_HALF_FLOAT; return(true);
+		case GL_RGBA16F:
+			format = GL_RGBA; type = GL_HALF_FLOAT; return(true);
+		case GL_R32F:
+			format = GL_RED; type = GL_FLOAT; return(true);
+		case GL_RG32F:
+			format = GL_RG; type = GL_FLOAT; return(true);
+		case GL_RGBA32F:
+			format = GL_RGBA; type = GL_FLOAT; return(true);
+		case GL_R11F_G11F_B10F:
+			format = GL_RGB; type = GL_UNSIGNED_INT_10F_11F_11F_REV; return(true);
+		case GL_RGB10_A2:
+			format = GL_RGBA; type = GL_UNSIGNED_INT_2_10_10_10_REV; return(true);
+		case GL_R8UI:
+			format = GL_RED_INTEGER; type = GL_UNSIGNED_BYTE; return(true);
+		case GL_R16UI:
+			format = GL_RED_INTEGER; type = GL_UNSIGNED_SHORT; return(true);
+		case GL_R32UI:
+			format = GL_RED_INTEGER; type = GL_UNSIGNED_INT; return(true);
+		case GL_RG32UI:
+			format = GL_RG_INTEGER; type = GL_UNSIGNED_INT; return(true);
+		case GL_RGBA16UI:
+			format = GL_RGBA_INTEGER; type = GL_UNSIGNED_SHORT; return(true);
+		case GL_RGBA32UI:
+			format = GL_RGBA_INTEGER; type = GL_UNSIGNED_INT; return(true);
+		case GL_R32I:
+			format = GL_RED_INTEGER; type = GL_INT; return(true);
+		case GL_DEPTH_COMPONENT16:
+			format = GL_DEPTH_COMPONENT; type = GL_UNSIGNED_SHORT; return(true);
+		case GL_DEPTH_COMPONENT24:
+		case GL_DEPTH_COMPONENT:
+			format = GL_DEPTH_COMPONENT; type = GL_UNSIGNED_INT; return(true);
+		case GL_DEPTH_COMPONENT32F:
+			format = GL_DEPTH_COMPONENT; type = GL_FLOAT; return(true);
+		case GL_DEPTH24_STENCIL8:
+			format = GL_DEPTH_STENCIL; type = GL_UNSIGNED_INT_24_8; return(true);
+		case GL_DEPTH32F_STENCIL8:
+			format = GL_DEPTH_STENCIL; type = GL_FLOAT_32_UNSIGNED_INT_24_8_REV; return(true);
+		default:
+			return(false);
+		}
+	}
+}
+
+/***********************************************************
+ *  Install()
+ *
+ *  This method is used for swapping the GLEW entry points
+ *  the renderer calls for the hooks, keeping the driver's
+ *  to pass the calls on to. The objects are read back with
+ *  direct state access, without touching the bindings of
+ *  the frame, so a driver without it gets no hooks.
+ ***********************************************************/
+void GLTrace::Install()
+{
+	if (s_bInstalled == true)
+	{
+		return;
+	}
+	if ((GLEW_VERSION_4_5 == GL_FALSE) && (GLEW_ARB_direct_state_access == GL_FALSE))
+	{
+		std::cout << "GL trace needs direct state access, no frames are captured" << std::endl;
+		return;
+	}
+
+	// keep the driver's entry point and swap in the hook, for the
+	// entry points the driver has
+#define GLTRACE_HOOK(function) \
+	s_real.function = __glew##function; \
+	if (NULL != __glew##function) \
+	{ \
+		__glew##function = &GLTrace::Hook##function; \
+	}
+
+	GLTRACE_HOOK(BindBuffer);
+	GLTRACE_HOOK(BindBufferBase);
+	GLTRACE_HOOK(BindBufferRange);
+	GLTRACE_HOOK(BufferData);
+	GLTRACE_HOOK(BufferSubData);
+	GLTRACE_HOOK(ClearBufferData);
+	GLTRACE_HOOK(UseProgram);
+	GLTRACE_HOOK(Uniform1i);
+	GLTRACE_HOOK(Uniform1ui);
+	GLTRACE_HOOK(Uniform2ui);
+	GLTRACE_HOOK(Uniform1f);
+	GLTRACE_HOOK(Uniform2f);
+	GLTRACE_HOOK(Uniform3f);
+	GLTRACE_HOOK(Uniform4f);
+	GLTRACE_HOOK(Uniform2fv);
+	GLTRACE_HOOK(Uniform3fv);
+	GLTRACE_HOOK(Uniform4fv);
+	GLTRACE_HOOK(UniformMatrix2fv);
+	GLTRACE_HOOK(UniformMatrix3fv);
+	GLTRACE_HOOK(UniformMatrix4fv);
+	GLTRACE_HOOK(UniformBlockBinding);
+	GLTRACE_HOOK(BindVertexArray);
+	GLTRACE_HOOK(BindVertexBuffer);
+	GLTRACE_HOOK(BindFramebuffer);
+	GLTRACE_HOOK(DrawBuffers);
+	GLTRACE_HOOK(BlitFramebuffer);
+	GLTRACE_HOOK(ClearBufferfv);
+	GLTRACE_HOOK(ClearBufferuiv);
+	GLTRACE_HOOK(ActiveTexture);
+	GLTRACE_HOOK(BindSampler);
+	GLTRACE_HOOK(BindImageTexture);
+	GLTRACE_HOOK(GenerateTextureMipmap);
+	GLTRACE_HOOK(GenerateMipmap);
+	GLTRACE_HOOK(TextureSubImage2D);
+	GLTRACE_HOOK(TexBuffer);
+	GLTRACE_HOOK(ClipControl);
+	GLTRACE_HOOK(BlendFunci);
+	GLTRACE_HOOK(BlendFunciARB);
+	GLTRACE_HOOK(DispatchCompute);
+	GLTRACE_HOOK(DrawArraysInstanced);
+	GLTRACE_HOOK(DrawElementsBaseVertex);
+	GLTRACE_HOOK(DrawElementsInstancedBaseVertex);
+	GLTRACE_HOOK(MultiDrawElementsIndirect);
+	GLTRACE_HOOK(MultiDrawElementsIndirectCount);
+	GLTRACE_HOOK(MultiDrawElementsIndirectCountARB);
+	GLTRACE_HOOK(MultiDrawArraysIndirect);
+	GLTRACE_HOOK(ShaderSource);
+	GLTRACE_HOOK(AttachShader);
+	GLTRACE_HOOK(DetachShader);
+	GLTRACE_HOOK(LinkProgram);
+	GLTRACE_HOOK(ProgramBinary);
+	GLTRACE_HOOK(DeleteProgram);
+	GLTRACE_HOOK(DeleteBuffers);
+	GLTRACE_HOOK(DeleteFramebuffers);
+	GLTRACE_HOOK(DeleteRenderbuffers);
+	GLTRACE_HOOK(DeleteVertexArrays);
+	GLTRACE_HOOK(DeleteSamplers);
+#undef GLTRACE_HOOK
+
+	// the member is not named after the entry point, which
+	// windows.h defines a macro of
+	s_real.MemoryBarriers = __glewMemoryBarrier;
+	if (NULL != __glewMemoryBarrier)
+	{
+		__glewMemoryBarrier = &GLTrace::HookMemoryBarriers;
+	}
+
+	s_bInstalled = true;
+}
+
+/***********************************************************
+ *  SetFrames()
+ *
+ *  This method is used for choosing the frames captured and
+ *  the file they are written to.
+ ***********************************************************/
+void GLTrace::SetFrames(const char* filename, unsigned long long firstFrame, unsigned long long frameCount)
+{
+	s_filename = filename;
+	s_firstFrame = firstFrame;
+	s_frameCount = frameCount;
+}
+
+/***********************************************************
+ *  BeginFrame()
+ *
+ *  This method is used for starting the capture with the
+ *  first frame of the range: the file is opened, and the
+ *  bindings the frame starts from are recorded as the calls
+ *  making them, which defines every object bound.
+ ***********************************************************/
+void GLTrace::BeginFrame(int width, int height)
+{
+	if ((s_bInstalled == false) || (s_frameCount == 0) || (s_frame != s_firstFrame) || (NULL != s_pFile))
+	{
+		return;
+	}
+
+	s_pFile = fopen(s_filename.c_str(), "wb");
+	if (NULL == s_pFile)
+	{
+		std::cout << "Could not create GL trace " << s_filename << std::endl;
+		s_frameCount = 0;
+		return;
+	}
+
+	// the header, with the frame size and the driver it came from
+	PutU32(s_records, TRACE_MAGIC);
+	PutU32(s_records, TRACE_VERSION);
+	PutU32(s_records, (unsigned int)width);
+	PutU32(s_records, (unsigned int)height);
+	const GLenum strings[] = { GL_VENDOR, GL_RENDERER, GL_VERSION };
+	for (size_t i = 0; i < sizeof(strings) / sizeof(strings[0]); i++)
+	{
+		const GLubyte* pString = glGetString(strings[i]);
+		PutString(s_records, (NULL != pString) ? (const char*)pString : "");
+	}
+
+	s_defined.clear();
+	s_bStateRecorded = false;
+	s_captureThread = std::this_thread::get_id();
+	s_bCapturing = true;
+	std::cout << "Capturing " << s_frameCount << " frames into GL trace " << s_filename << std::endl;
+	RecordBindings();
+}
+
+/***********************************************************
+ *  EndFrame()
+ *
+ *  This method is used for ending a frame, writing its
+ *  records, and closing the trace after the last frame of
+ *  the range.
+ ***********************************************************/
+void GLTrace::EndFrame()
+{
+	if (s_bInstalled == false)
+	{
+		return;
+	}
+	if (IsRecording() == true)
+	{
+		Record(OP_FRAME_END, { s_frame });
+		s_stats.frames++;
+		if (fwrite(s_records.data(), 1, s_records.size(), s_pFile) != s_records.size())
+		{
+			std::cout << "Could not write GL trace " << s_filename << std::endl;
+		}
+		s_stats.bytes += s_records.size();
+		s_records.clear();
+		if (s_stats.frames >= s_frameCount)
+		{
+			Finish();
+		}
+	}
+	s_frame++;
+}
+
+/***********************************************************
+ *  Finish()
+ *
+ *  This method is used for closing the trace, after its
+ *  last frame or when the run ends before it.
+ ***********************************************************/
+void GLTrace::Finish()
+{
+	if (NULL == s_pFile)
+	{
+		return;
+	}
+	s_bCapturing = false;
+	// a frame cut off in the middle is left out
+	s_records.clear();
+	fclose(s_pFile);
+	s_pFile = NULL;
+	s_frameCount = 0;
+	std::cout << "GL trace of " << s_stats.frames << " frames written to " << s_filename << std::endl;
+}
+
+/***********************************************************
+ *  IsRecording()
+ *
+ *  This method is used for telling whether the calls of
+ *  this thread are captured, which only those of the thread
+ *  rendering the frames are.
+ ***********************************************************/
+bool GLTrace::IsRecording()
+{
+	return((s_bCapturing.load() == true) && (std::this_thread::get_id() == s_captureThread));
+}
+
+/***********************************************************
+ *  Record()
+ *
+ *  This method is used for appending a record to the frame,
+ *  writing the records once they grow large.
+ ***********************************************************/
+void GLTrace::Record(int opcode, std::initializer_list<unsigned long long> args, const void* pData, size_t dataBytes)
+{
+	unsigned short header[2] = { (unsigned short)opcode, (unsigned short)args.size() };
+	unsigned int bytes = (NULL != pData) ? (unsigned int)dataBytes : 0;
+	s_records.insert(s_records.end(), (const unsigned char*)header, (const unsigned char*)header + sizeof(header));
+	s_records.insert(s_records.end(), (const unsigned char*)&bytes, (const unsigned char*)&bytes + sizeof(bytes));
+	for (std::initializer_list<unsigned long long>::const_iterator arg = args.begin(); arg != args.end(); ++arg)
+	{
+		PutU64(s_records, *arg);
+	}
+	if (bytes > 0)
+	{
+		s_records.insert(s_records.end(), (const unsigned char*)pData, (const unsigned char*)pData + bytes);
+	}
+
+	if (opcode < OP_STATE)
+	{
+		s_stats.calls++;
+	}
+	if ((s_records.size() >= FLUSH_BYTES) && (NULL != s_pFile))
+	{
+		fwrite(s_records.data(), 1, s_records.size(), s_pFile);
+		s_stats.bytes += s_records.size();
+		s_records.clear();
+	}
+}
+
+/***********************************************************
+ *  RecordBindings()
+ *
+ *  This method is used for recording the program, vertex
+ *  array, framebuffers, buffers, samplers and images bound
+ *  as the capture starts, since the frame relies on those
+ *  bound before it.
+ ***********************************************************/
+void GLTrace::RecordBindings()
+{
+	GLint name = 0;
+	glGetIntegerv(GL_CURRENT_PROGRAM, &name);
+	DefineProgram((GLuint)name);
+	Record(OP_USE_PROGRAM, { (GLuint)name });
+	glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &name);
+	DefineVertexArray((GLuint)name);
+	Record(OP_BIND_VERTEX_ARRAY, { (GLuint)name });
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &name);
+	DefineFramebuffer((GLuint)name);
+	Record(OP_BIND_FRAMEBUFFER, { GL_DRAW_FRAMEBUFFER, (GLuint)name });
+	glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &name);
+	DefineFramebuffer((GLuint)name);
+	Record(OP_BIND_FRAMEBUFFER, { GL_READ_FRAMEBUFFER, (GLuint)name });
+
+	for (size_t i = 0; i < sizeof(BUFFER_TARGETS) / sizeof(BUFFER_TARGETS[0]); i++)
+	{
+		glGetIntegerv(BUFFER_TARGETS[i][1], &name);
+		DefineBuffer((GLuint)name);
+		Record(OP_BIND_BUFFER, { BUFFER_TARGETS[i][0], (GLuint)name });
+	}
+	// the uniform and storage blocks read the indexed bindings
+	const GLenum indexedTargets[][4] =
+	{
+		{ GL_UNIFORM_BUFFER, GL_UNIFORM_BUFFER_BINDING, GL_UNIFORM_BUFFER_START, GL_UNIFORM_BUFFER_SIZE },
+		{ GL_SHADER_STORAGE_BUFFER, GL_SHADER_STORAGE_BUFFER_BINDING, GL_SHADER_STORAGE_BUFFER_START, GL_SHADER_STORAGE_BUFFER_SIZE }
+	};
+	for (int target = 0; target < 2; target++)
+	{
+		for (GLuint index = 0; index < (GLuint)TRACE_BUFFER_BINDINGS; index++)
+		{
+			name = 0;
+			glGetIntegeri_v(indexedTargets[target][1], index, &name);
+			if (0 == name)
+			{
+				continue;
+			}
+			GLint64 start = 0;
+			GLint64 size = 0;
+			glGetInteger64i_v(indexedTargets[target][2], index, &start);
+			glGetInteger64i_v(indexedTargets[target][3], index, &size);
+			DefineBuffer((GLuint)name);
+			if (size > 0)
+			{
+				Record(OP_BIND_BUFFER_RANGE, { indexedTargets[target][0], index, (GLuint)name, SignedArg(start), SignedArg(size) });
+			}
+			else
+			{
+				Record(OP_BIND_BUFFER_BASE, { indexedTargets[target][0], index, (GLuint)name });
+			}
+		}
+	}
+
+	// the samplers are bound per texture unit, which the query
+	// reads of the active one
+	GLint activeTexture = GL_TEXTURE0;
+	glGetIntegerv(GL_ACTIVE_TEXTURE, &activeTexture);
+	for (GLuint unit = 0; unit < (GLuint)STATE_TEXTURE_UNITS; unit++)
+	{
+		s_real.ActiveTexture(GL_TEXTURE0 + unit);
+		name = 0;
+		glGetIntegerv(GL_SAMPLER_BINDING, &name);
+		if (0 != name)
+		{
+			DefineSampler((GLuint)name);
+			Record(OP_BIND_SAMPLER, { unit, (GLuint)name });
+		}
+	}
+	s_real.ActiveTexture((GLenum)activeTexture);
+	Record(OP_ACTIVE_TEXTURE, { (GLenum)activeTexture });
+
+	for (GLuint unit = 0; unit < (GLuint)TRACE_IMAGE_UNITS; unit++)
+	{
+		GLint image[6] = { 0, 0, 0, 0, 0, 0 };
+		glGetIntegeri_v(GL_IMAGE_BINDING_NAME, unit, &image[0]);
+		if (0 == image[0])
+		{
+			continue;
+		}
+		glGetIntegeri_v(GL_IMAGE_BINDING_LEVEL, unit, &image[1]);
+		glGetIntegeri_v(GL_IMAGE_BINDING_LAYERED, unit, &image[2]);
+		glGetIntegeri_v(GL_IMAGE_BINDING_LAYER, unit, &image[3]);
+		glGetIntegeri_v(GL_IMAGE_BINDING_ACCESS, unit, &image[4]);
+		glGetIntegeri_v(GL_IMAGE_BINDING_FORMAT, unit, &image[5]);
+		DefineTexture((GLuint)image[0]);
+		Record(OP_BIND_IMAGE_TEXTURE, { unit, (GLuint)image[0], SignedArg(image[1]), (GLuint)image[2],
+			SignedArg(image[3]), (GLuint)image[4], (GLuint)image[5] });
+	}
+
+	GLint clipOrigin = GL_LOWER_LEFT;
+	GLint clipDepth = GL_NEGATIVE_ONE_TO_ONE;
+	glGetIntegerv(GL_CLIP_ORIGIN, &clipOrigin);
+	glGetIntegerv(GL_CLIP_DEPTH_MODE, &clipDepth);
+	Record(OP_CLIP_CONTROL, { (GLenum)clipOrigin, (GLenum)clipDepth });
+}
+
+/***********************************************************
+ *  QueryState()
+ *
+ *  This method is used for reading the fixed function state
+ *  the draws depend on, which the GL 1.1 calls setting it
+ *  cannot report as they are made.
+ ***********************************************************/
+void GLTrace::QueryState(TRACE_STATE& state)
+{
+	memset(&state, 0, sizeof(state));
+	for (int i = 0; i < STATE_ENABLES; i++)
+	{
+		state.enables[i] = (glIsEnabled(ENABLE_CAP_LIST[i]) == GL_TRUE) ? 1 : 0;
+	}
+	GLboolean depthMask = GL_TRUE;
+	GLboolean colorMask[4] = { GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE };
+	glGetBooleanv(GL_DEPTH_WRITEMASK, &depthMask);
+	glGetBooleanv(GL_COLOR_WRITEMASK, colorMask);
+	state.depthMask = depthMask;
+	for (int i = 0; i < 4; i++)
+	{
+		state.colorMask[i] = colorMask[i];
+	}
+	glGetIntegerv(GL_DEPTH_FUNC, &state.depthFunc);
+	glGetIntegerv(GL_CULL_FACE_MODE, &state.cullFace);
+	glGetIntegerv(GL_FRONT_FACE, &state.frontFace);
+	GLint polygonMode[2] = { GL_FILL, GL_FILL };
+	glGetIntegerv(GL_POLYGON_MODE, polygonMode);
+	state.polygonMode = polygonMode[0];
+	glGetIntegerv(GL_BLEND_EQUATION_RGB, &state.blendEquation[0]);
+	glGetIntegerv(GL_BLEND_EQUATION_ALPHA, &state.blendEquation[1]);
+	for (GLuint buffer = 0; buffer < (GLuint)STATE_DRAW_BUFFERS; buffer++)
+	{
+		glGetIntegeri_v(GL_BLEND_SRC_RGB, buffer, &state.blendFunc[buffer][0]);
+		glGetIntegeri_v(GL_BLEND_DST_RGB, buffer, &state.blendFunc[buffer][1]);
+		glGetIntegeri_v(GL_BLEND_SRC_ALPHA, buffer, &state.blendFunc[buffer][2]);
+		glGetIntegeri_v(GL_BLEND_DST_ALPHA, buffer, &state.blendFunc[buffer][3]);
+	}
+	glGetIntegerv(GL_VIEWPORT, state.viewport);
+	glGetIntegerv(GL_SCISSOR_BOX, state.scissor);
+	glGetFloatv(GL_POLYGON_OFFSET_FACTOR, &state.polygonOffset[0]);
+	glGetFloatv(GL_POLYGON_OFFSET_UNITS, &state.polygonOffset[1]);
+	glGetFloatv(GL_COLOR_CLEAR_VALUE, state.clearColor);
+	glGetFloatv(GL_DEPTH_CLEAR_VALUE, &state.clearDepth);
+	glGetFloatv(GL_BLEND_COLOR, state.blendColor);
+
+	glGetIntegerv(GL_ACTIVE_TEXTURE, &state.activeTexture);
+	for (int unit = 0; unit < STATE_TEXTURE_UNITS; unit++)
+	{
+		s_real.ActiveTexture(GL_TEXTURE0 + (GLenum)unit);
+		for (int target = 0; target < STATE_TEXTURE_TARGETS; target++)
+		{
+			GLint texture = 0;
+			glGetIntegerv(TEXTURE_BINDING_LIST[target], &texture);
+			state.textures[unit][target] = (GLuint)texture;
+		}
+	}
+	s_real.ActiveTexture((GLenum)state.activeTexture);
+}
+
+/***********************************************************
+ *  RecordState()
+ *
+ *  This method is used for recording the fixed function
+ *  state before a call that depends on it, when it changed
+ *  since the one before, defining the textures bound.
+ ***********************************************************/
+void GLTrace::RecordState()
+{
+	TRACE_STATE state;
+	QueryState(state);
+	if ((s_bStateRecorded == true) && (memcmp(&state, &s_state, sizeof(state)) == 0))
+	{
+		return;
+	}
+	for (int unit = 0; unit < STATE_TEXTURE_UNITS; unit++)
+	{
+		for (int target = 0; target < STATE_TEXTURE_TARGETS; target++)
+		{
+			DefineTexture(state.textures[unit][target]);
+		}
+	}
+	Record(OP_STATE, {}, &state, sizeof(state));
+	s_state = state;
+	s_bStateRecorded = true;
+	s_stats.stateChanges++;
+}
+
+/***********************************************************
+ *  MarkDefined()
+ *
+ *  This method is used for telling whether an object is yet
+ *  to be defined in the trace, marking it defined.
+ ***********************************************************/
+bool GLTrace::MarkDefined(int opcode, GLuint name)
+{
+	if (0 == name)
+	{
+		return(false);
+	}
+	bool bNew = s_defined.insert(((unsigned long long)opcode << 32) | name).second;
+	if (bNew == true)
+	{
+		s_stats.objects++;
+	}
+	return(bNew);
+}
+
+/***********************************************************
+ *  Forget()
+ *
+ *  This method is used for dropping deleted objects from
+ *  the trace, so an object later made under the same name
+ *  is defined again.
+ ***********************************************************/
+void GLTrace::Forget(int opcode, GLsizei count, const GLuint* pNames)
+{
+	if ((IsRecording() == false) || (NULL == pNames))
+	{
+		return;
+	}
+	for (GLsizei i = 0; i < count; i++)
+	{
+		s_defined.erase(((unsigned long long)opcode << 32) | pNames[i]);
+	}
+}
+
+/***********************************************************
+ *  DefineBuffer()
+ *
+ *  This method is used for defining a buffer with its size
+ *  and contents. A buffer mapped other than persistently
+ *  cannot be read, and is defined empty.
+ ***********************************************************/
+void GLTrace::DefineBuffer(GLuint buffer)
+{
+	if ((0 == buffer) || (glIsBuffer(buffer) == GL_FALSE) || (MarkDefined(OP_DEFINE_BUFFER, buffer) == false))
+	{
+		return;
+	}
+	GLint64 size = 0;
+	GLint mapped = GL_FALSE;
+	GLint accessFlags = 0;
+	glGetNamedBufferParameteri64v(buffer, GL_BUFFER_SIZE, &size);
+	glGetNamedBufferParameteriv(buffer, GL_BUFFER_MAPPED, &mapped);
+	glGetNamedBufferParameteriv(buffer, GL_BUFFER_ACCESS_FLAGS, &accessFlags);
+
+	std::vector<unsigned char> contents;
+	if ((size > 0) && ((mapped == GL_FALSE) || ((accessFlags & GL_MAP_PERSISTENT_BIT) != 0)))
+	{
+		contents.resize((size_t)size);
+		glGetNamedBufferSubData(buffer, 0, (GLsizeiptr)size, contents.data());
+	}
+	Record(OP_DEFINE_BUFFER, { buffer, SignedArg(size) }, contents.data(), contents.size());
+}
+
+/***********************************************************
+ *  DefineTexture()
+ *
+ *  This method is used for defining a texture with its
+ *  target, format, size, mip levels, parameters and the
+ *  contents of every level. A buffer texture is defined by
+ *  the range of its buffer, and a multisampled one without
+ *  contents, which cannot be read back.
+ ***********************************************************/
+void GLTrace::DefineTexture(GLuint texture)
+{
+	if ((0 == texture) || (glIsTexture(texture) == GL_FALSE) || (MarkDefined(OP_DEFINE_TEXTURE, texture) == false))
+	{
+		return;
+	}
+	GLint target = 0;
+	GLint internalFormat = 0;
+	glGetTextureParameteriv(texture, GL_TEXTURE_TARGET, &target);
+	glGetTextureLevelParameteriv(texture, 0, GL_TEXTURE_INTERNAL_FORMAT, &internalFormat);
+
+	if (target == GL_TEXTURE_BUFFER)
+	{
+		GLint buffer = 0;
+		GLint offset = 0;
+		GLint size = 0;
+		glGetTextureLevelParameteriv(texture, 0, GL_TEXTURE_BUFFER_DATA_STORE_BINDING, &buffer);
+		glGetTextureLevelParameteriv(texture, 0, GL_TEXTURE_BUFFER_OFFSET, &offset);
+		glGetTextureLevelParameteriv(texture, 0, GL_TEXTURE_BUFFER_SIZE, &size);
+		DefineBuffer((GLuint)buffer);
+		Record(OP_DEFINE_TEXTURE, { texture, (GLuint)target, (GLuint)internalFormat, 0, 0, 0, 0, 0, 0, GL_NONE, GL_NONE,
+			(GLuint)buffer, SignedArg(offset), SignedArg(size) });
+		return;
+	}
+
+	GLint width = 0;
+	GLint height = 0;
+	GLint depth = 0;
+	GLint samples = 0;
+	GLint compressed = GL_FALSE;
+	GLint immutable = GL_FALSE;
+	GLint levels = 0;
+	glGetTextureLevelParameteriv(texture, 0, GL_TEXTURE_WIDTH, &width);
+	glGetTextureLevelParameteriv(texture, 0, GL_TEXTURE_HEIGHT, &height);
+	glGetTextureLevelParameteriv(texture, 0, GL_TEXTURE_DEPTH, &depth);
+	glGetTextureLevelParameteriv(texture, 0, GL_TEXTURE_SAMPLES, &samples);
+	glGetTextureLevelParameteriv(texture, 0, GL_TEXTURE_COMPRESSED, &compressed);
+	glGetTextureParameteriv(texture, GL_TEXTURE_IMMUTABLE_FORMAT, &immutable);
+	if (immutable == GL_TRUE)
+	{
+		glGetTextureParameteriv(texture, GL_TEXTURE_IMMUTABLE_LEVELS, &levels);
+	}
+	else
+	{
+		// the levels of a mutable texture are those made so far
+		GLint levelWidth = width;
+		while ((levelWidth > 0) && (levels < 16))
+		{
+			levels++;
+			levelWidth = 0;
+			glGetTextureLevelParameteriv(texture, levels, GL_TEXTURE_WIDTH, &levelWidth);
+		}
+	}
+	// the faces of a cube map are read and written as layers
+	if (target == GL_TEXTURE_CUBE_MAP)
+	{
+		depth = 6;
+	}
+
+	std::vector<unsigned char> blob;
+	bool bMultisample = (target == GL_TEXTURE_2D_MULTISAMPLE) || (target == GL_TEXTURE_2D_MULTISAMPLE_ARRAY);
+	if (bMultisample == false)
+	{
+		const GLenum (*parameterLists[2])[2] = { SAMPLER_PARAMETERS, TEXTURE_ONLY_PARAMETERS };
+		const size_t parameterCounts[2] =
+		{
+			sizeof(SAMPLER_PARAMETERS) / sizeof(SAMPLER_PARAMETERS[0]),
+			sizeof(TEXTURE_ONLY_PARAMETERS) / sizeof(TEXTURE_ONLY_PARAMETERS[0])
+		};
+		PutU32(blob, (unsigned int)(parameterCounts[0] + parameterCounts[1]));
+		for (int list = 0; list < 2; list++)
+		{
+			for (size_t i = 0; i < parameterCounts[list]; i++)
+			{
+				GLenum pname = parameterLists[list][i][0];
+				GLenum bFloat = parameterLists[list][i][1];
+				unsigned int bits = 0;
+				if (bFloat == GL_TRUE)
+				{
+					GLfloat value = 0.0f;
+					glGetTextureParameterfv(texture, pname, &value);
+					bits = (unsigned int)FloatArg(value);
+				}
+				else
+				{
+					GLint value = 0;
+					glGetTextureParameteriv(texture, pname, &value);
+					bits = (unsigned int)value;
+				}
+				PutU32(blob, pname);
+				PutU32(blob, bFloat);
+				PutU32(blob, bits);
+			}
+		}
+	}
+	else
+	{
+		PutU32(blob, 0);
+	}
+
+	GLenum format = GL_NONE;
+	GLenum type = GL_NONE;
+	bool bReadable = (bMultisample == false) &&
+		((compressed == GL_TRUE) || (GetTransferFormat((GLenum)internalFormat, format, type) == true));
+	PutU32(blob, (bReadable == true) ? (unsigned int)levels : 0);
+	if (bReadable == true)
+	{
+		// read into memory, not a bound pixel buffer, tightly packed
+		GLint packBuffer = 0;
+		GLint packAlignment = 4;
+		glGetIntegerv(GL_PIXEL_PACK_BUFFER_BINDING, &packBuffer);
+		glGetIntegerv(GL_PACK_ALIGNMENT, &packAlignment);
+		s_real.BindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		glPixelStorei(GL_PACK_ALIGNMENT, 1);
+
+		std::vector<unsigned char> contents;
+		for (GLint level = 0; level < levels; level++)
+		{
+			GLint levelBytes = 0;
+			if (compressed == GL_TRUE)
+			{
+				glGetTextureLevelParameteriv(texture, level, GL_TEXTURE_COMPRESSED_IMAGE_SIZE, &levelBytes);
+				contents.resize((size_t)std::max(levelBytes, 0));
+				glGetCompressedTextureImage(texture, level, (GLsizei)contents.size(), contents.data());
+			}
+			else
+			{
+				GLint levelWidth = std::max(width >> level, 1);
+				GLint levelHeight = std::max(height >> level, 1);
+				GLint levelDepth = (target == GL_TEXTURE_3D) ? std::max(depth >> level, 1) : std::max(depth, 1);
+				levelBytes = levelWidth * levelHeight * levelDepth * GetPixelBytes(format, type);
+				contents.resize((size_t)levelBytes);
+				glGetTextureImage(texture, level, format, type, (GLsizei)contents.size(), contents.data());
+			}
+			PutBytes(blob, contents.data(), contents.size());
+		}
+
+		glPixelStorei(GL_PACK_ALIGNMENT, packAlignment);
+		s_real.BindBuffer(GL_PIXEL_PACK_BUFFER, (GLuint)packBuffer);
+	}
+
+	Record(OP_DEFINE_TEXTURE, { texture, (GLuint)target, (GLuint)internalFormat, SignedArg(levels),
+		SignedArg(width), SignedArg(height), SignedArg(depth), SignedArg(samples), (GLuint)compressed, format, type, 0, 0, 0 },
+		blob.data(), blob.size());
+}
+
+/***********************************************************
+ *  DefineRenderbuffer()
+ *
+ *  This method is used for defining a renderbuffer by its
+ *  format, size and samples; its contents are drawn.
+ ***********************************************************/
+void GLTrace::DefineRenderbuffer(GLuint renderbuffer)
+{
+	if ((0 == renderbuffer) || (glIsRenderbuffer(renderbuffer) == GL_FALSE) ||
+		(MarkDefined(OP_DEFINE_RENDERBUFFER, renderbuffer) == false))
+	{
+		return;
+	}
+	GLint internalFormat = 0;
+	GLint width = 0;
+	GLint height = 0;
+	GLint samples = 0;
+	glGetNamedRenderbufferParameteriv(renderbuffer, GL_RENDERBUFFER_INTERNAL_FORMAT, &internalFormat);
+	glGetNamedRenderbufferParameteriv(renderbuffer, GL_RENDERBUFFER_WIDTH, &width);
+	glGetNamedRenderbufferParameteriv(renderbuffer, GL_RENDERBUFFER_HEIGHT, &height);
+	glGetNamedRenderbufferParameteriv(renderbuffer, GL_RENDERBUFFER_SAMPLES, &samples);
+	Record(OP_DEFINE_RENDERBUFFER, { renderbuffer, (GLuint)internalFormat, SignedArg(width), SignedArg(height), SignedArg(samples) });
+}
+
+/***********************************************************
+ *  DefineFramebuffer()
+ *
+ *  This method is used for defining a framebuffer by the
+ *  textures and renderbuffers attached to it, defined
+ *  first, and its draw and read buffers. An attachment is
+ *  recorded with the layer it draws into, -1 for a whole
+ *  texture, and the views of a multiview one.
+ ***********************************************************/
+void GLTrace::DefineFramebuffer(GLuint framebuffer)
+{
+	if ((0 == framebuffer) || (glIsFramebuffer(framebuffer) == GL_FALSE) ||
+		(MarkDefined(OP_DEFINE_FRAMEBUFFER, framebuffer) == false))
+	{
+		return;
+	}
+
+	std::vector<GLenum> attachments;
+	for (GLenum i = 0; i < (GLenum)STATE_DRAW_BUFFERS; i++)
+	{
+		attachments.push_back(GL_COLOR_ATTACHMENT0 + i);
+	}
+	attachments.push_back(GL_DEPTH_ATTACHMENT);
+	attachments.push_back(GL_STENCIL_ATTACHMENT);
+
+	std::vector<unsigned char> blob;
+	unsigned int attached = 0;
+	std::vector<unsigned char> entries;
+	for (size_t i = 0; i < attachments.size(); i++)
+	{
+		GLint objectType = GL_NONE;
+		GLint name = 0;
+		glGetNamedFramebufferAttachmentParameteriv(framebuffer, attachments[i], GL_FRAMEBUFFER_ATTACHMENT_OBJECT_TYPE, &objectType);
+		if (objectType == GL_NONE)
+		{
+			continue;
+		}
+		glGetNamedFramebufferAttachmentParameteriv(framebuffer, attachments[i], GL_FRAMEBUFFER_ATTACHMENT_OBJECT_NAME, &name);
+		GLint level = 0;
+		GLint layer = -1;
+		GLint views = 0;
+		GLint baseView = 0;
+		if (objectType == GL_TEXTURE)
+		{
+			DefineTexture((GLuint)name);
+			GLint layered = GL_FALSE;
+			GLint target = 0;
+			glGetNamedFramebufferAttachmentParameteriv(framebuffer, attachments[i], GL_FRAMEBUFFER_ATTACHMENT_TEXTURE_LEVEL, &level);
+			glGetNamedFramebufferAttachmentParameteriv(framebuffer, attachments[i], GL_FRAMEBUFFER_ATTACHMENT_LAYERED, &layered);
+			glGetTextureParameteriv((GLuint)name, GL_TEXTURE_TARGET, &target);
+			if (GLEW_OVR_multiview == GL_TRUE)
+			{
+				glGetNamedFramebufferAttachmentParameteriv(framebuffer, attachments[i],
+					GL_FRAMEBUFFER_ATTACHMENT_TEXTURE_NUM_VIEWS_OVR, &views);
+				glGetNamedFramebufferAttachmentParameteriv(framebuffer, attachments[i],
+					GL_FRAMEBUFFER_ATTACHMENT_TEXTURE_BASE_VIEW_INDEX_OVR, &baseView);
+			}
+			// a single layer of an array, or a face of a cube map
+			if ((layered == GL_FALSE) && (views == 0))
+			{
+				if (target == GL_TEXTURE_CUBE_MAP)
+				{
+					GLint face = GL_TEXTURE_CUBE_MAP_POSITIVE_X;
+					glGetNamedFramebufferAttachmentParameteriv(framebuffer, attachments[i],
+						GL_FRAMEBUFFER_ATTACHMENT_TEXTURE_CUBE_MAP_FACE, &face);
+					layer = face - GL_TEXTURE_CUBE_MAP_POSITIVE_X;
+				}
+				else if ((target == GL_TEXTURE_2D_ARRAY) || (target == GL_TEXTURE_3D) ||
+					(target == GL_TEXTURE_CUBE_MAP_ARRAY) || (target == GL_TEXTURE_2D_MULTISAMPLE_ARRAY))
+				{
+					glGetNamedFramebufferAttachmentParameteriv(framebuffer, attachments[i],
+						GL_FRAMEBUFFER_ATTACHMENT_TEXTURE_LAYER, &layer);
+				}
+			}
+		}
+		else
+		{
+			DefineRenderbuffer((GLuint)name);
+		}
+		PutU32(entries, attachments[i]);
+		PutU32(entries, (unsigned int)objectType);
+		PutU32(entries, (unsigned int)name);
+		PutU32(entries, (unsigned int)level);
+		PutU32(entries, (unsigned int)layer);
+		PutU32(entries, (unsigned int)views);
+		PutU32(entries, (unsigned int)baseView);
+		attached++;
+	}
+	PutU32(blob, attached);
+	blob.insert(blob.end(), entries.begin(), entries.end());
+	for (GLenum i = 0; i < (GLenum)STATE_DRAW_BUFFERS; i++)
+	{
+		GLint drawBuffer = GL_NONE;
+		glGetNamedFramebufferParameteriv(framebuffer, GL_DRAW_BUFFER0 + i, &drawBuffer);
+		PutU32(blob, (unsigned int)drawBuffer);
+	}
+	GLint readBuffer = GL_NONE;
+	glGetNamedFramebufferParameteriv(framebuffer, GL_READ_BUFFER, &readBuffer);
+	PutU32(blob, (unsigned int)readBuffer);
+
+	Record(OP_DEFINE_FRAMEBUFFER, { framebuffer }, blob.data(), blob.size());
+}
+
+/***********************************************************
+ *  DefineVertexArray()
+ *
+ *  This method is used for defining a vertex array by its
+ *  element buffer, attribute formats and vertex buffer
+ *  bindings. The bindings can only be read from a bound
+ *  vertex array, so it is bound for the queries and the
+ *  one bound before is restored.
+ ***********************************************************/
+void GLTrace::DefineVertexArray(GLuint vertexArray)
+{
+	if ((0 == vertexArray) || (glIsVertexArray(vertexArray) == GL_FALSE) ||
+		(MarkDefined(OP_DEFINE_VERTEX_ARRAY, vertexArray) == false))
+	{
+		return;
+	}
+	GLint boundVertexArray = 0;
+	glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &boundVertexArray);
+	s_real.BindVertexArray(vertexArray);
+
+	std::vector<unsigned char> blob;
+	GLint elementBuffer = 0;
+	glGetIntegerv(GL_ELEMENT_ARRAY_BUFFER_BINDING, &elementBuffer);
+	DefineBuffer((GLuint)elementBuffer);
+	PutU32(blob, (unsigned int)elementBuffer);
+	const GLenum attribParameters[] =
+	{
+		GL_VERTEX_ATTRIB_ARRAY_ENABLED, GL_VERTEX_ATTRIB_ARRAY_SIZE, GL_VERTEX_ATTRIB_ARRAY_TYPE,
+		GL_VERTEX_ATTRIB_ARRAY_NORMALIZED, GL_VERTEX_ATTRIB_ARRAY_INTEGER, GL_VERTEX_ATTRIB_ARRAY_LONG,
+		GL_VERTEX_ATTRIB_RELATIVE_OFFSET, GL_VERTEX_ATTRIB_BINDING
+	};
+	for (GLuint attrib = 0; attrib < (GLuint)TRACE_VERTEX_ATTRIBS; attrib++)
+	{
+		for (size_t i = 0; i < sizeof(attribParameters) / sizeof(attribParameters[0]); i++)
+		{
+			GLint value = 0;
+			glGetVertexAttribiv(attrib, attribParameters[i], &value);
+			PutU32(blob, (unsigned int)value);
+		}
+	}
+	for (GLuint binding = 0; binding < (GLuint)TRACE_VERTEX_ATTRIBS; binding++)
+	{
+		GLint buffer = 0;
+		GLint stride = 0;
+		GLint divisor = 0;
+		GLint64 offset = 0;
+		glGetIntegeri_v(GL_VERTEX_BINDING_BUFFER, binding, &buffer);
+		glGetIntegeri_v(GL_VERTEX_BINDING_STRIDE, binding, &stride);
+		glGetIntegeri_v(GL_VERTEX_BINDING_DIVISOR, binding, &divisor);
+		glGetInteger64i_v(GL_VERTEX_BINDING_OFFSET, binding, &offset);
+		DefineBuffer((GLuint)buffer);
+		PutU32(blob, (unsigned int)buffer);
+		PutU64(blob, (unsigned long long)offset);
+		PutU32(blob, (unsigned int)stride);
+		PutU32(blob, (unsigned int)divisor);
+	}
+
+	s_real.BindVertexArray((GLuint)boundVertexArray);
+	Record(OP_DEFINE_VERTEX_ARRAY, { vertexArray }, blob.data(), blob.size());
+}
+
+/***********************************************************
+ *  DefineSampler()
+ *
+ *  This method is used for defining a sampler by its
+ *  filtering, wrapping and comparison parameters.
+ ***********************************************************/
+void GLTrace::DefineSampler(GLuint sampler)
+{
+	if ((0 == sampler) || (glIsSampler(sampler) == GL_FALSE) || (MarkDefined(OP_DEFINE_SAMPLER, sampler) == false))
+	{
+		return;
+	}
+	std::vector<unsigned char> blob;
+	size_t parameterCount = sizeof(SAMPLER_PARAMETERS) / sizeof(SAMPLER_PARAMETERS[0]);
+	PutU32(blob, (unsigned int)parameterCount);
+	for (size_t i = 0; i < parameterCount; i++)
+	{
+		unsigned int bits = 0;
+		if (SAMPLER_PARAMETERS[i][1] == GL_TRUE)
+		{
+			GLfloat value = 0.0f;
+			glGetSamplerParameterfv(sampler, SAMPLER_PARAMETERS[i][0], &value);
+			bits = (unsigned int)FloatArg(value);
+		}
+		else
+		{
+			GLint value = 0;
+			glGetSamplerParameteriv(sampler, SAMPLER_PARAMETERS[i][0], &value);
+			bits = (unsigned int)value;
+		}
+		PutU32(blob, SAMPLER_PARAMETERS[i][0]);
+		PutU32(blob, SAMPLER_PARAMETERS[i][1]);
+		PutU32(blob, bits);
+	}
+	Record(OP_DEFINE_SAMPLER, { sampler }, blob.data(), blob.size());
+}
+
+/***********************************************************
+ *  DefineProgram()
+ *
+ *  This method is used for defining a program by the shader
+ *  sources it was linked from, or its binary when it was
+ *  loaded from one, with the values of its uniforms and the
+ *  bindings of its blocks, all by name, since the locations
+ *  and indices another driver assigns may differ.
+ ***********************************************************/
+void GLTrace::DefineProgram(GLuint program)
+{
+	if ((0 == program) || (glIsProgram(program) == GL_FALSE) || (MarkDefined(OP_DEFINE_PROGRAM, program) == false))
+	{
+		return;
+	}
+	PROGRAM_SOURCE source;
+	source.binaryFormat = GL_NONE;
+	{
+		std::lock_guard<std::mutex> lock(s_sourceMutex);
+		std::map<GLuint, PROGRAM_SOURCE>::const_iterator found = s_programSources.find(program);
+		if (found != s_programSources.end())
+		{
+			source = found->second;
+		}
+	}
+	// a program built before the hooks has only its binary
+	if ((source.sources.empty() == true) && (source.binary.empty() == true))
+	{
+		GLint binaryLength = 0;
+		glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &binaryLength);
+		if (binaryLength > 0)
+		{
+			source.binary.resize((size_t)binaryLength);
+			glGetProgramBinary(program, binaryLength, NULL, &source.binaryFormat, source.binary.data());
+		}
+		else
+		{
+			std::cout << "GL trace has no source or binary of program " << program << std::endl;
+		}
+	}
+
+	std::vector<unsigned char> blob;
+	PutU32(blob, (unsigned int)source.sources.size());
+	for (size_t i = 0; i < source.sources.size(); i++)
+	{
+		PutU32(blob, source.shaderTypes[i]);
+		PutString(blob, source.sources[i]);
+	}
+	PutU32(blob, source.binaryFormat);
+	PutBytes(blob, source.binary.data(), source.binary.size());
+
+	// every element of the uniforms outside blocks, with its value
+	GLint uniformCount = 0;
+	glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &uniformCount);
+	std::vector<unsigned char> uniforms;
+	unsigned int elementCount = 0;
+	for (GLint i = 0; i < uniformCount; i++)
+	{
+		char name[MAX_NAME_LENGTH];
+		GLsizei length = 0;
+		GLint size = 0;
+		GLenum type = GL_NONE;
+		glGetActiveUniform(program, (GLuint)i, MAX_NAME_LENGTH, &length, &size, &type, name);
+		GLenum baseType = GL_NONE;
+		int components = GetUniformComponents(type, baseType);
+		if (components == 0)
+		{
+			continue;
+		}
+		std::string baseName(name, (size_t)length);
+		if ((baseName.size() > 3) && (baseName.compare(baseName.size() - 3, 3, "[0]") == 0))
+		{
+			baseName.resize(baseName.size() - 3);
+		}
+		for (GLint element = 0; element < size; element++)
+		{
+			std::string elementName = (size > 1) ? baseName + "[" + std::to_string(element) + "]" : baseName;
+			GLint location = glGetUniformLocation(program, elementName.c_str());
+			if (location < 0)
+			{
+				continue;
+			}
+			unsigned int values[16] = {};
+			if (baseType == GL_FLOAT)
+			{
+				glGetUniformfv(program, location, (GLfloat*)values);
+			}
+			else if (baseType == GL_INT)
+			{
+				glGetUniformiv(program, location, (GLint*)values);
+			}
+			else
+			{
+				glGetUniformuiv(program, location, (GLuint*)values);
+			}
+			PutString(uniforms, elementName);
+			PutU32(uniforms, (unsigned int)location);
+			PutU32(uniforms, type);
+			for (int c = 0; c < components; c++)
+			{
+				PutU32(uniforms, values[c]);
+			}
+			elementCount++;
+		}
+	}
+	PutU32(blob, elementCount);
+	blob.insert(blob.end(), uniforms.begin(), uniforms.end());
+
+	GLint blockCount = 0;
+	glGetProgramiv(program, GL_ACTIVE_UNIFORM_BLOCKS, &blockCount);
+	PutU32(blob, (unsigned int)blockCount);
+	for (GLint i = 0; i < blockCount; i++)
+	{
+		char name[MAX_NAME_LENGTH];
+		GLsizei length = 0;
+		GLint binding = 0;
+		glGetActiveUniformBlockName(program, (GLuint)i, MAX_NAME_LENGTH, &length, name);
+		glGetActiveUniformBlockiv(program, (GLuint)i, GL_UNIFORM_BLOCK_BINDING, &binding);
+		PutString(blob, std::string(name, (size_t)length));
+		PutU32(blob, (unsigned int)binding);
+	}
+	GLint storageBlockCount = 0;
+	glGetProgramInterfaceiv(program, GL_SHADER_STORAGE_BLOCK, GL_ACTIVE_RESOURCES, &storageBlockCount);
+	PutU32(blob, (unsigned int)storageBlockCount);
+	for (GLint i = 0; i < storageBlockCount; i++)
+	{
+		char name[MAX_NAME_LENGTH];
+		GLsizei length = 0;
+		GLint binding = 0;
+		const GLenum property = GL_BUFFER_BINDING;
+		glGetProgramResourceName(program, GL_SHADER_STORAGE_BLOCK, (GLuint)i, MAX_NAME_LENGTH, &length, name);
+		glGetProgramResourceiv(program, GL_SHADER_STORAGE_BLOCK, (GLuint)i, 1, &property, 1, NULL, &binding);
+		PutString(blob, std::string(name, (size_t)length));
+		PutU32(blob, (unsigned int)binding);
+	}
+
+	Record(OP_DEFINE_PROGRAM, { program }, blob.data(), blob.size());
+}
+
+/***********************************************************
+ *  RecordClear()
+ *
+ *  This method is used for recording a glClear() call and
+ *  the state it clears with.
+ ***********************************************************/
+void GLTrace::RecordClear(GLbitfield mask)
+{
+	if (IsRecording() == true)
+	{
+		RecordState();
+		Record(OP_CLEAR, { mask });
+	}
+}
+
+/***********************************************************
+ *  RecordDrawArrays()
+ *
+ *  This method is used for recording a glDrawArrays() call
+ *  and the state it draws with.
+ ***********************************************************/
+void GLTrace::RecordDrawArrays(GLenum mode, GLint first, GLsizei count)
+{
+	if (IsRecording() == true)
+	{
+		RecordState();
+		Record(OP_DRAW_ARRAYS, { mode, SignedArg(first), SignedArg(count) });
+	}
+}
+
+/***********************************************************
+ *  RecordCopyTexSubImage2D()
+ *
+ *  This method is used for recording a copy from the read
+ *  framebuffer into the texture bound to the active unit.
+ ***********************************************************/
+void GLTrace::RecordCopyTexSubImage2D(GLenum target, GLint level, GLint xoffset, GLint yoffset,
+	GLint x, GLint y, GLsizei width, GLsizei height)
+{
+	if (IsRecording() == true)
+	{
+		RecordState();
+		Record(OP_COPY_TEX_SUB_IMAGE_2D, { target, SignedArg(level), SignedArg(xoffset), SignedArg(yoffset),
+			SignedArg(x), SignedArg(y), SignedArg(width), SignedArg(height) });
+	}
+}
+
+/***********************************************************
+ *  RecordBufferWrite()
+ *
+ *  This method is used for recording the bytes written into
+ *  a persistently mapped buffer, which the replay writes
+ *  with glNamedBufferSubData().
+ ***********************************************************/
+void GLTrace::RecordBufferWrite(GLuint buffer, GLintptr offset, GLsizeiptr size, const void* pData)
+{
+	if ((IsRecording() == true) && (size > 0))
+	{
+		DefineBuffer(buffer);
+		Record(OP_BUFFER_WRITE, { buffer, SignedArg(offset), SignedArg(size) }, pData, (size_t)size);
+	}
+}
+
+/***********************************************************
+ *  GetStateEnable()
+ *
+ *  This method is used for getting the capability of a slot
+ *  of the recorded enables.
+ ***********************************************************/
+GLenum GLTrace::GetStateEnable(int index)
+{
+	return(((index >= 0) && (index < STATE_ENABLES)) ? ENABLE_CAP_LIST[index] : GL_NONE);
+}
+
+/***********************************************************
+ *  GetStateTextureTarget()
+ *
+ *  This method is used for getting the texture target of a
+ *  slot of the recorded texture bindings.
+ ***********************************************************/
+GLenum GLTrace::GetStateTextureTarget(int index)
+{
+	return(((index >= 0) && (index < STATE_TEXTURE_TARGETS)) ? TEXTURE_TARGET_LIST[index] : GL_NONE);
+}
+
+/***********************************************************
+ *  GetOpcodeName()
+ *
+ *  This method is used for getting the GL call or the kind
+ *  of record of an opcode, for the replay's timings.
+ ***********************************************************/
+const char* GLTrace::GetOpcodeName(int opcode)
+{
+	return(((opcode >= 0) && (opcode < OP_COUNT)) ? OPCODE_NAMES[opcode] : "unknown");
+}
+
+/***********************************************************
+ *  GetPixelBytes()
+ *
+ *  This method is used for getting the bytes of a pixel of
+ *  a format and type, counting the packed types whole.
+ ***********************************************************/
+int GLTrace::GetPixelBytes(GLenum format, GLenum type)
+{
+	switch (type)
+	{
+	case GL_UNSIGNED_INT_24_8:
+	case GL_UNSIGNED_INT_10F_11F_11F_REV:
+	case GL_UNSIGNED_INT_2_10_10_10_REV:
+	case GL_UNSIGNED_INT_5_9_9_9_REV:
+		return(4);
+	case GL_FLOAT_32_UNSIGNED_INT_24_8_REV:
+		return(8);
+	case GL_UNSIGNED_SHORT_5_6_5:
+	case GL_UNSIGNED_SHORT_4_4_4_4:
+	case GL_UNSIGNED_SHORT_5_5_5_1:
+		return(2);
+	default:
+		break;
+	}
+
+	int components = 1;
+	switch (format)
+	{
+	case GL_RG:
+	case GL_RG_INTEGER:
+		components = 2;
+		break;
+	case GL_RGB:
+	case GL_BGR:
+	case GL_RGB_INTEGER:
+		components = 3;
+		break;
+	case GL_RGBA:
+	case GL_BGRA:
+	case GL_RGBA_INTEGER:
+		components = 4;
+		break;
+	default:
+		break;
+	}
+	int componentBytes = 4;
+	switch (type)
+	{
+	case GL_UNSIGNED_BYTE:
+	case GL_BYTE:
+		componentBytes = 1;
+		break;
+	case GL_UNSIGNED_SHORT:
+	case GL_SHORT:
+	case GL_HALF_FLOAT:
+		componentBytes = 2;
+		break;
+	default:
+		break;
+	}
+	return(components * componentBytes);
+}
+
+/***********************************************************
+ *  GetUniformComponents()
+ *
+ *  This method is used for getting the values in a uniform
+ *  of a type and the type they are read and set as. The
+ *  samplers and images hold the unit they read.
+ ***********************************************************/
+int GLTrace::GetUniformComponents(GLenum type, GLenum& baseType)
+{
+	baseType = GL_FLOAT;
+	switch (type)
+	{
+	case GL_FLOAT:
+		return(1);
+	case GL_FLOAT_VEC2:
+		return(2);
+	case GL_FLOAT_VEC3:
+		return(3);
+	case GL_FLOAT_VEC4:
+	case GL_FLOAT_MAT2:
+		return(4);
+	case GL_FLOAT_MAT2x3:
+	case GL_FLOAT_MAT3x2:
+		return(6);
+	case GL_FLOAT_MAT2x4:
+	case GL_FLOAT_MAT4x2:
+		return(8);
+	case GL_FLOAT_MAT3:
+		return(9);
+	case GL_FLOAT_MAT3x4:
+	case GL_FLOAT_MAT4x3:
+		return(12);
+	case GL_FLOAT_MAT4:
+		return(16);
+	default:
+		break;
+	}
+
+	baseType = GL_UNSIGNED_INT;
+	switch (type)
+	{
+	case GL_UNSIGNED_INT:
+		return(1);
+	case GL_UNSIGNED_INT_VEC2:
+		return(2);
+	case GL_UNSIGNED_INT_VEC3:
+		return(3);
+	case GL_UNSIGNED_INT_VEC4:
+		return(4);
+	default:
+		break;
+	}
+
+	baseType = GL_INT;
+	switch (type)
+	{
+	case GL_INT:
+	case GL_BOOL:
+		return(1);
+	case GL_INT_VEC2:
+	case GL_BOOL_VEC2:
+		return(2);
+	case GL_INT_VEC3:
+	case GL_BOOL_VEC3:
+		return(3);
+	case GL_INT_VEC4:
+	case GL_BOOL_VEC4:
+		return(4);
+	case GL_SAMPLER_2D:
+	case GL_SAMPLER_3D:
+	case GL_SAMPLER_CUBE:
+	case GL_SAMPLER_2D_SHADOW:
+	case GL_SAMPLER_2D_ARRAY:
+	case GL_SAMPLER_2D_ARRAY_SHADOW:
+	case GL_SAMPLER_CUBE_SHADOW:
+	case GL_SAMPLER_BUFFER:
+	case GL_SAMPLER_2D_MULTISAMPLE:
+	case GL_INT_SAMPLER_2D:
+	case GL_INT_SAMPLER_BUFFER:
+	case GL_UNSIGNED_INT_SAMPLER_2D:
+	case GL_UNSIGNED_INT_SAMPLER_2D_ARRAY:
+	case GL_UNSIGNED_INT_SAMPLER_BUFFER:
+	case GL_IMAGE_2D:
+	case GL_IMAGE_3D:
+	case GL_IMAGE_2D_ARRAY:
+	case GL_IMAGE_BUFFER:
+	case GL_INT_IMAGE_2D:
+	case GL_UNSIGNED_INT_IMAGE_2D:
+	case GL_UNSIGNED_INT_IMAGE_3D:
+	case GL_UNSIGNED_INT_IMAGE_BUFFER:
+		return(1);
+	default:
+		break;
+	}
+
+	baseType = GL_NONE;
+	return(0);
+}
+
+/***********************************************************
+ *  Print()
+ *
+ *  This method is used for printing what the capture wrote.
+ ***********************************************************/
+void GLTrace::Print()
+{
+	if (s_bInstalled == false)
+	{
+		return;
+	}
+	std::cout << "\n*** GL TRACE: ***\n";
+	std::cout << "file " << s_filename
+		<< "\tframes " << s_stats.frames << " of " << (s_firstFrame) << " + " << std::max(s_frameCount, s_stats.frames) << "\n";
+	std::cout << "calls " << s_stats.calls
+		<< "\tstate changes " << s_stats.stateChanges
+		<< "\tobjects " << s_stats.objects
+		<< "\t" << (s_stats.bytes / (1024 * 1024)) << " MB\n";
+}
+
+// the hooks: each records its call, defining the objects it
+// names first, while the frames are captured, then makes it;
+// the calls that draw, clear or copy record the state first
+
+void GLAPIENTRY GLTrace::HookBindBuffer(GLenum target, GLuint buffer)
+{
+	if (IsRecording() == true)
+	{
+		DefineBuffer(buffer);
+		Record(OP_BIND_BUFFER, { target, buffer });
+	}
+	s_real.BindBuffer(target, buffer);
+}
+
+void GLAPIENTRY GLTrace::HookBindBufferBase(GLenum target, GLuint index, GLuint buffer)
+{
+	if (IsRecording() == true)
+	{
+		DefineBuffer(buffer);
+		Record(OP_BIND_BUFFER_BASE, { target, index, buffer });
+	}
+	s_real.BindBufferBase(target, index, buffer);
+}
+
+void GLAPIENTRY GLTrace::HookBindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size)
+{
+	if (IsRecording() == true)
+	{
+		DefineBuffer(buffer);
+		Record(OP_BIND_BUFFER_RANGE, { target, index, buffer, SignedArg(offset), SignedArg(size) });
+	}
+	s_real.BindBufferRange(target, index, buffer, offset, size);
+}
+
+void GLAPIENTRY GLTrace::HookBufferData(GLenum target, GLsizeiptr size, const void* pData, GLenum usage)
+{
+	if (IsRecording() == true)
+	{
+		Record(OP_BUFFER_DATA, { target, SignedArg(size), usage }, pData, (size_t)size);
+	}
+	s_real.BufferData(target, size, pData, usage);
+}
+
+void GLAPIENTRY GLTrace::HookBufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const void* pData)
+{
+	if (IsRecording() == true)
+	{
+		Record(OP_BUFFER_SUB_DATA, { target, SignedArg(offset), SignedArg(size) }, pData, (size_t)size);
+	}
+	s_real.BufferSubData(target, offset, size, pData);
+}
+
+void GLAPIENTRY GLTrace::HookClearBufferData(GLenum target, GLenum internalFormat, GLenum format, GLenum type, const void* pData)
+{
+	if (IsRecording() == true)
+	{
+		Record(OP_CLEAR_BUFFER_DATA, { target, internalFormat, format, type }, pData, (size_t)GetPixelBytes(format, type));
+	}
+	s_real.ClearBufferData(target, internalFormat, format, type, pData);
+}
+
+void GLAPIENTRY GLTrace::HookUseProgram(GLuint program)
+{
+	if (IsRecording() == true)
+	{
+		DefineProgram(program);
+		Record(OP_USE_PROGRAM, { program });
+	}
+	s_real.UseProgram(program);
+}
+
+void GLAPIENTRY GLTrace::HookUniform1i(GLint location, GLint v0)
+{
+	if (IsRecording() == true)
+	{
+		Record(OP_UNIFORM_1I, { SignedArg(location), SignedArg(v0) });
+	}
+	s_real.Uniform1i(location, v0);
+}
+
+void GLAPIENTRY GLTrace::HookUniform1ui(GLint location, GLuint v0)
+{
+	if (IsRecording() == true)
+	{
+		Record(OP_UNIFORM_1UI, { SignedArg(location), v0 });
+	}
+	s_real.Uniform1ui(location, v0);
+}
+
+void GLAPIENTRY GLTrace::HookUniform2ui(GLint location, GLuint v0, GLuint v1)
+{
+	if (IsRecording() == true)
+	{
+		Record(OP_UNIFORM_2UI, { SignedArg(location), v0, v1 });
+	}
+	s_real.Uniform2ui(location, v0, v1);
+}
+
+void GLAPIENTRY GLTrace::HookUniform1f(GLint location, GLfloat v0)
+{
+	if (IsRecording() == true)
+	{
+		Record(OP_UNIFORM_1F, { SignedArg(location), FloatArg(v0) });
+	}
+	s_real.Uniform1f(location, v0);
+}
+
+void GLAPIENTRY GLTrace::HookUniform2f(GLint location, GLfloat v0, GLfloat v1)
+{
+	if (IsRecording() == true)
+	{
+		Record(OP_UNIFORM_2F, { SignedArg(location), FloatArg(v0), FloatArg(v1) });
+	}
+	s_real.Uniform2f(location, v0, v1);
+}
+
+void GLAPIENTRY GLTrace::HookUniform3f(GLint location, GLfloat v0, GLfloat v1, GLfloat v2)
+{
+	if (IsRecording() == true)
+	{
+		Record(OP_UNIFORM_3F, { SignedArg(location), FloatArg(v0), FloatArg(v1), FloatArg(v2) });
+	}
+	s_real.Uniform3f(location, v0, v1, v2);
+}
+
+void GLAPIENTRY GLTrace::HookUniform4f(GLint location, GLfloat v0, GLfloat v1, GLfloat v2, GLfloat v3)
+{
+	if (IsRecording() == true)
+	{
+		Record(OP_UNIFORM_4F, { SignedArg(location), FloatArg(v0), FloatArg(v1), FloatArg(v2), FloatArg(v3) });
+	}
+	s_real.Uniform4f(location, v0, v1, v2, v3);
+}
+
+void GLAPIENTRY GLTrace::HookUniform2fv(GLint location, GLsizei count, const GLfloat* pValues)
+{
+	if (IsRecording() == true)
+	{
+		Record(OP_UNIFORM_FV, { 2, SignedArg(location), SignedArg(count) }, pValues, (size_t)count * 2 * sizeof(GLfloat));
+	}
+	s_real.Uniform2fv(location, count, pValues);
+}
+
+void GLAPIENTRY GLTrace::HookUniform3fv(GLint location, GLsizei count, const GLfloat* pValues)
+{
+	if (IsRecording() == true)
+	{
+		Record(OP_UNIFORM_FV, { 3, SignedArg(location), SignedArg(count) }, pValues, (size_t)count * 3 * sizeof(GLfloat));
+	}
+	s_real.Uniform3fv(location, count, pValues);
+}
+
+void GLAPIENTRY GLTrace::HookUniform4fv(GLint location, GLsizei count, const GLfloat* pValues)
+{
+	if (IsRecording() == true)
+	{
+		Record(OP_UNIFORM_FV, { 4, SignedArg(location), SignedArg(count) }, pValues, (size_t)count * 4 * sizeof(GLfloat));
+	}
+	s_real.Uniform4fv(location, count, pValues);
+}
+
+void GLAPIENTRY GLTrace::HookUniformMatrix2fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat* pValues)
+{
+	if (IsRecording() == true)
+	{
+		Record(OP_UNIFORM_MATRIX_FV, { 2, SignedArg(location), SignedArg(count), transpose },
+			pValues, (size_t)count * 4 * sizeof(GLfloat));
+	}
+	s_real.UniformMatrix2fv(location, count, transpose, pValues);
+}
+
+void GLAPIENTRY GLTrace::HookUniformMatrix3fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat* pValues)
+{
+	if (IsRecording() == true)
+	{
+		Record(OP_UNIFORM_MATRIX_FV, { 3, SignedArg(location), SignedArg(count), transpose },
+			pValues, (size_t)count * 9 * sizeof(GLfloat));
+	}
+	s_real.UniformMatrix3fv(location, count, transpose, pValues);
+}
+
+void GLAPIENTRY GLTrace::HookUniformMatrix4fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat* pValues)
+{
+	if (IsRecording() == true)
+	{
+		Record(OP_UNIFORM_MATRIX_FV, { 4, SignedArg(location), SignedArg(count), transpose },
+			pValues, (size_t)count * 16 * sizeof(GLfloat));
+	}
+	s_real.UniformMatrix4fv(location, count, transpose, pValues);
+}
+
+void GLAPIENTRY GLTrace::HookUniformBlockBinding(GLuint program, GLuint blockIndex, GLuint binding)
+{
+	if (IsRecording() == true)
+	{
+		// by the name of the block, whose index may differ
+		char name[MAX_NAME_LENGTH];
+		GLsizei length = 0;
+		glGetActiveUniformBlockName(program, blockIndex, MAX_NAME_LENGTH, &length, name);
+		DefineProgram(program);
+		Record(OP_UNIFORM_BLOCK_BINDING, { program, binding }, name, (size_t)length);
+	}
+	s_real.UniformBlockBinding(program, blockIndex, binding);
+}
+
+void GLAPIENTRY GLTrace::HookBindVertexArray(GLuint vertexArray)
+{
+	if (IsRecording() == true)
+	{
+		DefineVertexArray(vertexArray);
+		Record(OP_BIND_VERTEX_ARRAY, { vertexArray });
+	}
+	s_real.BindVertexArray(vertexArray);
+}
+
+void GLAPIENTRY GLTrace::HookBindVertexBuffer(GLuint bindingIndex, GLuint buffer, GLintptr offset, GLsizei stride)
+{
+	if (IsRecording() == true)
+	{
+		DefineBuffer(buffer);
+		Record(OP_BIND_VERTEX_BUFFER, { bindingIndex, buffer, SignedArg(offset), SignedArg(stride) });
+	}
+	s_real.BindVertexBuffer(bindingIndex, buffer, offset, stride);
+}
+
+void GLAPIENTRY GLTrace::HookBindFramebuffer(GLenum target, GLuint framebuffer)
+{
+	if (IsRecording() == true)
+	{
+		DefineFramebuffer(framebuffer);
+		Record(OP_BIND_FRAMEBUFFER, { target, framebuffer });
+	}
+	s_real.BindFramebuffer(target, framebuffer);
+}
+
+void GLAPIENTRY GLTrace::HookDrawBuffers(GLsizei count, const GLenum* pBuffers)
+{
+	if (IsRecording() == true)
+	{
+		Record(OP_DRAW_BUFFERS, { SignedArg(count) }, pBuffers, (size_t)count * sizeof(GLenum));
+	}
+	s_real.DrawBuffers(count, pBuffers);
+}
+
+void GLAPIENTRY GLTrace::HookBlitFramebuffer(GLint srcX0, GLint srcY0, GLint srcX1, GLint srcY1,
+	GLint dstX0, GLint dstY0, GLint dstX1, GLint dstY1, GLbitfield mask, GLenum filter)
+{
+	if (IsRecording() == true)
+	{
+		RecordState();
+		Record(OP_BLIT_FRAMEBUFFER, { SignedArg(srcX0), SignedArg(srcY0), SignedArg(srcX1), SignedArg(srcY1),
+			SignedArg(dstX0), SignedArg(dstY0), SignedArg(dstX1), SignedArg(dstY1), mask, filter });
+	}
+	s_real.BlitFramebuffer(srcX0, srcY0, srcX1, srcY1, dstX0, dstY0, dstX1, dstY1, mask, filter);
+}
+
+void GLAPIENTRY GLTrace::HookClearBufferfv(GLenum buffer, GLint drawBuffer, const GLfloat* pValue)
+{
+	if (IsRecording() == true)
+	{
+		RecordState();
+		size_t values = (buffer == GL_COLOR) ? 4 : 1;
+		Record(OP_CLEAR_BUFFER_FV, { buffer, SignedArg(drawBuffer) }, pValue, values * sizeof(GLfloat));
+	}
+	s_real.ClearBufferfv(buffer, drawBuffer, pValue);
+}
+
+void GLAPIENTRY GLTrace::HookClearBufferuiv(GLenum buffer, GLint drawBuffer, const GLuint* pValue)
+{
+	if (IsRecording() == true)
+	{
+		RecordState();
+		Record(OP_CLEAR_BUFFER_UIV, { buffer, SignedArg(drawBuffer) }, pValue, 4 * sizeof(GLuint));
+	}
+	s_real.ClearBufferuiv(buffer, drawBuffer, pValue);
+}
+
+void GLAPIENTRY GLTrace::HookActiveTexture(GLenum texture)
+{
+	if (IsRecording() == true)
+	{
+		Record(OP_ACTIVE_TEXTURE, { texture });
+	}
+	s_real.ActiveTexture(texture);
+}
+
+void GLAPIENTRY GLTrace::HookBindSampler(GLuint unit, GLuint sampler)
+{
+	if (IsRecording() == true)
+	{
+		DefineSampler(sampler);
+		Record(OP_BIND_SAMPLER, { unit, sampler });
+	}
+	s_real.BindSampler(unit, sampler);
+}
+
+void GLAPIENTRY GLTrace::HookBindImageTexture(GLuint unit, GLuint texture, GLint level, GLboolean layered,
+	GLint layer, GLenum access, GLenum format)
+{
+	if (IsRecording() == true)
+	{
+		DefineTexture(texture);
+		Record(OP_BIND_IMAGE_TEXTURE, { unit, texture, SignedArg(level), layered, SignedArg(layer), access, format });
+	}
+	s_real.BindImageTexture(unit, texture, level, layered, layer, access, format);
+}
+
+void GLAPIENTRY GLTrace::HookGenerateTextureMipmap(GLuint texture)
+{
+	if (IsRecording() == true)
+	{
+		DefineTexture(texture);
+		Record(OP_GENERATE_TEXTURE_MIPMAP, { texture });
+	}
+	s_real.GenerateTextureMipmap(texture);
+}
+
+void GLAPIENTRY GLTrace::HookGenerateMipmap(GLenum target)
+{
+	if (IsRecording() == true)
+	{
+		RecordState();
+		Record(OP_GENERATE_MIPMAP, { target });
+	}
+	s_real.GenerateMipmap(target);
+}
+
+void GLAPIENTRY GLTrace::HookTextureSubImage2D(GLuint texture, GLint level, GLint xoffset, GLint yoffset,
+	GLsizei width, GLsizei height, GLenum format, GLenum type, const void* pPixels)
+{
+	if (IsRecording() == true)
+	{
+		DefineTexture(texture);
+		// the pixels come from a bound unpack buffer at an offset, or
+		// from memory in rows of the unpack row length and alignment
+		GLint unpackBuffer = 0;
+		GLint rowLength = 0;
+		GLint alignment = 4;
+		glGetIntegerv(GL_PIXEL_UNPACK_BUFFER_BINDING, &unpackBuffer);
+		glGetIntegerv(GL_UNPACK_ROW_LENGTH, &rowLength);
+		glGetIntegerv(GL_UNPACK_ALIGNMENT, &alignment);
+		size_t bytes = 0;
+		if ((0 == unpackBuffer) && (width > 0) && (height > 0))
+		{
+			size_t pixelBytes = (size_t)GetPixelBytes(format, type);
+			size_t rowBytes = (size_t)((rowLength > 0) ? rowLength : width) * pixelBytes;
+			rowBytes = ((rowBytes + alignment - 1) / alignment) * alignment;
+			bytes = rowBytes * (size_t)(height - 1) + (size_t)width * pixelBytes;
+		}
+		Record(OP_TEXTURE_SUB_IMAGE_2D, { texture, SignedArg(level), SignedArg(xoffset), SignedArg(yoffset),
+			SignedArg(width), SignedArg(height), format, type, (GLuint)unpackBuffer, PointerArg(pPixels),
+			SignedArg(rowLength), SignedArg(alignment) }, (0 == unpackBuffer) ? pPixels : NULL, bytes);
+	}
+	s_real.TextureSubImage2D(texture, level, xoffset, yoffset, width, height, format, type, pPixels);
+}
+
+void GLAPIENTRY GLTrace::HookTexBuffer(GLenum target, GLenum internalFormat, GLuint buffer)
+{
+	if (IsRecording() == true)
+	{
+		RecordState();
+		DefineBuffer(buffer);
+		Record(OP_TEX_BUFFER, { target, internalFormat, buffer });
+	}
+	s_real.TexBuffer(target, internalFormat, buffer);
+}
+
+void GLAPIENTRY GLTrace::HookClipControl(GLenum origin, GLenum depth)
+{
+	if (IsRecording() == true)
+	{
+		Record(OP_CLIP_CONTROL, { origin, depth });
+	}
+	s_real.ClipControl(origin, depth);
+}
+
+void GLAPIENTRY GLTrace::HookBlendFunci(GLuint buffer, GLenum src, GLenum dst)
+{
+	if (IsRecording() == true)
+	{
+		Record(OP_BLEND_FUNCI, { buffer, src, dst });
+	}
+	s_real.BlendFunci(buffer, src, dst);
+}
+
+void GLAPIENTRY GLTrace::HookBlendFunciARB(GLuint buffer, GLenum src, GLenum dst)
+{
+	if (IsRecording() == true)
+	{
+		Record(OP_BLEND_FUNCI, { buffer, src, dst });
+	}
+	s_real.BlendFunciARB(buffer, src, dst);
+}
+
+void GLAPIENTRY GLTrace::HookMemoryBarriers(GLbitfield barriers)
+{
+	if (IsRecording() == true)
+	{
+		Record(OP_MEMORY_BARRIER, { barriers });
+	}
+	s_real.MemoryBarriers(barriers);
+}
+
+void GLAPIENTRY GLTrace::HookDispatchCompute(GLuint groupsX, GLuint groupsY, GLuint groupsZ)
+{
+	if (IsRecording() == true)
+	{
+		RecordState();
+		Record(OP_DISPATCH_COMPUTE, { groupsX, groupsY, groupsZ });
+	}
+	s_real.DispatchCompute(groupsX, groupsY, groupsZ);
+}
+
+void GLAPIENTRY GLTrace::HookDrawArraysInstanced(GLenum mode, GLint first, GLsizei count, GLsizei instances)
+{
+	if (IsRecording() == true)
+	{
+		RecordState();
+		Record(OP_DRAW_ARRAYS_INSTANCED, { mode, SignedArg(first), SignedArg(count), SignedArg(instances) });
+	}
+	s_real.DrawArraysInstanced(mode, first, count, instances);
+}
+
+void GLAPIENTRY GLTrace::HookDrawElementsBaseVertex(GLenum mode, GLsizei count, GLenum type, void* pIndices, GLint baseVertex)
+{
+	if (IsRecording() == true)
+	{
+		RecordState();
+		Record(OP_DRAW_ELEMENTS_BASE_VERTEX, { mode, SignedArg(count), type, PointerArg(pIndices), SignedArg(baseVertex) });
+	}
+	s_real.DrawElementsBaseVertex(mode, count, type, pIndices, baseVertex);
+}
+
+void GLAPIENTRY GLTrace::HookDrawElementsInstancedBaseVertex(GLenum mode, GLsizei count, GLenum type,
+	const void* pIndices, GLsizei instances, GLint baseVertex)
+{
+	if (IsRecording() == true)
+	{
+		RecordState();
+		Record(OP_DRAW_ELEMENTS_INSTANCED_BASE_VERTEX, { mode, SignedArg(count), type, PointerArg(pIndices),
+			SignedArg(instances), SignedArg(baseVertex) });
+	}
+	s_real.DrawElementsInstancedBaseVertex(mode, count, type, pIndices, instances, baseVertex);
+}
+
+void GLAPIENTRY GLTrace::HookMultiDrawElementsIndirect(GLenum mode, GLenum type, const void* pIndirect,
+	GLsizei drawCount, GLsizei stride)
+{
+	if (IsRecording() == true)
+	{
+		RecordState();
+		Record(OP_MULTI_DRAW_ELEMENTS_INDIRECT, { mode, type, PointerArg(pIndirect), SignedArg(drawCount), SignedArg(stride) });
+	}
+	s_real.MultiDrawElementsIndirect(mode, type, pIndirect, drawCount, stride);
+}
+
+void GLAPIENTRY GLTrace::HookMultiDrawElementsIndirectCount(GLenum mode, GLenum type, const GLvoid* pIndirect,
+	GLintptr drawCount, GLsizei maxDrawCount, GLsizei stride)
+{
+	if (IsRecording() == true)
+	{
+		RecordState();
+		Record(OP_MULTI_DRAW_ELEMENTS_INDIRECT_COUNT, { mode, type, PointerArg(pIndirect), SignedArg(drawCount),
+			SignedArg(maxDrawCount), SignedArg(stride) });
+	}
+	s_real.MultiDrawElementsIndirectCount(mode, type, pIndirect, drawCount, maxDrawCount, stride);
+}
+
+void GLAPIENTRY GLTrace::HookMultiDrawElementsIndirectCountARB(GLenum mode, GLenum type, const void* pIndirect,
+	GLintptr drawCount, GLsizei maxDrawCount, GLsizei stride)
+{
+	if (IsRecording() == true)
+	{
+		RecordState();
+		Record(OP_MULTI_DRAW_ELEMENTS_INDIRECT_COUNT, { mode, type, PointerArg(pIndirect), SignedArg(drawCount),
+			SignedArg(maxDrawCount), SignedArg(stride) });
+	}
+	s_real.MultiDrawElementsIndirectCountARB(mode, type, pIndirect, drawCount, maxDrawCount, stride);
+}
+
+void GLAPIENTRY GLTrace::HookMultiDrawArraysIndirect(GLenum mode, const void* pIndirect, GLsizei drawCount, GLsizei stride)
+{
+	if (IsRecording() == true)
+	{
+		RecordState();
+		Record(OP_MULTI_DRAW_ARRAYS_INDIRECT, { mode, PointerArg(pIndirect), SignedArg(drawCount), SignedArg(stride) });
+	}
+	s_real.MultiDrawArraysIndirect(mode, pIndirect, drawCount, stride);
+}
+
+// the shader sources are kept on every thread, whether frames
+// are captured or not, since the programs are built long
+// before the frames they draw
+
+void GLAPIENTRY GLTrace::HookShaderSource(GLuint shader, GLsizei count, const GLchar* const* pStrings, const GLint* pLengths)
+{
+	std::string source;
+	for (GLsizei i = 0; i < count; i++)
+	{
+		if ((NULL != pLengths) && (pLengths[i] >= 0))
+		{
+			source.append(pStrings[i], (size_t)pLengths[i]);
+		}
+		else
+		{
+			source.append(pStrings[i]);
+		}
+	}
+	{
+		std::lock_guard<std::mutex> lock(s_sourceMutex);
+		s_shaderSources[shader] = source;
+	}
+	s_real.ShaderSource(shader, count, pStrings, pLengths);
+}
+
+void GLAPIENTRY GLTrace::HookAttachShader(GLuint program, GLuint shader)
+{
+	{
+		std::lock_guard<std::mutex> lock(s_sourceMutex);
+		s_attachedShaders[program].push_back(shader);
+	}
+	s_real.AttachShader(program, shader);
+}
+
+void GLAPIENTRY GLTrace::HookDetachShader(GLuint program, GLuint shader)
+{
+	{
+		std::lock_guard<std::mutex> lock(s_sourceMutex);
+		std::vector<GLuint>& shaders = s_attachedShaders[program];
+		shaders.erase(std::remove(shaders.begin(), shaders.end(), shader), shaders.end());
+	}
+	s_real.DetachShader(program, shader);
+}
+
+void GLAPIENTRY GLTrace::HookLinkProgram(GLuint program)
+{
+	{
+		std::lock_guard<std::mutex> lock(s_sourceMutex);
+		PROGRAM_SOURCE source;
+		source.binaryFormat = GL_NONE;
+		const std::vector<GLuint>& shaders = s_attachedShaders[program];
+		for (size_t i = 0; i < shaders.size(); i++)
+		{
+			GLint type = GL_NONE;
+			glGetShaderiv(shaders[i], GL_SHADER_TYPE, &type);
+			source.shaderTypes.push_back((GLenum)type);
+			source.sources.push_back(s_shaderSources[shaders[i]]);
+		}
+		s_programSources[program] = source;
+	}
+	Forget(OP_DEFINE_PROGRAM, 1, &program);
+	s_real.LinkProgram(program);
+}
+
+void GLAPIENTRY GLTrace::HookProgramBinary(GLuint program, GLenum binaryFormat, const void* pBinary, GLsizei length)
+{
+	{
+		std::lock_guard<std::mutex> lock(s_sourceMutex);
+		PROGRAM_SOURCE source;
+		source.binaryFormat = binaryFormat;
+		source.binary.assign((const unsigned char*)pBinary, (const unsigned char*)pBinary + length);
+		s_programSources[program] = source;
+	}
+	Forget(OP_DEFINE_PROGRAM, 1, &program);
+	s_real.ProgramBinary(program, binaryFormat, pBinary, length);
+}
+
+void GLAPIENTRY GLTrace::HookDeleteProgram(GLuint program)
+{
+	{
+		std::lock_guard<std::mutex> lock(s_sourceMutex);
+		s_programSources.erase(program);
+		s_attachedShaders.erase(program);
+	}
+	Forget(OP_DEFINE_PROGRAM, 1, &program);
+	s_real.DeleteProgram(program);
+}
+
+void GLAPIENTRY GLTrace::HookDeleteBuffers(GLsizei count, const GLuint* pBuffers)
+{
+	Forget(OP_DEFINE_BUFFER, count, pBuffers);
+	s_real.DeleteBuffers(count, pBuffers);
+}
+
+void GLAPIENTRY GLTrace::HookDeleteFramebuffers(GLsizei count, const GLuint* pFramebuffers)
+{
+	Forget(OP_DEFINE_FRAMEBUFFER, count, pFramebuffers);
+	s_real.DeleteFramebuffers(count, pFramebuffers);
+}
+
+void GLAPIENTRY GLTrace::HookDeleteRenderbuffers(GLsizei count, const GLuint* pRenderbuffers)
+{
+	Forget(OP_DEFINE_RENDERBUFFER, count, pRenderbuffers);
+	s_real.DeleteRenderbuffers(count, pRenderbuffers);
+}
+
+void GLAPIENTRY GLTrace::HookDeleteVertexArrays(GLsizei count, const GLuint* pVertexArrays)
+{
+	Forget(OP_DEFINE_VERTEX_ARRAY, count, pVertexArrays);
+	s_real.DeleteVertexArrays(count, pVertexArrays);
+}
+
+void GLAPIENTRY GLTrace::HookDeleteSamplers(GLsizei count, const GLuint* pSamplers)
+{
+	Forget(OP_DEFINE_SAMPLER, count, pSamplers);
+	s_real.DeleteSamplers(count, pSamplers);
+}
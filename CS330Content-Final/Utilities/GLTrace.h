@@ -0,0 +1,388 @@
+///////////////////////////////////////////////////////////////////////////////
+// gltrace.h
+// ============
+// capture of the GL calls of a range of frames into a binary trace
+//
+//  A slow frame a customer reports can only be studied on a machine
+//  with the application, its assets and the same scene. The trace
+//  holds the GL calls of a range of frames instead, with the contents
+//  of every buffer, texture and program they use as it was the first
+//  time a call used it, so GLTraceReplay can run the frames again on
+//  any machine, alone, and time each call on another driver. GLEW
+//  calls the entry points past GL 1.1 through pointers, which are
+//  swapped here for recording ones; the GL 1.1 calls are linked
+//  directly, so their callers record the few that draw, and the
+//  fixed function state they set, the enables, blending, viewport
+//  and the bound textures, is recorded before each draw whenever it
+//  changed. The hooks are only installed for a capture, so a run
+//  without one calls the driver directly.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+#include <atomic>
+#include <cstdio>
+#include <initializer_list>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+/***********************************************************
+ *  GLTrace
+ *
+ *  This class contains the hooks and the trace being
+ *  written. It is used through static methods, like
+ *  GLDebug, since the GLEW entry points are global and
+ *  the calls come from every module.
+ ***********************************************************/
+class GLTrace
+{
+public:
+	// first bytes of a trace file, "GLTR", and its version
+	static const unsigned int TRACE_MAGIC = 0x52544C47;
+	static const unsigned int TRACE_VERSION = 1;
+
+	// what a record of the trace holds; a record is the opcode
+	// and the number of arguments in 16 bits each, the bytes of
+	// its data in 32, the arguments in 64 bits each, then the
+	// data, such as the values of a glBufferSubData() call or
+	// the contents of a defined object
+	enum OPCODE
+	{
+		// the calls the hooks and their callers record
+		OP_BIND_BUFFER = 0,
+		OP_BIND_BUFFER_BASE,
+		OP_BIND_BUFFER_RANGE,
+		OP_BUFFER_DATA,
+		OP_BUFFER_SUB_DATA,
+		OP_CLEAR_BUFFER_DATA,
+		OP_USE_PROGRAM,
+		OP_UNIFORM_1I,
+		OP_UNIFORM_1UI,
+		OP_UNIFORM_2UI,
+		OP_UNIFORM_1F,
+		OP_UNIFORM_2F,
+		OP_UNIFORM_3F,
+		OP_UNIFORM_4F,
+		OP_UNIFORM_FV,
+		OP_UNIFORM_MATRIX_FV,
+		OP_UNIFORM_BLOCK_BINDING,
+		OP_BIND_VERTEX_ARRAY,
+		OP_BIND_VERTEX_BUFFER,
+		OP_BIND_FRAMEBUFFER,
+		OP_DRAW_BUFFERS,
+		OP_BLIT_FRAMEBUFFER,
+		OP_CLEAR_BUFFER_FV,
+		OP_CLEAR_BUFFER_UIV,
+		OP_ACTIVE_TEXTURE,
+		OP_BIND_SAMPLER,
+		OP_BIND_IMAGE_TEXTURE,
+		OP_GENERATE_TEXTURE_MIPMAP,
+		OP_GENERATE_MIPMAP,
+		OP_TEXTURE_SUB_IMAGE_2D,
+		OP_TEX_BUFFER,
+		OP_CLIP_CONTROL,
+		OP_BLEND_FUNCI,
+		OP_MEMORY_BARRIER,
+		OP_DISPATCH_COMPUTE,
+		OP_DRAW_ARRAYS_INSTANCED,
+		OP_DRAW_ELEMENTS_BASE_VERTEX,
+		OP_DRAW_ELEMENTS_INSTANCED_BASE_VERTEX,
+		OP_MULTI_DRAW_ELEMENTS_INDIRECT,
+		OP_MULTI_DRAW_ELEMENTS_INDIRECT_COUNT,
+		OP_MULTI_DRAW_ARRAYS_INDIRECT,
+		OP_CLEAR,
+		OP_DRAW_ARRAYS,
+		OP_COPY_TEX_SUB_IMAGE_2D,
+		// what no single call shows
+		OP_STATE,				// a TRACE_STATE as its data
+		OP_BUFFER_WRITE,		// a write into a persistent mapping
+		OP_DEFINE_BUFFER,		// an object and its contents, by name
+		OP_DEFINE_TEXTURE,
+		OP_DEFINE_RENDERBUFFER,
+		OP_DEFINE_FRAMEBUFFER,
+		OP_DEFINE_VERTEX_ARRAY,
+		OP_DEFINE_SAMPLER,
+		OP_DEFINE_PROGRAM,
+		OP_FRAME_END,
+		OP_COUNT
+	};
+
+	// texture units, texture targets and draw buffers whose state
+	// is recorded before the draws
+	static const int STATE_TEXTURE_UNITS = 32;
+	static const int STATE_TEXTURE_TARGETS = 6;
+	static const int STATE_DRAW_BUFFERS = 8;
+	static const int STATE_ENABLES = 13;
+
+	// the GL 1.1 state the draws depend on, recorded whenever it
+	// changed since the last draw
+	struct TRACE_STATE
+	{
+		GLint enables[STATE_ENABLES];
+		GLint depthFunc;
+		GLint depthMask;
+		GLint colorMask[4];
+		GLint cullFace;
+		GLint frontFace;
+		GLint polygonMode;
+		GLint blendEquation[2];		// color and alpha
+		GLint blendFunc[STATE_DRAW_BUFFERS][4];	// color and alpha source and destination
+		GLint viewport[4];
+		GLint scissor[4];
+		GLfloat polygonOffset[2];	// factor and units
+		GLfloat clearColor[4];
+		GLfloat clearDepth;
+		GLfloat blendColor[4];
+		GLint activeTexture;
+		GLuint textures[STATE_TEXTURE_UNITS][STATE_TEXTURE_TARGETS];
+	};
+
+	// what a capture wrote
+	struct TRACE_STATS
+	{
+		unsigned long long frames;
+		unsigned long long calls;			// recorded calls, not counting state
+		unsigned long long stateChanges;
+		unsigned long long objects;			// objects defined with their contents
+		unsigned long long bytes;			// of the whole file
+	};
+
+	// swap the GLEW entry points for the hooks; call after
+	// GLLoader::Load() and before any program is built, so the shader
+	// sources of every program are known to the trace
+	static void Install();
+	static bool IsInstalled() { return(s_bInstalled); }
+	// capture count frames from the frame numbered first, 0 being
+	// the first rendered, into a file
+	static void SetFrames(const char* filename, unsigned long long firstFrame, unsigned long long frameCount);
+
+	// mark the frames on the thread rendering them; the frame
+	// begins before its first GL call and ends after its present
+	static void BeginFrame(int width, int height);
+	static void EndFrame();
+	// close a trace the run ended in the middle of
+	static void Finish();
+
+	// the GL 1.1 calls that draw, which no hook sees, recorded by
+	// their callers just before they make them
+	static void RecordClear(GLbitfield mask);
+	static void RecordDrawArrays(GLenum mode, GLint first, GLsizei count);
+	static void RecordCopyTexSubImage2D(GLenum target, GLint level, GLint xoffset, GLint yoffset,
+		GLint x, GLint y, GLsizei width, GLsizei height);
+	// a write into a persistently mapped buffer, which no call shows
+	static void RecordBufferWrite(GLuint buffer, GLintptr offset, GLsizeiptr size, const void* pData);
+
+	// the capability, texture target of each slot of the state,
+	// and name of an opcode, shared with the replay
+	static GLenum GetStateEnable(int index);
+	static GLenum GetStateTextureTarget(int index);
+	static const char* GetOpcodeName(int opcode);
+	// bytes of a pixel of a format and type
+	static int GetPixelBytes(GLenum format, GLenum type);
+	// values in a uniform of a type, and whether they are set as
+	// GL_FLOAT, GL_INT or GL_UNSIGNED_INT; 0 for the types the
+	// trace leaves out, such as doubles
+	static int GetUniformComponents(GLenum type, GLenum& baseType);
+
+	static const TRACE_STATS& GetStats() { return(s_stats); }
+	// print what the capture wrote
+	static void Print();
+
+private:
+	// the shaders a program was linked with, or the binary it was
+	// loaded from
+	struct PROGRAM_SOURCE
+	{
+		std::vector<GLenum> shaderTypes;
+		std::vector<std::string> sources;
+		GLenum binaryFormat;
+		std::vector<unsigned char> binary;
+	};
+
+	// the GLEW entry points the hooks replaced
+	struct GL_FUNCTIONS
+	{
+		PFNGLBINDBUFFERPROC BindBuffer;
+		PFNGLBINDBUFFERBASEPROC BindBufferBase;
+		PFNGLBINDBUFFERRANGEPROC BindBufferRange;
+		PFNGLBUFFERDATAPROC BufferData;
+		PFNGLBUFFERSUBDATAPROC BufferSubData;
+		PFNGLCLEARBUFFERDATAPROC ClearBufferData;
+		PFNGLUSEPROGRAMPROC UseProgram;
+		PFNGLUNIFORM1IPROC Uniform1i;
+		PFNGLUNIFORM1UIPROC Uniform1ui;
+		PFNGLUNIFORM2UIPROC Uniform2ui;
+		PFNGLUNIFORM1FPROC Uniform1f;
+		PFNGLUNIFORM2FPROC Uniform2f;
+		PFNGLUNIFORM3FPROC Uniform3f;
+		PFNGLUNIFORM4FPROC Uniform4f;
+		PFNGLUNIFORM2FVPROC Uniform2fv;
+		PFNGLUNIFORM3FVPROC Uniform3fv;
+		PFNGLUNIFORM4FVPROC Uniform4fv;
+		PFNGLUNIFORMMATRIX2FVPROC UniformMatrix2fv;
+		PFNGLUNIFORMMATRIX3FVPROC UniformMatrix3fv;
+		PFNGLUNIFORMMATRIX4FVPROC UniformMatrix4fv;
+		PFNGLUNIFORMBLOCKBINDINGPROC UniformBlockBinding;
+		PFNGLBINDVERTEXARRAYPROC BindVertexArray;
+		PFNGLBINDVERTEXBUFFERPROC BindVertexBuffer;
+		PFNGLBINDFRAMEBUFFERPROC BindFramebuffer;
+		PFNGLDRAWBUFFERSPROC DrawBuffers;
+		PFNGLBLITFRAMEBUFFERPROC BlitFramebuffer;
+		PFNGLCLEARBUFFERFVPROC ClearBufferfv;
+		PFNGLCLEARBUFFERUIVPROC ClearBufferuiv;
+		PFNGLACTIVETEXTUREPROC ActiveTexture;
+		PFNGLBINDSAMPLERPROC BindSampler;
+		PFNGLBINDIMAGETEXTUREPROC BindImageTexture;
+		PFNGLGENERATETEXTUREMIPMAPPROC GenerateTextureMipmap;
+		PFNGLGENERATEMIPMAPPROC GenerateMipmap;
+		PFNGLTEXTURESUBIMAGE2DPROC TextureSubImage2D;
+		PFNGLTEXBUFFERPROC TexBuffer;
+		PFNGLCLIPCONTROLPROC ClipControl;
+		PFNGLBLENDFUNCIPROC BlendFunci;
+		PFNGLBLENDFUNCIARBPROC BlendFunciARB;
+		PFNGLMEMORYBARRIERPROC MemoryBarriers;
+		PFNGLDISPATCHCOMPUTEPROC DispatchCompute;
+		PFNGLDRAWARRAYSINSTANCEDPROC DrawArraysInstanced;
+		PFNGLDRAWELEMENTSBASEVERTEXPROC DrawElementsBaseVertex;
+		PFNGLDRAWELEMENTSINSTANCEDBASEVERTEXPROC DrawElementsInstancedBaseVertex;
+		PFNGLMULTIDRAWELEMENTSINDIRECTPROC MultiDrawElementsIndirect;
+		PFNGLMULTIDRAWELEMENTSINDIRECTCOUNTPROC MultiDrawElementsIndirectCount;
+		PFNGLMULTIDRAWELEMENTSINDIRECTCOUNTARBPROC MultiDrawElementsIndirectCountARB;
+		PFNGLMULTIDRAWARRAYSINDIRECTPROC MultiDrawArraysIndirect;
+		PFNGLSHADERSOURCEPROC ShaderSource;
+		PFNGLATTACHSHADERPROC AttachShader;
+		PFNGLDETACHSHADERPROC DetachShader;
+		PFNGLLINKPROGRAMPROC LinkProgram;
+		PFNGLPROGRAMBINARYPROC ProgramBinary;
+		PFNGLDELETEPROGRAMPROC DeleteProgram;
+		PFNGLDELETEBUFFERSPROC DeleteBuffers;
+		PFNGLDELETEFRAMEBUFFERSPROC DeleteFramebuffers;
+		PFNGLDELETERENDERBUFFERSPROC DeleteRenderbuffers;
+		PFNGLDELETEVERTEXARRAYSPROC DeleteVertexArrays;
+		PFNGLDELETESAMPLERSPROC DeleteSamplers;
+	};
+
+	static bool s_bInstalled;
+	static GL_FUNCTIONS s_real;
+	// set while frames are captured, on the thread rendering them;
+	// the loader thread's calls pass through
+	static std::atomic<bool> s_bCapturing;
+	static std::thread::id s_captureThread;
+	static std::string s_filename;
+	static unsigned long long s_firstFrame;
+	static unsigned long long s_frameCount;
+	static unsigned long long s_frame;
+	static FILE* s_pFile;
+	// records of the frame not yet written to the file
+	static std::vector<unsigned char> s_records;
+	static TRACE_STATS s_stats;
+	// objects defined in the trace, by opcode of their definition
+	// in the high bits and name in the low
+	static std::set<unsigned long long> s_defined;
+	static TRACE_STATE s_state;
+	static bool s_bStateRecorded;
+
+	// guards the sources, since programs may be built on any thread
+	static std::mutex s_sourceMutex;
+	static std::map<GLuint, std::string> s_shaderSources;
+	static std::map<GLuint, std::vector<GLuint> > s_attachedShaders;
+	static std::map<GLuint, PROGRAM_SOURCE> s_programSources;
+
+	// whether this thread's calls are recorded
+	static bool IsRecording();
+	static void Record(int opcode, std::initializer_list<unsigned long long> args,
+		const void* pData = NULL, size_t dataBytes = 0);
+	static void Open();
+	static void Close();
+	// the bindings in effect as the capture starts, as the calls
+	// that would make them
+	static void RecordBindings();
+	// the fixed function state, when it changed since the last draw
+	static void RecordState();
+	static void QueryState(TRACE_STATE& state);
+
+	// define an object the first time a call uses it, with what
+	// it holds at that point
+	static bool MarkDefined(int opcode, GLuint name);
+	static void Forget(int opcode, GLsizei count, const GLuint* pNames);
+	static void DefineBuffer(GLuint buffer);
+	static void DefineTexture(GLuint texture);
+	static void DefineRenderbuffer(GLuint renderbuffer);
+	static void DefineFramebuffer(GLuint framebuffer);
+	static void DefineVertexArray(GLuint vertexArray);
+	static void DefineSampler(GLuint sampler);
+	static void DefineProgram(GLuint program);
+
+	// the hooks swapped in for the GLEW entry points
+	static void GLAPIENTRY HookBindBuffer(GLenum target, GLuint buffer);
+	static void GLAPIENTRY HookBindBufferBase(GLenum target, GLuint index, GLuint buffer);
+	static void GLAPIENTRY HookBindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size);
+	static void GLAPIENTRY HookBufferData(GLenum target, GLsizeiptr size, const void* pData, GLenum usage);
+	static void GLAPIENTRY HookBufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const void* pData);
+	static void GLAPIENTRY HookClearBufferData(GLenum target, GLenum internalFormat, GLenum format, GLenum type, const void* pData);
+	static void GLAPIENTRY HookUseProgram(GLuint program);
+	static void GLAPIENTRY HookUniform1i(GLint location, GLint v0);
+	static void GLAPIENTRY HookUniform1ui(GLint location, GLuint v0);
+	static void GLAPIENTRY HookUniform2ui(GLint location, GLuint v0, GLuint v1);
+	static void GLAPIENTRY HookUniform1f(GLint location, GLfloat v0);
+	static void GLAPIENTRY HookUniform2f(GLint location, GLfloat v0, GLfloat v1);
+	static void GLAPIENTRY HookUniform3f(GLint location, GLfloat v0, GLfloat v1, GLfloat v2);
+	static void GLAPIENTRY HookUniform4f(GLint location, GLfloat v0, GLfloat v1, GLfloat v2, GLfloat v3);
+	static void GLAPIENTRY HookUniform2fv(GLint location, GLsizei count, const GLfloat* pValues);
+	static void GLAPIENTRY HookUniform3fv(GLint location, GLsizei count, const GLfloat* pValues);
+	static void GLAPIENTRY HookUniform4fv(GLint location, GLsizei count, const GLfloat* pValues);
+	static void GLAPIENTRY HookUniformMatrix2fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat* pValues);
+	static void GLAPIENTRY HookUniformMatrix3fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat* pValues);
+	static void GLAPIENTRY HookUniformMatrix4fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat* pValues);
+	static void GLAPIENTRY HookUniformBlockBinding(GLuint program, GLuint blockIndex, GLuint binding);
+	static void GLAPIENTRY HookBindVertexArray(GLuint vertexArray);
+	static void GLAPIENTRY HookBindVertexBuffer(GLuint bindingIndex, GLuint buffer, GLintptr offset, GLsizei stride);
+	static void GLAPIENTRY HookBindFramebuffer(GLenum target, GLuint framebuffer);
+	static void GLAPIENTRY HookDrawBuffers(GLsizei count, const GLenum* pBuffers);
+	static void GLAPIENTRY HookBlitFramebuffer(GLint srcX0, GLint srcY0, GLint srcX1, GLint srcY1,
+		GLint dstX0, GLint dstY0, GLint dstX1, GLint dstY1, GLbitfield mask, GLenum filter);
+	static void GLAPIENTRY HookClearBufferfv(GLenum buffer, GLint drawBuffer, const GLfloat* pValue);
+	static void GLAPIENTRY HookClearBufferuiv(GLenum buffer, GLint drawBuffer, const GLuint* pValue);
+	static void GLAPIENTRY HookActiveTexture(GLenum texture);
+	static void GLAPIENTRY HookBindSampler(GLuint unit, GLuint sampler);
+	static void GLAPIENTRY HookBindImageTexture(GLuint unit, GLuint texture, GLint level, GLboolean layered,
+		GLint layer, GLenum access, GLenum format);
+	static void GLAPIENTRY HookGenerateTextureMipmap(GLuint texture);
+	static void GLAPIENTRY HookGenerateMipmap(GLenum target);
+	static void GLAPIENTRY HookTextureSubImage2D(GLuint texture, GLint level, GLint xoffset, GLint yoffset,
+		GLsizei width, GLsizei height, GLenum format, GLenum type, const void* pPixels);
+	static void GLAPIENTRY HookTexBuffer(GLenum target, GLenum internalFormat, GLuint buffer);
+	static void GLAPIENTRY HookClipControl(GLenum origin, GLenum depth);
+	static void GLAPIENTRY HookBlendFunci(GLuint buffer, GLenum src, GLenum dst);
+	static void GLAPIENTRY HookBlendFunciARB(GLuint buffer, GLenum src, GLenum dst);
+	static void GLAPIENTRY HookMemoryBarriers(GLbitfield barriers);
+	static void GLAPIENTRY HookDispatchCompute(GLuint groupsX, GLuint groupsY, GLuint groupsZ);
+	static void GLAPIENTRY HookDrawArraysInstanced(GLenum mode, GLint first, GLsizei count, GLsizei instances);
+	static void GLAPIENTRY HookDrawElementsBaseVertex(GLenum mode, GLsizei count, GLenum type, void* pIndices, GLint baseVertex);
+	static void GLAPIENTRY HookDrawElementsInstancedBaseVertex(GLenum mode, GLsizei count, GLenum type,
+		const void* pIndices, GLsizei instances, GLint baseVertex);
+	static void GLAPIENTRY HookMultiDrawElementsIndirect(GLenum mode, GLenum type, const void* pIndirect,
+		GLsizei drawCount, GLsizei stride);
+	static void GLAPIENTRY HookMultiDrawElementsIndirectCount(GLenum mode, GLenum type, const GLvoid* pIndirect,
+		GLintptr drawCount, GLsizei maxDrawCount, GLsizei stride);
+	static void GLAPIENTRY HookMultiDrawElementsIndirectCountARB(GLenum mode, GLenum type, const void* pIndirect,
+		GLintptr drawCount, GLsizei maxDrawCount, GLsizei stride);
+	static void GLAPIENTRY HookMultiDrawArraysIndirect(GLenum mode, const void* pIndirect, GLsizei drawCount, GLsizei stride);
+	static void GLAPIENTRY HookShaderSource(GLuint shader, GLsizei count, const GLchar* const* pStrings, const GLint* pLengths);
+	static void GLAPIENTRY HookAttachShader(GLuint program, GLuint shader);
+	static void GLAPIENTRY HookDetachShader(GLuint program, GLuint shader);
+	static void GLAPIENTRY HookLinkProgram(GLuint program);
+	static void GLAPIENTRY HookProgramBinary(GLuint program, GLenum binaryFormat, const void* pBinary, GLsizei length);
+	static void GLAPIENTRY HookDeleteProgram(GLuint program);
+	static void GLAPIENTRY HookDeleteBuffers(GLsizei count, const GLuint* pBuffers);
+	static void GLAPIENTRY HookDeleteFramebuffers(GLsizei count, const GLuint* pFramebuffers);
+	static void GLAPIENTRY HookDeleteRenderbuffers(GLsizei count, const GLuint* pRenderbuffers);
+	static void GLAPIENTRY HookDeleteVertexArrays(GLsizei count, const GLuint* pVertexArrays);
+	static void GLAPIENTRY HookDeleteSamplers(GLsizei count, const GLuint* pSamplers);
+};
@@ -0,0 +1,1515 @@
+///////////////////////////////////////////////////////////////////////////////
+// gltracereplay.cpp
+// ============
+// offline replay and timing of a trace GLTrace captured
+//
+//  The replay loads a trace without the scene, its assets or the rest
+//  of the application, creates every object the trace defines under
+//  names of its own, with the contents it was captured with, and makes
+//  the recorded calls in order, as often as asked. The first loop
+//  creates the objects and warms the driver; the later ones are timed
+//  per frame, on the GPU with timestamps and on the wall clock, and,
+//  with the call timing on, per call with a GPU query around each, so
+//  a slow frame can be broken down on any driver by the calls it spent
+//  its time in.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "GLTraceReplay.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+
+namespace
+{
+	// bytes of the record header, before its arguments
+	const size_t RECORD_HEADER_BYTES = 8;
+	// calls printed by their GPU time
+	const size_t PRINTED_OPCODES = 20;
+
+	// the sized format of the unsized ones older uploads name, since
+	// the replay makes immutable storage
+	GLenum GetSizedFormat(GLenum internalFormat)
+	{
+		switch (internalFormat)
+		{
+		case GL_RED:
+			return(GL_R8);
+		case GL_RG:
+			return(GL_RG8);
+		case GL_RGB:
+			return(GL_RGB8);
+		case GL_RGBA:
+			return(GL_RGBA8);
+		case GL_DEPTH_COMPONENT:
+			return(GL_DEPTH_COMPONENT24);
+		case GL_DEPTH_STENCIL:
+			return(GL_DEPTH24_STENCIL8);
+		default:
+			return(internalFormat);
+		}
+	}
+
+	// print the mean, nearest rank median and 95th percentile, and
+	// maximum of a time
+	void PrintSummary(const char* label, const std::vector<double>& samples)
+	{
+		if (samples.empty() == true)
+		{
+			return;
+		}
+		std::vector<double> sorted(samples);
+		std::sort(sorted.begin(), sorted.end());
+		double total = 0.0;
+		for (size_t i = 0; i < sorted.size(); i++)
+		{
+			total += sorted[i];
+		}
+		size_t p50 = (size_t)std::ceil(0.50 * (double)sorted.size());
+		size_t p95 = (size_t)std::ceil(0.95 * (double)sorted.size());
+		std::cout << label
+			<< "\tmean " << (total / (double)sorted.size())
+			<< "\tp50 " << sorted[(p50 > 0) ? p50 - 1 : 0]
+			<< "\tp95 " << sorted[(p95 > 0) ? p95 - 1 : 0]
+			<< "\tmax " << sorted.back() << "\n";
+	}
+}
+
+/***********************************************************
+ *  GLTraceReplay()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+GLTraceReplay::GLTraceReplay()
+{
+	m_width = 0;
+	m_height = 0;
+	m_frames = 0;
+	m_bTiming = false;
+	m_loops = 0;
+	m_currentProgram = 0;
+	memset(&m_state, 0, sizeof(m_state));
+	m_bStateApplied = false;
+	m_frameQueries[0] = 0;
+	m_frameQueries[1] = 0;
+	memset(m_opcodeTimes, 0, sizeof(m_opcodeTimes));
+}
+
+/***********************************************************
+ *  ~GLTraceReplay()
+ *
+ *  The destructor for the class; Run() deletes its objects
+ *  while the context is current.
+ ***********************************************************/
+GLTraceReplay::~GLTraceReplay()
+{
+}
+
+/***********************************************************
+ *  READER::U32()
+ *
+ *  This method is used for reading 32 bits of the data.
+ ***********************************************************/
+unsigned int GLTraceReplay::READER::U32()
+{
+	unsigned int value = 0;
+	if (offset + sizeof(value) > bytes)
+	{
+		bOverrun = true;
+		return(0);
+	}
+	memcpy(&value, pData + offset, sizeof(value));
+	offset += sizeof(value);
+	return(value);
+}
+
+/***********************************************************
+ *  READER::U64()
+ *
+ *  This method is used for reading 64 bits of the data.
+ ***********************************************************/
+unsigned long long GLTraceReplay::READER::U64()
+{
+	unsigned long long value = 0;
+	if (offset + sizeof(value) > bytes)
+	{
+		bOverrun = true;
+		return(0);
+	}
+	memcpy(&value, pData + offset, sizeof(value));
+	offset += sizeof(value);
+	return(value);
+}
+
+/***********************************************************
+ *  READER::String()
+ *
+ *  This method is used for reading a string preceded by its
+ *  32 bit length.
+ ***********************************************************/
+std::string GLTraceReplay::READER::String()
+{
+	size_t length = U32();
+	if (offset + length > bytes)
+	{
+		bOverrun = true;
+		return(std::string());
+	}
+	std::string text((const char*)pData + offset, length);
+	offset += length;
+	return(text);
+}
+
+/***********************************************************
+ *  READER::Bytes()
+ *
+ *  This method is used for reading bytes preceded by their
+ *  64 bit count, returning them in place.
+ ***********************************************************/
+const unsigned char* GLTraceReplay::READER::Bytes(size_t& count)
+{
+	count = (size_t)U64();
+	if (offset + count > bytes)
+	{
+		bOverrun = true;
+		count = 0;
+		return(NULL);
+	}
+	const unsigned char* pBytes = pData + offset;
+	offset += count;
+	return(pBytes);
+}
+
+/***********************************************************
+ *  Load()
+ *
+ *  This method is used for reading a trace into memory and
+ *  splitting it into its records. A trace whose capture was
+ *  cut off ends with its last whole frame.
+ ***********************************************************/
+bool GLTraceReplay::Load(const char* filename)
+{
+	m_filename = filename;
+	FILE* pFile = fopen(filename, "rb");
+	if (NULL == pFile)
+	{
+		std::cout << "Could not open GL trace " << filename << std::endl;
+		return(false);
+	}
+	fseek(pFile, 0, SEEK_END);
+	long fileBytes = ftell(pFile);
+	fseek(pFile, 0, SEEK_SET);
+	m_file.resize((fileBytes > 0) ? (size_t)fileBytes : 0);
+	size_t read = (m_file.empty() == false) ? fread(m_file.data(), 1, m_file.size(), pFile) : 0;
+	fclose(pFile);
+	if (read != m_file.size())
+	{
+		std::cout << "Could not read GL trace " << filename << std::endl;
+		return(false);
+	}
+
+	READER header = { m_file.data(), m_file.size(), 0, false };
+	unsigned int magic = header.U32();
+	unsigned int version = header.U32();
+	if ((magic != GLTrace::TRACE_MAGIC) || (version != GLTrace::TRACE_VERSION))
+	{
+		std::cout << filename << " is not a GL trace of version " << GLTrace::TRACE_VERSION << std::endl;
+		return(false);
+	}
+	m_width = (int)header.U32();
+	m_height = (int)header.U32();
+	m_vendor = header.String();
+	m_renderer = header.String();
+	m_version = header.String();
+	if ((header.bOverrun == true) || (m_width <= 0) || (m_height <= 0))
+	{
+		std::cout << "GL trace " << filename << " has a damaged header" << std::endl;
+		return(false);
+	}
+
+	size_t offset = header.offset;
+	size_t framesEnd = 0;
+	size_t argsEnd = 0;
+	while (offset < m_file.size())
+	{
+		if (offset + RECORD_HEADER_BYTES > m_file.size())
+		{
+			break;
+		}
+		unsigned short opcode = 0;
+		unsigned short argCount = 0;
+		unsigned int dataBytes = 0;
+		memcpy(&opcode, &m_file[offset], sizeof(opcode));
+		memcpy(&argCount, &m_file[offset + 2], sizeof(argCount));
+		memcpy(&dataBytes, &m_file[offset + 4], sizeof(dataBytes));
+		size_t argBytes = (size_t)argCount * sizeof(unsigned long long);
+		if ((opcode >= GLTrace::OP_COUNT) || (offset + RECORD_HEADER_BYTES + argBytes + dataBytes > m_file.size()))
+		{
+			break;
+		}
+
+		RECORD record;
+		record.opcode = opcode;
+		record.argCount = argCount;
+		record.argIndex = m_args.size();
+		record.dataOffset = offset + RECORD_HEADER_BYTES + argBytes;
+		record.dataBytes = dataBytes;
+		m_args.resize(m_args.size() + argCount);
+		if (argCount > 0)
+		{
+			memcpy(&m_args[record.argIndex], &m_file[offset + RECORD_HEADER_BYTES], argBytes);
+		}
+		m_records.push_back(record);
+		offset = record.dataOffset + dataBytes;
+
+		if (opcode == GLTrace::OP_FRAME_END)
+		{
+			m_frames++;
+			framesEnd = m_records.size();
+			argsEnd = m_args.size();
+		}
+	}
+	if (offset < m_file.size())
+	{
+		std::cout << "GL trace " << filename << " is cut off after frame " << m_frames << std::endl;
+	}
+	m_records.resize(framesEnd);
+	m_args.resize(argsEnd);
+
+	std::cout << "Loaded GL trace " << filename << " of " << m_frames << " frames at "
+		<< m_width << "x" << m_height << ", captured on " << m_renderer << std::endl;
+	return(m_frames > 0);
+}
+
+/***********************************************************
+ *  Arg()
+ *
+ *  This method is used for getting an argument of a record,
+ *  0 past those it has.
+ ***********************************************************/
+unsigned long long GLTraceReplay::Arg(const RECORD& record, unsigned int index) const
+{
+	return((index < record.argCount) ? m_args[record.argIndex + index] : 0);
+}
+
+long long GLTraceReplay::SignedArg(const RECORD& record, unsigned int index) const
+{
+	return((long long)Arg(record, index));
+}
+
+GLfloat GLTraceReplay::FloatArg(const RECORD& record, unsigned int index) const
+{
+	unsigned int bits = (unsigned int)Arg(record, index);
+	GLfloat value = 0.0f;
+	memcpy(&value, &bits, sizeof(value));
+	return(value);
+}
+
+const void* GLTraceReplay::PointerArg(const RECORD& record, unsigned int index) const
+{
+	return((const void*)(uintptr_t)Arg(record, index));
+}
+
+const void* GLTraceReplay::GetData(const RECORD& record) const
+{
+	return((record.dataBytes > 0) ? m_file.data() + record.dataOffset : NULL);
+}
+
+GLTraceReplay::READER GLTraceReplay::GetReader(const RECORD& record) const
+{
+	READER reader = { m_file.data() + record.dataOffset, record.dataBytes, 0, false };
+	return(reader);
+}
+
+/***********************************************************
+ *  Remap()
+ *
+ *  This method is used for getting the replay's object for
+ *  a name of the trace. A name the trace never defined, as
+ *  a buffer generated and bound during the frames, is made
+ *  here, the way glGen*() would have made it.
+ ***********************************************************/
+GLuint GLTraceReplay::Remap(int kind, GLuint name)
+{
+	if (0 == name)
+	{
+		return(0);
+	}
+	std::map<GLuint, GLuint>::const_iterator found = m_names[kind].find(name);
+	if (found != m_names[kind].end())
+	{
+		return(found->second);
+	}
+
+	GLuint object = 0;
+	switch (kind)
+	{
+	case KIND_BUFFER:
+		glGenBuffers(1, &object);
+		break;
+	case KIND_TEXTURE:
+		glGenTextures(1, &object);
+		break;
+	case KIND_RENDERBUFFER:
+		glGenRenderbuffers(1, &object);
+		break;
+	case KIND_FRAMEBUFFER:
+		glGenFramebuffers(1, &object);
+		break;
+	case KIND_VERTEX_ARRAY:
+		glGenVertexArrays(1, &object);
+		break;
+	case KIND_SAMPLER:
+		glGenSamplers(1, &object);
+		break;
+	default:
+		// a program cannot be made without its shaders
+		return(0);
+	}
+	m_names[kind][name] = object;
+	return(object);
+}
+
+/***********************************************************
+ *  RemapLocation()
+ *
+ *  This method is used for getting the location of the
+ *  replay's current program for a location of the trace.
+ *  A location the program does not have is set as -1,
+ *  which GL ignores.
+ ***********************************************************/
+GLint GLTraceReplay::RemapLocation(GLint location)
+{
+	std::map<GLuint, std::map<GLint, GLint> >::const_iterator program = m_locations.find(m_currentProgram);
+	if (program == m_locations.end())
+	{
+		return(-1);
+	}
+	std::map<GLint, GLint>::const_iterator found = program->second.find(location);
+	return((found != program->second.end()) ? found->second : -1);
+}
+
+/***********************************************************
+ *  Release()
+ *
+ *  This method is used for deleting the replay's object for
+ *  a name of the trace, before the name is defined again.
+ ***********************************************************/
+void GLTraceReplay::Release(int kind, GLuint name)
+{
+	std::map<GLuint, GLuint>::iterator found = m_names[kind].find(name);
+	if (found == m_names[kind].end())
+	{
+		return;
+	}
+	GLuint object = found->second;
+	switch (kind)
+	{
+	case KIND_BUFFER:
+		glDeleteBuffers(1, &object);
+		break;
+	case KIND_TEXTURE:
+		glDeleteTextures(1, &object);
+		break;
+	case KIND_RENDERBUFFER:
+		glDeleteRenderbuffers(1, &object);
+		break;
+	case KIND_FRAMEBUFFER:
+		glDeleteFramebuffers(1, &object);
+		break;
+	case KIND_VERTEX_ARRAY:
+		glDeleteVertexArrays(1, &object);
+		break;
+	case KIND_SAMPLER:
+		glDeleteSamplers(1, &object);
+		break;
+	case KIND_PROGRAM:
+		glDeleteProgram(object);
+		m_locations.erase(name);
+		break;
+	default:
+		break;
+	}
+	m_names[kind].erase(found);
+}
+
+/***********************************************************
+ *  DeleteObjects()
+ *
+ *  This method is used for deleting every object the replay
+ *  made, and its queries.
+ ***********************************************************/
+void GLTraceReplay::DeleteObjects()
+{
+	for (int kind = 0; kind < KIND_COUNT; kind++)
+	{
+		while (m_names[kind].empty() == false)
+		{
+			Release(kind, m_names[kind].begin()->first);
+		}
+	}
+	if (m_queries.empty() == false)
+	{
+		glDeleteQueries((GLsizei)m_queries.size(), m_queries.data());
+		m_queries.clear();
+	}
+	if (0 != m_frameQueries[0])
+	{
+		glDeleteQueries(2, m_frameQueries);
+		m_frameQueries[0] = 0;
+		m_frameQueries[1] = 0;
+	}
+}
+
+/***********************************************************
+ *  Run()
+ *
+ *  This method is used for replaying the frames of the
+ *  trace loops times. The objects are defined in the first
+ *  loop, and the later loops draw them as the previous
+ *  loop left them, timing their frames; a single loop is
+ *  timed as it is.
+ ***********************************************************/
+bool GLTraceReplay::Run(int loops)
+{
+	if (m_frames == 0)
+	{
+		return(false);
+	}
+	m_loops = std::max(loops, 1);
+	const GLubyte* pRenderer = glGetString(GL_RENDERER);
+	m_replayRenderer = (NULL != pRenderer) ? (const char*)pRenderer : "";
+	glGenQueries(2, m_frameQueries);
+
+	typedef std::chrono::steady_clock CLOCK;
+	for (int loop = 0; loop < m_loops; loop++)
+	{
+		bool bFirstLoop = (loop == 0);
+		bool bMeasured = (m_loops == 1) || (loop > 0);
+		CLOCK::time_point frameStart = CLOCK::now();
+		glQueryCounter(m_frameQueries[0], GL_TIMESTAMP);
+
+		for (size_t i = 0; i < m_records.size(); i++)
+		{
+			const RECORD& record = m_records[i];
+			if (record.opcode == GLTrace::OP_FRAME_END)
+			{
+				// wait for the frame, so its wall time holds its GPU work
+				glQueryCounter(m_frameQueries[1], GL_TIMESTAMP);
+				glFinish();
+				CLOCK::time_point frameEnd = CLOCK::now();
+				if (bMeasured == true)
+				{
+					GLuint64 start = 0;
+					GLuint64 end = 0;
+					glGetQueryObjectui64v(m_frameQueries[0], GL_QUERY_RESULT, &start);
+					glGetQueryObjectui64v(m_frameQueries[1], GL_QUERY_RESULT, &end);
+					m_gpuFrameMs.push_back((double)(end - start) / 1000000.0);
+					m_wallFrameMs.push_back(std::chrono::duration<double, std::milli>(frameEnd - frameStart).count());
+					ReadQueries();
+				}
+				frameStart = CLOCK::now();
+				glQueryCounter(m_frameQueries[0], GL_TIMESTAMP);
+				continue;
+			}
+
+			bool bTimed = (m_bTiming == true) && (bMeasured == true) && (record.opcode < GLTrace::OP_STATE);
+			if (bTimed == false)
+			{
+				Execute(record, bFirstLoop);
+				continue;
+			}
+			if (m_pending.size() == m_queries.size())
+			{
+				GLuint query = 0;
+				glGenQueries(1, &query);
+				m_queries.push_back(query);
+			}
+			PENDING_QUERY pending = { record.opcode, m_queries[m_pending.size()] };
+			glBeginQuery(GL_TIME_ELAPSED, pending.query);
+			CLOCK::time_point callStart = CLOCK::now();
+			Execute(record, bFirstLoop);
+			CLOCK::time_point callEnd = CLOCK::now();
+			glEndQuery(GL_TIME_ELAPSED);
+			m_opcodeTimes[record.opcode].cpuMs += std::chrono::duration<double, std::milli>(callEnd - callStart).count();
+			m_pending.push_back(pending);
+		}
+	}
+
+	DeleteObjects();
+	return(true);
+}
+
+/***********************************************************
+ *  ReadQueries()
+ *
+ *  This method is used for adding the GPU times of the
+ *  calls of a finished frame to their opcodes.
+ ***********************************************************/
+void GLTraceReplay::ReadQueries()
+{
+	for (size_t i = 0; i < m_pending.size(); i++)
+	{
+		GLuint64 elapsed = 0;
+		glGetQueryObjectui64v(m_pending[i].query, GL_QUERY_RESULT, &elapsed);
+		m_opcodeTimes[m_pending[i].opcode].calls++;
+		m_opcodeTimes[m_pending[i].opcode].gpuMs += (double)elapsed / 1000000.0;
+	}
+	m_pending.clear();
+}
+
+/***********************************************************
+ *  Execute()
+ *
+ *  This method is used for making the call of a record with
+ *  the replay's objects. The definitions are only made in
+ *  the first loop.
+ ***********************************************************/
+void GLTraceReplay::Execute(const RECORD& record, bool bFirstLoop)
+{
+	if ((record.opcode >= GLTrace::OP_DEFINE_BUFFER) && (record.opcode <= GLTrace::OP_DEFINE_PROGRAM) &&
+		(bFirstLoop == false))
+	{
+		return;
+	}
+
+	const void* pData = GetData(record);
+	switch (record.opcode)
+	{
+	case GLTrace::OP_BIND_BUFFER:
+		glBindBuffer((GLenum)Arg(record, 0), Remap(KIND_BUFFER, (GLuint)Arg(record, 1)));
+		break;
+	case GLTrace::OP_BIND_BUFFER_BASE:
+		glBindBufferBase((GLenum)Arg(record, 0), (GLuint)Arg(record, 1), Remap(KIND_BUFFER, (GLuint)Arg(record, 2)));
+		break;
+	case GLTrace::OP_BIND_BUFFER_RANGE:
+		glBindBufferRange((GLenum)Arg(record, 0), (GLuint)Arg(record, 1), Remap(KIND_BUFFER, (GLuint)Arg(record, 2)),
+			(GLintptr)SignedArg(record, 3), (GLsizeiptr)SignedArg(record, 4));
+		break;
+	case GLTrace::OP_BUFFER_DATA:
+		glBufferData((GLenum)Arg(record, 0), (GLsizeiptr)SignedArg(record, 1), pData, (GLenum)Arg(record, 2));
+		break;
+	case GLTrace::OP_BUFFER_SUB_DATA:
+		glBufferSubData((GLenum)Arg(record, 0), (GLintptr)SignedArg(record, 1), (GLsizeiptr)SignedArg(record, 2), pData);
+		break;
+	case GLTrace::OP_CLEAR_BUFFER_DATA:
+		glClearBufferData((GLenum)Arg(record, 0), (GLenum)Arg(record, 1), (GLenum)Arg(record, 2), (GLenum)Arg(record, 3), pData);
+		break;
+	case GLTrace::OP_USE_PROGRAM:
+		m_currentProgram = (GLuint)Arg(record, 0);
+		glUseProgram(Remap(KIND_PROGRAM, m_currentProgram));
+		break;
+	case GLTrace::OP_UNIFORM_1I:
+		glUniform1i(RemapLocation((GLint)SignedArg(record, 0)), (GLint)SignedArg(record, 1));
+		break;
+	case GLTrace::OP_UNIFORM_1UI:
+		glUniform1ui(RemapLocation((GLint)SignedArg(record, 0)), (GLuint)Arg(record, 1));
+		break;
+	case GLTrace::OP_UNIFORM_2UI:
+		glUniform2ui(RemapLocation((GLint)SignedArg(record, 0)), (GLuint)Arg(record, 1), (GLuint)Arg(record, 2));
+		break;
+	case GLTrace::OP_UNIFORM_1F:
+		glUniform1f(RemapLocation((GLint)SignedArg(record, 0)), FloatArg(record, 1));
+		break;
+	case GLTrace::OP_UNIFORM_2F:
+		glUniform2f(RemapLocation((GLint)SignedArg(record, 0)), FloatArg(record, 1), FloatArg(record, 2));
+		break;
+	case GLTrace::OP_UNIFORM_3F:
+		glUniform3f(RemapLocation((GLint)SignedArg(record, 0)), FloatArg(record, 1), FloatArg(record, 2), FloatArg(record, 3));
+		break;
+	case GLTrace::OP_UNIFORM_4F:
+		glUniform4f(RemapLocation((GLint)SignedArg(record, 0)), FloatArg(record, 1), FloatArg(record, 2),
+			FloatArg(record, 3), FloatArg(record, 4));
+		break;
+	case GLTrace::OP_UNIFORM_FV:
+	{
+		GLint location = RemapLocation((GLint)SignedArg(record, 1));
+		GLsizei count = (GLsizei)SignedArg(record, 2);
+		switch (Arg(record, 0))
+		{
+		case 2:
+			glUniform2fv(location, count, (const GLfloat*)pData);
+			break;
+		case 3:
+			glUniform3fv(location, count, (const GLfloat*)pData);
+			break;
+		default:
+			glUniform4fv(location, count, (const GLfloat*)pData);
+			break;
+		}
+		break;
+	}
+	case GLTrace::OP_UNIFORM_MATRIX_FV:
+	{
+		GLint location = RemapLocation((GLint)SignedArg(record, 1));
+		GLsizei count = (GLsizei)SignedArg(record, 2);
+		GLboolean transpose = (GLboolean)Arg(record, 3);
+		switch (Arg(record, 0))
+		{
+		case 2:
+			glUniformMatrix2fv(location, count, transpose, (const GLfloat*)pData);
+			break;
+		case 3:
+			glUniformMatrix3fv(location, count, transpose, (const GLfloat*)pData);
+			break;
+		default:
+			glUniformMatrix4fv(location, count, transpose, (const GLfloat*)pData);
+			break;
+		}
+		break;
+	}
+	case GLTrace::OP_UNIFORM_BLOCK_BINDING:
+	{
+		// the block by its name, whose index may differ here
+		GLuint program = Remap(KIND_PROGRAM, (GLuint)Arg(record, 0));
+		std::string name((NULL != pData) ? (const char*)pData : "", record.dataBytes);
+		GLuint blockIndex = (0 != program) ? glGetUniformBlockIndex(program, name.c_str()) : GL_INVALID_INDEX;
+		if (blockIndex != GL_INVALID_INDEX)
+		{
+			glUniformBlockBinding(program, blockIndex, (GLuint)Arg(record, 1));
+		}
+		break;
+	}
+	case GLTrace::OP_BIND_VERTEX_ARRAY:
+		glBindVertexArray(Remap(KIND_VERTEX_ARRAY, (GLuint)Arg(record, 0)));
+		break;
+	case GLTrace::OP_BIND_VERTEX_BUFFER:
+		glBindVertexBuffer((GLuint)Arg(record, 0), Remap(KIND_BUFFER, (GLuint)Arg(record, 1)),
+			(GLintptr)SignedArg(record, 2), (GLsizei)SignedArg(record, 3));
+		break;
+	case GLTrace::OP_BIND_FRAMEBUFFER:
+		glBindFramebuffer((GLenum)Arg(record, 0), Remap(KIND_FRAMEBUFFER, (GLuint)Arg(record, 1)));
+		break;
+	case GLTrace::OP_DRAW_BUFFERS:
+		glDrawBuffers((GLsizei)SignedArg(record, 0), (const GLenum*)pData);
+		break;
+	case GLTrace::OP_BLIT_FRAMEBUFFER:
+		glBlitFramebuffer((GLint)SignedArg(record, 0), (GLint)SignedArg(record, 1), (GLint)SignedArg(record, 2),
+			(GLint)SignedArg(record, 3), (GLint)SignedArg(record, 4), (GLint)SignedArg(record, 5),
+			(GLint)SignedArg(record, 6), (GLint)SignedArg(record, 7), (GLbitfield)Arg(record, 8), (GLenum)Arg(record, 9));
+		break;
+	case GLTrace::OP_CLEAR_BUFFER_FV:
+		glClearBufferfv((GLenum)Arg(record, 0), (GLint)SignedArg(record, 1), (const GLfloat*)pData);
+		break;
+	case GLTrace::OP_CLEAR_BUFFER_UIV:
+		glClearBufferuiv((GLenum)Arg(record, 0), (GLint)SignedArg(record, 1), (const GLuint*)pData);
+		break;
+	case GLTrace::OP_ACTIVE_TEXTURE:
+		// the state compared with the next one is the unit now active
+		m_state.activeTexture = (GLint)Arg(record, 0);
+		glActiveTexture((GLenum)Arg(record, 0));
+		break;
+	case GLTrace::OP_BIND_SAMPLER:
+		glBindSampler((GLuint)Arg(record, 0), Remap(KIND_SAMPLER, (GLuint)Arg(record, 1)));
+		break;
+	case GLTrace::OP_BIND_IMAGE_TEXTURE:
+		glBindImageTexture((GLuint)Arg(record, 0), Remap(KIND_TEXTURE, (GLuint)Arg(record, 1)), (GLint)SignedArg(record, 2),
+			(GLboolean)Arg(record, 3), (GLint)SignedArg(record, 4), (GLenum)Arg(record, 5), (GLenum)Arg(record, 6));
+		break;
+	case GLTrace::OP_GENERATE_TEXTURE_MIPMAP:
+		glGenerateTextureMipmap(Remap(KIND_TEXTURE, (GLuint)Arg(record, 0)));
+		break;
+	case GLTrace::OP_GENERATE_MIPMAP:
+		glGenerateMipmap((GLenum)Arg(record, 0));
+		break;
+	case GLTrace::OP_TEXTURE_SUB_IMAGE_2D:
+	{
+		GLuint texture = Remap(KIND_TEXTURE, (GLuint)Arg(record, 0));
+		glPixelStorei(GL_UNPACK_ROW_LENGTH, (GLint)SignedArg(record, 10));
+		glPixelStorei(GL_UNPACK_ALIGNMENT, (GLint)SignedArg(record, 11));
+		if (0 != Arg(record, 8))
+		{
+			// from the unpack buffer the replay has bound, at an offset
+			glTextureSubImage2D(texture, (GLint)SignedArg(record, 1), (GLint)SignedArg(record, 2), (GLint)SignedArg(record, 3),
+				(GLsizei)SignedArg(record, 4), (GLsizei)SignedArg(record, 5), (GLenum)Arg(record, 6), (GLenum)Arg(record, 7),
+				PointerArg(record, 9));
+		}
+		else
+		{
+			GLint unpackBuffer = 0;
+			glGetIntegerv(GL_PIXEL_UNPACK_BUFFER_BINDING, &unpackBuffer);
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+			glTextureSubImage2D(texture, (GLint)SignedArg(record, 1), (GLint)SignedArg(record, 2), (GLint)SignedArg(record, 3),
+				(GLsizei)SignedArg(record, 4), (GLsizei)SignedArg(record, 5), (GLenum)Arg(record, 6), (GLenum)Arg(record, 7),
+				pData);
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, (GLuint)unpackBuffer);
+		}
+		glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		break;
+	}
+	case GLTrace::OP_TEX_BUFFER:
+		glTexBuffer((GLenum)Arg(record, 0), (GLenum)Arg(record, 1), Remap(KIND_BUFFER, (GLuint)Arg(record, 2)));
+		break;
+	case GLTrace::OP_CLIP_CONTROL:
+		glClipControl((GLenum)Arg(record, 0), (GLenum)Arg(record, 1));
+		break;
+	case GLTrace::OP_BLEND_FUNCI:
+		glBlendFunci((GLuint)Arg(record, 0), (GLenum)Arg(record, 1), (GLenum)Arg(record, 2));
+		break;
+	case GLTrace::OP_MEMORY_BARRIER:
+		glMemoryBarrier((GLbitfield)Arg(record, 0));
+		break;
+	case GLTrace::OP_DISPATCH_COMPUTE:
+		glDispatchCompute((GLuint)Arg(record, 0), (GLuint)Arg(record, 1), (GLuint)Arg(record, 2));
+		break;
+	case GLTrace::OP_DRAW_ARRAYS_INSTANCED:
+		glDrawArraysInstanced((GLenum)Arg(record, 0), (GLint)SignedArg(record, 1), (GLsizei)SignedArg(record, 2),
+			(GLsizei)SignedArg(record, 3));
+		break;
+	case GLTrace::OP_DRAW_ELEMENTS_BASE_VERTEX:
+		glDrawElementsBaseVertex((GLenum)Arg(record, 0), (GLsizei)SignedArg(record, 1), (GLenum)Arg(record, 2),
+			(void*)PointerArg(record, 3), (GLint)SignedArg(record, 4));
+		break;
+	case GLTrace::OP_DRAW_ELEMENTS_INSTANCED_BASE_VERTEX:
+		glDrawElementsInstancedBaseVertex((GLenum)Arg(record, 0), (GLsizei)SignedArg(record, 1), (GLenum)Arg(record, 2),
+			PointerArg(record, 3), (GLsizei)SignedArg(record, 4), (GLint)SignedArg(record, 5));
+		break;
+	case GLTrace::OP_MULTI_DRAW_ELEMENTS_INDIRECT:
+		glMultiDrawElementsIndirect((GLenum)Arg(record, 0), (GLenum)Arg(record, 1), PointerArg(record, 2),
+			(GLsizei)SignedArg(record, 3), (GLsizei)SignedArg(record, 4));
+		break;
+	case GLTrace::OP_MULTI_DRAW_ELEMENTS_INDIRECT_COUNT:
+		// GL 4.6 or the ARB extension, whichever the driver has
+		if (NULL != glMultiDrawElementsIndirectCount)
+		{
+			glMultiDrawElementsIndirectCount((GLenum)Arg(record, 0), (GLenum)Arg(record, 1), PointerArg(record, 2),
+				(GLintptr)SignedArg(record, 3), (GLsizei)SignedArg(record, 4), (GLsizei)SignedArg(record, 5));
+		}
+		else if (NULL != glMultiDrawElementsIndirectCountARB)
+		{
+			glMultiDrawElementsIndirectCountARB((GLenum)Arg(record, 0), (GLenum)Arg(record, 1), PointerArg(record, 2),
+				(GLintptr)SignedArg(record, 3), (GLsizei)SignedArg(record, 4), (GLsizei)SignedArg(record, 5));
+		}
+		break;
+	case GLTrace::OP_MULTI_DRAW_ARRAYS_INDIRECT:
+		glMultiDrawArraysIndirect((GLenum)Arg(record, 0), PointerArg(record, 1), (GLsizei)SignedArg(record, 2),
+			(GLsizei)SignedArg(record, 3));
+		break;
+	case GLTrace::OP_CLEAR:
+		glClear((GLbitfield)Arg(record, 0));
+		break;
+	case GLTrace::OP_DRAW_ARRAYS:
+		glDrawArrays((GLenum)Arg(record, 0), (GLint)SignedArg(record, 1), (GLsizei)SignedArg(record, 2));
+		break;
+	case GLTrace::OP_COPY_TEX_SUB_IMAGE_2D:
+		glCopyTexSubImage2D((GLenum)Arg(record, 0), (GLint)SignedArg(record, 1), (GLint)SignedArg(record, 2),
+			(GLint)SignedArg(record, 3), (GLint)SignedArg(record, 4), (GLint)SignedArg(record, 5),
+			(GLsizei)SignedArg(record, 6), (GLsizei)SignedArg(record, 7));
+		break;
+	case GLTrace::OP_STATE:
+		if (record.dataBytes == sizeof(GLTrace::TRACE_STATE))
+		{
+			GLTrace::TRACE_STATE state;
+			memcpy(&state, pData, sizeof(state));
+			ApplyState(state);
+		}
+		break;
+	case GLTrace::OP_BUFFER_WRITE:
+		glNamedBufferSubData(Remap(KIND_BUFFER, (GLuint)Arg(record, 0)), (GLintptr)SignedArg(record, 1),
+			(GLsizeiptr)record.dataBytes, pData);
+		break;
+	case GLTrace::OP_DEFINE_BUFFER:
+		DefineBuffer(record);
+		break;
+	case GLTrace::OP_DEFINE_TEXTURE:
+		DefineTexture(record);
+		break;
+	case GLTrace::OP_DEFINE_RENDERBUFFER:
+		DefineRenderbuffer(record);
+		break;
+	case GLTrace::OP_DEFINE_FRAMEBUFFER:
+		DefineFramebuffer(record);
+		break;
+	case GLTrace::OP_DEFINE_VERTEX_ARRAY:
+		DefineVertexArray(record);
+		break;
+	case GLTrace::OP_DEFINE_SAMPLER:
+		DefineSampler(record);
+		break;
+	case GLTrace::OP_DEFINE_PROGRAM:
+		DefineProgram(record);
+		break;
+	default:
+		break;
+	}
+}
+
+/***********************************************************
+ *  ApplyState()
+ *
+ *  This method is used for setting the fixed function state
+ *  of a record where it differs from the state set last,
+ *  or all of it the first time.
+ ***********************************************************/
+void GLTraceReplay::ApplyState(const GLTrace::TRACE_STATE& state)
+{
+	bool bAll = (m_bStateApplied == false);
+	const GLTrace::TRACE_STATE& last = m_state;
+
+	for (int i = 0; i < GLTrace::STATE_ENABLES; i++)
+	{
+		if ((bAll == true) || (state.enables[i] != last.enables[i]))
+		{
+			if (state.enables[i] != 0)
+			{
+				glEnable(GLTrace::GetStateEnable(i));
+			}
+			else
+			{
+				glDisable(GLTrace::GetStateEnable(i));
+			}
+		}
+	}
+	if ((bAll == true) || (state.depthFunc != last.depthFunc))
+	{
+		glDepthFunc((GLenum)state.depthFunc);
+	}
+	if ((bAll == true) || (state.depthMask != last.depthMask))
+	{
+		glDepthMask((GLboolean)state.depthMask);
+	}
+	if ((bAll == true) || (memcmp(state.colorMask, last.colorMask, sizeof(state.colorMask)) != 0))
+	{
+		glColorMask((GLboolean)state.colorMask[0], (GLboolean)state.colorMask[1],
+			(GLboolean)state.colorMask[2], (GLboolean)state.colorMask[3]);
+	}
+	if ((bAll == true) || (state.cullFace != last.cullFace))
+	{
+		glCullFace((GLenum)state.cullFace);
+	}
+	if ((bAll == true) || (state.frontFace != last.frontFace))
+	{
+		glFrontFace((GLenum)state.frontFace);
+	}
+	if ((bAll == true) || (state.polygonMode != last.polygonMode))
+	{
+		glPolygonMode(GL_FRONT_AND_BACK, (GLenum)state.polygonMode);
+	}
+	if ((bAll == true) || (memcmp(state.blendEquation, last.blendEquation, sizeof(state.blendEquation)) != 0))
+	{
+		glBlendEquationSeparate((GLenum)state.blendEquation[0], (GLenum)state.blendEquation[1]);
+	}
+	for (int buffer = 0; buffer < GLTrace::STATE_DRAW_BUFFERS; buffer++)
+	{
+		if ((bAll == true) || (memcmp(state.blendFunc[buffer], last.blendFunc[buffer], sizeof(state.blendFunc[buffer])) != 0))
+		{
+			glBlendFuncSeparatei((GLuint)buffer, (GLenum)state.blendFunc[buffer][0], (GLenum)state.blendFunc[buffer][1],
+				(GLenum)state.blendFunc[buffer][2], (GLenum)state.blendFunc[buffer][3]);
+		}
+	}
+	if ((bAll == true) || (memcmp(state.viewport, last.viewport, sizeof(state.viewport)) != 0))
+	{
+		glViewport(state.viewport[0], state.viewport[1], state.viewport[2], state.viewport[3]);
+	}
+	if ((bAll == true) || (memcmp(state.scissor, last.scissor, sizeof(state.scissor)) != 0))
+	{
+		glScissor(state.scissor[0], state.scissor[1], state.scissor[2], state.scissor[3]);
+	}
+	if ((bAll == true) || (memcmp(state.polygonOffset, last.polygonOffset, sizeof(state.polygonOffset)) != 0))
+	{
+		glPolygonOffset(state.polygonOffset[0], state.polygonOffset[1]);
+	}
+	if ((bAll == true) || (memcmp(state.clearColor, last.clearColor, sizeof(state.clearColor)) != 0))
+	{
+		glClearColor(state.clearColor[0], state.clearColor[1], state.clearColor[2], state.clearColor[3]);
+	}
+	if ((bAll == true) || (state.clearDepth != last.clearDepth))
+	{
+		glClearDepth(state.clearDepth);
+	}
+	if ((bAll == true) || (memcmp(state.blendColor, last.blendColor, sizeof(state.blendColor)) != 0))
+	{
+		glBlendColor(state.blendColor[0], state.blendColor[1], state.blendColor[2], state.blendColor[3]);
+	}
+
+	// the textures are bound per unit, through the active one
+	bool bUnitChanged = false;
+	for (int unit = 0; unit < GLTrace::STATE_TEXTURE_UNITS; unit++)
+	{
+		for (int target = 0; target < GLTrace::STATE_TEXTURE_TARGETS; target++)
+		{
+			if ((bAll == true) || (state.textures[unit][target] != last.textures[unit][target]))
+			{
+				glActiveTexture(GL_TEXTURE0 + (GLenum)unit);
+				glBindTexture(GLTrace::GetStateTextureTarget(target), Remap(KIND_TEXTURE, state.textures[unit][target]));
+				bUnitChanged = true;
+			}
+		}
+	}
+	if ((bAll == true) || (bUnitChanged == true) || (state.activeTexture != last.activeTexture))
+	{
+		glActiveTexture((GLenum)state.activeTexture);
+	}
+
+	m_state = state;
+	m_bStateApplied = true;
+}
+
+/***********************************************************
+ *  DefineBuffer()
+ *
+ *  This method is used for making a buffer of the trace's
+ *  size and contents. Its storage is mutable, since the
+ *  frames may respecify it with glBufferData().
+ ***********************************************************/
+void GLTraceReplay::DefineBuffer(const RECORD& record)
+{
+	GLuint name = (GLuint)Arg(record, 0);
+	Release(KIND_BUFFER, name);
+	GLuint buffer = 0;
+	glCreateBuffers(1, &buffer);
+	glNamedBufferData(buffer, (GLsizeiptr)SignedArg(record, 1), GetData(record), GL_DYNAMIC_DRAW);
+	m_names[KIND_BUFFER][name] = buffer;
+}
+
+/***********************************************************
+ *  DefineTexture()
+ *
+ *  This method is used for making a texture of the trace's
+ *  target, format and size, with its parameters and the
+ *  contents of its levels.
+ ***********************************************************/
+void GLTraceReplay::DefineTexture(const RECORD& record)
+{
+	GLuint name = (GLuint)Arg(record, 0);
+	GLenum target = (GLenum)Arg(record, 1);
+	GLenum internalFormat = GetSizedFormat((GLenum)Arg(record, 2));
+	GLsizei levels = std::max((GLsizei)SignedArg(record, 3), 1);
+	GLsizei width = (GLsizei)SignedArg(record, 4);
+	GLsizei height = (GLsizei)SignedArg(record, 5);
+	GLsizei depth = (GLsizei)SignedArg(record, 6);
+	GLsizei samples = (GLsizei)SignedArg(record, 7);
+	bool bCompressed = (Arg(record, 8) == GL_TRUE);
+	GLenum format = (GLenum)Arg(record, 9);
+	GLenum type = (GLenum)Arg(record, 10);
+
+	Release(KIND_TEXTURE, name);
+	// the texture may be bound, so every binding is set again
+	m_bStateApplied = false;
+	GLuint texture = 0;
+	glCreateTextures(target, 1, &texture);
+	m_names[KIND_TEXTURE][name] = texture;
+
+	switch (target)
+	{
+	case GL_TEXTURE_BUFFER:
+	{
+		GLuint buffer = Remap(KIND_BUFFER, (GLuint)Arg(record, 11));
+		GLsizeiptr size = (GLsizeiptr)SignedArg(record, 13);
+		if (size > 0)
+		{
+			glTextureBufferRange(texture, internalFormat, buffer, (GLintptr)SignedArg(record, 12), size);
+		}
+		else
+		{
+			glTextureBuffer(texture, internalFormat, buffer);
+		}
+		return;
+	}
+	case GL_TEXTURE_2D:
+	case GL_TEXTURE_CUBE_MAP:
+		glTextureStorage2D(texture, levels, internalFormat, width, height);
+		break;
+	case GL_TEXTURE_2D_ARRAY:
+	case GL_TEXTURE_CUBE_MAP_ARRAY:
+	case GL_TEXTURE_3D:
+		glTextureStorage3D(texture, levels, internalFormat, width, height, depth);
+		break;
+	case GL_TEXTURE_2D_MULTISAMPLE:
+		glTextureStorage2DMultisample(texture, samples, internalFormat, width, height, GL_TRUE);
+		return;
+	case GL_TEXTURE_2D_MULTISAMPLE_ARRAY:
+		glTextureStorage3DMultisample(texture, samples, internalFormat, width, height, depth, GL_TRUE);
+		return;
+	default:
+		std::cout << "GL trace texture " << name << " has a target the replay leaves out" << std::endl;
+		return;
+	}
+
+	READER reader = GetReader(record);
+	unsigned int parameters = reader.U32();
+	bool bAnisotropy = (GLEW_VERSION_4_6 == GL_TRUE) || (GLEW_ARB_texture_filter_anisotropic == GL_TRUE) ||
+		(GLEW_EXT_texture_filter_anisotropic == GL_TRUE);
+	for (unsigned int i = 0; (i < parameters) && (reader.bOverrun == false); i++)
+	{
+		GLenum pname = reader.U32();
+		bool bFloat = (reader.U32() == GL_TRUE);
+		unsigned int bits = reader.U32();
+		if ((pname == GL_TEXTURE_MAX_ANISOTROPY) && (bAnisotropy == false))
+		{
+			continue;
+		}
+		if (bFloat == true)
+		{
+			GLfloat value = 0.0f;
+			memcpy(&value, &bits, sizeof(value));
+			glTextureParameterf(texture, pname, value);
+		}
+		else
+		{
+			glTextureParameteri(texture, pname, (GLint)bits);
+		}
+	}
+
+	// upload from memory, tightly packed
+	GLint unpackBuffer = 0;
+	glGetIntegerv(GL_PIXEL_UNPACK_BUFFER_BINDING, &unpackBuffer);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	unsigned int levelCount = reader.U32();
+	bool bLayered = (target != GL_TEXTURE_2D);
+	for (unsigned int level = 0; (level < levelCount) && (reader.bOverrun == false); level++)
+	{
+		size_t bytes = 0;
+		const unsigned char* pContents = reader.Bytes(bytes);
+		if ((NULL == pContents) || (bytes == 0))
+		{
+			continue;
+		}
+		GLsizei levelWidth = std::max(width >> level, 1);
+		GLsizei levelHeight = std::max(height >> level, 1);
+		GLsizei levelDepth = (target == GL_TEXTURE_3D) ? std::max(depth >> level, 1) : std::max(depth, 1);
+		if ((bCompressed == true) && (bLayered == true))
+		{
+			glCompressedTextureSubImage3D(texture, (GLint)level, 0, 0, 0, levelWidth, levelHeight, levelDepth,
+				internalFormat, (GLsizei)bytes, pContents);
+		}
+		else if (bCompressed == true)
+		{
+			glCompressedTextureSubImage2D(texture, (GLint)level, 0, 0, levelWidth, levelHeight,
+				internalFormat, (GLsizei)bytes, pContents);
+		}
+		else if (bLayered == true)
+		{
+			glTextureSubImage3D(texture, (GLint)level, 0, 0, 0, levelWidth, levelHeight, levelDepth, format, type, pContents);
+		}
+		else
+		{
+			glTextureSubImage2D(texture, (GLint)level, 0, 0, levelWidth, levelHeight, format, type, pContents);
+		}
+	}
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, (GLuint)unpackBuffer);
+}
+
+/***********************************************************
+ *  DefineRenderbuffer()
+ *
+ *  This method is used for making a renderbuffer of the
+ *  trace's format, size and samples.
+ ***********************************************************/
+void GLTraceReplay::DefineRenderbuffer(const RECORD& record)
+{
+	GLuint name = (GLuint)Arg(record, 0);
+	Release(KIND_RENDERBUFFER, name);
+	GLuint renderbuffer = 0;
+	glCreateRenderbuffers(1, &renderbuffer);
+	glNamedRenderbufferStorageMultisample(renderbuffer, (GLsizei)SignedArg(record, 4),
+		GetSizedFormat((GLenum)Arg(record, 1)), (GLsizei)SignedArg(record, 2), (GLsizei)SignedArg(record, 3));
+	m_names[KIND_RENDERBUFFER][name] = renderbuffer;
+}
+
+/***********************************************************
+ *  DefineFramebuffer()
+ *
+ *  This method is used for making a framebuffer with the
+ *  trace's attachments and draw and read buffers. The
+ *  multiview attachments have no direct state call, so the
+ *  framebuffer is bound for them, and they are left out on
+ *  a driver without OVR_multiview.
+ ***********************************************************/
+void GLTraceReplay::DefineFramebuffer(const RECORD& record)
+{
+	GLuint name = (GLuint)Arg(record, 0);
+	Release(KIND_FRAMEBUFFER, name);
+	GLuint framebuffer = 0;
+	glCreateFramebuffers(1, &framebuffer);
+	m_names[KIND_FRAMEBUFFER][name] = framebuffer;
+
+	READER reader = GetReader(record);
+	unsigned int attachments = reader.U32();
+	for (unsigned int i = 0; (i < attachments) && (reader.bOverrun == false); i++)
+	{
+		GLenum attachment = reader.U32();
+		GLenum objectType = reader.U32();
+		GLuint object = reader.U32();
+		GLint level = (GLint)reader.U32();
+		GLint layer = (GLint)reader.U32();
+		GLsizei views = (GLsizei)reader.U32();
+		GLint baseView = (GLint)reader.U32();
+		if (objectType == GL_RENDERBUFFER)
+		{
+			glNamedFramebufferRenderbuffer(framebuffer, attachment, GL_RENDERBUFFER, Remap(KIND_RENDERBUFFER, object));
+			continue;
+		}
+		GLuint texture = Remap(KIND_TEXTURE, object);
+		if (views > 0)
+		{
+			if (GLEW_OVR_multiview == GL_TRUE)
+			{
+				GLint drawFramebuffer = 0;
+				glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &drawFramebuffer);
+				glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffer);
+				glFramebufferTextureMultiviewOVR(GL_DRAW_FRAMEBUFFER, attachment, texture, level, baseView, views);
+				glBindFramebuffer(GL_DRAW_FRAMEBUFFER, (GLuint)drawFramebuffer);
+			}
+		}
+		else if (layer >= 0)
+		{
+			glNamedFramebufferTextureLayer(framebuffer, attachment, texture, level, layer);
+		}
+		else
+		{
+			glNamedFramebufferTexture(framebuffer, attachment, texture, level);
+		}
+	}
+
+	GLenum drawBuffers[GLTrace::STATE_DRAW_BUFFERS];
+	for (int i = 0; i < GLTrace::STATE_DRAW_BUFFERS; i++)
+	{
+		drawBuffers[i] = reader.U32();
+	}
+	GLenum readBuffer = reader.U32();
+	if (reader.bOverrun == false)
+	{
+		glNamedFramebufferDrawBuffers(framebuffer, GLTrace::STATE_DRAW_BUFFERS, drawBuffers);
+		glNamedFramebufferReadBuffer(framebuffer, readBuffer);
+	}
+}
+
+/***********************************************************
+ *  DefineVertexArray()
+ *
+ *  This method is used for making a vertex array with the
+ *  trace's element buffer, attribute formats and vertex
+ *  buffer bindings.
+ ***********************************************************/
+void GLTraceReplay::DefineVertexArray(const RECORD& record)
+{
+	GLuint name = (GLuint)Arg(record, 0);
+	Release(KIND_VERTEX_ARRAY, name);
+	GLuint vertexArray = 0;
+	glCreateVertexArrays(1, &vertexArray);
+	m_names[KIND_VERTEX_ARRAY][name] = vertexArray;
+
+	READER reader = GetReader(record);
+	glVertexArrayElementBuffer(vertexArray, Remap(KIND_BUFFER, reader.U32()));
+	// the attributes and bindings GLTrace records
+	const GLuint attribs = 16;
+	for (GLuint attrib = 0; (attrib < attribs) && (reader.bOverrun == false); attrib++)
+	{
+		bool bEnabled = (reader.U32() != 0);
+		GLint size = (GLint)reader.U32();
+		GLenum type = reader.U32();
+		GLboolean normalized = (GLboolean)reader.U32();
+		bool bInteger = (reader.U32() != 0);
+		bool bLong = (reader.U32() != 0);
+		GLuint relativeOffset = reader.U32();
+		GLuint binding = reader.U32();
+		if (bLong == true)
+		{
+			glVertexArrayAttribLFormat(vertexArray, attrib, size, type, relativeOffset);
+		}
+		else if (bInteger == true)
+		{
+			glVertexArrayAttribIFormat(vertexArray, attrib, size, type, relativeOffset);
+		}
+		else
+		{
+			glVertexArrayAttribFormat(vertexArray, attrib, size, type, normalized, relativeOffset);
+		}
+		glVertexArrayAttribBinding(vertexArray, attrib, binding);
+		if (bEnabled == true)
+		{
+			glEnableVertexArrayAttrib(vertexArray, attrib);
+		}
+	}
+	for (GLuint binding = 0; (binding < attribs) && (reader.bOverrun == false); binding++)
+	{
+		GLuint buffer = reader.U32();
+		GLintptr offset = (GLintptr)reader.U64();
+		GLsizei stride = (GLsizei)reader.U32();
+		GLuint divisor = reader.U32();
+		glVertexArrayVertexBuffer(vertexArray, binding, Remap(KIND_BUFFER, buffer), offset, stride);
+		glVertexArrayBindingDivisor(vertexArray, binding, divisor);
+	}
+}
+
+/***********************************************************
+ *  DefineSampler()
+ *
+ *  This method is used for making a sampler with the
+ *  trace's parameters.
+ ***********************************************************/
+void GLTraceReplay::DefineSampler(const RECORD& record)
+{
+	GLuint name = (GLuint)Arg(record, 0);
+	Release(KIND_SAMPLER, name);
+	GLuint sampler = 0;
+	glCreateSamplers(1, &sampler);
+	m_names[KIND_SAMPLER][name] = sampler;
+
+	READER reader = GetReader(record);
+	unsigned int parameters = reader.U32();
+	bool bAnisotropy = (GLEW_VERSION_4_6 == GL_TRUE) || (GLEW_ARB_texture_filter_anisotropic == GL_TRUE) ||
+		(GLEW_EXT_texture_filter_anisotropic == GL_TRUE);
+	for (unsigned int i = 0; (i < parameters) && (reader.bOverrun == false); i++)
+	{
+		GLenum pname = reader.U32();
+		bool bFloat = (reader.U32() == GL_TRUE);
+		unsigned int bits = reader.U32();
+		if ((pname == GL_TEXTURE_MAX_ANISOTROPY) && (bAnisotropy == false))
+		{
+			continue;
+		}
+		if (bFloat == true)
+		{
+			GLfloat value = 0.0f;
+			memcpy(&value, &bits, sizeof(value));
+			glSamplerParameterf(sampler, pname, value);
+		}
+		else
+		{
+			glSamplerParameteri(sampler, pname, (GLint)bits);
+		}
+	}
+}
+
+/***********************************************************
+ *  DefineProgram()
+ *
+ *  This method is used for building a program from the
+ *  trace's shader sources, or loading its binary, which
+ *  only loads on the driver it came from. The uniforms are
+ *  set by name, keeping the replay's location for each
+ *  location of the trace, and the blocks bound by name.
+ ***********************************************************/
+void GLTraceReplay::DefineProgram(const RECORD& record)
+{
+	GLuint name = (GLuint)Arg(record, 0);
+	Release(KIND_PROGRAM, name);
+	GLuint program = glCreateProgram();
+	m_names[KIND_PROGRAM][name] = program;
+
+	READER reader = GetReader(record);
+	unsigned int shaderCount = reader.U32();
+	std::vector<GLuint> shaders;
+	for (unsigned int i = 0; (i < shaderCount) && (reader.bOverrun == false); i++)
+	{
+		GLenum shaderType = reader.U32();
+		std::string source = reader.String();
+		GLuint shader = glCreateShader(shaderType);
+		const GLchar* pSource = source.c_str();
+		glShaderSource(shader, 1, &pSource, NULL);
+		glCompileShader(shader);
+		GLint compiled = GL_FALSE;
+		glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+		if (compiled == GL_FALSE)
+		{
+			char log[512];
+			glGetShaderInfoLog(shader, sizeof(log), NULL, log);
+			std::cout << "GL trace program " << name << " failed to compile:\n" << log << std::endl;
+		}
+		glAttachShader(program, shader);
+		shaders.push_back(shader);
+	}
+	GLenum binaryFormat = reader.U32();
+	size_t binaryBytes = 0;
+	const unsigned char* pBinary = reader.Bytes(binaryBytes);
+	if (shaders.empty() == false)
+	{
+		glLinkProgram(program);
+		for (size_t i = 0; i < shaders.size(); i++)
+		{
+			glDetachShader(program, shaders[i]);
+			glDeleteShader(shaders[i]);
+		}
+	}
+	else if (binaryBytes > 0)
+	{
+		glProgramBinary(program, binaryFormat, pBinary, (GLsizei)binaryBytes);
+	}
+	GLint linked = GL_FALSE;
+	glGetProgramiv(program, GL_LINK_STATUS, &linked);
+	if (linked == GL_FALSE)
+	{
+		std::cout << "GL trace program " << name << " did not link on this driver" << std::endl;
+		return;
+	}
+
+	std::map<GLint, GLint>& locations = m_locations[name];
+	unsigned int elements = reader.U32();
+	for (unsigned int i = 0; (i < elements) && (reader.bOverrun == false); i++)
+	{
+		std::string uniformName = reader.String();
+		GLint traceLocation = (GLint)reader.U32();
+		GLenum type = reader.U32();
+		GLenum baseType = GL_NONE;
+		int components = GLTrace::GetUniformComponents(type, baseType);
+		unsigned int values[16] = {};
+		for (int c = 0; c < components; c++)
+		{
+			values[c] = reader.U32();
+		}
+		GLint location = glGetUniformLocation(program, uniformName.c_str());
+		locations[traceLocation] = location;
+		if (location >= 0)
+		{
+			SetUniform(program, location, type, values);
+		}
+	}
+
+	unsigned int blocks = reader.U32();
+	for (unsigned int i = 0; (i < blocks) && (reader.bOverrun == false); i++)
+	{
+		std::string blockName = reader.String();
+		GLuint binding = reader.U32();
+		GLuint blockIndex = glGetUniformBlockIndex(program, blockName.c_str());
+		if (blockIndex != GL_INVALID_INDEX)
+		{
+			glUniformBlockBinding(program, blockIndex, binding);
+		}
+	}
+	unsigned int storageBlocks = reader.U32();
+	for (unsigned int i = 0; (i < storageBlocks) && (reader.bOverrun == false); i++)
+	{
+		std::string blockName = reader.String();
+		GLuint binding = reader.U32();
+		GLuint blockIndex = glGetProgramResourceIndex(program, GL_SHADER_STORAGE_BLOCK, blockName.c_str());
+		if (blockIndex != GL_INVALID_INDEX)
+		{
+			glShaderStorageBlockBinding(program, blockIndex, binding);
+		}
+	}
+}
+
+/***********************************************************
+ *  SetUniform()
+ *
+ *  This method is used for setting a uniform of a program
+ *  to the values the trace read back for it.
+ ***********************************************************/
+void GLTraceReplay::SetUniform(GLuint program, GLint location, GLenum type, const unsigned int* pValues)
+{
+	const GLfloat* pFloats = (const GLfloat*)pValues;
+	switch (type)
+	{
+	case GL_FLOAT_MAT2:
+		glProgramUniformMatrix2fv(program, location, 1, GL_FALSE, pFloats);
+		return;
+	case GL_FLOAT_MAT3:
+		glProgramUniformMatrix3fv(program, location, 1, GL_FALSE, pFloats);
+		return;
+	case GL_FLOAT_MAT4:
+		glProgramUniformMatrix4fv(program, location, 1, GL_FALSE, pFloats);
+		return;
+	case GL_FLOAT_MAT2x3:
+		glProgramUniformMatrix2x3fv(program, location, 1, GL_FALSE, pFloats);
+		return;
+	case GL_FLOAT_MAT3x2:
+		glProgramUniformMatrix3x2fv(program, location, 1, GL_FALSE, pFloats);
+		return;
+	case GL_FLOAT_MAT2x4:
+		glProgramUniformMatrix2x4fv(program, location, 1, GL_FALSE, pFloats);
+		return;
+	case GL_FLOAT_MAT4x2:
+		glProgramUniformMatrix4x2fv(program, location, 1, GL_FALSE, pFloats);
+		return;
+	case GL_FLOAT_MAT3x4:
+		glProgramUniformMatrix3x4fv(program, location, 1, GL_FALSE, pFloats);
+		return;
+	case GL_FLOAT_MAT4x3:
+		glProgramUniformMatrix4x3fv(program, location, 1, GL_FALSE, pFloats);
+		return;
+	default:
+		break;
+	}
+
+	GLenum baseType = GL_NONE;
+	int components = GLTrace::GetUniformComponents(type, baseType);
+	const GLint* pInts = (const GLint*)pValues;
+	if (baseType == GL_FLOAT)
+	{
+		switch (components)
+		{
+		case 1: glProgramUniform1fv(program, location, 1, pFloats); break;
+		case 2: glProgramUniform2fv(program, location, 1, pFloats); break;
+		case 3: glProgramUniform3fv(program, location, 1, pFloats); break;
+		case 4: glProgramUniform4fv(program, location, 1, pFloats); break;
+		default: break;
+		}
+	}
+	else if (baseType == GL_INT)
+	{
+		switch (components)
+		{
+		case 1: glProgramUniform1iv(program, location, 1, pInts); break;
+		case 2: glProgramUniform2iv(program, location, 1, pInts); break;
+		case 3: glProgramUniform3iv(program, location, 1, pInts); break;
+		case 4: glProgramUniform4iv(program, location, 1, pInts); break;
+		default: break;
+		}
+	}
+	else if (baseType == GL_UNSIGNED_INT)
+	{
+		switch (components)
+		{
+		case 1: glProgramUniform1uiv(program, location, 1, pValues); break;
+		case 2: glProgramUniform2uiv(program, location, 1, pValues); break;
+		case 3: glProgramUniform3uiv(program, location, 1, pValues); break;
+		case 4: glProgramUniform4uiv(program, location, 1, pValues); break;
+		default: break;
+		}
+	}
+}
+
+/***********************************************************
+ *  Print()
+ *
+ *  This method is used for printing the frame times of the
+ *  replay and, with the call timing, the calls that took
+ *  the most GPU time.
+ ***********************************************************/
+void GLTraceReplay::Print() const
+{
+	std::cout << "\n*** GL TRACE REPLAY: ***\n";
+	std::cout << "file " << m_filename << "\tframes " << m_frames << "\tloops " << m_loops
+		<< "\tmeasured frames " << m_gpuFrameMs.size() << "\n";
+	std::cout << "captured on " << m_renderer << " (" << m_version << ")\n";
+	std::cout << "replayed on " << m_replayRenderer << "\n";
+	PrintSummary("gpu ms", m_gpuFrameMs);
+	PrintSummary("wall ms", m_wallFrameMs);
+	if (m_bTiming == false)
+	{
+		return;
+	}
+
+	std::vector<int> opcodes;
+	double totalGpuMs = 0.0;
+	for (int i = 0; i < GLTrace::OP_COUNT; i++)
+	{
+		if (m_opcodeTimes[i].calls > 0)
+		{
+			opcodes.push_back(i);
+			totalGpuMs += m_opcodeTimes[i].gpuMs;
+		}
+	}
+	std::sort(opcodes.begin(), opcodes.end(),
+		[this](int a, int b) { return(m_opcodeTimes[a].gpuMs > m_opcodeTimes[b].gpuMs); });
+	double frames = (double)std::max<size_t>(m_gpuFrameMs.size(), 1);
+	std::cout << "calls by GPU time, per frame:\n";
+	for (size_t i = 0; (i < opcodes.size()) && (i < PRINTED_OPCODES); i++)
+	{
+		const OPCODE_TIME& time = m_opcodeTimes[opcodes[i]];
+		std::cout << std::left << std::setw(36) << GLTrace::GetOpcodeName(opcodes[i]) << std::right
+			<< "\tcalls " << (double)time.calls / frames
+			<< "\tgpu ms " << time.gpuMs / frames
+			<< "\t(" << ((totalGpuMs > 0.0) ? 100.0 * time.gpuMs / totalGpuMs : 0.0) << "%)"
+			<< "\tcpu ms " << time.cpuMs / frames << "\n";
+	}
+}
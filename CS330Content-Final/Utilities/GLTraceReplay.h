@@ -0,0 +1,175 @@
+///////////////////////////////////////////////////////////////////////////////
+// gltracereplay.h
+// ============
+// offline replay and timing of a trace GLTrace captured
+//
+//  The replay loads a trace without the scene, its assets or the rest
+//  of the application, creates every object the trace defines under
+//  names of its own, with the contents it was captured with, and makes
+//  the recorded calls in order, as often as asked. The first loop
+//  creates the objects and warms the driver; the later ones are timed
+//  per frame, on the GPU with timestamps and on the wall clock, and,
+//  with the call timing on, per call with a GPU query around each, so
+//  a slow frame can be broken down on any driver by the calls it spent
+//  its time in.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "GLTrace.h"
+
+#include <GL/glew.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+/***********************************************************
+ *  GLTraceReplay
+ *
+ *  This class contains a loaded trace, the objects made for
+ *  it and the times of its replay. Load() reads the file
+ *  without a context; Run() needs the context current.
+ ***********************************************************/
+class GLTraceReplay
+{
+public:
+	// constructor
+	GLTraceReplay();
+	// destructor
+	~GLTraceReplay();
+
+	// read and check a trace file; false when it cannot be read or
+	// is not a trace of this version
+	bool Load(const char* filename);
+	// size of the frames the trace was captured at, for the window
+	int GetWidth() const { return(m_width); }
+	int GetHeight() const { return(m_height); }
+	// time every call with a GPU query of its own, which adds a
+	// query per call to the frames
+	void SetTiming(bool bTiming) { m_bTiming = bTiming; }
+
+	// replay the frames of the trace loops times; false when the
+	// trace has no frames
+	bool Run(int loops);
+	// print the frame times and the calls by the GPU time they took
+	void Print() const;
+
+private:
+	// a record of the trace, its arguments copied out of the file
+	// since the records are not aligned
+	struct RECORD
+	{
+		int opcode;
+		unsigned int argCount;
+		size_t argIndex;		// into m_args
+		size_t dataOffset;		// into m_file
+		unsigned int dataBytes;
+	};
+
+	// reads the data of a record, failing softly past its end
+	struct READER
+	{
+		const unsigned char* pData;
+		size_t bytes;
+		size_t offset;
+		bool bOverrun;
+
+		unsigned int U32();
+		unsigned long long U64();
+		std::string String();
+		// bytes preceded by their 64 bit count, in place
+		const unsigned char* Bytes(size_t& count);
+	};
+
+	// the objects of a kind, which have separate names
+	enum KIND
+	{
+		KIND_BUFFER = 0,
+		KIND_TEXTURE,
+		KIND_RENDERBUFFER,
+		KIND_FRAMEBUFFER,
+		KIND_VERTEX_ARRAY,
+		KIND_SAMPLER,
+		KIND_PROGRAM,
+		KIND_COUNT
+	};
+
+	// the calls of an opcode and the time they took
+	struct OPCODE_TIME
+	{
+		unsigned long long calls;
+		double gpuMs;
+		double cpuMs;
+	};
+
+	// a timed call of the frame, read back at its end
+	struct PENDING_QUERY
+	{
+		int opcode;
+		GLuint query;
+	};
+
+	std::string m_filename;
+	std::vector<unsigned char> m_file;
+	std::vector<unsigned long long> m_args;
+	std::vector<RECORD> m_records;
+	int m_width;
+	int m_height;
+	std::string m_vendor;
+	std::string m_renderer;
+	std::string m_version;
+	// the driver the trace was replayed on
+	std::string m_replayRenderer;
+	unsigned long long m_frames;
+	bool m_bTiming;
+	int m_loops;
+
+	// names of the replay by the names of the trace
+	std::map<GLuint, GLuint> m_names[KIND_COUNT];
+	// uniform locations of the replay by those of the trace, per
+	// program of the trace
+	std::map<GLuint, std::map<GLint, GLint> > m_locations;
+	GLuint m_currentProgram;
+	// the fixed function state applied last, valid once applied
+	GLTrace::TRACE_STATE m_state;
+	bool m_bStateApplied;
+
+	std::vector<GLuint> m_queries;
+	std::vector<PENDING_QUERY> m_pending;
+	GLuint m_frameQueries[2];
+	OPCODE_TIME m_opcodeTimes[GLTrace::OP_COUNT];
+	// milliseconds of each frame replayed after the first loop
+	std::vector<double> m_gpuFrameMs;
+	std::vector<double> m_wallFrameMs;
+
+	unsigned long long Arg(const RECORD& record, unsigned int index) const;
+	long long SignedArg(const RECORD& record, unsigned int index) const;
+	GLfloat FloatArg(const RECORD& record, unsigned int index) const;
+	const void* PointerArg(const RECORD& record, unsigned int index) const;
+	// the data of a record, NULL when it has none
+	const void* GetData(const RECORD& record) const;
+	READER GetReader(const RECORD& record) const;
+
+	// the replay's name for a name of the trace, made on first use
+	// for the objects the trace binds before it defines them
+	GLuint Remap(int kind, GLuint name);
+	GLint RemapLocation(GLint location);
+	// forget an object of the trace, deleting the replay's
+	void Release(int kind, GLuint name);
+
+	void Execute(const RECORD& record, bool bFirstLoop);
+	void ApplyState(const GLTrace::TRACE_STATE& state);
+	void DefineBuffer(const RECORD& record);
+	void DefineTexture(const RECORD& record);
+	void DefineRenderbuffer(const RECORD& record);
+	void DefineFramebuffer(const RECORD& record);
+	void DefineVertexArray(const RECORD& record);
+	void DefineSampler(const RECORD& record);
+	void DefineProgram(const RECORD& record);
+	static void SetUniform(GLuint program, GLint location, GLenum type, const unsigned int* pValues);
+
+	// read the call times of the frame once it finished
+	void ReadQueries();
+	void DeleteObjects();
+};
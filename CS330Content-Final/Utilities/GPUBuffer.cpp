@@ -0,0 +1,262 @@
+///////////////////////////////////////////////////////////////////////////////
+// gpubuffer.cpp
+// ============
+// buffer objects created for how often they are written
+//
+//  Every buffer is created and written through the copy targets, which
+//  no VAO or draw reads, so the bindings of the frame are left alone.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "GPUBuffer.h"
+#include "GLDebug.h"
+
+#include <iostream>
+
+namespace
+{
+	// names of the usage classes, in the order of USAGE
+	const char* const USAGE_NAMES[GPUBuffer::USAGE_COUNT] =
+	{
+		"static",
+		"dynamic",
+		"stream"
+	};
+
+	// no update yet
+	const unsigned long long NO_FRAME = ~0ull;
+}
+
+unsigned long long GPUBuffer::s_frame = 0;
+GPUBuffer::USAGE_STATS GPUBuffer::s_stats[GPUBuffer::USAGE_COUNT] = {};
+
+/***********************************************************
+ *  GPUBuffer()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+GPUBuffer::GPUBuffer()
+{
+	m_buffer = 0;
+	m_size = 0;
+	m_usage = USAGE_STATIC;
+	m_lastUpdateFrame = NO_FRAME;
+	m_updateFrames = 0;
+	m_bMisuseReported = false;
+}
+
+/***********************************************************
+ *  ~GPUBuffer()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+GPUBuffer::~GPUBuffer()
+{
+	Destroy();
+}
+
+/***********************************************************
+ *  Create()
+ *
+ *  This method is used for creating the storage of the
+ *  buffer for its usage class. A static buffer gets
+ *  immutable storage the driver may place anywhere and a
+ *  dynamic one immutable storage it may write, where
+ *  ARB_buffer_storage is there; a stream buffer keeps
+ *  mutable storage, which is what orphaning renames.
+ ***********************************************************/
+bool GPUBuffer::Create(USAGE usage, GLsizeiptr size, const void* pData,
+	GPUMemory::CATEGORY category, const char* owner)
+{
+	Destroy();
+
+	m_usage = usage;
+	m_size = size;
+	m_owner = (NULL != owner) ? owner : "";
+	m_lastUpdateFrame = NO_FRAME;
+	m_updateFrames = 0;
+	m_bMisuseReported = false;
+
+	glGenBuffers(1, &m_buffer);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, m_buffer);
+	if ((usage != USAGE_STREAM) && (GLEW_ARB_buffer_storage == GL_TRUE))
+	{
+		glBufferStorage(GL_COPY_WRITE_BUFFER, size, pData,
+			(usage == USAGE_DYNAMIC) ? GL_DYNAMIC_STORAGE_BIT : 0);
+	}
+	else
+	{
+		const GLenum BUFFER_USAGE[USAGE_COUNT] = { GL_STATIC_DRAW, GL_DYNAMIC_DRAW, GL_STREAM_DRAW };
+		glBufferData(GL_COPY_WRITE_BUFFER, size, pData, BUFFER_USAGE[usage]);
+	}
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+	GPUMemory::TrackBuffer(m_buffer, (long long)size, category, owner);
+	if (NULL != owner)
+	{
+		GLDebug::Label(GL_BUFFER, m_buffer, owner);
+	}
+	s_stats[usage].buffers++;
+	s_stats[usage].bytes += (unsigned long long)size;
+
+	return(0 != m_buffer);
+}
+
+/***********************************************************
+ *  Destroy()
+ *
+ *  This method is used for deleting the buffer and taking
+ *  it out of the totals of its class.
+ ***********************************************************/
+void GPUBuffer::Destroy()
+{
+	if (0 == m_buffer)
+	{
+		return;
+	}
+
+	GPUMemory::DeleteBuffers(1, &m_buffer);
+	m_buffer = 0;
+	s_stats[m_usage].buffers--;
+	s_stats[m_usage].bytes -= (unsigned long long)m_size;
+	m_size = 0;
+}
+
+/***********************************************************
+ *  Update()
+ *
+ *  This method is used for writing part of the buffer. A
+ *  static buffer is written through a staging buffer the
+ *  GPU copies from, so its immutable storage is never
+ *  mapped or waited on. A dynamic buffer is written in
+ *  place. A stream buffer is orphaned by every write that
+ *  starts at its beginning, so rewriting it never waits for
+ *  the draws reading it before, and the writes further in
+ *  fill the new storage.
+ ***********************************************************/
+void GPUBuffer::Update(GLintptr offset, GLsizeiptr size, const void* pData)
+{
+	if ((0 == m_buffer) || (NULL == pData) || (size <= 0) || (offset + size > m_size))
+	{
+		return;
+	}
+
+	CountUpdate(size);
+
+	glBindBuffer(GL_COPY_WRITE_BUFFER, m_buffer);
+	if (m_usage == USAGE_STATIC)
+	{
+		GLuint staging = 0;
+		glGenBuffers(1, &staging);
+		glBindBuffer(GL_COPY_READ_BUFFER, staging);
+		glBufferData(GL_COPY_READ_BUFFER, size, pData, GL_STREAM_COPY);
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, offset, size);
+		glBindBuffer(GL_COPY_READ_BUFFER, 0);
+		glDeleteBuffers(1, &staging);
+	}
+	else
+	{
+		if ((m_usage == USAGE_STREAM) && (0 == offset))
+		{
+			glBufferData(GL_COPY_WRITE_BUFFER, m_size, NULL, GL_STREAM_DRAW);
+		}
+		glBufferSubData(GL_COPY_WRITE_BUFFER, offset, size, pData);
+	}
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+/***********************************************************
+ *  CountUpdate()
+ *
+ *  This method is used for counting an update and the
+ *  frames in a row the buffer was updated in. Once a static
+ *  or dynamic buffer goes past what its class allows, every
+ *  further update counts as a misuse, and the first one is
+ *  reported with the class the buffer should have.
+ ***********************************************************/
+void GPUBuffer::CountUpdate(GLsizeiptr size)
+{
+	s_stats[m_usage].updates++;
+	s_stats[m_usage].updateBytes += (unsigned long long)size;
+
+	if (m_lastUpdateFrame != s_frame)
+	{
+		m_updateFrames = (m_lastUpdateFrame + 1 == s_frame) ? m_updateFrames + 1 : 1;
+		m_lastUpdateFrame = s_frame;
+	}
+
+	int allowedFrames = (m_usage == USAGE_STATIC) ? STATIC_UPDATE_FRAMES :
+		((m_usage == USAGE_DYNAMIC) ? DYNAMIC_UPDATE_FRAMES : 0);
+	if ((allowedFrames == 0) || (m_updateFrames <= allowedFrames))
+	{
+		return;
+	}
+
+	s_stats[m_usage].misuses++;
+	if (m_bMisuseReported == false)
+	{
+		m_bMisuseReported = true;
+		std::cout << "Warning: " << USAGE_NAMES[m_usage] << " buffer " << m_owner
+			<< " was updated " << m_updateFrames << " frames in a row, it should be "
+			<< ((m_usage == USAGE_STATIC) ? "dynamic or stream" : "stream") << std::endl;
+	}
+}
+
+/***********************************************************
+ *  GetUpdateBytes()
+ *
+ *  This method is used for the bytes every class wrote
+ *  since the start.
+ ***********************************************************/
+unsigned long long GPUBuffer::GetUpdateBytes()
+{
+	unsigned long long bytes = 0;
+	for (int i = 0; i < USAGE_COUNT; i++)
+	{
+		bytes += s_stats[i].updateBytes;
+	}
+	return(bytes);
+}
+
+/***********************************************************
+ *  GetMisuses()
+ *
+ *  This method is used for the updates of every class made
+ *  more often than the class expects, since the start.
+ ***********************************************************/
+unsigned long long GPUBuffer::GetMisuses()
+{
+	unsigned long long misuses = 0;
+	for (int i = 0; i < USAGE_COUNT; i++)
+	{
+		misuses += s_stats[i].misuses;
+	}
+	return(misuses);
+}
+
+/***********************************************************
+ *  GetUsageName()
+ *
+ *  This method is used for the name of a usage class.
+ ***********************************************************/
+const char* GPUBuffer::GetUsageName(int usage)
+{
+	return(((usage >= 0) && (usage < USAGE_COUNT)) ? USAGE_NAMES[usage] : "");
+}
+
+/***********************************************************
+ *  Print()
+ *
+ *  This method is used for printing the buffers and updates
+ *  of every usage class for the exit report.
+ ***********************************************************/
+void GPUBuffer::Print()
+{
+	for (int i = 0; i < USAGE_COUNT; i++)
+	{
+		std::cout << USAGE_NAMES[i] << " buffers " << s_stats[i].buffers
+			<< "\tKB " << s_stats[i].bytes / 1024
+			<< "\tupdates " << s_stats[i].updates
+			<< "\tKB written " << s_stats[i].updateBytes / 1024
+			<< "\tmisused " << s_stats[i].misuses << "\n";
+	}
+}
@@ -0,0 +1,116 @@
+///////////////////////////////////////////////////////////////////////////////
+// gpubuffer.h
+// ============
+// buffer objects created for how often they are written
+//
+//  A buffer the driver is told is static is placed where the GPU reads
+//  it fastest and updating it costs a copy or a stall, while a buffer
+//  rewritten every frame is better renamed each time than waited on.
+//  Each buffer here is created for one usage class, which picks its
+//  storage and how an update reaches it: a static buffer has immutable
+//  storage and is updated through a staging copy, a dynamic one is
+//  written in place, and a stream buffer is orphaned whenever it is
+//  rewritten from the start, so the driver hands it fresh memory
+//  instead of waiting for the draws still reading the old. The data of
+//  the frame written at many offsets goes through the upload ring
+//  instead, which sub-allocates one persistently mapped buffer.
+//
+//  The updates are counted per class, and a buffer updated more often
+//  than its class expects, such as a static buffer every frame, is
+//  reported once and counted as a misuse for the render counters.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "GPUMemory.h"
+
+#include <GL/glew.h>
+
+#include <string>
+
+/***********************************************************
+ *  GPUBuffer
+ *
+ *  This class contains one buffer object and the frames it
+ *  was updated in. The buffers are created and updated on
+ *  the thread rendering, which advances the frame.
+ ***********************************************************/
+class GPUBuffer
+{
+public:
+	// constructor
+	GPUBuffer();
+	// destructor
+	~GPUBuffer();
+
+	// how often the contents of a buffer change
+	enum USAGE
+	{
+		USAGE_STATIC = 0,	// written once, rarely updated
+		USAGE_DYNAMIC,		// updated now and then
+		USAGE_STREAM,		// rewritten every frame
+		USAGE_COUNT
+	};
+
+	// the buffers of a usage class and their updates since the start
+	struct USAGE_STATS
+	{
+		unsigned long long buffers;		// live buffers
+		unsigned long long bytes;		// storage of the live buffers
+		unsigned long long updates;		// Update() calls
+		unsigned long long updateBytes;	// bytes they wrote
+		unsigned long long misuses;		// updates more often than the class expects
+	};
+
+	// frames in a row a static or a dynamic buffer is updated in
+	// before its updates count as misuses
+	static const int STATIC_UPDATE_FRAMES = 2;
+	static const int DYNAMIC_UPDATE_FRAMES = 60;
+
+	// create the buffer with size bytes of pData, or undefined
+	// contents without it; its memory is counted in the category
+	// under the owner, which also labels it in the GL debug mode
+	bool Create(USAGE usage, GLsizeiptr size, const void* pData,
+		GPUMemory::CATEGORY category, const char* owner);
+	void Destroy();
+	bool IsCreated() const { return(0 != m_buffer); }
+
+	// write size bytes of pData at offset, the way the usage class
+	// of the buffer asks for
+	void Update(GLintptr offset, GLsizeiptr size, const void* pData);
+
+	GLuint GetName() const { return(m_buffer); }
+	GLsizeiptr GetSize() const { return(m_size); }
+	USAGE GetUsage() const { return(m_usage); }
+
+	// start the next frame the updates are counted in
+	static void BeginFrame() { s_frame++; }
+
+	static const USAGE_STATS& GetStats(int usage) { return(s_stats[usage]); }
+	// bytes written and misused updates of every class since the start
+	static unsigned long long GetUpdateBytes();
+	static unsigned long long GetMisuses();
+	static const char* GetUsageName(int usage);
+	// print the classes for the exit report
+	static void Print();
+
+private:
+	GLuint m_buffer;
+	GLsizeiptr m_size;
+	USAGE m_usage;
+	std::string m_owner;
+	// frame of the last update and the frames in a row it ends
+	unsigned long long m_lastUpdateFrame;
+	int m_updateFrames;
+	bool m_bMisuseReported;
+
+	static unsigned long long s_frame;
+	static USAGE_STATS s_stats[USAGE_COUNT];
+
+	// count an update against the frames in a row allowed to the class
+	void CountUpdate(GLsizeiptr size);
+
+	// not copyable, the buffer is owned
+	GPUBuffer(const GPUBuffer&);
+	GPUBuffer& operator=(const GPUBuffer&);
+};
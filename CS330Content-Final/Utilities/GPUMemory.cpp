@@ -0,0 +1,619 @@
+///////////////////////////////////////////////////////////////////////////////
+// gpumemory.cpp
+// ============
+// accounting of the video memory held by every buffer, texture and
+// renderbuffer
+//
+//  GL gives no way to ask what the objects of a context hold, so the
+//  memory a deployed machine runs short of cannot be traced to the
+//  meshes, the textures or the render targets after the fact. Every
+//  module creating storage registers it here with its size, format,
+//  mip levels and owner, and deletes it through here, so the totals
+//  of each category and their peaks are known at any time, and the
+//  whole list can be dumped on demand. Where the driver reports its
+//  free memory, through NVX_gpu_memory_info or ATI_meminfo, the memory
+//  it lost since startup is shown beside the tracked total, which
+//  shows what the accounting misses, such as the driver's own copies.
+//  The CPU copies modules keep of what they sent to GL are counted
+//  apart from it, by owner, since they weigh on the memory of a small
+//  machine as well.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "GPUMemory.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#include <vector>
+
+const char* const GPUMemory::DUMP_FILE = "gpu_memory.csv";
+std::mutex GPUMemory::s_mutex;
+std::map<unsigned long long, GPUMemory::RESOURCE> GPUMemory::s_resources;
+GPUMemory::CATEGORY_TOTAL GPUMemory::s_totals[GPUMemory::CATEGORY_COUNT] = {};
+std::map<std::string, std::pair<unsigned long long, GPUMemory::CATEGORY>> GPUMemory::s_hostCopies;
+GPUMemory::CATEGORY_TOTAL GPUMemory::s_hostTotals[GPUMemory::CATEGORY_COUNT] = {};
+unsigned long long GPUMemory::s_totalBytes = 0;
+unsigned long long GPUMemory::s_peakBytes = 0;
+bool GPUMemory::s_bBaseline = false;
+GPUMemory::DRIVER_MEMORY GPUMemory::s_baseline = {};
+
+namespace
+{
+	// names of the categories and kinds in the output
+	const char* const CATEGORY_NAMES[GPUMemory::CATEGORY_COUNT] =
+	{
+		"meshes",
+		"textures",
+		"render targets",
+		"buffers"
+	};
+	const char* const KIND_NAMES[GPUMemory::KIND_COUNT] =
+	{
+		"buffer",
+		"texture",
+		"renderbuffer"
+	};
+
+	const double BYTES_PER_MB = 1024.0 * 1024.0;
+
+	// key of an object in the resources
+	unsigned long long MakeKey(GPUMemory::KIND kind, GLuint name)
+	{
+		return(((unsigned long long)kind << 32) | (unsigned long long)name);
+	}
+
+	// size of a block of a format, 1x1 for the uncompressed ones
+	void GetBlock(GLenum internalFormat, int& blockWidth, int& blockHeight, int& blockBytes)
+	{
+		blockWidth = 1;
+		blockHeight = 1;
+		switch (internalFormat)
+		{
+		case GL_R8:
+		case GL_R8UI:
+		case GL_STENCIL_INDEX8:
+			blockBytes = 1;
+			break;
+		case GL_RG8:
+		case GL_RG8_SNORM:
+		case GL_R16F:
+		case GL_R16UI:
+		case GL_DEPTH_COMPONENT16:
+			blockBytes = 2;
+			break;
+		case GL_RGBA16F:
+		case GL_RG32F:
+		case GL_RG32UI:
+		case GL_DEPTH32F_STENCIL8:
+			blockBytes = 8;
+			break;
+		case GL_RGBA32F:
+		case GL_RGBA32UI:
+			blockBytes = 16;
+			break;
+		case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+		case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:
+		case GL_COMPRESSED_RED_RGTC1:
+			blockWidth = 4;
+			blockHeight = 4;
+			blockBytes = 8;
+			break;
+		case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+		case GL_COMPRESSED_RG_RGTC2:
+		case GL_COMPRESSED_RGBA_BPTC_UNORM:
+		case GL_COMPRESSED_RGBA_ASTC_4x4_KHR:
+			blockWidth = 4;
+			blockHeight = 4;
+			blockBytes = 16;
+			break;
+		case GL_COMPRESSED_RGBA_ASTC_6x6_KHR:
+			blockWidth = 6;
+			blockHeight = 6;
+			blockBytes = 16;
+			break;
+		case GL_COMPRESSED_RGBA_ASTC_8x8_KHR:
+			blockWidth = 8;
+			blockHeight = 8;
+			blockBytes = 16;
+			break;
+		default:
+			// RGBA8, R32F, the packed R11F_G11F_B10F and RGB10_A2, the
+			// two channel 16 bit formats, the 24 and 32 bit depths, and
+			// RGB8, which the drivers store padded to four bytes
+			blockBytes = 4;
+			break;
+		}
+	}
+
+	// name of a format for the dump
+	const char* GetFormatName(GLenum internalFormat)
+	{
+		switch (internalFormat)
+		{
+		case GL_NONE: return("-");
+		case GL_R8: return("R8");
+		case GL_R8UI: return("R8UI");
+		case GL_RG8: return("RG8");
+		case GL_RGB8: return("RGB8");
+		case GL_RGBA8: return("RGBA8");
+		case GL_RG8_SNORM: return("RG8_SNORM");
+		case GL_RG16_SNORM: return("RG16_SNORM");
+		case GL_RGB10_A2: return("RGB10_A2");
+		case GL_R11F_G11F_B10F: return("R11F_G11F_B10F");
+		case GL_R16F: return("R16F");
+		case GL_RG16F: return("RG16F");
+		case GL_RGBA16F: return("RGBA16F");
+		case GL_R32F: return("R32F");
+		case GL_RGBA32F: return("RGBA32F");
+		case GL_DEPTH_COMPONENT16: return("DEPTH16");
+		case GL_DEPTH_COMPONENT24: return("DEPTH24");
+		case GL_DEPTH_COMPONENT32F: return("DEPTH32F");
+		case GL_DEPTH24_STENCIL8: return("DEPTH24_STENCIL8");
+		case GL_COMPRESSED_RGB_S3TC_DXT1_EXT: return("BC1");
+		case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT: return("BC3");
+		case GL_COMPRESSED_RG_RGTC2: return("BC5");
+		case GL_COMPRESSED_RGBA_BPTC_UNORM: return("BC7");
+		case GL_COMPRESSED_RGBA_ASTC_4x4_KHR: return("ASTC4x4");
+		case GL_COMPRESSED_RGBA_ASTC_6x6_KHR: return("ASTC6x6");
+		case GL_COMPRESSED_RGBA_ASTC_8x8_KHR: return("ASTC8x8");
+		default: return("other");
+		}
+	}
+
+	// largest resources first, for the dump
+	bool IsLarger(const GPUMemory::RESOURCE& a, const GPUMemory::RESOURCE& b)
+	{
+		return(a.bytes > b.bytes);
+	}
+}
+
+/***********************************************************
+ *  CaptureBaseline()
+ *
+ *  This method is used for noting the free memory of the
+ *  driver, once the context is current and before the scene
+ *  creates anything.
+ ***********************************************************/
+void GPUMemory::CaptureBaseline()
+{
+	DRIVER_MEMORY memory;
+	if (QueryDriverMemory(memory) == true)
+	{
+		std::lock_guard<std::mutex> lock(s_mutex);
+		s_baseline = memory;
+		s_bBaseline = true;
+	}
+}
+
+/***********************************************************
+ *  Track()
+ *
+ *  This method is used for adding a resource, or replacing
+ *  the one of the same object, and updating the totals and
+ *  their peaks.
+ ***********************************************************/
+void GPUMemory::Track(const RESOURCE& resource)
+{
+	if (resource.name == 0)
+	{
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(s_mutex);
+	RESOURCE& tracked = s_resources[MakeKey(resource.kind, resource.name)];
+	if (tracked.name != 0)
+	{
+		s_totals[tracked.category].resources--;
+		s_totals[tracked.category].bytes -= tracked.bytes;
+		s_totalBytes -= tracked.bytes;
+	}
+	tracked = resource;
+
+	CATEGORY_TOTAL& total = s_totals[resource.category];
+	total.resources++;
+	total.bytes += resource.bytes;
+	total.peakBytes = std::max(total.peakBytes, total.bytes);
+	s_totalBytes += resource.bytes;
+	s_peakBytes = std::max(s_peakBytes, s_totalBytes);
+}
+
+/***********************************************************
+ *  TrackBuffer()
+ *
+ *  This method is used for registering the storage of a
+ *  buffer.
+ ***********************************************************/
+void GPUMemory::TrackBuffer(GLuint buffer, long long bytes, CATEGORY category, const char* owner)
+{
+	RESOURCE resource;
+	resource.kind = KIND_BUFFER;
+	resource.category = category;
+	resource.name = buffer;
+	resource.internalFormat = GL_NONE;
+	resource.width = (int)std::min(bytes, (long long)0x7fffffff);
+	resource.height = 1;
+	resource.depth = 1;
+	resource.levels = 1;
+	resource.bytes = (unsigned long long)std::max(bytes, 0LL);
+	resource.owner = (NULL != owner) ? owner : "";
+	Track(resource);
+}
+
+/***********************************************************
+ *  TrackTexture()
+ *
+ *  This method is used for registering the storage of a
+ *  texture.
+ ***********************************************************/
+void GPUMemory::TrackTexture(GLuint texture, GLenum internalFormat, int width, int height, int depth, int levels,
+	CATEGORY category, const char* owner)
+{
+	RESOURCE resource;
+	resource.kind = KIND_TEXTURE;
+	resource.category = category;
+	resource.name = texture;
+	resource.internalFormat = internalFormat;
+	resource.width = width;
+	resource.height = height;
+	resource.depth = depth;
+	resource.levels = levels;
+	resource.bytes = GetTextureBytes(internalFormat, width, height, depth, levels);
+	resource.owner = (NULL != owner) ? owner : "";
+	Track(resource);
+}
+
+/***********************************************************
+ *  TrackRenderbuffer()
+ *
+ *  This method is used for registering the storage of a
+ *  renderbuffer, which is always a render target.
+ ***********************************************************/
+void GPUMemory::TrackRenderbuffer(GLuint renderbuffer, GLenum internalFormat, int width, int height, int samples,
+	const char* owner)
+{
+	RESOURCE resource;
+	resource.kind = KIND_RENDERBUFFER;
+	resource.category = CATEGORY_RENDER_TARGET;
+	resource.name = renderbuffer;
+	resource.internalFormat = internalFormat;
+	resource.width = width;
+	resource.height = height;
+	resource.depth = std::max(samples, 1);
+	resource.levels = 1;
+	resource.bytes = GetTextureBytes(internalFormat, width, height, 1, 1) * (unsigned long long)resource.depth;
+	resource.owner = (NULL != owner) ? owner : "";
+	Track(resource);
+}
+
+/***********************************************************
+ *  SetOwner()
+ *
+ *  This method is used for naming the owner of a tracked
+ *  resource, such as a texture created before the tag it
+ *  was loaded for is known.
+ ***********************************************************/
+void GPUMemory::SetOwner(KIND kind, GLuint name, const char* owner)
+{
+	std::lock_guard<std::mutex> lock(s_mutex);
+	std::map<unsigned long long, RESOURCE>::iterator it = s_resources.find(MakeKey(kind, name));
+	if ((it != s_resources.end()) && (NULL != owner))
+	{
+		it->second.owner = owner;
+	}
+}
+
+/***********************************************************
+ *  TrackHostCopy()
+ *
+ *  This method is used for registering the bytes of the CPU
+ *  copies an owner keeps of the data it sent to GL, such as
+ *  the vertices of the meshes, in place of what the owner
+ *  registered before.
+ ***********************************************************/
+void GPUMemory::TrackHostCopy(const char* owner, long long bytes, CATEGORY category)
+{
+	if ((NULL == owner) || (category < 0) || (category >= CATEGORY_COUNT))
+	{
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(s_mutex);
+	std::map<std::string, std::pair<unsigned long long, CATEGORY>>::iterator it = s_hostCopies.find(owner);
+	if (it != s_hostCopies.end())
+	{
+		CATEGORY_TOTAL& previous = s_hostTotals[it->second.second];
+		previous.resources--;
+		previous.bytes -= it->second.first;
+		s_hostCopies.erase(it);
+	}
+	if (bytes <= 0)
+	{
+		return;
+	}
+
+	s_hostCopies[owner] = std::make_pair((unsigned long long)bytes, category);
+	CATEGORY_TOTAL& total = s_hostTotals[category];
+	total.resources++;
+	total.bytes += (unsigned long long)bytes;
+	total.peakBytes = std::max(total.peakBytes, total.bytes);
+}
+
+/***********************************************************
+ *  Release()
+ *
+ *  This method is used for removing the resources of
+ *  deleted objects from the totals.
+ ***********************************************************/
+void GPUMemory::Release(KIND kind, GLsizei count, const GLuint* pNames)
+{
+	std::lock_guard<std::mutex> lock(s_mutex);
+	for (GLsizei i = 0; i < count; i++)
+	{
+		std::map<unsigned long long, RESOURCE>::iterator it = s_resources.find(MakeKey(kind, pNames[i]));
+		if (it == s_resources.end())
+		{
+			continue;
+		}
+		s_totals[it->second.category].resources--;
+		s_totals[it->second.category].bytes -= it->second.bytes;
+		s_totalBytes -= it->second.bytes;
+		s_resources.erase(it);
+	}
+}
+
+/***********************************************************
+ *  DeleteBuffers()
+ *
+ *  This method is used for deleting buffers and releasing
+ *  what they held.
+ ***********************************************************/
+void GPUMemory::DeleteBuffers(GLsizei count, const GLuint* pBuffers)
+{
+	Release(KIND_BUFFER, count, pBuffers);
+	glDeleteBuffers(count, pBuffers);
+}
+
+/***********************************************************
+ *  DeleteTextures()
+ *
+ *  This method is used for deleting textures and releasing
+ *  what they held.
+ ***********************************************************/
+void GPUMemory::DeleteTextures(GLsizei count, const GLuint* pTextures)
+{
+	Release(KIND_TEXTURE, count, pTextures);
+	glDeleteTextures(count, pTextures);
+}
+
+/***********************************************************
+ *  DeleteRenderbuffers()
+ *
+ *  This method is used for deleting renderbuffers and
+ *  releasing what they held.
+ ***********************************************************/
+void GPUMemory::DeleteRenderbuffers(GLsizei count, const GLuint* pRenderbuffers)
+{
+	Release(KIND_RENDERBUFFER, count, pRenderbuffers);
+	glDeleteRenderbuffers(count, pRenderbuffers);
+}
+
+/***********************************************************
+ *  GetTextureBytes()
+ *
+ *  This method is used for getting the bytes of a texture,
+ *  summing its levels, each half the size of the one above
+ *  and at least one block across.
+ ***********************************************************/
+unsigned long long GPUMemory::GetTextureBytes(GLenum internalFormat, int width, int height, int depth, int levels)
+{
+	int blockWidth = 1;
+	int blockHeight = 1;
+	int blockBytes = 4;
+	GetBlock(internalFormat, blockWidth, blockHeight, blockBytes);
+
+	unsigned long long bytes = 0;
+	for (int level = 0; level < std::max(levels, 1); level++)
+	{
+		unsigned long long blocksX = (unsigned long long)((std::max(width >> level, 1) + blockWidth - 1) / blockWidth);
+		unsigned long long blocksY = (unsigned long long)((std::max(height >> level, 1) + blockHeight - 1) / blockHeight);
+		bytes += blocksX * blocksY * (unsigned long long)blockBytes;
+	}
+	return(bytes * (unsigned long long)std::max(depth, 1));
+}
+
+/***********************************************************
+ *  GetCategoryTotal()
+ *
+ *  This method is used for getting the resources, bytes and
+ *  peak bytes of a category.
+ ***********************************************************/
+GPUMemory::CATEGORY_TOTAL GPUMemory::GetCategoryTotal(int category)
+{
+	std::lock_guard<std::mutex> lock(s_mutex);
+	return(s_totals[category]);
+}
+
+/***********************************************************
+ *  GetHostTotal()
+ *
+ *  This method is used for getting the owners, bytes and
+ *  peak bytes of the CPU copies of a category.
+ ***********************************************************/
+GPUMemory::CATEGORY_TOTAL GPUMemory::GetHostTotal(int category)
+{
+	std::lock_guard<std::mutex> lock(s_mutex);
+	return(s_hostTotals[category]);
+}
+
+/***********************************************************
+ *  GetTotalBytes()
+ *
+ *  This method is used for getting the bytes of every
+ *  tracked resource.
+ ***********************************************************/
+unsigned long long GPUMemory::GetTotalBytes()
+{
+	std::lock_guard<std::mutex> lock(s_mutex);
+	return(s_totalBytes);
+}
+
+/***********************************************************
+ *  GetPeakBytes()
+ *
+ *  This method is used for getting the most bytes tracked
+ *  at any one time.
+ ***********************************************************/
+unsigned long long GPUMemory::GetPeakBytes()
+{
+	std::lock_guard<std::mutex> lock(s_mutex);
+	return(s_peakBytes);
+}
+
+/***********************************************************
+ *  GetCategoryName()
+ *
+ *  This method is used for getting the name of a category.
+ ***********************************************************/
+const char* GPUMemory::GetCategoryName(int category)
+{
+	if ((category < 0) || (category >= CATEGORY_COUNT))
+	{
+		return("unknown");
+	}
+	return(CATEGORY_NAMES[category]);
+}
+
+/***********************************************************
+ *  QueryDriverMemory()
+ *
+ *  This method is used for asking the driver for its free
+ *  video memory, through NVX_gpu_memory_info on NVIDIA or
+ *  the texture pool of ATI_meminfo on AMD. It needs the
+ *  context current.
+ ***********************************************************/
+bool GPUMemory::QueryDriverMemory(DRIVER_MEMORY& memory)
+{
+	memory.source = "none";
+	memory.totalKB = 0;
+	memory.freeKB = 0;
+	if (GLEW_NVX_gpu_memory_info)
+	{
+		GLint totalKB = 0;
+		GLint freeKB = 0;
+		glGetIntegerv(GL_GPU_MEMORY_INFO_DEDICATED_VIDMEM_NVX, &totalKB);
+		glGetIntegerv(GL_GPU_MEMORY_INFO_CURRENT_AVAILABLE_VIDMEM_NVX, &freeKB);
+		memory.source = "NVX_gpu_memory_info";
+		memory.totalKB = totalKB;
+		memory.freeKB = freeKB;
+		return(true);
+	}
+	if (GLEW_ATI_meminfo)
+	{
+		// total free, largest free block, and the same for the
+		// shared memory
+		GLint pool[4] = {};
+		glGetIntegerv(GL_TEXTURE_FREE_MEMORY_ATI, pool);
+		memory.source = "ATI_meminfo";
+		memory.freeKB = pool[0];
+		return(true);
+	}
+	return(false);
+}
+
+/***********************************************************
+ *  Print()
+ *
+ *  This method is used for printing the tracked bytes and
+ *  peak of every category, and the memory the driver lost
+ *  since the baseline beside the tracked total.
+ ***********************************************************/
+void GPUMemory::Print()
+{
+	DRIVER_MEMORY memory;
+	bool bDriver = QueryDriverMemory(memory);
+
+	std::lock_guard<std::mutex> lock(s_mutex);
+	std::cout << "\n*** GPU MEMORY: ***\n";
+	for (int i = 0; i < CATEGORY_COUNT; i++)
+	{
+		std::cout << CATEGORY_NAMES[i]
+			<< "\tresources " << s_totals[i].resources
+			<< "\t" << (double)s_totals[i].bytes / BYTES_PER_MB << " MB"
+			<< "\tpeak " << (double)s_totals[i].peakBytes / BYTES_PER_MB << " MB\n";
+	}
+	std::cout << "tracked\t" << (double)s_totalBytes / BYTES_PER_MB << " MB"
+		<< "\tpeak " << (double)s_peakBytes / BYTES_PER_MB << " MB\n";
+	for (int i = 0; i < CATEGORY_COUNT; i++)
+	{
+		if (s_hostTotals[i].peakBytes == 0)
+		{
+			continue;
+		}
+		std::cout << "CPU copies of " << CATEGORY_NAMES[i]
+			<< "\towners " << s_hostTotals[i].resources
+			<< "\t" << (double)s_hostTotals[i].bytes / BYTES_PER_MB << " MB"
+			<< "\tpeak " << (double)s_hostTotals[i].peakBytes / BYTES_PER_MB << " MB\n";
+	}
+
+	if (bDriver == false)
+	{
+		std::cout << "driver\tno memory info extension\n";
+		return;
+	}
+	std::cout << "driver\t" << memory.source << "\tfree " << (double)memory.freeKB / 1024.0 << " MB";
+	if (memory.totalKB > 0)
+	{
+		std::cout << " of " << (double)memory.totalKB / 1024.0 << " MB";
+	}
+	if (s_bBaseline == true)
+	{
+		std::cout << "\tused since startup " << (double)(s_baseline.freeKB - memory.freeKB) / 1024.0 << " MB";
+	}
+	std::cout << "\n";
+}
+
+/***********************************************************
+ *  Dump()
+ *
+ *  This method is used for writing every tracked resource,
+ *  largest first, as CSV. It makes no GL calls.
+ ***********************************************************/
+bool GPUMemory::Dump(const char* filename)
+{
+	std::vector<RESOURCE> resources;
+	unsigned long long totalBytes = 0;
+	unsigned long long peakBytes = 0;
+	{
+		std::lock_guard<std::mutex> lock(s_mutex);
+		totalBytes = s_totalBytes;
+		peakBytes = s_peakBytes;
+		for (std::map<unsigned long long, RESOURCE>::const_iterator it = s_resources.begin(); it != s_resources.end(); ++it)
+		{
+			resources.push_back(it->second);
+		}
+	}
+	std::sort(resources.begin(), resources.end(), IsLarger);
+
+	FILE* file = fopen(filename, "wb");
+	if (file == NULL)
+	{
+		std::cout << "Could not create GPU memory dump " << filename << std::endl;
+		return(false);
+	}
+	fprintf(file, "category,kind,name,owner,format,width,height,depth,levels,bytes\n");
+	for (size_t i = 0; i < resources.size(); i++)
+	{
+		const RESOURCE& resource = resources[i];
+		fprintf(file, "%s,%s,%u,\"%s\",%s,%d,%d,%d,%d,%llu\n", CATEGORY_NAMES[resource.category],
+			KIND_NAMES[resource.kind], resource.name, resource.owner.c_str(), GetFormatName(resource.internalFormat),
+			resource.width, resource.height, resource.depth, resource.levels, resource.bytes);
+	}
+	bool bWritten = (ferror(file) == 0);
+	fclose(file);
+	if (bWritten == true)
+	{
+		std::cout << "Wrote " << resources.size() << " GPU resources of " << (double)totalBytes / BYTES_PER_MB
+			<< " MB, peak " << (double)peakBytes / BYTES_PER_MB << " MB, to " << filename << std::endl;
+	}
+	return(bWritten);
+}
@@ -0,0 +1,153 @@
+///////////////////////////////////////////////////////////////////////////////
+// gpumemory.h
+// ============
+// accounting of the video memory held by every buffer, texture and
+// renderbuffer
+//
+//  GL gives no way to ask what the objects of a context hold, so the
+//  memory a deployed machine runs short of cannot be traced to the
+//  meshes, the textures or the render targets after the fact. Every
+//  module creating storage registers it here with its size, format,
+//  mip levels and owner, and deletes it through here, so the totals
+//  of each category and their peaks are known at any time, and the
+//  whole list can be dumped on demand. Where the driver reports its
+//  free memory, through NVX_gpu_memory_info or ATI_meminfo, the memory
+//  it lost since startup is shown beside the tracked total, which
+//  shows what the accounting misses, such as the driver's own copies.
+//  The CPU copies modules keep of what they sent to GL are counted
+//  apart from it, by owner, since they weigh on the memory of a small
+//  machine as well.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+#include <map>
+#include <mutex>
+#include <string>
+
+/***********************************************************
+ *  GPUMemory
+ *
+ *  This class contains the tracked resources and their
+ *  totals. It is used through static methods, like GLDebug,
+ *  since the meshes, textures and targets are created by
+ *  many modules and on the loader thread as well.
+ ***********************************************************/
+class GPUMemory
+{
+public:
+	// what a resource is used for, which the totals are kept by
+	enum CATEGORY
+	{
+		CATEGORY_MESH = 0,		// vertex, index and meshlet buffers
+		CATEGORY_TEXTURE,		// material textures and their placeholders
+		CATEGORY_RENDER_TARGET,	// color, depth and shadow targets
+		CATEGORY_BUFFER,		// uniform, storage, staging and upload buffers
+		CATEGORY_COUNT
+	};
+
+	// the kind of GL object, since buffers, textures and
+	// renderbuffers have separate names
+	enum KIND
+	{
+		KIND_BUFFER = 0,
+		KIND_TEXTURE,
+		KIND_RENDERBUFFER,
+		KIND_COUNT
+	};
+
+	struct RESOURCE
+	{
+		KIND kind;
+		CATEGORY category;
+		GLuint name;
+		GLenum internalFormat;	// GL_NONE for buffers
+		int width;				// bytes of a buffer
+		int height;
+		int depth;				// layers of an array, samples of a renderbuffer
+		int levels;
+		unsigned long long bytes;
+		std::string owner;
+	};
+
+	struct CATEGORY_TOTAL
+	{
+		unsigned long long resources;
+		unsigned long long bytes;
+		unsigned long long peakBytes;
+	};
+
+	// free video memory the driver reports, in kilobytes
+	struct DRIVER_MEMORY
+	{
+		const char* source;		// the extension it came from
+		long long totalKB;		// dedicated memory, 0 when unknown
+		long long freeKB;
+	};
+
+	// file F9 writes the resources to
+	static const char* const DUMP_FILE;
+
+	// note the free memory the driver reports before anything is
+	// created, which the memory it lost later is measured from
+	static void CaptureBaseline();
+
+	// register the storage of a buffer, replacing what was tracked
+	// for it, as glBufferData() does for the buffer
+	static void TrackBuffer(GLuint buffer, long long bytes, CATEGORY category, const char* owner);
+	// register the storage of a texture of levels mip levels and
+	// depth layers or slices
+	static void TrackTexture(GLuint texture, GLenum internalFormat, int width, int height, int depth, int levels,
+		CATEGORY category, const char* owner);
+	static void TrackRenderbuffer(GLuint renderbuffer, GLenum internalFormat, int width, int height, int samples,
+		const char* owner);
+	// name the owner of a resource tracked before it was known
+	static void SetOwner(KIND kind, GLuint name, const char* owner);
+	// register the bytes of the CPU copies an owner keeps of data it
+	// sent to GL, replacing what was tracked for the owner; 0 stops
+	// tracking it
+	static void TrackHostCopy(const char* owner, long long bytes, CATEGORY category);
+
+	// delete GL objects and stop tracking them, for every object
+	// that was tracked
+	static void DeleteBuffers(GLsizei count, const GLuint* pBuffers);
+	static void DeleteTextures(GLsizei count, const GLuint* pTextures);
+	static void DeleteRenderbuffers(GLsizei count, const GLuint* pRenderbuffers);
+
+	// bytes of a texture of a format, counting the blocks of the
+	// compressed formats
+	static unsigned long long GetTextureBytes(GLenum internalFormat, int width, int height, int depth, int levels);
+
+	static CATEGORY_TOTAL GetCategoryTotal(int category);
+	// the CPU copies of a category, an owner counted as a resource
+	static CATEGORY_TOTAL GetHostTotal(int category);
+	static unsigned long long GetTotalBytes();
+	static unsigned long long GetPeakBytes();
+	static const char* GetCategoryName(int category);
+	// free memory of the driver now; false when it reports none
+	static bool QueryDriverMemory(DRIVER_MEMORY& memory);
+
+	// print the totals of every category and the driver's view
+	static void Print();
+	// write every resource, largest first, as CSV
+	static bool Dump(const char* filename);
+
+private:
+	// guards the resources, since the loader thread creates textures
+	static std::mutex s_mutex;
+	// resources by kind in the high bits and name in the low
+	static std::map<unsigned long long, RESOURCE> s_resources;
+	static CATEGORY_TOTAL s_totals[CATEGORY_COUNT];
+	// bytes and category of the CPU copies by owner
+	static std::map<std::string, std::pair<unsigned long long, CATEGORY>> s_hostCopies;
+	static CATEGORY_TOTAL s_hostTotals[CATEGORY_COUNT];
+	static unsigned long long s_totalBytes;
+	static unsigned long long s_peakBytes;
+	static bool s_bBaseline;
+	static DRIVER_MEMORY s_baseline;
+
+	static void Track(const RESOURCE& resource);
+	static void Release(KIND kind, GLsizei count, const GLuint* pNames);
+};
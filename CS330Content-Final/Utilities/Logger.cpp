@@ -0,0 +1,324 @@
+///////////////////////////////////////////////////////////////////////////////
+// logger.cpp
+// ============
+// console messages formatted where they happen and written off the thread
+//
+//  A LOG_*() macro formats its message into a ring of the calling
+//  thread, taking no lock, and a writer thread drains the rings of
+//  every thread in time order every few milliseconds. Errors are
+//  written at once, after whatever was queued, and so is everything
+//  logged while the writer is not running.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "Logger.h"
+#include "ScopeProfiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
+std::atomic<int> Logger::s_minSeverity(Logger::SEVERITY_INFO);
+std::atomic<bool> Logger::s_bRunning(false);
+std::atomic<unsigned long long> Logger::s_dropped(0);
+std::atomic<unsigned long long> Logger::s_limited(0);
+unsigned long long Logger::s_written = 0;
+std::mutex Logger::s_threadsMutex;
+std::vector<Logger::THREAD_BUFFER*> Logger::s_threads;
+std::mutex Logger::s_outputMutex;
+std::vector<Logger::MESSAGE> Logger::s_pending;
+std::thread Logger::s_thread;
+std::mutex Logger::s_wakeMutex;
+std::condition_variable Logger::s_wake;
+bool Logger::s_bStopping = false;
+int Logger::s_intervalMilliseconds = Logger::DEFAULT_INTERVAL_MILLISECONDS;
+
+namespace
+{
+	// ring of the calling thread, once it has one
+	thread_local void* t_pThreadBuffer = NULL;
+
+	// messages are written in the order they were logged
+	struct MESSAGE_TIME_ORDER
+	{
+		template <typename T>
+		bool operator()(const T& a, const T& b) const { return(a.nanoseconds < b.nanoseconds); }
+	};
+}
+
+/***********************************************************
+ *  Start()
+ *
+ *  This method is used for starting the writer thread, from
+ *  when on messages other than errors are queued.
+ ***********************************************************/
+void Logger::Start(int intervalMilliseconds)
+{
+	if (IsRunning() == true)
+	{
+		return;
+	}
+
+	s_intervalMilliseconds = intervalMilliseconds;
+	s_bStopping = false;
+	s_thread = std::thread(&Logger::WriterLoop);
+	s_bRunning.store(true, std::memory_order_release);
+}
+
+/***********************************************************
+ *  Stop()
+ *
+ *  This method is used for ending the writer thread and
+ *  writing what the threads queued since it last drained.
+ *  Messages logged from then on are written at once.
+ ***********************************************************/
+void Logger::Stop()
+{
+	if (IsRunning() == false)
+	{
+		return;
+	}
+
+	s_bRunning.store(false, std::memory_order_release);
+	{
+		std::lock_guard<std::mutex> lock(s_wakeMutex);
+		s_bStopping = true;
+	}
+	s_wake.notify_one();
+	s_thread.join();
+	Flush();
+}
+
+/***********************************************************
+ *  Flush()
+ *
+ *  This method is used for writing the queued messages of
+ *  every thread now.
+ ***********************************************************/
+void Logger::Flush()
+{
+	std::lock_guard<std::mutex> lock(s_outputMutex);
+	DrainLocked();
+}
+
+/***********************************************************
+ *  GetThreadBuffer()
+ *
+ *  This method is used for getting the ring of the calling
+ *  thread, registering it the first time. Only this first
+ *  call takes the lock.
+ ***********************************************************/
+Logger::THREAD_BUFFER* Logger::GetThreadBuffer()
+{
+	if (t_pThreadBuffer == NULL)
+	{
+		THREAD_BUFFER* pBuffer = new THREAD_BUFFER();
+		pBuffer->messages.resize(MESSAGES_PER_THREAD);
+		pBuffer->queued.store(0, std::memory_order_relaxed);
+		pBuffer->taken.store(0, std::memory_order_relaxed);
+
+		std::lock_guard<std::mutex> lock(s_threadsMutex);
+		s_threads.push_back(pBuffer);
+		t_pThreadBuffer = pBuffer;
+	}
+	return((THREAD_BUFFER*)t_pThreadBuffer);
+}
+
+/***********************************************************
+ *  Write()
+ *
+ *  This method is used for logging a message formatted like
+ *  printf(), without a trailing newline.
+ ***********************************************************/
+void Logger::Write(SEVERITY severity, const char* format, ...)
+{
+	va_list arguments;
+	va_start(arguments, format);
+	WriteArguments(severity, 0, format, arguments);
+	va_end(arguments);
+}
+
+/***********************************************************
+ *  WriteLimited()
+ *
+ *  This method is used for logging a message of a call site
+ *  unless the last one it logged was under the interval
+ *  ago. The message after a quiet spell tells how many were
+ *  left out. Of threads racing for the same slot, only the
+ *  one moving the time on writes.
+ ***********************************************************/
+void Logger::WriteLimited(RATE_LIMIT& limit, int intervalMilliseconds, SEVERITY severity, const char* format, ...)
+{
+	long long now = ScopeProfiler::Now();
+	long long next = limit.nextNanoseconds.load(std::memory_order_relaxed);
+	if ((now < next) || (limit.nextNanoseconds.compare_exchange_strong(next,
+		now + (long long)intervalMilliseconds * 1000000, std::memory_order_relaxed) == false))
+	{
+		limit.suppressed.fetch_add(1, std::memory_order_relaxed);
+		s_limited.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+
+	va_list arguments;
+	va_start(arguments, format);
+	WriteArguments(severity, limit.suppressed.exchange(0, std::memory_order_relaxed), format, arguments);
+	va_end(arguments);
+}
+
+/***********************************************************
+ *  WriteArguments()
+ *
+ *  This method is used for formatting a message straight
+ *  into the next slot of the ring of the calling thread and
+ *  publishing it for the writer. A full ring drops the
+ *  message rather than wait. Errors, and every message
+ *  while the writer is not running, are written at once
+ *  and whole, after the queued ones.
+ ***********************************************************/
+void Logger::WriteArguments(SEVERITY severity, unsigned int suppressed, const char* format, va_list arguments)
+{
+	if ((severity == SEVERITY_ERROR) || (IsRunning() == false))
+	{
+		// written whole, as a compile log may run long
+		va_list measure;
+		va_copy(measure, arguments);
+		int length = vsnprintf(NULL, 0, format, measure);
+		va_end(measure);
+		std::vector<char> text((length > 0) ? length + 32 : 32, '\0');
+		vsnprintf(&text[0], text.size(), format, arguments);
+		if ((suppressed > 0) && (length >= 0))
+		{
+			snprintf(&text[length], text.size() - length, " (%u more suppressed)", suppressed);
+		}
+		std::lock_guard<std::mutex> lock(s_outputMutex);
+		DrainLocked();
+		Output(severity, &text[0]);
+		return;
+	}
+
+	THREAD_BUFFER* pBuffer = GetThreadBuffer();
+	unsigned long long queued = pBuffer->queued.load(std::memory_order_relaxed);
+	if (queued - pBuffer->taken.load(std::memory_order_acquire) >= MESSAGES_PER_THREAD)
+	{
+		s_dropped.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+
+	MESSAGE& message = pBuffer->messages[queued % MESSAGES_PER_THREAD];
+	message.nanoseconds = ScopeProfiler::Now();
+	message.severity = severity;
+	int length = vsnprintf(message.text, sizeof(message.text), format, arguments);
+	if ((suppressed > 0) && (length >= 0) && (length < MESSAGE_LENGTH))
+	{
+		snprintf(message.text + length, sizeof(message.text) - length, " (%u more suppressed)", suppressed);
+	}
+	pBuffer->queued.store(queued + 1, std::memory_order_release);
+}
+
+/***********************************************************
+ *  DrainLocked()
+ *
+ *  This method is used for taking the published messages
+ *  of every ring, handing their slots back, and writing
+ *  them merged by the time they were logged.
+ ***********************************************************/
+void Logger::DrainLocked()
+{
+	s_pending.clear();
+	{
+		std::lock_guard<std::mutex> lock(s_threadsMutex);
+		for (size_t i = 0; i < s_threads.size(); i++)
+		{
+			THREAD_BUFFER* pBuffer = s_threads[i];
+			unsigned long long taken = pBuffer->taken.load(std::memory_order_relaxed);
+			unsigned long long queued = pBuffer->queued.load(std::memory_order_acquire);
+			for (unsigned long long m = taken; m < queued; m++)
+			{
+				s_pending.push_back(pBuffer->messages[m % MESSAGES_PER_THREAD]);
+			}
+			pBuffer->taken.store(queued, std::memory_order_release);
+		}
+	}
+	if (s_pending.empty() == true)
+	{
+		return;
+	}
+
+	std::stable_sort(s_pending.begin(), s_pending.end(), MESSAGE_TIME_ORDER());
+	for (size_t i = 0; i < s_pending.size(); i++)
+	{
+		Output(s_pending[i].severity, s_pending[i].text);
+	}
+	fflush(stdout);
+}
+
+/***********************************************************
+ *  Output()
+ *
+ *  This method is used for writing one message to the
+ *  console, warnings and errors marked as such.
+ ***********************************************************/
+void Logger::Output(SEVERITY severity, const char* text)
+{
+	const char* prefix = "";
+	if (severity == SEVERITY_WARNING)
+	{
+		prefix = "WARNING: ";
+	}
+	else if (severity == SEVERITY_ERROR)
+	{
+		prefix = "ERROR: ";
+	}
+	fprintf(stdout, "%s%s\n", prefix, text);
+	s_written++;
+}
+
+/***********************************************************
+ *  WriterLoop()
+ *
+ *  This method is the body of the writer thread, draining
+ *  the rings every interval until Stop().
+ ***********************************************************/
+void Logger::WriterLoop()
+{
+	ScopeProfiler::SetThreadName("logger");
+
+	std::unique_lock<std::mutex> lock(s_wakeMutex);
+	while (s_bStopping == false)
+	{
+		s_wake.wait_for(lock, std::chrono::milliseconds(s_intervalMilliseconds));
+		lock.unlock();
+		Flush();
+		lock.lock();
+	}
+}
+
+/***********************************************************
+ *  GetStats()
+ *
+ *  This method is used for getting the messages written and
+ *  those left out since the launch.
+ ***********************************************************/
+Logger::LOG_STATS Logger::GetStats()
+{
+	LOG_STATS stats;
+	{
+		std::lock_guard<std::mutex> lock(s_outputMutex);
+		stats.written = s_written;
+	}
+	stats.dropped = s_dropped.load(std::memory_order_relaxed);
+	stats.limited = s_limited.load(std::memory_order_relaxed);
+	return(stats);
+}
+
+/***********************************************************
+ *  Print()
+ *
+ *  This method is used for writing the stats to the console
+ *  for the exit report.
+ ***********************************************************/
+void Logger::Print()
+{
+	LOG_STATS stats = GetStats();
+	printf("log messages %llu\trate limited %llu\tdropped %llu\n",
+		stats.written, stats.limited, stats.dropped);
+}
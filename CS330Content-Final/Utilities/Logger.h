@@ -0,0 +1,183 @@
+///////////////////////////////////////////////////////////////////////////////
+// logger.h
+// ============
+// console messages formatted where they happen and written off the thread
+//
+//  Writing to the console flushes and takes the stream lock, which on
+//  the render loop turns a warning repeated every frame into a hitch.
+//  A LOG_*() macro instead formats its message into a ring of the
+//  calling thread, taking no lock, and a writer thread drains the rings
+//  of every thread in time order every few milliseconds. Errors are
+//  written at once, after whatever was queued, so a message before an
+//  exit is never lost; so is everything before Start() or after Stop(),
+//  as the offline modes run without the writer. Messages below
+//  LOG_MIN_SEVERITY are compiled out, the others below the level set at
+//  run time cost one relaxed atomic load, and the *_LIMITED() macros
+//  write a message of their call site at most once per interval,
+//  counting the ones left out.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <atomic>
+#include <cstdarg>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// lowest severity compiled in: 0 debug, 1 info, 2 warning, 3 error
+#ifndef LOG_MIN_SEVERITY
+#ifdef _DEBUG
+#define LOG_MIN_SEVERITY 0
+#else
+#define LOG_MIN_SEVERITY 1
+#endif
+#endif
+
+/***********************************************************
+ *  Logger
+ *
+ *  This class contains the rings the threads queue their
+ *  messages in and the thread writing them. It is used
+ *  through static methods, like the ScopeProfiler, so any
+ *  module can log without being handed an object.
+ ***********************************************************/
+class Logger
+{
+public:
+	// severities, in the order of LOG_MIN_SEVERITY
+	enum SEVERITY
+	{
+		SEVERITY_DEBUG = 0,
+		SEVERITY_INFO = 1,
+		SEVERITY_WARNING = 2,
+		SEVERITY_ERROR = 3
+	};
+
+	// messages queued per thread; a message finding the ring full is
+	// dropped and counted
+	static const int MESSAGES_PER_THREAD = 256;
+	// characters kept of a message, longer ones are cut
+	static const int MESSAGE_LENGTH = 496;
+	// how often the writer drains the rings unless told otherwise
+	static const int DEFAULT_INTERVAL_MILLISECONDS = 20;
+
+	// the call site state of a *_LIMITED() macro, zeroed as a static
+	struct RATE_LIMIT
+	{
+		std::atomic<long long> nextNanoseconds;		// earliest time of the next message
+		std::atomic<unsigned int> suppressed;		// messages left out since the last one
+	};
+
+	// messages since the launch
+	struct LOG_STATS
+	{
+		unsigned long long written;		// messages written to the console
+		unsigned long long dropped;		// messages lost to a full ring
+		unsigned long long limited;		// messages left out by a rate limit
+	};
+
+	// start and stop the writer thread; Stop() writes what is queued
+	static void Start(int intervalMilliseconds = DEFAULT_INTERVAL_MILLISECONDS);
+	static void Stop();
+	static bool IsRunning() { return(s_bRunning.load(std::memory_order_acquire)); }
+	// write the queued messages of every thread now
+	static void Flush();
+
+	// lowest severity written, of those compiled in; info by default
+	static void SetMinSeverity(SEVERITY severity) { s_minSeverity.store(severity, std::memory_order_relaxed); }
+	static bool IsEnabled(SEVERITY severity) { return(severity >= s_minSeverity.load(std::memory_order_relaxed)); }
+
+	// queue a printf() style message; used through the LOG_*() macros
+	static void Write(SEVERITY severity, const char* format, ...);
+	// the same at most once per interval of a call site
+	static void WriteLimited(RATE_LIMIT& limit, int intervalMilliseconds, SEVERITY severity, const char* format, ...);
+
+	static LOG_STATS GetStats();
+	// print the stats for the exit report
+	static void Print();
+
+private:
+	// a formatted message waiting for the writer
+	struct MESSAGE
+	{
+		long long nanoseconds;
+		SEVERITY severity;
+		char text[MESSAGE_LENGTH];
+	};
+
+	// ring of one thread; only its thread queues, only the writer
+	// takes, and each publishes its count after the messages
+	struct THREAD_BUFFER
+	{
+		std::vector<MESSAGE> messages;
+		std::atomic<unsigned long long> queued;
+		std::atomic<unsigned long long> taken;
+	};
+
+	static std::atomic<int> s_minSeverity;
+	static std::atomic<bool> s_bRunning;
+	static std::atomic<unsigned long long> s_dropped;
+	static std::atomic<unsigned long long> s_limited;
+	static unsigned long long s_written;
+	// rings of every thread that logged, kept after the thread ends
+	static std::mutex s_threadsMutex;
+	static std::vector<THREAD_BUFFER*> s_threads;
+	// held while writing to the console, so whole messages go out in
+	// time order from the writer and the threads writing errors
+	static std::mutex s_outputMutex;
+	static std::vector<MESSAGE> s_pending;
+	// the writer thread and what wakes it early
+	static std::thread s_thread;
+	static std::mutex s_wakeMutex;
+	static std::condition_variable s_wake;
+	static bool s_bStopping;
+	static int s_intervalMilliseconds;
+
+	// ring of the calling thread, registered on first use
+	static THREAD_BUFFER* GetThreadBuffer();
+	// queue or write a message of the variable arguments
+	static void WriteArguments(SEVERITY severity, unsigned int suppressed, const char* format, va_list arguments);
+	// take the queued messages of every ring and write them in time
+	// order; called with s_outputMutex held
+	static void DrainLocked();
+	// write one message to the console
+	static void Output(SEVERITY severity, const char* text);
+	// body of the writer thread
+	static void WriterLoop();
+};
+
+// the macros a message is logged with, compiled out below
+// LOG_MIN_SEVERITY; the *_LIMITED() ones take the interval in
+// milliseconds first
+#define LOG_WRITE(severity, ...) do { if (Logger::IsEnabled(severity) == true) { Logger::Write(severity, __VA_ARGS__); } } while (0)
+#define LOG_WRITE_LIMITED(severity, intervalMilliseconds, ...) do { if (Logger::IsEnabled(severity) == true) { \
+	static Logger::RATE_LIMIT logRateLimit; Logger::WriteLimited(logRateLimit, intervalMilliseconds, severity, __VA_ARGS__); } } while (0)
+
+#if LOG_MIN_SEVERITY <= 0
+#define LOG_DEBUG(...) LOG_WRITE(Logger::SEVERITY_DEBUG, __VA_ARGS__)
+#define LOG_DEBUG_LIMITED(intervalMilliseconds, ...) LOG_WRITE_LIMITED(Logger::SEVERITY_DEBUG, intervalMilliseconds, __VA_ARGS__)
+#else
+#define LOG_DEBUG(...) ((void)0)
+#define LOG_DEBUG_LIMITED(intervalMilliseconds, ...) ((void)0)
+#endif
+
+#if LOG_MIN_SEVERITY <= 1
+#define LOG_INFO(...) LOG_WRITE(Logger::SEVERITY_INFO, __VA_ARGS__)
+#define LOG_INFO_LIMITED(intervalMilliseconds, ...) LOG_WRITE_LIMITED(Logger::SEVERITY_INFO, intervalMilliseconds, __VA_ARGS__)
+#else
+#define LOG_INFO(...) ((void)0)
+#define LOG_INFO_LIMITED(intervalMilliseconds, ...) ((void)0)
+#endif
+
+#if LOG_MIN_SEVERITY <= 2
+#define LOG_WARNING(...) LOG_WRITE(Logger::SEVERITY_WARNING, __VA_ARGS__)
+#define LOG_WARNING_LIMITED(intervalMilliseconds, ...) LOG_WRITE_LIMITED(Logger::SEVERITY_WARNING, intervalMilliseconds, __VA_ARGS__)
+#else
+#define LOG_WARNING(...) ((void)0)
+#define LOG_WARNING_LIMITED(intervalMilliseconds, ...) ((void)0)
+#endif
+
+// errors are never compiled out
+#define LOG_ERROR(...) LOG_WRITE(Logger::SEVERITY_ERROR, __VA_ARGS__)
@@ -0,0 +1,123 @@
+///////////////////////////////////////////////////////////////////////////////
+// simdmath.h
+// ============
+// four wide float operations on SSE2 and on ARM64 NEON
+//
+//  The batch kernels of the renderer, the matrix composition and
+//  products, the frustum tests of the BVH and the normal generation,
+//  are written once against these operations, which compile to SSE2
+//  on x86 and x64 and to NEON on ARM64, whichever glm was configured
+//  for. SIMD_FLOAT4 is 0 when glm has neither, such as without
+//  GLM_FORCE_INTRINSICS, and the kernels keep to their scalar loops.
+//  The NEON side needs ARM64 for its division, square root and
+//  horizontal add; 32 bit ARM builds use the scalar loops.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+
+#if GLM_ARCH & GLM_ARCH_SSE2_BIT
+#define SIMD_FLOAT4 1
+#define SIMD_FLOAT4_SSE2 1
+#include <emmintrin.h>
+#include <glm/simd/matrix.h>
+#elif (GLM_ARCH & GLM_ARCH_NEON_BIT) && (defined(__aarch64__) || defined(_M_ARM64))
+#define SIMD_FLOAT4 1
+#define SIMD_FLOAT4_NEON 1
+#include <arm_neon.h>
+#else
+#define SIMD_FLOAT4 0
+#endif
+
+#if SIMD_FLOAT4
+// four floats in a register; masks are floats with all bits set in
+// the lanes that are true
+typedef glm_f32vec4 FLOAT4;
+
+#if SIMD_FLOAT4_SSE2
+inline FLOAT4 Float4Load(const float* pValues) { return(_mm_loadu_ps(pValues)); }
+inline void Float4Store(float* pValues, FLOAT4 value) { _mm_storeu_ps(pValues, value); }
+inline FLOAT4 Float4Set(float value) { return(_mm_set1_ps(value)); }
+inline FLOAT4 Float4Zero() { return(_mm_setzero_ps()); }
+inline FLOAT4 Float4Add(FLOAT4 a, FLOAT4 b) { return(_mm_add_ps(a, b)); }
+inline FLOAT4 Float4Sub(FLOAT4 a, FLOAT4 b) { return(_mm_sub_ps(a, b)); }
+inline FLOAT4 Float4Mul(FLOAT4 a, FLOAT4 b) { return(_mm_mul_ps(a, b)); }
+inline FLOAT4 Float4Div(FLOAT4 a, FLOAT4 b) { return(_mm_div_ps(a, b)); }
+inline FLOAT4 Float4Sqrt(FLOAT4 a) { return(_mm_sqrt_ps(a)); }
+inline FLOAT4 Float4LessThan(FLOAT4 a, FLOAT4 b) { return(_mm_cmplt_ps(a, b)); }
+inline FLOAT4 Float4LessEqual(FLOAT4 a, FLOAT4 b) { return(_mm_cmple_ps(a, b)); }
+inline FLOAT4 Float4GreaterEqual(FLOAT4 a, FLOAT4 b) { return(_mm_cmpge_ps(a, b)); }
+// the lanes of a where the mask is set, of b elsewhere
+inline FLOAT4 Float4Select(FLOAT4 mask, FLOAT4 a, FLOAT4 b) { return(_mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b))); }
+// bit n set when lane n of the mask is
+inline int Float4MaskBits(FLOAT4 mask) { return(_mm_movemask_ps(mask)); }
+
+inline void Float4Transpose(FLOAT4& row0, FLOAT4& row1, FLOAT4& row2, FLOAT4& row3)
+{
+	_MM_TRANSPOSE4_PS(row0, row1, row2, row3);
+}
+
+// pResult = pA * pB for column major 4x4 matrices; pResult may be pB
+inline void Float4MultiplyMatrix(const float* pA, const float* pB, float* pResult)
+{
+	glm_vec4 a[4] = { _mm_loadu_ps(pA), _mm_loadu_ps(pA + 4), _mm_loadu_ps(pA + 8), _mm_loadu_ps(pA + 12) };
+	glm_vec4 b[4] = { _mm_loadu_ps(pB), _mm_loadu_ps(pB + 4), _mm_loadu_ps(pB + 8), _mm_loadu_ps(pB + 12) };
+	glm_vec4 result[4];
+	glm_mat4_mul(a, b, result);
+	for (int column = 0; column < 4; column++)
+	{
+		_mm_storeu_ps(pResult + column * 4, result[column]);
+	}
+}
+#else
+inline FLOAT4 Float4Load(const float* pValues) { return(vld1q_f32(pValues)); }
+inline void Float4Store(float* pValues, FLOAT4 value) { vst1q_f32(pValues, value); }
+inline FLOAT4 Float4Set(float value) { return(vdupq_n_f32(value)); }
+inline FLOAT4 Float4Zero() { return(vdupq_n_f32(0.0f)); }
+inline FLOAT4 Float4Add(FLOAT4 a, FLOAT4 b) { return(vaddq_f32(a, b)); }
+inline FLOAT4 Float4Sub(FLOAT4 a, FLOAT4 b) { return(vsubq_f32(a, b)); }
+inline FLOAT4 Float4Mul(FLOAT4 a, FLOAT4 b) { return(vmulq_f32(a, b)); }
+inline FLOAT4 Float4Div(FLOAT4 a, FLOAT4 b) { return(vdivq_f32(a, b)); }
+inline FLOAT4 Float4Sqrt(FLOAT4 a) { return(vsqrtq_f32(a)); }
+inline FLOAT4 Float4LessThan(FLOAT4 a, FLOAT4 b) { return(vreinterpretq_f32_u32(vcltq_f32(a, b))); }
+inline FLOAT4 Float4LessEqual(FLOAT4 a, FLOAT4 b) { return(vreinterpretq_f32_u32(vcleq_f32(a, b))); }
+inline FLOAT4 Float4GreaterEqual(FLOAT4 a, FLOAT4 b) { return(vreinterpretq_f32_u32(vcgeq_f32(a, b))); }
+inline FLOAT4 Float4Select(FLOAT4 mask, FLOAT4 a, FLOAT4 b) { return(vbslq_f32(vreinterpretq_u32_f32(mask), a, b)); }
+
+inline int Float4MaskBits(FLOAT4 mask)
+{
+	const uint32_t LANE_BITS[4] = { 1, 2, 4, 8 };
+	return((int)vaddvq_u32(vandq_u32(vreinterpretq_u32_f32(mask), vld1q_u32(LANE_BITS))));
+}
+
+inline void Float4Transpose(FLOAT4& row0, FLOAT4& row1, FLOAT4& row2, FLOAT4& row3)
+{
+	float32x4x2_t rows01 = vtrnq_f32(row0, row1);
+	float32x4x2_t rows23 = vtrnq_f32(row2, row3);
+	row0 = vcombine_f32(vget_low_f32(rows01.val[0]), vget_low_f32(rows23.val[0]));
+	row1 = vcombine_f32(vget_low_f32(rows01.val[1]), vget_low_f32(rows23.val[1]));
+	row2 = vcombine_f32(vget_high_f32(rows01.val[0]), vget_high_f32(rows23.val[0]));
+	row3 = vcombine_f32(vget_high_f32(rows01.val[1]), vget_high_f32(rows23.val[1]));
+}
+
+// each column of the result is the columns of pA weighted by the
+// lanes of that column of pB, summed in pairs like glm_mat4_mul()
+inline void Float4MultiplyMatrix(const float* pA, const float* pB, float* pResult)
+{
+	float32x4_t a0 = vld1q_f32(pA);
+	float32x4_t a1 = vld1q_f32(pA + 4);
+	float32x4_t a2 = vld1q_f32(pA + 8);
+	float32x4_t a3 = vld1q_f32(pA + 12);
+	for (int column = 0; column < 4; column++)
+	{
+		float32x4_t b = vld1q_f32(pB + column * 4);
+		float32x4_t sum01 = vaddq_f32(vmulq_laneq_f32(a0, b, 0), vmulq_laneq_f32(a1, b, 1));
+		float32x4_t sum23 = vaddq_f32(vmulq_laneq_f32(a2, b, 2), vmulq_laneq_f32(a3, b, 3));
+		vst1q_f32(pResult + column * 4, vaddq_f32(sum01, sum23));
+	}
+}
+#endif
+#endif
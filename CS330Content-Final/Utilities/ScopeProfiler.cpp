@@ -0,0 +1,277 @@
+///////////////////////////////////////////////////////////////////////////////
+// scopeprofiler.cpp
+// ============
+// CPU time of marked scopes on every thread, exported as a Chrome trace
+//
+//  A PROFILE_SCOPE() marker at the top of a function or block records
+//  when it was entered and left. Each thread writes its events into a
+//  ring buffer of its own, so recording takes no lock, and the newest
+//  events of every thread are written at exit as the JSON trace format
+//  chrome://tracing and Perfetto open, or copied out while the threads
+//  run, for the trace of a hitch. While the profiler is off a
+//  marker costs one relaxed atomic load. Built with TRACY_ENABLE, the
+//  markers are also Tracy zones, streamed to a connected Tracy viewer.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "ScopeProfiler.h"
+
+#include <chrono>
+#include <cstdio>
+
+std::atomic<bool> ScopeProfiler::s_bEnabled(false);
+std::mutex ScopeProfiler::s_threadsMutex;
+std::vector<ScopeProfiler::THREAD_BUFFER*> ScopeProfiler::s_threads;
+
+namespace
+{
+	// time the events are measured from
+	const std::chrono::steady_clock::time_point LAUNCH_TIME = std::chrono::steady_clock::now();
+
+	// ring of the calling thread, once it has one
+	thread_local void* t_pThreadBuffer = NULL;
+
+	// write a string as a JSON string literal
+	void WriteJSONString(FILE* file, const char* text)
+	{
+		fputc('"', file);
+		for (const char* c = text; *c != '\0'; c++)
+		{
+			if ((*c == '"') || (*c == '\\'))
+			{
+				fputc('\\', file);
+				fputc(*c, file);
+			}
+			else if ((unsigned char)*c >= 0x20)
+			{
+				fputc(*c, file);
+			}
+		}
+		fputc('"', file);
+	}
+}
+
+/***********************************************************
+ *  Now()
+ *
+ *  This method is used for getting the nanoseconds since the
+ *  launch from the steady clock.
+ ***********************************************************/
+long long ScopeProfiler::Now()
+{
+	return((long long)std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now() - LAUNCH_TIME).count());
+}
+
+/***********************************************************
+ *  GetThreadBuffer()
+ *
+ *  This method is used for getting the ring of the calling
+ *  thread, registering it the first time. Only this first
+ *  call takes the lock; the events are allocated by the
+ *  first Record(), so a thread that is only named costs
+ *  no ring.
+ ***********************************************************/
+ScopeProfiler::THREAD_BUFFER* ScopeProfiler::GetThreadBuffer()
+{
+	if (t_pThreadBuffer == NULL)
+	{
+		THREAD_BUFFER* pBuffer = new THREAD_BUFFER();
+		pBuffer->written.store(0, std::memory_order_relaxed);
+
+		std::lock_guard<std::mutex> lock(s_threadsMutex);
+		pBuffer->threadId = (int)s_threads.size() + 1;
+		s_threads.push_back(pBuffer);
+		t_pThreadBuffer = pBuffer;
+	}
+	return((THREAD_BUFFER*)t_pThreadBuffer);
+}
+
+/***********************************************************
+ *  SetThreadName()
+ *
+ *  This method is used for naming the calling thread in the
+ *  trace, and in Tracy when it is built in.
+ ***********************************************************/
+void ScopeProfiler::SetThreadName(const char* name)
+{
+	THREAD_BUFFER* pBuffer = GetThreadBuffer();
+	std::lock_guard<std::mutex> lock(s_threadsMutex);
+	pBuffer->name = name;
+#ifdef TRACY_ENABLE
+	tracy::SetThreadName(name);
+#endif
+}
+
+/***********************************************************
+ *  Record()
+ *
+ *  This method is used for writing a finished scope into the
+ *  next slot of the ring of the calling thread, and then
+ *  publishing the new count for the export.
+ ***********************************************************/
+void ScopeProfiler::Record(const char* name, long long beginNanoseconds, long long endNanoseconds)
+{
+	THREAD_BUFFER* pBuffer = GetThreadBuffer();
+	if (pBuffer->events.empty() == true)
+	{
+		pBuffer->events.resize(EVENTS_PER_THREAD);
+	}
+	unsigned long long written = pBuffer->written.load(std::memory_order_relaxed);
+	SCOPE_EVENT& event = pBuffer->events[written % EVENTS_PER_THREAD];
+	event.name = name;
+	event.beginNanoseconds = beginNanoseconds;
+	event.endNanoseconds = endNanoseconds;
+	pBuffer->written.store(written + 1, std::memory_order_release);
+}
+
+/***********************************************************
+ *  GetEventCount()
+ *
+ *  This method is used for getting the scopes recorded over
+ *  every thread.
+ ***********************************************************/
+unsigned long long ScopeProfiler::GetEventCount()
+{
+	std::lock_guard<std::mutex> lock(s_threadsMutex);
+	unsigned long long events = 0;
+	for (size_t i = 0; i < s_threads.size(); i++)
+	{
+		events += s_threads[i]->written.load(std::memory_order_acquire);
+	}
+	return(events);
+}
+
+/***********************************************************
+ *  GetOverwrittenCount()
+ *
+ *  This method is used for getting the scopes that newer
+ *  ones replaced in a full ring, which the trace lacks.
+ ***********************************************************/
+unsigned long long ScopeProfiler::GetOverwrittenCount()
+{
+	std::lock_guard<std::mutex> lock(s_threadsMutex);
+	unsigned long long overwritten = 0;
+	for (size_t i = 0; i < s_threads.size(); i++)
+	{
+		unsigned long long written = s_threads[i]->written.load(std::memory_order_acquire);
+		overwritten += (written > EVENTS_PER_THREAD) ? written - EVENTS_PER_THREAD : 0;
+	}
+	return(overwritten);
+}
+
+/***********************************************************
+ *  CopyEvents()
+ *
+ *  This method is used for copying the newest events of
+ *  every thread out of their rings. A thread may record
+ *  while its ring is read, so the count is read again after
+ *  the copy, and the slots it wrapped onto meanwhile are
+ *  dropped from the front.
+ ***********************************************************/
+void ScopeProfiler::CopyEvents(long long sinceNanoseconds, std::vector<THREAD_EVENTS>& threads)
+{
+	std::lock_guard<std::mutex> lock(s_threadsMutex);
+	threads.resize(s_threads.size());
+	for (size_t i = 0; i < s_threads.size(); i++)
+	{
+		const THREAD_BUFFER* pBuffer = s_threads[i];
+		THREAD_EVENTS& copy = threads[i];
+		copy.threadId = pBuffer->threadId;
+		copy.name = pBuffer->name;
+		copy.events.clear();
+
+		// the ring holds the newest events, oldest first from the
+		// slot the next one goes into
+		unsigned long long written = pBuffer->written.load(std::memory_order_acquire);
+		unsigned long long first = (written > EVENTS_PER_THREAD) ? written - EVENTS_PER_THREAD : 0;
+		std::vector<unsigned long long> indexes;
+		for (unsigned long long e = first; e < written; e++)
+		{
+			const SCOPE_EVENT& event = pBuffer->events[e % EVENTS_PER_THREAD];
+			if (event.endNanoseconds >= sinceNanoseconds)
+			{
+				copy.events.push_back(event);
+				indexes.push_back(e);
+			}
+		}
+
+		unsigned long long writtenAfter = pBuffer->written.load(std::memory_order_acquire);
+		unsigned long long firstValid = (writtenAfter > EVENTS_PER_THREAD) ? writtenAfter - EVENTS_PER_THREAD : 0;
+		size_t dropped = 0;
+		while ((dropped < indexes.size()) && (indexes[dropped] < firstValid))
+		{
+			dropped++;
+		}
+		copy.events.erase(copy.events.begin(), copy.events.begin() + dropped);
+	}
+}
+
+/***********************************************************
+ *  WriteChromeTrace()
+ *
+ *  This method is used for writing the kept events of every
+ *  thread as a Chrome trace.
+ ***********************************************************/
+bool ScopeProfiler::WriteChromeTrace(const char* filename)
+{
+	std::vector<THREAD_EVENTS> threads;
+	CopyEvents(0, threads);
+	return(WriteChromeTrace(filename, threads, std::vector<COUNTER_EVENT>()));
+}
+
+/***********************************************************
+ *  WriteChromeTrace()
+ *
+ *  This method is used for writing copied events as the
+ *  complete ("X") events of the Chrome trace format, with
+ *  times in microseconds, a metadata event naming each
+ *  thread that was named, and the counters as counter
+ *  ("C") events.
+ ***********************************************************/
+bool ScopeProfiler::WriteChromeTrace(const char* filename, const std::vector<THREAD_EVENTS>& threads,
+	const std::vector<COUNTER_EVENT>& counters)
+{
+	FILE* file = fopen(filename, "wb");
+	if (file == NULL)
+	{
+		return(false);
+	}
+
+	fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+	bool bFirst = true;
+	for (size_t i = 0; i < threads.size(); i++)
+	{
+		const THREAD_EVENTS& thread = threads[i];
+		if (thread.name.empty() == false)
+		{
+			fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":",
+				(bFirst == true) ? "" : ",\n", thread.threadId);
+			WriteJSONString(file, thread.name.c_str());
+			fprintf(file, "}}");
+			bFirst = false;
+		}
+		for (size_t e = 0; e < thread.events.size(); e++)
+		{
+			const SCOPE_EVENT& event = thread.events[e];
+			fprintf(file, "%s{\"name\":", (bFirst == true) ? "" : ",\n");
+			WriteJSONString(file, event.name);
+			fprintf(file, ",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+				thread.threadId, (double)event.beginNanoseconds / 1000.0,
+				(double)(event.endNanoseconds - event.beginNanoseconds) / 1000.0);
+			bFirst = false;
+		}
+	}
+	for (size_t i = 0; i < counters.size(); i++)
+	{
+		fprintf(file, "%s{\"name\":", (bFirst == true) ? "" : ",\n");
+		WriteJSONString(file, counters[i].name);
+		fprintf(file, ",\"ph\":\"C\",\"pid\":1,\"ts\":%.3f,\"args\":{\"value\":%.4f}}",
+			(double)counters[i].nanoseconds / 1000.0, counters[i].value);
+		bFirst = false;
+	}
+	fprintf(file, "\n]}\n");
+
+	bool bWritten = (ferror(file) == 0);
+	fclose(file);
+	return(bWritten);
+}
@@ -0,0 +1,146 @@
+///////////////////////////////////////////////////////////////////////////////
+// scopeprofiler.h
+// ============
+// CPU time of marked scopes on every thread, exported as a Chrome trace
+//
+//  A PROFILE_SCOPE() marker at the top of a function or block records
+//  when it was entered and left. Each thread writes its events into a
+//  ring buffer of its own, so recording takes no lock, and the newest
+//  events of every thread are written at exit as the JSON trace format
+//  chrome://tracing and Perfetto open, or copied out while the threads
+//  run, for the trace of a hitch. While the profiler is off a
+//  marker costs one relaxed atomic load. Built with TRACY_ENABLE, the
+//  markers are also Tracy zones, streamed to a connected Tracy viewer.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#ifdef TRACY_ENABLE
+#include <tracy/Tracy.hpp>
+#endif
+
+/***********************************************************
+ *  ScopeProfiler
+ *
+ *  This class contains the ring buffers the threads record
+ *  their scopes into. It is used through static methods,
+ *  like the draw counters of ShapeMeshes, so any module can
+ *  place markers without being handed an object.
+ ***********************************************************/
+class ScopeProfiler
+{
+public:
+	// events kept per thread; older ones are overwritten
+	static const int EVENTS_PER_THREAD = 32768;
+
+	// a scope run on a thread, in nanoseconds from the launch; the
+	// name is a string literal, never copied
+	struct SCOPE_EVENT
+	{
+		const char* name;
+		long long beginNanoseconds;
+		long long endNanoseconds;
+	};
+
+	// record the scopes entered from now on, or stop
+	static void SetEnabled(bool bEnable) { s_bEnabled.store(bEnable, std::memory_order_relaxed); }
+	static bool IsEnabled() { return(s_bEnabled.load(std::memory_order_relaxed)); }
+	// name the calling thread in the trace
+	static void SetThreadName(const char* name);
+	// nanoseconds since the launch
+	static long long Now();
+	// add a finished scope to the ring of the calling thread
+	static void Record(const char* name, long long beginNanoseconds, long long endNanoseconds);
+
+	// the events of one thread, copied out of its ring
+	struct THREAD_EVENTS
+	{
+		int threadId;
+		std::string name;
+		std::vector<SCOPE_EVENT> events;
+	};
+	// a value at a time, drawn as a counter track of the trace
+	struct COUNTER_EVENT
+	{
+		const char* name;
+		long long nanoseconds;
+		double value;
+	};
+
+	// write the events of every thread as Chrome trace JSON; the
+	// threads should be idle, as at exit, since an event written
+	// meanwhile may be overwritten while it is read
+	static bool WriteChromeTrace(const char* filename);
+	// copy the events of every thread that ended at or after the
+	// time given, while the threads go on recording; an event a
+	// thread overwrote during the copy is left out
+	static void CopyEvents(long long sinceNanoseconds, std::vector<THREAD_EVENTS>& threads);
+	// write copied events, and counters, as Chrome trace JSON
+	static bool WriteChromeTrace(const char* filename, const std::vector<THREAD_EVENTS>& threads,
+		const std::vector<COUNTER_EVENT>& counters);
+	// events recorded, and those overwritten before any export
+	static unsigned long long GetEventCount();
+	static unsigned long long GetOverwrittenCount();
+
+private:
+	// ring of one thread; only its thread writes the events, and
+	// the count is published after each one
+	struct THREAD_BUFFER
+	{
+		std::vector<SCOPE_EVENT> events;
+		std::atomic<unsigned long long> written;
+		int threadId;
+		std::string name;
+	};
+
+	static std::atomic<bool> s_bEnabled;
+	// rings of every thread that recorded or was named, kept after
+	// the thread ends so its events still export
+	static std::mutex s_threadsMutex;
+	static std::vector<THREAD_BUFFER*> s_threads;
+
+	// ring of the calling thread, registered on first use
+	static THREAD_BUFFER* GetThreadBuffer();
+};
+
+/***********************************************************
+ *  ProfileScope
+ *
+ *  This class records the scope it lives in from its
+ *  construction to its destruction. It is placed with the
+ *  PROFILE_SCOPE() macro rather than by hand.
+ ***********************************************************/
+class ProfileScope
+{
+public:
+	explicit ProfileScope(const char* name)
+	{
+		m_name = name;
+		m_beginNanoseconds = (ScopeProfiler::IsEnabled() == true) ? ScopeProfiler::Now() : -1;
+	}
+	~ProfileScope()
+	{
+		if (m_beginNanoseconds >= 0)
+		{
+			ScopeProfiler::Record(m_name, m_beginNanoseconds, ScopeProfiler::Now());
+		}
+	}
+
+private:
+	const char* m_name;
+	long long m_beginNanoseconds;
+};
+
+// record the enclosing scope under a string literal name
+#define PROFILE_SCOPE_JOIN2(a, b) a##b
+#define PROFILE_SCOPE_JOIN(a, b) PROFILE_SCOPE_JOIN2(a, b)
+#ifdef TRACY_ENABLE
+#define PROFILE_SCOPE(name) ZoneScopedN(name); ProfileScope PROFILE_SCOPE_JOIN(profileScope, __LINE__)(name)
+#else
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_SCOPE_JOIN(profileScope, __LINE__)(name)
+#endif
@@ -9,111 +9,2569 @@ using namespace std;
 
 #include <stdlib.h>
 #include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <chrono>
 
 #include <GL/glew.h>
 
 #include "ShaderManager.h"
+#include "ScopeProfiler.h"
+#include "GLDebug.h"
+#include "AssetPack.h"
+#include "Logger.h"
+
+namespace
+{
+	// FNV-1a hash used to key the uniform location cache without
+	// constructing a std::string for every lookup
+	unsigned int HashUniformName(const char* name)
+	{
+		unsigned int hash = 2166136261u;
+		while (*name != '\0')
+		{
+			hash ^= (unsigned char)(*name++);
+			hash *= 16777619u;
+		}
+		return(hash);
+	}
+
+	// FNV-1a 64-bit hash used to key the program binary cache
+	unsigned long long HashProgramSource(const std::string& text, unsigned long long hash)
+	{
+		for (size_t i = 0; i < text.length(); i++)
+		{
+			hash ^= (unsigned char)text[i];
+			hash *= 1099511628211ull;
+		}
+		return(hash);
+	}
+
+	// header written in front of the driver's program binary
+	struct PROGRAM_CACHE_HEADER
+	{
+		unsigned int magic;
+		unsigned int binaryFormat;
+		unsigned long long cacheKey;
+		unsigned int binaryLength;
+	};
+
+	const unsigned int PROGRAM_CACHE_MAGIC = 0x43505347;	// "GSPC"
+
+	// source of a shader from the mounted asset pack, or from the
+	// loose file when the pack holds none
+	bool ReadShaderFile(const char* path, std::string& code)
+	{
+		if (AssetPack::FindText(path, code) == true)
+		{
+			return(true);
+		}
+		std::ifstream stream(path, std::ios::in);
+		if (stream.is_open() == false)
+		{
+			return(false);
+		}
+		std::stringstream sstr;
+		sstr << stream.rdbuf();
+		code = sstr.str();
+		return(true);
+	}
+
+	// directory of a path with its trailing separator, empty for a
+	// bare file name
+	std::string GetDirectory(const std::string& path)
+	{
+		size_t separator = path.find_last_of("/\\");
+		return((separator == std::string::npos) ? std::string() : path.substr(0, separator + 1));
+	}
+
+	// the quoted file name of an #include line; false when the line is
+	// no #include, true with an empty name when it is a malformed one
+	bool ParseInclude(const std::string& line, std::string& name)
+	{
+		size_t start = line.find_first_not_of(" \t");
+		if ((start == std::string::npos) || (line[start] != '#'))
+		{
+			return(false);
+		}
+		start = line.find_first_not_of(" \t", start + 1);
+		if ((start == std::string::npos) || (line.compare(start, 7, "include") != 0))
+		{
+			return(false);
+		}
+		name.clear();
+		size_t open = line.find('"', start + 7);
+		size_t close = (open == std::string::npos) ? open : line.find('"', open + 1);
+		if (close != std::string::npos)
+		{
+			name = line.substr(open + 1, close - open - 1);
+		}
+		return(true);
+	}
+
+	// add the files not in a list yet to it, when there is one
+	void AddSourceFiles(const std::vector<std::string>& files, std::vector<std::string>* pFiles)
+	{
+		for (size_t i = 0; (NULL != pFiles) && (i < files.size()); i++)
+		{
+			if (std::find(pFiles->begin(), pFiles->end(), files[i]) == pFiles->end())
+			{
+				pFiles->push_back(files[i]);
+			}
+		}
+	}
+
+	// the info log of a compile or link, as errors when it failed and
+	// as warnings otherwise
+	void LogBuildMessage(GLint result, const char* message)
+	{
+		if (message[0] == '\0')
+		{
+			return;
+		}
+		if (result == GL_TRUE)
+		{
+			LOG_WARNING("%s", message);
+		}
+		else
+		{
+			LOG_ERROR("%s", message);
+		}
+	}
+
+	// defines enabled by each PERMUTATION_* bit, in bit order
+	const char* const g_PermutationDefines[] =
+	{
+		"USE_TEXTURE",
+		"USE_LIGHTING",
+		"USE_INSTANCING",
+		"USE_OIT",
+		"USE_GBUFFER"
+	};
+
+	// uniforms of the SPIR-V scene shaders by the locations they are
+	// declared with, which must match the SPIRV_LOCATION() of
+	// vertexShader.glsl and fragmentShader.glsl
+	struct SPIRV_UNIFORM_INFO
+	{
+		const char* name;
+		GLint location;
+	};
+
+	const SPIRV_UNIFORM_INFO g_SpirvUniforms[] =
+	{
+		{ "model", 0 },
+		{ "normalMatrix", 1 },
+		{ "instanceData", 2 },
+		{ "instanceBase", 3 },
+		{ "objectColor", 4 },
+		{ "UVscale", 5 },
+		{ "materialIndex", 6 },
+		{ "textureIndex", 7 },
+		{ "textureArray", 8 },
+		{ "shadowAtlas", 9 },
+		{ "lightmap", 10 },
+		{ "lightmapEnabled", 11 },
+		{ "cascadeShadowMap", 12 },
+		{ "reflectionProbes", 13 }
+	};
+
+	// SPIR-V module from the mounted asset pack, or from the loose
+	// file when the pack holds none
+	bool ReadShaderModule(const std::string& path, std::string& module)
+	{
+		AssetPack::ASSET_VIEW view;
+		if (AssetPack::Find(path.c_str(), view) == true)
+		{
+			module.assign((const char*)view.pData, view.size);
+			return(true);
+		}
+		std::ifstream stream(path.c_str(), std::ios::in | std::ios::binary);
+		if (stream.is_open() == false)
+		{
+			return(false);
+		}
+		std::stringstream sstr;
+		sstr << stream.rdbuf();
+		module = sstr.str();
+		return(module.empty() == false);
+	}
+
+	// uniform blocks shared between programs and their binding points
+	struct UNIFORM_BLOCK_INFO
+	{
+		const char* name;
+		GLuint binding;
+	};
+
+	const UNIFORM_BLOCK_INFO g_UniformBlocks[] =
+	{
+		{ "FrameData", ShaderManager::FRAME_DATA_BINDING },
+		{ "LightData", ShaderManager::LIGHT_DATA_BINDING },
+		{ "MaterialData", ShaderManager::MATERIAL_DATA_BINDING },
+		{ "ShadowData", ShaderManager::SHADOW_DATA_BINDING },
+		{ "TextureData", ShaderManager::TEXTURE_DATA_BINDING },
+		{ "StereoData", ShaderManager::STEREO_DATA_BINDING },
+		{ "CascadeData", ShaderManager::CASCADE_DATA_BINDING },
+		{ "ProbeData", ShaderManager::PROBE_DATA_BINDING }
+	};
+}
+
+/***********************************************************
+ *  ShaderManager()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+ShaderManager::ShaderManager()
+{
+	m_programID = 0;
+	m_currentPermutation = 0;
+	m_bExternalProgram = false;
+	for (int i = 0; i < PERMUTATION_COUNT; i++)
+	{
+		PROGRAM_INFO* programs[4] = { &m_programs[i], &m_reloadPrograms[i], &m_vertexStages[i], &m_reloadVertexStages[i] };
+		for (int j = 0; j < 4; j++)
+		{
+			programs[j]->programID = 0;
+			programs[j]->vertexShaderID = 0;
+			programs[j]->fragmentShaderID = 0;
+			programs[j]->bSeparable = false;
+			programs[j]->bSpirv = false;
+			programs[j]->pipelineID = 0;
+			programs[j]->activeStage = 0;
+			programs[j]->bReady = false;
+			programs[j]->cacheKey = 0;
+		}
+	}
+	m_activeTextureUnit = -1;
+	memset(m_boundTextures, 0, sizeof(m_boundTextures));
+	ResetStateFilterStats();
+	m_bUseProgramBinaryCache = true;
+	m_bMultiview = false;
+	m_bHalfPrecision = false;
+	m_bSeparablePrograms = false;
+	m_bSpirvShaders = false;
+	m_bParallelCompile = false;
+	m_bReloadPending = false;
+	m_pFileWatcher = NULL;
+	memset(&m_sourceStats, 0, sizeof(m_sourceStats));
+}
+
+/***********************************************************
+ *  ~ShaderManager()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+ShaderManager::~ShaderManager()
+{
+}
 
 /***********************************************************
  *  LoadShaders()
  *
  *  This method is called to load the shader data from 
- *  external GLSL compatible files.
+ *  external GLSL compatible files and build one program
+ *  for every permutation of the PERMUTATION_* defines.
+ *  Only the fallback programs are waited for; the other
+ *  programs finish in PollPendingPrograms() and draws use
+ *  GetFallbackPermutation() until then.
  ***********************************************************/
 GLuint ShaderManager::LoadShaders(const char * vertex_file_path,const char * fragment_file_path){
 
-	// Create the shaders
-	GLuint VertexShaderID = glCreateShader(GL_VERTEX_SHADER);
-	GLuint FragmentShaderID = glCreateShader(GL_FRAGMENT_SHADER);
-
-	// Read the Vertex Shader code from the file
 	std::string VertexShaderCode;
-	std::ifstream VertexShaderStream(vertex_file_path, std::ios::in);
-	if(VertexShaderStream.is_open()){
-		std::stringstream sstr;
-		sstr << VertexShaderStream.rdbuf();
-		VertexShaderCode = sstr.str();
-		VertexShaderStream.close();
-	}else{
-		printf("Impossible to open %s. Are you in the right directory ? Don't forget to read the FAQ !\n", vertex_file_path);
+	std::string FragmentShaderCode;
+	m_sceneSourceFiles.clear();
+	if (ReadShaderSources(vertex_file_path, fragment_file_path, VertexShaderCode, FragmentShaderCode,
+		&m_sceneSourceFiles) == false)
+	{
 		getchar();
 		return 0;
 	}
 
+	m_vertexShaderPath = vertex_file_path;
+	m_fragmentShaderPath = fragment_file_path;
+
+	// let the driver compile on its own threads when it can, so the
+	// compile and link calls below return without waiting
+	m_bParallelCompile = (GLEW_KHR_parallel_shader_compile == GL_TRUE) ||
+		(GLEW_ARB_parallel_shader_compile == GL_TRUE);
+	if (GLEW_KHR_parallel_shader_compile == GL_TRUE)
+	{
+		glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+	}
+	else if (GLEW_ARB_parallel_shader_compile == GL_TRUE)
+	{
+		glMaxShaderCompilerThreadsARB(0xFFFFFFFF);
+	}
+
+	if ((m_bSeparablePrograms == true) &&
+		(GLEW_VERSION_4_1 == GL_FALSE) && (GLEW_ARB_separate_shader_objects == GL_FALSE))
+	{
+		LOG_WARNING("Separable programs need GL_ARB_separate_shader_objects, linking whole programs");
+		m_bSeparablePrograms = false;
+	}
+	if (m_bSpirvShaders == true)
+	{
+		// the modules are built for whole programs of a single view
+		if ((m_bMultiview == true) || (m_bSeparablePrograms == true))
+		{
+			LOG_WARNING("SPIR-V shaders are built for single view whole programs, compiling GLSL");
+			m_bSpirvShaders = false;
+		}
+		else if ((GLEW_VERSION_4_6 == GL_FALSE) && (GLEW_ARB_gl_spirv == GL_FALSE))
+		{
+			LOG_WARNING("SPIR-V shaders need GL_ARB_gl_spirv, compiling GLSL");
+			m_bSpirvShaders = false;
+		}
+	}
+
+	// submit every permutation before waiting on any of them
+	SubmitPermutations(m_programs, m_vertexStages, VertexShaderCode, FragmentShaderCode);
+
+	// the fallback programs have to exist before the first frame
+	for (int permutation = 0; permutation < PERMUTATION_COUNT; permutation++)
+	{
+		if ((GetFallbackPermutation(permutation) == permutation) &&
+			(IsProgramReady(m_programs[permutation]) == false))
+		{
+			FinishPermutation(m_programs, m_vertexStages, permutation);
+		}
+	}
+
+	// without parallel compile there is nothing to overlap with
+	// rendering, so finish the rest now like a single program load
+	if (m_bParallelCompile == false)
+	{
+		for (int permutation = 0; permutation < PERMUTATION_COUNT; permutation++)
+		{
+			if (IsProgramReady(m_programs[permutation]) == false)
+			{
+				FinishPermutation(m_programs, m_vertexStages, permutation);
+			}
+		}
+	}
+
+	if (m_bSeparablePrograms == true)
+	{
+		int vertexStages = 0;
+		for (int permutation = 0; permutation < PERMUTATION_COUNT; permutation++)
+		{
+			vertexStages += (0 != m_vertexStages[permutation].programID) ? 1 : 0;
+		}
+		LOG_INFO("Built %d vertex stages and %d fragment stages for the shader permutations",
+			vertexStages, (int)PERMUTATION_COUNT);
+	}
+
+	m_currentPermutation = FALLBACK_PERMUTATION;
+	m_programID = m_programs[FALLBACK_PERMUTATION].programID;
+
+	return m_programID;
+}
+
+/***********************************************************
+ *  ReadShaderSources()
+ *
+ *  This method is used for reading the vertex and fragment
+ *  shader code from the passed in files.
+ ***********************************************************/
+bool ShaderManager::ReadShaderSources(
+	const char* vertex_file_path,
+	const char* fragment_file_path,
+	std::string& VertexShaderCode,
+	std::string& FragmentShaderCode,
+	std::vector<std::string>* pFiles)
+{
+	// Read the Vertex Shader code from the file
+	if(ReadShaderSource(vertex_file_path, VertexShaderCode, pFiles) == false){
+		LOG_ERROR("Impossible to open %s. Are you in the right directory ? Don't forget to read the FAQ !", vertex_file_path);
+		return false;
+	}
+
 	// Read the Fragment Shader code from the file
+	ReadShaderSource(fragment_file_path, FragmentShaderCode, pFiles);
+
+	return true;
+}
+
+/***********************************************************
+ *  ReadShaderSource()
+ *
+ *  This method is used for reading a shader file with every
+ *  #include in it expanded. The expansion of a file is kept
+ *  with the hash of the contents of the files that went
+ *  into it, and reused while the cached files still hash
+ *  the same, so the programs sharing a shader, or an
+ *  include, read and expand it once. A file leaves the
+ *  cache when the watcher sees it change.
+ ***********************************************************/
+bool ShaderManager::ReadShaderSource(const std::string& path, std::string& code, std::vector<std::string>* pFiles)
+{
+	std::map<std::string, EXPANDED_SOURCE>::iterator found = m_expandedSources.find(path);
+	bool bReuse = (found != m_expandedSources.end());
+	if (bReuse == true)
+	{
+		unsigned long long hash = 14695981039346656037ull;
+		for (size_t i = 0; (i < found->second.files.size()) && (bReuse == true); i++)
+		{
+			const SOURCE_FILE* pFile = GetSourceFile(found->second.files[i]);
+			bReuse = (NULL != pFile);
+			if (bReuse == true)
+			{
+				hash = (hash ^ pFile->hash) * 1099511628211ull;
+			}
+		}
+		bReuse = (bReuse == true) && (hash == found->second.hash);
+	}
+
+	if (bReuse == true)
+	{
+		m_sourceStats.expansionHits++;
+	}
+	else
+	{
+		if (NULL == GetSourceFile(path))
+		{
+			return(false);
+		}
+		EXPANDED_SOURCE expansion;
+		expansion.hash = 14695981039346656037ull;
+		bool bExpanded = ExpandShaderFile(path, expansion);
+		m_sourceStats.expansions++;
+		if (bExpanded == false)
+		{
+			// a broken include is expanded again next time, and the
+			// source fails to compile with the error printed
+			m_expandedSources.erase(path);
+			code = expansion.text;
+			AddSourceFiles(expansion.files, pFiles);
+			return(true);
+		}
+		found = m_expandedSources.insert(std::make_pair(path, EXPANDED_SOURCE())).first;
+		found->second = expansion;
+	}
+
+	code = found->second.text;
+	AddSourceFiles(found->second.files, pFiles);
+	return(true);
+}
+
+/***********************************************************
+ *  ExpandShaderFile()
+ *
+ *  This method is used for appending a shader file to an
+ *  expansion with its #include lines replaced by the files
+ *  they name, relative to the including file. Like a
+ *  #pragma once, a file already in the expansion is left
+ *  out. #line directives keep the compile errors on the
+ *  lines of the files they come from, each file numbered by
+ *  its place in the expansion's files. Returns false when
+ *  an include is malformed or cannot be read.
+ ***********************************************************/
+bool ShaderManager::ExpandShaderFile(const std::string& path, EXPANDED_SOURCE& expansion)
+{
+	// the file is listed even when it cannot be read, so the watcher
+	// notices it appearing
+	int sourceIndex = (int)expansion.files.size();
+	expansion.files.push_back(path);
+	const SOURCE_FILE* pFile = GetSourceFile(path);
+	if (NULL == pFile)
+	{
+		return(false);
+	}
+	expansion.hash = (expansion.hash ^ pFile->hash) * 1099511628211ull;
+
+	bool bExpanded = true;
+	std::istringstream stream(pFile->text);
+	std::string line;
+	int lineNumber = 0;
+	while (std::getline(stream, line))
+	{
+		lineNumber++;
+		std::string name;
+		if (ParseInclude(line, name) == false)
+		{
+			expansion.text += line;
+			expansion.text += '\n';
+			continue;
+		}
+
+		// an empty line keeps the numbering of the lines after it
+		std::string includePath = GetDirectory(path) + name;
+		if (name.empty() == true)
+		{
+			LOG_ERROR("%s(%d): malformed #include", path.c_str(), lineNumber);
+			bExpanded = false;
+			expansion.text += '\n';
+			continue;
+		}
+		if (std::find(expansion.files.begin(), expansion.files.end(), includePath) != expansion.files.end())
+		{
+			expansion.text += '\n';
+			continue;
+		}
+
+		expansion.text += "#line 1 " + std::to_string(expansion.files.size()) + "\n";
+		if (ExpandShaderFile(includePath, expansion) == false)
+		{
+			LOG_ERROR("%s(%d): cannot include %s", path.c_str(), lineNumber, includePath.c_str());
+			bExpanded = false;
+		}
+		expansion.text += "#line " + std::to_string(lineNumber + 1) + " " + std::to_string(sourceIndex) + "\n";
+	}
+
+	return(bExpanded);
+}
+
+/***********************************************************
+ *  GetSourceFile()
+ *
+ *  This method is used for reading a shader file through
+ *  the cache shared by every program, from the mounted
+ *  asset pack or the loose file. Returns NULL when it
+ *  cannot be read.
+ ***********************************************************/
+const ShaderManager::SOURCE_FILE* ShaderManager::GetSourceFile(const std::string& path)
+{
+	std::map<std::string, SOURCE_FILE>::const_iterator found = m_sourceFiles.find(path);
+	if (found != m_sourceFiles.end())
+	{
+		m_sourceStats.fileHits++;
+		return(&found->second);
+	}
+
+	SOURCE_FILE file;
+	if (ReadShaderFile(path.c_str(), file.text) == false)
+	{
+		return(NULL);
+	}
+	file.hash = HashProgramSource(file.text, 14695981039346656037ull);
+	m_sourceStats.fileReads++;
+	return(&m_sourceFiles.insert(std::make_pair(path, file)).first->second);
+}
+
+/***********************************************************
+ *  SubmitPermutations()
+ *
+ *  This method is used for replacing every program of the
+ *  passed in permutation set, loading the cached binary of
+ *  each one or submitting it for compiling from source.
+ *  With separable programs the set is one vertex stage for
+ *  each combination of the VERTEX_PERMUTATION_MASK bits and
+ *  one fragment stage per permutation, each cached under the
+ *  key of its own source, so an edit of one shader file
+ *  leaves the binaries of the other stage valid.
+ ***********************************************************/
+void ShaderManager::SubmitPermutations(
+	PROGRAM_INFO* programs,
+	PROGRAM_INFO* vertexStages,
+	const std::string& VertexShaderCode,
+	const std::string& FragmentShaderCode)
+{
+	// the cache key covers both sources, with their includes
+	// expanded so an edit of an include invalidates the binaries
+	// too, and the driver, since a binary is only valid for the
+	// exact driver that produced it
+	unsigned long long sourceKey = 14695981039346656037ull;
+	unsigned long long driverKey = 14695981039346656037ull;
+	if (m_bUseProgramBinaryCache == true)
+	{
+		const char* vendor = (const char*)glGetString(GL_VENDOR);
+		const char* renderer = (const char*)glGetString(GL_RENDERER);
+		const char* version = (const char*)glGetString(GL_VERSION);
+		sourceKey = HashProgramSource(VertexShaderCode, sourceKey);
+		sourceKey = HashProgramSource(FragmentShaderCode, sourceKey);
+		sourceKey = HashProgramSource((NULL != vendor) ? vendor : "", sourceKey);
+		sourceKey = HashProgramSource((NULL != renderer) ? renderer : "", sourceKey);
+		sourceKey = HashProgramSource((NULL != version) ? version : "", sourceKey);
+		driverKey = HashProgramSource((NULL != vendor) ? vendor : "", driverKey);
+		driverKey = HashProgramSource((NULL != renderer) ? renderer : "", driverKey);
+		driverKey = HashProgramSource((NULL != version) ? version : "", driverKey);
+	}
+	std::string variant = (m_bMultiview == true) ? ".multiview" : "";
+	if (m_bHalfPrecision == true)
+	{
+		variant += ".half";
+	}
+
+	if ((m_bSpirvShaders == true) && (SubmitSpirvPermutations(programs, vertexStages, driverKey) == true))
+	{
+		return;
+	}
+
+	for (int permutation = 0; permutation < PERMUTATION_COUNT; permutation++)
+	{
+		std::string defines = GetPermutationDefines(permutation);
+		if (m_bMultiview == true)
+		{
+			defines += "#define USE_MULTIVIEW\n";
+		}
+		if (m_bHalfPrecision == true)
+		{
+			defines += "#define USE_HALF_PRECISION\n";
+		}
+
+		if (m_bSeparablePrograms == false)
+		{
+			ReleaseProgram(vertexStages[permutation]);
+			SubmitSetProgram(programs[permutation], permutation,
+				m_vertexShaderPath + "." + std::to_string(permutation) + variant + ".programcache",
+				HashProgramSource(defines, sourceKey),
+				InjectDefines(VertexShaderCode, defines),
+				InjectDefines(FragmentShaderCode, defines), false);
+			continue;
+		}
+
+		defines += "#define USE_SEPARABLE\n";
+		// a vertex stage is built by the lowest permutation it serves
+		if ((permutation & ~VERTEX_PERMUTATION_MASK) == 0)
+		{
+			SubmitSetProgram(vertexStages[permutation], permutation,
+				m_vertexShaderPath + "." + std::to_string(permutation) + variant + ".separable.programcache",
+				HashProgramSource(defines, HashProgramSource(VertexShaderCode, driverKey)),
+				InjectDefines(VertexShaderCode, defines), "", true);
+		}
+		else
+		{
+			ReleaseProgram(vertexStages[permutation]);
+		}
+		SubmitSetProgram(programs[permutation], permutation,
+			m_fragmentShaderPath + "." + std::to_string(permutation) + variant + ".separable.programcache",
+			HashProgramSource(defines, HashProgramSource(FragmentShaderCode, driverKey)),
+			"", InjectDefines(FragmentShaderCode, defines), true);
+	}
+
+	// join the stages that both came from the cache
+	if (m_bSeparablePrograms == true)
+	{
+		for (int permutation = 0; permutation < PERMUTATION_COUNT; permutation++)
+		{
+			JoinStages(programs[permutation], GetVertexStage(vertexStages, permutation), permutation);
+		}
+	}
+}
+
+/***********************************************************
+ *  SubmitSpirvPermutations()
+ *
+ *  This method is used for replacing every program of the
+ *  passed in permutation set with one made from the SPIR-V
+ *  modules of CompileSpirvModules(). The modules are read
+ *  once, one per combination of the bits that change the
+ *  interface of each stage, and every permutation sharing a
+ *  module specializes it for its own texture and lighting
+ *  bits, so the driver never parses GLSL and no defines are
+ *  assembled. The program binary cache still applies, keyed
+ *  by the modules and the specialization.
+ ***********************************************************/
+bool ShaderManager::SubmitSpirvPermutations(
+	PROGRAM_INFO* programs,
+	PROGRAM_INFO* vertexStages,
+	unsigned long long driverKey)
+{
+	bool bBindless = (GLEW_ARB_bindless_texture == GL_TRUE);
+	std::string vertexModules[PERMUTATION_COUNT];
+	std::string fragmentModules[PERMUTATION_COUNT];
+	for (int permutation = 0; permutation < PERMUTATION_COUNT; permutation++)
+	{
+		if ((permutation & ~INTERFACE_PERMUTATION_MASK) != 0)
+		{
+			continue;
+		}
+		std::string vertexPath = GetSpirvModulePath(m_vertexShaderPath, permutation & VERTEX_PERMUTATION_MASK, false);
+		std::string fragmentPath = GetSpirvModulePath(m_fragmentShaderPath, permutation, bBindless);
+		if ((ReadShaderModule(vertexPath, vertexModules[permutation]) == false) ||
+			(ReadShaderModule(fragmentPath, fragmentModules[permutation]) == false))
+		{
+			LOG_WARNING("SPIR-V module %s is missing, build them with --compile-spirv; compiling GLSL",
+				fragmentModules[permutation].empty() ? fragmentPath.c_str() : vertexPath.c_str());
+			m_bSpirvShaders = false;
+			return(false);
+		}
+	}
+
+	for (int permutation = 0; permutation < PERMUTATION_COUNT; permutation++)
+	{
+		PROGRAM_INFO& program = programs[permutation];
+		const std::string& vertexModule = vertexModules[permutation & INTERFACE_PERMUTATION_MASK];
+		const std::string& fragmentModule = fragmentModules[permutation & INTERFACE_PERMUTATION_MASK];
+
+		// replace the program of a previous load
+		ReleaseProgram(vertexStages[permutation]);
+		ReleaseProgram(program);
+		program.bSpirv = true;
+
+		std::vector<GLuint> indices;
+		std::vector<GLuint> values;
+		GetSpecialization(permutation, indices, values);
+		std::string specialization;
+		for (size_t i = 0; i < indices.size(); i++)
+		{
+			specialization += std::to_string(indices[i]) + "=" + std::to_string(values[i]) + ";";
+		}
+
+		program.cachePath = m_vertexShaderPath + "." + std::to_string(permutation) + ".spirv.programcache";
+		program.cacheKey = HashProgramSource(specialization,
+			HashProgramSource(fragmentModule, HashProgramSource(vertexModule, driverKey)));
+
+		if (m_bUseProgramBinaryCache == true)
+		{
+			program.programID = LoadProgramBinary(program.cachePath, program.cacheKey);
+		}
+		if (0 != program.programID)
+		{
+			program.bReady = true;
+			OnProgramLinked(program);
+			LabelProgram(program.programID, permutation, "scene");
+		}
+		else
+		{
+			LOG_INFO("Specializing shader permutation %d [%s]", permutation, GetPermutationName(permutation).c_str());
+			SubmitSpirvProgram(program, permutation, vertexModule, fragmentModule);
+		}
+	}
+
+	return(true);
+}
+
+/***********************************************************
+ *  SubmitSpirvProgram()
+ *
+ *  This method is used for handing the SPIR-V modules of a
+ *  permutation to the driver and specializing them, then
+ *  linking them like SubmitProgram() does the sources, so
+ *  FinishProgram() collects the result the same way.
+ ***********************************************************/
+void ShaderManager::SubmitSpirvProgram(
+	PROGRAM_INFO& program,
+	int permutation,
+	const std::string& VertexModule,
+	const std::string& FragmentModule)
+{
+	PROFILE_SCOPE("shader compile submit");
+	program.vertexShaderID = glCreateShader(GL_VERTEX_SHADER);
+	program.fragmentShaderID = glCreateShader(GL_FRAGMENT_SHADER);
+
+	glShaderBinary(1, &program.vertexShaderID, GL_SHADER_BINARY_FORMAT_SPIR_V,
+		VertexModule.data(), (GLsizei)VertexModule.size());
+	glSpecializeShader(program.vertexShaderID, "main", 0, NULL, NULL);
+
+	std::vector<GLuint> indices;
+	std::vector<GLuint> values;
+	GetSpecialization(permutation, indices, values);
+	glShaderBinary(1, &program.fragmentShaderID, GL_SHADER_BINARY_FORMAT_SPIR_V,
+		FragmentModule.data(), (GLsizei)FragmentModule.size());
+	glSpecializeShader(program.fragmentShaderID, "main", (GLuint)indices.size(), &indices[0], &values[0]);
+
+	program.programID = glCreateProgram();
+	glAttachShader(program.programID, program.vertexShaderID);
+	glAttachShader(program.programID, program.fragmentShaderID);
+	if (m_bUseProgramBinaryCache == true)
+	{
+		glProgramParameteri(program.programID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	}
+	glLinkProgram(program.programID);
+
+	program.bReady = false;
+}
+
+/***********************************************************
+ *  GetSpecialization()
+ *
+ *  This method is used for listing the specialization
+ *  constants of a permutation's fragment stage: its texture
+ *  and lighting bits, then the constants set through
+ *  SetSpecializationConstant().
+ ***********************************************************/
+void ShaderManager::GetSpecialization(int permutation, std::vector<GLuint>& indices, std::vector<GLuint>& values) const
+{
+	indices.clear();
+	values.clear();
+	indices.push_back(SPEC_TEXTURE);
+	values.push_back(((permutation & PERMUTATION_TEXTURE) != 0) ? 1 : 0);
+	indices.push_back(SPEC_LIGHTING);
+	values.push_back(((permutation & PERMUTATION_LIGHTING) != 0) ? 1 : 0);
+	for (size_t i = 0; i < m_specializationConstants.size(); i++)
+	{
+		indices.push_back(m_specializationConstants[i].first);
+		values.push_back(m_specializationConstants[i].second);
+	}
+}
+
+/***********************************************************
+ *  SetSpecializationConstant()
+ *
+ *  This method is used for setting the value a constant of
+ *  the SPIR-V fragment stages is specialized with, replacing
+ *  an earlier value of the same constant.
+ ***********************************************************/
+void ShaderManager::SetSpecializationConstant(GLuint constantID, GLuint value)
+{
+	for (size_t i = 0; i < m_specializationConstants.size(); i++)
+	{
+		if (m_specializationConstants[i].first == constantID)
+		{
+			m_specializationConstants[i].second = value;
+			return;
+		}
+	}
+	m_specializationConstants.push_back(std::make_pair(constantID, value));
+}
+
+/***********************************************************
+ *  GetSpirvModulePath()
+ *
+ *  This method is used for naming the SPIR-V module of a
+ *  shader file for the interface bits of a permutation. The
+ *  fragment shader has a module for each texture path, as
+ *  bindless handles cannot be tested for in SPIR-V.
+ ***********************************************************/
+std::string ShaderManager::GetSpirvModulePath(const std::string& shaderPath, int permutation, bool bBindless)
+{
+	return(shaderPath + "." + std::to_string(permutation & INTERFACE_PERMUTATION_MASK) +
+		((bBindless == true) ? ".bindless" : "") + ".spv");
+}
+
+/***********************************************************
+ *  CompileSpirvModules()
+ *
+ *  This method is used for the offline step of the SPIR-V
+ *  shaders: compiling the scene shaders with the
+ *  glslangValidator of the Vulkan SDK, found on the path,
+ *  into one module for every combination of the interface
+ *  bits of each stage, and for the fragment shader once more
+ *  with bindless textures. The other bits are left to the
+ *  specialization constants. The compiler is given the
+ *  sources with their #includes expanded, written next to
+ *  each module for the time of its build.
+ ***********************************************************/
+bool ShaderManager::CompileSpirvModules(const char* vertex_file_path, const char* fragment_file_path)
+{
+	std::string VertexShaderCode;
 	std::string FragmentShaderCode;
-	std::ifstream FragmentShaderStream(fragment_file_path, std::ios::in);
-	if(FragmentShaderStream.is_open()){
-		std::stringstream sstr;
-		sstr << FragmentShaderStream.rdbuf();
-		FragmentShaderCode = sstr.str();
-		FragmentShaderStream.close();
+	if ((ReadShaderSource(vertex_file_path, VertexShaderCode) == false) ||
+		(ReadShaderSource(fragment_file_path, FragmentShaderCode) == false))
+	{
+		LOG_ERROR("Impossible to open %s or %s", vertex_file_path, fragment_file_path);
+		return(false);
 	}
 
-	GLint Result = GL_FALSE;
-	int InfoLogLength;
+	bool bCompiled = true;
+	for (int permutation = 0; permutation < PERMUTATION_COUNT; permutation++)
+	{
+		if ((permutation & ~INTERFACE_PERMUTATION_MASK) != 0)
+		{
+			continue;
+		}
 
+		std::string defines = "-DUSE_SPIRV";
+		for (size_t i = 0; i < sizeof(g_PermutationDefines) / sizeof(g_PermutationDefines[0]); i++)
+		{
+			if ((permutation & (1 << i)) != 0)
+			{
+				defines += std::string(" -D") + g_PermutationDefines[i];
+			}
+		}
 
-	// Compile Vertex Shader
-	printf("Compiling shader : %s...", vertex_file_path);
-	char const * VertexSourcePointer = VertexShaderCode.c_str();
-	glShaderSource(VertexShaderID, 1, &VertexSourcePointer , NULL);
-	glCompileShader(VertexShaderID);
+		// one module of the vertex shader per vertex interface, and
+		// both texture paths of the fragment shader
+		struct SPIRV_BUILD
+		{
+			const char* stage;
+			const std::string* pSource;
+			std::string module;
+			const char* defines;
+			bool bRequired;
+		};
+		std::vector<SPIRV_BUILD> builds;
+		if ((permutation & ~VERTEX_PERMUTATION_MASK) == 0)
+		{
+			builds.push_back({ "vert", &VertexShaderCode, GetSpirvModulePath(vertex_file_path, permutation, false), "", true });
+		}
+		builds.push_back({ "frag", &FragmentShaderCode, GetSpirvModulePath(fragment_file_path, permutation, false), "", true });
+		builds.push_back({ "frag", &FragmentShaderCode, GetSpirvModulePath(fragment_file_path, permutation, true),
+			" -DUSE_BINDLESS", false });
 
-	// Check Vertex Shader
-	glGetShaderiv(VertexShaderID, GL_COMPILE_STATUS, &Result);
-	glGetShaderiv(VertexShaderID, GL_INFO_LOG_LENGTH, &InfoLogLength);
-	if ( InfoLogLength > 0 ){
-		std::vector<char> VertexShaderErrorMessage(InfoLogLength+1);
-		glGetShaderInfoLog(VertexShaderID, InfoLogLength, NULL, &VertexShaderErrorMessage[0]);
-		printf("\n%s\n", &VertexShaderErrorMessage[0]);
+		for (size_t i = 0; i < builds.size(); i++)
+		{
+			std::string sourcePath = builds[i].module + ".glsl";
+			std::ofstream source(sourcePath.c_str(), std::ios::out | std::ios::trunc);
+			source << *builds[i].pSource;
+			source.close();
+
+			// -G targets OpenGL; the stage is named as the files are .glsl
+			std::string command = std::string("glslangValidator -G --auto-map-bindings -S ") + builds[i].stage +
+				" " + defines + builds[i].defines + " -o \"" + builds[i].module + "\" \"" + sourcePath + "\"";
+			LOG_INFO("%s", command.c_str());
+			int result = system(command.c_str());
+			std::remove(sourcePath.c_str());
+			if (result == 0)
+			{
+				continue;
+			}
+			if (builds[i].bRequired == true)
+			{
+				LOG_ERROR("SPIR-V module %s did not build", builds[i].module.c_str());
+				bCompiled = false;
+			}
+			else
+			{
+				// the compiler may lack bindless textures in SPIR-V, then
+				// a GPU with them compiles the GLSL
+				LOG_WARNING("SPIR-V module %s did not build, bindless textures will use the GLSL",
+					builds[i].module.c_str());
+			}
+		}
 	}
 
-	printf("success\n");
+	return(bCompiled);
+}
 
-	// Compile Fragment Shader
-	printf("Compiling shader : %s...", fragment_file_path);
-	char const * FragmentSourcePointer = FragmentShaderCode.c_str();
-	glShaderSource(FragmentShaderID, 1, &FragmentSourcePointer , NULL);
-	glCompileShader(FragmentShaderID);
+/***********************************************************
+ *  SubmitSetProgram()
+ *
+ *  This method is used for replacing one program of a
+ *  permutation set with its cached binary, or submitting it
+ *  for compiling from source when there is none.
+ ***********************************************************/
+void ShaderManager::SubmitSetProgram(
+	PROGRAM_INFO& program,
+	int permutation,
+	const std::string& cachePath,
+	unsigned long long cacheKey,
+	const std::string& VertexShaderCode,
+	const std::string& FragmentShaderCode,
+	bool bSeparable)
+{
+	// replace the program of a previous load
+	ReleaseProgram(program);
 
-	// Check Fragment Shader
-	glGetShaderiv(FragmentShaderID, GL_COMPILE_STATUS, &Result);
-	glGetShaderiv(FragmentShaderID, GL_INFO_LOG_LENGTH, &InfoLogLength);
-	if ( InfoLogLength > 0 ){
-		std::vector<char> FragmentShaderErrorMessage(InfoLogLength+1);
-		glGetShaderInfoLog(FragmentShaderID, InfoLogLength, NULL, &FragmentShaderErrorMessage[0]);
-		printf("\n%s\n", &FragmentShaderErrorMessage[0]);
+	program.cachePath = cachePath;
+	program.cacheKey = cacheKey;
+	program.bSeparable = bSeparable;
+	const char* label = (bSeparable == false) ? "scene" :
+		((FragmentShaderCode.empty() == true) ? "scene vertex stage" : "scene fragment stage");
+
+	if (m_bUseProgramBinaryCache == true)
+	{
+		program.programID = LoadProgramBinary(program.cachePath, program.cacheKey, bSeparable);
+	}
+	if (0 != program.programID)
+	{
+		program.bReady = true;
+		OnProgramLinked(program);
+		LabelProgram(program.programID, permutation, label);
+	}
+	else
+	{
+		LOG_INFO("Building %s permutation %d [%s]", label, permutation, GetPermutationName(permutation).c_str());
+		SubmitProgram(program, VertexShaderCode, FragmentShaderCode, bSeparable);
+	}
+}
+
+/***********************************************************
+ *  SubmitProgram()
+ *
+ *  This method is used for handing the passed in vertex and
+ *  fragment shader source to the driver for compiling and
+ *  linking, without querying any status that would wait for
+ *  the result. FinishProgram() collects the result.
+ ***********************************************************/
+void ShaderManager::SubmitProgram(
+	PROGRAM_INFO& program,
+	const std::string& VertexShaderCode,
+	const std::string& FragmentShaderCode,
+	bool bSeparable)
+{
+	PROFILE_SCOPE("shader compile submit");
+	// Create the shaders
+	program.vertexShaderID = (VertexShaderCode.empty() == false) ? glCreateShader(GL_VERTEX_SHADER) : 0;
+	program.fragmentShaderID = (FragmentShaderCode.empty() == false) ? glCreateShader(GL_FRAGMENT_SHADER) : 0;
+
+	// Compile Vertex Shader
+	if (0 != program.vertexShaderID)
+	{
+		char const * VertexSourcePointer = VertexShaderCode.c_str();
+		glShaderSource(program.vertexShaderID, 1, &VertexSourcePointer , NULL);
+		glCompileShader(program.vertexShaderID);
 	}
 
-	printf("success\n");
+	// Compile Fragment Shader
+	if (0 != program.fragmentShaderID)
+	{
+		char const * FragmentSourcePointer = FragmentShaderCode.c_str();
+		glShaderSource(program.fragmentShaderID, 1, &FragmentSourcePointer , NULL);
+		glCompileShader(program.fragmentShaderID);
+	}
 
 	// Link the program
-	printf("Linking shader program...");
-	GLuint ProgramID = glCreateProgram();
-	m_programID = ProgramID;
-	glAttachShader(ProgramID, VertexShaderID);
-	glAttachShader(ProgramID, FragmentShaderID);
-	glLinkProgram(ProgramID);
+	program.programID = glCreateProgram();
+	if (0 != program.vertexShaderID)
+	{
+		glAttachShader(program.programID, program.vertexShaderID);
+	}
+	if (0 != program.fragmentShaderID)
+	{
+		glAttachShader(program.programID, program.fragmentShaderID);
+	}
+	if (bSeparable == true)
+	{
+		// a single stage linked on its own, for program pipelines
+		glProgramParameteri(program.programID, GL_PROGRAM_SEPARABLE, GL_TRUE);
+	}
+	if (m_bUseProgramBinaryCache == true)
+	{
+		glProgramParameteri(program.programID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	}
+	glLinkProgram(program.programID);
+
+	program.bReady = false;
+}
+
+/***********************************************************
+ *  FinishProgram()
+ *
+ *  This method is used for collecting the compile and link
+ *  results of a submitted program, waiting for the driver
+ *  if it is still working, and preparing it for use.
+ ***********************************************************/
+void ShaderManager::FinishProgram(PROGRAM_INFO& program, int permutation, const char* label)
+{
+	PROFILE_SCOPE("shader compile finish");
+	GLint Result = GL_FALSE;
+	int InfoLogLength;
+
+	// Check Vertex Shader
+	if (0 != program.vertexShaderID)
+	{
+		LOG_INFO("Compiling shader : %s", m_vertexShaderPath.c_str());
+		glGetShaderiv(program.vertexShaderID, GL_COMPILE_STATUS, &Result);
+		glGetShaderiv(program.vertexShaderID, GL_INFO_LOG_LENGTH, &InfoLogLength);
+		if ( InfoLogLength > 0 ){
+			std::vector<char> VertexShaderErrorMessage(InfoLogLength+1);
+			glGetShaderInfoLog(program.vertexShaderID, InfoLogLength, NULL, &VertexShaderErrorMessage[0]);
+			LogBuildMessage(Result, &VertexShaderErrorMessage[0]);
+		}
+
+	}
+
+	// Check Fragment Shader
+	if (0 != program.fragmentShaderID)
+	{
+		LOG_INFO("Compiling shader : %s", m_fragmentShaderPath.c_str());
+		glGetShaderiv(program.fragmentShaderID, GL_COMPILE_STATUS, &Result);
+		glGetShaderiv(program.fragmentShaderID, GL_INFO_LOG_LENGTH, &InfoLogLength);
+		if ( InfoLogLength > 0 ){
+			std::vector<char> FragmentShaderErrorMessage(InfoLogLength+1);
+			glGetShaderInfoLog(program.fragmentShaderID, InfoLogLength, NULL, &FragmentShaderErrorMessage[0]);
+			LogBuildMessage(Result, &FragmentShaderErrorMessage[0]);
+		}
+
+	}
 
 	// Check the program
-	glGetProgramiv(ProgramID, GL_LINK_STATUS, &Result);
-	glGetProgramiv(ProgramID, GL_INFO_LOG_LENGTH, &InfoLogLength);
+	LOG_INFO("Linking shader program [%s]", GetPermutationName(permutation).c_str());
+	glGetProgramiv(program.programID, GL_LINK_STATUS, &Result);
+	glGetProgramiv(program.programID, GL_INFO_LOG_LENGTH, &InfoLogLength);
 	if ( InfoLogLength > 1 ){
 		std::vector<char> ProgramErrorMessage(InfoLogLength+1);
-		glGetProgramInfoLog(ProgramID, InfoLogLength, NULL, &ProgramErrorMessage[0]);
-		printf("\n%s\n", &ProgramErrorMessage[0]);
+		glGetProgramInfoLog(program.programID, InfoLogLength, NULL, &ProgramErrorMessage[0]);
+		LogBuildMessage(Result, &ProgramErrorMessage[0]);
 	}
 
-	printf("success\n");
-	
-	glDetachShader(ProgramID, VertexShaderID);
-	glDetachShader(ProgramID, FragmentShaderID);
 	
-	glDeleteShader(VertexShaderID);
-	glDeleteShader(FragmentShaderID);
+	if (0 != program.vertexShaderID)
+	{
+		glDetachShader(program.programID, program.vertexShaderID);
+		glDeleteShader(program.vertexShaderID);
+	}
+	if (0 != program.fragmentShaderID)
+	{
+		glDetachShader(program.programID, program.fragmentShaderID);
+		glDeleteShader(program.fragmentShaderID);
+	}
+	program.vertexShaderID = 0;
+	program.fragmentShaderID = 0;
 
-	return ProgramID;
+	if ((m_bUseProgramBinaryCache == true) && (Result == GL_TRUE))
+	{
+		SaveProgramBinary(program.programID, program.cachePath, program.cacheKey);
+	}
+
+	program.bReady = true;
+	OnProgramLinked(program);
+	LabelProgram(program.programID, permutation, label);
+}
+
+/***********************************************************
+ *  FinishPermutation()
+ *
+ *  This method is used for finishing the program of the
+ *  passed in permutation. With separable programs that is
+ *  its fragment stage and, unless another permutation did
+ *  already, the vertex stage it shares, which are then
+ *  joined by their pipeline.
+ ***********************************************************/
+void ShaderManager::FinishPermutation(PROGRAM_INFO* programs, PROGRAM_INFO* vertexStages, int permutation)
+{
+	PROGRAM_INFO& program = programs[permutation];
+	if (program.bSeparable == false)
+	{
+		FinishProgram(program, permutation);
+		return;
+	}
+
+	PROGRAM_INFO& vertexStage = GetVertexStage(vertexStages, permutation);
+	if ((vertexStage.bReady == false) && (0 != vertexStage.programID))
+	{
+		FinishProgram(vertexStage, permutation & VERTEX_PERMUTATION_MASK, "scene vertex stage");
+	}
+	if ((program.bReady == false) && (0 != program.programID))
+	{
+		FinishProgram(program, permutation, "scene fragment stage");
+	}
+	JoinStages(program, vertexStage, permutation);
+}
+
+/***********************************************************
+ *  JoinStages()
+ *
+ *  This method is used for giving a separable fragment stage
+ *  the pipeline with its vertex stage, once both are ready
+ *  and linked. A stage that failed to link leaves the
+ *  permutation without a pipeline, drawing with its fallback.
+ ***********************************************************/
+void ShaderManager::JoinStages(PROGRAM_INFO& program, const PROGRAM_INFO& vertexStage, int permutation)
+{
+	if ((program.bSeparable == false) || (0 != program.pipelineID) ||
+		(program.bReady == false) || (vertexStage.bReady == false))
+	{
+		return;
+	}
+
+	GLint vertexLinked = GL_FALSE;
+	GLint fragmentLinked = GL_FALSE;
+	glGetProgramiv(vertexStage.programID, GL_LINK_STATUS, &vertexLinked);
+	glGetProgramiv(program.programID, GL_LINK_STATUS, &fragmentLinked);
+	if ((vertexLinked != GL_TRUE) || (fragmentLinked != GL_TRUE))
+	{
+		return;
+	}
+
+	program.pipelineID = GetProgramPipeline(vertexStage.programID, program.programID);
+	program.activeStage = program.programID;
+	if (GLDebug::IsEnabled() == true)
+	{
+		GLDebug::Label(GL_PROGRAM_PIPELINE, program.pipelineID,
+			("scene pipeline " + GetPermutationName(permutation)).c_str());
+	}
+}
+
+/***********************************************************
+ *  LabelProgram()
+ *
+ *  This method is used for naming a permutation program
+ *  after its defines in the GL debug mode.
+ ***********************************************************/
+void ShaderManager::LabelProgram(GLuint programID, int permutation, const char* label)
+{
+	if (GLDebug::IsEnabled() == true)
+	{
+		GLDebug::Label(GL_PROGRAM, programID, (std::string(label) + " " + GetPermutationName(permutation)).c_str());
+	}
+}
+
+/***********************************************************
+ *  PollPendingPrograms()
+ *
+ *  This method is called once per frame, between frames, to
+ *  finish every submitted program the driver has completed
+ *  without waiting on the ones that are still compiling,
+ *  and to start or complete a hot reload of the shaders.
+ *  Returns the number of programs that are still pending.
+ ***********************************************************/
+int ShaderManager::PollPendingPrograms()
+{
+	// the watcher thread only raises the flags, the rebuild
+	// itself has to run on the thread that owns the context;
+	// every flag is taken, so a save of several files rebuilds
+	// once, and the changed files are read again
+	if (NULL != m_pFileWatcher)
+	{
+		bool bChanged = false;
+		for (size_t i = 0; i < m_sourceWatches.size(); i++)
+		{
+			if (m_pFileWatcher->TakeChange(m_sourceWatches[i]) == true)
+			{
+				m_sourceFiles.erase(m_watchedFiles[i]);
+				bChanged = true;
+			}
+		}
+		if (bChanged == true)
+		{
+			BeginReload();
+		}
+	}
+
+	int pendingCount = FinishCompletedPrograms(m_programs, m_vertexStages);
+
+	if (m_bReloadPending == true)
+	{
+		int reloadPendingCount = FinishCompletedPrograms(m_reloadPrograms, m_reloadVertexStages);
+		if (reloadPendingCount == 0)
+		{
+			CompleteReload();
+		}
+		pendingCount += reloadPendingCount;
+	}
+
+	return(pendingCount);
 }
 
+/***********************************************************
+ *  FinishCompletedPrograms()
+ *
+ *  This method is used for finishing the programs of the
+ *  passed in permutation set that the driver has completed.
+ *  Returns the number of programs that are still pending.
+ ***********************************************************/
+int ShaderManager::FinishCompletedPrograms(PROGRAM_INFO* programs, PROGRAM_INFO* vertexStages)
+{
+	int pendingCount = 0;
+
+	for (int permutation = 0; permutation < PERMUTATION_COUNT; permutation++)
+	{
+		PROGRAM_INFO& program = programs[permutation];
+		if ((IsProgramReady(program) == true) || (0 == program.programID))
+		{
+			continue;
+		}
+
+		// a separable permutation waits for its vertex stage as well
+		const PROGRAM_INFO& vertexStage = GetVertexStage(vertexStages, permutation);
+		GLint bCompleted = GL_TRUE;
+		if (m_bParallelCompile == true)
+		{
+			if (program.bReady == false)
+			{
+				glGetProgramiv(program.programID, GL_COMPLETION_STATUS_KHR, &bCompleted);
+			}
+			if ((bCompleted == GL_TRUE) && (program.bSeparable == true) &&
+				(vertexStage.bReady == false) && (0 != vertexStage.programID))
+			{
+				glGetProgramiv(vertexStage.programID, GL_COMPLETION_STATUS_KHR, &bCompleted);
+			}
+		}
+		if ((program.bReady == true) && (program.bSeparable == true) && (vertexStage.bReady == true))
+		{
+			// both stages finished, and one failed to link; nothing
+			// more will come of this permutation
+			continue;
+		}
+		if (bCompleted == GL_TRUE)
+		{
+			FinishPermutation(programs, vertexStages, permutation);
+		}
+		else
+		{
+			pendingCount++;
+		}
+	}
+
+	return(pendingCount);
+}
 
+/***********************************************************
+ *  BeginReload()
+ *
+ *  This method is used for rebuilding the shader files of
+ *  the last LoadShaders() call into the reload programs,
+ *  while the current programs keep drawing. Files the edit
+ *  started including are watched from now on.
+ ***********************************************************/
+void ShaderManager::BeginReload()
+{
+	std::string VertexShaderCode;
+	std::string FragmentShaderCode;
+	if (ReadShaderSources(m_vertexShaderPath.c_str(), m_fragmentShaderPath.c_str(),
+		VertexShaderCode, FragmentShaderCode, &m_sceneSourceFiles) == false)
+	{
+		return;
+	}
+	WatchSourceFiles();
+
+	LOG_INFO("Shader source changed, reloading...");
+
+	// a reload still in flight is replaced by the newer sources
+	SubmitPermutations(m_reloadPrograms, m_reloadVertexStages, VertexShaderCode, FragmentShaderCode);
+	m_bReloadPending = true;
+}
+
+/***********************************************************
+ *  CompleteReload()
+ *
+ *  This method is used for swapping the finished reload
+ *  programs in for the current ones, but only when every
+ *  permutation linked, so a typo in the shader keeps the
+ *  previous programs drawing.
+ ***********************************************************/
+void ShaderManager::CompleteReload()
+{
+	m_bReloadPending = false;
+
+	for (int permutation = 0; permutation < PERMUTATION_COUNT; permutation++)
+	{
+		GLint Result = GL_FALSE;
+		glGetProgramiv(m_reloadPrograms[permutation].programID, GL_LINK_STATUS, &Result);
+		if ((Result == GL_TRUE) && (0 != m_reloadVertexStages[permutation].programID))
+		{
+			glGetProgramiv(m_reloadVertexStages[permutation].programID, GL_LINK_STATUS, &Result);
+		}
+		if (Result != GL_TRUE)
+		{
+			LOG_WARNING("Shader reload failed, keeping the current programs");
+			for (int i = 0; i < PERMUTATION_COUNT; i++)
+			{
+				ReleaseProgram(m_reloadPrograms[i]);
+				ReleaseProgram(m_reloadVertexStages[i]);
+			}
+			return;
+		}
+	}
+
+	for (int permutation = 0; permutation < PERMUTATION_COUNT; permutation++)
+	{
+		ReleaseProgram(m_programs[permutation]);
+		ReleaseProgram(m_vertexStages[permutation]);
+		std::swap(m_programs[permutation], m_reloadPrograms[permutation]);
+		std::swap(m_vertexStages[permutation], m_reloadVertexStages[permutation]);
+	}
+
+	// the new programs start from their default values, so
+	// re-send every value that was set through a handle
+	m_programID = m_programs[m_currentPermutation].programID;
+	BindProgram(m_programs[m_currentPermutation]);
+	ApplyUniformHandles();
+
+	LOG_INFO("Shaders reloaded");
+}
+
+/***********************************************************
+ *  StartFileWatcher()
+ *
+ *  This method is used for watching the shader files of the
+ *  last LoadShaders() call, and the files they include, for
+ *  changes, so PollPendingPrograms() can reload them.
+ ***********************************************************/
+void ShaderManager::StartFileWatcher(FileWatcher* pWatcher)
+{
+	if ((NULL == pWatcher) || (m_vertexShaderPath.empty()))
+	{
+		m_pFileWatcher = NULL;
+		return;
+	}
+
+	if (pWatcher != m_pFileWatcher)
+	{
+		m_sourceWatches.clear();
+		m_watchedFiles.clear();
+	}
+	m_pFileWatcher = pWatcher;
+	WatchSourceFiles();
+
+	LOG_INFO("Watching %s, %s and %d included files for changes", m_vertexShaderPath.c_str(),
+		m_fragmentShaderPath.c_str(), (int)m_sceneSourceFiles.size() - 2);
+}
+
+/***********************************************************
+ *  WatchSourceFiles()
+ *
+ *  This method is used for adding a watch for every file of
+ *  the scene shaders that has none yet. A file no longer
+ *  included keeps its watch, which only costs a reload.
+ ***********************************************************/
+void ShaderManager::WatchSourceFiles()
+{
+	if (NULL == m_pFileWatcher)
+	{
+		return;
+	}
+
+	for (size_t i = 0; i < m_sceneSourceFiles.size(); i++)
+	{
+		if (std::find(m_watchedFiles.begin(), m_watchedFiles.end(), m_sceneSourceFiles[i]) == m_watchedFiles.end())
+		{
+			m_sourceWatches.push_back(m_pFileWatcher->Watch(m_sceneSourceFiles[i]));
+			m_watchedFiles.push_back(m_sceneSourceFiles[i]);
+		}
+	}
+}
+
+/***********************************************************
+ *  ReleaseProgram()
+ *
+ *  This method is used for deleting a permutation's program
+ *  and any shaders still attached from a pending build.
+ ***********************************************************/
+void ShaderManager::ReleaseProgram(PROGRAM_INFO& program)
+{
+	if ((program.bSeparable == true) && (0 != program.programID))
+	{
+		ReleaseProgramPipelines(program.programID);
+	}
+	program.bSeparable = false;
+	program.bSpirv = false;
+	program.pipelineID = 0;
+	program.activeStage = 0;
+	if (0 != program.vertexShaderID)
+	{
+		glDeleteShader(program.vertexShaderID);
+		program.vertexShaderID = 0;
+	}
+	if (0 != program.fragmentShaderID)
+	{
+		glDeleteShader(program.fragmentShaderID);
+		program.fragmentShaderID = 0;
+	}
+	if (0 != program.programID)
+	{
+		glDeleteProgram(program.programID);
+		program.programID = 0;
+	}
+	program.bReady = false;
+	program.uniformCache.clear();
+	for (size_t i = 0; i < program.uniformStates.size(); i++)
+	{
+		program.uniformStates[i].location = -1;
+		program.uniformStates[i].bHasValue = false;
+	}
+}
+
+/***********************************************************
+ *  GetPermutationDefines()
+ *
+ *  This method is used for building the #define lines that
+ *  select the passed in permutation in the shader source.
+ ***********************************************************/
+std::string ShaderManager::GetPermutationDefines(int permutation)
+{
+	std::string defines;
+	for (size_t i = 0; i < sizeof(g_PermutationDefines) / sizeof(g_PermutationDefines[0]); i++)
+	{
+		if ((permutation & (1 << i)) != 0)
+		{
+			defines += "#define ";
+			defines += g_PermutationDefines[i];
+			defines += "\n";
+		}
+	}
+	return(defines);
+}
+
+/***********************************************************
+ *  GetPermutationName()
+ *
+ *  This method is used for getting a readable list of the
+ *  defines enabled by the passed in permutation.
+ ***********************************************************/
+std::string ShaderManager::GetPermutationName(int permutation)
+{
+	std::string name;
+	for (size_t i = 0; i < sizeof(g_PermutationDefines) / sizeof(g_PermutationDefines[0]); i++)
+	{
+		if ((permutation & (1 << i)) != 0)
+		{
+			if (false == name.empty())
+			{
+				name += " ";
+			}
+			name += g_PermutationDefines[i];
+		}
+	}
+	return(name.empty() ? std::string("base") : name);
+}
+
+/***********************************************************
+ *  InjectDefines()
+ *
+ *  This method is used for inserting the define lines into
+ *  the shader source, after the #version line which must be
+ *  the first statement of the shader.
+ ***********************************************************/
+std::string ShaderManager::InjectDefines(const std::string& code, const std::string& defines)
+{
+	if (defines.empty())
+	{
+		return(code);
+	}
+
+	size_t version = code.find("#version");
+	if (version == std::string::npos)
+	{
+		return(defines + code);
+	}
+
+	size_t lineEnd = code.find('\n', version);
+	if (lineEnd == std::string::npos)
+	{
+		return(code + "\n" + defines);
+	}
+
+	std::string injected = code;
+	injected.insert(lineEnd + 1, defines);
+	return(injected);
+}
+
+/***********************************************************
+ *  OnProgramLinked()
+ *
+ *  This method is called once a permutation's program has
+ *  been linked from source or created from a cached binary,
+ *  to prepare the state the rest of the manager relies on.
+ ***********************************************************/
+void ShaderManager::OnProgramLinked(PROGRAM_INFO& program)
+{
+	// point the shared uniform blocks at their fixed bindings
+	BindUniformBlocks(program.programID);
+
+	// resolve every active uniform once so the setters never
+	// have to ask the driver for a location by name
+	CacheUniformLocations(program);
+}
+
+/***********************************************************
+ *  UsePermutation()
+ *
+ *  This method is used for activating the program built for
+ *  the passed in PERMUTATION_* flags, or the fallback one
+ *  while that program is still compiling. Uniform values set
+ *  through handles follow the switch, so every program sees
+ *  the values that were set while another one was active.
+ ***********************************************************/
+void ShaderManager::UsePermutation(int permutation)
+{
+	if ((permutation < 0) || (permutation >= PERMUTATION_COUNT))
+	{
+		return;
+	}
+	// draw with the fallback program while the real one compiles
+	if (IsProgramReady(m_programs[permutation]) == false)
+	{
+		permutation = GetFallbackPermutation(permutation);
+	}
+	if ((permutation == m_currentPermutation) && (m_bExternalProgram == false))
+	{
+		m_stateStats.programSkips++;
+		return;
+	}
+
+	m_currentPermutation = permutation;
+	m_bExternalProgram = false;
+	BindProgram(m_programs[permutation]);
+	m_stateStats.programSwitches++;
+
+	// bring the new program up to date with the handle values
+	ApplyUniformHandles();
+}
+
+/***********************************************************
+ *  BindProgram()
+ *
+ *  This method is used for making the program of a
+ *  permutation, or the pipeline of its separable stages,
+ *  the one drawn with. A bound program takes precedence over
+ *  a bound pipeline, so the program binding is cleared.
+ ***********************************************************/
+void ShaderManager::BindProgram(const PROGRAM_INFO& program)
+{
+	m_programID = program.programID;
+	if (0 != program.pipelineID)
+	{
+		glUseProgram(0);
+		glBindProgramPipeline(program.pipelineID);
+	}
+	else
+	{
+		glUseProgram(m_programID);
+	}
+}
+
+/***********************************************************
+ *  GetProgramPipeline()
+ *
+ *  This method is used for finding the pipeline joining the
+ *  passed in separable stage programs, creating it the first
+ *  time the pair is asked for. The pipelines are few, one
+ *  per pair drawn with, so a list is searched.
+ ***********************************************************/
+GLuint ShaderManager::GetProgramPipeline(GLuint vertexProgram, GLuint fragmentProgram)
+{
+	for (size_t i = 0; i < m_pipelines.size(); i++)
+	{
+		if ((m_pipelines[i].vertexProgram == vertexProgram) &&
+			(m_pipelines[i].fragmentProgram == fragmentProgram))
+		{
+			return(m_pipelines[i].pipelineID);
+		}
+	}
+
+	PIPELINE_INFO pipeline;
+	pipeline.vertexProgram = vertexProgram;
+	pipeline.fragmentProgram = fragmentProgram;
+	pipeline.pipelineID = 0;
+	glGenProgramPipelines(1, &pipeline.pipelineID);
+	glUseProgramStages(pipeline.pipelineID, GL_VERTEX_SHADER_BIT, vertexProgram);
+	glUseProgramStages(pipeline.pipelineID, GL_FRAGMENT_SHADER_BIT, fragmentProgram);
+	// glUniform*() reaches the fragment stage unless a lookup
+	// found the uniform in the vertex stage
+	glActiveShaderProgram(pipeline.pipelineID, fragmentProgram);
+	m_pipelines.push_back(pipeline);
+
+	return(pipeline.pipelineID);
+}
+
+/***********************************************************
+ *  ReleaseProgramPipelines()
+ *
+ *  This method is used for deleting every cached pipeline
+ *  using the passed in stage program, and forgetting it in
+ *  the permutations that were drawing with it.
+ ***********************************************************/
+void ShaderManager::ReleaseProgramPipelines(GLuint programID)
+{
+	size_t kept = 0;
+	for (size_t i = 0; i < m_pipelines.size(); i++)
+	{
+		const PIPELINE_INFO& pipeline = m_pipelines[i];
+		if ((pipeline.vertexProgram != programID) && (pipeline.fragmentProgram != programID))
+		{
+			m_pipelines[kept++] = pipeline;
+			continue;
+		}
+
+		for (int permutation = 0; permutation < PERMUTATION_COUNT; permutation++)
+		{
+			PROGRAM_INFO* programs[2] = { &m_programs[permutation], &m_reloadPrograms[permutation] };
+			for (int j = 0; j < 2; j++)
+			{
+				if (programs[j]->pipelineID == pipeline.pipelineID)
+				{
+					programs[j]->pipelineID = 0;
+				}
+			}
+		}
+		glDeleteProgramPipelines(1, &pipeline.pipelineID);
+	}
+	m_pipelines.resize(kept);
+}
+
+/***********************************************************
+ *  UseProgramPipeline()
+ *
+ *  This method is used for activating a pipeline of
+ *  GetProgramPipeline() the way UseExternalProgram()
+ *  activates a program.
+ ***********************************************************/
+void ShaderManager::UseProgramPipeline(GLuint pipelineID)
+{
+	glUseProgram(0);
+	glBindProgramPipeline(pipelineID);
+	m_bExternalProgram = true;
+	m_stateStats.programSwitches++;
+}
+
+/***********************************************************
+ *  LoadStageProgram()
+ *
+ *  This method is used for building a separable program of
+ *  one stage from an external GLSL file, with the defines of
+ *  the passed in permutation, for passes that pair their own
+ *  stage with a stage of another program in a pipeline. It
+ *  waits for the compile and link, and returns 0 after
+ *  printing the log when either one fails.
+ ***********************************************************/
+GLuint ShaderManager::LoadStageProgram(GLenum shaderType, const char* file_path, int permutation)
+{
+	PROFILE_SCOPE("shader compile");
+	std::string ShaderCode;
+	if ((ReadShaderSource(file_path, ShaderCode) == false) || (ShaderCode.empty() == true))
+	{
+		LOG_ERROR("Impossible to open %s", file_path);
+		return 0;
+	}
+
+	std::string defines = GetPermutationDefines(permutation);
+	if (m_bMultiview == true)
+	{
+		defines += "#define USE_MULTIVIEW\n";
+	}
+	if (m_bHalfPrecision == true)
+	{
+		defines += "#define USE_HALF_PRECISION\n";
+	}
+	defines += "#define USE_SEPARABLE\n";
+	ShaderCode = InjectDefines(ShaderCode, defines);
+
+	PROGRAM_INFO program;
+	program.programID = 0;
+	program.vertexShaderID = 0;
+	program.fragmentShaderID = 0;
+	SubmitProgram(program,
+		(shaderType == GL_VERTEX_SHADER) ? ShaderCode : std::string(),
+		(shaderType == GL_FRAGMENT_SHADER) ? ShaderCode : std::string(), true);
+
+	GLint Result = GL_FALSE;
+	int InfoLogLength;
+	GLuint shaderID = (0 != program.vertexShaderID) ? program.vertexShaderID : program.fragmentShaderID;
+	LOG_INFO("Compiling shader : %s", file_path);
+	glGetShaderiv(shaderID, GL_COMPILE_STATUS, &Result);
+	glGetShaderiv(shaderID, GL_INFO_LOG_LENGTH, &InfoLogLength);
+	if (InfoLogLength > 1)
+	{
+		std::vector<char> ShaderErrorMessage(InfoLogLength+1);
+		glGetShaderInfoLog(shaderID, InfoLogLength, NULL, &ShaderErrorMessage[0]);
+		LogBuildMessage(Result, &ShaderErrorMessage[0]);
+	}
+	bool bCompiled = (Result == GL_TRUE);
+
+	glGetProgramiv(program.programID, GL_LINK_STATUS, &Result);
+	glGetProgramiv(program.programID, GL_INFO_LOG_LENGTH, &InfoLogLength);
+	if (InfoLogLength > 1)
+	{
+		std::vector<char> ProgramErrorMessage(InfoLogLength+1);
+		glGetProgramInfoLog(program.programID, InfoLogLength, NULL, &ProgramErrorMessage[0]);
+		LogBuildMessage(Result, &ProgramErrorMessage[0]);
+	}
+
+	glDetachShader(program.programID, shaderID);
+	glDeleteShader(shaderID);
+	if ((bCompiled == false) || (Result != GL_TRUE))
+	{
+		glDeleteProgram(program.programID);
+		return 0;
+	}
+
+	BindUniformBlocks(program.programID);
+	GLDebug::Label(GL_PROGRAM, program.programID, file_path);
+	return program.programID;
+}
+
+/***********************************************************
+ *  LoadComputeShader()
+ *
+ *  This method is used for building a compute program from
+ *  an external GLSL file, waiting for the compile and link.
+ *  Returns 0 and prints the log when either one fails.
+ ***********************************************************/
+GLuint ShaderManager::LoadComputeShader(const char* compute_file_path)
+{
+	PROFILE_SCOPE("shader compile");
+	std::string ComputeShaderCode;
+	if (ReadShaderSource(compute_file_path, ComputeShaderCode) == false)
+	{
+		LOG_ERROR("Impossible to open %s.", compute_file_path);
+		return 0;
+	}
+
+	GLint Result = GL_FALSE;
+	int InfoLogLength;
+
+	LOG_INFO("Compiling shader : %s", compute_file_path);
+	GLuint ComputeShaderID = glCreateShader(GL_COMPUTE_SHADER);
+	char const * ComputeSourcePointer = ComputeShaderCode.c_str();
+	glShaderSource(ComputeShaderID, 1, &ComputeSourcePointer, NULL);
+	glCompileShader(ComputeShaderID);
+	glGetShaderiv(ComputeShaderID, GL_COMPILE_STATUS, &Result);
+	glGetShaderiv(ComputeShaderID, GL_INFO_LOG_LENGTH, &InfoLogLength);
+	if (InfoLogLength > 1)
+	{
+		std::vector<char> ComputeShaderErrorMessage(InfoLogLength+1);
+		glGetShaderInfoLog(ComputeShaderID, InfoLogLength, NULL, &ComputeShaderErrorMessage[0]);
+		LogBuildMessage(Result, &ComputeShaderErrorMessage[0]);
+	}
+	if (Result != GL_TRUE)
+	{
+		glDeleteShader(ComputeShaderID);
+		return 0;
+	}
+
+	GLuint ProgramID = glCreateProgram();
+	glAttachShader(ProgramID, ComputeShaderID);
+	glLinkProgram(ProgramID);
+	glGetProgramiv(ProgramID, GL_LINK_STATUS, &Result);
+	glGetProgramiv(ProgramID, GL_INFO_LOG_LENGTH, &InfoLogLength);
+	if (InfoLogLength > 1)
+	{
+		std::vector<char> ProgramErrorMessage(InfoLogLength+1);
+		glGetProgramInfoLog(ProgramID, InfoLogLength, NULL, &ProgramErrorMessage[0]);
+		LogBuildMessage(Result, &ProgramErrorMessage[0]);
+	}
+
+	glDetachShader(ProgramID, ComputeShaderID);
+	glDeleteShader(ComputeShaderID);
+	if (Result != GL_TRUE)
+	{
+		glDeleteProgram(ProgramID);
+		return 0;
+	}
+
+	BindUniformBlocks(ProgramID);
+	GLDebug::Label(GL_PROGRAM, ProgramID, compute_file_path);
+	return ProgramID;
+}
+
+/***********************************************************
+ *  LoadExternalProgram()
+ *
+ *  This method is used for building a program from external
+ *  vertex and fragment shader files, for passes that draw
+ *  with a single shader of their own. It waits for the
+ *  compile and link like a plain program load, and returns
+ *  0 after printing the log when either one fails.
+ ***********************************************************/
+GLuint ShaderManager::LoadExternalProgram(
+	const char* vertex_file_path,
+	const char* fragment_file_path)
+{
+	PROFILE_SCOPE("shader compile");
+	std::string VertexShaderCode;
+	std::string FragmentShaderCode;
+	if ((ReadShaderSources(vertex_file_path, fragment_file_path, VertexShaderCode, FragmentShaderCode) == false) ||
+		(FragmentShaderCode.empty() == true))
+	{
+		return 0;
+	}
+
+	PROGRAM_INFO program;
+	program.programID = 0;
+	program.vertexShaderID = 0;
+	program.fragmentShaderID = 0;
+	SubmitProgram(program, VertexShaderCode, FragmentShaderCode);
+
+	GLint Result = GL_FALSE;
+	int InfoLogLength;
+	GLuint shaders[2] = { program.vertexShaderID, program.fragmentShaderID };
+	const char* paths[2] = { vertex_file_path, fragment_file_path };
+	bool bCompiled = true;
+	for (int i = 0; i < 2; i++)
+	{
+		LOG_INFO("Compiling shader : %s", paths[i]);
+		glGetShaderiv(shaders[i], GL_COMPILE_STATUS, &Result);
+		glGetShaderiv(shaders[i], GL_INFO_LOG_LENGTH, &InfoLogLength);
+		if (InfoLogLength > 1)
+		{
+			std::vector<char> ShaderErrorMessage(InfoLogLength+1);
+			glGetShaderInfoLog(shaders[i], InfoLogLength, NULL, &ShaderErrorMessage[0]);
+			LogBuildMessage(Result, &ShaderErrorMessage[0]);
+		}
+		bCompiled = bCompiled && (Result == GL_TRUE);
+	}
+
+	glGetProgramiv(program.programID, GL_LINK_STATUS, &Result);
+	glGetProgramiv(program.programID, GL_INFO_LOG_LENGTH, &InfoLogLength);
+	if (InfoLogLength > 1)
+	{
+		std::vector<char> ProgramErrorMessage(InfoLogLength+1);
+		glGetProgramInfoLog(program.programID, InfoLogLength, NULL, &ProgramErrorMessage[0]);
+		LogBuildMessage(Result, &ProgramErrorMessage[0]);
+	}
+
+	for (int i = 0; i < 2; i++)
+	{
+		glDetachShader(program.programID, shaders[i]);
+		glDeleteShader(shaders[i]);
+	}
+	if ((bCompiled == false) || (Result != GL_TRUE))
+	{
+		glDeleteProgram(program.programID);
+		return 0;
+	}
+
+	BindUniformBlocks(program.programID);
+	GLDebug::Label(GL_PROGRAM, program.programID, fragment_file_path);
+	return program.programID;
+}
+
+/***********************************************************
+ *  LoadMeshShaderProgram()
+ *
+ *  This method is used for building a program that replaces
+ *  the vertex stage with the task and mesh stages of
+ *  GL_NV_mesh_shader, which this GLEW predates, so the
+ *  extension is looked up by name and its stage enums are
+ *  the ones from the extension spec. The permutation defines
+ *  go into every stage, so the mesh shader writes the
+ *  outputs the fragment shader of that permutation reads.
+ ***********************************************************/
+GLuint ShaderManager::LoadMeshShaderProgram(
+	const char* task_file_path,
+	const char* mesh_file_path,
+	const char* fragment_file_path,
+	int permutation)
+{
+	PROFILE_SCOPE("shader compile");
+	const GLenum TASK_SHADER_NV = 0x955A;
+	const GLenum MESH_SHADER_NV = 0x9559;
+
+	bool bSupported = false;
+	GLint extensionCount = 0;
+	glGetIntegerv(GL_NUM_EXTENSIONS, &extensionCount);
+	for (GLint i = 0; (i < extensionCount) && (bSupported == false); i++)
+	{
+		const char* pExtension = (const char*)glGetStringi(GL_EXTENSIONS, (GLuint)i);
+		bSupported = (NULL != pExtension) && (strcmp(pExtension, "GL_NV_mesh_shader") == 0);
+	}
+	if (bSupported == false)
+	{
+		return 0;
+	}
+
+	const char* paths[3] = { task_file_path, mesh_file_path, fragment_file_path };
+	const GLenum stages[3] = { TASK_SHADER_NV, MESH_SHADER_NV, GL_FRAGMENT_SHADER };
+	GLuint shaders[3] = { 0, 0, 0 };
+	std::string defines = GetPermutationDefines(permutation);
+	GLint Result = GL_FALSE;
+	int InfoLogLength;
+	bool bCompiled = true;
+	for (int i = 0; (i < 3) && (bCompiled == true); i++)
+	{
+		std::string ShaderCode;
+		if (ReadShaderSource(paths[i], ShaderCode) == false)
+		{
+			LOG_ERROR("Impossible to open %s.", paths[i]);
+			bCompiled = false;
+			break;
+		}
+		ShaderCode = InjectDefines(ShaderCode, defines);
+
+		LOG_INFO("Compiling shader : %s", paths[i]);
+		shaders[i] = glCreateShader(stages[i]);
+		char const * SourcePointer = ShaderCode.c_str();
+		glShaderSource(shaders[i], 1, &SourcePointer, NULL);
+		glCompileShader(shaders[i]);
+		glGetShaderiv(shaders[i], GL_COMPILE_STATUS, &Result);
+		glGetShaderiv(shaders[i], GL_INFO_LOG_LENGTH, &InfoLogLength);
+		if (InfoLogLength > 1)
+		{
+			std::vector<char> ShaderErrorMessage(InfoLogLength+1);
+			glGetShaderInfoLog(shaders[i], InfoLogLength, NULL, &ShaderErrorMessage[0]);
+			LogBuildMessage(Result, &ShaderErrorMessage[0]);
+		}
+		bCompiled = (Result == GL_TRUE);
+	}
+
+	GLuint ProgramID = 0;
+	if (bCompiled == true)
+	{
+		ProgramID = glCreateProgram();
+		for (int i = 0; i < 3; i++)
+		{
+			glAttachShader(ProgramID, shaders[i]);
+		}
+		glLinkProgram(ProgramID);
+		glGetProgramiv(ProgramID, GL_LINK_STATUS, &Result);
+		glGetProgramiv(ProgramID, GL_INFO_LOG_LENGTH, &InfoLogLength);
+		if (InfoLogLength > 1)
+		{
+			std::vector<char> ProgramErrorMessage(InfoLogLength+1);
+			glGetProgramInfoLog(ProgramID, InfoLogLength, NULL, &ProgramErrorMessage[0]);
+			LogBuildMessage(Result, &ProgramErrorMessage[0]);
+		}
+		for (int i = 0; i < 3; i++)
+		{
+			glDetachShader(ProgramID, shaders[i]);
+		}
+	}
+	for (int i = 0; i < 3; i++)
+	{
+		if (0 != shaders[i])
+		{
+			glDeleteShader(shaders[i]);
+		}
+	}
+	if ((bCompiled == false) || (Result != GL_TRUE))
+	{
+		if (0 != ProgramID)
+		{
+			glDeleteProgram(ProgramID);
+		}
+		return 0;
+	}
+
+	BindUniformBlocks(ProgramID);
+	GLDebug::Label(GL_PROGRAM, ProgramID, mesh_file_path);
+	return ProgramID;
+}
+
+/***********************************************************
+ *  UseExternalProgram()
+ *
+ *  This method is used for activating a program that is not
+ *  one of the permutations. Uniform handle values set while
+ *  it is active are only stored, and reach the permutation
+ *  programs with the next UsePermutation().
+ ***********************************************************/
+void ShaderManager::UseExternalProgram(GLuint programID)
+{
+	glUseProgram(programID);
+	m_bExternalProgram = true;
+	m_stateStats.programSwitches++;
+}
+
+/***********************************************************
+ *  ApplyUniformHandles()
+ *
+ *  This method is used for uploading every value set through
+ *  a uniform handle that differs from the shadow copy of the
+ *  active program.
+ ***********************************************************/
+void ShaderManager::ApplyUniformHandles()
+{
+	ApplyProgramHandles(m_programs[m_currentPermutation]);
+	if (m_bSeparablePrograms == true)
+	{
+		ApplyProgramHandles(GetVertexStage(m_vertexStages, m_currentPermutation));
+	}
+}
+
+/***********************************************************
+ *  ApplyProgramHandles()
+ *
+ *  This method is used for uploading every handle value
+ *  that differs from the shadow copy of the passed in
+ *  program, the active one or a stage of its pipeline.
+ ***********************************************************/
+void ShaderManager::ApplyProgramHandles(PROGRAM_INFO& program)
+{
+	for (size_t i = 0; i < m_uniformHandles.size(); i++)
+	{
+		const UNIFORM_HANDLE_INFO& handleInfo = m_uniformHandles[i];
+		UNIFORM_STATE& state = program.uniformStates[i];
+		if ((handleInfo.bHasValue == false) || (state.location < 0))
+		{
+			continue;
+		}
+		if ((state.bHasValue == true) && (memcmp(state.lastValue, handleInfo.value, handleInfo.valueSize) == 0))
+		{
+			m_stateStats.uniformSkips++;
+			continue;
+		}
+
+		memcpy(state.lastValue, handleInfo.value, handleInfo.valueSize);
+		state.bHasValue = true;
+		m_stateStats.uniformUploads++;
+		m_uniformHandles[i].uploads++;
+		UploadUniformValue(state.program, state.location, handleInfo.expectedType, handleInfo.value);
+	}
+}
+
+/***********************************************************
+ *  UploadUniformValue()
+ *
+ *  This method is used for uploading a shadowed handle value
+ *  of the passed in GL type to the active program, or to the
+ *  passed in separable stage program.
+ ***********************************************************/
+void ShaderManager::UploadUniformValue(GLuint program, GLint location, GLenum type, const unsigned char* value) const
+{
+	switch (type)
+	{
+	case GL_BOOL: UploadUniform(program, location, *(const bool*)value); break;
+	case GL_INT: UploadUniform(program, location, *(const int*)value); break;
+	case GL_FLOAT: UploadUniform(program, location, *(const float*)value); break;
+	case GL_FLOAT_VEC2: UploadUniform(program, location, *(const glm::vec2*)value); break;
+	case GL_FLOAT_VEC3: UploadUniform(program, location, *(const glm::vec3*)value); break;
+	case GL_FLOAT_VEC4: UploadUniform(program, location, *(const glm::vec4*)value); break;
+	case GL_FLOAT_MAT3: UploadUniform(program, location, *(const glm::mat3*)value); break;
+	case GL_FLOAT_MAT4: UploadUniform(program, location, *(const glm::mat4*)value); break;
+	default: break;
+	}
+}
+
+/***********************************************************
+ *  LoadProgramBinary()
+ *
+ *  This method is used for creating the program from the
+ *  binary cache file. Returns 0 when the file is missing,
+ *  was made from other sources or drivers, or the driver
+ *  rejects the binary, so the caller compiles from source.
+ ***********************************************************/
+GLuint ShaderManager::LoadProgramBinary(const std::string& cachePath, unsigned long long cacheKey, bool bSeparable)
+{
+	GLint formatCount = 0;
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+	if (formatCount <= 0)
+	{
+		return 0;
+	}
+
+	// the binary is handed to GL where it lies in the warm-start
+	// snapshot, or read from the cache file
+	AssetPack::ASSET_VIEW view;
+	if (AssetPack::ReadArtifact(cachePath.c_str(), view) == false)
+	{
+		return 0;
+	}
+
+	size_t offset = 0;
+	PROGRAM_CACHE_HEADER header;
+	if ((AssetPack::ReadView(view, offset, &header, sizeof(header)) == false) ||
+		(header.magic != PROGRAM_CACHE_MAGIC) || (header.cacheKey != cacheKey) ||
+		(header.binaryLength == 0) || (header.binaryLength > view.size - offset))
+	{
+		return 0;
+	}
+
+	GLuint ProgramID = glCreateProgram();
+	if (bSeparable == true)
+	{
+		glProgramParameteri(ProgramID, GL_PROGRAM_SEPARABLE, GL_TRUE);
+	}
+	glProgramBinary(ProgramID, header.binaryFormat, view.pData + offset, (GLsizei)header.binaryLength);
+
+	GLint Result = GL_FALSE;
+	glGetProgramiv(ProgramID, GL_LINK_STATUS, &Result);
+	if (Result != GL_TRUE)
+	{
+		LOG_INFO("Cached shader program %s was rejected, compiling from source", cachePath.c_str());
+		glDeleteProgram(ProgramID);
+		return 0;
+	}
+
+	LOG_INFO("Loaded shader program from cache : %s", cachePath.c_str());
+	AssetPack::NoteArtifact(cachePath.c_str(), false);
+
+	return ProgramID;
+}
+
+/***********************************************************
+ *  SaveProgramBinary()
+ *
+ *  This method is used for writing the binary of the linked
+ *  program into the cache file, replacing any previous one.
+ ***********************************************************/
+void ShaderManager::SaveProgramBinary(GLuint programID, const std::string& cachePath, unsigned long long cacheKey)
+{
+	GLint binaryLength = 0;
+	glGetProgramiv(programID, GL_PROGRAM_BINARY_LENGTH, &binaryLength);
+	if (binaryLength <= 0)
+	{
+		return;
+	}
+
+	std::vector<char> binary(binaryLength);
+	GLenum binaryFormat = GL_NONE;
+	glGetProgramBinary(programID, binaryLength, NULL, &binaryFormat, &binary[0]);
+
+	std::ofstream CacheStream(cachePath.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+	if (!CacheStream.is_open())
+	{
+		LOG_WARNING("Unable to write shader program cache %s", cachePath.c_str());
+		return;
+	}
+
+	PROGRAM_CACHE_HEADER header;
+	header.magic = PROGRAM_CACHE_MAGIC;
+	header.binaryFormat = binaryFormat;
+	header.cacheKey = cacheKey;
+	header.binaryLength = (unsigned int)binaryLength;
+	CacheStream.write((const char*)&header, sizeof(header));
+	CacheStream.write(&binary[0], binaryLength);
+	CacheStream.close();
+	if (CacheStream)
+	{
+		AssetPack::NoteArtifact(cachePath.c_str(), true);
+	}
+}
+
+/***********************************************************
+ *  BindUniformBlocks()
+ *
+ *  This method is called after the program is linked to
+ *  assign every known uniform block to its fixed binding
+ *  point, so one buffer can feed all of the programs.
+ ***********************************************************/
+void ShaderManager::BindUniformBlocks(GLuint programID)
+{
+	for (size_t i = 0; i < sizeof(g_UniformBlocks) / sizeof(g_UniformBlocks[0]); i++)
+	{
+		GLuint blockIndex = glGetUniformBlockIndex(programID, g_UniformBlocks[i].name);
+		if (blockIndex != GL_INVALID_INDEX)
+		{
+			glUniformBlockBinding(programID, blockIndex, g_UniformBlocks[i].binding);
+		}
+	}
+}
+
+/***********************************************************
+ *  CacheUniformLocations()
+ *
+ *  This method is called after the program is linked to
+ *  query all of the active uniforms and store their
+ *  locations, sorted by name hash for fast lookups.
+ ***********************************************************/
+void ShaderManager::CacheUniformLocations(PROGRAM_INFO& program)
+{
+	if (program.bSpirv == true)
+	{
+		CacheSpirvUniformLocations(program);
+		return;
+	}
+
+	GLint uniformCount = 0;
+	GLint maxNameLength = 0;
+
+	std::vector<UNIFORM_INFO>& uniformCache = program.uniformCache;
+	uniformCache.clear();
+
+	glGetProgramiv(program.programID, GL_ACTIVE_UNIFORMS, &uniformCount);
+	glGetProgramiv(program.programID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxNameLength);
+	if ((uniformCount <= 0) || (maxNameLength <= 0))
+	{
+		ResolveUniformHandles(program);
+		return;
+	}
+
+	std::vector<char> nameBuffer(maxNameLength + 1);
+	for (GLint i = 0; i < uniformCount; i++)
+	{
+		GLsizei nameLength = 0;
+		GLint arraySize = 0;
+		GLenum type = GL_NONE;
+		glGetActiveUniform(program.programID, (GLuint)i, maxNameLength, &nameLength, &arraySize, &type, &nameBuffer[0]);
+
+		std::string name(&nameBuffer[0], nameLength);
+		GLint location = glGetUniformLocation(program.programID, name.c_str());
+		if (location < 0)
+		{
+			// uniforms inside blocks have no location
+			continue;
+		}
+
+		// arrays of basic types are reported once as "name[0]", so
+		// register the bare name and every element individually
+		size_t bracket = name.rfind("[0]");
+		if ((bracket != std::string::npos) && (bracket + 3 == name.length()))
+		{
+			std::string baseName = name.substr(0, bracket);
+			uniformCache.push_back({ HashUniformName(baseName.c_str()), location, type, baseName });
+			for (GLint element = 0; element < arraySize; element++)
+			{
+				std::string elementName = baseName + "[" + std::to_string(element) + "]";
+				uniformCache.push_back({ HashUniformName(elementName.c_str()), location + element, type, elementName });
+			}
+		}
+		else
+		{
+			uniformCache.push_back({ HashUniformName(name.c_str()), location, type, name });
+		}
+	}
+
+	std::sort(uniformCache.begin(), uniformCache.end(),
+		[](const UNIFORM_INFO& a, const UNIFORM_INFO& b) { return(a.hash < b.hash); });
+
+	LOG_DEBUG("Cached %d active uniform locations", (int)uniformCache.size());
+
+	// handles resolved against a previous program must follow the new one
+	ResolveUniformHandles(program);
+}
+
+/***********************************************************
+ *  CacheSpirvUniformLocations()
+ *
+ *  This method is used for caching the active uniforms of a
+ *  program made from SPIR-V modules, which have no names to
+ *  query. Each active uniform is reported with the location
+ *  it was declared with, which names it through the table
+ *  of g_SpirvUniforms.
+ ***********************************************************/
+void ShaderManager::CacheSpirvUniformLocations(PROGRAM_INFO& program)
+{
+	std::vector<UNIFORM_INFO>& uniformCache = program.uniformCache;
+	uniformCache.clear();
+
+	GLint uniformCount = 0;
+	glGetProgramInterfaceiv(program.programID, GL_UNIFORM, GL_ACTIVE_RESOURCES, &uniformCount);
+	const GLenum properties[2] = { GL_LOCATION, GL_TYPE };
+	for (GLint i = 0; i < uniformCount; i++)
+	{
+		GLint values[2] = { -1, GL_NONE };
+		glGetProgramResourceiv(program.programID, GL_UNIFORM, (GLuint)i, 2, properties, 2, NULL, values);
+		if (values[0] < 0)
+		{
+			// uniforms inside blocks have no location
+			continue;
+		}
+		for (size_t j = 0; j < sizeof(g_SpirvUniforms) / sizeof(g_SpirvUniforms[0]); j++)
+		{
+			if (g_SpirvUniforms[j].location == values[0])
+			{
+				uniformCache.push_back({ HashUniformName(g_SpirvUniforms[j].name), values[0], (GLenum)values[1],
+					g_SpirvUniforms[j].name });
+				break;
+			}
+		}
+	}
+
+	std::sort(uniformCache.begin(), uniformCache.end(),
+		[](const UNIFORM_INFO& a, const UNIFORM_INFO& b) { return(a.hash < b.hash); });
+
+	LOG_DEBUG("Cached %d active uniform locations", (int)uniformCache.size());
+
+	ResolveUniformHandles(program);
+}
+
+/***********************************************************
+ *  GetUniformLocation()
+ *
+ *  This method is used for getting the cached location of
+ *  the named uniform. Returns -1 for unknown names, which
+ *  the glUniform*() calls silently ignore. With separable
+ *  programs a uniform of the vertex stage makes that stage
+ *  the one of the pipeline that glUniform*() reaches.
+ ***********************************************************/
+GLint ShaderManager::GetUniformLocation(const char* name) const
+{
+	const PROGRAM_INFO& program = m_programs[m_currentPermutation];
+	const UNIFORM_INFO* uniform = FindUniform(program, name);
+	if (0 == program.pipelineID)
+	{
+		return((NULL != uniform) ? uniform->location : -1);
+	}
+
+	GLuint owner = program.programID;
+	if (NULL == uniform)
+	{
+		const PROGRAM_INFO& vertexStage = GetVertexStage(m_vertexStages, m_currentPermutation);
+		uniform = FindUniform(vertexStage, name);
+		owner = (NULL != uniform) ? vertexStage.programID : owner;
+	}
+	if (owner != program.activeStage)
+	{
+		glActiveShaderProgram(program.pipelineID, owner);
+		program.activeStage = owner;
+	}
+
+	return((NULL != uniform) ? uniform->location : -1);
+}
+
+/***********************************************************
+ *  FindUniform()
+ *
+ *  This method is used for finding the cache entry of the
+ *  named active uniform in the passed in program. Returns
+ *  NULL for unknown names.
+ ***********************************************************/
+const ShaderManager::UNIFORM_INFO* ShaderManager::FindUniform(const PROGRAM_INFO& program, const char* name) const
+{
+	unsigned int hash = HashUniformName(name);
+	const std::vector<UNIFORM_INFO>& uniformCache = program.uniformCache;
+
+	std::vector<UNIFORM_INFO>::const_iterator entry = std::lower_bound(
+		uniformCache.begin(), uniformCache.end(), hash,
+		[](const UNIFORM_INFO& info, unsigned int value) { return(info.hash < value); });
+
+	// compare the names of every entry sharing the hash
+	while ((entry != uniformCache.end()) && (entry->hash == hash))
+	{
+		if (entry->name.compare(name) == 0)
+		{
+			return(&(*entry));
+		}
+		++entry;
+	}
+
+	return(NULL);
+}
+
+/***********************************************************
+ *  RegisterUniformHandle()
+ *
+ *  This method is used for adding a uniform to the handle
+ *  table, or reusing the entry if the name was already
+ *  registered, and returns the table index for the handle.
+ ***********************************************************/
+int ShaderManager::RegisterUniformHandle(const char* name, GLenum expectedType, unsigned int valueSize)
+{
+	for (size_t i = 0; i < m_uniformHandles.size(); i++)
+	{
+		if (m_uniformHandles[i].name.compare(name) == 0)
+		{
+			return((int)i);
+		}
+	}
+
+	UNIFORM_HANDLE_INFO handleInfo;
+	handleInfo.name = name;
+	handleInfo.expectedType = expectedType;
+	handleInfo.valueSize = valueSize;
+	handleInfo.bHasValue = false;
+	handleInfo.uploads = 0;
+	m_uniformHandles.push_back(handleInfo);
+
+	for (int i = 0; i < PERMUTATION_COUNT; i++)
+	{
+		ResolveUniformHandles(m_programs[i]);
+		ResolveUniformHandles(m_reloadPrograms[i]);
+		ResolveUniformHandles(m_vertexStages[i]);
+		ResolveUniformHandles(m_reloadVertexStages[i]);
+	}
+
+	return((int)m_uniformHandles.size() - 1);
+}
+
+/***********************************************************
+ *  ResolveUniformHandles()
+ *
+ *  This method is used for refreshing the location and type
+ *  of every registered uniform handle from the uniform cache
+ *  of the passed in program, warning about type mismatches.
+ ***********************************************************/
+void ShaderManager::ResolveUniformHandles(PROGRAM_INFO& program)
+{
+	program.uniformStates.resize(m_uniformHandles.size());
+
+	for (size_t i = 0; i < m_uniformHandles.size(); i++)
+	{
+		const UNIFORM_HANDLE_INFO& handleInfo = m_uniformHandles[i];
+		UNIFORM_STATE& state = program.uniformStates[i];
+		const UNIFORM_INFO* uniform = FindUniform(program, handleInfo.name.c_str());
+		GLenum previousType = state.type;
+
+		state.location = (NULL != uniform) ? uniform->location : -1;
+		state.program = (program.bSeparable == true) ? program.programID : 0;
+		state.type = (NULL != uniform) ? uniform->type : GL_NONE;
+		// a newly linked program starts from its default values
+		state.bHasValue = false;
+
+		// samplers are set through integer handles
+		bool bSamplerAsInt = (handleInfo.expectedType == GL_INT) &&
+			((state.type == GL_SAMPLER_2D) || (state.type == GL_SAMPLER_2D_ARRAY));
+		if ((NULL != uniform) && (state.type != handleInfo.expectedType) &&
+			(bSamplerAsInt == false) && (state.type != previousType))
+		{
+			LOG_WARNING("uniform %s has GL type 0x%04X, handle expects 0x%04X",
+				handleInfo.name.c_str(), state.type, handleInfo.expectedType);
+		}
+	}
+}
+
+/***********************************************************
+ *  InvalidateUniformShadow()
+ *
+ *  This method is used for discarding the shadow copies of
+ *  the uploaded uniform values so the next set of each
+ *  handle always reaches the program.
+ ***********************************************************/
+void ShaderManager::InvalidateUniformShadow()
+{
+	for (int permutation = 0; permutation < PERMUTATION_COUNT; permutation++)
+	{
+		std::vector<UNIFORM_STATE>* stateSets[2] = {
+			&m_programs[permutation].uniformStates, &m_vertexStages[permutation].uniformStates };
+		for (int set = 0; set < 2; set++)
+		{
+			std::vector<UNIFORM_STATE>& states = *stateSets[set];
+			for (size_t i = 0; i < states.size(); i++)
+			{
+				states[i].bHasValue = false;
+			}
+		}
+	}
+}
+
+/***********************************************************
+ *  BindTexture()
+ *
+ *  This method is used for binding a texture to the passed
+ *  in texture unit, skipping the GL calls when the texture
+ *  is already bound to that unit. Texture names are unique
+ *  across targets, so the shadow state only keeps the name.
+ ***********************************************************/
+void ShaderManager::BindTexture(int unit, GLuint textureID, GLenum target)
+{
+	if ((unit < 0) || (unit >= MAX_TEXTURE_UNITS))
+	{
+		return;
+	}
+	if (m_boundTextures[unit] == textureID)
+	{
+		m_stateStats.textureSkips++;
+		return;
+	}
+
+	SetActiveTextureUnit(unit);
+	glBindTexture(target, textureID);
+	m_boundTextures[unit] = textureID;
+	m_stateStats.textureBinds++;
+}
+
+/***********************************************************
+ *  ForgetTexture()
+ *
+ *  This method is used for clearing the shadow state of the
+ *  units a deleted texture was bound to. Deleting a texture
+ *  binds 0 in its place, so the shadow state matches GL
+ *  again without a call.
+ ***********************************************************/
+void ShaderManager::ForgetTexture(GLuint textureID)
+{
+	for (int unit = 0; unit < MAX_TEXTURE_UNITS; unit++)
+	{
+		if (m_boundTextures[unit] == textureID)
+		{
+			m_boundTextures[unit] = 0;
+		}
+	}
+}
+
+/***********************************************************
+ *  SetActiveTextureUnit()
+ *
+ *  This method is used for selecting the texture unit that
+ *  texture calls like glTexParameteri() apply to, skipping
+ *  the call when the unit is already active.
+ ***********************************************************/
+void ShaderManager::SetActiveTextureUnit(int unit)
+{
+	if ((unit < 0) || (unit >= MAX_TEXTURE_UNITS) || (m_activeTextureUnit == unit))
+	{
+		return;
+	}
+
+	glActiveTexture(GL_TEXTURE0 + unit);
+	m_activeTextureUnit = unit;
+}
+
+/***********************************************************
+ *  ResetStateFilterStats()
+ *
+ *  This method is used for clearing the redundant state
+ *  filter counters.
+ ***********************************************************/
+void ShaderManager::ResetStateFilterStats()
+{
+	memset(&m_stateStats, 0, sizeof(m_stateStats));
+	for (size_t i = 0; i < m_uniformHandles.size(); i++)
+	{
+		m_uniformHandles[i].uploads = 0;
+	}
+}
+
+/***********************************************************
+ *  GetUniformUploadCounts()
+ *
+ *  This method is used for listing the uploads each uniform
+ *  handle sent to GL, most uploaded first.
+ ***********************************************************/
+void ShaderManager::GetUniformUploadCounts(std::vector<std::pair<std::string, unsigned long long> >& counts) const
+{
+	counts.clear();
+	for (size_t i = 0; i < m_uniformHandles.size(); i++)
+	{
+		counts.push_back(std::make_pair(m_uniformHandles[i].name, m_uniformHandles[i].uploads));
+	}
+	std::stable_sort(counts.begin(), counts.end(),
+		[](const std::pair<std::string, unsigned long long>& a, const std::pair<std::string, unsigned long long>& b) {
+			return(a.second > b.second);
+		});
+}
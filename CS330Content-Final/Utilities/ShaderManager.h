@@ -7,97 +7,779 @@
 #include <glm/gtc/type_ptr.hpp>
 
 #include <string>
+#include <cstring>
+#include <vector>
+#include <map>
 #include <fstream>
 #include <sstream>
 #include <iostream>
 
+#include "FileWatcher.h"
+
+/***********************************************************
+ *  UniformHandle
+ *
+ *  Typed reference to a uniform resolved once by name with
+ *  ShaderManager::GetUniformHandle<T>(). The handle indexes
+ *  the manager's handle table, which holds the location and
+ *  GL type, so setting a value never touches a string.
+ ***********************************************************/
+template <typename T>
+struct UniformHandle
+{
+	int index = -1;
+
+	bool IsValid() const { return(index >= 0); }
+};
+
+// maps a C++ value type onto the GLSL uniform type it sets
+template <typename T> struct UniformTraits;
+template <> struct UniformTraits<bool> { static const GLenum glType = GL_BOOL; };
+template <> struct UniformTraits<int> { static const GLenum glType = GL_INT; };
+template <> struct UniformTraits<float> { static const GLenum glType = GL_FLOAT; };
+template <> struct UniformTraits<glm::vec2> { static const GLenum glType = GL_FLOAT_VEC2; };
+template <> struct UniformTraits<glm::vec3> { static const GLenum glType = GL_FLOAT_VEC3; };
+template <> struct UniformTraits<glm::vec4> { static const GLenum glType = GL_FLOAT_VEC4; };
+template <> struct UniformTraits<glm::mat3> { static const GLenum glType = GL_FLOAT_MAT3; };
+template <> struct UniformTraits<glm::mat4> { static const GLenum glType = GL_FLOAT_MAT4; };
+
 class ShaderManager
 {
 public:
+	// program of the active permutation; the fragment stage of its
+	// pipeline with separable programs
 	unsigned int m_programID;
-	
+
+	// counters for the redundant state filter
+	struct STATE_FILTER_STATS
+	{
+		unsigned long long uniformUploads;	// handle uploads sent to GL
+		unsigned long long uniformSkips;	// handle uploads skipped, value unchanged
+		unsigned long long textureBinds;	// texture binds sent to GL
+		unsigned long long textureSkips;	// texture binds skipped, already bound
+		unsigned long long programSwitches;	// permutation program switches
+		unsigned long long programSkips;	// permutation switches skipped, already active
+	};
+
+	// counters for the shader source cache
+	struct SOURCE_STATS
+	{
+		unsigned long long fileReads;		// shader files read from the pack or disk
+		unsigned long long fileHits;		// shader file reads served by the cache
+		unsigned long long expansions;		// sources expanded with their #includes
+		unsigned long long expansionHits;	// expansions reused, no file of them changed
+	};
+
+	// each permutation bit injects one #define into the shader source
+	// when LoadShaders() builds the program for that combination
+	enum SHADER_PERMUTATION
+	{
+		PERMUTATION_TEXTURE = 1 << 0,	// #define USE_TEXTURE
+		PERMUTATION_LIGHTING = 1 << 1,	// #define USE_LIGHTING
+		PERMUTATION_INSTANCING = 1 << 2,	// #define USE_INSTANCING
+		PERMUTATION_TRANSPARENCY = 1 << 3,	// #define USE_OIT
+		PERMUTATION_GBUFFER = 1 << 4,	// #define USE_GBUFFER
+		PERMUTATION_COUNT = 1 << 5
+	};
+
+	// permutation LoadShaders() waits for, used while the others compile
+	static const int FALLBACK_PERMUTATION = 0;
+
+	// permutation bits that change which inputs the program reads, so a
+	// program can only stand in for one that has the same bits set
+	static const int INTERFACE_PERMUTATION_MASK =
+		PERMUTATION_INSTANCING | PERMUTATION_TRANSPARENCY | PERMUTATION_GBUFFER;
+
+	// permutation bits the vertex shader reads; with separable programs
+	// one vertex stage serves every permutation with the same bits
+	static const int VERTEX_PERMUTATION_MASK = PERMUTATION_INSTANCING;
+
+	// program drawn with while the passed in permutation compiles
+	static int GetFallbackPermutation(int permutation)
+	{
+		return(FALLBACK_PERMUTATION | (permutation & INTERFACE_PERMUTATION_MASK));
+	}
+
+	// maximum texture units tracked by the shadow state
+	static const int MAX_TEXTURE_UNITS = 32;
+
+	// fixed binding points of the uniform blocks shared by every program
+	enum UNIFORM_BLOCK_BINDING
+	{
+		FRAME_DATA_BINDING = 0,		// FrameData: view, projection, viewPosition
+		LIGHT_DATA_BINDING = 1,		// LightData: lightCount, lightSources[]
+		MATERIAL_DATA_BINDING = 2,	// MaterialData: materials[]
+		SHADOW_DATA_BINDING = 3,	// ShadowData: shadow quality, shadows[]
+		TEXTURE_DATA_BINDING = 4,	// TextureData: bindless textureHandles[]
+		STEREO_DATA_BINDING = 5,	// StereoData: eyeView[], eyeProjection[]
+		CASCADE_DATA_BINDING = 6,	// CascadeData: cascade matrices, splits
+		PROBE_DATA_BINDING = 7		// ProbeData: reflection probe spheres
+	};
+
+	ShaderManager();
+	~ShaderManager();
+
 	GLuint LoadShaders(
-		const char* vertex_file_path, 
+		const char* vertex_file_path,
 		const char* fragment_file_path);
 
-	// activate the shader
+	// enable or disable the on-disk program binary cache used by
+	// LoadShaders(), which is enabled by default
+	void SetProgramBinaryCache(bool bEnable) { m_bUseProgramBinaryCache = bEnable; }
+	// build every permutation for the two views of GL_OVR_multiview,
+	// projected with the StereoData block; set before LoadShaders()
+	void SetMultiview(bool bEnable) { m_bMultiview = bEnable; }
+	bool IsMultiview() const { return(m_bMultiview); }
+	// build the permutations as separable vertex and fragment stage
+	// programs joined by program pipelines, so a vertex stage is
+	// compiled once for all the fragment stages it serves; set before
+	// LoadShaders(), which drops it without separate shader objects
+	void SetSeparablePrograms(bool bEnable) { m_bSeparablePrograms = bEnable; }
+	bool IsSeparablePrograms() const { return(m_bSeparablePrograms); }
+	// build every permutation with USE_HALF_PRECISION defined, which
+	// does the color and lighting math of the fragment shader in half
+	// floats where the driver has them; set before LoadShaders(). The
+	// SPIR-V modules are built without it
+	void SetHalfPrecision(bool bEnable) { m_bHalfPrecision = bEnable; }
+	bool IsHalfPrecision() const { return(m_bHalfPrecision); }
+
+	// specialization constants of the SPIR-V scene shaders, by the
+	// constant_id they are declared with
+	enum SPECIALIZATION_CONSTANT
+	{
+		SPEC_TEXTURE = 0,			// PERMUTATION_TEXTURE
+		SPEC_LIGHTING = 1,			// PERMUTATION_LIGHTING
+		SPEC_CLUSTER_LIGHTS = 2		// lights listed per light cluster
+	};
+	// build the permutations from the SPIR-V modules written by
+	// CompileSpirvModules(), one per combination of the interface bits,
+	// specialized for the other bits, instead of the GLSL sources; set
+	// before LoadShaders(), which keeps the GLSL without
+	// GL_ARB_gl_spirv or when a module is missing
+	void SetSpirvShaders(bool bEnable) { m_bSpirvShaders = bEnable; }
+	bool IsSpirvShaders() const { return(m_bSpirvShaders); }
+	// value of a specialization constant that is not a permutation bit,
+	// given to every SPIR-V fragment stage; set before LoadShaders()
+	void SetSpecializationConstant(GLuint constantID, GLuint value);
+	// compile the scene shaders offline into the SPIR-V modules of
+	// SetSpirvShaders() with glslangValidator, next to the sources;
+	// false when a module did not build
+	bool CompileSpirvModules(const char* vertex_file_path, const char* fragment_file_path);
+
+	// activate the shader, restoring the values set through handles
 	// ------------------------------------------------------------------------
 	inline void use()
 	{
-		glUseProgram(m_programID);
+		m_bExternalProgram = false;
+		BindProgram(m_programs[m_currentPermutation]);
+		ApplyUniformHandles();
+	}
+
+	// activate the program built for a combination of PERMUTATION_* flags
+	void UsePermutation(int permutation);
+
+	// build a compute program from a GLSL file, 0 on failure; the
+	// program is owned by the caller and not part of the permutations
+	GLuint LoadComputeShader(const char* compute_file_path);
+	// build a program from a vertex and fragment shader file without
+	// permutations, 0 on failure; the program is owned by the caller
+	GLuint LoadExternalProgram(
+		const char* vertex_file_path,
+		const char* fragment_file_path);
+	// build a program from a task, a mesh and a fragment shader file
+	// of GL_NV_mesh_shader, with the defines of a permutation in all
+	// three, 0 on failure or without the extension; the program is
+	// owned by the caller
+	GLuint LoadMeshShaderProgram(
+		const char* task_file_path,
+		const char* mesh_file_path,
+		const char* fragment_file_path,
+		int permutation);
+	// activate a program built outside of the permutation set, such as
+	// a compute program; handle values set meanwhile are kept for the
+	// next UsePermutation(), which switches back
+	void UseExternalProgram(GLuint programID);
+	// build a separable program of one stage, GL_VERTEX_SHADER or
+	// GL_FRAGMENT_SHADER, with the defines of a permutation, 0 on
+	// failure; the program is owned by the caller, whose uniforms are
+	// set with glProgramUniform*()
+	GLuint LoadStageProgram(GLenum shaderType, const char* file_path, int permutation);
+	// the pipeline joining a separable vertex and fragment stage
+	// program, created the first time the pair is asked for
+	GLuint GetProgramPipeline(GLuint vertexProgram, GLuint fragmentProgram);
+	// delete the pipelines using a stage program, before it is deleted
+	void ReleaseProgramPipelines(GLuint programID);
+	// activate a pipeline of GetProgramPipeline() like a program of
+	// UseExternalProgram()
+	void UseProgramPipeline(GLuint pipelineID);
+	// finish the programs the driver has compiled since the last call,
+	// without waiting, and swap in reloaded shaders; returns how many
+	// programs are still compiling
+	int PollPendingPrograms();
+
+	// watch the loaded shader files through the watcher, shared with
+	// the other hot reloads, and rebuild them through
+	// PollPendingPrograms() when they change; NULL stops watching
+	void StartFileWatcher(FileWatcher* pWatcher);
+	void StopFileWatcher() { m_pFileWatcher = NULL; }
+	// shader source cache counters
+	const SOURCE_STATS& GetSourceStats() const { return(m_sourceStats); }
+	int GetCurrentPermutation() const { return(m_currentPermutation); }
+
+	// uniform location lookup
+	// ------------------------------------------------------------------------
+	// returns the cached location of the named active uniform, or -1 when the
+	// linked program has no active uniform with that name (same as GL does)
+	GLint GetUniformLocation(const char* name) const;
+	inline GLint GetUniformLocation(const std::string &name) const
+	{
+		return(GetUniformLocation(name.c_str()));
+	}
+
+	// typed uniform handles
+	// ------------------------------------------------------------------------
+	// resolve a uniform once by name; the handle stays valid across
+	// program reloads and permutations because each program keeps its
+	// own location for every handle
+	template <typename T>
+	UniformHandle<T> GetUniformHandle(const char* name)
+	{
+		UniformHandle<T> handle;
+		handle.index = RegisterUniformHandle(name, UniformTraits<T>::glType, sizeof(T));
+		return(handle);
+	}
+
+	// set the value of a resolved uniform with a single typed call; the
+	// upload is skipped when the value matches the last one sent to the
+	// active program, and the value is kept for the other permutations
+	template <typename T>
+	inline void setUniform(const UniformHandle<T>& handle, const T& value) const
+	{
+		static_assert(sizeof(T) <= sizeof(UNIFORM_HANDLE_INFO::value), "uniform value too large for shadow state");
+
+		if (handle.IsValid() == false)
+		{
+			return;
+		}
+
+		UNIFORM_HANDLE_INFO& handleInfo = m_uniformHandles[handle.index];
+		memcpy(handleInfo.value, &value, sizeof(T));
+		handleInfo.bHasValue = true;
+		if (m_bExternalProgram == true)
+		{
+			return;
+		}
+
+		SetUniformState(m_programs[m_currentPermutation].uniformStates[handle.index], handleInfo, value);
+		if (m_bSeparablePrograms == true)
+		{
+			// the vertex stage is shared, and so is the shadow of its values
+			SetUniformState(GetVertexStage(m_vertexStages, m_currentPermutation).uniformStates[handle.index],
+				handleInfo, value);
+		}
+	}
+
+	// forget the shadowed uniform values, e.g. after a value was set through
+	// the name or location setters below, which bypass the filter
+	void InvalidateUniformShadow();
+
+	// bind a texture to a texture unit unless it is already bound there
+	void BindTexture(int unit, GLuint textureID, GLenum target = GL_TEXTURE_2D);
+	// make a texture unit the target of texture calls unless it already is
+	void SetActiveTextureUnit(int unit);
+	// forget a deleted texture on the units it was bound to, which
+	// GL unbinds, so a new texture reusing its name is bound again
+	void ForgetTexture(GLuint textureID);
+
+	// redundant state filter counters
+	const STATE_FILTER_STATS& GetStateFilterStats() const { return(m_stateStats); }
+	void ResetStateFilterStats();
+	// uploads sent to GL through each uniform handle, by name, since
+	// the last reset; the name and location setters are not counted
+	void GetUniformUploadCounts(std::vector<std::pair<std::string, unsigned long long> >& counts) const;
+
+	// returns the GL type reported by the active program for the handle's uniform
+	template <typename T>
+	inline GLenum GetUniformType(const UniformHandle<T>& handle) const
+	{
+		if (handle.IsValid() == false)
+		{
+			return(GL_NONE);
+		}
+		GLenum type = m_programs[m_currentPermutation].uniformStates[handle.index].type;
+		if ((type == GL_NONE) && (m_bSeparablePrograms == true))
+		{
+			type = GetVertexStage(m_vertexStages, m_currentPermutation).uniformStates[handle.index].type;
+		}
+		return(type);
 	}
 
 	// utility uniform functions
 	// ------------------------------------------------------------------------
+	inline void setBoolValue(GLint location, bool value) const
+	{
+		glUniform1i(location, (int)value);
+	}
+	inline void setBoolValue(const char* name, bool value) const
+	{
+		setBoolValue(GetUniformLocation(name), value);
+	}
 	inline void setBoolValue(const std::string &name, bool value) const
 	{
-		glUniform1i(glGetUniformLocation(m_programID, name.c_str()), (int)value);
+		setBoolValue(GetUniformLocation(name), value);
 	}
 
 	// ------------------------------------------------------------------------
+	inline void setIntValue(GLint location, int value) const
+	{
+		glUniform1i(location, value);
+	}
+	inline void setIntValue(const char* name, int value) const
+	{
+		setIntValue(GetUniformLocation(name), value);
+	}
 	inline void setIntValue(const std::string &name, int value) const
 	{
-		glUniform1i(glGetUniformLocation(m_programID, name.c_str()), value);
+		setIntValue(GetUniformLocation(name), value);
 	}
 
 	// ------------------------------------------------------------------------
+	inline void setFloatValue(GLint location, float value) const
+	{
+		glUniform1f(location, value);
+	}
+	inline void setFloatValue(const char* name, float value) const
+	{
+		setFloatValue(GetUniformLocation(name), value);
+	}
 	inline void setFloatValue(const std::string &name, float value) const
 	{
-		glUniform1f(glGetUniformLocation(m_programID, name.c_str()), value);
+		setFloatValue(GetUniformLocation(name), value);
 	}
 
 	// ------------------------------------------------------------------------
+	inline void setVec2Value(GLint location, const glm::vec2 &value) const
+	{
+		glUniform2fv(location, 1, &value[0]);
+	}
+	inline void setVec2Value(const char* name, const glm::vec2 &value) const
+	{
+		setVec2Value(GetUniformLocation(name), value);
+	}
 	inline void setVec2Value(const std::string &name, const glm::vec2 &value) const
 	{
-		glUniform2fv(glGetUniformLocation(m_programID, name.c_str()), 1, &value[0]);
+		setVec2Value(GetUniformLocation(name), value);
 	}
 
+	inline void setVec2Value(const char* name, float x, float y) const
+	{
+		glUniform2f(GetUniformLocation(name), x, y);
+	}
 	inline void setVec2Value(const std::string &name, float x, float y) const
 	{
-		glUniform2f(glGetUniformLocation(m_programID, name.c_str()), x, y);
+		glUniform2f(GetUniformLocation(name), x, y);
 	}
 
 	// ------------------------------------------------------------------------
+	inline void setVec3Value(GLint location, const glm::vec3 &value) const
+	{
+		glUniform3fv(location, 1, &value[0]);
+	}
+	inline void setVec3Value(const char* name, const glm::vec3 &value) const
+	{
+		setVec3Value(GetUniformLocation(name), value);
+	}
 	inline void setVec3Value(const std::string &name, const glm::vec3 &value) const
 	{
-		glUniform3fv(glGetUniformLocation(m_programID, name.c_str()), 1, &value[0]);
+		setVec3Value(GetUniformLocation(name), value);
+	}
+	inline void setVec3Value(const char* name, float x, float y, float z) const
+	{
+		glUniform3f(GetUniformLocation(name), x, y, z);
 	}
 	inline void setVec3Value(const std::string &name, float x, float y, float z) const
 	{
-		glUniform3f(glGetUniformLocation(m_programID, name.c_str()), x, y, z);
+		glUniform3f(GetUniformLocation(name), x, y, z);
 	}
 
 	// ------------------------------------------------------------------------
+	inline void setVec4Value(GLint location, const glm::vec4 &value) const
+	{
+		glUniform4fv(location, 1, &value[0]);
+	}
+	inline void setVec4Value(const char* name, const glm::vec4 &value) const
+	{
+		setVec4Value(GetUniformLocation(name), value);
+	}
 	inline void setVec4Value(const std::string &name, const glm::vec4 &value) const
 	{
-		glUniform4fv(glGetUniformLocation(m_programID, name.c_str()), 1, &value[0]);
+		setVec4Value(GetUniformLocation(name), value);
 	}
-	inline void setVec4Value(const std::string &name, float x, float y, float z, float w)
+	inline void setVec4Value(const char* name, float x, float y, float z, float w) const
 	{
-		glUniform4f(glGetUniformLocation(m_programID, name.c_str()), x, y, z, w);
+		glUniform4f(GetUniformLocation(name), x, y, z, w);
+	}
+	inline void setVec4Value(const std::string &name, float x, float y, float z, float w) const
+	{
+		glUniform4f(GetUniformLocation(name), x, y, z, w);
 	}
 
 	// ------------------------------------------------------------------------
+	inline void setMat2Value(GLint location, const glm::mat2 &mat) const
+	{
+		glUniformMatrix2fv(location, 1, GL_FALSE, &mat[0][0]);
+	}
+	inline void setMat2Value(const char* name, const glm::mat2 &mat) const
+	{
+		setMat2Value(GetUniformLocation(name), mat);
+	}
 	inline void setMat2Value(const std::string &name, const glm::mat2 &mat) const
 	{
-		glUniformMatrix2fv(glGetUniformLocation(m_programID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+		setMat2Value(GetUniformLocation(name), mat);
 	}
 
 	// ------------------------------------------------------------------------
+	inline void setMat3Value(GLint location, const glm::mat3 &mat) const
+	{
+		glUniformMatrix3fv(location, 1, GL_FALSE, &mat[0][0]);
+	}
+	inline void setMat3Value(const char* name, const glm::mat3 &mat) const
+	{
+		setMat3Value(GetUniformLocation(name), mat);
+	}
 	inline void setMat3Value(const std::string &name, const glm::mat3 &mat) const
 	{
-		glUniformMatrix3fv(glGetUniformLocation(m_programID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+		setMat3Value(GetUniformLocation(name), mat);
 	}
 
 	// ------------------------------------------------------------------------
+	inline void setMat4Value(GLint location, const glm::mat4 &mat) const
+	{
+		glUniformMatrix4fv(location, 1, GL_FALSE, glm::value_ptr(mat));
+	}
+	inline void setMat4Value(const char* name, const glm::mat4 &mat) const
+	{
+		setMat4Value(GetUniformLocation(name), mat);
+	}
 	inline void setMat4Value(const std::string &name, const glm::mat4 &mat) const
 	{
-		glUniformMatrix4fv(glGetUniformLocation(m_programID, name.c_str()), 1, GL_FALSE, glm::value_ptr(mat));
+		setMat4Value(GetUniformLocation(name), mat);
 	}
 
 	// ------------------------------------------------------------------------
+	inline void setSampler2DValue(GLint location, const int &value) const
+	{
+		glUniform1i(location, value);
+	}
+	inline void setSampler2DValue(const char* name, const int &value) const
+	{
+		setSampler2DValue(GetUniformLocation(name), value);
+	}
 	inline void setSampler2DValue(const std::string& name, const int &value) const
 	{
-		glUniform1i(glGetUniformLocation(m_programID, name.c_str()), value);
+		setSampler2DValue(GetUniformLocation(name), value);
+	}
+
+private:
+	// cached location of one active uniform in the linked program
+	struct UNIFORM_INFO
+	{
+		unsigned int hash;		// FNV-1a hash of the uniform name
+		GLint location;			// location returned by glGetUniformLocation()
+		GLenum type;			// GLSL type reported by glGetActiveUniform()
+		std::string name;		// full uniform name, e.g. "lightSources[0].position"
+	};
+
+	// uniform referenced by a UniformHandle<T>, shared by all programs
+	struct UNIFORM_HANDLE_INFO
+	{
+		std::string name;		// name the handle was resolved with
+		GLenum expectedType;	// type implied by the handle's template argument
+		unsigned int valueSize;	// sizeof the handle's value type
+		bool bHasValue;			// value holds the last value set through the handle
+		unsigned char value[sizeof(glm::mat4)];	// last value set, for every permutation
+		unsigned long long uploads;	// uploads sent to GL through the handle
+	};
+
+	// per-program state of one handle
+	struct UNIFORM_STATE
+	{
+		GLint location = -1;	// location in the program, -1 if inactive
+		GLuint program = 0;		// separable program uploaded to with glProgramUniform*(), 0 for the active one
+		GLenum type = GL_NONE;	// type reported by the program
+		bool bHasValue = false;	// lastValue holds the value currently in the program
+		unsigned char lastValue[sizeof(glm::mat4)];	// shadow copy of the last upload
+	};
+
+	// one linked program of the permutation set, or one separable
+	// stage program of it
+	struct PROGRAM_INFO
+	{
+		GLuint programID;
+		GLuint vertexShaderID;		// shaders of a submitted build, 0 once finished
+		GLuint fragmentShaderID;
+		bool bSeparable;			// a single stage, drawn through pipelineID
+		bool bSpirv;				// specialized from SPIR-V modules, whose uniforms have no names
+		GLuint pipelineID;			// pipeline of a separable fragment stage, 0 until both stages linked
+		mutable GLuint activeStage;	// program of the pipeline that glUniform*() reaches
+		bool bReady;				// linked and its uniforms cached
+		std::string cachePath;		// binary cache file of the program
+		unsigned long long cacheKey;	// hash of the sources, defines and driver
+		// active uniforms sorted by name hash, filled once after linking
+		std::vector<UNIFORM_INFO> uniformCache;
+		// indexed by UniformHandle<T>::index
+		std::vector<UNIFORM_STATE> uniformStates;
+	};
+
+	// shader file as read, shared by every program including it
+	struct SOURCE_FILE
+	{
+		std::string text;
+		unsigned long long hash;	// FNV-1a hash of the text
+	};
+
+	// shader source with its #includes expanded
+	struct EXPANDED_SOURCE
+	{
+		std::string text;
+		unsigned long long hash;	// hash of the files' hashes, in order
+		std::vector<std::string> files;	// the file and every file it included
+	};
+
+	// pipeline of a pair of separable stage programs
+	struct PIPELINE_INFO
+	{
+		GLuint vertexProgram;
+		GLuint fragmentProgram;
+		GLuint pipelineID;
+	};
+
+	// programs indexed by permutation flags, mutable for the shadow
+	// values; the fragment stages with separable programs
+	mutable PROGRAM_INFO m_programs[PERMUTATION_COUNT];
+	// separable vertex stages, indexed by the VERTEX_PERMUTATION_MASK
+	// bits of the permutations they serve
+	mutable PROGRAM_INFO m_vertexStages[PERMUTATION_COUNT];
+	// pipelines by the stage programs they join
+	std::vector<PIPELINE_INFO> m_pipelines;
+	// true to build the permutations as separable stage programs
+	bool m_bSeparablePrograms;
+	// true to build the permutations from SPIR-V modules
+	bool m_bSpirvShaders;
+	// constant ID and value pairs of SetSpecializationConstant()
+	std::vector<std::pair<GLuint, GLuint> > m_specializationConstants;
+	// permutation of the active program
+	int m_currentPermutation;
+	// true while a program from UseExternalProgram() is active
+	bool m_bExternalProgram;
+	// table indexed by UniformHandle<T>::index, mutable for the set values
+	mutable std::vector<UNIFORM_HANDLE_INFO> m_uniformHandles;
+	// texture bound to each unit, 0 when unknown
+	GLuint m_boundTextures[MAX_TEXTURE_UNITS];
+	// currently active texture unit, -1 when unknown
+	int m_activeTextureUnit;
+	// redundant state filter counters
+	mutable STATE_FILTER_STATS m_stateStats;
+	// true to load and store linked programs in the binary cache
+	bool m_bUseProgramBinaryCache;
+	// true to build the permutations with USE_MULTIVIEW defined
+	bool m_bMultiview;
+	// true to build the permutations with USE_HALF_PRECISION defined
+	bool m_bHalfPrecision;
+	// true when the driver compiles programs on its own threads
+	bool m_bParallelCompile;
+	// shader files of the last LoadShaders() call
+	std::string m_vertexShaderPath;
+	std::string m_fragmentShaderPath;
+	// programs being rebuilt after the shader files changed
+	PROGRAM_INFO m_reloadPrograms[PERMUTATION_COUNT];
+	PROGRAM_INFO m_reloadVertexStages[PERMUTATION_COUNT];
+	// true while m_reloadPrograms are compiling
+	bool m_bReloadPending;
+	// watcher of the shader files and their watches, taken between
+	// frames; NULL when they are not watched
+	FileWatcher* m_pFileWatcher;
+	std::vector<int> m_sourceWatches;
+	std::vector<std::string> m_watchedFiles;
+	// the shader files of the last LoadShaders() call and the files
+	// they include
+	std::vector<std::string> m_sceneSourceFiles;
+	// shader files by path, read once until the watcher sees them change
+	std::map<std::string, SOURCE_FILE> m_sourceFiles;
+	// expanded sources by the path of the file expanded
+	std::map<std::string, EXPANDED_SOURCE> m_expandedSources;
+	SOURCE_STATS m_sourceStats;
+
+	// start compiling and linking the shader sources into a program;
+	// an empty source leaves its stage out
+	void SubmitProgram(
+		PROGRAM_INFO& program,
+		const std::string& VertexShaderCode,
+		const std::string& FragmentShaderCode,
+		bool bSeparable = false);
+	// replace a program of a set with its cached binary, or submit it
+	void SubmitSetProgram(
+		PROGRAM_INFO& program,
+		int permutation,
+		const std::string& cachePath,
+		unsigned long long cacheKey,
+		const std::string& VertexShaderCode,
+		const std::string& FragmentShaderCode,
+		bool bSeparable);
+	// read the vertex and fragment shader files, adding the files
+	// they include to the passed in list
+	bool ReadShaderSources(
+		const char* vertex_file_path,
+		const char* fragment_file_path,
+		std::string& VertexShaderCode,
+		std::string& FragmentShaderCode,
+		std::vector<std::string>* pFiles = NULL);
+	// read a shader file with its #includes expanded, reusing the last
+	// expansion while none of its files changed; the files are added
+	// to the passed in list
+	bool ReadShaderSource(const std::string& path, std::string& code, std::vector<std::string>* pFiles = NULL);
+	// expand the #includes of a shader file into a new expansion
+	bool ExpandShaderFile(const std::string& path, EXPANDED_SOURCE& expansion);
+	// a shader file through the cache, NULL when it cannot be read
+	const SOURCE_FILE* GetSourceFile(const std::string& path);
+	// watch the files of the scene shaders not watched yet
+	void WatchSourceFiles();
+	// replace every program of a permutation set from the sources
+	void SubmitPermutations(
+		PROGRAM_INFO* programs,
+		PROGRAM_INFO* vertexStages,
+		const std::string& VertexShaderCode,
+		const std::string& FragmentShaderCode);
+	// collect the results of a submitted program, waiting if needed
+	void FinishProgram(PROGRAM_INFO& program, int permutation, const char* label = "scene");
+	// finish the program of a permutation and, with separable
+	// programs, its vertex stage, and join them
+	void FinishPermutation(PROGRAM_INFO* programs, PROGRAM_INFO* vertexStages, int permutation);
+	// finish the completed programs of a set, returns how many are pending
+	int FinishCompletedPrograms(PROGRAM_INFO* programs, PROGRAM_INFO* vertexStages);
+	// replace every program of a set with its cached binary or one
+	// specialized from the SPIR-V modules; false when a module is
+	// missing, leaving the set to the GLSL sources
+	bool SubmitSpirvPermutations(PROGRAM_INFO* programs, PROGRAM_INFO* vertexStages, unsigned long long driverKey);
+	// start specializing and linking the SPIR-V modules into the
+	// program of a permutation
+	void SubmitSpirvProgram(
+		PROGRAM_INFO& program,
+		int permutation,
+		const std::string& VertexModule,
+		const std::string& FragmentModule);
+	// the specialization constants of a permutation's fragment stage
+	void GetSpecialization(int permutation, std::vector<GLuint>& indices, std::vector<GLuint>& values) const;
+	// path of the SPIR-V module of a shader file for the interface
+	// bits of a permutation
+	static std::string GetSpirvModulePath(const std::string& shaderPath, int permutation, bool bBindless);
+	// join a separable fragment stage and its vertex stage once both
+	// linked
+	void JoinStages(PROGRAM_INFO& program, const PROGRAM_INFO& vertexStage, int permutation);
+	// true once a permutation's program can be drawn with
+	bool IsProgramReady(const PROGRAM_INFO& program) const
+	{
+		return((program.bReady == true) && ((program.bSeparable == false) || (0 != program.pipelineID)));
+	}
+	// the vertex stage of a set serving a permutation
+	static PROGRAM_INFO& GetVertexStage(PROGRAM_INFO* vertexStages, int permutation)
+	{
+		return(vertexStages[permutation & VERTEX_PERMUTATION_MASK]);
+	}
+	// make a permutation's program or pipeline the one drawn with
+	void BindProgram(const PROGRAM_INFO& program);
+	// rebuild the shader files into m_reloadPrograms
+	void BeginReload();
+	// swap the reloaded programs in once all of them linked
+	void CompleteReload();
+	// delete a program and the shaders of a pending build
+	void ReleaseProgram(PROGRAM_INFO& program);
+	// #define lines and readable name of a permutation
+	static std::string GetPermutationDefines(int permutation);
+	static std::string GetPermutationName(int permutation);
+	// insert define lines after the #version line of the source
+	static std::string InjectDefines(const std::string& code, const std::string& defines);
+	// try to create the program from a cached binary, 0 on failure
+	GLuint LoadProgramBinary(const std::string& cachePath, unsigned long long cacheKey, bool bSeparable = false);
+	// write the binary of a linked program to the cache file
+	void SaveProgramBinary(GLuint programID, const std::string& cachePath, unsigned long long cacheKey);
+	// finish setting up the newly linked program of a permutation
+	void OnProgramLinked(PROGRAM_INFO& program);
+	// name the program of a permutation in the GL debug mode
+	void LabelProgram(GLuint programID, int permutation, const char* label);
+
+	// attach the known uniform blocks of a linked program to their bindings
+	void BindUniformBlocks(GLuint programID);
+	// query every active uniform of a linked program and cache its location
+	void CacheUniformLocations(PROGRAM_INFO& program);
+	// the same for a SPIR-V program, naming its uniforms by location
+	void CacheSpirvUniformLocations(PROGRAM_INFO& program);
+	// find the cache entry for the named uniform in a program
+	const UNIFORM_INFO* FindUniform(const PROGRAM_INFO& program, const char* name) const;
+	// add (or reuse) a handle table entry and resolve it against the programs
+	int RegisterUniformHandle(const char* name, GLenum expectedType, unsigned int valueSize);
+	// refresh a program's handle states after it was (re)linked
+	void ResolveUniformHandles(PROGRAM_INFO& program);
+	// upload the handle values the active program does not have yet
+	void ApplyUniformHandles();
+	// the same for one program, or one stage of the active pipeline
+	void ApplyProgramHandles(PROGRAM_INFO& program);
+	// upload a shadowed handle value of the given GL type
+	void UploadUniformValue(GLuint program, GLint location, GLenum type, const unsigned char* value) const;
+
+	// upload a handle value to one program unless it has it already
+	template <typename T>
+	inline void SetUniformState(UNIFORM_STATE& state, UNIFORM_HANDLE_INFO& handleInfo, const T& value) const
+	{
+		if (state.location < 0)
+		{
+			return;
+		}
+		if ((state.bHasValue == true) && (memcmp(state.lastValue, &value, sizeof(T)) == 0))
+		{
+			m_stateStats.uniformSkips++;
+			return;
+		}
+
+		memcpy(state.lastValue, &value, sizeof(T));
+		state.bHasValue = true;
+		m_stateStats.uniformUploads++;
+		handleInfo.uploads++;
+		UploadUniform(state.program, state.location, value);
+	}
+
+	// typed uploads used by setUniform(), to the active program or to
+	// a separable stage program
+	inline void UploadUniform(GLuint program, GLint location, bool value) const
+	{
+		if (0 != program) { glProgramUniform1i(program, location, (int)value); } else { glUniform1i(location, (int)value); }
+	}
+	inline void UploadUniform(GLuint program, GLint location, int value) const
+	{
+		if (0 != program) { glProgramUniform1i(program, location, value); } else { glUniform1i(location, value); }
+	}
+	inline void UploadUniform(GLuint program, GLint location, float value) const
+	{
+		if (0 != program) { glProgramUniform1f(program, location, value); } else { glUniform1f(location, value); }
+	}
+	inline void UploadUniform(GLuint program, GLint location, const glm::vec2& value) const
+	{
+		if (0 != program) { glProgramUniform2fv(program, location, 1, &value[0]); } else { glUniform2fv(location, 1, &value[0]); }
+	}
+	inline void UploadUniform(GLuint program, GLint location, const glm::vec3& value) const
+	{
+		if (0 != program) { glProgramUniform3fv(program, location, 1, &value[0]); } else { glUniform3fv(location, 1, &value[0]); }
+	}
+	inline void UploadUniform(GLuint program, GLint location, const glm::vec4& value) const
+	{
+		if (0 != program) { glProgramUniform4fv(program, location, 1, &value[0]); } else { glUniform4fv(location, 1, &value[0]); }
+	}
+	inline void UploadUniform(GLuint program, GLint location, const glm::mat3& value) const
+	{
+		if (0 != program) { glProgramUniformMatrix3fv(program, location, 1, GL_FALSE, &value[0][0]); } else { glUniformMatrix3fv(location, 1, GL_FALSE, &value[0][0]); }
+	}
+	inline void UploadUniform(GLuint program, GLint location, const glm::mat4& value) const
+	{
+		if (0 != program) { glProgramUniformMatrix4fv(program, location, 1, GL_FALSE, glm::value_ptr(value)); } else { glUniformMatrix4fv(location, 1, GL_FALSE, glm::value_ptr(value)); }
 	}
-};
\ No newline at end of file
+};
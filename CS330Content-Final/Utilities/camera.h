@@ -76,10 +76,20 @@ public:
         updateCameraVectors();
     }
 
-    // returns the view matrix calculated using Euler Angles and the LookAt Matrix
+    // returns the view matrix calculated using Euler Angles and the LookAt Matrix,
+    // kept from the last call while the position and orientation stay the same;
+    // the attributes are public, so they are compared rather than flagged dirty
     glm::mat4 GetViewMatrix() const
     {
-        return glm::lookAt(Position, Position + Front, Up);
+        if ((viewCached == false) || (Position != cachedPosition) || (Front != cachedFront) || (Up != cachedUp))
+        {
+            cachedView = glm::lookAt(Position, Position + Front, Up);
+            cachedPosition = Position;
+            cachedFront = Front;
+            cachedUp = Up;
+            viewCached = true;
+        }
+        return cachedView;
     }
 
     // processes input received from any keyboard-like input system. Accepts input parameter in the form of camera defined ENUM (to abstract it from windowing systems)
@@ -133,14 +143,24 @@ public:
     }
 
 private:
+    // view matrix of the last GetViewMatrix() and the attributes it was built from
+    mutable glm::mat4 cachedView;
+    mutable glm::vec3 cachedPosition;
+    mutable glm::vec3 cachedFront;
+    mutable glm::vec3 cachedUp;
+    mutable bool viewCached = false;
+
     // calculates the front vector from the Camera's (updated) Euler Angles
     void updateCameraVectors()
     {
-        // calculate the new Front vector
+        // calculate the new Front vector, taking each sine and cosine once
+        float yaw = glm::radians(Yaw);
+        float pitch = glm::radians(Pitch);
+        float cosPitch = cos(pitch);
         glm::vec3 front;
-        front.x = cos(glm::radians(Yaw)) * cos(glm::radians(Pitch));
-        front.y = sin(glm::radians(Pitch));
-        front.z = sin(glm::radians(Yaw)) * cos(glm::radians(Pitch));
+        front.x = cos(yaw) * cosPitch;
+        front.y = sin(pitch);
+        front.z = sin(yaw) * cosPitch;
         Front = glm::normalize(front);
         // also re-calculate the Right and Up vector
         Right = glm::normalize(glm::cross(Front, WorldUp));  // normalize the vectors, because their length gets closer to 0 the more you look up or down which results in slower movement.
@@ -0,0 +1,184 @@
+#version 430 core
+// samples the clip of each draw SceneAnimation poses on the GPU and
+// writes its model and normal matrices into the instance data of the
+// frame, one invocation per draw
+layout (local_size_x = 64) in;
+
+// (first channel, channel count, playback, duration bits) per clip
+layout (std430, binding = 0) readonly buffer Clips
+{
+   uvec4 clips[];
+};
+
+// (first key, key count, property, interpolation) per channel
+layout (std430, binding = 1) readonly buffer Channels
+{
+   uvec4 channels[];
+};
+
+// (value, time) per key
+layout (std430, binding = 2) readonly buffer Keys
+{
+   vec4 keys[];
+};
+
+// SceneAnimation::GPU_RECORD
+struct AnimatedDraw
+{
+   mat4 parentWorld;
+   mat4 offset;
+   vec4 restScale;      // w is the start
+   vec4 restRotation;   // w is the speed
+   vec4 restPosition;
+   uvec4 target;        // clip, instance
+};
+
+layout (std430, binding = 3) readonly buffer AnimatedDraws
+{
+   AnimatedDraw records[];
+};
+
+// 9 RGBA32F texels per instance: model columns, color, (UV scale,
+// material index, texture index), normal matrix columns
+layout (std430, binding = 4) buffer InstanceData
+{
+   vec4 texels[];
+};
+
+uniform float time;
+uniform uint instanceBase;
+uniform uint recordCount;
+
+const uint PROPERTY_SCALE = 0u;
+const uint PROPERTY_ROTATION = 1u;
+const uint PLAYBACK_LOOP = 1u;
+const uint PLAYBACK_PINGPONG = 2u;
+const uint INTERPOLATION_STEP = 0u;
+const uint INTERPOLATION_SMOOTH = 2u;
+
+// SceneAnimation::GetClipTime()
+float GetClipTime(uvec4 clip, float start, float speed)
+{
+   float duration = uintBitsToFloat(clip.w);
+   float clipTime = (time - start) * speed;
+   if (clipTime <= 0.0)
+   {
+      return 0.0;
+   }
+   if (clip.z == PLAYBACK_LOOP)
+   {
+      return mod(clipTime, duration);
+   }
+   if (clip.z == PLAYBACK_PINGPONG)
+   {
+      clipTime = mod(clipTime, 2.0 * duration);
+      return (clipTime > duration) ? 2.0 * duration - clipTime : clipTime;
+   }
+   return min(clipTime, duration);
+}
+
+// one channel of SceneAnimation::SampleClip(); the keys of a channel
+// are few, so they are walked instead of searched
+vec3 SampleChannel(uvec4 channel, float clipTime)
+{
+   uint first = channel.x;
+   uint last = channel.x + channel.y - 1u;
+   if (clipTime <= keys[first].w)
+   {
+      return keys[first].xyz;
+   }
+   if (clipTime >= keys[last].w)
+   {
+      return keys[last].xyz;
+   }
+
+   uint key = first;
+   while ((key + 1u < last) && (keys[key + 1u].w <= clipTime))
+   {
+      key++;
+   }
+   vec4 from = keys[key];
+   vec4 to = keys[key + 1u];
+   float weight = (clipTime - from.w) / (to.w - from.w);
+   if (channel.w == INTERPOLATION_STEP)
+   {
+      weight = 0.0;
+   }
+   else if (channel.w == INTERPOLATION_SMOOTH)
+   {
+      weight = weight * weight * (3.0 - 2.0 * weight);
+   }
+   return mix(from.xyz, to.xyz, weight);
+}
+
+// ComposeModelMatrix(): scale, Z, Y, X rotation and translation
+mat4 ComposeModelMatrix(vec3 scale, vec3 rotationDegrees, vec3 position)
+{
+   vec3 r = radians(rotationDegrees);
+   vec3 s = sin(r);
+   vec3 c = cos(r);
+   return mat4(
+      vec4(c.y * c.z, c.x * s.z + s.x * s.y * c.z, s.x * s.z - c.x * s.y * c.z, 0.0) * scale.x,
+      vec4(-c.y * s.z, c.x * c.z - s.x * s.y * s.z, s.x * c.z + c.x * s.y * s.z, 0.0) * scale.y,
+      vec4(s.y, -s.x * c.y, c.x * c.y, 0.0) * scale.z,
+      vec4(position, 1.0));
+}
+
+void main()
+{
+   uint index = gl_GlobalInvocationID.x;
+   if (index >= recordCount)
+   {
+      return;
+   }
+
+   AnimatedDraw record = records[index];
+   uvec4 clip = clips[record.target.x];
+   float clipTime = GetClipTime(clip, record.restScale.w, record.restRotation.w);
+
+   vec3 scale = vec3(1.0);
+   vec3 rotation = vec3(0.0);
+   vec3 position = vec3(0.0);
+   for (uint c = clip.x; c < clip.x + clip.y; c++)
+   {
+      uvec4 channel = channels[c];
+      vec3 value = SampleChannel(channel, clipTime);
+      if (channel.z == PROPERTY_SCALE)
+      {
+         scale = value;
+      }
+      else if (channel.z == PROPERTY_ROTATION)
+      {
+         rotation = value;
+      }
+      else
+      {
+         position = value;
+      }
+   }
+
+   mat4 model = record.parentWorld *
+      ComposeModelMatrix(record.restScale.xyz * scale, record.restRotation.xyz + rotation,
+         record.restPosition.xyz + position) * record.offset;
+
+   // the inverse transpose from the cross products of the axes, as
+   // ComputeNormalMatrix() does
+   vec3 axisX = model[0].xyz;
+   vec3 axisY = model[1].xyz;
+   vec3 axisZ = model[2].xyz;
+   mat3 cofactors = mat3(cross(axisY, axisZ), cross(axisZ, axisX), cross(axisX, axisY));
+   float determinant = dot(axisX, cofactors[0]);
+   if (determinant != 0.0)
+   {
+      cofactors *= 1.0 / determinant;
+   }
+
+   uint texel = (instanceBase + record.target.y) * 9u;
+   texels[texel] = model[0];
+   texels[texel + 1u] = model[1];
+   texels[texel + 2u] = model[2];
+   texels[texel + 3u] = model[3];
+   texels[texel + 6u] = vec4(cofactors[0], 0.0);
+   texels[texel + 7u] = vec4(cofactors[1], 0.0);
+   texels[texel + 8u] = vec4(cofactors[2], 0.0);
+}
@@ -0,0 +1,25 @@
+#version 430 core
+#extension GL_ARB_shader_viewport_layer_array : enable
+// depth of one shadow caster into the cascades of the directional key
+// light, one instance per cascade, each writing its layer of the cascade
+// array; drawn with depthPrepassFragment.glsl, which writes nothing but
+// depth. Without the extension a cascade is drawn at a time, into the
+// one layer attached, with a single instance.
+layout (location = 0) in vec3 inVertexPosition;
+
+// must match CascadedShadows::MAX_CASCADES
+#define MAX_SHADOW_CASCADES 4
+
+uniform mat4 model;
+uniform mat4 cascadeViewProjection[MAX_SHADOW_CASCADES];
+// cascade of instance 0
+uniform int firstCascade;
+
+void main()
+{
+   int cascade = firstCascade + gl_InstanceID;
+   gl_Position = cascadeViewProjection[cascade] * model * vec4(inVertexPosition, 1.0f);
+#ifdef GL_ARB_shader_viewport_layer_array
+   gl_Layer = cascade;
+#endif
+}
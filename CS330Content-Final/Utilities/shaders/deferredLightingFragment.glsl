@@ -0,0 +1,266 @@
+#version 440 core
+// full screen lighting pass of the deferred path: shades the G-buffer
+// written by the USE_GBUFFER permutation of fragmentShader.glsl with the
+// same cluster light lists and light model as the forward path, so both
+// paths produce the same image
+
+#include "include/lighting.glsl"
+
+// must match fragmentShader.glsl
+#define MAX_CLUSTER_LIGHTS 64
+
+// G-buffer targets of DeferredPass
+uniform sampler2D albedoTexture;
+uniform sampler2D normalTexture;
+uniform usampler2D materialTexture;
+uniform sampler2D depthTexture;
+// world position from the window depth
+uniform mat4 inverseViewProjection;
+
+// variable rate shading of ShadingRate: 0 shades every pixel, 1 shades
+// the light of the coarse tiles once per 2x2 pixels into the half
+// resolution coarseLighting, and 2 shades every pixel, reading the
+// light of the coarse tiles back from it; must match
+// ShadingRate::LIGHTING_PASS
+uniform int shadingRatePass;
+uniform usampler2D shadingRateImage;
+uniform sampler2D coarseLighting;
+
+// must match ShadingRate::TILE_SIZE
+#define SHADING_RATE_TILE_SIZE 16
+
+out vec4 outFragmentColor;
+
+#include "include/frameData.glsl"
+
+// active light sources (std140, binding 1)
+layout (std140) uniform LightData
+{
+   int lightCount;
+   LightSource lightSources[MAX_LIGHTS];
+};
+
+// every defined material (std140, binding 2)
+layout (std140) uniform MaterialData
+{
+   Material materials[MAX_MATERIALS];
+};
+
+// cube shadow maps of the lights, layers of one depth cube map array
+// (std140, binding 3), see ShadowAtlas
+#define MAX_SHADOWED_LIGHTS 8
+
+struct ShadowLight
+{
+   vec2 depthRange;     // near and far plane of the cube faces
+};
+
+layout (std140) uniform ShadowData
+{
+   int shadowQuality;   // ShadowAtlas::SHADOW_QUALITY, 0 = off
+   float shadowDepthBias;
+   float shadowTexelSize;   // of a cube face, in uv
+   ShadowLight shadows[MAX_SHADOWED_LIGHTS];
+};
+
+uniform samplerCubeArrayShadow shadowAtlas;
+
+#include "include/cascadeShadows.glsl"
+#include "include/reflectionProbes.glsl"
+
+// light lists of the froxel grid built by lightClusterCompute.glsl
+layout (std430, binding = 2) readonly buffer LightClusters
+{
+   uvec4 gridSize;
+   vec4 sliceParams;    // slice scale, slice bias, viewport width, height
+   uint clusterLights[];
+};
+
+// function prototypes
+float CalcAttenuation(LightSource light, vec3 vertexPosition);
+vec3 CalcDirectLight(LightSource light, Material material, vec3 lightNormal, vec3 vertexPosition, vec3 viewDirection);
+float CalcShadow(LightSource light, vec3 worldPosition);
+uint FindLightCluster(vec2 pixel, vec3 fragmentPosition);
+vec3 DecodeOctahedral(vec2 e);
+
+void main()
+{
+   ivec2 coord = ivec2(gl_FragCoord.xy);
+   bool bCoarseTile = false;
+   if (shadingRatePass != 0)
+   {
+      // a texel of the coarse pass lights the pixel at the corner of
+      // its 2x2 pixels
+      if (shadingRatePass == 1)
+      {
+         coord *= 2;
+      }
+      bCoarseTile = (texelFetch(shadingRateImage, coord / SHADING_RATE_TILE_SIZE, 0).r != 0u);
+      if ((shadingRatePass == 1) && (bCoarseTile == false))
+      {
+         discard;
+      }
+   }
+
+   // nothing was drawn here, keep the clear color and depth
+   uint materialID = texelFetch(materialTexture, coord, 0).r;
+   if (materialID == 0u)
+   {
+      discard;
+   }
+
+   float depth = texelFetch(depthTexture, coord, 0).r;
+   vec2 ndc = (vec2(coord) + 0.5) / vec2(textureSize(depthTexture, 0)) * 2.0 - 1.0;
+   // reverse-Z clips depth to 0..1, which is the window depth as is
+   float ndcDepth = (viewPosition.w != 0.0) ? depth : (depth * 2.0 - 1.0);
+   vec4 worldPosition = inverseViewProjection * vec4(ndc, ndcDepth, 1.0);
+   vec3 fragmentPosition = worldPosition.xyz / worldPosition.w;
+
+   vec4 albedo = texelFetch(albedoTexture, coord, 0);
+   vec3 lightNormal = DecodeOctahedral(texelFetch(normalTexture, coord, 0).xy);
+   vec3 viewDirection = normalize(viewPosition.xyz - fragmentPosition);
+   vec3 phongResult = vec3(0.0f);
+   Material material = materials[materialID - 1u];
+
+   if ((shadingRatePass == 2) && (bCoarseTile == true))
+   {
+      phongResult = texelFetch(coarseLighting, coord / 2, 0).rgb;
+   }
+   else
+   {
+      uint clusterBase = FindLightCluster(vec2(coord) + 0.5, fragmentPosition) * uint(MAX_CLUSTER_LIGHTS + 1);
+      uint clusterLightCount = clusterLights[clusterBase];
+      // the ambient of the material is the same for every light, so it
+      // is added once, weighted by the summed attenuation of the lights
+      vec3 lightAmbient = vec3(0.0);
+      float ambientWeight = 0.0;
+      for(uint i = 0u; i < clusterLightCount; i++)
+      {
+         LightSource light = lightSources[clusterLights[clusterBase + 1u + i]];
+         float attenuation = CalcAttenuation(light, fragmentPosition);
+         lightAmbient += light.ambientColor * attenuation;
+         ambientWeight += attenuation;
+         if ((light.type != LIGHT_TYPE_AMBIENT) && (attenuation > 0.0))
+         {
+            phongResult += CalcDirectLight(light, material, lightNormal, fragmentPosition, viewDirection) * attenuation;
+         }
+      }
+      phongResult += lightAmbient + ((material.ambientColor * material.ambientStrength) * ambientWeight);
+   }
+
+   // the transparent draws that follow test against this depth
+   gl_FragDepth = depth;
+   // the coarse pass keeps the light alone, the albedo and the
+   // reflection stay per pixel
+   if (shadingRatePass == 1)
+   {
+      outFragmentColor = vec4(phongResult, 1.0);
+      return;
+   }
+   vec3 reflection = CalcProbeReflection(fragmentPosition, lightNormal, viewDirection, material);
+   outFragmentColor = vec4((phongResult * albedo.xyz) + reflection, albedo.w);
+}
+
+// unfolds the normal EncodeOctahedral() in fragmentShader.glsl packed
+// into the G-buffer
+vec3 DecodeOctahedral(vec2 e)
+{
+   vec3 n = vec3(e.x, 1.0 - abs(e.x) - abs(e.y), e.y);
+   if (n.y < 0.0)
+   {
+      n.xz = (vec2(1.0) - abs(e.yx)) * vec2(e.x >= 0.0 ? 1.0 : -1.0, e.y >= 0.0 ? 1.0 : -1.0);
+   }
+   return(normalize(n));
+}
+
+// must stay identical to FindLightCluster() in fragmentShader.glsl, but
+// for the pixel, which the coarse pass does not shade at gl_FragCoord
+uint FindLightCluster(vec2 pixel, vec3 fragmentPosition)
+{
+   uvec2 tile = uvec2(clamp(pixel * vec2(gridSize.xy) / sliceParams.zw,
+      vec2(0.0), vec2(gridSize.xy) - 1.0));
+   float viewDepth = max(-(view * vec4(fragmentPosition, 1.0)).z, 1e-4);
+   uint slice = uint(clamp(log(viewDepth) * sliceParams.x + sliceParams.y,
+      0.0, float(gridSize.z) - 1.0));
+
+   return(tile.x + (tile.y * gridSize.x) + (slice * gridSize.x * gridSize.y));
+}
+
+// must stay identical to CalcShadow() in fragmentShader.glsl
+// fraction of the light reaching a world position, from the cube of the
+// light, filtered with more taps at higher quality
+float CalcShadow(LightSource light, vec3 worldPosition)
+{
+   // a directional light has no cube, only the key light has cascades
+   if (light.radius < 0.0)
+   {
+      return((light.shadowIndex < 0) ? 1.0 : CalcCascadeShadow(worldPosition));
+   }
+   if ((light.shadowIndex < 0) || (shadowQuality == 0))
+   {
+      return(1.0);
+   }
+
+   // the face the position lies in looks down its major axis, so its
+   // depth follows from the distance along that axis alone
+   vec3 toFragment = worldPosition - light.position;
+   vec3 axisDistance = abs(toFragment);
+   float majorDistance = max(axisDistance.x, max(axisDistance.y, axisDistance.z));
+   vec2 depthRange = shadows[light.shadowIndex].depthRange;
+   float clipDepth = ((depthRange.y + depthRange.x) / (depthRange.y - depthRange.x)) -
+      ((2.0 * depthRange.y * depthRange.x) / ((depthRange.y - depthRange.x) * majorDistance));
+   float compareDepth = (clipDepth * 0.5 + 0.5) - shadowDepthBias;
+
+   // taps step a texel of the face across the direction, and seamless
+   // filtering carries them over the face edges
+   int filterRadius = shadowQuality - 1;
+   vec3 side = (axisDistance.y < 0.99 * length(toFragment)) ? vec3(0.0, 1.0, 0.0) : vec3(1.0, 0.0, 0.0);
+   vec3 tangent = normalize(cross(toFragment, side));
+   vec3 bitangent = normalize(cross(toFragment, tangent));
+   float texelDistance = 2.0 * majorDistance * shadowTexelSize;
+
+   float lit = 0.0;
+   for (int y = -filterRadius; y <= filterRadius; y++)
+   {
+      for (int x = -filterRadius; x <= filterRadius; x++)
+      {
+         vec3 tapDirection = toFragment + (((float(x) * tangent) + (float(y) * bitangent)) * texelDistance);
+         lit += texture(shadowAtlas, vec4(tapDirection, float(light.shadowIndex)), compareDepth);
+      }
+   }
+
+   float taps = float(((2 * filterRadius) + 1) * ((2 * filterRadius) + 1));
+   return(lit / taps);
+}
+
+// must stay identical to CalcAttenuation() in fragmentShader.glsl
+float CalcAttenuation(LightSource light, vec3 vertexPosition)
+{
+   if (light.radius <= 0.0)
+   {
+      return(light.fade);
+   }
+
+   float distanceRatio = length(light.position - vertexPosition) / light.radius;
+   float window = clamp(1.0 - pow(distanceRatio, 4.0), 0.0, 1.0);
+   return(window * window * light.fade);
+}
+
+// must stay identical to CalcDirectLight() in fragmentShader.glsl, but
+// for its half floats of USE_HALF_PRECISION
+vec3 CalcDirectLight(LightSource light, Material material, vec3 lightNormal, vec3 vertexPosition, vec3 viewDirection)
+{
+   // a directional light holds its direction in place of a position
+   vec3 lightDirection = (light.radius < 0.0) ? normalize(light.position) : normalize(light.position - vertexPosition);
+   float impact = max(dot(lightNormal, lightDirection), 0.0);
+   vec3 direct = impact * material.diffuseColor; 
+
+   if (light.type == LIGHT_TYPE_POINT)
+   {
+      vec3 reflectDir = reflect(-lightDirection, lightNormal);
+      float specularComponent = pow(max(dot(viewDirection, reflectDir), 0.0), light.focalStrength);
+      direct += (light.specularIntensity * material.shininess) * specularComponent * material.specularColor;
+   }
+
+   return(direct * CalcShadow(light, vertexPosition));
+}
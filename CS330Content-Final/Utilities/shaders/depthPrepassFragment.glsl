@@ -0,0 +1,5 @@
+#version 330 core
+// the depth pre-pass only writes depth, color writes are masked off
+void main()
+{
+}
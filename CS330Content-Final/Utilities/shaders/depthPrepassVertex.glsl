@@ -0,0 +1,31 @@
+#version 330 core
+// position-only vertex shader of the depth pre-pass; the instance fetch
+// and position math must stay identical to vertexShader.glsl, so the main
+// pass produces the exact same depth for its GL_EQUAL test
+#extension GL_ARB_shader_draw_parameters : enable
+layout (location = 0) in vec3 inVertexPosition;
+
+invariant gl_Position;
+
+// model matrices of the render list, SceneManager::INSTANCE_DATA as
+// 9 RGBA32F texels of which the first four are read here
+uniform samplerBuffer instanceData;
+uniform int instanceBase = 0;
+
+#include "include/frameData.glsl"
+
+void main()
+{
+#ifdef GL_ARB_shader_draw_parameters
+   int texel = (instanceBase + gl_BaseInstanceARB + gl_InstanceID) * 9;
+#else
+   int texel = (instanceBase + gl_InstanceID) * 9;
+#endif
+   mat4 model = mat4(
+      texelFetch(instanceData, texel),
+      texelFetch(instanceData, texel + 1),
+      texelFetch(instanceData, texel + 2),
+      texelFetch(instanceData, texel + 3));
+
+   gl_Position = projection * view * model * vec4(inVertexPosition, 1.0f);
+}
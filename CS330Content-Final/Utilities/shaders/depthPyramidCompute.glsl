@@ -0,0 +1,60 @@
+#version 430 core
+// builds one level of the hierarchical depth pyramid; level 0 copies the
+// depth buffer, every other level keeps the farthest depth of the 2x2
+// texels below it, plus the extra row and column of an odd sized level;
+// the farthest depth is the smallest one with reverse-Z
+layout (local_size_x = 8, local_size_y = 8) in;
+
+// depth buffer copy for level 0, the pyramid itself for the other levels
+layout (binding = 17) uniform sampler2D sourceDepth;
+layout (binding = 0, r32f) writeonly uniform image2D targetLevel;
+
+// mip level of sourceDepth read by this pass, -1 to copy level 0
+uniform int sourceLevel;
+// true when the depth buffer holds 1 at the near plane and 0 far away
+uniform bool bReverseDepth;
+
+void main()
+{
+   ivec2 targetCoord = ivec2(gl_GlobalInvocationID.xy);
+   ivec2 targetSize = imageSize(targetLevel);
+   if (any(greaterThanEqual(targetCoord, targetSize)))
+   {
+      return;
+   }
+
+   if (sourceLevel < 0)
+   {
+      imageStore(targetLevel, targetCoord, vec4(texelFetch(sourceDepth, targetCoord, 0).r));
+      return;
+   }
+
+   ivec2 sourceSize = textureSize(sourceDepth, sourceLevel);
+   ivec2 sourceMax = sourceSize - ivec2(1);
+   ivec2 sourceCoord = targetCoord * 2;
+
+   // the last texel of an odd level also covers the row or column
+   // that did not fit into the level above it
+   ivec2 extent = ivec2(1);
+   if (((sourceSize.x & 1) != 0) && (targetCoord.x == targetSize.x - 1))
+   {
+      extent.x = 2;
+   }
+   if (((sourceSize.y & 1) != 0) && (targetCoord.y == targetSize.y - 1))
+   {
+      extent.y = 2;
+   }
+
+   float farthest = bReverseDepth ? 1.0 : 0.0;
+   for (int y = 0; y <= extent.y; y++)
+   {
+      for (int x = 0; x <= extent.x; x++)
+      {
+         ivec2 coord = min(sourceCoord + ivec2(x, y), sourceMax);
+         float depth = texelFetch(sourceDepth, coord, sourceLevel).r;
+         farthest = bReverseDepth ? min(farthest, depth) : max(farthest, depth);
+      }
+   }
+
+   imageStore(targetLevel, targetCoord, vec4(farthest));
+}
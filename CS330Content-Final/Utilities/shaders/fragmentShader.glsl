@@ -1,108 +1,538 @@
 #version 440 core
+// resident texture handles replace the per-draw texture units; a SPIR-V
+// module is built for each texture path, as it cannot test for them
+#ifndef USE_SPIRV
+#extension GL_ARB_bindless_texture : enable
+#elif defined(USE_BINDLESS)
+#extension GL_ARB_bindless_texture : require
+#endif
+// HALF and HALF3 are half floats for the color and lighting math, which
+// many GPUs run at twice the rate of full ones, and full ones without
+// USE_HALF_PRECISION or the extensions; positions, depths and texture
+// coordinates stay full precision
+#if defined(USE_HALF_PRECISION) && !defined(USE_SPIRV)
+#extension GL_AMD_gpu_shader_half_float : enable
+#extension GL_NV_gpu_shader5 : enable
+#endif
+#if defined(USE_HALF_PRECISION) && !defined(USE_SPIRV) && (defined(GL_AMD_gpu_shader_half_float) || defined(GL_NV_gpu_shader5))
+#define HALF float16_t
+#define HALF3 f16vec3
+#else
+#define HALF float
+#define HALF3 vec3
+#endif
+#ifdef USE_SPIRV
+// SPIR-V modules carry no names, so the uniforms and blocks are found by
+// the locations and bindings given here; ShaderManager maps the uniform
+// locations back to their names, they must match g_SpirvUniforms
+#define SPIRV_LOCATION(n) layout (location = n)
+#define SPIRV_BLOCK(n) layout (std140, binding = n)
+#else
+#define SPIRV_LOCATION(n)
+#define SPIRV_BLOCK(n) layout (std140)
+#endif
 
-struct Material 
+#include "include/lighting.glsl"
+
+// lights listed per cluster, must match LightClusters::MAX_CLUSTER_LIGHTS;
+// the SPIR-V modules are specialized with it instead
+#define MAX_CLUSTER_LIGHTS 64
+
+// capacity of the texture table, must match TextureTable::MAX_TEXTURES
+#define MAX_TEXTURES 256
+
+SPIRV_LOCATION(0) in vec3 fragmentPosition;
+SPIRV_LOCATION(1) in vec3 fragmentVertexNormal;
+SPIRV_LOCATION(2) in vec2 fragmentTextureCoordinate;
+// xy = lightmap UV, z = 1 on the static geometry the lightmap covers
+SPIRV_LOCATION(3) in vec3 fragmentLightmapCoordinate;
+
+#ifdef USE_OIT
+// weighted blended order-independent transparency: premultiplied color
+// and coverage summed with their weight, and the product of (1 - alpha)
+layout (location = 0) out vec4 outAccumulation;
+layout (location = 1) out float outRevealage;
+#elif defined(USE_GBUFFER)
+// G-buffer of the deferred path, lit by deferredLightingFragment.glsl:
+// albedo and alpha, unlit normal packed octahedrally into xy, and
+// material index + 1 (0 = empty)
+layout (location = 0) out vec4 outAlbedo;
+layout (location = 1) out vec4 outNormal;
+layout (location = 2) out uint outMaterial;
+#else
+SPIRV_LOCATION(0) out vec4 outFragmentColor;
+#endif
+
+// USE_TEXTURE, USE_LIGHTING, USE_INSTANCING, USE_OIT and USE_GBUFFER are injected by
+// ShaderManager when it builds each permutation, in place of runtime
+// branches on uniforms. A SPIR-V module is built for each combination
+// of the bits that change the interface, and the texture and lighting
+// bits are specialization constants set when it is specialized
+#ifdef USE_SPIRV
+layout (constant_id = 0) const bool useTexture = false;
+layout (constant_id = 1) const bool useLighting = false;
+layout (constant_id = 2) const int clusterLightCapacity = MAX_CLUSTER_LIGHTS;
+#else
+#ifdef USE_TEXTURE
+const bool useTexture = true;
+#else
+const bool useTexture = false;
+#endif
+#ifdef USE_LIGHTING
+const bool useLighting = true;
+#else
+const bool useLighting = false;
+#endif
+const int clusterLightCapacity = MAX_CLUSTER_LIGHTS;
+#endif
+
+#ifdef USE_INSTANCING
+// per-instance values fetched by the vertex shader
+SPIRV_LOCATION(4) flat in vec4 instanceColor;
+SPIRV_LOCATION(5) flat in vec2 instanceUVscale;
+SPIRV_LOCATION(6) flat in int instanceMaterialIndex;
+SPIRV_LOCATION(7) flat in int instanceTextureIndex;
+// lights picked for the instance on the CPU, see vertexShader.glsl
+SPIRV_LOCATION(8) flat in uvec3 instanceLights;
+#else
+SPIRV_LOCATION(4) uniform vec4 objectColor = vec4(1.0f);
+SPIRV_LOCATION(5) uniform vec2 UVscale = vec2(1.0f, 1.0f);
+SPIRV_LOCATION(6) uniform int materialIndex = 0;
+SPIRV_LOCATION(7) uniform int textureIndex = 0;
+// single draws have no light list and always read the clusters
+const uvec3 instanceLights = uvec3(0u);
+#endif
+
+#ifdef GL_ARB_bindless_texture
+// resident handle of every scene texture (std140, binding 4), see
+// TextureTable; xy hold the 64-bit handle
+SPIRV_BLOCK(4) uniform TextureData
+{
+   uvec4 textureHandles[MAX_TEXTURES];
+};
+#else
+// every scene texture packed into a tile of a texture array layer
+// (std140, binding 4), see TextureTable
+struct TextureLayer
+{
+   vec4 rect;      // xy = offset, zw = scale in the layer
+   ivec4 layer;    // x = layer, y = channels of a gray texture, zw unused
+};
+
+SPIRV_BLOCK(4) uniform TextureData
+{
+   TextureLayer textureLayers[MAX_TEXTURES];
+};
+
+SPIRV_LOCATION(8) uniform sampler2DArray textureArray;
+#endif
+
+#include "include/frameData.glsl"
+
+// active light sources (std140, binding 1); only the first
+// lightCount entries are uploaded and evaluated
+SPIRV_BLOCK(1) uniform LightData
+{
+   int lightCount;
+   LightSource lightSources[MAX_LIGHTS];
+};
+
+// every defined material (std140, binding 2), selected by materialIndex
+SPIRV_BLOCK(2) uniform MaterialData
+{
+   Material materials[MAX_MATERIALS];
+};
+
+// cube shadow maps of the lights, layers of one depth cube map array
+// (std140, binding 3), see ShadowAtlas
+#define MAX_SHADOWED_LIGHTS 8
+
+struct ShadowLight
 {
-    vec3 ambientColor;
-    float ambientStrength;
-    vec3 diffuseColor;
-    vec3 specularColor;
-    float shininess;
-}; 
+   vec2 depthRange;     // near and far plane of the cube faces
+};
 
-struct LightSource 
+SPIRV_BLOCK(3) uniform ShadowData
 {
-    vec3 position;	
-    vec3 ambientColor;
-    vec3 diffuseColor;
-    vec3 specularColor;
-    float focalStrength;
-    float specularIntensity;
+   int shadowQuality;   // ShadowAtlas::SHADOW_QUALITY, 0 = off
+   float shadowDepthBias;
+   float shadowTexelSize;   // of a cube face, in uv
+   ShadowLight shadows[MAX_SHADOWED_LIGHTS];
 };
 
-#define TOTAL_LIGHTS 4
+SPIRV_LOCATION(9) uniform samplerCubeArrayShadow shadowAtlas;
+
+#include "include/cascadeShadows.glsl"
+#include "include/reflectionProbes.glsl"
+
+// diffuse and ambient lighting of the static geometry baked by
+// LightmapBaker; 0 while the lights have no finished bake
+SPIRV_LOCATION(10) uniform sampler2D lightmap;
+SPIRV_LOCATION(11) uniform int lightmapEnabled = 0;
 
-in vec3 fragmentPosition;
-in vec3 fragmentVertexNormal;
-in vec2 fragmentTextureCoordinate;
+#ifdef GL_ARB_bindless_texture
+// capacity of the page tables, must match VirtualTextures::MAX_VIRTUAL_TEXTURES
+#define MAX_VIRTUAL_TEXTURES 8
+
+// page tables of the sparse textures paged in by VirtualTextures (std430,
+// binding 7): the pixel of each 4x4 block writing feedback this frame,
+// two entries per texture, then the feedback bits of every page followed
+// by the finest resident level under each tile of level 0
+layout (std430, binding = 7) buffer VirtualPages
+{
+   uvec4 virtualFrame;   // x = pixel of the 4x4 block, 0 to 15
+   // xy = tiles across and down level 0, z = levels paged in, then
+   // x = first feedback bit, y = first residency word
+   uvec4 virtualTextures[MAX_VIRTUAL_TEXTURES * 2];
+   uint virtualWords[];
+};
 
-out vec4 outFragmentColor;
+// the feedback written must not come from pixels the depth test drops
+layout (early_fragment_tests) in;
+#endif
 
-uniform bool bUseTexture=false;
-uniform bool bUseLighting=false;
-uniform vec4 objectColor = vec4(1.0f);
-uniform sampler2D objectTexture;
-uniform vec3 viewPosition;
-uniform vec2 UVscale = vec2(1.0f, 1.0f);
-uniform LightSource lightSources[TOTAL_LIGHTS];
-uniform Material material;
+// light lists of the froxel grid built by lightClusterCompute.glsl
+// (std430, binding 2): grid header, then per cluster a count and indexes
+layout (std430, binding = 2) readonly buffer LightClusters
+{
+   uvec4 gridSize;
+   vec4 sliceParams;    // slice scale, slice bias, viewport width, height
+   uint clusterLights[];
+};
 
 // function prototypes
-vec3 CalcLightSource(LightSource light, vec3 lightNormal, vec3 vertexPosition, vec3 viewDirection);
+float CalcAttenuation(LightSource light, vec3 vertexPosition);
+HALF3 CalcDirectLight(LightSource light, Material material, vec3 lightNormal, vec3 vertexPosition, vec3 viewDirection);
+float CalcShadow(LightSource light, vec3 worldPosition);
+void WriteFragmentColor(vec4 color);
+vec4 SampleObjectTexture(int index, vec2 uv);
+#ifdef GL_ARB_bindless_texture
+vec4 SampleVirtualTexture(sampler2D virtualSampler, int virtualIndex, vec2 uv);
+#endif
+uint FindLightCluster();
+#ifdef USE_GBUFFER
+vec2 EncodeOctahedral(vec3 n);
+#endif
 
 void main()
 {
-   if(bUseLighting == true)
+#ifdef USE_INSTANCING
+   vec4 drawColor = instanceColor;
+   vec2 drawUVscale = instanceUVscale;
+   int drawMaterialIndex = instanceMaterialIndex;
+   int drawTextureIndex = instanceTextureIndex;
+#else
+   vec4 drawColor = objectColor;
+   vec2 drawUVscale = UVscale;
+   int drawMaterialIndex = materialIndex;
+   int drawTextureIndex = textureIndex;
+#endif
+
+   // useTexture and useLighting are constant, so the branches on them
+   // are folded away like the #ifdef blocks of the interface bits
+#ifdef USE_GBUFFER
+   // the lighting pass shades albedo the way the lit branch below does
+   if (useTexture)
+   {
+      outAlbedo = vec4(SampleObjectTexture(drawTextureIndex, fragmentTextureCoordinate * drawUVscale).xyz, 1.0);
+   }
+   else
+   {
+      outAlbedo = drawColor;
+   }
+   outNormal = vec4(EncodeOctahedral(normalize(fragmentVertexNormal)), 0.0, 0.0);
+   outMaterial = uint(drawMaterialIndex) + 1u;
+#else
+   if (useLighting)
    {
       // properties
       vec3 lightNormal = normalize(fragmentVertexNormal);
-      vec3 viewDirection = normalize(viewPosition - fragmentPosition);
-      vec3 phongResult = vec3(0.0f);
+      vec3 viewDirection = normalize(viewPosition.xyz - fragmentPosition);
+      HALF3 phongResult = HALF3(0.0);
+      Material material = materials[drawMaterialIndex];
 
-      for(int i = 0; i < TOTAL_LIGHTS; i++)
+      if ((lightmapEnabled != 0) && (fragmentLightmapCoordinate.z > 0.5))
+      {
+         // static surfaces read their baked lighting, without highlights
+         phongResult = HALF3(texture(lightmap, fragmentLightmapCoordinate.xy).rgb);
+      }
+      else
       {
-         phongResult += CalcLightSource(lightSources[i], lightNormal, fragmentPosition, viewDirection); 
-      }   
-    
-      if(bUseTexture == true)
+         // only the few lights picked for the draw, when it has a list,
+         // or else the lights that reach the cluster of this fragment
+         uint objectLightCount = instanceLights.x & 0xFFu;
+         uint clusterBase = 0u;
+         uint drawLightCount = 0u;
+         if (objectLightCount != 0u)
+         {
+            drawLightCount = objectLightCount - 1u;
+         }
+         else
+         {
+            clusterBase = FindLightCluster() * uint(clusterLightCapacity + 1);
+            drawLightCount = clusterLights[clusterBase];
+         }
+         // the ambient of the material is the same for every light, so it is
+         // added once, weighted by the summed attenuation of the lights
+         HALF3 lightAmbient = HALF3(0.0);
+         HALF ambientWeight = HALF(0.0);
+         for(uint i = 0u; i < drawLightCount; i++)
+         {
+            // the list bytes follow the count, three to a word
+            uint lightIndex = (objectLightCount != 0u) ?
+               ((instanceLights[(i + 1u) / 3u] >> (((i + 1u) % 3u) * 8u)) & 0xFFu) :
+               clusterLights[clusterBase + 1u + i];
+            LightSource light = lightSources[lightIndex];
+            HALF attenuation = HALF(CalcAttenuation(light, fragmentPosition));
+            lightAmbient += HALF3(light.ambientColor) * attenuation;
+            ambientWeight += attenuation;
+            if ((light.type != LIGHT_TYPE_AMBIENT) && (attenuation > HALF(0.0)))
+            {
+               phongResult += CalcDirectLight(light, material, lightNormal, fragmentPosition, viewDirection) * attenuation;
+            }
+         }
+         phongResult += lightAmbient + (HALF3(material.ambientColor * material.ambientStrength) * ambientWeight);
+      }
+      // the reflection sits on top of the surface color, not tinted by it
+      vec3 reflection = CalcProbeReflection(fragmentPosition, lightNormal, viewDirection, material);
+
+      if (useTexture)
       {
-         vec4 textureColor = texture(objectTexture, fragmentTextureCoordinate * UVscale);
-         outFragmentColor = vec4(phongResult * textureColor.xyz, 1.0);
+         vec4 textureColor = SampleObjectTexture(drawTextureIndex, fragmentTextureCoordinate * drawUVscale);
+#ifdef USE_OIT
+         // translucent surfaces keep the coverage of their texture and color
+         WriteFragmentColor(vec4(vec3(phongResult * HALF3(textureColor.xyz)) + reflection, textureColor.w * drawColor.w));
+#else
+         WriteFragmentColor(vec4(vec3(phongResult * HALF3(textureColor.xyz)) + reflection, 1.0));
+#endif
       }
       else
       {
-         outFragmentColor = vec4(phongResult * objectColor.xyz, objectColor.w);
+         WriteFragmentColor(vec4(vec3(phongResult * HALF3(drawColor.xyz)) + reflection, drawColor.w));
       }
    }
-   else 
+   else if (useTexture)
    {
-      if(bUseTexture == true)
+      WriteFragmentColor(SampleObjectTexture(drawTextureIndex, fragmentTextureCoordinate * drawUVscale));
+   }
+   else
+   {
+      WriteFragmentColor(drawColor);
+   }
+#endif
+}
+
+#ifdef USE_GBUFFER
+// folds the unit sphere onto the square of -1..1 the two channels of
+// the normal target hold, which spreads their precision evenly over
+// every direction; DecodeOctahedral() in deferredLightingFragment.glsl
+// unfolds it
+vec2 EncodeOctahedral(vec3 n)
+{
+   n /= (abs(n.x) + abs(n.y) + abs(n.z));
+   vec2 folded = n.xz;
+   if (n.y < 0.0)
+   {
+      folded = (vec2(1.0) - abs(n.zx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.z >= 0.0 ? 1.0 : -1.0);
+   }
+   return(folded);
+}
+#endif
+
+// reads the scene texture of the draw by its texture table index; with
+// bindless handles the index is the same over a whole draw
+vec4 SampleObjectTexture(int index, vec2 uv)
+{
+#ifdef GL_ARB_bindless_texture
+   uvec4 entry = textureHandles[index];
+   if (entry.z != 0u)
+   {
+      return SampleVirtualTexture(sampler2D(entry.xy), int(entry.z) - 1, uv);
+   }
+   return texture(sampler2D(entry.xy), uv);
+#else
+   // repeat inside the tile, half a texel in from its edges, with the
+   // gradients of the unwrapped UVs so the wrap seam keeps its mip level
+   TextureLayer entry = textureLayers[index];
+   vec2 inset = vec2(0.5) / (vec2(textureSize(textureArray, 0).xy) * entry.rect.zw);
+   vec2 tileUV = entry.rect.xy + clamp(fract(uv), inset, vec2(1.0) - inset) * entry.rect.zw;
+   vec4 texel = textureGrad(textureArray, vec3(tileUV, float(entry.layer.x)),
+      dFdx(uv) * entry.rect.zw, dFdy(uv) * entry.rect.zw);
+   // the blit into the array kept a gray texture in red, and its
+   // alpha in green, rather than through its swizzle
+   if (entry.layer.y == 1)
+   {
+      texel = vec4(texel.rrr, 1.0);
+   }
+   else if (entry.layer.y == 2)
+   {
+      texel = texel.rrrg;
+   }
+   return texel;
+#endif
+}
+
+#ifdef GL_ARB_bindless_texture
+// reads a sparse texture no finer than the level resident under its
+// tile, by scaling the gradients up to it, and from one pixel of each
+// 4x4 block a frame marks the page the level it wanted falls in
+vec4 SampleVirtualTexture(sampler2D virtualSampler, int virtualIndex, vec2 uv)
+{
+   uvec4 extent = virtualTextures[virtualIndex * 2];
+   uvec4 tables = virtualTextures[virtualIndex * 2 + 1];
+   vec2 gradientX = dFdx(uv);
+   vec2 gradientY = dFdy(uv);
+   float lod = max(textureQueryLod(virtualSampler, uv).y, 0.0);
+   // the texture repeats
+   vec2 wrappedUV = fract(uv);
+
+   uvec2 blockPixel = uvec2(gl_FragCoord.xy) & 3u;
+   uint level = uint(lod);
+   if ((blockPixel.y * 4u + blockPixel.x == virtualFrame.x) && (level < extent.z))
+   {
+      uvec2 tiles = extent.xy;
+      uint page = 0u;
+      for (uint i = 0u; i < level; i++)
       {
-         outFragmentColor = texture(objectTexture, fragmentTextureCoordinate * UVscale);
+         page += tiles.x * tiles.y;
+         tiles >>= 1u;
       }
-      else
+      uvec2 tile = min(uvec2(wrappedUV * vec2(tiles)), tiles - 1u);
+      uint bit = tables.x + page + tile.y * tiles.x + tile.x;
+      atomicOr(virtualWords[bit >> 5u], 1u << (bit & 31u));
+   }
+
+   uvec2 baseTile = min(uvec2(wrappedUV * vec2(extent.xy)), extent.xy - 1u);
+   float resident = float(virtualWords[tables.y + baseTile.y * extent.x + baseTile.x]);
+   float scale = exp2(max(resident - lod, 0.0));
+   return textureGrad(virtualSampler, uv, gradientX * scale, gradientY * scale);
+}
+#endif
+
+// writes the shaded color, or its weighted share of the transparent
+// layers with the depth weight of McGuire and Bavoil's equation 7
+void WriteFragmentColor(vec4 color)
+{
+#if defined(USE_GBUFFER)
+   // never called, the G-buffer targets are written in main()
+#elif defined(USE_OIT)
+   // the weight falls off with distance, so reverse-Z depth is flipped
+   float depth = (viewPosition.w != 0.0) ? (1.0 - gl_FragCoord.z) : gl_FragCoord.z;
+   float weight = clamp(pow(min(1.0, color.a * 10.0) + 0.01, 3.0) * 1e8 *
+      pow(1.0 - depth * 0.9, 3.0), 1e-2, 3e3);
+   outAccumulation = vec4(color.rgb * color.a, color.a) * weight;
+   outRevealage = color.a;
+#else
+   outFragmentColor = color;
+#endif
+}
+
+// index of the froxel grid cluster this fragment lies in, from its
+// screen tile and the exponential slice of its view depth; the tile
+// comes from the projected position rather than gl_FragCoord, so a
+// view drawn into part of the frame finds its own tiles
+uint FindLightCluster()
+{
+   vec4 clipPosition = projection * view * vec4(fragmentPosition, 1.0);
+   vec2 screenPosition = (clipPosition.xy / clipPosition.w) * 0.5 + 0.5;
+   uvec2 tile = uvec2(clamp(screenPosition * vec2(gridSize.xy),
+      vec2(0.0), vec2(gridSize.xy) - 1.0));
+   float viewDepth = max(-(view * vec4(fragmentPosition, 1.0)).z, 1e-4);
+   uint slice = uint(clamp(log(viewDepth) * sliceParams.x + sliceParams.y,
+      0.0, float(gridSize.z) - 1.0));
+
+   return(tile.x + (tile.y * gridSize.x) + (slice * gridSize.x * gridSize.y));
+}
+
+// fraction of the light reaching a world position, from the cube of the
+// light, filtered with more taps at higher quality
+float CalcShadow(LightSource light, vec3 worldPosition)
+{
+   // a directional light has no cube, only the key light has cascades
+   if (light.radius < 0.0)
+   {
+      return((light.shadowIndex < 0) ? 1.0 : CalcCascadeShadow(worldPosition));
+   }
+   if ((light.shadowIndex < 0) || (shadowQuality == 0))
+   {
+      return(1.0);
+   }
+
+   // the face the position lies in looks down its major axis, so its
+   // depth follows from the distance along that axis alone
+   vec3 toFragment = worldPosition - light.position;
+   vec3 axisDistance = abs(toFragment);
+   float majorDistance = max(axisDistance.x, max(axisDistance.y, axisDistance.z));
+   vec2 depthRange = shadows[light.shadowIndex].depthRange;
+   float clipDepth = ((depthRange.y + depthRange.x) / (depthRange.y - depthRange.x)) -
+      ((2.0 * depthRange.y * depthRange.x) / ((depthRange.y - depthRange.x) * majorDistance));
+   float compareDepth = (clipDepth * 0.5 + 0.5) - shadowDepthBias;
+
+   // taps step a texel of the face across the direction, and seamless
+   // filtering carries them over the face edges
+   int filterRadius = shadowQuality - 1;
+   vec3 side = (axisDistance.y < 0.99 * length(toFragment)) ? vec3(0.0, 1.0, 0.0) : vec3(1.0, 0.0, 0.0);
+   vec3 tangent = normalize(cross(toFragment, side));
+   vec3 bitangent = normalize(cross(toFragment, tangent));
+   float texelDistance = 2.0 * majorDistance * shadowTexelSize;
+
+   float lit = 0.0;
+   for (int y = -filterRadius; y <= filterRadius; y++)
+   {
+      for (int x = -filterRadius; x <= filterRadius; x++)
       {
-         outFragmentColor = objectColor;
+         vec3 tapDirection = toFragment + (((float(x) * tangent) + (float(y) * bitangent)) * texelDistance);
+         lit += texture(shadowAtlas, vec4(tapDirection, float(light.shadowIndex)), compareDepth);
       }
    }
+
+   float taps = float(((2 * filterRadius) + 1) * ((2 * filterRadius) + 1));
+   return(lit / taps);
 }
 
-// calculates the color when using a directional light.
-vec3 CalcLightSource(LightSource light, vec3 lightNormal, vec3 vertexPosition, vec3 viewDirection)
+// fades the light to nothing at its radius, so culling the light past
+// it makes no visible difference, times the fade of the light LOD; both
+// the ambient and the direct terms are scaled by it
+float CalcAttenuation(LightSource light, vec3 vertexPosition)
 {
-   vec3 ambient;
-   vec3 diffuse;
-   vec3 specular;
-
-   //**Calculate Ambient lighting**
+   if (light.radius <= 0.0)
+   {
+      return(light.fade);
+   }
 
-   ambient = light.ambientColor + (material.ambientColor * material.ambientStrength);
+   float distanceRatio = length(light.position - vertexPosition) / light.radius;
+   float window = clamp(1.0 - pow(distanceRatio, 4.0), 0.0, 1.0);
+   return(window * window * light.fade);
+}
 
+// calculates the diffuse and specular color of a light that is not
+// ambient only, before its attenuation; the direction to the light
+// comes from full precision positions, the terms after it are half
+HALF3 CalcDirectLight(LightSource light, Material material, vec3 lightNormal, vec3 vertexPosition, vec3 viewDirection)
+{
    //**Calculate Diffuse lighting**
 
    // Calculate distance (light direction) between light source and fragments/pixels
-   vec3 lightDirection = normalize(light.position - vertexPosition); 
+   // a directional light holds its direction in place of a position
+   vec3 lightDirection = (light.radius < 0.0) ? normalize(light.position) : normalize(light.position - vertexPosition);
    // Calculate diffuse impact by generating dot product of normal and light
-   float impact = max(dot(lightNormal, lightDirection), 0.0);
+   HALF impact = max(dot(HALF3(lightNormal), HALF3(lightDirection)), HALF(0.0));
    // Generate diffuse material color   
-   diffuse = impact * material.diffuseColor; 
+   HALF3 direct = impact * HALF3(material.diffuseColor); 
 
    //**Calculate Specular lighting**
 
-   // Calculate reflection vector
-   vec3 reflectDir = reflect(-lightDirection, lightNormal);
-   // Calculate specular component
-   float specularComponent = pow(max(dot(viewDirection, reflectDir), 0.0), light.focalStrength);
-   specular = (light.specularIntensity * material.shininess) * specularComponent * material.specularColor;
-  
-   return(ambient + diffuse + specular);
-}
\ No newline at end of file
+   // only lights with a highlight pay for the reflection and pow()
+   if (light.type == LIGHT_TYPE_POINT)
+   {
+      // Calculate reflection vector
+      vec3 reflectDir = reflect(-lightDirection, lightNormal);
+      // Calculate specular component; pow() scales the rounding of its
+      // base by the exponent, so the base is kept full precision
+      HALF specularComponent = HALF(pow(max(dot(viewDirection, reflectDir), 0.0), light.focalStrength));
+      direct += HALF(light.specularIntensity * material.shininess) * specularComponent * HALF3(material.specularColor);
+   }
+
+   // shadows only hold back the direct light
+   return(direct * HALF(CalcShadow(light, vertexPosition)));
+}
@@ -0,0 +1,102 @@
+#version 440 core
+// albedo, normal, depth and material of one part into a view of its
+// impostor; lit later by impostorFragment.glsl
+#extension GL_ARB_bindless_texture : enable
+
+// capacity of the texture table, must match TextureTable::MAX_TEXTURES
+#define MAX_TEXTURES 256
+
+in vec3 fragmentVertexNormal;
+in vec2 fragmentTextureCoordinate;
+
+// albedo and coverage, and the octahedral normal in xy, window depth
+// in z and material index + 1 in w (0 = empty)
+layout (location = 0) out vec4 outAlbedo;
+layout (location = 1) out vec4 outNormalDepth;
+
+uniform vec4 objectColor = vec4(1.0f);
+uniform vec2 UVscale = vec2(1.0f, 1.0f);
+uniform int materialIndex = 0;
+// texture table index, -1 for the untextured parts
+uniform int textureIndex = -1;
+// 1 for the blended parts, which only add to the albedo
+uniform int transparent = 0;
+
+#ifdef GL_ARB_bindless_texture
+// resident handle of every scene texture (std140, binding 4), see
+// TextureTable; xy hold the 64-bit handle
+layout (std140) uniform TextureData
+{
+   uvec4 textureHandles[MAX_TEXTURES];
+};
+#else
+// every scene texture packed into a tile of a texture array layer
+// (std140, binding 4), see TextureTable
+struct TextureLayer
+{
+   vec4 rect;      // xy = offset, zw = scale in the layer
+   ivec4 layer;    // x = layer, y = channels of a gray texture, zw unused
+};
+
+layout (std140) uniform TextureData
+{
+   TextureLayer textureLayers[MAX_TEXTURES];
+};
+
+uniform sampler2DArray textureArray;
+#endif
+
+// same lookup as fragmentShader.glsl
+vec4 SampleObjectTexture(int index, vec2 uv)
+{
+#ifdef GL_ARB_bindless_texture
+   return texture(sampler2D(textureHandles[index].xy), uv);
+#else
+   TextureLayer entry = textureLayers[index];
+   vec2 inset = vec2(0.5) / (vec2(textureSize(textureArray, 0).xy) * entry.rect.zw);
+   vec2 tileUV = entry.rect.xy + clamp(fract(uv), inset, vec2(1.0) - inset) * entry.rect.zw;
+   vec4 texel = textureGrad(textureArray, vec3(tileUV, float(entry.layer.x)),
+      dFdx(uv) * entry.rect.zw, dFdy(uv) * entry.rect.zw);
+   if (entry.layer.y == 1)
+   {
+      texel = vec4(texel.rrr, 1.0);
+   }
+   else if (entry.layer.y == 2)
+   {
+      texel = texel.rrrg;
+   }
+   return texel;
+#endif
+}
+
+// unit vector onto the square of its octahedron, in -1..1
+vec2 EncodeOctahedral(vec3 n)
+{
+   n /= (abs(n.x) + abs(n.y) + abs(n.z));
+   vec2 folded = n.xz;
+   if (n.y < 0.0)
+   {
+      folded = (vec2(1.0) - abs(n.zx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.z >= 0.0 ? 1.0 : -1.0);
+   }
+   return(folded);
+}
+
+void main()
+{
+   vec4 albedo = objectColor;
+   if (textureIndex >= 0)
+   {
+      // the lit shaders take the texture over the color, keeping the
+      // alpha of the color on the blended parts
+      vec4 textureColor = SampleObjectTexture(textureIndex, fragmentTextureCoordinate * UVscale);
+      albedo = vec4(textureColor.xyz, (transparent != 0) ? (textureColor.w * objectColor.w) : 1.0);
+   }
+   if (transparent == 0)
+   {
+      albedo.w = 1.0;
+   }
+
+   outAlbedo = albedo;
+   outNormalDepth = vec4(EncodeOctahedral(normalize(fragmentVertexNormal)),
+      gl_FragCoord.z, float(materialIndex + 1));
+}
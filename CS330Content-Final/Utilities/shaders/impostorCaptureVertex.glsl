@@ -0,0 +1,20 @@
+#version 330 core
+// one part of a composite object into a view of its impostor, in the
+// space of the object, see ImpostorAtlas
+layout (location = 0) in vec3 inVertexPosition;
+layout (location = 1) in vec3 inVertexNormal;
+layout (location = 2) in vec2 inTextureCoordinate;
+
+out vec3 fragmentVertexNormal;
+out vec2 fragmentTextureCoordinate;
+
+uniform mat4 model;
+uniform mat3 normalMatrix;
+uniform mat4 captureViewProjection;
+
+void main()
+{
+   gl_Position = captureViewProjection * model * vec4(inVertexPosition, 1.0f);
+   fragmentVertexNormal = normalMatrix * inVertexNormal;
+   fragmentTextureCoordinate = inTextureCoordinate;
+}
@@ -0,0 +1,208 @@
+#version 330 core
+// an impostor from the four views of its octahedral grid nearest the
+// camera direction, captured by impostorCaptureFragment.glsl; lit with
+// the light model of fragmentShader.glsl, without shadows
+
+#include "include/lighting.glsl"
+
+// must match ImpostorAtlas::GRID_SIZE and ImpostorAtlas::VIEW_SIZE
+#define GRID_SIZE 8
+#define VIEW_SIZE 64
+
+// share of the radius the surface is moved toward the camera, so the
+// impostor wins the depth test over the parts it fades in over
+#define DEPTH_BIAS 0.05
+
+in vec3 localPosition;
+flat in ivec4 viewIndexes;
+flat in vec4 viewWeights;
+flat in mat3 objectAxes;
+flat in mat3 normalAxes;
+flat in vec4 centerRadius;
+flat in float worldRadius;
+flat in float atlasLayer;
+flat in float fade;
+
+out vec4 outFragmentColor;
+
+// views of every impostor, one layer each, see ImpostorAtlas
+uniform sampler2DArray albedoAtlas;
+uniform sampler2DArray normalDepthAtlas;
+// 0 draws the albedo unlit
+uniform int lighting = 1;
+
+#include "include/frameData.glsl"
+
+// active light sources (std140, binding 1)
+layout (std140) uniform LightData
+{
+   int lightCount;
+   LightSource lightSources[MAX_LIGHTS];
+};
+
+// every defined material (std140, binding 2)
+layout (std140) uniform MaterialData
+{
+   Material materials[MAX_MATERIALS];
+};
+
+// 4x4 ordered dither thresholds of the cross-fade
+const float BAYER[16] = float[16](
+   0.0, 8.0, 2.0, 10.0,
+   12.0, 4.0, 14.0, 6.0,
+   3.0, 11.0, 1.0, 9.0,
+   15.0, 7.0, 13.0, 5.0);
+
+// direction a view of the grid was captured from, matching
+// GetViewDirection() of ImpostorAtlas.cpp
+vec3 GetViewDirection(int viewIndex)
+{
+   vec2 octahedral = (vec2(float(viewIndex % GRID_SIZE), float(viewIndex / GRID_SIZE)) /
+      float(GRID_SIZE - 1)) * 2.0 - 1.0;
+   vec3 direction = vec3(octahedral.x, 1.0 - abs(octahedral.x) - abs(octahedral.y), octahedral.y);
+   if (direction.y < 0.0)
+   {
+      direction.xz = (vec2(1.0) - abs(octahedral.yx)) *
+         vec2(octahedral.x >= 0.0 ? 1.0 : -1.0, octahedral.y >= 0.0 ? 1.0 : -1.0);
+   }
+   return(normalize(direction));
+}
+
+vec3 DecodeOctahedral(vec2 e)
+{
+   vec3 n = vec3(e.x, 1.0 - abs(e.x) - abs(e.y), e.y);
+   if (n.y < 0.0)
+   {
+      n.xz = (vec2(1.0) - abs(e.yx)) * vec2(e.x >= 0.0 ? 1.0 : -1.0, e.y >= 0.0 ? 1.0 : -1.0);
+   }
+   return(normalize(n));
+}
+
+// same fall off and light model as fragmentShader.glsl
+float CalcAttenuation(LightSource light, vec3 vertexPosition)
+{
+   if (light.radius <= 0.0)
+   {
+      return(light.fade);
+   }
+
+   float distanceRatio = length(light.position - vertexPosition) / light.radius;
+   float window = clamp(1.0 - pow(distanceRatio, 4.0), 0.0, 1.0);
+   return(window * window * light.fade);
+}
+
+vec3 CalcDirectLight(LightSource light, Material material, vec3 lightNormal, vec3 vertexPosition, vec3 viewDirection)
+{
+   vec3 lightDirection = (light.radius < 0.0) ? normalize(light.position) : normalize(light.position - vertexPosition);
+   float impact = max(dot(lightNormal, lightDirection), 0.0);
+   vec3 direct = impact * material.diffuseColor;
+   if (light.type == LIGHT_TYPE_POINT)
+   {
+      vec3 reflectDir = reflect(-lightDirection, lightNormal);
+      float specularComponent = pow(max(dot(viewDirection, reflectDir), 0.0), light.focalStrength);
+      direct += (light.specularIntensity * material.shininess) * specularComponent * material.specularColor;
+   }
+   return(direct);
+}
+
+void main()
+{
+   // the impostor takes the share of the pixels its fade asks for
+   ivec2 ditherPixel = ivec2(gl_FragCoord.xy) & 3;
+   if (fade <= ((BAYER[(ditherPixel.y * 4) + ditherPixel.x] + 0.5) / 16.0))
+   {
+      discard;
+   }
+
+   float radius = centerRadius.w;
+   vec2 halfTexel = vec2(0.5 / float(VIEW_SIZE));
+   vec3 albedoSum = vec3(0.0);
+   vec3 normalSum = vec3(0.0);
+   vec3 surfaceSum = vec3(0.0);
+   float coverage = 0.0;
+   float dominantWeight = -1.0;
+   vec3 dominantCoordinate = vec3(0.0);
+   for (int i = 0; i < 4; i++)
+   {
+      float weight = viewWeights[i];
+      if (weight <= 0.0)
+      {
+         continue;
+      }
+
+      // the quad point as the view saw it, inside its tile
+      int viewIndex = viewIndexes[i];
+      vec3 direction = GetViewDirection(viewIndex);
+      vec3 reference = (abs(direction.y) < 0.999) ? vec3(0.0, 1.0, 0.0) : vec3(0.0, 0.0, 1.0);
+      vec3 right = normalize(cross(reference, direction));
+      vec3 up = cross(direction, right);
+      vec2 frame = vec2(dot(localPosition, right), dot(localPosition, up)) / radius;
+      vec2 frameUV = clamp(frame * 0.5 + 0.5, halfTexel, vec2(1.0) - halfTexel);
+      vec2 tile = vec2(float(viewIndex % GRID_SIZE), float(viewIndex / GRID_SIZE));
+      vec3 coordinate = vec3((tile + frameUV) / float(GRID_SIZE), atlasLayer);
+
+      vec4 albedo = texture(albedoAtlas, coordinate);
+      vec4 normalDepth = texture(normalDepthAtlas, coordinate);
+      float share = weight * albedo.w;
+      albedoSum += albedo.xyz * share;
+      coverage += share;
+      normalSum += DecodeOctahedral(normalDepth.xy) * share;
+      // the window depth of the orthographic view back to a distance
+      // along its direction
+      surfaceSum += ((right * frame.x) + (up * frame.y) + (direction * (1.0 - 2.0 * normalDepth.z))) * radius * share;
+      if (weight > dominantWeight)
+      {
+         dominantWeight = weight;
+         dominantCoordinate = coordinate;
+      }
+   }
+   if (coverage < 0.5)
+   {
+      discard;
+   }
+
+   vec3 albedo = albedoSum / coverage;
+   vec3 worldPosition = centerRadius.xyz + (objectAxes * (surfaceSum / coverage));
+
+   // depth of the surface, nudged toward the camera
+   vec4 viewSpace = view * vec4(worldPosition, 1.0);
+   viewSpace.z += worldRadius * DEPTH_BIAS;
+   vec4 clip = projection * viewSpace;
+   float ndcDepth = clip.z / clip.w;
+   gl_FragDepth = (viewPosition.w != 0.0) ? ndcDepth : ((ndcDepth * 0.5) + 0.5);
+
+   if (lighting == 0)
+   {
+      outFragmentColor = vec4(albedo, 1.0);
+      return;
+   }
+
+   // the material is never blended, so it comes from the nearest view
+   ivec3 materialTexel = ivec3(dominantCoordinate.xy * vec2(textureSize(normalDepthAtlas, 0).xy), int(atlasLayer));
+   int materialIndex = clamp(int(texelFetch(normalDepthAtlas, materialTexel, 0).w + 0.5) - 1, 0, MAX_MATERIALS - 1);
+   Material material = materials[materialIndex];
+
+   vec3 lightNormal = normalize(normalAxes * normalSum);
+   vec3 viewDirection = normalize(viewPosition.xyz - worldPosition);
+   vec3 phongResult = vec3(0.0);
+   vec3 lightAmbient = vec3(0.0);
+   float ambientWeight = 0.0;
+   for (int i = 0; i < lightCount; i++)
+   {
+      LightSource light = lightSources[i];
+      if (light.type == LIGHT_TYPE_OFF)
+      {
+         continue;
+      }
+      float attenuation = CalcAttenuation(light, worldPosition);
+      lightAmbient += light.ambientColor * attenuation;
+      ambientWeight += attenuation;
+      if ((light.type != LIGHT_TYPE_AMBIENT) && (attenuation > 0.0))
+      {
+         phongResult += CalcDirectLight(light, material, lightNormal, worldPosition, viewDirection) * attenuation;
+      }
+   }
+   phongResult += lightAmbient + ((material.ambientColor * material.ambientStrength) * ambientWeight);
+
+   outFragmentColor = vec4(phongResult * albedo, 1.0);
+}
@@ -0,0 +1,73 @@
+#version 330 core
+// one camera facing quad per impostor, read as instance attributes, see
+// ImpostorAtlas::IMPOSTOR_INSTANCE; picks the four views of the
+// octahedral grid around the direction the object is seen from
+layout (location = 0) in vec4 inCenterRadius;   // world center, capture radius in object space
+layout (location = 1) in vec4 inAxisX;          // object to world columns, w = atlas layer
+layout (location = 2) in vec4 inAxisY;          // w = share of the pixels the impostor takes
+layout (location = 3) in vec4 inAxisZ;
+
+// views along each side of the grid, must match ImpostorAtlas::GRID_SIZE
+#define GRID_SIZE 8
+
+#include "include/frameData.glsl"
+
+// quad point relative to the capture center, in object space
+out vec3 localPosition;
+flat out ivec4 viewIndexes;
+flat out vec4 viewWeights;
+flat out mat3 objectAxes;
+flat out mat3 normalAxes;
+flat out vec4 centerRadius;
+flat out float worldRadius;
+flat out float atlasLayer;
+flat out float fade;
+
+// unit vector onto the square of its octahedron, in -1..1
+vec2 EncodeOctahedral(vec3 n)
+{
+   n /= (abs(n.x) + abs(n.y) + abs(n.z));
+   vec2 folded = n.xz;
+   if (n.y < 0.0)
+   {
+      folded = (vec2(1.0) - abs(n.zx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.z >= 0.0 ? 1.0 : -1.0);
+   }
+   return(folded);
+}
+
+void main()
+{
+   mat3 axes = mat3(inAxisX.xyz, inAxisY.xyz, inAxisZ.xyz);
+   mat3 inverseAxes = inverse(axes);
+   float radius = inCenterRadius.w * max(length(inAxisX.xyz), max(length(inAxisY.xyz), length(inAxisZ.xyz)));
+
+   // triangle strip corners, spanning the sphere as the camera sees it
+   vec2 corner = vec2(float(gl_VertexID & 1), float(gl_VertexID >> 1)) * 2.0 - 1.0;
+   vec3 cameraRight = vec3(view[0][0], view[1][0], view[2][0]);
+   vec3 cameraUp = vec3(view[0][1], view[1][1], view[2][1]);
+   vec3 worldPosition = inCenterRadius.xyz + ((cameraRight * corner.x) + (cameraUp * corner.y)) * radius;
+   gl_Position = projection * view * vec4(worldPosition, 1.0);
+
+   // direction toward the camera in object space; an orthographic
+   // camera sees everything along its own axis
+   vec3 toCamera = (projection[3][3] == 1.0) ?
+      vec3(view[0][2], view[1][2], view[2][2]) : (viewPosition.xyz - inCenterRadius.xyz);
+   vec3 localDirection = normalize(inverseAxes * toCamera);
+
+   // the four views around it and their bilinear weights
+   vec2 grid = (EncodeOctahedral(localDirection) * 0.5 + 0.5) * float(GRID_SIZE - 1);
+   vec2 cell = clamp(floor(grid), vec2(0.0), vec2(float(GRID_SIZE - 2)));
+   vec2 blend = clamp(grid - cell, 0.0, 1.0);
+   int firstView = int(cell.x) + (int(cell.y) * GRID_SIZE);
+   viewIndexes = ivec4(firstView, firstView + 1, firstView + GRID_SIZE, firstView + GRID_SIZE + 1);
+   viewWeights = vec4((1.0 - blend.x) * (1.0 - blend.y), blend.x * (1.0 - blend.y),
+      (1.0 - blend.x) * blend.y, blend.x * blend.y);
+
+   localPosition = inverseAxes * (worldPosition - inCenterRadius.xyz);
+   objectAxes = axes;
+   normalAxes = transpose(inverseAxes);
+   centerRadius = inCenterRadius;
+   worldRadius = radius;
+   atlasLayer = inAxisX.w;
+   fade = inAxisY.w;
+}
@@ -0,0 +1,72 @@
+// cascaded shadow maps of the directional key light (std140, binding 6),
+// see CascadedShadows; included after frameData.glsl, whose view the
+// shadows fade out by
+#ifndef SPIRV_BLOCK
+#define SPIRV_BLOCK(n) layout (std140)
+#endif
+#ifndef SPIRV_LOCATION
+#define SPIRV_LOCATION(n)
+#endif
+
+// capacity of the CascadeData block, must match CascadedShadows::MAX_CASCADES
+#define MAX_SHADOW_CASCADES 4
+
+SPIRV_BLOCK(6) uniform CascadeData
+{
+   mat4 cascadeViewProjection[MAX_SHADOW_CASCADES];
+   vec4 cascadeSplits;        // view depth each cascade reaches
+   int cascadeCount;          // 0 without a key light
+   int cascadeQuality;        // ShadowAtlas::SHADOW_QUALITY, 0 = off
+   float cascadeDepthBias;
+   float cascadeTexelSize;    // of a cascade, in uv
+};
+
+SPIRV_LOCATION(12) uniform sampler2DArrayShadow cascadeShadowMap;
+
+// fraction of the key light reaching a world position, from the finest
+// cascade whose map holds every tap, so views other than the one the
+// cascades were fitted to still find theirs; filtered with more taps at
+// higher quality. The shadows fade out over the last tenth of the depth
+// the cascades reach, so they end without a seam.
+float CalcCascadeShadow(vec3 worldPosition)
+{
+   if ((cascadeCount == 0) || (cascadeQuality == 0))
+   {
+      return(1.0);
+   }
+
+   int filterRadius = cascadeQuality - 1;
+   float margin = cascadeTexelSize * (float(filterRadius) + 1.0);
+   int cascade = 0;
+   vec3 coord = vec3(0.0);
+   for (; cascade < cascadeCount; cascade++)
+   {
+      // orthographic, so w is 1
+      coord = (cascadeViewProjection[cascade] * vec4(worldPosition, 1.0)).xyz * 0.5 + 0.5;
+      if (all(greaterThanEqual(coord.xy, vec2(margin))) && all(lessThanEqual(coord.xy, vec2(1.0 - margin))))
+      {
+         break;
+      }
+   }
+   if (cascade >= cascadeCount)
+   {
+      return(1.0);
+   }
+   float compareDepth = coord.z - cascadeDepthBias;
+
+   float lit = 0.0;
+   for (int y = -filterRadius; y <= filterRadius; y++)
+   {
+      for (int x = -filterRadius; x <= filterRadius; x++)
+      {
+         vec2 tapUV = coord.xy + (vec2(x, y) * cascadeTexelSize);
+         lit += texture(cascadeShadowMap, vec4(tapUV, float(cascade), compareDepth));
+      }
+   }
+   float taps = float(((2 * filterRadius) + 1) * ((2 * filterRadius) + 1));
+
+   float viewDepth = -(view * vec4(worldPosition, 1.0)).z;
+   float reach = cascadeSplits[cascadeCount - 1];
+   float fade = clamp((reach - viewDepth) / (reach * 0.1), 0.0, 1.0);
+   return(mix(1.0, lit / taps, fade));
+}
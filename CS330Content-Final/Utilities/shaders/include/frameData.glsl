@@ -0,0 +1,11 @@
+// per-frame camera data shared by every program (std140, binding 0);
+// shaders built as SPIR-V define SPIRV_BLOCK() to give the binding
+#ifndef SPIRV_BLOCK
+#define SPIRV_BLOCK(n) layout (std140)
+#endif
+SPIRV_BLOCK(0) uniform FrameData
+{
+   mat4 view;
+   mat4 projection;
+   vec4 viewPosition;   // xyz = camera position, w = 1 with reverse-Z depth
+};
@@ -0,0 +1,42 @@
+// material and light records of the MaterialData and LightData blocks,
+// laid out as SceneManager uploads them
+
+struct Material 
+{
+    vec3 ambientColor;
+    float ambientStrength;
+    vec3 diffuseColor;
+    float shininess;
+    vec3 specularColor;
+    float reflectivity;     // share of the reflection probes at normal
+                            // incidence, 0 for none
+}; 
+
+struct LightSource 
+{
+    vec3 position;          // direction towards it when directional
+    float focalStrength;
+    vec3 ambientColor;
+    float specularIntensity;
+    vec3 diffuseColor;
+    float radius;           // reach of the light, 0 for the whole scene,
+                            // negative for a directional light
+    vec3 specularColor;
+    int shadowIndex;        // entry of the ShadowData block, 0 for the
+                            // cascades of a directional light, -1 for none
+    int type;               // LIGHT_TYPE_*, set by SceneManager::UploadLights()
+    float fade;             // 0 to 1 as the light LOD fades it out, scaling
+                            // its attenuation
+};
+
+// terms a light is shaded with, must match SceneManager::LIGHT_TYPE
+#define LIGHT_TYPE_AMBIENT 0    // no direct light, only the ambient term
+#define LIGHT_TYPE_DIFFUSE 1    // direct light without a highlight
+#define LIGHT_TYPE_POINT 2      // direct light with a highlight
+#define LIGHT_TYPE_OFF 3        // faded out by the light LOD, in no cluster
+
+// capacity of the material buffer, must match SceneManager::MAX_MATERIALS
+#define MAX_MATERIALS 32
+
+// capacity of the light buffer, must match SceneManager::MAX_LIGHTS
+#define MAX_LIGHTS 64
@@ -0,0 +1,70 @@
+// reflection probes of the shiny materials (std140, binding 7), see
+// ReflectionProbes; included after lighting.glsl, whose Material gives
+// the reflectivity and shininess
+#ifndef SPIRV_BLOCK
+#define SPIRV_BLOCK(n) layout (std140)
+#endif
+#ifndef SPIRV_LOCATION
+#define SPIRV_LOCATION(n)
+#endif
+
+// capacity of the ProbeData block, must match ReflectionProbes::MAX_PROBES
+#define MAX_REFLECTION_PROBES 8
+
+SPIRV_BLOCK(7) uniform ProbeData
+{
+   vec4 probeSpheres[MAX_REFLECTION_PROBES];   // capture position and reach,
+                                               // 0 reach until captured
+   int probeCount;         // 0 while a probe is being captured
+   float probeLevels;      // prefiltered levels past the sharpest one
+};
+
+SPIRV_LOCATION(13) uniform samplerCubeArray reflectionProbes;
+
+// fraction of its reach over which a probe fades out, so neighbouring
+// probes blend instead of meeting at a seam
+#define PROBE_FADE_FRACTION 0.25
+
+// light the probes around a world position reflect towards the eye,
+// from the level prefiltered for the roughness of the material. The
+// probes holding the position are weighted down towards the edge of
+// their reach and normalized where they overlap; the share reflected
+// rises towards grazing angles, less so on rough surfaces.
+vec3 CalcProbeReflection(vec3 worldPosition, vec3 normal, vec3 viewDirection, Material material)
+{
+   if ((probeCount == 0) || (material.reflectivity <= 0.0))
+   {
+      return(vec3(0.0));
+   }
+
+   // the Phong exponent as a roughness, which picks the level
+   float roughness = sqrt(2.0 / (material.shininess + 2.0));
+   vec4 direction = vec4(reflect(-viewDirection, normal), 0.0);
+   float level = roughness * probeLevels;
+
+   vec3 reflected = vec3(0.0);
+   float weight = 0.0;
+   for (int i = 0; i < probeCount; i++)
+   {
+      vec4 sphere = probeSpheres[i];
+      float fade = sphere.w * PROBE_FADE_FRACTION;
+      float probeWeight = clamp((sphere.w - distance(worldPosition, sphere.xyz)) / max(fade, 0.0001), 0.0, 1.0);
+      if (probeWeight > 0.0)
+      {
+         direction.w = float(i);
+         reflected += textureLod(reflectionProbes, direction, level).rgb * probeWeight;
+         weight += probeWeight;
+      }
+   }
+   if (weight <= 0.0)
+   {
+      return(vec3(0.0));
+   }
+   reflected /= max(weight, 1.0);
+
+   // Schlick's Fresnel term, its grazing share held down by roughness
+   float cosine = clamp(dot(normal, viewDirection), 0.0, 1.0);
+   float grazing = max(1.0 - roughness, material.reflectivity);
+   float fresnel = material.reflectivity + ((grazing - material.reflectivity) * pow(1.0 - cosine, 5.0));
+   return(reflected * fresnel);
+}
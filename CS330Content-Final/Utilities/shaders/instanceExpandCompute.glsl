@@ -0,0 +1,60 @@
+#version 430 core
+// rebuilds the instance data of the frame from the compact records
+// InstanceExpander::Pack() wrote, one invocation per record, into the
+// layout of SceneManager::INSTANCE_DATA the other shaders read
+layout (local_size_x = 64) in;
+
+// InstanceExpander::COMPACT_INSTANCE, three uvec4 per record:
+// (position, scale xy), (rotation xy, rotation zw, scale z, UV scale),
+// (color rg, color ba, material index, texture index)
+layout (std430, binding = 0) readonly buffer CompactInstances
+{
+   uvec4 records[];
+};
+
+// 9 RGBA32F texels per instance: model columns, color, (UV scale,
+// material index, texture index), normal matrix columns
+layout (std430, binding = 1) writeonly buffer InstanceData
+{
+   vec4 texels[];
+};
+
+// record of the first instance in the buffer, and the records
+uniform uint firstRecord;
+uniform uint instanceCount;
+
+void main()
+{
+   uint instance = gl_GlobalInvocationID.x;
+   if (instance >= instanceCount)
+   {
+      return;
+   }
+
+   uint record = (firstRecord + instance) * 3u;
+   uvec4 record0 = records[record];
+   uvec4 record1 = records[record + 1u];
+   uvec4 record2 = records[record + 2u];
+
+   vec3 position = uintBitsToFloat(record0.xyz);
+   vec3 scale = vec3(unpackHalf2x16(record0.w), unpackHalf2x16(record1.z).x);
+   vec4 q = normalize(vec4(unpackSnorm2x16(record1.x), unpackSnorm2x16(record1.y)));
+
+   // columns of the rotation of the unit quaternion
+   mat3 rotation = mat3(
+      1.0 - 2.0 * (q.y * q.y + q.z * q.z), 2.0 * (q.x * q.y + q.w * q.z), 2.0 * (q.x * q.z - q.w * q.y),
+      2.0 * (q.x * q.y - q.w * q.z), 1.0 - 2.0 * (q.x * q.x + q.z * q.z), 2.0 * (q.y * q.z + q.w * q.x),
+      2.0 * (q.x * q.z + q.w * q.y), 2.0 * (q.y * q.z - q.w * q.x), 1.0 - 2.0 * (q.x * q.x + q.y * q.y));
+
+   uint texel = instance * 9u;
+   texels[texel] = vec4(rotation[0] * scale.x, 0.0);
+   texels[texel + 1u] = vec4(rotation[1] * scale.y, 0.0);
+   texels[texel + 2u] = vec4(rotation[2] * scale.z, 0.0);
+   texels[texel + 3u] = vec4(position, 1.0);
+   texels[texel + 4u] = vec4(unpackHalf2x16(record2.x), unpackHalf2x16(record2.y));
+   texels[texel + 5u] = vec4(unpackHalf2x16(record1.w), float(int(record2.z)), float(int(record2.w)));
+   // the inverse transpose of a rotation and scale divides by the scale
+   texels[texel + 6u] = vec4(rotation[0] / scale.x, 0.0);
+   texels[texel + 7u] = vec4(rotation[1] / scale.y, 0.0);
+   texels[texel + 8u] = vec4(rotation[2] / scale.z, 0.0);
+}
@@ -0,0 +1,115 @@
+#version 430 core
+// bins the lights of the LightData block into the clusters of a froxel
+// grid spanning the view frustum; each invocation builds the view space
+// box of one cluster and lists the lights whose sphere touches it
+layout (local_size_x = 64) in;
+
+struct LightSource 
+{
+    vec3 position;	
+    float focalStrength;
+    vec3 ambientColor;
+    float specularIntensity;
+    vec3 diffuseColor;
+    float radius;
+    vec3 specularColor;
+    int shadowIndex;        // entry of the ShadowData block, -1 for none
+    int type;               // LIGHT_TYPE_*, set by SceneManager::UploadLights()
+    float fade;
+};
+
+// must match LIGHT_TYPE_OFF in include/lighting.glsl
+#define LIGHT_TYPE_OFF 3
+
+// must match SceneManager::MAX_LIGHTS and LightClusters::MAX_CLUSTER_LIGHTS
+#define MAX_LIGHTS 64
+#define MAX_CLUSTER_LIGHTS 64
+
+// active light sources (std140, binding 1)
+layout (std140) uniform LightData
+{
+   int lightCount;
+   LightSource lightSources[MAX_LIGHTS];
+};
+
+// grid header, then per cluster a light count and MAX_CLUSTER_LIGHTS indexes
+layout (std430, binding = 2) buffer LightClusters
+{
+   uvec4 gridSize;
+   vec4 sliceParams;    // slice scale, slice bias, viewport width, height
+   uint clusterLights[];
+};
+
+uniform mat4 view;
+uniform mat4 inverseProjection;
+uniform vec2 depthRange;   // near and far distance of the clusters
+
+// view space point of a normalized device xy at a view space distance
+vec3 UnprojectToDepth(vec2 ndc, float viewDepth)
+{
+   vec4 nearPoint = inverseProjection * vec4(ndc, -1.0, 1.0);
+   vec4 farPoint = inverseProjection * vec4(ndc, 1.0, 1.0);
+   nearPoint /= nearPoint.w;
+   farPoint /= farPoint.w;
+
+   float t = (-viewDepth - nearPoint.z) / (farPoint.z - nearPoint.z);
+   return mix(nearPoint.xyz, farPoint.xyz, t);
+}
+
+void main()
+{
+   uint cluster = gl_GlobalInvocationID.x;
+   uint clusterCount = gridSize.x * gridSize.y * gridSize.z;
+   if (cluster >= clusterCount)
+   {
+      return;
+   }
+
+   uvec3 cell = uvec3(
+      cluster % gridSize.x,
+      (cluster / gridSize.x) % gridSize.y,
+      cluster / (gridSize.x * gridSize.y));
+
+   // exponential depth slices, the inverse of the fragment shader lookup
+   float sliceNear = depthRange.x * pow(depthRange.y / depthRange.x, float(cell.z) / float(gridSize.z));
+   float sliceFar = depthRange.x * pow(depthRange.y / depthRange.x, float(cell.z + 1u) / float(gridSize.z));
+   vec2 ndcMin = vec2(cell.xy) / vec2(gridSize.xy) * 2.0 - 1.0;
+   vec2 ndcMax = vec2(cell.xy + uvec2(1u)) / vec2(gridSize.xy) * 2.0 - 1.0;
+
+   vec3 boxMin = vec3(1e30);
+   vec3 boxMax = vec3(-1e30);
+   for (int corner = 0; corner < 8; corner++)
+   {
+      vec2 ndc = vec2(((corner & 1) != 0) ? ndcMax.x : ndcMin.x, ((corner & 2) != 0) ? ndcMax.y : ndcMin.y);
+      vec3 point = UnprojectToDepth(ndc, ((corner & 4) != 0) ? sliceFar : sliceNear);
+      boxMin = min(boxMin, point);
+      boxMax = max(boxMax, point);
+   }
+
+   uint base = cluster * uint(MAX_CLUSTER_LIGHTS + 1);
+   uint count = 0u;
+   for (int i = 0; (i < lightCount) && (count < uint(MAX_CLUSTER_LIGHTS)); i++)
+   {
+      // a light the light LOD faded out reaches none
+      if (lightSources[i].type == LIGHT_TYPE_OFF)
+      {
+         continue;
+      }
+      // a light without radius reaches every cluster
+      float radius = lightSources[i].radius;
+      bool bInside = (radius <= 0.0);
+      if (bInside == false)
+      {
+         vec3 center = vec3(view * vec4(lightSources[i].position, 1.0));
+         vec3 offset = clamp(center, boxMin, boxMax) - center;
+         bInside = (dot(offset, offset) <= radius * radius);
+      }
+
+      if (bInside == true)
+      {
+         clusterLights[base + 1u + count] = uint(i);
+         count++;
+      }
+   }
+   clusterLights[base] = count;
+}
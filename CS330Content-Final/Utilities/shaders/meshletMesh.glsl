@@ -0,0 +1,120 @@
+#version 450
+#extension GL_NV_mesh_shader : require
+// mesh shading path of the meshlet culling: one work group emits one
+// meshlet launched by meshletTask.glsl, with the outputs and the position
+// math of vertexShader.glsl for the fragment shader of the permutation
+layout (local_size_x = 32) in;
+layout (triangles, max_vertices = 64, max_primitives = 124) out;
+
+// MeshOptimizer::MESHLET
+struct Meshlet
+{
+   uint firstIndex;
+   uint triangleCount;
+   uint firstVertex;
+   uint vertexCount;
+   uint firstTriangle;
+   int baseVertex;
+   uint padding0;
+   uint padding1;
+   vec4 sphere;   // xyz center, w radius
+   vec4 cone;     // xyz axis, w cutoff
+};
+
+layout (std430, binding = 0) readonly buffer Meshlets
+{
+   Meshlet meshlets[];
+};
+
+// arena vertex number of every meshlet vertex
+layout (std430, binding = 1) readonly buffer MeshletVertices
+{
+   uint meshletVertices[];
+};
+
+// three byte sized meshlet vertex numbers per triangle
+layout (std430, binding = 2) readonly buffer MeshletTriangles
+{
+   uint meshletTriangles[];
+};
+
+// the full float arena, ShapeMeshes::VERTEX_FLOATS per vertex
+layout (std430, binding = 3) readonly buffer ArenaVertices
+{
+   float arenaVertices[];
+};
+
+taskNV in MeshletTask
+{
+   uint instance;
+   uint meshletIndices[32];
+} task;
+
+out vec3 fragmentPosition[];
+out vec3 fragmentVertexNormal[];
+out vec2 fragmentTextureCoordinate[];
+// the meshlets are never lightmapped, so the weight is always 0
+out vec3 fragmentLightmapCoordinate[];
+
+// the render list always draws with the instancing permutations
+flat out vec4 instanceColor[];
+flat out vec2 instanceUVscale[];
+flat out int instanceMaterialIndex[];
+flat out int instanceTextureIndex[];
+flat out uvec3 instanceLights[];
+
+// per-instance data of the render list as read by vertexShader.glsl;
+// instanceBase is the first instance of the batch drawn
+uniform samplerBuffer instanceData;
+uniform int instanceBase;
+
+#include "include/frameData.glsl"
+
+void main()
+{
+   Meshlet meshlet = meshlets[task.meshletIndices[gl_WorkGroupID.x]];
+
+   int texel = (instanceBase + int(task.instance)) * 9;
+   mat4 model = mat4(
+      texelFetch(instanceData, texel),
+      texelFetch(instanceData, texel + 1),
+      texelFetch(instanceData, texel + 2),
+      texelFetch(instanceData, texel + 3));
+   vec4 color = texelFetch(instanceData, texel + 4);
+   vec4 extra = texelFetch(instanceData, texel + 5);
+   vec4 normalColumn0 = texelFetch(instanceData, texel + 6);
+   vec4 normalColumn1 = texelFetch(instanceData, texel + 7);
+   vec4 normalColumn2 = texelFetch(instanceData, texel + 8);
+   mat3 normalMatrix = mat3(normalColumn0.xyz, normalColumn1.xyz, normalColumn2.xyz);
+   uvec3 lights = uvec3(normalColumn0.w, normalColumn1.w, normalColumn2.w);
+
+   for (uint i = gl_LocalInvocationID.x; i < meshlet.vertexCount; i += 32u)
+   {
+      uint vertex = meshletVertices[meshlet.firstVertex + i] * 8u;
+      vec3 position = vec3(arenaVertices[vertex], arenaVertices[vertex + 1u], arenaVertices[vertex + 2u]);
+
+      fragmentPosition[i] = vec3(model * vec4(position, 1.0));
+      gl_MeshVerticesNV[i].gl_Position = projection * view * model * vec4(position, 1.0f);
+      fragmentVertexNormal[i] = normalMatrix * vec3(arenaVertices[vertex + 3u], arenaVertices[vertex + 4u], arenaVertices[vertex + 5u]);
+      fragmentTextureCoordinate[i] = vec2(arenaVertices[vertex + 6u], arenaVertices[vertex + 7u]);
+      fragmentLightmapCoordinate[i] = vec3(0.0);
+      instanceColor[i] = color;
+      instanceUVscale[i] = extra.xy;
+      instanceMaterialIndex[i] = int(extra.z);
+      instanceTextureIndex[i] = int(extra.w);
+      instanceLights[i] = lights;
+   }
+
+   for (uint i = gl_LocalInvocationID.x; i < meshlet.triangleCount; i += 32u)
+   {
+      uint triangle = meshletTriangles[meshlet.firstTriangle + i];
+      gl_PrimitiveIndicesNV[i * 3u] = triangle & 0xFFu;
+      gl_PrimitiveIndicesNV[i * 3u + 1u] = (triangle >> 8) & 0xFFu;
+      gl_PrimitiveIndicesNV[i * 3u + 2u] = (triangle >> 16) & 0xFFu;
+   }
+
+   if (gl_LocalInvocationID.x == 0u)
+   {
+      gl_PrimitiveCountNV = meshlet.triangleCount;
+   }
+}
@@ -0,0 +1,188 @@
+#version 450
+#extension GL_NV_mesh_shader : require
+// mesh shading path of the meshlet culling: one work group tests 32
+// meshlets of one instance with the tests of meshletCullCompute.glsl and
+// launches a mesh work group for each one that passes
+layout (local_size_x = 32) in;
+
+// MeshOptimizer::MESHLET
+struct Meshlet
+{
+   uint firstIndex;
+   uint triangleCount;
+   uint firstVertex;
+   uint vertexCount;
+   uint firstTriangle;
+   int baseVertex;
+   uint padding0;
+   uint padding1;
+   vec4 sphere;   // xyz center, w radius
+   vec4 cone;     // xyz axis, w cutoff
+};
+
+layout (std430, binding = 0) readonly buffer Meshlets
+{
+   Meshlet meshlets[];
+};
+
+// the instance and meshlets of the mesh work groups launched
+taskNV out MeshletTask
+{
+   uint instance;
+   uint meshletIndices[32];
+} task;
+
+// per-instance data of the render list as read by vertexShader.glsl;
+// instanceBase is the first instance of the batch drawn
+uniform samplerBuffer instanceData;
+uniform int instanceBase;
+
+// the meshlets of the batch, and the task work groups of each instance
+uniform uint firstMeshlet;
+uniform uint meshletCount;
+uniform uint taskGroups;
+
+layout (binding = 17) uniform sampler2D depthPyramid;
+uniform mat4 pyramidViewProjection;
+uniform bool bPyramidValid;
+
+#include "include/frameData.glsl"
+
+// true when the sphere is at least partly inside every frustum plane
+bool IsSphereInFrustum(vec3 center, float radius)
+{
+   mat4 rows = transpose(projection * view);
+   vec4 planes[6] = vec4[6](
+      rows[3] + rows[0], rows[3] - rows[0],
+      rows[3] + rows[1], rows[3] - rows[1],
+      rows[3] + rows[2], rows[3] - rows[2]);
+   for (int i = 0; i < 6; i++)
+   {
+      if (dot(planes[i].xyz, center) + planes[i].w < -radius * length(planes[i].xyz))
+      {
+         return false;
+      }
+   }
+   return true;
+}
+
+// true when the box is at least partly in front of the pyramid depth
+bool IsBoxVisible(vec3 boxMin, vec3 boxMax)
+{
+   vec3 ndcMin = vec3(1.0);
+   vec3 ndcMax = vec3(-1.0);
+   for (int corner = 0; corner < 8; corner++)
+   {
+      vec3 position = vec3(
+         ((corner & 1) != 0) ? boxMax.x : boxMin.x,
+         ((corner & 2) != 0) ? boxMax.y : boxMin.y,
+         ((corner & 4) != 0) ? boxMax.z : boxMin.z);
+      vec4 clip = pyramidViewProjection * vec4(position, 1.0);
+
+      // a box reaching behind the camera cannot be tested
+      if (clip.w <= 0.0)
+      {
+         return true;
+      }
+
+      vec3 ndc = clip.xyz / clip.w;
+      ndcMin = min(ndcMin, ndc);
+      ndcMax = max(ndcMax, ndc);
+   }
+
+   vec2 uvMin = clamp(ndcMin.xy * 0.5 + 0.5, 0.0, 1.0);
+   vec2 uvMax = clamp(ndcMax.xy * 0.5 + 0.5, 0.0, 1.0);
+   // reverse-Z maps the clip depth to 0..1 directly, nearest largest
+   float nearestDepth = (viewPosition.w != 0.0) ? ndcMax.z : (ndcMin.z * 0.5 + 0.5);
+
+   vec2 pyramidSize = vec2(textureSize(depthPyramid, 0));
+   vec2 rectSize = (uvMax - uvMin) * pyramidSize;
+   int maxLevel = textureQueryLevels(depthPyramid) - 1;
+   int level = clamp(int(ceil(log2(max(max(rectSize.x, rectSize.y), 1.0)))), 0, maxLevel);
+
+   ivec2 levelMax = textureSize(depthPyramid, level) - ivec2(1);
+   vec2 levelSize = vec2(levelMax + ivec2(1));
+   ivec2 texelMin = clamp(ivec2(uvMin * levelSize), ivec2(0), levelMax);
+   ivec2 texelMax = clamp(ivec2(uvMax * levelSize), ivec2(0), levelMax);
+
+   vec4 depths = vec4(
+      texelFetch(depthPyramid, texelMin, level).r,
+      texelFetch(depthPyramid, ivec2(texelMax.x, texelMin.y), level).r,
+      texelFetch(depthPyramid, ivec2(texelMin.x, texelMax.y), level).r,
+      texelFetch(depthPyramid, texelMax, level).r);
+   if (viewPosition.w != 0.0)
+   {
+      float farthest = min(min(depths.x, depths.y), min(depths.z, depths.w));
+      return (nearestDepth >= farthest);
+   }
+   float farthest = max(max(depths.x, depths.y), max(depths.z, depths.w));
+   return (nearestDepth <= farthest);
+}
+
+// true unless the meshlet is outside the view, faces away from the
+// camera, or hides behind the previous depth
+bool IsMeshletVisible(Meshlet meshlet, mat4 model)
+{
+   vec3 center = vec3(model * vec4(meshlet.sphere.xyz, 1.0));
+   vec3 scale = vec3(length(model[0].xyz), length(model[1].xyz), length(model[2].xyz));
+   float radius = meshlet.sphere.w * max(max(scale.x, scale.y), scale.z);
+
+   if (IsSphereInFrustum(center, radius) == false)
+   {
+      return false;
+   }
+
+   // the cone only keeps its angle under an even scale, and mirroring
+   // turns the triangles around
+   bool bEvenScale = (max(max(scale.x, scale.y), scale.z) <= 1.01 * min(min(scale.x, scale.y), scale.z));
+   if ((meshlet.cone.w < 1.0) && (bEvenScale == true) && (determinant(mat3(model)) > 0.0))
+   {
+      vec3 axis = normalize(mat3(model) * meshlet.cone.xyz);
+      vec3 toCenter = center - viewPosition.xyz;
+      if (dot(toCenter, axis) >= meshlet.cone.w * length(toCenter) + radius)
+      {
+         return false;
+      }
+   }
+
+   if (bPyramidValid == true)
+   {
+      return IsBoxVisible(center - vec3(radius), center + vec3(radius));
+   }
+   return true;
+}
+
+shared uint visibleCount;
+
+void main()
+{
+   if (gl_LocalInvocationID.x == 0u)
+   {
+      visibleCount = 0u;
+   }
+   barrier();
+
+   uint instance = gl_WorkGroupID.x / taskGroups;
+   uint meshlet = (gl_WorkGroupID.x % taskGroups) * 32u + gl_LocalInvocationID.x;
+
+   int texel = (instanceBase + int(instance)) * 9;
+   mat4 model = mat4(
+      texelFetch(instanceData, texel),
+      texelFetch(instanceData, texel + 1),
+      texelFetch(instanceData, texel + 2),
+      texelFetch(instanceData, texel + 3));
+   bool bVisible = (meshlet < meshletCount) &&
+      IsMeshletVisible(meshlets[firstMeshlet + meshlet], model);
+
+   // the visible meshlets of the group, compacted in any order
+   if (bVisible == true)
+   {
+      task.meshletIndices[atomicAdd(visibleCount, 1u)] = firstMeshlet + meshlet;
+   }
+   barrier();
+   if (gl_LocalInvocationID.x == 0u)
+   {
+      task.instance = instance;
+      gl_TaskCountNV = visibleCount;
+   }
+}
@@ -0,0 +1,21 @@
+#version 330 core
+// bounding box of an object under an occlusion query, see
+// OcclusionQueries::QUERY_BOX; one instance per box, its corners made
+// from gl_VertexID as a single 14 vertex triangle strip
+layout (location = 0) in vec4 inBoxMin;   // world corners, w unused
+layout (location = 1) in vec4 inBoxMax;
+
+#include "include/frameData.glsl"
+
+// corners of the unit cube along the strip
+const vec3 STRIP_CORNERS[14] = vec3[14](
+   vec3(0.0, 1.0, 1.0), vec3(1.0, 1.0, 1.0), vec3(0.0, 0.0, 1.0), vec3(1.0, 0.0, 1.0),
+   vec3(1.0, 0.0, 0.0), vec3(1.0, 1.0, 1.0), vec3(1.0, 1.0, 0.0), vec3(0.0, 1.0, 1.0),
+   vec3(0.0, 1.0, 0.0), vec3(0.0, 0.0, 1.0), vec3(0.0, 0.0, 0.0), vec3(1.0, 0.0, 0.0),
+   vec3(0.0, 1.0, 0.0), vec3(1.0, 1.0, 0.0));
+
+void main()
+{
+   vec3 position = mix(inBoxMin.xyz, inBoxMax.xyz, STRIP_CORNERS[gl_VertexID]);
+   gl_Position = projection * view * vec4(position, 1.0f);
+}
@@ -0,0 +1,95 @@
+#version 430 core
+// tests the bounds of every multi-draw indirect command against the depth
+// pyramid of the previous frame and writes the instance count of the
+// command, zero when the bounds are hidden behind the previous depth
+layout (local_size_x = 64) in;
+
+// two texels per command: (box min, instance count), (box max, unused)
+layout (std430, binding = 0) readonly buffer CommandBounds
+{
+   vec4 commandBounds[];
+};
+
+// ShapeMeshes::INDIRECT_COMMAND, five uints per command
+layout (std430, binding = 1) buffer IndirectCommands
+{
+   uint indirectCommands[];
+};
+
+layout (binding = 17) uniform sampler2D depthPyramid;
+
+// view-projection the depth pyramid was rendered with
+uniform mat4 pyramidViewProjection;
+uniform uint commandCount;
+// true when the pyramid holds reverse-Z depth, 1 at the near plane
+uniform bool bReverseDepth;
+
+// true when the box is at least partly in front of the pyramid depth
+bool IsBoxVisible(vec3 boxMin, vec3 boxMax)
+{
+   vec3 ndcMin = vec3(1.0);
+   vec3 ndcMax = vec3(-1.0);
+   for (int corner = 0; corner < 8; corner++)
+   {
+      vec3 position = vec3(
+         ((corner & 1) != 0) ? boxMax.x : boxMin.x,
+         ((corner & 2) != 0) ? boxMax.y : boxMin.y,
+         ((corner & 4) != 0) ? boxMax.z : boxMin.z);
+      vec4 clip = pyramidViewProjection * vec4(position, 1.0);
+
+      // a box reaching behind the camera cannot be tested
+      if (clip.w <= 0.0)
+      {
+         return true;
+      }
+
+      vec3 ndc = clip.xyz / clip.w;
+      ndcMin = min(ndcMin, ndc);
+      ndcMax = max(ndcMax, ndc);
+   }
+
+   vec2 uvMin = clamp(ndcMin.xy * 0.5 + 0.5, 0.0, 1.0);
+   vec2 uvMax = clamp(ndcMax.xy * 0.5 + 0.5, 0.0, 1.0);
+   // reverse-Z maps the clip depth to 0..1 directly, nearest largest
+   float nearestDepth = bReverseDepth ? ndcMax.z : (ndcMin.z * 0.5 + 0.5);
+
+   // the level at which the screen rectangle spans at most two texels
+   // per axis, so four fetches cover all of it
+   vec2 pyramidSize = vec2(textureSize(depthPyramid, 0));
+   vec2 rectSize = (uvMax - uvMin) * pyramidSize;
+   int maxLevel = textureQueryLevels(depthPyramid) - 1;
+   int level = clamp(int(ceil(log2(max(max(rectSize.x, rectSize.y), 1.0)))), 0, maxLevel);
+
+   ivec2 levelMax = textureSize(depthPyramid, level) - ivec2(1);
+   vec2 levelSize = vec2(levelMax + ivec2(1));
+   ivec2 texelMin = clamp(ivec2(uvMin * levelSize), ivec2(0), levelMax);
+   ivec2 texelMax = clamp(ivec2(uvMax * levelSize), ivec2(0), levelMax);
+
+   vec4 depths = vec4(
+      texelFetch(depthPyramid, texelMin, level).r,
+      texelFetch(depthPyramid, ivec2(texelMax.x, texelMin.y), level).r,
+      texelFetch(depthPyramid, ivec2(texelMin.x, texelMax.y), level).r,
+      texelFetch(depthPyramid, texelMax, level).r);
+   if (bReverseDepth)
+   {
+      float farthest = min(min(depths.x, depths.y), min(depths.z, depths.w));
+      return (nearestDepth >= farthest);
+   }
+   float farthest = max(max(depths.x, depths.y), max(depths.z, depths.w));
+   return (nearestDepth <= farthest);
+}
+
+void main()
+{
+   uint command = gl_GlobalInvocationID.x;
+   if (command >= commandCount)
+   {
+      return;
+   }
+
+   vec4 boundsMin = commandBounds[command * 2u];
+   vec4 boundsMax = commandBounds[command * 2u + 1u];
+   bool bVisible = IsBoxVisible(boundsMin.xyz, boundsMax.xyz);
+
+   indirectCommands[command * 5u + 1u] = bVisible ? uint(boundsMin.w) : 0u;
+}
@@ -0,0 +1,29 @@
+#version 400 core
+// composites the weighted blended transparency targets over the opaque
+// scene, blended with GL_SRC_ALPHA / GL_ONE_MINUS_SRC_ALPHA
+uniform sampler2D accumulationTexture;
+uniform sampler2D revealageTexture;
+
+out vec4 outFragmentColor;
+
+void main()
+{
+   ivec2 coord = ivec2(gl_FragCoord.xy);
+   float revealage = texelFetch(revealageTexture, coord, 0).r;
+
+   // no transparent layer covers this pixel
+   if (revealage >= 1.0)
+   {
+      discard;
+   }
+
+   vec4 accumulation = texelFetch(accumulationTexture, coord, 0);
+   // keep the sum finite where many heavily weighted layers overlap
+   if (isinf(max(max(abs(accumulation.r), abs(accumulation.g)), abs(accumulation.b))))
+   {
+      accumulation.rgb = vec3(accumulation.a);
+   }
+
+   vec3 averageColor = accumulation.rgb / max(accumulation.a, 1e-5);
+   outFragmentColor = vec4(averageColor, 1.0 - revealage);
+}
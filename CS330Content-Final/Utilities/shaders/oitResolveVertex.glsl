@@ -0,0 +1,9 @@
+#version 400 core
+// full screen triangle for the transparency resolve, the deferred
+// lighting pass and the post effects, generated from the
+// vertex index so no vertex buffer is needed
+void main()
+{
+   vec2 position = vec2(float((gl_VertexID << 1) & 2), float(gl_VertexID & 2));
+   gl_Position = vec4(position * 2.0 - 1.0, 0.0, 1.0);
+}
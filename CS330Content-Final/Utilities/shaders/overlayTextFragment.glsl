@@ -0,0 +1,14 @@
+#version 400 core
+// lit font pixels of the stats overlay over a dark backing, blended
+// with GL_SRC_ALPHA / GL_ONE_MINUS_SRC_ALPHA
+uniform sampler2D fontTexture;
+
+in vec2 fontTexel;
+
+out vec4 outFragmentColor;
+
+void main()
+{
+   float coverage = texelFetch(fontTexture, ivec2(fontTexel), 0).r;
+   outFragmentColor = mix(vec4(0.0, 0.0, 0.0, 0.6), vec4(1.0, 1.0, 0.7, 1.0), coverage);
+}
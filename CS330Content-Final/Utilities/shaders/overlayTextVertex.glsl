@@ -0,0 +1,20 @@
+#version 400 core
+// one character of the stats overlay per instance, a quad generated
+// from the vertex index and placed in window pixels from the top left
+layout(location = 0) in uvec4 inGlyph;	// x, y, font column, unused
+
+uniform vec2 viewportSize;
+uniform float glyphScale;
+
+// texel of the font under the vertex, rows counted from the top
+out vec2 fontTexel;
+
+const vec2 GLYPH_CELL = vec2(6.0, 8.0);
+
+void main()
+{
+   vec2 corner = vec2(float(gl_VertexID & 1), float((gl_VertexID >> 1) & 1));
+   vec2 pixel = vec2(inGlyph.xy) + corner * GLYPH_CELL * glyphScale;
+   fontTexel = vec2(float(inGlyph.z) * GLYPH_CELL.x, 0.0) + corner * GLYPH_CELL;
+   gl_Position = vec4(pixel.x / viewportSize.x * 2.0 - 1.0, 1.0 - pixel.y / viewportSize.y * 2.0, 0.0, 1.0);
+}
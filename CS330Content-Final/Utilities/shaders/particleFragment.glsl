@@ -0,0 +1,18 @@
+#version 430 core
+// a round particle fading toward its edge, blended by ParticleSystem
+// over the scene or added to it
+in vec4 particleColor;
+in vec2 quadPosition;
+
+out vec4 outFragmentColor;
+
+void main()
+{
+   float radiusSquared = dot(quadPosition, quadPosition);
+   if (radiusSquared >= 1.0)
+   {
+      discard;
+   }
+   float falloff = 1.0 - radiusSquared;
+   outFragmentColor = vec4(particleColor.rgb, particleColor.a * falloff * falloff);
+}
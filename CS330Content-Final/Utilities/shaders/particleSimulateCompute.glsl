@@ -0,0 +1,200 @@
+#version 430 core
+// the particles of one pool of ParticleSystem, a stage per dispatch:
+// the spawns take particles off the dead list into the current alive
+// list, the prepare stage sizes the simulation by its count, and the
+// simulation moves every alive particle into the other list or back
+// to the dead list
+layout (local_size_x = 64) in;
+
+// ParticleSystem::GPU_EMITTER
+struct Emitter
+{
+   vec4 center;         // w is the turbulence
+   vec4 box;            // w is the life
+   vec4 velocity;       // w is the life jitter
+   vec4 spread;         // w is the drag
+   vec4 acceleration;   // w is the start size
+   vec4 startColor;
+   vec4 endColor;
+   uint firstSpawn;
+   uint spawnCount;
+   float endSize;
+   uint blendMode;
+};
+
+struct Particle
+{
+   vec4 positionAge;
+   vec4 velocityLife;
+   uvec4 info;          // emitter, random state
+};
+
+layout (std430, binding = 0) readonly buffer Emitters
+{
+   Emitter emitters[];
+};
+
+layout (std430, binding = 1) buffer Particles
+{
+   Particle particles[];
+};
+
+layout (std430, binding = 2) buffer DeadList
+{
+   uint deadList[];
+};
+
+// two lists of capacity entries each
+layout (std430, binding = 3) buffer AliveLists
+{
+   uint aliveLists[];
+};
+
+// a draw command per alive list, its instance count the list's
+// count, the dispatch of the simulation and the dead count
+layout (std430, binding = 4) buffer Counters
+{
+   uint counters[];
+};
+
+uniform int stage;
+uniform uint pool;
+uniform uint capacity;
+uniform uint current;
+uniform uint spawnTotal;
+uniform uint emitterCount;
+uniform uint seed;
+uniform float step;
+uniform float time;
+
+const int STAGE_EMIT = 0;
+const int STAGE_PREPARE = 1;
+const int STAGE_SIMULATE = 2;
+const uint COUNTER_DISPATCH = 8u;
+const uint COUNTER_DEAD = 11u;
+
+// instance count of the draw command of an alive list
+uint CountIndex(uint list)
+{
+   return list * 4u + 1u;
+}
+
+// PCG hash of a random state
+uint Hash(uint value)
+{
+   uint state = value * 747796405u + 2891336453u;
+   uint word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+   return (word >> 22u) ^ word;
+}
+
+// -1..1 on each axis, advancing the state
+vec3 RandomSigned(inout uint state)
+{
+   vec3 value;
+   state = Hash(state);
+   value.x = float(state) / 4294967295.0;
+   state = Hash(state);
+   value.y = float(state) / 4294967295.0;
+   state = Hash(state);
+   value.z = float(state) / 4294967295.0;
+   return value * 2.0 - 1.0;
+}
+
+void Emit(uint spawn)
+{
+   uint e = 0u;
+   while ((e < emitterCount) && ((emitters[e].blendMode != pool) ||
+      (spawn < emitters[e].firstSpawn) || (spawn >= emitters[e].firstSpawn + emitters[e].spawnCount)))
+   {
+      e++;
+   }
+   if (e >= emitterCount)
+   {
+      return;
+   }
+
+   // a count that was already 0 is put back, as is one another
+   // spawn took below 0 before it was
+   uint available = atomicAdd(counters[COUNTER_DEAD], 0xFFFFFFFFu);
+   if ((available == 0u) || (available > capacity))
+   {
+      atomicAdd(counters[COUNTER_DEAD], 1u);
+      return;
+   }
+   uint index = deadList[available - 1u];
+
+   Emitter emitter = emitters[e];
+   uint state = Hash(seed ^ Hash(spawn));
+   vec3 position = emitter.center.xyz + emitter.box.xyz * RandomSigned(state);
+   vec3 jitter = RandomSigned(state);
+   vec3 velocity = emitter.velocity.xyz + emitter.spread.xyz * jitter;
+   float life = max(emitter.box.w + emitter.velocity.w * jitter.x, 0.01);
+   particles[index].positionAge = vec4(position, 0.0);
+   particles[index].velocityLife = vec4(velocity, life);
+   particles[index].info = uvec4(e, state, 0u, 0u);
+
+   uint slot = atomicAdd(counters[CountIndex(current)], 1u);
+   aliveLists[current * capacity + slot] = index;
+}
+
+void Prepare()
+{
+   counters[COUNTER_DISPATCH] = (counters[CountIndex(current)] + 63u) / 64u;
+   counters[CountIndex(1u - current)] = 0u;
+}
+
+void Simulate(uint slot)
+{
+   if (slot >= counters[CountIndex(current)])
+   {
+      return;
+   }
+   uint index = aliveLists[current * capacity + slot];
+   Particle particle = particles[index];
+   float age = particle.positionAge.w + step;
+   if (age >= particle.velocityLife.w)
+   {
+      uint dead = atomicAdd(counters[COUNTER_DEAD], 1u);
+      deadList[dead] = index;
+      return;
+   }
+
+   Emitter emitter = emitters[particle.info.x];
+   vec3 position = particle.positionAge.xyz;
+   vec3 velocity = particle.velocityLife.xyz + emitter.acceleration.xyz * step;
+   velocity /= 1.0 + emitter.spread.w * step;
+   // a swirl varying over space and time, out of phase for each
+   // particle, for steam and drifting dust
+   float phase = float(particle.info.y & 1023u) * 0.0061;
+   vec3 swirl = sin(position.yzx * 3.1 + vec3(1.3, 1.7, 1.1) * time + phase);
+   velocity += swirl * emitter.center.w * step;
+   position += velocity * step;
+
+   particles[index].positionAge = vec4(position, age);
+   particles[index].velocityLife.xyz = velocity;
+   uint next = atomicAdd(counters[CountIndex(1u - current)], 1u);
+   aliveLists[(1u - current) * capacity + next] = index;
+}
+
+void main()
+{
+   uint id = gl_GlobalInvocationID.x;
+   if (stage == STAGE_EMIT)
+   {
+      if (id < spawnTotal)
+      {
+         Emit(id);
+      }
+   }
+   else if (stage == STAGE_PREPARE)
+   {
+      if (id == 0u)
+      {
+         Prepare();
+      }
+   }
+   else
+   {
+      Simulate(id);
+   }
+}
@@ -0,0 +1,87 @@
+#version 430 core
+// bitonic sort of the alive list of a ParticleSystem pool, back to
+// front: the key stage writes the distance and index of each alive
+// particle and keys below every distance past the count, and each
+// merge stage compares the pairs stride apart within blocks of keys,
+// ordered far to near over the whole list
+layout (local_size_x = 64) in;
+
+#include "include/frameData.glsl"
+
+struct Particle
+{
+   vec4 positionAge;
+   vec4 velocityLife;
+   uvec4 info;
+};
+
+layout (std430, binding = 1) readonly buffer Particles
+{
+   Particle particles[];
+};
+
+layout (std430, binding = 3) readonly buffer AliveLists
+{
+   uint aliveLists[];
+};
+
+layout (std430, binding = 4) readonly buffer Counters
+{
+   uint counters[];
+};
+
+// (distance bits, particle index)
+layout (std430, binding = 5) buffer SortKeys
+{
+   uvec2 sortKeys[];
+};
+
+uniform int stage;
+uniform uint capacity;
+uniform uint current;
+uniform uint sortSize;
+uniform uint block;
+uniform uint stride;
+
+const int STAGE_KEYS = 0;
+
+void main()
+{
+   uint id = gl_GlobalInvocationID.x;
+   if (stage == STAGE_KEYS)
+   {
+      if (id >= sortSize)
+      {
+         return;
+      }
+      // positive floats order as their bits do; 0 is below them all
+      uvec2 key = uvec2(0u, 0u);
+      if (id < counters[current * 4u + 1u])
+      {
+         uint index = aliveLists[current * capacity + id];
+         vec3 position = particles[index].positionAge.xyz;
+         // an orthographic camera sorts along its own axis
+         float depth = (projection[3][3] == 1.0) ?
+            -(view * vec4(position, 1.0)).z : distance(viewPosition.xyz, position);
+         key = uvec2(floatBitsToUint(max(depth, 1.0e-6)), index);
+      }
+      sortKeys[id] = key;
+      return;
+   }
+
+   if (id >= sortSize / 2u)
+   {
+      return;
+   }
+   uint low = id & (stride - 1u);
+   uint first = ((id - low) << 1u) + low;
+   uint second = first + stride;
+   bool bDescending = ((first & block) == 0u);
+   uvec2 a = sortKeys[first];
+   uvec2 b = sortKeys[second];
+   if ((a.x < b.x) == bDescending)
+   {
+      sortKeys[first] = b;
+      sortKeys[second] = a;
+   }
+}
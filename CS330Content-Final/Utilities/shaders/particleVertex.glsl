@@ -0,0 +1,76 @@
+#version 430 core
+// one camera facing quad per alive particle of a ParticleSystem pool,
+// the particle taken from the alive list, or from the sorted keys of
+// a blended pool, by the instance
+
+#include "include/frameData.glsl"
+
+// ParticleSystem::GPU_EMITTER
+struct Emitter
+{
+   vec4 center;
+   vec4 box;
+   vec4 velocity;
+   vec4 spread;
+   vec4 acceleration;   // w is the start size
+   vec4 startColor;
+   vec4 endColor;
+   uint firstSpawn;
+   uint spawnCount;
+   float endSize;
+   uint blendMode;
+};
+
+struct Particle
+{
+   vec4 positionAge;
+   vec4 velocityLife;
+   uvec4 info;          // emitter, random state
+};
+
+layout (std430, binding = 0) readonly buffer Emitters
+{
+   Emitter emitters[];
+};
+
+layout (std430, binding = 1) readonly buffer Particles
+{
+   Particle particles[];
+};
+
+layout (std430, binding = 3) readonly buffer AliveLists
+{
+   uint aliveLists[];
+};
+
+layout (std430, binding = 5) readonly buffer SortKeys
+{
+   uvec2 sortKeys[];
+};
+
+uniform uint capacity;
+uniform uint current;
+// 1 reads the sorted keys instead of the alive list
+uniform int sorted;
+
+out vec4 particleColor;
+// -1..1 across the quad
+out vec2 quadPosition;
+
+void main()
+{
+   uint index = (sorted != 0) ? sortKeys[gl_InstanceID].y : aliveLists[current * capacity + uint(gl_InstanceID)];
+   Particle particle = particles[index];
+   Emitter emitter = emitters[particle.info.x];
+   float lifeFraction = clamp(particle.positionAge.w / particle.velocityLife.w, 0.0, 1.0);
+   float size = mix(emitter.acceleration.w, emitter.endSize, lifeFraction);
+   particleColor = mix(emitter.startColor, emitter.endColor, lifeFraction);
+
+   // triangle strip corners, spanning the particle as the camera sees it
+   quadPosition = vec2(float(gl_VertexID & 1), float(gl_VertexID >> 1)) * 2.0 - 1.0;
+   vec3 cameraRight = vec3(view[0][0], view[1][0], view[2][0]);
+   vec3 cameraUp = vec3(view[0][1], view[1][1], view[2][1]);
+   vec3 worldPosition = particle.positionAge.xyz +
+      ((cameraRight * quadPosition.x) + (cameraUp * quadPosition.y)) * (size * 0.5);
+   gl_Position = projection * view * vec4(worldPosition, 1.0);
+}
@@ -0,0 +1,11 @@
+#version 330 core
+// the object ID pass writes the ID of the nearest instance, 0 where
+// nothing was drawn
+flat in int objectID;
+
+layout (location = 0) out uint outObjectID;
+
+void main()
+{
+   outObjectID = uint(objectID);
+}
@@ -0,0 +1,31 @@
+#version 330 core
+// vertex shader of the object ID pass; the instance fetch and position
+// math follow depthPrepassVertex.glsl, with the picked region of the
+// view stretched over the small ID target
+layout (location = 0) in vec3 inVertexPosition;
+
+// model matrices of the render list, SceneManager::INSTANCE_DATA as
+// 9 RGBA32F texels of which the first four are read here
+uniform samplerBuffer instanceData;
+uniform int instanceBase = 0;
+// ID of the first instance of the draw, its submission index + 1
+uniform int firstID = 1;
+// maps the picked region of clip space onto the whole target
+uniform mat4 pickRegion;
+
+#include "include/frameData.glsl"
+
+flat out int objectID;
+
+void main()
+{
+   int texel = (instanceBase + gl_InstanceID) * 9;
+   mat4 model = mat4(
+      texelFetch(instanceData, texel),
+      texelFetch(instanceData, texel + 1),
+      texelFetch(instanceData, texel + 2),
+      texelFetch(instanceData, texel + 3));
+
+   objectID = firstID + gl_InstanceID;
+   gl_Position = pickRegion * projection * view * model * vec4(inVertexPosition, 1.0f);
+}
@@ -0,0 +1,63 @@
+#version 400 core
+// bloom at a fraction of the frame size: stage 0 keeps what is brighter
+// than the threshold of the downsampled frame, stage 1 blurs along one
+// axis with bilinear taps, each covering two texels
+uniform sampler2D colorTexture;
+uniform sampler2D bloomTexture;
+uniform int bloomStage;
+uniform float threshold;
+uniform float sourceScale;
+uniform vec2 blurDirection;
+uniform int tapCount;
+
+out vec4 outFragmentColor;
+
+// gaussian weights and offsets folded into bilinear taps, for 5 and 9
+// texels
+const float WEIGHTS_3[2] = float[2](0.2941176, 0.3529412);
+const float OFFSETS_3[2] = float[2](0.0, 1.3333333);
+const float WEIGHTS_5[3] = float[3](0.2270270, 0.3162162, 0.0702703);
+const float OFFSETS_5[3] = float[3](0.0, 1.3846154, 3.2307692);
+
+void main()
+{
+   if (bloomStage == 0)
+   {
+      // four bilinear taps cover the block of frame texels under the
+      // pixel
+      vec2 texelSize = 1.0 / vec2(textureSize(colorTexture, 0));
+      vec2 uv = gl_FragCoord.xy * sourceScale * texelSize;
+      float offset = sourceScale * 0.25;
+      vec3 color = texture(colorTexture, uv + vec2(-offset, -offset) * texelSize).rgb;
+      color += texture(colorTexture, uv + vec2(offset, -offset) * texelSize).rgb;
+      color += texture(colorTexture, uv + vec2(-offset, offset) * texelSize).rgb;
+      color += texture(colorTexture, uv + vec2(offset, offset) * texelSize).rgb;
+      color *= 0.25;
+
+      float brightness = max(max(color.r, color.g), color.b);
+      float contribution = max(brightness - threshold, 0.0) / max(brightness, 1e-4);
+      outFragmentColor = vec4(color * contribution, 1.0);
+      return;
+   }
+
+   vec2 texelSize = 1.0 / vec2(textureSize(bloomTexture, 0));
+   vec2 uv = gl_FragCoord.xy * texelSize;
+   vec2 direction = blurDirection * texelSize;
+   vec3 color;
+   if (tapCount <= 3)
+   {
+      color = texture(bloomTexture, uv).rgb * WEIGHTS_3[0];
+      color += texture(bloomTexture, uv + direction * OFFSETS_3[1]).rgb * WEIGHTS_3[1];
+      color += texture(bloomTexture, uv - direction * OFFSETS_3[1]).rgb * WEIGHTS_3[1];
+   }
+   else
+   {
+      color = texture(bloomTexture, uv).rgb * WEIGHTS_5[0];
+      for (int i = 1; i < 3; i++)
+      {
+         color += texture(bloomTexture, uv + direction * OFFSETS_5[i]).rgb * WEIGHTS_5[i];
+         color += texture(bloomTexture, uv - direction * OFFSETS_5[i]).rgb * WEIGHTS_5[i];
+      }
+   }
+   outFragmentColor = vec4(color, 1.0);
+}
@@ -0,0 +1,88 @@
+#version 400 core
+// combines the frame with the occlusion and the bloom and tone maps it.
+// The occlusion is brought up to the frame size from its four nearest
+// texels, each weighed by how close its view depth is to the pixel's
+uniform sampler2D colorTexture;
+uniform sampler2D depthTexture;
+uniform sampler2D occlusionTexture;
+uniform sampler2D bloomTexture;
+uniform mat4 inverseProjection;
+uniform int occlusionEnabled;
+uniform int occlusionDivisor;
+uniform float bloomStrength;
+uniform int toneMapper;
+uniform float exposure;
+uniform int lumaInAlpha;
+
+out vec4 outFragmentColor;
+
+#include "include/frameData.glsl"
+
+float ViewDepthAt(ivec2 coord, ivec2 size)
+{
+   float depth = texelFetch(depthTexture, coord, 0).r;
+   vec2 ndc = (vec2(coord) + 0.5) / vec2(size) * 2.0 - 1.0;
+   // reverse-Z clips depth to 0..1, which is the window depth as is
+   float ndcDepth = (viewPosition.w != 0.0) ? depth : (depth * 2.0 - 1.0);
+   vec4 position = inverseProjection * vec4(ndc, ndcDepth, 1.0);
+   return -position.z / position.w;
+}
+
+float UpsampleOcclusion(ivec2 coord, ivec2 size)
+{
+   ivec2 lowSize = textureSize(occlusionTexture, 0);
+   vec2 lowPosition = (vec2(coord) + 0.5) / float(occlusionDivisor) - 0.5;
+   ivec2 base = ivec2(floor(lowPosition));
+   vec2 f = fract(lowPosition);
+   float depth = ViewDepthAt(coord, size);
+
+   float occlusion = 0.0;
+   float weightSum = 0.0;
+   for (int i = 0; i < 4; i++)
+   {
+      ivec2 offset = ivec2(i & 1, i >> 1);
+      vec2 texel = texelFetch(occlusionTexture, clamp(base + offset, ivec2(0), lowSize - 1), 0).rg;
+      float bilinear = ((offset.x == 1) ? f.x : 1.0 - f.x) * ((offset.y == 1) ? f.y : 1.0 - f.y);
+      float weight = (bilinear + 1e-3) / (1e-3 + abs(texel.g - depth));
+      occlusion += texel.r * weight;
+      weightSum += weight;
+   }
+   return occlusion / weightSum;
+}
+
+vec3 ToneMapACES(vec3 color)
+{
+   // Narkowicz's fit of the ACES filmic curve
+   return clamp((color * (2.51 * color + 0.03)) / (color * (2.43 * color + 0.59) + 0.14), 0.0, 1.0);
+}
+
+void main()
+{
+   ivec2 size = textureSize(colorTexture, 0);
+   ivec2 coord = ivec2(gl_FragCoord.xy);
+   vec3 color = texelFetch(colorTexture, coord, 0).rgb;
+
+   if (occlusionEnabled != 0)
+   {
+      color *= UpsampleOcclusion(coord, size);
+   }
+   if (bloomStrength > 0.0)
+   {
+      color += texture(bloomTexture, (vec2(coord) + 0.5) / vec2(size)).rgb * bloomStrength;
+   }
+
+   color *= exposure;
+   if (toneMapper == 1)
+   {
+      color = color / (1.0 + color);
+   }
+   else if (toneMapper == 2)
+   {
+      color = ToneMapACES(color);
+   }
+   color = clamp(color, 0.0, 1.0);
+
+   // FXAA finds its edges from the luma kept in alpha
+   float alpha = (lumaInAlpha != 0) ? dot(color, vec3(0.299, 0.587, 0.114)) : 1.0;
+   outFragmentColor = vec4(color, alpha);
+}
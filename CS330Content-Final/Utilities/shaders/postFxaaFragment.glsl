@@ -0,0 +1,140 @@
+#version 400 core
+// FXAA on the tone mapped frame, after Lottes: finds the edge through
+// the pixel from the luma of its neighbors, searches along it for its
+// ends, and samples the frame shifted toward the far side of the edge
+uniform sampler2D colorTexture;
+uniform int searchSteps;
+
+out vec4 outFragmentColor;
+
+// contrast below which a pixel is left alone, absolute and relative
+const float EDGE_THRESHOLD_MIN = 0.0312;
+const float EDGE_THRESHOLD = 0.125;
+const float SUBPIXEL_QUALITY = 0.75;
+
+float LumaAt(vec2 uv)
+{
+   return texture(colorTexture, uv).a;
+}
+
+float LumaAt(vec2 uv, ivec2 offset)
+{
+   return textureLodOffset(colorTexture, uv, 0.0, offset).a;
+}
+
+void main()
+{
+   vec2 texelSize = 1.0 / vec2(textureSize(colorTexture, 0));
+   vec2 uv = gl_FragCoord.xy * texelSize;
+   vec4 center = texture(colorTexture, uv);
+
+   float lumaM = center.a;
+   float lumaN = LumaAt(uv, ivec2(0, 1));
+   float lumaS = LumaAt(uv, ivec2(0, -1));
+   float lumaE = LumaAt(uv, ivec2(1, 0));
+   float lumaW = LumaAt(uv, ivec2(-1, 0));
+   float lumaMin = min(lumaM, min(min(lumaN, lumaS), min(lumaE, lumaW)));
+   float lumaMax = max(lumaM, max(max(lumaN, lumaS), max(lumaE, lumaW)));
+   float lumaRange = lumaMax - lumaMin;
+   if (lumaRange < max(EDGE_THRESHOLD_MIN, lumaMax * EDGE_THRESHOLD))
+   {
+      outFragmentColor = vec4(center.rgb, 1.0);
+      return;
+   }
+
+   float lumaNW = LumaAt(uv, ivec2(-1, 1));
+   float lumaNE = LumaAt(uv, ivec2(1, 1));
+   float lumaSW = LumaAt(uv, ivec2(-1, -1));
+   float lumaSE = LumaAt(uv, ivec2(1, -1));
+
+   // the edge runs along the axis the luma changes least across
+   float edgeHorizontal = abs(lumaN + lumaS - 2.0 * lumaM) * 2.0 +
+      abs(lumaNE + lumaSE - 2.0 * lumaE) + abs(lumaNW + lumaSW - 2.0 * lumaW);
+   float edgeVertical = abs(lumaE + lumaW - 2.0 * lumaM) * 2.0 +
+      abs(lumaNE + lumaNW - 2.0 * lumaN) + abs(lumaSE + lumaSW - 2.0 * lumaS);
+   bool bHorizontal = (edgeHorizontal >= edgeVertical);
+
+   // the side of the pixel the edge lies on
+   float luma1 = bHorizontal ? lumaS : lumaW;
+   float luma2 = bHorizontal ? lumaN : lumaE;
+   float gradient1 = luma1 - lumaM;
+   float gradient2 = luma2 - lumaM;
+   bool bSteepest1 = (abs(gradient1) >= abs(gradient2));
+   float gradientScaled = 0.25 * max(abs(gradient1), abs(gradient2));
+   float stepLength = bHorizontal ? texelSize.y : texelSize.x;
+   float lumaLocalAverage;
+   if (bSteepest1)
+   {
+      stepLength = -stepLength;
+      lumaLocalAverage = 0.5 * (luma1 + lumaM);
+   }
+   else
+   {
+      lumaLocalAverage = 0.5 * (luma2 + lumaM);
+   }
+
+   // search both ways along the edge, half a texel onto it
+   vec2 edgeUv = uv;
+   if (bHorizontal)
+   {
+      edgeUv.y += stepLength * 0.5;
+   }
+   else
+   {
+      edgeUv.x += stepLength * 0.5;
+   }
+   vec2 offset = bHorizontal ? vec2(texelSize.x, 0.0) : vec2(0.0, texelSize.y);
+   vec2 uv1 = edgeUv - offset;
+   vec2 uv2 = edgeUv + offset;
+   float lumaEnd1 = LumaAt(uv1) - lumaLocalAverage;
+   float lumaEnd2 = LumaAt(uv2) - lumaLocalAverage;
+   bool bReached1 = (abs(lumaEnd1) >= gradientScaled);
+   bool bReached2 = (abs(lumaEnd2) >= gradientScaled);
+   for (int i = 0; (i < searchSteps) && !(bReached1 && bReached2); i++)
+   {
+      // longer steps the further the search gets
+      float stride = (i < 3) ? 1.0 : ((i < 6) ? 2.0 : 4.0);
+      if (!bReached1)
+      {
+         uv1 -= offset * stride;
+         lumaEnd1 = LumaAt(uv1) - lumaLocalAverage;
+         bReached1 = (abs(lumaEnd1) >= gradientScaled);
+      }
+      if (!bReached2)
+      {
+         uv2 += offset * stride;
+         lumaEnd2 = LumaAt(uv2) - lumaLocalAverage;
+         bReached2 = (abs(lumaEnd2) >= gradientScaled);
+      }
+   }
+
+   float distance1 = bHorizontal ? (uv.x - uv1.x) : (uv.y - uv1.y);
+   float distance2 = bHorizontal ? (uv2.x - uv.x) : (uv2.y - uv.y);
+   bool bDirection1 = (distance1 < distance2);
+   float distanceFinal = min(distance1, distance2);
+   float edgeLength = distance1 + distance2;
+   float pixelOffset = -distanceFinal / edgeLength + 0.5;
+
+   // only shift when the nearer end changes luma the other way than
+   // the pixel does
+   bool bCenterSmaller = (lumaM < lumaLocalAverage);
+   bool bCorrectVariation = (((bDirection1 ? lumaEnd1 : lumaEnd2) < 0.0) != bCenterSmaller);
+   float finalOffset = bCorrectVariation ? pixelOffset : 0.0;
+
+   // thin features shorter than a pixel, from the 3 by 3 average
+   float lumaAverage = (1.0 / 12.0) * (2.0 * (lumaN + lumaS + lumaE + lumaW) + lumaNW + lumaNE + lumaSW + lumaSE);
+   float subPixel = clamp(abs(lumaAverage - lumaM) / lumaRange, 0.0, 1.0);
+   subPixel = (-2.0 * subPixel + 3.0) * subPixel * subPixel;
+   finalOffset = max(finalOffset, subPixel * subPixel * SUBPIXEL_QUALITY);
+
+   vec2 finalUv = uv;
+   if (bHorizontal)
+   {
+      finalUv.y += finalOffset * stepLength;
+   }
+   else
+   {
+      finalUv.x += finalOffset * stepLength;
+   }
+   outFragmentColor = vec4(texture(colorTexture, finalUv).rgb, 1.0);
+}
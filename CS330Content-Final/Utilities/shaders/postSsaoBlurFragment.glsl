@@ -0,0 +1,33 @@
+#version 400 core
+// blurs the occlusion at its own size, leaving out neighbors whose view
+// depth is far from the pixel's so the occlusion stays on its surface
+uniform sampler2D occlusionTexture;
+uniform int blurRadius;
+
+out vec2 outOcclusion;
+
+// share of the view depth a neighbor may differ by and still count
+const float DEPTH_TOLERANCE = 0.1;
+
+void main()
+{
+   ivec2 size = textureSize(occlusionTexture, 0);
+   ivec2 coord = ivec2(gl_FragCoord.xy);
+   vec2 center = texelFetch(occlusionTexture, coord, 0).rg;
+
+   float occlusion = 0.0;
+   float weightSum = 0.0;
+   for (int y = -blurRadius; y <= blurRadius; y++)
+   {
+      for (int x = -blurRadius; x <= blurRadius; x++)
+      {
+         vec2 neighbor = texelFetch(occlusionTexture, clamp(coord + ivec2(x, y), ivec2(0), size - 1), 0).rg;
+         float weight = max(1.0 - abs(neighbor.g - center.g) / (DEPTH_TOLERANCE * center.g), 0.0);
+         occlusion += neighbor.r * weight;
+         weightSum += weight;
+      }
+   }
+
+   // the center always weighs 1, so the sum is never 0
+   outOcclusion = vec2(occlusion / weightSum, center.g);
+}
@@ -0,0 +1,136 @@
+#version 400 core
+// screen space ambient occlusion at a fraction of the frame size;
+// writes the occlusion and the view depth of the pixel, which the blur
+// and the upsampling weigh their neighbors by, and the frames since the
+// occlusion was computed. A pixel reprojected onto the same surface of
+// the last frame keeps its occlusion until its turn to be recomputed
+uniform sampler2D depthTexture;
+uniform sampler2D occlusionHistory;
+uniform mat4 inverseProjection;
+uniform int resolutionDivisor;
+uniform int sampleCount;
+uniform float radius;
+// view of this frame back to the world, and the view and view
+// projection of the frame the history was written in
+uniform mat4 inverseView;
+uniform mat4 previousView;
+uniform mat4 previousViewProjection;
+uniform int historyValid;
+// frames a pixel keeps its occlusion for, 0 to compute every pixel
+// every frame
+uniform int cacheFrames;
+uniform int frameIndex;
+// texels the pixel may have moved since the last frame
+uniform float maxMotion;
+
+out vec4 outOcclusion;
+
+#include "include/frameData.glsl"
+
+const float BIAS = 0.02;
+const float GOLDEN_ANGLE = 2.39996323;
+// view depth written where nothing was drawn, within half float range
+const float FAR_DEPTH = 65000.0;
+// share of the view depth the history may differ by and still be the
+// same surface
+const float DEPTH_TOLERANCE = 0.05;
+// pixels along each side of the blocks recomputed together, so the
+// pixels skipping the samples run side by side
+const int CACHE_TILE = 8;
+
+bool IsBackground(float depth)
+{
+   // reverse-Z clears the depth to 0, the usual depth to 1
+   return (viewPosition.w != 0.0) ? (depth <= 0.0) : (depth >= 1.0);
+}
+
+vec3 ViewPositionAt(ivec2 coord, ivec2 size)
+{
+   coord = clamp(coord, ivec2(0), size - 1);
+   float depth = texelFetch(depthTexture, coord, 0).r;
+   vec2 ndc = (vec2(coord) + 0.5) / vec2(size) * 2.0 - 1.0;
+   // reverse-Z clips depth to 0..1, which is the window depth as is
+   float ndcDepth = (viewPosition.w != 0.0) ? depth : (depth * 2.0 - 1.0);
+   vec4 position = inverseProjection * vec4(ndc, ndcDepth, 1.0);
+   return position.xyz / position.w;
+}
+
+void main()
+{
+   ivec2 size = textureSize(depthTexture, 0);
+   ivec2 coord = ivec2(gl_FragCoord.xy) * resolutionDivisor;
+   if (IsBackground(texelFetch(depthTexture, min(coord, size - 1), 0).r))
+   {
+      outOcclusion = vec4(1.0, FAR_DEPTH, 0.0, 0.0);
+      return;
+   }
+   vec3 position = ViewPositionAt(coord, size);
+
+   // the occlusion of the last frame where the pixel lands on the same
+   // surface, barely moved, and its block is not due this frame; the
+   // pixels newly uncovered fail the depth and are computed
+   if ((historyValid != 0) && (cacheFrames > 0))
+   {
+      vec4 world = inverseView * vec4(position, 1.0);
+      vec4 previousClip = previousViewProjection * world;
+      vec2 previousUV = previousClip.xy / previousClip.w * 0.5 + 0.5;
+      vec2 historyPixel = previousUV * vec2(textureSize(occlusionHistory, 0));
+      if ((previousClip.w > 0.0) && all(greaterThanEqual(previousUV, vec2(0.0))) && all(lessThan(previousUV, vec2(1.0))))
+      {
+         vec4 history = texelFetch(occlusionHistory, ivec2(historyPixel), 0);
+         float previousDepth = -(previousView * world).z;
+         ivec2 tile = ivec2(gl_FragCoord.xy) / CACHE_TILE;
+         bool bSameSurface = abs(history.g - previousDepth) < DEPTH_TOLERANCE * previousDepth;
+         bool bStill = distance(historyPixel, gl_FragCoord.xy) < maxMotion;
+         bool bDue = (((tile.x + tile.y * 3 + frameIndex) % cacheFrames) == 0) || (history.b >= float(cacheFrames));
+         if (bSameSurface && bStill && !bDue)
+         {
+            outOcclusion = vec4(history.r, -position.z, history.b + 1.0, 0.0);
+            return;
+         }
+      }
+   }
+
+   // the normal from the neighbors on the flatter side of each axis,
+   // so it does not bend across a silhouette
+   vec3 right = ViewPositionAt(coord + ivec2(1, 0), size) - position;
+   vec3 left = position - ViewPositionAt(coord - ivec2(1, 0), size);
+   vec3 up = ViewPositionAt(coord + ivec2(0, 1), size) - position;
+   vec3 down = position - ViewPositionAt(coord - ivec2(0, 1), size);
+   vec3 dx = (abs(right.z) < abs(left.z)) ? right : left;
+   vec3 dy = (abs(up.z) < abs(down.z)) ? up : down;
+   vec3 normal = normalize(cross(dx, dy));
+
+   // interleaved gradient noise rotates the pattern per pixel, which
+   // the blur then smooths out
+   float noise = fract(52.9829189 * fract(dot(gl_FragCoord.xy, vec2(0.06711056, 0.00583715))));
+   vec3 tangent = normalize(abs(normal.z) < 0.999 ? cross(normal, vec3(0.0, 0.0, 1.0)) : cross(normal, vec3(1.0, 0.0, 0.0)));
+   vec3 bitangent = cross(normal, tangent);
+
+   float occlusion = 0.0;
+   for (int i = 0; i < sampleCount; i++)
+   {
+      // cosine weighted directions of a golden angle spiral, the
+      // nearer samples denser
+      float fraction = (float(i) + 0.5) / float(sampleCount);
+      float angle = float(i) * GOLDEN_ANGLE + noise * 6.2831853;
+      float diskRadius = sqrt(fraction);
+      vec3 direction = vec3(cos(angle) * diskRadius, sin(angle) * diskRadius, sqrt(1.0 - fraction));
+      float sampleDistance = radius * mix(0.1, 1.0, fraction * fraction);
+      vec3 samplePosition = position + (tangent * direction.x + bitangent * direction.y + normal * direction.z) * sampleDistance;
+
+      vec4 clip = projection * vec4(samplePosition, 1.0);
+      vec2 uv = clip.xy / clip.w * 0.5 + 0.5;
+      if (any(lessThan(uv, vec2(0.0))) || any(greaterThan(uv, vec2(1.0))))
+      {
+         continue;
+      }
+      vec3 scenePosition = ViewPositionAt(ivec2(uv * vec2(size)), size);
+      // occluders far behind the sample are another surface, not
+      // one shading this pixel
+      float range = smoothstep(0.0, 1.0, radius / max(abs(position.z - scenePosition.z), 1e-4));
+      occlusion += ((scenePosition.z >= samplePosition.z + BIAS) ? 1.0 : 0.0) * range;
+   }
+
+   outOcclusion = vec4(1.0 - occlusion / float(max(sampleCount, 1)), -position.z, 0.0, 0.0);
+}
@@ -0,0 +1,88 @@
+#version 400 core
+// temporal anti-aliasing: blends the frame, drawn a subpixel off the
+// last one, with the history of the earlier frames reprojected onto it
+// by its depth. The history is clamped to the colors around the pixel,
+// so what moved or was uncovered does not leave a trail
+uniform sampler2D colorTexture;
+uniform sampler2D depthTexture;
+uniform sampler2D historyTexture;
+uniform mat4 inverseViewProjection;
+uniform mat4 previousViewProjection;
+uniform int historyValid;
+uniform int clampMode;
+uniform float blendFactor;
+
+out vec4 outFragmentColor;
+
+#include "include/frameData.glsl"
+
+vec3 ColorAt(ivec2 coord, ivec2 size)
+{
+   return texelFetch(colorTexture, clamp(coord, ivec2(0), size - 1), 0).rgb;
+}
+
+void main()
+{
+   ivec2 size = textureSize(colorTexture, 0);
+   ivec2 coord = ivec2(gl_FragCoord.xy);
+   vec3 current = ColorAt(coord, size);
+   if (historyValid == 0)
+   {
+      outFragmentColor = vec4(current, 1.0);
+      return;
+   }
+
+   // the point of the pixel, kept homogeneous so the cleared depth of
+   // an infinite projection reprojects as a direction
+   float depth = texelFetch(depthTexture, coord, 0).r;
+   vec2 ndc = (vec2(coord) + 0.5) / vec2(size) * 2.0 - 1.0;
+   // reverse-Z clips depth to 0..1, which is the window depth as is
+   float ndcDepth = (viewPosition.w != 0.0) ? depth : (depth * 2.0 - 1.0);
+   vec4 worldPosition = inverseViewProjection * vec4(ndc, ndcDepth, 1.0);
+   vec4 previousClip = previousViewProjection * worldPosition;
+   vec2 previousUv = previousClip.xy / previousClip.w * 0.5 + 0.5;
+   if ((previousClip.w <= 0.0) || any(lessThan(previousUv, vec2(0.0))) || any(greaterThan(previousUv, vec2(1.0))))
+   {
+      outFragmentColor = vec4(current, 1.0);
+      return;
+   }
+   vec3 history = texture(historyTexture, previousUv).rgb;
+
+   // the range of the colors around the pixel
+   vec3 minColor = current;
+   vec3 maxColor = current;
+   vec3 moment1 = current;
+   vec3 moment2 = current * current;
+   for (int y = -1; y <= 1; y++)
+   {
+      for (int x = -1; x <= 1; x++)
+      {
+         if (((x == 0) && (y == 0)) || ((clampMode == 1) && (x != 0) && (y != 0)))
+         {
+            continue;
+         }
+         vec3 neighbor = ColorAt(coord + ivec2(x, y), size);
+         minColor = min(minColor, neighbor);
+         maxColor = max(maxColor, neighbor);
+         moment1 += neighbor;
+         moment2 += neighbor * neighbor;
+      }
+   }
+   if (clampMode == 3)
+   {
+      // narrow the box to a deviation around the mean, which keeps
+      // out the outliers of the box
+      vec3 mean = moment1 / 9.0;
+      vec3 deviation = sqrt(max(moment2 / 9.0 - mean * mean, 0.0));
+      minColor = max(minColor, mean - deviation);
+      maxColor = min(maxColor, mean + deviation);
+   }
+   history = clamp(history, minColor, maxColor);
+
+   // weigh by the inverse brightness, so a single bright sample does
+   // not flicker through the blend
+   float currentWeight = blendFactor / (1.0 + dot(current, vec3(0.299, 0.587, 0.114)));
+   float historyWeight = (1.0 - blendFactor) / (1.0 + dot(history, vec3(0.299, 0.587, 0.114)));
+   vec3 result = (current * currentWeight + history * historyWeight) / (currentWeight + historyWeight);
+   outFragmentColor = vec4(result, 1.0);
+}
@@ -0,0 +1,123 @@
+#version 430 core
+// prefilters one level of a captured reflection probe into its cube of
+// the probe array, one invocation per texel of all six faces; level 0
+// copies the capture, every other level takes the GGX lobe of a rougher
+// surface, importance sampled from the mips of the capture so a few
+// samples are enough without sparkles
+layout (local_size_x = 8, local_size_y = 8) in;
+
+// the captured cube with its full mip chain
+layout (binding = 14) uniform samplerCube captureCube;
+// the level of the probe array written by this pass, all six faces
+layout (binding = 0, rgba16f) writeonly uniform imageCubeArray probeLevel;
+
+// cube of the probe in the array
+uniform int probeIndex;
+uniform int levelSize;
+// GGX alpha of the level, 0 to copy the capture
+uniform float roughness;
+
+const int SAMPLE_COUNT = 32;
+const float PI = 3.14159265;
+
+// direction through the center of a texel of a cube face, in the
+// +X, -X, +Y, -Y, +Z, -Z order and texel orientation of a cube map
+vec3 GetTexelDirection(int face, ivec2 texel)
+{
+   vec2 st = ((vec2(texel) + 0.5) / float(levelSize)) * 2.0 - 1.0;
+   vec3 direction;
+   if (face == 0)
+   {
+      direction = vec3(1.0, -st.y, -st.x);
+   }
+   else if (face == 1)
+   {
+      direction = vec3(-1.0, -st.y, st.x);
+   }
+   else if (face == 2)
+   {
+      direction = vec3(st.x, 1.0, st.y);
+   }
+   else if (face == 3)
+   {
+      direction = vec3(st.x, -1.0, -st.y);
+   }
+   else if (face == 4)
+   {
+      direction = vec3(st.x, -st.y, 1.0);
+   }
+   else
+   {
+      direction = vec3(-st.x, -st.y, -1.0);
+   }
+   return(normalize(direction));
+}
+
+// point i of the Hammersley set in the unit square
+vec2 Hammersley(uint i)
+{
+   uint bits = i;
+   bits = (bits << 16u) | (bits >> 16u);
+   bits = ((bits & 0x55555555u) << 1u) | ((bits & 0xAAAAAAAAu) >> 1u);
+   bits = ((bits & 0x33333333u) << 2u) | ((bits & 0xCCCCCCCCu) >> 2u);
+   bits = ((bits & 0x0F0F0F0Fu) << 4u) | ((bits & 0xF0F0F0F0u) >> 4u);
+   bits = ((bits & 0x00FF00FFu) << 8u) | ((bits & 0xFF00FF00u) >> 8u);
+   return(vec2(float(i) / float(SAMPLE_COUNT), float(bits) * 2.3283064365386963e-10));
+}
+
+void main()
+{
+   ivec3 coord = ivec3(gl_GlobalInvocationID);
+   if (any(greaterThanEqual(coord.xy, ivec2(levelSize))))
+   {
+      return;
+   }
+   vec3 normal = GetTexelDirection(coord.z, coord.xy);
+   ivec3 target = ivec3(coord.xy, (probeIndex * 6) + coord.z);
+
+   if (roughness <= 0.0)
+   {
+      imageStore(probeLevel, target, vec4(textureLod(captureCube, normal, 0.0).rgb, 1.0));
+      return;
+   }
+
+   // the view is taken along the normal, so the lobe does not stretch
+   // at grazing angles, as usual for a prefiltered probe
+   vec3 up = (abs(normal.z) < 0.999) ? vec3(0.0, 0.0, 1.0) : vec3(1.0, 0.0, 0.0);
+   vec3 tangent = normalize(cross(up, normal));
+   vec3 bitangent = cross(normal, tangent);
+
+   float alphaSquared = roughness * roughness;
+   float captureSize = float(textureSize(captureCube, 0).x);
+   float texelSolidAngle = (4.0 * PI) / (6.0 * captureSize * captureSize);
+   float maxLevel = float(textureQueryLevels(captureCube) - 1);
+
+   vec3 color = vec3(0.0);
+   float weight = 0.0;
+   for (uint i = 0u; i < uint(SAMPLE_COUNT); i++)
+   {
+      // half vector of the GGX distribution, then the light direction
+      vec2 xi = Hammersley(i);
+      float phi = 2.0 * PI * xi.x;
+      float cosTheta = sqrt((1.0 - xi.y) / (1.0 + ((alphaSquared - 1.0) * xi.y)));
+      float sinTheta = sqrt(1.0 - (cosTheta * cosTheta));
+      vec3 halfVector = (tangent * (cos(phi) * sinTheta)) + (bitangent * (sin(phi) * sinTheta)) + (normal * cosTheta);
+      vec3 light = (2.0 * dot(normal, halfVector) * halfVector) - normal;
+      float cosLight = dot(normal, light);
+      if (cosLight <= 0.0)
+      {
+         continue;
+      }
+
+      // read the mip whose texels cover the solid angle of the sample
+      float denominator = ((cosTheta * cosTheta) * (alphaSquared - 1.0)) + 1.0;
+      float distribution = alphaSquared / (PI * denominator * denominator);
+      float pdf = distribution * 0.25;
+      float sampleSolidAngle = 1.0 / (float(SAMPLE_COUNT) * pdf + 0.0001);
+      float level = clamp((0.5 * log2(sampleSolidAngle / texelSolidAngle)) + 1.0, 0.0, maxLevel);
+
+      color += textureLod(captureCube, light, level).rgb * cosLight;
+      weight += cosLight;
+   }
+   imageStore(probeLevel, target, vec4(color / max(weight, 0.0001), 1.0));
+}
@@ -0,0 +1,109 @@
+#version 430 core
+// writes the interleaved vertices of one sphere or torus tessellation into
+// the arena vertex buffer from its parameter record, one invocation per
+// vertex, in the order and with the values ShapeMeshes::GenerateSphereMesh()
+// and GenerateTorusMesh() would write them, so the indices built on the CPU
+// draw them unchanged
+layout (local_size_x = 64) in;
+
+// ShapeMeshes::MESH_SHAPE
+const uint SHAPE_SPHERE = 7u;
+const uint SHAPE_TORUS = 9u;
+
+const float PI = 3.14159265358979323846;
+
+// the full float arena, ShapeMeshes::VERTEX_FLOATS per vertex: position,
+// normal, UV
+layout (std430, binding = 0) writeonly buffer ArenaVertices
+{
+   float vertices[];
+};
+
+// ShapeMeshes::PROCEDURAL_MESH
+uniform uint shape;
+uniform uint baseVertex;
+uniform uvec2 segments;    // bands and slices, or main and tube segments
+uniform float thickness;   // tube radius of the torus
+uniform uint vertexCount;
+
+void WriteVertex(uint vertex, vec3 position, vec3 normal, vec2 uv)
+{
+   uint first = (baseVertex + vertex) * 8u;
+   vertices[first] = position.x;
+   vertices[first + 1u] = position.y;
+   vertices[first + 2u] = position.z;
+   vertices[first + 3u] = normal.x;
+   vertices[first + 4u] = normal.y;
+   vertices[first + 5u] = normal.z;
+   vertices[first + 6u] = uv.x;
+   vertices[first + 7u] = uv.y;
+}
+
+// top pole, one ring of slices + 1 vertices per band boundary, bottom pole;
+// each ring holds slices 0 to slices / 2 and a second copy of the seam
+// slice starting the other half
+void SphereVertex(uint vertex)
+{
+   uint bands = segments.x;
+   uint slices = segments.y;
+   if (vertex == 0u)
+   {
+      WriteVertex(vertex, vec3(0.0, 1.0, 0.0), vec3(0.0, 1.0, 0.0), vec2(0.5, 1.0));
+      return;
+   }
+   if (vertex == vertexCount - 1u)
+   {
+      WriteVertex(vertex, vec3(0.0, -1.0, 0.0), vec3(0.0, -1.0, 0.0), vec2(0.5, 0.0));
+      return;
+   }
+
+   uint ringVertices = slices + 1u;
+   uint halfSlices = slices / 2u;
+   uint ring = 1u + (vertex - 1u) / ringVertices;
+   uint k = (vertex - 1u) % ringVertices;
+   uint slice = (k <= halfSlices) ? k : (k - 1u);
+
+   float bandAngle = PI * float(ring) / float(bands);
+   float y = cos(bandAngle);
+   float radius = sin(bandAngle);
+   float halfTurns = float(slice) / float(halfSlices) - ((k > halfSlices) ? 2.0 : 0.0);
+   float sliceAngle = 2.0 * PI * float(slice) / float(slices);
+   vec3 position = vec3(radius * sin(sliceAngle), y, radius * cos(sliceAngle));
+   WriteVertex(vertex, position, position,
+      vec2(0.5 + 0.5 * radius * halfTurns, 1.0 - float(ring) / float(bands)));
+}
+
+// a grid of main + 1 rows of tube + 1 vertices, the last row and column
+// on the angles of the first so the seams close exactly
+void TorusVertex(uint vertex)
+{
+   uint mainSegments = segments.x;
+   uint tubeSegments = segments.y;
+   uint i = vertex / (tubeSegments + 1u);
+   uint j = vertex % (tubeSegments + 1u);
+
+   float mainAngle = 2.0 * PI * float(i % mainSegments) / float(mainSegments);
+   float tubeAngle = 2.0 * PI * float(j % tubeSegments) / float(tubeSegments);
+   vec3 ringDirection = vec3(cos(mainAngle), sin(mainAngle), 0.0);
+   vec3 normal = ringDirection * cos(tubeAngle) + vec3(0.0, 0.0, sin(tubeAngle));
+   WriteVertex(vertex, ringDirection + normal * thickness, normal,
+      vec2(float(i) / float(mainSegments), float(j) / float(tubeSegments)));
+}
+
+void main()
+{
+   uint vertex = gl_GlobalInvocationID.x;
+   if (vertex >= vertexCount)
+   {
+      return;
+   }
+
+   if (shape == SHAPE_SPHERE)
+   {
+      SphereVertex(vertex);
+   }
+   else if (shape == SHAPE_TORUS)
+   {
+      TorusVertex(vertex);
+   }
+}
@@ -0,0 +1,86 @@
+#version 430 core
+// writes the shading rate of one tile of the frame per work group, see
+// ShadingRate: a tile is shaded coarsely when every pixel shows one of
+// the materials flagged for it in the G-buffer, and the luminance of the
+// previous frame barely varies over it
+layout (local_size_x = 16, local_size_y = 16) in;
+
+// must match ShadingRate::TILE_SIZE
+#define TILE_SIZE 16
+#define TILE_PIXELS (TILE_SIZE * TILE_SIZE)
+
+// the lit frame before and the materials of the G-buffer of this one,
+// on the units the lighting pass reads the rate image and coarse light
+layout (binding = 18) uniform sampler2D previousFrame;
+layout (binding = 19) uniform usampler2D materialTexture;
+// a texel per tile, 0 for full rate and 1 for one shade per 2x2 pixels
+layout (binding = 0, r8ui) writeonly uniform uimage2D shadingRateImage;
+
+// bit i set for the material of ID i + 1 in the G-buffer
+uniform uint coarseMaterials;
+
+// largest deviation of the luminance over a tile, relative to its mean,
+// still shaded coarsely; relative, so dark and bright regions of the
+// same contrast are treated alike
+const float MAX_RELATIVE_DEVIATION = 0.04;
+
+shared float tileLuminance[TILE_PIXELS];
+shared float tileSquared[TILE_PIXELS];
+shared uint tileFine;
+
+void main()
+{
+   ivec2 size = textureSize(materialTexture, 0);
+   ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);
+   uint index = gl_LocalInvocationIndex;
+   if (index == 0u)
+   {
+      tileFine = 0u;
+   }
+   memoryBarrierShared();
+   barrier();
+
+   float luminance = 0.0;
+   if (all(lessThan(pixel, size)))
+   {
+      // nothing drawn, or a material without the flag, keeps the tile
+      // at full rate
+      uint materialID = texelFetch(materialTexture, pixel, 0).r;
+      if ((materialID == 0u) || ((coarseMaterials & (1u << (materialID - 1u))) == 0u))
+      {
+         atomicOr(tileFine, 1u);
+      }
+      luminance = dot(texelFetch(previousFrame, pixel, 0).rgb, vec3(0.2126, 0.7152, 0.0722));
+   }
+   tileLuminance[index] = luminance;
+   tileSquared[index] = luminance * luminance;
+   memoryBarrierShared();
+   barrier();
+
+   // sum the tile in halves
+   for (uint stride = uint(TILE_PIXELS / 2); stride > 0u; stride /= 2u)
+   {
+      if (index < stride)
+      {
+         tileLuminance[index] += tileLuminance[index + stride];
+         tileSquared[index] += tileSquared[index + stride];
+      }
+      memoryBarrierShared();
+      barrier();
+   }
+
+   if (index != 0u)
+   {
+      return;
+   }
+
+   // the tiles along the right and top edges are cut off
+   ivec2 tile = ivec2(gl_WorkGroupID.xy);
+   ivec2 covered = min(size - (tile * TILE_SIZE), ivec2(TILE_SIZE));
+   float count = float(covered.x * covered.y);
+   float mean = tileLuminance[0] / count;
+   float variance = max((tileSquared[0] / count) - (mean * mean), 0.0);
+   bool bCoarse = (tileFine == 0u) && (sqrt(variance) <= (MAX_RELATIVE_DEVIATION * (mean + 0.01)));
+
+   imageStore(shadingRateImage, tile, uvec4(bCoarse ? 1u : 0u));
+}
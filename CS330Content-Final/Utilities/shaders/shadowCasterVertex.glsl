@@ -0,0 +1,40 @@
+#version 430 core
+#extension GL_ARB_shader_viewport_layer_array : enable
+// depth of one shadow caster into the cube of a point light in the shadow
+// atlas, one instance for each face set in faceMask, each writing the layer
+// of its face; drawn with depthPrepassFragment.glsl, which writes nothing
+// but depth. Without the extension a face is drawn at a time, into the one
+// layer attached, with a mask of that face alone.
+layout (location = 0) in vec3 inVertexPosition;
+
+// cube faces, in the +X, -X, +Y, -Y, +Z, -Z layer order
+#define SHADOW_FACES 6
+
+uniform mat4 model;
+uniform mat4 faceViewProjection[SHADOW_FACES];
+// faces the caster reaches, a bit per face
+uniform int faceMask;
+// layer of the +X face of the cube
+uniform int firstLayer;
+
+void main()
+{
+   // the face of this instance is the one of its set bit
+   int face = 0;
+   for (int skip = gl_InstanceID; face < (SHADOW_FACES - 1); face++)
+   {
+      if ((faceMask & (1 << face)) != 0)
+      {
+         if (skip == 0)
+         {
+            break;
+         }
+         skip--;
+      }
+   }
+
+   gl_Position = faceViewProjection[face] * model * vec4(inVertexPosition, 1.0f);
+#ifdef GL_ARB_shader_viewport_layer_array
+   gl_Layer = firstLayer + face;
+#endif
+}
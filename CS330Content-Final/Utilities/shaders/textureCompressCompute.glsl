@@ -0,0 +1,257 @@
+#version 430 core
+// compresses a level of an RGBA8, RG8 or R8 texture into BC1 blocks,
+// or BC3 blocks with alpha, one invocation per 4x4 block, into a buffer
+// GPUTextureCompressor copies the blocks from into the compressed texture
+layout (local_size_x = 8, local_size_y = 8) in;
+
+// two words a BC1 block, four a BC3 one with the alpha block first,
+// the blocks of a level in rows from the bottom, as GL lays them out
+layout (std430, binding = 0) writeonly buffer Blocks
+{
+   uint words[];
+};
+
+// read through its swizzle, so gray textures come in as RGB
+uniform sampler2D sourceTexture;
+uniform int sourceLevel;
+uniform ivec2 levelSize;
+// word of the first block of the level
+uniform uint firstWord;
+uniform bool alphaBlocks;
+// 0 for the box of the colors, 1 for their principal axis with the
+// endpoints fitted to the indices once
+uniform int quality;
+
+vec4 texels[16];
+
+uint PackColor(vec3 color)
+{
+   uvec3 bits = uvec3(round(clamp(color, 0.0, 1.0) * vec3(31.0, 63.0, 31.0)));
+   return((bits.r << 11) | (bits.g << 5) | bits.b);
+}
+
+vec3 UnpackColor(uint color)
+{
+   return(vec3(float((color >> 11) & 31u), float((color >> 5) & 63u), float(color & 31u)) / vec3(31.0, 63.0, 31.0));
+}
+
+// index of the palette entry nearest each texel, 2 bits a texel;
+// entries 0 and 1 are the endpoints, 2 and 3 the thirds between
+uint FindColorIndices(vec3 color0, vec3 color1)
+{
+   vec3 palette[4] = vec3[4](color0, color1, mix(color0, color1, 1.0 / 3.0), mix(color0, color1, 2.0 / 3.0));
+   uint indices = 0u;
+   for (int i = 0; i < 16; i++)
+   {
+      uint best = 0u;
+      float bestError = 1e30;
+      for (uint p = 0u; p < 4u; p++)
+      {
+         vec3 difference = texels[i].rgb - palette[p];
+         float error = dot(difference, difference);
+         if (error < bestError)
+         {
+            best = p;
+            bestError = error;
+         }
+      }
+      indices |= best << (2 * i);
+   }
+   return(indices);
+}
+
+// endpoints on the principal axis of the colors, the axis found by
+// iterating on their covariance from the box diagonal
+void FindAxisEndpoints(vec3 minColor, vec3 maxColor, out vec3 color0, out vec3 color1)
+{
+   vec3 mean = vec3(0.0);
+   for (int i = 0; i < 16; i++)
+   {
+      mean += texels[i].rgb;
+   }
+   mean /= 16.0;
+
+   mat3 covariance = mat3(0.0);
+   for (int i = 0; i < 16; i++)
+   {
+      vec3 d = texels[i].rgb - mean;
+      covariance += outerProduct(d, d);
+   }
+
+   vec3 axis = maxColor - minColor;
+   for (int i = 0; i < 8; i++)
+   {
+      vec3 next = covariance * axis;
+      float length2 = dot(next, next);
+      if (length2 < 1e-12)
+      {
+         break;
+      }
+      axis = next * inversesqrt(length2);
+   }
+   if (dot(axis, axis) < 1e-12)
+   {
+      color0 = maxColor;
+      color1 = minColor;
+      return;
+   }
+   axis = normalize(axis);
+
+   float low = 1e30;
+   float high = -1e30;
+   for (int i = 0; i < 16; i++)
+   {
+      float t = dot(texels[i].rgb - mean, axis);
+      low = min(low, t);
+      high = max(high, t);
+   }
+   color0 = clamp(mean + axis * high, 0.0, 1.0);
+   color1 = clamp(mean + axis * low, 0.0, 1.0);
+}
+
+// least squares endpoints for the indices picked, each texel the
+// weighted sum of the two; left as they are when the indices all pick
+// one weight
+void RefineEndpoints(uint indices, inout vec3 color0, inout vec3 color1)
+{
+   const float weights[4] = float[4](1.0, 0.0, 2.0 / 3.0, 1.0 / 3.0);
+   float alpha2 = 0.0;
+   float beta2 = 0.0;
+   float alphaBeta = 0.0;
+   vec3 alphaColor = vec3(0.0);
+   vec3 betaColor = vec3(0.0);
+   for (int i = 0; i < 16; i++)
+   {
+      float a = weights[(indices >> (2 * i)) & 3u];
+      float b = 1.0 - a;
+      alpha2 += a * a;
+      beta2 += b * b;
+      alphaBeta += a * b;
+      alphaColor += a * texels[i].rgb;
+      betaColor += b * texels[i].rgb;
+   }
+   float determinant = alpha2 * beta2 - alphaBeta * alphaBeta;
+   if (abs(determinant) < 1e-6)
+   {
+      return;
+   }
+   color0 = clamp((alphaColor * beta2 - betaColor * alphaBeta) / determinant, 0.0, 1.0);
+   color1 = clamp((betaColor * alpha2 - alphaColor * alphaBeta) / determinant, 0.0, 1.0);
+}
+
+// the two words of a color block, the endpoints ordered for the four
+// color mode BC3 always reads
+uvec2 EncodeColorBlock()
+{
+   vec3 minColor = texels[0].rgb;
+   vec3 maxColor = texels[0].rgb;
+   for (int i = 1; i < 16; i++)
+   {
+      minColor = min(minColor, texels[i].rgb);
+      maxColor = max(maxColor, texels[i].rgb);
+   }
+
+   vec3 color0;
+   vec3 color1;
+   if (quality == 0)
+   {
+      // inset by a sixteenth of the box, as the CPU encoder does
+      vec3 inset = (maxColor - minColor) / 16.0;
+      color0 = maxColor - inset;
+      color1 = minColor + inset;
+   }
+   else
+   {
+      FindAxisEndpoints(minColor, maxColor, color0, color1);
+      RefineEndpoints(FindColorIndices(color0, color1), color0, color1);
+   }
+
+   uint packed0 = PackColor(color0);
+   uint packed1 = PackColor(color1);
+   if (packed0 < packed1)
+   {
+      uint swapped = packed0;
+      packed0 = packed1;
+      packed1 = swapped;
+   }
+   uint indices = (packed0 == packed1) ? 0u : FindColorIndices(UnpackColor(packed0), UnpackColor(packed1));
+   return(uvec2(packed0 | (packed1 << 16), indices));
+}
+
+// the two words of a BC3 alpha block: the highest and lowest alpha
+// and 3 bits a texel, 0 and 1 for them and 2 to 7 for the sevenths
+// between, from the highest down
+uvec2 EncodeAlphaBlock()
+{
+   float minAlpha = texels[0].a;
+   float maxAlpha = texels[0].a;
+   for (int i = 1; i < 16; i++)
+   {
+      minAlpha = min(minAlpha, texels[i].a);
+      maxAlpha = max(maxAlpha, texels[i].a);
+   }
+   uint alpha0 = uint(round(maxAlpha * 255.0));
+   uint alpha1 = uint(round(minAlpha * 255.0));
+
+   uint low = 0u;
+   uint high = 0u;
+   if (alpha0 > alpha1)
+   {
+      float scale = 7.0 / float(alpha0 - alpha1);
+      for (int i = 0; i < 16; i++)
+      {
+         uint fraction = min(uint(round((float(alpha0) - texels[i].a * 255.0) * scale)), 7u);
+         uint code = (fraction == 0u) ? 0u : ((fraction == 7u) ? 1u : fraction + 1u);
+         int bit = 3 * i;
+         if (bit < 32)
+         {
+            low |= code << bit;
+            if (bit > 29)
+            {
+               high |= code >> (32 - bit);
+            }
+         }
+         else
+         {
+            high |= code << (bit - 32);
+         }
+      }
+   }
+   return(uvec2(alpha0 | (alpha1 << 8) | (low << 16), (low >> 16) | (high << 16)));
+}
+
+void main()
+{
+   ivec2 blockCount = (levelSize + 3) / 4;
+   ivec2 block = ivec2(gl_GlobalInvocationID.xy);
+   if (any(greaterThanEqual(block, blockCount)))
+   {
+      return;
+   }
+
+   // texels past the edges of a level repeat its last column and row
+   for (int i = 0; i < 16; i++)
+   {
+      ivec2 texel = min(block * 4 + ivec2(i & 3, i >> 2), levelSize - 1);
+      texels[i] = texelFetch(sourceTexture, texel, sourceLevel);
+   }
+
+   uint blockIndex = uint(block.y * blockCount.x + block.x);
+   if (alphaBlocks)
+   {
+      uint word = firstWord + blockIndex * 4u;
+      uvec2 alphaBlock = EncodeAlphaBlock();
+      uvec2 colorBlock = EncodeColorBlock();
+      words[word] = alphaBlock.x;
+      words[word + 1u] = alphaBlock.y;
+      words[word + 2u] = colorBlock.x;
+      words[word + 3u] = colorBlock.y;
+   }
+   else
+   {
+      uint word = firstWord + blockIndex * 2u;
+      uvec2 colorBlock = EncodeColorBlock();
+      words[word] = colorBlock.x;
+      words[word + 1u] = colorBlock.y;
+   }
+}
@@ -1,20 +1,117 @@
 #version 330 core
+// gl_BaseInstanceARB locates the instances of multi-draw indirect commands
+#extension GL_ARB_shader_draw_parameters : enable
+#ifdef USE_MULTIVIEW
+// every draw is broadcast to both layers of the stereo target
+#extension GL_OVR_multiview : require
+layout (num_views = 2) in;
+#endif
+#if defined(USE_SEPARABLE) || defined(USE_SPIRV)
+// linked on its own and paired with the fragment stages in pipelines,
+// or a SPIR-V module whose outputs are matched by location
+#extension GL_ARB_separate_shader_objects : require
+#endif
+#ifdef USE_SPIRV
+// SPIR-V modules carry no names, so the uniforms and blocks are found by
+// the locations and bindings given here; ShaderManager maps the uniform
+// locations back to their names, they must match g_SpirvUniforms
+#extension GL_ARB_explicit_uniform_location : require
+#extension GL_ARB_shading_language_420pack : require
+#define SPIRV_LOCATION(n) layout (location = n)
+#define SPIRV_BLOCK(n) layout (std140, binding = n)
+#else
+#define SPIRV_LOCATION(n)
+#define SPIRV_BLOCK(n) layout (std140)
+#endif
 layout (location = 0) in vec3 inVertexPosition;
 layout (location = 1) in vec3 inVertexNormal;
 layout (location = 2) in vec2 inTextureCoordinate;
+// lightmap UV and weight of the baked static geometry; the other
+// meshes leave the attribute disabled, which reads as a weight of 0
+layout (location = 3) in vec3 inLightmapCoordinate;
 
-out vec3 fragmentPosition;
-out vec3 fragmentVertexNormal;
-out vec2 fragmentTextureCoordinate;
+SPIRV_LOCATION(0) out vec3 fragmentPosition;
+SPIRV_LOCATION(1) out vec3 fragmentVertexNormal;
+SPIRV_LOCATION(2) out vec2 fragmentTextureCoordinate;
+SPIRV_LOCATION(3) out vec3 fragmentLightmapCoordinate;
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+// the depth pre-pass computes the same position, so the depths match
+// exactly for its GL_EQUAL test
+#ifdef USE_SEPARABLE
+// the built-in outputs a separable stage writes have to be declared
+out gl_PerVertex
+{
+	vec4 gl_Position;
+};
+#endif
+invariant gl_Position;
+
+#ifdef USE_INSTANCING
+// per-instance data of the render list, SceneManager::INSTANCE_DATA as
+// 9 RGBA32F texels: model columns, color, (UV scale, material index,
+// texture index), normal matrix columns whose w carry the light list
+SPIRV_LOCATION(2) uniform samplerBuffer instanceData;
+// first instance of the current batch in instanceData; zero for
+// multi-draw indirect, whose commands carry it as base instance
+SPIRV_LOCATION(3) uniform int instanceBase = 0;
+
+SPIRV_LOCATION(4) flat out vec4 instanceColor;
+SPIRV_LOCATION(5) flat out vec2 instanceUVscale;
+SPIRV_LOCATION(6) flat out int instanceMaterialIndex;
+SPIRV_LOCATION(7) flat out int instanceTextureIndex;
+// lights picked for the instance by SceneManager::PackObjectLights(),
+// three bytes per word, the first the count + 1 or 0 for none
+SPIRV_LOCATION(8) flat out uvec3 instanceLights;
+#else
+SPIRV_LOCATION(0) uniform mat4 model;
+// inverse transpose of the upper 3x3 of model, computed on the CPU
+SPIRV_LOCATION(1) uniform mat3 normalMatrix;
+#endif
+
+#include "include/frameData.glsl"
+
+#ifdef USE_MULTIVIEW
+// camera of each eye (std140, binding 5); FrameData then holds the
+// view enclosing both, which the lights are clustered against
+layout (std140) uniform StereoData
+{
+   mat4 eyeView[2];
+   mat4 eyeProjection[2];
+};
+#endif
 
 void main()
 {
+#ifdef USE_INSTANCING
+#ifdef GL_ARB_shader_draw_parameters
+   int texel = (instanceBase + gl_BaseInstanceARB + gl_InstanceID) * 9;
+#else
+   int texel = (instanceBase + gl_InstanceID) * 9;
+#endif
+   mat4 model = mat4(
+      texelFetch(instanceData, texel),
+      texelFetch(instanceData, texel + 1),
+      texelFetch(instanceData, texel + 2),
+      texelFetch(instanceData, texel + 3));
+   instanceColor = texelFetch(instanceData, texel + 4);
+   vec4 instanceExtra = texelFetch(instanceData, texel + 5);
+   instanceUVscale = instanceExtra.xy;
+   instanceMaterialIndex = int(instanceExtra.z);
+   instanceTextureIndex = int(instanceExtra.w);
+   vec4 normalColumn0 = texelFetch(instanceData, texel + 6);
+   vec4 normalColumn1 = texelFetch(instanceData, texel + 7);
+   vec4 normalColumn2 = texelFetch(instanceData, texel + 8);
+   mat3 normalMatrix = mat3(normalColumn0.xyz, normalColumn1.xyz, normalColumn2.xyz);
+   instanceLights = uvec3(normalColumn0.w, normalColumn1.w, normalColumn2.w);
+#endif
+
    fragmentPosition = vec3(model * vec4(inVertexPosition, 1.0));
+#ifdef USE_MULTIVIEW
+   gl_Position = eyeProjection[gl_ViewID_OVR] * eyeView[gl_ViewID_OVR] * model * vec4(inVertexPosition, 1.0f);
+#else
    gl_Position = projection * view * model * vec4(inVertexPosition, 1.0f);
-   fragmentVertexNormal = inVertexNormal;
+#endif
+   fragmentVertexNormal = normalMatrix * inVertexNormal;
    fragmentTextureCoordinate = inTextureCoordinate;
+   fragmentLightmapCoordinate = inLightmapCoordinate;
 }
\ No newline at end of file
@@ -0,0 +1,68 @@
+#version 430 core
+// converts a frame copied from the framebuffer into the NV12 planes a
+// video encoder takes, BT.709 in the limited range, one invocation per
+// four pixels of two rows, for the buffer FrameCapture reads back
+layout (local_size_x = 8, local_size_y = 8) in;
+
+// the frame, rows from the bottom as GL draws them
+layout (rgba8, binding = 0) readonly uniform image2D frame;
+
+// a byte of luma per pixel in rows from the top, then a byte of Cb
+// and one of Cr per 2x2 pixels, interleaved, four bytes a word
+layout (std430, binding = 0) writeonly buffer Planes
+{
+   uint words[];
+};
+
+// of the frame, and of the picture encoded, a multiple of 4 by 2
+// taken from its top left
+uniform ivec2 frameSize;
+uniform ivec2 pictureSize;
+
+vec3 ReadPixel(int x, int y)
+{
+   return(imageLoad(frame, ivec2(x, frameSize.y - 1 - y)).rgb);
+}
+
+float Luma(vec3 color)
+{
+   return(dot(color, vec3(0.2126, 0.7152, 0.0722)));
+}
+
+void main()
+{
+   ivec2 group = ivec2(gl_GlobalInvocationID.xy);
+   if ((group.x * 4 >= pictureSize.x) || (group.y * 2 >= pictureSize.y))
+   {
+      return;
+   }
+
+   int wordsPerRow = pictureSize.x / 4;
+   vec4 lumaRows[2];
+   vec2 chroma[2];
+   for (int pair = 0; pair < 2; pair++)
+   {
+      vec3 sum = vec3(0.0);
+      for (int row = 0; row < 2; row++)
+      {
+         for (int column = 0; column < 2; column++)
+         {
+            vec3 color = ReadPixel(group.x * 4 + pair * 2 + column, group.y * 2 + row);
+            lumaRows[row][pair * 2 + column] = Luma(color);
+            sum += color;
+         }
+      }
+      vec3 average = sum * 0.25;
+      float luma = Luma(average);
+      chroma[pair] = vec2((average.b - luma) / 1.8556, (average.r - luma) / 1.5748);
+   }
+
+   for (int row = 0; row < 2; row++)
+   {
+      words[(group.y * 2 + row) * wordsPerRow + group.x] =
+         packUnorm4x8((16.0 + 219.0 * lumaRows[row]) / 255.0);
+   }
+   uint chromaStart = uint(pictureSize.x * pictureSize.y / 4);
+   words[chromaStart + uint(group.y * wordsPerRow + group.x)] =
+      packUnorm4x8((128.0 + 224.0 * vec4(chroma[0], chroma[1])) / 255.0);
+}